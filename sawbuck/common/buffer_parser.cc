@@ -14,9 +14,75 @@
 #include "sawbuck/common/buffer_parser.h"
 
 #include "base/logging.h"
+#include "build/build_config.h"
+
+#if defined(ARCH_CPU_X86_FAMILY)
+#include <emmintrin.h>
+#endif
 
 namespace {
 
+// Returns the index of the first zero among the @p num_chars characters
+// at @p str, or @p num_chars if there's none. Reads no further.
+template <class CharType>
+size_t FindTerminatorScalar(const CharType* str, size_t num_chars) {
+  for (size_t i = 0; i < num_chars; ++i) {
+    if (str[i] == 0)
+      return i;
+  }
+  return num_chars;
+}
+
+#if defined(ARCH_CPU_X86_FAMILY)
+
+// SSE2 is baseline on every x86 CPU we run on, so there's no need to check
+// for it at runtime. The vector loop compares sixteen bytes at a time with
+// unaligned loads, and only while sixteen bytes remain, so it never reads
+// past the end of the buffer. The scalar loop pins down the terminator in
+// the block it's found in, and scans the tail.
+size_t FindTerminator(const char* str, size_t num_chars) {
+  const size_t kCharsPerBlock = sizeof(__m128i);
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + kCharsPerBlock <= num_chars; i += kCharsPerBlock) {
+    __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(block, zero)) != 0)
+      return i + FindTerminatorScalar(str + i, kCharsPerBlock);
+  }
+
+  return i + FindTerminatorScalar(str + i, num_chars - i);
+}
+
+#if defined(WCHAR_T_IS_UTF16)
+size_t FindTerminator(const wchar_t* str, size_t num_chars) {
+  const size_t kCharsPerBlock = sizeof(__m128i) / sizeof(wchar_t);
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + kCharsPerBlock <= num_chars; i += kCharsPerBlock) {
+    __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(block, zero)) != 0)
+      return i + FindTerminatorScalar(str + i, kCharsPerBlock);
+  }
+
+  return i + FindTerminatorScalar(str + i, num_chars - i);
+}
+#else  // defined(WCHAR_T_IS_UTF16)
+size_t FindTerminator(const wchar_t* str, size_t num_chars) {
+  return FindTerminatorScalar(str, num_chars);
+}
+#endif  // defined(WCHAR_T_IS_UTF16)
+
+#else  // defined(ARCH_CPU_X86_FAMILY)
+
+template <class CharType>
+size_t FindTerminator(const CharType* str, size_t num_chars) {
+  return FindTerminatorScalar(str, num_chars);
+}
+
+#endif  // defined(ARCH_CPU_X86_FAMILY)
+
 template <class CharType>
 bool GetStringAtImpl(BinaryBufferParser* parser, size_t pos,
     const CharType** ptr, size_t* len) {
@@ -26,15 +92,13 @@ bool GetStringAtImpl(BinaryBufferParser* parser, size_t pos,
     return false;
 
   size_t num_chars = (parser->data_len() - pos) / sizeof(*start);
-  for (size_t strlen = 0; strlen < num_chars; ++strlen) {
-    if (start[strlen] == '\0') {
-      *len = strlen;
-      *ptr = start;
-      return true;
-    }
-  }
+  size_t strlen = FindTerminator(start, num_chars);
+  if (strlen == num_chars)
+    return false;
 
-  return false;
+  *len = strlen;
+  *ptr = start;
+  return true;
 }
 
 }  // namespace
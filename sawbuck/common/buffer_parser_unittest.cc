@@ -12,6 +12,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include "sawbuck/common/buffer_parser.h"
+
+#include <algorithm>
+#include <vector>
+#include "base/logging.h"
+#include "base/time/time.h"
 #include "gtest/gtest.h"
 
 namespace {
@@ -113,6 +118,80 @@ TEST(BinaryBufferParser, GetStringAtWideSucceeds) {
   TestGetStringAt<wchar_t>();
 }
 
+// Tries strings of each length at each offset into exactly sized buffers,
+// to cover the block and tail paths of the terminator search.
+template <class CharType>
+void TestGetStringAtLengths() {
+  const size_t kMaxChars = 70;
+  for (size_t num_chars = 1; num_chars <= kMaxChars; ++num_chars) {
+    std::vector<CharType> buf(num_chars, 'x');
+    BinaryBufferParser parser(&buf[0], num_chars * sizeof(buf[0]));
+    const CharType* str = NULL;
+    size_t len = 0;
+
+    // No terminator.
+    for (size_t pos = 0; pos < num_chars; ++pos)
+      ASSERT_FALSE(parser.GetStringAt(pos * sizeof(buf[0]), &str, &len));
+
+    for (size_t zero = 0; zero < num_chars; ++zero) {
+      buf[zero] = 0;
+      for (size_t pos = 0; pos < num_chars; ++pos) {
+        bool found = parser.GetStringAt(pos * sizeof(buf[0]), &str, &len);
+        ASSERT_EQ(pos <= zero, found);
+        if (found) {
+          ASSERT_EQ(&buf[pos], str);
+          ASSERT_EQ(zero - pos, len);
+        }
+      }
+      buf[zero] = 'x';
+    }
+  }
+}
+
+TEST(BinaryBufferParser, GetStringAtLengths) {
+  TestGetStringAtLengths<char>();
+}
+
+TEST(BinaryBufferParser, GetStringAtWideLengths) {
+  TestGetStringAtLengths<wchar_t>();
+}
+
+// Reports the rate GetStringAt scans at, next to a byte at a time loop.
+TEST(BinaryBufferParser, GetStringAtThroughput) {
+  const size_t kNumChars = 1024 * 1024;
+  const int kNumPasses = 20;
+  std::vector<char> buf(kNumChars, 'x');
+  buf.back() = '\0';
+
+  BinaryBufferParser parser(&buf[0], buf.size());
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  for (int i = 0; i < kNumPasses; ++i) {
+    const char* str = NULL;
+    size_t len = 0;
+    ASSERT_TRUE(parser.GetStringAt(0, &str, &len));
+    ASSERT_EQ(kNumChars - 1, len);
+  }
+  base::TimeDelta parser_time = base::TimeTicks::HighResNow() - start;
+
+  // The volatile read keeps the loop from being replaced by strlen.
+  start = base::TimeTicks::HighResNow();
+  for (int i = 0; i < kNumPasses; ++i) {
+    const volatile char* str = &buf[0];
+    size_t len = 0;
+    while (str[len] != '\0')
+      ++len;
+    ASSERT_EQ(kNumChars - 1, len);
+  }
+  base::TimeDelta loop_time = base::TimeTicks::HighResNow() - start;
+
+  double num_bytes = static_cast<double>(kNumChars) * kNumPasses;
+  LOG(INFO) << "GetStringAt: "
+            << num_bytes / std::max(parser_time.InSecondsF(), 1e-6)
+            << " bytes/s, byte loop: "
+            << num_bytes / std::max(loop_time.InSecondsF(), 1e-6)
+            << " bytes/s.";
+}
+
 TEST(BinaryBufferReader, IsAligned) {
   BinaryBufferReader reader(kDataBuffer, kDataBufferSize);
 
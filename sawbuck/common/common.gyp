@@ -72,7 +72,24 @@
         'com_utils.cc',
         'com_utils.h',
         'initializing_coclass.h',
+        'memory_budget.cc',
+        'memory_budget.h',
+        'memory_footprint.h',
+        'perf_counters.cc',
+        'perf_counters.h',
+        'record_decoder.h',
+        'reorder_buffer.h',
+        'spsc_ring.h',
+        'task_pool.cc',
+        'task_pool.h',
+        'utf8_transcoder.cc',
+        'utf8_transcoder.h',
       ],
+      'link_settings': {
+        'libraries': [
+          '-lpsapi.lib',
+        ],
+      },
     },
     {
       'target_name': 'common_unittests',
@@ -82,6 +99,14 @@
         'com_utils_unittest.cc',
         'common_unittest_main.cc',
         'initializing_coclass_unittest.cc',
+        'memory_budget_unittest.cc',
+        'memory_footprint_unittest.cc',
+        'perf_counters_unittest.cc',
+        'record_decoder_unittest.cc',
+        'reorder_buffer_unittest.cc',
+        'spsc_ring_unittest.cc',
+        'task_pool_unittest.cc',
+        'utf8_transcoder_unittest.cc',
       ],
       'dependencies': [
         'common',
@@ -0,0 +1,225 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Memory budget implementation.
+#include "sawbuck/common/memory_budget.h"
+
+#include <psapi.h>
+#include <algorithm>
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+
+namespace {
+
+MemoryBudget shared_memory_budget;
+
+double ToMegabytes(uint64 bytes) {
+  return static_cast<double>(bytes) / (1024 * 1024);
+}
+
+}  // namespace
+
+const uint64 MemoryBudget::kDefaultLimit;
+const uint64 MemoryBudget::kDefaultCommitLimit;
+
+MemoryBudget::MemoryBudget()
+    : next_id_(0), limit_(kDefaultLimit),
+      commit_limit_(kDefaultCommitLimit), low_memory_(NULL) {
+}
+
+MemoryBudget::~MemoryBudget() {
+  if (low_memory_ != NULL)
+    ::CloseHandle(low_memory_);
+}
+
+MemoryBudget* MemoryBudget::Get() {
+  return &shared_memory_budget;
+}
+
+MemoryBudget::ConsumerId MemoryBudget::Register(const std::string& name,
+                                                double refill_cost,
+                                                const EvictCallback& evict) {
+  DCHECK(!evict.is_null());
+  DCHECK_LT(0.0, refill_cost);
+
+  base::AutoLock lock(lock_);
+  ConsumerId id = next_id_++;
+  Consumer& consumer = consumers_[id];
+  consumer.usage.name = name;
+  consumer.refill_cost = refill_cost;
+  consumer.evict = evict;
+
+  return id;
+}
+
+void MemoryBudget::Unregister(ConsumerId id) {
+  base::AutoLock lock(lock_);
+  DCHECK(consumers_.find(id) != consumers_.end());
+  consumers_.erase(id);
+}
+
+void MemoryBudget::ReportUsage(ConsumerId id, uint64 bytes) {
+  base::AutoLock lock(lock_);
+  ConsumerMap::iterator it(consumers_.find(id));
+  DCHECK(it != consumers_.end());
+  it->second.usage.bytes = bytes;
+}
+
+void MemoryBudget::set_limit(uint64 limit) {
+  base::AutoLock lock(lock_);
+  limit_ = limit;
+}
+
+uint64 MemoryBudget::limit() const {
+  base::AutoLock lock(lock_);
+  return limit_;
+}
+
+void MemoryBudget::set_commit_limit(uint64 commit_limit) {
+  base::AutoLock lock(lock_);
+  commit_limit_ = commit_limit;
+}
+
+uint64 MemoryBudget::commit_limit() const {
+  base::AutoLock lock(lock_);
+  return commit_limit_;
+}
+
+uint64 MemoryBudget::Enforce(uint64 process_commit, bool memory_low) {
+  std::vector<std::pair<EvictCallback, uint64> > evictions;
+  uint64 requested = 0;
+
+  {
+    base::AutoLock lock(lock_);
+
+    uint64 total = 0;
+    std::vector<Consumer*> order;
+    ConsumerMap::iterator it(consumers_.begin());
+    for (; it != consumers_.end(); ++it) {
+      total += it->second.usage.bytes;
+      if (it->second.usage.bytes != 0)
+        order.push_back(&it->second);
+    }
+
+    // Take the greatest of the excesses, as shedding that meets them all.
+    uint64 excess = 0;
+    if (limit_ != 0 && total > limit_)
+      excess = total - limit_;
+    if (commit_limit_ != 0 && process_commit > commit_limit_)
+      excess = std::max(excess, process_commit - commit_limit_);
+    if (memory_low)
+      excess = std::max(excess, total / 4);
+    if (excess == 0)
+      return 0;
+
+    std::sort(order.begin(), order.end(), EvictsBefore);
+    for (size_t i = 0; i < order.size() && requested < excess; ++i) {
+      Consumer* consumer = order[i];
+      uint64 bytes = std::min(consumer->usage.bytes, excess - requested);
+      consumer->usage.evicted += bytes;
+      requested += bytes;
+      evictions.push_back(std::make_pair(consumer->evict, bytes));
+    }
+  }
+
+  // The consumers may report back as they evict, which takes the lock.
+  for (size_t i = 0; i < evictions.size(); ++i)
+    evictions[i].first.Run(evictions[i].second);
+
+  return requested;
+}
+
+uint64 MemoryBudget::CheckPressure() {
+  PROCESS_MEMORY_COUNTERS_EX counters = {};
+  counters.cb = sizeof(counters);
+  uint64 process_commit = 0;
+  if (::GetProcessMemoryInfo(
+          ::GetCurrentProcess(),
+          reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+          sizeof(counters))) {
+    process_commit = counters.PrivateUsage;
+  }
+
+  BOOL memory_low = FALSE;
+  {
+    base::AutoLock lock(lock_);
+    if (low_memory_ == NULL) {
+      low_memory_ =
+          ::CreateMemoryResourceNotification(LowMemoryResourceNotification);
+    }
+    if (low_memory_ != NULL &&
+        !::QueryMemoryResourceNotification(low_memory_, &memory_low)) {
+      memory_low = FALSE;
+    }
+  }
+
+  return Enforce(process_commit, memory_low != FALSE);
+}
+
+uint64 MemoryBudget::GetTotalUsage() const {
+  base::AutoLock lock(lock_);
+  uint64 total = 0;
+  ConsumerMap::const_iterator it(consumers_.begin());
+  for (; it != consumers_.end(); ++it)
+    total += it->second.usage.bytes;
+
+  return total;
+}
+
+void MemoryBudget::GetUsage(std::vector<Usage>* usage) const {
+  DCHECK(usage != NULL);
+
+  base::AutoLock lock(lock_);
+  usage->clear();
+  ConsumerMap::const_iterator it(consumers_.begin());
+  for (; it != consumers_.end(); ++it)
+    usage->push_back(it->second.usage);
+}
+
+std::wstring MemoryBudget::FormatSummary() const {
+  std::vector<Usage> usage;
+  GetUsage(&usage);
+
+  uint64 total = 0;
+  for (size_t i = 0; i < usage.size(); ++i)
+    total += usage[i].bytes;
+
+  std::wstring summary;
+  uint64 budget_limit = limit();
+  if (budget_limit != 0) {
+    summary = base::StringPrintf(L"Caches %.1f of %.0f MB",
+                                 ToMegabytes(total),
+                                 ToMegabytes(budget_limit));
+  } else {
+    summary = base::StringPrintf(L"Caches %.1f MB", ToMegabytes(total));
+  }
+
+  for (size_t i = 0; i < usage.size(); ++i) {
+    summary.append(i == 0 ? L": " : L", ");
+    summary.append(base::UTF8ToWide(usage[i].name));
+    summary.append(base::StringPrintf(L" %.1f", ToMegabytes(usage[i].bytes)));
+  }
+
+  return summary;
+}
+
+bool MemoryBudget::EvictsBefore(const Consumer* a, const Consumer* b) {
+  // The cheapest to refill go first, and of those equally cheap, the
+  // largest, which are likeliest to hold bytes that haven't been used in
+  // a while.
+  if (a->refill_cost != b->refill_cost)
+    return a->refill_cost < b->refill_cost;
+  return a->usage.bytes > b->usage.bytes;
+}
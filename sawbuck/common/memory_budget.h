@@ -0,0 +1,144 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Memory budget declaration.
+#ifndef SAWBUCK_COMMON_MEMORY_BUDGET_H_
+#define SAWBUCK_COMMON_MEMORY_BUDGET_H_
+
+#include <windows.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/synchronization/lock.h"
+
+// Keeps the books on the memory sawbuck's caches take, so that together
+// they stay within one budget, rather than each within its own.
+//
+// Each cache registers with the price of refilling it, and reports its
+// footprint as it changes. When the caches are over the budget, the
+// process commits more than it should, or the system runs low on memory,
+// the budget asks the caches that are cheapest to refill to shed bytes
+// first. A cache sheds what it can and reports its new footprint.
+class MemoryBudget {
+ public:
+  typedef int ConsumerId;
+
+  // Asks a consumer to free about the given number of bytes. This is run
+  // on the thread that enforces the budget, without the budget's lock
+  // held, so a consumer living on another thread posts itself the work.
+  typedef base::Callback<void(uint64)> EvictCallback;
+
+  // A consumer's share of the budget.
+  struct Usage {
+    Usage() : bytes(0), evicted(0) {
+    }
+
+    std::string name;
+    uint64 bytes;
+    // The bytes the consumer was asked to free to date.
+    uint64 evicted;
+  };
+
+  // The default limit on the caches, and of the process's commit, which
+  // leave a 32 bit process room for the logs themselves.
+  static const uint64 kDefaultLimit = 768 * 1024 * 1024;
+  static const uint64 kDefaultCommitLimit = 1536 * 1024 * 1024;
+
+  MemoryBudget();
+  ~MemoryBudget();
+
+  // @returns the budget shared by the whole process.
+  static MemoryBudget* Get();
+
+  // Registers a consumer.
+  // @param name names the consumer in the summary.
+  // @param refill_cost what it costs to refill a byte of the consumer's
+  //     cache, relative to the other consumers. Display text that is
+  //     quickly formatted anew rates 1, symbols off a symbol server far
+  //     more. The cheapest consumers are asked to shed bytes first.
+  // @param evict the consumer's eviction callback.
+  // @returns the consumer's id.
+  ConsumerId Register(const std::string& name,
+                      double refill_cost,
+                      const EvictCallback& evict);
+
+  // Unregisters the consumer @p id, whose usage leaves the books.
+  // @note the eviction callbacks run on the thread that enforces the
+  //     budget, so a consumer must unregister on that thread too, lest
+  //     it be asked after it's gone.
+  void Unregister(ConsumerId id);
+
+  // Records that the consumer @p id now takes @p bytes. The estimates of
+  // memory_footprint.h size the containers of a cache.
+  void ReportUsage(ConsumerId id, uint64 bytes);
+
+  // Accessors for the most the caches may take, in bytes, and the most
+  // the whole process may commit before the caches shed bytes. Zero
+  // lifts either limit.
+  // @{
+  void set_limit(uint64 limit);
+  uint64 limit() const;
+  void set_commit_limit(uint64 commit_limit);
+  uint64 commit_limit() const;
+  // @}
+
+  // Asks the consumers to shed what takes them over the budget.
+  // @param process_commit the bytes the process commits.
+  // @param memory_low true iff the system runs low on memory, in which
+  //     case the caches shed a quarter of their footprint at least.
+  // @returns the bytes the consumers were asked to free.
+  uint64 Enforce(uint64 process_commit, bool memory_low);
+
+  // Samples the process's commit and the system's memory pressure, and
+  // enforces the budget with them.
+  // @returns the bytes the consumers were asked to free.
+  uint64 CheckPressure();
+
+  // @returns the bytes the consumers take together.
+  uint64 GetTotalUsage() const;
+
+  // Retrieves the consumers' shares to @p usage, in registration order.
+  void GetUsage(std::vector<Usage>* usage) const;
+
+  // @returns the budget as a line for the stats pane, e.g.
+  //     "Caches 12.5 of 768 MB: symbols 12.0, display 0.5".
+  std::wstring FormatSummary() const;
+
+ private:
+  struct Consumer {
+    Usage usage;
+    double refill_cost;
+    EvictCallback evict;
+  };
+  typedef std::map<ConsumerId, Consumer> ConsumerMap;
+
+  // Orders the consumers by what they are asked to free first.
+  static bool EvictsBefore(const Consumer* a, const Consumer* b);
+
+  mutable base::Lock lock_;
+  ConsumerMap consumers_;  // Under lock_.
+  ConsumerId next_id_;  // Under lock_.
+  uint64 limit_;  // Under lock_.
+  uint64 commit_limit_;  // Under lock_.
+
+  // Signalled while the system runs low on memory, created on the first
+  // check.
+  HANDLE low_memory_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryBudget);
+};
+
+#endif  // SAWBUCK_COMMON_MEMORY_BUDGET_H_
@@ -0,0 +1,166 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Memory budget unittests.
+#include "sawbuck/common/memory_budget.h"
+
+#include <algorithm>
+#include "base/bind.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// A cache that sheds what it's asked to, and reports back.
+class TestConsumer {
+ public:
+  TestConsumer(MemoryBudget* budget, const char* name, double refill_cost)
+      : budget_(budget), bytes_(0), evictions_(0) {
+    id_ = budget_->Register(
+        name, refill_cost,
+        base::Bind(&TestConsumer::Evict, base::Unretained(this)));
+  }
+  ~TestConsumer() {
+    budget_->Unregister(id_);
+  }
+
+  void SetBytes(uint64 bytes) {
+    bytes_ = bytes;
+    budget_->ReportUsage(id_, bytes_);
+  }
+
+  uint64 bytes() const { return bytes_; }
+  int evictions() const { return evictions_; }
+
+ private:
+  void Evict(uint64 bytes) {
+    ++evictions_;
+    SetBytes(bytes_ - std::min(bytes, bytes_));
+  }
+
+  MemoryBudget* budget_;
+  MemoryBudget::ConsumerId id_;
+  uint64 bytes_;
+  int evictions_;
+};
+
+}  // namespace
+
+TEST(MemoryBudgetTest, StaysWithinLimit) {
+  MemoryBudget budget;
+  budget.set_limit(1000);
+  budget.set_commit_limit(0);
+
+  TestConsumer cheap(&budget, "cheap", 1.0);
+  TestConsumer dear(&budget, "dear", 10.0);
+  cheap.SetBytes(300);
+  dear.SetBytes(600);
+  EXPECT_EQ(900U, budget.GetTotalUsage());
+
+  // Within the limit, nobody sheds a byte.
+  EXPECT_EQ(0U, budget.Enforce(0, false));
+  EXPECT_EQ(0, cheap.evictions());
+  EXPECT_EQ(0, dear.evictions());
+
+  // Over it, the cheap consumer goes first.
+  dear.SetBytes(800);
+  EXPECT_EQ(100U, budget.Enforce(0, false));
+  EXPECT_EQ(200U, cheap.bytes());
+  EXPECT_EQ(800U, dear.bytes());
+  EXPECT_EQ(0, dear.evictions());
+
+  // Once the cheap one is empty, the dear one gives.
+  dear.SetBytes(1000);
+  EXPECT_EQ(200U, budget.Enforce(0, false));
+  EXPECT_EQ(0U, cheap.bytes());
+  EXPECT_EQ(1000U, dear.bytes());
+  EXPECT_EQ(0, dear.evictions());
+
+  dear.SetBytes(1300);
+  EXPECT_EQ(300U, budget.Enforce(0, false));
+  EXPECT_EQ(1000U, dear.bytes());
+  EXPECT_EQ(1, dear.evictions());
+  // The empty consumer isn't bothered.
+  EXPECT_EQ(2, cheap.evictions());
+}
+
+TEST(MemoryBudgetTest, ShedsUnderPressure) {
+  MemoryBudget budget;
+  budget.set_limit(0);
+  budget.set_commit_limit(5000);
+
+  TestConsumer cheap(&budget, "cheap", 1.0);
+  TestConsumer dear(&budget, "dear", 10.0);
+  cheap.SetBytes(400);
+  dear.SetBytes(800);
+
+  // Without a limit on the caches, only the commit counts.
+  EXPECT_EQ(0U, budget.Enforce(5000, false));
+  EXPECT_EQ(500U, budget.Enforce(5500, false));
+  EXPECT_EQ(0U, cheap.bytes());
+  EXPECT_EQ(700U, dear.bytes());
+
+  // Low memory sheds a quarter at least.
+  cheap.SetBytes(100);
+  EXPECT_EQ(200U, budget.Enforce(0, true));
+  EXPECT_EQ(0U, cheap.bytes());
+  EXPECT_EQ(600U, dear.bytes());
+}
+
+TEST(MemoryBudgetTest, EqualCostsShedLargestFirst) {
+  MemoryBudget budget;
+  budget.set_limit(100);
+
+  TestConsumer small(&budget, "small", 1.0);
+  TestConsumer large(&budget, "large", 1.0);
+  small.SetBytes(50);
+  large.SetBytes(150);
+
+  EXPECT_EQ(100U, budget.Enforce(0, false));
+  EXPECT_EQ(50U, small.bytes());
+  EXPECT_EQ(50U, large.bytes());
+}
+
+TEST(MemoryBudgetTest, FormatSummary) {
+  MemoryBudget budget;
+  budget.set_limit(768 * 1024 * 1024);
+  EXPECT_EQ(L"Caches 0.0 of 768 MB", budget.FormatSummary());
+
+  TestConsumer symbols(&budget, "symbols", 10.0);
+  TestConsumer display(&budget, "display", 1.0);
+  symbols.SetBytes(12 * 1024 * 1024);
+  display.SetBytes(512 * 1024);
+  EXPECT_EQ(L"Caches 12.5 of 768 MB: symbols 12.0, display 0.5",
+            budget.FormatSummary());
+
+  std::vector<MemoryBudget::Usage> usage;
+  budget.GetUsage(&usage);
+  ASSERT_EQ(2U, usage.size());
+  EXPECT_EQ("symbols", usage[0].name);
+  EXPECT_EQ(12U * 1024 * 1024, usage[0].bytes);
+
+  budget.set_limit(0);
+  EXPECT_EQ(L"Caches 12.5 MB: symbols 12.0, display 0.5",
+            budget.FormatSummary());
+}
+
+TEST(MemoryBudgetTest, UnregisterLeavesTheBooks) {
+  MemoryBudget budget;
+  {
+    TestConsumer consumer(&budget, "consumer", 1.0);
+    consumer.SetBytes(100);
+    EXPECT_EQ(100U, budget.GetTotalUsage());
+  }
+  EXPECT_EQ(0U, budget.GetTotalUsage());
+  EXPECT_EQ(0U, budget.CheckPressure());
+}
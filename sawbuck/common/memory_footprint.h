@@ -0,0 +1,40 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Estimates of the heap the standard containers take, for the footprints
+// the caches and indexes report.
+#ifndef SAWBUCK_COMMON_MEMORY_FOOTPRINT_H_
+#define SAWBUCK_COMMON_MEMORY_FOOTPRINT_H_
+
+#include <stddef.h>
+
+// What a std::map or std::set node takes beside its value: the parent and
+// child links and the color, and the heap's own header, which together
+// come to about four pointers.
+const size_t kTreeNodeOverhead = 4 * sizeof(void*);
+
+// @returns the heap a node of @p Tree takes, value and all.
+template <class Tree>
+size_t TreeNodeFootprint() {
+  return sizeof(typename Tree::value_type) + kTreeNodeOverhead;
+}
+
+// @returns roughly the heap the nodes of @p tree take, not counting what
+//     its values point to.
+template <class Tree>
+size_t TreeFootprint(const Tree& tree) {
+  return tree.size() * TreeNodeFootprint<Tree>();
+}
+
+#endif  // SAWBUCK_COMMON_MEMORY_FOOTPRINT_H_
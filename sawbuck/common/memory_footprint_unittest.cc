@@ -0,0 +1,50 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Memory footprint unittests.
+#include "sawbuck/common/memory_footprint.h"
+
+#include <map>
+#include <set>
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(MemoryFootprintTest, EmptyTreeTakesNothing) {
+  EXPECT_EQ(0U, TreeFootprint(std::map<int, double>()));
+  EXPECT_EQ(0U, TreeFootprint(std::set<int>()));
+}
+
+TEST(MemoryFootprintTest, NodeCoversValueAndLinks) {
+  typedef std::map<int, double> Map;
+  EXPECT_EQ(sizeof(Map::value_type) + kTreeNodeOverhead,
+            TreeNodeFootprint<Map>());
+  EXPECT_LT(3 * sizeof(void*), kTreeNodeOverhead);
+}
+
+TEST(MemoryFootprintTest, TreeScalesWithSize) {
+  typedef std::map<int, double> Map;
+  Map map;
+  for (int i = 0; i < 10; ++i)
+    map[i] = i;
+  EXPECT_EQ(10 * TreeNodeFootprint<Map>(), TreeFootprint(map));
+
+  std::set<int> set;
+  set.insert(1);
+  set.insert(2);
+  set.insert(2);
+  EXPECT_EQ(2 * (sizeof(int) + kTreeNodeOverhead), TreeFootprint(set));
+}
+
+}  // namespace
@@ -0,0 +1,149 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Perf counter implementation.
+#include "sawbuck/common/perf_counters.h"
+
+#include <algorithm>
+#include "base/atomicops.h"
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+
+namespace {
+
+// The head of the list of registered counters, a PerfCounter*. Being
+// zero-initialized, it's ready before any counter's constructor runs.
+base::subtle::AtomicWord g_counters = 0;
+
+PerfCounter* FirstCounter() {
+  return reinterpret_cast<PerfCounter*>(
+      base::subtle::Acquire_Load(&g_counters));
+}
+
+bool NameLess(const PerfCounterValues& a, const PerfCounterValues& b) {
+  return a.name < b.name;
+}
+
+}  // namespace
+
+base::TimeDelta PerfCounterValues::EstimatedTotalTime() const {
+  if (samples == 0)
+    return base::TimeDelta();
+  return base::TimeDelta::FromMicroseconds(static_cast<int64>(
+      static_cast<double>(sample_time.InMicroseconds()) * count / samples));
+}
+
+const size_t PerfCounter::kNumShards;
+
+PerfCounter::PerfCounter(const char* name, uint32 sample_interval)
+    : name_(name), sample_interval_(sample_interval), next_(NULL) {
+  DCHECK(name != NULL);
+  DCHECK(sample_interval != 0 &&
+         (sample_interval & (sample_interval - 1)) == 0);
+  memset(shards_, 0, sizeof(shards_));
+
+  // Push ourselves on the list of counters.
+  base::subtle::AtomicWord head = 0;
+  do {
+    head = base::subtle::NoBarrier_Load(&g_counters);
+    next_ = reinterpret_cast<PerfCounter*>(head);
+  } while (base::subtle::Release_CompareAndSwap(
+               &g_counters, head,
+               reinterpret_cast<base::subtle::AtomicWord>(this)) != head);
+}
+
+bool PerfCounter::Increment() {
+  LONGLONG count = ::InterlockedExchangeAdd64(&CurrentShard()->count, 1);
+  // The first operation on a shard is sampled, so that rare operations
+  // get timed at all.
+  return (count & (sample_interval_ - 1)) == 0;
+}
+
+void PerfCounter::AddSample(base::TimeDelta time) {
+  Shard* shard = CurrentShard();
+  ::InterlockedExchangeAdd64(&shard->samples, 1);
+  ::InterlockedExchangeAdd64(&shard->sample_time_us, time.InMicroseconds());
+}
+
+void PerfCounter::AddTimed(base::TimeDelta time) {
+  ::InterlockedExchangeAdd64(&CurrentShard()->count, 1);
+  AddSample(time);
+}
+
+void PerfCounter::GetValues(PerfCounterValues* values) const {
+  DCHECK(values != NULL);
+  values->name = name_;
+  values->count = 0;
+  values->samples = 0;
+  int64 sample_time_us = 0;
+  for (size_t i = 0; i < kNumShards; ++i) {
+    // The shards are read without a lock, so the sums may be off by the
+    // operations in flight, which is fine for a report.
+    values->count += shards_[i].count;
+    values->samples += shards_[i].samples;
+    sample_time_us += shards_[i].sample_time_us;
+  }
+  values->sample_time = base::TimeDelta::FromMicroseconds(sample_time_us);
+}
+
+void PerfCounter::Reset() {
+  for (size_t i = 0; i < kNumShards; ++i) {
+    Shard* shard = &shards_[i];
+    ::InterlockedExchangeAdd64(&shard->count, -shard->count);
+    ::InterlockedExchangeAdd64(&shard->samples, -shard->samples);
+    ::InterlockedExchangeAdd64(&shard->sample_time_us,
+                               -shard->sample_time_us);
+  }
+}
+
+void PerfCounter::GetAllValues(std::vector<PerfCounterValues>* values) {
+  DCHECK(values != NULL);
+  values->clear();
+  for (PerfCounter* counter = FirstCounter(); counter != NULL;
+       counter = counter->next_) {
+    values->push_back(PerfCounterValues());
+    counter->GetValues(&values->back());
+  }
+  std::sort(values->begin(), values->end(), NameLess);
+}
+
+void PerfCounter::ResetAll() {
+  for (PerfCounter* counter = FirstCounter(); counter != NULL;
+       counter = counter->next_) {
+    counter->Reset();
+  }
+}
+
+PerfCounter::Shard* PerfCounter::CurrentShard() {
+  return &shards_[ShardIndex(::GetCurrentThreadId())];
+}
+
+std::string FormatPerfCounterValues(
+    const std::vector<PerfCounterValues>& values) {
+  std::string text =
+      base::StringPrintf("%-28s %12s %10s %12s %12s\n",
+                         "Counter", "Count", "Samples", "Mean (us)",
+                         "Total (ms)");
+  for (size_t i = 0; i < values.size(); ++i) {
+    const PerfCounterValues& value = values[i];
+    base::StringAppendF(&text, "%-28s %12lld %10lld %12.1f %12.1f\n",
+                        value.name.c_str(), value.count, value.samples,
+                        value.samples == 0 ? 0.0 :
+                            static_cast<double>(
+                                value.sample_time.InMicroseconds()) /
+                            value.samples,
+                        value.EstimatedTotalTime().InMillisecondsF());
+  }
+  return text;
+}
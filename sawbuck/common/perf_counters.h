@@ -0,0 +1,135 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Counters and sampled timers for sawbuck's own hot paths.
+#ifndef SAWBUCK_COMMON_PERF_COUNTERS_H_
+#define SAWBUCK_COMMON_PERF_COUNTERS_H_
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/time/time.h"
+
+// The values of a PerfCounter, summed over all threads.
+struct PerfCounterValues {
+  PerfCounterValues() : count(0), samples(0) {
+  }
+
+  // @returns the total duration of all counts, extrapolated from the
+  //    samples.
+  base::TimeDelta EstimatedTotalTime() const;
+
+  std::string name;
+  int64 count;
+  int64 samples;
+  base::TimeDelta sample_time;
+};
+
+// A named count of operations, along with the time taken by a sample of
+// them. Counters are meant to live at namespace scope, they register
+// themselves at construction and are never unregistered.
+//
+// Increments are lock-free. Each counter keeps a handful of shards, and
+// a thread adds to the shard picked by its thread id, so threads rarely
+// contend for the same cache line. Reading sums over the shards.
+class PerfCounter {
+ public:
+  // @param name the name the counter is reported under.
+  // @param sample_interval one in this many operations is timed, must be
+  //    a power of two. Reading the clock costs far more than the count,
+  //    so operations that are cheap and frequent want a large interval.
+  PerfCounter(const char* name, uint32 sample_interval);
+
+  // Counts an operation.
+  // @returns true iff the operation should be timed, and the time then
+  //    passed to AddSample.
+  bool Increment();
+
+  // Adds the time taken by a sampled operation.
+  void AddSample(base::TimeDelta time);
+
+  // Counts an operation that was timed elsewhere, such as a latency.
+  void AddTimed(base::TimeDelta time);
+
+  // @returns the counter's values.
+  void GetValues(PerfCounterValues* values) const;
+
+  // Zeroes the counter.
+  void Reset();
+
+  const char* name() const { return name_; }
+
+  // @returns the values of all registered counters, ordered by name.
+  static void GetAllValues(std::vector<PerfCounterValues>* values);
+
+  // Zeroes all registered counters.
+  static void ResetAll();
+
+  static const size_t kNumShards = 16;
+
+  // @returns the index of the shard the thread @p thread_id adds to.
+  //    Thread ids are multiples of four, so their low bits are dropped.
+  static size_t ShardIndex(DWORD thread_id) {
+    return (thread_id >> 2) % kNumShards;
+  }
+
+ private:
+
+  // A shard is padded out to a cache line of its own.
+  struct Shard {
+    volatile LONGLONG count;
+    volatile LONGLONG samples;
+    volatile LONGLONG sample_time_us;
+    char padding[64 - 3 * sizeof(LONGLONG)];
+  };
+
+  Shard* CurrentShard();
+
+  const char* name_;
+  const uint32 sample_interval_;
+  Shard shards_[kNumShards];
+
+  // The next registered counter.
+  PerfCounter* next_;
+
+  DISALLOW_COPY_AND_ASSIGN(PerfCounter);
+};
+
+// Counts the scope it lives in on a counter, and times it when the counter
+// picks it for a sample.
+class ScopedPerfTimer {
+ public:
+  explicit ScopedPerfTimer(PerfCounter* counter) : counter_(counter) {
+    if (counter_->Increment())
+      start_ = base::TimeTicks::HighResNow();
+  }
+
+  ~ScopedPerfTimer() {
+    if (!start_.is_null())
+      counter_->AddSample(base::TimeTicks::HighResNow() - start_);
+  }
+
+ private:
+  PerfCounter* counter_;
+  base::TimeTicks start_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedPerfTimer);
+};
+
+// Formats @p values as a table, one counter to a line.
+std::string FormatPerfCounterValues(
+    const std::vector<PerfCounterValues>& values);
+
+#endif  // SAWBUCK_COMMON_PERF_COUNTERS_H_
@@ -0,0 +1,133 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Perf counter unittests.
+#include "sawbuck/common/perf_counters.h"
+
+#include <set>
+#include "base/threading/simple_thread.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+PerfCounter every_op("Test.EveryOp", 1);
+PerfCounter every_fourth_op("Test.EveryFourthOp", 4);
+
+class PerfCountersTest: public testing::Test {
+ public:
+  virtual void SetUp() {
+    PerfCounter::ResetAll();
+  }
+};
+
+class Incrementer : public base::DelegateSimpleThread::Delegate {
+ public:
+  explicit Incrementer(int count) : count_(count) {
+  }
+
+  virtual void Run() {
+    for (int i = 0; i < count_; ++i)
+      ScopedPerfTimer timer(&every_fourth_op);
+  }
+
+ private:
+  int count_;
+};
+
+}  // namespace
+
+TEST_F(PerfCountersTest, SamplesOneInInterval) {
+  for (int i = 0; i < 100; ++i)
+    ScopedPerfTimer timer(&every_fourth_op);
+
+  PerfCounterValues values;
+  every_fourth_op.GetValues(&values);
+  EXPECT_EQ("Test.EveryFourthOp", values.name);
+  EXPECT_EQ(100, values.count);
+  EXPECT_EQ(25, values.samples);
+}
+
+TEST_F(PerfCountersTest, AddTimed) {
+  every_op.AddTimed(base::TimeDelta::FromMilliseconds(3));
+  every_op.AddTimed(base::TimeDelta::FromMilliseconds(5));
+
+  PerfCounterValues values;
+  every_op.GetValues(&values);
+  EXPECT_EQ(2, values.count);
+  EXPECT_EQ(2, values.samples);
+  EXPECT_EQ(8, values.sample_time.InMilliseconds());
+  EXPECT_EQ(8, values.EstimatedTotalTime().InMilliseconds());
+
+  every_op.Reset();
+  every_op.GetValues(&values);
+  EXPECT_EQ(0, values.count);
+  EXPECT_EQ(0, values.samples);
+}
+
+TEST_F(PerfCountersTest, ExtrapolatesTotal) {
+  // Two samples of 10 ms each, out of eight operations.
+  for (int i = 0; i < 8; ++i) {
+    if (every_fourth_op.Increment())
+      every_fourth_op.AddSample(base::TimeDelta::FromMilliseconds(10));
+  }
+
+  PerfCounterValues values;
+  every_fourth_op.GetValues(&values);
+  EXPECT_EQ(2, values.samples);
+  EXPECT_EQ(80, values.EstimatedTotalTime().InMilliseconds());
+}
+
+TEST_F(PerfCountersTest, CountsAcrossThreads) {
+  Incrementer incrementer(1000);
+  base::DelegateSimpleThread thread1(&incrementer, "Incrementer1");
+  base::DelegateSimpleThread thread2(&incrementer, "Incrementer2");
+  thread1.Start();
+  thread2.Start();
+  incrementer.Run();
+  thread1.Join();
+  thread2.Join();
+
+  PerfCounterValues values;
+  every_fourth_op.GetValues(&values);
+  EXPECT_EQ(3000, values.count);
+}
+
+TEST_F(PerfCountersTest, SpreadsAdjacentThreadsOverShards) {
+  // Thread ids go up by four, and a run of them covers all of the shards.
+  const DWORD kFirstThreadId = 0x1A2C;
+  std::set<size_t> shards;
+  for (DWORD i = 0; i < PerfCounter::kNumShards; ++i) {
+    DWORD thread_id = kFirstThreadId + 4 * i;
+    EXPECT_NE(PerfCounter::ShardIndex(thread_id),
+              PerfCounter::ShardIndex(thread_id + 4));
+    shards.insert(PerfCounter::ShardIndex(thread_id));
+  }
+  EXPECT_EQ(PerfCounter::kNumShards, shards.size());
+}
+
+TEST_F(PerfCountersTest, GetAllValues) {
+  every_op.AddTimed(base::TimeDelta::FromMilliseconds(1));
+
+  std::vector<PerfCounterValues> values;
+  PerfCounter::GetAllValues(&values);
+  ASSERT_EQ(2U, values.size());
+  EXPECT_EQ("Test.EveryFourthOp", values[0].name);
+  EXPECT_EQ(0, values[0].count);
+  EXPECT_EQ("Test.EveryOp", values[1].name);
+  EXPECT_EQ(1, values[1].count);
+
+  std::string text = FormatPerfCounterValues(values);
+  EXPECT_NE(std::string::npos, text.find("Test.EveryOp"));
+  EXPECT_NE(std::string::npos, text.find("Test.EveryFourthOp"));
+}
@@ -0,0 +1,181 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Record decoder declaration.
+//
+// A compile-time layer over BinaryBufferReader for records of a fixed
+// layout. The layout is declared once, as a list of field types, e.g. a
+// stack trace, a line number and two strings is
+//
+//   typedef RecordDecoder<CountedArray<void*>,
+//                         Field<DWORD>,
+//                         CString<char>,
+//                         CString<char> > LogMessageFullDecoder;
+//
+// and decoding makes a single bounds check for the minimum size of the
+// whole record. Fixed size fields are then taken with pointer arithmetic,
+// and each variable length field checks only its own excess, against the
+// minimum size of the fields after it.
+#ifndef SAWBUCK_COMMON_RECORD_DECODER_H_
+#define SAWBUCK_COMMON_RECORD_DECODER_H_
+
+#include <windows.h>
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "sawbuck/common/buffer_parser.h"
+
+// The field decoders all have the same shape. Each has a Value type, the
+// minimum size of the field, and a static Decode function.
+// @param data the record, @p data_len bytes long.
+// @param rest_size the minimum size of the fields after this one.
+// @param pos the field's byte position in @p data, advanced past the field
+//     on success. It's guaranteed that kMinSize + @p rest_size bytes remain
+//     from @p pos, and Decode must keep @p rest_size bytes remaining.
+// @param value on success receives the field.
+// @returns true on success, false if the field doesn't fit.
+
+// A fixed size field of type T.
+template <class T>
+struct Field {
+  typedef const T* Value;
+  static const size_t kMinSize = sizeof(T);
+
+  static bool Decode(const int8* data, size_t data_len, size_t rest_size,
+                     size_t* pos, Value* value) {
+    DCHECK_LE(*pos + kMinSize + rest_size, data_len);
+    *value = reinterpret_cast<const T*>(data + *pos);
+    *pos += kMinSize;
+    return true;
+  }
+};
+
+// A DWORD count followed by that many elements of type T.
+template <class T>
+struct CountedArray {
+  struct Value {
+    Value() : data(NULL), count(0) {
+    }
+
+    const T* data;
+    size_t count;
+  };
+  static const size_t kMinSize = sizeof(DWORD);
+
+  static bool Decode(const int8* data, size_t data_len, size_t rest_size,
+                     size_t* pos, Value* value) {
+    DCHECK_LE(*pos + kMinSize + rest_size, data_len);
+    size_t count = *reinterpret_cast<const DWORD*>(data + *pos);
+    size_t start = *pos + kMinSize;
+    // Divide rather than multiply, so a bogus count can't overflow.
+    if (count > (data_len - start - rest_size) / sizeof(T))
+      return false;
+
+    value->data = reinterpret_cast<const T*>(data + start);
+    value->count = count;
+    *pos = start + count * sizeof(T);
+    return true;
+  }
+};
+
+// A zero terminated string of CharType.
+template <class CharType>
+struct CString {
+  struct Value {
+    Value() : str(NULL), len(0) {
+    }
+
+    const CharType* str;
+    // The length in characters, excluding the terminator.
+    size_t len;
+  };
+  static const size_t kMinSize = sizeof(CharType);
+
+  static bool Decode(const int8* data, size_t data_len, size_t rest_size,
+                     size_t* pos, Value* value) {
+    DCHECK_LE(*pos + kMinSize + rest_size, data_len);
+    // The terminator must leave room for the rest of the record.
+    BinaryBufferParser parser(data, data_len - rest_size);
+    if (!parser.GetStringAt(*pos, &value->str, &value->len))
+      return false;
+
+    *pos += (value->len + 1) * sizeof(CharType);
+    return true;
+  }
+};
+
+// Stands in for the unused fields of shorter records.
+struct NoField {
+  struct Value {
+  };
+  static const size_t kMinSize = 0;
+
+  static bool Decode(const int8* data, size_t data_len, size_t rest_size,
+                     size_t* pos, Value* value) {
+    return true;
+  }
+};
+
+// Decodes records of up to five fields, F1 through F5.
+template <class F1,
+          class F2 = NoField,
+          class F3 = NoField,
+          class F4 = NoField,
+          class F5 = NoField>
+class RecordDecoder {
+ public:
+  // The minimum size of a record.
+  static const size_t kMinSize = F1::kMinSize + F2::kMinSize +
+      F3::kMinSize + F4::kMinSize + F5::kMinSize;
+
+  // Decodes a record at the read position of @p reader, and advances the
+  // read position past it on success.
+  // @param v1 through @p v5 receive the fields, and are only to be
+  //     trusted on success. The values of unused fields may be NULL.
+  // @returns true on success, false if the record doesn't fit in what
+  //     remains of the reader's buffer.
+  // @note Does not check the fields for appropriate alignment.
+  static bool Decode(BinaryBufferReader* reader,
+                     typename F1::Value* v1,
+                     typename F2::Value* v2 = NULL,
+                     typename F3::Value* v3 = NULL,
+                     typename F4::Value* v4 = NULL,
+                     typename F5::Value* v5 = NULL) {
+    DCHECK(reader != NULL);
+    size_t data_len = reader->RemainingBytes();
+    const int8* data = NULL;
+    if (data_len < kMinSize || !reader->Peek(data_len, &data))
+      return false;
+
+    // The minimum sizes of the fields after each field.
+    const size_t kRest4 = F5::kMinSize;
+    const size_t kRest3 = F4::kMinSize + kRest4;
+    const size_t kRest2 = F3::kMinSize + kRest3;
+    const size_t kRest1 = F2::kMinSize + kRest2;
+
+    size_t pos = 0;
+    if (!F1::Decode(data, data_len, kRest1, &pos, v1) ||
+        !F2::Decode(data, data_len, kRest2, &pos, v2) ||
+        !F3::Decode(data, data_len, kRest3, &pos, v3) ||
+        !F4::Decode(data, data_len, kRest4, &pos, v4) ||
+        !F5::Decode(data, data_len, 0, &pos, v5)) {
+      return false;
+    }
+
+    bool consumed = reader->Consume(pos);
+    DCHECK(consumed);
+    return consumed;
+  }
+};
+
+#endif  // SAWBUCK_COMMON_RECORD_DECODER_H_
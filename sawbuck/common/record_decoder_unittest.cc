@@ -0,0 +1,154 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Record decoder unittests.
+#include "sawbuck/common/record_decoder.h"
+
+#include <string.h>
+#include <vector>
+#include "gtest/gtest.h"
+
+namespace {
+
+typedef RecordDecoder<CountedArray<void*>,
+                      Field<DWORD>,
+                      CString<char>,
+                      CString<char> > FullDecoder;
+
+class RecordDecoderTest: public testing::Test {
+ public:
+  template <class T>
+  void Append(const T& value) {
+    const int8* bytes = reinterpret_cast<const int8*>(&value);
+    buffer_.insert(buffer_.end(), bytes, bytes + sizeof(value));
+  }
+
+  void AppendString(const char* str) {
+    buffer_.insert(buffer_.end(), str, str + strlen(str) + 1);
+  }
+
+  // Appends a full log message record.
+  void AppendFullRecord(DWORD depth, DWORD line, const char* file,
+                        const char* message) {
+    Append(depth);
+    for (DWORD i = 0; i < depth; ++i)
+      Append(reinterpret_cast<void*>(i + 1));
+    Append(line);
+    AppendString(file);
+    AppendString(message);
+  }
+
+ protected:
+  std::vector<int8> buffer_;
+};
+
+}  // namespace
+
+TEST_F(RecordDecoderTest, MinSize) {
+  size_t full_size = FullDecoder::kMinSize;
+  EXPECT_EQ(sizeof(DWORD) + sizeof(DWORD) + 2, full_size);
+  size_t wide_size = RecordDecoder<CString<wchar_t> >::kMinSize;
+  EXPECT_EQ(sizeof(wchar_t), wide_size);
+}
+
+TEST_F(RecordDecoderTest, DecodesFields) {
+  AppendFullRecord(3, 42, "file.cc", "A message");
+  AppendFullRecord(0, 7, "", "");
+
+  BinaryBufferReader reader(&buffer_[0], buffer_.size());
+  CountedArray<void*>::Value trace;
+  const DWORD* line = NULL;
+  CString<char>::Value file;
+  CString<char>::Value message;
+  ASSERT_TRUE(FullDecoder::Decode(&reader, &trace, &line, &file, &message));
+  ASSERT_EQ(3U, trace.count);
+  EXPECT_EQ(reinterpret_cast<void*>(1), trace.data[0]);
+  EXPECT_EQ(reinterpret_cast<void*>(3), trace.data[2]);
+  EXPECT_EQ(42, *line);
+  EXPECT_EQ("file.cc", std::string(file.str, file.len));
+  EXPECT_EQ("A message", std::string(message.str, message.len));
+
+  ASSERT_TRUE(FullDecoder::Decode(&reader, &trace, &line, &file, &message));
+  EXPECT_EQ(0U, trace.count);
+  EXPECT_EQ(7, *line);
+  EXPECT_EQ(0U, file.len);
+  EXPECT_EQ(0U, message.len);
+  EXPECT_EQ(0U, reader.RemainingBytes());
+
+  EXPECT_FALSE(FullDecoder::Decode(&reader, &trace, &line, &file, &message));
+}
+
+TEST_F(RecordDecoderTest, FailsOnTruncation) {
+  AppendFullRecord(2, 42, "file.cc", "A message");
+
+  // Every truncation fails, and leaves the read position alone.
+  for (size_t len = 0; len < buffer_.size(); ++len) {
+    BinaryBufferReader reader(&buffer_[0], len);
+    CountedArray<void*>::Value trace;
+    const DWORD* line = NULL;
+    CString<char>::Value file;
+    CString<char>::Value message;
+    EXPECT_FALSE(FullDecoder::Decode(&reader, &trace, &line, &file,
+                                     &message));
+    EXPECT_EQ(0U, reader.pos());
+  }
+}
+
+TEST_F(RecordDecoderTest, FailsOnBogusCount) {
+  Append(static_cast<DWORD>(0xFFFFFFFF));
+  Append(static_cast<DWORD>(42));
+  AppendString("file.cc");
+  AppendString("A message");
+
+  BinaryBufferReader reader(&buffer_[0], buffer_.size());
+  CountedArray<void*>::Value trace;
+  const DWORD* line = NULL;
+  CString<char>::Value file;
+  CString<char>::Value message;
+  EXPECT_FALSE(FullDecoder::Decode(&reader, &trace, &line, &file, &message));
+}
+
+TEST_F(RecordDecoderTest, StringsLeaveRoomForTheRest) {
+  // The first string would run to the end of the buffer, which leaves
+  // nothing for the field after it.
+  AppendString("name");
+  typedef RecordDecoder<CString<char>, Field<DWORD> > Decoder;
+  Append(static_cast<DWORD>(42));
+  buffer_.resize(buffer_.size() - 1);
+
+  CString<char>::Value name;
+  const DWORD* value = NULL;
+  BinaryBufferReader reader(&buffer_[0], buffer_.size());
+  EXPECT_FALSE(Decoder::Decode(&reader, &name, &value));
+
+  buffer_.push_back(0);
+  BinaryBufferReader whole_reader(&buffer_[0], buffer_.size());
+  ASSERT_TRUE(Decoder::Decode(&whole_reader, &name, &value));
+  EXPECT_EQ("name", std::string(name.str, name.len));
+  EXPECT_EQ(42, *value);
+}
+
+TEST_F(RecordDecoderTest, AdvancesReader) {
+  AppendString("name");
+  Append(static_cast<DWORD>(42));
+
+  BinaryBufferReader reader(&buffer_[0], buffer_.size());
+  CString<char>::Value name;
+  ASSERT_TRUE(RecordDecoder<CString<char> >::Decode(&reader, &name));
+  EXPECT_EQ(5U, reader.pos());
+
+  const DWORD* value = NULL;
+  ASSERT_TRUE(reader.Read(&value));
+  EXPECT_EQ(42, *value);
+}
@@ -0,0 +1,105 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// A bounded buffer that puts elements back in time order.
+#ifndef SAWBUCK_COMMON_REORDER_BUFFER_H_
+#define SAWBUCK_COMMON_REORDER_BUFFER_H_
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/time/time.h"
+
+// Holds elements pushed in about, but not quite, time order, and releases
+// them in time order once the caller knows no earlier element can still
+// arrive. Elements of equal time are released in the order pushed. Should
+// more than the capacity be held, the earliest are released regardless,
+// which bounds both the memory and the hold up of a stalled clock.
+//
+// Elements are swapped in and out, so T has to be default constructible
+// and swappable, and an element's storage travels with it.
+// @note this class is not thread safe.
+template <class T>
+class ReorderBuffer {
+ public:
+  explicit ReorderBuffer(size_t capacity);
+
+  // Takes the contents of @p element, stamped @p time, leaving it with
+  // whatever a default T holds.
+  void Push(const base::Time& time, T* element);
+
+  // Releases the earliest element to @p element, if it is stamped before
+  // @p time, or if we hold more than our capacity.
+  // @returns true iff an element was released.
+  bool PopBefore(const base::Time& time, T* element);
+
+  // Releases the earliest element to @p element, whatever its time.
+  // @returns true iff an element was released.
+  bool PopFront(T* element);
+
+  size_t size() const { return elements_.size(); }
+  bool empty() const { return elements_.empty(); }
+  size_t capacity() const { return capacity_; }
+
+ private:
+  // The elements keyed by time, then by push order.
+  typedef std::pair<base::Time, uint64> Key;
+  typedef std::map<Key, T> ElementMap;
+
+  const size_t capacity_;
+  uint64 next_sequence_;
+  ElementMap elements_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReorderBuffer);
+};
+
+template <class T>
+ReorderBuffer<T>::ReorderBuffer(size_t capacity)
+    : capacity_(capacity), next_sequence_(0) {
+  DCHECK_LT(0U, capacity);
+}
+
+template <class T>
+void ReorderBuffer<T>::Push(const base::Time& time, T* element) {
+  DCHECK(element != NULL);
+  using std::swap;
+  swap(elements_[Key(time, next_sequence_++)], *element);
+}
+
+template <class T>
+bool ReorderBuffer<T>::PopBefore(const base::Time& time, T* element) {
+  if (elements_.empty())
+    return false;
+  if (elements_.begin()->first.first >= time && elements_.size() <= capacity_)
+    return false;
+
+  return PopFront(element);
+}
+
+template <class T>
+bool ReorderBuffer<T>::PopFront(T* element) {
+  DCHECK(element != NULL);
+  if (elements_.empty())
+    return false;
+
+  using std::swap;
+  typename ElementMap::iterator it(elements_.begin());
+  swap(it->second, *element);
+  elements_.erase(it);
+  return true;
+}
+
+#endif  // SAWBUCK_COMMON_REORDER_BUFFER_H_
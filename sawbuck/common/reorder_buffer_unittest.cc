@@ -0,0 +1,88 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Reorder buffer unittests.
+#include "sawbuck/common/reorder_buffer.h"
+
+#include <string>
+#include "gtest/gtest.h"
+
+namespace {
+
+class ReorderBufferTest: public testing::Test {
+ public:
+  ReorderBufferTest() : kT0(base::Time::Now()) {
+  }
+
+  base::Time Ms(int ms) {
+    return kT0 + base::TimeDelta::FromMilliseconds(ms);
+  }
+
+  void Push(ReorderBuffer<std::string>* buffer, int ms, const char* text) {
+    std::string element(text);
+    buffer->Push(Ms(ms), &element);
+    EXPECT_TRUE(element.empty());
+  }
+
+ protected:
+  const base::Time kT0;
+};
+
+}  // namespace
+
+TEST_F(ReorderBufferTest, ReleasesInTimeOrder) {
+  ReorderBuffer<std::string> buffer(16);
+  EXPECT_TRUE(buffer.empty());
+
+  Push(&buffer, 20, "c");
+  Push(&buffer, 10, "a");
+  Push(&buffer, 30, "d");
+  Push(&buffer, 10, "b");
+  EXPECT_EQ(4U, buffer.size());
+
+  // Only the elements stamped before the time are released.
+  std::string element;
+  ASSERT_TRUE(buffer.PopBefore(Ms(25), &element));
+  EXPECT_EQ("a", element);
+  ASSERT_TRUE(buffer.PopBefore(Ms(25), &element));
+  EXPECT_EQ("b", element);
+  ASSERT_TRUE(buffer.PopBefore(Ms(25), &element));
+  EXPECT_EQ("c", element);
+  EXPECT_FALSE(buffer.PopBefore(Ms(25), &element));
+  EXPECT_FALSE(buffer.PopBefore(Ms(30), &element));
+
+  // A late element still goes out ahead of the rest.
+  Push(&buffer, 5, "late");
+  ASSERT_TRUE(buffer.PopBefore(Ms(25), &element));
+  EXPECT_EQ("late", element);
+
+  ASSERT_TRUE(buffer.PopFront(&element));
+  EXPECT_EQ("d", element);
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_FALSE(buffer.PopFront(&element));
+}
+
+TEST_F(ReorderBufferTest, ReleasesPastCapacity) {
+  ReorderBuffer<std::string> buffer(2);
+  Push(&buffer, 30, "c");
+  Push(&buffer, 10, "a");
+  Push(&buffer, 20, "b");
+
+  // Over capacity, the earliest goes regardless of the time.
+  std::string element;
+  ASSERT_TRUE(buffer.PopBefore(Ms(0), &element));
+  EXPECT_EQ("a", element);
+  EXPECT_FALSE(buffer.PopBefore(Ms(0), &element));
+  EXPECT_EQ(2U, buffer.size());
+}
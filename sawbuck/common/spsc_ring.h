@@ -0,0 +1,112 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// A lock-free single producer, single consumer ring buffer.
+#ifndef SAWBUCK_COMMON_SPSC_RING_H_
+#define SAWBUCK_COMMON_SPSC_RING_H_
+
+#include <vector>
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/logging.h"
+
+// A fixed capacity ring of T, which can be written by one thread and read
+// by another without locking. Elements are constructed once, up front, and
+// are filled and read in place, so that an element can reuse storage
+// it acquired on an earlier trip around the ring.
+//
+// The producer fills an element by calling BeginPush, then publishes it to
+// the consumer with EndPush. The consumer reads the element returned by
+// Front, then hands it back to the producer with Pop.
+template <class T>
+class SpscRing {
+ public:
+  // @param capacity the number of elements in the ring, must be a power
+  //    of two.
+  explicit SpscRing(size_t capacity);
+
+  // Producer side.
+  // @{
+  // @returns the element to fill in, or NULL if the ring is full.
+  T* BeginPush();
+  // Publishes the element returned by the last BeginPush.
+  void EndPush();
+  // @}
+
+  // Consumer side.
+  // @{
+  // @returns the oldest published element, or NULL if the ring is empty.
+  T* Front();
+  // Releases the element returned by Front.
+  void Pop();
+  // @}
+
+  size_t capacity() const { return elements_.size(); }
+
+ private:
+  // The positions are free-running counters, masked to index elements_.
+  // The producer owns tail_ and the consumer owns head_, each only reads
+  // the other's position.
+  typedef base::subtle::Atomic32 Position;
+
+  std::vector<T> elements_;
+  Position head_;
+  Position tail_;
+
+  DISALLOW_COPY_AND_ASSIGN(SpscRing);
+};
+
+template <class T>
+SpscRing<T>::SpscRing(size_t capacity)
+    : elements_(capacity), head_(0), tail_(0) {
+  DCHECK(capacity != 0 && (capacity & (capacity - 1)) == 0);
+  DCHECK_LE(capacity, 1U << 30);
+}
+
+template <class T>
+T* SpscRing<T>::BeginPush() {
+  uint32 tail = base::subtle::NoBarrier_Load(&tail_);
+  uint32 head = base::subtle::Acquire_Load(&head_);
+  if (tail - head == elements_.size())
+    return NULL;
+
+  return &elements_[tail & (elements_.size() - 1)];
+}
+
+template <class T>
+void SpscRing<T>::EndPush() {
+  uint32 tail = base::subtle::NoBarrier_Load(&tail_);
+  DCHECK_LT(tail - static_cast<uint32>(base::subtle::Acquire_Load(&head_)),
+            elements_.size());
+  base::subtle::Release_Store(&tail_, static_cast<Position>(tail + 1));
+}
+
+template <class T>
+T* SpscRing<T>::Front() {
+  uint32 head = base::subtle::NoBarrier_Load(&head_);
+  uint32 tail = base::subtle::Acquire_Load(&tail_);
+  if (head == tail)
+    return NULL;
+
+  return &elements_[head & (elements_.size() - 1)];
+}
+
+template <class T>
+void SpscRing<T>::Pop() {
+  uint32 head = base::subtle::NoBarrier_Load(&head_);
+  DCHECK_NE(head, static_cast<uint32>(base::subtle::Acquire_Load(&tail_)));
+  base::subtle::Release_Store(&head_, static_cast<Position>(head + 1));
+}
+
+#endif  // SAWBUCK_COMMON_SPSC_RING_H_
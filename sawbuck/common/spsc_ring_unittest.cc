@@ -0,0 +1,114 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/common/spsc_ring.h"
+
+#include <string>
+#include "base/threading/platform_thread.h"
+#include "base/threading/simple_thread.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(SpscRingTest, Empty) {
+  SpscRing<int> ring(4);
+
+  EXPECT_EQ(4, ring.capacity());
+  EXPECT_TRUE(ring.Front() == NULL);
+}
+
+TEST(SpscRingTest, PushAndPop) {
+  SpscRing<int> ring(4);
+
+  // Go around the ring a few times, filling it up each time.
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 4; ++i) {
+      int* element = ring.BeginPush();
+      ASSERT_TRUE(element != NULL);
+      *element = round * 10 + i;
+      ring.EndPush();
+    }
+
+    EXPECT_TRUE(ring.BeginPush() == NULL);
+
+    for (int i = 0; i < 4; ++i) {
+      int* element = ring.Front();
+      ASSERT_TRUE(element != NULL);
+      EXPECT_EQ(round * 10 + i, *element);
+      ring.Pop();
+    }
+
+    EXPECT_TRUE(ring.Front() == NULL);
+  }
+}
+
+TEST(SpscRingTest, ElementsAreReused) {
+  SpscRing<std::string> ring(2);
+
+  std::string* element = ring.BeginPush();
+  element->assign(100, 'x');
+  ring.EndPush();
+  ring.Pop();
+
+  ring.BeginPush();
+  ring.EndPush();
+  ring.Pop();
+
+  // We're back at the first element, which keeps its contents.
+  element = ring.BeginPush();
+  EXPECT_EQ(std::string(100, 'x'), *element);
+}
+
+class Producer : public base::DelegateSimpleThread::Delegate {
+ public:
+  Producer(SpscRing<int>* ring, int count) : ring_(ring), count_(count) {
+  }
+
+  virtual void Run() {
+    for (int i = 0; i < count_; ++i) {
+      int* element = NULL;
+      while ((element = ring_->BeginPush()) == NULL)
+        base::PlatformThread::YieldCurrentThread();
+
+      *element = i;
+      ring_->EndPush();
+    }
+  }
+
+ private:
+  SpscRing<int>* ring_;
+  int count_;
+};
+
+TEST(SpscRingTest, CrossThread) {
+  const int kCount = 100000;
+  SpscRing<int> ring(64);
+  Producer producer(&ring, kCount);
+  base::DelegateSimpleThread thread(&producer, "Producer");
+  thread.Start();
+
+  // The elements must come out in order on this thread.
+  for (int i = 0; i < kCount; ++i) {
+    int* element = NULL;
+    while ((element = ring.Front()) == NULL)
+      base::PlatformThread::YieldCurrentThread();
+
+    ASSERT_EQ(i, *element);
+    ring.Pop();
+  }
+
+  thread.Join();
+  EXPECT_TRUE(ring.Front() == NULL);
+}
+
+}  // namespace
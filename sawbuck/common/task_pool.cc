@@ -0,0 +1,330 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Task pool implementation.
+#include "sawbuck/common/task_pool.h"
+
+#include <algorithm>
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/sys_info.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/simple_thread.h"
+#include "sawbuck/common/perf_counters.h"
+
+namespace {
+
+// The shared pool. It's created, and its workers started, on first use, so
+// it costs nothing to the processes that don't use it. It's leaked, as
+// there may be tasks in flight at exit, and joining the workers then
+// would only slow the exit down.
+base::LazyInstance<TaskPool>::Leaky shared_task_pool =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+class TaskPool::Worker : public base::DelegateSimpleThread::Delegate {
+ public:
+  Worker(TaskPool* pool, size_t index)
+      : pool_(pool), index_(index), thread_(this, "Task pool worker") {
+  }
+
+  void Start() {
+    thread_.Start();
+  }
+
+  void Join() {
+    thread_.Join();
+  }
+
+  // DelegateSimpleThread::Delegate implementation.
+  virtual void Run() {
+    pool_->WorkerMain(this);
+  }
+
+  size_t index() const { return index_; }
+
+  base::Lock lock_;
+  TaskQueue tasks_[NUM_PRIORITIES];  // Under lock_.
+
+ private:
+  TaskPool* pool_;
+  size_t index_;
+  base::DelegateSimpleThread thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(Worker);
+};
+
+TaskPool::Stats::Stats() : tasks_stolen(0) {
+  for (size_t i = 0; i < NUM_PRIORITIES; ++i) {
+    tasks_run[i] = 0;
+    tasks_cancelled[i] = 0;
+  }
+}
+
+TaskPool::TaskPool(size_t num_workers)
+    : num_workers_(num_workers != 0 ? num_workers :
+          std::max(1, base::SysInfo::NumberOfProcessors() - 1)),
+      work_available_(&lock_),
+      pending_(0),
+      next_worker_(0),
+      stopping_(false) {
+}
+
+TaskPool::~TaskPool() {
+  {
+    base::AutoLock lock(lock_);
+    DCHECK_EQ(0U, pending_);
+    stopping_ = true;
+    work_available_.Broadcast();
+  }
+
+  for (size_t i = 0; i < workers_.size(); ++i)
+    workers_[i]->Join();
+}
+
+TaskPool* TaskPool::Get() {
+  return shared_task_pool.Pointer();
+}
+
+void TaskPool::GetStats(Stats* stats) const {
+  DCHECK(stats != NULL);
+  base::AutoLock lock(lock_);
+  *stats = stats_;
+}
+
+void TaskPool::Post(TaskGroup* group, const base::Closure& closure) {
+  DCHECK(group != NULL);
+
+  // A worker keeps what it posts, the others deal their tasks out.
+  Worker* worker = current_worker_.Get();
+  Task task = { group, closure };
+
+  // The task is counted as it's queued, so that it's never taken before
+  // it's counted.
+  base::AutoLock lock(lock_);
+  if (workers_.empty())
+    StartWorkers();
+  if (worker == NULL)
+    worker = workers_[next_worker_++ % workers_.size()];
+  {
+    base::AutoLock worker_lock(worker->lock_);
+    worker->tasks_[group->priority()].push_back(task);
+  }
+  ++pending_;
+  work_available_.Signal();
+}
+
+bool TaskPool::TakeTask(Worker* worker, Task* task) {
+  DCHECK(worker != NULL);
+  DCHECK(task != NULL);
+
+  bool found = false;
+  bool stolen = false;
+  for (size_t priority = 0; priority < NUM_PRIORITIES && !found;
+       ++priority) {
+    {
+      base::AutoLock lock(worker->lock_);
+      TaskQueue& tasks = worker->tasks_[priority];
+      if (!tasks.empty()) {
+        *task = tasks.back();
+        tasks.pop_back();
+        found = true;
+        break;
+      }
+    }
+
+    // Steal from the others in turn, starting past ourselves, so that the
+    // thieves spread over the victims.
+    for (size_t i = 1; i < workers_.size(); ++i) {
+      Worker* victim = workers_[(worker->index() + i) % workers_.size()];
+      base::AutoLock lock(victim->lock_);
+      TaskQueue& tasks = victim->tasks_[priority];
+      if (!tasks.empty()) {
+        *task = tasks.front();
+        tasks.pop_front();
+        found = true;
+        stolen = true;
+        break;
+      }
+    }
+  }
+  if (!found)
+    return false;
+
+  base::AutoLock lock(lock_);
+  DCHECK_NE(0U, pending_);
+  --pending_;
+  if (stolen)
+    ++stats_.tasks_stolen;
+  return true;
+}
+
+bool TaskPool::TakeGroupTask(TaskGroup* group, Task* task) {
+  DCHECK(group != NULL);
+  DCHECK(task != NULL);
+
+  bool found = false;
+  for (size_t i = 0; i < workers_.size() && !found; ++i) {
+    base::AutoLock lock(workers_[i]->lock_);
+    TaskQueue& tasks = workers_[i]->tasks_[group->priority()];
+    TaskQueue::iterator it(tasks.begin());
+    for (; it != tasks.end(); ++it) {
+      if (it->group == group) {
+        *task = *it;
+        tasks.erase(it);
+        found = true;
+        break;
+      }
+    }
+  }
+  if (!found)
+    return false;
+
+  base::AutoLock lock(lock_);
+  DCHECK_NE(0U, pending_);
+  --pending_;
+  return true;
+}
+
+void TaskPool::RunTask(Task* task) {
+  DCHECK(task != NULL);
+  TaskGroup* group = task->group;
+
+  base::TimeDelta run_time;
+  bool cancelled = group->IsCancelled();
+  if (!cancelled) {
+    base::TimeTicks start(base::TimeTicks::HighResNow());
+    task->closure.Run();
+    run_time = base::TimeTicks::HighResNow() - start;
+  }
+  // Release what the task holds before the group can go away.
+  task->closure.Reset();
+
+  {
+    base::AutoLock lock(lock_);
+    if (cancelled) {
+      ++stats_.tasks_cancelled[group->priority()];
+    } else {
+      ++stats_.tasks_run[group->priority()];
+      stats_.run_time[group->priority()] += run_time;
+    }
+  }
+
+  // The group may be destroyed as soon as it's told.
+  group->OnTaskDone(cancelled, run_time);
+}
+
+void TaskPool::WorkerMain(Worker* worker) {
+  current_worker_.Set(worker);
+
+  while (true) {
+    {
+      base::AutoLock lock(lock_);
+      while (pending_ == 0 && !stopping_)
+        work_available_.Wait();
+      if (pending_ == 0)
+        return;
+    }
+
+    // Another thread may take the task we were woken for before we find
+    // it, in which case we go around again.
+    Task task;
+    if (TakeTask(worker, &task))
+      RunTask(&task);
+    else
+      base::PlatformThread::YieldCurrentThread();
+  }
+}
+
+void TaskPool::StartWorkers() {
+  lock_.AssertAcquired();
+  DCHECK(workers_.empty());
+
+  for (size_t i = 0; i < num_workers_; ++i)
+    workers_.push_back(new Worker(this, i));
+  for (size_t i = 0; i < workers_.size(); ++i)
+    workers_[i]->Start();
+}
+
+TaskPool::TaskGroup::TaskGroup(TaskPool* pool,
+                               Priority priority,
+                               PerfCounter* cost_counter)
+    : pool_(pool),
+      priority_(priority),
+      cost_counter_(cost_counter),
+      cancelled_(0),
+      done_(&lock_),
+      outstanding_(0) {
+  DCHECK(pool_ != NULL);
+  DCHECK_LT(priority_, NUM_PRIORITIES);
+}
+
+TaskPool::TaskGroup::~TaskGroup() {
+  Cancel();
+  Wait();
+}
+
+void TaskPool::TaskGroup::Post(const base::Closure& task) {
+  {
+    base::AutoLock lock(lock_);
+    ++outstanding_;
+  }
+  pool_->Post(this, task);
+}
+
+void TaskPool::TaskGroup::Cancel() {
+  base::subtle::Release_Store(&cancelled_, 1);
+}
+
+bool TaskPool::TaskGroup::IsCancelled() const {
+  return base::subtle::Acquire_Load(&cancelled_) != 0;
+}
+
+void TaskPool::TaskGroup::Wait() {
+  while (true) {
+    {
+      base::AutoLock lock(lock_);
+      if (outstanding_ == 0)
+        return;
+    }
+
+    Task task;
+    if (!pool_->TakeGroupTask(this, &task))
+      break;
+    pool_->RunTask(&task);
+  }
+
+  // The rest are running.
+  base::AutoLock lock(lock_);
+  while (outstanding_ != 0)
+    done_.Wait();
+}
+
+base::TimeDelta TaskPool::TaskGroup::cost() const {
+  base::AutoLock lock(lock_);
+  return cost_;
+}
+
+void TaskPool::TaskGroup::OnTaskDone(bool cancelled,
+                                     base::TimeDelta run_time) {
+  if (cost_counter_ != NULL && !cancelled)
+    cost_counter_->AddTimed(run_time);
+
+  base::AutoLock lock(lock_);
+  DCHECK_NE(0U, outstanding_);
+  cost_ += run_time;
+  if (--outstanding_ == 0)
+    done_.Broadcast();
+}
@@ -0,0 +1,184 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Task pool declaration.
+#ifndef SAWBUCK_COMMON_TASK_POOL_H_
+#define SAWBUCK_COMMON_TASK_POOL_H_
+
+#include <deque>
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/memory/scoped_vector.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread_local.h"
+#include "base/time/time.h"
+
+class PerfCounter;
+
+// A pool of worker threads for sawbuck's background work, shared so that
+// the work scales across the cores without each client starting threads
+// of its own and oversubscribing them.
+//
+// Tasks are posted through a TaskGroup, which gives them their priority,
+// and can cancel them and wait for them together. Each worker keeps a
+// queue per priority. A worker takes the newest task of its own queues,
+// where the tasks it posts itself go, and failing that steals the oldest
+// task of another worker's, always going for the highest priority first.
+// Tasks posted from other threads are dealt out to the workers in turn.
+class TaskPool {
+ public:
+  // The priority classes, from the most urgent down.
+  enum Priority {
+    // Work the user is waiting on, e.g. a find.
+    PRIORITY_INTERACTIVE,
+    // Work that backs what's on screen, e.g. filtering new rows.
+    PRIORITY_VISIBLE,
+    // Work that may come in handy later, e.g. prefetching symbols.
+    PRIORITY_BACKGROUND,
+    NUM_PRIORITIES,
+  };
+
+  // The tallies of the tasks the pool has seen, by priority.
+  struct Stats {
+    Stats();
+
+    int64 tasks_run[NUM_PRIORITIES];
+    // The tasks skipped as their group had been cancelled.
+    int64 tasks_cancelled[NUM_PRIORITIES];
+    base::TimeDelta run_time[NUM_PRIORITIES];
+    // The tasks a worker took from another worker's queues.
+    int64 tasks_stolen;
+  };
+
+  class TaskGroup;
+
+  // @param num_workers the number of worker threads, or zero for one
+  //     fewer than there are processors, as the threads waiting on the
+  //     tasks help run them. The workers are started on the first post.
+  explicit TaskPool(size_t num_workers = 0);
+  // @pre no group has tasks outstanding.
+  ~TaskPool();
+
+  // @returns the pool shared by the whole process.
+  static TaskPool* Get();
+
+  size_t num_workers() const { return num_workers_; }
+
+  // Retrieves the tallies so far to @p stats.
+  void GetStats(Stats* stats) const;
+
+ private:
+  struct Task {
+    TaskGroup* group;
+    base::Closure closure;
+  };
+  typedef std::deque<Task> TaskQueue;
+  class Worker;
+
+  // Queues @p closure for @p group.
+  void Post(TaskGroup* group, const base::Closure& closure);
+
+  // Takes the next task for @p worker to run to @p task, from its own
+  // queues or another worker's.
+  // @returns true iff there was one.
+  bool TakeTask(Worker* worker, Task* task);
+  // Takes the oldest queued task of @p group to @p task, for a thread
+  // waiting on the group to run.
+  // @returns true iff there was one.
+  bool TakeGroupTask(TaskGroup* group, Task* task);
+  // Runs @p task, unless its group has been cancelled, and accounts it.
+  void RunTask(Task* task);
+
+  // The main loop of @p worker's thread.
+  void WorkerMain(Worker* worker);
+  // @pre lock_ is held.
+  void StartWorkers();
+
+  const size_t num_workers_;
+
+  // The workers, which are all created before any is started, and are
+  // then left be until the pool is destroyed.
+  ScopedVector<Worker> workers_;
+
+  // The worker running on the current thread, if any.
+  base::ThreadLocalPointer<Worker> current_worker_;
+
+  // Taken before a worker's lock when both are held, never after.
+  mutable base::Lock lock_;
+  // Signaled when a task is queued, or the workers are to stop.
+  base::ConditionVariable work_available_;  // Under lock_.
+  // The number of tasks in the worker queues.
+  size_t pending_;  // Under lock_.
+  // The worker the next task from outside the pool goes to.
+  size_t next_worker_;  // Under lock_.
+  bool stopping_;  // Under lock_.
+  Stats stats_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(TaskPool);
+};
+
+// A set of tasks of a priority, which can be cancelled, waited for, and
+// costed together. A thread waiting on a group runs its queued tasks
+// rather than block on them.
+// @note a group cancels and waits for its tasks on destruction, so the
+//     state they use may safely go with it.
+class TaskPool::TaskGroup {
+ public:
+  // @param cost_counter if not NULL, is charged with the run time of each
+  //     task of the group.
+  TaskGroup(TaskPool* pool, Priority priority, PerfCounter* cost_counter);
+  ~TaskGroup();
+
+  // Queues @p task on the pool.
+  void Post(const base::Closure& task);
+
+  // Skips the tasks not yet started. Long running tasks poll IsCancelled
+  // to stop early.
+  void Cancel();
+  bool IsCancelled() const;
+
+  // Waits for the posted tasks to be run or skipped, running them on the
+  // calling thread while they're queued.
+  void Wait();
+
+  // @returns the total run time of the tasks run so far.
+  base::TimeDelta cost() const;
+
+  Priority priority() const { return priority_; }
+
+ private:
+  friend class TaskPool;
+
+  // Accounts a task that took @p run_time, or was skipped if @p cancelled,
+  // and wakes the waiters if it was the last one outstanding.
+  void OnTaskDone(bool cancelled, base::TimeDelta run_time);
+
+  TaskPool* pool_;
+  const Priority priority_;
+  PerfCounter* cost_counter_;
+
+  base::subtle::Atomic32 cancelled_;
+
+  mutable base::Lock lock_;
+  // Signaled when the last outstanding task is done.
+  base::ConditionVariable done_;  // Under lock_.
+  size_t outstanding_;  // Under lock_.
+  base::TimeDelta cost_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(TaskGroup);
+};
+
+#endif  // SAWBUCK_COMMON_TASK_POOL_H_
@@ -0,0 +1,218 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Task pool unittests.
+#include "sawbuck/common/task_pool.h"
+
+#include <vector>
+#include "base/bind.h"
+#include "base/synchronization/waitable_event.h"
+#include "sawbuck/common/perf_counters.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+PerfCounter task_cost("Test.TaskCost", 1);
+
+void Increment(base::Lock* lock, int* count) {
+  base::AutoLock auto_lock(*lock);
+  ++*count;
+}
+
+void Record(base::Lock* lock, std::vector<int>* order, int value) {
+  base::AutoLock auto_lock(*lock);
+  order->push_back(value);
+}
+
+void RecordAndSignal(base::Lock* lock,
+                     std::vector<int>* order,
+                     int value,
+                     base::WaitableEvent* done) {
+  Record(lock, order, value);
+  done->Signal();
+}
+
+void Block(base::WaitableEvent* started, base::WaitableEvent* release) {
+  started->Signal();
+  release->Wait();
+}
+
+// Posts @p count increments from a pool task, and waits for them.
+void Fork(TaskPool* pool, base::Lock* lock, int* count, int num_tasks) {
+  TaskPool::TaskGroup group(pool, TaskPool::PRIORITY_VISIBLE, NULL);
+  for (int i = 0; i < num_tasks; ++i)
+    group.Post(base::Bind(&Increment, lock, count));
+  group.Wait();
+}
+
+}  // namespace
+
+TEST(TaskPoolTest, RunsTasks) {
+  TaskPool pool(4);
+  EXPECT_EQ(4U, pool.num_workers());
+
+  base::Lock lock;
+  int count = 0;
+  {
+    TaskPool::TaskGroup group(&pool, TaskPool::PRIORITY_VISIBLE, NULL);
+    for (int i = 0; i < 1000; ++i)
+      group.Post(base::Bind(&Increment, &lock, &count));
+    group.Wait();
+    EXPECT_EQ(1000, count);
+  }
+
+  TaskPool::Stats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(1000, stats.tasks_run[TaskPool::PRIORITY_VISIBLE]);
+  EXPECT_EQ(0, stats.tasks_cancelled[TaskPool::PRIORITY_VISIBLE]);
+  EXPECT_EQ(0, stats.tasks_run[TaskPool::PRIORITY_INTERACTIVE]);
+}
+
+TEST(TaskPoolTest, NestedGroups) {
+  TaskPool pool(2);
+
+  // The workers wait on the groups their tasks post, and run their tasks
+  // in the meantime.
+  base::Lock lock;
+  int count = 0;
+  TaskPool::TaskGroup group(&pool, TaskPool::PRIORITY_VISIBLE, NULL);
+  for (int i = 0; i < 10; ++i)
+    group.Post(base::Bind(&Fork, &pool, &lock, &count, 100));
+  group.Wait();
+  EXPECT_EQ(1000, count);
+}
+
+TEST(TaskPoolTest, Cancel) {
+  TaskPool pool(1);
+
+  // Hold up the only worker.
+  base::WaitableEvent started(false, false);
+  base::WaitableEvent release(false, false);
+  TaskPool::TaskGroup blocker(&pool, TaskPool::PRIORITY_INTERACTIVE, NULL);
+  blocker.Post(base::Bind(&Block, &started, &release));
+  started.Wait();
+
+  base::Lock lock;
+  int count = 0;
+  {
+    TaskPool::TaskGroup group(&pool, TaskPool::PRIORITY_BACKGROUND, NULL);
+    for (int i = 0; i < 10; ++i)
+      group.Post(base::Bind(&Increment, &lock, &count));
+    EXPECT_FALSE(group.IsCancelled());
+    group.Cancel();
+    EXPECT_TRUE(group.IsCancelled());
+    group.Wait();
+  }
+  EXPECT_EQ(0, count);
+
+  release.Signal();
+  blocker.Wait();
+
+  TaskPool::Stats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(10, stats.tasks_cancelled[TaskPool::PRIORITY_BACKGROUND]);
+  EXPECT_EQ(0, stats.tasks_run[TaskPool::PRIORITY_BACKGROUND]);
+  EXPECT_EQ(1, stats.tasks_run[TaskPool::PRIORITY_INTERACTIVE]);
+}
+
+TEST(TaskPoolTest, RunsHigherPrioritiesFirst) {
+  TaskPool pool(1);
+
+  base::WaitableEvent started(false, false);
+  base::WaitableEvent release(false, false);
+  TaskPool::TaskGroup blocker(&pool, TaskPool::PRIORITY_INTERACTIVE, NULL);
+  blocker.Post(base::Bind(&Block, &started, &release));
+  started.Wait();
+
+  // Queue the priorities from the bottom up while the worker's busy.
+  base::Lock lock;
+  std::vector<int> order;
+  TaskPool::TaskGroup background(&pool, TaskPool::PRIORITY_BACKGROUND, NULL);
+  TaskPool::TaskGroup visible(&pool, TaskPool::PRIORITY_VISIBLE, NULL);
+  TaskPool::TaskGroup interactive(&pool, TaskPool::PRIORITY_INTERACTIVE,
+                                  NULL);
+  base::WaitableEvent done(false, false);
+  background.Post(base::Bind(&RecordAndSignal, &lock, &order,
+                             TaskPool::PRIORITY_BACKGROUND, &done));
+  visible.Post(base::Bind(&Record, &lock, &order,
+                          TaskPool::PRIORITY_VISIBLE));
+  interactive.Post(base::Bind(&Record, &lock, &order,
+                              TaskPool::PRIORITY_INTERACTIVE));
+
+  // Waiting on the groups would run their tasks here, so wait on the
+  // last task to run on the worker instead.
+  release.Signal();
+  done.Wait();
+
+  ASSERT_EQ(3U, order.size());
+  EXPECT_EQ(TaskPool::PRIORITY_INTERACTIVE, order[0]);
+  EXPECT_EQ(TaskPool::PRIORITY_VISIBLE, order[1]);
+  EXPECT_EQ(TaskPool::PRIORITY_BACKGROUND, order[2]);
+}
+
+TEST(TaskPoolTest, WaitRunsQueuedTasks) {
+  TaskPool pool(1);
+
+  base::WaitableEvent started(false, false);
+  base::WaitableEvent release(false, false);
+  TaskPool::TaskGroup blocker(&pool, TaskPool::PRIORITY_INTERACTIVE, NULL);
+  blocker.Post(base::Bind(&Block, &started, &release));
+  started.Wait();
+
+  // With the worker held up, the waiting thread runs the tasks itself.
+  base::Lock lock;
+  int count = 0;
+  TaskPool::TaskGroup group(&pool, TaskPool::PRIORITY_VISIBLE, &task_cost);
+  for (int i = 0; i < 10; ++i)
+    group.Post(base::Bind(&Increment, &lock, &count));
+  group.Wait();
+  EXPECT_EQ(10, count);
+
+  release.Signal();
+}
+
+TEST(TaskPoolTest, AccountsCost) {
+  task_cost.Reset();
+  TaskPool pool(2);
+
+  base::WaitableEvent started(false, false);
+  base::WaitableEvent release(true, true);
+  TaskPool::TaskGroup group(&pool, TaskPool::PRIORITY_VISIBLE, &task_cost);
+  for (int i = 0; i < 5; ++i)
+    group.Post(base::Bind(&Block, &started, &release));
+  group.Wait();
+
+  PerfCounterValues values;
+  task_cost.GetValues(&values);
+  EXPECT_EQ(5, values.count);
+  EXPECT_EQ(values.sample_time, group.cost());
+
+  TaskPool::Stats stats;
+  pool.GetStats(&stats);
+  EXPECT_EQ(group.cost(), stats.run_time[TaskPool::PRIORITY_VISIBLE]);
+}
+
+TEST(TaskPoolTest, SharedPool) {
+  TaskPool* pool = TaskPool::Get();
+  ASSERT_TRUE(pool != NULL);
+  EXPECT_EQ(pool, TaskPool::Get());
+  EXPECT_LE(1U, pool->num_workers());
+
+  base::Lock lock;
+  int count = 0;
+  TaskPool::TaskGroup group(pool, TaskPool::PRIORITY_BACKGROUND, NULL);
+  group.Post(base::Bind(&Increment, &lock, &count));
+  group.Wait();
+  EXPECT_EQ(1, count);
+}
@@ -0,0 +1,195 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// UTF-8 transcoder implementation.
+#include "sawbuck/common/utf8_transcoder.h"
+
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/strings/utf_string_conversions.h"
+#include "build/build_config.h"
+
+#if defined(ARCH_CPU_X86_FAMILY)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// @returns true iff @p c is a continuation byte.
+bool IsTrail(uint8 c) {
+  return (c & 0xC0) == 0x80;
+}
+
+// @returns true iff base::UTF8ToWide passes @p code_point through, rather
+//     than replacing it, which it does for the surrogates and the
+//     non-characters.
+bool IsValidCodePoint(uint32 code_point) {
+  return code_point < 0xD800 ||
+      (code_point >= 0xE000 && code_point < 0xFDD0) ||
+      (code_point > 0xFDEF && code_point <= 0x10FFFF &&
+       (code_point & 0xFFFE) != 0xFFFE);
+}
+
+// Decodes the multi-byte sequence at the start of the @p length bytes at
+// @p text to @p code_point, and its length to @p sequence_length.
+// @returns false if the sequence is ill-formed, overlong, or encodes a
+//     code point base::UTF8ToWide would replace.
+bool DecodeSequence(const uint8* text,
+                    size_t length,
+                    uint32* code_point,
+                    size_t* sequence_length) {
+  DCHECK_LT(0U, length);
+  uint8 lead = text[0];
+  size_t trail_bytes = 0;
+  uint32 value = 0;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    trail_bytes = 1;
+    value = lead & 0x1F;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    trail_bytes = 2;
+    value = lead & 0x0F;
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    trail_bytes = 3;
+    value = lead & 0x07;
+  } else {
+    return false;
+  }
+  if (trail_bytes >= length)
+    return false;
+
+  for (size_t i = 1; i <= trail_bytes; ++i) {
+    if (!IsTrail(text[i]))
+      return false;
+    value = (value << 6) | (text[i] & 0x3F);
+  }
+
+  // Shorter sequences would have done for overlong ones.
+  static const uint32 kMinValues[] = { 0, 0x80, 0x800, 0x10000 };
+  if (value < kMinValues[trail_bytes] || !IsValidCodePoint(value))
+    return false;
+
+  *code_point = value;
+  *sequence_length = trail_bytes + 1;
+  return true;
+}
+
+// Stores @p code_point at @p out.
+// @returns the number of wide characters stored.
+size_t StoreCodePoint(uint32 code_point, wchar_t* out) {
+#if defined(WCHAR_T_IS_UTF16)
+  if (code_point >= 0x10000) {
+    code_point -= 0x10000;
+    out[0] = static_cast<wchar_t>(0xD800 + (code_point >> 10));
+    out[1] = static_cast<wchar_t>(0xDC00 + (code_point & 0x3FF));
+    return 2;
+  }
+#endif
+  out[0] = static_cast<wchar_t>(code_point);
+  return 1;
+}
+
+#if defined(ARCH_CPU_X86_FAMILY)
+
+const size_t kBytesPerBlock = sizeof(__m128i);
+
+// Widens the sixteen ASCII bytes of @p block to wide characters at @p out.
+void StoreWidened(__m128i block, wchar_t* out) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i low = _mm_unpacklo_epi8(block, zero);
+  __m128i high = _mm_unpackhi_epi8(block, zero);
+#if defined(WCHAR_T_IS_UTF16)
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), low);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), high);
+#else  // defined(WCHAR_T_IS_UTF16)
+  __m128i* dest = reinterpret_cast<__m128i*>(out);
+  _mm_storeu_si128(dest, _mm_unpacklo_epi16(low, zero));
+  _mm_storeu_si128(dest + 1, _mm_unpackhi_epi16(low, zero));
+  _mm_storeu_si128(dest + 2, _mm_unpacklo_epi16(high, zero));
+  _mm_storeu_si128(dest + 3, _mm_unpackhi_epi16(high, zero));
+#endif  // defined(WCHAR_T_IS_UTF16)
+}
+
+#endif  // defined(ARCH_CPU_X86_FAMILY)
+
+// Converts the @p length bytes at @p text to @p out, which has room for
+// @p length wide characters, as no character takes more wide characters
+// than bytes.
+// @returns false if @p text is ill-formed, else the number of wide
+//     characters stored in @p out_length.
+bool Transcode(const uint8* text,
+               size_t length,
+               wchar_t* out,
+               size_t* out_length) {
+  size_t in = 0;
+  size_t stored = 0;
+  while (in < length) {
+#if defined(ARCH_CPU_X86_FAMILY)
+    // SSE2 is baseline on every x86 CPU we run on. A block with any byte
+    // past ASCII has its top bit set in the mask, and goes to the scalar
+    // loop a character at a time.
+    while (in + kBytesPerBlock <= length) {
+      __m128i block = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(text + in));
+      if (_mm_movemask_epi8(block) != 0)
+        break;
+      StoreWidened(block, out + stored);
+      in += kBytesPerBlock;
+      stored += kBytesPerBlock;
+    }
+    if (in == length)
+      break;
+#endif  // defined(ARCH_CPU_X86_FAMILY)
+
+    if (text[in] < 0x80) {
+      out[stored++] = text[in++];
+      continue;
+    }
+
+    uint32 code_point = 0;
+    size_t sequence_length = 0;
+    if (!DecodeSequence(text + in, length - in, &code_point,
+                        &sequence_length)) {
+      return false;
+    }
+    in += sequence_length;
+    stored += StoreCodePoint(code_point, out + stored);
+  }
+
+  *out_length = stored;
+  return true;
+}
+
+}  // namespace
+
+bool TranscodeUTF8ToWide(const char* text, size_t length, std::wstring* wide) {
+  DCHECK(text != NULL || length == 0);
+  DCHECK(wide != NULL);
+
+  wide->resize(length);
+  size_t wide_length = 0;
+  if (length != 0 &&
+      !Transcode(reinterpret_cast<const uint8*>(text), length, &(*wide)[0],
+                 &wide_length)) {
+    return base::UTF8ToWide(text, length, wide);
+  }
+
+  wide->resize(wide_length);
+  return true;
+}
+
+std::wstring TranscodeUTF8ToWide(const base::StringPiece& text) {
+  std::wstring wide;
+  TranscodeUTF8ToWide(text.data(), text.size(), &wide);
+  return wide;
+}
@@ -0,0 +1,109 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// UTF-8 transcoder unittests.
+#include "sawbuck/common/utf8_transcoder.h"
+
+#include "base/basictypes.h"
+#include "base/strings/utf_string_conversions.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// @returns @p text converted by base::UTF8ToWide.
+std::wstring BaseUTF8ToWide(const std::string& text) {
+  std::wstring wide;
+  base::UTF8ToWide(text.data(), text.size(), &wide);
+  return wide;
+}
+
+}  // namespace
+
+TEST(UTF8TranscoderTest, Ascii) {
+  EXPECT_EQ(L"", TranscodeUTF8ToWide(""));
+  EXPECT_EQ(L"a", TranscodeUTF8ToWide("a"));
+
+  // Lengths about the block size take both the vector and the scalar
+  // loops.
+  std::string text;
+  std::wstring expected;
+  for (int i = 0; i < 70; ++i) {
+    EXPECT_EQ(expected, TranscodeUTF8ToWide(text)) << i;
+    text.push_back(static_cast<char>(' ' + i));
+    expected.push_back(static_cast<wchar_t>(L' ' + i));
+  }
+
+  // Embedded zeros are characters like any other.
+  EXPECT_EQ(std::wstring(L"a\0b", 3),
+            TranscodeUTF8ToWide(base::StringPiece("a\0b", 3)));
+}
+
+TEST(UTF8TranscoderTest, MultiByte) {
+  // Two, three and four byte characters, alone and among ASCII runs
+  // longer than a block.
+  EXPECT_EQ(L"\xE9", TranscodeUTF8ToWide("\xC3\xA9"));
+  EXPECT_EQ(L"\x4E2D\x6587", TranscodeUTF8ToWide("\xE4\xB8\xAD\xE6\x96\x87"));
+  EXPECT_EQ(BaseUTF8ToWide("\xF0\x9F\x98\x80"),
+            TranscodeUTF8ToWide("\xF0\x9F\x98\x80"));
+
+  std::string text("Opening the profile at c:\\users\\r\xC3\xA9mi\\"
+                   "AppData\\Local\\Chromium \xE4\xB8\xAD and more ASCII");
+  EXPECT_EQ(BaseUTF8ToWide(text), TranscodeUTF8ToWide(text));
+
+  // A character straddling a block boundary.
+  for (size_t pad = 0; pad < 20; ++pad) {
+    std::string padded(std::string(pad, 'x') + "\xE6\x96\x87" +
+                       std::string(20, 'y'));
+    EXPECT_EQ(BaseUTF8ToWide(padded), TranscodeUTF8ToWide(padded)) << pad;
+  }
+
+  // The bounds of each sequence length.
+  EXPECT_EQ(BaseUTF8ToWide("\xC2\x80\xDF\xBF\xE0\xA0\x80\xEF\xBF\xBD"),
+            TranscodeUTF8ToWide("\xC2\x80\xDF\xBF\xE0\xA0\x80\xEF\xBF\xBD"));
+  EXPECT_EQ(BaseUTF8ToWide("\xF4\x8F\xBF\xBD"),
+            TranscodeUTF8ToWide("\xF4\x8F\xBF\xBD"));
+}
+
+TEST(UTF8TranscoderTest, IllFormed) {
+  const char* kIllFormed[] = {
+    // A lone trail byte, and a truncated sequence.
+    "abc\x80" "def",
+    "abc\xE4\xB8",
+    // Overlong encodings.
+    "\xC0\xAF",
+    "\xE0\x80\xAF",
+    "\xF0\x80\x80\xAF",
+    // A surrogate, a non-character, and past the last code point.
+    "\xED\xA0\x80",
+    "\xEF\xBF\xBE",
+    "\xF4\x90\x80\x80",
+    // A lead byte followed by ASCII.
+    "\xC3" "0123456789abcdefghij",
+  };
+
+  for (size_t i = 0; i < arraysize(kIllFormed); ++i) {
+    std::string text(kIllFormed[i]);
+    std::wstring wide;
+    EXPECT_FALSE(TranscodeUTF8ToWide(text.data(), text.size(), &wide)) << i;
+    EXPECT_EQ(BaseUTF8ToWide(text), wide) << i;
+  }
+}
+
+TEST(UTF8TranscoderTest, ReusesOutput) {
+  std::wstring wide(L"something long that was there before");
+  EXPECT_TRUE(TranscodeUTF8ToWide("new", 3, &wide));
+  EXPECT_EQ(L"new", wide);
+  EXPECT_TRUE(TranscodeUTF8ToWide(NULL, 0, &wide));
+  EXPECT_EQ(L"", wide);
+}
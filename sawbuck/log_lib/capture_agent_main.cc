@@ -0,0 +1,366 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// A headless capture agent, which captures the log messages of the
+// providers it's given, and the kernel's process and module events, and
+// streams them to a viewer connected over TCP. This allows capturing on
+// a machine with no UI, or with no room for one.
+//
+// Usage: capture_agent [--port=N] --providers=GUID[:level[:flags]];...
+//
+// The level is decimal and the flags are hex, they default to information
+// and all flags.
+//
+// The agent serves one viewer at a time, and captures only while one is
+// connected.
+#include <winsock2.h>
+#include <objbase.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "base/at_exit.h"
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread.h"
+#include "base/win/event_trace_controller.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/log_lib/log_consumer.h"
+#include "sawbuck/log_lib/log_stream.h"
+#include "sawbuck/log_lib/tdh_event_decoder.h"
+
+namespace {
+
+const wchar_t kAgentSessionName[] = L"Sawbuck Capture Agent Session";
+
+// How often the agent sends what it has captured.
+const int kFlushIntervalMs = 100;
+
+struct Provider {
+  GUID guid;
+  UCHAR level;
+  ULONG flags;
+};
+
+int Error(const std::wstring& error) {
+  std::wcout << error << std::endl;
+
+  return 1;
+}
+
+// Parses the providers of @p str, of the form GUID[:level[:flags]];...
+// @returns true iff all the providers parse.
+bool ParseProviders(const std::string& str, std::vector<Provider>* providers) {
+  DCHECK(providers != NULL);
+
+  std::vector<std::string> entries;
+  base::SplitString(str, ';', &entries);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (entries[i].empty())
+      continue;
+
+    std::vector<std::string> fields;
+    base::SplitString(entries[i], ':', &fields);
+    std::wstring guid(fields[0].begin(), fields[0].end());
+    Provider provider = { GUID_NULL, TRACE_LEVEL_INFORMATION, 0xFFFFFFFF };
+    unsigned level = provider.level;
+    int flags = static_cast<int>(provider.flags);
+    if (fields.size() > 3 ||
+        FAILED(::CLSIDFromString(guid.c_str(), &provider.guid)) ||
+        (fields.size() > 1 && !base::StringToUint(fields[1], &level)) ||
+        (fields.size() > 2 && !base::HexStringToInt(fields[2], &flags)) ||
+        level > 0xFF) {
+      return false;
+    }
+    provider.level = static_cast<UCHAR>(level);
+    provider.flags = static_cast<ULONG>(flags);
+    providers->push_back(provider);
+  }
+
+  return !providers->empty();
+}
+
+bool Is64BitSystem() {
+  if (sizeof(void*) == 8)  // NOLINT
+    return true;
+
+  BOOL is_wow_64 = FALSE;
+  return ::IsWow64Process(::GetCurrentProcess(), &is_wow_64) && is_wow_64;
+}
+
+// Sends the stream to the connected viewer.
+class SocketOutput : public LogStreamWriter::Output {
+ public:
+  explicit SocketOutput(SOCKET socket) : socket_(socket) {
+  }
+
+  virtual bool Write(const char* data, size_t len) {
+    while (len != 0) {
+      int sent = ::send(socket_, data, static_cast<int>(len), 0);
+      if (sent == SOCKET_ERROR) {
+        LOG(ERROR) << "Failed to send to the viewer, error "
+            << ::WSAGetLastError();
+        return false;
+      }
+      data += sent;
+      len -= sent;
+    }
+    return true;
+  }
+
+ private:
+  SOCKET socket_;
+
+  DISALLOW_COPY_AND_ASSIGN(SocketOutput);
+};
+
+// Funnels the events of the log and kernel consumer threads into the
+// stream writer, which the main thread flushes.
+class LockedStreamWriter
+    : public LogEvents,
+      public TraceEvents,
+      public KernelProcessEvents,
+      public KernelModuleEvents {
+ public:
+  explicit LockedStreamWriter(LogStreamWriter::Output* output)
+      : writer_(output) {
+  }
+
+  bool Flush() {
+    base::AutoLock lock(lock_);
+    return writer_.Flush();
+  }
+
+  // LogEvents implementation.
+  virtual void OnLogMessage(const LogMessage& log_message) {
+    base::AutoLock lock(lock_);
+    writer_.OnLogMessage(log_message);
+  }
+  virtual void OnLogMessages(const LogMessage* log_messages, size_t count) {
+    base::AutoLock lock(lock_);
+    writer_.OnLogMessages(log_messages, count);
+  }
+
+  // TraceEvents implementation.
+  virtual void OnTraceEventBegin(const TraceMessage& trace_message) {
+    base::AutoLock lock(lock_);
+    writer_.OnTraceEventBegin(trace_message);
+  }
+  virtual void OnTraceEventEnd(const TraceMessage& trace_message) {
+    base::AutoLock lock(lock_);
+    writer_.OnTraceEventEnd(trace_message);
+  }
+  virtual void OnTraceEventInstant(const TraceMessage& trace_message) {
+    base::AutoLock lock(lock_);
+    writer_.OnTraceEventInstant(trace_message);
+  }
+
+  // KernelProcessEvents implementation.
+  virtual void OnProcessIsRunning(const base::Time& time,
+                                  const ProcessInfo& process_info) {
+    base::AutoLock lock(lock_);
+    writer_.OnProcessIsRunning(time, process_info);
+  }
+  virtual void OnProcessStarted(const base::Time& time,
+                                const ProcessInfo& process_info) {
+    base::AutoLock lock(lock_);
+    writer_.OnProcessStarted(time, process_info);
+  }
+  virtual void OnProcessEnded(const base::Time& time,
+                              const ProcessInfo& process_info,
+                              ULONG exit_status) {
+    base::AutoLock lock(lock_);
+    writer_.OnProcessEnded(time, process_info, exit_status);
+  }
+
+  // KernelModuleEvents implementation.
+  virtual void OnModuleIsLoaded(DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info) {
+    base::AutoLock lock(lock_);
+    writer_.OnModuleIsLoaded(process_id, time, module_info);
+  }
+  virtual void OnModuleUnload(DWORD process_id,
+                              const base::Time& time,
+                              const ModuleInformation& module_info) {
+    base::AutoLock lock(lock_);
+    writer_.OnModuleUnload(process_id, time, module_info);
+  }
+  virtual void OnModuleLoad(DWORD process_id,
+                            const base::Time& time,
+                            const ModuleInformation& module_info) {
+    base::AutoLock lock(lock_);
+    writer_.OnModuleLoad(process_id, time, module_info);
+  }
+
+ private:
+  base::Lock lock_;
+  LogStreamWriter writer_;
+
+  DISALLOW_COPY_AND_ASSIGN(LockedStreamWriter);
+};
+
+// Captures the log and kernel sessions into @p sink until the stream to
+// the viewer fails.
+// @returns false iff the sessions fail to start.
+bool Capture(const std::vector<Provider>& providers,
+             LockedStreamWriter* sink) {
+  DCHECK(sink != NULL);
+
+  // Stop any session left behind by a previous agent.
+  base::win::EtwTraceProperties ignore;
+  base::win::EtwTraceController::Stop(kAgentSessionName, &ignore);
+
+  base::win::EtwTraceController log_controller;
+  base::win::EtwTraceController kernel_controller;
+  base::Thread log_consumer_thread("Log consumer");
+  base::Thread kernel_consumer_thread("Kernel consumer");
+  // Other providers' events are decoded here, where their schemas are
+  // registered, and go to the viewer as text.
+  TdhEventDecoder generic_decoder(NULL);
+  scoped_ptr<LogConsumer> log_consumer;
+  scoped_ptr<KernelLogConsumer> kernel_consumer;
+
+  // Use the QPC timer, see
+  // http://msdn.microsoft.com/en-us/library/aa364160(v=vs.85).aspx.
+  base::win::EtwTraceProperties log_props;
+  EVENT_TRACE_PROPERTIES* p = log_props.get();
+  p->Wnode.ClientContext = 1;
+  p->LogFileMode = EVENT_TRACE_REAL_TIME_MODE;
+  HRESULT hr = log_controller.Start(kAgentSessionName, &log_props);
+  if (SUCCEEDED(hr)) {
+    log_consumer.reset(new LogConsumer());
+    log_consumer->set_event_sink(sink);
+    log_consumer->set_trace_sink(sink);
+    log_consumer->set_generic_decoder(&generic_decoder);
+    log_consumer->set_batch_log_messages(true);
+    hr = log_consumer->OpenRealtimeSession(kAgentSessionName);
+  }
+  if (SUCCEEDED(hr)) {
+    CHECK(log_consumer_thread.Start());
+    log_consumer_thread.message_loop()->PostTask(FROM_HERE,
+        base::Bind(base::IgnoreResult(&LogConsumer::Consume),
+                   base::Unretained(log_consumer.get())));
+
+    base::win::EtwTraceProperties kernel_props;
+    p = kernel_props.get();
+    p->Wnode.Guid = SystemTraceControlGuid;
+    p->Wnode.ClientContext = 1;
+    p->LogFileMode = EVENT_TRACE_REAL_TIME_MODE;
+    p->EnableFlags = EVENT_TRACE_FLAG_IMAGE_LOAD | EVENT_TRACE_FLAG_PROCESS;
+    hr = kernel_controller.Start(KERNEL_LOGGER_NAME, &kernel_props);
+  }
+  if (SUCCEEDED(hr)) {
+    kernel_consumer.reset(new KernelLogConsumer());
+    kernel_consumer->set_module_event_sink(sink);
+    kernel_consumer->set_process_event_sink(sink);
+    kernel_consumer->set_is_64_bit_log(Is64BitSystem());
+    hr = kernel_consumer->OpenRealtimeSession(KERNEL_LOGGER_NAME);
+  }
+  if (SUCCEEDED(hr)) {
+    CHECK(kernel_consumer_thread.Start());
+    kernel_consumer_thread.message_loop()->PostTask(FROM_HERE,
+        base::Bind(base::IgnoreResult(&KernelLogConsumer::Consume),
+                   base::Unretained(kernel_consumer.get())));
+
+    for (size_t i = 0; i < providers.size(); ++i) {
+      log_controller.EnableProvider(providers[i].guid,
+                                    providers[i].level,
+                                    providers[i].flags);
+    }
+
+    // The flush fails once the viewer goes away.
+    while (sink->Flush())
+      ::Sleep(kFlushIntervalMs);
+  } else {
+    LOG(ERROR) << "Failed to start capturing, error " << hr;
+  }
+
+  log_controller.Stop(NULL);
+  kernel_controller.Stop(NULL);
+  log_consumer_thread.Stop();
+  kernel_consumer_thread.Stop();
+
+  return SUCCEEDED(hr);
+}
+
+}  // namespace
+
+int wmain(int argc, const wchar_t** argv) {
+  base::AtExitManager at_exit;
+  CommandLine::Init(0, NULL);
+
+  CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  int port = kLogStreamDefaultPort;
+  if (cmd_line->HasSwitch("port") &&
+      (!base::StringToInt(cmd_line->GetSwitchValueASCII("port"), &port) ||
+       port <= 0 || port > 0xFFFF)) {
+    return Error(L"The port must be a number from 1 to 65535.");
+  }
+  std::vector<Provider> providers;
+  if (!ParseProviders(cmd_line->GetSwitchValueASCII("providers"),
+                      &providers)) {
+    return Error(L"Usage: capture_agent [--port=N] "
+                 L"--providers=GUID[:level[:flags]];...");
+  }
+
+  WSADATA wsa_data = {};
+  if (::WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+    return Error(L"Failed to initialize Winsock.");
+
+  SOCKET listener = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = ::htonl(INADDR_ANY);
+  addr.sin_port = ::htons(static_cast<u_short>(port));
+  if (listener == INVALID_SOCKET ||
+      ::bind(listener, reinterpret_cast<sockaddr*>(&addr),
+             sizeof(addr)) == SOCKET_ERROR ||
+      ::listen(listener, 1) == SOCKET_ERROR) {
+    ::WSACleanup();
+    return Error(L"Failed to listen for viewers.");
+  }
+
+  int ret = 0;
+  while (true) {
+    std::wcout << L"Waiting for a viewer on port " << port << std::endl;
+    SOCKET viewer = ::accept(listener, NULL, NULL);
+    if (viewer == INVALID_SOCKET) {
+      ret = Error(L"Failed to accept a viewer.");
+      break;
+    }
+
+    std::wcout << L"Viewer connected, capturing." << std::endl;
+    bool started = false;
+    {
+      SocketOutput output(viewer);
+      LockedStreamWriter sink(&output);
+      started = Capture(providers, &sink);
+    }
+    ::closesocket(viewer);
+    if (!started) {
+      ret = Error(L"Failed to start the capture sessions.");
+      break;
+    }
+    std::wcout << L"Viewer disconnected." << std::endl;
+  }
+
+  ::closesocket(listener);
+  ::WSACleanup();
+  return ret;
+}
@@ -0,0 +1,193 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// CPU profile service implementation.
+#include "sawbuck/log_lib/cpu_profile_service.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+// Orders frames hottest first.
+bool IsHotter(const ICpuProfileService::HotFrame& a,
+              const ICpuProfileService::HotFrame& b) {
+  if (a.inclusive_samples_ != b.inclusive_samples_)
+    return a.inclusive_samples_ > b.inclusive_samples_;
+  return a.exclusive_samples_ > b.exclusive_samples_;
+}
+
+}  // namespace
+
+const size_t CpuProfileService::kDefaultMaxSamples;
+const CpuProfileService::StackId CpuProfileService::kEmptyStack;
+
+ICpuProfileService::HotFrame::HotFrame()
+    : address_(0), inclusive_samples_(0), exclusive_samples_(0) {
+}
+
+CpuProfileService::CpuProfileService()
+    : max_samples_(kDefaultMaxSamples) {
+  StackNode root = { kEmptyStack, 0 };
+  stack_nodes_.push_back(root);
+}
+
+CpuProfileService::CpuProfileService(size_t max_samples)
+    : max_samples_(max_samples) {
+  DCHECK_LT(0U, max_samples);
+  StackNode root = { kEmptyStack, 0 };
+  stack_nodes_.push_back(root);
+}
+
+CpuProfileService::~CpuProfileService() {
+}
+
+void CpuProfileService::GetStackFrames(
+    StackId stack_id, std::vector<sym_util::Address>* frames) {
+  DCHECK(frames != NULL);
+  frames->clear();
+
+  base::AutoLock lock(lock_);
+  DCHECK_LT(stack_id, stack_nodes_.size());
+  for (; stack_id != kEmptyStack; stack_id = stack_nodes_[stack_id].parent)
+    frames->push_back(stack_nodes_[stack_id].address);
+}
+
+size_t CpuProfileService::num_stack_nodes() {
+  base::AutoLock lock(lock_);
+  return stack_nodes_.size() - 1;
+}
+
+uint64 CpuProfileService::GetHotFrames(DWORD process_id,
+                                       const base::Time& from,
+                                       const base::Time& to,
+                                       size_t max_frames,
+                                       std::vector<HotFrame>* frames) {
+  DCHECK(frames != NULL);
+  frames->clear();
+
+  typedef std::map<sym_util::Address, HotFrame> HotFrameMap;
+  HotFrameMap hot_frames;
+  uint64 num_samples = 0;
+  {
+    base::AutoLock lock(lock_);
+
+    // Count the samples by stack first, so each distinct stack is walked
+    // once however many samples share it.
+    typedef std::map<StackId, uint64> StackCountMap;
+    StackCountMap stack_counts;
+    for (size_t i = 0; i < samples_.size(); ++i) {
+      const Sample& sample = samples_[i];
+      if (sample.process_id != process_id ||
+          sample.time < from || sample.time > to) {
+        continue;
+      }
+
+      stack_counts[sample.stack_id] += sample.count;
+      num_samples += sample.count;
+    }
+
+    std::vector<sym_util::Address> seen;
+    StackCountMap::const_iterator it(stack_counts.begin());
+    for (; it != stack_counts.end(); ++it) {
+      StackId stack_id = it->first;
+      if (stack_id == kEmptyStack)
+        continue;
+
+      hot_frames[stack_nodes_[stack_id].address].exclusive_samples_ +=
+          it->second;
+      seen.clear();
+      for (; stack_id != kEmptyStack;
+           stack_id = stack_nodes_[stack_id].parent) {
+        sym_util::Address address = stack_nodes_[stack_id].address;
+        if (std::find(seen.begin(), seen.end(), address) != seen.end())
+          continue;
+
+        seen.push_back(address);
+        hot_frames[address].inclusive_samples_ += it->second;
+      }
+    }
+  }
+
+  HotFrameMap::iterator it(hot_frames.begin());
+  for (; it != hot_frames.end(); ++it) {
+    it->second.address_ = it->first;
+    frames->push_back(it->second);
+  }
+
+  std::sort(frames->begin(), frames->end(), IsHotter);
+  if (frames->size() > max_frames)
+    frames->resize(max_frames);
+
+  return num_samples;
+}
+
+void CpuProfileService::OnSampledProfile(
+    const base::Time& time,
+    DWORD thread_id,
+    sym_util::Address instruction_pointer,
+    ULONG count) {
+  base::AutoLock lock(lock_);
+
+  // A sample whose stack walk never came, e.g. as it was lost with a full
+  // buffer, is superseded. Without its stack walk we don't know its
+  // process.
+  PendingSample& pending = pending_samples_[thread_id];
+  pending.time = time;
+  pending.count = count;
+}
+
+void CpuProfileService::OnStackWalk(const base::Time& time,
+                                    DWORD process_id,
+                                    DWORD thread_id,
+                                    size_t num_frames,
+                                    const sym_util::Address* frames) {
+  DCHECK(num_frames == 0 || frames != NULL);
+  base::AutoLock lock(lock_);
+
+  // The stacks of other events, if the session asked for them, don't
+  // follow a profile interrupt.
+  PendingSampleMap::iterator it(pending_samples_.find(thread_id));
+  if (it == pending_samples_.end())
+    return;
+
+  Sample sample = { it->second.time, process_id,
+                    InternStack(num_frames, frames), it->second.count };
+  pending_samples_.erase(it);
+
+  samples_.push_back(sample);
+  if (samples_.size() > max_samples_)
+    samples_.pop_front();
+}
+
+CpuProfileService::StackId CpuProfileService::InternStack(
+    size_t num_frames, const sym_util::Address* frames) {
+  lock_.AssertAcquired();
+
+  // The tree is rooted at the outermost frame, so walk the stack outwards
+  // in.
+  StackId stack_id = kEmptyStack;
+  for (size_t i = num_frames; i > 0; --i) {
+    std::pair<StackNodeMap::iterator, bool> inserted(
+        stack_node_ids_.insert(std::make_pair(
+            std::make_pair(stack_id, frames[i - 1]), stack_nodes_.size())));
+    if (inserted.second) {
+      StackNode node = { stack_id, frames[i - 1] };
+      stack_nodes_.push_back(node);
+    }
+    stack_id = inserted.first->second;
+  }
+
+  return stack_id;
+}
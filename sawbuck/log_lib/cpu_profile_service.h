@@ -0,0 +1,142 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// CPU profile service declaration.
+#ifndef SAWBUCK_LOG_LIB_CPU_PROFILE_SERVICE_H_
+#define SAWBUCK_LOG_LIB_CPU_PROFILE_SERVICE_H_
+
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+#include "base/synchronization/lock.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+
+class ICpuProfileService {
+ public:
+  // The samples a return address or instruction pointer was on the stack
+  // of, over a stretch of time.
+  struct HotFrame {
+    HotFrame();
+
+    sym_util::Address address_;
+    // The samples with the address anywhere on their stack, counting each
+    // sample once even where the address recurs on it.
+    uint64 inclusive_samples_;
+    // The samples with the address innermost on their stack.
+    uint64 exclusive_samples_;
+  };
+
+  // Retrieve the unique frames of the samples of @p process_id from @p from
+  // to @p to, most inclusive samples first, to @p frames.
+  // @param max_frames the most frames to retrieve.
+  // @returns the number of samples in the stretch.
+  virtual uint64 GetHotFrames(DWORD process_id,
+                              const base::Time& from,
+                              const base::Time& to,
+                              size_t max_frames,
+                              std::vector<HotFrame>* frames) = 0;
+};
+
+// The CPU profile service sinks the profile events of a kernel log parser.
+// It ties each profile interrupt to the stack walk that follows it on the
+// same thread, and interns the stacks into a call tree, so that a sample
+// costs a tree node id however deep its stack. The samples are capped, but
+// the tree only grows with the number of distinct stacks.
+class CpuProfileService
+    : public ICpuProfileService,
+      public KernelProfileEvents {
+ public:
+  // The default number of samples kept for GetHotFrames.
+  static const size_t kDefaultMaxSamples = 1024 * 1024;
+
+  // Identifies an interned stack by its innermost call tree node.
+  typedef size_t StackId;
+  // The empty stack, which is the root of the call tree.
+  static const StackId kEmptyStack = 0;
+
+  CpuProfileService();
+  explicit CpuProfileService(size_t max_samples);
+  ~CpuProfileService();
+
+  // Retrieve the frames of @p stack_id, innermost first, to @p frames.
+  void GetStackFrames(StackId stack_id,
+                      std::vector<sym_util::Address>* frames);
+
+  // The number of distinct stacks interned, for testing.
+  size_t num_stack_nodes();
+
+  // ICpuProfileService implementation.
+  virtual uint64 GetHotFrames(DWORD process_id,
+                              const base::Time& from,
+                              const base::Time& to,
+                              size_t max_frames,
+                              std::vector<HotFrame>* frames);
+
+  // KernelProfileEvents implementation.
+  virtual void OnSampledProfile(const base::Time& time,
+                                DWORD thread_id,
+                                sym_util::Address instruction_pointer,
+                                ULONG count);
+  virtual void OnStackWalk(const base::Time& time,
+                           DWORD process_id,
+                           DWORD thread_id,
+                           size_t num_frames,
+                           const sym_util::Address* frames);
+
+ private:
+  // A node of the call tree, standing for the stack of its frames up to
+  // and including its own.
+  struct StackNode {
+    StackId parent;
+    sym_util::Address address;
+  };
+  // A profile interrupt, awaiting its stack walk.
+  struct PendingSample {
+    base::Time time;
+    ULONG count;
+  };
+  // A sample, as kept for reports over a stretch of time.
+  struct Sample {
+    base::Time time;
+    DWORD process_id;
+    StackId stack_id;
+    ULONG count;
+  };
+
+  // @returns the id of the stack @p frames, innermost first, interning it
+  //     as need be. Under lock_.
+  StackId InternStack(size_t num_frames, const sym_util::Address* frames);
+
+  const size_t max_samples_;
+
+  base::Lock lock_;
+
+  // The call tree, with the root at kEmptyStack. Under lock_.
+  std::vector<StackNode> stack_nodes_;
+  typedef std::map<std::pair<StackId, sym_util::Address>, StackId>
+      StackNodeMap;
+  StackNodeMap stack_node_ids_;
+
+  // The profile interrupts by thread. Under lock_.
+  typedef std::map<DWORD, PendingSample> PendingSampleMap;
+  PendingSampleMap pending_samples_;
+
+  // The samples in order of their stack walks. Under lock_.
+  std::deque<Sample> samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(CpuProfileService);
+};
+
+#endif  // SAWBUCK_LOG_LIB_CPU_PROFILE_SERVICE_H_
@@ -0,0 +1,173 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// CPU profile service unittests.
+#include "sawbuck/log_lib/cpu_profile_service.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const DWORD kPid = 1234;
+const DWORD kOtherPid = 1235;
+const DWORD kTid = 4321;
+const DWORD kOtherTid = 4322;
+
+const sym_util::Address kMain = 0x10001000;
+const sym_util::Address kFoo = 0x10002000;
+const sym_util::Address kBar = 0x10003000;
+
+class CpuProfileServiceTest: public testing::Test {
+ public:
+  CpuProfileServiceTest() : kT0(base::Time::Now()) {
+  }
+
+  // @returns kT0 plus @p ms milliseconds.
+  base::Time At(int ms) {
+    return kT0 + base::TimeDelta::FromMilliseconds(ms);
+  }
+
+  // Issues a sample of @p thread_id in @p process_id at @p time, with the
+  // stack of the @p num_frames @p frames, innermost first.
+  void Sample(const base::Time& time, DWORD process_id, DWORD thread_id,
+              size_t num_frames, const sym_util::Address* frames) {
+    service_.OnSampledProfile(time, thread_id, frames[0], 1);
+    service_.OnStackWalk(time, process_id, thread_id, num_frames, frames);
+  }
+
+  // @returns the frame of @p address in @p frames, or NULL.
+  static const ICpuProfileService::HotFrame* FindFrame(
+      const std::vector<ICpuProfileService::HotFrame>& frames,
+      sym_util::Address address) {
+    for (size_t i = 0; i < frames.size(); ++i) {
+      if (frames[i].address_ == address)
+        return &frames[i];
+    }
+    return NULL;
+  }
+
+ protected:
+  const base::Time kT0;
+  CpuProfileService service_;
+};
+
+}  // namespace
+
+TEST_F(CpuProfileServiceTest, InternsStacks) {
+  const sym_util::Address kFooStack[] = { kFoo, kMain };
+  const sym_util::Address kBarStack[] = { kBar, kFoo, kMain };
+  Sample(At(0), kPid, kTid, arraysize(kFooStack), kFooStack);
+  Sample(At(1), kPid, kTid, arraysize(kBarStack), kBarStack);
+  Sample(At(2), kPid, kTid, arraysize(kBarStack), kBarStack);
+
+  // The stacks share their outer frames.
+  EXPECT_EQ(3U, service_.num_stack_nodes());
+
+  std::vector<ICpuProfileService::HotFrame> frames;
+  EXPECT_EQ(3U, service_.GetHotFrames(kPid, At(0), At(2), 10, &frames));
+  ASSERT_EQ(3U, frames.size());
+
+  // Ties on inclusive samples go to the most exclusive samples.
+  EXPECT_EQ(kFoo, frames[0].address_);
+  EXPECT_EQ(3U, frames[0].inclusive_samples_);
+  EXPECT_EQ(1U, frames[0].exclusive_samples_);
+  EXPECT_EQ(kMain, frames[1].address_);
+  EXPECT_EQ(3U, frames[1].inclusive_samples_);
+  EXPECT_EQ(0U, frames[1].exclusive_samples_);
+  EXPECT_EQ(kBar, frames[2].address_);
+  EXPECT_EQ(2U, frames[2].inclusive_samples_);
+  EXPECT_EQ(2U, frames[2].exclusive_samples_);
+
+  // The most frames are respected.
+  service_.GetHotFrames(kPid, At(0), At(2), 1, &frames);
+  ASSERT_EQ(1U, frames.size());
+  EXPECT_EQ(kFoo, frames[0].address_);
+}
+
+TEST_F(CpuProfileServiceTest, GetStackFrames) {
+  const sym_util::Address kBarStack[] = { kBar, kFoo, kMain };
+  const sym_util::Address kFooStack[] = { kFoo, kMain };
+  Sample(At(0), kPid, kTid, arraysize(kBarStack), kBarStack);
+  Sample(At(0), kPid, kTid, arraysize(kFooStack), kFooStack);
+
+  // The innermost frame of the stack is the last node interned.
+  std::vector<sym_util::Address> frames;
+  service_.GetStackFrames(3, &frames);
+  ASSERT_EQ(3U, frames.size());
+  EXPECT_EQ(kBar, frames[0]);
+  EXPECT_EQ(kFoo, frames[1]);
+  EXPECT_EQ(kMain, frames[2]);
+
+  service_.GetStackFrames(CpuProfileService::kEmptyStack, &frames);
+  EXPECT_TRUE(frames.empty());
+}
+
+TEST_F(CpuProfileServiceTest, RecursionCountsOnce) {
+  const sym_util::Address kStack[] = { kFoo, kFoo, kFoo, kMain };
+  Sample(At(0), kPid, kTid, arraysize(kStack), kStack);
+
+  std::vector<ICpuProfileService::HotFrame> frames;
+  service_.GetHotFrames(kPid, At(0), At(0), 10, &frames);
+  const ICpuProfileService::HotFrame* foo = FindFrame(frames, kFoo);
+  ASSERT_TRUE(foo != NULL);
+  EXPECT_EQ(1U, foo->inclusive_samples_);
+  EXPECT_EQ(1U, foo->exclusive_samples_);
+}
+
+TEST_F(CpuProfileServiceTest, FiltersByProcessAndTime) {
+  const sym_util::Address kFooStack[] = { kFoo, kMain };
+  const sym_util::Address kBarStack[] = { kBar, kMain };
+  Sample(At(0), kPid, kTid, arraysize(kFooStack), kFooStack);
+  Sample(At(10), kPid, kTid, arraysize(kBarStack), kBarStack);
+  Sample(At(10), kOtherPid, kOtherTid, arraysize(kFooStack), kFooStack);
+
+  std::vector<ICpuProfileService::HotFrame> frames;
+  EXPECT_EQ(1U, service_.GetHotFrames(kPid, At(5), At(15), 10, &frames));
+  EXPECT_TRUE(FindFrame(frames, kBar) != NULL);
+  EXPECT_TRUE(FindFrame(frames, kFoo) == NULL);
+
+  EXPECT_EQ(1U, service_.GetHotFrames(kOtherPid, At(0), At(15), 10, &frames));
+  EXPECT_TRUE(FindFrame(frames, kFoo) != NULL);
+  EXPECT_TRUE(FindFrame(frames, kBar) == NULL);
+}
+
+TEST_F(CpuProfileServiceTest, StackWalksWithoutSamplesAreIgnored) {
+  const sym_util::Address kStack[] = { kFoo, kMain };
+  service_.OnStackWalk(At(0), kPid, kTid, arraysize(kStack), kStack);
+
+  // A sample only takes the stack walk of its own thread.
+  service_.OnSampledProfile(At(1), kTid, kFoo, 1);
+  service_.OnStackWalk(At(1), kPid, kOtherTid, arraysize(kStack), kStack);
+
+  std::vector<ICpuProfileService::HotFrame> frames;
+  EXPECT_EQ(0U, service_.GetHotFrames(kPid, At(0), At(1), 10, &frames));
+  EXPECT_TRUE(frames.empty());
+  EXPECT_EQ(0U, service_.num_stack_nodes());
+
+  service_.OnStackWalk(At(1), kPid, kTid, arraysize(kStack), kStack);
+  EXPECT_EQ(1U, service_.GetHotFrames(kPid, At(0), At(1), 10, &frames));
+}
+
+TEST(CpuProfileServiceCapTest, CapsSamples) {
+  CpuProfileService service(2);
+  const sym_util::Address kStack[] = { kFoo, kMain };
+  base::Time t0(base::Time::Now());
+  for (int i = 0; i < 3; ++i) {
+    service.OnSampledProfile(t0, kTid, kFoo, 1);
+    service.OnStackWalk(t0, kPid, kTid, arraysize(kStack), kStack);
+  }
+
+  std::vector<ICpuProfileService::HotFrame> frames;
+  EXPECT_EQ(2U, service.GetHotFrames(kPid, t0, t0, 10, &frames));
+}
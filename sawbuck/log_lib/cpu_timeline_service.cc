@@ -0,0 +1,194 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// CPU timeline service implementation.
+#include "sawbuck/log_lib/cpu_timeline_service.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+// The KTHREAD_STATE of a thread preempted while it could still run.
+const int kThreadStateReady = 1;
+
+// The most processors we keep a timeline for.
+const ULONG kMaxProcessors = 256;
+
+// @returns the overlap of [@p start, @p end) with [@p from, @p to).
+base::TimeDelta Overlap(const base::Time& start, const base::Time& end,
+                        const base::Time& from, const base::Time& to) {
+  base::Time overlap_start = std::max(start, from);
+  base::Time overlap_end = std::min(end, to);
+  if (overlap_end <= overlap_start)
+    return base::TimeDelta();
+
+  return overlap_end - overlap_start;
+}
+
+}  // namespace
+
+const size_t CpuTimelineService::kDefaultMaxRuns;
+
+CpuTimelineService::CpuTimelineService() : max_runs_(kDefaultMaxRuns) {
+}
+
+CpuTimelineService::CpuTimelineService(size_t max_runs)
+    : max_runs_(max_runs) {
+  DCHECK_LT(0U, max_runs);
+}
+
+CpuTimelineService::~CpuTimelineService() {
+}
+
+bool CpuTimelineService::GetThreadActivity(DWORD thread_id,
+                                           const base::Time& from,
+                                           const base::Time& to,
+                                           ThreadActivity* activity) {
+  DCHECK(activity != NULL);
+  DCHECK(from <= to);
+
+  base::AutoLock lock(lock_);
+
+  // Bound the window by the timeline we have left.
+  base::Time first_time;
+  for (size_t i = 0; i < processors_.size(); ++i) {
+    const RunQueue& runs = processors_[i];
+    if (!runs.empty() &&
+        (first_time.is_null() || runs.front().start < first_time)) {
+      first_time = runs.front().start;
+    }
+  }
+  base::Time window_start = std::max(from, first_time);
+  base::Time window_end = std::min(to, last_time_);
+  if (first_time.is_null() || window_end <= window_start)
+    return false;
+
+  *activity = ThreadActivity();
+  for (size_t i = 0; i < processors_.size(); ++i) {
+    const RunQueue& runs = processors_[i];
+
+    // Start at the run in progress at the start of the window.
+    Run key = { window_start, 0 };
+    RunQueue::const_iterator it(
+        std::upper_bound(runs.begin(), runs.end(), key));
+    if (it != runs.begin())
+      --it;
+
+    for (; it != runs.end() && it->start < window_end; ++it) {
+      if (it->thread_id != thread_id)
+        continue;
+
+      RunQueue::const_iterator next(it + 1);
+      base::Time end = next == runs.end() ? last_time_ : next->start;
+      activity->running_ += Overlap(it->start, end, window_start, window_end);
+    }
+  }
+
+  // The intervals are ordered on their end, and none is longer than
+  // longest_ready_, so none past the window's end plus that overlaps it.
+  ReadyInterval key = { base::Time(), window_start, 0 };
+  ReadyIntervalQueue::const_iterator it(std::upper_bound(
+      ready_intervals_.begin(), ready_intervals_.end(), key));
+  for (; it != ready_intervals_.end() &&
+         it->end - longest_ready_ < window_end; ++it) {
+    if (it->thread_id == thread_id)
+      activity->ready_ += Overlap(it->start, it->end, window_start,
+                                  window_end);
+  }
+
+  // And a ready interval still in progress.
+  ReadyTimeMap::const_iterator ready(ready_times_.find(thread_id));
+  if (ready != ready_times_.end())
+    activity->ready_ += Overlap(ready->second, last_time_, window_start,
+                                window_end);
+
+  base::TimeDelta window = window_end - window_start;
+  activity->waiting_ = window - activity->running_ - activity->ready_;
+  if (activity->waiting_ < base::TimeDelta())
+    activity->waiting_ = base::TimeDelta();
+
+  return true;
+}
+
+void CpuTimelineService::OnContextSwitch(const base::Time& time,
+                                         ULONG processor,
+                                         DWORD old_thread_id,
+                                         DWORD new_thread_id,
+                                         int old_thread_state) {
+  if (processor >= kMaxProcessors) {
+    LOG(ERROR) << "Context switch on unexpected processor " << processor;
+    return;
+  }
+
+  base::AutoLock lock(lock_);
+
+  if (time > last_time_)
+    last_time_ = time;
+
+  if (processor >= processors_.size())
+    processors_.resize(processor + 1);
+
+  // A switch back to the same thread extends its run.
+  if (old_thread_id == new_thread_id)
+    return;
+
+  EndReadyInterval(new_thread_id, time);
+  // A preempted thread is ready to run again straight away.
+  if (old_thread_state == kThreadStateReady && old_thread_id != 0)
+    ready_times_[old_thread_id] = time;
+
+  RunQueue& runs = processors_[processor];
+  if (!runs.empty() && runs.back().thread_id == new_thread_id)
+    return;
+
+  Run run = { time, new_thread_id };
+  runs.push_back(run);
+  if (runs.size() > max_runs_)
+    runs.pop_front();
+}
+
+void CpuTimelineService::OnThreadReady(const base::Time& time,
+                                       DWORD thread_id) {
+  base::AutoLock lock(lock_);
+
+  if (time > last_time_)
+    last_time_ = time;
+
+  // The first ready time counts, the thread has been ready since.
+  ready_times_.insert(std::make_pair(thread_id, time));
+}
+
+void CpuTimelineService::EndReadyInterval(DWORD thread_id,
+                                          const base::Time& time) {
+  lock_.AssertAcquired();
+
+  ReadyTimeMap::iterator it(ready_times_.find(thread_id));
+  if (it == ready_times_.end())
+    return;
+
+  ReadyInterval interval = { it->second, time, thread_id };
+  ready_times_.erase(it);
+  if (interval.end < interval.start)
+    return;
+
+  // Keep the queue ordered on the end of the intervals.
+  if (!ready_intervals_.empty() && interval.end < ready_intervals_.back().end)
+    return;
+
+  ready_intervals_.push_back(interval);
+  longest_ready_ = std::max(longest_ready_, interval.end - interval.start);
+  if (ready_intervals_.size() > max_runs_)
+    ready_intervals_.pop_front();
+}
@@ -0,0 +1,121 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// CPU timeline service declaration.
+#ifndef SAWBUCK_LOG_LIB_CPU_TIMELINE_SERVICE_H_
+#define SAWBUCK_LOG_LIB_CPU_TIMELINE_SERVICE_H_
+
+#include <deque>
+#include <map>
+#include <vector>
+#include "base/synchronization/lock.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+
+class ICpuTimelineService {
+ public:
+  // How a thread spent a stretch of time.
+  struct ThreadActivity {
+    // Time on a processor.
+    base::TimeDelta running_;
+    // Time ready to run, but waiting on a processor.
+    base::TimeDelta ready_;
+    // The rest, e.g. blocked on I/O or a lock.
+    base::TimeDelta waiting_;
+  };
+
+  // Retrieve how @p thread_id spent the time from @p from to @p to.
+  // @returns true iff the scheduler timeline covers some of that time.
+  virtual bool GetThreadActivity(DWORD thread_id,
+                                 const base::Time& from,
+                                 const base::Time& to,
+                                 ThreadActivity* activity) = 0;
+};
+
+// The CPU timeline service sinks the scheduler events of a kernel log
+// parser, and keeps a timeline of which thread ran on each processor. The
+// timeline is run length encoded, one entry per switch to a different
+// thread, and the oldest entries are dropped past a fixed count so that
+// memory stays bounded however long the capture runs.
+class CpuTimelineService
+    : public ICpuTimelineService,
+      public KernelSchedulerEvents {
+ public:
+  // The default number of runs kept per processor, and of ready intervals.
+  static const size_t kDefaultMaxRuns = 256 * 1024;
+
+  CpuTimelineService();
+  explicit CpuTimelineService(size_t max_runs);
+  ~CpuTimelineService();
+
+  // ICpuTimelineService implementation.
+  virtual bool GetThreadActivity(DWORD thread_id,
+                                 const base::Time& from,
+                                 const base::Time& to,
+                                 ThreadActivity* activity);
+
+  // KernelSchedulerEvents implementation.
+  virtual void OnContextSwitch(const base::Time& time,
+                               ULONG processor,
+                               DWORD old_thread_id,
+                               DWORD new_thread_id,
+                               int old_thread_state);
+  virtual void OnThreadReady(const base::Time& time,
+                             DWORD thread_id);
+
+ private:
+  // A thread's stint on a processor, lasting to the start of the next run.
+  struct Run {
+    base::Time start;
+    DWORD thread_id;
+
+    // Orders runs on their start.
+    bool operator<(const Run& other) const { return start < other.start; }
+  };
+  typedef std::deque<Run> RunQueue;
+
+  // A stretch of time a thread spent ready to run.
+  struct ReadyInterval {
+    base::Time start;
+    base::Time end;
+    DWORD thread_id;
+
+    // Orders intervals on their end.
+    bool operator<(const ReadyInterval& other) const {
+      return end < other.end;
+    }
+  };
+  typedef std::deque<ReadyInterval> ReadyIntervalQueue;
+
+  // Adds the ready interval of @p thread_id, if any, ending at @p time.
+  void EndReadyInterval(DWORD thread_id, const base::Time& time);
+
+  const size_t max_runs_;
+
+  base::Lock lock_;
+  // The runs on each processor, in time order. Under lock_.
+  std::vector<RunQueue> processors_;
+  // The ready intervals in order of their end. Under lock_.
+  ReadyIntervalQueue ready_intervals_;
+  // The longest ready interval, to bound searches. Under lock_.
+  base::TimeDelta longest_ready_;
+  // The start of the pending ready interval of each thread. Under lock_.
+  typedef std::map<DWORD, base::Time> ReadyTimeMap;
+  ReadyTimeMap ready_times_;
+  // The time of the latest event, which ends the last runs. Under lock_.
+  base::Time last_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(CpuTimelineService);
+};
+
+#endif  // SAWBUCK_LOG_LIB_CPU_TIMELINE_SERVICE_H_
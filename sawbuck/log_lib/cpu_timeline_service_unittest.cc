@@ -0,0 +1,104 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// CPU timeline service unittests.
+#include "sawbuck/log_lib/cpu_timeline_service.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+const DWORD kTid1 = 1234;
+const DWORD kTid2 = 4321;
+const int kStateWaiting = 5;
+const int kStateReady = 1;
+
+class CpuTimelineServiceTest: public testing::Test {
+ public:
+  CpuTimelineServiceTest() : kT0(base::Time::Now()) {
+  }
+
+  // @returns kT0 plus @p ms milliseconds.
+  base::Time At(int ms) {
+    return kT0 + base::TimeDelta::FromMilliseconds(ms);
+  }
+
+ protected:
+  const base::Time kT0;
+};
+
+}  // namespace
+
+TEST_F(CpuTimelineServiceTest, NoTimeline) {
+  CpuTimelineService service;
+  ICpuTimelineService::ThreadActivity activity;
+  EXPECT_FALSE(service.GetThreadActivity(kTid1, At(0), At(10), &activity));
+}
+
+TEST_F(CpuTimelineServiceTest, RunningReadyAndWaiting) {
+  CpuTimelineService service;
+
+  // Thread 1 runs on processor 0 from 0 to 10ms, and from 30 to 40ms,
+  // having been made ready at 20ms.
+  service.OnContextSwitch(At(0), 0, 0, kTid1, kStateWaiting);
+  service.OnContextSwitch(At(10), 0, kTid1, 0, kStateWaiting);
+  service.OnThreadReady(At(20), kTid1);
+  service.OnContextSwitch(At(30), 0, 0, kTid1, kStateWaiting);
+  service.OnContextSwitch(At(40), 0, kTid1, kTid2, kStateReady);
+  // Thread 2 runs on processor 1 too, which doesn't count for thread 1.
+  service.OnContextSwitch(At(5), 1, 0, kTid2, kStateWaiting);
+  service.OnContextSwitch(At(50), 1, kTid2, 0, kStateWaiting);
+
+  ICpuTimelineService::ThreadActivity activity;
+  ASSERT_TRUE(service.GetThreadActivity(kTid1, At(0), At(40), &activity));
+  EXPECT_EQ(20, activity.running_.InMilliseconds());
+  EXPECT_EQ(10, activity.ready_.InMilliseconds());
+  EXPECT_EQ(10, activity.waiting_.InMilliseconds());
+
+  // A window clips the runs.
+  ASSERT_TRUE(service.GetThreadActivity(kTid1, At(5), At(35), &activity));
+  EXPECT_EQ(10, activity.running_.InMilliseconds());
+  EXPECT_EQ(10, activity.ready_.InMilliseconds());
+  EXPECT_EQ(10, activity.waiting_.InMilliseconds());
+
+  // Thread 1 was preempted at 40ms, and is ready since.
+  ASSERT_TRUE(service.GetThreadActivity(kTid1, At(40), At(100), &activity));
+  EXPECT_EQ(0, activity.running_.InMilliseconds());
+  EXPECT_EQ(10, activity.ready_.InMilliseconds());
+  EXPECT_EQ(0, activity.waiting_.InMilliseconds());
+
+  // Thread 2 ran on both processors.
+  ASSERT_TRUE(service.GetThreadActivity(kTid2, At(0), At(50), &activity));
+  EXPECT_EQ(55, activity.running_.InMilliseconds());
+}
+
+TEST_F(CpuTimelineServiceTest, RunLengthEncodes) {
+  CpuTimelineService service(2);
+
+  // Switches back to the same thread extend its run.
+  service.OnContextSwitch(At(0), 0, 0, kTid1, kStateWaiting);
+  service.OnContextSwitch(At(10), 0, kTid1, kTid1, kStateReady);
+  service.OnContextSwitch(At(20), 0, kTid1, kTid1, kStateReady);
+  service.OnContextSwitch(At(30), 0, kTid1, kTid2, kStateWaiting);
+
+  ICpuTimelineService::ThreadActivity activity;
+  ASSERT_TRUE(service.GetThreadActivity(kTid1, At(0), At(30), &activity));
+  EXPECT_EQ(30, activity.running_.InMilliseconds());
+
+  // A third run drops the oldest, so the timeline only covers 40-50ms.
+  service.OnContextSwitch(At(40), 0, kTid2, kTid1, kStateWaiting);
+  service.OnContextSwitch(At(50), 0, kTid1, 0, kStateWaiting);
+  ASSERT_TRUE(service.GetThreadActivity(kTid1, At(0), At(50), &activity));
+  EXPECT_EQ(10, activity.running_.InMilliseconds());
+  EXPECT_EQ(0, activity.waiting_.InMilliseconds());
+}
@@ -0,0 +1,203 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Disk I/O latency service implementation.
+#include "sawbuck/log_lib/disk_io_latency_service.h"
+
+#include <algorithm>
+#include "base/logging.h"
+#include "sawbuck/log_lib/thread_info_service.h"
+
+namespace {
+
+// Orders file reads slowest first.
+bool IsSlower(const IDiskIoLatencyService::FileReads& a,
+              const IDiskIoLatencyService::FileReads& b) {
+  return a.total_latency_ > b.total_latency_;
+}
+
+}  // namespace
+
+const size_t DiskIoLatencyService::kDefaultMaxRecentReads;
+
+IDiskIoLatencyService::FileReads::FileReads()
+    : read_count_(0), bytes_read_(0) {
+}
+
+DiskIoLatencyService::LatencyStats::LatencyStats()
+    : bytes_read_(0), bytes_written_(0) {
+}
+
+DiskIoLatencyService::DiskIoLatencyService()
+    : thread_info_service_(NULL), max_recent_reads_(kDefaultMaxRecentReads) {
+  no_file_name_ = &*file_names_.insert(std::wstring()).first;
+}
+
+DiskIoLatencyService::DiskIoLatencyService(size_t max_recent_reads)
+    : thread_info_service_(NULL), max_recent_reads_(max_recent_reads) {
+  DCHECK_LT(0U, max_recent_reads);
+  no_file_name_ = &*file_names_.insert(std::wstring()).first;
+}
+
+DiskIoLatencyService::~DiskIoLatencyService() {
+}
+
+bool DiskIoLatencyService::GetFileStats(const std::wstring& file_name,
+                                        LatencyStats* stats) {
+  DCHECK(stats != NULL);
+  base::AutoLock lock(lock_);
+
+  std::set<std::wstring>::const_iterator name(file_names_.find(file_name));
+  if (name == file_names_.end())
+    return false;
+
+  FileStatsMap::const_iterator it(file_stats_.find(&*name));
+  if (it == file_stats_.end())
+    return false;
+
+  *stats = it->second;
+  return true;
+}
+
+bool DiskIoLatencyService::GetProcessStats(DWORD process_id,
+                                           LatencyStats* stats) {
+  DCHECK(stats != NULL);
+  base::AutoLock lock(lock_);
+
+  ProcessStatsMap::const_iterator it(process_stats_.find(process_id));
+  if (it == process_stats_.end())
+    return false;
+
+  *stats = it->second;
+  return true;
+}
+
+bool DiskIoLatencyService::GetRecentReadsTimeRange(base::Time* first,
+                                                   base::Time* last) {
+  DCHECK(first != NULL && last != NULL);
+  base::AutoLock lock(lock_);
+
+  if (recent_reads_.empty())
+    return false;
+
+  *first = recent_reads_.front().time;
+  *last = recent_reads_.back().time;
+  return true;
+}
+
+void DiskIoLatencyService::GetSlowestFileReads(const base::Time& from,
+                                               const base::Time& to,
+                                               size_t max_files,
+                                               std::vector<FileReads>* files) {
+  DCHECK(files != NULL);
+  files->clear();
+
+  typedef std::map<const std::wstring*, LatencyHistogram> HistogramMap;
+  HistogramMap histograms;
+  std::map<const std::wstring*, uint64> bytes_read;
+  {
+    base::AutoLock lock(lock_);
+    for (size_t i = 0; i < recent_reads_.size(); ++i) {
+      const RecentRead& read = recent_reads_[i];
+      if (read.time < from || read.time > to)
+        continue;
+
+      histograms[read.file_name].Add(read.latency);
+      bytes_read[read.file_name] += read.byte_count;
+    }
+  }
+
+  HistogramMap::const_iterator it(histograms.begin());
+  for (; it != histograms.end(); ++it) {
+    const LatencyHistogram& histogram = it->second;
+    FileReads file;
+    // The names are never released, so are safe to use outside the lock.
+    file.file_name_ = *it->first;
+    file.read_count_ = histogram.count();
+    file.bytes_read_ = bytes_read[it->first];
+    file.total_latency_ = histogram.total();
+    file.p50_latency_ = histogram.GetPercentile(50);
+    file.p95_latency_ = histogram.GetPercentile(95);
+    file.max_latency_ = histogram.max();
+    files->push_back(file);
+  }
+
+  std::sort(files->begin(), files->end(), IsSlower);
+  if (files->size() > max_files)
+    files->resize(max_files);
+}
+
+void DiskIoLatencyService::OnDiskIo(const base::Time& time,
+                                    DWORD process_id,
+                                    DWORD thread_id,
+                                    bool is_write,
+                                    ULONG disk_number,
+                                    uint64 byte_offset,
+                                    ULONG transfer_size,
+                                    sym_util::Address file_object,
+                                    const base::TimeDelta& latency) {
+  // The thread info service has its own lock, look the process up first.
+  IThreadInfoService::ThreadInfo thread_info = {};
+  if (thread_info_service_ != NULL &&
+      thread_info_service_->GetThreadInfo(thread_id, time, &thread_info)) {
+    process_id = thread_info.process_id_;
+  }
+
+  base::AutoLock lock(lock_);
+
+  const std::wstring* file_name = no_file_name_;
+  FileObjectMap::const_iterator it(file_objects_.find(file_object));
+  if (it != file_objects_.end())
+    file_name = it->second;
+
+  AddIo(is_write, transfer_size, latency, &file_stats_[file_name]);
+  AddIo(is_write, transfer_size, latency, &process_stats_[process_id]);
+
+  if (is_write)
+    return;
+
+  RecentRead read = { time, file_name, transfer_size, latency };
+  recent_reads_.push_back(read);
+  if (recent_reads_.size() > max_recent_reads_)
+    recent_reads_.pop_front();
+}
+
+void DiskIoLatencyService::OnFileName(const base::Time& time,
+                                      sym_util::Address file_object,
+                                      const std::wstring& file_name) {
+  base::AutoLock lock(lock_);
+
+  file_objects_[file_object] = &*file_names_.insert(file_name).first;
+}
+
+void DiskIoLatencyService::OnFileDeleted(const base::Time& time,
+                                         sym_util::Address file_object) {
+  base::AutoLock lock(lock_);
+
+  file_objects_.erase(file_object);
+}
+
+void DiskIoLatencyService::AddIo(bool is_write, ULONG byte_count,
+                                 const base::TimeDelta& latency,
+                                 LatencyStats* stats) {
+  DCHECK(stats != NULL);
+
+  if (is_write) {
+    stats->write_latency_.Add(latency);
+    stats->bytes_written_ += byte_count;
+  } else {
+    stats->read_latency_.Add(latency);
+    stats->bytes_read_ += byte_count;
+  }
+}
@@ -0,0 +1,162 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Disk I/O latency service declaration.
+#ifndef SAWBUCK_LOG_LIB_DISK_IO_LATENCY_SERVICE_H_
+#define SAWBUCK_LOG_LIB_DISK_IO_LATENCY_SERVICE_H_
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "base/synchronization/lock.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/log_lib/latency_histogram.h"
+
+class IThreadInfoService;
+
+class IDiskIoLatencyService {
+ public:
+  // The disk reads of a file over a stretch of time.
+  struct FileReads {
+    FileReads();
+
+    // The name of the file, empty if the log didn't name it.
+    std::wstring file_name_;
+    uint64 read_count_;
+    uint64 bytes_read_;
+    // The time spent waiting on the reads, in all and the worst of it.
+    base::TimeDelta total_latency_;
+    base::TimeDelta p50_latency_;
+    base::TimeDelta p95_latency_;
+    base::TimeDelta max_latency_;
+  };
+
+  // Retrieve the files whose reads completing from @p from to @p to took
+  // the longest in all, slowest first, to @p files.
+  // @param max_files the most files to retrieve.
+  virtual void GetSlowestFileReads(const base::Time& from,
+                                   const base::Time& to,
+                                   size_t max_files,
+                                   std::vector<FileReads>* files) = 0;
+};
+
+// The disk I/O latency service sinks the disk I/O events of a kernel log
+// parser. It keeps streaming latency histograms of the reads and writes of
+// each file and each process for the whole of the log, and the most recent
+// reads for reports over a stretch of time. The histograms are of bounded
+// size, and the recent reads are capped, so memory only grows with the
+// number of distinct files and processes.
+class DiskIoLatencyService
+    : public IDiskIoLatencyService,
+      public KernelDiskIoEvents {
+ public:
+  // The default number of recent reads kept for GetSlowestFileReads.
+  static const size_t kDefaultMaxRecentReads = 64 * 1024;
+
+  // The latencies of a file or a process.
+  struct LatencyStats {
+    LatencyStats();
+
+    LatencyHistogram read_latency_;
+    LatencyHistogram write_latency_;
+    uint64 bytes_read_;
+    uint64 bytes_written_;
+  };
+
+  DiskIoLatencyService();
+  explicit DiskIoLatencyService(size_t max_recent_reads);
+  ~DiskIoLatencyService();
+
+  // Sets the service we tie the issuing threads of the I/O to their
+  // processes with. Without it we go by the event headers, which don't
+  // reliably name the issuing process.
+  void set_thread_info_service(IThreadInfoService* thread_info_service) {
+    thread_info_service_ = thread_info_service;
+  }
+
+  // Retrieve the latencies of @p file_name, or of @p process_id, over the
+  // whole of the log.
+  // @returns true iff the file or process did any disk I/O.
+  bool GetFileStats(const std::wstring& file_name, LatencyStats* stats);
+  bool GetProcessStats(DWORD process_id, LatencyStats* stats);
+
+  // Retrieve the completion times of the first and last recent reads.
+  // @returns true iff there are any.
+  bool GetRecentReadsTimeRange(base::Time* first, base::Time* last);
+
+  // IDiskIoLatencyService implementation.
+  virtual void GetSlowestFileReads(const base::Time& from,
+                                   const base::Time& to,
+                                   size_t max_files,
+                                   std::vector<FileReads>* files);
+
+  // KernelDiskIoEvents implementation.
+  virtual void OnDiskIo(const base::Time& time,
+                        DWORD process_id,
+                        DWORD thread_id,
+                        bool is_write,
+                        ULONG disk_number,
+                        uint64 byte_offset,
+                        ULONG transfer_size,
+                        sym_util::Address file_object,
+                        const base::TimeDelta& latency);
+  virtual void OnFileName(const base::Time& time,
+                          sym_util::Address file_object,
+                          const std::wstring& file_name);
+  virtual void OnFileDeleted(const base::Time& time,
+                             sym_util::Address file_object);
+
+ private:
+  // A read, as kept for reports over a stretch of time.
+  struct RecentRead {
+    base::Time time;
+    const std::wstring* file_name;
+    ULONG byte_count;
+    base::TimeDelta latency;
+  };
+
+  // Adds an I/O of @p byte_count bytes taking @p latency to @p stats.
+  static void AddIo(bool is_write, ULONG byte_count,
+                    const base::TimeDelta& latency, LatencyStats* stats);
+
+  IThreadInfoService* thread_info_service_;
+  const size_t max_recent_reads_;
+
+  base::Lock lock_;
+
+  // The file names we've seen, interned, starting with the empty name of
+  // unnamed files. Under lock_.
+  std::set<std::wstring> file_names_;
+  const std::wstring* no_file_name_;
+
+  // The names of the live file objects. Under lock_.
+  typedef std::map<sym_util::Address, const std::wstring*> FileObjectMap;
+  FileObjectMap file_objects_;
+
+  // The latencies by file, keyed by interned name, and by process.
+  // Under lock_.
+  typedef std::map<const std::wstring*, LatencyStats> FileStatsMap;
+  FileStatsMap file_stats_;
+  typedef std::map<DWORD, LatencyStats> ProcessStatsMap;
+  ProcessStatsMap process_stats_;
+
+  // The recent reads in order of completion. Under lock_.
+  std::deque<RecentRead> recent_reads_;
+
+  DISALLOW_COPY_AND_ASSIGN(DiskIoLatencyService);
+};
+
+#endif  // SAWBUCK_LOG_LIB_DISK_IO_LATENCY_SERVICE_H_
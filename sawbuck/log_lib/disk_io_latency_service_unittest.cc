@@ -0,0 +1,172 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Disk I/O latency service unittests.
+#include "sawbuck/log_lib/disk_io_latency_service.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "sawbuck/log_lib/thread_info_service.h"
+
+namespace {
+
+using testing::_;
+using testing::DoAll;
+using testing::Return;
+using testing::SetArgPointee;
+
+const DWORD kPid = 1234;
+const DWORD kTid = 4321;
+const sym_util::Address kFooObject = 0x80001000;
+const sym_util::Address kBarObject = 0x80002000;
+
+class MockThreadInfoService: public IThreadInfoService {
+ public:
+  MOCK_METHOD3(GetThreadInfo, bool(DWORD thread_id, const base::Time& time,
+                                   ThreadInfo* info));
+};
+
+class DiskIoLatencyServiceTest: public testing::Test {
+ public:
+  DiskIoLatencyServiceTest() : kT0(base::Time::Now()) {
+  }
+
+  virtual void SetUp() {
+    service_.OnFileName(kT0, kFooObject, L"c:\\foo.dll");
+    service_.OnFileName(kT0, kBarObject, L"c:\\bar.dll");
+  }
+
+  // @returns kT0 plus @p ms milliseconds.
+  base::Time At(int ms) {
+    return kT0 + base::TimeDelta::FromMilliseconds(ms);
+  }
+
+  // Issues a read of @p file_object of @p byte_count bytes at @p time,
+  // taking @p latency_ms.
+  void Read(const base::Time& time, sym_util::Address file_object,
+            ULONG byte_count, int latency_ms) {
+    service_.OnDiskIo(time, kPid, kTid, false, 0, 0, byte_count, file_object,
+                      base::TimeDelta::FromMilliseconds(latency_ms));
+  }
+
+ protected:
+  DiskIoLatencyService service_;
+  const base::Time kT0;
+};
+
+}  // namespace
+
+TEST_F(DiskIoLatencyServiceTest, SlowestFileReads) {
+  Read(At(10), kFooObject, 0x1000, 5);
+  Read(At(20), kFooObject, 0x2000, 10);
+  Read(At(30), kBarObject, 0x1000, 20);
+  // An unnamed file object.
+  Read(At(40), 0x80003000, 0x1000, 1);
+  // Writes don't make the read reports.
+  service_.OnDiskIo(At(40), kPid, kTid, true, 0, 0, 0x1000, kFooObject,
+                    base::TimeDelta::FromMilliseconds(100));
+
+  std::vector<IDiskIoLatencyService::FileReads> files;
+  service_.GetSlowestFileReads(At(0), At(50), 10, &files);
+  ASSERT_EQ(3U, files.size());
+  EXPECT_EQ(L"c:\\bar.dll", files[0].file_name_);
+  EXPECT_EQ(L"c:\\foo.dll", files[1].file_name_);
+  EXPECT_EQ(2U, files[1].read_count_);
+  EXPECT_EQ(0x3000U, files[1].bytes_read_);
+  EXPECT_EQ(15, files[1].total_latency_.InMilliseconds());
+  EXPECT_EQ(10, files[1].max_latency_.InMilliseconds());
+  EXPECT_EQ(L"", files[2].file_name_);
+
+  // Only the reads in the window count.
+  service_.GetSlowestFileReads(At(15), At(25), 10, &files);
+  ASSERT_EQ(1U, files.size());
+  EXPECT_EQ(L"c:\\foo.dll", files[0].file_name_);
+  EXPECT_EQ(1U, files[0].read_count_);
+
+  service_.GetSlowestFileReads(At(0), At(50), 1, &files);
+  ASSERT_EQ(1U, files.size());
+  EXPECT_EQ(L"c:\\bar.dll", files[0].file_name_);
+
+  base::Time first;
+  base::Time last;
+  ASSERT_TRUE(service_.GetRecentReadsTimeRange(&first, &last));
+  EXPECT_TRUE(At(10) == first);
+  EXPECT_TRUE(At(40) == last);
+}
+
+TEST_F(DiskIoLatencyServiceTest, FileAndProcessStats) {
+  Read(At(10), kFooObject, 0x1000, 5);
+  service_.OnDiskIo(At(20), kPid + 1, kTid, true, 0, 0, 0x2000, kFooObject,
+                    base::TimeDelta::FromMilliseconds(7));
+
+  DiskIoLatencyService::LatencyStats stats;
+  ASSERT_TRUE(service_.GetFileStats(L"c:\\foo.dll", &stats));
+  EXPECT_EQ(1U, stats.read_latency_.count());
+  EXPECT_EQ(1U, stats.write_latency_.count());
+  EXPECT_EQ(0x1000U, stats.bytes_read_);
+  EXPECT_EQ(0x2000U, stats.bytes_written_);
+  EXPECT_FALSE(service_.GetFileStats(L"c:\\bar.dll", &stats));
+
+  ASSERT_TRUE(service_.GetProcessStats(kPid, &stats));
+  EXPECT_EQ(1U, stats.read_latency_.count());
+  EXPECT_EQ(0U, stats.write_latency_.count());
+  ASSERT_TRUE(service_.GetProcessStats(kPid + 1, &stats));
+  EXPECT_EQ(7, stats.write_latency_.max().InMilliseconds());
+}
+
+TEST_F(DiskIoLatencyServiceTest, DeletedFileObjects) {
+  service_.OnFileDeleted(At(5), kFooObject);
+  Read(At(10), kFooObject, 0x1000, 5);
+
+  std::vector<IDiskIoLatencyService::FileReads> files;
+  service_.GetSlowestFileReads(At(0), At(50), 10, &files);
+  ASSERT_EQ(1U, files.size());
+  EXPECT_EQ(L"", files[0].file_name_);
+}
+
+TEST_F(DiskIoLatencyServiceTest, RecentReadsAreCapped) {
+  DiskIoLatencyService service(2);
+  service.OnDiskIo(At(10), kPid, kTid, false, 0, 0, 0x1000, kFooObject,
+                   base::TimeDelta());
+  service.OnDiskIo(At(20), kPid, kTid, false, 0, 0, 0x1000, kFooObject,
+                   base::TimeDelta());
+  service.OnDiskIo(At(30), kPid, kTid, false, 0, 0, 0x1000, kFooObject,
+                   base::TimeDelta());
+
+  base::Time first;
+  base::Time last;
+  ASSERT_TRUE(service.GetRecentReadsTimeRange(&first, &last));
+  EXPECT_TRUE(At(20) == first);
+
+  // The running stats still count them all.
+  DiskIoLatencyService::LatencyStats stats;
+  ASSERT_TRUE(service.GetProcessStats(kPid, &stats));
+  EXPECT_EQ(3U, stats.read_latency_.count());
+}
+
+TEST_F(DiskIoLatencyServiceTest, AttributesToIssuingProcess) {
+  MockThreadInfoService thread_info_service;
+  service_.set_thread_info_service(&thread_info_service);
+
+  IThreadInfoService::ThreadInfo info = {};
+  info.thread_id_ = kTid;
+  info.process_id_ = kPid + 10;
+  EXPECT_CALL(thread_info_service, GetThreadInfo(kTid, _, _))
+      .WillOnce(DoAll(SetArgPointee<2>(info), Return(true)));
+  Read(At(10), kFooObject, 0x1000, 5);
+
+  DiskIoLatencyService::LatencyStats stats;
+  EXPECT_FALSE(service_.GetProcessStats(kPid, &stats));
+  EXPECT_TRUE(service_.GetProcessStats(kPid + 10, &stats));
+}
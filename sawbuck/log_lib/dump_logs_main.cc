@@ -12,16 +12,47 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 //
+#include <fcntl.h>
+#include <io.h>
+#include <stdio.h>
+#include <algorithm>
 #include <iostream>
 #include "base/at_exit.h"
+#include "base/bind.h"
 #include "base/command_line.h"
+#include "base/files/file_path.h"
 #include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop/message_loop.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/strings/stringprintf.h"
 #include "base/strings/string_piece.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
 #include "base/strings/utf_string_conversions.h"
+#include "base/threading/thread.h"
 #include "base/win/event_trace_consumer.h"
+#include "sawbuck/log_lib/disk_io_latency_service.h"
+#include "sawbuck/log_lib/etl_file_reader.h"
+#include "sawbuck/log_lib/event_router.h"
+#include "sawbuck/log_lib/heap_profile_service.h"
+#include "sawbuck/log_lib/heap_trace_session.h"
+#include "sawbuck/log_lib/log_export_reader.h"
+#include "sawbuck/log_lib/log_export_writer.h"
 #include "sawbuck/log_lib/kernel_log_consumer.h"
 #include "sawbuck/log_lib/log_consumer.h"
+#include "sawbuck/log_lib/page_fault_aggregator.h"
+#include "sawbuck/log_lib/process_info_service.h"
+#include "sawbuck/log_lib/stack_symbolizer.h"
+#include "sawbuck/log_lib/string_table.h"
+#include "sawbuck/log_lib/symbol_lookup_service.h"
+#include "sawbuck/log_lib/time_formatter.h"
+#include "sawbuck/log_lib/trace_json_writer.h"
+#include "sawbuck/log_lib/trace_span_matcher.h"
+#include "sawbuck/log_lib/working_set_profiler.h"
+#include "sawbuck/viewer/log_query.h"
+#include "sawbuck/viewer/log_store.h"
 
 
 // The log consumer class we use to parse the logs on our behalf.
@@ -36,9 +67,18 @@ class DumpLogConsumer
 
   static void ProcessEvent(EVENT_TRACE* event);
 
+  size_t unhandled_event_count() const { return unhandled_event_count_; }
+
  private:
   virtual void ProcessOneEvent(EVENT_TRACE* event);
 
+  // Unhandled events are counted rather than logged, as there tend to be
+  // a lot of them.
+  size_t unhandled_event_count_;
+
+  // Routes the events to the parser for their class.
+  EventRouter router_;
+
   // Our current instance pointer, used to route the
   // log events to our sole instance.
   static DumpLogConsumer* current_;
@@ -46,9 +86,12 @@ class DumpLogConsumer
 
 DumpLogConsumer* DumpLogConsumer::current_ = NULL;
 
-DumpLogConsumer::DumpLogConsumer() {
+DumpLogConsumer::DumpLogConsumer() : unhandled_event_count_(0) {
   DCHECK(current_ == NULL);
   current_ = this;
+
+  LogParser::AddEventClasses(&router_);
+  KernelLogParser::AddEventClasses(&router_);
 }
 
 DumpLogConsumer::~DumpLogConsumer() {
@@ -63,10 +106,89 @@ void DumpLogConsumer::ProcessEvent(EVENT_TRACE* event) {
 }
 
 void DumpLogConsumer::ProcessOneEvent(EVENT_TRACE* event) {
-  if (!LogParser::ProcessOneEvent(event) &&
-      !KernelLogParser::ProcessOneEvent(event)) {
-    LOG(INFO) << "Unhandled event";
+  if (!router_.ProcessOneEvent(event))
+    ++unhandled_event_count_;
+}
+
+// Parses one log file into a sorted run of binary export rows, for the
+// --jobs mode to merge.
+class ExportJob
+    : public EtlEventSink,
+      public KernelLogParser,
+      public LogParser {
+ public:
+  ExportJob(const base::FilePath& path, const LogParser::EventFilter& filter);
+  ~ExportJob();
+
+  // Parses the file into the run, on a worker thread.
+  void Run();
+
+  // Accessors, valid once run.
+  // @{
+  const base::FilePath& path() const { return path_; }
+  HRESULT result() const { return result_; }
+  // The run, rewound for reading.
+  FILE* run() const { return run_; }
+  size_t unhandled_event_count() const { return unhandled_event_count_; }
+  // @}
+
+ private:
+  // EtlEventSink implementation.
+  virtual void OnEvent(EVENT_TRACE* event);
+
+  base::FilePath path_;
+  EventRouter router_;
+  FILE* run_;
+  HRESULT result_;
+  size_t unhandled_event_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(ExportJob);
+};
+
+ExportJob::ExportJob(const base::FilePath& path,
+                     const LogParser::EventFilter& filter)
+    : path_(path), run_(NULL), result_(E_PENDING), unhandled_event_count_(0) {
+  LogParser::AddEventClasses(&router_);
+  KernelLogParser::AddEventClasses(&router_);
+  set_event_filter(filter);
+}
+
+ExportJob::~ExportJob() {
+  if (run_ != NULL)
+    fclose(run_);
+}
+
+void ExportJob::Run() {
+  run_ = tmpfile();
+  if (run_ == NULL) {
+    result_ = E_FAIL;
+    return;
   }
+
+  EtlFileReader reader;
+  result_ = reader.Open(path_);
+  if (FAILED(result_))
+    return;
+
+  // The writer copies the rows as they come, so there's no need to hold
+  // on to the mapped file beyond the reading.
+  LogExportWriter::FileOutput output(run_);
+  LogExportWriter writer(LogExportWriter::BINARY, &output,
+                         LogExportWriter::kDefaultBufferSize);
+  set_event_sink(&writer);
+  set_trace_sink(&writer);
+  result_ = reader.Consume(this);
+  set_event_sink(NULL);
+  set_trace_sink(NULL);
+
+  if (SUCCEEDED(result_) && !writer.Flush())
+    result_ = E_FAIL;
+  rewind(run_);
+}
+
+void ExportJob::OnEvent(EVENT_TRACE* event) {
+  if (!router_.ProcessOneEvent(event))
+    ++unhandled_event_count_;
 }
 
 class LogDumpHandler
@@ -144,6 +266,10 @@ class LogDumpHandler
       const TraceEvents::TraceMessage& trace_message);
   virtual void OnTraceEventInstant(
       const TraceEvents::TraceMessage& trace_message);
+
+ private:
+  // Formats the time stamps of log messages.
+  TimeFormatter time_formatter_;
 };
 
 void LogDumpHandler::OnModuleIsLoaded(DWORD process_id,
@@ -278,7 +404,18 @@ void LogDumpHandler::OnProcessEnded(const base::Time& time,
 
 // LogEvents implementation.
 void LogDumpHandler::OnLogMessage(const LogEvents::LogMessage& log_msg) {
-  // TODO(siggi): implement me..
+  char time[TimeFormatter::kMaxLength];
+  time_formatter_.Format(log_msg.time, time);
+
+  std::wcout << time << L'\t'
+      << static_cast<int>(log_msg.level) << L'\t'
+      << log_msg.process_id << L'\t'
+      << log_msg.thread_id << L'\t'
+      << base::UTF8ToWide(base::StringPiece(log_msg.file, log_msg.file_len))
+      << L'(' << log_msg.line << L")\t"
+      << base::UTF8ToWide(base::StringPiece(log_msg.message,
+                                            log_msg.message_len))
+      << L'\n';
 }
 
 void LogDumpHandler::OnTraceEventBegin(
@@ -296,19 +433,754 @@ void LogDumpHandler::OnTraceEventInstant(
   // TODO(siggi): implement me..
 }
 
+// Stores the log messages, for a --query to run over once consumed.
+class QueryHandler : public LogEvents {
+ public:
+  QueryHandler() : store_(&file_table_) {
+  }
+
+  const LogStore& store() const { return store_; }
+
+ private:
+  // LogEvents implementation.
+  virtual void OnLogMessage(const LogEvents::LogMessage& log_msg) {
+    store_.AddLogMessage(log_msg);
+  }
+
+  StringTable file_table_;
+  LogStore store_;
+
+  DISALLOW_COPY_AND_ASSIGN(QueryHandler);
+};
+
+// Dumps the log messages for --symbolize, each followed by its stack trace
+// symbolized. The files are read twice: the first pass gathers the traces
+// to the symbolizer, which then resolves their distinct frames in bulk,
+// and the second pass dumps the log messages as LogDumpHandler does.
+class SymbolizedLogDumper : public LogDumpHandler {
+ public:
+  explicit SymbolizedLogDumper(StackSymbolizer* symbolizer);
+
+  // Resolves the frames gathered, and sets up for the dumping pass.
+  void ResolveFrames();
+
+ private:
+  // LogEvents implementation.
+  virtual void OnLogMessage(const LogEvents::LogMessage& msg);
+
+  StackSymbolizer* symbolizer_;
+  bool dumping_;
+
+  // Scratch buffers, reused from message to message.
+  std::vector<sym_util::Address> addresses_;
+  std::vector<const sym_util::SymbolRecord*> symbols_;
+
+  DISALLOW_COPY_AND_ASSIGN(SymbolizedLogDumper);
+};
+
+SymbolizedLogDumper::SymbolizedLogDumper(StackSymbolizer* symbolizer)
+    : symbolizer_(symbolizer), dumping_(false) {
+  DCHECK(symbolizer != NULL);
+}
+
+void SymbolizedLogDumper::ResolveFrames() {
+  DCHECK(!dumping_);
+  symbolizer_->ResolveFrames();
+  dumping_ = true;
+}
+
+void SymbolizedLogDumper::OnLogMessage(const LogEvents::LogMessage& msg) {
+  addresses_.resize(msg.trace_depth);
+  for (size_t i = 0; i < msg.trace_depth; ++i)
+    addresses_[i] = reinterpret_cast<sym_util::Address>(msg.traces[i]);
+  const sym_util::Address* frames =
+      addresses_.empty() ? NULL : &addresses_[0];
+  if (!dumping_) {
+    symbolizer_->AddTrace(msg.process_id, msg.time, frames,
+                          addresses_.size());
+    return;
+  }
+
+  LogDumpHandler::OnLogMessage(msg);
+  symbolizer_->GetSymbols(msg.process_id, msg.time, frames, addresses_.size(),
+                          &symbols_);
+  for (size_t i = 0; i < symbols_.size(); ++i) {
+    std::wcout << base::StringPrintf(L"\t0x%08llX", addresses_[i]);
+    const sym_util::SymbolRecord* symbol = symbols_[i];
+    if (symbol != NULL) {
+      if (!symbol->name->empty()) {
+        std::wcout << L'\t' << *symbol->module << L'!' << *symbol->name
+            << base::StringPrintf(L"+0x%X", symbol->offset);
+      }
+      if (!symbol->file->empty())
+        std::wcout << L'\t' << *symbol->file << L'(' << symbol->line << L')';
+    }
+    std::wcout << L'\n';
+  }
+}
+
+const wchar_t kUsage[] =
+    L"Usage: dump_logs [options] <log file>...\n"
+    L"Dumps the log messages and kernel events of the log files.\n"
+    L"\n"
+    L"Options:\n"
+    L"  --pid=<pid>          Only the events of process <pid>.\n"
+    L"  --level=<level>      Only the log messages of <level> and below.\n"
+    L"  --from=<seconds>     Only the events from <seconds> in.\n"
+    L"  --to=<seconds>       Only the events up to <seconds> in.\n"
+    L"  --format=<format>    Exports the events as csv, jsonl, binary or\n"
+    L"                       trace event JSON, to --out=<file> or stdout.\n"
+    L"  --jobs=<count>       Reads the files on <count> threads to export.\n"
+    L"  --query=<query>      Runs <query> on the log messages.\n"
+    L"  --disk-io            Reports the slowest file reads, from\n"
+    L"                       --disk-io-from=<seconds> to\n"
+    L"                       --disk-io-to=<seconds>.\n"
+    L"  --page-faults        Reports the page faults by kind, and the\n"
+    L"                       modules and pages that fault the most, rather\n"
+    L"                       than dump the kernel events.\n"
+    L"  --working-set        Reports the pages each module read in, in\n"
+    L"                       order, rather than dump the kernel events.\n"
+    L"  --page-order=<file>  With --working-set, writes the order in which\n"
+    L"                       the pages of --page-order-module=<image>, e.g.\n"
+    L"                       chrome.dll, were first read in to <file>.\n"
+    L"  --heap               Reports the stacks holding the most live heap\n"
+    L"                       bytes in each process, or in --pid only.\n"
+    L"  --heap-images=<images> Captures the heap events of the processes of\n"
+    L"                       the ;-separated <images> started over the next\n"
+    L"                       --heap-seconds=<seconds>, 30 by default, and\n"
+    L"                       reports as --heap does. Takes no log files.\n"
+    L"  --symbolize          Dumps the log messages with their stack traces\n"
+    L"                       symbolized.\n"
+    L"  --symbol-path=<path> The symbol path for --symbolize. A\n"
+    L"                       \"breakpad*<dir>\" element resolves the modules\n"
+    L"                       with a Breakpad symbol file in <dir> from it,\n"
+    L"                       the others go to DbgHelp.\n"
+    L"  --symbol-cache=<file> Keeps the symbols resolved in <file> from run\n"
+    L"                       to run.\n";
+
 int Error(const std::wstring& error) {
   std::wcout << error << std::endl;
 
   return 1;
 }
 
+// The most files we list in the disk I/O report.
+const size_t kMaxReportFiles = 25;
+
+// Lists the files whose disk reads took longest. The --disk-io-from and
+// --disk-io-to switches narrow the report to a window, in seconds from the
+// first read.
+void PrintSlowestFileReads(const CommandLine& cmd_line,
+                           DiskIoLatencyService* disk_io) {
+  DCHECK(disk_io != NULL);
+
+  base::Time first;
+  base::Time last;
+  if (!disk_io->GetRecentReadsTimeRange(&first, &last)) {
+    std::wcout << L"No disk reads in the logs." << std::endl;
+    return;
+  }
+
+  base::Time from = first;
+  base::Time to = last;
+  int seconds = 0;
+  if (base::StringToInt(cmd_line.GetSwitchValueASCII("disk-io-from"),
+                        &seconds)) {
+    from = first + base::TimeDelta::FromSeconds(seconds);
+  }
+  if (base::StringToInt(cmd_line.GetSwitchValueASCII("disk-io-to"),
+                        &seconds)) {
+    to = first + base::TimeDelta::FromSeconds(seconds);
+  }
+
+  std::vector<IDiskIoLatencyService::FileReads> files;
+  disk_io->GetSlowestFileReads(from, to, kMaxReportFiles, &files);
+
+  std::wcout << L"Slowest file reads, " << (from - first).InSecondsF()
+      << L"s to " << (to - first).InSecondsF() << L"s:\n"
+      << L"Total ms\tReads\tKB\tMedian ms\t95th ms\tMax ms\tFile\n";
+  for (size_t i = 0; i < files.size(); ++i) {
+    const IDiskIoLatencyService::FileReads& file = files[i];
+    std::wcout << file.total_latency_.InMillisecondsF() << L'\t'
+        << file.read_count_ << L'\t'
+        << file.bytes_read_ / 1024 << L'\t'
+        << file.p50_latency_.InMillisecondsF() << L'\t'
+        << file.p95_latency_.InMillisecondsF() << L'\t'
+        << file.max_latency_.InMillisecondsF() << L'\t'
+        << (file.file_name_.empty() ? L"(unknown)" : file.file_name_)
+        << L'\n';
+  }
+}
+
+// The width of the time buckets of the page fault report, which only
+// reports the totals.
+const int kPageFaultBucketSeconds = 1;
+
+// The most modules and pages we list in the page fault report.
+const size_t kMaxReportModules = 25;
+const size_t kMaxReportPages = 25;
+
+// Prints the headers of the columns of PrintFaultCounts.
+void PrintFaultCountsHeader() {
+  std::wcout << L"Faults\tTransition\tDemand zero\tCopy on write\tGuard\t"
+      << L"Hard\tAccess violation\tHard KB\tHard ms\t";
+}
+
+// Prints @p counts, a column per kind of fault.
+void PrintFaultCounts(const PageFaultAggregator::FaultCounts& counts) {
+  std::wcout << counts.total_faults() << L'\t';
+  for (int i = 0; i < PageFaultAggregator::FAULT_KIND_MAX; ++i)
+    std::wcout << counts.faults[i] << L'\t';
+  std::wcout << counts.hard_fault_bytes / 1024 << L'\t'
+      << counts.hard_fault_time.InMillisecondsF() << L'\t';
+}
+
+// Lists the page faults of the logs by kind, with the hard fault I/O, and
+// the modules and pages that faulted the most.
+void PrintPageFaults(const PageFaultAggregator& page_faults) {
+  const PageFaultAggregator::FaultCounts& totals = page_faults.totals();
+  if (totals.total_faults() == 0) {
+    std::wcout << L"No page faults in the logs." << std::endl;
+    return;
+  }
+
+  std::wcout << L"Page faults:\n";
+  PrintFaultCountsHeader();
+  std::wcout << L'\n';
+  PrintFaultCounts(totals);
+  std::wcout << L'\n';
+
+  std::vector<PageFaultAggregator::ModuleFaults> modules;
+  page_faults.GetTopModules(kMaxReportModules, &modules);
+  std::wcout << L"\nModules that faulted the most:\n";
+  PrintFaultCountsHeader();
+  std::wcout << L"Module\n";
+  for (size_t i = 0; i < modules.size(); ++i) {
+    PrintFaultCounts(modules[i].counts);
+    const std::wstring& name = modules[i].module.image_file_name;
+    std::wcout << (name.empty() ? L"(no module)" : name) << L'\n';
+  }
+
+  std::vector<PageFaultAggregator::PageFaults> pages;
+  page_faults.GetTopPages(kMaxReportPages, &pages);
+  std::wcout << L"\nPages that faulted the most:\n";
+  PrintFaultCountsHeader();
+  std::wcout << L"Page\n";
+  for (size_t i = 0; i < pages.size(); ++i) {
+    PrintFaultCounts(pages[i].counts);
+    const std::wstring& name = pages[i].module.image_file_name;
+    if (name.empty())
+      std::wcout << base::StringPrintf(L"0x%08llX\n", pages[i].page);
+    else
+      std::wcout << name << base::StringPrintf(L"+0x%llX\n", pages[i].page);
+  }
+}
+
+// Lists the pages each module read in, in the order they came in, with
+// the time from the module's first page-in and the time spent waiting.
+void PrintWorkingSet(
+    const std::vector<WorkingSetProfiler::ModuleTimeline>& timelines) {
+  if (timelines.empty()) {
+    std::wcout << L"No module pages read in the logs." << std::endl;
+    return;
+  }
+
+  for (size_t i = 0; i < timelines.size(); ++i) {
+    const WorkingSetProfiler::ModuleTimeline& timeline = timelines[i];
+    std::wcout << timeline.module.image_file_name << L": "
+        << timeline.page_ins.size() << L" page-ins, "
+        << timeline.total_bytes / 1024 << L" KB, "
+        << timeline.total_latency.InMillisecondsF() << L" ms\n"
+        << L"At ms\tWait ms\tRVA\tSection\n";
+
+    base::Time first = timeline.page_ins.front().time;
+    for (size_t j = 0; j < timeline.page_ins.size(); ++j) {
+      const WorkingSetProfiler::PageIn& page_in = timeline.page_ins[j];
+      std::wcout << (page_in.time - first).InMillisecondsF() << L'\t'
+          << page_in.latency.InMillisecondsF() << L'\t'
+          << base::StringPrintf(L"0x%08llX\t", page_in.rva);
+      if (page_in.section != WorkingSetProfiler::kNoSection) {
+        std::wcout << base::UTF8ToWide(
+            timeline.sections[page_in.section].name);
+      }
+      std::wcout << L'\n';
+    }
+    std::wcout << L'\n';
+  }
+}
+
+// Writes the page ordering of the --page-order-module image, the first
+// module of @p timelines by that base name, to the --page-order file.
+// @returns 0 on success.
+int WritePageOrdering(
+    const CommandLine& cmd_line,
+    const WorkingSetProfiler& profiler,
+    const std::vector<WorkingSetProfiler::ModuleTimeline>& timelines) {
+  std::wstring image =
+      StringToLowerASCII(cmd_line.GetSwitchValueNative("page-order-module"));
+  for (size_t i = 0; i < timelines.size(); ++i) {
+    const WorkingSetProfiler::ModuleInformation& module = timelines[i].module;
+    std::wstring name =
+        base::FilePath(module.image_file_name).BaseName().value();
+    if (StringToLowerASCII(name) != image)
+      continue;
+
+    base::FilePath path(cmd_line.GetSwitchValuePath("page-order"));
+    if (!profiler.WritePageOrdering(module, path)) {
+      return Error(base::StringPrintf(L"Error writing \"%ls\"",
+                                      path.value().c_str()));
+    }
+    return 0;
+  }
+
+  return Error(base::StringPrintf(L"No pages of \"%ls\" read in the logs.",
+                                  image.c_str()));
+}
+
+// The most stacks of a process we list in the heap report.
+const size_t kMaxReportStacks = 10;
+
+// Lists the stacks that hold the most live heap bytes in each process, or
+// in the --pid process only, as of the end of the logs.
+void PrintTopHeapStacks(const CommandLine& cmd_line,
+                        HeapProfileService* heap_profile) {
+  DCHECK(heap_profile != NULL);
+
+  std::vector<DWORD> process_ids;
+  unsigned pid = 0;
+  if (base::StringToUint(cmd_line.GetSwitchValueASCII("pid"), &pid))
+    process_ids.push_back(pid);
+  else
+    heap_profile->GetProcessIds(&process_ids);
+  if (process_ids.empty()) {
+    std::wcout << L"No live heap allocations in the logs." << std::endl;
+    return;
+  }
+
+  std::vector<IHeapProfileService::OutstandingStack> stacks;
+  std::vector<sym_util::Address> frames;
+  for (size_t i = 0; i < process_ids.size(); ++i) {
+    uint64 bytes = heap_profile->GetTopStacks(process_ids[i],
+                                              kMaxReportStacks, &stacks);
+    std::wcout << L"Live heap of process " << process_ids[i] << L", "
+        << bytes << L" bytes:\n"
+        << L"Bytes\tBlocks\tStack\n";
+    for (size_t j = 0; j < stacks.size(); ++j) {
+      std::wcout << stacks[j].bytes_ << L'\t' << stacks[j].allocations_
+          << L'\t';
+      heap_profile->GetStackFrames(stacks[j].stack_id_, &frames);
+      if (frames.empty())
+        std::wcout << L"(no stack)";
+      for (size_t k = 0; k < frames.size(); ++k) {
+        std::wcout << base::StringPrintf(k == 0 ? L"0x%08llX" : L" 0x%08llX",
+                                         frames[k]);
+      }
+      std::wcout << L'\n';
+    }
+  }
+
+  if (heap_profile->num_dropped_allocations() != 0) {
+    std::wcerr << heap_profile->num_dropped_allocations()
+        << L" allocations untracked over the cap." << std::endl;
+  }
+}
+
+// Reads the event filter of the --pid, --level, --from and --to switches,
+// the times in seconds from the first event.
+LogParser::EventFilter GetEventFilter(const CommandLine& cmd_line) {
+  LogParser::EventFilter filter;
+  unsigned value = 0;
+  if (base::StringToUint(cmd_line.GetSwitchValueASCII("pid"), &value))
+    filter.process_id = value;
+  if (base::StringToUint(cmd_line.GetSwitchValueASCII("level"), &value))
+    filter.max_level = static_cast<UCHAR>(std::min(value, 0xFFU));
+
+  int seconds = 0;
+  if (base::StringToInt(cmd_line.GetSwitchValueASCII("from"), &seconds))
+    filter.from = base::TimeDelta::FromSeconds(seconds);
+  if (base::StringToInt(cmd_line.GetSwitchValueASCII("to"), &seconds))
+    filter.to = base::TimeDelta::FromSeconds(seconds);
+
+  return filter;
+}
+
+// Exports the log files in @p args with @p num_jobs worker threads. Each
+// file is parsed into a run of its own, and the runs are merged on time
+// into @p writer.
+// @note the --from and --to switches are relative to the first event of
+//     each file, rather than of all files.
+int ExportWithJobs(const CommandLine& cmd_line,
+                   const std::vector<std::wstring>& args,
+                   size_t num_jobs,
+                   LogExportWriter* writer) {
+  DCHECK_LT(0U, num_jobs);
+  DCHECK(writer != NULL);
+
+  LogParser::EventFilter filter = GetEventFilter(cmd_line);
+  ScopedVector<ExportJob> jobs;
+  for (size_t i = 0; i < args.size(); ++i)
+    jobs.push_back(new ExportJob(base::FilePath(args[i]), filter));
+
+  // Deal the files out to the workers in turn, stopping a worker waits for
+  // the files it was dealt.
+  num_jobs = std::min(num_jobs, jobs.size());
+  ScopedVector<base::Thread> workers;
+  for (size_t i = 0; i < num_jobs; ++i) {
+    scoped_ptr<base::Thread> worker(new base::Thread("Log export worker"));
+    if (!worker->Start())
+      return Error(L"Error starting the export workers.");
+    workers.push_back(worker.release());
+  }
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    workers[i % num_jobs]->message_loop()->PostTask(FROM_HERE,
+        base::Bind(&ExportJob::Run, base::Unretained(jobs[i])));
+  }
+  for (size_t i = 0; i < workers.size(); ++i)
+    workers[i]->Stop();
+
+  size_t unhandled_event_count = 0;
+  ScopedVector<LogExportReader> runs;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    if (FAILED(jobs[i]->result())) {
+      return Error(
+          base::StringPrintf(L"Error 0x%08X, reading file \"%ls\"",
+                             jobs[i]->result(),
+                             jobs[i]->path().value().c_str()));
+    }
+    unhandled_event_count += jobs[i]->unhandled_event_count();
+    runs.push_back(new LogExportReader(jobs[i]->run()));
+  }
+
+  if (!MergeExportRuns(runs.get(), writer))
+    return Error(L"Error reading back the export runs.");
+
+  if (unhandled_event_count != 0) {
+    std::wcerr << unhandled_event_count << L" unhandled events."
+        << std::endl;
+  }
+
+  return 0;
+}
+
+// Consumes the log files in @p args, the log messages to @p dumper, and
+// the module events to @p lookup_service if not NULL.
+HRESULT ConsumeForSymbols(const CommandLine& cmd_line,
+                          const std::vector<std::wstring>& args,
+                          SymbolLookupService* lookup_service,
+                          SymbolizedLogDumper* dumper) {
+  // Only one consumer may exist at a time, so each pass gets its own.
+  DumpLogConsumer consumer;
+  if (lookup_service != NULL)
+    consumer.set_module_event_sink(lookup_service);
+  consumer.set_event_sink(dumper);
+  consumer.set_event_filter(GetEventFilter(cmd_line));
+  for (size_t i = 0; i < args.size(); ++i) {
+    HRESULT hr = consumer.OpenFileSession(args[i].c_str());
+    if (FAILED(hr)) {
+      Error(base::StringPrintf(L"Error 0x%08X, opening file \"%ls\"",
+                               hr, args[i].c_str()));
+      return hr;
+    }
+  }
+
+  HRESULT hr = consumer.Consume();
+  if (FAILED(hr))
+    Error(base::StringPrintf(L"Error 0x%08X consuming log files", hr));
+  return hr;
+}
+
+// Dumps the log messages of the files in @p args with their stack traces
+// symbolized, with the symbols of the --symbol-path, and the symbol cache
+// of the --symbol-cache file if any. The modules with a Breakpad symbol
+// file in a "breakpad*<dir>" element of the path resolve from its table,
+// the others through DbgHelp.
+// @note the symbols are resolved on the lookup service's sole thread, as
+//     DbgHelp isn't thread safe, and it's the distinct frames that take
+//     the time rather than the stacks.
+int SymbolizeLogs(const CommandLine& cmd_line,
+                  const std::vector<std::wstring>& args) {
+  base::MessageLoop message_loop;
+  base::Thread background_thread("Symbol lookup");
+  if (!background_thread.Start())
+    return Error(L"Error starting the symbol lookup thread.");
+
+  int result = 0;
+  {
+    SymbolLookupService lookup_service;
+    lookup_service.set_background_thread(background_thread.message_loop());
+    if (cmd_line.HasSwitch("symbol-path")) {
+      lookup_service.SetSymbolPath(
+          cmd_line.GetSwitchValueNative("symbol-path").c_str());
+    }
+    base::FilePath cache_path(cmd_line.GetSwitchValuePath("symbol-cache"));
+    if (!cache_path.empty())
+      lookup_service.OpenPersistentCache(cache_path);
+
+    StackSymbolizer symbolizer(&lookup_service);
+    SymbolizedLogDumper dumper(&symbolizer);
+    base::TimeTicks start = base::TimeTicks::Now();
+    if (FAILED(ConsumeForSymbols(cmd_line, args, &lookup_service,
+                                 &dumper))) {
+      result = 1;
+    } else {
+      dumper.ResolveFrames();
+      std::wcerr << L"Resolved " << symbolizer.num_frames()
+          << L" distinct frames in "
+          << (base::TimeTicks::Now() - start).InMillisecondsF() << L" ms."
+          << std::endl;
+
+      // The module loads of the first pass span the whole of the logs, so
+      // the second pass looks the frames up in them as they stand.
+      if (FAILED(ConsumeForSymbols(cmd_line, args, NULL, &dumper)))
+        result = 1;
+    }
+  }
+
+  background_thread.Stop();
+  return result;
+}
+
+bool Is64BitSystem() {
+  if (sizeof(void*) == 8)  // NOLINT
+    return true;
+
+  BOOL is_wow_64 = FALSE;
+  return ::IsWow64Process(::GetCurrentProcess(), &is_wow_64) && is_wow_64;
+}
+
+const wchar_t kHeapSessionName[] = L"Sawbuck Heap Session";
+
+// How long --heap-images captures for, unless --heap-seconds says.
+const int kDefaultHeapSeconds = 30;
+
+// Captures the heap events of the processes of the --heap-images images
+// started over the next --heap-seconds, and reports their live heaps as
+// of the end of the capture.
+// @note heap tracing only takes for the processes started while the
+//     session runs, see HeapTraceSession.
+int CaptureHeap(const CommandLine& cmd_line) {
+  std::vector<std::wstring> images;
+  base::SplitString(cmd_line.GetSwitchValueNative("heap-images"), L';',
+                    &images);
+  int seconds = kDefaultHeapSeconds;
+  if (cmd_line.HasSwitch("heap-seconds") &&
+      (!base::StringToInt(cmd_line.GetSwitchValueASCII("heap-seconds"),
+                          &seconds) || seconds <= 0)) {
+    return Error(L"The heap capture must last a positive number of "
+                 L"seconds.");
+  }
+
+  HeapTraceSession session;
+  for (size_t i = 0; i < images.size(); ++i) {
+    if (images[i].empty())
+      continue;
+    HRESULT hr = session.AddImageName(images[i].c_str());
+    if (FAILED(hr)) {
+      return Error(base::StringPrintf(
+          L"Error 0x%08X, enabling heap tracing for \"%ls\"",
+          hr, images[i].c_str()));
+    }
+  }
+  HRESULT hr = session.Start(kHeapSessionName);
+  if (FAILED(hr)) {
+    return Error(base::StringPrintf(L"Error 0x%08X, starting the heap "
+                                    L"session", hr));
+  }
+
+  HeapProfileService heap_profile;
+  KernelLogConsumer consumer;
+  consumer.set_heap_event_sink(&heap_profile);
+  consumer.set_is_64_bit_log(Is64BitSystem());
+  hr = consumer.OpenRealtimeSession(kHeapSessionName);
+  if (FAILED(hr)) {
+    return Error(base::StringPrintf(L"Error 0x%08X, opening the heap "
+                                    L"session", hr));
+  }
+
+  base::Thread consumer_thread("Heap consumer");
+  if (!consumer_thread.Start())
+    return Error(L"Error starting the heap consumer thread.");
+  consumer_thread.message_loop()->PostTask(FROM_HERE,
+      base::Bind(base::IgnoreResult(&KernelLogConsumer::Consume),
+                 base::Unretained(&consumer)));
+
+  std::wcerr << L"Capturing the heaps of the processes started over the "
+      << L"next " << seconds << L" seconds." << std::endl;
+  ::Sleep(seconds * 1000);
+
+  // Stopping the session ends the consumption, once the events logged so
+  // far are through.
+  session.Stop();
+  consumer_thread.Stop();
+
+  PrintTopHeapStacks(cmd_line, &heap_profile);
+  return 0;
+}
+
 int wmain(int argc, const wchar_t** argv) {
   base::AtExitManager at_exit;
   CommandLine::Init(0, NULL);
 
   CommandLine* cmd_line = CommandLine::ForCurrentProcess();
   std::vector<std::wstring> args = cmd_line->GetArgs();
+  if (cmd_line->HasSwitch("help") ||
+      (args.empty() && !cmd_line->HasSwitch("heap-images"))) {
+    std::wcout << kUsage;
+    return 1;
+  }
+
+  // With --heap-images, the heap events are captured live rather than
+  // read from files.
+  if (cmd_line->HasSwitch("heap-images")) {
+    if (!args.empty())
+      return Error(L"--heap-images takes no log files.");
+    return CaptureHeap(*cmd_line);
+  }
+
+  // With --format=trace, the trace events are matched into spans, which
+  // are exported as trace event JSON, with the process names of the
+  // kernel log.
+  bool trace_export = cmd_line->GetSwitchValueASCII("format") == "trace";
+
+  // With --jobs, the files are read on that many threads, and exported.
+  unsigned num_jobs = 0;
+  if (cmd_line->HasSwitch("jobs")) {
+    if (!base::StringToUint(cmd_line->GetSwitchValueASCII("jobs"),
+                            &num_jobs) || num_jobs == 0) {
+      return Error(L"The number of jobs must be a positive number.");
+    }
+    if (!cmd_line->HasSwitch("format"))
+      return Error(L"--jobs requires an export --format.");
+    if (cmd_line->HasSwitch("disk-io") || cmd_line->HasSwitch("heap"))
+      return Error(L"--jobs can't be used with --disk-io or --heap.");
+    if (trace_export)
+      return Error(L"--jobs can't be used with --format=trace.");
+  }
+
+  // With --symbolize, the log messages are dumped with their stack traces
+  // symbolized.
+  if (cmd_line->HasSwitch("symbolize")) {
+    if (cmd_line->HasSwitch("format") || cmd_line->HasSwitch("query") ||
+        cmd_line->HasSwitch("disk-io") || cmd_line->HasSwitch("heap") ||
+        cmd_line->HasSwitch("page-faults") ||
+        cmd_line->HasSwitch("working-set") || num_jobs != 0) {
+      return Error(L"--symbolize can't be used with --format, --query, "
+                   L"--disk-io, --heap, --page-faults, --working-set or "
+                   L"--jobs.");
+    }
+    return SymbolizeLogs(*cmd_line, args);
+  }
+
+  // With --query, the log messages are stored and queried, rather than
+  // dumped.
+  LogQuery query;
+  bool run_query = cmd_line->HasSwitch("query");
+  if (run_query) {
+    if (cmd_line->HasSwitch("format"))
+      return Error(L"--query can't be used with --format.");
+    std::string text =
+        base::WideToUTF8(cmd_line->GetSwitchValueNative("query"));
+    std::string error;
+    if (!query.Parse(text, &error))
+      return Error(base::UTF8ToWide(error));
+  }
+
+  // With --page-faults, the module and page fault events are tallied for
+  // a report, rather than dumped.
+  PageFaultAggregator page_faults(
+      base::TimeDelta::FromSeconds(kPageFaultBucketSeconds));
+  bool page_fault_report = cmd_line->HasSwitch("page-faults");
+  if (page_fault_report &&
+      (cmd_line->HasSwitch("format") || run_query)) {
+    return Error(L"--page-faults can't be used with --format or --query.");
+  }
+
+  // With --working-set, the module and page fault events go to the working
+  // set profiler for a report, rather than dumped.
+  WorkingSetProfiler working_set;
+  bool working_set_report = cmd_line->HasSwitch("working-set");
+  if (working_set_report &&
+      (cmd_line->HasSwitch("format") || run_query || page_fault_report)) {
+    return Error(L"--working-set can't be used with --format, --query or "
+                 L"--page-faults.");
+  }
+  if (cmd_line->HasSwitch("page-order") &&
+      (!working_set_report || !cmd_line->HasSwitch("page-order-module"))) {
+    return Error(L"--page-order requires --working-set and "
+                 L"--page-order-module.");
+  }
+
   DumpLogConsumer consumer;
+
+  // With --format, the log messages and trace events are exported, to the
+  // --out file or to stdout, rather than dumped.
+  scoped_ptr<LogExportWriter::FileOutput> export_output;
+  scoped_ptr<LogExportWriter> export_writer;
+  ProcessInfoService process_info;
+  TraceSpanMatcher span_matcher;
+  scoped_ptr<TraceJsonWriter> trace_writer;
+  FILE* export_file = NULL;
+  LogDumpHandler handler;
+  QueryHandler query_handler;
+  if (cmd_line->HasSwitch("format")) {
+    LogExportWriter::Format format = LogExportWriter::CSV;
+    if (!trace_export && !LogExportWriter::ParseFormat(
+            cmd_line->GetSwitchValueASCII("format"), &format)) {
+      return Error(L"Unknown format, use csv, jsonl, binary or trace.");
+    }
+
+    base::FilePath out_path(cmd_line->GetSwitchValuePath("out"));
+    if (out_path.empty()) {
+      _setmode(_fileno(stdout), _O_BINARY);
+      export_file = stdout;
+    } else {
+      export_file = _wfopen(out_path.value().c_str(), L"wb");
+      if (export_file == NULL) {
+        return Error(base::StringPrintf(L"Error opening \"%ls\"",
+                                        out_path.value().c_str()));
+      }
+    }
+
+    export_output.reset(new LogExportWriter::FileOutput(export_file));
+    if (trace_export) {
+      trace_writer.reset(new TraceJsonWriter(
+          export_output.get(), LogExportWriter::kDefaultBufferSize));
+      trace_writer->set_process_info_service(&process_info);
+      span_matcher.set_span_sink(trace_writer.get());
+      consumer.set_process_event_sink(&process_info);
+      consumer.set_trace_sink(&span_matcher);
+    } else {
+      export_writer.reset(new LogExportWriter(
+          format, export_output.get(), LogExportWriter::kDefaultBufferSize));
+      if (num_jobs != 0) {
+        int result = ExportWithJobs(*cmd_line, args, num_jobs,
+                                    export_writer.get());
+        bool written = export_writer->Flush();
+        if (export_file != stdout)
+          fclose(export_file);
+        if (result == 0 && !written)
+          return Error(L"Error writing the export.");
+        return result;
+      }
+
+      consumer.set_event_sink(export_writer.get());
+      consumer.set_trace_sink(export_writer.get());
+    }
+  } else if (run_query) {
+    consumer.set_event_sink(&query_handler);
+  } else if (page_fault_report) {
+    consumer.set_module_event_sink(&page_faults);
+    consumer.set_page_fault_event_sink(&page_faults);
+  } else if (working_set_report) {
+    consumer.set_module_event_sink(&working_set);
+    consumer.set_page_fault_event_sink(&working_set);
+  } else {
+    consumer.set_module_event_sink(&handler);
+    consumer.set_page_fault_event_sink(&handler);
+    consumer.set_process_event_sink(&handler);
+    consumer.set_event_sink(&handler);
+  }
+
   for (size_t i = 0; i < args.size(); ++i) {
     HRESULT hr = consumer.OpenFileSession(args[i].c_str());
 
@@ -318,15 +1190,63 @@ int wmain(int argc, const wchar_t** argv) {
                              hr, args[i].c_str()));
   }
 
-  LogDumpHandler handler;
-  consumer.set_module_event_sink(&handler);
-  consumer.set_page_fault_event_sink(&handler);
-  consumer.set_process_event_sink(&handler);
-  consumer.set_event_sink(&handler);
+  consumer.set_event_filter(GetEventFilter(*cmd_line));
+
+  // Tally the disk I/O for a report if asked.
+  DiskIoLatencyService disk_io;
+  bool disk_io_report = cmd_line->HasSwitch("disk-io");
+  if (disk_io_report)
+    consumer.set_disk_io_event_sink(&disk_io);
+
+  // Track the live heap allocations for a report if asked.
+  HeapProfileService heap_profile;
+  bool heap_report = cmd_line->HasSwitch("heap");
+  if (heap_report)
+    consumer.set_heap_event_sink(&heap_profile);
 
   HRESULT hr = consumer.Consume();
   if (FAILED(hr))
     return Error(base::StringPrintf(L"Error 0x%08X consuming log files", hr));
 
+  if (export_output.get() != NULL) {
+    bool written = export_writer.get() != NULL ? export_writer->Flush() :
+                                                 trace_writer->Finish();
+    if (export_file != stdout)
+      fclose(export_file);
+    if (!written)
+      return Error(L"Error writing the export.");
+  }
+
+  if (consumer.unhandled_event_count() != 0) {
+    std::wcerr << consumer.unhandled_event_count()
+        << L" unhandled events." << std::endl;
+  }
+
+  if (disk_io_report)
+    PrintSlowestFileReads(*cmd_line, &disk_io);
+
+  if (page_fault_report)
+    PrintPageFaults(page_faults);
+
+  if (working_set_report) {
+    std::vector<WorkingSetProfiler::ModuleTimeline> timelines;
+    working_set.GetTimelines(&timelines);
+    PrintWorkingSet(timelines);
+    if (cmd_line->HasSwitch("page-order")) {
+      int result = WritePageOrdering(*cmd_line, working_set, timelines);
+      if (result != 0)
+        return result;
+    }
+  }
+
+  if (heap_report)
+    PrintTopHeapStacks(*cmd_line, &heap_profile);
+
+  if (run_query) {
+    LogQuery::Result result;
+    query.Run(query_handler.store(), &result);
+    std::wcout << base::UTF8ToWide(LogQuery::FormatResult(result));
+  }
+
   return 0;
 }
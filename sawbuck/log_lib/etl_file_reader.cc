@@ -0,0 +1,899 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Memory mapped ETW log file reader implementation.
+#include "sawbuck/log_lib/etl_file_reader.h"
+
+#include <cguid.h>
+#include <algorithm>
+#include <map>
+#include "base/logging.h"
+#include "sawbuck/log_lib/kernel_log_types.h"
+
+namespace {
+
+using kernel_log_types::LogFileHeader32;
+using kernel_log_types::LogFileHeader64;
+
+// The on-disk structures below are gleaned from ntwmi.h in the WDK, and
+// from hex dumps of log files. Only the fields we use are spelled out.
+
+// The header at the start of each buffer in a log file. The fields we use
+// are at the same offsets in the XP and Vista+ versions of the header.
+struct WmiBufferHeader {
+  ULONG BufferSize;
+  ULONG Reserved1[3];
+  LONGLONG TimeStamp;
+  // The number of the buffer in the session, the buffers are numbered in
+  // the order they're written, across processors.
+  LONGLONG SequenceNumber;
+  ULONG Reserved2[2];
+  // An ETW_BUFFER_CONTEXT.
+  ULONG ClientContext;
+  ULONG Reserved3;
+  // The offset to the end of the valid data in the buffer.
+  ULONG Offset;
+  ULONG Reserved4[5];
+};
+COMPILE_ASSERT(sizeof(WmiBufferHeader) == 72, wmi_buffer_header_size);
+
+// All event headers start with a marker ULONG, which carries the header
+// type in its third byte and flags in its fourth byte.
+const ULONG kTraceHeaderFlag = 0x80000000;
+const ULONG kPaddingMarker = 0xFFFFFFFF;
+
+enum HeaderType {
+  kHeaderTypeSystem32 = 1,
+  kHeaderTypeSystem64 = 2,
+  kHeaderTypeCompact32 = 3,
+  kHeaderTypeCompact64 = 4,
+  kHeaderTypeFull32 = 10,
+  kHeaderTypeInstance32 = 11,
+  kHeaderTypePerfInfo32 = 16,
+  kHeaderTypePerfInfo64 = 17,
+  kHeaderTypeEventHeader32 = 18,
+  kHeaderTypeEventHeader64 = 19,
+  kHeaderTypeFull64 = 20,
+  kHeaderTypeInstance64 = 21,
+};
+
+// Used by the kernel logger, the event class is implied by the group of
+// the hook id.
+struct SystemTraceHeader {
+  USHORT Version;
+  UCHAR HeaderType;
+  UCHAR Flags;
+  USHORT Size;
+  USHORT HookId;
+  ULONG ThreadId;
+  ULONG ProcessId;
+  LONGLONG SystemTime;
+  ULONG KernelTime;
+  ULONG UserTime;
+};
+COMPILE_ASSERT(sizeof(SystemTraceHeader) == 32, system_trace_header_size);
+
+// A system trace header without the processor times.
+const size_t kCompactTraceHeaderSize = 24;
+
+// A system trace header without the processor times or process/thread ids.
+struct PerfInfoTraceHeader {
+  USHORT Version;
+  UCHAR HeaderType;
+  UCHAR Flags;
+  USHORT Size;
+  USHORT HookId;
+  LONGLONG SystemTime;
+};
+COMPILE_ASSERT(sizeof(PerfInfoTraceHeader) == 16, perfinfo_header_size);
+
+// The logged form of instance events, with the registration handles
+// resolved to GUIDs.
+struct InstanceTraceHeader {
+  USHORT Size;
+  USHORT FieldTypeFlags;
+  ULONG Version;
+  ULONG ThreadId;
+  ULONG ProcessId;
+  LONGLONG TimeStamp;
+  GUID Guid;
+  ULONG KernelTime;
+  ULONG UserTime;
+  ULONG InstanceId;
+  ULONG ParentInstanceId;
+  GUID ParentGuid;
+};
+COMPILE_ASSERT(sizeof(InstanceTraceHeader) == 72, instance_header_size);
+
+// The header used by manifest-based providers, as EVENT_HEADER.
+struct EventHeader {
+  USHORT Size;
+  USHORT HeaderType;
+  USHORT Flags;
+  USHORT EventProperty;
+  ULONG ThreadId;
+  ULONG ProcessId;
+  LONGLONG TimeStamp;
+  GUID ProviderId;
+  USHORT Id;
+  UCHAR Version;
+  UCHAR Channel;
+  UCHAR Level;
+  UCHAR Opcode;
+  USHORT Task;
+  ULONGLONG Keyword;
+  ULONG KernelTime;
+  ULONG UserTime;
+  GUID ActivityId;
+};
+COMPILE_ASSERT(sizeof(EventHeader) == 80, event_header_size);
+
+// Extended data items sit between the header and the event data.
+const USHORT kEventHeaderFlagExtendedInfo = 0x0001;
+
+// The clock types, as per TRACE_LOGFILE_HEADER::ReservedFlags.
+enum ClockType {
+  kClockTypePerfCounter = 1,
+  kClockTypeSystemTime = 2,
+  kClockTypeCpuCycle = 3,
+};
+
+// Kernel event classes beyond those in kernel_log_types.
+const GUID kDiskIoEventClass = {
+    0x3d6fa8d4, 0xfe05, 0x11d0,
+    0x9d, 0xda, 0x00, 0xc0, 0x4f, 0xd7, 0xba, 0x7c };
+const GUID kThreadEventClass = {
+    0x3d6fa8d1, 0xfe05, 0x11d0,
+    0x9d, 0xda, 0x00, 0xc0, 0x4f, 0xd7, 0xba, 0x7c };
+const GUID kFileIoEventClass = {
+    0x90cbdc39, 0x4a3e, 0x11d1,
+    0x84, 0xf4, 0x00, 0x00, 0xf8, 0x04, 0x64, 0xe3 };
+const GUID kTcpIpEventClass = {
+    0x9a280ac0, 0xc8e0, 0x11d1,
+    0x84, 0xe2, 0x00, 0xc0, 0x4f, 0xb9, 0x98, 0xa2 };
+const GUID kUdpIpEventClass = {
+    0xbf3a50c5, 0xa9c9, 0x4988,
+    0xa0, 0x05, 0x2d, 0xf0, 0xb7, 0xc8, 0x0f, 0x80 };
+const GUID kRegistryEventClass = {
+    0xae53722e, 0xc863, 0x11d2,
+    0x86, 0x59, 0x00, 0xc0, 0x4f, 0xa3, 0x21, 0xa1 };
+
+// Maps the group of @p hook_id to the corresponding event class.
+const GUID& GetSystemEventClass(USHORT hook_id) {
+  switch (hook_id & 0xFF00) {
+    case 0x0000: return kernel_log_types::kEventTraceEventClass;
+    case 0x0100: return kDiskIoEventClass;
+    case 0x0200: return kernel_log_types::kPageFaultEventClass;
+    case 0x0300: return kernel_log_types::kProcessEventClass;
+    case 0x0400: return kFileIoEventClass;
+    case 0x0500: return kThreadEventClass;
+    case 0x0600: return kTcpIpEventClass;
+    case 0x0800: return kUdpIpEventClass;
+    case 0x0900: return kRegistryEventClass;
+    case 0x1400: return kernel_log_types::kImageLoadEventClass;
+  }
+
+  return GUID_NULL;
+}
+
+enum ParseResult {
+  EVENT_PARSED,
+  // The event is of a type we don't handle.
+  EVENT_SKIPPED,
+  // There is no valid event at the position.
+  EVENT_END,
+};
+
+// Parses the event at @p data into @p event, and its size, including
+// the header, into @p event_size.
+// @param length the number of valid bytes at data.
+// @note the event time stamp is left in the clock units of the log.
+ParseResult ParseEvent(const uint8* data,
+                       size_t length,
+                       EVENT_TRACE* event,
+                       size_t* event_size) {
+  DCHECK(data != NULL);
+  DCHECK(event != NULL);
+  DCHECK(event_size != NULL);
+
+  if (length < sizeof(ULONG))
+    return EVENT_END;
+
+  ULONG marker = *reinterpret_cast<const ULONG*>(data);
+  if (marker == kPaddingMarker)
+    return EVENT_END;
+
+  // A WNODE_HEADER, which starts with its size.
+  if ((marker & kTraceHeaderFlag) == 0) {
+    if (marker < sizeof(ULONG) || marker > length)
+      return EVENT_END;
+    *event_size = marker;
+    return EVENT_SKIPPED;
+  }
+
+  memset(event, 0, sizeof(*event));
+  EVENT_TRACE_HEADER& header = event->Header;
+
+  size_t header_size = 0;
+  size_t size = 0;
+  ParseResult result = EVENT_PARSED;
+  switch ((marker >> 16) & 0xFF) {
+    case kHeaderTypeSystem32:
+    case kHeaderTypeSystem64:
+    case kHeaderTypeCompact32:
+    case kHeaderTypeCompact64: {
+      header_size = sizeof(SystemTraceHeader);
+      UCHAR header_type = (marker >> 16) & 0xFF;
+      if (header_type == kHeaderTypeCompact32 ||
+          header_type == kHeaderTypeCompact64) {
+        header_size = kCompactTraceHeaderSize;
+      }
+      if (length < header_size)
+        return EVENT_END;
+
+      const SystemTraceHeader* system =
+          reinterpret_cast<const SystemTraceHeader*>(data);
+      size = system->Size;
+      header.Class.Type = static_cast<UCHAR>(system->HookId & 0xFF);
+      header.Class.Version = system->Version;
+      header.ThreadId = system->ThreadId;
+      header.ProcessId = system->ProcessId;
+      header.TimeStamp.QuadPart = system->SystemTime;
+      header.Guid = GetSystemEventClass(system->HookId);
+      if (header_size == sizeof(SystemTraceHeader)) {
+        header.KernelTime = system->KernelTime;
+        header.UserTime = system->UserTime;
+      }
+      break;
+    }
+
+    case kHeaderTypePerfInfo32:
+    case kHeaderTypePerfInfo64: {
+      header_size = sizeof(PerfInfoTraceHeader);
+      if (length < header_size)
+        return EVENT_END;
+
+      const PerfInfoTraceHeader* perf_info =
+          reinterpret_cast<const PerfInfoTraceHeader*>(data);
+      size = perf_info->Size;
+      header.Class.Type = static_cast<UCHAR>(perf_info->HookId & 0xFF);
+      header.Class.Version = perf_info->Version;
+      // These events carry no process or thread id.
+      header.ThreadId = static_cast<ULONG>(-1);
+      header.ProcessId = static_cast<ULONG>(-1);
+      header.TimeStamp.QuadPart = perf_info->SystemTime;
+      header.Guid = GetSystemEventClass(perf_info->HookId);
+      break;
+    }
+
+    case kHeaderTypeFull32:
+    case kHeaderTypeFull64:
+      header_size = sizeof(EVENT_TRACE_HEADER);
+      if (length < header_size)
+        return EVENT_END;
+
+      header = *reinterpret_cast<const EVENT_TRACE_HEADER*>(data);
+      size = header.Size;
+      break;
+
+    case kHeaderTypeInstance32:
+    case kHeaderTypeInstance64: {
+      header_size = sizeof(InstanceTraceHeader);
+      if (length < header_size)
+        return EVENT_END;
+
+      const InstanceTraceHeader* instance =
+          reinterpret_cast<const InstanceTraceHeader*>(data);
+      size = instance->Size;
+      header.FieldTypeFlags = instance->FieldTypeFlags;
+      memcpy(&header.Class, &instance->Version, sizeof(header.Class));
+      header.ThreadId = instance->ThreadId;
+      header.ProcessId = instance->ProcessId;
+      header.TimeStamp.QuadPart = instance->TimeStamp;
+      header.Guid = instance->Guid;
+      header.KernelTime = instance->KernelTime;
+      header.UserTime = instance->UserTime;
+      event->InstanceId = instance->InstanceId;
+      event->ParentInstanceId = instance->ParentInstanceId;
+      event->ParentGuid = instance->ParentGuid;
+      break;
+    }
+
+    case kHeaderTypeEventHeader32:
+    case kHeaderTypeEventHeader64: {
+      header_size = sizeof(EventHeader);
+      if (length < header_size)
+        return EVENT_END;
+
+      const EventHeader* event_header =
+          reinterpret_cast<const EventHeader*>(data);
+      size = event_header->Size;
+      header.Class.Type = event_header->Opcode;
+      header.Class.Level = event_header->Level;
+      header.Class.Version = event_header->Version;
+      header.ThreadId = event_header->ThreadId;
+      header.ProcessId = event_header->ProcessId;
+      header.TimeStamp.QuadPart = event_header->TimeStamp;
+      header.Guid = event_header->ProviderId;
+      header.KernelTime = event_header->KernelTime;
+      header.UserTime = event_header->UserTime;
+
+      // We don't parse the extended data items.
+      if ((event_header->Flags & kEventHeaderFlagExtendedInfo) != 0)
+        result = EVENT_SKIPPED;
+      break;
+    }
+
+    default:
+      // The remaining header types start with their size.
+      header_size = sizeof(ULONG);
+      size = marker & 0xFFFF;
+      result = EVENT_SKIPPED;
+      break;
+  }
+
+  if (size < header_size || size > length)
+    return EVENT_END;
+
+  header.Size = static_cast<USHORT>(size);
+  event->MofData = const_cast<uint8*>(data + header_size);
+  event->MofLength = static_cast<ULONG>(size - header_size);
+  *event_size = size;
+
+  return result;
+}
+
+// Retrieves the raw time stamps of the first event of the buffer at
+// @p data, of @p data_size valid bytes, to @p first, and of its last event
+// to @p last, unless that's NULL, in which case we stop at the first.
+// @returns false if the buffer holds no event.
+bool GetEventTimeStamps(const uint8* data,
+                        size_t data_size,
+                        ULONG context,
+                        int64* first,
+                        int64* last) {
+  DCHECK(first != NULL);
+
+  // The alignment is the second byte of the buffer context.
+  size_t alignment = (context >> 8) & 0xFF;
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    alignment = 8;
+
+  EVENT_TRACE event = {};
+  bool found = false;
+  size_t position = sizeof(WmiBufferHeader);
+  while (position < data_size) {
+    size_t event_size = 0;
+    ParseResult result = ParseEvent(data + position, data_size - position,
+                                    &event, &event_size);
+    if (result == EVENT_END)
+      break;
+    if (result == EVENT_PARSED) {
+      int64 time_stamp = event.Header.TimeStamp.QuadPart;
+      if (!found)
+        *first = time_stamp;
+      found = true;
+      if (last == NULL)
+        break;
+      *last = time_stamp;
+    }
+    position += (event_size + alignment - 1) & ~(alignment - 1);
+  }
+  return found;
+}
+
+}  // namespace
+
+// Walks the events of a sequence of buffers.
+class EtlFileReader::BufferCursor {
+ public:
+  // @param buffers the indexes of the buffers to walk, must outlive us.
+  // @param order breaks ties between cursors with events at the same time.
+  BufferCursor(const EtlFileReader* reader,
+               const std::vector<size_t>* buffers,
+               size_t order)
+      : reader_(reader), buffers_(buffers), order_(order), next_buffer_(0),
+        data_(NULL), position_(0), end_(0), alignment_(8), done_(false) {
+    memset(&event_, 0, sizeof(event_));
+  }
+
+  // Moves to the next event.
+  // @returns the number of buffers we finished with on the way.
+  size_t Advance();
+
+  bool done() const { return done_; }
+  size_t order() const { return order_; }
+  EVENT_TRACE* event() { return &event_; }
+  const EventPosition& position() const { return position_of_event_; }
+  int64 time() const { return event_.Header.TimeStamp.QuadPart; }
+
+  // Orders cursors by descending time, for use with the heap functions.
+  static bool Later(const BufferCursor* a, const BufferCursor* b) {
+    if (a->time() != b->time())
+      return a->time() > b->time();
+    return a->order() > b->order();
+  }
+
+ private:
+  const EtlFileReader* reader_;
+  const std::vector<size_t>* buffers_;
+  size_t order_;
+  size_t next_buffer_;
+
+  // The current buffer, and alignment of the events in it.
+  const uint8* data_;
+  size_t position_;
+  size_t end_;
+  size_t alignment_;
+
+  // The current event, and its position in the file.
+  EVENT_TRACE event_;
+  EventPosition position_of_event_;
+  bool done_;
+};
+
+size_t EtlFileReader::BufferCursor::Advance() {
+  DCHECK(!done_);
+
+  size_t buffers_finished = 0;
+  while (true) {
+    while (data_ != NULL && position_ < end_) {
+      size_t event_offset = position_;
+      size_t event_size = 0;
+      ParseResult result = ParseEvent(data_ + position_,
+                                      end_ - position_,
+                                      &event_,
+                                      &event_size);
+      if (result == EVENT_END)
+        break;
+
+      // Events are padded to the buffer alignment.
+      event_size = (event_size + alignment_ - 1) & ~(alignment_ - 1);
+      position_ = std::min(position_ + event_size, end_);
+
+      if (result == EVENT_PARSED) {
+        size_t buffer = (*buffers_)[next_buffer_ - 1];
+        const BufferInfo& info = reader_->buffers_[buffer];
+        event_.ClientContext = info.context;
+        event_.Header.TimeStamp.QuadPart =
+            reader_->ConvertTimeStamp(event_.Header.TimeStamp.QuadPart);
+        position_of_event_.buffer = static_cast<uint32>(buffer);
+        position_of_event_.offset = static_cast<uint32>(event_offset);
+        return buffers_finished;
+      }
+    }
+
+    if (data_ != NULL) {
+      ++buffers_finished;
+      data_ = NULL;
+    }
+
+    if (next_buffer_ == buffers_->size()) {
+      done_ = true;
+      return buffers_finished;
+    }
+
+    const BufferInfo& info = reader_->buffers_[(*buffers_)[next_buffer_++]];
+    data_ = info.data;
+    position_ = sizeof(WmiBufferHeader);
+    end_ = info.data_size;
+
+    // The alignment is the second byte of the buffer context.
+    alignment_ = (info.context >> 8) & 0xFF;
+    if (alignment_ == 0 || (alignment_ & (alignment_ - 1)) != 0)
+      alignment_ = 8;
+  }
+}
+
+EtlFileReader::EtlFileReader()
+    : pointer_size_(0),
+      start_time_stamp_(0),
+      events_lost_(0),
+      buffers_lost_(0),
+      circular_(false) {
+}
+
+EtlFileReader::~EtlFileReader() {
+}
+
+HRESULT EtlFileReader::Open(const base::FilePath& path) {
+  DCHECK(!file_.IsValid());
+
+  if (!file_.Initialize(path)) {
+    LOG(ERROR) << "Unable to map log file \"" << path.value() << "\".";
+    return E_FAIL;
+  }
+
+  HRESULT hr = IndexBuffers();
+  if (FAILED(hr)) {
+    LOG(ERROR) << "\"" << path.value() << "\" is not a valid log file.";
+    Close();
+    return hr;
+  }
+
+  path_ = path;
+  return hr;
+}
+
+HRESULT EtlFileReader::Refresh(size_t* num_new_buffers) {
+  DCHECK(file_.IsValid());
+  DCHECK(num_new_buffers != NULL);
+
+  // The buffers read before must be where they were, which they are
+  // unless the session wrapped around, or started over.
+  std::vector<BufferInfo> old_buffers;
+  old_buffers.swap(buffers_);
+  file_.Close();
+  HRESULT hr = E_FAIL;
+  if (file_.Initialize(path_))
+    hr = IndexBuffers();
+  if (SUCCEEDED(hr) && buffers_.size() < old_buffers.size())
+    hr = E_FAIL;
+  for (size_t i = 0; SUCCEEDED(hr) && i < old_buffers.size(); ++i) {
+    if (buffers_[i].sequence != old_buffers[i].sequence ||
+        buffers_[i].time_stamp != old_buffers[i].time_stamp) {
+      hr = E_FAIL;
+    }
+  }
+  if (FAILED(hr)) {
+    LOG(ERROR) << "Unable to refresh log file \"" << path_.value() << "\".";
+    Close();
+    return hr;
+  }
+
+  *num_new_buffers = buffers_.size() - old_buffers.size();
+  return S_OK;
+}
+
+void EtlFileReader::Close() {
+  path_.clear();
+  buffers_.clear();
+  latest_time_stamps_.clear();
+  earliest_event_time_stamps_.clear();
+  file_.Close();
+  start_time_stamp_ = 0;
+  events_lost_ = 0;
+  buffers_lost_ = 0;
+  circular_ = false;
+}
+
+HRESULT EtlFileReader::IndexBuffers() {
+  DCHECK(buffers_.empty());
+
+  const uint8* data = file_.data();
+  size_t length = file_.length();
+  if (length < sizeof(WmiBufferHeader))
+    return E_FAIL;
+
+  // All buffers are the size of the first one.
+  size_t buffer_size =
+      reinterpret_cast<const WmiBufferHeader*>(data)->BufferSize;
+  if (buffer_size < sizeof(WmiBufferHeader) || buffer_size > length)
+    return E_FAIL;
+
+  for (size_t offset = 0; offset + buffer_size <= length;
+       offset += buffer_size) {
+    const WmiBufferHeader* header =
+        reinterpret_cast<const WmiBufferHeader*>(data + offset);
+
+    // Preallocated log files are padded with empty buffers at the end.
+    if (header->BufferSize != buffer_size)
+      break;
+
+    BufferInfo info = {};
+    info.data = data + offset;
+    info.data_size = std::min(static_cast<size_t>(header->Offset),
+                              buffer_size);
+    info.context = header->ClientContext;
+    info.sequence = header->SequenceNumber;
+    info.time_stamp = header->TimeStamp;
+    buffers_.push_back(info);
+  }
+
+  // The bounds of the events of the buffers, for seeking by time. A buffer
+  // without events is bounded by its flush, which nothing in it precedes.
+  // The buffer of the log file header isn't stamped at its flush, so its
+  // events are walked for their last.
+  latest_time_stamps_.resize(buffers_.size());
+  earliest_event_time_stamps_.resize(buffers_.size());
+  int64 latest = kint64min;
+  for (size_t i = 0; i < buffers_.size(); ++i) {
+    const BufferInfo& info = buffers_[i];
+    int64 first = info.time_stamp;
+    int64 last = info.time_stamp;
+    GetEventTimeStamps(info.data, info.data_size, info.context, &first,
+                       info.time_stamp == 0 ? &last : NULL);
+    latest = std::max(latest, last);
+    latest_time_stamps_[i] = latest;
+    earliest_event_time_stamps_[i] = first;
+  }
+  for (size_t i = buffers_.size(); i > 1; --i) {
+    earliest_event_time_stamps_[i - 2] =
+        std::min(earliest_event_time_stamps_[i - 2],
+                 earliest_event_time_stamps_[i - 1]);
+  }
+
+  // The first event in the file is the log file header event, which
+  // provides the clock information we need to convert time stamps.
+  std::vector<size_t> first_buffer(1, 0);
+  BufferCursor cursor(this, &first_buffer, 0);
+  clock_.Reset();
+  cursor.Advance();
+  if (cursor.done())
+    return E_FAIL;
+
+  const EVENT_TRACE* event = cursor.event();
+  if (event->Header.Guid != kernel_log_types::kEventTraceEventClass ||
+      event->Header.Class.Type != kernel_log_types::kLogFileHeaderEvent ||
+      event->MofLength < sizeof(LogFileHeader32)) {
+    return E_FAIL;
+  }
+  start_time_stamp_ = event->Header.TimeStamp.QuadPart;
+
+  const LogFileHeader32* header32 =
+      reinterpret_cast<const LogFileHeader32*>(event->MofData);
+  pointer_size_ = header32->PointerSize;
+  ULONGLONG perf_frequency = header32->PerfFrequency;
+  ULONGLONG start_time = header32->StartTime;
+  ULONG clock_type = header32->ReservedFlags;
+  events_lost_ = header32->EventsLost;
+  buffers_lost_ = header32->BuffersLost;
+  circular_ = (header32->LogFileMode & EVENT_TRACE_FILE_MODE_CIRCULAR) != 0;
+  if (pointer_size_ == 8) {
+    if (event->MofLength < sizeof(LogFileHeader64))
+      return E_FAIL;
+
+    const LogFileHeader64* header64 =
+        reinterpret_cast<const LogFileHeader64*>(event->MofData);
+    perf_frequency = header64->PerfFrequency;
+    start_time = header64->StartTime;
+    clock_type = header64->ReservedFlags;
+    buffers_lost_ = header64->BuffersLost;
+  }
+
+  int64 clock_frequency = 0;
+  switch (clock_type) {
+    case kClockTypeCpuCycle:
+      clock_frequency = static_cast<int64>(header32->CPUSpeed) * 1000000;
+      break;
+
+    case kClockTypeSystemTime:
+      return S_OK;
+
+    default:
+      // Older logs leave the clock type unspecified, and use the
+      // performance counter.
+      clock_frequency = perf_frequency;
+      break;
+  }
+
+  if (clock_frequency <= 0) {
+    LOG(ERROR) << "Log file has no clock frequency.";
+    return S_OK;
+  }
+
+  // The header event is logged at the start of the session, and its
+  // time stamp is still in the clock units of the log.
+  clock_.Init(clock_frequency, event->Header.TimeStamp.QuadPart, start_time);
+
+  return S_OK;
+}
+
+int64 EtlFileReader::ConvertTimeStamp(int64 time_stamp) const {
+  return clock_.ToFileTime(time_stamp);
+}
+
+void EtlFileReader::FindBufferGaps(size_t begin,
+                                   size_t end,
+                                   std::vector<BufferGap>* gaps) const {
+  DCHECK_LE(begin, end);
+  DCHECK_LE(end, buffers_.size());
+  DCHECK(gaps != NULL);
+
+  // Logs that don't number their buffers have no gaps to find.
+  std::vector<std::pair<int64, size_t> > sequence;
+  sequence.reserve(end);
+  for (size_t i = 0; i < end; ++i) {
+    if (buffers_[i].sequence != 0)
+      sequence.push_back(std::make_pair(buffers_[i].sequence, i));
+  }
+  std::sort(sequence.begin(), sequence.end());
+
+  for (size_t i = 1; i < sequence.size(); ++i) {
+    int64 missing = sequence[i].first - sequence[i - 1].first - 1;
+    size_t before = sequence[i - 1].second;
+    // A gap belongs to the buffer that ends it, so it's found once as the
+    // buffers are read a range at a time.
+    if (missing <= 0 || (circular_ && before == 0) ||
+        sequence[i].second < begin) {
+      continue;
+    }
+
+    BufferGap gap = {
+        ConvertTimeStamp(buffers_[before].time_stamp),
+        static_cast<size_t>(missing),
+      };
+    gaps->push_back(gap);
+  }
+  std::stable_sort(gaps->begin(), gaps->end());
+}
+
+HRESULT EtlFileReader::Consume(EtlEventSink* sink) {
+  return ConsumeBuffers(0, buffers_.size(), sink);
+}
+
+HRESULT EtlFileReader::ConsumeBuffers(size_t begin,
+                                      size_t end,
+                                      EtlEventSink* sink) {
+  DCHECK_LE(begin, end);
+  DCHECK_LE(end, buffers_.size());
+  DCHECK(sink != NULL);
+  DCHECK(file_.IsValid());
+
+  // Events are in time order within the buffers of each processor,
+  // so we merge the per-processor buffer sequences by time.
+  std::map<size_t, size_t> stream_indexes;
+  std::vector<std::vector<size_t> > streams;
+  for (size_t i = begin; i < end; ++i) {
+    size_t processor = GetBufferProcessor(i);
+    std::map<size_t, size_t>::iterator it(stream_indexes.find(processor));
+    if (it == stream_indexes.end()) {
+      it = stream_indexes.insert(
+          std::make_pair(processor, streams.size())).first;
+      streams.push_back(std::vector<size_t>());
+    }
+    streams[it->second].push_back(i);
+  }
+
+  size_t buffers_read = 0;
+  std::vector<BufferCursor> cursors;
+  cursors.reserve(streams.size());
+  std::vector<BufferCursor*> heap;
+  for (size_t i = 0; i < streams.size(); ++i) {
+    cursors.push_back(BufferCursor(this, &streams[i], i));
+    BufferCursor* cursor = &cursors.back();
+
+    // Leading empty buffers are read as far as our client is concerned.
+    for (size_t j = cursor->Advance(); j > 0; --j) {
+      if (!sink->OnBufferRead(++buffers_read))
+        return E_ABORT;
+    }
+
+    if (!cursor->done())
+      heap.push_back(cursor);
+  }
+  std::make_heap(heap.begin(), heap.end(), BufferCursor::Later);
+
+  // The gaps go in time order with the events, each after the events of
+  // the buffer before it.
+  std::vector<BufferGap> gaps;
+  FindBufferGaps(begin, end, &gaps);
+  size_t next_gap = 0;
+
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), BufferCursor::Later);
+    BufferCursor* cursor = heap.back();
+    for (; next_gap < gaps.size() &&
+           gaps[next_gap].time_stamp < cursor->time(); ++next_gap) {
+      sink->OnBuffersLost(gaps[next_gap].time_stamp,
+                          gaps[next_gap].num_buffers);
+    }
+    current_position_ = cursor->position();
+    sink->OnEvent(cursor->event());
+
+    for (size_t j = cursor->Advance(); j > 0; --j) {
+      if (!sink->OnBufferRead(++buffers_read))
+        return E_ABORT;
+    }
+
+    if (cursor->done()) {
+      heap.pop_back();
+    } else {
+      std::push_heap(heap.begin(), heap.end(), BufferCursor::Later);
+    }
+  }
+
+  for (; next_gap < gaps.size(); ++next_gap)
+    sink->OnBuffersLost(gaps[next_gap].time_stamp, gaps[next_gap].num_buffers);
+
+  return S_OK;
+}
+
+void EtlFileReader::ReadBuffer(size_t index, EtlEventSink* sink) {
+  DCHECK_LT(index, buffers_.size());
+  DCHECK(sink != NULL);
+
+  std::vector<size_t> buffer(1, index);
+  BufferCursor cursor(this, &buffer, 0);
+  for (cursor.Advance(); !cursor.done(); cursor.Advance()) {
+    current_position_ = cursor.position();
+    sink->OnEvent(cursor.event());
+  }
+}
+
+bool EtlFileReader::ReadEvent(const EventPosition& position,
+                              EtlEventSink* sink) const {
+  DCHECK(sink != NULL);
+
+  if (position.buffer >= buffers_.size())
+    return false;
+  const BufferInfo& info = buffers_[position.buffer];
+  if (position.offset < sizeof(WmiBufferHeader) ||
+      position.offset >= info.data_size) {
+    return false;
+  }
+
+  EVENT_TRACE event;
+  size_t event_size = 0;
+  if (ParseEvent(info.data + position.offset,
+                 info.data_size - position.offset,
+                 &event,
+                 &event_size) != EVENT_PARSED) {
+    return false;
+  }
+
+  event.ClientContext = info.context;
+  event.Header.TimeStamp.QuadPart =
+      ConvertTimeStamp(event.Header.TimeStamp.QuadPart);
+  sink->OnEvent(&event);
+  return true;
+}
+
+void EtlFileReader::FindTimeRange(int64 begin,
+                                  int64 end,
+                                  size_t* first,
+                                  size_t* last) const {
+  DCHECK(first != NULL);
+  DCHECK(last != NULL);
+
+  *first = 0;
+  *last = buffers_.size();
+  if (begin >= end) {
+    *last = 0;
+    return;
+  }
+  if (circular_)
+    return;
+
+  // The first buffer at or after which a buffer was flushed at begin or
+  // later. None of the events before it is in range.
+  size_t low = 0;
+  size_t high = buffers_.size();
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (ConvertTimeStamp(latest_time_stamps_[middle]) < begin)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  *first = low;
+
+  // The first buffer from which on all events are at end or later.
+  high = buffers_.size();
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (ConvertTimeStamp(earliest_event_time_stamps_[middle]) < end)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  *last = low;
+}
+
+size_t EtlFileReader::GetBufferProcessor(size_t index) const {
+  DCHECK_LT(index, buffers_.size());
+
+  // The processor number is the first byte of the buffer context.
+  return buffers_[index].context & 0xFF;
+}
@@ -0,0 +1,211 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Memory mapped ETW log file reader declaration.
+#ifndef SAWBUCK_LOG_LIB_ETL_FILE_READER_H_
+#define SAWBUCK_LOG_LIB_ETL_FILE_READER_H_
+
+#include <windows.h>
+#include <evntrace.h>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/files/memory_mapped_file.h"
+#include "sawbuck/log_lib/event_clock.h"
+
+// Implemented by clients of EtlFileReader to receive the events read.
+class EtlEventSink {
+ public:
+  // Issued for each event read, in time order when consuming a whole file.
+  // The event header time stamp is converted to a FILETIME, unless the
+  // reader is set to issue raw time stamps, and the event data points
+  // straight into the mapped file.
+  // @note the event itself is not valid beyond the call, but its data is
+  //    valid for as long as the reader is open.
+  virtual void OnEvent(EVENT_TRACE* event) = 0;
+
+  // Issued once all the events of a buffer are read.
+  // @param buffers_read the number of buffers read so far.
+  // @returns false to stop reading.
+  virtual bool OnBufferRead(size_t buffers_read) { return true; }
+
+  // Issued where buffers are missing from the sequence the session wrote,
+  // as they were lost, in time order with the events when consuming a
+  // whole file.
+  // @param time_stamp the time stamp of the last buffer before the gap,
+  //     converted as the event time stamps are.
+  // @param num_buffers the number of buffers missing.
+  virtual void OnBuffersLost(int64 time_stamp, size_t num_buffers) {}
+};
+
+// Reads ETW log files by mapping them into memory and walking the buffers
+// directly, as opposed to going through OpenTrace/ProcessTrace. This saves
+// copying each event, and allows random access to the buffers of the file.
+// @note this handles the classic event header types, which is what the
+//    kernel logger and our log providers generate. Events with extended
+//    data items, and WPP messages, are skipped.
+class EtlFileReader {
+ public:
+  EtlFileReader();
+  ~EtlFileReader();
+
+  // The position of an event in the file, by which it can be read again.
+  struct EventPosition {
+    EventPosition() : buffer(0), offset(0) {
+    }
+
+    // The index of the event's buffer.
+    uint32 buffer;
+    // The offset of the event in its buffer.
+    uint32 offset;
+  };
+
+  // Maps the log file at @p path and indexes its buffers.
+  // @returns S_OK on success, an error code if the file can't be mapped
+  //    or isn't a valid log file.
+  HRESULT Open(const base::FilePath& path);
+  void Close();
+
+  // Maps the buffers appended to the file since it was opened or last
+  // refreshed, for a file that's still being written. The file is mapped
+  // anew, so the data of the events read before is no longer valid, and
+  // the buffers indexed before keep their indexes.
+  // @param num_new_buffers on success, the number of buffers appended.
+  // @returns S_OK on success, an error code if the file can't be mapped,
+  //    or its buffers were rewritten, as in a circular log that wrapped.
+  HRESULT Refresh(size_t* num_new_buffers);
+
+  // Reads all events in the file, merging the per-processor buffers
+  // by time, as ProcessTrace does, and issues the gaps in the sequence of
+  // buffers along with them.
+  // @returns S_OK if all events were read, E_ABORT if @p sink stopped
+  //    the reading.
+  HRESULT Consume(EtlEventSink* sink);
+
+  // As Consume, but only reads the buffers in [@p begin, @p end) and the
+  // gaps before them, e.g. those a Refresh added. OnBufferRead counts the
+  // buffers from @p begin.
+  // @pre begin <= end <= num_buffers().
+  HRESULT ConsumeBuffers(size_t begin, size_t end, EtlEventSink* sink);
+
+  // Finds the buffers that may hold events logged in [@p begin, @p end),
+  // time stamps as we issue them, for ConsumeBuffers to read only those.
+  // Each buffer's time stamp is when it was flushed, so none of its
+  // events is later, and none is earlier than its first event. Running
+  // over those bounds, the latest flush so far and the earliest event
+  // from there on ascend through the file, so the range is binary
+  // searched. A circular log wraps, and is all in range.
+  // @param first returns the first buffer in range.
+  // @param last returns the buffer past the last in range.
+  void FindTimeRange(int64 begin, int64 end, size_t* first,
+                     size_t* last) const;
+
+  // Reads the events of the buffer at @p index, in the order they were
+  // logged. OnBufferRead is not issued.
+  // @pre index < num_buffers().
+  void ReadBuffer(size_t index, EtlEventSink* sink);
+
+  // @returns the position of the event being issued by Consume or
+  //     ReadBuffer, only valid during the sink's OnEvent.
+  const EventPosition& current_position() const { return current_position_; }
+
+  // Reads the event at @p position again, issuing it to @p sink. This is
+  // safe to call from several threads at once.
+  // @returns true if there's an event we handle at @p position.
+  bool ReadEvent(const EventPosition& position, EtlEventSink* sink) const;
+
+  // Accessors, valid once open.
+  // @{
+  size_t num_buffers() const { return buffers_.size(); }
+  // The processor the buffer at @p index was logged on.
+  size_t GetBufferProcessor(size_t index) const;
+  bool is_64_bit_log() const { return pointer_size_ == 8; }
+  // The time stamp of the start of the session, as we issue them.
+  int64 start_time() const { return ConvertTimeStamp(start_time_stamp_); }
+  // The events and buffers the session lost, as its log file header
+  // tells. Buffers lost are also found as gaps, @see OnBuffersLost.
+  uint32 events_lost() const { return events_lost_; }
+  uint32 buffers_lost() const { return buffers_lost_; }
+  // @}
+
+ private:
+  // A buffer in the mapped file.
+  struct BufferInfo {
+    // The start of the buffer, including its header.
+    const uint8* data;
+    // The extent of the valid data in the buffer, including its header.
+    size_t data_size;
+    // The buffer context, as ETW_BUFFER_CONTEXT.
+    ULONG context;
+    // The number of the buffer in the session's sequence, or zero, and
+    // its raw time stamp.
+    int64 sequence;
+    int64 time_stamp;
+  };
+  class BufferCursor;
+
+  // A run of buffers missing from the sequence.
+  struct BufferGap {
+    // The converted time stamp of the buffer before the gap.
+    int64 time_stamp;
+    size_t num_buffers;
+
+    bool operator<(const BufferGap& other) const {
+      return time_stamp < other.time_stamp;
+    }
+  };
+
+  // Indexes the buffers of the mapped file and reads the timing
+  // information from the log file header event.
+  HRESULT IndexBuffers();
+
+  // Finds the gaps in the sequence of the buffers before @p end, in time
+  // order, short of those before @p begin in the sequence.
+  void FindBufferGaps(size_t begin,
+                      size_t end,
+                      std::vector<BufferGap>* gaps) const;
+
+  // Converts @p time_stamp, in the clock units of the log, to the FILETIME
+  // we issue.
+  int64 ConvertTimeStamp(int64 time_stamp) const;
+
+  base::FilePath path_;
+  base::MemoryMappedFile file_;
+  std::vector<BufferInfo> buffers_;
+  // For FindTimeRange, by buffer: the latest raw time stamp of the buffers
+  // up to it, and the earliest raw time stamp its events or those of the
+  // buffers past it may have. Both ascend.
+  std::vector<int64> latest_time_stamps_;
+  std::vector<int64> earliest_event_time_stamps_;
+
+  // The position of the event being issued.
+  EventPosition current_position_;
+
+  // The clock of the log, anchored on the raw time stamp of the log file
+  // header event and the corresponding session start time.
+  EventClock clock_;
+  ULONG pointer_size_;
+  // The raw time stamp of the log file header event.
+  int64 start_time_stamp_;
+
+  // From the log file header. A circular log wraps past its first buffer,
+  // which is not a gap.
+  uint32 events_lost_;
+  uint32 buffers_lost_;
+  bool circular_;
+
+  DISALLOW_COPY_AND_ASSIGN(EtlFileReader);
+};
+
+#endif  // SAWBUCK_LOG_LIB_ETL_FILE_READER_H_
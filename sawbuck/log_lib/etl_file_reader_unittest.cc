@@ -0,0 +1,424 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/log_lib/etl_file_reader.h"
+
+#include <vector>
+#include "base/file_util.h"
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/path_service.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/log_lib/kernel_log_unittest_data.h"
+#include "sawbuck/log_lib/kernel_log_types.h"
+
+namespace {
+
+using testing::_;
+using testing::ByRef;
+using testing::Eq;
+using testing::InSequence;
+using testing::StrictMock;
+
+class MockKernelModuleEvents: public KernelModuleEvents {
+ public:
+  MOCK_METHOD3(OnModuleIsLoaded, void(DWORD process_id,
+                                      const base::Time& time,
+                                      const ModuleInformation& module_info));
+  MOCK_METHOD3(OnModuleUnload, void(DWORD process_id,
+                                    const base::Time& time,
+                                    const ModuleInformation& module_info));
+  MOCK_METHOD3(OnModuleLoad, void(DWORD process_id,
+                                  const base::Time& time,
+                                  const ModuleInformation& module_info));
+};
+
+class MockKernelProcessEvents: public KernelProcessEvents {
+ public:
+  MOCK_METHOD2(OnProcessIsRunning, void (const base::Time& time,
+                                         const ProcessInfo& process_info));
+  MOCK_METHOD2(OnProcessStarted, void (const base::Time& time,
+                                       const ProcessInfo& process_info));
+  MOCK_METHOD3(OnProcessEnded, void (const base::Time& time,
+                                     const ProcessInfo& process_info,
+                                     ULONG exit_status));
+};
+
+// Records the events read, and feeds them to a kernel log parser.
+class TestSink : public EtlEventSink, public KernelLogParser {
+ public:
+  TestSink() : stop_after_buffers_(0), buffers_read_(0) {
+  }
+
+  virtual void OnEvent(EVENT_TRACE* event) {
+    events_.push_back(event->Header);
+    ProcessOneEvent(event);
+  }
+
+  virtual bool OnBufferRead(size_t buffers_read) {
+    EXPECT_EQ(buffers_read_ + 1, buffers_read);
+    buffers_read_ = buffers_read;
+
+    return stop_after_buffers_ == 0 || buffers_read < stop_after_buffers_;
+  }
+
+  // If non-zero, reading stops after this many buffers.
+  size_t stop_after_buffers_;
+  size_t buffers_read_;
+  std::vector<EVENT_TRACE_HEADER> events_;
+};
+
+class EtlFileReaderTest: public testing::Test {
+ public:
+  virtual void SetUp() {
+    base::FilePath src_root;
+    ASSERT_TRUE(PathService::Get(base::DIR_SOURCE_ROOT, &src_root));
+    test_data_dir_ = src_root.AppendASCII("sawbuck\\log_lib\\test_data");
+
+    // As for the kernel log consumer tests, we don't want to sniff the
+    // artificially created test logs for their bitness.
+    sink_.set_infer_bitness_from_log(false);
+  }
+
+  void ExpectModules(bool water_down) {
+    std::vector<KernelModuleEvents::ModuleInformation> modules(
+        testing::module_list, testing::module_list + testing::kNumModules);
+    if (water_down) {
+      for (size_t i = 0; i < modules.size(); ++i) {
+        modules[i].image_checksum = 0;
+        modules[i].time_date_stamp = 0;
+      }
+    }
+
+    // The unload and load events are in a different buffer from the
+    // others, which only comes out right if we merge the buffers by time.
+    InSequence in;
+    for (size_t i = 0; i < modules.size(); ++i) {
+      EXPECT_CALL(module_events_, OnModuleIsLoaded(_, _, modules[i]));
+    }
+    EXPECT_CALL(module_events_, OnModuleUnload(_, _, modules[0]));
+    EXPECT_CALL(module_events_, OnModuleLoad(_, _, modules[0]));
+
+    sink_.set_module_event_sink(&module_events_);
+  }
+
+  void ExpectProcesses() {
+    InSequence in;
+    for (size_t i = 0; i < testing::kNumProcesses - 1; ++i) {
+      EXPECT_CALL(process_events_,
+                  OnProcessIsRunning(_, testing::process_list[i]));
+    }
+
+    const KernelProcessEvents::ProcessInfo& process =
+        testing::process_list[testing::kNumProcesses - 1];
+    EXPECT_CALL(process_events_, OnProcessStarted(_, process));
+    EXPECT_CALL(process_events_, OnProcessEnded(_, process, ERROR_SUCCESS));
+
+    sink_.set_process_event_sink(&process_events_);
+  }
+
+  void Consume(const wchar_t* file_name) {
+    ASSERT_HRESULT_SUCCEEDED(reader_.Open(test_data_dir_.Append(file_name)));
+    ASSERT_HRESULT_SUCCEEDED(reader_.Consume(&sink_));
+    EXPECT_EQ(reader_.num_buffers(), sink_.buffers_read_);
+  }
+
+ protected:
+  base::FilePath test_data_dir_;
+  StrictMock<MockKernelModuleEvents> module_events_;
+  StrictMock<MockKernelProcessEvents> process_events_;
+  TestSink sink_;
+  EtlFileReader reader_;
+};
+
+TEST_F(EtlFileReaderTest, OpenFailsForMissingFile) {
+  EXPECT_HRESULT_FAILED(
+      reader_.Open(test_data_dir_.Append(L"does_not_exist.etl")));
+  EXPECT_EQ(0, reader_.num_buffers());
+}
+
+TEST_F(EtlFileReaderTest, ImageEventsLog32Version0) {
+  sink_.set_is_64_bit_log(false);
+  ExpectModules(true);
+  Consume(L"image_data_32_v0.etl");
+}
+
+TEST_F(EtlFileReaderTest, ImageEventsLog32Version2) {
+  sink_.set_is_64_bit_log(false);
+  ExpectModules(false);
+  Consume(L"image_data_32_v2.etl");
+}
+
+TEST_F(EtlFileReaderTest, ImageEventsLog64Version2) {
+  sink_.set_is_64_bit_log(true);
+  ExpectModules(false);
+  Consume(L"image_data_64_v2.etl");
+}
+
+TEST_F(EtlFileReaderTest, ProcessEventsLog32Version2) {
+  sink_.set_is_64_bit_log(false);
+  ExpectProcesses();
+  Consume(L"process_data_32_v2.etl");
+}
+
+TEST_F(EtlFileReaderTest, ProcessEventsLog64Version3) {
+  sink_.set_is_64_bit_log(true);
+  ExpectProcesses();
+  Consume(L"process_data_64_v3.etl");
+}
+
+TEST_F(EtlFileReaderTest, EventsAreInTimeOrder) {
+  sink_.set_is_64_bit_log(false);
+  ASSERT_HRESULT_SUCCEEDED(
+      reader_.Open(test_data_dir_.Append(L"image_data_32_v0.etl")));
+  ASSERT_HRESULT_SUCCEEDED(reader_.Consume(&sink_));
+
+  ASSERT_FALSE(sink_.events_.empty());
+  // The log file header event comes first.
+  EXPECT_TRUE(sink_.events_[0].Guid ==
+      kernel_log_types::kEventTraceEventClass);
+  for (size_t i = 1; i < sink_.events_.size(); ++i) {
+    EXPECT_LE(sink_.events_[i - 1].TimeStamp.QuadPart,
+              sink_.events_[i].TimeStamp.QuadPart);
+  }
+}
+
+TEST_F(EtlFileReaderTest, ReadBuffer) {
+  ASSERT_HRESULT_SUCCEEDED(
+      reader_.Open(test_data_dir_.Append(L"image_data_32_v0.etl")));
+  ASSERT_EQ(3, reader_.num_buffers());
+
+  // The last buffer has the bulk of the events, read it on its own.
+  reader_.ReadBuffer(2, &sink_);
+  EXPECT_EQ(25, sink_.events_.size());
+  EXPECT_EQ(0, sink_.buffers_read_);
+  for (size_t i = 0; i < sink_.events_.size(); ++i) {
+    EXPECT_TRUE(sink_.events_[i].Guid ==
+        kernel_log_types::kImageLoadEventClass);
+  }
+
+  sink_.events_.clear();
+  reader_.ReadBuffer(0, &sink_);
+  ASSERT_EQ(1, sink_.events_.size());
+  EXPECT_TRUE(sink_.events_[0].Guid ==
+      kernel_log_types::kEventTraceEventClass);
+}
+
+// Records the positions of the events read, along with their headers.
+class PositionSink : public EtlEventSink {
+ public:
+  explicit PositionSink(const EtlFileReader* reader) : reader_(reader) {
+  }
+
+  virtual void OnEvent(EVENT_TRACE* event) {
+    positions_.push_back(reader_->current_position());
+    events_.push_back(event->Header);
+  }
+
+  const EtlFileReader* reader_;
+  std::vector<EtlFileReader::EventPosition> positions_;
+  std::vector<EVENT_TRACE_HEADER> events_;
+};
+
+TEST_F(EtlFileReaderTest, ReadEventAgain) {
+  ASSERT_HRESULT_SUCCEEDED(
+      reader_.Open(test_data_dir_.Append(L"image_data_32_v2.etl")));
+  PositionSink consumed(&reader_);
+  ASSERT_HRESULT_SUCCEEDED(reader_.Consume(&consumed));
+  ASSERT_FALSE(consumed.events_.empty());
+
+  // Each event reads the same again from its position.
+  PositionSink read(&reader_);
+  for (size_t i = 0; i < consumed.positions_.size(); ++i)
+    ASSERT_TRUE(reader_.ReadEvent(consumed.positions_[i], &read));
+  ASSERT_EQ(consumed.events_.size(), read.events_.size());
+  for (size_t i = 0; i < consumed.events_.size(); ++i) {
+    EXPECT_EQ(0, memcmp(&consumed.events_[i], &read.events_[i],
+                        sizeof(consumed.events_[i])));
+  }
+
+  // There's no event at the start of a buffer, nor past the buffers.
+  EtlFileReader::EventPosition position;
+  EXPECT_FALSE(reader_.ReadEvent(position, &read));
+  position.buffer = reader_.num_buffers();
+  position.offset = consumed.positions_[0].offset;
+  EXPECT_FALSE(reader_.ReadEvent(position, &read));
+}
+
+TEST_F(EtlFileReaderTest, StopReading) {
+  sink_.set_is_64_bit_log(false);
+  sink_.stop_after_buffers_ = 1;
+
+  ASSERT_HRESULT_SUCCEEDED(
+      reader_.Open(test_data_dir_.Append(L"image_data_32_v2.etl")));
+  EXPECT_EQ(E_ABORT, reader_.Consume(&sink_));
+
+  // We stop as soon as the header buffer is done.
+  EXPECT_EQ(1, sink_.buffers_read_);
+  EXPECT_EQ(1, sink_.events_.size());
+}
+
+// Records the gaps in the buffers, and the events before each.
+class GapSink : public EtlEventSink {
+ public:
+  struct Gap {
+    int64 time_stamp;
+    size_t num_buffers;
+    size_t events_before;
+  };
+
+  GapSink() : num_events_(0), last_time_stamp_(0) {
+  }
+
+  virtual void OnEvent(EVENT_TRACE* event) {
+    ++num_events_;
+    last_time_stamp_ = event->Header.TimeStamp.QuadPart;
+  }
+
+  virtual void OnBuffersLost(int64 time_stamp, size_t num_buffers) {
+    // The gap comes after the events before it.
+    EXPECT_LE(last_time_stamp_, time_stamp);
+    Gap gap = { time_stamp, num_buffers, num_events_ };
+    gaps_.push_back(gap);
+  }
+
+  size_t num_events_;
+  int64 last_time_stamp_;
+  std::vector<Gap> gaps_;
+};
+
+TEST_F(EtlFileReaderTest, BufferGaps) {
+  // The test log's buffers are numbered in sequence, so it has no gaps.
+  base::FilePath original(test_data_dir_.Append(L"image_data_32_v0.etl"));
+  ASSERT_HRESULT_SUCCEEDED(reader_.Open(original));
+  GapSink none;
+  ASSERT_HRESULT_SUCCEEDED(reader_.Consume(&none));
+  EXPECT_TRUE(none.gaps_.empty());
+  EXPECT_EQ(0, reader_.events_lost());
+  EXPECT_EQ(0, reader_.buffers_lost());
+  reader_.Close();
+
+  // Renumber the second buffer, the last in sequence, as if the three
+  // before it were lost.
+  std::string contents;
+  ASSERT_TRUE(base::ReadFileToString(original, &contents));
+  const size_t kBufferSize = 65536;
+  const size_t kSequenceNumberOffset = 24;
+  ASSERT_EQ(3 * kBufferSize, contents.size());
+  int64* sequence = reinterpret_cast<int64*>(
+      &contents[kBufferSize + kSequenceNumberOffset]);
+  ASSERT_EQ(2, *sequence);
+  *sequence = 5;
+
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::FilePath path(temp_dir.path().Append(L"gaps.etl"));
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            base::WriteFile(path, contents.data(), contents.size()));
+
+  ASSERT_HRESULT_SUCCEEDED(reader_.Open(path));
+  GapSink gaps;
+  ASSERT_HRESULT_SUCCEEDED(reader_.Consume(&gaps));
+  ASSERT_EQ(1, gaps.gaps_.size());
+  EXPECT_EQ(3, gaps.gaps_[0].num_buffers);
+  EXPECT_EQ(none.num_events_, gaps.num_events_);
+  EXPECT_LT(0, gaps.gaps_[0].events_before);
+  reader_.Close();
+}
+
+TEST_F(EtlFileReaderTest, RefreshGrowingFile) {
+  base::FilePath original(test_data_dir_.Append(L"image_data_32_v0.etl"));
+  ASSERT_HRESULT_SUCCEEDED(reader_.Open(original));
+  PositionSink all(&reader_);
+  ASSERT_HRESULT_SUCCEEDED(reader_.Consume(&all));
+  reader_.Close();
+
+  // Write the file a buffer at a time, as a session would flush it.
+  std::string contents;
+  ASSERT_TRUE(base::ReadFileToString(original, &contents));
+  const size_t kBufferSize = 65536;
+  ASSERT_EQ(3 * kBufferSize, contents.size());
+
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::FilePath path(temp_dir.path().Append(L"growing.etl"));
+  ASSERT_EQ(static_cast<int>(kBufferSize),
+            base::WriteFile(path, contents.data(), kBufferSize));
+
+  ASSERT_HRESULT_SUCCEEDED(reader_.Open(path));
+  ASSERT_EQ(1, reader_.num_buffers());
+  PositionSink read(&reader_);
+  ASSERT_HRESULT_SUCCEEDED(reader_.ConsumeBuffers(0, 1, &read));
+  EXPECT_EQ(1, read.events_.size());
+
+  // Nothing new.
+  size_t num_new_buffers = 0;
+  ASSERT_HRESULT_SUCCEEDED(reader_.Refresh(&num_new_buffers));
+  EXPECT_EQ(0, num_new_buffers);
+
+  // A partly written buffer isn't indexed until it's whole.
+  ASSERT_EQ(static_cast<int>(2 * kBufferSize + 100),
+            base::WriteFile(path, contents.data(), 2 * kBufferSize + 100));
+  ASSERT_HRESULT_SUCCEEDED(reader_.Refresh(&num_new_buffers));
+  EXPECT_EQ(1, num_new_buffers);
+  ASSERT_HRESULT_SUCCEEDED(reader_.ConsumeBuffers(1, 2, &read));
+
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            base::WriteFile(path, contents.data(), contents.size()));
+  ASSERT_HRESULT_SUCCEEDED(reader_.Refresh(&num_new_buffers));
+  EXPECT_EQ(1, num_new_buffers);
+  ASSERT_HRESULT_SUCCEEDED(reader_.ConsumeBuffers(2, 3, &read));
+
+  // A buffer at a time, the events all come out.
+  EXPECT_EQ(all.events_.size(), read.events_.size());
+
+  // Rewriting a buffer read, as a circular log wraps, fails the refresh.
+  const size_t kSequenceNumberOffset = 24;
+  *reinterpret_cast<int64*>(&contents[kSequenceNumberOffset]) = 7;
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            base::WriteFile(path, contents.data(), contents.size()));
+  EXPECT_HRESULT_FAILED(reader_.Refresh(&num_new_buffers));
+  EXPECT_EQ(0, reader_.num_buffers());
+}
+
+TEST_F(EtlFileReaderTest, FindTimeRange) {
+  ASSERT_HRESULT_SUCCEEDED(
+      reader_.Open(test_data_dir_.Append(L"image_data_32_v2.etl")));
+  PositionSink all(&reader_);
+  ASSERT_HRESULT_SUCCEEDED(reader_.Consume(&all));
+  ASSERT_FALSE(all.events_.empty());
+  int64 begin = all.events_.front().TimeStamp.QuadPart;
+  int64 end = all.events_.back().TimeStamp.QuadPart + 1;
+  EXPECT_EQ(begin, reader_.start_time());
+
+  // The whole log spans all of the buffers, and an empty range none.
+  size_t first = 0;
+  size_t last = 0;
+  reader_.FindTimeRange(begin, end, &first, &last);
+  EXPECT_EQ(0, first);
+  EXPECT_EQ(reader_.num_buffers(), last);
+  reader_.FindTimeRange(end, end, &first, &last);
+  EXPECT_EQ(first, last);
+
+  // Every event of a range is in the buffers found for it.
+  for (size_t i = 0; i < all.events_.size(); ++i) {
+    int64 time = all.events_[i].TimeStamp.QuadPart;
+    reader_.FindTimeRange(time, time + 1, &first, &last);
+    EXPECT_LE(first, all.positions_[i].buffer);
+    EXPECT_GT(last, all.positions_[i].buffer);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,87 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event clock implementation.
+#include "sawbuck/log_lib/event_clock.h"
+
+#include <windows.h>
+#include "base/logging.h"
+
+const int64 EventClock::kFileTimeTicksPerSecond;
+
+EventClock::EventClock() {
+  Reset();
+}
+
+void EventClock::Init(int64 frequency,
+                      int64 reference_time_stamp,
+                      int64 reference_file_time) {
+  DCHECK_GT(frequency, 0);
+
+  frequency_ = frequency;
+  reference_time_stamp_ = reference_time_stamp;
+  reference_file_time_ = reference_file_time;
+  if (kFileTimeTicksPerSecond % frequency == 0) {
+    mode_ = MODE_MULTIPLY;
+    ratio_ = kFileTimeTicksPerSecond / frequency;
+  } else if (frequency % kFileTimeTicksPerSecond == 0) {
+    mode_ = MODE_DIVIDE;
+    ratio_ = frequency / kFileTimeTicksPerSecond;
+  } else {
+    mode_ = MODE_GENERAL;
+    ratio_ = 0;
+  }
+}
+
+void EventClock::Reset() {
+  mode_ = MODE_SYSTEM_TIME;
+  frequency_ = kFileTimeTicksPerSecond;
+  ratio_ = 1;
+  reference_time_stamp_ = 0;
+  reference_file_time_ = 0;
+}
+
+int64 EventClock::ToFileTime(int64 time_stamp) const {
+  int64 delta = time_stamp - reference_time_stamp_;
+  switch (mode_) {
+    case MODE_SYSTEM_TIME:
+      return time_stamp;
+
+    case MODE_MULTIPLY:
+      return reference_file_time_ + delta * ratio_;
+
+    case MODE_DIVIDE:
+      return reference_file_time_ + delta / ratio_;
+
+    default:
+      break;
+  }
+
+  // Convert seconds and remainder separately to avoid overflow in
+  // long-running sessions.
+  int64 seconds = delta / frequency_;
+  int64 remainder = delta % frequency_;
+
+  return reference_file_time_ + seconds * kFileTimeTicksPerSecond +
+      remainder * kFileTimeTicksPerSecond / frequency_;
+}
+
+base::Time EventClock::ToTime(int64 time_stamp) const {
+  uint64 file_time = ToFileTime(time_stamp);
+
+  FILETIME ret = {};
+  ret.dwLowDateTime = static_cast<DWORD>(file_time);
+  ret.dwHighDateTime = static_cast<DWORD>(file_time >> 32);
+  return base::Time::FromFileTime(ret);
+}
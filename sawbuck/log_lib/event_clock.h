@@ -0,0 +1,80 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event clock declaration.
+#ifndef SAWBUCK_LOG_LIB_EVENT_CLOCK_H_
+#define SAWBUCK_LOG_LIB_EVENT_CLOCK_H_
+
+#include "base/basictypes.h"
+#include "base/time/time.h"
+
+// Converts raw event time stamps, in the clock units of a log session, to
+// FILETIMEs. The conversion is anchored on a reference time stamp and its
+// FILETIME, as found in the log file header. Performance counters commonly
+// run at 10MHz, and cycle counters at a whole number of MHz, so where the
+// clock frequency is a multiple or divisor of the FILETIME resolution the
+// conversion reduces to a single multiply or divide per time stamp.
+class EventClock {
+ public:
+  // The resolution of FILETIMEs, in ticks per second.
+  static const int64 kFileTimeTicksPerSecond = 10000000;
+
+  // Creates a clock whose time stamps are FILETIMEs already.
+  EventClock();
+
+  // Sets the clock to one counting @p frequency ticks per second, where
+  // @p reference_time_stamp corresponds to @p reference_file_time.
+  // @pre frequency > 0.
+  void Init(int64 frequency,
+            int64 reference_time_stamp,
+            int64 reference_file_time);
+
+  // Resets the clock to system time, where time stamps are FILETIMEs.
+  void Reset();
+
+  // @returns @p time_stamp, in the clock units, as a FILETIME.
+  int64 ToFileTime(int64 time_stamp) const;
+
+  // @returns @p time_stamp, in the clock units, as a base::Time.
+  base::Time ToTime(int64 time_stamp) const;
+
+  // Accessors.
+  // @{
+  // True iff time stamps are FILETIMEs, in which case they convert as-is.
+  bool is_system_time() const { return mode_ == MODE_SYSTEM_TIME; }
+  // The frequency of the clock, in ticks per second.
+  int64 frequency() const { return frequency_; }
+  // @}
+
+ private:
+  enum Mode {
+    // Time stamps are FILETIMEs.
+    MODE_SYSTEM_TIME,
+    // Each clock tick is a whole number of FILETIME ticks.
+    MODE_MULTIPLY,
+    // Each FILETIME tick is a whole number of clock ticks.
+    MODE_DIVIDE,
+    // Neither, seconds and remainder are converted separately.
+    MODE_GENERAL,
+  };
+
+  Mode mode_;
+  int64 frequency_;
+  // The multiplier or divisor for MODE_MULTIPLY and MODE_DIVIDE.
+  int64 ratio_;
+  int64 reference_time_stamp_;
+  int64 reference_file_time_;
+};
+
+#endif  // SAWBUCK_LOG_LIB_EVENT_CLOCK_H_
@@ -0,0 +1,106 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event clock unittests.
+#include "sawbuck/log_lib/event_clock.h"
+
+#include <windows.h>
+#include "gtest/gtest.h"
+
+namespace {
+
+const int64 kReferenceTimeStamp = 123456789;
+// 2012-01-01 00:00:00 UTC, as a FILETIME.
+const int64 kReferenceFileTime = 129698496000000000LL;
+
+// The conversion every clock mode must agree with.
+int64 SlowConvert(int64 frequency, int64 time_stamp) {
+  int64 delta = time_stamp - kReferenceTimeStamp;
+  int64 seconds = delta / frequency;
+  int64 remainder = delta % frequency;
+  return kReferenceFileTime + seconds * EventClock::kFileTimeTicksPerSecond +
+      remainder * EventClock::kFileTimeTicksPerSecond / frequency;
+}
+
+void ExpectConverts(int64 frequency) {
+  EventClock clock;
+  clock.Init(frequency, kReferenceTimeStamp, kReferenceFileTime);
+  EXPECT_FALSE(clock.is_system_time());
+  EXPECT_EQ(frequency, clock.frequency());
+
+  EXPECT_EQ(kReferenceFileTime, clock.ToFileTime(kReferenceTimeStamp));
+
+  // From a few ticks to a day into the session, and a little before it.
+  const int64 kDeltas[] = { 1, 7, 999, frequency - 1, frequency,
+                            frequency * 3 + 17, frequency * 86400 + 5,
+                            -1, -frequency - 3 };
+  for (size_t i = 0; i < arraysize(kDeltas); ++i) {
+    int64 time_stamp = kReferenceTimeStamp + kDeltas[i];
+    EXPECT_EQ(SlowConvert(frequency, time_stamp), clock.ToFileTime(time_stamp))
+        << "frequency " << frequency << ", delta " << kDeltas[i];
+  }
+}
+
+}  // namespace
+
+TEST(EventClockTest, SystemTime) {
+  EventClock clock;
+  EXPECT_TRUE(clock.is_system_time());
+  EXPECT_EQ(kReferenceFileTime, clock.ToFileTime(kReferenceFileTime));
+
+  FILETIME file_time = {};
+  file_time.dwLowDateTime = static_cast<DWORD>(kReferenceFileTime);
+  file_time.dwHighDateTime = static_cast<DWORD>(kReferenceFileTime >> 32);
+  EXPECT_EQ(base::Time::FromFileTime(file_time),
+            clock.ToTime(kReferenceFileTime));
+}
+
+TEST(EventClockTest, Reset) {
+  EventClock clock;
+  clock.Init(3579545, kReferenceTimeStamp, kReferenceFileTime);
+  EXPECT_FALSE(clock.is_system_time());
+
+  clock.Reset();
+  EXPECT_TRUE(clock.is_system_time());
+  EXPECT_EQ(kReferenceTimeStamp, clock.ToFileTime(kReferenceTimeStamp));
+}
+
+TEST(EventClockTest, ConvertsMultiplesOfFileTime) {
+  // The usual performance counter, and cycle counters.
+  ExpectConverts(10000000);
+  ExpectConverts(2400000000LL);
+  ExpectConverts(3300000000LL);
+}
+
+TEST(EventClockTest, ConvertsDivisorsOfFileTime) {
+  ExpectConverts(1000);
+  ExpectConverts(1000000);
+  ExpectConverts(2500000);
+}
+
+TEST(EventClockTest, ConvertsOtherFrequencies) {
+  // The ACPI timer, and a cycle counter not a multiple of 10MHz.
+  ExpectConverts(3579545);
+  ExpectConverts(2394000000LL);
+}
+
+TEST(EventClockTest, ToTime) {
+  EventClock clock;
+  clock.Init(10000000, kReferenceTimeStamp, kReferenceFileTime);
+
+  EventClock system;
+  EXPECT_EQ(system.ToTime(kReferenceFileTime) +
+                base::TimeDelta::FromMicroseconds(1500),
+            clock.ToTime(kReferenceTimeStamp + 15000));
+}
@@ -0,0 +1,154 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event rate statistics implementation.
+#include "sawbuck/log_lib/event_rate_stats.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+bool EventRateStats::Key::operator<(const Key& other) const {
+  if (process_id != other.process_id)
+    return process_id < other.process_id;
+  if (level != other.level)
+    return level < other.level;
+  return memcmp(&event_class, &other.event_class, sizeof(event_class)) < 0;
+}
+
+bool EventRateStats::Key::operator==(const Key& other) const {
+  return process_id == other.process_id && level == other.level &&
+      event_class == other.event_class;
+}
+
+EventRateStats::EventRateStats(size_t history_length)
+    : history_length_(history_length), last_counts_(NULL) {
+  DCHECK_NE(0U, history_length);
+}
+
+EventRateStats::~EventRateStats() {
+}
+
+// static
+bool EventRateStats::BusiestFirst(const Rates& a, const Rates& b) {
+  if (a.events_per_second != b.events_per_second)
+    return a.events_per_second > b.events_per_second;
+  return a.events > b.events;
+}
+
+void EventRateStats::AddEvent(const EVENT_TRACE* event) {
+  DCHECK(event != NULL);
+
+  Key key;
+  key.event_class = event->Header.Guid;
+  key.process_id = event->Header.ProcessId;
+  key.level = event->Header.Class.Level;
+  if (last_counts_ == NULL || !(key == last_key_)) {
+    last_key_ = key;
+    last_counts_ = &pending_[key];
+  }
+
+  ++last_counts_->events;
+  last_counts_->bytes += event->Header.Size;
+}
+
+void EventRateStats::Flush() {
+  if (pending_.empty())
+    return;
+
+  {
+    base::AutoLock lock(lock_);
+    CountsMap::const_iterator it(pending_.begin());
+    for (; it != pending_.end(); ++it) {
+      Source& source = sources_[it->first];
+      source.interval.events += it->second.events;
+      source.interval.bytes += it->second.bytes;
+    }
+  }
+
+  pending_.clear();
+  last_counts_ = NULL;
+}
+
+void EventRateStats::EndInterval(base::TimeTicks now) {
+  base::AutoLock lock(lock_);
+  if (interval_start_.is_null()) {
+    interval_start_ = now;
+    return;
+  }
+
+  double seconds = (now - interval_start_).InSecondsF();
+  interval_start_ = now;
+  if (seconds <= 0)
+    return;
+
+  SourceMap::iterator it(sources_.begin());
+  for (; it != sources_.end(); ++it) {
+    Source& source = it->second;
+    source.events_per_second = source.interval.events / seconds;
+    source.bytes_per_second = source.interval.bytes / seconds;
+    source.total.events += source.interval.events;
+    source.total.bytes += source.interval.bytes;
+    source.interval = Counts();
+
+    source.history.push_back(source.events_per_second);
+    if (source.history.size() > history_length_)
+      source.history.pop_front();
+  }
+}
+
+void EventRateStats::GetRates(std::vector<Rates>* rates) const {
+  DCHECK(rates != NULL);
+  rates->clear();
+
+  {
+    base::AutoLock lock(lock_);
+    rates->reserve(sources_.size());
+    SourceMap::const_iterator it(sources_.begin());
+    for (; it != sources_.end(); ++it) {
+      const Source& source = it->second;
+      rates->push_back(Rates());
+      Rates& rate = rates->back();
+      rate.key = it->first;
+      // The totals include the interval in progress.
+      rate.events = source.total.events + source.interval.events;
+      rate.bytes = source.total.bytes + source.interval.bytes;
+      rate.events_per_second = source.events_per_second;
+      rate.bytes_per_second = source.bytes_per_second;
+      rate.history.assign(source.history.begin(), source.history.end());
+    }
+  }
+
+  std::sort(rates->begin(), rates->end(), BusiestFirst);
+}
+
+std::wstring MakeSparkline(const std::vector<double>& values) {
+  // The lower block elements, from one eighth high to full height.
+  static const wchar_t kBlocks[] = L"\x2581\x2582\x2583\x2584"
+                                   L"\x2585\x2586\x2587\x2588";
+  const int kNumBlocks = arraysize(kBlocks) - 1;
+
+  double max = 0;
+  for (size_t i = 0; i < values.size(); ++i)
+    max = std::max(max, values[i]);
+
+  std::wstring line;
+  for (size_t i = 0; i < values.size(); ++i) {
+    int block = 0;
+    if (max > 0)
+      block = static_cast<int>(values[i] / max * (kNumBlocks - 1) + 0.5);
+    line += kBlocks[std::max(0, std::min(block, kNumBlocks - 1))];
+  }
+
+  return line;
+}
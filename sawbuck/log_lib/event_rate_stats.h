@@ -0,0 +1,137 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event rate statistics declaration.
+#ifndef SAWBUCK_LOG_LIB_EVENT_RATE_STATS_H_
+#define SAWBUCK_LOG_LIB_EVENT_RATE_STATS_H_
+
+#include <windows.h>
+#include <cguid.h>
+#include <evntrace.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+
+// Tallies the events of a session by their source, to tell which process
+// or provider floods the session. The sources are keyed on event class,
+// process and level. Legacy ETW events carry the class of the event but not
+// the provider that logged it, and the providers that log like Chrome
+// share their classes, so the process tells those providers apart.
+//
+// The consumer thread adds events to a tally of its own, without locking,
+// and flushes the tally at the end of each buffer. The reader closes an
+// interval at a time, which turns the counts since the last interval into
+// rates and appends them to the history of each source.
+class EventRateStats {
+ public:
+  struct Key {
+    Key() : event_class(GUID_NULL), process_id(0), level(0) {
+    }
+
+    bool operator<(const Key& other) const;
+    bool operator==(const Key& other) const;
+
+    GUID event_class;
+    DWORD process_id;
+    UCHAR level;
+  };
+
+  struct Rates {
+    Rates() : events(0), bytes(0), events_per_second(0),
+        bytes_per_second(0) {
+    }
+
+    Key key;
+    // The totals since the first event.
+    uint64 events;
+    uint64 bytes;
+    // The rates over the last interval.
+    double events_per_second;
+    double bytes_per_second;
+    // The events per second of the past intervals, oldest first.
+    std::vector<double> history;
+  };
+
+  // @param history_length the number of intervals of history to keep.
+  explicit EventRateStats(size_t history_length);
+  ~EventRateStats();
+
+  // Consumer side.
+  // @{
+  // Counts @p event against its source.
+  void AddEvent(const EVENT_TRACE* event);
+  // Publishes the events added since the last flush to the reader.
+  void Flush();
+  // @}
+
+  // Reader side.
+  // @{
+  // Closes the interval that ends at @p now. The first call only starts
+  // the first interval.
+  void EndInterval(base::TimeTicks now);
+  // @returns the rates of all sources, the busiest first.
+  void GetRates(std::vector<Rates>* rates) const;
+  // @}
+
+  // Orders rates the way GetRates does, for merging those of several
+  // sessions.
+  static bool BusiestFirst(const Rates& a, const Rates& b);
+
+ private:
+  struct Counts {
+    Counts() : events(0), bytes(0) {
+    }
+
+    uint64 events;
+    uint64 bytes;
+  };
+  typedef std::map<Key, Counts> CountsMap;
+
+  struct Source {
+    Source() : events_per_second(0), bytes_per_second(0) {
+    }
+
+    Counts total;
+    Counts interval;
+    double events_per_second;
+    double bytes_per_second;
+    std::deque<double> history;
+  };
+  typedef std::map<Key, Source> SourceMap;
+
+  const size_t history_length_;
+
+  // Owned by the consumer thread. Events mostly come in runs from the
+  // same source, so we remember the last one's counts.
+  CountsMap pending_;
+  Key last_key_;
+  Counts* last_counts_;
+
+  // Protects the members below.
+  mutable base::Lock lock_;
+  SourceMap sources_;
+  base::TimeTicks interval_start_;
+
+  DISALLOW_COPY_AND_ASSIGN(EventRateStats);
+};
+
+// @returns a line of block characters, one per value, whose height tracks
+//    each value relative to the largest of @p values.
+std::wstring MakeSparkline(const std::vector<double>& values);
+
+#endif  // SAWBUCK_LOG_LIB_EVENT_RATE_STATS_H_
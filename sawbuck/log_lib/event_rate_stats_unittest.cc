@@ -0,0 +1,123 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event rate statistics unittests.
+#include "sawbuck/log_lib/event_rate_stats.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const GUID kEventClass = { 0x1A2B3C4D, 0x5E6F, 0x7081,
+    { 0x92, 0xA3, 0xB4, 0xC5, 0xD6, 0xE7, 0xF8, 0x09 } };
+
+class EventRateStatsTest: public testing::Test {
+ public:
+  EventRateStatsTest() : stats_(3), t0_(base::TimeTicks::Now()) {
+  }
+
+  // Adds @p count events of @p size bytes from @p pid at @p level.
+  void Add(DWORD pid, UCHAR level, USHORT size, int count) {
+    EVENT_TRACE event = {};
+    event.Header.Guid = kEventClass;
+    event.Header.ProcessId = pid;
+    event.Header.Class.Level = level;
+    event.Header.Size = size;
+    for (int i = 0; i < count; ++i)
+      stats_.AddEvent(&event);
+  }
+
+  // Ends the interval at @p seconds past t0_.
+  void EndInterval(int seconds) {
+    stats_.EndInterval(t0_ + base::TimeDelta::FromSeconds(seconds));
+  }
+
+ protected:
+  EventRateStats stats_;
+  const base::TimeTicks t0_;
+};
+
+}  // namespace
+
+TEST_F(EventRateStatsTest, RatesBySource) {
+  EndInterval(0);
+  Add(1, TRACE_LEVEL_ERROR, 100, 10);
+  Add(2, TRACE_LEVEL_INFORMATION, 50, 40);
+  Add(1, TRACE_LEVEL_ERROR, 100, 10);
+  stats_.Flush();
+  EndInterval(2);
+
+  std::vector<EventRateStats::Rates> rates;
+  stats_.GetRates(&rates);
+  ASSERT_EQ(2U, rates.size());
+
+  // The busiest comes first.
+  EXPECT_EQ(2U, rates[0].key.process_id);
+  EXPECT_EQ(TRACE_LEVEL_INFORMATION, rates[0].key.level);
+  EXPECT_EQ(40U, rates[0].events);
+  EXPECT_EQ(2000U, rates[0].bytes);
+  EXPECT_EQ(20.0, rates[0].events_per_second);
+  EXPECT_EQ(1000.0, rates[0].bytes_per_second);
+
+  EXPECT_EQ(1U, rates[1].key.process_id);
+  EXPECT_EQ(20U, rates[1].events);
+  EXPECT_EQ(10.0, rates[1].events_per_second);
+}
+
+TEST_F(EventRateStatsTest, UnflushedEventsAreNotSeen) {
+  Add(1, TRACE_LEVEL_ERROR, 100, 10);
+
+  std::vector<EventRateStats::Rates> rates;
+  stats_.GetRates(&rates);
+  EXPECT_TRUE(rates.empty());
+
+  // Flushed, the events count in the totals before the interval ends.
+  stats_.Flush();
+  stats_.GetRates(&rates);
+  ASSERT_EQ(1U, rates.size());
+  EXPECT_EQ(10U, rates[0].events);
+  EXPECT_EQ(0.0, rates[0].events_per_second);
+}
+
+TEST_F(EventRateStatsTest, HistoryIsCapped) {
+  EndInterval(0);
+  for (int i = 1; i <= 5; ++i) {
+    Add(1, TRACE_LEVEL_ERROR, 10, i);
+    stats_.Flush();
+    EndInterval(i);
+  }
+
+  std::vector<EventRateStats::Rates> rates;
+  stats_.GetRates(&rates);
+  ASSERT_EQ(1U, rates.size());
+  EXPECT_EQ(15U, rates[0].events);
+  ASSERT_EQ(3U, rates[0].history.size());
+  EXPECT_EQ(3.0, rates[0].history[0]);
+  EXPECT_EQ(4.0, rates[0].history[1]);
+  EXPECT_EQ(5.0, rates[0].history[2]);
+}
+
+TEST(MakeSparklineTest, ScalesToMax) {
+  std::vector<double> values;
+  EXPECT_EQ(L"", MakeSparkline(values));
+
+  values.push_back(0);
+  values.push_back(50);
+  values.push_back(100);
+  EXPECT_EQ(L"\x2581\x2585\x2588", MakeSparkline(values));
+
+  // All zeros make a flat line.
+  std::vector<double> zeros(2, 0.0);
+  EXPECT_EQ(L"\x2581\x2581", MakeSparkline(zeros));
+}
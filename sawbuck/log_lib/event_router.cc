@@ -0,0 +1,103 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event router implementation.
+#include "sawbuck/log_lib/event_router.h"
+
+#include "base/logging.h"
+#include "sawbuck/common/perf_counters.h"
+
+namespace {
+
+// The initial table size, as a power of two.
+const int kInitialTableBits = 4;
+
+// Events are parsed by the hundred thousand, so only a few are timed.
+PerfCounter parse_event_counter("Parse.Event", 64);
+
+// Mixes the words of a GUID into 32 bits, whose top bits index the table.
+uint32 HashEventClass(const GUID& event_class) {
+  COMPILE_ASSERT(sizeof(GUID) == 4 * sizeof(uint32), guid_is_four_words);
+  const uint32* words = reinterpret_cast<const uint32*>(&event_class);
+  // This is Fibonacci hashing, the multiply spreads the bits upwards.
+  return (words[0] ^ words[1] ^ words[2] ^ words[3]) * 0x9E3779B1U;
+}
+
+}  // namespace
+
+EventRouter::EventRouter()
+    : slots_(1 << kInitialTableBits),
+      hash_shift_(32 - kInitialTableBits),
+      num_event_classes_(0) {
+}
+
+EventRouter::~EventRouter() {
+}
+
+void EventRouter::AddEventClass(const GUID& event_class,
+                                const EventParser& parser) {
+  DCHECK(!parser.is_null());
+
+  size_t slot = FindSlot(event_class);
+  if (slots_[slot].parser.is_null()) {
+    if (2 * (num_event_classes_ + 1) > slots_.size()) {
+      Grow();
+      slot = FindSlot(event_class);
+    }
+
+    slots_[slot].event_class = event_class;
+    ++num_event_classes_;
+  }
+
+  slots_[slot].parser = parser;
+}
+
+bool EventRouter::ProcessOneEvent(EVENT_TRACE* event) const {
+  DCHECK(event != NULL);
+
+  const Slot& slot = slots_[FindSlot(event->Header.Guid)];
+  if (slot.parser.is_null())
+    return false;
+
+  ScopedPerfTimer timer(&parse_event_counter);
+  return slot.parser.Run(event);
+}
+
+size_t EventRouter::FindSlot(const GUID& event_class) const {
+  size_t mask = slots_.size() - 1;
+  size_t slot = HashEventClass(event_class) >> hash_shift_;
+
+  // The table is never full, so this finds the class or an empty slot.
+  while (!slots_[slot].parser.is_null() &&
+         slots_[slot].event_class != event_class) {
+    slot = (slot + 1) & mask;
+  }
+
+  return slot;
+}
+
+void EventRouter::Grow() {
+  std::vector<Slot> old_slots(slots_.size() * 2);
+  old_slots.swap(slots_);
+  --hash_shift_;
+
+  for (size_t i = 0; i < old_slots.size(); ++i) {
+    if (old_slots[i].parser.is_null())
+      continue;
+
+    size_t slot = FindSlot(old_slots[i].event_class);
+    DCHECK(slots_[slot].parser.is_null());
+    slots_[slot] = old_slots[i];
+  }
+}
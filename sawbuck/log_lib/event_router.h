@@ -0,0 +1,73 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event router declaration.
+#ifndef SAWBUCK_LOG_LIB_EVENT_ROUTER_H_
+#define SAWBUCK_LOG_LIB_EVENT_ROUTER_H_
+
+#include <windows.h>
+#include <wmistr.h>
+#include <evntrace.h>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/callback.h"
+
+// Routes events to the parsers registered for their event class. The class
+// GUID is hashed once into a small open-addressed table, so the cost of
+// routing an event doesn't grow with the number of classes registered.
+class EventRouter {
+ public:
+  // Parses an event.
+  // @returns true iff the event resulted in a notification.
+  typedef base::Callback<bool(EVENT_TRACE* event)> EventParser;
+
+  EventRouter();
+  ~EventRouter();
+
+  // Routes the events of @p event_class to @p parser, in place of the
+  // parser the class had, if any.
+  void AddEventClass(const GUID& event_class, const EventParser& parser);
+
+  // Routes an event to the parser for its class.
+  // @returns true iff the event has a parser, and it resulted in a
+  //     notification.
+  bool ProcessOneEvent(EVENT_TRACE* event) const;
+
+  size_t num_event_classes() const { return num_event_classes_; }
+
+ private:
+  struct Slot {
+    GUID event_class;
+    // Null for an empty slot.
+    EventParser parser;
+  };
+
+  // Returns the slot @p event_class lives in, or the empty slot it would
+  // go in.
+  size_t FindSlot(const GUID& event_class) const;
+
+  // Doubles the table and rehashes the slots into it.
+  void Grow();
+
+  // The table is a power of two in size, and kept no more than half full
+  // so the probe sequences stay short.
+  std::vector<Slot> slots_;
+  // The table size is 2 ^ (32 - hash_shift_).
+  int hash_shift_;
+  size_t num_event_classes_;
+
+  DISALLOW_COPY_AND_ASSIGN(EventRouter);
+};
+
+#endif  // SAWBUCK_LOG_LIB_EVENT_ROUTER_H_
@@ -0,0 +1,107 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event router unittests.
+#include "sawbuck/log_lib/event_router.h"
+
+#include "base/bind.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using testing::_;
+using testing::Return;
+using testing::StrictMock;
+
+class MockParser {
+ public:
+  MOCK_METHOD2(Parse, bool(int id, EVENT_TRACE* event));
+
+  EventRouter::EventParser Bind(int id) {
+    return base::Bind(&MockParser::Parse, base::Unretained(this), id);
+  }
+};
+
+// Makes a distinct event class for each @p i.
+GUID MakeEventClass(int i) {
+  GUID event_class = { 0x1A2B3C4D, 0x5E6F, 0x7081,
+                       { 0x92, 0xA3, 0xB4, 0xC5, 0xD6, 0xE7, 0xF8, 0x09 } };
+  event_class.Data4[7] = static_cast<unsigned char>(i);
+  event_class.Data1 += i / 256;
+  return event_class;
+}
+
+class EventRouterTest: public testing::Test {
+ public:
+  EventRouterTest() {
+    memset(&event_, 0, sizeof(event_));
+  }
+
+  bool Route(const GUID& event_class) {
+    event_.Header.Guid = event_class;
+    return router_.ProcessOneEvent(&event_);
+  }
+
+ protected:
+  EventRouter router_;
+  StrictMock<MockParser> parser_;
+  EVENT_TRACE event_;
+};
+
+}  // namespace
+
+TEST_F(EventRouterTest, UnknownClass) {
+  EXPECT_EQ(0U, router_.num_event_classes());
+  EXPECT_FALSE(Route(MakeEventClass(0)));
+
+  router_.AddEventClass(MakeEventClass(1), parser_.Bind(1));
+  EXPECT_FALSE(Route(MakeEventClass(0)));
+}
+
+TEST_F(EventRouterTest, RoutesByClass) {
+  router_.AddEventClass(MakeEventClass(1), parser_.Bind(1));
+  router_.AddEventClass(MakeEventClass(2), parser_.Bind(2));
+  EXPECT_EQ(2U, router_.num_event_classes());
+
+  EXPECT_CALL(parser_, Parse(1, &event_)).WillOnce(Return(true));
+  EXPECT_TRUE(Route(MakeEventClass(1)));
+
+  // The parser's result is passed on.
+  EXPECT_CALL(parser_, Parse(2, &event_)).WillOnce(Return(false));
+  EXPECT_FALSE(Route(MakeEventClass(2)));
+}
+
+TEST_F(EventRouterTest, ReplacesParser) {
+  router_.AddEventClass(MakeEventClass(1), parser_.Bind(1));
+  router_.AddEventClass(MakeEventClass(1), parser_.Bind(2));
+  EXPECT_EQ(1U, router_.num_event_classes());
+
+  EXPECT_CALL(parser_, Parse(2, &event_)).WillOnce(Return(true));
+  EXPECT_TRUE(Route(MakeEventClass(1)));
+}
+
+TEST_F(EventRouterTest, ManyClasses) {
+  // Enough classes to grow the table a few times.
+  const int kNumClasses = 1000;
+  for (int i = 0; i < kNumClasses; ++i)
+    router_.AddEventClass(MakeEventClass(i), parser_.Bind(i));
+  EXPECT_EQ(static_cast<size_t>(kNumClasses), router_.num_event_classes());
+
+  for (int i = 0; i < kNumClasses; ++i) {
+    EXPECT_CALL(parser_, Parse(i, &event_)).WillOnce(Return(true));
+    EXPECT_TRUE(Route(MakeEventClass(i)));
+  }
+  EXPECT_FALSE(Route(MakeEventClass(kNumClasses)));
+}
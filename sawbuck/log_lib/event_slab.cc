@@ -0,0 +1,83 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event slab implementation.
+#include "sawbuck/log_lib/event_slab.h"
+
+#include "base/logging.h"
+
+namespace {
+
+// The copies start on eight byte boundaries, as do the events in the ETW
+// buffers.
+const size_t kAlignment = sizeof(uint64);
+
+size_t Align(size_t size) {
+  return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+}  // namespace
+
+EventSlab::EventSlab(size_t capacity)
+    : storage_(Align(capacity) / kAlignment),
+      capacity_(Align(capacity)),
+      used_(0),
+      num_events_(0) {
+}
+
+EventSlab::~EventSlab() {
+}
+
+// static
+size_t EventSlab::GetRecordSize(const EVENT_TRACE* event) {
+  DCHECK(event != NULL);
+  return Align(sizeof(*event)) + Align(event->MofLength);
+}
+
+bool EventSlab::Append(const EVENT_TRACE* event) {
+  DCHECK(event != NULL);
+  size_t size = GetRecordSize(event);
+  if (size > capacity_ - used_)
+    return false;
+
+  uint8* record = reinterpret_cast<uint8*>(&storage_[0]) + used_;
+  EVENT_TRACE* copy = reinterpret_cast<EVENT_TRACE*>(record);
+  *copy = *event;
+  copy->MofData = NULL;
+  if (event->MofLength != 0) {
+    copy->MofData = record + Align(sizeof(*event));
+    memcpy(copy->MofData, event->MofData, event->MofLength);
+  }
+
+  used_ += size;
+  ++num_events_;
+  return true;
+}
+
+EVENT_TRACE* EventSlab::GetNext(size_t* offset) {
+  DCHECK(offset != NULL);
+  if (*offset >= used_)
+    return NULL;
+
+  uint8* record = reinterpret_cast<uint8*>(&storage_[0]) + *offset;
+  EVENT_TRACE* event = reinterpret_cast<EVENT_TRACE*>(record);
+  *offset += GetRecordSize(event);
+  DCHECK_LE(*offset, used_);
+  return event;
+}
+
+void EventSlab::Clear() {
+  used_ = 0;
+  num_events_ = 0;
+}
@@ -0,0 +1,67 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event slab declaration.
+#ifndef SAWBUCK_LOG_LIB_EVENT_SLAB_H_
+#define SAWBUCK_LOG_LIB_EVENT_SLAB_H_
+
+#include <windows.h>
+#include <wmistr.h>
+#include <evntrace.h>
+#include <vector>
+#include "base/basictypes.h"
+
+// A buffer of a fixed size that ETW events are copied to, header and
+// payload alike, so the copies outlive the ETW buffer they came in. The
+// copies are EVENT_TRACE structures whose MofData points into the slab, so
+// they parse like the events they copy. Appending doesn't allocate, which
+// keeps it cheap enough for the ETW callbacks.
+class EventSlab {
+ public:
+  // @param capacity the bytes of events the slab holds.
+  explicit EventSlab(size_t capacity);
+  ~EventSlab();
+
+  // @returns the bytes the copy of @p event takes in a slab.
+  static size_t GetRecordSize(const EVENT_TRACE* event);
+
+  // Copies @p event to the end of the slab.
+  // @returns false if there's no room for it, in which case the slab is
+  //     left as it was.
+  bool Append(const EVENT_TRACE* event);
+
+  // Retrieves the copy at @p offset, and advances @p offset past it. Start
+  // at offset zero to go through the copies in the order they came.
+  // @returns NULL past the last copy.
+  EVENT_TRACE* GetNext(size_t* offset);
+
+  // Empties the slab, keeping its storage.
+  void Clear();
+
+  bool empty() const { return num_events_ == 0; }
+  size_t num_events() const { return num_events_; }
+  size_t used() const { return used_; }
+  size_t capacity() const { return capacity_; }
+
+ private:
+  // In units of eight bytes, for the alignment of the copies.
+  std::vector<uint64> storage_;
+  const size_t capacity_;
+  size_t used_;
+  size_t num_events_;
+
+  DISALLOW_COPY_AND_ASSIGN(EventSlab);
+};
+
+#endif  // SAWBUCK_LOG_LIB_EVENT_SLAB_H_
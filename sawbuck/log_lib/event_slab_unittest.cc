@@ -0,0 +1,115 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event slab unittests.
+#include "sawbuck/log_lib/event_slab.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// {01234567-89AB-CDEF-0123-456789ABCDEF}
+const GUID kEventClass = { 0x01234567, 0x89AB, 0xCDEF,
+    { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF } };
+
+void InitEvent(UCHAR type, const char* data, EVENT_TRACE* event) {
+  memset(event, 0, sizeof(*event));
+  event->Header.Guid = kEventClass;
+  event->Header.Class.Type = type;
+  event->Header.ProcessId = 1234;
+  event->Header.ThreadId = 4321;
+  event->Header.TimeStamp.QuadPart = 1000 + type;
+  event->MofData = const_cast<char*>(data);
+  event->MofLength = static_cast<ULONG>(strlen(data) + 1);
+}
+
+}  // namespace
+
+TEST(EventSlabTest, CopiesEvents) {
+  EventSlab slab(1024);
+  EXPECT_TRUE(slab.empty());
+
+  char first_data[] = "first";
+  char second_data[] = "second event";
+  EVENT_TRACE first = {};
+  EVENT_TRACE second = {};
+  InitEvent(1, first_data, &first);
+  InitEvent(2, second_data, &second);
+  ASSERT_TRUE(slab.Append(&first));
+  ASSERT_TRUE(slab.Append(&second));
+  EXPECT_EQ(2U, slab.num_events());
+  EXPECT_EQ(EventSlab::GetRecordSize(&first) +
+                EventSlab::GetRecordSize(&second),
+            slab.used());
+
+  // The copies hold on to the payloads after the originals change.
+  first_data[0] = 'F';
+  second_data[0] = 'S';
+
+  size_t offset = 0;
+  EVENT_TRACE* event = slab.GetNext(&offset);
+  ASSERT_TRUE(event != NULL);
+  EXPECT_EQ(1, event->Header.Class.Type);
+  EXPECT_EQ(1234U, event->Header.ProcessId);
+  EXPECT_EQ(4321U, event->Header.ThreadId);
+  EXPECT_EQ(1001, event->Header.TimeStamp.QuadPart);
+  EXPECT_STREQ("first", reinterpret_cast<const char*>(event->MofData));
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(event->MofData) % 8);
+
+  event = slab.GetNext(&offset);
+  ASSERT_TRUE(event != NULL);
+  EXPECT_EQ(2, event->Header.Class.Type);
+  EXPECT_STREQ("second event",
+               reinterpret_cast<const char*>(event->MofData));
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(event) % 8);
+
+  EXPECT_TRUE(slab.GetNext(&offset) == NULL);
+}
+
+TEST(EventSlabTest, RefusesWhatDoesntFit) {
+  char data[] = "payload";
+  EVENT_TRACE event = {};
+  InitEvent(1, data, &event);
+  size_t record_size = EventSlab::GetRecordSize(&event);
+
+  EventSlab slab(record_size * 2);
+  EXPECT_TRUE(slab.Append(&event));
+  EXPECT_TRUE(slab.Append(&event));
+  EXPECT_FALSE(slab.Append(&event));
+  EXPECT_EQ(2U, slab.num_events());
+  EXPECT_EQ(slab.capacity(), slab.used());
+
+  slab.Clear();
+  EXPECT_TRUE(slab.empty());
+  EXPECT_EQ(0U, slab.used());
+  size_t offset = 0;
+  EXPECT_TRUE(slab.GetNext(&offset) == NULL);
+  EXPECT_TRUE(slab.Append(&event));
+}
+
+TEST(EventSlabTest, CopiesEmptyPayloads) {
+  EVENT_TRACE event = {};
+  InitEvent(3, "", &event);
+  event.MofData = NULL;
+  event.MofLength = 0;
+
+  EventSlab slab(256);
+  ASSERT_TRUE(slab.Append(&event));
+  size_t offset = 0;
+  EVENT_TRACE* copy = slab.GetNext(&offset);
+  ASSERT_TRUE(copy != NULL);
+  EXPECT_TRUE(copy->MofData == NULL);
+  EXPECT_EQ(0U, copy->MofLength);
+  EXPECT_TRUE(slab.GetNext(&offset) == NULL);
+}
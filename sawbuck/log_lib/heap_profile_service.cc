@@ -0,0 +1,310 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Heap profile service implementation.
+#include "sawbuck/log_lib/heap_profile_service.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+// Orders stacks most bytes outstanding first.
+bool HasMoreBytes(const IHeapProfileService::OutstandingStack& a,
+                  const IHeapProfileService::OutstandingStack& b) {
+  if (a.bytes_ != b.bytes_)
+    return a.bytes_ > b.bytes_;
+  return a.allocations_ > b.allocations_;
+}
+
+}  // namespace
+
+const size_t HeapProfileService::kDefaultMaxAllocations;
+const HeapProfileService::StackId HeapProfileService::kEmptyStack;
+
+IHeapProfileService::OutstandingStack::OutstandingStack()
+    : stack_id_(0), bytes_(0), allocations_(0) {
+}
+
+HeapProfileService::ProcessHeap::ProcessHeap() : bytes(0) {
+}
+
+HeapProfileService::HeapProfileService()
+    : max_allocations_(kDefaultMaxAllocations), num_allocations_(0),
+      num_dropped_allocations_(0), num_unknown_frees_(0) {
+  StackNode root = { kEmptyStack, 0 };
+  stack_nodes_.push_back(root);
+}
+
+HeapProfileService::HeapProfileService(size_t max_allocations)
+    : max_allocations_(max_allocations), num_allocations_(0),
+      num_dropped_allocations_(0), num_unknown_frees_(0) {
+  DCHECK_LT(0U, max_allocations);
+  StackNode root = { kEmptyStack, 0 };
+  stack_nodes_.push_back(root);
+}
+
+HeapProfileService::~HeapProfileService() {
+}
+
+void HeapProfileService::set_end_time(const base::Time& end_time) {
+  base::AutoLock lock(lock_);
+  end_time_ = end_time;
+}
+
+base::Time HeapProfileService::latest_time() {
+  base::AutoLock lock(lock_);
+  return latest_time_;
+}
+
+uint64 HeapProfileService::num_dropped_allocations() {
+  base::AutoLock lock(lock_);
+  return num_dropped_allocations_;
+}
+
+uint64 HeapProfileService::num_unknown_frees() {
+  base::AutoLock lock(lock_);
+  return num_unknown_frees_;
+}
+
+size_t HeapProfileService::num_stack_nodes() {
+  base::AutoLock lock(lock_);
+  return stack_nodes_.size() - 1;
+}
+
+void HeapProfileService::GetProcessIds(std::vector<DWORD>* process_ids) {
+  DCHECK(process_ids != NULL);
+  process_ids->clear();
+
+  base::AutoLock lock(lock_);
+  ProcessHeapMap::const_iterator it(heaps_.begin());
+  for (; it != heaps_.end(); ++it) {
+    if (!it->second.allocations.empty())
+      process_ids->push_back(it->first);
+  }
+}
+
+uint64 HeapProfileService::GetTopStacks(
+    DWORD process_id,
+    size_t max_stacks,
+    std::vector<OutstandingStack>* stacks) {
+  DCHECK(stacks != NULL);
+  stacks->clear();
+
+  base::AutoLock lock(lock_);
+  ProcessHeapMap::const_iterator heap(heaps_.find(process_id));
+  if (heap == heaps_.end())
+    return 0;
+
+  const StackTotalMap& totals = heap->second.stack_totals;
+  stacks->reserve(totals.size());
+  StackTotalMap::const_iterator it(totals.begin());
+  for (; it != totals.end(); ++it) {
+    OutstandingStack stack;
+    stack.stack_id_ = it->first;
+    stack.bytes_ = it->second.bytes;
+    stack.allocations_ = it->second.allocations;
+    stacks->push_back(stack);
+  }
+
+  // There are far fewer stacks than blocks, but still too many to sort
+  // for a handful of the top ones.
+  size_t num_stacks = std::min(max_stacks, stacks->size());
+  std::partial_sort(stacks->begin(), stacks->begin() + num_stacks,
+                    stacks->end(), HasMoreBytes);
+  stacks->resize(num_stacks);
+
+  return heap->second.bytes;
+}
+
+void HeapProfileService::GetStackFrames(
+    StackId stack_id, std::vector<sym_util::Address>* frames) {
+  DCHECK(frames != NULL);
+  frames->clear();
+
+  base::AutoLock lock(lock_);
+  DCHECK_LT(stack_id, stack_nodes_.size());
+  for (; stack_id != kEmptyStack; stack_id = stack_nodes_[stack_id].parent)
+    frames->push_back(stack_nodes_[stack_id].address);
+}
+
+void HeapProfileService::OnHeapAlloc(const base::Time& time,
+                                     DWORD process_id,
+                                     DWORD thread_id,
+                                     sym_util::Address heap,
+                                     sym_util::Address address,
+                                     uint64 size) {
+  base::AutoLock lock(lock_);
+  if (!Apply(time))
+    return;
+
+  Allocate(process_id, thread_id, address, size);
+}
+
+void HeapProfileService::OnHeapRealloc(const base::Time& time,
+                                       DWORD process_id,
+                                       DWORD thread_id,
+                                       sym_util::Address heap,
+                                       sym_util::Address old_address,
+                                       sym_util::Address new_address,
+                                       uint64 new_size) {
+  base::AutoLock lock(lock_);
+  if (!Apply(time))
+    return;
+
+  // The block takes the stack of the reallocation, as that's what keeps
+  // it alive at its new size.
+  if (!Release(&heaps_[process_id], old_address))
+    ++num_unknown_frees_;
+  Allocate(process_id, thread_id, new_address, new_size);
+}
+
+void HeapProfileService::OnHeapFree(const base::Time& time,
+                                    DWORD process_id,
+                                    DWORD thread_id,
+                                    sym_util::Address heap,
+                                    sym_util::Address address) {
+  base::AutoLock lock(lock_);
+  if (!Apply(time))
+    return;
+
+  // The stack walk that follows is the free's, not that of an allocation
+  // whose own walk went missing.
+  pending_stacks_.erase(thread_id);
+
+  ProcessHeapMap::iterator it(heaps_.find(process_id));
+  if (it == heaps_.end() || !Release(&it->second, address))
+    ++num_unknown_frees_;
+}
+
+void HeapProfileService::OnStackWalk(const base::Time& time,
+                                     DWORD process_id,
+                                     DWORD thread_id,
+                                     size_t num_frames,
+                                     const sym_util::Address* frames) {
+  DCHECK(num_frames == 0 || frames != NULL);
+  base::AutoLock lock(lock_);
+  if (!Apply(time))
+    return;
+
+  // The stacks of other events, if the session asked for them, don't
+  // follow an allocation.
+  PendingStackMap::iterator pending(pending_stacks_.find(thread_id));
+  if (pending == pending_stacks_.end())
+    return;
+  PendingStack stack = pending->second;
+  pending_stacks_.erase(pending);
+  if (stack.process_id != process_id)
+    return;
+
+  ProcessHeap& heap = heaps_[process_id];
+  AllocationMap::iterator it(heap.allocations.find(stack.address));
+  if (it == heap.allocations.end() || it->second.stack_id != kEmptyStack)
+    return;
+
+  Allocation& allocation = it->second;
+  int64 size = static_cast<int64>(allocation.size);
+  allocation.stack_id = InternStack(num_frames, frames);
+  AddToStack(&heap, kEmptyStack, -size, -1);
+  AddToStack(&heap, allocation.stack_id, size, 1);
+}
+
+bool HeapProfileService::Apply(const base::Time& time) {
+  lock_.AssertAcquired();
+  if (!end_time_.is_null() && time > end_time_)
+    return false;
+
+  if (time > latest_time_)
+    latest_time_ = time;
+  return true;
+}
+
+void HeapProfileService::Allocate(DWORD process_id,
+                                  DWORD thread_id,
+                                  sym_util::Address address,
+                                  uint64 size) {
+  lock_.AssertAcquired();
+  ProcessHeap& heap = heaps_[process_id];
+
+  // A block at a live address means we missed its free, e.g. to a lost
+  // buffer, so the old block is gone.
+  Release(&heap, address);
+
+  if (num_allocations_ >= max_allocations_) {
+    ++num_dropped_allocations_;
+    pending_stacks_.erase(thread_id);
+    return;
+  }
+
+  Allocation allocation = { size, kEmptyStack };
+  heap.allocations.insert(std::make_pair(address, allocation));
+  ++num_allocations_;
+  AddToStack(&heap, kEmptyStack, static_cast<int64>(size), 1);
+
+  // An allocation whose stack walk never came is superseded, and stays
+  // under the empty stack.
+  PendingStack& pending = pending_stacks_[thread_id];
+  pending.process_id = process_id;
+  pending.address = address;
+}
+
+bool HeapProfileService::Release(ProcessHeap* heap,
+                                 sym_util::Address address) {
+  lock_.AssertAcquired();
+  DCHECK(heap != NULL);
+  AllocationMap::iterator it(heap->allocations.find(address));
+  if (it == heap->allocations.end())
+    return false;
+
+  AddToStack(heap, it->second.stack_id,
+             -static_cast<int64>(it->second.size), -1);
+  heap->allocations.erase(it);
+  --num_allocations_;
+  return true;
+}
+
+void HeapProfileService::AddToStack(ProcessHeap* heap, StackId stack_id,
+                                    int64 bytes, int64 allocations) {
+  DCHECK(heap != NULL);
+  StackTotal& total = heap->stack_totals[stack_id];
+  total.bytes += bytes;
+  total.allocations += allocations;
+  heap->bytes += bytes;
+
+  // The stacks with nothing outstanding are dropped, so the tallies only
+  // grow with the stacks of live blocks.
+  if (total.allocations == 0)
+    heap->stack_totals.erase(stack_id);
+}
+
+HeapProfileService::StackId HeapProfileService::InternStack(
+    size_t num_frames, const sym_util::Address* frames) {
+  lock_.AssertAcquired();
+
+  // The tree is rooted at the outermost frame, so walk the stack outwards
+  // in.
+  StackId stack_id = kEmptyStack;
+  for (size_t i = num_frames; i > 0; --i) {
+    std::pair<StackNodeMap::iterator, bool> inserted(
+        stack_node_ids_.insert(std::make_pair(
+            std::make_pair(stack_id, frames[i - 1]), stack_nodes_.size())));
+    if (inserted.second) {
+      StackNode node = { stack_id, frames[i - 1] };
+      stack_nodes_.push_back(node);
+    }
+    stack_id = inserted.first->second;
+  }
+
+  return stack_id;
+}
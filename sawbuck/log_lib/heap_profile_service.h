@@ -0,0 +1,212 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Heap profile service declaration.
+#ifndef SAWBUCK_LOG_LIB_HEAP_PROFILE_SERVICE_H_
+#define SAWBUCK_LOG_LIB_HEAP_PROFILE_SERVICE_H_
+
+#include <map>
+#include <utility>
+#include <vector>
+#include "base/containers/hash_tables.h"
+#include "base/synchronization/lock.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+
+class IHeapProfileService {
+ public:
+  // Identifies an interned stack by its innermost call tree node.
+  typedef size_t StackId;
+
+  // The live allocations of a stack.
+  struct OutstandingStack {
+    OutstandingStack();
+
+    StackId stack_id_;
+    uint64 bytes_;
+    uint64 allocations_;
+  };
+
+  // Retrieve the processes with live allocations, by process id, to
+  // @p process_ids.
+  virtual void GetProcessIds(std::vector<DWORD>* process_ids) = 0;
+
+  // Retrieve the stacks of the live allocations of @p process_id, most
+  // bytes first, to @p stacks. The allocations whose stack walk has yet
+  // to come, or never came, are under the empty stack.
+  // @param max_stacks the most stacks to retrieve.
+  // @returns the bytes outstanding in the process.
+  virtual uint64 GetTopStacks(DWORD process_id,
+                              size_t max_stacks,
+                              std::vector<OutstandingStack>* stacks) = 0;
+
+  // Retrieve the frames of @p stack_id, innermost first, to @p frames.
+  virtual void GetStackFrames(StackId stack_id,
+                              std::vector<sym_util::Address>* frames) = 0;
+};
+
+// The heap profile service sinks the heap events of a kernel log parser,
+// and tracks the live allocations of each process as of the latest event.
+// Each allocation is tied to the stack walk that follows it on the same
+// thread, and the stacks are interned into a call tree, so an allocation
+// costs an entry in its process' table of blocks by address however deep
+// its stack. The bytes outstanding are tallied by stack as the events
+// come, so that reports don't walk the blocks. The blocks tracked are
+// capped, and the tree only grows with the number of distinct stacks.
+class HeapProfileService
+    : public IHeapProfileService,
+      public KernelHeapEvents {
+ public:
+  // The default number of live allocations tracked.
+  static const size_t kDefaultMaxAllocations = 4 * 1024 * 1024;
+
+  // The empty stack, which is the root of the call tree.
+  static const StackId kEmptyStack = 0;
+
+  HeapProfileService();
+  explicit HeapProfileService(size_t max_allocations);
+  ~HeapProfileService();
+
+  // Ignore the events stamped after @p end_time, so that a log consumed
+  // through reports the heaps as of then. A null time, the default,
+  // applies every event.
+  void set_end_time(const base::Time& end_time);
+
+  // The time of the latest event applied, or null before the first.
+  base::Time latest_time();
+
+  // The allocations left untracked for the cap.
+  uint64 num_dropped_allocations();
+
+  // The frees of blocks we don't know of, most of which were allocated
+  // before the trace started.
+  uint64 num_unknown_frees();
+
+  // The number of distinct stacks interned, for testing.
+  size_t num_stack_nodes();
+
+  // IHeapProfileService implementation.
+  virtual void GetProcessIds(std::vector<DWORD>* process_ids);
+  virtual uint64 GetTopStacks(DWORD process_id,
+                              size_t max_stacks,
+                              std::vector<OutstandingStack>* stacks);
+  virtual void GetStackFrames(StackId stack_id,
+                              std::vector<sym_util::Address>* frames);
+
+  // KernelHeapEvents implementation.
+  virtual void OnHeapAlloc(const base::Time& time,
+                           DWORD process_id,
+                           DWORD thread_id,
+                           sym_util::Address heap,
+                           sym_util::Address address,
+                           uint64 size);
+  virtual void OnHeapRealloc(const base::Time& time,
+                             DWORD process_id,
+                             DWORD thread_id,
+                             sym_util::Address heap,
+                             sym_util::Address old_address,
+                             sym_util::Address new_address,
+                             uint64 new_size);
+  virtual void OnHeapFree(const base::Time& time,
+                          DWORD process_id,
+                          DWORD thread_id,
+                          sym_util::Address heap,
+                          sym_util::Address address);
+  virtual void OnStackWalk(const base::Time& time,
+                           DWORD process_id,
+                           DWORD thread_id,
+                           size_t num_frames,
+                           const sym_util::Address* frames);
+
+ private:
+  // A node of the call tree, standing for the stack of its frames up to
+  // and including its own.
+  struct StackNode {
+    StackId parent;
+    sym_util::Address address;
+  };
+  // A live block.
+  struct Allocation {
+    uint64 size;
+    StackId stack_id;
+  };
+  struct StackTotal {
+    uint64 bytes;
+    uint64 allocations;
+  };
+  typedef base::hash_map<sym_util::Address, Allocation> AllocationMap;
+  typedef base::hash_map<StackId, StackTotal> StackTotalMap;
+  // The live blocks of a process, by address and by stack.
+  struct ProcessHeap {
+    ProcessHeap();
+
+    AllocationMap allocations;
+    StackTotalMap stack_totals;
+    uint64 bytes;
+  };
+  typedef std::map<DWORD, ProcessHeap> ProcessHeapMap;
+  // An allocation, awaiting its stack walk.
+  struct PendingStack {
+    DWORD process_id;
+    sym_util::Address address;
+  };
+  typedef std::map<DWORD, PendingStack> PendingStackMap;
+
+  // @returns true iff an event at @p time is to be applied, noting it as
+  //     the latest if so. Under lock_.
+  bool Apply(const base::Time& time);
+
+  // Track the block of @p size bytes at @p address of @p process_id, as
+  // allocated by @p thread_id. Under lock_.
+  void Allocate(DWORD process_id, DWORD thread_id,
+                sym_util::Address address, uint64 size);
+  // Forget the block at @p address of @p heap.
+  // @returns true iff the block was tracked. Under lock_.
+  bool Release(ProcessHeap* heap, sym_util::Address address);
+
+  // Add @p bytes over @p allocations to the tally of @p stack_id in
+  // @p heap, which may be negative to subtract. Under lock_.
+  static void AddToStack(ProcessHeap* heap, StackId stack_id,
+                         int64 bytes, int64 allocations);
+
+  // @returns the id of the stack @p frames, innermost first, interning it
+  //     as need be. Under lock_.
+  StackId InternStack(size_t num_frames, const sym_util::Address* frames);
+
+  const size_t max_allocations_;
+
+  base::Lock lock_;
+
+  // The call tree, with the root at kEmptyStack. Under lock_.
+  std::vector<StackNode> stack_nodes_;
+  typedef std::map<std::pair<StackId, sym_util::Address>, StackId>
+      StackNodeMap;
+  StackNodeMap stack_node_ids_;
+
+  // The live blocks by process. Under lock_.
+  ProcessHeapMap heaps_;
+  size_t num_allocations_;
+
+  // The allocations by thread. Under lock_.
+  PendingStackMap pending_stacks_;
+
+  // Under lock_.
+  base::Time end_time_;
+  base::Time latest_time_;
+  uint64 num_dropped_allocations_;
+  uint64 num_unknown_frees_;
+
+  DISALLOW_COPY_AND_ASSIGN(HeapProfileService);
+};
+
+#endif  // SAWBUCK_LOG_LIB_HEAP_PROFILE_SERVICE_H_
@@ -0,0 +1,198 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Heap profile service unittests.
+#include "sawbuck/log_lib/heap_profile_service.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const DWORD kPid = 1234;
+const DWORD kOtherPid = 1235;
+const DWORD kTid = 4321;
+const DWORD kOtherTid = 4322;
+
+const sym_util::Address kHeap = 0x00300000;
+const sym_util::Address kBlock1 = 0x00301000;
+const sym_util::Address kBlock2 = 0x00302000;
+const sym_util::Address kBlock3 = 0x00303000;
+
+const sym_util::Address kMain = 0x10001000;
+const sym_util::Address kFoo = 0x10002000;
+const sym_util::Address kBar = 0x10003000;
+
+class HeapProfileServiceTest: public testing::Test {
+ public:
+  HeapProfileServiceTest() : kT0(base::Time::Now()) {
+  }
+
+  // @returns kT0 plus @p ms milliseconds.
+  base::Time At(int ms) {
+    return kT0 + base::TimeDelta::FromMilliseconds(ms);
+  }
+
+  // Issues an allocation of @p size bytes at @p address by @p thread_id
+  // of @p process_id at @p time, with the stack of the @p num_frames
+  // @p frames, innermost first.
+  void Alloc(const base::Time& time, DWORD process_id, DWORD thread_id,
+             sym_util::Address address, uint64 size,
+             size_t num_frames, const sym_util::Address* frames) {
+    service_.OnHeapAlloc(time, process_id, thread_id, kHeap, address, size);
+    service_.OnStackWalk(time, process_id, thread_id, num_frames, frames);
+  }
+
+  // @returns the stack of @p frames in @p stacks, or NULL.
+  const IHeapProfileService::OutstandingStack* FindStack(
+      const std::vector<IHeapProfileService::OutstandingStack>& stacks,
+      size_t num_frames, const sym_util::Address* frames) {
+    std::vector<sym_util::Address> expected(frames, frames + num_frames);
+    std::vector<sym_util::Address> actual;
+    for (size_t i = 0; i < stacks.size(); ++i) {
+      service_.GetStackFrames(stacks[i].stack_id_, &actual);
+      if (actual == expected)
+        return &stacks[i];
+    }
+    return NULL;
+  }
+
+ protected:
+  const base::Time kT0;
+  HeapProfileService service_;
+};
+
+}  // namespace
+
+TEST_F(HeapProfileServiceTest, TalliesLiveBytesByStack) {
+  const sym_util::Address kFooStack[] = { kFoo, kMain };
+  const sym_util::Address kBarStack[] = { kBar, kFoo, kMain };
+  Alloc(At(0), kPid, kTid, kBlock1, 100, arraysize(kFooStack), kFooStack);
+  Alloc(At(1), kPid, kTid, kBlock2, 10, arraysize(kBarStack), kBarStack);
+  Alloc(At(2), kPid, kTid, kBlock3, 20, arraysize(kBarStack), kBarStack);
+
+  // The stacks share their outer frames.
+  EXPECT_EQ(3U, service_.num_stack_nodes());
+
+  std::vector<IHeapProfileService::OutstandingStack> stacks;
+  EXPECT_EQ(130U, service_.GetTopStacks(kPid, 10, &stacks));
+  ASSERT_EQ(2U, stacks.size());
+  EXPECT_EQ(stacks[0].stack_id_,
+            FindStack(stacks, arraysize(kFooStack), kFooStack)->stack_id_);
+  EXPECT_EQ(100U, stacks[0].bytes_);
+  EXPECT_EQ(1U, stacks[0].allocations_);
+  EXPECT_EQ(30U, stacks[1].bytes_);
+  EXPECT_EQ(2U, stacks[1].allocations_);
+
+  // Freeing a block takes it off its stack, and the stack goes once its
+  // last block does.
+  service_.OnHeapFree(At(3), kPid, kTid, kHeap, kBlock1);
+  EXPECT_EQ(30U, service_.GetTopStacks(kPid, 10, &stacks));
+  ASSERT_EQ(1U, stacks.size());
+  EXPECT_TRUE(FindStack(stacks, arraysize(kBarStack), kBarStack) != NULL);
+
+  // The processes are tracked apart.
+  EXPECT_EQ(0U, service_.GetTopStacks(kOtherPid, 10, &stacks));
+  EXPECT_TRUE(stacks.empty());
+  std::vector<DWORD> process_ids;
+  service_.GetProcessIds(&process_ids);
+  ASSERT_EQ(1U, process_ids.size());
+  EXPECT_EQ(kPid, process_ids[0]);
+
+  // A process whose blocks are all freed has nothing to report.
+  Alloc(At(3), kOtherPid, kOtherTid, kBlock1, 5, 0, NULL);
+  service_.OnHeapFree(At(3), kOtherPid, kOtherTid, kHeap, kBlock1);
+  service_.GetProcessIds(&process_ids);
+  EXPECT_EQ(1U, process_ids.size());
+
+  EXPECT_EQ(At(3), service_.latest_time());
+}
+
+TEST_F(HeapProfileServiceTest, ReallocMovesTheBlockToItsStack) {
+  const sym_util::Address kFooStack[] = { kFoo, kMain };
+  const sym_util::Address kBarStack[] = { kBar, kMain };
+  Alloc(At(0), kPid, kTid, kBlock1, 100, arraysize(kFooStack), kFooStack);
+
+  service_.OnHeapRealloc(At(1), kPid, kTid, kHeap, kBlock1, kBlock2, 250);
+  service_.OnStackWalk(At(1), kPid, kTid, arraysize(kBarStack), kBarStack);
+
+  std::vector<IHeapProfileService::OutstandingStack> stacks;
+  EXPECT_EQ(250U, service_.GetTopStacks(kPid, 10, &stacks));
+  ASSERT_EQ(1U, stacks.size());
+  EXPECT_TRUE(FindStack(stacks, arraysize(kBarStack), kBarStack) != NULL);
+
+  // The old block is gone.
+  service_.OnHeapFree(At(2), kPid, kTid, kHeap, kBlock1);
+  EXPECT_EQ(1U, service_.num_unknown_frees());
+  service_.OnHeapFree(At(3), kPid, kTid, kHeap, kBlock2);
+  EXPECT_EQ(0U, service_.GetTopStacks(kPid, 10, &stacks));
+  EXPECT_TRUE(stacks.empty());
+}
+
+TEST_F(HeapProfileServiceTest, MatchesStacksByThread) {
+  const sym_util::Address kFooStack[] = { kFoo, kMain };
+  service_.OnHeapAlloc(At(0), kPid, kTid, kHeap, kBlock1, 100);
+  service_.OnHeapAlloc(At(0), kPid, kOtherTid, kHeap, kBlock2, 10);
+
+  // Until its stack walk comes, a block is under the empty stack.
+  std::vector<IHeapProfileService::OutstandingStack> stacks;
+  EXPECT_EQ(110U, service_.GetTopStacks(kPid, 10, &stacks));
+  ASSERT_EQ(1U, stacks.size());
+  EXPECT_EQ(HeapProfileService::kEmptyStack, stacks[0].stack_id_);
+
+  service_.OnStackWalk(At(1), kPid, kOtherTid,
+                       arraysize(kFooStack), kFooStack);
+  EXPECT_EQ(110U, service_.GetTopStacks(kPid, 10, &stacks));
+  ASSERT_EQ(2U, stacks.size());
+  EXPECT_EQ(HeapProfileService::kEmptyStack, stacks[0].stack_id_);
+  EXPECT_EQ(100U, stacks[0].bytes_);
+  EXPECT_EQ(10U, stacks[1].bytes_);
+  EXPECT_TRUE(FindStack(stacks, arraysize(kFooStack), kFooStack) != NULL);
+
+  // The stack walk of a free isn't taken for a pending allocation's.
+  service_.OnHeapFree(At(2), kPid, kTid, kHeap, kBlock3);
+  service_.OnStackWalk(At(2), kPid, kTid, arraysize(kFooStack), kFooStack);
+  EXPECT_EQ(110U, service_.GetTopStacks(kPid, 1, &stacks));
+  ASSERT_EQ(1U, stacks.size());
+  EXPECT_EQ(HeapProfileService::kEmptyStack, stacks[0].stack_id_);
+}
+
+TEST_F(HeapProfileServiceTest, IgnoresEventsPastTheEndTime) {
+  const sym_util::Address kFooStack[] = { kFoo, kMain };
+  service_.set_end_time(At(1));
+  Alloc(At(0), kPid, kTid, kBlock1, 100, arraysize(kFooStack), kFooStack);
+  Alloc(At(1), kPid, kTid, kBlock2, 10, arraysize(kFooStack), kFooStack);
+  Alloc(At(2), kPid, kTid, kBlock3, 1, arraysize(kFooStack), kFooStack);
+  service_.OnHeapFree(At(2), kPid, kTid, kHeap, kBlock1);
+
+  std::vector<IHeapProfileService::OutstandingStack> stacks;
+  EXPECT_EQ(110U, service_.GetTopStacks(kPid, 10, &stacks));
+  EXPECT_EQ(At(1), service_.latest_time());
+}
+
+TEST_F(HeapProfileServiceTest, CapsTheBlocksTracked) {
+  HeapProfileService service(2);
+  service.OnHeapAlloc(At(0), kPid, kTid, kHeap, kBlock1, 1);
+  service.OnHeapAlloc(At(0), kPid, kTid, kHeap, kBlock2, 2);
+  service.OnHeapAlloc(At(0), kPid, kTid, kHeap, kBlock3, 4);
+  EXPECT_EQ(1U, service.num_dropped_allocations());
+
+  std::vector<IHeapProfileService::OutstandingStack> stacks;
+  EXPECT_EQ(3U, service.GetTopStacks(kPid, 10, &stacks));
+
+  // Freeing a block makes room for another.
+  service.OnHeapFree(At(1), kPid, kTid, kHeap, kBlock1);
+  service.OnHeapAlloc(At(1), kPid, kTid, kHeap, kBlock3, 4);
+  EXPECT_EQ(1U, service.num_dropped_allocations());
+  EXPECT_EQ(6U, service.GetTopStacks(kPid, 10, &stacks));
+}
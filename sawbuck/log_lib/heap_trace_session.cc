@@ -0,0 +1,154 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Heap trace session implementation.
+#include "sawbuck/log_lib/heap_trace_session.h"
+
+#include "base/logging.h"
+#include "base/win/registry.h"
+#include <initguid.h>  // NOLINT - must precede kernel_log_types.
+#include "sawbuck/log_lib/kernel_log_types.h"  // NOLINT - must be last
+
+namespace {
+
+const wchar_t kImageFileExecutionOptionsKey[] =
+    L"Software\\Microsoft\\Windows NT\\CurrentVersion\\"
+    L"Image File Execution Options\\";
+// Setting this to 1 has ntdll log the heap events of the image's processes
+// to the sessions that enable the heap provider.
+const wchar_t kTracingFlagsValue[] = L"TracingFlags";
+
+// The heap events we ask for the stacks of.
+const UCHAR kStackedHeapEvents[] = {
+  kernel_log_types::kHeapAllocEvent,
+  kernel_log_types::kHeapReallocEvent,
+  kernel_log_types::kHeapFreeEvent,
+};
+
+// Asks @p session for the stacks of the heap events. The stack tracing
+// setting is new to Windows 7, so on earlier systems the events come
+// without stacks, and go under the empty stack.
+// @returns true on success.
+bool EnableHeapStackWalks(TRACEHANDLE session) {
+  HMODULE advapi32 = ::GetModuleHandle(L"advapi32.dll");
+  if (!advapi32)
+    return false;
+
+  typedef ULONG (WINAPI* TraceSetInformationProc)(
+      TRACEHANDLE session, TRACE_INFO_CLASS info_class, void* info,
+      ULONG info_length);
+  TraceSetInformationProc trace_set_information =
+      reinterpret_cast<TraceSetInformationProc>(
+          ::GetProcAddress(advapi32, "TraceSetInformation"));
+  if (trace_set_information == NULL)
+    return false;
+
+  CLASSIC_EVENT_ID event_ids[arraysize(kStackedHeapEvents)] = {};
+  for (size_t i = 0; i < arraysize(kStackedHeapEvents); ++i) {
+    event_ids[i].EventGuid = kernel_log_types::kHeapEventClass;
+    event_ids[i].Type = kStackedHeapEvents[i];
+  }
+  ULONG error = trace_set_information(session, TraceStackTracingInfo,
+                                      event_ids, sizeof(event_ids));
+  if (error != ERROR_SUCCESS) {
+    LOG(ERROR) << "Unable to enable heap stack walks, error " << error;
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace
+
+HeapTraceSession::HeapTraceSession() {
+}
+
+HeapTraceSession::~HeapTraceSession() {
+  Stop();
+}
+
+HRESULT HeapTraceSession::AddImageName(const wchar_t* image_name) {
+  DCHECK(image_name != NULL);
+  std::wstring key_name(kImageFileExecutionOptionsKey);
+  key_name += image_name;
+
+  base::win::RegKey key;
+  LONG error = key.Create(HKEY_LOCAL_MACHINE, key_name.c_str(),
+                          KEY_QUERY_VALUE | KEY_SET_VALUE);
+  if (error != ERROR_SUCCESS)
+    return HRESULT_FROM_WIN32(error);
+
+  // Leave alone the images someone else traces the heap of.
+  DWORD flags = 0;
+  if (key.ReadValueDW(kTracingFlagsValue, &flags) == ERROR_SUCCESS &&
+      (flags & 1) != 0) {
+    return S_OK;
+  }
+
+  error = key.WriteValue(kTracingFlagsValue, flags | 1);
+  if (error != ERROR_SUCCESS)
+    return HRESULT_FROM_WIN32(error);
+
+  image_names_.push_back(image_name);
+  return S_OK;
+}
+
+HRESULT HeapTraceSession::Start(const wchar_t* session_name) {
+  DCHECK(session_name != NULL);
+
+  // Use the QPC timer, as for the kernel session the stacks and other
+  // events come from.
+  base::win::EtwTraceProperties props;
+  EVENT_TRACE_PROPERTIES* p = props.get();
+  p->Wnode.ClientContext = 1;
+  p->LogFileMode = EVENT_TRACE_REAL_TIME_MODE;
+  // The heap events come thick and fast, so the buffers are generous.
+  p->BufferSize = 1024;
+  p->MinimumBuffers = 64;
+  p->MaximumBuffers = 256;
+  HRESULT hr = controller_.Start(session_name, &props);
+  if (FAILED(hr))
+    return hr;
+
+  EnableHeapStackWalks(controller_.session());
+  hr = controller_.EnableProvider(kernel_log_types::kHeapEventClass,
+                                  TRACE_LEVEL_VERBOSE, 0xFFFFFFFF);
+  if (FAILED(hr))
+    Stop();
+
+  return hr;
+}
+
+void HeapTraceSession::Stop() {
+  if (controller_.session() != NULL)
+    controller_.Stop(NULL);
+
+  for (size_t i = 0; i < image_names_.size(); ++i) {
+    std::wstring key_name(kImageFileExecutionOptionsKey);
+    key_name += image_names_[i];
+
+    // Clear our flag, but keep any other.
+    base::win::RegKey key(HKEY_LOCAL_MACHINE, key_name.c_str(),
+                          KEY_QUERY_VALUE | KEY_SET_VALUE);
+    DWORD flags = 0;
+    if (key.ReadValueDW(kTracingFlagsValue, &flags) != ERROR_SUCCESS)
+      continue;
+    flags &= ~1;
+    if (flags == 0)
+      key.DeleteValue(kTracingFlagsValue);
+    else
+      key.WriteValue(kTracingFlagsValue, flags);
+  }
+  image_names_.clear();
+}
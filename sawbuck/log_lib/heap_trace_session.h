@@ -0,0 +1,57 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Heap trace session declaration.
+#ifndef SAWBUCK_LOG_LIB_HEAP_TRACE_SESSION_H_
+#define SAWBUCK_LOG_LIB_HEAP_TRACE_SESSION_H_
+
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/win/event_trace_controller.h"
+
+// Captures the heap events of selected processes, with their stacks, to a
+// real time session for a KernelLogParser with a heap event sink to
+// consume. Heap tracing is costly, so it's enabled per image through its
+// Image File Execution Options, and only takes effect for the processes
+// of the image started while the session runs.
+class HeapTraceSession {
+ public:
+  HeapTraceSession();
+  ~HeapTraceSession();
+
+  // Enables heap tracing for the processes of @p image_name, e.g.
+  // L"chrome.exe", until Stop.
+  // @returns S_OK on success, an error code otherwise.
+  HRESULT AddImageName(const wchar_t* image_name);
+
+  // Starts the real time session @p session_name, logging the heap events
+  // with their stacks.
+  // @returns S_OK on success, an error code otherwise.
+  HRESULT Start(const wchar_t* session_name);
+
+  // Stops the session, and disables heap tracing for the images we enabled
+  // it for.
+  void Stop();
+
+ private:
+  base::win::EtwTraceController controller_;
+
+  // The images we enabled heap tracing for, which didn't have it before.
+  std::vector<std::wstring> image_names_;
+
+  DISALLOW_COPY_AND_ASSIGN(HeapTraceSession);
+};
+
+#endif  // SAWBUCK_LOG_LIB_HEAP_TRACE_SESSION_H_
@@ -0,0 +1,75 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Kernel capture profile implementation.
+#include "sawbuck/log_lib/kernel_capture_profile.h"
+
+#include "base/basictypes.h"
+#include "base/logging.h"
+
+namespace kernel_capture_profile {
+
+namespace {
+
+// The flags of every profile.
+const ULONG kBaseFlags = EVENT_TRACE_FLAG_PROCESS | EVENT_TRACE_FLAG_IMAGE_LOAD;
+
+struct ProfileInfo {
+  const char* name;
+  ULONG flags;
+};
+
+// In the order of Profile.
+const ProfileInfo kProfiles[] = {
+  { "minimal", kBaseFlags },
+  { "startup_io",
+    kBaseFlags | EVENT_TRACE_FLAG_THREAD | EVENT_TRACE_FLAG_DISK_IO |
+        EVENT_TRACE_FLAG_DISK_FILE_IO | EVENT_TRACE_FLAG_MEMORY_HARD_FAULTS },
+  { "cpu",
+    kBaseFlags | EVENT_TRACE_FLAG_THREAD | EVENT_TRACE_FLAG_CSWITCH |
+        EVENT_TRACE_FLAG_DISPATCHER | EVENT_TRACE_FLAG_PROFILE },
+  { "memory",
+    kBaseFlags | EVENT_TRACE_FLAG_THREAD |
+        EVENT_TRACE_FLAG_MEMORY_PAGE_FAULTS |
+        EVENT_TRACE_FLAG_MEMORY_HARD_FAULTS },
+};
+COMPILE_ASSERT(arraysize(kProfiles) == NUM_PROFILES,
+               profile_table_must_cover_the_profiles);
+
+}  // namespace
+
+ULONG GetEnableFlags(Profile profile) {
+  DCHECK_LE(0, profile);
+  DCHECK_LT(profile, NUM_PROFILES);
+  return kProfiles[profile].flags;
+}
+
+const char* GetName(Profile profile) {
+  DCHECK_LE(0, profile);
+  DCHECK_LT(profile, NUM_PROFILES);
+  return kProfiles[profile].name;
+}
+
+bool FindProfile(const std::string& name, Profile* profile) {
+  DCHECK(profile != NULL);
+  for (int i = 0; i < NUM_PROFILES; ++i) {
+    if (name == kProfiles[i].name) {
+      *profile = static_cast<Profile>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace kernel_capture_profile
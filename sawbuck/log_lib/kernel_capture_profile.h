@@ -0,0 +1,56 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Kernel capture profile declaration.
+#ifndef SAWBUCK_LOG_LIB_KERNEL_CAPTURE_PROFILE_H_
+#define SAWBUCK_LOG_LIB_KERNEL_CAPTURE_PROFILE_H_
+
+#include <windows.h>
+#include <evntrace.h>
+#include <string>
+
+// Named sets of kernel flags, so that a capture turns on the kernel events
+// an investigation needs and no more, as the heavier ones cost the traced
+// machine dearly. Every profile has the process and image load events,
+// which name the processes and modules of the logs' stack traces.
+namespace kernel_capture_profile {
+
+enum Profile {
+  // Processes and image loads only.
+  MINIMAL,
+  // Adds threads, disk and file I/O and hard faults, for slow startups.
+  STARTUP_IO,
+  // Adds threads, context switches, ready threads and profile samples.
+  CPU,
+  // Adds threads and page faults, hard and soft.
+  MEMORY,
+
+  // Must be last.
+  NUM_PROFILES
+};
+
+// @returns the kernel enable flags of @p profile.
+ULONG GetEnableFlags(Profile profile);
+
+// @returns the name of @p profile, as configurations and preferences give
+//     it, e.g. "startup_io".
+const char* GetName(Profile profile);
+
+// Looks up the profile named @p name to @p profile.
+// @returns true iff there's one, false otherwise.
+bool FindProfile(const std::string& name, Profile* profile);
+
+}  // namespace kernel_capture_profile
+
+#endif  // SAWBUCK_LOG_LIB_KERNEL_CAPTURE_PROFILE_H_
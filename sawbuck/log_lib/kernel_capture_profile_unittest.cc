@@ -0,0 +1,52 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Kernel capture profile unit tests.
+#include "sawbuck/log_lib/kernel_capture_profile.h"
+
+#include "gtest/gtest.h"
+
+namespace kernel_capture_profile {
+
+TEST(KernelCaptureProfileTest, NamesRoundTrip) {
+  for (int i = 0; i < NUM_PROFILES; ++i) {
+    Profile profile = static_cast<Profile>(i);
+    Profile found = NUM_PROFILES;
+    ASSERT_TRUE(FindProfile(GetName(profile), &found));
+    EXPECT_EQ(profile, found);
+  }
+
+  Profile found = MINIMAL;
+  EXPECT_FALSE(FindProfile("everything", &found));
+  EXPECT_FALSE(FindProfile("", &found));
+  EXPECT_EQ(MINIMAL, found);
+}
+
+TEST(KernelCaptureProfileTest, Flags) {
+  // Every profile names the processes and modules of the stacks.
+  const ULONG kBase = EVENT_TRACE_FLAG_PROCESS | EVENT_TRACE_FLAG_IMAGE_LOAD;
+  for (int i = 0; i < NUM_PROFILES; ++i)
+    EXPECT_EQ(kBase, GetEnableFlags(static_cast<Profile>(i)) & kBase);
+
+  EXPECT_EQ(kBase, GetEnableFlags(MINIMAL));
+  EXPECT_NE(0U, GetEnableFlags(STARTUP_IO) & EVENT_TRACE_FLAG_DISK_FILE_IO);
+  EXPECT_EQ(0U, GetEnableFlags(STARTUP_IO) & EVENT_TRACE_FLAG_CSWITCH);
+  EXPECT_NE(0U, GetEnableFlags(CPU) & EVENT_TRACE_FLAG_PROFILE);
+  EXPECT_NE(0U, GetEnableFlags(CPU) & EVENT_TRACE_FLAG_CSWITCH);
+  EXPECT_NE(0U,
+            GetEnableFlags(MEMORY) & EVENT_TRACE_FLAG_MEMORY_PAGE_FAULTS);
+  EXPECT_EQ(0U, GetEnableFlags(MEMORY) & EVENT_TRACE_FLAG_PROFILE);
+}
+
+}  // namespace kernel_capture_profile
@@ -15,8 +15,11 @@
 // Kernel log consumer implementation.
 #include "sawbuck/log_lib/kernel_log_consumer.h"
 
+#include <algorithm>
+#include "base/bind.h"
 #include "base/logging.h"
 #include "sawbuck/common/buffer_parser.h"
+#include "sawbuck/log_lib/event_router.h"
 #include <initguid.h>  // NOLINT - must precede kernel_log_types.
 #include "sawbuck/log_lib/kernel_log_types.h"  // NOLINT - must be last
 
@@ -24,6 +27,13 @@ namespace {
 
 using namespace kernel_log_types;
 
+// The clock types, as per LogFileHeader32::ReservedFlags.
+enum ClockType {
+  kClockTypePerfCounter = 1,
+  kClockTypeSystemTime = 2,
+  kClockTypeCpuCycle = 3,
+};
+
 // The functions named ConvertModuleInformationFromLogEvent below all serve
 // the purpose of parsing a particular version and bitness of an NT Kernel
 // Logger module information event to the common ModuleInformation format.
@@ -226,339 +236,811 @@ bool KernelProcessEvents::ProcessInfo::operator == (
 
 KernelLogParser::KernelLogParser() : module_event_sink_(NULL),
     page_fault_event_sink_(NULL), process_event_sink_(NULL),
-    infer_bitness_from_log_(true),
-    is_64_bit_log_(false) {
+    memory_event_sink_(NULL), thread_event_sink_(NULL),
+    scheduler_event_sink_(NULL), disk_io_event_sink_(NULL),
+    profile_event_sink_(NULL), heap_event_sink_(NULL),
+    registry_event_sink_(NULL),
+    infer_bitness_from_log_(true), is_64_bit_log_(false), perf_frequency_(0),
+    event_clock_(NULL), has_log_clock_(false) {
+  // To decode a new event class, add its structs and decoders here.
+  AddImageLoadDecoders<ImageLoad32V0>(0, false);
+  AddImageLoadDecoders<ImageLoad32V1>(1, false);
+  AddImageLoadDecoders<ImageLoad32V2>(2, false);
+  AddImageLoadDecoders<ImageLoad64V0>(0, true);
+  AddImageLoadDecoders<ImageLoad64V1>(1, true);
+  AddImageLoadDecoders<ImageLoad64V2>(2, true);
+
+  AddPageFaultDecoders<PageFault32V2, HardPageFault32V2>(2, false);
+  AddPageFaultDecoders<PageFault64V2, HardPageFault64V2>(2, true);
+
+  // TODO(siggi): Version 0 and 64 bit version 1 process events.
+  AddProcessDecoders<ProcessInfo32V1>(1, false);
+  AddProcessDecoders<ProcessInfo32V2>(2, false);
+  AddProcessDecoders<ProcessInfo32V3>(3, false);
+  AddProcessDecoders<ProcessInfo64V2>(2, true);
+  AddProcessDecoders<ProcessInfo64V3>(3, true);
+
+  AddProcessCountersDecoders<ProcessPerfCtr32V2>(2, false);
+  AddProcessCountersDecoders<ProcessPerfCtr64V2>(2, true);
+
+  for (UCHAR version = 1; version <= 3; ++version) {
+    AddThreadDecoders<ThreadInfoPrefix>(version, false);
+    AddThreadDecoders<ThreadInfoPrefix>(version, true);
+  }
+
+  for (int is_64_bit = 0; is_64_bit < 2; ++is_64_bit) {
+    AddEventDecoder(kThreadEventClass, kContextSwitchEvent, 2,
+        is_64_bit != 0, &KernelLogParser::DecodeContextSwitchEvent);
+    AddEventDecoder(kThreadEventClass, kReadyThreadEvent, 2,
+        is_64_bit != 0, &KernelLogParser::DecodeReadyThreadEvent);
+  }
+
+  AddDiskIoDecoders<DiskIo32V2, FileIoName32>(2, false);
+  AddDiskIoDecoders<DiskIo32V2, FileIoName32>(3, false);
+  AddDiskIoDecoders<DiskIo64V2, FileIoName64>(2, true);
+  AddDiskIoDecoders<DiskIo64V2, FileIoName64>(3, true);
+
+  AddProfileDecoders<SampledProfile32V2, ULONG>(2, false);
+  AddProfileDecoders<SampledProfile64V2, ULONGLONG>(2, true);
+
+  AddHeapDecoders<HeapAlloc32V2, HeapRealloc32V2, HeapFree32V2>(2, false);
+  AddHeapDecoders<HeapAlloc64V2, HeapRealloc64V2, HeapFree64V2>(2, true);
+
+  AddRegistryDecoders<Registry32V2>(2, false);
+  AddRegistryDecoders<Registry64V2>(2, true);
+
+  std::sort(event_decoders_.begin(), event_decoders_.end());
 }
 
 KernelLogParser::~KernelLogParser() {
 }
 
-bool KernelLogParser::ProcessImageLoadEvent(EVENT_TRACE* event) {
+base::Time KernelLogParser::watermark() {
+  base::AutoLock lock(watermark_lock_);
+  return watermark_;
+}
+
+void KernelLogParser::AddEventClasses(EventRouter* router) {
+  DCHECK(router != NULL);
+  EventRouter::EventParser parser(
+      base::Bind(&KernelLogParser::ProcessOneEvent, base::Unretained(this)));
+  router->AddEventClass(kEventTraceEventClass, parser);
+
+  // The decoders are sorted by class first, so each class is a run.
+  for (size_t i = 0; i < event_decoders_.size(); ++i) {
+    const GUID& event_class = event_decoders_[i].key.event_class;
+    if (i == 0 || event_class != event_decoders_[i - 1].key.event_class)
+      router->AddEventClass(event_class, parser);
+  }
+}
+
+bool KernelLogParser::EventKey::operator<(const EventKey& o) const {
+  int diff = memcmp(&event_class, &o.event_class, sizeof(event_class));
+  if (diff != 0)
+    return diff < 0;
+  if (type != o.type)
+    return type < o.type;
+  if (version != o.version)
+    return version < o.version;
+  return is_64_bit < o.is_64_bit;
+}
+
+void KernelLogParser::AddEventDecoder(const GUID& event_class,
+                                      UCHAR type,
+                                      UCHAR version,
+                                      bool is_64_bit,
+                                      EventDecoder decoder) {
+  EventDecoderEntry entry = { { event_class, type, version, is_64_bit },
+                               decoder };
+  event_decoders_.push_back(entry);
+}
+
+template <class ImageLoadType>
+void KernelLogParser::AddImageLoadDecoders(UCHAR version, bool is_64_bit) {
+  AddEventDecoder(kImageLoadEventClass, kImageNotifyUnloadEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeImageLoadEvent<ImageLoadType,
+          &KernelModuleEvents::OnModuleUnload>);
+  AddEventDecoder(kImageLoadEventClass, kImageNotifyIsLoadedEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeImageLoadEvent<ImageLoadType,
+          &KernelModuleEvents::OnModuleIsLoaded>);
+  AddEventDecoder(kImageLoadEventClass, kImageNotifyLoadEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeImageLoadEvent<ImageLoadType,
+          &KernelModuleEvents::OnModuleLoad>);
+}
+
+template <class PageFaultType, class HardPageFaultType>
+void KernelLogParser::AddPageFaultDecoders(UCHAR version, bool is_64_bit) {
+  AddEventDecoder(kPageFaultEventClass, kTransitionFaultEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodePageFaultEvent<PageFaultType,
+          &KernelPageFaultEvents::OnTransitionFault>);
+  AddEventDecoder(kPageFaultEventClass, kDemandZeroFaultEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodePageFaultEvent<PageFaultType,
+          &KernelPageFaultEvents::OnDemandZeroFault>);
+  AddEventDecoder(kPageFaultEventClass, kCopyOnWriteEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodePageFaultEvent<PageFaultType,
+          &KernelPageFaultEvents::OnCopyOnWriteFault>);
+  AddEventDecoder(kPageFaultEventClass, kGuardPageFaultEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodePageFaultEvent<PageFaultType,
+          &KernelPageFaultEvents::OnGuardPageFault>);
+  AddEventDecoder(kPageFaultEventClass, kHardEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodePageFaultEvent<PageFaultType,
+          &KernelPageFaultEvents::OnHardFault>);
+  AddEventDecoder(kPageFaultEventClass, kAccessViolationEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodePageFaultEvent<PageFaultType,
+          &KernelPageFaultEvents::OnAccessViolationFault>);
+  AddEventDecoder(kPageFaultEventClass, kHardPageFaultEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeHardPageFaultEvent<HardPageFaultType>);
+}
+
+template <class ProcessInfoType>
+void KernelLogParser::AddProcessDecoders(UCHAR version, bool is_64_bit) {
+  AddEventDecoder(kProcessEventClass, kProcessIsRunningEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeProcessEvent<ProcessInfoType>);
+  AddEventDecoder(kProcessEventClass, kProcessStartEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeProcessEvent<ProcessInfoType>);
+  AddEventDecoder(kProcessEventClass, kProcessEndEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeProcessEvent<ProcessInfoType>);
+}
+
+template <class ProcessCountersType>
+void KernelLogParser::AddProcessCountersDecoders(UCHAR version,
+                                                 bool is_64_bit) {
+  AddEventDecoder(kProcessEventClass, kProcessPerfCtrEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeProcessCountersEvent<ProcessCountersType>);
+  AddEventDecoder(kProcessEventClass, kProcessPerfCtrRundownEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeProcessCountersEvent<ProcessCountersType>);
+}
+
+template <class ThreadInfoType>
+void KernelLogParser::AddThreadDecoders(UCHAR version, bool is_64_bit) {
+  AddEventDecoder(kThreadEventClass, kThreadIsRunningEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeThreadEvent<ThreadInfoType>);
+  AddEventDecoder(kThreadEventClass, kThreadStartEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeThreadEvent<ThreadInfoType>);
+  AddEventDecoder(kThreadEventClass, kThreadEndEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeThreadEvent<ThreadInfoType>);
+}
+
+template <class DiskIoType, class FileIoNameType>
+void KernelLogParser::AddDiskIoDecoders(UCHAR version, bool is_64_bit) {
+  AddEventDecoder(kDiskIoEventClass, kDiskIoReadEvent, version, is_64_bit,
+      &KernelLogParser::DecodeDiskIoEvent<DiskIoType>);
+  AddEventDecoder(kDiskIoEventClass, kDiskIoWriteEvent, version, is_64_bit,
+      &KernelLogParser::DecodeDiskIoEvent<DiskIoType>);
+
+  AddEventDecoder(kFileIoEventClass, kFileIoNameEvent, version, is_64_bit,
+      &KernelLogParser::DecodeFileNameEvent<FileIoNameType>);
+  AddEventDecoder(kFileIoEventClass, kFileIoFileCreateEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeFileNameEvent<FileIoNameType>);
+  AddEventDecoder(kFileIoEventClass, kFileIoFileRundownEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeFileNameEvent<FileIoNameType>);
+  AddEventDecoder(kFileIoEventClass, kFileIoFileDeleteEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeFileDeletedEvent<FileIoNameType>);
+}
+
+template <class SampledProfileType, class FrameType>
+void KernelLogParser::AddProfileDecoders(UCHAR version, bool is_64_bit) {
+  AddEventDecoder(kPerfInfoEventClass, kSampledProfileEvent, version,
+      is_64_bit,
+      &KernelLogParser::DecodeSampledProfileEvent<SampledProfileType>);
+  AddEventDecoder(kStackWalkEventClass, kStackWalkEvent, version, is_64_bit,
+      &KernelLogParser::DecodeStackWalkEvent<FrameType>);
+}
+
+template <class HeapAllocType, class HeapReallocType, class HeapFreeType>
+void KernelLogParser::AddHeapDecoders(UCHAR version, bool is_64_bit) {
+  AddEventDecoder(kHeapEventClass, kHeapAllocEvent, version, is_64_bit,
+      &KernelLogParser::DecodeHeapAllocEvent<HeapAllocType>);
+  AddEventDecoder(kHeapEventClass, kHeapReallocEvent, version, is_64_bit,
+      &KernelLogParser::DecodeHeapReallocEvent<HeapReallocType>);
+  AddEventDecoder(kHeapEventClass, kHeapFreeEvent, version, is_64_bit,
+      &KernelLogParser::DecodeHeapFreeEvent<HeapFreeType>);
+}
+
+template <class RegistryType>
+void KernelLogParser::AddRegistryDecoders(UCHAR version, bool is_64_bit) {
+  static const UCHAR kAccessEvents[] = {
+    kRegistryCreateEvent, kRegistryOpenEvent, kRegistryDeleteEvent,
+    kRegistryQueryEvent, kRegistrySetValueEvent, kRegistryDeleteValueEvent,
+    kRegistryQueryValueEvent, kRegistryEnumerateKeyEvent,
+    kRegistryEnumerateValueKeyEvent, kRegistryQueryMultipleValueEvent,
+    kRegistrySetInformationEvent, kRegistryFlushEvent,
+    kRegistryVirtualizeEvent, kRegistryCloseEvent, kRegistrySetSecurityEvent,
+    kRegistryQuerySecurityEvent,
+  };
+  for (size_t i = 0; i < arraysize(kAccessEvents); ++i) {
+    AddEventDecoder(kRegistryEventClass, kAccessEvents[i], version,
+        is_64_bit, &KernelLogParser::DecodeRegistryEvent<RegistryType>);
+  }
+
+  AddEventDecoder(kRegistryEventClass, kRegistryKcbCreateEvent, version,
+      is_64_bit, &KernelLogParser::DecodeRegistryKeyNameEvent<RegistryType>);
+  AddEventDecoder(kRegistryEventClass, kRegistryKcbRundownBeginEvent,
+      version, is_64_bit,
+      &KernelLogParser::DecodeRegistryKeyNameEvent<RegistryType>);
+  AddEventDecoder(kRegistryEventClass, kRegistryKcbDeleteEvent, version,
+      is_64_bit,
+      &KernelLogParser::DecodeRegistryKeyDeletedEvent<RegistryType>);
+}
+
+template <class ImageLoadType, KernelLogParser::ModuleEventHandler handler>
+bool KernelLogParser::DecodeImageLoadEvent(EVENT_TRACE* event) {
   DCHECK(event && event->Header.Guid == kImageLoadEventClass);
 
   if (module_event_sink_ == NULL)
     return false;
 
+  // Not all event versions carry all the fields.
+  module_info_.image_checksum = 0;
+  module_info_.time_date_stamp = 0;
+
+  DWORD process_id = 0;
+  const ImageLoadType* data =
+      reinterpret_cast<const ImageLoadType*>(event->MofData);
+  if (!ConvertModuleInformationFromLogEvent(data, event->MofLength,
+                                            &process_id, &module_info_)) {
+    return false;
+  }
+
+  if (process_id == 0)
+    process_id = event->Header.ProcessId;
+
   base::Time time(base::Time::FromFileTime(
       reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
-  KernelModuleEvents::ModuleInformation info = {};
-  DWORD process_id = 0;
+  (module_event_sink_->*handler)(process_id, time, module_info_);
+  return true;
+}
 
-#define EVENT_HANDLER(type, version, event_type, handler) \
-  if (event->Header.Class.Type == type && \
-      event->Header.Class.Version == version) { \
-    event_type* data = reinterpret_cast<event_type*>(event->MofData); \
-    if (ConvertModuleInformationFromLogEvent(data, \
-                                             event->MofLength, \
-                                             &process_id, \
-                                             &info)) { \
-      if (process_id == 0) \
-        process_id = event->Header.ProcessId; \
-      module_event_sink_->handler(process_id, time, info); \
-      return true; \
-    } \
-  }
-
-  if (is_64_bit_log_) {
-    EVENT_HANDLER(kImageNotifyUnloadEvent, 0, ImageLoad64V0, OnModuleUnload)
-    EVENT_HANDLER(kImageNotifyIsLoadedEvent, 0, ImageLoad64V0,
-        OnModuleIsLoaded)
-    EVENT_HANDLER(kImageNotifyLoadEvent, 0, ImageLoad64V0, OnModuleLoad);
-    EVENT_HANDLER(kImageNotifyUnloadEvent, 1, ImageLoad64V1, OnModuleUnload)
-    EVENT_HANDLER(kImageNotifyIsLoadedEvent, 1, ImageLoad64V1,
-        OnModuleIsLoaded)
-    EVENT_HANDLER(kImageNotifyLoadEvent, 1, ImageLoad64V1, OnModuleLoad);
-    EVENT_HANDLER(kImageNotifyUnloadEvent, 2, ImageLoad64V2, OnModuleUnload)
-    EVENT_HANDLER(kImageNotifyIsLoadedEvent, 2, ImageLoad64V2,
-        OnModuleIsLoaded)
-    EVENT_HANDLER(kImageNotifyLoadEvent, 2, ImageLoad64V2, OnModuleLoad);
-  } else {
-    EVENT_HANDLER(kImageNotifyUnloadEvent, 0, ImageLoad32V0, OnModuleUnload)
-    EVENT_HANDLER(kImageNotifyIsLoadedEvent, 0, ImageLoad32V0,
-        OnModuleIsLoaded)
-    EVENT_HANDLER(kImageNotifyLoadEvent, 0, ImageLoad32V0, OnModuleLoad);
-    EVENT_HANDLER(kImageNotifyUnloadEvent, 1, ImageLoad32V1, OnModuleUnload)
-    EVENT_HANDLER(kImageNotifyIsLoadedEvent, 1, ImageLoad32V1,
-        OnModuleIsLoaded)
-    EVENT_HANDLER(kImageNotifyLoadEvent, 1, ImageLoad32V1, OnModuleLoad);
-    EVENT_HANDLER(kImageNotifyUnloadEvent, 2, ImageLoad32V2, OnModuleUnload)
-    EVENT_HANDLER(kImageNotifyIsLoadedEvent, 2, ImageLoad32V2,
-        OnModuleIsLoaded)
-    EVENT_HANDLER(kImageNotifyLoadEvent, 2, ImageLoad32V2, OnModuleLoad);
-  }
-
-#undef EVENT_HANDLER
-
-  return false;
-}
-
-bool KernelLogParser::ProcessPageFaultEvent(EVENT_TRACE* event) {
+template <class PageFaultType, KernelLogParser::PageFaultEventHandler handler>
+bool KernelLogParser::DecodePageFaultEvent(EVENT_TRACE* event) {
   DCHECK(event && event->Header.Guid == kPageFaultEventClass);
 
   if (page_fault_event_sink_ == NULL)
     return false;
 
-  if (event->Header.Class.Version != 2)
+  BinaryBufferReader reader(event->MofData, event->MofLength);
+  const PageFaultType* data = NULL;
+  if (!reader.Read(&data)) {
+    LOG(ERROR) << "Short page fault event";
     return false;
+  }
 
   base::Time time(base::Time::FromFileTime(
       reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
-  DWORD process_id = event->Header.ProcessId;
-  DWORD thread_id = event->Header.ThreadId;
+  (page_fault_event_sink_->*handler)(event->Header.ProcessId,
+                                     event->Header.ThreadId,
+                                     time,
+                                     data->VirtualAddress,
+                                     data->ProgramCounter);
+  return true;
+}
+
+template <class HardPageFaultType>
+bool KernelLogParser::DecodeHardPageFaultEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kPageFaultEventClass);
+
+  if (page_fault_event_sink_ == NULL)
+    return false;
 
   BinaryBufferReader reader(event->MofData, event->MofLength);
-  if (event->Header.Class.Type == kHardPageFaultEvent) {
-    if (is_64_bit_log()) {
-      const HardPageFault64V2* data = NULL;
-      if (!reader.Read(&data)) {
-        LOG(ERROR) << "Short hard fault event";
-        return false;
-      }
+  const HardPageFaultType* data = NULL;
+  if (!reader.Read(&data)) {
+    LOG(ERROR) << "Short hard fault event";
+    return false;
+  }
 
-      // TODO(siggi): Is this right?
-      base::Time initial_time(base::Time::FromFileTime(
-          reinterpret_cast<const FILETIME&>(data->InitialTime)));
-
-      page_fault_event_sink_->OnHardPageFault(
-          data->ThreadId, time, initial_time, data->ReadOffset,
-          data->VirtualAddress, data->FileObject, data->ByteCount);
-    } else {
-      const HardPageFault32V2* data = NULL;
-      if (!reader.Read(&data)) {
-        LOG(ERROR) << "Short hard fault event";
-        return false;
-      }
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  // TODO(siggi): Is this right?
+  base::Time initial_time(base::Time::FromFileTime(
+      reinterpret_cast<const FILETIME&>(data->InitialTime)));
 
-      // TODO(siggi): Is this right?
-      base::Time initial_time(base::Time::FromFileTime(
-          reinterpret_cast<const FILETIME&>(data->InitialTime)));
+  page_fault_event_sink_->OnHardPageFault(
+      data->ThreadId, time, initial_time, data->ReadOffset,
+      data->VirtualAddress, data->FileObject, data->ByteCount);
+  return true;
+}
 
-      page_fault_event_sink_->OnHardPageFault(
-          data->ThreadId, time, initial_time, data->ReadOffset,
-          data->VirtualAddress, data->FileObject, data->ByteCount);
-    }
-    return true;
-  } else {
-    // Check the event type.
-    switch (event->Header.Class.Type) {
-      case kTransitionFaultEvent:
-      case kDemandZeroFaultEvent:
-      case kCopyOnWriteEvent:
-      case kGuardPageFaultEvent:
-      case kHardEvent:
-      case kAccessViolationEvent:
-        break;
-
-      default:
-        LOG(ERROR) << "Unknown page fault event type: "
-            << static_cast<int>(event->Header.Class.Type);
-        return false;
-    }
+template <class ProcessInfoType>
+bool KernelLogParser::DecodeProcessEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kProcessEventClass);
 
-    // Read the data with the right bitness.
-    sym_util::Address virtual_address = 0;
-    sym_util::Address program_counter = 0;
-    if (is_64_bit_log()) {
-      const PageFault64V2* data = NULL;
-      if (!reader.Read(&data)) {
-        LOG(ERROR) << "Short page fault event";
-        return false;
-      }
+  if (process_event_sink_ == NULL)
+    return false;
 
-      virtual_address = data->VirtualAddress;
-      program_counter = data->ProgramCounter;
-    } else {
-      const PageFault32V2* data = NULL;
-      if (!reader.Read(&data)) {
-        LOG(ERROR) << "Short page fault event";
-        return false;
-      }
+  KernelProcessEvents::ProcessInfo& process_info = process_info_;
+  ULONG exit_status = 0;
+  if (!ParseProcessEvent<ProcessInfoType>(event->MofData,
+                                          event->MofLength,
+                                          &process_info,
+                                          &exit_status)) {
+    return false;
+  }
 
-      virtual_address = data->VirtualAddress;
-      program_counter = data->ProgramCounter;
-    }
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  switch (event->Header.Class.Type) {
+    case kProcessIsRunningEvent:
+      process_event_sink_->OnProcessIsRunning(time, process_info);
+      break;
 
-    // And dispatch the callback.
-    switch (event->Header.Class.Type) {
-      case kTransitionFaultEvent:
-        page_fault_event_sink_->OnTransitionFault(process_id,
-                                                  thread_id,
-                                                  time,
-                                                  virtual_address,
-                                                  program_counter);
-        break;
-
-      case kDemandZeroFaultEvent:
-        page_fault_event_sink_->OnDemandZeroFault(process_id,
-                                                  thread_id,
-                                                  time,
-                                                  virtual_address,
-                                                  program_counter);
-        break;
-
-      case kCopyOnWriteEvent:
-        page_fault_event_sink_->OnCopyOnWriteFault(process_id,
-                                                   thread_id,
-                                                   time,
-                                                   virtual_address,
-                                                   program_counter);
-        break;
-
-      case kGuardPageFaultEvent:
-        page_fault_event_sink_->OnGuardPageFault(process_id,
-                                                 thread_id,
-                                                 time,
-                                                 virtual_address,
-                                                 program_counter);
-        break;
-
-      case kHardEvent:
-        page_fault_event_sink_->OnHardFault(process_id,
-                                            thread_id,
-                                            time,
-                                            virtual_address,
-                                            program_counter);
-        break;
-
-      case kAccessViolationEvent:
-        page_fault_event_sink_->OnAccessViolationFault(process_id,
-                                                       thread_id,
-                                                       time,
-                                                       virtual_address,
-                                                       program_counter);
-        break;
-
-      default:
-        NOTREACHED() << "Impossible page fault type";
-        break;
-    }
+    case kProcessStartEvent:
+      process_event_sink_->OnProcessStarted(time, process_info);
+      break;
 
-    return true;
+    case kProcessEndEvent:
+      process_event_sink_->OnProcessEnded(time, process_info, exit_status);
+      break;
+
+    default:
+      NOTREACHED() << "Impossible process event type";
+      break;
   }
 
-  return false;
+  return true;
 }
 
-bool KernelLogParser::ProcessProcessEvent(EVENT_TRACE* event) {
+template <class ProcessCountersType>
+bool KernelLogParser::DecodeProcessCountersEvent(EVENT_TRACE* event) {
   DCHECK(event && event->Header.Guid == kProcessEventClass);
 
+  if (memory_event_sink_ == NULL)
+    return false;
+
+  BinaryBufferReader reader(event->MofData, event->MofLength);
+  const ProcessCountersType* data = NULL;
+  if (!reader.Read(&data)) {
+    LOG(ERROR) << "Short process counters event";
+    return false;
+  }
+
+  KernelMemoryEvents::ProcessCounters counters = {
+      data->ProcessId,
+      data->PageFaultCount,
+      data->HandleCount,
+      data->WorkingSetSize,
+      data->PeakWorkingSetSize,
+      data->PagefileUsage,
+      data->PeakPagefileUsage,
+      data->VirtualSize,
+      data->PrivatePageCount,
+    };
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  memory_event_sink_->OnProcessCounters(time, counters);
+  return true;
+}
+
+template <class ThreadInfoType>
+bool KernelLogParser::DecodeThreadEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kThreadEventClass);
+
+  if (thread_event_sink_ == NULL)
+    return false;
+
+  BinaryBufferReader reader(event->MofData, event->MofLength);
+  const ThreadInfoType* data = NULL;
+  if (!reader.Read(&data)) {
+    LOG(ERROR) << "Short thread event";
+    return false;
+  }
+
+  KernelThreadEvents::ThreadInfo thread_info = {
+      data->ProcessId,
+      data->ThreadId,
+    };
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
   switch (event->Header.Class.Type) {
-      case kProcessIsRunningEvent:
-      case kProcessStartEvent:
-      case kProcessEndEvent:
-        // Add other known event types here.
-        break;
+    case kThreadIsRunningEvent:
+      thread_event_sink_->OnThreadIsRunning(time, thread_info);
+      break;
+
+    case kThreadStartEvent:
+      thread_event_sink_->OnThreadStarted(time, thread_info);
+      break;
+
+    case kThreadEndEvent:
+      thread_event_sink_->OnThreadEnded(time, thread_info);
+      break;
 
     default:
-      // Unknown event type.
-      return false;
+      NOTREACHED() << "Impossible thread event type";
+      break;
   }
 
-  if (process_event_sink_ == NULL)
+  return true;
+}
+
+bool KernelLogParser::DecodeContextSwitchEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kThreadEventClass);
+
+  if (scheduler_event_sink_ == NULL)
+    return false;
+
+  BinaryBufferReader reader(event->MofData, event->MofLength);
+  const ContextSwitchV2* data = NULL;
+  if (!reader.Read(&data)) {
+    LOG(ERROR) << "Short context switch event";
     return false;
+  }
 
-  KernelProcessEvents::ProcessInfo process_info;
   base::Time time(base::Time::FromFileTime(
       reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
-  bool has_info = false;
-  ULONG exit_status = 0;
+  scheduler_event_sink_->OnContextSwitch(time,
+                                         event->BufferContext.ProcessorNumber,
+                                         data->OldThreadId,
+                                         data->NewThreadId,
+                                         data->OldThreadState);
+  return true;
+}
 
-  if (is_64_bit_log_) {
-    switch (event->Header.Class.Version) {
-      case 0:
-        NOTREACHED();  // TODO(siggi): writeme.
-        break;
-      case 1:
-        NOTREACHED();  // TODO(siggi): writeme.
-        break;
-      case 2: {
-          has_info =
-              ParseProcessEvent<ProcessInfo64V2>(event->MofData,
-                                                 event->MofLength,
-                                                 &process_info,
-                                                 &exit_status);
-        }
-        break;
-      case 3: {
-          has_info =
-              ParseProcessEvent<ProcessInfo64V3>(event->MofData,
-                                                 event->MofLength,
-                                                 &process_info,
-                                                 &exit_status);
-        }
-        break;
-
-      default:
-        LOG(ERROR) << "Unexpected process info version "
-            << event->Header.Class.Version;
-        break;
-    }
-  } else {
-    switch (event->Header.Class.Version) {
-      case 0:
-        NOTREACHED();  // TODO(siggi): writeme.
-        break;
-      case 1: {
-          has_info =
-              ParseProcessEvent<ProcessInfo32V1>(event->MofData,
-                                                 event->MofLength,
-                                                 &process_info,
-                                                 &exit_status);
-        }
-        break;
-      case 2: {
-          has_info =
-              ParseProcessEvent<ProcessInfo32V2>(event->MofData,
-                                                 event->MofLength,
-                                                 &process_info,
-                                                 &exit_status);
-        }
-        break;
-      case 3: {
-          has_info =
-              ParseProcessEvent<ProcessInfo32V3>(event->MofData,
-                                                 event->MofLength,
-                                                 &process_info,
-                                                 &exit_status);
-        }
-        break;
-
-      default:
-        LOG(ERROR) << "Unexpected process info version "
-            << event->Header.Class.Version;
-        break;
-    }
+bool KernelLogParser::DecodeReadyThreadEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kThreadEventClass);
+
+  if (scheduler_event_sink_ == NULL)
+    return false;
+
+  BinaryBufferReader reader(event->MofData, event->MofLength);
+  const ReadyThreadV2* data = NULL;
+  if (!reader.Read(&data)) {
+    LOG(ERROR) << "Short ready thread event";
+    return false;
   }
 
-  if (has_info) {
-    switch (event->Header.Class.Type) {
-      case kProcessIsRunningEvent:
-        process_event_sink_->OnProcessIsRunning(time, process_info);
-        break;
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  scheduler_event_sink_->OnThreadReady(time, data->ThreadId);
+  return true;
+}
 
-      case kProcessStartEvent:
-        process_event_sink_->OnProcessStarted(time, process_info);
-        break;
+template <class DiskIoType>
+bool KernelLogParser::DecodeDiskIoEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kDiskIoEventClass);
 
-      case kProcessEndEvent:
-        process_event_sink_->OnProcessEnded(time, process_info, exit_status);
-        break;
-    }
+  if (disk_io_event_sink_ == NULL)
+    return false;
 
-    return true;
+  BinaryBufferReader reader(event->MofData, event->MofLength);
+  const DiskIoType* data = NULL;
+  if (!reader.Read(&data)) {
+    LOG(ERROR) << "Short disk I/O event";
+    return false;
+  }
+
+  // Version 3 tells us the issuing thread.
+  DWORD thread_id = event->Header.ThreadId;
+  const ULONG* issuing_thread_id = NULL;
+  if (event->Header.Class.Version >= 3 && reader.Read(&issuing_thread_id))
+    thread_id = *issuing_thread_id;
+
+  // Convert the response time from ticks, without overflowing the product.
+  base::TimeDelta latency;
+  if (perf_frequency_ != 0) {
+    uint64 ticks = data->HighResResponseTime;
+    latency = base::TimeDelta::FromMicroseconds(
+        (ticks / perf_frequency_) * base::Time::kMicrosecondsPerSecond +
+        (ticks % perf_frequency_) * base::Time::kMicrosecondsPerSecond /
+            perf_frequency_);
+  }
+
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  disk_io_event_sink_->OnDiskIo(time,
+                                event->Header.ProcessId,
+                                thread_id,
+                                event->Header.Class.Type == kDiskIoWriteEvent,
+                                data->DiskNumber,
+                                data->ByteOffset,
+                                data->TransferSize,
+                                data->FileObject,
+                                latency);
+  return true;
+}
+
+template <class FileIoNameType>
+bool KernelLogParser::DecodeFileNameEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kFileIoEventClass);
+
+  if (disk_io_event_sink_ == NULL)
+    return false;
+
+  const FileIoNameType* data =
+      reinterpret_cast<const FileIoNameType*>(event->MofData);
+  size_t data_len = event->MofLength;
+  if (data_len < FIELD_OFFSET(FileIoNameType, FileName)) {
+    LOG(ERROR) << "Short file name event";
+    return false;
   }
 
-  return false;
+  size_t max_len = (data_len -
+      FIELD_OFFSET(FileIoNameType, FileName)) / sizeof(wchar_t);
+  size_t string_len = wcsnlen_s(data->FileName, max_len);
+  std::wstring file_name(data->FileName, string_len);
+
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  disk_io_event_sink_->OnFileName(time, data->FileObject, file_name);
+  return true;
+}
+
+template <class FileIoNameType>
+bool KernelLogParser::DecodeFileDeletedEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kFileIoEventClass);
+
+  if (disk_io_event_sink_ == NULL)
+    return false;
+
+  const FileIoNameType* data =
+      reinterpret_cast<const FileIoNameType*>(event->MofData);
+  if (event->MofLength < FIELD_OFFSET(FileIoNameType, FileName)) {
+    LOG(ERROR) << "Short file delete event";
+    return false;
+  }
+
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  disk_io_event_sink_->OnFileDeleted(time, data->FileObject);
+  return true;
+}
+
+template <class SampledProfileType>
+bool KernelLogParser::DecodeSampledProfileEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kPerfInfoEventClass);
+
+  if (profile_event_sink_ == NULL)
+    return false;
+
+  BinaryBufferReader reader(event->MofData, event->MofLength);
+  const SampledProfileType* data = NULL;
+  if (!reader.Read(&data)) {
+    LOG(ERROR) << "Short sampled profile event";
+    return false;
+  }
+
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  profile_event_sink_->OnSampledProfile(time,
+                                        data->ThreadId,
+                                        data->InstructionPointer,
+                                        data->Count);
+  return true;
+}
+
+template <class FrameType>
+bool KernelLogParser::DecodeStackWalkEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kStackWalkEventClass);
+
+  if (profile_event_sink_ == NULL && heap_event_sink_ == NULL)
+    return false;
+
+  BinaryBufferReader reader(event->MofData, event->MofLength);
+  const StackWalkPrefix* data = NULL;
+  if (!reader.Read(&data)) {
+    LOG(ERROR) << "Short stack walk event";
+    return false;
+  }
+
+  // The frames fill the rest of the event, and the 32 bit ones are widened,
+  // into a buffer that's kept to spare an allocation per stack.
+  size_t num_frames = reader.RemainingBytes() / sizeof(FrameType);
+  stack_frames_.resize(num_frames);
+  for (size_t i = 0; i < num_frames; ++i) {
+    const FrameType* frame = NULL;
+    if (!reader.Read(&frame))
+      break;
+    stack_frames_[i] = *frame;
+  }
+
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  const sym_util::Address* frames =
+      num_frames != 0 ? &stack_frames_[0] : NULL;
+  // The stacks are of whichever events the session asked for, so both
+  // sinks get them, and match them to the events they've seen.
+  if (profile_event_sink_ != NULL) {
+    profile_event_sink_->OnStackWalk(time, data->StackProcess,
+                                     data->StackThread, num_frames, frames);
+  }
+  if (heap_event_sink_ != NULL) {
+    heap_event_sink_->OnStackWalk(time, data->StackProcess,
+                                  data->StackThread, num_frames, frames);
+  }
+  return true;
+}
+
+template <class HeapAllocType>
+bool KernelLogParser::DecodeHeapAllocEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kHeapEventClass);
+
+  if (heap_event_sink_ == NULL)
+    return false;
+
+  BinaryBufferReader reader(event->MofData, event->MofLength);
+  const HeapAllocType* data = NULL;
+  if (!reader.Read(&data)) {
+    LOG(ERROR) << "Short heap alloc event";
+    return false;
+  }
+
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  heap_event_sink_->OnHeapAlloc(time,
+                                event->Header.ProcessId,
+                                event->Header.ThreadId,
+                                data->HeapHandle,
+                                data->AllocAddress,
+                                data->AllocSize);
+  return true;
+}
+
+template <class HeapReallocType>
+bool KernelLogParser::DecodeHeapReallocEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kHeapEventClass);
+
+  if (heap_event_sink_ == NULL)
+    return false;
+
+  BinaryBufferReader reader(event->MofData, event->MofLength);
+  const HeapReallocType* data = NULL;
+  if (!reader.Read(&data)) {
+    LOG(ERROR) << "Short heap realloc event";
+    return false;
+  }
+
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  heap_event_sink_->OnHeapRealloc(time,
+                                  event->Header.ProcessId,
+                                  event->Header.ThreadId,
+                                  data->HeapHandle,
+                                  data->OldAllocAddress,
+                                  data->NewAllocAddress,
+                                  data->NewAllocSize);
+  return true;
+}
+
+template <class HeapFreeType>
+bool KernelLogParser::DecodeHeapFreeEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kHeapEventClass);
+
+  if (heap_event_sink_ == NULL)
+    return false;
+
+  BinaryBufferReader reader(event->MofData, event->MofLength);
+  const HeapFreeType* data = NULL;
+  if (!reader.Read(&data)) {
+    LOG(ERROR) << "Short heap free event";
+    return false;
+  }
+
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  heap_event_sink_->OnHeapFree(time,
+                               event->Header.ProcessId,
+                               event->Header.ThreadId,
+                               data->HeapHandle,
+                               data->FreeAddress);
+  return true;
+}
+
+template <class RegistryType>
+const RegistryType* KernelLogParser::ParseRegistryEvent(EVENT_TRACE* event) {
+  const RegistryType* data =
+      reinterpret_cast<const RegistryType*>(event->MofData);
+  size_t data_len = event->MofLength;
+  if (data_len < FIELD_OFFSET(RegistryType, KeyName))
+    return NULL;
+
+  size_t max_len = (data_len -
+      FIELD_OFFSET(RegistryType, KeyName)) / sizeof(wchar_t);
+  size_t string_len = wcsnlen_s(data->KeyName, max_len);
+  registry_key_name_.assign(data->KeyName, string_len);
+  return data;
+}
+
+template <class RegistryType>
+bool KernelLogParser::DecodeRegistryEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kRegistryEventClass);
+
+  if (registry_event_sink_ == NULL)
+    return false;
+
+  const RegistryType* data = ParseRegistryEvent<RegistryType>(event);
+  if (data == NULL) {
+    LOG(ERROR) << "Short registry event";
+    return false;
+  }
+
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  const EventClock* clock = event_clock_;
+  if (clock == NULL && has_log_clock_)
+    clock = &log_clock_;
+  base::TimeDelta latency;
+  if (clock != NULL && data->InitialTime != 0) {
+    latency = time - clock->ToTime(data->InitialTime);
+    // The approximate clock may well drift past short operations.
+    if (latency < base::TimeDelta())
+      latency = base::TimeDelta();
+  }
+
+  registry_event_sink_->OnRegistryAccess(time,
+                                         event->Header.ProcessId,
+                                         event->Header.ThreadId,
+                                         event->Header.Class.Type,
+                                         data->Status,
+                                         data->KeyHandle,
+                                         registry_key_name_,
+                                         latency);
+  return true;
+}
+
+template <class RegistryType>
+bool KernelLogParser::DecodeRegistryKeyNameEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kRegistryEventClass);
+
+  if (registry_event_sink_ == NULL)
+    return false;
+
+  const RegistryType* data = ParseRegistryEvent<RegistryType>(event);
+  if (data == NULL) {
+    LOG(ERROR) << "Short registry key name event";
+    return false;
+  }
+
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  registry_event_sink_->OnRegistryKeyName(time, data->KeyHandle,
+                                          registry_key_name_);
+  return true;
+}
+
+template <class RegistryType>
+bool KernelLogParser::DecodeRegistryKeyDeletedEvent(EVENT_TRACE* event) {
+  DCHECK(event && event->Header.Guid == kRegistryEventClass);
+
+  if (registry_event_sink_ == NULL)
+    return false;
+
+  const RegistryType* data =
+      reinterpret_cast<const RegistryType*>(event->MofData);
+  if (event->MofLength < FIELD_OFFSET(RegistryType, KeyName)) {
+    LOG(ERROR) << "Short registry key delete event";
+    return false;
+  }
+
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  registry_event_sink_->OnRegistryKeyDeleted(time, data->KeyHandle);
+  return true;
 }
 
 bool KernelLogParser::ProcessOneEvent(EVENT_TRACE* event) {
-  if (event->Header.Guid == kImageLoadEventClass) {
-    return ProcessImageLoadEvent(event);
-  } else if (event->Header.Guid == kPageFaultEventClass) {
-    return ProcessPageFaultEvent(event);
-  } else if (event->Header.Guid == kProcessEventClass) {
-    return ProcessProcessEvent(event);
-  } else if (event->Header.Guid == kEventTraceEventClass) {
+  // The log file header tells the bitness of the events that follow, so
+  // it's dealt with ahead of the decoders.
+  if (event->Header.Guid == kEventTraceEventClass) {
     if (event->Header.Class.Type == kLogFileHeaderEvent) {
       LogFileHeader32* data =
           reinterpret_cast<LogFileHeader32*>(event->MofData);
@@ -566,11 +1048,60 @@ bool KernelLogParser::ProcessOneEvent(EVENT_TRACE* event) {
       if (infer_bitness_from_log_) {
         is_64_bit_log_ = (data->PointerSize == 8);
       }
+
+      // The fields past the logger name are laid out by pointer size.
+      ULONGLONG boot_time = 0;
+      ULONG clock_type = 0;
+      if (data->PointerSize == 8 &&
+          event->MofLength >= sizeof(LogFileHeader64)) {
+        LogFileHeader64* data64 = reinterpret_cast<LogFileHeader64*>(data);
+        perf_frequency_ = data64->PerfFrequency;
+        boot_time = data64->BootTime;
+        clock_type = data64->ReservedFlags;
+      } else if (data->PointerSize != 8 &&
+                 event->MofLength >= sizeof(LogFileHeader32)) {
+        perf_frequency_ = data->PerfFrequency;
+        boot_time = data->BootTime;
+        clock_type = data->ReservedFlags;
+      }
+
+      // The performance counter counts from about boot, which is as close
+      // as the header gets us to its raw time stamps. Older logs leave the
+      // clock type unspecified, and use the performance counter.
+      if (clock_type == kClockTypeSystemTime) {
+        log_clock_.Reset();
+        has_log_clock_ = true;
+      } else if (clock_type != kClockTypeCpuCycle && perf_frequency_ != 0 &&
+                 boot_time != 0) {
+        log_clock_.Init(perf_frequency_, 0, boot_time);
+        has_log_clock_ = true;
+      }
     }
     return true;
   }
 
-  return false;
+  // The events of each processor's buffers come in order, but the buffers
+  // of different processors interleave, so the watermark only advances.
+  base::Time time(base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp)));
+  {
+    base::AutoLock lock(watermark_lock_);
+    if (time > watermark_)
+      watermark_ = time;
+  }
+
+  EventDecoderEntry entry = { { event->Header.Guid,
+                                 event->Header.Class.Type,
+                                 event->Header.Class.Version,
+                                 is_64_bit_log_ },
+                               NULL };
+  EventDecoderTable::const_iterator it(
+      std::lower_bound(event_decoders_.begin(), event_decoders_.end(),
+                       entry));
+  if (it == event_decoders_.end() || entry < *it)
+    return false;
+
+  return (this->*it->decoder)(event);
 }
 
 KernelLogConsumer* KernelLogConsumer::current_ = NULL;
@@ -585,11 +1116,41 @@ KernelLogConsumer::~KernelLogConsumer() {
   current_ = NULL;
 }
 
+void KernelLogConsumer::GetTotals(SessionCostMeter::Totals* totals) {
+  DCHECK(totals != NULL);
+  base::AutoLock lock(totals_lock_);
+  *totals = totals_;
+}
+
 void KernelLogConsumer::ProcessEvent(EVENT_TRACE* event) {
   DCHECK(current_ != NULL);
+  ++current_->pending_totals_.events;
+  current_->pending_totals_.bytes += event->Header.Size;
   current_->ProcessOneEvent(event);
 }
 
+bool KernelLogConsumer::ProcessBuffer(EVENT_TRACE_LOGFILE* buffer) {
+  DCHECK(current_ != NULL);
+
+  // The thread's times are read once a buffer, which is cheap next to the
+  // buffer's events.
+  FILETIME creation = {}, exit = {}, kernel = {}, user = {};
+  if (::GetThreadTimes(::GetCurrentThread(), &creation, &exit, &kernel,
+                       &user)) {
+    ULARGE_INTEGER kernel_time = { kernel.dwLowDateTime,
+                                   kernel.dwHighDateTime };
+    ULARGE_INTEGER user_time = { user.dwLowDateTime, user.dwHighDateTime };
+    // The times are in 100 nanosecond units.
+    current_->pending_totals_.consumer_cpu_time =
+        base::TimeDelta::FromMicroseconds(
+            (kernel_time.QuadPart + user_time.QuadPart) / 10);
+  }
+
+  base::AutoLock lock(current_->totals_lock_);
+  current_->totals_ = current_->pending_totals_;
+  return true;
+}
+
 DWORD WINAPI KernelLogConsumer::ThreadProc(void* param) {
   KernelLogConsumer* consumer =
       reinterpret_cast<KernelLogConsumer*>(param);
@@ -17,10 +17,16 @@
 #define SAWBUCK_LOG_LIB_KERNEL_LOG_CONSUMER_H_
 
 #include <string>
+#include <vector>
+#include "base/synchronization/lock.h"
 #include "base/time/time.h"
 #include "base/win/event_trace_consumer.h"
+#include "sawbuck/log_lib/event_clock.h"
+#include "sawbuck/log_lib/session_cost_meter.h"
 #include "sawbuck/sym_util/types.h"
 
+class EventRouter;
+
 // Implemented by clients of EventTraceConsumer to get module load
 // event notifications.
 class KernelModuleEvents {
@@ -115,6 +121,176 @@ class KernelProcessEvents {
   // TODO(siggi): Data collection end event?
 };
 
+class KernelMemoryEvents {
+ public:
+  // The memory counters of a process, in bytes where they're sizes.
+  struct ProcessCounters {
+    DWORD process_id;
+    // The page faults of the process since it started.
+    ULONG page_fault_count;
+    ULONG handle_count;
+    uint64 working_set;
+    uint64 peak_working_set;
+    // The commit charge of the process, its pagefile usage.
+    uint64 commit;
+    uint64 peak_commit;
+    uint64 virtual_size;
+    uint64 private_bytes;
+  };
+  // Issued for the counters of a process as it ends, and for those of
+  // each running process at the rundowns of the session.
+  virtual void OnProcessCounters(const base::Time& time,
+                                 const ProcessCounters& counters) = 0;
+};
+
+class KernelThreadEvents {
+ public:
+  struct ThreadInfo {
+    ULONG process_id;
+    ULONG thread_id;
+  };
+  // Issued for threads running before the trace session started.
+  virtual void OnThreadIsRunning(const base::Time& time,
+                                 const ThreadInfo& thread_info) = 0;
+  // Issued for threads starting after the trace session started.
+  virtual void OnThreadStarted(const base::Time& time,
+                               const ThreadInfo& thread_info) = 0;
+  // Issued for threads ending.
+  virtual void OnThreadEnded(const base::Time& time,
+                             const ThreadInfo& thread_info) = 0;
+};
+
+class KernelSchedulerEvents {
+ public:
+  // Issued as @p processor switches from running @p old_thread_id to
+  // running @p new_thread_id, either of which may be the idle thread, 0.
+  // @param old_thread_state the KTHREAD_STATE of the old thread, e.g. 5
+  //     for waiting, or 1 for ready if it was preempted.
+  virtual void OnContextSwitch(const base::Time& time,
+                               ULONG processor,
+                               DWORD old_thread_id,
+                               DWORD new_thread_id,
+                               int old_thread_state) = 0;
+  // Issued as @p thread_id becomes ready to run, e.g. as the wait it was
+  // in is satisfied.
+  virtual void OnThreadReady(const base::Time& time,
+                             DWORD thread_id) = 0;
+};
+
+class KernelDiskIoEvents {
+ public:
+  // Issued as a disk read or write completes.
+  // @param process_id the process id of the event header, which is not
+  //     necessarily that of the issuing process.
+  // @param thread_id the issuing thread where the log says, otherwise the
+  //     thread id of the event header.
+  // @param file_object the kernel file object of the I/O, tied to a file
+  //     name by OnFileName.
+  // @param latency the time from issue to completion.
+  virtual void OnDiskIo(const base::Time& time,
+                        DWORD process_id,
+                        DWORD thread_id,
+                        bool is_write,
+                        ULONG disk_number,
+                        uint64 byte_offset,
+                        ULONG transfer_size,
+                        sym_util::Address file_object,
+                        const base::TimeDelta& latency) = 0;
+  // Issued as @p file_object is tied to @p file_name, on creation or for
+  // the files open as the trace session started.
+  virtual void OnFileName(const base::Time& time,
+                          sym_util::Address file_object,
+                          const std::wstring& file_name) = 0;
+  // Issued as @p file_object is freed, after which it may be reused.
+  virtual void OnFileDeleted(const base::Time& time,
+                             sym_util::Address file_object) = 0;
+};
+
+class KernelProfileEvents {
+ public:
+  // Issued for each profile interrupt, as a processor running @p thread_id
+  // was sampled at @p instruction_pointer.
+  // @param count the number of samples this event stands for.
+  virtual void OnSampledProfile(const base::Time& time,
+                                DWORD thread_id,
+                                sym_util::Address instruction_pointer,
+                                ULONG count) = 0;
+  // Issued for each stack walk, which the kernel logs right after the event
+  // the stack is of, e.g. a profile interrupt, on the same thread.
+  // @param frames the @p num_frames return addresses of the stack,
+  //     innermost first, valid only for the duration of the call.
+  virtual void OnStackWalk(const base::Time& time,
+                           DWORD process_id,
+                           DWORD thread_id,
+                           size_t num_frames,
+                           const sym_util::Address* frames) = 0;
+};
+
+class KernelRegistryEvents {
+ public:
+  // Issued as a registry operation completes.
+  // @param operation the registry event type, e.g.
+  //     kernel_log_types::kRegistryOpenEvent.
+  // @param status the NTSTATUS of the operation.
+  // @param key_handle the key control block of the key operated on, tied
+  //     to a key path by OnRegistryKeyName.
+  // @param key_name the name the operation gives, relative to the key of
+  //     @p key_handle, empty if it gives none.
+  // @param latency the time from the start of the operation, zero where
+  //     the log's clock is unknown.
+  virtual void OnRegistryAccess(const base::Time& time,
+                                DWORD process_id,
+                                DWORD thread_id,
+                                int operation,
+                                ULONG status,
+                                sym_util::Address key_handle,
+                                const std::wstring& key_name,
+                                const base::TimeDelta& latency) = 0;
+  // Issued as @p key_handle is tied to the full path @p key_path, on
+  // creation or for the keys open as the trace session started.
+  virtual void OnRegistryKeyName(const base::Time& time,
+                                 sym_util::Address key_handle,
+                                 const std::wstring& key_path) = 0;
+  // Issued as @p key_handle is freed, after which it may be reused.
+  virtual void OnRegistryKeyDeleted(const base::Time& time,
+                                    sym_util::Address key_handle) = 0;
+};
+
+class KernelHeapEvents {
+ public:
+  // Issued as @p thread_id allocates @p size bytes at @p address from
+  // @p heap.
+  virtual void OnHeapAlloc(const base::Time& time,
+                           DWORD process_id,
+                           DWORD thread_id,
+                           sym_util::Address heap,
+                           sym_util::Address address,
+                           uint64 size) = 0;
+  // Issued as @p thread_id reallocates the block at @p old_address to
+  // @p new_size bytes at @p new_address, which may be the same address.
+  virtual void OnHeapRealloc(const base::Time& time,
+                             DWORD process_id,
+                             DWORD thread_id,
+                             sym_util::Address heap,
+                             sym_util::Address old_address,
+                             sym_util::Address new_address,
+                             uint64 new_size) = 0;
+  // Issued as @p thread_id frees the block at @p address.
+  virtual void OnHeapFree(const base::Time& time,
+                          DWORD process_id,
+                          DWORD thread_id,
+                          sym_util::Address heap,
+                          sym_util::Address address) = 0;
+  // Issued for each stack walk, as for KernelProfileEvents. Where the
+  // session asks for the stacks of the heap events, each is followed by
+  // its stack walk on the same thread.
+  virtual void OnStackWalk(const base::Time& time,
+                           DWORD process_id,
+                           DWORD thread_id,
+                           size_t num_frames,
+                           const sym_util::Address* frames) = 0;
+};
+
 class KernelLogParser {
  public:
   KernelLogParser();
@@ -130,6 +306,22 @@ class KernelLogParser {
     is_64_bit_log_ = is_64_bit_log;
   }
 
+  // The frequency of the performance counter of the logging machine, which
+  // the disk I/O latencies are in ticks of. Taken from the log's header.
+  uint64 perf_frequency() const { return perf_frequency_; }
+  void set_perf_frequency(uint64 perf_frequency) {
+    perf_frequency_ = perf_frequency;
+  }
+
+  // The clock that converts the raw time stamps within the events, such
+  // as the start of the registry operations, e.g. that of an
+  // EtlFileReader. Without one, we approximate the clock from the log's
+  // header, by the performance counter counting from boot. We must not
+  // outlive @p event_clock.
+  void set_event_clock(const EventClock* event_clock) {
+    event_clock_ = event_clock;
+  }
+
   void set_module_event_sink(KernelModuleEvents* module_event_sink) {
     module_event_sink_ = module_event_sink;
   }
@@ -139,16 +331,152 @@ class KernelLogParser {
   void set_process_event_sink(KernelProcessEvents* process_event_sink) {
     process_event_sink_ = process_event_sink;
   }
+  void set_memory_event_sink(KernelMemoryEvents* memory_event_sink) {
+    memory_event_sink_ = memory_event_sink;
+  }
+  void set_thread_event_sink(KernelThreadEvents* thread_event_sink) {
+    thread_event_sink_ = thread_event_sink;
+  }
+  void set_scheduler_event_sink(
+      KernelSchedulerEvents* scheduler_event_sink) {
+    scheduler_event_sink_ = scheduler_event_sink;
+  }
+  void set_disk_io_event_sink(KernelDiskIoEvents* disk_io_event_sink) {
+    disk_io_event_sink_ = disk_io_event_sink;
+  }
+  void set_profile_event_sink(KernelProfileEvents* profile_event_sink) {
+    profile_event_sink_ = profile_event_sink;
+  }
+  void set_heap_event_sink(KernelHeapEvents* heap_event_sink) {
+    heap_event_sink_ = heap_event_sink;
+  }
+  void set_registry_event_sink(KernelRegistryEvents* registry_event_sink) {
+    registry_event_sink_ = registry_event_sink;
+  }
+
+  // The time of the latest event processed, or null before the first.
+  // Consumers of the log events of other sessions can hold on to those
+  // stamped after the watermark, to see them only once the kernel events
+  // they depend on, such as module loads, are through.
+  // @note this may be called on any thread.
+  base::Time watermark();
 
   // Process an event, issue callbacks to event sinks as appropriate.
   // @param event the event to process.
   // @returns true iff the event resulted in a notification, false otherwise.
   bool ProcessOneEvent(EVENT_TRACE* event);
 
+  // Routes the event classes we decode to us, for consumers that parse the
+  // events of several parsers. We must outlive @p router's use.
+  void AddEventClasses(EventRouter* router);
+
  private:
-  bool ProcessImageLoadEvent(EVENT_TRACE* event);
-  bool ProcessPageFaultEvent(EVENT_TRACE* event);
-  bool ProcessProcessEvent(EVENT_TRACE* event);
+  // Decodes an event of a known class, type, version and bitness, and
+  // issues the callback it calls for.
+  // @returns true iff the event resulted in a notification.
+  typedef bool (KernelLogParser::*EventDecoder)(EVENT_TRACE* event);
+
+  // The events we decode, sorted by key for lookup.
+  struct EventKey {
+    bool operator<(const EventKey& o) const;
+
+    GUID event_class;
+    UCHAR type;
+    UCHAR version;
+    bool is_64_bit;
+  };
+  struct EventDecoderEntry {
+    bool operator<(const EventDecoderEntry& o) const { return key < o.key; }
+
+    EventKey key;
+    EventDecoder decoder;
+  };
+  typedef std::vector<EventDecoderEntry> EventDecoderTable;
+
+  // Adds the decoder @p decoder for the events keyed by the other arguments.
+  void AddEventDecoder(const GUID& event_class, UCHAR type, UCHAR version,
+                       bool is_64_bit, EventDecoder decoder);
+
+  // Add the decoders of the types of an event class, for an event struct
+  // of a @p version and bitness.
+  template <class ImageLoadType>
+  void AddImageLoadDecoders(UCHAR version, bool is_64_bit);
+  template <class PageFaultType, class HardPageFaultType>
+  void AddPageFaultDecoders(UCHAR version, bool is_64_bit);
+  template <class ProcessInfoType>
+  void AddProcessDecoders(UCHAR version, bool is_64_bit);
+  template <class ProcessCountersType>
+  void AddProcessCountersDecoders(UCHAR version, bool is_64_bit);
+  template <class ThreadInfoType>
+  void AddThreadDecoders(UCHAR version, bool is_64_bit);
+  template <class DiskIoType, class FileIoNameType>
+  void AddDiskIoDecoders(UCHAR version, bool is_64_bit);
+  template <class SampledProfileType, class FrameType>
+  void AddProfileDecoders(UCHAR version, bool is_64_bit);
+  template <class HeapAllocType, class HeapReallocType, class HeapFreeType>
+  void AddHeapDecoders(UCHAR version, bool is_64_bit);
+  template <class RegistryType>
+  void AddRegistryDecoders(UCHAR version, bool is_64_bit);
+
+  // The decoders, by the event struct they parse and the callback they
+  // issue.
+  typedef void (KernelModuleEvents::*ModuleEventHandler)(
+      DWORD process_id,
+      const base::Time& time,
+      const KernelModuleEvents::ModuleInformation& module_info);
+  template <class ImageLoadType, ModuleEventHandler handler>
+  bool DecodeImageLoadEvent(EVENT_TRACE* event);
+
+  typedef void (KernelPageFaultEvents::*PageFaultEventHandler)(
+      DWORD process_id,
+      DWORD thread_id,
+      const base::Time& time,
+      sym_util::Address address,
+      sym_util::Address program_counter);
+  template <class PageFaultType, PageFaultEventHandler handler>
+  bool DecodePageFaultEvent(EVENT_TRACE* event);
+  template <class HardPageFaultType>
+  bool DecodeHardPageFaultEvent(EVENT_TRACE* event);
+
+  template <class ProcessInfoType>
+  bool DecodeProcessEvent(EVENT_TRACE* event);
+  template <class ProcessCountersType>
+  bool DecodeProcessCountersEvent(EVENT_TRACE* event);
+
+  template <class ThreadInfoType>
+  bool DecodeThreadEvent(EVENT_TRACE* event);
+  bool DecodeContextSwitchEvent(EVENT_TRACE* event);
+  bool DecodeReadyThreadEvent(EVENT_TRACE* event);
+  template <class DiskIoType>
+  bool DecodeDiskIoEvent(EVENT_TRACE* event);
+  template <class FileIoNameType>
+  bool DecodeFileNameEvent(EVENT_TRACE* event);
+  template <class FileIoNameType>
+  bool DecodeFileDeletedEvent(EVENT_TRACE* event);
+  template <class SampledProfileType>
+  bool DecodeSampledProfileEvent(EVENT_TRACE* event);
+  template <class FrameType>
+  bool DecodeStackWalkEvent(EVENT_TRACE* event);
+  template <class HeapAllocType>
+  bool DecodeHeapAllocEvent(EVENT_TRACE* event);
+  template <class HeapReallocType>
+  bool DecodeHeapReallocEvent(EVENT_TRACE* event);
+  template <class HeapFreeType>
+  bool DecodeHeapFreeEvent(EVENT_TRACE* event);
+  template <class RegistryType>
+  bool DecodeRegistryEvent(EVENT_TRACE* event);
+  template <class RegistryType>
+  bool DecodeRegistryKeyNameEvent(EVENT_TRACE* event);
+  template <class RegistryType>
+  bool DecodeRegistryKeyDeletedEvent(EVENT_TRACE* event);
+
+  // Parses the key name of the registry event @p event to
+  // registry_key_name_.
+  // @returns the event data, or NULL if the event is short.
+  template <class RegistryType>
+  const RegistryType* ParseRegistryEvent(EVENT_TRACE* event);
+
+  EventDecoderTable event_decoders_;
 
   // Our module event sink.
   KernelModuleEvents* module_event_sink_;
@@ -156,6 +484,21 @@ class KernelLogParser {
   KernelPageFaultEvents* page_fault_event_sink_;
   // Our process event sink.
   KernelProcessEvents* process_event_sink_;
+  // Our memory event sink.
+  KernelMemoryEvents* memory_event_sink_;
+  // Our thread event sink.
+  KernelThreadEvents* thread_event_sink_;
+  // Our scheduler event sink.
+  KernelSchedulerEvents* scheduler_event_sink_;
+
+  // Our disk I/O event sink.
+  KernelDiskIoEvents* disk_io_event_sink_;
+  // Our profile event sink.
+  KernelProfileEvents* profile_event_sink_;
+  // Our heap event sink, which gets the stack walks too.
+  KernelHeapEvents* heap_event_sink_;
+  // Our registry event sink.
+  KernelRegistryEvents* registry_event_sink_;
 
   // If true, we should infer the log bitness from the event stream,
   // e.g. from the pointer size field of the log file header event.
@@ -164,6 +507,29 @@ class KernelLogParser {
   // True iff (infer_bitness_from_log_ == true), and we've evidence that
   // the log we're consuming originates from a 64 bit machine.
   bool is_64_bit_log_;
+
+  // The performance counter frequency of the logging machine, or zero if
+  // we've yet to see the log file header.
+  uint64 perf_frequency_;
+
+  // The clock we've been given, if any, and the one we approximate from
+  // the log file header otherwise, valid iff has_log_clock_.
+  const EventClock* event_clock_;
+  EventClock log_clock_;
+  bool has_log_clock_;
+
+  // The module and process information issued to the sinks. These are
+  // decoded into for each event, so that their strings keep their
+  // buffers, and decoding doesn't allocate once they've grown to fit.
+  KernelModuleEvents::ModuleInformation module_info_;
+  KernelProcessEvents::ProcessInfo process_info_;
+  // The frames of the latest stack walk, widened to sym_util::Address.
+  std::vector<sym_util::Address> stack_frames_;
+  // The key name of the latest registry event.
+  std::wstring registry_key_name_;
+
+  base::Lock watermark_lock_;
+  base::Time watermark_;  // Under watermark_lock_.
 };
 
 class KernelLogConsumer
@@ -173,10 +539,22 @@ class KernelLogConsumer
   KernelLogConsumer();
   ~KernelLogConsumer();
 
+  // Retrieves the events and bytes consumed so far, and the CPU time of
+  // the consuming thread, as of the last buffer consumed, to @p totals.
+  // @note this may be called on any thread.
+  void GetTotals(SessionCostMeter::Totals* totals);
+
   static DWORD WINAPI ThreadProc(void* param);
   static void ProcessEvent(EVENT_TRACE* event);
+  static bool ProcessBuffer(EVENT_TRACE_LOGFILE* buffer);
 
  private:
+  // The totals since the last buffer, owned by the consuming thread.
+  SessionCostMeter::Totals pending_totals_;
+
+  base::Lock totals_lock_;
+  SessionCostMeter::Totals totals_;  // Under totals_lock_.
+
   static KernelLogConsumer* current_;
 };
 
@@ -19,13 +19,16 @@
 #include "base/files/file_path.h"
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
+#include "sawbuck/log_lib/kernel_log_types.h"
 #include "sawbuck/log_lib/kernel_log_unittest_data.h"
 
 namespace {
 
 using testing::_;
+using testing::AllOf;
 using testing::ByRef;
 using testing::Eq;
+using testing::Field;
 using testing::InSequence;
 using testing::StrictMock;
 
@@ -53,6 +56,196 @@ class MockKernelProcessEvents: public KernelProcessEvents{
                                      ULONG exit_status));
 };
 
+class MockKernelMemoryEvents: public KernelMemoryEvents {
+ public:
+  MOCK_METHOD2(OnProcessCounters, void(const base::Time& time,
+                                       const ProcessCounters& counters));
+};
+
+class MockKernelPageFaultEvents: public KernelPageFaultEvents {
+ public:
+  MOCK_METHOD5(OnTransitionFault, void(DWORD process_id,
+                                       DWORD thread_id,
+                                       const base::Time& time,
+                                       sym_util::Address address,
+                                       sym_util::Address program_counter));
+  MOCK_METHOD5(OnDemandZeroFault, void(DWORD process_id,
+                                       DWORD thread_id,
+                                       const base::Time& time,
+                                       sym_util::Address address,
+                                       sym_util::Address program_counter));
+  MOCK_METHOD5(OnCopyOnWriteFault, void(DWORD process_id,
+                                        DWORD thread_id,
+                                        const base::Time& time,
+                                        sym_util::Address address,
+                                        sym_util::Address program_counter));
+  MOCK_METHOD5(OnGuardPageFault, void(DWORD process_id,
+                                      DWORD thread_id,
+                                      const base::Time& time,
+                                      sym_util::Address address,
+                                      sym_util::Address program_counter));
+  MOCK_METHOD5(OnHardFault, void(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter));
+  MOCK_METHOD5(OnAccessViolationFault, void(DWORD process_id,
+                                            DWORD thread_id,
+                                            const base::Time& time,
+                                            sym_util::Address address,
+                                            sym_util::Address program_counter));
+  MOCK_METHOD7(OnHardPageFault, void(DWORD thread_id,
+                                     const base::Time& time,
+                                     const base::Time& initial_time,
+                                     sym_util::Offset offset,
+                                     sym_util::Address address,
+                                     sym_util::Address file_object,
+                                     sym_util::ByteCount byte_count));
+};
+
+class MockKernelThreadEvents: public KernelThreadEvents {
+ public:
+  MOCK_METHOD2(OnThreadIsRunning, void(const base::Time& time,
+                                       const ThreadInfo& thread_info));
+  MOCK_METHOD2(OnThreadStarted, void(const base::Time& time,
+                                     const ThreadInfo& thread_info));
+  MOCK_METHOD2(OnThreadEnded, void(const base::Time& time,
+                                   const ThreadInfo& thread_info));
+};
+
+class MockKernelSchedulerEvents: public KernelSchedulerEvents {
+ public:
+  MOCK_METHOD5(OnContextSwitch, void(const base::Time& time,
+                                     ULONG processor,
+                                     DWORD old_thread_id,
+                                     DWORD new_thread_id,
+                                     int old_thread_state));
+  MOCK_METHOD2(OnThreadReady, void(const base::Time& time,
+                                   DWORD thread_id));
+};
+
+class MockKernelDiskIoEvents: public KernelDiskIoEvents {
+ public:
+  MOCK_METHOD9(OnDiskIo, void(const base::Time& time,
+                              DWORD process_id,
+                              DWORD thread_id,
+                              bool is_write,
+                              ULONG disk_number,
+                              uint64 byte_offset,
+                              ULONG transfer_size,
+                              sym_util::Address file_object,
+                              const base::TimeDelta& latency));
+  MOCK_METHOD3(OnFileName, void(const base::Time& time,
+                                sym_util::Address file_object,
+                                const std::wstring& file_name));
+  MOCK_METHOD2(OnFileDeleted, void(const base::Time& time,
+                                   sym_util::Address file_object));
+};
+
+class MockKernelProfileEvents: public KernelProfileEvents {
+ public:
+  typedef std::vector<sym_util::Address> Frames;
+
+  MOCK_METHOD4(OnSampledProfile, void(const base::Time& time,
+                                      DWORD thread_id,
+                                      sym_util::Address instruction_pointer,
+                                      ULONG count));
+  // The frames are only valid for the call, so they're copied into a vector
+  // for matching.
+  virtual void OnStackWalk(const base::Time& time,
+                           DWORD process_id,
+                           DWORD thread_id,
+                           size_t num_frames,
+                           const sym_util::Address* frames) {
+    OnStack(process_id, thread_id, Frames(frames, frames + num_frames));
+  }
+  MOCK_METHOD3(OnStack, void(DWORD process_id,
+                             DWORD thread_id,
+                             const Frames& frames));
+};
+
+class MockKernelHeapEvents: public KernelHeapEvents {
+ public:
+  typedef std::vector<sym_util::Address> Frames;
+
+  MOCK_METHOD6(OnHeapAlloc, void(const base::Time& time,
+                                 DWORD process_id,
+                                 DWORD thread_id,
+                                 sym_util::Address heap,
+                                 sym_util::Address address,
+                                 uint64 size));
+  MOCK_METHOD7(OnHeapRealloc, void(const base::Time& time,
+                                   DWORD process_id,
+                                   DWORD thread_id,
+                                   sym_util::Address heap,
+                                   sym_util::Address old_address,
+                                   sym_util::Address new_address,
+                                   uint64 new_size));
+  MOCK_METHOD5(OnHeapFree, void(const base::Time& time,
+                                DWORD process_id,
+                                DWORD thread_id,
+                                sym_util::Address heap,
+                                sym_util::Address address));
+  virtual void OnStackWalk(const base::Time& time,
+                           DWORD process_id,
+                           DWORD thread_id,
+                           size_t num_frames,
+                           const sym_util::Address* frames) {
+    OnStack(process_id, thread_id, Frames(frames, frames + num_frames));
+  }
+  MOCK_METHOD3(OnStack, void(DWORD process_id,
+                             DWORD thread_id,
+                             const Frames& frames));
+};
+
+class MockKernelRegistryEvents: public KernelRegistryEvents {
+ public:
+  MOCK_METHOD8(OnRegistryAccess, void(const base::Time& time,
+                                      DWORD process_id,
+                                      DWORD thread_id,
+                                      int operation,
+                                      ULONG status,
+                                      sym_util::Address key_handle,
+                                      const std::wstring& key_name,
+                                      const base::TimeDelta& latency));
+  MOCK_METHOD3(OnRegistryKeyName, void(const base::Time& time,
+                                       sym_util::Address key_handle,
+                                       const std::wstring& key_path));
+  MOCK_METHOD2(OnRegistryKeyDeleted, void(const base::Time& time,
+                                          sym_util::Address key_handle));
+};
+
+MATCHER_P2(ThreadInfoIs, process_id, thread_id, "") {
+  return arg.process_id == process_id && arg.thread_id == thread_id;
+}
+
+MATCHER_P3(ProcessCountersAre, process_id, working_set, commit, "") {
+  return arg.process_id == process_id && arg.working_set == working_set &&
+      arg.commit == commit;
+}
+
+// Makes an event of @p event_class, @p type and @p version around @p data.
+template <class DataType>
+EVENT_TRACE MakeEvent(const GUID& event_class, UCHAR type, UCHAR version,
+                      DataType* data) {
+  EVENT_TRACE event = {};
+  event.Header.Guid = event_class;
+  event.Header.Class.Type = type;
+  event.Header.Class.Version = version;
+  event.Header.ProcessId = 1234;
+  event.Header.ThreadId = 4321;
+  event.MofData = data;
+  event.MofLength = sizeof(*data);
+  return event;
+}
+
+// Makes a page fault event of @p type and @p version around @p data.
+template <class DataType>
+EVENT_TRACE MakePageFaultEvent(UCHAR type, UCHAR version, DataType* data) {
+  return MakeEvent(kernel_log_types::kPageFaultEventClass, type, version,
+                   data);
+}
+
 class KernelLogConsumerTest: public testing::Test {
  public:
   KernelLogConsumerTest() {
@@ -153,6 +346,477 @@ class KernelLogConsumerTest: public testing::Test {
   ModuleInfoList modules_;
 };
 
+TEST(KernelLogParserTest, PageFaultEvents) {
+  StrictMock<MockKernelPageFaultEvents> page_fault_events;
+  KernelLogParser parser;
+  parser.set_infer_bitness_from_log(false);
+  parser.set_page_fault_event_sink(&page_fault_events);
+
+  kernel_log_types::PageFault32V2 fault32 = { 0x1000, 0x2000 };
+  EVENT_TRACE event = MakePageFaultEvent(
+      kernel_log_types::kDemandZeroFaultEvent, 2, &fault32);
+  EXPECT_CALL(page_fault_events,
+              OnDemandZeroFault(1234, 4321, _, 0x1000, 0x2000)).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  kernel_log_types::HardPageFault32V2 hard32 = {};
+  hard32.ReadOffset = 0x3000;
+  hard32.VirtualAddress = 0x4000;
+  hard32.ThreadId = 4322;
+  hard32.ByteCount = 0x5000;
+  event = MakePageFaultEvent(kernel_log_types::kHardPageFaultEvent, 2,
+                             &hard32);
+  EXPECT_CALL(page_fault_events,
+              OnHardPageFault(4322, _, _, 0x3000, 0x4000, 0, 0x5000))
+      .Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  // A version we don't know of is ignored.
+  event = MakePageFaultEvent(kernel_log_types::kDemandZeroFaultEvent, 1,
+                             &fault32);
+  EXPECT_FALSE(parser.ProcessOneEvent(&event));
+
+  parser.set_is_64_bit_log(true);
+  kernel_log_types::PageFault64V2 fault64 = { 0x100000000ULL, 0x2000 };
+  event = MakePageFaultEvent(kernel_log_types::kHardEvent, 2, &fault64);
+  EXPECT_CALL(page_fault_events,
+              OnHardFault(1234, 4321, _, 0x100000000ULL, 0x2000)).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  // Too short for its bitness.
+  event = MakePageFaultEvent(kernel_log_types::kHardEvent, 2, &fault32);
+  EXPECT_FALSE(parser.ProcessOneEvent(&event));
+}
+
+TEST(KernelLogParserTest, ProcessCountersEvents) {
+  StrictMock<MockKernelMemoryEvents> memory_events;
+  KernelLogParser parser;
+  parser.set_infer_bitness_from_log(false);
+  parser.set_memory_event_sink(&memory_events);
+
+  kernel_log_types::ProcessPerfCtr32V2 counters32 = {};
+  counters32.ProcessId = 1235;
+  counters32.PageFaultCount = 100;
+  counters32.WorkingSetSize = 0x200000;
+  counters32.PagefileUsage = 0x100000;
+  EVENT_TRACE event = MakeEvent(kernel_log_types::kProcessEventClass,
+      kernel_log_types::kProcessPerfCtrRundownEvent, 2, &counters32);
+  EXPECT_CALL(memory_events,
+              OnProcessCounters(_, ProcessCountersAre(1235U, 0x200000U,
+                                                      0x100000U))).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  parser.set_is_64_bit_log(true);
+  kernel_log_types::ProcessPerfCtr64V2 counters64 = {};
+  counters64.ProcessId = 1236;
+  counters64.WorkingSetSize = 0x100000000ULL;
+  counters64.PagefileUsage = 0x180000000ULL;
+  event = MakeEvent(kernel_log_types::kProcessEventClass,
+                    kernel_log_types::kProcessPerfCtrEvent, 2, &counters64);
+  EXPECT_CALL(memory_events,
+              OnProcessCounters(_, ProcessCountersAre(1236U,
+                                                      0x100000000ULL,
+                                                      0x180000000ULL)))
+      .Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  // Too short for its bitness.
+  event = MakeEvent(kernel_log_types::kProcessEventClass,
+                    kernel_log_types::kProcessPerfCtrEvent, 2, &counters32);
+  EXPECT_FALSE(parser.ProcessOneEvent(&event));
+}
+
+TEST(KernelLogParserTest, ThreadEvents) {
+  StrictMock<MockKernelThreadEvents> thread_events;
+  KernelLogParser parser;
+  parser.set_infer_bitness_from_log(false);
+  parser.set_thread_event_sink(&thread_events);
+
+  // Thread events are laid out the same on either bitness.
+  kernel_log_types::ThreadInfoPrefix thread = { 1235, 4322 };
+  EVENT_TRACE event = MakeEvent(kernel_log_types::kThreadEventClass,
+                                kernel_log_types::kThreadIsRunningEvent, 2,
+                                &thread);
+  EXPECT_CALL(thread_events,
+              OnThreadIsRunning(_, ThreadInfoIs(1235U, 4322U))).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  parser.set_is_64_bit_log(true);
+  event = MakeEvent(kernel_log_types::kThreadEventClass,
+                    kernel_log_types::kThreadStartEvent, 3, &thread);
+  EXPECT_CALL(thread_events,
+              OnThreadStarted(_, ThreadInfoIs(1235U, 4322U))).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  event = MakeEvent(kernel_log_types::kThreadEventClass,
+                    kernel_log_types::kThreadEndEvent, 1, &thread);
+  EXPECT_CALL(thread_events,
+              OnThreadEnded(_, ThreadInfoIs(1235U, 4322U))).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  // The collection end carries nothing we use.
+  event = MakeEvent(kernel_log_types::kThreadEventClass,
+                    kernel_log_types::kThreadCollectionEnded, 2, &thread);
+  EXPECT_FALSE(parser.ProcessOneEvent(&event));
+}
+
+TEST(KernelLogParserTest, SchedulerEvents) {
+  StrictMock<MockKernelSchedulerEvents> scheduler_events;
+  KernelLogParser parser;
+  parser.set_infer_bitness_from_log(false);
+  parser.set_scheduler_event_sink(&scheduler_events);
+
+  kernel_log_types::ContextSwitchV2 context_switch = {};
+  context_switch.NewThreadId = 4322;
+  context_switch.OldThreadId = 4321;
+  context_switch.OldThreadState = 5;
+  EVENT_TRACE event = MakeEvent(kernel_log_types::kThreadEventClass,
+                                kernel_log_types::kContextSwitchEvent, 2,
+                                &context_switch);
+  event.BufferContext.ProcessorNumber = 3;
+  EXPECT_CALL(scheduler_events,
+              OnContextSwitch(_, 3U, 4321U, 4322U, 5)).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  parser.set_is_64_bit_log(true);
+  kernel_log_types::ReadyThreadV2 ready_thread = {};
+  ready_thread.ThreadId = 4323;
+  event = MakeEvent(kernel_log_types::kThreadEventClass,
+                    kernel_log_types::kReadyThreadEvent, 2, &ready_thread);
+  EXPECT_CALL(scheduler_events, OnThreadReady(_, 4323U)).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  // A short event is rejected.
+  event.MofLength = sizeof(ready_thread) - 1;
+  EXPECT_FALSE(parser.ProcessOneEvent(&event));
+}
+
+TEST(KernelLogParserTest, DiskIoEvents) {
+  StrictMock<MockKernelDiskIoEvents> disk_io_events;
+  KernelLogParser parser;
+  parser.set_infer_bitness_from_log(false);
+  parser.set_disk_io_event_sink(&disk_io_events);
+  // Ten ticks to the microsecond.
+  parser.set_perf_frequency(10000000);
+
+  kernel_log_types::DiskIo32V2 disk_io = {};
+  disk_io.DiskNumber = 1;
+  disk_io.TransferSize = 0x1000;
+  disk_io.ByteOffset = 0x100000000ULL;
+  disk_io.FileObject = 0x80001000;
+  disk_io.HighResResponseTime = 50000;
+  EVENT_TRACE event = MakeEvent(kernel_log_types::kDiskIoEventClass,
+                                kernel_log_types::kDiskIoReadEvent, 2,
+                                &disk_io);
+  EXPECT_CALL(disk_io_events,
+              OnDiskIo(_, 1234U, 4321U, false, 1U, 0x100000000ULL, 0x1000U,
+                       0x80001000U, base::TimeDelta::FromMicroseconds(5000)))
+      .Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  // Version 3 names the issuing thread.
+  parser.set_is_64_bit_log(true);
+  struct {
+    kernel_log_types::DiskIo64V2 disk_io;
+    ULONG issuing_thread_id;
+  } disk_io_v3 = {};
+  disk_io_v3.disk_io.FileObject = 0xFFFFFA8001234560ULL;
+  disk_io_v3.issuing_thread_id = 4322;
+  event = MakeEvent(kernel_log_types::kDiskIoEventClass,
+                    kernel_log_types::kDiskIoWriteEvent, 3, &disk_io_v3);
+  EXPECT_CALL(disk_io_events,
+              OnDiskIo(_, 1234U, 4322U, true, 0U, 0U, 0U,
+                       0xFFFFFA8001234560ULL, base::TimeDelta())).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  // The file name events.
+  struct {
+    ULONGLONG file_object;
+    wchar_t file_name[8];
+  } file_name = { 0xFFFFFA8001234560ULL, L"c:\foo" };
+  event = MakeEvent(kernel_log_types::kFileIoEventClass,
+                    kernel_log_types::kFileIoFileRundownEvent, 2,
+                    &file_name);
+  EXPECT_CALL(disk_io_events,
+              OnFileName(_, 0xFFFFFA8001234560ULL, std::wstring(L"c:\foo")))
+      .Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  event = MakeEvent(kernel_log_types::kFileIoEventClass,
+                    kernel_log_types::kFileIoFileDeleteEvent, 2, &file_name);
+  EXPECT_CALL(disk_io_events,
+              OnFileDeleted(_, 0xFFFFFA8001234560ULL)).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  // A short event is rejected.
+  event.MofLength = sizeof(ULONG);
+  EXPECT_FALSE(parser.ProcessOneEvent(&event));
+}
+
+TEST(KernelLogParserTest, ProfileEvents) {
+  typedef MockKernelProfileEvents::Frames Frames;
+  StrictMock<MockKernelProfileEvents> profile_events;
+  KernelLogParser parser;
+  parser.set_infer_bitness_from_log(false);
+  parser.set_profile_event_sink(&profile_events);
+
+  kernel_log_types::SampledProfile32V2 sample = {};
+  sample.InstructionPointer = 0x10001234;
+  sample.ThreadId = 4322;
+  sample.Count = 1;
+  EVENT_TRACE event = MakeEvent(kernel_log_types::kPerfInfoEventClass,
+                                kernel_log_types::kSampledProfileEvent, 2,
+                                &sample);
+  EXPECT_CALL(profile_events,
+              OnSampledProfile(_, 4322U, 0x10001234U, 1U)).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  // The 32 bit frames are widened.
+  struct {
+    kernel_log_types::StackWalkPrefix prefix;
+    ULONG frames[3];
+  } stack32 = { { 0, 1235, 4322 }, { 0x10001234, 0x10002000, 0x80000000 } };
+  event = MakeEvent(kernel_log_types::kStackWalkEventClass,
+                    kernel_log_types::kStackWalkEvent, 2, &stack32);
+  // Leave out the struct's tail padding, which would read as a frame.
+  event.MofLength = sizeof(stack32.prefix) + sizeof(stack32.frames);
+  Frames expected32;
+  expected32.push_back(0x10001234);
+  expected32.push_back(0x10002000);
+  expected32.push_back(0x80000000);
+  EXPECT_CALL(profile_events, OnStack(1235U, 4322U, expected32)).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  parser.set_is_64_bit_log(true);
+  struct {
+    kernel_log_types::StackWalkPrefix prefix;
+    ULONGLONG frames[2];
+  } stack64 = { { 0, 1236, 4323 },
+                { 0x000007FEF0001000ULL, 0xFFFFF80001234567ULL } };
+  event = MakeEvent(kernel_log_types::kStackWalkEventClass,
+                    kernel_log_types::kStackWalkEvent, 2, &stack64);
+  Frames expected64;
+  expected64.push_back(0x000007FEF0001000ULL);
+  expected64.push_back(0xFFFFF80001234567ULL);
+  EXPECT_CALL(profile_events, OnStack(1236U, 4323U, expected64)).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  // A stack walk with no room for its prefix is rejected.
+  event.MofLength = sizeof(ULONG);
+  EXPECT_FALSE(parser.ProcessOneEvent(&event));
+}
+
+TEST(KernelLogParserTest, HeapEvents) {
+  typedef MockKernelHeapEvents::Frames Frames;
+  StrictMock<MockKernelHeapEvents> heap_events;
+  KernelLogParser parser;
+  parser.set_infer_bitness_from_log(false);
+  parser.set_heap_event_sink(&heap_events);
+
+  kernel_log_types::HeapAlloc32V2 alloc32 = { 0x00300000, 24, 0x00301000 };
+  EVENT_TRACE event = MakeEvent(kernel_log_types::kHeapEventClass,
+                                kernel_log_types::kHeapAllocEvent, 2,
+                                &alloc32);
+  EXPECT_CALL(heap_events,
+              OnHeapAlloc(_, 1234U, 4321U, 0x00300000U, 0x00301000U, 24U))
+      .Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  kernel_log_types::HeapRealloc32V2 realloc32 =
+      { 0x00300000, 0x00302000, 0x00301000, 48, 24 };
+  event = MakeEvent(kernel_log_types::kHeapEventClass,
+                    kernel_log_types::kHeapReallocEvent, 2, &realloc32);
+  EXPECT_CALL(heap_events,
+              OnHeapRealloc(_, 1234U, 4321U, 0x00300000U, 0x00301000U,
+                            0x00302000U, 48U)).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  // The heap sink gets the stack walks, without a profile sink.
+  struct {
+    kernel_log_types::StackWalkPrefix prefix;
+    ULONG frames[2];
+  } stack32 = { { 0, 1234, 4321 }, { 0x77001234, 0x10002000 } };
+  event = MakeEvent(kernel_log_types::kStackWalkEventClass,
+                    kernel_log_types::kStackWalkEvent, 2, &stack32);
+  event.MofLength = sizeof(stack32.prefix) + sizeof(stack32.frames);
+  Frames expected32;
+  expected32.push_back(0x77001234);
+  expected32.push_back(0x10002000);
+  EXPECT_CALL(heap_events, OnStack(1234U, 4321U, expected32)).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  parser.set_is_64_bit_log(true);
+  kernel_log_types::HeapFree64V2 free64 =
+      { 0x0000000000300000ULL, 0x000007FF00302000ULL };
+  event = MakeEvent(kernel_log_types::kHeapEventClass,
+                    kernel_log_types::kHeapFreeEvent, 2, &free64);
+  EXPECT_CALL(heap_events,
+              OnHeapFree(_, 1234U, 4321U, 0x0000000000300000ULL,
+                         0x000007FF00302000ULL)).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  // A short event is rejected.
+  event.MofLength = sizeof(ULONGLONG);
+  EXPECT_FALSE(parser.ProcessOneEvent(&event));
+}
+
+TEST(KernelLogParserTest, RegistryEvents) {
+  StrictMock<MockKernelRegistryEvents> registry_events;
+  KernelLogParser parser;
+  parser.set_infer_bitness_from_log(false);
+  parser.set_registry_event_sink(&registry_events);
+
+  // A clock of a tick per microsecond, from the event's time stamp.
+  const base::Time kTime = base::Time::Now();
+  FILETIME file_time = kTime.ToFileTime();
+  int64 file_time_stamp =
+      reinterpret_cast<LARGE_INTEGER&>(file_time).QuadPart;
+  EventClock clock;
+  clock.Init(1000000, 1000000, file_time_stamp);
+  parser.set_event_clock(&clock);
+
+  // The operation started 250 microseconds before it completed.
+  // The name follows the fixed fields, which the structs pad past.
+  struct {
+    LONGLONG initial_time;
+    ULONG status;
+    ULONG index;
+    ULONG key_handle;
+    wchar_t key_name[16];
+  } open32 = { 1000000 - 250, 0, 0, 0xE1001000, L"Google\\Chrome" };
+  EVENT_TRACE event = MakeEvent(kernel_log_types::kRegistryEventClass,
+                                kernel_log_types::kRegistryOpenEvent, 2,
+                                &open32);
+  event.Header.TimeStamp.QuadPart = file_time_stamp;
+  EXPECT_CALL(registry_events,
+              OnRegistryAccess(_, 1234U, 4321U,
+                               kernel_log_types::kRegistryOpenEvent, 0U,
+                               0xE1001000U, std::wstring(L"Google\\Chrome"),
+                               base::TimeDelta::FromMicroseconds(250)))
+      .Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  parser.set_is_64_bit_log(true);
+  struct {
+    LONGLONG initial_time;
+    ULONG status;
+    ULONG index;
+    ULONGLONG key_handle;
+    wchar_t key_path[32];
+  } kcb64 = { 0, 0, 0, 0xFFFFF8A000102000ULL,
+              L"\\REGISTRY\\MACHINE\\SOFTWARE" };
+  event = MakeEvent(kernel_log_types::kRegistryEventClass,
+                    kernel_log_types::kRegistryKcbRundownBeginEvent, 2,
+                    &kcb64);
+  EXPECT_CALL(registry_events,
+              OnRegistryKeyName(_, 0xFFFFF8A000102000ULL,
+                                std::wstring(kcb64.key_path))).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  event = MakeEvent(kernel_log_types::kRegistryEventClass,
+                    kernel_log_types::kRegistryKcbDeleteEvent, 2, &kcb64);
+  EXPECT_CALL(registry_events,
+              OnRegistryKeyDeleted(_, 0xFFFFF8A000102000ULL)).Times(1);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  // A short event is rejected.
+  event.MofLength = sizeof(ULONG);
+  EXPECT_FALSE(parser.ProcessOneEvent(&event));
+}
+
+TEST(KernelLogParserTest, PerfFrequencyFromLogFileHeader) {
+  KernelLogParser parser;
+
+  kernel_log_types::LogFileHeader64 header = {};
+  header.PointerSize = 8;
+  header.PerfFrequency = 3579545;
+  EVENT_TRACE event = MakeEvent(kernel_log_types::kEventTraceEventClass,
+                                kernel_log_types::kLogFileHeaderEvent, 2,
+                                &header);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+  EXPECT_TRUE(parser.is_64_bit_log());
+  EXPECT_EQ(3579545U, parser.perf_frequency());
+
+  kernel_log_types::LogFileHeader32 header32 = {};
+  header32.PointerSize = 4;
+  header32.PerfFrequency = 14318180;
+  event = MakeEvent(kernel_log_types::kEventTraceEventClass,
+                    kernel_log_types::kLogFileHeaderEvent, 2, &header32);
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+  EXPECT_FALSE(parser.is_64_bit_log());
+  EXPECT_EQ(14318180U, parser.perf_frequency());
+}
+
+TEST(KernelLogParserTest, Watermark) {
+  KernelLogParser parser;
+  parser.set_infer_bitness_from_log(false);
+  EXPECT_TRUE(parser.watermark().is_null());
+
+  base::Time t0(base::Time::Now());
+  kernel_log_types::ThreadInfoPrefix thread = { 1235, 4322 };
+  EVENT_TRACE event = MakeEvent(kernel_log_types::kThreadEventClass,
+                                kernel_log_types::kThreadStartEvent, 2,
+                                &thread);
+  reinterpret_cast<FILETIME&>(event.Header.TimeStamp) = t0.ToFileTime();
+
+  // Events no one sinks still advance the watermark.
+  EXPECT_FALSE(parser.ProcessOneEvent(&event));
+  EXPECT_TRUE(t0 == parser.watermark());
+
+  // It never goes back.
+  base::Time t1(t0 + base::TimeDelta::FromMilliseconds(10));
+  reinterpret_cast<FILETIME&>(event.Header.TimeStamp) = t1.ToFileTime();
+  parser.ProcessOneEvent(&event);
+  reinterpret_cast<FILETIME&>(event.Header.TimeStamp) = t0.ToFileTime();
+  parser.ProcessOneEvent(&event);
+  EXPECT_TRUE(t1 == parser.watermark());
+}
+
+TEST(KernelLogParserTest, ImageEventsDontInheritFields) {
+  typedef KernelModuleEvents::ModuleInformation ModuleInformation;
+  StrictMock<MockKernelModuleEvents> module_events;
+  KernelLogParser parser;
+  parser.set_infer_bitness_from_log(false);
+  parser.set_module_event_sink(&module_events);
+
+  // The parser decodes every image event into the same module information,
+  // so an older event must not pick up the fields of a newer one.
+  char buffer2[256] = {};
+  kernel_log_types::ImageLoad32V2* load2 =
+      reinterpret_cast<kernel_log_types::ImageLoad32V2*>(buffer2);
+  load2->BaseAddress = 0x10000000;
+  load2->ModuleSize = 0x1000;
+  load2->ImageChecksum = 0xCAFE;
+  load2->TimeDateStamp = 0xF00D;
+  wcscpy(load2->ImageFileName, L"C:\\Windows\\System32\\kernel32.dll");
+  EVENT_TRACE event = MakeEvent(kernel_log_types::kImageLoadEventClass,
+                                kernel_log_types::kImageNotifyLoadEvent, 2,
+                                load2);
+  event.MofLength = sizeof(buffer2);
+  EXPECT_CALL(module_events, OnModuleLoad(1234, _, AllOf(
+      Field(&ModuleInformation::image_checksum, 0xCAFEU),
+      Field(&ModuleInformation::time_date_stamp, 0xF00DU),
+      Field(&ModuleInformation::image_file_name,
+            L"C:\\Windows\\System32\\kernel32.dll"))));
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+
+  char buffer0[256] = {};
+  kernel_log_types::ImageLoad32V0* load0 =
+      reinterpret_cast<kernel_log_types::ImageLoad32V0*>(buffer0);
+  load0->BaseAddress = 0x20000000;
+  load0->ModuleSize = 0x2000;
+  wcscpy(load0->ImageFileName, L"C:\\a.dll");
+  event = MakeEvent(kernel_log_types::kImageLoadEventClass,
+                    kernel_log_types::kImageNotifyLoadEvent, 0, load0);
+  event.MofLength = sizeof(buffer0);
+  EXPECT_CALL(module_events, OnModuleLoad(1234, _, AllOf(
+      Field(&ModuleInformation::base_address, 0x20000000U),
+      Field(&ModuleInformation::image_checksum, 0U),
+      Field(&ModuleInformation::time_date_stamp, 0U),
+      Field(&ModuleInformation::image_file_name, L"C:\\a.dll"))));
+  EXPECT_TRUE(parser.ProcessOneEvent(&event));
+}
+
 TEST_F(KernelLogConsumerTest, ImageEventsLog32Version0) {
   consumer_.set_is_64_bit_log(false);
   ExpectWaterDownModules();
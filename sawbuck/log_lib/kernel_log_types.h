@@ -30,6 +30,18 @@ enum {
   kLogFileHeaderEvent = 0,
 };
 
+// Real time sessions issue the events of this class to their consumers
+// where they lose events, buffers or their log file. The events carry no
+// data, their time stamp is that of the loss.
+DEFINE_GUID(kRtLostEventClass,
+  0x6a399ae0, 0x4bc6, 0x4de9, 0x87, 0x0b, 0x36, 0x57, 0xf8, 0x94, 0x7e, 0x7e);
+
+enum {
+  kRtLostEvent = 32,
+  kRtLostBuffer = 33,
+  kRtLostFile = 34,
+};
+
 struct LogFileHeader32 {
   ULONG BufferSize;
   ULONG Version;
@@ -197,6 +209,10 @@ enum {
   kProcessEndEvent = 2,
   kProcessIsRunningEvent = 3,
   kProcessCollectionEnded = 4,
+  // The memory counters of a process as it ends, and of each process
+  // running as the session's rundown starts and ends.
+  kProcessPerfCtrEvent = 32,
+  kProcessPerfCtrRundownEvent = 33,
 };
 
 DEFINE_GUID(kProcessEventClass,
@@ -294,6 +310,292 @@ struct ProcessInfo64V3 {
   // ImageFileName, ItemWString
 };
 
+// The memory counters of a process. The sizes are in bytes.
+struct ProcessPerfCtr32V2 {
+  ULONG ProcessId;  // ItemULong
+  ULONG PageFaultCount;  // ItemULong
+  ULONG HandleCount;  // ItemULong
+  ULONG Reserved;  // ItemULong
+  ULONG PeakVirtualSize;  // ItemPtr
+  ULONG PeakWorkingSetSize;  // ItemPtr
+  ULONG PeakPagefileUsage;  // ItemPtr
+  ULONG QuotaPeakPagedPoolUsage;  // ItemPtr
+  ULONG QuotaPeakNonPagedPoolUsage;  // ItemPtr
+  ULONG VirtualSize;  // ItemPtr
+  ULONG WorkingSetSize;  // ItemPtr
+  ULONG PagefileUsage;  // ItemPtr
+  ULONG QuotaPagedPoolUsage;  // ItemPtr
+  ULONG QuotaNonPagedPoolUsage;  // ItemPtr
+  ULONG PrivatePageCount;  // ItemPtr
+};
+
+struct ProcessPerfCtr64V2 {
+  ULONG ProcessId;  // ItemULong
+  ULONG PageFaultCount;  // ItemULong
+  ULONG HandleCount;  // ItemULong
+  ULONG Reserved;  // ItemULong
+  ULONGLONG PeakVirtualSize;  // ItemPtr
+  ULONGLONG PeakWorkingSetSize;  // ItemPtr
+  ULONGLONG PeakPagefileUsage;  // ItemPtr
+  ULONGLONG QuotaPeakPagedPoolUsage;  // ItemPtr
+  ULONGLONG QuotaPeakNonPagedPoolUsage;  // ItemPtr
+  ULONGLONG VirtualSize;  // ItemPtr
+  ULONGLONG WorkingSetSize;  // ItemPtr
+  ULONGLONG PagefileUsage;  // ItemPtr
+  ULONGLONG QuotaPagedPoolUsage;  // ItemPtr
+  ULONGLONG QuotaNonPagedPoolUsage;  // ItemPtr
+  ULONGLONG PrivatePageCount;  // ItemPtr
+};
+
+// Thread-related events.
+// These are documented-ish at
+// http://msdn.microsoft.com/en-us/library/aa364132(v=vs.85).aspx
+DEFINE_GUID(kThreadEventClass,
+  0x3d6fa8d1, 0xfe05, 0x11d0, 0x9d, 0xda, 0x00, 0xc0, 0x4f, 0xd7, 0xba, 0x7c);
+
+enum {
+  kThreadStartEvent = 1,
+  kThreadEndEvent = 2,
+  kThreadIsRunningEvent = 3,
+  kThreadCollectionEnded = 4,
+
+  kContextSwitchEvent = 36,
+  kReadyThreadEvent = 50,
+};
+
+// The start and end events of versions 1 through 3 lead with the ids,
+// on either bitness. What follows are the stack extents, start address
+// and the like, which we don't use.
+struct ThreadInfoPrefix {
+  ULONG ProcessId;  // ItemULong
+  ULONG ThreadId;  // ItemULong
+};
+
+// The scheduler events carry no pointers, so they're laid out the same on
+// either bitness. The processor is in the event's buffer context.
+struct ContextSwitchV2 {
+  ULONG NewThreadId;  // ItemULong
+  ULONG OldThreadId;  // ItemULong
+  CHAR NewThreadPriority;  // ItemChar
+  CHAR OldThreadPriority;  // ItemChar
+  UCHAR PreviousCState;  // ItemUChar
+  CHAR SpareByte;  // ItemChar
+  CHAR OldThreadWaitReason;  // ItemChar
+  CHAR OldThreadWaitMode;  // ItemChar
+  CHAR OldThreadState;  // ItemChar
+  CHAR OldThreadWaitIdealProcessor;  // ItemChar
+  ULONG NewThreadWaitTime;  // ItemULong
+  ULONG Reserved;  // ItemULong
+};
+
+struct ReadyThreadV2 {
+  ULONG ThreadId;  // ItemULong
+  CHAR AdjustReason;  // ItemChar
+  CHAR AdjustIncrement;  // ItemChar
+  CHAR Flag;  // ItemChar
+  CHAR Reserved;  // ItemChar
+};
+
+// Disk I/O events, issued as a disk read or write completes.
+DEFINE_GUID(kDiskIoEventClass,
+  0x3d6fa8d4, 0xfe05, 0x11d0, 0x9d, 0xda, 0x00, 0xc0, 0x4f, 0xd7, 0xba, 0x7c);
+
+enum {
+  kDiskIoReadEvent = 10,
+  kDiskIoWriteEvent = 11,
+};
+
+// Version 3 appends the issuing thread id, ItemULong, to these.
+struct DiskIo32V2 {
+  ULONG DiskNumber;  // ItemULong
+  ULONG IrpFlags;  // ItemULong
+  ULONG TransferSize;  // ItemULong
+  ULONG Reserved;  // ItemULong
+  ULONGLONG ByteOffset;  // ItemULongLong
+  ULONG FileObject;  // ItemPtr
+  ULONG Irp;  // ItemPtr
+  // The time from issue to completion, in performance counter ticks.
+  ULONGLONG HighResResponseTime;  // ItemULongLong
+};
+
+struct DiskIo64V2 {
+  ULONG DiskNumber;  // ItemULong
+  ULONG IrpFlags;  // ItemULong
+  ULONG TransferSize;  // ItemULong
+  ULONG Reserved;  // ItemULong
+  ULONGLONG ByteOffset;  // ItemULongLong
+  ULONGLONG FileObject;  // ItemPtr
+  ULONGLONG Irp;  // ItemPtr
+  ULONGLONG HighResResponseTime;  // ItemULongLong
+};
+
+// File I/O events. We only decode the name events, which tie the file
+// objects of the disk I/O events to file names.
+DEFINE_GUID(kFileIoEventClass,
+  0x90cbdc39, 0x4a3e, 0x11d1, 0x84, 0xf4, 0x00, 0x00, 0xf8, 0x04, 0x64, 0xe3);
+
+enum {
+  kFileIoNameEvent = 0,
+  kFileIoFileCreateEvent = 32,
+  kFileIoFileDeleteEvent = 35,
+  kFileIoFileRundownEvent = 36,
+};
+
+struct FileIoName32 {
+  ULONG FileObject;  // ItemPtr
+  wchar_t FileName[1];  // ItemWString
+};
+
+struct FileIoName64 {
+  ULONGLONG FileObject;  // ItemPtr
+  wchar_t FileName[1];  // ItemWString
+};
+
+// Profile interrupt events, issued for each sample of each processor when
+// the session enables EVENT_TRACE_FLAG_PROFILE.
+DEFINE_GUID(kPerfInfoEventClass,
+  0xce1dbfb4, 0x137e, 0x4da6, 0x87, 0xb0, 0x3f, 0x59, 0xaa, 0x10, 0x2c, 0xbc);
+
+enum {
+  kSampledProfileEvent = 46,
+};
+
+struct SampledProfile32V2 {
+  ULONG InstructionPointer;  // ItemPtr
+  ULONG ThreadId;  // ItemULong
+  USHORT Count;  // ItemUShort
+  USHORT Reserved;  // ItemUShort
+};
+
+struct SampledProfile64V2 {
+  ULONGLONG InstructionPointer;  // ItemPtr
+  ULONG ThreadId;  // ItemULong
+  USHORT Count;  // ItemUShort
+  USHORT Reserved;  // ItemUShort
+};
+
+// Stack walk events, which the kernel logs right after the events the
+// session asked for stacks of, on the same processor.
+DEFINE_GUID(kStackWalkEventClass,
+  0xdef2fe46, 0x7bd6, 0x4b80, 0xbd, 0x94, 0xf5, 0x7f, 0xe2, 0x0d, 0x0c, 0xe3);
+
+enum {
+  kStackWalkEvent = 32,
+};
+
+// The stack follows, as up to 192 pointers, innermost first.
+struct StackWalkPrefix {
+  // The raw time stamp of the event the stack is of.
+  ULONGLONG EventTimeStamp;  // ItemULongLong
+  ULONG StackProcess;  // ItemULong
+  ULONG StackThread;  // ItemULong
+};
+
+// Registry events, issued as each registry operation completes.
+DEFINE_GUID(kRegistryEventClass,
+  0xae53722e, 0xc863, 0x11d2, 0x86, 0x59, 0x00, 0xc0, 0x4f, 0xa3, 0x21, 0xa1);
+
+enum {
+  kRegistryCreateEvent = 10,
+  kRegistryOpenEvent = 11,
+  kRegistryDeleteEvent = 12,
+  kRegistryQueryEvent = 13,
+  kRegistrySetValueEvent = 14,
+  kRegistryDeleteValueEvent = 15,
+  kRegistryQueryValueEvent = 16,
+  kRegistryEnumerateKeyEvent = 17,
+  kRegistryEnumerateValueKeyEvent = 18,
+  kRegistryQueryMultipleValueEvent = 19,
+  kRegistrySetInformationEvent = 20,
+  kRegistryFlushEvent = 21,
+  // The key control block events tie the key handles of the others to
+  // full key paths.
+  kRegistryKcbCreateEvent = 22,
+  kRegistryKcbDeleteEvent = 23,
+  kRegistryKcbRundownBeginEvent = 24,
+  kRegistryKcbRundownEndEvent = 25,
+  kRegistryVirtualizeEvent = 26,
+  kRegistryCloseEvent = 27,
+  kRegistrySetSecurityEvent = 28,
+  kRegistryQuerySecurityEvent = 29,
+};
+
+struct Registry32V2 {
+  // The raw time stamp of the start of the operation.
+  LONGLONG InitialTime;  // ItemLongLong
+  ULONG Status;  // ItemULong
+  ULONG Index;  // ItemULong
+  // The key control block of the key the operation is on, or relative
+  // to.
+  ULONG KeyHandle;  // ItemPtr
+  wchar_t KeyName[1];  // ItemWString
+};
+
+struct Registry64V2 {
+  LONGLONG InitialTime;  // ItemLongLong
+  ULONG Status;  // ItemULong
+  ULONG Index;  // ItemULong
+  ULONGLONG KeyHandle;  // ItemPtr
+  wchar_t KeyName[1];  // ItemWString
+};
+
+// Heap events, which ntdll logs in the context of the allocating thread
+// for the processes heap tracing is enabled for.
+DEFINE_GUID(kHeapEventClass,
+  0x222962ab, 0x6180, 0x4b88, 0xa8, 0x25, 0x34, 0x6b, 0x75, 0xf2, 0xa2, 0x4a);
+
+enum {
+  kHeapCreateEvent = 32,
+  kHeapAllocEvent = 33,
+  kHeapReallocEvent = 34,
+  kHeapDestroyEvent = 35,
+  kHeapFreeEvent = 36,
+};
+
+struct HeapAlloc32V2 {
+  ULONG HeapHandle;  // ItemPtr
+  ULONG AllocSize;  // ItemPtr
+  ULONG AllocAddress;  // ItemPtr
+  ULONG SourceId;  // ItemULong
+};
+
+struct HeapAlloc64V2 {
+  ULONGLONG HeapHandle;  // ItemPtr
+  ULONGLONG AllocSize;  // ItemPtr
+  ULONGLONG AllocAddress;  // ItemPtr
+  ULONG SourceId;  // ItemULong
+};
+
+struct HeapRealloc32V2 {
+  ULONG HeapHandle;  // ItemPtr
+  ULONG NewAllocAddress;  // ItemPtr
+  ULONG OldAllocAddress;  // ItemPtr
+  ULONG NewAllocSize;  // ItemPtr
+  ULONG OldAllocSize;  // ItemPtr
+  ULONG SourceId;  // ItemULong
+};
+
+struct HeapRealloc64V2 {
+  ULONGLONG HeapHandle;  // ItemPtr
+  ULONGLONG NewAllocAddress;  // ItemPtr
+  ULONGLONG OldAllocAddress;  // ItemPtr
+  ULONGLONG NewAllocSize;  // ItemPtr
+  ULONGLONG OldAllocSize;  // ItemPtr
+  ULONG SourceId;  // ItemULong
+};
+
+struct HeapFree32V2 {
+  ULONG HeapHandle;  // ItemPtr
+  ULONG FreeAddress;  // ItemPtr
+  ULONG SourceId;  // ItemULong
+};
+
+struct HeapFree64V2 {
+  ULONGLONG HeapHandle;  // ItemPtr
+  ULONGLONG FreeAddress;  // ItemPtr
+  ULONG SourceId;  // ItemULong
+};
+
 }  // namespace kernel_log_types
 
 #endif  // SAWBUCK_LOG_LIB_KERNEL_LOG_TYPES_H_
@@ -0,0 +1,585 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Writes a large synthetic kernel log, to feed the benchmarks of the
+// module, process and page fault handling. Where make_test_data writes
+// a handful of events, this writes a storm of them:
+//   --processes=N       processes start, load their modules and exit.
+//   --concurrency=N     processes are alive at any one time.
+//   --modules=N         DLLs, each at an ASLR base of its own.
+//   --faults=N          page faults, taken by the modules' code.
+//   --hard-percent=N    the percentage of faults that are hard faults.
+//   --64-bit            the events have the 64 bit layouts. As the log
+//                       header says otherwise, consumers must be told.
+//   --seed=N            the seed of the storm, to repeat it exactly.
+// The events are logged through a provider of our own with the kernel's
+// event classes, as make_test_data does, so the modules the faults hit
+// are also loaded into our own process.
+//
+// Usage: kernel_storm [options] file.etl
+#include <windows.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "base/win/event_trace_controller.h"
+#include "base/win/event_trace_provider.h"
+#include "sawbuck/sym_util/types.h"
+
+#include <initguid.h>  // NOLINT - must precede only kernel_log_types.h.
+#include "sawbuck/log_lib/kernel_log_types.h"
+
+namespace {
+
+// {5A1B5C3E-7D0E-4F52-9C3A-2B86D1E0A4C7}
+DEFINE_GUID(kStormProviderName,
+    0x5a1b5c3e, 0x7d0e, 0x4f52,
+    0x9c, 0x3a, 0x2b, 0x86, 0xd1, 0xe0, 0xa4, 0xc7);
+
+const wchar_t kStormSessionName[] = L"Kernel Storm Session";
+
+const uint64 kPageSize = 0x1000;
+// Images are mapped at 64K granularity.
+const uint64 kAllocationGranularity = 0x10000;
+
+// Real system DLL names, before we make up numbered ones.
+const wchar_t* kModuleNames[] = {
+  L"ntdll.dll", L"kernel32.dll", L"KernelBase.dll", L"user32.dll",
+  L"gdi32.dll", L"advapi32.dll", L"msvcrt.dll", L"sechost.dll",
+  L"rpcrt4.dll", L"ole32.dll", L"oleaut32.dll", L"shell32.dll",
+  L"shlwapi.dll", L"comctl32.dll", L"ws2_32.dll", L"crypt32.dll",
+  L"winhttp.dll", L"wininet.dll", L"uxtheme.dll", L"dwmapi.dll",
+  L"imm32.dll", L"msctf.dll", L"version.dll", L"psapi.dll",
+  L"dbghelp.dll", L"winmm.dll", L"setupapi.dll", L"cfgmgr32.dll",
+};
+
+// Executables the processes are made to run.
+const char* kImageNames[] = {
+  "chrome.exe", "svchost.exe", "explorer.exe", "notepad.exe",
+  "cmd.exe", "conhost.exe", "devenv.exe", "cl.exe", "link.exe",
+  "python.exe", "taskhost.exe", "SearchIndexer.exe",
+};
+
+// Of every 100 soft faults, how many are of each type.
+const struct {
+  base::win::EtwEventType type;
+  int percent;
+} kFaultMix[] = {
+  { kernel_log_types::kTransitionFaultEvent, 45 },
+  { kernel_log_types::kDemandZeroFaultEvent, 35 },
+  { kernel_log_types::kCopyOnWriteEvent, 12 },
+  { kernel_log_types::kHardEvent, 5 },
+  { kernel_log_types::kGuardPageFaultEvent, 2 },
+  { kernel_log_types::kAccessViolationEvent, 1 },
+};
+
+struct StormOptions {
+  StormOptions()
+      : processes(5000), concurrency(64), modules(300), faults(2000000),
+        hard_percent(5), is_64_bit(false), seed(0x9E3779B9U) {
+  }
+
+  int processes;
+  int concurrency;
+  int modules;
+  int faults;
+  int hard_percent;
+  bool is_64_bit;
+  uint32 seed;
+};
+
+// Reads the int switch @p name into @p value, if present.
+// @returns false iff the switch is present but not a number in
+//     [@p min, @p max].
+bool GetIntSwitch(const CommandLine& cmd_line, const char* name, int min,
+                  int max, int* value) {
+  if (!cmd_line.HasSwitch(name))
+    return true;
+
+  return base::StringToInt(cmd_line.GetSwitchValueASCII(name), value) &&
+      min <= *value && *value <= max;
+}
+
+bool GetStormOptions(const CommandLine& cmd_line, StormOptions* options) {
+  if (!GetIntSwitch(cmd_line, "processes", 0, kint32max,
+                    &options->processes) ||
+      !GetIntSwitch(cmd_line, "concurrency", 1, 4096,
+                    &options->concurrency) ||
+      !GetIntSwitch(cmd_line, "modules", 1, 4096, &options->modules) ||
+      !GetIntSwitch(cmd_line, "faults", 0, kint32max, &options->faults) ||
+      !GetIntSwitch(cmd_line, "hard-percent", 0, 100,
+                    &options->hard_percent)) {
+    return false;
+  }
+
+  if (cmd_line.HasSwitch("seed") &&
+      !base::StringToUint(cmd_line.GetSwitchValueASCII("seed"),
+                          &options->seed)) {
+    return false;
+  }
+  // Xorshift is stuck at zero.
+  options->seed |= 1;
+  options->is_64_bit = cmd_line.HasSwitch("64-bit");
+
+  return true;
+}
+
+// A synthesized process and the modules it has loaded.
+struct StormProcess {
+  DWORD process_id;
+  DWORD parent_id;
+  DWORD session_id;
+  std::string image_name;
+  std::wstring command_line;
+  sym_util::ModuleInformation executable;
+  std::vector<size_t> modules;
+};
+
+// Generates the storm's events and logs them to |provider|.
+class KernelStorm {
+ public:
+  KernelStorm(base::win::EtwTraceProvider* provider,
+              const StormOptions& options);
+
+  // Logs the whole storm.
+  void Run();
+
+  size_t events_logged() const { return events_logged_; }
+  size_t events_retried() const { return events_retried_; }
+
+ private:
+  // Picks a value in [@p min, @p max].
+  uint32 Pick(uint32 min, uint32 max);
+
+  // Lays out the DLLs top down from a random base, as ASLR does.
+  void MakeModules();
+  void StartProcess(StormProcess* process);
+  void EndProcess(const StormProcess& process);
+  // Takes a fault in one of the modules of our own process.
+  void TakeFault();
+
+  // Logs the image event @p type of @p module in @p process_id.
+  void LogImageEvent(const sym_util::ModuleInformation& module,
+                     DWORD process_id,
+                     base::win::EtwEventType type);
+  template <class ImageLoadType, typename AddressType>
+  void LogImageEventImpl(const sym_util::ModuleInformation& module,
+                         DWORD process_id,
+                         base::win::EtwEventType type);
+
+  void LogProcessEvent(const StormProcess& process,
+                       DWORD exit_status,
+                       base::win::EtwEventType type);
+  template <class ProcessInfoType>
+  void LogProcessEventImpl(const StormProcess& process,
+                           DWORD exit_status,
+                           base::win::EtwEventType type);
+
+  template <class PageFaultType, typename AddressType>
+  void LogPageFault(base::win::EtwEventType type,
+                    uint64 address,
+                    uint64 program_counter);
+  template <class HardPageFaultType, typename AddressType>
+  void LogHardPageFault(uint64 address, uint64 file_object, uint64 offset);
+
+  // Logs @p event, waiting out the session's buffers filling up.
+  void Log(const EVENT_TRACE_HEADER* event);
+
+  base::win::EtwTraceProvider* provider_;
+  StormOptions options_;
+  // The state of our xorshift generator.
+  uint32 random_;
+
+  std::vector<sym_util::ModuleInformation> modules_;
+  // The storm's user, the local system.
+  BYTE user_sid_[SECURITY_MAX_SID_SIZE];
+  DWORD next_process_id_;
+
+  size_t events_logged_;
+  size_t events_retried_;
+
+  DISALLOW_COPY_AND_ASSIGN(KernelStorm);
+};
+
+KernelStorm::KernelStorm(base::win::EtwTraceProvider* provider,
+                         const StormOptions& options)
+    : provider_(provider), options_(options), random_(options.seed),
+      next_process_id_(1000), events_logged_(0), events_retried_(0) {
+  DCHECK(provider != NULL);
+
+  SID_IDENTIFIER_AUTHORITY nt_authority = SECURITY_NT_AUTHORITY;
+  CHECK(::InitializeSid(user_sid_, &nt_authority, 1));
+  *::GetSidSubAuthority(user_sid_, 0) = SECURITY_LOCAL_SYSTEM_RID;
+}
+
+uint32 KernelStorm::Pick(uint32 min, uint32 max) {
+  DCHECK_LE(min, max);
+  random_ ^= random_ << 13;
+  random_ ^= random_ >> 17;
+  random_ ^= random_ << 5;
+
+  // The full range wraps to an empty span.
+  uint32 span = max - min + 1;
+  return span == 0 ? random_ : min + random_ % span;
+}
+
+void KernelStorm::MakeModules() {
+  // The DLL region ends at a random point near the top of the address
+  // space, and the DLLs pack downwards from there with the odd gap.
+  uint64 next_top = options_.is_64_bit ? 0x7FF00000000ULL : 0x78000000ULL;
+  next_top -= Pick(0, 0xFF) * kAllocationGranularity;
+
+  for (int i = 0; i < options_.modules; ++i) {
+    sym_util::ModuleInformation module;
+    module.module_size =
+        static_cast<sym_util::ModuleSize>(Pick(4, 1024) * 4 * kPageSize);
+    uint64 size_rounded = (module.module_size + kAllocationGranularity - 1) &
+        ~(kAllocationGranularity - 1);
+    next_top -= size_rounded + Pick(0, 3) * kAllocationGranularity;
+    module.base_address = next_top;
+    module.image_checksum = Pick(0, kuint32max);
+    module.time_date_stamp = Pick(0x4A000000, 0x52000000);
+    if (static_cast<size_t>(i) < arraysize(kModuleNames)) {
+      module.image_file_name = L"C:\\Windows\\system32\\";
+      module.image_file_name += kModuleNames[i];
+    } else {
+      module.image_file_name = base::StringPrintf(
+          L"C:\\Program Files\\Storm\\storm_%04d.dll", i);
+    }
+    modules_.push_back(module);
+  }
+}
+
+void KernelStorm::Run() {
+  MakeModules();
+
+  // Our own process has all the modules loaded from the start, as they are
+  // where the faults happen.
+  const DWORD own_process_id = ::GetCurrentProcessId();
+  for (size_t i = 0; i < modules_.size(); ++i) {
+    LogImageEvent(modules_[i], own_process_id,
+                  kernel_log_types::kImageNotifyIsLoadedEvent);
+  }
+
+  // Spread the faults evenly over the process churn.
+  const int steps = std::max(options_.processes, 1);
+  std::vector<StormProcess> running;
+  int faults_taken = 0;
+  for (int i = 0; i < steps; ++i) {
+    if (i < options_.processes) {
+      // Make room for the new process by ending a random one.
+      if (running.size() >= static_cast<size_t>(options_.concurrency)) {
+        size_t victim = Pick(0, running.size() - 1);
+        EndProcess(running[victim]);
+        running[victim] = running.back();
+        running.pop_back();
+      }
+
+      StormProcess process;
+      process.parent_id = running.empty() ? own_process_id :
+          running[Pick(0, running.size() - 1)].process_id;
+      StartProcess(&process);
+      running.push_back(process);
+    }
+
+    int faults_due = static_cast<int>(
+        static_cast<int64>(options_.faults) * (i + 1) / steps);
+    for (; faults_taken < faults_due; ++faults_taken)
+      TakeFault();
+  }
+
+  for (size_t i = 0; i < running.size(); ++i)
+    EndProcess(running[i]);
+}
+
+void KernelStorm::StartProcess(StormProcess* process) {
+  DCHECK(process != NULL);
+
+  // Process ids are multiples of four, and recycled in time, but not
+  // before this storm ends.
+  process->process_id = next_process_id_;
+  next_process_id_ += 4;
+  process->session_id = Pick(0, 9) == 0 ? 0 : 1;
+  process->image_name = kImageNames[Pick(0, arraysize(kImageNames) - 1)];
+  process->command_line = base::StringPrintf(L"\"C:\\Storm\\%hs\" --id=%lu",
+                                             process->image_name.c_str(),
+                                             process->process_id);
+
+  // Executables are relocated anew for each process.
+  sym_util::ModuleInformation& exe = process->executable;
+  exe.base_address = (options_.is_64_bit ? 0x13F000000ULL : 0x00400000ULL) +
+      Pick(0, 0xFF) * kAllocationGranularity;
+  exe.module_size =
+      static_cast<sym_util::ModuleSize>(Pick(16, 4096) * kPageSize);
+  exe.image_checksum = Pick(0, kuint32max);
+  exe.time_date_stamp = Pick(0x4A000000, 0x52000000);
+  exe.image_file_name = L"C:\\Storm\\";
+  exe.image_file_name.append(process->image_name.begin(),
+                             process->image_name.end());
+
+  LogProcessEvent(*process, STILL_ACTIVE, kernel_log_types::kProcessStartEvent);
+  LogImageEvent(exe, process->process_id,
+                kernel_log_types::kImageNotifyLoadEvent);
+
+  // Every process has the first few system DLLs, and a random selection
+  // of the others.
+  const size_t num_system = std::min<size_t>(4, modules_.size());
+  for (size_t i = 0; i < num_system; ++i)
+    process->modules.push_back(i);
+  for (size_t i = num_system; i < modules_.size(); ++i) {
+    if (Pick(0, 9) == 0)
+      process->modules.push_back(i);
+  }
+  for (size_t i = 0; i < process->modules.size(); ++i) {
+    LogImageEvent(modules_[process->modules[i]], process->process_id,
+                  kernel_log_types::kImageNotifyLoadEvent);
+  }
+}
+
+void KernelStorm::EndProcess(const StormProcess& process) {
+  for (size_t i = process.modules.size(); i > 0; --i) {
+    LogImageEvent(modules_[process.modules[i - 1]], process.process_id,
+                  kernel_log_types::kImageNotifyUnloadEvent);
+  }
+  LogImageEvent(process.executable, process.process_id,
+                kernel_log_types::kImageNotifyUnloadEvent);
+  LogProcessEvent(process, ERROR_SUCCESS, kernel_log_types::kProcessEndEvent);
+}
+
+void KernelStorm::TakeFault() {
+  // Faults cluster in the first few modules, as they do in life.
+  size_t index = Pick(0, 3) == 0 ? Pick(0, modules_.size() - 1) :
+      Pick(0, std::min<size_t>(modules_.size(), 16) - 1);
+  const sym_util::ModuleInformation& module = modules_[index];
+  uint64 program_counter =
+      module.base_address + Pick(0, module.module_size - 1);
+
+  if (static_cast<int>(Pick(0, 99)) < options_.hard_percent) {
+    // Hard faults read the module's pages in from its image file.
+    uint64 offset = Pick(0, module.module_size - 1) & ~(kPageSize - 1);
+    uint64 file_object = 0x80000000ULL + index * 0x100;
+    if (options_.is_64_bit) {
+      LogHardPageFault<kernel_log_types::HardPageFault64V2, ULONGLONG>(
+          module.base_address + offset, file_object, offset);
+    } else {
+      LogHardPageFault<kernel_log_types::HardPageFault32V2, ULONG>(
+          module.base_address + offset, file_object, offset);
+    }
+    return;
+  }
+
+  // Half the soft faults are on the heap, the others in the module.
+  uint64 address = Pick(0, 1) == 0 ?
+      module.base_address + Pick(0, module.module_size - 1) :
+      0x01000000ULL + Pick(0, 0x0FFFFFFF);
+  uint32 mix = Pick(0, 99);
+  base::win::EtwEventType type = kFaultMix[0].type;
+  for (size_t i = 0; i < arraysize(kFaultMix); ++i) {
+    if (mix < static_cast<uint32>(kFaultMix[i].percent)) {
+      type = kFaultMix[i].type;
+      break;
+    }
+    mix -= kFaultMix[i].percent;
+  }
+
+  if (options_.is_64_bit) {
+    LogPageFault<kernel_log_types::PageFault64V2, ULONGLONG>(
+        type, address, program_counter);
+  } else {
+    LogPageFault<kernel_log_types::PageFault32V2, ULONG>(
+        type, address, program_counter);
+  }
+}
+
+void KernelStorm::LogImageEvent(const sym_util::ModuleInformation& module,
+                                DWORD process_id,
+                                base::win::EtwEventType type) {
+  if (options_.is_64_bit) {
+    LogImageEventImpl<kernel_log_types::ImageLoad64V2, ULONGLONG>(
+        module, process_id, type);
+  } else {
+    LogImageEventImpl<kernel_log_types::ImageLoad32V2, ULONG>(
+        module, process_id, type);
+  }
+}
+
+template <class ImageLoadType, typename AddressType>
+void KernelStorm::LogImageEventImpl(const sym_util::ModuleInformation& module,
+                                    DWORD process_id,
+                                    base::win::EtwEventType type) {
+  ImageLoadType load = {};
+  load.BaseAddress = static_cast<AddressType>(module.base_address);
+  load.ModuleSize = module.module_size;
+  load.ProcessId = process_id;
+  load.ImageChecksum = module.image_checksum;
+  load.TimeDateStamp = module.time_date_stamp;
+
+  base::win::EtwMofEvent<2> evt(kernel_log_types::kImageLoadEventClass,
+                                type,
+                                2,  // version
+                                TRACE_LEVEL_INFORMATION);
+  evt.SetField(0, FIELD_OFFSET(ImageLoadType, ImageFileName), &load);
+  evt.SetField(1,
+               sizeof(wchar_t) * (module.image_file_name.size() + 1),
+               module.image_file_name.c_str());
+  Log(evt.get());
+}
+
+void KernelStorm::LogProcessEvent(const StormProcess& process,
+                                  DWORD exit_status,
+                                  base::win::EtwEventType type) {
+  if (options_.is_64_bit) {
+    LogProcessEventImpl<kernel_log_types::ProcessInfo64V3>(process,
+                                                           exit_status, type);
+  } else {
+    LogProcessEventImpl<kernel_log_types::ProcessInfo32V3>(process,
+                                                           exit_status, type);
+  }
+}
+
+template <class ProcessInfoType>
+void KernelStorm::LogProcessEventImpl(const StormProcess& process,
+                                      DWORD exit_status,
+                                      base::win::EtwEventType type) {
+  ProcessInfoType info = {};
+  info.ProcessId = process.process_id;
+  info.ParentId = process.parent_id;
+  info.SessionId = process.session_id;
+  info.ExitStatus = exit_status;
+
+  base::win::EtwMofEvent<4> evt(kernel_log_types::kProcessEventClass,
+                                type,
+                                3,  // version
+                                TRACE_LEVEL_INFORMATION);
+  evt.SetField(0, FIELD_OFFSET(ProcessInfoType, UserSID), &info);
+  evt.SetField(1, ::GetLengthSid(user_sid_), user_sid_);
+  evt.SetField(2,
+               process.image_name.length() + 1,
+               process.image_name.c_str());
+  evt.SetField(3,
+               (process.command_line.length() + 1) * sizeof(wchar_t),
+               process.command_line.c_str());
+  Log(evt.get());
+}
+
+template <class PageFaultType, typename AddressType>
+void KernelStorm::LogPageFault(base::win::EtwEventType type,
+                               uint64 address,
+                               uint64 program_counter) {
+  PageFaultType fault = {};
+  fault.VirtualAddress = static_cast<AddressType>(address);
+  fault.ProgramCounter = static_cast<AddressType>(program_counter);
+
+  base::win::EtwMofEvent<1> evt(kernel_log_types::kPageFaultEventClass,
+                                type,
+                                2,  // version
+                                TRACE_LEVEL_INFORMATION);
+  evt.SetField(0, sizeof(fault), &fault);
+  Log(evt.get());
+}
+
+template <class HardPageFaultType, typename AddressType>
+void KernelStorm::LogHardPageFault(uint64 address,
+                                   uint64 file_object,
+                                   uint64 offset) {
+  // The read started a little before it completed.
+  FILETIME initial_time = (base::Time::Now() -
+      base::TimeDelta::FromMicroseconds(Pick(50, 20000))).ToFileTime();
+
+  HardPageFaultType fault = {};
+  fault.InitialTime = reinterpret_cast<ULONGLONG&>(initial_time);
+  fault.ReadOffset = offset;
+  fault.VirtualAddress = static_cast<AddressType>(address);
+  fault.FileObject = static_cast<AddressType>(file_object);
+  fault.ThreadId = ::GetCurrentThreadId();
+  fault.ByteCount = static_cast<ULONG>(Pick(1, 8) * kPageSize);
+
+  base::win::EtwMofEvent<1> evt(kernel_log_types::kPageFaultEventClass,
+                                kernel_log_types::kHardPageFaultEvent,
+                                2,  // version
+                                TRACE_LEVEL_INFORMATION);
+  evt.SetField(0, sizeof(fault), &fault);
+  Log(evt.get());
+}
+
+void KernelStorm::Log(const EVENT_TRACE_HEADER* event) {
+  // A storm outruns the session's writer, which is no reason to lose
+  // events, so wait for buffers to free up.
+  while (provider_->Log(event) == ERROR_NOT_ENOUGH_MEMORY) {
+    ++events_retried_;
+    ::Sleep(1);
+  }
+  ++events_logged_;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  CommandLine::Init(argc, argv);
+
+  const CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  StormOptions options;
+  std::vector<std::wstring> args = cmd_line->GetArgs();
+  if (!GetStormOptions(*cmd_line, &options) || args.size() != 1) {
+    printf("Usage: kernel_storm [--processes=N] [--concurrency=N] "
+           "[--modules=N] [--faults=N]\n"
+           "           [--hard-percent=N] [--64-bit] [--seed=N] file.etl\n");
+    return 1;
+  }
+
+  // Stop any dangling session of a previous, crashing run.
+  base::win::EtwTraceProperties props;
+  base::win::EtwTraceController::Stop(kStormSessionName, &props);
+
+  base::win::EtwTraceController controller;
+  HRESULT hr = controller.StartFileSession(kStormSessionName,
+                                           args[0].c_str(),
+                                           false);
+  if (SUCCEEDED(hr)) {
+    hr = controller.EnableProvider(kStormProviderName,
+                                   TRACE_LEVEL_VERBOSE,
+                                   0xFFFFFFFF);
+  }
+  if (FAILED(hr)) {
+    printf("Error 0x%08X starting the file session.\n", hr);
+    return 1;
+  }
+
+  base::win::EtwTraceProvider provider(kStormProviderName);
+  provider.Register();
+
+  KernelStorm storm(&provider, options);
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  storm.Run();
+  base::TimeDelta elapsed = base::TimeTicks::HighResNow() - start;
+  controller.Stop(NULL);
+
+  printf("%u events logged in %.2fs, %u waits for buffers, to \"%ls\".\n",
+         static_cast<unsigned>(storm.events_logged()),
+         elapsed.InSecondsF(),
+         static_cast<unsigned>(storm.events_retried()),
+         args[0].c_str());
+  if (options.is_64_bit)
+    printf("The events have the 64 bit layouts, pass --64-bit-log.\n");
+
+  return 0;
+}
@@ -0,0 +1,110 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Latency histogram implementation.
+#include "sawbuck/log_lib/latency_histogram.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+const int LatencyHistogram::kSubBucketBits;
+const int LatencyHistogram::kSubBuckets;
+const int LatencyHistogram::kMaxValueBits;
+const size_t LatencyHistogram::kMaxBuckets;
+
+LatencyHistogram::LatencyHistogram()
+    : count_(0), total_us_(0), max_us_(0) {
+}
+
+LatencyHistogram::~LatencyHistogram() {
+}
+
+void LatencyHistogram::Add(const base::TimeDelta& latency) {
+  int64 value = std::max(latency.InMicroseconds(), static_cast<int64>(0));
+
+  size_t bucket = GetBucket(value);
+  if (bucket >= buckets_.size())
+    buckets_.resize(bucket + 1);
+  ++buckets_[bucket];
+
+  ++count_;
+  total_us_ += value;
+  max_us_ = std::max(max_us_, value);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  if (other.buckets_.size() > buckets_.size())
+    buckets_.resize(other.buckets_.size());
+  for (size_t i = 0; i < other.buckets_.size(); ++i)
+    buckets_[i] += other.buckets_[i];
+
+  count_ += other.count_;
+  total_us_ += other.total_us_;
+  max_us_ = std::max(max_us_, other.max_us_);
+}
+
+base::TimeDelta LatencyHistogram::GetPercentile(double percentile) const {
+  if (count_ == 0)
+    return base::TimeDelta();
+
+  // The rank of the sample we're after, at least the first.
+  percentile = std::min(std::max(percentile, 0.0), 100.0);
+  uint64 rank = static_cast<uint64>(count_ * percentile / 100.0 + 0.5);
+  rank = std::max(rank, static_cast<uint64>(1));
+
+  uint64 seen = 0;
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    seen += buckets_[i];
+    if (seen < rank)
+      continue;
+
+    // The top bucket also holds everything past it.
+    if (i == kMaxBuckets - 1)
+      return max();
+    return base::TimeDelta::FromMicroseconds(
+        std::min(GetBucketMax(i), max_us_));
+  }
+
+  NOTREACHED() << "The buckets don't add up to the count";
+  return max();
+}
+
+size_t LatencyHistogram::GetBucket(int64 value) {
+  DCHECK_LE(0, value);
+
+  const int64 kMaxValue = (static_cast<int64>(1) << kMaxValueBits) - 1;
+  value = std::min(value, kMaxValue);
+  if (value < kSubBuckets)
+    return static_cast<size_t>(value);
+
+  // Find the top bit, the sub-bucket bits follow it.
+  int top_bit = kSubBucketBits;
+  while ((value >> (top_bit + 1)) != 0)
+    ++top_bit;
+
+  int shift = top_bit - kSubBucketBits;
+  size_t sub_bucket = static_cast<size_t>(value >> shift) - kSubBuckets;
+  return (shift + 1) * kSubBuckets + sub_bucket;
+}
+
+int64 LatencyHistogram::GetBucketMax(size_t bucket) {
+  DCHECK_LT(bucket, kMaxBuckets);
+
+  if (bucket < static_cast<size_t>(kSubBuckets))
+    return bucket;
+
+  int shift = static_cast<int>(bucket / kSubBuckets) - 1;
+  int64 sub_bucket = kSubBuckets + bucket % kSubBuckets;
+  return ((sub_bucket + 1) << shift) - 1;
+}
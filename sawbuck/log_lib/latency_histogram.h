@@ -0,0 +1,72 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Latency histogram declaration.
+#ifndef SAWBUCK_LOG_LIB_LATENCY_HISTOGRAM_H_
+#define SAWBUCK_LOG_LIB_LATENCY_HISTOGRAM_H_
+
+#include <vector>
+#include "base/basictypes.h"
+#include "base/time/time.h"
+
+// A histogram of latencies with log-linear buckets, in the manner of an
+// HDR histogram. Each power of two of microseconds is split into
+// kSubBuckets linear buckets, so a percentile is good to within one
+// kSubBuckets'th of its value, and the histogram never takes more than
+// kMaxBuckets counters however many samples it sees.
+class LatencyHistogram {
+ public:
+  static const int kSubBucketBits = 3;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  // The largest latency we tell apart, about 12 days in microseconds,
+  // and the number of buckets it takes to get there.
+  static const int kMaxValueBits = 40;
+  static const size_t kMaxBuckets =
+      (kMaxValueBits - kSubBucketBits + 1) * kSubBuckets;
+
+  LatencyHistogram();
+  ~LatencyHistogram();
+
+  // Adds a sample of @p latency, negative latencies count as zero.
+  void Add(const base::TimeDelta& latency);
+
+  // Adds the samples of @p other to ours.
+  void Merge(const LatencyHistogram& other);
+
+  // @returns the latency no more than @p percentile percent of the samples
+  //     exceed, to the precision of the buckets, or zero if there are none.
+  base::TimeDelta GetPercentile(double percentile) const;
+
+  uint64 count() const { return count_; }
+  base::TimeDelta total() const {
+    return base::TimeDelta::FromMicroseconds(total_us_);
+  }
+  base::TimeDelta max() const {
+    return base::TimeDelta::FromMicroseconds(max_us_);
+  }
+
+ private:
+  // @returns the bucket of @p value, in microseconds.
+  static size_t GetBucket(int64 value);
+  // @returns the largest value in @p bucket, in microseconds.
+  static int64 GetBucketMax(size_t bucket);
+
+  // Grown to the highest bucket with a sample.
+  std::vector<uint32> buckets_;
+  uint64 count_;
+  int64 total_us_;
+  int64 max_us_;
+};
+
+#endif  // SAWBUCK_LOG_LIB_LATENCY_HISTOGRAM_H_
@@ -0,0 +1,90 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Latency histogram unittests.
+#include "sawbuck/log_lib/latency_histogram.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+base::TimeDelta Us(int64 us) {
+  return base::TimeDelta::FromMicroseconds(us);
+}
+
+}  // namespace
+
+TEST(LatencyHistogramTest, Empty) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(0U, histogram.count());
+  EXPECT_EQ(0, histogram.GetPercentile(50).InMicroseconds());
+  EXPECT_EQ(0, histogram.max().InMicroseconds());
+}
+
+TEST(LatencyHistogramTest, SmallValuesAreExact) {
+  LatencyHistogram histogram;
+  for (int64 i = 1; i <= 7; ++i)
+    histogram.Add(Us(i));
+
+  EXPECT_EQ(7U, histogram.count());
+  EXPECT_EQ(28, histogram.total().InMicroseconds());
+  EXPECT_EQ(1, histogram.GetPercentile(0).InMicroseconds());
+  EXPECT_EQ(4, histogram.GetPercentile(50).InMicroseconds());
+  EXPECT_EQ(7, histogram.GetPercentile(100).InMicroseconds());
+}
+
+TEST(LatencyHistogramTest, Percentiles) {
+  LatencyHistogram histogram;
+  // 1 to 1000 ms.
+  for (int64 i = 1; i <= 1000; ++i)
+    histogram.Add(Us(i * 1000));
+
+  EXPECT_EQ(1000U, histogram.count());
+  EXPECT_EQ(1000000, histogram.max().InMicroseconds());
+
+  // The percentiles are no less than the truth, and within an eighth of it.
+  int64 p50 = histogram.GetPercentile(50).InMicroseconds();
+  EXPECT_LE(500000, p50);
+  EXPECT_GE(500000 + 500000 / 8, p50);
+  int64 p99 = histogram.GetPercentile(99).InMicroseconds();
+  EXPECT_LE(990000, p99);
+  EXPECT_GE(990000 + 990000 / 8, p99);
+  // No percentile exceeds the largest sample.
+  EXPECT_EQ(1000000, histogram.GetPercentile(100).InMicroseconds());
+}
+
+TEST(LatencyHistogramTest, Bounded) {
+  LatencyHistogram histogram;
+  histogram.Add(Us(-10));
+  histogram.Add(base::TimeDelta::FromDays(365));
+
+  EXPECT_EQ(2U, histogram.count());
+  EXPECT_EQ(0, histogram.GetPercentile(50).InMicroseconds());
+  EXPECT_EQ(base::TimeDelta::FromDays(365), histogram.GetPercentile(100));
+}
+
+TEST(LatencyHistogramTest, Merge) {
+  LatencyHistogram histogram;
+  LatencyHistogram other;
+  histogram.Add(Us(1));
+  other.Add(Us(100));
+  other.Add(Us(200));
+
+  histogram.Merge(other);
+  EXPECT_EQ(3U, histogram.count());
+  EXPECT_EQ(301, histogram.total().InMicroseconds());
+  EXPECT_EQ(200, histogram.max().InMicroseconds());
+  int64 p50 = histogram.GetPercentile(50).InMicroseconds();
+  EXPECT_LE(100, p50);
+  EXPECT_GE(100 + 100 / 8, p50);
+}
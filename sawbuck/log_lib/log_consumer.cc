@@ -15,16 +15,250 @@
 // Log consumer implementation.
 #include "sawbuck/log_lib/log_consumer.h"
 
+#include "base/bind.h"
+#include "base/lazy_instance.h"
 #include "base/debug/trace_event_win.h"
 #include "base/logging.h"
 #include "base/logging_win.h"
+#include "base/message_loop/message_loop.h"
+#include "base/stl_util.h"
+#include "base/threading/thread_local.h"
 #include "sawbuck/common/buffer_parser.h"
+#include "sawbuck/common/record_decoder.h"
+#include "sawbuck/log_lib/event_rate_stats.h"
+#include "sawbuck/log_lib/event_router.h"
+#include "sawbuck/log_lib/event_slab.h"
+#include "sawbuck/log_lib/kernel_log_types.h"
+#include "sawbuck/log_lib/tdh_event_decoder.h"
 #include <initguid.h>  // NOLINT - must be last include.
 
-LogParser::LogParser() : log_event_sink_(NULL), trace_event_sink_(NULL) {
+namespace {
+
+// The trace event version we know the layout of. Later versions append to
+// its layout, so their events are parsed by the known prefix.
+const USHORT kTraceEventVersion = 0;
+
+// Decodes a trace event, whose id has the pointer size of the process that
+// logged it. The format is the name as a zero-terminated string, the id,
+// and the extra data as a zero-terminated string.
+template <class IdType>
+bool DecodeTraceEvent(BinaryBufferReader* reader,
+                      TraceEvents::TraceMessage* trace) {
+  typedef RecordDecoder<CString<char>,
+                        Field<IdType>,
+                        CString<char> > Decoder;
+  CString<char>::Value name;
+  const IdType* id = NULL;
+  CString<char>::Value extra;
+  if (!Decoder::Decode(reader, &name, &id, &extra))
+    return false;
+
+  DCHECK(id != NULL);
+  trace->name = name.str;
+  trace->name_len = name.len;
+  // The ids are opaque, so a 64 bit id may be truncated in a 32 bit build.
+  trace->id = reinterpret_cast<void*>(static_cast<uintptr_t>(*id));
+  trace->extra = extra.str;
+  trace->extra_len = extra.len;
+  return true;
+}
+
+// @returns the size of the stack frames of the log event of @p data_len
+//     bytes at @p data, which is a stack trace, @p gap bytes, and
+//     @p num_strings zero terminated strings. The frames have the pointer
+//     size of the process that logged the event, which the event doesn't
+//     tell otherwise. They're taken to be 32 bit iff that layout accounts
+//     for the event exactly. A 64 bit frame never passes for a 32 bit frame
+//     and the start of a string, as the top bytes of user mode addresses
+//     are zero.
+size_t GetStackFrameSize(const void* data, size_t data_len, size_t gap,
+                         size_t num_strings) {
+  const char* bytes = reinterpret_cast<const char*>(data);
+  if (data_len < sizeof(DWORD))
+    return sizeof(uint64);
+
+  // Without frames, the size makes no difference.
+  size_t depth = *reinterpret_cast<const DWORD*>(bytes);
+  if (depth == 0)
+    return sizeof(void*);
+
+  size_t pos = sizeof(DWORD);
+  if (depth > (data_len - pos) / sizeof(uint32))
+    return sizeof(uint64);
+
+  pos += depth * sizeof(uint32) + gap;
+  for (size_t i = 0; i < num_strings; ++i) {
+    if (pos >= data_len)
+      return sizeof(uint64);
+    const void* end = memchr(bytes + pos, 0, data_len - pos);
+    if (end == NULL)
+      return sizeof(uint64);
+    pos = reinterpret_cast<const char*>(end) - bytes + 1;
+  }
+
+  return pos == data_len ? sizeof(uint32) : sizeof(uint64);
+}
+
+// Points @p msg at the @p depth frames at @p frames, converting them to
+// our pointer size in a new element of @p converted if they're of another.
+// A 64 bit frame is truncated in a 32 bit build, as it can't be resolved
+// there anyway.
+template <class FrameType>
+void SetStackTrace(const FrameType* frames, size_t depth,
+                   std::deque<std::vector<void*> >* converted,
+                   LogEvents::LogMessage* msg) {
+  msg->trace_depth = depth;
+  if (sizeof(FrameType) == sizeof(void*)) {
+    msg->traces = reinterpret_cast<void* const*>(frames);
+    return;
+  }
+
+  converted->push_back(std::vector<void*>(depth));
+  std::vector<void*>& trace = converted->back();
+  for (size_t i = 0; i < depth; ++i)
+    trace[i] = reinterpret_cast<void*>(static_cast<uintptr_t>(frames[i]));
+  msg->traces = depth == 0 ? NULL : &trace[0];
+}
+
+// Decodes the @p log_fields of a LOG_MESSAGE_WITH_STACKTRACE event, whose
+// frames are of FrameType, from @p reader into @p msg.
+// The format of the binary log message is:
+// 1. A DWORD containing the stack trace depth.
+// 2. The trace, "depth" in number.
+// 3. The log message as a zero-terminated string.
+// The trace is skipped by its depth when only the message is wanted.
+template <class FrameType>
+bool DecodeStackTraceMessage(BinaryBufferReader* reader, uint32 log_fields,
+                             std::deque<std::vector<void*> >* converted,
+                             LogEvents::LogMessage* msg) {
+  typedef RecordDecoder<CountedArray<FrameType>,
+                        CString<char> > Decoder;
+  typedef RecordDecoder<CountedArray<FrameType> > TraceDecoder;
+  typename CountedArray<FrameType>::Value trace;
+  CString<char>::Value message;
+  bool want_trace = (log_fields & LogEvents::FIELD_STACK_TRACE) != 0;
+  bool want_message = (log_fields & LogEvents::FIELD_MESSAGE) != 0;
+  bool decoded = true;
+  if (want_message)
+    decoded = Decoder::Decode(reader, &trace, &message);
+  else if (want_trace)
+    decoded = TraceDecoder::Decode(reader, &trace);
+  if (!decoded)
+    return false;
+
+  if (want_trace)
+    SetStackTrace(trace.data, trace.count, converted, msg);
+  msg->message = message.str;
+  msg->message_len = message.len;
+  return true;
+}
+
+// Decodes the @p log_fields of a LOG_MESSAGE_FULL event, whose frames are
+// of FrameType, from @p reader into @p msg, but for the file atom.
+// The format of the binary log message is:
+// 1. A DWORD containing the stack trace depth.
+// 2. The trace, "depth" in number.
+// 3. The line as a 4 byte integer value.
+// 4. The file as a zero-terminated string.
+// 5. The log message as a zero-terminated string.
+// The fields are decoded up to the last one wanted, the trace is skipped
+// by its depth, and the file's terminator is only looked for when the
+// file or the message is wanted.
+template <class FrameType>
+bool DecodeFullMessage(BinaryBufferReader* reader, uint32 log_fields,
+                       std::deque<std::vector<void*> >* converted,
+                       LogEvents::LogMessage* msg) {
+  typedef RecordDecoder<CountedArray<FrameType>,
+                        Field<DWORD>,
+                        CString<char>,
+                        CString<char> > Decoder;
+  typedef RecordDecoder<CountedArray<FrameType>,
+                        Field<DWORD>,
+                        CString<char> > FileDecoder;
+  typedef RecordDecoder<CountedArray<FrameType> > TraceDecoder;
+  typename CountedArray<FrameType>::Value trace;
+  const DWORD* line = NULL;
+  CString<char>::Value file;
+  CString<char>::Value message;
+  bool want_trace = (log_fields & LogEvents::FIELD_STACK_TRACE) != 0;
+  bool want_file = (log_fields & LogEvents::FIELD_FILE_LINE) != 0;
+  bool want_message = (log_fields & LogEvents::FIELD_MESSAGE) != 0;
+  bool decoded = true;
+  if (want_message)
+    decoded = Decoder::Decode(reader, &trace, &line, &file, &message);
+  else if (want_file)
+    decoded = FileDecoder::Decode(reader, &trace, &line, &file);
+  else if (want_trace)
+    decoded = TraceDecoder::Decode(reader, &trace);
+  if (!decoded)
+    return false;
+
+  if (want_trace)
+    SetStackTrace(trace.data, trace.count, converted, msg);
+  if (want_file) {
+    msg->line = *line;
+    msg->file = file.str;
+    msg->file_len = file.len;
+  }
+  msg->message = message.str;
+  msg->message_len = message.len;
+  return true;
+}
+
+}  // namespace
+
+void LogEvents::OnLogMessages(const LogMessage* log_messages,
+                              size_t num_messages) {
+  for (size_t i = 0; i < num_messages; ++i)
+    OnLogMessage(log_messages[i]);
+}
+
+void LogEvents::OnEventLoss(const EventLoss& event_loss) {
+}
+
+LogParser::LogParser()
+    : log_event_sink_(NULL), trace_event_sink_(NULL), string_table_(NULL),
+      generic_decoder_(NULL), log_fields_(LogEvents::ALL_FIELDS),
+      batch_log_messages_(false), filtered_event_count_(0),
+      unknown_trace_event_count_(0), newer_trace_event_count_(0) {
+}
+
+LogParser::EventFilter::EventFilter()
+    : process_id(0), max_level(0xFF) {
 }
 
 LogParser::~LogParser() {
+  DCHECK(pending_log_messages_.empty());
+}
+
+void LogParser::FlushLogMessages() {
+  if (pending_log_messages_.empty())
+    return;
+
+  DCHECK(log_event_sink_ != NULL);
+  log_event_sink_->OnLogMessages(&pending_log_messages_[0],
+                                 pending_log_messages_.size());
+  pending_log_messages_.clear();
+  generic_messages_.clear();
+  converted_traces_.clear();
+}
+
+void LogParser::DeliverEventLoss(const LogEvents::EventLoss& event_loss) {
+  if (log_event_sink_ == NULL)
+    return;
+
+  // Keep the loss in order with the log messages.
+  FlushLogMessages();
+  log_event_sink_->OnEventLoss(event_loss);
+}
+
+void LogParser::DeliverLogMessage(const LogEvents::LogMessage& log_message) {
+  if (batch_log_messages_) {
+    pending_log_messages_.push_back(log_message);
+  } else {
+    log_event_sink_->OnLogMessage(log_message);
+    converted_traces_.clear();
+  }
 }
 
 bool LogParser::ProcessOneEvent(EVENT_TRACE* event) {
@@ -33,13 +267,56 @@ bool LogParser::ProcessOneEvent(EVENT_TRACE* event) {
   // Is it a log message?
   if (event->Header.Guid == logging::kLogEventId) {
     return ParseLogEvent(event);
-  } else if (event->Header.Guid == base::debug::kTraceEventClass32) {
+  } else if (event->Header.Guid == base::debug::kTraceEventClass32 ||
+             event->Header.Guid == base::debug::kTraceEventClass64) {
     return ParseTraceEvent(event);
+  } else if (event->Header.Guid == kernel_log_types::kRtLostEventClass) {
+    return ParseLostEvent(event);
+  } else if (generic_decoder_ != NULL) {
+    return ParseGenericEvent(event);
   }
 
   return false;
 }
 
+bool LogParser::PassesFilter(const EVENT_TRACE* event,
+                             const base::Time& time) {
+  if (first_event_time_.is_null())
+    first_event_time_ = time;
+
+  const EventFilter& filter = event_filter_;
+  base::TimeDelta since_first = time - first_event_time_;
+  bool passes = event->Header.Class.Level <= filter.max_level &&
+      (filter.process_id == 0 ||
+       event->Header.ProcessId == filter.process_id) &&
+      since_first >= filter.from &&
+      (filter.to == base::TimeDelta() || since_first <= filter.to);
+  if (!passes)
+    ++filtered_event_count_;
+
+  return passes;
+}
+
+void LogParser::AddEventClasses(EventRouter* router) {
+  DCHECK(router != NULL);
+  router->AddEventClass(logging::kLogEventId,
+      base::Bind(&LogParser::ParseLogEvent, base::Unretained(this)));
+  router->AddEventClass(base::debug::kTraceEventClass32,
+      base::Bind(&LogParser::ParseTraceEvent, base::Unretained(this)));
+  router->AddEventClass(base::debug::kTraceEventClass64,
+      base::Bind(&LogParser::ParseTraceEvent, base::Unretained(this)));
+  router->AddEventClass(kernel_log_types::kRtLostEventClass,
+      base::Bind(&LogParser::ParseLostEvent, base::Unretained(this)));
+}
+
+void LogParser::AddGenericEventClass(const GUID& provider,
+                                     EventRouter* router) {
+  DCHECK(router != NULL);
+  DCHECK(generic_decoder_ != NULL);
+  router->AddEventClass(provider,
+      base::Bind(&LogParser::ParseGenericEvent, base::Unretained(this)));
+}
+
 bool LogParser::ParseLogEvent(EVENT_TRACE* event) {
   DCHECK(event != NULL);
 
@@ -52,14 +329,21 @@ bool LogParser::ParseLogEvent(EVENT_TRACE* event) {
 
   msg.time = base::Time::FromFileTime(
       reinterpret_cast<FILETIME&>(event->Header.TimeStamp));
+  // The event is ours, so it's handled even if it's filtered out.
+  if (!PassesFilter(event, msg.time))
+    return true;
+
   msg.level = event->Header.Class.Level;
   msg.process_id = event->Header.ProcessId;
   msg.thread_id = event->Header.ThreadId;
 
+  bool want_trace = (log_fields_ & LogEvents::FIELD_STACK_TRACE) != 0;
+  bool want_message = (log_fields_ & LogEvents::FIELD_MESSAGE) != 0;
   if (event->Header.Class.Type == logging::LOG_MESSAGE &&
       event->Header.Class.Version == 0) {
-    if (reader.ReadString(&msg.message, &msg.message_len)) {
-      log_event_sink_->OnLogMessage(msg);
+    if (!want_message ||
+        reader.ReadString(&msg.message, &msg.message_len)) {
+      DeliverLogMessage(msg);
     } else {
       DLOG(ERROR) << "Failed to read message from event";
     }
@@ -68,16 +352,20 @@ bool LogParser::ParseLogEvent(EVENT_TRACE* event) {
   } else if (event->Header.Class.Type ==
       logging::LOG_MESSAGE_WITH_STACKTRACE &&
       event->Header.Class.Version == 0) {
-    // The format of the binary log message is:
-    // 1. A DWORD containing the stack trace depth.
-    // 2. The trace, "depth" in number.
-    // 3. The log message as a zero-terminated string.
-    const DWORD* depth = NULL;
-    if (reader.Read(&depth) &&
-        reader.Read(*depth * sizeof(void*), &msg.traces) &&
-        reader.ReadString(&msg.message, &msg.message_len)) {
-      msg.trace_depth = *depth;
-      log_event_sink_->OnLogMessage(msg);
+    // The frame size only matters to what's past the depth.
+    bool decoded = true;
+    if (want_trace || want_message) {
+      if (GetStackFrameSize(event->MofData, event->MofLength, 0, 1) ==
+          sizeof(uint32)) {
+        decoded = DecodeStackTraceMessage<uint32>(
+            &reader, log_fields_, &converted_traces_, &msg);
+      } else {
+        decoded = DecodeStackTraceMessage<uint64>(
+            &reader, log_fields_, &converted_traces_, &msg);
+      }
+    }
+    if (decoded) {
+      DeliverLogMessage(msg);
     } else {
       DLOG(ERROR) << "Failed to read stack trace or message from event";
     }
@@ -86,23 +374,8 @@ bool LogParser::ParseLogEvent(EVENT_TRACE* event) {
     return true;
   } else if (event->Header.Class.Type == logging::LOG_MESSAGE_FULL &&
              event->Header.Class.Version == 0) {
-    // The format of the binary log message is:
-    // 1. A DWORD containing the stack trace depth.
-    // 2. The trace, "depth" in number.
-    // 3. The line as a 4 byte integer value.
-    // 4. The file as a zero-terminated string.
-    // 5. The log message as a zero-terminated string.
-    const DWORD* depth = NULL;
-    const DWORD* line = NULL;
-    if (reader.Read(&depth) &&
-        reader.Read(*depth * sizeof(void*), &msg.traces) &&
-        reader.Read(&line) &&
-        reader.ReadString(&msg.file, &msg.file_len) &&
-        reader.ReadString(&msg.message, &msg.message_len)) {
-      msg.trace_depth = *depth;
-      msg.line = *line;
-
-      log_event_sink_->OnLogMessage(msg);
+    if (DecodeFullLogMessage(event, &reader, &msg)) {
+      DeliverLogMessage(msg);
 
       // Event is handled.
       return true;
@@ -114,6 +387,75 @@ bool LogParser::ParseLogEvent(EVENT_TRACE* event) {
   return false;
 }
 
+bool LogParser::DecodeFullLogMessage(const EVENT_TRACE* event,
+                                     BinaryBufferReader* reader,
+                                     LogEvents::LogMessage* msg) {
+  DCHECK(event != NULL);
+  DCHECK(reader != NULL);
+  DCHECK(msg != NULL);
+
+  // The frame size only matters to what's past the depth. The line comes
+  // between the trace and the strings.
+  bool decoded = true;
+  if (log_fields_ != 0) {
+    if (GetStackFrameSize(event->MofData, event->MofLength, sizeof(DWORD),
+                          2) == sizeof(uint32)) {
+      decoded = DecodeFullMessage<uint32>(reader, log_fields_,
+                                          &converted_traces_, msg);
+    } else {
+      decoded = DecodeFullMessage<uint64>(reader, log_fields_,
+                                          &converted_traces_, msg);
+    }
+  }
+  if (!decoded)
+    return false;
+
+  if ((log_fields_ & LogEvents::FIELD_FILE_LINE) != 0 &&
+      string_table_ != NULL) {
+    msg->file_atom = string_table_->Intern(
+        base::StringPiece(msg->file, msg->file_len));
+  }
+
+  return true;
+}
+
+bool LogParser::ParseGenericEvent(EVENT_TRACE* event) {
+  DCHECK(event != NULL);
+  DCHECK(generic_decoder_ != NULL);
+
+  if (log_event_sink_ == NULL)
+    return false;
+
+  // Events with no schema aren't ours to filter.
+  if (!generic_decoder_->Decode(event, NULL))
+    return false;
+
+  LogEvents::LogMessage msg;
+  msg.time = base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp));
+  if (!PassesFilter(event, msg.time))
+    return true;
+
+  msg.level = event->Header.Class.Level;
+  msg.process_id = event->Header.ProcessId;
+  msg.thread_id = event->Header.ThreadId;
+
+  if ((log_fields_ & LogEvents::FIELD_MESSAGE) != 0) {
+    // The text stays put until the message is delivered.
+    generic_messages_.push_back(std::string());
+    std::string& text = generic_messages_.back();
+    generic_decoder_->Decode(event, &text);
+    msg.message = text.c_str();
+    msg.message_len = text.size();
+  }
+
+  DeliverLogMessage(msg);
+  if (!batch_log_messages_)
+    generic_messages_.clear();
+
+  return true;
+}
+
 bool LogParser::ParseTraceEvent(EVENT_TRACE* event) {
   DCHECK(event != NULL);
 
@@ -129,30 +471,37 @@ bool LogParser::ParseTraceEvent(EVENT_TRACE* event) {
       break;
 
     default:
-      LOG(ERROR) << "Unknown event type " << event->Header.Class.Type;
+      // These are counted rather than logged, as a provider that emits
+      // them is likely to emit a lot of them.
+      ++unknown_trace_event_count_;
       return false;
   }
 
-  if (event->Header.Class.Version != 0) {
-    LOG(ERROR) << "Unknown event version " << event->Header.Class.Version;
-    return false;
-  }
+  if (event->Header.Class.Version > kTraceEventVersion)
+    ++newer_trace_event_count_;
 
   TraceEvents::TraceMessage trace;
 
   trace.time = base::Time::FromFileTime(
       reinterpret_cast<FILETIME&>(event->Header.TimeStamp));
+  if (!PassesFilter(event, trace.time))
+    return true;
+
   trace.level = event->Header.Class.Level;
   trace.process_id = event->Header.ProcessId;
   trace.thread_id = event->Header.ThreadId;
   BinaryBufferReader reader(event->MofData, event->MofLength);
 
-  void* const* id = NULL;
-  if (reader.ReadString(&trace.name, &trace.name_len) &&
-      reader.Read(&id),
-      reader.ReadString(&trace.extra, &trace.extra_len)) {
-    DCHECK(id != NULL);
-    trace.id = *id;
+  // The event class tells the bitness of the logging process.
+  bool decoded = false;
+  if (event->Header.Guid == base::debug::kTraceEventClass64)
+    decoded = DecodeTraceEvent<uint64>(&reader, &trace);
+  else
+    decoded = DecodeTraceEvent<uint32>(&reader, &trace);
+
+  if (decoded) {
+    // Keep the trace event in order with the log messages.
+    FlushLogMessages();
 
     switch (event->Header.Class.Type) {
       case base::debug::kTraceEventTypeBegin:
@@ -172,25 +521,219 @@ bool LogParser::ParseTraceEvent(EVENT_TRACE* event) {
     return true;
   }
 
+  ++unknown_trace_event_count_;
   return false;
 }
 
-LogConsumer* LogConsumer::current_ = NULL;
+bool LogParser::ParseLostEvent(EVENT_TRACE* event) {
+  DCHECK(event != NULL);
+
+  LogEvents::EventLoss loss;
+  loss.time = base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp));
+  switch (event->Header.Class.Type) {
+    case kernel_log_types::kRtLostEvent:
+    case kernel_log_types::kRtLostFile:
+      loss.type = LogEvents::EventLoss::EVENTS_LOST;
+      break;
+    case kernel_log_types::kRtLostBuffer:
+      loss.type = LogEvents::EventLoss::BUFFERS_LOST;
+      break;
+    default:
+      return false;
+  }
+
+  // The loss applies to all events, so it's not subject to the filter.
+  DeliverEventLoss(loss);
+  return true;
+}
+
+namespace {
 
-LogConsumer::LogConsumer() {
-  DCHECK(current_ == NULL);
+// The consumer of each consuming thread.
+base::LazyInstance<base::ThreadLocalPointer<LogConsumer> >::Leaky
+    current_consumer = LAZY_INSTANCE_INITIALIZER;
 
-  current_ = this;
+}  // namespace
+
+LogConsumer::LogConsumer()
+    : event_rate_stats_(NULL), ingest_loop_(NULL), slab_size_(0),
+      current_slab_(NULL), slab_freed_(&slab_lock_), num_slabs_(0),
+      num_pending_slabs_(0), max_slabs_(0), num_slab_waits_(0) {
 }
 
 LogConsumer::~LogConsumer() {
-  DCHECK(current_ == this);
-  current_ = NULL;
+  DCHECK_EQ(0U, num_pending_slabs_);
+  delete current_slab_;
+  STLDeleteElements(&free_slabs_);
+}
+
+HRESULT LogConsumer::Consume() {
+  // ProcessTrace calls back on the thread that calls it.
+  DCHECK(current_consumer.Pointer()->Get() == NULL);
+  current_consumer.Pointer()->Set(this);
+
+  // With the parsing deferred the callbacks do little, so they may as
+  // well run ahead of the threads that would hold them up.
+  HANDLE thread = ::GetCurrentThread();
+  int priority = ::GetThreadPriority(thread);
+  if (ingest_loop_ != NULL)
+    ::SetThreadPriority(thread, THREAD_PRIORITY_ABOVE_NORMAL);
+
+  HRESULT hr = EtwTraceConsumerBase<LogConsumer>::Consume();
+
+  if (ingest_loop_ != NULL) {
+    ::SetThreadPriority(thread, priority);
+
+    // Whatever the last buffer left in the current slab goes too, and the
+    // ingest thread has to be done with the slabs before we are.
+    PostSlab();
+    base::AutoLock lock(slab_lock_);
+    while (num_pending_slabs_ != 0)
+      slab_freed_.Wait();
+  }
+
+  current_consumer.Pointer()->Set(NULL);
+  return hr;
+}
+
+void LogConsumer::DeferParsing(base::MessageLoop* ingest_loop,
+                               size_t slab_size,
+                               size_t max_slabs) {
+  DCHECK(ingest_loop != NULL);
+  DCHECK_LT(0U, slab_size);
+  DCHECK_LT(0U, max_slabs);
+  DCHECK(current_consumer.Pointer()->Get() != this);
+
+  ingest_loop_ = ingest_loop;
+  slab_size_ = slab_size;
+  set_max_slabs(max_slabs);
+}
+
+void LogConsumer::set_max_slabs(size_t max_slabs) {
+  DCHECK_LT(0U, max_slabs);
+  base::AutoLock lock(slab_lock_);
+  max_slabs_ = max_slabs;
+  slab_freed_.Broadcast();
+}
+
+size_t LogConsumer::max_slabs() {
+  base::AutoLock lock(slab_lock_);
+  return max_slabs_;
+}
+
+size_t LogConsumer::num_slab_waits() {
+  base::AutoLock lock(slab_lock_);
+  return num_slab_waits_;
+}
+
+void LogConsumer::DeferEvent(const EVENT_TRACE* event) {
+  if (current_slab_ != NULL && current_slab_->Append(event))
+    return;
+
+  // The slab is full, or there's none yet.
+  PostSlab();
+  size_t record_size = EventSlab::GetRecordSize(event);
+  if (record_size > slab_size_) {
+    // An event larger than the slabs gets a slab of its own, which is
+    // freed after it's parsed.
+    EventSlab* slab = new EventSlab(record_size);
+    CHECK(slab->Append(event));
+    std::swap(slab, current_slab_);
+    PostSlab();
+    current_slab_ = slab;
+    return;
+  }
+
+  if (current_slab_ == NULL)
+    current_slab_ = AcquireSlab();
+  bool appended = current_slab_->Append(event);
+  DCHECK(appended);
+}
+
+void LogConsumer::PostSlab() {
+  if (current_slab_ == NULL || current_slab_->empty())
+    return;
+
+  {
+    base::AutoLock lock(slab_lock_);
+    ++num_pending_slabs_;
+  }
+  ingest_loop_->PostTask(FROM_HERE,
+      base::Bind(&LogConsumer::ParseSlab, base::Unretained(this),
+                 current_slab_));
+  current_slab_ = NULL;
+}
+
+EventSlab* LogConsumer::AcquireSlab() {
+  base::AutoLock lock(slab_lock_);
+  if (free_slabs_.empty() && num_slabs_ >= max_slabs_) {
+    // The ingest thread is behind, there's nothing for it but to wait.
+    ++num_slab_waits_;
+    while (free_slabs_.empty() && num_slabs_ >= max_slabs_)
+      slab_freed_.Wait();
+  }
+
+  if (!free_slabs_.empty()) {
+    EventSlab* slab = free_slabs_.back();
+    free_slabs_.pop_back();
+    return slab;
+  }
+
+  ++num_slabs_;
+  return new EventSlab(slab_size_);
+}
+
+void LogConsumer::ParseSlab(EventSlab* slab) {
+  DCHECK_EQ(ingest_loop_, base::MessageLoop::current());
+  DCHECK(slab != NULL);
+
+  size_t offset = 0;
+  while (EVENT_TRACE* event = slab->GetNext(&offset))
+    ProcessOneEvent(event);
+  // The log messages refer to the slab's copies.
+  FlushLogMessages();
+
+  slab->Clear();
+  base::AutoLock lock(slab_lock_);
+  if (slab->capacity() > slab_size_)
+    delete slab;
+  else
+    free_slabs_.push_back(slab);
+  --num_pending_slabs_;
+  slab_freed_.Broadcast();
+}
+
+// static
+LogConsumer* LogConsumer::current() {
+  LogConsumer* consumer = current_consumer.Pointer()->Get();
+  DCHECK(consumer != NULL);
+  return consumer;
 }
 
 void LogConsumer::ProcessEvent(PEVENT_TRACE event) {
-  DCHECK(current_ != NULL);
-  current_->ProcessOneEvent(event);
+  LogConsumer* consumer = current();
+  if (consumer->event_rate_stats_ != NULL)
+    consumer->event_rate_stats_->AddEvent(event);
+  if (consumer->ingest_loop_ != NULL)
+    consumer->DeferEvent(event);
+  else
+    consumer->ProcessOneEvent(event);
+}
+
+bool LogConsumer::ProcessBuffer(EVENT_TRACE_LOGFILE* buffer) {
+  LogConsumer* consumer = current();
+  // The events of this buffer are about to go away. Their copies go to
+  // the ingest thread without waiting for a full slab, so they're parsed
+  // as promptly as they would be otherwise.
+  if (consumer->ingest_loop_ != NULL)
+    consumer->PostSlab();
+  else
+    consumer->FlushLogMessages();
+  if (consumer->event_rate_stats_ != NULL)
+    consumer->event_rate_stats_->Flush();
+
+  return true;
 }
 
 DWORD WINAPI LogConsumer::ThreadProc(LPVOID param) {
@@ -16,8 +16,24 @@
 #ifndef SAWBUCK_LOG_LIB_LOG_CONSUMER_H_
 #define SAWBUCK_LOG_LIB_LOG_CONSUMER_H_
 
+#include <deque>
+#include <string>
+#include <vector>
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
 #include "base/time/time.h"
 #include "base/win/event_trace_consumer.h"
+#include "sawbuck/log_lib/string_table.h"
+
+class BinaryBufferReader;
+class EventRateStats;
+class EventRouter;
+class EventSlab;
+class TdhEventDecoder;
+
+namespace base {
+class MessageLoop;
+}  // namespace base
 
 struct LogMessageBase {
   LogMessageBase() : level(0), process_id(0), thread_id(0), trace_depth(0),
@@ -36,9 +52,20 @@ struct LogMessageBase {
 // Implemented by clients of LogParser to receive log message notifications.
 class LogEvents {
  public:
+  // The fields of a log message a sink may do without, @see
+  // LogParser::set_log_fields. The time, level, process and thread are
+  // always there.
+  enum LogField {
+    FIELD_STACK_TRACE = 1 << 0,
+    // The file, its atom and the line.
+    FIELD_FILE_LINE = 1 << 1,
+    FIELD_MESSAGE = 1 << 2,
+    ALL_FIELDS = FIELD_STACK_TRACE | FIELD_FILE_LINE | FIELD_MESSAGE,
+  };
+
   struct LogMessage : public LogMessageBase {
     LogMessage() : message_len(0), message(NULL), file_len(0), file(NULL),
-        line(0) {
+        file_atom(StringTable::kEmptyAtom), line(0) {
     }
 
     size_t message_len;
@@ -47,6 +74,9 @@ class LogEvents {
     // File/line information, if available.
     size_t file_len;
     const char* file;
+    // The atom for file in the parser's string table, or kEmptyAtom if
+    // the parser has no string table.
+    StringTable::Atom file_atom;
     int line;
   };
 
@@ -54,6 +84,34 @@ class LogEvents {
   // Note: log_message is not valid beyond the call, any strings
   //    you need to hold on to must be copied.
   virtual void OnLogMessage(const LogMessage& log_message) = 0;
+
+  // Issued for a batch of log messages, in order, when the parser batches.
+  // The default implementation issues OnLogMessage for each message, sinks
+  // can override this to amortize their per-message overhead.
+  // Note: log_messages are not valid beyond the call.
+  virtual void OnLogMessages(const LogMessage* log_messages,
+                             size_t num_messages);
+
+  // Where the capture lost data, as the session ran out of buffers or the
+  // consumer fell behind.
+  struct EventLoss {
+    enum Type {
+      EVENTS_LOST,
+      BUFFERS_LOST,
+    };
+
+    EventLoss() : type(EVENTS_LOST), count(0) {
+    }
+
+    base::Time time;
+    Type type;
+    // The number of events or buffers lost, zero if unknown.
+    uint32 count;
+  };
+
+  // Issued for each loss, in order with the log messages. The default
+  // implementation ignores it.
+  virtual void OnEventLoss(const EventLoss& event_loss);
 };
 
 // Implemented by clients of LogParser to receive trace message notifications.
@@ -89,20 +147,137 @@ class LogParser {
   void set_trace_sink(TraceEvents* trace_event_sink){
     trace_event_sink_ = trace_event_sink;
   }
+  // Sets the table file names are interned to, the table must
+  // outlive this parser.
+  void set_string_table(StringTable* string_table) {
+    string_table_ = string_table;
+  }
+  // Sets the decoder for the events of other providers, which become log
+  // messages of their properties rendered to text. The decoder must
+  // outlive this parser.
+  void set_generic_decoder(TdhEventDecoder* generic_decoder) {
+    generic_decoder_ = generic_decoder;
+  }
+
+  // When batching, log messages are held and issued to the sink in one
+  // OnLogMessages call on FlushLogMessages. As the messages refer to the
+  // event data, FlushLogMessages must be called before the data goes away,
+  // e.g. from the ETW buffer callback. Trace events are not batched, rather
+  // they flush the log messages ahead of them to preserve order.
+  void set_batch_log_messages(bool batch_log_messages) {
+    batch_log_messages_ = batch_log_messages;
+  }
+  void FlushLogMessages();
+
+  // Issues @p event_loss to the event sink, after the log messages held
+  // ahead of it. The parser issues the losses real time sessions report,
+  // this is for the losses its client finds, e.g. gaps between the buffers
+  // of a log file.
+  void DeliverEventLoss(const LogEvents::EventLoss& event_loss);
+
+  // Sets the LogEvents::LogField mask of the fields the event sink needs,
+  // ALL_FIELDS by default. The fields left out are not decoded, nor is
+  // their part of the event validated, and they're left empty. A sink that
+  // only counts by level or process, for instance, saves the scans for the
+  // file and message terminators, and the interning of the file.
+  void set_log_fields(uint32 log_fields) { log_fields_ = log_fields; }
+  uint32 log_fields() const { return log_fields_; }
+
+  // Narrows the log messages and trace events parsed. The events that
+  // don't pass are dropped on their header, before their payload is
+  // decoded.
+  struct EventFilter {
+    EventFilter();
+
+    // Passes the events of this process only, unless zero.
+    DWORD process_id;
+    // Passes the events of this level or more severe.
+    UCHAR max_level;
+    // Passes the events from this long after the first event parsed, and
+    // until this long after it, unless zero.
+    base::TimeDelta from;
+    base::TimeDelta to;
+  };
+  void set_event_filter(const EventFilter& event_filter) {
+    event_filter_ = event_filter;
+  }
+  // The number of events the filter dropped.
+  size_t filtered_event_count() const { return filtered_event_count_; }
+
+  // The number of trace events of unknown types, or that failed to parse.
+  size_t unknown_trace_event_count() const {
+    return unknown_trace_event_count_;
+  }
+  // The number of trace events of versions newer than we know, which are
+  // parsed by the layout of the version we know.
+  size_t newer_trace_event_count() const { return newer_trace_event_count_; }
 
   bool ProcessOneEvent(EVENT_TRACE* event);
 
+  // Routes the event classes we parse to us, for consumers that parse the
+  // events of several parsers. We must outlive @p router's use.
+  void AddEventClasses(EventRouter* router);
+  // Routes the events of @p provider to our generic decoder.
+  // @pre the generic decoder is set.
+  void AddGenericEventClass(const GUID& provider, EventRouter* router);
+
  private:
   bool ParseLogEvent(EVENT_TRACE* event);
   bool ParseTraceEvent(EVENT_TRACE* event);
+  bool ParseGenericEvent(EVENT_TRACE* event);
+  bool ParseLostEvent(EVENT_TRACE* event);
+
+  // Decode the fields of log_fields_ of the LOG_MESSAGE_FULL @p event from
+  // @p reader into @p msg.
+  // @returns false if the event doesn't decode.
+  bool DecodeFullLogMessage(const EVENT_TRACE* event,
+                            BinaryBufferReader* reader,
+                            LogEvents::LogMessage* msg);
+
+  // Returns true iff @p event passes the event filter.
+  bool PassesFilter(const EVENT_TRACE* event, const base::Time& time);
+
+  // Issues or holds on to log_message depending on batch_log_messages_.
+  void DeliverLogMessage(const LogEvents::LogMessage& log_message);
 
   // Our log event sink.
   LogEvents* log_event_sink_;
 
   // Our trace event sink.
   TraceEvents* trace_event_sink_;
+
+  // Our string table, if any.
+  StringTable* string_table_;
+
+  // Our generic decoder, if any, and the text of the generic log messages
+  // held for the next flush. A deque, so the text doesn't move as more
+  // is added.
+  TdhEventDecoder* generic_decoder_;
+  std::deque<std::string> generic_messages_;
+  // The stack traces of the log messages of the other pointer size, in
+  // ours, held likewise.
+  std::deque<std::vector<void*> > converted_traces_;
+
+  // The LogEvents::LogField mask of the fields we decode.
+  uint32 log_fields_;
+
+  // The log messages held for the next flush, when batching.
+  bool batch_log_messages_;
+  std::vector<LogEvents::LogMessage> pending_log_messages_;
+
+  // The event filter, and the time of the first event it saw.
+  EventFilter event_filter_;
+  base::Time first_event_time_;
+  size_t filtered_event_count_;
+
+  // Tallies of the trace events we dropped or parsed in part.
+  size_t unknown_trace_event_count_;
+  size_t newer_trace_event_count_;
 };
 
+// Consumes a log session, on the thread that calls Consume. The ETW
+// callbacks find their consumer by that thread, so several consumers can
+// each consume a session of their own on a thread of their own.
 class LogConsumer
     : public base::win::EtwTraceConsumerBase<LogConsumer>,
       public LogParser {
@@ -110,10 +285,75 @@ class LogConsumer
   LogConsumer();
   ~LogConsumer();
 
+  // Consumes the open sessions until they close, on the calling thread.
+  // When parsing is deferred, this waits for the ingest thread to parse
+  // the last of the events before returning.
+  // @returns S_OK on success, an error code otherwise.
+  HRESULT Consume();
+
+  // Defers the parsing of the events to the thread of @p ingest_loop,
+  // which must outlive the consumption. The ETW callbacks then only copy
+  // the events to slabs of @p slab_size bytes, which the ingest thread
+  // parses, issuing the events to the sinks, and hands back. Should the
+  // ingest thread fall behind by @p max_slabs, the callbacks wait for it.
+  // The consuming thread runs above normal priority meanwhile, so the
+  // sessions' buffers don't wait on it.
+  // @pre the consumption hasn't started.
+  void DeferParsing(base::MessageLoop* ingest_loop,
+                    size_t slab_size,
+                    size_t max_slabs);
+
+  // The most slabs in use at once, which may grow while consuming, e.g. as
+  // the session loses buffers. May be called on any thread.
+  // @{
+  void set_max_slabs(size_t max_slabs);
+  size_t max_slabs();
+  // @}
+  // @returns the times the callbacks waited for a slab, may be called on
+  //     any thread.
+  size_t num_slab_waits();
+
+  // Tallies all events consumed, parsed or not, on @p event_rate_stats,
+  // which must outlive the consumption.
+  void set_event_rate_stats(EventRateStats* event_rate_stats) {
+    event_rate_stats_ = event_rate_stats;
+  }
+
   static DWORD WINAPI ThreadProc(LPVOID param);
   static void ProcessEvent(EVENT_TRACE* event);
+  static bool ProcessBuffer(EVENT_TRACE_LOGFILE* buffer);
  private:
-  static LogConsumer* current_;
+  // @returns the consumer consuming on the calling thread.
+  static LogConsumer* current();
+
+  // Copies @p event to the current slab, handing the slab over to the
+  // ingest thread once it's full.
+  void DeferEvent(const EVENT_TRACE* event);
+  // Hands the current slab over to the ingest thread, unless it's empty.
+  void PostSlab();
+  // @returns a free slab, waiting for one if all are in use.
+  EventSlab* AcquireSlab();
+  // Parses the events of @p slab and frees it, on the ingest thread.
+  void ParseSlab(EventSlab* slab);
+
+  EventRateStats* event_rate_stats_;
+
+  // The deferred parsing state, if any. The current slab is only touched
+  // on the consuming thread.
+  base::MessageLoop* ingest_loop_;
+  size_t slab_size_;
+  EventSlab* current_slab_;
+
+  base::Lock slab_lock_;
+  // Signaled as the ingest thread frees slabs.
+  base::ConditionVariable slab_freed_;
+  std::vector<EventSlab*> free_slabs_;  // Under slab_lock_.
+  // The slabs of slab_size_ allocated, and the slabs handed over to the
+  // ingest thread and not yet freed.
+  size_t num_slabs_;  // Under slab_lock_.
+  size_t num_pending_slabs_;  // Under slab_lock_.
+  size_t max_slabs_;  // Under slab_lock_.
+  size_t num_slab_waits_;  // Under slab_lock_.
 };
 
 #endif  // SAWBUCK_LOG_LIB_LOG_CONSUMER_H_
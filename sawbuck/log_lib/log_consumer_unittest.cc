@@ -14,10 +14,14 @@
 #include "sawbuck/log_lib/log_consumer.h"
 
 #include <cguid.h>
+#include <vector>
+#include "base/debug/trace_event_win.h"
 #include "base/logging_win.h"
 #include "base/time/time.h"
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
+#include "sawbuck/log_lib/kernel_log_types.h"
+#include "sawbuck/log_lib/tdh_event_decoder.h"
 #include <initguid.h>  // NOLINT - must be last.
 
 namespace {
@@ -31,6 +35,8 @@ using testing::_;
 using testing::AllOf;
 using testing::ElementsAreArray;
 using testing::Field;
+using testing::InSequence;
+using testing::Invoke;
 using testing::IsNull;
 using testing::NotNull;
 using testing::StrictMock;
@@ -39,6 +45,7 @@ using testing::StrEq;
 class MockLogEvents: public LogEvents {
  public:
   MOCK_METHOD1(OnLogMessage, void(const LogEvents::LogMessage& msg));
+  MOCK_METHOD1(OnEventLoss, void(const LogEvents::EventLoss& event_loss));
 };
 
 class EventTrace: public EVENT_TRACE {
@@ -66,6 +73,13 @@ class EventTrace: public EVENT_TRACE {
 
 char kMsgText[] = "Nothing to see here, please move on";
 
+// Appends the bytes of @p value to @p buffer.
+template <class T>
+void AppendBytes(const T& value, std::vector<char>* buffer) {
+  const char* bytes = reinterpret_cast<const char*>(&value);
+  buffer->insert(buffer->end(), bytes, bytes + sizeof(value));
+}
+
 class LogParserTest: public testing::Test {
  public:
   LogParserTest() : log_msg_(logging::kLogEventId, logging::LOG_MESSAGE,
@@ -77,7 +91,12 @@ class LogParserTest: public testing::Test {
     parser_.set_event_sink(&events_);
   }
 
+  void SaveTrace(const LogEvents::LogMessage& msg) {
+    saved_trace_.assign(msg.traces, msg.traces + msg.trace_depth);
+  }
+
  protected:
+  std::vector<void*> saved_trace_;
   EventTrace log_msg_;
   StrictMock<MockLogEvents> events_;
   LogParser parser_;
@@ -163,4 +182,385 @@ TEST_F(LogParserTest, ParseLogEventWithStackTrace) {
   EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
 }
 
+TEST_F(LogParserTest, ParseLogEventFields) {
+  void* backtrace[] = { reinterpret_cast<void*>(0x1000),
+                        reinterpret_cast<void*>(0x2000) };
+  const char kFile[] = "file.cc";
+  const DWORD kLine = 42;
+
+  // A full log message is the stack trace depth and trace, the line, the
+  // file and the message.
+  std::vector<char> buffer;
+  DWORD depth = arraysize(backtrace);
+  const char* bytes = reinterpret_cast<const char*>(&depth);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(depth));
+  bytes = reinterpret_cast<const char*>(backtrace);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(backtrace));
+  bytes = reinterpret_cast<const char*>(&kLine);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(kLine));
+  buffer.insert(buffer.end(), kFile, kFile + sizeof(kFile));
+  buffer.insert(buffer.end(), kMsgText, kMsgText + sizeof(kMsgText));
+
+  log_msg_.Header.Class.Type = logging::LOG_MESSAGE_FULL;
+  log_msg_.MofData = &buffer[0];
+  log_msg_.MofLength = buffer.size();
+
+  StringTable string_table;
+  parser_.set_string_table(&string_table);
+
+  // All the fields by default.
+  typedef LogEvents::LogMessage Msg;
+  EXPECT_CALL(events_, OnLogMessage(AllOf(
+      AllOf(
+          Field(&Msg::trace_depth, arraysize(backtrace)),
+          Field(&Msg::traces, NotNull()),
+          Field(&Msg::line, kLine)),
+      AllOf(
+          Field(&Msg::file, StrEq(kFile)),
+          Field(&Msg::file_atom, string_table.Intern(kFile)),
+          Field(&Msg::message, StrEq(kMsgText))))));
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  testing::Mock::VerifyAndClearExpectations(&events_);
+
+  // Just the file and line.
+  parser_.set_log_fields(LogEvents::FIELD_FILE_LINE);
+  EXPECT_CALL(events_, OnLogMessage(AllOf(
+      AllOf(
+          Field(&Msg::trace_depth, 0),
+          Field(&Msg::traces, IsNull()),
+          Field(&Msg::line, kLine)),
+      AllOf(
+          Field(&Msg::file, StrEq(kFile)),
+          Field(&Msg::message, IsNull()),
+          Field(&Msg::message_len, 0)))));
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  testing::Mock::VerifyAndClearExpectations(&events_);
+
+  // None of them, the header is all there is.
+  parser_.set_log_fields(0);
+  EXPECT_CALL(events_, OnLogMessage(AllOf(
+      AllOf(
+          Field(&Msg::level, TRACE_LEVEL_INFORMATION),
+          Field(&Msg::process_id, ::GetCurrentProcessId()),
+          Field(&Msg::traces, IsNull())),
+      AllOf(
+          Field(&Msg::file, IsNull()),
+          Field(&Msg::file_atom, StringTable::kEmptyAtom),
+          Field(&Msg::message, IsNull())))));
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  testing::Mock::VerifyAndClearExpectations(&events_);
+
+  // A truncated trace fails the decode only if it's wanted.
+  log_msg_.MofLength = sizeof(DWORD) + sizeof(void*);
+  EXPECT_CALL(events_, OnLogMessage(_));
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  testing::Mock::VerifyAndClearExpectations(&events_);
+
+  parser_.set_log_fields(LogEvents::FIELD_STACK_TRACE);
+  EXPECT_FALSE(parser_.ProcessOneEvent(&log_msg_));
+}
+
+TEST_F(LogParserTest, ParseLogEventOtherFrameSizes) {
+  // The frames of a 32 bit process, whatever our own bitness.
+  const uint32 kFrames32[] = { 0x1000, 0x2000, 0x3000 };
+  std::vector<void*> expected_trace;
+  for (size_t i = 0; i < arraysize(kFrames32); ++i) {
+    expected_trace.push_back(
+        reinterpret_cast<void*>(static_cast<uintptr_t>(kFrames32[i])));
+  }
+
+  std::vector<char> buffer;
+  AppendBytes(static_cast<DWORD>(arraysize(kFrames32)), &buffer);
+  AppendBytes(kFrames32, &buffer);
+  buffer.insert(buffer.end(), kMsgText, kMsgText + sizeof(kMsgText));
+
+  log_msg_.Header.Class.Type = logging::LOG_MESSAGE_WITH_STACKTRACE;
+  log_msg_.MofData = &buffer[0];
+  log_msg_.MofLength = buffer.size();
+
+  typedef LogEvents::LogMessage Msg;
+  EXPECT_CALL(events_, OnLogMessage(AllOf(
+      Field(&Msg::trace_depth, arraysize(kFrames32)),
+      Field(&Msg::message, StrEq(kMsgText)))))
+      .WillOnce(Invoke(this, &LogParserTest::SaveTrace));
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  testing::Mock::VerifyAndClearExpectations(&events_);
+  EXPECT_EQ(expected_trace, saved_trace_);
+
+  // And the same with the line and file.
+  const char kFile[] = "file.cc";
+  const DWORD kLine = 42;
+  buffer.clear();
+  AppendBytes(static_cast<DWORD>(arraysize(kFrames32)), &buffer);
+  AppendBytes(kFrames32, &buffer);
+  AppendBytes(kLine, &buffer);
+  buffer.insert(buffer.end(), kFile, kFile + sizeof(kFile));
+  buffer.insert(buffer.end(), kMsgText, kMsgText + sizeof(kMsgText));
+
+  log_msg_.Header.Class.Type = logging::LOG_MESSAGE_FULL;
+  log_msg_.MofData = &buffer[0];
+  log_msg_.MofLength = buffer.size();
+
+  EXPECT_CALL(events_, OnLogMessage(AllOf(
+      Field(&Msg::trace_depth, arraysize(kFrames32)),
+      Field(&Msg::line, kLine),
+      Field(&Msg::file, StrEq(kFile)),
+      Field(&Msg::message, StrEq(kMsgText)))))
+      .WillOnce(Invoke(this, &LogParserTest::SaveTrace));
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  testing::Mock::VerifyAndClearExpectations(&events_);
+  EXPECT_EQ(expected_trace, saved_trace_);
+
+  // The user mode frames of a 64 bit process, which are truncated in a
+  // 32 bit build.
+  const uint64 kFrames64[] = { 0x00007FF612340000ULL, 0x00007FF6123456F0ULL };
+  expected_trace.clear();
+  for (size_t i = 0; i < arraysize(kFrames64); ++i) {
+    expected_trace.push_back(
+        reinterpret_cast<void*>(static_cast<uintptr_t>(kFrames64[i])));
+  }
+
+  buffer.clear();
+  AppendBytes(static_cast<DWORD>(arraysize(kFrames64)), &buffer);
+  AppendBytes(kFrames64, &buffer);
+  AppendBytes(kLine, &buffer);
+  buffer.insert(buffer.end(), kFile, kFile + sizeof(kFile));
+  buffer.insert(buffer.end(), kMsgText, kMsgText + sizeof(kMsgText));
+  log_msg_.MofData = &buffer[0];
+  log_msg_.MofLength = buffer.size();
+
+  EXPECT_CALL(events_, OnLogMessage(AllOf(
+      Field(&Msg::trace_depth, arraysize(kFrames64)),
+      Field(&Msg::line, kLine),
+      Field(&Msg::file, StrEq(kFile)),
+      Field(&Msg::message, StrEq(kMsgText)))))
+      .WillOnce(Invoke(this, &LogParserTest::SaveTrace));
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  EXPECT_EQ(expected_trace, saved_trace_);
+}
+
+TEST_F(LogParserTest, BatchLogEvents) {
+  parser_.set_batch_log_messages(true);
+
+  // Nothing is issued until the flush.
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  testing::Mock::VerifyAndClearExpectations(&events_);
+
+  // The default OnLogMessages issues each message in turn.
+  typedef LogEvents::LogMessage Msg;
+  EXPECT_CALL(events_, OnLogMessage(
+      Field(&Msg::message, StrEq(kMsgText)))).Times(3);
+  parser_.FlushLogMessages();
+  testing::Mock::VerifyAndClearExpectations(&events_);
+
+  // A second flush has nothing to issue.
+  parser_.FlushLogMessages();
+}
+
+TEST_F(LogParserTest, EventFilter) {
+  LogParser::EventFilter filter;
+  filter.process_id = ::GetCurrentProcessId();
+  filter.max_level = TRACE_LEVEL_WARNING;
+  filter.to = base::TimeDelta::FromSeconds(10);
+  parser_.set_event_filter(filter);
+
+  // Filtered events are handled, but not issued.
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  EXPECT_EQ(1U, parser_.filtered_event_count());
+
+  typedef LogEvents::LogMessage Msg;
+  EXPECT_CALL(events_, OnLogMessage(
+      Field(&Msg::level, TRACE_LEVEL_ERROR))).Times(1);
+  log_msg_.Header.Class.Level = TRACE_LEVEL_ERROR;
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  testing::Mock::VerifyAndClearExpectations(&events_);
+
+  log_msg_.Header.ProcessId = ::GetCurrentProcessId() + 1;
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  EXPECT_EQ(2U, parser_.filtered_event_count());
+
+  // The time range is relative to the first event.
+  log_msg_.Header.ProcessId = ::GetCurrentProcessId();
+  reinterpret_cast<FILETIME&>(log_msg_.Header.TimeStamp) =
+      (base::Time::Now() + base::TimeDelta::FromSeconds(11)).ToFileTime();
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  EXPECT_EQ(3U, parser_.filtered_event_count());
+}
+
+// Has a schema of a single count for the events of kRandomGuid.
+class CountSchemaSource : public TdhEventDecoder::SchemaSource {
+ public:
+  virtual bool GetSchema(const EVENT_TRACE* event,
+                         TdhEventDecoder::Schema* schema) {
+    if (event->Header.Guid != kRandomGuid)
+      return false;
+
+    TdhEventDecoder::Property property;
+    property.name = "Count";
+    property.type = TdhEventDecoder::TYPE_UINT32;
+    schema->assign(1, property);
+    return true;
+  }
+};
+
+TEST_F(LogParserTest, ParseGenericEvent) {
+  CountSchemaSource source;
+  TdhEventDecoder decoder(&source);
+  uint32 count = 12;
+  EventTrace event(kRandomGuid, 3, TRACE_LEVEL_WARNING,
+      ::GetCurrentProcessId(), ::GetCurrentThreadId(), base::Time::Now(),
+      sizeof(count), &count);
+
+  // Other providers' events aren't ours without a decoder.
+  EXPECT_FALSE(parser_.ProcessOneEvent(&event));
+
+  parser_.set_generic_decoder(&decoder);
+  typedef LogEvents::LogMessage Msg;
+  EXPECT_CALL(events_, OnLogMessage(AllOf(
+      Field(&Msg::level, TRACE_LEVEL_WARNING),
+      Field(&Msg::process_id, ::GetCurrentProcessId()),
+      Field(&Msg::message_len, strlen("Count=12")),
+      Field(&Msg::message, StrEq("Count=12"))))).Times(1);
+  EXPECT_TRUE(parser_.ProcessOneEvent(&event));
+  testing::Mock::VerifyAndClearExpectations(&events_);
+
+  // Nor are those the decoder has no schema for.
+  event.Header.Guid = GUID_NULL;
+  EXPECT_FALSE(parser_.ProcessOneEvent(&event));
+  event.Header.Guid = kRandomGuid;
+
+  // When batching, the text of each message lasts until the flush.
+  parser_.set_batch_log_messages(true);
+  EXPECT_TRUE(parser_.ProcessOneEvent(&event));
+  count = 13;
+  EXPECT_TRUE(parser_.ProcessOneEvent(&event));
+  {
+    InSequence in;
+    EXPECT_CALL(events_, OnLogMessage(
+        Field(&Msg::message, StrEq("Count=12")))).Times(1);
+    EXPECT_CALL(events_, OnLogMessage(
+        Field(&Msg::message, StrEq("Count=13")))).Times(1);
+  }
+  parser_.FlushLogMessages();
+}
+
+TEST_F(LogParserTest, ParseLostEvents) {
+  base::Time now(base::Time::Now());
+  EventTrace lost_buffer(kernel_log_types::kRtLostEventClass,
+      kernel_log_types::kRtLostBuffer, TRACE_LEVEL_INFORMATION, 0, 0, now,
+      0, NULL);
+
+  // A loss flushes the messages batched ahead of it.
+  parser_.set_batch_log_messages(true);
+  EXPECT_TRUE(parser_.ProcessOneEvent(&log_msg_));
+  typedef LogEvents::EventLoss Loss;
+  {
+    InSequence in;
+    EXPECT_CALL(events_, OnLogMessage(_)).Times(1);
+    EXPECT_CALL(events_, OnEventLoss(AllOf(
+        Field(&Loss::type, Loss::BUFFERS_LOST),
+        Field(&Loss::count, 0U),
+        Field(&Loss::time, now)))).Times(1);
+  }
+  EXPECT_TRUE(parser_.ProcessOneEvent(&lost_buffer));
+  testing::Mock::VerifyAndClearExpectations(&events_);
+
+  EventTrace lost_events(kernel_log_types::kRtLostEventClass,
+      kernel_log_types::kRtLostEvent, TRACE_LEVEL_INFORMATION, 0, 0, now,
+      0, NULL);
+  EXPECT_CALL(events_, OnEventLoss(
+      Field(&Loss::type, Loss::EVENTS_LOST))).Times(1);
+  EXPECT_TRUE(parser_.ProcessOneEvent(&lost_events));
+
+  // Other types of the class aren't losses.
+  lost_events.Header.Class.Type = kernel_log_types::kRtLostFile + 1;
+  EXPECT_FALSE(parser_.ProcessOneEvent(&lost_events));
+}
+
+class MockTraceEvents: public TraceEvents {
+ public:
+  MOCK_METHOD1(OnTraceEventBegin, void(const TraceMessage& msg));
+  MOCK_METHOD1(OnTraceEventEnd, void(const TraceMessage& msg));
+  MOCK_METHOD1(OnTraceEventInstant, void(const TraceMessage& msg));
+};
+
+class TraceParserTest: public testing::Test {
+ public:
+  virtual void SetUp() {
+    parser_.set_trace_sink(&events_);
+  }
+
+  // Makes a trace event payload of @p name, @p id and @p extra.
+  template <class IdType>
+  void MakePayload(const char* name, IdType id, const char* extra) {
+    payload_.assign(name, name + strlen(name) + 1);
+    const char* id_bytes = reinterpret_cast<const char*>(&id);
+    payload_.insert(payload_.end(), id_bytes, id_bytes + sizeof(id));
+    payload_.insert(payload_.end(), extra, extra + strlen(extra) + 1);
+  }
+
+  bool ProcessEvent(const GUID& event_class, UCHAR type, USHORT version) {
+    EventTrace event(event_class, type, TRACE_LEVEL_INFORMATION,
+        ::GetCurrentProcessId(), ::GetCurrentThreadId(), base::Time::Now(),
+        payload_.size(), &payload_[0]);
+    event.Header.Class.Version = version;
+    return parser_.ProcessOneEvent(&event);
+  }
+
+ protected:
+  std::vector<char> payload_;
+  StrictMock<MockTraceEvents> events_;
+  LogParser parser_;
+};
+
+typedef TraceEvents::TraceMessage TraceMsg;
+
+TEST_F(TraceParserTest, Parse32BitEvent) {
+  MakePayload<uint32>("Name", 0x1234, "extra");
+  EXPECT_CALL(events_, OnTraceEventBegin(AllOf(
+      Field(&TraceMsg::name, StrEq("Name")),
+      Field(&TraceMsg::id, reinterpret_cast<void*>(0x1234)),
+      Field(&TraceMsg::extra, StrEq("extra"))))).Times(1);
+  EXPECT_TRUE(ProcessEvent(base::debug::kTraceEventClass32,
+                           base::debug::kTraceEventTypeBegin, 0));
+}
+
+TEST_F(TraceParserTest, Parse64BitEvent) {
+  MakePayload<uint64>("Name", 0x5678, "extra");
+  EXPECT_CALL(events_, OnTraceEventEnd(AllOf(
+      Field(&TraceMsg::name, StrEq("Name")),
+      Field(&TraceMsg::id, reinterpret_cast<void*>(0x5678)),
+      Field(&TraceMsg::extra, StrEq("extra"))))).Times(1);
+  EXPECT_TRUE(ProcessEvent(base::debug::kTraceEventClass64,
+                           base::debug::kTraceEventTypeEnd, 0));
+  EXPECT_EQ(0U, parser_.unknown_trace_event_count());
+}
+
+TEST_F(TraceParserTest, ParseNewerVersion) {
+  MakePayload<uint32>("Name", 1, "extra");
+  // Newer versions may append fields.
+  payload_.push_back(42);
+  EXPECT_CALL(events_, OnTraceEventInstant(
+      Field(&TraceMsg::name, StrEq("Name")))).Times(1);
+  EXPECT_TRUE(ProcessEvent(base::debug::kTraceEventClass32,
+                           base::debug::kTraceEventTypeInstant, 2));
+  EXPECT_EQ(1U, parser_.newer_trace_event_count());
+  EXPECT_EQ(0U, parser_.unknown_trace_event_count());
+}
+
+TEST_F(TraceParserTest, CountsUnknownEvents) {
+  MakePayload<uint32>("Name", 1, "extra");
+  EXPECT_FALSE(ProcessEvent(base::debug::kTraceEventClass32, 109, 0));
+  EXPECT_FALSE(ProcessEvent(base::debug::kTraceEventClass64, 109, 0));
+  EXPECT_EQ(2U, parser_.unknown_trace_event_count());
+
+  // A short event is counted too.
+  payload_.resize(3);
+  EXPECT_FALSE(ProcessEvent(base::debug::kTraceEventClass32,
+                            base::debug::kTraceEventTypeBegin, 0));
+  EXPECT_EQ(3U, parser_.unknown_trace_event_count());
+}
+
 }  // namespace
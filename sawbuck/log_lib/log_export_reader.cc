@@ -0,0 +1,248 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log export reader implementation.
+#include "sawbuck/log_lib/log_export_reader.h"
+
+#include <functional>
+#include <queue>
+#include "base/logging.h"
+
+namespace {
+
+// The size of a row's fixed columns in a block.
+const size_t kRowSize = sizeof(int64) + 2 * sizeof(uint8) +
+    3 * sizeof(uint32) + sizeof(uint64) + 2 * sizeof(uint32);
+
+// Points @p column at the next @p num_rows values at @p pos in @p block.
+template <class T>
+void TakeColumn(const std::vector<char>& block, size_t num_rows, size_t* pos,
+                const T** column) {
+  *column = reinterpret_cast<const T*>(&block[*pos]);
+  *pos += num_rows * sizeof(T);
+}
+
+}  // namespace
+
+LogExportReader::LogExportReader(FILE* file)
+    : file_(file), num_rows_(0), times_(NULL), types_(NULL), levels_(NULL),
+      process_ids_(NULL), thread_ids_(NULL), lines_(NULL), ids_(NULL),
+      file_lens_(NULL), message_lens_(NULL), row_(0), file_offset_(0),
+      message_offset_(0), failed_(false) {
+  DCHECK(file != NULL);
+}
+
+LogExportReader::~LogExportReader() {
+}
+
+bool LogExportReader::Next() {
+  if (row_ < num_rows_) {
+    // Step past the strings of the current row.
+    file_offset_ += file_lens_[row_];
+    message_offset_ += message_lens_[row_];
+    ++row_;
+  }
+
+  while (row_ == num_rows_) {
+    if (!ReadBlock())
+      return false;
+  }
+
+  return true;
+}
+
+LogExportWriter::RowType LogExportReader::type() const {
+  DCHECK_LT(row_, num_rows_);
+  return static_cast<LogExportWriter::RowType>(types_[row_]);
+}
+
+base::Time LogExportReader::time() const {
+  DCHECK_LT(row_, num_rows_);
+  return base::Time::FromInternalValue(times_[row_]);
+}
+
+void LogExportReader::GetLogMessage(
+    LogEvents::LogMessage* log_message) const {
+  DCHECK(log_message != NULL);
+  DCHECK_EQ(LogExportWriter::LOG_ROW, type());
+
+  GetBase(log_message);
+  log_message->file_len = file_lens_[row_];
+  log_message->file = &block_[file_offset_];
+  log_message->line = lines_[row_];
+  log_message->message_len = message_lens_[row_];
+  log_message->message = &block_[message_offset_];
+}
+
+void LogExportReader::GetTraceMessage(
+    TraceEvents::TraceMessage* trace_message) const {
+  DCHECK(trace_message != NULL);
+  DCHECK_NE(LogExportWriter::LOG_ROW, type());
+
+  GetBase(trace_message);
+  trace_message->name_len = file_lens_[row_];
+  trace_message->name = &block_[file_offset_];
+  trace_message->id = reinterpret_cast<void*>(
+      static_cast<uintptr_t>(ids_[row_]));
+  trace_message->extra_len = message_lens_[row_];
+  trace_message->extra = &block_[message_offset_];
+}
+
+void LogExportReader::GetBase(LogMessageBase* event) const {
+  event->time = time();
+  event->level = levels_[row_];
+  event->process_id = process_ids_[row_];
+  event->thread_id = thread_ids_[row_];
+}
+
+bool LogExportReader::ReadBlock() {
+  row_ = 0;
+  num_rows_ = 0;
+
+  uint32 header[2] = {};
+  size_t read = fread(header, 1, sizeof(header), file_);
+  if (read == 0 && feof(file_))
+    return false;
+  if (read != sizeof(header) || header[0] != LogExportWriter::kBlockMagic ||
+      header[1] > LogExportWriter::kRowsPerBlock) {
+    failed_ = true;
+    return false;
+  }
+
+  size_t num_rows = header[1];
+  if (num_rows == 0)
+    return true;
+
+  size_t columns_size = num_rows * kRowSize;
+  block_.resize(columns_size);
+  if (fread(&block_[0], 1, columns_size, file_) != columns_size) {
+    failed_ = true;
+    return false;
+  }
+
+  // The string lengths are the last two columns, sum them up to read the
+  // strings that follow.
+  const uint32* file_lens = reinterpret_cast<const uint32*>(
+      &block_[0] + columns_size - 2 * num_rows * sizeof(uint32));
+  const uint32* message_lens = file_lens + num_rows;
+  size_t strings_size = 0;
+  for (size_t i = 0; i < num_rows; ++i)
+    strings_size += file_lens[i] + message_lens[i];
+
+  // Pad to make the string pointers valid for empty strings at the end.
+  block_.resize(columns_size + strings_size + 1);
+  if (strings_size != 0 &&
+      fread(&block_[columns_size], 1, strings_size, file_) != strings_size) {
+    failed_ = true;
+    return false;
+  }
+
+  // Point the columns into the block, which may have moved on resizing.
+  size_t pos = 0;
+  TakeColumn(block_, num_rows, &pos, &times_);
+  TakeColumn(block_, num_rows, &pos, &types_);
+  TakeColumn(block_, num_rows, &pos, &levels_);
+  TakeColumn(block_, num_rows, &pos, &process_ids_);
+  TakeColumn(block_, num_rows, &pos, &thread_ids_);
+  TakeColumn(block_, num_rows, &pos, &lines_);
+  TakeColumn(block_, num_rows, &pos, &ids_);
+  TakeColumn(block_, num_rows, &pos, &file_lens_);
+  TakeColumn(block_, num_rows, &pos, &message_lens_);
+  DCHECK_EQ(columns_size, pos);
+
+  size_t files_size = 0;
+  for (size_t i = 0; i < num_rows; ++i)
+    files_size += file_lens_[i];
+  file_offset_ = columns_size;
+  message_offset_ = columns_size + files_size;
+  num_rows_ = num_rows;
+
+  return true;
+}
+
+namespace {
+
+// A merge cursor on a run, ordered to make a min heap on the time and then
+// the run index.
+struct RunHead {
+  RunHead(int64 time, size_t run) : time(time), run(run) {
+  }
+
+  bool operator>(const RunHead& other) const {
+    if (time != other.time)
+      return time > other.time;
+    return run > other.run;
+  }
+
+  int64 time;
+  size_t run;
+};
+
+}  // namespace
+
+bool MergeExportRuns(const std::vector<LogExportReader*>& runs,
+                     LogExportWriter* writer) {
+  DCHECK(writer != NULL);
+
+  typedef std::priority_queue<RunHead, std::vector<RunHead>,
+                              std::greater<RunHead> > RunHeap;
+  RunHeap heads;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    if (runs[i]->Next())
+      heads.push(RunHead(runs[i]->time().ToInternalValue(), i));
+  }
+
+  bool succeeded = true;
+  LogEvents::LogMessage log_message;
+  TraceEvents::TraceMessage trace_message;
+  while (!heads.empty()) {
+    size_t run = heads.top().run;
+    heads.pop();
+
+    LogExportReader* reader = runs[run];
+    switch (reader->type()) {
+      case LogExportWriter::LOG_ROW:
+        reader->GetLogMessage(&log_message);
+        writer->OnLogMessage(log_message);
+        break;
+      case LogExportWriter::BEGIN_ROW:
+        reader->GetTraceMessage(&trace_message);
+        writer->OnTraceEventBegin(trace_message);
+        break;
+      case LogExportWriter::END_ROW:
+        reader->GetTraceMessage(&trace_message);
+        writer->OnTraceEventEnd(trace_message);
+        break;
+      case LogExportWriter::INSTANT_ROW:
+        reader->GetTraceMessage(&trace_message);
+        writer->OnTraceEventInstant(trace_message);
+        break;
+      default:
+        // An unknown row type is a malformed run, drop the rest of it.
+        LOG(ERROR) << "Unknown row type in export run " << run;
+        succeeded = false;
+        continue;
+    }
+
+    if (reader->Next())
+      heads.push(RunHead(reader->time().ToInternalValue(), run));
+  }
+
+  for (size_t i = 0; i < runs.size(); ++i) {
+    if (runs[i]->failed())
+      succeeded = false;
+  }
+
+  return succeeded;
+}
@@ -0,0 +1,89 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log export reader declaration.
+#ifndef SAWBUCK_LOG_LIB_LOG_EXPORT_READER_H_
+#define SAWBUCK_LOG_LIB_LOG_EXPORT_READER_H_
+
+#include <stdio.h>
+#include <vector>
+#include "base/basictypes.h"
+#include "sawbuck/log_lib/log_consumer.h"
+#include "sawbuck/log_lib/log_export_writer.h"
+
+// Reads back the rows of a LogExportWriter's binary output, a block at a
+// time.
+class LogExportReader {
+ public:
+  // @param file the file read from, which must outlive us.
+  explicit LogExportReader(FILE* file);
+  ~LogExportReader();
+
+  // Advances to the next row, reading the next block when need be.
+  // @returns false at the end of the file, or on a malformed block.
+  bool Next();
+
+  // Accessors for the current row, valid after Next returns true. The
+  // strings of the row are valid until Next is next called.
+  // @{
+  LogExportWriter::RowType type() const;
+  base::Time time() const;
+  // @pre type() == LOG_ROW.
+  void GetLogMessage(LogEvents::LogMessage* log_message) const;
+  // @pre type() != LOG_ROW.
+  void GetTraceMessage(TraceEvents::TraceMessage* trace_message) const;
+  // @}
+
+  // True iff the reading stopped on a malformed block.
+  bool failed() const { return failed_; }
+
+ private:
+  // Reads the next block and points the columns into it.
+  bool ReadBlock();
+
+  void GetBase(LogMessageBase* event) const;
+
+  FILE* file_;
+
+  // The block read, and its columns.
+  std::vector<char> block_;
+  size_t num_rows_;
+  const int64* times_;
+  const uint8* types_;
+  const uint8* levels_;
+  const uint32* process_ids_;
+  const uint32* thread_ids_;
+  const uint32* lines_;
+  const uint64* ids_;
+  const uint32* file_lens_;
+  const uint32* message_lens_;
+
+  // The current row, and the offsets of its strings in the block.
+  size_t row_;
+  size_t file_offset_;
+  size_t message_offset_;
+
+  bool failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogExportReader);
+};
+
+// Merges runs of rows, each in time order, into @p writer in time order.
+// Rows of equal times are taken from the earlier run first.
+// @returns false if any run is malformed, everything up to the malformed
+//     block is merged nonetheless.
+bool MergeExportRuns(const std::vector<LogExportReader*>& runs,
+                     LogExportWriter* writer);
+
+#endif  // SAWBUCK_LOG_LIB_LOG_EXPORT_READER_H_
@@ -0,0 +1,221 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log export reader unittests.
+#include "sawbuck/log_lib/log_export_reader.h"
+
+#include "base/strings/string_piece.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+class StringOutput : public LogExportWriter::Output {
+ public:
+  virtual bool Write(const char* data, size_t len) {
+    str_.append(data, len);
+    return true;
+  }
+
+  const std::string& str() const { return str_; }
+
+ private:
+  std::string str_;
+};
+
+class LogExportReaderTest : public testing::Test {
+ public:
+  LogExportReaderTest() : kT0(base::Time::Now()) {
+  }
+
+  virtual void TearDown() {
+    for (size_t i = 0; i < files_.size(); ++i)
+      fclose(files_[i]);
+  }
+
+  // Makes a temporary file for a run.
+  FILE* NewRun() {
+    FILE* file = tmpfile();
+    EXPECT_TRUE(file != NULL);
+    files_.push_back(file);
+    return file;
+  }
+
+  // Writes a log message from @p pid at @p ms milliseconds past kT0.
+  void WriteLog(LogExportWriter* writer, DWORD pid, int ms,
+                const char* message) {
+    LogEvents::LogMessage log_message;
+    log_message.time = kT0 + base::TimeDelta::FromMilliseconds(ms);
+    log_message.level = 3;
+    log_message.process_id = pid;
+    log_message.thread_id = pid + 1;
+    log_message.file = "file.cc";
+    log_message.file_len = 7;
+    log_message.line = ms;
+    log_message.message = message;
+    log_message.message_len = strlen(message);
+    writer->OnLogMessage(log_message);
+  }
+
+  // Flushes the run of @p writer and rewinds its @p file for reading.
+  void FinishRun(LogExportWriter* writer, FILE* file) {
+    ASSERT_TRUE(writer->Flush());
+    rewind(file);
+  }
+
+ protected:
+  const base::Time kT0;
+  std::vector<FILE*> files_;
+};
+
+}  // namespace
+
+TEST_F(LogExportReaderTest, RoundTrip) {
+  FILE* file = NewRun();
+  LogExportWriter::FileOutput output(file);
+  LogExportWriter writer(LogExportWriter::BINARY, &output,
+                         LogExportWriter::kDefaultBufferSize);
+  WriteLog(&writer, 10, 1, "A message");
+
+  TraceEvents::TraceMessage trace;
+  trace.time = kT0 + base::TimeDelta::FromMilliseconds(2);
+  trace.level = 5;
+  trace.process_id = 20;
+  trace.thread_id = 21;
+  trace.name = "Name";
+  trace.name_len = 4;
+  trace.id = reinterpret_cast<void*>(0x1234);
+  trace.extra = "";
+  trace.extra_len = 0;
+  writer.OnTraceEventEnd(trace);
+  FinishRun(&writer, file);
+
+  LogExportReader reader(file);
+  ASSERT_TRUE(reader.Next());
+  ASSERT_EQ(LogExportWriter::LOG_ROW, reader.type());
+  LogEvents::LogMessage log_message;
+  reader.GetLogMessage(&log_message);
+  EXPECT_TRUE(kT0 + base::TimeDelta::FromMilliseconds(1) ==
+              log_message.time);
+  EXPECT_EQ(3, log_message.level);
+  EXPECT_EQ(10U, log_message.process_id);
+  EXPECT_EQ(11U, log_message.thread_id);
+  EXPECT_EQ("file.cc", base::StringPiece(log_message.file,
+                                         log_message.file_len));
+  EXPECT_EQ(1, log_message.line);
+  EXPECT_EQ("A message", base::StringPiece(log_message.message,
+                                           log_message.message_len));
+
+  ASSERT_TRUE(reader.Next());
+  ASSERT_EQ(LogExportWriter::END_ROW, reader.type());
+  TraceEvents::TraceMessage trace_message;
+  reader.GetTraceMessage(&trace_message);
+  EXPECT_TRUE(trace.time == trace_message.time);
+  EXPECT_EQ(5, trace_message.level);
+  EXPECT_EQ(20U, trace_message.process_id);
+  EXPECT_EQ(21U, trace_message.thread_id);
+  EXPECT_EQ("Name", base::StringPiece(trace_message.name,
+                                      trace_message.name_len));
+  EXPECT_EQ(trace.id, trace_message.id);
+  EXPECT_EQ(0U, trace_message.extra_len);
+
+  EXPECT_FALSE(reader.Next());
+  EXPECT_FALSE(reader.failed());
+}
+
+TEST_F(LogExportReaderTest, ReadsBlocks) {
+  FILE* file = NewRun();
+  LogExportWriter::FileOutput output(file);
+  LogExportWriter writer(LogExportWriter::BINARY, &output,
+                         LogExportWriter::kDefaultBufferSize);
+  const size_t kNumRows = LogExportWriter::kRowsPerBlock * 2 + 1;
+  for (size_t i = 0; i < kNumRows; ++i)
+    WriteLog(&writer, 10, i, i % 2 ? "odd" : "even");
+  FinishRun(&writer, file);
+
+  LogExportReader reader(file);
+  LogEvents::LogMessage log_message;
+  for (size_t i = 0; i < kNumRows; ++i) {
+    ASSERT_TRUE(reader.Next());
+    reader.GetLogMessage(&log_message);
+    ASSERT_EQ(static_cast<int>(i), log_message.line);
+    ASSERT_EQ(i % 2 ? "odd" : "even",
+              base::StringPiece(log_message.message,
+                                log_message.message_len));
+  }
+  EXPECT_FALSE(reader.Next());
+  EXPECT_FALSE(reader.failed());
+}
+
+TEST_F(LogExportReaderTest, MalformedBlock) {
+  FILE* file = NewRun();
+  const char kGarbage[] = "Not a block at all";
+  fwrite(kGarbage, 1, sizeof(kGarbage), file);
+  rewind(file);
+
+  LogExportReader reader(file);
+  EXPECT_FALSE(reader.Next());
+  EXPECT_TRUE(reader.failed());
+}
+
+TEST_F(LogExportReaderTest, MergeRuns) {
+  // Two runs with interleaved and equal times.
+  FILE* file1 = NewRun();
+  LogExportWriter::FileOutput output1(file1);
+  LogExportWriter writer1(LogExportWriter::BINARY, &output1,
+                          LogExportWriter::kDefaultBufferSize);
+  WriteLog(&writer1, 1, 0, "a");
+  WriteLog(&writer1, 1, 2, "c");
+  WriteLog(&writer1, 1, 3, "d");
+  FinishRun(&writer1, file1);
+
+  FILE* file2 = NewRun();
+  LogExportWriter::FileOutput output2(file2);
+  LogExportWriter writer2(LogExportWriter::BINARY, &output2,
+                          LogExportWriter::kDefaultBufferSize);
+  WriteLog(&writer2, 2, 1, "b");
+  WriteLog(&writer2, 2, 3, "e");
+  WriteLog(&writer2, 2, 5, "f");
+  FinishRun(&writer2, file2);
+
+  // And an empty one.
+  FILE* file3 = NewRun();
+
+  LogExportReader reader1(file1);
+  LogExportReader reader2(file2);
+  LogExportReader reader3(file3);
+  std::vector<LogExportReader*> runs;
+  runs.push_back(&reader1);
+  runs.push_back(&reader2);
+  runs.push_back(&reader3);
+
+  StringOutput output;
+  LogExportWriter writer(LogExportWriter::BINARY, &output,
+                         LogExportWriter::kDefaultBufferSize);
+  ASSERT_TRUE(MergeExportRuns(runs, &writer));
+  ASSERT_TRUE(writer.Flush());
+  EXPECT_EQ(6U, writer.num_rows());
+
+  // Read the merged output back to check its order.
+  FILE* merged = NewRun();
+  fwrite(output.str().data(), 1, output.str().size(), merged);
+  rewind(merged);
+  LogExportReader reader(merged);
+  std::string messages;
+  LogEvents::LogMessage log_message;
+  while (reader.Next()) {
+    reader.GetLogMessage(&log_message);
+    messages.append(log_message.message, log_message.message_len);
+  }
+  EXPECT_EQ("abcdef", messages);
+}
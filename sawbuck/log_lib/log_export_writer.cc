@@ -0,0 +1,349 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log export writer implementation.
+#include "sawbuck/log_lib/log_export_writer.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+const char* const kRowTypeNames[] = { "log", "begin", "end", "instant" };
+
+const char kCsvHeader[] = "type,time,level,pid,tid,file,line,message,id\n";
+
+const char kHexDigits[] = "0123456789abcdef";
+
+// The smallest output buffer we use.
+const size_t kMinBufferSize = 256;
+
+}  // namespace
+
+const size_t LogExportWriter::kDefaultBufferSize;
+const size_t LogExportWriter::kRowsPerBlock;
+const uint32 LogExportWriter::kBlockMagic;
+
+LogExportWriter::FileOutput::FileOutput(FILE* file) : file_(file) {
+  DCHECK(file != NULL);
+}
+
+bool LogExportWriter::FileOutput::Write(const char* data, size_t len) {
+  return fwrite(data, 1, len, file_) == len;
+}
+
+LogExportWriter::LogExportWriter(Format format,
+                                 Output* output,
+                                 size_t buffer_size)
+    : format_(format),
+      output_(output),
+      buffer_size_(std::max(buffer_size, kMinBufferSize)),
+      num_rows_(0),
+      failed_(false) {
+  DCHECK(output != NULL);
+  buffer_.reserve(buffer_size_);
+
+  if (format_ == CSV)
+    Append(kCsvHeader, arraysize(kCsvHeader) - 1);
+}
+
+LogExportWriter::~LogExportWriter() {
+  Flush();
+}
+
+bool LogExportWriter::ParseFormat(const std::string& name, Format* format) {
+  DCHECK(format != NULL);
+  if (name == "csv") {
+    *format = CSV;
+  } else if (name == "jsonl") {
+    *format = JSON_LINES;
+  } else if (name == "binary") {
+    *format = BINARY;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+bool LogExportWriter::Flush() {
+  if (format_ == BINARY && !times_.empty())
+    WriteBinaryBlock();
+
+  WriteBuffer();
+  return !failed_;
+}
+
+void LogExportWriter::OnLogMessage(const LogMessage& log_message) {
+  Row row = { LOG_ROW, &log_message,
+              base::StringPiece(log_message.file, log_message.file_len),
+              log_message.line,
+              base::StringPiece(log_message.message, log_message.message_len),
+              0 };
+  WriteRow(row);
+}
+
+void LogExportWriter::OnTraceEventBegin(const TraceMessage& trace_message) {
+  Row row = { BEGIN_ROW, &trace_message,
+              base::StringPiece(trace_message.name, trace_message.name_len),
+              0,
+              base::StringPiece(trace_message.extra, trace_message.extra_len),
+              reinterpret_cast<uintptr_t>(trace_message.id) };
+  WriteRow(row);
+}
+
+void LogExportWriter::OnTraceEventEnd(const TraceMessage& trace_message) {
+  Row row = { END_ROW, &trace_message,
+              base::StringPiece(trace_message.name, trace_message.name_len),
+              0,
+              base::StringPiece(trace_message.extra, trace_message.extra_len),
+              reinterpret_cast<uintptr_t>(trace_message.id) };
+  WriteRow(row);
+}
+
+void LogExportWriter::OnTraceEventInstant(const TraceMessage& trace_message) {
+  Row row = { INSTANT_ROW, &trace_message,
+              base::StringPiece(trace_message.name, trace_message.name_len),
+              0,
+              base::StringPiece(trace_message.extra, trace_message.extra_len),
+              reinterpret_cast<uintptr_t>(trace_message.id) };
+  WriteRow(row);
+}
+
+void LogExportWriter::WriteRow(const Row& row) {
+  ++num_rows_;
+  switch (format_) {
+    case CSV:
+      WriteTextRow(row);
+      break;
+    case JSON_LINES:
+      WriteJsonRow(row);
+      break;
+    case BINARY:
+      AddBinaryRow(row);
+      break;
+    default:
+      NOTREACHED();
+      break;
+  }
+}
+
+void LogExportWriter::WriteTextRow(const Row& row) {
+  Append(kRowTypeNames[row.type]);
+  AppendChar(',');
+  AppendTime(row.event->time);
+  AppendChar(',');
+  AppendUint(row.event->level);
+  AppendChar(',');
+  AppendUint(row.event->process_id);
+  AppendChar(',');
+  AppendUint(row.event->thread_id);
+  AppendChar(',');
+  AppendCsvField(row.file);
+  AppendChar(',');
+  AppendUint(row.line);
+  AppendChar(',');
+  AppendCsvField(row.message);
+  AppendChar(',');
+  if (row.type != LOG_ROW)
+    AppendUint(row.id);
+  AppendChar('\n');
+}
+
+void LogExportWriter::WriteJsonRow(const Row& row) {
+  Append("{\"type\":\"");
+  Append(kRowTypeNames[row.type]);
+  Append("\",\"time\":\"");
+  AppendTime(row.event->time);
+  Append("\",\"level\":");
+  AppendUint(row.event->level);
+  Append(",\"pid\":");
+  AppendUint(row.event->process_id);
+  Append(",\"tid\":");
+  AppendUint(row.event->thread_id);
+  if (row.type == LOG_ROW) {
+    Append(",\"file\":");
+    AppendJsonString(row.file);
+    Append(",\"line\":");
+    AppendUint(row.line);
+    Append(",\"message\":");
+    AppendJsonString(row.message);
+  } else {
+    Append(",\"name\":");
+    AppendJsonString(row.file);
+    Append(",\"id\":");
+    AppendUint(row.id);
+    Append(",\"extra\":");
+    AppendJsonString(row.message);
+  }
+  Append("}\n");
+}
+
+void LogExportWriter::AddBinaryRow(const Row& row) {
+  times_.push_back(row.event->time.ToInternalValue());
+  types_.push_back(static_cast<uint8>(row.type));
+  levels_.push_back(row.event->level);
+  process_ids_.push_back(row.event->process_id);
+  thread_ids_.push_back(row.event->thread_id);
+  lines_.push_back(row.line);
+  ids_.push_back(row.id);
+  file_lens_.push_back(static_cast<uint32>(row.file.size()));
+  message_lens_.push_back(static_cast<uint32>(row.message.size()));
+  row.file.AppendToString(&files_);
+  row.message.AppendToString(&messages_);
+
+  if (times_.size() == kRowsPerBlock)
+    WriteBinaryBlock();
+}
+
+void LogExportWriter::WriteBinaryBlock() {
+  uint32 header[] = { kBlockMagic, static_cast<uint32>(times_.size()) };
+  Append(reinterpret_cast<const char*>(header), sizeof(header));
+  AppendColumn(times_);
+  AppendColumn(types_);
+  AppendColumn(levels_);
+  AppendColumn(process_ids_);
+  AppendColumn(thread_ids_);
+  AppendColumn(lines_);
+  AppendColumn(ids_);
+  AppendColumn(file_lens_);
+  AppendColumn(message_lens_);
+  Append(files_);
+  Append(messages_);
+
+  times_.clear();
+  types_.clear();
+  levels_.clear();
+  process_ids_.clear();
+  thread_ids_.clear();
+  lines_.clear();
+  ids_.clear();
+  file_lens_.clear();
+  message_lens_.clear();
+  files_.clear();
+  messages_.clear();
+}
+
+template <class T>
+void LogExportWriter::AppendColumn(const std::vector<T>& column) {
+  if (!column.empty()) {
+    Append(reinterpret_cast<const char*>(&column[0]),
+           column.size() * sizeof(column[0]));
+  }
+}
+
+void LogExportWriter::Append(const char* data, size_t len) {
+  if (buffer_.size() + len > buffer_size_) {
+    WriteBuffer();
+
+    // Don't bother buffering what wouldn't fit anyway.
+    if (len > buffer_size_) {
+      if (!failed_ && !output_->Write(data, len))
+        failed_ = true;
+      return;
+    }
+  }
+
+  buffer_.insert(buffer_.end(), data, data + len);
+}
+
+void LogExportWriter::AppendChar(char c) {
+  if (buffer_.size() == buffer_size_)
+    WriteBuffer();
+  buffer_.push_back(c);
+}
+
+void LogExportWriter::AppendUint(uint64 value) {
+  char digits[20];
+  size_t len = 0;
+  do {
+    digits[sizeof(digits) - ++len] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+
+  Append(digits + sizeof(digits) - len, len);
+}
+
+void LogExportWriter::AppendTime(const base::Time& time) {
+  char str[TimeFormatter::kMaxLength];
+  size_t len = time_formatter_.Format(time, str);
+  Append(str, len);
+}
+
+void LogExportWriter::AppendCsvField(const base::StringPiece& str) {
+  if (str.find_first_of(",\"\r\n") == base::StringPiece::npos) {
+    Append(str);
+    return;
+  }
+
+  AppendChar('"');
+  size_t start = 0;
+  for (size_t i = 0; i < str.size(); ++i) {
+    if (str[i] == '"') {
+      // Quotes are doubled up.
+      Append(str.data() + start, i + 1 - start);
+      start = i;
+    }
+  }
+  Append(str.data() + start, str.size() - start);
+  AppendChar('"');
+}
+
+void LogExportWriter::AppendJsonString(const base::StringPiece& str) {
+  AppendChar('"');
+  size_t start = 0;
+  for (size_t i = 0; i < str.size(); ++i) {
+    unsigned char c = static_cast<unsigned char>(str[i]);
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+
+    // Write out the run before the character, then escape it.
+    Append(str.data() + start, i - start);
+    start = i + 1;
+    switch (c) {
+      case '"':
+        Append("\\\"");
+        break;
+      case '\\':
+        Append("\\\\");
+        break;
+      case '\n':
+        Append("\\n");
+        break;
+      case '\r':
+        Append("\\r");
+        break;
+      case '\t':
+        Append("\\t");
+        break;
+      default: {
+        char escape[] = { '\\', 'u', '0', '0',
+                          kHexDigits[c >> 4], kHexDigits[c & 0xF] };
+        Append(escape, arraysize(escape));
+        break;
+      }
+    }
+  }
+  Append(str.data() + start, str.size() - start);
+  AppendChar('"');
+}
+
+void LogExportWriter::WriteBuffer() {
+  if (buffer_.empty())
+    return;
+
+  if (!failed_ && !output_->Write(&buffer_[0], buffer_.size()))
+    failed_ = true;
+  buffer_.clear();
+}
@@ -0,0 +1,177 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log export writer declaration.
+#ifndef SAWBUCK_LOG_LIB_LOG_EXPORT_WRITER_H_
+#define SAWBUCK_LOG_LIB_LOG_EXPORT_WRITER_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "sawbuck/log_lib/log_consumer.h"
+#include "sawbuck/log_lib/time_formatter.h"
+
+// Writes the log messages and trace events it receives as CSV, JSON Lines
+// or binary columns. The rows are formatted into a buffer that's sized up
+// front and written out whenever it fills, so the output sees few, large
+// writes.
+//
+// Each row has a type, "log", "begin", "end" or "instant", and the time,
+// level, process and thread id of the event. Log messages add the file,
+// line and message, trace events the name, id and extra data.
+//  - CSV has a header row, and the columns
+//    type,time,level,pid,tid,file,line,message,id. Trace events put their
+//    name and extra data in the file and message columns.
+//  - JSON Lines has an object per row, with the keys of the row's type.
+//  - The binary format is a sequence of blocks of up to kRowsPerBlock rows.
+//    A block is the uint32 kBlockMagic and the uint32 row count n, then
+//    the columns, each of n little endian values:
+//      int64 time, in microseconds since 1601 UTC
+//      uint8 type, a RowType
+//      uint8 level
+//      uint32 process id, uint32 thread id, uint32 line
+//      uint64 id
+//      uint32 file length, uint32 message length
+//    and last the files, and then the messages, concatenated.
+class LogExportWriter : public LogEvents, public TraceEvents {
+ public:
+  enum Format {
+    CSV,
+    JSON_LINES,
+    BINARY,
+  };
+
+  enum RowType {
+    LOG_ROW,
+    BEGIN_ROW,
+    END_ROW,
+    INSTANT_ROW,
+  };
+
+  // Receives the writer's output.
+  class Output {
+   public:
+    virtual ~Output() {}
+
+    // @returns true on success.
+    virtual bool Write(const char* data, size_t len) = 0;
+  };
+
+  // Writes to a stdio file.
+  class FileOutput : public Output {
+   public:
+    // @param file the file written to, which must outlive us.
+    explicit FileOutput(FILE* file);
+
+    virtual bool Write(const char* data, size_t len);
+
+   private:
+    FILE* file_;
+
+    DISALLOW_COPY_AND_ASSIGN(FileOutput);
+  };
+
+  static const size_t kDefaultBufferSize = 1024 * 1024;
+  static const size_t kRowsPerBlock = 4096;
+  static const uint32 kBlockMagic = 0x4B4C4253;  // "SBLK".
+
+  // @param output receives the output, and must outlive us.
+  // @param buffer_size the size of the output buffer.
+  LogExportWriter(Format format, Output* output, size_t buffer_size);
+  // Flushes what's left.
+  ~LogExportWriter();
+
+  // Parses a format name, "csv", "jsonl" or "binary".
+  // @returns true iff @p name names a format.
+  static bool ParseFormat(const std::string& name, Format* format);
+
+  // Writes out the rows buffered so far.
+  // @returns false if the output has failed, now or before.
+  bool Flush();
+
+  // The number of rows written so far.
+  size_t num_rows() const { return num_rows_; }
+  bool failed() const { return failed_; }
+
+  // LogEvents implementation.
+  virtual void OnLogMessage(const LogMessage& log_message);
+
+  // TraceEvents implementation.
+  virtual void OnTraceEventBegin(const TraceMessage& trace_message);
+  virtual void OnTraceEventEnd(const TraceMessage& trace_message);
+  virtual void OnTraceEventInstant(const TraceMessage& trace_message);
+
+ private:
+  // A row, whichever its type.
+  struct Row {
+    RowType type;
+    const LogMessageBase* event;
+    base::StringPiece file;
+    int line;
+    base::StringPiece message;
+    uint64 id;
+  };
+
+  void WriteRow(const Row& row);
+  void WriteTextRow(const Row& row);
+  void WriteJsonRow(const Row& row);
+  void AddBinaryRow(const Row& row);
+  void WriteBinaryBlock();
+
+  // Appends to the buffer, writing it out first if it's too full.
+  void Append(const char* data, size_t len);
+  void Append(const base::StringPiece& str) { Append(str.data(), str.size()); }
+  void AppendChar(char c);
+  template <class T>
+  void AppendColumn(const std::vector<T>& column);
+  void AppendUint(uint64 value);
+  void AppendTime(const base::Time& time);
+  // Appends @p str quoted for CSV if need be.
+  void AppendCsvField(const base::StringPiece& str);
+  // Appends @p str as a quoted JSON string.
+  void AppendJsonString(const base::StringPiece& str);
+
+  // Writes out the buffer.
+  void WriteBuffer();
+
+  Format format_;
+  Output* output_;
+  TimeFormatter time_formatter_;
+
+  // The output buffer, reserved to its size up front.
+  std::vector<char> buffer_;
+  size_t buffer_size_;
+
+  // The columns of the binary block being gathered.
+  std::vector<int64> times_;
+  std::vector<uint8> types_;
+  std::vector<uint8> levels_;
+  std::vector<uint32> process_ids_;
+  std::vector<uint32> thread_ids_;
+  std::vector<uint32> lines_;
+  std::vector<uint64> ids_;
+  std::vector<uint32> file_lens_;
+  std::vector<uint32> message_lens_;
+  std::string files_;
+  std::string messages_;
+
+  size_t num_rows_;
+  bool failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogExportWriter);
+};
+
+#endif  // SAWBUCK_LOG_LIB_LOG_EXPORT_WRITER_H_
@@ -0,0 +1,241 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log export writer unittests.
+#include "sawbuck/log_lib/log_export_writer.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class StringOutput : public LogExportWriter::Output {
+ public:
+  StringOutput() : num_writes_(0), fail_(false) {
+  }
+
+  virtual bool Write(const char* data, size_t len) {
+    ++num_writes_;
+    str_.append(data, len);
+    return !fail_;
+  }
+
+  const std::string& str() const { return str_; }
+  size_t num_writes() const { return num_writes_; }
+  void set_fail(bool fail) { fail_ = fail; }
+
+ private:
+  std::string str_;
+  size_t num_writes_;
+  bool fail_;
+};
+
+class LogExportWriterTest : public testing::Test {
+ public:
+  LogExportWriterTest() {
+    message_.time = base::Time::Now();
+    message_.level = 4;
+    message_.process_id = 10;
+    message_.thread_id = 11;
+    SetMessage("file.cc", "A message");
+    message_.line = 42;
+
+    trace_.time = message_.time;
+    trace_.level = 5;
+    trace_.process_id = 20;
+    trace_.thread_id = 21;
+    trace_.name = "Name";
+    trace_.name_len = 4;
+    trace_.id = reinterpret_cast<void*>(0x1234);
+    trace_.extra = "";
+    trace_.extra_len = 0;
+
+    char time[TimeFormatter::kMaxLength];
+    TimeFormatter formatter;
+    time_.assign(time, formatter.Format(message_.time, time));
+  }
+
+  void SetMessage(const char* file, const char* message) {
+    message_.file = file;
+    message_.file_len = strlen(file);
+    message_.message = message;
+    message_.message_len = strlen(message);
+  }
+
+ protected:
+  StringOutput output_;
+  LogEvents::LogMessage message_;
+  TraceEvents::TraceMessage trace_;
+  // The formatted time of the events.
+  std::string time_;
+};
+
+template <class T>
+T ReadValue(const std::string& str, size_t* pos) {
+  T value;
+  memcpy(&value, str.data() + *pos, sizeof(value));
+  *pos += sizeof(value);
+  return value;
+}
+
+}  // namespace
+
+TEST_F(LogExportWriterTest, ParseFormat) {
+  LogExportWriter::Format format = LogExportWriter::CSV;
+  EXPECT_TRUE(LogExportWriter::ParseFormat("jsonl", &format));
+  EXPECT_EQ(LogExportWriter::JSON_LINES, format);
+  EXPECT_TRUE(LogExportWriter::ParseFormat("binary", &format));
+  EXPECT_EQ(LogExportWriter::BINARY, format);
+  EXPECT_TRUE(LogExportWriter::ParseFormat("csv", &format));
+  EXPECT_EQ(LogExportWriter::CSV, format);
+  EXPECT_FALSE(LogExportWriter::ParseFormat("xml", &format));
+}
+
+TEST_F(LogExportWriterTest, Csv) {
+  {
+    LogExportWriter writer(LogExportWriter::CSV, &output_,
+                           LogExportWriter::kDefaultBufferSize);
+    writer.OnLogMessage(message_);
+    SetMessage("file.cc", "Commas, and \"quotes\"");
+    writer.OnLogMessage(message_);
+    writer.OnTraceEventBegin(trace_);
+    EXPECT_EQ(3U, writer.num_rows());
+
+    // Nothing is written until the buffer fills or is flushed.
+    EXPECT_EQ(0U, output_.num_writes());
+  }
+
+  EXPECT_EQ(1U, output_.num_writes());
+  EXPECT_EQ("type,time,level,pid,tid,file,line,message,id\n"
+            "log," + time_ + ",4,10,11,file.cc,42,A message,\n"
+            "log," + time_ + ",4,10,11,file.cc,42,"
+                "\"Commas, and \"\"quotes\"\"\",\n"
+            "begin," + time_ + ",5,20,21,Name,0,,4660\n",
+            output_.str());
+}
+
+TEST_F(LogExportWriterTest, JsonLines) {
+  {
+    LogExportWriter writer(LogExportWriter::JSON_LINES, &output_,
+                           LogExportWriter::kDefaultBufferSize);
+    SetMessage("c:\\file.cc", "A \"line\"\nand\x01");
+    writer.OnLogMessage(message_);
+    writer.OnTraceEventEnd(trace_);
+  }
+
+  EXPECT_EQ("{\"type\":\"log\",\"time\":\"" + time_ + "\",\"level\":4,"
+            "\"pid\":10,\"tid\":11,\"file\":\"c:\\\\file.cc\",\"line\":42,"
+            "\"message\":\"A \\\"line\\\"\\nand\\u0001\"}\n"
+            "{\"type\":\"end\",\"time\":\"" + time_ + "\",\"level\":5,"
+            "\"pid\":20,\"tid\":21,\"name\":\"Name\",\"id\":4660,"
+            "\"extra\":\"\"}\n",
+            output_.str());
+}
+
+TEST_F(LogExportWriterTest, Binary) {
+  {
+    LogExportWriter writer(LogExportWriter::BINARY, &output_,
+                           LogExportWriter::kDefaultBufferSize);
+    writer.OnLogMessage(message_);
+    writer.OnTraceEventInstant(trace_);
+  }
+
+  const std::string& str = output_.str();
+  size_t pos = 0;
+  ASSERT_EQ(2 * sizeof(uint32) +
+            2 * (sizeof(int64) + 2 * sizeof(uint8) + 5 * sizeof(uint32) +
+                 sizeof(uint64)) +
+            strlen("file.ccName") + strlen("A message"),
+            str.size());
+  EXPECT_EQ(LogExportWriter::kBlockMagic, ReadValue<uint32>(str, &pos));
+  EXPECT_EQ(2U, ReadValue<uint32>(str, &pos));
+  EXPECT_EQ(message_.time.ToInternalValue(), ReadValue<int64>(str, &pos));
+  pos += sizeof(int64);
+  EXPECT_EQ(LogExportWriter::LOG_ROW, ReadValue<uint8>(str, &pos));
+  EXPECT_EQ(LogExportWriter::INSTANT_ROW, ReadValue<uint8>(str, &pos));
+  EXPECT_EQ(4, ReadValue<uint8>(str, &pos));
+  EXPECT_EQ(5, ReadValue<uint8>(str, &pos));
+  EXPECT_EQ(10U, ReadValue<uint32>(str, &pos));
+  EXPECT_EQ(20U, ReadValue<uint32>(str, &pos));
+  pos += 2 * sizeof(uint32);
+  EXPECT_EQ(42U, ReadValue<uint32>(str, &pos));
+  EXPECT_EQ(0U, ReadValue<uint32>(str, &pos));
+  EXPECT_EQ(0U, ReadValue<uint64>(str, &pos));
+  EXPECT_EQ(0x1234U, ReadValue<uint64>(str, &pos));
+  EXPECT_EQ(7U, ReadValue<uint32>(str, &pos));
+  EXPECT_EQ(4U, ReadValue<uint32>(str, &pos));
+  EXPECT_EQ(9U, ReadValue<uint32>(str, &pos));
+  EXPECT_EQ(0U, ReadValue<uint32>(str, &pos));
+  EXPECT_EQ("file.ccNameA message", str.substr(pos));
+}
+
+TEST_F(LogExportWriterTest, BinaryBlocks) {
+  {
+    LogExportWriter writer(LogExportWriter::BINARY, &output_,
+                           LogExportWriter::kDefaultBufferSize);
+    for (size_t i = 0; i < LogExportWriter::kRowsPerBlock + 1; ++i)
+      writer.OnLogMessage(message_);
+  }
+
+  // A full block, then a block of one.
+  const std::string& str = output_.str();
+  size_t pos = 0;
+  EXPECT_EQ(LogExportWriter::kBlockMagic, ReadValue<uint32>(str, &pos));
+  EXPECT_EQ(LogExportWriter::kRowsPerBlock, ReadValue<uint32>(str, &pos));
+
+  size_t row_size = sizeof(int64) + 2 * sizeof(uint8) + 5 * sizeof(uint32) +
+      sizeof(uint64) + strlen("file.ccA message");
+  pos += LogExportWriter::kRowsPerBlock * row_size;
+  EXPECT_EQ(LogExportWriter::kBlockMagic, ReadValue<uint32>(str, &pos));
+  EXPECT_EQ(1U, ReadValue<uint32>(str, &pos));
+  EXPECT_EQ(pos + row_size, str.size());
+}
+
+TEST_F(LogExportWriterTest, WritesWhenFull) {
+  const size_t kBufferSize = 1024;
+  std::string expected;
+  {
+    LogExportWriter writer(LogExportWriter::CSV, &output_, kBufferSize);
+    expected = "type,time,level,pid,tid,file,line,message,id\n";
+    for (size_t i = 0; i < 100; ++i) {
+      writer.OnLogMessage(message_);
+      expected += "log," + time_ + ",4,10,11,file.cc,42,A message,\n";
+    }
+
+    // A message too big for the buffer goes straight through.
+    std::string big(2 * kBufferSize, 'x');
+    SetMessage("file.cc", big.c_str());
+    writer.OnLogMessage(message_);
+    expected += "log," + time_ + ",4,10,11,file.cc,42," + big + ",\n";
+
+    EXPECT_TRUE(writer.Flush());
+  }
+
+  EXPECT_LT(1U, output_.num_writes());
+  EXPECT_EQ(expected, output_.str());
+}
+
+TEST_F(LogExportWriterTest, OutputFailure) {
+  LogExportWriter writer(LogExportWriter::CSV, &output_,
+                         LogExportWriter::kDefaultBufferSize);
+  writer.OnLogMessage(message_);
+  output_.set_fail(true);
+  EXPECT_FALSE(writer.Flush());
+  EXPECT_TRUE(writer.failed());
+
+  // Once failed, nothing more is written.
+  output_.set_fail(false);
+  writer.OnLogMessage(message_);
+  EXPECT_FALSE(writer.Flush());
+  EXPECT_EQ(1U, output_.num_writes());
+}
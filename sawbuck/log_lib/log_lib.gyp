@@ -27,20 +27,92 @@
       'target_name': 'log_lib',
       'type': 'static_library',
       'sources': [
+        'cpu_profile_service.cc',
+        'cpu_profile_service.h',
+        'cpu_timeline_service.cc',
+        'cpu_timeline_service.h',
+        'disk_io_latency_service.cc',
+        'disk_io_latency_service.h',
+        'etl_file_reader.cc',
+        'etl_file_reader.h',
+        'event_clock.cc',
+        'event_clock.h',
+        'event_rate_stats.cc',
+        'event_rate_stats.h',
+        'event_router.cc',
+        'event_router.h',
+        'event_slab.cc',
+        'event_slab.h',
+        'heap_profile_service.cc',
+        'heap_profile_service.h',
+        'heap_trace_session.cc',
+        'heap_trace_session.h',
+        'kernel_capture_profile.cc',
+        'kernel_capture_profile.h',
         'kernel_log_consumer.cc',
         'kernel_log_consumer.h',
+        'latency_histogram.cc',
+        'latency_histogram.h',
         'log_consumer.cc',
         'log_consumer.h',
+        'log_export_reader.cc',
+        'log_export_reader.h',
+        'log_export_writer.cc',
+        'log_export_writer.h',
+        'log_sampler.cc',
+        'log_sampler.h',
+        'log_stream.cc',
+        'log_stream.h',
+        'page_fault_aggregator.cc',
+        'page_fault_aggregator.h',
         'process_info_service.cc',
         'process_info_service.h',
+        'process_memory_service.cc',
+        'process_memory_service.h',
+        'registry_access_service.cc',
+        'registry_access_service.h',
+        'sawbuck_trace_provider.cc',
+        'sawbuck_trace_provider.h',
+        'session_cost_meter.cc',
+        'session_cost_meter.h',
+        'span_index.cc',
+        'span_index.h',
+        'span_regression_detector.cc',
+        'span_regression_detector.h',
+        'stack_symbolizer.cc',
+        'stack_symbolizer.h',
+        'string_table.cc',
+        'string_table.h',
         'symbol_lookup_service.cc',
         'symbol_lookup_service.h',
+        'tdh_event_decoder.cc',
+        'tdh_event_decoder.h',
+        'thread_context_service.cc',
+        'thread_context_service.h',
+        'thread_info_service.cc',
+        'thread_info_service.h',
+        'time_formatter.cc',
+        'time_formatter.h',
+        'trace_flow_matcher.cc',
+        'trace_flow_matcher.h',
+        'trace_json_writer.cc',
+        'trace_json_writer.h',
+        'trace_span_matcher.cc',
+        'trace_span_matcher.h',
+        'working_set_profiler.cc',
+        'working_set_profiler.h',
       ],
       'dependencies': [
         '<(DEPTH)/base/base.gyp:base',
+        '<(DEPTH)/third_party/zlib/zlib.gyp:zlib',
         '../common/common.gyp:common',
         '../sym_util/sym_util.gyp:sym_util',
       ],
+      'link_settings': {
+        'libraries': [
+          '-ltdh.lib',
+        ],
+      },
     },
     {
       'target_name': 'test_common',
@@ -66,11 +138,42 @@
       'target_name': 'log_lib_unittests',
       'type': 'executable',
       'sources': [
+        'cpu_profile_service_unittest.cc',
+        'cpu_timeline_service_unittest.cc',
+        'disk_io_latency_service_unittest.cc',
+        'etl_file_reader_unittest.cc',
+        'event_clock_unittest.cc',
+        'event_rate_stats_unittest.cc',
+        'event_router_unittest.cc',
+        'event_slab_unittest.cc',
+        'heap_profile_service_unittest.cc',
+        'kernel_capture_profile_unittest.cc',
         'kernel_log_consumer_unittest.cc',
+        'latency_histogram_unittest.cc',
         'log_consumer_unittest.cc',
+        'log_export_reader_unittest.cc',
+        'log_export_writer_unittest.cc',
         'log_lib_unittest_main.cc',
+        'log_sampler_unittest.cc',
+        'log_stream_unittest.cc',
+        'page_fault_aggregator_unittest.cc',
         'process_info_service_unittest.cc',
+        'process_memory_service_unittest.cc',
+        'registry_access_service_unittest.cc',
+        'session_cost_meter_unittest.cc',
+        'span_index_unittest.cc',
+        'span_regression_detector_unittest.cc',
+        'stack_symbolizer_unittest.cc',
+        'string_table_unittest.cc',
         'symbol_lookup_service_unittest.cc',
+        'tdh_event_decoder_unittest.cc',
+        'thread_context_service_unittest.cc',
+        'thread_info_service_unittest.cc',
+        'time_formatter_unittest.cc',
+        'trace_flow_matcher_unittest.cc',
+        'trace_json_writer_unittest.cc',
+        'trace_span_matcher_unittest.cc',
+        'working_set_profiler_unittest.cc',
       ],
       'dependencies': [
         'log_lib',
@@ -80,6 +183,22 @@
         '<(DEPTH)/testing/gtest.gyp:gtest',
       ],
     },
+    {
+      'target_name': 'capture_agent',
+      'type': 'executable',
+      'sources': [
+        'capture_agent_main.cc',
+      ],
+      'dependencies': [
+        'log_lib',
+        '<(DEPTH)/base/base.gyp:base',
+      ],
+      'link_settings': {
+        'libraries': [
+          '-lws2_32.lib',
+        ],
+      },
+    },
     {
       'target_name': 'dump_logs',
       'type': 'executable',
@@ -88,9 +207,42 @@
       ],
       'dependencies': [
         'log_lib',
+        '../viewer/viewer.gyp:viewer_lib',
         '<(DEPTH)/base/base.gyp:base',
       ],          
     },
+    {
+      'target_name': 'kernel_storm',
+      'type': 'executable',
+      'sources': [
+        'kernel_storm_main.cc',
+      ],
+      'dependencies': [
+        '<(DEPTH)/base/base.gyp:base',
+      ],
+    },
+    {
+      'target_name': 'log_lib_benchmarks',
+      'type': 'executable',
+      'sources': [
+        'log_lib_benchmarks_main.cc',
+      ],
+      'dependencies': [
+        'log_lib',
+        '<(DEPTH)/base/base.gyp:base',
+      ],
+    },
+    {
+      'target_name': 'symbol_lookup_benchmark',
+      'type': 'executable',
+      'sources': [
+        'symbol_lookup_benchmark_main.cc',
+      ],
+      'dependencies': [
+        'log_lib',
+        '<(DEPTH)/base/base.gyp:base',
+      ],
+    },
     {
       'target_name': 'test_logger',
       'type': 'executable',
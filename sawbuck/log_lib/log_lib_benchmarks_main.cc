@@ -0,0 +1,400 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Measures the throughput of the log parsers on synthetic events, and on
+// the events of any log files given on the command line. Each benchmark
+// reports events per second, bytes of event data per second, and heap
+// allocations per event. With --64-bit-log the kernel events of the files
+// are taken to have the 64 bit layouts, as kernel_storm --64-bit writes.
+//
+// Usage: log_lib_benchmarks [--iterations=N] [--64-bit-log] [file.etl ...]
+#include <stdio.h>
+#include <algorithm>
+#include <new>
+#include <vector>
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/debug/trace_event_win.h"
+#include "base/files/file_path.h"
+#include "base/logging.h"
+#include "base/logging_win.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/time/time.h"
+#include "sawbuck/common/buffer_parser.h"
+#include "sawbuck/log_lib/etl_file_reader.h"
+#include "sawbuck/log_lib/event_router.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/log_lib/kernel_log_types.h"
+#include "sawbuck/log_lib/log_consumer.h"
+
+namespace {
+
+// The number of heap allocations made, counted by our operator new.
+size_t num_allocations = 0;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  ++num_allocations;
+  void* ptr = malloc(size);
+  if (ptr == NULL)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void* ptr) {
+  free(ptr);
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete[](void* ptr) {
+  operator delete(ptr);
+}
+
+namespace {
+
+const size_t kDefaultIterations = 1000000;
+
+const char kMessage[] = "A log message of a typical length, with some "
+                        "formatted values 1234 and 0x5678 in it.";
+const char kFile[] = "c:\\src\\chrome\\browser\\browser_process_impl.cc";
+const char kTraceName[] = "BrowserProcessImpl::CreateResourceDispatcher";
+const char kTraceExtra[] = "";
+const DWORD kLine = 123;
+const size_t kStackDepth = 20;
+
+// Discards all the events it receives.
+class NullSink
+    : public LogEvents,
+      public TraceEvents,
+      public KernelPageFaultEvents {
+ public:
+  // LogEvents implementation.
+  virtual void OnLogMessage(const LogMessage& log_message) {}
+
+  // TraceEvents implementation.
+  virtual void OnTraceEventBegin(const TraceMessage& trace_message) {}
+  virtual void OnTraceEventEnd(const TraceMessage& trace_message) {}
+  virtual void OnTraceEventInstant(const TraceMessage& trace_message) {}
+
+  // KernelPageFaultEvents implementation.
+  virtual void OnTransitionFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter) {}
+  virtual void OnDemandZeroFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter) {}
+  virtual void OnCopyOnWriteFault(DWORD process_id,
+                                  DWORD thread_id,
+                                  const base::Time& time,
+                                  sym_util::Address address,
+                                  sym_util::Address program_counter) {}
+  virtual void OnGuardPageFault(DWORD process_id,
+                                DWORD thread_id,
+                                const base::Time& time,
+                                sym_util::Address address,
+                                sym_util::Address program_counter) {}
+  virtual void OnHardFault(DWORD process_id,
+                           DWORD thread_id,
+                           const base::Time& time,
+                           sym_util::Address address,
+                           sym_util::Address program_counter) {}
+  virtual void OnAccessViolationFault(DWORD process_id,
+                                      DWORD thread_id,
+                                      const base::Time& time,
+                                      sym_util::Address address,
+                                      sym_util::Address program_counter) {}
+  virtual void OnHardPageFault(DWORD thread_id,
+                               const base::Time& time,
+                               const base::Time& initial_time,
+                               sym_util::Offset offset,
+                               sym_util::Address address,
+                               sym_util::Address file_object,
+                               sym_util::ByteCount byte_count) {}
+};
+
+// The parsers, wired to a null sink and routed to as dump_logs does.
+class NullConsumer : public KernelLogParser, public LogParser {
+ public:
+  NullConsumer() {
+    LogParser::AddEventClasses(&router_);
+    KernelLogParser::AddEventClasses(&router_);
+
+    set_event_sink(&sink_);
+    set_trace_sink(&sink_);
+    set_page_fault_event_sink(&sink_);
+  }
+
+  bool ProcessOneEvent(EVENT_TRACE* event) {
+    return router_.ProcessOneEvent(event);
+  }
+
+ private:
+  NullSink sink_;
+  EventRouter router_;
+};
+
+// Prints a benchmark's results.
+void Report(const char* name,
+            size_t num_events,
+            size_t num_bytes,
+            size_t num_allocs,
+            base::TimeDelta elapsed) {
+  double seconds = std::max(elapsed.InSecondsF(), 1e-9);
+  printf("%-32s %12.0f %12.0f %8.2f\n",
+         name,
+         num_events / seconds,
+         num_bytes / seconds,
+         num_events == 0 ? 0.0 : static_cast<double>(num_allocs) / num_events);
+}
+
+// An event of our log or trace providers, with its data.
+class SyntheticEvent {
+ public:
+  SyntheticEvent(const GUID& event_class, UCHAR type) {
+    memset(&event_, 0, sizeof(event_));
+    event_.Header.Size = sizeof(event_);
+    event_.Header.Guid = event_class;
+    event_.Header.Class.Type = type;
+    event_.Header.Class.Level = TRACE_LEVEL_INFORMATION;
+    event_.Header.ProcessId = ::GetCurrentProcessId();
+    event_.Header.ThreadId = ::GetCurrentThreadId();
+    reinterpret_cast<FILETIME&>(event_.Header.TimeStamp) =
+        base::Time::Now().ToFileTime();
+  }
+
+  // Appends @p len bytes at @p data to the event data.
+  void Append(const void* data, size_t len) {
+    const char* bytes = reinterpret_cast<const char*>(data);
+    data_.insert(data_.end(), bytes, bytes + len);
+  }
+  template <class T>
+  void Append(const T& value) { Append(&value, sizeof(value)); }
+  void AppendString(const char* str) { Append(str, strlen(str) + 1); }
+
+  // Appends a stack trace of kStackDepth made up frames, prefixed by
+  // its depth.
+  void AppendStackTrace() {
+    Append(static_cast<DWORD>(kStackDepth));
+    for (size_t i = 0; i < kStackDepth; ++i)
+      Append(reinterpret_cast<void*>(0x10000000 + i * 0x100));
+  }
+
+  EVENT_TRACE* Get() {
+    event_.MofData = data_.empty() ? NULL : &data_[0];
+    event_.MofLength = data_.size();
+    return &event_;
+  }
+
+ private:
+  EVENT_TRACE event_;
+  std::vector<char> data_;
+};
+
+// Runs @p event through @p consumer @p iterations times.
+void BenchmarkEvent(const char* name,
+                    SyntheticEvent* event,
+                    NullConsumer* consumer,
+                    size_t iterations) {
+  EVENT_TRACE* trace = event->Get();
+  size_t allocs = num_allocations;
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  for (size_t i = 0; i < iterations; ++i) {
+    if (!consumer->ProcessOneEvent(trace)) {
+      printf("%s: the event was not handled.\n", name);
+      return;
+    }
+  }
+  base::TimeDelta elapsed = base::TimeTicks::HighResNow() - start;
+
+  Report(name, iterations, iterations * trace->MofLength,
+         num_allocations - allocs, elapsed);
+}
+
+// Reads the fields of a full log message with a BinaryBufferReader, rather
+// than through the parser.
+void BenchmarkBufferReader(SyntheticEvent* event, size_t iterations) {
+  EVENT_TRACE* trace = event->Get();
+  size_t allocs = num_allocations;
+  size_t total_len = 0;
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  for (size_t i = 0; i < iterations; ++i) {
+    BinaryBufferReader reader(trace->MofData, trace->MofLength);
+    const DWORD* depth = NULL;
+    const void* traces = NULL;
+    const DWORD* line = NULL;
+    const char* file = NULL;
+    size_t file_len = 0;
+    const char* message = NULL;
+    size_t message_len = 0;
+    if (!reader.Read(&depth) ||
+        !reader.Read(*depth * sizeof(void*), &traces) ||
+        !reader.Read(&line) ||
+        !reader.ReadString(&file, &file_len) ||
+        !reader.ReadString(&message, &message_len)) {
+      printf("BinaryBufferReader: the event failed to read.\n");
+      return;
+    }
+    total_len += file_len + message_len;
+  }
+  base::TimeDelta elapsed = base::TimeTicks::HighResNow() - start;
+
+  // Use the lengths, lest the reads be optimized away.
+  CHECK_EQ(iterations * (strlen(kFile) + strlen(kMessage)), total_len);
+  Report("BinaryBufferReader", iterations, iterations * trace->MofLength,
+         num_allocations - allocs, elapsed);
+}
+
+// Tallies the events and bytes of a log file while routing them.
+class LogFileSink : public EtlEventSink {
+ public:
+  explicit LogFileSink(NullConsumer* consumer)
+      : consumer_(consumer), num_events_(0), num_bytes_(0) {
+  }
+
+  // EtlEventSink implementation.
+  virtual void OnEvent(EVENT_TRACE* event) {
+    consumer_->ProcessOneEvent(event);
+    ++num_events_;
+    num_bytes_ += event->MofLength;
+  }
+
+  size_t num_events() const { return num_events_; }
+  size_t num_bytes() const { return num_bytes_; }
+
+ private:
+  NullConsumer* consumer_;
+  size_t num_events_;
+  size_t num_bytes_;
+};
+
+// Replays the events of the log file at @p path through @p consumer.
+// The file is read once up front to make sure it's in the file cache.
+void BenchmarkLogFile(const base::FilePath& path, NullConsumer* consumer) {
+  EtlFileReader reader;
+  HRESULT hr = reader.Open(path);
+  if (FAILED(hr)) {
+    printf("Error 0x%08X opening \"%ls\".\n", hr, path.value().c_str());
+    return;
+  }
+
+  LogFileSink warm_up(consumer);
+  reader.Consume(&warm_up);
+
+  LogFileSink sink(consumer);
+  size_t allocs = num_allocations;
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  hr = reader.Consume(&sink);
+  base::TimeDelta elapsed = base::TimeTicks::HighResNow() - start;
+  if (FAILED(hr)) {
+    printf("Error 0x%08X reading \"%ls\".\n", hr, path.value().c_str());
+    return;
+  }
+
+  Report(base::WideToUTF8(path.BaseName().value()).c_str(),
+         sink.num_events(), sink.num_bytes(), num_allocations - allocs,
+         elapsed);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  CommandLine::Init(argc, argv);
+
+  const CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  unsigned iterations = kDefaultIterations;
+  if (cmd_line->HasSwitch("iterations") &&
+      (!base::StringToUint(cmd_line->GetSwitchValueASCII("iterations"),
+                           &iterations) || iterations == 0)) {
+    printf("The number of iterations must be a positive number.\n");
+    return 1;
+  }
+
+  NullConsumer consumer;
+
+  SyntheticEvent message(logging::kLogEventId, logging::LOG_MESSAGE);
+  message.AppendString(kMessage);
+
+  SyntheticEvent stack_message(logging::kLogEventId,
+                               logging::LOG_MESSAGE_WITH_STACKTRACE);
+  stack_message.AppendStackTrace();
+  stack_message.AppendString(kMessage);
+
+  SyntheticEvent full_message(logging::kLogEventId, logging::LOG_MESSAGE_FULL);
+  full_message.AppendStackTrace();
+  full_message.Append(kLine);
+  full_message.AppendString(kFile);
+  full_message.AppendString(kMessage);
+
+  const UCHAR kTraceTypes[] = {
+    base::debug::kTraceEventTypeBegin,
+    base::debug::kTraceEventTypeEnd,
+    base::debug::kTraceEventTypeInstant,
+  };
+  const char* kTraceNames[] = {
+    "TRACE_EVENT_BEGIN",
+    "TRACE_EVENT_END",
+    "TRACE_EVENT_INSTANT",
+  };
+  COMPILE_ASSERT(arraysize(kTraceTypes) == arraysize(kTraceNames),
+                 trace_types_mismatch);
+
+  kernel_log_types::PageFault32V2 fault = { 0x10001000, 0x20002000 };
+  SyntheticEvent fault_event(kernel_log_types::kPageFaultEventClass,
+                             kernel_log_types::kTransitionFaultEvent);
+  fault_event.Append(fault);
+  fault_event.Get()->Header.Class.Version = 2;
+
+  printf("%-32s %12s %12s %8s\n",
+         "Benchmark", "Events/s", "Bytes/s", "Allocs");
+  BenchmarkEvent("LOG_MESSAGE", &message, &consumer, iterations);
+  BenchmarkEvent("LOG_MESSAGE_WITH_STACKTRACE", &stack_message, &consumer,
+                 iterations);
+  BenchmarkEvent("LOG_MESSAGE_FULL", &full_message, &consumer, iterations);
+  // As for a sink that only counts by level and process.
+  NullConsumer counting_consumer;
+  counting_consumer.set_log_fields(0);
+  BenchmarkEvent("LOG_MESSAGE_FULL, no fields", &full_message,
+                 &counting_consumer, iterations);
+  for (size_t i = 0; i < arraysize(kTraceTypes); ++i) {
+    SyntheticEvent trace(base::debug::kTraceEventClass32, kTraceTypes[i]);
+    trace.AppendString(kTraceName);
+    trace.Append(static_cast<uint32>(0x1234));
+    trace.AppendString(kTraceExtra);
+    BenchmarkEvent(kTraceNames[i], &trace, &consumer, iterations);
+  }
+  BenchmarkEvent("Kernel transition fault", &fault_event, &consumer,
+                 iterations);
+  BenchmarkBufferReader(&full_message, iterations);
+
+  NullConsumer file_consumer;
+  if (cmd_line->HasSwitch("64-bit-log")) {
+    file_consumer.set_infer_bitness_from_log(false);
+    file_consumer.set_is_64_bit_log(true);
+  }
+  std::vector<std::wstring> args = cmd_line->GetArgs();
+  for (size_t i = 0; i < args.size(); ++i)
+    BenchmarkLogFile(base::FilePath(args[i]), &file_consumer);
+
+  return 0;
+}
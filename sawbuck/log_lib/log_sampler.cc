@@ -0,0 +1,173 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log message sampler implementation.
+#include "sawbuck/log_lib/log_sampler.h"
+
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+
+bool LogSampler::SiteKey::operator<(const SiteKey& other) const {
+  if (process_id != other.process_id)
+    return process_id < other.process_id;
+  if (file != other.file)
+    return file < other.file;
+  return line < other.line;
+}
+
+LogSampler::LogSampler(LogEvents* sink) : sink_(sink), rate_limit_(0) {
+  DCHECK(sink != NULL);
+}
+
+LogSampler::~LogSampler() {
+}
+
+void LogSampler::set_rules(const std::vector<Rule>& rules) {
+  rules_ = rules;
+  stats_.rules.assign(rules_.size(), RuleStats());
+  PublishStats();
+}
+
+bool LogSampler::ParseRules(const std::string& spec,
+                            std::vector<Rule>* rules) {
+  DCHECK(rules != NULL);
+  rules->clear();
+
+  std::vector<std::string> rule_specs;
+  base::SplitString(spec, ';', &rule_specs);
+  for (size_t i = 0; i < rule_specs.size(); ++i) {
+    // Tolerate a trailing separator.
+    if (rule_specs[i].empty())
+      continue;
+
+    Rule rule;
+    std::vector<std::string> terms;
+    base::SplitString(rule_specs[i], ',', &terms);
+    for (size_t j = 0; j < terms.size(); ++j) {
+      size_t equals = terms[j].find('=');
+      if (equals == std::string::npos)
+        return false;
+
+      std::string key(terms[j].substr(0, equals));
+      std::string value(terms[j].substr(equals + 1));
+      unsigned number = 0;
+      if (key == "file") {
+        rule.file = value;
+      } else if (!base::StringToUint(value, &number)) {
+        return false;
+      } else if (key == "pid") {
+        rule.process_id = number;
+      } else if (key == "level" && number <= 0xFF) {
+        rule.min_level = static_cast<UCHAR>(number);
+      } else if (key == "one_in" && number != 0) {
+        rule.one_in = number;
+      } else {
+        return false;
+      }
+    }
+
+    rules->push_back(rule);
+  }
+
+  return true;
+}
+
+bool LogSampler::IsSampling() const {
+  return !rules_.empty() || rate_limit_ != 0;
+}
+
+void LogSampler::GetStats(Stats* stats) const {
+  DCHECK(stats != NULL);
+  base::AutoLock lock(lock_);
+  *stats = published_stats_;
+}
+
+void LogSampler::OnLogMessage(const LogMessage& log_message) {
+  if (Passes(log_message))
+    sink_->OnLogMessage(log_message);
+  PublishStats();
+}
+
+void LogSampler::OnLogMessages(const LogMessage* log_messages,
+                               size_t num_messages) {
+  passed_.clear();
+  for (size_t i = 0; i < num_messages; ++i) {
+    if (Passes(log_messages[i]))
+      passed_.push_back(log_messages[i]);
+  }
+
+  if (!passed_.empty())
+    sink_->OnLogMessages(&passed_[0], passed_.size());
+  PublishStats();
+}
+
+void LogSampler::OnEventLoss(const EventLoss& event_loss) {
+  sink_->OnEventLoss(event_loss);
+}
+
+bool LogSampler::Passes(const LogMessage& log_message) {
+  ++stats_.messages;
+
+  for (size_t i = 0; i < rules_.size(); ++i) {
+    const Rule& rule = rules_[i];
+    if (rule.process_id != 0 && rule.process_id != log_message.process_id)
+      continue;
+    if (rule.min_level != 0 && log_message.level < rule.min_level)
+      continue;
+    if (!rule.file.empty() &&
+        base::StringPiece(log_message.file, log_message.file_len).find(
+            rule.file) == base::StringPiece::npos) {
+      continue;
+    }
+
+    // The first of each run of one_in matches passes.
+    RuleStats& rule_stats = stats_.rules[i];
+    if (rule_stats.matched++ % rule.one_in != 0) {
+      ++rule_stats.dropped;
+      return false;
+    }
+    break;
+  }
+
+  return PassesRateLimit(log_message);
+}
+
+bool LogSampler::PassesRateLimit(const LogMessage& log_message) {
+  if (rate_limit_ == 0)
+    return true;
+
+  SiteKey key = { log_message.process_id, log_message.file_atom,
+                  log_message.line };
+  SiteWindow& window = sites_[key];
+  int64 second = log_message.time.ToInternalValue() /
+      base::Time::kMicrosecondsPerSecond;
+  if (window.second != second) {
+    window.second = second;
+    window.count = 0;
+  }
+
+  if (window.count >= rate_limit_) {
+    ++stats_.rate_limited;
+    return false;
+  }
+
+  ++window.count;
+  return true;
+}
+
+void LogSampler::PublishStats() {
+  base::AutoLock lock(lock_);
+  published_stats_ = stats_;
+}
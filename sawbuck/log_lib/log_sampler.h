@@ -0,0 +1,148 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log message sampler declaration.
+#ifndef SAWBUCK_LOG_LIB_LOG_SAMPLER_H_
+#define SAWBUCK_LOG_LIB_LOG_SAMPLER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/synchronization/lock.h"
+#include "sawbuck/log_lib/log_consumer.h"
+
+// Sits between a LogParser and its sink, and passes only a sample of the
+// log messages of high volume sources. A message is sampled by the first
+// rule it matches, which passes one in so many of the messages it matches.
+// Besides, the messages of any one site, that is of a process, file and
+// line, can be limited to so many a second.
+//
+// The sampler counts what it drops, so that statistics over the messages
+// that passed can be scaled back up.
+//
+// Sites are told apart by the atom of their file, so the parser needs a
+// string table to tell the sites of different files apart.
+class LogSampler : public LogEvents {
+ public:
+  struct Rule {
+    Rule() : process_id(0), min_level(0), one_in(1) {
+    }
+
+    // Matches the messages of this process only, unless zero.
+    DWORD process_id;
+    // Matches the messages of this level or more verbose, unless zero.
+    UCHAR min_level;
+    // Matches the messages whose file contains this, unless empty.
+    std::string file;
+    // Passes one in this many of the matching messages.
+    uint32 one_in;
+  };
+
+  struct RuleStats {
+    RuleStats() : matched(0), dropped(0) {
+    }
+
+    uint64 matched;
+    uint64 dropped;
+  };
+
+  struct Stats {
+    Stats() : messages(0), rate_limited(0) {
+    }
+
+    // All the messages seen.
+    uint64 messages;
+    // The messages dropped by the rate limit.
+    uint64 rate_limited;
+    // The messages matched and dropped by each rule.
+    std::vector<RuleStats> rules;
+  };
+
+  // @param sink receives the messages that pass, must outlive us.
+  explicit LogSampler(LogEvents* sink);
+  virtual ~LogSampler();
+
+  // Sets the rules, before any messages come in.
+  void set_rules(const std::vector<Rule>& rules);
+  const std::vector<Rule>& rules() const { return rules_; }
+
+  // Sets the most messages a second to pass from any one site, zero for
+  // no limit. The seconds go by the time of the messages.
+  void set_rate_limit(uint32 rate_limit) { rate_limit_ = rate_limit; }
+
+  // Parses sampling rules from @p spec, which holds semicolon separated
+  // rules of comma separated "key=value" terms. The keys are pid, level,
+  // file and one_in, e.g. "level=5,one_in=10;file=net\\,one_in=100".
+  // @returns true on success.
+  static bool ParseRules(const std::string& spec, std::vector<Rule>* rules);
+
+  // @returns true iff there's sampling or rate limiting to do.
+  bool IsSampling() const;
+
+  // Gets the counts as of the last batch of messages, may be called on
+  // any thread.
+  void GetStats(Stats* stats) const;
+
+  // LogEvents implementation.
+  virtual void OnLogMessage(const LogMessage& log_message);
+  virtual void OnLogMessages(const LogMessage* log_messages,
+                             size_t num_messages);
+  // Losses always pass.
+  virtual void OnEventLoss(const EventLoss& event_loss);
+
+ private:
+  // @returns true iff @p log_message passes, and counts it.
+  bool Passes(const LogMessage& log_message);
+  // @returns true iff the rate limit passes @p log_message.
+  bool PassesRateLimit(const LogMessage& log_message);
+  // Makes the current counts visible to GetStats.
+  void PublishStats();
+
+  LogEvents* sink_;
+  std::vector<Rule> rules_;
+  uint32 rate_limit_;
+
+  struct SiteKey {
+    bool operator<(const SiteKey& other) const;
+
+    DWORD process_id;
+    StringTable::Atom file;
+    int line;
+  };
+  struct SiteWindow {
+    SiteWindow() : second(0), count(0) {
+    }
+
+    // The second the count is for, in the time of the messages.
+    int64 second;
+    uint32 count;
+  };
+  typedef std::map<SiteKey, SiteWindow> SiteMap;
+  SiteMap sites_;
+
+  // The messages of a batch that pass, reused across batches.
+  std::vector<LogMessage> passed_;
+
+  // Our counts, owned by the thread that issues messages to us.
+  Stats stats_;
+
+  // Protects published_stats_.
+  mutable base::Lock lock_;
+  Stats published_stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogSampler);
+};
+
+#endif  // SAWBUCK_LOG_LIB_LOG_SAMPLER_H_
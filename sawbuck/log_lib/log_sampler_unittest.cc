@@ -0,0 +1,136 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log message sampler unittests.
+#include "sawbuck/log_lib/log_sampler.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class CountingSink : public LogEvents {
+ public:
+  CountingSink() : messages_(0) {
+  }
+
+  virtual void OnLogMessage(const LogMessage& log_message) {
+    ++messages_;
+  }
+
+  int messages_;
+};
+
+class LogSamplerTest: public testing::Test {
+ public:
+  LogSamplerTest() : sampler_(&sink_), t0_(base::Time::Now()) {
+  }
+
+  // Issues @p count messages from @p file at @p level, at @p ms
+  // milliseconds past t0_, in one batch.
+  void Issue(const char* file, int line, UCHAR level, int ms, int count) {
+    std::vector<LogEvents::LogMessage> messages(count);
+    for (int i = 0; i < count; ++i) {
+      messages[i].time = t0_ + base::TimeDelta::FromMilliseconds(ms);
+      messages[i].level = level;
+      messages[i].process_id = 1;
+      messages[i].file = file;
+      messages[i].file_len = strlen(file);
+      // The sampler tells sites apart by atom.
+      messages[i].file_atom = file[0];
+      messages[i].line = line;
+    }
+    sampler_.OnLogMessages(&messages[0], messages.size());
+  }
+
+ protected:
+  CountingSink sink_;
+  LogSampler sampler_;
+  const base::Time t0_;
+};
+
+}  // namespace
+
+TEST(LogSamplerParseTest, ParseRules) {
+  std::vector<LogSampler::Rule> rules;
+  ASSERT_TRUE(LogSampler::ParseRules(
+      "level=5,one_in=10; file=net\\,pid=12,one_in=100;", &rules));
+  ASSERT_EQ(2U, rules.size());
+  EXPECT_EQ(5, rules[0].min_level);
+  EXPECT_EQ(10U, rules[0].one_in);
+  EXPECT_TRUE(rules[0].file.empty());
+  EXPECT_EQ("net\\", rules[1].file);
+  EXPECT_EQ(12U, rules[1].process_id);
+  EXPECT_EQ(100U, rules[1].one_in);
+
+  ASSERT_TRUE(LogSampler::ParseRules("", &rules));
+  EXPECT_TRUE(rules.empty());
+
+  EXPECT_FALSE(LogSampler::ParseRules("level", &rules));
+  EXPECT_FALSE(LogSampler::ParseRules("one_in=0", &rules));
+  EXPECT_FALSE(LogSampler::ParseRules("level=x", &rules));
+  EXPECT_FALSE(LogSampler::ParseRules("color=5", &rules));
+}
+
+TEST_F(LogSamplerTest, PassesAllWithoutRules) {
+  EXPECT_FALSE(sampler_.IsSampling());
+  Issue("a.cc", 1, 5, 0, 10);
+  EXPECT_EQ(10, sink_.messages_);
+}
+
+TEST_F(LogSamplerTest, SamplesByFirstMatchingRule) {
+  std::vector<LogSampler::Rule> rules;
+  ASSERT_TRUE(LogSampler::ParseRules("file=net,one_in=10;level=5,one_in=2",
+                                     &rules));
+  sampler_.set_rules(rules);
+  EXPECT_TRUE(sampler_.IsSampling());
+
+  // All of these match the first rule.
+  Issue("net\\x.cc", 1, 5, 0, 100);
+  EXPECT_EQ(10, sink_.messages_);
+  // These match the second.
+  Issue("b.cc", 1, 5, 0, 100);
+  EXPECT_EQ(60, sink_.messages_);
+  // And these neither.
+  Issue("b.cc", 1, 2, 0, 100);
+  EXPECT_EQ(160, sink_.messages_);
+
+  LogSampler::Stats stats;
+  sampler_.GetStats(&stats);
+  EXPECT_EQ(300U, stats.messages);
+  ASSERT_EQ(2U, stats.rules.size());
+  EXPECT_EQ(100U, stats.rules[0].matched);
+  EXPECT_EQ(90U, stats.rules[0].dropped);
+  EXPECT_EQ(100U, stats.rules[1].matched);
+  EXPECT_EQ(50U, stats.rules[1].dropped);
+  EXPECT_EQ(0U, stats.rate_limited);
+}
+
+TEST_F(LogSamplerTest, RateLimitsBySite) {
+  sampler_.set_rate_limit(5);
+  EXPECT_TRUE(sampler_.IsSampling());
+
+  Issue("a.cc", 1, 5, 0, 20);
+  EXPECT_EQ(5, sink_.messages_);
+  // Another line is another site.
+  Issue("a.cc", 2, 5, 0, 20);
+  EXPECT_EQ(10, sink_.messages_);
+  // And the next second starts over.
+  Issue("a.cc", 1, 5, 1000, 20);
+  EXPECT_EQ(15, sink_.messages_);
+
+  LogSampler::Stats stats;
+  sampler_.GetStats(&stats);
+  EXPECT_EQ(60U, stats.messages);
+  EXPECT_EQ(45U, stats.rate_limited);
+}
@@ -0,0 +1,606 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log stream implementation.
+#include "sawbuck/log_lib/log_stream.h"
+
+#include <string.h>
+#include "base/logging.h"
+#include "sawbuck/common/buffer_parser.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+const size_t kHeaderSize = sizeof(LogStreamBlockHeader);
+
+template <class T>
+void Append(const T& value, std::string* buffer) {
+  buffer->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+void AppendColumn(const std::vector<T>& column, std::string* buffer) {
+  if (!column.empty()) {
+    buffer->append(reinterpret_cast<const char*>(&column[0]),
+                   column.size() * sizeof(column[0]));
+  }
+}
+
+void AppendString(const base::StringPiece& str, std::string* buffer) {
+  Append(static_cast<uint32>(str.size()), buffer);
+  buffer->append(str.data(), str.size());
+}
+
+void AppendString(const std::wstring& str, std::string* buffer) {
+  Append(static_cast<uint32>(str.size()), buffer);
+  buffer->append(reinterpret_cast<const char*>(str.data()),
+                 str.size() * sizeof(wchar_t));
+}
+
+// The block payload is read straight from the inflated buffer, which
+// keeps no alignment past its columns, so values are copied out.
+template <class T>
+bool Read(BinaryBufferReader* reader, T* value) {
+  const void* data = NULL;
+  if (!reader->Read(sizeof(*value), &data))
+    return false;
+
+  memcpy(value, data, sizeof(*value));
+  return true;
+}
+
+template <class T>
+bool ReadColumn(BinaryBufferReader* reader, size_t count, const T** column) {
+  return reader->Read(count * sizeof(T), column);
+}
+
+template <class CharType>
+bool ReadString(BinaryBufferReader* reader,
+                std::basic_string<CharType>* str) {
+  // The length is checked against the bytes left before it's scaled, as
+  // the byte count of a corrupt length can overflow in 32-bit builds.
+  uint32 len = 0;
+  const void* data = NULL;
+  if (!Read(reader, &len) ||
+      len > reader->RemainingBytes() / sizeof(CharType) ||
+      !reader->Read(len * sizeof(CharType), &data)) {
+    return false;
+  }
+
+  str->resize(len);
+  if (len != 0)
+    memcpy(&(*str)[0], data, len * sizeof(CharType));
+  return true;
+}
+
+}  // namespace
+
+const size_t LogStreamWriter::kRowsPerBlock;
+const uint32 LogStreamWriter::kBlockMagic;
+const uint32 LogStreamWriter::kVersion;
+const uint32 LogStreamWriter::kMaxPayloadSize;
+
+LogStreamWriter::LogStreamWriter(Output* output)
+    : output_(output), num_new_strings_(0), num_kernel_events_(0),
+      payload_bytes_(0), bytes_written_(0), failed_(false) {
+  DCHECK(output != NULL);
+}
+
+LogStreamWriter::~LogStreamWriter() {
+  Flush();
+}
+
+bool LogStreamWriter::Flush() {
+  if (times_.empty() && num_kernel_events_ == 0 && num_new_strings_ == 0)
+    return !failed_;
+
+  std::string payload;
+  Append(static_cast<uint32>(times_.size()), &payload);
+  Append(static_cast<uint32>(traces_.size()), &payload);
+  Append(num_new_strings_, &payload);
+  Append(num_kernel_events_, &payload);
+  AppendColumn(times_, &payload);
+  AppendColumn(ids_, &payload);
+  AppendColumn(traces_, &payload);
+  AppendColumn(process_ids_, &payload);
+  AppendColumn(thread_ids_, &payload);
+  AppendColumn(lines_, &payload);
+  AppendColumn(string_ids_column_, &payload);
+  AppendColumn(message_lens_, &payload);
+  AppendColumn(trace_depths_, &payload);
+  AppendColumn(types_, &payload);
+  AppendColumn(levels_, &payload);
+  payload.append(messages_);
+  payload.append(new_strings_);
+  payload.append(kernel_events_);
+
+  times_.clear();
+  ids_.clear();
+  traces_.clear();
+  process_ids_.clear();
+  thread_ids_.clear();
+  lines_.clear();
+  string_ids_column_.clear();
+  message_lens_.clear();
+  trace_depths_.clear();
+  types_.clear();
+  levels_.clear();
+  messages_.clear();
+  new_strings_.clear();
+  num_new_strings_ = 0;
+  kernel_events_.clear();
+  num_kernel_events_ = 0;
+
+  if (failed_)
+    return false;
+
+  if (payload.size() > kMaxPayloadSize) {
+    LOG(ERROR) << "Log stream block too large, " << payload.size()
+        << " bytes.";
+    failed_ = true;
+    return false;
+  }
+
+  uLongf compressed_size = compressBound(payload.size());
+  std::string block(kHeaderSize + compressed_size, '\0');
+  int ret = compress2(reinterpret_cast<Bytef*>(&block[kHeaderSize]),
+                      &compressed_size,
+                      reinterpret_cast<const Bytef*>(payload.data()),
+                      payload.size(),
+                      Z_DEFAULT_COMPRESSION);
+  if (ret != Z_OK) {
+    LOG(ERROR) << "Failed to compress log stream block, error " << ret;
+    failed_ = true;
+    return false;
+  }
+  block.resize(kHeaderSize + compressed_size);
+
+  LogStreamBlockHeader header = {};
+  header.magic = kBlockMagic;
+  header.version = kVersion;
+  header.payload_size = static_cast<uint32>(payload.size());
+  header.compressed_size = static_cast<uint32>(compressed_size);
+  memcpy(&block[0], &header, kHeaderSize);
+
+  if (!output_->Write(block.data(), block.size())) {
+    failed_ = true;
+    return false;
+  }
+
+  payload_bytes_ += payload.size();
+  bytes_written_ += block.size();
+  return true;
+}
+
+void LogStreamWriter::OnLogMessage(const LogMessage& log_message) {
+  AddRow(LogExportWriter::LOG_ROW,
+         log_message,
+         base::StringPiece(log_message.file, log_message.file_len),
+         log_message.line,
+         base::StringPiece(log_message.message, log_message.message_len),
+         0);
+}
+
+void LogStreamWriter::OnTraceEventBegin(const TraceMessage& trace_message) {
+  AddTraceRow(LogExportWriter::BEGIN_ROW, trace_message);
+}
+
+void LogStreamWriter::OnTraceEventEnd(const TraceMessage& trace_message) {
+  AddTraceRow(LogExportWriter::END_ROW, trace_message);
+}
+
+void LogStreamWriter::OnTraceEventInstant(
+    const TraceMessage& trace_message) {
+  AddTraceRow(LogExportWriter::INSTANT_ROW, trace_message);
+}
+
+void LogStreamWriter::OnProcessIsRunning(const base::Time& time,
+                                         const ProcessInfo& process_info) {
+  AddProcessEvent(PROCESS_IS_RUNNING, time, process_info, 0);
+}
+
+void LogStreamWriter::OnProcessStarted(const base::Time& time,
+                                       const ProcessInfo& process_info) {
+  AddProcessEvent(PROCESS_STARTED, time, process_info, 0);
+}
+
+void LogStreamWriter::OnProcessEnded(const base::Time& time,
+                                     const ProcessInfo& process_info,
+                                     ULONG exit_status) {
+  AddProcessEvent(PROCESS_ENDED, time, process_info, exit_status);
+}
+
+void LogStreamWriter::OnModuleIsLoaded(DWORD process_id,
+                                       const base::Time& time,
+                                       const ModuleInformation& module_info) {
+  AddModuleEvent(MODULE_IS_LOADED, process_id, time, module_info);
+}
+
+void LogStreamWriter::OnModuleUnload(DWORD process_id,
+                                     const base::Time& time,
+                                     const ModuleInformation& module_info) {
+  AddModuleEvent(MODULE_UNLOAD, process_id, time, module_info);
+}
+
+void LogStreamWriter::OnModuleLoad(DWORD process_id,
+                                   const base::Time& time,
+                                   const ModuleInformation& module_info) {
+  AddModuleEvent(MODULE_LOAD, process_id, time, module_info);
+}
+
+void LogStreamWriter::AddRow(LogExportWriter::RowType type,
+                             const LogMessageBase& event,
+                             const base::StringPiece& str,
+                             int line,
+                             const base::StringPiece& message,
+                             uint64 id) {
+  times_.push_back(event.time.ToInternalValue());
+  ids_.push_back(id);
+  for (size_t i = 0; i < event.trace_depth; ++i)
+    traces_.push_back(reinterpret_cast<uintptr_t>(event.traces[i]));
+  process_ids_.push_back(event.process_id);
+  thread_ids_.push_back(event.thread_id);
+  lines_.push_back(static_cast<uint32>(line));
+  string_ids_column_.push_back(GetStringId(str));
+  message_lens_.push_back(static_cast<uint32>(message.size()));
+  trace_depths_.push_back(static_cast<uint32>(event.trace_depth));
+  types_.push_back(static_cast<uint8>(type));
+  levels_.push_back(event.level);
+  message.AppendToString(&messages_);
+
+  MaybeFlush();
+}
+
+void LogStreamWriter::AddTraceRow(LogExportWriter::RowType type,
+                                  const TraceMessage& trace_message) {
+  AddRow(type,
+         trace_message,
+         base::StringPiece(trace_message.name, trace_message.name_len),
+         0,
+         base::StringPiece(trace_message.extra, trace_message.extra_len),
+         reinterpret_cast<uintptr_t>(trace_message.id));
+}
+
+void LogStreamWriter::AddProcessEvent(KernelEventType type,
+                                      const base::Time& time,
+                                      const ProcessInfo& process_info,
+                                      ULONG exit_status) {
+  Append(static_cast<uint32>(type), &kernel_events_);
+  Append(time.ToInternalValue(), &kernel_events_);
+  Append(process_info.process_id, &kernel_events_);
+  Append(process_info.parent_id, &kernel_events_);
+  Append(process_info.session_id, &kernel_events_);
+  kernel_events_.append(
+      reinterpret_cast<const char*>(&process_info.user_sid),
+      SECURITY_MAX_SID_SIZE);
+  Append(exit_status, &kernel_events_);
+  AppendString(base::StringPiece(process_info.image_name), &kernel_events_);
+  AppendString(process_info.command_line, &kernel_events_);
+  ++num_kernel_events_;
+
+  MaybeFlush();
+}
+
+void LogStreamWriter::AddModuleEvent(KernelEventType type,
+                                     DWORD process_id,
+                                     const base::Time& time,
+                                     const ModuleInformation& module_info) {
+  Append(static_cast<uint32>(type), &kernel_events_);
+  Append(time.ToInternalValue(), &kernel_events_);
+  Append(process_id, &kernel_events_);
+  Append(module_info.base_address, &kernel_events_);
+  Append(module_info.module_size, &kernel_events_);
+  Append(module_info.image_checksum, &kernel_events_);
+  Append(module_info.time_date_stamp, &kernel_events_);
+  AppendString(module_info.image_file_name, &kernel_events_);
+  ++num_kernel_events_;
+
+  MaybeFlush();
+}
+
+void LogStreamWriter::MaybeFlush() {
+  if (times_.size() >= kRowsPerBlock || num_kernel_events_ >= kRowsPerBlock)
+    Flush();
+}
+
+uint32 LogStreamWriter::GetStringId(const base::StringPiece& str) {
+  if (str.empty())
+    return 0;
+
+  std::string key(str.as_string());
+  std::map<std::string, uint32>::const_iterator it(string_ids_.find(key));
+  if (it != string_ids_.end())
+    return it->second;
+
+  uint32 id = static_cast<uint32>(string_ids_.size() + 1);
+  string_ids_.insert(std::make_pair(key, id));
+  AppendString(str, &new_strings_);
+  ++num_new_strings_;
+  return id;
+}
+
+LogStreamReader::LogStreamReader()
+    : event_sink_(NULL), trace_sink_(NULL), process_event_sink_(NULL),
+      module_event_sink_(NULL), string_table_(NULL), strings_(1),
+      atoms_(1, StringTable::kEmptyAtom), failed_(false) {
+}
+
+LogStreamReader::~LogStreamReader() {
+}
+
+bool LogStreamReader::Append(const char* data, size_t len) {
+  if (failed_)
+    return false;
+
+  pending_.append(data, len);
+  size_t pos = 0;
+  std::string payload;
+  while (pending_.size() - pos >= kHeaderSize) {
+    LogStreamBlockHeader header = {};
+    memcpy(&header, pending_.data() + pos, kHeaderSize);
+    if (header.magic != LogStreamWriter::kBlockMagic ||
+        header.version != LogStreamWriter::kVersion ||
+        header.payload_size > LogStreamWriter::kMaxPayloadSize ||
+        header.compressed_size >
+            compressBound(LogStreamWriter::kMaxPayloadSize)) {
+      LOG(ERROR) << "Malformed log stream block header.";
+      failed_ = true;
+      return false;
+    }
+
+    if (pending_.size() - pos - kHeaderSize < header.compressed_size)
+      break;
+
+    payload.resize(header.payload_size);
+    uLongf payload_size = header.payload_size;
+    int ret = uncompress(
+        reinterpret_cast<Bytef*>(payload.empty() ? NULL : &payload[0]),
+        &payload_size,
+        reinterpret_cast<const Bytef*>(pending_.data() + pos + kHeaderSize),
+        header.compressed_size);
+    if (ret != Z_OK || payload_size != header.payload_size ||
+        !ReadPayload(payload)) {
+      LOG(ERROR) << "Malformed log stream block.";
+      failed_ = true;
+      return false;
+    }
+
+    pos += kHeaderSize + header.compressed_size;
+  }
+
+  pending_.erase(0, pos);
+  return true;
+}
+
+bool LogStreamReader::ReadPayload(const std::string& payload) {
+  BinaryBufferReader reader(payload.data(), payload.size());
+
+  uint32 num_rows = 0;
+  uint32 num_traces = 0;
+  uint32 num_strings = 0;
+  uint32 num_kernel_events = 0;
+  if (!Read(&reader, &num_rows) || !Read(&reader, &num_traces) ||
+      !Read(&reader, &num_strings) || !Read(&reader, &num_kernel_events)) {
+    return false;
+  }
+
+  // The counts are checked against the payload size before the columns
+  // are taken, which keeps their byte counts from overflowing.
+  if (num_rows > payload.size() || num_traces > payload.size())
+    return false;
+
+  const int64* times = NULL;
+  const uint64* ids = NULL;
+  const uint64* traces = NULL;
+  const uint32* process_ids = NULL;
+  const uint32* thread_ids = NULL;
+  const uint32* lines = NULL;
+  const uint32* string_ids = NULL;
+  const uint32* message_lens = NULL;
+  const uint32* trace_depths = NULL;
+  const uint8* types = NULL;
+  const uint8* levels = NULL;
+  if (!ReadColumn(&reader, num_rows, &times) ||
+      !ReadColumn(&reader, num_rows, &ids) ||
+      !ReadColumn(&reader, num_traces, &traces) ||
+      !ReadColumn(&reader, num_rows, &process_ids) ||
+      !ReadColumn(&reader, num_rows, &thread_ids) ||
+      !ReadColumn(&reader, num_rows, &lines) ||
+      !ReadColumn(&reader, num_rows, &string_ids) ||
+      !ReadColumn(&reader, num_rows, &message_lens) ||
+      !ReadColumn(&reader, num_rows, &trace_depths) ||
+      !ReadColumn(&reader, num_rows, &types) ||
+      !ReadColumn(&reader, num_rows, &levels)) {
+    return false;
+  }
+
+  uint64 message_bytes = 0;
+  uint64 trace_entries = 0;
+  for (uint32 row = 0; row < num_rows; ++row) {
+    if (types[row] > LogExportWriter::INSTANT_ROW)
+      return false;
+    message_bytes += message_lens[row];
+    trace_entries += trace_depths[row];
+  }
+  const char* messages = NULL;
+  if (trace_entries != num_traces || message_bytes > payload.size() ||
+      !ReadColumn(&reader, static_cast<size_t>(message_bytes), &messages)) {
+    return false;
+  }
+
+  for (uint32 i = 0; i < num_strings; ++i) {
+    std::string str;
+    if (!ReadString(&reader, &str))
+      return false;
+    strings_.push_back(str);
+    atoms_.push_back(StringTable::kEmptyAtom);
+  }
+  for (uint32 row = 0; row < num_rows; ++row) {
+    if (string_ids[row] >= strings_.size())
+      return false;
+  }
+
+  for (uint32 i = 0; i < num_kernel_events; ++i) {
+    if (!ReadKernelEvent(&reader))
+      return false;
+  }
+  if (reader.RemainingBytes() != 0)
+    return false;
+
+  // All is well, issue the rows.
+  traces_.resize(num_traces);
+  for (uint32 i = 0; i < num_traces; ++i)
+    traces_[i] = reinterpret_cast<void*>(static_cast<uintptr_t>(traces[i]));
+
+  size_t message_offset = 0;
+  size_t trace_offset = 0;
+  for (uint32 row = 0; row < num_rows; ++row) {
+    LogMessageBase base;
+    base.time = base::Time::FromInternalValue(times[row]);
+    base.level = levels[row];
+    base.process_id = process_ids[row];
+    base.thread_id = thread_ids[row];
+    base.trace_depth = trace_depths[row];
+    base.traces = base.trace_depth == 0 ? NULL : &traces_[trace_offset];
+    const char* message = messages + message_offset;
+    size_t message_len = message_lens[row];
+    const std::string& str = strings_[string_ids[row]];
+    message_offset += message_len;
+    trace_offset += base.trace_depth;
+
+    LogExportWriter::RowType type =
+        static_cast<LogExportWriter::RowType>(types[row]);
+    if (type == LogExportWriter::LOG_ROW) {
+      if (event_sink_ == NULL)
+        continue;
+
+      LogEvents::LogMessage log_message;
+      static_cast<LogMessageBase&>(log_message) = base;
+      log_message.message = message;
+      log_message.message_len = message_len;
+      if (!str.empty()) {
+        log_message.file = str.data();
+        log_message.file_len = str.size();
+        log_message.line = lines[row];
+        if (string_table_ != NULL) {
+          StringTable::Atom& atom = atoms_[string_ids[row]];
+          if (atom == StringTable::kEmptyAtom)
+            atom = string_table_->Intern(str);
+          log_message.file_atom = atom;
+        }
+      }
+      log_messages_.push_back(log_message);
+      continue;
+    }
+
+    // Trace events go out in order with the log messages.
+    FlushLogMessages();
+    if (trace_sink_ == NULL)
+      continue;
+
+    TraceEvents::TraceMessage trace_message;
+    static_cast<LogMessageBase&>(trace_message) = base;
+    trace_message.name = str.data();
+    trace_message.name_len = str.size();
+    trace_message.id = reinterpret_cast<void*>(
+        static_cast<uintptr_t>(ids[row]));
+    trace_message.extra = message;
+    trace_message.extra_len = message_len;
+    switch (type) {
+      case LogExportWriter::BEGIN_ROW:
+        trace_sink_->OnTraceEventBegin(trace_message);
+        break;
+      case LogExportWriter::END_ROW:
+        trace_sink_->OnTraceEventEnd(trace_message);
+        break;
+      default:
+        trace_sink_->OnTraceEventInstant(trace_message);
+        break;
+    }
+  }
+  FlushLogMessages();
+
+  return true;
+}
+
+bool LogStreamReader::ReadKernelEvent(BinaryBufferReader* reader) {
+  DCHECK(reader != NULL);
+
+  uint32 type = 0;
+  int64 time_value = 0;
+  if (!Read(reader, &type) || !Read(reader, &time_value) ||
+      type > LogStreamWriter::MODULE_LOAD) {
+    return false;
+  }
+  base::Time time(base::Time::FromInternalValue(time_value));
+
+  switch (type) {
+    case LogStreamWriter::PROCESS_IS_RUNNING:
+    case LogStreamWriter::PROCESS_STARTED:
+    case LogStreamWriter::PROCESS_ENDED: {
+      KernelProcessEvents::ProcessInfo info;
+      const void* sid = NULL;
+      ULONG exit_status = 0;
+      if (!Read(reader, &info.process_id) ||
+          !Read(reader, &info.parent_id) ||
+          !Read(reader, &info.session_id) ||
+          !reader->Read(SECURITY_MAX_SID_SIZE, &sid) ||
+          !Read(reader, &exit_status) ||
+          !ReadString(reader, &info.image_name) ||
+          !ReadString(reader, &info.command_line)) {
+        return false;
+      }
+      memcpy(&info.user_sid, sid, SECURITY_MAX_SID_SIZE);
+
+      if (process_event_sink_ == NULL)
+        return true;
+      if (type == LogStreamWriter::PROCESS_IS_RUNNING)
+        process_event_sink_->OnProcessIsRunning(time, info);
+      else if (type == LogStreamWriter::PROCESS_STARTED)
+        process_event_sink_->OnProcessStarted(time, info);
+      else
+        process_event_sink_->OnProcessEnded(time, info, exit_status);
+      return true;
+    }
+
+    default: {
+      DWORD process_id = 0;
+      KernelModuleEvents::ModuleInformation info;
+      if (!Read(reader, &process_id) ||
+          !Read(reader, &info.base_address) ||
+          !Read(reader, &info.module_size) ||
+          !Read(reader, &info.image_checksum) ||
+          !Read(reader, &info.time_date_stamp) ||
+          !ReadString(reader, &info.image_file_name)) {
+        return false;
+      }
+
+      if (module_event_sink_ == NULL)
+        return true;
+      if (type == LogStreamWriter::MODULE_IS_LOADED)
+        module_event_sink_->OnModuleIsLoaded(process_id, time, info);
+      else if (type == LogStreamWriter::MODULE_UNLOAD)
+        module_event_sink_->OnModuleUnload(process_id, time, info);
+      else
+        module_event_sink_->OnModuleLoad(process_id, time, info);
+      return true;
+    }
+  }
+}
+
+void LogStreamReader::FlushLogMessages() {
+  if (!log_messages_.empty() && event_sink_ != NULL)
+    event_sink_->OnLogMessages(&log_messages_[0], log_messages_.size());
+  log_messages_.clear();
+}
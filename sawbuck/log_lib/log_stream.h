@@ -0,0 +1,254 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log stream declaration.
+#ifndef SAWBUCK_LOG_LIB_LOG_STREAM_H_
+#define SAWBUCK_LOG_LIB_LOG_STREAM_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/log_lib/log_consumer.h"
+#include "sawbuck/log_lib/log_export_writer.h"
+#include "sawbuck/log_lib/string_table.h"
+
+class BinaryBufferReader;
+
+// The log stream carries the parsed log messages and trace events of a
+// capture, along with the kernel's process and module events, from a
+// capture agent to a viewer. It's a sequence of blocks, each a
+// LogStreamBlockHeader and the zlib compressed payload of up to
+// kRowsPerBlock rows. The payload inflates to, in little endian:
+//   uint32 row count n, trace entry count t, new string count s and kernel
+//   event count k, then the columns of the rows:
+//     int64 time, in microseconds since 1601 UTC
+//     uint64 id
+//   the t uint64 stack trace entries of the rows, in order, then
+//     uint32 process id, uint32 thread id, uint32 line
+//     uint32 string id, of the file of a log message or the name of a
+//       trace event, zero for none
+//     uint32 message length, uint32 trace depth
+//     uint8 type, a LogExportWriter::RowType
+//     uint8 level
+//   the messages, or the extra data of trace events, concatenated, the s
+//   strings first seen in the block, each a uint32 length and its bytes,
+//   which take the next string ids of the stream, from one up, and last
+//   the k kernel events, each a uint32 LogStreamWriter::KernelEventType,
+//   an int64 time and the fields of the event.
+// Strings are sent once per stream, and the columns compress well, so the
+// stream takes a fraction of the bandwidth of the events it carries.
+struct LogStreamBlockHeader {
+  uint32 magic;
+  uint32 version;
+  // The sizes of the payload, inflated and compressed.
+  uint32 payload_size;
+  uint32 compressed_size;
+};
+
+// The TCP port capture agents serve their log stream on by default.
+const int kLogStreamDefaultPort = 7800;
+
+// Writes the events it receives to a log stream. The rows are gathered
+// into a block, which goes out when it's full or on Flush. This isn't
+// thread safe, writers from several threads must serialize their calls.
+class LogStreamWriter
+    : public LogEvents,
+      public TraceEvents,
+      public KernelProcessEvents,
+      public KernelModuleEvents {
+ public:
+  enum KernelEventType {
+    PROCESS_IS_RUNNING,
+    PROCESS_STARTED,
+    PROCESS_ENDED,
+    MODULE_IS_LOADED,
+    MODULE_UNLOAD,
+    MODULE_LOAD,
+  };
+
+  // Receives the stream.
+  class Output {
+   public:
+    virtual ~Output() {}
+
+    // @returns true on success.
+    virtual bool Write(const char* data, size_t len) = 0;
+  };
+
+  static const size_t kRowsPerBlock = 4096;
+  static const uint32 kBlockMagic = 0x54534253;  // "SBST".
+  static const uint32 kVersion = 1;
+  // The largest payload a block may have.
+  static const uint32 kMaxPayloadSize = 64 * 1024 * 1024;
+
+  // @param output receives the stream, and must outlive us.
+  explicit LogStreamWriter(Output* output);
+  ~LogStreamWriter();
+
+  // Writes out the block gathered so far, if any.
+  // @returns false if the output has failed, now or before.
+  bool Flush();
+
+  bool failed() const { return failed_; }
+  // The bytes of payload written, and the bytes they compressed to.
+  uint64 payload_bytes() const { return payload_bytes_; }
+  uint64 bytes_written() const { return bytes_written_; }
+
+  // LogEvents implementation.
+  virtual void OnLogMessage(const LogMessage& log_message);
+
+  // TraceEvents implementation.
+  virtual void OnTraceEventBegin(const TraceMessage& trace_message);
+  virtual void OnTraceEventEnd(const TraceMessage& trace_message);
+  virtual void OnTraceEventInstant(const TraceMessage& trace_message);
+
+  // KernelProcessEvents implementation.
+  virtual void OnProcessIsRunning(const base::Time& time,
+                                  const ProcessInfo& process_info);
+  virtual void OnProcessStarted(const base::Time& time,
+                                const ProcessInfo& process_info);
+  virtual void OnProcessEnded(const base::Time& time,
+                              const ProcessInfo& process_info,
+                              ULONG exit_status);
+
+  // KernelModuleEvents implementation.
+  virtual void OnModuleIsLoaded(DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info);
+  virtual void OnModuleUnload(DWORD process_id,
+                              const base::Time& time,
+                              const ModuleInformation& module_info);
+  virtual void OnModuleLoad(DWORD process_id,
+                            const base::Time& time,
+                            const ModuleInformation& module_info);
+
+ private:
+  void AddRow(LogExportWriter::RowType type,
+              const LogMessageBase& event,
+              const base::StringPiece& str,
+              int line,
+              const base::StringPiece& message,
+              uint64 id);
+  void AddTraceRow(LogExportWriter::RowType type,
+                   const TraceMessage& trace_message);
+  void AddProcessEvent(KernelEventType type,
+                       const base::Time& time,
+                       const ProcessInfo& process_info,
+                       ULONG exit_status);
+  void AddModuleEvent(KernelEventType type,
+                      DWORD process_id,
+                      const base::Time& time,
+                      const ModuleInformation& module_info);
+  // Flushes the block if it's full.
+  void MaybeFlush();
+
+  // @returns the id of @p str, which is sent with the next block if it's
+  //     new to the stream.
+  uint32 GetStringId(const base::StringPiece& str);
+
+  Output* output_;
+
+  // The ids of the strings sent, and of those to be sent, so far.
+  std::map<std::string, uint32> string_ids_;
+
+  // The columns of the block being gathered.
+  std::vector<int64> times_;
+  std::vector<uint64> ids_;
+  std::vector<uint64> traces_;
+  std::vector<uint32> process_ids_;
+  std::vector<uint32> thread_ids_;
+  std::vector<uint32> lines_;
+  std::vector<uint32> string_ids_column_;
+  std::vector<uint32> message_lens_;
+  std::vector<uint32> trace_depths_;
+  std::vector<uint8> types_;
+  std::vector<uint8> levels_;
+  std::string messages_;
+  // The strings new to the stream, serialized, and their count.
+  std::string new_strings_;
+  uint32 num_new_strings_;
+  // The kernel events, serialized, and their count.
+  std::string kernel_events_;
+  uint32 num_kernel_events_;
+
+  uint64 payload_bytes_;
+  uint64 bytes_written_;
+  bool failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogStreamWriter);
+};
+
+// Reads a log stream as it arrives, and issues the events of each block
+// it completes to its sinks, the kernel events of a block ahead of its
+// rows.
+class LogStreamReader {
+ public:
+  LogStreamReader();
+  ~LogStreamReader();
+
+  void set_event_sink(LogEvents* event_sink) { event_sink_ = event_sink; }
+  void set_trace_sink(TraceEvents* trace_sink) { trace_sink_ = trace_sink; }
+  void set_process_event_sink(KernelProcessEvents* process_event_sink) {
+    process_event_sink_ = process_event_sink;
+  }
+  void set_module_event_sink(KernelModuleEvents* module_event_sink) {
+    module_event_sink_ = module_event_sink;
+  }
+  // Sets the table file names are interned to, the table must outlive
+  // this reader.
+  void set_string_table(StringTable* string_table) {
+    string_table_ = string_table;
+  }
+
+  // Takes the next @p len bytes of the stream, and issues the events of
+  // the blocks they complete.
+  // @returns false on a malformed block, now or before.
+  bool Append(const char* data, size_t len);
+
+  bool failed() const { return failed_; }
+
+ private:
+  // Reads and issues the events of the block @p payload inflates to.
+  bool ReadPayload(const std::string& payload);
+  bool ReadKernelEvent(BinaryBufferReader* reader);
+  // Issues the log messages held in log_messages_.
+  void FlushLogMessages();
+
+  LogEvents* event_sink_;
+  TraceEvents* trace_sink_;
+  KernelProcessEvents* process_event_sink_;
+  KernelModuleEvents* module_event_sink_;
+  StringTable* string_table_;
+
+  // The bytes received past the last complete block.
+  std::string pending_;
+
+  // The strings of the stream by id, and their atoms in string_table_,
+  // kEmptyAtom until interned.
+  std::vector<std::string> strings_;
+  std::vector<StringTable::Atom> atoms_;
+
+  // The log messages of the block being read, issued in runs.
+  std::vector<LogEvents::LogMessage> log_messages_;
+  // The stack traces of the block, widened to pointers.
+  std::vector<void*> traces_;
+
+  bool failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogStreamReader);
+};
+
+#endif  // SAWBUCK_LOG_LIB_LOG_STREAM_H_
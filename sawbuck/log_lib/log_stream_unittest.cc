@@ -0,0 +1,431 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log stream unittests.
+#include "sawbuck/log_lib/log_stream.h"
+
+#include <string.h>
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+using testing::_;
+using testing::Field;
+using testing::InSequence;
+
+class StringOutput : public LogStreamWriter::Output {
+ public:
+  StringOutput() : fail_(false) {
+  }
+
+  virtual bool Write(const char* data, size_t len) {
+    if (fail_)
+      return false;
+    str_.append(data, len);
+    return true;
+  }
+
+  const std::string& str() const { return str_; }
+  void set_fail(bool fail) { fail_ = fail; }
+
+ private:
+  std::string str_;
+  bool fail_;
+};
+
+// Records the log messages it's handed, as their pointers don't outlive
+// the call.
+class RecordingLogEvents : public LogEvents {
+ public:
+  struct Record {
+    int64 time;
+    UCHAR level;
+    DWORD process_id;
+    DWORD thread_id;
+    std::vector<void*> traces;
+    std::string file;
+    StringTable::Atom file_atom;
+    int line;
+    std::string message;
+  };
+
+  RecordingLogEvents() : num_batches_(0) {
+  }
+
+  virtual void OnLogMessage(const LogMessage& log_message) {
+    Record record;
+    record.time = log_message.time.ToInternalValue();
+    record.level = log_message.level;
+    record.process_id = log_message.process_id;
+    record.thread_id = log_message.thread_id;
+    record.traces.assign(log_message.traces,
+                         log_message.traces + log_message.trace_depth);
+    if (log_message.file != NULL)
+      record.file.assign(log_message.file, log_message.file_len);
+    record.file_atom = log_message.file_atom;
+    record.line = log_message.line;
+    record.message.assign(log_message.message, log_message.message_len);
+    records_.push_back(record);
+  }
+
+  virtual void OnLogMessages(const LogMessage* log_messages, size_t count) {
+    ++num_batches_;
+    LogEvents::OnLogMessages(log_messages, count);
+  }
+
+  const std::vector<Record>& records() const { return records_; }
+  size_t num_batches() const { return num_batches_; }
+
+ private:
+  std::vector<Record> records_;
+  size_t num_batches_;
+};
+
+class MockTraceEvents : public TraceEvents {
+ public:
+  MOCK_METHOD1(OnTraceEventBegin, void(const TraceMessage& trace_message));
+  MOCK_METHOD1(OnTraceEventEnd, void(const TraceMessage& trace_message));
+  MOCK_METHOD1(OnTraceEventInstant, void(const TraceMessage& trace_message));
+};
+
+class MockKernelProcessEvents : public KernelProcessEvents {
+ public:
+  MOCK_METHOD2(OnProcessIsRunning, void(const base::Time& time,
+                                        const ProcessInfo& process_info));
+  MOCK_METHOD2(OnProcessStarted, void(const base::Time& time,
+                                      const ProcessInfo& process_info));
+  MOCK_METHOD3(OnProcessEnded, void(const base::Time& time,
+                                    const ProcessInfo& process_info,
+                                    ULONG exit_status));
+};
+
+class MockKernelModuleEvents : public KernelModuleEvents {
+ public:
+  MOCK_METHOD3(OnModuleIsLoaded, void(DWORD process_id,
+                                      const base::Time& time,
+                                      const ModuleInformation& module_info));
+  MOCK_METHOD3(OnModuleUnload, void(DWORD process_id,
+                                    const base::Time& time,
+                                    const ModuleInformation& module_info));
+  MOCK_METHOD3(OnModuleLoad, void(DWORD process_id,
+                                  const base::Time& time,
+                                  const ModuleInformation& module_info));
+};
+
+class LogStreamTest : public testing::Test {
+ public:
+  LogStreamTest() : kT0(base::Time::Now()) {
+    reader_.set_event_sink(&log_events_);
+    reader_.set_trace_sink(&trace_events_);
+    reader_.set_process_event_sink(&process_events_);
+    reader_.set_module_event_sink(&module_events_);
+    reader_.set_string_table(&string_table_);
+  }
+
+  // Writes a log message from @p pid at @p ms milliseconds past kT0.
+  void WriteLog(LogStreamWriter* writer, DWORD pid, int ms,
+                const char* file, const char* message) {
+    void* traces[] = { reinterpret_cast<void*>(0x1000 + ms),
+                       reinterpret_cast<void*>(0x2000 + ms) };
+    LogEvents::LogMessage log_message;
+    log_message.time = kT0 + base::TimeDelta::FromMilliseconds(ms);
+    log_message.level = 3;
+    log_message.process_id = pid;
+    log_message.thread_id = pid + 1;
+    log_message.trace_depth = ms % 3;
+    log_message.traces = traces;
+    log_message.file = file;
+    log_message.file_len = strlen(file);
+    log_message.line = ms;
+    log_message.message = message;
+    log_message.message_len = strlen(message);
+    writer->OnLogMessage(log_message);
+  }
+
+ protected:
+  const base::Time kT0;
+  StringOutput output_;
+  StringTable string_table_;
+  RecordingLogEvents log_events_;
+  testing::StrictMock<MockTraceEvents> trace_events_;
+  testing::StrictMock<MockKernelProcessEvents> process_events_;
+  testing::StrictMock<MockKernelModuleEvents> module_events_;
+  LogStreamReader reader_;
+};
+
+template <class T>
+void Append(const T& value, std::string* payload) {
+  payload->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// @returns the stream block of @p payload, as LogStreamWriter makes them.
+std::string MakeBlock(const std::string& payload) {
+  std::string compressed(compressBound(payload.size()), '\0');
+  uLongf compressed_size = compressed.size();
+  EXPECT_EQ(Z_OK, compress(reinterpret_cast<Bytef*>(&compressed[0]),
+                           &compressed_size,
+                           reinterpret_cast<const Bytef*>(payload.data()),
+                           payload.size()));
+  compressed.resize(compressed_size);
+
+  LogStreamBlockHeader header = {};
+  header.magic = LogStreamWriter::kBlockMagic;
+  header.version = LogStreamWriter::kVersion;
+  header.payload_size = payload.size();
+  header.compressed_size = compressed.size();
+  return std::string(reinterpret_cast<const char*>(&header),
+                     sizeof(header)) + compressed;
+}
+
+// @returns the stream block of a running process at @p time, whose command
+//     line claims @p command_line_len wide characters, followed by four
+//     bytes.
+std::string MakeProcessBlock(const base::Time& time,
+                             uint32 command_line_len) {
+  std::string payload;
+  Append<uint32>(0, &payload);  // Rows.
+  Append<uint32>(0, &payload);  // Traces.
+  Append<uint32>(0, &payload);  // Strings.
+  Append<uint32>(1, &payload);  // Kernel events.
+  Append<uint32>(LogStreamWriter::PROCESS_IS_RUNNING, &payload);
+  Append<int64>(time.ToInternalValue(), &payload);
+  Append<ULONG>(10, &payload);  // Process id.
+  Append<ULONG>(1, &payload);  // Parent id.
+  Append<ULONG>(0, &payload);  // Session id.
+  payload.append(SECURITY_MAX_SID_SIZE, '\0');
+  Append<ULONG>(0, &payload);  // Exit status.
+  Append<uint32>(0, &payload);  // Image name.
+  Append<uint32>(command_line_len, &payload);
+  payload.append(4, 'x');
+  return MakeBlock(payload);
+}
+
+}  // namespace
+
+TEST_F(LogStreamTest, RoundTripsLogMessages) {
+  LogStreamWriter writer(&output_);
+  WriteLog(&writer, 10, 1, "file.cc", "first");
+  WriteLog(&writer, 10, 2, "other.cc", "second");
+  WriteLog(&writer, 11, 3, "file.cc", "");
+  WriteLog(&writer, 11, 4, "", "no file");
+  ASSERT_TRUE(writer.Flush());
+  EXPECT_TRUE(writer.Flush());
+
+  ASSERT_TRUE(reader_.Append(output_.str().data(), output_.str().size()));
+  ASSERT_EQ(4, log_events_.records().size());
+  EXPECT_EQ(1, log_events_.num_batches());
+
+  const RecordingLogEvents::Record& first = log_events_.records()[0];
+  EXPECT_EQ((kT0 + base::TimeDelta::FromMilliseconds(1)).ToInternalValue(),
+            first.time);
+  EXPECT_EQ(3, first.level);
+  EXPECT_EQ(10, first.process_id);
+  EXPECT_EQ(11, first.thread_id);
+  ASSERT_EQ(1, first.traces.size());
+  EXPECT_EQ(reinterpret_cast<void*>(0x1001), first.traces[0]);
+  EXPECT_EQ("file.cc", first.file);
+  EXPECT_EQ(string_table_.Intern("file.cc"), first.file_atom);
+  EXPECT_EQ(1, first.line);
+  EXPECT_EQ("first", first.message);
+
+  EXPECT_EQ(2, log_events_.records()[1].traces.size());
+  EXPECT_EQ("other.cc", log_events_.records()[1].file);
+  EXPECT_EQ("", log_events_.records()[2].message);
+  EXPECT_EQ(first.file_atom, log_events_.records()[2].file_atom);
+  EXPECT_EQ("", log_events_.records()[3].file);
+  EXPECT_EQ(StringTable::kEmptyAtom, log_events_.records()[3].file_atom);
+  EXPECT_EQ(0, log_events_.records()[3].line);
+}
+
+TEST_F(LogStreamTest, SendsStringsOnce) {
+  LogStreamWriter writer(&output_);
+  WriteLog(&writer, 10, 1, "a_rather_long_file_name.cc", "first");
+  ASSERT_TRUE(writer.Flush());
+  size_t first_block = output_.str().size();
+
+  // The second block refers to the string sent with the first.
+  WriteLog(&writer, 10, 2, "a_rather_long_file_name.cc", "first");
+  ASSERT_TRUE(writer.Flush());
+  EXPECT_EQ(std::string::npos,
+            output_.str().find("a_rather_long_file_name.cc", first_block));
+
+  ASSERT_TRUE(reader_.Append(output_.str().data(), output_.str().size()));
+  ASSERT_EQ(2, log_events_.records().size());
+  EXPECT_EQ("a_rather_long_file_name.cc", log_events_.records()[1].file);
+}
+
+TEST_F(LogStreamTest, RoundTripsTraceEvents) {
+  LogStreamWriter writer(&output_);
+  TraceEvents::TraceMessage trace_message;
+  trace_message.time = kT0;
+  trace_message.process_id = 10;
+  trace_message.thread_id = 11;
+  trace_message.name = "span";
+  trace_message.name_len = 4;
+  trace_message.id = reinterpret_cast<void*>(0xF00);
+  trace_message.extra = "extra";
+  trace_message.extra_len = 5;
+
+  WriteLog(&writer, 10, 1, "file.cc", "before");
+  writer.OnTraceEventBegin(trace_message);
+  writer.OnTraceEventInstant(trace_message);
+  writer.OnTraceEventEnd(trace_message);
+  WriteLog(&writer, 10, 2, "file.cc", "after");
+  ASSERT_TRUE(writer.Flush());
+
+  {
+    InSequence seq;
+    EXPECT_CALL(trace_events_, OnTraceEventBegin(
+        Field(&TraceEvents::TraceMessage::id, trace_message.id)));
+    EXPECT_CALL(trace_events_, OnTraceEventInstant(
+        Field(&TraceEvents::TraceMessage::extra_len, 5)));
+    EXPECT_CALL(trace_events_, OnTraceEventEnd(
+        Field(&TraceEvents::TraceMessage::name_len, 4)));
+  }
+  ASSERT_TRUE(reader_.Append(output_.str().data(), output_.str().size()));
+
+  // The log messages on either side of the traces go out separately.
+  ASSERT_EQ(2, log_events_.records().size());
+  EXPECT_EQ(2, log_events_.num_batches());
+}
+
+TEST_F(LogStreamTest, RoundTripsKernelEvents) {
+  LogStreamWriter writer(&output_);
+  KernelProcessEvents::ProcessInfo process_info;
+  process_info.process_id = 10;
+  process_info.parent_id = 9;
+  process_info.session_id = 1;
+  memset(&process_info.user_sid, 0, SECURITY_MAX_SID_SIZE);
+  process_info.image_name = "foo.exe";
+  process_info.command_line = L"foo.exe --bar";
+  KernelModuleEvents::ModuleInformation module_info;
+  module_info.base_address = 0x400000;
+  module_info.module_size = 0x1000;
+  module_info.image_checksum = 0xCAFE;
+  module_info.time_date_stamp = 0xBEEF;
+  module_info.image_file_name = L"C:\\foo.exe";
+
+  writer.OnProcessIsRunning(kT0, process_info);
+  writer.OnProcessStarted(kT0, process_info);
+  writer.OnModuleLoad(10, kT0, module_info);
+  writer.OnModuleIsLoaded(10, kT0, module_info);
+  writer.OnModuleUnload(10, kT0, module_info);
+  writer.OnProcessEnded(kT0, process_info, 42);
+  ASSERT_TRUE(writer.Flush());
+
+  {
+    typedef KernelProcessEvents::ProcessInfo ProcessInfo;
+    typedef KernelModuleEvents::ModuleInformation ModuleInformation;
+    InSequence seq;
+    EXPECT_CALL(process_events_, OnProcessIsRunning(kT0,
+        Field(&ProcessInfo::image_name, process_info.image_name)));
+    EXPECT_CALL(process_events_, OnProcessStarted(kT0,
+        Field(&ProcessInfo::command_line, process_info.command_line)));
+    EXPECT_CALL(module_events_, OnModuleLoad(10, kT0,
+        Field(&ModuleInformation::image_file_name,
+              module_info.image_file_name)));
+    EXPECT_CALL(module_events_, OnModuleIsLoaded(10, kT0,
+        Field(&ModuleInformation::base_address, module_info.base_address)));
+    EXPECT_CALL(module_events_, OnModuleUnload(10, kT0,
+        Field(&ModuleInformation::time_date_stamp,
+              module_info.time_date_stamp)));
+    EXPECT_CALL(process_events_, OnProcessEnded(kT0,
+        Field(&ProcessInfo::parent_id, 9), 42));
+  }
+  ASSERT_TRUE(reader_.Append(output_.str().data(), output_.str().size()));
+}
+
+TEST_F(LogStreamTest, AppendsPartialBlocks) {
+  {
+    LogStreamWriter writer(&output_);
+    for (int i = 0; i < 10; ++i) {
+      WriteLog(&writer, 10, i, "file.cc", "message");
+      ASSERT_TRUE(writer.Flush());
+    }
+  }
+
+  // Feed the stream a byte at a time.
+  const std::string& str = output_.str();
+  for (size_t i = 0; i < str.size(); ++i)
+    ASSERT_TRUE(reader_.Append(str.data() + i, 1));
+  EXPECT_EQ(10, log_events_.records().size());
+  EXPECT_EQ(10, log_events_.num_batches());
+}
+
+TEST_F(LogStreamTest, FlushesFullBlocks) {
+  LogStreamWriter writer(&output_);
+  for (size_t i = 0; i < LogStreamWriter::kRowsPerBlock; ++i)
+    WriteLog(&writer, 10, 1, "file.cc", "message");
+  EXPECT_FALSE(output_.str().empty());
+  EXPECT_LT(0, writer.bytes_written());
+}
+
+TEST_F(LogStreamTest, FailsOnOutputError) {
+  LogStreamWriter writer(&output_);
+  output_.set_fail(true);
+  WriteLog(&writer, 10, 1, "file.cc", "message");
+  EXPECT_FALSE(writer.Flush());
+  EXPECT_TRUE(writer.failed());
+
+  output_.set_fail(false);
+  WriteLog(&writer, 10, 2, "file.cc", "message");
+  EXPECT_FALSE(writer.Flush());
+  EXPECT_TRUE(output_.str().empty());
+}
+
+TEST_F(LogStreamTest, RejectsMalformedStreams) {
+  {
+    LogStreamWriter writer(&output_);
+    WriteLog(&writer, 10, 1, "file.cc", "message");
+  }
+  std::string str(output_.str());
+
+  // A bad magic.
+  std::string bad(str);
+  bad[0] ^= 0xFF;
+  EXPECT_FALSE(reader_.Append(bad.data(), bad.size()));
+  EXPECT_TRUE(reader_.failed());
+  EXPECT_FALSE(reader_.Append(str.data(), str.size()));
+
+  // A corrupt compressed payload.
+  LogStreamReader reader;
+  bad = str;
+  bad[sizeof(LogStreamBlockHeader) + 2] ^= 0xFF;
+  EXPECT_FALSE(reader.Append(bad.data(), bad.size()));
+
+  // A payload size that doesn't match the inflated payload.
+  LogStreamReader other_reader;
+  bad = str;
+  LogStreamBlockHeader header = {};
+  memcpy(&header, bad.data(), sizeof(header));
+  ++header.payload_size;
+  memcpy(&bad[0], &header, sizeof(header));
+  EXPECT_FALSE(other_reader.Append(bad.data(), bad.size()));
+
+  EXPECT_TRUE(log_events_.records().empty());
+}
+
+TEST_F(LogStreamTest, RejectsOverlongStrings) {
+  std::string block(MakeProcessBlock(kT0, 4 / sizeof(wchar_t)));
+  EXPECT_CALL(process_events_, OnProcessIsRunning(kT0, _));
+  EXPECT_TRUE(reader_.Append(block.data(), block.size()));
+
+  // A length past the payload, whose byte count wraps around in 32-bit
+  // builds, fails the stream.
+  block = MakeProcessBlock(kT0, 0x80000001);
+  EXPECT_FALSE(reader_.Append(block.data(), block.size()));
+  EXPECT_TRUE(reader_.failed());
+}
@@ -0,0 +1,265 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Page fault aggregator implementation.
+#include "sawbuck/log_lib/page_fault_aggregator.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+template <class Faults>
+bool MoreFaults(const Faults& a, const Faults& b) {
+  return a.counts.total_faults() > b.counts.total_faults();
+}
+
+// Moves the @p count entries of @p faults with the most faults to the
+// front, most first, and drops the rest.
+template <class Faults>
+void KeepTop(size_t count, std::vector<Faults>* faults) {
+  DCHECK(faults != NULL);
+  count = std::min(count, faults->size());
+  std::partial_sort(faults->begin(), faults->begin() + count, faults->end(),
+                    MoreFaults<Faults>);
+  faults->resize(count);
+}
+
+}  // namespace
+
+const sym_util::Address PageFaultAggregator::kPageSize;
+const PageFaultAggregator::ModuleId PageFaultAggregator::kNoModule;
+
+PageFaultAggregator::FaultCounts::FaultCounts() : hard_fault_bytes(0) {
+  for (size_t i = 0; i < FAULT_KIND_MAX; ++i)
+    faults[i] = 0;
+}
+
+void PageFaultAggregator::FaultCounts::Add(const FaultCounts& other) {
+  for (size_t i = 0; i < FAULT_KIND_MAX; ++i)
+    faults[i] += other.faults[i];
+  hard_fault_bytes += other.hard_fault_bytes;
+  hard_fault_time += other.hard_fault_time;
+}
+
+uint64 PageFaultAggregator::FaultCounts::total_faults() const {
+  uint64 total = 0;
+  for (size_t i = 0; i < FAULT_KIND_MAX; ++i)
+    total += faults[i];
+  return total;
+}
+
+bool PageFaultAggregator::BucketKey::operator<(const BucketKey& o) const {
+  if (process_id != o.process_id)
+    return process_id < o.process_id;
+  if (module != o.module)
+    return module < o.module;
+  if (page != o.page)
+    return page < o.page;
+  if (kind != o.kind)
+    return kind < o.kind;
+  return time_bucket < o.time_bucket;
+}
+
+PageFaultAggregator::PageFaultAggregator(base::TimeDelta bucket_width)
+    : bucket_width_(bucket_width) {
+  DCHECK_LT(0, bucket_width_.InMicroseconds());
+}
+
+PageFaultAggregator::~PageFaultAggregator() {
+}
+
+void PageFaultAggregator::GetTopModules(
+    size_t count, std::vector<ModuleFaults>* modules) const {
+  DCHECK(modules != NULL);
+
+  // The buckets are ordered by process first, so gather by module id.
+  typedef std::map<ModuleId, FaultCounts> ModuleCountsMap;
+  ModuleCountsMap module_counts;
+  BucketMap::const_iterator it(buckets_.begin());
+  for (; it != buckets_.end(); ++it)
+    AddBucket(it->first, it->second, &module_counts[it->first.module]);
+
+  modules->clear();
+  ModuleCountsMap::const_iterator jt(module_counts.begin());
+  for (; jt != module_counts.end(); ++jt) {
+    ModuleFaults faults;
+    if (jt->first != kNoModule)
+      faults.module = modules_[jt->first];
+    faults.counts = jt->second;
+    modules->push_back(faults);
+  }
+
+  KeepTop(count, modules);
+}
+
+void PageFaultAggregator::GetTopPages(size_t count,
+                                      std::vector<PageFaults>* pages) const {
+  DCHECK(pages != NULL);
+
+  typedef std::pair<ModuleId, sym_util::Address> PageKey;
+  typedef std::map<PageKey, FaultCounts> PageCountsMap;
+  PageCountsMap page_counts;
+  BucketMap::const_iterator it(buckets_.begin());
+  for (; it != buckets_.end(); ++it) {
+    PageKey key(it->first.module, it->first.page);
+    AddBucket(it->first, it->second, &page_counts[key]);
+  }
+
+  pages->clear();
+  PageCountsMap::const_iterator jt(page_counts.begin());
+  for (; jt != page_counts.end(); ++jt) {
+    PageFaults faults;
+    if (jt->first.first != kNoModule)
+      faults.module = modules_[jt->first.first];
+    faults.page = jt->first.second;
+    faults.counts = jt->second;
+    pages->push_back(faults);
+  }
+
+  KeepTop(count, pages);
+}
+
+void PageFaultAggregator::OnModuleIsLoaded(
+    DWORD process_id, const base::Time& time,
+    const ModuleInformation& module_info) {
+  module_cache_.ModuleLoaded(process_id, time, module_info);
+}
+
+void PageFaultAggregator::OnModuleUnload(
+    DWORD process_id, const base::Time& time,
+    const ModuleInformation& module_info) {
+  module_cache_.ModuleUnloaded(process_id, time, module_info);
+}
+
+void PageFaultAggregator::OnModuleLoad(
+    DWORD process_id, const base::Time& time,
+    const ModuleInformation& module_info) {
+  module_cache_.ModuleLoaded(process_id, time, module_info);
+}
+
+void PageFaultAggregator::OnTransitionFault(DWORD process_id,
+                                            DWORD thread_id,
+                                            const base::Time& time,
+                                            sym_util::Address address,
+                                            sym_util::Address program_counter) {
+  AddFault(TRANSITION_FAULT, process_id, time, address);
+}
+
+void PageFaultAggregator::OnDemandZeroFault(DWORD process_id,
+                                            DWORD thread_id,
+                                            const base::Time& time,
+                                            sym_util::Address address,
+                                            sym_util::Address program_counter) {
+  AddFault(DEMAND_ZERO_FAULT, process_id, time, address);
+}
+
+void PageFaultAggregator::OnCopyOnWriteFault(
+    DWORD process_id, DWORD thread_id, const base::Time& time,
+    sym_util::Address address, sym_util::Address program_counter) {
+  AddFault(COPY_ON_WRITE_FAULT, process_id, time, address);
+}
+
+void PageFaultAggregator::OnGuardPageFault(DWORD process_id,
+                                           DWORD thread_id,
+                                           const base::Time& time,
+                                           sym_util::Address address,
+                                           sym_util::Address program_counter) {
+  AddFault(GUARD_PAGE_FAULT, process_id, time, address);
+}
+
+void PageFaultAggregator::OnHardFault(DWORD process_id,
+                                      DWORD thread_id,
+                                      const base::Time& time,
+                                      sym_util::Address address,
+                                      sym_util::Address program_counter) {
+  pending_hard_faults_[thread_id] =
+      AddFault(HARD_FAULT, process_id, time, address);
+}
+
+void PageFaultAggregator::OnAccessViolationFault(
+    DWORD process_id, DWORD thread_id, const base::Time& time,
+    sym_util::Address address, sym_util::Address program_counter) {
+  AddFault(ACCESS_VIOLATION_FAULT, process_id, time, address);
+}
+
+void PageFaultAggregator::OnHardPageFault(DWORD thread_id,
+                                          const base::Time& time,
+                                          const base::Time& initial_time,
+                                          sym_util::Offset offset,
+                                          sym_util::Address address,
+                                          sym_util::Address file_object,
+                                          sym_util::ByteCount byte_count) {
+  base::TimeDelta latency = time - initial_time;
+  totals_.hard_fault_bytes += byte_count;
+  totals_.hard_fault_time += latency;
+
+  // Without a hard fault on the thread, we can't tell the process.
+  ThreadHardFaultMap::iterator it(pending_hard_faults_.find(thread_id));
+  if (it == pending_hard_faults_.end())
+    return;
+
+  BucketCounts& bucket = it->second->second;
+  bucket.hard_fault_bytes += byte_count;
+  bucket.hard_fault_time += latency;
+  pending_hard_faults_.erase(it);
+}
+
+PageFaultAggregator::ModuleId PageFaultAggregator::GetModuleId(
+    const ModuleInformation& module) {
+  std::pair<ModuleIdMap::iterator, bool> inserted =
+      module_ids_.insert(std::make_pair(module, modules_.size()));
+  if (inserted.second)
+    modules_.push_back(module);
+
+  return inserted.first->second;
+}
+
+PageFaultAggregator::BucketMap::iterator PageFaultAggregator::AddFault(
+    FaultKind kind, sym_util::ProcessId process_id, const base::Time& time,
+    sym_util::Address address) {
+  DCHECK_LE(0, kind);
+  DCHECK_GT(FAULT_KIND_MAX, kind);
+
+  BucketKey key;
+  key.process_id = process_id;
+  key.kind = kind;
+  key.time_bucket =
+      time.ToInternalValue() / bucket_width_.ToInternalValue();
+
+  ModuleInformation module;
+  if (module_cache_.GetModuleForAddress(process_id, time, address, &module)) {
+    key.module = GetModuleId(module);
+    address -= module.base_address;
+  } else {
+    key.module = kNoModule;
+  }
+  key.page = address & ~(kPageSize - 1);
+
+  BucketMap::iterator it(buckets_.insert(
+      std::make_pair(key, BucketCounts())).first);
+  ++it->second.faults;
+  ++totals_.faults[kind];
+
+  return it;
+}
+
+void PageFaultAggregator::AddBucket(const BucketKey& key,
+                                    const BucketCounts& bucket,
+                                    FaultCounts* counts) {
+  DCHECK(counts != NULL);
+  counts->faults[key.kind] += bucket.faults;
+  counts->hard_fault_bytes += bucket.hard_fault_bytes;
+  counts->hard_fault_time += bucket.hard_fault_time;
+}
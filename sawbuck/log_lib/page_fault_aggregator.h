@@ -0,0 +1,205 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Page fault aggregator declaration.
+#ifndef SAWBUCK_LOG_LIB_PAGE_FAULT_AGGREGATOR_H_
+#define SAWBUCK_LOG_LIB_PAGE_FAULT_AGGREGATOR_H_
+
+#include <map>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/time/time.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/sym_util/module_cache.h"
+
+// The page fault aggregator sinks the page fault and module events of a
+// kernel log parser, and tallies the faults by process, module, page, kind
+// and time bucket as they arrive. No event is kept, so the memory it takes
+// grows with the number of distinct pages faulted on, not with the length
+// of the log.
+class PageFaultAggregator
+    : public KernelModuleEvents,
+      public KernelPageFaultEvents {
+ public:
+  enum FaultKind {
+    TRANSITION_FAULT,
+    DEMAND_ZERO_FAULT,
+    COPY_ON_WRITE_FAULT,
+    GUARD_PAGE_FAULT,
+    HARD_FAULT,
+    ACCESS_VIOLATION_FAULT,
+    FAULT_KIND_MAX,
+  };
+
+  // The tally of a set of faults.
+  struct FaultCounts {
+    FaultCounts();
+    void Add(const FaultCounts& other);
+    uint64 total_faults() const;
+
+    // The number of faults of each kind.
+    uint64 faults[FAULT_KIND_MAX];
+    // The bytes read to satisfy the hard faults, and the time it took.
+    uint64 hard_fault_bytes;
+    base::TimeDelta hard_fault_time;
+  };
+
+  // The faults in a module, or outside of any module if it has no name.
+  struct ModuleFaults {
+    ModuleInformation module;
+    FaultCounts counts;
+  };
+
+  // The faults on a page of a module, or on a page outside of any module.
+  struct PageFaults {
+    ModuleInformation module;
+    // The RVA of the page within the module, or its address if outside.
+    sym_util::Address page;
+    FaultCounts counts;
+  };
+
+  // The page size faults are tallied by.
+  static const sym_util::Address kPageSize = 0x1000;
+
+  // @param bucket_width the width of the time buckets faults are tallied in.
+  explicit PageFaultAggregator(base::TimeDelta bucket_width);
+  ~PageFaultAggregator();
+
+  base::TimeDelta bucket_width() const { return bucket_width_; }
+
+  // @returns the number of distinct process, module, page, kind and time
+  //     buckets we've tallied.
+  size_t bucket_count() const { return buckets_.size(); }
+
+  // @returns the tally of all faults, which includes the bytes of the hard
+  //     page faults we couldn't tie to a hard fault.
+  const FaultCounts& totals() const { return totals_; }
+
+  // Retrieves the @p count modules with the most faults to @p modules,
+  // most faults first.
+  void GetTopModules(size_t count, std::vector<ModuleFaults>* modules) const;
+
+  // Retrieves the @p count pages with the most faults to @p pages, most
+  // faults first.
+  void GetTopPages(size_t count, std::vector<PageFaults>* pages) const;
+
+  // KernelModuleEvents implementation.
+  virtual void OnModuleIsLoaded(DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info);
+  virtual void OnModuleUnload(DWORD process_id,
+                              const base::Time& time,
+                              const ModuleInformation& module_info);
+  virtual void OnModuleLoad(DWORD process_id,
+                            const base::Time& time,
+                            const ModuleInformation& module_info);
+
+  // KernelPageFaultEvents implementation.
+  virtual void OnTransitionFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter);
+  virtual void OnDemandZeroFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter);
+  virtual void OnCopyOnWriteFault(DWORD process_id,
+                                  DWORD thread_id,
+                                  const base::Time& time,
+                                  sym_util::Address address,
+                                  sym_util::Address program_counter);
+  virtual void OnGuardPageFault(DWORD process_id,
+                                DWORD thread_id,
+                                const base::Time& time,
+                                sym_util::Address address,
+                                sym_util::Address program_counter);
+  virtual void OnHardFault(DWORD process_id,
+                           DWORD thread_id,
+                           const base::Time& time,
+                           sym_util::Address address,
+                           sym_util::Address program_counter);
+  virtual void OnAccessViolationFault(DWORD process_id,
+                                      DWORD thread_id,
+                                      const base::Time& time,
+                                      sym_util::Address address,
+                                      sym_util::Address program_counter);
+  virtual void OnHardPageFault(DWORD thread_id,
+                               const base::Time& time,
+                               const base::Time& initial_time,
+                               sym_util::Offset offset,
+                               sym_util::Address address,
+                               sym_util::Address file_object,
+                               sym_util::ByteCount byte_count);
+
+ private:
+  // Modules are tallied by an id, as the same few occur over and over.
+  typedef size_t ModuleId;
+  static const ModuleId kNoModule = static_cast<ModuleId>(-1);
+  ModuleId GetModuleId(const ModuleInformation& module);
+
+  struct BucketKey {
+    bool operator<(const BucketKey& o) const;
+
+    sym_util::ProcessId process_id;
+    ModuleId module;
+    // The page's RVA in the module, or its address if there's no module.
+    sym_util::Address page;
+    FaultKind kind;
+    int64 time_bucket;
+  };
+  // The tally of a bucket is only that of its kind.
+  struct BucketCounts {
+    BucketCounts() : faults(0), hard_fault_bytes(0) {}
+
+    uint64 faults;
+    uint64 hard_fault_bytes;
+    base::TimeDelta hard_fault_time;
+  };
+  typedef std::map<BucketKey, BucketCounts> BucketMap;
+
+  // Tallies a fault of @p kind on @p address in @p process_id at @p time.
+  // @returns the bucket tallied in.
+  BucketMap::iterator AddFault(FaultKind kind,
+                               sym_util::ProcessId process_id,
+                               const base::Time& time,
+                               sym_util::Address address);
+
+  // Adds the tally of @p bucket to @p counts.
+  static void AddBucket(const BucketKey& key,
+                        const BucketCounts& bucket,
+                        FaultCounts* counts);
+
+  // The module load state of the processes, to tie addresses to modules.
+  sym_util::ModuleCache module_cache_;
+
+  // The modules we've seen faults in, and their ids.
+  typedef std::map<ModuleInformation, ModuleId> ModuleIdMap;
+  ModuleIdMap module_ids_;
+  std::vector<ModuleInformation> modules_;
+
+  base::TimeDelta bucket_width_;
+  BucketMap buckets_;
+  FaultCounts totals_;
+
+  // The I/O of a hard fault is reported by thread on a later event, so we
+  // keep the bucket of the last hard fault of each thread until it comes.
+  typedef std::map<DWORD, BucketMap::iterator> ThreadHardFaultMap;
+  ThreadHardFaultMap pending_hard_faults_;
+
+  DISALLOW_COPY_AND_ASSIGN(PageFaultAggregator);
+};
+
+#endif  // SAWBUCK_LOG_LIB_PAGE_FAULT_AGGREGATOR_H_
@@ -0,0 +1,125 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Page fault aggregator unittests.
+#include "sawbuck/log_lib/page_fault_aggregator.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+const DWORD kPid = 1234;
+const DWORD kTid = 4321;
+
+class PageFaultAggregatorTest: public testing::Test {
+ public:
+  PageFaultAggregatorTest()
+      : aggregator_(base::TimeDelta::FromMilliseconds(100)),
+        kT0(base::Time::Now()),
+        kT1(kT0 + base::TimeDelta::FromMilliseconds(10)) {
+  }
+
+  virtual void SetUp() {
+    module_.base_address = 0x10000000;
+    module_.module_size = 0x100000;
+    module_.image_checksum = 0xCAFEBABE;
+    module_.time_date_stamp = 0xBABECAFE;
+    module_.image_file_name = L"c:\\foo\\bar.dll";
+    aggregator_.OnModuleIsLoaded(kPid, kT0, module_);
+  }
+
+ protected:
+  PageFaultAggregator aggregator_;
+  KernelModuleEvents::ModuleInformation module_;
+  const base::Time kT0;
+  const base::Time kT1;
+};
+
+}  // namespace
+
+TEST_F(PageFaultAggregatorTest, TalliesByModuleAndPage) {
+  aggregator_.OnTransitionFault(kPid, kTid, kT1, 0x10001010, 0);
+  aggregator_.OnTransitionFault(kPid, kTid, kT1, 0x10001FF0, 0);
+  aggregator_.OnDemandZeroFault(kPid, kTid, kT1, 0x10001000, 0);
+  aggregator_.OnDemandZeroFault(kPid, kTid, kT1, 0x10003000, 0);
+  // Outside of any module.
+  aggregator_.OnDemandZeroFault(kPid, kTid, kT1, 0x20000010, 0);
+
+  EXPECT_EQ(5U, aggregator_.totals().total_faults());
+  // The two transition faults share a bucket.
+  EXPECT_EQ(4U, aggregator_.bucket_count());
+
+  std::vector<PageFaultAggregator::ModuleFaults> modules;
+  aggregator_.GetTopModules(10, &modules);
+  ASSERT_EQ(2U, modules.size());
+  EXPECT_TRUE(modules[0].module == module_);
+  EXPECT_EQ(4U, modules[0].counts.total_faults());
+  EXPECT_EQ(2U,
+      modules[0].counts.faults[PageFaultAggregator::TRANSITION_FAULT]);
+  EXPECT_EQ(L"", modules[1].module.image_file_name);
+  EXPECT_EQ(1U, modules[1].counts.total_faults());
+
+  std::vector<PageFaultAggregator::PageFaults> pages;
+  aggregator_.GetTopPages(1, &pages);
+  ASSERT_EQ(1U, pages.size());
+  EXPECT_TRUE(pages[0].module == module_);
+  EXPECT_EQ(0x1000U, pages[0].page);
+  EXPECT_EQ(3U, pages[0].counts.total_faults());
+}
+
+TEST_F(PageFaultAggregatorTest, TalliesByTimeBucket) {
+  aggregator_.OnGuardPageFault(kPid, kTid, kT1, 0x10001000, 0);
+  aggregator_.OnGuardPageFault(kPid, kTid, kT1, 0x10001000, 0);
+  aggregator_.OnGuardPageFault(kPid, kTid,
+      kT1 + base::TimeDelta::FromSeconds(1), 0x10001000, 0);
+
+  EXPECT_EQ(2U, aggregator_.bucket_count());
+
+  std::vector<PageFaultAggregator::PageFaults> pages;
+  aggregator_.GetTopPages(10, &pages);
+  ASSERT_EQ(1U, pages.size());
+  EXPECT_EQ(3U, pages[0].counts.total_faults());
+}
+
+TEST_F(PageFaultAggregatorTest, JoinsHardPageFaults) {
+  aggregator_.OnHardFault(kPid, kTid, kT1, 0x10002000, 0);
+  aggregator_.OnHardPageFault(kTid, kT1 + base::TimeDelta::FromMilliseconds(5),
+                              kT1, 0x1000, 0x10002000, 0, 0x4000);
+  // A hard page fault on a thread without a hard fault is only totalled.
+  aggregator_.OnHardPageFault(kTid + 1, kT1, kT1, 0x1000, 0x10002000, 0,
+                              0x1000);
+  // As is a second one on the same thread.
+  aggregator_.OnHardPageFault(kTid, kT1, kT1, 0x1000, 0x10002000, 0,
+                              0x1000);
+
+  EXPECT_EQ(0x6000U, aggregator_.totals().hard_fault_bytes);
+
+  std::vector<PageFaultAggregator::ModuleFaults> modules;
+  aggregator_.GetTopModules(10, &modules);
+  ASSERT_EQ(1U, modules.size());
+  EXPECT_EQ(1U, modules[0].counts.faults[PageFaultAggregator::HARD_FAULT]);
+  EXPECT_EQ(0x4000U, modules[0].counts.hard_fault_bytes);
+  EXPECT_EQ(5, modules[0].counts.hard_fault_time.InMilliseconds());
+}
+
+TEST_F(PageFaultAggregatorTest, NoModuleAfterUnload) {
+  aggregator_.OnModuleUnload(kPid, kT1, module_);
+  aggregator_.OnTransitionFault(kPid, kTid,
+      kT1 + base::TimeDelta::FromMilliseconds(1), 0x10001000, 0);
+
+  std::vector<PageFaultAggregator::PageFaults> pages;
+  aggregator_.GetTopPages(10, &pages);
+  ASSERT_EQ(1U, pages.size());
+  EXPECT_EQ(L"", pages[0].module.image_file_name);
+  EXPECT_EQ(0x10001000U, pages[0].page);
+}
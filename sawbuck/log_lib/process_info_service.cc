@@ -15,6 +15,7 @@
 // Symbol information service implementation.
 #include "sawbuck/log_lib/process_info_service.h"
 
+#include "base/logging.h"
 #include "base/strings/string_util.h"
 #include "base/strings/utf_string_conversions.h"
 
@@ -29,53 +30,124 @@ bool IProcessInfoService::ProcessInfo::operator == (
          exit_code_ == other.exit_code_;
 }
 
-ProcessInfoService::ProcessInfoService() {
+ProcessInfoService::ProcessInfoService()
+    : snapshot_(reinterpret_cast<base::subtle::AtomicWord>(
+          new ProcessRecordMap())),
+      active_readers_(0) {
 }
 
 ProcessInfoService::~ProcessInfoService() {
+  // There must be no readers by now.
+  DCHECK_EQ(0, base::subtle::Acquire_Load(&active_readers_));
+  delete reinterpret_cast<ProcessRecordMap*>(
+      base::subtle::NoBarrier_Load(&snapshot_));
+  for (size_t i = 0; i < retired_snapshots_.size(); ++i)
+    delete retired_snapshots_[i];
 }
 
-ProcessInfoService::ProcessInfoMap::iterator ProcessInfoService::FindProcess(
+const ProcessInfoService::ProcessRecord* ProcessInfoService::FindProcess(
+    const ProcessRecordMap& processes, DWORD process_id,
+    const base::Time& time) {
+  ProcessRecordMap::const_iterator it(processes.find(process_id));
+  if (it == processes.end())
+    return NULL;
+
+  // Find the last process started at or before time, it's the one if it
+  // hasn't ended by then - where zero end time means infinity.
+  const ProcessRecords& records = it->second;
+  size_t lo = 0;
+  size_t hi = records.size();
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (time < records[mid].started_)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  if (lo == 0)
+    return NULL;
+
+  const ProcessRecord& record = records[lo - 1];
+  if (record.ended_ == base::Time() || time < record.ended_)
+    return &record;
+
+  return NULL;
+}
+
+ProcessInfoService::ProcessRecord* ProcessInfoService::FindProcess(
     DWORD process_id, const base::Time& time) {
   lock_.AssertAcquired();
-  ProcessKey key = std::make_pair(process_id, time);
-  ProcessInfoMap::iterator it(process_info_.lower_bound(key));
-
-  // We have two success cases here - either an exact match on {PID, time}, or
-  // else time > process start time, but < process end time, in which case
-  // lower bound will have returned us the next largest {PID, time} key,
-  // and we need to back up one.
-  if (it == process_info_.end() || it->first != key) {
-    // Are we at the beginning of the list, can't back up in that case.
-    if (it == process_info_.begin())
-      return process_info_.end();
-
-    --it;
-  }
+  return const_cast<ProcessRecord*>(
+      FindProcess(process_records_, process_id, time));
+}
 
-  // Are we pointing to relevant process info now? Need a match on pid,
-  // and (start <= time < end) - where zero end time means infinity.
-  if (it->first.first == process_id && it->second.started_ <= time &&
-      (it->second.ended_ == base::Time() || time < it->second.ended_)) {
-    return it;
-  }
+void ProcessInfoService::InsertProcess(DWORD process_id,
+                                       const ProcessRecord& record) {
+  lock_.AssertAcquired();
+  ProcessRecords& records = process_records_[process_id];
+  ProcessRecords::iterator it(records.begin());
+  while (it != records.end() && !(record.started_ < it->started_))
+    ++it;
+  records.insert(it, record);
+}
 
-  return process_info_.end();
+const std::wstring* ProcessInfoService::InternCommandLine(
+    const KernelProcessEvents::ProcessInfo& process_info) {
+  lock_.AssertAcquired();
+  std::wstring command_line(process_info.command_line);
+  if (command_line.empty())
+    command_line = base::UTF8ToWide(process_info.image_name);
+
+  CommandLineMap::iterator it(command_line_map_.find(command_line));
+  if (it != command_line_map_.end())
+    return it->second;
+
+  command_lines_.push_back(command_line);
+  const std::wstring* interned = &command_lines_.back();
+  command_line_map_.insert(std::make_pair(command_line, interned));
+  return interned;
+}
+
+void ProcessInfoService::Publish() {
+  lock_.AssertAcquired();
+
+  ProcessRecordMap* snapshot = new ProcessRecordMap(process_records_);
+  base::subtle::AtomicWord previous = base::subtle::NoBarrier_Load(&snapshot_);
+  base::subtle::Release_Store(&snapshot_,
+      reinterpret_cast<base::subtle::AtomicWord>(snapshot));
+  retired_snapshots_.push_back(reinterpret_cast<ProcessRecordMap*>(previous));
+
+  // A reader that counted itself in after the store above picks up the new
+  // snapshot, so with no readers, none can be holding a retired one.
+  base::subtle::MemoryBarrier();
+  if (base::subtle::Acquire_Load(&active_readers_) == 0) {
+    for (size_t i = 0; i < retired_snapshots_.size(); ++i)
+      delete retired_snapshots_[i];
+    retired_snapshots_.clear();
+  }
 }
 
 bool ProcessInfoService::GetProcessInfo(DWORD process_id,
     const base::Time& time, IProcessInfoService::ProcessInfo* info) {
-  base::AutoLock lock(lock_);
-
   DCHECK(info != NULL);
-  ProcessInfoMap::iterator it(FindProcess(process_id, time));
 
-  if (it != process_info_.end()) {
-    *info = it->second;
-    return true;
+  base::subtle::Barrier_AtomicIncrement(&active_readers_, 1);
+  const ProcessRecordMap* snapshot = reinterpret_cast<ProcessRecordMap*>(
+      base::subtle::Acquire_Load(&snapshot_));
+
+  const ProcessRecord* record = FindProcess(*snapshot, process_id, time);
+  if (record != NULL) {
+    info->started_ = record->started_;
+    info->ended_ = record->ended_;
+    info->process_id_ = process_id;
+    info->parent_process_id_ = record->parent_process_id_;
+    info->session_id_ = record->session_id_;
+    info->command_line_ = *record->command_line_;
+    info->exit_code_ = record->exit_code_;
   }
 
-  return false;
+  base::subtle::Barrier_AtomicIncrement(&active_readers_, -1);
+  return record != NULL;
 }
 
 void ProcessInfoService::OnProcessIsRunning(const base::Time& time,
@@ -89,47 +161,39 @@ void ProcessInfoService::OnProcessStarted(const base::Time& time,
   base::AutoLock lock(lock_);
 
    // See whether we have a record of this pid/time already.
-  ProcessInfoMap::iterator it(
-      FindProcess(process_info.process_id, time));
-  if (it == process_info_.end()) {
+  ProcessRecord* found = FindProcess(process_info.process_id, time);
+  if (found == NULL) {
     // Repack the kernel event to our notion of a process info.
-    IProcessInfoService::ProcessInfo to_insert = {
+    ProcessRecord to_insert = {
         time,  // started_
         base::Time(),  // ended_
-        process_info.process_id,
         process_info.parent_id,
         process_info.session_id,
-        L"",
+        InternCommandLine(process_info),
         STILL_ACTIVE,
       };
-    if (process_info.command_line.empty()) {
-      to_insert.command_line_ = base::UTF8ToWide(process_info.image_name);
-    } else {
-      to_insert.command_line_ = process_info.command_line;
-    }
-
-    ProcessKey key(process_info.process_id, time);
-    process_info_.insert(std::make_pair(key, to_insert));
+    InsertProcess(process_info.process_id, to_insert);
   } else {
-    // Make a copy of the process info.
-    IProcessInfoService::ProcessInfo copy = it->second;
+    // Make a copy of the process record.
+    ProcessRecord copy = *found;
 
     // We should have had an end time in the previous callback.
     DCHECK(base::Time() == copy.started_);
     DCHECK(base::Time() != copy.ended_);
 
     // Verify that we're seeing the same process info.
-    DCHECK_EQ(process_info.process_id, copy.process_id_);
     DCHECK_EQ(process_info.parent_id, copy.parent_process_id_);
     DCHECK_EQ(process_info.session_id, copy.session_id_);
 
     // Drop the old entry, fix up the start time and reinsert it.
-    process_info_.erase(it);
+    ProcessRecords& records = process_records_[process_info.process_id];
+    records.erase(records.begin() + (found - &records[0]));
 
     copy.started_ = time;
-    ProcessKey key(process_info.process_id, time);
-    process_info_.insert(std::make_pair(key, copy));
+    InsertProcess(process_info.process_id, copy);
   }
+
+  Publish();
 }
 
 void ProcessInfoService::OnProcessEnded(const base::Time& time,
@@ -138,36 +202,28 @@ void ProcessInfoService::OnProcessEnded(const base::Time& time,
   base::AutoLock lock(lock_);
 
   // See whether we have a record of this pid/time already.
-  ProcessInfoMap::iterator it(
-      FindProcess(process_info.process_id, time));
-  if (it == process_info_.end()) {
+  ProcessRecord* found = FindProcess(process_info.process_id, time);
+  if (found == NULL) {
     // Repack the kernel event to our notion of a process info.
-    IProcessInfoService::ProcessInfo to_insert = {
+    ProcessRecord to_insert = {
         base::Time(),  // started_
         time,  // ended_
-        process_info.process_id,
         process_info.parent_id,
         process_info.session_id,
-        L"",
+        InternCommandLine(process_info),
         exit_status,
       };
-    if (process_info.command_line.empty()) {
-      to_insert.command_line_ = base::UTF8ToWide(process_info.image_name);
-    } else {
-      to_insert.command_line_ = process_info.command_line;
-    }
-
-    ProcessKey key(process_info.process_id, base::Time());
-    process_info_.insert(std::make_pair(key, to_insert));
+    InsertProcess(process_info.process_id, to_insert);
   } else {
     // We should not have had an end time in the previous callback.
-    DCHECK(base::Time() == it->second.ended_);
+    DCHECK(base::Time() == found->ended_);
     // Verify that we're seeing the same process info.
-    DCHECK_EQ(process_info.process_id, it->second.process_id_);
-    DCHECK_EQ(process_info.parent_id, it->second.parent_process_id_);
-    DCHECK_EQ(process_info.session_id, it->second.session_id_);
+    DCHECK_EQ(process_info.parent_id, found->parent_process_id_);
+    DCHECK_EQ(process_info.session_id, found->session_id_);
 
-    it->second.ended_ = time;
-    it->second.exit_code_ = exit_status;
+    found->ended_ = time;
+    found->exit_code_ = exit_status;
   }
+
+  Publish();
 }
@@ -16,7 +16,12 @@
 #ifndef SAWBUCK_LOG_LIB_PROCESS_INFO_SERVICE_H_
 #define SAWBUCK_LOG_LIB_PROCESS_INFO_SERVICE_H_
 
+#include <deque>
 #include <map>
+#include <string>
+#include <vector>
+#include "base/atomicops.h"
+#include "base/basictypes.h"
 #include "base/synchronization/lock.h"
 #include "sawbuck/log_lib/kernel_log_consumer.h"
 
@@ -47,6 +52,8 @@ class MessageLoop;
 
 // The process info service class sinks process events from a kernel log
 // parser, and stores away the process information for later retrieval.
+// Lookups never block on the writer, as they go by an immutable snapshot
+// the writer publishes after each change.
 class ProcessInfoService
     : public IProcessInfoService,
       public KernelProcessEvents {
@@ -68,14 +75,67 @@ class ProcessInfoService
       ULONG exit_status);
 
  private:
-  typedef std::pair<DWORD, base::Time> ProcessKey;
-  typedef std::map<ProcessKey, IProcessInfoService::ProcessInfo>
-      ProcessInfoMap;
-  ProcessInfoMap::iterator FindProcess(DWORD process_id,
-      const base::Time& time);
+  // A process, with its command line interned in command_lines_.
+  struct ProcessRecord {
+    base::Time started_;
+    base::Time ended_;
+    DWORD parent_process_id_;
+    DWORD session_id_;
+    const std::wstring* command_line_;
+    DWORD exit_code_;
+  };
+  // The processes of a pid, sorted by start time.
+  typedef std::vector<ProcessRecord> ProcessRecords;
+  typedef std::map<DWORD, ProcessRecords> ProcessRecordMap;
+
+  // @returns the record of the process that had @p process_id at @p time
+  //     in @p processes, or NULL.
+  static const ProcessRecord* FindProcess(const ProcessRecordMap& processes,
+                                          DWORD process_id,
+                                          const base::Time& time);
+  // As above, but mutable, for process_records_.
+  // @pre lock_ is held.
+  ProcessRecord* FindProcess(DWORD process_id, const base::Time& time);
 
+  // Inserts @p record for @p process_id into process_records_, in order.
+  // @pre lock_ is held.
+  void InsertProcess(DWORD process_id, const ProcessRecord& record);
+
+  // @returns the interned copy of the command line of @p process_info.
+  // @pre lock_ is held.
+  const std::wstring* InternCommandLine(
+      const KernelProcessEvents::ProcessInfo& process_info);
+
+  // Publishes a snapshot of process_records_ for readers, and frees the
+  // snapshots no reader can be using any more.
+  // @pre lock_ is held.
+  void Publish();
+
+  // Only serializes the writers, readers go by the published snapshot.
   base::Lock lock_;
-  ProcessInfoMap process_info_;  // Under lock_.
+
+  // The processes we know of, which the published snapshots copy.
+  ProcessRecordMap process_records_;  // Under lock_.
+
+  // The command lines, in a deque so that they stay put for lock-free
+  // readers, which refer to them by pointer. They're never released.
+  std::deque<std::wstring> command_lines_;  // Under lock_.
+  typedef std::map<std::wstring, const std::wstring*> CommandLineMap;
+  CommandLineMap command_line_map_;  // Under lock_.
+
+  // The snapshot readers use, which is never modified once published.
+  // Written with release semantics, read with acquire semantics.
+  base::subtle::AtomicWord snapshot_;
+
+  // The number of readers currently looking at a snapshot. A replaced
+  // snapshot is freed once the writer sees no readers, as readers count
+  // themselves in before picking up the snapshot.
+  base::subtle::Atomic32 active_readers_;
+
+  // The snapshots replaced but possibly still in use.
+  std::vector<ProcessRecordMap*> retired_snapshots_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(ProcessInfoService);
 };
 
 #endif  // SAWBUCK_LOG_LIB_PROCESS_INFO_SERVICE_H_
@@ -209,4 +209,27 @@ TEST_F(ProcessInfoServiceTest, EndStart) {
   EXPECT_FALSE(service_.GetProcessInfo(kPid, kT2, &info));
 }
 
+TEST_F(ProcessInfoServiceTest, RecycledPid) {
+  const wchar_t kOtherCommandLine[] = L"bar.exe";
+  const base::Time kT3(kT2 + base::TimeDelta::FromMilliseconds(97));
+
+  // The pid goes to another process as the first ends, and both of them
+  // are looked up by time.
+  StartProcess(kT1, kPid, kParentPid, kSession, Sids::World(),
+      kImageName, kCommandLine);
+  EndProcess(kT2, kPid, kParentPid, kSession, Sids::World(),
+      kImageName, kCommandLine, kExitCode);
+  StartProcess(kT2, kPid, kParentPid, kSession, Sids::World(),
+      kImageName, kOtherCommandLine);
+
+  IProcessInfoService::ProcessInfo info = {};
+  EXPECT_TRUE(service_.GetProcessInfo(kPid, kT1, &info));
+  EXPECT_STREQ(kCommandLine, info.command_line_.c_str());
+  EXPECT_TRUE(service_.GetProcessInfo(kPid, kT2, &info));
+  EXPECT_STREQ(kOtherCommandLine, info.command_line_.c_str());
+  EXPECT_TRUE(service_.GetProcessInfo(kPid, kT3, &info));
+  EXPECT_TRUE(kT2 == info.started_);
+  EXPECT_EQ(STILL_ACTIVE, info.exit_code_);
+}
+
 }  // namespace
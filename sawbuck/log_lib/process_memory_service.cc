@@ -0,0 +1,421 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Process memory service implementation.
+#include "sawbuck/log_lib/process_memory_service.h"
+
+#include <algorithm>
+#include "base/logging.h"
+#include "base/stl_util.h"
+
+const size_t ProcessMemoryService::kDefaultMaxBuckets;
+const int64 ProcessMemoryService::kFinestBucketUs;
+const int64 ProcessMemoryService::kLevelFactor;
+const size_t ProcessMemoryService::kLevelCount;
+const int64 ProcessMemoryService::kMaxBucketsPerLevel;
+
+ProcessMemoryService::ProcessMemoryService()
+    : max_buckets_(kDefaultMaxBuckets),
+      process_sink_(NULL),
+      page_fault_sink_(NULL),
+      num_buckets_(0) {
+}
+
+ProcessMemoryService::ProcessMemoryService(size_t max_buckets)
+    : max_buckets_(max_buckets),
+      process_sink_(NULL),
+      page_fault_sink_(NULL),
+      num_buckets_(0) {
+  DCHECK_LT(0U, max_buckets);
+}
+
+ProcessMemoryService::~ProcessMemoryService() {
+  STLDeleteElements(&instances_);
+}
+
+size_t ProcessMemoryService::num_buckets() {
+  base::AutoLock lock(lock_);
+  return num_buckets_;
+}
+
+int64 ProcessMemoryService::BucketWidth(size_t level) {
+  DCHECK_LT(level, kLevelCount);
+  int64 width = kFinestBucketUs;
+  for (size_t i = 0; i < level; ++i)
+    width *= kLevelFactor;
+  return width;
+}
+
+void ProcessMemoryService::GetInstances(std::vector<Instance>* instances) {
+  DCHECK(instances != NULL);
+  base::AutoLock lock(lock_);
+  instances->clear();
+  instances->reserve(instances_.size());
+  for (size_t i = 0; i < instances_.size(); ++i)
+    instances->push_back(instances_[i]->instance);
+}
+
+bool ProcessMemoryService::GetTimeRange(base::Time* first,
+                                        base::Time* last) {
+  DCHECK(first != NULL);
+  DCHECK(last != NULL);
+  base::AutoLock lock(lock_);
+  if (first_.is_null())
+    return false;
+
+  *first = first_;
+  *last = last_;
+  return true;
+}
+
+void ProcessMemoryService::GetSamples(InstanceId id,
+                                      const base::Time& from,
+                                      const base::Time& to,
+                                      size_t sample_count,
+                                      std::vector<Sample>* samples) {
+  DCHECK(samples != NULL);
+  Sample empty = {};
+  samples->assign(sample_count, empty);
+
+  int64 slice_us = 0;
+  if (sample_count != 0)
+    slice_us = (to - from).InMicroseconds() / sample_count;
+  if (slice_us <= 0)
+    return;
+
+  base::AutoLock lock(lock_);
+  if (id >= instances_.size())
+    return;
+  const InstanceData& data = *instances_[id];
+
+  // Use the coarsest level no coarser than a slice, or a coarser one where
+  // that level's buckets of the start of the range were released.
+  int64 origin = from.ToInternalValue();
+  size_t level_index = 0;
+  while (level_index + 1 < kLevelCount &&
+         BucketWidth(level_index + 1) <= slice_us) {
+    ++level_index;
+  }
+  while (level_index + 1 < kLevelCount) {
+    const Level& level = data.levels[level_index];
+    if (!level.released || level.first * BucketWidth(level_index) <= origin)
+      break;
+    ++level_index;
+  }
+  const Level& level = data.levels[level_index];
+  if (level.buckets.empty())
+    return;
+
+  int64 width = BucketWidth(level_index);
+  int64 level_last = level.first +
+      static_cast<int64>(level.buckets.size()) - 1;
+  int64 ended = data.instance.ended.is_null() ?
+      kint64max : data.instance.ended.ToInternalValue();
+  for (size_t i = 0; i < sample_count; ++i) {
+    int64 slice_begin = origin + static_cast<int64>(i) * slice_us;
+    int64 first = std::max(level.first, slice_begin / width);
+    int64 last = std::min(level_last, (slice_begin + slice_us - 1) / width);
+    Sample& sample = (*samples)[i];
+    if (first > last) {
+      // Past the buckets, the latest counters hold while the instance
+      // runs.
+      if (first > level_last && slice_begin < ended) {
+        sample.working_set = level.buckets.back().working_set;
+        sample.commit = level.buckets.back().commit;
+      }
+      continue;
+    }
+
+    int64 page_faults = 0;
+    for (int64 j = first; j <= last; ++j) {
+      const Bucket& bucket =
+          level.buckets[static_cast<size_t>(j - level.first)];
+      sample.working_set = std::max(sample.working_set, bucket.working_set);
+      sample.commit = std::max(sample.commit, bucket.commit);
+      page_faults += bucket.page_faults;
+    }
+    sample.page_faults_per_second = page_faults * 1e6 /
+        ((last - first + 1) * width);
+  }
+}
+
+void ProcessMemoryService::OnProcessCounters(
+    const base::Time& time, const ProcessCounters& counters) {
+  base::AutoLock lock(lock_);
+  InstanceData* data = GetInstance(counters.process_id);
+  Instance& instance = data->instance;
+  instance.peak_working_set = std::max(instance.peak_working_set,
+      std::max(counters.working_set, counters.peak_working_set));
+  instance.peak_commit = std::max(instance.peak_commit,
+      std::max(counters.commit, counters.peak_commit));
+
+  for (size_t i = 0; i < kLevelCount; ++i) {
+    Bucket* bucket = GetBucket(time, i, &data->levels[i]);
+    if (bucket == NULL)
+      continue;
+
+    if (bucket->sampled) {
+      bucket->working_set = std::max(bucket->working_set,
+                                     counters.working_set);
+      bucket->commit = std::max(bucket->commit, counters.commit);
+    } else {
+      bucket->working_set = counters.working_set;
+      bucket->commit = counters.commit;
+      bucket->sampled = true;
+    }
+  }
+
+  UpdateTimeRange(time);
+  ReleaseBuckets();
+}
+
+void ProcessMemoryService::OnTransitionFault(
+    DWORD process_id, DWORD thread_id, const base::Time& time,
+    sym_util::Address address, sym_util::Address program_counter) {
+  AddPageFault(process_id, time);
+  if (page_fault_sink_ != NULL) {
+    page_fault_sink_->OnTransitionFault(process_id, thread_id, time, address,
+                                        program_counter);
+  }
+}
+
+void ProcessMemoryService::OnDemandZeroFault(
+    DWORD process_id, DWORD thread_id, const base::Time& time,
+    sym_util::Address address, sym_util::Address program_counter) {
+  AddPageFault(process_id, time);
+  if (page_fault_sink_ != NULL) {
+    page_fault_sink_->OnDemandZeroFault(process_id, thread_id, time, address,
+                                        program_counter);
+  }
+}
+
+void ProcessMemoryService::OnCopyOnWriteFault(
+    DWORD process_id, DWORD thread_id, const base::Time& time,
+    sym_util::Address address, sym_util::Address program_counter) {
+  AddPageFault(process_id, time);
+  if (page_fault_sink_ != NULL) {
+    page_fault_sink_->OnCopyOnWriteFault(process_id, thread_id, time,
+                                         address, program_counter);
+  }
+}
+
+void ProcessMemoryService::OnGuardPageFault(
+    DWORD process_id, DWORD thread_id, const base::Time& time,
+    sym_util::Address address, sym_util::Address program_counter) {
+  AddPageFault(process_id, time);
+  if (page_fault_sink_ != NULL) {
+    page_fault_sink_->OnGuardPageFault(process_id, thread_id, time, address,
+                                       program_counter);
+  }
+}
+
+void ProcessMemoryService::OnHardFault(
+    DWORD process_id, DWORD thread_id, const base::Time& time,
+    sym_util::Address address, sym_util::Address program_counter) {
+  AddPageFault(process_id, time);
+  if (page_fault_sink_ != NULL) {
+    page_fault_sink_->OnHardFault(process_id, thread_id, time, address,
+                                  program_counter);
+  }
+}
+
+void ProcessMemoryService::OnAccessViolationFault(
+    DWORD process_id, DWORD thread_id, const base::Time& time,
+    sym_util::Address address, sym_util::Address program_counter) {
+  AddPageFault(process_id, time);
+  if (page_fault_sink_ != NULL) {
+    page_fault_sink_->OnAccessViolationFault(process_id, thread_id, time,
+                                             address, program_counter);
+  }
+}
+
+void ProcessMemoryService::OnHardPageFault(
+    DWORD thread_id, const base::Time& time, const base::Time& initial_time,
+    sym_util::Offset offset, sym_util::Address address,
+    sym_util::Address file_object, sym_util::ByteCount byte_count) {
+  if (page_fault_sink_ != NULL) {
+    page_fault_sink_->OnHardPageFault(thread_id, time, initial_time, offset,
+                                      address, file_object, byte_count);
+  }
+}
+
+void ProcessMemoryService::OnProcessIsRunning(
+    const base::Time& time, const ProcessInfo& process_info) {
+  {
+    base::AutoLock lock(lock_);
+    // The instance may be known by its counters or faults already.
+    CurrentInstanceMap::const_iterator it(
+        current_instances_.find(process_info.process_id));
+    InstanceData* data = NULL;
+    if (it != current_instances_.end() &&
+        instances_[it->second]->instance.ended.is_null()) {
+      data = instances_[it->second];
+    } else {
+      data = AddInstance(process_info.process_id, base::Time());
+    }
+    if (data->instance.image_name.empty())
+      data->instance.image_name = process_info.image_name;
+    UpdateTimeRange(time);
+  }
+  if (process_sink_ != NULL)
+    process_sink_->OnProcessIsRunning(time, process_info);
+}
+
+void ProcessMemoryService::OnProcessStarted(
+    const base::Time& time, const ProcessInfo& process_info) {
+  {
+    base::AutoLock lock(lock_);
+    InstanceData* data = AddInstance(process_info.process_id, time);
+    data->instance.image_name = process_info.image_name;
+    UpdateTimeRange(time);
+  }
+  if (process_sink_ != NULL)
+    process_sink_->OnProcessStarted(time, process_info);
+}
+
+void ProcessMemoryService::OnProcessEnded(const base::Time& time,
+                                          const ProcessInfo& process_info,
+                                          ULONG exit_status) {
+  {
+    base::AutoLock lock(lock_);
+    CurrentInstanceMap::const_iterator it(
+        current_instances_.find(process_info.process_id));
+    InstanceData* data = NULL;
+    if (it != current_instances_.end() &&
+        instances_[it->second]->instance.ended.is_null()) {
+      data = instances_[it->second];
+    } else {
+      data = AddInstance(process_info.process_id, base::Time());
+    }
+    data->instance.ended = time;
+    if (data->instance.image_name.empty())
+      data->instance.image_name = process_info.image_name;
+    UpdateTimeRange(time);
+  }
+  if (process_sink_ != NULL)
+    process_sink_->OnProcessEnded(time, process_info, exit_status);
+}
+
+ProcessMemoryService::Bucket* ProcessMemoryService::GetBucket(
+    const base::Time& time, size_t level_index, Level* level) {
+  lock_.AssertAcquired();
+  DCHECK(level != NULL);
+
+  int64 index = time.ToInternalValue() / BucketWidth(level_index);
+  Bucket empty = {};
+  if (level->buckets.empty()) {
+    level->first = index;
+    level->buckets.push_back(empty);
+    ++num_buckets_;
+    return &level->buckets.front();
+  }
+
+  int64 last = level->first + static_cast<int64>(level->buckets.size()) - 1;
+  if (index < level->first) {
+    // The events come in about in order, but not exactly so. Earlier
+    // buckets have no samples before them.
+    if (level->released || last - index >= kMaxBucketsPerLevel)
+      return NULL;
+    size_t count = static_cast<size_t>(level->first - index);
+    level->buckets.insert(level->buckets.begin(), count, empty);
+    level->first = index;
+    num_buckets_ += count;
+  } else if (index > last) {
+    if (index - level->first >= kMaxBucketsPerLevel)
+      return NULL;
+    Bucket held = level->buckets.back();
+    held.page_faults = 0;
+    held.sampled = false;
+    size_t count = static_cast<size_t>(index - last);
+    level->buckets.resize(level->buckets.size() + count, held);
+    num_buckets_ += count;
+  }
+
+  return &level->buckets[static_cast<size_t>(index - level->first)];
+}
+
+ProcessMemoryService::InstanceData* ProcessMemoryService::GetInstance(
+    DWORD process_id) {
+  lock_.AssertAcquired();
+  CurrentInstanceMap::const_iterator it(current_instances_.find(process_id));
+  if (it != current_instances_.end())
+    return instances_[it->second];
+
+  return AddInstance(process_id, base::Time());
+}
+
+ProcessMemoryService::InstanceData* ProcessMemoryService::AddInstance(
+    DWORD process_id, const base::Time& time) {
+  lock_.AssertAcquired();
+  InstanceData* data = new InstanceData();
+  Instance& instance = data->instance;
+  instance.id = instances_.size();
+  instance.process_id = process_id;
+  instance.started = time;
+  instance.peak_working_set = 0;
+  instance.peak_commit = 0;
+  instance.page_faults = 0;
+  instances_.push_back(data);
+  current_instances_[process_id] = instance.id;
+  return data;
+}
+
+void ProcessMemoryService::AddPageFault(DWORD process_id,
+                                        const base::Time& time) {
+  base::AutoLock lock(lock_);
+  InstanceData* data = GetInstance(process_id);
+  ++data->instance.page_faults;
+  for (size_t i = 0; i < kLevelCount; ++i) {
+    Bucket* bucket = GetBucket(time, i, &data->levels[i]);
+    if (bucket != NULL)
+      ++bucket->page_faults;
+  }
+
+  UpdateTimeRange(time);
+  ReleaseBuckets();
+}
+
+void ProcessMemoryService::UpdateTimeRange(const base::Time& time) {
+  lock_.AssertAcquired();
+  if (first_.is_null() || time < first_)
+    first_ = time;
+  last_ = std::max(last_, time);
+}
+
+void ProcessMemoryService::ReleaseBuckets() {
+  lock_.AssertAcquired();
+  for (size_t level_index = 0;
+       num_buckets_ > max_buckets_ && level_index + 1 < kLevelCount;
+       ++level_index) {
+    bool released = true;
+    while (released && num_buckets_ > max_buckets_) {
+      // Halve the level of each instance, rounding up so that a level of a
+      // single bucket goes too.
+      released = false;
+      for (size_t i = 0; i < instances_.size(); ++i) {
+        Level& level = instances_[i]->levels[level_index];
+        if (level.buckets.empty())
+          continue;
+
+        size_t count = (level.buckets.size() + 1) / 2;
+        level.buckets.erase(level.buckets.begin(),
+                            level.buckets.begin() + count);
+        level.first += count;
+        level.released = true;
+        num_buckets_ -= count;
+        released = true;
+      }
+    }
+  }
+}
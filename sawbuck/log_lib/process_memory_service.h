@@ -0,0 +1,268 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Process memory service declaration.
+#ifndef SAWBUCK_LOG_LIB_PROCESS_MEMORY_SERVICE_H_
+#define SAWBUCK_LOG_LIB_PROCESS_MEMORY_SERVICE_H_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "base/synchronization/lock.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+
+// The process memory service answers the memory queries of a chart pane.
+class IProcessMemoryService {
+ public:
+  // Identifies an instance, in the order the instances were added.
+  typedef size_t InstanceId;
+
+  // A process instance, told apart from the other instances of its
+  // process id by its start time.
+  struct Instance {
+    InstanceId id;
+    DWORD process_id;
+    // Null for processes that were running as the log began.
+    base::Time started;
+    // Null while the process is running.
+    base::Time ended;
+    // Empty for a process the kernel log only told the counters or page
+    // faults of.
+    std::string image_name;
+    // The peaks of the counters sampled, in bytes.
+    uint64 peak_working_set;
+    uint64 peak_commit;
+    // The page faults of the instance in the log.
+    int64 page_faults;
+  };
+
+  // The memory of an instance within a slice of time.
+  struct Sample {
+    // The largest working set and commit sampled within the slice, or the
+    // latest sampled before it, in bytes. Zero before the first sample.
+    uint64 working_set;
+    uint64 commit;
+    // The rate of page faults over the slice.
+    double page_faults_per_second;
+  };
+
+  // Retrieves the instances to @p instances, in order of their ids.
+  virtual void GetInstances(std::vector<Instance>* instances) = 0;
+
+  // Retrieves the times of the earliest and latest events to @p first and
+  // @p last.
+  // @returns false if we have no events.
+  virtual bool GetTimeRange(base::Time* first, base::Time* last) = 0;
+
+  // Divides [@p from, @p to) into @p sample_count equal slices, and
+  // retrieves the memory of the instance @p id within each of them to
+  // @p samples. This costs in the order of the number of samples, and of
+  // the buckets of the level of detail that serves them.
+  virtual void GetSamples(InstanceId id,
+                          const base::Time& from,
+                          const base::Time& to,
+                          size_t sample_count,
+                          std::vector<Sample>* samples) = 0;
+};
+
+// The process memory service sinks the memory counters, page faults and
+// process events of a kernel log parser, and keeps a timeline of the
+// working set, commit and page fault rate of each process instance. The
+// kernel counts the memory of a process as it ends and at the rundowns of
+// the session, so the working set and commit are sampled sparsely, and
+// held from one sample to the next, while the page faults are counted as
+// they come.
+// The timelines are kept down-sampled to a number of levels of detail, each
+// kLevelFactor times coarser than the last, and no raw samples are held.
+// Past a budget of buckets over all instances, the oldest half of the
+// finest level that has buckets is released across the instances, so that
+// long captures keep their coarse history and lose only their fine detail.
+// The process and page fault events are passed on to other sinks, so the
+// service can sit in the chains of sinks of the kernel log.
+// @note this class is thread safe.
+class ProcessMemoryService
+    : public IProcessMemoryService,
+      public KernelMemoryEvents,
+      public KernelPageFaultEvents,
+      public KernelProcessEvents {
+ public:
+  // The default most buckets we hold over all instances and levels.
+  static const size_t kDefaultMaxBuckets = 1024 * 1024;
+
+  // The width of the buckets of the finest level, in microseconds.
+  static const int64 kFinestBucketUs = 100 * 1000;
+  // The ratio of the bucket widths of adjacent levels.
+  static const int64 kLevelFactor = 8;
+  static const size_t kLevelCount = 5;
+  // The most buckets of a level, past which the level stops accounting
+  // events, which bounds the memory of an instance with a bad timestamp.
+  static const int64 kMaxBucketsPerLevel = 1024 * 1024;
+
+  ProcessMemoryService();
+  explicit ProcessMemoryService(size_t max_buckets);
+  ~ProcessMemoryService();
+
+  // Set the sinks to pass the events on to, NULL for none.
+  // @pre no events are being issued.
+  // @{
+  void set_process_event_sink(KernelProcessEvents* process_sink) {
+    process_sink_ = process_sink;
+  }
+  void set_page_fault_event_sink(KernelPageFaultEvents* page_fault_sink) {
+    page_fault_sink_ = page_fault_sink;
+  }
+  // @}
+
+  // @returns the number of buckets held over all instances and levels.
+  size_t num_buckets();
+
+  // IProcessMemoryService implementation.
+  virtual void GetInstances(std::vector<Instance>* instances);
+  virtual bool GetTimeRange(base::Time* first, base::Time* last);
+  virtual void GetSamples(InstanceId id,
+                          const base::Time& from,
+                          const base::Time& to,
+                          size_t sample_count,
+                          std::vector<Sample>* samples);
+
+  // KernelMemoryEvents implementation.
+  virtual void OnProcessCounters(const base::Time& time,
+                                 const ProcessCounters& counters);
+
+  // KernelPageFaultEvents implementation. The hard page faults tell no
+  // process, and are only passed on.
+  virtual void OnTransitionFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter);
+  virtual void OnDemandZeroFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter);
+  virtual void OnCopyOnWriteFault(DWORD process_id,
+                                  DWORD thread_id,
+                                  const base::Time& time,
+                                  sym_util::Address address,
+                                  sym_util::Address program_counter);
+  virtual void OnGuardPageFault(DWORD process_id,
+                                DWORD thread_id,
+                                const base::Time& time,
+                                sym_util::Address address,
+                                sym_util::Address program_counter);
+  virtual void OnHardFault(DWORD process_id,
+                           DWORD thread_id,
+                           const base::Time& time,
+                           sym_util::Address address,
+                           sym_util::Address program_counter);
+  virtual void OnAccessViolationFault(DWORD process_id,
+                                      DWORD thread_id,
+                                      const base::Time& time,
+                                      sym_util::Address address,
+                                      sym_util::Address program_counter);
+  virtual void OnHardPageFault(DWORD thread_id,
+                               const base::Time& time,
+                               const base::Time& initial_time,
+                               sym_util::Offset offset,
+                               sym_util::Address address,
+                               sym_util::Address file_object,
+                               sym_util::ByteCount byte_count);
+
+  // KernelProcessEvents implementation.
+  virtual void OnProcessIsRunning(const base::Time& time,
+                                  const ProcessInfo& process_info);
+  virtual void OnProcessStarted(const base::Time& time,
+                                const ProcessInfo& process_info);
+  virtual void OnProcessEnded(const base::Time& time,
+                              const ProcessInfo& process_info,
+                              ULONG exit_status);
+
+ private:
+  // The memory of an instance within a bucket of a level. Buckets without
+  // samples hold the counters of the latest sample before them as they're
+  // added, a sample that comes in late doesn't update those after it.
+  struct Bucket {
+    uint64 working_set;
+    uint64 commit;
+    uint32 page_faults;
+    bool sampled;
+  };
+
+  // The buckets of a level, dense from the bucket at index first.
+  struct Level {
+    Level() : first(0), released(false) {}
+
+    int64 first;
+    std::deque<Bucket> buckets;
+    // True once buckets were released off the front of the level, after
+    // which earlier events are no longer accounted to it.
+    bool released;
+  };
+
+  struct InstanceData {
+    Instance instance;
+    Level levels[kLevelCount];
+  };
+
+  // @returns the width of the buckets of @p level in microseconds.
+  static int64 BucketWidth(size_t level);
+
+  // @returns the bucket of @p level holding @p time, adding it and the
+  //     buckets between it and the level's as needed, or NULL if @p time
+  //     is out of the level's reach.
+  // @pre lock_ is held.
+  Bucket* GetBucket(const base::Time& time, size_t level_index,
+                    Level* level);
+
+  // @returns the instance of @p process_id, adding one of an unknown
+  //     start if there's none.
+  // @pre lock_ is held.
+  InstanceData* GetInstance(DWORD process_id);
+
+  // Adds an instance of @p process_id started at @p time.
+  // @pre lock_ is held.
+  InstanceData* AddInstance(DWORD process_id, const base::Time& time);
+
+  // Accounts a page fault of @p process_id at @p time.
+  void AddPageFault(DWORD process_id, const base::Time& time);
+
+  // Notes the time of an event in the time range.
+  // @pre lock_ is held.
+  void UpdateTimeRange(const base::Time& time);
+
+  // Releases the oldest buckets of the finest levels until we're within
+  // our budget, or only the coarsest level is left.
+  // @pre lock_ is held.
+  void ReleaseBuckets();
+
+  const size_t max_buckets_;
+
+  KernelProcessEvents* process_sink_;
+  KernelPageFaultEvents* page_fault_sink_;
+
+  base::Lock lock_;
+  std::vector<InstanceData*> instances_;  // Under lock_.
+  // The latest instance of each process id.
+  typedef std::map<DWORD, InstanceId> CurrentInstanceMap;
+  CurrentInstanceMap current_instances_;  // Under lock_.
+  size_t num_buckets_;  // Under lock_.
+  base::Time first_;  // Under lock_.
+  base::Time last_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(ProcessMemoryService);
+};
+
+#endif  // SAWBUCK_LOG_LIB_PROCESS_MEMORY_SERVICE_H_
@@ -0,0 +1,188 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Process memory service unittests.
+#include "sawbuck/log_lib/process_memory_service.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using testing::_;
+using testing::StrictMock;
+
+const DWORD kPid = 1234;
+const DWORD kTid = 4321;
+const uint64 kMB = 1024 * 1024;
+
+class MockProcessEvents : public KernelProcessEvents {
+ public:
+  MOCK_METHOD2(OnProcessIsRunning, void(const base::Time& time,
+                                        const ProcessInfo& process_info));
+  MOCK_METHOD2(OnProcessStarted, void(const base::Time& time,
+                                      const ProcessInfo& process_info));
+  MOCK_METHOD3(OnProcessEnded, void(const base::Time& time,
+                                    const ProcessInfo& process_info,
+                                    ULONG exit_status));
+};
+
+class ProcessMemoryServiceTest: public testing::Test {
+ public:
+  // The origin is on a bucket boundary of every level.
+  ProcessMemoryServiceTest() : kT0(base::Time::FromInternalValue(
+      ProcessMemoryService::kFinestBucketUs * 4096 * 100 * 1000)) {
+  }
+
+  base::Time Ms(int64 ms) {
+    return kT0 + base::TimeDelta::FromMilliseconds(ms);
+  }
+
+  KernelProcessEvents::ProcessInfo MakeProcessInfo(DWORD process_id,
+                                                   const char* image_name) {
+    KernelProcessEvents::ProcessInfo info = {};
+    info.process_id = process_id;
+    info.image_name = image_name;
+    return info;
+  }
+
+  void AddCounters(ProcessMemoryService* service, DWORD process_id,
+                   int64 ms, uint64 working_set, uint64 commit) {
+    KernelMemoryEvents::ProcessCounters counters = {};
+    counters.process_id = process_id;
+    counters.working_set = working_set;
+    counters.commit = commit;
+    service->OnProcessCounters(Ms(ms), counters);
+  }
+
+  void AddFaults(ProcessMemoryService* service, DWORD process_id,
+                 int64 ms, int count) {
+    for (int i = 0; i < count; ++i)
+      service->OnDemandZeroFault(process_id, kTid, Ms(ms), 0x1000, 0x2000);
+  }
+
+ protected:
+  const base::Time kT0;
+  ProcessMemoryService service_;
+};
+
+}  // namespace
+
+TEST_F(ProcessMemoryServiceTest, SamplesMemoryAndFaultRate) {
+  base::Time first, last;
+  EXPECT_FALSE(service_.GetTimeRange(&first, &last));
+
+  service_.OnProcessStarted(Ms(0), MakeProcessInfo(kPid, "foo.exe"));
+  AddCounters(&service_, kPid, 0, 10 * kMB, 5 * kMB);
+  AddFaults(&service_, kPid, 50, 10);
+  AddCounters(&service_, kPid, 500, 20 * kMB, 8 * kMB);
+
+  ASSERT_TRUE(service_.GetTimeRange(&first, &last));
+  EXPECT_EQ(Ms(0), first);
+  EXPECT_EQ(Ms(500), last);
+
+  std::vector<IProcessMemoryService::Instance> instances;
+  service_.GetInstances(&instances);
+  ASSERT_EQ(1U, instances.size());
+  EXPECT_EQ(kPid, instances[0].process_id);
+  EXPECT_EQ(Ms(0), instances[0].started);
+  EXPECT_EQ("foo.exe", instances[0].image_name);
+  EXPECT_EQ(20 * kMB, instances[0].peak_working_set);
+  EXPECT_EQ(8 * kMB, instances[0].peak_commit);
+  EXPECT_EQ(10, instances[0].page_faults);
+
+  // Slices as wide as the finest buckets.
+  std::vector<IProcessMemoryService::Sample> samples;
+  service_.GetSamples(instances[0].id, Ms(0), Ms(1000), 10, &samples);
+  ASSERT_EQ(10U, samples.size());
+  EXPECT_EQ(10 * kMB, samples[0].working_set);
+  EXPECT_EQ(5 * kMB, samples[0].commit);
+  EXPECT_DOUBLE_EQ(100.0, samples[0].page_faults_per_second);
+  // The counters hold from one sample to the next, and past the last.
+  EXPECT_EQ(10 * kMB, samples[4].working_set);
+  EXPECT_EQ(0, samples[4].page_faults_per_second);
+  EXPECT_EQ(20 * kMB, samples[5].working_set);
+  EXPECT_EQ(8 * kMB, samples[5].commit);
+  EXPECT_EQ(20 * kMB, samples[9].working_set);
+
+  // A coarse slice is served from a coarse level, and takes the peak.
+  service_.GetSamples(instances[0].id, Ms(0), Ms(8000), 1, &samples);
+  ASSERT_EQ(1U, samples.size());
+  EXPECT_EQ(20 * kMB, samples[0].working_set);
+  EXPECT_DOUBLE_EQ(10 / 6.4, samples[0].page_faults_per_second);
+
+  // There's nothing before the first bucket, or of an unknown instance.
+  service_.GetSamples(instances[0].id, Ms(-1000), Ms(0), 10, &samples);
+  EXPECT_EQ(0, samples[9].working_set);
+  service_.GetSamples(10, Ms(0), Ms(1000), 10, &samples);
+  ASSERT_EQ(10U, samples.size());
+  EXPECT_EQ(0, samples[0].working_set);
+}
+
+TEST_F(ProcessMemoryServiceTest, TellsInstancesApart) {
+  service_.OnProcessStarted(Ms(0), MakeProcessInfo(kPid, "foo.exe"));
+  AddCounters(&service_, kPid, 100, 10 * kMB, 5 * kMB);
+  service_.OnProcessEnded(Ms(200), MakeProcessInfo(kPid, "foo.exe"), 0);
+  // The process id is reused.
+  service_.OnProcessStarted(Ms(300), MakeProcessInfo(kPid, "bar.exe"));
+  AddFaults(&service_, kPid, 400, 3);
+  // A process the log tells only the faults of, and then names.
+  AddFaults(&service_, kPid + 1, 400, 2);
+  service_.OnProcessIsRunning(Ms(500), MakeProcessInfo(kPid + 1, "baz.exe"));
+
+  std::vector<IProcessMemoryService::Instance> instances;
+  service_.GetInstances(&instances);
+  ASSERT_EQ(3U, instances.size());
+  EXPECT_EQ("foo.exe", instances[0].image_name);
+  EXPECT_EQ(Ms(200), instances[0].ended);
+  EXPECT_EQ(0, instances[0].page_faults);
+  EXPECT_EQ("bar.exe", instances[1].image_name);
+  EXPECT_TRUE(instances[1].ended.is_null());
+  EXPECT_EQ(3, instances[1].page_faults);
+  EXPECT_EQ("baz.exe", instances[2].image_name);
+  EXPECT_TRUE(instances[2].started.is_null());
+  EXPECT_EQ(2, instances[2].page_faults);
+
+  // The counters of an ended instance don't hold past its end.
+  std::vector<IProcessMemoryService::Sample> samples;
+  service_.GetSamples(instances[0].id, Ms(0), Ms(1000), 10, &samples);
+  EXPECT_EQ(10 * kMB, samples[1].working_set);
+  EXPECT_EQ(0, samples[2].working_set);
+}
+
+TEST_F(ProcessMemoryServiceTest, ReleasesFineLevelsPastBudget) {
+  ProcessMemoryService service(64);
+  for (int i = 0; i < 1000; ++i)
+    AddFaults(&service, kPid, i * 100, 1);
+  EXPECT_GE(64U, service.num_buckets());
+
+  // The start of the capture is served from the coarse levels.
+  std::vector<IProcessMemoryService::Sample> samples;
+  service.GetSamples(0, Ms(0), Ms(100 * 1000), 100, &samples);
+  ASSERT_EQ(100U, samples.size());
+  EXPECT_LT(0, samples[0].page_faults_per_second);
+  EXPECT_LT(0, samples[99].page_faults_per_second);
+}
+
+TEST_F(ProcessMemoryServiceTest, PassesEventsOn) {
+  StrictMock<MockProcessEvents> process_events;
+  service_.set_process_event_sink(&process_events);
+
+  EXPECT_CALL(process_events, OnProcessStarted(Ms(0), _)).Times(1);
+  service_.OnProcessStarted(Ms(0), MakeProcessInfo(kPid, "foo.exe"));
+  EXPECT_CALL(process_events, OnProcessIsRunning(Ms(0), _)).Times(1);
+  service_.OnProcessIsRunning(Ms(0), MakeProcessInfo(kPid + 1, "bar.exe"));
+  EXPECT_CALL(process_events, OnProcessEnded(Ms(100), _, 1U)).Times(1);
+  service_.OnProcessEnded(Ms(100), MakeProcessInfo(kPid, "foo.exe"), 1);
+}
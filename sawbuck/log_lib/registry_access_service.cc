@@ -0,0 +1,225 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Registry access service implementation.
+#include "sawbuck/log_lib/registry_access_service.h"
+
+#include <algorithm>
+#include "base/logging.h"
+#include "sawbuck/log_lib/kernel_log_types.h"
+
+namespace {
+
+// Orders accesses most frequent first.
+bool IsMoreFrequent(const IRegistryAccessService::KeyAccesses& a,
+                    const IRegistryAccessService::KeyAccesses& b) {
+  if (a.count_ != b.count_)
+    return a.count_ > b.count_;
+  return a.total_latency_ > b.total_latency_;
+}
+
+// Orders accesses slowest in all first.
+bool IsSlower(const IRegistryAccessService::KeyAccesses& a,
+              const IRegistryAccessService::KeyAccesses& b) {
+  if (a.total_latency_ != b.total_latency_)
+    return a.total_latency_ > b.total_latency_;
+  return a.count_ > b.count_;
+}
+
+}  // namespace
+
+const size_t RegistryAccessService::kDefaultMaxRecentAccesses;
+
+IRegistryAccessService::KeyAccesses::KeyAccesses()
+    : process_id_(0), operation_(0), count_(0) {
+}
+
+bool RegistryAccessService::AccessKey::operator<(const AccessKey& o) const {
+  if (process_id != o.process_id)
+    return process_id < o.process_id;
+  if (key_path != o.key_path)
+    return key_path < o.key_path;
+  return operation < o.operation;
+}
+
+RegistryAccessService::AccessStats::AccessStats() : count(0) {
+}
+
+RegistryAccessService::RegistryAccessService()
+    : max_recent_accesses_(kDefaultMaxRecentAccesses) {
+  no_key_path_ = &*key_paths_.insert(std::wstring()).first;
+}
+
+RegistryAccessService::RegistryAccessService(size_t max_recent_accesses)
+    : max_recent_accesses_(max_recent_accesses) {
+  DCHECK_LT(0U, max_recent_accesses);
+  no_key_path_ = &*key_paths_.insert(std::wstring()).first;
+}
+
+RegistryAccessService::~RegistryAccessService() {
+}
+
+void RegistryAccessService::GetTotals(SortOrder order,
+                                      size_t max_keys,
+                                      std::vector<KeyAccesses>* accesses) {
+  DCHECK(accesses != NULL);
+  base::AutoLock lock(lock_);
+  GetTopKeys(totals_, order, max_keys, accesses);
+}
+
+const wchar_t* RegistryAccessService::GetOperationName(int operation) {
+  using namespace kernel_log_types;
+
+  switch (operation) {
+    case kRegistryCreateEvent: return L"Create";
+    case kRegistryOpenEvent: return L"Open";
+    case kRegistryDeleteEvent: return L"Delete";
+    case kRegistryQueryEvent: return L"Query";
+    case kRegistrySetValueEvent: return L"SetValue";
+    case kRegistryDeleteValueEvent: return L"DeleteValue";
+    case kRegistryQueryValueEvent: return L"QueryValue";
+    case kRegistryEnumerateKeyEvent: return L"EnumerateKey";
+    case kRegistryEnumerateValueKeyEvent: return L"EnumerateValueKey";
+    case kRegistryQueryMultipleValueEvent: return L"QueryMultipleValue";
+    case kRegistrySetInformationEvent: return L"SetInformation";
+    case kRegistryFlushEvent: return L"Flush";
+    case kRegistryVirtualizeEvent: return L"Virtualize";
+    case kRegistryCloseEvent: return L"Close";
+    case kRegistrySetSecurityEvent: return L"SetSecurity";
+    case kRegistryQuerySecurityEvent: return L"QuerySecurity";
+    default: return L"Unknown";
+  }
+}
+
+size_t RegistryAccessService::num_key_paths() {
+  base::AutoLock lock(lock_);
+  return key_paths_.size() - 1;
+}
+
+void RegistryAccessService::GetHotKeys(const base::Time& from,
+                                       const base::Time& to,
+                                       SortOrder order,
+                                       size_t max_keys,
+                                       std::vector<KeyAccesses>* accesses) {
+  DCHECK(accesses != NULL);
+
+  AccessStatsMap stats;
+  {
+    base::AutoLock lock(lock_);
+    for (size_t i = 0; i < recent_accesses_.size(); ++i) {
+      const RecentAccess& access = recent_accesses_[i];
+      if (access.time < from || access.time > to)
+        continue;
+
+      AddAccess(access.latency, &stats[access.key]);
+    }
+  }
+
+  // The paths are never released, so are safe to use outside the lock.
+  GetTopKeys(stats, order, max_keys, accesses);
+}
+
+void RegistryAccessService::OnRegistryAccess(const base::Time& time,
+                                             DWORD process_id,
+                                             DWORD thread_id,
+                                             int operation,
+                                             ULONG status,
+                                             sym_util::Address key_handle,
+                                             const std::wstring& key_name,
+                                             const base::TimeDelta& latency) {
+  base::AutoLock lock(lock_);
+
+  AccessKey key = { process_id, InternKeyPath(key_handle, key_name),
+                    operation };
+  AddAccess(latency, &totals_[key]);
+
+  RecentAccess access = { time, key, latency };
+  recent_accesses_.push_back(access);
+  if (recent_accesses_.size() > max_recent_accesses_)
+    recent_accesses_.pop_front();
+}
+
+void RegistryAccessService::OnRegistryKeyName(const base::Time& time,
+                                              sym_util::Address key_handle,
+                                              const std::wstring& key_path) {
+  base::AutoLock lock(lock_);
+  key_handles_[key_handle] = &*key_paths_.insert(key_path).first;
+}
+
+void RegistryAccessService::OnRegistryKeyDeleted(
+    const base::Time& time, sym_util::Address key_handle) {
+  base::AutoLock lock(lock_);
+  key_handles_.erase(key_handle);
+}
+
+const std::wstring* RegistryAccessService::InternKeyPath(
+    sym_util::Address key_handle, const std::wstring& key_name) {
+  lock_.AssertAcquired();
+
+  // Names from the root of the registry stand alone, the others are
+  // relative to the key of the handle, which may be all there is.
+  const std::wstring* key_path = no_key_path_;
+  if (key_name.empty() || key_name[0] != L'\\') {
+    KeyHandleMap::const_iterator it(key_handles_.find(key_handle));
+    if (it != key_handles_.end())
+      key_path = it->second;
+  }
+  if (key_name.empty())
+    return key_path;
+
+  key_path_buffer_.assign(*key_path);
+  if (!key_path_buffer_.empty())
+    key_path_buffer_ += L'\\';
+  key_path_buffer_ += key_name;
+
+  std::set<std::wstring>::const_iterator it(
+      key_paths_.find(key_path_buffer_));
+  if (it == key_paths_.end())
+    it = key_paths_.insert(key_path_buffer_).first;
+  return &*it;
+}
+
+void RegistryAccessService::AddAccess(const base::TimeDelta& latency,
+                                      AccessStats* stats) {
+  DCHECK(stats != NULL);
+  ++stats->count;
+  stats->total_latency += latency;
+  if (latency > stats->max_latency)
+    stats->max_latency = latency;
+}
+
+void RegistryAccessService::GetTopKeys(const AccessStatsMap& stats,
+                                       SortOrder order,
+                                       size_t max_keys,
+                                       std::vector<KeyAccesses>* accesses) {
+  DCHECK(accesses != NULL);
+  accesses->clear();
+
+  AccessStatsMap::const_iterator it(stats.begin());
+  for (; it != stats.end(); ++it) {
+    KeyAccesses access;
+    access.process_id_ = it->first.process_id;
+    access.key_path_ = *it->first.key_path;
+    access.operation_ = it->first.operation;
+    access.count_ = it->second.count;
+    access.total_latency_ = it->second.total_latency;
+    access.max_latency_ = it->second.max_latency;
+    accesses->push_back(access);
+  }
+
+  std::sort(accesses->begin(), accesses->end(),
+            order == BY_COUNT ? IsMoreFrequent : IsSlower);
+  if (accesses->size() > max_keys)
+    accesses->resize(max_keys);
+}
@@ -0,0 +1,176 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Registry access service declaration.
+#ifndef SAWBUCK_LOG_LIB_REGISTRY_ACCESS_SERVICE_H_
+#define SAWBUCK_LOG_LIB_REGISTRY_ACCESS_SERVICE_H_
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "base/synchronization/lock.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+
+class IRegistryAccessService {
+ public:
+  // The accesses of a process to a key by an operation, over a stretch of
+  // time.
+  struct KeyAccesses {
+    KeyAccesses();
+
+    DWORD process_id_;
+    // The path of the key, empty if the log didn't name it.
+    std::wstring key_path_;
+    // The registry event type of the operation, see GetOperationName.
+    int operation_;
+    uint64 count_;
+    // The time spent in the operations, in all and the worst of it.
+    base::TimeDelta total_latency_;
+    base::TimeDelta max_latency_;
+  };
+
+  // The orders the accesses can be reported in.
+  enum SortOrder {
+    BY_COUNT,
+    BY_TOTAL_LATENCY,
+  };
+
+  // Retrieve the accesses completing from @p from to @p to, tallied by
+  // process, key path and operation, to @p accesses in @p order, most
+  // first.
+  // @param max_keys the most tallies to retrieve.
+  virtual void GetHotKeys(const base::Time& from,
+                          const base::Time& to,
+                          SortOrder order,
+                          size_t max_keys,
+                          std::vector<KeyAccesses>* accesses) = 0;
+};
+
+// The registry access service sinks the registry events of a kernel log
+// parser. It ties the key handles of the operations to the key paths the
+// log names them by, interns the paths, and tallies the count and latency
+// of the accesses by process, key path and operation for the whole of the
+// log as they stream by. The most recent accesses are kept for reports
+// over a stretch of time, but they're capped, so memory only grows with
+// the number of distinct tallies.
+class RegistryAccessService
+    : public IRegistryAccessService,
+      public KernelRegistryEvents {
+ public:
+  // The default number of recent accesses kept for GetHotKeys.
+  static const size_t kDefaultMaxRecentAccesses = 256 * 1024;
+
+  RegistryAccessService();
+  explicit RegistryAccessService(size_t max_recent_accesses);
+  ~RegistryAccessService();
+
+  // Retrieve the tallies over the whole of the log, as for GetHotKeys.
+  void GetTotals(SortOrder order,
+                 size_t max_keys,
+                 std::vector<KeyAccesses>* accesses);
+
+  // @returns the name of the registry @p operation, e.g. L"QueryValue".
+  static const wchar_t* GetOperationName(int operation);
+
+  // The number of distinct key paths interned, for testing.
+  size_t num_key_paths();
+
+  // IRegistryAccessService implementation.
+  virtual void GetHotKeys(const base::Time& from,
+                          const base::Time& to,
+                          SortOrder order,
+                          size_t max_keys,
+                          std::vector<KeyAccesses>* accesses);
+
+  // KernelRegistryEvents implementation.
+  virtual void OnRegistryAccess(const base::Time& time,
+                                DWORD process_id,
+                                DWORD thread_id,
+                                int operation,
+                                ULONG status,
+                                sym_util::Address key_handle,
+                                const std::wstring& key_name,
+                                const base::TimeDelta& latency);
+  virtual void OnRegistryKeyName(const base::Time& time,
+                                 sym_util::Address key_handle,
+                                 const std::wstring& key_path);
+  virtual void OnRegistryKeyDeleted(const base::Time& time,
+                                    sym_util::Address key_handle);
+
+ private:
+  // What the accesses are tallied by.
+  struct AccessKey {
+    bool operator<(const AccessKey& o) const;
+
+    DWORD process_id;
+    const std::wstring* key_path;
+    int operation;
+  };
+  struct AccessStats {
+    AccessStats();
+
+    uint64 count;
+    base::TimeDelta total_latency;
+    base::TimeDelta max_latency;
+  };
+  typedef std::map<AccessKey, AccessStats> AccessStatsMap;
+
+  // An access, as kept for reports over a stretch of time.
+  struct RecentAccess {
+    base::Time time;
+    AccessKey key;
+    base::TimeDelta latency;
+  };
+
+  // @returns the interned path of @p key_name relative to the key of
+  //     @p key_handle. Under lock_.
+  const std::wstring* InternKeyPath(sym_util::Address key_handle,
+                                    const std::wstring& key_name);
+
+  // Adds an access taking @p latency to @p stats.
+  static void AddAccess(const base::TimeDelta& latency, AccessStats* stats);
+
+  // Retrieve the @p max_keys most of @p stats in @p order to @p accesses.
+  static void GetTopKeys(const AccessStatsMap& stats,
+                         SortOrder order,
+                         size_t max_keys,
+                         std::vector<KeyAccesses>* accesses);
+
+  const size_t max_recent_accesses_;
+
+  base::Lock lock_;
+
+  // The key paths we've seen, interned, starting with the empty path of
+  // unnamed keys. Under lock_.
+  std::set<std::wstring> key_paths_;
+  const std::wstring* no_key_path_;
+  // Where the paths are built, to spare an allocation per access.
+  std::wstring key_path_buffer_;
+
+  // The paths of the live key handles. Under lock_.
+  typedef std::map<sym_util::Address, const std::wstring*> KeyHandleMap;
+  KeyHandleMap key_handles_;
+
+  // The tallies over the whole of the log. Under lock_.
+  AccessStatsMap totals_;
+
+  // The recent accesses in order of completion. Under lock_.
+  std::deque<RecentAccess> recent_accesses_;
+
+  DISALLOW_COPY_AND_ASSIGN(RegistryAccessService);
+};
+
+#endif  // SAWBUCK_LOG_LIB_REGISTRY_ACCESS_SERVICE_H_
@@ -0,0 +1,157 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Registry access service unittests.
+#include "sawbuck/log_lib/registry_access_service.h"
+
+#include "gtest/gtest.h"
+#include "sawbuck/log_lib/kernel_log_types.h"
+
+namespace {
+
+using kernel_log_types::kRegistryOpenEvent;
+using kernel_log_types::kRegistryQueryValueEvent;
+
+const DWORD kPid = 1234;
+const DWORD kOtherPid = 1235;
+const DWORD kTid = 4321;
+
+const sym_util::Address kSoftwareKey = 0xFFFFF8A000101000ULL;
+const sym_util::Address kChromeKey = 0xFFFFF8A000102000ULL;
+
+const wchar_t kSoftwarePath[] = L"\\REGISTRY\\MACHINE\\SOFTWARE";
+const wchar_t kChromePath[] =
+    L"\\REGISTRY\\MACHINE\\SOFTWARE\\Google\\Chrome";
+
+class RegistryAccessServiceTest: public testing::Test {
+ public:
+  RegistryAccessServiceTest() : kT0(base::Time::Now()) {
+  }
+
+  // @returns kT0 plus @p ms milliseconds.
+  base::Time At(int ms) {
+    return kT0 + base::TimeDelta::FromMilliseconds(ms);
+  }
+
+  // Issues an access by @p process_id at @p time, taking @p latency_us.
+  void Access(const base::Time& time, DWORD process_id, int operation,
+              sym_util::Address key_handle, const wchar_t* key_name,
+              int latency_us) {
+    service_.OnRegistryAccess(
+        time, process_id, kTid, operation, 0, key_handle, key_name,
+        base::TimeDelta::FromMicroseconds(latency_us));
+  }
+
+ protected:
+  const base::Time kT0;
+  RegistryAccessService service_;
+};
+
+}  // namespace
+
+TEST_F(RegistryAccessServiceTest, ResolvesKeyPaths) {
+  service_.OnRegistryKeyName(At(0), kSoftwareKey, kSoftwarePath);
+  service_.OnRegistryKeyName(At(0), kChromeKey, kChromePath);
+
+  // An open relative to a key, a query of the key itself, and an open by
+  // full path all come to the same key.
+  Access(At(1), kPid, kRegistryOpenEvent, kSoftwareKey, L"Google\\Chrome",
+         10);
+  Access(At(2), kPid, kRegistryQueryValueEvent, kChromeKey, L"", 5);
+  Access(At(3), kPid, kRegistryOpenEvent, 0, kChromePath, 20);
+  // And a key we've no name for is unknown.
+  Access(At(4), kPid, kRegistryOpenEvent, 0x1000, L"", 1);
+
+  std::vector<IRegistryAccessService::KeyAccesses> accesses;
+  service_.GetTotals(RegistryAccessService::BY_COUNT, 10, &accesses);
+  ASSERT_EQ(3U, accesses.size());
+  EXPECT_EQ(kChromePath, accesses[0].key_path_);
+  EXPECT_EQ(kRegistryOpenEvent, accesses[0].operation_);
+  EXPECT_EQ(2U, accesses[0].count_);
+  EXPECT_EQ(30, accesses[0].total_latency_.InMicroseconds());
+  EXPECT_EQ(20, accesses[0].max_latency_.InMicroseconds());
+  EXPECT_EQ(kChromePath, accesses[1].key_path_);
+  EXPECT_EQ(kRegistryQueryValueEvent, accesses[1].operation_);
+  EXPECT_EQ(L"", accesses[2].key_path_);
+
+  // The key paths are interned.
+  EXPECT_EQ(2U, service_.num_key_paths());
+
+  // A deleted handle is no longer resolved.
+  service_.OnRegistryKeyDeleted(At(5), kChromeKey);
+  Access(At(6), kPid, kRegistryQueryValueEvent, kChromeKey, L"", 5);
+  service_.GetTotals(RegistryAccessService::BY_COUNT, 10, &accesses);
+  ASSERT_EQ(4U, accesses.size());
+  size_t unknown_queries = 0;
+  for (size_t i = 0; i < accesses.size(); ++i) {
+    if (accesses[i].key_path_.empty() &&
+        accesses[i].operation_ == kRegistryQueryValueEvent) {
+      unknown_queries += accesses[i].count_;
+    }
+  }
+  EXPECT_EQ(1U, unknown_queries);
+}
+
+TEST_F(RegistryAccessServiceTest, SortsAndScopesHotKeys) {
+  service_.OnRegistryKeyName(At(0), kSoftwareKey, kSoftwarePath);
+  service_.OnRegistryKeyName(At(0), kChromeKey, kChromePath);
+
+  // Many fast queries of one key, and a few slow opens of another, in two
+  // processes.
+  for (int i = 0; i < 10; ++i)
+    Access(At(i), kPid, kRegistryQueryValueEvent, kChromeKey, L"", 1);
+  for (int i = 0; i < 3; ++i)
+    Access(At(i), kOtherPid, kRegistryOpenEvent, kSoftwareKey, L"", 100);
+  Access(At(20), kPid, kRegistryOpenEvent, kSoftwareKey, L"", 1000);
+
+  std::vector<IRegistryAccessService::KeyAccesses> accesses;
+  service_.GetHotKeys(At(0), At(9), RegistryAccessService::BY_COUNT, 10,
+                      &accesses);
+  ASSERT_EQ(2U, accesses.size());
+  EXPECT_EQ(kPid, accesses[0].process_id_);
+  EXPECT_EQ(10U, accesses[0].count_);
+  EXPECT_EQ(kOtherPid, accesses[1].process_id_);
+  EXPECT_EQ(3U, accesses[1].count_);
+
+  service_.GetHotKeys(At(0), At(9), RegistryAccessService::BY_TOTAL_LATENCY,
+                      1, &accesses);
+  ASSERT_EQ(1U, accesses.size());
+  EXPECT_EQ(kOtherPid, accesses[0].process_id_);
+  EXPECT_EQ(kSoftwarePath, accesses[0].key_path_);
+  EXPECT_EQ(300, accesses[0].total_latency_.InMicroseconds());
+
+  // The range bounds the report.
+  service_.GetHotKeys(At(10), At(30), RegistryAccessService::BY_COUNT, 10,
+                      &accesses);
+  ASSERT_EQ(1U, accesses.size());
+  EXPECT_EQ(1000, accesses[0].max_latency_.InMicroseconds());
+}
+
+TEST_F(RegistryAccessServiceTest, CapsRecentAccesses) {
+  RegistryAccessService service(2);
+  for (int i = 0; i < 3; ++i) {
+    service.OnRegistryAccess(At(i), kPid, kTid, kRegistryOpenEvent, 0,
+                             0, kChromePath, base::TimeDelta());
+  }
+
+  // The oldest access has gone from the recent ones, not the totals.
+  std::vector<IRegistryAccessService::KeyAccesses> accesses;
+  service.GetHotKeys(At(0), At(2), RegistryAccessService::BY_COUNT, 10,
+                     &accesses);
+  ASSERT_EQ(1U, accesses.size());
+  EXPECT_EQ(2U, accesses[0].count_);
+  service.GetTotals(RegistryAccessService::BY_COUNT, 10, &accesses);
+  ASSERT_EQ(1U, accesses.size());
+  EXPECT_EQ(3U, accesses[0].count_);
+}
@@ -0,0 +1,72 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Sawbuck's own trace event provider implementation.
+#include "sawbuck/log_lib/sawbuck_trace_provider.h"
+
+#include "base/debug/trace_event_win.h"
+
+const GUID kSawbuckTraceProvider = { 0x2e3c8baf, 0x4c1d, 0x4f52,
+    { 0x8e, 0x0b, 0x6a, 0x4d, 0x17, 0xf0, 0x5c, 0x39 } };
+
+namespace {
+
+SawbuckTraceProvider sawbuck_trace_provider;
+
+}  // namespace
+
+SawbuckTraceProvider::SawbuckTraceProvider()
+    : base::win::EtwTraceProvider(kSawbuckTraceProvider) {
+}
+
+SawbuckTraceProvider* SawbuckTraceProvider::Get() {
+  return &sawbuck_trace_provider;
+}
+
+void SawbuckTraceProvider::TraceEvent(const char* name,
+                                      const void* id,
+                                      base::win::EtwEventType type,
+                                      const char* extra) {
+  if (!IsTracing())
+    return;
+
+  if (extra == NULL)
+    extra = "";
+
+  // The event class tells the consumer the size of the id.
+  const GUID& event_class = sizeof(id) == sizeof(uint64) ?
+      base::debug::kTraceEventClass64 : base::debug::kTraceEventClass32;
+  base::win::EtwMofEvent<3> event(event_class, type, TRACE_LEVEL_INFORMATION);
+  event.SetField(0, strlen(name) + 1, name);
+  event.SetField(1, sizeof(id), &id);
+  event.SetField(2, strlen(extra) + 1, extra);
+  Log(event.get());
+}
+
+ScopedSawbuckTraceEvent::ScopedSawbuckTraceEvent(const char* name,
+                                                 const void* id)
+    : name_(name), id_(id), traced_(false) {
+  SawbuckTraceProvider* provider = SawbuckTraceProvider::Get();
+  if (provider->IsTracing()) {
+    provider->TraceEvent(name_, id_, base::debug::kTraceEventTypeBegin, NULL);
+    traced_ = true;
+  }
+}
+
+ScopedSawbuckTraceEvent::~ScopedSawbuckTraceEvent() {
+  if (traced_) {
+    SawbuckTraceProvider::Get()->TraceEvent(
+        name_, id_, base::debug::kTraceEventTypeEnd, NULL);
+  }
+}
@@ -0,0 +1,78 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Sawbuck's own trace event provider declaration.
+#ifndef SAWBUCK_LOG_LIB_SAWBUCK_TRACE_PROVIDER_H_
+#define SAWBUCK_LOG_LIB_SAWBUCK_TRACE_PROVIDER_H_
+
+#include <windows.h>
+#include <evntrace.h>
+#include "base/basictypes.h"
+#include "base/win/event_trace_provider.h"
+
+// The provider sawbuck traces its own hot paths on, so that a second
+// sawbuck instance or xperf can record it.
+// {2E3C8BAF-4C1D-4F52-8E0B-6A4D17F05C39}
+extern const GUID kSawbuckTraceProvider;
+
+// Logs trace events in the format of Chrome's base trace events, which
+// sawbuck displays, but on a provider of our own. Base's provider is a
+// singleton on Chrome's GUID, so sawbuck's events would be mixed up with
+// those of any Chrome that's tracing.
+class SawbuckTraceProvider : public base::win::EtwTraceProvider {
+ public:
+  SawbuckTraceProvider();
+
+  // @returns the process-wide provider, which the viewer registers.
+  static SawbuckTraceProvider* Get();
+
+  // @returns true iff a session has enabled us at a level that wants
+  //    trace events.
+  bool IsTracing() const {
+    return enable_level() >= TRACE_LEVEL_INFORMATION;
+  }
+
+  // Logs a trace event, if we're tracing.
+  // @param name the name of the event, which pairs begins with ends.
+  // @param id an identifier to tell concurrent events of a name apart.
+  // @param type one of the base::debug::kTraceEventType constants.
+  // @param extra a string to log with the event, may be NULL.
+  void TraceEvent(const char* name,
+                  const void* id,
+                  base::win::EtwEventType type,
+                  const char* extra);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SawbuckTraceProvider);
+};
+
+// Traces the begin on construction and the end on destruction of the
+// scope it lives in.
+class ScopedSawbuckTraceEvent {
+ public:
+  // @param name the name of the event, must outlive this instance.
+  // @param id an identifier to tell concurrent events of a name apart.
+  ScopedSawbuckTraceEvent(const char* name, const void* id);
+  ~ScopedSawbuckTraceEvent();
+
+ private:
+  const char* name_;
+  const void* id_;
+  // True iff we traced the begin, an end without one is of no use.
+  bool traced_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedSawbuckTraceEvent);
+};
+
+#endif  // SAWBUCK_LOG_LIB_SAWBUCK_TRACE_PROVIDER_H_
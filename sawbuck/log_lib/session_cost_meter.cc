@@ -0,0 +1,56 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Session cost meter implementation.
+#include "sawbuck/log_lib/session_cost_meter.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+SessionCostMeter::SessionCostMeter() : has_cost_(false) {
+}
+
+void SessionCostMeter::Sample(base::TimeTicks now, const Totals& totals) {
+  if (last_sample_.is_null()) {
+    last_sample_ = now;
+    last_totals_ = totals;
+    return;
+  }
+
+  double seconds = (now - last_sample_).InSecondsF();
+  if (seconds <= 0)
+    return;
+
+  // The totals only grow, unless the session was swapped for another
+  // without a reset, in which case the interval counts from zero.
+  if (totals.events < last_totals_.events || totals.bytes < last_totals_.bytes)
+    last_totals_ = Totals();
+
+  cost_.events_per_second = (totals.events - last_totals_.events) / seconds;
+  cost_.bytes_per_second = (totals.bytes - last_totals_.bytes) / seconds;
+  base::TimeDelta cpu_time =
+      totals.consumer_cpu_time - last_totals_.consumer_cpu_time;
+  cost_.consumer_cpu = std::max(0.0, cpu_time.InSecondsF() / seconds);
+  has_cost_ = true;
+
+  last_sample_ = now;
+  last_totals_ = totals;
+}
+
+void SessionCostMeter::Reset() {
+  last_sample_ = base::TimeTicks();
+  last_totals_ = Totals();
+  has_cost_ = false;
+  cost_ = Cost();
+}
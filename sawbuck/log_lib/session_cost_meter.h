@@ -0,0 +1,73 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Session cost meter declaration.
+#ifndef SAWBUCK_LOG_LIB_SESSION_COST_METER_H_
+#define SAWBUCK_LOG_LIB_SESSION_COST_METER_H_
+
+#include "base/basictypes.h"
+#include "base/time/time.h"
+
+// Measures what a session costs as it runs: the events and bytes it
+// delivers a second, and the share of a processor its consumer takes.
+// The meter is fed the session's running totals at intervals, and turns
+// the change over each interval into rates.
+class SessionCostMeter {
+ public:
+  // The totals of a session since it started.
+  struct Totals {
+    Totals() : events(0), bytes(0) {
+    }
+
+    uint64 events;
+    uint64 bytes;
+    // The CPU time of the thread consuming the session.
+    base::TimeDelta consumer_cpu_time;
+  };
+
+  // The rates over the last interval.
+  struct Cost {
+    Cost() : events_per_second(0), bytes_per_second(0), consumer_cpu(0) {
+    }
+
+    double events_per_second;
+    double bytes_per_second;
+    // The consumer's CPU time over the interval's length, where 1 is all
+    // of one processor.
+    double consumer_cpu;
+  };
+
+  SessionCostMeter();
+
+  // Closes the interval that ends at @p now, with @p totals as of then.
+  // The first call only starts the first interval.
+  void Sample(base::TimeTicks now, const Totals& totals);
+
+  // Forgets the totals, as for a new session.
+  void Reset();
+
+  // @returns true once an interval has closed.
+  bool has_cost() const { return has_cost_; }
+  const Cost& cost() const { return cost_; }
+
+ private:
+  base::TimeTicks last_sample_;
+  Totals last_totals_;
+  bool has_cost_;
+  Cost cost_;
+
+  DISALLOW_COPY_AND_ASSIGN(SessionCostMeter);
+};
+
+#endif  // SAWBUCK_LOG_LIB_SESSION_COST_METER_H_
@@ -0,0 +1,76 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Session cost meter unit tests.
+#include "sawbuck/log_lib/session_cost_meter.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+SessionCostMeter::Totals MakeTotals(uint64 events, uint64 bytes,
+                                    int cpu_ms) {
+  SessionCostMeter::Totals totals;
+  totals.events = events;
+  totals.bytes = bytes;
+  totals.consumer_cpu_time = base::TimeDelta::FromMilliseconds(cpu_ms);
+  return totals;
+}
+
+}  // namespace
+
+TEST(SessionCostMeterTest, RatesOverIntervals) {
+  SessionCostMeter meter;
+  base::TimeTicks now = base::TimeTicks::Now();
+
+  // The first sample only starts the interval.
+  meter.Sample(now, MakeTotals(100, 1000, 10));
+  EXPECT_FALSE(meter.has_cost());
+
+  now += base::TimeDelta::FromSeconds(2);
+  meter.Sample(now, MakeTotals(2100, 41000, 110));
+  ASSERT_TRUE(meter.has_cost());
+  EXPECT_DOUBLE_EQ(1000, meter.cost().events_per_second);
+  EXPECT_DOUBLE_EQ(20000, meter.cost().bytes_per_second);
+  EXPECT_DOUBLE_EQ(0.05, meter.cost().consumer_cpu);
+
+  // A sample at the same time changes nothing.
+  meter.Sample(now, MakeTotals(5000, 50000, 500));
+  EXPECT_DOUBLE_EQ(1000, meter.cost().events_per_second);
+
+  now += base::TimeDelta::FromSeconds(1);
+  meter.Sample(now, MakeTotals(2100, 41000, 110));
+  EXPECT_DOUBLE_EQ(0, meter.cost().events_per_second);
+  EXPECT_DOUBLE_EQ(0, meter.cost().consumer_cpu);
+}
+
+TEST(SessionCostMeterTest, Reset) {
+  SessionCostMeter meter;
+  base::TimeTicks now = base::TimeTicks::Now();
+  meter.Sample(now, MakeTotals(100, 1000, 10));
+  meter.Sample(now + base::TimeDelta::FromSeconds(1),
+               MakeTotals(200, 2000, 20));
+  EXPECT_TRUE(meter.has_cost());
+
+  meter.Reset();
+  EXPECT_FALSE(meter.has_cost());
+  EXPECT_EQ(0, meter.cost().events_per_second);
+
+  // The next session's totals start over.
+  now += base::TimeDelta::FromSeconds(5);
+  meter.Sample(now, MakeTotals(10, 100, 0));
+  meter.Sample(now + base::TimeDelta::FromSeconds(1),
+               MakeTotals(60, 600, 0));
+  EXPECT_DOUBLE_EQ(50, meter.cost().events_per_second);
+}
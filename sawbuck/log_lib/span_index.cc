@@ -0,0 +1,282 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Span index implementation.
+#include "sawbuck/log_lib/span_index.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+// Orders a time before the spans that end after it.
+bool EndsAfter(const base::Time& time, const ISpanIndex::Span& span) {
+  return time < span.end;
+}
+
+}  // namespace
+
+const size_t SpanIndex::kDefaultMaxSpansPerTrack;
+const int64 SpanIndex::kFinestBucketUs;
+const int64 SpanIndex::kLevelFactor;
+const size_t SpanIndex::kLevelCount;
+const int64 SpanIndex::kMaxBucketsPerLevel;
+
+bool ISpanIndex::Track::operator<(const Track& o) const {
+  if (process_id != o.process_id)
+    return process_id < o.process_id;
+  return thread_id < o.thread_id;
+}
+
+bool ISpanIndex::Track::operator==(const Track& o) const {
+  return process_id == o.process_id && thread_id == o.thread_id;
+}
+
+SpanIndex::SpanIndex() : max_spans_per_track_(kDefaultMaxSpansPerTrack) {
+}
+
+SpanIndex::SpanIndex(size_t max_spans_per_track)
+    : max_spans_per_track_(max_spans_per_track) {
+  DCHECK_LT(0U, max_spans_per_track);
+}
+
+SpanIndex::~SpanIndex() {
+}
+
+int64 SpanIndex::BucketWidth(size_t level) {
+  DCHECK_LT(level, kLevelCount);
+  int64 width = kFinestBucketUs;
+  for (size_t i = 0; i < level; ++i)
+    width *= kLevelFactor;
+  return width;
+}
+
+void SpanIndex::AddToLevel(const Span& span, int64 width, Level* level) {
+  DCHECK(level != NULL);
+  int64 begin = span.begin.ToInternalValue();
+  int64 end = span.end.ToInternalValue();
+  int64 first = begin / width;
+  int64 last = (end > begin ? end - 1 : end) / width;
+
+  if (level->buckets.empty())
+    level->first = first;
+
+  int64 new_first = std::min(first, level->first);
+  int64 new_last = std::max(last,
+      level->first + static_cast<int64>(level->buckets.size()) - 1);
+  if (new_last - new_first >= kMaxBucketsPerLevel)
+    return;
+
+  Bucket empty = {};
+  if (new_first < level->first) {
+    level->buckets.insert(level->buckets.begin(),
+                          static_cast<size_t>(level->first - new_first),
+                          empty);
+    level->first = new_first;
+  }
+  level->buckets.resize(static_cast<size_t>(new_last - new_first + 1),
+                        empty);
+
+  for (int64 i = first; i <= last; ++i) {
+    Bucket& bucket = level->buckets[static_cast<size_t>(i - level->first)];
+    ++bucket.span_count;
+    bucket.max_depth = std::max(bucket.max_depth, span.depth + 1);
+    if (span.depth == 0) {
+      int64 overlap = std::min(end, (i + 1) * width) -
+          std::max(begin, i * width);
+      bucket.busy += base::TimeDelta::FromMicroseconds(overlap);
+    }
+  }
+}
+
+void SpanIndex::CollectSpans(const TrackData& data,
+                             const base::Time& from,
+                             const base::Time& to,
+                             std::vector<Span>* spans) {
+  DCHECK(spans != NULL);
+  // The spans that overlap the range end after its start, and, as they
+  // begin before its end, end before the end plus the longest span.
+  std::deque<Span>::const_iterator it(
+      std::upper_bound(data.spans.begin(), data.spans.end(), from,
+                       EndsAfter));
+  base::Time end_bound(to + data.longest);
+  for (; it != data.spans.end() && it->end <= end_bound; ++it) {
+    if (it->begin < to)
+      spans->push_back(*it);
+  }
+}
+
+void SpanIndex::BucketSpans(const std::vector<Span>& spans,
+                            const base::Time& from,
+                            int64 slice_us,
+                            std::vector<Bucket>* buckets) {
+  DCHECK_LT(0, slice_us);
+  DCHECK(buckets != NULL);
+  int64 slice_count = static_cast<int64>(buckets->size());
+  int64 origin = from.ToInternalValue();
+  for (size_t i = 0; i < spans.size(); ++i) {
+    const Span& span = spans[i];
+    int64 begin = span.begin.ToInternalValue() - origin;
+    int64 end = span.end.ToInternalValue() - origin;
+    int64 first = std::max<int64>(0, begin / slice_us);
+    int64 last = std::min(slice_count - 1,
+                          (end > begin ? end - 1 : end) / slice_us);
+    for (int64 j = first; j <= last; ++j) {
+      Bucket& bucket = (*buckets)[static_cast<size_t>(j)];
+      ++bucket.span_count;
+      bucket.max_depth = std::max(bucket.max_depth, span.depth + 1);
+      if (span.depth == 0) {
+        int64 overlap = std::min(end, (j + 1) * slice_us) -
+            std::max(begin, j * slice_us);
+        bucket.busy += base::TimeDelta::FromMicroseconds(overlap);
+      }
+    }
+  }
+}
+
+void SpanIndex::GetTracks(std::vector<Track>* tracks) {
+  DCHECK(tracks != NULL);
+  tracks->clear();
+
+  base::AutoLock lock(lock_);
+  TrackMap::const_iterator it(tracks_.begin());
+  for (; it != tracks_.end(); ++it)
+    tracks->push_back(it->first);
+}
+
+bool SpanIndex::GetTimeRange(base::Time* first, base::Time* last) {
+  DCHECK(first != NULL);
+  DCHECK(last != NULL);
+
+  base::AutoLock lock(lock_);
+  if (tracks_.empty())
+    return false;
+
+  *first = first_;
+  *last = last_;
+  return true;
+}
+
+void SpanIndex::GetSpans(const Track& track,
+                         const base::Time& from,
+                         const base::Time& to,
+                         std::vector<Span>* spans) {
+  DCHECK(spans != NULL);
+  spans->clear();
+
+  base::AutoLock lock(lock_);
+  TrackMap::const_iterator it(tracks_.find(track));
+  if (it != tracks_.end())
+    CollectSpans(it->second, from, to, spans);
+}
+
+void SpanIndex::GetBuckets(const Track& track,
+                           const base::Time& from,
+                           const base::Time& to,
+                           size_t bucket_count,
+                           std::vector<Bucket>* buckets) {
+  DCHECK(buckets != NULL);
+  Bucket empty = {};
+  buckets->assign(bucket_count, empty);
+
+  int64 slice_us = 0;
+  if (bucket_count != 0)
+    slice_us = (to - from).InMicroseconds() / bucket_count;
+  if (slice_us <= 0)
+    return;
+
+  base::AutoLock lock(lock_);
+  TrackMap::const_iterator it(tracks_.find(track));
+  if (it == tracks_.end())
+    return;
+  const TrackData& data = it->second;
+
+  // Slices finer than the finest level are summarized from the spans.
+  if (slice_us < kFinestBucketUs) {
+    std::vector<Span> spans;
+    CollectSpans(data, from, to, &spans);
+    BucketSpans(spans, from, slice_us, buckets);
+    return;
+  }
+
+  // Otherwise use the coarsest level no coarser than a slice, and merge
+  // each of its buckets into the slices it overlaps, sharing its busy time
+  // out by the overlap so that slices that aren't a multiple of the level
+  // width don't alias.
+  size_t level_index = 0;
+  while (level_index + 1 < kLevelCount &&
+         BucketWidth(level_index + 1) <= slice_us) {
+    ++level_index;
+  }
+  const Level& level = data.levels[level_index];
+  if (level.buckets.empty())
+    return;
+
+  int64 width = BucketWidth(level_index);
+  int64 origin = from.ToInternalValue();
+  int64 range_end = slice_us * static_cast<int64>(bucket_count);
+  int64 first = std::max(level.first, origin / width);
+  int64 last = std::min(
+      level.first + static_cast<int64>(level.buckets.size()) - 1,
+      (origin + range_end - 1) / width);
+  for (int64 i = first; i <= last; ++i) {
+    const Bucket& source =
+        level.buckets[static_cast<size_t>(i - level.first)];
+    if (source.span_count == 0)
+      continue;
+
+    int64 begin = std::max<int64>(0, i * width - origin);
+    int64 end = std::min(range_end, (i + 1) * width - origin);
+    bool counted = false;
+    for (int64 slice = begin / slice_us; slice * slice_us < end; ++slice) {
+      int64 overlap = std::min(end, (slice + 1) * slice_us) -
+          std::max(begin, slice * slice_us);
+      Bucket& bucket = (*buckets)[static_cast<size_t>(slice)];
+      bucket.busy += base::TimeDelta::FromMicroseconds(
+          source.busy.InMicroseconds() * overlap / width);
+      bucket.max_depth = std::max(bucket.max_depth, source.max_depth);
+      if (!counted) {
+        bucket.span_count += source.span_count;
+        counted = true;
+      }
+    }
+  }
+}
+
+void SpanIndex::OnTraceSpan(const TraceSpan& trace_span) {
+  Track track = { trace_span.process_id, trace_span.begin_thread_id };
+  Span span = { trace_span.begin, trace_span.end, trace_span.name,
+                trace_span.depth };
+
+  base::AutoLock lock(lock_);
+  if (tracks_.empty() || span.begin < first_)
+    first_ = span.begin;
+  if (tracks_.empty() || span.end > last_)
+    last_ = span.end;
+
+  TrackData& data = tracks_[track];
+  for (size_t i = 0; i < kLevelCount; ++i)
+    AddToLevel(span, BucketWidth(i), &data.levels[i]);
+
+  data.longest = std::max(data.longest, span.end - span.begin);
+
+  // The spans arrive in about the order of their end, but keep the order
+  // exact for the searches.
+  std::deque<Span>::iterator pos(data.spans.end());
+  while (pos != data.spans.begin() && span.end < (pos - 1)->end)
+    --pos;
+  data.spans.insert(pos, span);
+  if (data.spans.size() > max_spans_per_track_)
+    data.spans.pop_front();
+}
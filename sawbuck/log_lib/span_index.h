@@ -0,0 +1,176 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Span index declaration.
+#ifndef SAWBUCK_LOG_LIB_SPAN_INDEX_H_
+#define SAWBUCK_LOG_LIB_SPAN_INDEX_H_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "base/synchronization/lock.h"
+#include "sawbuck/log_lib/trace_span_matcher.h"
+
+// The span index answers the span queries of a timeline view.
+class ISpanIndex {
+ public:
+  // A track holds the spans begun on a thread.
+  struct Track {
+    bool operator<(const Track& o) const;
+    bool operator==(const Track& o) const;
+
+    DWORD process_id;
+    DWORD thread_id;
+  };
+
+  struct Span {
+    base::Time begin;
+    base::Time end;
+    const std::string* name;
+    size_t depth;
+  };
+
+  // The spans of a track within a slice of time.
+  struct Bucket {
+    // The time of the slice spent within top level spans.
+    base::TimeDelta busy;
+    // One more than the deepest span within the slice, or zero for none.
+    size_t max_depth;
+    // The number of spans within the slice. Spans that cross into
+    // neighbouring slices at a coarser level may be counted, once per level
+    // bucket, in each of them.
+    uint32 span_count;
+  };
+
+  // Retrieves the tracks with spans to @p tracks, in order.
+  virtual void GetTracks(std::vector<Track>* tracks) = 0;
+
+  // Retrieves the times of the earliest begin and latest end of the spans
+  // to @p first and @p last.
+  // @returns false if we have no spans.
+  virtual bool GetTimeRange(base::Time* first, base::Time* last) = 0;
+
+  // Retrieves the spans of @p track that overlap [@p from, @p to) to
+  // @p spans, in order of their end time.
+  virtual void GetSpans(const Track& track,
+                        const base::Time& from,
+                        const base::Time& to,
+                        std::vector<Span>* spans) = 0;
+
+  // Divides [@p from, @p to) into @p bucket_count equal slices, and
+  // retrieves a summary of the spans of @p track within each of them to
+  // @p buckets. This costs in the order of the number of buckets, not of
+  // the number of spans, for slices wider than the finest level of detail.
+  virtual void GetBuckets(const Track& track,
+                          const base::Time& from,
+                          const base::Time& to,
+                          size_t bucket_count,
+                          std::vector<Bucket>* buckets) = 0;
+};
+
+// The span index sinks the spans of a trace span matcher, and keeps them
+// per thread, both as they are, for zoomed in views, and pre-aggregated to
+// a number of levels of detail, each kLevelFactor times coarser than the
+// last, so that a zoomed out view of a long capture is drawn from a
+// handful of buckets per pixel rather than from every span in view.
+// @note the span names are referenced, not copied, so the matcher must
+//     outlive us.
+// @note this class is thread safe.
+class SpanIndex : public ISpanIndex, public TraceSpanEvents {
+ public:
+  // The default most spans we hold per track, past which the oldest are
+  // released. The aggregated levels are kept regardless.
+  static const size_t kDefaultMaxSpansPerTrack = 64 * 1024;
+
+  // The width of the buckets of the finest level, in microseconds.
+  static const int64 kFinestBucketUs = 10 * 1000;
+  // The ratio of the bucket widths of adjacent levels.
+  static const int64 kLevelFactor = 8;
+  static const size_t kLevelCount = 6;
+  // The most buckets of a level, past which the level stops accounting
+  // spans, which bounds the memory of a track with a bad timestamp. This
+  // is a little under three hours at the finest level.
+  static const int64 kMaxBucketsPerLevel = 1024 * 1024;
+
+  SpanIndex();
+  explicit SpanIndex(size_t max_spans_per_track);
+  ~SpanIndex();
+
+  // ISpanIndex implementation.
+  virtual void GetTracks(std::vector<Track>* tracks);
+  virtual bool GetTimeRange(base::Time* first, base::Time* last);
+  virtual void GetSpans(const Track& track,
+                        const base::Time& from,
+                        const base::Time& to,
+                        std::vector<Span>* spans);
+  virtual void GetBuckets(const Track& track,
+                          const base::Time& from,
+                          const base::Time& to,
+                          size_t bucket_count,
+                          std::vector<Bucket>* buckets);
+
+  // TraceSpanEvents implementation.
+  virtual void OnTraceSpan(const TraceSpan& span);
+
+ private:
+  // The buckets of a level, dense from the bucket at index first.
+  struct Level {
+    Level() : first(0) {}
+
+    int64 first;
+    std::vector<Bucket> buckets;
+  };
+
+  struct TrackData {
+    // The spans of the track, in order of their end time.
+    std::deque<Span> spans;
+    // The longest of spans, which bounds how far back from a time we
+    // need to look for the spans that overlap it.
+    base::TimeDelta longest;
+    Level levels[kLevelCount];
+  };
+  typedef std::map<Track, TrackData> TrackMap;
+
+  // @returns the width of the buckets of @p level in microseconds.
+  static int64 BucketWidth(size_t level);
+
+  // Accounts @p span to the buckets of @p width of @p level.
+  static void AddToLevel(const Span& span, int64 width, Level* level);
+
+  // Retrieves the spans of @p data that overlap [@p from, @p to) to
+  // @p spans.
+  static void CollectSpans(const TrackData& data,
+                           const base::Time& from,
+                           const base::Time& to,
+                           std::vector<Span>* spans);
+
+  // Summarizes @p spans to the slices of @p slice_us from @p from of
+  // @p buckets.
+  static void BucketSpans(const std::vector<Span>& spans,
+                          const base::Time& from,
+                          int64 slice_us,
+                          std::vector<Bucket>* buckets);
+
+  const size_t max_spans_per_track_;
+
+  base::Lock lock_;
+  TrackMap tracks_;  // Under lock_.
+  base::Time first_;  // Under lock_.
+  base::Time last_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(SpanIndex);
+};
+
+#endif  // SAWBUCK_LOG_LIB_SPAN_INDEX_H_
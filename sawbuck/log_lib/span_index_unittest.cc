@@ -0,0 +1,175 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Span index unittests.
+#include "sawbuck/log_lib/span_index.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const DWORD kPid = 1234;
+const DWORD kTid = 4321;
+
+class SpanIndexTest: public testing::Test {
+ public:
+  SpanIndexTest() : kT0(base::Time::FromInternalValue(
+      SpanIndex::kFinestBucketUs * 1000 * 1000)), name_("Paint") {
+  }
+
+  // Adds a span of @p depth on @p tid from @p begin_ms to @p end_ms
+  // milliseconds past kT0.
+  void AddSpan(DWORD tid, int begin_ms, int end_ms, size_t depth) {
+    TraceSpanEvents::TraceSpan span = {};
+    span.process_id = kPid;
+    span.begin_thread_id = tid;
+    span.end_thread_id = tid;
+    span.name = &name_;
+    span.begin = Ms(begin_ms);
+    span.end = Ms(end_ms);
+    span.depth = depth;
+    index_.OnTraceSpan(span);
+  }
+
+  base::Time Ms(int64 ms) {
+    return kT0 + base::TimeDelta::FromMilliseconds(ms);
+  }
+
+ protected:
+  const base::Time kT0;
+  const std::string name_;
+  SpanIndex index_;
+};
+
+}  // namespace
+
+TEST_F(SpanIndexTest, Tracks) {
+  std::vector<ISpanIndex::Track> tracks;
+  base::Time first, last;
+  EXPECT_FALSE(index_.GetTimeRange(&first, &last));
+
+  AddSpan(kTid + 1, 10, 20, 0);
+  AddSpan(kTid, 5, 15, 0);
+
+  index_.GetTracks(&tracks);
+  ASSERT_EQ(2U, tracks.size());
+  EXPECT_EQ(kTid, tracks[0].thread_id);
+  EXPECT_EQ(kTid + 1, tracks[1].thread_id);
+
+  ASSERT_TRUE(index_.GetTimeRange(&first, &last));
+  EXPECT_TRUE(Ms(5) == first);
+  EXPECT_TRUE(Ms(20) == last);
+}
+
+TEST_F(SpanIndexTest, GetSpans) {
+  ISpanIndex::Track track = { kPid, kTid };
+  // A long span ending after shorter ones that begin later.
+  AddSpan(kTid, 10, 20, 1);
+  AddSpan(kTid, 30, 40, 1);
+  AddSpan(kTid, 0, 100, 0);
+  AddSpan(kTid, 110, 120, 0);
+
+  std::vector<ISpanIndex::Span> spans;
+  index_.GetSpans(track, Ms(50), Ms(60), &spans);
+  ASSERT_EQ(1U, spans.size());
+  EXPECT_TRUE(Ms(0) == spans[0].begin);
+
+  index_.GetSpans(track, Ms(15), Ms(35), &spans);
+  ASSERT_EQ(3U, spans.size());
+  EXPECT_TRUE(Ms(20) == spans[0].end);
+  EXPECT_TRUE(Ms(40) == spans[1].end);
+  EXPECT_TRUE(Ms(100) == spans[2].end);
+  EXPECT_EQ(&name_, spans[0].name);
+
+  // The range is half open.
+  index_.GetSpans(track, Ms(100), Ms(110), &spans);
+  EXPECT_TRUE(spans.empty());
+
+  ISpanIndex::Track other = { kPid, kTid + 1 };
+  index_.GetSpans(other, Ms(0), Ms(200), &spans);
+  EXPECT_TRUE(spans.empty());
+}
+
+TEST_F(SpanIndexTest, FineBucketsFromSpans) {
+  ISpanIndex::Track track = { kPid, kTid };
+  AddSpan(kTid, 0, 3, 0);
+  AddSpan(kTid, 1, 2, 1);
+
+  // Ten slices of a millisecond.
+  std::vector<ISpanIndex::Bucket> buckets;
+  index_.GetBuckets(track, Ms(0), Ms(10), 10, &buckets);
+  ASSERT_EQ(10U, buckets.size());
+  EXPECT_EQ(1, buckets[0].busy.InMilliseconds());
+  EXPECT_EQ(1U, buckets[0].max_depth);
+  EXPECT_EQ(2U, buckets[1].max_depth);
+  EXPECT_EQ(2U, buckets[1].span_count);
+  EXPECT_EQ(1, buckets[2].busy.InMilliseconds());
+  EXPECT_EQ(0U, buckets[3].span_count);
+  EXPECT_EQ(0, buckets[3].busy.InMilliseconds());
+}
+
+TEST_F(SpanIndexTest, CoarseBucketsFromLevels) {
+  ISpanIndex::Track track = { kPid, kTid };
+  // Ten minutes of a 5ms span every 20ms, and one long nested span.
+  for (int i = 0; i < 30000; ++i)
+    AddSpan(kTid, i * 20, i * 20 + 5, 0);
+  AddSpan(kTid, 1000, 2000, 1);
+
+  // A hundred slices of six seconds.
+  std::vector<ISpanIndex::Bucket> buckets;
+  index_.GetBuckets(track, Ms(0), Ms(600 * 1000), 100, &buckets);
+  ASSERT_EQ(100U, buckets.size());
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    // A quarter of each slice is busy, to within the width of the level
+    // buckets that straddle the slice boundaries.
+    EXPECT_NEAR(1500, buckets[i].busy.InMilliseconds(), 400);
+    EXPECT_LE(1U, buckets[i].max_depth);
+  }
+  EXPECT_EQ(2U, buckets[0].max_depth);
+  EXPECT_EQ(1U, buckets[1].max_depth);
+
+  // The busy time adds up, to within the shares of the level buckets that
+  // straddle the ends of the range.
+  int64 total_us = 0;
+  for (size_t i = 0; i < buckets.size(); ++i)
+    total_us += buckets[i].busy.InMicroseconds();
+  EXPECT_NEAR(150 * 1000 * 1000, total_us, 1000 * 1000);
+
+  index_.GetBuckets(track, Ms(0), Ms(600 * 1000), 0, &buckets);
+  EXPECT_TRUE(buckets.empty());
+}
+
+TEST_F(SpanIndexTest, DropsOldestSpans) {
+  SpanIndex index(2);
+  ISpanIndex::Track track = { kPid, kTid };
+  TraceSpanEvents::TraceSpan span = {};
+  span.process_id = kPid;
+  span.begin_thread_id = kTid;
+  span.name = &name_;
+  for (int i = 0; i < 3; ++i) {
+    span.begin = Ms(i * 10);
+    span.end = Ms(i * 10 + 5);
+    index.OnTraceSpan(span);
+  }
+
+  std::vector<ISpanIndex::Span> spans;
+  index.GetSpans(track, Ms(0), Ms(100), &spans);
+  ASSERT_EQ(2U, spans.size());
+  EXPECT_TRUE(Ms(10) == spans[0].begin);
+
+  // The levels still account the dropped span.
+  std::vector<ISpanIndex::Bucket> buckets;
+  index.GetBuckets(track, Ms(0), Ms(1000), 10, &buckets);
+  EXPECT_EQ(15, buckets[0].busy.InMilliseconds());
+}
@@ -0,0 +1,107 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Span regression detector implementation.
+#include "sawbuck/log_lib/span_regression_detector.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+// Orders regressions by ratio, worst first.
+bool IsWorse(const SpanRegressionDetector::Regression& a,
+             const SpanRegressionDetector::Regression& b) {
+  if (a.ratio != b.ratio)
+    return a.ratio > b.ratio;
+  return a.name < b.name;
+}
+
+}  // namespace
+
+const double SpanRegressionDetector::kDefaultFactor = 1.5;
+const uint64 SpanRegressionDetector::kDefaultMinCount;
+
+SpanRegressionDetector::SpanRegressionDetector()
+    : factor_(kDefaultFactor), min_count_(kDefaultMinCount) {
+}
+
+SpanRegressionDetector::~SpanRegressionDetector() {
+}
+
+void SpanRegressionDetector::set_factor(double factor) {
+  DCHECK_LT(1.0, factor);
+  factor_ = factor;
+}
+
+void SpanRegressionDetector::SetBaseline(
+    const std::vector<TraceSpanMatcher::DurationStats>& baseline) {
+  baseline_.clear();
+  regressions_.clear();
+  for (size_t i = 0; i < baseline.size(); ++i) {
+    if (baseline[i].count >= min_count_)
+      baseline_[baseline[i].name] = baseline[i].p95;
+  }
+}
+
+size_t SpanRegressionDetector::Check(
+    const std::vector<TraceSpanMatcher::DurationStats>& live,
+    const base::Time& now) {
+  size_t flagged = 0;
+  for (size_t i = 0; i < live.size(); ++i) {
+    const TraceSpanMatcher::DurationStats& stats = live[i];
+    if (stats.count < min_count_)
+      continue;
+    BaselineMap::const_iterator it(baseline_.find(stats.name));
+    if (it == baseline_.end())
+      continue;
+
+    // A microsecond on either side keeps spans that take no time at all
+    // from dividing by zero.
+    double ratio = (stats.p95.InMicroseconds() + 1.0) /
+        (it->second.InMicroseconds() + 1.0);
+    if (ratio < factor_)
+      continue;
+
+    RegressionMap::iterator found(regressions_.find(stats.name));
+    if (found == regressions_.end()) {
+      Regression regression;
+      regression.name = stats.name;
+      regression.baseline_p95 = it->second;
+      regression.first_flagged = now;
+      found = regressions_.insert(
+          std::make_pair(stats.name, regression)).first;
+      ++flagged;
+    }
+    Regression& regression = found->second;
+    if (ratio >= regression.ratio) {
+      regression.p95 = stats.p95;
+      regression.count = stats.count;
+      regression.ratio = ratio;
+    }
+  }
+
+  return flagged;
+}
+
+void SpanRegressionDetector::GetRegressions(
+    std::vector<Regression>* regressions) const {
+  DCHECK(regressions != NULL);
+  regressions->clear();
+  regressions->reserve(regressions_.size());
+  RegressionMap::const_iterator it(regressions_.begin());
+  for (; it != regressions_.end(); ++it)
+    regressions->push_back(it->second);
+  std::sort(regressions->begin(), regressions->end(), IsWorse);
+}
@@ -0,0 +1,112 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Span regression detector declaration.
+#ifndef SAWBUCK_LOG_LIB_SPAN_REGRESSION_DETECTOR_H_
+#define SAWBUCK_LOG_LIB_SPAN_REGRESSION_DETECTOR_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/time/time.h"
+#include "sawbuck/log_lib/trace_span_matcher.h"
+
+// Flags the span names whose durations regress from a baseline, e.g. that
+// of a session saved before a change, while a capture goes on. The live
+// durations are the histograms a TraceSpanMatcher keeps by name, which are
+// sampled now and then to Check, and the baseline keeps the 95th
+// percentile of each name, so the memory grows with the distinct names
+// rather than with the spans however long the capture.
+// A name is flagged once its live 95th percentile exceeds that of the
+// baseline by factor(), over at least min_count() spans, and stays flagged
+// for the rest of the capture, with the worst ratio it's been seen at.
+class SpanRegressionDetector {
+ public:
+  // The default ratio of the 95th percentiles a name is flagged at.
+  static const double kDefaultFactor;
+  // The default fewest live spans of a name it's flagged over.
+  static const uint64 kDefaultMinCount = 20;
+
+  struct Regression {
+    Regression() : count(0), ratio(0) {
+    }
+
+    std::string name;
+    // The 95th percentile of the baseline, and the live one as of the
+    // worst ratio.
+    base::TimeDelta baseline_p95;
+    base::TimeDelta p95;
+    // The live spans as of the worst ratio.
+    uint64 count;
+    // The worst ratio of the 95th percentiles.
+    double ratio;
+    // The time the name was first flagged.
+    base::Time first_flagged;
+  };
+
+  SpanRegressionDetector();
+  ~SpanRegressionDetector();
+
+  // Sets the ratio of the 95th percentiles a name is flagged at, which is
+  // greater than one.
+  void set_factor(double factor);
+  double factor() const { return factor_; }
+
+  // Sets the fewest live spans of a name it's flagged over.
+  void set_min_count(uint64 min_count) { min_count_ = min_count; }
+  uint64 min_count() const { return min_count_; }
+
+  // Replaces the baseline with @p baseline, and forgets the names flagged.
+  // Names of fewer than min_count() spans in the baseline are left out, as
+  // their percentiles are noise.
+  void SetBaseline(
+      const std::vector<TraceSpanMatcher::DurationStats>& baseline);
+
+  // @returns true iff there's a baseline to check against.
+  bool has_baseline() const { return !baseline_.empty(); }
+  // @returns the number of names in the baseline.
+  size_t baseline_size() const { return baseline_.size(); }
+
+  // Checks the durations of @p live, as of @p now, against the baseline.
+  // @returns the number of names newly flagged.
+  size_t Check(const std::vector<TraceSpanMatcher::DurationStats>& live,
+               const base::Time& now);
+
+  // Retrieves the names flagged so far, worst ratio first, to
+  // @p regressions.
+  void GetRegressions(std::vector<Regression>* regressions) const;
+
+  // @returns the number of names flagged so far.
+  size_t regression_count() const { return regressions_.size(); }
+
+  // Forgets the names flagged, keeping the baseline.
+  void ClearRegressions() { regressions_.clear(); }
+
+ private:
+  double factor_;
+  uint64 min_count_;
+
+  // The 95th percentile of each name of the baseline.
+  typedef std::map<std::string, base::TimeDelta> BaselineMap;
+  BaselineMap baseline_;
+
+  // The names flagged, by name.
+  typedef std::map<std::string, Regression> RegressionMap;
+  RegressionMap regressions_;
+
+  DISALLOW_COPY_AND_ASSIGN(SpanRegressionDetector);
+};
+
+#endif  // SAWBUCK_LOG_LIB_SPAN_REGRESSION_DETECTOR_H_
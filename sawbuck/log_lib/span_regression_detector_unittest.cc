@@ -0,0 +1,114 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Span regression detector unittests.
+#include "sawbuck/log_lib/span_regression_detector.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TraceSpanMatcher::DurationStats Stats(const char* name, uint64 count,
+                                      int p95_ms) {
+  TraceSpanMatcher::DurationStats stats;
+  stats.name = name;
+  stats.count = count;
+  stats.p95 = base::TimeDelta::FromMilliseconds(p95_ms);
+  return stats;
+}
+
+class SpanRegressionDetectorTest: public testing::Test {
+ public:
+  SpanRegressionDetectorTest() : kT0(base::Time::Now()) {
+    std::vector<TraceSpanMatcher::DurationStats> baseline;
+    baseline.push_back(Stats("Paint", 100, 10));
+    baseline.push_back(Stats("Layout", 100, 20));
+    baseline.push_back(Stats("Rare", 2, 1));
+    detector_.SetBaseline(baseline);
+  }
+
+ protected:
+  const base::Time kT0;
+  SpanRegressionDetector detector_;
+};
+
+}  // namespace
+
+TEST_F(SpanRegressionDetectorTest, LeavesOutSparseBaselineNames) {
+  EXPECT_TRUE(detector_.has_baseline());
+  EXPECT_EQ(2U, detector_.baseline_size());
+}
+
+TEST_F(SpanRegressionDetectorTest, FlagsNamesPastTheFactor) {
+  std::vector<TraceSpanMatcher::DurationStats> live;
+  live.push_back(Stats("Paint", 50, 14));
+  live.push_back(Stats("Layout", 50, 40));
+  live.push_back(Stats("Rare", 50, 100));
+  live.push_back(Stats("Unknown", 50, 100));
+  EXPECT_EQ(1U, detector_.Check(live, kT0));
+
+  std::vector<SpanRegressionDetector::Regression> regressions;
+  detector_.GetRegressions(&regressions);
+  ASSERT_EQ(1U, regressions.size());
+  EXPECT_EQ("Layout", regressions[0].name);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(20),
+            regressions[0].baseline_p95);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(40), regressions[0].p95);
+  EXPECT_EQ(50U, regressions[0].count);
+  EXPECT_NEAR(2.0, regressions[0].ratio, 0.01);
+  EXPECT_EQ(kT0, regressions[0].first_flagged);
+}
+
+TEST_F(SpanRegressionDetectorTest, WaitsForEnoughSpans) {
+  std::vector<TraceSpanMatcher::DurationStats> live;
+  live.push_back(Stats("Paint", 5, 100));
+  EXPECT_EQ(0U, detector_.Check(live, kT0));
+
+  live[0].count = SpanRegressionDetector::kDefaultMinCount;
+  EXPECT_EQ(1U, detector_.Check(live, kT0));
+  EXPECT_EQ(1U, detector_.regression_count());
+}
+
+TEST_F(SpanRegressionDetectorTest, KeepsTheWorstRatio) {
+  base::Time t1 = kT0 + base::TimeDelta::FromSeconds(1);
+  base::Time t2 = kT0 + base::TimeDelta::FromSeconds(2);
+  std::vector<TraceSpanMatcher::DurationStats> live;
+  live.push_back(Stats("Paint", 50, 30));
+  EXPECT_EQ(1U, detector_.Check(live, kT0));
+  live[0] = Stats("Paint", 80, 50);
+  EXPECT_EQ(0U, detector_.Check(live, t1));
+  // Recovering doesn't clear the flag.
+  live[0] = Stats("Paint", 200, 10);
+  EXPECT_EQ(0U, detector_.Check(live, t2));
+
+  std::vector<SpanRegressionDetector::Regression> regressions;
+  detector_.GetRegressions(&regressions);
+  ASSERT_EQ(1U, regressions.size());
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(50), regressions[0].p95);
+  EXPECT_EQ(80U, regressions[0].count);
+  EXPECT_EQ(kT0, regressions[0].first_flagged);
+
+  detector_.ClearRegressions();
+  EXPECT_EQ(0U, detector_.regression_count());
+  EXPECT_TRUE(detector_.has_baseline());
+}
+
+TEST_F(SpanRegressionDetectorTest, HonorsTheFactor) {
+  detector_.set_factor(3.0);
+  std::vector<TraceSpanMatcher::DurationStats> live;
+  live.push_back(Stats("Layout", 50, 40));
+  EXPECT_EQ(0U, detector_.Check(live, kT0));
+  live[0].p95 = base::TimeDelta::FromMilliseconds(61);
+  EXPECT_EQ(1U, detector_.Check(live, kT0));
+}
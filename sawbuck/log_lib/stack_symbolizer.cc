@@ -0,0 +1,112 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Stack symbolizer implementation.
+#include "sawbuck/log_lib/stack_symbolizer.h"
+
+#include "base/logging.h"
+
+const size_t StackSymbolizer::kNoFrame;
+
+StackSymbolizer::StackSymbolizer(ISymbolLookupService* lookup_service)
+    : lookup_service_(lookup_service), resolved_(false) {
+  DCHECK(lookup_service != NULL);
+}
+
+void StackSymbolizer::AddTrace(sym_util::ProcessId process_id,
+                               const base::Time& time,
+                               const sym_util::Address* frames,
+                               size_t depth) {
+  DCHECK(!resolved_);
+  GetFrameIds(process_id, time, frames, depth);
+}
+
+void StackSymbolizer::ResolveFrames() {
+  DCHECK(!resolved_);
+  lookup_service_->ResolveAddressesNow(
+      frame_process_ids_.empty() ? NULL : &frame_process_ids_[0],
+      frame_times_.empty() ? NULL : &frame_times_[0],
+      frame_addresses_.empty() ? NULL : &frame_addresses_[0],
+      frame_addresses_.size(),
+      &symbols_);
+  DCHECK_EQ(frames_.size(), symbols_.size());
+  resolved_ = true;
+}
+
+void StackSymbolizer::GetSymbols(
+    sym_util::ProcessId process_id,
+    const base::Time& time,
+    const sym_util::Address* frames,
+    size_t depth,
+    std::vector<const sym_util::SymbolRecord*>* symbols) {
+  DCHECK(resolved_);
+  DCHECK(symbols != NULL);
+
+  GetFrameIds(process_id, time, frames, depth);
+  symbols->resize(depth);
+  for (size_t i = 0; i < depth; ++i) {
+    (*symbols)[i] =
+        frame_ids_[i] != kNoFrame ? &symbols_[frame_ids_[i]] : NULL;
+  }
+}
+
+void StackSymbolizer::GetFrameIds(sym_util::ProcessId process_id,
+                                  const base::Time& time,
+                                  const sym_util::Address* frames,
+                                  size_t depth) {
+  frame_ids_.clear();
+  if (depth == 0)
+    return;
+
+  DCHECK(frames != NULL);
+  lookup_service_->GetModulesForAddresses(process_id, time, frames, depth,
+                                          &modules_);
+  DCHECK_EQ(depth, modules_.size());
+  for (size_t i = 0; i < depth; ++i) {
+    const sym_util::ModuleInformation& module = modules_[i];
+    if (module.image_file_name.empty()) {
+      frame_ids_.push_back(kNoFrame);
+      continue;
+    }
+
+    FrameKey key(GetModuleId(module), frames[i] - module.base_address);
+    FrameMap::iterator it = frames_.find(key);
+    if (it != frames_.end()) {
+      frame_ids_.push_back(it->second);
+      continue;
+    }
+
+    // The module loads are the same on both passes, so that every frame
+    // is gathered before the frames are resolved.
+    DCHECK(!resolved_);
+    if (resolved_) {
+      frame_ids_.push_back(kNoFrame);
+      continue;
+    }
+    size_t frame_id = frames_.size();
+    frames_.insert(std::make_pair(key, frame_id));
+    frame_process_ids_.push_back(process_id);
+    frame_times_.push_back(time);
+    frame_addresses_.push_back(frames[i]);
+    frame_ids_.push_back(frame_id);
+  }
+}
+
+size_t StackSymbolizer::GetModuleId(const sym_util::ModuleInformation& module) {
+  sym_util::ModuleInformation build(module);
+  build.base_address = 0;
+  std::pair<std::map<sym_util::ModuleInformation, size_t>::iterator, bool>
+      inserted = module_ids_.insert(std::make_pair(build, module_ids_.size()));
+  return inserted.first->second;
+}
@@ -0,0 +1,102 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Stack symbolizer declaration.
+#ifndef SAWBUCK_LOG_LIB_STACK_SYMBOLIZER_H_
+#define SAWBUCK_LOG_LIB_STACK_SYMBOLIZER_H_
+
+#include <map>
+#include <utility>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/time/time.h"
+#include "sawbuck/log_lib/symbol_lookup_service.h"
+
+// Symbolizes the stack traces of a set of logs in bulk, each distinct
+// frame once. The same code logs the same stacks over and over, and the
+// same module loads at different bases across processes, so the frames
+// are keyed by module build and RVA. The traces are gathered first, then
+// the frames are resolved together, and then the traces are looked up
+// again, against the same module loads, for their symbols.
+class StackSymbolizer {
+ public:
+  // @param lookup_service resolves the modules and symbols of the frames,
+  //     and must outlive the symbolizer.
+  explicit StackSymbolizer(ISymbolLookupService* lookup_service);
+
+  // Gathers the frames of the @p depth @p frames, observed in
+  // @p process_id at @p time, that weren't seen before.
+  // @pre ResolveFrames hasn't been called.
+  void AddTrace(sym_util::ProcessId process_id,
+                const base::Time& time,
+                const sym_util::Address* frames,
+                size_t depth);
+
+  // Resolves the frames gathered.
+  // @note this waits on the lookup service, so it mustn't be called on
+  //     the thread that resolves symbols.
+  void ResolveFrames();
+
+  // Retrieves the symbols of the @p depth @p frames, observed in
+  // @p process_id at @p time, to @p symbols, which get NULL for frames
+  // outside of any module. The symbols are valid for the lifetime of the
+  // symbolizer.
+  // @pre ResolveFrames has been called, and the trace was added before.
+  void GetSymbols(sym_util::ProcessId process_id,
+                  const base::Time& time,
+                  const sym_util::Address* frames,
+                  size_t depth,
+                  std::vector<const sym_util::SymbolRecord*>* symbols);
+
+  // @returns the number of distinct frames gathered.
+  size_t num_frames() const { return frames_.size(); }
+
+ private:
+  // A module build, and an offset into it.
+  typedef std::pair<size_t, sym_util::Address> FrameKey;
+  typedef std::map<FrameKey, size_t> FrameMap;
+
+  // The frame id of addresses outside of any module.
+  static const size_t kNoFrame = static_cast<size_t>(-1);
+
+  // Retrieves the frame ids of the @p depth @p frames to frame_ids_,
+  // gathering the frames not seen before unless resolved.
+  void GetFrameIds(sym_util::ProcessId process_id,
+                   const base::Time& time,
+                   const sym_util::Address* frames,
+                   size_t depth);
+  // @returns the id of the build of @p module, whatever its base.
+  size_t GetModuleId(const sym_util::ModuleInformation& module);
+
+  ISymbolLookupService* lookup_service_;
+  bool resolved_;
+
+  // The module builds seen, by their identity with a zero base.
+  std::map<sym_util::ModuleInformation, size_t> module_ids_;
+  FrameMap frames_;
+  // An occurrence of each frame, by frame id, for the lookup.
+  std::vector<sym_util::ProcessId> frame_process_ids_;
+  std::vector<base::Time> frame_times_;
+  std::vector<sym_util::Address> frame_addresses_;
+  // The symbols of the frames, by frame id, once resolved.
+  std::vector<sym_util::SymbolRecord> symbols_;
+
+  // Scratch buffers, reused from trace to trace.
+  std::vector<sym_util::ModuleInformation> modules_;
+  std::vector<size_t> frame_ids_;
+
+  DISALLOW_COPY_AND_ASSIGN(StackSymbolizer);
+};
+
+#endif  // SAWBUCK_LOG_LIB_STACK_SYMBOLIZER_H_
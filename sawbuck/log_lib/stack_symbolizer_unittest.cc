@@ -0,0 +1,265 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Stack symbolizer unittests.
+#include "sawbuck/log_lib/stack_symbolizer.h"
+
+#include <vector>
+#include "base/strings/stringprintf.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+const sym_util::ProcessId kProcess1 = 1;
+const sym_util::ProcessId kProcess2 = 2;
+const sym_util::ProcessId kProcess3 = 3;
+
+// The app loads at a base per process, the other processes have no module.
+const sym_util::Address kApp1Base = 0x10000;
+const sym_util::Address kApp2Base = 0x40000;
+const sym_util::ModuleSize kAppSize = 0x1000;
+
+// A lookup service with the one app module, which names the function at
+// each RVA after it, and tallies the bulk lookups.
+class FakeSymbolLookupService : public ISymbolLookupService {
+ public:
+  FakeSymbolLookupService() : num_bulk_lookups_(0) {
+  }
+
+  int num_bulk_lookups() const { return num_bulk_lookups_; }
+  const std::vector<sym_util::Address>& looked_up() const {
+    return looked_up_;
+  }
+
+  virtual Handle ResolveAddress(sym_util::ProcessId process_id,
+                                const base::Time& time,
+                                sym_util::Address address,
+                                const SymbolResolvedCallback& callback) {
+    ADD_FAILURE() << "Not reached.";
+    return kInvalidHandle;
+  }
+  virtual Handle ResolveAddresses(sym_util::ProcessId process_id,
+                                  const base::Time& time,
+                                  const sym_util::Address* addresses,
+                                  size_t num_addresses,
+                                  sym_util::SymbolLevel level,
+                                  const SymbolsResolvedCallback& callback) {
+    ADD_FAILURE() << "Not reached.";
+    return kInvalidHandle;
+  }
+  virtual Handle ResolveAddressesProgressively(
+      sym_util::ProcessId process_id,
+      const base::Time& time,
+      const sym_util::Address* addresses,
+      size_t num_addresses,
+      sym_util::SymbolLevel level,
+      Priority priority,
+      const base::TimeTicks& deadline,
+      const SymbolsProgressCallback& callback) {
+    ADD_FAILURE() << "Not reached.";
+    return kInvalidHandle;
+  }
+  virtual void PrefetchAddresses(sym_util::ProcessId process_id,
+                                 const base::Time& time,
+                                 const sym_util::Address* addresses,
+                                 size_t num_addresses) {
+    ADD_FAILURE() << "Not reached.";
+  }
+  virtual void ResolveAddressesNow(
+      const sym_util::ProcessId* process_ids,
+      const base::Time* times,
+      const sym_util::Address* addresses,
+      size_t num_addresses,
+      std::vector<sym_util::SymbolRecord>* symbols) {
+    ++num_bulk_lookups_;
+    symbols->resize(num_addresses);
+    for (size_t i = 0; i < num_addresses; ++i) {
+      looked_up_.push_back(addresses[i]);
+      sym_util::SymbolRecord& symbol = (*symbols)[i];
+      sym_util::ModuleInformation module;
+      if (!GetModule(process_ids[i], &module))
+        continue;
+      sym_util::Address rva = addresses[i] - module.base_address;
+      symbol.module = strings_.Intern(module.image_file_name);
+      symbol.module_base = module.base_address;
+      symbol.name = strings_.Intern(
+          base::StringPrintf(L"Function%llX", rva & ~0xFULL));
+      symbol.offset = static_cast<uint32>(rva & 0xF);
+      symbol.level = sym_util::SYMBOL_FUNCTION;
+    }
+  }
+  virtual size_t GetModulesForAddresses(
+      sym_util::ProcessId process_id,
+      const base::Time& time,
+      const sym_util::Address* addresses,
+      size_t num_addresses,
+      std::vector<sym_util::ModuleInformation>* modules) {
+    modules->assign(num_addresses, sym_util::ModuleInformation());
+    sym_util::ModuleInformation module;
+    if (!GetModule(process_id, &module))
+      return 0;
+
+    size_t found = 0;
+    for (size_t i = 0; i < num_addresses; ++i) {
+      if (addresses[i] >= module.base_address &&
+          addresses[i] < module.base_address + module.module_size) {
+        (*modules)[i] = module;
+        ++found;
+      }
+    }
+    return found;
+  }
+  virtual void CancelRequest(Handle request_handle) {
+    ADD_FAILURE() << "Not reached.";
+  }
+  virtual void SetSymbolPath(const wchar_t* symbol_path) {
+    ADD_FAILURE() << "Not reached.";
+  }
+  virtual int GetModuleGeneration() { return 0; }
+
+ private:
+  // Retrieves the app module of @p process_id to @p module.
+  // @returns false if the process has none.
+  static bool GetModule(sym_util::ProcessId process_id,
+                        sym_util::ModuleInformation* module) {
+    if (process_id != kProcess1 && process_id != kProcess2)
+      return false;
+    module->base_address = process_id == kProcess1 ? kApp1Base : kApp2Base;
+    module->module_size = kAppSize;
+    module->image_checksum = 0xCAFE;
+    module->time_date_stamp = 0xF00D;
+    module->image_file_name = L"C:\\app.exe";
+    return true;
+  }
+
+  int num_bulk_lookups_;
+  std::vector<sym_util::Address> looked_up_;
+  sym_util::SymbolStringTable strings_;
+};
+
+class StackSymbolizerTest : public testing::Test {
+ public:
+  StackSymbolizerTest() : symbolizer_(&lookup_service_) {
+  }
+
+  // Adds the trace of @p depth @p frames in @p process_id.
+  void AddTrace(sym_util::ProcessId process_id,
+                const sym_util::Address* frames,
+                size_t depth) {
+    symbolizer_.AddTrace(process_id, base::Time(), frames, depth);
+  }
+
+  // @returns the symbols of the trace of @p depth @p frames in
+  //     @p process_id, as names with their offsets, or "?" for frames
+  //     without a symbol.
+  std::vector<std::wstring> GetSymbols(sym_util::ProcessId process_id,
+                                       const sym_util::Address* frames,
+                                       size_t depth) {
+    std::vector<const sym_util::SymbolRecord*> symbols;
+    symbolizer_.GetSymbols(process_id, base::Time(), frames, depth,
+                           &symbols);
+    EXPECT_EQ(depth, symbols.size());
+
+    std::vector<std::wstring> names;
+    for (size_t i = 0; i < symbols.size(); ++i) {
+      if (symbols[i] == NULL) {
+        names.push_back(L"?");
+        continue;
+      }
+      names.push_back(base::StringPrintf(L"%ls+0x%X",
+                                         symbols[i]->name->c_str(),
+                                         symbols[i]->offset));
+    }
+    return names;
+  }
+
+ protected:
+  FakeSymbolLookupService lookup_service_;
+  StackSymbolizer symbolizer_;
+};
+
+}  // namespace
+
+TEST_F(StackSymbolizerTest, ResolvesDistinctFramesOnce) {
+  // Two rows' traces that share their outer frames.
+  const sym_util::Address kTrace1[] = {
+      kApp1Base + 0x104, kApp1Base + 0x208, kApp1Base + 0x30C };
+  const sym_util::Address kTrace2[] = {
+      kApp1Base + 0x404, kApp1Base + 0x208, kApp1Base + 0x30C };
+  AddTrace(kProcess1, kTrace1, arraysize(kTrace1));
+  AddTrace(kProcess1, kTrace2, arraysize(kTrace2));
+  AddTrace(kProcess1, kTrace1, arraysize(kTrace1));
+  EXPECT_EQ(4U, symbolizer_.num_frames());
+
+  symbolizer_.ResolveFrames();
+  EXPECT_EQ(1, lookup_service_.num_bulk_lookups());
+  ASSERT_EQ(4U, lookup_service_.looked_up().size());
+  EXPECT_EQ(kApp1Base + 0x104, lookup_service_.looked_up()[0]);
+  EXPECT_EQ(kApp1Base + 0x208, lookup_service_.looked_up()[1]);
+  EXPECT_EQ(kApp1Base + 0x30C, lookup_service_.looked_up()[2]);
+  EXPECT_EQ(kApp1Base + 0x404, lookup_service_.looked_up()[3]);
+}
+
+TEST_F(StackSymbolizerTest, SharesFramesAcrossModuleBases) {
+  // The same frame in two processes that load the app at different bases.
+  const sym_util::Address kTrace1[] = { kApp1Base + 0x104 };
+  const sym_util::Address kTrace2[] = { kApp2Base + 0x104 };
+  AddTrace(kProcess1, kTrace1, arraysize(kTrace1));
+  AddTrace(kProcess2, kTrace2, arraysize(kTrace2));
+  EXPECT_EQ(1U, symbolizer_.num_frames());
+
+  symbolizer_.ResolveFrames();
+  std::vector<std::wstring> symbols1 =
+      GetSymbols(kProcess1, kTrace1, arraysize(kTrace1));
+  std::vector<std::wstring> symbols2 =
+      GetSymbols(kProcess2, kTrace2, arraysize(kTrace2));
+  ASSERT_EQ(1U, symbols1.size());
+  EXPECT_EQ(L"Function100+0x4", symbols1[0]);
+  EXPECT_EQ(symbols1, symbols2);
+}
+
+TEST_F(StackSymbolizerTest, ResolvesEachRowsFrames) {
+  const sym_util::Address kTrace1[] = {
+      kApp1Base + 0x104, 0x1234, kApp1Base + 0x30C };
+  const sym_util::Address kTrace2[] = {
+      kApp2Base + 0x30C, kApp2Base + 0x104 };
+  const sym_util::Address kTrace3[] = { kApp1Base + 0x104 };
+  AddTrace(kProcess1, kTrace1, arraysize(kTrace1));
+  AddTrace(kProcess2, kTrace2, arraysize(kTrace2));
+  AddTrace(kProcess3, kTrace3, arraysize(kTrace3));
+  AddTrace(kProcess1, NULL, 0);
+  EXPECT_EQ(2U, symbolizer_.num_frames());
+  symbolizer_.ResolveFrames();
+
+  // The frames outside of the app get no symbol, and the process without
+  // the app has none at all.
+  std::vector<std::wstring> symbols =
+      GetSymbols(kProcess1, kTrace1, arraysize(kTrace1));
+  ASSERT_EQ(3U, symbols.size());
+  EXPECT_EQ(L"Function100+0x4", symbols[0]);
+  EXPECT_EQ(L"?", symbols[1]);
+  EXPECT_EQ(L"Function300+0xC", symbols[2]);
+
+  symbols = GetSymbols(kProcess2, kTrace2, arraysize(kTrace2));
+  ASSERT_EQ(2U, symbols.size());
+  EXPECT_EQ(L"Function300+0xC", symbols[0]);
+  EXPECT_EQ(L"Function100+0x4", symbols[1]);
+
+  symbols = GetSymbols(kProcess3, kTrace3, arraysize(kTrace3));
+  ASSERT_EQ(1U, symbols.size());
+  EXPECT_EQ(L"?", symbols[0]);
+
+  EXPECT_TRUE(GetSymbols(kProcess1, NULL, 0).empty());
+  EXPECT_EQ(1, lookup_service_.num_bulk_lookups());
+}
@@ -0,0 +1,58 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// String interning table implementation.
+#include "sawbuck/log_lib/string_table.h"
+
+#include "base/logging.h"
+
+const StringTable::Atom StringTable::kEmptyAtom;
+
+StringTable::StringTable() {
+  // Make sure the empty string gets the empty atom.
+  strings_.push_back(std::string());
+  atoms_.insert(std::make_pair(base::StringPiece(strings_.back()),
+                               kEmptyAtom));
+}
+
+StringTable::~StringTable() {
+}
+
+StringTable::Atom StringTable::Intern(const base::StringPiece& str) {
+  if (str.empty())
+    return kEmptyAtom;
+
+  base::AutoLock lock(lock_);
+  AtomMap::iterator it(atoms_.find(str));
+  if (it != atoms_.end())
+    return it->second;
+
+  Atom atom = strings_.size();
+  strings_.push_back(str.as_string());
+  atoms_.insert(std::make_pair(base::StringPiece(strings_.back()), atom));
+
+  return atom;
+}
+
+const std::string& StringTable::GetString(Atom atom) const {
+  base::AutoLock lock(lock_);
+  DCHECK_LT(atom, strings_.size());
+
+  return strings_[atom];
+}
+
+size_t StringTable::size() const {
+  base::AutoLock lock(lock_);
+  return strings_.size();
+}
@@ -0,0 +1,66 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// String interning table declaration.
+#ifndef SAWBUCK_LOG_LIB_STRING_TABLE_H_
+#define SAWBUCK_LOG_LIB_STRING_TABLE_H_
+
+#include <deque>
+#include <map>
+#include <string>
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "base/synchronization/lock.h"
+
+// Interns strings, handing out a stable 32 bit atom for each distinct
+// string. Atoms are dense and allocated in order of first occurrence,
+// the empty string is always kEmptyAtom. Since interned strings are never
+// released, this is intended for small vocabularies that repeat a lot, like
+// source file names.
+// @note this class is thread safe.
+class StringTable {
+ public:
+  typedef uint32 Atom;
+  static const Atom kEmptyAtom = 0;
+
+  StringTable();
+  ~StringTable();
+
+  // Interns @p str.
+  // @returns the atom for @p str.
+  Atom Intern(const base::StringPiece& str);
+
+  // @returns the string for @p atom, which must have been returned
+  //    from Intern on this table.
+  // @note the returned reference is valid for the lifetime of the table.
+  const std::string& GetString(Atom atom) const;
+
+  // @returns the number of strings interned, including the empty string.
+  size_t size() const;
+
+ private:
+  mutable base::Lock lock_;
+
+  // The interned strings, indexed by atom. This is a deque so as to keep
+  // the strings in place as it grows.
+  std::deque<std::string> strings_;  // Under lock_.
+
+  // The keys refer to the strings in strings_.
+  typedef std::map<base::StringPiece, Atom> AtomMap;
+  AtomMap atoms_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(StringTable);
+};
+
+#endif  // SAWBUCK_LOG_LIB_STRING_TABLE_H_
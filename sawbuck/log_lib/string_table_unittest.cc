@@ -0,0 +1,66 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/log_lib/string_table.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(StringTableTest, EmptyString) {
+  StringTable table;
+
+  EXPECT_EQ(1, table.size());
+  EXPECT_EQ(StringTable::kEmptyAtom, table.Intern(""));
+  EXPECT_EQ(StringTable::kEmptyAtom, table.Intern(base::StringPiece()));
+  EXPECT_EQ("", table.GetString(StringTable::kEmptyAtom));
+  EXPECT_EQ(1, table.size());
+}
+
+TEST(StringTableTest, Intern) {
+  StringTable table;
+
+  StringTable::Atom foo = table.Intern("foo.cc");
+  StringTable::Atom bar = table.Intern("bar.cc");
+
+  EXPECT_NE(StringTable::kEmptyAtom, foo);
+  EXPECT_NE(StringTable::kEmptyAtom, bar);
+  EXPECT_NE(foo, bar);
+
+  // Interning again yields the same atom, regardless of the storage
+  // of the string interned.
+  std::string foo_copy("foo.cc");
+  EXPECT_EQ(foo, table.Intern(foo_copy));
+  EXPECT_EQ(foo, table.Intern(base::StringPiece("foo.cc.h", 6)));
+  EXPECT_EQ(3, table.size());
+
+  EXPECT_EQ("foo.cc", table.GetString(foo));
+  EXPECT_EQ("bar.cc", table.GetString(bar));
+}
+
+TEST(StringTableTest, StableStrings) {
+  StringTable table;
+
+  StringTable::Atom first = table.Intern("first");
+  const std::string* first_str = &table.GetString(first);
+
+  for (int i = 0; i < 10000; ++i) {
+    std::string str(i + 1, 'x');
+    table.Intern(str);
+  }
+
+  EXPECT_EQ(first_str, &table.GetString(first));
+  EXPECT_EQ("first", *first_str);
+}
+
+}  // namespace
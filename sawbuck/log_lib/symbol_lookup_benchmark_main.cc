@@ -0,0 +1,274 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Replays symbol lookups through the SymbolLookupService, to measure the
+// symbolization and its caching end to end. The module events of the log
+// files given on the command line load the processes' modules into the
+// service. The lookups are those of the stack traces of the log messages
+// in the files, or those listed in the --lookups file, one per line as
+//   <pid> <time> <address>
+// where the time is in microseconds since 1601 UTC and the address is in
+// hex. The lookups are replayed one at a time, twice, first with cold and
+// then with warm caches.
+//
+// Usage: symbol_lookup_benchmark [--lookups=FILE] [--symbol-path=PATH]
+//            file.etl ...
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "base/at_exit.h"
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/logging.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/threading/thread.h"
+#include "base/time/time.h"
+#include "sawbuck/log_lib/etl_file_reader.h"
+#include "sawbuck/log_lib/event_router.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/log_lib/log_consumer.h"
+#include "sawbuck/log_lib/symbol_lookup_service.h"
+
+namespace {
+
+struct Lookup {
+  sym_util::ProcessId process_id;
+  base::Time time;
+  sym_util::Address address;
+};
+
+// Feeds the module events of a log to the service, and gathers the
+// lookups of the stack traces of its log messages.
+class LogReplay
+    : public EtlEventSink,
+      public KernelLogParser,
+      public LogParser,
+      public LogEvents {
+ public:
+  LogReplay(SymbolLookupService* service, std::vector<Lookup>* lookups)
+      : lookups_(lookups) {
+    LogParser::AddEventClasses(&router_);
+    KernelLogParser::AddEventClasses(&router_);
+    set_module_event_sink(service);
+    set_event_sink(lookups != NULL ? this : NULL);
+  }
+
+  // EtlEventSink implementation.
+  virtual void OnEvent(EVENT_TRACE* event) {
+    router_.ProcessOneEvent(event);
+  }
+
+  // LogEvents implementation.
+  virtual void OnLogMessage(const LogMessage& log_message) {
+    for (size_t i = 0; i < log_message.trace_depth; ++i) {
+      Lookup lookup = {
+        log_message.process_id,
+        log_message.time,
+        reinterpret_cast<sym_util::Address>(log_message.traces[i]),
+      };
+      lookups_->push_back(lookup);
+    }
+  }
+
+ private:
+  EventRouter router_;
+  std::vector<Lookup>* lookups_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogReplay);
+};
+
+// Reads the lookups of the file at @p path.
+// @returns false if the file can't be read, or has a malformed line.
+bool ReadLookups(const base::FilePath& path, std::vector<Lookup>* lookups) {
+  FILE* file = _wfopen(path.value().c_str(), L"r");
+  if (file == NULL)
+    return false;
+
+  bool succeeded = true;
+  char line[256];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    unsigned long process_id = 0;
+    long long time = 0;
+    unsigned long long address = 0;
+    if (sscanf(line, "%lu %lld %llx", &process_id, &time, &address) != 3) {
+      succeeded = false;
+      break;
+    }
+
+    Lookup lookup = {
+      process_id,
+      base::Time::FromInternalValue(time),
+      static_cast<sym_util::Address>(address),
+    };
+    lookups->push_back(lookup);
+  }
+
+  fclose(file);
+  return succeeded;
+}
+
+// Issues lookups one at a time, and times each from request to callback.
+class LookupTimer {
+ public:
+  explicit LookupTimer(SymbolLookupService* service)
+      : service_(service), num_resolved_(0) {
+  }
+
+  void Replay(const std::vector<Lookup>& lookups) {
+    latencies_.clear();
+    num_resolved_ = 0;
+    for (size_t i = 0; i < lookups.size(); ++i) {
+      base::RunLoop run_loop;
+      quit_ = run_loop.QuitClosure();
+
+      base::TimeTicks start = base::TimeTicks::HighResNow();
+      service_->ResolveAddress(lookups[i].process_id, lookups[i].time,
+          lookups[i].address,
+          base::Bind(&LookupTimer::OnResolved, base::Unretained(this)));
+      run_loop.Run();
+      latencies_.push_back(base::TimeTicks::HighResNow() - start);
+    }
+  }
+
+  // Prints the percentiles of the latencies, labeled @p label.
+  void Report(const char* label) {
+    std::sort(latencies_.begin(), latencies_.end());
+    printf("%s: %u lookups, %u resolved\n", label,
+           static_cast<unsigned>(latencies_.size()),
+           static_cast<unsigned>(num_resolved_));
+    if (latencies_.empty())
+      return;
+
+    const int kPercentiles[] = { 50, 90, 99, 100 };
+    for (size_t i = 0; i < arraysize(kPercentiles); ++i) {
+      size_t index = (latencies_.size() - 1) * kPercentiles[i] / 100;
+      printf("  p%d %.3f ms\n", kPercentiles[i],
+             latencies_[index].InMillisecondsF());
+    }
+  }
+
+ private:
+  void OnResolved(sym_util::ProcessId process_id,
+                  base::Time time,
+                  sym_util::Address address,
+                  SymbolLookupService::Handle handle,
+                  const sym_util::SymbolRecord& symbol) {
+    if (symbol.name != NULL && !symbol.name->empty())
+      ++num_resolved_;
+    quit_.Run();
+  }
+
+  SymbolLookupService* service_;
+  base::Closure quit_;
+  std::vector<base::TimeDelta> latencies_;
+  size_t num_resolved_;
+
+  DISALLOW_COPY_AND_ASSIGN(LookupTimer);
+};
+
+void ReportStats(const char* label,
+                 const sym_util::ModuleSymbolCache::Stats& stats) {
+  size_t lookups = stats.hits + stats.failure_hits + stats.resolved +
+      stats.failed;
+  double hit_ratio = lookups == 0 ? 0.0 :
+      static_cast<double>(stats.hits + stats.failure_hits) / lookups;
+  printf("%s: %.1f%% cache hits, %u resolved, %u failed, "
+         "%u modules loaded in %.1f ms\n",
+         label, hit_ratio * 100,
+         static_cast<unsigned>(stats.resolved),
+         static_cast<unsigned>(stats.failed),
+         static_cast<unsigned>(stats.modules_loaded),
+         stats.load_time.InMillisecondsF());
+}
+
+// The difference of the tallies @p after and @p before.
+sym_util::ModuleSymbolCache::Stats StatsSince(
+    const sym_util::ModuleSymbolCache::Stats& after,
+    const sym_util::ModuleSymbolCache::Stats& before) {
+  sym_util::ModuleSymbolCache::Stats stats;
+  stats.hits = after.hits - before.hits;
+  stats.failure_hits = after.failure_hits - before.failure_hits;
+  stats.resolved = after.resolved - before.resolved;
+  stats.failed = after.failed - before.failed;
+  stats.modules_loaded = after.modules_loaded - before.modules_loaded;
+  stats.load_time = after.load_time - before.load_time;
+  return stats;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  CommandLine::Init(argc, argv);
+
+  const CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  std::vector<std::wstring> args = cmd_line->GetArgs();
+  if (args.empty()) {
+    printf("Usage: symbol_lookup_benchmark [--lookups=FILE] "
+           "[--symbol-path=PATH] file.etl ...\n");
+    return 1;
+  }
+
+  base::MessageLoop message_loop;
+  base::Thread background_thread("Symbol lookup");
+  if (!background_thread.Start())
+    return 1;
+
+  {
+    SymbolLookupService service;
+    service.set_background_thread(background_thread.message_loop());
+    if (cmd_line->HasSwitch("symbol-path")) {
+      service.SetSymbolPath(
+          cmd_line->GetSwitchValueNative("symbol-path").c_str());
+    }
+
+    std::vector<Lookup> lookups;
+    base::FilePath lookups_path(cmd_line->GetSwitchValuePath("lookups"));
+    if (!lookups_path.empty() && !ReadLookups(lookups_path, &lookups)) {
+      printf("Error reading the lookups of \"%ls\".\n",
+             lookups_path.value().c_str());
+      return 1;
+    }
+
+    for (size_t i = 0; i < args.size(); ++i) {
+      EtlFileReader reader;
+      base::FilePath path(args[i]);
+      HRESULT hr = reader.Open(path);
+      if (FAILED(hr)) {
+        printf("Error 0x%08X opening \"%ls\".\n", hr, path.value().c_str());
+        return 1;
+      }
+
+      LogReplay replay(&service, lookups_path.empty() ? &lookups : NULL);
+      reader.Consume(&replay);
+    }
+
+    LookupTimer timer(&service);
+    timer.Replay(lookups);
+    timer.Report("Cold");
+    // The background thread is idle between lookups.
+    sym_util::ModuleSymbolCache::Stats cold(service.symbol_stats());
+    ReportStats("Cold", cold);
+
+    timer.Replay(lookups);
+    timer.Report("Warm");
+    ReportStats("Warm", StatsSince(service.symbol_stats(), cold));
+  }
+
+  background_thread.Stop();
+  return 0;
+}
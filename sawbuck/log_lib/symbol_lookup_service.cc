@@ -16,16 +16,66 @@
 #include "sawbuck/log_lib/symbol_lookup_service.h"
 
 #include <algorithm>
-
 #include "base/bind.h"
 #include "base/message_loop/message_loop.h"
+#include "base/strings/string_util.h"
+#include "base/synchronization/waitable_event.h"
+#include "sawbuck/common/perf_counters.h"
+#include "sawbuck/log_lib/sawbuck_trace_provider.h"
+
+namespace {
+
+PerfCounter resolve_counter("Symbols.Resolve", 1);
+
+// Loaded symbols can take minutes to come back off a symbol server, so
+// they're about the dearest memory we have to refill.
+const double kSymbolsRefillCost = 100.0;
+
+// @returns the file name of @p path, without directory, in lower case.
+std::wstring GetImageName(const std::wstring& path) {
+  size_t separator = path.find_last_of(L"\\/:");
+  return StringToLowerASCII(separator == std::wstring::npos ?
+      path : path.substr(separator + 1));
+}
+
+}  // namespace
 
-SymbolLookupService::SymbolLookupService() : background_thread_(NULL),
-    foreground_thread_(base::MessageLoop::current()), next_request_id_(0),
-    unprocessed_id_(0) {
+const size_t SymbolLookupService::kMaxRequestsConsidered;
+const size_t SymbolLookupService::kPrefetchChunkSize;
+
+struct SymbolLookupService::MoreUrgent {
+  bool operator()(RequestMap::const_iterator a,
+                  RequestMap::const_iterator b) const {
+    const Request& first = a->second;
+    const Request& second = b->second;
+    if (first.priority_ != second.priority_)
+      return first.priority_ > second.priority_;
+
+    // A null deadline is no deadline at all, which goes last.
+    if (first.deadline_ != second.deadline_) {
+      if (first.deadline_.is_null() || second.deadline_.is_null())
+        return second.deadline_.is_null();
+      return first.deadline_ < second.deadline_;
+    }
+
+    // Failing that, the oldest request goes first.
+    return a->first < b->first;
+  }
+};
+
+SymbolLookupService::SymbolLookupService()
+    : module_generation_(0), module_symbols_(&symbol_strings_),
+      background_thread_(NULL),
+      foreground_thread_(base::MessageLoop::current()), next_request_id_(0) {
+  module_symbols_.set_missing_symbols_cache(&missing_symbols_);
+  memory_budget_id_ = MemoryBudget::Get()->Register(
+      "symbols", kSymbolsRefillCost,
+      base::Bind(&SymbolLookupService::EvictSymbols, base::Unretained(this)));
 }
 
 SymbolLookupService::~SymbolLookupService() {
+  MemoryBudget::Get()->Unregister(memory_budget_id_);
+
   // Make sure there aren't any tasks pending for this object.
   DCHECK(resolve_task_.is_null());
   DCHECK(callback_task_.is_null());
@@ -34,18 +84,155 @@ SymbolLookupService::~SymbolLookupService() {
 SymbolLookupService::Handle SymbolLookupService::ResolveAddress(
     sym_util::ProcessId process_id, const base::Time& time,
     sym_util::Address address, const SymbolResolvedCallback& callback) {
-  DCHECK_EQ(foreground_thread_, base::MessageLoop::current());
   DCHECK(!callback.is_null());
 
-  base::AutoLock lock(resolution_lock_);
-  Handle request_id = next_request_id_++;
-  DCHECK(requests_.end() == requests_.find(request_id));
-  Request& request = requests_[request_id];
+  Request request;
   request.process_id_ = process_id;
   request.time_ = time;
-  request.address_ = address;
+  request.addresses_.push_back(address);
+  request.level_ = sym_util::SYMBOL_ALL;
+  request.priority_ = PRIORITY_NORMAL;
   request.callback_ = callback;
 
+  return EnqueueRequest(request);
+}
+
+SymbolLookupService::Handle SymbolLookupService::ResolveAddresses(
+    sym_util::ProcessId process_id, const base::Time& time,
+    const sym_util::Address* addresses, size_t num_addresses,
+    sym_util::SymbolLevel level, const SymbolsResolvedCallback& callback) {
+  DCHECK(addresses != NULL || num_addresses == 0);
+  DCHECK_LE(sym_util::SYMBOL_FUNCTION, level);
+  DCHECK(!callback.is_null());
+
+  Request request;
+  request.process_id_ = process_id;
+  request.time_ = time;
+  request.addresses_.assign(addresses, addresses + num_addresses);
+  request.level_ = level;
+  request.priority_ = PRIORITY_NORMAL;
+  request.batch_callback_ = callback;
+
+  return EnqueueRequest(request);
+}
+
+SymbolLookupService::Handle SymbolLookupService::ResolveAddressesProgressively(
+    sym_util::ProcessId process_id, const base::Time& time,
+    const sym_util::Address* addresses, size_t num_addresses,
+    sym_util::SymbolLevel level, Priority priority,
+    const base::TimeTicks& deadline, const SymbolsProgressCallback& callback) {
+  DCHECK(addresses != NULL || num_addresses == 0);
+  DCHECK(!callback.is_null());
+
+  Request request;
+  request.process_id_ = process_id;
+  request.time_ = time;
+  request.addresses_.assign(addresses, addresses + num_addresses);
+  request.level_ = level;
+  request.priority_ = priority;
+  request.deadline_ = deadline;
+  request.progress_callback_ = callback;
+
+  // The module loads give the modules at once, so the first callback
+  // waits on no symbols, nor on the requests ahead of this one.
+  GetModuleSymbols(process_id, time, request.addresses_, &request.resolved_);
+
+  return EnqueueRequest(request);
+}
+
+SymbolLookupService::Handle SymbolLookupService::EnqueueRequest(
+    const Request& request) {
+  DCHECK_EQ(foreground_thread_, base::MessageLoop::current());
+
+  base::AutoLock lock(resolution_lock_);
+  Handle request_id = next_request_id_++;
+  DCHECK(requests_.end() == requests_.find(request_id));
+  Request& queued = requests_[request_id];
+  queued = request;
+  queued.resolved_level_ = sym_util::SYMBOL_MODULE;
+  queued.done_ = false;
+  queued.unreported_ = false;
+
+  if (!queued.progress_callback_.is_null()) {
+    // The modules are all there is to a request that goes no further.
+    queued.done_ = queued.level_ == sym_util::SYMBOL_MODULE ||
+        queued.addresses_.empty();
+    queued.unreported_ = true;
+    EnsureCallbackTask();
+  }
+
+  if (!queued.done_)
+    EnsureResolveTask();
+
+  return request_id;
+}
+
+sym_util::SymbolLevel SymbolLookupService::GetNextLevel(
+    const Request& request) {
+  DCHECK(!request.done_);
+
+  // A progressive request gets its functions before the rest, unless all
+  // of it is to be had without loading symbols.
+  if (!request.progress_callback_.is_null() &&
+      request.resolved_level_ < sym_util::SYMBOL_FUNCTION &&
+      request.level_ > sym_util::SYMBOL_FUNCTION &&
+      !CanResolveWithoutLoading(request, request.level_)) {
+    return sym_util::SYMBOL_FUNCTION;
+  }
+
+  return request.level_;
+}
+
+void SymbolLookupService::GetModuleSymbols(
+    sym_util::ProcessId process_id, const base::Time& time,
+    const std::vector<sym_util::Address>& addresses,
+    std::vector<sym_util::SymbolRecord>* symbols) {
+  DCHECK(symbols != NULL);
+
+  std::vector<sym_util::ModuleInformation> modules;
+  GetModulesForAddresses(process_id, time,
+                         addresses.empty() ? NULL : &addresses[0],
+                         addresses.size(), &modules);
+
+  symbols->clear();
+  symbols->resize(addresses.size());
+  for (size_t i = 0; i < addresses.size(); ++i) {
+    if (modules[i].image_file_name.empty())
+      continue;
+
+    sym_util::SymbolRecord& record = (*symbols)[i];
+    record.module = symbol_strings_.Intern(modules[i].image_file_name);
+    record.module_base = modules[i].base_address;
+    record.offset = static_cast<uint32>(addresses[i] -
+                                        modules[i].base_address);
+    record.level = sym_util::SYMBOL_MODULE;
+  }
+}
+
+void SymbolLookupService::PrefetchAddresses(
+    sym_util::ProcessId process_id, const base::Time& time,
+    const sym_util::Address* addresses, size_t num_addresses) {
+  DCHECK_EQ(foreground_thread_, base::MessageLoop::current());
+  DCHECK(addresses != NULL || num_addresses == 0);
+  if (num_addresses == 0)
+    return;
+
+  base::AutoLock lock(resolution_lock_);
+  if (prefetches_.size() == kMaxPrefetches)
+    prefetches_.pop_front();
+
+  prefetches_.push_back(Prefetch());
+  Prefetch& prefetch = prefetches_.back();
+  prefetch.process_id_ = process_id;
+  prefetch.time_ = time;
+  prefetch.addresses_.assign(addresses, addresses + num_addresses);
+
+  EnsureResolveTask();
+}
+
+void SymbolLookupService::EnsureResolveTask() {
+  resolution_lock_.AssertAcquired();
+
   // Post a task to do the symbol resolution unless one is already pending,
   // or currently executing. The task will NULL this field as it exits
   // on an empty queue.
@@ -54,8 +241,51 @@ SymbolLookupService::Handle SymbolLookupService::ResolveAddress(
                                base::Unretained(this));
     background_thread_->PostTask(FROM_HERE, resolve_task_);
   }
+}
 
-  return request_id;
+void SymbolLookupService::EnsureCallbackTask() {
+  resolution_lock_.AssertAcquired();
+
+  if (callback_task_.is_null()) {
+    callback_task_ = base::Bind(&SymbolLookupService::IssueCallbacks,
+                                base::Unretained(this));
+    foreground_thread_->PostTask(FROM_HERE, callback_task_);
+  }
+}
+
+bool SymbolLookupService::TakePrefetchAddresses(Request* request) {
+  DCHECK(request != NULL);
+  resolution_lock_.AssertAcquired();
+
+  // Whoever shows the symbols asks for as much of them as they need, so
+  // the function will do for now.
+  request->level_ = sym_util::SYMBOL_FUNCTION;
+
+  if (prefetches_.empty()) {
+    if (preloads_.empty())
+      return false;
+
+    const Prefetch& preload = preloads_.front();
+    request->process_id_ = preload.process_id_;
+    request->time_ = preload.time_;
+    request->addresses_ = preload.addresses_;
+    preloads_.pop_front();
+    return true;
+  }
+
+  // Take from the back of the most recent prefetch, which is cheap to trim.
+  Prefetch& prefetch = prefetches_.back();
+  size_t count = std::min(prefetch.addresses_.size(), kPrefetchChunkSize);
+  request->process_id_ = prefetch.process_id_;
+  request->time_ = prefetch.time_;
+  request->addresses_.assign(prefetch.addresses_.end() - count,
+                             prefetch.addresses_.end());
+
+  prefetch.addresses_.resize(prefetch.addresses_.size() - count);
+  if (prefetch.addresses_.empty())
+    prefetches_.pop_back();
+
+  return true;
 }
 
 void SymbolLookupService::CancelRequest(Handle request_handle) {
@@ -74,6 +304,48 @@ void SymbolLookupService::SetSymbolPath(const wchar_t* symbol_path) {
                  symbol_path));
 }
 
+int SymbolLookupService::GetModuleGeneration() {
+  base::AutoLock lock(module_lock_);
+  return module_generation_;
+}
+
+void SymbolLookupService::OpenPersistentCache(const base::FilePath& path) {
+  background_thread_->PostTask(FROM_HERE,
+      base::Bind(&SymbolLookupService::OpenPersistentCacheCallback,
+                 base::Unretained(this),
+                 path));
+}
+
+void SymbolLookupService::SetPreloadModules(
+    const std::vector<std::wstring>& image_names) {
+  base::AutoLock lock(module_lock_);
+  preload_names_.clear();
+  for (size_t i = 0; i < image_names.size(); ++i)
+    preload_names_.insert(GetImageName(image_names[i]));
+}
+
+void SymbolLookupService::SetSymbolCacheBudget(uint64 budget) {
+  background_thread_->PostTask(FROM_HERE,
+      base::Bind(&SymbolLookupService::SetSymbolCacheBudgetCallback,
+                 base::Unretained(this),
+                 budget));
+}
+
+void SymbolLookupService::OnProcessIsRunning(
+    const base::Time& time, const ProcessInfo& process_info) {
+}
+
+void SymbolLookupService::OnProcessStarted(
+    const base::Time& time, const ProcessInfo& process_info) {
+}
+
+void SymbolLookupService::OnProcessEnded(
+    const base::Time& time, const ProcessInfo& process_info,
+    ULONG exit_status) {
+  base::AutoLock lock(module_lock_);
+  module_cache_.ProcessEnded(process_info.process_id, time);
+}
+
 void SymbolLookupService::OnModuleIsLoaded(
     DWORD process_id, const base::Time& time,
     const ModuleInformation& module_info) {
@@ -91,130 +363,267 @@ void SymbolLookupService::OnModuleIsLoaded(
 void SymbolLookupService::OnModuleUnload(
     DWORD process_id, const base::Time& time,
     const ModuleInformation& module_info) {
+  // The unload has to match the load, which was mapped to a drive path.
+  ModuleInformation& info = const_cast<ModuleInformation&>(module_info);
+
   base::AutoLock lock(module_lock_);
+  MapDevicePath(&info.image_file_name);
   module_cache_.ModuleUnloaded(process_id, time, module_info);
+  ++module_generation_;
 }
 
 void SymbolLookupService::OnModuleLoad(
     DWORD process_id, const base::Time& time,
     const ModuleInformation& module_info) {
-  std::wstring file_path(module_info.image_file_name);
-  // Map device paths to drive paths.
+  // The drive path is shorter than the device path, so mapping in place
+  // doesn't allocate.
+  ModuleInformation& info = const_cast<ModuleInformation&>(module_info);
+
+  bool preload = false;
+  {
+    base::AutoLock lock(module_lock_);
+
+    MapDevicePath(&info.image_file_name);
+    module_cache_.ModuleLoaded(process_id, time, module_info);
+    ++module_generation_;
+    preload = ShouldPreload(module_info);
+  }
+
+  // The module's base address takes us to its symbols, whether or not
+  // there's a symbol at it.
+  if (preload) {
+    base::AutoLock lock(resolution_lock_);
+    preloads_.push_back(Prefetch());
+    Prefetch& prefetch = preloads_.back();
+    prefetch.process_id_ = process_id;
+    prefetch.time_ = time;
+    prefetch.addresses_.push_back(module_info.base_address);
+
+    EnsureResolveTask();
+  }
+}
+
+bool SymbolLookupService::ShouldPreload(const ModuleInformation& module) {
+  module_lock_.AssertAcquired();
+  if (preload_names_.empty())
+    return false;
+
+  ModuleInformation build(module);
+  build.base_address = 0;
+  build.image_file_name = GetImageName(module.image_file_name);
+  if (preload_names_.find(build.image_file_name) == preload_names_.end())
+    return false;
+
+  return preloaded_modules_.insert(build).second;
+}
+
+void SymbolLookupService::MapDevicePath(std::wstring* path) {
+  DCHECK(path != NULL);
+  module_lock_.AssertAcquired();
+
+  if (MapDevicePathToKnownDrive(path))
+    return;
+
+  // The path may be on a drive that's appeared since we last looked.
+  static const wchar_t kDevicePrefix[] = L"\\Device\\";
+  if (path->compare(0, arraysize(kDevicePrefix) - 1, kDevicePrefix) != 0)
+    return;
+
+  UpdateDrivePaths();
+  MapDevicePathToKnownDrive(path);
+}
+
+bool SymbolLookupService::MapDevicePathToKnownDrive(std::wstring* path) {
+  DCHECK(path != NULL);
+  module_lock_.AssertAcquired();
+
+  DrivePaths::const_iterator it(drive_paths_.begin());
+  for (; it != drive_paths_.end(); ++it) {
+    const std::wstring& device_path = it->first;
+    if (path->size() > device_path.size() &&
+        (*path)[device_path.size()] == L'\\' &&
+        path->compare(0, device_path.size(), device_path) == 0) {
+      path->replace(0, device_path.size(), it->second);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void SymbolLookupService::UpdateDrivePaths() {
+  module_lock_.AssertAcquired();
+
+  drive_paths_.clear();
   DWORD drives = ::GetLogicalDrives();
-  char drive = 'A';
+  wchar_t drive = L'A';
   for (; drives != 0; drives >>= 1, ++drive) {
     if (drives & 1) {
       wchar_t device_path[1024] = {};
       wchar_t device[] = { drive, L':', L'\0' };
       if (::QueryDosDevice(device, device_path, arraysize(device_path)) &&
-          file_path.find(device_path) == 0) {
-        std::wstring new_path = device;
-        new_path += file_path.substr(wcslen(device_path));
-        file_path = new_path;
+          device_path[0] != L'\0') {
+        drive_paths_.push_back(std::make_pair(device_path, device));
       }
     }
   }
-
-  ModuleInformation& info = const_cast<ModuleInformation&>(module_info);
-  info.image_file_name = file_path;
-
-  base::AutoLock lock(module_lock_);
-
-  module_cache_.ModuleLoaded(process_id, time, module_info);
 }
 
-bool SymbolLookupService::ResolveAddressImpl(sym_util::ProcessId pid,
-                                             const base::Time& time,
-                                             sym_util::Address address,
-                                             sym_util::Symbol* symbol) {
+void SymbolLookupService::ResolveAddressesImpl(
+    sym_util::ProcessId pid,
+    const base::Time& time,
+    const std::vector<sym_util::Address>& addresses,
+    sym_util::SymbolLevel level,
+    std::vector<sym_util::SymbolRecord>* symbols) {
   DCHECK_EQ(background_thread_, base::MessageLoop::current());
-  using sym_util::ModuleCache;
-  using sym_util::SymbolCache;
-
-  ModuleCache::ModuleLoadStateId id;
-  SymbolCacheMap::iterator it;
+  DCHECK(symbols != NULL);
+  ScopedPerfTimer timer(&resolve_counter);
 
+  // The process and time only serve to find the modules and RVAs.
+  std::vector<sym_util::ModuleInformation> modules(addresses.size());
+  std::vector<bool> found(addresses.size());
   {
     // Hold the module lock only while accessing the module cache.
     base::AutoLock lock(module_lock_);
+    for (size_t i = 0; i < addresses.size(); ++i) {
+      found[i] = module_cache_.GetModuleForAddress(pid, time, addresses[i],
+                                                   &module_memo_,
+                                                   &modules[i]);
+    }
+  }
 
-    id = module_cache_.GetStateId(pid, time);
-    it = symbol_caches_.find(id);
-    if (it == symbol_caches_.end()) {
-      // We have a miss, initialize a cache for this module id.
-      if (symbol_caches_.size() == kMaxCacheSize) {
-        // Evict the least recently used element.
-        ModuleCache::ModuleLoadStateId to_evict = lru_module_id_.front();
-        lru_module_id_.erase(lru_module_id_.begin());
-        symbol_caches_.erase(to_evict);
+  symbols->clear();
+  symbols->resize(addresses.size());
+  bool resolved_any = false;
+  for (size_t i = 0; i < addresses.size(); ++i) {
+    if (!found[i])
+      continue;
+
+    // Symbols we have in memory are the cheapest, then those of modules
+    // we've seen in past sessions, which need no symbol cache, nor dbghelp.
+    sym_util::SymbolRecord& record = (*symbols)[i];
+    bool cached = module_symbols_.IsCached(modules[i], addresses[i], level);
+    if (!cached &&
+        !module_symbols_.CanResolveWithoutLoading(modules[i], addresses[i],
+                                                  level)) {
+      sym_util::Symbol symbol;
+      if (persistent_cache_.Lookup(modules[i], addresses[i], &symbol) &&
+          symbol.level >= level) {
+        symbol_strings_.Intern(symbol, &record);
+        module_symbols_.AddSymbol(modules[i], addresses[i], record);
+        continue;
       }
-
-      std::pair<SymbolCacheMap::iterator, bool> inserted =
-          symbol_caches_.insert(std::make_pair(id, SymbolCache()));
-
-      DCHECK_EQ(inserted.second, true);
-      SymbolCache& cache = inserted.first->second;
-      cache.set_status_callback(status_callback_);
-
-      std::vector<ModuleInformation> modules;
-      module_cache_.GetProcessModuleState(pid, time, &modules);
-      cache.SetSymbolPath(symbol_path_.c_str());
-      cache.Initialize(modules.size(), modules.size() ? &modules[0] : NULL);
-
-      it = inserted.first;
-    } else {
-      // We have a hit, manage the LRU by removing our ID.
-      // It will be pushed to the back of the LRU just below.
-      lru_module_id_.erase(
-          std::find(lru_module_id_.begin(), lru_module_id_.end(), id));
     }
-  }
 
-  // Push our id to the back of the lru list.
-  lru_module_id_.push_back(id);
+    // This can take a long time, so it's important not to
+    // hold the module lock over this operation.
+    if (!module_symbols_.GetSymbolForAddress(modules[i], addresses[i], level,
+                                             &record) || cached) {
+      continue;
+    }
 
-  DCHECK(it != symbol_caches_.end());
-  SymbolCache& cache = it->second;
+    // Keep what we resolved for the sessions to come.
+    resolved_any = true;
+    sym_util::Symbol symbol;
+    record.ToSymbol(&symbol);
+    persistent_cache_.Insert(modules[i], addresses[i], symbol);
+  }
 
-  // This can take a long time, so it's important not to
-  // hold the module lock over this operation.
-  bool ret = cache.GetSymbolForAddress(address, symbol);
+  ReportSymbolsUsage();
 
   // Clear the last status we posted.
-  if (!status_callback_.is_null())
+  if (resolved_any && !status_callback_.is_null())
     status_callback_.Run(L"Ready\r\n");
+}
+
+bool SymbolLookupService::CanResolveWithoutLoading(
+    const Request& request, sym_util::SymbolLevel level) {
+  DCHECK_EQ(background_thread_, base::MessageLoop::current());
+
+  base::AutoLock lock(module_lock_);
+  for (size_t i = 0; i < request.addresses_.size(); ++i) {
+    // Addresses outside any module don't resolve at all.
+    sym_util::ModuleInformation module;
+    if (module_cache_.GetModuleForAddress(request.process_id_,
+                                          request.time_,
+                                          request.addresses_[i],
+                                          &module_memo_,
+                                          &module) &&
+        !module_symbols_.CanResolveWithoutLoading(module,
+                                                  request.addresses_[i],
+                                                  level)) {
+      return false;
+    }
+  }
 
-  return ret;
+  return true;
 }
 
 void SymbolLookupService::ResolveCallback() {
   DCHECK_EQ(background_thread_, base::MessageLoop::current());
+  ScopedSawbuckTraceEvent trace("SymbolLookupService::ResolveCallback", this);
 
   while (true) {
-    Handle request_id;
+    Handle request_id = kInvalidHandle;
     Request request;
+    sym_util::SymbolLevel level = sym_util::SYMBOL_ALL;
 
-    // Find the next unresolved request.
+    // Find the next unresolved request. DbgHelp is single threaded, so
+    // while it loads one module's symbols, it can't look up any other.
+    // We therefore prefer requests that need no loading, so that a slow
+    // download doesn't hold up lookups in modules we already have.
     {
       base::AutoLock lock(resolution_lock_);
 
-      RequestMap::iterator it = requests_.lower_bound(unprocessed_id_);
-      if (it == requests_.end()) {
+      std::vector<RequestMap::iterator> pending;
+      RequestMap::iterator it = requests_.begin();
+      for (; it != requests_.end(); ++it) {
+        if (!it->second.done_)
+          pending.push_back(it);
+      }
+
+      size_t considered = std::min(pending.size(), kMaxRequestsConsidered);
+      std::partial_sort(pending.begin(), pending.begin() + considered,
+                        pending.end(), MoreUrgent());
+
+      size_t chosen = considered;
+      std::vector<sym_util::SymbolLevel> levels(considered);
+      for (size_t i = 0; i < considered; ++i) {
+        levels[i] = GetNextLevel(pending[i]->second);
+        if (CanResolveWithoutLoading(pending[i]->second, levels[i])) {
+          chosen = i;
+          break;
+        }
+      }
+
+      if (considered != 0) {
+        // Failing that, the most urgent request it is.
+        if (chosen == considered)
+          chosen = 0;
+
+        request_id = pending[chosen]->first;
+        request = pending[chosen]->second;
+        level = levels[chosen];
+      } else if (TakePrefetchAddresses(&request)) {
+        level = request.level_;
+      } else {
         // Null the task to signal we're exiting.
         resolve_task_ = ProcessingCallback();
         return;
       }
-
-      request_id = it->first;
-      request = it->second;
     }
 
     // Don't hold the lock over the symbol resolution proper.
-    sym_util::Symbol symbol;
-    ResolveAddressImpl(request.process_id_,
-                       request.time_,
-                       request.address_,
-                       &symbol);
+    std::vector<sym_util::SymbolRecord> symbols;
+    ResolveAddressesImpl(request.process_id_,
+                         request.time_,
+                         request.addresses_,
+                         level,
+                         &symbols);
+
+    // A prefetch has nobody to tell, the caches have its symbols now.
+    if (request_id == kInvalidHandle)
+      continue;
 
     // Store the result, mindfully of the fact that the request
     // might have been cancelled while we did the resolution.
@@ -223,16 +632,24 @@ void SymbolLookupService::ResolveCallback() {
 
       RequestMap::iterator it = requests_.find(request_id);
       if (it != requests_.end()) {
-        it->second.resolved_ = symbol;
-
-        if (callback_task_.is_null()) {
-          callback_task_ = base::Bind(&SymbolLookupService::IssueCallbacks,
-                                      base::Unretained(this));
-          foreground_thread_->PostTask(FROM_HERE, callback_task_);
+        Request& resolved = it->second;
+        if (!resolved.progress_callback_.is_null()) {
+          // Addresses that failed to resolve keep what the level before
+          // made of them, their modules at least.
+          DCHECK_EQ(symbols.size(), resolved.resolved_.size());
+          for (size_t i = 0; i < symbols.size(); ++i) {
+            if (symbols[i].module->empty())
+              symbols[i] = resolved.resolved_[i];
+          }
         }
-      }
 
-      unprocessed_id_ = request_id + 1;
+        resolved.resolved_.swap(symbols);
+        resolved.resolved_level_ = level;
+        resolved.done_ = level >= resolved.level_;
+        resolved.unreported_ = true;
+
+        EnsureCallbackTask();
+      }
     }
   }
 }
@@ -240,10 +657,134 @@ void SymbolLookupService::ResolveCallback() {
 void SymbolLookupService::SetSymbolPathCallback(const std::wstring& path) {
   DCHECK_EQ(background_thread_, base::MessageLoop::current());
 
-  symbol_path_ = path;
-  SymbolCacheMap::iterator it(symbol_caches_.begin());
-  for (; it != symbol_caches_.end(); ++it)
-    it->second.SetSymbolPath(symbol_path_.c_str());
+  module_symbols_.SetSymbolPath(path.c_str());
+  ReportSymbolsUsage();
+
+  // Addresses that failed to resolve may now succeed.
+  base::AutoLock lock(module_lock_);
+  ++module_generation_;
+}
+
+void SymbolLookupService::OpenPersistentCacheCallback(
+    const base::FilePath& path) {
+  DCHECK_EQ(background_thread_, base::MessageLoop::current());
+
+  // We carry on without, should the caches fail to open.
+  persistent_cache_.Open(path);
+  missing_symbols_.Open(path.AddExtension(L"missing"));
+}
+
+void SymbolLookupService::SetSymbolCacheBudgetCallback(uint64 budget) {
+  DCHECK_EQ(background_thread_, base::MessageLoop::current());
+
+  module_symbols_.set_max_loaded_size(budget);
+  ReportSymbolsUsage();
+}
+
+void SymbolLookupService::EvictSymbols(uint64 bytes) {
+  // The budget may be enforced before we have a thread to evict on, when
+  // there's nothing loaded to evict.
+  if (background_thread_ == NULL)
+    return;
+
+  background_thread_->PostTask(FROM_HERE,
+      base::Bind(&SymbolLookupService::EvictSymbolsCallback,
+                 base::Unretained(this),
+                 bytes));
+}
+
+void SymbolLookupService::EvictSymbolsCallback(uint64 bytes) {
+  DCHECK_EQ(background_thread_, base::MessageLoop::current());
+
+  module_symbols_.UnloadLeastRecentlyUsed(bytes);
+  ReportSymbolsUsage();
+}
+
+void SymbolLookupService::ReportSymbolsUsage() {
+  DCHECK_EQ(background_thread_, base::MessageLoop::current());
+
+  MemoryBudget::Get()->ReportUsage(memory_budget_id_,
+                                   module_symbols_.loaded_size());
+}
+
+void SymbolLookupService::ResolveAddressesNow(
+    const sym_util::ProcessId* process_ids, const base::Time* times,
+    const sym_util::Address* addresses, size_t num_addresses,
+    std::vector<sym_util::SymbolRecord>* symbols) {
+  DCHECK_NE(background_thread_, base::MessageLoop::current());
+  DCHECK(num_addresses == 0 ||
+         (process_ids != NULL && times != NULL && addresses != NULL));
+  DCHECK(symbols != NULL);
+
+  base::WaitableEvent done(false, false);
+  background_thread_->PostTask(FROM_HERE,
+      base::Bind(&SymbolLookupService::ResolveAddressesNowCallback,
+                 base::Unretained(this),
+                 process_ids,
+                 times,
+                 addresses,
+                 num_addresses,
+                 symbols,
+                 &done));
+  done.Wait();
+}
+
+size_t SymbolLookupService::GetModulesForAddresses(
+    sym_util::ProcessId process_id, const base::Time& time,
+    const sym_util::Address* addresses, size_t num_addresses,
+    std::vector<sym_util::ModuleInformation>* modules) {
+  DCHECK(num_addresses == 0 || addresses != NULL);
+  DCHECK(modules != NULL);
+
+  modules->clear();
+  modules->resize(num_addresses);
+
+  // The addresses share a process and time, so a memo of our own takes a
+  // single state lookup for all of them.
+  size_t found = 0;
+  sym_util::ModuleCache::StateIdMemo memo;
+  base::AutoLock lock(module_lock_);
+  for (size_t i = 0; i < num_addresses; ++i) {
+    if (module_cache_.GetModuleForAddress(process_id, time, addresses[i],
+                                          &memo, &(*modules)[i])) {
+      ++found;
+    } else {
+      (*modules)[i] = sym_util::ModuleInformation();
+    }
+  }
+
+  return found;
+}
+
+void SymbolLookupService::ResolveAddressesNowCallback(
+    const sym_util::ProcessId* process_ids, const base::Time* times,
+    const sym_util::Address* addresses, size_t num_addresses,
+    std::vector<sym_util::SymbolRecord>* symbols, base::WaitableEvent* done) {
+  DCHECK_EQ(background_thread_, base::MessageLoop::current());
+
+  symbols->clear();
+  symbols->reserve(num_addresses);
+
+  // Addresses in bulk tend to come sorted by process and time, so resolve
+  // each run of the same process and time together.
+  std::vector<sym_util::Address> run;
+  std::vector<sym_util::SymbolRecord> run_symbols;
+  size_t start = 0;
+  while (start < num_addresses) {
+    size_t end = start + 1;
+    while (end < num_addresses && process_ids[end] == process_ids[start] &&
+           times[end] == times[start]) {
+      ++end;
+    }
+
+    run.assign(addresses + start, addresses + end);
+    ResolveAddressesImpl(process_ids[start], times[start], run,
+                         sym_util::SYMBOL_ALL, &run_symbols);
+    symbols->insert(symbols->end(), run_symbols.begin(), run_symbols.end());
+    start = end;
+  }
+
+  done->Signal();
 }
 
 void SymbolLookupService::IssueCallbacks() {
@@ -251,12 +792,14 @@ void SymbolLookupService::IssueCallbacks() {
     Request request;
     Handle request_id;
 
-    // Find the lowest request that has been processed.
+    // Find the lowest request that has symbols to report.
     {
       base::AutoLock lock(resolution_lock_);
 
       RequestMap::iterator it = requests_.begin();
-      if (it == requests_.end() || it->first >= unprocessed_id_) {
+      while (it != requests_.end() && !it->second.unreported_)
+        ++it;
+      if (it == requests_.end()) {
         // Null the callback to signal we're exiting.
         callback_task_ = ProcessingCallback();
         return;
@@ -265,13 +808,33 @@ void SymbolLookupService::IssueCallbacks() {
       request_id = it->first;
       request = it->second;
 
-      requests_.erase(it);
+      // A progressive request stays until it's resolved in full.
+      if (request.done_)
+        requests_.erase(it);
+      else
+        it->second.unreported_ = false;
     }
 
-    request.callback_.Run(request.process_id_,
-                          request.time_,
-                          request.address_,
-                          request_id,
-                          request.resolved_);
+    if (!request.progress_callback_.is_null()) {
+      request.progress_callback_.Run(request.process_id_,
+                                     request.time_,
+                                     request_id,
+                                     request.addresses_,
+                                     request.resolved_,
+                                     request.done_);
+    } else if (!request.callback_.is_null()) {
+      DCHECK_EQ(1U, request.resolved_.size());
+      request.callback_.Run(request.process_id_,
+                            request.time_,
+                            request.addresses_[0],
+                            request_id,
+                            request.resolved_[0]);
+    } else {
+      request.batch_callback_.Run(request.process_id_,
+                                  request.time_,
+                                  request_id,
+                                  request.addresses_,
+                                  request.resolved_);
+    }
   }
 }
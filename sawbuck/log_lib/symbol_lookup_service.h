@@ -16,14 +16,21 @@
 #ifndef SAWBUCK_LOG_LIB_SYMBOL_LOOKUP_SERVICE_H_
 #define SAWBUCK_LOG_LIB_SYMBOL_LOOKUP_SERVICE_H_
 
+#include <deque>
+#include <set>
 #include <string>
 #include <vector>
 #include "base/callback.h"
+#include "base/files/file_path.h"
 #include "base/synchronization/lock.h"
 #include "base/time/time.h"
+#include "sawbuck/common/memory_budget.h"
 #include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/sym_util/missing_symbols_cache.h"
 #include "sawbuck/sym_util/module_cache.h"
-#include "sawbuck/sym_util/symbol_cache.h"
+#include "sawbuck/sym_util/module_symbol_cache.h"
+#include "sawbuck/sym_util/persistent_symbol_cache.h"
+#include "sawbuck/sym_util/symbol_string_table.h"
 
 class ISymbolLookupService {
  public:
@@ -36,11 +43,40 @@ class ISymbolLookupService {
                               base::Time,
                               sym_util::Address,
                               Handle,
-                              const sym_util::Symbol&)>
+                              const sym_util::SymbolRecord&)>
       SymbolResolvedCallback;
 
+  // Type of the batch resolution callback, which gets the addresses and
+  // their symbols in the order requested.
+  typedef base::Callback<void(sym_util::ProcessId,
+                              base::Time,
+                              Handle,
+                              const std::vector<sym_util::Address>&,
+                              const std::vector<sym_util::SymbolRecord>&)>
+      SymbolsResolvedCallback;
+
+  // Type of the progressive resolution callback, which gets the addresses
+  // and their symbols as far as they're resolved, each symbol's level
+  // telling how far. It's invoked once per level the request reaches, the
+  // last time with @p final set.
+  typedef base::Callback<void(sym_util::ProcessId,
+                              base::Time,
+                              Handle,
+                              const std::vector<sym_util::Address>&,
+                              const std::vector<sym_util::SymbolRecord>&,
+                              bool final)>
+      SymbolsProgressCallback;
+
+  // How urgent a request is. More urgent requests go first, and among
+  // requests of a priority, the earliest deadline goes first.
+  enum Priority {
+    PRIORITY_LOW,
+    PRIORITY_NORMAL,
+    PRIORITY_HIGH,
+  };
+
   // Enqueues an address resolution request for @p address in the context of
-  // @p process_id at @p time.
+  // @p process_id at @p time, which resolves the symbol in full.
   // @param process_id the process where @address was observed.
   // @param time the time when @p address was observed.
   // @param address the address to lookup.
@@ -52,23 +88,113 @@ class ISymbolLookupService {
                                 sym_util::Address address,
                                 const SymbolResolvedCallback& callback) = 0;
 
+  // Enqueues a resolution request for the @p num_addresses addresses at
+  // @p addresses, e.g. the frames of a stack trace, which are resolved
+  // together and reported in a single callback.
+  // @param process_id the process where the addresses were observed.
+  // @param time the time when the addresses were observed.
+  // @param level the least the symbols are resolved to, which should be
+  //    no more than the caller shows.
+  // @param callback a callback object which gets invoked when resolution
+  //    of all the addresses completes.
+  // @returns the request handle on success, or kInvalidHandle on error.
+  virtual Handle ResolveAddresses(sym_util::ProcessId process_id,
+                                  const base::Time& time,
+                                  const sym_util::Address* addresses,
+                                  size_t num_addresses,
+                                  sym_util::SymbolLevel level,
+                                  const SymbolsResolvedCallback& callback) = 0;
+
+  // Enqueues a resolution request for the @p num_addresses addresses at
+  // @p addresses, which reports their symbols level by level: the modules
+  // and module offsets at once, then the functions once their symbols are
+  // loaded, then the rest up to @p level. Levels that need no symbols
+  // loaded are skipped to. Addresses that fail to resolve at a level keep
+  // the symbols of the level before.
+  // @param process_id the process where the addresses were observed.
+  // @param time the time when the addresses were observed.
+  // @param level the least the symbols are resolved to in the end.
+  // @param priority the urgency of the request.
+  // @param deadline when the caller would like the symbols by, which
+  //    orders requests of the same priority. A null deadline goes last.
+  // @param callback a callback object which gets invoked at each level.
+  // @returns the request handle on success, or kInvalidHandle on error.
+  //    The handle may be cancelled until the final callback.
+  virtual Handle ResolveAddressesProgressively(
+      sym_util::ProcessId process_id,
+      const base::Time& time,
+      const sym_util::Address* addresses,
+      size_t num_addresses,
+      sym_util::SymbolLevel level,
+      Priority priority,
+      const base::TimeTicks& deadline,
+      const SymbolsProgressCallback& callback) = 0;
+
+  // Enqueues a best-effort resolution of the @p num_addresses addresses at
+  // @p addresses, which only serves to warm the symbol caches for a later
+  // request. Prefetches resolve the functions only. Prefetches yield to all
+  // other requests, and the most recent prefetch goes first.
+  // @param process_id the process where the addresses were observed.
+  // @param time the time when the addresses were observed.
+  virtual void PrefetchAddresses(sym_util::ProcessId process_id,
+                                 const base::Time& time,
+                                 const sym_util::Address* addresses,
+                                 size_t num_addresses) = 0;
+
+  // Resolves each of the @p num_addresses @p addresses, observed in
+  // @p process_ids at @p times, to @p symbols, and waits for it. This is
+  // for clients without a message loop, e.g. scripts resolving addresses
+  // in bulk, and for clients on threads of their own that would rather
+  // wait than call back. Addresses that fail to resolve get empty symbols.
+  // @note this must not be called on the thread that resolves symbols.
+  virtual void ResolveAddressesNow(
+      const sym_util::ProcessId* process_ids,
+      const base::Time* times,
+      const sym_util::Address* addresses,
+      size_t num_addresses,
+      std::vector<sym_util::SymbolRecord>* symbols) = 0;
+
+  // Looks up the modules containing the @p num_addresses @p addresses in
+  // @p process_id at @p time, from the module loads seen so far. This
+  // takes no symbols, and doesn't wait on symbol resolution.
+  // @param modules receives a module per address, with an empty image
+  //     file name for any address outside of the modules.
+  // @returns the number of addresses found in a module.
+  virtual size_t GetModulesForAddresses(
+      sym_util::ProcessId process_id,
+      const base::Time& time,
+      const sym_util::Address* addresses,
+      size_t num_addresses,
+      std::vector<sym_util::ModuleInformation>* modules) = 0;
+
   // Cancel a pending async symbol resolution request.
   // @param request_handle a request handle previously returned from
-  //    ResolveAddress, whose callback has not yet been invoked.
+  //    ResolveAddress, ResolveAddresses or ResolveAddressesProgressively,
+  //    whose final callback has not yet been invoked.
   virtual void CancelRequest(Handle request_handle) = 0;
 
   // Change the symbol path to @p symbol_path.
   virtual void SetSymbolPath(const wchar_t* symbol_path) = 0;
+
+  // @returns a count of the module loads and unloads, and symbol path
+  //    changes, seen so far. Addresses resolve alike while it stays the
+  //    same, so clients may hold on to resolutions made under it.
+  virtual int GetModuleGeneration() = 0;
 };
 
 // Fwd.
-namespace base { class MessageLoop; }
+namespace base {
+class MessageLoop;
+class WaitableEvent;
+}  // namespace base
 
 // The symbol lookup service class knows how to sink the NT kernel log's
 // module events, and to subsequently service {pid,time,address}->symbol
-// queries on the processes it's heard of.
+// queries on the processes it's heard of. It sinks the process events too,
+// to compact the module history of the processes that have ended.
 class SymbolLookupService
     : public ISymbolLookupService,
+      public KernelProcessEvents,
       public KernelModuleEvents {
  public:
   SymbolLookupService();
@@ -77,6 +203,7 @@ class SymbolLookupService
   typedef base::Callback<void(const wchar_t*)> StatusCallback;
   void set_status_callback(const StatusCallback& status_callback) {
     status_callback_ = status_callback;
+    module_symbols_.set_status_callback(status_callback);
   }
 
   // Accessors for our background thread message loop.
@@ -86,13 +213,80 @@ class SymbolLookupService
     background_thread_ = background_thread;
   }
 
+  // Opens the on-disk symbol cache at @p path, which then serves the
+  // symbols of modules we've seen before, and keeps those we resolve.
+  // The modules the symbol path has no symbols for are kept beside it.
+  // Note: the cache is opened on the background thread.
+  void OpenPersistentCache(const base::FilePath& path);
+
+  // Sets the modules whose symbols we load as soon as one appears in the
+  // kernel log, rather than on first lookup, which can take a while for
+  // a large PDB off a symbol server.
+  // @param image_names the file names of the modules, without directory,
+  //     in any case. Empty turns preloading off.
+  void SetPreloadModules(const std::vector<std::wstring>& image_names);
+
+  // Sets the most memory the loaded symbols may take to @p budget bytes.
+  // The least recently used modules' symbols are unloaded to stay in it.
+  // The loaded symbols also count against the process's memory budget,
+  // which may unload them sooner.
+  void SetSymbolCacheBudget(uint64 budget);
+
+  // The tallies of the lookups that went past the persistent cache.
+  // @note these are updated on the background thread, and may only be
+  //     read while it's idle.
+  const sym_util::ModuleSymbolCache::Stats& symbol_stats() const {
+    return module_symbols_.stats();
+  }
+
   // ISymboLookupService implementation.
   virtual Handle ResolveAddress(sym_util::ProcessId process_id,
                                 const base::Time& time,
                                 sym_util::Address address,
                                 const SymbolResolvedCallback& callback);
+  virtual Handle ResolveAddresses(sym_util::ProcessId process_id,
+                                  const base::Time& time,
+                                  const sym_util::Address* addresses,
+                                  size_t num_addresses,
+                                  sym_util::SymbolLevel level,
+                                  const SymbolsResolvedCallback& callback);
+  virtual Handle ResolveAddressesProgressively(
+      sym_util::ProcessId process_id,
+      const base::Time& time,
+      const sym_util::Address* addresses,
+      size_t num_addresses,
+      sym_util::SymbolLevel level,
+      Priority priority,
+      const base::TimeTicks& deadline,
+      const SymbolsProgressCallback& callback);
+  virtual void PrefetchAddresses(sym_util::ProcessId process_id,
+                                 const base::Time& time,
+                                 const sym_util::Address* addresses,
+                                 size_t num_addresses);
+  virtual void ResolveAddressesNow(
+      const sym_util::ProcessId* process_ids,
+      const base::Time* times,
+      const sym_util::Address* addresses,
+      size_t num_addresses,
+      std::vector<sym_util::SymbolRecord>* symbols);
+  virtual size_t GetModulesForAddresses(
+      sym_util::ProcessId process_id,
+      const base::Time& time,
+      const sym_util::Address* addresses,
+      size_t num_addresses,
+      std::vector<sym_util::ModuleInformation>* modules);
   virtual void CancelRequest(Handle request_handle);
   virtual void SetSymbolPath(const wchar_t* symbol_path);
+  virtual int GetModuleGeneration();
+
+  // KernelProcessEvents implementation.
+  virtual void OnProcessIsRunning(const base::Time& time,
+                                  const ProcessInfo& process_info);
+  virtual void OnProcessStarted(const base::Time& time,
+                                const ProcessInfo& process_info);
+  virtual void OnProcessEnded(const base::Time& time,
+                              const ProcessInfo& process_info,
+                              ULONG exit_status);
 
   // KernelModuleEvents implementation.
   virtual void OnModuleIsLoaded(DWORD process_id,
@@ -106,36 +300,158 @@ class SymbolLookupService
                             const ModuleInformation& module_info);
 
  private:
-  virtual bool ResolveAddressImpl(sym_util::ProcessId process_id,
-                                  const base::Time& time,
-                                  sym_util::Address address,
-                                  sym_util::Symbol* symbol);
+  struct Request;
+
+  // Enqueues @p request, whose callbacks and addresses are set.
+  // @returns the request handle.
+  Handle EnqueueRequest(const Request& request);
+
+  // Orders pending requests by urgency, most urgent first.
+  struct MoreUrgent;
+
+  // @returns the level to resolve the pending @p request to next.
+  sym_util::SymbolLevel GetNextLevel(const Request& request);
+
+  // Gets the modules and module offsets of @p addresses in @p process_id
+  // at @p time to @p symbols, at SYMBOL_MODULE, leaving the symbols of
+  // addresses outside any module empty.
+  void GetModuleSymbols(sym_util::ProcessId process_id,
+                        const base::Time& time,
+                        const std::vector<sym_util::Address>& addresses,
+                        std::vector<sym_util::SymbolRecord>* symbols);
+
+  // Posts the callback task, unless it's pending or running already.
+  // @pre resolution_lock_ is held.
+  void EnsureCallbackTask();
+
+  // Posts the resolve task, unless it's pending or running already.
+  // @pre resolution_lock_ is held.
+  void EnsureResolveTask();
+
+  // Takes the next few prefetch addresses to @p request, or failing that
+  // the next preload.
+  // @returns false if there are none.
+  // @pre resolution_lock_ is held.
+  bool TakePrefetchAddresses(Request* request);
+
+  // @returns true iff @p module is to be preloaded, and hasn't been yet.
+  // @pre module_lock_ is held.
+  bool ShouldPreload(const ModuleInformation& module);
+
+  // Maps the device path @p path, as the kernel logs them, to a drive path
+  // in place. Paths on no drive are left alone.
+  // @pre module_lock_ is held.
+  void MapDevicePath(std::wstring* path);
+  // Does the mapping with the drives we know of.
+  // @returns true iff @p path is on one of them.
+  // @pre module_lock_ is held.
+  bool MapDevicePathToKnownDrive(std::wstring* path);
+  // Queries the device paths of the present drives anew.
+  // @pre module_lock_ is held.
+  void UpdateDrivePaths();
+
+  // Resolves @p addresses in @p process_id at @p time to @p symbols, at
+  // least to @p level, leaving the symbols of addresses that fail to
+  // resolve empty.
+  virtual void ResolveAddressesImpl(
+      sym_util::ProcessId process_id,
+      const base::Time& time,
+      const std::vector<sym_util::Address>& addresses,
+      sym_util::SymbolLevel level,
+      std::vector<sym_util::SymbolRecord>* symbols);
 
   void SetSymbolPathCallback(const std::wstring& path);
+  void OpenPersistentCacheCallback(const base::FilePath& path);
+  void SetSymbolCacheBudgetCallback(uint64 budget);
+  // Invoked by the memory budget to free @p bytes of the loaded symbols,
+  // which posts EvictSymbolsCallback to the background thread.
+  void EvictSymbols(uint64 bytes);
+  void EvictSymbolsCallback(uint64 bytes);
+  // Reports the memory the loaded symbols take to the memory budget.
+  void ReportSymbolsUsage();
+  void ResolveAddressesNowCallback(const sym_util::ProcessId* process_ids,
+                                   const base::Time* times,
+                                   const sym_util::Address* addresses,
+                                   size_t num_addresses,
+                                   std::vector<sym_util::SymbolRecord>* symbols,
+                                   base::WaitableEvent* done);
   void ResolveCallback();
   void IssueCallbacks();
 
+  // @returns true iff all the addresses of @p request resolve to @p level
+  //     without loading symbols.
+  bool CanResolveWithoutLoading(const Request& request,
+                                sym_util::SymbolLevel level);
+
+  // Requests that need symbols loaded, which can take minutes when they
+  // come off a symbol server, yield to those that don't, among this many
+  // of the most urgent pending requests.
+  static const size_t kMaxRequestsConsidered = 32;
+
+  // The most prefetches we keep, the oldest make way for new ones, as they
+  // are for rows that have likely scrolled by.
+  static const size_t kMaxPrefetches = 16;
+  // The most prefetch addresses we resolve between checks for requests.
+  static const size_t kPrefetchChunkSize = 8;
+
   base::Lock module_lock_;
   sym_util::ModuleCache module_cache_;  // Under module_lock_.
+  // The last state the background thread looked up, which the frames of
+  // a stack, and the stacks of a process, mostly share.
+  sym_util::ModuleCache::StateIdMemo module_memo_;  // Under module_lock_.
+  // Bumped on every change to module_cache_ or the symbol path.
+  int module_generation_;  // Under module_lock_.
+
+  // The lower case file names of the modules to preload.
+  std::set<std::wstring> preload_names_;  // Under module_lock_.
+  // The modules we've preloaded, by their file name and build, without
+  // base address.
+  std::set<ModuleInformation> preloaded_modules_;  // Under module_lock_.
+  // The device paths of the drives, and the drives as "X:". Drives come
+  // and go rarely, so we query them only when a path fails to map.
+  typedef std::vector<std::pair<std::wstring, std::wstring> > DrivePaths;
+  DrivePaths drive_paths_;  // Under module_lock_.
+
+  // The strings of the symbols we hand out, which stay valid for our
+  // lifetime, so that clients can hold on to symbol records.
+  sym_util::SymbolStringTable symbol_strings_;
 
-  // We keep a cache of symbol cache instances keyed on module
-  // load state id with an lru replacement policy.
-  typedef std::map<sym_util::ModuleCache::ModuleLoadStateId,
-      sym_util::SymbolCache> SymbolCacheMap;
-  static const size_t kMaxCacheSize = 10;
-  typedef std::vector<sym_util::ModuleCache::ModuleLoadStateId>
-      LoadStateVector;
-  LoadStateVector lru_module_id_;
-  SymbolCacheMap symbol_caches_;
-  std::wstring symbol_path_;
+  // The symbols we've resolved, by module and RVA, shared by all
+  // processes. The module cache maps an address to its module and RVA.
+  // Only accessed on the background thread.
+  sym_util::ModuleSymbolCache module_symbols_;
+
+  // Our share of the process's memory budget, for module_symbols_.
+  MemoryBudget::ConsumerId memory_budget_id_;
+
+  // Symbols resolved in this and past sessions, consulted before the
+  // module symbols. Only accessed on the background thread.
+  sym_util::PersistentSymbolCache persistent_cache_;
+  // The modules without symbols in this and past sessions, which
+  // module_symbols_ spares the symbol servers for. Only accessed on the
+  // background thread.
+  sym_util::MissingSymbolsCache missing_symbols_;
 
   base::Lock resolution_lock_;
   struct Request {
     sym_util::ProcessId process_id_;
     base::Time time_;
-    sym_util::Address address_;
+    std::vector<sym_util::Address> addresses_;
+    sym_util::SymbolLevel level_;
+    Priority priority_;
+    base::TimeTicks deadline_;
+    // Exactly one of these is set, the first for a single address.
     SymbolResolvedCallback callback_;
-    sym_util::Symbol resolved_;
+    SymbolsResolvedCallback batch_callback_;
+    SymbolsProgressCallback progress_callback_;
+    std::vector<sym_util::SymbolRecord> resolved_;
+    // The level resolved_ is at, SYMBOL_MODULE for a progressive request
+    // before the background thread gets to it.
+    sym_util::SymbolLevel resolved_level_;
+    // True once resolved_ is at level_.
+    bool done_;
+    // True while resolved_ holds symbols not yet called back with.
+    bool unreported_;
   };
   // Under resolution_lock_.
   typedef std::map<Handle, Request> RequestMap;
@@ -144,8 +460,17 @@ class SymbolLookupService
   RequestMap requests_;
   // Next request id issued.
   Handle next_request_id_;  // Under resolution_lock_.
-  // The id of the largest-id unprocessed request.
-  Handle unprocessed_id_;  // Under resolution_lock_.
+
+  // Pending prefetches, most recent last.
+  struct Prefetch {
+    sym_util::ProcessId process_id_;
+    base::Time time_;
+    std::vector<sym_util::Address> addresses_;
+  };
+  std::deque<Prefetch> prefetches_;  // Under resolution_lock_.
+  // Pending preloads, each for the base of a module, oldest first. These
+  // go after the prefetches, as they're for no particular row.
+  std::deque<Prefetch> preloads_;  // Under resolution_lock_.
 
   // Invoked on the worker thread on status changes.
   StatusCallback status_callback_;
@@ -19,6 +19,8 @@
 #include <tlhelp32.h>
 #include "base/bind.h"
 #include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/synchronization/waitable_event.h"
 #include "base/threading/thread.h"
 #include "base/win/pe_image.h"
 #include "base/win/scoped_handle.h"
@@ -36,7 +38,8 @@ void QuitMessageLoop(base::MessageLoop* loop) {
 
 class SymbolLookupServiceTest: public testing::Test {
  public:
-  SymbolLookupServiceTest() : background_thread_("Background Thread") {
+  SymbolLookupServiceTest()
+      : final_(false), background_thread_("Background Thread") {
   }
 
   virtual void SetUp() {
@@ -102,8 +105,40 @@ class SymbolLookupServiceTest: public testing::Test {
     resolved_.push_back(handle);
   }
 
+  void TraceProgress(sym_util::ProcessId pid, base::Time time,
+      SymbolLookupService::Handle handle,
+      const std::vector<sym_util::Address>& addresses,
+      const std::vector<sym_util::SymbolRecord>& symbols, bool final) {
+    EXPECT_EQ(&message_loop_, base::MessageLoop::current());
+    EXPECT_FALSE(final_) << "Called back after the final callback.";
+    EXPECT_EQ(addresses.size(), symbols.size());
+
+    progress_.push_back(symbols);
+    final_ = final;
+  }
+
+  // Holds up the background thread until @p event is signaled.
+  void BlockBackgroundThread(base::WaitableEvent* event) {
+    background_thread_.message_loop()->PostTask(FROM_HERE,
+        base::Bind(&base::WaitableEvent::Wait, base::Unretained(event)));
+  }
+
+  SymbolLookupService::Handle ResolveFooProgressively() {
+    const sym_util::Address addresses[] = {
+        reinterpret_cast<sym_util::Address>(&Foo), 0 };
+    return service_.ResolveAddressesProgressively(
+        ::GetCurrentProcessId(), base::Time::Now(), addresses,
+        arraysize(addresses), sym_util::SYMBOL_LINE,
+        ISymbolLookupService::PRIORITY_HIGH, base::TimeTicks::Now(),
+        base::Bind(&SymbolLookupServiceTest::TraceProgress,
+                   base::Unretained(this)));
+  }
+
  protected:
   std::vector<SymbolLookupService::Handle> resolved_;
+  // The symbols of each progress callback, and whether the last was final.
+  std::vector<std::vector<sym_util::SymbolRecord> > progress_;
+  bool final_;
 
   base::MessageLoop message_loop_;
   base::Thread background_thread_;
@@ -168,4 +203,104 @@ TEST_F(SymbolLookupServiceTest, LookupFooCancel) {
   ASSERT_EQ(5, resolved_.size());
 }
 
+TEST_F(SymbolLookupServiceTest, ResolveAddressesNow) {
+  LoadModules();
+
+  // Two runs of the same process and time, and one address that's in no
+  // module of the process it's looked up in.
+  base::Time now(base::Time::Now());
+  sym_util::ProcessId pid = ::GetCurrentProcessId();
+  const sym_util::ProcessId process_ids[] = { pid, pid, pid, pid + 1 };
+  const base::Time times[] = {
+      now, now, now + base::TimeDelta::FromSeconds(1), now };
+  sym_util::Address foo = reinterpret_cast<sym_util::Address>(&Foo);
+  const sym_util::Address addresses[] = { foo, foo, foo, foo };
+
+  std::vector<sym_util::SymbolRecord> symbols;
+  service_.ResolveAddressesNow(process_ids, times, addresses,
+                               arraysize(addresses), &symbols);
+
+  ASSERT_EQ(arraysize(addresses), symbols.size());
+  for (size_t i = 0; i < 3; ++i)
+    EXPECT_PRED_FORMAT2(testing::IsSubstring, L"Foo", *symbols[i].name);
+  EXPECT_STREQ(L"", symbols[3].name->c_str());
+}
+
+TEST_F(SymbolLookupServiceTest, ResolveProgressively) {
+  LoadModules();
+
+  // The modules come without the background thread.
+  base::WaitableEvent go(false, false);
+  BlockBackgroundThread(&go);
+  ASSERT_NE(SymbolLookupService::kInvalidHandle, ResolveFooProgressively());
+
+  base::RunLoop().RunUntilIdle();
+  ASSERT_EQ(1U, progress_.size());
+  EXPECT_FALSE(final_);
+  ASSERT_EQ(2U, progress_[0].size());
+  const sym_util::SymbolRecord& module = progress_[0][0];
+  EXPECT_EQ(sym_util::SYMBOL_MODULE, module.level);
+  EXPECT_PRED_FORMAT2(testing::IsSubstring, L".exe", *module.module);
+  EXPECT_EQ(reinterpret_cast<sym_util::Address>(&Foo) - module.module_base,
+            module.offset);
+  EXPECT_STREQ(L"", module.name->c_str());
+  // Nothing is at address zero.
+  EXPECT_STREQ(L"", progress_[0][1].module->c_str());
+
+  go.Signal();
+  ResolveAll();
+
+  ASSERT_LE(2U, progress_.size());
+  EXPECT_TRUE(final_);
+  const sym_util::SymbolRecord& symbol = progress_.back()[0];
+  EXPECT_LE(sym_util::SYMBOL_LINE, symbol.level);
+  EXPECT_PRED_FORMAT2(testing::IsSubstring, L"Foo", *symbol.name);
+  EXPECT_STREQ(L"", progress_.back()[1].module->c_str());
+}
+
+TEST_F(SymbolLookupServiceTest, ResolveProgressivelyCancel) {
+  LoadModules();
+
+  base::WaitableEvent go(false, false);
+  BlockBackgroundThread(&go);
+  SymbolLookupService::Handle h = ResolveFooProgressively();
+  ASSERT_NE(SymbolLookupService::kInvalidHandle, h);
+
+  // A request may be cancelled between its levels.
+  base::RunLoop().RunUntilIdle();
+  ASSERT_EQ(1U, progress_.size());
+  service_.CancelRequest(h);
+
+  go.Signal();
+  ResolveAll();
+
+  EXPECT_EQ(1U, progress_.size());
+  EXPECT_FALSE(final_);
+}
+
+TEST_F(SymbolLookupServiceTest, GetModulesForAddresses) {
+  sym_util::ProcessId pid = ::GetCurrentProcessId();
+  base::Time now(base::Time::Now());
+  const sym_util::Address addresses[] = {
+      reinterpret_cast<sym_util::Address>(&Foo), 0 };
+
+  std::vector<sym_util::ModuleInformation> modules;
+  EXPECT_EQ(0, service_.GetModulesForAddresses(pid, now, addresses,
+                                               arraysize(addresses),
+                                               &modules));
+  ASSERT_EQ(arraysize(addresses), modules.size());
+  EXPECT_TRUE(modules[0].image_file_name.empty());
+
+  // Foo is in the test executable, and nothing is at address zero.
+  LoadModules();
+  EXPECT_EQ(1, service_.GetModulesForAddresses(pid, now, addresses,
+                                               arraysize(addresses),
+                                               &modules));
+  ASSERT_EQ(arraysize(addresses), modules.size());
+  EXPECT_PRED_FORMAT2(testing::IsSubstring, L".exe",
+                      modules[0].image_file_name);
+  EXPECT_LE(modules[0].base_address, addresses[0]);
+  EXPECT_TRUE(modules[1].image_file_name.empty());
+}
+
 }  // namespace
@@ -0,0 +1,340 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Generic event decoder implementation.
+#include "sawbuck/log_lib/tdh_event_decoder.h"
+
+#include <tdh.h>
+#include <algorithm>
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+
+namespace {
+
+// Appends the value of type @p T at @p data to @p text, as @p format
+// renders it after conversion to @p Printed.
+template <typename T, typename Printed>
+void AppendValue(const uint8* data, const char* format, std::string* text) {
+  T value;
+  memcpy(&value, data, sizeof(value));
+  base::StringAppendF(text, format, static_cast<Printed>(value));
+}
+
+}  // namespace
+
+// Gets the event schemas from TDH, which knows those of the manifests and
+// MOF classes registered on this machine.
+class TdhEventDecoder::TdhSchemaSource : public TdhEventDecoder::SchemaSource {
+ public:
+  virtual bool GetSchema(const EVENT_TRACE* event, Schema* schema);
+
+ private:
+  // Maps a TDH input type to ours.
+  // @returns false if we don't render the type.
+  static bool GetPropertyType(USHORT in_type, PropertyType* type);
+
+  std::vector<uint8> buffer_;
+};
+
+bool TdhEventDecoder::TdhSchemaSource::GetSchema(const EVENT_TRACE* event,
+                                                 Schema* schema) {
+  DCHECK(event != NULL);
+  DCHECK(schema != NULL);
+
+  // Classic consumers get the events as EVENT_TRACE, which TDH takes
+  // as an EVENT_RECORD with a classic header.
+  EVENT_RECORD record = {};
+  record.EventHeader.Flags = EVENT_HEADER_FLAG_CLASSIC_HEADER;
+  record.EventHeader.ProviderId = event->Header.Guid;
+  record.EventHeader.EventDescriptor.Opcode = event->Header.Class.Type;
+  record.EventHeader.EventDescriptor.Version = event->Header.Class.Version;
+  record.EventHeader.EventDescriptor.Level = event->Header.Class.Level;
+  record.EventHeader.ProcessId = event->Header.ProcessId;
+  record.EventHeader.ThreadId = event->Header.ThreadId;
+  record.UserData = event->MofData;
+  record.UserDataLength = static_cast<USHORT>(event->MofLength);
+
+  ULONG size = static_cast<ULONG>(buffer_.size());
+  TRACE_EVENT_INFO* info = NULL;
+  ULONG error = ERROR_INSUFFICIENT_BUFFER;
+  while (error == ERROR_INSUFFICIENT_BUFFER) {
+    buffer_.resize(std::max(size, static_cast<ULONG>(sizeof(*info))));
+    info = reinterpret_cast<TRACE_EVENT_INFO*>(&buffer_[0]);
+    size = static_cast<ULONG>(buffer_.size());
+    error = ::TdhGetEventInformation(&record, 0, NULL, info, &size);
+  }
+  if (error != ERROR_SUCCESS)
+    return false;
+
+  schema->clear();
+  const uint8* base = reinterpret_cast<const uint8*>(info);
+  for (ULONG i = 0; i < info->TopLevelPropertyCount; ++i) {
+    const EVENT_PROPERTY_INFO& property_info = info->EventPropertyInfoArray[i];
+
+    // Structures, arrays and properties sized by other properties would
+    // need more than a type to lay out, and we stop short of them.
+    const ULONG kUnsupportedFlags =
+        PropertyStruct | PropertyParamLength | PropertyParamCount;
+    if ((property_info.Flags & kUnsupportedFlags) != 0 ||
+        property_info.count != 1) {
+      break;
+    }
+
+    Property property;
+    if (!GetPropertyType(property_info.nonStructType.InType, &property.type))
+      break;
+
+    // Strings of a fixed length aren't zero-terminated.
+    if (GetPropertySize(property.type) == 0 && property_info.length != 0)
+      break;
+
+    property.name = base::WideToUTF8(
+        reinterpret_cast<const wchar_t*>(base + property_info.NameOffset));
+    schema->push_back(property);
+  }
+
+  return true;
+}
+
+bool TdhEventDecoder::TdhSchemaSource::GetPropertyType(USHORT in_type,
+                                                       PropertyType* type) {
+  DCHECK(type != NULL);
+
+  switch (in_type) {
+    case TDH_INTYPE_INT8: *type = TYPE_INT8; return true;
+    case TDH_INTYPE_UINT8: *type = TYPE_UINT8; return true;
+    case TDH_INTYPE_INT16: *type = TYPE_INT16; return true;
+    case TDH_INTYPE_UINT16: *type = TYPE_UINT16; return true;
+    case TDH_INTYPE_INT32: *type = TYPE_INT32; return true;
+    case TDH_INTYPE_UINT32: *type = TYPE_UINT32; return true;
+    case TDH_INTYPE_INT64: *type = TYPE_INT64; return true;
+    case TDH_INTYPE_UINT64: *type = TYPE_UINT64; return true;
+    case TDH_INTYPE_HEXINT32: *type = TYPE_HEX_INT32; return true;
+    case TDH_INTYPE_HEXINT64: *type = TYPE_HEX_INT64; return true;
+    case TDH_INTYPE_FLOAT: *type = TYPE_FLOAT; return true;
+    case TDH_INTYPE_DOUBLE: *type = TYPE_DOUBLE; return true;
+    case TDH_INTYPE_BOOLEAN: *type = TYPE_BOOLEAN; return true;
+    case TDH_INTYPE_GUID: *type = TYPE_GUID; return true;
+    case TDH_INTYPE_UNICODESTRING: *type = TYPE_UNICODE_STRING; return true;
+    case TDH_INTYPE_ANSISTRING: *type = TYPE_ANSI_STRING; return true;
+    default: return false;
+  }
+}
+
+bool TdhEventDecoder::SchemaKey::operator<(const SchemaKey& o) const {
+  int cmp = memcmp(&provider, &o.provider, sizeof(provider));
+  if (cmp != 0)
+    return cmp < 0;
+  if (type != o.type)
+    return type < o.type;
+  return version < o.version;
+}
+
+TdhEventDecoder::TdhEventDecoder(SchemaSource* schema_source)
+    : schema_source_(schema_source) {
+  if (schema_source_ == NULL) {
+    tdh_schema_source_.reset(new TdhSchemaSource());
+    schema_source_ = tdh_schema_source_.get();
+  }
+}
+
+TdhEventDecoder::~TdhEventDecoder() {
+}
+
+bool TdhEventDecoder::Decode(const EVENT_TRACE* event, std::string* text) {
+  DCHECK(event != NULL);
+
+  const CachedSchema& schema = GetSchema(event);
+  if (!schema.valid)
+    return false;
+  if (text == NULL)
+    return true;
+
+  text->clear();
+  const uint8* data = reinterpret_cast<const uint8*>(event->MofData);
+  size_t length = event->MofLength;
+  size_t offset = 0;
+  for (size_t i = 0; i < schema.properties.size(); ++i) {
+    const Property& property = schema.properties[i];
+    if (i != 0)
+      text->push_back(' ');
+    text->append(property.name);
+    text->push_back('=');
+
+    size_t size = RenderProperty(property.type, data + offset,
+                                 length - offset, text);
+    if (size == 0) {
+      text->append("...");
+      break;
+    }
+    offset += size;
+  }
+
+  return true;
+}
+
+size_t TdhEventDecoder::GetPropertySize(PropertyType type) {
+  switch (type) {
+    case TYPE_INT8:
+    case TYPE_UINT8:
+      return 1;
+
+    case TYPE_INT16:
+    case TYPE_UINT16:
+      return 2;
+
+    case TYPE_INT32:
+    case TYPE_UINT32:
+    case TYPE_HEX_INT32:
+    case TYPE_FLOAT:
+    case TYPE_BOOLEAN:
+      return 4;
+
+    case TYPE_INT64:
+    case TYPE_UINT64:
+    case TYPE_HEX_INT64:
+    case TYPE_DOUBLE:
+      return 8;
+
+    case TYPE_GUID:
+      return sizeof(GUID);
+
+    default:
+      return 0;
+  }
+}
+
+const TdhEventDecoder::CachedSchema& TdhEventDecoder::GetSchema(
+    const EVENT_TRACE* event) {
+  SchemaKey key = {};
+  key.provider = event->Header.Guid;
+  key.type = event->Header.Class.Type;
+  key.version = event->Header.Class.Version;
+
+  SchemaMap::iterator it(schemas_.find(key));
+  if (it != schemas_.end())
+    return it->second;
+
+  CachedSchema& schema = schemas_[key];
+  schema.valid = schema_source_->GetSchema(event, &schema.properties);
+  return schema;
+}
+
+size_t TdhEventDecoder::RenderProperty(PropertyType type,
+                                       const uint8* data,
+                                       size_t length,
+                                       std::string* text) {
+  DCHECK(text != NULL);
+
+  size_t size = GetPropertySize(type);
+  if (size > length)
+    return 0;
+
+  switch (type) {
+    case TYPE_INT8:
+      AppendValue<int8, int>(data, "%d", text);
+      break;
+    case TYPE_UINT8:
+      AppendValue<uint8, unsigned int>(data, "%u", text);
+      break;
+    case TYPE_INT16:
+      AppendValue<int16, int>(data, "%d", text);
+      break;
+    case TYPE_UINT16:
+      AppendValue<uint16, unsigned int>(data, "%u", text);
+      break;
+    case TYPE_INT32:
+      AppendValue<int32, int>(data, "%d", text);
+      break;
+    case TYPE_UINT32:
+      AppendValue<uint32, unsigned int>(data, "%u", text);
+      break;
+    case TYPE_INT64:
+      AppendValue<int64, long long>(data, "%lld", text);
+      break;
+    case TYPE_UINT64:
+      AppendValue<uint64, unsigned long long>(data, "%llu", text);
+      break;
+    case TYPE_HEX_INT32:
+      AppendValue<uint32, unsigned int>(data, "0x%X", text);
+      break;
+    case TYPE_HEX_INT64:
+      AppendValue<uint64, unsigned long long>(data, "0x%llX", text);
+      break;
+    case TYPE_FLOAT:
+      AppendValue<float, double>(data, "%g", text);
+      break;
+    case TYPE_DOUBLE:
+      AppendValue<double, double>(data, "%g", text);
+      break;
+
+    case TYPE_BOOLEAN: {
+      BOOL value = FALSE;
+      memcpy(&value, data, sizeof(value));
+      text->append(value ? "true" : "false");
+      break;
+    }
+
+    case TYPE_GUID: {
+      GUID guid = {};
+      memcpy(&guid, data, sizeof(guid));
+      base::StringAppendF(text,
+          "{%08lX-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}",
+          static_cast<unsigned long>(guid.Data1), guid.Data2, guid.Data3,
+          guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3],
+          guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7]);
+      break;
+    }
+
+    case TYPE_UNICODE_STRING: {
+      // Event data is packed, so the string may well be misaligned.
+      size_t max_len = length / sizeof(wchar_t);
+      size_t len = 0;
+      for (; len < max_len; ++len) {
+        wchar_t c = L'\0';
+        memcpy(&c, data + len * sizeof(c), sizeof(c));
+        if (c == L'\0')
+          break;
+      }
+      if (len == max_len)
+        return 0;
+
+      std::wstring str(len, L'\0');
+      if (len != 0)
+        memcpy(&str[0], data, len * sizeof(wchar_t));
+      text->append(base::WideToUTF8(str));
+      size = (len + 1) * sizeof(wchar_t);
+      break;
+    }
+
+    case TYPE_ANSI_STRING: {
+      const char* str = reinterpret_cast<const char*>(data);
+      const void* end = memchr(str, '\0', length);
+      if (end == NULL)
+        return 0;
+
+      size_t len = reinterpret_cast<const char*>(end) - str;
+      text->append(str, len);
+      size = len + 1;
+      break;
+    }
+
+    default:
+      NOTREACHED() << "Unknown property type";
+      return 0;
+  }
+
+  return size;
+}
@@ -0,0 +1,134 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Generic event decoder declaration.
+#ifndef SAWBUCK_LOG_LIB_TDH_EVENT_DECODER_H_
+#define SAWBUCK_LOG_LIB_TDH_EVENT_DECODER_H_
+
+#include <windows.h>
+#include <wmistr.h>
+#include <evntrace.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+
+// Decodes the events of providers we have no parser for, rendering their
+// properties to text by the event schema TDH has for them. Looking up a
+// schema is costly, so each is looked up once per provider, event type and
+// version, and kept as a table of the property names and types that the
+// events are then walked by. Events with no schema are remembered as such
+// too, and cost a map lookup after the first.
+// @note not thread safe, each parser should have its own decoder.
+class TdhEventDecoder {
+ public:
+  // The property types we render.
+  enum PropertyType {
+    TYPE_INT8,
+    TYPE_UINT8,
+    TYPE_INT16,
+    TYPE_UINT16,
+    TYPE_INT32,
+    TYPE_UINT32,
+    TYPE_INT64,
+    TYPE_UINT64,
+    TYPE_HEX_INT32,
+    TYPE_HEX_INT64,
+    TYPE_FLOAT,
+    TYPE_DOUBLE,
+    // A 32 bit BOOL.
+    TYPE_BOOLEAN,
+    TYPE_GUID,
+    // Zero-terminated strings.
+    TYPE_UNICODE_STRING,
+    TYPE_ANSI_STRING,
+  };
+
+  struct Property {
+    std::string name;
+    PropertyType type;
+  };
+  // The properties of an event, in order. Schemas end at the first
+  // property we can't lay out, such as a structure or an array.
+  typedef std::vector<Property> Schema;
+
+  // Provides the schemas of events.
+  class SchemaSource {
+   public:
+    virtual ~SchemaSource() {}
+
+    // Retrieves the schema of @p event into @p schema.
+    // @returns false if there's none.
+    virtual bool GetSchema(const EVENT_TRACE* event, Schema* schema) = 0;
+  };
+
+  // @param schema_source the source of the event schemas, or NULL to get
+  //     them from TDH. Must outlive us.
+  explicit TdhEventDecoder(SchemaSource* schema_source);
+  ~TdhEventDecoder();
+
+  // Renders the properties of @p event to @p text as space separated
+  // "name=value" pairs, and "..." if the event data ends early.
+  // @param text may be NULL to only check that the event decodes.
+  // @returns false if there's no schema for the event.
+  bool Decode(const EVENT_TRACE* event, std::string* text);
+
+  // The number of schemas looked up, whether or not there was one.
+  size_t num_schemas() const { return schemas_.size(); }
+
+  // @returns the size of properties of @p type, or zero for strings.
+  static size_t GetPropertySize(PropertyType type);
+
+ private:
+  class TdhSchemaSource;
+
+  struct SchemaKey {
+    GUID provider;
+    UCHAR type;
+    UCHAR version;
+
+    bool operator<(const SchemaKey& o) const;
+  };
+
+  struct CachedSchema {
+    CachedSchema() : valid(false) {
+    }
+
+    // False if the source had no schema for the event.
+    bool valid;
+    Schema properties;
+  };
+  typedef std::map<SchemaKey, CachedSchema> SchemaMap;
+
+  // @returns the schema of @p event, looking it up on first use.
+  const CachedSchema& GetSchema(const EVENT_TRACE* event);
+
+  // Renders the property value at @p data to @p text.
+  // @returns the size of the property, or zero if it doesn't fit in the
+  //     @p length bytes left.
+  static size_t RenderProperty(PropertyType type,
+                               const uint8* data,
+                               size_t length,
+                               std::string* text);
+
+  // The TDH schema source, when we use it.
+  scoped_ptr<SchemaSource> tdh_schema_source_;
+  SchemaSource* schema_source_;
+  SchemaMap schemas_;
+
+  DISALLOW_COPY_AND_ASSIGN(TdhEventDecoder);
+};
+
+#endif  // SAWBUCK_LOG_LIB_TDH_EVENT_DECODER_H_
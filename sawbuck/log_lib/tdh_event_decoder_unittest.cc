@@ -0,0 +1,188 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Generic event decoder unittests.
+#include "sawbuck/log_lib/tdh_event_decoder.h"
+
+#include <map>
+#include "gtest/gtest.h"
+#include <initguid.h>  // NOLINT - must be last.
+
+namespace {
+
+// {D9A8B3E1-6C2F-4E7A-9B4D-2F1C0A5E8D73}
+DEFINE_GUID(kProviderGuid,
+    0xd9a8b3e1, 0x6c2f, 0x4e7a,
+        0x9b, 0x4d, 0x2f, 0x1c, 0x0a, 0x5e, 0x8d, 0x73);
+
+typedef TdhEventDecoder::Property Property;
+typedef TdhEventDecoder::Schema Schema;
+
+// Serves the schemas it's given by event type, and counts the lookups.
+class TestSchemaSource : public TdhEventDecoder::SchemaSource {
+ public:
+  TestSchemaSource() : num_lookups_(0) {
+  }
+
+  virtual bool GetSchema(const EVENT_TRACE* event, Schema* schema) {
+    ++num_lookups_;
+    std::map<UCHAR, Schema>::const_iterator it(
+        schemas_.find(event->Header.Class.Type));
+    if (it == schemas_.end())
+      return false;
+
+    *schema = it->second;
+    return true;
+  }
+
+  void AddProperty(UCHAR type,
+                   const char* name,
+                   TdhEventDecoder::PropertyType property_type) {
+    Property property;
+    property.name = name;
+    property.type = property_type;
+    schemas_[type].push_back(property);
+  }
+
+  size_t num_lookups_;
+  std::map<UCHAR, Schema> schemas_;
+};
+
+// Appends event data to a buffer.
+class EventData {
+ public:
+  template <typename T>
+  void Append(const T& value) {
+    const char* data = reinterpret_cast<const char*>(&value);
+    data_.insert(data_.end(), data, data + sizeof(value));
+  }
+  void AppendString(const char* str) {
+    data_.insert(data_.end(), str, str + strlen(str) + 1);
+  }
+  void AppendString(const wchar_t* str) {
+    const char* data = reinterpret_cast<const char*>(str);
+    data_.insert(data_.end(), data, data + (wcslen(str) + 1) * sizeof(*str));
+  }
+
+  // Makes an event of @p type around the data.
+  EVENT_TRACE MakeEvent(UCHAR type) {
+    EVENT_TRACE event = {};
+    event.Header.Guid = kProviderGuid;
+    event.Header.Class.Type = type;
+    event.MofData = data_.empty() ? NULL : &data_[0];
+    event.MofLength = static_cast<ULONG>(data_.size());
+    return event;
+  }
+
+  std::vector<char> data_;
+};
+
+class TdhEventDecoderTest : public testing::Test {
+ public:
+  TdhEventDecoderTest() : decoder_(&source_) {
+  }
+
+ protected:
+  TestSchemaSource source_;
+  TdhEventDecoder decoder_;
+};
+
+}  // namespace
+
+TEST_F(TdhEventDecoderTest, RendersProperties) {
+  source_.AddProperty(1, "Small", TdhEventDecoder::TYPE_INT8);
+  source_.AddProperty(1, "Count", TdhEventDecoder::TYPE_UINT32);
+  source_.AddProperty(1, "Offset", TdhEventDecoder::TYPE_INT64);
+  source_.AddProperty(1, "Flags", TdhEventDecoder::TYPE_HEX_INT32);
+  source_.AddProperty(1, "Ratio", TdhEventDecoder::TYPE_DOUBLE);
+  source_.AddProperty(1, "Found", TdhEventDecoder::TYPE_BOOLEAN);
+  source_.AddProperty(1, "Name", TdhEventDecoder::TYPE_ANSI_STRING);
+  source_.AddProperty(1, "Path", TdhEventDecoder::TYPE_UNICODE_STRING);
+  source_.AddProperty(1, "Id", TdhEventDecoder::TYPE_GUID);
+
+  EventData data;
+  data.Append(static_cast<int8>(-3));
+  data.Append(static_cast<uint32>(42));
+  data.Append(static_cast<int64>(-1234567890123LL));
+  data.Append(static_cast<uint32>(0xBEEF));
+  data.Append(0.5);
+  data.Append(static_cast<BOOL>(TRUE));
+  data.AppendString("foo");
+  data.AppendString(L"C:\\bar.txt");
+  data.Append(kProviderGuid);
+  EVENT_TRACE event = data.MakeEvent(1);
+
+  std::string text;
+  ASSERT_TRUE(decoder_.Decode(&event, &text));
+  EXPECT_EQ("Small=-3 Count=42 Offset=-1234567890123 Flags=0xBEEF "
+            "Ratio=0.5 Found=true Name=foo Path=C:\\bar.txt "
+            "Id={D9A8B3E1-6C2F-4E7A-9B4D-2F1C0A5E8D73}", text);
+}
+
+TEST_F(TdhEventDecoderTest, LooksUpSchemasOnce) {
+  source_.AddProperty(1, "Count", TdhEventDecoder::TYPE_UINT32);
+
+  EventData data;
+  data.Append(static_cast<uint32>(7));
+  EVENT_TRACE event = data.MakeEvent(1);
+  EVENT_TRACE unknown = data.MakeEvent(2);
+
+  std::string text;
+  for (size_t i = 0; i < 3; ++i) {
+    EXPECT_TRUE(decoder_.Decode(&event, &text));
+    EXPECT_EQ("Count=7", text);
+    EXPECT_FALSE(decoder_.Decode(&unknown, &text));
+  }
+
+  // Each was looked up the once, including the one with no schema.
+  EXPECT_EQ(2, source_.num_lookups_);
+  EXPECT_EQ(2, decoder_.num_schemas());
+
+  // The version is part of the key.
+  event.Header.Class.Version = 1;
+  EXPECT_TRUE(decoder_.Decode(&event, NULL));
+  EXPECT_EQ(3, source_.num_lookups_);
+}
+
+TEST_F(TdhEventDecoderTest, StopsAtEndOfData) {
+  source_.AddProperty(1, "Count", TdhEventDecoder::TYPE_UINT32);
+  source_.AddProperty(1, "Total", TdhEventDecoder::TYPE_UINT64);
+
+  EventData data;
+  data.Append(static_cast<uint32>(7));
+  data.Append(static_cast<uint32>(8));
+  EVENT_TRACE event = data.MakeEvent(1);
+
+  std::string text;
+  ASSERT_TRUE(decoder_.Decode(&event, &text));
+  EXPECT_EQ("Count=7 Total=...", text);
+}
+
+TEST_F(TdhEventDecoderTest, StopsAtUnterminatedString) {
+  source_.AddProperty(1, "Name", TdhEventDecoder::TYPE_ANSI_STRING);
+  source_.AddProperty(2, "Path", TdhEventDecoder::TYPE_UNICODE_STRING);
+
+  EventData data;
+  data.Append('f');
+  data.Append('o');
+  EVENT_TRACE event = data.MakeEvent(1);
+
+  std::string text;
+  ASSERT_TRUE(decoder_.Decode(&event, &text));
+  EXPECT_EQ("Name=...", text);
+
+  event = data.MakeEvent(2);
+  ASSERT_TRUE(decoder_.Decode(&event, &text));
+  EXPECT_EQ("Path=...", text);
+}
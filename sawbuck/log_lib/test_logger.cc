@@ -13,6 +13,35 @@
 // limitations under the License.
 //
 // Test logger implementation.
+//
+// Logs a message with a stack trace per command line argument. With --load
+// it instead generates events at a configurable rate, to stress the live
+// capture of the viewer:
+//   --rate=N          events per second over all threads, 0 for flat out.
+//   --threads=N       the number of logging threads.
+//   --duration=N      seconds to log for.
+//   --message-size=A-B the message length, uniform in [A, B].
+//   --stack-depth=A-B the stack trace depth, uniform in [A, B].
+//   --trace-percent=N the percentage of events that are trace event
+//                     begin/end pairs, or instants one time in ten.
+//   --file=PATH       log to a file session of our own rather than to
+//                     the sessions that enabled us, e.g. the viewer's.
+//   --session=NAME    the session to report lost events of, defaults to
+//                     the viewer's.
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/debug/trace_event_win.h"
+#include "base/logging.h"
+#include "base/memory/scoped_vector.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/simple_thread.h"
+#include "base/time/time.h"
+#include "base/win/event_trace_controller.h"
 #include "base/win/event_trace_provider.h"
 #include <cguid.h>
 #include <initguid.h>
@@ -32,7 +61,308 @@ enum LogMessageTypes {
   LOG_MESSAGE_WITH_STACKTRACE = 11,
 };
 
+namespace {
+
+const wchar_t kViewerSessionName[] = L"Sawbuck Log Session";
+const wchar_t kFileSessionName[] = L"Test Logger Session";
+
+// The longest stack trace we log, as CaptureStackBackTrace allows.
+const int kMaxStackDepth = 62;
+const int kMaxMessageSize = 64 * 1024;
+
+// An inclusive range of values to pick from.
+struct Range {
+  Range(int min, int max) : min(min), max(max) {
+  }
+
+  int min;
+  int max;
+};
+
+struct LoadOptions {
+  LoadOptions()
+      : rate(10000), threads(1), duration(10), message_size(32, 128),
+        stack_depth(0, 20), trace_percent(10) {
+  }
+
+  int rate;
+  int threads;
+  int duration;
+  Range message_size;
+  Range stack_depth;
+  int trace_percent;
+};
+
+// Parses "A-B" or "A" into @p range.
+// @returns true iff @p value is a range in [0, @p limit].
+bool ParseRange(const std::string& value, int limit, Range* range) {
+  size_t dash = value.find('-');
+  std::string min = value.substr(0, dash);
+  std::string max = dash == std::string::npos ? min : value.substr(dash + 1);
+  if (!base::StringToInt(min, &range->min) ||
+      !base::StringToInt(max, &range->max)) {
+    return false;
+  }
+
+  return 0 <= range->min && range->min <= range->max && range->max <= limit;
+}
+
+// Reads the int switch @p name into @p value, if present.
+// @returns false iff the switch is present but not a number in
+//     [@p min, @p max].
+bool GetIntSwitch(const CommandLine& cmd_line, const char* name, int min,
+                  int max, int* value) {
+  if (!cmd_line.HasSwitch(name))
+    return true;
+
+  return base::StringToInt(cmd_line.GetSwitchValueASCII(name), value) &&
+      min <= *value && *value <= max;
+}
+
+bool GetLoadOptions(const CommandLine& cmd_line, LoadOptions* options) {
+  if (!GetIntSwitch(cmd_line, "rate", 0, kint32max, &options->rate) ||
+      !GetIntSwitch(cmd_line, "threads", 1, 64, &options->threads) ||
+      !GetIntSwitch(cmd_line, "duration", 1, kint32max, &options->duration) ||
+      !GetIntSwitch(cmd_line, "trace-percent", 0, 100,
+                    &options->trace_percent)) {
+    return false;
+  }
+
+  if (cmd_line.HasSwitch("message-size") &&
+      !ParseRange(cmd_line.GetSwitchValueASCII("message-size"),
+                  kMaxMessageSize, &options->message_size)) {
+    return false;
+  }
+  if (cmd_line.HasSwitch("stack-depth") &&
+      !ParseRange(cmd_line.GetSwitchValueASCII("stack-depth"),
+                  kMaxStackDepth, &options->stack_depth)) {
+    return false;
+  }
+
+  return true;
+}
+
+// Logs its share of the load on a thread of its own.
+class LoadThread : public base::DelegateSimpleThread::Delegate {
+ public:
+  LoadThread(base::win::EtwTraceProvider* provider,
+             const LoadOptions& options,
+             uint32 seed)
+      : provider_(provider), options_(options), random_(seed | 1),
+        events_logged_(0), events_failed_(0) {
+    message_.assign(kMaxMessageSize, 'x');
+    message_.push_back('\0');
+  }
+
+  virtual void Run();
+
+  size_t events_logged() const { return events_logged_; }
+  size_t events_failed() const { return events_failed_; }
+
+ private:
+  // Picks a value in @p range.
+  int Pick(const Range& range);
+
+  void LogMessage();
+  // Logs a trace event of @p type for @p id.
+  void LogTraceEvent(base::win::EtwEventType type, uintptr_t id);
+  void Log(const EVENT_TRACE_HEADER* event);
+
+  base::win::EtwTraceProvider* provider_;
+  LoadOptions options_;
+  // The state of our xorshift generator.
+  uint32 random_;
+
+  // The message text, a run of x's of which a tail is logged.
+  std::string message_;
+  // Our stack, repeated to make deeper traces.
+  void* stack_trace_[kMaxStackDepth];
+
+  size_t events_logged_;
+  size_t events_failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoadThread);
+};
+
+void LoadThread::Run() {
+  int depth = ::CaptureStackBackTrace(0, kMaxStackDepth, stack_trace_, NULL);
+  for (int i = std::max(depth, 1); i < kMaxStackDepth; ++i)
+    stack_trace_[i] = stack_trace_[i % std::max(depth, 1)];
+
+  // Each thread paces itself to its share of the rate.
+  base::TimeDelta interval;
+  if (options_.rate != 0) {
+    interval = base::TimeDelta::FromMicroseconds(
+        base::Time::kMicrosecondsPerSecond * options_.threads / options_.rate);
+  }
+
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  base::TimeTicks end =
+      start + base::TimeDelta::FromSeconds(options_.duration);
+  base::TimeTicks next = start;
+  uintptr_t next_id = 1;
+  for (base::TimeTicks now = start; now < end;
+       now = base::TimeTicks::HighResNow()) {
+    if (now < next) {
+      // Sleep off the larger waits, and spin through the short ones.
+      if (next - now > base::TimeDelta::FromMilliseconds(2))
+        base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1));
+      continue;
+    }
+
+    if (Pick(Range(0, 99)) < options_.trace_percent) {
+      if (Pick(Range(0, 9)) == 0) {
+        LogTraceEvent(base::debug::kTraceEventTypeInstant, next_id);
+      } else {
+        // A pair takes the time of two events.
+        LogTraceEvent(base::debug::kTraceEventTypeBegin, next_id);
+        LogTraceEvent(base::debug::kTraceEventTypeEnd, next_id);
+        next += interval;
+      }
+      ++next_id;
+    } else {
+      LogMessage();
+    }
+
+    next += interval;
+  }
+}
+
+int LoadThread::Pick(const Range& range) {
+  random_ ^= random_ << 13;
+  random_ ^= random_ >> 17;
+  random_ ^= random_ << 5;
+  return range.min + random_ % (range.max - range.min + 1);
+}
+
+void LoadThread::LogMessage() {
+  const DWORD depth = Pick(options_.stack_depth);
+  const size_t size = Pick(options_.message_size);
+
+  base::win::EtwMofEvent<3> event(kLogEventId,
+                                  LOG_MESSAGE_WITH_STACKTRACE,
+                                  TRACE_LEVEL_INFORMATION);
+  event.SetField(0, sizeof(depth), &depth);
+  event.SetField(1, sizeof(stack_trace_[0]) * depth, stack_trace_);
+  // Log the tail of the message to pick up its terminator.
+  event.SetField(2, size + 1, &message_[kMaxMessageSize - size]);
+  Log(event.get());
+}
+
+void LoadThread::LogTraceEvent(base::win::EtwEventType type, uintptr_t id) {
+  static const char kName[] = "TestLogger::LoadThread";
+  static const char kExtra[] = "";
+  const GUID& event_class = sizeof(id) == sizeof(uint64) ?
+      base::debug::kTraceEventClass64 : base::debug::kTraceEventClass32;
+
+  base::win::EtwMofEvent<3> event(event_class, type, TRACE_LEVEL_INFORMATION);
+  event.SetField(0, sizeof(kName), kName);
+  event.SetField(1, sizeof(id), &id);
+  event.SetField(2, sizeof(kExtra), kExtra);
+  Log(event.get());
+}
+
+void LoadThread::Log(const EVENT_TRACE_HEADER* event) {
+  if (provider_->Log(event) == ERROR_SUCCESS)
+    ++events_logged_;
+  else
+    ++events_failed_;
+}
+
+// Prints the lost events of the session @p session_name.
+void PrintSessionStats(const wchar_t* session_name) {
+  base::win::EtwTraceProperties props;
+  HRESULT hr = base::win::EtwTraceController::Query(session_name, &props);
+  if (FAILED(hr)) {
+    printf("No statistics for session \"%ls\".\n", session_name);
+    return;
+  }
+
+  EVENT_TRACE_PROPERTIES* p = props.get();
+  printf("Session \"%ls\": %lu events lost, %lu real-time buffers lost, "
+         "%lu buffers written.\n",
+         session_name, p->EventsLost, p->RealTimeBuffersLost,
+         p->BuffersWritten);
+}
+
+int GenerateLoad(const CommandLine& cmd_line) {
+  LoadOptions options;
+  if (!GetLoadOptions(cmd_line, &options)) {
+    printf("Invalid load options.\n");
+    return 1;
+  }
+
+  // With --file, log to a file session of our own.
+  base::win::EtwTraceController controller;
+  std::wstring session_name(kViewerSessionName);
+  base::FilePath file(cmd_line.GetSwitchValuePath("file"));
+  if (!file.empty()) {
+    session_name = kFileSessionName;
+    base::win::EtwTraceProperties props;
+    base::win::EtwTraceController::Stop(kFileSessionName, &props);
+
+    HRESULT hr = controller.StartFileSession(kFileSessionName,
+                                             file.value().c_str(), false);
+    if (SUCCEEDED(hr)) {
+      hr = controller.EnableProvider(kChromeTraceProviderName,
+                                     TRACE_LEVEL_VERBOSE, 0xFFFFFFFF);
+    }
+    if (FAILED(hr)) {
+      printf("Error 0x%08X starting the file session.\n", hr);
+      return 1;
+    }
+  } else if (cmd_line.HasSwitch("session")) {
+    session_name = cmd_line.GetSwitchValueNative("session");
+  }
+
+  base::win::EtwTraceProvider provider(kChromeTraceProviderName);
+  provider.Register();
+
+  ScopedVector<LoadThread> loads;
+  ScopedVector<base::DelegateSimpleThread> threads;
+  for (int i = 0; i < options.threads; ++i) {
+    loads.push_back(new LoadThread(&provider, options,
+                                   0x9E3779B9U * (i + 1)));
+    threads.push_back(new base::DelegateSimpleThread(loads.back(),
+                                                     "Test logger load"));
+  }
+
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i]->Start();
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i]->Join();
+  base::TimeDelta elapsed = base::TimeTicks::HighResNow() - start;
+
+  size_t events_logged = 0;
+  size_t events_failed = 0;
+  for (size_t i = 0; i < loads.size(); ++i) {
+    events_logged += loads[i]->events_logged();
+    events_failed += loads[i]->events_failed();
+  }
+  printf("%u events logged, %u failed, in %.2fs, %.0f events/s.\n",
+         static_cast<unsigned>(events_logged),
+         static_cast<unsigned>(events_failed),
+         elapsed.InSecondsF(),
+         events_logged / std::max(elapsed.InSecondsF(), 1e-9));
+
+  PrintSessionStats(session_name.c_str());
+  if (!file.empty())
+    controller.Stop(NULL);
+
+  return 0;
+}
+
+}  // namespace
+
 int main(int argc, char **argv) {
+  base::AtExitManager at_exit;
+  CommandLine::Init(argc, argv);
+
+  const CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  if (cmd_line->HasSwitch("load"))
+    return GenerateLoad(*cmd_line);
+
   base::win::EtwTraceProvider provider(kChromeTraceProviderName);
   provider.Register();
 
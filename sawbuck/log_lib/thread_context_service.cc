@@ -0,0 +1,304 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+// Thread context service implementation.
+#include "sawbuck/log_lib/thread_context_service.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+typedef IThreadContextService::Record Record;
+
+// Orders records on their time.
+bool RecordTimeLess(const Record& record, const base::Time& time) {
+  return record.time_ < time;
+}
+
+bool TimeRecordLess(const base::Time& time, const Record& record) {
+  return time < record.time_;
+}
+
+}  // namespace
+
+const size_t ThreadContextService::kDefaultMaxRecordsPerThread;
+
+ThreadContextService::ThreadContextService()
+    : max_records_per_thread_(kDefaultMaxRecordsPerThread),
+      page_fault_sink_(NULL), disk_io_sink_(NULL), scheduler_sink_(NULL) {
+}
+
+ThreadContextService::ThreadContextService(size_t max_records_per_thread)
+    : max_records_per_thread_(max_records_per_thread),
+      page_fault_sink_(NULL), disk_io_sink_(NULL), scheduler_sink_(NULL) {
+  DCHECK_LT(0U, max_records_per_thread);
+}
+
+ThreadContextService::~ThreadContextService() {
+}
+
+bool ThreadContextService::GetThreadContext(DWORD thread_id,
+                                            const base::Time& from,
+                                            const base::Time& to,
+                                            size_t max_records,
+                                            std::vector<Record>* records) {
+  DCHECK(records != NULL);
+  DCHECK(from <= to);
+
+  records->clear();
+
+  base::AutoLock lock(lock_);
+  ThreadRecordsMap::const_iterator it = threads_.find(thread_id);
+  if (it == threads_.end())
+    return true;
+
+  const RecordQueue& queue = it->second.records;
+  RecordQueue::const_iterator begin =
+      std::lower_bound(queue.begin(), queue.end(), from, RecordTimeLess);
+  RecordQueue::const_iterator end =
+      std::upper_bound(begin, queue.end(), to, TimeRecordLess);
+
+  // Keep the records nearest the middle of the window, where the event
+  // the window is around is.
+  size_t count = end - begin;
+  if (count > max_records) {
+    base::Time middle = from + (to - from) / 2;
+    RecordQueue::const_iterator center =
+        std::lower_bound(begin, end, middle, RecordTimeLess);
+    size_t before = std::min<size_t>(center - begin, max_records / 2);
+    begin = center - before;
+    if (static_cast<size_t>(end - begin) > max_records)
+      end = begin + max_records;
+    else
+      begin = end - max_records;
+  }
+  records->assign(begin, end);
+
+  return !it->second.dropped || queue.empty() ||
+      queue.front().time_ <= from;
+}
+
+void ThreadContextService::OnTransitionFault(
+    DWORD process_id,
+    DWORD thread_id,
+    const base::Time& time,
+    sym_util::Address address,
+    sym_util::Address program_counter) {
+  Record record(MakeRecord(Record::SOFT_FAULT, time));
+  record.address_ = address;
+  AddRecord(thread_id, record);
+
+  if (page_fault_sink_ != NULL) {
+    page_fault_sink_->OnTransitionFault(process_id, thread_id, time, address,
+                                        program_counter);
+  }
+}
+
+void ThreadContextService::OnDemandZeroFault(
+    DWORD process_id,
+    DWORD thread_id,
+    const base::Time& time,
+    sym_util::Address address,
+    sym_util::Address program_counter) {
+  Record record(MakeRecord(Record::SOFT_FAULT, time));
+  record.address_ = address;
+  AddRecord(thread_id, record);
+
+  if (page_fault_sink_ != NULL) {
+    page_fault_sink_->OnDemandZeroFault(process_id, thread_id, time, address,
+                                        program_counter);
+  }
+}
+
+void ThreadContextService::OnCopyOnWriteFault(
+    DWORD process_id,
+    DWORD thread_id,
+    const base::Time& time,
+    sym_util::Address address,
+    sym_util::Address program_counter) {
+  Record record(MakeRecord(Record::SOFT_FAULT, time));
+  record.address_ = address;
+  AddRecord(thread_id, record);
+
+  if (page_fault_sink_ != NULL) {
+    page_fault_sink_->OnCopyOnWriteFault(process_id, thread_id, time,
+                                         address, program_counter);
+  }
+}
+
+void ThreadContextService::OnGuardPageFault(
+    DWORD process_id,
+    DWORD thread_id,
+    const base::Time& time,
+    sym_util::Address address,
+    sym_util::Address program_counter) {
+  Record record(MakeRecord(Record::FAULT_VIOLATION, time));
+  record.address_ = address;
+  AddRecord(thread_id, record);
+
+  if (page_fault_sink_ != NULL) {
+    page_fault_sink_->OnGuardPageFault(process_id, thread_id, time, address,
+                                       program_counter);
+  }
+}
+
+void ThreadContextService::OnHardFault(DWORD process_id,
+                                       DWORD thread_id,
+                                       const base::Time& time,
+                                       sym_util::Address address,
+                                       sym_util::Address program_counter) {
+  Record record(MakeRecord(Record::HARD_FAULT, time));
+  record.address_ = address;
+  AddRecord(thread_id, record);
+
+  if (page_fault_sink_ != NULL) {
+    page_fault_sink_->OnHardFault(process_id, thread_id, time, address,
+                                  program_counter);
+  }
+}
+
+void ThreadContextService::OnAccessViolationFault(
+    DWORD process_id,
+    DWORD thread_id,
+    const base::Time& time,
+    sym_util::Address address,
+    sym_util::Address program_counter) {
+  Record record(MakeRecord(Record::FAULT_VIOLATION, time));
+  record.address_ = address;
+  AddRecord(thread_id, record);
+
+  if (page_fault_sink_ != NULL) {
+    page_fault_sink_->OnAccessViolationFault(process_id, thread_id, time,
+                                             address, program_counter);
+  }
+}
+
+void ThreadContextService::OnHardPageFault(DWORD thread_id,
+                                           const base::Time& time,
+                                           const base::Time& initial_time,
+                                           sym_util::Offset offset,
+                                           sym_util::Address address,
+                                           sym_util::Address file_object,
+                                           sym_util::ByteCount byte_count) {
+  // The thread id of the event body is the faulting thread's.
+  Record record(MakeRecord(Record::HARD_FAULT_READ, time));
+  record.address_ = address;
+  record.byte_count_ = static_cast<ULONG>(byte_count);
+  record.latency_ = time - initial_time;
+  AddRecord(thread_id, record);
+
+  if (page_fault_sink_ != NULL) {
+    page_fault_sink_->OnHardPageFault(thread_id, time, initial_time, offset,
+                                      address, file_object, byte_count);
+  }
+}
+
+void ThreadContextService::OnDiskIo(const base::Time& time,
+                                    DWORD process_id,
+                                    DWORD thread_id,
+                                    bool is_write,
+                                    ULONG disk_number,
+                                    uint64 byte_offset,
+                                    ULONG transfer_size,
+                                    sym_util::Address file_object,
+                                    const base::TimeDelta& latency) {
+  Record record(MakeRecord(is_write ? Record::DISK_WRITE : Record::DISK_READ,
+                           time));
+  record.address_ = file_object;
+  record.byte_count_ = transfer_size;
+  record.latency_ = latency;
+  AddRecord(thread_id, record);
+
+  if (disk_io_sink_ != NULL) {
+    disk_io_sink_->OnDiskIo(time, process_id, thread_id, is_write,
+                            disk_number, byte_offset, transfer_size,
+                            file_object, latency);
+  }
+}
+
+void ThreadContextService::OnFileName(const base::Time& time,
+                                      sym_util::Address file_object,
+                                      const std::wstring& file_name) {
+  if (disk_io_sink_ != NULL)
+    disk_io_sink_->OnFileName(time, file_object, file_name);
+}
+
+void ThreadContextService::OnFileDeleted(const base::Time& time,
+                                         sym_util::Address file_object) {
+  if (disk_io_sink_ != NULL)
+    disk_io_sink_->OnFileDeleted(time, file_object);
+}
+
+void ThreadContextService::OnContextSwitch(const base::Time& time,
+                                           ULONG processor,
+                                           DWORD old_thread_id,
+                                           DWORD new_thread_id,
+                                           int old_thread_state) {
+  // The idle thread's context is of no interest.
+  if (old_thread_id != 0) {
+    Record record(MakeRecord(Record::SWITCHED_OUT, time));
+    record.processor_ = processor;
+    record.thread_state_ = old_thread_state;
+    AddRecord(old_thread_id, record);
+  }
+  if (new_thread_id != 0) {
+    Record record(MakeRecord(Record::SWITCHED_IN, time));
+    record.processor_ = processor;
+    AddRecord(new_thread_id, record);
+  }
+
+  if (scheduler_sink_ != NULL) {
+    scheduler_sink_->OnContextSwitch(time, processor, old_thread_id,
+                                     new_thread_id, old_thread_state);
+  }
+}
+
+void ThreadContextService::OnThreadReady(const base::Time& time,
+                                         DWORD thread_id) {
+  AddRecord(thread_id, MakeRecord(Record::READIED, time));
+
+  if (scheduler_sink_ != NULL)
+    scheduler_sink_->OnThreadReady(time, thread_id);
+}
+
+ThreadContextService::Record ThreadContextService::MakeRecord(
+    Record::Kind kind, const base::Time& time) {
+  Record record = {};
+  record.time_ = time;
+  record.kind_ = kind;
+  return record;
+}
+
+void ThreadContextService::AddRecord(DWORD thread_id, const Record& record) {
+  base::AutoLock lock(lock_);
+
+  ThreadRecords& thread = threads_[thread_id];
+  RecordQueue& records = thread.records;
+  // The events of a thread mostly come in order, those that don't go
+  // after the records of their time.
+  if (records.empty() || !(record.time_ < records.back().time_)) {
+    records.push_back(record);
+  } else {
+    records.insert(std::upper_bound(records.begin(), records.end(),
+                                    record.time_, TimeRecordLess),
+                   record);
+  }
+
+  if (records.size() > max_records_per_thread_) {
+    records.pop_front();
+    thread.dropped = true;
+  }
+}
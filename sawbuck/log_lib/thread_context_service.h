@@ -0,0 +1,216 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+// Thread context service declaration.
+#ifndef SAWBUCK_LOG_LIB_THREAD_CONTEXT_SERVICE_H_
+#define SAWBUCK_LOG_LIB_THREAD_CONTEXT_SERVICE_H_
+
+#include <deque>
+#include <map>
+#include <vector>
+#include "base/synchronization/lock.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+
+class IThreadContextService {
+ public:
+  // A kernel event of a thread.
+  struct Record {
+    enum Kind {
+      // A page fault resolved without I/O, e.g. a transition, demand zero
+      // or copy on write fault.
+      SOFT_FAULT,
+      // A page fault that needs the page read in.
+      HARD_FAULT,
+      // The read that resolved a hard fault, which completed at time_.
+      HARD_FAULT_READ,
+      // An access or guard page violation.
+      FAULT_VIOLATION,
+      // A disk read or write, which completed at time_.
+      DISK_READ,
+      DISK_WRITE,
+      // The thread was switched onto or off a processor.
+      SWITCHED_IN,
+      SWITCHED_OUT,
+      // The thread became ready to run.
+      READIED,
+    };
+
+    base::Time time_;
+    Kind kind_;
+    // The faulting address for faults, the file object for disk I/O.
+    sym_util::Address address_;
+    // The bytes read or written, for disk I/O and fault reads.
+    ULONG byte_count_;
+    // The time from issue to completion, for disk I/O and fault reads.
+    base::TimeDelta latency_;
+    // The processor for switches, the KTHREAD_STATE the thread was left in
+    // when switched out.
+    ULONG processor_;
+    int thread_state_;
+  };
+
+  // Retrieve the kernel events of @p thread_id from @p from to @p to, in
+  // time order, to @p records.
+  // @param max_records the most records to retrieve, those nearest the
+  //     middle of the window are kept.
+  // @returns true iff the records still cover the start of the window,
+  //     that is, none of its records were dropped.
+  virtual bool GetThreadContext(DWORD thread_id,
+                                const base::Time& from,
+                                const base::Time& to,
+                                size_t max_records,
+                                std::vector<Record>* records) = 0;
+};
+
+// The thread context service sinks the page fault, disk I/O and scheduler
+// events of a kernel log parser, and indexes them by thread and time, so
+// the context of a log message costs a search rather than a scan of the
+// kernel events. Each thread's records are kept in time order, and its
+// oldest dropped past a fixed count, so memory is bounded per thread.
+//
+// The events are passed on to the sinks set for them, so the service can
+// stand in front of those that aggregate them.
+class ThreadContextService
+    : public IThreadContextService,
+      public KernelPageFaultEvents,
+      public KernelDiskIoEvents,
+      public KernelSchedulerEvents {
+ public:
+  // The default number of records kept per thread.
+  static const size_t kDefaultMaxRecordsPerThread = 16 * 1024;
+
+  ThreadContextService();
+  explicit ThreadContextService(size_t max_records_per_thread);
+  ~ThreadContextService();
+
+  // Set the sinks to pass the events on to, NULL for none.
+  // @{
+  void set_page_fault_event_sink(KernelPageFaultEvents* page_fault_sink) {
+    page_fault_sink_ = page_fault_sink;
+  }
+  void set_disk_io_event_sink(KernelDiskIoEvents* disk_io_sink) {
+    disk_io_sink_ = disk_io_sink;
+  }
+  void set_scheduler_event_sink(KernelSchedulerEvents* scheduler_sink) {
+    scheduler_sink_ = scheduler_sink;
+  }
+  // @}
+
+  // IThreadContextService implementation.
+  virtual bool GetThreadContext(DWORD thread_id,
+                                const base::Time& from,
+                                const base::Time& to,
+                                size_t max_records,
+                                std::vector<Record>* records);
+
+  // KernelPageFaultEvents implementation.
+  virtual void OnTransitionFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter);
+  virtual void OnDemandZeroFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter);
+  virtual void OnCopyOnWriteFault(DWORD process_id,
+                                  DWORD thread_id,
+                                  const base::Time& time,
+                                  sym_util::Address address,
+                                  sym_util::Address program_counter);
+  virtual void OnGuardPageFault(DWORD process_id,
+                                DWORD thread_id,
+                                const base::Time& time,
+                                sym_util::Address address,
+                                sym_util::Address program_counter);
+  virtual void OnHardFault(DWORD process_id,
+                           DWORD thread_id,
+                           const base::Time& time,
+                           sym_util::Address address,
+                           sym_util::Address program_counter);
+  virtual void OnAccessViolationFault(DWORD process_id,
+                                      DWORD thread_id,
+                                      const base::Time& time,
+                                      sym_util::Address address,
+                                      sym_util::Address program_counter);
+  virtual void OnHardPageFault(DWORD thread_id,
+                               const base::Time& time,
+                               const base::Time& initial_time,
+                               sym_util::Offset offset,
+                               sym_util::Address address,
+                               sym_util::Address file_object,
+                               sym_util::ByteCount byte_count);
+
+  // KernelDiskIoEvents implementation.
+  virtual void OnDiskIo(const base::Time& time,
+                        DWORD process_id,
+                        DWORD thread_id,
+                        bool is_write,
+                        ULONG disk_number,
+                        uint64 byte_offset,
+                        ULONG transfer_size,
+                        sym_util::Address file_object,
+                        const base::TimeDelta& latency);
+  virtual void OnFileName(const base::Time& time,
+                          sym_util::Address file_object,
+                          const std::wstring& file_name);
+  virtual void OnFileDeleted(const base::Time& time,
+                             sym_util::Address file_object);
+
+  // KernelSchedulerEvents implementation.
+  virtual void OnContextSwitch(const base::Time& time,
+                               ULONG processor,
+                               DWORD old_thread_id,
+                               DWORD new_thread_id,
+                               int old_thread_state);
+  virtual void OnThreadReady(const base::Time& time,
+                             DWORD thread_id);
+
+ private:
+  // A thread's records, in time order.
+  typedef std::deque<Record> RecordQueue;
+
+  // @returns a record of @p kind at @p time, with the rest zeroed.
+  static Record MakeRecord(Record::Kind kind, const base::Time& time);
+
+  // Adds @p record to the records of @p thread_id, dropping the oldest
+  // past max_records_per_thread_.
+  void AddRecord(DWORD thread_id, const Record& record);
+
+  const size_t max_records_per_thread_;
+
+  KernelPageFaultEvents* page_fault_sink_;
+  KernelDiskIoEvents* disk_io_sink_;
+  KernelSchedulerEvents* scheduler_sink_;
+
+  base::Lock lock_;
+  // The records of each thread. Under lock_.
+  struct ThreadRecords {
+    ThreadRecords() : dropped(false) {
+    }
+
+    RecordQueue records;
+    // True once records were dropped, the time of the front record is
+    // then the start of what we know.
+    bool dropped;
+  };
+  typedef std::map<DWORD, ThreadRecords> ThreadRecordsMap;
+  ThreadRecordsMap threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadContextService);
+};
+
+#endif  // SAWBUCK_LOG_LIB_THREAD_CONTEXT_SERVICE_H_
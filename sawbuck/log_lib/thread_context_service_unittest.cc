@@ -0,0 +1,157 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+// Thread context service unittests.
+#include "sawbuck/log_lib/thread_context_service.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+const DWORD kPid = 42;
+const DWORD kTid1 = 1234;
+const DWORD kTid2 = 4321;
+const int kStateWaiting = 5;
+
+typedef IThreadContextService::Record Record;
+
+class MockSchedulerEvents : public KernelSchedulerEvents {
+ public:
+  MOCK_METHOD5(OnContextSwitch, void(const base::Time& time,
+                                     ULONG processor,
+                                     DWORD old_thread_id,
+                                     DWORD new_thread_id,
+                                     int old_thread_state));
+  MOCK_METHOD2(OnThreadReady, void(const base::Time& time,
+                                   DWORD thread_id));
+};
+
+class ThreadContextServiceTest: public testing::Test {
+ public:
+  ThreadContextServiceTest() : kT0(base::Time::Now()) {
+  }
+
+  // @returns kT0 plus @p ms milliseconds.
+  base::Time At(int ms) {
+    return kT0 + base::TimeDelta::FromMilliseconds(ms);
+  }
+
+ protected:
+  const base::Time kT0;
+};
+
+}  // namespace
+
+TEST_F(ThreadContextServiceTest, NoRecords) {
+  ThreadContextService service;
+  std::vector<Record> records;
+  EXPECT_TRUE(service.GetThreadContext(kTid1, At(0), At(10), 10, &records));
+  EXPECT_TRUE(records.empty());
+}
+
+TEST_F(ThreadContextServiceTest, RecordsByThreadAndTime) {
+  ThreadContextService service;
+
+  service.OnContextSwitch(At(0), 1, 0, kTid1, kStateWaiting);
+  service.OnHardFault(kPid, kTid1, At(2), 0x1000, 0x2000);
+  service.OnDiskIo(At(5), kPid, kTid1, false, 0, 0, 4096, 0x3000,
+                   base::TimeDelta::FromMilliseconds(3));
+  service.OnDemandZeroFault(kPid, kTid2, At(6), 0x4000, 0x2000);
+  service.OnContextSwitch(At(8), 1, kTid1, kTid2, kStateWaiting);
+  service.OnThreadReady(At(20), kTid1);
+
+  std::vector<Record> records;
+  EXPECT_TRUE(service.GetThreadContext(kTid1, At(0), At(10), 10, &records));
+  ASSERT_EQ(4U, records.size());
+  EXPECT_EQ(Record::SWITCHED_IN, records[0].kind_);
+  EXPECT_EQ(1U, records[0].processor_);
+  EXPECT_EQ(Record::HARD_FAULT, records[1].kind_);
+  EXPECT_EQ(0x1000, records[1].address_);
+  EXPECT_EQ(Record::DISK_READ, records[2].kind_);
+  EXPECT_EQ(4096U, records[2].byte_count_);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(3), records[2].latency_);
+  EXPECT_EQ(Record::SWITCHED_OUT, records[3].kind_);
+  EXPECT_EQ(kStateWaiting, records[3].thread_state_);
+
+  // The window bounds are inclusive.
+  EXPECT_TRUE(service.GetThreadContext(kTid1, At(2), At(5), 10, &records));
+  ASSERT_EQ(2U, records.size());
+  EXPECT_EQ(At(2), records[0].time_);
+  EXPECT_EQ(At(5), records[1].time_);
+
+  EXPECT_TRUE(service.GetThreadContext(kTid2, At(0), At(10), 10, &records));
+  ASSERT_EQ(2U, records.size());
+  EXPECT_EQ(Record::SOFT_FAULT, records[0].kind_);
+  EXPECT_EQ(Record::SWITCHED_IN, records[1].kind_);
+}
+
+TEST_F(ThreadContextServiceTest, OutOfOrderRecords) {
+  ThreadContextService service;
+
+  service.OnThreadReady(At(10), kTid1);
+  service.OnThreadReady(At(30), kTid1);
+  service.OnHardFault(kPid, kTid1, At(20), 0x1000, 0x2000);
+
+  std::vector<Record> records;
+  EXPECT_TRUE(service.GetThreadContext(kTid1, At(0), At(40), 10, &records));
+  ASSERT_EQ(3U, records.size());
+  EXPECT_EQ(At(10), records[0].time_);
+  EXPECT_EQ(At(20), records[1].time_);
+  EXPECT_EQ(At(30), records[2].time_);
+}
+
+TEST_F(ThreadContextServiceTest, MaxRecordsKeepsTheMiddle) {
+  ThreadContextService service;
+  for (int i = 0; i <= 100; ++i)
+    service.OnThreadReady(At(i), kTid1);
+
+  std::vector<Record> records;
+  EXPECT_TRUE(service.GetThreadContext(kTid1, At(0), At(100), 4, &records));
+  ASSERT_EQ(4U, records.size());
+  EXPECT_EQ(At(48), records[0].time_);
+  EXPECT_EQ(At(51), records[3].time_);
+
+  // Near the end of the records, the window slides back.
+  EXPECT_TRUE(service.GetThreadContext(kTid1, At(90), At(110), 4, &records));
+  ASSERT_EQ(4U, records.size());
+  EXPECT_EQ(At(97), records[0].time_);
+  EXPECT_EQ(At(100), records[3].time_);
+}
+
+TEST_F(ThreadContextServiceTest, DropsOldestRecords) {
+  ThreadContextService service(3);
+  for (int i = 0; i < 5; ++i)
+    service.OnThreadReady(At(i * 10), kTid1);
+
+  std::vector<Record> records;
+  EXPECT_FALSE(service.GetThreadContext(kTid1, At(0), At(50), 10, &records));
+  ASSERT_EQ(3U, records.size());
+  EXPECT_EQ(At(20), records[0].time_);
+
+  // A window past the dropped records is whole.
+  EXPECT_TRUE(service.GetThreadContext(kTid1, At(25), At(50), 10, &records));
+  EXPECT_EQ(2U, records.size());
+}
+
+TEST_F(ThreadContextServiceTest, PassesEventsOn) {
+  ThreadContextService service;
+  testing::StrictMock<MockSchedulerEvents> scheduler;
+  service.set_scheduler_event_sink(&scheduler);
+
+  EXPECT_CALL(scheduler, OnContextSwitch(At(0), 1, 0, kTid1, kStateWaiting));
+  EXPECT_CALL(scheduler, OnThreadReady(At(5), kTid2));
+  service.OnContextSwitch(At(0), 1, 0, kTid1, kStateWaiting);
+  service.OnThreadReady(At(5), kTid2);
+}
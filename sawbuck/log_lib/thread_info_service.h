@@ -0,0 +1,73 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Thread information service declaration.
+#ifndef SAWBUCK_LOG_LIB_THREAD_INFO_SERVICE_H_
+#define SAWBUCK_LOG_LIB_THREAD_INFO_SERVICE_H_
+
+#include <map>
+#include "base/synchronization/lock.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+
+class IThreadInfoService {
+ public:
+  struct ThreadInfo {
+    base::Time started_;
+    base::Time ended_;
+    DWORD thread_id_;
+    DWORD process_id_;
+
+    bool operator == (const ThreadInfo& other) const;
+  };
+
+  // Retrieve info about @p thread_id at @p time. Thread ids are recycled,
+  // so this is the thread that had the id at the time.
+  // @returns true iff info is available, false otherwise.
+  virtual bool GetThreadInfo(DWORD thread_id, const base::Time& time,
+      ThreadInfo* info) = 0;
+};
+
+// The thread info service class sinks thread events from a kernel log
+// parser, and stores away the lifetime and owning process of each thread
+// for later retrieval.
+class ThreadInfoService
+    : public IThreadInfoService,
+      public KernelThreadEvents {
+ public:
+  ThreadInfoService();
+  ~ThreadInfoService();
+
+  // IThreadInfoService implementation.
+  virtual bool GetThreadInfo(DWORD thread_id, const base::Time& time,
+      IThreadInfoService::ThreadInfo* info);
+
+  // KernelThreadEvents implementation.
+  virtual void OnThreadIsRunning(const base::Time& time,
+      const KernelThreadEvents::ThreadInfo& thread_info);
+  virtual void OnThreadStarted(const base::Time& time,
+      const KernelThreadEvents::ThreadInfo& thread_info);
+  virtual void OnThreadEnded(const base::Time& time,
+      const KernelThreadEvents::ThreadInfo& thread_info);
+
+ private:
+  typedef std::pair<DWORD, base::Time> ThreadKey;
+  typedef std::map<ThreadKey, IThreadInfoService::ThreadInfo> ThreadInfoMap;
+  ThreadInfoMap::iterator FindThread(DWORD thread_id,
+      const base::Time& time);
+
+  base::Lock lock_;
+  ThreadInfoMap thread_info_;  // Under lock_.
+};
+
+#endif  // SAWBUCK_LOG_LIB_THREAD_INFO_SERVICE_H_
@@ -0,0 +1,113 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Thread information service unittests.
+#include "sawbuck/log_lib/thread_info_service.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+const DWORD kTid = 0x42;
+const DWORD kPid = 0x99;
+const DWORD kOtherPid = 0x77;
+
+class ThreadInfoServiceTest: public testing::Test {
+ public:
+  ThreadInfoServiceTest() : kT0(base::Time()), kT1(base::Time::Now()),
+      kT2(kT1 + base::TimeDelta::FromMilliseconds(97)),
+      kT3(kT2 + base::TimeDelta::FromMilliseconds(97)) {
+  }
+
+ protected:
+  void RunningThread(DWORD thread_id, DWORD process_id) {
+    KernelThreadEvents::ThreadInfo info = { process_id, thread_id };
+    service_.OnThreadIsRunning(base::Time::Now(), info);
+  }
+
+  void StartThread(const base::Time& time, DWORD thread_id,
+                   DWORD process_id) {
+    KernelThreadEvents::ThreadInfo info = { process_id, thread_id };
+    service_.OnThreadStarted(time, info);
+  }
+
+  void EndThread(const base::Time& time, DWORD thread_id, DWORD process_id) {
+    KernelThreadEvents::ThreadInfo info = { process_id, thread_id };
+    service_.OnThreadEnded(time, info);
+  }
+
+  ThreadInfoService service_;
+  const base::Time kT0;
+  const base::Time kT1;
+  const base::Time kT2;
+  const base::Time kT3;
+};
+
+}  // namespace
+
+TEST_F(ThreadInfoServiceTest, LookupOnEmpty) {
+  IThreadInfoService::ThreadInfo info = {};
+
+  EXPECT_FALSE(service_.GetThreadInfo(0, kT0, &info));
+  EXPECT_FALSE(service_.GetThreadInfo(kTid, kT1, &info));
+}
+
+TEST_F(ThreadInfoServiceTest, IsRunningAndEnds) {
+  RunningThread(kTid, kPid);
+
+  IThreadInfoService::ThreadInfo info = {};
+  EXPECT_TRUE(service_.GetThreadInfo(kTid, kT0, &info));
+  EXPECT_TRUE(kT0 == info.started_);
+  EXPECT_TRUE(kT0 == info.ended_);
+  EXPECT_EQ(kTid, info.thread_id_);
+  EXPECT_EQ(kPid, info.process_id_);
+  EXPECT_TRUE(service_.GetThreadInfo(kTid, kT2, &info));
+
+  EndThread(kT1, kTid, kPid);
+
+  EXPECT_TRUE(service_.GetThreadInfo(kTid, kT0, &info));
+  EXPECT_TRUE(kT1 == info.ended_);
+  EXPECT_FALSE(service_.GetThreadInfo(kTid, kT1, &info));
+  EXPECT_FALSE(service_.GetThreadInfo(kTid, kT2, &info));
+}
+
+TEST_F(ThreadInfoServiceTest, EndStart) {
+  // Signal ending ahead of starting, the result should be as if they came
+  // in order.
+  EndThread(kT2, kTid, kPid);
+  StartThread(kT1, kTid, kPid);
+
+  IThreadInfoService::ThreadInfo info = {};
+  EXPECT_FALSE(service_.GetThreadInfo(kTid, kT0, &info));
+  EXPECT_TRUE(service_.GetThreadInfo(kTid, kT1, &info));
+  EXPECT_TRUE(kT1 == info.started_);
+  EXPECT_TRUE(kT2 == info.ended_);
+  EXPECT_EQ(kPid, info.process_id_);
+  EXPECT_FALSE(service_.GetThreadInfo(kTid, kT2, &info));
+}
+
+TEST_F(ThreadInfoServiceTest, RecycledThreadId) {
+  StartThread(kT1, kTid, kPid);
+  EndThread(kT2, kTid, kPid);
+  // The id goes to a thread of another process.
+  StartThread(kT2, kTid, kOtherPid);
+
+  IThreadInfoService::ThreadInfo info = {};
+  EXPECT_TRUE(service_.GetThreadInfo(kTid, kT1, &info));
+  EXPECT_EQ(kPid, info.process_id_);
+  EXPECT_TRUE(service_.GetThreadInfo(kTid, kT2, &info));
+  EXPECT_EQ(kOtherPid, info.process_id_);
+  EXPECT_TRUE(service_.GetThreadInfo(kTid, kT3, &info));
+  EXPECT_EQ(kOtherPid, info.process_id_);
+  EXPECT_TRUE(kT2 == info.started_);
+}
@@ -0,0 +1,233 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log time stamp formatter implementation.
+#include "sawbuck/log_lib/time_formatter.h"
+
+#include <string.h>
+#include "base/logging.h"
+
+namespace {
+
+const int64 kMicrosecondsPerMillisecond =
+    base::Time::kMicrosecondsPerMillisecond;
+const int64 kMicrosecondsPerSecond = base::Time::kMicrosecondsPerSecond;
+const int64 kSecondsPerMinute = 60;
+const int64 kSecondsPerHour = 60 * kSecondsPerMinute;
+
+// Writes @p value in decimal to @p out, zero padded to @p min_digits.
+// @returns the end of the digits written.
+char* WriteDigits(int64 value, int min_digits, char* out) {
+  DCHECK_LE(0, value);
+
+  char digits[20];
+  int num_digits = 0;
+  do {
+    digits[num_digits++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  while (num_digits < min_digits)
+    digits[num_digits++] = '0';
+
+  while (num_digits > 0)
+    *out++ = digits[--num_digits];
+
+  return out;
+}
+
+// Writes two digits of @p value, which is less than 100.
+inline char* WriteTwoDigits(int value, char* out) {
+  DCHECK_LE(0, value);
+  DCHECK_GT(100, value);
+  *out++ = static_cast<char>('0' + value / 10);
+  *out++ = static_cast<char>('0' + value % 10);
+  return out;
+}
+
+// Writes three digits of @p value, which is less than 1000.
+inline char* WriteThreeDigits(int value, char* out) {
+  DCHECK_LE(0, value);
+  DCHECK_GT(1000, value);
+  *out++ = static_cast<char>('0' + value / 100);
+  return WriteTwoDigits(value % 100, out);
+}
+
+// Reads the decimal digits at @p pos in @p text to @p value, and moves
+// @p pos past them.
+// @returns the number of digits read.
+size_t ReadDigits(const base::StringPiece& text, size_t* pos, int64* value) {
+  size_t start = *pos;
+  *value = 0;
+  while (*pos < text.size() && text[*pos] >= '0' && text[*pos] <= '9' &&
+         *pos - start < 10) {
+    *value = *value * 10 + (text[*pos] - '0');
+    ++*pos;
+  }
+
+  return *pos - start;
+}
+
+}  // namespace
+
+const size_t TimeFormatter::kMaxLength;
+
+TimeFormatter::TimeFormatter()
+    : has_cached_second_(false), cached_second_(0) {
+  memset(cached_clock_, 0, sizeof(cached_clock_));
+}
+
+size_t TimeFormatter::Format(base::Time time, char* buffer) {
+  DCHECK(buffer != NULL);
+  if (base_time_.is_null())
+    return FormatLocal(time, buffer);
+
+  return FormatRelative(time, buffer);
+}
+
+void TimeFormatter::Format(base::Time time, std::string* str) {
+  DCHECK(str != NULL);
+
+  char buffer[kMaxLength];
+  size_t length = Format(time, buffer);
+  str->assign(buffer, length);
+}
+
+bool TimeFormatter::Parse(const base::StringPiece& text,
+                          base::Time day,
+                          base::Time* time) const {
+  DCHECK(time != NULL);
+
+  size_t pos = 0;
+  bool negative = false;
+  if (!base_time_.is_null() && !text.empty() && text[0] == '-') {
+    negative = true;
+    ++pos;
+  }
+
+  // Hours, then minutes and seconds under 60, each after a ':'.
+  int64 hours = 0;
+  if (ReadDigits(text, &pos, &hours) == 0)
+    return false;
+  int64 seconds = hours * kSecondsPerHour;
+  const int64 kMultipliers[] = { kSecondsPerMinute, 1 };
+  for (size_t i = 0; i < arraysize(kMultipliers) && pos < text.size() &&
+           text[pos] == ':'; ++i) {
+    ++pos;
+    int64 value = 0;
+    size_t digits = ReadDigits(text, &pos, &value);
+    if (digits == 0 || digits > 2 || value >= 60)
+      return false;
+    seconds += value * kMultipliers[i];
+  }
+
+  // Then the fraction of the second, read as such, so "-25" is 250ms.
+  int64 microseconds = seconds * kMicrosecondsPerSecond;
+  if (pos < text.size() && (text[pos] == '-' || text[pos] == '.')) {
+    ++pos;
+    int64 scale = kMicrosecondsPerSecond;
+    size_t start = pos;
+    for (; pos < text.size() && text[pos] >= '0' && text[pos] <= '9'; ++pos) {
+      scale /= 10;
+      microseconds += (text[pos] - '0') * scale;
+    }
+    if (pos == start)
+      return false;
+  }
+
+  if (pos != text.size())
+    return false;
+
+  if (!base_time_.is_null()) {
+    base::TimeDelta delta(base::TimeDelta::FromMicroseconds(microseconds));
+    *time = negative ? base_time_ - delta : base_time_ + delta;
+    return true;
+  }
+
+  // Land on that time of day by offsetting from the time of day of @p day.
+  base::Time::Exploded exploded = {};
+  day.LocalExplode(&exploded);
+  int64 day_microseconds =
+      ((exploded.hour * kSecondsPerHour + exploded.minute * kSecondsPerMinute +
+        exploded.second) * 1000 + exploded.millisecond) *
+      kMicrosecondsPerMillisecond;
+  int64 day_start = day.ToInternalValue() -
+      day.ToInternalValue() % kMicrosecondsPerMillisecond - day_microseconds;
+  *time = base::Time::FromInternalValue(day_start + microseconds);
+  return true;
+}
+
+size_t TimeFormatter::FormatLocal(base::Time time, char* buffer) {
+  // Split the time into whole seconds and the rest, rounding down.
+  int64 value = time.ToInternalValue();
+  int64 second = value / kMicrosecondsPerSecond;
+  int64 microseconds = value % kMicrosecondsPerSecond;
+  if (microseconds < 0) {
+    --second;
+    microseconds += kMicrosecondsPerSecond;
+  }
+
+  if (!has_cached_second_ || second != cached_second_) {
+    base::Time::Exploded exploded = {};
+    base::Time::FromInternalValue(second * kMicrosecondsPerSecond).
+        LocalExplode(&exploded);
+
+    char* out = cached_clock_;
+    out = WriteTwoDigits(exploded.hour, out);
+    *out++ = ':';
+    out = WriteTwoDigits(exploded.minute, out);
+    *out++ = ':';
+    out = WriteTwoDigits(exploded.second, out);
+    DCHECK_EQ(cached_clock_ + sizeof(cached_clock_), out);
+
+    has_cached_second_ = true;
+    cached_second_ = second;
+  }
+
+  char* out = buffer;
+  memcpy(out, cached_clock_, sizeof(cached_clock_));
+  out += sizeof(cached_clock_);
+  *out++ = '-';
+  out = WriteThreeDigits(
+      static_cast<int>(microseconds / kMicrosecondsPerMillisecond), out);
+  *out = '\0';
+
+  return out - buffer;
+}
+
+size_t TimeFormatter::FormatRelative(base::Time time, char* buffer) {
+  char* out = buffer;
+  int64 delta = (time - base_time_).ToInternalValue();
+  if (delta < 0) {
+    *out++ = '-';
+    delta = -delta;
+  }
+
+  int64 seconds = delta / kMicrosecondsPerSecond;
+  int milliseconds = static_cast<int>(
+      delta % kMicrosecondsPerSecond / kMicrosecondsPerMillisecond);
+
+  out = WriteDigits(seconds / kSecondsPerHour, 2, out);
+  *out++ = ':';
+  out = WriteTwoDigits(
+      static_cast<int>(seconds / kSecondsPerMinute % 60), out);
+  *out++ = ':';
+  out = WriteTwoDigits(static_cast<int>(seconds % kSecondsPerMinute), out);
+  *out++ = '-';
+  out = WriteThreeDigits(milliseconds, out);
+  *out = '\0';
+
+  DCHECK_GT(buffer + kMaxLength, out);
+  return out - buffer;
+}
@@ -0,0 +1,74 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log time stamp formatter declaration.
+#ifndef SAWBUCK_LOG_LIB_TIME_FORMATTER_H_
+#define SAWBUCK_LOG_LIB_TIME_FORMATTER_H_
+
+#include <string>
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+
+// Formats log time stamps as "HH:MM:SS-mmm", either in local time or
+// relative to a base time. Log messages come in time order, so many in a
+// row share their second. The formatter caches the local time of day for
+// the last second it formatted, and renders the milliseconds with integer
+// arithmetic, so most time stamps are formatted without exploding them.
+// @note not thread safe, as formatting updates the cache.
+class TimeFormatter {
+ public:
+  // The size of a buffer that holds any formatted time, and its zero
+  // terminator.
+  static const size_t kMaxLength = 32;
+
+  TimeFormatter();
+
+  // Formats @p time into @p buffer, zero terminated.
+  // @param buffer a buffer of at least kMaxLength characters.
+  // @returns the length of the formatted time.
+  size_t Format(base::Time time, char* buffer);
+  void Format(base::Time time, std::string* str);
+
+  // Parses @p text, as formatted, back to @p time. Trailing fields may be
+  // left off, e.g. "12:03" or "12:03:15", and the milliseconds may follow
+  // a '.' as well as a '-'. Local times of day fall on the day of @p day,
+  // which is a time of the log being looked at.
+  // @returns true on success.
+  bool Parse(const base::StringPiece& text,
+             base::Time day,
+             base::Time* time) const;
+
+  // Times are formatted relative to the base time, unless it's null.
+  base::Time base_time() const { return base_time_; }
+  void set_base_time(base::Time base_time) { base_time_ = base_time; }
+
+ private:
+  // Formats @p time as a local time of day.
+  size_t FormatLocal(base::Time time, char* buffer);
+  // Formats @p time as a duration since base_time_.
+  size_t FormatRelative(base::Time time, char* buffer);
+
+  base::Time base_time_;
+
+  // The second last formatted in local time, and its time of day as
+  // "HH:MM:SS".
+  bool has_cached_second_;
+  int64 cached_second_;
+  char cached_clock_[8];
+
+  DISALLOW_COPY_AND_ASSIGN(TimeFormatter);
+};
+
+#endif  // SAWBUCK_LOG_LIB_TIME_FORMATTER_H_
@@ -0,0 +1,128 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/log_lib/time_formatter.h"
+
+#include "base/strings/stringprintf.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using base::Time;
+using base::TimeDelta;
+
+// Formats the way the formatter does, the slow way.
+std::string FormatExploded(Time time) {
+  Time::Exploded exploded;
+  time.LocalExplode(&exploded);
+  return base::StringPrintf("%02d:%02d:%02d-%03d",
+                            exploded.hour,
+                            exploded.minute,
+                            exploded.second,
+                            exploded.millisecond);
+}
+
+std::string Format(TimeFormatter* formatter, Time time) {
+  std::string str;
+  formatter->Format(time, &str);
+  return str;
+}
+
+TEST(TimeFormatterTest, LocalTime) {
+  TimeFormatter formatter;
+  EXPECT_TRUE(formatter.base_time().is_null());
+
+  Time start(Time::Now());
+  // Step through a few seconds, back and forth.
+  const int64 kSteps[] = { 0, 1, 999, 1000, 1001, 999999, 1000000, 1000001,
+                           3600000000LL, 17, 59999999, 60000000 };
+  for (size_t i = 0; i < arraysize(kSteps); ++i) {
+    Time time(start + TimeDelta::FromMicroseconds(kSteps[i]));
+    EXPECT_EQ(FormatExploded(time), Format(&formatter, time));
+  }
+
+  char buffer[TimeFormatter::kMaxLength];
+  EXPECT_EQ(12U, formatter.Format(start, buffer));
+  EXPECT_EQ(FormatExploded(start), buffer);
+}
+
+TEST(TimeFormatterTest, RelativeTime) {
+  TimeFormatter formatter;
+  Time base(Time::Now());
+  formatter.set_base_time(base);
+  EXPECT_EQ(base, formatter.base_time());
+
+  EXPECT_EQ("00:00:00-000", Format(&formatter, base));
+  EXPECT_EQ("00:00:00-001",
+            Format(&formatter, base + TimeDelta::FromMicroseconds(1500)));
+  EXPECT_EQ("-00:00:01-250",
+            Format(&formatter, base - TimeDelta::FromMilliseconds(1250)));
+  EXPECT_EQ("01:02:03-004",
+            Format(&formatter, base + TimeDelta::FromHours(1) +
+                   TimeDelta::FromMinutes(2) + TimeDelta::FromSeconds(3) +
+                   TimeDelta::FromMilliseconds(4)));
+  EXPECT_EQ("123:00:59-999",
+            Format(&formatter, base + TimeDelta::FromHours(123) +
+                   TimeDelta::FromMilliseconds(59999)));
+
+  // A null base time goes back to local time.
+  formatter.set_base_time(Time());
+  EXPECT_EQ(FormatExploded(base), Format(&formatter, base));
+}
+
+TEST(TimeFormatterTest, ParseLocalTime) {
+  TimeFormatter formatter;
+  // Start at noon, so the steps below stay in the day.
+  Time day;
+  ASSERT_TRUE(formatter.Parse("12", Time::Now(), &day));
+
+  // Times parse back to themselves, to the millisecond.
+  const int64 kSteps[] = { 0, 999, 1000, 1000000, 3600000000LL, 59999999 };
+  for (size_t i = 0; i < arraysize(kSteps); ++i) {
+    Time time(day + TimeDelta::FromMicroseconds(kSteps[i]));
+    Time parsed;
+    ASSERT_TRUE(formatter.Parse(Format(&formatter, time), day, &parsed));
+    EXPECT_EQ(time.ToInternalValue() / 1000, parsed.ToInternalValue() / 1000);
+    EXPECT_EQ(Format(&formatter, time), Format(&formatter, parsed));
+  }
+
+  // Trailing fields default to zero, and fractions read as such.
+  Time parsed;
+  ASSERT_TRUE(formatter.Parse("12:03", day, &parsed));
+  EXPECT_EQ(FormatExploded(parsed), "12:03:00-000");
+  ASSERT_TRUE(formatter.Parse("12:03:15.25", day, &parsed));
+  EXPECT_EQ(FormatExploded(parsed), "12:03:15-250");
+
+  const char* kInvalid[] = { "", ":03", "12:", "12:60", "12:3:4:5",
+                             "12:03:15-", "-12:03", "12:03 pm" };
+  for (size_t i = 0; i < arraysize(kInvalid); ++i)
+    EXPECT_FALSE(formatter.Parse(kInvalid[i], day, &parsed)) << kInvalid[i];
+}
+
+TEST(TimeFormatterTest, ParseRelativeTime) {
+  TimeFormatter formatter;
+  Time base(Time::Now());
+  formatter.set_base_time(base);
+
+  Time parsed;
+  ASSERT_TRUE(formatter.Parse("01:02:03-004", Time(), &parsed));
+  EXPECT_EQ(base + TimeDelta::FromHours(1) + TimeDelta::FromMinutes(2) +
+                TimeDelta::FromSeconds(3) + TimeDelta::FromMilliseconds(4),
+            parsed);
+  ASSERT_TRUE(formatter.Parse("-00:00:01-250", Time(), &parsed));
+  EXPECT_EQ(base - TimeDelta::FromMilliseconds(1250), parsed);
+  ASSERT_TRUE(formatter.Parse("123", Time(), &parsed));
+  EXPECT_EQ(base + TimeDelta::FromHours(123), parsed);
+}
+
+}  // namespace
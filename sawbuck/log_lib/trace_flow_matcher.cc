@@ -0,0 +1,288 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Trace flow matcher implementation.
+#include "sawbuck/log_lib/trace_flow_matcher.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+// Orders flow stats by total time, largest first.
+bool HasMoreTime(const TraceFlowMatcher::FlowStats& a,
+                 const TraceFlowMatcher::FlowStats& b) {
+  return a.total > b.total;
+}
+
+}  // namespace
+
+const size_t TraceFlowMatcher::kDefaultMaxOpenFlows;
+const int64 TraceFlowMatcher::kDefaultTimeoutMs;
+const size_t TraceFlowMatcher::kMaxHops;
+
+TraceFlowMatcher::TraceFlowMatcher()
+    : max_open_flows_(kDefaultMaxOpenFlows),
+      timeout_(base::TimeDelta::FromMilliseconds(kDefaultTimeoutMs)),
+      open_flow_count_(0), held_end_count_(0), local_flow_count_(0),
+      expired_flow_count_(0), unmatched_end_count_(0),
+      dropped_begin_count_(0) {
+}
+
+TraceFlowMatcher::TraceFlowMatcher(size_t max_open_flows,
+                                   const base::TimeDelta& timeout)
+    : max_open_flows_(max_open_flows), timeout_(timeout),
+      open_flow_count_(0), held_end_count_(0), local_flow_count_(0),
+      expired_flow_count_(0), unmatched_end_count_(0),
+      dropped_begin_count_(0) {
+  DCHECK(timeout > base::TimeDelta());
+}
+
+TraceFlowMatcher::~TraceFlowMatcher() {
+}
+
+bool TraceFlowMatcher::FlowKey::operator<(const FlowKey& o) const {
+  if (name != o.name)
+    return name < o.name;
+  return id < o.id;
+}
+
+void TraceFlowMatcher::GetFlowStats(std::vector<FlowStats>* stats) {
+  DCHECK(stats != NULL);
+  stats->clear();
+
+  base::AutoLock lock(lock_);
+  NameMap::const_iterator it(names_.begin());
+  for (; it != names_.end(); ++it) {
+    const NameHistograms& histograms = it->second;
+    if (histograms.end_to_end.count() == 0)
+      continue;
+
+    FlowStats name_stats;
+    name_stats.name = it->first;
+    name_stats.end_to_end = GetLatencyStats(histograms.end_to_end);
+    for (size_t i = 0; i < histograms.hops.size(); ++i)
+      name_stats.hops.push_back(GetLatencyStats(histograms.hops[i]));
+    name_stats.total = histograms.end_to_end.total();
+    stats->push_back(name_stats);
+  }
+
+  std::sort(stats->begin(), stats->end(), HasMoreTime);
+}
+
+size_t TraceFlowMatcher::open_flow_count() {
+  base::AutoLock lock(lock_);
+  return open_flow_count_;
+}
+
+uint64 TraceFlowMatcher::local_flow_count() {
+  base::AutoLock lock(lock_);
+  return local_flow_count_;
+}
+
+uint64 TraceFlowMatcher::expired_flow_count() {
+  base::AutoLock lock(lock_);
+  return expired_flow_count_;
+}
+
+uint64 TraceFlowMatcher::unmatched_end_count() {
+  base::AutoLock lock(lock_);
+  return unmatched_end_count_;
+}
+
+uint64 TraceFlowMatcher::dropped_begin_count() {
+  base::AutoLock lock(lock_);
+  return dropped_begin_count_;
+}
+
+void TraceFlowMatcher::OnTraceEventBegin(const TraceMessage& trace_message) {
+  base::AutoLock lock(lock_);
+  UpdateTime(trace_message.time);
+
+  FlowKey key = { InternName(trace_message.name, trace_message.name_len),
+                  trace_message.id };
+  OpenFlow flow;
+  flow.begin = trace_message.time;
+  flow.process_id = trace_message.process_id;
+  flow.crossed = false;
+  flow.last = trace_message.time;
+
+  // A begin that's late to arrive closes the oldest end held for it.
+  HeldEndMap::iterator held(held_ends_.find(key));
+  if (held != held_ends_.end()) {
+    std::vector<HeldEnd>& ends = held->second;
+    for (size_t i = 0; i < ends.size(); ++i) {
+      if (ends[i].time < flow.begin)
+        continue;
+
+      HeldEnd end = ends[i];
+      ends.erase(ends.begin() + i);
+      if (ends.empty())
+        held_ends_.erase(held);
+      --held_end_count_;
+      CloseFlow(key, flow, end.process_id, end.time);
+      return;
+    }
+  }
+
+  if (open_flow_count_ >= max_open_flows_) {
+    ++dropped_begin_count_;
+    return;
+  }
+
+  open_flows_[key].push_back(flow);
+  ++open_flow_count_;
+}
+
+void TraceFlowMatcher::OnTraceEventEnd(const TraceMessage& trace_message) {
+  base::AutoLock lock(lock_);
+  UpdateTime(trace_message.time);
+
+  FlowKey key = { InternName(trace_message.name, trace_message.name_len),
+                  trace_message.id };
+  OpenFlowMap::iterator it(open_flows_.find(key));
+  if (it != open_flows_.end()) {
+    DCHECK(!it->second.empty());
+    OpenFlow flow = it->second.back();
+    it->second.pop_back();
+    if (it->second.empty())
+      open_flows_.erase(it);
+    --open_flow_count_;
+
+    CloseFlow(key, flow, trace_message.process_id, trace_message.time);
+    return;
+  }
+
+  // Hold the end for its begin, unless we hold too many.
+  if (held_end_count_ >= max_open_flows_) {
+    ++unmatched_end_count_;
+    return;
+  }
+  HeldEnd end = { trace_message.time, trace_message.process_id };
+  held_ends_[key].push_back(end);
+  ++held_end_count_;
+}
+
+void TraceFlowMatcher::OnTraceEventInstant(
+    const TraceMessage& trace_message) {
+  base::AutoLock lock(lock_);
+  UpdateTime(trace_message.time);
+
+  FlowKey key = { InternName(trace_message.name, trace_message.name_len),
+                  trace_message.id };
+  OpenFlowMap::iterator it(open_flows_.find(key));
+  if (it == open_flows_.end())
+    return;
+
+  // A step goes to the latest flow of its key.
+  OpenFlow& flow = it->second.back();
+  if (trace_message.process_id != flow.process_id)
+    flow.crossed = true;
+  // Leave room for the hop to the end.
+  if (flow.hops.size() + 1 < kMaxHops) {
+    flow.hops.push_back(trace_message.time - flow.last);
+    flow.last = trace_message.time;
+  }
+}
+
+const std::string* TraceFlowMatcher::InternName(const char* name,
+                                                size_t name_len) {
+  lock_.AssertAcquired();
+
+  std::string key(name, name_len);
+  NameMap::iterator it(names_.find(key));
+  if (it == names_.end())
+    it = names_.insert(std::make_pair(key, NameHistograms())).first;
+
+  return &it->first;
+}
+
+void TraceFlowMatcher::CloseFlow(const FlowKey& key,
+                                 const OpenFlow& flow,
+                                 DWORD process_id,
+                                 const base::Time& time) {
+  lock_.AssertAcquired();
+
+  if (!flow.crossed && process_id == flow.process_id) {
+    ++local_flow_count_;
+    return;
+  }
+
+  NameHistograms& histograms = names_[*key.name];
+  histograms.end_to_end.Add(time - flow.begin);
+  size_t hop_count = flow.hops.size() + 1;
+  if (histograms.hops.size() < hop_count)
+    histograms.hops.resize(hop_count);
+  for (size_t i = 0; i < flow.hops.size(); ++i)
+    histograms.hops[i].Add(flow.hops[i]);
+  histograms.hops[flow.hops.size()].Add(time - flow.last);
+}
+
+void TraceFlowMatcher::UpdateTime(const base::Time& time) {
+  lock_.AssertAcquired();
+
+  latest_ = std::max(latest_, time);
+  // Release a quarter of the timeout apart, so that the cost of the scans
+  // spreads over the events in between.
+  if (!last_release_.is_null() && latest_ - last_release_ < timeout_ / 4)
+    return;
+  last_release_ = latest_;
+
+  base::Time cutoff(latest_ - timeout_);
+  OpenFlowMap::iterator flows(open_flows_.begin());
+  while (flows != open_flows_.end()) {
+    std::vector<OpenFlow>& open = flows->second;
+    size_t kept = 0;
+    for (size_t i = 0; i < open.size(); ++i) {
+      if (open[i].begin >= cutoff)
+        open[kept++] = open[i];
+    }
+    size_t released = open.size() - kept;
+    open.resize(kept);
+    expired_flow_count_ += released;
+    open_flow_count_ -= released;
+    if (open.empty())
+      open_flows_.erase(flows++);
+    else
+      ++flows;
+  }
+
+  HeldEndMap::iterator ends(held_ends_.begin());
+  while (ends != held_ends_.end()) {
+    std::vector<HeldEnd>& held = ends->second;
+    size_t kept = 0;
+    for (size_t i = 0; i < held.size(); ++i) {
+      if (held[i].time >= cutoff)
+        held[kept++] = held[i];
+    }
+    size_t released = held.size() - kept;
+    held.resize(kept);
+    unmatched_end_count_ += released;
+    held_end_count_ -= released;
+    if (held.empty())
+      held_ends_.erase(ends++);
+    else
+      ++ends;
+  }
+}
+
+TraceFlowMatcher::LatencyStats TraceFlowMatcher::GetLatencyStats(
+    const LatencyHistogram& histogram) {
+  LatencyStats stats;
+  stats.count = histogram.count();
+  stats.p50 = histogram.GetPercentile(50);
+  stats.p95 = histogram.GetPercentile(95);
+  stats.max = histogram.max();
+  return stats;
+}
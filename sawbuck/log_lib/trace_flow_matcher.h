@@ -0,0 +1,167 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Trace flow matcher declaration.
+#ifndef SAWBUCK_LOG_LIB_TRACE_FLOW_MATCHER_H_
+#define SAWBUCK_LOG_LIB_TRACE_FLOW_MATCHER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "base/synchronization/lock.h"
+#include "sawbuck/log_lib/latency_histogram.h"
+#include "sawbuck/log_lib/log_consumer.h"
+
+// The trace flow matcher sinks the trace events of a log parser, and
+// follows the async flows that cross processes, such as an IPC begun in
+// one process and ended in another, which the span matcher keys apart by
+// process. A flow is keyed by its name and id alone: it opens with a begin
+// event, takes the instant events of its key as steps, and closes with an
+// end event. The time from each event of a flow to the next is a hop.
+// It keeps histograms of the end to end latency of the flows of each name,
+// and of each of their first kMaxHops hops, and counts the flows that end
+// in the process they began in, with no steps elsewhere, as local rather
+// than tallying them, as those are the span matcher's.
+// The events of different processes reach us out of order, so an end that
+// matches no flow is held a while for a begin that's late to arrive.
+// Flows open, and ends held, past the timeout are released, and past the
+// most open flows begin events are dropped, so that our memory grows with
+// the flows in flight, rather than with those that never end.
+// @note this class is thread safe.
+class TraceFlowMatcher : public TraceEvents {
+ public:
+  // The default most flows we hold open, and ends we hold unmatched.
+  static const size_t kDefaultMaxOpenFlows = 64 * 1024;
+  // The default time a flow may take to end, and an end take to match.
+  static const int64 kDefaultTimeoutMs = 10 * 1000;
+  // The hops of a flow we tell apart. The steps past these are ignored,
+  // so that the last hop runs to the flow's end.
+  static const size_t kMaxHops = 8;
+
+  // The latencies of a hop, or of the flows end to end.
+  struct LatencyStats {
+    uint64 count;
+    base::TimeDelta p50;
+    base::TimeDelta p95;
+    base::TimeDelta max;
+  };
+
+  struct FlowStats {
+    std::string name;
+    LatencyStats end_to_end;
+    // The hops from the begin event, in order, as far as any flow of the
+    // name got.
+    std::vector<LatencyStats> hops;
+    // The total time of the flows end to end.
+    base::TimeDelta total;
+  };
+
+  TraceFlowMatcher();
+  TraceFlowMatcher(size_t max_open_flows, const base::TimeDelta& timeout);
+  ~TraceFlowMatcher();
+
+  // Retrieves the latency statistics of the cross process flows of each
+  // name, in order of the total time spent in the flows, largest first, to
+  // @p stats.
+  void GetFlowStats(std::vector<FlowStats>* stats);
+
+  // @returns the number of flows yet to end.
+  size_t open_flow_count();
+  // @returns the number of flows that ended in the process they began in.
+  uint64 local_flow_count();
+  // @returns the number of flows released for not ending in time.
+  uint64 expired_flow_count();
+  // @returns the number of end events that matched no begin event in time.
+  uint64 unmatched_end_count();
+  // @returns the number of begin events dropped for too many open flows.
+  uint64 dropped_begin_count();
+
+  // TraceEvents implementation.
+  virtual void OnTraceEventBegin(const TraceMessage& trace_message);
+  virtual void OnTraceEventEnd(const TraceMessage& trace_message);
+  virtual void OnTraceEventInstant(const TraceMessage& trace_message);
+
+ private:
+  struct FlowKey {
+    bool operator<(const FlowKey& o) const;
+
+    const std::string* name;
+    void* id;
+  };
+  struct OpenFlow {
+    base::Time begin;
+    DWORD process_id;
+    // True once a step came from another process.
+    bool crossed;
+    // The time of the latest event of the flow, and the hops up to it.
+    base::Time last;
+    std::vector<base::TimeDelta> hops;
+  };
+  struct HeldEnd {
+    base::Time time;
+    DWORD process_id;
+  };
+  // The open flows of a key, latest last.
+  typedef std::map<FlowKey, std::vector<OpenFlow> > OpenFlowMap;
+  // The ends held of a key, latest last.
+  typedef std::map<FlowKey, std::vector<HeldEnd> > HeldEndMap;
+
+  // The histograms of the flows of a name.
+  struct NameHistograms {
+    LatencyHistogram end_to_end;
+    std::vector<LatencyHistogram> hops;
+  };
+
+  // @returns the interned @p name.
+  // @pre lock_ is held.
+  const std::string* InternName(const char* name, size_t name_len);
+
+  // Closes @p flow of @p key with an end in @p process_id at @p time.
+  // @pre lock_ is held.
+  void CloseFlow(const FlowKey& key, const OpenFlow& flow, DWORD process_id,
+                 const base::Time& time);
+
+  // Notes the time of the latest event, releasing the flows and ends past
+  // the timeout every so often.
+  // @pre lock_ is held.
+  void UpdateTime(const base::Time& time);
+
+  static LatencyStats GetLatencyStats(const LatencyHistogram& histogram);
+
+  const size_t max_open_flows_;
+  const base::TimeDelta timeout_;
+
+  base::Lock lock_;
+
+  // The flow names and their histograms. The names are never released,
+  // so the keys compare them by address. Under lock_.
+  typedef std::map<std::string, NameHistograms> NameMap;
+  NameMap names_;
+
+  OpenFlowMap open_flows_;  // Under lock_.
+  HeldEndMap held_ends_;  // Under lock_.
+  size_t open_flow_count_;  // Under lock_.
+  size_t held_end_count_;  // Under lock_.
+  // The latest event time, and the time of the last release. Under lock_.
+  base::Time latest_;
+  base::Time last_release_;
+  uint64 local_flow_count_;  // Under lock_.
+  uint64 expired_flow_count_;  // Under lock_.
+  uint64 unmatched_end_count_;  // Under lock_.
+  uint64 dropped_begin_count_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(TraceFlowMatcher);
+};
+
+#endif  // SAWBUCK_LOG_LIB_TRACE_FLOW_MATCHER_H_
@@ -0,0 +1,186 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Trace flow matcher unittests.
+#include "sawbuck/log_lib/trace_flow_matcher.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const DWORD kBrowserPid = 1234;
+const DWORD kRendererPid = 5678;
+const DWORD kTid = 4321;
+
+class TraceFlowMatcherTest: public testing::Test {
+ public:
+  TraceFlowMatcherTest()
+      : matcher_(4, base::TimeDelta::FromSeconds(1)),
+        kT0(base::Time::Now()) {
+  }
+
+  // Makes a trace message for @p name and @p id in @p pid at @p ms
+  // milliseconds past kT0.
+  TraceEvents::TraceMessage Message(DWORD pid, const char* name, int id,
+                                    int ms) {
+    TraceEvents::TraceMessage message;
+    message.time = kT0 + base::TimeDelta::FromMilliseconds(ms);
+    message.process_id = pid;
+    message.thread_id = kTid;
+    message.name = name;
+    message.name_len = strlen(name);
+    message.id = reinterpret_cast<void*>(id);
+    return message;
+  }
+
+  void Begin(DWORD pid, const char* name, int id, int ms) {
+    matcher_.OnTraceEventBegin(Message(pid, name, id, ms));
+  }
+  void Instant(DWORD pid, const char* name, int id, int ms) {
+    matcher_.OnTraceEventInstant(Message(pid, name, id, ms));
+  }
+  void End(DWORD pid, const char* name, int id, int ms) {
+    matcher_.OnTraceEventEnd(Message(pid, name, id, ms));
+  }
+
+ protected:
+  TraceFlowMatcher matcher_;
+  const base::Time kT0;
+};
+
+}  // namespace
+
+TEST_F(TraceFlowMatcherTest, MatchesFlowsAcrossProcesses) {
+  // Two flows of the same name, interleaved, with a step each.
+  Begin(kBrowserPid, "Ipc", 1, 0);
+  Begin(kBrowserPid, "Ipc", 2, 5);
+  Instant(kRendererPid, "Ipc", 1, 10);
+  Instant(kRendererPid, "Ipc", 2, 25);
+  End(kBrowserPid, "Ipc", 1, 40);
+  End(kBrowserPid, "Ipc", 2, 45);
+  // A flow of another name, with no steps.
+  Begin(kBrowserPid, "Paint", 1, 50);
+  End(kRendererPid, "Paint", 1, 53);
+  EXPECT_EQ(0U, matcher_.open_flow_count());
+  EXPECT_EQ(0U, matcher_.local_flow_count());
+
+  std::vector<TraceFlowMatcher::FlowStats> stats;
+  matcher_.GetFlowStats(&stats);
+  ASSERT_EQ(2U, stats.size());
+
+  const TraceFlowMatcher::FlowStats& ipc = stats[0];
+  EXPECT_EQ("Ipc", ipc.name);
+  EXPECT_EQ(2U, ipc.end_to_end.count);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(80), ipc.total);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(40), ipc.end_to_end.max);
+  ASSERT_EQ(2U, ipc.hops.size());
+  EXPECT_EQ(2U, ipc.hops[0].count);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(20), ipc.hops[0].max);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(30), ipc.hops[1].max);
+
+  EXPECT_EQ("Paint", stats[1].name);
+  EXPECT_EQ(1U, stats[1].end_to_end.count);
+  ASSERT_EQ(1U, stats[1].hops.size());
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(3), stats[1].hops[0].max);
+}
+
+TEST_F(TraceFlowMatcherTest, CountsLocalFlows) {
+  Begin(kBrowserPid, "Ipc", 1, 0);
+  Instant(kBrowserPid, "Ipc", 1, 5);
+  End(kBrowserPid, "Ipc", 1, 10);
+  EXPECT_EQ(1U, matcher_.local_flow_count());
+
+  std::vector<TraceFlowMatcher::FlowStats> stats;
+  matcher_.GetFlowStats(&stats);
+  EXPECT_TRUE(stats.empty());
+
+  // A step elsewhere makes a flow cross processes, even if it ends home.
+  Begin(kBrowserPid, "Ipc", 1, 20);
+  Instant(kRendererPid, "Ipc", 1, 25);
+  End(kBrowserPid, "Ipc", 1, 30);
+  EXPECT_EQ(1U, matcher_.local_flow_count());
+  matcher_.GetFlowStats(&stats);
+  ASSERT_EQ(1U, stats.size());
+  EXPECT_EQ(1U, stats[0].end_to_end.count);
+}
+
+TEST_F(TraceFlowMatcherTest, MatchesLateBegins) {
+  // The end arrives before its begin.
+  End(kRendererPid, "Ipc", 1, 30);
+  EXPECT_EQ(0U, matcher_.open_flow_count());
+  Begin(kBrowserPid, "Ipc", 1, 10);
+  EXPECT_EQ(0U, matcher_.open_flow_count());
+
+  std::vector<TraceFlowMatcher::FlowStats> stats;
+  matcher_.GetFlowStats(&stats);
+  ASSERT_EQ(1U, stats.size());
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(20), stats[0].total);
+
+  // A held end doesn't match a begin after it.
+  End(kRendererPid, "Ipc", 2, 40);
+  Begin(kBrowserPid, "Ipc", 2, 50);
+  EXPECT_EQ(1U, matcher_.open_flow_count());
+}
+
+TEST_F(TraceFlowMatcherTest, ReleasesFlowsPastTimeout) {
+  Begin(kBrowserPid, "Ipc", 1, 0);
+  End(kRendererPid, "Ipc", 2, 100);
+  EXPECT_EQ(1U, matcher_.open_flow_count());
+
+  // Events well past the timeout release the flow and the held end.
+  Begin(kBrowserPid, "Ipc", 3, 2000);
+  EXPECT_EQ(1U, matcher_.open_flow_count());
+  EXPECT_EQ(1U, matcher_.expired_flow_count());
+  EXPECT_EQ(1U, matcher_.unmatched_end_count());
+
+  // The released flow no longer ends.
+  End(kRendererPid, "Ipc", 1, 2100);
+  Begin(kBrowserPid, "Ipc", 2, 2200);
+  std::vector<TraceFlowMatcher::FlowStats> stats;
+  matcher_.GetFlowStats(&stats);
+  EXPECT_TRUE(stats.empty());
+}
+
+TEST_F(TraceFlowMatcherTest, DropsBeginsPastMaxOpenFlows) {
+  for (int i = 0; i < 6; ++i)
+    Begin(kBrowserPid, "Ipc", i, i);
+  EXPECT_EQ(4U, matcher_.open_flow_count());
+  EXPECT_EQ(2U, matcher_.dropped_begin_count());
+
+  // The ends of the dropped begins are held in their stead.
+  End(kRendererPid, "Ipc", 5, 10);
+  End(kRendererPid, "Ipc", 0, 11);
+  EXPECT_EQ(3U, matcher_.open_flow_count());
+
+  std::vector<TraceFlowMatcher::FlowStats> stats;
+  matcher_.GetFlowStats(&stats);
+  ASSERT_EQ(1U, stats.size());
+  EXPECT_EQ(1U, stats[0].end_to_end.count);
+}
+
+TEST_F(TraceFlowMatcherTest, CapsHops) {
+  Begin(kBrowserPid, "Ipc", 1, 0);
+  for (int i = 1; i <= 20; ++i)
+    Instant(i % 2 ? kRendererPid : kBrowserPid, "Ipc", 1, i);
+  End(kBrowserPid, "Ipc", 1, 30);
+
+  std::vector<TraceFlowMatcher::FlowStats> stats;
+  matcher_.GetFlowStats(&stats);
+  ASSERT_EQ(1U, stats.size());
+  ASSERT_EQ(TraceFlowMatcher::kMaxHops, stats[0].hops.size());
+  // The last hop runs from the last step told apart to the end.
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(
+                30 - static_cast<int>(TraceFlowMatcher::kMaxHops) + 1),
+            stats[0].hops.back().max);
+}
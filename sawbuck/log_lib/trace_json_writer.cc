@@ -0,0 +1,228 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Trace JSON writer implementation.
+#include "sawbuck/log_lib/trace_json_writer.h"
+
+#include <algorithm>
+#include "base/logging.h"
+#include "base/strings/utf_string_conversions.h"
+#include "sawbuck/log_lib/process_info_service.h"
+
+namespace {
+
+const char kHeader[] = "{\"traceEvents\":[";
+const char kFooter[] = "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+const char kHexDigits[] = "0123456789abcdef";
+
+// The smallest output buffer we use.
+const size_t kMinBufferSize = 256;
+
+// @returns the file name of the image @p command_line starts with, which
+//     is quoted if it has spaces.
+std::string GetImageFileName(const std::wstring& command_line) {
+  std::wstring image;
+  if (!command_line.empty() && command_line[0] == L'"') {
+    size_t end = command_line.find(L'"', 1);
+    image = command_line.substr(1, end == std::wstring::npos ?
+        std::wstring::npos : end - 1);
+  } else {
+    image = command_line.substr(0, command_line.find_first_of(L" \t"));
+  }
+
+  size_t separator = image.find_last_of(L"\\/:");
+  if (separator != std::wstring::npos)
+    image = image.substr(separator + 1);
+  return base::WideToUTF8(image);
+}
+
+}  // namespace
+
+TraceJsonWriter::TraceJsonWriter(LogExportWriter::Output* output,
+                                 size_t buffer_size)
+    : output_(output),
+      process_info_service_(NULL),
+      buffer_size_(std::max(buffer_size, kMinBufferSize)),
+      num_events_(0),
+      num_spans_(0),
+      finished_(false),
+      failed_(false) {
+  DCHECK(output != NULL);
+  buffer_.reserve(buffer_size_);
+
+  Append(kHeader, arraysize(kHeader) - 1);
+}
+
+TraceJsonWriter::~TraceJsonWriter() {
+  if (!finished_)
+    Finish();
+}
+
+void TraceJsonWriter::WriteSpan(DWORD process_id,
+                                DWORD thread_id,
+                                const base::StringPiece& name,
+                                const base::Time& begin,
+                                const base::Time& end,
+                                size_t depth) {
+  DCHECK(!finished_);
+  WriteProcessName(process_id, begin);
+
+  ++num_spans_;
+  BeginEvent();
+  Append("{\"name\":");
+  AppendJsonString(name);
+  Append(",\"ph\":\"X\",\"ts\":");
+  AppendTime(begin);
+  Append(",\"dur\":");
+  // Spans that end before they begin are clock skew, and shown as instants.
+  AppendInt(std::max(static_cast<int64>(0), (end - begin).InMicroseconds()));
+  Append(",\"pid\":");
+  AppendInt(process_id);
+  Append(",\"tid\":");
+  AppendInt(thread_id);
+  Append(",\"args\":{\"depth\":");
+  AppendInt(depth);
+  Append("}}");
+}
+
+bool TraceJsonWriter::Finish() {
+  DCHECK(!finished_);
+  finished_ = true;
+
+  Append(kFooter, arraysize(kFooter) - 1);
+  WriteBuffer();
+  return !failed_;
+}
+
+void TraceJsonWriter::OnTraceSpan(const TraceSpan& span) {
+  DCHECK(span.name != NULL);
+  WriteSpan(span.process_id, span.begin_thread_id, *span.name, span.begin,
+            span.end, span.depth);
+}
+
+void TraceJsonWriter::WriteProcessName(DWORD process_id,
+                                       const base::Time& time) {
+  if (process_info_service_ == NULL ||
+      !named_processes_.insert(process_id).second) {
+    return;
+  }
+
+  IProcessInfoService::ProcessInfo info;
+  if (!process_info_service_->GetProcessInfo(process_id, time, &info))
+    return;
+  std::string name = GetImageFileName(info.command_line_);
+  if (name.empty())
+    return;
+
+  BeginEvent();
+  Append("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":");
+  AppendInt(process_id);
+  Append(",\"args\":{\"name\":");
+  AppendJsonString(name);
+  Append("}}");
+}
+
+void TraceJsonWriter::BeginEvent() {
+  if (num_events_++ != 0)
+    AppendChar(',');
+  AppendChar('\n');
+}
+
+void TraceJsonWriter::Append(const char* data, size_t len) {
+  if (buffer_.size() + len > buffer_size_) {
+    WriteBuffer();
+
+    // Don't bother buffering what wouldn't fit anyway.
+    if (len > buffer_size_) {
+      if (!failed_ && !output_->Write(data, len))
+        failed_ = true;
+      return;
+    }
+  }
+
+  buffer_.insert(buffer_.end(), data, data + len);
+}
+
+void TraceJsonWriter::AppendChar(char c) {
+  if (buffer_.size() == buffer_size_)
+    WriteBuffer();
+  buffer_.push_back(c);
+}
+
+void TraceJsonWriter::AppendInt(int64 value) {
+  uint64 magnitude = value < 0 ? 0 - static_cast<uint64>(value) : value;
+  char digits[21];
+  size_t len = 0;
+  do {
+    digits[sizeof(digits) - ++len] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (value < 0)
+    digits[sizeof(digits) - ++len] = '-';
+
+  Append(digits + sizeof(digits) - len, len);
+}
+
+void TraceJsonWriter::AppendTime(const base::Time& time) {
+  AppendInt((time - base::Time::UnixEpoch()).InMicroseconds());
+}
+
+void TraceJsonWriter::AppendJsonString(const base::StringPiece& str) {
+  AppendChar('"');
+  size_t start = 0;
+  for (size_t i = 0; i < str.size(); ++i) {
+    unsigned char c = static_cast<unsigned char>(str[i]);
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+
+    // Write out the run before the character, then escape it.
+    Append(str.data() + start, i - start);
+    start = i + 1;
+    switch (c) {
+      case '"':
+        Append("\\\"");
+        break;
+      case '\\':
+        Append("\\\\");
+        break;
+      case '\n':
+        Append("\\n");
+        break;
+      case '\r':
+        Append("\\r");
+        break;
+      case '\t':
+        Append("\\t");
+        break;
+      default: {
+        char escape[] = { '\\', 'u', '0', '0',
+                          kHexDigits[c >> 4], kHexDigits[c & 0xF] };
+        Append(escape, arraysize(escape));
+        break;
+      }
+    }
+  }
+  Append(str.data() + start, str.size() - start);
+  AppendChar('"');
+}
+
+void TraceJsonWriter::WriteBuffer() {
+  if (buffer_.empty())
+    return;
+
+  if (!failed_ && !output_->Write(&buffer_[0], buffer_.size()))
+    failed_ = true;
+  buffer_.clear();
+}
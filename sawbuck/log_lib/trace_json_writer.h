@@ -0,0 +1,113 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Trace JSON writer declaration.
+#ifndef SAWBUCK_LOG_LIB_TRACE_JSON_WRITER_H_
+#define SAWBUCK_LOG_LIB_TRACE_JSON_WRITER_H_
+
+#include <set>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+#include "sawbuck/log_lib/log_export_writer.h"
+#include "sawbuck/log_lib/trace_span_matcher.h"
+
+class IProcessInfoService;
+
+// Writes trace spans out in the trace event JSON format that
+// chrome://tracing and the Perfetto UI open, as an object with a
+// "traceEvents" array. Each span is a complete, "X", event with its name,
+// process, the thread it began on, and its begin time and duration in
+// microseconds since the Unix epoch. The first span of each process is
+// preceded by a "process_name" metadata event, named for the image of the
+// process, if the process info service knows it.
+//
+// The events are formatted into a buffer that's sized up front and written
+// out whenever it fills, so the memory we use is bounded by the buffer and
+// the set of processes seen, however many spans are written.
+class TraceJsonWriter : public TraceSpanEvents {
+ public:
+  // @param output receives the output, and must outlive us.
+  // @param buffer_size the size of the output buffer.
+  TraceJsonWriter(LogExportWriter::Output* output, size_t buffer_size);
+  // Finishes the output, if not already finished.
+  ~TraceJsonWriter();
+
+  // Sets the service the process names are looked up from, which must
+  // outlive us. May be NULL, the default, for no process names.
+  void set_process_info_service(IProcessInfoService* process_info_service) {
+    process_info_service_ = process_info_service;
+  }
+
+  // Writes a span of @p name, from @p begin to @p end, begun on
+  // @p thread_id of @p process_id with @p depth spans open.
+  void WriteSpan(DWORD process_id,
+                 DWORD thread_id,
+                 const base::StringPiece& name,
+                 const base::Time& begin,
+                 const base::Time& end,
+                 size_t depth);
+
+  // Closes the event array and writes out what's buffered. No spans may be
+  // written after.
+  // @returns false if the output has failed, now or before.
+  bool Finish();
+
+  // The number of spans written so far.
+  size_t num_spans() const { return num_spans_; }
+  bool failed() const { return failed_; }
+
+  // TraceSpanEvents implementation.
+  virtual void OnTraceSpan(const TraceSpan& span);
+
+ private:
+  // Writes the process name metadata of @p process_id, as of @p time, the
+  // first time round for each process.
+  void WriteProcessName(DWORD process_id, const base::Time& time);
+  // Starts a new event in the array.
+  void BeginEvent();
+
+  // Appends to the buffer, writing it out first if it's too full.
+  void Append(const char* data, size_t len);
+  void Append(const base::StringPiece& str) { Append(str.data(), str.size()); }
+  void AppendChar(char c);
+  void AppendInt(int64 value);
+  // Appends @p time in microseconds since the Unix epoch.
+  void AppendTime(const base::Time& time);
+  // Appends @p str as a quoted JSON string.
+  void AppendJsonString(const base::StringPiece& str);
+
+  // Writes out the buffer.
+  void WriteBuffer();
+
+  LogExportWriter::Output* output_;
+  IProcessInfoService* process_info_service_;
+
+  // The output buffer, reserved to its size up front.
+  std::vector<char> buffer_;
+  size_t buffer_size_;
+
+  // The processes whose names we've looked up.
+  std::set<DWORD> named_processes_;
+
+  size_t num_events_;
+  size_t num_spans_;
+  bool finished_;
+  bool failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceJsonWriter);
+};
+
+#endif  // SAWBUCK_LOG_LIB_TRACE_JSON_WRITER_H_
@@ -0,0 +1,191 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Trace JSON writer unittests.
+#include "sawbuck/log_lib/trace_json_writer.h"
+
+#include <map>
+#include "gtest/gtest.h"
+#include "sawbuck/log_lib/process_info_service.h"
+
+namespace {
+
+class StringOutput : public LogExportWriter::Output {
+ public:
+  StringOutput() : num_writes_(0), fail_(false) {
+  }
+
+  virtual bool Write(const char* data, size_t len) {
+    ++num_writes_;
+    str_.append(data, len);
+    return !fail_;
+  }
+
+  const std::string& str() const { return str_; }
+  size_t num_writes() const { return num_writes_; }
+  void set_fail(bool fail) { fail_ = fail; }
+
+ private:
+  std::string str_;
+  size_t num_writes_;
+  bool fail_;
+};
+
+// Knows the command lines of the processes added to it, and counts the
+// lookups.
+class FakeProcessInfoService : public IProcessInfoService {
+ public:
+  FakeProcessInfoService() : num_lookups_(0) {
+  }
+
+  void AddProcess(DWORD process_id, const wchar_t* command_line) {
+    command_lines_[process_id] = command_line;
+  }
+
+  virtual bool GetProcessInfo(DWORD process_id, const base::Time& time,
+                              ProcessInfo* info) {
+    ++num_lookups_;
+    std::map<DWORD, std::wstring>::const_iterator it(
+        command_lines_.find(process_id));
+    if (it == command_lines_.end())
+      return false;
+
+    info->process_id_ = process_id;
+    info->command_line_ = it->second;
+    return true;
+  }
+
+  int num_lookups() const { return num_lookups_; }
+
+ private:
+  std::map<DWORD, std::wstring> command_lines_;
+  int num_lookups_;
+};
+
+// @returns the time @p us microseconds past the Unix epoch.
+base::Time UnixMicroseconds(int64 us) {
+  return base::Time::UnixEpoch() + base::TimeDelta::FromMicroseconds(us);
+}
+
+}  // namespace
+
+TEST(TraceJsonWriterTest, Empty) {
+  StringOutput output;
+  TraceJsonWriter writer(&output, LogExportWriter::kDefaultBufferSize);
+  EXPECT_TRUE(writer.Finish());
+
+  EXPECT_EQ("{\"traceEvents\":[\n],\"displayTimeUnit\":\"ms\"}\n",
+            output.str());
+  EXPECT_EQ(0, writer.num_spans());
+}
+
+TEST(TraceJsonWriterTest, WriteSpans) {
+  StringOutput output;
+  TraceJsonWriter writer(&output, LogExportWriter::kDefaultBufferSize);
+  writer.WriteSpan(10, 11, "Outer \"span\"", UnixMicroseconds(1000),
+                   UnixMicroseconds(3500), 0);
+  // A span that ends before it begins is written with no duration.
+  writer.WriteSpan(10, 12, "Skewed", UnixMicroseconds(5000),
+                   UnixMicroseconds(4000), 1);
+  EXPECT_TRUE(output.str().empty());
+  EXPECT_TRUE(writer.Finish());
+
+  EXPECT_EQ("{\"traceEvents\":[\n"
+            "{\"name\":\"Outer \\\"span\\\"\",\"ph\":\"X\",\"ts\":1000,"
+                "\"dur\":2500,\"pid\":10,\"tid\":11,\"args\":{\"depth\":0}},\n"
+            "{\"name\":\"Skewed\",\"ph\":\"X\",\"ts\":5000,"
+                "\"dur\":0,\"pid\":10,\"tid\":12,\"args\":{\"depth\":1}}\n"
+            "],\"displayTimeUnit\":\"ms\"}\n",
+            output.str());
+  EXPECT_EQ(2, writer.num_spans());
+}
+
+TEST(TraceJsonWriterTest, OnTraceSpan) {
+  StringOutput output;
+  {
+    TraceJsonWriter writer(&output, LogExportWriter::kDefaultBufferSize);
+    std::string name("Span");
+    TraceSpanEvents::TraceSpan span = {
+        20, 21, 22, &name, NULL, UnixMicroseconds(7), UnixMicroseconds(9), 2 };
+    writer.OnTraceSpan(span);
+    // The writer finishes the output as it goes.
+  }
+
+  EXPECT_EQ("{\"traceEvents\":[\n"
+            "{\"name\":\"Span\",\"ph\":\"X\",\"ts\":7,"
+                "\"dur\":2,\"pid\":20,\"tid\":21,\"args\":{\"depth\":2}}\n"
+            "],\"displayTimeUnit\":\"ms\"}\n",
+            output.str());
+}
+
+TEST(TraceJsonWriterTest, ProcessNames) {
+  FakeProcessInfoService process_info;
+  process_info.AddProcess(10, L"\"c:\\program files\\app\\app.exe\" --flag");
+  process_info.AddProcess(20, L"");
+
+  StringOutput output;
+  TraceJsonWriter writer(&output, LogExportWriter::kDefaultBufferSize);
+  writer.set_process_info_service(&process_info);
+  writer.WriteSpan(10, 11, "A", UnixMicroseconds(1), UnixMicroseconds(2), 0);
+  writer.WriteSpan(10, 11, "B", UnixMicroseconds(3), UnixMicroseconds(4), 0);
+  // Neither an unknown process nor one with no image are named.
+  writer.WriteSpan(20, 21, "C", UnixMicroseconds(5), UnixMicroseconds(6), 0);
+  writer.WriteSpan(30, 31, "D", UnixMicroseconds(7), UnixMicroseconds(8), 0);
+  writer.WriteSpan(30, 31, "E", UnixMicroseconds(9), UnixMicroseconds(10), 0);
+  EXPECT_TRUE(writer.Finish());
+
+  // Each process is looked up once.
+  EXPECT_EQ(3, process_info.num_lookups());
+  EXPECT_EQ("{\"traceEvents\":[\n"
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":10,"
+                "\"args\":{\"name\":\"app.exe\"}},\n"
+            "{\"name\":\"A\",\"ph\":\"X\",\"ts\":1,"
+                "\"dur\":1,\"pid\":10,\"tid\":11,\"args\":{\"depth\":0}},\n"
+            "{\"name\":\"B\",\"ph\":\"X\",\"ts\":3,"
+                "\"dur\":1,\"pid\":10,\"tid\":11,\"args\":{\"depth\":0}},\n"
+            "{\"name\":\"C\",\"ph\":\"X\",\"ts\":5,"
+                "\"dur\":1,\"pid\":20,\"tid\":21,\"args\":{\"depth\":0}},\n"
+            "{\"name\":\"D\",\"ph\":\"X\",\"ts\":7,"
+                "\"dur\":1,\"pid\":30,\"tid\":31,\"args\":{\"depth\":0}},\n"
+            "{\"name\":\"E\",\"ph\":\"X\",\"ts\":9,"
+                "\"dur\":1,\"pid\":30,\"tid\":31,\"args\":{\"depth\":0}}\n"
+            "],\"displayTimeUnit\":\"ms\"}\n",
+            output.str());
+}
+
+TEST(TraceJsonWriterTest, WritesWhenFull) {
+  StringOutput output;
+  TraceJsonWriter writer(&output, 0);
+  for (int i = 0; i < 100; ++i) {
+    writer.WriteSpan(1, 2, "A span name", UnixMicroseconds(i),
+                     UnixMicroseconds(i + 1), 0);
+  }
+  // The buffer is written out as it fills, in large writes.
+  EXPECT_LT(0U, output.num_writes());
+  EXPECT_GT(50U, output.num_writes());
+  size_t written = output.str().size();
+  EXPECT_TRUE(writer.Finish());
+  EXPECT_LT(written, output.str().size());
+  EXPECT_EQ(100, writer.num_spans());
+}
+
+TEST(TraceJsonWriterTest, Failure) {
+  StringOutput output;
+  output.set_fail(true);
+  TraceJsonWriter writer(&output, LogExportWriter::kDefaultBufferSize);
+  writer.WriteSpan(1, 2, "A", UnixMicroseconds(1), UnixMicroseconds(2), 0);
+  EXPECT_FALSE(writer.failed());
+  EXPECT_FALSE(writer.Finish());
+  EXPECT_TRUE(writer.failed());
+}
@@ -0,0 +1,167 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Trace span matcher implementation.
+#include "sawbuck/log_lib/trace_span_matcher.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+// Orders duration stats by total time, largest first.
+bool HasMoreTime(const TraceSpanMatcher::DurationStats& a,
+                 const TraceSpanMatcher::DurationStats& b) {
+  return a.total > b.total;
+}
+
+}  // namespace
+
+const size_t TraceSpanMatcher::kDefaultMaxOpenSpans;
+
+TraceSpanMatcher::TraceSpanMatcher()
+    : max_open_spans_(kDefaultMaxOpenSpans), span_sink_(NULL),
+      open_span_count_(0), unmatched_end_count_(0), dropped_begin_count_(0) {
+}
+
+TraceSpanMatcher::TraceSpanMatcher(size_t max_open_spans)
+    : max_open_spans_(max_open_spans), span_sink_(NULL),
+      open_span_count_(0), unmatched_end_count_(0), dropped_begin_count_(0) {
+}
+
+TraceSpanMatcher::~TraceSpanMatcher() {
+}
+
+bool TraceSpanMatcher::SpanKey::operator<(const SpanKey& o) const {
+  if (process_id != o.process_id)
+    return process_id < o.process_id;
+  if (name != o.name)
+    return name < o.name;
+  return id < o.id;
+}
+
+void TraceSpanMatcher::GetDurationStats(std::vector<DurationStats>* stats) {
+  DCHECK(stats != NULL);
+  stats->clear();
+
+  base::AutoLock lock(lock_);
+  NameMap::const_iterator it(names_.begin());
+  for (; it != names_.end(); ++it) {
+    const LatencyHistogram& histogram = it->second;
+    if (histogram.count() == 0)
+      continue;
+
+    DurationStats name_stats;
+    name_stats.name = it->first;
+    name_stats.count = histogram.count();
+    name_stats.total = histogram.total();
+    name_stats.p50 = histogram.GetPercentile(50);
+    name_stats.p95 = histogram.GetPercentile(95);
+    name_stats.p99 = histogram.GetPercentile(99);
+    name_stats.max = histogram.max();
+    stats->push_back(name_stats);
+  }
+
+  std::sort(stats->begin(), stats->end(), HasMoreTime);
+}
+
+size_t TraceSpanMatcher::open_span_count() {
+  base::AutoLock lock(lock_);
+  return open_span_count_;
+}
+
+uint64 TraceSpanMatcher::unmatched_end_count() {
+  base::AutoLock lock(lock_);
+  return unmatched_end_count_;
+}
+
+uint64 TraceSpanMatcher::dropped_begin_count() {
+  base::AutoLock lock(lock_);
+  return dropped_begin_count_;
+}
+
+void TraceSpanMatcher::OnTraceEventBegin(const TraceMessage& trace_message) {
+  base::AutoLock lock(lock_);
+
+  if (open_span_count_ >= max_open_spans_) {
+    ++dropped_begin_count_;
+    return;
+  }
+
+  SpanKey key = { trace_message.process_id,
+                  InternName(trace_message.name, trace_message.name_len),
+                  trace_message.id };
+  size_t& depth = thread_depths_[std::make_pair(trace_message.process_id,
+                                                trace_message.thread_id)];
+  OpenSpan span = { trace_message.thread_id, trace_message.time, depth++ };
+  open_spans_[key].push_back(span);
+  ++open_span_count_;
+}
+
+void TraceSpanMatcher::OnTraceEventEnd(const TraceMessage& trace_message) {
+  base::AutoLock lock(lock_);
+
+  SpanKey key = { trace_message.process_id,
+                  InternName(trace_message.name, trace_message.name_len),
+                  trace_message.id };
+  OpenSpanMap::iterator it(open_spans_.find(key));
+  if (it == open_spans_.end()) {
+    ++unmatched_end_count_;
+    return;
+  }
+
+  DCHECK(!it->second.empty());
+  OpenSpan open_span = it->second.back();
+  it->second.pop_back();
+  if (it->second.empty())
+    open_spans_.erase(it);
+  --open_span_count_;
+
+  ThreadDepthMap::iterator depth(thread_depths_.find(
+      std::make_pair(key.process_id, open_span.thread_id)));
+  DCHECK(depth != thread_depths_.end());
+  if (depth != thread_depths_.end() && --depth->second == 0)
+    thread_depths_.erase(depth);
+
+  names_[*key.name].Add(trace_message.time - open_span.begin);
+
+  if (span_sink_ != NULL) {
+    TraceSpanEvents::TraceSpan span = { key.process_id,
+                                        open_span.thread_id,
+                                        trace_message.thread_id,
+                                        key.name,
+                                        key.id,
+                                        open_span.begin,
+                                        trace_message.time,
+                                        open_span.depth };
+    span_sink_->OnTraceSpan(span);
+  }
+}
+
+void TraceSpanMatcher::OnTraceEventInstant(
+    const TraceMessage& trace_message) {
+  // Instants have no duration.
+}
+
+const std::string* TraceSpanMatcher::InternName(const char* name,
+                                                size_t name_len) {
+  lock_.AssertAcquired();
+
+  std::string key(name, name_len);
+  NameMap::iterator it(names_.find(key));
+  if (it == names_.end())
+    it = names_.insert(std::make_pair(key, LatencyHistogram())).first;
+
+  return &it->first;
+}
@@ -0,0 +1,136 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Trace span matcher declaration.
+#ifndef SAWBUCK_LOG_LIB_TRACE_SPAN_MATCHER_H_
+#define SAWBUCK_LOG_LIB_TRACE_SPAN_MATCHER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "base/synchronization/lock.h"
+#include "sawbuck/log_lib/latency_histogram.h"
+#include "sawbuck/log_lib/log_consumer.h"
+
+// Implemented by clients of TraceSpanMatcher to receive the spans of
+// matched trace events.
+class TraceSpanEvents {
+ public:
+  struct TraceSpan {
+    DWORD process_id;
+    // The threads the span began and ended on.
+    DWORD begin_thread_id;
+    DWORD end_thread_id;
+    const std::string* name;
+    void* id;
+    base::Time begin;
+    base::Time end;
+    // The number of spans open on the begin thread as this one began.
+    size_t depth;
+  };
+
+  // Issued as the end event of a span is matched to its begin event.
+  // Note: the span is not valid beyond the call.
+  virtual void OnTraceSpan(const TraceSpan& span) = 0;
+};
+
+// The trace span matcher sinks the trace events of a log parser, and pairs
+// the begin and end events of each span as they stream in, keyed by their
+// process, name and id. Nested spans of the same key pair innermost first.
+// It keeps a histogram of the durations of each name, and holds only the
+// spans yet to end, so its memory grows with the open spans and distinct
+// names rather than with the log.
+// @note this class is thread safe.
+class TraceSpanMatcher : public TraceEvents {
+ public:
+  // The default most spans we hold open, past which begin events are
+  // dropped, so that spans that never end can't grow us without bound.
+  static const size_t kDefaultMaxOpenSpans = 64 * 1024;
+
+  // The durations of the spans of a name.
+  struct DurationStats {
+    std::string name;
+    uint64 count;
+    base::TimeDelta total;
+    base::TimeDelta p50;
+    base::TimeDelta p95;
+    base::TimeDelta p99;
+    base::TimeDelta max;
+  };
+
+  TraceSpanMatcher();
+  explicit TraceSpanMatcher(size_t max_open_spans);
+  ~TraceSpanMatcher();
+
+  // Sets the sink the matched spans are issued to, which is called under
+  // our lock.
+  void set_span_sink(TraceSpanEvents* span_sink) { span_sink_ = span_sink; }
+
+  // Retrieves the duration statistics of each span name, in order of the
+  // total time spent in the spans, largest first, to @p stats.
+  void GetDurationStats(std::vector<DurationStats>* stats);
+
+  // @returns the number of spans yet to end.
+  size_t open_span_count();
+  // @returns the number of end events that matched no begin event.
+  uint64 unmatched_end_count();
+  // @returns the number of begin events dropped for too many open spans.
+  uint64 dropped_begin_count();
+
+  // TraceEvents implementation.
+  virtual void OnTraceEventBegin(const TraceMessage& trace_message);
+  virtual void OnTraceEventEnd(const TraceMessage& trace_message);
+  virtual void OnTraceEventInstant(const TraceMessage& trace_message);
+
+ private:
+  struct SpanKey {
+    bool operator<(const SpanKey& o) const;
+
+    DWORD process_id;
+    const std::string* name;
+    void* id;
+  };
+  struct OpenSpan {
+    DWORD thread_id;
+    base::Time begin;
+    size_t depth;
+  };
+  // The open spans of a key, innermost last.
+  typedef std::map<SpanKey, std::vector<OpenSpan> > OpenSpanMap;
+
+  // @returns the interned @p name.
+  const std::string* InternName(const char* name, size_t name_len);
+
+  const size_t max_open_spans_;
+  TraceSpanEvents* span_sink_;
+
+  base::Lock lock_;
+
+  // The span names and the histograms of their durations. The names are
+  // never released, so the keys compare them by address. Under lock_.
+  typedef std::map<std::string, LatencyHistogram> NameMap;
+  NameMap names_;
+
+  OpenSpanMap open_spans_;  // Under lock_.
+  // The number of open spans of each process and thread. Under lock_.
+  typedef std::map<std::pair<DWORD, DWORD>, size_t> ThreadDepthMap;
+  ThreadDepthMap thread_depths_;
+  size_t open_span_count_;  // Under lock_.
+  uint64 unmatched_end_count_;  // Under lock_.
+  uint64 dropped_begin_count_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(TraceSpanMatcher);
+};
+
+#endif  // SAWBUCK_LOG_LIB_TRACE_SPAN_MATCHER_H_
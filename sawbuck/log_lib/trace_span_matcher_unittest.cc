@@ -0,0 +1,149 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Trace span matcher unittests.
+#include "sawbuck/log_lib/trace_span_matcher.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using testing::_;
+using testing::StrictMock;
+
+const DWORD kPid = 1234;
+const DWORD kTid = 4321;
+
+class MockTraceSpanEvents: public TraceSpanEvents {
+ public:
+  MOCK_METHOD1(OnTraceSpan, void(const TraceSpan& span));
+};
+
+MATCHER_P3(SpanIs, name, duration_ms, depth, "") {
+  return *arg.name == name &&
+      (arg.end - arg.begin).InMilliseconds() == duration_ms &&
+      arg.depth == depth;
+}
+
+class TraceSpanMatcherTest: public testing::Test {
+ public:
+  TraceSpanMatcherTest() : kT0(base::Time::Now()) {
+  }
+
+  // Makes a trace message for @p name and @p id in @p pid at @p ms
+  // milliseconds past kT0.
+  TraceEvents::TraceMessage Message(DWORD pid, const char* name, int id,
+                                    int ms) {
+    TraceEvents::TraceMessage message;
+    message.time = kT0 + base::TimeDelta::FromMilliseconds(ms);
+    message.process_id = pid;
+    message.thread_id = kTid;
+    message.name = name;
+    message.name_len = strlen(name);
+    message.id = reinterpret_cast<void*>(id);
+    return message;
+  }
+
+  void Begin(DWORD pid, const char* name, int id, int ms) {
+    matcher_.OnTraceEventBegin(Message(pid, name, id, ms));
+  }
+  void End(DWORD pid, const char* name, int id, int ms) {
+    matcher_.OnTraceEventEnd(Message(pid, name, id, ms));
+  }
+
+ protected:
+  TraceSpanMatcher matcher_;
+  const base::Time kT0;
+};
+
+}  // namespace
+
+TEST_F(TraceSpanMatcherTest, MatchesSpans) {
+  StrictMock<MockTraceSpanEvents> spans;
+  matcher_.set_span_sink(&spans);
+
+  // Interleaved spans of different keys.
+  Begin(kPid, "Load", 1, 0);
+  Begin(kPid, "Load", 2, 5);
+  Begin(kPid + 1, "Load", 1, 6);
+  EXPECT_EQ(3U, matcher_.open_span_count());
+
+  EXPECT_CALL(spans, OnTraceSpan(SpanIs("Load", 10, 0U))).Times(1);
+  End(kPid, "Load", 1, 10);
+  EXPECT_CALL(spans, OnTraceSpan(SpanIs("Load", 15, 1U))).Times(1);
+  End(kPid, "Load", 2, 20);
+  EXPECT_CALL(spans, OnTraceSpan(SpanIs("Load", 24, 0U))).Times(1);
+  End(kPid + 1, "Load", 1, 30);
+  EXPECT_EQ(0U, matcher_.open_span_count());
+
+  // An end without a begin.
+  End(kPid, "Load", 1, 40);
+  EXPECT_EQ(1U, matcher_.unmatched_end_count());
+}
+
+TEST_F(TraceSpanMatcherTest, NestedSpans) {
+  StrictMock<MockTraceSpanEvents> spans;
+  matcher_.set_span_sink(&spans);
+
+  Begin(kPid, "Paint", 0, 0);
+  Begin(kPid, "Paint", 0, 10);
+  EXPECT_CALL(spans, OnTraceSpan(SpanIs("Paint", 5, 1U))).Times(1);
+  End(kPid, "Paint", 0, 15);
+  EXPECT_CALL(spans, OnTraceSpan(SpanIs("Paint", 20, 0U))).Times(1);
+  End(kPid, "Paint", 0, 20);
+
+  // The depth is back to zero.
+  Begin(kPid, "Layout", 0, 30);
+  EXPECT_CALL(spans, OnTraceSpan(SpanIs("Layout", 5, 0U))).Times(1);
+  End(kPid, "Layout", 0, 35);
+}
+
+TEST_F(TraceSpanMatcherTest, DurationStats) {
+  for (int i = 1; i <= 100; ++i) {
+    Begin(kPid, "Short", i, 0);
+    End(kPid, "Short", i, i);
+  }
+  Begin(kPid, "Long", 0, 0);
+  End(kPid, "Long", 0, 1000000);
+  // Open spans don't count.
+  Begin(kPid, "Open", 0, 0);
+
+  std::vector<TraceSpanMatcher::DurationStats> stats;
+  matcher_.GetDurationStats(&stats);
+  ASSERT_EQ(2U, stats.size());
+  EXPECT_EQ("Long", stats[0].name);
+  EXPECT_EQ(1U, stats[0].count);
+  EXPECT_EQ("Short", stats[1].name);
+  EXPECT_EQ(100U, stats[1].count);
+  EXPECT_EQ(5050, stats[1].total.InMilliseconds());
+  EXPECT_EQ(100, stats[1].max.InMilliseconds());
+  // The percentiles are good to an eighth.
+  EXPECT_LE(50, stats[1].p50.InMilliseconds());
+  EXPECT_GE(50 + 50 / 8, stats[1].p50.InMilliseconds());
+  EXPECT_LE(95, stats[1].p95.InMilliseconds());
+  EXPECT_LE(99, stats[1].p99.InMilliseconds());
+}
+
+TEST_F(TraceSpanMatcherTest, OpenSpansAreCapped) {
+  TraceSpanMatcher matcher(2);
+  matcher.OnTraceEventBegin(Message(kPid, "A", 0, 0));
+  matcher.OnTraceEventBegin(Message(kPid, "B", 0, 0));
+  matcher.OnTraceEventBegin(Message(kPid, "C", 0, 0));
+  EXPECT_EQ(2U, matcher.open_span_count());
+  EXPECT_EQ(1U, matcher.dropped_begin_count());
+
+  matcher.OnTraceEventEnd(Message(kPid, "C", 0, 10));
+  EXPECT_EQ(1U, matcher.unmatched_end_count());
+}
@@ -0,0 +1,215 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Working set profiler implementation.
+#include "sawbuck/log_lib/working_set_profiler.h"
+
+#include <set>
+#include "base/file_util.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "base/win/pe_image.h"
+
+namespace {
+
+// @returns the index of the section of @p sections containing @p rva, or
+//     WorkingSetProfiler::kNoSection.
+size_t FindSection(const std::vector<WorkingSetProfiler::Section>& sections,
+                   sym_util::Address rva) {
+  for (size_t i = 0; i < sections.size(); ++i) {
+    if (sections[i].rva <= rva && rva - sections[i].rva < sections[i].size)
+      return i;
+  }
+
+  return WorkingSetProfiler::kNoSection;
+}
+
+}  // namespace
+
+const size_t WorkingSetProfiler::kNoSection;
+const sym_util::Address WorkingSetProfiler::kPageSize;
+
+WorkingSetProfiler::ModuleTimeline::ModuleTimeline() : total_bytes(0) {
+}
+
+WorkingSetProfiler::WorkingSetProfiler() {
+}
+
+WorkingSetProfiler::~WorkingSetProfiler() {
+}
+
+void WorkingSetProfiler::GetTimelines(
+    std::vector<ModuleTimeline>* timelines) {
+  DCHECK(timelines != NULL);
+
+  timelines->clear();
+  for (size_t i = 0; i < modules_.size(); ++i) {
+    const ModulePageIns& module = modules_[i];
+    if (module.page_ins.empty())
+      continue;
+
+    // The sections are read once, failures only leave them empty.
+    SectionsMap::iterator it(sections_.find(module.module));
+    if (it == sections_.end()) {
+      it = sections_.insert(
+          std::make_pair(module.module, std::vector<Section>())).first;
+      if (!GetModuleSections(module.module, &it->second))
+        it->second.clear();
+    }
+
+    timelines->push_back(ModuleTimeline());
+    ModuleTimeline& timeline = timelines->back();
+    timeline.module = module.module;
+    timeline.sections = it->second;
+    timeline.page_ins = module.page_ins;
+    for (size_t j = 0; j < timeline.page_ins.size(); ++j) {
+      PageIn& page_in = timeline.page_ins[j];
+      page_in.section = FindSection(timeline.sections, page_in.rva);
+      timeline.total_bytes += page_in.byte_count;
+      timeline.total_latency += page_in.latency;
+    }
+  }
+}
+
+void WorkingSetProfiler::GetPageOrdering(
+    const ModuleInformation& module,
+    std::vector<sym_util::Address>* pages) const {
+  DCHECK(pages != NULL);
+
+  pages->clear();
+  ModuleIndexMap::const_iterator it(module_indexes_.find(module));
+  if (it == module_indexes_.end())
+    return;
+
+  std::set<sym_util::Address> seen;
+  const std::vector<PageIn>& page_ins = modules_[it->second].page_ins;
+  for (size_t i = 0; i < page_ins.size(); ++i) {
+    if (seen.insert(page_ins[i].rva).second)
+      pages->push_back(page_ins[i].rva);
+  }
+}
+
+bool WorkingSetProfiler::WritePageOrdering(const ModuleInformation& module,
+                                           const base::FilePath& path) const {
+  std::vector<sym_util::Address> pages;
+  GetPageOrdering(module, &pages);
+
+  std::string contents;
+  for (size_t i = 0; i < pages.size(); ++i)
+    base::StringAppendF(&contents, "0x%08llX\n", pages[i]);
+
+  int written = base::WriteFile(path, contents.data(), contents.size());
+  return written == static_cast<int>(contents.size());
+}
+
+void WorkingSetProfiler::OnModuleIsLoaded(
+    DWORD process_id, const base::Time& time,
+    const ModuleInformation& module_info) {
+  module_cache_.ModuleLoaded(process_id, time, module_info);
+}
+
+void WorkingSetProfiler::OnModuleUnload(
+    DWORD process_id, const base::Time& time,
+    const ModuleInformation& module_info) {
+  module_cache_.ModuleUnloaded(process_id, time, module_info);
+}
+
+void WorkingSetProfiler::OnModuleLoad(
+    DWORD process_id, const base::Time& time,
+    const ModuleInformation& module_info) {
+  module_cache_.ModuleLoaded(process_id, time, module_info);
+}
+
+void WorkingSetProfiler::OnHardFault(DWORD process_id,
+                                     DWORD thread_id,
+                                     const base::Time& time,
+                                     sym_util::Address address,
+                                     sym_util::Address program_counter) {
+  ModuleInformation module;
+  if (!module_cache_.GetModuleForAddress(process_id, time, address,
+                                         &module)) {
+    // Not in a module, e.g. the page file, which we don't profile.
+    pending_faults_.erase(thread_id);
+    return;
+  }
+
+  PendingFault& fault = pending_faults_[thread_id];
+  fault.module = GetModuleIndex(module);
+  fault.time = time;
+  fault.rva = (address - module.base_address) & ~(kPageSize - 1);
+}
+
+void WorkingSetProfiler::OnHardPageFault(DWORD thread_id,
+                                         const base::Time& time,
+                                         const base::Time& initial_time,
+                                         sym_util::Offset offset,
+                                         sym_util::Address address,
+                                         sym_util::Address file_object,
+                                         sym_util::ByteCount byte_count) {
+  PendingFaultMap::iterator it(pending_faults_.find(thread_id));
+  if (it == pending_faults_.end())
+    return;
+
+  PageIn page_in;
+  page_in.time = it->second.time;
+  page_in.latency = time - initial_time;
+  page_in.rva = it->second.rva;
+  page_in.file_offset = offset;
+  page_in.byte_count = byte_count;
+  page_in.section = kNoSection;
+
+  modules_[it->second.module].page_ins.push_back(page_in);
+  pending_faults_.erase(it);
+}
+
+bool WorkingSetProfiler::GetModuleSections(const ModuleInformation& module,
+                                           std::vector<Section>* sections) {
+  DCHECK(sections != NULL);
+
+  base::MemoryMappedFile image;
+  if (!image.Initialize(base::FilePath(module.image_file_name)))
+    return false;
+
+  base::win::PEImageAsData pe_image(
+      reinterpret_cast<HMODULE>(const_cast<uint8*>(image.data())));
+  if (!pe_image.VerifyMagic())
+    return false;
+
+  sections->clear();
+  for (UINT i = 0; i < pe_image.GetNumSections(); ++i) {
+    const IMAGE_SECTION_HEADER* header = pe_image.GetSectionHeader(i);
+    Section section;
+    // Section names are not necessarily zero terminated.
+    section.name.assign(reinterpret_cast<const char*>(header->Name),
+                        strnlen(reinterpret_cast<const char*>(header->Name),
+                                IMAGE_SIZEOF_SHORT_NAME));
+    section.rva = header->VirtualAddress;
+    section.size = header->Misc.VirtualSize;
+    sections->push_back(section);
+  }
+
+  return true;
+}
+
+size_t WorkingSetProfiler::GetModuleIndex(const ModuleInformation& module) {
+  std::pair<ModuleIndexMap::iterator, bool> inserted =
+      module_indexes_.insert(std::make_pair(module, modules_.size()));
+  if (inserted.second) {
+    modules_.push_back(ModulePageIns());
+    modules_.back().module = module;
+  }
+
+  return inserted.first->second;
+}
@@ -0,0 +1,183 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Working set profiler declaration.
+#ifndef SAWBUCK_LOG_LIB_WORKING_SET_PROFILER_H_
+#define SAWBUCK_LOG_LIB_WORKING_SET_PROFILER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/time/time.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/sym_util/module_cache.h"
+
+// The working set profiler sinks the module and hard fault events of a
+// kernel log parser, e.g. of a cold start, and ties each page read in to
+// the module and section it belongs to. It reports the order in which the
+// pages of each module came in, and the time spent waiting on them, and
+// can write that order out for linker reordering experiments.
+class WorkingSetProfiler
+    : public KernelModuleEvents,
+      public KernelPageFaultEvents {
+ public:
+  // A section of a module image.
+  struct Section {
+    std::string name;
+    uint32 rva;
+    uint32 size;
+  };
+
+  static const size_t kNoSection = static_cast<size_t>(-1);
+
+  // A read satisfying a hard fault in a module.
+  struct PageIn {
+    // The time of the fault, and the time it took to satisfy it.
+    base::Time time;
+    base::TimeDelta latency;
+    // The RVA of the faulting page, and the extent of the read.
+    sym_util::Address rva;
+    sym_util::Offset file_offset;
+    sym_util::ByteCount byte_count;
+    // The index of the page's section, or kNoSection.
+    size_t section;
+  };
+
+  // The pages a module read in, in order.
+  struct ModuleTimeline {
+    ModuleTimeline();
+
+    ModuleInformation module;
+    std::vector<Section> sections;
+    std::vector<PageIn> page_ins;
+    uint64 total_bytes;
+    base::TimeDelta total_latency;
+  };
+
+  static const sym_util::Address kPageSize = 0x1000;
+
+  WorkingSetProfiler();
+  virtual ~WorkingSetProfiler();
+
+  // Retrieves the timelines of the modules that read pages in to
+  // @p timelines, ordered by their first hard fault.
+  void GetTimelines(std::vector<ModuleTimeline>* timelines);
+
+  // Retrieves the RVAs of the faulting pages of @p module to @p pages, in
+  // the order they were first read in.
+  void GetPageOrdering(const ModuleInformation& module,
+                       std::vector<sym_util::Address>* pages) const;
+
+  // Writes the page ordering of @p module to @p path, one hex RVA a line.
+  // @returns true on success.
+  bool WritePageOrdering(const ModuleInformation& module,
+                         const base::FilePath& path) const;
+
+  // KernelModuleEvents implementation.
+  virtual void OnModuleIsLoaded(DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info);
+  virtual void OnModuleUnload(DWORD process_id,
+                              const base::Time& time,
+                              const ModuleInformation& module_info);
+  virtual void OnModuleLoad(DWORD process_id,
+                            const base::Time& time,
+                            const ModuleInformation& module_info);
+
+  // KernelPageFaultEvents implementation.
+  virtual void OnTransitionFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter) {}
+  virtual void OnDemandZeroFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter) {}
+  virtual void OnCopyOnWriteFault(DWORD process_id,
+                                  DWORD thread_id,
+                                  const base::Time& time,
+                                  sym_util::Address address,
+                                  sym_util::Address program_counter) {}
+  virtual void OnGuardPageFault(DWORD process_id,
+                                DWORD thread_id,
+                                const base::Time& time,
+                                sym_util::Address address,
+                                sym_util::Address program_counter) {}
+  virtual void OnHardFault(DWORD process_id,
+                           DWORD thread_id,
+                           const base::Time& time,
+                           sym_util::Address address,
+                           sym_util::Address program_counter);
+  virtual void OnAccessViolationFault(DWORD process_id,
+                                      DWORD thread_id,
+                                      const base::Time& time,
+                                      sym_util::Address address,
+                                      sym_util::Address program_counter) {}
+  virtual void OnHardPageFault(DWORD thread_id,
+                               const base::Time& time,
+                               const base::Time& initial_time,
+                               sym_util::Offset offset,
+                               sym_util::Address address,
+                               sym_util::Address file_object,
+                               sym_util::ByteCount byte_count);
+
+ protected:
+  // Reads the sections of @p module from its image on disk to @p sections.
+  // Overridable for testing.
+  // @returns true on success.
+  virtual bool GetModuleSections(const ModuleInformation& module,
+                                 std::vector<Section>* sections);
+
+ private:
+  // The hard fault of a thread, awaiting its page fault event.
+  struct PendingFault {
+    size_t module;
+    base::Time time;
+    sym_util::Address rva;
+  };
+
+  // The page-ins of a module as they came in.
+  struct ModulePageIns {
+    ModuleInformation module;
+    std::vector<PageIn> page_ins;
+  };
+
+  // @returns the index of @p module in modules_, adding it if need be.
+  size_t GetModuleIndex(const ModuleInformation& module);
+
+  // The module load state of the processes, to tie addresses to modules.
+  sym_util::ModuleCache module_cache_;
+
+  // The modules that took hard faults, in order of their first fault, and
+  // their indexes.
+  std::vector<ModulePageIns> modules_;
+  typedef std::map<ModuleInformation, size_t> ModuleIndexMap;
+  ModuleIndexMap module_indexes_;
+
+  // The sections of the modules, read on first report.
+  typedef std::map<ModuleInformation, std::vector<Section> > SectionsMap;
+  SectionsMap sections_;
+
+  // The pending hard fault of each thread.
+  typedef std::map<DWORD, PendingFault> PendingFaultMap;
+  PendingFaultMap pending_faults_;
+
+  DISALLOW_COPY_AND_ASSIGN(WorkingSetProfiler);
+};
+
+#endif  // SAWBUCK_LOG_LIB_WORKING_SET_PROFILER_H_
@@ -0,0 +1,149 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Working set profiler unittests.
+#include "sawbuck/log_lib/working_set_profiler.h"
+
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+const DWORD kPid = 1234;
+const DWORD kTid = 4321;
+
+// Serves made up sections, rather than reading them from the image.
+class TestWorkingSetProfiler : public WorkingSetProfiler {
+ public:
+  TestWorkingSetProfiler() : sections_read_(0) {
+  }
+
+  int sections_read_;
+
+ protected:
+  virtual bool GetModuleSections(const ModuleInformation& module,
+                                 std::vector<Section>* sections) {
+    ++sections_read_;
+    Section text = { ".text", 0x1000, 0x3000 };
+    Section data = { ".data", 0x4000, 0x1000 };
+    sections->push_back(text);
+    sections->push_back(data);
+    return true;
+  }
+};
+
+class WorkingSetProfilerTest: public testing::Test {
+ public:
+  WorkingSetProfilerTest()
+      : kT0(base::Time::Now()),
+        kT1(kT0 + base::TimeDelta::FromMilliseconds(10)),
+        kT2(kT0 + base::TimeDelta::FromMilliseconds(20)) {
+  }
+
+  virtual void SetUp() {
+    module_.base_address = 0x10000000;
+    module_.module_size = 0x100000;
+    module_.image_checksum = 0xCAFEBABE;
+    module_.time_date_stamp = 0xBABECAFE;
+    module_.image_file_name = L"c:\\foo\\bar.dll";
+    profiler_.OnModuleIsLoaded(kPid, kT0, module_);
+  }
+
+  // Issues a hard fault at @p address, and its read of @p byte_count
+  // bytes taking @p latency_ms.
+  void PageIn(const base::Time& time, sym_util::Address address,
+              sym_util::ByteCount byte_count, int latency_ms) {
+    profiler_.OnHardFault(kPid, kTid, time, address, 0);
+    profiler_.OnHardPageFault(kTid,
+        time + base::TimeDelta::FromMilliseconds(latency_ms), time,
+        address - module_.base_address, address, 0, byte_count);
+  }
+
+ protected:
+  TestWorkingSetProfiler profiler_;
+  KernelModuleEvents::ModuleInformation module_;
+  const base::Time kT0;
+  const base::Time kT1;
+  const base::Time kT2;
+};
+
+}  // namespace
+
+TEST_F(WorkingSetProfilerTest, Timeline) {
+  PageIn(kT1, 0x10004010, 0x1000, 3);
+  PageIn(kT1, 0x10001FF0, 0x2000, 5);
+  // Outside of any module.
+  PageIn(kT1, 0x20001000, 0x1000, 7);
+  PageIn(kT2, 0x10008000, 0x1000, 1);
+
+  std::vector<WorkingSetProfiler::ModuleTimeline> timelines;
+  profiler_.GetTimelines(&timelines);
+  ASSERT_EQ(1U, timelines.size());
+
+  const WorkingSetProfiler::ModuleTimeline& timeline = timelines[0];
+  EXPECT_TRUE(timeline.module == module_);
+  EXPECT_EQ(2U, timeline.sections.size());
+  EXPECT_EQ(0x4000U, timeline.total_bytes);
+  EXPECT_EQ(9, timeline.total_latency.InMilliseconds());
+
+  ASSERT_EQ(3U, timeline.page_ins.size());
+  EXPECT_EQ(0x4000U, timeline.page_ins[0].rva);
+  EXPECT_EQ(1U, timeline.page_ins[0].section);
+  EXPECT_EQ(0x1000U, timeline.page_ins[1].rva);
+  EXPECT_EQ(0U, timeline.page_ins[1].section);
+  EXPECT_EQ(0x2000U, timeline.page_ins[1].byte_count);
+  EXPECT_EQ(5, timeline.page_ins[1].latency.InMilliseconds());
+  EXPECT_EQ(0x8000U, timeline.page_ins[2].rva);
+  EXPECT_EQ(WorkingSetProfiler::kNoSection, timeline.page_ins[2].section);
+  EXPECT_TRUE(kT2 == timeline.page_ins[2].time);
+
+  // The sections are only read once.
+  profiler_.GetTimelines(&timelines);
+  EXPECT_EQ(1, profiler_.sections_read_);
+}
+
+TEST_F(WorkingSetProfilerTest, IgnoresUnmatchedPageFaults) {
+  profiler_.OnHardPageFault(kTid, kT1, kT0, 0x1000, 0x10001000, 0, 0x1000);
+  profiler_.OnHardFault(kPid, kTid, kT1, 0x10001000, 0);
+  profiler_.OnHardPageFault(kTid + 1, kT1, kT0, 0x1000, 0x10001000, 0,
+                            0x1000);
+
+  std::vector<WorkingSetProfiler::ModuleTimeline> timelines;
+  profiler_.GetTimelines(&timelines);
+  EXPECT_TRUE(timelines.empty());
+}
+
+TEST_F(WorkingSetProfilerTest, PageOrdering) {
+  PageIn(kT1, 0x10003000, 0x1000, 1);
+  PageIn(kT1, 0x10001000, 0x1000, 1);
+  PageIn(kT2, 0x10003800, 0x1000, 1);
+  PageIn(kT2, 0x10002000, 0x1000, 1);
+
+  std::vector<sym_util::Address> pages;
+  profiler_.GetPageOrdering(module_, &pages);
+  ASSERT_EQ(3U, pages.size());
+  EXPECT_EQ(0x3000U, pages[0]);
+  EXPECT_EQ(0x1000U, pages[1]);
+  EXPECT_EQ(0x2000U, pages[2]);
+
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::FilePath path(temp_dir.path().Append(L"order.txt"));
+  ASSERT_TRUE(profiler_.WritePageOrdering(module_, path));
+
+  std::string contents;
+  ASSERT_TRUE(base::ReadFileToString(path, &contents));
+  EXPECT_EQ("0x00003000\n0x00001000\n0x00002000\n", contents);
+}
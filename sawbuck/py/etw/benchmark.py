@@ -0,0 +1,185 @@
+#!python
+# Copyright 2012 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""A script to measure the throughput of the etw module on log files.
+
+The log files are replayed through each consumption mode in turn:
+  ctypes-lazy    TraceEventSource through ctypes, reading no event fields.
+  ctypes-eager   TraceEventSource through ctypes, decoding every field.
+  native-lazy    TraceEventSource on _etw_native, reading no event fields.
+  native-eager   TraceEventSource on _etw_native, decoding every field.
+  columns        etw.columns.ReadColumns, into NumPy arrays.
+The native modes are skipped without the _etw_native extension, and the
+columns mode without it or NumPy.
+
+Each mode runs in a worker process of its own, so that its peak working set
+is its own. The modes deliver different events: the consumers handle the
+image and process events, the columns hold the records of the column event
+classes. Compare a mode's events per second across changes, rather than the
+modes to one another.
+
+Usage: benchmark.py [--iterations=N] [--mode=MODE ...] [file.etl ...]
+The files default to the log_lib test logs.
+"""
+import ctypes
+import glob
+import multiprocessing
+import optparse
+import os
+import sys
+import time
+from etw import columns
+from etw import consumer
+from etw import EventConsumer, EventHandler, TraceEventSource
+from etw.descriptors import image
+from etw.descriptors import process
+
+
+_SRC_DIR = os.path.abspath(os.path.join(__file__, '../../../..'))
+
+_DEFAULT_LOGS = os.path.join(_SRC_DIR, 'sawbuck/log_lib/test_data/*.etl')
+
+_MODES = ['ctypes-lazy', 'ctypes-eager', 'native-lazy', 'native-eager',
+          'columns']
+
+
+class _PROCESS_MEMORY_COUNTERS(ctypes.Structure):
+  _fields_ = [('cb', ctypes.c_ulong),
+              ('PageFaultCount', ctypes.c_ulong),
+              ('PeakWorkingSetSize', ctypes.c_size_t),
+              ('WorkingSetSize', ctypes.c_size_t),
+              ('QuotaPeakPagedPoolUsage', ctypes.c_size_t),
+              ('QuotaPagedPoolUsage', ctypes.c_size_t),
+              ('QuotaPeakNonPagedPoolUsage', ctypes.c_size_t),
+              ('QuotaNonPagedPoolUsage', ctypes.c_size_t),
+              ('PagefileUsage', ctypes.c_size_t),
+              ('PeakPagefileUsage', ctypes.c_size_t)]
+
+
+def _GetPeakWorkingSet():
+  """Returns the peak working set of this process, in bytes."""
+  counters = _PROCESS_MEMORY_COUNTERS()
+  counters.cb = ctypes.sizeof(counters)
+  if not ctypes.windll.psapi.GetProcessMemoryInfo(
+      ctypes.windll.kernel32.GetCurrentProcess(), ctypes.byref(counters),
+      counters.cb):
+    raise ctypes.WinError()
+  return counters.PeakWorkingSetSize
+
+
+class _EventCounter(EventConsumer):
+  """Counts the image and process events, decoding their fields if asked."""
+  def __init__(self, eager):
+    self.count = 0
+    self._eager = eager
+
+  @EventHandler(image.Event.Load, image.Event.UnLoad, image.Event.DCStart,
+                image.Event.DCEnd, process.Event.Start, process.Event.End,
+                process.Event.DCStart, process.Event.DCEnd)
+  def OnEvent(self, event):
+    self.count += 1
+    if self._eager:
+      for name, unused_field_type in event._fields_:
+        getattr(event, name)
+
+
+def _IsModeAvailable(mode):
+  """Returns true iff mode has what it needs in this installation."""
+  if mode.startswith('ctypes-'):
+    return True
+  if consumer._etw_native is None:
+    return False
+  if mode == 'columns':
+    try:
+      import numpy  # pylint: disable=W0612
+    except ImportError:
+      return False
+  return True
+
+
+def _ConsumeFile(mode, path):
+  """Replays the log at path in mode, returning the number of events."""
+  if mode == 'columns':
+    arrays = columns.ReadColumns(path)
+    return sum(len(arrays[name]) for name in columns.EVENT_CLASSES)
+
+  counter = _EventCounter(mode.endswith('-eager'))
+  source = TraceEventSource([counter], native=mode.startswith('native-'))
+  source.OpenFileSession(path)
+  source.Consume()
+  source.Close()
+  return counter.count
+
+
+def _RunMode(task):
+  """Runs a mode in a worker process.
+
+  Args:
+    task: the (mode, paths, iterations) tuple of the run.
+
+  Returns:
+    The (events, seconds, peak working set) tuple of the run.
+  """
+  mode, paths, iterations = task
+  events = 0
+  start = time.clock()
+  for unused_iteration in xrange(iterations):
+    for path in paths:
+      events += _ConsumeFile(mode, path)
+  seconds = time.clock() - start
+  return events, seconds, _GetPeakWorkingSet()
+
+
+def _ParseArgs():
+  parser = optparse.OptionParser(usage='%prog [options] [file.etl ...]')
+  parser.add_option('--iterations', type='int', default=10,
+                    help='The number of times each file is replayed.')
+  parser.add_option('--mode', action='append', dest='modes',
+                    choices=_MODES,
+                    help='A mode to run, of %s. Defaults to all of them.' %
+                        ', '.join(_MODES))
+  options, paths = parser.parse_args()
+  if options.iterations < 1:
+    parser.error('The iterations must be at least one.')
+  if not paths:
+    paths = sorted(glob.glob(_DEFAULT_LOGS))
+  if not paths:
+    parser.error('No log files to replay.')
+  return options, paths
+
+
+def main():
+  options, paths = _ParseArgs()
+  print '%d file(s), %d iteration(s).' % (len(paths), options.iterations)
+  print '%-14s%12s%12s%12s%14s' % ('Mode', 'Events', 'Seconds', 'Events/s',
+                                   'Peak WS (KB)')
+  for mode in options.modes or _MODES:
+    if not _IsModeAvailable(mode):
+      print '%-14s%12s' % (mode, 'n/a')
+      continue
+
+    # A fresh process per mode, so that the peak is the mode's own.
+    pool = multiprocessing.Pool(1)
+    events, seconds, peak = pool.apply(_RunMode,
+                                       ((mode, paths, options.iterations),))
+    pool.close()
+    pool.join()
+    rate = events / seconds if seconds > 0 else 0
+    print '%-14s%12d%12.3f%12.0f%14d' % (mode, events, seconds, rate,
+                                         peak / 1024)
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -17,12 +17,15 @@
     'chromium_code': 1,
     'etw_sources': [
       'etw/__init__.py',
+      'etw/columns.py',
       'etw/consumer.py',
       'etw/controller.py',
       'etw/evntcons.py',
       'etw/evntrace.py',
       'etw/guiddef.py',
+      'etw/parallel.py',
       'etw/provider.py',
+      'etw/symbols.py',
       'etw/util.py',
       'etw/descriptors/__init__.py',
       'etw/descriptors/binary_buffer.py',
@@ -44,12 +47,16 @@
       'sources': [
         '<@(etw_sources)',
       ],
+      'dependencies': [
+        'etw_native',
+      ],
       'actions': [
         {
           'action_name': 'build_etw',
           'msvs_cygwin_shell': 0,
           'inputs': [
             '<@(etw_sources)',
+            '<(PRODUCT_DIR)/_etw_native.pyd',
           ],
           'outputs': [
             '<(PRODUCT_DIR)/ETW-0.6.5.0-py2.6.egg',
@@ -58,6 +65,7 @@
             '"<(DEPTH)/third_party/setuptools/setup_env.bat" &&'
               '"<(DEPTH)/third_party/python_26/python"',
             'setup.py',
+            '--native-module=<(PRODUCT_DIR)/_etw_native.pyd',
             'bdist_egg',
             '--dist-dir=<(PRODUCT_DIR)',
             '--bdist-dir=<(PRODUCT_DIR)/temp/etw/',
@@ -65,5 +73,61 @@
         },
       ],
     },
+    {
+      # The native consumer the etw package picks up when it's present.
+      'target_name': 'etw_native',
+      'type': 'loadable_module',
+      'product_name': '_etw_native',
+      'product_extension': 'pyd',
+      'sources': [
+        'native/column_reader.cc',
+        'native/column_reader.h',
+        'native/column_stream.cc',
+        'native/column_stream.h',
+        'native/etw_native_module.cc',
+        'native/native_event_source.cc',
+        'native/native_event_source.h',
+        'native/symbol_resolver.cc',
+        'native/symbol_resolver.h',
+      ],
+      'include_dirs': [
+        '<(DEPTH)',
+        '<(DEPTH)/third_party/python_26/include',
+      ],
+      'dependencies': [
+        '<(DEPTH)/base/base.gyp:base',
+        '<(DEPTH)/sawbuck/log_lib/log_lib.gyp:log_lib',
+      ],
+      'msvs_settings': {
+        'VCLinkerTool': {
+          # Python.h pulls in python26.lib by pragma.
+          'AdditionalLibraryDirectories': [
+            '<(DEPTH)/third_party/python_26/libs',
+          ],
+        },
+      },
+    },
+    {
+      'target_name': 'etw_native_unittests',
+      'type': 'executable',
+      'sources': [
+        'native/column_reader.cc',
+        'native/column_reader.h',
+        'native/column_reader_unittest.cc',
+        'native/symbol_resolver.cc',
+        'native/symbol_resolver.h',
+        'native/symbol_resolver_unittest.cc',
+        '<(DEPTH)/sawbuck/log_lib/log_lib_unittest_main.cc',
+      ],
+      'include_dirs': [
+        '<(DEPTH)',
+      ],
+      'dependencies': [
+        '<(DEPTH)/base/base.gyp:base',
+        '<(DEPTH)/sawbuck/log_lib/log_lib.gyp:log_lib',
+        '<(DEPTH)/sawbuck/log_lib/log_lib.gyp:test_common',
+        '<(DEPTH)/testing/gtest.gyp:gtest',
+      ],
+    },
   ],
 }
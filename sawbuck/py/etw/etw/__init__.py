@@ -16,14 +16,21 @@
 Event Tracing for Windows. The classes implement an ETW controller, consumer
 and provider.
 """
+from etw.columns import ColumnStream, ReadColumns
 from etw.consumer import TraceEventSource, EventConsumer, EventHandler
 from etw.controller import TraceController, TraceProperties
-from etw.provider import TraceProvider, MofEvent
+from etw.provider import EventBatch, EventTemplate, MofEvent, TraceProvider
+from etw.symbols import SymbolResolver
 from etw.guiddef import GUID
 
 __all__ = ['GUID',
+           'ColumnStream',
+           'EventBatch',
+           'EventTemplate',
            'TraceProvider',
            'MofEvent',
+           'ReadColumns',
+           'SymbolResolver',
            'EventConsumer',
            'EventHandler',
            'TraceEventSource',
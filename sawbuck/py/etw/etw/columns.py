@@ -0,0 +1,236 @@
+# Copyright 2012 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Bulk reading of kernel log events into NumPy structured arrays."""
+
+try:
+  from etw import _etw_native
+except ImportError:
+  _etw_native = None
+
+
+# The fault_type values of PageFault events.
+TRANSITION_FAULT = 0
+DEMAND_ZERO_FAULT = 1
+COPY_ON_WRITE_FAULT = 2
+GUARD_PAGE_FAULT = 3
+HARD_FAULT = 4
+ACCESS_VIOLATION_FAULT = 5
+
+# The event_type values of Image events.
+IMAGE_IS_LOADED = 0
+IMAGE_UNLOAD = 1
+IMAGE_LOAD = 2
+
+# The event classes the native records are decoded into. The fields of the
+# records of each are described by the extension, see _GetDType. Times are in
+# seconds since 1.1.1970.
+EVENT_CLASSES = ['HardPageFault', 'Image', 'PageFault']
+
+
+def _GetDType(numpy, event_class):
+  """Returns the dtype of the native records of event_class.
+
+  The layout comes from the extension, so that it can't disagree with the
+  records it decodes.
+  """
+  itemsize, fields = _etw_native.RecordLayout(event_class)
+  names, formats, offsets = zip(*fields)
+  return numpy.dtype({'names': list(names),
+                      'formats': list(formats),
+                      'offsets': list(offsets),
+                      'itemsize': itemsize})
+
+
+def ReadColumns(path, event_classes=None, fields=None):
+  """Decode a whole log file into one structured array per event class.
+
+  The decoding is native, the events never cross into Python one by one.
+
+  Args:
+    path: the path of the .etl file to read.
+    event_classes: the names of the event classes to read, of those in
+        EVENT_CLASSES. Defaults to all of them.
+    fields: an optional list of the fields to keep, the arrays keep those
+        they have. Defaults to all fields.
+
+  Returns:
+    A dict of the array of each event class read, in time order. The
+    'Strings' entry is an object array of the strings the records refer to
+    by index, e.g. the image file names of Image events.
+
+  Raises:
+    RuntimeError: the _etw_native extension isn't available.
+    ValueError: an event class is unknown.
+    WindowsError: the file can't be read.
+  """
+  # NumPy is only needed here, importing it is not cheap.
+  import numpy
+
+  if _etw_native is None:
+    raise RuntimeError('Reading columns needs the _etw_native extension.')
+
+  if event_classes is None:
+    event_classes = EVENT_CLASSES
+  for event_class in event_classes:
+    if event_class not in EVENT_CLASSES:
+      raise ValueError('Unknown event class %s.' % event_class)
+
+  records, strings = _etw_native.ReadRecords(unicode(path),
+                                             list(event_classes))
+  columns = {}
+  for event_class in event_classes:
+    dtype = _GetDType(numpy, event_class)
+    array = numpy.frombuffer(records[event_class], dtype=dtype)
+    if fields is not None:
+      kept = [name for name in dtype.names if name in fields]
+      array = array[kept]
+    columns[event_class] = array
+
+  columns['Strings'] = numpy.array(strings, dtype=object)
+  return columns
+
+
+class ColumnStream(object):
+  """Streams the kernel events of a real time session in column chunks.
+
+  The session is consumed on a native thread, which decodes the events into
+  records and cuts them into a batch per ETW buffer, or per time slice. The
+  batches queue up in a bounded ring for NextBatch to take, as arrays like
+  those of ReadColumns. The events never cross into Python one by one, and
+  a script that falls behind loses batches rather than holding the session
+  up; Stats tells what it missed.
+
+  Usage:
+    stream = ColumnStream('NT Kernel Logger', ['PageFault'])
+    for batch in stream:
+      Process(batch['PageFault'])
+  """
+
+  def __init__(self, session_name, event_classes=None, fields=None,
+               max_batches=64, slice_seconds=0.0):
+    """Starts consuming the real time session session_name.
+
+    Args:
+      session_name: the name of the real time session to consume.
+      event_classes: the names of the event classes to stream, of those in
+          EVENT_CLASSES. Defaults to all of them.
+      fields: an optional list of the fields to keep, as for ReadColumns.
+      max_batches: the number of batches queued at most, past which new
+          batches are dropped.
+      slice_seconds: the time each batch covers at least, zero for a batch
+          per ETW buffer.
+
+    Raises:
+      RuntimeError: the _etw_native extension isn't available.
+      ValueError: an event class is unknown.
+      WindowsError: the session can't be opened.
+    """
+    # NumPy is only needed here, importing it is not cheap.
+    import numpy
+    self._numpy = numpy
+
+    if _etw_native is None:
+      raise RuntimeError('Streaming columns needs the _etw_native extension.')
+
+    if event_classes is None:
+      event_classes = EVENT_CLASSES
+    for event_class in event_classes:
+      if event_class not in EVENT_CLASSES:
+        raise ValueError('Unknown event class %s.' % event_class)
+
+    self._event_classes = list(event_classes)
+    self._fields = fields
+    self._dtypes = dict((event_class, _GetDType(numpy, event_class))
+                        for event_class in self._event_classes)
+    # The strings of all the batches so far, as the records refer to those
+    # of earlier batches too.
+    self._strings = []
+    self._string_array = numpy.array([], dtype=object)
+
+    self._stream = _etw_native.ColumnStream(max_batches, slice_seconds)
+    for event_class in self._event_classes:
+      self._stream.AddRecordKind(event_class)
+    self._stream.Start(unicode(session_name))
+
+  def __del__(self):
+    self.Close()
+
+  def __iter__(self):
+    """Yields the batches until the session closes."""
+    while True:
+      batch = self.NextBatch(1.0)
+      if batch is not None:
+        yield batch
+      elif not self._stream.IsConsuming():
+        # Take whatever queued up in the meantime.
+        batch = self.NextBatch(0.0)
+        if batch is None:
+          return
+        yield batch
+
+  def NextBatch(self, timeout=None):
+    """Takes the oldest batch queued.
+
+    Args:
+      timeout: the seconds to wait for a batch at most, None to wait for
+          as long as the session is open.
+
+    Returns:
+      A dict of the array of each event class streamed, and a 'Strings'
+      entry as ReadColumns has, or None if no batch came.
+    """
+    while True:
+      # The native wait is in slices, so that KeyboardInterrupt gets in.
+      wait = 1.0 if timeout is None else timeout
+      batch = self._stream.NextBatch(wait)
+      if (batch is not None or timeout is not None or
+          not self._stream.IsConsuming()):
+        break
+
+    if batch is None:
+      return None
+
+    records, first_string, strings = batch
+    if strings:
+      assert first_string == len(self._strings)
+      self._strings.extend(strings)
+      self._string_array = self._numpy.array(self._strings, dtype=object)
+
+    columns = {}
+    for event_class in self._event_classes:
+      dtype = self._dtypes[event_class]
+      array = self._numpy.frombuffer(records[event_class], dtype=dtype)
+      if self._fields is not None:
+        kept = [name for name in dtype.names if name in self._fields]
+        array = array[kept]
+      columns[event_class] = array
+
+    columns['Strings'] = self._string_array
+    return columns
+
+  def Stats(self):
+    """Returns the tallies of the stream so far.
+
+    Returns:
+      A dict of the 'batches_delivered' and 'batches_dropped', the
+      'records_dropped' as a dict by event class, and the 'events_lost' and
+      'buffers_lost' the session itself reported.
+    """
+    return self._stream.Stats()
+
+  def Close(self):
+    """Stops consuming the session, the batches queued can still be taken."""
+    stream = getattr(self, '_stream', None)
+    if stream is not None:
+      stream.Stop()
@@ -13,13 +13,23 @@
 # limitations under the License.
 """Implements a trace consumer utility class."""
 from collections import defaultdict
-from ctypes import byref, cast, POINTER
+from ctypes import addressof, byref, cast, sizeof, string_at, POINTER
 from etw import evntcons
 from etw import evntrace
 from etw import util
 from etw.descriptors import event
+from etw.guiddef import GUID
 import logging
 
+_GUID_SIZE = sizeof(GUID)
+
+# The native consumer is optional, the module falls back to consuming
+# through ctypes without it.
+try:
+  from etw import _etw_native
+except ImportError:
+  _etw_native = None
+
 
 def _BindHandler(handler_func, handler_instance):
   def BoundHandler(event):
@@ -193,6 +203,22 @@ class _TraceLogSession(object):
     except:
       logging.exception('Exception in _ProcessEventCallback')
 
+class _NativeLogSession(object):
+  """The session events consumed natively are parsed in.
+
+  The native consumer doesn't consume in raw time mode, so the time values
+  are all FILETIMEs. The log bitness is updated as each event is handed
+  over, as the native consumer infers it from the log file header.
+  """
+  def __init__(self):
+    self.is_64_bit_log = False
+
+  def SessionTimeToTime(self, session_time):
+    """Convert a FILETIME value to a python time value."""
+    return (session_time * util.FILETIME_TO_SECONDS_MULTIPLIER -
+            util.FILETIME_EPOCH_DELTA_S)
+
+
 class TraceEventSource(object):
   """An Event Tracing for Windows consumer class.
 
@@ -207,9 +233,18 @@ class TraceEventSource(object):
 
   Note that each TraceEventSource can at most consume a single real time
   session, and no more than 63 sessions overall.
+
+  When the _etw_native extension is available, the sessions are consumed
+  natively, and only the events the handlers handle cross into Python. A
+  native handler set with SetNativeHandler gets the events the native
+  consumer decodes itself, without any Python parsing.
+
+  Consume still calls into Python per event. Scripts that must keep up with
+  a busy real time session should stream it in batches with
+  etw.columns.ColumnStream instead.
   """
 
-  def __init__(self, handlers=[], raw_time=False):
+  def __init__(self, handlers=[], raw_time=False, native=None):
     """Creates an idle consumer.
 
     Args:
@@ -217,12 +252,23 @@ class TraceEventSource(object):
           Each handler should be an object derived from EventConsumer.
       raw_time: if True, consume logs with the raw time option. This allows
           converting stamps recorded in events to wall-clock time.
+      native: if True, consume natively, if False, through ctypes. The
+          default is to consume natively when available and not in
+          raw time mode, which the native consumer doesn't support.
     """
     self._stop = False
     self._handlers = handlers[:]
     self._raw_time = raw_time
     self._trace_sessions = []
-    self._handler_cache = dict()
+    self._BuildDispatchTable()
+    self._native_source = None
+    if native is None:
+      native = _etw_native is not None and not raw_time
+    if native and (_etw_native is None or raw_time):
+      raise RuntimeError('Native consumption is not available.')
+    if native:
+      self._native_source = _etw_native.EventSource()
+      self._native_session = _NativeLogSession()
 
   def __del__(self):
     """Clean up any trace sessions we have open."""
@@ -235,8 +281,35 @@ class TraceEventSource(object):
       handler: the handler to add.
     """
     self._handlers.append(handler)
-    # Clear our handler cache.
-    self._handler_cache.clear()
+    self._BuildDispatchTable()
+
+  def SetNativeHandler(self, handler):
+    """Set the handler of the events the native consumer decodes.
+
+    The handler may implement any of the methods below, and gets the
+    events of those only. Times are in seconds since 1.1.1970.
+      OnLogMessage(time, level, process_id, thread_id, message, file, line)
+      OnTraceEventBegin, OnTraceEventEnd, OnTraceEventInstant(
+          time, process_id, thread_id, name, id, extra)
+      OnModuleIsLoaded, OnModuleUnload, OnModuleLoad(
+          time, process_id, base_address, module_size, image_checksum,
+          time_date_stamp, image_file_name)
+      OnProcessIsRunning, OnProcessStarted(
+          time, process_id, parent_id, session_id, image_name, command_line)
+      OnProcessEnded(time, process_id, parent_id, session_id, image_name,
+                     command_line, exit_status)
+      OnThreadIsRunning, OnThreadStarted, OnThreadEnded(
+          time, process_id, thread_id)
+
+    Args:
+      handler: the handler, or None for none.
+
+    Raises:
+      RuntimeError: this source doesn't consume natively.
+    """
+    if not self._native_source:
+      raise RuntimeError('Native handlers need native consumption.')
+    self._native_source.SetHandler(handler)
 
   def OpenRealtimeSession(self, name):
     """Open a trace session named "name".
@@ -244,6 +317,10 @@ class TraceEventSource(object):
     Args:
       name: name of the session to open.
     """
+    if self._native_source:
+      self._native_source.OpenRealtimeSession(unicode(name))
+      return
+
     session = _TraceLogSession(self, self._raw_time)
     session.OpenRealtimeSession(name)
     self._trace_sessions.append(session)
@@ -254,6 +331,10 @@ class TraceEventSource(object):
     Args:
       path: relative or absolute path to the file to open.
     """
+    if self._native_source:
+      self._native_source.OpenFileSession(unicode(path))
+      return
+
     session = _TraceLogSession(self, self._raw_time)
     session.OpenFileSession(path)
     self._trace_sessions.append(session)
@@ -264,6 +345,10 @@ class TraceEventSource(object):
     Note: if any of the open sessions are realtime sessions, this function
       will not return until Close() is called to close the realtime session.
     """
+    if self._native_source:
+      self._ConsumeNative()
+      return
+
     handles = (evntrace.TRACEHANDLE *
                len(self._trace_sessions))()
 
@@ -277,6 +362,8 @@ class TraceEventSource(object):
 
   def Close(self):
     """Close all open trace sessions."""
+    if self._native_source:
+      self._native_source.Close()
     while len(self._trace_sessions):
       session = self._trace_sessions.pop()
       session.Close()
@@ -284,27 +371,35 @@ class TraceEventSource(object):
   def ProcessEvent(self, session, event_trace):
     """Process a single event.
 
-    Retrieve the guid, version and type from the event and try to find a handler
-    for the event and event class that can parse the event data. If both exist,
-    dispatch the event object to the handler.
+    Look the guid, version and type of the event up in the dispatch table,
+    and if there are handlers and an event class that can parse the event
+    data, dispatch the event object to the handlers.
 
     Args:
       session: the _TraceLogSession on which this event occurred.
       event_trace: a POINTER(EVENT_TRACE) for the current event.
     """
     header = event_trace.contents.Header
-    guid = str(header.Guid)
-    version = header.Class.Version
-    kind = header.Class.Type
-
-    # Look for a handler and EventClass for the event.
-    event_class = event.EventClass.Get(guid, version, kind)
-    if event_class:
-      handlers = self._GetHandlers(guid, kind)
-      if handlers:
-        event_obj = event_class(session, event_trace)
-        for handler in handlers:
-          handler(event_obj)
+    guid = header.Guid
+
+    # Most events have no subscriber, and are dropped on the first field
+    # of their GUID, before anything else is read from them.
+    events = self._dispatch_table.get(guid.Data1)
+    if events is None:
+      return
+
+    header_class = header.Class
+    key = (string_at(addressof(guid), _GUID_SIZE),
+           header_class.Version,
+           header_class.Type)
+    entry = events.get(key)
+    if entry is None:
+      return
+
+    event_class, handlers = entry
+    event_obj = event_class(session, event_trace)
+    for handler in handlers:
+      handler(event_obj)
 
   def ProcessBuffer(self, session, buffer):
     """Process a buffer.
@@ -341,16 +436,52 @@ class TraceEventSource(object):
       logging.exception("Exception in ProcessEvent, terminating parsing")
       self._stop = True
 
-  def _GetHandlers(self, guid, kind):
-    key = (guid, kind)
-    handler_list = self._handler_cache.get(key, None)
-    if handler_list != None:
-      return handler_list
-
-    # We didn't cache this already.
-    handler_list = []
+  def _ConsumeNative(self):
+    # Only the events our handlers handle are handed back to us.
+    event_keys = set()
     for handler_instance in self._handlers:
-      for handler_func in handler_instance.event_handler_map.get(key, []):
-        handler_list.append(_BindHandler(handler_func, handler_instance))
+      event_keys.update(handler_instance.event_handler_map.keys())
+    for guid, kind in event_keys:
+      self._native_source.AddPythonEvent(unicode(guid), kind)
 
-    return handler_list
+    self._native_source.SetPythonCallback(self._ProcessNativeEvent)
+    try:
+      self._native_source.Consume()
+    finally:
+      self._native_source.SetPythonCallback(None)
+
+  def _ProcessNativeEvent(self, event_address, is_64_bit_log):
+    session = self._native_session
+    session.is_64_bit_log = bool(is_64_bit_log)
+    self._ProcessEventCallback(
+        session, cast(event_address, POINTER(evntrace.EVENT_TRACE)))
+    return not self._stop
+
+  def _BuildDispatchTable(self):
+    """Build the table ProcessEvent dispatches the events by.
+
+    The table maps the Data1 field of the GUID of each event class handled
+    to a dict keyed by (GUID bytes, version, type). Its values are the
+    (EventClass, bound handlers) of the events, for all the versions of the
+    event classes we have descriptors for.
+    """
+    bound_handlers = defaultdict(list)
+    for handler_instance in self._handlers:
+      for key, handler_funcs in handler_instance.event_handler_map.items():
+        for handler_func in handler_funcs:
+          bound_handlers[key].append(
+              _BindHandler(handler_func, handler_instance))
+
+    table = {}
+    for (guid, kind), handlers in bound_handlers.items():
+      event_classes = event.EventClass.GetAll(guid, kind)
+      if not event_classes:
+        continue
+
+      guid_struct = GUID(guid)
+      guid_bytes = string_at(addressof(guid_struct), _GUID_SIZE)
+      events = table.setdefault(guid_struct.Data1, {})
+      for version, event_class in event_classes:
+        events[(guid_bytes, version, kind)] = (event_class, handlers)
+
+    self._dispatch_table = table
@@ -13,8 +13,38 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 """EventClass and EventCategory base classes for Event descriptors."""
+import ctypes
 import inspect
 from etw.descriptors import binary_buffer
+from etw.descriptors import field
+
+
+class FieldLayout(object):
+  """The layout of the fields of an EventClass in the logs of a bitness.
+
+  The fields up to the first variable size one are at fixed offsets, which are
+  precomputed so that each can be decoded on its own. The fields past that
+  prefix can only be decoded in order.
+
+  Attributes:
+    fields: the (name, field type) tuples of the fields.
+    index: a dict of the index of each field by name.
+    offsets: the offsets of the fields of the fixed layout prefix.
+    prefix_size: the size of the fixed layout prefix.
+  """
+
+  def __init__(self, fields, is_64_bit_log):
+    self.fields = fields
+    self.index = dict((name, i) for i, (name, unused) in enumerate(fields))
+    self.offsets = []
+    offset = 0
+    for unused_name, field_type in fields:
+      size = field.GetSize(field_type, is_64_bit_log)
+      if size is None:
+        break
+      self.offsets.append(offset)
+      offset += size
+    self.prefix_size = offset
 
 
 class EventClass(object):
@@ -28,11 +58,13 @@ class EventClass(object):
     _fields_ = [('IntField', field.Int32),
                 ('StringField', field.String)]
 
-  The constructor iterates over the _fields_ property and invokes the function
-  defined in the second half of the tuple. The return value is assigned as a
-  named attribute of this class, the name being the first half of the tuple. The
-  function in the second half of the tuple should take a TraceLogSession and a
-  BinaryBufferReader as parameters and should return a mixed value.
+  The constructor keeps a copy of the event data, and the first time one of the
+  names in the _fields_ property is read, the function defined in the second
+  half of its tuple decodes it. The return value is assigned as a named
+  attribute of this class, the name being the first half of the tuple, so that
+  a field is only decoded once. The function in the second half of the tuple
+  should take a TraceLogSession and a BinaryBufferReader as parameters and
+  should return a mixed value.
 
   Subclasses must also define the _event_types_ list. This will cause the
   subclass to be registered in the the EventClass's subclass map for each event
@@ -50,23 +82,79 @@ class EventClass(object):
   # the derived classes.
   _subclass_map = {}
 
+  # The FieldLayout of each subclass, by (subclass, is_64_bit_log) tuple.
+  _layouts = {}
+
   def __init__(self, log_session, event_trace):
     """Initialize by extracting event trace header and MOF data.
 
     Args:
+      log_session: the _TraceLogSession the event arrived on.
       event_trace: a POINTER(EVENT_TRACE) for the current event.
-      is_64_bit_log: whether the log is from a 64 bit system.
+
+    Raises:
+      BufferOverflowError: the MOF data is too short for the fixed layout
+          prefix of the fields.
     """
-    header = event_trace.contents.Header
+    contents = event_trace.contents
+    header = contents.Header
     self.process_id = header.ProcessId
     self.thread_id = header.ThreadId
 
     self.raw_time_stamp = header.TimeStamp
     self.time_stamp = log_session.SessionTimeToTime(header.TimeStamp)
-    reader = binary_buffer.BinaryBufferReader(event_trace.contents.MofData,
-                                              event_trace.contents.MofLength)
-    for name, field in self._fields_:
-      setattr(self, name, field(log_session, reader))
+
+    layout = self.GetLayout(log_session.is_64_bit_log)
+    length = contents.MofLength
+    if length < layout.prefix_size:
+      raise binary_buffer.BufferOverflowError()
+
+    # The MOF data only lives as long as the event callback.
+    self._session = log_session
+    self._data = ctypes.create_string_buffer(length)
+    ctypes.memmove(self._data, contents.MofData, length)
+    self._layout = layout
+    # The reader of the fields past the fixed layout prefix, and the index of
+    # the next one it reads.
+    self._reader = None
+    self._next_field = len(layout.offsets)
+
+  def __getattr__(self, name):
+    """Decodes the field name, which hasn't been read before."""
+    layout = self.__dict__.get('_layout')
+    if layout is None or name not in layout.index:
+      raise AttributeError(name)
+
+    i = layout.index[name]
+    start = ctypes.addressof(self._data)
+    length = len(self._data)
+    if i < len(layout.offsets):
+      offset = layout.offsets[i]
+      reader = binary_buffer.BinaryBufferReader(start + offset,
+                                                length - offset)
+      value = layout.fields[i][1](self._session, reader)
+      setattr(self, name, value)
+      return value
+
+    if self._reader is None:
+      self._reader = binary_buffer.BinaryBufferReader(start, length)
+      self._reader.Consume(layout.prefix_size)
+    while self._next_field <= i:
+      field_name, field_type = layout.fields[self._next_field]
+      value = field_type(self._session, self._reader)
+      setattr(self, field_name, value)
+      self._next_field += 1
+    return value
+
+  @classmethod
+  def GetLayout(cls, is_64_bit_log):
+    """Returns the FieldLayout of this class in logs of the given bitness."""
+    key = cls, bool(is_64_bit_log)
+    layout = EventClass._layouts.get(key, None)
+    if layout is None:
+      layout = FieldLayout(cls._fields_, is_64_bit_log)
+      EventClass._layouts[key] = layout
+    return layout
 
   @staticmethod
   def Get(guid, version, event_type):
@@ -84,6 +172,21 @@ class EventClass(object):
     key = guid, version, event_type
     return EventClass._subclass_map.get(key, None)
 
+  @staticmethod
+  def GetAll(guid, event_type):
+    """Returns the subclasses of all versions for the given guid and event_type.
+
+    Args:
+      guid: The event category guid as a string.
+      event_type: The type of the event as a number.
+
+    Returns:
+      A list of (version, subclass) tuples, one per version of the event.
+    """
+    return [(key[1], subclass)
+            for key, subclass in EventClass._subclass_map.iteritems()
+            if key[0] == guid and key[2] == event_type]
+
   @staticmethod
   def Set(guid, version, event_type, subclass):
     """Sets the subclass for the given guid, version and event_type.
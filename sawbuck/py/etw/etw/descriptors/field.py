@@ -24,8 +24,8 @@ class MyEventClass(EventClass):
               ('StringField', field.String)]
 
 When a log event is parsed, the EventClass is created, and each callable
-field type is invoked. The return value is assigned to the EventClass using
-the name provided in the _fields_ list.
+field type is invoked the first time its field is read. The return value is
+assigned to the EventClass using the name provided in the _fields_ list.
 
 To add a new field type, define a function that takes these arguments:
   session: The _TraceLogSession instance the event arrived on.
@@ -35,45 +35,84 @@ To add a new field type, define a function that takes these arguments:
   reader: An instance of the BinaryBufferReader class to read from.
 and returns a mixed value. If the BinaryBufferReader doesn't already have
 a function to read a certain type, it will need to be added as well.
+
+Field types that always read the same number of bytes should be decorated
+with FixedSize. The fields of an EventClass up to its first variable size
+field are then at precomputed offsets, and can be decoded independently.
 """
 
 
+def FixedSize(size, size_64_bit=None):
+  """Returns a decorator recording the size of a fixed size field type.
+
+  Args:
+    size: the number of bytes the field type reads.
+    size_64_bit: the number of bytes it reads from 64 bit logs, if that
+        differs from size.
+  """
+  if size_64_bit is None:
+    size_64_bit = size
+
+  def Decorate(field_type):
+    field_type.sizes = (size, size_64_bit)
+    return field_type
+  return Decorate
+
+
+def GetSize(field_type, is_64_bit_log):
+  """Returns the number of bytes field_type reads, or None if that varies."""
+  sizes = getattr(field_type, 'sizes', None)
+  if sizes is None:
+    return None
+  return sizes[bool(is_64_bit_log)]
+
+
+@FixedSize(1)
 def Boolean(unused_session, reader):
   return reader.ReadBoolean()
 
 
+@FixedSize(1)
 def Int8(unused_session, reader):
   return reader.ReadInt8()
 
 
+@FixedSize(1)
 def UInt8(unused_session, reader):
   return reader.ReadUInt8()
 
 
+@FixedSize(2)
 def Int16(unused_session, reader):
   return reader.ReadInt16()
 
 
+@FixedSize(2)
 def UInt16(unused_session, reader):
   return reader.ReadUInt16()
 
 
+@FixedSize(4)
 def Int32(unused_session, reader):
   return reader.ReadInt32()
 
 
+@FixedSize(4)
 def UInt32(unused_session, reader):
   return reader.ReadUInt32()
 
 
+@FixedSize(8)
 def Int64(unused_session, reader):
   return reader.ReadInt64()
 
 
+@FixedSize(8)
 def UInt64(unused_session, reader):
   return reader.ReadUInt64()
 
 
+@FixedSize(4, 8)
 def Pointer(session, reader):
   if session.is_64_bit_log:
     return reader.ReadUInt64()
@@ -93,5 +132,6 @@ def Sid(session, reader):
   return reader.ReadSid(session.is_64_bit_log)
 
 
+@FixedSize(8)
 def WmiTime(session, reader):
   return session.SessionTimeToTime(reader.ReadUInt64())
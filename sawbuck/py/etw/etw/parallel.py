@@ -0,0 +1,105 @@
+# Copyright 2012 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Analysis of several log files in parallel worker processes.
+
+Consuming a log in Python is bound to a single core by the GIL, so logs of
+several files are best consumed in several processes. For example:
+
+class ImageLoadCounter(etw.EventConsumer):
+  def __init__(self):
+    self.count = 0
+
+  @etw.EventHandler(image.Event.Load)
+  def OnImageLoad(self, event):
+    self.count += 1
+
+def Merge(counter, other):
+  counter.count += other.count
+  return counter
+
+if __name__ == '__main__':
+  counter = parallel.AnalyzeFiles(paths, ImageLoadCounter, Merge)
+
+The consumers cross process boundaries, so their classes must be defined at
+module level, and they must pickle. As the workers import the main module,
+the driver must be guarded by the __name__ test on Windows.
+"""
+import multiprocessing
+from etw.consumer import TraceEventSource
+
+
+def _AnalyzeFile(task):
+  """Consumes a log file in a worker process.
+
+  Args:
+    task: the (path, consumer_class, args, raw_time) tuple of the file.
+
+  Returns:
+    The consumer, after it handled the events of the file.
+  """
+  path, consumer_class, args, raw_time = task
+  consumer = consumer_class(*args)
+  source = TraceEventSource([consumer], raw_time)
+  source.OpenFileSession(path)
+  source.Consume()
+  source.Close()
+  return consumer
+
+
+def AnalyzeFiles(paths, consumer_class, merge, args=(), jobs=None,
+                 raw_time=False):
+  """Consumes each of the log files with a consumer of its own, in parallel.
+
+  Args:
+    paths: the paths of the .etl files to consume.
+    consumer_class: the EventConsumer subclass to consume each file with.
+    merge: the function reducing the consumers. It's called with the result
+        of the previous call, or the first consumer, and the consumer of the
+        next file, in the order of paths.
+    args: the arguments to construct the consumers with.
+    jobs: the number of worker processes, defaults to the number of cores.
+        With a single job, the files are consumed in this process.
+    raw_time: whether the time stamps of the events are left in the units
+        of the logs.
+
+  Returns:
+    The reduced consumers.
+
+  Raises:
+    ValueError: there are no paths.
+    WindowsError: a file can't be consumed.
+  """
+  if not paths:
+    raise ValueError('No log files to analyze.')
+
+  if jobs is None:
+    jobs = multiprocessing.cpu_count()
+  jobs = min(jobs, len(paths))
+
+  tasks = [(path, consumer_class, args, raw_time) for path in paths]
+  if jobs == 1:
+    return reduce(merge, map(_AnalyzeFile, tasks))
+
+  pool = multiprocessing.Pool(jobs)
+  try:
+    # Each file is a task of its own, as the files of a log are often of
+    # very different sizes.
+    consumers = pool.imap(_AnalyzeFile, tasks, 1)
+    result = consumers.next()
+    for consumer in consumers:
+      result = merge(result, consumer)
+  finally:
+    pool.terminate()
+    pool.join()
+  return result
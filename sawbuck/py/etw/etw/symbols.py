@@ -0,0 +1,116 @@
+# Copyright 2012 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Bulk resolution of the addresses of kernel log events to symbols."""
+import collections
+
+try:
+  from etw import _etw_native
+except ImportError:
+  _etw_native = None
+
+
+# A resolved symbol. The offset is from the start of the symbol.
+Symbol = collections.namedtuple(
+    'Symbol', ['module', 'module_base', 'name', 'file', 'line', 'offset'])
+
+
+class SymbolResolver(object):
+  """Resolves the addresses observed in processes to symbols, in bulk.
+
+  The modules of the processes over time come from the module events of
+  kernel logs, or are added one by one. The resolution is that of the viewer,
+  and can share its persistent cache of symbols, which makes resolving the
+  addresses of modules seen before cheap.
+
+  resolver = SymbolResolver()
+  resolver.ReadModules('kernel.etl')
+  symbols = resolver.Resolve(faults['process_id'], faults['time'],
+                             faults['program_counter'])
+  """
+
+  def __init__(self, symbol_path=None, cache_path=None):
+    """Create a resolver.
+
+    Args:
+      symbol_path: the symbol path, defaults to that of the environment.
+      cache_path: the path of the persistent symbol cache to use, if any.
+
+    Raises:
+      RuntimeError: the _etw_native extension isn't available.
+    """
+    if _etw_native is None:
+      raise RuntimeError('Resolving symbols needs the _etw_native extension.')
+    self._resolver = _etw_native.SymbolResolver()
+    if symbol_path is not None:
+      self._resolver.SetSymbolPath(unicode(symbol_path))
+    if cache_path is not None:
+      self._resolver.OpenPersistentCache(unicode(cache_path))
+
+  def ReadModules(self, path):
+    """Reads the module events of the log file at path.
+
+    Raises:
+      WindowsError: the file can't be read.
+    """
+    self._resolver.ReadModules(unicode(path))
+
+  def ModuleLoaded(self, process_id, time, module):
+    """Notes the load of a module into a process.
+
+    Args:
+      process_id: the process the module loaded into.
+      time: the time of the load, 0 for modules loaded all along.
+      module: the (base_address, module_size, image_checksum,
+          time_date_stamp, image_file_name) tuple of the module.
+    """
+    self._resolver.ModuleLoaded(process_id, time, *self._ModuleArgs(module))
+
+  def ModuleUnloaded(self, process_id, time, module):
+    """Notes the unload of a module from a process, see ModuleLoaded."""
+    self._resolver.ModuleUnloaded(process_id, time, *self._ModuleArgs(module))
+
+  def Resolve(self, process_ids, times, addresses):
+    """Resolves addresses to symbols.
+
+    The arguments may be NumPy arrays, or anything that converts to one,
+    and scalars apply to all addresses.
+
+    Args:
+      process_ids: the processes the addresses were observed in.
+      times: the times the addresses were observed at, in seconds since
+          1.1.1970 as the time stamps of events.
+      addresses: the addresses to resolve.
+
+    Returns:
+      A list of the Symbol of each address, or None where it doesn't
+      resolve.
+    """
+    # NumPy is only needed here, importing it is not cheap.
+    import numpy
+
+    process_ids, times, addresses = numpy.broadcast_arrays(
+        numpy.asarray(process_ids), numpy.asarray(times),
+        numpy.asarray(addresses))
+    records = self._resolver.Resolve(
+        numpy.ascontiguousarray(process_ids.ravel(), dtype='<u4'),
+        numpy.ascontiguousarray(times.ravel(), dtype='<f8'),
+        numpy.ascontiguousarray(addresses.ravel(), dtype='<u8'))
+    return [record and Symbol._make(record) for record in records]
+
+  @staticmethod
+  def _ModuleArgs(module):
+    (base_address, module_size, image_checksum, time_date_stamp,
+     image_file_name) = module
+    return (base_address, module_size, image_checksum, time_date_stamp,
+            unicode(image_file_name))
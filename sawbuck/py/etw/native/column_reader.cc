@@ -0,0 +1,292 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Column reader implementation.
+#include "sawbuck/py/etw/native/column_reader.h"
+
+#include "base/logging.h"
+
+namespace {
+
+double ToPythonTime(const base::Time& time) {
+  return time.ToDoubleT();
+}
+
+#define FIELD(record, name, format) \
+    { #name, format, offsetof(ColumnReader::record, name) }
+
+const ColumnReader::FieldLayout kPageFaultFields[] = {
+  FIELD(PageFaultRecord, time, "<f8"),
+  FIELD(PageFaultRecord, address, "<u8"),
+  FIELD(PageFaultRecord, program_counter, "<u8"),
+  FIELD(PageFaultRecord, process_id, "<u4"),
+  FIELD(PageFaultRecord, thread_id, "<u4"),
+  FIELD(PageFaultRecord, fault_type, "<u4"),
+  { NULL },
+};
+
+const ColumnReader::FieldLayout kHardPageFaultFields[] = {
+  FIELD(HardPageFaultRecord, time, "<f8"),
+  FIELD(HardPageFaultRecord, initial_time, "<f8"),
+  FIELD(HardPageFaultRecord, offset, "<u8"),
+  FIELD(HardPageFaultRecord, address, "<u8"),
+  FIELD(HardPageFaultRecord, file_object, "<u8"),
+  FIELD(HardPageFaultRecord, thread_id, "<u4"),
+  FIELD(HardPageFaultRecord, byte_count, "<u4"),
+  { NULL },
+};
+
+const ColumnReader::FieldLayout kImageFields[] = {
+  FIELD(ImageRecord, time, "<f8"),
+  FIELD(ImageRecord, base_address, "<u8"),
+  FIELD(ImageRecord, process_id, "<u4"),
+  FIELD(ImageRecord, module_size, "<u4"),
+  FIELD(ImageRecord, image_checksum, "<u4"),
+  FIELD(ImageRecord, time_date_stamp, "<u4"),
+  FIELD(ImageRecord, name_index, "<u4"),
+  FIELD(ImageRecord, event_type, "<u4"),
+  { NULL },
+};
+
+#undef FIELD
+
+template <class RecordType>
+void AppendRecord(const RecordType& record, std::string* records) {
+  records->append(reinterpret_cast<const char*>(&record), sizeof(record));
+}
+
+}  // namespace
+
+const char* const ColumnReader::kRecordKindNames[NUM_RECORD_KINDS] = {
+  "PageFault",
+  "HardPageFault",
+  "Image",
+};
+
+ColumnReader::ColumnReader() {
+  for (int i = 0; i < NUM_RECORD_KINDS; ++i)
+    wanted_[i] = false;
+}
+
+ColumnReader::~ColumnReader() {
+}
+
+ColumnReader::RecordKind ColumnReader::RecordKindFromName(const char* name) {
+  DCHECK(name != NULL);
+  for (int i = 0; i < NUM_RECORD_KINDS; ++i) {
+    if (strcmp(name, kRecordKindNames[i]) == 0)
+      return static_cast<RecordKind>(i);
+  }
+  return NUM_RECORD_KINDS;
+}
+
+size_t ColumnReader::RecordSize(RecordKind kind) {
+  switch (kind) {
+    case PAGE_FAULT:
+      return sizeof(PageFaultRecord);
+    case HARD_PAGE_FAULT:
+      return sizeof(HardPageFaultRecord);
+    case IMAGE:
+      return sizeof(ImageRecord);
+    default:
+      NOTREACHED() << "Unknown record kind " << kind;
+      return 1;
+  }
+}
+
+const ColumnReader::FieldLayout* ColumnReader::GetFieldLayout(
+    RecordKind kind) {
+  switch (kind) {
+    case PAGE_FAULT:
+      return kPageFaultFields;
+    case HARD_PAGE_FAULT:
+      return kHardPageFaultFields;
+    case IMAGE:
+      return kImageFields;
+    default:
+      NOTREACHED() << "Unknown record kind " << kind;
+      return NULL;
+  }
+}
+
+void ColumnReader::AddRecordKind(RecordKind kind) {
+  DCHECK_LT(kind, NUM_RECORD_KINDS);
+  wanted_[kind] = true;
+
+  // The parser skips decoding the events no sink is set for.
+  if (wanted_[PAGE_FAULT] || wanted_[HARD_PAGE_FAULT])
+    set_page_fault_event_sink(this);
+  if (wanted_[IMAGE])
+    set_module_event_sink(this);
+}
+
+void ColumnReader::TakeRecords(RecordKind kind, std::string* records) {
+  DCHECK_LT(kind, NUM_RECORD_KINDS);
+  DCHECK(records != NULL);
+  records->clear();
+  records->swap(records_[kind]);
+}
+
+HRESULT ColumnReader::Read(const base::FilePath& path) {
+  EtlFileReader reader;
+  HRESULT hr = reader.Open(path);
+  if (FAILED(hr))
+    return hr;
+
+  if (infer_bitness_from_log())
+    set_is_64_bit_log(reader.is_64_bit_log());
+  return reader.Consume(this);
+}
+
+void ColumnReader::OnEvent(EVENT_TRACE* event) {
+  ProcessOneEvent(event);
+}
+
+void ColumnReader::OnModuleIsLoaded(DWORD process_id,
+                                    const base::Time& time,
+                                    const ModuleInformation& module_info) {
+  AddImageRecord(IMAGE_IS_LOADED, process_id, time, module_info);
+}
+
+void ColumnReader::OnModuleUnload(DWORD process_id,
+                                  const base::Time& time,
+                                  const ModuleInformation& module_info) {
+  AddImageRecord(IMAGE_UNLOAD, process_id, time, module_info);
+}
+
+void ColumnReader::OnModuleLoad(DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info) {
+  AddImageRecord(IMAGE_LOAD, process_id, time, module_info);
+}
+
+void ColumnReader::OnTransitionFault(DWORD process_id,
+                                     DWORD thread_id,
+                                     const base::Time& time,
+                                     sym_util::Address address,
+                                     sym_util::Address program_counter) {
+  AddPageFaultRecord(TRANSITION_FAULT, process_id, thread_id, time, address,
+                     program_counter);
+}
+
+void ColumnReader::OnDemandZeroFault(DWORD process_id,
+                                     DWORD thread_id,
+                                     const base::Time& time,
+                                     sym_util::Address address,
+                                     sym_util::Address program_counter) {
+  AddPageFaultRecord(DEMAND_ZERO_FAULT, process_id, thread_id, time, address,
+                     program_counter);
+}
+
+void ColumnReader::OnCopyOnWriteFault(DWORD process_id,
+                                      DWORD thread_id,
+                                      const base::Time& time,
+                                      sym_util::Address address,
+                                      sym_util::Address program_counter) {
+  AddPageFaultRecord(COPY_ON_WRITE_FAULT, process_id, thread_id, time,
+                     address, program_counter);
+}
+
+void ColumnReader::OnGuardPageFault(DWORD process_id,
+                                    DWORD thread_id,
+                                    const base::Time& time,
+                                    sym_util::Address address,
+                                    sym_util::Address program_counter) {
+  AddPageFaultRecord(GUARD_PAGE_FAULT, process_id, thread_id, time, address,
+                     program_counter);
+}
+
+void ColumnReader::OnHardFault(DWORD process_id,
+                               DWORD thread_id,
+                               const base::Time& time,
+                               sym_util::Address address,
+                               sym_util::Address program_counter) {
+  AddPageFaultRecord(HARD_FAULT, process_id, thread_id, time, address,
+                     program_counter);
+}
+
+void ColumnReader::OnAccessViolationFault(DWORD process_id,
+                                          DWORD thread_id,
+                                          const base::Time& time,
+                                          sym_util::Address address,
+                                          sym_util::Address program_counter) {
+  AddPageFaultRecord(ACCESS_VIOLATION_FAULT, process_id, thread_id, time,
+                     address, program_counter);
+}
+
+void ColumnReader::OnHardPageFault(DWORD thread_id,
+                                   const base::Time& time,
+                                   const base::Time& initial_time,
+                                   sym_util::Offset offset,
+                                   sym_util::Address address,
+                                   sym_util::Address file_object,
+                                   sym_util::ByteCount byte_count) {
+  if (!wanted_[HARD_PAGE_FAULT])
+    return;
+
+  HardPageFaultRecord record = {};
+  record.time = ToPythonTime(time);
+  record.initial_time = ToPythonTime(initial_time);
+  record.offset = offset;
+  record.address = address;
+  record.file_object = file_object;
+  record.thread_id = thread_id;
+  record.byte_count = byte_count;
+  AppendRecord(record, &records_[HARD_PAGE_FAULT]);
+}
+
+void ColumnReader::AddImageRecord(ImageEventType event_type,
+                                  DWORD process_id,
+                                  const base::Time& time,
+                                  const ModuleInformation& module_info) {
+  DCHECK(wanted_[IMAGE]);
+  ImageRecord record = {};
+  record.time = ToPythonTime(time);
+  record.base_address = module_info.base_address;
+  record.process_id = process_id;
+  record.module_size = module_info.module_size;
+  record.image_checksum = module_info.image_checksum;
+  record.time_date_stamp = module_info.time_date_stamp;
+  record.name_index = InternString(module_info.image_file_name);
+  record.event_type = event_type;
+  AppendRecord(record, &records_[IMAGE]);
+}
+
+void ColumnReader::AddPageFaultRecord(FaultType fault_type,
+                                      DWORD process_id,
+                                      DWORD thread_id,
+                                      const base::Time& time,
+                                      sym_util::Address address,
+                                      sym_util::Address program_counter) {
+  if (!wanted_[PAGE_FAULT])
+    return;
+
+  PageFaultRecord record = {};
+  record.time = ToPythonTime(time);
+  record.address = address;
+  record.program_counter = program_counter;
+  record.process_id = process_id;
+  record.thread_id = thread_id;
+  record.fault_type = fault_type;
+  AppendRecord(record, &records_[PAGE_FAULT]);
+}
+
+uint32 ColumnReader::InternString(const std::wstring& str) {
+  std::pair<StringIndex::iterator, bool> inserted(
+      string_index_.insert(
+          std::make_pair(str, static_cast<uint32>(strings_.size()))));
+  if (inserted.second)
+    strings_.push_back(str);
+  return inserted.first->second;
+}
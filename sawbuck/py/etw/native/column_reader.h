@@ -0,0 +1,218 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Column reader declaration, decoding a log file into packed records for
+// the etw module's bulk export.
+#ifndef SAWBUCK_PY_ETW_NATIVE_COLUMN_READER_H_
+#define SAWBUCK_PY_ETW_NATIVE_COLUMN_READER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/logging.h"
+#include "sawbuck/log_lib/etl_file_reader.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+
+// Decodes the kernel events of a log file into one buffer of fixed size
+// records per kind, for the etw module to view as NumPy structured arrays.
+// The events never cross into Python one by one, which is what makes this
+// fast enough for logs of millions of events.
+class ColumnReader
+    : public EtlEventSink,
+      public KernelLogParser,
+      public KernelModuleEvents,
+      public KernelPageFaultEvents {
+ public:
+  enum RecordKind {
+    PAGE_FAULT,
+    HARD_PAGE_FAULT,
+    IMAGE,
+    NUM_RECORD_KINDS,
+  };
+  // The names of the kinds, as the etw module knows them.
+  static const char* const kRecordKindNames[NUM_RECORD_KINDS];
+
+  // The records are laid out as NumPy lays out the aligned structured
+  // dtype of the same fields, in the same order.
+  struct PageFaultRecord {
+    // In seconds since 1.1.1970, as the etw module's time stamps.
+    double time;
+    uint64 address;
+    uint64 program_counter;
+    uint32 process_id;
+    uint32 thread_id;
+    // A FaultType.
+    uint32 fault_type;
+  };
+  enum FaultType {
+    TRANSITION_FAULT,
+    DEMAND_ZERO_FAULT,
+    COPY_ON_WRITE_FAULT,
+    GUARD_PAGE_FAULT,
+    HARD_FAULT,
+    ACCESS_VIOLATION_FAULT,
+  };
+
+  struct HardPageFaultRecord {
+    double time;
+    double initial_time;
+    uint64 offset;
+    uint64 address;
+    uint64 file_object;
+    uint32 thread_id;
+    uint32 byte_count;
+  };
+
+  struct ImageRecord {
+    double time;
+    uint64 base_address;
+    uint32 process_id;
+    uint32 module_size;
+    uint32 image_checksum;
+    uint32 time_date_stamp;
+    // The index of the image file name in strings().
+    uint32 name_index;
+    // An ImageEventType.
+    uint32 event_type;
+  };
+  enum ImageEventType {
+    IMAGE_IS_LOADED,
+    IMAGE_UNLOAD,
+    IMAGE_LOAD,
+  };
+
+  ColumnReader();
+  ~ColumnReader();
+
+  // Returns the kind named @p name, or NUM_RECORD_KINDS if there's none.
+  static RecordKind RecordKindFromName(const char* name);
+  // Returns the size of the records of @p kind.
+  static size_t RecordSize(RecordKind kind);
+
+  // Describes a field of the records of a kind, for the etw module to
+  // build the dtype of the records from.
+  struct FieldLayout {
+    const char* name;
+    // The NumPy type of the field, e.g. "<u4".
+    const char* format;
+    size_t offset;
+  };
+  // Returns the fields of the records of @p kind, in order, ending with an
+  // entry with a NULL name.
+  static const FieldLayout* GetFieldLayout(RecordKind kind);
+
+  // Records the events of @p kind, which are skipped otherwise.
+  void AddRecordKind(RecordKind kind);
+
+  // Decodes the log file at @p path.
+  // @returns S_OK on success, an error code if the file can't be read.
+  HRESULT Read(const base::FilePath& path);
+
+  // The records of @p kind, packed one after the other.
+  const std::string& records(RecordKind kind) const {
+    DCHECK_LT(kind, NUM_RECORD_KINDS);
+    return records_[kind];
+  }
+  size_t num_records(RecordKind kind) const {
+    return records(kind).size() / RecordSize(kind);
+  }
+  // Hands the records of @p kind so far over to @p records, for readers
+  // that take them in chunks.
+  void TakeRecords(RecordKind kind, std::string* records);
+
+  // The strings the records refer to by index.
+  const std::vector<std::wstring>& strings() const { return strings_; }
+
+ private:
+  // EtlEventSink implementation.
+  virtual void OnEvent(EVENT_TRACE* event);
+
+  // KernelModuleEvents implementation.
+  virtual void OnModuleIsLoaded(DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info);
+  virtual void OnModuleUnload(DWORD process_id,
+                              const base::Time& time,
+                              const ModuleInformation& module_info);
+  virtual void OnModuleLoad(DWORD process_id,
+                            const base::Time& time,
+                            const ModuleInformation& module_info);
+
+  // KernelPageFaultEvents implementation.
+  virtual void OnTransitionFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter);
+  virtual void OnDemandZeroFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter);
+  virtual void OnCopyOnWriteFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter);
+  virtual void OnGuardPageFault(DWORD process_id,
+                                DWORD thread_id,
+                                const base::Time& time,
+                                sym_util::Address address,
+                                sym_util::Address program_counter);
+  virtual void OnHardFault(DWORD process_id,
+                           DWORD thread_id,
+                           const base::Time& time,
+                           sym_util::Address address,
+                           sym_util::Address program_counter);
+  virtual void OnAccessViolationFault(DWORD process_id,
+                                      DWORD thread_id,
+                                      const base::Time& time,
+                                      sym_util::Address address,
+                                      sym_util::Address program_counter);
+  virtual void OnHardPageFault(DWORD thread_id,
+                               const base::Time& time,
+                               const base::Time& initial_time,
+                               sym_util::Offset offset,
+                               sym_util::Address address,
+                               sym_util::Address file_object,
+                               sym_util::ByteCount byte_count);
+
+  // Shared by the notifications of a kind.
+  void AddImageRecord(ImageEventType event_type,
+                      DWORD process_id,
+                      const base::Time& time,
+                      const ModuleInformation& module_info);
+  void AddPageFaultRecord(FaultType fault_type,
+                          DWORD process_id,
+                          DWORD thread_id,
+                          const base::Time& time,
+                          sym_util::Address address,
+                          sym_util::Address program_counter);
+
+  // Returns the index of @p str in strings_, adding it as need be.
+  uint32 InternString(const std::wstring& str);
+
+  bool wanted_[NUM_RECORD_KINDS];
+  std::string records_[NUM_RECORD_KINDS];
+
+  std::vector<std::wstring> strings_;
+  typedef std::map<std::wstring, uint32> StringIndex;
+  StringIndex string_index_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnReader);
+};
+
+#endif  // SAWBUCK_PY_ETW_NATIVE_COLUMN_READER_H_
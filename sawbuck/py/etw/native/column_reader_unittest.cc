@@ -0,0 +1,141 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Column reader unittests.
+#include "sawbuck/py/etw/native/column_reader.h"
+
+#include "base/files/file_path.h"
+#include "base/path_service.h"
+#include "gtest/gtest.h"
+#include "sawbuck/log_lib/kernel_log_unittest_data.h"
+
+namespace {
+
+class ColumnReaderTest: public testing::Test {
+ public:
+  virtual void SetUp() {
+    base::FilePath src_root;
+    ASSERT_TRUE(PathService::Get(base::DIR_SOURCE_ROOT, &src_root));
+    test_data_dir_ = src_root.AppendASCII("sawbuck\\log_lib\\test_data");
+
+    // The test logs are artificially created, their headers don't tell
+    // their bitness.
+    reader_.set_infer_bitness_from_log(false);
+    reader_.set_is_64_bit_log(false);
+  }
+
+  const ColumnReader::ImageRecord& ImageRecordAt(size_t index) {
+    return reinterpret_cast<const ColumnReader::ImageRecord*>(
+        reader_.records(ColumnReader::IMAGE).data())[index];
+  }
+
+ protected:
+  base::FilePath test_data_dir_;
+  ColumnReader reader_;
+};
+
+TEST_F(ColumnReaderTest, RecordLayout) {
+  EXPECT_EQ(40, sizeof(ColumnReader::PageFaultRecord));
+  EXPECT_EQ(48, sizeof(ColumnReader::HardPageFaultRecord));
+  EXPECT_EQ(40, sizeof(ColumnReader::ImageRecord));
+}
+
+TEST_F(ColumnReaderTest, FieldLayout) {
+  for (int i = 0; i < ColumnReader::NUM_RECORD_KINDS; ++i) {
+    ColumnReader::RecordKind kind = static_cast<ColumnReader::RecordKind>(i);
+    const ColumnReader::FieldLayout* field =
+        ColumnReader::GetFieldLayout(kind);
+    ASSERT_TRUE(field != NULL);
+
+    // The fields are in order, and don't overlap.
+    size_t end = 0;
+    for (; field->name != NULL; ++field) {
+      EXPECT_LE(end, field->offset) << field->name;
+      // The formats are of the "<u4" form, ending with the size.
+      end = field->offset + (field->format[2] - '0');
+    }
+    EXPECT_LE(end, ColumnReader::RecordSize(kind));
+  }
+}
+
+TEST_F(ColumnReaderTest, RecordKindFromName) {
+  EXPECT_EQ(ColumnReader::PAGE_FAULT,
+            ColumnReader::RecordKindFromName("PageFault"));
+  EXPECT_EQ(ColumnReader::HARD_PAGE_FAULT,
+            ColumnReader::RecordKindFromName("HardPageFault"));
+  EXPECT_EQ(ColumnReader::IMAGE, ColumnReader::RecordKindFromName("Image"));
+  EXPECT_EQ(ColumnReader::NUM_RECORD_KINDS,
+            ColumnReader::RecordKindFromName("Bogus"));
+}
+
+TEST_F(ColumnReaderTest, ReadFailsForMissingFile) {
+  EXPECT_HRESULT_FAILED(
+      reader_.Read(test_data_dir_.Append(L"does_not_exist.etl")));
+}
+
+TEST_F(ColumnReaderTest, ReadsImageRecords) {
+  reader_.AddRecordKind(ColumnReader::IMAGE);
+  ASSERT_HRESULT_SUCCEEDED(
+      reader_.Read(test_data_dir_.Append(L"image_data_32_v2.etl")));
+
+  // All the modules are loaded to start with, then the first one is
+  // unloaded and loaded again.
+  ASSERT_EQ(testing::kNumModules + 2,
+            reader_.num_records(ColumnReader::IMAGE));
+  for (size_t i = 0; i < testing::kNumModules; ++i) {
+    const ColumnReader::ImageRecord& record = ImageRecordAt(i);
+    EXPECT_EQ(ColumnReader::IMAGE_IS_LOADED, record.event_type);
+    EXPECT_EQ(testing::module_list[i].base_address, record.base_address);
+    EXPECT_EQ(testing::module_list[i].module_size, record.module_size);
+    ASSERT_LT(record.name_index, reader_.strings().size());
+    EXPECT_EQ(testing::module_list[i].image_file_name,
+              reader_.strings()[record.name_index]);
+  }
+
+  const ColumnReader::ImageRecord& unload =
+      ImageRecordAt(testing::kNumModules);
+  const ColumnReader::ImageRecord& load =
+      ImageRecordAt(testing::kNumModules + 1);
+  EXPECT_EQ(ColumnReader::IMAGE_UNLOAD, unload.event_type);
+  EXPECT_EQ(ColumnReader::IMAGE_LOAD, load.event_type);
+  // The names are interned.
+  EXPECT_EQ(ImageRecordAt(0).name_index, unload.name_index);
+  EXPECT_EQ(ImageRecordAt(0).name_index, load.name_index);
+  EXPECT_LE(unload.time, load.time);
+
+  // Only the kinds asked for are recorded.
+  EXPECT_EQ(0, reader_.num_records(ColumnReader::PAGE_FAULT));
+  EXPECT_EQ(0, reader_.num_records(ColumnReader::HARD_PAGE_FAULT));
+}
+
+TEST_F(ColumnReaderTest, TakeRecords) {
+  reader_.AddRecordKind(ColumnReader::IMAGE);
+  ASSERT_HRESULT_SUCCEEDED(
+      reader_.Read(test_data_dir_.Append(L"image_data_32_v2.etl")));
+  const size_t num_records = reader_.num_records(ColumnReader::IMAGE);
+  const size_t num_strings = reader_.strings().size();
+  ASSERT_LT(0U, num_records);
+
+  // The records are handed over, while the strings stay.
+  std::string records("stale");
+  reader_.TakeRecords(ColumnReader::IMAGE, &records);
+  EXPECT_EQ(num_records * sizeof(ColumnReader::ImageRecord), records.size());
+  EXPECT_EQ(0, reader_.num_records(ColumnReader::IMAGE));
+  EXPECT_EQ(num_strings, reader_.strings().size());
+
+  reader_.TakeRecords(ColumnReader::IMAGE, &records);
+  EXPECT_TRUE(records.empty());
+}
+
+}  // namespace
@@ -0,0 +1,214 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Column stream implementation.
+#include "sawbuck/py/etw/native/column_stream.h"
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/stl_util.h"
+#include "sawbuck/log_lib/kernel_log_types.h"
+
+namespace {
+
+// Real time sessions deliver the events in the layout of the system's
+// kernel, whatever our own bitness.
+bool Is64BitSystem() {
+  if (sizeof(void*) == 8)  // NOLINT
+    return true;
+
+  BOOL is_wow_64 = FALSE;
+  return ::IsWow64Process(::GetCurrentProcess(), &is_wow_64) && is_wow_64;
+}
+
+}  // namespace
+
+ColumnStream* ColumnStream::current_ = NULL;
+
+ColumnStream::Stats::Stats()
+    : batches_delivered(0), batches_dropped(0), events_lost(0),
+      buffers_lost(0) {
+  for (int i = 0; i < ColumnReader::NUM_RECORD_KINDS; ++i)
+    records_dropped[i] = 0;
+}
+
+ColumnStream::ColumnStream(size_t max_batches, base::TimeDelta slice)
+    : strings_handed_out_(0), slice_(slice), batch_queued_(&lock_),
+      max_batches_(max_batches), consuming_(false),
+      thread_("Column stream") {
+  DCHECK_LT(0U, max_batches);
+  reader_.set_infer_bitness_from_log(false);
+  reader_.set_is_64_bit_log(Is64BitSystem());
+}
+
+ColumnStream::~ColumnStream() {
+  Stop();
+  STLDeleteElements(&queue_);
+}
+
+void ColumnStream::AddRecordKind(ColumnReader::RecordKind kind) {
+  DCHECK(!thread_.IsRunning());
+  reader_.AddRecordKind(kind);
+}
+
+HRESULT ColumnStream::Start(const wchar_t* session_name) {
+  DCHECK(session_name != NULL);
+  if (current_ != NULL || thread_.IsRunning())
+    return HRESULT_FROM_WIN32(ERROR_BUSY);
+
+  HRESULT hr = OpenRealtimeSession(session_name);
+  if (FAILED(hr))
+    return hr;
+  if (!thread_.Start()) {
+    Close();
+    return E_FAIL;
+  }
+
+  current_ = this;
+  {
+    base::AutoLock lock(lock_);
+    consuming_ = true;
+  }
+  thread_.message_loop()->PostTask(FROM_HERE,
+      base::Bind(&ColumnStream::ConsumeSession, base::Unretained(this)));
+  return S_OK;
+}
+
+bool ColumnStream::NextBatch(base::TimeDelta timeout, Batch* batch) {
+  DCHECK(batch != NULL);
+  base::TimeTicks deadline = base::TimeTicks::Now() + timeout;
+
+  base::AutoLock lock(lock_);
+  while (queue_.empty() && consuming_) {
+    base::TimeDelta left = deadline - base::TimeTicks::Now();
+    if (left <= base::TimeDelta())
+      return false;
+    batch_queued_.TimedWait(left);
+  }
+  if (queue_.empty())
+    return false;
+
+  Batch* oldest = queue_.front();
+  queue_.pop_front();
+  for (int i = 0; i < ColumnReader::NUM_RECORD_KINDS; ++i)
+    batch->records[i].swap(oldest->records[i]);
+  batch->first_string = oldest->first_string;
+  batch->strings.swap(oldest->strings);
+  delete oldest;
+  ++stats_.batches_delivered;
+  return true;
+}
+
+void ColumnStream::Stop() {
+  if (!thread_.IsRunning())
+    return;
+
+  // Closing the session ends the consumption once the current buffer is
+  // through.
+  Close();
+  thread_.Stop();
+  current_ = NULL;
+}
+
+bool ColumnStream::is_consuming() {
+  base::AutoLock lock(lock_);
+  return consuming_;
+}
+
+void ColumnStream::GetStats(Stats* stats) {
+  DCHECK(stats != NULL);
+  base::AutoLock lock(lock_);
+  *stats = stats_;
+}
+
+void ColumnStream::ProcessEvent(EVENT_TRACE* event) {
+  DCHECK(current_ != NULL);
+  if (current_ == NULL)
+    return;
+
+  if (event->Header.Guid == kernel_log_types::kRtLostEventClass) {
+    base::AutoLock lock(current_->lock_);
+    if (event->Header.Class.Type == kernel_log_types::kRtLostEvent)
+      ++current_->stats_.events_lost;
+    else if (event->Header.Class.Type == kernel_log_types::kRtLostBuffer)
+      ++current_->stats_.buffers_lost;
+    return;
+  }
+
+  current_->reader_.ProcessOneEvent(event);
+}
+
+bool ColumnStream::ProcessBuffer(EVENT_TRACE_LOGFILE* buffer) {
+  DCHECK(current_ != NULL);
+  if (current_ == NULL)
+    return false;
+
+  // The buffers are the natural boundary of the batches, as each holds
+  // the events of a stretch of time on a processor.
+  base::TimeTicks now = base::TimeTicks::Now();
+  if (now - current_->slice_start_ >= current_->slice_) {
+    current_->QueueBatch();
+    current_->slice_start_ = now;
+  }
+  return true;
+}
+
+void ColumnStream::ConsumeSession() {
+  slice_start_ = base::TimeTicks::Now();
+  HRESULT hr = Consume();
+  if (FAILED(hr))
+    LOG(ERROR) << "Error consuming the session: " << hr;
+
+  // Whatever came after the last full slice makes for a last batch.
+  QueueBatch();
+
+  base::AutoLock lock(lock_);
+  consuming_ = false;
+  batch_queued_.Broadcast();
+}
+
+void ColumnStream::QueueBatch() {
+  scoped_ptr<Batch> batch(new Batch());
+  bool empty = true;
+  for (int i = 0; i < ColumnReader::NUM_RECORD_KINDS; ++i) {
+    reader_.TakeRecords(static_cast<ColumnReader::RecordKind>(i),
+                        &batch->records[i]);
+    empty = empty && batch->records[i].empty();
+  }
+  const std::vector<std::wstring>& strings = reader_.strings();
+  batch->first_string = static_cast<uint32>(strings_handed_out_);
+  batch->strings.assign(strings.begin() + strings_handed_out_,
+                        strings.end());
+  strings_handed_out_ = strings.size();
+  if (empty && batch->strings.empty())
+    return;
+
+  base::AutoLock lock(lock_);
+  if (queue_.size() < max_batches_) {
+    queue_.push_back(batch.release());
+    batch_queued_.Signal();
+    return;
+  }
+
+  // The records are dropped, but not the strings, which later records
+  // may refer to. They follow on from those of the newest batch queued.
+  ++stats_.batches_dropped;
+  for (int i = 0; i < ColumnReader::NUM_RECORD_KINDS; ++i) {
+    stats_.records_dropped[i] += batch->records[i].size() /
+        ColumnReader::RecordSize(static_cast<ColumnReader::RecordKind>(i));
+  }
+  std::vector<std::wstring>& newest = queue_.back()->strings;
+  newest.insert(newest.end(), batch->strings.begin(), batch->strings.end());
+}
@@ -0,0 +1,125 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Column stream declaration, decoding a real time session into batches of
+// packed records for the etw module.
+#ifndef SAWBUCK_PY_ETW_NATIVE_COLUMN_STREAM_H_
+#define SAWBUCK_PY_ETW_NATIVE_COLUMN_STREAM_H_
+
+#include <deque>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread.h"
+#include "base/time/time.h"
+#include "base/win/event_trace_consumer.h"
+#include "sawbuck/py/etw/native/column_reader.h"
+
+// Consumes a real time session on a thread of its own, decoding its kernel
+// events into the records of a ColumnReader. The records are cut into a
+// batch per ETW buffer, or per time slice, and queued for the etw module
+// to take. Python never sees the events one by one, and a script that
+// falls behind doesn't hold up the session: once the queue is full, new
+// batches are dropped and counted.
+// As the ETW callbacks are static, one instance consumes at a time.
+class ColumnStream : public base::win::EtwTraceConsumerBase<ColumnStream> {
+ public:
+  struct Batch {
+    // The records of each kind, packed as ColumnReader packs them.
+    std::string records[ColumnReader::NUM_RECORD_KINDS];
+    // The strings first interned in this batch, the first of which has
+    // the index first_string. The records refer to earlier batches'
+    // strings too.
+    uint32 first_string;
+    std::vector<std::wstring> strings;
+  };
+
+  struct Stats {
+    Stats();
+
+    int64 batches_delivered;
+    int64 batches_dropped;
+    // The records of the batches dropped, by kind.
+    int64 records_dropped[ColumnReader::NUM_RECORD_KINDS];
+    // The losses the session reported, before any of our own.
+    int64 events_lost;
+    int64 buffers_lost;
+  };
+
+  // @param max_batches the number of batches queued at most, at least one.
+  // @param slice the time a batch covers at least, zero for one batch
+  //     per ETW buffer.
+  ColumnStream(size_t max_batches, base::TimeDelta slice);
+  ~ColumnStream();
+
+  // Records the events of @p kind, which are skipped otherwise.
+  // @pre the stream isn't started.
+  void AddRecordKind(ColumnReader::RecordKind kind);
+
+  // Opens the real time session @p session_name, and starts consuming it.
+  // @returns S_OK on success, an error code otherwise.
+  HRESULT Start(const wchar_t* session_name);
+
+  // Takes the oldest batch queued into @p batch, waiting up to @p timeout
+  // for one to come.
+  // @returns false if there was none, in which case the stream may have
+  //     stopped, see is_consuming.
+  bool NextBatch(base::TimeDelta timeout, Batch* batch);
+
+  // Closes the session, and waits for the consumption to stop. The batches
+  // queued can still be taken.
+  void Stop();
+
+  // Returns true until the session closes or fails.
+  bool is_consuming();
+  // Retrieves the tallies so far to @p stats.
+  void GetStats(Stats* stats);
+
+  // The ETW callbacks.
+  static void ProcessEvent(EVENT_TRACE* event);
+  static bool ProcessBuffer(EVENT_TRACE_LOGFILE* buffer);
+
+ private:
+  // Runs on thread_, for as long as the session is open.
+  void ConsumeSession();
+
+  // Cuts what's been decoded since the previous batch into a batch, and
+  // queues it. Runs on thread_.
+  void QueueBatch();
+
+  // The consumption's state, only touched on thread_.
+  ColumnReader reader_;
+  size_t strings_handed_out_;
+  base::TimeTicks slice_start_;
+  const base::TimeDelta slice_;
+
+  base::Lock lock_;
+  // Signaled as batches queue up, and as the consumption stops.
+  base::ConditionVariable batch_queued_;  // Under lock_.
+  std::deque<Batch*> queue_;  // Under lock_.
+  const size_t max_batches_;
+  bool consuming_;  // Under lock_.
+  Stats stats_;  // Under lock_.
+
+  base::Thread thread_;
+
+  // The instance consuming.
+  static ColumnStream* current_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnStream);
+};
+
+#endif  // SAWBUCK_PY_ETW_NATIVE_COLUMN_STREAM_H_
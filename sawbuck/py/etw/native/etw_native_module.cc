@@ -0,0 +1,918 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// The _etw_native extension module, exposing NativeEventSource to the etw
+// module as _etw_native.EventSource, SymbolResolver as
+// _etw_native.SymbolResolver, and ColumnStream as _etw_native.ColumnStream.
+#include "sawbuck/py/etw/native/native_event_source.h"
+
+#include <objbase.h>
+#include <map>
+#include "base/at_exit.h"
+#include "base/logging.h"
+#include "sawbuck/py/etw/native/column_reader.h"
+#include "sawbuck/py/etw/native/column_stream.h"
+#include "sawbuck/py/etw/native/symbol_resolver.h"
+
+namespace {
+
+// The parsers use base facilities that expect an AtExitManager. It's leaked,
+// as extension modules are never unloaded.
+base::AtExitManager* at_exit_manager = NULL;
+
+struct EventSourceObject {
+  PyObject_HEAD
+  NativeEventSource* source;
+};
+
+PyObject* EventSource_new(PyTypeObject* type, PyObject* args,
+                          PyObject* kwds) {
+  EventSourceObject* self =
+      reinterpret_cast<EventSourceObject*>(type->tp_alloc(type, 0));
+  if (self == NULL)
+    return NULL;
+
+  self->source = new NativeEventSource();
+  return reinterpret_cast<PyObject*>(self);
+}
+
+void EventSource_dealloc(EventSourceObject* self) {
+  delete self->source;
+  self->ob_type->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+// Raises WindowsError for a failed @p hr.
+PyObject* FromHResult(HRESULT hr) {
+  if (FAILED(hr))
+    return PyErr_SetFromWindowsErr(HRESULT_CODE(hr));
+
+  Py_RETURN_NONE;
+}
+
+PyObject* EventSource_OpenRealtimeSession(EventSourceObject* self,
+                                          PyObject* args) {
+  const Py_UNICODE* name = NULL;
+  if (!PyArg_ParseTuple(args, "u:OpenRealtimeSession", &name))
+    return NULL;
+
+  return FromHResult(self->source->OpenRealtimeSession(name));
+}
+
+PyObject* EventSource_OpenFileSession(EventSourceObject* self,
+                                      PyObject* args) {
+  const Py_UNICODE* path = NULL;
+  if (!PyArg_ParseTuple(args, "u:OpenFileSession", &path))
+    return NULL;
+
+  return FromHResult(self->source->OpenFileSession(path));
+}
+
+PyObject* EventSource_SetHandler(EventSourceObject* self, PyObject* args) {
+  PyObject* handler = NULL;
+  if (!PyArg_ParseTuple(args, "O:SetHandler", &handler))
+    return NULL;
+
+  if (!self->source->SetHandler(handler))
+    return NULL;
+
+  Py_RETURN_NONE;
+}
+
+PyObject* EventSource_AddPythonEvent(EventSourceObject* self,
+                                     PyObject* args) {
+  Py_UNICODE* guid_string = NULL;
+  unsigned char type = 0;
+  if (!PyArg_ParseTuple(args, "ub:AddPythonEvent", &guid_string, &type))
+    return NULL;
+
+  GUID event_class = {};
+  if (FAILED(::CLSIDFromString(guid_string, &event_class))) {
+    PyErr_SetString(PyExc_ValueError, "Malformed GUID.");
+    return NULL;
+  }
+
+  self->source->AddPythonEvent(event_class, type);
+  Py_RETURN_NONE;
+}
+
+PyObject* EventSource_SetPythonCallback(EventSourceObject* self,
+                                        PyObject* args) {
+  PyObject* callback = NULL;
+  if (!PyArg_ParseTuple(args, "O:SetPythonCallback", &callback))
+    return NULL;
+
+  if (callback != Py_None && !PyCallable_Check(callback)) {
+    PyErr_SetString(PyExc_TypeError, "The callback must be callable.");
+    return NULL;
+  }
+
+  self->source->SetPythonCallback(callback);
+  Py_RETURN_NONE;
+}
+
+PyObject* EventSource_Consume(EventSourceObject* self, PyObject* unused) {
+  if (!self->source->ConsumeSessions())
+    return NULL;
+
+  Py_RETURN_NONE;
+}
+
+PyObject* EventSource_Close(EventSourceObject* self, PyObject* unused) {
+  return FromHResult(self->source->Close());
+}
+
+PyMethodDef EventSource_methods[] = {
+  { "OpenRealtimeSession",
+    reinterpret_cast<PyCFunction>(EventSource_OpenRealtimeSession),
+    METH_VARARGS,
+    "Opens the real time session of a name." },
+  { "OpenFileSession",
+    reinterpret_cast<PyCFunction>(EventSource_OpenFileSession),
+    METH_VARARGS,
+    "Opens a file session for the file at a path." },
+  { "SetHandler",
+    reinterpret_cast<PyCFunction>(EventSource_SetHandler),
+    METH_VARARGS,
+    "Sets the object whose On* methods get the natively decoded events." },
+  { "AddPythonEvent",
+    reinterpret_cast<PyCFunction>(EventSource_AddPythonEvent),
+    METH_VARARGS,
+    "Hands the events of a class GUID string and type to the callback." },
+  { "SetPythonCallback",
+    reinterpret_cast<PyCFunction>(EventSource_SetPythonCallback),
+    METH_VARARGS,
+    "Sets callback(event_address, is_64_bit_log), which gets the events\n"
+    "added with AddPythonEvent and returns False to stop consuming." },
+  { "Consume",
+    reinterpret_cast<PyCFunction>(EventSource_Consume),
+    METH_NOARGS,
+    "Consumes the open sessions." },
+  { "Close",
+    reinterpret_cast<PyCFunction>(EventSource_Close),
+    METH_NOARGS,
+    "Closes the open sessions." },
+  { NULL },
+};
+
+PyTypeObject EventSourceType = {
+  PyObject_HEAD_INIT(NULL)
+  0,                                         // ob_size
+  "_etw_native.EventSource",                 // tp_name
+  sizeof(EventSourceObject),                 // tp_basicsize
+  0,                                         // tp_itemsize
+  reinterpret_cast<destructor>(EventSource_dealloc),  // tp_dealloc
+  0,                                         // tp_print
+  0,                                         // tp_getattr
+  0,                                         // tp_setattr
+  0,                                         // tp_compare
+  0,                                         // tp_repr
+  0,                                         // tp_as_number
+  0,                                         // tp_as_sequence
+  0,                                         // tp_as_mapping
+  0,                                         // tp_hash
+  0,                                         // tp_call
+  0,                                         // tp_str
+  0,                                         // tp_getattro
+  0,                                         // tp_setattro
+  0,                                         // tp_as_buffer
+  Py_TPFLAGS_DEFAULT,                        // tp_flags
+  "Consumes trace sessions, decoding the events log_lib knows natively.",
+  0,                                         // tp_traverse
+  0,                                         // tp_clear
+  0,                                         // tp_richcompare
+  0,                                         // tp_weaklistoffset
+  0,                                         // tp_iter
+  0,                                         // tp_iternext
+  EventSource_methods,                       // tp_methods
+  0,                                         // tp_members
+  0,                                         // tp_getset
+  0,                                         // tp_base
+  0,                                         // tp_dict
+  0,                                         // tp_descr_get
+  0,                                         // tp_descr_set
+  0,                                         // tp_dictoffset
+  0,                                         // tp_init
+  0,                                         // tp_alloc
+  EventSource_new,                           // tp_new
+};
+
+// Returns a new dict of the record string of each kind of @p records, or
+// NULL with a Python exception set.
+PyObject* BuildRecordDict(const std::string* records) {
+  PyObject* dict = PyDict_New();
+  if (dict == NULL)
+    return NULL;
+  for (int i = 0; i < ColumnReader::NUM_RECORD_KINDS; ++i) {
+    PyObject* value = PyString_FromStringAndSize(records[i].data(),
+                                                 records[i].size());
+    if (value == NULL ||
+        PyDict_SetItemString(dict, ColumnReader::kRecordKindNames[i],
+                             value) < 0) {
+      Py_XDECREF(value);
+      Py_DECREF(dict);
+      return NULL;
+    }
+    Py_DECREF(value);
+  }
+  return dict;
+}
+
+// Returns a new list of @p strings, or NULL with a Python exception set.
+PyObject* BuildStringList(const std::vector<std::wstring>& strings) {
+  PyObject* list = PyList_New(strings.size());
+  if (list == NULL)
+    return NULL;
+  for (size_t i = 0; i < strings.size(); ++i) {
+    PyObject* value = PyUnicode_FromWideChar(strings[i].c_str(),
+                                             strings[i].size());
+    if (value == NULL) {
+      Py_DECREF(list);
+      return NULL;
+    }
+    // PyList_SET_ITEM steals the reference.
+    PyList_SET_ITEM(list, i, value);
+  }
+  return list;
+}
+
+PyObject* ReadRecords(PyObject* self, PyObject* args) {
+  const Py_UNICODE* path = NULL;
+  PyObject* kinds = NULL;
+  if (!PyArg_ParseTuple(args, "uO:ReadRecords", &path, &kinds))
+    return NULL;
+
+  ColumnReader reader;
+  PyObject* iterator = PyObject_GetIter(kinds);
+  if (iterator == NULL)
+    return NULL;
+  while (PyObject* item = PyIter_Next(iterator)) {
+    const char* name = PyString_AsString(item);
+    ColumnReader::RecordKind kind = ColumnReader::NUM_RECORD_KINDS;
+    if (name != NULL) {
+      kind = ColumnReader::RecordKindFromName(name);
+      if (kind == ColumnReader::NUM_RECORD_KINDS)
+        PyErr_Format(PyExc_ValueError, "Unknown event class %s.", name);
+    }
+    Py_DECREF(item);
+    if (kind == ColumnReader::NUM_RECORD_KINDS) {
+      Py_DECREF(iterator);
+      return NULL;
+    }
+    reader.AddRecordKind(kind);
+  }
+  Py_DECREF(iterator);
+  if (PyErr_Occurred())
+    return NULL;
+
+  // The reading doesn't touch Python.
+  HRESULT hr = S_OK;
+  Py_BEGIN_ALLOW_THREADS
+  hr = reader.Read(base::FilePath(path));
+  Py_END_ALLOW_THREADS
+  if (FAILED(hr))
+    return PyErr_SetFromWindowsErr(HRESULT_CODE(hr));
+
+  std::string records[ColumnReader::NUM_RECORD_KINDS];
+  for (int i = 0; i < ColumnReader::NUM_RECORD_KINDS; ++i)
+    reader.TakeRecords(static_cast<ColumnReader::RecordKind>(i), &records[i]);
+  PyObject* record_dict = BuildRecordDict(records);
+  if (record_dict == NULL)
+    return NULL;
+  PyObject* string_list = BuildStringList(reader.strings());
+  if (string_list == NULL) {
+    Py_DECREF(record_dict);
+    return NULL;
+  }
+
+  return Py_BuildValue("(NN)", record_dict, string_list);
+}
+
+struct ColumnStreamObject {
+  PyObject_HEAD
+  ColumnStream* stream;
+};
+
+PyObject* ColumnStream_new(PyTypeObject* type, PyObject* args,
+                           PyObject* kwds) {
+  Py_ssize_t max_batches = 0;
+  double slice = 0;
+  if (!PyArg_ParseTuple(args, "nd:ColumnStream", &max_batches, &slice))
+    return NULL;
+  if (max_batches < 1 || slice < 0) {
+    PyErr_SetString(PyExc_ValueError,
+                    "At least one batch must queue, over a positive slice.");
+    return NULL;
+  }
+
+  ColumnStreamObject* self =
+      reinterpret_cast<ColumnStreamObject*>(type->tp_alloc(type, 0));
+  if (self == NULL)
+    return NULL;
+
+  self->stream = new ColumnStream(
+      max_batches,
+      base::TimeDelta::FromMicroseconds(static_cast<int64>(slice * 1e6)));
+  return reinterpret_cast<PyObject*>(self);
+}
+
+void ColumnStream_dealloc(ColumnStreamObject* self) {
+  // This waits for the consumption to stop, which doesn't need Python.
+  Py_BEGIN_ALLOW_THREADS
+  delete self->stream;
+  Py_END_ALLOW_THREADS
+  self->ob_type->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+PyObject* ColumnStream_AddRecordKind(ColumnStreamObject* self,
+                                     PyObject* args) {
+  const char* name = NULL;
+  if (!PyArg_ParseTuple(args, "s:AddRecordKind", &name))
+    return NULL;
+
+  ColumnReader::RecordKind kind = ColumnReader::RecordKindFromName(name);
+  if (kind == ColumnReader::NUM_RECORD_KINDS) {
+    PyErr_Format(PyExc_ValueError, "Unknown event class %s.", name);
+    return NULL;
+  }
+
+  self->stream->AddRecordKind(kind);
+  Py_RETURN_NONE;
+}
+
+PyObject* ColumnStream_Start(ColumnStreamObject* self, PyObject* args) {
+  const Py_UNICODE* name = NULL;
+  if (!PyArg_ParseTuple(args, "u:Start", &name))
+    return NULL;
+
+  return FromHResult(self->stream->Start(name));
+}
+
+PyObject* ColumnStream_NextBatch(ColumnStreamObject* self, PyObject* args) {
+  double timeout = 0;
+  if (!PyArg_ParseTuple(args, "d:NextBatch", &timeout))
+    return NULL;
+
+  ColumnStream::Batch batch;
+  bool got_batch = false;
+  Py_BEGIN_ALLOW_THREADS
+  got_batch = self->stream->NextBatch(
+      base::TimeDelta::FromMicroseconds(static_cast<int64>(timeout * 1e6)),
+      &batch);
+  Py_END_ALLOW_THREADS
+  if (!got_batch)
+    Py_RETURN_NONE;
+
+  PyObject* record_dict = BuildRecordDict(batch.records);
+  if (record_dict == NULL)
+    return NULL;
+  PyObject* string_list = BuildStringList(batch.strings);
+  if (string_list == NULL) {
+    Py_DECREF(record_dict);
+    return NULL;
+  }
+
+  return Py_BuildValue("(NkN)", record_dict,
+                       static_cast<unsigned long>(batch.first_string),
+                       string_list);
+}
+
+PyObject* ColumnStream_Stop(ColumnStreamObject* self, PyObject* unused) {
+  Py_BEGIN_ALLOW_THREADS
+  self->stream->Stop();
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+PyObject* ColumnStream_IsConsuming(ColumnStreamObject* self,
+                                   PyObject* unused) {
+  return PyBool_FromLong(self->stream->is_consuming());
+}
+
+PyObject* ColumnStream_Stats(ColumnStreamObject* self, PyObject* unused) {
+  ColumnStream::Stats stats;
+  self->stream->GetStats(&stats);
+
+  PyObject* records_dropped = PyDict_New();
+  if (records_dropped == NULL)
+    return NULL;
+  for (int i = 0; i < ColumnReader::NUM_RECORD_KINDS; ++i) {
+    PyObject* value = PyLong_FromLongLong(stats.records_dropped[i]);
+    if (value == NULL ||
+        PyDict_SetItemString(records_dropped,
+                             ColumnReader::kRecordKindNames[i],
+                             value) < 0) {
+      Py_XDECREF(value);
+      Py_DECREF(records_dropped);
+      return NULL;
+    }
+    Py_DECREF(value);
+  }
+
+  return Py_BuildValue("{sLsLsNsLsL}",
+                       "batches_delivered", stats.batches_delivered,
+                       "batches_dropped", stats.batches_dropped,
+                       "records_dropped", records_dropped,
+                       "events_lost", stats.events_lost,
+                       "buffers_lost", stats.buffers_lost);
+}
+
+PyMethodDef ColumnStream_methods[] = {
+  { "AddRecordKind",
+    reinterpret_cast<PyCFunction>(ColumnStream_AddRecordKind),
+    METH_VARARGS,
+    "Records the events of an event class, before the stream starts." },
+  { "Start",
+    reinterpret_cast<PyCFunction>(ColumnStream_Start),
+    METH_VARARGS,
+    "Starts consuming the real time session of a name." },
+  { "NextBatch",
+    reinterpret_cast<PyCFunction>(ColumnStream_NextBatch),
+    METH_VARARGS,
+    "NextBatch(timeout) waits up to timeout seconds for the oldest batch.
+"
+    "Returns None if none came, or a tuple of the dict of the record
+"
+    "string of each event class, the index of the first string the batch
+"
+    "interned, and the list of those strings." },
+  { "Stop",
+    reinterpret_cast<PyCFunction>(ColumnStream_Stop),
+    METH_NOARGS,
+    "Closes the session, the batches queued can still be taken." },
+  { "IsConsuming",
+    reinterpret_cast<PyCFunction>(ColumnStream_IsConsuming),
+    METH_NOARGS,
+    "Returns True until the session closes or fails." },
+  { "Stats",
+    reinterpret_cast<PyCFunction>(ColumnStream_Stats),
+    METH_NOARGS,
+    "Returns a dict of the tallies of the batches delivered and dropped,
+"
+    "the records dropped by event class, and the session's own losses." },
+  { NULL },
+};
+
+PyTypeObject ColumnStreamType = {
+  PyObject_HEAD_INIT(NULL)
+  0,                                         // ob_size
+  "_etw_native.ColumnStream",                // tp_name
+  sizeof(ColumnStreamObject),                // tp_basicsize
+  0,                                         // tp_itemsize
+  reinterpret_cast<destructor>(ColumnStream_dealloc),  // tp_dealloc
+  0,                                         // tp_print
+  0,                                         // tp_getattr
+  0,                                         // tp_setattr
+  0,                                         // tp_compare
+  0,                                         // tp_repr
+  0,                                         // tp_as_number
+  0,                                         // tp_as_sequence
+  0,                                         // tp_as_mapping
+  0,                                         // tp_hash
+  0,                                         // tp_call
+  0,                                         // tp_str
+  0,                                         // tp_getattro
+  0,                                         // tp_setattro
+  0,                                         // tp_as_buffer
+  Py_TPFLAGS_DEFAULT,                        // tp_flags
+  "ColumnStream(max_batches, slice) decodes a real time session into\n"
+  "batches of packed records on a thread of its own.",
+  0,                                         // tp_traverse
+  0,                                         // tp_clear
+  0,                                         // tp_richcompare
+  0,                                         // tp_weaklistoffset
+  0,                                         // tp_iter
+  0,                                         // tp_iternext
+  ColumnStream_methods,                      // tp_methods
+  0,                                         // tp_members
+  0,                                         // tp_getset
+  0,                                         // tp_base
+  0,                                         // tp_dict
+  0,                                         // tp_descr_get
+  0,                                         // tp_descr_set
+  0,                                         // tp_dictoffset
+  0,                                         // tp_init
+  0,                                         // tp_alloc
+  ColumnStream_new,                          // tp_new
+};
+
+struct SymbolResolverObject {
+  PyObject_HEAD
+  SymbolResolver* resolver;
+};
+
+PyObject* SymbolResolver_new(PyTypeObject* type, PyObject* args,
+                             PyObject* kwds) {
+  SymbolResolverObject* self =
+      reinterpret_cast<SymbolResolverObject*>(type->tp_alloc(type, 0));
+  if (self == NULL)
+    return NULL;
+
+  self->resolver = new SymbolResolver();
+  if (!self->resolver->Initialize()) {
+    Py_DECREF(self);
+    PyErr_SetString(PyExc_RuntimeError,
+                    "Error starting the symbol resolution thread.");
+    return NULL;
+  }
+  return reinterpret_cast<PyObject*>(self);
+}
+
+void SymbolResolver_dealloc(SymbolResolverObject* self) {
+  delete self->resolver;
+  self->ob_type->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+PyObject* SymbolResolver_ReadModules(SymbolResolverObject* self,
+                                     PyObject* args) {
+  const Py_UNICODE* path = NULL;
+  if (!PyArg_ParseTuple(args, "u:ReadModules", &path))
+    return NULL;
+
+  HRESULT hr = S_OK;
+  Py_BEGIN_ALLOW_THREADS
+  hr = self->resolver->ReadModules(base::FilePath(path));
+  Py_END_ALLOW_THREADS
+  return FromHResult(hr);
+}
+
+// Parses the (process_id, time, base_address, module_size, image_checksum,
+// time_date_stamp, image_file_name) arguments of the module notifications.
+bool ParseModuleArgs(PyObject* args,
+                     const char* format,
+                     sym_util::ProcessId* process_id,
+                     base::Time* time,
+                     sym_util::ModuleInformation* module) {
+  unsigned long pid = 0;
+  double time_value = 0;
+  unsigned PY_LONG_LONG base_address = 0;
+  unsigned long module_size = 0;
+  unsigned long image_checksum = 0;
+  unsigned long time_date_stamp = 0;
+  const Py_UNICODE* image_file_name = NULL;
+  if (!PyArg_ParseTuple(args, format, &pid, &time_value, &base_address,
+                        &module_size, &image_checksum, &time_date_stamp,
+                        &image_file_name)) {
+    return false;
+  }
+
+  *process_id = pid;
+  *time = base::Time::FromDoubleT(time_value);
+  module->base_address = base_address;
+  module->module_size = module_size;
+  module->image_checksum = image_checksum;
+  module->time_date_stamp = time_date_stamp;
+  module->image_file_name = image_file_name;
+  return true;
+}
+
+PyObject* SymbolResolver_ModuleLoaded(SymbolResolverObject* self,
+                                      PyObject* args) {
+  sym_util::ProcessId process_id = 0;
+  base::Time time;
+  sym_util::ModuleInformation module;
+  if (!ParseModuleArgs(args, "kdKkkku:ModuleLoaded", &process_id, &time,
+                       &module)) {
+    return NULL;
+  }
+
+  self->resolver->ModuleLoaded(process_id, time, module);
+  Py_RETURN_NONE;
+}
+
+PyObject* SymbolResolver_ModuleUnloaded(SymbolResolverObject* self,
+                                        PyObject* args) {
+  sym_util::ProcessId process_id = 0;
+  base::Time time;
+  sym_util::ModuleInformation module;
+  if (!ParseModuleArgs(args, "kdKkkku:ModuleUnloaded", &process_id, &time,
+                       &module)) {
+    return NULL;
+  }
+
+  self->resolver->ModuleUnloaded(process_id, time, module);
+  Py_RETURN_NONE;
+}
+
+PyObject* SymbolResolver_OpenPersistentCache(SymbolResolverObject* self,
+                                             PyObject* args) {
+  const Py_UNICODE* path = NULL;
+  if (!PyArg_ParseTuple(args, "u:OpenPersistentCache", &path))
+    return NULL;
+
+  self->resolver->OpenPersistentCache(base::FilePath(path));
+  Py_RETURN_NONE;
+}
+
+PyObject* SymbolResolver_SetSymbolPath(SymbolResolverObject* self,
+                                       PyObject* args) {
+  const Py_UNICODE* symbol_path = NULL;
+  if (!PyArg_ParseTuple(args, "u:SetSymbolPath", &symbol_path))
+    return NULL;
+
+  self->resolver->SetSymbolPath(symbol_path);
+  Py_RETURN_NONE;
+}
+
+// Interns the Python strings of the symbol strings, which repeat a lot in
+// bulk lookups.
+class SymbolStrings {
+ public:
+  SymbolStrings() {
+  }
+  ~SymbolStrings() {
+    for (StringMap::iterator it = strings_.begin(); it != strings_.end(); ++it)
+      Py_DECREF(it->second);
+  }
+
+  // @returns a new reference to the Python string of @p str, or NULL.
+  PyObject* Get(const std::wstring* str) {
+    StringMap::iterator it = strings_.find(str);
+    if (it == strings_.end()) {
+      PyObject* value = PyUnicode_FromWideChar(str->c_str(), str->size());
+      if (value == NULL)
+        return NULL;
+      it = strings_.insert(std::make_pair(str, value)).first;
+    }
+    Py_INCREF(it->second);
+    return it->second;
+  }
+
+ private:
+  // The strings of the symbol records are interned themselves, so their
+  // addresses are keys enough.
+  typedef std::map<const std::wstring*, PyObject*> StringMap;
+  StringMap strings_;
+
+  DISALLOW_COPY_AND_ASSIGN(SymbolStrings);
+};
+
+PyObject* SymbolResolver_Resolve(SymbolResolverObject* self, PyObject* args) {
+  const char* process_ids = NULL;
+  int process_ids_size = 0;
+  const char* times = NULL;
+  int times_size = 0;
+  const char* addresses = NULL;
+  int addresses_size = 0;
+  if (!PyArg_ParseTuple(args, "s#s#s#:Resolve",
+                        &process_ids, &process_ids_size,
+                        &times, &times_size,
+                        &addresses, &addresses_size)) {
+    return NULL;
+  }
+
+  size_t num_addresses = addresses_size / sizeof(sym_util::Address);
+  if (addresses_size % sizeof(sym_util::Address) != 0 ||
+      static_cast<size_t>(process_ids_size) !=
+          num_addresses * sizeof(sym_util::ProcessId) ||
+      static_cast<size_t>(times_size) != num_addresses * sizeof(double)) {
+    PyErr_SetString(PyExc_ValueError,
+                    "The buffers must be of as many uint32 process ids, "
+                    "float64 times and uint64 addresses.");
+    return NULL;
+  }
+
+  std::vector<sym_util::SymbolRecord> symbols;
+  Py_BEGIN_ALLOW_THREADS
+  self->resolver->Resolve(
+      reinterpret_cast<const sym_util::ProcessId*>(process_ids),
+      reinterpret_cast<const double*>(times),
+      reinterpret_cast<const sym_util::Address*>(addresses),
+      num_addresses,
+      &symbols);
+  Py_END_ALLOW_THREADS
+
+  PyObject* result = PyList_New(symbols.size());
+  if (result == NULL)
+    return NULL;
+  SymbolStrings strings;
+  for (size_t i = 0; i < symbols.size(); ++i) {
+    const sym_util::SymbolRecord& symbol = symbols[i];
+    PyObject* value = NULL;
+    if (symbol.name->empty()) {
+      Py_INCREF(Py_None);
+      value = Py_None;
+    } else {
+      value = Py_BuildValue("(NKNNkk)",
+                            strings.Get(symbol.module),
+                            static_cast<unsigned PY_LONG_LONG>(
+                                symbol.module_base),
+                            strings.Get(symbol.name),
+                            strings.Get(symbol.file),
+                            static_cast<unsigned long>(symbol.line),
+                            static_cast<unsigned long>(symbol.offset));
+    }
+    if (value == NULL) {
+      Py_DECREF(result);
+      return NULL;
+    }
+    // PyList_SET_ITEM steals the reference.
+    PyList_SET_ITEM(result, i, value);
+  }
+
+  return result;
+}
+
+PyMethodDef SymbolResolver_methods[] = {
+  { "ReadModules",
+    reinterpret_cast<PyCFunction>(SymbolResolver_ReadModules),
+    METH_VARARGS,
+    "Reads the module events of the log file at a path." },
+  { "ModuleLoaded",
+    reinterpret_cast<PyCFunction>(SymbolResolver_ModuleLoaded),
+    METH_VARARGS,
+    "ModuleLoaded(process_id, time, base_address, module_size,\n"
+    "image_checksum, time_date_stamp, image_file_name) notes a module\n"
+    "load. A time of 0 is the beginning of time." },
+  { "ModuleUnloaded",
+    reinterpret_cast<PyCFunction>(SymbolResolver_ModuleUnloaded),
+    METH_VARARGS,
+    "Notes a module unload, with the arguments of ModuleLoaded." },
+  { "OpenPersistentCache",
+    reinterpret_cast<PyCFunction>(SymbolResolver_OpenPersistentCache),
+    METH_VARARGS,
+    "Opens the persistent symbol cache at a path." },
+  { "SetSymbolPath",
+    reinterpret_cast<PyCFunction>(SymbolResolver_SetSymbolPath),
+    METH_VARARGS,
+    "Sets the symbol path." },
+  { "Resolve",
+    reinterpret_cast<PyCFunction>(SymbolResolver_Resolve),
+    METH_VARARGS,
+    "Resolve(process_ids, times, addresses) resolves the addresses of\n"
+    "buffers of as many uint32 process ids, float64 times and uint64\n"
+    "addresses. Returns a list of a (module, module_base, name, file,\n"
+    "line, offset) tuple per address, or None where it doesn't resolve." },
+  { NULL },
+};
+
+PyTypeObject SymbolResolverType = {
+  PyObject_HEAD_INIT(NULL)
+  0,                                         // ob_size
+  "_etw_native.SymbolResolver",              // tp_name
+  sizeof(SymbolResolverObject),              // tp_basicsize
+  0,                                         // tp_itemsize
+  reinterpret_cast<destructor>(SymbolResolver_dealloc),  // tp_dealloc
+  0,                                         // tp_print
+  0,                                         // tp_getattr
+  0,                                         // tp_setattr
+  0,                                         // tp_compare
+  0,                                         // tp_repr
+  0,                                         // tp_as_number
+  0,                                         // tp_as_sequence
+  0,                                         // tp_as_mapping
+  0,                                         // tp_hash
+  0,                                         // tp_call
+  0,                                         // tp_str
+  0,                                         // tp_getattro
+  0,                                         // tp_setattro
+  0,                                         // tp_as_buffer
+  Py_TPFLAGS_DEFAULT,                        // tp_flags
+  "Resolves addresses in the processes of kernel logs to symbols.",
+  0,                                         // tp_traverse
+  0,                                         // tp_clear
+  0,                                         // tp_richcompare
+  0,                                         // tp_weaklistoffset
+  0,                                         // tp_iter
+  0,                                         // tp_iternext
+  SymbolResolver_methods,                    // tp_methods
+  0,                                         // tp_members
+  0,                                         // tp_getset
+  0,                                         // tp_base
+  0,                                         // tp_dict
+  0,                                         // tp_descr_get
+  0,                                         // tp_descr_set
+  0,                                         // tp_dictoffset
+  0,                                         // tp_init
+  0,                                         // tp_alloc
+  SymbolResolver_new,                        // tp_new
+};
+
+PyObject* RecordLayout(PyObject* self, PyObject* args) {
+  const char* name = NULL;
+  if (!PyArg_ParseTuple(args, "s:RecordLayout", &name))
+    return NULL;
+
+  ColumnReader::RecordKind kind = ColumnReader::RecordKindFromName(name);
+  if (kind == ColumnReader::NUM_RECORD_KINDS) {
+    PyErr_Format(PyExc_ValueError, "Unknown event class %s.", name);
+    return NULL;
+  }
+
+  PyObject* fields = PyList_New(0);
+  if (fields == NULL)
+    return NULL;
+  const ColumnReader::FieldLayout* field = ColumnReader::GetFieldLayout(kind);
+  for (; field->name != NULL; ++field) {
+    PyObject* value = Py_BuildValue("(ssn)", field->name, field->format,
+                                    static_cast<Py_ssize_t>(field->offset));
+    if (value == NULL || PyList_Append(fields, value) < 0) {
+      Py_XDECREF(value);
+      Py_DECREF(fields);
+      return NULL;
+    }
+    Py_DECREF(value);
+  }
+
+  return Py_BuildValue("(nN)",
+                       static_cast<Py_ssize_t>(ColumnReader::RecordSize(kind)),
+                       fields);
+}
+
+PyObject* LogEvents(PyObject* self, PyObject* args) {
+  unsigned PY_LONG_LONG session_handle = 0;
+  unsigned PY_LONG_LONG address = 0;
+  Py_ssize_t size = 0;
+  if (!PyArg_ParseTuple(args, "KKn:LogEvents", &session_handle, &address,
+                        &size)) {
+    return NULL;
+  }
+
+  // The events are packed one after the other, each header 8 byte aligned.
+  const char* data = reinterpret_cast<const char*>(address);
+  Py_ssize_t logged = 0;
+  Py_ssize_t failed = 0;
+  Py_BEGIN_ALLOW_THREADS
+  Py_ssize_t offset = 0;
+  while (offset + static_cast<Py_ssize_t>(sizeof(EVENT_TRACE_HEADER)) <=
+             size) {
+    EVENT_TRACE_HEADER* header =
+        reinterpret_cast<EVENT_TRACE_HEADER*>(
+            const_cast<char*>(data + offset));
+    if (header->Size < sizeof(EVENT_TRACE_HEADER))
+      break;
+
+    if (::TraceEvent(session_handle, header) == ERROR_SUCCESS)
+      ++logged;
+    else
+      ++failed;
+    offset += (header->Size + 7) & ~7;
+  }
+  Py_END_ALLOW_THREADS
+
+  return Py_BuildValue("(nn)", logged, failed);
+}
+
+PyMethodDef module_methods[] = {
+  { "RecordLayout",
+    RecordLayout,
+    METH_VARARGS,
+    "RecordLayout(event_class) returns the size of the records of\n"
+    "event_class, and the list of the (name, format, offset) tuples of\n"
+    "their fields." },
+  { "LogEvents",
+    LogEvents,
+    METH_VARARGS,
+    "LogEvents(session_handle, address, size) logs the events packed at\n"
+    "address, as etw.EventBatch packs them, one TraceEvent per event.\n"
+    "Returns the number of events logged, and of those that failed." },
+  { "ReadRecords",
+    ReadRecords,
+    METH_VARARGS,
+    "ReadRecords(path, event_classes) decodes the log file at path into\n"
+    "packed records. Returns a dict of the record string of each event\n"
+    "class, and the list of strings the records refer to by index." },
+  { NULL },
+};
+
+}  // namespace
+
+PyMODINIT_FUNC init_etw_native() {
+  if (at_exit_manager == NULL)
+    at_exit_manager = new base::AtExitManager();
+
+  if (PyType_Ready(&EventSourceType) < 0 ||
+      PyType_Ready(&SymbolResolverType) < 0 ||
+      PyType_Ready(&ColumnStreamType) < 0) {
+    return;
+  }
+
+  PyObject* module = Py_InitModule3("_etw_native", module_methods,
+      "Native trace consumption for the etw module.");
+  if (module == NULL)
+    return;
+
+  // Consume releases the GIL, so that other threads may run meanwhile, e.g.
+  // to close a real time session.
+  PyEval_InitThreads();
+
+  Py_INCREF(&EventSourceType);
+  PyModule_AddObject(module, "EventSource",
+                     reinterpret_cast<PyObject*>(&EventSourceType));
+  Py_INCREF(&SymbolResolverType);
+  PyModule_AddObject(module, "SymbolResolver",
+                     reinterpret_cast<PyObject*>(&SymbolResolverType));
+  Py_INCREF(&ColumnStreamType);
+  PyModule_AddObject(module, "ColumnStream",
+                     reinterpret_cast<PyObject*>(&ColumnStreamType));
+}
@@ -0,0 +1,424 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Native event source implementation.
+#include "sawbuck/py/etw/native/native_event_source.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+// Holds the GIL for its scope, from a thread that may or may not hold it.
+class ScopedGIL {
+ public:
+  ScopedGIL() : state_(PyGILState_Ensure()) {
+  }
+  ~ScopedGIL() {
+    PyGILState_Release(state_);
+  }
+
+ private:
+  PyGILState_STATE state_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedGIL);
+};
+
+// The etw module's time stamps are in seconds since 1.1.1970.
+double ToPythonTime(const base::Time& time) {
+  return time.ToDoubleT();
+}
+
+}  // namespace
+
+const char* const NativeEventSource::kNotificationNames[NUM_NOTIFICATIONS] = {
+  "OnLogMessage",
+  "OnTraceEventBegin",
+  "OnTraceEventEnd",
+  "OnTraceEventInstant",
+  "OnModuleIsLoaded",
+  "OnModuleUnload",
+  "OnModuleLoad",
+  "OnProcessIsRunning",
+  "OnProcessStarted",
+  "OnProcessEnded",
+  "OnThreadIsRunning",
+  "OnThreadStarted",
+  "OnThreadEnded",
+};
+
+NativeEventSource* NativeEventSource::current_ = NULL;
+
+bool NativeEventSource::PythonEventKey::operator<(
+    const PythonEventKey& o) const {
+  int ret = memcmp(&event_class, &o.event_class, sizeof(event_class));
+  if (ret != 0)
+    return ret < 0;
+  return type < o.type;
+}
+
+NativeEventSource::NativeEventSource()
+    : python_callback_(NULL), stopping_(false), error_type_(NULL),
+      error_value_(NULL), error_traceback_(NULL) {
+  for (int i = 0; i < NUM_NOTIFICATIONS; ++i)
+    methods_[i] = NULL;
+
+  LogParser::AddEventClasses(&router_);
+  KernelLogParser::AddEventClasses(&router_);
+}
+
+NativeEventSource::~NativeEventSource() {
+  DCHECK(current_ != this);
+  for (int i = 0; i < NUM_NOTIFICATIONS; ++i)
+    Py_XDECREF(methods_[i]);
+  Py_XDECREF(python_callback_);
+  Py_XDECREF(error_type_);
+  Py_XDECREF(error_value_);
+  Py_XDECREF(error_traceback_);
+}
+
+bool NativeEventSource::SetHandler(PyObject* handler) {
+  DCHECK(handler != NULL);
+  PyObject* methods[NUM_NOTIFICATIONS] = {};
+  if (handler != Py_None) {
+    for (int i = 0; i < NUM_NOTIFICATIONS; ++i) {
+      if (!PyObject_HasAttrString(handler, kNotificationNames[i]))
+        continue;
+
+      methods[i] = PyObject_GetAttrString(handler, kNotificationNames[i]);
+      if (methods[i] == NULL) {
+        for (int j = 0; j < i; ++j)
+          Py_XDECREF(methods[j]);
+        return false;
+      }
+    }
+  }
+
+  for (int i = 0; i < NUM_NOTIFICATIONS; ++i) {
+    Py_XDECREF(methods_[i]);
+    methods_[i] = methods[i];
+  }
+
+  // The parsers skip decoding the events no sink is set for.
+  set_event_sink(HasMethods(ON_LOG_MESSAGE, ON_LOG_MESSAGE) ? this : NULL);
+  set_trace_sink(
+      HasMethods(ON_TRACE_EVENT_BEGIN, ON_TRACE_EVENT_INSTANT) ? this : NULL);
+  set_module_event_sink(
+      HasMethods(ON_MODULE_IS_LOADED, ON_MODULE_LOAD) ? this : NULL);
+  set_process_event_sink(
+      HasMethods(ON_PROCESS_IS_RUNNING, ON_PROCESS_ENDED) ? this : NULL);
+  set_thread_event_sink(
+      HasMethods(ON_THREAD_IS_RUNNING, ON_THREAD_ENDED) ? this : NULL);
+
+  return true;
+}
+
+void NativeEventSource::AddPythonEvent(const GUID& event_class, UCHAR type) {
+  PythonEventKey key = { event_class, type };
+  PythonEventKeys::iterator it(
+      std::lower_bound(python_events_.begin(), python_events_.end(), key));
+  if (it == python_events_.end() || key < *it)
+    python_events_.insert(it, key);
+}
+
+void NativeEventSource::SetPythonCallback(PyObject* callback) {
+  DCHECK(callback != NULL);
+  Py_XDECREF(python_callback_);
+  python_callback_ = NULL;
+  if (callback != Py_None) {
+    Py_INCREF(callback);
+    python_callback_ = callback;
+  }
+}
+
+bool NativeEventSource::ConsumeSessions() {
+  if (current_ != NULL) {
+    PyErr_SetString(PyExc_RuntimeError,
+                    "Another event source is consuming.");
+    return false;
+  }
+
+  current_ = this;
+  stopping_ = false;
+
+  HRESULT hr = S_OK;
+  Py_BEGIN_ALLOW_THREADS
+  hr = Consume();
+  Py_END_ALLOW_THREADS
+
+  current_ = NULL;
+
+  if (error_type_ != NULL) {
+    // PyErr_Restore takes over our references.
+    PyErr_Restore(error_type_, error_value_, error_traceback_);
+    error_type_ = NULL;
+    error_value_ = NULL;
+    error_traceback_ = NULL;
+    return false;
+  }
+
+  if (FAILED(hr)) {
+    PyErr_SetFromWindowsErr(HRESULT_CODE(hr));
+    return false;
+  }
+
+  return true;
+}
+
+void NativeEventSource::ProcessEvent(EVENT_TRACE* event) {
+  DCHECK(current_ != NULL);
+  if (current_ != NULL && !current_->stopping_)
+    current_->DispatchEvent(event);
+}
+
+bool NativeEventSource::ProcessBuffer(EVENT_TRACE_LOGFILE* buffer) {
+  DCHECK(current_ != NULL);
+  // Returning false stops the consumption.
+  return current_ != NULL && !current_->stopping_;
+}
+
+void NativeEventSource::DispatchEvent(EVENT_TRACE* event) {
+  if (python_callback_ != NULL) {
+    PythonEventKey key = { event->Header.Guid, event->Header.Class.Type };
+    if (std::binary_search(python_events_.begin(), python_events_.end(),
+                           key)) {
+      ScopedGIL gil;
+      PyObject* result = PyObject_CallFunction(python_callback_, "(Ki)",
+          static_cast<unsigned PY_LONG_LONG>(
+              reinterpret_cast<uintptr_t>(event)),
+          is_64_bit_log() ? 1 : 0);
+      if (result == NULL) {
+        StopOnError();
+        return;
+      }
+
+      int keep_going = PyObject_IsTrue(result);
+      Py_DECREF(result);
+      if (keep_going < 0) {
+        StopOnError();
+        return;
+      }
+      if (keep_going == 0)
+        stopping_ = true;
+    }
+  }
+
+  // This sees to the log file header too, which tells the log's bitness.
+  router_.ProcessOneEvent(event);
+}
+
+bool NativeEventSource::HasMethods(Notification first,
+                                   Notification last) const {
+  for (int i = first; i <= last; ++i) {
+    if (methods_[i] != NULL)
+      return true;
+  }
+  return false;
+}
+
+void NativeEventSource::Notify(Notification notification, PyObject* args) {
+  DCHECK(methods_[notification] != NULL);
+  if (args != NULL) {
+    PyObject* result = PyObject_CallObject(methods_[notification], args);
+    Py_DECREF(args);
+    if (result != NULL) {
+      Py_DECREF(result);
+      return;
+    }
+  }
+
+  StopOnError();
+}
+
+void NativeEventSource::StopOnError() {
+  DCHECK(PyErr_Occurred());
+  if (error_type_ == NULL)
+    PyErr_Fetch(&error_type_, &error_value_, &error_traceback_);
+  else
+    PyErr_Clear();
+
+  stopping_ = true;
+}
+
+void NativeEventSource::OnModuleIsLoaded(DWORD process_id,
+                                         const base::Time& time,
+                                         const ModuleInformation& module_info) {
+  NotifyModule(ON_MODULE_IS_LOADED, process_id, time, module_info);
+}
+
+void NativeEventSource::OnModuleUnload(DWORD process_id,
+                                       const base::Time& time,
+                                       const ModuleInformation& module_info) {
+  NotifyModule(ON_MODULE_UNLOAD, process_id, time, module_info);
+}
+
+void NativeEventSource::OnModuleLoad(DWORD process_id,
+                                     const base::Time& time,
+                                     const ModuleInformation& module_info) {
+  NotifyModule(ON_MODULE_LOAD, process_id, time, module_info);
+}
+
+void NativeEventSource::NotifyModule(Notification notification,
+                                     DWORD process_id,
+                                     const base::Time& time,
+                                     const ModuleInformation& module_info) {
+  if (methods_[notification] == NULL)
+    return;
+
+  ScopedGIL gil;
+  const std::wstring& name = module_info.image_file_name;
+  Notify(notification,
+         Py_BuildValue("(dkKkkku#)",
+                       ToPythonTime(time),
+                       process_id,
+                       static_cast<unsigned PY_LONG_LONG>(
+                           module_info.base_address),
+                       module_info.module_size,
+                       module_info.image_checksum,
+                       module_info.time_date_stamp,
+                       name.c_str(),
+                       static_cast<Py_ssize_t>(name.size())));
+}
+
+void NativeEventSource::OnProcessIsRunning(const base::Time& time,
+                                           const ProcessInfo& process_info) {
+  NotifyProcess(ON_PROCESS_IS_RUNNING, time, process_info);
+}
+
+void NativeEventSource::OnProcessStarted(const base::Time& time,
+                                         const ProcessInfo& process_info) {
+  NotifyProcess(ON_PROCESS_STARTED, time, process_info);
+}
+
+void NativeEventSource::NotifyProcess(Notification notification,
+                                      const base::Time& time,
+                                      const ProcessInfo& process_info) {
+  if (methods_[notification] == NULL)
+    return;
+
+  ScopedGIL gil;
+  Notify(notification,
+         Py_BuildValue("(dkkks#u#)",
+                       ToPythonTime(time),
+                       process_info.process_id,
+                       process_info.parent_id,
+                       process_info.session_id,
+                       process_info.image_name.c_str(),
+                       static_cast<Py_ssize_t>(
+                           process_info.image_name.size()),
+                       process_info.command_line.c_str(),
+                       static_cast<Py_ssize_t>(
+                           process_info.command_line.size())));
+}
+
+void NativeEventSource::OnProcessEnded(const base::Time& time,
+                                       const ProcessInfo& process_info,
+                                       ULONG exit_status) {
+  if (methods_[ON_PROCESS_ENDED] == NULL)
+    return;
+
+  ScopedGIL gil;
+  Notify(ON_PROCESS_ENDED,
+         Py_BuildValue("(dkkks#u#k)",
+                       ToPythonTime(time),
+                       process_info.process_id,
+                       process_info.parent_id,
+                       process_info.session_id,
+                       process_info.image_name.c_str(),
+                       static_cast<Py_ssize_t>(
+                           process_info.image_name.size()),
+                       process_info.command_line.c_str(),
+                       static_cast<Py_ssize_t>(
+                           process_info.command_line.size()),
+                       exit_status));
+}
+
+void NativeEventSource::OnThreadIsRunning(const base::Time& time,
+                                          const ThreadInfo& thread_info) {
+  NotifyThread(ON_THREAD_IS_RUNNING, time, thread_info);
+}
+
+void NativeEventSource::OnThreadStarted(const base::Time& time,
+                                        const ThreadInfo& thread_info) {
+  NotifyThread(ON_THREAD_STARTED, time, thread_info);
+}
+
+void NativeEventSource::OnThreadEnded(const base::Time& time,
+                                      const ThreadInfo& thread_info) {
+  NotifyThread(ON_THREAD_ENDED, time, thread_info);
+}
+
+void NativeEventSource::NotifyThread(Notification notification,
+                                     const base::Time& time,
+                                     const ThreadInfo& thread_info) {
+  if (methods_[notification] == NULL)
+    return;
+
+  ScopedGIL gil;
+  Notify(notification,
+         Py_BuildValue("(dkk)",
+                       ToPythonTime(time),
+                       thread_info.process_id,
+                       thread_info.thread_id));
+}
+
+void NativeEventSource::OnLogMessage(const LogMessage& log_message) {
+  if (methods_[ON_LOG_MESSAGE] == NULL)
+    return;
+
+  ScopedGIL gil;
+  Notify(ON_LOG_MESSAGE,
+         Py_BuildValue("(dBkks#s#i)",
+                       ToPythonTime(log_message.time),
+                       log_message.level,
+                       log_message.process_id,
+                       log_message.thread_id,
+                       log_message.message,
+                       static_cast<Py_ssize_t>(log_message.message_len),
+                       log_message.file,
+                       static_cast<Py_ssize_t>(log_message.file_len),
+                       log_message.line));
+}
+
+void NativeEventSource::OnTraceEventBegin(const TraceMessage& trace_message) {
+  NotifyTrace(ON_TRACE_EVENT_BEGIN, trace_message);
+}
+
+void NativeEventSource::OnTraceEventEnd(const TraceMessage& trace_message) {
+  NotifyTrace(ON_TRACE_EVENT_END, trace_message);
+}
+
+void NativeEventSource::OnTraceEventInstant(
+    const TraceMessage& trace_message) {
+  NotifyTrace(ON_TRACE_EVENT_INSTANT, trace_message);
+}
+
+void NativeEventSource::NotifyTrace(Notification notification,
+                                    const TraceMessage& trace_message) {
+  if (methods_[notification] == NULL)
+    return;
+
+  ScopedGIL gil;
+  Notify(notification,
+         Py_BuildValue("(dkks#Ks#)",
+                       ToPythonTime(trace_message.time),
+                       trace_message.process_id,
+                       trace_message.thread_id,
+                       trace_message.name,
+                       static_cast<Py_ssize_t>(trace_message.name_len),
+                       static_cast<unsigned PY_LONG_LONG>(
+                           reinterpret_cast<uintptr_t>(trace_message.id)),
+                       trace_message.extra,
+                       static_cast<Py_ssize_t>(trace_message.extra_len)));
+}
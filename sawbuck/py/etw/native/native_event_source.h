@@ -0,0 +1,197 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Native event source declaration, backing the etw module's consumer.
+#ifndef SAWBUCK_PY_ETW_NATIVE_NATIVE_EVENT_SOURCE_H_
+#define SAWBUCK_PY_ETW_NATIVE_NATIVE_EVENT_SOURCE_H_
+
+// Python.h must come first, it redefines some of the standard headers'
+// macros.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>  // NOLINT
+#include <vector>
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/win/event_trace_consumer.h"
+#include "sawbuck/log_lib/event_router.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/log_lib/log_consumer.h"
+
+// Consumes trace sessions on behalf of etw.TraceEventSource. The events
+// LogParser and KernelLogParser decode are decoded here, and cross into
+// Python only for the notifications the handler implements. The events
+// of the classes and types added with AddPythonEvent are handed to the
+// Python callback whole, for the Python descriptors to parse.
+// As the ETW callbacks are static, one instance consumes at a time.
+class NativeEventSource
+    : public base::win::EtwTraceConsumerBase<NativeEventSource>,
+      public KernelLogParser,
+      public LogParser,
+      public KernelModuleEvents,
+      public KernelProcessEvents,
+      public KernelThreadEvents,
+      public LogEvents,
+      public TraceEvents {
+ public:
+  // The notifications a handler may implement, by the name of the method.
+  enum Notification {
+    ON_LOG_MESSAGE,
+    ON_TRACE_EVENT_BEGIN,
+    ON_TRACE_EVENT_END,
+    ON_TRACE_EVENT_INSTANT,
+    ON_MODULE_IS_LOADED,
+    ON_MODULE_UNLOAD,
+    ON_MODULE_LOAD,
+    ON_PROCESS_IS_RUNNING,
+    ON_PROCESS_STARTED,
+    ON_PROCESS_ENDED,
+    ON_THREAD_IS_RUNNING,
+    ON_THREAD_STARTED,
+    ON_THREAD_ENDED,
+    NUM_NOTIFICATIONS,
+  };
+  static const char* const kNotificationNames[NUM_NOTIFICATIONS];
+
+  NativeEventSource();
+  ~NativeEventSource();
+
+  // Issues the notifications @p handler has methods for to those methods,
+  // in place of the previous handler's. @p handler may be None.
+  // @returns false with a Python exception set on failure.
+  // @note the GIL must be held.
+  bool SetHandler(PyObject* handler);
+
+  // Hands the events of @p event_class and @p type to the Python callback.
+  void AddPythonEvent(const GUID& event_class, UCHAR type);
+
+  // Sets the callable the events added with AddPythonEvent go to, as
+  // callback(event_address, is_64_bit_log). Consumption stops once the
+  // callback returns false. @p callback may be None.
+  // @note the GIL must be held.
+  void SetPythonCallback(PyObject* callback);
+
+  // Consumes the open sessions, with the GIL released while the events
+  // don't need Python.
+  // @returns false with a Python exception set on failure, or if a
+  //     notification or the callback raised, in which case it's the first
+  //     exception raised.
+  // @note the GIL must be held.
+  bool ConsumeSessions();
+
+  // The ETW callbacks.
+  static void ProcessEvent(EVENT_TRACE* event);
+  static bool ProcessBuffer(EVENT_TRACE_LOGFILE* buffer);
+
+ private:
+  // KernelModuleEvents implementation.
+  virtual void OnModuleIsLoaded(DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info);
+  virtual void OnModuleUnload(DWORD process_id,
+                              const base::Time& time,
+                              const ModuleInformation& module_info);
+  virtual void OnModuleLoad(DWORD process_id,
+                            const base::Time& time,
+                            const ModuleInformation& module_info);
+
+  // KernelProcessEvents implementation.
+  virtual void OnProcessIsRunning(const base::Time& time,
+                                  const ProcessInfo& process_info);
+  virtual void OnProcessStarted(const base::Time& time,
+                                const ProcessInfo& process_info);
+  virtual void OnProcessEnded(const base::Time& time,
+                              const ProcessInfo& process_info,
+                              ULONG exit_status);
+
+  // KernelThreadEvents implementation.
+  virtual void OnThreadIsRunning(const base::Time& time,
+                                 const ThreadInfo& thread_info);
+  virtual void OnThreadStarted(const base::Time& time,
+                               const ThreadInfo& thread_info);
+  virtual void OnThreadEnded(const base::Time& time,
+                             const ThreadInfo& thread_info);
+
+  // LogEvents implementation.
+  virtual void OnLogMessage(const LogMessage& log_message);
+
+  // TraceEvents implementation.
+  virtual void OnTraceEventBegin(const TraceMessage& trace_message);
+  virtual void OnTraceEventEnd(const TraceMessage& trace_message);
+  virtual void OnTraceEventInstant(const TraceMessage& trace_message);
+
+  // Returns true iff the handler has a method for any of the notifications
+  // from @p first to @p last, inclusive.
+  bool HasMethods(Notification first, Notification last) const;
+
+  // Shared by the notifications of a kind.
+  void NotifyModule(Notification notification,
+                    DWORD process_id,
+                    const base::Time& time,
+                    const ModuleInformation& module_info);
+  void NotifyProcess(Notification notification,
+                     const base::Time& time,
+                     const ProcessInfo& process_info);
+  void NotifyThread(Notification notification,
+                    const base::Time& time,
+                    const ThreadInfo& thread_info);
+  void NotifyTrace(Notification notification,
+                   const TraceMessage& trace_message);
+
+  // Calls the method for @p notification with @p args, a new reference
+  // which is released, and stops consumption if it raises. @p args may be
+  // NULL with a Python exception set, for failing to build them.
+  // @note the GIL must be held.
+  void Notify(Notification notification, PyObject* args);
+
+  // Holds on to the Python exception set, unless one is held already, and
+  // stops consumption.
+  // @note the GIL must be held.
+  void StopOnError();
+
+  // Routes @p event to Python if its class and type were added, and to
+  // the parsers.
+  void DispatchEvent(EVENT_TRACE* event);
+
+  // The events that go to the Python callback, sorted for lookup.
+  struct PythonEventKey {
+    bool operator<(const PythonEventKey& o) const;
+
+    GUID event_class;
+    UCHAR type;
+  };
+  typedef std::vector<PythonEventKey> PythonEventKeys;
+  PythonEventKeys python_events_;
+  PyObject* python_callback_;  // Owned reference, may be NULL.
+
+  // The handler's methods, owned references, or NULL for those it lacks.
+  PyObject* methods_[NUM_NOTIFICATIONS];
+
+  // Routes the events to the parser for their class.
+  EventRouter router_;
+
+  // Set as a notification or the callback asks to stop, checked on each
+  // event and buffer.
+  bool stopping_;
+  // The first exception raised from Python during consumption, if any.
+  PyObject* error_type_;
+  PyObject* error_value_;
+  PyObject* error_traceback_;
+
+  // The instance consuming.
+  static NativeEventSource* current_;
+
+  DISALLOW_COPY_AND_ASSIGN(NativeEventSource);
+};
+
+#endif  // SAWBUCK_PY_ETW_NATIVE_NATIVE_EVENT_SOURCE_H_
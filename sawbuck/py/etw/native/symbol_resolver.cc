@@ -0,0 +1,89 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Symbol resolver implementation.
+#include "sawbuck/py/etw/native/symbol_resolver.h"
+
+#include "base/logging.h"
+
+SymbolResolver::SymbolResolver() : thread_("Symbol resolution") {
+  set_module_event_sink(&service_);
+}
+
+SymbolResolver::~SymbolResolver() {
+  thread_.Stop();
+}
+
+bool SymbolResolver::Initialize() {
+  if (!thread_.Start())
+    return false;
+
+  service_.set_background_thread(thread_.message_loop());
+  return true;
+}
+
+HRESULT SymbolResolver::ReadModules(const base::FilePath& path) {
+  EtlFileReader reader;
+  HRESULT hr = reader.Open(path);
+  if (FAILED(hr))
+    return hr;
+
+  if (infer_bitness_from_log())
+    set_is_64_bit_log(reader.is_64_bit_log());
+  return reader.Consume(this);
+}
+
+void SymbolResolver::ModuleLoaded(sym_util::ProcessId process_id,
+                                  const base::Time& time,
+                                  const sym_util::ModuleInformation& module) {
+  service_.OnModuleLoad(process_id, time, module);
+}
+
+void SymbolResolver::ModuleUnloaded(
+    sym_util::ProcessId process_id,
+    const base::Time& time,
+    const sym_util::ModuleInformation& module) {
+  service_.OnModuleUnload(process_id, time, module);
+}
+
+void SymbolResolver::OpenPersistentCache(const base::FilePath& path) {
+  // This opens the cache on the resolution thread, ahead of any lookup.
+  service_.OpenPersistentCache(path);
+}
+
+void SymbolResolver::SetSymbolPath(const wchar_t* symbol_path) {
+  service_.SetSymbolPath(symbol_path);
+}
+
+void SymbolResolver::Resolve(const sym_util::ProcessId* process_ids,
+                             const double* times,
+                             const sym_util::Address* addresses,
+                             size_t num_addresses,
+                             std::vector<sym_util::SymbolRecord>* symbols) {
+  DCHECK(thread_.IsRunning());
+
+  std::vector<base::Time> time_values(num_addresses);
+  for (size_t i = 0; i < num_addresses; ++i)
+    time_values[i] = base::Time::FromDoubleT(times[i]);
+
+  service_.ResolveAddressesNow(process_ids,
+                               num_addresses ? &time_values[0] : NULL,
+                               addresses,
+                               num_addresses,
+                               symbols);
+}
+
+void SymbolResolver::OnEvent(EVENT_TRACE* event) {
+  ProcessOneEvent(event);
+}
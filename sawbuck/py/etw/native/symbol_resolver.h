@@ -0,0 +1,84 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Symbol resolver declaration, resolving addresses in bulk for the etw
+// module.
+#ifndef SAWBUCK_PY_ETW_NATIVE_SYMBOL_RESOLVER_H_
+#define SAWBUCK_PY_ETW_NATIVE_SYMBOL_RESOLVER_H_
+
+#include <vector>
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/threading/thread.h"
+#include "sawbuck/log_lib/etl_file_reader.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/log_lib/symbol_lookup_service.h"
+
+// Resolves the addresses observed in the processes of kernel logs to
+// symbols, for the etw module. The resolution is the viewer's symbol lookup
+// service's, with its persistent cache of symbols by module and RVA, so that
+// scripts and the viewer warm the same cache.
+class SymbolResolver
+    : public EtlEventSink,
+      public KernelLogParser {
+ public:
+  SymbolResolver();
+  ~SymbolResolver();
+
+  // Starts the thread the symbols are resolved on.
+  // @returns false on failure.
+  bool Initialize();
+
+  // Reads the module events of the log file at @p path, which tell the
+  // modules of the processes over time.
+  // @returns S_OK on success, an error code if the file can't be read.
+  HRESULT ReadModules(const base::FilePath& path);
+
+  // Notes the load of @p module into @p process_id at @p time, for modules
+  // that aren't in a log. A null @p time is the beginning of time.
+  void ModuleLoaded(sym_util::ProcessId process_id,
+                    const base::Time& time,
+                    const sym_util::ModuleInformation& module);
+  // Notes the unload of @p module from @p process_id at @p time.
+  void ModuleUnloaded(sym_util::ProcessId process_id,
+                      const base::Time& time,
+                      const sym_util::ModuleInformation& module);
+
+  // Opens the persistent symbol cache at @p path.
+  void OpenPersistentCache(const base::FilePath& path);
+  // Sets the symbol path to @p symbol_path.
+  void SetSymbolPath(const wchar_t* symbol_path);
+
+  // Resolves each of the @p num_addresses @p addresses, observed in
+  // @p process_ids at @p times, to @p symbols. The times are in seconds
+  // since 1.1.1970, as the etw module's time stamps.
+  // @note the symbol strings live as long as this resolver.
+  void Resolve(const sym_util::ProcessId* process_ids,
+               const double* times,
+               const sym_util::Address* addresses,
+               size_t num_addresses,
+               std::vector<sym_util::SymbolRecord>* symbols);
+
+ private:
+  // EtlEventSink implementation.
+  virtual void OnEvent(EVENT_TRACE* event);
+
+  // The service must outlive the thread it resolves on.
+  SymbolLookupService service_;
+  base::Thread thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(SymbolResolver);
+};
+
+#endif  // SAWBUCK_PY_ETW_NATIVE_SYMBOL_RESOLVER_H_
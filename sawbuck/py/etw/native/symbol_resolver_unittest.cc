@@ -0,0 +1,86 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Symbol resolver unittests.
+#include "sawbuck/py/etw/native/symbol_resolver.h"
+
+#include "base/files/file_path.h"
+#include "base/path_service.h"
+#include "base/win/pe_image.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+void Foo() {
+  NOTREACHED() << "This function is only here for an address to resolve";
+}
+
+class SymbolResolverTest: public testing::Test {
+ public:
+  virtual void SetUp() {
+    ASSERT_TRUE(resolver_.Initialize());
+  }
+
+  // Notes the load of the test executable into this process.
+  void LoadExecutable() {
+    HMODULE module = ::GetModuleHandle(NULL);
+    base::win::PEImage image(module);
+    ASSERT_TRUE(image.VerifyMagic());
+
+    sym_util::ModuleInformation module_info;
+    module_info.base_address = reinterpret_cast<sym_util::ModuleBase>(module);
+    module_info.module_size =
+        image.GetNTHeaders()->OptionalHeader.SizeOfImage;
+    module_info.image_checksum =
+        image.GetNTHeaders()->OptionalHeader.CheckSum;
+    module_info.time_date_stamp =
+        image.GetNTHeaders()->FileHeader.TimeDateStamp;
+
+    base::FilePath exe_path;
+    ASSERT_TRUE(PathService::Get(base::FILE_EXE, &exe_path));
+    module_info.image_file_name = exe_path.value();
+
+    resolver_.ModuleLoaded(::GetCurrentProcessId(), base::Time(),
+                           module_info);
+  }
+
+ protected:
+  SymbolResolver resolver_;
+};
+
+TEST_F(SymbolResolverTest, ReadModulesFailsForMissingFile) {
+  EXPECT_HRESULT_FAILED(
+      resolver_.ReadModules(base::FilePath(L"does_not_exist.etl")));
+}
+
+TEST_F(SymbolResolverTest, Resolve) {
+  LoadExecutable();
+
+  const sym_util::ProcessId process_ids[] = {
+      ::GetCurrentProcessId(), ::GetCurrentProcessId() + 1 };
+  const double times[] = { 1.0, 1.0 };
+  sym_util::Address foo = reinterpret_cast<sym_util::Address>(&Foo);
+  const sym_util::Address addresses[] = { foo, foo };
+
+  std::vector<sym_util::SymbolRecord> symbols;
+  resolver_.Resolve(process_ids, times, addresses, arraysize(addresses),
+                    &symbols);
+
+  ASSERT_EQ(arraysize(addresses), symbols.size());
+  EXPECT_PRED_FORMAT2(testing::IsSubstring, L"Foo", *symbols[0].name);
+  // The executable isn't loaded in the other process.
+  EXPECT_STREQ(L"", symbols[1].name->c_str());
+}
+
+}  // namespace
@@ -21,6 +21,12 @@ use_setuptools()
 
 from setuptools import setup
 
+# The native consumer is built separately, and packaged in when given.
+data_files = []
+for arg in sys.argv[1:]:
+  if arg.startswith('--native-module='):
+    sys.argv.remove(arg)
+    data_files.append(('etw', [arg[len('--native-module='):]]))
 
 setup(name = 'ETW',
       version = '0.6.5.0',
@@ -29,6 +35,9 @@ setup(name = 'ETW',
       author_email = 'siggi@chromium.org',
       url = 'http://code.google.com/p/sawbuck',
       packages = ['etw', 'etw.descriptors'],
+      data_files = data_files,
+      # The native module can't load from within a zip file.
+      zip_safe = not data_files,
       tests_require = ["nose>=0.9.2"],
       test_suite = 'nose.collector',
       license = 'Apache 2.0')
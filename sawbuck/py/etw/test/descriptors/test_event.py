@@ -115,6 +115,51 @@ class EventClassTest(unittest.TestCase):
     self.assertRaises(binary_buffer.BufferOverflowError, TestEventClass,
                       mock_session, mock_event_trace)
 
+  def testLazyDecoding(self):
+    """Test decoding fields out of order from a copy of the event data."""
+    class TestEventClass(event.EventClass):
+      _fields_ = [('TestInt32', field.Int32),
+                  ('TestString', field.String),
+                  ('TestInt64', field.Int64)]
+
+    header_dict = {'ProcessId': 5678, 'ThreadId': 8765, 'TimeStamp': 123456789}
+
+    data = ctypes.c_buffer(18)
+    ptr = ctypes.cast(data, ctypes.c_void_p)
+    int32 = ctypes.cast(ptr.value, ctypes.POINTER(ctypes.c_int))
+    int32.contents.value = 1234
+    ctypes.memmove(ptr.value + 4, 'Hello', 6)
+    int64 = ctypes.cast(ptr.value + 10, ctypes.POINTER(ctypes.c_longlong))
+    int64.contents.value = 4321
+
+    mock_event_trace = MockEventTrace(header_dict, ptr.value,
+                                      ctypes.sizeof(data))
+    mock_session = MockSession()
+    obj = TestEventClass(mock_session, mock_event_trace)
+
+    # The event data may be reused as soon as the event callback returns.
+    ctypes.memset(data, 0, ctypes.sizeof(data))
+    self.assertEqual(obj.TestInt64, 4321)
+    self.assertEqual(obj.TestString, 'Hello')
+    self.assertEqual(obj.TestInt32, 1234)
+    self.assertRaises(AttributeError, getattr, obj, 'TestBogus')
+
+  def testFieldLayout(self):
+    """Test the offsets of the fixed layout prefix of the fields."""
+    class TestEventClass(event.EventClass):
+      _fields_ = [('TestInt8', field.Int8),
+                  ('TestPointer', field.Pointer),
+                  ('TestInt32', field.Int32),
+                  ('TestWString', field.WString),
+                  ('TestInt16', field.Int16)]
+
+    layout = TestEventClass.GetLayout(False)
+    self.assertEqual([0, 1, 5], layout.offsets)
+    self.assertEqual(9, layout.prefix_size)
+    layout = TestEventClass.GetLayout(True)
+    self.assertEqual([0, 1, 9], layout.offsets)
+    self.assertEqual(13, layout.prefix_size)
+
 
 class EventCategoryTest(unittest.TestCase):
   def testCreation(self):
@@ -0,0 +1,70 @@
+#!python
+# Copyright 2012 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+from etw import columns
+from etw import TraceEventSource, EventConsumer, EventHandler
+from etw.descriptors import image
+import os
+import unittest
+
+
+_SRC_DIR = os.path.abspath(os.path.join(__file__, '../../../../..'))
+
+class ReadColumnsTest(unittest.TestCase):
+  _TEST_LOG = os.path.normpath(
+      os.path.join(_SRC_DIR,
+                   'sawbuck/log_lib/test_data/image_data_32_v2.etl'))
+
+  def testUnknownEventClass(self):
+    """Test that unknown event classes are refused."""
+    self.assertRaises(ValueError, columns.ReadColumns, self._TEST_LOG,
+                      ['Bogus'])
+
+  def testImageColumns(self):
+    """Test that the image columns match the events consumed."""
+    if columns._etw_native is None:
+      return
+
+    class TestConsumer(EventConsumer):
+      def __init__(self, bases):
+        self._bases = bases
+
+      @EventHandler(image.Event.Load, image.Event.DCStart,
+                    image.Event.UnLoad)
+      def OnImageEvent(self, event_data):
+        self._bases.append(event_data.ImageBase)
+
+    bases = []
+    log_consumer = TraceEventSource([TestConsumer(bases)])
+    log_consumer.OpenFileSession(self._TEST_LOG)
+    log_consumer.Consume()
+
+    image_columns = columns.ReadColumns(self._TEST_LOG, ['Image'])
+    images = image_columns['Image']
+    self.assertEqual(bases, list(images['base_address']))
+    names = image_columns['Strings'][images['name_index']]
+    self.assertTrue(all(name for name in names))
+
+  def testFieldSelection(self):
+    """Test that only the fields asked for are kept."""
+    if columns._etw_native is None:
+      return
+
+    image_columns = columns.ReadColumns(self._TEST_LOG, ['Image'],
+                                        ['time', 'base_address', 'bogus'])
+    self.assertEqual(('time', 'base_address'),
+                     image_columns['Image'].dtype.names)
+
+if __name__ == '__main__':
+  unittest.main()
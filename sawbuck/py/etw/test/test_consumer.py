@@ -13,6 +13,7 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 from etw import TraceEventSource, EventConsumer, EventHandler
+from etw import consumer as etw_consumer
 from etw.descriptors import image
 import exceptions
 import os
@@ -55,6 +56,24 @@ class TraceConsumerTest(unittest.TestCase):
     self._Consume(self._TEST_LOG, [consumer])
     self.assertNotEqual(consumer._image_load_events, 0)
 
+  def testAddHandler(self):
+    """Test that handlers added after creation get their events."""
+    class TestConsumer(EventConsumer):
+      def __init__(self):
+        super(TestConsumer, self).__init__()
+        self._image_load_events = 0
+
+      @EventHandler(image.Event.Load)
+      def OnImageLoad(self, event_data):
+        self._image_load_events += 1
+
+    consumer = TestConsumer()
+    log_consumer = TraceEventSource()
+    log_consumer.AddHandler(consumer)
+    log_consumer.OpenFileSession(self._TEST_LOG)
+    log_consumer.Consume()
+    self.assertNotEqual(consumer._image_load_events, 0)
+
   def testMultipleConsumers(self):
     """Test two consumers instances."""
     class TestConsumer(EventConsumer):
@@ -154,5 +173,60 @@ class TraceConsumerTest(unittest.TestCase):
 
     self.assertEqual(cooked_times, raw_times)
 
+  def testNativeConsuming(self):
+    """Test that consuming natively produces the same results."""
+    if etw_consumer._etw_native is None:
+      return
+
+    class TestConsumer(EventConsumer):
+      def __init__(self, bases):
+        self._bases = bases
+
+      @EventHandler(image.Event.Load, image.Event.DCStart)
+      def OnImageStartLoad(self, event_data):
+        self._bases.append(event_data.ImageBase)
+
+    python_bases = []
+    log_consumer = TraceEventSource([TestConsumer(python_bases)],
+                                    native=False)
+    log_consumer.OpenFileSession(self._TEST_LOG)
+    log_consumer.Consume()
+
+    native_bases = []
+    log_consumer = TraceEventSource([TestConsumer(native_bases)],
+                                    native=True)
+    log_consumer.OpenFileSession(self._TEST_LOG)
+    log_consumer.Consume()
+
+    self.assertNotEqual(python_bases, [])
+    self.assertEqual(python_bases, native_bases)
+
+  def testNativeHandler(self):
+    """Test the events decoded natively."""
+    if etw_consumer._etw_native is None:
+      return
+
+    class NativeHandler(object):
+      def __init__(self):
+        self.bases = []
+
+      def OnModuleIsLoaded(self, time, process_id, base_address, *args):
+        self.bases.append(base_address)
+
+      def OnModuleLoad(self, time, process_id, base_address, *args):
+        self.bases.append(base_address)
+
+    handler = NativeHandler()
+    log_consumer = TraceEventSource(native=True)
+    log_consumer.SetNativeHandler(handler)
+    log_consumer.OpenFileSession(self._TEST_LOG)
+    log_consumer.Consume()
+    self.assertTrue(len(handler.bases) > 10)
+
+  def testNativeHandlerNeedsNative(self):
+    """Test that native handlers are refused without native consumption."""
+    log_consumer = TraceEventSource(native=False)
+    self.assertRaises(RuntimeError, log_consumer.SetNativeHandler, None)
+
 if __name__ == '__main__':
   unittest.main()
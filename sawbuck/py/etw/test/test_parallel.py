@@ -0,0 +1,65 @@
+#!python
+# Copyright 2012 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+from etw import EventConsumer, EventHandler
+from etw import parallel
+from etw.descriptors import image
+import os
+import unittest
+
+
+_SRC_DIR = os.path.abspath(os.path.join(__file__, '../../../../..'))
+
+
+class ImageLoadCounter(EventConsumer):
+  def __init__(self, start=0):
+    self.count = start
+
+  @EventHandler(image.Event.Load)
+  def OnImageLoad(self, event_data):
+    self.count += 1
+
+
+def MergeCounters(counter, other):
+  counter.count += other.count
+  return counter
+
+
+class AnalyzeFilesTest(unittest.TestCase):
+  _TEST_LOG = os.path.normpath(
+      os.path.join(_SRC_DIR,
+                   'sawbuck/log_lib/test_data/image_data_32_v2.etl'))
+
+  def testNoFiles(self):
+    """Test that there must be files to analyze."""
+    self.assertRaises(ValueError, parallel.AnalyzeFiles, [],
+                      ImageLoadCounter, MergeCounters)
+
+  def testSingleJob(self):
+    """Test consuming files in this process."""
+    counter = parallel.AnalyzeFiles([self._TEST_LOG], ImageLoadCounter,
+                                    MergeCounters, jobs=1)
+    self.assertNotEqual(0, counter.count)
+
+  def testJobs(self):
+    """Test that the workers' consumers are merged."""
+    counter = parallel.AnalyzeFiles([self._TEST_LOG], ImageLoadCounter,
+                                    MergeCounters, jobs=1)
+    counters = parallel.AnalyzeFiles([self._TEST_LOG] * 3, ImageLoadCounter,
+                                     MergeCounters, args=(1,), jobs=2)
+    self.assertEqual(3 * (counter.count + 1), counters.count)
+
+
+if __name__ == '__main__':
+  unittest.main()
@@ -12,7 +12,7 @@
 # WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 # See the License for the specific language governing permissions and
 # limitations under the License.
-from etw import MofEvent, TraceEventSource
+from etw import EventBatch, EventTemplate, MofEvent, TraceEventSource
 from etw import TraceController, TraceProperties, TraceProvider
 import ctypes
 import etw.evntrace as evn
@@ -86,6 +86,38 @@ class TraceProviderTest(unittest.TestCase):
     consumer.OpenFileSession(self._tempfile)
     consumer.Consume()
 
+  def testLogBatch(self):
+    """Log a batch of events to an enabled provider"""
+    provider = TraceProvider(self._TEST_PROVIDER)
+    template = EventTemplate(self._LOG_EVENT_ID, self._LOG_MESSAGE,
+                             evn.TRACE_LEVEL_INFORMATION)
+    # A batch just short of room for three events.
+    batch = EventBatch(3 * 64 - 8)
+    self.assertTrue(batch.Add(template, 'First event\0'))
+    self.assertTrue(batch.Add(template, 'Second event\0'))
+    self.assertFalse(batch.Add(template, 'Third event\0'))
+    self.assertEqual(2, len(batch))
+    self.assertRaises(ValueError, batch.Add, template, 'x' * 0x10000)
+
+    self.assertEqual((2, 0), provider.LogBatch(batch))
+    self.assertEqual(0, len(batch))
+
+    self._controller.Stop()
+
+    class TestConsumer(TraceEventSource):
+      def __init__(self):
+        TraceEventSource.__init__(self)
+        self.messages = []
+
+      def ProcessEvent(self, session, event):
+        if event.contents.Header.Guid == TraceProviderTest._LOG_EVENT_ID:
+          self.messages.append(ctypes.string_at(event.contents.MofData))
+
+    consumer = TestConsumer()
+    consumer.OpenFileSession(self._tempfile)
+    consumer.Consume()
+    self.assertEqual(['First event', 'Second event'], consumer.messages)
+
 
 if __name__ == '__main__':
   unittest.main()
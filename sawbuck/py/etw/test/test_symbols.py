@@ -0,0 +1,55 @@
+#!python
+# Copyright 2012 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+from etw import symbols
+import os
+import unittest
+
+
+_SRC_DIR = os.path.abspath(os.path.join(__file__, '../../../../..'))
+
+class SymbolResolverTest(unittest.TestCase):
+  _TEST_LOG = os.path.normpath(
+      os.path.join(_SRC_DIR,
+                   'sawbuck/log_lib/test_data/image_data_32_v2.etl'))
+
+  def testNeedsNative(self):
+    """Test that the resolver refuses to work without the extension."""
+    if symbols._etw_native is not None:
+      return
+
+    self.assertRaises(RuntimeError, symbols.SymbolResolver)
+
+  def testNoModules(self):
+    """Test that addresses in no module don't resolve."""
+    if symbols._etw_native is None:
+      return
+
+    resolver = symbols.SymbolResolver()
+    self.assertEqual([None, None],
+                     resolver.Resolve(1234, 1.0, [0x10000, 0x20000]))
+
+  def testReadModules(self):
+    """Test reading the modules of a log."""
+    if symbols._etw_native is None:
+      return
+
+    resolver = symbols.SymbolResolver()
+    resolver.ReadModules(self._TEST_LOG)
+    self.assertRaises(WindowsError, resolver.ReadModules,
+                      self._TEST_LOG + '.bogus')
+
+
+if __name__ == '__main__':
+  unittest.main()
@@ -22,12 +22,20 @@
       'type': 'none',
       'dependencies': [
         'common/common.gyp:*',
-        'installer/installer.gyp:*',
         'log_lib/log_lib.gyp:*',
-        'py/py.gyp:*',
         'sym_util/sym_util.gyp:*',
         'viewer/viewer.gyp:*',
       ],
+      'conditions': [
+        # The installer packages, and the Python bindings load into, the
+        # 32-bit build only.
+        ['target_arch=="ia32"', {
+          'dependencies': [
+            'installer/installer.gyp:*',
+            'py/py.gyp:*',
+          ],
+        }],
+      ],
     },
     {
       # Add new unittests to this target as inputs.
@@ -0,0 +1,472 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Breakpad symbol table implementation.
+#include "sawbuck/sym_util/breakpad_symbol_table.h"
+
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+
+namespace sym_util {
+
+namespace {
+
+const uint32 kMagic = 0x54535042;  // 'BPST'.
+const uint32 kVersion = 1;
+
+// Room for a time date stamp and a size, in hex, and a NUL.
+const size_t kCodeIdSize = 20;
+
+// A function, or a public symbol, as parsed.
+struct ParsedFunction {
+  uint32 rva;
+  // Zero for a public symbol, until it's sized to the next function.
+  uint32 size;
+  bool is_public;
+  uint32 name;
+  // The line records of the function, as indexes into the parsed lines.
+  size_t first_line;
+  size_t num_lines;
+};
+
+struct ParsedLine {
+  uint32 rva;
+  uint32 size;
+  uint32 line;
+  uint32 file;
+};
+
+bool FunctionLess(const ParsedFunction& a, const ParsedFunction& b) {
+  if (a.rva != b.rva)
+    return a.rva < b.rva;
+  // Functions go ahead of public symbols at the same address.
+  return !a.is_public && b.is_public;
+}
+
+bool LineLess(const ParsedLine& a, const ParsedLine& b) {
+  return a.rva < b.rva;
+}
+
+// Accumulates the strings of a table, each of them once.
+class StringPool {
+ public:
+  // @returns the offset of @p str in the pool.
+  uint32 Add(const std::string& str) {
+    std::map<std::string, uint32>::const_iterator it(offsets_.find(str));
+    if (it != offsets_.end())
+      return it->second;
+
+    uint32 offset = static_cast<uint32>(data_.size());
+    data_.append(str);
+    data_.append(1, '\0');
+    offsets_.insert(std::make_pair(str, offset));
+    return offset;
+  }
+
+  const std::string& data() const { return data_; }
+
+ private:
+  std::string data_;
+  std::map<std::string, uint32> offsets_;
+};
+
+// Reads the space separated token at @p *pos, up to @p end, and moves
+// @p *pos past it and the space that follows.
+// @returns false if there's no token.
+bool ReadToken(const char** pos, const char* end, std::string* token) {
+  const char* begin = *pos;
+  const char* stop = begin;
+  while (stop != end && *stop != ' ')
+    ++stop;
+  if (stop == begin)
+    return false;
+
+  token->assign(begin, stop);
+  *pos = stop != end ? stop + 1 : stop;
+  return true;
+}
+
+// Reads a token at @p *pos as a number, in hex if @p hex.
+bool ReadNumber(const char** pos, const char* end, bool hex, uint32* value) {
+  std::string token;
+  if (!ReadToken(pos, end, &token))
+    return false;
+
+  int64 number = 0;
+  bool parsed = hex ? base::HexStringToInt64(token, &number) :
+      base::StringToInt64(token, &number);
+  if (!parsed || number < 0 || number > kuint32max)
+    return false;
+
+  *value = static_cast<uint32>(number);
+  return true;
+}
+
+// @returns true iff @p line starts with @p prefix, which is then skipped.
+bool SkipPrefix(const char* prefix, const char** pos, const char* end) {
+  size_t length = strlen(prefix);
+  if (static_cast<size_t>(end - *pos) < length ||
+      memcmp(*pos, prefix, length) != 0) {
+    return false;
+  }
+  *pos += length;
+  return true;
+}
+
+}  // namespace
+
+struct BreakpadSymbolTable::Header {
+  uint32 magic;
+  uint32 version;
+  // The size of the block.
+  uint32 size;
+  char code_id[kCodeIdSize];
+
+  // The arrays and the strings, by their offset in the block.
+  uint32 functions_offset;
+  uint32 num_functions;
+  uint32 lines_offset;
+  uint32 num_lines;
+  uint32 strings_offset;
+  uint32 strings_size;
+};
+
+struct BreakpadSymbolTable::Function {
+  uint32 rva;
+  // Zero for a public symbol that extends to the end of the module.
+  uint32 size;
+  // The offset of the function's name in the strings.
+  uint32 name;
+  // The function's line records in the line array.
+  uint32 first_line;
+  uint32 num_lines;
+};
+
+struct BreakpadSymbolTable::Line {
+  uint32 rva;
+  uint32 size;
+  uint32 line;
+  // The offset of the source file's name in the strings.
+  uint32 file;
+};
+
+BreakpadSymbolTable::BreakpadSymbolTable()
+    : header_(NULL), data_(NULL), size_(0) {
+}
+
+bool BreakpadSymbolTable::Convert(const char* text,
+                                  size_t length,
+                                  std::string* table) {
+  DCHECK(text != NULL);
+  DCHECK(table != NULL);
+
+  std::string code_id;
+  StringPool strings;
+  std::map<uint32, uint32> files;
+  std::vector<ParsedFunction> functions;
+  std::vector<ParsedLine> lines;
+  bool in_function = false;
+  bool seen_module = false;
+
+  const char* text_end = text + length;
+  const char* line_begin = text;
+  while (line_begin != text_end) {
+    const char* end = std::find(line_begin, text_end, '\n');
+    const char* next = end != text_end ? end + 1 : end;
+    if (end != line_begin && end[-1] == '\r')
+      --end;
+    const char* record = line_begin;
+    const char* pos = record;
+    line_begin = next;
+
+    // The file must start out with the module record.
+    if (!seen_module) {
+      if (!SkipPrefix("MODULE ", &pos, end))
+        return false;
+      seen_module = true;
+      continue;
+    }
+
+    if (SkipPrefix("FILE ", &pos, end)) {
+      in_function = false;
+      uint32 number = 0;
+      if (!ReadNumber(&pos, end, false, &number))
+        return false;
+      files[number] = strings.Add(std::string(pos, end));
+    } else if (SkipPrefix("FUNC ", &pos, end) ||
+               SkipPrefix("PUBLIC ", &pos, end)) {
+      bool is_public = *record == 'P';
+      // The functions that have been merged by identical code folding
+      // are flagged, which doesn't matter to us.
+      SkipPrefix("m ", &pos, end);
+
+      ParsedFunction function = {};
+      function.is_public = is_public;
+      uint32 param_size = 0;
+      if (!ReadNumber(&pos, end, true, &function.rva) ||
+          (!is_public && !ReadNumber(&pos, end, true, &function.size)) ||
+          !ReadNumber(&pos, end, true, &param_size)) {
+        return false;
+      }
+      function.name = strings.Add(std::string(pos, end));
+      function.first_line = lines.size();
+      functions.push_back(function);
+      in_function = !is_public;
+    } else if (SkipPrefix("INFO CODE_ID ", &pos, end)) {
+      in_function = false;
+      if (!ReadToken(&pos, end, &code_id) || code_id.size() >= kCodeIdSize)
+        return false;
+      StringToUpperASCII(&code_id);
+    } else if (pos != end && isxdigit(static_cast<unsigned char>(*pos))) {
+      // A line record, which belongs to the function before it.
+      if (!in_function)
+        continue;
+      ParsedLine line = {};
+      uint32 file_number = 0;
+      if (!ReadNumber(&pos, end, true, &line.rva) ||
+          !ReadNumber(&pos, end, true, &line.size) ||
+          !ReadNumber(&pos, end, false, &line.line) ||
+          !ReadNumber(&pos, end, false, &file_number)) {
+        return false;
+      }
+      std::map<uint32, uint32>::const_iterator file(files.find(file_number));
+      line.file = file != files.end() ? file->second : strings.Add("");
+      lines.push_back(line);
+      ++functions.back().num_lines;
+    } else {
+      // Stack unwinding and inlining records are of no use to us.
+      in_function = false;
+    }
+  }
+
+  if (!seen_module)
+    return false;
+
+  // Sort each function's lines, then the functions, dropping the public
+  // symbols and the folded functions that share an address with another.
+  for (size_t i = 0; i < functions.size(); ++i) {
+    std::vector<ParsedLine>::iterator first(
+        lines.begin() + functions[i].first_line);
+    std::sort(first, first + functions[i].num_lines, LineLess);
+  }
+  std::stable_sort(functions.begin(), functions.end(), FunctionLess);
+  std::vector<ParsedFunction> sorted;
+  for (size_t i = 0; i < functions.size(); ++i) {
+    const ParsedFunction& function = functions[i];
+    if (!sorted.empty()) {
+      const ParsedFunction& last = sorted.back();
+      if (last.rva == function.rva)
+        continue;
+      // A public symbol within a function is the function.
+      if (function.is_public && !last.is_public &&
+          function.rva - last.rva < last.size) {
+        continue;
+      }
+    }
+    sorted.push_back(function);
+  }
+  // Public symbols extend to the next function.
+  for (size_t i = 0; i + 1 < sorted.size(); ++i) {
+    if (sorted[i].is_public)
+      sorted[i].size = sorted[i + 1].rva - sorted[i].rva;
+  }
+
+  Header header = {};
+  header.magic = kMagic;
+  header.version = kVersion;
+  strncpy(header.code_id, code_id.c_str(), kCodeIdSize - 1);
+  header.functions_offset = sizeof(header);
+  header.num_functions = static_cast<uint32>(sorted.size());
+  header.lines_offset =
+      header.functions_offset + header.num_functions * sizeof(Function);
+
+  std::vector<Line> table_lines;
+  std::vector<Function> table_functions(sorted.size());
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    const ParsedFunction& parsed = sorted[i];
+    Function& function = table_functions[i];
+    function.rva = parsed.rva;
+    function.size = parsed.size;
+    function.name = parsed.name;
+    function.first_line = static_cast<uint32>(table_lines.size());
+    function.num_lines = static_cast<uint32>(parsed.num_lines);
+    for (size_t j = 0; j < parsed.num_lines; ++j) {
+      const ParsedLine& parsed_line = lines[parsed.first_line + j];
+      Line line = { parsed_line.rva, parsed_line.size, parsed_line.line,
+                    parsed_line.file };
+      table_lines.push_back(line);
+    }
+  }
+
+  header.num_lines = static_cast<uint32>(table_lines.size());
+  header.strings_offset =
+      header.lines_offset + header.num_lines * sizeof(Line);
+  header.strings_size = static_cast<uint32>(strings.data().size());
+  header.size = header.strings_offset + header.strings_size;
+
+  table->clear();
+  table->reserve(header.size);
+  table->append(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!table_functions.empty()) {
+    table->append(reinterpret_cast<const char*>(&table_functions[0]),
+                  table_functions.size() * sizeof(Function));
+  }
+  if (!table_lines.empty()) {
+    table->append(reinterpret_cast<const char*>(&table_lines[0]),
+                  table_lines.size() * sizeof(Line));
+  }
+  table->append(strings.data());
+  DCHECK_EQ(header.size, table->size());
+
+  return true;
+}
+
+std::string BreakpadSymbolTable::GetCodeId(const ModuleInformation& module) {
+  // This is how Breakpad's dump_syms formats it.
+  std::string code_id(base::StringPrintf("%08X%x", module.time_date_stamp,
+                                         module.module_size));
+  StringToUpperASCII(&code_id);
+  return code_id;
+}
+
+bool BreakpadSymbolTable::Attach(const void* data, size_t size) {
+  DCHECK(data != NULL);
+  Detach();
+
+  if (size < sizeof(Header))
+    return false;
+
+  const Header* header = reinterpret_cast<const Header*>(data);
+  if (header->magic != kMagic || header->version != kVersion ||
+      header->size != size ||
+      header->code_id[kCodeIdSize - 1] != '\0') {
+    return false;
+  }
+
+  // The arrays and the strings must fit the block, and the last string
+  // must be terminated for every offset to point to a terminated one.
+  uint64 functions_end = static_cast<uint64>(header->functions_offset) +
+      static_cast<uint64>(header->num_functions) * sizeof(Function);
+  uint64 lines_end = static_cast<uint64>(header->lines_offset) +
+      static_cast<uint64>(header->num_lines) * sizeof(Line);
+  uint64 strings_end = static_cast<uint64>(header->strings_offset) +
+      header->strings_size;
+  if (header->functions_offset < sizeof(Header) ||
+      header->functions_offset % sizeof(uint32) != 0 ||
+      header->lines_offset % sizeof(uint32) != 0 ||
+      functions_end > size || lines_end > size || strings_end > size) {
+    return false;
+  }
+  const uint8* bytes = reinterpret_cast<const uint8*>(data);
+  if (header->strings_size != 0 && bytes[strings_end - 1] != '\0')
+    return false;
+
+  header_ = header;
+  data_ = bytes;
+  size_ = size;
+  return true;
+}
+
+void BreakpadSymbolTable::Detach() {
+  header_ = NULL;
+  data_ = NULL;
+  size_ = 0;
+}
+
+std::string BreakpadSymbolTable::code_id() const {
+  DCHECK(is_attached());
+  return header_->code_id;
+}
+
+bool BreakpadSymbolTable::Lookup(uint32 rva, Symbol* symbol) const {
+  DCHECK(symbol != NULL);
+  if (header_ == NULL)
+    return false;
+
+  // Find the last function at or below the RVA.
+  const Function* functions =
+      reinterpret_cast<const Function*>(data_ + header_->functions_offset);
+  const Function* begin = functions;
+  const Function* end = functions + header_->num_functions;
+  while (begin != end) {
+    const Function* mid = begin + (end - begin) / 2;
+    if (mid->rva <= rva)
+      begin = mid + 1;
+    else
+      end = mid;
+  }
+  if (begin == functions)
+    return false;
+
+  const Function* function = begin - 1;
+  if (function->size != 0 && rva - function->rva >= function->size)
+    return false;
+  const char* name = GetString(function->name);
+  if (name == NULL)
+    return false;
+
+  symbol->name = UTF8ToWide(name);
+  symbol->mangled_name.clear();
+  symbol->offset = rva - function->rva;
+  symbol->size = function->size;
+  symbol->file.clear();
+  symbol->line = 0;
+
+  // And the function's last line record at or below the RVA.
+  if (static_cast<uint64>(function->first_line) + function->num_lines >
+      header_->num_lines) {
+    return true;
+  }
+  const Line* lines = reinterpret_cast<const Line*>(
+      data_ + header_->lines_offset) + function->first_line;
+  const Line* lines_begin = lines;
+  const Line* lines_end = lines + function->num_lines;
+  while (lines_begin != lines_end) {
+    const Line* mid = lines_begin + (lines_end - lines_begin) / 2;
+    if (mid->rva <= rva)
+      lines_begin = mid + 1;
+    else
+      lines_end = mid;
+  }
+  if (lines_begin != lines) {
+    const Line* line = lines_begin - 1;
+    const char* file = GetString(line->file);
+    if (rva - line->rva < line->size && file != NULL) {
+      symbol->file = UTF8ToWide(file);
+      symbol->line = line->line;
+    }
+  }
+
+  return true;
+}
+
+size_t BreakpadSymbolTable::num_functions() const {
+  return header_ != NULL ? header_->num_functions : 0;
+}
+
+const char* BreakpadSymbolTable::GetString(uint32 offset) const {
+  if (offset >= header_->strings_size)
+    return NULL;
+  return reinterpret_cast<const char*>(data_ + header_->strings_offset) +
+      offset;
+}
+
+}  // namespace sym_util
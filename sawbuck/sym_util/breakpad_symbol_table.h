@@ -0,0 +1,88 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Breakpad symbol table declaration.
+#ifndef SAWBUCK_SYM_UTIL_BREAKPAD_SYMBOL_TABLE_H_
+#define SAWBUCK_SYM_UTIL_BREAKPAD_SYMBOL_TABLE_H_
+
+#include <string>
+#include "base/basictypes.h"
+#include "sawbuck/sym_util/types.h"
+
+namespace sym_util {
+
+// The functions, line records and source files of a module, converted from
+// a Breakpad symbol file and laid out in a flat block of memory, so that
+// the block can be kept in a file and memory mapped as is. Lookups are
+// binary searches of sorted arrays, which take no memory but the block.
+//
+// The block starts with a header, then the functions sorted by RVA, then
+// the line records, sorted by RVA within each function, and last the
+// strings, NUL terminated UTF-8. Public symbols are functions that extend
+// to the next function. All offsets are checked against the block before
+// use, so a corrupt block makes for misses, not crashes.
+class BreakpadSymbolTable {
+ public:
+  BreakpadSymbolTable();
+
+  // Converts the Breakpad symbol file in @p text to a table, in @p table.
+  // @param length the length of @p text, in bytes.
+  // @returns false if @p text isn't a Breakpad symbol file.
+  static bool Convert(const char* text, size_t length, std::string* table);
+
+  // @returns the code identifier Breakpad gives @p module, by which its
+  //     symbol file is matched to the module, e.g. "4D2A1B3C7A0000" for a
+  //     module of size 0x7A0000 and time date stamp 0x4D2A1B3C.
+  static std::string GetCodeId(const ModuleInformation& module);
+
+  // Starts using the table laid out in @p data.
+  // @param data a table laid out by Convert, which must outlive its use.
+  // @returns false if @p data doesn't hold a table of @p size bytes.
+  bool Attach(const void* data, size_t size);
+  void Detach();
+  bool is_attached() const { return header_ != NULL; }
+
+  // @returns the code identifier of the module the table is for, empty
+  //     if the symbol file didn't record one.
+  // @pre is_attached().
+  std::string code_id() const;
+
+  // Looks up the function at @p rva, and on success fills in all of
+  // @p symbol but for its module name and base, which are up to the
+  // caller. The names are undecorated, as Breakpad has them, so the
+  // mangled name is left empty.
+  // @returns true iff a function covers @p rva.
+  bool Lookup(uint32 rva, Symbol* symbol) const;
+
+  // @returns the number of functions in the table.
+  size_t num_functions() const;
+
+ private:
+  struct Header;
+  struct Function;
+  struct Line;
+
+  // @returns the string at @p offset, or NULL if it's out of bounds.
+  const char* GetString(uint32 offset) const;
+
+  const Header* header_;
+  const uint8* data_;
+  size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(BreakpadSymbolTable);
+};
+
+}  // namespace sym_util
+
+#endif  // SAWBUCK_SYM_UTIL_BREAKPAD_SYMBOL_TABLE_H_
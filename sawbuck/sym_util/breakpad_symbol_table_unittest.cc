@@ -0,0 +1,148 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Breakpad symbol table unittests.
+#include "sawbuck/sym_util/breakpad_symbol_table.h"
+
+#include <string>
+#include "gtest/gtest.h"
+
+namespace sym_util {
+
+namespace {
+
+const char kSymbols[] =
+    "MODULE windows x86 1F2E3D4C5B6A79880102030405060708A chrome.dll.pdb\r\n"
+    "INFO CODE_ID 4d2a1b3c7a0000 chrome.dll\r\n"
+    "FILE 1 c:\\src\\foo.cc\r\n"
+    "FILE 2 c:\\src\\bar.cc\r\n"
+    "FUNC 1000 40 4 Foo(int)\r\n"
+    "1010 10 12 1\r\n"
+    "1000 10 10 1\r\n"
+    "1020 20 14 2\r\n"
+    "FUNC m 2000 10 0 Bar()\r\n"
+    "FUNC m 2000 10 0 Folded()\r\n"
+    "PUBLIC 1020 0 _Foo\r\n"
+    "PUBLIC m 3000 0 _Baz\r\n"
+    "PUBLIC 3800 0 _Last\r\n"
+    "STACK WIN 4 1000 40 0 0 4 0 0 0 1 $T0 $ebp = \r\n";
+
+class BreakpadSymbolTableTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    ASSERT_TRUE(BreakpadSymbolTable::Convert(kSymbols, sizeof(kSymbols) - 1,
+                                             &data_));
+    ASSERT_TRUE(table_.Attach(data_.data(), data_.size()));
+  }
+
+ protected:
+  std::string data_;
+  BreakpadSymbolTable table_;
+};
+
+}  // namespace
+
+TEST_F(BreakpadSymbolTableTest, GetCodeId) {
+  ModuleInformation module = {};
+  module.module_size = 0x7A0000;
+  module.time_date_stamp = 0x4D2A1B3C;
+  EXPECT_EQ("4D2A1B3C7A0000", BreakpadSymbolTable::GetCodeId(module));
+  EXPECT_EQ("4D2A1B3C7A0000", table_.code_id());
+
+  module.time_date_stamp = 0xB3C;
+  EXPECT_EQ("00000B3C7A0000", BreakpadSymbolTable::GetCodeId(module));
+}
+
+TEST_F(BreakpadSymbolTableTest, LookupFunctions) {
+  // The folded function and the public symbol within Foo are dropped.
+  EXPECT_EQ(4, table_.num_functions());
+
+  Symbol symbol;
+  ASSERT_TRUE(table_.Lookup(0x1014, &symbol));
+  EXPECT_EQ(L"Foo(int)", symbol.name);
+  EXPECT_EQ(L"", symbol.mangled_name);
+  EXPECT_EQ(0x14, symbol.offset);
+  EXPECT_EQ(0x40, symbol.size);
+  EXPECT_EQ(L"c:\\src\\foo.cc", symbol.file);
+  EXPECT_EQ(12, symbol.line);
+
+  ASSERT_TRUE(table_.Lookup(0x103F, &symbol));
+  EXPECT_EQ(L"Foo(int)", symbol.name);
+  EXPECT_EQ(L"c:\\src\\bar.cc", symbol.file);
+  EXPECT_EQ(14, symbol.line);
+
+  ASSERT_TRUE(table_.Lookup(0x2000, &symbol));
+  EXPECT_EQ(L"Bar()", symbol.name);
+  EXPECT_EQ(0, symbol.offset);
+  EXPECT_EQ(L"", symbol.file);
+  EXPECT_EQ(0, symbol.line);
+
+  // Before, between and past the functions.
+  EXPECT_FALSE(table_.Lookup(0xFFF, &symbol));
+  EXPECT_FALSE(table_.Lookup(0x1040, &symbol));
+  EXPECT_FALSE(table_.Lookup(0x2010, &symbol));
+}
+
+TEST_F(BreakpadSymbolTableTest, LookupPublics) {
+  // Public symbols extend to the next function, the last one to the end.
+  Symbol symbol;
+  ASSERT_TRUE(table_.Lookup(0x37FF, &symbol));
+  EXPECT_EQ(L"_Baz", symbol.name);
+  EXPECT_EQ(0x7FF, symbol.offset);
+  EXPECT_EQ(0x800, symbol.size);
+
+  ASSERT_TRUE(table_.Lookup(0x10000, &symbol));
+  EXPECT_EQ(L"_Last", symbol.name);
+  EXPECT_EQ(0xC800, symbol.offset);
+  EXPECT_EQ(0, symbol.size);
+}
+
+TEST_F(BreakpadSymbolTableTest, ConvertRejectsOtherFiles) {
+  std::string data;
+  const char kNotSymbols[] = "FUNC 1000 40 4 Foo(int)\n";
+  EXPECT_FALSE(BreakpadSymbolTable::Convert(kNotSymbols,
+                                            sizeof(kNotSymbols) - 1,
+                                            &data));
+  const char kBadFunction[] = "MODULE windows x86 1 a.pdb\nFUNC 1000 Foo\n";
+  EXPECT_FALSE(BreakpadSymbolTable::Convert(kBadFunction,
+                                            sizeof(kBadFunction) - 1,
+                                            &data));
+
+  const char kEmpty[] = "MODULE windows x86 1 a.pdb\n";
+  ASSERT_TRUE(BreakpadSymbolTable::Convert(kEmpty, sizeof(kEmpty) - 1,
+                                           &data));
+  BreakpadSymbolTable table;
+  ASSERT_TRUE(table.Attach(data.data(), data.size()));
+  EXPECT_EQ("", table.code_id());
+  Symbol symbol;
+  EXPECT_FALSE(table.Lookup(0x1000, &symbol));
+}
+
+TEST_F(BreakpadSymbolTableTest, AttachRejectsCorruptTables) {
+  BreakpadSymbolTable table;
+  EXPECT_FALSE(table.Attach(data_.data(), data_.size() - 1));
+  EXPECT_FALSE(table.Attach(data_.data(), 8));
+
+  std::string corrupt(data_);
+  corrupt[0] ^= 0xFF;
+  EXPECT_FALSE(table.Attach(corrupt.data(), corrupt.size()));
+
+  // An unterminated last string.
+  corrupt = data_;
+  corrupt[corrupt.size() - 1] = 'x';
+  EXPECT_FALSE(table.Attach(corrupt.data(), corrupt.size()));
+  EXPECT_FALSE(table.is_attached());
+}
+
+}  // namespace sym_util
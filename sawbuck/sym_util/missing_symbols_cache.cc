@@ -0,0 +1,152 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Missing symbols cache implementation.
+#include "sawbuck/sym_util/missing_symbols_cache.h"
+
+#include <vector>
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/utf_string_conversions.h"
+#include "sawbuck/sym_util/symbol_store.h"
+
+namespace {
+
+// The file has the symbol path on its first line, then a line per module:
+// the image name, time date stamp, size and the time it was found missing,
+// separated by tabs.
+const char kFieldSeparator = '\t';
+const size_t kNumFields = 4;
+
+}  // namespace
+
+namespace sym_util {
+
+const int MissingSymbolsCache::kDefaultTtlHours;
+
+MissingSymbolsCache::Key::Key(const ModuleInformation& module) {
+  SymbolStore::Key key(SymbolStore::MakeKey(module, module.base_address));
+  image_name = key.image_name;
+  time_date_stamp = key.time_date_stamp;
+  module_size = key.module_size;
+}
+
+bool MissingSymbolsCache::Key::operator<(const Key& o) const {
+  if (module_size != o.module_size)
+    return module_size < o.module_size;
+  if (time_date_stamp != o.time_date_stamp)
+    return time_date_stamp < o.time_date_stamp;
+  return image_name < o.image_name;
+}
+
+MissingSymbolsCache::MissingSymbolsCache()
+    : ttl_(base::TimeDelta::FromHours(kDefaultTtlHours)),
+      has_symbol_path_(false) {
+}
+
+MissingSymbolsCache::~MissingSymbolsCache() {
+}
+
+bool MissingSymbolsCache::Open(const base::FilePath& path) {
+  path_ = path;
+
+  std::string contents;
+  if (!base::PathExists(path))
+    return true;
+  if (!base::ReadFileToString(path, &contents))
+    return false;
+
+  std::vector<std::string> lines;
+  base::SplitString(contents, '\n', &lines);
+  if (lines.empty())
+    return true;
+  std::wstring symbol_path(base::UTF8ToWide(lines[0]));
+  if (has_symbol_path_ && symbol_path != symbol_path_)
+    return true;
+  symbol_path_ = symbol_path;
+
+  for (size_t i = 1; i < lines.size(); ++i) {
+    std::vector<std::string> fields;
+    base::SplitString(lines[i], kFieldSeparator, &fields);
+    Key key;
+    unsigned time_date_stamp = 0;
+    unsigned module_size = 0;
+    int64 time = 0;
+    if (fields.size() != kNumFields || fields[0].empty() ||
+        !base::StringToUint(fields[1], &time_date_stamp) ||
+        !base::StringToUint(fields[2], &module_size) ||
+        !base::StringToInt64(fields[3], &time)) {
+      continue;
+    }
+
+    key.image_name = base::UTF8ToWide(fields[0]);
+    key.time_date_stamp = time_date_stamp;
+    key.module_size = module_size;
+    modules_[key] = base::Time::FromInternalValue(time);
+  }
+
+  return true;
+}
+
+void MissingSymbolsCache::SetSymbolPath(const std::wstring& symbol_path) {
+  bool changed = symbol_path != symbol_path_;
+  has_symbol_path_ = true;
+  if (!changed)
+    return;
+
+  symbol_path_ = symbol_path;
+  modules_.clear();
+  Save();
+}
+
+bool MissingSymbolsCache::IsMissing(const ModuleInformation& module,
+                                    const base::Time& now) const {
+  ModuleMap::const_iterator it(modules_.find(Key(module)));
+  return it != modules_.end() && now - it->second < ttl_;
+}
+
+void MissingSymbolsCache::AddMissing(const ModuleInformation& module,
+                                     const base::Time& time) {
+  modules_[Key(module)] = time;
+  Save();
+}
+
+void MissingSymbolsCache::Save() {
+  if (path_.empty())
+    return;
+
+  // The modules are few, and found missing seldom, so the file is simply
+  // rewritten whole.
+  std::string contents(base::WideToUTF8(symbol_path_));
+  contents.append(1, '\n');
+  ModuleMap::const_iterator it(modules_.begin());
+  for (; it != modules_.end(); ++it) {
+    contents.append(base::WideToUTF8(it->first.image_name));
+    contents.append(1, kFieldSeparator);
+    contents.append(base::UintToString(it->first.time_date_stamp));
+    contents.append(1, kFieldSeparator);
+    contents.append(base::UintToString(it->first.module_size));
+    contents.append(1, kFieldSeparator);
+    contents.append(base::Int64ToString(it->second.ToInternalValue()));
+    contents.append(1, '\n');
+  }
+
+  int size = static_cast<int>(contents.size());
+  if (base::WriteFile(path_, contents.data(), size) != size)
+    LOG(ERROR) << "Unable to write " << path_.value();
+}
+
+}  // namespace sym_util
@@ -0,0 +1,99 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Missing symbols cache declaration.
+#ifndef SAWBUCK_SYM_UTIL_MISSING_SYMBOLS_CACHE_H_
+#define SAWBUCK_SYM_UTIL_MISSING_SYMBOLS_CACHE_H_
+
+#include <map>
+#include <string>
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/time/time.h"
+#include "sawbuck/sym_util/types.h"
+
+namespace sym_util {
+
+// Remembers the modules the symbol path had no symbols for, from one
+// session to the next, so that a module without a PDB, e.g. a third party
+// DLL, isn't asked of the symbol servers in every session, each time taking
+// many seconds. The modules are keyed by identity, wherever they're loaded,
+// and forgotten after a while, in case their symbols turn up.
+// The cache holds only for the symbol path it was built under, and starts
+// over as the path changes.
+class MissingSymbolsCache {
+ public:
+  MissingSymbolsCache();
+  ~MissingSymbolsCache();
+
+  // How long a module is taken to be without symbols.
+  base::TimeDelta ttl() const { return ttl_; }
+  void set_ttl(const base::TimeDelta& ttl) { ttl_ = ttl; }
+
+  // The default of ttl, in hours.
+  static const int kDefaultTtlHours = 24;
+
+  // Reads the cache file at @p path, if there is one, and writes the
+  // modules we add from then on back to it. A file of another symbol path
+  // than the one set is started over, and lines that don't parse are
+  // skipped. Before a symbol path is set, the file's is taken.
+  // @returns true on success, or if there's no file yet.
+  bool Open(const base::FilePath& path);
+
+  // Sets the symbol path the modules we add are without symbols on, which
+  // forgets the modules of any other path.
+  void SetSymbolPath(const std::wstring& symbol_path);
+
+  // @returns true iff @p module was found without symbols within the ttl
+  //     before @p now.
+  bool IsMissing(const ModuleInformation& module, const base::Time& now) const;
+
+  // Notes that @p module was found without symbols at @p time.
+  void AddMissing(const ModuleInformation& module, const base::Time& time);
+
+  // @returns the number of modules we know of, whatever their age.
+  size_t num_modules() const { return modules_.size(); }
+
+ private:
+  // The identity of a module, as SymbolStore keys modules.
+  struct Key {
+    explicit Key(const ModuleInformation& module);
+    Key() : time_date_stamp(0), module_size(0) {
+    }
+    bool operator<(const Key& o) const;
+
+    std::wstring image_name;
+    ModuleTimeDateStamp time_date_stamp;
+    ModuleSize module_size;
+  };
+
+  // Writes the modules we know of to path_, if it's set.
+  void Save();
+
+  // The modules without symbols, and when they were found without.
+  typedef std::map<Key, base::Time> ModuleMap;
+  ModuleMap modules_;
+
+  base::TimeDelta ttl_;
+  base::FilePath path_;
+  std::wstring symbol_path_;
+  // True once SetSymbolPath has been called.
+  bool has_symbol_path_;
+
+  DISALLOW_COPY_AND_ASSIGN(MissingSymbolsCache);
+};
+
+}  // namespace sym_util
+
+#endif  // SAWBUCK_SYM_UTIL_MISSING_SYMBOLS_CACHE_H_
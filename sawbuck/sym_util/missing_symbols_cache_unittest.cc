@@ -0,0 +1,142 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Missing symbols cache unittests.
+#include "sawbuck/sym_util/missing_symbols_cache.h"
+
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "gtest/gtest.h"
+
+namespace sym_util {
+
+namespace {
+
+const wchar_t kSymbolPath[] =
+    L"srv*c:\\symbols*http://msdl.microsoft.com/download/symbols";
+const wchar_t kOtherSymbolPath[] = L"c:\\symbols";
+
+class MissingSymbolsCacheTest : public testing::Test {
+ public:
+  MissingSymbolsCacheTest() : now_(base::Time::Now()) {
+  }
+
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    cache_path_ = temp_dir_.path().Append(L"symbol_cache.missing");
+
+    module_.base_address = 0x10000000;
+    module_.module_size = 0x100000;
+    module_.image_checksum = 0xCAFE;
+    module_.time_date_stamp = 0x4D2;
+    module_.image_file_name = L"c:\\program files\\vendor\\vendor.dll";
+  }
+
+ protected:
+  base::ScopedTempDir temp_dir_;
+  base::FilePath cache_path_;
+  ModuleInformation module_;
+  base::Time now_;
+};
+
+}  // namespace
+
+TEST_F(MissingSymbolsCacheTest, KeysByIdentity) {
+  MissingSymbolsCache cache;
+  cache.SetSymbolPath(kSymbolPath);
+  EXPECT_FALSE(cache.IsMissing(module_, now_));
+  cache.AddMissing(module_, now_);
+  EXPECT_TRUE(cache.IsMissing(module_, now_));
+
+  // The module is the same wherever it's loaded from, in any case.
+  ModuleInformation moved(module_);
+  moved.base_address = 0x20000000;
+  moved.image_file_name = L"d:\\VENDOR.DLL";
+  EXPECT_TRUE(cache.IsMissing(moved, now_));
+
+  // But not another build of it.
+  ModuleInformation rebuilt(module_);
+  rebuilt.time_date_stamp++;
+  EXPECT_FALSE(cache.IsMissing(rebuilt, now_));
+}
+
+TEST_F(MissingSymbolsCacheTest, Expires) {
+  MissingSymbolsCache cache;
+  cache.set_ttl(base::TimeDelta::FromHours(1));
+  cache.AddMissing(module_, now_);
+
+  EXPECT_TRUE(cache.IsMissing(module_, now_ + base::TimeDelta::FromMinutes(59)));
+  EXPECT_FALSE(cache.IsMissing(module_, now_ + base::TimeDelta::FromHours(1)));
+}
+
+TEST_F(MissingSymbolsCacheTest, Persists) {
+  {
+    MissingSymbolsCache cache;
+    cache.SetSymbolPath(kSymbolPath);
+    ASSERT_TRUE(cache.Open(cache_path_));
+    cache.AddMissing(module_, now_);
+  }
+
+  // The path may be set before or after opening.
+  {
+    MissingSymbolsCache cache;
+    ASSERT_TRUE(cache.Open(cache_path_));
+    cache.SetSymbolPath(kSymbolPath);
+    EXPECT_TRUE(cache.IsMissing(module_, now_));
+  }
+
+  MissingSymbolsCache cache;
+  cache.SetSymbolPath(kSymbolPath);
+  ASSERT_TRUE(cache.Open(cache_path_));
+  EXPECT_EQ(1U, cache.num_modules());
+  EXPECT_TRUE(cache.IsMissing(module_, now_));
+}
+
+TEST_F(MissingSymbolsCacheTest, StartsOverOnNewSymbolPath) {
+  {
+    MissingSymbolsCache cache;
+    cache.SetSymbolPath(kSymbolPath);
+    ASSERT_TRUE(cache.Open(cache_path_));
+    cache.AddMissing(module_, now_);
+  }
+
+  {
+    MissingSymbolsCache cache;
+    cache.SetSymbolPath(kOtherSymbolPath);
+    ASSERT_TRUE(cache.Open(cache_path_));
+    EXPECT_FALSE(cache.IsMissing(module_, now_));
+  }
+
+  MissingSymbolsCache cache;
+  ASSERT_TRUE(cache.Open(cache_path_));
+  cache.SetSymbolPath(kOtherSymbolPath);
+  EXPECT_FALSE(cache.IsMissing(module_, now_));
+  EXPECT_EQ(0U, cache.num_modules());
+}
+
+TEST_F(MissingSymbolsCacheTest, SkipsBadLines) {
+  std::string contents("c:\\symbols\n"
+                       "vendor.dll\t1234\t1048576\n"
+                       "vendor.dll\tfoo\t1048576\t0\n"
+                       "\n");
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            base::WriteFile(cache_path_, contents.data(), contents.size()));
+
+  MissingSymbolsCache cache;
+  cache.SetSymbolPath(L"c:\\symbols");
+  EXPECT_TRUE(cache.Open(cache_path_));
+  EXPECT_EQ(0U, cache.num_modules());
+}
+
+}  // namespace sym_util
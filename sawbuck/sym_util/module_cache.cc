@@ -15,13 +15,23 @@
 // Module cache implementation.
 #include "sawbuck/sym_util/module_cache.h"
 
+#include <algorithm>
+#include "base/logging.h"
+
 namespace sym_util {
 
 // The empty module load state.
 ModuleCache::ModuleLoadState ModuleCache::empty_;
 
 
-ModuleCache::ModuleCache() : next_module_load_state_id_(0) {
+ModuleCache::StateIdMemo::StateIdMemo()
+    : generation(-1), pid(0), id(kInvalidModuleLoadState) {
+}
+
+ModuleCache::ModuleCache()
+    : next_module_load_state_id_(0),
+      num_module_load_states_(0),
+      generation_(0) {
 }
 
 void ModuleCache::ModuleLoaded(ProcessId pid,
@@ -29,14 +39,11 @@ void ModuleCache::ModuleLoaded(ProcessId pid,
                                const ModuleInformation& module) {
   ModuleStateKey key(pid, time);
 
-  // Find the state we have for this process.
-  ModuleLoadState state(GetStateForProcess(key));
-
-  // Add the new module.
-  state.insert(GetModuleId(module));
-
-  // And store it.
-  SetProcessState(key, GetModuleLoadStateId(state));
+  // Find the state we have for this process, add the new module,
+  // and store it.
+  ModuleLoadStateId id = GetStateIdForProcess(key);
+  SetProcessState(key, GetTransitionStateId(id, GetModuleId(module), true));
+  ++generation_;
 }
 
 void ModuleCache::ModuleUnloaded(ProcessId pid,
@@ -44,14 +51,40 @@ void ModuleCache::ModuleUnloaded(ProcessId pid,
                                  const ModuleInformation& module) {
   ModuleStateKey key(pid, time);
 
-  // Find the state we have for this process.
-  ModuleLoadState state(GetStateForProcess(key));
+  // Find the state we have for this process, remove the module,
+  // and store it.
+  ModuleLoadStateId id = GetStateIdForProcess(key);
+  SetProcessState(key, GetTransitionStateId(id, GetModuleId(module), false));
+  ++generation_;
+}
 
-  // Remove the module.
-  state.erase(GetModuleId(module));
+void ModuleCache::ProcessEnded(ProcessId pid, const base::Time& time) {
+  ProcessLoadStateMap::iterator begin(process_states_.lower_bound(
+      ModuleStateKey(pid, base::Time::FromInternalValue(kint64min))));
+  ProcessLoadStateMap::iterator end(
+      process_states_.upper_bound(ModuleStateKey(pid, time)));
+
+  if (begin != end) {
+    // The entries move over with their references.
+    StateHistory& history = ended_states_[pid];
+    size_t old_size = history.size();
+    history.reserve(old_size + std::distance(begin, end));
+    for (ProcessLoadStateMap::iterator it(begin); it != end; ++it) {
+      StateEntry entry = { it->first.time_, it->second };
+      history.push_back(entry);
+    }
+    process_states_.erase(begin, end);
+
+    // A pid is only reused after its process ends, so the history is
+    // almost always in order already.
+    if (old_size != 0 && history[old_size] < history[old_size - 1]) {
+      std::inplace_merge(history.begin(), history.begin() + old_size,
+                         history.end());
+    }
+  }
 
-  // And store it.
-  SetProcessState(key, GetModuleLoadStateId(state));
+  SweepUnreferencedStates();
+  ++generation_;
 }
 
 bool ModuleCache::GetProcessModuleState(
@@ -73,11 +106,60 @@ bool ModuleCache::GetProcessModuleState(
   return true;
 }
 
+bool ModuleCache::GetModuleForAddress(ProcessId pid,
+                                      const base::Time& time,
+                                      Address address,
+                                      ModuleInformation* module) {
+  StateIdMemo memo;
+  return GetModuleForAddress(pid, time, address, &memo, module);
+}
+
+bool ModuleCache::GetModuleForAddress(ProcessId pid,
+                                      const base::Time& time,
+                                      Address address,
+                                      StateIdMemo* memo,
+                                      ModuleInformation* module) {
+  DCHECK(memo != NULL);
+  DCHECK(module != NULL);
+
+  ModuleLoadStateId id = GetStateIdForProcess(ModuleStateKey(pid, time),
+                                              memo);
+  if (id == kInvalidModuleLoadState)
+    return false;
+
+  // Find the last module based at or below the address.
+  const ModuleIntervals& intervals = GetModuleIntervals(id);
+  ModuleInterval probe = {};
+  probe.base = address;
+  ModuleIntervals::const_iterator it(
+      std::upper_bound(intervals.begin(), intervals.end(), probe));
+
+  // Step back to the module that contains the address, which is almost
+  // always the first, unless modules overlap.
+  while (it != intervals.begin()) {
+    --it;
+    if (it->max_end <= address)
+      break;
+    if (address < it->end) {
+      *module = GetModule(it->id);
+      return true;
+    }
+  }
+
+  return false;
+}
+
 ModuleCache::ModuleLoadStateId ModuleCache::GetStateId(
     ProcessId pid, const base::Time& start_time) {
   return GetStateIdForProcess(ModuleStateKey(pid, start_time));
 }
 
+ModuleCache::ModuleLoadStateId ModuleCache::GetStateId(
+    ProcessId pid, const base::Time& time, StateIdMemo* memo) {
+  DCHECK(memo != NULL);
+  return GetStateIdForProcess(ModuleStateKey(pid, time), memo);
+}
+
 ModuleCache::ModuleId ModuleCache::GetModuleId(
     const ModuleInformation& module_info) {
   ModuleInfoMap::iterator it(module_ids_.find(module_info));
@@ -96,37 +178,222 @@ const ModuleInformation& ModuleCache::GetModule(ModuleId id) {
   return modules_[id];
 }
 
-ModuleCache::ModuleLoadStateId ModuleCache::GetModuleLoadStateId(
-    const ModuleLoadState& state) {
-  ModuleLoadStateMap::iterator it(module_load_state_ids_.find(state));
+ModuleCache::ModuleLoadStateHash ModuleCache::HashModule(ModuleId id) {
+  // Spread the ids over the hash space, as sums of small consecutive
+  // ids collide easily.
+  uint64 hash = (static_cast<uint64>(id) + 1) * 0x9E3779B97F4A7C15ULL;
+  return static_cast<ModuleLoadStateHash>(hash ^ (hash >> 32));
+}
 
-  if (it != module_load_state_ids_.end())
+ModuleCache::ModuleLoadStateId ModuleCache::GetTransitionStateId(
+    ModuleLoadStateId from, ModuleId module, bool loaded) {
+  TransitionMap& transitions =
+      loaded ? loaded_transitions_ : unloaded_transitions_;
+  TransitionKey transition(from, module);
+  TransitionMap::iterator it(transitions.find(transition));
+  if (it != transitions.end() && !module_load_state_dropped_[it->second])
     return it->second;
 
+  const ModuleLoadState& from_state =
+      from == kInvalidModuleLoadState ? empty_ : GetModuleLoadState(from);
+  ModuleLoadStateHash hash =
+      from == kInvalidModuleLoadState ? 0 : module_load_state_hashes_[from];
+
+  ModuleLoadState::const_iterator pos(
+      std::lower_bound(from_state.begin(), from_state.end(), module));
+  bool present = pos != from_state.end() && *pos == module;
+
+  ModuleLoadStateId id = kInvalidModuleLoadState;
+  if (it != transitions.end()) {
+    // The state it went to was dropped, forget it.
+    transitions.erase(it);
+  }
+  if (present == loaded) {
+    // Nothing changes, but a process with no state gets an empty one.
+    id = from != kInvalidModuleLoadState ? from :
+        GetModuleLoadStateId(empty_, 0);
+  } else {
+    ModuleLoadState state;
+    state.reserve(from_state.size() + 1);
+    state.insert(state.end(), from_state.begin(), pos);
+    if (loaded) {
+      state.push_back(module);
+      state.insert(state.end(), pos, from_state.end());
+      hash += HashModule(module);
+    } else {
+      state.insert(state.end(), pos + 1, from_state.end());
+      hash -= HashModule(module);
+    }
+    id = GetModuleLoadStateId(state, hash);
+  }
+
+  transitions.insert(std::make_pair(transition, id));
+  return id;
+}
+
+ModuleCache::ModuleLoadStateId ModuleCache::GetModuleLoadStateId(
+    const ModuleLoadState& state, ModuleLoadStateHash hash) {
+  // Only states with the same hash need comparing.
+  std::pair<ModuleLoadStateMap::iterator, ModuleLoadStateMap::iterator>
+      range(module_load_state_ids_.equal_range(hash));
+  for (; range.first != range.second; ++range.first) {
+    if (module_load_states_[range.first->second] == state)
+      return range.first->second;
+  }
+
   ModuleLoadStateId id = next_module_load_state_id_++;
-  module_load_state_ids_.insert(std::make_pair(state, id));
+  module_load_state_ids_.insert(std::make_pair(hash, id));
   module_load_states_.push_back(state);
+  module_load_state_hashes_.push_back(hash);
+  module_load_state_intervals_.push_back(ModuleIntervals());
+  module_load_state_intervals_built_.push_back(false);
+  module_load_state_refs_.push_back(0);
+  module_load_state_dropped_.push_back(false);
+  ++num_module_load_states_;
 
   return id;
 }
 
+void ModuleCache::AddStateRef(ModuleLoadStateId id) {
+  DCHECK(!module_load_state_dropped_[id]);
+  ++module_load_state_refs_[id];
+}
+
+void ModuleCache::ReleaseStateRef(ModuleLoadStateId id) {
+  DCHECK_NE(0U, module_load_state_refs_[id]);
+  if (--module_load_state_refs_[id] == 0)
+    unreferenced_states_.push_back(id);
+}
+
+void ModuleCache::SweepUnreferencedStates() {
+  std::vector<ModuleLoadStateId>::const_iterator it(
+      unreferenced_states_.begin());
+  for (; it != unreferenced_states_.end(); ++it) {
+    if (module_load_state_refs_[*it] == 0 &&
+        !module_load_state_dropped_[*it]) {
+      DropModuleLoadState(*it);
+    }
+  }
+  unreferenced_states_.clear();
+}
+
+void ModuleCache::DropModuleLoadState(ModuleLoadStateId id) {
+  DCHECK_EQ(0U, module_load_state_refs_[id]);
+  DCHECK(!module_load_state_dropped_[id]);
+
+  std::pair<ModuleLoadStateMap::iterator, ModuleLoadStateMap::iterator>
+      range(module_load_state_ids_.equal_range(module_load_state_hashes_[id]));
+  for (; range.first != range.second; ++range.first) {
+    if (range.first->second == id) {
+      module_load_state_ids_.erase(range.first);
+      break;
+    }
+  }
+
+  // Transitions are keyed on where they start, so the ones from the state
+  // are a range.
+  TransitionKey first(id, 0);
+  TransitionKey last(id + 1, 0);
+  loaded_transitions_.erase(loaded_transitions_.lower_bound(first),
+                            loaded_transitions_.lower_bound(last));
+  unloaded_transitions_.erase(unloaded_transitions_.lower_bound(first),
+                              unloaded_transitions_.lower_bound(last));
+
+  ModuleLoadState().swap(module_load_states_[id]);
+  ModuleIntervals().swap(module_load_state_intervals_[id]);
+  module_load_state_intervals_built_[id] = false;
+  module_load_state_dropped_[id] = true;
+  --num_module_load_states_;
+}
+
 const ModuleCache::ModuleLoadState& ModuleCache::GetModuleLoadState(
     ModuleLoadStateId id) {
   return module_load_states_[id];
 }
 
+const ModuleCache::ModuleIntervals& ModuleCache::GetModuleIntervals(
+    ModuleLoadStateId id) {
+  DCHECK_LT(id, module_load_state_intervals_.size());
+  ModuleIntervals& intervals = module_load_state_intervals_[id];
+  if (module_load_state_intervals_built_[id])
+    return intervals;
+
+  const ModuleLoadState& state = GetModuleLoadState(id);
+  intervals.reserve(state.size());
+  ModuleLoadState::const_iterator it(state.begin());
+  for (; it != state.end(); ++it) {
+    const ModuleInformation& info = GetModule(*it);
+    ModuleInterval interval = {};
+    interval.base = info.base_address;
+    interval.end = info.base_address + info.module_size;
+    interval.id = *it;
+    intervals.push_back(interval);
+  }
+
+  std::sort(intervals.begin(), intervals.end());
+  ModuleBase max_end = 0;
+  for (size_t i = 0; i < intervals.size(); ++i) {
+    max_end = std::max(max_end, intervals[i].end);
+    intervals[i].max_end = max_end;
+  }
+
+  module_load_state_intervals_built_[id] = true;
+  return intervals;
+}
+
 ModuleCache::ModuleLoadStateId ModuleCache::GetStateIdForProcess(
     const ModuleStateKey& key) {
-  ProcessLoadStateMap::iterator it(process_states_.upper_bound(key));
-  // Back up one if we can.
-  if (it != process_states_.begin())
+  StateIdMemo memo;
+  return GetStateIdForProcess(key, &memo);
+}
+
+ModuleCache::ModuleLoadStateId ModuleCache::GetStateIdForProcess(
+    const ModuleStateKey& key, StateIdMemo* memo) {
+  DCHECK(memo != NULL);
+  if (memo->generation == generation_ && memo->pid == key.pid_ &&
+      memo->from <= key.time_ && key.time_ < memo->until) {
+    return memo->id;
+  }
+
+  // The state holds from the last entry of the process at or before the
+  // time, or since ever if there's none, until the process's next entry.
+  memo->generation = generation_;
+  memo->pid = key.pid_;
+  memo->from = base::Time::FromInternalValue(kint64min);
+  memo->until = base::Time::FromInternalValue(kint64max);
+  memo->id = kInvalidModuleLoadState;
+
+  ProcessLoadStateMap::iterator next(process_states_.upper_bound(key));
+  if (next != process_states_.end() && next->first.pid_ == key.pid_)
+    memo->until = next->first.time_;
+  if (next != process_states_.begin()) {
+    ProcessLoadStateMap::iterator it(next);
     --it;
+    if (it->first.pid_ == key.pid_) {
+      memo->from = it->first.time_;
+      memo->id = it->second;
+      return memo->id;
+    }
+  }
 
-  // If we hit on the right process, we found the nearest info we have.
-  if (it != process_states_.end() && it->first.pid_ == key.pid_)
-    return it->second;
+  // Before the live entries of the process, its ended history holds.
+  EndedProcessMap::const_iterator ended(ended_states_.find(key.pid_));
+  if (ended == ended_states_.end())
+    return memo->id;
+
+  const StateHistory& history = ended->second;
+  StateEntry probe = { key.time_, kInvalidModuleLoadState };
+  StateHistory::const_iterator it(
+      std::upper_bound(history.begin(), history.end(), probe));
+  if (it != history.end())
+    memo->until = it->time;
+  if (it != history.begin()) {
+    --it;
+    memo->from = it->time;
+    memo->id = it->id;
+  }
 
-  return kInvalidModuleLoadState;
+  return memo->id;
 }
 
 const ModuleCache::ModuleLoadState& ModuleCache::GetStateForProcess(
@@ -147,9 +414,11 @@ void ModuleCache::SetProcessState(const ModuleStateKey& key,
     --it;
 
   // Do we need to insert a new entry?
+  AddStateRef(id);
   if (it == process_states_.end() || it->first != key) {
     process_states_.insert(std::make_pair(key, id));
   } else {  // it->first == key
+    ReleaseStateRef(it->second);
     it->second = id;
   }
 }
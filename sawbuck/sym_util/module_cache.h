@@ -18,7 +18,6 @@
 
 #include "base/time/time.h"
 #include <map>
-#include <set>
 #include <string>
 #include <vector>
 #include "sawbuck/sym_util/types.h"
@@ -33,6 +32,24 @@ class ModuleCache {
  public:
   ModuleCache();
 
+  typedef size_t ModuleLoadStateId;
+
+  // The outcome of a state lookup, which serves the lookups that follow
+  // for the same process at times with the same state, without a search.
+  // Any change to the cache invalidates it. Callers keep one apiece, e.g.
+  // one per thread, as the cache doesn't touch it but to look up.
+  struct StateIdMemo {
+    StateIdMemo();
+
+    // The generation of the cache the memo is for, -1 for none.
+    int generation;
+    ProcessId pid;
+    // The times the state holds over, from inclusive, until exclusive.
+    base::Time from;
+    base::Time until;
+    ModuleLoadStateId id;
+  };
+
   // @p module loaded into @p pid at @p time.
   void ModuleLoaded(ProcessId pid,
                     const base::Time& time,
@@ -41,12 +58,30 @@ class ModuleCache {
   void ModuleUnloaded(ProcessId pid,
                       const base::Time& time,
                       const ModuleInformation& module);
+  // Process @p pid ended at @p time. Its state history up to then moves
+  // out of the live map into a flat array, and the states no entry refers
+  // to any more are dropped. Lookups see the same states as before.
+  void ProcessEnded(ProcessId pid, const base::Time& time);
 
   // Retrieve the module state for process @p pid at @p time.
   bool GetProcessModuleState(ProcessId pid,
                              const base::Time& time,
                              std::vector<ModuleInformation>* modules);
 
+  // Retrieve the module that contains @p address in process @p pid at
+  // @p time.
+  // @returns true iff there is such a module.
+  bool GetModuleForAddress(ProcessId pid,
+                           const base::Time& time,
+                           Address address,
+                           ModuleInformation* module);
+  // As above, looking up the state through @p memo, and updating it.
+  bool GetModuleForAddress(ProcessId pid,
+                           const base::Time& time,
+                           Address address,
+                           StateIdMemo* memo,
+                           ModuleInformation* module);
+
   // Returns an arbitrary ID that's guaranteed to be different for any
   // two process load states - e.g. if GetProcessModuleState(pid, time, ...)
   // were to return different sets of modules for two values of {pid, time},
@@ -54,9 +89,15 @@ class ModuleCache {
   // This function _may_ return the same ID for e.g. two different {pid, time}
   // pairs, if it so happens that the module load state for the processes
   // referred is identical at the times indicated.
-  typedef size_t ModuleLoadStateId;
   ModuleLoadStateId GetStateId(ProcessId pid,
                                const base::Time& start_time);
+  // As above, looking up the state through @p memo, and updating it.
+  ModuleLoadStateId GetStateId(ProcessId pid,
+                               const base::Time& time,
+                               StateIdMemo* memo);
+
+  // @returns the number of distinct module load states held.
+  size_t num_module_load_states() const { return num_module_load_states_; }
 
  private:
   // Since the same module occurs loaded at the same address
@@ -73,21 +114,86 @@ class ModuleCache {
   const ModuleInformation& GetModule(ModuleId id);
 
   // The module load state of any process at any given time is
-  // encoded as a set of module ids. And since we tend to have
+  // encoded as a sorted vector of module ids. And since we tend to have
   // multiple occurrences of the same module load state, e.g. when
   // you have multiple instances of the same executable running, we
   // encode entire module load states into an integer as well.
-  typedef std::set<ModuleId> ModuleLoadState;
-  typedef std::map<ModuleLoadState, ModuleLoadStateId> ModuleLoadStateMap;
-  // Maps from module load state to id.
+  typedef std::vector<ModuleId> ModuleLoadState;
+  // The hash of a load state is the sum of the hashes of its modules, so
+  // that the hash of a state one module away is cheap to compute.
+  typedef size_t ModuleLoadStateHash;
+  static ModuleLoadStateHash HashModule(ModuleId id);
+
+  // Maps from module load state hash to the ids of the states with it.
+  typedef std::multimap<ModuleLoadStateHash, ModuleLoadStateId>
+      ModuleLoadStateMap;
   ModuleLoadStateMap module_load_state_ids_;
-  // Maps from id to module load state.
+  // Maps from id to module load state, and its hash.
   std::vector<ModuleLoadState> module_load_states_;
+  std::vector<ModuleLoadStateHash> module_load_state_hashes_;
   ModuleId next_module_load_state_id_;
 
-  ModuleLoadStateId GetModuleLoadStateId(const ModuleLoadState& state);
+  // The number of process state entries referring to each load state, and
+  // whether it's been dropped. Ids aren't reused, so a dropped state's id
+  // never comes to stand for another state.
+  std::vector<size_t> module_load_state_refs_;
+  std::vector<bool> module_load_state_dropped_;
+  size_t num_module_load_states_;
+  // The states whose references went to zero since the last sweep, which
+  // may have been referred to again since.
+  std::vector<ModuleLoadStateId> unreferenced_states_;
+
+  void AddStateRef(ModuleLoadStateId id);
+  void ReleaseStateRef(ModuleLoadStateId id);
+  // Drops the states in unreferenced_states_ still without references.
+  void SweepUnreferencedStates();
+  // Frees unreferenced load state @p id, and forgets the transitions
+  // from it. Transitions to it are forgotten when next looked up.
+  void DropModuleLoadState(ModuleLoadStateId id);
+
+  // Processes tend to load the same modules in the same order, so we
+  // remember where adding or removing a module takes each state. This
+  // makes repeated transitions a map lookup, and new ones the cost of
+  // building the new state once.
+  typedef std::pair<ModuleLoadStateId, ModuleId> TransitionKey;
+  typedef std::map<TransitionKey, ModuleLoadStateId> TransitionMap;
+  TransitionMap loaded_transitions_;
+  TransitionMap unloaded_transitions_;
+
+  // @returns the id of the state @p from with @p module added, or removed
+  //     if @p loaded is false. @p from may be kInvalidModuleLoadState for
+  //     the empty state.
+  ModuleLoadStateId GetTransitionStateId(ModuleLoadStateId from,
+                                         ModuleId module,
+                                         bool loaded);
+  // @returns the id of @p state with @p hash, interning it if need be.
+  ModuleLoadStateId GetModuleLoadStateId(const ModuleLoadState& state,
+                                         ModuleLoadStateHash hash);
   const ModuleLoadState& GetModuleLoadState(ModuleLoadStateId id);
 
+  // The modules of a load state sorted by base address, for finding the
+  // module containing an address with a binary search.
+  struct ModuleInterval {
+    ModuleBase base;
+    ModuleBase end;
+    // The largest end of any module up to and including this one, which
+    // bounds the search for overlapping modules.
+    ModuleBase max_end;
+    ModuleId id;
+
+    bool operator<(const ModuleInterval& o) const {
+      return base < o.base;
+    }
+  };
+  typedef std::vector<ModuleInterval> ModuleIntervals;
+
+  // Retrieves the intervals of load state @p id, building them on first use.
+  const ModuleIntervals& GetModuleIntervals(ModuleLoadStateId id);
+
+  // The intervals by load state id, and whether they've been built.
+  std::vector<ModuleIntervals> module_load_state_intervals_;
+  std::vector<bool> module_load_state_intervals_built_;
+
   struct ModuleStateKey {
     ModuleStateKey(ProcessId pid, const base::Time& time)
         : pid_(pid), time_(time) {
@@ -115,6 +221,10 @@ class ModuleCache {
 
   // Retrieves the module load state id for a process at a time.
   ModuleLoadStateId GetStateIdForProcess(const ModuleStateKey& key);
+  // Retrieves it through @p memo, searching and updating the memo if it
+  // doesn't cover @p key.
+  ModuleLoadStateId GetStateIdForProcess(const ModuleStateKey& key,
+                                         StateIdMemo* memo);
   // Set the module load state for a process at a time.
   void SetProcessState(const ModuleStateKey& key, ModuleLoadStateId id);
 
@@ -125,6 +235,23 @@ class ModuleCache {
   typedef std::map<ModuleStateKey, ModuleLoadStateId> ProcessLoadStateMap;
   ProcessLoadStateMap process_states_;
 
+  // The state history of ended processes, by pid, sorted by time. A
+  // reused pid's live entries in process_states_ follow its history.
+  struct StateEntry {
+    base::Time time;
+    ModuleLoadStateId id;
+
+    bool operator<(const StateEntry& o) const {
+      return time < o.time;
+    }
+  };
+  typedef std::vector<StateEntry> StateHistory;
+  typedef std::map<ProcessId, StateHistory> EndedProcessMap;
+  EndedProcessMap ended_states_;
+
+  // Bumped on every module load and unload, and process end.
+  int generation_;
+
   static const ModuleLoadStateId kInvalidModuleLoadState = -1;
   static ModuleLoadState empty_;
 };
@@ -70,6 +70,263 @@ TEST(ModuleCacheTest, Insert) {
             cache.GetStateId(kPid1, t2 + base::TimeDelta::FromMilliseconds(1)));
 }
 
+TEST(ModuleCacheTest, SharedStates) {
+  ModuleCache cache;
+  base::Time t0(base::Time::Now());
+  base::Time t1(t0 + base::TimeDelta::FromSeconds(1));
+  base::Time t2(t0 + base::TimeDelta::FromSeconds(2));
+  const ProcessId kPid2 = kPid1 + 1;
+
+  ModuleInformation mod1 = { 0 };
+  mod1.base_address = 0x10000000;
+  mod1.module_size = 0x1000;
+  ModuleInformation mod2 = { 0 };
+  mod2.base_address = 0x20000000;
+  mod2.module_size = 0x1000;
+
+  // Two processes loading the same modules in opposite order end up in
+  // the same state.
+  cache.ModuleLoaded(kPid1, t0, mod1);
+  cache.ModuleLoaded(kPid1, t1, mod2);
+  cache.ModuleLoaded(kPid2, t0, mod2);
+  cache.ModuleLoaded(kPid2, t1, mod1);
+  EXPECT_EQ(cache.GetStateId(kPid1, t1), cache.GetStateId(kPid2, t1));
+  EXPECT_NE(cache.GetStateId(kPid1, t0), cache.GetStateId(kPid2, t0));
+
+  // Unloading a module goes back to the earlier state.
+  cache.ModuleUnloaded(kPid1, t2, mod2);
+  EXPECT_EQ(cache.GetStateId(kPid1, t0), cache.GetStateId(kPid1, t2));
+  cache.ModuleUnloaded(kPid2, t2, mod2);
+  EXPECT_EQ(cache.GetStateId(kPid1, t2), cache.GetStateId(kPid2, t2));
+
+  // Loading a module twice doesn't change the state.
+  cache.ModuleLoaded(kPid2, t2, mod1);
+  EXPECT_EQ(cache.GetStateId(kPid1, t2), cache.GetStateId(kPid2, t2));
+
+  std::vector<ModuleInformation> modules;
+  ASSERT_TRUE(cache.GetProcessModuleState(kPid2, t1, &modules));
+  ASSERT_EQ(2U, modules.size());
+  EXPECT_EQ(mod1.base_address, modules[0].base_address);
+  EXPECT_EQ(mod2.base_address, modules[1].base_address);
+}
+
+TEST(ModuleCacheTest, GetModuleForAddress) {
+  ModuleCache cache;
+
+  ModuleInformation mod1 = { 0 };
+  mod1.base_address = 0x10000000;
+  mod1.module_size = 0x1000;
+  mod1.image_file_name = L"foo.dll";
+  base::Time t0(base::Time::Now());
+  cache.ModuleLoaded(kPid1, t0, mod1);
+
+  ModuleInformation mod2 = { 0 };
+  mod2.base_address = 0x20000000;
+  mod2.module_size = 0x2000;
+  mod2.image_file_name = L"bar.dll";
+  base::Time t1(t0 + base::TimeDelta::FromMilliseconds(10));
+  cache.ModuleLoaded(kPid1, t1, mod2);
+
+  ModuleInformation module;
+  EXPECT_TRUE(cache.GetModuleForAddress(kPid1, t0, 0x10000000, &module));
+  EXPECT_STREQ(L"foo.dll", module.image_file_name.c_str());
+  EXPECT_TRUE(cache.GetModuleForAddress(kPid1, t0, 0x10000FFF, &module));
+  EXPECT_STREQ(L"foo.dll", module.image_file_name.c_str());
+  EXPECT_FALSE(cache.GetModuleForAddress(kPid1, t0, 0x10001000, &module));
+  EXPECT_FALSE(cache.GetModuleForAddress(kPid1, t0, 0x0FFFFFFF, &module));
+
+  // Bar isn't loaded until t1.
+  EXPECT_FALSE(cache.GetModuleForAddress(kPid1, t0, 0x20000010, &module));
+  EXPECT_TRUE(cache.GetModuleForAddress(kPid1, t1, 0x20000010, &module));
+  EXPECT_STREQ(L"bar.dll", module.image_file_name.c_str());
+
+  // Nor in another process.
+  EXPECT_FALSE(cache.GetModuleForAddress(kPid1 + 1, t1, 0x20000010,
+                                         &module));
+}
+
+TEST(ModuleCacheTest, StateIdMemo) {
+  ModuleCache cache;
+
+  ModuleInformation mod1 = { 0 };
+  mod1.base_address = 0x10000000;
+  mod1.module_size = 0x1000;
+  mod1.image_file_name = L"foo.dll";
+  base::Time t0(base::Time::Now());
+  cache.ModuleLoaded(kPid1, t0, mod1);
+
+  ModuleInformation mod2 = { 0 };
+  mod2.base_address = 0x20000000;
+  mod2.module_size = 0x2000;
+  mod2.image_file_name = L"bar.dll";
+  base::Time t1(t0 + base::TimeDelta::FromMilliseconds(10));
+  cache.ModuleLoaded(kPid1, t1, mod2);
+
+  // The memo spans the times between the process's entries.
+  ModuleCache::StateIdMemo memo;
+  base::Time t05(t0 + base::TimeDelta::FromMilliseconds(5));
+  EXPECT_EQ(cache.GetStateId(kPid1, t0), cache.GetStateId(kPid1, t0, &memo));
+  EXPECT_EQ(t0, memo.from);
+  EXPECT_EQ(t1, memo.until);
+  EXPECT_EQ(cache.GetStateId(kPid1, t05), cache.GetStateId(kPid1, t05, &memo));
+  EXPECT_EQ(cache.GetStateId(kPid1, t1), cache.GetStateId(kPid1, t1, &memo));
+  EXPECT_EQ(t1, memo.from);
+  EXPECT_EQ(cache.GetStateId(kPid1 + 1, t1),
+            cache.GetStateId(kPid1 + 1, t1, &memo));
+  EXPECT_EQ(kPid1 + 1, memo.pid);
+
+  ModuleInformation module;
+  EXPECT_FALSE(cache.GetModuleForAddress(kPid1, t05, 0x20000010, &memo,
+                                         &module));
+  EXPECT_TRUE(cache.GetModuleForAddress(kPid1, t05, 0x10000010, &memo,
+                                        &module));
+  EXPECT_STREQ(L"foo.dll", module.image_file_name.c_str());
+
+  // A change to the cache invalidates the memo.
+  int generation = memo.generation;
+  cache.ModuleLoaded(kPid1, t05, mod2);
+  EXPECT_TRUE(cache.GetModuleForAddress(kPid1, t05, 0x20000010, &memo,
+                                        &module));
+  EXPECT_NE(generation, memo.generation);
+  EXPECT_STREQ(L"bar.dll", module.image_file_name.c_str());
+  EXPECT_EQ(t05, memo.from);
+}
+
+TEST(ModuleCacheTest, ProcessEnded) {
+  ModuleCache cache;
+
+  ModuleInformation mod1 = { 0 };
+  mod1.base_address = 0x10000000;
+  mod1.module_size = 0x1000;
+  mod1.image_file_name = L"foo.dll";
+  ModuleInformation mod2 = { 0 };
+  mod2.base_address = 0x20000000;
+  mod2.module_size = 0x1000;
+  mod2.image_file_name = L"bar.dll";
+  ModuleInformation mod3 = { 0 };
+  mod3.base_address = 0x30000000;
+  mod3.module_size = 0x1000;
+  mod3.image_file_name = L"baz.dll";
+  base::Time t0(base::Time::Now());
+  base::Time t1(t0 + base::TimeDelta::FromMilliseconds(10));
+  base::Time t2(t0 + base::TimeDelta::FromMilliseconds(20));
+  base::Time t3(t0 + base::TimeDelta::FromMilliseconds(30));
+  const ProcessId kPid2 = kPid1 + 1;
+
+  // The loads at t0 go through states no entry ends up referring to.
+  cache.ModuleLoaded(kPid1, t0, mod1);
+  cache.ModuleLoaded(kPid1, t0, mod2);
+  cache.ModuleLoaded(kPid1, t0, mod3);
+  cache.ModuleUnloaded(kPid1, t1, mod3);
+  cache.ModuleLoaded(kPid2, t0, mod3);
+  EXPECT_EQ(4U, cache.num_module_load_states());
+
+  ModuleCache::ModuleLoadStateId id0 = cache.GetStateId(kPid1, t0);
+  ModuleCache::ModuleLoadStateId id1 = cache.GetStateId(kPid1, t1);
+  ModuleCache::ModuleLoadStateId id2 = cache.GetStateId(kPid2, t0);
+
+  // Ending the process drops its states but those it ended up with, and
+  // the lookups stay the same.
+  ModuleCache::StateIdMemo memo;
+  cache.GetStateId(kPid1, t0, &memo);
+  int generation = memo.generation;
+  cache.ProcessEnded(kPid1, t2);
+  EXPECT_EQ(id0, cache.GetStateId(kPid1, t0, &memo));
+  EXPECT_NE(generation, memo.generation);
+  EXPECT_EQ(3U, cache.num_module_load_states());
+  EXPECT_EQ(id0, cache.GetStateId(kPid1, t0));
+  EXPECT_EQ(id1, cache.GetStateId(kPid1, t1));
+  EXPECT_EQ(id1, cache.GetStateId(kPid1, t2));
+  EXPECT_EQ(id2, cache.GetStateId(kPid2, t0));
+
+  ModuleInformation module;
+  EXPECT_TRUE(cache.GetModuleForAddress(kPid1, t0, 0x30000000, &memo,
+                                        &module));
+  EXPECT_STREQ(L"baz.dll", module.image_file_name.c_str());
+  EXPECT_EQ(t0, memo.from);
+  EXPECT_EQ(t1, memo.until);
+  EXPECT_FALSE(cache.GetModuleForAddress(kPid1, t1, 0x30000000, &memo,
+                                         &module));
+  EXPECT_EQ(t1, memo.from);
+  EXPECT_TRUE(cache.GetModuleForAddress(kPid1, t1, 0x20000000, &memo,
+                                        &module));
+  EXPECT_STREQ(L"bar.dll", module.image_file_name.c_str());
+  EXPECT_EQ(cache.GetStateId(kPid2 + 1, t0),
+            cache.GetStateId(kPid1, t0 - base::TimeDelta::FromSeconds(1)));
+
+  // A reused pid's entries follow the ended process's history.
+  cache.ModuleUnloaded(kPid1, t3, mod1);
+  std::vector<ModuleInformation> modules;
+  ASSERT_TRUE(cache.GetProcessModuleState(kPid1, t3, &modules));
+  ASSERT_EQ(1U, modules.size());
+  EXPECT_STREQ(L"bar.dll", modules[0].image_file_name.c_str());
+  EXPECT_EQ(id1, cache.GetStateId(kPid1, t2));
+  EXPECT_EQ(id0, cache.GetStateId(kPid1, t0, &memo));
+  EXPECT_EQ(t1, memo.until);
+  EXPECT_EQ(id1, cache.GetStateId(kPid1, t2, &memo));
+  EXPECT_EQ(t3, memo.until);
+
+  // The dropped states are rebuilt when a process goes through them.
+  cache.ModuleLoaded(kPid2, t1, mod1);
+  ASSERT_TRUE(cache.GetProcessModuleState(kPid2, t1, &modules));
+  ASSERT_EQ(2U, modules.size());
+  EXPECT_STREQ(L"foo.dll", modules[0].image_file_name.c_str());
+  EXPECT_STREQ(L"baz.dll", modules[1].image_file_name.c_str());
+}
+
+TEST(ModuleCacheTest, GetModuleForAddressMany) {
+  ModuleCache cache;
+  base::Time t0(base::Time::Now());
+
+  // Load modules in no particular order, with gaps between them.
+  const int kNumModules = 100;
+  for (int i = 0; i < kNumModules; ++i) {
+    int slot = (i * 37) % kNumModules;
+    ModuleInformation mod = { 0 };
+    mod.base_address = 0x10000000 + slot * 0x10000;
+    mod.module_size = 0x8000;
+    mod.time_date_stamp = slot;
+    cache.ModuleLoaded(kPid1, t0, mod);
+  }
+
+  ModuleInformation module;
+  for (int slot = 0; slot < kNumModules; ++slot) {
+    Address base = 0x10000000 + slot * 0x10000;
+    ASSERT_TRUE(cache.GetModuleForAddress(kPid1, t0, base + 0x7FFF, &module));
+    EXPECT_EQ(slot, module.time_date_stamp);
+    EXPECT_FALSE(cache.GetModuleForAddress(kPid1, t0, base + 0x8000,
+                                           &module));
+  }
+}
+
+TEST(ModuleCacheTest, GetModuleForAddressOverlapping) {
+  ModuleCache cache;
+  base::Time t0(base::Time::Now());
+
+  // A large module that a missed unload left around, and a small one
+  // within it.
+  ModuleInformation large = { 0 };
+  large.base_address = 0x10000000;
+  large.module_size = 0x100000;
+  large.image_file_name = L"large.dll";
+  cache.ModuleLoaded(kPid1, t0, large);
+
+  ModuleInformation small = { 0 };
+  small.base_address = 0x10010000;
+  small.module_size = 0x1000;
+  small.image_file_name = L"small.dll";
+  cache.ModuleLoaded(kPid1, t0, small);
+
+  ModuleInformation module;
+  ASSERT_TRUE(cache.GetModuleForAddress(kPid1, t0, 0x10010010, &module));
+  EXPECT_STREQ(L"small.dll", module.image_file_name.c_str());
+
+  // Past the small module, the large one still contains the address.
+  ASSERT_TRUE(cache.GetModuleForAddress(kPid1, t0, 0x10020000, &module));
+  EXPECT_STREQ(L"large.dll", module.image_file_name.c_str());
+  EXPECT_FALSE(cache.GetModuleForAddress(kPid1, t0, 0x10100000, &module));
+}
+
 }  //  namespace sym_util
 
 
@@ -0,0 +1,315 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Module symbol cache implementation.
+#include "sawbuck/sym_util/module_symbol_cache.h"
+
+#include <vector>
+#include "base/logging.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+#include "sawbuck/sym_util/missing_symbols_cache.h"
+#include "sawbuck/sym_util/symbol_cache.h"
+
+namespace sym_util {
+
+const uint64 ModuleSymbolCache::kDefaultMaxLoadedSize;
+
+struct ModuleSymbolCache::LoadedModule {
+  LoadedModule() : size(0), measured(false), local_only(false) {
+  }
+
+  SymbolCache cache;
+  // The memory the cache's symbols take, once measured.
+  uint64 size;
+  bool measured;
+  // True iff the cache loads from the local symbol path only.
+  bool local_only;
+};
+
+ModuleSymbolCache::ModuleIdentity::ModuleIdentity(
+    const ModuleInformation& module)
+    : module_size(module.module_size),
+      image_checksum(module.image_checksum),
+      time_date_stamp(module.time_date_stamp),
+      image_file_name(module.image_file_name) {
+}
+
+bool ModuleSymbolCache::ModuleIdentity::operator<(
+    const ModuleIdentity& o) const {
+  if (module_size != o.module_size)
+    return module_size < o.module_size;
+  if (image_checksum != o.image_checksum)
+    return image_checksum < o.image_checksum;
+  if (time_date_stamp != o.time_date_stamp)
+    return time_date_stamp < o.time_date_stamp;
+  return image_file_name < o.image_file_name;
+}
+
+ModuleSymbolCache::ModuleSymbolCache(SymbolStringTable* strings)
+    : strings_(strings),
+      loaded_modules_(LoadedModuleCache::NO_AUTO_EVICT),
+      loaded_size_(0),
+      max_loaded_size_(kDefaultMaxLoadedSize),
+      missing_symbols_(NULL) {
+  DCHECK(strings_ != NULL);
+}
+
+ModuleSymbolCache::~ModuleSymbolCache() {
+}
+
+bool ModuleSymbolCache::GetSymbolForAddress(const ModuleInformation& module,
+                                            Address address,
+                                            SymbolLevel level,
+                                            SymbolRecord* symbol) {
+  DCHECK(symbol != NULL);
+  DCHECK_LE(module.base_address, address);
+  DCHECK_GT(module.base_address + module.module_size, address);
+  uint32 rva = static_cast<uint32>(address - module.base_address);
+
+  ModuleSymbols& symbols = GetModuleSymbols(module);
+  std::map<uint32, SymbolRecord>::iterator found(symbols.symbols.find(rva));
+  if (found != symbols.symbols.end() && found->second.level >= level) {
+    ++stats_.hits;
+    *symbol = found->second;
+  } else {
+    if (symbols.failures.find(rva) != symbols.failures.end()) {
+      ++stats_.failure_hits;
+      return false;
+    }
+
+    // Resolve at the same RVA in the module where we first saw it.
+    Symbol resolved;
+    if (!ResolveSymbol(symbols.module, symbols.module.base_address + rva,
+                       level, &resolved)) {
+      // What we have at a lower level is still good.
+      if (found != symbols.symbols.end()) {
+        *symbol = found->second;
+      } else {
+        ++stats_.failed;
+        symbols.failures.insert(rva);
+        return false;
+      }
+    } else {
+      ++stats_.resolved;
+      strings_->Intern(resolved, symbol);
+      if (found != symbols.symbols.end())
+        found->second = *symbol;
+      else
+        symbols.symbols.insert(std::make_pair(rva, *symbol));
+    }
+  }
+
+  symbol->module = symbols.module_name;
+  symbol->module_base = module.base_address;
+  return true;
+}
+
+void ModuleSymbolCache::AddSymbol(const ModuleInformation& module,
+                                  Address address,
+                                  const SymbolRecord& symbol) {
+  DCHECK_LE(module.base_address, address);
+  DCHECK_GT(module.base_address + module.module_size, address);
+  uint32 rva = static_cast<uint32>(address - module.base_address);
+
+  std::map<uint32, SymbolRecord>& symbols = GetModuleSymbols(module).symbols;
+  std::map<uint32, SymbolRecord>::iterator found(symbols.find(rva));
+  if (found == symbols.end())
+    symbols.insert(std::make_pair(rva, symbol));
+  else if (found->second.level < symbol.level)
+    found->second = symbol;
+}
+
+bool ModuleSymbolCache::IsCached(const ModuleInformation& module,
+                                 Address address,
+                                 SymbolLevel level) const {
+  DCHECK_LE(module.base_address, address);
+  DCHECK_GT(module.base_address + module.module_size, address);
+  uint32 rva = static_cast<uint32>(address - module.base_address);
+
+  ModuleSymbolsMap::const_iterator it(modules_.find(ModuleIdentity(module)));
+  if (it == modules_.end())
+    return false;
+
+  std::map<uint32, SymbolRecord>::const_iterator found(
+      it->second.symbols.find(rva));
+  if (found != it->second.symbols.end())
+    return found->second.level >= level;
+  return it->second.failures.find(rva) != it->second.failures.end();
+}
+
+bool ModuleSymbolCache::CanResolveWithoutLoading(
+    const ModuleInformation& module,
+    Address address,
+    SymbolLevel level) const {
+  return IsCached(module, address, level) ||
+      loaded_modules_.Peek(ModuleIdentity(module)) != loaded_modules_.end() ||
+      IsMissingSymbols(module);
+}
+
+bool ModuleSymbolCache::IsMissingSymbols(
+    const ModuleInformation& module) const {
+  // There's nothing to skip on a path without symbol servers.
+  return missing_symbols_ != NULL && local_symbol_path_ != symbol_path_ &&
+      missing_symbols_->IsMissing(module, base::Time::Now());
+}
+
+ModuleSymbolCache::ModuleSymbols& ModuleSymbolCache::GetModuleSymbols(
+    const ModuleInformation& module) {
+  ModuleIdentity identity(module);
+  ModuleSymbolsMap::iterator it(modules_.find(identity));
+  if (it == modules_.end()) {
+    it = modules_.insert(std::make_pair(identity, ModuleSymbols())).first;
+    it->second.module = module;
+    it->second.module_name = strings_->Intern(module.image_file_name);
+  }
+  return it->second;
+}
+
+void ModuleSymbolCache::SetSymbolPath(const wchar_t* symbol_path) {
+  symbol_path_ = symbol_path != NULL ? symbol_path : L"";
+  local_symbol_path_ = GetLocalSymbolPath(symbol_path_);
+  if (missing_symbols_ != NULL)
+    missing_symbols_->SetSymbolPath(symbol_path_);
+
+  // The loaded modules go, to be loaded afresh from the new path, and
+  // the failures get another go.
+  loaded_modules_.Clear();
+  loaded_size_ = 0;
+  ModuleSymbolsMap::iterator it(modules_.begin());
+  for (; it != modules_.end(); ++it)
+    it->second.failures.clear();
+}
+
+void ModuleSymbolCache::set_missing_symbols_cache(
+    MissingSymbolsCache* missing_symbols) {
+  missing_symbols_ = missing_symbols;
+  if (missing_symbols_ != NULL)
+    missing_symbols_->SetSymbolPath(symbol_path_);
+}
+
+std::wstring ModuleSymbolCache::GetLocalSymbolPath(
+    const std::wstring& symbol_path) {
+  std::vector<std::wstring> elements;
+  base::SplitString(symbol_path, L';', &elements);
+
+  std::wstring local_path;
+  for (size_t i = 0; i < elements.size(); ++i) {
+    const std::wstring& element = elements[i];
+    if (element.empty() ||
+        StartsWith(element, L"srv*", false) ||
+        StartsWith(element, L"symsrv*", false)) {
+      continue;
+    }
+
+    if (!local_path.empty())
+      local_path.append(1, L';');
+    local_path.append(element);
+  }
+
+  return local_path;
+}
+
+void ModuleSymbolCache::set_max_loaded_size(uint64 max_loaded_size) {
+  max_loaded_size_ = max_loaded_size;
+  EvictLoadedModules();
+}
+
+uint64 ModuleSymbolCache::UnloadLeastRecentlyUsed(uint64 bytes) {
+  uint64 freed = 0;
+  while (freed < bytes && loaded_modules_.size() > 1)
+    freed += UnloadOldestModule();
+
+  return freed;
+}
+
+bool ModuleSymbolCache::ResolveSymbol(const ModuleInformation& module,
+                                      Address address,
+                                      SymbolLevel level,
+                                      Symbol* symbol) {
+  // Find the module's symbol cache, which makes it the most recently used.
+  ModuleIdentity identity(module);
+  LoadedModuleCache::iterator it(loaded_modules_.Get(identity));
+  if (it == loaded_modules_.end()) {
+    LoadedModule* loaded = new LoadedModule();
+    it = loaded_modules_.Put(identity, loaded);
+    loaded->cache.set_status_callback(status_callback_);
+    loaded->local_only = IsMissingSymbols(module);
+    if (loaded->local_only) {
+      ++stats_.modules_missing;
+      loaded->cache.SetSymbolPath(local_symbol_path_.c_str());
+    } else {
+      loaded->cache.SetSymbolPath(symbol_path_.c_str());
+    }
+    ModuleInformation module_copy(module);
+    loaded->cache.Initialize(1, &module_copy);
+  }
+
+  LoadedModule* loaded = it->second;
+  base::TimeTicks start;
+  if (!loaded->measured)
+    start = base::TimeTicks::Now();
+  bool ret = loaded->cache.GetSymbolForAddress(address, level, symbol);
+
+  // Symbols load on the first lookup, which is when we can price them.
+  if (!loaded->measured) {
+    ++stats_.modules_loaded;
+    stats_.load_time += base::TimeTicks::Now() - start;
+
+    loaded->size = GetLoadedSize(&loaded->cache);
+    loaded->measured = true;
+
+    // Spare the sessions to come asking the servers for symbols that
+    // aren't there.
+    if (missing_symbols_ != NULL && !loaded->local_only &&
+        local_symbol_path_ != symbol_path_ &&
+        !HasSymbols(&loaded->cache, module)) {
+      missing_symbols_->AddMissing(module, base::Time::Now());
+    }
+    loaded_size_ += loaded->size;
+    EvictLoadedModules();
+  }
+
+  return ret;
+}
+
+uint64 ModuleSymbolCache::GetLoadedSize(SymbolCache* cache) {
+  DCHECK(cache != NULL);
+  return cache->GetLoadedSymbolsSize();
+}
+
+bool ModuleSymbolCache::HasSymbols(SymbolCache* cache,
+                                   const ModuleInformation& module) {
+  DCHECK(cache != NULL);
+  return cache->HasSymbols(module.base_address);
+}
+
+void ModuleSymbolCache::EvictLoadedModules() {
+  while (loaded_size_ > max_loaded_size_ && loaded_modules_.size() > 1)
+    UnloadOldestModule();
+}
+
+uint64 ModuleSymbolCache::UnloadOldestModule() {
+  DCHECK_LT(1U, loaded_modules_.size());
+
+  LoadedModuleCache::reverse_iterator oldest(loaded_modules_.rbegin());
+  uint64 size = oldest->second->size;
+  DCHECK_LE(size, loaded_size_);
+  loaded_size_ -= size;
+  loaded_modules_.Erase(oldest);
+
+  return size;
+}
+
+}  // namespace sym_util
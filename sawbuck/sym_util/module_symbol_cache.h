@@ -0,0 +1,224 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Module symbol cache declaration.
+#ifndef SAWBUCK_SYM_UTIL_MODULE_SYMBOL_CACHE_H_
+#define SAWBUCK_SYM_UTIL_MODULE_SYMBOL_CACHE_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/containers/mru_cache.h"
+#include "base/time/time.h"
+#include "sawbuck/sym_util/symbol_string_table.h"
+#include "sawbuck/sym_util/types.h"
+
+namespace sym_util {
+
+class MissingSymbolsCache;
+class SymbolCache;
+
+// Caches symbols by module identity and RVA, rather than by address, so a
+// module that's loaded in many processes, at as many bases, is resolved
+// once for all of them. Misses are resolved with a symbol cache per
+// module, which loads that module alone, and of which we keep a few.
+// The address space of a process only serves to find the module and RVA
+// of an address, which is up to the caller.
+class ModuleSymbolCache {
+ public:
+  // @param strings interns the strings of the symbols we hand out, must
+  //     outlive this instance.
+  explicit ModuleSymbolCache(SymbolStringTable* strings);
+  virtual ~ModuleSymbolCache();
+
+  typedef base::Callback<void(const wchar_t*)> StatusCallback;
+  void set_status_callback(const StatusCallback& status_callback) {
+    status_callback_ = status_callback;
+  }
+
+  // Retrieves the symbol at @p address in @p module, at least to @p level.
+  // A symbol we have at a lower level is resolved further, and kept so.
+  // On success, the symbol's module name and base are those of @p module.
+  // @pre @p address is within @p module.
+  // @returns true on success.
+  bool GetSymbolForAddress(const ModuleInformation& module,
+                           Address address,
+                           SymbolLevel level,
+                           SymbolRecord* symbol);
+
+  // Adds @p symbol at @p address in @p module, as resolved elsewhere,
+  // unless we have a symbol there already, at the same level or above.
+  // @pre @p address is within @p module, and the strings of @p symbol
+  //     are interned in our string table.
+  void AddSymbol(const ModuleInformation& module,
+                 Address address,
+                 const SymbolRecord& symbol);
+
+  // @returns true iff we know the symbol at @p address in @p module to
+  //     @p level, or that it fails to resolve.
+  // @pre @p address is within @p module.
+  bool IsCached(const ModuleInformation& module,
+                Address address,
+                SymbolLevel level) const;
+
+  // @returns true iff the symbol at @p address in @p module can be had to
+  //     @p level without loading, and possibly downloading, the module's
+  //     symbols.
+  // @pre @p address is within @p module.
+  bool CanResolveWithoutLoading(const ModuleInformation& module,
+                                Address address,
+                                SymbolLevel level) const;
+
+  // Sets a new symbol path, which sends the addresses that failed to
+  // resolve back for another try.
+  void SetSymbolPath(const wchar_t* symbol_path);
+
+  // Sets the cache of the modules the symbol path has no symbols for. The
+  // symbol servers aren't asked for the symbols of those, which then load
+  // from the local elements of the path alone, and are cheap to resolve.
+  // @param missing_symbols must outlive its use, may be NULL.
+  void set_missing_symbols_cache(MissingSymbolsCache* missing_symbols);
+
+  // @returns @p symbol_path without its symbol server elements, e.g.
+  //     "srv*c:\symbols*http://msdl.microsoft.com/download/symbols".
+  static std::wstring GetLocalSymbolPath(const std::wstring& symbol_path);
+
+  // Sets the most memory the loaded symbols may take, in bytes. The least
+  // recently used modules are unloaded to stay within it, though the most
+  // recently used one stays loaded regardless.
+  void set_max_loaded_size(uint64 max_loaded_size);
+  uint64 max_loaded_size() const { return max_loaded_size_; }
+
+  // @returns the memory the loaded symbols take, in bytes.
+  uint64 loaded_size() const { return loaded_size_; }
+
+  // Unloads the least recently used modules until they free @p bytes, or
+  // only the most recently used one is left, e.g. when memory runs short.
+  // @returns the bytes freed.
+  uint64 UnloadLeastRecentlyUsed(uint64 bytes);
+
+  // The default of max_loaded_size.
+  static const uint64 kDefaultMaxLoadedSize = 512 * 1024 * 1024;
+
+  // Tallies of how our lookups were served, to measure the caching by.
+  struct Stats {
+    Stats() : hits(0), failure_hits(0), resolved(0), failed(0),
+        modules_loaded(0), modules_missing(0) {
+    }
+
+    // Lookups of symbols we had, and of those we knew to fail.
+    size_t hits;
+    size_t failure_hits;
+    // Lookups that went to the symbols of a module, by outcome.
+    size_t resolved;
+    size_t failed;
+    // The modules whose symbols we loaded, and the time the loading took,
+    // which is the time of the first lookup in each.
+    size_t modules_loaded;
+    base::TimeDelta load_time;
+    // The modules loaded without asking the symbol servers, as they were
+    // known to have no symbols there.
+    size_t modules_missing;
+  };
+  const Stats& stats() const { return stats_; }
+
+ protected:
+  // Resolves @p address in @p module to @p level with a symbol cache for
+  // the module.
+  // @note virtual to allow testing.
+  virtual bool ResolveSymbol(const ModuleInformation& module,
+                             Address address,
+                             SymbolLevel level,
+                             Symbol* symbol);
+
+  // @returns the memory the symbols loaded in @p cache take, in bytes.
+  // @note virtual to allow testing.
+  virtual uint64 GetLoadedSize(SymbolCache* cache);
+
+  // @returns true iff @p cache found symbols for @p module, rather than
+  //     making do with its exports.
+  // @note virtual to allow testing.
+  virtual bool HasSymbols(SymbolCache* cache, const ModuleInformation& module);
+
+ private:
+  // The identity of a module, wherever it's loaded.
+  struct ModuleIdentity {
+    explicit ModuleIdentity(const ModuleInformation& module);
+    bool operator<(const ModuleIdentity& o) const;
+
+    ModuleSize module_size;
+    ModuleChecksum image_checksum;
+    ModuleTimeDateStamp time_date_stamp;
+    std::wstring image_file_name;
+  };
+
+  // What we know of the symbols of a module, by RVA.
+  struct ModuleSymbols {
+    // The module as first seen, where its symbol cache loads it.
+    ModuleInformation module;
+    // The module's name, interned.
+    const std::wstring* module_name;
+    std::map<uint32, SymbolRecord> symbols;
+    // The RVAs that failed to resolve.
+    std::set<uint32> failures;
+  };
+  typedef std::map<ModuleIdentity, ModuleSymbols> ModuleSymbolsMap;
+  ModuleSymbolsMap modules_;
+
+  // @returns what we know of the symbols of @p module.
+  ModuleSymbols& GetModuleSymbols(const ModuleInformation& module);
+
+  SymbolStringTable* strings_;
+
+  // A symbol cache loaded with a single module.
+  struct LoadedModule;
+  // The loaded modules, most recently used first.
+  typedef base::OwningMRUCache<ModuleIdentity, LoadedModule*>
+      LoadedModuleCache;
+  LoadedModuleCache loaded_modules_;
+
+  // Unloads the least recently used modules until the rest fit in
+  // max_loaded_size_, or only one is left.
+  void EvictLoadedModules();
+  // Unloads the least recently used module.
+  // @returns the bytes freed.
+  // @pre more than one module is loaded.
+  uint64 UnloadOldestModule();
+
+  // The memory the loaded modules take, and the most they may.
+  uint64 loaded_size_;
+  uint64 max_loaded_size_;
+
+  // @returns true iff @p module is known to have no symbols on the symbol
+  //     path, so that the symbol servers needn't be asked.
+  bool IsMissingSymbols(const ModuleInformation& module) const;
+
+  // Our symbol path, and its local elements.
+  std::wstring symbol_path_;
+  std::wstring local_symbol_path_;
+  StatusCallback status_callback_;
+
+  // The modules without symbols, if any.
+  MissingSymbolsCache* missing_symbols_;
+
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(ModuleSymbolCache);
+};
+
+}  // namespace sym_util
+
+#endif  // SAWBUCK_SYM_UTIL_MODULE_SYMBOL_CACHE_H_
@@ -0,0 +1,399 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Module symbol cache unittests.
+#include "sawbuck/sym_util/module_symbol_cache.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "sawbuck/sym_util/missing_symbols_cache.h"
+
+namespace sym_util {
+
+namespace {
+
+using testing::_;
+using testing::DoAll;
+using testing::Invoke;
+using testing::Return;
+using testing::SetArgPointee;
+
+class TestModuleSymbolCache : public ModuleSymbolCache {
+ public:
+  TestModuleSymbolCache() : ModuleSymbolCache(&strings_) {
+  }
+
+  MOCK_METHOD4(ResolveSymbol, bool(const ModuleInformation& module,
+                                   Address address,
+                                   SymbolLevel level,
+                                   Symbol* symbol));
+  MOCK_METHOD1(GetLoadedSize, uint64(SymbolCache* cache));
+  MOCK_METHOD2(HasSymbols, bool(SymbolCache* cache,
+                                const ModuleInformation& module));
+
+  // Resolves with a real symbol cache, to exercise the loaded modules.
+  bool LoadAndResolveSymbol(const ModuleInformation& module,
+                            Address address,
+                            SymbolLevel level,
+                            Symbol* symbol) {
+    return ModuleSymbolCache::ResolveSymbol(module, address, level, symbol);
+  }
+
+ private:
+  SymbolStringTable strings_;
+};
+
+ModuleInformation MakeModule(ModuleBase base) {
+  ModuleInformation module = {};
+  module.base_address = base;
+  module.module_size = 0x100000;
+  module.image_checksum = 0xCAFE;
+  module.time_date_stamp = 0x4D2;
+  module.image_file_name = L"c:\\chrome\\chrome.dll";
+  return module;
+}
+
+Symbol MakeSymbol(const wchar_t* name) {
+  Symbol symbol;
+  symbol.module = L"as loaded";
+  symbol.module_base = 0x10000000;
+  symbol.name = name;
+  symbol.offset = 4;
+  symbol.size = 16;
+  symbol.line = 10;
+  return symbol;
+}
+
+}  // namespace
+
+TEST(ModuleSymbolCacheTest, SharesAcrossBases) {
+  testing::StrictMock<TestModuleSymbolCache> cache;
+  ModuleInformation first(MakeModule(0x10000000));
+  ModuleInformation second(MakeModule(0x30000000));
+
+  // The first sighting resolves, in the module as first seen.
+  EXPECT_CALL(cache, ResolveSymbol(first, 0x10000100, _, _))
+      .WillOnce(DoAll(SetArgPointee<3>(MakeSymbol(L"Foo")), Return(true)));
+  SymbolRecord symbol;
+  ASSERT_TRUE(cache.GetSymbolForAddress(first, 0x10000100,
+                                        SYMBOL_ALL, &symbol));
+  EXPECT_EQ(L"Foo", *symbol.name);
+  EXPECT_EQ(first.image_file_name, *symbol.module);
+  EXPECT_EQ(first.base_address, symbol.module_base);
+
+  // The same RVA in the same module elsewhere hits, with the module and
+  // base it was looked up in.
+  ASSERT_TRUE(cache.GetSymbolForAddress(second, 0x30000100,
+                                        SYMBOL_ALL, &symbol));
+  EXPECT_EQ(L"Foo", *symbol.name);
+  EXPECT_EQ(4U, symbol.offset);
+  EXPECT_EQ(second.base_address, symbol.module_base);
+  ASSERT_TRUE(cache.GetSymbolForAddress(first, 0x10000100,
+                                        SYMBOL_ALL, &symbol));
+
+  // Another RVA in the second module still resolves in the first.
+  EXPECT_CALL(cache, ResolveSymbol(first, 0x10000200, _, _))
+      .WillOnce(DoAll(SetArgPointee<3>(MakeSymbol(L"Bar")), Return(true)));
+  ASSERT_TRUE(cache.GetSymbolForAddress(second, 0x30000200,
+                                        SYMBOL_ALL, &symbol));
+  EXPECT_EQ(L"Bar", *symbol.name);
+  EXPECT_EQ(second.base_address, symbol.module_base);
+}
+
+TEST(ModuleSymbolCacheTest, CountsLookups) {
+  testing::StrictMock<TestModuleSymbolCache> cache;
+  ModuleInformation module(MakeModule(0x10000000));
+
+  EXPECT_CALL(cache, ResolveSymbol(module, 0x10000100, _, _))
+      .WillOnce(DoAll(SetArgPointee<3>(MakeSymbol(L"Foo")), Return(true)));
+  EXPECT_CALL(cache, ResolveSymbol(module, 0x10000200, _, _))
+      .WillOnce(Return(false));
+  SymbolRecord symbol;
+  ASSERT_TRUE(cache.GetSymbolForAddress(module, 0x10000100,
+                                        SYMBOL_ALL, &symbol));
+  ASSERT_TRUE(cache.GetSymbolForAddress(module, 0x10000100,
+                                        SYMBOL_ALL, &symbol));
+  ASSERT_TRUE(cache.GetSymbolForAddress(module, 0x10000100,
+                                        SYMBOL_ALL, &symbol));
+  EXPECT_FALSE(cache.GetSymbolForAddress(module, 0x10000200,
+                                         SYMBOL_ALL, &symbol));
+  EXPECT_FALSE(cache.GetSymbolForAddress(module, 0x10000200,
+                                         SYMBOL_ALL, &symbol));
+
+  const ModuleSymbolCache::Stats& stats = cache.stats();
+  EXPECT_EQ(2U, stats.hits);
+  EXPECT_EQ(1U, stats.failure_hits);
+  EXPECT_EQ(1U, stats.resolved);
+  EXPECT_EQ(1U, stats.failed);
+  // The mock resolves without loading anything.
+  EXPECT_EQ(0U, stats.modules_loaded);
+}
+
+TEST(ModuleSymbolCacheTest, UpgradesLevels) {
+  testing::StrictMock<TestModuleSymbolCache> cache;
+  ModuleInformation module(MakeModule(0x10000000));
+
+  Symbol function(MakeSymbol(L"Foo"));
+  function.line = 0;
+  function.level = SYMBOL_FUNCTION;
+  EXPECT_CALL(cache, ResolveSymbol(module, 0x10000100, SYMBOL_FUNCTION, _))
+      .WillOnce(DoAll(SetArgPointee<3>(function), Return(true)));
+  SymbolRecord symbol;
+  ASSERT_TRUE(cache.GetSymbolForAddress(module, 0x10000100, SYMBOL_FUNCTION,
+                                        &symbol));
+  EXPECT_EQ(SYMBOL_FUNCTION, symbol.level);
+  EXPECT_TRUE(cache.IsCached(module, 0x10000100, SYMBOL_FUNCTION));
+  EXPECT_FALSE(cache.IsCached(module, 0x10000100, SYMBOL_LINE));
+
+  // Asking for more goes back to the module's symbols, once.
+  Symbol line(MakeSymbol(L"Foo"));
+  line.level = SYMBOL_LINE;
+  EXPECT_CALL(cache, ResolveSymbol(module, 0x10000100, SYMBOL_LINE, _))
+      .WillOnce(DoAll(SetArgPointee<3>(line), Return(true)));
+  ASSERT_TRUE(cache.GetSymbolForAddress(module, 0x10000100, SYMBOL_LINE,
+                                        &symbol));
+  EXPECT_EQ(10U, symbol.line);
+  ASSERT_TRUE(cache.GetSymbolForAddress(module, 0x10000100, SYMBOL_FUNCTION,
+                                        &symbol));
+  EXPECT_EQ(SYMBOL_LINE, symbol.level);
+  EXPECT_TRUE(cache.IsCached(module, 0x10000100, SYMBOL_LINE));
+
+  // Failing to resolve further leaves what we had.
+  EXPECT_CALL(cache, ResolveSymbol(module, 0x10000100, SYMBOL_ALL, _))
+      .WillOnce(Return(false));
+  ASSERT_TRUE(cache.GetSymbolForAddress(module, 0x10000100, SYMBOL_ALL,
+                                        &symbol));
+  EXPECT_EQ(L"Foo", *symbol.name);
+  EXPECT_EQ(SYMBOL_LINE, symbol.level);
+  EXPECT_EQ(1U, cache.stats().hits);
+  EXPECT_EQ(2U, cache.stats().resolved);
+  EXPECT_EQ(0U, cache.stats().failed);
+}
+
+TEST(ModuleSymbolCacheTest, DistinguishesBuilds) {
+  testing::StrictMock<TestModuleSymbolCache> cache;
+  ModuleInformation module(MakeModule(0x10000000));
+  ModuleInformation rebuilt(module);
+  rebuilt.time_date_stamp++;
+
+  EXPECT_CALL(cache, ResolveSymbol(module, _, _, _))
+      .WillOnce(DoAll(SetArgPointee<3>(MakeSymbol(L"Foo")), Return(true)));
+  EXPECT_CALL(cache, ResolveSymbol(rebuilt, _, _, _))
+      .WillOnce(DoAll(SetArgPointee<3>(MakeSymbol(L"Bar")), Return(true)));
+
+  SymbolRecord symbol;
+  ASSERT_TRUE(cache.GetSymbolForAddress(module, 0x10000100,
+                                        SYMBOL_ALL, &symbol));
+  EXPECT_EQ(L"Foo", *symbol.name);
+  ASSERT_TRUE(cache.GetSymbolForAddress(rebuilt, 0x10000100,
+                                        SYMBOL_ALL, &symbol));
+  EXPECT_EQ(L"Bar", *symbol.name);
+}
+
+TEST(ModuleSymbolCacheTest, RemembersFailures) {
+  testing::StrictMock<TestModuleSymbolCache> cache;
+  ModuleInformation module(MakeModule(0x10000000));
+
+  EXPECT_CALL(cache, ResolveSymbol(module, 0x10000100, _, _))
+      .WillOnce(Return(false));
+  SymbolRecord symbol;
+  EXPECT_FALSE(cache.GetSymbolForAddress(module, 0x10000100,
+                                         SYMBOL_ALL, &symbol));
+  EXPECT_FALSE(cache.GetSymbolForAddress(module, 0x10000100,
+                                         SYMBOL_ALL, &symbol));
+
+  // A new symbol path gives failures another go.
+  cache.SetSymbolPath(L"c:\\symbols");
+  EXPECT_CALL(cache, ResolveSymbol(module, 0x10000100, _, _))
+      .WillOnce(DoAll(SetArgPointee<3>(MakeSymbol(L"Foo")), Return(true)));
+  ASSERT_TRUE(cache.GetSymbolForAddress(module, 0x10000100,
+                                        SYMBOL_ALL, &symbol));
+  EXPECT_EQ(L"Foo", *symbol.name);
+}
+
+TEST(ModuleSymbolCacheTest, AddSymbol) {
+  testing::StrictMock<TestModuleSymbolCache> cache;
+  ModuleInformation module(MakeModule(0x10000000));
+  ModuleInformation elsewhere(MakeModule(0x30000000));
+
+  SymbolStringTable strings;
+  SymbolRecord added;
+  strings.Intern(MakeSymbol(L"Foo"), &added);
+  cache.AddSymbol(module, 0x10000100, added);
+  EXPECT_TRUE(cache.CanResolveWithoutLoading(elsewhere, 0x30000100,
+                                             SYMBOL_ALL));
+
+  // The added symbol hits without resolving, with the lookup's module.
+  SymbolRecord symbol;
+  ASSERT_TRUE(cache.GetSymbolForAddress(elsewhere, 0x30000100,
+                                        SYMBOL_ALL, &symbol));
+  EXPECT_EQ(added.name, symbol.name);
+  EXPECT_EQ(elsewhere.image_file_name, *symbol.module);
+  EXPECT_EQ(elsewhere.base_address, symbol.module_base);
+}
+
+TEST(ModuleSymbolCacheTest, CanResolveWithoutLoading) {
+  testing::StrictMock<TestModuleSymbolCache> cache;
+  ModuleInformation module(MakeModule(0x10000000));
+  ModuleInformation elsewhere(MakeModule(0x30000000));
+
+  EXPECT_FALSE(cache.CanResolveWithoutLoading(module, 0x10000100, SYMBOL_ALL));
+
+  // Resolved and failed RVAs are known, wherever the module is.
+  EXPECT_CALL(cache, ResolveSymbol(module, 0x10000100, _, _))
+      .WillOnce(DoAll(SetArgPointee<3>(MakeSymbol(L"Foo")), Return(true)));
+  EXPECT_CALL(cache, ResolveSymbol(module, 0x10000200, _, _))
+      .WillOnce(Return(false));
+  SymbolRecord symbol;
+  ASSERT_TRUE(cache.GetSymbolForAddress(module, 0x10000100,
+                                        SYMBOL_ALL, &symbol));
+  EXPECT_FALSE(cache.GetSymbolForAddress(module, 0x10000200,
+                                         SYMBOL_ALL, &symbol));
+
+  EXPECT_TRUE(cache.CanResolveWithoutLoading(elsewhere, 0x30000100,
+                                             SYMBOL_ALL));
+  EXPECT_TRUE(cache.CanResolveWithoutLoading(elsewhere, 0x30000200,
+                                             SYMBOL_ALL));
+  // The mock loads no symbols, so other RVAs would need loading.
+  EXPECT_FALSE(cache.CanResolveWithoutLoading(elsewhere, 0x30000300,
+                                              SYMBOL_ALL));
+}
+
+TEST(ModuleSymbolCacheTest, EvictsBySize) {
+  testing::NiceMock<TestModuleSymbolCache> cache;
+  ON_CALL(cache, ResolveSymbol(_, _, _, _))
+      .WillByDefault(Invoke(&cache,
+                            &TestModuleSymbolCache::LoadAndResolveSymbol));
+  EXPECT_CALL(cache, GetLoadedSize(_)).WillRepeatedly(Return(100));
+  cache.set_max_loaded_size(250);
+
+  ModuleInformation first(MakeModule(0x10000000));
+  ModuleInformation second(first);
+  second.time_date_stamp++;
+  ModuleInformation third(first);
+  third.time_date_stamp += 2;
+
+  SymbolRecord symbol;
+  cache.GetSymbolForAddress(first, 0x10000100, SYMBOL_ALL, &symbol);
+  cache.GetSymbolForAddress(second, 0x10000100, SYMBOL_ALL, &symbol);
+  EXPECT_EQ(200U, cache.loaded_size());
+
+  // Using the first makes the second the least recently used, so it goes
+  // to make room for the third.
+  cache.GetSymbolForAddress(first, 0x10000200, SYMBOL_ALL, &symbol);
+  cache.GetSymbolForAddress(third, 0x10000100, SYMBOL_ALL, &symbol);
+  EXPECT_EQ(200U, cache.loaded_size());
+  EXPECT_TRUE(cache.CanResolveWithoutLoading(first, 0x10000300, SYMBOL_ALL));
+  EXPECT_FALSE(cache.CanResolveWithoutLoading(second, 0x10000300, SYMBOL_ALL));
+  EXPECT_TRUE(cache.CanResolveWithoutLoading(third, 0x10000300, SYMBOL_ALL));
+
+  // The most recently used module stays, however large.
+  cache.set_max_loaded_size(0);
+  EXPECT_EQ(100U, cache.loaded_size());
+  EXPECT_TRUE(cache.CanResolveWithoutLoading(third, 0x10000300, SYMBOL_ALL));
+  EXPECT_FALSE(cache.CanResolveWithoutLoading(first, 0x10000300, SYMBOL_ALL));
+}
+
+TEST(ModuleSymbolCacheTest, UnloadLeastRecentlyUsed) {
+  testing::NiceMock<TestModuleSymbolCache> cache;
+  ON_CALL(cache, ResolveSymbol(_, _, _, _))
+      .WillByDefault(Invoke(&cache,
+                            &TestModuleSymbolCache::LoadAndResolveSymbol));
+  EXPECT_CALL(cache, GetLoadedSize(_)).WillRepeatedly(Return(100));
+
+  ModuleInformation first(MakeModule(0x10000000));
+  ModuleInformation second(first);
+  second.time_date_stamp++;
+  ModuleInformation third(first);
+  third.time_date_stamp += 2;
+
+  SymbolRecord symbol;
+  cache.GetSymbolForAddress(first, 0x10000100, SYMBOL_ALL, &symbol);
+  cache.GetSymbolForAddress(second, 0x10000100, SYMBOL_ALL, &symbol);
+  cache.GetSymbolForAddress(third, 0x10000100, SYMBOL_ALL, &symbol);
+  EXPECT_EQ(300U, cache.loaded_size());
+
+  // Whole modules go, so freeing a little unloads the oldest.
+  EXPECT_EQ(100U, cache.UnloadLeastRecentlyUsed(1));
+  EXPECT_EQ(200U, cache.loaded_size());
+  EXPECT_FALSE(cache.CanResolveWithoutLoading(first, 0x10000300, SYMBOL_ALL));
+
+  // The most recently used module stays, however much is asked for.
+  EXPECT_EQ(100U, cache.UnloadLeastRecentlyUsed(1000));
+  EXPECT_EQ(100U, cache.loaded_size());
+  EXPECT_TRUE(cache.CanResolveWithoutLoading(third, 0x10000300, SYMBOL_ALL));
+  EXPECT_EQ(0U, cache.UnloadLeastRecentlyUsed(1000));
+}
+
+TEST(ModuleSymbolCacheTest, GetLocalSymbolPath) {
+  EXPECT_EQ(L"c:\\symbols;d:\\build",
+            ModuleSymbolCache::GetLocalSymbolPath(
+                L"c:\\symbols;SRV*c:\\cache*http://symbols;d:\\build;"
+                L"symsrv*symsrv.dll*c:\\cache*http://other"));
+  EXPECT_EQ(L"", ModuleSymbolCache::GetLocalSymbolPath(
+                     L"srv*http://symbols"));
+}
+
+TEST(ModuleSymbolCacheTest, RemembersModulesWithoutSymbols) {
+  MissingSymbolsCache missing_symbols;
+  testing::NiceMock<TestModuleSymbolCache> cache;
+  ON_CALL(cache, ResolveSymbol(_, _, _, _))
+      .WillByDefault(Invoke(&cache,
+                            &TestModuleSymbolCache::LoadAndResolveSymbol));
+  cache.SetSymbolPath(L"srv*c:\\cache*http://symbols");
+  cache.set_missing_symbols_cache(&missing_symbols);
+
+  // A module the servers have no symbols for is noted.
+  ModuleInformation module(MakeModule(0x10000000));
+  EXPECT_FALSE(cache.CanResolveWithoutLoading(module, 0x10000100, SYMBOL_ALL));
+  EXPECT_CALL(cache, HasSymbols(_, module)).WillOnce(Return(false));
+  SymbolRecord symbol;
+  cache.GetSymbolForAddress(module, 0x10000100, SYMBOL_ALL, &symbol);
+  EXPECT_TRUE(missing_symbols.IsMissing(module, base::Time::Now()));
+  EXPECT_EQ(0U, cache.stats().modules_missing);
+
+  // So that after a new symbol path, which unloads it, the next session's
+  // worth of lookups don't have to wait on the servers.
+  cache.SetSymbolPath(L"srv*c:\\cache*http://symbols");
+  EXPECT_TRUE(cache.CanResolveWithoutLoading(module, 0x10000200, SYMBOL_ALL));
+  EXPECT_CALL(cache, HasSymbols(_, _)).Times(0);
+  cache.GetSymbolForAddress(module, 0x10000200, SYMBOL_ALL, &symbol);
+  EXPECT_EQ(1U, cache.stats().modules_missing);
+
+  // Another module with symbols isn't noted.
+  ModuleInformation other(MakeModule(0x20000000));
+  other.time_date_stamp++;
+  EXPECT_CALL(cache, HasSymbols(_, other)).WillOnce(Return(true));
+  cache.GetSymbolForAddress(other, 0x20000100, SYMBOL_ALL, &symbol);
+  EXPECT_FALSE(missing_symbols.IsMissing(other, base::Time::Now()));
+}
+
+TEST(ModuleSymbolCacheTest, NoMissingSymbolsWithoutServers) {
+  MissingSymbolsCache missing_symbols;
+  testing::NiceMock<TestModuleSymbolCache> cache;
+  ON_CALL(cache, ResolveSymbol(_, _, _, _))
+      .WillByDefault(Invoke(&cache,
+                            &TestModuleSymbolCache::LoadAndResolveSymbol));
+  cache.SetSymbolPath(L"c:\\symbols");
+  cache.set_missing_symbols_cache(&missing_symbols);
+
+  // There's no server to spare, so there's nothing to note.
+  ModuleInformation module(MakeModule(0x10000000));
+  EXPECT_CALL(cache, HasSymbols(_, _)).Times(0);
+  SymbolRecord symbol;
+  cache.GetSymbolForAddress(module, 0x10000100, SYMBOL_ALL, &symbol);
+  EXPECT_EQ(0U, missing_symbols.num_modules());
+}
+
+}  // namespace sym_util
@@ -0,0 +1,184 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Persistent symbol cache implementation.
+#include "sawbuck/sym_util/persistent_symbol_cache.h"
+
+#include <string.h>
+#include <vector>
+#include "base/logging.h"
+
+namespace sym_util {
+
+const size_t PersistentSymbolCache::kInitialSize;
+const size_t PersistentSymbolCache::kMaxSize;
+
+PersistentSymbolCache::PersistentSymbolCache() : view_(NULL), size_(0) {
+}
+
+PersistentSymbolCache::~PersistentSymbolCache() {
+  Close();
+}
+
+bool PersistentSymbolCache::Open(const base::FilePath& path) {
+  Close();
+
+  // No sharing, as two processes appending to the same store would
+  // trample each other.
+  file_.Set(::CreateFile(path.value().c_str(),
+                         GENERIC_READ | GENERIC_WRITE,
+                         0,
+                         NULL,
+                         OPEN_ALWAYS,
+                         FILE_ATTRIBUTE_NORMAL,
+                         NULL));
+  if (!file_.IsValid()) {
+    LOG(ERROR) << "Unable to open symbol cache " << path.value().c_str()
+        << ", error " << ::GetLastError();
+    return false;
+  }
+
+  LARGE_INTEGER file_size = {};
+  if (!::GetFileSizeEx(file_.Get(), &file_size)) {
+    Close();
+    return false;
+  }
+
+  uint64 existing_size = static_cast<uint64>(file_size.QuadPart);
+  bool start_over = existing_size < SymbolStore::kMinSize ||
+      existing_size > kMaxSize;
+  size_t size = start_over ? kInitialSize :
+      static_cast<size_t>(existing_size);
+
+  if (!Map(size)) {
+    Close();
+    return false;
+  }
+
+  if (start_over || !store_.Attach(view_, size_)) {
+    SymbolStore::Format(view_, size_);
+    CHECK(store_.Attach(view_, size_));
+  }
+
+  return true;
+}
+
+void PersistentSymbolCache::Close() {
+  Unmap();
+  file_.Close();
+}
+
+bool PersistentSymbolCache::Lookup(const ModuleInformation& module,
+                                   Address address,
+                                   Symbol* symbol) const {
+  DCHECK(symbol != NULL);
+  if (!is_open())
+    return false;
+
+  if (!store_.Lookup(SymbolStore::MakeKey(module, address), symbol))
+    return false;
+
+  symbol->module = module.image_file_name;
+  symbol->module_base = module.base_address;
+  return true;
+}
+
+bool PersistentSymbolCache::Insert(const ModuleInformation& module,
+                                   Address address,
+                                   const Symbol& symbol) {
+  if (!is_open())
+    return false;
+
+  SymbolStore::Key key(SymbolStore::MakeKey(module, address));
+  while (!store_.Insert(key, symbol)) {
+    if (!Grow())
+      return false;
+  }
+
+  return true;
+}
+
+bool PersistentSymbolCache::Map(size_t size) {
+  DCHECK(file_.IsValid());
+  Unmap();
+
+  // Mapping past the end of the file extends it.
+  ULARGE_INTEGER map_size = {};
+  map_size.QuadPart = size;
+  mapping_.Set(::CreateFileMapping(file_.Get(),
+                                   NULL,
+                                   PAGE_READWRITE,
+                                   map_size.HighPart,
+                                   map_size.LowPart,
+                                   NULL));
+  if (!mapping_.IsValid()) {
+    LOG(ERROR) << "Unable to map symbol cache, error " << ::GetLastError();
+    return false;
+  }
+
+  view_ = ::MapViewOfFile(mapping_.Get(), FILE_MAP_ALL_ACCESS, 0, 0, size);
+  if (view_ == NULL) {
+    LOG(ERROR) << "Unable to view symbol cache, error " << ::GetLastError();
+    mapping_.Close();
+    return false;
+  }
+
+  size_ = size;
+  return true;
+}
+
+void PersistentSymbolCache::Unmap() {
+  store_.Detach();
+  if (view_ != NULL) {
+    ::UnmapViewOfFile(view_);
+    view_ = NULL;
+  }
+  mapping_.Close();
+  size_ = 0;
+}
+
+bool PersistentSymbolCache::Grow() {
+  size_t new_size = size_ * 2;
+  if (new_size > kMaxSize)
+    return false;
+
+  // Rebuild the store at the new size off to the side, as the buckets
+  // depend on the size.
+  std::vector<uint8> buffer(new_size);
+  SymbolStore new_store;
+  SymbolStore::Format(&buffer[0], new_size);
+  CHECK(new_store.Attach(&buffer[0], new_size));
+  if (!store_.CopyTo(&new_store))
+    return false;
+  new_store.Detach();
+
+  if (!Map(new_size)) {
+    Close();
+    return false;
+  }
+
+  // Write the first word, which holds the magic, last. Should we go away
+  // midway through, the file is started over next time round.
+  const size_t kMagicSize = sizeof(uint32);
+  memset(view_, 0, kMagicSize);
+  memcpy(reinterpret_cast<uint8*>(view_) + kMagicSize,
+         &buffer[kMagicSize],
+         new_size - kMagicSize);
+  memcpy(view_, &buffer[0], kMagicSize);
+
+  CHECK(store_.Attach(view_, size_));
+  return true;
+}
+
+}  // namespace sym_util
@@ -0,0 +1,84 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Persistent symbol cache declaration.
+#ifndef SAWBUCK_SYM_UTIL_PERSISTENT_SYMBOL_CACHE_H_
+#define SAWBUCK_SYM_UTIL_PERSISTENT_SYMBOL_CACHE_H_
+
+#include <windows.h>
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/win/scoped_handle.h"
+#include "sawbuck/sym_util/symbol_store.h"
+#include "sawbuck/sym_util/types.h"
+
+namespace sym_util {
+
+// Keeps resolved symbols in a memory mapped file from one session to the
+// next, keyed by module identity and RVA, so that stack traces from a
+// build we've seen before resolve without going near dbghelp.
+// The file is held open exclusively, so only one process at a time gets
+// to use it, others go without.
+class PersistentSymbolCache {
+ public:
+  PersistentSymbolCache();
+  ~PersistentSymbolCache();
+
+  // Opens the cache file at @p path, creating it if need be. A file that
+  // doesn't hold a valid cache is started over.
+  // @returns true on success.
+  bool Open(const base::FilePath& path);
+  void Close();
+  bool is_open() const { return view_ != NULL; }
+
+  // Looks up the symbol at @p address in @p module.
+  // @returns true iff found, in which case @p symbol is filled in as
+  //     SymbolCache::GetSymbolForAddress would.
+  bool Lookup(const ModuleInformation& module,
+              Address address,
+              Symbol* symbol) const;
+
+  // Stores @p symbol for @p address in @p module, growing the file as
+  // need be.
+  // @returns true on success.
+  bool Insert(const ModuleInformation& module,
+              Address address,
+              const Symbol& symbol);
+
+  // The size of a new cache file, and the most the file grows to.
+  static const size_t kInitialSize = 4 * 1024 * 1024;
+  static const size_t kMaxSize = 256 * 1024 * 1024;
+
+ private:
+  // Maps @p size bytes of the file, extending it as need be.
+  bool Map(size_t size);
+  void Unmap();
+
+  // Moves the store to a file of twice the size.
+  bool Grow();
+
+  base::win::ScopedHandle file_;
+  base::win::ScopedHandle mapping_;
+  void* view_;
+  size_t size_;
+
+  // The store in view_.
+  SymbolStore store_;
+
+  DISALLOW_COPY_AND_ASSIGN(PersistentSymbolCache);
+};
+
+}  // namespace sym_util
+
+#endif  // SAWBUCK_SYM_UTIL_PERSISTENT_SYMBOL_CACHE_H_
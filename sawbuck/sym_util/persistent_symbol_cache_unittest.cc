@@ -0,0 +1,138 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Persistent symbol cache unittests.
+#include "sawbuck/sym_util/persistent_symbol_cache.h"
+
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/strings/stringprintf.h"
+#include "gtest/gtest.h"
+
+namespace sym_util {
+
+namespace {
+
+class PersistentSymbolCacheTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    cache_path_ = temp_dir_.path().Append(L"symbol_cache.dat");
+
+    module_.base_address = 0x10000000;
+    module_.module_size = 0x1000000;
+    module_.image_checksum = 0xCAFE;
+    module_.time_date_stamp = 0x4D2;
+    module_.image_file_name = L"c:\\chrome\\chrome.dll";
+  }
+
+  Symbol MakeSymbol(int i) {
+    Symbol symbol;
+    symbol.name = base::StringPrintf(L"Function%d", i);
+    symbol.mangled_name = base::StringPrintf(L"?Function%d@@YAXXZ", i);
+    symbol.offset = i;
+    symbol.size = 16;
+    symbol.file = L"c:\\src\\chrome\\foo.cc";
+    symbol.line = i;
+    return symbol;
+  }
+
+ protected:
+  base::ScopedTempDir temp_dir_;
+  base::FilePath cache_path_;
+  ModuleInformation module_;
+};
+
+}  // namespace
+
+TEST_F(PersistentSymbolCacheTest, Persists) {
+  Address address = module_.base_address + 0x100;
+  {
+    PersistentSymbolCache cache;
+    ASSERT_TRUE(cache.Open(cache_path_));
+    EXPECT_TRUE(cache.is_open());
+
+    Symbol symbol;
+    EXPECT_FALSE(cache.Lookup(module_, address, &symbol));
+    EXPECT_TRUE(cache.Insert(module_, address, MakeSymbol(1)));
+  }
+
+  // The same module, loaded elsewhere in another session, hits.
+  ModuleInformation moved(module_);
+  moved.base_address = 0x20000000;
+
+  PersistentSymbolCache cache;
+  ASSERT_TRUE(cache.Open(cache_path_));
+  Symbol symbol;
+  ASSERT_TRUE(cache.Lookup(moved, moved.base_address + 0x100, &symbol));
+  EXPECT_EQ(L"Function1", symbol.name);
+  EXPECT_EQ(L"?Function1@@YAXXZ", symbol.mangled_name);
+  EXPECT_EQ(moved.image_file_name, symbol.module);
+  EXPECT_EQ(moved.base_address, symbol.module_base);
+  EXPECT_EQ(1U, symbol.line);
+}
+
+TEST_F(PersistentSymbolCacheTest, OpenIsExclusive) {
+  PersistentSymbolCache cache;
+  ASSERT_TRUE(cache.Open(cache_path_));
+
+  PersistentSymbolCache other;
+  EXPECT_FALSE(other.Open(cache_path_));
+  EXPECT_FALSE(other.is_open());
+
+  Symbol symbol;
+  EXPECT_FALSE(other.Lookup(module_, module_.base_address, &symbol));
+  EXPECT_FALSE(other.Insert(module_, module_.base_address, symbol));
+}
+
+TEST_F(PersistentSymbolCacheTest, StartsOverOnGarbage) {
+  std::string garbage(PersistentSymbolCache::kInitialSize, 'x');
+  ASSERT_EQ(static_cast<int>(garbage.size()),
+            base::WriteFile(cache_path_, garbage.data(), garbage.size()));
+
+  PersistentSymbolCache cache;
+  ASSERT_TRUE(cache.Open(cache_path_));
+  Symbol symbol;
+  EXPECT_FALSE(cache.Lookup(module_, module_.base_address, &symbol));
+  EXPECT_TRUE(cache.Insert(module_, module_.base_address, MakeSymbol(0)));
+  EXPECT_TRUE(cache.Lookup(module_, module_.base_address, &symbol));
+}
+
+TEST_F(PersistentSymbolCacheTest, Grows) {
+  // Insert more than the initial file holds.
+  const int kNumSymbols = 30000;
+  {
+    PersistentSymbolCache cache;
+    ASSERT_TRUE(cache.Open(cache_path_));
+    for (int i = 0; i < kNumSymbols; ++i)
+      ASSERT_TRUE(cache.Insert(module_, module_.base_address + i * 16,
+                               MakeSymbol(i)));
+  }
+
+  int64 file_size = 0;
+  ASSERT_TRUE(base::GetFileSize(cache_path_, &file_size));
+  EXPECT_LT(static_cast<int64>(PersistentSymbolCache::kInitialSize),
+            file_size);
+
+  PersistentSymbolCache cache;
+  ASSERT_TRUE(cache.Open(cache_path_));
+  for (int i = 0; i < kNumSymbols; i += 997) {
+    Symbol symbol;
+    ASSERT_TRUE(cache.Lookup(module_, module_.base_address + i * 16,
+                             &symbol));
+    EXPECT_EQ(MakeSymbol(i).name, symbol.name);
+  }
+}
+
+}  // namespace sym_util
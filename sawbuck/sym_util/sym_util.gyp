@@ -1,16 +1,16 @@
-# Copyright 2009 Google Inc.
-#
-# Licensed under the Apache License, Version 2.0 (the "License");
-# you may not use this file except in compliance with the License.
-# You may obtain a copy of the License at
-# 
-#      http://www.apache.org/licenses/LICENSE-2.0
-#
-# Unless required by applicable law or agreed to in writing, software
-# distributed under the License is distributed on an "AS IS" BASIS,
-# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-# See the License for the specific language governing permissions and
-# limitations under the License.
+# Copyright 2009 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+# 
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
 
 {
   'variables': {
@@ -18,7 +18,7 @@
   },
   'target_defaults': {
     'include_dirs': [
-      '<(DEPTH)',
+      '<(DEPTH)',
       '../..',
     ],
     'defines': [
@@ -31,26 +31,46 @@
       'target_name': 'sym_util',
       'type': 'static_library',
       'sources': [
+        'breakpad_symbol_table.cc',
+        'breakpad_symbol_table.h',
+        'missing_symbols_cache.cc',
+        'missing_symbols_cache.h',
         'module_cache.cc',
         'module_cache.h',
+        'module_symbol_cache.cc',
+        'module_symbol_cache.h',
+        'persistent_symbol_cache.cc',
+        'persistent_symbol_cache.h',
         'symbol_cache.cc',
         'symbol_cache.h',
+        'symbol_store.cc',
+        'symbol_store.h',
+        'symbol_string_table.cc',
+        'symbol_string_table.h',
         'types.cc',
         'types.h',
       ],
       'dependencies': [
-        '<(DEPTH)/base/base.gyp:base',
+        '<(DEPTH)/base/base.gyp:base',
       ],
     },
     {
       'target_name': 'sym_util_unittests',
       'type': 'executable',
       'sources': [
+        'breakpad_symbol_table_unittest.cc',
+        'missing_symbols_cache_unittest.cc',
         'module_cache_unittest.cc',
+        'module_symbol_cache_unittest.cc',
+        'persistent_symbol_cache_unittest.cc',
+        'symbol_cache_unittest.cc',
+        'symbol_store_unittest.cc',
+        'symbol_string_table_unittest.cc',
       ],
       'dependencies': [
         'sym_util',
         '<(DEPTH)/base/base.gyp:base',
+        '<(DEPTH)/testing/gmock.gyp:gmock',
         '<(DEPTH)/testing/gtest.gyp:gtest',
       ],
     },
@@ -13,11 +13,23 @@
 // limitations under the License.
 #include "sawbuck/sym_util/symbol_cache.h"
 
+#include <algorithm>
+#include "base/file_util.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_split.h"
 #include "base/strings/string_util.h"
+#include "base/strings/utf_string_conversions.h"
+#include "sawbuck/sym_util/breakpad_symbol_table.h"
 #include <dbghelp.h>
 
 namespace {
 
+// The prefix of the symbol path elements that name a directory of Breakpad
+// symbol files.
+const wchar_t kBreakpadPrefix[] = L"breakpad*";
+
 template <size_t name_len>
 class SymbolInfo {
  public:
@@ -37,10 +49,28 @@ class SymbolInfo {
   };
 };
 
+bool BaseLess(const sym_util::ModuleInformation& module,
+              sym_util::Address address) {
+  return module.base_address < address;
+}
+
 }  // namespace
 
 namespace sym_util {
 
+struct SymbolCache::BreakpadModule {
+  ModuleInformation module;
+  // The table's block is mapped from its file, or failing that, converted
+  // to memory.
+  scoped_ptr<base::MemoryMappedFile> file;
+  std::string converted;
+  BreakpadSymbolTable table;
+
+  size_t size() const {
+    return file.get() != NULL ? file->length() : converted.size();
+  }
+};
+
 SymbolCache::SymbolCache() : initialized_(false) {
   // We use our own this pointer as process handle to ensure uniqueness
   // of handles passed to SymInitialize within our process.
@@ -73,7 +103,14 @@ bool SymbolCache::Initialize(size_t num_modules,
 
   // Load the modules.
   for (size_t i = 0; i < num_modules; ++i) {
-    modules_.push_back(modules[i]);
+    // Keep the modules sorted by base, as the callback looks them up
+    // while they load.
+    modules_.insert(std::lower_bound(modules_.begin(), modules_.end(),
+                                     modules[i].base_address, BaseLess),
+                    modules[i]);
+
+    if (LoadBreakpadSymbols(modules[i]))
+      continue;
 
     DWORD64 load_base = ::SymLoadModuleEx(process_handle_,
                                           NULL,
@@ -88,14 +125,30 @@ bool SymbolCache::Initialize(size_t num_modules,
   return true;
 }
 
-bool SymbolCache::GetSymbolForAddress(Address address, Symbol *symbol) {
-  // Try the local cache first.
-  SymbolMap::const_iterator it(cache_.find(address));
+bool SymbolCache::GetSymbolForAddress(Address address,
+                                      SymbolLevel level,
+                                      Symbol *symbol) {
+  // Try the local cache first, resolving further if need be.
+  SymbolMap::iterator it(cache_.find(address));
   if (it != cache_.end()) {
+    ResolveSymbolLevel(address, level, &it->second);
     *symbol = it->second;
     return true;
   }
 
+  const BreakpadModule* breakpad = FindBreakpadModule(address);
+  if (breakpad != NULL) {
+    uint32 rva = static_cast<uint32>(address - breakpad->module.base_address);
+    if (!breakpad->table.Lookup(rva, symbol))
+      return false;
+
+    // The table has it all at no extra cost.
+    symbol->module = breakpad->module.image_file_name;
+    symbol->module_base = breakpad->module.base_address;
+    symbol->level = SYMBOL_ALL;
+    return true;
+  }
+
   IMAGEHLP_MODULE64 module = { sizeof(module) };
   if (::SymGetModuleInfo64(process_handle_, address, &module)) {
     symbol->module = module.ImageName;
@@ -110,26 +163,83 @@ bool SymbolCache::GetSymbolForAddress(Address address, Symbol *symbol) {
   symbol->name = sym_info.get()->Name;
   symbol->offset = static_cast<size_t>(offset);
   symbol->size = sym_info.get()->Size;
+  symbol->mangled_name.clear();
+  symbol->file.clear();
+  symbol->line = 0;
+  symbol->level = SYMBOL_FUNCTION;
+  ResolveSymbolLevel(address, level, symbol);
 
-  // Lookup the unmagled name.
-  DWORD options = ::SymGetOptions();
-  ::SymSetOptions((options | SYMOPT_PUBLICS_ONLY) & ~SYMOPT_UNDNAME);
-  if (::SymFromAddr(process_handle_, address, &offset, sym_info.get()))
-    symbol->mangled_name = sym_info.get()->Name;
-  ::SymSetOptions(options);
+  cache_.insert(std::make_pair(address, *symbol));
+  return true;
+}
 
-  IMAGEHLP_LINE64 line_info = { sizeof(line_info) };
-  DWORD line_displacement = 0;
-  if (::SymGetLineFromAddr64(process_handle_,
-                             address,
-                             &line_displacement,
-                             &line_info)) {
-    symbol->file = line_info.FileName;
-    symbol->line = line_info.LineNumber;
+void SymbolCache::ResolveSymbolLevel(Address address,
+                                     SymbolLevel level,
+                                     Symbol* symbol) {
+  DCHECK(symbol != NULL);
+
+  if (symbol->level < SYMBOL_LINE && level >= SYMBOL_LINE) {
+    IMAGEHLP_LINE64 line_info = { sizeof(line_info) };
+    DWORD line_displacement = 0;
+    if (::SymGetLineFromAddr64(process_handle_,
+                               address,
+                               &line_displacement,
+                               &line_info)) {
+      symbol->file = line_info.FileName;
+      symbol->line = line_info.LineNumber;
+    }
+    symbol->level = SYMBOL_LINE;
   }
 
-  cache_.insert(std::make_pair(address, *symbol));
-  return true;
+  if (symbol->level < SYMBOL_MANGLED_NAME && level >= SYMBOL_MANGLED_NAME) {
+    // Lookup the unmagled name.
+    DWORD64 offset = 0;
+    SymbolInfo<1024> sym_info;
+    DWORD options = ::SymGetOptions();
+    ::SymSetOptions((options | SYMOPT_PUBLICS_ONLY) & ~SYMOPT_UNDNAME);
+    if (::SymFromAddr(process_handle_, address, &offset, sym_info.get()))
+      symbol->mangled_name = sym_info.get()->Name;
+    ::SymSetOptions(options);
+    symbol->level = SYMBOL_MANGLED_NAME;
+  }
+}
+
+uint64 SymbolCache::GetLoadedSymbolsSize() {
+  uint64 size = 0;
+  for (size_t i = 0; i < modules_.size(); ++i) {
+    const BreakpadModule* breakpad =
+        FindBreakpadModule(modules_[i].base_address);
+    if (breakpad != NULL) {
+      size += breakpad->size();
+      continue;
+    }
+
+    IMAGEHLP_MODULE64 module = { sizeof(module) };
+    int64 pdb_size = 0;
+    if (::SymGetModuleInfo64(process_handle_, modules_[i].base_address,
+                             &module) &&
+        module.LoadedPdbName[0] != L'\0' &&
+        base::GetFileSize(base::FilePath(module.LoadedPdbName), &pdb_size)) {
+      size += pdb_size;
+    } else {
+      size += modules_[i].module_size;
+    }
+  }
+
+  return size;
+}
+
+bool SymbolCache::HasSymbols(Address module_base) {
+  const BreakpadModule* breakpad = FindBreakpadModule(module_base);
+  if (breakpad != NULL)
+    return breakpad->table.num_functions() != 0;
+
+  IMAGEHLP_MODULE64 module = { sizeof(module) };
+  if (!::SymGetModuleInfo64(process_handle_, module_base, &module))
+    return false;
+
+  return module.SymType != SymNone && module.SymType != SymExport &&
+      module.SymType != SymDeferred;
 }
 
 void SymbolCache::Cleanup() {
@@ -137,23 +247,131 @@ void SymbolCache::Cleanup() {
     ::SymCleanup(process_handle_);
 
   initialized_ = false;
+  breakpad_modules_.clear();
 }
 
 void SymbolCache::SetSymbolPath(const wchar_t* symbol_path) {
-  if (symbol_path != NULL)
-    symbol_path_ = symbol_path;
-  else
-    symbol_path_ = L"";
+  SplitSymbolPath(symbol_path != NULL ? symbol_path : L"",
+                  &symbol_path_, &breakpad_dirs_);
 
   if (initialized_) {
     // Switch the symbol path to the newly supplied one.
-    ::SymSetSearchPath(process_handle_, symbol_path);
+    ::SymSetSearchPath(process_handle_,
+                       symbol_path != NULL ? symbol_path_.c_str() : NULL);
 
     // And flush the cache.
     cache_.clear();
   }
 }
 
+void SymbolCache::SplitSymbolPath(const std::wstring& symbol_path,
+                                  std::wstring* dbghelp_path,
+                                  std::vector<std::wstring>* breakpad_dirs) {
+  DCHECK(dbghelp_path != NULL);
+  DCHECK(breakpad_dirs != NULL);
+
+  std::vector<std::wstring> elements;
+  base::SplitString(symbol_path, L';', &elements);
+
+  dbghelp_path->clear();
+  breakpad_dirs->clear();
+  const size_t kPrefixLength = arraysize(kBreakpadPrefix) - 1;
+  for (size_t i = 0; i < elements.size(); ++i) {
+    const std::wstring& element = elements[i];
+    if (StartsWith(element, kBreakpadPrefix, false)) {
+      if (element.size() > kPrefixLength)
+        breakpad_dirs->push_back(element.substr(kPrefixLength));
+      continue;
+    }
+
+    if (!dbghelp_path->empty())
+      dbghelp_path->append(1, L';');
+    dbghelp_path->append(element);
+  }
+}
+
+bool SymbolCache::LoadBreakpadSymbols(const ModuleInformation& module) {
+  if (breakpad_dirs_.empty())
+    return false;
+
+  std::wstring image_name(
+      base::FilePath(module.image_file_name).BaseName().value());
+  std::string code_id(BreakpadSymbolTable::GetCodeId(module));
+  std::wstring table_name(image_name + L"." + UTF8ToWide(code_id) +
+                          L".symtab");
+
+  for (size_t i = 0; i < breakpad_dirs_.size(); ++i) {
+    base::FilePath dir(breakpad_dirs_[i]);
+    base::FilePath table_path(dir.Append(table_name));
+    scoped_ptr<BreakpadModule> loaded(new BreakpadModule());
+    loaded->module = module;
+
+    // A table converted before, or prebuilt, maps as is.
+    loaded->file.reset(new base::MemoryMappedFile());
+    if (loaded->file->Initialize(table_path) &&
+        loaded->table.Attach(loaded->file->data(), loaded->file->length()) &&
+        loaded->table.code_id() == code_id) {
+      breakpad_modules_.push_back(loaded.release());
+      return true;
+    }
+    loaded->table.Detach();
+    loaded->file.reset();
+
+    // Otherwise the symbol file has to be converted, and has to be for
+    // this very module.
+    std::string text;
+    if (!base::ReadFileToString(dir.Append(image_name + L".sym"), &text))
+      continue;
+    if (!status_callback_.is_null()) {
+      std::wstring status(L"Converting Breakpad symbols for ");
+      status.append(image_name);
+      status_callback_.Run(status.c_str());
+    }
+    if (!BreakpadSymbolTable::Convert(text.data(), text.size(),
+                                      &loaded->converted) ||
+        !loaded->table.Attach(loaded->converted.data(),
+                              loaded->converted.size()) ||
+        loaded->table.code_id() != code_id) {
+      LOG(WARNING) << "Breakpad symbols for " << image_name
+          << " don't match module " << code_id;
+      continue;
+    }
+
+    // Save the table to map next time, and this time too, if we can.
+    int size = static_cast<int>(loaded->converted.size());
+    if (base::WriteFile(table_path, loaded->converted.data(), size) == size) {
+      scoped_ptr<base::MemoryMappedFile> file(new base::MemoryMappedFile());
+      if (file->Initialize(table_path) &&
+          loaded->table.Attach(file->data(), file->length())) {
+        loaded->file.reset(file.release());
+        std::string().swap(loaded->converted);
+      } else {
+        loaded->table.Attach(loaded->converted.data(),
+                             loaded->converted.size());
+      }
+    }
+
+    breakpad_modules_.push_back(loaded.release());
+    return true;
+  }
+
+  return false;
+}
+
+const SymbolCache::BreakpadModule* SymbolCache::FindBreakpadModule(
+    Address address) const {
+  // There are seldom more than a few of these.
+  for (size_t i = 0; i < breakpad_modules_.size(); ++i) {
+    const ModuleInformation& module = breakpad_modules_[i]->module;
+    if (address >= module.base_address &&
+        address - module.base_address < module.module_size) {
+      return breakpad_modules_[i];
+    }
+  }
+
+  return NULL;
+}
+
 // TODO(siggi): This callback needs cleaning up. Firstly anytime it sees
 //    a proposed module, or when it thinks it's found a match in e.g.
 //    systemroot or by prepending a drive letter, or whathever, it should
@@ -194,6 +412,11 @@ BOOL CALLBACK SymbolCache::SymbolCallback(HANDLE process,
           reinterpret_cast<IMAGEHLP_DEFERRED_SYMBOL_LOAD64*>(data);
       LOG(INFO) << "CBA_DEFERRED_SYMBOL_LOAD_FAILURE(0x\n" <<
           loaded->BaseOfImage << ")";
+      if (!cache->status_callback_.is_null()) {
+        std::wstring status(L"No symbols for ");
+        status.append(loaded->FileName);
+        cache->status_callback_.Run(status.c_str());
+      }
       break;
     }
 
@@ -218,6 +441,13 @@ BOOL CALLBACK SymbolCache::SymbolCallback(HANDLE process,
           reinterpret_cast<IMAGEHLP_DEFERRED_SYMBOL_LOAD64*>(data);
       LOG(INFO) << "CBA_DEFERRED_SYMBOL_LOAD_START(0x" << loaded->BaseOfImage
           << ")\n";
+      // Loading can mean a download, which may take a while, so tell which
+      // module it's for.
+      if (!cache->status_callback_.is_null()) {
+        std::wstring status(L"Loading symbols for ");
+        status.append(loaded->FileName);
+        cache->status_callback_.Run(status.c_str());
+      }
       break;
     }
 
@@ -271,14 +501,14 @@ BOOL CALLBACK SymbolCache::SymbolCallback(HANDLE process,
 
 bool SymbolCache::GetModuleInformation(Address load_address,
                                        ModuleInformation* info) {
-  for (size_t i = 0; i < modules_.size(); ++i) {
-    if (modules_[i].base_address == load_address) {
-      *info = modules_[i];
-      return true;
-    }
-  }
+  ModuleList::const_iterator it(
+      std::lower_bound(modules_.begin(), modules_.end(), load_address,
+                       BaseLess));
+  if (it == modules_.end() || it->base_address != load_address)
+    return false;
 
-  return false;
+  *info = *it;
+  return true;
 }
 
 }  // namespace sym_util
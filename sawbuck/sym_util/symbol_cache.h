@@ -19,14 +19,18 @@
 #include <windows.h>
 #include <string>
 #include <map>
-#include <set>
 #include <vector>
+#include "base/basictypes.h"
 #include "base/callback.h"
+#include "base/memory/scoped_vector.h"
 #include "sawbuck/sym_util/types.h"
 
 namespace sym_util {
 
-// A simple wrapper around the Symbol APIs.
+// A simple wrapper around the Symbol APIs. Modules that have a Breakpad
+// symbol file in one of the "breakpad*<directory>" elements of the symbol
+// path are resolved from a table converted from that file instead, which
+// then needn't load in dbghelp at all.
 class SymbolCache {
  public:
   SymbolCache();
@@ -37,15 +41,41 @@ class SymbolCache {
     status_callback_ = status_callback;
   }
 
-  bool GetSymbolForAddress(Address address, Symbol *symbol);
+  // Resolves @p address to @p symbol, at least to @p level. A lookup at a
+  // higher level than before resolves only what the earlier one didn't.
+  // @returns true on success.
+  bool GetSymbolForAddress(Address address,
+                           SymbolLevel level,
+                           Symbol *symbol);
 
   // Initialize to the set of modules provided.
   bool Initialize(size_t num_modules, ModuleInformation* modules);
   void Cleanup();
 
   // Sets a new symbol path, flushes the current cache.
+  // @note the Breakpad elements of the path apply to the modules
+  //     initialized after the change.
   void SetSymbolPath(const wchar_t* symbol_path);
 
+  // Splits the Breakpad elements off @p symbol_path.
+  // @param dbghelp_path on return, the elements for dbghelp.
+  // @param breakpad_dirs on return, the directories of the Breakpad
+  //     elements, in order.
+  static void SplitSymbolPath(const std::wstring& symbol_path,
+                              std::wstring* dbghelp_path,
+                              std::vector<std::wstring>* breakpad_dirs);
+
+  // @returns an estimate of the memory the loaded symbols take, which is
+  //     the size of the PDB files loaded, or of the images for modules
+  //     without one.
+  uint64 GetLoadedSymbolsSize();
+
+  // @returns true iff symbols were found for the module loaded at
+  //     @p module_base, rather than just its exports.
+  // @note the module's symbols load on its first lookup, which has to
+  //     come first.
+  bool HasSymbols(Address module_base);
+
  private:
   // We handle symbol callbacks to provide more information about images,
   // such as checksums and timestamps.
@@ -56,12 +86,29 @@ class SymbolCache {
 
   bool GetModuleInformation(Address load_address, ModuleInformation* info);
 
+  // A module resolved from a Breakpad symbol table.
+  struct BreakpadModule;
+
+  // Loads the Breakpad symbol table for @p module from the first of our
+  // Breakpad directories that has one, converting the module's symbol
+  // file to a table, and saving that alongside it, if need be.
+  // @returns true on success.
+  bool LoadBreakpadSymbols(const ModuleInformation& module);
+
+  // @returns the Breakpad module containing @p address, or NULL.
+  const BreakpadModule* FindBreakpadModule(Address address) const;
+
   // The process handle we provide SymInitialize.
   HANDLE process_handle_;
 
-  // Our symbol path.
+  // Our symbol path, without its Breakpad elements.
   std::wstring symbol_path_;
 
+  // The directories of the Breakpad symbol files, and the modules loaded
+  // from them.
+  std::vector<std::wstring> breakpad_dirs_;
+  ScopedVector<BreakpadModule> breakpad_modules_;
+
   // True iff we've successfully SymInitialized and not
   // called SymCleanup.
   bool initialized_;
@@ -69,17 +116,17 @@ class SymbolCache {
   // Callback we invoke on on status updates.
   StatusCallback status_callback_;
 
-  // We keep a cache of previously resolved symbols.
-  // TODO(siggi): does this make sense?
+  // Resolves the parts of @p symbol at @p address above its level, up to
+  // @p level.
+  void ResolveSymbolLevel(Address address, SymbolLevel level, Symbol* symbol);
+
+  // We keep a cache of previously resolved symbols, at the level they
+  // were resolved to.
   typedef std::map<Address, Symbol> SymbolMap;
   SymbolMap cache_;
 
   typedef std::vector<ModuleInformation> ModuleList;
   ModuleList modules_;
-
-  // To ensure we only retry loading each module once.
-  typedef std::set<Address> RetriedModuleSet;
-  RetriedModuleSet retried_;
 };
 
 }  // namespace sym_util
@@ -0,0 +1,145 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Symbol cache unittests.
+#include "sawbuck/sym_util/symbol_cache.h"
+
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "gtest/gtest.h"
+
+namespace sym_util {
+
+namespace {
+
+const char kSymbols[] =
+    "MODULE windows x86 1F2E3D4C5B6A79880102030405060708A vendor.dll.pdb\n"
+    "INFO CODE_ID 000004D2100000 vendor.dll\n"
+    "FILE 1 c:\\src\\foo.cc\n"
+    "FUNC 1000 40 4 Foo(int)\n"
+    "1000 40 10 1\n";
+
+class SymbolCacheTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    symbol_path_ = L"breakpad*" + temp_dir_.path().value();
+
+    module_.base_address = 0x10000000;
+    module_.module_size = 0x100000;
+    module_.image_checksum = 0xCAFE;
+    module_.time_date_stamp = 0x4D2;
+    module_.image_file_name = L"c:\\program files\\vendor\\vendor.dll";
+  }
+
+  void WriteSymbols(const char* symbols) {
+    int size = static_cast<int>(strlen(symbols));
+    ASSERT_EQ(size, base::WriteFile(temp_dir_.path().Append(L"vendor.dll.sym"),
+                                    symbols, size));
+  }
+
+ protected:
+  base::ScopedTempDir temp_dir_;
+  std::wstring symbol_path_;
+  ModuleInformation module_;
+};
+
+}  // namespace
+
+TEST_F(SymbolCacheTest, SplitSymbolPath) {
+  std::wstring dbghelp_path;
+  std::vector<std::wstring> breakpad_dirs;
+  SymbolCache::SplitSymbolPath(
+      L"c:\\symbols;Breakpad*c:\\chrome\\syms;breakpad*;"
+      L"srv*c:\\symbols*http://msdl.microsoft.com/download/symbols;"
+      L"breakpad*d:\\syms",
+      &dbghelp_path, &breakpad_dirs);
+
+  EXPECT_EQ(L"c:\\symbols;"
+            L"srv*c:\\symbols*http://msdl.microsoft.com/download/symbols",
+            dbghelp_path);
+  ASSERT_EQ(2, breakpad_dirs.size());
+  EXPECT_EQ(L"c:\\chrome\\syms", breakpad_dirs[0]);
+  EXPECT_EQ(L"d:\\syms", breakpad_dirs[1]);
+}
+
+TEST_F(SymbolCacheTest, ResolvesFromBreakpadSymbols) {
+  ASSERT_NO_FATAL_FAILURE(WriteSymbols(kSymbols));
+
+  SymbolCache cache;
+  cache.SetSymbolPath(symbol_path_.c_str());
+  ASSERT_TRUE(cache.Initialize(1, &module_));
+  EXPECT_TRUE(cache.HasSymbols(module_.base_address));
+
+  Symbol symbol;
+  ASSERT_TRUE(cache.GetSymbolForAddress(module_.base_address + 0x1010,
+                                        SYMBOL_ALL, &symbol));
+  EXPECT_EQ(module_.image_file_name, symbol.module);
+  EXPECT_EQ(module_.base_address, symbol.module_base);
+  EXPECT_EQ(L"Foo(int)", symbol.name);
+  EXPECT_EQ(0x10, symbol.offset);
+  EXPECT_EQ(L"c:\\src\\foo.cc", symbol.file);
+  EXPECT_EQ(10, symbol.line);
+  EXPECT_FALSE(cache.GetSymbolForAddress(module_.base_address + 0x1040,
+                                         SYMBOL_ALL, &symbol));
+
+  // The conversion is saved, and measured by its table.
+  base::FilePath table_path(
+      temp_dir_.path().Append(L"vendor.dll.000004D2100000.symtab"));
+  int64 table_size = 0;
+  ASSERT_TRUE(base::GetFileSize(table_path, &table_size));
+  EXPECT_EQ(table_size, cache.GetLoadedSymbolsSize());
+}
+
+TEST_F(SymbolCacheTest, MapsConvertedTable) {
+  ASSERT_NO_FATAL_FAILURE(WriteSymbols(kSymbols));
+  {
+    SymbolCache cache;
+    cache.SetSymbolPath(symbol_path_.c_str());
+    ASSERT_TRUE(cache.Initialize(1, &module_));
+  }
+
+  // The table does without the symbol file once converted.
+  ASSERT_TRUE(base::DeleteFile(temp_dir_.path().Append(L"vendor.dll.sym"),
+                               false));
+  SymbolCache cache;
+  cache.SetSymbolPath(symbol_path_.c_str());
+  ASSERT_TRUE(cache.Initialize(1, &module_));
+
+  Symbol symbol;
+  ASSERT_TRUE(cache.GetSymbolForAddress(module_.base_address + 0x1000,
+                                        SYMBOL_ALL, &symbol));
+  EXPECT_EQ(L"Foo(int)", symbol.name);
+}
+
+TEST_F(SymbolCacheTest, IgnoresSymbolsForOtherModules) {
+  const char kOtherSymbols[] =
+      "MODULE windows x86 1F2E3D4C5B6A79880102030405060708A vendor.dll.pdb\n"
+      "INFO CODE_ID 000004D3100000 vendor.dll\n"
+      "FUNC 1000 40 4 Foo(int)\n";
+  ASSERT_NO_FATAL_FAILURE(WriteSymbols(kOtherSymbols));
+
+  SymbolCache cache;
+  cache.SetSymbolPath(symbol_path_.c_str());
+  ASSERT_TRUE(cache.Initialize(1, &module_));
+
+  // The module goes to dbghelp, which doesn't find it.
+  Symbol symbol;
+  EXPECT_FALSE(cache.GetSymbolForAddress(module_.base_address + 0x1000,
+                                         SYMBOL_ALL, &symbol));
+  EXPECT_FALSE(base::PathExists(
+      temp_dir_.path().Append(L"vendor.dll.000004D2100000.symtab")));
+}
+
+}  // namespace sym_util
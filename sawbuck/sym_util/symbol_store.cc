@@ -0,0 +1,388 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Symbol store implementation.
+#include "sawbuck/sym_util/symbol_store.h"
+
+#include <string.h>
+#include "base/logging.h"
+
+namespace sym_util {
+
+namespace {
+
+const uint32 kMagic = 0x53594D53;  // 'SMYS'.
+const uint32 kVersion = 2;
+
+// We aim for a bucket per this many bytes of block, which is about the
+// size of a symbol record with typical C++ names.
+const size_t kBytesPerBucket = 512;
+const uint32 kMinBuckets = 16;
+
+const uint32 kFnvOffsetBasis = 2166136261U;
+const uint32 kFnvPrime = 16777619U;
+
+inline uint32 HashBytes(uint32 hash, const void* data, size_t size) {
+  const uint8* bytes = reinterpret_cast<const uint8*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+inline uint32 HashUnit(uint32 hash, uint32 unit) {
+  uint16 value = static_cast<uint16>(unit);
+  return HashBytes(hash, &value, sizeof(value));
+}
+
+inline size_t RoundUp(size_t value) {
+  return (value + 3) & ~static_cast<size_t>(3);
+}
+
+// Appends @p length UTF-16 code units at @p units to @p str.
+void ReadString(const uint16* units, size_t length, std::wstring* str) {
+  str->resize(length);
+  for (size_t i = 0; i < length; ++i)
+    (*str)[i] = static_cast<wchar_t>(units[i]);
+}
+
+// Writes @p str as UTF-16 code units to @p units.
+// @returns the end of the units written.
+uint16* WriteString(const std::wstring& str, uint16* units) {
+  for (size_t i = 0; i < str.size(); ++i)
+    *units++ = static_cast<uint16>(str[i]);
+  return units;
+}
+
+}  // namespace
+
+struct SymbolStore::Header {
+  uint32 magic;
+  uint32 version;
+  // The size of the block.
+  uint32 size;
+  // The buckets follow the header, each holds the offset of the first
+  // record in its chain, or zero.
+  uint32 num_buckets;
+  uint32 num_entries;
+  // The used part of the heap.
+  uint32 heap_begin;
+  uint32 heap_end;
+
+  uint32* buckets() {
+    return reinterpret_cast<uint32*>(this + 1);
+  }
+};
+
+struct SymbolStore::Record {
+  // The offset of the next record in the chain, or zero.
+  uint32 next;
+  uint32 hash;
+
+  uint32 time_date_stamp;
+  uint32 module_size;
+  uint32 rva;
+
+  uint32 offset;
+  uint32 size;
+  uint32 line;
+  // The SymbolLevel the symbol was resolved to.
+  uint32 level;
+
+  // The lengths of the strings that follow the record, as UTF-16 code
+  // units, in this order.
+  uint32 image_name_length;
+  uint32 name_length;
+  uint32 mangled_name_length;
+  uint32 file_length;
+
+  const uint16* strings() const {
+    return reinterpret_cast<const uint16*>(this + 1);
+  }
+  uint16* strings() {
+    return reinterpret_cast<uint16*>(this + 1);
+  }
+
+  uint64 strings_length() const {
+    return static_cast<uint64>(image_name_length) + name_length +
+        mangled_name_length + file_length;
+  }
+};
+
+const size_t SymbolStore::kMinSize =
+    sizeof(SymbolStore::Header) + kMinBuckets * sizeof(uint32) +
+    kMinBuckets * kBytesPerBucket;
+
+SymbolStore::Key SymbolStore::MakeKey(const ModuleInformation& module,
+                                      Address address) {
+  DCHECK_LE(module.base_address, address);
+  DCHECK_GT(module.base_address + module.module_size, address);
+
+  Key key;
+  const std::wstring& path = module.image_file_name;
+  size_t separator = path.find_last_of(L"\\/:");
+  key.image_name = separator == std::wstring::npos ?
+      path : path.substr(separator + 1);
+  for (size_t i = 0; i < key.image_name.size(); ++i) {
+    wchar_t c = key.image_name[i];
+    if (c >= L'A' && c <= L'Z')
+      key.image_name[i] = c - L'A' + L'a';
+  }
+  key.time_date_stamp = module.time_date_stamp;
+  key.module_size = module.module_size;
+  key.rva = static_cast<uint32>(address - module.base_address);
+
+  return key;
+}
+
+SymbolStore::SymbolStore() : header_(NULL), data_(NULL), size_(0) {
+}
+
+void SymbolStore::Format(void* data, size_t size) {
+  DCHECK(data != NULL);
+  DCHECK_LE(kMinSize, size);
+  DCHECK_GE(kuint32max, size);
+
+  uint32 num_buckets = kMinBuckets;
+  while (num_buckets * 2 * kBytesPerBucket <= size)
+    num_buckets *= 2;
+
+  Header* header = reinterpret_cast<Header*>(data);
+  header->magic = kMagic;
+  header->version = kVersion;
+  header->size = static_cast<uint32>(size);
+  header->num_buckets = num_buckets;
+  header->num_entries = 0;
+  header->heap_begin = sizeof(Header) + num_buckets * sizeof(uint32);
+  header->heap_end = header->heap_begin;
+  memset(header->buckets(), 0, num_buckets * sizeof(uint32));
+}
+
+bool SymbolStore::Attach(void* data, size_t size) {
+  DCHECK(data != NULL);
+  Detach();
+
+  if (size < kMinSize || size > kuint32max)
+    return false;
+
+  Header* header = reinterpret_cast<Header*>(data);
+  if (header->magic != kMagic || header->version != kVersion ||
+      header->size != size) {
+    return false;
+  }
+
+  // The bucket count must be a power of two, and the heap within bounds.
+  uint32 num_buckets = header->num_buckets;
+  if (num_buckets == 0 || (num_buckets & (num_buckets - 1)) != 0 ||
+      num_buckets > (size - sizeof(Header)) / sizeof(uint32) ||
+      header->heap_begin != sizeof(Header) + num_buckets * sizeof(uint32) ||
+      header->heap_end < header->heap_begin || header->heap_end > size) {
+    return false;
+  }
+
+  header_ = header;
+  data_ = reinterpret_cast<uint8*>(data);
+  size_ = size;
+  return true;
+}
+
+void SymbolStore::Detach() {
+  header_ = NULL;
+  data_ = NULL;
+  size_ = 0;
+}
+
+bool SymbolStore::Lookup(const Key& key, Symbol* symbol) const {
+  DCHECK(symbol != NULL);
+  if (!is_attached())
+    return false;
+
+  uint32 hash = Hash(key);
+  uint32 offset = header_->buckets()[hash & (header_->num_buckets - 1)];
+
+  // Bound the walk, in case the chain is corrupt and loops.
+  for (uint32 i = 0; i <= header_->num_entries && offset != 0; ++i) {
+    const Record* record = GetRecord(offset);
+    if (record == NULL)
+      return false;
+
+    if (record->hash == hash && KeyEquals(record, key)) {
+      ReadRecord(record, NULL, symbol);
+      return true;
+    }
+
+    offset = record->next;
+  }
+
+  return false;
+}
+
+bool SymbolStore::Insert(const Key& key, const Symbol& symbol) {
+  if (!is_attached())
+    return false;
+
+  // A more resolved symbol goes ahead of the one it supersedes in the
+  // chain, which then shadows it.
+  Symbol existing;
+  if (Lookup(key, &existing) && existing.level >= symbol.level)
+    return true;
+
+  size_t strings_length = key.image_name.size() + symbol.name.size() +
+      symbol.mangled_name.size() + symbol.file.size();
+  size_t record_size = RoundUp(sizeof(Record) +
+                               strings_length * sizeof(uint16));
+  if (record_size > size_ - header_->heap_end)
+    return false;
+
+  uint32 offset = header_->heap_end;
+  Record* record = reinterpret_cast<Record*>(data_ + offset);
+  uint32 hash = Hash(key);
+  uint32* bucket = &header_->buckets()[hash & (header_->num_buckets - 1)];
+
+  record->next = *bucket;
+  record->hash = hash;
+  record->time_date_stamp = key.time_date_stamp;
+  record->module_size = key.module_size;
+  record->rva = key.rva;
+  record->offset = static_cast<uint32>(symbol.offset);
+  record->size = static_cast<uint32>(symbol.size);
+  record->line = static_cast<uint32>(symbol.line);
+  record->level = symbol.level;
+  record->image_name_length = static_cast<uint32>(key.image_name.size());
+  record->name_length = static_cast<uint32>(symbol.name.size());
+  record->mangled_name_length =
+      static_cast<uint32>(symbol.mangled_name.size());
+  record->file_length = static_cast<uint32>(symbol.file.size());
+
+  uint16* units = record->strings();
+  units = WriteString(key.image_name, units);
+  units = WriteString(symbol.name, units);
+  units = WriteString(symbol.mangled_name, units);
+  units = WriteString(symbol.file, units);
+
+  // Link the record in only once it's complete.
+  header_->heap_end = static_cast<uint32>(offset + record_size);
+  *bucket = offset;
+  ++header_->num_entries;
+
+  return true;
+}
+
+bool SymbolStore::CopyTo(SymbolStore* other) const {
+  DCHECK(other != NULL);
+  if (!is_attached())
+    return true;
+
+  Key key;
+  Symbol symbol;
+  uint32 offset = header_->heap_begin;
+  while (offset < header_->heap_end) {
+    const Record* record = GetRecord(offset);
+    if (record == NULL)
+      break;
+
+    ReadRecord(record, &key, &symbol);
+    if (!other->Insert(key, symbol))
+      return false;
+
+    offset += static_cast<uint32>(RoundUp(
+        sizeof(Record) + record->strings_length() * sizeof(uint16)));
+  }
+
+  return true;
+}
+
+size_t SymbolStore::num_entries() const {
+  return is_attached() ? header_->num_entries : 0;
+}
+
+size_t SymbolStore::used_size() const {
+  return is_attached() ? header_->heap_end : 0;
+}
+
+const SymbolStore::Record* SymbolStore::GetRecord(uint32 offset) const {
+  DCHECK(is_attached());
+  uint64 begin = offset;
+  if (begin < header_->heap_begin || begin % 4 != 0 ||
+      begin + sizeof(Record) > header_->heap_end) {
+    return NULL;
+  }
+
+  const Record* record = reinterpret_cast<const Record*>(data_ + offset);
+  if (begin + sizeof(Record) + record->strings_length() * sizeof(uint16) >
+      header_->heap_end) {
+    return NULL;
+  }
+
+  return record;
+}
+
+void SymbolStore::ReadRecord(const Record* record,
+                             Key* key,
+                             Symbol* symbol) const {
+  DCHECK(record != NULL);
+  DCHECK(symbol != NULL);
+
+  const uint16* units = record->strings();
+  if (key != NULL) {
+    ReadString(units, record->image_name_length, &key->image_name);
+    key->time_date_stamp = record->time_date_stamp;
+    key->module_size = record->module_size;
+    key->rva = record->rva;
+  }
+  units += record->image_name_length;
+
+  ReadString(units, record->name_length, &symbol->name);
+  units += record->name_length;
+  ReadString(units, record->mangled_name_length, &symbol->mangled_name);
+  units += record->mangled_name_length;
+  ReadString(units, record->file_length, &symbol->file);
+
+  symbol->offset = record->offset;
+  symbol->size = record->size;
+  symbol->line = record->line;
+  symbol->level = record->level >= SYMBOL_FUNCTION &&
+      record->level <= SYMBOL_ALL ?
+          static_cast<SymbolLevel>(record->level) : SYMBOL_FUNCTION;
+}
+
+uint32 SymbolStore::Hash(const Key& key) {
+  uint32 hash = kFnvOffsetBasis;
+  for (size_t i = 0; i < key.image_name.size(); ++i)
+    hash = HashUnit(hash, key.image_name[i]);
+  hash = HashBytes(hash, &key.time_date_stamp, sizeof(key.time_date_stamp));
+  hash = HashBytes(hash, &key.module_size, sizeof(key.module_size));
+  hash = HashBytes(hash, &key.rva, sizeof(key.rva));
+  return hash;
+}
+
+bool SymbolStore::KeyEquals(const Record* record, const Key& key) {
+  if (record->time_date_stamp != key.time_date_stamp ||
+      record->module_size != key.module_size ||
+      record->rva != key.rva ||
+      record->image_name_length != key.image_name.size()) {
+    return false;
+  }
+
+  const uint16* units = record->strings();
+  for (size_t i = 0; i < key.image_name.size(); ++i) {
+    if (units[i] != static_cast<uint16>(key.image_name[i]))
+      return false;
+  }
+
+  return true;
+}
+
+}  // namespace sym_util
@@ -0,0 +1,109 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Symbol store declaration.
+#ifndef SAWBUCK_SYM_UTIL_SYMBOL_STORE_H_
+#define SAWBUCK_SYM_UTIL_SYMBOL_STORE_H_
+
+#include <string>
+#include "base/basictypes.h"
+#include "sawbuck/sym_util/types.h"
+
+namespace sym_util {
+
+// A hash table of resolved symbols, keyed by module identity and RVA, laid
+// out in a flat block of memory so that it can live in a memory mapped
+// file and outlive the process.
+//
+// The block starts with a header and an array of hash buckets, and the
+// rest is a heap the symbol records are appended to. Records are never
+// removed, when the heap is full the store has to be copied to a larger
+// block. A symbol resolved further than before is appended anew, and
+// shadows the record it supersedes. All offsets are checked against the
+// block before use, so a corrupt block makes for misses, not crashes.
+class SymbolStore {
+ public:
+  // Identifies a symbol independently of where its module is loaded.
+  struct Key {
+    // The module's file name, without its directory, in lower case.
+    std::wstring image_name;
+    ModuleTimeDateStamp time_date_stamp;
+    ModuleSize module_size;
+    // The symbol's address relative to the module base.
+    uint32 rva;
+  };
+
+  // @returns the key for @p address in @p module.
+  // @pre @p address is within @p module.
+  static Key MakeKey(const ModuleInformation& module, Address address);
+
+  SymbolStore();
+
+  // Lays out an empty store in @p data.
+  // @param size the size of @p data, at least kMinSize.
+  static void Format(void* data, size_t size);
+
+  // Starts using the store laid out in @p data.
+  // @param data a store laid out by Format, which must outlive its use.
+  // @returns false if @p data doesn't hold a store of @p size bytes.
+  bool Attach(void* data, size_t size);
+  void Detach();
+  bool is_attached() const { return header_ != NULL; }
+
+  // Looks up @p key, and on success fills in all of @p symbol but for
+  // its module name and base, which are up to the caller.
+  // @returns true iff the key was found.
+  bool Lookup(const Key& key, Symbol* symbol) const;
+
+  // Inserts the symbol at @p key, unless it's already there at the same
+  // level or above.
+  // @returns true on success, false if the store is full.
+  bool Insert(const Key& key, const Symbol& symbol);
+
+  // Inserts all our symbols to @p other.
+  // @returns true on success, false if @p other ran out of room.
+  bool CopyTo(SymbolStore* other) const;
+
+  // @returns the number of records in the store, superseded ones
+  //     included.
+  size_t num_entries() const;
+  // @returns the number of bytes used of the block.
+  size_t used_size() const;
+
+  // The smallest block a store can be formatted in.
+  static const size_t kMinSize;
+
+ private:
+  struct Header;
+  struct Record;
+
+  // @returns the record at @p offset, or NULL if it's out of bounds.
+  const Record* GetRecord(uint32 offset) const;
+
+  // Retrieves the key and symbol of @p record.
+  void ReadRecord(const Record* record, Key* key, Symbol* symbol) const;
+
+  static uint32 Hash(const Key& key);
+  static bool KeyEquals(const Record* record, const Key& key);
+
+  Header* header_;
+  uint8* data_;
+  size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(SymbolStore);
+};
+
+}  // namespace sym_util
+
+#endif  // SAWBUCK_SYM_UTIL_SYMBOL_STORE_H_
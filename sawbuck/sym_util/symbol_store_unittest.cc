@@ -0,0 +1,255 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Symbol store unittests.
+#include "sawbuck/sym_util/symbol_store.h"
+
+#include <vector>
+#include "base/strings/stringprintf.h"
+#include "gtest/gtest.h"
+
+namespace sym_util {
+
+namespace {
+
+const ModuleBase kBase = 0x10000000;
+
+ModuleInformation MakeModule(const wchar_t* path) {
+  ModuleInformation module = {};
+  module.base_address = kBase;
+  module.module_size = 0x100000;
+  module.image_checksum = 0xCAFE;
+  module.time_date_stamp = 0x4D2;
+  module.image_file_name = path;
+  return module;
+}
+
+Symbol MakeSymbol(const wchar_t* name) {
+  Symbol symbol;
+  symbol.name = name;
+  symbol.mangled_name = std::wstring(L"?") + name + L"@@YAXXZ";
+  symbol.offset = 12;
+  symbol.size = 345;
+  symbol.file = L"c:\\src\\foo.cc";
+  symbol.line = 67;
+  return symbol;
+}
+
+void ExpectSymbolEquals(const Symbol& expected, const Symbol& actual) {
+  EXPECT_EQ(expected.name, actual.name);
+  EXPECT_EQ(expected.mangled_name, actual.mangled_name);
+  EXPECT_EQ(expected.offset, actual.offset);
+  EXPECT_EQ(expected.size, actual.size);
+  EXPECT_EQ(expected.file, actual.file);
+  EXPECT_EQ(expected.line, actual.line);
+}
+
+class SymbolStoreTest : public testing::Test {
+ public:
+  SymbolStoreTest() : buffer_(SymbolStore::kMinSize) {
+  }
+
+  virtual void SetUp() {
+    SymbolStore::Format(&buffer_[0], buffer_.size());
+    ASSERT_TRUE(store_.Attach(&buffer_[0], buffer_.size()));
+  }
+
+ protected:
+  std::vector<uint8> buffer_;
+  SymbolStore store_;
+};
+
+}  // namespace
+
+TEST(SymbolStoreKeyTest, MakeKey) {
+  ModuleInformation module(MakeModule(L"C:\\Program Files\\Chrome.DLL"));
+  SymbolStore::Key key(SymbolStore::MakeKey(module, kBase + 0x1234));
+  EXPECT_EQ(L"chrome.dll", key.image_name);
+  EXPECT_EQ(module.time_date_stamp, key.time_date_stamp);
+  EXPECT_EQ(module.module_size, key.module_size);
+  EXPECT_EQ(0x1234U, key.rva);
+
+  module.image_file_name = L"bare.dll";
+  EXPECT_EQ(L"bare.dll", SymbolStore::MakeKey(module, kBase).image_name);
+}
+
+TEST_F(SymbolStoreTest, InsertAndLookup) {
+  ModuleInformation module(MakeModule(L"c:\\foo\\chrome.dll"));
+  SymbolStore::Key key1(SymbolStore::MakeKey(module, kBase + 0x10));
+  SymbolStore::Key key2(SymbolStore::MakeKey(module, kBase + 0x20));
+  Symbol symbol1(MakeSymbol(L"Foo"));
+  Symbol symbol2(MakeSymbol(L"Bar"));
+
+  Symbol found;
+  EXPECT_FALSE(store_.Lookup(key1, &found));
+  EXPECT_EQ(0U, store_.num_entries());
+
+  EXPECT_TRUE(store_.Insert(key1, symbol1));
+  EXPECT_TRUE(store_.Insert(key2, symbol2));
+  EXPECT_EQ(2U, store_.num_entries());
+
+  ASSERT_TRUE(store_.Lookup(key1, &found));
+  ExpectSymbolEquals(symbol1, found);
+  ASSERT_TRUE(store_.Lookup(key2, &found));
+  ExpectSymbolEquals(symbol2, found);
+
+  // Inserting again is a no-op.
+  EXPECT_TRUE(store_.Insert(key1, symbol2));
+  EXPECT_EQ(2U, store_.num_entries());
+  ASSERT_TRUE(store_.Lookup(key1, &found));
+  ExpectSymbolEquals(symbol1, found);
+
+  // The same module from another path, at another base, hits.
+  ModuleInformation moved(module);
+  moved.base_address = 0x20000000;
+  moved.image_file_name = L"d:\\bar\\CHROME.dll";
+  ASSERT_TRUE(store_.Lookup(
+      SymbolStore::MakeKey(moved, moved.base_address + 0x10), &found));
+  ExpectSymbolEquals(symbol1, found);
+
+  // A different build misses.
+  ModuleInformation rebuilt(module);
+  rebuilt.time_date_stamp++;
+  EXPECT_FALSE(store_.Lookup(SymbolStore::MakeKey(rebuilt, kBase + 0x10),
+                             &found));
+  rebuilt = module;
+  rebuilt.module_size++;
+  EXPECT_FALSE(store_.Lookup(SymbolStore::MakeKey(rebuilt, kBase + 0x10),
+                             &found));
+}
+
+TEST_F(SymbolStoreTest, UpgradesLevels) {
+  ModuleInformation module(MakeModule(L"c:\\foo\\chrome.dll"));
+  SymbolStore::Key key(SymbolStore::MakeKey(module, kBase + 0x10));
+  Symbol function(MakeSymbol(L"Foo"));
+  function.mangled_name.clear();
+  function.file.clear();
+  function.line = 0;
+  function.level = SYMBOL_FUNCTION;
+
+  Symbol found;
+  EXPECT_TRUE(store_.Insert(key, function));
+  ASSERT_TRUE(store_.Lookup(key, &found));
+  EXPECT_EQ(SYMBOL_FUNCTION, found.level);
+
+  // A more resolved symbol supersedes the record, a less resolved one
+  // doesn't.
+  Symbol all(MakeSymbol(L"Foo"));
+  EXPECT_TRUE(store_.Insert(key, all));
+  EXPECT_EQ(2U, store_.num_entries());
+  ASSERT_TRUE(store_.Lookup(key, &found));
+  ExpectSymbolEquals(all, found);
+  EXPECT_EQ(SYMBOL_ALL, found.level);
+
+  EXPECT_TRUE(store_.Insert(key, function));
+  EXPECT_EQ(2U, store_.num_entries());
+  ASSERT_TRUE(store_.Lookup(key, &found));
+  EXPECT_EQ(SYMBOL_ALL, found.level);
+}
+
+TEST_F(SymbolStoreTest, PersistsInBlock) {
+  ModuleInformation module(MakeModule(L"chrome.dll"));
+  SymbolStore::Key key(SymbolStore::MakeKey(module, kBase + 0x10));
+  Symbol symbol(MakeSymbol(L"Foo"));
+  ASSERT_TRUE(store_.Insert(key, symbol));
+  store_.Detach();
+
+  // A copy of the block is as good as the original.
+  std::vector<uint8> copy(buffer_);
+  SymbolStore other;
+  ASSERT_TRUE(other.Attach(&copy[0], copy.size()));
+  Symbol found;
+  ASSERT_TRUE(other.Lookup(key, &found));
+  ExpectSymbolEquals(symbol, found);
+}
+
+TEST_F(SymbolStoreTest, RejectsBadBlocks) {
+  SymbolStore other;
+
+  // Wrong size.
+  EXPECT_FALSE(other.Attach(&buffer_[0], buffer_.size() - 4));
+
+  // Bad magic.
+  std::vector<uint8> copy(buffer_);
+  copy[0] ^= 0xFF;
+  EXPECT_FALSE(other.Attach(&copy[0], copy.size()));
+
+  // Garbage.
+  std::vector<uint8> garbage(buffer_.size(), 0xAB);
+  EXPECT_FALSE(other.Attach(&garbage[0], garbage.size()));
+  EXPECT_FALSE(other.is_attached());
+}
+
+TEST_F(SymbolStoreTest, SurvivesCorruptRecords) {
+  ModuleInformation module(MakeModule(L"chrome.dll"));
+  SymbolStore::Key key(SymbolStore::MakeKey(module, kBase + 0x10));
+  ASSERT_TRUE(store_.Insert(key, MakeSymbol(L"Foo")));
+
+  // Scribble over the heap, lookups must miss rather than crash.
+  size_t used = store_.used_size();
+  for (size_t i = used - 64; i < used; ++i)
+    buffer_[i] = 0xFF;
+
+  Symbol found;
+  store_.Lookup(key, &found);
+  SymbolStore::Key other_key(SymbolStore::MakeKey(module, kBase + 0x20));
+  EXPECT_FALSE(store_.Lookup(other_key, &found));
+}
+
+TEST_F(SymbolStoreTest, FillsUpAndCopies) {
+  ModuleInformation module(MakeModule(L"chrome.dll"));
+
+  // Fill the store up.
+  size_t num_inserted = 0;
+  while (true) {
+    std::wstring name(
+        base::StringPrintf(L"Function%d", static_cast<int>(num_inserted)));
+    SymbolStore::Key key(
+        SymbolStore::MakeKey(module, kBase + num_inserted * 16));
+    if (!store_.Insert(key, MakeSymbol(name.c_str())))
+      break;
+    ++num_inserted;
+  }
+  EXPECT_LT(10U, num_inserted);
+  EXPECT_EQ(num_inserted, store_.num_entries());
+  EXPECT_GE(buffer_.size(), store_.used_size());
+
+  // Too small a store to copy to fails.
+  std::vector<uint8> small_buffer(SymbolStore::kMinSize);
+  SymbolStore small_store;
+  SymbolStore::Format(&small_buffer[0], small_buffer.size());
+  ASSERT_TRUE(small_store.Attach(&small_buffer[0], small_buffer.size()));
+  ASSERT_TRUE(small_store.Insert(
+      SymbolStore::MakeKey(module, kBase + 1), MakeSymbol(L"Extra")));
+  EXPECT_FALSE(store_.CopyTo(&small_store));
+
+  // A larger store takes them all.
+  std::vector<uint8> large_buffer(SymbolStore::kMinSize * 4);
+  SymbolStore large_store;
+  SymbolStore::Format(&large_buffer[0], large_buffer.size());
+  ASSERT_TRUE(large_store.Attach(&large_buffer[0], large_buffer.size()));
+  ASSERT_TRUE(store_.CopyTo(&large_store));
+  EXPECT_EQ(num_inserted, large_store.num_entries());
+
+  for (size_t i = 0; i < num_inserted; ++i) {
+    std::wstring name(
+        base::StringPrintf(L"Function%d", static_cast<int>(i)));
+    Symbol found;
+    ASSERT_TRUE(large_store.Lookup(
+        SymbolStore::MakeKey(module, kBase + i * 16), &found));
+    EXPECT_EQ(name, found.name);
+  }
+}
+
+}  // namespace sym_util
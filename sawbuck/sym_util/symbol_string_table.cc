@@ -0,0 +1,97 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Symbol string table implementation.
+#include "sawbuck/sym_util/symbol_string_table.h"
+
+#include "base/logging.h"
+
+namespace sym_util {
+
+namespace {
+
+const std::wstring kEmptyString;
+
+}  // namespace
+
+SymbolRecord::SymbolRecord()
+    : module(&kEmptyString),
+      module_base(0),
+      name(&kEmptyString),
+      mangled_name(&kEmptyString),
+      file(&kEmptyString),
+      offset(0),
+      size(0),
+      line(0),
+      level(SYMBOL_ALL) {
+}
+
+void SymbolRecord::ToSymbol(Symbol* symbol) const {
+  DCHECK(symbol != NULL);
+  symbol->module = *module;
+  symbol->module_base = module_base;
+  symbol->name = *name;
+  symbol->mangled_name = *mangled_name;
+  symbol->offset = offset;
+  symbol->size = size;
+  symbol->file = *file;
+  symbol->line = line;
+  symbol->level = level;
+}
+
+SymbolStringTable::SymbolStringTable() {
+}
+
+SymbolStringTable::~SymbolStringTable() {
+}
+
+const std::wstring* SymbolStringTable::Intern(const std::wstring& str) {
+  if (str.empty())
+    return &kEmptyString;
+
+  base::AutoLock lock(lock_);
+  StringSet::const_iterator it(index_.find(&str));
+  if (it != index_.end())
+    return *it;
+
+  strings_.push_back(str);
+  const std::wstring* interned = &strings_.back();
+  index_.insert(interned);
+
+  return interned;
+}
+
+void SymbolStringTable::Intern(const Symbol& symbol, SymbolRecord* record) {
+  DCHECK(record != NULL);
+  record->module = Intern(symbol.module);
+  record->module_base = symbol.module_base;
+  record->name = Intern(symbol.name);
+  record->mangled_name = Intern(symbol.mangled_name);
+  record->file = Intern(symbol.file);
+  record->offset = static_cast<uint32>(symbol.offset);
+  record->size = static_cast<uint32>(symbol.size);
+  record->line = static_cast<uint32>(symbol.line);
+  record->level = symbol.level;
+}
+
+size_t SymbolStringTable::size() const {
+  base::AutoLock lock(lock_);
+  return strings_.size();
+}
+
+const std::wstring* SymbolStringTable::empty() {
+  return &kEmptyString;
+}
+
+}  // namespace sym_util
@@ -0,0 +1,94 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Symbol string table declaration.
+#ifndef SAWBUCK_SYM_UTIL_SYMBOL_STRING_TABLE_H_
+#define SAWBUCK_SYM_UTIL_SYMBOL_STRING_TABLE_H_
+
+#include <deque>
+#include <set>
+#include <string>
+#include "base/basictypes.h"
+#include "base/synchronization/lock.h"
+#include "sawbuck/sym_util/types.h"
+
+namespace sym_util {
+
+// A resolved symbol, whose strings are interned in a SymbolStringTable, so
+// that it copies as a few words rather than as four strings.
+struct SymbolRecord {
+  // Initializes an empty symbol, with empty strings.
+  SymbolRecord();
+
+  // Copies the symbol to @p symbol.
+  void ToSymbol(Symbol* symbol) const;
+
+  const std::wstring* module;
+  ModuleBase module_base;
+  const std::wstring* name;
+  const std::wstring* mangled_name;
+  const std::wstring* file;
+  uint32 offset;
+  uint32 size;
+  uint32 line;
+  SymbolLevel level;
+};
+
+// Interns the strings of resolved symbols. Symbol and file names repeat a
+// lot from frame to frame, and interned strings are never released, so
+// that records can refer to them for the lifetime of the table.
+// @note this class is thread safe.
+class SymbolStringTable {
+ public:
+  SymbolStringTable();
+  ~SymbolStringTable();
+
+  // Interns @p str.
+  // @returns the interned copy of @p str, which is valid for the lifetime
+  //     of the table.
+  const std::wstring* Intern(const std::wstring& str);
+
+  // Interns the strings of @p symbol, and copies it to @p record.
+  void Intern(const Symbol& symbol, SymbolRecord* record);
+
+  // @returns the number of distinct strings interned, but for the empty
+  //     string.
+  size_t size() const;
+
+  // @returns the empty string, which all tables and records share.
+  static const std::wstring* empty();
+
+ private:
+  struct StringLess {
+    bool operator()(const std::wstring* a, const std::wstring* b) const {
+      return *a < *b;
+    }
+  };
+
+  mutable base::Lock lock_;
+
+  // The interned strings. This is a deque so as to keep the strings in
+  // place as it grows.
+  std::deque<std::wstring> strings_;  // Under lock_.
+
+  // The strings in strings_, in order.
+  typedef std::set<const std::wstring*, StringLess> StringSet;
+  StringSet index_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(SymbolStringTable);
+};
+
+}  // namespace sym_util
+
+#endif  // SAWBUCK_SYM_UTIL_SYMBOL_STRING_TABLE_H_
@@ -0,0 +1,92 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Symbol string table unittests.
+#include "sawbuck/sym_util/symbol_string_table.h"
+
+#include "gtest/gtest.h"
+
+namespace sym_util {
+
+TEST(SymbolStringTableTest, EmptyString) {
+  SymbolStringTable table;
+
+  EXPECT_EQ(SymbolStringTable::empty(), table.Intern(L""));
+  EXPECT_EQ(0U, table.size());
+
+  SymbolRecord record;
+  EXPECT_EQ(SymbolStringTable::empty(), record.module);
+  EXPECT_EQ(SymbolStringTable::empty(), record.name);
+  EXPECT_EQ(SymbolStringTable::empty(), record.mangled_name);
+  EXPECT_EQ(SymbolStringTable::empty(), record.file);
+}
+
+TEST(SymbolStringTableTest, Intern) {
+  SymbolStringTable table;
+
+  const std::wstring* foo = table.Intern(L"Foo");
+  const std::wstring* bar = table.Intern(L"Bar");
+  EXPECT_EQ(L"Foo", *foo);
+  EXPECT_EQ(L"Bar", *bar);
+  EXPECT_NE(foo, bar);
+
+  // Interning again yields the same string, regardless of the storage of
+  // the string interned.
+  std::wstring foo_copy(L"Foo");
+  EXPECT_EQ(foo, table.Intern(foo_copy));
+  EXPECT_EQ(2U, table.size());
+
+  // The strings stay put as the table grows.
+  for (int i = 0; i < 10000; ++i)
+    table.Intern(std::wstring(i + 1, L'x'));
+  EXPECT_EQ(foo, table.Intern(L"Foo"));
+  EXPECT_EQ(L"Foo", *foo);
+}
+
+TEST(SymbolStringTableTest, Records) {
+  SymbolStringTable table;
+
+  Symbol symbol;
+  symbol.module = L"chrome.dll";
+  symbol.module_base = 0x10000000;
+  symbol.name = L"Foo";
+  symbol.mangled_name = L"?Foo@@YAXXZ";
+  symbol.offset = 4;
+  symbol.size = 16;
+  symbol.file = L"foo.cc";
+  symbol.line = 10;
+
+  SymbolRecord first;
+  SymbolRecord second;
+  table.Intern(symbol, &first);
+  table.Intern(symbol, &second);
+
+  // The records share the strings.
+  EXPECT_EQ(first.name, second.name);
+  EXPECT_EQ(first.file, second.file);
+  EXPECT_EQ(4U, table.size());
+
+  Symbol copy;
+  first.ToSymbol(&copy);
+  EXPECT_EQ(symbol.module, copy.module);
+  EXPECT_EQ(symbol.module_base, copy.module_base);
+  EXPECT_EQ(symbol.name, copy.name);
+  EXPECT_EQ(symbol.mangled_name, copy.mangled_name);
+  EXPECT_EQ(symbol.offset, copy.offset);
+  EXPECT_EQ(symbol.size, copy.size);
+  EXPECT_EQ(symbol.file, copy.file);
+  EXPECT_EQ(symbol.line, copy.line);
+}
+
+}  // namespace sym_util
@@ -46,9 +46,25 @@ struct ModuleInformation {
   std::wstring image_file_name;
 };
 
+// How much of a symbol to resolve, each level adding to the one before,
+// so that callers pay only for the parts they show.
+enum SymbolLevel {
+  // Only the module and the offset into it, which the module loads give
+  // without any symbols. These are never cached.
+  SYMBOL_MODULE = 0,
+  // The function's name, offset and size.
+  SYMBOL_FUNCTION = 1,
+  // And its source file and line.
+  SYMBOL_LINE,
+  // And its mangled name.
+  SYMBOL_MANGLED_NAME,
+
+  SYMBOL_ALL = SYMBOL_MANGLED_NAME
+};
+
 // A resolved symbol.
 struct Symbol {
-  Symbol() : offset(0), line(0) {
+  Symbol() : offset(0), line(0), level(SYMBOL_ALL) {
   }
 
   // The module name.
@@ -68,6 +84,9 @@ struct Symbol {
   // Source file and line number, if available.
   std::wstring file;
   size_t line;
+
+  // The parts of the symbol that were resolved, the rest are left empty.
+  SymbolLevel level;
 };
 
 }  // namespace types
@@ -0,0 +1,151 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Aho-Corasick multi-literal matcher implementation.
+#include "sawbuck/viewer/aho_corasick.h"
+
+#include <string.h>
+#include <deque>
+#include "base/logging.h"
+
+namespace {
+
+inline char ToLowerASCII(char c) {
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+}  // namespace
+
+AhoCorasickMatcher::AhoCorasickMatcher()
+    : flags_(0), built_(false), num_classes_(1) {
+  memset(byte_class_, 0, sizeof(byte_class_));
+}
+
+AhoCorasickMatcher::~AhoCorasickMatcher() {
+}
+
+void AhoCorasickMatcher::AddLiteral(const base::StringPiece& literal,
+                                    uint8 flags) {
+  DCHECK(!built_);
+  DCHECK_NE(0, flags);
+
+  std::string lowered;
+  lowered.reserve(literal.size());
+  for (size_t i = 0; i < literal.size(); ++i)
+    lowered.push_back(ToLowerASCII(literal[i]));
+
+  literals_.push_back(std::make_pair(lowered, flags));
+  flags_ |= flags;
+}
+
+void AhoCorasickMatcher::Build() {
+  DCHECK(!built_);
+  built_ = true;
+
+  // Assign a class to each distinct byte in the literals, and its upper
+  // case to the same class.
+  for (size_t i = 0; i < literals_.size(); ++i) {
+    const std::string& literal = literals_[i].first;
+    for (size_t j = 0; j < literal.size(); ++j) {
+      uint8 c = static_cast<uint8>(literal[j]);
+      if (byte_class_[c] == 0) {
+        DCHECK_LT(num_classes_, 256U);
+        byte_class_[c] = static_cast<uint8>(num_classes_++);
+      }
+    }
+  }
+  for (char c = 'A'; c <= 'Z'; ++c) {
+    byte_class_[static_cast<uint8>(c)] =
+        byte_class_[static_cast<uint8>(ToLowerASCII(c))];
+  }
+
+  // Build the trie, with -1 for missing transitions.
+  next_.assign(num_classes_, -1);
+  state_flags_.assign(1, 0);
+  for (size_t i = 0; i < literals_.size(); ++i) {
+    const std::string& literal = literals_[i].first;
+    int32 state = 0;
+    for (size_t j = 0; j < literal.size(); ++j) {
+      size_t index = state * num_classes_ +
+          byte_class_[static_cast<uint8>(literal[j])];
+      if (next_[index] == -1) {
+        next_[index] = static_cast<int32>(state_flags_.size());
+        next_.resize(next_.size() + num_classes_, -1);
+        state_flags_.push_back(0);
+      }
+      state = next_[index];
+    }
+    state_flags_[state] |= literals_[i].second;
+  }
+
+  // Walk the trie breadth first, filling in the missing transitions from
+  // the failure states, and inheriting the failure states' flags. A state's
+  // failure state is shallower, so it's always complete by then.
+  std::vector<int32> failure(state_flags_.size(), 0);
+  std::deque<int32> queue;
+  for (size_t c = 0; c < num_classes_; ++c) {
+    int32 child = next_[c];
+    if (child == -1) {
+      next_[c] = 0;
+    } else {
+      failure[child] = 0;
+      queue.push_back(child);
+    }
+  }
+
+  while (!queue.empty()) {
+    int32 state = queue.front();
+    queue.pop_front();
+    state_flags_[state] |= state_flags_[failure[state]];
+
+    size_t base = state * num_classes_;
+    size_t failure_base = failure[state] * num_classes_;
+    for (size_t c = 0; c < num_classes_; ++c) {
+      int32 child = next_[base + c];
+      if (child == -1) {
+        next_[base + c] = next_[failure_base + c];
+      } else {
+        failure[child] = next_[failure_base + c];
+        queue.push_back(child);
+      }
+    }
+  }
+}
+
+uint8 AhoCorasickMatcher::Match(const base::StringPiece& text,
+                                uint8 stop_flags) const {
+  DCHECK(built_);
+
+  // The start state yields the flags of any empty literals.
+  uint8 found = state_flags_[0];
+  if ((found & stop_flags) != 0)
+    return found;
+
+  const int32* next = &next_[0];
+  const uint8* state_flags = &state_flags_[0];
+  size_t num_classes = num_classes_;
+  int32 state = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    state = next[state * num_classes +
+                 byte_class_[static_cast<uint8>(text[i])]];
+    uint8 flags = state_flags[state];
+    if (flags != 0) {
+      found |= flags;
+      if ((found & stop_flags) != 0)
+        break;
+    }
+  }
+
+  return found;
+}
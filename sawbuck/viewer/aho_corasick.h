@@ -0,0 +1,75 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Aho-Corasick multi-literal matcher declaration.
+#ifndef SAWBUCK_VIEWER_AHO_CORASICK_H_
+#define SAWBUCK_VIEWER_AHO_CORASICK_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+
+// Searches text for any number of literals at once, ignoring ASCII case,
+// in a single pass over the text.
+//
+// Each literal carries a set of flag bits, and a search yields the union
+// of the flags of the literals found. The literals are compiled to a
+// deterministic automaton over the classes of bytes that occur in them,
+// which keeps the transition table small.
+class AhoCorasickMatcher {
+ public:
+  AhoCorasickMatcher();
+  ~AhoCorasickMatcher();
+
+  // Adds a literal to search for. Must be called before Build().
+  // @param literal the literal, an empty literal is found in all text.
+  // @param flags the non-zero flags to yield when @p literal is found.
+  void AddLiteral(const base::StringPiece& literal, uint8 flags);
+
+  // Compiles the literals added so far. Must be called before Match().
+  void Build();
+
+  // Searches @p text for our literals.
+  // @param stop_flags the search stops as soon as any of these are found.
+  // @returns the union of the flags of the literals found.
+  uint8 Match(const base::StringPiece& text, uint8 stop_flags) const;
+
+  // @returns the number of literals added.
+  size_t num_literals() const { return literals_.size(); }
+
+  // @returns the union of the flags of all literals.
+  uint8 flags() const { return flags_; }
+
+ private:
+  // The literals, lower cased, and their flags.
+  typedef std::vector<std::pair<std::string, uint8> > LiteralList;
+  LiteralList literals_;
+  uint8 flags_;
+
+  bool built_;
+  // Maps each byte to its class, class 0 being the bytes that occur in
+  // no literal.
+  uint8 byte_class_[256];
+  size_t num_classes_;
+  // The transitions, num_classes_ per state, state 0 being the start.
+  std::vector<int32> next_;
+  // The flags yielded on entering each state.
+  std::vector<uint8> state_flags_;
+
+  DISALLOW_COPY_AND_ASSIGN(AhoCorasickMatcher);
+};
+
+#endif  // SAWBUCK_VIEWER_AHO_CORASICK_H_
@@ -0,0 +1,117 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/aho_corasick.h"
+
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/pattern_matcher.h"
+
+namespace {
+
+const uint8 kFlagA = 1 << 0;
+const uint8 kFlagB = 1 << 1;
+const uint8 kFlagC = 1 << 2;
+const uint8 kAllFlags = kFlagA | kFlagB | kFlagC;
+
+TEST(AhoCorasickMatcherTest, NoLiterals) {
+  AhoCorasickMatcher matcher;
+  matcher.Build();
+  EXPECT_EQ(0U, matcher.num_literals());
+  EXPECT_EQ(0, matcher.flags());
+  EXPECT_EQ(0, matcher.Match("", kAllFlags));
+  EXPECT_EQ(0, matcher.Match("some text", kAllFlags));
+}
+
+TEST(AhoCorasickMatcherTest, Match) {
+  AhoCorasickMatcher matcher;
+  matcher.AddLiteral("he", kFlagA);
+  matcher.AddLiteral("SHE", kFlagB);
+  matcher.AddLiteral("hers", kFlagC);
+  matcher.AddLiteral("his", kFlagC);
+  matcher.Build();
+  EXPECT_EQ(4U, matcher.num_literals());
+  EXPECT_EQ(kAllFlags, matcher.flags());
+
+  EXPECT_EQ(0, matcher.Match("", 0));
+  EXPECT_EQ(0, matcher.Match("h e r s", 0));
+  EXPECT_EQ(kFlagA, matcher.Match("The end", 0));
+  EXPECT_EQ(kFlagA | kFlagB, matcher.Match("ushe", 0));
+  EXPECT_EQ(kFlagA | kFlagC, matcher.Match("HERS", 0));
+  EXPECT_EQ(kAllFlags, matcher.Match("ushers", 0));
+  EXPECT_EQ(kFlagC, matcher.Match("this", 0));
+  EXPECT_EQ(kFlagA | kFlagC, matcher.Match("hhis hhe", 0));
+}
+
+TEST(AhoCorasickMatcherTest, StopFlags) {
+  AhoCorasickMatcher matcher;
+  matcher.AddLiteral("first", kFlagA);
+  matcher.AddLiteral("second", kFlagB);
+  matcher.Build();
+
+  const char kText[] = "first, then second";
+  EXPECT_EQ(kFlagA | kFlagB, matcher.Match(kText, 0));
+  EXPECT_EQ(kFlagA, matcher.Match(kText, kFlagA));
+  EXPECT_EQ(kFlagA | kFlagB, matcher.Match(kText, kFlagB));
+}
+
+TEST(AhoCorasickMatcherTest, EmptyLiteral) {
+  AhoCorasickMatcher matcher;
+  matcher.AddLiteral("", kFlagA);
+  matcher.AddLiteral("x", kFlagB);
+  matcher.Build();
+
+  EXPECT_EQ(kFlagA, matcher.Match("", 0));
+  EXPECT_EQ(kFlagA, matcher.Match("abc", 0));
+  EXPECT_EQ(kFlagA | kFlagB, matcher.Match("xyz", 0));
+}
+
+TEST(AhoCorasickMatcherTest, AgreesWithSearcher) {
+  const char* kLiterals[] = {
+    "aab", "ab", "abab", "b", "#1", "ing the", "\xC3\xA9t\xC3\xA9",
+  };
+  const char* kTexts[] = {
+    "", "a", "aaab", "AABAB", "bbbb", "Closing the file #12", "abaab",
+    "\xC3\xA9t\xC3\xA9", "\xC3\x89T\xC3\x89",
+  };
+
+  // Each literal on its own agrees with a plain search.
+  for (size_t i = 0; i < arraysize(kLiterals); ++i) {
+    AhoCorasickMatcher matcher;
+    matcher.AddLiteral(kLiterals[i], kFlagA);
+    matcher.Build();
+
+    CaselessSearcher searcher(kLiterals[i]);
+    for (size_t j = 0; j < arraysize(kTexts); ++j) {
+      EXPECT_EQ(searcher.Find(kTexts[j]) ? kFlagA : 0,
+                matcher.Match(kTexts[j], 0))
+          << "'" << kLiterals[i] << "' in '" << kTexts[j] << "'";
+    }
+  }
+
+  // And so do all of them together, each with its own flag.
+  AhoCorasickMatcher matcher;
+  for (size_t i = 0; i < arraysize(kLiterals); ++i)
+    matcher.AddLiteral(kLiterals[i], 1 << i);
+  matcher.Build();
+
+  for (size_t j = 0; j < arraysize(kTexts); ++j) {
+    uint8 expected = 0;
+    for (size_t i = 0; i < arraysize(kLiterals); ++i) {
+      if (CaselessSearcher(kLiterals[i]).Find(kTexts[j]))
+        expected |= 1 << i;
+    }
+    EXPECT_EQ(expected, matcher.Match(kTexts[j], 0)) << kTexts[j];
+  }
+}
+
+}  // namespace
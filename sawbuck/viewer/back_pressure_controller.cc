@@ -0,0 +1,112 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// Back-pressure controller implementation.
+#include "sawbuck/viewer/back_pressure_controller.h"
+
+#include <algorithm>
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+
+namespace {
+
+// @returns the name of @p level, as ETW defines them.
+const char* GetLevelName(UCHAR level) {
+  static const char* const kLevelNames[] = {
+      "none", "fatal", "error", "warning", "information", "verbose" };
+  if (level < arraysize(kLevelNames))
+    return kLevelNames[level];
+  return "verbose";
+}
+
+}  // namespace
+
+BackPressureController::BackPressureController(UCHAR floor, int calm_samples)
+    : floor_(floor), calm_samples_(calm_samples), calm_(0) {
+  DCHECK_LT(0, calm_samples);
+}
+
+BackPressureController::~BackPressureController() {
+}
+
+void BackPressureController::Reset(const std::vector<UCHAR>& levels) {
+  configured_levels_ = levels;
+  levels_ = levels;
+  lowered_.clear();
+  calm_ = 0;
+}
+
+void BackPressureController::SetConfiguredLevel(size_t provider,
+                                                UCHAR level) {
+  DCHECK_LT(provider, levels_.size());
+  configured_levels_[provider] = level;
+  levels_[provider] = level;
+  lowered_.erase(std::remove(lowered_.begin(), lowered_.end(), provider),
+                 lowered_.end());
+}
+
+void BackPressureController::Sample(bool behind,
+                                    const std::vector<double>& rates,
+                                    std::vector<size_t>* changed) {
+  DCHECK(changed != NULL);
+  changed->clear();
+
+  if (!behind) {
+    if (lowered_.empty() || ++calm_ < calm_samples_)
+      return;
+
+    // A level at a time, so that a provider that proves too noisy again
+    // costs no more than a level's worth of falling behind.
+    calm_ = 0;
+    size_t provider = lowered_.back();
+    lowered_.pop_back();
+    DCHECK_LT(levels_[provider], configured_levels_[provider]);
+    ++levels_[provider];
+    changed->push_back(provider);
+    return;
+  }
+
+  calm_ = 0;
+  // The noisiest provider left above the floor, the most verbose of those
+  // equally noisy.
+  size_t noisiest = levels_.size();
+  double noisiest_rate = 0;
+  for (size_t i = 0; i < levels_.size(); ++i) {
+    if (levels_[i] <= floor_)
+      continue;
+    double rate = i < rates.size() ? rates[i] : 0;
+    if (noisiest == levels_.size() || rate > noisiest_rate ||
+        (rate == noisiest_rate && levels_[i] > levels_[noisiest])) {
+      noisiest = i;
+      noisiest_rate = rate;
+    }
+  }
+  if (noisiest == levels_.size())
+    return;
+
+  --levels_[noisiest];
+  lowered_.push_back(noisiest);
+  changed->push_back(noisiest);
+}
+
+std::string FormatLevelChange(const std::string& provider_name,
+                              UCHAR old_level,
+                              UCHAR new_level) {
+  return base::StringPrintf(
+      "%s the level of %s from %s to %s, as the capture %s",
+      new_level < old_level ? "Lowered" : "Restored",
+      provider_name.c_str(),
+      GetLevelName(old_level),
+      GetLevelName(new_level),
+      new_level < old_level ? "fell behind" : "caught up");
+}
@@ -0,0 +1,90 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// Back-pressure controller declaration.
+#ifndef SAWBUCK_VIEWER_BACK_PRESSURE_CONTROLLER_H_
+#define SAWBUCK_VIEWER_BACK_PRESSURE_CONTROLLER_H_
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+
+// Decides which providers to log less from, and when to restore them, when
+// the capture can't keep up. Past the ceiling of the session buffers, a
+// session that falls behind loses whatever events ETW can't deliver, which
+// skews the log unpredictably. Lowering the level of the noisiest provider
+// instead drops its most verbose events, and only those.
+// Each sample in which ingest fell behind lowers the noisiest provider
+// still above the floor by a level. Once there's been no falling behind for
+// a number of samples in a row, the last provider lowered gets a level
+// back, and so on until all are at their configured levels.
+// The controller doesn't touch the sessions, the samples are passed in and
+// the changes passed back, which makes it easy to test.
+class BackPressureController {
+ public:
+  // @param floor the level no provider is lowered past, e.g.
+  //     TRACE_LEVEL_WARNING to keep the warnings and errors.
+  // @param calm_samples the samples in a row without falling behind
+  //     before a level is restored, at least one.
+  BackPressureController(UCHAR floor, int calm_samples);
+  ~BackPressureController();
+
+  // Starts over with providers at @p levels, a zero level being that of a
+  // provider that isn't enabled, with none lowered.
+  void Reset(const std::vector<UCHAR>& levels);
+
+  // Sets the configured level of @p provider to @p level, which it's then
+  // at, dropping any lowering of it.
+  void SetConfiguredLevel(size_t provider, UCHAR level);
+
+  // Takes a sample.
+  // @param behind true iff ingest fell behind since the last sample.
+  // @param rates the events per second of each provider since the last
+  //     sample, which rank the providers to lower. Missing rates are zero.
+  // @param changed returns the providers whose level changed, see level.
+  void Sample(bool behind,
+              const std::vector<double>& rates,
+              std::vector<size_t>* changed);
+
+  // @returns the level @p provider is to be at.
+  UCHAR level(size_t provider) const { return levels_[provider]; }
+  // @returns the level @p provider was configured at.
+  UCHAR configured_level(size_t provider) const {
+    return configured_levels_[provider];
+  }
+  size_t num_providers() const { return levels_.size(); }
+  // @returns true iff any provider is below its configured level.
+  bool is_lowered() const { return !lowered_.empty(); }
+
+ private:
+  const UCHAR floor_;
+  const int calm_samples_;
+
+  std::vector<UCHAR> configured_levels_;
+  std::vector<UCHAR> levels_;
+  // The providers lowered, a level per entry, the last lowered last.
+  std::vector<size_t> lowered_;
+  // The samples since ingest last fell behind.
+  int calm_;
+
+  DISALLOW_COPY_AND_ASSIGN(BackPressureController);
+};
+
+// @returns the message of the marker row of a change of the level of
+//     @p provider_name from @p old_level to @p new_level.
+std::string FormatLevelChange(const std::string& provider_name,
+                              UCHAR old_level,
+                              UCHAR new_level);
+
+#endif  // SAWBUCK_VIEWER_BACK_PRESSURE_CONTROLLER_H_
@@ -0,0 +1,139 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// Back-pressure controller unittests.
+#include "sawbuck/viewer/back_pressure_controller.h"
+
+#include <evntrace.h>
+#include "gtest/gtest.h"
+
+namespace {
+
+class BackPressureControllerTest : public testing::Test {
+ public:
+  BackPressureControllerTest() : controller_(TRACE_LEVEL_WARNING, 2) {
+  }
+
+  virtual void SetUp() {
+    // A verbose provider, an informational one, and one that's disabled.
+    std::vector<UCHAR> levels;
+    levels.push_back(TRACE_LEVEL_VERBOSE);
+    levels.push_back(TRACE_LEVEL_INFORMATION);
+    levels.push_back(0);
+    controller_.Reset(levels);
+  }
+
+ protected:
+  BackPressureController controller_;
+  std::vector<size_t> changed_;
+};
+
+}  // namespace
+
+TEST_F(BackPressureControllerTest, LeavesKeptUpCaptureAlone) {
+  std::vector<double> rates;
+  for (int i = 0; i < 5; ++i) {
+    controller_.Sample(false, rates, &changed_);
+    EXPECT_TRUE(changed_.empty());
+  }
+  EXPECT_FALSE(controller_.is_lowered());
+  EXPECT_EQ(TRACE_LEVEL_VERBOSE, controller_.level(0));
+}
+
+TEST_F(BackPressureControllerTest, LowersNoisiestProviderToFloor) {
+  std::vector<double> rates;
+  rates.push_back(10);
+  rates.push_back(1000);
+  rates.push_back(5000);
+
+  // The disabled provider isn't lowered, however noisy.
+  controller_.Sample(true, rates, &changed_);
+  ASSERT_EQ(1U, changed_.size());
+  EXPECT_EQ(1U, changed_[0]);
+  EXPECT_EQ(TRACE_LEVEL_WARNING, controller_.level(1));
+  EXPECT_TRUE(controller_.is_lowered());
+
+  // Past the floor, the next noisiest goes down.
+  controller_.Sample(true, rates, &changed_);
+  ASSERT_EQ(1U, changed_.size());
+  EXPECT_EQ(0U, changed_[0]);
+  EXPECT_EQ(TRACE_LEVEL_INFORMATION, controller_.level(0));
+
+  controller_.Sample(true, rates, &changed_);
+  ASSERT_EQ(1U, changed_.size());
+  EXPECT_EQ(TRACE_LEVEL_WARNING, controller_.level(0));
+
+  // All are at the floor.
+  controller_.Sample(true, rates, &changed_);
+  EXPECT_TRUE(changed_.empty());
+  EXPECT_EQ(0, controller_.level(2));
+}
+
+TEST_F(BackPressureControllerTest, PrefersMostVerboseWithoutRates) {
+  controller_.Sample(true, std::vector<double>(), &changed_);
+  ASSERT_EQ(1U, changed_.size());
+  EXPECT_EQ(0U, changed_[0]);
+  EXPECT_EQ(TRACE_LEVEL_INFORMATION, controller_.level(0));
+}
+
+TEST_F(BackPressureControllerTest, RestoresLastLoweredFirst) {
+  std::vector<double> rates;
+  rates.push_back(1000);
+  rates.push_back(10);
+  controller_.Sample(true, rates, &changed_);
+  controller_.Sample(true, rates, &changed_);
+  EXPECT_EQ(TRACE_LEVEL_WARNING, controller_.level(0));
+
+  // Falling behind again starts the calm over.
+  controller_.Sample(false, rates, &changed_);
+  EXPECT_TRUE(changed_.empty());
+  controller_.Sample(true, rates, &changed_);
+  EXPECT_EQ(1U, changed_[0]);
+  EXPECT_EQ(TRACE_LEVEL_WARNING, controller_.level(1));
+
+  controller_.Sample(false, rates, &changed_);
+  EXPECT_TRUE(changed_.empty());
+  controller_.Sample(false, rates, &changed_);
+  ASSERT_EQ(1U, changed_.size());
+  EXPECT_EQ(1U, changed_[0]);
+  EXPECT_EQ(TRACE_LEVEL_INFORMATION, controller_.level(1));
+
+  for (int i = 0; i < 4; ++i)
+    controller_.Sample(false, rates, &changed_);
+  EXPECT_EQ(TRACE_LEVEL_VERBOSE, controller_.level(0));
+  EXPECT_FALSE(controller_.is_lowered());
+
+  controller_.Sample(false, rates, &changed_);
+  EXPECT_TRUE(changed_.empty());
+}
+
+TEST_F(BackPressureControllerTest, ConfiguredLevelDropsLowering) {
+  controller_.Sample(true, std::vector<double>(), &changed_);
+  EXPECT_TRUE(controller_.is_lowered());
+
+  controller_.SetConfiguredLevel(0, TRACE_LEVEL_ERROR);
+  EXPECT_FALSE(controller_.is_lowered());
+  EXPECT_EQ(TRACE_LEVEL_ERROR, controller_.level(0));
+  EXPECT_EQ(TRACE_LEVEL_ERROR, controller_.configured_level(0));
+}
+
+TEST(FormatLevelChangeTest, Format) {
+  EXPECT_EQ("Lowered the level of Chrome from verbose to information, as "
+                "the capture fell behind",
+            FormatLevelChange("Chrome", TRACE_LEVEL_VERBOSE,
+                              TRACE_LEVEL_INFORMATION));
+  EXPECT_EQ("Restored the level of Chrome from information to verbose, as "
+                "the capture caught up",
+            FormatLevelChange("Chrome", TRACE_LEVEL_INFORMATION,
+                              TRACE_LEVEL_VERBOSE));
+}
@@ -0,0 +1,331 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Capture spill implementation.
+#include "sawbuck/viewer/capture_spill.h"
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "sawbuck/common/buffer_parser.h"
+#include "sawbuck/viewer/log_store.h"
+
+namespace {
+
+// All sections of a block are aligned to this.
+const size_t kBlockAlignment = 8;
+
+// Each block starts with this header, which is followed by these sections,
+// in order:
+//   UCHAR levels[num_rows]
+//   DWORD process_ids[num_rows]
+//   DWORD thread_ids[num_rows]
+//   int64 times[num_rows]
+//   uint32 files[num_rows] - the file atoms.
+//   int32 lines[num_rows]
+//   uint32 message_ends[num_rows] - end offset of each message.
+//   char messages[message_bytes]
+//   uint32 trace_ends[num_rows] - end index of each trace.
+//   uint64 traces[num_trace_addresses]
+struct BlockHeader {
+  // The size of the block, this header included.
+  uint64 block_bytes;
+  uint32 num_rows;
+  uint32 num_trace_addresses;
+  uint32 message_bytes;
+  uint32 reserved;
+};
+
+void Align(std::string* buffer) {
+  buffer->resize((buffer->size() + kBlockAlignment - 1) &
+                 ~(kBlockAlignment - 1));
+}
+
+template <class T>
+void AppendArray(const std::vector<T>& values, std::string* buffer) {
+  if (!values.empty()) {
+    buffer->append(reinterpret_cast<const char*>(&values[0]),
+                   values.size() * sizeof(values[0]));
+  }
+  Align(buffer);
+}
+
+template <class T>
+bool ReadArray(BinaryBufferReader* reader, size_t count, const T** values) {
+  return reader->Read(count * sizeof(T), values) &&
+      reader->Align(kBlockAlignment);
+}
+
+}  // namespace
+
+void CaptureSpill::Block::Clear() {
+  levels.clear();
+  process_ids.clear();
+  thread_ids.clear();
+  times.clear();
+  files.clear();
+  lines.clear();
+  message_ends.clear();
+  messages.clear();
+  trace_ends.clear();
+  traces.clear();
+}
+
+CaptureSpill::CaptureSpill()
+    : num_rows_(0), file_(NULL), file_bytes_(0), file_failed_(false) {
+}
+
+CaptureSpill::~CaptureSpill() {
+  Clear();
+}
+
+void CaptureSpill::AddRow(UCHAR level,
+                          DWORD process_id,
+                          DWORD thread_id,
+                          const base::Time& time,
+                          StringTable::Atom file,
+                          int line,
+                          const base::StringPiece& message,
+                          size_t trace_depth,
+                          const sym_util::Address* traces) {
+  block_.levels.push_back(level);
+  block_.process_ids.push_back(process_id);
+  block_.thread_ids.push_back(thread_id);
+  block_.times.push_back(time.ToInternalValue());
+  block_.files.push_back(file);
+  block_.lines.push_back(line);
+  block_.messages.append(message.data(), message.size());
+  block_.message_ends.push_back(block_.messages.size());
+  if (trace_depth != 0)
+    block_.traces.insert(block_.traces.end(), traces, traces + trace_depth);
+  block_.trace_ends.push_back(block_.traces.size());
+  ++num_rows_;
+
+  if (block_.levels.size() == kRowsPerBlock)
+    SealBlock();
+}
+
+bool CaptureSpill::AppendTo(LogStore* store) {
+  DCHECK(store != NULL);
+
+  bool ok = true;
+  if (file_ != NULL) {
+    // The file is read back from the start, a block at a time.
+    if (fflush(file_) != 0 || fseek(file_, 0, SEEK_SET) != 0) {
+      ok = false;
+    } else {
+      for (int64 read = 0; ok && read < file_bytes_; read += buffer_.size()) {
+        ok = ReadBlock(&buffer_) &&
+            AppendBlock(buffer_.data(), buffer_.size(), store);
+      }
+    }
+    if (!ok) {
+      LOG(ERROR) << "Failed to read back the spill \"" << path_.value()
+                 << "\".";
+    }
+  }
+
+  for (size_t i = 0; ok && i < memory_blocks_.size(); ++i) {
+    const std::string& block = memory_blocks_[i];
+    ok = AppendBlock(block.data(), block.size(), store);
+  }
+
+  if (ok && !block_.levels.empty()) {
+    PackBlock(block_, &buffer_);
+    ok = AppendBlock(buffer_.data(), buffer_.size(), store);
+  }
+
+  Clear();
+  return ok;
+}
+
+void CaptureSpill::Clear() {
+  block_.Clear();
+  num_rows_ = 0;
+  CloseFile();
+  memory_blocks_.clear();
+  file_failed_ = false;
+  buffer_.clear();
+}
+
+void CaptureSpill::PackBlock(const Block& block, std::string* buffer) {
+  DCHECK(buffer != NULL);
+
+  BlockHeader header = {};
+  header.num_rows = block.levels.size();
+  header.num_trace_addresses = block.traces.size();
+  header.message_bytes = block.messages.size();
+
+  buffer->clear();
+  buffer->append(reinterpret_cast<const char*>(&header), sizeof(header));
+  Align(buffer);
+  AppendArray(block.levels, buffer);
+  AppendArray(block.process_ids, buffer);
+  AppendArray(block.thread_ids, buffer);
+  AppendArray(block.times, buffer);
+  AppendArray(block.files, buffer);
+  AppendArray(block.lines, buffer);
+  AppendArray(block.message_ends, buffer);
+  buffer->append(block.messages);
+  Align(buffer);
+  AppendArray(block.trace_ends, buffer);
+  AppendArray(block.traces, buffer);
+
+  reinterpret_cast<BlockHeader*>(&(*buffer)[0])->block_bytes =
+      buffer->size();
+}
+
+bool CaptureSpill::AppendBlock(const char* data,
+                               size_t size,
+                               LogStore* store) {
+  DCHECK(data != NULL);
+  DCHECK(store != NULL);
+
+  BinaryBufferReader reader(data, size);
+  const BlockHeader* header = NULL;
+  if (!reader.Read(&header) || !reader.Align(kBlockAlignment) ||
+      header->block_bytes != size) {
+    return false;
+  }
+
+  size_t num_rows = header->num_rows;
+  const UCHAR* levels = NULL;
+  const DWORD* process_ids = NULL;
+  const DWORD* thread_ids = NULL;
+  const int64* times = NULL;
+  const StringTable::Atom* files = NULL;
+  const int32* lines = NULL;
+  const uint32* message_ends = NULL;
+  const char* messages = NULL;
+  const uint32* trace_ends = NULL;
+  const sym_util::Address* traces = NULL;
+  if (!ReadArray(&reader, num_rows, &levels) ||
+      !ReadArray(&reader, num_rows, &process_ids) ||
+      !ReadArray(&reader, num_rows, &thread_ids) ||
+      !ReadArray(&reader, num_rows, &times) ||
+      !ReadArray(&reader, num_rows, &files) ||
+      !ReadArray(&reader, num_rows, &lines) ||
+      !ReadArray(&reader, num_rows, &message_ends) ||
+      !ReadArray(&reader, header->message_bytes, &messages) ||
+      !ReadArray(&reader, num_rows, &trace_ends) ||
+      !ReadArray(&reader, header->num_trace_addresses, &traces)) {
+    return false;
+  }
+
+  // Check the row references before we append anything.
+  uint32 message_begin = 0;
+  uint32 trace_begin = 0;
+  for (size_t row = 0; row < num_rows; ++row) {
+    if (message_ends[row] < message_begin ||
+        message_ends[row] > header->message_bytes ||
+        trace_ends[row] < trace_begin ||
+        trace_ends[row] > header->num_trace_addresses) {
+      return false;
+    }
+    message_begin = message_ends[row];
+    trace_begin = trace_ends[row];
+  }
+
+  message_begin = 0;
+  trace_begin = 0;
+  for (size_t row = 0; row < num_rows; ++row) {
+    size_t trace_depth = trace_ends[row] - trace_begin;
+    store->AddRow(levels[row],
+                  process_ids[row],
+                  thread_ids[row],
+                  base::Time::FromInternalValue(times[row]),
+                  files[row],
+                  lines[row],
+                  base::StringPiece(messages + message_begin,
+                                    message_ends[row] - message_begin),
+                  trace_depth,
+                  trace_depth == 0 ? NULL : traces + trace_begin);
+
+    message_begin = message_ends[row];
+    trace_begin = trace_ends[row];
+  }
+
+  return true;
+}
+
+void CaptureSpill::SealBlock() {
+  if (block_.levels.empty())
+    return;
+
+  PackBlock(block_, &buffer_);
+  block_.Clear();
+
+  if (OpenFile()) {
+    if (fwrite(buffer_.data(), 1, buffer_.size(), file_) == buffer_.size()) {
+      file_bytes_ += buffer_.size();
+      return;
+    }
+
+    // The blocks written before stay good, as the file is only read back
+    // up to file_bytes_.
+    LOG(ERROR) << "Failed to write the spill \"" << path_.value() << "\".";
+    file_failed_ = true;
+  }
+
+  memory_blocks_.push_back(std::string());
+  memory_blocks_.back().swap(buffer_);
+}
+
+bool CaptureSpill::OpenFile() {
+  if (file_ != NULL)
+    return true;
+  if (file_failed_)
+    return false;
+
+  if (directory_.empty())
+    file_ = base::CreateAndOpenTemporaryFile(&path_);
+  else
+    file_ = base::CreateAndOpenTemporaryFileInDir(directory_, &path_);
+  if (file_ == NULL) {
+    LOG(ERROR) << "Failed to create a spill file, spilling to memory.";
+    file_failed_ = true;
+    return false;
+  }
+
+  file_bytes_ = 0;
+  return true;
+}
+
+void CaptureSpill::CloseFile() {
+  if (file_ == NULL)
+    return;
+
+  file_util::CloseFile(file_);
+  file_ = NULL;
+  base::DeleteFile(path_, false);
+  path_.clear();
+  file_bytes_ = 0;
+}
+
+bool CaptureSpill::ReadBlock(std::string* buffer) {
+  DCHECK(file_ != NULL);
+  DCHECK(buffer != NULL);
+
+  BlockHeader header = {};
+  if (fread(&header, sizeof(header), 1, file_) != 1 ||
+      header.block_bytes < sizeof(header) ||
+      header.block_bytes > static_cast<uint64>(file_bytes_)) {
+    return false;
+  }
+
+  size_t rest = static_cast<size_t>(header.block_bytes) - sizeof(header);
+  buffer->resize(static_cast<size_t>(header.block_bytes));
+  memcpy(&(*buffer)[0], &header, sizeof(header));
+  return rest == 0 ||
+      fread(&(*buffer)[sizeof(header)], 1, rest, file_) == rest;
+}
@@ -0,0 +1,134 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Capture spill declaration.
+#ifndef SAWBUCK_VIEWER_CAPTURE_SPILL_H_
+#define SAWBUCK_VIEWER_CAPTURE_SPILL_H_
+
+#include <windows.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+#include "sawbuck/log_lib/string_table.h"
+#include "sawbuck/sym_util/types.h"
+
+class LogStore;
+
+// Holds the rows captured while the capture is paused, so they reach
+// neither the store nor the views until it resumes. The rows are packed
+// column-wise into blocks of kRowsPerBlock rows, laid out as a log index
+// lays out its rows, and each block that fills is written to a temporary
+// file, so a long pause costs disk rather than memory. Resuming reads the
+// blocks back in order and appends their rows to the store straight from
+// the columns, a block at a time.
+// Should the file fail, the blocks stay in memory from then on.
+// @note the file atoms are kept as they are, so the rows must go to a
+//     store that shares the file table they were interned to.
+class CaptureSpill {
+ public:
+  CaptureSpill();
+  ~CaptureSpill();
+
+  // Sets the directory of the spill file, the system's temporary directory
+  // by default.
+  // @note this applies from the next file created.
+  void set_directory(const base::FilePath& directory) {
+    directory_ = directory;
+  }
+
+  // Spills a row, @see LogStore::AddRow.
+  void AddRow(UCHAR level,
+              DWORD process_id,
+              DWORD thread_id,
+              const base::Time& time,
+              StringTable::Atom file,
+              int line,
+              const base::StringPiece& message,
+              size_t trace_depth,
+              const sym_util::Address* traces);
+
+  // Appends the rows spilled to @p store, in the order they were spilled,
+  // and empties the spill.
+  // @returns false if some spilled rows couldn't be read back, in which
+  //     case those before them were appended.
+  bool AppendTo(LogStore* store);
+
+  // Discards the rows spilled, and deletes the file.
+  void Clear();
+
+  // @returns the number of rows spilled.
+  size_t num_rows() const { return num_rows_; }
+  // @returns the bytes written to the file.
+  int64 file_bytes() const { return file_bytes_; }
+
+  // The rows of each block.
+  static const size_t kRowsPerBlock = 16 * 1024;
+
+ private:
+  // The columns of the block being filled.
+  struct Block {
+    void Clear();
+
+    std::vector<UCHAR> levels;
+    std::vector<DWORD> process_ids;
+    std::vector<DWORD> thread_ids;
+    std::vector<int64> times;
+    std::vector<StringTable::Atom> files;
+    std::vector<int32> lines;
+    std::vector<uint32> message_ends;
+    std::string messages;
+    std::vector<uint32> trace_ends;
+    std::vector<sym_util::Address> traces;
+  };
+
+  // Packs @p block into @p buffer.
+  static void PackBlock(const Block& block, std::string* buffer);
+  // Appends the rows of the block packed in @p data to @p store.
+  // @returns false if @p data doesn't hold a valid block.
+  static bool AppendBlock(const char* data, size_t size, LogStore* store);
+
+  // Packs block_ and writes it to file_, or keeps it in memory_blocks_.
+  void SealBlock();
+
+  // Opens file_, unless the spill fell back to memory.
+  // @returns true iff file_ is open.
+  bool OpenFile();
+  void CloseFile();
+
+  // Reads the next packed block from file_ into @p buffer.
+  bool ReadBlock(std::string* buffer);
+
+  Block block_;
+  size_t num_rows_;
+
+  // The spill file, NULL until a block is sealed.
+  base::FilePath directory_;
+  base::FilePath path_;
+  FILE* file_;
+  int64 file_bytes_;
+  // The blocks sealed once the file failed, after those in the file.
+  std::vector<std::string> memory_blocks_;
+  bool file_failed_;
+
+  // Scratch space for packing and reading back blocks.
+  std::string buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(CaptureSpill);
+};
+
+#endif  // SAWBUCK_VIEWER_CAPTURE_SPILL_H_
@@ -0,0 +1,134 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Capture spill unit tests.
+#include "sawbuck/viewer/capture_spill.h"
+
+#include "base/files/scoped_temp_dir.h"
+#include "base/strings/stringprintf.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/log_store.h"
+
+namespace {
+
+class CaptureSpillTest : public testing::Test {
+ public:
+  CaptureSpillTest() : store_(&file_table_) {
+  }
+
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    spill_.set_directory(temp_dir_.path());
+    file_ = file_table_.Intern("foo.cc");
+    time_ = base::Time::Now();
+  }
+
+  // Spills @p count rows, every third with a trace of its row number.
+  void SpillRows(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      sym_util::Address trace[2] = { 0x1000, 0x1000 + i };
+      spill_.AddRow(i % 5, 10, 100 + i % 7,
+                    time_ + base::TimeDelta::FromMicroseconds(i),
+                    i % 2 ? file_ : StringTable::kEmptyAtom, i,
+                    base::StringPrintf("Row %d", i),
+                    i % 3 == 0 ? arraysize(trace) : 0, trace);
+    }
+  }
+
+  // Expects the rows of store_ to be those of SpillRows.
+  void ExpectRows(size_t count) {
+    ASSERT_EQ(count, static_cast<size_t>(store_.num_rows()));
+    std::string buffer;
+    std::vector<sym_util::Address> trace;
+    for (size_t i = 0; i < count; ++i) {
+      int row = static_cast<int>(i);
+      EXPECT_EQ(i % 5, store_.GetSeverity(row));
+      EXPECT_EQ(10, store_.GetProcessId(row));
+      EXPECT_EQ(100 + i % 7, store_.GetThreadId(row));
+      EXPECT_EQ(time_ + base::TimeDelta::FromMicroseconds(i),
+                store_.GetTime(row));
+      EXPECT_EQ(i % 2 ? file_ : StringTable::kEmptyAtom,
+                store_.GetFileAtom(row));
+      EXPECT_EQ(row, store_.GetLine(row));
+      EXPECT_EQ(base::StringPrintf("Row %d", i),
+                store_.GetMessage(row, &buffer).as_string());
+
+      store_.GetStackTrace(row, &trace);
+      if (i % 3 == 0) {
+        ASSERT_EQ(2U, trace.size());
+        EXPECT_EQ(0x1000 + i, trace[1]);
+      } else {
+        EXPECT_TRUE(trace.empty());
+      }
+    }
+  }
+
+ protected:
+  base::ScopedTempDir temp_dir_;
+  StringTable file_table_;
+  StringTable::Atom file_;
+  base::Time time_;
+  LogStore store_;
+  CaptureSpill spill_;
+};
+
+}  // namespace
+
+TEST_F(CaptureSpillTest, AppendsRowsKeptInMemory) {
+  SpillRows(100);
+  EXPECT_EQ(100U, spill_.num_rows());
+  // Less than a block is never written.
+  EXPECT_EQ(0, spill_.file_bytes());
+  EXPECT_EQ(0, store_.num_rows());
+
+  EXPECT_TRUE(spill_.AppendTo(&store_));
+  ExpectRows(100);
+  EXPECT_EQ(0U, spill_.num_rows());
+
+  // The spill starts over.
+  EXPECT_TRUE(spill_.AppendTo(&store_));
+  EXPECT_EQ(100, store_.num_rows());
+}
+
+TEST_F(CaptureSpillTest, AppendsRowsSpilledToFile) {
+  const size_t kNumRows = 2 * CaptureSpill::kRowsPerBlock + 10;
+  SpillRows(kNumRows);
+  EXPECT_EQ(kNumRows, spill_.num_rows());
+  EXPECT_LT(0, spill_.file_bytes());
+
+  EXPECT_TRUE(spill_.AppendTo(&store_));
+  ExpectRows(kNumRows);
+  EXPECT_EQ(0U, spill_.num_rows());
+  EXPECT_EQ(0, spill_.file_bytes());
+}
+
+TEST_F(CaptureSpillTest, FallsBackToMemory) {
+  spill_.set_directory(temp_dir_.path().Append(L"missing"));
+  const size_t kNumRows = CaptureSpill::kRowsPerBlock + 10;
+  SpillRows(kNumRows);
+  EXPECT_EQ(0, spill_.file_bytes());
+
+  EXPECT_TRUE(spill_.AppendTo(&store_));
+  ExpectRows(kNumRows);
+}
+
+TEST_F(CaptureSpillTest, Clear) {
+  SpillRows(CaptureSpill::kRowsPerBlock + 10);
+  spill_.Clear();
+  EXPECT_EQ(0U, spill_.num_rows());
+  EXPECT_EQ(0, spill_.file_bytes());
+
+  EXPECT_TRUE(spill_.AppendTo(&store_));
+  EXPECT_EQ(0, store_.num_rows());
+}
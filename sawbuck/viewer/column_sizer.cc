@@ -0,0 +1,108 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Column sizing implementation.
+#include "sawbuck/viewer/column_sizer.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+// The number of pages that cover the basic multilingual plane.
+const size_t kNumPages = 0x10000 / GlyphWidthTable::kCharsPerPage;
+
+}  // namespace
+
+const size_t GlyphWidthTable::kCharsPerPage;
+
+GlyphWidthTable::GlyphWidthTable(Measurer* measurer)
+    : measurer_(measurer), pages_(kNumPages) {
+  DCHECK(measurer_ != NULL);
+}
+
+GlyphWidthTable::~GlyphWidthTable() {
+}
+
+int GlyphWidthTable::GetTextWidth(const std::wstring& text) {
+  int width = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    size_t c = static_cast<uint16>(text[i]);
+    width += GetPage(c - c % kCharsPerPage)[c % kCharsPerPage];
+  }
+  return width;
+}
+
+const int* GlyphWidthTable::GetPage(size_t first) {
+  std::vector<int>& page = pages_[first / kCharsPerPage];
+  if (page.empty()) {
+    page.resize(kCharsPerPage);
+    if (!measurer_->GetCharWidths(static_cast<wchar_t>(first),
+                                  kCharsPerPage, &page[0])) {
+      // Leave the widths at zero, rather than fail again and again.
+      LOG(ERROR) << "Failed to measure glyph widths.";
+    }
+  }
+  return &page[0];
+}
+
+ColumnSizer::ColumnSizer(TextSource* source, GlyphWidthTable* widths)
+    : source_(source), widths_(widths) {
+  DCHECK(source_ != NULL);
+  DCHECK(widths_ != NULL);
+}
+
+void ColumnSizer::GetSampleRows(int num_rows,
+                                int first_visible,
+                                int num_visible,
+                                int num_samples,
+                                std::vector<int>* rows) {
+  DCHECK(rows != NULL);
+  rows->clear();
+  if (num_rows <= 0)
+    return;
+
+  first_visible = std::min(std::max(first_visible, 0), num_rows - 1);
+  int end_visible = std::min(first_visible + std::max(num_visible, 0),
+                             num_rows);
+  for (int row = first_visible; row < end_visible; ++row)
+    rows->push_back(row);
+
+  // Take a row from each of num_samples even strides, at a pseudo random
+  // offset within the stride, so that periodic rows don't skew the sample.
+  // The sample is deterministic, for the same width every time.
+  if (num_samples > 0) {
+    num_samples = std::min(num_samples, num_rows);
+    uint32 seed = 0x5EED;
+    for (int i = 0; i < num_samples; ++i) {
+      int begin = static_cast<int>(static_cast<int64>(i) * num_rows /
+                                   num_samples);
+      int end = static_cast<int>(static_cast<int64>(i + 1) * num_rows /
+                                 num_samples);
+      seed = seed * 1103515245 + 12345;
+      rows->push_back(begin + (seed >> 8) % (end - begin));
+    }
+  }
+
+  std::sort(rows->begin(), rows->end());
+  rows->erase(std::unique(rows->begin(), rows->end()), rows->end());
+}
+
+int ColumnSizer::GetColumnWidth(int col, const std::vector<int>& rows) {
+  int width = 0;
+  for (size_t i = 0; i < rows.size(); ++i)
+    width = std::max(width, widths_->GetTextWidth(
+        source_->GetCellText(rows[i], col)));
+  return width;
+}
@@ -0,0 +1,97 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Column sizing declarations.
+#ifndef SAWBUCK_VIEWER_COLUMN_SIZER_H_
+#define SAWBUCK_VIEWER_COLUMN_SIZER_H_
+
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+
+// Caches the advance widths of the glyphs of a font, so text can be
+// measured without a round trip to GDI per string. The widths are
+// measured a page of characters at a time, as first needed.
+// @note this ignores kerning, which is near enough for sizing columns.
+class GlyphWidthTable {
+ public:
+  // Measures the glyphs for the table.
+  class Measurer {
+   public:
+    virtual ~Measurer() {}
+
+    // Retrieves the widths of the @p count characters from @p first.
+    // @returns true on success.
+    virtual bool GetCharWidths(wchar_t first, size_t count, int* widths) = 0;
+  };
+
+  // @param measurer measures the font's glyphs, must outlive this instance.
+  explicit GlyphWidthTable(Measurer* measurer);
+  ~GlyphWidthTable();
+
+  // @returns the width of @p text.
+  int GetTextWidth(const std::wstring& text);
+
+  // The number of characters measured at a time.
+  static const size_t kCharsPerPage = 256;
+
+ private:
+  // @returns the widths of the page of characters starting at @p first.
+  const int* GetPage(size_t first);
+
+  Measurer* measurer_;
+
+  // The pages of widths, empty until measured.
+  std::vector<std::vector<int> > pages_;
+
+  DISALLOW_COPY_AND_ASSIGN(GlyphWidthTable);
+};
+
+// Picks column widths from the widest text among a sample of rows, which
+// takes time in proportion to the sample rather than the rows.
+class ColumnSizer {
+ public:
+  // Supplies the text to measure.
+  class TextSource {
+   public:
+    // @returns the text of the cell at @p row and @p col, valid until the
+    //     next call.
+    virtual const std::wstring& GetCellText(int row, int col) = 0;
+  };
+
+  // @param source supplies the cell text.
+  // @param widths measures the text.
+  ColumnSizer(TextSource* source, GlyphWidthTable* widths);
+
+  // Picks rows to measure, in ascending order: the visible rows, and
+  // @p num_samples more spread over all @p num_rows rows.
+  // @param first_visible the first visible row.
+  // @param num_visible the number of visible rows.
+  static void GetSampleRows(int num_rows,
+                            int first_visible,
+                            int num_visible,
+                            int num_samples,
+                            std::vector<int>* rows);
+
+  // @returns the width of the widest text in column @p col among @p rows.
+  int GetColumnWidth(int col, const std::vector<int>& rows);
+
+ private:
+  TextSource* source_;
+  GlyphWidthTable* widths_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnSizer);
+};
+
+#endif  // SAWBUCK_VIEWER_COLUMN_SIZER_H_
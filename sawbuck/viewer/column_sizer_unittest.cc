@@ -0,0 +1,173 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/column_sizer.h"
+
+#include <algorithm>
+#include <map>
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using testing::_;
+using testing::Invoke;
+using testing::Return;
+
+// Measures each character as a width of its value modulo 10, plus one.
+bool FakeCharWidths(wchar_t first, size_t count, int* widths) {
+  for (size_t i = 0; i < count; ++i)
+    widths[i] = static_cast<int>((first + i) % 10 + 1);
+  return true;
+}
+
+class MockMeasurer : public GlyphWidthTable::Measurer {
+ public:
+  MockMeasurer() {
+    ON_CALL(*this, GetCharWidths(_, _, _))
+        .WillByDefault(Invoke(FakeCharWidths));
+  }
+
+  MOCK_METHOD3(GetCharWidths, bool(wchar_t, size_t, int*));
+};
+
+class TestTextSource : public ColumnSizer::TextSource {
+ public:
+  virtual const std::wstring& GetCellText(int row, int col) {
+    ++num_calls_;
+    return cells_[std::make_pair(row, col)];
+  }
+
+  std::map<std::pair<int, int>, std::wstring> cells_;
+  int num_calls_;
+};
+
+TEST(GlyphWidthTableTest, MeasuresPagesOnce) {
+  testing::StrictMock<MockMeasurer> measurer;
+  GlyphWidthTable table(&measurer);
+
+  EXPECT_CALL(measurer,
+      GetCharWidths(0, GlyphWidthTable::kCharsPerPage, _)).Times(1);
+  // '0' is 48, and 'A' is 65.
+  EXPECT_EQ(9 + 10 + 6 + 7, table.GetTextWidth(L"01AB"));
+  EXPECT_EQ(9 + 9, table.GetTextWidth(L"00"));
+  EXPECT_EQ(0, table.GetTextWidth(L""));
+
+  // A character on another page measures that page.
+  EXPECT_CALL(measurer,
+      GetCharWidths(0x4E00, GlyphWidthTable::kCharsPerPage, _)).Times(1);
+  EXPECT_EQ(9 + 9, table.GetTextWidth(L"\x4E00" L"0"));
+  EXPECT_EQ(9, table.GetTextWidth(L"\x4E00"));
+}
+
+TEST(GlyphWidthTableTest, MeasureFailure) {
+  testing::StrictMock<MockMeasurer> measurer;
+  GlyphWidthTable table(&measurer);
+
+  // A page that fails to measure isn't measured again.
+  EXPECT_CALL(measurer, GetCharWidths(0, _, _)).WillOnce(Return(false));
+  EXPECT_EQ(0, table.GetTextWidth(L"abc"));
+  EXPECT_EQ(0, table.GetTextWidth(L"abc"));
+}
+
+TEST(ColumnSizerTest, SampleRowsEmpty) {
+  std::vector<int> rows(1, 10);
+  ColumnSizer::GetSampleRows(0, 0, 10, 10, &rows);
+  EXPECT_TRUE(rows.empty());
+}
+
+TEST(ColumnSizerTest, SampleRowsSmallLog) {
+  // A log smaller than the sample is measured in full.
+  std::vector<int> rows;
+  ColumnSizer::GetSampleRows(5, 0, 20, 256, &rows);
+  ASSERT_EQ(5U, rows.size());
+  for (int i = 0; i < 5; ++i)
+    EXPECT_EQ(i, rows[i]);
+
+  ColumnSizer::GetSampleRows(5, 3, 1, 256, &rows);
+  EXPECT_EQ(5U, rows.size());
+}
+
+TEST(ColumnSizerTest, SampleRowsLargeLog) {
+  const int kNumRows = 10000000;
+  const int kNumSamples = 256;
+  const int kFirstVisible = 5000000;
+  const int kNumVisible = 40;
+
+  std::vector<int> rows;
+  ColumnSizer::GetSampleRows(kNumRows, kFirstVisible, kNumVisible,
+                             kNumSamples, &rows);
+
+  // No more rows than the visible ones and the samples, sorted and unique.
+  EXPECT_GE(static_cast<size_t>(kNumVisible + kNumSamples), rows.size());
+  EXPECT_LT(static_cast<size_t>(kNumSamples), rows.size());
+  for (size_t i = 1; i < rows.size(); ++i)
+    EXPECT_LT(rows[i - 1], rows[i]);
+  EXPECT_LE(0, rows.front());
+  EXPECT_GT(kNumRows, rows.back());
+
+  // All the visible rows are there.
+  for (int row = kFirstVisible; row < kFirstVisible + kNumVisible; ++row)
+    EXPECT_TRUE(std::binary_search(rows.begin(), rows.end(), row));
+
+  // Each stride of the log has a sample.
+  for (int i = 0; i < kNumSamples; ++i) {
+    int begin = static_cast<int>(static_cast<int64>(i) * kNumRows /
+                                 kNumSamples);
+    int end = static_cast<int>(static_cast<int64>(i + 1) * kNumRows /
+                               kNumSamples);
+    EXPECT_TRUE(std::lower_bound(rows.begin(), rows.end(), begin) <
+                std::lower_bound(rows.begin(), rows.end(), end));
+  }
+
+  // The sample is the same every time.
+  std::vector<int> again;
+  ColumnSizer::GetSampleRows(kNumRows, kFirstVisible, kNumVisible,
+                             kNumSamples, &again);
+  EXPECT_TRUE(rows == again);
+}
+
+TEST(ColumnSizerTest, SampleRowsVisibleClamped) {
+  std::vector<int> rows;
+  ColumnSizer::GetSampleRows(100, 90, 40, 0, &rows);
+  ASSERT_EQ(10U, rows.size());
+  EXPECT_EQ(90, rows.front());
+  EXPECT_EQ(99, rows.back());
+}
+
+TEST(ColumnSizerTest, GetColumnWidth) {
+  testing::NiceMock<MockMeasurer> measurer;
+  GlyphWidthTable table(&measurer);
+  TestTextSource source;
+  source.num_calls_ = 0;
+  source.cells_[std::make_pair(0, 1)] = L"00";
+  source.cells_[std::make_pair(1, 1)] = L"0000";
+  source.cells_[std::make_pair(2, 1)] = L"000";
+  source.cells_[std::make_pair(3, 1)] = L"000000000";
+  source.cells_[std::make_pair(1, 2)] = L"0";
+
+  ColumnSizer sizer(&source, &table);
+  std::vector<int> rows;
+  rows.push_back(0);
+  rows.push_back(1);
+  rows.push_back(2);
+
+  // Row 3 is widest, but isn't measured.
+  EXPECT_EQ(4 * 9, sizer.GetColumnWidth(1, rows));
+  EXPECT_EQ(3, source.num_calls_);
+  EXPECT_EQ(9, sizer.GetColumnWidth(2, rows));
+
+  EXPECT_EQ(0, sizer.GetColumnWidth(1, std::vector<int>()));
+}
+
+}  // namespace
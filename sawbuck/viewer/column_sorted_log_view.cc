@@ -0,0 +1,578 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Column sorted log view implementation.
+#include "sawbuck/viewer/column_sorted_log_view.h"
+
+#include <algorithm>
+#include <iterator>
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/logging.h"
+#include "base/message_loop/message_loop.h"
+#include "sawbuck/common/perf_counters.h"
+#include "sawbuck/common/task_pool.h"
+
+namespace {
+
+PerfCounter sort_chunk_counter("ColumnSort.Chunk", 1);
+PerfCounter sort_range_counter("ColumnSort.Range", 1);
+
+// No more threads than this sort a chunk.
+const size_t kMaxSortThreads = 8;
+// A chunk holds at most this many rows per sorting thread.
+const int kMaxRowsPerThread = 64 * 1024;
+// A row costs a few nanoseconds a radix pass, so a thread needs this many
+// rows to earn back posting its range and merging its run.
+const int kMinRowsPerThread = 4 * 1024;
+
+// The bits of a radix sort digit, and the number of digits of a key.
+const int kRadixBits = 8;
+const int kRadixDigits = 64 / kRadixBits;
+const size_t kRadixBuckets = 1 << kRadixBits;
+
+// Maps @p value to a key that orders like it.
+uint64 SignedKey(int64 value) {
+  return static_cast<uint64>(value) ^ (static_cast<uint64>(1) << 63);
+}
+
+uint64 GetSortKey(ILogView* view,
+                  LogViewFormatter::Column column,
+                  const std::vector<uint32>& atom_ranks,
+                  int row) {
+  switch (column) {
+    case LogViewFormatter::SEVERITY:
+      return SignedKey(view->GetSeverity(row));
+    case LogViewFormatter::PROCESS_ID:
+      return view->GetProcessId(row);
+    case LogViewFormatter::THREAD_ID:
+      return view->GetThreadId(row);
+    case LogViewFormatter::TIME:
+      return SignedKey(view->GetTime(row).ToInternalValue());
+    case LogViewFormatter::FILE: {
+      StringTable::Atom atom = view->GetFileAtom(row);
+      DCHECK_LT(atom, atom_ranks.size());
+      return atom_ranks[atom];
+    }
+    case LogViewFormatter::LINE:
+      return SignedKey(view->GetLine(row));
+    case LogViewFormatter::COUNT:
+      return SignedKey(view->GetRepeatCount(row));
+    default:
+      NOTREACHED();
+      return 0;
+  }
+}
+
+}  // namespace
+
+const uint32 ColumnSortedLogView::kNoRank;
+
+ColumnSortedLogView::ColumnSortedLogView(ILogView* original,
+                                         LogViewFormatter::Column column,
+                                         bool descending)
+    : original_(original), registration_cookie_(0), column_(column),
+      descending_(descending), first_row_(0), sorted_rows_(0),
+      max_threads_(std::min(TaskPool::Get()->num_workers() + 1,
+                            kMaxSortThreads)),
+      next_sink_cookie_(1) {
+  DCHECK(original_ != NULL);
+  DCHECK(IsSortable(column_));
+  original_->Register(this, &registration_cookie_);
+  sorted_rows_ = original_->GetFirstRow();
+  PostSortTask();
+}
+
+ColumnSortedLogView::~ColumnSortedLogView() {
+  // Make sure we're not pinged post-destruction.
+  if (!task_.IsCancelled())
+    task_.Cancel();
+
+  original_->Unregister(registration_cookie_);
+}
+
+bool ColumnSortedLogView::IsSortable(LogViewFormatter::Column column) {
+  switch (column) {
+    case LogViewFormatter::SEVERITY:
+    case LogViewFormatter::PROCESS_ID:
+    case LogViewFormatter::THREAD_ID:
+    case LogViewFormatter::TIME:
+    case LogViewFormatter::FILE:
+    case LogViewFormatter::LINE:
+    case LogViewFormatter::COUNT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void ColumnSortedLogView::LogViewNewItems() {
+  PostSortTask();
+}
+
+void ColumnSortedLogView::LogViewCleared() {
+  task_.Cancel();
+  rows_.clear();
+  runs_.clear();
+  first_row_ = 0;
+  sorted_rows_ = original_->GetFirstRow();
+  NotifyCleared();
+  PostSortTask();
+}
+
+void ColumnSortedLogView::LogViewEvicted(int first_row) {
+  // Our evicted rows are the leading rows that were evicted, the rest keep
+  // their numbers.
+  size_t num_evicted = 0;
+  while (num_evicted < rows_.size() && rows_[num_evicted].row < first_row)
+    ++num_evicted;
+  rows_.erase(rows_.begin(), rows_.begin() + num_evicted);
+  first_row_ += static_cast<int>(num_evicted);
+
+  // Rows evicted from further on leave a gap, so the rows are renumbered.
+  bool renumber = EraseRowsBefore(first_row, &rows_);
+  for (size_t i = 0; i < runs_.size(); ++i)
+    EraseRowsBefore(first_row, runs_[i]);
+  sorted_rows_ = std::max(sorted_rows_, first_row);
+
+  if (renumber) {
+    first_row_ = 0;
+    NotifyCleared();
+    NotifyNewItems();
+  } else if (num_evicted != 0) {
+    EventSinkMap::iterator it(event_sinks_.begin());
+    for (; it != event_sinks_.end(); ++it)
+      it->second->LogViewEvicted(first_row_);
+  }
+}
+
+int ColumnSortedLogView::GetNumRows() {
+  return first_row_ + static_cast<int>(rows_.size());
+}
+
+int ColumnSortedLogView::GetFirstRow() {
+  return first_row_;
+}
+
+void ColumnSortedLogView::ClearAll() {
+  original_->ClearAll();
+}
+
+int ColumnSortedLogView::GetSeverity(int row) {
+  return original_->GetSeverity(GetOriginalRow(row));
+}
+
+DWORD ColumnSortedLogView::GetProcessId(int row) {
+  return original_->GetProcessId(GetOriginalRow(row));
+}
+
+DWORD ColumnSortedLogView::GetThreadId(int row) {
+  return original_->GetThreadId(GetOriginalRow(row));
+}
+
+base::Time ColumnSortedLogView::GetTime(int row) {
+  return original_->GetTime(GetOriginalRow(row));
+}
+
+std::string ColumnSortedLogView::GetFileName(int row) {
+  return original_->GetFileName(GetOriginalRow(row));
+}
+
+StringTable::Atom ColumnSortedLogView::GetFileAtom(int row) {
+  return original_->GetFileAtom(GetOriginalRow(row));
+}
+
+int ColumnSortedLogView::GetLine(int row) {
+  return original_->GetLine(GetOriginalRow(row));
+}
+
+std::string ColumnSortedLogView::GetMessage(int row) {
+  return original_->GetMessage(GetOriginalRow(row));
+}
+
+void ColumnSortedLogView::GetStackTrace(
+    int row, std::vector<sym_util::Address>* trace) {
+  return original_->GetStackTrace(GetOriginalRow(row), trace);
+}
+
+base::StringPiece ColumnSortedLogView::GetFileNamePiece(int row,
+                                                        std::string* buffer) {
+  return original_->GetFileNamePiece(GetOriginalRow(row), buffer);
+}
+
+base::StringPiece ColumnSortedLogView::GetMessagePiece(int row,
+                                                       std::string* buffer) {
+  return original_->GetMessagePiece(GetOriginalRow(row), buffer);
+}
+
+size_t ColumnSortedLogView::GetStackTracePiece(
+    int row,
+    const sym_util::Address** trace,
+    std::vector<sym_util::Address>* buffer) {
+  return original_->GetStackTracePiece(GetOriginalRow(row), trace, buffer);
+}
+
+StackTracePool::StackId ColumnSortedLogView::GetStackTraceId(int row) {
+  return original_->GetStackTraceId(GetOriginalRow(row));
+}
+
+bool ColumnSortedLogView::CollapsesRepeats() {
+  return original_->CollapsesRepeats();
+}
+
+int ColumnSortedLogView::GetRepeatCount(int row) {
+  return original_->GetRepeatCount(GetOriginalRow(row));
+}
+
+base::Time ColumnSortedLogView::GetLastTime(int row) {
+  return original_->GetLastTime(GetOriginalRow(row));
+}
+
+bool ColumnSortedLogView::IsLossMarker(int row) {
+  return original_->IsLossMarker(GetOriginalRow(row));
+}
+
+int ColumnSortedLogView::FindRowForTime(const base::Time& time) {
+  if (column_ == LogViewFormatter::TIME && !descending_)
+    return ILogView::FindRowForTime(time);
+
+  int original_row = original_->FindRowForTime(time);
+  for (size_t i = 0; i < rows_.size(); ++i) {
+    if (rows_[i].row == original_row)
+      return first_row_ + static_cast<int>(i);
+  }
+  return GetNumRows();
+}
+
+StackModuleIndex* ColumnSortedLogView::GetStackModuleIndex() {
+  // Our rows' traces are the original's.
+  return original_->GetStackModuleIndex();
+}
+
+ProcessInstanceIndex* ColumnSortedLogView::GetProcessInstanceIndex() {
+  // Our rows' processes are the original's.
+  return original_->GetProcessInstanceIndex();
+}
+
+const LogStore* ColumnSortedLogView::GetLogStore() {
+  // Our rows don't map to the original store row for row.
+  return NULL;
+}
+
+const LogStore* ColumnSortedLogView::GetMappedStore() {
+  // Our rows are the original's, reordered.
+  return original_->GetMappedStore();
+}
+
+int ColumnSortedLogView::GetStoreRow(int row) {
+  // The original is the list's view, which flattens its own mapping.
+  return original_->GetStoreRow(GetOriginalRow(row));
+}
+
+void ColumnSortedLogView::Register(ILogViewEvents* event_sink,
+                                   int* registration_cookie) {
+  int cookie = next_sink_cookie_++;
+  event_sinks_.insert(std::make_pair(cookie, event_sink));
+  *registration_cookie = cookie;
+}
+
+void ColumnSortedLogView::Unregister(int registration_cookie) {
+  event_sinks_.erase(registration_cookie);
+}
+
+void ColumnSortedLogView::SortAll() {
+  while (is_sorting())
+    SortChunk();
+}
+
+void ColumnSortedLogView::SortRange(ILogView* view,
+                                    LogViewFormatter::Column column,
+                                    bool descending,
+                                    const std::vector<uint32>& atom_ranks,
+                                    int begin,
+                                    int end,
+                                    Run* run) {
+  DCHECK(view != NULL);
+  DCHECK(run != NULL);
+
+  run->clear();
+  run->reserve(end - begin);
+  for (int row = begin; row < end; ++row) {
+    Entry entry;
+    entry.key = GetSortKey(view, column, atom_ranks, row);
+    if (descending)
+      entry.key = ~entry.key;
+    entry.row = row;
+    run->push_back(entry);
+  }
+
+  Run buffer;
+  RadixSort(run, &buffer);
+}
+
+void ColumnSortedLogView::RadixSort(Run* run, Run* buffer) {
+  DCHECK(run != NULL);
+  DCHECK(buffer != NULL);
+  size_t num_entries = run->size();
+  if (num_entries < 2)
+    return;
+
+  // Count the entries by each digit in one pass.
+  std::vector<size_t> counts(kRadixDigits * kRadixBuckets, 0);
+  for (size_t i = 0; i < num_entries; ++i) {
+    uint64 key = (*run)[i].key;
+    for (int digit = 0; digit < kRadixDigits; ++digit) {
+      size_t bucket = (key >> (digit * kRadixBits)) & (kRadixBuckets - 1);
+      ++counts[digit * kRadixBuckets + bucket];
+    }
+  }
+
+  // Distribute by each digit, least significant first, but for the
+  // digits all keys share, such as the high digits of small values.
+  buffer->resize(num_entries);
+  for (int digit = 0; digit < kRadixDigits; ++digit) {
+    int shift = digit * kRadixBits;
+    size_t* offsets = &counts[digit * kRadixBuckets];
+    size_t first_bucket = (run->front().key >> shift) & (kRadixBuckets - 1);
+    if (offsets[first_bucket] == num_entries)
+      continue;
+
+    size_t offset = 0;
+    for (size_t bucket = 0; bucket < kRadixBuckets; ++bucket) {
+      size_t count = offsets[bucket];
+      offsets[bucket] = offset;
+      offset += count;
+    }
+
+    for (size_t i = 0; i < num_entries; ++i) {
+      const Entry& entry = (*run)[i];
+      size_t bucket = (entry.key >> shift) & (kRadixBuckets - 1);
+      (*buffer)[offsets[bucket]++] = entry;
+    }
+    run->swap(*buffer);
+  }
+}
+
+void ColumnSortedLogView::MergeRuns(const Run& first,
+                                    const Run& second,
+                                    Run* merged) {
+  DCHECK(merged != NULL);
+  merged->clear();
+  merged->reserve(first.size() + second.size());
+  std::merge(first.begin(), first.end(), second.begin(), second.end(),
+             std::back_inserter(*merged));
+}
+
+bool ColumnSortedLogView::EraseRowsBefore(int first_row, Run* run) {
+  DCHECK(run != NULL);
+  Run::iterator kept(run->begin());
+  for (Run::iterator it(run->begin()); it != run->end(); ++it) {
+    if (it->row >= first_row)
+      *kept++ = *it;
+  }
+  if (kept == run->end())
+    return false;
+
+  run->erase(kept, run->end());
+  return true;
+}
+
+int ColumnSortedLogView::GetOriginalRow(int row) const {
+  DCHECK_LE(first_row_, row);
+  DCHECK_LT(row - first_row_, static_cast<int>(rows_.size()));
+  return rows_[row - first_row_].row;
+}
+
+void ColumnSortedLogView::RankNewAtoms(int begin, int end) {
+  std::map<StringTable::Atom, std::string> new_atoms;
+  for (int row = begin; row < end; ++row) {
+    StringTable::Atom atom = original_->GetFileAtom(row);
+    if (atom < atom_ranks_.size() && atom_ranks_[atom] != kNoRank)
+      continue;
+    if (new_atoms.find(atom) == new_atoms.end())
+      new_atoms[atom] = original_->GetFileName(row);
+  }
+  if (new_atoms.empty())
+    return;
+
+  RankedAtoms added;
+  std::map<StringTable::Atom, std::string>::const_iterator it(
+      new_atoms.begin());
+  for (; it != new_atoms.end(); ++it)
+    added.push_back(std::make_pair(it->second, it->first));
+  std::sort(added.begin(), added.end());
+
+  RankedAtoms ranked;
+  ranked.reserve(ranked_atoms_.size() + added.size());
+  std::merge(ranked_atoms_.begin(), ranked_atoms_.end(),
+             added.begin(), added.end(), std::back_inserter(ranked));
+  ranked_atoms_.swap(ranked);
+
+  // The atoms ranked before keep their order among the new ranks, so
+  // re-keying the rows sorted so far keeps them sorted.
+  std::vector<uint32> new_ranks(ranked_atoms_.size() - added.size());
+  for (size_t rank = 0; rank < ranked_atoms_.size(); ++rank) {
+    StringTable::Atom atom = ranked_atoms_[rank].second;
+    if (atom < atom_ranks_.size() && atom_ranks_[atom] != kNoRank)
+      new_ranks[atom_ranks_[atom]] = static_cast<uint32>(rank);
+  }
+  for (size_t rank = 0; rank < ranked_atoms_.size(); ++rank) {
+    StringTable::Atom atom = ranked_atoms_[rank].second;
+    if (atom >= atom_ranks_.size())
+      atom_ranks_.resize(atom + 1, kNoRank);
+    atom_ranks_[atom] = static_cast<uint32>(rank);
+  }
+
+  if (new_ranks.empty())
+    return;
+  for (size_t i = 0; i <= runs_.size(); ++i) {
+    Run* run = i < runs_.size() ? runs_[i] : &rows_;
+    for (Run::iterator entry(run->begin()); entry != run->end(); ++entry) {
+      uint64 rank = descending_ ? ~entry->key : entry->key;
+      rank = new_ranks[static_cast<size_t>(rank)];
+      entry->key = descending_ ? ~rank : rank;
+    }
+  }
+}
+
+void ColumnSortedLogView::PushRun(Run* run) {
+  DCHECK(run != NULL);
+  if (run->empty()) {
+    delete run;
+    return;
+  }
+
+  runs_.push_back(run);
+  while (runs_.size() > 1 &&
+         runs_[runs_.size() - 2]->size() <= runs_.back()->size()) {
+    scoped_ptr<Run> merged(new Run());
+    MergeRuns(*runs_[runs_.size() - 2], *runs_.back(), merged.get());
+    runs_.pop_back();
+    runs_.pop_back();
+    runs_.push_back(merged.release());
+  }
+}
+
+void ColumnSortedLogView::PublishRuns() {
+  // Merge the runs down to one, smallest first.
+  while (runs_.size() > 1) {
+    scoped_ptr<Run> merged(new Run());
+    MergeRuns(*runs_[runs_.size() - 2], *runs_.back(), merged.get());
+    runs_.pop_back();
+    runs_.pop_back();
+    runs_.push_back(merged.release());
+  }
+  if (runs_.empty())
+    return;
+
+  const Run& run = *runs_[0];
+  if (run.empty()) {
+    runs_.clear();
+    return;
+  }
+
+  // The new rows are appended if they all go after ours, otherwise ours
+  // move and the view is renumbered.
+  if (rows_.empty() || !(run.front() < rows_.back())) {
+    rows_.insert(rows_.end(), run.begin(), run.end());
+    runs_.clear();
+    NotifyNewItems();
+    return;
+  }
+
+  Run merged;
+  MergeRuns(rows_, run, &merged);
+  rows_.swap(merged);
+  runs_.clear();
+  first_row_ = 0;
+  NotifyCleared();
+  NotifyNewItems();
+}
+
+void ColumnSortedLogView::PostSortTask() {
+  if (task_.IsCancelled()) {
+    task_.Reset(base::Bind(&ColumnSortedLogView::SortChunk,
+                           base::Unretained(this)));
+    base::MessageLoop::current()->PostTask(FROM_HERE, task_.callback());
+  }
+}
+
+void ColumnSortedLogView::SortChunk() {
+  ScopedPerfTimer timer(&sort_chunk_counter);
+  task_.Cancel();
+
+  int num_rows = original_->GetNumRows();
+  int start = std::max(sorted_rows_, original_->GetFirstRow());
+  if (start >= num_rows) {
+    PublishRuns();
+    return;
+  }
+
+  // Figure the range we're going to sort, and how many threads to spread
+  // it over.
+  int num_threads = std::max(1, std::min(
+      static_cast<int>(max_threads_),
+      (num_rows - start) / kMinRowsPerThread));
+  int end = std::min(start + num_threads * kMaxRowsPerThread, num_rows);
+
+  // The ranges read the atom ranks, so they're settled beforehand.
+  if (column_ == LogViewFormatter::FILE)
+    RankNewAtoms(start, end);
+
+  // Hand the trailing ranges to the task pool, then sort the first range
+  // ourselves, and any the pool hasn't got to by then. The sorted ranges
+  // are taken in in order.
+  int range = (end - start + num_threads - 1) / num_threads;
+  std::vector<Run*> runs(num_threads);
+  for (int i = 0; i < num_threads; ++i)
+    runs[i] = new Run();
+  {
+    TaskPool::TaskGroup group(TaskPool::Get(), TaskPool::PRIORITY_VISIBLE,
+                              &sort_range_counter);
+    for (int i = 1; i < num_threads; ++i) {
+      group.Post(base::Bind(&ColumnSortedLogView::SortRange, original_,
+                            column_, descending_, base::ConstRef(atom_ranks_),
+                            std::min(start + i * range, end),
+                            std::min(start + (i + 1) * range, end),
+                            runs[i]));
+    }
+
+    SortRange(original_, column_, descending_, atom_ranks_,
+              start, std::min(start + range, end), runs[0]);
+    group.Wait();
+  }
+
+  for (int i = 0; i < num_threads; ++i)
+    PushRun(runs[i]);
+
+  sorted_rows_ = end;
+
+  // Post again if we're not done, otherwise show the rows.
+  if (sorted_rows_ < num_rows)
+    PostSortTask();
+  else
+    PublishRuns();
+}
+
+void ColumnSortedLogView::NotifyNewItems() {
+  EventSinkMap::iterator it(event_sinks_.begin());
+  for (; it != event_sinks_.end(); ++it)
+    it->second->LogViewNewItems();
+}
+
+void ColumnSortedLogView::NotifyCleared() {
+  EventSinkMap::iterator it(event_sinks_.begin());
+  for (; it != event_sinks_.end(); ++it)
+    it->second->LogViewCleared();
+}
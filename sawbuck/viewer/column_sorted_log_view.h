@@ -0,0 +1,204 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Column sorted log view declaration.
+#ifndef SAWBUCK_VIEWER_COLUMN_SORTED_LOG_VIEW_H_
+#define SAWBUCK_VIEWER_COLUMN_SORTED_LOG_VIEW_H_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/cancelable_callback.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "sawbuck/viewer/log_list_view.h"
+
+// Provides a view on a log with its rows ordered by a column, as for
+// clicking on a column header. The view keeps the permutation of the
+// original's rows and their sort keys, not copies of the rows. Integer
+// columns key by value, and the file column by the rank of the file name's
+// atom among the names seen so far.
+//
+// Like the filtered view, the permutation is built in chunks of rows, one
+// chunk per task posted to the current message loop. Large chunks are
+// split into row ranges that are keyed and radix sorted in parallel on the
+// task pool, and the sorted ranges are merged on the message
+// loop thread. The view shows the rows sorted so far, and takes in new
+// rows by merging them in once they're sorted. Rows that merge past the
+// end of the view are appended, otherwise the view renumbers its rows,
+// which sinks see as the view being cleared and refilled.
+// @note ties go by original row.
+// @note the original view is read concurrently from the task pool,
+//    only while a chunk is being sorted. See FilteredLogView.
+class ColumnSortedLogView
+    : public ILogViewEvents,
+      public ILogView {
+ public:
+  // Sorts the rows of @p original by @p column, which must be sortable,
+  // largest first if @p descending.
+  ColumnSortedLogView(ILogView* original,
+                      LogViewFormatter::Column column,
+                      bool descending);
+  ~ColumnSortedLogView();
+
+  // @returns true iff rows can be sorted by @p column.
+  static bool IsSortable(LogViewFormatter::Column column);
+
+  // ILogViewEvents implementation.
+  virtual void LogViewNewItems();
+  virtual void LogViewCleared();
+  virtual void LogViewEvicted(int first_row);
+
+  // ILogView implementation;
+  // @{
+  virtual int GetNumRows();
+  virtual int GetFirstRow();
+  virtual void ClearAll();
+  virtual int GetSeverity(int row);
+  virtual DWORD GetProcessId(int row);
+  virtual DWORD GetThreadId(int row);
+  virtual base::Time GetTime(int row);
+  virtual std::string GetFileName(int row);
+  virtual StringTable::Atom GetFileAtom(int row);
+  virtual int GetLine(int row);
+  virtual std::string GetMessage(int row);
+  virtual void GetStackTrace(int row, std::vector<sym_util::Address>* trace);
+  virtual base::StringPiece GetFileNamePiece(int row, std::string* buffer);
+  virtual base::StringPiece GetMessagePiece(int row, std::string* buffer);
+  virtual size_t GetStackTracePiece(int row,
+                                    const sym_util::Address** trace,
+                                    std::vector<sym_util::Address>* buffer);
+  virtual StackTracePool::StackId GetStackTraceId(int row);
+  virtual bool CollapsesRepeats();
+  virtual int GetRepeatCount(int row);
+  virtual base::Time GetLastTime(int row);
+  virtual bool IsLossMarker(int row);
+  // Unless sorted by ascending time, this finds the original's row for
+  // @p time, which is slow as it searches the permutation.
+  virtual int FindRowForTime(const base::Time& time);
+  virtual StackModuleIndex* GetStackModuleIndex();
+  virtual ProcessInstanceIndex* GetProcessInstanceIndex();
+  virtual const LogStore* GetLogStore();
+  virtual const LogStore* GetMappedStore();
+  virtual int GetStoreRow(int row);
+  virtual void Register(ILogViewEvents* event_sink,
+                        int* registration_cookie);
+  virtual void Unregister(int registration_cookie);
+  // @}
+
+  // Sorts the rows left to sort now, rather than chunk by chunk.
+  void SortAll();
+
+  // @returns true while there are rows left to sort.
+  bool is_sorting() const { return !task_.IsCancelled(); }
+
+  LogViewFormatter::Column column() const { return column_; }
+  bool descending() const { return descending_; }
+
+ protected:
+  // An original row and its sort key.
+  struct Entry {
+    bool operator<(const Entry& other) const {
+      return key < other.key || (key == other.key && row < other.row);
+    }
+
+    uint64 key;
+    int row;
+  };
+  typedef std::vector<Entry> Run;
+
+  // The rank of atoms that haven't been ranked yet.
+  static const uint32 kNoRank = 0xFFFFFFFF;
+
+  // Keys the rows of @p view in [@p begin, @p end) by @p column, with the
+  // file atom ranks @p atom_ranks, and sorts them into @p run.
+  static void SortRange(ILogView* view,
+                        LogViewFormatter::Column column,
+                        bool descending,
+                        const std::vector<uint32>& atom_ranks,
+                        int begin,
+                        int end,
+                        Run* run);
+  // Stable sorts @p run by key, using @p buffer as scratch.
+  static void RadixSort(Run* run, Run* buffer);
+  // Merges @p first and @p second into @p merged.
+  static void MergeRuns(const Run& first, const Run& second, Run* merged);
+  // Erases the entries of @p run for rows before @p first_row.
+  // @returns true iff there were any.
+  static bool EraseRowsBefore(int first_row, Run* run);
+
+  // Returns the row of |original_| our |row| is.
+  int GetOriginalRow(int row) const;
+
+  // Ranks the file atoms first seen in rows [@p begin, @p end) of the
+  // original, re-keying the rows sorted so far to the new ranks, which
+  // keeps their order.
+  void RankNewAtoms(int begin, int end);
+
+  // Adds @p run to |runs_|, merging it with the runs before it that
+  // are no larger, so that there are few runs to merge in the end.
+  void PushRun(Run* run);
+  // Merges |runs_| into |rows_| and notifies the sinks.
+  void PublishRuns();
+
+  void PostSortTask();
+  void SortChunk();
+
+  void NotifyNewItems();
+  void NotifyCleared();
+
+  ILogView* original_;
+  int registration_cookie_;
+  LogViewFormatter::Column column_;
+  bool descending_;
+
+  // The original's rows in sort order, our row |first_row_| on. The rows
+  // before are rows evicted from |original_|, so the rows keep their
+  // numbers until the view is renumbered.
+  Run rows_;
+  int first_row_;
+
+  // The sorted runs of rows yet to be merged into |rows_|, largest first.
+  ScopedVector<Run> runs_;
+
+  // The next row of |original_| to sort.
+  int sorted_rows_;
+
+  // The rank of each file atom, by atom, and the names and atoms ranked
+  // in rank order.
+  std::vector<uint32> atom_ranks_;
+  typedef std::vector<std::pair<std::string, StringTable::Atom> >
+      RankedAtoms;
+  RankedAtoms ranked_atoms_;
+
+  // The maximum number of threads sorting a chunk, including our own.
+  // Defaults to the task pool's workers and our own.
+  size_t max_threads_;
+
+  typedef base::CancelableCallback<void()> SortCallback;
+
+  // Non-cancelled while a sort task is pending.
+  SortCallback task_;
+
+  typedef std::map<int, ILogViewEvents*> EventSinkMap;
+  EventSinkMap event_sinks_;
+  int next_sink_cookie_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnSortedLogView);
+};
+
+#endif  // SAWBUCK_VIEWER_COLUMN_SORTED_LOG_VIEW_H_
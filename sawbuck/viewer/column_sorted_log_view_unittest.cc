@@ -0,0 +1,162 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "sawbuck/viewer/column_sorted_log_view.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/mock_log_view_interfaces.h"
+#include "sawbuck/viewer/test_log_view.h"
+
+namespace {
+
+using testing::InSequence;
+using testing::MockILogViewEvents;
+using testing::StrictMock;
+
+class ColumnSortedLogViewTest : public testing::TestLogViewTest {
+};
+
+}  // namespace
+
+TEST_F(ColumnSortedLogViewTest, IsSortable) {
+  EXPECT_TRUE(ColumnSortedLogView::IsSortable(LogViewFormatter::PROCESS_ID));
+  EXPECT_TRUE(ColumnSortedLogView::IsSortable(LogViewFormatter::FILE));
+  EXPECT_TRUE(ColumnSortedLogView::IsSortable(LogViewFormatter::TIME));
+  EXPECT_FALSE(ColumnSortedLogView::IsSortable(LogViewFormatter::MESSAGE));
+}
+
+TEST_F(ColumnSortedLogViewTest, SortsByProcess) {
+  original_.AddRow(3, 0, "foo.cc", 1);
+  original_.AddRow(1, 0, "foo.cc", 2);
+  original_.AddRow(2, 0, "foo.cc", 3);
+  original_.AddRow(1, 0, "foo.cc", 4);
+
+  ColumnSortedLogView view(&original_, LogViewFormatter::PROCESS_ID, false);
+  EXPECT_TRUE(view.is_sorting());
+  EXPECT_EQ(0, view.GetNumRows());
+  RunMessageLoopToIdle();
+  EXPECT_FALSE(view.is_sorting());
+  EXPECT_EQ(Rows(1, 3, 2, 0), GetRows(&view));
+  EXPECT_EQ(1, view.GetProcessId(0));
+
+  // Ties still go by row when descending.
+  ColumnSortedLogView descending(&original_, LogViewFormatter::PROCESS_ID,
+                                 true);
+  descending.SortAll();
+  EXPECT_EQ(Rows(0, 2, 1, 3), GetRows(&descending));
+}
+
+TEST_F(ColumnSortedLogViewTest, SortsByFileName) {
+  original_.AddRow(1, 0, "b.cc", 1);
+  original_.AddRow(1, 0, "c.cc", 2);
+  original_.AddRow(1, 0, "a.cc", 3);
+
+  ColumnSortedLogView view(&original_, LogViewFormatter::FILE, false);
+  RunMessageLoopToIdle();
+
+  StrictMock<MockILogViewEvents> events;
+  int cookie = 0;
+  view.Register(&events, &cookie);
+
+  // A file that ranks first re-ranks the others, and moves rows.
+  original_.AddRow(1, 0, "0.cc", 4);
+  original_.NotifyNewItems();
+  {
+    InSequence sequence;
+    EXPECT_CALL(events, LogViewCleared());
+    EXPECT_CALL(events, LogViewNewItems());
+  }
+  RunMessageLoopToIdle();
+  EXPECT_EQ(Rows(3, 2, 0, 1), GetRows(&view));
+  EXPECT_EQ("0.cc", view.GetFileName(0));
+
+  view.Unregister(cookie);
+}
+
+TEST_F(ColumnSortedLogViewTest, AppendsRowsSortingLast) {
+  original_.AddRow(1, 0, "foo.cc", 1);
+  original_.AddRow(1, 0, "foo.cc", 2);
+
+  ColumnSortedLogView view(&original_, LogViewFormatter::TIME, false);
+  view.SortAll();
+
+  StrictMock<MockILogViewEvents> events;
+  int cookie = 0;
+  view.Register(&events, &cookie);
+
+  original_.AddRow(1, 0, "foo.cc", 3);
+  original_.AddRow(1, 0, "foo.cc", 4);
+  original_.NotifyNewItems();
+  EXPECT_CALL(events, LogViewNewItems());
+  RunMessageLoopToIdle();
+  EXPECT_EQ(Rows(0, 1, 2, 3), GetRows(&view));
+  EXPECT_EQ(2, view.FindRowForTime(base::Time::FromDoubleT(3)));
+
+  view.Unregister(cookie);
+}
+
+TEST_F(ColumnSortedLogViewTest, Eviction) {
+  original_.AddRow(1, 0, "foo.cc", 1);
+  original_.AddRow(2, 0, "foo.cc", 2);
+  original_.AddRow(1, 0, "foo.cc", 3);
+  original_.AddRow(2, 0, "foo.cc", 4);
+
+  ColumnSortedLogView view(&original_, LogViewFormatter::PROCESS_ID, false);
+  view.SortAll();
+  EXPECT_EQ(Rows(0, 2, 1, 3), GetRows(&view));
+
+  StrictMock<MockILogViewEvents> events;
+  int cookie = 0;
+  view.Register(&events, &cookie);
+
+  // Leading rows keep the numbering.
+  EXPECT_CALL(events, LogViewEvicted(1));
+  original_.Evict(1);
+  EXPECT_EQ(1, view.GetFirstRow());
+  EXPECT_EQ(2, view.GetLine(1));
+
+  // Others renumber.
+  {
+    InSequence sequence;
+    EXPECT_CALL(events, LogViewCleared());
+    EXPECT_CALL(events, LogViewNewItems());
+  }
+  original_.Evict(2);
+  EXPECT_EQ(0, view.GetFirstRow());
+  ASSERT_EQ(2, view.GetNumRows());
+  EXPECT_EQ(2, view.GetLine(0));
+  EXPECT_EQ(3, view.GetLine(1));
+  // The original's row for the time is found in the permutation.
+  EXPECT_EQ(1, view.FindRowForTime(base::Time::FromDoubleT(4)));
+
+  view.Unregister(cookie);
+}
+
+TEST_F(ColumnSortedLogViewTest, SortsManyRows) {
+  const int kNumRows = 100000;
+  for (int row = 0; row < kNumRows; ++row)
+    original_.AddRow((row * 7919) % 1000, 0, "foo.cc", row);
+
+  ColumnSortedLogView view(&original_, LogViewFormatter::PROCESS_ID, false);
+  view.SortAll();
+  ASSERT_EQ(kNumRows, view.GetNumRows());
+  for (int row = 1; row < kNumRows; ++row) {
+    DWORD pid = view.GetProcessId(row);
+    DWORD previous_pid = view.GetProcessId(row - 1);
+    ASSERT_LE(previous_pid, pid);
+    if (previous_pid == pid)
+      ASSERT_LT(view.GetLine(row - 1), view.GetLine(row));
+  }
+}
@@ -37,6 +37,12 @@ const wchar_t kProviderLevelsKey[] = L"Software\\Google\\SawBuck\\Levels";
 const wchar_t kProviderLevelValue[] = L"log_level";
 // Per-provider DWORD value for current enable flags.
 const wchar_t kProviderEnableFlagsValue[] = L"enable_flags";
+// Per-provider DWORD value, non-zero iff the provider is muted.
+const wchar_t kProviderMutedValue[] = L"muted";
+
+// Binary value caching the providers read from kProviderNamesKey, along
+// with the time they were last changed.
+const wchar_t kProviderCacheValue[] = L"provider_cache";
 
 // Symbol path value.
 const wchar_t kSymPathValue[] = L"symbol_path";
@@ -57,6 +63,114 @@ const wchar_t kFilterViewColumnWidths[] = L"filter_view_column_widths";
 
 const wchar_t kFilterValues[] = L"filter_values";
 
+// String value for the query last run in the query dialog.
+const wchar_t kQueryValue[] = L"query";
+
+// DWORD value for the most times a second to update the views with new
+// log messages, zero for no limit.
+const wchar_t kNewItemsUpdatesPerSecondValue[] =
+    L"new_items_updates_per_second";
+
+// DWORD value for the most memory loaded symbols may take, in megabytes.
+const wchar_t kSymbolCacheBudgetValue[] = L"symbol_cache_budget_mb";
+
+// DWORD value for the most memory our caches may take together, in
+// megabytes.
+const wchar_t kMemoryBudgetValue[] = L"memory_budget_mb";
+
+// DWORD value, non-zero to load the symbols of the modules listed in the
+// string value of semicolon separated module file names as soon as they
+// appear in the kernel log.
+const wchar_t kPreloadSymbolsValue[] = L"preload_symbols";
+const wchar_t kPreloadSymbolsModulesValue[] = L"preload_symbols_modules";
+
+// DWORD value, non-zero to capture the context switches of the kernel log,
+// which tell whether the thread of a log message was running at the time.
+const wchar_t kCaptureContextSwitchesValue[] = L"capture_context_switches";
+
+// DWORD value, non-zero to capture the disk I/O of the kernel log, for the
+// report of the slowest disk reads.
+const wchar_t kCaptureDiskIoValue[] = L"capture_disk_io";
+
+// DWORD value, non-zero to capture the page faults of the kernel log, for
+// the kernel context of a log message's thread.
+const wchar_t kCapturePageFaultsValue[] = L"capture_page_faults";
+
+// DWORD value, non-zero to sample the CPU with the kernel log's profile
+// interrupts and their stacks, for the report of the hottest functions.
+const wchar_t kCaptureCpuSamplesValue[] = L"capture_cpu_samples";
+
+// DWORD value, non-zero to capture the registry accesses of the kernel log,
+// for the reports of the hottest registry keys.
+const wchar_t kCaptureRegistryValue[] = L"capture_registry";
+
+// String value naming the kernel capture profile, one of "minimal",
+// "startup_io", "cpu" or "memory". If it's missing or names no profile,
+// the kernel events captured follow the capture values above.
+const wchar_t kKernelProfileValue[] = L"kernel_profile";
+
+// DWORD value for the number of real time sessions the providers are split
+// across, each consumed on a thread of its own, one by default.
+const wchar_t kAppSessionsValue[] = L"app_sessions";
+
+// DWORD value, zero to parse the events of the providers in the ETW
+// callbacks rather than copy them there for another thread to parse.
+const wchar_t kDeferParsingValue[] = L"defer_parsing";
+
+// DWORD value for the percentage of a span name's baseline 95th percentile
+// its live 95th percentile is flagged as a regression past, 150 by default.
+const wchar_t kSpanRegressionPercentValue[] = L"span_regression_percent";
+
+// DWORD value for the most milliseconds to hold captured log messages while
+// waiting for the kernel events before them, zero to show them as they
+// come.
+const wchar_t kReorderLatencyMsValue[] = L"reorder_latency_ms";
+
+// DWORD value for the most memory, in megabytes, the buffers of each of
+// our trace sessions may grow to when their consumers fall behind.
+const wchar_t kSessionBufferCeilingMbValue[] = L"session_buffer_ceiling_mb";
+
+// DWORD value, zero to let the sessions lose events once their buffers are
+// at the ceiling and they still fall behind, rather than lower the levels
+// of the noisiest providers until they catch up.
+const wchar_t kBackPressureValue[] = L"back_pressure";
+
+// String value for the path of a log file to write the capture to while
+// consuming it in real time, empty to capture in real time only. The
+// kernel session goes to a file of the same name with ".kernel" before
+// its extension. The DWORD values are non-zero to write the files
+// circularly, and for the most megabytes each file may take.
+const wchar_t kCaptureFileValue[] = L"capture_file";
+const wchar_t kCaptureFileCircularValue[] = L"capture_file_circular";
+const wchar_t kCaptureFileMaxMbValue[] = L"capture_file_max_mb";
+
+// DWORD values bounding the rows the viewer retains, past which it drops
+// the oldest: the most rows, the most megabytes of row data and the most
+// minutes between the oldest row and the newest. Zero for no bound, which
+// is the default but for the megabytes of a 32-bit viewer.
+const wchar_t kRetainMaxRowsValue[] = L"retain_max_rows";
+const wchar_t kRetainMaxMbValue[] = L"retain_max_mb";
+const wchar_t kRetainMaxMinutesValue[] = L"retain_max_minutes";
+
+// String value for the rules that sample the captured log messages, as
+// parsed by LogSampler::ParseRules, empty to keep all. The DWORD value is
+// the most messages a second to keep from any one file and line of a
+// process, zero for no limit.
+const wchar_t kLogSamplingRulesValue[] = L"log_sampling_rules";
+const wchar_t kLogRateLimitValue[] = L"log_rate_limit";
+
+// DWORD value, non-zero to collapse log rows that repeat the last row of
+// their thread into it, with a count.
+const wchar_t kCollapseRepeatsValue[] = L"collapse_repeats";
+
+// String value for the rules that highlight log rows, as serialized by
+// RowHighlighter::SerializeRules.
+const wchar_t kHighlightRulesValue[] = L"highlight_rules";
+
+// String value for the session and index files of the session library,
+// as serialized by SessionLibrary::SerializePaths.
+const wchar_t kSessionLibraryValue[] = L"session_library";
+
 }  // namespace config
 
 #endif  // SAWBUCK_VIEWER_CONST_CONFIG_H_
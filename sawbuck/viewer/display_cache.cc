@@ -0,0 +1,105 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Display string cache implementation.
+#include "sawbuck/viewer/display_cache.h"
+
+#include "base/logging.h"
+
+namespace {
+
+// The key packs the generation above the row, above the column.
+const int kColumnBits = 8;
+const int kRowBits = 32;
+const int kGenerationBits = 64 - kRowBits - kColumnBits;
+
+// What an entry takes beside its text: its key and string, and the links
+// of its list and hash table nodes, the latter keyed afresh.
+const size_t kEntryOverhead =
+    2 * sizeof(uint64) + sizeof(std::wstring) + 4 * sizeof(void*);
+
+}  // namespace
+
+DisplayCache::DisplayCache(size_t max_entries)
+    : cache_(max_entries), generation_(0), bytes_(0) {
+  DCHECK_LT(0U, max_entries);
+}
+
+DisplayCache::~DisplayCache() {
+}
+
+const std::wstring* DisplayCache::Get(int row, int column) {
+  Cache::iterator it(cache_.Get(MakeKey(row, column)));
+  if (it == cache_.end())
+    return NULL;
+
+  return &it->second;
+}
+
+const std::wstring& DisplayCache::Put(int row,
+                                      int column,
+                                      const std::wstring& text) {
+  // Put replaces the cell's entry, or evicts the oldest to make room for
+  // it, which we do first to keep the books.
+  Key key = MakeKey(row, column);
+  Cache::iterator it(cache_.Peek(key));
+  if (it != cache_.end())
+    Erase(it);
+  else if (cache_.size() == cache_.max_size())
+    Erase(--cache_.end());
+
+  it = cache_.Put(key, text);
+  bytes_ += GetEntryBytes(it->second);
+  return it->second;
+}
+
+bool DisplayCache::Has(int row, int column) {
+  return cache_.Peek(MakeKey(row, column)) != cache_.end();
+}
+
+void DisplayCache::Invalidate() {
+  // Should the generation outgrow its key bits, wrap it around, and drop
+  // everything lest a stale entry come back to life.
+  if (++generation_ == (1 << kGenerationBits)) {
+    generation_ = 0;
+    cache_.Clear();
+    bytes_ = 0;
+  }
+}
+
+void DisplayCache::Shrink(size_t bytes) {
+  size_t target = bytes < bytes_ ? bytes_ - bytes : 0;
+  while (bytes_ > target && !cache_.empty())
+    Erase(--cache_.end());
+}
+
+DisplayCache::Key DisplayCache::MakeKey(int row, int column) const {
+  DCHECK_LE(0, row);
+  DCHECK_LE(0, column);
+  DCHECK_GT(1 << kColumnBits, column);
+
+  return (static_cast<Key>(generation_) << (kRowBits + kColumnBits)) |
+      (static_cast<Key>(static_cast<uint32>(row)) << kColumnBits) | column;
+}
+
+size_t DisplayCache::GetEntryBytes(const std::wstring& text) {
+  return kEntryOverhead + (text.capacity() + 1) * sizeof(wchar_t);
+}
+
+void DisplayCache::Erase(Cache::iterator it) {
+  size_t entry_bytes = GetEntryBytes(it->second);
+  DCHECK_LE(entry_bytes, bytes_);
+  bytes_ -= entry_bytes;
+  cache_.Erase(it);
+}
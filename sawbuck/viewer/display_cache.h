@@ -0,0 +1,79 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Display string cache declaration.
+#ifndef SAWBUCK_VIEWER_DISPLAY_CACHE_H_
+#define SAWBUCK_VIEWER_DISPLAY_CACHE_H_
+
+#include <string>
+#include "base/basictypes.h"
+#include "base/containers/mru_cache.h"
+
+// A bounded, least recently used cache of the display text of list view
+// cells. Entries are keyed on the cache's generation as well as their
+// cell, so invalidating the lot is a matter of starting a new generation,
+// and the stale entries age out.
+class DisplayCache {
+ public:
+  // @param max_entries the most cells to keep text for.
+  explicit DisplayCache(size_t max_entries);
+  ~DisplayCache();
+
+  // @returns the cached text of the cell at @p row and @p column, or NULL
+  //     if none is cached. The cell becomes the most recently used.
+  // @note the text is valid until the next call to Put.
+  const std::wstring* Get(int row, int column);
+
+  // Caches @p text for the cell at @p row and @p column, evicting the
+  // least recently used cell if the cache is full.
+  // @returns the cached text, valid until the next call to Put.
+  const std::wstring& Put(int row, int column, const std::wstring& text);
+
+  // @returns true iff text is cached for the cell at @p row and @p column.
+  // Doesn't change the recency of the cell.
+  bool Has(int row, int column);
+
+  // Invalidates all cached text.
+  void Invalidate();
+
+  // Evicts the least recently used cells until they free @p bytes, or
+  // the cache is empty.
+  // @note this invalidates the text Get and Put returned.
+  void Shrink(size_t bytes);
+
+  size_t size() const { return cache_.size(); }
+  int generation() const { return generation_; }
+  // @returns roughly the memory the cached text takes, in bytes.
+  size_t bytes() const { return bytes_; }
+
+ private:
+  typedef uint64 Key;
+  typedef base::HashingMRUCache<Key, std::wstring> Cache;
+
+  Key MakeKey(int row, int column) const;
+
+  // @returns roughly the memory an entry for @p text takes, in bytes.
+  static size_t GetEntryBytes(const std::wstring& text);
+
+  // Erases the entry at @p it, and its bytes.
+  void Erase(Cache::iterator it);
+
+  Cache cache_;
+  int generation_;
+  size_t bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(DisplayCache);
+};
+
+#endif  // SAWBUCK_VIEWER_DISPLAY_CACHE_H_
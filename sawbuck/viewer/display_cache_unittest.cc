@@ -0,0 +1,109 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/display_cache.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(DisplayCacheTest, GetAndPut) {
+  DisplayCache cache(10);
+  EXPECT_EQ(0U, cache.size());
+  EXPECT_TRUE(cache.Get(0, 0) == NULL);
+
+  EXPECT_EQ(L"foo", cache.Put(0, 0, L"foo"));
+  EXPECT_EQ(L"bar", cache.Put(0, 1, L"bar"));
+  EXPECT_EQ(L"baz", cache.Put(1, 0, L"baz"));
+  EXPECT_EQ(3U, cache.size());
+
+  ASSERT_TRUE(cache.Get(0, 0) != NULL);
+  EXPECT_EQ(L"foo", *cache.Get(0, 0));
+  ASSERT_TRUE(cache.Get(0, 1) != NULL);
+  EXPECT_EQ(L"bar", *cache.Get(0, 1));
+  ASSERT_TRUE(cache.Get(1, 0) != NULL);
+  EXPECT_EQ(L"baz", *cache.Get(1, 0));
+  EXPECT_TRUE(cache.Get(1, 1) == NULL);
+
+  // Putting again replaces.
+  cache.Put(0, 0, L"qux");
+  EXPECT_EQ(L"qux", *cache.Get(0, 0));
+  EXPECT_EQ(3U, cache.size());
+}
+
+TEST(DisplayCacheTest, EvictsLeastRecentlyUsed) {
+  const int kMaxEntries = 4;
+  DisplayCache cache(kMaxEntries);
+  for (int row = 0; row < kMaxEntries; ++row)
+    cache.Put(row, 6, L"text");
+
+  // Touch row 0, then overflow.
+  EXPECT_TRUE(cache.Get(0, 6) != NULL);
+  cache.Put(100000000, 6, L"big row");
+  EXPECT_EQ(static_cast<size_t>(kMaxEntries), cache.size());
+
+  EXPECT_TRUE(cache.Has(0, 6));
+  EXPECT_FALSE(cache.Has(1, 6));
+  EXPECT_TRUE(cache.Has(2, 6));
+  EXPECT_TRUE(cache.Has(100000000, 6));
+
+  // Has doesn't count as a use.
+  EXPECT_TRUE(cache.Has(2, 6));
+  cache.Put(5, 6, L"text");
+  EXPECT_FALSE(cache.Has(2, 6));
+}
+
+TEST(DisplayCacheTest, Invalidate) {
+  DisplayCache cache(10);
+  cache.Put(3, 2, L"old");
+  EXPECT_EQ(0, cache.generation());
+
+  cache.Invalidate();
+  EXPECT_EQ(1, cache.generation());
+  EXPECT_TRUE(cache.Get(3, 2) == NULL);
+
+  cache.Put(3, 2, L"new");
+  EXPECT_EQ(L"new", *cache.Get(3, 2));
+}
+
+TEST(DisplayCacheTest, KeepsBytes) {
+  const int kMaxEntries = 4;
+  DisplayCache cache(kMaxEntries);
+  EXPECT_EQ(0U, cache.bytes());
+
+  cache.Put(0, 0, L"text");
+  size_t entry_bytes = cache.bytes();
+  EXPECT_LT(4 * sizeof(wchar_t), entry_bytes);
+
+  // Replacing and evicting keep the count.
+  cache.Put(0, 0, L"text");
+  EXPECT_EQ(entry_bytes, cache.bytes());
+  for (int row = 1; row <= kMaxEntries; ++row)
+    cache.Put(row, 0, L"text");
+  EXPECT_EQ(static_cast<size_t>(kMaxEntries), cache.size());
+  EXPECT_EQ(kMaxEntries * entry_bytes, cache.bytes());
+
+  // Shrinking goes for the least recently used.
+  EXPECT_TRUE(cache.Get(1, 0) != NULL);
+  cache.Shrink(entry_bytes + 1);
+  EXPECT_EQ(2U, cache.size());
+  EXPECT_EQ(2 * entry_bytes, cache.bytes());
+  EXPECT_TRUE(cache.Has(1, 0));
+  EXPECT_TRUE(cache.Has(4, 0));
+
+  cache.Shrink(1000000);
+  EXPECT_EQ(0U, cache.size());
+  EXPECT_EQ(0U, cache.bytes());
+}
+
+}  // namespace
@@ -0,0 +1,145 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Duplicate row filter implementation.
+#include "sawbuck/viewer/duplicate_row_filter.h"
+
+#include <algorithm>
+#include <string>
+#include "base/logging.h"
+#include "sawbuck/viewer/log_store.h"
+
+namespace {
+
+const uint32 kFnvOffsetBasis = 2166136261U;
+const uint32 kFnvPrime = 16777619U;
+
+// Folds the @p size bytes at @p bytes into the FNV-1a hash @p hash.
+uint32 HashBytes(const void* bytes, size_t size, uint32 hash) {
+  const uint8* begin = reinterpret_cast<const uint8*>(bytes);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= begin[i];
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+}  // namespace
+
+const int64 DuplicateRowFilter::kWindowUs;
+
+bool DuplicateRowFilter::Fingerprint::operator<(
+    const Fingerprint& other) const {
+  if (process_id != other.process_id)
+    return process_id < other.process_id;
+  if (thread_id != other.thread_id)
+    return thread_id < other.thread_id;
+  if (location != other.location)
+    return location < other.location;
+  return payload < other.payload;
+}
+
+bool DuplicateRowFilter::Fingerprint::operator==(
+    const Fingerprint& other) const {
+  return process_id == other.process_id && thread_id == other.thread_id &&
+      location == other.location && payload == other.payload;
+}
+
+DuplicateRowFilter::DuplicateRowFilter(size_t num_sources)
+    : spans_(num_sources, std::pair<int64, int64>(1, 0)) {
+}
+
+DuplicateRowFilter::~DuplicateRowFilter() {
+}
+
+void DuplicateRowFilter::SetSourceSpan(size_t source,
+                                       int64 first_time,
+                                       int64 last_time) {
+  DCHECK_LT(source, spans_.size());
+  DCHECK_LE(first_time, last_time);
+  spans_[source] = std::make_pair(first_time, last_time);
+}
+
+bool DuplicateRowFilter::InOverlap(size_t source, int64 time) const {
+  DCHECK_LT(source, spans_.size());
+  for (size_t i = 0; i < spans_.size(); ++i) {
+    if (i == source || spans_[i].first > spans_[i].second)
+      continue;
+    if (time >= spans_[i].first - kWindowUs &&
+        time <= spans_[i].second + kWindowUs) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DuplicateRowFilter::IsDuplicate(size_t source, int64 time,
+                                     const Fingerprint& fingerprint) {
+  DCHECK_LT(source, spans_.size());
+  DCHECK(window_.empty() || window_.back().time <= time);
+  Expire(time);
+
+  // Count this source's rows of the fingerprint, and the most any other
+  // source has. They sort together, by source.
+  size_t own = 0;
+  size_t most_other = 0;
+  CountMap::const_iterator it =
+      counts_.lower_bound(CountKey(fingerprint, 0));
+  for (; it != counts_.end() && it->first.first == fingerprint; ++it) {
+    if (it->first.second == source)
+      own = it->second;
+    else
+      most_other = std::max(most_other, it->second);
+  }
+
+  TrackedRow tracked = { time, fingerprint, source };
+  window_.push_back(tracked);
+  ++counts_[CountKey(fingerprint, source)];
+  return own < most_other;
+}
+
+void DuplicateRowFilter::GetFingerprint(const LogStore& store, int row,
+                                        Fingerprint* fingerprint) {
+  DCHECK(fingerprint != NULL);
+  fingerprint->process_id = store.GetProcessId(row);
+  fingerprint->thread_id = store.GetThreadId(row);
+
+  int severity = store.GetSeverity(row);
+  int line = store.GetLine(row);
+  const std::string& file = store.GetFileName(row);
+  uint32 hash = HashBytes(&severity, sizeof(severity), kFnvOffsetBasis);
+  hash = HashBytes(&line, sizeof(line), hash);
+  fingerprint->location = HashBytes(file.data(), file.size(), hash);
+
+  std::string buffer;
+  base::StringPiece message = store.GetMessage(row, &buffer);
+  hash = HashBytes(message.data(), message.size(), kFnvOffsetBasis);
+  std::vector<sym_util::Address> trace;
+  store.GetStackTrace(row, &trace);
+  if (!trace.empty())
+    hash = HashBytes(&trace[0], trace.size() * sizeof(trace[0]), hash);
+  fingerprint->payload = hash;
+}
+
+void DuplicateRowFilter::Expire(int64 time) {
+  while (!window_.empty() && window_.front().time < time - kWindowUs) {
+    const TrackedRow& oldest = window_.front();
+    CountMap::iterator it =
+        counts_.find(CountKey(oldest.fingerprint, oldest.source));
+    DCHECK(it != counts_.end());
+    if (--it->second == 0)
+      counts_.erase(it);
+    window_.pop_front();
+  }
+}
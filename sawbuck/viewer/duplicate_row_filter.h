@@ -0,0 +1,116 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Duplicate row filter declaration.
+#ifndef SAWBUCK_VIEWER_DUPLICATE_ROW_FILTER_H_
+#define SAWBUCK_VIEWER_DUPLICATE_ROW_FILTER_H_
+
+#include <windows.h>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+#include "base/basictypes.h"
+
+class LogStore;
+
+// Tells the rows that several sources merged by time have in common, e.g.
+// the events that rotated logs, or a snapshot and the log it was taken
+// from, both hold. A row duplicates another source's when their
+// fingerprints match and their times are within kWindowUs of one another.
+// The times are allowed to differ, as each log converts the time stamps
+// of its events by a clock of its own, whose reference is only sampled
+// to the resolution of the system clock.
+//
+// A source may hold identical rows of its own, e.g. a message logged in a
+// tight loop, so it's the count that matters: a source's Nth row of a
+// fingerprint within the window is a duplicate iff another source had at
+// least N of them.
+//
+// Only the rows within the window of another source's time span are kept
+// track of, and only for the length of the window, so the memory used is
+// bounded by the rows of the overlap logged in any one window.
+class DuplicateRowFilter {
+ public:
+  // What identifies a row, but for its time.
+  struct Fingerprint {
+    Fingerprint() : process_id(0), thread_id(0), location(0), payload(0) {
+    }
+
+    bool operator<(const Fingerprint& other) const;
+    bool operator==(const Fingerprint& other) const;
+
+    DWORD process_id;
+    DWORD thread_id;
+    // Hashes the severity, file name and line, which stand in for the
+    // provider, as the rows don't keep it.
+    uint32 location;
+    // Hashes the message and the stack trace.
+    uint32 payload;
+  };
+
+  // Rows further apart than this, in microseconds, are never duplicates.
+  static const int64 kWindowUs = 16 * 1000;
+
+  // @param num_sources the number of sources merged.
+  explicit DuplicateRowFilter(size_t num_sources);
+  ~DuplicateRowFilter();
+
+  // Sets the internal times of the first and last rows of @p source.
+  // Sources that are left unset have no rows.
+  void SetSourceSpan(size_t source, int64 first_time, int64 last_time);
+
+  // @returns true iff a row of @p source lies within the window of
+  //     another source's span, and so may duplicate one of its rows.
+  bool InOverlap(size_t source, int64 time) const;
+
+  // Looks at the next row of the merge, a row of @p source at @p time
+  // with @p fingerprint, where @p time is no earlier than the last.
+  // @returns true iff it duplicates a row of another source.
+  bool IsDuplicate(size_t source, int64 time,
+                   const Fingerprint& fingerprint);
+
+  // Retrieves the fingerprint of @p row of @p store.
+  static void GetFingerprint(const LogStore& store, int row,
+                             Fingerprint* fingerprint);
+
+  // @returns the rows kept track of.
+  size_t num_tracked() const { return window_.size(); }
+
+ private:
+  // A row within the window of the last.
+  struct TrackedRow {
+    int64 time;
+    Fingerprint fingerprint;
+    size_t source;
+  };
+  typedef std::pair<Fingerprint, size_t> CountKey;
+  typedef std::map<CountKey, size_t> CountMap;
+
+  // Forgets the rows further than the window before @p time.
+  void Expire(int64 time);
+
+  // The first and last row times of each source, first past last for
+  // sources without rows.
+  std::vector<std::pair<int64, int64> > spans_;
+
+  // The rows within the window, oldest first, and how many of them each
+  // source has of each fingerprint.
+  std::deque<TrackedRow> window_;
+  CountMap counts_;
+
+  DISALLOW_COPY_AND_ASSIGN(DuplicateRowFilter);
+};
+
+#endif  // SAWBUCK_VIEWER_DUPLICATE_ROW_FILTER_H_
@@ -0,0 +1,105 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Duplicate row filter unit tests.
+#include "sawbuck/viewer/duplicate_row_filter.h"
+
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/log_store.h"
+
+namespace {
+
+DuplicateRowFilter::Fingerprint MakeFingerprint(uint32 payload) {
+  DuplicateRowFilter::Fingerprint fingerprint;
+  fingerprint.process_id = 1;
+  fingerprint.thread_id = 2;
+  fingerprint.location = 3;
+  fingerprint.payload = payload;
+  return fingerprint;
+}
+
+}  // namespace
+
+TEST(DuplicateRowFilterTest, InOverlap) {
+  DuplicateRowFilter filter(3);
+  filter.SetSourceSpan(0, 1000000, 2000000);
+  filter.SetSourceSpan(1, 1500000, 3000000);
+
+  EXPECT_FALSE(filter.InOverlap(0, 1000000));
+  EXPECT_TRUE(filter.InOverlap(0, 1500000));
+  EXPECT_TRUE(filter.InOverlap(
+      0, 1500000 - DuplicateRowFilter::kWindowUs));
+  EXPECT_TRUE(filter.InOverlap(1, 2000000));
+  EXPECT_FALSE(filter.InOverlap(1, 2500000));
+  // The third has no rows of its own, but would overlap the first two.
+  EXPECT_TRUE(filter.InOverlap(2, 1200000));
+  EXPECT_FALSE(filter.InOverlap(2, 5000000));
+}
+
+TEST(DuplicateRowFilterTest, CountsRepeats) {
+  DuplicateRowFilter filter(3);
+  DuplicateRowFilter::Fingerprint repeated = MakeFingerprint(10);
+  DuplicateRowFilter::Fingerprint other = MakeFingerprint(11);
+
+  // The first source logs the same row twice, the second has both of
+  // them and a third of its own, the third has one.
+  EXPECT_FALSE(filter.IsDuplicate(0, 100, repeated));
+  EXPECT_FALSE(filter.IsDuplicate(0, 100, repeated));
+  EXPECT_TRUE(filter.IsDuplicate(1, 101, repeated));
+  EXPECT_TRUE(filter.IsDuplicate(1, 101, repeated));
+  EXPECT_FALSE(filter.IsDuplicate(1, 102, repeated));
+  EXPECT_TRUE(filter.IsDuplicate(2, 103, repeated));
+  EXPECT_FALSE(filter.IsDuplicate(2, 103, other));
+  EXPECT_EQ(7U, filter.num_tracked());
+}
+
+TEST(DuplicateRowFilterTest, ForgetsRowsPastTheWindow) {
+  DuplicateRowFilter filter(2);
+  DuplicateRowFilter::Fingerprint fingerprint = MakeFingerprint(10);
+  EXPECT_FALSE(filter.IsDuplicate(0, 0, fingerprint));
+  EXPECT_FALSE(filter.IsDuplicate(1, DuplicateRowFilter::kWindowUs + 1,
+                                  fingerprint));
+  // The first row is forgotten, so only the second is tracked.
+  EXPECT_EQ(1U, filter.num_tracked());
+  EXPECT_TRUE(filter.IsDuplicate(0, DuplicateRowFilter::kWindowUs + 2,
+                                 fingerprint));
+}
+
+TEST(DuplicateRowFilterTest, GetFingerprint) {
+  StringTable file_table;
+  LogStore store(&file_table);
+  StringTable::Atom foo = file_table.Intern("foo.cc");
+  base::Time time = base::Time::Now();
+  sym_util::Address trace[] = { 0x1000, 0x2000 };
+  store.AddRow(TRACE_LEVEL_ERROR, 1, 2, time, foo, 10, "message", 0, NULL);
+  store.AddRow(TRACE_LEVEL_ERROR, 1, 2, time, foo, 10, "message", 0, NULL);
+  store.AddRow(TRACE_LEVEL_ERROR, 1, 2, time, foo, 11, "message", 0, NULL);
+  store.AddRow(TRACE_LEVEL_ERROR, 1, 2, time, foo, 10, "other", 0, NULL);
+  store.AddRow(TRACE_LEVEL_ERROR, 1, 2, time, foo, 10, "message",
+               arraysize(trace), trace);
+
+  DuplicateRowFilter::Fingerprint fingerprints[5];
+  for (int row = 0; row < 5; ++row)
+    DuplicateRowFilter::GetFingerprint(store, row, &fingerprints[row]);
+
+  EXPECT_EQ(1U, fingerprints[0].process_id);
+  EXPECT_EQ(2U, fingerprints[0].thread_id);
+  EXPECT_TRUE(fingerprints[0] == fingerprints[1]);
+  // The line goes to the location, the message and trace to the payload.
+  EXPECT_NE(fingerprints[0].location, fingerprints[2].location);
+  EXPECT_EQ(fingerprints[0].payload, fingerprints[2].payload);
+  EXPECT_EQ(fingerprints[0].location, fingerprints[3].location);
+  EXPECT_NE(fingerprints[0].payload, fingerprints[3].payload);
+  EXPECT_NE(fingerprints[0].payload, fingerprints[4].payload);
+}
@@ -35,7 +35,7 @@ const wchar_t kSeparator[] = L"|";
 Filter::Filter(Column column, Relation relation, Action action,
                const wchar_t* value)
     : column_(column), relation_(relation), action_(action), is_valid_(true),
-      match_re_("") {
+      matcher_("", PatternMatcher::PARTIAL_MATCH) {
   DCHECK(column < NUM_COLUMNS && relation < NUM_RELATIONS &&
          action < NUM_ACTIONS && value != NULL);
   value_ = base::WideToUTF8(value);
@@ -43,19 +43,30 @@ Filter::Filter(Column column, Relation relation, Action action,
 }
 
 
-Filter::Filter(const base::DictionaryValue* const serialized) : match_re_("") {
+Filter::Filter(const base::DictionaryValue* const serialized)
+    : matcher_("", PatternMatcher::PARTIAL_MATCH) {
   is_valid_ = Deserialize(serialized);
   BuildRegExp();
 }
 
 void Filter::BuildRegExp() {
+  // Any cached file and stack matches are stale with a new value.
+  file_atom_matches_.clear();
+  module_set_matches_.clear();
+  function_set_matches_.clear();
+  instance_matches_.clear();
+
   switch (column_) {
     case SEVERITY:
     case TIME:
     case FILE:
     case MESSAGE:
-      match_re_ = pcrecpp::RE(value_.c_str(),
-          PCRE_NEWLINE_ANYCRLF | PCRE_DOTALL | PCRE_UTF8 | PCRE_CASELESS);
+    case STACK:
+    case PROCESS_NAME:
+    case COMMAND_LINE:
+    case PROCESS_INSTANCE:
+      matcher_ = PatternMatcher(value_, relation_ == IS ?
+          PatternMatcher::FULL_MATCH : PatternMatcher::PARTIAL_MATCH);
       break;
   }
 }
@@ -89,7 +100,7 @@ bool Filter::Matches(ILogView* log_view, int row_index) const {
       break;
     }
     case FILE: {
-      matches = ValueMatchesString(log_view->GetFileName(row_index));
+      matches = FileMatches(log_view, row_index);
       break;
     }
     case LINE: {
@@ -97,7 +108,19 @@ bool Filter::Matches(ILogView* log_view, int row_index) const {
       break;
     }
     case MESSAGE: {
-      matches = ValueMatchesString(log_view->GetMessage(row_index));
+      std::string buffer;
+      matches = ValueMatchesString(
+          log_view->GetMessagePiece(row_index, &buffer));
+      break;
+    }
+    case STACK: {
+      matches = StackMatches(log_view, row_index);
+      break;
+    }
+    case PROCESS_NAME:
+    case COMMAND_LINE:
+    case PROCESS_INSTANCE: {
+      matches = ProcessMatches(log_view, row_index);
       break;
     }
     default:
@@ -123,15 +146,91 @@ bool Filter::ValueMatchesInt(int check_value) const {
   return matches;
 }
 
-bool Filter::ValueMatchesString(const std::string& check_string) const {
-  DCHECK(!match_re_.pattern().empty());
-  bool matches = false;
-  if (relation_ == IS) {
-    matches = match_re_.FullMatch(check_string);
-  } else if (relation_ == CONTAINS) {
-    matches = match_re_.PartialMatch(check_string);
+bool Filter::ValueMatchesString(
+    const base::StringPiece& check_string) const {
+  DCHECK(!matcher_.pattern().empty());
+  return matcher_.Matches(check_string);
+}
+
+bool Filter::FileMatches(ILogView* log_view, int row_index) const {
+  StringTable::Atom atom = log_view->GetFileAtom(row_index);
+  if (atom >= file_atom_matches_.size())
+    file_atom_matches_.resize(atom + 1, ATOM_UNKNOWN);
+
+  if (file_atom_matches_[atom] == ATOM_UNKNOWN) {
+    std::string buffer;
+    bool matches = ValueMatchesString(
+        log_view->GetFileNamePiece(row_index, &buffer));
+    file_atom_matches_[atom] = matches ? ATOM_MATCHES : ATOM_DOES_NOT_MATCH;
   }
-  return matches;
+
+  return file_atom_matches_[atom] == ATOM_MATCHES;
+}
+
+bool Filter::StackMatches(ILogView* log_view, int row_index) const {
+  StackModuleIndex* index = log_view->GetStackModuleIndex();
+  if (index == NULL)
+    return false;
+
+  if (StackSetMatches(index, false,
+                      index->GetModuleSet(log_view, row_index))) {
+    return true;
+  }
+  if (value_.find('.') != std::string::npos)
+    return false;
+
+  return StackSetMatches(index, true,
+                         index->GetFunctionSet(log_view, row_index));
+}
+
+bool Filter::StackSetMatches(StackModuleIndex* index,
+                             bool functions,
+                             StackModuleIndex::SetId set) const {
+  std::vector<uint8>& set_matches = functions ?
+      function_set_matches_ : module_set_matches_;
+  if (set >= set_matches.size())
+    set_matches.resize(set + 1, ATOM_UNKNOWN);
+
+  if (set_matches[set] == ATOM_UNKNOWN) {
+    std::vector<std::string> names;
+    if (functions)
+      index->GetFunctionNames(set, &names);
+    else
+      index->GetModuleNames(set, &names);
+
+    bool matches = false;
+    for (size_t i = 0; i < names.size() && !matches; ++i)
+      matches = ValueMatchesString(names[i]);
+    set_matches[set] = matches ? ATOM_MATCHES : ATOM_DOES_NOT_MATCH;
+  }
+
+  return set_matches[set] == ATOM_MATCHES;
+}
+
+bool Filter::ProcessMatches(ILogView* log_view, int row_index) const {
+  ProcessInstanceIndex* index = log_view->GetProcessInstanceIndex();
+  if (index == NULL)
+    return false;
+
+  ProcessInstanceIndex::InstanceId instance = index->GetInstance(
+      log_view->GetProcessId(row_index), log_view->GetTime(row_index));
+  if (instance >= instance_matches_.size())
+    instance_matches_.resize(instance + 1, ATOM_UNKNOWN);
+
+  if (instance_matches_[instance] == ATOM_UNKNOWN) {
+    std::string value;
+    if (column_ == PROCESS_NAME)
+      value = index->GetImageName(instance);
+    else if (column_ == COMMAND_LINE)
+      value = index->GetCommandLine(instance);
+    else
+      value = index->GetInstanceKey(instance);
+    bool matches = ValueMatchesString(value);
+    instance_matches_[instance] =
+        matches ? ATOM_MATCHES : ATOM_DOES_NOT_MATCH;
+  }
+
+  return instance_matches_[instance] == ATOM_MATCHES;
 }
 
 base::DictionaryValue* Filter::Serialize() const {
@@ -20,8 +20,11 @@
 
 #include <string>
 #include <vector>
+#include "base/strings/string_piece.h"
 #include "sawbuck/viewer/log_list_view.h"
-#include "pcrecpp.h"  // NOLINT
+#include "sawbuck/viewer/pattern_matcher.h"
+#include "sawbuck/viewer/process_instance_index.h"
+#include "sawbuck/viewer/stack_module_index.h"
 
 // forward
 namespace base {
@@ -49,6 +52,16 @@ class Filter {
     FILE = LogViewFormatter::FILE,
     LINE = LogViewFormatter::LINE,
     MESSAGE = LogViewFormatter::MESSAGE,
+    // The modules and functions the row's stack trace passes through, of
+    // which the formatter has no column, see StackMatches.
+    STACK = LogViewFormatter::MESSAGE + 1,
+    // The image name and command line of the row's process instance, see
+    // ProcessMatches.
+    PROCESS_NAME,
+    COMMAND_LINE,
+    // The row's process instance, by its key, see
+    // ProcessInstanceIndex::FormatInstanceKey.
+    PROCESS_INSTANCE,
     NUM_COLUMNS
   };
 
@@ -77,6 +90,13 @@ class Filter {
   // Returns true if this filter matches the log entry in log_view on row_index.
   bool Matches(ILogView* log_view, int row_index) const;
 
+  // Returns true if this filter's value matches |check_value|, for the
+  // integer columns.
+  bool ValueMatchesInt(int check_value) const;
+  // Returns true if this filter's value matches |check_string|, for the
+  // string columns.
+  bool ValueMatchesString(const base::StringPiece& check_string) const;
+
   // Returns a JSON value representation of this filter. This representation
   // can be used in the constructor that takes a serialized representation.
   // Note that ownership of the Value is assigned to the caller.
@@ -109,14 +129,31 @@ class Filter {
 
  private:
 
-  bool ValueMatchesInt(int check_value) const;
-  bool ValueMatchesString(const std::string& check_string) const;
-
-  // Sets up match_re_ if needed.
+  // Matches the file of row_index, by way of file_atom_matches_.
+  bool FileMatches(ILogView* log_view, int row_index) const;
+
+  // Matches the stack trace of row_index, which matches if any of the
+  // modules it passes through matches. Values without a dot are matched
+  // against the trace's functions too, as module names have dots where
+  // function names don't, which takes the trace's symbols. Views without
+  // a stack module index match no stack filter.
+  bool StackMatches(ILogView* log_view, int row_index) const;
+  // Matches the names of module or function set @p set of @p index, by way
+  // of module_set_matches_ or function_set_matches_.
+  bool StackSetMatches(StackModuleIndex* index,
+                       bool functions,
+                       StackModuleIndex::SetId set) const;
+
+  // Matches the image name, command line or key of the process instance
+  // of row_index, by way of instance_matches_. Views without a process
+  // instance index match no process filter.
+  bool ProcessMatches(ILogView* log_view, int row_index) const;
+
+  // Sets up matcher_ if needed.
   void BuildRegExp();
 
-  // As an optimization, we compile a matching reg exp at construction.
-  pcrecpp::RE match_re_;
+  // As an optimization, we compile a matcher at construction.
+  PatternMatcher matcher_;
 
   Column column_;
   Relation relation_;
@@ -127,6 +164,22 @@ class Filter {
   std::string value_;
 
   bool is_valid_;
+
+  // File names repeat a lot, so FILE filters cache the outcome of the
+  // match against each file atom seen. Indexed by atom, this assumes the
+  // filter is applied to views over a single string table.
+  enum AtomMatch {
+    ATOM_UNKNOWN = 0,
+    ATOM_MATCHES,
+    ATOM_DOES_NOT_MATCH,
+  };
+  mutable std::vector<uint8> file_atom_matches_;
+  // Likewise STACK filters cache the outcome per module and function set,
+  // which assumes the filter is applied to views over a single index.
+  mutable std::vector<uint8> module_set_matches_;
+  mutable std::vector<uint8> function_set_matches_;
+  // And the process filters per process instance.
+  mutable std::vector<uint8> instance_matches_;
 };
 
 
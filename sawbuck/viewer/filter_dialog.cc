@@ -20,6 +20,7 @@
 
 #include "base/file_util.h"
 #include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
 #include "base/strings/utf_string_conversions.h"
 #include "pcrecpp.h"  // NOLINT
 #include "sawbuck/viewer/const_config.h"
@@ -54,6 +55,10 @@ const wchar_t* FilterDialog::kColumns[] = {
   L"File",
   L"Line",
   L"Message",
+  L"Stack",
+  L"Process name",
+  L"Command line",
+  L"Process instance",
 };
 
 const wchar_t* FilterDialog::kRelations[] = {
@@ -66,6 +71,15 @@ const wchar_t* FilterDialog::kActions[] = {
   L"exclude",
 };
 
+namespace {
+
+// The preview is refined a pass per tick of this timer, which keeps the
+// dialog responsive while a pass is sampled.
+const UINT_PTR kPreviewTimerId = 1;
+const UINT kPreviewMs = 50;
+
+}  // namespace
+
 template <size_t N>
 void PopulateCombobox(CComboBox* combo_box, const wchar_t* (&strings)[N]) {
   DCHECK(combo_box);
@@ -75,6 +89,17 @@ void PopulateCombobox(CComboBox* combo_box, const wchar_t* (&strings)[N]) {
   combo_box->SetCurSel(0);
 }
 
+FilterDialog::FilterDialog()
+    : current_filter_(0), preview_view_(NULL) {
+}
+
+FilterDialog::FilterDialog(ILogView* preview_view)
+    : current_filter_(0), preview_view_(preview_view) {
+}
+
+FilterDialog::~FilterDialog() {
+}
+
 BOOL FilterDialog::OnInitDialog(CWindow focus_window, LPARAM init_param) {
   DlgResize_Init();
   CenterWindow();
@@ -105,6 +130,15 @@ BOOL FilterDialog::OnInitDialog(CWindow focus_window, LPARAM init_param) {
   reset_filter_button_.Attach(GetDlgItem(IDC_FILTER_RESET));
   DCHECK(reset_filter_button_.m_hWnd);
 
+  preview_text_.Attach(GetDlgItem(IDC_FILTER_PREVIEW));
+  preview_examples_.Attach(GetDlgItem(IDC_FILTER_EXAMPLES));
+  if (preview_view_ != NULL) {
+    preview_.reset(new FilterPreview(preview_view_));
+  } else {
+    preview_text_.ShowWindow(SW_HIDE);
+    preview_examples_.ShowWindow(SW_HIDE);
+  }
+
   Preferences pref;
   std::string stored;
   if (pref.ReadStringValue(config::kFilterValues, &stored, "")) {
@@ -132,6 +166,56 @@ void FilterDialog::PopulateFilterList() {
     filter_list_view_.AddItem(item, 2, base::UTF8ToWide(iter->value()).c_str());
     filter_list_view_.AddItem(item, 3, FilterDialog::kActions[iter->action()]);
   }
+
+  RestartPreview();
+}
+
+void FilterDialog::RestartPreview() {
+  if (preview_.get() == NULL)
+    return;
+
+  std::vector<Filter> filters(filters_);
+  Filter edited(GetEditedFilter());
+  if (!edited.value().empty())
+    filters.push_back(edited);
+
+  preview_->SetFilters(filters);
+  UpdatePreview();
+  if (!preview_->IsDone())
+    SetTimer(kPreviewTimerId, kPreviewMs);
+}
+
+void FilterDialog::UpdatePreview() {
+  DCHECK(preview_.get() != NULL);
+  const FilterPreview::Estimate& estimate = preview_->estimate();
+
+  std::wstring text;
+  if (estimate.margin == 0) {
+    text = base::StringPrintf(L"%lld of %lld rows match.",
+                              estimate.estimated_matches,
+                              estimate.total_rows);
+  } else {
+    text = base::StringPrintf(
+        L"About %lld (\x00B1%lld) of %lld rows match, from a sample of "
+            L"%lld rows.",
+        estimate.estimated_matches, estimate.margin, estimate.total_rows,
+        estimate.sampled_rows);
+  }
+  preview_text_.SetWindowText(text.c_str());
+
+  preview_examples_.SetRedraw(FALSE);
+  preview_examples_.ResetContent();
+  const std::vector<int>& examples = preview_->examples();
+  for (size_t i = 0; i < examples.size(); ++i) {
+    int row = examples[i];
+    std::wstring example = base::StringPrintf(L"%ls(%d): %ls",
+        base::UTF8ToWide(preview_view_->GetFileName(row)).c_str(),
+        preview_view_->GetLine(row),
+        base::UTF8ToWide(preview_view_->GetMessage(row)).c_str());
+    preview_examples_.AddString(example.c_str());
+  }
+  preview_examples_.SetRedraw(TRUE);
+  preview_examples_.Invalidate();
 }
 
 
@@ -140,9 +224,23 @@ void FilterDialog::OnClose() {
 }
 
 void FilterDialog::OnDestroy() {
+  KillTimer(kPreviewTimerId);
+  preview_.reset();
   filter_list_view_.Detach();
 }
 
+void FilterDialog::OnTimer(UINT_PTR timer_id) {
+  if (timer_id != kPreviewTimerId) {
+    SetMsgHandled(FALSE);
+    return;
+  }
+
+  if (preview_.get() == NULL || !preview_->Refine())
+    KillTimer(kPreviewTimerId);
+  if (preview_.get() != NULL)
+    UpdatePreview();
+}
+
 void FilterDialog::OnIdOk(UINT notify_code, int id, CWindow window) {
   EndDialog(IDOK);
 }
@@ -151,7 +249,7 @@ void FilterDialog::OnIdCancel(UINT notify_code, int id, CWindow window) {
   EndDialog(IDCANCEL);
 }
 
-void FilterDialog::OnFilterAdd(UINT notify_code, int id, CWindow window) {
+Filter FilterDialog::GetEditedFilter() {
   // Get the filter data:
   int column = column_dropdown_.GetCurSel();
   int relation = relation_dropdown_.GetCurSel();
@@ -163,11 +261,18 @@ void FilterDialog::OnFilterAdd(UINT notify_code, int id, CWindow window) {
   value.resize(length);
   value_dropdown_.GetWindowText(&value[0], length + 1);
 
-  Filter filter(static_cast<Filter::Column>(column),
+  return Filter(static_cast<Filter::Column>(column),
                 static_cast<Filter::Relation>(relation),
                 static_cast<Filter::Action>(action),
                 value.c_str());
-  filters_.push_back(filter);
+}
+
+void FilterDialog::OnFilterEdited(UINT notify_code, int id, CWindow window) {
+  RestartPreview();
+}
+
+void FilterDialog::OnFilterAdd(UINT notify_code, int id, CWindow window) {
+  filters_.push_back(GetEditedFilter());
 
   PopulateFilterList();
 
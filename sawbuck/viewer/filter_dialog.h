@@ -23,7 +23,9 @@
 #include <string>
 #include <vector>
 
+#include "base/memory/scoped_ptr.h"
 #include "sawbuck/viewer/filter.h"
+#include "sawbuck/viewer/filter_preview.h"
 #include "sawbuck/viewer/list_view_base.h"
 #include "sawbuck/viewer/resource.h"
 
@@ -69,6 +71,7 @@ class FilterDialog: public CDialogImpl<FilterDialog>,
     MSG_WM_INITDIALOG(OnInitDialog)
     MSG_WM_CLOSE(OnClose)
     MSG_WM_DESTROY(OnDestroy)
+    MSG_WM_TIMER(OnTimer)
     COMMAND_ID_HANDLER_EX(IDC_FILTER_ADD, OnFilterAdd)
     COMMAND_ID_HANDLER_EX(IDC_FILTER_REMOVE, OnFilterRemove)
     COMMAND_ID_HANDLER_EX(IDC_FILTER_RESET, OnFilterReset)
@@ -76,6 +79,10 @@ class FilterDialog: public CDialogImpl<FilterDialog>,
     COMMAND_ID_HANDLER_EX(IDCANCEL, OnIdCancel)
     COMMAND_ID_HANDLER_EX(IDC_FILTER_SAVE, OnFilterSave)
     COMMAND_ID_HANDLER_EX(IDC_FILTER_LOAD, OnFilterLoad)
+    COMMAND_HANDLER_EX(IDC_FILTER_TEXT, CBN_EDITCHANGE, OnFilterEdited)
+    COMMAND_HANDLER_EX(IDC_FILTER_COLUMN, CBN_SELCHANGE, OnFilterEdited)
+    COMMAND_HANDLER_EX(IDC_FILTER_RELATION, CBN_SELCHANGE, OnFilterEdited)
+    COMMAND_HANDLER_EX(IDC_FILTER_ACTION, CBN_SELCHANGE, OnFilterEdited)
     CHAIN_MSG_MAP(CDialogResize<FilterDialog>)
   END_MSG_MAP()
 
@@ -87,6 +94,8 @@ class FilterDialog: public CDialogImpl<FilterDialog>,
     DLGRESIZE_CONTROL(IDC_FILTER_TEXT, DLSZ_SIZE_X)
     DLGRESIZE_CONTROL(IDC_FILTER_ACTION, DLSZ_MOVE_X)
     DLGRESIZE_CONTROL(IDC_FILTER_LIST, DLSZ_SIZE_X | DLSZ_SIZE_Y)
+    DLGRESIZE_CONTROL(IDC_FILTER_PREVIEW, DLSZ_SIZE_X | DLSZ_MOVE_Y)
+    DLGRESIZE_CONTROL(IDC_FILTER_EXAMPLES, DLSZ_SIZE_X | DLSZ_MOVE_Y)
     DLGRESIZE_CONTROL(IDC_FILTER_STATIC, DLSZ_MOVE_X)
     DLGRESIZE_CONTROL(IDC_FILTER_SAVE, DLSZ_MOVE_X | DLSZ_MOVE_Y)
     DLGRESIZE_CONTROL(IDC_FILTER_LOAD, DLSZ_MOVE_X | DLSZ_MOVE_Y)
@@ -94,6 +103,12 @@ class FilterDialog: public CDialogImpl<FilterDialog>,
 
   static const int IDD = IDD_FILTERDIALOG;
 
+  FilterDialog();
+  // Previews the rows of @p preview_view the filters pass as they're
+  // edited, see FilterPreview.
+  explicit FilterDialog(ILogView* preview_view);
+  ~FilterDialog();
+
   static const wchar_t* kColumns[];
   static const wchar_t* kRelations[];
   static const wchar_t* kActions[];
@@ -104,6 +119,7 @@ class FilterDialog: public CDialogImpl<FilterDialog>,
   BOOL OnInitDialog(CWindow focus_window, LPARAM init_param);
   void OnClose();
   void OnDestroy();
+  void OnTimer(UINT_PTR timer_id);
   void OnIdOk(UINT notify_code, int id, CWindow window);
   void OnIdCancel(UINT notify_code, int id, CWindow window);
   void OnFilterAdd(UINT notify_code, int id, CWindow window);
@@ -112,12 +128,26 @@ class FilterDialog: public CDialogImpl<FilterDialog>,
 
   void OnFilterSave(UINT notify_code, int id, CWindow window);
   void OnFilterLoad(UINT notify_code, int id, CWindow window);
+  void OnFilterEdited(UINT notify_code, int id, CWindow window);
+
+  // @returns the filter the controls describe.
+  Filter GetEditedFilter();
 
   void PopulateFilterList();
 
+  // Starts the preview over for the filters listed, and the one being
+  // edited if it has a value.
+  void RestartPreview();
+  // Shows the preview's estimate and examples so far.
+  void UpdatePreview();
+
   int current_filter_;
   std::vector<Filter> filters_;
 
+  // The view previewed and its preview, NULL without one.
+  ILogView* preview_view_;
+  scoped_ptr<FilterPreview> preview_;
+
   FilterListView filter_list_view_;
 
   CComboBox column_dropdown_;
@@ -128,6 +158,9 @@ class FilterDialog: public CDialogImpl<FilterDialog>,
   CButton add_filter_button_;
   CButton remove_filter_button_;
   CButton reset_filter_button_;
+
+  CStatic preview_text_;
+  CListBox preview_examples_;
 };
 
 #endif  // SAWBUCK_VIEWER_FILTER_DIALOG_H_
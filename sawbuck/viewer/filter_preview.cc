@@ -0,0 +1,182 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Filter preview implementation.
+#include "sawbuck/viewer/filter_preview.h"
+
+#include <math.h>
+#include <algorithm>
+#include "base/logging.h"
+#include "sawbuck/viewer/log_list_view.h"
+
+namespace {
+
+// The z-score of a two sided 95% confidence interval.
+const double kConfidenceZ = 1.96;
+
+int GreatestCommonDivisor(int a, int b) {
+  while (b != 0) {
+    int remainder = a % b;
+    a = b;
+    b = remainder;
+  }
+  return a;
+}
+
+// Returns a stride coprime with @p num_runs near its golden section, so that
+// successive runs land far apart and fill the gaps between them evenly.
+int GetStride(int num_runs) {
+  if (num_runs <= 2)
+    return 1;
+  int stride = static_cast<int>(num_runs * 0.618);
+  while (stride > 1 && GreatestCommonDivisor(stride, num_runs) != 1)
+    --stride;
+  return std::max(stride, 1);
+}
+
+}  // namespace
+
+const int FilterPreview::kNumStrata;
+const int FilterPreview::kRunRows;
+const int64 FilterPreview::kMaxSampledRows;
+const size_t FilterPreview::kMaxExamples;
+
+FilterPreview::FilterPreview(ILogView* view)
+    : view_(view), first_row_(0), end_row_(0), passes_(0), max_runs_(0) {
+  DCHECK(view_ != NULL);
+}
+
+FilterPreview::~FilterPreview() {
+}
+
+void FilterPreview::SetFilters(const std::vector<Filter>& filters) {
+  std::vector<Filter> inclusion_filters;
+  std::vector<Filter> exclusion_filters;
+  std::vector<Filter>::const_iterator iter(filters.begin());
+  for (; iter != filters.end(); ++iter) {
+    if (iter->action() == Filter::INCLUDE)
+      inclusion_filters.push_back(*iter);
+    else
+      exclusion_filters.push_back(*iter);
+  }
+  program_.reset(new FilterProgram(inclusion_filters, exclusion_filters));
+
+  first_row_ = view_->GetFirstRow();
+  end_row_ = view_->GetNumRows();
+  int num_runs = (end_row_ - first_row_ + kRunRows - 1) / kRunRows;
+  int num_strata = std::min(kNumStrata, num_runs);
+
+  strata_.clear();
+  strata_.resize(num_strata);
+  max_runs_ = 0;
+  for (int i = 0; i < num_strata; ++i) {
+    Stratum& stratum = strata_[i];
+    stratum.first_run = static_cast<int>(
+        static_cast<int64>(num_runs) * i / num_strata);
+    int next_run = static_cast<int>(
+        static_cast<int64>(num_runs) * (i + 1) / num_strata);
+    stratum.num_runs = next_run - stratum.first_run;
+    stratum.stride = GetStride(stratum.num_runs);
+    max_runs_ = std::max(max_runs_, stratum.num_runs);
+  }
+
+  passes_ = 0;
+  examples_.clear();
+  estimate_ = Estimate();
+  estimate_.total_rows = end_row_ - first_row_;
+}
+
+bool FilterPreview::Refine() {
+  if (IsDone())
+    return false;
+
+  // The rows evicted since the filters were set are skipped.
+  int first_row = std::max(first_row_, view_->GetFirstRow());
+  for (size_t i = 0; i < strata_.size(); ++i) {
+    Stratum& stratum = strata_[i];
+    if (passes_ >= stratum.num_runs)
+      continue;
+
+    int run = stratum.first_run +
+        static_cast<int>(static_cast<int64>(passes_) * stratum.stride %
+                         stratum.num_runs);
+    int begin = std::max(first_row_ + run * kRunRows, first_row);
+    int end = std::min(first_row_ + (run + 1) * kRunRows, end_row_);
+    if (begin >= end)
+      continue;
+
+    rows_.clear();
+    program_->Run(view_, view_->GetLogStore(), NULL, begin, end, &rows_);
+    stratum.sampled += end - begin;
+    stratum.matched += rows_.size();
+    for (size_t j = 0; j < rows_.size(); ++j)
+      examples_.push_back(rows_[j]);
+  }
+  ++passes_;
+
+  // Keep the earliest examples.
+  std::sort(examples_.begin(), examples_.end());
+  if (examples_.size() > kMaxExamples)
+    examples_.resize(kMaxExamples);
+
+  UpdateEstimate();
+  return !IsDone();
+}
+
+void FilterPreview::RefineAll() {
+  while (Refine()) {
+  }
+}
+
+bool FilterPreview::IsDone() const {
+  return program_.get() == NULL || passes_ >= max_runs_ ||
+      estimate_.sampled_rows >= kMaxSampledRows;
+}
+
+int64 FilterPreview::GetStratumRows(const Stratum& stratum) const {
+  int64 begin = first_row_ + static_cast<int64>(stratum.first_run) * kRunRows;
+  int64 end = std::min(
+      begin + static_cast<int64>(stratum.num_runs) * kRunRows,
+      static_cast<int64>(end_row_));
+  return end - begin;
+}
+
+void FilterPreview::UpdateEstimate() {
+  int64 sampled_rows = 0;
+  int64 matched_rows = 0;
+  double estimated_matches = 0;
+  double variance = 0;
+  for (size_t i = 0; i < strata_.size(); ++i) {
+    const Stratum& stratum = strata_[i];
+    sampled_rows += stratum.sampled;
+    matched_rows += stratum.matched;
+    if (stratum.sampled == 0)
+      continue;
+
+    double rows = static_cast<double>(GetStratumRows(stratum));
+    double rate = static_cast<double>(stratum.matched) / stratum.sampled;
+    estimated_matches += rate * rows;
+    // The finite population correction takes the variance to zero as the
+    // sample takes in the stratum.
+    double correction = std::max(0.0, 1.0 - stratum.sampled / rows);
+    variance += rows * rows * rate * (1 - rate) / stratum.sampled *
+        correction;
+  }
+
+  estimate_.sampled_rows = sampled_rows;
+  estimate_.matched_rows = matched_rows;
+  estimate_.estimated_matches =
+      static_cast<int64>(estimated_matches + 0.5);
+  estimate_.margin = static_cast<int64>(kConfidenceZ * sqrt(variance) + 0.5);
+}
@@ -0,0 +1,133 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Filter preview declaration.
+#ifndef SAWBUCK_VIEWER_FILTER_PREVIEW_H_
+#define SAWBUCK_VIEWER_FILTER_PREVIEW_H_
+
+#include <vector>
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "sawbuck/viewer/filter.h"
+#include "sawbuck/viewer/filter_program.h"
+
+class ILogView;
+
+// Estimates how many rows of a log view a set of filters passes, from a
+// sample of the rows rather than all of them, so that filters can be tuned
+// without scanning the log for each edit. The rows are split into
+// kNumStrata strata of consecutive rows, and each pass samples a run of
+// kRunRows rows from each stratum, a run it hasn't sampled before, spread
+// over the stratum. The estimate is refined pass by pass, until the sample
+// reaches kMaxSampledRows or takes in every row.
+// The view's rows are those it had as the filters were set, rows added
+// since aren't sampled and rows evicted since are skipped.
+// @note this class isn't thread safe, and the view must not change during
+//    a pass.
+class FilterPreview {
+ public:
+  // The strata the rows are split into.
+  static const int kNumStrata = 64;
+  // The rows of a run, a block of the filter program.
+  static const int kRunRows = FilterProgram::kBlockRows;
+  // The sample is refined up to this many rows.
+  static const int64 kMaxSampledRows = 256 * 1024;
+  // The most example rows kept.
+  static const size_t kMaxExamples = 8;
+
+  struct Estimate {
+    Estimate() : total_rows(0), sampled_rows(0), matched_rows(0),
+        estimated_matches(0), margin(0) {
+    }
+
+    // The rows of the view as the filters were set.
+    int64 total_rows;
+    // The rows sampled so far, and those of them that passed.
+    int64 sampled_rows;
+    int64 matched_rows;
+    // The estimated rows the filters pass, the sum over strata of each
+    // stratum's pass rate times its rows, and the half width of its 95%
+    // confidence interval, which is zero once every row is sampled.
+    int64 estimated_matches;
+    int64 margin;
+  };
+
+  explicit FilterPreview(ILogView* view);
+  ~FilterPreview();
+
+  // Starts over estimating for @p filters, which are split into inclusion
+  // and exclusion filters as FilteredLogView does.
+  void SetFilters(const std::vector<Filter>& filters);
+
+  // Samples another run of each stratum, and refines the estimate.
+  // @returns true iff there are passes left.
+  bool Refine();
+
+  // Refines until done.
+  void RefineAll();
+
+  // @returns true iff there are no passes left.
+  bool IsDone() const;
+
+  const Estimate& estimate() const { return estimate_; }
+
+  // @returns the first sampled rows that passed, in order, at most
+  //     kMaxExamples of them.
+  const std::vector<int>& examples() const { return examples_; }
+
+ private:
+  struct Stratum {
+    Stratum() : first_run(0), num_runs(0), stride(0), sampled(0),
+        matched(0) {
+    }
+
+    // The stratum's runs are [first_run, first_run + num_runs).
+    int first_run;
+    int num_runs;
+    // The runs are visited stride apart, modulo num_runs, which the stride
+    // is coprime with, so that each is visited once.
+    int stride;
+    int64 sampled;
+    int64 matched;
+  };
+
+  // @returns the number of rows of @p stratum.
+  int64 GetStratumRows(const Stratum& stratum) const;
+
+  // Recomputes estimate_ from the strata.
+  void UpdateEstimate();
+
+  ILogView* view_;
+  scoped_ptr<FilterProgram> program_;
+
+  // The rows being sampled, as the filters were set.
+  int first_row_;
+  int end_row_;
+
+  std::vector<Stratum> strata_;
+  // The number of passes done, which is the number of runs sampled from
+  // each stratum.
+  int passes_;
+  // The most runs of any stratum.
+  int max_runs_;
+
+  Estimate estimate_;
+  std::vector<int> examples_;
+  // Scratch space for the rows that pass.
+  std::vector<int> rows_;
+
+  DISALLOW_COPY_AND_ASSIGN(FilterPreview);
+};
+
+#endif  // SAWBUCK_VIEWER_FILTER_PREVIEW_H_
@@ -0,0 +1,137 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Filter preview unit tests.
+#include "sawbuck/viewer/filter_preview.h"
+
+#include <set>
+#include "base/strings/stringprintf.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/log_store.h"
+#include "sawbuck/viewer/store_log_view.h"
+
+namespace {
+
+using testing::StoreLogView;
+
+class FilterPreviewTest : public testing::Test {
+ public:
+  FilterPreviewTest() : store_(&file_table_), view_(&store_) {
+  }
+
+  // Adds @p num_rows rows, a tenth of them from process 20 and the rest
+  // from process 10.
+  void AddRows(int num_rows) {
+    base::Time time(base::Time::Now());
+    StringTable::Atom file = file_table_.Intern("foo.cc");
+    for (int i = 0; i < num_rows; ++i) {
+      store_.AddRow(TRACE_LEVEL_INFORMATION, i % 10 == 0 ? 20 : 10, 100,
+                    time + base::TimeDelta::FromMilliseconds(i), file, 1,
+                    base::StringPrintf("Row %d", i), 0, NULL);
+    }
+  }
+
+  std::vector<Filter> ProcessFilter(const wchar_t* process_id) {
+    std::vector<Filter> filters;
+    filters.push_back(Filter(Filter::PROCESS_ID, Filter::IS,
+                             Filter::INCLUDE, process_id));
+    return filters;
+  }
+
+ protected:
+  StringTable file_table_;
+  LogStore store_;
+  StoreLogView view_;
+};
+
+}  // namespace
+
+TEST_F(FilterPreviewTest, EmptyView) {
+  FilterPreview preview(&view_);
+  preview.SetFilters(ProcessFilter(L"20"));
+  EXPECT_TRUE(preview.IsDone());
+  EXPECT_FALSE(preview.Refine());
+  EXPECT_EQ(0, preview.estimate().total_rows);
+  EXPECT_EQ(0, preview.estimate().estimated_matches);
+}
+
+TEST_F(FilterPreviewTest, SmallViewIsExact) {
+  AddRows(1000);
+  FilterPreview preview(&view_);
+  preview.SetFilters(ProcessFilter(L"20"));
+  EXPECT_FALSE(preview.IsDone());
+  preview.RefineAll();
+
+  const FilterPreview::Estimate& estimate = preview.estimate();
+  EXPECT_EQ(1000, estimate.total_rows);
+  EXPECT_EQ(1000, estimate.sampled_rows);
+  EXPECT_EQ(100, estimate.matched_rows);
+  EXPECT_EQ(100, estimate.estimated_matches);
+  EXPECT_EQ(0, estimate.margin);
+
+  ASSERT_EQ(FilterPreview::kMaxExamples, preview.examples().size());
+  for (size_t i = 0; i < preview.examples().size(); ++i)
+    EXPECT_EQ(static_cast<int>(i * 10), preview.examples()[i]);
+}
+
+TEST_F(FilterPreviewTest, RefinesProgressively) {
+  const int kNumRows = 100 * 1000;
+  AddRows(kNumRows);
+  FilterPreview preview(&view_);
+  preview.SetFilters(ProcessFilter(L"20"));
+
+  // The first pass takes a run from each stratum.
+  EXPECT_TRUE(preview.Refine());
+  const FilterPreview::Estimate& estimate = preview.estimate();
+  EXPECT_EQ(kNumRows, estimate.total_rows);
+  EXPECT_EQ(FilterPreview::kNumStrata * FilterPreview::kRunRows,
+            estimate.sampled_rows);
+  EXPECT_NEAR(kNumRows / 10, estimate.estimated_matches,
+              kNumRows / 100);
+  EXPECT_LT(0, estimate.margin);
+
+  int64 margin = estimate.margin;
+  EXPECT_TRUE(preview.Refine());
+  EXPECT_EQ(2 * FilterPreview::kNumStrata * FilterPreview::kRunRows,
+            estimate.sampled_rows);
+  EXPECT_GT(margin, estimate.margin);
+
+  // The sample takes in every row once.
+  preview.RefineAll();
+  EXPECT_EQ(kNumRows, estimate.sampled_rows);
+  EXPECT_EQ(kNumRows / 10, estimate.estimated_matches);
+  EXPECT_EQ(0, estimate.margin);
+}
+
+TEST_F(FilterPreviewTest, StopsAtTheSampleLimit) {
+  const int kNumRows = 400 * 1000;
+  AddRows(kNumRows);
+  FilterPreview preview(&view_);
+  preview.SetFilters(std::vector<Filter>());
+  preview.RefineAll();
+
+  const FilterPreview::Estimate& estimate = preview.estimate();
+  EXPECT_LE(FilterPreview::kMaxSampledRows, estimate.sampled_rows);
+  EXPECT_GT(kNumRows, estimate.sampled_rows);
+  // With no filters every row passes.
+  EXPECT_EQ(kNumRows, estimate.estimated_matches);
+  EXPECT_EQ(0, estimate.margin);
+
+  // Starting over forgets the sample.
+  preview.SetFilters(ProcessFilter(L"30"));
+  EXPECT_EQ(0, preview.estimate().sampled_rows);
+  preview.Refine();
+  EXPECT_EQ(0, preview.estimate().estimated_matches);
+  EXPECT_TRUE(preview.examples().empty());
+}
@@ -0,0 +1,685 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Compiled filter program implementation.
+#include "sawbuck/viewer/filter_program.h"
+
+#include <algorithm>
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "sawbuck/viewer/log_store.h"
+#include "sawbuck/viewer/pattern_matcher.h"
+#include "sawbuck/viewer/row_posting_index.h"
+#include "sawbuck/viewer/trigram_index.h"
+
+namespace {
+
+// The fewest literal filters on a column worth combining, as a single
+// literal is cheaper to search for on its own.
+const size_t kMinCombinedLiterals = 2;
+
+// Marks the cached literal matches of a file atom as known.
+const uint8 kKeyKnown = 1 << 7;
+
+enum KeyMatch {
+  KEY_UNKNOWN = 0,
+  KEY_MATCHES,
+  KEY_DOES_NOT_MATCH,
+};
+
+// Sets |match_state| in the state of each row whose value in |column|
+// equals |value|.
+template <class T>
+void MarkEquals(const T* column,
+                int first_row,
+                const int* candidates,
+                int first,
+                int num_rows,
+                T value,
+                uint8 match_state,
+                uint8* state) {
+  if (candidates == NULL) {
+    // This is the loop that matters, keep it simple enough to vectorize.
+    const T* values = column + (first - first_row);
+    for (int i = 0; i < num_rows; ++i)
+      state[i] |= values[i] == value ? match_state : 0;
+  } else {
+    const int* rows = candidates + first;
+    for (int i = 0; i < num_rows; ++i)
+      state[i] |= column[rows[i] - first_row] == value ? match_state : 0;
+  }
+}
+
+// Returns true iff |filter| can be combined with other literal filters on
+// its column, and if so returns its literal in |literal|.
+bool GetCombinableLiteral(const Filter& filter, std::string* literal) {
+  if (filter.column() != Filter::FILE && filter.column() != Filter::MESSAGE)
+    return false;
+  if (filter.relation() != Filter::CONTAINS)
+    return false;
+
+  return PatternMatcher::ParseLiteral(filter.value(), literal) &&
+      !literal->empty();
+}
+
+size_t CountCombinableLiterals(const std::vector<Filter>& filters,
+                               Filter::Column column) {
+  size_t count = 0;
+  std::string literal;
+  for (size_t i = 0; i < filters.size(); ++i) {
+    if (filters[i].column() == column &&
+        GetCombinableLiteral(filters[i], &literal)) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+// Merges the rows of |key| in [|begin|, |end|) of |index| into |rows|,
+// which are in ascending order.
+void MergePostings(const RowPostingIndex& index,
+                   uint32 key,
+                   int begin,
+                   int end,
+                   std::vector<int>* rows) {
+  size_t size = rows->size();
+  index.GetRows(key, begin, end, rows);
+  std::inplace_merge(rows->begin(), rows->begin() + size, rows->end());
+}
+
+}  // namespace
+
+const int FilterProgram::kBlockRows;
+
+FilterProgram::Predicate::Predicate(const Filter& filter)
+    : filter(filter), kind(GENERIC), cost(0), value(0) {
+  match_state = filter.action() == Filter::EXCLUDE ?
+      ROW_EXCLUDED : ROW_INCLUDED;
+
+  switch (filter.column()) {
+    case Filter::PROCESS_ID:
+    case Filter::THREAD_ID:
+    case Filter::LINE:
+      if (filter.relation() == Filter::IS) {
+        kind = INT_EQUALS;
+        // Same as Filter::ValueMatchesInt, a bad value compares as parsed.
+        base::StringToInt(filter.value(), &value);
+      } else {
+        // Contains matches on the formatted integer.
+        cost = 1;
+      }
+      break;
+
+    case Filter::SEVERITY:
+    case Filter::FILE:
+      kind = KEYED;
+      break;
+
+    case Filter::PROCESS_NAME:
+    case Filter::COMMAND_LINE:
+    case Filter::PROCESS_INSTANCE:
+      // Keyed by process instance, which takes a join of the block.
+      kind = KEYED;
+      cost = 1;
+      break;
+
+    case Filter::MESSAGE:
+      cost = 2;
+      // Any match contains this, so rows the message index rules out for
+      // it can't match.
+      index_literal = PatternMatcher::FindRequiredLiteral(filter.value());
+      if (index_literal.size() < TrigramIndex::kMinLiteralLength)
+        index_literal.clear();
+      break;
+
+    case Filter::TIME:
+      // Time needs formatting before matching.
+      cost = 3;
+      break;
+
+    case Filter::STACK:
+      // Each new trace costs a module lookup, and may need its symbols.
+      cost = 4;
+      break;
+
+    default:
+      NOTREACHED() << "Invalid column type in filter!";
+      break;
+  }
+}
+
+bool FilterProgram::Predicate::operator<(const Predicate& other) const {
+  // Inclusions go before exclusions, as an exclusion is only tested on the
+  // rows included by then.
+  if (kind != other.kind)
+    return kind < other.kind;
+  if (match_state != other.match_state)
+    return match_state < other.match_state;
+  return cost < other.cost;
+}
+
+FilterProgram::FilterProgram(const std::vector<Filter>& inclusion,
+                             const std::vector<Filter>& exclusion)
+    : has_inclusions_(!inclusion.empty()),
+      keep_loss_markers_(false),
+      message_stop_state_(0),
+      block_rows_(kBlockRows),
+      block_state_(kBlockRows),
+      block_instances_(kBlockRows),
+      has_block_instances_(false) {
+  size_t num_file_literals =
+      CountCombinableLiterals(inclusion, Filter::FILE) +
+      CountCombinableLiterals(exclusion, Filter::FILE);
+  size_t num_message_literals =
+      CountCombinableLiterals(inclusion, Filter::MESSAGE) +
+      CountCombinableLiterals(exclusion, Filter::MESSAGE);
+  AddFilters(inclusion, num_file_literals, num_message_literals);
+  AddFilters(exclusion, num_file_literals, num_message_literals);
+
+  file_literals_.Build();
+  message_literals_.Build();
+  // A row is done when it's excluded, barring exclusions when it's
+  // included.
+  message_stop_state_ = (message_literals_.flags() & ROW_EXCLUDED) != 0 ?
+      ROW_EXCLUDED : ROW_INCLUDED;
+
+  std::stable_sort(predicates_.begin(), predicates_.end());
+}
+
+FilterProgram::~FilterProgram() {
+}
+
+void FilterProgram::AddFilters(const std::vector<Filter>& filters,
+                               size_t num_file_literals,
+                               size_t num_message_literals) {
+  for (size_t i = 0; i < filters.size(); ++i) {
+    const Filter& filter = filters[i];
+    uint8 match_state = filter.action() == Filter::EXCLUDE ?
+        ROW_EXCLUDED : ROW_INCLUDED;
+
+    std::string literal;
+    if (GetCombinableLiteral(filter, &literal)) {
+      if (filter.column() == Filter::FILE &&
+          num_file_literals >= kMinCombinedLiterals) {
+        file_literals_.AddLiteral(literal, match_state);
+        continue;
+      }
+      if (filter.column() == Filter::MESSAGE &&
+          num_message_literals >= kMinCombinedLiterals) {
+        message_literals_.AddLiteral(literal, match_state);
+        continue;
+      }
+    }
+
+    predicates_.push_back(Predicate(filter));
+  }
+}
+
+void FilterProgram::Run(ILogView* view,
+                        const LogStore* store,
+                        const int* candidates,
+                        int begin,
+                        int end,
+                        std::vector<int>* rows) {
+  DCHECK(view != NULL);
+  DCHECK(rows != NULL);
+
+  for (int first = begin; first < end; first += kBlockRows) {
+    RunBlock(view, store, candidates, first,
+             std::min(kBlockRows, end - first), rows);
+  }
+}
+
+bool FilterProgram::GetCandidateRows(ILogView* view,
+                                     const LogStore& store,
+                                     int begin,
+                                     int end,
+                                     std::vector<int>* rows) {
+  DCHECK(view != NULL);
+  DCHECK(rows != NULL);
+
+  // The combined literals test the file and message columns.
+  if (file_literals_.num_literals() != 0 ||
+      message_literals_.num_literals() != 0) {
+    return false;
+  }
+
+  bool has_severity_inclusions = false;
+  bool has_severity_exclusions = false;
+  for (size_t i = 0; i < predicates_.size(); ++i) {
+    const Predicate& predicate = predicates_[i];
+    if (predicate.filter.column() == Filter::SEVERITY) {
+      if (predicate.match_state == ROW_INCLUDED)
+        has_severity_inclusions = true;
+      else
+        has_severity_exclusions = true;
+    } else if (predicate.filter.column() != Filter::PROCESS_ID ||
+               predicate.kind != INT_EQUALS) {
+      return false;
+    }
+  }
+
+  // Without inclusions, only the excluded severities narrow the rows down.
+  if (!has_inclusions_ && !has_severity_exclusions)
+    return false;
+
+  rows->clear();
+  begin = std::max(begin, store.first_row());
+  end = std::min(end, store.num_rows());
+  if (begin >= end)
+    return true;
+
+  // A row that passes is included by its severity or its process id, and
+  // isn't excluded by that same column, or there are no inclusions and its
+  // severity isn't excluded. Either way it's in one of the lists merged.
+  if (has_severity_inclusions || !has_inclusions_) {
+    const RowPostingIndex& severities = store.severity_postings();
+    uint8 initial_state = has_inclusions_ ? 0 : ROW_INCLUDED;
+    std::vector<uint32> levels;
+    severities.GetKeys(&levels);
+    for (size_t i = 0; i < levels.size(); ++i) {
+      // The last row of a level is retained, and stands in for the rest.
+      int row = severities.GetLastRow(levels[i]);
+      if (row < begin)
+        continue;
+
+      UCHAR level = static_cast<UCHAR>(levels[i]);
+      if ((GetSeverityState(view, level, row) | initial_state) ==
+              ROW_INCLUDED) {
+        MergePostings(severities, levels[i], begin, end, rows);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < predicates_.size(); ++i) {
+    const Predicate& inclusion = predicates_[i];
+    if (inclusion.filter.column() != Filter::PROCESS_ID ||
+        inclusion.match_state != ROW_INCLUDED) {
+      continue;
+    }
+
+    bool excluded = false;
+    for (size_t j = 0; j < predicates_.size() && !excluded; ++j) {
+      const Predicate& exclusion = predicates_[j];
+      excluded = exclusion.filter.column() == Filter::PROCESS_ID &&
+          exclusion.match_state == ROW_EXCLUDED &&
+          exclusion.value == inclusion.value;
+    }
+    if (!excluded) {
+      MergePostings(store.process_postings(),
+                    static_cast<uint32>(inclusion.value), begin, end, rows);
+    }
+  }
+  // A process id may be included twice over, or by its severity too.
+  rows->erase(std::unique(rows->begin(), rows->end()), rows->end());
+
+  if (keep_loss_markers_) {
+    const std::vector<int>& markers = store.loss_marker_rows();
+    size_t size = rows->size();
+    rows->insert(rows->end(),
+                 std::lower_bound(markers.begin(), markers.end(), begin),
+                 std::lower_bound(markers.begin(), markers.end(), end));
+    std::inplace_merge(rows->begin(), rows->begin() + size, rows->end());
+    rows->erase(std::unique(rows->begin(), rows->end()), rows->end());
+  }
+
+  // Where most of the rows are candidates, running them all is as fast.
+  if (rows->size() * 2 > static_cast<size_t>(end - begin) &&
+      end - begin > kBlockRows) {
+    return false;
+  }
+
+  return true;
+}
+
+void FilterProgram::RunBlock(ILogView* view,
+                             const LogStore* store,
+                             const int* candidates,
+                             int first,
+                             int num_rows,
+                             std::vector<int>* rows) {
+  for (int i = 0; i < num_rows; ++i)
+    block_rows_[i] = candidates != NULL ? candidates[first + i] : first + i;
+
+  // Without inclusion filters, all rows start out included.
+  uint8* state = &block_state_[0];
+  std::fill(state, state + num_rows, has_inclusions_ ? 0 : ROW_INCLUDED);
+  has_block_instances_ = false;
+
+  size_t next = 0;
+  for (; next < predicates_.size() && predicates_[next].kind != GENERIC;
+       ++next) {
+    Predicate& predicate = predicates_[next];
+    if (predicate.kind == INT_EQUALS)
+      RunIntEquals(predicate, view, store, candidates, first, num_rows);
+    else
+      RunKeyed(&predicate, view, store, num_rows);
+  }
+
+  // The combined literals go after the cheap predicates, and before the
+  // generic ones.
+  RunFileLiterals(view, store, num_rows);
+  RunMessageLiterals(view, store, num_rows);
+
+  for (; next < predicates_.size(); ++next)
+    RunGeneric(predicates_[next], view, store, num_rows);
+
+  if (keep_loss_markers_)
+    KeepLossMarkers(view, store, num_rows);
+
+  for (int i = 0; i < num_rows; ++i) {
+    if (state[i] == ROW_INCLUDED)
+      rows->push_back(block_rows_[i]);
+  }
+}
+
+void FilterProgram::RunIntEquals(const Predicate& predicate,
+                                 ILogView* view,
+                                 const LogStore* store,
+                                 const int* candidates,
+                                 int first,
+                                 int num_rows) {
+  uint8* state = &block_state_[0];
+  if (store != NULL) {
+    switch (predicate.filter.column()) {
+      case Filter::PROCESS_ID:
+        MarkEquals(store->process_ids(), store->first_row(),
+                   candidates, first, num_rows,
+                   static_cast<DWORD>(predicate.value),
+                   predicate.match_state, state);
+        break;
+
+      case Filter::THREAD_ID:
+        MarkEquals(store->thread_ids(), store->first_row(),
+                   candidates, first, num_rows,
+                   static_cast<DWORD>(predicate.value),
+                   predicate.match_state, state);
+        break;
+
+      case Filter::LINE:
+        MarkEquals(store->lines(), store->first_row(),
+                   candidates, first, num_rows,
+                   static_cast<int32>(predicate.value),
+                   predicate.match_state, state);
+        break;
+
+      default:
+        NOTREACHED();
+        break;
+    }
+    return;
+  }
+
+  for (int i = 0; i < num_rows; ++i) {
+    int row = block_rows_[i];
+    int value = 0;
+    switch (predicate.filter.column()) {
+      case Filter::PROCESS_ID:
+        value = view->GetProcessId(row);
+        break;
+      case Filter::THREAD_ID:
+        value = view->GetThreadId(row);
+        break;
+      case Filter::LINE:
+        value = view->GetLine(row);
+        break;
+      default:
+        NOTREACHED();
+        break;
+    }
+    if (value == predicate.value)
+      state[i] |= predicate.match_state;
+  }
+}
+
+void FilterProgram::RunKeyed(Predicate* predicate,
+                             ILogView* view,
+                             const LogStore* store,
+                             int num_rows) {
+  Filter::Column column = predicate->filter.column();
+  bool is_file = column == Filter::FILE;
+  bool is_process = column == Filter::PROCESS_NAME ||
+      column == Filter::COMMAND_LINE || column == Filter::PROCESS_INSTANCE;
+  if (is_process)
+    JoinProcessInstances(view, store, num_rows);
+
+  const UCHAR* levels = store != NULL ? store->levels() : NULL;
+  const StringTable::Atom* atoms = store != NULL ? store->file_atoms() : NULL;
+  int first_row = store != NULL ? store->first_row() : 0;
+
+  uint8* state = &block_state_[0];
+  std::vector<uint8>& key_matches = predicate->key_matches;
+  for (int i = 0; i < num_rows; ++i) {
+    int row = block_rows_[i];
+    size_t key = 0;
+    if (is_process)
+      key = block_instances_[i];
+    else if (is_file)
+      key = atoms != NULL ? atoms[row - first_row] : view->GetFileAtom(row);
+    else
+      key = levels != NULL ? levels[row - first_row] : view->GetSeverity(row);
+
+    if (key >= key_matches.size())
+      key_matches.resize(key + 1, KEY_UNKNOWN);
+
+    if (key_matches[key] == KEY_UNKNOWN) {
+      // The first row with this key stands in for all of them.
+      key_matches[key] = predicate->filter.Matches(view, row) ?
+          KEY_MATCHES : KEY_DOES_NOT_MATCH;
+    }
+
+    if (key_matches[key] == KEY_MATCHES)
+      state[i] |= predicate->match_state;
+  }
+}
+
+void FilterProgram::JoinProcessInstances(ILogView* view,
+                                         const LogStore* store,
+                                         int num_rows) {
+  // The join is shared by the process predicates of the block.
+  if (has_block_instances_)
+    return;
+  has_block_instances_ = true;
+
+  ProcessInstanceIndex* index = view->GetProcessInstanceIndex();
+  if (index == NULL) {
+    std::fill(block_instances_.begin(), block_instances_.begin() + num_rows,
+              ProcessInstanceIndex::kUnknownInstance);
+    return;
+  }
+  index->GetInstances(view, store, &block_rows_[0], num_rows,
+                      &block_instances_[0]);
+}
+
+void FilterProgram::RunGeneric(const Predicate& predicate,
+                               ILogView* view,
+                               const LogStore* store,
+                               int num_rows) {
+  DCHECK_EQ(GENERIC, predicate.kind);
+  if (num_rows == 0)
+    return;
+
+  // The message index may rule out most of the block up front.
+  const TrigramIndex* index = store != NULL ? store->message_index() : NULL;
+  bool has_candidates = false;
+  if (index != NULL && !predicate.index_literal.empty()) {
+    has_candidates = index->GetCandidateRows(predicate.index_literal,
+                                             block_rows_[0],
+                                             block_rows_[num_rows - 1] + 1,
+                                             &index_rows_);
+  }
+
+  // Rows with the same trace match alike, and runs of them are common, so
+  // stack predicates carry the outcome over from row to row while the
+  // trace stays the same.
+  bool is_stack = predicate.filter.column() == Filter::STACK;
+  const StackTracePool::StackId* stack_ids =
+      store != NULL ? store->stack_ids() : NULL;
+  int first_row = store != NULL ? store->first_row() : 0;
+  StackTracePool::StackId last_stack = StackTracePool::kUnknownStack;
+  bool last_matches = false;
+
+  // An inclusion only needs testing on rows that aren't yet included
+  // or excluded, an exclusion only on rows that are included.
+  uint8* state = &block_state_[0];
+  uint8 pending_state = predicate.match_state == ROW_INCLUDED ?
+      0 : ROW_INCLUDED;
+  size_t next_candidate = 0;
+  for (int j = 0; j < num_rows; ++j) {
+    if (state[j] != pending_state)
+      continue;
+
+    int row = block_rows_[j];
+    if (has_candidates) {
+      // Both the block rows and the candidates are in ascending order.
+      while (next_candidate < index_rows_.size() &&
+             index_rows_[next_candidate] < row) {
+        ++next_candidate;
+      }
+      if (next_candidate == index_rows_.size() ||
+          index_rows_[next_candidate] != row) {
+        continue;
+      }
+    }
+
+    bool matches = false;
+    if (is_stack) {
+      StackTracePool::StackId stack = stack_ids != NULL ?
+          stack_ids[row - first_row] : view->GetStackTraceId(row);
+      if (stack == StackTracePool::kUnknownStack || stack != last_stack) {
+        last_matches = MatchesRow(predicate, view, store, row);
+        last_stack = stack;
+      }
+      matches = last_matches;
+    } else {
+      matches = MatchesRow(predicate, view, store, row);
+    }
+    if (matches)
+      state[j] |= predicate.match_state;
+  }
+}
+
+void FilterProgram::RunFileLiterals(ILogView* view,
+                                    const LogStore* store,
+                                    int num_rows) {
+  if (file_literals_.num_literals() == 0)
+    return;
+
+  const StringTable::Atom* atoms = store != NULL ? store->file_atoms() : NULL;
+  int first_row = store != NULL ? store->first_row() : 0;
+  uint8* state = &block_state_[0];
+  for (int i = 0; i < num_rows; ++i) {
+    int row = block_rows_[i];
+    size_t atom = atoms != NULL ?
+        atoms[row - first_row] : view->GetFileAtom(row);
+    if (atom >= file_literal_matches_.size())
+      file_literal_matches_.resize(atom + 1, 0);
+
+    uint8& matches = file_literal_matches_[atom];
+    if (matches == 0) {
+      // File names are matched once, so there's no stopping early.
+      std::string buffer;
+      base::StringPiece file(store != NULL ?
+          base::StringPiece(store->GetFileName(row)) :
+          view->GetFileNamePiece(row, &buffer));
+      matches = file_literals_.Match(file, 0) | kKeyKnown;
+    }
+
+    state[i] |= matches & ~kKeyKnown;
+  }
+}
+
+void FilterProgram::RunMessageLiterals(ILogView* view,
+                                       const LogStore* store,
+                                       int num_rows) {
+  if (message_literals_.num_literals() == 0)
+    return;
+
+  bool has_exclusions = (message_literals_.flags() & ROW_EXCLUDED) != 0;
+  uint8* state = &block_state_[0];
+  std::string buffer;
+  for (int i = 0; i < num_rows; ++i) {
+    // Excluded rows are done, and included rows only stand to be excluded.
+    if ((state[i] & ROW_EXCLUDED) != 0 ||
+        (state[i] == ROW_INCLUDED && !has_exclusions)) {
+      continue;
+    }
+
+    int row = block_rows_[i];
+    if (store != NULL) {
+      state[i] |= message_literals_.Match(store->GetMessage(row, &buffer),
+                                          message_stop_state_);
+    } else {
+      state[i] |= message_literals_.Match(
+          view->GetMessagePiece(row, &buffer), message_stop_state_);
+    }
+  }
+}
+
+uint8 FilterProgram::GetSeverityState(ILogView* view, UCHAR level,
+                                      int row) {
+  uint8 state = 0;
+  for (size_t i = 0; i < predicates_.size(); ++i) {
+    Predicate& predicate = predicates_[i];
+    if (predicate.filter.column() != Filter::SEVERITY)
+      continue;
+
+    // Shares the cached outcome of RunKeyed.
+    std::vector<uint8>& key_matches = predicate.key_matches;
+    if (level >= key_matches.size())
+      key_matches.resize(level + 1, KEY_UNKNOWN);
+    if (key_matches[level] == KEY_UNKNOWN) {
+      key_matches[level] = predicate.filter.Matches(view, row) ?
+          KEY_MATCHES : KEY_DOES_NOT_MATCH;
+    }
+    if (key_matches[level] == KEY_MATCHES)
+      state |= predicate.match_state;
+  }
+  return state;
+}
+
+void FilterProgram::KeepLossMarkers(ILogView* view,
+                                    const LogStore* store,
+                                    int num_rows) {
+  uint8* state = &block_state_[0];
+  if (store != NULL) {
+    const StringTable::Atom* atoms = store->file_atoms();
+    StringTable::Atom marker = store->loss_marker_file();
+    int first_row = store->first_row();
+    for (int i = 0; i < num_rows; ++i) {
+      if (atoms[block_rows_[i] - first_row] == marker)
+        state[i] = ROW_INCLUDED;
+    }
+    return;
+  }
+
+  for (int i = 0; i < num_rows; ++i) {
+    if (view->IsLossMarker(block_rows_[i]))
+      state[i] = ROW_INCLUDED;
+  }
+}
+
+bool FilterProgram::MatchesRow(const Predicate& predicate,
+                               ILogView* view,
+                               const LogStore* store,
+                               int row) {
+  // Match messages in place, rather than copying them out of the view.
+  if (store != NULL && predicate.filter.column() == Filter::MESSAGE) {
+    std::string buffer;
+    return predicate.filter.ValueMatchesString(
+        store->GetMessage(row, &buffer));
+  }
+
+  return predicate.filter.Matches(view, row);
+}
@@ -0,0 +1,212 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Compiled filter program declaration.
+#ifndef SAWBUCK_VIEWER_FILTER_PROGRAM_H_
+#define SAWBUCK_VIEWER_FILTER_PROGRAM_H_
+
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "sawbuck/viewer/aho_corasick.h"
+#include "sawbuck/viewer/filter.h"
+
+class LogStore;
+
+// A set of inclusion and exclusion filters compiled to a program that
+// filters rows a block at a time. A row passes if it matches any of the
+// inclusion filters, or there are none, and matches none of the exclusion
+// filters.
+//
+// The filters are sorted by cost. Integer equality filters run first, as
+// tight loops over the columns of a block. Severity, file and process
+// filters are next, with the outcome cached per severity, file and process
+// instance, so each distinct value is only matched once. The block's rows
+// are joined to their process instances once for all process filters.
+// The remaining filters, i.e. the string matches, only run on the rows
+// left undecided by the cheap ones. Stack filters go last, as a new trace
+// needs its modules looked up, and rows take the outcome of the row before
+// them when they share its trace.
+//
+// Where several of the message or file filters are plain literal CONTAINS
+// filters, those are combined into a single Aho-Corasick automaton per
+// column, so each message or file name is scanned once for all of them.
+// @note this class is not thread safe, as it caches match state.
+class FilterProgram {
+ public:
+  FilterProgram(const std::vector<Filter>& inclusion,
+                const std::vector<Filter>& exclusion);
+  ~FilterProgram();
+
+  // The number of rows filtered at a time.
+  static const int kBlockRows = 256;
+
+  // Appends the rows of @p view that pass the filters to @p rows, in order.
+  // @param view the view to filter.
+  // @param store if non-NULL, the store backing @p view row for row, which
+  //    is then read directly.
+  // @param candidates if NULL, the rows [@p begin, @p end) are filtered,
+  //    otherwise the rows candidates[@p begin] to candidates[@p end - 1].
+  // @param rows receives the passing rows.
+  void Run(ILogView* view,
+           const LogStore* store,
+           const int* candidates,
+           int begin,
+           int end,
+           std::vector<int>* rows);
+
+  // Narrows the rows [@p begin, @p end) of @p store down to those that may
+  // pass, by way of its severity and process id posting lists, where the
+  // filters test those columns alone. The candidates still need running.
+  // @param view the view @p store backs row for row.
+  // @param rows on success receives the candidate rows in ascending order.
+  // @returns true on success, or false if the filters test other columns,
+  //     or the lists can't usefully narrow down the rows.
+  bool GetCandidateRows(ILogView* view,
+                        const LogStore& store,
+                        int begin,
+                        int end,
+                        std::vector<int>* rows);
+
+  // Sets whether the rows that mark lost data pass whatever the filters,
+  // so a filtered view still shows where it may be missing rows. This is
+  // off by default, @see ILogView::IsLossMarker.
+  void set_keep_loss_markers(bool keep_loss_markers) {
+    keep_loss_markers_ = keep_loss_markers;
+  }
+  bool keep_loss_markers() const { return keep_loss_markers_; }
+
+ private:
+  enum PredicateKind {
+    // Integer equality, on the process id, thread id, or line columns.
+    INT_EQUALS,
+    // Matches only depend on a small key, the severity, the file atom or
+    // the process instance.
+    KEYED,
+    // Everything else.
+    GENERIC,
+  };
+
+  // The per-row match state of a block.
+  enum RowState {
+    ROW_INCLUDED = 1 << 0,
+    ROW_EXCLUDED = 1 << 1,
+  };
+
+  struct Predicate {
+    explicit Predicate(const Filter& filter);
+
+    // Orders predicates for evaluation.
+    bool operator<(const Predicate& other) const;
+
+    Filter filter;
+    PredicateKind kind;
+    // Lower is cheaper, this orders the predicates of a kind.
+    int cost;
+    // The state bit a match sets.
+    uint8 match_state;
+    // The value to compare to, for INT_EQUALS.
+    int value;
+    // The cached outcome per key for KEYED.
+    std::vector<uint8> key_matches;
+    // For message predicates, a literal any match contains, or empty.
+    std::string index_literal;
+  };
+
+  // Filters the rows of a single block.
+  void RunBlock(ILogView* view,
+                const LogStore* store,
+                const int* candidates,
+                int first,
+                int num_rows,
+                std::vector<int>* rows);
+
+  // Evaluates an integer equality predicate over the block.
+  void RunIntEquals(const Predicate& predicate,
+                    ILogView* view,
+                    const LogStore* store,
+                    const int* candidates,
+                    int first,
+                    int num_rows);
+
+  // Evaluates a keyed predicate over the block.
+  void RunKeyed(Predicate* predicate,
+                ILogView* view,
+                const LogStore* store,
+                int num_rows);
+
+  // Joins the rows of the block to their process instances, to
+  // block_instances_, unless that's done already.
+  void JoinProcessInstances(ILogView* view,
+                            const LogStore* store,
+                            int num_rows);
+
+  // Evaluates a generic predicate over the block.
+  void RunGeneric(const Predicate& predicate,
+                  ILogView* view,
+                  const LogStore* store,
+                  int num_rows);
+
+  // Evaluates the combined literal file filters over the block.
+  void RunFileLiterals(ILogView* view, const LogStore* store, int num_rows);
+
+  // Evaluates the combined literal message filters over the block.
+  void RunMessageLiterals(ILogView* view, const LogStore* store,
+                          int num_rows);
+
+  // Matches @p predicate against @p row.
+  bool MatchesRow(const Predicate& predicate,
+                  ILogView* view,
+                  const LogStore* store,
+                  int row);
+
+  // @returns the match state of the severity predicates for rows of
+  // @p level, of which @p row is one.
+  uint8 GetSeverityState(ILogView* view, UCHAR level, int row);
+
+  // Includes the loss markers of the block, whatever their state.
+  void KeepLossMarkers(ILogView* view, const LogStore* store, int num_rows);
+
+  // Adds filters to predicates_, or to the literal automata.
+  void AddFilters(const std::vector<Filter>& filters,
+                  size_t num_file_literals,
+                  size_t num_message_literals);
+
+  // The predicates in order of evaluation.
+  std::vector<Predicate> predicates_;
+  bool has_inclusions_;
+  bool keep_loss_markers_;
+
+  // The combined literal filters, yielding the state bits of the filters
+  // found. File matches are cached per file atom, with kKeyKnown set once
+  // a file atom has been matched.
+  AhoCorasickMatcher file_literals_;
+  std::vector<uint8> file_literal_matches_;
+  AhoCorasickMatcher message_literals_;
+  // Searches stop when these bits are found.
+  uint8 message_stop_state_;
+
+  // Scratch space for the current block, the row numbers and their state.
+  std::vector<int> block_rows_;
+  std::vector<uint8> block_state_;
+  // The process instances of the block's rows, if has_block_instances_.
+  std::vector<ProcessInstanceIndex::InstanceId> block_instances_;
+  bool has_block_instances_;
+  // Scratch space for the message index candidates of a block.
+  std::vector<int> index_rows_;
+
+  DISALLOW_COPY_AND_ASSIGN(FilterProgram);
+};
+
+#endif  // SAWBUCK_VIEWER_FILTER_PROGRAM_H_
@@ -0,0 +1,433 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/filter_program.h"
+
+#include "base/strings/stringprintf.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/log_store.h"
+#include "sawbuck/viewer/mock_log_view_interfaces.h"
+#include "sawbuck/viewer/store_log_view.h"
+
+namespace {
+
+using testing::_;
+using testing::Invoke;
+using testing::StoreLogView;
+using testing::StrictMock;
+
+const UCHAR kLevels[] = {
+  TRACE_LEVEL_ERROR, TRACE_LEVEL_WARNING, TRACE_LEVEL_INFORMATION,
+};
+const char* kFiles[] = { "", "foo.cc", "bar.cc", "baz.h" };
+const char* kMessages[] = {
+  "Opening a file", "Closing the file", "Something failed", "",
+};
+
+class FilterProgramTest : public testing::Test {
+ public:
+  FilterProgramTest() : store_(&file_table_) {
+  }
+
+  virtual void SetUp() {
+    base::Time time(base::Time::Now());
+    for (int i = 0; i < kNumRows; ++i) {
+      store_.AddRow(kLevels[i % arraysize(kLevels)],
+                    10 + i % 7,
+                    100 + i % 5,
+                    time + base::TimeDelta::FromMilliseconds(i),
+                    file_table_.Intern(kFiles[i % arraysize(kFiles)]),
+                    i % 11,
+                    base::StringPrintf("%s #%d",
+                                       kMessages[i % arraysize(kMessages)],
+                                       i),
+                    0, NULL);
+    }
+  }
+
+  // Filters our rows the slow way.
+  std::vector<int> NaiveFilter(const std::vector<Filter>& inclusion,
+                               const std::vector<Filter>& exclusion,
+                               const std::vector<int>& candidates) {
+    StoreLogView view(&store_);
+    std::vector<int> rows;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      int row = candidates[i];
+      bool included = inclusion.empty();
+      for (size_t j = 0; j < inclusion.size(); ++j)
+        included = included || inclusion[j].Matches(&view, row);
+      for (size_t j = 0; j < exclusion.size(); ++j)
+        included = included && !exclusion[j].Matches(&view, row);
+      if (included)
+        rows.push_back(row);
+    }
+    return rows;
+  }
+
+  // Checks that a program over @p filters agrees with the slow way, with
+  // and without access to the store, and over all rows retained or a
+  // subset.
+  void ExpectMatchesNaive(const std::vector<Filter>& filters) {
+    std::vector<Filter> inclusion;
+    std::vector<Filter> exclusion;
+    for (size_t i = 0; i < filters.size(); ++i) {
+      if (filters[i].action() == Filter::INCLUDE)
+        inclusion.push_back(filters[i]);
+      else
+        exclusion.push_back(filters[i]);
+    }
+
+    std::vector<int> all_rows;
+    std::vector<int> some_rows;
+    int first_row = store_.first_row();
+    for (int i = first_row; i < kNumRows; ++i) {
+      all_rows.push_back(i);
+      if (i % 3 != 0)
+        some_rows.push_back(i);
+    }
+
+    std::vector<int> expected_all(NaiveFilter(inclusion, exclusion, all_rows));
+    std::vector<int> expected_some(
+        NaiveFilter(inclusion, exclusion, some_rows));
+
+    StoreLogView store_view(&store_);
+    // Hiding the store exercises the view accessor paths.
+    StoreLogView storeless_view(&store_);
+    storeless_view.set_hide_store(true);
+    ILogView* views[] = { &store_view, &storeless_view };
+    for (size_t i = 0; i < arraysize(views); ++i) {
+      FilterProgram program(inclusion, exclusion);
+      const LogStore* store = views[i]->GetLogStore();
+
+      std::vector<int> rows;
+      program.Run(views[i], store, NULL, first_row, kNumRows, &rows);
+      EXPECT_EQ(expected_all, rows);
+
+      rows.clear();
+      program.Run(views[i], store, &some_rows[0], 0, some_rows.size(),
+                  &rows);
+      EXPECT_EQ(expected_some, rows);
+
+      // Running in pieces comes out the same.
+      rows.clear();
+      program.Run(views[i], store, NULL, first_row, 1000, &rows);
+      program.Run(views[i], store, NULL, 1000, kNumRows, &rows);
+      EXPECT_EQ(expected_all, rows);
+    }
+  }
+
+  // Checks that running a program over @p filters on the candidates from
+  // the posting lists agrees with running it on all rows retained.
+  void ExpectCandidatesMatchRun(const std::vector<Filter>& filters) {
+    std::vector<Filter> inclusion;
+    std::vector<Filter> exclusion;
+    for (size_t i = 0; i < filters.size(); ++i) {
+      if (filters[i].action() == Filter::INCLUDE)
+        inclusion.push_back(filters[i]);
+      else
+        exclusion.push_back(filters[i]);
+    }
+
+    StoreLogView view(&store_);
+    FilterProgram program(inclusion, exclusion);
+    program.set_keep_loss_markers(true);
+    std::vector<int> expected;
+    program.Run(&view, &store_, NULL, store_.first_row(), store_.num_rows(),
+                &expected);
+
+    FilterProgram candidate_program(inclusion, exclusion);
+    candidate_program.set_keep_loss_markers(true);
+    std::vector<int> candidates;
+    ASSERT_TRUE(candidate_program.GetCandidateRows(&view, store_, 0,
+                                                   store_.num_rows(),
+                                                   &candidates));
+    ASSERT_FALSE(candidates.empty());
+    EXPECT_LE(store_.first_row(), candidates.front());
+    EXPECT_GT(static_cast<size_t>(store_.num_rows() - store_.first_row()),
+              candidates.size());
+
+    std::vector<int> rows;
+    candidate_program.Run(&view, &store_, &candidates[0], 0,
+                          candidates.size(), &rows);
+    EXPECT_EQ(expected, rows);
+  }
+
+ protected:
+  static const int kNumRows = 2345;
+
+  StringTable file_table_;
+  LogStore store_;
+};
+
+TEST_F(FilterProgramTest, NoFilters) {
+  ExpectMatchesNaive(std::vector<Filter>());
+}
+
+TEST_F(FilterProgramTest, IntegerFilters) {
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::PROCESS_ID, Filter::IS, Filter::INCLUDE,
+                           L"12"));
+  ExpectMatchesNaive(filters);
+
+  filters.push_back(Filter(Filter::THREAD_ID, Filter::IS, Filter::EXCLUDE,
+                           L"101"));
+  ExpectMatchesNaive(filters);
+
+  filters.push_back(Filter(Filter::LINE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"1"));
+  ExpectMatchesNaive(filters);
+
+  // Bad values compare as parsed.
+  filters.push_back(Filter(Filter::LINE, Filter::IS, Filter::EXCLUDE,
+                           L"bogus"));
+  ExpectMatchesNaive(filters);
+}
+
+TEST_F(FilterProgramTest, EvictedRows) {
+  // The columns of a store that evicted rows start at its first row.
+  LogStore::Retention retention;
+  retention.max_rows = 2000;
+  store_.set_retention(retention);
+  ASSERT_LT(0, store_.first_row());
+  ASSERT_GT(1000, store_.first_row());
+
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::PROCESS_ID, Filter::IS, Filter::INCLUDE,
+                           L"12"));
+  filters.push_back(Filter(Filter::SEVERITY, Filter::IS, Filter::EXCLUDE,
+                           L"2"));
+  filters.push_back(Filter(Filter::FILE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"foo"));
+  ExpectMatchesNaive(filters);
+}
+
+TEST_F(FilterProgramTest, KeyedFilters) {
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::FILE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"\\.cc$"));
+  ExpectMatchesNaive(filters);
+
+  filters.push_back(Filter(Filter::SEVERITY, Filter::IS, Filter::EXCLUDE,
+                           L"ERROR"));
+  ExpectMatchesNaive(filters);
+
+  filters.push_back(Filter(Filter::FILE, Filter::IS, Filter::EXCLUDE,
+                           L"foo\\.cc"));
+  ExpectMatchesNaive(filters);
+}
+
+TEST_F(FilterProgramTest, MixedFilters) {
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"file"));
+  filters.push_back(Filter(Filter::PROCESS_ID, Filter::IS, Filter::INCLUDE,
+                           L"16"));
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::EXCLUDE,
+                           L"#1\\d*$"));
+  filters.push_back(Filter(Filter::FILE, Filter::CONTAINS, Filter::EXCLUDE,
+                           L"baz"));
+  filters.push_back(Filter(Filter::TIME, Filter::CONTAINS, Filter::EXCLUDE,
+                           L"7"));
+  ExpectMatchesNaive(filters);
+}
+
+TEST_F(FilterProgramTest, CombinedLiteralFilters) {
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"OPENING"));
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"failed"));
+  ExpectMatchesNaive(filters);
+
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::EXCLUDE,
+                           L"#12"));
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::EXCLUDE,
+                           L"g a f"));
+  ExpectMatchesNaive(filters);
+
+  // Literal file filters, next to a regular expression that isn't combined.
+  filters.push_back(Filter(Filter::FILE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"foo\\."));
+  filters.push_back(Filter(Filter::FILE, Filter::CONTAINS, Filter::EXCLUDE,
+                           L"\\.H"));
+  filters.push_back(Filter(Filter::FILE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"^ba"));
+  ExpectMatchesNaive(filters);
+
+  // Overlapping literals.
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::EXCLUDE,
+                           L"ing the"));
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"sing"));
+  ExpectMatchesNaive(filters);
+}
+
+TEST_F(FilterProgramTest, IndexedMessageFilters) {
+  store_.EnableMessageIndex();
+
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"Closing.*#1\\d"));
+  ExpectMatchesNaive(filters);
+
+  filters.push_back(Filter(Filter::MESSAGE, Filter::IS, Filter::INCLUDE,
+                           L"something failed #2\\d*"));
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::EXCLUDE,
+                           L"#123"));
+  ExpectMatchesNaive(filters);
+
+  // Too short for the index.
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"#7"));
+  ExpectMatchesNaive(filters);
+}
+
+int GetMockProcessId(int row) {
+  return row % 4;
+}
+
+TEST_F(FilterProgramTest, KeepLossMarkers) {
+  LogEvents::EventLoss loss;
+  loss.time = store_.GetTime(kNumRows - 1);
+  int marker = store_.AddLossMarker(loss);
+
+  // The markers are warnings from no process, with no file.
+  std::vector<Filter> inclusion;
+  std::vector<Filter> exclusion;
+  inclusion.push_back(Filter(Filter::PROCESS_ID, Filter::IS,
+                             Filter::INCLUDE, L"12"));
+  exclusion.push_back(Filter(Filter::SEVERITY, Filter::IS,
+                             Filter::EXCLUDE, L"WARNING"));
+
+  StoreLogView store_view(&store_);
+  StoreLogView storeless_view(&store_);
+  storeless_view.set_hide_store(true);
+  ILogView* views[] = { &store_view, &storeless_view };
+  for (size_t i = 0; i < arraysize(views); ++i) {
+    FilterProgram program(inclusion, exclusion);
+    const LogStore* store = views[i]->GetLogStore();
+
+    std::vector<int> rows;
+    program.Run(views[i], store, NULL, 0, marker + 1, &rows);
+    ASSERT_FALSE(rows.empty());
+    EXPECT_NE(marker, rows.back());
+
+    program.set_keep_loss_markers(true);
+    std::vector<int> kept_rows;
+    program.Run(views[i], store, NULL, 0, marker + 1, &kept_rows);
+    rows.push_back(marker);
+    EXPECT_EQ(rows, kept_rows);
+  }
+}
+
+TEST_F(FilterProgramTest, CandidatesFromPostings) {
+  LogEvents::EventLoss loss;
+  loss.time = store_.GetTime(kNumRows - 1);
+  store_.AddLossMarker(loss);
+
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::SEVERITY, Filter::IS, Filter::INCLUDE,
+                           L"ERROR"));
+  ExpectCandidatesMatchRun(filters);
+
+  filters.push_back(Filter(Filter::PROCESS_ID, Filter::IS, Filter::INCLUDE,
+                           L"12"));
+  filters.push_back(Filter(Filter::SEVERITY, Filter::IS, Filter::EXCLUDE,
+                           L"WARNING"));
+  filters.push_back(Filter(Filter::PROCESS_ID, Filter::IS, Filter::EXCLUDE,
+                           L"13"));
+  ExpectCandidatesMatchRun(filters);
+
+  // Exclusions alone narrow the rows down by severity.
+  filters.clear();
+  filters.push_back(Filter(Filter::SEVERITY, Filter::IS, Filter::EXCLUDE,
+                           L"ERROR"));
+  filters.push_back(Filter(Filter::SEVERITY, Filter::IS, Filter::EXCLUDE,
+                           L"WARNING"));
+  filters.push_back(Filter(Filter::PROCESS_ID, Filter::IS, Filter::EXCLUDE,
+                           L"11"));
+  ExpectCandidatesMatchRun(filters);
+
+  // As they do on an evicted store.
+  LogStore::Retention retention;
+  retention.max_rows = 2000;
+  store_.set_retention(retention);
+  ASSERT_LT(0, store_.first_row());
+  ExpectCandidatesMatchRun(filters);
+}
+
+TEST_F(FilterProgramTest, NoCandidatesFromPostings) {
+  StoreLogView view(&store_);
+  std::vector<int> rows;
+
+  // No filters, and filters on other columns, don't narrow the rows down.
+  std::vector<Filter> inclusion;
+  std::vector<Filter> exclusion;
+  FilterProgram empty_program(inclusion, exclusion);
+  EXPECT_FALSE(empty_program.GetCandidateRows(&view, store_, 0, kNumRows,
+                                              &rows));
+
+  inclusion.push_back(Filter(Filter::SEVERITY, Filter::IS, Filter::INCLUDE,
+                             L"ERROR"));
+  inclusion.push_back(Filter(Filter::FILE, Filter::CONTAINS, Filter::INCLUDE,
+                             L"foo"));
+  FilterProgram file_program(inclusion, exclusion);
+  EXPECT_FALSE(file_program.GetCandidateRows(&view, store_, 0, kNumRows,
+                                             &rows));
+
+  inclusion.pop_back();
+  inclusion.push_back(Filter(Filter::PROCESS_ID, Filter::CONTAINS,
+                             Filter::INCLUDE, L"1"));
+  FilterProgram contains_program(inclusion, exclusion);
+  EXPECT_FALSE(contains_program.GetCandidateRows(&view, store_, 0, kNumRows,
+                                                 &rows));
+
+  // Nor do filters that pass most rows.
+  inclusion.clear();
+  exclusion.push_back(Filter(Filter::SEVERITY, Filter::IS, Filter::EXCLUDE,
+                             L"ERROR"));
+  FilterProgram broad_program(inclusion, exclusion);
+  EXPECT_FALSE(broad_program.GetCandidateRows(&view, store_, 0, kNumRows,
+                                              &rows));
+}
+
+TEST_F(FilterProgramTest, StringFiltersRunOnUndecidedRows) {
+  StrictMock<testing::MockILogView> view;
+  EXPECT_CALL(view, GetProcessId(_))
+      .WillRepeatedly(Invoke(GetMockProcessId));
+
+  // A quarter of the rows are excluded by process id, and only the rest
+  // have their message fetched.
+  const int kRows = 1000;
+  EXPECT_CALL(view, GetMessage(_))
+      .Times(kRows - kRows / 4)
+      .WillRepeatedly(testing::Return("message"));
+
+  std::vector<Filter> inclusion;
+  std::vector<Filter> exclusion;
+  inclusion.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS,
+                             Filter::INCLUDE, L"mess"));
+  exclusion.push_back(Filter(Filter::PROCESS_ID, Filter::IS,
+                             Filter::EXCLUDE, L"2"));
+
+  FilterProgram program(inclusion, exclusion);
+  std::vector<int> rows;
+  program.Run(&view, NULL, NULL, 0, kRows, &rows);
+
+  ASSERT_EQ(kRows - kRows / 4, rows.size());
+  for (size_t i = 0; i < rows.size(); ++i)
+    EXPECT_NE(2, rows[i] % 4);
+}
+
+}  // namespace
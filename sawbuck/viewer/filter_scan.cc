@@ -0,0 +1,262 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Shared filter scan implementation.
+#include "sawbuck/viewer/filter_scan.h"
+
+#include <algorithm>
+#include <utility>
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/message_loop/message_loop.h"
+#include "sawbuck/common/perf_counters.h"
+#include "sawbuck/common/task_pool.h"
+#include "sawbuck/log_lib/sawbuck_trace_provider.h"
+#include "sawbuck/viewer/log_list_view.h"
+
+namespace {
+
+PerfCounter scan_chunk_counter("FilterScan.Chunk", 1);
+PerfCounter scan_range_counter("FilterScan.Range", 1);
+
+// No more threads than this filter a chunk.
+const size_t kMaxScanThreads = 8;
+// A chunk holds at most this many rows per filtering thread.
+const int kMaxRowsPerThread = 1000;
+// A row costs a run of every client's filter program, which may match
+// its message, so even a few hundred rows keep a thread busy past the
+// posting cost.
+const int kMinRowsPerThread = 250;
+
+}  // namespace
+
+const int FilterScan::Client::kNotScanning;
+
+// The filters of a client, and its part in the current round.
+struct FilterScan::ClientState {
+  ClientState(Client* client,
+              const std::vector<Filter>& inclusion,
+              const std::vector<Filter>& exclusion)
+      : client(client), inclusion(inclusion), exclusion(exclusion),
+        begin(0) {
+  }
+
+  // Makes sure there's a program and a match list for each of
+  // @p num_threads threads.
+  void PrepareThreads(size_t num_threads) {
+    while (programs.size() < num_threads) {
+      programs.push_back(new FilterProgram(inclusion, exclusion));
+      programs.back()->set_keep_loss_markers(true);
+    }
+    if (matches.size() < num_threads)
+      matches.resize(num_threads);
+    for (size_t i = 0; i < num_threads; ++i)
+      matches[i].clear();
+  }
+
+  Client* client;
+  std::vector<Filter> inclusion;
+  std::vector<Filter> exclusion;
+
+  // One program per thread, as programs cache match state.
+  ScopedVector<FilterProgram> programs;
+
+  // The client's first row in the current round, and the rows each thread
+  // found for it.
+  int begin;
+  std::vector<std::vector<int> > matches;
+};
+
+FilterScan::FilterScan(ILogView* original)
+    : original_(original),
+      max_scan_threads_(std::min(TaskPool::Get()->num_workers() + 1,
+                                 kMaxScanThreads)) {
+  DCHECK(original_ != NULL);
+}
+
+FilterScan::~FilterScan() {
+  DCHECK(clients_.empty());
+
+  // Make sure we're not pinged post-destruction.
+  if (!task_.IsCancelled())
+    task_.Cancel();
+}
+
+void FilterScan::AddClient(Client* client,
+                           const std::vector<Filter>& inclusion,
+                           const std::vector<Filter>& exclusion) {
+  DCHECK(client != NULL);
+  DCHECK(FindClient(client) == NULL);
+  clients_.push_back(new ClientState(client, inclusion, exclusion));
+  PostScanTask();
+}
+
+void FilterScan::SetFilters(Client* client,
+                            const std::vector<Filter>& inclusion,
+                            const std::vector<Filter>& exclusion) {
+  ClientState* state = FindClient(client);
+  DCHECK(state != NULL);
+  state->inclusion = inclusion;
+  state->exclusion = exclusion;
+  state->programs.clear();
+}
+
+void FilterScan::RemoveClient(Client* client) {
+  ScopedVector<ClientState>::iterator it(clients_.begin());
+  for (; it != clients_.end(); ++it) {
+    if ((*it)->client == client) {
+      clients_.erase(it);
+      return;
+    }
+  }
+  NOTREACHED() << "Removing a client that wasn't added.";
+}
+
+void FilterScan::PostScanTask() {
+  if (task_.IsCancelled()) {
+    task_.Reset(base::Bind(&FilterScan::ScanChunk, base::Unretained(this)));
+    base::MessageLoop::current()->PostTask(FROM_HERE, task_.callback());
+  }
+}
+
+void FilterScan::ScanRange(ILogView* view,
+                           const LogStore* store,
+                           const std::vector<ClientState*>& clients,
+                           size_t thread,
+                           int begin,
+                           int end) {
+  for (int first = begin; first < end; first += FilterProgram::kBlockRows) {
+    int block_end = std::min(first + FilterProgram::kBlockRows, end);
+    for (size_t i = 0; i < clients.size(); ++i) {
+      ClientState* state = clients[i];
+      int from = std::max(first, state->begin);
+      if (from < block_end) {
+        state->programs[thread]->Run(view, store, NULL, from, block_end,
+                                     &state->matches[thread]);
+      }
+    }
+  }
+}
+
+void FilterScan::ScanRangeTask(ILogView* view,
+                               const LogStore* store,
+                               const std::vector<ClientState*>* clients,
+                               size_t thread,
+                               int begin,
+                               int end) {
+  ScanRange(view, store, *clients, thread, begin, end);
+}
+
+FilterScan::ClientState* FilterScan::FindClient(Client* client) {
+  for (size_t i = 0; i < clients_.size(); ++i) {
+    if (clients_[i]->client == client)
+      return clients_[i];
+  }
+  return NULL;
+}
+
+void FilterScan::ScanChunk() {
+  ScopedPerfTimer timer(&scan_chunk_counter);
+  ScopedSawbuckTraceEvent trace("FilterScan::ScanChunk", this);
+  task_.Cancel();
+
+  // Group the clients with rows to filter by their next row. The clients
+  // that have caught up share a group, and those catching up, e.g. new
+  // views, go in groups of their own until they catch up, so as not to
+  // hold up the others.
+  int num_rows = original_->GetNumRows();
+  std::vector<std::pair<int, ClientState*> > active;
+  for (size_t i = 0; i < clients_.size(); ++i) {
+    ClientState* state = clients_[i];
+    int row = state->client->GetScanRow();
+    if (row == Client::kNotScanning || row >= num_rows)
+      continue;
+
+    state->begin = std::max(row, original_->GetFirstRow());
+    active.push_back(std::make_pair(state->begin, state));
+  }
+  if (active.empty())
+    return;
+  std::sort(active.begin(), active.end());
+
+  // Filter a chunk for each group, then hand out each client's rows in
+  // order, as the clients may change the scan as they take them.
+  std::vector<std::pair<Client*, std::vector<int> > > results;
+  std::vector<int> ends;
+  std::vector<ClientState*> group;
+  for (size_t i = 0; i < active.size(); ++i) {
+    group.push_back(active[i].second);
+    if (i + 1 < active.size() && active[i + 1].first == active[i].first)
+      continue;
+
+    int end = ScanGroup(group, active[i].first, num_rows);
+    for (size_t j = 0; j < group.size(); ++j) {
+      ClientState* state = group[j];
+      results.push_back(std::make_pair(state->client, std::vector<int>()));
+      std::vector<int>& rows = results.back().second;
+      for (size_t thread = 0; thread < state->matches.size(); ++thread) {
+        rows.insert(rows.end(), state->matches[thread].begin(),
+                    state->matches[thread].end());
+      }
+      ends.push_back(end);
+    }
+    group.clear();
+  }
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (FindClient(results[i].first) != NULL)
+      results[i].first->OnRowsScanned(ends[i], results[i].second);
+  }
+
+  // Post again if anyone's not done.
+  for (size_t i = 0; i < clients_.size(); ++i) {
+    int row = clients_[i]->client->GetScanRow();
+    if (row != Client::kNotScanning && row < num_rows) {
+      PostScanTask();
+      break;
+    }
+  }
+}
+
+int FilterScan::ScanGroup(const std::vector<ClientState*>& clients,
+                          int start,
+                          int num_rows) {
+  // Figure the range we're going to filter, and how many threads to
+  // spread it over.
+  int num_threads = std::max(1, std::min(
+      static_cast<int>(max_scan_threads_),
+      (num_rows - start) / kMinRowsPerThread));
+  int end = std::min(start + num_threads * kMaxRowsPerThread, num_rows);
+
+  for (size_t i = 0; i < clients.size(); ++i)
+    clients[i]->PrepareThreads(num_threads);
+
+  // Hand the trailing ranges to the task pool, then filter the first
+  // range ourselves, and any the pool hasn't got to by then.
+  const LogStore* store = original_->GetLogStore();
+  int range = (end - start + num_threads - 1) / num_threads;
+  TaskPool::TaskGroup group(TaskPool::Get(), TaskPool::PRIORITY_VISIBLE,
+                            &scan_range_counter);
+  for (int i = 1; i < num_threads; ++i) {
+    group.Post(base::Bind(&FilterScan::ScanRangeTask, original_, store,
+                          &clients, i, std::min(start + i * range, end),
+                          std::min(start + (i + 1) * range, end)));
+  }
+
+  ScanRange(original_, store, clients, 0, start,
+            std::min(start + range, end));
+  group.Wait();
+
+  return end;
+}
@@ -0,0 +1,125 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Shared filter scan declaration.
+#ifndef SAWBUCK_VIEWER_FILTER_SCAN_H_
+#define SAWBUCK_VIEWER_FILTER_SCAN_H_
+
+#include <vector>
+
+#include "base/cancelable_callback.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "sawbuck/viewer/filter.h"
+#include "sawbuck/viewer/filter_program.h"
+
+class ILogView;
+
+// Filters the new rows of a log for several filtered views at once, so
+// that N views over a log cost about as much as one. Each round filters a
+// chunk of rows, one round per task posted to the current message loop,
+// and the chunk is split into row ranges that are filtered on the shared
+// task pool. Each thread takes its range a
+// block of rows at a time, and runs the filters of every view over the
+// block before moving on, while the block's rows are at hand.
+// Views that have fallen behind, e.g. new views, catch up from their own
+// row, taking the same chunks as the others once they've caught up.
+// @note the scan must outlive its clients, and the original view is read
+//    concurrently from the worker threads, only while a chunk is being
+//    filtered. See FilteredLogView.
+class FilterScan {
+ public:
+  // A view the scan filters rows for.
+  class Client {
+   public:
+    // Signals that the client takes no rows for now.
+    static const int kNotScanning = -1;
+
+    // @returns the next row of the original to filter for the client, or
+    //     kNotScanning.
+    virtual int GetScanRow() = 0;
+
+    // Called with the rows past GetScanRow() that passed the client's
+    // filters, in order. The next row to filter is @p end.
+    virtual void OnRowsScanned(int end, const std::vector<int>& rows) = 0;
+
+   protected:
+    virtual ~Client() {}
+  };
+
+  explicit FilterScan(ILogView* original);
+  ~FilterScan();
+
+  // Adds @p client, filtering by @p inclusion and @p exclusion filters.
+  void AddClient(Client* client,
+                 const std::vector<Filter>& inclusion,
+                 const std::vector<Filter>& exclusion);
+  // Changes the filters of @p client.
+  void SetFilters(Client* client,
+                  const std::vector<Filter>& inclusion,
+                  const std::vector<Filter>& exclusion);
+  void RemoveClient(Client* client);
+
+  // Schedules a round for the clients that have rows to filter.
+  void PostScanTask();
+
+  ILogView* original() const { return original_; }
+
+ protected:
+  struct ClientState;
+
+  // Filters the rows [@p begin, @p end) for @p clients, each from its
+  // begin row on, with the programs the clients have for @p thread.
+  static void ScanRange(ILogView* view,
+                        const LogStore* store,
+                        const std::vector<ClientState*>& clients,
+                        size_t thread,
+                        int begin,
+                        int end);
+  // As above, as a task of the pool.
+  static void ScanRangeTask(ILogView* view,
+                            const LogStore* store,
+                            const std::vector<ClientState*>* clients,
+                            size_t thread,
+                            int begin,
+                            int end);
+
+  // Returns the state of @p client, or NULL.
+  ClientState* FindClient(Client* client);
+
+  void ScanChunk();
+  // Filters a chunk of rows from @p start for @p clients, which are all
+  // at @p start, into their match lists.
+  // @returns the end of the chunk.
+  int ScanGroup(const std::vector<ClientState*>& clients,
+                int start,
+                int num_rows);
+
+  ILogView* original_;
+
+  ScopedVector<ClientState> clients_;
+
+  // The maximum number of threads filtering a chunk, including our own.
+  // Defaults to the number of pool workers and our own thread.
+  size_t max_scan_threads_;
+
+  typedef base::CancelableCallback<void()> ScanCallback;
+
+  // Non-cancelled while a round is pending.
+  ScanCallback task_;
+
+  DISALLOW_COPY_AND_ASSIGN(FilterScan);
+};
+
+#endif  // SAWBUCK_VIEWER_FILTER_SCAN_H_
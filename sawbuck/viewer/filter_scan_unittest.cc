@@ -0,0 +1,98 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "sawbuck/viewer/filter_scan.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/filtered_log_view.h"
+#include "sawbuck/viewer/test_log_view.h"
+
+namespace {
+
+using testing::StrictMock;
+
+std::vector<Filter> ProcessFilters(const wchar_t* pid) {
+  std::vector<Filter> filters;
+  filters.push_back(
+      Filter(Filter::PROCESS_ID, Filter::IS, Filter::INCLUDE, pid));
+  return filters;
+}
+
+class FilterScanTest : public testing::TestLogViewTest {
+ public:
+  // Checks that @p view holds every row of process @p pid.
+  void ExpectProcessRows(ILogView* view, int pid) {
+    int num_rows = original_.GetNumRows();
+    ASSERT_EQ((num_rows + 2 - pid) / 3, view->GetNumRows());
+    for (int row = 0; row < view->GetNumRows(); ++row)
+      ASSERT_EQ(pid + 3 * row, view->GetLine(row));
+  }
+};
+
+}  // namespace
+
+TEST_F(FilterScanTest, FiltersForAllViews) {
+  original_.AddRows(10000);
+
+  FilterScan scan(&original_);
+  FilteredLogView first(&scan, ProcessFilters(L"1"));
+  FilteredLogView second(&scan, ProcessFilters(L"2"));
+  RunMessageLoopToIdle();
+
+  ExpectProcessRows(&first, 1);
+  ExpectProcessRows(&second, 2);
+
+  // New rows go to both.
+  original_.AddRows(5000);
+  original_.NotifyNewItems();
+  scan.PostScanTask();
+  RunMessageLoopToIdle();
+
+  ExpectProcessRows(&first, 1);
+  ExpectProcessRows(&second, 2);
+}
+
+TEST_F(FilterScanTest, NewViewCatchesUp) {
+  FilterScan scan(&original_);
+  FilteredLogView first(&scan, ProcessFilters(L"0"));
+  original_.AddRows(5000);
+  original_.NotifyNewItems();
+  RunMessageLoopToIdle();
+  ExpectProcessRows(&first, 0);
+
+  // The new view starts from the first row, alongside the caught up view.
+  FilteredLogView second(&scan, ProcessFilters(L"1"));
+  original_.AddRows(5000);
+  original_.NotifyNewItems();
+  RunMessageLoopToIdle();
+
+  ExpectProcessRows(&first, 0);
+  ExpectProcessRows(&second, 1);
+}
+
+TEST_F(FilterScanTest, ChangingFilters) {
+  original_.AddRows(3000);
+
+  FilterScan scan(&original_);
+  FilteredLogView first(&scan, ProcessFilters(L"1"));
+  FilteredLogView second(&scan, ProcessFilters(L"2"));
+  RunMessageLoopToIdle();
+
+  second.SetFilters(ProcessFilters(L"0"));
+  RunMessageLoopToIdle();
+
+  ExpectProcessRows(&first, 1);
+  ExpectProcessRows(&second, 0);
+}
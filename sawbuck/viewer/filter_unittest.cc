@@ -103,6 +103,28 @@ TEST_F(FilterTest, TestPIDMatching) {
   }
 }
 
+TEST_F(FilterTest, TestFileMatching) {
+  const int kNumRows = 4;
+  const StringTable::Atom kFooAtom = 1;
+  const StringTable::Atom kBarAtom = 2;
+  EXPECT_CALL(mock_view_, GetFileAtom(0)).WillRepeatedly(Return(kFooAtom));
+  EXPECT_CALL(mock_view_, GetFileAtom(1)).WillRepeatedly(Return(kBarAtom));
+  EXPECT_CALL(mock_view_, GetFileAtom(2)).WillRepeatedly(Return(kFooAtom));
+  EXPECT_CALL(mock_view_, GetFileAtom(3)).WillRepeatedly(Return(kBarAtom));
+
+  // The file names should be fetched once per distinct atom.
+  EXPECT_CALL(mock_view_, GetFileName(0)).WillOnce(Return("foo.cc"));
+  EXPECT_CALL(mock_view_, GetFileName(1)).WillOnce(Return("bar.cc"));
+
+  Filter include_is(Filter::FILE, Filter::IS, Filter::INCLUDE, L"foo.cc");
+  for (int i = 0; i < kNumRows; i++) {
+    if (i % 2 == 0)
+      EXPECT_TRUE(include_is.Matches(&mock_view_, i));
+    else
+      EXPECT_FALSE(include_is.Matches(&mock_view_, i));
+  }
+}
+
 TEST_F(FilterTest, TestTimeMatching) {
   // TODO(siggi): Test time filtering.
 }
@@ -15,17 +15,90 @@
 // Filtered list view implementation.
 #include "sawbuck/viewer/filtered_log_view.h"
 
+#include <algorithm>
 #include "base/bind.h"
 #include "base/logging.h"
 #include "pcrecpp.h"  // NOLINT
+#include "sawbuck/common/perf_counters.h"
+#include "sawbuck/common/task_pool.h"
+#include "sawbuck/log_lib/sawbuck_trace_provider.h"
+
+namespace {
+
+PerfCounter filter_chunk_counter("Filter.Chunk", 1);
+PerfCounter filter_range_counter("Filter.Range", 1);
+
+// No more threads than this filter a chunk.
+const size_t kMaxFilterThreads = 8;
+// A chunk holds at most this many rows per filtering thread.
+const int kMaxRowsPerThread = 1000;
+// A row costs a run of the filter program, which may match its message,
+// so even a few hundred rows keep a thread busy past the posting cost.
+const int kMinRowsPerThread = 250;
+
+bool MatchesAny(const std::vector<Filter>& list, ILogView* view, int row) {
+  std::vector<Filter>::const_iterator iter(list.begin());
+  for (; iter != list.end(); ++iter) {
+    if (iter->Matches(view, row)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true iff every filter in |subset| is also in |set|.
+bool IsSubset(const std::vector<Filter>& subset,
+              const std::vector<Filter>& set) {
+  for (size_t i = 0; i < subset.size(); ++i) {
+    if (std::find(set.begin(), set.end(), subset[i]) == set.end())
+      return false;
+  }
+  return true;
+}
+
+// Returns the filters in |set| that aren't in |subtrahend|.
+std::vector<Filter> Difference(const std::vector<Filter>& set,
+                               const std::vector<Filter>& subtrahend) {
+  std::vector<Filter> difference;
+  for (size_t i = 0; i < set.size(); ++i) {
+    if (std::find(subtrahend.begin(), subtrahend.end(), set[i]) ==
+            subtrahend.end()) {
+      difference.push_back(set[i]);
+    }
+  }
+  return difference;
+}
+
+// Filters a range of rows on the task pool, see FilterProgram::Run.
+void FilterRange(FilterProgram* program, ILogView* view, const LogStore* store,
+                 const int* candidates, int begin, int end,
+                 std::vector<int>* rows) {
+  program->Run(view, store, candidates, begin, end, rows);
+}
+
+}  // namespace
 
 FilteredLogView::FilteredLogView(ILogView* original,
                                  const std::vector<Filter>& filters) :
-    filtered_rows_(0), original_(original),
-    registration_cookie_(0), next_sink_cookie_(1) {
-  DCHECK(original_ != NULL);
-  original_->Register(this, &registration_cookie_);
-  SetFilters(filters);
+    first_row_(0), flattens_rows_(false), filtered_rows_(0),
+    refined_rows_(0),
+    max_filter_threads_(std::min(TaskPool::Get()->num_workers() + 1,
+                                 kMaxFilterThreads)),
+    original_(original), registration_cookie_(0), scan_(NULL),
+    next_sink_cookie_(1) {
+  Initialize(filters);
+}
+
+FilteredLogView::FilteredLogView(FilterScan* scan,
+                                 const std::vector<Filter>& filters) :
+    first_row_(0), flattens_rows_(false), filtered_rows_(0),
+    refined_rows_(0),
+    max_filter_threads_(std::min(TaskPool::Get()->num_workers() + 1,
+                                 kMaxFilterThreads)),
+    original_(scan->original()), registration_cookie_(0), scan_(scan),
+    next_sink_cookie_(1) {
+  scan_->AddClient(this, inclusion_filters_, exclusion_filters_);
+  Initialize(filters);
 }
 
 FilteredLogView::~FilteredLogView() {
@@ -33,9 +106,22 @@ FilteredLogView::~FilteredLogView() {
   if (!task_.IsCancelled())
     task_.Cancel();
 
+  if (scan_ != NULL)
+    scan_->RemoveClient(this);
   original_->Unregister(registration_cookie_);
 }
 
+void FilteredLogView::Initialize(const std::vector<Filter>& filters) {
+  DCHECK(original_ != NULL);
+  original_->Register(this, &registration_cookie_);
+  filtered_rows_ = original_->GetFirstRow();
+  flattens_rows_ = original_->GetLogStore() == NULL &&
+      original_->GetMappedStore() != NULL;
+  UpdatePrograms();
+  SetFilters(filters);
+  PostFilteringTask();
+}
+
 void FilteredLogView::LogViewNewItems() {
   PostFilteringTask();
 }
@@ -47,8 +133,40 @@ void FilteredLogView::LogViewCleared() {
     it->second->LogViewCleared();
 }
 
+void FilteredLogView::LogViewEvicted(int first_row) {
+  // Our evicted rows are the included rows that were evicted, and the rest
+  // keep their numbers. Any candidates left to refine go the same way.
+  int num_evicted = included_rows_.Rank(first_row);
+  included_rows_.EraseBefore(first_row);
+  if (flattens_rows_)
+    store_rows_.erase(store_rows_.begin(), store_rows_.begin() + num_evicted);
+  first_row_ += num_evicted;
+
+  if (!refine_rows_.empty()) {
+    std::vector<int>::iterator evicted(
+        std::lower_bound(refine_rows_.begin(), refine_rows_.end(),
+                         first_row));
+    int num_candidates = evicted - refine_rows_.begin();
+    refine_rows_.erase(refine_rows_.begin(), evicted);
+    refined_rows_ = std::max(0, refined_rows_ - num_candidates);
+  }
+
+  filtered_rows_ = std::max(filtered_rows_, first_row);
+
+  if (num_evicted == 0)
+    return;
+
+  EventSinkMap::iterator it(event_sinks_.begin());
+  for (; it != event_sinks_.end(); ++it)
+    it->second->LogViewEvicted(first_row_);
+}
+
 int FilteredLogView::GetNumRows() {
-  return included_rows_.size();
+  return first_row_ + included_rows_.size();
+}
+
+int FilteredLogView::GetFirstRow() {
+  return first_row_;
 }
 
 void FilteredLogView::ClearAll() {
@@ -56,51 +174,134 @@ void FilteredLogView::ClearAll() {
 }
 
 int FilteredLogView::GetSeverity(int row) {
-  DCHECK(row < GetNumRows());
-
-  return original_->GetSeverity(included_rows_[row]);
+  return original_->GetSeverity(GetOriginalRow(row));
 }
 
 DWORD FilteredLogView::GetProcessId(int row) {
-  DCHECK(row < GetNumRows());
-
-  return original_->GetProcessId(included_rows_[row]);
+  return original_->GetProcessId(GetOriginalRow(row));
 }
 
 DWORD FilteredLogView::GetThreadId(int row) {
-  DCHECK(row < GetNumRows());
-
-  return original_->GetThreadId(included_rows_[row]);
+  return original_->GetThreadId(GetOriginalRow(row));
 }
 
 base::Time FilteredLogView::GetTime(int row) {
-  DCHECK(row < GetNumRows());
-
-  return original_->GetTime(included_rows_[row]);
+  return original_->GetTime(GetOriginalRow(row));
 }
 
 std::string FilteredLogView::GetFileName(int row) {
-  DCHECK(row < GetNumRows());
+  return original_->GetFileName(GetOriginalRow(row));
+}
 
-  return original_->GetFileName(included_rows_[row]);
+StringTable::Atom FilteredLogView::GetFileAtom(int row) {
+  return original_->GetFileAtom(GetOriginalRow(row));
 }
 
 int FilteredLogView::GetLine(int row) {
-  DCHECK(row < GetNumRows());
-
-  return original_->GetLine(included_rows_[row]);
+  return original_->GetLine(GetOriginalRow(row));
 }
 
 std::string FilteredLogView::GetMessage(int row) {
-  DCHECK(row < GetNumRows());
+  return original_->GetMessage(GetOriginalRow(row));
+}
+
+void FilteredLogView::GetStackTrace(int row,
+                                    std::vector<sym_util::Address>* trace) {
+  return original_->GetStackTrace(GetOriginalRow(row), trace);
+}
 
-  return original_->GetMessage(included_rows_[row]);
+base::StringPiece FilteredLogView::GetFileNamePiece(int row,
+                                                    std::string* buffer) {
+  return original_->GetFileNamePiece(GetOriginalRow(row), buffer);
 }
 
-void FilteredLogView::GetStackTrace(int row, std::vector<void*>* trace) {
-  DCHECK(row < GetNumRows());
+base::StringPiece FilteredLogView::GetMessagePiece(int row,
+                                                   std::string* buffer) {
+  return original_->GetMessagePiece(GetOriginalRow(row), buffer);
+}
 
-  return original_->GetStackTrace(included_rows_[row], trace);
+size_t FilteredLogView::GetStackTracePiece(
+    int row,
+    const sym_util::Address** trace,
+    std::vector<sym_util::Address>* buffer) {
+  return original_->GetStackTracePiece(GetOriginalRow(row), trace, buffer);
+}
+
+StackTracePool::StackId FilteredLogView::GetStackTraceId(int row) {
+  return original_->GetStackTraceId(GetOriginalRow(row));
+}
+
+bool FilteredLogView::CollapsesRepeats() {
+  return original_->CollapsesRepeats();
+}
+
+int FilteredLogView::GetRepeatCount(int row) {
+  return original_->GetRepeatCount(GetOriginalRow(row));
+}
+
+base::Time FilteredLogView::GetLastTime(int row) {
+  return original_->GetLastTime(GetOriginalRow(row));
+}
+
+bool FilteredLogView::IsLossMarker(int row) {
+  return original_->IsLossMarker(GetOriginalRow(row));
+}
+
+int FilteredLogView::FindRowForTime(const base::Time& time) {
+  // Our rows are in the order of the original's, so the first of ours at
+  // or past its row is the one.
+  int original_row = original_->FindRowForTime(time);
+  return first_row_ + included_rows_.Rank(original_row);
+}
+
+StackModuleIndex* FilteredLogView::GetStackModuleIndex() {
+  // Our rows' traces are the original's.
+  return original_->GetStackModuleIndex();
+}
+
+ProcessInstanceIndex* FilteredLogView::GetProcessInstanceIndex() {
+  // Our rows' processes are the original's.
+  return original_->GetProcessInstanceIndex();
+}
+
+const LogStore* FilteredLogView::GetLogStore() {
+  // Our rows don't map to the original store row for row.
+  return NULL;
+}
+
+const LogStore* FilteredLogView::GetMappedStore() {
+  // Our rows are a subset of the original's.
+  return original_->GetMappedStore();
+}
+
+int FilteredLogView::GetStoreRow(int row) {
+  if (!flattens_rows_)
+    return GetOriginalRow(row);
+
+  DCHECK_GE(row, first_row_);
+  DCHECK_LT(row - first_row_, static_cast<int>(store_rows_.size()));
+  return store_rows_[row - first_row_];
+}
+
+int FilteredLogView::GetScanRow() {
+  // Candidates left to refine precede the new rows.
+  if (!refine_rows_.empty())
+    return kNotScanning;
+  return filtered_rows_;
+}
+
+void FilteredLogView::OnRowsScanned(int end, const std::vector<int>& rows) {
+  DCHECK(refine_rows_.empty());
+  int starting_rows = GetNumRows();
+
+  IncludeRows(rows.begin(), rows.end());
+  filtered_rows_ = std::max(filtered_rows_, end);
+
+  if (starting_rows != GetNumRows()) {
+    EventSinkMap::iterator it(event_sinks_.begin());
+    for (; it != event_sinks_.end(); ++it)
+      it->second->LogViewNewItems();
+  }
 }
 
 void FilteredLogView::Register(ILogViewEvents* event_sink,
@@ -115,54 +316,102 @@ void FilteredLogView::Unregister(int registration_cookie) {
   event_sinks_.erase(registration_cookie);
 }
 
+int FilteredLogView::GetOriginalRow(int row) const {
+  DCHECK_LE(first_row_, row);
+  DCHECK_LT(row - first_row_, included_rows_.size());
+  return included_rows_.Select(row - first_row_);
+}
+
 bool FilteredLogView::MatchesFilterList(const std::vector<Filter>& list,
                                         int index) {
-  std::vector<Filter>::const_iterator iter(list.begin());
-  for (; iter != list.end(); ++iter) {
-    if (iter->Matches(original_, index)) {
-      return true;
-    }
+  return MatchesAny(list, original_, index);
+}
+
+void FilteredLogView::EnsureRangePrograms(size_t num_ranges) {
+  while (range_programs_.size() < num_ranges) {
+    range_programs_.push_back(
+        new FilterProgram(inclusion_filters_, exclusion_filters_));
+    range_programs_.back()->set_keep_loss_markers(true);
+    range_refine_programs_.push_back(
+        new FilterProgram(refine_inclusion_filters_,
+                          refine_exclusion_filters_));
+    range_refine_programs_.back()->set_keep_loss_markers(true);
   }
-  return false;
 }
 
 void FilteredLogView::FilterChunk() {
+  ScopedPerfTimer timer(&filter_chunk_counter);
+  ScopedSawbuckTraceEvent trace("FilteredLogView::FilterChunk", this);
   task_.Cancel();
 
   // Stash our starting row count.
   int starting_rows = GetNumRows();
 
-  // Figure the range we're going to filter.
-  const int kMaxFilterRows = 1000;
-  int start = filtered_rows_;
-  int end = std::min(filtered_rows_ + kMaxFilterRows, original_->GetNumRows());
+  // Candidates left over from narrowing the filters are refined before
+  // we proceed to new rows, the candidates all precede the new rows.
+  int num_rows = original_->GetNumRows();
+  bool refining = !refine_rows_.empty();
+  const LogStore* store = original_->GetLogStore();
+  if (store != NULL && FilterFromPostings(*store))
+    return;
+  if (!refining && scan_ != NULL) {
+    // The scan takes it from here.
+    scan_->PostScanTask();
+    return;
+  }
+  const int* candidates = refining ? &refine_rows_[0] : NULL;
+  int start = refining ? refined_rows_ : filtered_rows_;
+  int limit = refining ? static_cast<int>(refine_rows_.size()) : num_rows;
+  FilterProgram* program = refining ? refine_program_.get() : program_.get();
+
+  // Figure the range we're going to filter, and how many threads to
+  // spread it over.
+  int num_threads = std::max(1, std::min(
+      static_cast<int>(max_filter_threads_),
+      (limit - start) / kMinRowsPerThread));
+  EnsureRangePrograms(num_threads - 1);
+  int end = std::min(start + num_threads * kMaxRowsPerThread, limit);
+
+  // Hand the trailing ranges to the task pool, then filter the first range
+  // ourselves, and any the pool hasn't got to by then. The ranges are
+  // included in order.
+  int range = (end - start + num_threads - 1) / num_threads;
+  std::vector<std::vector<int> > range_rows(num_threads - 1);
+  chunk_rows_.clear();
+  {
+    TaskPool::TaskGroup group(TaskPool::Get(), TaskPool::PRIORITY_VISIBLE,
+                              &filter_range_counter);
+    for (int i = 1; i < num_threads; ++i) {
+      FilterProgram* range_program = refining ?
+          range_refine_programs_[i - 1] : range_programs_[i - 1];
+      group.Post(base::Bind(&FilterRange, range_program, original_, store,
+                            candidates, std::min(start + i * range, end),
+                            std::min(start + (i + 1) * range, end),
+                            &range_rows[i - 1]));
+    }
+
+    program->Run(original_, store, candidates,
+                 start, std::min(start + range, end), &chunk_rows_);
+    group.Wait();
+  }
 
+  IncludeRows(chunk_rows_.begin(), chunk_rows_.end());
+  for (int i = 1; i < num_threads; ++i)
+    IncludeRows(range_rows[i - 1].begin(), range_rows[i - 1].end());
 
-  if (inclusion_filters_.empty()) {
-    // If the inclusion_filters_ list is empty, show all rows that do not match
-    // a filter in the exclusion list
-    for (int i = start; i < end; ++i) {
-      // Run the exclusion filters here..
-      if (!MatchesFilterList(exclusion_filters_, i)) {
-        included_rows_.push_back(i);
-      }
+  // Update our cursor.
+  if (refining) {
+    refined_rows_ = end;
+    if (refined_rows_ == limit) {
+      std::vector<int>().swap(refine_rows_);
+      refined_rows_ = 0;
     }
   } else {
-    // Otherwise, show all rows that match a filter in the inclusion list but
-    // match no rows in the exclusion list.
-    for (int i = start; i < end; ++i) {
-      if (MatchesFilterList(inclusion_filters_, i) &&
-          !MatchesFilterList(exclusion_filters_, i)) {
-        included_rows_.push_back(i);
-      }
-    }
+    filtered_rows_ = end;
   }
 
-  // Update our cursor.
-  filtered_rows_ = end;
-
   // Post again if we're not done.
-  if (end != original_->GetNumRows())
+  if (!refine_rows_.empty() || filtered_rows_ != num_rows)
     PostFilteringTask();
 
   // If we added rows, signal the change.
@@ -173,31 +422,154 @@ void FilteredLogView::FilterChunk() {
   }
 }
 
+bool FilteredLogView::FilterFromPostings(const LogStore& store) {
+  // Candidates left to refine are as quickly redone in full, as is
+  // everything from the first row retained.
+  bool refining = !refine_rows_.empty();
+  int start = refining ? original_->GetFirstRow() : filtered_rows_;
+  int num_rows = original_->GetNumRows();
+  if (!program_->GetCandidateRows(original_, store, start, num_rows,
+                                  &posting_rows_)) {
+    return false;
+  }
+
+  int starting_rows = GetNumRows();
+  if (refining) {
+    ClearIncludedRows();
+    std::vector<int>().swap(refine_rows_);
+    refined_rows_ = 0;
+  }
+  if (!posting_rows_.empty()) {
+    chunk_rows_.clear();
+    program_->Run(original_, &store, &posting_rows_[0], 0,
+                  static_cast<int>(posting_rows_.size()), &chunk_rows_);
+    IncludeRows(chunk_rows_.begin(), chunk_rows_.end());
+  }
+  posting_rows_.clear();
+  filtered_rows_ = num_rows;
+
+  if (refining || starting_rows != GetNumRows()) {
+    EventSinkMap::iterator it(event_sinks_.begin());
+    for (; it != event_sinks_.end(); ++it)
+      it->second->LogViewNewItems();
+  }
+  return true;
+}
+
 void FilteredLogView::SetFilters(const std::vector<Filter>& filters) {
-  inclusion_filters_.clear();
-  exclusion_filters_.clear();
+  std::vector<Filter> inclusion_filters;
+  std::vector<Filter> exclusion_filters;
 
   std::vector<Filter>::const_iterator iter(filters.begin());
   for (; iter != filters.end(); ++iter) {
     if (iter->action() == Filter::INCLUDE) {
-      inclusion_filters_.push_back(*iter);
+      inclusion_filters.push_back(*iter);
     } else if (iter->action() == Filter::EXCLUDE) {
-      exclusion_filters_.push_back(*iter);
+      exclusion_filters.push_back(*iter);
     } else {
       NOTREACHED();
     }
   }
 
-  RestartFiltering();
+  // The new filters are narrower than ours if they exclude at least what
+  // we exclude, and include at most what we include. If so, the rows we've
+  // included so far are candidates to refine, and the rest stay out.
+  bool narrower = IsSubset(exclusion_filters_, exclusion_filters) &&
+      (inclusion_filters_.empty() ||
+       (!inclusion_filters.empty() &&
+        IsSubset(inclusion_filters, inclusion_filters_)));
+  if (!narrower) {
+    inclusion_filters_.swap(inclusion_filters);
+    exclusion_filters_.swap(exclusion_filters);
+    refine_inclusion_filters_.clear();
+    refine_exclusion_filters_.clear();
+    UpdatePrograms();
+    RestartFiltering();
+    return;
+  }
+
+  if (!refine_rows_.empty()) {
+    // We're already refining under a previous narrowing, so the remaining
+    // candidates need the full set of filters. Rows already refined only
+    // need the difference, but it's simpler to treat them the same.
+    refine_inclusion_filters_ = inclusion_filters;
+    refine_exclusion_filters_ = exclusion_filters;
+    IncludeRows(refine_rows_.begin() + refined_rows_, refine_rows_.end());
+  } else {
+    // The candidates passed our filters, so they only need testing
+    // against the difference. A changed inclusion list needs testing
+    // in full, as the candidates may have passed a removed alternative.
+    refine_inclusion_filters_.clear();
+    if (!IsSubset(inclusion_filters, inclusion_filters_) ||
+        !IsSubset(inclusion_filters_, inclusion_filters)) {
+      refine_inclusion_filters_ = inclusion_filters;
+    }
+    refine_exclusion_filters_ =
+        Difference(exclusion_filters, exclusion_filters_);
+
+    // Nothing to do if the filters didn't change.
+    if (refine_inclusion_filters_.empty() &&
+        refine_exclusion_filters_.empty()) {
+      return;
+    }
+  }
+
+  inclusion_filters_.swap(inclusion_filters);
+  exclusion_filters_.swap(exclusion_filters);
+  UpdatePrograms();
+
+  refine_rows_.clear();
+  included_rows_.GetRows(&refine_rows_);
+  ClearIncludedRows();
+  refined_rows_ = 0;
+  PostFilteringTask();
 }
 
 void FilteredLogView::RestartFiltering() {
-  // Reset our included state and our filtering state.
-  filtered_rows_ = 0;
-  included_rows_.clear();
+  // Reset our included state and our filtering state, our rows are
+  // numbered afresh.
+  filtered_rows_ = original_->GetFirstRow();
+  first_row_ = 0;
+  flattens_rows_ = original_->GetLogStore() == NULL &&
+      original_->GetMappedStore() != NULL;
+  ClearIncludedRows();
+  refine_rows_.clear();
+  refined_rows_ = 0;
   PostFilteringTask();
 }
 
+void FilteredLogView::IncludeRows(std::vector<int>::const_iterator begin,
+                                  std::vector<int>::const_iterator end) {
+  included_rows_.AppendRows(begin, end);
+  if (!flattens_rows_)
+    return;
+
+  // The original's mapping is composed into ours here, once per row, so
+  // that looking up a store row doesn't go through the original.
+  for (; begin != end; ++begin)
+    store_rows_.push_back(original_->GetStoreRow(*begin));
+}
+
+void FilteredLogView::ClearIncludedRows() {
+  included_rows_.Clear();
+  store_rows_.clear();
+}
+
+void FilteredLogView::UpdatePrograms() {
+  program_.reset(new FilterProgram(inclusion_filters_, exclusion_filters_));
+  refine_program_.reset(new FilterProgram(refine_inclusion_filters_,
+                                          refine_exclusion_filters_));
+  program_->set_keep_loss_markers(true);
+  refine_program_->set_keep_loss_markers(true);
+  if (scan_ != NULL)
+    scan_->SetFilters(this, inclusion_filters_, exclusion_filters_);
+
+  // The range programs are idle between chunks, and are compiled anew as
+  // they're next needed.
+  range_programs_.clear();
+  range_refine_programs_.clear();
+}
+
 void FilteredLogView::PostFilteringTask() {
   if (task_.IsCancelled()) {
     task_.Reset(base::Bind(&FilteredLogView::FilterChunk,
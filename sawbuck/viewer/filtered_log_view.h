@@ -22,60 +22,161 @@
 
 #include "base/cancelable_callback.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
 #include "sawbuck/viewer/filter.h"
+#include "sawbuck/viewer/filter_program.h"
+#include "sawbuck/viewer/filter_scan.h"
 #include "sawbuck/viewer/log_list_view.h"
-
-// Provides a filtered view on a log.
+#include "sawbuck/viewer/row_set.h"
+
+// Provides a filtered view on a log. Filtering proceeds in chunks of rows,
+// one chunk per task posted to the current message loop. Large chunks are
+// split into row ranges that are matched in parallel on a pool of filter
+// threads, while the message loop thread waits on the outcome.
+// @note the original view is read concurrently from the filter threads,
+//    though only while a chunk is being filtered. It must therefore
+//    tolerate concurrent reads, and must not change while a chunk is
+//    being filtered, which holds if it only changes on our thread.
 class FilteredLogView
     : public ILogViewEvents,
-      public ILogView {
+      public ILogView,
+      public FilterScan::Client {
  public:
   explicit FilteredLogView(ILogView* original,
                            const std::vector<Filter>& filters);
+  // Filters the new rows of @p scan's original as part of @p scan, along
+  // with the other views on it. Refining after narrowing the filters is
+  // still done by the view itself.
+  FilteredLogView(FilterScan* scan, const std::vector<Filter>& filters);
   ~FilteredLogView();
 
   // ILogViewEvents implementation.
   virtual void LogViewNewItems();
   virtual void LogViewCleared();
+  virtual void LogViewEvicted(int first_row);
 
   // ILogView implementation;
   // @{
   virtual int GetNumRows();
+  virtual int GetFirstRow();
   virtual void ClearAll();
   virtual int GetSeverity(int row);
   virtual DWORD GetProcessId(int row);
   virtual DWORD GetThreadId(int row);
   virtual base::Time GetTime(int row);
   virtual std::string GetFileName(int row);
+  virtual StringTable::Atom GetFileAtom(int row);
   virtual int GetLine(int row);
   virtual std::string GetMessage(int row);
-  virtual void GetStackTrace(int row, std::vector<void*>* trace);
+  virtual void GetStackTrace(int row, std::vector<sym_util::Address>* trace);
+  virtual base::StringPiece GetFileNamePiece(int row, std::string* buffer);
+  virtual base::StringPiece GetMessagePiece(int row, std::string* buffer);
+  virtual size_t GetStackTracePiece(int row,
+                                    const sym_util::Address** trace,
+                                    std::vector<sym_util::Address>* buffer);
+  virtual StackTracePool::StackId GetStackTraceId(int row);
+  virtual bool CollapsesRepeats();
+  virtual int GetRepeatCount(int row);
+  virtual base::Time GetLastTime(int row);
+  virtual bool IsLossMarker(int row);
+  virtual int FindRowForTime(const base::Time& time);
+  virtual StackModuleIndex* GetStackModuleIndex();
+  virtual ProcessInstanceIndex* GetProcessInstanceIndex();
+  virtual const LogStore* GetLogStore();
+  virtual const LogStore* GetMappedStore();
+  virtual int GetStoreRow(int row);
   virtual void Register(ILogViewEvents* event_sink,
                         int* registration_cookie);
   virtual void Unregister(int registration_cookie);
   // @}
 
+  // FilterScan::Client implementation.
+  virtual int GetScanRow();
+  virtual void OnRowsScanned(int end, const std::vector<int>& rows);
+
  void SetFilters(const std::vector<Filter>& filters);
 
  protected:
+  // Starts filtering @p filters, shared by the constructors.
+  void Initialize(const std::vector<Filter>& filters);
+
   void PostFilteringTask();
   void FilterChunk();
+  // Filters all rows left by way of the posting lists of @p store, which
+  // backs |original_| row for row.
+  // @returns true if it did, false if the filters don't allow for it.
+  bool FilterFromPostings(const LogStore& store);
   virtual void RestartFiltering();
 
+  // Returns the row of |original_| our |row| is.
+  int GetOriginalRow(int row) const;
+
+  // Adds the original's rows in [@p begin, @p end), which follow on from
+  // our included rows, to our included rows.
+  void IncludeRows(std::vector<int>::const_iterator begin,
+                   std::vector<int>::const_iterator end);
+  // Empties our included rows.
+  void ClearIncludedRows();
+
   // Returns true if the item at |index| would match a filter in |list|,
   // false otherwise.
   bool MatchesFilterList(const std::vector<Filter>& list, int index);
 
+  // Compiles our current filters for the ranges of a chunk after the first,
+  // for up to @p num_ranges ranges, if not already compiled.
+  void EnsureRangePrograms(size_t num_ranges);
+  // Compiles our current filters, for us and for the chunk ranges.
+  void UpdatePrograms();
+
   // The filters we are using. We break them into two lists, one that contains
   // inclusion filters, the other exclusion filters.
   std::vector<Filter> inclusion_filters_;
   std::vector<Filter> exclusion_filters_;
 
-  // The included rows we have filtered.
-  std::vector<int> included_rows_;
+  // When the filters are narrowed, the rows included under the broader
+  // filters are refined by these filters, rather than re-filtering the
+  // whole log.
+  std::vector<Filter> refine_inclusion_filters_;
+  std::vector<Filter> refine_exclusion_filters_;
+
+  // The above, compiled.
+  scoped_ptr<FilterProgram> program_;
+  scoped_ptr<FilterProgram> refine_program_;
+
+  // The included rows we have filtered, our row |first_row_| on. The rows
+  // before are the included rows evicted from |original_|, so the rows
+  // keep their numbers. A compressed set, as a filter that passes most
+  // rows would otherwise cost an int per row.
+  RowSet included_rows_;
+  int first_row_;
+  // The rows of the original's mapped store that our included rows are,
+  // looked up once as the rows are included. Only kept if |flattens_rows_|,
+  // that is if the original maps its rows to the store other than row for
+  // row, as otherwise our included rows are the store's rows.
+  bool flattens_rows_;
+  std::vector<int> store_rows_;
   // Row number of last row in |original_| that we've processed.
   int filtered_rows_;
 
+  // The candidate rows left to refine, and the number refined so far.
+  std::vector<int> refine_rows_;
+  int refined_rows_;
+
+  // Scratch space for the candidates from the posting lists, and for the
+  // rows a chunk includes before they go into |included_rows_|.
+  std::vector<int> posting_rows_;
+  std::vector<int> chunk_rows_;
+
+  // The maximum number of threads filtering a chunk, including our own.
+  // Defaults to the task pool's workers and our own.
+  size_t max_filter_threads_;
+
+  // The programs for the ranges of a chunk after the first, to filter new
+  // rows and to refine candidates, compiled lazily. Each range has its own,
+  // as programs cache match state.
+  ScopedVector<FilterProgram> range_programs_;
+  ScopedVector<FilterProgram> range_refine_programs_;
+
   typedef base::CancelableCallback<void()> FilterCallback;
 
   // Non-NULL if there's a task pending to process additional rows.
@@ -84,6 +185,9 @@ class FilteredLogView
   ILogView* original_;
   int registration_cookie_;
 
+  // The scan that filters our new rows, if any.
+  FilterScan* scan_;
+
   typedef std::map<int, ILogViewEvents*> EventSinkMap;
   EventSinkMap event_sinks_;
   int next_sink_cookie_;
@@ -13,16 +13,19 @@
 // limitations under the License.
 #include "sawbuck/viewer/filtered_log_view.h"
 
+#include "base/atomicops.h"
 #include "base/run_loop.h"
 #include "base/message_loop/message_loop.h"
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
+#include "sawbuck/viewer/log_store.h"
 #include "sawbuck/viewer/mock_log_view_interfaces.h"
 
 namespace {
 
 using testing::_;
 using testing::AtLeast;
+using testing::Invoke;
 using testing::Return;
 using testing::SetArgumentPointee;
 using testing::StrictMock;
@@ -36,8 +39,29 @@ class TestingFilteredLogView: public FilteredLogView {
   }
 
   const FilterCallback& task() const { return task_; }
+  std::vector<int> included_rows() const {
+    std::vector<int> rows;
+    included_rows_.GetRows(&rows);
+    return rows;
+  }
+  void set_max_filter_threads(size_t max_filter_threads) {
+    max_filter_threads_ = max_filter_threads;
+  }
 };
 
+std::string GetParityMessage(int row) {
+  return row % 2 == 0 ? "even" : "odd";
+}
+
+// Counts the messages fetched, which may be from several threads.
+base::subtle::Atomic32 messages_fetched = 0;
+
+std::string GetCountedMessage(int row) {
+  base::subtle::NoBarrier_AtomicIncrement(&messages_fetched, 1);
+  const char* kMessages[] = { "zero", "one", "two" };
+  return kMessages[row % arraysize(kMessages)];
+}
+
 class FilteredLogViewTest: public testing::Test {
  public:
   static const int kRegCookie = 42;
@@ -45,6 +69,10 @@ class FilteredLogViewTest: public testing::Test {
   void ExpectCreation(int num_rows) {
     EXPECT_CALL(mock_view_, Register(_, _))
         .WillOnce(SetArgumentPointee<1>(kRegCookie));
+    EXPECT_CALL(mock_view_, GetLogStore())
+        .WillRepeatedly(Return(static_cast<const LogStore*>(NULL)));
+    EXPECT_CALL(mock_view_, GetFirstRow())
+        .WillRepeatedly(Return(0));
   }
 
   void ExpectUnregistration() {
@@ -203,6 +231,375 @@ TEST_F(FilteredLogViewTest, Filtering) {
   ExpectUnregistration();
 }
 
+TEST_F(FilteredLogViewTest, ParallelFiltering) {
+  ExpectCreation(0);
+  TestingFilteredLogView filtered(&mock_view_, filters_);
+  filtered.set_max_filter_threads(4);
+
+  int cookie = 0;
+  filtered.Register(&mock_view_events_, &cookie);
+
+  // Enough rows for several chunks across all threads, plus a ragged end.
+  const int kNumRows = 12345;
+  EXPECT_CALL(mock_view_, GetNumRows())
+      .WillRepeatedly(Return(kNumRows));
+  EXPECT_CALL(mock_view_, GetMessage(_))
+      .WillRepeatedly(Invoke(GetParityMessage));
+  EXPECT_CALL(mock_view_events_, LogViewNewItems())
+      .Times(AtLeast(1));
+
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::MESSAGE, Filter::IS, Filter::INCLUDE,
+                           L"even"));
+  filtered.SetFilters(filters);
+  RunMessageLoopToIdle();
+
+  // The matches must come out complete and in order.
+  const std::vector<int>& included = filtered.included_rows();
+  ASSERT_EQ((kNumRows + 1) / 2, included.size());
+  for (size_t i = 0; i < included.size(); ++i)
+    ASSERT_EQ(2 * i, included[i]);
+
+  // Flip the filter over, and check that the workers pick up the change.
+  filters.clear();
+  filters.push_back(Filter(Filter::MESSAGE, Filter::IS, Filter::EXCLUDE,
+                           L"even"));
+  filtered.SetFilters(filters);
+  RunMessageLoopToIdle();
+
+  const std::vector<int>& flipped = filtered.included_rows();
+  ASSERT_EQ(kNumRows / 2, flipped.size());
+  for (size_t i = 0; i < flipped.size(); ++i)
+    ASSERT_EQ(2 * i + 1, flipped[i]);
+
+  ExpectUnregistration();
+}
+
+TEST_F(FilteredLogViewTest, NarrowingRefinesIncludedRows) {
+  ExpectCreation(0);
+  TestingFilteredLogView filtered(&mock_view_, filters_);
+  filtered.set_max_filter_threads(4);
+
+  int cookie = 0;
+  filtered.Register(&mock_view_events_, &cookie);
+
+  const int kNumRows = 10000;
+  EXPECT_CALL(mock_view_, GetNumRows())
+      .WillRepeatedly(Return(kNumRows));
+  EXPECT_CALL(mock_view_, GetMessage(_))
+      .WillRepeatedly(Invoke(GetCountedMessage));
+  EXPECT_CALL(mock_view_events_, LogViewNewItems())
+      .Times(AtLeast(1));
+
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::MESSAGE, Filter::IS, Filter::EXCLUDE,
+                           L"zero"));
+  filtered.SetFilters(filters);
+  RunMessageLoopToIdle();
+  ASSERT_EQ(kNumRows - (kNumRows + 2) / 3, filtered.GetNumRows());
+
+  // An added exclusion only tests the rows included so far, and only
+  // against the added filter.
+  base::subtle::NoBarrier_Store(&messages_fetched, 0);
+  filters.push_back(Filter(Filter::MESSAGE, Filter::IS, Filter::EXCLUDE,
+                           L"one"));
+  filtered.SetFilters(filters);
+  EXPECT_EQ(0, filtered.GetNumRows());
+  RunMessageLoopToIdle();
+  EXPECT_EQ(kNumRows - (kNumRows + 2) / 3,
+            base::subtle::NoBarrier_Load(&messages_fetched));
+
+  const std::vector<int>& included = filtered.included_rows();
+  ASSERT_EQ(kNumRows / 3, included.size());
+  for (size_t i = 0; i < included.size(); ++i)
+    ASSERT_EQ(3 * i + 2, included[i]);
+
+  // Setting the same filters again is free.
+  base::subtle::NoBarrier_Store(&messages_fetched, 0);
+  filtered.SetFilters(filters);
+  RunMessageLoopToIdle();
+  EXPECT_EQ(0, base::subtle::NoBarrier_Load(&messages_fetched));
+  EXPECT_EQ(kNumRows / 3, filtered.GetNumRows());
+
+  // Narrowing to an inclusion, then narrowing again before the first
+  // refinement is done, still comes out right.
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE,
+                           L"o"));
+  filtered.SetFilters(filters);
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::EXCLUDE,
+                           L"tw"));
+  filtered.SetFilters(filters);
+  RunMessageLoopToIdle();
+  EXPECT_EQ(0, filtered.GetNumRows());
+
+  // Broadening re-filters the whole log.
+  base::subtle::NoBarrier_Store(&messages_fetched, 0);
+  filters.erase(filters.begin() + 1, filters.end());
+  filtered.SetFilters(filters);
+  RunMessageLoopToIdle();
+  EXPECT_EQ(kNumRows, base::subtle::NoBarrier_Load(&messages_fetched));
+  EXPECT_EQ(kNumRows - (kNumRows + 2) / 3, filtered.GetNumRows());
+
+  ExpectUnregistration();
+}
+
+TEST_F(FilteredLogViewTest, EvictedRows) {
+  ExpectCreation(0);
+  TestingFilteredLogView filtered(&mock_view_, filters_);
+
+  int cookie = 0;
+  filtered.Register(&mock_view_events_, &cookie);
+
+  EXPECT_CALL(mock_view_, GetNumRows())
+      .WillRepeatedly(Return(100));
+  EXPECT_CALL(mock_view_, GetMessage(_))
+      .WillRepeatedly(Invoke(GetParityMessage));
+  EXPECT_CALL(mock_view_events_, LogViewNewItems())
+      .Times(AtLeast(1));
+
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::MESSAGE, Filter::IS, Filter::INCLUDE,
+                           L"even"));
+  filtered.SetFilters(filters);
+  RunMessageLoopToIdle();
+  ASSERT_EQ(50, filtered.GetNumRows());
+
+  // The even rows up to 30 go, and the others keep their numbers.
+  EXPECT_CALL(mock_view_events_, LogViewEvicted(16)).Times(1);
+  filtered.LogViewEvicted(31);
+  EXPECT_EQ(16, filtered.GetFirstRow());
+  EXPECT_EQ(50, filtered.GetNumRows());
+  ASSERT_FALSE(filtered.included_rows().empty());
+  EXPECT_EQ(32, filtered.included_rows().front());
+
+  // Evicting none of our rows goes unremarked.
+  filtered.LogViewEvicted(32);
+  EXPECT_EQ(16, filtered.GetFirstRow());
+
+  // New rows are numbered on from the last.
+  EXPECT_CALL(mock_view_, GetNumRows())
+      .WillRepeatedly(Return(120));
+  filtered.LogViewNewItems();
+  RunMessageLoopToIdle();
+  EXPECT_EQ(16, filtered.GetFirstRow());
+  EXPECT_EQ(60, filtered.GetNumRows());
+
+  ExpectUnregistration();
+}
+
+TEST_F(FilteredLogViewTest, FiltersFromFirstRow) {
+  ExpectCreation(0);
+  EXPECT_CALL(mock_view_, GetFirstRow())
+      .WillRepeatedly(Return(50));
+  TestingFilteredLogView filtered(&mock_view_, filters_);
+
+  // The evicted rows of the original aren't looked at.
+  EXPECT_CALL(mock_view_, GetNumRows())
+      .WillRepeatedly(Return(100));
+  EXPECT_CALL(mock_view_, GetMessage(testing::Ge(50)))
+      .WillRepeatedly(Invoke(GetParityMessage));
+
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::MESSAGE, Filter::IS, Filter::INCLUDE,
+                           L"even"));
+  filtered.SetFilters(filters);
+  RunMessageLoopToIdle();
+  EXPECT_EQ(0, filtered.GetFirstRow());
+  EXPECT_EQ(25, filtered.GetNumRows());
+
+  ExpectUnregistration();
+}
+
+// Every tenth row is an error, the rows cycle through four processes.
+UCHAR GetPostingSeverity(int row) {
+  return row % 10 == 0 ? TRACE_LEVEL_ERROR : TRACE_LEVEL_INFORMATION;
+}
+
+int GetPostingSeverityInt(int row) {
+  return GetPostingSeverity(row);
+}
+
+void AddPostingRows(int count, LogStore* store) {
+  for (int i = 0; i < count; ++i) {
+    int row = store->num_rows();
+    store->AddRow(GetPostingSeverity(row), 1 + row % 4, 1, base::Time(),
+                  StringTable::kEmptyAtom, 0, "message", 0, NULL);
+  }
+}
+
+TEST_F(FilteredLogViewTest, FiltersFromPostings) {
+  StringTable file_table;
+  LogStore store(&file_table);
+  AddPostingRows(3000, &store);
+
+  ExpectCreation(0);
+  TestingFilteredLogView filtered(&mock_view_, filters_);
+
+  // Only the severities of a row of each are looked at, and no messages.
+  EXPECT_CALL(mock_view_, GetLogStore())
+      .WillRepeatedly(Return(&store));
+  EXPECT_CALL(mock_view_, GetNumRows())
+      .WillRepeatedly(Return(3000));
+  EXPECT_CALL(mock_view_, GetSeverity(_))
+      .Times(2)
+      .WillRepeatedly(Invoke(GetPostingSeverityInt));
+
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::SEVERITY, Filter::IS, Filter::INCLUDE,
+                           L"ERROR"));
+  filtered.SetFilters(filters);
+  RunMessageLoopToIdle();
+  ASSERT_EQ(300, filtered.GetNumRows());
+  EXPECT_EQ(2990, filtered.included_rows().back());
+
+  // Narrowing redoes the rows from the lists, here the errors of process
+  // three go.
+  testing::Mock::VerifyAndClearExpectations(&mock_view_);
+  EXPECT_CALL(mock_view_, GetLogStore())
+      .WillRepeatedly(Return(&store));
+  EXPECT_CALL(mock_view_, GetFirstRow())
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(mock_view_, GetNumRows())
+      .WillRepeatedly(Return(3000));
+  EXPECT_CALL(mock_view_, GetSeverity(_))
+      .WillRepeatedly(Invoke(GetPostingSeverityInt));
+  filters.push_back(Filter(Filter::PROCESS_ID, Filter::IS, Filter::EXCLUDE,
+                           L"3"));
+  filtered.SetFilters(filters);
+  RunMessageLoopToIdle();
+  EXPECT_EQ(150, filtered.GetNumRows());
+
+  // New rows are taken from the lists too.
+  AddPostingRows(1000, &store);
+  EXPECT_CALL(mock_view_, GetNumRows())
+      .WillRepeatedly(Return(4000));
+  filtered.LogViewNewItems();
+  RunMessageLoopToIdle();
+  EXPECT_EQ(200, filtered.GetNumRows());
+  EXPECT_EQ(3980, filtered.included_rows().back());
+
+  ExpectUnregistration();
+}
+
+DWORD GetPostingProcessId(int row) {
+  return 1 + row % 4;
+}
+
+TEST_F(FilteredLogViewTest, FlattensStoreRows) {
+  StringTable file_table;
+  LogStore store(&file_table);
+  AddPostingRows(3000, &store);
+
+  ExpectCreation(0);
+  EXPECT_CALL(mock_view_, GetLogStore())
+      .WillRepeatedly(Return(&store));
+  EXPECT_CALL(mock_view_, GetNumRows())
+      .WillRepeatedly(Return(3000));
+  EXPECT_CALL(mock_view_, GetSeverity(_))
+      .WillRepeatedly(Invoke(GetPostingSeverityInt));
+  EXPECT_CALL(mock_view_, GetProcessId(_))
+      .WillRepeatedly(Invoke(GetPostingProcessId));
+
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::SEVERITY, Filter::IS, Filter::INCLUDE,
+                           L"ERROR"));
+  TestingFilteredLogView errors(&mock_view_, filters);
+  RunMessageLoopToIdle();
+  ASSERT_EQ(300, errors.GetNumRows());
+
+  // The view on the store's view maps to the store through its own rows.
+  EXPECT_EQ(&store, errors.GetMappedStore());
+  EXPECT_EQ(NULL, errors.GetLogStore());
+  EXPECT_EQ(20, errors.GetStoreRow(2));
+
+  // The errors of process one are every other error, and the view on the
+  // view maps straight to the store rows.
+  filters.clear();
+  filters.push_back(Filter(Filter::PROCESS_ID, Filter::IS, Filter::INCLUDE,
+                           L"1"));
+  TestingFilteredLogView process_errors(&errors, filters);
+  RunMessageLoopToIdle();
+  ASSERT_EQ(150, process_errors.GetNumRows());
+  EXPECT_EQ(&store, process_errors.GetMappedStore());
+  for (int i = 0; i < process_errors.GetNumRows(); ++i) {
+    ASSERT_EQ(2 * i, process_errors.included_rows()[i]);
+    ASSERT_EQ(20 * i, process_errors.GetStoreRow(i));
+  }
+
+  ExpectUnregistration();
+}
+
+base::Time GetRowTime(int row) {
+  return base::Time::FromInternalValue(1000000 * (row + 1));
+}
+
+TEST_F(FilteredLogViewTest, FindRowForTime) {
+  ExpectCreation(0);
+  TestingFilteredLogView filtered(&mock_view_, filters_);
+
+  EXPECT_CALL(mock_view_, GetNumRows())
+      .WillRepeatedly(Return(10));
+  EXPECT_CALL(mock_view_, GetMessage(_))
+      .WillRepeatedly(Invoke(GetParityMessage));
+  EXPECT_CALL(mock_view_, GetTime(_))
+      .WillRepeatedly(Invoke(GetRowTime));
+
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::MESSAGE, Filter::IS, Filter::INCLUDE,
+                           L"odd"));
+  filtered.SetFilters(filters);
+  RunMessageLoopToIdle();
+  ASSERT_EQ(5, filtered.GetNumRows());
+
+  // Rows 1, 3, 5, 7 and 9 are included, the first at or past row 4 is 5.
+  EXPECT_EQ(0, filtered.FindRowForTime(GetRowTime(0)));
+  EXPECT_EQ(2, filtered.FindRowForTime(GetRowTime(4)));
+  EXPECT_EQ(2, filtered.FindRowForTime(GetRowTime(5)));
+  EXPECT_EQ(4, filtered.FindRowForTime(GetRowTime(9)));
+  EXPECT_EQ(5, filtered.FindRowForTime(GetRowTime(10)));
+
+  ExpectUnregistration();
+}
+
+TEST_F(FilteredLogViewTest, PieceAccessors) {
+  ExpectCreation(0);
+  TestingFilteredLogView filtered(&mock_view_, filters_);
+
+  EXPECT_CALL(mock_view_, GetNumRows())
+      .WillRepeatedly(Return(10));
+  EXPECT_CALL(mock_view_, GetMessage(_))
+      .WillRepeatedly(Invoke(GetParityMessage));
+
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::MESSAGE, Filter::IS, Filter::INCLUDE,
+                           L"odd"));
+  filtered.SetFilters(filters);
+  RunMessageLoopToIdle();
+  ASSERT_EQ(5, filtered.GetNumRows());
+
+  // The mock has no store, so the pieces are of the buffers, and of
+  // the original's rows.
+  std::string buffer;
+  base::StringPiece message(filtered.GetMessagePiece(2, &buffer));
+  EXPECT_EQ("odd", message.as_string());
+  EXPECT_EQ(buffer.data(), message.data());
+
+  EXPECT_CALL(mock_view_, GetFileName(5))
+      .WillOnce(Return("file.cc"));
+  EXPECT_EQ("file.cc", filtered.GetFileNamePiece(2, &buffer).as_string());
+
+  std::vector<sym_util::Address> trace(1, 0x1000);
+  EXPECT_CALL(mock_view_, GetStackTrace(5, _))
+      .WillOnce(SetArgumentPointee<1>(trace));
+  std::vector<sym_util::Address> trace_buffer;
+  const sym_util::Address* addresses = NULL;
+  EXPECT_EQ(1U, filtered.GetStackTracePiece(2, &addresses, &trace_buffer));
+  ASSERT_TRUE(addresses != NULL);
+  EXPECT_EQ(0x1000, addresses[0]);
+
+  ExpectUnregistration();
+}
+
 class MockFilteredLogView : public TestingFilteredLogView {
  public:
   explicit MockFilteredLogView(ILogView* original,
@@ -50,6 +50,7 @@ LRESULT FindDialog::OnFind(UINT notify_code, int id, CWindow window) {
     params_.match_case_ = (IsDlgButtonChecked(IDC_MATCH_CASE) == BST_CHECKED);
     params_.direction_down_ = (IsDlgButtonChecked(IDC_DIRECTION_DOWN) ==
                                BST_CHECKED);
+    params_.find_all_ = (id == IDC_FIND_ALL);
     base::WideToUTF8(text, text.Length(), &params_.expression_);
     EndDialog(IDOK);
   } else {
@@ -23,13 +23,16 @@
 #include "resource.h"
 
 struct FindParameters {
-  FindParameters() : direction_down_(true), match_case_(false) {
+  FindParameters()
+      : direction_down_(true), match_case_(false), find_all_(false) {
   }
 
   // UTF8 encoded regular expression.
   std::string expression_;
   bool direction_down_;
   bool match_case_;
+  // True to find all matching rows, rather than the next one.
+  bool find_all_;
 };
 
 class FindDialog : public CDialogImpl<FindDialog> {
@@ -39,6 +42,7 @@ class FindDialog : public CDialogImpl<FindDialog> {
   BEGIN_MSG_MAP(FindDialog)
     MSG_WM_INITDIALOG(OnInitDialog)
     COMMAND_ID_HANDLER_EX(IDOK, OnFind)
+    COMMAND_ID_HANDLER_EX(IDC_FIND_ALL, OnFind)
     COMMAND_ID_HANDLER_EX(IDCANCEL, OnCancel)
   END_MSG_MAP()
 
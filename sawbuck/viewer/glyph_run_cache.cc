@@ -0,0 +1,111 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Glyph run cache implementation.
+#include "sawbuck/viewer/glyph_run_cache.h"
+
+#include "base/logging.h"
+
+namespace {
+
+// The number of pages that cover the basic multilingual plane.
+const size_t kNumPages = 0x10000 / GlyphRunCache::kCharsPerPage;
+
+// The ellipsis is three dots, which any font has, as the list view has it.
+const wchar_t kEllipsisDot = L'.';
+const size_t kEllipsisLength = 3;
+
+// @returns true iff @p c is half of a surrogate pair, which pairs up into
+//     characters past the basic multilingual plane, that we leave to GDI.
+bool IsSurrogate(wchar_t c) {
+  return c >= 0xD800 && c <= 0xDFFF;
+}
+
+}  // namespace
+
+const uint16 GlyphRunCache::kMissingGlyph;
+const size_t GlyphRunCache::kCharsPerPage;
+
+GlyphRunCache::GlyphRunCache(Measurer* measurer)
+    : measurer_(measurer), pages_(kNumPages) {
+  DCHECK(measurer_ != NULL);
+}
+
+GlyphRunCache::~GlyphRunCache() {
+}
+
+bool GlyphRunCache::Layout(const std::wstring& text,
+                           int max_width,
+                           GlyphRun* run) {
+  DCHECK(run != NULL);
+
+  run->glyphs.resize(text.size());
+  run->advances.resize(text.size());
+  run->width = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (!GetGlyph(text[i], &run->glyphs[i], &run->advances[i]))
+      return false;
+    run->width += run->advances[i];
+  }
+  if (run->width <= max_width)
+    return true;
+
+  // Drop glyphs off the end until the rest fit beside the ellipsis, or
+  // there are none left, and the ellipsis is clipped.
+  uint16 dot = 0;
+  int dot_width = 0;
+  if (!GetGlyph(kEllipsisDot, &dot, &dot_width))
+    return false;
+
+  int ellipsis_width = static_cast<int>(kEllipsisLength) * dot_width;
+  while (!run->glyphs.empty() && run->width + ellipsis_width > max_width) {
+    run->width -= run->advances.back();
+    run->glyphs.pop_back();
+    run->advances.pop_back();
+  }
+  run->glyphs.resize(run->glyphs.size() + kEllipsisLength, dot);
+  run->advances.resize(run->advances.size() + kEllipsisLength, dot_width);
+  run->width += ellipsis_width;
+
+  return true;
+}
+
+const GlyphRunCache::Page& GlyphRunCache::GetPage(size_t first) {
+  Page& page = pages_[first / kCharsPerPage];
+  if (page.glyphs.empty()) {
+    page.glyphs.resize(kCharsPerPage);
+    page.widths.resize(kCharsPerPage);
+    if (!measurer_->GetGlyphs(static_cast<wchar_t>(first), kCharsPerPage,
+                              &page.glyphs[0], &page.widths[0])) {
+      // Mark the page missing, for GDI to draw, rather than fail again and
+      // again.
+      LOG(ERROR) << "Failed to measure glyphs.";
+      page.glyphs.assign(kCharsPerPage, kMissingGlyph);
+    }
+  }
+  return page;
+}
+
+bool GlyphRunCache::GetGlyph(wchar_t c, uint16* glyph, int* width) {
+  DCHECK(glyph != NULL);
+  DCHECK(width != NULL);
+  if (IsSurrogate(c))
+    return false;
+
+  size_t index = static_cast<uint16>(c);
+  const Page& page = GetPage(index - index % kCharsPerPage);
+  *glyph = page.glyphs[index % kCharsPerPage];
+  *width = page.widths[index % kCharsPerPage];
+  return *glyph != kMissingGlyph;
+}
@@ -0,0 +1,97 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Glyph run cache declaration.
+#ifndef SAWBUCK_VIEWER_GLYPH_RUN_CACHE_H_
+#define SAWBUCK_VIEWER_GLYPH_RUN_CACHE_H_
+
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+
+// A line of glyphs laid out to be drawn in one call, e.g. by ExtTextOut
+// with ETO_GLYPH_INDEX, which spares GDI mapping the characters to glyphs
+// and measuring them again on every paint.
+struct GlyphRun {
+  GlyphRun() : width(0) {
+  }
+
+  std::vector<uint16> glyphs;
+  // The advance of each glyph, for ExtTextOut's lpDx.
+  std::vector<int> advances;
+  // The sum of the advances.
+  int width;
+};
+
+// Caches the glyph indices and advance widths of the characters of a font,
+// a page of characters at a time as first needed, and lays out the text
+// of list view cells with them, truncated with an ellipsis as the list
+// view would.
+// @note like GlyphWidthTable, this ignores kerning and shaping, which
+//     makes no odds to the text of logs.
+class GlyphRunCache {
+ public:
+  // Measures the glyphs for the cache.
+  class Measurer {
+   public:
+    virtual ~Measurer() {}
+
+    // Retrieves the glyph indices and advance widths of the @p count
+    // characters from @p first. Characters the font has no glyph for get
+    // kMissingGlyph.
+    // @returns true on success.
+    virtual bool GetGlyphs(wchar_t first,
+                           size_t count,
+                           uint16* glyphs,
+                           int* widths) = 0;
+  };
+
+  // The glyph of the characters the font lacks, as GetGlyphIndices marks
+  // them.
+  static const uint16 kMissingGlyph = 0xFFFF;
+  // The number of characters measured at a time.
+  static const size_t kCharsPerPage = 256;
+
+  // @param measurer measures the font's glyphs, must outlive this instance.
+  explicit GlyphRunCache(Measurer* measurer);
+  ~GlyphRunCache();
+
+  // Lays out @p text to @p run, as much of it as fits in @p max_width
+  // followed by an ellipsis, if it doesn't all fit.
+  // @returns false if the font lacks a glyph of the text, which is then
+  //     to be drawn as characters, for GDI to link in a font that has it.
+  bool Layout(const std::wstring& text, int max_width, GlyphRun* run);
+
+ private:
+  struct Page {
+    std::vector<uint16> glyphs;
+    std::vector<int> widths;
+  };
+
+  // @returns the page of the characters starting at @p first.
+  const Page& GetPage(size_t first);
+
+  // Looks up the glyph and width of @p c.
+  // @returns false if the font lacks a glyph of @p c.
+  bool GetGlyph(wchar_t c, uint16* glyph, int* width);
+
+  Measurer* measurer_;
+
+  // The pages of glyphs, empty until measured.
+  std::vector<Page> pages_;
+
+  DISALLOW_COPY_AND_ASSIGN(GlyphRunCache);
+};
+
+#endif  // SAWBUCK_VIEWER_GLYPH_RUN_CACHE_H_
@@ -0,0 +1,133 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Glyph run cache unittests.
+#include "sawbuck/viewer/glyph_run_cache.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using testing::_;
+using testing::Invoke;
+using testing::Return;
+
+// Gives each character its own value plus 1000 as its glyph, and a width
+// of its value modulo 10, plus one, but for 'x', which the font lacks.
+bool FakeGlyphs(wchar_t first, size_t count, uint16* glyphs, int* widths) {
+  for (size_t i = 0; i < count; ++i) {
+    wchar_t c = static_cast<wchar_t>(first + i);
+    glyphs[i] = c == L'x' ? GlyphRunCache::kMissingGlyph :
+        static_cast<uint16>(c + 1000);
+    widths[i] = static_cast<int>(c % 10 + 1);
+  }
+  return true;
+}
+
+class MockMeasurer : public GlyphRunCache::Measurer {
+ public:
+  MockMeasurer() {
+    ON_CALL(*this, GetGlyphs(_, _, _, _))
+        .WillByDefault(Invoke(FakeGlyphs));
+  }
+
+  MOCK_METHOD4(GetGlyphs, bool(wchar_t, size_t, uint16*, int*));
+};
+
+// The width of each '.', which is 46.
+const int kDotWidth = 7;
+
+}  // namespace
+
+TEST(GlyphRunCacheTest, LaysOutText) {
+  testing::StrictMock<MockMeasurer> measurer;
+  GlyphRunCache cache(&measurer);
+
+  EXPECT_CALL(measurer,
+      GetGlyphs(0, GlyphRunCache::kCharsPerPage, _, _)).Times(1);
+  GlyphRun run;
+  // '0' is 48, and 'A' is 65.
+  ASSERT_TRUE(cache.Layout(L"0A", 100, &run));
+  ASSERT_EQ(2U, run.glyphs.size());
+  EXPECT_EQ(1048, run.glyphs[0]);
+  EXPECT_EQ(1065, run.glyphs[1]);
+  ASSERT_EQ(2U, run.advances.size());
+  EXPECT_EQ(9, run.advances[0]);
+  EXPECT_EQ(6, run.advances[1]);
+  EXPECT_EQ(15, run.width);
+
+  // Exactly fitting text isn't truncated.
+  ASSERT_TRUE(cache.Layout(L"0A", 15, &run));
+  EXPECT_EQ(2U, run.glyphs.size());
+
+  ASSERT_TRUE(cache.Layout(L"", 0, &run));
+  EXPECT_TRUE(run.glyphs.empty());
+  EXPECT_EQ(0, run.width);
+
+  // A character on another page measures that page.
+  EXPECT_CALL(measurer,
+      GetGlyphs(0x4E00, GlyphRunCache::kCharsPerPage, _, _)).Times(1);
+  ASSERT_TRUE(cache.Layout(L"\x4E00", 100, &run));
+  EXPECT_EQ(0x4E00 + 1000, run.glyphs[0]);
+  ASSERT_TRUE(cache.Layout(L"\x4E00\x4E01", 100, &run));
+  EXPECT_EQ(2U, run.glyphs.size());
+}
+
+TEST(GlyphRunCacheTest, TruncatesWithEllipsis) {
+  testing::NiceMock<MockMeasurer> measurer;
+  GlyphRunCache cache(&measurer);
+
+  // "00000" is 45 wide, and each dot 7, so two zeros fit beside the
+  // ellipsis.
+  GlyphRun run;
+  ASSERT_TRUE(cache.Layout(L"00000", 40, &run));
+  ASSERT_EQ(2U + 3, run.glyphs.size());
+  EXPECT_EQ(1048, run.glyphs[0]);
+  EXPECT_EQ(1048, run.glyphs[1]);
+  EXPECT_EQ(1046, run.glyphs[2]);
+  EXPECT_EQ(1046, run.glyphs[4]);
+  EXPECT_EQ(kDotWidth, run.advances[4]);
+  EXPECT_EQ(18 + 3 * kDotWidth, run.width);
+  EXPECT_EQ(run.glyphs.size(), run.advances.size());
+
+  // When the ellipsis alone overflows, it's all that's left, to be
+  // clipped.
+  ASSERT_TRUE(cache.Layout(L"000", 10, &run));
+  ASSERT_EQ(3U, run.glyphs.size());
+  EXPECT_EQ(1046, run.glyphs[0]);
+  EXPECT_EQ(3 * kDotWidth, run.width);
+}
+
+TEST(GlyphRunCacheTest, MissingGlyphs) {
+  testing::NiceMock<MockMeasurer> measurer;
+  GlyphRunCache cache(&measurer);
+
+  GlyphRun run;
+  EXPECT_FALSE(cache.Layout(L"0x0", 100, &run));
+  // Surrogates are left to GDI.
+  EXPECT_FALSE(cache.Layout(L"0\xD83D\xDE00", 100, &run));
+}
+
+TEST(GlyphRunCacheTest, MeasureFailure) {
+  testing::StrictMock<MockMeasurer> measurer;
+  GlyphRunCache cache(&measurer);
+
+  // A page that fails to measure isn't measured again, and its text is
+  // left to GDI.
+  EXPECT_CALL(measurer, GetGlyphs(0, _, _, _)).WillOnce(Return(false));
+  GlyphRun run;
+  EXPECT_FALSE(cache.Layout(L"abc", 100, &run));
+  EXPECT_FALSE(cache.Layout(L"abc", 100, &run));
+}
@@ -0,0 +1,56 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Go To Time dialog implementation.
+#include "sawbuck/viewer/go_to_time_dialog.h"
+
+#include "base/strings/string_util.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/win/scoped_bstr.h"
+
+GoToTimeDialog::GoToTimeDialog(const std::string& time) : time_(time) {
+}
+
+GoToTimeDialog::~GoToTimeDialog() {
+}
+
+LRESULT GoToTimeDialog::OnInitDialog(CWindow focus_window,
+                                     LPARAM init_param) {
+  CWindow text_wnd(GetDlgItem(IDC_GOTO_TIME));
+  text_wnd.SetFocus();
+  if (!time_.empty()) {
+    text_wnd.SetWindowText(base::UTF8ToWide(time_).c_str());
+    text_wnd.SendMessage(EM_SETSEL, 0, -1);
+  }
+  return FALSE;
+}
+
+LRESULT GoToTimeDialog::OnOk(UINT notify_code, int id, CWindow window) {
+  CWindow text_wnd(GetDlgItem(IDC_GOTO_TIME));
+  base::win::ScopedBstr text;
+  text_wnd.GetWindowText(text.Receive());
+  if (text.Length()) {
+    base::WideToUTF8(text, text.Length(), &time_);
+    base::TrimWhitespaceASCII(time_, base::TRIM_ALL, &time_);
+    EndDialog(IDOK);
+  } else {
+    text_wnd.SetFocus();
+  }
+  return 0;
+}
+
+LRESULT GoToTimeDialog::OnCancel(UINT notify_code, int id, CWindow window) {
+  EndDialog(IDCANCEL);
+  return 0;
+}
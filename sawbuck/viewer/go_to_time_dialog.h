@@ -0,0 +1,51 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Go To Time dialog declaration.
+#ifndef SAWBUCK_VIEWER_GO_TO_TIME_DIALOG_H_
+#define SAWBUCK_VIEWER_GO_TO_TIME_DIALOG_H_
+
+#include <atlbase.h>
+#include <atlcrack.h>
+#include <atlwin.h>
+#include <string>
+#include "resource.h"
+
+// Asks for a time stamp to go to, as the time column shows them.
+class GoToTimeDialog : public CDialogImpl<GoToTimeDialog> {
+ public:
+  enum { IDD = IDD_GOTOTIMEDIALOG };
+
+  BEGIN_MSG_MAP(GoToTimeDialog)
+    MSG_WM_INITDIALOG(OnInitDialog)
+    COMMAND_ID_HANDLER_EX(IDOK, OnOk)
+    COMMAND_ID_HANDLER_EX(IDCANCEL, OnCancel)
+  END_MSG_MAP()
+
+  // @param time the time stamp the dialog starts out with, UTF8 encoded.
+  explicit GoToTimeDialog(const std::string& time);
+  ~GoToTimeDialog();
+
+  LRESULT OnInitDialog(CWindow focus_window, LPARAM init_param);
+  LRESULT OnOk(UINT notify_code, int id, CWindow window);
+  LRESULT OnCancel(UINT notify_code, int id, CWindow window);
+
+  // The time stamp entered, UTF8 encoded.
+  const std::string& time() const { return time_; }
+
+ protected:
+  std::string time_;
+};
+
+#endif  // SAWBUCK_VIEWER_GO_TO_TIME_DIALOG_H_
@@ -0,0 +1,71 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Import scope dialog implementation.
+#include "sawbuck/viewer/import_scope_dialog.h"
+
+#include "base/strings/string_util.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/win/scoped_bstr.h"
+
+ImportScopeDialog::ImportScopeDialog(const std::string& begin,
+                                     const std::string& duration,
+                                     const std::string& process_ids)
+    : begin_(begin), duration_(duration), process_ids_(process_ids) {
+}
+
+ImportScopeDialog::~ImportScopeDialog() {
+}
+
+LRESULT ImportScopeDialog::OnInitDialog(CWindow focus_window,
+                                        LPARAM init_param) {
+  SetItemText(IDC_IMPORT_BEGIN, begin_);
+  SetItemText(IDC_IMPORT_DURATION, duration_);
+  SetItemText(IDC_IMPORT_PROCESSES, process_ids_);
+
+  CWindow begin_wnd(GetDlgItem(IDC_IMPORT_BEGIN));
+  begin_wnd.SetFocus();
+  begin_wnd.SendMessage(EM_SETSEL, 0, -1);
+  return FALSE;
+}
+
+LRESULT ImportScopeDialog::OnOk(UINT notify_code, int id, CWindow window) {
+  begin_ = GetItemText(IDC_IMPORT_BEGIN);
+  duration_ = GetItemText(IDC_IMPORT_DURATION);
+  process_ids_ = GetItemText(IDC_IMPORT_PROCESSES);
+  EndDialog(IDOK);
+  return 0;
+}
+
+LRESULT ImportScopeDialog::OnCancel(UINT notify_code, int id,
+                                    CWindow window) {
+  EndDialog(IDCANCEL);
+  return 0;
+}
+
+void ImportScopeDialog::SetItemText(int id, const std::string& text) {
+  CWindow text_wnd(GetDlgItem(id));
+  text_wnd.SetWindowText(base::UTF8ToWide(text).c_str());
+}
+
+std::string ImportScopeDialog::GetItemText(int id) {
+  CWindow text_wnd(GetDlgItem(id));
+  base::win::ScopedBstr text;
+  text_wnd.GetWindowText(text.Receive());
+
+  std::string result;
+  base::WideToUTF8(text, text.Length(), &result);
+  base::TrimWhitespaceASCII(result, base::TRIM_ALL, &result);
+  return result;
+}
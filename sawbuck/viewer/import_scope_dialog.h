@@ -0,0 +1,62 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Import scope dialog declaration.
+#ifndef SAWBUCK_VIEWER_IMPORT_SCOPE_DIALOG_H_
+#define SAWBUCK_VIEWER_IMPORT_SCOPE_DIALOG_H_
+
+#include <atlbase.h>
+#include <atlcrack.h>
+#include <atlwin.h>
+#include <string>
+#include "resource.h"
+
+// Asks for the stretch of time and the processes to import of a log, as
+// LogImporter::ParseScope parses them.
+class ImportScopeDialog : public CDialogImpl<ImportScopeDialog> {
+ public:
+  enum { IDD = IDD_IMPORTSCOPEDIALOG };
+
+  BEGIN_MSG_MAP(ImportScopeDialog)
+    MSG_WM_INITDIALOG(OnInitDialog)
+    COMMAND_ID_HANDLER_EX(IDOK, OnOk)
+    COMMAND_ID_HANDLER_EX(IDCANCEL, OnCancel)
+  END_MSG_MAP()
+
+  // The dialog starts out with @p begin, @p duration and @p process_ids.
+  ImportScopeDialog(const std::string& begin,
+                    const std::string& duration,
+                    const std::string& process_ids);
+  ~ImportScopeDialog();
+
+  LRESULT OnInitDialog(CWindow focus_window, LPARAM init_param);
+  LRESULT OnOk(UINT notify_code, int id, CWindow window);
+  LRESULT OnCancel(UINT notify_code, int id, CWindow window);
+
+  // What was entered, trimmed of whitespace.
+  const std::string& begin() const { return begin_; }
+  const std::string& duration() const { return duration_; }
+  const std::string& process_ids() const { return process_ids_; }
+
+ protected:
+  // Sets the text of the control @p id to @p text, or gets it.
+  void SetItemText(int id, const std::string& text);
+  std::string GetItemText(int id);
+
+  std::string begin_;
+  std::string duration_;
+  std::string process_ids_;
+};
+
+#endif  // SAWBUCK_VIEWER_IMPORT_SCOPE_DIALOG_H_
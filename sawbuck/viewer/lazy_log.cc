@@ -0,0 +1,276 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Lazily materialized log implementation.
+#include "sawbuck/viewer/lazy_log.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include "base/debug/trace_event_win.h"
+#include "base/logging.h"
+#include "base/logging_win.h"
+#include "sawbuck/log_lib/log_consumer.h"
+#include "sawbuck/viewer/log_store.h"
+
+namespace {
+
+int64 GetEventTime(const EVENT_TRACE* event) {
+  return base::Time::FromFileTime(
+      reinterpret_cast<const FILETIME&>(event->Header.TimeStamp))
+          .ToInternalValue();
+}
+
+}  // namespace
+
+LazyLogFile::LazyLogFile() {
+}
+
+LazyLogFile::~LazyLogFile() {
+}
+
+HRESULT LazyLogFile::Open(const base::FilePath& path) {
+  return reader_.Open(path);
+}
+
+bool LazyLogFile::IsRowEvent(const EVENT_TRACE* event) {
+  DCHECK(event != NULL);
+
+  const EVENT_TRACE_HEADER& header = event->Header;
+  if (header.Guid == logging::kLogEventId)
+    return true;
+
+  if (header.Guid == base::debug::kTraceEventClass32 ||
+      header.Guid == base::debug::kTraceEventClass64) {
+    switch (header.Class.Type) {
+      case base::debug::kTraceEventTypeBegin:
+      case base::debug::kTraceEventTypeEnd:
+      case base::debug::kTraceEventTypeInstant:
+        return true;
+    }
+  }
+
+  return false;
+}
+
+void LazyLogFile::AddRow(const EVENT_TRACE* event,
+                         const EtlFileReader::EventPosition& position) {
+  DCHECK(IsRowEvent(event));
+
+  Row row = {};
+  row.time = GetEventTime(event);
+  row.process_id = event->Header.ProcessId;
+  row.thread_id = event->Header.ThreadId;
+  row.level = event->Header.Class.Level;
+  row.position = position;
+  DCHECK(rows_.empty() || rows_.back().time <= row.time);
+  rows_.push_back(row);
+}
+
+// Decodes the row of the event read, as the import would have.
+class LazyLog::RowDecoder
+    : public EtlEventSink,
+      public LogEvents,
+      public TraceEvents {
+ public:
+  RowDecoder(StringTable* file_table, DecodedRow* decoded)
+      : file_table_(file_table), decoded_(decoded) {
+    parser_.set_event_sink(this);
+    parser_.set_trace_sink(this);
+    parser_.set_string_table(file_table);
+  }
+
+  // EtlEventSink implementation.
+  virtual void OnEvent(EVENT_TRACE* event) {
+    parser_.ProcessOneEvent(event);
+  }
+
+  // LogEvents implementation.
+  virtual void OnLogMessage(const LogEvents::LogMessage& log_message) {
+    base::StringPiece message;
+    ParseLogMessage(log_message, file_table_, &decoded_->file,
+                    &decoded_->line, &message);
+    message.CopyToString(&decoded_->message);
+    SetTrace(log_message);
+  }
+
+  // TraceEvents implementation.
+  virtual void OnTraceEventBegin(
+      const TraceEvents::TraceMessage& trace_message) {
+    SetTraceMessage("BEGIN", trace_message);
+  }
+  virtual void OnTraceEventEnd(
+      const TraceEvents::TraceMessage& trace_message) {
+    SetTraceMessage("END", trace_message);
+  }
+  virtual void OnTraceEventInstant(
+      const TraceEvents::TraceMessage& trace_message) {
+    SetTraceMessage("INSTANT", trace_message);
+  }
+
+ private:
+  void SetTraceMessage(const char* type,
+                       const TraceEvents::TraceMessage& trace_message) {
+    decoded_->message = FormatTraceMessage(type, trace_message);
+    SetTrace(trace_message);
+  }
+
+  void SetTrace(const LogMessageBase& message) {
+    decoded_->trace.resize(message.trace_depth);
+    for (size_t i = 0; i < message.trace_depth; ++i)
+      decoded_->trace[i] = reinterpret_cast<uintptr_t>(message.traces[i]);
+  }
+
+  LogParser parser_;
+  StringTable* file_table_;
+  DecodedRow* decoded_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowDecoder);
+};
+
+const size_t LazyLog::kCachedRows;
+
+LazyLog::LazyLog(StringTable* file_table)
+    : file_table_(file_table), cache_(kCachedRows) {
+  DCHECK(file_table != NULL);
+}
+
+LazyLog::~LazyLog() {
+}
+
+void LazyLog::MergeFrom(ScopedVector<LazyLogFile>* files) {
+  DCHECK(files != NULL);
+  DCHECK(files_.empty());
+
+  // A min-heap of the next row time of each file, ties go to the lower
+  // file index.
+  typedef std::pair<int64, size_t> Entry;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > heap;
+  std::vector<size_t> next_rows(files->size(), 0);
+
+  size_t total_rows = 0;
+  for (size_t i = 0; i < files->size(); ++i) {
+    const LazyLogFile* file = (*files)[i];
+    if (!file->rows_.empty())
+      heap.push(Entry(file->rows_[0].time, i));
+    total_rows += file->rows_.size();
+  }
+  rows_.reserve(total_rows);
+
+  while (!heap.empty()) {
+    size_t source = heap.top().second;
+    heap.pop();
+
+    LazyLogFile* file = (*files)[source];
+    size_t row = next_rows[source]++;
+    rows_.push_back(file->rows_[row]);
+    rows_.back().file = static_cast<uint32>(source);
+
+    if (row + 1 < file->rows_.size())
+      heap.push(Entry(file->rows_[row + 1].time, source));
+  }
+
+  // The merged rows hold all we need of the files' rows.
+  for (size_t i = 0; i < files->size(); ++i) {
+    std::vector<LazyLogFile::Row>().swap((*files)[i]->rows_);
+    files_.push_back((*files)[i]);
+  }
+  files->weak_clear();
+}
+
+UCHAR LazyLog::GetSeverity(int row) const {
+  return rows_[row].level;
+}
+
+DWORD LazyLog::GetProcessId(int row) const {
+  return rows_[row].process_id;
+}
+
+DWORD LazyLog::GetThreadId(int row) const {
+  return rows_[row].thread_id;
+}
+
+base::Time LazyLog::GetTime(int row) const {
+  return base::Time::FromInternalValue(rows_[row].time);
+}
+
+StringTable::Atom LazyLog::GetFileAtom(int row) const {
+  DecodedRow decoded;
+  GetDecodedRow(row, &decoded);
+  return decoded.file;
+}
+
+int LazyLog::GetLine(int row) const {
+  DecodedRow decoded;
+  GetDecodedRow(row, &decoded);
+  return decoded.line;
+}
+
+void LazyLog::GetMessage(int row, std::string* message) const {
+  DCHECK(message != NULL);
+
+  DecodedRow decoded;
+  GetDecodedRow(row, &decoded);
+  message->swap(decoded.message);
+}
+
+void LazyLog::GetStackTrace(int row,
+                            std::vector<sym_util::Address>* trace) const {
+  DCHECK(trace != NULL);
+
+  DecodedRow decoded;
+  GetDecodedRow(row, &decoded);
+  trace->swap(decoded.trace);
+}
+
+int LazyLog::FindRowForTime(const base::Time& time) const {
+  int64 value = time.ToInternalValue();
+  int low = 0;
+  int high = num_rows();
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (rows_[mid].time < value)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return low;
+}
+
+void LazyLog::GetDecodedRow(int row, DecodedRow* decoded) const {
+  DCHECK_GE(row, 0);
+  DCHECK_LT(row, num_rows());
+  DCHECK(decoded != NULL);
+
+  size_t slot = row % kCachedRows;
+  {
+    base::AutoLock lock(cache_lock_);
+    if (cache_[slot].row == row) {
+      *decoded = cache_[slot];
+      return;
+    }
+  }
+
+  // Decode outside the lock, so readers on other threads don't wait on us.
+  // An event that fails to decode makes an empty row.
+  const LazyLogFile::Row& info = rows_[row];
+  RowDecoder decoder(file_table_, decoded);
+  if (!files_[info.file]->reader()->ReadEvent(info.position, &decoder))
+    LOG(ERROR) << "Failed to read the event of row " << row << ".";
+  decoded->row = row;
+
+  base::AutoLock lock(cache_lock_);
+  cache_[slot] = *decoded;
+}
@@ -0,0 +1,147 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Lazily materialized log declaration.
+#ifndef SAWBUCK_VIEWER_LAZY_LOG_H_
+#define SAWBUCK_VIEWER_LAZY_LOG_H_
+
+#include <windows.h>
+#include <evntrace.h>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/memory/scoped_vector.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "sawbuck/log_lib/etl_file_reader.h"
+#include "sawbuck/log_lib/string_table.h"
+#include "sawbuck/sym_util/types.h"
+
+// The rows of a log file, indexed by the position of their events in the
+// mapped file, along with the fields that come with the event headers: the
+// time, level, process and thread. Indexing a file this way skips decoding
+// the event payloads, which LazyLog defers until the rows are read.
+class LazyLogFile {
+ public:
+  LazyLogFile();
+  ~LazyLogFile();
+
+  // Maps the log file at @p path.
+  // @returns S_OK on success, an error code otherwise.
+  HRESULT Open(const base::FilePath& path);
+
+  // @returns true iff @p event is a log message or trace event, which
+  //     makes a row.
+  static bool IsRowEvent(const EVENT_TRACE* event);
+
+  // Appends a row for @p event, which is at @p position in our file. The
+  // rows must be added in time order.
+  // @pre IsRowEvent(event).
+  void AddRow(const EVENT_TRACE* event,
+              const EtlFileReader::EventPosition& position);
+
+  // @returns the reader of our file, valid once open.
+  EtlFileReader* reader() { return &reader_; }
+
+  size_t num_rows() const { return rows_.size(); }
+
+ private:
+  friend class LazyLog;
+
+  struct Row {
+    int64 time;
+    DWORD process_id;
+    DWORD thread_id;
+    UCHAR level;
+    // The index of the row's file in its LazyLog, once merged into one.
+    uint32 file;
+    EtlFileReader::EventPosition position;
+  };
+
+  EtlFileReader reader_;
+  std::vector<Row> rows_;
+
+  DISALLOW_COPY_AND_ASSIGN(LazyLogFile);
+};
+
+// A log whose rows are materialized lazily from the log files they were
+// indexed from. The files stay mapped, and the file, line, message and
+// stack trace of a row are decoded from its event when it's read, into a
+// cache of the rows read last. Compared to a LogStore, this saves decoding
+// the events up front, and holds a few dozen bytes per row in memory, at
+// the cost of decoding the rows again as searches and filters go over them.
+// @note the rows may be read from several threads at once.
+class LazyLog {
+ public:
+  // @param file_table the table file names are interned to, must outlive
+  //     this log.
+  explicit LazyLog(StringTable* file_table);
+  ~LazyLog();
+
+  // Takes the rows of @p files, merged by time, and the files with them.
+  // Rows of equal time are taken in the order of their files. This is
+  // called once, on a new log.
+  void MergeFrom(ScopedVector<LazyLogFile>* files);
+
+  int num_rows() const { return static_cast<int>(rows_.size()); }
+
+  // Row accessors, @p row must be in [0, num_rows()).
+  // @{
+  UCHAR GetSeverity(int row) const;
+  DWORD GetProcessId(int row) const;
+  DWORD GetThreadId(int row) const;
+  base::Time GetTime(int row) const;
+  StringTable::Atom GetFileAtom(int row) const;
+  int GetLine(int row) const;
+  void GetMessage(int row, std::string* message) const;
+  void GetStackTrace(int row, std::vector<sym_util::Address>* trace) const;
+  // @}
+
+  // @returns the first row no earlier than @p time, or num_rows() if
+  //     there's none.
+  int FindRowForTime(const base::Time& time) const;
+
+  // The number of decoded rows cached, which are cached by row number, so
+  // rows this far apart evict each other.
+  static const size_t kCachedRows = 4096;
+
+ private:
+  struct DecodedRow {
+    DecodedRow() : row(-1), file(StringTable::kEmptyAtom), line(0) {
+    }
+
+    int row;
+    StringTable::Atom file;
+    int line;
+    std::string message;
+    std::vector<sym_util::Address> trace;
+  };
+  class RowDecoder;
+
+  // Copies @p row decoded to @p decoded, decoding it if it's not cached.
+  void GetDecodedRow(int row, DecodedRow* decoded) const;
+
+  StringTable* file_table_;
+  ScopedVector<LazyLogFile> files_;
+  std::vector<LazyLogFile::Row> rows_;
+
+  // Guards cache_, which readers may fill from several threads.
+  mutable base::Lock cache_lock_;
+  mutable std::vector<DecodedRow> cache_;  // Under cache_lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(LazyLog);
+};
+
+#endif  // SAWBUCK_VIEWER_LAZY_LOG_H_
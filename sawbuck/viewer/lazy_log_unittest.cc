@@ -0,0 +1,170 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/log_store.h"
+// Lazily materialized log unittests.
+#include "sawbuck/viewer/lazy_log.h"
+
+#include "base/debug/trace_event_win.h"
+#include "base/logging_win.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// {5C5DD2DC-5E3B-4C46-8E8B-7C7F8C3F2A1E}
+const GUID kOtherEventClass = { 0x5c5dd2dc, 0x5e3b, 0x4c46,
+    { 0x8e, 0x8b, 0x7c, 0x7f, 0x8c, 0x3f, 0x2a, 0x1e } };
+
+base::Time TimeAt(int64 seconds) {
+  return base::Time::FromInternalValue(
+      base::Time::kMicrosecondsPerSecond * seconds);
+}
+
+EVENT_TRACE MakeEvent(const GUID& guid,
+                      UCHAR type,
+                      UCHAR level,
+                      const base::Time& time) {
+  EVENT_TRACE event = {};
+  event.Header.Guid = guid;
+  event.Header.Class.Type = type;
+  event.Header.Class.Level = level;
+  event.Header.ProcessId = 10;
+  event.Header.ThreadId = 20;
+
+  FILETIME file_time = time.ToFileTime();
+  event.Header.TimeStamp.LowPart = file_time.dwLowDateTime;
+  event.Header.TimeStamp.HighPart = file_time.dwHighDateTime;
+
+  return event;
+}
+
+EVENT_TRACE MakeLogEvent(const base::Time& time) {
+  return MakeEvent(logging::kLogEventId, logging::LOG_MESSAGE,
+                   TRACE_LEVEL_INFORMATION, time);
+}
+
+EtlFileReader::EventPosition MakePosition(uint32 buffer, uint32 offset) {
+  EtlFileReader::EventPosition position;
+  position.buffer = buffer;
+  position.offset = offset;
+  return position;
+}
+
+TEST(LazyLogFileTest, IsRowEvent) {
+  base::Time now = TimeAt(1);
+
+  EVENT_TRACE log = MakeLogEvent(now);
+  EXPECT_TRUE(LazyLogFile::IsRowEvent(&log));
+
+  EVENT_TRACE begin = MakeEvent(base::debug::kTraceEventClass32,
+                                base::debug::kTraceEventTypeBegin,
+                                TRACE_LEVEL_INFORMATION, now);
+  EXPECT_TRUE(LazyLogFile::IsRowEvent(&begin));
+
+  EVENT_TRACE instant = MakeEvent(base::debug::kTraceEventClass64,
+                                  base::debug::kTraceEventTypeInstant,
+                                  TRACE_LEVEL_INFORMATION, now);
+  EXPECT_TRUE(LazyLogFile::IsRowEvent(&instant));
+
+  // Trace events of other types, and events of other classes, make no row.
+  EVENT_TRACE other_type = MakeEvent(base::debug::kTraceEventClass32,
+                                     EVENT_TRACE_TYPE_INFO,
+                                     TRACE_LEVEL_INFORMATION, now);
+  EXPECT_FALSE(LazyLogFile::IsRowEvent(&other_type));
+
+  EVENT_TRACE other_class = MakeEvent(kOtherEventClass,
+                                      base::debug::kTraceEventTypeBegin,
+                                      TRACE_LEVEL_INFORMATION, now);
+  EXPECT_FALSE(LazyLogFile::IsRowEvent(&other_class));
+}
+
+TEST(LazyLogTest, MergeFromInterleavesByTime) {
+  ScopedVector<LazyLogFile> files;
+  files.push_back(new LazyLogFile);
+  files.push_back(new LazyLogFile);
+
+  EVENT_TRACE event = MakeLogEvent(TimeAt(1));
+  files[0]->AddRow(&event, MakePosition(0, 0));
+  event = MakeLogEvent(TimeAt(3));
+  event.Header.Class.Level = TRACE_LEVEL_ERROR;
+  files[0]->AddRow(&event, MakePosition(0, 100));
+
+  event = MakeLogEvent(TimeAt(2));
+  event.Header.ProcessId = 11;
+  files[1]->AddRow(&event, MakePosition(1, 0));
+  // Ties go to the earlier file.
+  event = MakeLogEvent(TimeAt(3));
+  event.Header.ThreadId = 21;
+  files[1]->AddRow(&event, MakePosition(1, 100));
+
+  StringTable file_table;
+  LazyLog log(&file_table);
+  log.MergeFrom(&files);
+  EXPECT_TRUE(files.empty());
+
+  ASSERT_EQ(4, log.num_rows());
+  EXPECT_EQ(TimeAt(1), log.GetTime(0));
+  EXPECT_EQ(TimeAt(2), log.GetTime(1));
+  EXPECT_EQ(11U, log.GetProcessId(1));
+  EXPECT_EQ(TimeAt(3), log.GetTime(2));
+  EXPECT_EQ(TRACE_LEVEL_ERROR, log.GetSeverity(2));
+  EXPECT_EQ(20U, log.GetThreadId(2));
+  EXPECT_EQ(TimeAt(3), log.GetTime(3));
+  EXPECT_EQ(21U, log.GetThreadId(3));
+}
+
+TEST(LazyLogTest, FindRowForTime) {
+  ScopedVector<LazyLogFile> files;
+  files.push_back(new LazyLogFile);
+  for (int i = 0; i < 5; ++i) {
+    EVENT_TRACE event = MakeLogEvent(TimeAt(2 * i));
+    files[0]->AddRow(&event, MakePosition(0, 100 * i));
+  }
+
+  StringTable file_table;
+  LazyLog log(&file_table);
+  log.MergeFrom(&files);
+
+  EXPECT_EQ(0, log.FindRowForTime(TimeAt(0)));
+  EXPECT_EQ(1, log.FindRowForTime(TimeAt(1)));
+  EXPECT_EQ(1, log.FindRowForTime(TimeAt(2)));
+  EXPECT_EQ(4, log.FindRowForTime(TimeAt(8)));
+  EXPECT_EQ(5, log.FindRowForTime(TimeAt(9)));
+}
+
+TEST(LazyLogTest, UnreadableRowsDecodeEmpty) {
+  // The file is never opened, so its events can't be read.
+  ScopedVector<LazyLogFile> files;
+  files.push_back(new LazyLogFile);
+  EVENT_TRACE event = MakeLogEvent(TimeAt(1));
+  files[0]->AddRow(&event, MakePosition(0, 0));
+
+  StringTable file_table;
+  LazyLog log(&file_table);
+  log.MergeFrom(&files);
+
+  ASSERT_EQ(1, log.num_rows());
+  EXPECT_EQ(TimeAt(1), log.GetTime(0));
+  EXPECT_EQ(StringTable::kEmptyAtom, log.GetFileAtom(0));
+  EXPECT_EQ(0, log.GetLine(0));
+
+  std::string message("stale");
+  log.GetMessage(0, &message);
+  EXPECT_EQ("", message);
+
+  std::vector<sym_util::Address> trace(1, 0x1000);
+  log.GetStackTrace(0, &trace);
+  EXPECT_TRUE(trace.empty());
+}
+
+}  // namespace
@@ -0,0 +1,313 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log aggregator implementation.
+#include "sawbuck/viewer/log_aggregator.h"
+
+#include <algorithm>
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "sawbuck/common/perf_counters.h"
+#include "sawbuck/common/task_pool.h"
+#include "sawbuck/viewer/message_templates.h"
+#include "sawbuck/viewer/row_batch.h"
+
+namespace {
+
+PerfCounter aggregate_chunk_counter("Aggregate.Chunk", 1);
+PerfCounter aggregate_range_counter("Aggregate.Range", 1);
+
+// No more threads than this tally a chunk.
+const size_t kMaxAggregateThreads = 8;
+// A chunk holds at most this many rows per tallying thread.
+const int kMaxRowsPerThread = 4000;
+// A row costs a key build and a map lookup, so a thread needs this many
+// rows to earn back posting its range and merging its group map.
+const int kMinRowsPerThread = 1000;
+
+// Returns the columns that key the groups of @p group_by.
+uint32 GetKeyColumns(LogAggregator::GroupBy group_by) {
+  switch (group_by) {
+    case LogAggregator::GROUP_BY_LOCATION:
+      return RowBatch::FILE_ATOM | RowBatch::LINE;
+    case LogAggregator::GROUP_BY_PROCESS:
+      return RowBatch::PROCESS_ID;
+    case LogAggregator::GROUP_BY_THREAD:
+      return RowBatch::PROCESS_ID | RowBatch::THREAD_ID;
+    case LogAggregator::GROUP_BY_STACK:
+      return RowBatch::STACK_ID;
+    default:
+      return 0;
+  }
+}
+
+// Returns the name of the group of @p row, keyed by @p key.
+std::string GetGroupName(ILogView* view, LogAggregator::GroupBy group_by,
+                         int row, const std::string& key_text) {
+  switch (group_by) {
+    case LogAggregator::GROUP_BY_LOCATION: {
+      std::string buffer;
+      return base::StringPrintf(
+          "%s(%d)", view->GetFileNamePiece(row, &buffer).as_string().c_str(),
+          view->GetLine(row));
+    }
+
+    case LogAggregator::GROUP_BY_PROCESS:
+      return base::StringPrintf("Process %d", view->GetProcessId(row));
+
+    case LogAggregator::GROUP_BY_THREAD:
+      return base::StringPrintf("Process %d, thread %d",
+                                view->GetProcessId(row),
+                                view->GetThreadId(row));
+
+    case LogAggregator::GROUP_BY_STACK: {
+      StackTracePool::StackId id = view->GetStackTraceId(row);
+      if (id == StackTracePool::kUnknownStack)
+        return "Unknown stack";
+      std::vector<sym_util::Address> buffer;
+      const sym_util::Address* trace = NULL;
+      size_t depth = view->GetStackTracePiece(row, &trace, &buffer);
+      if (depth == 0)
+        return "No stack";
+      return base::StringPrintf("Stack %u, %u frames from 0x%llX", id,
+                                static_cast<unsigned>(depth), trace[0]);
+    }
+
+    case LogAggregator::GROUP_BY_MESSAGE:
+      return key_text;
+
+    default:
+      NOTREACHED();
+      return std::string();
+  }
+}
+
+bool MoreFrequent(const LogAggregator::Group& a,
+                  const LogAggregator::Group& b) {
+  if (a.count != b.count)
+    return a.count > b.count;
+  return a.first_row < b.first_row;
+}
+
+}  // namespace
+
+LogAggregator::LogAggregator(ILogView* view, GroupBy group_by)
+    : view_(view), registration_cookie_(0), group_by_(group_by),
+      aggregated_rows_(0),
+      max_threads_(std::min(TaskPool::Get()->num_workers() + 1,
+                            kMaxAggregateThreads)) {
+  DCHECK(view_ != NULL);
+  view_->Register(this, &registration_cookie_);
+  aggregated_rows_ = view_->GetFirstRow();
+  PostAggregationTask();
+}
+
+LogAggregator::~LogAggregator() {
+  // Make sure we're not pinged post-destruction.
+  if (!task_.IsCancelled())
+    task_.Cancel();
+
+  view_->Unregister(registration_cookie_);
+}
+
+void LogAggregator::LogViewNewItems() {
+  PostAggregationTask();
+}
+
+void LogAggregator::LogViewCleared() {
+  groups_.clear();
+  total_ = Group();
+  aggregated_rows_ = view_->GetFirstRow();
+  PostAggregationTask();
+}
+
+void LogAggregator::LogViewEvicted(int first_row) {
+  // The evicted rows we've tallied stay counted, those we haven't are lost.
+  aggregated_rows_ = std::max(aggregated_rows_, first_row);
+}
+
+void LogAggregator::AggregateAll() {
+  while (!IsDone())
+    AggregateChunk();
+  task_.Cancel();
+}
+
+bool LogAggregator::IsDone() {
+  return aggregated_rows_ >= view_->GetNumRows();
+}
+
+void LogAggregator::GetGroups(std::vector<Group>* groups) const {
+  DCHECK(groups != NULL);
+  groups->clear();
+  groups->reserve(groups_.size());
+  GroupMap::const_iterator it(groups_.begin());
+  for (; it != groups_.end(); ++it)
+    groups->push_back(it->second);
+  std::sort(groups->begin(), groups->end(), MoreFrequent);
+}
+
+void LogAggregator::MaskMessage(const base::StringPiece& message,
+                                std::string* masked) {
+  DCHECK(masked != NULL);
+  MessageTemplates::Split(message, '#', masked, NULL);
+}
+
+void LogAggregator::AggregateRange(ILogView* view, GroupBy group_by,
+                                   int begin, int end,
+                                   GroupMap* groups, Group* total) {
+  DCHECK(view != NULL);
+  DCHECK(groups != NULL);
+  DCHECK(total != NULL);
+
+  if (begin >= end)
+    return;
+
+  // The range is read a column at a time, rather than a cell at a time.
+  RowBatch batch;
+  view->GetRows(begin, end - begin,
+                RowBatch::MESSAGE | RowBatch::SEVERITY | RowBatch::TIME |
+                    RowBatch::REPEATS | GetKeyColumns(group_by),
+                &batch);
+
+  GroupKey key;
+  for (int row = begin; row < end; ++row) {
+    int i = row - begin;
+    const base::StringPiece& message = batch.messages[i];
+    switch (group_by) {
+      case GROUP_BY_LOCATION:
+        key.id = (static_cast<uint64>(batch.file_atoms[i]) << 32) |
+            static_cast<uint32>(batch.lines[i]);
+        break;
+      case GROUP_BY_PROCESS:
+        key.id = batch.process_ids[i];
+        break;
+      case GROUP_BY_THREAD:
+        key.id = (static_cast<uint64>(batch.process_ids[i]) << 32) |
+            batch.thread_ids[i];
+        break;
+      case GROUP_BY_STACK:
+        key.id = batch.stack_ids[i];
+        break;
+      case GROUP_BY_MESSAGE:
+        MaskMessage(message, &key.text);
+        break;
+      default:
+        NOTREACHED();
+        break;
+    }
+
+    Group occurrences;
+    occurrences.count = batch.repeat_counts[i];
+    occurrences.bytes = occurrences.count * message.size();
+    int severity = batch.severities[i];
+    if (severity != TRACE_LEVEL_NONE && severity <= TRACE_LEVEL_ERROR)
+      occurrences.errors = occurrences.count;
+    occurrences.first_time = batch.times[i];
+    occurrences.last_time = batch.last_times[i];
+    occurrences.first_row = row;
+    MergeGroup(occurrences, total);
+
+    GroupMap::iterator it(groups->find(key));
+    if (it == groups->end()) {
+      occurrences.name = GetGroupName(view, group_by, row, key.text);
+      groups->insert(std::make_pair(key, occurrences));
+    } else {
+      MergeGroup(occurrences, &it->second);
+    }
+  }
+}
+
+void LogAggregator::MergeGroup(const Group& from, Group* into) {
+  DCHECK(into != NULL);
+  if (from.count == 0)
+    return;
+  if (into->count == 0) {
+    *into = from;
+    return;
+  }
+
+  into->count += from.count;
+  into->bytes += from.bytes;
+  into->errors += from.errors;
+  into->first_time = std::min(into->first_time, from.first_time);
+  into->last_time = std::max(into->last_time, from.last_time);
+}
+
+void LogAggregator::MergeGroups(const GroupMap& from, GroupMap* into) {
+  DCHECK(into != NULL);
+  GroupMap::const_iterator it(from.begin());
+  for (; it != from.end(); ++it) {
+    GroupMap::iterator found(into->find(it->first));
+    if (found == into->end())
+      into->insert(*it);
+    else
+      MergeGroup(it->second, &found->second);
+  }
+}
+
+void LogAggregator::AggregateChunk() {
+  ScopedPerfTimer timer(&aggregate_chunk_counter);
+  task_.Cancel();
+
+  int num_rows = view_->GetNumRows();
+  int start = std::max(aggregated_rows_, view_->GetFirstRow());
+
+  // Figure the range we're going to tally, and how many threads to spread
+  // it over.
+  int num_threads = std::max(1, std::min(
+      static_cast<int>(max_threads_),
+      (num_rows - start) / kMinRowsPerThread));
+  int end = std::min(start + num_threads * kMaxRowsPerThread, num_rows);
+
+  // Hand the trailing ranges to the task pool, then tally the first range
+  // ourselves, and any the pool hasn't got to by then. The ranges are
+  // merged in order.
+  int range = (end - start + num_threads - 1) / num_threads;
+  std::vector<GroupMap> range_groups(num_threads - 1);
+  std::vector<Group> range_totals(num_threads - 1);
+  {
+    TaskPool::TaskGroup group(TaskPool::Get(), TaskPool::PRIORITY_VISIBLE,
+                              &aggregate_range_counter);
+    for (int i = 1; i < num_threads; ++i) {
+      group.Post(base::Bind(&LogAggregator::AggregateRange, view_, group_by_,
+                            std::min(start + i * range, end),
+                            std::min(start + (i + 1) * range, end),
+                            &range_groups[i - 1], &range_totals[i - 1]));
+    }
+
+    AggregateRange(view_, group_by_, start, std::min(start + range, end),
+                   &groups_, &total_);
+    group.Wait();
+  }
+
+  for (int i = 1; i < num_threads; ++i) {
+    MergeGroups(range_groups[i - 1], &groups_);
+    MergeGroup(range_totals[i - 1], &total_);
+  }
+
+  aggregated_rows_ = std::max(aggregated_rows_, end);
+
+  // Post again if we're not done.
+  if (aggregated_rows_ < num_rows)
+    PostAggregationTask();
+}
+
+void LogAggregator::PostAggregationTask() {
+  if (task_.IsCancelled()) {
+    task_.Reset(base::Bind(&LogAggregator::AggregateChunk,
+                           base::Unretained(this)));
+    base::MessageLoop::current()->PostTask(FROM_HERE, task_.callback());
+  }
+}
@@ -0,0 +1,154 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log aggregator declaration.
+#ifndef SAWBUCK_VIEWER_LOG_AGGREGATOR_H_
+#define SAWBUCK_VIEWER_LOG_AGGREGATOR_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/cancelable_callback.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+#include "sawbuck/viewer/log_list_view.h"
+
+// Tallies the rows of a log view by a grouping, to find the call sites,
+// processes or messages that dominate a log. Give it a filtered view to
+// tally only the rows the filters let through. Like the filtered view,
+// aggregation proceeds in chunks of rows, one chunk per task posted to the
+// current message loop, and large chunks are split into row ranges that
+// are tallied in parallel on a pool of worker threads. New rows are
+// tallied as they arrive, while rows evicted from the view stay counted.
+// Repeats a row gains after it's tallied aren't counted.
+// @note the view is read concurrently from the worker threads, only while
+//    a chunk is being tallied. See FilteredLogView.
+class LogAggregator : public ILogViewEvents {
+ public:
+  enum GroupBy {
+    // By file and line.
+    GROUP_BY_LOCATION,
+    GROUP_BY_PROCESS,
+    // By process and thread.
+    GROUP_BY_THREAD,
+    // By stack trace, which needs a view that pools its traces.
+    GROUP_BY_STACK,
+    // By message, with numbers masked. See MaskMessage.
+    GROUP_BY_MESSAGE,
+  };
+
+  // The tally of a group of rows.
+  struct Group {
+    Group() : count(0), bytes(0), errors(0), first_row(0) {
+    }
+
+    // Describes the group's key, e.g. "foo.cc(12)".
+    std::string name;
+    // The occurrences of the group's rows, counting repeats.
+    int64 count;
+    // The message bytes of those occurrences.
+    int64 bytes;
+    // The occurrences of error or critical severity.
+    int64 errors;
+    // The earliest and latest time of an occurrence.
+    base::Time first_time;
+    base::Time last_time;
+    // The first row of the group, which may have been evicted since.
+    int first_row;
+  };
+
+  LogAggregator(ILogView* view, GroupBy group_by);
+  ~LogAggregator();
+
+  // ILogViewEvents implementation.
+  virtual void LogViewNewItems();
+  virtual void LogViewCleared();
+  virtual void LogViewEvicted(int first_row);
+
+  // Tallies the rows left to tally now, rather than chunk by chunk.
+  void AggregateAll();
+
+  // @returns true iff all the rows of the view have been tallied.
+  bool IsDone();
+
+  // Gets the groups tallied so far, most frequent first.
+  void GetGroups(std::vector<Group>* groups) const;
+
+  GroupBy group_by() const { return group_by_; }
+  // @returns the tally over all groups, which has no name.
+  const Group& total() const { return total_; }
+
+  // Masks the numbers in @p message, so that messages logged from the same
+  // format string compare equal. The parameters of the message's template
+  // are replaced with '#', see MessageTemplates::Split.
+  static void MaskMessage(const base::StringPiece& message,
+                          std::string* masked);
+
+  // Merges @p from, tallied from later rows, into @p into. Either may be
+  // empty.
+  static void MergeGroup(const Group& from, Group* into);
+
+ protected:
+  // Identifies a group. Groups by message are told apart by their masked
+  // message, the others by a number.
+  struct GroupKey {
+    GroupKey() : id(0) {
+    }
+
+    bool operator<(const GroupKey& other) const {
+      return id < other.id || (id == other.id && text < other.text);
+    }
+
+    uint64 id;
+    std::string text;
+  };
+  typedef std::map<GroupKey, Group> GroupMap;
+
+  // Tallies the rows of @p view in [@p begin, @p end) by @p group_by into
+  // @p groups, and over all groups into @p total.
+  static void AggregateRange(ILogView* view, GroupBy group_by,
+                             int begin, int end,
+                             GroupMap* groups, Group* total);
+  static void MergeGroups(const GroupMap& from, GroupMap* into);
+
+  void PostAggregationTask();
+  void AggregateChunk();
+
+  ILogView* view_;
+  int registration_cookie_;
+  GroupBy group_by_;
+
+  // The groups tallied so far, and the tally over them.
+  GroupMap groups_;
+  Group total_;
+
+  // The next row of |view_| to tally.
+  int aggregated_rows_;
+
+  // The maximum number of threads tallying a chunk, including our own.
+  // Defaults to the task pool's workers and our own.
+  size_t max_threads_;
+
+  typedef base::CancelableCallback<void()> AggregateCallback;
+
+  // Non-NULL if there's a task pending to tally additional rows.
+  AggregateCallback task_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogAggregator);
+};
+
+#endif  // SAWBUCK_VIEWER_LOG_AGGREGATOR_H_
@@ -0,0 +1,218 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "sawbuck/viewer/log_aggregator.h"
+
+#include "base/run_loop.h"
+#include "base/strings/stringprintf.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/log_store.h"
+#include "sawbuck/viewer/store_log_view.h"
+
+namespace {
+
+using testing::StoreLogView;
+
+class TestingLogAggregator : public LogAggregator {
+ public:
+  TestingLogAggregator(ILogView* view, GroupBy group_by)
+      : LogAggregator(view, group_by) {
+  }
+
+  void set_max_threads(size_t max_threads) { max_threads_ = max_threads; }
+};
+
+std::string Mask(const char* message) {
+  std::string masked;
+  LogAggregator::MaskMessage(message, &masked);
+  return masked;
+}
+
+class LogAggregatorTest : public testing::Test {
+ public:
+  LogAggregatorTest() : store_(&file_table_), view_(&store_) {
+    for (size_t i = 0; i < arraysize(trace_); ++i)
+      trace_[i] = 0x1000 + i;
+  }
+
+  // Adds @p num_rows rows, from two call sites in three threads.
+  void AddRows(int num_rows) {
+    StringTable::Atom files[] = {
+      file_table_.Intern("foo.cc"), file_table_.Intern("bar.cc"),
+    };
+    for (int i = 0; i < num_rows; ++i) {
+      int row = store_.num_rows();
+      store_.AddRow(TRACE_LEVEL_INFORMATION, 10, 100 + row % 3,
+                    time_ + base::TimeDelta::FromMilliseconds(row),
+                    files[row % 2], 10 * (row % 2),
+                    base::StringPrintf("Opened %d bytes at 0x%08X",
+                                       row % 5 + 1, row),
+                    row % 2 + 1, trace_);
+    }
+  }
+
+  void RunMessageLoopToIdle() {
+    base::RunLoop run_loop;
+    run_loop.RunUntilIdle();
+  }
+
+ protected:
+  base::MessageLoop message_loop_;
+  base::Time time_;
+  StringTable file_table_;
+  LogStore store_;
+  StoreLogView view_;
+  sym_util::Address trace_[2];
+};
+
+}  // namespace
+
+TEST(LogAggregatorMaskTest, MaskMessage) {
+  EXPECT_EQ("", Mask(""));
+  EXPECT_EQ("Opening a file", Mask("Opening a file"));
+  EXPECT_EQ("Read # bytes at #", Mask("Read 42 bytes at 0x0012FF7C"));
+  EXPECT_EQ("Took #", Mask("Took 10ms"));
+  EXPECT_EQ("Handle #, v8 and utf16", Mask("Handle 0012ff7c, v8 and utf16"));
+  EXPECT_EQ("{#-#-#-#-#}",
+            Mask("{7E1AD3F4-66C9-4d4a-B5D6-94A1B2C3D4E5}"));
+  EXPECT_EQ("Deadbeef and cafe", Mask("Deadbeef and cafe"));
+}
+
+TEST_F(LogAggregatorTest, GroupByLocation) {
+  AddRows(10);
+  LogAggregator aggregator(&view_, LogAggregator::GROUP_BY_LOCATION);
+  aggregator.AggregateAll();
+  EXPECT_TRUE(aggregator.IsDone());
+
+  std::vector<LogAggregator::Group> groups;
+  aggregator.GetGroups(&groups);
+  ASSERT_EQ(2U, groups.size());
+  EXPECT_EQ("foo.cc(0)", groups[0].name);
+  EXPECT_EQ(5, groups[0].count);
+  EXPECT_EQ(0, groups[0].first_row);
+  EXPECT_EQ(time_, groups[0].first_time);
+  EXPECT_EQ(time_ + base::TimeDelta::FromMilliseconds(8),
+            groups[0].last_time);
+  EXPECT_EQ("bar.cc(10)", groups[1].name);
+  EXPECT_EQ(5, groups[1].count);
+  EXPECT_EQ(1, groups[1].first_row);
+
+  EXPECT_EQ(10, aggregator.total().count);
+  EXPECT_EQ(groups[0].bytes + groups[1].bytes, aggregator.total().bytes);
+  EXPECT_EQ(time_ + base::TimeDelta::FromMilliseconds(9),
+            aggregator.total().last_time);
+}
+
+TEST_F(LogAggregatorTest, GroupByThreadAndStack) {
+  AddRows(9);
+  LogAggregator by_thread(&view_, LogAggregator::GROUP_BY_THREAD);
+  LogAggregator by_stack(&view_, LogAggregator::GROUP_BY_STACK);
+  by_thread.AggregateAll();
+  by_stack.AggregateAll();
+
+  std::vector<LogAggregator::Group> groups;
+  by_thread.GetGroups(&groups);
+  ASSERT_EQ(3U, groups.size());
+  EXPECT_EQ("Process 10, thread 100", groups[0].name);
+  EXPECT_EQ(3, groups[0].count);
+
+  by_stack.GetGroups(&groups);
+  ASSERT_EQ(2U, groups.size());
+  EXPECT_EQ(5, groups[0].count);
+  EXPECT_EQ(base::StringPrintf("Stack %u, 1 frames from 0x%llX",
+                               store_.GetStackTraceId(0), trace_[0]),
+            groups[0].name);
+  EXPECT_EQ(4, groups[1].count);
+}
+
+TEST_F(LogAggregatorTest, GroupByMessage) {
+  AddRows(4);
+  store_.AddRow(TRACE_LEVEL_ERROR, 10, 100, time_, 0, 0, "Closed", 0, NULL);
+  LogAggregator aggregator(&view_, LogAggregator::GROUP_BY_MESSAGE);
+  aggregator.AggregateAll();
+
+  std::vector<LogAggregator::Group> groups;
+  aggregator.GetGroups(&groups);
+  ASSERT_EQ(2U, groups.size());
+  EXPECT_EQ("Opened # bytes at #", groups[0].name);
+  EXPECT_EQ(4, groups[0].count);
+  EXPECT_EQ(0, groups[0].errors);
+  EXPECT_EQ("Closed", groups[1].name);
+  EXPECT_EQ(6, groups[1].bytes);
+  EXPECT_EQ(1, groups[1].errors);
+  EXPECT_EQ(1, aggregator.total().errors);
+}
+
+TEST_F(LogAggregatorTest, ParallelAgreesWithSerial) {
+  AddRows(20000);
+  TestingLogAggregator serial(&view_, LogAggregator::GROUP_BY_MESSAGE);
+  TestingLogAggregator parallel(&view_, LogAggregator::GROUP_BY_MESSAGE);
+  serial.set_max_threads(1);
+  parallel.set_max_threads(4);
+  serial.AggregateAll();
+  parallel.AggregateAll();
+
+  std::vector<LogAggregator::Group> expected;
+  std::vector<LogAggregator::Group> groups;
+  serial.GetGroups(&expected);
+  parallel.GetGroups(&groups);
+  ASSERT_EQ(expected.size(), groups.size());
+  for (size_t i = 0; i < groups.size(); ++i) {
+    EXPECT_EQ(expected[i].name, groups[i].name);
+    EXPECT_EQ(expected[i].count, groups[i].count);
+    EXPECT_EQ(expected[i].bytes, groups[i].bytes);
+    EXPECT_EQ(expected[i].errors, groups[i].errors);
+    EXPECT_EQ(expected[i].first_row, groups[i].first_row);
+    EXPECT_EQ(expected[i].first_time, groups[i].first_time);
+    EXPECT_EQ(expected[i].last_time, groups[i].last_time);
+  }
+  EXPECT_EQ(20000, parallel.total().count);
+}
+
+TEST_F(LogAggregatorTest, Incremental) {
+  AddRows(10);
+  LogAggregator aggregator(&view_, LogAggregator::GROUP_BY_PROCESS);
+  EXPECT_FALSE(aggregator.IsDone());
+  RunMessageLoopToIdle();
+  EXPECT_TRUE(aggregator.IsDone());
+  EXPECT_EQ(10, aggregator.total().count);
+
+  AddRows(5);
+  aggregator.LogViewNewItems();
+  RunMessageLoopToIdle();
+  EXPECT_EQ(15, aggregator.total().count);
+
+  // Evicted rows stay counted.
+  LogStore::Retention retention;
+  retention.max_rows = 5;
+  store_.set_retention(retention);
+  aggregator.LogViewEvicted(store_.first_row());
+  AddRows(1);
+  aggregator.LogViewNewItems();
+  RunMessageLoopToIdle();
+  EXPECT_EQ(16, aggregator.total().count);
+
+  std::vector<LogAggregator::Group> groups;
+  aggregator.GetGroups(&groups);
+  ASSERT_EQ(1U, groups.size());
+  EXPECT_EQ("Process 10", groups[0].name);
+  EXPECT_EQ(16, groups[0].count);
+
+  store_.Clear();
+  aggregator.LogViewCleared();
+  RunMessageLoopToIdle();
+  EXPECT_EQ(0, aggregator.total().count);
+  aggregator.GetGroups(&groups);
+  EXPECT_TRUE(groups.empty());
+}
@@ -0,0 +1,351 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log diff implementation.
+#include "sawbuck/viewer/log_diff.h"
+
+#include <math.h>
+#include <algorithm>
+#include <map>
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/threading/thread.h"
+#include "sawbuck/viewer/log_store.h"
+
+namespace {
+
+// A view on a log store, row for row, that never changes.
+class StoreView : public ILogView {
+ public:
+  explicit StoreView(const LogStore* store) : store_(store) {
+    DCHECK(store_ != NULL);
+  }
+
+  virtual int GetNumRows() { return store_->num_rows(); }
+  virtual int GetFirstRow() { return store_->first_row(); }
+  virtual void ClearAll() { NOTREACHED(); }
+  virtual int GetSeverity(int row) { return store_->GetSeverity(row); }
+  virtual DWORD GetProcessId(int row) { return store_->GetProcessId(row); }
+  virtual DWORD GetThreadId(int row) { return store_->GetThreadId(row); }
+  virtual base::Time GetTime(int row) { return store_->GetTime(row); }
+  virtual std::string GetFileName(int row) {
+    return store_->GetFileName(row);
+  }
+  virtual StringTable::Atom GetFileAtom(int row) {
+    return store_->GetFileAtom(row);
+  }
+  virtual int GetLine(int row) { return store_->GetLine(row); }
+  virtual std::string GetMessage(int row) {
+    std::string buffer;
+    return store_->GetMessage(row, &buffer).as_string();
+  }
+  virtual void GetStackTrace(int row, std::vector<sym_util::Address>* trace) {
+    store_->GetStackTrace(row, trace);
+  }
+  virtual base::StringPiece GetFileNamePiece(int row, std::string* buffer) {
+    return store_->GetFileName(row);
+  }
+  virtual base::StringPiece GetMessagePiece(int row, std::string* buffer) {
+    return store_->GetMessage(row, buffer);
+  }
+  virtual StackTracePool::StackId GetStackTraceId(int row) {
+    return store_->GetStackTraceId(row);
+  }
+  virtual bool CollapsesRepeats() { return store_->collapse_repeats(); }
+  virtual int GetRepeatCount(int row) { return store_->GetRepeatCount(row); }
+  virtual base::Time GetLastTime(int row) { return store_->GetLastTime(row); }
+  virtual bool IsLossMarker(int row) { return store_->IsLossMarker(row); }
+  virtual const LogStore* GetLogStore() { return store_; }
+  virtual void Register(ILogViewEvents* event_sink,
+                        int* registration_cookie) {
+    *registration_cookie = 0;
+  }
+  virtual void Unregister(int registration_cookie) {}
+
+ private:
+  const LogStore* store_;
+
+  DISALLOW_COPY_AND_ASSIGN(StoreView);
+};
+
+// Returns the name @p group is matched across sessions by. Stack groups
+// are named for their pool id, which is particular to the session, so
+// they're matched by their depth and innermost frame instead.
+std::string GetMatchName(LogAggregator::GroupBy group_by,
+                         const std::string& name) {
+  if (group_by != LogAggregator::GROUP_BY_STACK)
+    return name;
+  size_t comma = name.find(", ");
+  if (comma == std::string::npos)
+    return name;
+  return name.substr(comma + 2);
+}
+
+bool IsHexDigit(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+      (c >= 'A' && c <= 'F');
+}
+
+bool MoreSignificantGroup(const LogDiff::GroupDelta& a,
+                          const LogDiff::GroupDelta& b) {
+  if (a.significance != b.significance)
+    return a.significance > b.significance;
+  return a.name < b.name;
+}
+
+bool MoreSignificantSpan(const LogDiff::SpanDelta& a,
+                         const LogDiff::SpanDelta& b) {
+  if (a.significance != b.significance)
+    return a.significance > b.significance;
+  return a.name < b.name;
+}
+
+TraceSpanMatcher::DurationStats NoDurations() {
+  TraceSpanMatcher::DurationStats stats;
+  stats.count = 0;
+  return stats;
+}
+
+}  // namespace
+
+struct LogDiff::Side {
+  std::vector<LogAggregator::Group> groups;
+  LogAggregator::Group total;
+  std::vector<TraceSpanMatcher::DurationStats> spans;
+};
+
+LogDiff::SpanDelta::SpanDelta()
+    : baseline(NoDurations()), current(NoDurations()), significance(0) {
+}
+
+LogDiff::LogDiff(LogAggregator::GroupBy group_by) : group_by_(group_by) {
+}
+
+LogDiff::~LogDiff() {
+}
+
+void LogDiff::Compare(const LogStore& baseline, ILogView* current) {
+  DCHECK(current != NULL);
+
+  StoreView baseline_view(&baseline);
+  Side baseline_side;
+  Side current_side;
+  base::Thread thread("Log diff baseline");
+  if (thread.Start()) {
+    thread.message_loop()->PostTask(FROM_HERE,
+        base::Bind(&LogDiff::TallySide, &baseline_view, group_by_,
+                   &baseline_side));
+  } else {
+    LOG(ERROR) << "Failed to start the baseline thread.";
+    TallySide(&baseline_view, group_by_, &baseline_side);
+  }
+  TallySide(current, group_by_, &current_side);
+  // Stopping the thread waits for the baseline's tally.
+  thread.Stop();
+
+  baseline_total_ = baseline_side.total;
+  current_total_ = current_side.total;
+  MatchGroups(baseline_side, current_side);
+  MatchSpans(baseline_side, current_side);
+}
+
+double LogDiff::GetProportionSignificance(int64 baseline_count,
+                                          int64 baseline_total,
+                                          int64 current_count,
+                                          int64 current_total) {
+  if (baseline_total <= 0 || current_total <= 0)
+    return 0;
+
+  double baseline_share = static_cast<double>(baseline_count) /
+      baseline_total;
+  double current_share = static_cast<double>(current_count) / current_total;
+  double pooled = static_cast<double>(baseline_count + current_count) /
+      (baseline_total + current_total);
+  double variance = pooled * (1 - pooled) *
+      (1.0 / baseline_total + 1.0 / current_total);
+  if (variance <= 0)
+    return 0;
+  return (current_share - baseline_share) / sqrt(variance);
+}
+
+bool LogDiff::ParseTraceMessage(const base::StringPiece& message,
+                                base::StringPiece* type,
+                                base::StringPiece* name,
+                                void** id) {
+  DCHECK(type != NULL);
+  DCHECK(name != NULL);
+  DCHECK(id != NULL);
+
+  // The message reads "TYPE(name, 0xID): extra", where the name may hold
+  // anything, so the id is the first hex number followed by "): ".
+  size_t open = message.find('(');
+  if (open == base::StringPiece::npos || open == 0)
+    return false;
+
+  static const char kIdPrefix[] = ", 0x";
+  size_t prefix = message.find(kIdPrefix, open + 1);
+  while (prefix != base::StringPiece::npos) {
+    size_t digits = prefix + arraysize(kIdPrefix) - 1;
+    size_t end = digits;
+    uintptr_t value = 0;
+    for (; end < message.size() && IsHexDigit(message[end]); ++end) {
+      char c = message[end];
+      int digit = c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+      value = (value << 4) | digit;
+    }
+    if (end > digits && message.substr(end, 2) == "):") {
+      *type = message.substr(0, open);
+      base::StringPiece padded(message.substr(open + 1, prefix - open - 1));
+      // The name is padded on the left to its length.
+      while (!padded.empty() && padded[0] == ' ')
+        padded.remove_prefix(1);
+      *name = padded;
+      *id = reinterpret_cast<void*>(value);
+      return true;
+    }
+    prefix = message.find(kIdPrefix, prefix + 1);
+  }
+
+  return false;
+}
+
+void LogDiff::MatchTraceRows(ILogView* view, int begin, int end,
+                             TraceSpanMatcher* matcher) {
+  DCHECK(view != NULL);
+  DCHECK(matcher != NULL);
+
+  std::string buffer;
+  for (int row = begin; row < end; ++row) {
+    // Trace events are logged from nowhere.
+    if (view->GetFileAtom(row) != StringTable::kEmptyAtom ||
+        view->GetLine(row) != 0) {
+      continue;
+    }
+
+    base::StringPiece type;
+    base::StringPiece name;
+    TraceEvents::TraceMessage trace_message;
+    if (!ParseTraceMessage(view->GetMessagePiece(row, &buffer), &type, &name,
+                           &trace_message.id)) {
+      continue;
+    }
+
+    trace_message.time = view->GetTime(row);
+    trace_message.level = static_cast<UCHAR>(view->GetSeverity(row));
+    trace_message.process_id = view->GetProcessId(row);
+    trace_message.thread_id = view->GetThreadId(row);
+    trace_message.name = name.data();
+    trace_message.name_len = name.size();
+    if (type == "BEGIN")
+      matcher->OnTraceEventBegin(trace_message);
+    else if (type == "END")
+      matcher->OnTraceEventEnd(trace_message);
+  }
+}
+
+void LogDiff::GetSpanDurations(
+    const LogStore& store,
+    std::vector<TraceSpanMatcher::DurationStats>* stats) {
+  DCHECK(stats != NULL);
+  StoreView view(&store);
+  TraceSpanMatcher matcher;
+  MatchTraceRows(&view, view.GetFirstRow(), view.GetNumRows(), &matcher);
+  matcher.GetDurationStats(stats);
+}
+
+void LogDiff::TallySide(ILogView* view,
+                        LogAggregator::GroupBy group_by,
+                        Side* side) {
+  DCHECK(view != NULL);
+  DCHECK(side != NULL);
+
+  LogAggregator aggregator(view, group_by);
+  aggregator.AggregateAll();
+  aggregator.GetGroups(&side->groups);
+  side->total = aggregator.total();
+
+  TraceSpanMatcher matcher;
+  MatchTraceRows(view, view->GetFirstRow(), view->GetNumRows(), &matcher);
+  matcher.GetDurationStats(&side->spans);
+}
+
+void LogDiff::MatchGroups(const Side& baseline, const Side& current) {
+  typedef std::map<std::string, GroupDelta> DeltaMap;
+  DeltaMap deltas;
+  for (size_t i = 0; i < baseline.groups.size(); ++i) {
+    const LogAggregator::Group& group = baseline.groups[i];
+    GroupDelta& delta = deltas[GetMatchName(group_by_, group.name)];
+    delta.name = group.name;
+    LogAggregator::MergeGroup(group, &delta.baseline);
+  }
+  for (size_t i = 0; i < current.groups.size(); ++i) {
+    const LogAggregator::Group& group = current.groups[i];
+    GroupDelta& delta = deltas[GetMatchName(group_by_, group.name)];
+    delta.name = group.name;
+    LogAggregator::MergeGroup(group, &delta.current);
+  }
+
+  groups_.clear();
+  groups_.reserve(deltas.size());
+  DeltaMap::iterator it(deltas.begin());
+  for (; it != deltas.end(); ++it) {
+    GroupDelta& delta = it->second;
+    double share = GetProportionSignificance(delta.baseline.count,
+                                             baseline.total.count,
+                                             delta.current.count,
+                                             current.total.count);
+    double errors = GetProportionSignificance(delta.baseline.errors,
+                                              delta.baseline.count,
+                                              delta.current.errors,
+                                              delta.current.count);
+    delta.significance = std::max(fabs(share), fabs(errors));
+    groups_.push_back(delta);
+  }
+  std::sort(groups_.begin(), groups_.end(), MoreSignificantGroup);
+}
+
+void LogDiff::MatchSpans(const Side& baseline, const Side& current) {
+  typedef std::map<std::string, SpanDelta> DeltaMap;
+  DeltaMap deltas;
+  for (size_t i = 0; i < baseline.spans.size(); ++i) {
+    SpanDelta& delta = deltas[baseline.spans[i].name];
+    delta.name = baseline.spans[i].name;
+    delta.baseline = baseline.spans[i];
+  }
+  for (size_t i = 0; i < current.spans.size(); ++i) {
+    SpanDelta& delta = deltas[current.spans[i].name];
+    delta.name = current.spans[i].name;
+    delta.current = current.spans[i];
+  }
+
+  spans_.clear();
+  spans_.reserve(deltas.size());
+  DeltaMap::iterator it(deltas.begin());
+  for (; it != deltas.end(); ++it) {
+    SpanDelta& delta = it->second;
+    uint64 fewer = std::min(delta.baseline.count, delta.current.count);
+    if (fewer == 0) {
+      delta.significance = sqrt(static_cast<double>(
+          std::max(delta.baseline.count, delta.current.count)));
+    } else {
+      // Add a microsecond to either side, so that zero durations compare.
+      double ratio =
+          (delta.current.p95.InMicroseconds() + 1.0) /
+          (delta.baseline.p95.InMicroseconds() + 1.0);
+      delta.significance = fabs(log(ratio)) * sqrt(static_cast<double>(fewer));
+    }
+    spans_.push_back(delta);
+  }
+  std::sort(spans_.begin(), spans_.end(), MoreSignificantSpan);
+}
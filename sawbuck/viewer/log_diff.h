@@ -0,0 +1,144 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log diff declaration.
+#ifndef SAWBUCK_VIEWER_LOG_DIFF_H_
+#define SAWBUCK_VIEWER_LOG_DIFF_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "sawbuck/log_lib/trace_span_matcher.h"
+#include "sawbuck/viewer/log_aggregator.h"
+#include "sawbuck/viewer/log_list_view.h"
+
+class LogStore;
+
+// Compares a session to a baseline, e.g. a capture to a session saved
+// before a change, to find what the change did to the log. Both sides are
+// tallied by a grouping, and their groups are matched by name, as the
+// file atoms and stack ids they're keyed by don't carry across sessions.
+// The trace event rows of both sides are replayed to a span matcher, and
+// their spans are matched by name.
+// The baseline is tallied on a thread of its own while the current side
+// is tallied on the caller's, and each side's tally is parallel in turn,
+// see LogAggregator.
+// Groups are ranked by how unlikely their change is to be chance: a group
+// whose share of the rows, or whose share of errors, moved by more than
+// its counts account for sorts first. See GetProportionSignificance.
+class LogDiff {
+ public:
+  // A group's tallies on either side, empty on a side it's missing from.
+  struct GroupDelta {
+    GroupDelta() : significance(0) {
+    }
+
+    std::string name;
+    LogAggregator::Group baseline;
+    LogAggregator::Group current;
+    // In standard deviations, the larger of the change in the group's
+    // share of the rows, and of the change in its error rate.
+    double significance;
+  };
+
+  // A span name's durations on either side, with a zero count on a side
+  // it's missing from.
+  struct SpanDelta {
+    SpanDelta();
+
+    std::string name;
+    TraceSpanMatcher::DurationStats baseline;
+    TraceSpanMatcher::DurationStats current;
+    // The log ratio of the 95th percentiles, weighted by the square root of
+    // the lesser count, or the square root of the count of the side the
+    // name is on if it's missing from the other.
+    double significance;
+  };
+
+  explicit LogDiff(LogAggregator::GroupBy group_by);
+  ~LogDiff();
+
+  // Compares @p current to @p baseline, replacing the outcome of any
+  // previous comparison. Neither may change during the call.
+  void Compare(const LogStore& baseline, ILogView* current);
+
+  LogAggregator::GroupBy group_by() const { return group_by_; }
+
+  // @returns the groups of both sides, most significant change first.
+  const std::vector<GroupDelta>& groups() const { return groups_; }
+  // @returns the span names of both sides, most significant change first.
+  const std::vector<SpanDelta>& spans() const { return spans_; }
+
+  // @returns the tallies over all rows of either side.
+  const LogAggregator::Group& baseline_total() const {
+    return baseline_total_;
+  }
+  const LogAggregator::Group& current_total() const {
+    return current_total_;
+  }
+
+  // @returns the z-score of the change from a proportion of
+  //     @p baseline_count in @p baseline_total to one of @p current_count
+  //     in @p current_total, by the pooled two proportion test. This is
+  //     zero if either total is zero or the proportions agree.
+  static double GetProportionSignificance(int64 baseline_count,
+                                          int64 baseline_total,
+                                          int64 current_count,
+                                          int64 current_total);
+
+  // Parses the message of a trace event row, @see FormatTraceMessage.
+  // @returns true iff @p message is that of a trace event, in which case
+  //     @p type, @p name and @p id hold its parts.
+  static bool ParseTraceMessage(const base::StringPiece& message,
+                                base::StringPiece* type,
+                                base::StringPiece* name,
+                                void** id);
+
+  // Replays the trace event rows of @p view in [@p begin, @p end) to
+  // @p matcher, in order.
+  static void MatchTraceRows(ILogView* view, int begin, int end,
+                             TraceSpanMatcher* matcher);
+
+  // Retrieves the duration statistics of the spans of the trace event rows
+  // of @p store to @p stats, @see TraceSpanMatcher::GetDurationStats.
+  static void GetSpanDurations(
+      const LogStore& store,
+      std::vector<TraceSpanMatcher::DurationStats>* stats);
+
+ private:
+  // The tallies of one side.
+  struct Side;
+
+  // Tallies @p view into @p side.
+  static void TallySide(ILogView* view,
+                        LogAggregator::GroupBy group_by,
+                        Side* side);
+
+  // Matches the groups and spans of @p baseline and @p current.
+  void MatchGroups(const Side& baseline, const Side& current);
+  void MatchSpans(const Side& baseline, const Side& current);
+
+  const LogAggregator::GroupBy group_by_;
+
+  std::vector<GroupDelta> groups_;
+  std::vector<SpanDelta> spans_;
+  LogAggregator::Group baseline_total_;
+  LogAggregator::Group current_total_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogDiff);
+};
+
+#endif  // SAWBUCK_VIEWER_LOG_DIFF_H_
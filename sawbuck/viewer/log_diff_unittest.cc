@@ -0,0 +1,207 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log diff unit tests.
+#include "sawbuck/viewer/log_diff.h"
+
+#include "base/strings/stringprintf.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/log_store.h"
+#include "sawbuck/viewer/store_log_view.h"
+
+namespace {
+
+using testing::StoreLogView;
+
+class LogDiffTest : public testing::Test {
+ public:
+  LogDiffTest()
+      : baseline_(&baseline_files_),
+        current_(&current_files_),
+        current_view_(&current_) {
+  }
+
+  // Adds @p count rows logged from @p file at @p line to @p store, of which
+  // the first @p errors are errors.
+  void AddRows(LogStore* store, const char* file, int line,
+               int count, int errors) {
+    StringTable::Atom atom = store->file_table()->Intern(file);
+    for (int i = 0; i < count; ++i) {
+      store->AddRow(i < errors ? TRACE_LEVEL_ERROR : TRACE_LEVEL_INFORMATION,
+                    10, 100, NextTime(), atom, line,
+                    base::StringPrintf("Row %d", i), 0, NULL);
+    }
+  }
+
+  // Adds @p count spans of @p name lasting @p duration_ms to @p store.
+  void AddSpans(LogStore* store, const char* name, int count,
+                int duration_ms) {
+    TraceEvents::TraceMessage trace_message;
+    trace_message.process_id = 10;
+    trace_message.thread_id = 100;
+    trace_message.name = name;
+    trace_message.name_len = strlen(name);
+    for (int i = 0; i < count; ++i) {
+      trace_message.id = reinterpret_cast<void*>(0x100 + i);
+      trace_message.time = NextTime();
+      store->AddTraceMessage("BEGIN", trace_message);
+      trace_message.time += base::TimeDelta::FromMilliseconds(duration_ms);
+      time_ = trace_message.time;
+      store->AddTraceMessage("END", trace_message);
+    }
+  }
+
+  const LogDiff::GroupDelta* FindGroup(const LogDiff& diff,
+                                       const std::string& name) {
+    for (size_t i = 0; i < diff.groups().size(); ++i) {
+      if (diff.groups()[i].name == name)
+        return &diff.groups()[i];
+    }
+    return NULL;
+  }
+
+ protected:
+  base::Time NextTime() {
+    time_ += base::TimeDelta::FromMilliseconds(1);
+    return time_;
+  }
+
+  base::MessageLoop message_loop_;
+  base::Time time_;
+  StringTable baseline_files_;
+  StringTable current_files_;
+  LogStore baseline_;
+  LogStore current_;
+  StoreLogView current_view_;
+};
+
+}  // namespace
+
+TEST(LogDiffSignificanceTest, GetProportionSignificance) {
+  EXPECT_EQ(0, LogDiff::GetProportionSignificance(10, 100, 10, 100));
+  EXPECT_EQ(0, LogDiff::GetProportionSignificance(10, 0, 10, 100));
+  EXPECT_LT(0, LogDiff::GetProportionSignificance(10, 100, 20, 100));
+  EXPECT_GT(0, LogDiff::GetProportionSignificance(20, 100, 10, 100));
+
+  // The same shift is more significant over more rows.
+  EXPECT_LT(LogDiff::GetProportionSignificance(10, 100, 20, 100),
+            LogDiff::GetProportionSignificance(1000, 10000, 2000, 10000));
+  // A proportion kept across totals is no change.
+  EXPECT_EQ(0, LogDiff::GetProportionSignificance(10, 100, 50, 500));
+}
+
+TEST(LogDiffParseTest, ParseTraceMessage) {
+  base::StringPiece type;
+  base::StringPiece name;
+  void* id = NULL;
+  EXPECT_TRUE(LogDiff::ParseTraceMessage("BEGIN(Paint, 0x0000BEEF): extra",
+                                         &type, &name, &id));
+  EXPECT_EQ("BEGIN", type);
+  EXPECT_EQ("Paint", name);
+  EXPECT_EQ(reinterpret_cast<void*>(0xBEEF), id);
+
+  // Names may hold anything the id is told apart from.
+  EXPECT_TRUE(LogDiff::ParseTraceMessage("END(a, 0xb, 0x00000010): ",
+                                         &type, &name, &id));
+  EXPECT_EQ("END", type);
+  EXPECT_EQ("a, 0xb", name);
+  EXPECT_EQ(reinterpret_cast<void*>(0x10), id);
+
+  EXPECT_FALSE(LogDiff::ParseTraceMessage("Opened a file", &type, &name,
+                                          &id));
+  EXPECT_FALSE(LogDiff::ParseTraceMessage("Read(foo, 0x): bar", &type,
+                                          &name, &id));
+}
+
+TEST_F(LogDiffTest, MatchesGroupsByName) {
+  // The files are interned in a different order on either side, so their
+  // atoms differ.
+  AddRows(&baseline_, "foo.cc", 10, 100, 0);
+  AddRows(&baseline_, "bar.cc", 20, 100, 1);
+  AddRows(&baseline_, "gone.cc", 30, 50, 0);
+  AddRows(&current_, "new.cc", 40, 50, 0);
+  AddRows(&current_, "bar.cc", 20, 100, 60);
+  AddRows(&current_, "foo.cc", 10, 100, 0);
+
+  LogDiff diff(LogAggregator::GROUP_BY_LOCATION);
+  diff.Compare(baseline_, &current_view_);
+  EXPECT_EQ(250, diff.baseline_total().count);
+  EXPECT_EQ(250, diff.current_total().count);
+  EXPECT_EQ(1, diff.baseline_total().errors);
+  EXPECT_EQ(60, diff.current_total().errors);
+
+  ASSERT_EQ(4U, diff.groups().size());
+  // The errors of bar.cc are the largest change.
+  const LogDiff::GroupDelta& top = diff.groups()[0];
+  EXPECT_EQ("bar.cc(20)", top.name);
+  EXPECT_EQ(100, top.baseline.count);
+  EXPECT_EQ(100, top.current.count);
+  EXPECT_EQ(1, top.baseline.errors);
+  EXPECT_EQ(60, top.current.errors);
+
+  const LogDiff::GroupDelta* foo = FindGroup(diff, "foo.cc(10)");
+  ASSERT_TRUE(foo != NULL);
+  EXPECT_EQ(100, foo->baseline.count);
+  EXPECT_EQ(100, foo->current.count);
+  EXPECT_EQ(0, foo->significance);
+  EXPECT_EQ("foo.cc(10)", diff.groups().back().name);
+
+  const LogDiff::GroupDelta* gone = FindGroup(diff, "gone.cc(30)");
+  ASSERT_TRUE(gone != NULL);
+  EXPECT_EQ(50, gone->baseline.count);
+  EXPECT_EQ(0, gone->current.count);
+  EXPECT_LT(0, gone->significance);
+
+  const LogDiff::GroupDelta* added = FindGroup(diff, "new.cc(40)");
+  ASSERT_TRUE(added != NULL);
+  EXPECT_EQ(0, added->baseline.count);
+  EXPECT_EQ(50, added->current.count);
+}
+
+TEST_F(LogDiffTest, ComparesSpans) {
+  AddSpans(&baseline_, "Paint", 20, 10);
+  AddSpans(&baseline_, "Layout", 20, 5);
+  AddSpans(&baseline_, "Gone", 4, 5);
+  AddSpans(&current_, "Layout", 20, 5);
+  AddSpans(&current_, "Paint", 20, 40);
+
+  LogDiff diff(LogAggregator::GROUP_BY_MESSAGE);
+  diff.Compare(baseline_, &current_view_);
+
+  ASSERT_EQ(3U, diff.spans().size());
+  const LogDiff::SpanDelta& paint = diff.spans()[0];
+  EXPECT_EQ("Paint", paint.name);
+  EXPECT_EQ(20U, paint.baseline.count);
+  EXPECT_EQ(20U, paint.current.count);
+  EXPECT_LT(paint.baseline.p95, paint.current.p95);
+
+  EXPECT_EQ("Gone", diff.spans()[1].name);
+  EXPECT_EQ(4U, diff.spans()[1].baseline.count);
+  EXPECT_EQ(0U, diff.spans()[1].current.count);
+
+  EXPECT_EQ("Layout", diff.spans()[2].name);
+  EXPECT_EQ(0, diff.spans()[2].significance);
+}
+
+TEST_F(LogDiffTest, GetSpanDurations) {
+  AddRows(&baseline_, "foo.cc", 10, 10, 0);
+  AddSpans(&baseline_, "Paint", 5, 10);
+
+  std::vector<TraceSpanMatcher::DurationStats> stats;
+  LogDiff::GetSpanDurations(baseline_, &stats);
+  ASSERT_EQ(1U, stats.size());
+  EXPECT_EQ("Paint", stats[0].name);
+  EXPECT_EQ(5U, stats[0].count);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(50), stats[0].total);
+}
@@ -0,0 +1,261 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Background log message search implementation.
+#include "sawbuck/viewer/log_finder.h"
+
+#include <algorithm>
+#include <limits>
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/message_loop/message_loop.h"
+#include "base/time/time.h"
+#include "pcrecpp.h"  // NOLINT
+#include "sawbuck/common/perf_counters.h"
+#include "sawbuck/common/task_pool.h"
+#include "sawbuck/viewer/log_list_view.h"
+#include "sawbuck/viewer/log_store.h"
+#include "sawbuck/viewer/pattern_matcher.h"
+#include "sawbuck/viewer/trigram_index.h"
+
+namespace {
+
+PerfCounter find_block_counter("LogFinder.Block", 1);
+
+// No more threads than this search a batch.
+const size_t kMaxFindThreads = 8;
+
+// Blocks check for a nearer hit this often.
+const int kRowsPerHitCheck = 256;
+
+// A batch of tasks runs no longer than this, before yielding to the
+// message loop.
+const int kMaxBatchTimeMs = 20;
+
+const base::subtle::Atomic32 kNoHit = std::numeric_limits<int32>::max();
+
+}  // namespace
+
+const int LogFinder::kRowsPerBlock;
+
+LogFinder::LogFinder(ILogView* view, Delegate* delegate)
+    : view_(view),
+      delegate_(delegate),
+      view_first_row_(0),
+      down_(true),
+      find_all_(false),
+      first_row_(0),
+      has_candidates_(false),
+      num_positions_(0),
+      searched_(0),
+      hits_num_rows_(0),
+      nearest_hit_(kNoHit),
+      max_find_threads_(std::min(TaskPool::Get()->num_workers() + 1,
+                                 kMaxFindThreads)) {
+  DCHECK(view_ != NULL);
+  DCHECK(delegate_ != NULL);
+}
+
+LogFinder::~LogFinder() {
+  Cancel();
+}
+
+void LogFinder::Find(const std::string& expression,
+                     bool match_case,
+                     bool down,
+                     int first_row) {
+  Cancel();
+  find_all_ = false;
+  StartFind(expression, match_case, down, first_row);
+}
+
+void LogFinder::FindAll(const std::string& expression, bool match_case) {
+  Cancel();
+  find_all_ = true;
+  hits_.Clear();
+  hits_num_rows_ = view_->GetNumRows();
+  StartFind(expression, match_case, true, 0);
+}
+
+void LogFinder::Cancel() {
+  task_.Cancel();
+}
+
+void LogFinder::StartFind(const std::string& expression,
+                          bool match_case,
+                          bool down,
+                          int first_row) {
+  pcrecpp::RE_Options options = PCRE_UTF8;
+  options.set_caseless(!match_case);
+  expression_.reset(new pcrecpp::RE(expression, options));
+
+  int num_rows = view_->GetNumRows();
+  down_ = down;
+  first_row_ = std::max(0, first_row);
+  if (down) {
+    first_row_ = std::max(first_row_, view_first_row_);
+    num_positions_ = std::max(0, num_rows - first_row_);
+  } else {
+    first_row_ = std::min(first_row_, num_rows - 1);
+    num_positions_ = std::max(0, first_row_ - view_first_row_ + 1);
+  }
+  searched_ = 0;
+
+  // The message index may narrow the search down a lot.
+  candidates_.clear();
+  has_candidates_ = false;
+  const LogStore* store = view_->GetLogStore();
+  if (store != NULL && store->message_index() != NULL &&
+      num_positions_ != 0) {
+    std::string literal(PatternMatcher::FindRequiredLiteral(expression));
+    int begin = down ? first_row_ : view_first_row_;
+    has_candidates_ = store->message_index()->GetCandidateRows(
+        literal, begin, begin + num_positions_, &candidates_);
+    if (has_candidates_)
+      num_positions_ = static_cast<int>(candidates_.size());
+  }
+
+  task_.Reset(base::Bind(&LogFinder::FindBatch, base::Unretained(this)));
+  base::MessageLoop::current()->PostTask(FROM_HERE, task_.callback());
+}
+
+void LogFinder::FindBatch() {
+  DCHECK(expression_.get() != NULL);
+
+  base::TimeTicks start(base::TimeTicks::Now());
+  int hit = -1;
+  while (searched_ < num_positions_ && hit == -1) {
+    // Figure how many blocks to search, and how many threads to spread
+    // them over.
+    int remaining = num_positions_ - searched_;
+    int num_blocks = std::max(1, std::min(
+        static_cast<int>(max_find_threads_),
+        (remaining + kRowsPerBlock - 1) / kRowsPerBlock));
+
+    // Hand the farther blocks to the task pool, then search the nearest
+    // block ourselves, and take the nearest hit.
+    base::subtle::NoBarrier_Store(&nearest_hit_, kNoHit);
+    block_first_hits_.assign(num_blocks, -1);
+    if (find_all_) {
+      block_hits_.resize(num_blocks);
+      for (int i = 0; i < num_blocks; ++i)
+        block_hits_[i].clear();
+    }
+    {
+      TaskPool::TaskGroup group(TaskPool::Get(),
+                                TaskPool::PRIORITY_INTERACTIVE,
+                                &find_block_counter);
+      for (int i = 1; i < num_blocks; ++i) {
+        group.Post(base::Bind(&LogFinder::SearchBlockTask,
+            base::Unretained(this), i,
+            std::min(searched_ + i * kRowsPerBlock, num_positions_),
+            std::min(searched_ + (i + 1) * kRowsPerBlock, num_positions_)));
+      }
+
+      hit = SearchBlock(0, searched_,
+                        std::min(searched_ + kRowsPerBlock, num_positions_));
+      group.Wait();
+    }
+
+    for (int i = 1; i < num_blocks && hit == -1; ++i)
+      hit = block_first_hits_[i];
+
+    // The blocks and their hits are in row order, so the hits are set in
+    // ascending order.
+    if (find_all_) {
+      for (int i = 0; i < num_blocks; ++i) {
+        const std::vector<int>& rows = block_hits_[i];
+        for (size_t j = 0; j < rows.size(); ++j)
+          hits_.Set(rows[j]);
+      }
+    }
+
+    searched_ = std::min(searched_ + num_blocks * kRowsPerBlock,
+                         num_positions_);
+
+    if (base::TimeTicks::Now() - start >
+        base::TimeDelta::FromMilliseconds(kMaxBatchTimeMs)) {
+      break;
+    }
+  }
+
+  if (hit == -1 && searched_ < num_positions_) {
+    // Yield, and carry on in a new task.
+    base::MessageLoop::current()->PostTask(FROM_HERE, task_.callback());
+    return;
+  }
+
+  // We're done, the delegate may start a new search from its callback.
+  task_.Cancel();
+  if (find_all_)
+    delegate_->OnFindAllDone(hits_.count());
+  else
+    delegate_->OnFindDone(hit);
+}
+
+int LogFinder::SearchBlock(int block, int begin, int end) {
+  const LogStore* store = view_->GetLogStore();
+  std::string buffer;
+  for (int position = begin; position < end; ++position) {
+    // Give up if a nearer block has a hit.
+    if ((position - begin) % kRowsPerHitCheck == 0 &&
+        base::subtle::Acquire_Load(&nearest_hit_) < block) {
+      return -1;
+    }
+
+    // Rows evicted since the search started are passed over.
+    int row = GetRow(position);
+    if (row < view_first_row_)
+      continue;
+
+    // Match the messages in place where we can.
+    base::StringPiece message(store != NULL ?
+        store->GetMessage(row, &buffer) :
+        view_->GetMessagePiece(row, &buffer));
+    bool matches = expression_->PartialMatch(
+        pcrecpp::StringPiece(message.data(), message.size()));
+
+    if (matches && find_all_) {
+      block_hits_[block].push_back(row);
+    } else if (matches) {
+      // Lower the nearest hit to our block, if it's not lower yet.
+      base::subtle::Atomic32 nearest = base::subtle::Acquire_Load(
+          &nearest_hit_);
+      while (nearest > block) {
+        base::subtle::Atomic32 previous =
+            base::subtle::Release_CompareAndSwap(&nearest_hit_, nearest,
+                                                 block);
+        if (previous == nearest)
+          break;
+        nearest = previous;
+      }
+      return row;
+    }
+  }
+
+  return -1;
+}
+
+void LogFinder::SearchBlockTask(int block, int begin, int end) {
+  block_first_hits_[block] = SearchBlock(block, begin, end);
+}
+
+int LogFinder::GetRow(int position) const {
+  DCHECK_LT(position, num_positions_);
+  if (has_candidates_) {
+    return down_ ? candidates_[position] :
+        candidates_[candidates_.size() - position - 1];
+  }
+  return down_ ? first_row_ + position : first_row_ - position;
+}
@@ -0,0 +1,171 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Background log message search declaration.
+#ifndef SAWBUCK_VIEWER_LOG_FINDER_H_
+#define SAWBUCK_VIEWER_LOG_FINDER_H_
+
+#include <string>
+#include <vector>
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/cancelable_callback.h"
+#include "base/memory/scoped_ptr.h"
+#include "sawbuck/viewer/row_bitmap.h"
+
+// Forward decls.
+class ILogView;
+namespace pcrecpp {
+class RE;
+}  // namespace pcrecpp
+
+// Searches the messages of a log view for a regular expression, without
+// tying up the thread it runs on for long.
+//
+// The search proceeds in batches, each a posted task, so the thread's
+// message loop keeps running between them. Each batch splits the rows
+// next in line into contiguous blocks, searches the nearest block itself
+// and hands the others to a pool of worker threads, then waits for them.
+// As the view is only accessed while the batch runs, it needn't be thread
+// safe for writes. Blocks past the nearest block with a hit stop early,
+// and the search is done with the first batch that has a hit.
+// A find-all search instead runs through every row, and collects the hits
+// in a row bitmap.
+//
+// Where the view is backed by a store with a message index, only the rows
+// the index yields for the expression's required literal are searched.
+// @note the search covers the rows present when it starts.
+class LogFinder {
+ public:
+  class Delegate {
+   public:
+    // Called when a search completes.
+    // @param row the first matching row in the search direction, or -1
+    //     if no row matches.
+    virtual void OnFindDone(int row) = 0;
+
+    // Called when a find-all search completes, the hits are available
+    // from hits().
+    // @param num_hits the number of matching rows.
+    virtual void OnFindAllDone(int num_hits) = 0;
+  };
+
+  // @param view the view to search, must outlive this instance.
+  // @param delegate receives search completions.
+  LogFinder(ILogView* view, Delegate* delegate);
+  ~LogFinder();
+
+  // Starts a search, cancelling any search in progress.
+  // @param expression a UTF8 regular expression to search for.
+  // @param match_case true iff case matters.
+  // @param down true to search down from @p first_row, false to search up.
+  // @param first_row the row to start searching from, inclusive.
+  void Find(const std::string& expression,
+            bool match_case,
+            bool down,
+            int first_row);
+
+  // Starts a search for all rows that match, cancelling any search in
+  // progress. The hits of a prior find-all are discarded.
+  // @param expression a UTF8 regular expression to search for.
+  // @param match_case true iff case matters.
+  void FindAll(const std::string& expression, bool match_case);
+
+  // Cancels the search in progress, if any. The delegate isn't called.
+  void Cancel();
+
+  // Sets the first row of the view. The rows before it are evicted, and
+  // searches pass over them, including any search in progress.
+  // @note the workers only read this while a batch is in progress on our
+  //     thread, so it's safe to set between batches.
+  void set_view_first_row(int first_row) { view_first_row_ = first_row; }
+
+  // @returns true iff a search is in progress.
+  bool is_finding() const { return !task_.IsCancelled(); }
+
+  // The rows matching the last find-all search, all in place only after
+  // the delegate is told it completed.
+  const RowBitmap& hits() const { return hits_; }
+  // The number of rows the last find-all search covered, rows past these
+  // may match without being in hits().
+  int hits_num_rows() const { return hits_num_rows_; }
+
+  // For testing.
+  void set_max_find_threads(size_t max_find_threads) {
+    max_find_threads_ = max_find_threads;
+  }
+
+  // The number of rows searched by each thread in a batch.
+  static const int kRowsPerBlock = 4096;
+
+ private:
+  // Sets up a search, down or up from @p first_row.
+  void StartFind(const std::string& expression,
+                 bool match_case,
+                 bool down,
+                 int first_row);
+
+  // Searches batches until the time slice is used up, or the search is
+  // done.
+  void FindBatch();
+
+  // Searches the positions [@p begin, @p end) of the search order, as
+  // block number @p block of a batch. Runs concurrently on the task pool.
+  // @returns the first matching row, or -1.
+  int SearchBlock(int block, int begin, int end);
+  // As above, as a task of the pool, with the outcome going to
+  // block_first_hits_.
+  void SearchBlockTask(int block, int begin, int end);
+
+  // @returns the row at @p position in the search order.
+  int GetRow(int position) const;
+
+  ILogView* view_;
+  Delegate* delegate_;
+
+  // The first row of the view, the rows before it are evicted.
+  int view_first_row_;
+
+  // The search in progress.
+  scoped_ptr<pcrecpp::RE> expression_;
+  bool down_;
+  bool find_all_;
+  int first_row_;
+  // If has_candidates_, the message index narrowed the rows to search down
+  // to these, in ascending order.
+  std::vector<int> candidates_;
+  bool has_candidates_;
+  // The number of positions in the search order, and how many are done.
+  int num_positions_;
+  int searched_;
+
+  // The first hit of each block in the batch in progress, or -1.
+  std::vector<int> block_first_hits_;
+  // The hits of each block in the batch in progress, for a find-all.
+  std::vector<std::vector<int> > block_hits_;
+  // The hits of the last find-all.
+  RowBitmap hits_;
+  int hits_num_rows_;
+
+  // The nearest block of the batch in progress that has a hit.
+  base::subtle::Atomic32 nearest_hit_;
+
+  size_t max_find_threads_;
+
+  base::CancelableClosure task_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogFinder);
+};
+
+#endif  // SAWBUCK_VIEWER_LOG_FINDER_H_
@@ -0,0 +1,230 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/log_finder.h"
+
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/strings/stringprintf.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/log_store.h"
+#include "sawbuck/viewer/mock_log_view_interfaces.h"
+
+namespace {
+
+using testing::_;
+using testing::Invoke;
+using testing::Return;
+using testing::StrictMock;
+
+class MockFindDelegate : public LogFinder::Delegate {
+ public:
+  MOCK_METHOD1(OnFindDone, void(int row));
+  MOCK_METHOD1(OnFindAllDone, void(int num_hits));
+};
+
+// The rows with a needle in their message.
+const int kNeedleRows[] = { 5, 4100, 4101, 20000, 33333 };
+const int kNumNeedles = arraysize(kNeedleRows);
+const int kNumRows = 40000;
+
+bool IsNeedleRow(int row) {
+  for (int i = 0; i < kNumNeedles; ++i) {
+    if (kNeedleRows[i] == row)
+      return true;
+  }
+  return false;
+}
+
+std::string GetMessage(int row) {
+  if (IsNeedleRow(row))
+    return base::StringPrintf("Row %d has a Needle in it", row);
+  return base::StringPrintf("Row %d is plain hay", row);
+}
+
+class LogFinderTest : public testing::Test {
+ public:
+  LogFinderTest() : store_(&file_table_), view_first_row_(0) {
+  }
+
+  virtual void SetUp() {
+    for (int i = 0; i < kNumRows; ++i) {
+      store_.AddRow(TRACE_LEVEL_INFORMATION, 1, 1, base::Time(),
+                    StringTable::kEmptyAtom, 0, GetMessage(i), 0, NULL);
+    }
+
+    EXPECT_CALL(view_, GetNumRows()).WillRepeatedly(Return(kNumRows));
+    EXPECT_CALL(view_, GetMessage(_)).WillRepeatedly(Invoke(GetMessage));
+    SetStore(NULL);
+  }
+
+  void SetStore(const LogStore* store) {
+    EXPECT_CALL(view_, GetLogStore()).WillRepeatedly(Return(store));
+  }
+
+  // Runs a search to completion, and expects it to find @p expected_row.
+  void ExpectFind(const char* expression, bool down, int first_row,
+                  int expected_row) {
+    StrictMock<MockFindDelegate> delegate;
+    LogFinder finder(&view_, &delegate);
+    finder.set_max_find_threads(4);
+    finder.set_view_first_row(view_first_row_);
+
+    EXPECT_CALL(delegate, OnFindDone(expected_row)).Times(1);
+    finder.Find(expression, false, down, first_row);
+    EXPECT_TRUE(finder.is_finding());
+
+    base::RunLoop run_loop;
+    run_loop.RunUntilIdle();
+    EXPECT_FALSE(finder.is_finding());
+  }
+
+ protected:
+  base::MessageLoop message_loop_;
+  StringTable file_table_;
+  LogStore store_;
+  StrictMock<testing::MockILogView> view_;
+  // The rows before this are evicted from the view.
+  int view_first_row_;
+};
+
+TEST_F(LogFinderTest, FindDown) {
+  ExpectFind("needle", true, 0, 5);
+  ExpectFind("needle", true, 5, 5);
+  ExpectFind("needle", true, 6, 4100);
+  ExpectFind("needle", true, 4101, 4101);
+  ExpectFind("needle", true, 4102, 20000);
+  ExpectFind("Row 33333 has", true, 0, 33333);
+  ExpectFind("needle", true, 33334, -1);
+  ExpectFind("needle", true, kNumRows, -1);
+}
+
+TEST_F(LogFinderTest, FindUp) {
+  ExpectFind("needle", false, kNumRows - 1, 33333);
+  ExpectFind("needle", false, kNumRows + 10, 33333);
+  ExpectFind("needle", false, 33332, 20000);
+  ExpectFind("needle", false, 19999, 4101);
+  ExpectFind("needle", false, 4100, 4100);
+  ExpectFind("needle", false, 4, -1);
+}
+
+TEST_F(LogFinderTest, FindPastEvictedRows) {
+  view_first_row_ = 4101;
+  ExpectFind("needle", true, 0, 4101);
+  ExpectFind("needle", true, 5, 4101);
+  ExpectFind("needle", false, 19999, 4101);
+  ExpectFind("needle", false, 4100, -1);
+}
+
+TEST_F(LogFinderTest, FindInStore) {
+  SetStore(&store_);
+  ExpectFind("needle", true, 6, 4100);
+  ExpectFind("needle", false, 20001, 20000);
+  ExpectFind("hay$", true, 5, 6);
+  ExpectFind("no such thing", true, 0, -1);
+}
+
+TEST_F(LogFinderTest, FindInIndexedStore) {
+  store_.EnableMessageIndex();
+  SetStore(&store_);
+  ExpectFind("needle", true, 6, 4100);
+  ExpectFind("needle", false, 20001, 20000);
+  ExpectFind("a needle in", true, 4102, 20000);
+  ExpectFind("needle", true, 33334, -1);
+  ExpectFind("no such thing", true, 0, -1);
+}
+
+TEST_F(LogFinderTest, FindAll) {
+  StrictMock<MockFindDelegate> delegate;
+  LogFinder finder(&view_, &delegate);
+  finder.set_max_find_threads(3);
+
+  EXPECT_CALL(delegate, OnFindAllDone(kNumNeedles)).Times(1);
+  finder.FindAll("needle", false);
+  base::RunLoop().RunUntilIdle();
+
+  EXPECT_EQ(kNumRows, finder.hits_num_rows());
+  const RowBitmap& hits = finder.hits();
+  int row = -1;
+  for (int i = 0; i < kNumNeedles; ++i) {
+    row = hits.FindNext(row + 1);
+    EXPECT_EQ(kNeedleRows[i], row);
+  }
+  EXPECT_EQ(-1, hits.FindNext(row + 1));
+
+  // A plain find leaves the hits be.
+  EXPECT_CALL(delegate, OnFindDone(4101)).Times(1);
+  finder.Find("needle", false, false, 20000 - 1);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(kNumNeedles, hits.count());
+
+  // All the hay.
+  EXPECT_CALL(delegate, OnFindAllDone(kNumRows - kNumNeedles)).Times(1);
+  finder.FindAll("hay", false);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_FALSE(hits.Test(5));
+  EXPECT_TRUE(hits.Test(6));
+}
+
+TEST_F(LogFinderTest, FindAllInIndexedStore) {
+  store_.EnableMessageIndex();
+  SetStore(&store_);
+
+  StrictMock<MockFindDelegate> delegate;
+  LogFinder finder(&view_, &delegate);
+
+  EXPECT_CALL(delegate, OnFindAllDone(2)).Times(1);
+  finder.FindAll("Row 410[01] has", true);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(2, finder.hits().CountRange(4100, 4102));
+
+  EXPECT_CALL(delegate, OnFindAllDone(0)).Times(1);
+  finder.FindAll("no such thing", false);
+  base::RunLoop().RunUntilIdle();
+  EXPECT_TRUE(finder.hits().empty());
+}
+
+TEST_F(LogFinderTest, MatchCase) {
+  StrictMock<MockFindDelegate> delegate;
+  LogFinder finder(&view_, &delegate);
+
+  EXPECT_CALL(delegate, OnFindDone(-1)).Times(1);
+  finder.Find("needle", true, true, 0);
+  base::RunLoop().RunUntilIdle();
+
+  EXPECT_CALL(delegate, OnFindDone(5)).Times(1);
+  finder.Find("Needle", true, true, 0);
+  base::RunLoop().RunUntilIdle();
+}
+
+TEST_F(LogFinderTest, Cancel) {
+  StrictMock<MockFindDelegate> delegate;
+  LogFinder finder(&view_, &delegate);
+
+  finder.Find("needle", false, true, 0);
+  EXPECT_TRUE(finder.is_finding());
+  finder.Cancel();
+  EXPECT_FALSE(finder.is_finding());
+
+  // The delegate isn't called.
+  base::RunLoop().RunUntilIdle();
+
+  // A new search supersedes the one in progress.
+  EXPECT_CALL(delegate, OnFindDone(20000)).Times(1);
+  finder.Find("needle", false, true, 0);
+  finder.Find("needle", false, true, 4102);
+  base::RunLoop().RunUntilIdle();
+}
+
+}  // namespace
@@ -0,0 +1,182 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log follower implementation.
+#include "sawbuck/viewer/log_follower.h"
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/time/time.h"
+#include "sawbuck/log_lib/etl_file_reader.h"
+#include "sawbuck/log_lib/event_router.h"
+
+namespace {
+
+// Feeds the events of the buffers read to the parsers.
+class FollowLogConsumer
+    : public EtlEventSink,
+      public LogParser,
+      public KernelLogParser {
+ public:
+  // @param stopped reading stops when this goes non-zero.
+  explicit FollowLogConsumer(const base::subtle::Atomic32* stopped);
+
+  // EtlEventSink implementation.
+  virtual void OnEvent(EVENT_TRACE* event);
+  virtual bool OnBufferRead(size_t buffers_read);
+  virtual void OnBuffersLost(int64 time_stamp, size_t num_buffers);
+
+ private:
+  const base::subtle::Atomic32* stopped_;
+
+  // Routes the events to the parser for their class.
+  EventRouter router_;
+};
+
+FollowLogConsumer::FollowLogConsumer(const base::subtle::Atomic32* stopped)
+    : stopped_(stopped) {
+  DCHECK(stopped != NULL);
+
+  LogParser::AddEventClasses(&router_);
+  KernelLogParser::AddEventClasses(&router_);
+}
+
+void FollowLogConsumer::OnEvent(EVENT_TRACE* event) {
+  if (!router_.ProcessOneEvent(event))
+    LOG(INFO) << "Unknown event";
+}
+
+bool FollowLogConsumer::OnBufferRead(size_t buffers_read) {
+  // Flushing here keeps the batches to a buffer's worth.
+  FlushLogMessages();
+
+  // Returning false stops the reading.
+  return !base::subtle::Acquire_Load(stopped_);
+}
+
+void FollowLogConsumer::OnBuffersLost(int64 time_stamp, size_t num_buffers) {
+  LogEvents::EventLoss loss;
+  loss.time = base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(time_stamp));
+  loss.type = LogEvents::EventLoss::BUFFERS_LOST;
+  loss.count = static_cast<uint32>(num_buffers);
+  DeliverEventLoss(loss);
+}
+
+}  // namespace
+
+const int LogFollower::kPollIntervalMs;
+const int LogFollower::kCheckDoneIntervalMs;
+
+LogFollower::LogFollower(StringTable* file_table,
+                         LogEvents* event_sink,
+                         TraceEvents* trace_sink,
+                         KernelProcessEvents* process_sink,
+                         KernelModuleEvents* module_sink,
+                         Delegate* delegate)
+    : file_table_(file_table),
+      event_sink_(event_sink),
+      trace_sink_(trace_sink),
+      process_sink_(process_sink),
+      module_sink_(module_sink),
+      delegate_(delegate),
+      origin_loop_(NULL),
+      stopped_(0),
+      stop_event_(true, false),
+      done_(0),
+      result_(S_OK),
+      follow_thread_("Log follower"),
+      check_done_task_(base::Bind(&LogFollower::CheckDone,
+                                  base::Unretained(this))) {
+  DCHECK(file_table != NULL);
+  DCHECK(delegate != NULL);
+}
+
+LogFollower::~LogFollower() {
+  Stop();
+  check_done_task_.Cancel();
+  follow_thread_.Stop();
+}
+
+void LogFollower::Start(const base::FilePath& path) {
+  DCHECK(origin_loop_ == NULL);
+  origin_loop_ = base::MessageLoop::current();
+  DCHECK(origin_loop_ != NULL);
+
+  CHECK(follow_thread_.Start());
+  follow_thread_.message_loop()->PostTask(FROM_HERE,
+      base::Bind(&LogFollower::Follow, base::Unretained(this), path));
+
+  origin_loop_->PostDelayedTask(FROM_HERE,
+      check_done_task_.callback(),
+      base::TimeDelta::FromMilliseconds(kCheckDoneIntervalMs));
+}
+
+void LogFollower::Stop() {
+  base::subtle::Release_Store(&stopped_, 1);
+  stop_event_.Signal();
+}
+
+void LogFollower::Follow(const base::FilePath& path) {
+  FollowLogConsumer consumer(&stopped_);
+  consumer.set_event_sink(event_sink_);
+  consumer.set_trace_sink(trace_sink_);
+  consumer.set_string_table(file_table_);
+  consumer.set_batch_log_messages(true);
+  consumer.set_process_event_sink(process_sink_);
+  consumer.set_module_event_sink(module_sink_);
+
+  EtlFileReader reader;
+  HRESULT hr = reader.Open(path);
+  size_t buffers_read = 0;
+  while (SUCCEEDED(hr)) {
+    size_t num_buffers = reader.num_buffers();
+    hr = reader.ConsumeBuffers(buffers_read, num_buffers, &consumer);
+    // The messages refer to the mapped file, which the refresh remaps.
+    consumer.FlushLogMessages();
+    buffers_read = num_buffers;
+
+    if (hr == E_ABORT ||
+        stop_event_.TimedWait(
+            base::TimeDelta::FromMilliseconds(kPollIntervalMs))) {
+      hr = S_OK;
+      break;
+    }
+
+    size_t num_new_buffers = 0;
+    hr = reader.Refresh(&num_new_buffers);
+  }
+
+  if (FAILED(hr)) {
+    LOG(ERROR) << "Stopped following \"" << path.value() << "\", error "
+        << hr;
+  }
+
+  result_ = hr;
+  base::subtle::Release_Store(&done_, 1);
+}
+
+void LogFollower::CheckDone() {
+  DCHECK_EQ(origin_loop_, base::MessageLoop::current());
+
+  if (!base::subtle::Acquire_Load(&done_)) {
+    origin_loop_->PostDelayedTask(FROM_HERE,
+        check_done_task_.callback(),
+        base::TimeDelta::FromMilliseconds(kCheckDoneIntervalMs));
+    return;
+  }
+
+  follow_thread_.Stop();
+  delegate_->OnLogFollowDone(result_);
+}
@@ -0,0 +1,112 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log follower declaration.
+#ifndef SAWBUCK_VIEWER_LOG_FOLLOWER_H_
+#define SAWBUCK_VIEWER_LOG_FOLLOWER_H_
+
+#include <windows.h>
+#include "base/atomicops.h"
+#include "base/cancelable_callback.h"
+#include "base/files/file_path.h"
+#include "base/message_loop/message_loop.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/log_lib/log_consumer.h"
+
+// Follows an ETW log file that's still being written, such as that of a
+// file-backed session sawdust runs. The file is mapped on a thread of its
+// own, which polls it for the buffers the session flushed since, reads
+// them, and issues their events to the sinks as the local consumers would.
+// Watching a session this way takes no real time session of our own, and
+// costs the traced system nothing past writing its file.
+// @note the events are in time order within each poll of the file, and
+//    close to it across polls, as each processor's buffers are flushed
+//    in turn.
+class LogFollower {
+ public:
+  // Implemented by the clients of LogFollower, which are called back on
+  // the thread that started following.
+  class Delegate {
+   public:
+    // Issued once the following stopped, or failed.
+    // @param hr S_OK if it was stopped, the error that ended it otherwise,
+    //     e.g. if the file wrapped around.
+    virtual void OnLogFollowDone(HRESULT hr) = 0;
+  };
+
+  // @param file_table the table file names are interned to.
+  // @param event_sink receives the log messages.
+  // @param trace_sink receives the trace events.
+  // @param process_sink receives the kernel process events.
+  // @param module_sink receives the kernel module events.
+  // @param delegate receives the completion notification.
+  // @note the sinks are invoked on the follow thread, and all parameters
+  //    must outlive this instance.
+  LogFollower(StringTable* file_table,
+              LogEvents* event_sink,
+              TraceEvents* trace_sink,
+              KernelProcessEvents* process_sink,
+              KernelModuleEvents* module_sink,
+              Delegate* delegate);
+
+  // Stops following and waits for the thread to wind up.
+  ~LogFollower();
+
+  // Starts following the log file at @p path in the background, from its
+  // first buffer. Must be called once, on a thread with a message loop.
+  void Start(const base::FilePath& path);
+
+  // Stops following, the delegate gets its OnLogFollowDone shortly.
+  void Stop();
+
+  // The interval at which the file is polled for new buffers.
+  static const int kPollIntervalMs = 500;
+  // The interval at which the follow thread is checked for completion.
+  static const int kCheckDoneIntervalMs = 200;
+
+ private:
+  // Runs on the follow thread.
+  void Follow(const base::FilePath& path);
+
+  // Calls back the delegate once the follow thread is done.
+  void CheckDone();
+
+  StringTable* file_table_;
+  LogEvents* event_sink_;
+  TraceEvents* trace_sink_;
+  KernelProcessEvents* process_sink_;
+  KernelModuleEvents* module_sink_;
+  Delegate* delegate_;
+
+  // The loop we were started on, where the delegate is called back.
+  base::MessageLoop* origin_loop_;
+
+  // Non-zero once we're stopped, read by the follow thread, which also
+  // waits on stop_event_ between polls.
+  base::subtle::Atomic32 stopped_;
+  base::WaitableEvent stop_event_;
+
+  // Non-zero once the follow thread is done, after it stores result_.
+  base::subtle::Atomic32 done_;
+  HRESULT result_;
+
+  base::Thread follow_thread_;
+  base::CancelableClosure check_done_task_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogFollower);
+};
+
+#endif  // SAWBUCK_VIEWER_LOG_FOLLOWER_H_
@@ -0,0 +1,123 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log follower unittests.
+#include "sawbuck/viewer/log_follower.h"
+
+#include <string>
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/path_service.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using testing::_;
+using testing::AtLeast;
+using testing::InvokeWithoutArgs;
+using testing::NiceMock;
+
+class MockKernelModuleEvents: public KernelModuleEvents {
+ public:
+  MOCK_METHOD3(OnModuleIsLoaded, void(DWORD process_id,
+                                      const base::Time& time,
+                                      const ModuleInformation& module_info));
+  MOCK_METHOD3(OnModuleUnload, void(DWORD process_id,
+                                    const base::Time& time,
+                                    const ModuleInformation& module_info));
+  MOCK_METHOD3(OnModuleLoad, void(DWORD process_id,
+                                  const base::Time& time,
+                                  const ModuleInformation& module_info));
+};
+
+class MockDelegate : public LogFollower::Delegate {
+ public:
+  MOCK_METHOD1(OnLogFollowDone, void(HRESULT hr));
+};
+
+class LogFollowerTest : public testing::Test {
+ public:
+  LogFollowerTest()
+      : follower_(&file_table_, NULL, NULL, NULL, &module_events_,
+                  &delegate_) {
+  }
+
+  virtual void SetUp() {
+    base::FilePath src_root;
+    ASSERT_TRUE(PathService::Get(base::DIR_SOURCE_ROOT, &src_root));
+    test_data_dir_ = src_root.AppendASCII("sawbuck\\log_lib\\test_data");
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+  void QuitMessageLoop() {
+    message_loop_.Quit();
+  }
+
+ protected:
+  base::MessageLoop message_loop_;
+  base::FilePath test_data_dir_;
+  base::ScopedTempDir temp_dir_;
+
+  StringTable file_table_;
+  NiceMock<MockKernelModuleEvents> module_events_;
+  NiceMock<MockDelegate> delegate_;
+  LogFollower follower_;
+};
+
+}  // namespace
+
+TEST_F(LogFollowerTest, FailsForMissingFile) {
+  EXPECT_CALL(delegate_, OnLogFollowDone(testing::Ne(S_OK))).WillOnce(
+      InvokeWithoutArgs(this, &LogFollowerTest::QuitMessageLoop));
+  follower_.Start(temp_dir_.path().Append(L"does_not_exist.etl"));
+  message_loop_.Run();
+}
+
+TEST_F(LogFollowerTest, FollowsGrowingFile) {
+  std::string contents;
+  ASSERT_TRUE(base::ReadFileToString(
+      test_data_dir_.Append(L"image_data_32_v0.etl"), &contents));
+  const size_t kBufferSize = 65536;
+  ASSERT_EQ(3 * kBufferSize, contents.size());
+
+  // The module load is the last event of the log, which ends the test.
+  EXPECT_CALL(module_events_, OnModuleIsLoaded(_, _, _)).Times(AtLeast(1));
+  EXPECT_CALL(module_events_, OnModuleLoad(_, _, _)).WillOnce(
+      InvokeWithoutArgs(&follower_, &LogFollower::Stop));
+  EXPECT_CALL(delegate_, OnLogFollowDone(S_OK)).WillOnce(
+      InvokeWithoutArgs(this, &LogFollowerTest::QuitMessageLoop));
+
+  // The session has flushed its first buffer, the header, when we start,
+  // and the rest as we follow.
+  base::FilePath path(temp_dir_.path().Append(L"growing.etl"));
+  ASSERT_EQ(static_cast<int>(kBufferSize),
+            base::WriteFile(path, contents.data(), kBufferSize));
+  follower_.Start(path);
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            base::WriteFile(path, contents.data(), contents.size()));
+  message_loop_.Run();
+}
+
+TEST_F(LogFollowerTest, Stop) {
+  base::FilePath path(temp_dir_.path().Append(L"copy.etl"));
+  ASSERT_TRUE(base::CopyFile(test_data_dir_.Append(L"image_data_32_v0.etl"),
+                             path));
+
+  EXPECT_CALL(delegate_, OnLogFollowDone(S_OK)).WillOnce(
+      InvokeWithoutArgs(this, &LogFollowerTest::QuitMessageLoop));
+  follower_.Start(path);
+  follower_.Stop();
+  message_loop_.Run();
+}
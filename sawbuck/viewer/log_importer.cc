@@ -0,0 +1,674 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Background log file importer implementation.
+#include "sawbuck/viewer/log_importer.h"
+
+#include <algorithm>
+#include "base/bind.h"
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+#include "base/time/time.h"
+#include "sawbuck/common/perf_counters.h"
+#include "sawbuck/log_lib/etl_file_reader.h"
+#include "sawbuck/log_lib/event_router.h"
+#include "sawbuck/viewer/log_index.h"
+
+namespace {
+
+PerfCounter import_file_counter("Import.File", 1);
+
+// Parses @p text as a number of seconds into @p delta, empty for zero.
+bool ParseSeconds(const std::string& text, base::TimeDelta* delta) {
+  DCHECK(delta != NULL);
+
+  std::string trimmed;
+  base::TrimWhitespaceASCII(text, base::TRIM_ALL, &trimmed);
+  double seconds = 0;
+  if (!trimmed.empty() &&
+      (!base::StringToDouble(trimmed, &seconds) || !(seconds >= 0))) {
+    return false;
+  }
+
+  *delta = base::TimeDelta::FromMicroseconds(
+      static_cast<int64>(seconds * base::Time::kMicrosecondsPerSecond));
+  return true;
+}
+
+// Applies the scope of an import to a log file.
+class ScopeFilter {
+ public:
+  // @param reader the file the scope applies to, which must be open, and
+  //     outlive us.
+  ScopeFilter(const LogImporter::Scope& scope, EtlFileReader* reader);
+
+  // @returns false iff @p event is a row outside the scope.
+  bool Includes(const EVENT_TRACE* event) const;
+
+  // @returns the number of buffers Consume reads, less the header's.
+  size_t num_buffers() const { return last_ - first_; }
+
+  // Consumes the buffers that may hold rows in scope to @p sink. The
+  // buffer of the log file header is read ahead of them if they miss it,
+  // as the parsers take the layout of the events from its header event.
+  HRESULT Consume(EtlEventSink* sink);
+
+ private:
+  const LogImporter::Scope& scope_;
+  EtlFileReader* reader_;
+  // The stretch in scope, as the reader issues time stamps.
+  int64 begin_;
+  int64 end_;
+  // The buffers that may hold rows in the stretch.
+  size_t first_;
+  size_t last_;
+};
+
+ScopeFilter::ScopeFilter(const LogImporter::Scope& scope,
+                         EtlFileReader* reader)
+    : scope_(scope), reader_(reader), begin_(kint64min), end_(kint64max),
+      first_(0), last_(reader->num_buffers()) {
+  if (scope.begin == base::TimeDelta() && scope.duration == base::TimeDelta())
+    return;
+
+  // The reader issues file times, in 100 ns units.
+  begin_ = reader->start_time() + scope.begin.InMicroseconds() * 10;
+  if (scope.duration != base::TimeDelta())
+    end_ = begin_ + scope.duration.InMicroseconds() * 10;
+  reader->FindTimeRange(begin_, end_, &first_, &last_);
+}
+
+bool ScopeFilter::Includes(const EVENT_TRACE* event) const {
+  if (!LazyLogFile::IsRowEvent(event))
+    return true;
+
+  int64 time = event->Header.TimeStamp.QuadPart;
+  if (time < begin_ || time >= end_)
+    return false;
+
+  return scope_.process_ids.empty() ||
+      std::binary_search(scope_.process_ids.begin(),
+                         scope_.process_ids.end(),
+                         static_cast<DWORD>(event->Header.ProcessId));
+}
+
+HRESULT ScopeFilter::Consume(EtlEventSink* sink) {
+  if (first_ != 0 && first_ < last_)
+    reader_->ReadBuffer(0, sink);
+  return reader_->ConsumeBuffers(first_, last_, sink);
+}
+
+// Feeds the events of a log file to the parsers on behalf of a worker.
+class ImportLogConsumer
+    : public EtlEventSink,
+      public LogParser,
+      public KernelLogParser {
+ public:
+  // @param filter tells the events to import.
+  // @param cancelled consumption stops when this goes non-zero.
+  // @param buffers_read receives the number of buffers consumed.
+  ImportLogConsumer(const ScopeFilter* filter,
+                    const base::subtle::Atomic32* cancelled,
+                    base::subtle::Atomic32* buffers_read);
+
+  // EtlEventSink implementation.
+  virtual void OnEvent(EVENT_TRACE* event);
+  virtual bool OnBufferRead(size_t buffers_read);
+  virtual void OnBuffersLost(int64 time_stamp, size_t num_buffers);
+
+ private:
+  const ScopeFilter* filter_;
+  const base::subtle::Atomic32* cancelled_;
+  base::subtle::Atomic32* buffers_read_;
+
+  // Routes the events to the parser for their class.
+  EventRouter router_;
+};
+
+ImportLogConsumer::ImportLogConsumer(const ScopeFilter* filter,
+                                     const base::subtle::Atomic32* cancelled,
+                                     base::subtle::Atomic32* buffers_read)
+    : filter_(filter), cancelled_(cancelled), buffers_read_(buffers_read) {
+  DCHECK(filter != NULL);
+  DCHECK(cancelled != NULL);
+  DCHECK(buffers_read != NULL);
+
+  LogParser::AddEventClasses(&router_);
+  KernelLogParser::AddEventClasses(&router_);
+}
+
+void ImportLogConsumer::OnEvent(EVENT_TRACE* event) {
+  if (!filter_->Includes(event))
+    return;
+  if (!router_.ProcessOneEvent(event))
+    LOG(INFO) << "Unknown event";
+}
+
+bool ImportLogConsumer::OnBufferRead(size_t buffers_read) {
+  // The event data stays mapped until the reader is closed, but flushing
+  // here keeps the batches to a buffer's worth.
+  FlushLogMessages();
+
+  base::subtle::NoBarrier_Store(buffers_read_,
+      static_cast<base::subtle::Atomic32>(buffers_read));
+
+  // Returning false stops the consumption.
+  return !base::subtle::Acquire_Load(cancelled_);
+}
+
+void ImportLogConsumer::OnBuffersLost(int64 time_stamp, size_t num_buffers) {
+  LogEvents::EventLoss loss;
+  loss.time = base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(time_stamp));
+  loss.type = LogEvents::EventLoss::BUFFERS_LOST;
+  loss.count = static_cast<uint32>(num_buffers);
+  DeliverEventLoss(loss);
+}
+
+// Indexes the rows of a log file for a lazy import on behalf of a worker,
+// and feeds the kernel events to the kernel parser.
+class LazyIndexConsumer
+    : public EtlEventSink,
+      public KernelLogParser {
+ public:
+  // @param file the file to index, which must be open.
+  // @param filter tells the events to index.
+  // @param cancelled consumption stops when this goes non-zero.
+  // @param buffers_read receives the number of buffers consumed.
+  LazyIndexConsumer(LazyLogFile* file,
+                    const ScopeFilter* filter,
+                    const base::subtle::Atomic32* cancelled,
+                    base::subtle::Atomic32* buffers_read);
+
+  // EtlEventSink implementation.
+  virtual void OnEvent(EVENT_TRACE* event);
+  virtual bool OnBufferRead(size_t buffers_read);
+
+ private:
+  LazyLogFile* file_;
+  const ScopeFilter* filter_;
+  const base::subtle::Atomic32* cancelled_;
+  base::subtle::Atomic32* buffers_read_;
+
+  // Routes the kernel events to the kernel parser.
+  EventRouter router_;
+};
+
+LazyIndexConsumer::LazyIndexConsumer(LazyLogFile* file,
+                                     const ScopeFilter* filter,
+                                     const base::subtle::Atomic32* cancelled,
+                                     base::subtle::Atomic32* buffers_read)
+    : file_(file), filter_(filter), cancelled_(cancelled),
+      buffers_read_(buffers_read) {
+  DCHECK(file != NULL);
+  DCHECK(filter != NULL);
+  DCHECK(cancelled != NULL);
+  DCHECK(buffers_read != NULL);
+
+  KernelLogParser::AddEventClasses(&router_);
+}
+
+void LazyIndexConsumer::OnEvent(EVENT_TRACE* event) {
+  // The rows are decoded as they're read, all we need now is where they are.
+  if (LazyLogFile::IsRowEvent(event)) {
+    if (filter_->Includes(event))
+      file_->AddRow(event, file_->reader()->current_position());
+    return;
+  }
+
+  router_.ProcessOneEvent(event);
+}
+
+bool LazyIndexConsumer::OnBufferRead(size_t buffers_read) {
+  base::subtle::NoBarrier_Store(buffers_read_,
+      static_cast<base::subtle::Atomic32>(buffers_read));
+
+  // Returning false stops the consumption.
+  return !base::subtle::Acquire_Load(cancelled_);
+}
+
+}  // namespace
+
+// Consumes a single file, or a log entry of an archive, into a staging
+// store, as a task of the importer's group on the task pool.
+class LogImporter::Worker : public LogEvents, public TraceEvents {
+ public:
+  // @param entry the log entry to consume if @p path is an archive, empty
+  //     otherwise.
+  Worker(LogImporter* importer,
+         const base::FilePath& path,
+         const std::string& entry);
+
+  // Posts the consumption to @p group.
+  void Start(TaskPool::TaskGroup* group);
+
+  // Accessors, may be called from any thread.
+  // @{
+  bool done() const { return base::subtle::Acquire_Load(&done_) != 0; }
+  int buffers_read() const {
+    return base::subtle::NoBarrier_Load(&buffers_read_);
+  }
+  int buffers_total() const {
+    return base::subtle::NoBarrier_Load(&buffers_total_);
+  }
+  // @}
+
+  // Accessors, valid once done.
+  // @{
+  HRESULT result() const { return result_; }
+  const LogStore& store() const { return store_; }
+  const LossCounts& loss_counts() const { return loss_counts_; }
+  // Releases the indexed file of a lazy import.
+  LazyLogFile* ReleaseLazyFile() { return lazy_file_.release(); }
+  // @}
+
+ private:
+  // Runs on the task pool.
+  void Consume();
+  // Runs on the task pool for lazy imports.
+  void ConsumeLazily();
+  // Runs on the task pool for archive entries.
+  void ConsumeArchiveEntry();
+  // Consumes the log file at @p path into store_, on the task pool.
+  HRESULT ConsumeFile(const base::FilePath& path);
+
+  // LogEvents implementation.
+  virtual void OnLogMessage(const LogEvents::LogMessage& log_message);
+  virtual void OnEventLoss(const LogEvents::EventLoss& event_loss);
+
+  // TraceEvents implementation.
+  virtual void OnTraceEventBegin(
+      const TraceEvents::TraceMessage& trace_message);
+  virtual void OnTraceEventEnd(
+      const TraceEvents::TraceMessage& trace_message);
+  virtual void OnTraceEventInstant(
+      const TraceEvents::TraceMessage& trace_message);
+
+  LogImporter* importer_;
+  base::FilePath path_;
+  std::string entry_;
+
+  // The imported rows, only accessed by the consuming task until done.
+  LogStore store_;
+  // Or the indexed file, for lazy imports.
+  scoped_ptr<LazyLogFile> lazy_file_;
+  // Relays the kernel events of the file, and loads or saves its index.
+  LogIndex index_;
+  HRESULT result_;
+  LossCounts loss_counts_;
+  // The buffers lost in gaps, only accessed by the consuming task.
+  uint64 gap_buffers_;
+
+  base::subtle::Atomic32 buffers_read_;
+  base::subtle::Atomic32 buffers_total_;
+  base::subtle::Atomic32 done_;
+};
+
+LogImporter::Worker::Worker(LogImporter* importer,
+                            const base::FilePath& path,
+                            const std::string& entry)
+    : importer_(importer),
+      path_(path),
+      entry_(entry),
+      store_(importer->file_table_),
+      index_(importer->process_sink_, importer->module_sink_),
+      result_(S_OK),
+      gap_buffers_(0),
+      buffers_read_(0),
+      buffers_total_(0),
+      done_(0) {
+}
+
+void LogImporter::Worker::Start(TaskPool::TaskGroup* group) {
+  DCHECK(group != NULL);
+  group->Post(base::Bind(&Worker::Consume, base::Unretained(this)));
+}
+
+void LogImporter::Worker::Consume() {
+  // The files still queued when we're cancelled aren't opened at all.
+  if (base::subtle::Acquire_Load(&importer_->cancelled_)) {
+    result_ = E_ABORT;
+    base::subtle::Release_Store(&done_, 1);
+    return;
+  }
+  if (!entry_.empty()) {
+    ConsumeArchiveEntry();
+    return;
+  }
+  if (importer_->lazy_) {
+    ConsumeLazily();
+    return;
+  }
+
+  // An up-to-date index saves parsing the file. It holds all of it.
+  bool whole = importer_->scope_.IsWhole();
+  if (whole && index_.Load(path_, &store_)) {
+    // The markers come back with the rows, but not the counts.
+    for (int row = store_.first_row(); row < store_.num_rows(); ++row) {
+      if (store_.IsLossMarker(row))
+        ++loss_counts_.num_markers;
+    }
+    base::subtle::NoBarrier_Store(&buffers_total_, 1);
+    base::subtle::NoBarrier_Store(&buffers_read_, 1);
+    result_ = S_OK;
+    base::subtle::Release_Store(&done_, 1);
+    return;
+  }
+
+  HRESULT hr = ConsumeFile(path_);
+
+  // Failing to save the index is not an import error, the log may well
+  // be on read-only media.
+  if (SUCCEEDED(hr) && whole && !index_.Save(path_, store_))
+    LOG(WARNING) << "Failed to save index for \"" << path_.value() << "\".";
+
+  result_ = hr;
+  base::subtle::Release_Store(&done_, 1);
+}
+
+void LogImporter::Worker::ConsumeArchiveEntry() {
+  // The entry is inflated to a file of its own, which is mapped as any
+  // other log file, and goes once consumed. It isn't indexed, as the index
+  // wouldn't outlive it.
+  ReportArchive archive;
+  base::FilePath log_path;
+  HRESULT hr = E_FAIL;
+  if (archive.Open(path_) && base::CreateTemporaryFile(&log_path))
+    hr = archive.ExtractEntry(entry_, log_path, &importer_->cancelled_);
+  archive.Close();
+
+  if (SUCCEEDED(hr))
+    hr = ConsumeFile(log_path);
+  else if (hr != E_ABORT)
+    LOG(ERROR) << "Failed to inflate \"" << entry_ << "\", error " << hr;
+
+  if (!log_path.empty())
+    base::DeleteFile(log_path, false);
+
+  result_ = hr;
+  base::subtle::Release_Store(&done_, 1);
+}
+
+HRESULT LogImporter::Worker::ConsumeFile(const base::FilePath& path) {
+  EtlFileReader reader;
+  HRESULT hr = reader.Open(path);
+  if (SUCCEEDED(hr)) {
+    ScopeFilter filter(importer_->scope_, &reader);
+    base::subtle::NoBarrier_Store(&buffers_total_,
+        static_cast<base::subtle::Atomic32>(filter.num_buffers()));
+
+    ImportLogConsumer consumer(&filter, &importer_->cancelled_,
+                               &buffers_read_);
+    consumer.set_event_sink(this);
+    consumer.set_trace_sink(this);
+    consumer.set_string_table(importer_->file_table_);
+    consumer.set_batch_log_messages(true);
+    consumer.set_process_event_sink(&index_);
+    consumer.set_module_event_sink(&index_);
+
+    hr = filter.Consume(&consumer);
+    // The messages refer to the mapped file, flush before it goes away.
+    consumer.FlushLogMessages();
+
+    loss_counts_.events_lost = reader.events_lost();
+    loss_counts_.buffers_lost =
+        std::max<uint64>(reader.buffers_lost(), gap_buffers_);
+  } else {
+    LOG(ERROR) << "Failed to open log file \"" << path.value()
+        << "\", error " << hr;
+  }
+
+  return hr;
+}
+
+void LogImporter::Worker::ConsumeLazily() {
+  lazy_file_.reset(new LazyLogFile());
+  HRESULT hr = lazy_file_->Open(path_);
+  if (SUCCEEDED(hr)) {
+    EtlFileReader* reader = lazy_file_->reader();
+    ScopeFilter filter(importer_->scope_, reader);
+    base::subtle::NoBarrier_Store(&buffers_total_,
+        static_cast<base::subtle::Atomic32>(filter.num_buffers()));
+
+    LazyIndexConsumer consumer(lazy_file_.get(), &filter,
+                               &importer_->cancelled_, &buffers_read_);
+    consumer.set_process_event_sink(&index_);
+    consumer.set_module_event_sink(&index_);
+    hr = filter.Consume(&consumer);
+  } else {
+    LOG(ERROR) << "Failed to open log file \"" << path_.value()
+        << "\", error " << hr;
+    lazy_file_.reset();
+  }
+
+  result_ = hr;
+  base::subtle::Release_Store(&done_, 1);
+}
+
+void LogImporter::Worker::OnLogMessage(
+    const LogEvents::LogMessage& log_message) {
+  store_.AddLogMessage(log_message);
+}
+
+void LogImporter::Worker::OnEventLoss(const LogEvents::EventLoss& event_loss) {
+  store_.AddLossMarker(event_loss);
+  ++loss_counts_.num_markers;
+  if (event_loss.type == LogEvents::EventLoss::BUFFERS_LOST)
+    gap_buffers_ += event_loss.count;
+}
+
+void LogImporter::Worker::OnTraceEventBegin(
+    const TraceEvents::TraceMessage& trace_message) {
+  store_.AddTraceMessage("BEGIN", trace_message);
+}
+
+void LogImporter::Worker::OnTraceEventEnd(
+    const TraceEvents::TraceMessage& trace_message) {
+  store_.AddTraceMessage("END", trace_message);
+}
+
+void LogImporter::Worker::OnTraceEventInstant(
+    const TraceEvents::TraceMessage& trace_message) {
+  store_.AddTraceMessage("INSTANT", trace_message);
+}
+
+bool LogImporter::ParseScope(const std::string& begin,
+                             const std::string& duration,
+                             const std::string& process_ids,
+                             Scope* scope) {
+  DCHECK(scope != NULL);
+
+  Scope parsed;
+  if (!ParseSeconds(begin, &parsed.begin) ||
+      !ParseSeconds(duration, &parsed.duration)) {
+    return false;
+  }
+
+  // The pieces come trimmed of whitespace.
+  std::vector<std::string> ids;
+  base::SplitString(process_ids, ',', &ids);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    unsigned int id = 0;
+    if (ids[i].empty())
+      continue;
+    if (!base::StringToUint(ids[i], &id))
+      return false;
+    parsed.process_ids.push_back(id);
+  }
+  std::sort(parsed.process_ids.begin(), parsed.process_ids.end());
+  parsed.process_ids.erase(
+      std::unique(parsed.process_ids.begin(), parsed.process_ids.end()),
+      parsed.process_ids.end());
+
+  *scope = parsed;
+  return true;
+}
+
+const int LogImporter::kProgressIntervalMs;
+const size_t LogImporter::kMaxReportTextSize;
+
+LogImporter::LogImporter(StringTable* file_table,
+                         KernelProcessEvents* process_sink,
+                         KernelModuleEvents* module_sink,
+                         Delegate* delegate)
+    : file_table_(file_table),
+      process_sink_(process_sink),
+      module_sink_(module_sink),
+      delegate_(delegate),
+      lazy_(false),
+      origin_loop_(NULL),
+      cancelled_(0),
+      start_result_(S_OK),
+      num_duplicates_(0),
+      check_progress_task_(base::Bind(&LogImporter::CheckProgress,
+                                      base::Unretained(this))),
+      group_(TaskPool::Get(), TaskPool::PRIORITY_INTERACTIVE,
+             &import_file_counter) {
+  DCHECK(file_table != NULL);
+  DCHECK(delegate != NULL);
+}
+
+LogImporter::~LogImporter() {
+  Cancel();
+  check_progress_task_.Cancel();
+
+  // The tasks are left to run, rather than be skipped, as the ones still
+  // queued wind up at once.
+  group_.Wait();
+}
+
+void LogImporter::Start(const std::vector<base::FilePath>& paths) {
+  DCHECK(origin_loop_ == NULL);
+  origin_loop_ = base::MessageLoop::current();
+  DCHECK(origin_loop_ != NULL);
+
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (ReportArchive::IsReportArchive(paths[i]))
+      StartArchive(paths[i]);
+    else
+      StartWorker(paths[i], std::string());
+  }
+
+  // The first check reports completion right away if nothing started.
+  origin_loop_->PostTask(FROM_HERE, check_progress_task_.callback());
+}
+
+void LogImporter::StartWorker(const base::FilePath& path,
+                              const std::string& entry) {
+  workers_.push_back(new Worker(this, path, entry));
+  workers_.back()->Start(&group_);
+}
+
+void LogImporter::StartArchive(const base::FilePath& path) {
+  // The inflated entries don't outlive the import, while a lazy import
+  // keeps its files mapped.
+  ReportArchive archive;
+  if (lazy_ || !archive.Open(path)) {
+    LOG(ERROR) << "Can't import archive \"" << path.value() << "\".";
+    if (SUCCEEDED(start_result_))
+      start_result_ = E_FAIL;
+    return;
+  }
+
+  // The text entries are small enough to read here.
+  archive.ReadTextEntries(kMaxReportTextSize, &report_texts_);
+
+  std::vector<std::string> entries;
+  archive.GetLogEntries(&entries);
+  for (size_t i = 0; i < entries.size(); ++i)
+    StartWorker(path, entries[i]);
+}
+
+void LogImporter::Cancel() {
+  base::subtle::Release_Store(&cancelled_, 1);
+}
+
+void LogImporter::MergeInto(LogStore* store) {
+  DCHECK(store != NULL);
+
+  std::vector<const LogStore*> sources;
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    DCHECK(workers_[i]->done());
+    sources.push_back(&workers_[i]->store());
+  }
+
+  num_duplicates_ = store->MergeFrom(sources, true);
+}
+
+void LogImporter::MergeInto(LazyLog* log) {
+  DCHECK(log != NULL);
+  DCHECK(lazy_);
+
+  ScopedVector<LazyLogFile> files;
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    DCHECK(workers_[i]->done());
+    LazyLogFile* file = workers_[i]->ReleaseLazyFile();
+    if (file != NULL)
+      files.push_back(file);
+  }
+
+  log->MergeFrom(&files);
+}
+
+LogImporter::LossCounts LogImporter::GetLossCounts() const {
+  LossCounts counts;
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    DCHECK(workers_[i]->done());
+    const LossCounts& worker_counts = workers_[i]->loss_counts();
+    counts.events_lost += worker_counts.events_lost;
+    counts.buffers_lost += worker_counts.buffers_lost;
+    counts.num_markers += worker_counts.num_markers;
+  }
+
+  return counts;
+}
+
+void LogImporter::CheckProgress() {
+  DCHECK_EQ(origin_loop_, base::MessageLoop::current());
+
+  bool all_done = true;
+  int64 buffers_read = 0;
+  int64 buffers_total = 0;
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    all_done = all_done && workers_[i]->done();
+    buffers_read += workers_[i]->buffers_read();
+    buffers_total += workers_[i]->buffers_total();
+  }
+
+  if (!all_done) {
+    int percent_done = 0;
+    if (buffers_total != 0)
+      percent_done = static_cast<int>(100 * buffers_read / buffers_total);
+    delegate_->OnImportProgress(percent_done);
+
+    origin_loop_->PostDelayedTask(FROM_HERE,
+        check_progress_task_.callback(),
+        base::TimeDelta::FromMilliseconds(kProgressIntervalMs));
+    return;
+  }
+
+  // The workers are done, their tasks are only winding up.
+  group_.Wait();
+  HRESULT hr = start_result_;
+  for (size_t i = 0; i < workers_.size() && SUCCEEDED(hr); ++i)
+    hr = workers_[i]->result();
+
+  if (SUCCEEDED(hr) && base::subtle::Acquire_Load(&cancelled_))
+    hr = E_ABORT;
+
+  delegate_->OnImportDone(hr);
+}
@@ -0,0 +1,207 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Background log file importer declaration.
+#ifndef SAWBUCK_VIEWER_LOG_IMPORTER_H_
+#define SAWBUCK_VIEWER_LOG_IMPORTER_H_
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "base/atomicops.h"
+#include "base/cancelable_callback.h"
+#include "base/files/file_path.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop/message_loop.h"
+#include "base/time/time.h"
+#include "sawbuck/common/task_pool.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/viewer/lazy_log.h"
+#include "sawbuck/viewer/log_store.h"
+#include "sawbuck/viewer/report_archive.h"
+
+// Imports a set of log files in the background. Each file is consumed by
+// a task of its own on the task pool into a staging store, and once all
+// files are done the staging stores are merged by time into the
+// destination.
+//
+// A lazy import only indexes the rows of each file, rather than decode
+// them into a staging store, and the indexed files are handed to a LazyLog.
+//
+// Report archives are imported without extracting them: each log entry is
+// inflated by a task of its own to a temporary file, which goes once
+// it's consumed, and the text entries are read for the delegate to show.
+// As the tasks run side by side, the modules the kernel log tells of
+// reach the module sink while the other entries are still inflating.
+//
+// An import may be scoped to a stretch of time and a set of processes, in
+// which case only the buffers of each file that may hold rows in the
+// stretch are read, and the rows outside the scope are dropped before
+// they're decoded. The kernel events of the buffers read all count.
+// @note since each file is consumed independently, events are only in
+//    order within a file, which is fine for the rows as they're merged by
+//    time, and for the kernel events as long as a single file carries those.
+class LogImporter {
+ public:
+  // Implemented by the clients of LogImporter, which are called back on
+  // the thread that started the import.
+  class Delegate {
+   public:
+    // Issued periodically while importing.
+    // @param percent_done an estimate of the progress.
+    virtual void OnImportProgress(int percent_done) = 0;
+
+    // Issued once all files are consumed, or the import was cancelled.
+    // The imported rows can then be retrieved with MergeInto.
+    // @param hr S_OK on success, the first error encountered otherwise.
+    virtual void OnImportDone(HRESULT hr) = 0;
+  };
+
+  // @param file_table the table file names are interned to.
+  // @param process_sink receives the kernel process events.
+  // @param module_sink receives the kernel module events.
+  // @param delegate receives progress and completion notifications.
+  // @note the sinks are invoked on the task pool, and all parameters
+  //    must outlive this instance.
+  LogImporter(StringTable* file_table,
+              KernelProcessEvents* process_sink,
+              KernelModuleEvents* module_sink,
+              Delegate* delegate);
+
+  // Cancels any import in progress and waits for the tasks to wind up.
+  ~LogImporter();
+
+  // Sets whether to import lazily, must be called before Start.
+  void set_lazy(bool lazy) { lazy_ = lazy; }
+  bool lazy() const { return lazy_; }
+
+  // The rows to import of each file.
+  struct Scope {
+    // @returns true iff this holds all of every file.
+    bool IsWhole() const {
+      return begin == base::TimeDelta() && duration == base::TimeDelta() &&
+          process_ids.empty();
+    }
+
+    // The stretch of time, from @p begin past the start of each file's
+    // session and lasting @p duration, or to the end if that's zero.
+    base::TimeDelta begin;
+    base::TimeDelta duration;
+    // The processes whose rows to import, sorted, or empty for all.
+    std::vector<DWORD> process_ids;
+  };
+  // Sets the scope of the import, must be called before Start. Scoped
+  // imports neither load nor save the indexes of the files.
+  void set_scope(const Scope& scope) { scope_ = scope; }
+  const Scope& scope() const { return scope_; }
+
+  // Parses a scope as the scope dialog has it: @p begin and @p duration
+  // in seconds, empty for zero, and @p process_ids separated by commas,
+  // empty for all.
+  // @returns true iff all three parse, in which case @p scope holds them.
+  static bool ParseScope(const std::string& begin,
+                         const std::string& duration,
+                         const std::string& process_ids,
+                         Scope* scope);
+
+  // Starts importing @p paths in the background, must be called once,
+  // on a thread with a message loop. Paths with the extension of a report
+  // archive are imported as such, but not by a lazy import, which fails
+  // them.
+  void Start(const std::vector<base::FilePath>& paths);
+
+  // Cancels the import, the delegate gets its OnImportDone shortly.
+  void Cancel();
+
+  // Appends the imported rows to @p store, merged by time. Files whose
+  // times overlap, e.g. rotated logs, hold some of the same rows, which
+  // are appended once. May be called once, after OnImportDone.
+  void MergeInto(LogStore* store);
+  // Hands the indexed files of a lazy import to @p log. May be called
+  // once, after OnImportDone.
+  void MergeInto(LazyLog* log);
+
+  // What the sessions that wrote the files lost, summed over the files.
+  struct LossCounts {
+    LossCounts() : events_lost(0), buffers_lost(0), num_markers(0) {
+    }
+
+    // As the log file headers tell, or the gaps between the buffers show
+    // if they tell fewer. Files imported from their index don't count.
+    uint64 events_lost;
+    uint64 buffers_lost;
+    // The loss marker rows imported, @see LogStore::AddLossMarker. Lazy
+    // imports have none.
+    size_t num_markers;
+  };
+  // May be called after OnImportDone.
+  LossCounts GetLossCounts() const;
+
+  // The rows dropped on merging for duplicating those of another file,
+  // valid once merged into a store.
+  size_t num_duplicates() const { return num_duplicates_; }
+
+  // The text entries of the report archives imported, such as the system
+  // information and the registry extract, valid once started.
+  const std::vector<ReportArchive::TextEntry>& report_texts() const {
+    return report_texts_;
+  }
+
+  // The interval at which progress is reported.
+  static const int kProgressIntervalMs = 200;
+  // The text entries of a report archive inflating to more are skipped.
+  static const size_t kMaxReportTextSize = 4 * 1024 * 1024;
+
+ private:
+  class Worker;
+
+  // Starts a worker on the file at @p path, or on its log entry @p entry
+  // if it's an archive.
+  void StartWorker(const base::FilePath& path, const std::string& entry);
+  // Starts a worker on each log entry of the archive at @p path.
+  void StartArchive(const base::FilePath& path);
+
+  // Reports progress, or completion if all workers are done.
+  void CheckProgress();
+
+  StringTable* file_table_;
+  KernelProcessEvents* process_sink_;
+  KernelModuleEvents* module_sink_;
+  Delegate* delegate_;
+  bool lazy_;
+  Scope scope_;
+
+  // The loop we were started on, where the delegate is called back.
+  base::MessageLoop* origin_loop_;
+
+  // One worker per file, or per log entry of an archive.
+  ScopedVector<Worker> workers_;
+  // The first error starting the workers, e.g. on an archive that can't
+  // be read.
+  HRESULT start_result_;
+  std::vector<ReportArchive::TextEntry> report_texts_;
+  size_t num_duplicates_;
+
+  // Non-zero once we're cancelled, read by the workers.
+  base::subtle::Atomic32 cancelled_;
+
+  base::CancelableClosure check_progress_task_;
+
+  // The workers' tasks, declared last as it waits for them on destruction.
+  TaskPool::TaskGroup group_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogImporter);
+};
+
+#endif  // SAWBUCK_VIEWER_LOG_IMPORTER_H_
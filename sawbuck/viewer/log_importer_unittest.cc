@@ -0,0 +1,244 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/log_importer.h"
+
+#include "base/file_util.h"
+#include "base/files/file_path.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/path_service.h"
+#include "base/strings/utf_string_conversions.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "third_party/zlib/contrib/minizip/zip.h"
+
+namespace {
+
+using testing::_;
+using testing::AtLeast;
+using testing::InvokeWithoutArgs;
+using testing::NiceMock;
+using testing::StrictMock;
+
+class MockKernelModuleEvents: public KernelModuleEvents {
+ public:
+  MOCK_METHOD3(OnModuleIsLoaded, void(DWORD process_id,
+                                      const base::Time& time,
+                                      const ModuleInformation& module_info));
+  MOCK_METHOD3(OnModuleUnload, void(DWORD process_id,
+                                    const base::Time& time,
+                                    const ModuleInformation& module_info));
+  MOCK_METHOD3(OnModuleLoad, void(DWORD process_id,
+                                  const base::Time& time,
+                                  const ModuleInformation& module_info));
+};
+
+class MockKernelProcessEvents: public KernelProcessEvents {
+ public:
+  MOCK_METHOD2(OnProcessIsRunning, void (const base::Time& time,
+                                         const ProcessInfo& process_info));
+  MOCK_METHOD2(OnProcessStarted, void (const base::Time& time,
+                                       const ProcessInfo& process_info));
+  MOCK_METHOD3(OnProcessEnded, void (const base::Time& time,
+                                     const ProcessInfo& process_info,
+                                     ULONG exit_status));
+};
+
+class MockDelegate: public LogImporter::Delegate {
+ public:
+  MOCK_METHOD1(OnImportProgress, void(int percent_done));
+  MOCK_METHOD1(OnImportDone, void(HRESULT hr));
+};
+
+class LogImporterTest: public testing::Test {
+ public:
+  LogImporterTest()
+      : importer_(&file_table_, &process_events_, &module_events_,
+                  &delegate_) {
+  }
+
+  virtual void SetUp() {
+    base::FilePath src_root;
+    ASSERT_TRUE(PathService::Get(base::DIR_SOURCE_ROOT, &src_root));
+    test_data_dir_ = src_root.AppendASCII("sawbuck\\log_lib\\test_data");
+  }
+
+  void QuitMessageLoop() {
+    message_loop_.Quit();
+  }
+
+  // Writes a report archive to @p path, with the test data file of each
+  // of @p log_names as an entry, and a system information entry.
+  void WriteArchive(const base::FilePath& path,
+                    const std::vector<std::wstring>& log_names) {
+    zipFile zip = zipOpen(base::WideToUTF8(path.value()).c_str(),
+                          APPEND_STATUS_CREATE);
+    ASSERT_TRUE(zip != NULL);
+    for (size_t i = 0; i < log_names.size(); ++i) {
+      std::string data;
+      ASSERT_TRUE(base::ReadFileToString(test_data_dir_.Append(log_names[i]),
+                                         &data));
+      AddEntry(zip, base::WideToUTF8(log_names[i]), data);
+    }
+    AddEntry(zip, "BasicSystemInformation.txt", "Windows 7\n");
+    ASSERT_EQ(ZIP_OK, zipClose(zip, NULL));
+  }
+
+  void AddEntry(zipFile zip, const std::string& name,
+                const std::string& data) {
+    ASSERT_EQ(ZIP_OK, zipOpenNewFileInZip(zip, name.c_str(), NULL, NULL, 0,
+                                          NULL, 0, NULL, Z_DEFLATED,
+                                          Z_DEFAULT_COMPRESSION));
+    ASSERT_EQ(ZIP_OK, zipWriteInFileInZip(zip, data.data(), data.size()));
+    ASSERT_EQ(ZIP_OK, zipCloseFileInZip(zip));
+  }
+
+ protected:
+  base::MessageLoop message_loop_;
+  base::FilePath test_data_dir_;
+
+  StringTable file_table_;
+  NiceMock<MockKernelModuleEvents> module_events_;
+  NiceMock<MockKernelProcessEvents> process_events_;
+  NiceMock<MockDelegate> delegate_;
+  LogImporter importer_;
+};
+
+TEST_F(LogImporterTest, ImportInParallel) {
+  std::vector<base::FilePath> paths;
+  paths.push_back(test_data_dir_.Append(L"image_data_32_v2.etl"));
+  paths.push_back(test_data_dir_.Append(L"process_data_32_v2.etl"));
+
+  // Each file feeds its own sink.
+  EXPECT_CALL(module_events_, OnModuleIsLoaded(_, _, _)).Times(AtLeast(1));
+  EXPECT_CALL(process_events_, OnProcessIsRunning(_, _)).Times(AtLeast(1));
+
+  EXPECT_CALL(delegate_, OnImportDone(S_OK)).WillOnce(
+      InvokeWithoutArgs(this, &LogImporterTest::QuitMessageLoop));
+  importer_.Start(paths);
+  message_loop_.Run();
+
+  // The kernel logs carry no log messages.
+  LogStore store(&file_table_);
+  importer_.MergeInto(&store);
+  EXPECT_EQ(0, store.num_rows());
+}
+
+TEST_F(LogImporterTest, ImportArchive) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::FilePath archive_path(temp_dir.path().Append(L"report.zip"));
+  std::vector<std::wstring> log_names;
+  log_names.push_back(L"image_data_32_v2.etl");
+  log_names.push_back(L"process_data_32_v2.etl");
+  ASSERT_NO_FATAL_FAILURE(WriteArchive(archive_path, log_names));
+
+  // Each entry feeds its own sink, as the files would.
+  EXPECT_CALL(module_events_, OnModuleIsLoaded(_, _, _)).Times(AtLeast(1));
+  EXPECT_CALL(process_events_, OnProcessIsRunning(_, _)).Times(AtLeast(1));
+
+  EXPECT_CALL(delegate_, OnImportDone(S_OK)).WillOnce(
+      InvokeWithoutArgs(this, &LogImporterTest::QuitMessageLoop));
+  importer_.Start(std::vector<base::FilePath>(1, archive_path));
+  message_loop_.Run();
+
+  ASSERT_EQ(1U, importer_.report_texts().size());
+  EXPECT_EQ("BasicSystemInformation.txt", importer_.report_texts()[0].name);
+  EXPECT_EQ("Windows 7\n", importer_.report_texts()[0].text);
+}
+
+TEST_F(LogImporterTest, ImportArchiveLazily) {
+  base::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::FilePath archive_path(temp_dir.path().Append(L"report.zip"));
+  ASSERT_NO_FATAL_FAILURE(WriteArchive(archive_path,
+                                       std::vector<std::wstring>()));
+
+  // The entries of an archive don't outlive the import.
+  EXPECT_CALL(delegate_, OnImportDone(testing::Ne(S_OK))).WillOnce(
+      InvokeWithoutArgs(this, &LogImporterTest::QuitMessageLoop));
+  importer_.set_lazy(true);
+  importer_.Start(std::vector<base::FilePath>(1, archive_path));
+  message_loop_.Run();
+}
+
+TEST_F(LogImporterTest, ImportScoped) {
+  std::vector<base::FilePath> paths;
+  paths.push_back(test_data_dir_.Append(L"image_data_32_v2.etl"));
+
+  // The kernel events of the stretch arrive whatever the processes.
+  LogImporter::Scope scope;
+  scope.duration = base::TimeDelta::FromSeconds(60);
+  scope.process_ids.push_back(1234);
+  importer_.set_scope(scope);
+  EXPECT_FALSE(importer_.scope().IsWhole());
+  EXPECT_CALL(module_events_, OnModuleIsLoaded(_, _, _)).Times(AtLeast(1));
+
+  EXPECT_CALL(delegate_, OnImportDone(S_OK)).WillOnce(
+      InvokeWithoutArgs(this, &LogImporterTest::QuitMessageLoop));
+  importer_.Start(paths);
+  message_loop_.Run();
+}
+
+TEST(LogImporterScopeTest, ParseScope) {
+  LogImporter::Scope scope;
+  EXPECT_TRUE(LogImporter::ParseScope("", " ", "", &scope));
+  EXPECT_TRUE(scope.IsWhole());
+
+  EXPECT_TRUE(LogImporter::ParseScope("1.5", "10", "30, 4,30 ,12", &scope));
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(1500), scope.begin);
+  EXPECT_EQ(base::TimeDelta::FromSeconds(10), scope.duration);
+  ASSERT_EQ(3U, scope.process_ids.size());
+  EXPECT_EQ(4U, scope.process_ids[0]);
+  EXPECT_EQ(12U, scope.process_ids[1]);
+  EXPECT_EQ(30U, scope.process_ids[2]);
+  EXPECT_FALSE(scope.IsWhole());
+
+  // Anything that doesn't parse leaves the scope be.
+  EXPECT_FALSE(LogImporter::ParseScope("-1", "", "", &scope));
+  EXPECT_FALSE(LogImporter::ParseScope("", "soon", "", &scope));
+  EXPECT_FALSE(LogImporter::ParseScope("", "", "12, x", &scope));
+  EXPECT_EQ(3U, scope.process_ids.size());
+}
+
+TEST_F(LogImporterTest, ImportNothing) {
+  EXPECT_CALL(delegate_, OnImportDone(S_OK)).WillOnce(
+      InvokeWithoutArgs(this, &LogImporterTest::QuitMessageLoop));
+  importer_.Start(std::vector<base::FilePath>());
+  message_loop_.Run();
+}
+
+TEST_F(LogImporterTest, ImportMissingFile) {
+  std::vector<base::FilePath> paths;
+  paths.push_back(test_data_dir_.Append(L"image_data_32_v2.etl"));
+  paths.push_back(test_data_dir_.Append(L"does_not_exist.etl"));
+
+  EXPECT_CALL(delegate_, OnImportDone(testing::Ne(S_OK))).WillOnce(
+      InvokeWithoutArgs(this, &LogImporterTest::QuitMessageLoop));
+  importer_.Start(paths);
+  message_loop_.Run();
+}
+
+TEST_F(LogImporterTest, Cancel) {
+  std::vector<base::FilePath> paths;
+  paths.push_back(test_data_dir_.Append(L"image_data_32_v2.etl"));
+
+  // The import may well complete before it notices the cancellation.
+  EXPECT_CALL(delegate_, OnImportDone(_)).WillOnce(
+      InvokeWithoutArgs(this, &LogImporterTest::QuitMessageLoop));
+  importer_.Start(paths);
+  importer_.Cancel();
+  message_loop_.Run();
+}
+
+}  // namespace
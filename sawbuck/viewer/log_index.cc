@@ -0,0 +1,937 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log file index implementation.
+#include "sawbuck/viewer/log_index.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include "base/file_util.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/logging.h"
+#include "sawbuck/common/buffer_parser.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+const wchar_t kIndexExtension[] = L".sbidx";
+
+// "SBIX" in little-endian order.
+const uint32 kIndexMagic = 0x58494253;
+// Bump this on any change to the layout below.
+const uint32 kIndexVersion = 2;
+
+// The flags of the index header.
+enum IndexFlags {
+  // The file is a session, which stands alone rather than indexing a log.
+  INDEX_FLAG_SESSION = 0x1,
+};
+
+// All sections of the index are aligned to this.
+const size_t kIndexAlignment = 8;
+
+// The index starts with this header, which is followed by these
+// sections, in order:
+//   UCHAR levels[num_rows]
+//   DWORD process_ids[num_rows]
+//   DWORD thread_ids[num_rows]
+//   int64 times[num_rows]
+//   uint32 files[num_rows] - index into the file names, 0 for none.
+//   int32 lines[num_rows]
+//   uint64 message_ends[num_rows] - end offset of each message.
+//   char messages[message_bytes]
+//   uint32 trace_ends[num_rows] - end index of each trace.
+//   uint64 traces[num_trace_addresses]
+//   char file_names[num_file_names][] - zero terminated, after the
+//       implicit empty name at index 0.
+//   kernel events[num_kernel_events] - the type and time, followed by
+//       the process or module information, each aligned.
+//   char filters[filter_bytes] - the serialized filters of a session.
+struct IndexHeader {
+  uint32 magic;
+  uint32 version;
+
+  // The size and modification time of the log file when indexed, zero
+  // for a session.
+  int64 log_size;
+  int64 log_last_modified;
+
+  uint32 num_rows;
+  uint32 num_file_names;
+  uint32 num_trace_addresses;
+  uint32 num_kernel_events;
+  uint64 message_bytes;
+
+  // A combination of IndexFlags.
+  uint32 flags;
+  uint32 filter_bytes;
+};
+
+// "SBCK" in little-endian order.
+const uint32 kCheckpointMagic = 0x4B434253;
+// Bump this on any change to the framing below.
+const uint32 kCheckpointVersion = 1;
+// "SBCH" in little-endian order.
+const uint32 kChunkMagic = 0x48434253;
+
+// A checkpoint starts with this header, which is followed by its chunks.
+struct CheckpointHeader {
+  uint32 magic;
+  uint32 version;
+};
+
+// Each chunk starts with this header, which is followed by the index of
+// its rows, a session of index_bytes.
+struct ChunkHeader {
+  uint32 magic;
+  // The zlib crc32 of the index.
+  uint32 crc;
+  uint64 index_bytes;
+  // The store's number of the chunk's first row, and of the store's first
+  // retained row, when the chunk was serialized.
+  int32 begin_row;
+  int32 first_row;
+};
+
+// @returns true iff @p data starts with a checkpoint header.
+bool IsCheckpoint(const char* data, size_t size) {
+  return size >= sizeof(CheckpointHeader) &&
+      reinterpret_cast<const CheckpointHeader*>(data)->magic ==
+          kCheckpointMagic;
+}
+
+uint32 GetChecksum(const char* data, size_t size) {
+  uLong crc = crc32(0L, Z_NULL, 0);
+  return crc32(crc, reinterpret_cast<const Bytef*>(data),
+               static_cast<uInt>(size));
+}
+
+// Retrieves the identifying properties of the log file at @p log_path.
+bool GetLogFileInfo(const base::FilePath& log_path,
+                    int64* size,
+                    int64* last_modified) {
+  base::File::Info info;
+  if (!base::GetFileInfo(log_path, &info))
+    return false;
+
+  *size = info.size;
+  *last_modified = info.last_modified.ToInternalValue();
+  return true;
+}
+
+void Align(std::string* buffer) {
+  buffer->resize((buffer->size() + kIndexAlignment - 1) &
+                 ~(kIndexAlignment - 1));
+}
+
+template <class T>
+void Append(const T& value, std::string* buffer) {
+  buffer->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+void AppendArray(const std::vector<T>& values, std::string* buffer) {
+  if (!values.empty()) {
+    buffer->append(reinterpret_cast<const char*>(&values[0]),
+                   values.size() * sizeof(values[0]));
+  }
+  Align(buffer);
+}
+
+template <class CharType>
+void AppendString(const std::basic_string<CharType>& str,
+                  std::string* buffer) {
+  buffer->append(reinterpret_cast<const char*>(str.c_str()),
+                 (str.size() + 1) * sizeof(CharType));
+}
+
+template <class T>
+bool Read(BinaryBufferReader* reader, T* value) {
+  const T* data = NULL;
+  if (!reader->Read(&data))
+    return false;
+
+  *value = *data;
+  return true;
+}
+
+template <class T>
+bool ReadArray(BinaryBufferReader* reader, size_t count, const T** values) {
+  return reader->Read(count * sizeof(T), values) &&
+      reader->Align(kIndexAlignment);
+}
+
+template <class CharType>
+bool ReadString(BinaryBufferReader* reader,
+                std::basic_string<CharType>* str) {
+  const CharType* data = NULL;
+  size_t len = 0;
+  if (!reader->ReadString(&data, &len))
+    return false;
+
+  str->assign(data, len);
+  return true;
+}
+
+}  // namespace
+
+LogIndex::LogIndex(KernelProcessEvents* process_sink,
+                   KernelModuleEvents* module_sink)
+    : process_sink_(process_sink),
+      module_sink_(module_sink),
+      module_process_sink_(NULL) {
+}
+
+LogIndex::~LogIndex() {
+}
+
+base::FilePath LogIndex::GetIndexPath(const base::FilePath& log_path) {
+  return base::FilePath(log_path.value() + kIndexExtension);
+}
+
+bool LogIndex::GetLogPath(const base::FilePath& index_path,
+                          base::FilePath* log_path) {
+  DCHECK(log_path != NULL);
+  const std::wstring& value = index_path.value();
+  size_t length = arraysize(kIndexExtension) - 1;
+  if (value.size() <= length ||
+      value.compare(value.size() - length, length, kIndexExtension) != 0) {
+    return false;
+  }
+
+  *log_path = base::FilePath(value.substr(0, value.size() - length));
+  return true;
+}
+
+// The sections of an index, which point into its bytes.
+struct LogIndex::Contents {
+  Contents()
+      : flags(0), log_size(0), log_last_modified(0), num_rows(0),
+        levels(NULL), process_ids(NULL), thread_ids(NULL), times(NULL),
+        files(NULL), lines(NULL), message_ends(NULL), messages(NULL),
+        trace_ends(NULL), traces(NULL), begin_row(0), first_row(0) {
+  }
+
+  uint32 flags;
+  int64 log_size;
+  int64 log_last_modified;
+
+  size_t num_rows;
+  const UCHAR* levels;
+  const DWORD* process_ids;
+  const DWORD* thread_ids;
+  const int64* times;
+  const uint32* files;
+  const int32* lines;
+  const uint64* message_ends;
+  const char* messages;
+  const uint32* trace_ends;
+  const uint64* traces;
+
+  std::vector<std::string> file_names;
+  std::vector<KernelEvent> kernel_events;
+  base::StringPiece filters;
+
+  // Those of the chunk header, for a checkpoint chunk.
+  int begin_row;
+  int first_row;
+};
+
+bool LogIndex::Save(const base::FilePath& log_path,
+                    const LogStore& store) const {
+  int64 log_size = 0;
+  int64 log_last_modified = 0;
+  if (!GetLogFileInfo(log_path, &log_size, &log_last_modified))
+    return false;
+
+  std::vector<KernelEvent> kernel_events;
+  GetKernelEvents(0, &kernel_events);
+  std::string buffer;
+  Serialize(store, store.first_row(), kernel_events, log_size,
+            log_last_modified, 0, std::string(), &buffer);
+  return WriteFile(GetIndexPath(log_path), buffer);
+}
+
+bool LogIndex::Load(const base::FilePath& log_path, LogStore* store) {
+  int64 log_size = 0;
+  int64 log_last_modified = 0;
+  if (!GetLogFileInfo(log_path, &log_size, &log_last_modified))
+    return false;
+
+  return LoadFile(GetIndexPath(log_path), log_size, log_last_modified, 0,
+                  store, NULL);
+}
+
+void LogIndex::SerializeSession(const LogStore& store,
+                                const std::string& filters,
+                                std::string* buffer) const {
+  std::vector<KernelEvent> kernel_events;
+  GetKernelEvents(0, &kernel_events);
+  Serialize(store, store.first_row(), kernel_events, 0, 0,
+            INDEX_FLAG_SESSION, filters, buffer);
+}
+
+void LogIndex::SerializeCheckpointHeader(std::string* buffer) {
+  DCHECK(buffer != NULL);
+  CheckpointHeader header = { kCheckpointMagic, kCheckpointVersion };
+  buffer->clear();
+  Append(header, buffer);
+  Align(buffer);
+}
+
+void LogIndex::SerializeCheckpointChunk(const LogStore& store,
+                                        int begin_row,
+                                        const std::string& filters,
+                                        size_t* next_event,
+                                        std::string* buffer) const {
+  DCHECK(next_event != NULL);
+  DCHECK(buffer != NULL);
+
+  std::vector<KernelEvent> kernel_events;
+  GetKernelEvents(*next_event, &kernel_events);
+  *next_event += kernel_events.size();
+
+  begin_row = std::max(begin_row, store.first_row());
+  std::string index;
+  Serialize(store, begin_row, kernel_events, 0, 0, INDEX_FLAG_SESSION,
+            filters, &index);
+
+  ChunkHeader header = {};
+  header.magic = kChunkMagic;
+  header.crc = GetChecksum(index.data(), index.size());
+  header.index_bytes = index.size();
+  header.begin_row = begin_row;
+  header.first_row = store.first_row();
+
+  buffer->clear();
+  Append(header, buffer);
+  Align(buffer);
+  buffer->append(index);
+}
+
+size_t LogIndex::num_kernel_events() const {
+  base::AutoLock lock(kernel_events_lock_);
+  return kernel_events_.size();
+}
+
+bool LogIndex::LoadSession(const base::FilePath& session_path,
+                           LogStore* store,
+                           std::string* filters) {
+  DCHECK(filters != NULL);
+  return LoadFile(session_path, 0, 0, INDEX_FLAG_SESSION, store, filters);
+}
+
+bool LogIndex::WriteFile(const base::FilePath& path,
+                         const std::string& buffer) {
+  int written = base::WriteFile(path, buffer.data(), buffer.size());
+  if (written != static_cast<int>(buffer.size())) {
+    LOG(ERROR) << "Failed to write \"" << path.value() << "\".";
+    // Don't leave a truncated file around.
+    base::DeleteFile(path, false);
+    return false;
+  }
+
+  return true;
+}
+
+void LogIndex::Serialize(const LogStore& store,
+                         int begin_row,
+                         const std::vector<KernelEvent>& kernel_events,
+                         int64 log_size,
+                         int64 log_last_modified,
+                         uint32 flags,
+                         const std::string& filters,
+                         std::string* buffer_out) {
+  DCHECK(buffer_out != NULL);
+
+  IndexHeader header = {};
+  header.magic = kIndexMagic;
+  header.version = kIndexVersion;
+  header.log_size = log_size;
+  header.log_last_modified = log_last_modified;
+  header.flags = flags;
+  header.filter_bytes = filters.size();
+
+  // The store's rows start at its first row, after any evictions.
+  int first_row = std::max(begin_row, store.first_row());
+  int num_rows = std::max(store.num_rows() - first_row, 0);
+  header.num_rows = num_rows;
+
+  // Gather the columns, and map the file atoms to a dense local numbering.
+  std::vector<UCHAR> levels(num_rows);
+  std::vector<DWORD> process_ids(num_rows);
+  std::vector<DWORD> thread_ids(num_rows);
+  std::vector<int64> times(num_rows);
+  std::vector<uint32> files(num_rows);
+  std::vector<int32> lines(num_rows);
+  std::vector<uint64> message_ends(num_rows);
+  std::string messages;
+  std::vector<uint32> trace_ends(num_rows);
+  std::vector<uint64> traces;
+  std::map<StringTable::Atom, uint32> file_indexes;
+  std::vector<StringTable::Atom> file_atoms;
+
+  std::vector<sym_util::Address> trace;
+  std::string message_buffer;
+  for (int i = 0; i < num_rows; ++i) {
+    int row = first_row + i;
+    levels[i] = store.GetSeverity(row);
+    process_ids[i] = store.GetProcessId(row);
+    thread_ids[i] = store.GetThreadId(row);
+    times[i] = store.GetTime(row).ToInternalValue();
+    lines[i] = store.GetLine(row);
+
+    StringTable::Atom atom = store.GetFileAtom(row);
+    if (atom != StringTable::kEmptyAtom) {
+      std::map<StringTable::Atom, uint32>::iterator it(
+          file_indexes.find(atom));
+      if (it == file_indexes.end()) {
+        file_atoms.push_back(atom);
+        it = file_indexes.insert(
+            std::make_pair(atom, file_atoms.size())).first;
+      }
+      files[i] = it->second;
+    }
+
+    base::StringPiece message(store.GetMessage(row, &message_buffer));
+    messages.append(message.data(), message.size());
+    message_ends[i] = messages.size();
+
+    store.GetStackTrace(row, &trace);
+    traces.insert(traces.end(), trace.begin(), trace.end());
+    trace_ends[i] = traces.size();
+  }
+
+  header.num_file_names = file_atoms.size();
+  header.num_trace_addresses = traces.size();
+  header.num_kernel_events = kernel_events.size();
+  header.message_bytes = messages.size();
+
+  std::string& buffer = *buffer_out;
+  buffer.clear();
+  Append(header, &buffer);
+  Align(&buffer);
+  AppendArray(levels, &buffer);
+  AppendArray(process_ids, &buffer);
+  AppendArray(thread_ids, &buffer);
+  AppendArray(times, &buffer);
+  AppendArray(files, &buffer);
+  AppendArray(lines, &buffer);
+  AppendArray(message_ends, &buffer);
+  buffer.append(messages);
+  Align(&buffer);
+  AppendArray(trace_ends, &buffer);
+  AppendArray(traces, &buffer);
+
+  for (size_t i = 0; i < file_atoms.size(); ++i)
+    AppendString(store.file_table()->GetString(file_atoms[i]), &buffer);
+  Align(&buffer);
+
+  for (size_t i = 0; i < kernel_events.size(); ++i) {
+    const KernelEvent& event = kernel_events[i];
+    Append(static_cast<uint32>(event.type), &buffer);
+    Append(event.time.ToInternalValue(), &buffer);
+
+    switch (event.type) {
+      case PROCESS_IS_RUNNING:
+      case PROCESS_STARTED:
+      case PROCESS_ENDED: {
+        const ProcessInfo& info = event.process_info;
+        Append(info.process_id, &buffer);
+        Append(info.parent_id, &buffer);
+        Append(info.session_id, &buffer);
+        buffer.append(reinterpret_cast<const char*>(&info.user_sid),
+                      SECURITY_MAX_SID_SIZE);
+        Append(event.exit_status, &buffer);
+        AppendString(info.image_name, &buffer);
+        AppendString(info.command_line, &buffer);
+        break;
+      }
+
+      default: {
+        const ModuleInformation& info = event.module_info;
+        Append(event.process_id, &buffer);
+        Append(info.base_address, &buffer);
+        Append(info.module_size, &buffer);
+        Append(info.image_checksum, &buffer);
+        Append(info.time_date_stamp, &buffer);
+        AppendString(info.image_file_name, &buffer);
+        break;
+      }
+    }
+    Align(&buffer);
+  }
+
+  buffer.append(filters);
+  Align(&buffer);
+}
+
+bool LogIndex::ParseContents(const char* data,
+                             size_t size,
+                             Contents* contents) {
+  DCHECK(contents != NULL);
+
+  BinaryBufferReader reader(data, size);
+  const IndexHeader* header = NULL;
+  if (!reader.Read(&header) || !reader.Align(kIndexAlignment))
+    return false;
+  if (header->magic != kIndexMagic || header->version != kIndexVersion)
+    return false;
+
+  contents->flags = header->flags;
+  contents->log_size = header->log_size;
+  contents->log_last_modified = header->log_last_modified;
+
+  // Validate and locate all sections.
+  size_t num_rows = header->num_rows;
+  contents->num_rows = num_rows;
+  if (!ReadArray(&reader, num_rows, &contents->levels) ||
+      !ReadArray(&reader, num_rows, &contents->process_ids) ||
+      !ReadArray(&reader, num_rows, &contents->thread_ids) ||
+      !ReadArray(&reader, num_rows, &contents->times) ||
+      !ReadArray(&reader, num_rows, &contents->files) ||
+      !ReadArray(&reader, num_rows, &contents->lines) ||
+      !ReadArray(&reader, num_rows, &contents->message_ends) ||
+      !ReadArray(&reader, header->message_bytes, &contents->messages) ||
+      !ReadArray(&reader, num_rows, &contents->trace_ends) ||
+      !ReadArray(&reader, header->num_trace_addresses, &contents->traces)) {
+    return false;
+  }
+
+  // The file names, after the implicit empty name.
+  for (size_t i = 0; i < header->num_file_names; ++i) {
+    std::string file_name;
+    if (!ReadString(&reader, &file_name))
+      return false;
+    contents->file_names.push_back(file_name);
+  }
+  if (!reader.Align(kIndexAlignment))
+    return false;
+
+  std::vector<KernelEvent>& kernel_events = contents->kernel_events;
+  kernel_events.resize(header->num_kernel_events);
+  for (size_t i = 0; i < kernel_events.size(); ++i) {
+    KernelEvent& event = kernel_events[i];
+    uint32 type = 0;
+    int64 time = 0;
+    if (!Read(&reader, &type) || !Read(&reader, &time) || type > MODULE_LOAD)
+      return false;
+    event.type = static_cast<KernelEventType>(type);
+    event.time = base::Time::FromInternalValue(time);
+
+    bool ok = false;
+    switch (event.type) {
+      case PROCESS_IS_RUNNING:
+      case PROCESS_STARTED:
+      case PROCESS_ENDED: {
+        ProcessInfo& info = event.process_info;
+        const void* sid = NULL;
+        ok = Read(&reader, &info.process_id) &&
+            Read(&reader, &info.parent_id) &&
+            Read(&reader, &info.session_id) &&
+            reader.Read(SECURITY_MAX_SID_SIZE, &sid) &&
+            Read(&reader, &event.exit_status) &&
+            ReadString(&reader, &info.image_name) &&
+            ReadString(&reader, &info.command_line);
+        if (ok)
+          memcpy(&info.user_sid, sid, SECURITY_MAX_SID_SIZE);
+        break;
+      }
+
+      default: {
+        ModuleInformation& info = event.module_info;
+        ok = Read(&reader, &event.process_id) &&
+            Read(&reader, &info.base_address) &&
+            Read(&reader, &info.module_size) &&
+            Read(&reader, &info.image_checksum) &&
+            Read(&reader, &info.time_date_stamp) &&
+            ReadString(&reader, &info.image_file_name);
+        break;
+      }
+    }
+
+    if (!ok || !reader.Align(kIndexAlignment))
+      return false;
+  }
+
+  const char* filter_data = NULL;
+  if (!ReadArray(&reader, header->filter_bytes, &filter_data))
+    return false;
+  contents->filters.set(filter_data, header->filter_bytes);
+
+  // Check the row references before anyone commits to anything.
+  uint64 message_begin = 0;
+  uint32 trace_begin = 0;
+  for (size_t row = 0; row < num_rows; ++row) {
+    if (contents->files[row] > contents->file_names.size() ||
+        contents->message_ends[row] < message_begin ||
+        contents->message_ends[row] > header->message_bytes ||
+        contents->trace_ends[row] < trace_begin ||
+        contents->trace_ends[row] > header->num_trace_addresses) {
+      return false;
+    }
+    message_begin = contents->message_ends[row];
+    trace_begin = contents->trace_ends[row];
+  }
+
+  return true;
+}
+
+bool LogIndex::ParseCheckpoint(const char* data,
+                               size_t size,
+                               std::vector<Contents>* chunks) {
+  DCHECK(chunks != NULL);
+
+  BinaryBufferReader reader(data, size);
+  const CheckpointHeader* header = NULL;
+  if (!reader.Read(&header) || !reader.Align(kIndexAlignment))
+    return false;
+  if (header->magic != kCheckpointMagic ||
+      header->version != kCheckpointVersion) {
+    return false;
+  }
+
+  // The chunks are written in order, so a crash leaves at most the last
+  // one short, and the ones before it whole.
+  while (reader.RemainingBytes() > 0) {
+    const ChunkHeader* chunk = NULL;
+    const char* index = NULL;
+    if (!reader.Read(&chunk) || !reader.Align(kIndexAlignment) ||
+        chunk->magic != kChunkMagic ||
+        chunk->index_bytes > reader.RemainingBytes() ||
+        !reader.Read(static_cast<size_t>(chunk->index_bytes), &index)) {
+      break;
+    }
+
+    size_t index_bytes = static_cast<size_t>(chunk->index_bytes);
+    Contents contents;
+    if (GetChecksum(index, index_bytes) != chunk->crc ||
+        !ParseContents(index, index_bytes, &contents) ||
+        contents.flags != INDEX_FLAG_SESSION) {
+      LOG(WARNING) << "Checkpoint cut short after " << chunks->size()
+                   << " chunks.";
+      break;
+    }
+    contents.begin_row = chunk->begin_row;
+    contents.first_row = chunk->first_row;
+    chunks->push_back(contents);
+  }
+
+  return true;
+}
+
+void LogIndex::ApplyContents(const Contents& contents,
+                             size_t skip_rows,
+                             LogStore* store) {
+  DCHECK(store != NULL);
+
+  // Intern the file names, index 0 is the empty name.
+  std::vector<StringTable::Atom> file_atoms(1, StringTable::kEmptyAtom);
+  for (size_t i = 0; i < contents.file_names.size(); ++i)
+    file_atoms.push_back(store->file_table()->Intern(contents.file_names[i]));
+
+  // Append the rows straight from the mapped columns.
+  std::vector<sym_util::Address> trace;
+  for (size_t row = skip_rows; row < contents.num_rows; ++row) {
+    uint64 message_begin = row == 0 ? 0 : contents.message_ends[row - 1];
+    uint32 trace_begin = row == 0 ? 0 : contents.trace_ends[row - 1];
+    trace.assign(contents.traces + trace_begin,
+                 contents.traces + contents.trace_ends[row]);
+
+    store->AddRow(contents.levels[row],
+                  contents.process_ids[row],
+                  contents.thread_ids[row],
+                  base::Time::FromInternalValue(contents.times[row]),
+                  file_atoms[contents.files[row]],
+                  contents.lines[row],
+                  base::StringPiece(contents.messages + message_begin,
+                      static_cast<size_t>(contents.message_ends[row] -
+                                          message_begin)),
+                  trace.size(),
+                  trace.empty() ? NULL : &trace[0]);
+  }
+
+  for (size_t i = 0; i < contents.kernel_events.size(); ++i)
+    ReplayEvent(contents.kernel_events[i]);
+}
+
+bool LogIndex::LoadFile(const base::FilePath& path,
+                        int64 log_size,
+                        int64 log_last_modified,
+                        uint32 flags,
+                        LogStore* store,
+                        std::string* filters) {
+  DCHECK(store != NULL);
+
+  base::MemoryMappedFile file;
+  if (!file.Initialize(path))
+    return false;
+  const char* data = reinterpret_cast<const char*>(file.data());
+
+  // A checkpoint is a session of sessions.
+  if (IsCheckpoint(data, file.length())) {
+    std::vector<Contents> chunks;
+    if (flags != INDEX_FLAG_SESSION ||
+        !ParseCheckpoint(data, file.length(), &chunks)) {
+      return false;
+    }
+
+    // The rows the store had evicted by the last chunk are skipped.
+    int first_row = chunks.empty() ? 0 : chunks.back().first_row;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      const Contents& chunk = chunks[i];
+      size_t skip_rows = std::min(
+          chunk.num_rows,
+          static_cast<size_t>(std::max(first_row - chunk.begin_row, 0)));
+      ApplyContents(chunk, skip_rows, store);
+    }
+
+    if (filters != NULL) {
+      filters->clear();
+      if (!chunks.empty())
+        chunks.back().filters.CopyToString(filters);
+    }
+    return true;
+  }
+
+  Contents contents;
+  if (!ParseContents(data, file.length(), &contents))
+    return false;
+  if (contents.flags != flags ||
+      contents.log_size != log_size ||
+      contents.log_last_modified != log_last_modified) {
+    return false;
+  }
+
+  // All is well, commit to the rows.
+  ApplyContents(contents, 0, store);
+  if (filters != NULL)
+    contents.filters.CopyToString(filters);
+
+  return true;
+}
+
+void LogIndex::GetKernelEvents(size_t begin,
+                               std::vector<KernelEvent>* events) const {
+  DCHECK(events != NULL);
+  base::AutoLock lock(kernel_events_lock_);
+  DCHECK_LE(begin, kernel_events_.size());
+  events->assign(kernel_events_.begin() + begin, kernel_events_.end());
+}
+
+LogIndex::MappedFile::MappedFile() : is_session_(false), num_rows_(0) {
+}
+
+LogIndex::MappedFile::~MappedFile() {
+}
+
+bool LogIndex::MappedFile::Open(const base::FilePath& path) {
+  DCHECK(!file_.IsValid());
+  if (!file_.Initialize(path))
+    return false;
+  const char* data = reinterpret_cast<const char*>(file_.data());
+
+  // The parts are a checkpoint's chunks, short of the rows it evicted, or
+  // the whole of an index.
+  std::vector<Contents> chunks;
+  if (IsCheckpoint(data, file_.length())) {
+    if (!ParseCheckpoint(data, file_.length(), &chunks))
+      return false;
+    is_session_ = true;
+  } else {
+    chunks.resize(1);
+    if (!ParseContents(data, file_.length(), &chunks[0]))
+      return false;
+    is_session_ = (chunks[0].flags & INDEX_FLAG_SESSION) != 0;
+    chunks[0].first_row = 0;
+  }
+
+  int first_row = chunks.empty() ? 0 : chunks.back().first_row;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    const Contents& chunk = chunks[i];
+    size_t first_index =
+        static_cast<size_t>(std::max(first_row - chunk.begin_row, 0));
+    if (first_index >= chunk.num_rows)
+      continue;
+
+    Part part = { static_cast<int>(num_rows_), first_index, chunk.times,
+                  chunk.message_ends, chunk.messages };
+    parts_.push_back(part);
+    num_rows_ += chunk.num_rows - first_index;
+  }
+
+  return true;
+}
+
+const LogIndex::MappedFile::Part& LogIndex::MappedFile::GetPart(
+    int row) const {
+  DCHECK_LE(0, row);
+  DCHECK_LT(static_cast<size_t>(row), num_rows_);
+
+  // The last part that starts at or before the row.
+  size_t begin = 0;
+  size_t end = parts_.size();
+  while (end - begin > 1) {
+    size_t middle = begin + (end - begin) / 2;
+    if (parts_[middle].first_row <= row)
+      begin = middle;
+    else
+      end = middle;
+  }
+  return parts_[begin];
+}
+
+base::StringPiece LogIndex::MappedFile::GetMessage(int row) const {
+  const Part& part = GetPart(row);
+  size_t index = row - part.first_row + part.first_index;
+  uint64 begin = index == 0 ? 0 : part.message_ends[index - 1];
+  return base::StringPiece(part.messages + begin,
+      static_cast<size_t>(part.message_ends[index] - begin));
+}
+
+base::Time LogIndex::MappedFile::GetTime(int row) const {
+  const Part& part = GetPart(row);
+  size_t index = row - part.first_row + part.first_index;
+  return base::Time::FromInternalValue(part.times[index]);
+}
+
+void LogIndex::RecordEvent(const KernelEvent& event) {
+  {
+    base::AutoLock lock(kernel_events_lock_);
+    kernel_events_.push_back(event);
+  }
+
+  ReplayEvent(event);
+}
+
+void LogIndex::ReplayEvent(const KernelEvent& event) {
+  switch (event.type) {
+    case PROCESS_IS_RUNNING:
+      if (process_sink_ != NULL)
+        process_sink_->OnProcessIsRunning(event.time, event.process_info);
+      if (module_process_sink_ != NULL) {
+        module_process_sink_->OnProcessIsRunning(event.time,
+                                                 event.process_info);
+      }
+      break;
+
+    case PROCESS_STARTED:
+      if (process_sink_ != NULL)
+        process_sink_->OnProcessStarted(event.time, event.process_info);
+      if (module_process_sink_ != NULL)
+        module_process_sink_->OnProcessStarted(event.time, event.process_info);
+      break;
+
+    case PROCESS_ENDED:
+      if (process_sink_ != NULL) {
+        process_sink_->OnProcessEnded(event.time, event.process_info,
+                                      event.exit_status);
+      }
+      if (module_process_sink_ != NULL) {
+        module_process_sink_->OnProcessEnded(event.time, event.process_info,
+                                             event.exit_status);
+      }
+      break;
+
+    case MODULE_IS_LOADED:
+      if (module_sink_ != NULL) {
+        module_sink_->OnModuleIsLoaded(event.process_id, event.time,
+                                       event.module_info);
+      }
+      break;
+
+    case MODULE_UNLOAD:
+      if (module_sink_ != NULL) {
+        module_sink_->OnModuleUnload(event.process_id, event.time,
+                                     event.module_info);
+      }
+      break;
+
+    case MODULE_LOAD:
+      if (module_sink_ != NULL) {
+        module_sink_->OnModuleLoad(event.process_id, event.time,
+                                   event.module_info);
+      }
+      break;
+
+    default:
+      NOTREACHED() << "Unexpected kernel event type.";
+      break;
+  }
+}
+
+void LogIndex::OnProcessIsRunning(const base::Time& time,
+                                  const ProcessInfo& process_info) {
+  KernelEvent event;
+  event.type = PROCESS_IS_RUNNING;
+  event.time = time;
+  event.process_info = process_info;
+  event.exit_status = 0;
+  RecordEvent(event);
+}
+
+void LogIndex::OnProcessStarted(const base::Time& time,
+                                const ProcessInfo& process_info) {
+  KernelEvent event;
+  event.type = PROCESS_STARTED;
+  event.time = time;
+  event.process_info = process_info;
+  event.exit_status = 0;
+  RecordEvent(event);
+}
+
+void LogIndex::OnProcessEnded(const base::Time& time,
+                              const ProcessInfo& process_info,
+                              ULONG exit_status) {
+  KernelEvent event;
+  event.type = PROCESS_ENDED;
+  event.time = time;
+  event.process_info = process_info;
+  event.exit_status = exit_status;
+  RecordEvent(event);
+}
+
+void LogIndex::OnModuleIsLoaded(DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info) {
+  KernelEvent event;
+  event.type = MODULE_IS_LOADED;
+  event.time = time;
+  event.process_id = process_id;
+  event.module_info = module_info;
+  RecordEvent(event);
+}
+
+void LogIndex::OnModuleUnload(DWORD process_id,
+                              const base::Time& time,
+                              const ModuleInformation& module_info) {
+  KernelEvent event;
+  event.type = MODULE_UNLOAD;
+  event.time = time;
+  event.process_id = process_id;
+  event.module_info = module_info;
+  RecordEvent(event);
+}
+
+void LogIndex::OnModuleLoad(DWORD process_id,
+                            const base::Time& time,
+                            const ModuleInformation& module_info) {
+  KernelEvent event;
+  event.type = MODULE_LOAD;
+  event.time = time;
+  event.process_id = process_id;
+  event.module_info = module_info;
+  RecordEvent(event);
+}
@@ -0,0 +1,265 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log file index declaration.
+#ifndef SAWBUCK_VIEWER_LOG_INDEX_H_
+#define SAWBUCK_VIEWER_LOG_INDEX_H_
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/strings/string_piece.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/viewer/log_store.h"
+
+// An index is a sidecar file next to an imported log file, which holds
+// the rows imported from the log in packed columns, along with the file
+// names they refer to and the kernel events seen in the log. Loading
+// the index on a subsequent import saves re-parsing the log.
+//
+// While importing, a LogIndex stands in as the kernel event sink, and
+// records the kernel events it forwards to the real sinks. When loading,
+// it replays the recorded events to the real sinks.
+//
+// A session file shares the index format, but stands alone: it's tied to
+// no log file, and carries the filters in effect when it was saved.
+//
+// A checkpoint is a session file written a chunk at a time, as a capture
+// runs: it's a header followed by chunks, each of which is a session of
+// the rows added since the chunk before, framed with its length and
+// checksum. A checkpoint loads and maps as a session, up to its first
+// chunk cut short, so that one left behind by a crash opens with the rows
+// it holds. See SessionCheckpoint.
+// @note the index records the size and modification time of its log file,
+//    and is stale if either changes.
+// @note the kernel events may be recorded on any thread.
+class LogIndex : public KernelProcessEvents, public KernelModuleEvents {
+ public:
+  // Maps the rows of an index or session file to read them in place, e.g.
+  // to search their messages without loading them into a store.
+  class MappedFile {
+   public:
+    MappedFile();
+    ~MappedFile();
+
+    // Maps the file at @p path, whatever log it indexes, if any.
+    // @returns true iff it's an index or a session file.
+    bool Open(const base::FilePath& path);
+
+    // Accessors, valid once open.
+    // @{
+    bool is_session() const { return is_session_; }
+    int num_rows() const { return static_cast<int>(num_rows_); }
+    base::StringPiece GetMessage(int row) const;
+    base::Time GetTime(int row) const;
+    // @}
+
+   private:
+    // The columns of an index, or of a checkpoint chunk.
+    struct Part {
+      // Our number of the part's first row, and its index in the columns.
+      int first_row;
+      size_t first_index;
+      const int64* times;
+      const uint64* message_ends;
+      const char* messages;
+    };
+
+    // @returns the part @p row is in.
+    const Part& GetPart(int row) const;
+
+    base::MemoryMappedFile file_;
+    bool is_session_;
+    size_t num_rows_;
+    // In row order.
+    std::vector<Part> parts_;
+
+    DISALLOW_COPY_AND_ASSIGN(MappedFile);
+  };
+
+  // @param process_sink receives the kernel process events.
+  // @param module_sink receives the kernel module events.
+  LogIndex(KernelProcessEvents* process_sink,
+           KernelModuleEvents* module_sink);
+  ~LogIndex();
+
+  // Also issues the kernel process events to @p sink, e.g. to the module
+  // sink, which compacts the module history of the processes that end.
+  void set_module_process_sink(KernelProcessEvents* sink) {
+    module_process_sink_ = sink;
+  }
+
+  // Loads the index of the log file at @p log_path, mapping it into memory.
+  // On success the rows are appended to @p store and the kernel events are
+  // replayed to our sinks.
+  // @returns true on success, false if there's no up-to-date index.
+  bool Load(const base::FilePath& log_path, LogStore* store);
+
+  // Writes the index of the log file at @p log_path, with the rows of
+  // @p store and the kernel events recorded so far.
+  // @returns true on success.
+  bool Save(const base::FilePath& log_path, const LogStore& store) const;
+
+  // Serializes a session of the rows of @p store, the kernel events
+  // recorded so far and the serialized @p filters to @p buffer.
+  void SerializeSession(const LogStore& store,
+                        const std::string& filters,
+                        std::string* buffer) const;
+
+  // Serializes the header a checkpoint starts with to @p buffer.
+  static void SerializeCheckpointHeader(std::string* buffer);
+
+  // Serializes a checkpoint chunk to @p buffer, of the rows of @p store
+  // from @p begin_row on, or from its first row if that's later, of the
+  // kernel events recorded from @p next_event on, and of the serialized
+  // @p filters. On return @p next_event is past the events serialized.
+  void SerializeCheckpointChunk(const LogStore& store,
+                                int begin_row,
+                                const std::string& filters,
+                                size_t* next_event,
+                                std::string* buffer) const;
+
+  // @returns the number of kernel events recorded so far.
+  size_t num_kernel_events() const;
+
+  // Loads the session file or checkpoint at @p session_path, mapping it
+  // into memory. On success the rows are appended to @p store, the kernel
+  // events are replayed to our sinks and @p filters holds the session's
+  // filters. The rows of a checkpoint that its store had evicted by its
+  // last chunk are skipped, and its filters are those of its last chunk.
+  // @returns true on success.
+  bool LoadSession(const base::FilePath& session_path,
+                   LogStore* store,
+                   std::string* filters);
+
+  // Writes @p buffer to @p path, deleting what's written on failure.
+  // @returns true on success.
+  static bool WriteFile(const base::FilePath& path, const std::string& buffer);
+
+  // @returns the path of the index for the log file at @p log_path.
+  static base::FilePath GetIndexPath(const base::FilePath& log_path);
+  // Retrieves the path of the log file @p index_path is the index of.
+  // @returns true iff @p index_path is the path of an index.
+  static bool GetLogPath(const base::FilePath& index_path,
+                         base::FilePath* log_path);
+
+  // KernelProcessEvents implementation.
+  virtual void OnProcessIsRunning(const base::Time& time,
+                                  const ProcessInfo& process_info);
+  virtual void OnProcessStarted(const base::Time& time,
+                                const ProcessInfo& process_info);
+  virtual void OnProcessEnded(const base::Time& time,
+                              const ProcessInfo& process_info,
+                              ULONG exit_status);
+
+  // KernelModuleEvents implementation.
+  virtual void OnModuleIsLoaded(DWORD process_id,
+                                const base::Time& time,
+                                const ModuleInformation& module_info);
+  virtual void OnModuleUnload(DWORD process_id,
+                              const base::Time& time,
+                              const ModuleInformation& module_info);
+  virtual void OnModuleLoad(DWORD process_id,
+                            const base::Time& time,
+                            const ModuleInformation& module_info);
+
+ private:
+  enum KernelEventType {
+    PROCESS_IS_RUNNING,
+    PROCESS_STARTED,
+    PROCESS_ENDED,
+    MODULE_IS_LOADED,
+    MODULE_UNLOAD,
+    MODULE_LOAD,
+  };
+
+  // A recorded kernel event, with only the fields that pertain to its
+  // type filled in.
+  struct KernelEvent {
+    KernelEventType type;
+    base::Time time;
+    DWORD process_id;
+    ModuleInformation module_info;
+    ProcessInfo process_info;
+    ULONG exit_status;
+  };
+
+  // The sections of an index, or of a checkpoint chunk, as located in its
+  // mapped bytes.
+  struct Contents;
+
+  // Serializes the rows of @p store from @p begin_row on, or from its
+  // first row if that's later, and @p kernel_events to @p buffer, with the
+  // given log identity, @p flags and @p filters.
+  static void Serialize(const LogStore& store,
+                        int begin_row,
+                        const std::vector<KernelEvent>& kernel_events,
+                        int64 log_size,
+                        int64 log_last_modified,
+                        uint32 flags,
+                        const std::string& filters,
+                        std::string* buffer);
+
+  // Locates and validates the sections of the index in @p data.
+  // @returns true iff @p data holds a whole index.
+  static bool ParseContents(const char* data,
+                            size_t size,
+                            Contents* contents);
+  // Locates the chunks of the checkpoint in @p data, up to the first one
+  // that's cut short or corrupt.
+  // @returns true iff @p data starts with a checkpoint header.
+  static bool ParseCheckpoint(const char* data,
+                              size_t size,
+                              std::vector<Contents>* chunks);
+
+  // Appends the rows of @p contents to @p store, short of the first
+  // @p skip_rows, and replays its kernel events.
+  void ApplyContents(const Contents& contents,
+                     size_t skip_rows,
+                     LogStore* store);
+
+  // Loads the file at @p path, which must have the given log identity and
+  // @p flags, appending its rows to @p store and replaying its kernel
+  // events. The filters go to @p filters, which may be NULL.
+  bool LoadFile(const base::FilePath& path,
+                int64 log_size,
+                int64 log_last_modified,
+                uint32 flags,
+                LogStore* store,
+                std::string* filters);
+
+  // Copies the kernel events recorded from @p begin on to @p events.
+  void GetKernelEvents(size_t begin, std::vector<KernelEvent>* events) const;
+
+  // Records @p event and issues it to our sinks.
+  void RecordEvent(const KernelEvent& event);
+  // Issues @p event to our sinks.
+  void ReplayEvent(const KernelEvent& event);
+
+  KernelProcessEvents* process_sink_;
+  KernelModuleEvents* module_sink_;
+  KernelProcessEvents* module_process_sink_;
+
+  mutable base::Lock kernel_events_lock_;
+  std::vector<KernelEvent> kernel_events_;  // Under kernel_events_lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(LogIndex);
+};
+
+#endif  // SAWBUCK_VIEWER_LOG_INDEX_H_
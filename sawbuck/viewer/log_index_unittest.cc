@@ -0,0 +1,466 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/log_index.h"
+
+#include <string>
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using testing::InSequence;
+using testing::StrictMock;
+
+class MockKernelModuleEvents: public KernelModuleEvents {
+ public:
+  MOCK_METHOD3(OnModuleIsLoaded, void(DWORD process_id,
+                                      const base::Time& time,
+                                      const ModuleInformation& module_info));
+  MOCK_METHOD3(OnModuleUnload, void(DWORD process_id,
+                                    const base::Time& time,
+                                    const ModuleInformation& module_info));
+  MOCK_METHOD3(OnModuleLoad, void(DWORD process_id,
+                                  const base::Time& time,
+                                  const ModuleInformation& module_info));
+};
+
+class MockKernelProcessEvents: public KernelProcessEvents {
+ public:
+  MOCK_METHOD2(OnProcessIsRunning, void (const base::Time& time,
+                                         const ProcessInfo& process_info));
+  MOCK_METHOD2(OnProcessStarted, void (const base::Time& time,
+                                       const ProcessInfo& process_info));
+  MOCK_METHOD3(OnProcessEnded, void (const base::Time& time,
+                                     const ProcessInfo& process_info,
+                                     ULONG exit_status));
+};
+
+const char kLogContents[] = "not really a log file";
+
+class LogIndexTest: public testing::Test {
+ public:
+  LogIndexTest() : time_(base::Time::Now()), store_(&file_table_) {
+    for (size_t i = 0; i < arraysize(trace_); ++i)
+      trace_[i] = 0x1000 + i;
+
+    module_.base_address = 0x10000000;
+    module_.module_size = 0x1000;
+    module_.image_checksum = 0xCAFE;
+    module_.time_date_stamp = 0xBABE;
+    module_.image_file_name = L"C:\\foo.dll";
+
+    memset(&process_.user_sid, 0,
+           sizeof(process_.user_sid) + sizeof(process_.sub_auths));
+    process_.process_id = 10;
+    process_.parent_id = 1;
+    process_.session_id = 2;
+    process_.user_sid.Revision = SID_REVISION;
+    process_.user_sid.SubAuthorityCount = 1;
+    process_.user_sid.SubAuthority[0] = 42;
+    process_.image_name = "foo.exe";
+    process_.command_line = L"foo.exe --bar";
+  }
+
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    log_path_ = temp_dir_.path().Append(L"test.etl");
+    ASSERT_EQ(static_cast<int>(arraysize(kLogContents)),
+              base::WriteFile(log_path_, kLogContents,
+                              arraysize(kLogContents)));
+
+    store_.AddRow(TRACE_LEVEL_ERROR, 10, 11, time_,
+                  file_table_.Intern("foo.cc"), 42, "A message",
+                  arraysize(trace_), trace_);
+    store_.AddRow(TRACE_LEVEL_INFORMATION, 20, 21, time_,
+                  StringTable::kEmptyAtom, 0, "", 0, NULL);
+    store_.AddRow(TRACE_LEVEL_WARNING, 30, 31, time_,
+                  file_table_.Intern("bar.cc"), 7, "Another message",
+                  2, trace_);
+  }
+
+  // Records a few kernel events to @p index.
+  void RecordKernelEvents(LogIndex* index) {
+    index->OnProcessIsRunning(time_, process_);
+    index->OnModuleIsLoaded(10, time_, module_);
+    index->OnModuleUnload(10, time_, module_);
+    index->OnProcessEnded(time_, process_, 3);
+  }
+
+  void ExpectKernelEvents() {
+    InSequence in;
+    EXPECT_CALL(process_events_, OnProcessIsRunning(time_, process_));
+    EXPECT_CALL(module_events_, OnModuleIsLoaded(10, time_, module_));
+    EXPECT_CALL(module_events_, OnModuleUnload(10, time_, module_));
+    EXPECT_CALL(process_events_, OnProcessEnded(time_, process_, 3));
+  }
+
+  void SaveIndex() {
+    LogIndex index(NULL, NULL);
+    RecordKernelEvents(&index);
+    ASSERT_TRUE(index.Save(log_path_, store_));
+  }
+
+  void ExpectRowsEqual(const LogStore& expected, const LogStore& actual) {
+    ASSERT_EQ(expected.num_rows(), actual.num_rows());
+    for (int row = 0; row < expected.num_rows(); ++row) {
+      EXPECT_EQ(expected.GetSeverity(row), actual.GetSeverity(row));
+      EXPECT_EQ(expected.GetProcessId(row), actual.GetProcessId(row));
+      EXPECT_EQ(expected.GetThreadId(row), actual.GetThreadId(row));
+      EXPECT_EQ(expected.GetTime(row), actual.GetTime(row));
+      EXPECT_EQ(expected.GetFileName(row), actual.GetFileName(row));
+      EXPECT_EQ(expected.GetLine(row), actual.GetLine(row));
+      std::string expected_buffer;
+      std::string actual_buffer;
+      EXPECT_EQ(expected.GetMessage(row, &expected_buffer),
+                actual.GetMessage(row, &actual_buffer));
+
+      std::vector<sym_util::Address> expected_trace;
+      std::vector<sym_util::Address> actual_trace;
+      expected.GetStackTrace(row, &expected_trace);
+      actual.GetStackTrace(row, &actual_trace);
+      EXPECT_EQ(expected_trace, actual_trace);
+    }
+  }
+
+ protected:
+  base::Time time_;
+  sym_util::Address trace_[5];
+  KernelModuleEvents::ModuleInformation module_;
+  KernelProcessEvents::ProcessInfo process_;
+
+  StringTable file_table_;
+  LogStore store_;
+
+  StrictMock<MockKernelModuleEvents> module_events_;
+  StrictMock<MockKernelProcessEvents> process_events_;
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath log_path_;
+};
+
+TEST_F(LogIndexTest, RecordingForwardsEvents) {
+  ExpectKernelEvents();
+
+  LogIndex index(&process_events_, &module_events_);
+  RecordKernelEvents(&index);
+}
+
+TEST_F(LogIndexTest, ForwardsProcessEventsToModuleSink) {
+  ExpectKernelEvents();
+  StrictMock<MockKernelProcessEvents> module_process_events;
+  EXPECT_CALL(module_process_events, OnProcessIsRunning(time_, process_));
+  EXPECT_CALL(module_process_events, OnProcessEnded(time_, process_, 3));
+
+  LogIndex index(&process_events_, &module_events_);
+  index.set_module_process_sink(&module_process_events);
+  RecordKernelEvents(&index);
+}
+
+TEST_F(LogIndexTest, SaveAndLoad) {
+  ASSERT_NO_FATAL_FAILURE(SaveIndex());
+  EXPECT_TRUE(base::PathExists(LogIndex::GetIndexPath(log_path_)));
+
+  // Load into a different table, where the file names intern differently.
+  StringTable other_table;
+  other_table.Intern("bar.cc");
+  other_table.Intern("baz.cc");
+  LogStore loaded(&other_table);
+
+  ExpectKernelEvents();
+  LogIndex index(&process_events_, &module_events_);
+  ASSERT_TRUE(index.Load(log_path_, &loaded));
+
+  ExpectRowsEqual(store_, loaded);
+  EXPECT_EQ(other_table.Intern("foo.cc"), loaded.GetFileAtom(0));
+  EXPECT_EQ(StringTable::kEmptyAtom, loaded.GetFileAtom(1));
+}
+
+TEST_F(LogIndexTest, SaveAndLoadEmpty) {
+  LogStore empty(&file_table_);
+  LogIndex saver(NULL, NULL);
+  ASSERT_TRUE(saver.Save(log_path_, empty));
+
+  LogStore loaded(&file_table_);
+  LogIndex index(&process_events_, &module_events_);
+  ASSERT_TRUE(index.Load(log_path_, &loaded));
+  EXPECT_EQ(0, loaded.num_rows());
+}
+
+TEST_F(LogIndexTest, LoadFailsWithoutIndex) {
+  LogStore loaded(&file_table_);
+  LogIndex index(&process_events_, &module_events_);
+  EXPECT_FALSE(index.Load(log_path_, &loaded));
+}
+
+TEST_F(LogIndexTest, LoadFailsForStaleIndex) {
+  ASSERT_NO_FATAL_FAILURE(SaveIndex());
+
+  // Grow the log file.
+  std::string contents(kLogContents);
+  contents += "and then some";
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            base::WriteFile(log_path_, contents.data(), contents.size()));
+
+  LogStore loaded(&file_table_);
+  LogIndex index(&process_events_, &module_events_);
+  EXPECT_FALSE(index.Load(log_path_, &loaded));
+  EXPECT_EQ(0, loaded.num_rows());
+}
+
+TEST_F(LogIndexTest, LoadFailsForTruncatedIndex) {
+  ASSERT_NO_FATAL_FAILURE(SaveIndex());
+
+  base::FilePath index_path(LogIndex::GetIndexPath(log_path_));
+  std::string contents;
+  ASSERT_TRUE(base::ReadFileToString(index_path, &contents));
+
+  // Chopping off the tail of the index must fail the load cleanly, with
+  // no rows appended and no events issued.
+  for (int len = 0; len < static_cast<int>(contents.size()); len += 7) {
+    ASSERT_EQ(len, base::WriteFile(index_path, contents.data(), len));
+
+    LogStore loaded(&file_table_);
+    LogIndex index(&process_events_, &module_events_);
+    EXPECT_FALSE(index.Load(log_path_, &loaded));
+    EXPECT_EQ(0, loaded.num_rows());
+  }
+}
+
+TEST_F(LogIndexTest, SaveAndLoadSession) {
+  std::string buffer;
+  {
+    LogIndex saver(NULL, NULL);
+    RecordKernelEvents(&saver);
+    saver.SerializeSession(store_, "some filters", &buffer);
+  }
+  base::FilePath session_path(temp_dir_.path().Append(L"test.sbsession"));
+  ASSERT_TRUE(LogIndex::WriteFile(session_path, buffer));
+
+  StringTable other_table;
+  LogStore loaded(&other_table);
+  std::string filters;
+
+  ExpectKernelEvents();
+  LogIndex index(&process_events_, &module_events_);
+  ASSERT_TRUE(index.LoadSession(session_path, &loaded, &filters));
+
+  ExpectRowsEqual(store_, loaded);
+  EXPECT_EQ("some filters", filters);
+}
+
+TEST_F(LogIndexTest, SessionSkipsEvictedRows) {
+  LogStore store(&file_table_);
+  for (int i = 0; i < 5; ++i) {
+    store.AddRow(TRACE_LEVEL_ERROR, i, i, time_, StringTable::kEmptyAtom,
+                 i, "message", 0, NULL);
+  }
+  LogStore::Retention retention;
+  retention.max_rows = 2;
+  store.set_retention(retention);
+  ASSERT_EQ(3, store.first_row());
+
+  LogIndex saver(NULL, NULL);
+  std::string buffer;
+  saver.SerializeSession(store, "", &buffer);
+  base::FilePath session_path(temp_dir_.path().Append(L"test.sbsession"));
+  ASSERT_TRUE(LogIndex::WriteFile(session_path, buffer));
+
+  LogStore loaded(&file_table_);
+  std::string filters;
+  LogIndex index(NULL, NULL);
+  ASSERT_TRUE(index.LoadSession(session_path, &loaded, &filters));
+  ASSERT_EQ(store.num_rows() - store.first_row(), loaded.num_rows());
+  for (int row = 0; row < loaded.num_rows(); ++row) {
+    EXPECT_EQ(store.GetLine(store.first_row() + row),
+              loaded.GetLine(row));
+  }
+}
+
+TEST_F(LogIndexTest, MappedFile) {
+  std::string buffer;
+  LogIndex saver(NULL, NULL);
+  saver.SerializeSession(store_, "", &buffer);
+  base::FilePath session_path(temp_dir_.path().Append(L"test.sbsession"));
+  ASSERT_TRUE(LogIndex::WriteFile(session_path, buffer));
+
+  LogIndex::MappedFile session;
+  ASSERT_TRUE(session.Open(session_path));
+  EXPECT_TRUE(session.is_session());
+  ASSERT_EQ(store_.num_rows(), session.num_rows());
+  for (int row = 0; row < session.num_rows(); ++row) {
+    std::string expected_buffer;
+    EXPECT_EQ(store_.GetMessage(row, &expected_buffer),
+              session.GetMessage(row));
+    EXPECT_EQ(store_.GetTime(row), session.GetTime(row));
+  }
+
+  // An index maps just as well.
+  ASSERT_NO_FATAL_FAILURE(SaveIndex());
+  LogIndex::MappedFile index;
+  ASSERT_TRUE(index.Open(LogIndex::GetIndexPath(log_path_)));
+  EXPECT_FALSE(index.is_session());
+  EXPECT_EQ(store_.num_rows(), index.num_rows());
+  EXPECT_EQ("Another message", index.GetMessage(2));
+
+  // The log itself doesn't.
+  LogIndex::MappedFile log;
+  EXPECT_FALSE(log.Open(log_path_));
+}
+
+TEST_F(LogIndexTest, LoadCheckpoint) {
+  // A chunk of the rows so far, and one of those to come, with the events
+  // recorded in between.
+  LogIndex saver(NULL, NULL);
+  std::string buffer;
+  std::string chunk;
+  size_t next_event = 0;
+  LogIndex::SerializeCheckpointHeader(&buffer);
+  saver.SerializeCheckpointChunk(store_, 0, "", &next_event, &chunk);
+  buffer.append(chunk);
+  RecordKernelEvents(&saver);
+  int next_row = store_.num_rows();
+  store_.AddRow(TRACE_LEVEL_INFORMATION, 40, 41, time_,
+                file_table_.Intern("foo.cc"), 8, "A later message", 0, NULL);
+  saver.SerializeCheckpointChunk(store_, next_row, "some filters",
+                                 &next_event, &chunk);
+  buffer.append(chunk);
+  EXPECT_EQ(saver.num_kernel_events(), next_event);
+
+  base::FilePath path(temp_dir_.path().Append(L"test.sbcheckpoint"));
+  ASSERT_TRUE(LogIndex::WriteFile(path, buffer));
+
+  StringTable other_table;
+  LogStore loaded(&other_table);
+  std::string filters;
+  ExpectKernelEvents();
+  LogIndex index(&process_events_, &module_events_);
+  ASSERT_TRUE(index.LoadSession(path, &loaded, &filters));
+  ExpectRowsEqual(store_, loaded);
+  EXPECT_EQ("some filters", filters);
+
+  // It only loads as a session.
+  LogStore other(&file_table_);
+  EXPECT_FALSE(index.Load(path, &other));
+}
+
+TEST_F(LogIndexTest, LoadCheckpointCutShort) {
+  LogIndex saver(NULL, NULL);
+  std::string buffer;
+  std::string chunk;
+  size_t next_event = 0;
+  LogIndex::SerializeCheckpointHeader(&buffer);
+  saver.SerializeCheckpointChunk(store_, 0, "", &next_event, &chunk);
+  buffer.append(chunk);
+
+  int next_row = store_.num_rows();
+  store_.AddRow(TRACE_LEVEL_INFORMATION, 40, 41, time_,
+                StringTable::kEmptyAtom, 8, "A lost message", 0, NULL);
+  saver.SerializeCheckpointChunk(store_, next_row, "", &next_event, &chunk);
+  buffer.append(chunk);
+
+  // The last chunk is cut short, then corrupted, as by a crash.
+  base::FilePath path(temp_dir_.path().Append(L"test.sbcheckpoint"));
+  for (int i = 0; i < 2; ++i) {
+    std::string cut(buffer);
+    if (i == 0)
+      cut.resize(buffer.size() - 10);
+    else
+      cut[buffer.size() - 10] ^= 0xFF;
+    ASSERT_TRUE(LogIndex::WriteFile(path, cut));
+
+    LogStore loaded(&file_table_);
+    std::string filters;
+    LogIndex index(NULL, NULL);
+    ASSERT_TRUE(index.LoadSession(path, &loaded, &filters));
+    EXPECT_EQ(next_row, loaded.num_rows());
+  }
+
+  // A header alone is an empty session.
+  LogIndex::SerializeCheckpointHeader(&buffer);
+  ASSERT_TRUE(LogIndex::WriteFile(path, buffer));
+  LogStore loaded(&file_table_);
+  std::string filters;
+  LogIndex index(NULL, NULL);
+  ASSERT_TRUE(index.LoadSession(path, &loaded, &filters));
+  EXPECT_EQ(0, loaded.num_rows());
+}
+
+TEST_F(LogIndexTest, CheckpointSkipsEvictedRows) {
+  LogStore store(&file_table_);
+  LogStore::Retention retention;
+  retention.max_rows = 3;
+  store.set_retention(retention);
+
+  // Each chunk holds two rows, and the store retains the last three.
+  LogIndex saver(NULL, NULL);
+  std::string buffer;
+  std::string chunk;
+  size_t next_event = 0;
+  LogIndex::SerializeCheckpointHeader(&buffer);
+  const char* kMessages[] = { "a", "b", "c", "d", "e", "f" };
+  for (int i = 0; i < 6; i += 2) {
+    store.AddRow(TRACE_LEVEL_ERROR, i, i, time_, StringTable::kEmptyAtom,
+                 i, kMessages[i], 0, NULL);
+    store.AddRow(TRACE_LEVEL_ERROR, i, i, time_, StringTable::kEmptyAtom,
+                 i + 1, kMessages[i + 1], 0, NULL);
+    saver.SerializeCheckpointChunk(store, i, "", &next_event, &chunk);
+    buffer.append(chunk);
+  }
+  ASSERT_EQ(3, store.first_row());
+  base::FilePath path(temp_dir_.path().Append(L"test.sbcheckpoint"));
+  ASSERT_TRUE(LogIndex::WriteFile(path, buffer));
+
+  LogStore loaded(&file_table_);
+  std::string filters;
+  LogIndex index(NULL, NULL);
+  ASSERT_TRUE(index.LoadSession(path, &loaded, &filters));
+  ASSERT_EQ(3, loaded.num_rows());
+  for (int row = 0; row < loaded.num_rows(); ++row)
+    EXPECT_EQ(3 + row, loaded.GetLine(row));
+
+  // The mapped rows skip them too.
+  LogIndex::MappedFile mapped;
+  ASSERT_TRUE(mapped.Open(path));
+  EXPECT_TRUE(mapped.is_session());
+  ASSERT_EQ(3, mapped.num_rows());
+  for (int row = 0; row < mapped.num_rows(); ++row) {
+    EXPECT_EQ(kMessages[3 + row], mapped.GetMessage(row));
+    EXPECT_EQ(time_, mapped.GetTime(row));
+  }
+}
+
+TEST_F(LogIndexTest, GetLogPath) {
+  base::FilePath log_path;
+  ASSERT_TRUE(LogIndex::GetLogPath(LogIndex::GetIndexPath(log_path_),
+                                   &log_path));
+  EXPECT_EQ(log_path_.value(), log_path.value());
+  EXPECT_FALSE(LogIndex::GetLogPath(log_path_, &log_path));
+  EXPECT_FALSE(LogIndex::GetLogPath(base::FilePath(L".sbidx"), &log_path));
+}
+
+TEST_F(LogIndexTest, IndexAndSessionDontMix) {
+  ASSERT_NO_FATAL_FAILURE(SaveIndex());
+
+  // An index doesn't load as a session.
+  LogStore loaded(&file_table_);
+  std::string filters;
+  LogIndex index(&process_events_, &module_events_);
+  EXPECT_FALSE(index.LoadSession(LogIndex::GetIndexPath(log_path_),
+                                 &loaded, &filters));
+  EXPECT_EQ(0, loaded.num_rows());
+}
+
+}  // namespace
@@ -15,23 +15,132 @@
 // Log viewer window implementation.
 #include "sawbuck/viewer/log_list_view.h"
 
-#include <atlalloc.h>
+#include <atldlgs.h>
 #include <atlframe.h>
+#include <atlgdi.h>
 #include <wmistr.h>
 #include <evntrace.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include "base/bind.h"
+#include "base/files/file.h"
+#include "base/files/file_path.h"
 #include "base/logging.h"
 #include "base/i18n/time_formatting.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
-#include "base/strings/utf_string_conversions.h"
-#include "pcrecpp.h"  // NOLINT
+#include "sawbuck/common/perf_counters.h"
+#include "sawbuck/common/utf8_transcoder.h"
+#include "sawbuck/log_lib/cpu_profile_service.h"
+#include "sawbuck/log_lib/cpu_timeline_service.h"
+#include "sawbuck/log_lib/disk_io_latency_service.h"
 #include "sawbuck/log_lib/process_info_service.h"
+#include "sawbuck/log_lib/registry_access_service.h"
+#include "sawbuck/log_lib/sawbuck_trace_provider.h"
+#include "sawbuck/log_lib/symbol_lookup_service.h"
+#include "sawbuck/log_lib/thread_context_service.h"
+#include "sawbuck/log_lib/thread_info_service.h"
+#include "sawbuck/viewer/column_sorted_log_view.h"
 #include "sawbuck/viewer/const_config.h"
+#include "sawbuck/viewer/log_store.h"
+#include "sawbuck/viewer/log_text_writer.h"
 #include "sawbuck/viewer/resource.h"
+#include "sawbuck/viewer/row_batch.h"
+#include "sawbuck/viewer/row_highlighter.h"
 #include "sawbuck/viewer/stack_trace_list_view.h"
 
 namespace {
 
+PerfCounter get_disp_info_counter("ListView.GetDispInfo", 16);
+PerfCounter draw_row_counter("ListView.DrawRow", 16);
+
+// The distinct addresses of the stack traces of the rows of a process, and
+// the time of one of the rows. The ids of the pooled traces gathered so far
+// let rows sharing a trace skip re-gathering its frames.
+struct ProcessAddresses {
+  base::Time time;
+  std::vector<sym_util::Address> addresses;
+  std::set<StackTracePool::StackId> stacks;
+};
+typedef std::map<DWORD, ProcessAddresses> ProcessAddressesMap;
+
+// The time either side of a row we show the CPU activity of its thread for.
+const int kCpuActivityWindowMs = 50;
+
+// The disk reads report spans the selected rows, and at least this long
+// either side of a single row. It lists no more than so many files.
+const int kMinDiskIoReportWindowMs = 1000;
+const size_t kMaxDiskIoReportFiles = 20;
+
+// The registry reports span the selected rows likewise, and list no more
+// than so many tallies.
+const int kMinRegistryReportWindowMs = 1000;
+const size_t kMaxRegistryReportKeys = 20;
+
+// The hot functions report spans the selected rows likewise. It resolves the
+// symbols of no more than so many of the hottest frames, of which it lists
+// no more than so many functions.
+const int kMinHotFunctionsWindowMs = 1000;
+const size_t kMaxHotFrames = 1024;
+const size_t kMaxHotFunctions = 20;
+
+// The kernel context report spans this long either side of a row, and lists
+// no more than so many of its thread's kernel events.
+const int kKernelContextWindowMs = 50;
+const size_t kMaxKernelContextRecords = 40;
+
+// @returns the description of a kernel context record of @p kind.
+const wchar_t* GetRecordKindText(IThreadContextService::Record::Kind kind) {
+  switch (kind) {
+    case IThreadContextService::Record::SOFT_FAULT:
+      return L"Soft fault";
+    case IThreadContextService::Record::HARD_FAULT:
+      return L"Hard fault";
+    case IThreadContextService::Record::HARD_FAULT_READ:
+      return L"Hard fault read";
+    case IThreadContextService::Record::FAULT_VIOLATION:
+      return L"Access violation";
+    case IThreadContextService::Record::DISK_READ:
+      return L"Disk read";
+    case IThreadContextService::Record::DISK_WRITE:
+      return L"Disk write";
+    case IThreadContextService::Record::SWITCHED_IN:
+      return L"Switched in";
+    case IThreadContextService::Record::SWITCHED_OUT:
+      return L"Switched out";
+    case IThreadContextService::Record::READIED:
+      return L"Readied";
+  }
+
+  NOTREACHED();
+  return L"";
+}
+
+// The samples of a function, over the hot frames within it.
+struct FunctionSamples {
+  FunctionSamples() : inclusive(0), exclusive(0) {
+  }
+
+  std::wstring name;
+  uint64 inclusive;
+  uint64 exclusive;
+};
+
+// Orders functions by their own samples first.
+bool IsHotterFunction(const FunctionSamples& a, const FunctionSamples& b) {
+  if (a.exclusive != b.exclusive)
+    return a.exclusive > b.exclusive;
+  return a.inclusive > b.inclusive;
+}
+
+// Copies @p piece to @p str, unless it's a piece of @p str already.
+void AssignPiece(const base::StringPiece& piece, std::string* str) {
+  if (piece.data() != str->data())
+    piece.CopyToString(str);
+}
+
 const char* GetSeverityText(UCHAR severity) {
   switch (severity)  {
     case TRACE_LEVEL_NONE:
@@ -66,6 +175,184 @@ bool IsSelected(UINT state) {
 
 const int kNoItem = -1;
 
+// The number of cells to cache display text for, a few screenfuls.
+const size_t kDisplayCacheSize = 16384;
+// Display text is formatted anew in no time, so it's the cheapest memory
+// to refill.
+const double kDisplayTextRefillCost = 1.0;
+
+// The width of the hit density strip, and the color of its densest hits.
+const int kHitStripWidth = 6;
+const COLORREF kHitColor = RGB(255, 128, 0);
+
+// The height of the volume strip, and the colors of its busiest times by
+// their worst severity.
+const int kVolumeStripHeight = 8;
+const COLORREF kVolumeColor = RGB(48, 96, 192);
+const COLORREF kWarningVolumeColor = RGB(255, 176, 0);
+const COLORREF kErrorVolumeColor = RGB(224, 0, 0);
+
+// Collects text in a global buffer for the clipboard.
+class ClipboardTextSink : public LogTextWriter::Sink {
+ public:
+  ClipboardTextSink() : data_(NULL), capacity_(0), length_(0) {
+  }
+
+  ~ClipboardTextSink() {
+    if (data_ != NULL)
+      ::GlobalFree(data_);
+  }
+
+  virtual bool Write(const base::StringPiece& text) {
+    TranscodeUTF8ToWide(text.data(), text.size(), &wide_text_);
+    if (!Reserve(length_ + wide_text_.size() + 1))
+      return false;
+
+    wchar_t* data = reinterpret_cast<wchar_t*>(::GlobalLock(data_));
+    memcpy(data + length_, wide_text_.data(),
+           wide_text_.size() * sizeof(wchar_t));
+    length_ += wide_text_.size();
+    data[length_] = L'\0';
+    ::GlobalUnlock(data_);
+
+    return true;
+  }
+
+  // @returns the zero terminated text, and gives up its ownership.
+  HGLOBAL Release() {
+    if (data_ == NULL) {
+      if (!Reserve(1))
+        return NULL;
+      wchar_t* data = reinterpret_cast<wchar_t*>(::GlobalLock(data_));
+      data[0] = L'\0';
+      ::GlobalUnlock(data_);
+    }
+
+    HGLOBAL data = data_;
+    data_ = NULL;
+    return data;
+  }
+
+ private:
+  // Grows the buffer to hold at least @p length characters.
+  bool Reserve(size_t length) {
+    if (length <= capacity_)
+      return true;
+
+    // Grow by doubling, to keep the cost of copying linear.
+    size_t capacity = std::max(length, capacity_ * 2);
+    HGLOBAL data = NULL;
+    if (data_ == NULL) {
+      data = ::GlobalAlloc(GMEM_MOVEABLE, capacity * sizeof(wchar_t));
+    } else {
+      data = ::GlobalReAlloc(data_, capacity * sizeof(wchar_t),
+                             GMEM_MOVEABLE);
+    }
+    if (data == NULL) {
+      LOG(ERROR) << "Unable to allocate clipboard data";
+      return false;
+    }
+
+    data_ = data;
+    capacity_ = capacity;
+    return true;
+  }
+
+  HGLOBAL data_;
+  size_t capacity_;
+  size_t length_;
+  std::wstring wide_text_;
+};
+
+// Writes text straight to a file.
+class FileTextSink : public LogTextWriter::Sink {
+ public:
+  explicit FileTextSink(base::File* file) : file_(file) {
+  }
+
+  virtual bool Write(const base::StringPiece& text) {
+    int size = static_cast<int>(text.size());
+    return file_->WriteAtCurrentPos(text.data(), size) == size;
+  }
+
+ private:
+  base::File* file_;
+};
+
+_COMDLG_FILTERSPEC kTextFileSpec[] = { {L"Text File", L"*.txt"} };
+
+// The number of rows to sample over the log when sizing columns, besides
+// the visible ones, and the margin the list view keeps around cell text.
+const int kAutoSizeSampleRows = 256;
+const int kCellMargin = 12;
+
+// While the view isn't following the tail, new rows only move the scroll
+// thumb, so the item count is brought up to date this seldom.
+const UINT_PTR kItemCountTimerId = 1;
+const UINT kScrolledAwayUpdateMs = 1000;
+
+// Measures the glyphs of the list view font.
+class WindowGlyphMeasurer : public GlyphWidthTable::Measurer {
+ public:
+  WindowGlyphMeasurer(HWND window, HFONT font)
+      : window_(window), font_(font) {
+  }
+
+  virtual bool GetCharWidths(wchar_t first, size_t count, int* widths) {
+    CClientDC dc(window_);
+    HFONT old_font = dc.SelectFont(font_);
+    bool ret = ::GetCharWidth32(dc, first, first + count - 1, widths) != 0;
+    dc.SelectFont(old_font);
+    return ret;
+  }
+
+ private:
+  HWND window_;
+  HFONT font_;
+};
+
+// Maps the characters of the list view font to glyphs, and measures them.
+class WindowGlyphRunMeasurer : public GlyphRunCache::Measurer {
+ public:
+  WindowGlyphRunMeasurer(HWND window, HFONT font)
+      : window_(window), font_(font) {
+  }
+
+  virtual bool GetGlyphs(wchar_t first,
+                         size_t count,
+                         uint16* glyphs,
+                         int* widths) {
+    std::vector<wchar_t> chars(count);
+    for (size_t i = 0; i < count; ++i)
+      chars[i] = static_cast<wchar_t>(first + i);
+
+    CClientDC dc(window_);
+    HFONT old_font = dc.SelectFont(font_);
+    bool ret = ::GetGlyphIndicesW(dc, &chars[0], static_cast<int>(count),
+                                  reinterpret_cast<WORD*>(glyphs),
+                                  GGI_MARK_NONEXISTING_GLYPHS) != GDI_ERROR &&
+        ::GetCharWidth32(dc, first, first + count - 1, widths) != 0;
+    dc.SelectFont(old_font);
+    return ret;
+  }
+
+ private:
+  HWND window_;
+  HFONT font_;
+};
+
+// The space the list view leaves left of cell text.
+const int kCellTextIndent = kCellMargin / 2;
+
+// @returns the blend of @p from and @p to, that has @p weight / 256 of
+//     the latter.
+COLORREF BlendColors(COLORREF from, COLORREF to, int weight) {
+  return RGB(
+      (GetRValue(from) * (256 - weight) + GetRValue(to) * weight) / 256,
+      (GetGValue(from) * (256 - weight) + GetGValue(to) * weight) / 256,
+      (GetBValue(from) * (256 - weight) + GetBValue(to) * weight) / 256);
+}
+
 }  // namespace
 
 using base::StringPrintf;
@@ -77,7 +364,8 @@ const LogListView::ColumnInfo LogListView::kColumns[] = {
   { 80, L"Time" },
   { 180, L"File" },
   { 30, L"Line" },
-  { 640, L"Message", }
+  { 640, L"Message", },
+  { 80, L"Count" }
 };
 
 const wchar_t* LogListView::kConfigKeyName =
@@ -98,6 +386,12 @@ bool LogViewFormatter::FormatColumn(ILogView* log_view,
   DCHECK(log_view != NULL);
   DCHECK(str != NULL);
 
+  // Going to the store takes one lookup for the row, rather than a chain
+  // of calls through the views stacked on it for each column.
+  const LogStore* store = log_view->GetMappedStore();
+  if (store != NULL)
+    return FormatStoreColumn(*store, log_view->GetStoreRow(row), col, str);
+
   switch (col) {
     case SEVERITY:
       *str = GetSeverityText(log_view->GetSeverity(row));
@@ -112,44 +406,11 @@ bool LogViewFormatter::FormatColumn(ILogView* log_view,
       break;
 
     case TIME:
-      {
-        if (!base_time_.is_null()) {
-          base::Time row_time = log_view->GetTime(row);
-          base::TimeDelta time_delta = row_time - base_time_;
-          bool is_negative = false;
-
-          if (time_delta.ToInternalValue() < 0) {
-            is_negative = true;
-            time_delta = -time_delta;
-          }
-
-          int64 hours = time_delta.InHours();
-          int64 minutes = time_delta.InMinutes() % 60;
-          int64 seconds = time_delta.InSeconds() % 60;
-          int64 milliseconds = time_delta.InMilliseconds() % 1000;
-
-          if (is_negative) {
-            *str = StringPrintf("-%02lld:%02lld:%02lld-%03lld",
-                                hours, minutes, seconds, milliseconds);
-          } else {
-            *str = StringPrintf("%02lld:%02lld:%02lld-%03lld",
-                                hours, minutes, seconds, milliseconds);
-          }
-        } else {
-          base::Time time = log_view->GetTime(row);
-          base::Time::Exploded exploded;
-          time.LocalExplode(&exploded);
-          *str = StringPrintf("%02d:%02d:%02d-%03d",
-                              exploded.hour,
-                              exploded.minute,
-                              exploded.second,
-                              exploded.millisecond);
-        }
-      }
+      time_formatter_.Format(log_view->GetTime(row), str);
       break;
 
     case FILE:
-      *str = log_view->GetFileName(row);
+      AssignPiece(log_view->GetFileNamePiece(row, str), str);
       break;
 
     case LINE:
@@ -157,8 +418,134 @@ bool LogViewFormatter::FormatColumn(ILogView* log_view,
       break;
 
     case MESSAGE:
-      *str = log_view->GetMessage(row);
+      AssignPiece(log_view->GetMessagePiece(row, str), str);
+      break;
+
+    case COUNT: {
+      int count = log_view->GetRepeatCount(row);
+      if (count == 1) {
+        str->clear();
+        break;
+      }
+
+      std::string last_time;
+      time_formatter_.Format(log_view->GetLastTime(row), &last_time);
+      *str = StringPrintf("%d, last %s", count, last_time.c_str());
+      break;
+    }
+
+    default:
+      return false;
+      break;
+  }
+
+  return true;
+}
+
+bool LogViewFormatter::FormatBatchColumn(const RowBatch& batch,
+                                         int index,
+                                         Column col,
+                                         std::string* str) {
+  DCHECK(str != NULL);
+  DCHECK(batch.HasColumns(RowBatch::FORMATTED_COLUMNS));
+  DCHECK_LE(0, index);
+  DCHECK_LT(index, batch.num_rows);
+
+  switch (col) {
+    case SEVERITY:
+      *str = GetSeverityText(batch.severities[index]);
+      break;
+
+    case PROCESS_ID:
+      *str = StringPrintf("%d", batch.process_ids[index]);
+      break;
+
+    case THREAD_ID:
+      *str = StringPrintf("%d", batch.thread_ids[index]);
+      break;
+
+    case TIME:
+      time_formatter_.Format(batch.times[index], str);
+      break;
+
+    case FILE:
+      batch.file_names[index].CopyToString(str);
+      break;
+
+    case LINE:
+      *str = StringPrintf("%d", batch.lines[index]);
+      break;
+
+    case MESSAGE:
+      batch.messages[index].CopyToString(str);
+      break;
+
+    case COUNT: {
+      int count = batch.repeat_counts[index];
+      if (count == 1) {
+        str->clear();
+        break;
+      }
+
+      std::string last_time;
+      time_formatter_.Format(batch.last_times[index], &last_time);
+      *str = StringPrintf("%d, last %s", count, last_time.c_str());
+      break;
+    }
+
+    default:
+      return false;
+      break;
+  }
+
+  return true;
+}
+
+bool LogViewFormatter::FormatStoreColumn(const LogStore& store,
+                                         int row,
+                                         Column col,
+                                         std::string* str) {
+  switch (col) {
+    case SEVERITY:
+      *str = GetSeverityText(store.GetSeverity(row));
+      break;
+
+    case PROCESS_ID:
+      *str = StringPrintf("%d", store.GetProcessId(row));
+      break;
+
+    case THREAD_ID:
+      *str = StringPrintf("%d", store.GetThreadId(row));
+      break;
+
+    case TIME:
+      time_formatter_.Format(store.GetTime(row), str);
+      break;
+
+    case FILE:
+      *str = store.GetFileName(row);
+      break;
+
+    case LINE:
+      *str = StringPrintf("%d", store.GetLine(row));
+      break;
+
+    case MESSAGE:
+      AssignPiece(store.GetMessage(row, str), str);
+      break;
+
+    case COUNT: {
+      int count = store.GetRepeatCount(row);
+      if (count == 1) {
+        str->clear();
+        break;
+      }
+
+      std::string last_time;
+      time_formatter_.Format(store.GetLastTime(row), &last_time);
+      *str = StringPrintf("%d, last %s", count, last_time.c_str());
       break;
+    }
 
     default:
       return false;
@@ -169,10 +556,27 @@ bool LogViewFormatter::FormatColumn(ILogView* log_view,
 }
 
 LogListView::LogListView(CUpdateUIBase* update_ui)
-    : log_view_(NULL), event_cookie_(0),
+    : log_view_(NULL), event_cookie_(0), unsorted_log_view_(NULL),
+      sort_column_(kNoSortColumn), sort_descending_(false), first_row_(0),
       update_ui_(update_ui), stack_trace_view_(NULL),
-      process_info_service_(NULL) {
+      process_info_service_(NULL), thread_info_service_(NULL),
+      cpu_timeline_service_(NULL), disk_io_latency_service_(NULL),
+      registry_access_service_(NULL),
+      cpu_profile_service_(NULL), hot_samples_(0),
+      hot_frames_handle_(ISymbolLookupService::kInvalidHandle),
+      thread_context_service_(NULL), symbol_lookup_service_(NULL),
+      prefetched_from_(0), prefetched_to_(-1), show_hits_(false),
+      volume_start_(0), volume_end_(0),
+      display_cache_(kDisplayCacheSize), last_hint_row_(0),
+      glyph_widths_font_(NULL), glyph_runs_font_(NULL),
+      glyph_runs_text_height_(0), bold_font_base_(NULL),
+      item_count_timer_set_(false), following_(true) {
   ui_loop_ = base::MessageLoop::current();
+  highlighter_.reset(new RowHighlighter(
+      base::Bind(&LogListView::OnRowsRestyled, base::Unretained(this))));
+  memory_budget_id_ = MemoryBudget::Get()->Register(
+      "display", kDisplayTextRefillCost,
+      base::Bind(&LogListView::EvictDisplayText, base::Unretained(this)));
 
   context_menu_bar_.LoadMenu(IDR_LIST_VIEW_CONTEXT_MENU);
   context_menu_ = context_menu_bar_.GetSubMenu(0);
@@ -181,18 +585,51 @@ LogListView::LogListView(CUpdateUIBase* update_ui)
                  wrong_number_of_column_info);
 }
 
+LogListView::~LogListView() {
+  MemoryBudget::Get()->Unregister(memory_budget_id_);
+}
+
 void LogListView::SetLogView(ILogView* log_view) {
+  unsorted_log_view_ = log_view;
+
+  // The view sorting the old one goes once we've let go of it.
+  scoped_ptr<ColumnSortedLogView> old_sorted_view(
+      column_sorted_view_.release());
+  if (log_view != NULL && sort_column_ != kNoSortColumn) {
+    column_sorted_view_.reset(new ColumnSortedLogView(
+        log_view, static_cast<LogViewFormatter::Column>(sort_column_),
+        sort_descending_));
+    log_view = column_sorted_view_.get();
+  }
+
+  ShowLogView(log_view);
+}
+
+void LogListView::SetHighlightRules(const std::vector<HighlightRule>& rules) {
+  highlighter_->SetRules(rules);
+}
+
+void LogListView::ShowLogView(ILogView* log_view) {
   if (log_view_ == log_view)
     return;
 
-  // Unregister from old log view.
+  // Unregister from old log view, once it's rendered any copy of ours.
   if (log_view_ != NULL) {
+    RenderPendingCopy();
     log_view_->Unregister(event_cookie_);
     event_cookie_ = 0;
   }
 
-  // Store the new one.
+  // Store the new one, and any find in progress is moot.
   log_view_ = log_view;
+  first_row_ = log_view_ != NULL ? log_view_->GetFirstRow() : 0;
+  finder_.reset(log_view_ != NULL ? new LogFinder(log_view_, this) : NULL);
+  if (finder_.get() != NULL)
+    finder_->set_view_first_row(first_row_);
+  ClearHits();
+  display_cache_.Invalidate();
+  prefetched_to_ = prefetched_from_ - 1;
+  highlighter_->SetView(log_view_);
 
   // Adjust our size if we've been created already.
   if (IsWindow()) {
@@ -200,6 +637,8 @@ void LogListView::SetLogView(ILogView* log_view) {
     SetItemCountEx(num_rows, 0);  // Invalidate the whole list.
     // We initially want to show the latest items
     EnsureVisible(num_rows - 1, TRUE /* PartialOK */);
+    following_ = true;
+    PaintVolumeStrip();
   }
 
   // Register for event notifications.
@@ -247,35 +686,260 @@ LRESULT LogListView::OnCreate(UINT msg,
 }
 
 void LogListView::OnDestroy() {
+  if (finder_.get() != NULL)
+    finder_->Cancel();
+  if (hot_frames_handle_ != ISymbolLookupService::kInvalidHandle) {
+    symbol_lookup_service_->CancelRequest(hot_frames_handle_);
+    hot_frames_handle_ = ISymbolLookupService::kInvalidHandle;
+  }
   if (log_view_ != NULL) {
     log_view_->Unregister(event_cookie_);
   }
+  highlighter_->SetView(NULL);
   SaveColumns();
 }
 
 LRESULT LogListView::OnGetDispInfo(NMHDR* pnmh) {
+  ScopedPerfTimer timer(&get_disp_info_counter);
+  ScopedSawbuckTraceEvent trace("LogListView::OnGetDispInfo", this);
   NMLVDISPINFO* info = reinterpret_cast<NMLVDISPINFO*>(pnmh);
   int col = info->item.iSubItem;
   size_t row = info->item.iItem;
 
-  if (col == COL_SEVERITY && info->item.mask & LVIF_IMAGE) {
+  if (col == COL_SEVERITY && info->item.mask & LVIF_IMAGE &&
+      static_cast<int>(row) >= first_row_) {
     info->item.iImage =
         GetImageIndexForSeverity(log_view_->GetSeverity(row));
   }
 
+  item_text_ = GetCellText(row, col);
+  if (info->item.mask & LVIF_TEXT)
+    info->item.pszText = const_cast<LPWSTR>(item_text_.c_str());
+
+  return 0;
+}
+
+LRESULT LogListView::OnCacheHint(NMHDR* pnmh) {
+  NMLVCACHEHINT* hint = reinterpret_cast<NMLVCACHEHINT*>(pnmh);
+  int from = hint->iFrom;
+  int to = hint->iTo;
+
+  // Read a page ahead in the direction we're scrolling.
+  int page = to - from + 1;
+  if (from >= last_hint_row_)
+    to += page;
+  else
+    from -= page;
+  last_hint_row_ = hint->iFrom;
+
+  from = std::max(from, first_row_);
+  to = std::min(to, log_view_->GetNumRows() - 1);
+  for (int row = from; row <= to; ++row) {
+    for (int col = COL_SEVERITY; col < COL_MAX; ++col) {
+      if (!display_cache_.Has(row, col))
+        GetCellText(row, col);
+    }
+  }
+
+  // The rows we're about to show are the likeliest to be selected next.
+  PrefetchSymbols(from, to);
+
+  return 0;
+}
+
+LRESULT LogListView::OnCustomDraw(NMHDR* pnmh) {
+  NMLVCUSTOMDRAW* draw = reinterpret_cast<NMLVCUSTOMDRAW*>(pnmh);
+  switch (draw->nmcd.dwDrawStage) {
+    case CDDS_PREPAINT:
+      return CDRF_NOTIFYITEMDRAW;
+
+    case CDDS_ITEMPREPAINT:
+      if (DrawRow(draw->nmcd.hdc, static_cast<int>(draw->nmcd.dwItemSpec)))
+        return CDRF_SKIPDEFAULT;
+      return CDRF_DODEFAULT;
+  }
+
+  return CDRF_DODEFAULT;
+}
+
+bool LogListView::DrawRow(HDC hdc, int row) {
+  ScopedPerfTimer timer(&draw_row_counter);
+  if (log_view_ == NULL)
+    return false;
+
+  CRect row_rect;
+  if (!GetItemRect(row, &row_rect, LVIR_BOUNDS))
+    return false;
+
+  // Selected rows show as the list view shows them, in the highlight
+  // while we have the focus, and greyed while we don't.
+  UINT state = GetItemState(row, LVIS_SELECTED | LVIS_FOCUSED);
+  bool has_focus = ::GetFocus() == m_hWnd;
+  COLORREF background = GetBkColor();
+  COLORREF text_color = GetTextColor();
+  const HighlightRule* rule = NULL;
+  if (row >= first_row_)
+    rule = highlighter_->GetRule(highlighter_->GetStyle(row));
+  if (IsSelected(state)) {
+    background = ::GetSysColor(has_focus ? COLOR_HIGHLIGHT : COLOR_BTNFACE);
+    if (has_focus)
+      text_color = ::GetSysColor(COLOR_HIGHLIGHTTEXT);
+  } else if (rule != NULL) {
+    if (rule->background_color != HighlightRule::kDefaultColor)
+      background = rule->background_color;
+    if (rule->text_color != HighlightRule::kDefaultColor)
+      text_color = rule->text_color;
+  }
+
+  // Bold rows are laid out by GDI, as the glyph runs are for our font.
+  GlyphRunCache* glyph_runs = GetGlyphRuns();
+  HFONT font = glyph_runs_font_;
+  if (rule != NULL && rule->bold) {
+    font = GetBoldFont();
+    glyph_runs = NULL;
+  }
+  CDCHandle dc(hdc);
+  dc.FillSolidRect(&row_rect, background);
+  HFONT old_font = dc.SelectFont(font);
+  COLORREF old_text_color = dc.SetTextColor(text_color);
+  int old_mode = dc.SetBkMode(TRANSPARENT);
+
+  if (row >= first_row_) {
+    CRect icon_rect;
+    if (GetSubItemRect(row, COL_SEVERITY, LVIR_ICON, &icon_rect)) {
+      CImageList images(GetImageList(LVSIL_SMALL));
+      images.Draw(dc, GetImageIndexForSeverity(log_view_->GetSeverity(row)),
+                  icon_rect.left, icon_rect.top, ILD_TRANSPARENT);
+    }
+  }
+
+  int num_columns = std::min(GetHeader().GetItemCount(),
+                             static_cast<int>(COL_MAX));
+  for (int col = COL_SEVERITY; col < num_columns; ++col) {
+    CRect cell;
+    if (!GetSubItemRect(row, col, LVIR_LABEL, &cell))
+      continue;
+    cell.left += kCellTextIndent;
+    cell.right -= kCellTextIndent;
+    if (cell.IsRectEmpty())
+      continue;
+
+    const std::wstring& text = GetCellText(row, col);
+    if (text.empty())
+      continue;
+
+    // Text the font lacks glyphs for goes to GDI, which links in fonts
+    // that have them.
+    if (glyph_runs != NULL &&
+        glyph_runs->Layout(text, cell.Width(), &glyph_run_)) {
+      int y = cell.top + (cell.Height() - glyph_runs_text_height_) / 2;
+      ::ExtTextOutW(dc, cell.left, y, ETO_CLIPPED | ETO_GLYPH_INDEX, &cell,
+                    reinterpret_cast<LPCWSTR>(&glyph_run_.glyphs[0]),
+                    static_cast<UINT>(glyph_run_.glyphs.size()),
+                    &glyph_run_.advances[0]);
+    } else {
+      dc.DrawText(text.c_str(), static_cast<int>(text.size()), &cell,
+                  DT_SINGLELINE | DT_VCENTER | DT_NOPREFIX |
+                      DT_END_ELLIPSIS);
+    }
+  }
+
+  if ((state & LVIS_FOCUSED) != 0 && has_focus)
+    dc.DrawFocusRect(&row_rect);
+
+  dc.SetBkMode(old_mode);
+  dc.SetTextColor(old_text_color);
+  dc.SelectFont(old_font);
+  return true;
+}
+
+void LogListView::PrefetchSymbols(int from, int to) {
+  if (symbol_lookup_service_ == NULL || from > to)
+    return;
+
+  // Gather the distinct addresses by process, as the frames of a busy
+  // thread's traces tend to repeat from row to row. The symbols are cached
+  // by module, so the time of any row an address occurs in will do.
+  ProcessAddressesMap by_process;
+
+  std::vector<sym_util::Address> buffer;
+  for (int row = from; row <= to; ++row) {
+    if (row >= prefetched_from_ && row <= prefetched_to_)
+      continue;
+
+    const sym_util::Address* trace = NULL;
+    size_t depth = log_view_->GetStackTracePiece(row, &trace, &buffer);
+    if (depth == 0)
+      continue;
+
+    DWORD pid = log_view_->GetProcessId(row);
+    ProcessAddressesMap::iterator it(by_process.find(pid));
+    if (it == by_process.end()) {
+      it = by_process.insert(std::make_pair(pid, ProcessAddresses())).first;
+      it->second.time = log_view_->GetTime(row);
+    }
+
+    StackTracePool::StackId stack = log_view_->GetStackTraceId(row);
+    if (stack != StackTracePool::kUnknownStack &&
+        !it->second.stacks.insert(stack).second) {
+      continue;
+    }
+
+    for (size_t i = 0; i < depth; ++i) {
+      it->second.addresses.push_back(trace[i]);
+    }
+  }
+
+  prefetched_from_ = from;
+  prefetched_to_ = to;
+
+  ProcessAddressesMap::iterator it(by_process.begin());
+  for (; it != by_process.end(); ++it) {
+    std::vector<sym_util::Address>& addresses = it->second.addresses;
+    std::sort(addresses.begin(), addresses.end());
+    addresses.erase(std::unique(addresses.begin(), addresses.end()),
+                    addresses.end());
+    symbol_lookup_service_->PrefetchAddresses(it->first, it->second.time,
+                                              &addresses[0],
+                                              addresses.size());
+  }
+}
+
+const std::wstring& LogListView::GetCellText(int row, int col) {
+  if (row < first_row_)
+    return base::EmptyWString();
+
+  // The count of a row changes as it collapses repeats, so it's formatted
+  // afresh, which is cheap.
+  bool cacheable = col != COL_COUNT || !log_view_->CollapsesRepeats();
+  const std::wstring* cached = NULL;
+  if (cacheable)
+    cached = display_cache_.Get(row, col);
+  if (cached != NULL)
+    return *cached;
+
   std::string temp_text;
   formatter_.FormatColumn(log_view_,
                           row,
                           static_cast<LogViewFormatter::Column>(col),
                           &temp_text);
 
-  item_text_ = base::UTF8ToWide(temp_text);
-  base::TrimWhitespace(item_text_, base::TRIM_TRAILING, &item_text_);
+  std::wstring text(TranscodeUTF8ToWide(temp_text));
+  base::TrimWhitespace(text, base::TRIM_TRAILING, &text);
+  if (!cacheable) {
+    uncached_text_.swap(text);
+    return uncached_text_;
+  }
+  const std::wstring& cached_text = display_cache_.Put(row, col, text);
+  MemoryBudget::Get()->ReportUsage(memory_budget_id_, display_cache_.bytes());
+  return cached_text;
+}
 
-  if (info->item.mask & LVIF_TEXT)
-    info->item.pszText = const_cast<LPWSTR>(item_text_.c_str());
+void LogListView::EvictDisplayText(uint64 bytes) {
+  DCHECK_EQ(ui_loop_, base::MessageLoop::current());
 
-  return 0;
+  display_cache_.Shrink(static_cast<size_t>(bytes));
+  MemoryBudget::Get()->ReportUsage(memory_budget_id_, display_cache_.bytes());
 }
 
 LRESULT LogListView::OnItemChanged(NMHDR* pnmh) {
@@ -286,21 +950,24 @@ LRESULT LogListView::OnItemChanged(NMHDR* pnmh) {
   if (stack_trace_view_ != NULL) {
     if (IsSelected(info->uNewState) && !IsSelected(info->uOldState)) {
       // Set the stack trace for a single row selection only.
-      if (row != kNoItem) {
-        std::vector<void*> trace;
-        log_view_->GetStackTrace(row, &trace);
+      if (row != kNoItem && row >= first_row_) {
+        std::vector<sym_util::Address> buffer;
+        const sym_util::Address* trace = NULL;
+        size_t depth = log_view_->GetStackTracePiece(row, &trace, &buffer);
 
         DCHECK(stack_trace_view_ != NULL);
         stack_trace_view_->SetStackTrace(
             log_view_->GetProcessId(row),
             log_view_->GetTime(row),
-            trace.size(),
-            trace.size() ? &trace[0] : NULL);
+            log_view_->GetStackTraceId(row),
+            depth,
+            trace);
       }
     } else if (!IsSelected(info->uNewState) && IsSelected(info->uOldState)) {
       // Clear the trace.
       DCHECK(stack_trace_view_ != NULL);
-      stack_trace_view_->SetStackTrace(0, base::Time::Now(), 0, NULL);
+      stack_trace_view_->SetStackTrace(0, base::Time::Now(),
+                                       StackTracePool::kEmptyStack, 0, NULL);
     }
   }
 
@@ -309,18 +976,60 @@ LRESULT LogListView::OnItemChanged(NMHDR* pnmh) {
   return 0;
 }
 
+LRESULT LogListView::OnColumnClick(NMHDR* pnmh) {
+  NMLISTVIEW* info = reinterpret_cast<NMLISTVIEW*>(pnmh);
+  int col = info->iSubItem;
+  if (!ColumnSortedLogView::IsSortable(
+          static_cast<LogViewFormatter::Column>(col))) {
+    return 0;
+  }
+
+  if (col != sort_column_) {
+    sort_column_ = col;
+    sort_descending_ = false;
+  } else if (!sort_descending_) {
+    sort_descending_ = true;
+  } else {
+    sort_column_ = kNoSortColumn;
+    sort_descending_ = false;
+  }
+
+  UpdateSortIndicators();
+  SetLogView(unsorted_log_view_);
+
+  return 0;
+}
+
+void LogListView::UpdateSortIndicators() {
+  CHeaderCtrl header(GetHeader());
+  int columns = header.GetItemCount();
+  for (int col = 0; col < columns; ++col) {
+    HDITEM item = {};
+    item.mask = HDI_FORMAT;
+    if (!header.GetItem(col, &item))
+      continue;
+
+    item.fmt &= ~(HDF_SORTUP | HDF_SORTDOWN);
+    if (col == sort_column_)
+      item.fmt |= sort_descending_ ? HDF_SORTDOWN : HDF_SORTUP;
+    header.SetItem(col, &item);
+  }
+}
+
 LRESULT LogListView::OnGetInfoTip(NMHDR* pnmh) {
   NMLVGETINFOTIP* info_tip = reinterpret_cast<NMLVGETINFOTIP*>(pnmh);
+  if (info_tip->iItem < first_row_)
+    return 0;
+
   size_t row = info_tip->iItem;
+  base::Time time = log_view_->GetTime(row);
+  std::wstringstream text;
 
   if (process_info_service_ != NULL) {
     DWORD pid = log_view_->GetProcessId(row);
-    base::Time time = log_view_->GetTime(row);
 
     IProcessInfoService::ProcessInfo info = {};
     if (process_info_service_->GetProcessInfo(pid, time, &info)) {
-      std::wstringstream text;
-
       text << L"Process: " << info.command_line_ << std::endl;
       if (info.started_ != base::Time()) {
         text << L"Started: "
@@ -331,11 +1040,46 @@ LRESULT LogListView::OnGetInfoTip(NMHDR* pnmh) {
             << base::TimeFormatShortDateAndTime(info.ended_) << std::endl
             << L"Exit code: " << info.exit_code_ << std::endl;
       }
+    }
+  }
+
+  if (thread_info_service_ != NULL) {
+    DWORD tid = log_view_->GetThreadId(row);
+
+    // Thread ids are recycled, so this is the thread that had the id then.
+    IThreadInfoService::ThreadInfo info = {};
+    if (thread_info_service_->GetThreadInfo(tid, time, &info)) {
+      text << L"Thread: " << info.thread_id_ << L" of process "
+          << info.process_id_ << std::endl;
+      if (info.started_ != base::Time()) {
+        text << L"Thread started: "
+            << base::TimeFormatShortDateAndTime(info.started_) << std::endl;
+      }
+      if (info.ended_ != base::Time()) {
+        text << L"Thread ended: "
+            << base::TimeFormatShortDateAndTime(info.ended_) << std::endl;
+      }
+    }
+  }
 
-      wcscpy_s(info_tip->pszText, info_tip->cchTextMax, text.str().c_str());
+  if (cpu_timeline_service_ != NULL) {
+    DWORD tid = log_view_->GetThreadId(row);
+    base::TimeDelta window =
+        base::TimeDelta::FromMilliseconds(kCpuActivityWindowMs);
+
+    ICpuTimelineService::ThreadActivity activity = {};
+    if (cpu_timeline_service_->GetThreadActivity(tid, time - window,
+                                                 time + window, &activity)) {
+      text << L"Within " << kCpuActivityWindowMs << L" ms: running "
+          << activity.running_.InMillisecondsF() << L" ms, ready "
+          << activity.ready_.InMillisecondsF() << L" ms, waiting "
+          << activity.waiting_.InMillisecondsF() << L" ms" << std::endl;
     }
   }
 
+  if (!text.str().empty())
+    wcscpy_s(info_tip->pszText, info_tip->cchTextMax, text.str().c_str());
+
   return 0;
 }
 
@@ -346,59 +1090,143 @@ int LogListView::GetImageIndexForSeverity(int severity) {
 }
 
 void LogListView::OnCopyCommand(UINT code, int id, CWindow window) {
-  std::wstringstream selection;
+  std::vector<int> rows;
+  GetSelectedRows(&rows);
+  if (rows.empty())
+    return;
 
-  int item = GetNextItem(kNoItem, LVNI_SELECTED);
-  for (; item != kNoItem; item = GetNextItem(item, LVNI_SELECTED)) {
-    NMLVDISPINFO info = {};
+  if (!::OpenClipboard(m_hWnd)) {
+    LOG(ERROR) << "Unable to open clipboard, error " << ::GetLastError();
+    return;
+  }
 
-    info.hdr.hwndFrom = m_hWnd;
-    info.item.iItem = item;
-    info.item.mask = LVIF_TEXT;
+  // This drops any copy of ours the clipboard had.
+  ::EmptyClipboard();
+  copy_rows_.swap(rows);
+  copy_base_time_ = formatter_.base_time();
 
-    for (int col = COL_SEVERITY; col < COL_MAX; ++col) {
-      info.item.iSubItem = col;
+  // Promise the text, we render it when it's asked for.
+  ::SetClipboardData(CF_UNICODETEXT, NULL);
+  ::CloseClipboard();
+}
 
-      OnGetDispInfo(&info.hdr);
+void LogListView::OnCopyToFile(UINT code, int id, CWindow window) {
+  std::vector<int> rows;
+  GetSelectedRows(&rows);
+  if (rows.empty())
+    return;
 
-      // Tab separate the columns.
-      if (col != COL_SEVERITY)
-        selection << L'\t';
-      selection << info.item.pszText;
-    }
+  CShellFileSaveDialog dialog(L"log",
+                              FOS_FORCEFILESYSTEM | FOS_PATHMUSTEXIST |
+                                  FOS_OVERWRITEPROMPT | FOS_DONTADDTORECENT,
+                              L"txt",
+                              &kTextFileSpec[0],
+                              1);
+  if (dialog.DoModal() != IDOK)
+    return;
 
-    // Clipboard has CRLF separated lines.
-    selection << L"\r\n";
+  std::wstring file_path;
+  file_path.resize(MAX_PATH);
+  if (FAILED(dialog.GetFilePath(&file_path[0], MAX_PATH - 1)))
+    return;
+  file_path.resize(wcslen(file_path.c_str()));
+
+  // Stream the rows to the file, rather than holding all their text.
+  base::File file(base::FilePath(file_path),
+                  base::File::FLAG_CREATE_ALWAYS | base::File::FLAG_WRITE);
+  LogTextWriter writer(log_view_, formatter_.base_time());
+  FileTextSink sink(&file);
+  if (!file.IsValid() || !writer.WriteRows(rows, &sink)) {
+    LOG(ERROR) << "Failed to copy to file: " << file_path;
+    MessageBox(L"Failed to write the file.", L"File save error.",
+               MB_OK | MB_ICONWARNING);
   }
+}
+
+void LogListView::OnRenderFormat(UINT format) {
+  if (format != CF_UNICODETEXT || copy_rows_.empty())
+    return;
+
+  // The clipboard is open for us.
+  HGLOBAL data = RenderCopy();
+  if (data != NULL && ::SetClipboardData(CF_UNICODETEXT, data) == NULL) {
+    LOG(ERROR) << "Unable to set clipboard data, error  "
+        << ::GetLastError();
+    ::GlobalFree(data);
+  }
+}
+
+void LogListView::OnRenderAllFormats() {
+  RenderPendingCopy();
+}
 
-  // Copy the sstring to a global pointer for the clipboard.
-  CHeapPtr<wchar_t, CGlobalAllocator> data;
+void LogListView::OnDestroyClipboard() {
+  std::vector<int>().swap(copy_rows_);
+}
 
-  if (!data.Allocate(selection.str().length() + 1)) {
-    LOG(ERROR) << "Unable to allocate clipboard data";
+void LogListView::GetSelectedRows(std::vector<int>* rows) {
+  DCHECK(rows != NULL);
+  rows->clear();
+
+  // Walking the selection of a large list is slow, and selecting it all
+  // is common.
+  int num_selected = GetSelectedCount();
+  int num_items = GetItemCount();
+  if (num_selected == num_items) {
+    rows->reserve(std::max(0, num_items - first_row_));
+    for (int row = first_row_; row < num_items; ++row)
+      rows->push_back(row);
     return;
   }
 
-  // Copy the string and the terminating zero.
-  memcpy(data.m_pData,
-         &selection.str()[0],
-         (selection.str().length() + 1) * sizeof(wchar_t));
+  // The selection may take in the items of evicted rows, which are left out.
+  rows->reserve(num_selected);
+  int item = GetNextItem(first_row_ - 1, LVNI_SELECTED);
+  for (; item != kNoItem; item = GetNextItem(item, LVNI_SELECTED))
+    rows->push_back(item);
+}
 
-  if (::OpenClipboard(m_hWnd)) {
-    ::EmptyClipboard();
+HGLOBAL LogListView::RenderCopy() {
+  DCHECK(log_view_ != NULL);
 
-    if (::SetClipboardData(CF_UNICODETEXT, data.m_pData)) {
-      // The clipboard has taken ownership now.
-      data.Detach();
-    } else {
-      LOG(ERROR) << "Unable to set clipboard data, error  "
-          << ::GetLastError();
-    }
+  LogTextWriter writer(log_view_, copy_base_time_);
+  ClipboardTextSink sink;
+  if (!writer.WriteRows(copy_rows_, &sink))
+    return NULL;
+
+  return sink.Release();
+}
 
+void LogListView::RenderPendingCopy() {
+  if (copy_rows_.empty())
+    return;
+
+  if (::OpenClipboard(m_hWnd)) {
+    // Someone may have taken the clipboard since.
+    if (::GetClipboardOwner() == m_hWnd) {
+      HGLOBAL data = RenderCopy();
+      if (data != NULL && ::SetClipboardData(CF_UNICODETEXT, data) == NULL)
+        ::GlobalFree(data);
+    }
     ::CloseClipboard();
-  } else  {
+  } else {
     LOG(ERROR) << "Unable to open clipboard, error " << ::GetLastError();
   }
+
+  std::vector<int>().swap(copy_rows_);
+}
+
+void LogListView::DropPendingCopy() {
+  if (copy_rows_.empty())
+    return;
+
+  if (::OpenClipboard(m_hWnd)) {
+    if (::GetClipboardOwner() == m_hWnd)
+      ::EmptyClipboard();
+    ::CloseClipboard();
+  }
+
+  std::vector<int>().swap(copy_rows_);
 }
 
 void LogListView::OnSelectAll(UINT code, int id, CWindow window) {
@@ -408,10 +1236,12 @@ void LogListView::OnSelectAll(UINT code, int id, CWindow window) {
 
 void LogListView::OnClearAll(UINT code, int id, CWindow window) {
   // Clear all items from the log view and then wait for change notifications.
+  RenderPendingCopy();
   log_view_->ClearAll();
   // And clear the stack trace as well.
   if (stack_trace_view_)
-    stack_trace_view_->SetStackTrace(0, base::Time::Now(), 0, NULL);
+    stack_trace_view_->SetStackTrace(0, base::Time::Now(),
+                                     StackTracePool::kEmptyStack, 0, NULL);
 }
 
 void LogListView::OnSetFocus(CWindow window) {
@@ -468,6 +1298,31 @@ void LogListView::OnContextMenu(CWindow wnd, CPoint point) {
                   ID_RESET_BASE_TIME,
                   L"&Reset Base Time");
 
+  menu.AppendMenu(row == -1 || disk_io_latency_service_ == NULL ?
+                      MF_GRAYED : MF_ENABLED,
+                  ID_DISK_IO_REPORT,
+                  L"Slowest &Disk Reads...");
+
+  UINT registry_flags = row == -1 || registry_access_service_ == NULL ?
+      MF_GRAYED : MF_ENABLED;
+  menu.AppendMenu(registry_flags,
+                  ID_REGISTRY_COUNT_REPORT,
+                  L"Registry Access by &Count...");
+  menu.AppendMenu(registry_flags,
+                  ID_REGISTRY_LATENCY_REPORT,
+                  L"Registry Access by &Latency...");
+
+  menu.AppendMenu(row == -1 || cpu_profile_service_ == NULL ||
+                      symbol_lookup_service_ == NULL ?
+                      MF_GRAYED : MF_ENABLED,
+                  ID_HOT_FUNCTIONS_REPORT,
+                  L"Hot &Functions...");
+
+  menu.AppendMenu(row == -1 || thread_context_service_ == NULL ?
+                      MF_GRAYED : MF_ENABLED,
+                  ID_KERNEL_CONTEXT_REPORT,
+                  L"&Kernel Context...");
+
   // TODO(siggi): Implement popup menu items to include/exclude
   //      the clicked column by its value.
 #if 0
@@ -499,7 +1354,11 @@ void LogListView::OnFind(UINT code, int id, CWindow window) {
   FindDialog find(find_params_);
   if (find.DoModal(m_hWnd) == IDOK) {
     find_params_ = find.find_params();
-    FindNext();
+    ClearHits();
+    if (find_params_.find_all_)
+      FindAll();
+    else
+      FindNext();
   }
 }
 
@@ -508,45 +1367,376 @@ void LogListView::OnFindNext(UINT code, int id, CWindow window) {
     FindNext();
 }
 
+void LogListView::OnGoToTime(UINT code, int id, CWindow window) {
+  int num_rows = log_view_->GetNumRows();
+  if (num_rows == first_row_)
+    return;
+
+  // Start from the time of the focused row, else the first.
+  int row = GetNextItem(-1, LVIS_FOCUSED);
+  if (row < first_row_)
+    row = first_row_;
+  std::string time_text;
+  formatter_.FormatColumn(log_view_, row, LogViewFormatter::TIME, &time_text);
+
+  GoToTimeDialog dialog(time_text);
+  if (dialog.DoModal(m_hWnd) != IDOK)
+    return;
+
+  base::Time time;
+  if (!formatter_.ParseTime(dialog.time(), log_view_->GetTime(row), &time)) {
+    MessageBox(L"The time should read as HH:MM:SS-mmm.", L"Go To Time");
+    return;
+  }
+
+  // Past the last row goes to the last row.
+  int found = std::min(log_view_->FindRowForTime(time), num_rows - 1);
+  OnFindDone(found);
+}
+
+void LogListView::GoToTime(const base::Time& time) {
+  pending_go_to_time_ = base::Time();
+  int num_rows = log_view_->GetNumRows();
+  if (!IsWindow() || num_rows == first_row_ ||
+      log_view_->GetTime(num_rows - 1) < time) {
+    pending_go_to_time_ = time;
+    return;
+  }
+
+  // The item count may be held back while we're scrolled away.
+  UpdateItemCount();
+  OnFindDone(log_view_->FindRowForTime(time));
+}
+
 void LogListView::OnAutoSizeColumns(UINT code, int id, CWindow window) {
+  // Measure the visible rows and a sample of the rest, rather than every
+  // row as LVSCW_AUTOSIZE does, which takes forever on a large log.
+  std::vector<int> rows;
+  ColumnSizer::GetSampleRows(GetItemCount(), GetTopIndex(), GetCountPerPage(),
+                             kAutoSizeSampleRows, &rows);
+
+  GlyphWidthTable* glyph_widths = GetGlyphWidths();
+  ColumnSizer sizer(this, glyph_widths);
   int columns = GetHeader().GetItemCount();
   // Skip resizing the severity column.
-  for (int i = 1; i < columns; ++i)
-    SetColumnWidth(i, LVSCW_AUTOSIZE);
+  for (int i = 1; i < columns && i < COL_MAX; ++i) {
+    int width = std::max(sizer.GetColumnWidth(i, rows),
+                         glyph_widths->GetTextWidth(kColumns[i].title));
+    SetColumnWidth(i, width + kCellMargin);
+  }
 }
 
-void LogListView::FindNext() {
-  pcrecpp::RE_Options options = PCRE_UTF8;
-  options.set_caseless(!find_params_.match_case_);
-  pcrecpp::RE expression(find_params_.expression_, options);
+GlyphWidthTable* LogListView::GetGlyphWidths() {
+  HFONT font = GetFont();
+  if (glyph_widths_.get() == NULL || font != glyph_widths_font_) {
+    glyph_widths_.reset();
+    glyph_measurer_.reset(new WindowGlyphMeasurer(m_hWnd, font));
+    glyph_widths_.reset(new GlyphWidthTable(glyph_measurer_.get()));
+    glyph_widths_font_ = font;
+  }
+
+  return glyph_widths_.get();
+}
+
+GlyphRunCache* LogListView::GetGlyphRuns() {
+  HFONT font = GetFont();
+  if (glyph_runs_.get() == NULL || font != glyph_runs_font_) {
+    glyph_runs_.reset();
+    glyph_run_measurer_.reset(new WindowGlyphRunMeasurer(m_hWnd, font));
+    glyph_runs_.reset(new GlyphRunCache(glyph_run_measurer_.get()));
+    glyph_runs_font_ = font;
+
+    CClientDC dc(m_hWnd);
+    HFONT old_font = dc.SelectFont(font);
+    TEXTMETRIC metrics = {};
+    dc.GetTextMetrics(&metrics);
+    dc.SelectFont(old_font);
+    glyph_runs_text_height_ = metrics.tmHeight;
+  }
+
+  return glyph_runs_.get();
+}
 
+HFONT LogListView::GetBoldFont() {
+  HFONT font = GetFont();
+  if (bold_font_.IsNull() || font != bold_font_base_) {
+    LOGFONT log_font = {};
+    CFontHandle(font).GetLogFont(&log_font);
+    log_font.lfWeight = FW_BOLD;
+    if (!bold_font_.IsNull())
+      bold_font_.DeleteObject();
+    bold_font_.CreateFontIndirect(&log_font);
+    bold_font_base_ = font;
+  }
+
+  return bold_font_;
+}
+
+void LogListView::OnRowsRestyled(int begin, int end) {
+  DCHECK_EQ(ui_loop_, base::MessageLoop::current());
+  if (!IsWindow() || begin >= end)
+    return;
+
+  int top = GetTopIndex();
+  int bottom = top + GetCountPerPage();
+  begin = std::max(begin, top);
+  end = std::min(end - 1, bottom);
+  if (begin <= end)
+    RedrawItems(begin, end);
+}
+
+void LogListView::FindNext() {
   int start = GetNextItem(-1, LVIS_FOCUSED);
-  int num_rows = log_view_->GetNumRows();
   bool down = find_params_.direction_down_;
   int i = down ? start + 1 : start - 1;
-  if (i < 0)
-    i = 0;  // in case start == -1.
+  if (i < first_row_)
+    i = first_row_;  // in case start == -1, or an evicted row.
+
+  // Step through the hits of a find-all, as far as they go.
+  const RowBitmap& hits = finder_->hits();
+  int covered_rows = finder_->hits_num_rows();
+  if (show_hits_ && i < covered_rows) {
+    int row = down ? hits.FindNext(i) : hits.FindPrevious(i);
+    if (row < first_row_)
+      row = -1;  // The hit's been evicted.
+    if (row != -1 || !down || covered_rows >= log_view_->GetNumRows()) {
+      OnFindDone(row);
+      return;
+    }
 
-  for (; down ? i < num_rows : i >= 0; down ? ++i : --i) {
-    std::string message(log_view_->GetMessage(i));
-    if (expression.PartialMatch(message))
-      break;
+    // Search the rows that came in since.
+    i = covered_rows;
+  }
+
+  finder_->Find(find_params_.expression_, find_params_.match_case_, down, i);
+}
+
+void LogListView::FindAll() {
+  finder_->FindAll(find_params_.expression_, find_params_.match_case_);
+}
+
+void LogListView::ClearHits() {
+  if (!show_hits_)
+    return;
+
+  show_hits_ = false;
+  if (IsWindow()) {
+    // Recalculate our frame, to drop the hit strip.
+    SetWindowPos(NULL, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER |
+                 SWP_NOACTIVATE | SWP_FRAMECHANGED);
   }
+}
+
+void LogListView::PaintHitStrip() {
+  DCHECK(show_hits_);
+
+  // Our client area ends where the strip starts.
+  CRect window_rect;
+  GetWindowRect(&window_rect);
+  CRect strip;
+  GetClientRect(&strip);
+  ClientToScreen(&strip);
+  strip.left = strip.right;
+  strip.right += kHitStripWidth;
+  strip.OffsetRect(-window_rect.left, -window_rect.top);
+
+  CWindowDC dc(m_hWnd);
+  COLORREF background = ::GetSysColor(COLOR_BTNFACE);
+  dc.FillSolidRect(&strip, background);
+
+  int num_rows = log_view_ != NULL ? log_view_->GetNumRows() : 0;
+  int height = strip.Height();
+  if (num_rows == 0 || height <= 0)
+    return;
+
+  // Each line of the strip covers a slice of the rows, shaded by the
+  // fraction of them that are hits.
+  const RowBitmap& hits = finder_->hits();
+  for (int y = 0; y < height; ++y) {
+    int begin = static_cast<int>(static_cast<int64>(y) * num_rows / height);
+    int end = static_cast<int>(
+        static_cast<int64>(y + 1) * num_rows / height);
+    end = std::max(end, begin + 1);
+
+    int count = hits.CountRange(begin, end);
+    if (count == 0)
+      continue;
+
+    int weight = 96 + 160 * count / (end - begin);
+    dc.FillSolidRect(strip.left, strip.top + y, kHitStripWidth, 1,
+                     BlendColors(background, kHitColor, weight));
+  }
+}
+
+CRect LogListView::GetVolumeStripRect() {
+  // Our client area starts where the strip ends.
+  CRect window_rect;
+  GetWindowRect(&window_rect);
+  CRect strip;
+  GetClientRect(&strip);
+  ClientToScreen(&strip);
+  strip.bottom = strip.top;
+  strip.top -= kVolumeStripHeight;
+  strip.OffsetRect(-window_rect.left, -window_rect.top);
+  return strip;
+}
 
-  if (i >= 0 && i < num_rows) {
+void LogListView::PaintVolumeStrip() {
+  CRect strip = GetVolumeStripRect();
+  CWindowDC dc(m_hWnd);
+  COLORREF background = ::GetSysColor(COLOR_BTNFACE);
+  dc.FillSolidRect(&strip, background);
+
+  volume_start_ = 0;
+  volume_end_ = 0;
+  const LogStore* store = log_view_ != NULL ? log_view_->GetLogStore() : NULL;
+  if (store == NULL || store->volume_histogram().empty() || strip.Width() <= 0)
+    return;
+
+  // Each column of the strip covers a slice of the store's time range,
+  // shaded by its share of the busiest slice's rows.
+  const VolumeHistogram& histogram = store->volume_histogram();
+  volume_start_ = histogram.start_time();
+  volume_end_ = histogram.end_time();
+  histogram.GetBuckets(volume_start_, volume_end_, strip.Width(),
+                       &volume_buckets_);
+  uint32 most = 0;
+  for (size_t i = 0; i < volume_buckets_.size(); ++i)
+    most = std::max(most, volume_buckets_[i].total());
+
+  for (size_t i = 0; i < volume_buckets_.size(); ++i) {
+    const VolumeHistogram::Bucket& bucket = volume_buckets_[i];
+    uint32 total = bucket.total();
+    if (total == 0)
+      continue;
+
+    COLORREF color = kVolumeColor;
+    if (bucket.counts[VolumeHistogram::SEVERITY_ERROR] != 0)
+      color = kErrorVolumeColor;
+    else if (bucket.counts[VolumeHistogram::SEVERITY_WARNING] != 0)
+      color = kWarningVolumeColor;
+    int weight = 64 + static_cast<int>(192 * static_cast<uint64>(total) / most);
+    dc.FillSolidRect(strip.left + static_cast<int>(i), strip.top, 1,
+                     strip.Height(), BlendColors(background, color, weight));
+  }
+}
+
+void LogListView::OnFindAllDone(int num_hits) {
+  if (num_hits == 0) {
+    MessageBox(L"The specified text was not found.");
+    return;
+  }
+
+  // Make room for the hit strip, then go to the nearest hit.
+  show_hits_ = true;
+  SetWindowPos(NULL, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER |
+               SWP_NOACTIVATE | SWP_FRAMECHANGED);
+  FindNext();
+}
+
+void LogListView::OnFindDone(int row) {
+  if (row >= 0 && row < log_view_->GetNumRows()) {
     // Clear the existing selection.
+    int start = GetNextItem(-1, LVIS_FOCUSED);
     if (start >= 0)
       SetItemState(start, 0, LVIS_SELECTED | LVIS_FOCUSED);
 
     // Select and focus the new item.
-    SetItemState(i, LVIS_SELECTED | LVIS_FOCUSED,
+    SetItemState(row, LVIS_SELECTED | LVIS_FOCUSED,
                  LVIS_SELECTED | LVIS_FOCUSED);
-    EnsureVisible(i, false);
+    EnsureVisible(row, false);
+    SetFollowing(IsLastItemVisible());
   } else {
     MessageBox(L"The specified text was not found.");
   }
 }
 
+void LogListView::OnKeyDown(TCHAR key, UINT repeat_count, UINT flags) {
+  // Escape cancels a find in progress.
+  if (key == VK_ESCAPE && finder_.get() != NULL && finder_->is_finding()) {
+    finder_->Cancel();
+    return;
+  }
+
+  // Let the list view move the focus first, then follow the tail iff it
+  // ended up in view. End always goes to the last row.
+  DefWindowProc();
+  SetFollowing(key == VK_END || IsLastItemVisible());
+}
+
+void LogListView::OnVScroll(int code, short pos, CScrollBar scroll_bar) {
+  DefWindowProc();
+  SetFollowing(IsLastItemVisible());
+}
+
+BOOL LogListView::OnMouseWheel(UINT flags, short delta, CPoint point) {
+  BOOL ret = static_cast<BOOL>(DefWindowProc());
+  SetFollowing(IsLastItemVisible());
+  return ret;
+}
+
+LRESULT LogListView::OnNcCalcSize(BOOL calc_valid_rects, LPARAM lparam) {
+  LRESULT ret = DefWindowProc();
+
+  // Carve the volume strip off the top of the client area, which puts it
+  // above the column headers, and the hit strip off the right, which puts
+  // it beside the vertical scroll bar.
+  RECT* client_rect = calc_valid_rects ?
+      &reinterpret_cast<NCCALCSIZE_PARAMS*>(lparam)->rgrc[0] :
+      reinterpret_cast<RECT*>(lparam);
+  client_rect->top = std::min(client_rect->bottom,
+                              client_rect->top + kVolumeStripHeight);
+  if (show_hits_) {
+    client_rect->right = std::max(client_rect->left,
+                                  client_rect->right - kHitStripWidth);
+  }
+
+  return ret;
+}
+
+void LogListView::OnNcPaint(CRgnHandle region) {
+  DefWindowProc();
+  PaintVolumeStrip();
+  if (show_hits_)
+    PaintHitStrip();
+}
+
+LRESULT LogListView::OnNcHitTest(CPoint point) {
+  // Claim the volume strip, which the frame would otherwise pass through.
+  CRect window_rect;
+  GetWindowRect(&window_rect);
+  if (GetVolumeStripRect().PtInRect(point - window_rect.TopLeft()))
+    return HTBORDER;
+
+  SetMsgHandled(FALSE);
+  return 0;
+}
+
+void LogListView::OnNcLButtonDown(UINT hit_test, CPoint point) {
+  CRect window_rect;
+  GetWindowRect(&window_rect);
+  CRect strip = GetVolumeStripRect();
+  point -= window_rect.TopLeft();
+  if (!strip.PtInRect(point) || volume_end_ <= volume_start_) {
+    SetMsgHandled(FALSE);
+    return;
+  }
+
+  int num_rows = log_view_->GetNumRows();
+  if (num_rows == first_row_)
+    return;
+
+  // Go to the first row at the time clicked, where past the last row goes
+  // to the last row.
+  double fraction = static_cast<double>(point.x - strip.left) / strip.Width();
+  int64 time = volume_start_ +
+      static_cast<int64>(fraction * (volume_end_ - volume_start_));
+  int found = log_view_->FindRowForTime(base::Time::FromInternalValue(time));
+  found = std::max(first_row_, std::min(found, num_rows - 1));
+  SetFocus();
+  OnFindDone(found);
+}
+
 void LogListView::OnSetBaseTime(UINT code, int id, CWindow window) {
   // Get the focused item.
   int row = GetNextItem(-1, LVIS_FOCUSED);
@@ -555,8 +1745,13 @@ void LogListView::OnSetBaseTime(UINT code, int id, CWindow window) {
     return;
   }
 
+  // An evicted row has no time to go by.
+  if (row < first_row_)
+    return;
+
   // Get the corresponding time.
   formatter_.set_base_time(log_view_->GetTime(row));
+  display_cache_.Invalidate();
 
   // Refresh the list.
   RedrawItems(0, GetItemCount());
@@ -564,42 +1759,426 @@ void LogListView::OnSetBaseTime(UINT code, int id, CWindow window) {
 
 void LogListView::OnResetBaseTime(UINT code, int id, CWindow window) {
   formatter_.set_base_time(base::Time());
+  display_cache_.Invalidate();
 
   // Refresh the list.
   RedrawItems(0, GetItemCount());
 }
 
+bool LogListView::GetSelectedTimeRange(int min_window_ms,
+                                       base::Time* from,
+                                       base::Time* to) {
+  DCHECK(from != NULL && to != NULL);
+  std::vector<int> rows;
+  GetSelectedRows(&rows);
+  if (rows.empty())
+    return false;
+
+  // The rows are in order, though their times needn't be.
+  *from = log_view_->GetTime(rows[0]);
+  *to = *from;
+  for (size_t i = 1; i < rows.size(); ++i) {
+    base::Time time = log_view_->GetTime(rows[i]);
+    *from = std::min(*from, time);
+    *to = std::max(*to, time);
+  }
+  base::TimeDelta min_window =
+      base::TimeDelta::FromMilliseconds(min_window_ms);
+  if (*to - *from < min_window) {
+    *from = *from - min_window;
+    *to = *to + min_window;
+  }
+
+  return true;
+}
+
+void LogListView::OnDiskIoReport(UINT code, int id, CWindow window) {
+  base::Time from;
+  base::Time to;
+  if (disk_io_latency_service_ == NULL ||
+      !GetSelectedTimeRange(kMinDiskIoReportWindowMs, &from, &to)) {
+    return;
+  }
+
+  std::vector<IDiskIoLatencyService::FileReads> files;
+  disk_io_latency_service_->GetSlowestFileReads(from, to,
+                                                kMaxDiskIoReportFiles,
+                                                &files);
+
+  std::wstringstream text;
+  if (files.empty())
+    text << L"No disk reads completed around the selected rows.";
+  for (size_t i = 0; i < files.size(); ++i) {
+    const IDiskIoLatencyService::FileReads& file = files[i];
+    text << (file.file_name_.empty() ? L"(unknown)" : file.file_name_)
+        << L": " << file.total_latency_.InMillisecondsF() << L" ms in "
+        << file.read_count_ << L" reads of " << file.bytes_read_ / 1024
+        << L" KB, 95th " << file.p95_latency_.InMillisecondsF()
+        << L" ms, max " << file.max_latency_.InMillisecondsF() << L" ms"
+        << std::endl;
+  }
+
+  ::MessageBox(m_hWnd, text.str().c_str(), L"Slowest Disk Reads", MB_OK);
+}
+
+void LogListView::OnRegistryReport(UINT code, int id, CWindow window) {
+  base::Time from;
+  base::Time to;
+  if (registry_access_service_ == NULL ||
+      !GetSelectedTimeRange(kMinRegistryReportWindowMs, &from, &to)) {
+    return;
+  }
+
+  bool by_count = id == ID_REGISTRY_COUNT_REPORT;
+  std::vector<IRegistryAccessService::KeyAccesses> accesses;
+  registry_access_service_->GetHotKeys(
+      from, to,
+      by_count ? IRegistryAccessService::BY_COUNT :
+                 IRegistryAccessService::BY_TOTAL_LATENCY,
+      kMaxRegistryReportKeys, &accesses);
+
+  std::wstringstream text;
+  if (accesses.empty()) {
+    text << L"No registry accesses completed around the selected rows.";
+  } else {
+    text << L"PID\tOperation\tCount\tTotal ms\tMax ms\tKey" << std::endl;
+  }
+  for (size_t i = 0; i < accesses.size(); ++i) {
+    const IRegistryAccessService::KeyAccesses& access = accesses[i];
+    text << access.process_id_ << L"\t"
+        << RegistryAccessService::GetOperationName(access.operation_)
+        << L"\t" << access.count_ << L"\t"
+        << base::StringPrintf(L"%.3f\t%.3f\t",
+                              access.total_latency_.InMillisecondsF(),
+                              access.max_latency_.InMillisecondsF())
+        << (access.key_path_.empty() ? L"(unknown)" : access.key_path_)
+        << std::endl;
+  }
+
+  ::MessageBox(m_hWnd, text.str().c_str(),
+               by_count ? L"Registry Access by Count" :
+                          L"Registry Access by Latency",
+               MB_OK);
+}
+
+void LogListView::OnKernelContextReport(UINT code, int id, CWindow window) {
+  std::vector<int> rows;
+  GetSelectedRows(&rows);
+  if (thread_context_service_ == NULL || rows.empty())
+    return;
+
+  // The report is of the thread of the first selected row, around it.
+  int row = rows[0];
+  DWORD tid = log_view_->GetThreadId(row);
+  base::Time time = log_view_->GetTime(row);
+  base::TimeDelta window =
+      base::TimeDelta::FromMilliseconds(kKernelContextWindowMs);
+  std::vector<IThreadContextService::Record> records;
+  bool whole = thread_context_service_->GetThreadContext(
+      tid, time - window, time + window, kMaxKernelContextRecords, &records);
+
+  std::wstringstream text;
+  text << L"Thread " << tid << L" within " << kKernelContextWindowMs
+      << L" ms:" << std::endl;
+  if (!whole)
+    text << L"(older events were dropped)" << std::endl;
+  if (records.empty())
+    text << L"No kernel events." << std::endl;
+  for (size_t i = 0; i < records.size(); ++i) {
+    const IThreadContextService::Record& record = records[i];
+    text << base::StringPrintf(L"%+.3f ms: ",
+                               (record.time_ - time).InMillisecondsF())
+        << GetRecordKindText(record.kind_);
+    switch (record.kind_) {
+      case IThreadContextService::Record::SOFT_FAULT:
+      case IThreadContextService::Record::HARD_FAULT:
+      case IThreadContextService::Record::FAULT_VIOLATION:
+        text << base::StringPrintf(L" at 0x%08llX", record.address_);
+        break;
+
+      case IThreadContextService::Record::HARD_FAULT_READ:
+      case IThreadContextService::Record::DISK_READ:
+      case IThreadContextService::Record::DISK_WRITE:
+        text << L" of " << record.byte_count_ << L" bytes in "
+            << record.latency_.InMillisecondsF() << L" ms";
+        break;
+
+      case IThreadContextService::Record::SWITCHED_IN:
+        text << L" on CPU " << record.processor_;
+        break;
+
+      case IThreadContextService::Record::SWITCHED_OUT:
+        text << L" from CPU " << record.processor_ << L", state "
+            << record.thread_state_;
+        break;
+
+      default:
+        break;
+    }
+    text << std::endl;
+  }
+
+  ::MessageBox(m_hWnd, text.str().c_str(), L"Kernel Context", MB_OK);
+}
+
+void LogListView::OnHotFunctionsReport(UINT code, int id, CWindow window) {
+  base::Time from;
+  base::Time to;
+  if (cpu_profile_service_ == NULL || symbol_lookup_service_ == NULL ||
+      !GetSelectedTimeRange(kMinHotFunctionsWindowMs, &from, &to)) {
+    return;
+  }
+
+  // The report is of the process of the first selected row.
+  std::vector<int> rows;
+  GetSelectedRows(&rows);
+  DWORD pid = log_view_->GetProcessId(rows[0]);
+
+  if (hot_frames_handle_ != ISymbolLookupService::kInvalidHandle) {
+    symbol_lookup_service_->CancelRequest(hot_frames_handle_);
+    hot_frames_handle_ = ISymbolLookupService::kInvalidHandle;
+  }
+
+  hot_samples_ = cpu_profile_service_->GetHotFrames(pid, from, to,
+                                                    kMaxHotFrames,
+                                                    &hot_frames_);
+  if (hot_frames_.empty()) {
+    ::MessageBox(m_hWnd, L"No CPU samples around the selected rows.",
+                 L"Hot Functions", MB_OK);
+    return;
+  }
+
+  // Only the unique frames are resolved, in a single batch, and only to
+  // their functions, which is all the report shows.
+  std::vector<sym_util::Address> addresses;
+  addresses.reserve(hot_frames_.size());
+  for (size_t i = 0; i < hot_frames_.size(); ++i)
+    addresses.push_back(hot_frames_[i].address_);
+
+  hot_frames_handle_ = symbol_lookup_service_->ResolveAddresses(
+      pid, to, &addresses[0], addresses.size(), sym_util::SYMBOL_FUNCTION,
+      base::Bind(&LogListView::HotFramesResolved, base::Unretained(this)));
+}
+
+void LogListView::HotFramesResolved(
+    sym_util::ProcessId pid,
+    base::Time time,
+    ISymbolLookupService::Handle handle,
+    const std::vector<sym_util::Address>& addresses,
+    const std::vector<sym_util::SymbolRecord>& symbols) {
+  // We should only hear of our current request.
+  DCHECK_EQ(hot_frames_handle_, handle);
+  DCHECK_EQ(hot_frames_.size(), symbols.size());
+  hot_frames_handle_ = ISymbolLookupService::kInvalidHandle;
+
+  // Sum the frames by function. The symbol strings are interned, so they
+  // key by pointer. Frames without a symbol stand for themselves.
+  typedef std::pair<const std::wstring*, const std::wstring*> FunctionKey;
+  typedef std::map<FunctionKey, FunctionSamples> FunctionMap;
+  FunctionMap functions;
+  std::vector<FunctionSamples> unresolved;
+  for (size_t i = 0; i < hot_frames_.size(); ++i) {
+    const ICpuProfileService::HotFrame& frame = hot_frames_[i];
+    const sym_util::SymbolRecord& symbol = symbols[i];
+
+    FunctionSamples* samples = NULL;
+    if (symbol.name->empty()) {
+      unresolved.push_back(FunctionSamples());
+      samples = &unresolved.back();
+      samples->name = base::StringPrintf(L"%ls!0x%llX",
+          symbol.module->empty() ? L"(unknown)" : symbol.module->c_str(),
+          static_cast<uint64>(frame.address_));
+    } else {
+      samples = &functions[FunctionKey(symbol.module, symbol.name)];
+      if (samples->name.empty())
+        samples->name = *symbol.module + L"!" + *symbol.name;
+    }
+    // A function's frames may share samples, so its inclusive samples are
+    // those of its hottest frame, which undercounts rather than overcounts.
+    samples->inclusive = std::max(samples->inclusive,
+                                  frame.inclusive_samples_);
+    samples->exclusive += frame.exclusive_samples_;
+  }
+
+  std::vector<FunctionSamples> hottest(unresolved);
+  FunctionMap::const_iterator it(functions.begin());
+  for (; it != functions.end(); ++it)
+    hottest.push_back(it->second);
+  std::sort(hottest.begin(), hottest.end(), IsHotterFunction);
+  if (hottest.size() > kMaxHotFunctions)
+    hottest.resize(kMaxHotFunctions);
+
+  std::wstringstream text;
+  text << hot_samples_ << L" samples of process " << pid
+      << L" around the selected rows." << std::endl;
+  for (size_t i = 0; i < hottest.size(); ++i) {
+    const FunctionSamples& function = hottest[i];
+    text << function.name << L": " << function.exclusive << L" self, "
+        << function.inclusive << L" total" << std::endl;
+  }
+  hot_frames_.clear();
+
+  ::MessageBox(m_hWnd, text.str().c_str(), L"Hot Functions", MB_OK);
+}
+
 void LogListView::LogViewNewItems() {
   DCHECK_EQ(ui_loop_, base::MessageLoop::current());
+  highlighter_->OnRowsAdded();
 
-  if (IsWindow()) {
-    // Check if last item was previously visible...
-    BOOL is_last_item_visible = ListView_IsItemVisible(m_hWnd,
-                                                       GetItemCount() - 1);
-    int num_rows = log_view_->GetNumRows();
-    SetItemCountEx(num_rows, LVSICF_NOINVALIDATEALL | LVSICF_NOSCROLL);
+  if (!IsWindow())
+    return;
+
+  if (!pending_go_to_time_.is_null()) {
+    GoToTime(pending_go_to_time_);
+    if (pending_go_to_time_.is_null())
+      return;
+  }
+
+  // Hold the count back while we're not following the tail, as updating
+  // it costs a repaint of the scroll bar and the hit strip.
+  if (!following_) {
+    if (!item_count_timer_set_) {
+      SetTimer(kItemCountTimerId, kScrolledAwayUpdateMs);
+      item_count_timer_set_ = true;
+    }
+    return;
+  }
+
+  UpdateItemCount();
+}
+
+void LogListView::OnTimer(UINT_PTR timer_id) {
+  if (timer_id != kItemCountTimerId) {
+    SetMsgHandled(FALSE);
+    return;
+  }
+
+  KillTimer(kItemCountTimerId);
+  item_count_timer_set_ = false;
+  UpdateItemCount();
+}
+
+void LogListView::UpdateItemCount() {
+  DCHECK(log_view_ != NULL);
+
+  int num_rows = log_view_->GetNumRows();
+  SetItemCountEx(num_rows, LVSICF_NOINVALIDATEALL | LVSICF_NOSCROLL);
 
-    // We want to show the latest items if the
-    // previously latest one was visible.
-    if (is_last_item_visible)
-      EnsureVisible(num_rows - 1, TRUE /* PartialOK */);
+  // We show the latest items while following the tail.
+  if (following_)
+    ScrollToTail(num_rows);
+
+  // The rows in view may have collapsed new repeats.
+  if (log_view_->CollapsesRepeats()) {
+    int top = GetTopIndex();
+    RedrawItems(top, std::min(top + GetCountPerPage(), num_rows - 1));
   }
+
+  // The hits now cover less of the log.
+  if (show_hits_)
+    RedrawWindow(NULL, NULL, RDW_FRAME | RDW_INVALIDATE);
+  else
+    PaintVolumeStrip();
+}
+
+bool LogListView::IsLastItemVisible() {
+  int last_item = GetItemCount() - 1;
+  return last_item < 0 || ListView_IsItemVisible(m_hWnd, last_item);
+}
+
+void LogListView::SetFollowing(bool following) {
+  if (following_ == following)
+    return;
+
+  following_ = following;
+  // Catch up with the rows held back while we weren't following.
+  if (following_ && item_count_timer_set_) {
+    KillTimer(kItemCountTimerId);
+    item_count_timer_set_ = false;
+    UpdateItemCount();
+  }
+}
+
+void LogListView::ScrollToTail(int num_rows) {
+  int top = GetTopIndex();
+  int per_page = GetCountPerPage();
+  int new_top = std::max(num_rows - per_page, 0);
+  if (new_top <= top)
+    return;
+
+  // A page or more of new rows replaces all those in view anyway.
+  CRect item_rect;
+  if (new_top - top >= per_page ||
+      !GetItemRect(top, &item_rect, LVIR_BOUNDS)) {
+    EnsureVisible(num_rows - 1, TRUE /* PartialOK */);
+    return;
+  }
+
+  Scroll(CSize(0, (new_top - top) * item_rect.Height()));
+}
+
+void LogListView::LogViewEvicted(int first_row) {
+  DCHECK_EQ(ui_loop_, base::MessageLoop::current());
+  DCHECK_LE(first_row_, first_row);
+
+  // The items stay put, so the selection does too, only the evicted rows
+  // go blank.
+  int old_first_row = first_row_;
+  first_row_ = first_row;
+  if (finder_.get() != NULL)
+    finder_->set_view_first_row(first_row);
+  highlighter_->OnRowsEvicted(first_row);
+
+  // A copy yet to be rendered loses the rows it can no longer get at.
+  copy_rows_.erase(copy_rows_.begin(),
+                   std::lower_bound(copy_rows_.begin(), copy_rows_.end(),
+                                    first_row));
+
+  if (!IsWindow())
+    return;
+
+  int top = GetTopIndex();
+  int bottom = top + GetCountPerPage();
+  if (top < first_row && bottom >= old_first_row)
+    RedrawItems(std::max(top, old_first_row), std::min(bottom, first_row - 1));
 }
 
 void LogListView::LogViewCleared() {
   DCHECK_EQ(ui_loop_, base::MessageLoop::current());
+  first_row_ = 0;
+  pending_go_to_time_ = base::Time();
+
+  // The rows a find would be searching are gone.
+  if (finder_.get() != NULL) {
+    finder_->Cancel();
+    finder_->set_view_first_row(0);
+  }
+  ClearHits();
+  display_cache_.Invalidate();
+  prefetched_to_ = prefetched_from_ - 1;
+  highlighter_->OnRowsCleared();
+  DropPendingCopy();
+  if (item_count_timer_set_) {
+    KillTimer(kItemCountTimerId);
+    item_count_timer_set_ = false;
+  }
+  following_ = true;
   DeleteAllItems();
+  PaintVolumeStrip();
 }
 
 void LogListView::UpdateCommandStatus(bool has_focus) {
   bool has_selection = GetSelectedCount() != 0;
 
   update_ui_->UIEnable(ID_EDIT_COPY, has_focus && has_selection);
+  update_ui_->UIEnable(ID_EDIT_COPY_TO_FILE, has_focus && has_selection);
   update_ui_->UIEnable(ID_EDIT_SELECT_ALL, has_focus);
   update_ui_->UIEnable(ID_EDIT_CLEAR_ALL, has_focus);
   update_ui_->UIEnable(ID_EDIT_FIND, has_focus);
   update_ui_->UIEnable(ID_EDIT_FIND_NEXT, has_focus &&
                        !find_params_.expression_.empty());
+  update_ui_->UIEnable(ID_EDIT_GOTO_TIME, has_focus &&
+                       log_view_->GetNumRows() > first_row_);
   update_ui_->UIEnable(ID_EDIT_AUTOSIZE_COLUMNS,
                        has_focus && log_view_->GetNumRows());
 }
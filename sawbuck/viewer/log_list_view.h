@@ -23,10 +23,32 @@
 #include <atlmisc.h>
 #include <string>
 #include <vector>
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/message_loop/message_loop.h"
+#include "base/strings/string_piece.h"
+#include "sawbuck/common/memory_budget.h"
+#include "sawbuck/log_lib/cpu_profile_service.h"
+#include "sawbuck/log_lib/string_table.h"
+#include "sawbuck/log_lib/symbol_lookup_service.h"
+#include "sawbuck/log_lib/time_formatter.h"
+#include "sawbuck/viewer/column_sizer.h"
+#include "sawbuck/viewer/display_cache.h"
 #include "sawbuck/viewer/find_dialog.h"
+#include "sawbuck/viewer/glyph_run_cache.h"
+#include "sawbuck/viewer/go_to_time_dialog.h"
 #include "sawbuck/viewer/list_view_base.h"
+#include "sawbuck/viewer/log_finder.h"
 #include "sawbuck/viewer/resource.h"
+#include "sawbuck/viewer/stack_trace_pool.h"
+#include "sawbuck/viewer/volume_histogram.h"
+
+struct HighlightRule;
+class LogStore;
+class ProcessInstanceIndex;
+struct RowBatch;
+class RowHighlighter;
+class StackModuleIndex;
 
 // Callback interface for ILogView.
 class ILogViewEvents {
@@ -34,14 +56,22 @@ class ILogViewEvents {
   // Called on the UI thread.
   virtual void LogViewNewItems() = 0;
   virtual void LogViewCleared() = 0;
+  // Called when the view's oldest rows are evicted, the other rows keep
+  // their numbers.
+  // @param first_row the view's new first row.
+  virtual void LogViewEvicted(int first_row) = 0;
 };
 
 // Provides a view on a log, the view may be filtered or sorted.
 class ILogView {
  public:
-  // Returns the number of rows in this view.
+  // Returns the number of rows in this view, including evicted rows.
   virtual int GetNumRows() = 0;
 
+  // Returns the first row of this view, the rows before it are evicted and
+  // mustn't be accessed.
+  virtual int GetFirstRow() = 0;
+
   // Clear all the items in this view.
   virtual void ClearAll() = 0;
 
@@ -50,9 +80,114 @@ class ILogView {
   virtual DWORD GetThreadId(int row) = 0;
   virtual base::Time GetTime(int row) = 0;
   virtual std::string GetFileName(int row) = 0;
+  // Returns the interned atom for the file name of row. Rows with equal
+  // file names have equal atoms, so this can be used to compare or cache
+  // on file names without fetching the string.
+  virtual StringTable::Atom GetFileAtom(int row) = 0;
   virtual int GetLine(int row) = 0;
   virtual std::string GetMessage(int row) = 0;
-  virtual void GetStackTrace(int row, std::vector<void*>* trace) = 0;
+  virtual void GetStackTrace(int row,
+                             std::vector<sym_util::Address>* trace) = 0;
+
+  // Zero-copy row accessors. Views backed by a store return pieces of the
+  // store's memory, which stay valid until the view next changes, that is
+  // until rows are added, evicted or cleared. The defaults copy the row
+  // into @p buffer and return that, so @p buffer must outlive the result.
+  // @{
+  virtual base::StringPiece GetFileNamePiece(int row, std::string* buffer) {
+    DCHECK(buffer != NULL);
+    *buffer = GetFileName(row);
+    return *buffer;
+  }
+  virtual base::StringPiece GetMessagePiece(int row, std::string* buffer) {
+    DCHECK(buffer != NULL);
+    *buffer = GetMessage(row);
+    return *buffer;
+  }
+  // @param trace on return points to the trace's addresses, NULL if the
+  //     trace is empty. Stores keep their traces encoded, so the default
+  //     decoding into @p buffer is the norm.
+  // @returns the depth of the trace.
+  virtual size_t GetStackTracePiece(int row,
+                                    const sym_util::Address** trace,
+                                    std::vector<sym_util::Address>* buffer) {
+    DCHECK(trace != NULL);
+    DCHECK(buffer != NULL);
+    GetStackTrace(row, buffer);
+    *trace = buffer->empty() ? NULL : &(*buffer)[0];
+    return buffer->size();
+  }
+  // @}
+
+  // Returns the id of the pooled stack trace of @p row. Rows with equal
+  // traces have equal ids, so this can be used to compare or cache on
+  // traces without fetching them. The default returns kUnknownStack, which
+  // equals no other row's id.
+  virtual StackTracePool::StackId GetStackTraceId(int row) {
+    return StackTracePool::kUnknownStack;
+  }
+
+  // Returns the index of the modules and functions of the rows' traces, by
+  // their stack ids, for filters on stacks. NULL by default, for views that
+  // can't tell the modules of their traces.
+  virtual StackModuleIndex* GetStackModuleIndex() { return NULL; }
+
+  // Returns the index of the process instances of the rows, for filters on
+  // processes. NULL by default, for views that can't tell the processes
+  // of their rows.
+  virtual ProcessInstanceIndex* GetProcessInstanceIndex() { return NULL; }
+
+  // Repeat accessors, for views on a store that collapses repeated rows.
+  // By default no row repeats.
+  // @{
+  // Returns true if rows may yet gain repeats, which changes their count.
+  virtual bool CollapsesRepeats() { return false; }
+  // Returns the number of occurrences of row.
+  virtual int GetRepeatCount(int row) { return 1; }
+  // Returns the time of the last occurrence of row.
+  virtual base::Time GetLastTime(int row) { return GetTime(row); }
+  // @}
+
+  // Returns true if row is a marker for data the capture lost, rather than
+  // a logged row. By default no row is.
+  virtual bool IsLossMarker(int row) { return false; }
+
+  // Returns the first row at or past @p time, or GetNumRows() if there's
+  // none. The default searches for the first row no earlier than @p time,
+  // which assumes the rows are in time order.
+  virtual int FindRowForTime(const base::Time& time) {
+    int low = GetFirstRow();
+    int high = GetNumRows();
+    while (low < high) {
+      int mid = low + (high - low) / 2;
+      if (GetTime(mid) < time)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+    return low;
+  }
+
+  // Returns the store backing this view row for row, or NULL if the view
+  // has no such store. This allows bulk access to the store's columns.
+  virtual const LogStore* GetLogStore() = 0;
+
+  // Returns the store whose rows this view's rows are, in whatever order
+  // and with whatever rows left out, or NULL if they aren't a store's
+  // rows. The default is the store backing the view row for row.
+  virtual const LogStore* GetMappedStore() { return GetLogStore(); }
+  // Returns the row of GetMappedStore() that @p row is. Views on views
+  // compose their mapping with the original's, and keep it flattened where
+  // they can, so that the lookup doesn't take a call per view stacked.
+  virtual int GetStoreRow(int row) { return row; }
+
+  // Retrieves the @p columns, a mask of RowBatch::Column, of the
+  // @p num_rows rows from @p first_row on to @p batch, for consumers that
+  // go over many rows. The default reads the columns from the mapped store
+  // if there's one, and row by row through the accessors otherwise, see
+  // row_batch.cc.
+  virtual void GetRows(int first_row, int num_rows, uint32 columns,
+                       RowBatch* batch);
 
   // Register for change notifications. Notifications will be issued
   // on the thread where the registration was made.
@@ -71,6 +206,8 @@ class LogViewFormatter {
     FILE,
     LINE,
     MESSAGE,
+    // The repeats of a collapsed row, empty for rows that don't repeat.
+    COUNT,
 
     // Must be last.
     NUM_COLUMNS
@@ -78,22 +215,52 @@ class LogViewFormatter {
 
   LogViewFormatter();
 
+  // Formats column @p col of @p row of @p log_view to @p str. Views on a
+  // store are read from the store, at the row their mapping points to.
   bool FormatColumn(ILogView* log_view,
                     int row,
                     Column col,
                     std::string* str);
+  // Formats column @p col of row @p index of @p batch to @p str. The batch
+  // must hold RowBatch::FORMATTED_COLUMNS.
+  bool FormatBatchColumn(const RowBatch& batch,
+                         int index,
+                         Column col,
+                         std::string* str);
+
+  base::Time base_time() const { return time_formatter_.base_time(); }
+  void set_base_time(base::Time base_time) {
+    time_formatter_.set_base_time(base_time);
+  }
 
-  base::Time base_time() const { return base_time_; }
-  void set_base_time(base::Time base_time) { base_time_ = base_time; }
+  // Parses @p text, as the time column shows it, to @p time. Times of day
+  // fall on the day of @p day.
+  bool ParseTime(const base::StringPiece& text,
+                 base::Time day,
+                 base::Time* time) const {
+    return time_formatter_.Parse(text, day, time);
+  }
 
  private:
-  // The time delta subtracted from the displayed time stamp in each row.
-  base::Time base_time_;
+  // Formats column @p col of row @p row of @p store to @p str.
+  bool FormatStoreColumn(const LogStore& store,
+                         int row,
+                         Column col,
+                         std::string* str);
+
+  // Formats the time stamp of each row, relative to the base time if set.
+  TimeFormatter time_formatter_;
 };
 
 // Forward decls.
+class ColumnSortedLogView;
 class StackTraceListView;
+class ICpuTimelineService;
+class IDiskIoLatencyService;
 class IProcessInfoService;
+class IRegistryAccessService;
+class IThreadContextService;
+class IThreadInfoService;
 namespace WTL {
 class CUpdateUIBase;
 };
@@ -103,10 +270,16 @@ typedef CWinTraits<WS_CHILD | WS_VISIBLE | WS_CLIPCHILDREN | WS_CLIPSIBLINGS |
     LVS_REPORT | LVS_SHOWSELALWAYS | LVS_OWNERDATA, 0>
         LogListViewTraits;
 
-// List view control subclass that manages the log view.
+// List view control subclass that manages the log view. The control owns
+// no data and asks for the rows in view only, which it draws through
+// custom draw, @see DrawRow. It still does the scrolling, a row at a time,
+// the selection, the columns and the context menus, and counts rows in
+// int, as ILogView does.
 class LogListView
     : public ListViewBase<LogListView, LogListViewTraits>,
-      public ILogViewEvents {
+      public ILogViewEvents,
+      public LogFinder::Delegate,
+      public ColumnSizer::TextSource {
  public:
   typedef ListViewBase<LogListView, LogListViewTraits> WindowBase;
   DECLARE_WND_SUPERCLASS(NULL, WindowBase::GetWndClassName())
@@ -117,21 +290,43 @@ class LogListView
     MSG_WM_DESTROY(OnDestroy)
     MSG_WM_SETFOCUS(OnSetFocus)
     MSG_WM_KILLFOCUS(OnKillFocus)
+    MSG_WM_KEYDOWN(OnKeyDown)
+    MSG_WM_VSCROLL(OnVScroll)
+    MSG_WM_MOUSEWHEEL(OnMouseWheel)
+    MSG_WM_NCCALCSIZE(OnNcCalcSize)
+    MSG_WM_NCPAINT(OnNcPaint)
+    MSG_WM_NCHITTEST(OnNcHitTest)
+    MSG_WM_NCLBUTTONDOWN(OnNcLButtonDown)
+    MSG_WM_TIMER(OnTimer)
     COMMAND_ID_HANDLER_EX(ID_EDIT_AUTOSIZE_COLUMNS, OnAutoSizeColumns)
+    MSG_WM_RENDERFORMAT(OnRenderFormat)
+    MSG_WM_RENDERALLFORMATS(OnRenderAllFormats)
+    MSG_WM_DESTROYCLIPBOARD(OnDestroyClipboard)
     COMMAND_ID_HANDLER_EX(ID_EDIT_COPY, OnCopyCommand)
+    COMMAND_ID_HANDLER_EX(ID_EDIT_COPY_TO_FILE, OnCopyToFile)
     COMMAND_ID_HANDLER_EX(ID_EDIT_CLEAR_ALL, OnClearAll)
     COMMAND_ID_HANDLER_EX(ID_EDIT_SELECT_ALL, OnSelectAll)
     COMMAND_ID_HANDLER_EX(ID_EDIT_FIND, OnFind)
     COMMAND_ID_HANDLER_EX(ID_EDIT_FIND_NEXT, OnFindNext)
+    COMMAND_ID_HANDLER_EX(ID_EDIT_GOTO_TIME, OnGoToTime)
     COMMAND_ID_HANDLER_EX(ID_SET_TIME_ZERO, OnSetBaseTime)
     COMMAND_ID_HANDLER_EX(ID_RESET_BASE_TIME, OnResetBaseTime)
+    COMMAND_ID_HANDLER_EX(ID_DISK_IO_REPORT, OnDiskIoReport)
+    COMMAND_ID_HANDLER_EX(ID_HOT_FUNCTIONS_REPORT, OnHotFunctionsReport)
+    COMMAND_ID_HANDLER_EX(ID_KERNEL_CONTEXT_REPORT, OnKernelContextReport)
+    COMMAND_ID_HANDLER_EX(ID_REGISTRY_COUNT_REPORT, OnRegistryReport)
+    COMMAND_ID_HANDLER_EX(ID_REGISTRY_LATENCY_REPORT, OnRegistryReport)
     REFLECTED_NOTIFY_CODE_HANDLER_EX(LVN_GETDISPINFO, OnGetDispInfo)
+    REFLECTED_NOTIFY_CODE_HANDLER_EX(LVN_ODCACHEHINT, OnCacheHint)
+    REFLECTED_NOTIFY_CODE_HANDLER_EX(NM_CUSTOMDRAW, OnCustomDraw)
     REFLECTED_NOTIFY_CODE_HANDLER_EX(LVN_ITEMCHANGED, OnItemChanged)
     REFLECTED_NOTIFY_CODE_HANDLER_EX(LVN_GETINFOTIP, OnGetInfoTip)
+    REFLECTED_NOTIFY_CODE_HANDLER_EX(LVN_COLUMNCLICK, OnColumnClick)
     DEFAULT_REFLECTION_HANDLER()
   END_MSG_MAP()
 
   explicit LogListView(CUpdateUIBase* update_ui);
+  ~LogListView();
 
   void set_stack_trace_view(StackTraceListView* stack_trace_view) {
     stack_trace_view_ = stack_trace_view;
@@ -139,11 +334,54 @@ class LogListView
   void set_process_info_service(IProcessInfoService* process_info_service) {
     process_info_service_ = process_info_service;
   }
+  void set_thread_info_service(IThreadInfoService* thread_info_service) {
+    thread_info_service_ = thread_info_service;
+  }
+  void set_cpu_timeline_service(ICpuTimelineService* cpu_timeline_service) {
+    cpu_timeline_service_ = cpu_timeline_service;
+  }
+  void set_disk_io_latency_service(IDiskIoLatencyService* disk_io_service) {
+    disk_io_latency_service_ = disk_io_service;
+  }
+  void set_cpu_profile_service(ICpuProfileService* cpu_profile_service) {
+    cpu_profile_service_ = cpu_profile_service;
+  }
+  void set_registry_access_service(IRegistryAccessService* registry_service) {
+    registry_access_service_ = registry_service;
+  }
+  void set_thread_context_service(IThreadContextService* context_service) {
+    thread_context_service_ = context_service;
+  }
+  // Sets the service we prefetch the symbols of nearby rows with.
+  void set_symbol_lookup_service(ISymbolLookupService* lookup_service) {
+    symbol_lookup_service_ = lookup_service;
+  }
+
+  // Selects and shows the first row at or after @p time. If the view's
+  // rows don't reach @p time yet, e.g. because they're still coming in
+  // from a session just opened, this waits for them.
+  void GoToTime(const base::Time& time);
 
+  // Sets the view we display, sorted by the column last clicked if any.
   void SetLogView(ILogView* log_view);
 
+  // Sets the rules that style the rows we display. Each row takes the
+  // style of the first rule it matches, if any.
+  void SetHighlightRules(const std::vector<HighlightRule>& rules);
+
   virtual void LogViewNewItems();
   virtual void LogViewCleared();
+  virtual void LogViewEvicted(int first_row);
+
+  // LogFinder::Delegate implementation.
+  virtual void OnFindDone(int row);
+  virtual void OnFindAllDone(int num_hits);
+
+  // ColumnSizer::TextSource implementation.
+  // @returns the display text of the cell at @p row and @p col, from the
+  //     display cache if it's there.
+  // @note the text is valid until the next call.
+  virtual const std::wstring& GetCellText(int row, int col);
 
   // Our column definitions and config data to satisfy our contract
   // to the ListViewImpl superclass.
@@ -163,6 +401,7 @@ class LogListView
     COL_FILE = LogViewFormatter::FILE,
     COL_LINE = LogViewFormatter::LINE,
     COL_MESSAGE = LogViewFormatter::MESSAGE,
+    COL_COUNT = LogViewFormatter::COUNT,
 
     // Must be last.
     COL_MAX,
@@ -172,32 +411,151 @@ class LogListView
   void OnDestroy();
 
   LRESULT OnGetDispInfo(LPNMHDR notification);
+  LRESULT OnCacheHint(LPNMHDR notification);
+  // Draws the rows ourselves, @see DrawRow.
+  LRESULT OnCustomDraw(LPNMHDR notification);
   LRESULT OnItemChanged(LPNMHDR notification);
   LRESULT OnGetInfoTip(LPNMHDR notification);
+  // Sorts by the column clicked, ascending, then descending, then not.
+  LRESULT OnColumnClick(LPNMHDR notification);
 
   void OnCopyCommand(UINT code, int id, CWindow window);
+  void OnCopyToFile(UINT code, int id, CWindow window);
+  void OnRenderFormat(UINT format);
+  void OnRenderAllFormats();
+  void OnDestroyClipboard();
   virtual void OnClearAll(UINT code, int id, CWindow window);
   void OnSelectAll(UINT code, int id, CWindow window);
   void OnSetFocus(CWindow window);
   void OnKillFocus(CWindow window);
+  void OnKeyDown(TCHAR key, UINT repeat_count, UINT flags);
+  void OnVScroll(int code, short pos, CScrollBar scroll_bar);
+  BOOL OnMouseWheel(UINT flags, short delta, CPoint point);
+  LRESULT OnNcCalcSize(BOOL calc_valid_rects, LPARAM lparam);
+  void OnNcPaint(CRgnHandle region);
+  LRESULT OnNcHitTest(CPoint point);
+  void OnNcLButtonDown(UINT hit_test, CPoint point);
+  void OnTimer(UINT_PTR timer_id);
   void OnContextMenu(CWindow wnd, CPoint point);
   void OnFind(UINT code, int id, CWindow window);
   void OnFindNext(UINT code, int id, CWindow window);
+  void OnGoToTime(UINT code, int id, CWindow window);
   void OnAutoSizeColumns(UINT code, int id, CWindow window);
 
   // Context menu command handlers.
   void OnSetBaseTime(UINT code, int id, CWindow window);
   void OnResetBaseTime(UINT code, int id, CWindow window);
+  void OnDiskIoReport(UINT code, int id, CWindow window);
+  void OnHotFunctionsReport(UINT code, int id, CWindow window);
+  void OnKernelContextReport(UINT code, int id, CWindow window);
+  // Reports the hottest registry keys by count or latency, as @p id says.
+  void OnRegistryReport(UINT code, int id, CWindow window);
+
+  // Retrieves the time span of the selected rows, widened to at least
+  // @p min_window_ms either side of a single row.
+  // @returns false if no rows are selected.
+  bool GetSelectedTimeRange(int min_window_ms,
+                            base::Time* from,
+                            base::Time* to);
+
+  // Shows the hot functions report, once the symbols of hot_frames_ are
+  // resolved.
+  void HotFramesResolved(sym_util::ProcessId pid,
+                         base::Time time,
+                         ISymbolLookupService::Handle handle,
+                         const std::vector<sym_util::Address>& addresses,
+                         const std::vector<sym_util::SymbolRecord>& symbols);
 
   // Updates the UI status for commands we support, disables
   // all our commands unless we have focus.
   // @param has_focus true iff this window has the focus.
   void UpdateCommandStatus(bool has_focus);
 
-  // Finds the next item matching with the current find parameters.
-  // See |find_params_|.
+  // Starts finding the next item matching with the current find
+  // parameters, see |find_params_|. The search runs in the background,
+  // and can be cancelled with the escape key. After a find-all, this
+  // steps through the hits it found instead.
   void FindNext();
 
+  // Starts finding all items matching the current find parameters.
+  void FindAll();
+
+  // Forgets the hits of the last find-all, and hides the hit strip.
+  void ClearHits();
+
+  // Paints the hit density strip beside the vertical scroll bar, which
+  // shows where in the log the hits of the last find-all are.
+  void PaintHitStrip();
+
+  // @returns the volume strip above our client area, in window
+  //     coordinates.
+  CRect GetVolumeStripRect();
+  // Paints the volume strip, which shows how many rows the store holds
+  // over time, shaded by their count and colored by their worst severity.
+  // It reads the store's volume histogram alone, so it costs the same for
+  // any number of rows.
+  void PaintVolumeStrip();
+
+  // Prefetches the symbols of the stack traces of rows @p from through
+  // @p to, but for those prefetched last time, so that selecting one
+  // shows its trace resolved.
+  void PrefetchSymbols(int from, int to);
+
+  // Displays @p log_view, which is the view we're handed or the view
+  // sorting it.
+  void ShowLogView(ILogView* log_view);
+
+  // Shows the sort order on the column headers.
+  void UpdateSortIndicators();
+
+  // Brings the item count up to date with the log view, and scrolls to
+  // the new rows if the last row was visible.
+  void UpdateItemCount();
+
+  // @returns true iff the last item is in view, or there are no items.
+  bool IsLastItemVisible();
+  // Follows the tail of the log, or stops following it, @see following_.
+  void SetFollowing(bool following);
+  // Scrolls the last of @p num_rows into view, blitting the rows that stay
+  // in view so that only those scrolled in repaint.
+  void ScrollToTail(int num_rows);
+
+  // @returns the glyph widths of our current font.
+  GlyphWidthTable* GetGlyphWidths();
+  // @returns the glyph runs of our current font.
+  GlyphRunCache* GetGlyphRuns();
+  // @returns the bold variant of our current font, for highlighted rows.
+  HFONT GetBoldFont();
+
+  // Invoked by the highlighter as it styles rows @p begin through
+  // @p end - 1, to redraw those in view.
+  void OnRowsRestyled(int begin, int end);
+
+  // Draws @p row to @p dc, a run of glyphs per cell, straight from the
+  // display cache. This spares the list view asking for the cells one at
+  // a time, copying their text, and GDI mapping and measuring it afresh
+  // on every paint.
+  // @returns false if the list view is to draw the row itself.
+  bool DrawRow(HDC dc, int row);
+
+  // Retrieves the selected rows, in order.
+  void GetSelectedRows(std::vector<int>* rows);
+
+  // Invoked by the memory budget to free @p bytes of the display cache.
+  void EvictDisplayText(uint64 bytes);
+
+  // @returns the text of the pending copy for the clipboard, or NULL on
+  //     failure.
+  HGLOBAL RenderCopy();
+
+  // Puts the text of the pending copy on the clipboard, if we still own
+  // it, while the rows are still around.
+  void RenderPendingCopy();
+
+  // Takes the pending copy off the clipboard, if we still own it, as the
+  // rows are gone.
+  void DropPendingCopy();
+
   // To help unittest mocking.
   virtual BOOL DeleteAllItems() {
     return WindowBase::DeleteAllItems();
@@ -209,8 +567,47 @@ class LogListView
   // Our process info service, if any.
   IProcessInfoService* process_info_service_;
 
+  // Our thread info service, if any.
+  IThreadInfoService* thread_info_service_;
+
+  // Our CPU timeline service, if any.
+  ICpuTimelineService* cpu_timeline_service_;
+
+  // Our disk I/O latency service, if any.
+  IDiskIoLatencyService* disk_io_latency_service_;
+
+  // Our registry access service, if any.
+  IRegistryAccessService* registry_access_service_;
+
+  // Our CPU profile service, if any.
+  ICpuProfileService* cpu_profile_service_;
+  // The frames of the pending hot functions report, their samples in all,
+  // and the request resolving their symbols, if any.
+  std::vector<ICpuProfileService::HotFrame> hot_frames_;
+  uint64 hot_samples_;
+  ISymbolLookupService::Handle hot_frames_handle_;
+
+  // Our thread context service, if any.
+  IThreadContextService* thread_context_service_;
+
+  // Our symbol lookup service, if any.
+  ISymbolLookupService* symbol_lookup_service_;
+  // The rows we last prefetched symbols for, empty when to < from.
+  int prefetched_from_;
+  int prefetched_to_;
+
   ILogView* log_view_;
   int event_cookie_;
+  // The view we're handed, which log_view_ sorts while sorting by a column.
+  ILogView* unsorted_log_view_;
+  scoped_ptr<ColumnSortedLogView> column_sorted_view_;
+  // The column we sort by, or kNoSortColumn.
+  static const int kNoSortColumn = -1;
+  int sort_column_;
+  bool sort_descending_;
+  // The first row of log_view_, the items before it are for evicted rows
+  // and show blank, so that the items keep the rows' numbers.
+  int first_row_;
 
   // Image indexes for severity, stored by severity value.
   std::vector<int> image_indexes_;
@@ -222,9 +619,68 @@ class LogListView
   // Temporary storage for strings returned from OnGetDispInfo.
   std::wstring item_text_;
 
+  // Caches the text of the cells on display, and of those about to be.
+  DisplayCache display_cache_;
+  // The display cache's share of the process's memory budget.
+  MemoryBudget::ConsumerId memory_budget_id_;
+  // The text of the last cell that isn't cached, @see GetCellText.
+  std::wstring uncached_text_;
+  // The first row of the last cache hint, to tell the scroll direction.
+  int last_hint_row_;
+
+  // True iff the item count timer is set, for new rows that came in while
+  // we're scrolled away from the last row.
+  bool item_count_timer_set_;
+
+  // True iff we're following the tail of the log, keeping the last page
+  // in view as rows come in. Scrolling away pauses it, scrolling back to
+  // the last row or the End key resumes it.
+  bool following_;
+
+  // The time to go to once the rows reach it, null if none.
+  base::Time pending_go_to_time_;
+
+  // Measures text for sizing columns, for the font it was created for.
+  scoped_ptr<GlyphWidthTable::Measurer> glyph_measurer_;
+  scoped_ptr<GlyphWidthTable> glyph_widths_;
+  HFONT glyph_widths_font_;
+  // Lays out the text of the rows we draw, for the font it was created
+  // for, whose text height is given.
+  scoped_ptr<GlyphRunCache::Measurer> glyph_run_measurer_;
+  scoped_ptr<GlyphRunCache> glyph_runs_;
+  HFONT glyph_runs_font_;
+  int glyph_runs_text_height_;
+  // The run of the cell being drawn, kept to reuse its storage.
+  GlyphRun glyph_run_;
+  // The bold variant of the font it was created from.
+  CFont bold_font_;
+  HFONT bold_font_base_;
+
+  // Styles the rows of log_view_ by the highlight rules.
+  scoped_ptr<RowHighlighter> highlighter_;
+
+  // The rows of the last copy, until the clipboard asks for their text,
+  // as copying large selections would otherwise take a lot of memory and
+  // time that may never be needed. Also the base time at the copy.
+  std::vector<int> copy_rows_;
+  base::Time copy_base_time_;
+
   // The last piece of text we searched for.
   FindParameters find_params_;
 
+  // Searches log_view_, created with it.
+  scoped_ptr<LogFinder> finder_;
+
+  // True iff the finder's hits are for the current find parameters, in
+  // which case we show the hit strip and step through them.
+  bool show_hits_;
+
+  // The time range across the volume strip as last painted, and the
+  // buckets painted, kept to reuse their storage.
+  int64 volume_start_;
+  int64 volume_end_;
+  std::vector<VolumeHistogram::Bucket> volume_buckets_;
+
   // Asserting on correct threading.
   base::MessageLoop* ui_loop_;
 
@@ -20,6 +20,7 @@
 namespace {
 
 using testing::NotNull;
+using testing::Return;
 using testing::StrictMock;
 
 class LogListViewTest : public testing::Test {
@@ -44,6 +45,7 @@ TEST_F(LogListViewTest, ClearAll) {
   TestingLogListView test_log_list_view;
   StrictMock<testing::MockILogView> mock_log_view;
   EXPECT_CALL(mock_log_view, Register(&test_log_list_view, NotNull())).Times(1);
+  EXPECT_CALL(mock_log_view, GetFirstRow()).WillOnce(Return(0));
   test_log_list_view.SetLogView(&mock_log_view);
 
   EXPECT_CALL(mock_log_view, ClearAll()).Times(1);
@@ -53,4 +55,17 @@ TEST_F(LogListViewTest, ClearAll) {
   test_log_list_view.LogViewCleared();
 }
 
+TEST_F(LogListViewTest, EvictedRowsShowBlank) {
+  TestingLogListView test_log_list_view;
+  StrictMock<testing::MockILogView> mock_log_view;
+  EXPECT_CALL(mock_log_view, Register(&test_log_list_view, NotNull())).Times(1);
+  EXPECT_CALL(mock_log_view, GetFirstRow()).WillOnce(Return(5));
+  test_log_list_view.SetLogView(&mock_log_view);
+
+  // The view isn't asked for the evicted rows.
+  EXPECT_EQ(L"", test_log_list_view.GetCellText(4, 0));
+  test_log_list_view.LogViewEvicted(10);
+  EXPECT_EQ(L"", test_log_list_view.GetCellText(9, 0));
+}
+
 }  // namespace
@@ -0,0 +1,1157 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log query implementation.
+#include "sawbuck/viewer/log_query.h"
+
+#include <algorithm>
+#include <map>
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/memory/scoped_vector.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "sawbuck/common/perf_counters.h"
+#include "sawbuck/common/task_pool.h"
+#include "sawbuck/viewer/log_store.h"
+
+namespace {
+
+PerfCounter query_run_counter("Query.Run", 1);
+PerfCounter query_range_counter("Query.Range", 1);
+
+// No more threads than this run a query.
+const size_t kMaxQueryThreads = 8;
+// Most rows cost a few branchless compares of the store's columns, so a
+// thread needs this many rows to earn back an executor and merging its
+// groups.
+const int kMinRowsPerThread = 16 * 1024;
+
+const int64 kMicrosecondsPerSecond = 1000 * 1000;
+
+// The level names, by level.
+const struct {
+  const char* name;
+  UCHAR level;
+} kLevelNames[] = {
+  { "FATAL", 1 },
+  { "ERROR", 2 },
+  { "WARNING", 3 },
+  { "INFO", 4 },
+  { "INFORMATION", 4 },
+  { "VERBOSE", 5 },
+};
+
+inline char ToLowerASCII(char c) {
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// @returns @p text in lower case.
+std::string LowerASCII(const std::string& text) {
+  std::string lowered(text);
+  for (size_t i = 0; i < lowered.size(); ++i)
+    lowered[i] = ToLowerASCII(lowered[i]);
+  return lowered;
+}
+
+// @returns true iff @p text is @p keyword, ignoring ASCII case.
+bool IsKeywordText(const std::string& text, const char* keyword) {
+  size_t i = 0;
+  for (; i < text.size() && keyword[i] != '\0'; ++i) {
+    if (ToLowerASCII(text[i]) != ToLowerASCII(keyword[i]))
+      return false;
+  }
+  return i == text.size() && keyword[i] == '\0';
+}
+
+// @returns true iff @p text contains @p lower_literal, which is in lower
+//     case, ignoring ASCII case.
+bool ContainsIgnoringCase(const base::StringPiece& text,
+                          const std::string& lower_literal) {
+  if (lower_literal.size() > text.size())
+    return false;
+  size_t last = text.size() - lower_literal.size();
+  for (size_t i = 0; i <= last; ++i) {
+    size_t j = 0;
+    while (j < lower_literal.size() &&
+           ToLowerASCII(text[i + j]) == lower_literal[j]) {
+      ++j;
+    }
+    if (j == lower_literal.size())
+      return true;
+  }
+  return false;
+}
+
+// Orders pairs by their first members alone.
+struct FirstLess {
+  template <class Pair>
+  bool operator()(const Pair& left, const Pair& right) const {
+    return left.first < right.first;
+  }
+};
+
+// @returns true iff any of the first @p num_rows in @p selection is set.
+bool AnySelected(const uint8* selection, int num_rows) {
+  for (int i = 0; i < num_rows; ++i) {
+    if (selection[i])
+      return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+const size_t LogQuery::kMaxGroupColumns;
+const int LogQuery::kBlockRows;
+
+LogQuery::Node::Node()
+    : kind(NODE_COMPARE), left(-1), right(-1), column(COLUMN_LEVEL),
+      op(OP_EQ) {
+}
+
+// Parses the query text into the query's plan, by recursive descent.
+class LogQuery::Parser {
+ public:
+  Parser(const base::StringPiece& text, LogQuery* query)
+      : text_(text), query_(query), position_(0) {
+    DCHECK(query != NULL);
+  }
+
+  bool Parse(std::string* error);
+
+ private:
+  enum TokenType {
+    TOKEN_END,
+    TOKEN_WORD,
+    TOKEN_NUMBER,
+    TOKEN_STRING,
+    TOKEN_SYMBOL,
+  };
+
+  struct Token {
+    TokenType type;
+    // The word, number or symbol, or the string without its quotes.
+    std::string text;
+    size_t offset;
+  };
+
+  // Splits text_ into tokens_.
+  bool Tokenize();
+
+  const Token& Peek() const { return tokens_[position_]; }
+  // @returns true iff the next token is @p keyword, ignoring case.
+  bool IsKeyword(const char* keyword) const;
+  // Takes the next token iff it's @p keyword or @p symbol.
+  // @{
+  bool AcceptKeyword(const char* keyword);
+  bool AcceptSymbol(const char* symbol);
+  // @}
+
+  // Records @p message as the error, at the next token.
+  // @returns false.
+  bool Fail(const char* message);
+
+  // The productions of the grammar, each returning true on success.
+  // @{
+  bool ParseCondition(int* node);
+  bool ParseConjunction(int* node);
+  bool ParseFactor(int* node);
+  bool ParseComparison(int* node);
+  bool ParseColumn(ColumnId* column);
+  bool ParseOp(Op* op);
+  bool ParseValue(ColumnId column, int64* value);
+  bool ParseString(std::string* text);
+  bool ParseCount(size_t* count);
+  // @}
+
+  // Adds @p node to the query's nodes.
+  // @returns its index.
+  int AddNode(const Node& node);
+  int AddBinary(NodeKind kind, int left, int right);
+
+  base::StringPiece text_;
+  LogQuery* query_;
+  std::vector<Token> tokens_;
+  size_t position_;
+  std::string error_;
+
+  DISALLOW_COPY_AND_ASSIGN(Parser);
+};
+
+bool LogQuery::Parser::Parse(std::string* error) {
+  DCHECK(error != NULL);
+  if (!Tokenize()) {
+    *error = error_;
+    return false;
+  }
+
+  AcceptKeyword("SELECT");
+  if (!AcceptKeyword("COUNT")) {
+    Fail("Expected COUNT");
+    *error = error_;
+    return false;
+  }
+  if (AcceptSymbol("(") && (!AcceptSymbol("*") || !AcceptSymbol(")"))) {
+    Fail("Expected COUNT(*)");
+    *error = error_;
+    return false;
+  }
+
+  bool ok = true;
+  if (AcceptKeyword("BY")) {
+    do {
+      ColumnId column = COLUMN_LEVEL;
+      if (!ParseColumn(&column)) {
+        ok = false;
+      } else if (column == COLUMN_TIME || column == COLUMN_MESSAGE) {
+        ok = Fail("Can't group by time or message, try template");
+      } else if (query_->group_by_.size() == kMaxGroupColumns) {
+        ok = Fail("Too many columns to group by");
+      } else {
+        query_->group_by_.push_back(column);
+      }
+    } while (ok && AcceptSymbol(","));
+  }
+  if (ok && AcceptKeyword("WHERE"))
+    ok = ParseCondition(&query_->root_);
+  if (ok && AcceptKeyword("LIMIT"))
+    ok = ParseCount(&query_->limit_);
+  if (ok && Peek().type != TOKEN_END)
+    ok = Fail("Unexpected text");
+
+  if (!ok)
+    *error = error_;
+  return ok;
+}
+
+bool LogQuery::Parser::Tokenize() {
+  size_t i = 0;
+  while (true) {
+    while (i < text_.size() && IsAsciiWhitespace(text_[i]))
+      ++i;
+
+    Token token;
+    token.offset = i;
+    if (i == text_.size()) {
+      token.type = TOKEN_END;
+      tokens_.push_back(token);
+      return true;
+    }
+
+    char c = text_[i];
+    size_t start = i;
+    if (IsAsciiAlpha(c) || c == '_') {
+      token.type = TOKEN_WORD;
+      while (i < text_.size() &&
+             (IsAsciiAlpha(text_[i]) || IsAsciiDigit(text_[i]) ||
+              text_[i] == '_')) {
+        ++i;
+      }
+      token.text = text_.substr(start, i - start).as_string();
+    } else if (IsAsciiDigit(c)) {
+      token.type = TOKEN_NUMBER;
+      while (i < text_.size() && IsAsciiDigit(text_[i]))
+        ++i;
+      if (i + 1 < text_.size() && text_[i] == '.' &&
+          IsAsciiDigit(text_[i + 1])) {
+        ++i;
+        while (i < text_.size() && IsAsciiDigit(text_[i]))
+          ++i;
+      }
+      token.text = text_.substr(start, i - start).as_string();
+    } else if (c == '\'' || c == '"') {
+      token.type = TOKEN_STRING;
+      size_t end = text_.find(c, i + 1);
+      if (end == base::StringPiece::npos) {
+        position_ = tokens_.size();
+        tokens_.push_back(token);
+        return Fail("Unterminated string");
+      }
+      token.text = text_.substr(i + 1, end - i - 1).as_string();
+      i = end + 1;
+    } else {
+      static const char* kSymbols[] = {
+        "!=", "<>", "<=", ">=", "(", ")", ",", "*", "=", "<", ">",
+      };
+      token.type = TOKEN_SYMBOL;
+      for (size_t j = 0; j < arraysize(kSymbols); ++j) {
+        if (text_.substr(i).starts_with(kSymbols[j])) {
+          token.text = kSymbols[j];
+          break;
+        }
+      }
+      if (token.text.empty()) {
+        position_ = tokens_.size();
+        tokens_.push_back(token);
+        return Fail("Unexpected character");
+      }
+      i += token.text.size();
+    }
+    tokens_.push_back(token);
+  }
+}
+
+bool LogQuery::Parser::IsKeyword(const char* keyword) const {
+  return Peek().type == TOKEN_WORD && IsKeywordText(Peek().text, keyword);
+}
+
+bool LogQuery::Parser::AcceptKeyword(const char* keyword) {
+  if (!IsKeyword(keyword))
+    return false;
+  ++position_;
+  return true;
+}
+
+bool LogQuery::Parser::AcceptSymbol(const char* symbol) {
+  if (Peek().type != TOKEN_SYMBOL || Peek().text != symbol)
+    return false;
+  ++position_;
+  return true;
+}
+
+bool LogQuery::Parser::Fail(const char* message) {
+  if (error_.empty()) {
+    error_ = base::StringPrintf("%s at position %d.", message,
+                                static_cast<int>(Peek().offset) + 1);
+  }
+  return false;
+}
+
+bool LogQuery::Parser::ParseCondition(int* node) {
+  if (!ParseConjunction(node))
+    return false;
+  while (AcceptKeyword("OR")) {
+    int right = -1;
+    if (!ParseConjunction(&right))
+      return false;
+    *node = AddBinary(NODE_OR, *node, right);
+  }
+  return true;
+}
+
+bool LogQuery::Parser::ParseConjunction(int* node) {
+  if (!ParseFactor(node))
+    return false;
+  while (AcceptKeyword("AND")) {
+    int right = -1;
+    if (!ParseFactor(&right))
+      return false;
+    *node = AddBinary(NODE_AND, *node, right);
+  }
+  return true;
+}
+
+bool LogQuery::Parser::ParseFactor(int* node) {
+  if (AcceptKeyword("NOT")) {
+    int operand = -1;
+    if (!ParseFactor(&operand))
+      return false;
+    *node = AddBinary(NODE_NOT, operand, -1);
+    return true;
+  }
+
+  if (AcceptSymbol("(")) {
+    if (!ParseCondition(node))
+      return false;
+    if (!AcceptSymbol(")"))
+      return Fail("Expected )");
+    return true;
+  }
+
+  return ParseComparison(node);
+}
+
+bool LogQuery::Parser::ParseComparison(int* node) {
+  Node comparison;
+  if (!ParseColumn(&comparison.column))
+    return false;
+  if (comparison.column == COLUMN_TEMPLATE)
+    return Fail("Can only group by template");
+  bool is_string = comparison.column == COLUMN_FILE ||
+      comparison.column == COLUMN_MESSAGE;
+
+  if (AcceptKeyword("CONTAINS")) {
+    if (!is_string)
+      return Fail("Only the file and message can contain text");
+    comparison.kind = NODE_CONTAINS;
+    if (!ParseString(&comparison.text))
+      return false;
+    comparison.text = LowerASCII(comparison.text);
+    *node = AddNode(comparison);
+    return true;
+  }
+
+  if (AcceptKeyword("IN")) {
+    if (is_string)
+      return Fail("Only numbers can be IN a list");
+    comparison.kind = NODE_IN;
+    if (!AcceptSymbol("("))
+      return Fail("Expected (");
+    do {
+      int64 value = 0;
+      if (!ParseValue(comparison.column, &value))
+        return false;
+      comparison.values.push_back(value);
+    } while (AcceptSymbol(","));
+    if (!AcceptSymbol(")"))
+      return Fail("Expected )");
+    std::sort(comparison.values.begin(), comparison.values.end());
+    *node = AddNode(comparison);
+    return true;
+  }
+
+  if (AcceptKeyword("BETWEEN")) {
+    if (is_string)
+      return Fail("Only numbers can be BETWEEN values");
+    int64 low = 0;
+    int64 high = 0;
+    if (!ParseValue(comparison.column, &low))
+      return false;
+    if (!AcceptKeyword("AND"))
+      return Fail("Expected AND");
+    if (!ParseValue(comparison.column, &high))
+      return false;
+
+    comparison.op = OP_GE;
+    comparison.values.push_back(low);
+    int left = AddNode(comparison);
+    comparison.op = OP_LE;
+    comparison.values[0] = high;
+    int right = AddNode(comparison);
+    *node = AddBinary(NODE_AND, left, right);
+    return true;
+  }
+
+  if (!ParseOp(&comparison.op))
+    return false;
+  if (is_string) {
+    if (comparison.op != OP_EQ && comparison.op != OP_NE)
+      return Fail("Text only compares with = and !=");
+    if (!ParseString(&comparison.text))
+      return false;
+  } else {
+    comparison.values.push_back(0);
+    if (!ParseValue(comparison.column, &comparison.values[0]))
+      return false;
+  }
+  *node = AddNode(comparison);
+  return true;
+}
+
+bool LogQuery::Parser::ParseColumn(ColumnId* column) {
+  DCHECK(column != NULL);
+  static const ColumnId kColumns[] = {
+    COLUMN_LEVEL, COLUMN_PID, COLUMN_TID, COLUMN_TIME, COLUMN_FILE,
+    COLUMN_LINE, COLUMN_MESSAGE, COLUMN_TEMPLATE,
+  };
+  for (size_t i = 0; i < arraysize(kColumns); ++i) {
+    if (AcceptKeyword(GetColumnName(kColumns[i]))) {
+      *column = kColumns[i];
+      return true;
+    }
+  }
+  return Fail("Expected a column");
+}
+
+bool LogQuery::Parser::ParseOp(Op* op) {
+  DCHECK(op != NULL);
+  static const struct {
+    const char* symbol;
+    Op op;
+  } kOps[] = {
+    { "=", OP_EQ }, { "!=", OP_NE }, { "<>", OP_NE }, { "<", OP_LT },
+    { "<=", OP_LE }, { ">", OP_GT }, { ">=", OP_GE },
+  };
+  for (size_t i = 0; i < arraysize(kOps); ++i) {
+    if (AcceptSymbol(kOps[i].symbol)) {
+      *op = kOps[i].op;
+      return true;
+    }
+  }
+  return Fail("Expected a comparison");
+}
+
+bool LogQuery::Parser::ParseValue(ColumnId column, int64* value) {
+  DCHECK(value != NULL);
+  const Token& token = Peek();
+  if (column == COLUMN_LEVEL && token.type == TOKEN_WORD) {
+    for (size_t i = 0; i < arraysize(kLevelNames); ++i) {
+      if (AcceptKeyword(kLevelNames[i].name)) {
+        *value = kLevelNames[i].level;
+        return true;
+      }
+    }
+    return Fail("Expected a level");
+  }
+  if (token.type != TOKEN_NUMBER)
+    return Fail("Expected a number");
+
+  // Read the number by hand, as times have up to six decimals, and the
+  // rest have none.
+  size_t point = token.text.find('.');
+  if (point != std::string::npos && column != COLUMN_TIME)
+    return Fail("Expected a whole number");
+  std::string whole = token.text.substr(0, point);
+  std::string fraction;
+  if (point != std::string::npos)
+    fraction = token.text.substr(point + 1);
+  if (whole.size() > 12 || fraction.size() > 6)
+    return Fail("Number out of range");
+
+  int64 number = 0;
+  for (size_t i = 0; i < whole.size(); ++i)
+    number = number * 10 + (whole[i] - '0');
+  if (column == COLUMN_TIME) {
+    fraction.resize(6, '0');
+    number *= kMicrosecondsPerSecond;
+    int64 micros = 0;
+    for (size_t i = 0; i < fraction.size(); ++i)
+      micros = micros * 10 + (fraction[i] - '0');
+    number += micros;
+  }
+
+  ++position_;
+  *value = number;
+  return true;
+}
+
+bool LogQuery::Parser::ParseString(std::string* text) {
+  DCHECK(text != NULL);
+  if (Peek().type != TOKEN_STRING)
+    return Fail("Expected a quoted string");
+  *text = Peek().text;
+  ++position_;
+  return true;
+}
+
+bool LogQuery::Parser::ParseCount(size_t* count) {
+  DCHECK(count != NULL);
+  const Token& token = Peek();
+  if (token.type != TOKEN_NUMBER || token.text.find('.') !=
+      std::string::npos || token.text.size() > 9) {
+    return Fail("Expected a count");
+  }
+  size_t number = 0;
+  for (size_t i = 0; i < token.text.size(); ++i)
+    number = number * 10 + (token.text[i] - '0');
+  if (number == 0)
+    return Fail("Expected a count");
+
+  ++position_;
+  *count = number;
+  return true;
+}
+
+int LogQuery::Parser::AddNode(const Node& node) {
+  query_->nodes_.push_back(node);
+  return static_cast<int>(query_->nodes_.size() - 1);
+}
+
+int LogQuery::Parser::AddBinary(NodeKind kind, int left, int right) {
+  Node node;
+  node.kind = kind;
+  node.left = left;
+  node.right = right;
+  return AddNode(node);
+}
+
+// Runs a query over ranges of rows of a store, a block at a time, grouping
+// the rows that meet the condition. Each thread has an executor of its own.
+class LogQuery::Executor {
+ public:
+  // The values of the group columns of a row.
+  struct Key {
+    Key() {
+      for (size_t i = 0; i < kMaxGroupColumns; ++i)
+        values[i] = 0;
+    }
+
+    bool operator<(const Key& other) const {
+      return std::lexicographical_compare(values, values + kMaxGroupColumns,
+                                          other.values,
+                                          other.values + kMaxGroupColumns);
+    }
+    bool operator==(const Key& other) const {
+      return std::equal(values, values + kMaxGroupColumns, other.values);
+    }
+
+    int64 values[kMaxGroupColumns];
+  };
+
+  struct Aggregate {
+    Aggregate() : count(0), first_time(kint64max), last_time(kint64min) {
+    }
+
+    // Merges @p other into this.
+    void Merge(const Aggregate& other) {
+      count += other.count;
+      first_time = std::min(first_time, other.first_time);
+      last_time = std::max(last_time, other.last_time);
+    }
+
+    int count;
+    int64 first_time;
+    int64 last_time;
+  };
+  typedef std::map<Key, Aggregate> GroupMap;
+
+  // @param time_base the time of the first row, that query times count
+  //     from.
+  Executor(const LogQuery& query, const LogStore& store, int64 time_base);
+
+  // Groups the rows [@p begin, @p end) that meet the condition.
+  void RunRange(int begin, int end);
+
+  const GroupMap& groups() const { return groups_; }
+  int rows_matched() const { return rows_matched_; }
+
+ private:
+  void RunBlock(int first, int num_rows);
+
+  // Clears the rows of @p selection that don't meet @p node, for the
+  // @p num_rows from @p first. Only the rows selected are tested.
+  void Evaluate(int node, int first, int num_rows, uint8* selection);
+  void EvaluateCompare(const Node& node, size_t index, int num_rows,
+                       uint8* selection);
+  void EvaluateIn(const Node& node, size_t index, int num_rows,
+                  uint8* selection);
+  void EvaluateFile(int node, size_t index, int num_rows, uint8* selection);
+  void EvaluateMessage(const Node& node, int first, int num_rows,
+                       uint8* selection);
+
+  // Compares @p num_rows of @p column to @p value by @p op, into
+  // @p selection. These loops have no branches to speak of.
+  template <class T>
+  static void CompareColumn(const T* column, Op op, int64 value,
+                            int num_rows, uint8* selection);
+
+  // @returns the value of @p column at @p index for grouping.
+  int64 GetKeyValue(ColumnId column, size_t index) const;
+
+  const LogQuery& query_;
+  const LogStore& store_;
+  int64 time_base_;
+  GroupMap groups_;
+  int rows_matched_;
+
+  // The selection of the current block, and scratch space per node.
+  std::vector<uint8> selection_;
+  std::vector<std::vector<uint8> > scratch_;
+  // Per file node, whether each file atom matches, or kUnknown.
+  static const uint8 kUnknown = 2;
+  std::vector<std::vector<uint8> > file_matches_;
+  std::vector<int> index_rows_;
+  std::string message_buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(Executor);
+};
+
+const uint8 LogQuery::Executor::kUnknown;
+
+LogQuery::Executor::Executor(const LogQuery& query,
+                             const LogStore& store,
+                             int64 time_base)
+    : query_(query), store_(store), time_base_(time_base), rows_matched_(0),
+      selection_(kBlockRows), scratch_(query.nodes_.size()),
+      file_matches_(query.nodes_.size()) {
+  for (size_t i = 0; i < query.nodes_.size(); ++i) {
+    NodeKind kind = query.nodes_[i].kind;
+    if (kind == NODE_OR || kind == NODE_NOT)
+      scratch_[i].resize(kBlockRows);
+  }
+}
+
+void LogQuery::Executor::RunRange(int begin, int end) {
+  for (int first = begin; first < end; first += kBlockRows)
+    RunBlock(first, std::min(kBlockRows, end - first));
+}
+
+void LogQuery::Executor::RunBlock(int first, int num_rows) {
+  DCHECK_LE(num_rows, kBlockRows);
+  uint8* selection = &selection_[0];
+
+  // The message index narrows the block down to its candidates.
+  const TrigramIndex* index = store_.message_index();
+  if (!query_.index_literal_.empty() && index != NULL &&
+      index->GetCandidateRows(query_.index_literal_, first,
+                              first + num_rows, &index_rows_)) {
+    std::fill(selection, selection + num_rows, 0);
+    for (size_t i = 0; i < index_rows_.size(); ++i)
+      selection[index_rows_[i] - first] = 1;
+  } else {
+    std::fill(selection, selection + num_rows, 1);
+  }
+
+  if (query_.root_ != -1)
+    Evaluate(query_.root_, first, num_rows, selection);
+
+  const std::vector<ColumnId>& group_by = query_.group_by_;
+  size_t first_index = first - store_.first_row();
+  const int64* times = store_.times() + first_index;
+  Key key;
+  GroupMap::iterator group = groups_.end();
+  for (int i = 0; i < num_rows; ++i) {
+    if (!selection[i])
+      continue;
+
+    // Neighboring rows often share a group, so the last one is checked
+    // before looking one up.
+    Key row_key;
+    for (size_t j = 0; j < group_by.size(); ++j)
+      row_key.values[j] = GetKeyValue(group_by[j], first_index + i);
+    if (group == groups_.end() || !(row_key == key)) {
+      key = row_key;
+      group = groups_.insert(std::make_pair(key, Aggregate())).first;
+    }
+
+    Aggregate& aggregate = group->second;
+    ++aggregate.count;
+    aggregate.first_time = std::min(aggregate.first_time, times[i]);
+    aggregate.last_time = std::max(aggregate.last_time, times[i]);
+    ++rows_matched_;
+  }
+}
+
+void LogQuery::Executor::Evaluate(int index,
+                                  int first,
+                                  int num_rows,
+                                  uint8* selection) {
+  const Node& node = query_.nodes_[index];
+  size_t column_index = first - store_.first_row();
+  switch (node.kind) {
+    case NODE_AND:
+      Evaluate(node.left, first, num_rows, selection);
+      if (AnySelected(selection, num_rows))
+        Evaluate(node.right, first, num_rows, selection);
+      break;
+
+    case NODE_OR: {
+      // The right operand only tests the rows the left one didn't take.
+      uint8* rest = &scratch_[index][0];
+      std::copy(selection, selection + num_rows, rest);
+      Evaluate(node.left, first, num_rows, selection);
+      for (int i = 0; i < num_rows; ++i)
+        rest[i] &= !selection[i];
+      if (AnySelected(rest, num_rows))
+        Evaluate(node.right, first, num_rows, rest);
+      for (int i = 0; i < num_rows; ++i)
+        selection[i] |= rest[i];
+      break;
+    }
+
+    case NODE_NOT: {
+      uint8* matched = &scratch_[index][0];
+      std::copy(selection, selection + num_rows, matched);
+      Evaluate(node.left, first, num_rows, matched);
+      for (int i = 0; i < num_rows; ++i)
+        selection[i] &= !matched[i];
+      break;
+    }
+
+    case NODE_COMPARE:
+    case NODE_CONTAINS:
+      if (node.column == COLUMN_FILE)
+        EvaluateFile(index, column_index, num_rows, selection);
+      else if (node.column == COLUMN_MESSAGE)
+        EvaluateMessage(node, first, num_rows, selection);
+      else
+        EvaluateCompare(node, column_index, num_rows, selection);
+      break;
+
+    case NODE_IN:
+      EvaluateIn(node, column_index, num_rows, selection);
+      break;
+
+    default:
+      NOTREACHED() << "Unknown node kind " << node.kind;
+      break;
+  }
+}
+
+template <class T>
+void LogQuery::Executor::CompareColumn(const T* column,
+                                       Op op,
+                                       int64 value,
+                                       int num_rows,
+                                       uint8* selection) {
+  switch (op) {
+    case OP_EQ:
+      for (int i = 0; i < num_rows; ++i)
+        selection[i] &= static_cast<int64>(column[i]) == value;
+      break;
+    case OP_NE:
+      for (int i = 0; i < num_rows; ++i)
+        selection[i] &= static_cast<int64>(column[i]) != value;
+      break;
+    case OP_LT:
+      for (int i = 0; i < num_rows; ++i)
+        selection[i] &= static_cast<int64>(column[i]) < value;
+      break;
+    case OP_LE:
+      for (int i = 0; i < num_rows; ++i)
+        selection[i] &= static_cast<int64>(column[i]) <= value;
+      break;
+    case OP_GT:
+      for (int i = 0; i < num_rows; ++i)
+        selection[i] &= static_cast<int64>(column[i]) > value;
+      break;
+    case OP_GE:
+      for (int i = 0; i < num_rows; ++i)
+        selection[i] &= static_cast<int64>(column[i]) >= value;
+      break;
+  }
+}
+
+void LogQuery::Executor::EvaluateCompare(const Node& node,
+                                         size_t index,
+                                         int num_rows,
+                                         uint8* selection) {
+  DCHECK_EQ(1U, node.values.size());
+  int64 value = node.values[0];
+  switch (node.column) {
+    case COLUMN_LEVEL:
+      CompareColumn(store_.levels() + index, node.op, value, num_rows,
+                    selection);
+      break;
+    case COLUMN_PID:
+      CompareColumn(store_.process_ids() + index, node.op, value, num_rows,
+                    selection);
+      break;
+    case COLUMN_TID:
+      CompareColumn(store_.thread_ids() + index, node.op, value, num_rows,
+                    selection);
+      break;
+    case COLUMN_TIME:
+      CompareColumn(store_.times() + index, node.op, time_base_ + value,
+                    num_rows, selection);
+      break;
+    case COLUMN_LINE:
+      CompareColumn(store_.lines() + index, node.op, value, num_rows,
+                    selection);
+      break;
+    default:
+      NOTREACHED() << "Not an integer column " << node.column;
+      break;
+  }
+}
+
+void LogQuery::Executor::EvaluateIn(const Node& node,
+                                    size_t index,
+                                    int num_rows,
+                                    uint8* selection) {
+  const std::vector<int64>& values = node.values;
+  for (int i = 0; i < num_rows; ++i) {
+    if (selection[i]) {
+      int64 value = GetKeyValue(node.column, index + i);
+      if (node.column == COLUMN_TIME)
+        value -= time_base_;
+      selection[i] = std::binary_search(values.begin(), values.end(), value);
+    }
+  }
+}
+
+void LogQuery::Executor::EvaluateFile(int node_index,
+                                      size_t index,
+                                      int num_rows,
+                                      uint8* selection) {
+  // File names repeat a lot, so each atom is only matched once.
+  const Node& node = query_.nodes_[node_index];
+  std::vector<uint8>& matches = file_matches_[node_index];
+  const StringTable::Atom* atoms = store_.file_atoms() + index;
+  for (int i = 0; i < num_rows; ++i) {
+    if (!selection[i])
+      continue;
+
+    StringTable::Atom atom = atoms[i];
+    if (atom >= matches.size())
+      matches.resize(atom + 1, kUnknown);
+    if (matches[atom] == kUnknown) {
+      const std::string& file = store_.file_table()->GetString(atom);
+      bool match = false;
+      if (node.kind == NODE_CONTAINS)
+        match = ContainsIgnoringCase(file, node.text);
+      else
+        match = (file == node.text) == (node.op == OP_EQ);
+      matches[atom] = match ? 1 : 0;
+    }
+    selection[i] = matches[atom];
+  }
+}
+
+void LogQuery::Executor::EvaluateMessage(const Node& node,
+                                         int first,
+                                         int num_rows,
+                                         uint8* selection) {
+  for (int i = 0; i < num_rows; ++i) {
+    if (!selection[i])
+      continue;
+
+    base::StringPiece message = store_.GetMessage(first + i,
+                                                  &message_buffer_);
+    bool match = false;
+    if (node.kind == NODE_CONTAINS)
+      match = ContainsIgnoringCase(message, node.text);
+    else
+      match = (message == node.text) == (node.op == OP_EQ);
+    selection[i] = match ? 1 : 0;
+  }
+}
+
+int64 LogQuery::Executor::GetKeyValue(ColumnId column, size_t index) const {
+  switch (column) {
+    case COLUMN_LEVEL:
+      return store_.levels()[index];
+    case COLUMN_PID:
+      return store_.process_ids()[index];
+    case COLUMN_TID:
+      return store_.thread_ids()[index];
+    case COLUMN_TIME:
+      return store_.times()[index];
+    case COLUMN_FILE:
+      return store_.file_atoms()[index];
+    case COLUMN_LINE:
+      return store_.lines()[index];
+    case COLUMN_TEMPLATE:
+      return store_.template_ids()[index];
+    default:
+      NOTREACHED() << "Can't group by column " << column;
+      return 0;
+  }
+}
+
+LogQuery::LogQuery()
+    : root_(-1), limit_(0), has_min_time_(false), min_time_(0),
+      max_threads_(std::min(TaskPool::Get()->num_workers() + 1,
+                            kMaxQueryThreads)) {
+}
+
+LogQuery::~LogQuery() {
+}
+
+bool LogQuery::Parse(const base::StringPiece& text, std::string* error) {
+  DCHECK(error != NULL);
+  nodes_.clear();
+  root_ = -1;
+  group_by_.clear();
+  limit_ = 0;
+  has_min_time_ = false;
+  min_time_ = 0;
+  index_literal_.clear();
+
+  Parser parser(text, this);
+  if (!parser.Parse(error))
+    return false;
+
+  if (root_ != -1)
+    PushDown(root_);
+  return true;
+}
+
+void LogQuery::Run(const LogStore& store, Result* result) const {
+  DCHECK(result != NULL);
+  ScopedPerfTimer timer(&query_run_counter);
+
+  *result = Result();
+  for (size_t i = 0; i < group_by_.size(); ++i)
+    result->key_names.push_back(GetColumnName(group_by_[i]));
+
+  int begin = store.first_row();
+  int end = store.num_rows();
+  int64 time_base = 0;
+  if (begin != end) {
+    result->start_time = store.GetTime(begin);
+    time_base = result->start_time.ToInternalValue();
+  }
+
+  // The rows before the earliest time a match may have can't match.
+  if (has_min_time_ && begin != end) {
+    base::Time min_time = base::Time::FromInternalValue(time_base +
+                                                        min_time_);
+    begin = std::max(begin, store.FindRowForTime(min_time));
+  }
+
+  // Hand the trailing ranges to the task pool, then run the first range
+  // ourselves, and any the pool hasn't got to by then.
+  int num_threads = std::max(1, std::min(static_cast<int>(max_threads_),
+                                         (end - begin) / kMinRowsPerThread));
+  ScopedVector<Executor> executors;
+  for (int i = 0; i < num_threads; ++i)
+    executors.push_back(new Executor(*this, store, time_base));
+
+  int range = (end - begin + num_threads - 1) / num_threads;
+  {
+    TaskPool::TaskGroup group(TaskPool::Get(),
+                              TaskPool::PRIORITY_INTERACTIVE,
+                              &query_range_counter);
+    for (int i = 1; i < num_threads; ++i) {
+      group.Post(base::Bind(&Executor::RunRange,
+                            base::Unretained(executors[i]),
+                            std::min(begin + i * range, end),
+                            std::min(begin + (i + 1) * range, end)));
+    }
+    executors[0]->RunRange(begin, std::min(begin + range, end));
+    group.Wait();
+  }
+
+  // Merge the groups of the ranges, then order them by their counts.
+  Executor::GroupMap groups;
+  for (size_t i = 0; i < executors.size(); ++i) {
+    const Executor::GroupMap& from = executors[i]->groups();
+    Executor::GroupMap::const_iterator it = from.begin();
+    for (; it != from.end(); ++it)
+      groups[it->first].Merge(it->second);
+    result->rows_matched += executors[i]->rows_matched();
+  }
+  result->rows_scanned = end - begin;
+  if (group_by_.empty() && groups.empty())
+    groups[Executor::Key()] = Executor::Aggregate();
+
+  std::vector<std::pair<int, Executor::GroupMap::const_iterator> > order;
+  Executor::GroupMap::const_iterator it = groups.begin();
+  for (; it != groups.end(); ++it)
+    order.push_back(std::make_pair(-it->second.count, it));
+  std::stable_sort(order.begin(), order.end(), FirstLess());
+
+  result->num_groups = order.size();
+  if (limit_ != 0 && order.size() > limit_)
+    order.resize(limit_);
+  for (size_t i = 0; i < order.size(); ++i) {
+    const Executor::Key& key = order[i].second->first;
+    const Executor::Aggregate& aggregate = order[i].second->second;
+    result->groups.push_back(Group());
+    Group& group = result->groups.back();
+    group.count = aggregate.count;
+    if (aggregate.count != 0) {
+      group.first_time = base::Time::FromInternalValue(aggregate.first_time);
+      group.last_time = base::Time::FromInternalValue(aggregate.last_time);
+    }
+    for (size_t j = 0; j < group_by_.size(); ++j)
+      group.keys.push_back(FormatKey(store, group_by_[j], key.values[j]));
+  }
+}
+
+std::string LogQuery::FormatResult(const Result& result) {
+  std::string text = base::StringPrintf("%10s %10s %10s", "count", "first",
+                                        "last");
+  for (size_t i = 0; i < result.key_names.size(); ++i)
+    text += "  " + result.key_names[i];
+  text += "\n";
+
+  for (size_t i = 0; i < result.groups.size(); ++i) {
+    const Group& group = result.groups[i];
+    double first = (group.first_time - result.start_time).InSecondsF();
+    double last = (group.last_time - result.start_time).InSecondsF();
+    if (group.count == 0) {
+      first = 0;
+      last = 0;
+    }
+    text += base::StringPrintf("%10d %10.3f %10.3f", group.count, first,
+                               last);
+    for (size_t j = 0; j < group.keys.size(); ++j)
+      text += "  " + group.keys[j];
+    text += "\n";
+  }
+
+  text += base::StringPrintf(
+      "%d of %d groups, %d of %d rows matched.\n",
+      static_cast<int>(result.groups.size()),
+      static_cast<int>(result.num_groups), result.rows_matched,
+      result.rows_scanned);
+  return text;
+}
+
+std::string LogQuery::FormatKey(const LogStore& store,
+                                ColumnId column,
+                                int64 value) {
+  switch (column) {
+    case COLUMN_LEVEL:
+      for (size_t i = 0; i < arraysize(kLevelNames); ++i) {
+        if (kLevelNames[i].level == value)
+          return kLevelNames[i].name;
+      }
+      break;
+
+    case COLUMN_FILE:
+      return store.file_table()->GetString(
+          static_cast<StringTable::Atom>(value));
+
+    case COLUMN_TEMPLATE: {
+      MessageTemplates::TemplateId id =
+          static_cast<MessageTemplates::TemplateId>(value);
+      if (id == MessageTemplates::kNoTemplate)
+        return "(no template)";
+
+      // Star out the parameters.
+      std::string text = store.message_templates().GetTemplate(id)
+          .as_string();
+      std::replace(text.begin(), text.end(),
+                   MessageTemplates::kParameterMarker, '*');
+      return text;
+    }
+
+    default:
+      break;
+  }
+
+  return base::Int64ToString(value);
+}
+
+const char* LogQuery::GetColumnName(ColumnId column) {
+  switch (column) {
+    case COLUMN_LEVEL:
+      return "level";
+    case COLUMN_PID:
+      return "pid";
+    case COLUMN_TID:
+      return "tid";
+    case COLUMN_TIME:
+      return "time";
+    case COLUMN_FILE:
+      return "file";
+    case COLUMN_LINE:
+      return "line";
+    case COLUMN_MESSAGE:
+      return "message";
+    case COLUMN_TEMPLATE:
+      return "template";
+  }
+  NOTREACHED() << "Unknown column " << column;
+  return "";
+}
+
+void LogQuery::PushDown(int index) {
+  const Node& node = nodes_[index];
+  if (node.kind == NODE_AND) {
+    PushDown(node.left);
+    PushDown(node.right);
+    return;
+  }
+
+  // A row before the first at a time is earlier than it.
+  if (node.kind == NODE_COMPARE && node.column == COLUMN_TIME &&
+      (node.op == OP_EQ || node.op == OP_GT || node.op == OP_GE)) {
+    min_time_ = has_min_time_ ? std::max(min_time_, node.values[0]) :
+        node.values[0];
+    has_min_time_ = true;
+  }
+
+  // The longest literal narrows the index candidates down the most.
+  if (node.kind == NODE_CONTAINS && node.column == COLUMN_MESSAGE &&
+      node.text.size() >= TrigramIndex::kMinLiteralLength &&
+      node.text.size() > index_literal_.size()) {
+    index_literal_ = node.text;
+  }
+}
@@ -0,0 +1,198 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log query declaration.
+#ifndef SAWBUCK_VIEWER_LOG_QUERY_H_
+#define SAWBUCK_VIEWER_LOG_QUERY_H_
+
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+
+class LogStore;
+
+// A query over the rows of a log store, in a small language of its own
+//
+//   [SELECT] COUNT [BY column, ...] [WHERE condition] [LIMIT n]
+//
+// e.g. "count by file where level <= warning and pid in (12, 34)". The
+// columns are level, pid, tid, time, file, line and message, and a query
+// may group by up to kMaxGroupColumns of them, but for time and message,
+// or by template, the message with its parameters starred out.
+// Conditions combine comparisons with AND, OR, NOT and parentheses, where
+// a comparison is one of
+//
+//   column = != < <= > >= value
+//   column IN (value, ...)
+//   column BETWEEN value AND value
+//   column CONTAINS 'text'
+//
+// Levels compare by number, so "level <= warning" are the warnings and
+// worse, and may be given by name. Times are in seconds from the first row
+// retained. The file and message compare as strings, CONTAINS ignoring
+// ASCII case. Keywords and level names are case insensitive too.
+//
+// Parsing yields a plan, whose top level conjuncts are pushed down to the
+// store where it can take them: a lower bound on time narrows the rows to
+// scan through the store's time index, and a message CONTAINS narrows each
+// block of rows to the candidates of the message index, if any. The rest
+// of the condition runs a block of rows at a time, each integer comparison
+// a tight loop over a column of the block, and each string comparison
+// over the rows of the block still in the running. Large scans are split
+// into row ranges that are grouped in parallel on the task pool, then the
+// groups of the ranges are merged.
+// @note the store must not change while a query runs.
+class LogQuery {
+ public:
+  // The most columns a query may group by.
+  static const size_t kMaxGroupColumns = 4;
+  // The number of rows evaluated at a time.
+  static const int kBlockRows = 256;
+
+  // A group of the rows that met the condition.
+  struct Group {
+    Group() : count(0) {
+    }
+
+    // The values of the group's BY columns.
+    std::vector<std::string> keys;
+    int count;
+    // The earliest and latest times of the group's rows.
+    base::Time first_time;
+    base::Time last_time;
+  };
+
+  struct Result {
+    Result() : num_groups(0), rows_scanned(0), rows_matched(0) {
+    }
+
+    // The names of the BY columns.
+    std::vector<std::string> key_names;
+    // The groups by descending count, up to the query's limit. A query
+    // that doesn't group has a single group, of all rows matched.
+    std::vector<Group> groups;
+    // The number of groups before the limit.
+    size_t num_groups;
+    // The time of the first row retained, which query times count from.
+    base::Time start_time;
+    int rows_scanned;
+    int rows_matched;
+  };
+
+  LogQuery();
+  ~LogQuery();
+
+  // Parses @p text into the query's plan.
+  // @param error on failure receives a description of the problem.
+  // @returns true on success.
+  bool Parse(const base::StringPiece& text, std::string* error);
+
+  // Runs the query over the retained rows of @p store into @p result.
+  // @pre Parse succeeded.
+  void Run(const LogStore& store, Result* result) const;
+
+  // Formats @p result as a table, a line per group, with the times in
+  // seconds from the result's start time.
+  static std::string FormatResult(const Result& result);
+
+  // Limits the threads a query runs on, including the caller's. Defaults
+  // to the number of pool workers and the caller.
+  void set_max_threads(size_t max_threads) { max_threads_ = max_threads; }
+
+ private:
+  class Executor;
+  class Parser;
+
+  enum ColumnId {
+    COLUMN_LEVEL,
+    COLUMN_PID,
+    COLUMN_TID,
+    COLUMN_TIME,
+    COLUMN_FILE,
+    COLUMN_LINE,
+    COLUMN_MESSAGE,
+    // Only to group by.
+    COLUMN_TEMPLATE,
+  };
+
+  enum NodeKind {
+    NODE_AND,
+    NODE_OR,
+    NODE_NOT,
+    // Compares a column to a value by op.
+    NODE_COMPARE,
+    // Tests an integer column for any of a set of values.
+    NODE_IN,
+    // Tests a string column for a substring.
+    NODE_CONTAINS,
+  };
+
+  enum Op {
+    OP_EQ,
+    OP_NE,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+  };
+
+  // A node of the condition tree.
+  struct Node {
+    Node();
+
+    NodeKind kind;
+    // The operands, for AND, OR and NOT, which only has a left operand.
+    int left;
+    int right;
+    ColumnId column;
+    Op op;
+    // The value to compare to, or the sorted values of an IN. Times are
+    // in microseconds from the first row.
+    std::vector<int64> values;
+    // The string to compare to, or to find.
+    std::string text;
+  };
+
+  // @returns the name of @p column.
+  static const char* GetColumnName(ColumnId column);
+  // @returns the text of @p value of @p column.
+  static std::string FormatKey(const LogStore& store,
+                               ColumnId column,
+                               int64 value);
+
+  // Pushes down the top level conjuncts under @p node that the store can
+  // take.
+  void PushDown(int node);
+
+  // The condition's nodes, children before parents, and the root, or -1
+  // for all rows.
+  std::vector<Node> nodes_;
+  int root_;
+  std::vector<ColumnId> group_by_;
+  size_t limit_;
+
+  // The conjuncts pushed down: the earliest time a row may have to meet
+  // the condition, and a string every matching message contains.
+  bool has_min_time_;
+  int64 min_time_;
+  std::string index_literal_;
+
+  size_t max_threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogQuery);
+};
+
+#endif  // SAWBUCK_VIEWER_LOG_QUERY_H_
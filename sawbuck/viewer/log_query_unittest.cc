@@ -0,0 +1,217 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log query unittests.
+#include "sawbuck/viewer/log_query.h"
+
+#include <evntrace.h>
+#include "base/strings/stringprintf.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/log_store.h"
+
+namespace {
+
+const int kNumRows = 1000;
+
+class LogQueryTest : public testing::Test {
+ public:
+  LogQueryTest() : store_(&file_table_) {
+  }
+
+  virtual void SetUp() {
+    // Rows 10 ms apart, from three processes, every tenth a warning and
+    // every hundredth an error, from two files.
+    start_ = base::Time::Now();
+    atoms_[0] = file_table_.Intern("foo.cc");
+    atoms_[1] = file_table_.Intern("bar.cc");
+    for (int i = 0; i < kNumRows; ++i) {
+      UCHAR level = TRACE_LEVEL_INFORMATION;
+      if (i % 100 == 0)
+        level = TRACE_LEVEL_ERROR;
+      else if (i % 10 == 0)
+        level = TRACE_LEVEL_WARNING;
+      std::string message = base::StringPrintf("Opened file %d", i);
+      if (i % 2 == 1)
+        message = base::StringPrintf("Closed FILE %d", i);
+      store_.AddRow(level, 1 + i % 3, 100, start_ + Ms(10 * i),
+                    atoms_[i % 2], i, message, 0, NULL);
+    }
+  }
+
+  // Runs @p text, expecting it to parse.
+  void Run(const char* text, LogQuery::Result* result) {
+    LogQuery query;
+    std::string error;
+    ASSERT_TRUE(query.Parse(text, &error)) << error;
+    query.Run(store_, result);
+  }
+
+  // @returns the count of the single group of @p text.
+  int Count(const char* text) {
+    LogQuery::Result result;
+    Run(text, &result);
+    EXPECT_EQ(1U, result.groups.size());
+    return result.groups.empty() ? -1 : result.groups[0].count;
+  }
+
+  static base::TimeDelta Ms(int64 ms) {
+    return base::TimeDelta::FromMilliseconds(ms);
+  }
+
+ protected:
+  base::Time start_;
+  StringTable::Atom atoms_[2];
+  StringTable file_table_;
+  LogStore store_;
+};
+
+TEST_F(LogQueryTest, Count) {
+  LogQuery::Result result;
+  Run("COUNT", &result);
+  ASSERT_EQ(1U, result.groups.size());
+  EXPECT_EQ(kNumRows, result.groups[0].count);
+  EXPECT_EQ(start_, result.groups[0].first_time);
+  EXPECT_EQ(start_ + Ms(10 * (kNumRows - 1)), result.groups[0].last_time);
+  EXPECT_EQ(kNumRows, result.rows_matched);
+
+  EXPECT_EQ(kNumRows, Count("select count(*)"));
+  EXPECT_EQ(0, Count("count where pid = 7"));
+}
+
+TEST_F(LogQueryTest, Comparisons) {
+  EXPECT_EQ(10, Count("count where level = error"));
+  EXPECT_EQ(100, Count("count where level <= WARNING"));
+  EXPECT_EQ(900, Count("count where level > 3"));
+  EXPECT_EQ(667, Count("count where pid != 3"));
+  EXPECT_EQ(667, Count("count where pid in (1, 2)"));
+  EXPECT_EQ(11, Count("count where line between 10 and 20"));
+  EXPECT_EQ(500, Count("count where file = 'foo.cc'"));
+  EXPECT_EQ(500, Count("count where file contains 'BAR'"));
+  EXPECT_EQ(500, Count("count where message contains 'closed file'"));
+  EXPECT_EQ(1, Count("count where message = 'Opened file 10'"));
+}
+
+TEST_F(LogQueryTest, Times) {
+  // The times count in seconds from the first row.
+  EXPECT_EQ(100, Count("count where time < 1"));
+  EXPECT_EQ(151, Count("count where time between 1 and 2.5"));
+  EXPECT_EQ(kNumRows - 995, Count("count where time >= 9.95"));
+}
+
+TEST_F(LogQueryTest, Conditions) {
+  EXPECT_EQ(10, Count("count where level = error and pid in (1, 2, 3)"));
+  EXPECT_EQ(60, Count("count where level = warning and not pid = 1"));
+  EXPECT_EQ(364, Count("count where pid = 1 or level = warning and "
+                       "line >= 500"));
+  EXPECT_EQ(227, Count("count where (pid = 1 or level = warning) and "
+                       "not (file = 'bar.cc' and pid = 1)"));
+}
+
+TEST_F(LogQueryTest, MessageIndex) {
+  // The index narrows down the rows, the results are the same.
+  int without_index = Count("count where message contains 'file 12' and "
+                            "level = info");
+  store_.EnableMessageIndex();
+  EXPECT_EQ(without_index,
+            Count("count where message contains 'file 12' and "
+                  "level = info"));
+  EXPECT_EQ(10, without_index);
+}
+
+TEST_F(LogQueryTest, GroupBy) {
+  LogQuery::Result result;
+  Run("count by level, file where level <= warning", &result);
+  ASSERT_EQ(2U, result.key_names.size());
+  EXPECT_EQ("level", result.key_names[0]);
+  EXPECT_EQ("file", result.key_names[1]);
+
+  // The warnings and errors are all on even rows, so from foo.cc.
+  ASSERT_EQ(2U, result.groups.size());
+  EXPECT_EQ(90, result.groups[0].count);
+  EXPECT_EQ("WARNING", result.groups[0].keys[0]);
+  EXPECT_EQ("foo.cc", result.groups[0].keys[1]);
+  EXPECT_EQ(10, result.groups[1].count);
+  EXPECT_EQ("ERROR", result.groups[1].keys[0]);
+  EXPECT_EQ(start_, result.groups[1].first_time);
+
+  Run("count by template limit 1", &result);
+  ASSERT_EQ(1U, result.groups.size());
+  EXPECT_EQ(2U, result.num_groups);
+  EXPECT_EQ(500, result.groups[0].count);
+
+  std::string text = LogQuery::FormatResult(result);
+  EXPECT_NE(std::string::npos, text.find("1 of 2 groups"));
+}
+
+TEST_F(LogQueryTest, Parallel) {
+  // Enough rows to spread over several threads.
+  for (int i = kNumRows; i < 100 * kNumRows; ++i) {
+    store_.AddRow(TRACE_LEVEL_INFORMATION, 1 + i % 3, 100,
+                  start_ + Ms(10 * i), atoms_[i % 2], i, "", 0, NULL);
+  }
+
+  LogQuery query;
+  std::string error;
+  ASSERT_TRUE(query.Parse("count by pid where line >= 500", &error));
+  LogQuery::Result serial;
+  query.set_max_threads(1);
+  query.Run(store_, &serial);
+  LogQuery::Result parallel;
+  query.set_max_threads(4);
+  query.Run(store_, &parallel);
+
+  ASSERT_EQ(3U, serial.groups.size());
+  ASSERT_EQ(serial.groups.size(), parallel.groups.size());
+  for (size_t i = 0; i < serial.groups.size(); ++i) {
+    EXPECT_EQ(serial.groups[i].keys, parallel.groups[i].keys);
+    EXPECT_EQ(serial.groups[i].count, parallel.groups[i].count);
+    EXPECT_EQ(serial.groups[i].first_time, parallel.groups[i].first_time);
+    EXPECT_EQ(serial.groups[i].last_time, parallel.groups[i].last_time);
+  }
+  EXPECT_EQ(100 * kNumRows - 500, parallel.rows_matched);
+}
+
+TEST_F(LogQueryTest, ParseErrors) {
+  static const char* kBadQueries[] = {
+    "",
+    "count by",
+    "count by time",
+    "count where",
+    "count where pid",
+    "count where pid = 'foo'",
+    "count where file < 'foo'",
+    "count where level = loud",
+    "count where pid in (1, 2",
+    "count where (pid = 1",
+    "count where message contains 'unterminated",
+    "count where template = 1",
+    "count where line = 1.5",
+    "count limit 0",
+    "count where pid = 1 garbage",
+    "count where pid = 1 ;",
+  };
+  for (size_t i = 0; i < arraysize(kBadQueries); ++i) {
+    LogQuery query;
+    std::string error;
+    EXPECT_FALSE(query.Parse(kBadQueries[i], &error)) << kBadQueries[i];
+    EXPECT_FALSE(error.empty());
+  }
+
+  LogQuery query;
+  std::string error;
+  EXPECT_FALSE(query.Parse("count where pid = x", &error));
+  EXPECT_EQ("Expected a number at position 19.", error);
+}
+
+}  // namespace
@@ -0,0 +1,914 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Columnar log store implementation.
+#include "sawbuck/viewer/log_store.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "sawbuck/common/memory_footprint.h"
+#include "sawbuck/common/perf_counters.h"
+#include "sawbuck/viewer/duplicate_row_filter.h"
+#include "third_party/zlib/zlib.h"
+#include "pcrecpp.h"  // NOLINT
+
+namespace {
+
+PerfCounter append_row_counter("Store.AppendRow", 64);
+PerfCounter seal_segment_counter("Store.SealSegment", 1);
+PerfCounter unseal_segment_counter("Store.UnsealSegment", 1);
+
+// A regular expression that matches "[<stuff>:<file>(<line>)].message"
+// and extracts the file/line/message parts.
+const pcrecpp::RE kFileRe("\\[[^\\]]*\\:([^:]+)\\((\\d+)\\)\\].(.*\\w).*",
+                          PCRE_NEWLINE_ANYCRLF | PCRE_DOTALL | PCRE_UTF8);
+
+// The bytes each row takes in the columns, over its message and trace.
+const size_t kRowColumnBytes = sizeof(UCHAR) + 2 * sizeof(DWORD) +
+    sizeof(int64) + sizeof(StringTable::Atom) + sizeof(int32) +
+    sizeof(StringArena::Ref) + sizeof(MessageTemplates::TemplateId) +
+    sizeof(StackTracePool::StackId);
+
+// Erases the first @p count entries of @p column.
+template <class T>
+void ErasePrefix(size_t count, std::vector<T>* column) {
+  DCHECK_LE(count, column->size());
+  column->erase(column->begin(), column->begin() + count);
+}
+
+}  // namespace
+
+const size_t StringArena::kBlockSize;
+const int LogStore::kEvictionChunkDivisor;
+const int LogStore::kRowsPerSegment;
+const size_t LogStore::kTimeIndexInterval;
+const size_t LogStore::kMaxCachedSegments;
+const uint32 LogStore::kSealedBlock;
+const char LogStore::kLossMarkerFile[] = "<data lost>";
+
+StringArena::StringArena() : current_block_(kNoBlock), allocated_bytes_(0) {
+}
+
+StringArena::~StringArena() {
+  Clear();
+}
+
+StringArena::Ref StringArena::Append(const char* str, size_t len) {
+  DCHECK(str != NULL || len == 0);
+
+  // Oversize strings get a block of their own, and leave the current
+  // block to be filled further.
+  if (len > kBlockSize) {
+    Block block = { new char[len], len, len, 1 };
+    memcpy(block.data, str, len);
+    allocated_bytes_ += len;
+    blocks_.push_back(block);
+
+    Ref ref;
+    ref.block = blocks_.size() - 1;
+    ref.offset = 0;
+    ref.length = len;
+    return ref;
+  }
+
+  if (current_block_ == kNoBlock ||
+      blocks_[current_block_].size - blocks_[current_block_].used < len) {
+    // A block all released while current is freed as we move on.
+    if (current_block_ != kNoBlock && blocks_[current_block_].live == 0)
+      FreeBlock(&blocks_[current_block_]);
+
+    Block block = { new char[kBlockSize], 0, kBlockSize, 0 };
+    allocated_bytes_ += kBlockSize;
+    blocks_.push_back(block);
+    current_block_ = blocks_.size() - 1;
+  }
+
+  Block& block = blocks_[current_block_];
+  memcpy(block.data + block.used, str, len);
+
+  Ref ref;
+  ref.block = current_block_;
+  ref.offset = block.used;
+  ref.length = len;
+
+  block.used += len;
+  ++block.live;
+
+  return ref;
+}
+
+base::StringPiece StringArena::Get(const Ref& ref) const {
+  if (ref.length == 0)
+    return base::StringPiece();
+
+  DCHECK_LT(ref.block, blocks_.size());
+  const Block& block = blocks_[ref.block];
+  DCHECK(block.data != NULL);
+  DCHECK_LE(ref.offset + ref.length, block.used);
+
+  return base::StringPiece(block.data + ref.offset, ref.length);
+}
+
+void StringArena::Release(const Ref& ref) {
+  DCHECK_LT(ref.block, blocks_.size());
+  Block& block = blocks_[ref.block];
+  DCHECK(block.data != NULL);
+  DCHECK_LT(0U, block.live);
+
+  // The current block may yet take more strings.
+  if (--block.live == 0 && ref.block != current_block_)
+    FreeBlock(&block);
+}
+
+void StringArena::FreeBlock(Block* block) {
+  DCHECK(block != NULL);
+  DCHECK(block->data != NULL);
+
+  delete [] block->data;
+  block->data = NULL;
+  allocated_bytes_ -= block->size;
+}
+
+void StringArena::Clear() {
+  for (size_t i = 0; i < blocks_.size(); ++i)
+    delete [] blocks_[i].data;
+
+  blocks_.clear();
+  current_block_ = kNoBlock;
+  allocated_bytes_ = 0;
+}
+
+LogStore::LogStore(StringTable* file_table)
+    : collapse_repeats_(false), file_table_(file_table),
+      next_unsealed_row_(0), hot_rows_(0), first_row_(0),
+      retained_bytes_(0) {
+  DCHECK(file_table != NULL);
+  loss_marker_file_ = file_table_->Intern(kLossMarkerFile);
+}
+
+LogStore::~LogStore() {
+}
+
+int LogStore::AddRow(UCHAR level,
+                     DWORD process_id,
+                     DWORD thread_id,
+                     const base::Time& time,
+                     StringTable::Atom file,
+                     int line,
+                     const base::StringPiece& message,
+                     size_t trace_depth,
+                     const sym_util::Address* traces) {
+  DCHECK(traces != NULL || trace_depth == 0);
+  ScopedPerfTimer timer(&append_row_counter);
+
+  bool collapse = collapse_repeats_ && file != loss_marker_file_;
+  if (collapse) {
+    int repeated = FindRepeatedRow(level, process_id, thread_id, file, line,
+                                   message, trace_depth, traces);
+    if (repeated != -1) {
+      Repeat& repeat = repeats_[repeated];
+      ++repeat.extra_count;
+      repeat.last_time = time.ToInternalValue();
+      return repeated;
+    }
+  }
+
+  int row = num_rows();
+
+  levels_.push_back(level);
+  process_ids_.push_back(process_id);
+  thread_ids_.push_back(thread_id);
+  times_.push_back(time.ToInternalValue());
+  file_atoms_.push_back(file);
+  lines_.push_back(line);
+  if (times_.size() % kTimeIndexInterval == 0)
+    ExtendTimeIndex();
+  volume_histogram_.Add(times_.back(), level);
+  severity_postings_.AddRow(level);
+  process_postings_.AddRow(process_id);
+  if (file == loss_marker_file_)
+    loss_marker_rows_.push_back(row);
+
+  // Messages that don't split losslessly are stored whole.
+  if (MessageTemplates::Split(message, MessageTemplates::kParameterMarker,
+                              &template_buffer_, &parameter_buffer_)) {
+    template_ids_.push_back(message_templates_.Intern(template_buffer_));
+    messages_.push_back(message_arena_.Append(parameter_buffer_.data(),
+                                              parameter_buffer_.size()));
+  } else {
+    template_ids_.push_back(MessageTemplates::kNoTemplate);
+    messages_.push_back(message_arena_.Append(message.data(),
+                                              message.size()));
+  }
+  if (message_index_.get() != NULL)
+    message_index_->AddRow(message);
+
+  stack_ids_.push_back(stack_pool_.Intern(traces, trace_depth));
+
+  retained_bytes_ += GetRowBytes(levels_.size() - 1);
+  if (collapse)
+    last_thread_rows_[thread_id] = row;
+  EnforceRetention();
+  if (hot_rows_ != 0)
+    SealColdRows();
+
+  return row;
+}
+
+int LogStore::FindRepeatedRow(UCHAR level,
+                              DWORD process_id,
+                              DWORD thread_id,
+                              StringTable::Atom file,
+                              int line,
+                              const base::StringPiece& message,
+                              size_t trace_depth,
+                              const sym_util::Address* traces) const {
+  ThreadRowMap::const_iterator it = last_thread_rows_.find(thread_id);
+  if (it == last_thread_rows_.end() || it->second < first_row_)
+    return -1;
+
+  // Compare the cheap columns first, the message last.
+  int row = it->second;
+  size_t index = GetIndex(row);
+  if (levels_[index] != level || process_ids_[index] != process_id ||
+      file_atoms_[index] != file || lines_[index] != line) {
+    return -1;
+  }
+
+  StackTracePool::StackId stack_id = stack_ids_[index];
+  if (stack_pool_.GetDepth(stack_id) != trace_depth ||
+      stack_pool_.Find(traces, trace_depth) != stack_id) {
+    return -1;
+  }
+
+  std::string buffer;
+  if (GetMessage(row, &buffer) != message)
+    return -1;
+
+  return row;
+}
+
+const sym_util::Address* LogStore::WidenTrace(size_t trace_depth,
+                                              void* const* traces) {
+  if (trace_depth == 0)
+    return NULL;
+
+  trace_buffer_.resize(trace_depth);
+  for (size_t i = 0; i < trace_depth; ++i)
+    trace_buffer_[i] = reinterpret_cast<uintptr_t>(traces[i]);
+  return &trace_buffer_[0];
+}
+
+int LogStore::AddLogMessage(const LogEvents::LogMessage& log_message) {
+  StringTable::Atom file = StringTable::kEmptyAtom;
+  int line = 0;
+  base::StringPiece message;
+  ParseLogMessage(log_message, file_table_, &file, &line, &message);
+
+  return AddRow(log_message.level,
+                log_message.process_id,
+                log_message.thread_id,
+                log_message.time,
+                file,
+                line,
+                message,
+                log_message.trace_depth,
+                WidenTrace(log_message.trace_depth, log_message.traces));
+}
+
+int LogStore::AddTraceMessage(const char* type,
+                              const TraceEvents::TraceMessage& trace_message) {
+  return AddRow(trace_message.level,
+                trace_message.process_id,
+                trace_message.thread_id,
+                trace_message.time,
+                StringTable::kEmptyAtom,
+                0,
+                FormatTraceMessage(type, trace_message),
+                trace_message.trace_depth,
+                WidenTrace(trace_message.trace_depth, trace_message.traces));
+}
+
+int LogStore::AddLossMarker(const LogEvents::EventLoss& event_loss) {
+  return AddRow(TRACE_LEVEL_WARNING,
+                0,
+                0,
+                event_loss.time,
+                loss_marker_file_,
+                0,
+                FormatEventLoss(event_loss),
+                0,
+                NULL);
+}
+
+int LogStore::AppendRow(const LogStore& source, int row) {
+  DCHECK_EQ(file_table_, source.file_table_);
+
+  size_t index = source.GetIndex(row);
+  StackTracePool::StackId stack_id = source.stack_ids_[index];
+  source.stack_pool_.GetFrames(stack_id, &trace_buffer_);
+  std::string buffer;
+
+  int new_row = AddRow(source.levels_[index],
+                       source.process_ids_[index],
+                       source.thread_ids_[index],
+                       source.GetTime(row),
+                       source.file_atoms_[index],
+                       source.lines_[index],
+                       source.GetMessage(row, &buffer),
+                       trace_buffer_.size(),
+                       trace_buffer_.empty() ? NULL : &trace_buffer_[0]);
+
+  RepeatMap::const_iterator it = source.repeats_.find(row);
+  if (it != source.repeats_.end()) {
+    Repeat& repeat = repeats_[new_row];
+    repeat.extra_count += it->second.extra_count;
+    repeat.last_time = std::max(repeat.last_time, it->second.last_time);
+  }
+
+  return new_row;
+}
+
+size_t LogStore::MergeFrom(const std::vector<const LogStore*>& sources,
+                           bool drop_duplicates) {
+  // A min-heap of the next row time of each source, ties go to the
+  // lower source index.
+  typedef std::pair<int64, size_t> Entry;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > heap;
+  std::vector<int> next_rows(sources.size(), 0);
+
+  // Only the rows in the overlap of the sources' spans are looked at for
+  // duplicates.
+  DuplicateRowFilter duplicates(sources.size());
+  size_t num_spans = 0;
+  size_t total_rows = levels_.size();
+  for (size_t i = 0; i < sources.size(); ++i) {
+    DCHECK(sources[i] != this);
+    next_rows[i] = sources[i]->first_row_;
+    if (!sources[i]->times_.empty()) {
+      heap.push(Entry(sources[i]->times_[0], i));
+      duplicates.SetSourceSpan(i, sources[i]->times_.front(),
+                               sources[i]->times_.back());
+      ++num_spans;
+    }
+    total_rows += sources[i]->times_.size();
+  }
+  drop_duplicates = drop_duplicates && num_spans > 1;
+  size_t num_dropped = 0;
+
+  levels_.reserve(total_rows);
+  process_ids_.reserve(total_rows);
+  thread_ids_.reserve(total_rows);
+  times_.reserve(total_rows);
+  file_atoms_.reserve(total_rows);
+  lines_.reserve(total_rows);
+  messages_.reserve(total_rows);
+  template_ids_.reserve(total_rows);
+  stack_ids_.reserve(total_rows);
+
+  while (!heap.empty()) {
+    size_t source = heap.top().second;
+    heap.pop();
+
+    const LogStore* store = sources[source];
+    int row = next_rows[source]++;
+    int64 time = store->times_[store->GetIndex(row)];
+
+    // Each source's loss markers are its own.
+    bool duplicate = false;
+    if (drop_duplicates && duplicates.InOverlap(source, time) &&
+        !store->IsLossMarker(row)) {
+      DuplicateRowFilter::Fingerprint fingerprint;
+      DuplicateRowFilter::GetFingerprint(*store, row, &fingerprint);
+      duplicate = duplicates.IsDuplicate(source, time, fingerprint);
+    }
+    if (duplicate)
+      ++num_dropped;
+    else
+      AppendRow(*store, row);
+
+    if (row + 1 < store->num_rows()) {
+      size_t next = store->GetIndex(row + 1);
+      DCHECK_LE(store->times_[next - 1], store->times_[next]);
+      heap.push(Entry(store->times_[next], source));
+    }
+  }
+
+  return num_dropped;
+}
+
+void LogStore::Clear() {
+  // Swap the columns out to release their storage, clear() would
+  // leave the capacity in place.
+  std::vector<UCHAR>().swap(levels_);
+  std::vector<DWORD>().swap(process_ids_);
+  std::vector<DWORD>().swap(thread_ids_);
+  std::vector<int64>().swap(times_);
+  std::vector<int64>().swap(time_index_);
+  volume_histogram_.Clear();
+  std::vector<StringTable::Atom>().swap(file_atoms_);
+  std::vector<int32>().swap(lines_);
+  std::vector<StringArena::Ref>().swap(messages_);
+  std::vector<MessageTemplates::TemplateId>().swap(template_ids_);
+  message_templates_.Clear();
+  std::vector<StackTracePool::StackId>().swap(stack_ids_);
+  stack_pool_.Clear();
+  first_row_ = 0;
+  retained_bytes_ = 0;
+  repeats_.clear();
+  last_thread_rows_.clear();
+
+  message_arena_.Clear();
+  std::deque<Segment>().swap(segments_);
+  next_unsealed_row_ = 0;
+  {
+    base::AutoLock lock(cache_lock_);
+    cached_segments_.clear();
+  }
+  if (message_index_.get() != NULL)
+    message_index_->Clear();
+  severity_postings_.Clear();
+  process_postings_.Clear();
+  std::vector<int>().swap(loss_marker_rows_);
+}
+
+void LogStore::set_retention(const Retention& retention) {
+  retention_ = retention;
+  EnforceRetention();
+}
+
+void LogStore::EnableMessageIndex() {
+  if (message_index_.get() != NULL)
+    return;
+
+  message_index_.reset(new TrigramIndex());
+  message_index_->EvictRowsBefore(first_row_);
+  std::string buffer;
+  for (int row = first_row_; row < num_rows(); ++row)
+    message_index_->AddRow(GetMessage(row, &buffer));
+}
+
+size_t LogStore::GetIndex(int row) const {
+  DCHECK_LE(first_row_, row);
+  DCHECK_LT(row, num_rows());
+  return row - first_row_;
+}
+
+size_t LogStore::GetRowBytes(size_t index) const {
+  DCHECK_LT(index, levels_.size());
+  return kRowColumnBytes + messages_[index].length;
+}
+
+void LogStore::EnforceRetention() {
+  size_t retained = levels_.size();
+  if (retained < 2)
+    return;
+
+  // Count the oldest rows past any of the limits, this is a single test
+  // while the store is within them.
+  bool has_max_age = retention_.max_age > base::TimeDelta();
+  int64 oldest_time = times_.back() - retention_.max_age.ToInternalValue();
+  size_t bytes = retained_bytes();
+  size_t count = 0;
+  // The references to each template and trace the rows counted hold, as
+  // their bytes only go with their last reference.
+  std::map<MessageTemplates::TemplateId, size_t> released_templates;
+  std::map<StackTracePool::StackId, size_t> released;
+  while (count + 1 < retained) {
+    if ((retention_.max_rows == 0 ||
+         retained - count <= retention_.max_rows) &&
+        (retention_.max_bytes == 0 || bytes <= retention_.max_bytes) &&
+        (!has_max_age || times_[count] >= oldest_time)) {
+      break;
+    }
+
+    bytes -= GetRowBytes(count);
+    MessageTemplates::TemplateId template_id = template_ids_[count];
+    if (template_id != MessageTemplates::kNoTemplate &&
+        ++released_templates[template_id] ==
+            message_templates_.GetRefCount(template_id)) {
+      bytes -= message_templates_.GetBytes(template_id);
+    }
+    StackTracePool::StackId stack_id = stack_ids_[count];
+    if (stack_id != StackTracePool::kEmptyStack &&
+        ++released[stack_id] == stack_pool_.GetRefCount(stack_id)) {
+      bytes -= stack_pool_.GetBytes(stack_id);
+    }
+    ++count;
+  }
+
+  if (count == 0)
+    return;
+
+  count = std::max(count, retained / kEvictionChunkDivisor);
+  EvictRows(std::min(count, retained - 1));
+}
+
+void LogStore::EvictRows(size_t count) {
+  DCHECK_LT(count, levels_.size());
+
+  for (size_t i = 0; i < count; ++i) {
+    retained_bytes_ -= GetRowBytes(i);
+    volume_histogram_.Remove(times_[i], levels_[i]);
+    if (messages_[i].block != kSealedBlock)
+      message_arena_.Release(messages_[i]);
+    if (template_ids_[i] != MessageTemplates::kNoTemplate)
+      message_templates_.Release(template_ids_[i]);
+    stack_pool_.Release(stack_ids_[i]);
+  }
+
+  ErasePrefix(count, &levels_);
+  ErasePrefix(count, &process_ids_);
+  ErasePrefix(count, &thread_ids_);
+  ErasePrefix(count, &times_);
+  ErasePrefix(count, &file_atoms_);
+  ErasePrefix(count, &lines_);
+  ErasePrefix(count, &messages_);
+  ErasePrefix(count, &template_ids_);
+
+  ErasePrefix(count, &stack_ids_);
+
+  // The intervals shift with the rows, so the index is rebuilt.
+  time_index_.clear();
+  ExtendTimeIndex();
+
+  first_row_ += static_cast<int>(count);
+
+  // Drop the segments whose rows are all gone, and their cached data.
+  while (!segments_.empty() &&
+         segments_.front().first_row + kRowsPerSegment <= first_row_) {
+    int segment_row = segments_.front().first_row;
+    segments_.pop_front();
+
+    base::AutoLock lock(cache_lock_);
+    std::list<CachedSegment>::iterator it = cached_segments_.begin();
+    while (it != cached_segments_.end()) {
+      if (it->first_row == segment_row)
+        it = cached_segments_.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  repeats_.erase(repeats_.begin(), repeats_.lower_bound(first_row_));
+  ThreadRowMap::iterator it = last_thread_rows_.begin();
+  while (it != last_thread_rows_.end()) {
+    if (it->second < first_row_)
+      last_thread_rows_.erase(it++);
+    else
+      ++it;
+  }
+
+  if (message_index_.get() != NULL)
+    message_index_->EvictRowsBefore(first_row_);
+  severity_postings_.EvictRowsBefore(first_row_);
+  process_postings_.EvictRowsBefore(first_row_);
+  loss_marker_rows_.erase(loss_marker_rows_.begin(),
+                          std::lower_bound(loss_marker_rows_.begin(),
+                                           loss_marker_rows_.end(),
+                                           first_row_));
+}
+
+void LogStore::ExtendTimeIndex() {
+  size_t intervals = times_.size() / kTimeIndexInterval;
+  while (time_index_.size() < intervals) {
+    std::vector<int64>::const_iterator begin(
+        times_.begin() + time_index_.size() * kTimeIndexInterval);
+    int64 latest = *std::max_element(begin, begin + kTimeIndexInterval);
+    if (!time_index_.empty())
+      latest = std::max(latest, time_index_.back());
+    time_index_.push_back(latest);
+  }
+}
+
+void LogStore::SealColdRows() {
+  DCHECK_NE(0U, hot_rows_);
+
+  // Evicted rows needn't be sealed.
+  next_unsealed_row_ = std::max(next_unsealed_row_, first_row_);
+  while (static_cast<size_t>(num_rows() - next_unsealed_row_) >=
+             hot_rows_ + kRowsPerSegment) {
+    if (!SealSegment())
+      break;
+  }
+}
+
+bool LogStore::SealSegment() {
+  ScopedPerfTimer timer(&seal_segment_counter);
+
+  size_t first_index = GetIndex(next_unsealed_row_);
+  DCHECK_LE(first_index + kRowsPerSegment, messages_.size());
+
+  std::string data;
+  for (size_t i = first_index; i < first_index + kRowsPerSegment; ++i) {
+    base::StringPiece message(message_arena_.Get(messages_[i]));
+    message.AppendToString(&data);
+  }
+
+  Segment segment;
+  segment.first_row = next_unsealed_row_;
+  segment.size = data.size();
+  uLongf compressed_size = compressBound(data.size());
+  segment.compressed.resize(std::max<uLongf>(compressed_size, 1));
+  int ret = compress2(reinterpret_cast<Bytef*>(&segment.compressed[0]),
+                      &compressed_size,
+                      reinterpret_cast<const Bytef*>(data.data()),
+                      data.size(),
+                      Z_BEST_SPEED);
+  if (ret != Z_OK) {
+    LOG(ERROR) << "Failed to compress log segment, error " << ret;
+    return false;
+  }
+  segment.compressed.resize(compressed_size);
+
+  // Repoint the rows to the segment's data, and let go of their strings.
+  uint32 offset = 0;
+  for (size_t i = first_index; i < first_index + kRowsPerSegment; ++i) {
+    StringArena::Ref& ref = messages_[i];
+    message_arena_.Release(ref);
+    ref.block = kSealedBlock;
+    ref.offset = offset;
+    offset += ref.length;
+  }
+
+  segments_.push_back(Segment());
+  segments_.back().first_row = segment.first_row;
+  segments_.back().size = segment.size;
+  segments_.back().compressed.swap(segment.compressed);
+  next_unsealed_row_ += kRowsPerSegment;
+
+  return true;
+}
+
+void LogStore::GetSealedMessage(size_t index, std::string* buffer) const {
+  DCHECK(buffer != NULL);
+  DCHECK(!segments_.empty());
+
+  const StringArena::Ref& ref = messages_[index];
+  DCHECK_EQ(kSealedBlock, ref.block);
+  int row = first_row_ + static_cast<int>(index);
+  size_t segment_index = (row - segments_.front().first_row) /
+      kRowsPerSegment;
+  DCHECK_LT(segment_index, segments_.size());
+  const Segment& segment = segments_[segment_index];
+  DCHECK_LE(segment.first_row, row);
+  DCHECK_LE(ref.offset + ref.length, segment.size);
+
+  {
+    base::AutoLock lock(cache_lock_);
+    std::list<CachedSegment>::iterator it = cached_segments_.begin();
+    for (; it != cached_segments_.end(); ++it) {
+      if (it->first_row == segment.first_row) {
+        cached_segments_.splice(cached_segments_.begin(), cached_segments_,
+                                it);
+        buffer->assign(it->data, ref.offset, ref.length);
+        return;
+      }
+    }
+  }
+
+  // Decompress outside the lock, so that readers of other segments
+  // needn't wait on this one.
+  CachedSegment cached;
+  cached.first_row = segment.first_row;
+  cached.data.resize(segment.size);
+  if (segment.size != 0) {
+    ScopedPerfTimer timer(&unseal_segment_counter);
+    uLongf size = segment.size;
+    int ret = uncompress(reinterpret_cast<Bytef*>(&cached.data[0]),
+                         &size,
+                         reinterpret_cast<const Bytef*>(
+                             segment.compressed.data()),
+                         segment.compressed.size());
+    DCHECK_EQ(Z_OK, ret);
+    DCHECK_EQ(segment.size, size);
+  }
+  buffer->assign(cached.data, ref.offset, ref.length);
+
+  base::AutoLock lock(cache_lock_);
+  cached_segments_.push_front(CachedSegment());
+  cached_segments_.front().first_row = cached.first_row;
+  cached_segments_.front().data.swap(cached.data);
+  if (cached_segments_.size() > kMaxCachedSegments)
+    cached_segments_.pop_back();
+}
+
+UCHAR LogStore::GetSeverity(int row) const {
+  return levels_[GetIndex(row)];
+}
+
+DWORD LogStore::GetProcessId(int row) const {
+  return process_ids_[GetIndex(row)];
+}
+
+DWORD LogStore::GetThreadId(int row) const {
+  return thread_ids_[GetIndex(row)];
+}
+
+base::Time LogStore::GetTime(int row) const {
+  return base::Time::FromInternalValue(times_[GetIndex(row)]);
+}
+
+StringTable::Atom LogStore::GetFileAtom(int row) const {
+  return file_atoms_[GetIndex(row)];
+}
+
+const std::string& LogStore::GetFileName(int row) const {
+  return file_table_->GetString(file_atoms_[GetIndex(row)]);
+}
+
+int LogStore::GetLine(int row) const {
+  return lines_[GetIndex(row)];
+}
+
+base::StringPiece LogStore::GetMessage(int row, std::string* buffer) const {
+  DCHECK(buffer != NULL);
+
+  size_t index = GetIndex(row);
+  MessageTemplates::TemplateId template_id = template_ids_[index];
+  if (messages_[index].block == kSealedBlock) {
+    if (template_id == MessageTemplates::kNoTemplate) {
+      GetSealedMessage(index, buffer);
+      return *buffer;
+    }
+
+    std::string parameters;
+    GetSealedMessage(index, &parameters);
+    return message_templates_.Expand(template_id, parameters, buffer);
+  }
+
+  base::StringPiece message(message_arena_.Get(messages_[index]));
+  if (template_id == MessageTemplates::kNoTemplate)
+    return message;
+
+  return message_templates_.Expand(template_id, message, buffer);
+}
+
+MessageTemplates::TemplateId LogStore::GetMessageTemplateId(int row) const {
+  return template_ids_[GetIndex(row)];
+}
+
+size_t LogStore::GetStackTraceDepth(int row) const {
+  return stack_pool_.GetDepth(stack_ids_[GetIndex(row)]);
+}
+
+void LogStore::GetStackTrace(int row,
+                             std::vector<sym_util::Address>* trace) const {
+  DCHECK(trace != NULL);
+  stack_pool_.GetFrames(stack_ids_[GetIndex(row)], trace);
+}
+
+StackTracePool::StackId LogStore::GetStackTraceId(int row) const {
+  return stack_ids_[GetIndex(row)];
+}
+
+int LogStore::GetRepeatCount(int row) const {
+  DCHECK_LE(first_row_, row);
+  if (repeats_.empty())
+    return 1;
+
+  RepeatMap::const_iterator it = repeats_.find(row);
+  return it == repeats_.end() ? 1 : 1 + it->second.extra_count;
+}
+
+base::Time LogStore::GetLastTime(int row) const {
+  RepeatMap::const_iterator it = repeats_.find(row);
+  if (it == repeats_.end())
+    return GetTime(row);
+
+  return base::Time::FromInternalValue(it->second.last_time);
+}
+
+int LogStore::FindRowForTime(const base::Time& time) const {
+  int64 value = time.ToInternalValue();
+
+  // The rows before the interval found are all earlier than @p time, so
+  // the answer is the first row in it that isn't, or in the rows past the
+  // last interval.
+  size_t interval = std::lower_bound(time_index_.begin(), time_index_.end(),
+                                     value) - time_index_.begin();
+  size_t index = interval * kTimeIndexInterval;
+  size_t end = std::min(index + kTimeIndexInterval, times_.size());
+  for (; index < end; ++index) {
+    if (times_[index] >= value)
+      return first_row_ + static_cast<int>(index);
+  }
+
+  DCHECK_EQ(interval, time_index_.size());
+  return num_rows();
+}
+
+size_t LogStore::GetMemoryUsage() const {
+  size_t usage = 0;
+
+  usage += levels_.capacity() * sizeof(levels_[0]);
+  usage += process_ids_.capacity() * sizeof(process_ids_[0]);
+  usage += thread_ids_.capacity() * sizeof(thread_ids_[0]);
+  usage += times_.capacity() * sizeof(times_[0]);
+  usage += time_index_.capacity() * sizeof(time_index_[0]);
+  usage += volume_histogram_.GetMemoryUsage();
+  usage += file_atoms_.capacity() * sizeof(file_atoms_[0]);
+  usage += lines_.capacity() * sizeof(lines_[0]);
+  usage += messages_.capacity() * sizeof(messages_[0]);
+  usage += template_ids_.capacity() * sizeof(template_ids_[0]);
+  usage += message_templates_.GetMemoryUsage();
+  usage += stack_ids_.capacity() * sizeof(stack_ids_[0]);
+  usage += stack_pool_.GetMemoryUsage();
+  usage += message_arena_.allocated_bytes();
+  for (size_t i = 0; i < segments_.size(); ++i)
+    usage += sizeof(segments_[i]) + segments_[i].compressed.capacity();
+  {
+    base::AutoLock lock(cache_lock_);
+    std::list<CachedSegment>::const_iterator it = cached_segments_.begin();
+    for (; it != cached_segments_.end(); ++it)
+      usage += sizeof(*it) + it->data.capacity();
+  }
+  if (message_index_.get() != NULL)
+    usage += message_index_->GetMemoryUsage();
+  usage += severity_postings_.GetMemoryUsage();
+  usage += process_postings_.GetMemoryUsage();
+  usage += loss_marker_rows_.capacity() * sizeof(loss_marker_rows_[0]);
+  usage += TreeFootprint(repeats_);
+  usage += TreeFootprint(last_thread_rows_);
+
+  return usage;
+}
+
+void ParseLogMessage(const LogEvents::LogMessage& log_message,
+                     StringTable* file_table,
+                     StringTable::Atom* file,
+                     int* line,
+                     base::StringPiece* message) {
+  DCHECK(file_table != NULL);
+  DCHECK(file != NULL);
+  DCHECK(line != NULL);
+  DCHECK(message != NULL);
+
+  pcrecpp::StringPiece text(log_message.message, log_message.message_len);
+  pcrecpp::StringPiece text_file;
+  pcrecpp::StringPiece text_message;
+  int text_line = 0;
+
+  // Use regular expression matching to extract the
+  // file/line/message from the log string.
+  if (!kFileRe.FullMatch(text, &text_file, &text_line, &text_message)) {
+    // As fallback, just slurp the entire string.
+    text_file.clear();
+    text_line = 0;
+    text_message = text;
+  }
+
+  message->set(text_message.data(), text_message.size());
+
+  // If the message carried file information, use that
+  // in preference to the above. The parser may have interned
+  // the file already.
+  if (log_message.file_len != 0) {
+    *file = log_message.file_atom;
+    if (*file == StringTable::kEmptyAtom) {
+      *file = file_table->Intern(
+          base::StringPiece(log_message.file, log_message.file_len));
+    }
+    *line = log_message.line;
+  } else {
+    *file = file_table->Intern(
+        base::StringPiece(text_file.data(), text_file.size()));
+    *line = text_line;
+  }
+}
+
+std::string FormatTraceMessage(const char* type,
+                               const TraceEvents::TraceMessage& trace_message) {
+  return base::StringPrintf("%s(%*s, 0x%08X): %*s",
+                            type,
+                            trace_message.name_len,
+                            trace_message.name,
+                            trace_message.id,
+                            trace_message.extra_len,
+                            trace_message.extra);
+}
+
+std::string FormatEventLoss(const LogEvents::EventLoss& event_loss) {
+  bool buffers = event_loss.type == LogEvents::EventLoss::BUFFERS_LOST;
+  if (event_loss.count == 0)
+    return buffers ? "Buffers lost" : "Events lost";
+
+  return base::StringPrintf("%u %s%s lost",
+                            event_loss.count,
+                            buffers ? "buffer" : "event",
+                            event_loss.count == 1 ? "" : "s");
+}
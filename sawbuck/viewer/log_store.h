@@ -0,0 +1,522 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Columnar log store declaration.
+#ifndef SAWBUCK_VIEWER_LOG_STORE_H_
+#define SAWBUCK_VIEWER_LOG_STORE_H_
+
+#include <windows.h>
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_piece.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "sawbuck/log_lib/log_consumer.h"
+#include "sawbuck/log_lib/string_table.h"
+#include "sawbuck/viewer/message_templates.h"
+#include "sawbuck/viewer/row_posting_index.h"
+#include "sawbuck/viewer/stack_trace_pool.h"
+#include "sawbuck/viewer/trigram_index.h"
+#include "sawbuck/viewer/volume_histogram.h"
+
+// An append-only arena for string data. Strings are stored back to back
+// in large blocks, which are never moved, so the storage for a string is
+// stable until it's released. A block is freed once all of its strings
+// are released, or when the arena is cleared.
+class StringArena {
+ public:
+  StringArena();
+  ~StringArena();
+
+  // A reference to a string stored in the arena.
+  struct Ref {
+    Ref() : block(0), offset(0), length(0) {
+    }
+
+    uint32 block;
+    uint32 offset;
+    uint32 length;
+  };
+
+  // Copies @p len bytes from @p str to the arena.
+  // @returns a reference to the stored copy.
+  Ref Append(const char* str, size_t len);
+
+  // @returns the string referred to by @p ref.
+  base::StringPiece Get(const Ref& ref) const;
+
+  // Releases the string referred to by @p ref, which must not be released
+  // again, nor read after.
+  void Release(const Ref& ref);
+
+  // Releases all storage.
+  void Clear();
+
+  // @returns the number of bytes allocated for string data.
+  size_t allocated_bytes() const { return allocated_bytes_; }
+
+  // The size of regular blocks, strings larger than this get a block
+  // of their own.
+  static const size_t kBlockSize = 256 * 1024;
+
+ private:
+  struct Block {
+    char* data;
+    size_t used;
+    size_t size;
+    // The number of strings not yet released.
+    size_t live;
+  };
+
+  // Frees the storage of @p block.
+  void FreeBlock(Block* block);
+
+  std::vector<Block> blocks_;
+
+  // Index of the block we're currently filling.
+  static const size_t kNoBlock = static_cast<size_t>(-1);
+  size_t current_block_;
+  size_t allocated_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(StringArena);
+};
+
+// Stores log rows column-wise. The fixed-size fields live in packed
+// arrays, one per column, file names are interned to a shared string
+// table, messages are split into a template, interned to a template table,
+// and their parameters, appended to a string arena, and stack traces are
+// interned to a stack trace pool. This costs a handful of bytes per row
+// over the message parameters, each distinct template and trace is stored
+// once, and all allocation is amortized over large chunks.
+//
+// The store may be bounded by a retention policy, in which case it's a
+// ring that evicts its oldest rows to make room for new ones. Rows are
+// numbered in the order they're added and keep their number through the
+// evictions, so the rows retained are [first_row(), num_rows()).
+//
+// The messages of rows past the newest hot_rows() may be sealed into
+// compressed segments, which are decompressed into a small cache as
+// they're read, so a long capture only keeps the messages of the rows in
+// use in the clear.
+// @note a store is filled and evicted on one thread, and may be read from
+//     several threads at once while that thread doesn't change it, as the
+//     cache of sealed segments is locked.
+class LogStore {
+ public:
+  // @param file_table the table file names are interned to, must
+  //    outlive this store.
+  explicit LogStore(StringTable* file_table);
+  ~LogStore();
+
+  // Bounds the rows the store retains, zero limits don't apply.
+  struct Retention {
+    Retention() : max_rows(0), max_bytes(0) {
+    }
+
+    // The most rows to retain.
+    size_t max_rows;
+    // The most bytes of row data to retain, @see retained_bytes.
+    size_t max_bytes;
+    // The oldest row to retain, relative to the time of the newest row.
+    base::TimeDelta max_age;
+  };
+
+  // Sets the retention policy and evicts the rows it doesn't retain. Rows
+  // are evicted oldest first as new rows are added, in chunks of a
+  // kEvictionChunkDivisor'th of the rows retained, so the cost of evicting
+  // them is spread over those added since. The newest row is always
+  // retained.
+  void set_retention(const Retention& retention);
+  const Retention& retention() const { return retention_; }
+
+  // Rows are evicted at least this fraction at a time.
+  static const int kEvictionChunkDivisor = 16;
+
+  // Sets whether rows that exactly repeat the last row of their thread are
+  // collapsed into it, rather than added. A collapsed row keeps the time of
+  // its first occurrence, and counts its repeats and the time of the last.
+  // @note this applies only to rows added from then on.
+  void set_collapse_repeats(bool collapse_repeats) {
+    collapse_repeats_ = collapse_repeats;
+  }
+  bool collapse_repeats() const { return collapse_repeats_; }
+
+  // Appends a row to the store, or collapses it into the last row of
+  // @p thread_id if it repeats it, @see set_collapse_repeats.
+  // @returns the index of the new row, or of the row it collapsed into.
+  int AddRow(UCHAR level,
+             DWORD process_id,
+             DWORD thread_id,
+             const base::Time& time,
+             StringTable::Atom file,
+             int line,
+             const base::StringPiece& message,
+             size_t trace_depth,
+             const sym_util::Address* traces);
+
+  // Appends a row for @p log_message, @see ParseLogMessage.
+  // @returns the index of the new row.
+  int AddLogMessage(const LogEvents::LogMessage& log_message);
+
+  // Appends a row for a trace event of @p type, @see FormatTraceMessage.
+  // @returns the index of the new row.
+  int AddTraceMessage(const char* type,
+                      const TraceEvents::TraceMessage& trace_message);
+
+  // The file name of the marker rows that stand in for lost data. It's
+  // not a valid path, so it can't clash with that of a log message.
+  static const char kLossMarkerFile[];
+
+  // Appends a marker row for @p event_loss, @see FormatEventLoss. Markers
+  // aren't collapsed, so each loss keeps its place in the rows.
+  // @returns the index of the new row.
+  int AddLossMarker(const LogEvents::EventLoss& event_loss);
+
+  // @returns true iff @p row is a marker for lost data.
+  bool IsLossMarker(int row) const {
+    return GetFileAtom(row) == loss_marker_file_;
+  }
+
+  // @returns the atom of kLossMarkerFile in file_table().
+  StringTable::Atom loss_marker_file() const { return loss_marker_file_; }
+
+  // Appends a copy of @p row of @p source, which must share our file table,
+  // along with its repeats.
+  // @returns the index of the new row, or of the row it collapsed into.
+  int AppendRow(const LogStore& source, int row);
+
+  // Appends all rows of @p sources, merged by time. Each of @p sources
+  // must be in time order, and rows of equal time are taken in the order
+  // of their sources. If @p drop_duplicates is true, the rows that
+  // duplicate those of another source are dropped, @see DuplicateRowFilter.
+  // @returns the number of rows dropped.
+  size_t MergeFrom(const std::vector<const LogStore*>& sources,
+                   bool drop_duplicates);
+
+  // Removes all rows and releases their storage, numbering starts over.
+  void Clear();
+
+  // @returns the number of rows added to the store, including evicted rows.
+  int num_rows() const {
+    return first_row_ + static_cast<int>(levels_.size());
+  }
+
+  // @returns the number of the oldest row retained, rows before it have
+  //     been evicted.
+  int first_row() const { return first_row_; }
+
+  // @returns the bytes of row data retained, which is the size of the rows'
+  //     columns and message parameters, and of their distinct message
+  //     templates and stack traces.
+  size_t retained_bytes() const {
+    return retained_bytes_ + message_templates_.live_bytes() +
+        stack_pool_.live_bytes();
+  }
+
+  // @returns the table file names are interned to.
+  StringTable* file_table() const { return file_table_; }
+
+  // Sets the number of newest rows whose messages are kept as they are,
+  // the messages of older rows are sealed kRowsPerSegment rows at a time.
+  // Zero, the default, seals none.
+  // @note this applies as rows are added from then on.
+  void set_hot_rows(size_t hot_rows) { hot_rows_ = hot_rows; }
+  size_t hot_rows() const { return hot_rows_; }
+
+  // The rows in a sealed segment.
+  static const int kRowsPerSegment = 4096;
+  // The most sealed segments kept decompressed.
+  static const size_t kMaxCachedSegments = 8;
+
+  // @returns the number of sealed segments retained.
+  size_t num_sealed_segments() const { return segments_.size(); }
+
+  // Indexes the messages of all rows, present and future, for fast text
+  // searches. This costs memory, and time as rows are added, so it's only
+  // worthwhile for stores that are searched.
+  void EnableMessageIndex();
+
+  // @returns the message index, or NULL if it's not enabled.
+  const TrigramIndex* message_index() const { return message_index_.get(); }
+
+  // @returns the retained rows by severity and by process id, which follow
+  //     the rows as they're added and evicted. Filters on these columns
+  //     alone can take their rows from the lists of the values that pass.
+  const RowPostingIndex& severity_postings() const {
+    return severity_postings_;
+  }
+  const RowPostingIndex& process_postings() const {
+    return process_postings_;
+  }
+
+  // @returns the retained marker rows for lost data, in ascending order.
+  const std::vector<int>& loss_marker_rows() const {
+    return loss_marker_rows_;
+  }
+
+  // Row accessors, @p row must be in [first_row(), num_rows()).
+  // @{
+  UCHAR GetSeverity(int row) const;
+  DWORD GetProcessId(int row) const;
+  DWORD GetThreadId(int row) const;
+  base::Time GetTime(int row) const;
+  StringTable::Atom GetFileAtom(int row) const;
+  const std::string& GetFileName(int row) const;
+  int GetLine(int row) const;
+  // @returns @p row's message in place if it's stored whole and not
+  //     sealed, or else copied or expanded into @p buffer. The message
+  //     is valid until rows are added to the store, or @p buffer changes.
+  base::StringPiece GetMessage(int row, std::string* buffer) const;
+  // @returns the id of @p row's message template in message_templates(),
+  //     which is equal for rows with equal templates, or kNoTemplate if the
+  //     message is stored whole.
+  MessageTemplates::TemplateId GetMessageTemplateId(int row) const;
+  size_t GetStackTraceDepth(int row) const;
+  void GetStackTrace(int row, std::vector<sym_util::Address>* trace) const;
+  // @returns the id of @p row's stack trace in stack_pool(), which is equal
+  //     for rows with equal traces.
+  StackTracePool::StackId GetStackTraceId(int row) const;
+  // @returns the number of occurrences of @p row, which is one unless
+  //     repeats were collapsed into it.
+  int GetRepeatCount(int row) const;
+  // @returns the time of the last occurrence of @p row.
+  base::Time GetLastTime(int row) const;
+  // @}
+
+  // @returns the first row at or past @p time, that is the first whose
+  //     time, or that of any row before it, is no earlier than @p time,
+  //     or num_rows() if there's none. For rows in time order this is the
+  //     first row no earlier than @p time. This takes O(log n) time.
+  int FindRowForTime(const base::Time& time) const;
+
+  // The rows per entry of the time index.
+  static const size_t kTimeIndexInterval = 256;
+
+  // @returns the counts of the retained rows by time and severity, which
+  //     follow the rows as they're added and evicted. Collapsed repeats
+  //     count once, at the time of their first occurrence.
+  const VolumeHistogram& volume_histogram() const {
+    return volume_histogram_;
+  }
+
+  // Column accessors for bulk reads, each column has an entry for each
+  // row retained, so row r is at index r - first_row(). The returned
+  // pointers are invalidated by adding rows to the store.
+  // @{
+  const UCHAR* levels() const { return ColumnData(levels_); }
+  const DWORD* process_ids() const { return ColumnData(process_ids_); }
+  const DWORD* thread_ids() const { return ColumnData(thread_ids_); }
+  const int64* times() const { return ColumnData(times_); }
+  const StringTable::Atom* file_atoms() const {
+    return ColumnData(file_atoms_);
+  }
+  const int32* lines() const { return ColumnData(lines_); }
+  const MessageTemplates::TemplateId* template_ids() const {
+    return ColumnData(template_ids_);
+  }
+  const StackTracePool::StackId* stack_ids() const {
+    return ColumnData(stack_ids_);
+  }
+  // @}
+
+  // @returns the table of the rows' message templates.
+  const MessageTemplates& message_templates() const {
+    return message_templates_;
+  }
+
+  // @returns the pool of the rows' stack traces.
+  const StackTracePool& stack_pool() const { return stack_pool_; }
+
+  // @returns an estimate of the heap memory used by the store.
+  size_t GetMemoryUsage() const;
+
+ private:
+  template <class T>
+  static const T* ColumnData(const std::vector<T>& column) {
+    return column.empty() ? NULL : &column[0];
+  }
+
+  // @returns the column index of @p row.
+  size_t GetIndex(int row) const;
+
+  // @returns the retained bytes of the row at @p index, short of its
+  //     message template and stack trace, which may be shared.
+  size_t GetRowBytes(size_t index) const;
+
+  // Evicts the rows the retention policy doesn't retain, if any.
+  void EnforceRetention();
+
+  // Evicts the oldest @p count rows.
+  void EvictRows(size_t count);
+
+  // Adds the entries of the intervals completed since to time_index_.
+  void ExtendTimeIndex();
+
+  // Seals the messages of the rows past the newest hot_rows_, a segment
+  // at a time.
+  void SealColdRows();
+  // Seals the messages of the segment that starts at next_unsealed_row_.
+  // @returns true on success.
+  bool SealSegment();
+  // Copies the sealed message, or message parameters, of the row at
+  // @p index to @p buffer.
+  void GetSealedMessage(size_t index, std::string* buffer) const;
+
+  // @returns the last row retained for @p thread_id if it's equal to the
+  //     row given, or -1.
+  int FindRepeatedRow(UCHAR level,
+                      DWORD process_id,
+                      DWORD thread_id,
+                      StringTable::Atom file,
+                      int line,
+                      const base::StringPiece& message,
+                      size_t trace_depth,
+                      const sym_util::Address* traces) const;
+
+  // Widens the @p trace_depth frames at @p traces into trace_buffer_.
+  // @returns the frames widened, NULL if there are none.
+  const sym_util::Address* WidenTrace(size_t trace_depth,
+                                      void* const* traces);
+
+  // The packed columns, all of equal length.
+  std::vector<UCHAR> levels_;
+  std::vector<DWORD> process_ids_;
+  std::vector<DWORD> thread_ids_;
+  std::vector<int64> times_;
+  std::vector<StringTable::Atom> file_atoms_;
+  std::vector<int32> lines_;
+  std::vector<StringArena::Ref> messages_;
+
+  // The latest time of the retained rows up to the end of each interval
+  // of kTimeIndexInterval rows, which increases even where the rows are
+  // out of order, so it can be searched for a time.
+  std::vector<int64> time_index_;
+
+  // Counts the retained rows by time and severity.
+  VolumeHistogram volume_histogram_;
+
+  // Each row holds a reference to its message template, unless its message
+  // is stored whole, the message parameters are in messages_.
+  std::vector<MessageTemplates::TemplateId> template_ids_;
+  MessageTemplates message_templates_;
+
+  // Each row holds a reference to its trace in stack_pool_.
+  std::vector<StackTracePool::StackId> stack_ids_;
+  StackTracePool stack_pool_;
+
+  // The repeats of collapsed rows, keyed by row. Repeats are rare enough
+  // that these are kept aside rather than in a column.
+  struct Repeat {
+    Repeat() : extra_count(0), last_time(0) {
+    }
+
+    // The occurrences past the first.
+    int extra_count;
+    int64 last_time;
+  };
+  typedef std::map<int, Repeat> RepeatMap;
+  RepeatMap repeats_;
+
+  // The last row added for each thread, while collapsing repeats.
+  typedef std::map<DWORD, int> ThreadRowMap;
+  ThreadRowMap last_thread_rows_;
+  bool collapse_repeats_;
+
+  // The interned file names, not owned.
+  StringTable* file_table_;
+  StringTable::Atom loss_marker_file_;
+
+  // Backing storage for the message parameters, or whole messages.
+  StringArena message_arena_;
+
+  // The messages of a segment of rows, compressed with zlib. Each
+  // sealed row's reference in messages_ is to its segment's data.
+  struct Segment {
+    Segment() : first_row(0), size(0) {
+    }
+
+    int first_row;
+    // The size of the data decompressed.
+    size_t size;
+    std::string compressed;
+  };
+  // The block of the references to sealed messages, the offset is into
+  // the data of the row's segment.
+  static const uint32 kSealedBlock = static_cast<uint32>(-1);
+  // The sealed segments in row order, each of kRowsPerSegment rows. The
+  // rows from next_unsealed_row_ on aren't sealed.
+  std::deque<Segment> segments_;
+  int next_unsealed_row_;
+  size_t hot_rows_;
+
+  // A decompressed sealed segment.
+  struct CachedSegment {
+    int first_row;
+    std::string data;
+  };
+  // Guards cached_segments_, which readers may fill from several threads.
+  mutable base::Lock cache_lock_;
+  // The segments read last, most recent first.
+  mutable std::list<CachedSegment> cached_segments_;  // Under cache_lock_.
+
+  // Scratch space for splitting messages as they're added.
+  std::string template_buffer_;
+  std::string parameter_buffer_;
+  std::vector<sym_util::Address> trace_buffer_;
+
+  // Indexes the message text, if enabled.
+  scoped_ptr<TrigramIndex> message_index_;
+
+  // Index the rows by severity and by process id, and the rows of
+  // loss_marker_file_.
+  RowPostingIndex severity_postings_;
+  RowPostingIndex process_postings_;
+  std::vector<int> loss_marker_rows_;
+
+  // The number of rows evicted, and the bytes of those retained.
+  int first_row_;
+  size_t retained_bytes_;
+
+  Retention retention_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogStore);
+};
+
+// Extracts the file, line and message of a row from @p log_message. Messages
+// that don't carry file information may still have it in their text, which
+// is then of form "[<stuff>:<file>(<line>)] <message><ws>".
+// @param file_table the table to intern file names to, where the parser
+//    didn't already.
+// @param message on return refers to the text of @p log_message.
+void ParseLogMessage(const LogEvents::LogMessage& log_message,
+                     StringTable* file_table,
+                     StringTable::Atom* file,
+                     int* line,
+                     base::StringPiece* message);
+
+// @returns the row message for a trace event of @p type, which is of form
+//    "{BEGIN|END|INSTANT}(<name>, 0x<id>): <extra>".
+std::string FormatTraceMessage(const char* type,
+                               const TraceEvents::TraceMessage& trace_message);
+
+// @returns the row message for @p event_loss, e.g. "3 buffers lost", or
+//    "Events lost" where the count isn't known.
+std::string FormatEventLoss(const LogEvents::EventLoss& event_loss);
+
+#endif  // SAWBUCK_VIEWER_LOG_STORE_H_
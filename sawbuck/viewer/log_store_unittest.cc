@@ -0,0 +1,864 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/log_store.h"
+
+#include "base/strings/stringprintf.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(StringArenaTest, AppendAndGet) {
+  StringArena arena;
+
+  StringArena::Ref empty = arena.Append("", 0);
+  StringArena::Ref foo = arena.Append("foo", 3);
+  StringArena::Ref bar = arena.Append("barbaz", 3);
+
+  EXPECT_EQ("", arena.Get(empty).as_string());
+  EXPECT_EQ("foo", arena.Get(foo).as_string());
+  EXPECT_EQ("bar", arena.Get(bar).as_string());
+  EXPECT_EQ(StringArena::kBlockSize, arena.allocated_bytes());
+}
+
+TEST(StringArenaTest, OversizeStrings) {
+  StringArena arena;
+
+  StringArena::Ref foo = arena.Append("foo", 3);
+
+  std::string big(StringArena::kBlockSize + 10, 'x');
+  StringArena::Ref big_ref = arena.Append(big.data(), big.size());
+
+  // The next small string should go in the first block.
+  StringArena::Ref bar = arena.Append("bar", 3);
+  EXPECT_EQ(foo.block, bar.block);
+  EXPECT_NE(foo.block, big_ref.block);
+
+  EXPECT_EQ("foo", arena.Get(foo).as_string());
+  EXPECT_EQ(big, arena.Get(big_ref).as_string());
+  EXPECT_EQ("bar", arena.Get(bar).as_string());
+
+  arena.Clear();
+  EXPECT_EQ(0, arena.allocated_bytes());
+}
+
+TEST(StringArenaTest, StableStorage) {
+  StringArena arena;
+
+  StringArena::Ref first = arena.Append("first", 5);
+  const char* first_data = arena.Get(first).data();
+
+  // Fill up a few blocks.
+  std::string filler(1000, 'f');
+  for (size_t i = 0; i < 3 * StringArena::kBlockSize / filler.size(); ++i)
+    arena.Append(filler.data(), filler.size());
+
+  EXPECT_EQ(first_data, arena.Get(first).data());
+  EXPECT_EQ("first", arena.Get(first).as_string());
+}
+
+TEST(StringArenaTest, Release) {
+  StringArena arena;
+
+  StringArena::Ref foo = arena.Append("foo", 3);
+  std::string big(StringArena::kBlockSize + 10, 'x');
+  StringArena::Ref big_ref = arena.Append(big.data(), big.size());
+  EXPECT_EQ(StringArena::kBlockSize + big.size(), arena.allocated_bytes());
+
+  // Oversize blocks go with their string.
+  arena.Release(big_ref);
+  EXPECT_EQ(StringArena::kBlockSize, arena.allocated_bytes());
+
+  // The current block stays for more strings.
+  arena.Release(foo);
+  EXPECT_EQ(StringArena::kBlockSize, arena.allocated_bytes());
+  StringArena::Ref bar = arena.Append("bar", 3);
+  EXPECT_EQ(foo.block, bar.block);
+  EXPECT_EQ("bar", arena.Get(bar).as_string());
+
+  // Once filled, a released block goes as the next one starts.
+  std::string filler(1000, 'f');
+  std::vector<StringArena::Ref> fillers;
+  while (fillers.empty() || fillers.back().block == bar.block)
+    fillers.push_back(arena.Append(filler.data(), filler.size()));
+  arena.Release(bar);
+  EXPECT_EQ(2 * StringArena::kBlockSize, arena.allocated_bytes());
+  for (size_t i = 0; i + 1 < fillers.size(); ++i)
+    arena.Release(fillers[i]);
+  EXPECT_EQ(StringArena::kBlockSize, arena.allocated_bytes());
+  EXPECT_EQ(filler, arena.Get(fillers.back()).as_string());
+}
+
+class LogStoreTest: public testing::Test {
+ public:
+  LogStoreTest() : time_(base::Time::Now()), store_(&file_table_) {
+    for (size_t i = 0; i < arraysize(trace_); ++i)
+      trace_[i] = 0x1000 + i;
+  }
+
+  std::string GetMessage(int row) {
+    std::string buffer;
+    return store_.GetMessage(row, &buffer).as_string();
+  }
+
+ protected:
+  base::Time time_;
+  sym_util::Address trace_[5];
+  StringTable file_table_;
+  LogStore store_;
+};
+
+TEST_F(LogStoreTest, Empty) {
+  EXPECT_EQ(0, store_.num_rows());
+}
+
+TEST_F(LogStoreTest, AddRow) {
+  EXPECT_EQ(0, store_.AddRow(TRACE_LEVEL_ERROR, 10, 11, time_,
+                             file_table_.Intern("file.cc"), 42, "A message",
+                             arraysize(trace_), trace_));
+  EXPECT_EQ(1, store_.AddRow(TRACE_LEVEL_INFORMATION, 20, 21,
+                             time_ + base::TimeDelta::FromSeconds(1),
+                             StringTable::kEmptyAtom, 0, "Another message",
+                             0, NULL));
+
+  ASSERT_EQ(2, store_.num_rows());
+
+  EXPECT_EQ(TRACE_LEVEL_ERROR, store_.GetSeverity(0));
+  EXPECT_EQ(10, store_.GetProcessId(0));
+  EXPECT_EQ(11, store_.GetThreadId(0));
+  EXPECT_EQ(time_, store_.GetTime(0));
+  EXPECT_EQ(file_table_.Intern("file.cc"), store_.GetFileAtom(0));
+  EXPECT_EQ("file.cc", store_.GetFileName(0));
+  EXPECT_EQ(42, store_.GetLine(0));
+  EXPECT_EQ("A message", GetMessage(0));
+
+  std::vector<sym_util::Address> trace;
+  store_.GetStackTrace(0, &trace);
+  EXPECT_EQ(std::vector<sym_util::Address>(trace_,
+                                           trace_ + arraysize(trace_)),
+            trace);
+  EXPECT_EQ(arraysize(trace_), store_.GetStackTraceDepth(0));
+
+  EXPECT_EQ(TRACE_LEVEL_INFORMATION, store_.GetSeverity(1));
+  EXPECT_EQ(20, store_.GetProcessId(1));
+  EXPECT_EQ(21, store_.GetThreadId(1));
+  EXPECT_EQ(time_ + base::TimeDelta::FromSeconds(1), store_.GetTime(1));
+  EXPECT_EQ(StringTable::kEmptyAtom, store_.GetFileAtom(1));
+  EXPECT_EQ("", store_.GetFileName(1));
+  EXPECT_EQ(0, store_.GetLine(1));
+  EXPECT_EQ("Another message", GetMessage(1));
+
+  store_.GetStackTrace(1, &trace);
+  EXPECT_TRUE(trace.empty());
+  EXPECT_EQ(0, store_.GetStackTraceDepth(1));
+}
+
+TEST_F(LogStoreTest, FileNames) {
+  StringTable::Atom foo = file_table_.Intern("foo.cc");
+  StringTable::Atom bar = file_table_.Intern("bar.cc");
+  store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, foo, 1, "", 0, NULL);
+  store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, bar, 1, "", 0, NULL);
+  store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, foo, 1, "", 0, NULL);
+
+  EXPECT_EQ(foo, store_.GetFileAtom(0));
+  EXPECT_EQ(bar, store_.GetFileAtom(1));
+  EXPECT_EQ(foo, store_.GetFileAtom(2));
+  EXPECT_EQ("foo.cc", store_.GetFileName(0));
+  EXPECT_EQ("bar.cc", store_.GetFileName(1));
+  EXPECT_EQ("foo.cc", store_.GetFileName(2));
+
+  // Interned names share storage.
+  EXPECT_EQ(&store_.GetFileName(0), &store_.GetFileName(2));
+}
+
+TEST_F(LogStoreTest, SharesMessageTemplates) {
+  StringTable::Atom file = file_table_.Intern("file.cc");
+  for (int i = 0; i < 10; ++i) {
+    store_.AddRow(TRACE_LEVEL_INFORMATION, 1, 1, time_, file, i,
+                  base::StringPrintf("Read %d bytes at 0x%08X", i, i * 16),
+                  0, NULL);
+  }
+  store_.AddRow(TRACE_LEVEL_INFORMATION, 1, 1, time_, file, 10, "Done",
+                0, NULL);
+  std::string marked("Has a \x01 in it");
+  store_.AddRow(TRACE_LEVEL_INFORMATION, 1, 1, time_, file, 11, marked,
+                0, NULL);
+
+  // Messages expand to their text, and equal templates have equal ids.
+  EXPECT_EQ("Read 3 bytes at 0x00000030", GetMessage(3));
+  EXPECT_EQ("Done", GetMessage(10));
+  EXPECT_EQ(marked, GetMessage(11));
+  MessageTemplates::TemplateId id = store_.GetMessageTemplateId(0);
+  for (int row = 1; row < 10; ++row)
+    EXPECT_EQ(id, store_.GetMessageTemplateId(row));
+  EXPECT_NE(id, store_.GetMessageTemplateId(10));
+  EXPECT_EQ(MessageTemplates::kNoTemplate, store_.GetMessageTemplateId(11));
+  EXPECT_EQ(2, store_.message_templates().num_templates());
+
+  // A message without parameters is the template itself.
+  std::string buffer;
+  EXPECT_EQ(store_.message_templates().GetTemplate(
+                store_.GetMessageTemplateId(10)).data(),
+            store_.GetMessage(10, &buffer).data());
+
+  // A template goes with the last row that refers to it.
+  LogStore::Retention retention;
+  retention.max_rows = 3;
+  store_.set_retention(retention);
+  EXPECT_EQ(9, store_.first_row());
+  EXPECT_EQ(2, store_.message_templates().num_templates());
+  retention.max_rows = 2;
+  store_.set_retention(retention);
+  EXPECT_EQ(1, store_.message_templates().num_templates());
+  EXPECT_EQ("Done", GetMessage(10));
+}
+
+TEST_F(LogStoreTest, SharesStackTraces) {
+  StringTable::Atom file = file_table_.Intern("file.cc");
+  for (int i = 0; i < 10; ++i) {
+    store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, file, i, "",
+                  arraysize(trace_), trace_);
+  }
+  store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, file, 10, "", 2, trace_);
+  store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, file, 11, "", 0, NULL);
+
+  // Equal traces have equal ids, and are stored once.
+  StackTracePool::StackId id = store_.GetStackTraceId(0);
+  for (int row = 1; row < 10; ++row)
+    EXPECT_EQ(id, store_.GetStackTraceId(row));
+  EXPECT_NE(id, store_.GetStackTraceId(10));
+  EXPECT_EQ(StackTracePool::kEmptyStack, store_.GetStackTraceId(11));
+  EXPECT_EQ(3, store_.stack_pool().num_stacks());
+  StackTracePool::StackId prefix = store_.GetStackTraceId(10);
+  EXPECT_EQ(store_.stack_pool().GetBytes(id) +
+                store_.stack_pool().GetBytes(prefix),
+            store_.stack_pool().live_bytes());
+
+  // A trace goes with the last row that refers to it.
+  LogStore::Retention retention;
+  retention.max_rows = 3;
+  store_.set_retention(retention);
+  EXPECT_EQ(9, store_.first_row());
+  EXPECT_EQ(10, store_.GetLine(10));
+  EXPECT_EQ(3, store_.stack_pool().num_stacks());
+
+  retention.max_rows = 2;
+  store_.set_retention(retention);
+  EXPECT_EQ(2, store_.stack_pool().num_stacks());
+  EXPECT_EQ(store_.stack_pool().GetBytes(prefix),
+            store_.stack_pool().live_bytes());
+  EXPECT_EQ(2, store_.GetStackTraceDepth(10));
+}
+
+TEST_F(LogStoreTest, SealsColdRows) {
+  const int kHotRows = 100;
+  const int kNumRows = 3 * LogStore::kRowsPerSegment + kHotRows;
+  store_.set_hot_rows(kHotRows);
+
+  StringTable::Atom file = file_table_.Intern("file.cc");
+  for (int i = 0; i < kNumRows; ++i) {
+    // Every other message is stored whole.
+    std::string message(i % 2 == 0 ?
+        base::StringPrintf("Row %d of many", i) :
+        base::StringPrintf("Has a \x01 at %d", i));
+    store_.AddRow(TRACE_LEVEL_INFORMATION, 1, 1, time_, file, i, message,
+                  0, NULL);
+  }
+  EXPECT_EQ(3, store_.num_sealed_segments());
+
+  // Sealed and hot messages read back alike, whether cached or not.
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < kNumRows; i += 97) {
+      EXPECT_EQ(i % 2 == 0 ?
+                    base::StringPrintf("Row %d of many", i) :
+                    base::StringPrintf("Has a \x01 at %d", i),
+                GetMessage(i));
+    }
+  }
+  EXPECT_EQ("Row 0 of many", GetMessage(0));
+  EXPECT_EQ(base::StringPrintf("Has a \x01 at %d", kNumRows - 1),
+            GetMessage(kNumRows - 1));
+
+  // Segments go with their last row.
+  LogStore::Retention retention;
+  retention.max_rows = kNumRows - LogStore::kRowsPerSegment;
+  store_.set_retention(retention);
+  EXPECT_EQ(2, store_.num_sealed_segments());
+  retention.max_rows = kNumRows - 2 * LogStore::kRowsPerSegment;
+  store_.set_retention(retention);
+  EXPECT_EQ(1, store_.num_sealed_segments());
+  int row = store_.first_row();
+  EXPECT_EQ(base::StringPrintf("Row %d of many", row + row % 2),
+            GetMessage(row + row % 2));
+
+  store_.Clear();
+  EXPECT_EQ(0, store_.num_sealed_segments());
+  EXPECT_EQ(0, store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, file, 1,
+                             "fresh", 0, NULL));
+  EXPECT_EQ("fresh", GetMessage(0));
+}
+
+TEST_F(LogStoreTest, Clear) {
+  StringTable::Atom foo = file_table_.Intern("foo.cc");
+  StringTable::Atom bar = file_table_.Intern("bar.cc");
+  store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, foo, 1, "message",
+                arraysize(trace_), trace_);
+  store_.Clear();
+
+  EXPECT_EQ(0, store_.num_rows());
+
+  // Make sure we're still good to go after a clear.
+  store_.AddRow(TRACE_LEVEL_ERROR, 2, 2, time_, bar, 2, "other", 2, trace_);
+  ASSERT_EQ(1, store_.num_rows());
+  EXPECT_EQ("bar.cc", store_.GetFileName(0));
+  EXPECT_EQ("other", GetMessage(0));
+  EXPECT_EQ(2, store_.GetStackTraceDepth(0));
+}
+
+TEST_F(LogStoreTest, AddLogMessage) {
+  const char kText[] = "[1234:5678:foo\\bar.cc(42)] A message";
+  LogEvents::LogMessage msg;
+  msg.level = TRACE_LEVEL_WARNING;
+  msg.time = time_;
+  msg.message = kText;
+  msg.message_len = sizeof(kText) - 1;
+
+  // The file and line get extracted from the text.
+  ASSERT_EQ(0, store_.AddLogMessage(msg));
+  EXPECT_EQ("foo\\bar.cc", store_.GetFileName(0));
+  EXPECT_EQ(42, store_.GetLine(0));
+  EXPECT_EQ("A message", GetMessage(0));
+
+  // Explicit file information takes precedence.
+  msg.file = "baz.cc";
+  msg.file_len = 6;
+  msg.line = 7;
+  ASSERT_EQ(1, store_.AddLogMessage(msg));
+  EXPECT_EQ("baz.cc", store_.GetFileName(1));
+  EXPECT_EQ(7, store_.GetLine(1));
+
+  // Text without file information is taken verbatim.
+  LogEvents::LogMessage plain;
+  plain.message = "Plain";
+  plain.message_len = 5;
+  ASSERT_EQ(2, store_.AddLogMessage(plain));
+  EXPECT_EQ(StringTable::kEmptyAtom, store_.GetFileAtom(2));
+  EXPECT_EQ(0, store_.GetLine(2));
+  EXPECT_EQ("Plain", GetMessage(2));
+
+  // The frames are widened to addresses.
+  void* const kFrames[] = {
+    reinterpret_cast<void*>(0x1000),
+    reinterpret_cast<void*>(0x2000),
+  };
+  plain.traces = kFrames;
+  plain.trace_depth = arraysize(kFrames);
+  ASSERT_EQ(3, store_.AddLogMessage(plain));
+  std::vector<sym_util::Address> trace;
+  store_.GetStackTrace(3, &trace);
+  ASSERT_EQ(2U, trace.size());
+  EXPECT_EQ(0x1000, trace[0]);
+  EXPECT_EQ(0x2000, trace[1]);
+}
+
+TEST_F(LogStoreTest, MergeFrom) {
+  LogStore first(&file_table_);
+  LogStore second(&file_table_);
+  StringTable::Atom foo = file_table_.Intern("foo.cc");
+  base::Time time_1 = time_ + base::TimeDelta::FromSeconds(1);
+  base::Time time_2 = time_ + base::TimeDelta::FromSeconds(2);
+  base::Time time_10 = time_ + base::TimeDelta::FromSeconds(10);
+
+  first.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, foo, 1, "first 0",
+               arraysize(trace_), trace_);
+  first.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_2, foo, 2, "first 2", 0, NULL);
+  second.AddRow(TRACE_LEVEL_ERROR, 2, 2, time_, foo, 3, "second 0", 0, NULL);
+  second.AddRow(TRACE_LEVEL_ERROR, 2, 2, time_1, foo, 4, "second 1",
+                2, trace_);
+
+  // The merged rows go after anything already present.
+  store_.AddRow(TRACE_LEVEL_ERROR, 3, 3, time_10, foo, 5, "existing", 0, NULL);
+
+  std::vector<const LogStore*> sources;
+  sources.push_back(&first);
+  sources.push_back(&second);
+  store_.MergeFrom(sources, false);
+
+  ASSERT_EQ(5, store_.num_rows());
+  EXPECT_EQ("existing", GetMessage(0));
+  // Ties go to the first source.
+  EXPECT_EQ("first 0", GetMessage(1));
+  EXPECT_EQ("second 0", GetMessage(2));
+  EXPECT_EQ("second 1", GetMessage(3));
+  EXPECT_EQ("first 2", GetMessage(4));
+
+  EXPECT_EQ(arraysize(trace_), store_.GetStackTraceDepth(1));
+  EXPECT_EQ(0, store_.GetStackTraceDepth(2));
+  EXPECT_EQ(2, store_.GetStackTraceDepth(3));
+  EXPECT_EQ(time_1, store_.GetTime(3));
+  EXPECT_EQ(4, store_.GetLine(3));
+  EXPECT_EQ(2, store_.GetProcessId(3));
+  EXPECT_EQ(foo, store_.GetFileAtom(3));
+}
+
+TEST_F(LogStoreTest, RetainMaxRows) {
+  LogStore::Retention retention;
+  retention.max_rows = 1000;
+  store_.set_retention(retention);
+
+  const int kNumRows = 5000;
+  StringTable::Atom file = file_table_.Intern("file.cc");
+  for (int i = 0; i < kNumRows; ++i) {
+    std::string message(base::StringPrintf("Row %d", i));
+    EXPECT_EQ(i, store_.AddRow(TRACE_LEVEL_INFORMATION, i, i, time_, file,
+                               i, message, i % arraysize(trace_), trace_));
+  }
+
+  // The rows are evicted in chunks, and keep their numbers.
+  EXPECT_EQ(kNumRows, store_.num_rows());
+  int retained = store_.num_rows() - store_.first_row();
+  EXPECT_GE(1000, retained);
+  EXPECT_LE(1000 - 1000 / LogStore::kEvictionChunkDivisor, retained);
+
+  for (int row = store_.first_row(); row < store_.num_rows(); ++row) {
+    EXPECT_EQ(row, store_.GetProcessId(row));
+    EXPECT_EQ(row, store_.GetLine(row));
+    EXPECT_EQ(base::StringPrintf("Row %d", row),
+              GetMessage(row));
+
+    std::vector<sym_util::Address> trace;
+    store_.GetStackTrace(row, &trace);
+    EXPECT_EQ(std::vector<sym_util::Address>(
+                  trace_, trace_ + row % arraysize(trace_)),
+              trace);
+  }
+
+  // The columns hold the retained rows.
+  EXPECT_EQ(store_.first_row(), store_.process_ids()[0]);
+  EXPECT_EQ(kNumRows - 1, store_.lines()[retained - 1]);
+}
+
+TEST_F(LogStoreTest, RetainMaxBytes) {
+  // A number this long isn't split out of its message, so each row stores
+  // the message whole.
+  const std::string kMessage(1000, '7');
+  StringTable::Atom file = file_table_.Intern("file.cc");
+  for (int i = 0; i < 100; ++i) {
+    store_.AddRow(TRACE_LEVEL_INFORMATION, 1, 1, time_, file, i, kMessage,
+                  0, NULL);
+  }
+  size_t row_bytes = store_.retained_bytes() / 100;
+  EXPECT_LT(kMessage.size(), row_bytes);
+
+  // Lowering the limit evicts right away.
+  LogStore::Retention retention;
+  retention.max_bytes = 10 * row_bytes;
+  store_.set_retention(retention);
+  EXPECT_EQ(90, store_.first_row());
+  EXPECT_EQ(10 * row_bytes, store_.retained_bytes());
+  EXPECT_EQ(90, store_.GetLine(90));
+
+  // The newest row is retained regardless.
+  retention.max_bytes = 1;
+  store_.set_retention(retention);
+  EXPECT_EQ(99, store_.first_row());
+  EXPECT_EQ(100, store_.num_rows());
+  EXPECT_EQ(kMessage, GetMessage(99));
+}
+
+TEST_F(LogStoreTest, RetainMaxAge) {
+  LogStore::Retention retention;
+  retention.max_age = base::TimeDelta::FromSeconds(60);
+  store_.set_retention(retention);
+
+  // A row a second for two minutes.
+  for (int i = 0; i < 120; ++i) {
+    store_.AddRow(TRACE_LEVEL_INFORMATION, 1, 1,
+                  time_ + base::TimeDelta::FromSeconds(i),
+                  StringTable::kEmptyAtom, i, "", 0, NULL);
+  }
+
+  // The rows of the last minute are retained.
+  EXPECT_EQ(120, store_.num_rows());
+  EXPECT_LE(59, store_.first_row());
+  EXPECT_LE(store_.GetTime(119) - retention.max_age,
+            store_.GetTime(store_.first_row()));
+}
+
+TEST_F(LogStoreTest, FindRowForTime) {
+  const int kNumRows = 3 * LogStore::kTimeIndexInterval + 10;
+  base::TimeDelta ms = base::TimeDelta::FromMilliseconds(1);
+  // Rows a millisecond apart, but for one that's late and one that's early.
+  for (int i = 0; i < kNumRows; ++i) {
+    base::Time time(time_ + ms * i);
+    if (i == 300)
+      time = time_ + ms * 500;
+    else if (i == 600)
+      time = time_;
+    store_.AddRow(TRACE_LEVEL_INFORMATION, 1, 1, time,
+                  StringTable::kEmptyAtom, i, "", 0, NULL);
+  }
+
+  EXPECT_EQ(0, store_.FindRowForTime(time_ - ms));
+  EXPECT_EQ(0, store_.FindRowForTime(time_));
+  EXPECT_EQ(17, store_.FindRowForTime(time_ + ms * 17));
+  EXPECT_EQ(256, store_.FindRowForTime(time_ + ms * 256));
+  // The late row is past all the times up to it.
+  EXPECT_EQ(300, store_.FindRowForTime(time_ + ms * 400));
+  EXPECT_EQ(501, store_.FindRowForTime(time_ + ms * 501));
+  EXPECT_EQ(kNumRows - 1, store_.FindRowForTime(time_ + ms * (kNumRows - 1)));
+  EXPECT_EQ(kNumRows, store_.FindRowForTime(time_ + ms * kNumRows));
+
+  // The index follows the rows as they're evicted.
+  LogStore::Retention retention;
+  retention.max_rows = kNumRows - 100;
+  store_.set_retention(retention);
+  int first_row = store_.first_row();
+  EXPECT_LE(100, first_row);
+  EXPECT_EQ(700, store_.FindRowForTime(time_ + ms * 700));
+  // The early row's time is reached well before it.
+  EXPECT_EQ(first_row, store_.FindRowForTime(time_));
+  EXPECT_EQ(kNumRows, store_.FindRowForTime(time_ + ms * kNumRows));
+
+  store_.Clear();
+  EXPECT_EQ(0, store_.FindRowForTime(time_));
+}
+
+TEST_F(LogStoreTest, VolumeHistogram) {
+  const int kNumRows = 1000;
+  base::TimeDelta ms = base::TimeDelta::FromMilliseconds(1);
+  for (int i = 0; i < kNumRows; ++i) {
+    store_.AddRow(i % 4 == 0 ? TRACE_LEVEL_ERROR : TRACE_LEVEL_INFORMATION,
+                  1, 1, time_ + ms * i, StringTable::kEmptyAtom, i, "", 0,
+                  NULL);
+  }
+
+  const VolumeHistogram& histogram = store_.volume_histogram();
+  std::vector<VolumeHistogram::Bucket> buckets;
+  histogram.GetBuckets(histogram.start_time(), histogram.end_time(), 1,
+                       &buckets);
+  ASSERT_EQ(1U, buckets.size());
+  EXPECT_EQ(kNumRows, buckets[0].total());
+  EXPECT_EQ(kNumRows / 4, buckets[0].counts[VolumeHistogram::SEVERITY_ERROR]);
+
+  // The counts follow the rows as they're evicted.
+  LogStore::Retention retention;
+  retention.max_rows = kNumRows / 2;
+  store_.set_retention(retention);
+  int retained = store_.num_rows() - store_.first_row();
+  histogram.GetBuckets(histogram.start_time(), histogram.end_time(), 1,
+                       &buckets);
+  EXPECT_EQ(retained, buckets[0].total());
+  EXPECT_LE((time_ + ms * store_.first_row()).ToInternalValue(),
+            histogram.start_time() + VolumeHistogram::kFinestWidth);
+
+  store_.Clear();
+  EXPECT_TRUE(store_.volume_histogram().empty());
+}
+
+TEST_F(LogStoreTest, EvictionAndMessageIndex) {
+  store_.EnableMessageIndex();
+  LogStore::Retention retention;
+  retention.max_rows = 100;
+  store_.set_retention(retention);
+
+  for (int i = 0; i < 1000; ++i) {
+    std::string message(i % 100 == 50 ? "A needle" : "Some hay");
+    store_.AddRow(TRACE_LEVEL_INFORMATION, 1, 1, time_,
+                  StringTable::kEmptyAtom, i, message, 0, NULL);
+  }
+
+  // The index forgets the evicted rows along with the store.
+  const TrigramIndex* index = store_.message_index();
+  EXPECT_EQ(store_.num_rows(), index->num_rows());
+  EXPECT_EQ(store_.first_row(), index->first_row());
+  std::vector<int> rows;
+  ASSERT_TRUE(index->GetCandidateRows("needle", 0, 1000, &rows));
+  ASSERT_FALSE(rows.empty());
+  EXPECT_LE(store_.first_row(), rows.front());
+
+  // An index enabled on an evicted store numbers its rows alike.
+  LogStore other(&file_table_);
+  other.set_retention(retention);
+  for (int i = 0; i < 1000; ++i) {
+    other.AddRow(TRACE_LEVEL_INFORMATION, 1, 1, time_,
+                 StringTable::kEmptyAtom, i, i == 999 ? "Last" : "Row", 0,
+                 NULL);
+  }
+  other.EnableMessageIndex();
+  ASSERT_TRUE(other.message_index()->GetCandidateRows("last", 0, 1000,
+                                                      &rows));
+  ASSERT_FALSE(rows.empty());
+  EXPECT_EQ(999, rows.back());
+
+  // A clear starts the numbering over.
+  store_.Clear();
+  EXPECT_EQ(0, store_.first_row());
+  EXPECT_EQ(0, store_.retained_bytes());
+  EXPECT_EQ(0, store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_,
+                             StringTable::kEmptyAtom, 0, "again", 0, NULL));
+}
+
+TEST_F(LogStoreTest, PostingLists) {
+  LogStore::Retention retention;
+  retention.max_rows = 100;
+  store_.set_retention(retention);
+
+  for (int i = 0; i < 1000; ++i) {
+    store_.AddRow(i % 10 == 0 ? TRACE_LEVEL_ERROR : TRACE_LEVEL_INFORMATION,
+                  i % 3, 1, time_, StringTable::kEmptyAtom, i, "Row", 0,
+                  NULL);
+  }
+  LogEvents::EventLoss loss;
+  loss.time = time_;
+  int marker = store_.AddLossMarker(loss);
+
+  // The lists follow the store's rows, and forget the evicted ones.
+  const RowPostingIndex& severities = store_.severity_postings();
+  EXPECT_EQ(store_.num_rows(), severities.num_rows());
+  EXPECT_EQ(store_.first_row(), severities.first_row());
+  std::vector<int> rows;
+  severities.GetRows(TRACE_LEVEL_ERROR, 0, store_.num_rows(), &rows);
+  ASSERT_FALSE(rows.empty());
+  EXPECT_LE(store_.first_row(), rows.front());
+  for (size_t i = 0; i < rows.size(); ++i)
+    EXPECT_EQ(TRACE_LEVEL_ERROR, store_.GetSeverity(rows[i]));
+
+  rows.clear();
+  store_.process_postings().GetRows(2, 0, store_.num_rows(), &rows);
+  ASSERT_FALSE(rows.empty());
+  for (size_t i = 0; i < rows.size(); ++i)
+    EXPECT_EQ(2U, store_.GetProcessId(rows[i]));
+
+  ASSERT_EQ(1U, store_.loss_marker_rows().size());
+  EXPECT_EQ(marker, store_.loss_marker_rows()[0]);
+
+  store_.Clear();
+  EXPECT_EQ(0, store_.severity_postings().num_rows());
+  EXPECT_EQ(-1, store_.process_postings().GetLastRow(2));
+  EXPECT_TRUE(store_.loss_marker_rows().empty());
+}
+
+TEST_F(LogStoreTest, MergeFromEvictedSource) {
+  LogStore source(&file_table_);
+  LogStore::Retention retention;
+  retention.max_rows = 10;
+  source.set_retention(retention);
+  for (int i = 0; i < 100; ++i) {
+    source.AddRow(TRACE_LEVEL_INFORMATION, 1, 1,
+                  time_ + base::TimeDelta::FromSeconds(i),
+                  StringTable::kEmptyAtom, i, "", 0, NULL);
+  }
+
+  std::vector<const LogStore*> sources(1, &source);
+  store_.MergeFrom(sources, false);
+  ASSERT_EQ(source.num_rows() - source.first_row(), store_.num_rows());
+  EXPECT_EQ(source.first_row(), store_.GetLine(0));
+  EXPECT_EQ(99, store_.GetLine(store_.num_rows() - 1));
+}
+
+TEST_F(LogStoreTest, MergeFromDropsDuplicates) {
+  // Two rotated logs, whose clocks put the events they share a
+  // microsecond apart, and which the second tells apart from a row of its
+  // own at the same time.
+  StringTable::Atom foo = file_table_.Intern("foo.cc");
+  LogStore first(&file_table_);
+  LogStore second(&file_table_);
+  for (int i = 0; i < 15; ++i) {
+    base::Time time = time_ + base::TimeDelta::FromSeconds(i);
+    std::string message = base::StringPrintf("row %d", i);
+    if (i < 10)
+      first.AddRow(TRACE_LEVEL_INFORMATION, 1, 1, time, foo, i, message,
+                   0, NULL);
+    if (i >= 5) {
+      second.AddRow(TRACE_LEVEL_INFORMATION, 1, 1,
+                    time + base::TimeDelta::FromMicroseconds(1), foo, i,
+                    message, 0, NULL);
+    }
+    if (i == 7) {
+      second.AddRow(TRACE_LEVEL_INFORMATION, 1, 1,
+                    time + base::TimeDelta::FromMicroseconds(1), foo, i,
+                    "another row", 0, NULL);
+    }
+  }
+
+  std::vector<const LogStore*> sources;
+  sources.push_back(&first);
+  sources.push_back(&second);
+  EXPECT_EQ(5U, store_.MergeFrom(sources, true));
+  ASSERT_EQ(16, store_.num_rows());
+  for (int row = 0; row < 8; ++row)
+    EXPECT_EQ(row, store_.GetLine(row));
+  EXPECT_EQ("another row", GetMessage(8));
+  for (int row = 9; row < 16; ++row)
+    EXPECT_EQ(row - 1, store_.GetLine(row));
+
+  // Without dropping them, they're all there.
+  LogStore all(&file_table_);
+  EXPECT_EQ(0U, all.MergeFrom(sources, false));
+  EXPECT_EQ(21, all.num_rows());
+}
+
+TEST_F(LogStoreTest, MessageIndex) {
+  EXPECT_TRUE(store_.message_index() == NULL);
+
+  StringTable::Atom file = file_table_.Intern("file.cc");
+  store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, file, 1, "before", 0, NULL);
+  store_.EnableMessageIndex();
+  ASSERT_TRUE(store_.message_index() != NULL);
+  store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, file, 2, "after", 0, NULL);
+
+  const TrigramIndex* index = store_.message_index();
+  EXPECT_EQ(2, index->num_rows());
+  std::vector<int> rows;
+  ASSERT_TRUE(index->GetCandidateRows("before", 0, 2, &rows));
+  EXPECT_EQ(0, rows.front());
+  ASSERT_TRUE(index->GetCandidateRows("after", 0, 2, &rows));
+  EXPECT_EQ(1, rows.back());
+
+  // The index follows the store through a clear.
+  store_.Clear();
+  EXPECT_EQ(0, index->num_rows());
+  store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, file, 3, "again", 0, NULL);
+  EXPECT_EQ(1, index->num_rows());
+}
+
+TEST_F(LogStoreTest, CollapseRepeats) {
+  store_.set_collapse_repeats(true);
+  StringTable::Atom foo = file_table_.Intern("foo.cc");
+  base::TimeDelta second = base::TimeDelta::FromSeconds(1);
+
+  EXPECT_EQ(0, store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, foo, 1,
+                             "repeat", 2, trace_));
+  // Another thread doesn't break the run.
+  EXPECT_EQ(1, store_.AddRow(TRACE_LEVEL_ERROR, 1, 2, time_, foo, 1,
+                             "repeat", 2, trace_));
+  EXPECT_EQ(0, store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_ + second, foo, 1,
+                             "repeat", 2, trace_));
+  EXPECT_EQ(0, store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_ + second * 2,
+                             foo, 1, "repeat", 2, trace_));
+
+  // Any difference makes a new row.
+  EXPECT_EQ(2, store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, foo, 1,
+                             "repeat", 1, trace_));
+  EXPECT_EQ(3, store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, foo, 2,
+                             "repeat", 1, trace_));
+  EXPECT_EQ(4, store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, foo, 2,
+                             "repeal", 1, trace_));
+  // And only the last row of the thread is repeated.
+  EXPECT_EQ(5, store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, foo, 1,
+                             "repeat", 2, trace_));
+
+  ASSERT_EQ(6, store_.num_rows());
+  EXPECT_EQ(3, store_.GetRepeatCount(0));
+  EXPECT_EQ(time_, store_.GetTime(0));
+  EXPECT_EQ(time_ + second * 2, store_.GetLastTime(0));
+  EXPECT_EQ(1, store_.GetRepeatCount(1));
+  EXPECT_EQ(time_, store_.GetLastTime(1));
+  EXPECT_EQ(1, store_.GetRepeatCount(5));
+
+  // Copies carry their repeats.
+  LogStore copy(&file_table_);
+  EXPECT_EQ(0, copy.AppendRow(store_, 0));
+  EXPECT_EQ(3, copy.GetRepeatCount(0));
+  EXPECT_EQ(time_ + second * 2, copy.GetLastTime(0));
+
+  store_.Clear();
+  EXPECT_EQ(0, store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, foo, 1,
+                             "repeat", 2, trace_));
+  EXPECT_EQ(1, store_.GetRepeatCount(0));
+}
+
+TEST_F(LogStoreTest, CollapseRepeatsAndEviction) {
+  store_.set_collapse_repeats(true);
+  LogStore::Retention retention;
+  retention.max_rows = 2;
+  store_.set_retention(retention);
+
+  store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, 0, 0, "one", 0, NULL);
+  store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, 0, 0, "one", 0, NULL);
+  store_.AddRow(TRACE_LEVEL_ERROR, 1, 2, time_, 0, 0, "two", 0, NULL);
+  EXPECT_EQ(2, store_.GetRepeatCount(0));
+  store_.AddRow(TRACE_LEVEL_ERROR, 1, 2, time_, 0, 0, "three", 0, NULL);
+  ASSERT_EQ(1, store_.first_row());
+
+  // Row zero's gone, so its repeat makes a new row.
+  EXPECT_EQ(3, store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, 0, 0, "one",
+                             0, NULL));
+  EXPECT_EQ(1, store_.GetRepeatCount(3));
+}
+
+TEST_F(LogStoreTest, LossMarkers) {
+  store_.set_collapse_repeats(true);
+  LogEvents::EventLoss loss;
+  loss.time = time_;
+  loss.type = LogEvents::EventLoss::BUFFERS_LOST;
+  loss.count = 3;
+
+  EXPECT_EQ(0, store_.AddRow(TRACE_LEVEL_ERROR, 1, 1, time_, 0, 0, "one",
+                             0, NULL));
+  EXPECT_EQ(1, store_.AddLossMarker(loss));
+  // Markers don't collapse.
+  EXPECT_EQ(2, store_.AddLossMarker(loss));
+  loss.type = LogEvents::EventLoss::EVENTS_LOST;
+  loss.count = 0;
+  EXPECT_EQ(3, store_.AddLossMarker(loss));
+
+  EXPECT_FALSE(store_.IsLossMarker(0));
+  EXPECT_TRUE(store_.IsLossMarker(1));
+  EXPECT_TRUE(store_.IsLossMarker(3));
+  EXPECT_EQ(1, store_.GetRepeatCount(1));
+  EXPECT_EQ(TRACE_LEVEL_WARNING, store_.GetSeverity(1));
+  EXPECT_EQ(LogStore::kLossMarkerFile, store_.GetFileName(1));
+  EXPECT_EQ(time_, store_.GetTime(1));
+  std::string buffer;
+  EXPECT_EQ("3 buffers lost", store_.GetMessage(1, &buffer).as_string());
+  EXPECT_EQ("Events lost", store_.GetMessage(3, &buffer).as_string());
+
+  // Stores sharing a file table share the marker's atom.
+  LogStore other(&file_table_);
+  EXPECT_EQ(store_.loss_marker_file(), other.loss_marker_file());
+  other.AppendRow(store_, 1);
+  EXPECT_TRUE(other.IsLossMarker(0));
+}
+
+TEST_F(LogStoreTest, MemoryUsage) {
+  // A typical row, as stored in the previous row-wise representation.
+  struct RowWise {
+    UCHAR level;
+    DWORD process_id;
+    DWORD thread_id;
+    base::Time time_stamp;
+    std::string file;
+    int line;
+    std::string message;
+    std::vector<void*> trace;
+  };
+
+  const char kMessage[] = "Some typical log message of moderate length";
+  const int kNumRows = 100000;
+  StringTable::Atom file = file_table_.Intern("chrome\\browser\\some_file.cc");
+  for (int i = 0; i < kNumRows; ++i) {
+    store_.AddRow(TRACE_LEVEL_INFORMATION, 1, 1, time_, file, i,
+                  kMessage, arraysize(trace_), trace_);
+  }
+
+  // The heap cost of a row-wise row is at least the struct, the message
+  // and the trace.
+  size_t row_wise_usage = kNumRows * (sizeof(RowWise) + sizeof(kMessage) +
+      sizeof(trace_));
+
+  EXPECT_LT(store_.GetMemoryUsage(), row_wise_usage);
+}
+
+}  // namespace
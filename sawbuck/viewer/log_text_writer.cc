@@ -0,0 +1,147 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log text writer implementation.
+#include "sawbuck/viewer/log_text_writer.h"
+
+#include <algorithm>
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/strings/string_util.h"
+#include "sawbuck/common/perf_counters.h"
+#include "sawbuck/common/task_pool.h"
+#include "sawbuck/viewer/log_list_view.h"
+#include "sawbuck/viewer/row_batch.h"
+
+namespace {
+
+PerfCounter format_chunk_counter("TextWriter.Chunk", 1);
+
+// No more threads than this format a batch.
+const size_t kMaxFormatThreads = 8;
+
+}  // namespace
+
+const size_t LogTextWriter::kRowsPerChunk;
+
+LogTextWriter::LogTextWriter(ILogView* view, base::Time base_time)
+    : view_(view),
+      base_time_(base_time),
+      max_threads_(std::min(TaskPool::Get()->num_workers() + 1,
+                            kMaxFormatThreads)) {
+  DCHECK(view_ != NULL);
+}
+
+LogTextWriter::~LogTextWriter() {
+}
+
+bool LogTextWriter::WriteRows(const std::vector<int>& rows, Sink* sink) {
+  DCHECK(sink != NULL);
+
+  LogViewFormatter formatter;
+  formatter.set_base_time(base_time_);
+  std::string text;
+
+  size_t written = 0;
+  while (written < rows.size()) {
+    // Figure how many chunks to format, and how many threads to spread
+    // them over.
+    size_t remaining = rows.size() - written;
+    size_t num_chunks = std::max<size_t>(1, std::min(
+        max_threads_, (remaining + kRowsPerChunk - 1) / kRowsPerChunk));
+    EnsureFormatters(num_chunks - 1);
+
+    // Hand the later chunks to the task pool, then format the first chunk
+    // ourselves, and pass the text on in order.
+    std::vector<std::string> chunk_text(num_chunks - 1);
+    TaskPool::TaskGroup group(TaskPool::Get(), TaskPool::PRIORITY_INTERACTIVE,
+                              &format_chunk_counter);
+    for (size_t i = 1; i < num_chunks; ++i) {
+      size_t begin = std::min(written + i * kRowsPerChunk, rows.size());
+      size_t end = std::min(begin + kRowsPerChunk, rows.size());
+      group.Post(base::Bind(&LogTextWriter::FormatRows, view_,
+                            formatters_[i - 1], &rows[begin], end - begin,
+                            &chunk_text[i - 1]));
+    }
+
+    size_t end = std::min(written + kRowsPerChunk, rows.size());
+    text.clear();
+    FormatRows(view_, &formatter, &rows[written], end - written, &text);
+    bool carry_on = sink->Write(text);
+
+    // The chunks must be done before we return, even if the sink stops.
+    if (!carry_on)
+      group.Cancel();
+    group.Wait();
+    for (size_t i = 1; carry_on && i < num_chunks; ++i)
+      carry_on = sink->Write(chunk_text[i - 1]);
+
+    if (!carry_on)
+      return false;
+
+    written = std::min(written + num_chunks * kRowsPerChunk, rows.size());
+  }
+
+  return true;
+}
+
+void LogTextWriter::FormatRows(ILogView* view,
+                               LogViewFormatter* formatter,
+                               const int* rows,
+                               size_t num_rows,
+                               std::string* text) {
+  DCHECK(view != NULL);
+  DCHECK(formatter != NULL);
+  DCHECK(text != NULL);
+
+  RowBatch batch;
+  std::string cell;
+  size_t i = 0;
+  while (i < num_rows) {
+    // Runs of consecutive rows are fetched as a batch, a column at a time.
+    size_t run = 1;
+    while (i + run < num_rows &&
+           rows[i + run] == rows[i] + static_cast<int>(run)) {
+      ++run;
+    }
+    view->GetRows(rows[i], static_cast<int>(run),
+                  RowBatch::FORMATTED_COLUMNS, &batch);
+
+    for (size_t j = 0; j < run; ++j) {
+      for (int col = 0; col < LogViewFormatter::NUM_COLUMNS; ++col) {
+        cell.clear();
+        formatter->FormatBatchColumn(
+            batch, static_cast<int>(j),
+            static_cast<LogViewFormatter::Column>(col), &cell);
+        base::TrimWhitespaceASCII(cell, base::TRIM_TRAILING, &cell);
+
+        // Tab separate the columns.
+        if (col != 0)
+          text->push_back('\t');
+        text->append(cell);
+      }
+
+      // Lines are CRLF separated, as on the clipboard.
+      text->append("\r\n");
+    }
+    i += run;
+  }
+}
+
+void LogTextWriter::EnsureFormatters(size_t num_formatters) {
+  while (formatters_.size() < num_formatters) {
+    formatters_.push_back(new LogViewFormatter());
+    formatters_.back()->set_base_time(base_time_);
+  }
+}
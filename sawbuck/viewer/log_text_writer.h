@@ -0,0 +1,87 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log text writer declaration.
+#ifndef SAWBUCK_VIEWER_LOG_TEXT_WRITER_H_
+#define SAWBUCK_VIEWER_LOG_TEXT_WRITER_H_
+
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/memory/scoped_vector.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+
+// Forward decls.
+class ILogView;
+class LogViewFormatter;
+
+// Writes log rows out as text, a line per row with the columns tab
+// separated, as the log list view displays them.
+//
+// The text goes to a sink a chunk at a time, so a large selection never
+// needs to be held as text in full. Chunks are formatted in batches,
+// spread over the task pool, and handed to the sink in order.
+// The view is only read while the writer runs, and the writer blocks the
+// thread it runs on until it's done, so the view needn't be thread safe for
+// writes.
+class LogTextWriter {
+ public:
+  // Receives the text of the rows written.
+  class Sink {
+   public:
+    // @param text the UTF8 text of a chunk of rows.
+    // @returns true to carry on, false to stop writing.
+    virtual bool Write(const base::StringPiece& text) = 0;
+  };
+
+  // @param view the view to write rows from, must outlive this instance.
+  // @param base_time the base time the time stamps are relative to, if
+  //     not null.
+  LogTextWriter(ILogView* view, base::Time base_time);
+  ~LogTextWriter();
+
+  // Writes @p rows of the view to @p sink, in the order given.
+  // @returns true if all rows were written, false if the sink stopped.
+  bool WriteRows(const std::vector<int>& rows, Sink* sink);
+
+  // Appends the text of @p num_rows rows at @p rows to @p text.
+  static void FormatRows(ILogView* view,
+                         LogViewFormatter* formatter,
+                         const int* rows,
+                         size_t num_rows,
+                         std::string* text);
+
+  // For testing.
+  void set_max_threads(size_t max_threads) { max_threads_ = max_threads; }
+
+  // The number of rows in a chunk.
+  static const size_t kRowsPerChunk = 1024;
+
+ private:
+  // Makes sure there's a formatter for each of @p num_formatters chunks
+  // after the first of a batch.
+  void EnsureFormatters(size_t num_formatters);
+
+  ILogView* view_;
+  base::Time base_time_;
+
+  size_t max_threads_;
+  // Each chunk of a batch has its own formatter, as formatters cache.
+  ScopedVector<LogViewFormatter> formatters_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogTextWriter);
+};
+
+#endif  // SAWBUCK_VIEWER_LOG_TEXT_WRITER_H_
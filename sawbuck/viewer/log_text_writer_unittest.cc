@@ -0,0 +1,152 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/log_text_writer.h"
+
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/mock_log_view_interfaces.h"
+
+namespace {
+
+using testing::_;
+using testing::Invoke;
+using testing::Return;
+using testing::StrictMock;
+
+const int kNumRows = 10000;
+
+base::Time GetTime(int row) {
+  return base::Time::FromInternalValue(12345678900000LL + row * 1000);
+}
+
+std::string GetMessage(int row) {
+  // Trailing whitespace is trimmed.
+  return base::StringPrintf("Message %d\n", row);
+}
+
+// Collects the text, and stops after a number of chunks if asked.
+class StringSink : public LogTextWriter::Sink {
+ public:
+  explicit StringSink(int max_chunks) : max_chunks_(max_chunks),
+                                        num_chunks_(0) {
+  }
+
+  virtual bool Write(const base::StringPiece& text) {
+    text.AppendToString(&text_);
+    return ++num_chunks_ != max_chunks_;
+  }
+
+  const std::string& text() const { return text_; }
+  int num_chunks() const { return num_chunks_; }
+
+ private:
+  std::string text_;
+  int max_chunks_;
+  int num_chunks_;
+};
+
+class LogTextWriterTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    EXPECT_CALL(view_, GetSeverity(_)).WillRepeatedly(Return(4));
+    EXPECT_CALL(view_, GetProcessId(_)).WillRepeatedly(Return(1234));
+    EXPECT_CALL(view_, GetThreadId(_)).WillRepeatedly(Return(5678));
+    EXPECT_CALL(view_, GetTime(_)).WillRepeatedly(Invoke(GetTime));
+    EXPECT_CALL(view_, GetFileName(_)).WillRepeatedly(Return("file.cc"));
+    EXPECT_CALL(view_, GetLine(_)).WillRepeatedly(Return(42));
+    EXPECT_CALL(view_, GetMessage(_)).WillRepeatedly(Invoke(GetMessage));
+  }
+
+  // @returns the text of @p rows, formatted the slow way.
+  std::string FormatRows(const std::vector<int>& rows, base::Time base_time) {
+    std::string text;
+    for (size_t i = 0; i < rows.size(); ++i) {
+      LogViewFormatter formatter;
+      formatter.set_base_time(base_time);
+      for (int col = 0; col < LogViewFormatter::NUM_COLUMNS; ++col) {
+        std::string cell;
+        formatter.FormatColumn(&view_, rows[i],
+                               static_cast<LogViewFormatter::Column>(col),
+                               &cell);
+        base::TrimWhitespaceASCII(cell, base::TRIM_TRAILING, &cell);
+        if (col != 0)
+          text += '\t';
+        text += cell;
+      }
+      text += "\r\n";
+    }
+    return text;
+  }
+
+ protected:
+  StrictMock<testing::MockILogView> view_;
+};
+
+TEST_F(LogTextWriterTest, NoRows) {
+  LogTextWriter writer(&view_, base::Time());
+  StringSink sink(-1);
+  EXPECT_TRUE(writer.WriteRows(std::vector<int>(), &sink));
+  EXPECT_EQ(0, sink.num_chunks());
+}
+
+TEST_F(LogTextWriterTest, FormatRows) {
+  const int kRows[] = { 7, 3 };
+  std::vector<int> rows(kRows, kRows + arraysize(kRows));
+
+  LogViewFormatter formatter;
+  std::string text;
+  LogTextWriter::FormatRows(&view_, &formatter, &rows[0], rows.size(), &text);
+  EXPECT_EQ(FormatRows(rows, base::Time()), text);
+  EXPECT_NE(std::string::npos, text.find("\tfile.cc\t42\tMessage 7\r\n"));
+}
+
+TEST_F(LogTextWriterTest, WriteRows) {
+  std::vector<int> rows;
+  for (int row = 0; row < kNumRows; row += 2)
+    rows.push_back(row);
+  rows.push_back(1);
+
+  base::Time base_time(GetTime(100));
+  LogTextWriter writer(&view_, base_time);
+  writer.set_max_threads(3);
+
+  StringSink sink(-1);
+  ASSERT_TRUE(writer.WriteRows(rows, &sink));
+  EXPECT_EQ(static_cast<int>((rows.size() + LogTextWriter::kRowsPerChunk - 1) /
+                             LogTextWriter::kRowsPerChunk),
+            sink.num_chunks());
+  EXPECT_EQ(FormatRows(rows, base_time), sink.text());
+}
+
+TEST_F(LogTextWriterTest, SinkStops) {
+  std::vector<int> rows;
+  for (int row = 0; row < kNumRows; ++row)
+    rows.push_back(row);
+
+  LogTextWriter writer(&view_, base::Time());
+  writer.set_max_threads(4);
+
+  StringSink sink(2);
+  EXPECT_FALSE(writer.WriteRows(rows, &sink));
+  EXPECT_EQ(2, sink.num_chunks());
+
+  // The writer is good for another go.
+  StringSink all_sink(-1);
+  EXPECT_TRUE(writer.WriteRows(rows, &all_sink));
+  EXPECT_EQ(FormatRows(rows, base::Time()), all_sink.text());
+}
+
+}  // namespace
@@ -16,14 +16,66 @@
 #include "sawbuck/viewer/log_viewer.h"
 
 #include <atlbase.h>
+#include <atldlgs.h>
 #include <atlframe.h>
+#include <algorithm>
+#include <sstream>
+#include "base/bind.h"
+#include "base/files/file_path.h"
+#include "base/logging.h"
 #include "base/strings/string_util.h"
 #include "base/strings/utf_string_conversions.h"
 #include "pcrecpp.h"  // NOLINT
 #include "sawbuck/viewer/filtered_log_view.h"
 #include "sawbuck/viewer/filter_dialog.h"
 #include "sawbuck/viewer/const_config.h"
+#include "sawbuck/viewer/log_diff.h"
+#include "sawbuck/viewer/log_index.h"
+#include "sawbuck/viewer/log_store.h"
 #include "sawbuck/viewer/preferences.h"
+#include "sawbuck/viewer/query_dialog.h"
+#include "sawbuck/viewer/sorted_log_view.h"
+
+namespace {
+
+// The most groups a summary lists.
+const size_t kMaxSummaryGroups = 25;
+// The most groups and span names a comparison lists.
+const size_t kMaxCompareGroups = 25;
+const size_t kMaxCompareSpans = 10;
+
+_COMDLG_FILTERSPEC kBaselineFileSpec[] = {
+  {L"Sawbuck Session", L"*.sbsession"},
+  {L"Indexed Capture", L"*.etl"},
+};
+
+// @returns the quick filter that hides the rows less severe than warnings.
+// It's an exclusion, so it narrows whatever other filters are in effect.
+Filter GetWarningsOnlyFilter() {
+  return Filter(Filter::SEVERITY, Filter::IS, Filter::EXCLUDE,
+                L"INFORMATION|VERBOSE|RESERVED\\d|UNKNOWN");
+}
+
+// Appends "<baseline> -> <current>" to @p text.
+template <class T>
+void AppendChange(const T& baseline, const T& current,
+                  std::wstringstream* text) {
+  *text << baseline << L" -> " << current;
+}
+
+}  // namespace
+
+LRESULT LogViewerBottomPane::OnCommand(UINT msg,
+                                       WPARAM wparam,
+                                       LPARAM lparam,
+                                       BOOL& handled) {
+  HWND window = GetSplitterPane(GetActivePane());
+  if (window == NULL) {
+    handled = FALSE;
+    return 0;
+  }
+  return ::SendMessage(window, msg, wparam, lparam);
+}
 
 LogViewer::LogViewer(CUpdateUIBase* update_ui)
     : log_list_view_(update_ui),
@@ -53,32 +105,96 @@ int LogViewer::OnCreate(LPCREATESTRUCT create_struct) {
   // Create the log list view.
   log_list_view_.Create(m_hWnd);
 
-  // Create the stack trace list view.
-  stack_trace_list_view_.Create(m_hWnd);
+  // Create the bottom pane, with the stack trace list view to the left of
+  // the process tree, the report information, the timeline and the memory
+  // chart.
+  bottom_pane_.Create(m_hWnd, rcDefault, NULL,
+                      WS_CHILD | WS_VISIBLE | WS_CLIPCHILDREN |
+                      WS_CLIPSIBLINGS);
+  stack_trace_list_view_.Create(bottom_pane_.m_hWnd);
+  detail_pane_.Create(bottom_pane_.m_hWnd, rcDefault, NULL,
+                      WS_CHILD | WS_VISIBLE | WS_CLIPCHILDREN |
+                      WS_CLIPSIBLINGS);
+  report_pane_.Create(detail_pane_.m_hWnd, rcDefault, NULL,
+                      WS_CHILD | WS_VISIBLE | WS_CLIPCHILDREN |
+                      WS_CLIPSIBLINGS);
+  process_tree_view_.Create(report_pane_.m_hWnd);
+  report_text_view_.Create(report_pane_.m_hWnd, rcDefault, NULL,
+                           WS_CHILD | WS_VISIBLE | WS_VSCROLL | WS_HSCROLL |
+                           ES_MULTILINE | ES_READONLY | ES_AUTOVSCROLL |
+                           ES_AUTOHSCROLL,
+                           WS_EX_CLIENTEDGE);
+  // The registry extract alone tends to exceed the default limit.
+  report_text_view_.SetLimitText(0);
+  chart_pane_.Create(detail_pane_.m_hWnd, rcDefault, NULL,
+                     WS_CHILD | WS_VISIBLE | WS_CLIPCHILDREN |
+                     WS_CLIPSIBLINGS);
+  timeline_view_.Create(chart_pane_.m_hWnd, rcDefault, NULL,
+                        WS_CHILD | WS_VISIBLE, WS_EX_CLIENTEDGE);
+  memory_chart_view_.Create(chart_pane_.m_hWnd, rcDefault, NULL,
+                            WS_CHILD | WS_VISIBLE, WS_EX_CLIENTEDGE);
 
   log_list_view_.set_stack_trace_view(&stack_trace_list_view_);
+  process_tree_view_.set_filter_callback(
+      base::Bind(&LogViewer::AddFilter, base::Unretained(this)));
+  memory_chart_view_.set_time_callback(
+      base::Bind(&LogViewer::GoToTime, base::Unretained(this)));
+
+  // The report information only shows once there's a report.
+  report_pane_.SetDefaultActivePane(SPLIT_PANE_LEFT);
+  report_pane_.SetSplitterPanes(process_tree_view_.m_hWnd,
+                                report_text_view_.m_hWnd);
+  report_pane_.SetSplitterExtendedStyle(SPLIT_RIGHTALIGNED);
+  report_pane_.SetSinglePaneMode(SPLIT_PANE_LEFT);
+
+  chart_pane_.SetSplitterPanes(timeline_view_.m_hWnd,
+                               memory_chart_view_.m_hWnd);
+
+  detail_pane_.SetDefaultActivePane(SPLIT_PANE_LEFT);
+  detail_pane_.SetSplitterPanes(report_pane_.m_hWnd,
+                                chart_pane_.m_hWnd);
+  detail_pane_.SetSplitterExtendedStyle(SPLIT_RIGHTALIGNED);
+
+  bottom_pane_.SetDefaultActivePane(SPLIT_PANE_LEFT);
+  bottom_pane_.SetSplitterPanes(stack_trace_list_view_.m_hWnd,
+                                detail_pane_.m_hWnd);
+  bottom_pane_.SetSplitterExtendedStyle(SPLIT_RIGHTALIGNED);
 
   SetDefaultActivePane(SPLIT_PANE_TOP);
-  SetSplitterPanes(log_list_view_.m_hWnd, stack_trace_list_view_.m_hWnd);
+  SetSplitterPanes(log_list_view_.m_hWnd, bottom_pane_.m_hWnd);
   SetSplitterExtendedStyle(SPLIT_BOTTOMALIGNED);
 
   // This is enabled so long as we live.
   update_ui_->UIEnable(ID_LOG_FILTER, true);
+  update_ui_->UIEnable(ID_LOG_SORT_BY_TIME, true);
+  update_ui_->UIEnable(ID_LOG_WARNINGS_ONLY, true);
+  update_ui_->UIEnable(ID_LOG_QUERY, true);
+
+  // The filtered views filter the new rows of the log as one.
+  filter_scan_.reset(new FilterScan(log_view_));
 
   // Read in any previously set filters.
   std::string filter_string;
   Preferences prefs;
   prefs.ReadStringValue(config::kFilterValues, &filter_string, "");
   if (!filter_string.empty()) {
-    std::vector<Filter> filters(Filter::DeserializeFilters(filter_string));
-    if (!filters.empty()) {
-      scoped_ptr<FilteredLogView> new_view(new FilteredLogView(log_view_,
-                                                               filters));
+    filters_ = Filter::DeserializeFilters(filter_string);
+    if (!filters_.empty()) {
+      scoped_ptr<FilteredLogView> new_view(
+          new FilteredLogView(filter_scan_.get(), filters_));
       log_list_view_.SetLogView(new_view.get());
       filtered_log_view_.reset(new_view.release());
     }
   }
 
+  // And any previously set highlight rules.
+  std::string rule_string;
+  prefs.ReadStringValue(config::kHighlightRulesValue, &rule_string, "");
+  if (!rule_string.empty()) {
+    log_list_view_.SetHighlightRules(
+        RowHighlighter::DeserializeRules(rule_string));
+  }
+
   SetMsgHandled(FALSE);
   return 1;
 }
@@ -92,21 +208,281 @@ LRESULT LogViewer::OnCommand(UINT msg,
 }
 
 void LogViewer::OnLogFilter(UINT code, int id, CWindow window) {
-  FilterDialog dialog;
-
-  if (dialog.DoModal(m_hWnd) == IDOK) {
-    std::vector<Filter> filters = dialog.get_filters();
-    Preferences pref;
-    pref.WriteStringValue(config::kFilterValues,
-                          Filter::SerializeFilters(filters));
-
-    // TODO(robertshield): If dialog.get_filters() is empty, we should set it
-    // back to the non filtered log view.
-    scoped_ptr<FilteredLogView> new_view(new FilteredLogView(log_view_,
-                                                             filters));
-    log_list_view_.SetLogView(new_view.get());
-    filtered_log_view_.reset(new_view.release());
+  FilterDialog dialog(GetUnfilteredLogView());
+
+  if (dialog.DoModal(m_hWnd) == IDOK)
+    SetFilters(dialog.get_filters());
+}
+
+void LogViewer::SetFilters(const std::vector<Filter>& filters) {
+  filters_ = filters;
+  bool warnings_only = std::find(filters_.begin(), filters_.end(),
+                                 GetWarningsOnlyFilter()) != filters_.end();
+  update_ui_->UISetCheck(ID_LOG_WARNINGS_ONLY, warnings_only);
+  Preferences pref;
+  pref.WriteStringValue(config::kFilterValues,
+                        Filter::SerializeFilters(filters_));
+
+  aggregator_.reset();
+  if (filters_.empty()) {
+    log_list_view_.SetLogView(GetUnfilteredLogView());
+    filtered_log_view_.reset();
+    return;
+  }
+
+  scoped_ptr<FilteredLogView> new_view(
+      new FilteredLogView(filter_scan_.get(), filters_));
+  log_list_view_.SetLogView(new_view.get());
+  filtered_log_view_.reset(new_view.release());
+}
+
+void LogViewer::AddFilter(const Filter& filter) {
+  std::vector<Filter> filters(GetFilters());
+  if (std::find(filters.begin(), filters.end(), filter) != filters.end())
+    return;
+
+  filters.push_back(filter);
+  SetFilters(filters);
+}
+
+void LogViewer::SetReportTexts(
+    const std::vector<ReportArchive::TextEntry>& texts) {
+  // Nothing shows before we're created, nor once we're destroyed.
+  if (!report_text_view_.IsWindow())
+    return;
+
+  if (texts.empty()) {
+    report_text_view_.SetWindowText(L"");
+    report_pane_.SetSinglePaneMode(SPLIT_PANE_LEFT);
+    return;
+  }
+
+  // Each entry goes under its name, with the line ends the edit control
+  // wants.
+  std::wstring text;
+  for (size_t i = 0; i < texts.size(); ++i) {
+    text += base::UTF8ToWide(texts[i].name);
+    text += L"\r\n\r\n";
+    std::string entry_text(texts[i].text);
+    ReplaceSubstringsAfterOffset(&entry_text, 0, "\r\n", "\n");
+    ReplaceSubstringsAfterOffset(&entry_text, 0, "\n", "\r\n");
+    text += base::UTF8ToWide(entry_text);
+    text += L"\r\n\r\n";
+  }
+  report_text_view_.SetWindowText(text.c_str());
+  report_pane_.SetSinglePaneMode(SPLIT_PANE_NONE);
+}
+
+void LogViewer::SetHighlightRules(const std::vector<HighlightRule>& rules) {
+  Preferences pref;
+  pref.WriteStringValue(config::kHighlightRulesValue,
+                        RowHighlighter::SerializeRules(rules));
+  log_list_view_.SetHighlightRules(rules);
+}
+
+std::vector<Filter> LogViewer::GetFilters() const {
+  if (filtered_log_view_.get() == NULL)
+    return std::vector<Filter>();
+
+  return filters_;
+}
+
+void LogViewer::OnLogSortByTime(UINT code, int id, CWindow window) {
+  // Build the new views before the list and the aggregator let go of the
+  // old ones, which we then tear down filtered view first.
+  scoped_ptr<SortedLogView> sorted_view;
+  if (sorted_log_view_.get() == NULL)
+    sorted_view.reset(new SortedLogView(log_view_));
+
+  ILogView* unfiltered_view = sorted_view.get();
+  if (unfiltered_view == NULL)
+    unfiltered_view = log_view_;
+
+  scoped_ptr<FilterScan> filter_scan(new FilterScan(unfiltered_view));
+  scoped_ptr<FilteredLogView> filtered_view;
+  if (filtered_log_view_.get() != NULL)
+    filtered_view.reset(new FilteredLogView(filter_scan.get(), filters_));
+
+  if (filtered_view.get() != NULL)
+    log_list_view_.SetLogView(filtered_view.get());
+  else
+    log_list_view_.SetLogView(unfiltered_view);
+  aggregator_.reset();
+
+  filtered_log_view_.reset(filtered_view.release());
+  filter_scan_.reset(filter_scan.release());
+  sorted_log_view_.reset(sorted_view.release());
+
+  update_ui_->UISetCheck(ID_LOG_SORT_BY_TIME, sorted_log_view_.get() != NULL);
+}
+
+void LogViewer::OnLogWarningsOnly(UINT code, int id, CWindow window) {
+  Filter warnings_only(GetWarningsOnlyFilter());
+  std::vector<Filter> filters(GetFilters());
+  std::vector<Filter>::iterator it =
+      std::find(filters.begin(), filters.end(), warnings_only);
+  if (it != filters.end())
+    filters.erase(it);
+  else
+    filters.push_back(warnings_only);
+  SetFilters(filters);
+}
+
+void LogViewer::OnLogQuery(UINT code, int id, CWindow window) {
+  // Queries look at the store's columns directly, so at every row the
+  // store holds whatever the filters.
+  const LogStore* store = GetUnfilteredLogView()->GetLogStore();
+  if (store == NULL) {
+    ::MessageBox(m_hWnd, L"This log can't be queried.", L"Query Log",
+                 MB_OK | MB_ICONERROR);
+    return;
+  }
+
+  Preferences prefs;
+  std::string query;
+  prefs.ReadStringValue(config::kQueryValue, &query, "");
+  QueryDialog dialog(store, query);
+  dialog.DoModal(m_hWnd);
+  if (dialog.query() != query)
+    prefs.WriteStringValue(config::kQueryValue, dialog.query());
+}
+
+void LogViewer::OnLogSummarize(UINT code, int id, CWindow window) {
+  LogAggregator::GroupBy group_by = static_cast<LogAggregator::GroupBy>(
+      LogAggregator::GROUP_BY_LOCATION + id - ID_LOG_SUMMARIZE_LOCATION);
+  if (aggregator_.get() == NULL || aggregator_->group_by() != group_by) {
+    ILogView* view = filtered_log_view_.get();
+    if (view == NULL)
+      view = GetUnfilteredLogView();
+    aggregator_.reset(new LogAggregator(view, group_by));
+  }
+
+  // Only the rows that arrived since the last summary are left to tally.
+  aggregator_->AggregateAll();
+  std::vector<LogAggregator::Group> groups;
+  aggregator_->GetGroups(&groups);
+
+  const LogAggregator::Group& total = aggregator_->total();
+  std::wstringstream text;
+  text << total.count << L" rows, " << total.bytes / 1024
+      << L" KB of messages in " << groups.size() << L" groups." << std::endl;
+  text.setf(std::ios::fixed, std::ios::floatfield);
+  text.precision(1);
+  for (size_t i = 0; i < groups.size() && i < kMaxSummaryGroups; ++i) {
+    const LogAggregator::Group& group = groups[i];
+    double seconds = (group.last_time - group.first_time).InSecondsF();
+    text << std::endl << group.count << L" rows ("
+        << 100.0 * group.count / total.count << L"%), "
+        << group.bytes / 1024 << L" KB";
+    if (seconds > 0)
+      text << L", " << group.count / seconds << L" rows/s";
+    text << L": " << base::UTF8ToWide(group.name);
+  }
+  if (groups.size() > kMaxSummaryGroups) {
+    text << std::endl << std::endl << (groups.size() - kMaxSummaryGroups)
+        << L" smaller groups not shown.";
+  }
+
+  ::MessageBox(m_hWnd, text.str().c_str(), L"Log Summary", MB_OK);
+}
+
+void LogViewer::OnLogCompare(UINT code, int id, CWindow window) {
+  LogAggregator::GroupBy group_by = id == ID_LOG_COMPARE_STACK ?
+      LogAggregator::GROUP_BY_STACK : LogAggregator::GROUP_BY_LOCATION;
+
+  CShellFileOpenDialog dialog(NULL,
+                              FOS_FORCEFILESYSTEM | FOS_FILEMUSTEXIST,
+                              L"sbsession",
+                              &kBaselineFileSpec[0],
+                              arraysize(kBaselineFileSpec));
+  if (dialog.DoModal() != IDOK)
+    return;
+  std::wstring file_path;
+  file_path.resize(MAX_PATH);
+  if (FAILED(dialog.GetFilePath(&file_path[0], MAX_PATH - 1)))
+    return;
+  file_path.resize(wcslen(file_path.c_str()));
+  base::FilePath path(file_path);
+
+  // The baseline is a saved session, or a capture with an up to date
+  // index, either of which loads without parsing. Its kernel events don't
+  // concern the current log, so they go nowhere.
+  StringTable baseline_files;
+  LogStore baseline(&baseline_files);
+  LogIndex loader(NULL, NULL);
+  std::string filters;
+  if (!loader.LoadSession(path, &baseline, &filters) &&
+      !loader.Load(path, &baseline)) {
+    LOG(ERROR) << "Failed to load the baseline: " << path.value();
+    ::MessageBox(m_hWnd, L"Failed to load the baseline. A capture must be "
+                 L"imported once to index it.", L"Compare With Session",
+                 MB_OK | MB_ICONWARNING);
+    return;
   }
+
+  ILogView* view = filtered_log_view_.get();
+  if (view == NULL)
+    view = GetUnfilteredLogView();
+  LogDiff diff(group_by);
+  diff.Compare(baseline, view);
+
+  const LogAggregator::Group& baseline_total = diff.baseline_total();
+  const LogAggregator::Group& current_total = diff.current_total();
+  std::wstringstream text;
+  text << L"Rows: ";
+  AppendChange(baseline_total.count, current_total.count, &text);
+  text << L", errors: ";
+  AppendChange(baseline_total.errors, current_total.errors, &text);
+  text << L", KB: ";
+  AppendChange(baseline_total.bytes / 1024, current_total.bytes / 1024,
+               &text);
+  text << L"." << std::endl;
+  text.setf(std::ios::fixed, std::ios::floatfield);
+  text.precision(1);
+
+  const std::vector<LogDiff::GroupDelta>& groups = diff.groups();
+  for (size_t i = 0; i < groups.size() && i < kMaxCompareGroups; ++i) {
+    const LogDiff::GroupDelta& group = groups[i];
+    if (group.significance == 0)
+      break;
+    text << std::endl << L"[" << group.significance << L"] rows ";
+    AppendChange(group.baseline.count, group.current.count, &text);
+    if (group.baseline.errors != 0 || group.current.errors != 0) {
+      text << L", errors ";
+      AppendChange(group.baseline.errors, group.current.errors, &text);
+    }
+    text << L", KB ";
+    AppendChange(group.baseline.bytes / 1024, group.current.bytes / 1024,
+                 &text);
+    text << L": " << base::UTF8ToWide(group.name);
+  }
+
+  const std::vector<LogDiff::SpanDelta>& spans = diff.spans();
+  if (!spans.empty())
+    text << std::endl;
+  for (size_t i = 0; i < spans.size() && i < kMaxCompareSpans; ++i) {
+    const LogDiff::SpanDelta& span = spans[i];
+    if (span.significance == 0)
+      break;
+    text << std::endl << L"[" << span.significance << L"] spans ";
+    AppendChange(span.baseline.count, span.current.count, &text);
+    text << L", p50 ms ";
+    AppendChange(span.baseline.p50.InMillisecondsF(),
+                 span.current.p50.InMillisecondsF(), &text);
+    text << L", p95 ms ";
+    AppendChange(span.baseline.p95.InMillisecondsF(),
+                 span.current.p95.InMillisecondsF(), &text);
+    text << L", p99 ms ";
+    AppendChange(span.baseline.p99.InMillisecondsF(),
+                 span.current.p99.InMillisecondsF(), &text);
+    text << L": " << base::UTF8ToWide(span.name);
+  }
+
+  ::MessageBox(m_hWnd, text.str().c_str(), L"Compare With Session", MB_OK);
+}
+
+ILogView* LogViewer::GetUnfilteredLogView() {
+  return filter_scan_->original();
 }
 
 void LogViewer::OnIncludeColumn(UINT code, int id, CWindow window) {
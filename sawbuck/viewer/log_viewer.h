@@ -23,16 +23,55 @@
 #include <atlsplit.h>
 #include <atlmisc.h>
 #include "base/memory/scoped_ptr.h"
+#include "sawbuck/viewer/filter.h"
+#include "sawbuck/viewer/filter_scan.h"
+#include "sawbuck/viewer/log_aggregator.h"
 #include "sawbuck/viewer/log_list_view.h"
+#include "sawbuck/viewer/memory_chart_view.h"
+#include "sawbuck/viewer/process_tree_view.h"
+#include "sawbuck/viewer/report_archive.h"
 #include "sawbuck/viewer/resource.h"
+#include "sawbuck/viewer/row_highlighter.h"
 #include "sawbuck/viewer/stack_trace_list_view.h"
+#include "sawbuck/viewer/timeline_view.h"
 
 // Forward decl.
 namespace WTL {
 class CUpdateUIBase;
 };
 class FilteredLogView;
+class ICpuProfileService;
+class ICpuTimelineService;
+class IDiskIoLatencyService;
+class IProcessMemoryService;
 class IProcessInfoService;
+class IRegistryAccessService;
+class ISpanIndex;
+class IThreadContextService;
+class IThreadInfoService;
+class SortedLogView;
+
+// A pane below the log list of the log viewer, which sets two views side
+// by side: the stack trace of the current row and the detail pane, which in
+// turn sets the report pane and the chart pane side by side. The report
+// pane sets the process tree beside the text entries of the report archive
+// imported, if any, and the chart pane sets the trace event timeline above
+// the process memory chart.
+class LogViewerBottomPane
+    : public CSplitterWindowImpl<LogViewerBottomPane, true> {
+ public:
+  typedef CSplitterWindowImpl<LogViewerBottomPane, true> Super;
+
+  BEGIN_MSG_MAP_EX(LogViewerBottomPane)
+    REFLECT_NOTIFICATIONS()
+    MESSAGE_HANDLER(WM_COMMAND, OnCommand)
+    CHAIN_MSG_MAP(Super)
+  END_MSG_MAP()
+
+ private:
+  // Forwards commands to the active pane, as the log viewer does to us.
+  LRESULT OnCommand(UINT msg, WPARAM wparam, LPARAM lparam, BOOL& handled);
+};
 
 // The log viewer window plays host to a listview, taking care of handling
 // its notification requests etc.
@@ -45,6 +84,15 @@ class LogViewer : public CSplitterWindowImpl<LogViewer, false> {
     MSG_WM_CREATE(OnCreate)
     REFLECT_NOTIFICATIONS()
     COMMAND_ID_HANDLER_EX(ID_LOG_FILTER, OnLogFilter)
+    COMMAND_ID_HANDLER_EX(ID_LOG_SORT_BY_TIME, OnLogSortByTime)
+    COMMAND_ID_HANDLER_EX(ID_LOG_WARNINGS_ONLY, OnLogWarningsOnly)
+    COMMAND_ID_HANDLER_EX(ID_LOG_QUERY, OnLogQuery)
+    COMMAND_RANGE_HANDLER_EX(ID_LOG_SUMMARIZE_LOCATION,
+                             ID_LOG_SUMMARIZE_MESSAGE,
+                             OnLogSummarize)
+    COMMAND_RANGE_HANDLER_EX(ID_LOG_COMPARE_LOCATION,
+                             ID_LOG_COMPARE_STACK,
+                             OnLogCompare)
     COMMAND_ID_HANDLER_EX(ID_INCLUDE_COLUMN, OnIncludeColumn)
     COMMAND_ID_HANDLER_EX(ID_EXCLUDE_COLUMN, OnExcludeColumn)
     MESSAGE_HANDLER(WM_COMMAND, OnCommand)
@@ -57,35 +105,136 @@ class LogViewer : public CSplitterWindowImpl<LogViewer, false> {
   // This must be called before the log window viewer is created.
   void SetLogView(ILogView* log_view);
 
+  // Filters the log view by @p filters, or stops filtering if they're
+  // empty, and saves them to the preferences.
+  void SetFilters(const std::vector<Filter>& filters);
+  // @returns the filters in effect, which are empty when not filtering.
+  std::vector<Filter> GetFilters() const;
+
+  // Adds @p filter to the filters in effect, unless it's there already.
+  void AddFilter(const Filter& filter);
+
+  // Highlights the rows of the log view by @p rules, and saves them to the
+  // preferences.
+  void SetHighlightRules(const std::vector<HighlightRule>& rules);
+
   void SetSymbolLookupService(ISymbolLookupService* symbol_lookup_service) {
     stack_trace_list_view_.SetSymbolLookupService(symbol_lookup_service);
+    log_list_view_.set_symbol_lookup_service(symbol_lookup_service);
   }
   void SetProcessInfoService(IProcessInfoService* process_info_service) {
     log_list_view_.set_process_info_service(process_info_service);
   }
+  void SetThreadInfoService(IThreadInfoService* thread_info_service) {
+    log_list_view_.set_thread_info_service(thread_info_service);
+  }
+  void SetCpuTimelineService(ICpuTimelineService* cpu_timeline_service) {
+    log_list_view_.set_cpu_timeline_service(cpu_timeline_service);
+  }
+  void SetDiskIoLatencyService(IDiskIoLatencyService* disk_io_service) {
+    log_list_view_.set_disk_io_latency_service(disk_io_service);
+  }
+  void SetCpuProfileService(ICpuProfileService* cpu_profile_service) {
+    log_list_view_.set_cpu_profile_service(cpu_profile_service);
+  }
+  void SetRegistryAccessService(IRegistryAccessService* registry_service) {
+    log_list_view_.set_registry_access_service(registry_service);
+  }
+  void SetThreadContextService(IThreadContextService* context_service) {
+    log_list_view_.set_thread_context_service(context_service);
+  }
+  void SetSpanIndex(ISpanIndex* span_index) {
+    timeline_view_.set_span_index(span_index);
+  }
+  void SetProcessMemoryService(IProcessMemoryService* memory_service) {
+    memory_chart_view_.set_memory_service(memory_service);
+  }
+  void SetProcessTree(ProcessTree* process_tree) {
+    process_tree_view_.set_process_tree(process_tree);
+  }
+
+  // Shows the first row at or after @p time, @see LogListView::GoToTime.
+  void GoToTime(const base::Time& time) {
+    log_list_view_.GoToTime(time);
+  }
+
+  // Shows @p texts, the text entries of a report archive, beside the
+  // process tree, or hides them if it's empty.
+  void SetReportTexts(const std::vector<ReportArchive::TextEntry>& texts);
 
  private:
   int OnCreate(LPCREATESTRUCT create_struct);
   LRESULT OnCommand(UINT msg, WPARAM wparam, LPARAM lparam, BOOL& handled);
   void OnLogFilter(UINT code, int id, CWindow window);
+  void OnLogSortByTime(UINT code, int id, CWindow window);
+  // Toggles the quick filter that hides the rows less severe than
+  // warnings, which the store's severity lists serve at once.
+  void OnLogWarningsOnly(UINT code, int id, CWindow window);
+  void OnLogQuery(UINT code, int id, CWindow window);
+  void OnLogSummarize(UINT code, int id, CWindow window);
+  void OnLogCompare(UINT code, int id, CWindow window);
   void OnIncludeColumn(UINT code, int id, CWindow window);
   void OnExcludeColumn(UINT code, int id, CWindow window);
 
+  // Returns the view we filter, the sorted view when sorting.
+  ILogView* GetUnfilteredLogView();
+
+  // Non-null iff sorting by time is enabled. This outlives the filtered
+  // view, which may be built over it.
+  scoped_ptr<SortedLogView> sorted_log_view_;
+
+  // Filters the new rows for the filtered views, over the sorted view
+  // when sorting. This outlives the filtered views.
+  scoped_ptr<FilterScan> filter_scan_;
+
   // Non-null iff filtering is enabled.
   scoped_ptr<FilteredLogView> filtered_log_view_;
 
+  // The filters of |filtered_log_view_|.
+  std::vector<Filter> filters_;
+
   // The original log view we're handed.
   ILogView* log_view_;
 
+  // Tallies the rows of the filtered view, or of the original view when
+  // not filtering, by the grouping last summarized. NULL until the first
+  // summary. Kept so as to tally new rows as they arrive.
+  scoped_ptr<LogAggregator> aggregator_;
+
   // The list view that displays the log.
   LogListView log_list_view_;
 
   // The row # of the item currently displayed in the stack trace.
   int stack_trace_item_row_;
 
+  // Hosts the stack trace list and the detail pane below the log list.
+  LogViewerBottomPane bottom_pane_;
+
   // The list that displays the stack trace for the currently selected log.
   StackTraceListView stack_trace_list_view_;
 
+  // Hosts the report pane and the chart pane.
+  LogViewerBottomPane detail_pane_;
+
+  // Hosts the process tree and the report information.
+  LogViewerBottomPane report_pane_;
+
+  // Shows the processes and their tallies, and filters on them.
+  ProcessTreeView process_tree_view_;
+
+  // Shows the system information and registry extract of a report.
+  CEdit report_text_view_;
+
+  // Hosts the timeline above the memory chart.
+  CHorizontalSplitterWindow chart_pane_;
+
+  // Draws the trace event spans of each thread.
+  TimelineView timeline_view_;
+
+  // Draws the memory of each process instance, and goes to the rows of the
+  // time clicked on.
+  MemoryChartView memory_chart_view_;
+
   // Used to update our UI.
   CUpdateUIBase* update_ui_;
 };
@@ -0,0 +1,344 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Memory chart view implementation.
+#include "sawbuck/viewer/memory_chart_view.h"
+
+#include <math.h>
+#include <algorithm>
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+
+namespace {
+
+const UINT_PTR kRefreshTimerId = 1;
+const UINT kRefreshMs = 1000;
+
+// The layout of the view, in pixels.
+const int kLabelWidth = 120;
+const int kRulerHeight = 18;
+const int kTrackHeight = 40;
+const int kFaultStripHeight = 6;
+// The least distance between ruler ticks.
+const int kMinTickSpacing = 80;
+
+// The zoom per notch of the mouse wheel.
+const double kZoomStep = 1.25;
+const int64 kMinViewSpanUs = 1000 * 1000;
+const int64 kMaxViewSpanUs = 24LL * 3600 * 1000 * 1000;
+
+const COLORREF kRulerColor = RGB(0xF0, 0xF0, 0xF0);
+const COLORREF kGridColor = RGB(0xD8, 0xD8, 0xD8);
+const COLORREF kTickColor = RGB(0x20, 0x50, 0xB0);
+const COLORREF kWorkingSetColor = RGB(0x8C, 0xC4, 0xE8);
+const COLORREF kCommitColor = RGB(0xD0, 0x60, 0x20);
+const COLORREF kNoFaultColor = RGB(0xF8, 0xF0, 0xE8);
+const COLORREF kFaultColor = RGB(0xC0, 0x20, 0x20);
+
+// @returns the color @p fraction of the way from @p from to @p to.
+COLORREF Blend(COLORREF from, COLORREF to, double fraction) {
+  fraction = std::max(0.0, std::min(1.0, fraction));
+  return RGB(
+      GetRValue(from) + (GetRValue(to) - GetRValue(from)) * fraction,
+      GetGValue(from) + (GetGValue(to) - GetGValue(from)) * fraction,
+      GetBValue(from) + (GetBValue(to) - GetBValue(from)) * fraction);
+}
+
+// Orders the instances of the largest peak working set first.
+bool LargerPeak(const IProcessMemoryService::Instance& a,
+                const IProcessMemoryService::Instance& b) {
+  if (a.peak_working_set != b.peak_working_set)
+    return a.peak_working_set > b.peak_working_set;
+  if (a.page_faults != b.page_faults)
+    return a.page_faults > b.page_faults;
+  return a.id < b.id;
+}
+
+// @returns true for an instance with nothing to draw.
+bool IsEmpty(const IProcessMemoryService::Instance& instance) {
+  return instance.peak_working_set == 0 && instance.peak_commit == 0 &&
+      instance.page_faults == 0;
+}
+
+}  // namespace
+
+MemoryChartView::MemoryChartView()
+    : memory_service_(NULL),
+      view_span_(base::TimeDelta::FromMicroseconds(kMinViewSpanUs)),
+      fit_(true),
+      first_track_(0) {
+}
+
+int MemoryChartView::OnCreate(LPCREATESTRUCT create_struct) {
+  SetTimer(kRefreshTimerId, kRefreshMs);
+  UpdateRange();
+
+  SetMsgHandled(FALSE);
+  return 1;
+}
+
+void MemoryChartView::OnDestroy() {
+  KillTimer(kRefreshTimerId);
+  SetMsgHandled(FALSE);
+}
+
+void MemoryChartView::OnTimer(UINT_PTR timer_id) {
+  if (timer_id != kRefreshTimerId) {
+    SetMsgHandled(FALSE);
+    return;
+  }
+
+  if (UpdateRange())
+    Invalidate();
+}
+
+bool MemoryChartView::UpdateRange() {
+  base::Time first, last;
+  if (memory_service_ == NULL ||
+      !memory_service_->GetTimeRange(&first, &last)) {
+    return false;
+  }
+
+  bool changed = first != capture_start_ || last != capture_end_;
+  capture_start_ = first;
+  capture_end_ = last;
+
+  if (fit_) {
+    view_start_ = first;
+    view_span_ = std::max(last - first,
+        base::TimeDelta::FromMicroseconds(kMinViewSpanUs));
+  }
+
+  return changed;
+}
+
+int MemoryChartView::TrackWidth(const CRect& client) {
+  return std::max(1, client.Width() - kLabelWidth);
+}
+
+base::Time MemoryChartView::TimeAt(int x, int track_width) const {
+  return view_start_ + base::TimeDelta::FromMicroseconds(
+      static_cast<int64>(static_cast<double>(x - kLabelWidth) *
+                         view_span_.InMicroseconds() / track_width));
+}
+
+BOOL MemoryChartView::OnEraseBkgnd(CDCHandle dc) {
+  // We paint all of our client area.
+  return TRUE;
+}
+
+void MemoryChartView::OnPaint(CDCHandle unused_dc) {
+  CPaintDC paint_dc(m_hWnd);
+  CMemoryDC dc(paint_dc.m_hDC, paint_dc.m_ps.rcPaint);
+
+  CRect client;
+  GetClientRect(&client);
+  dc.FillSolidRect(&client, ::GetSysColor(COLOR_WINDOW));
+
+  HFONT old_font = dc.SelectFont(AtlGetDefaultGuiFont());
+  dc.SetBkMode(TRANSPARENT);
+  dc.SetTextColor(::GetSysColor(COLOR_WINDOWTEXT));
+
+  instances_.clear();
+  if (memory_service_ != NULL)
+    memory_service_->GetInstances(&instances_);
+  instances_.erase(std::remove_if(instances_.begin(), instances_.end(),
+                                  IsEmpty),
+                   instances_.end());
+
+  if (instances_.empty()) {
+    dc.DrawText(L"No process memory counters.", -1, &client,
+                DT_CENTER | DT_VCENTER | DT_SINGLELINE | DT_NOPREFIX);
+    dc.SelectFont(old_font);
+    return;
+  }
+  std::sort(instances_.begin(), instances_.end(), LargerPeak);
+
+  DrawRuler(dc.m_hDC, client);
+
+  first_track_ = std::min(first_track_, instances_.size() - 1);
+  int top = client.top + kRulerHeight;
+  for (size_t i = first_track_; i < instances_.size() && top < client.bottom;
+       ++i) {
+    const Instance& instance = instances_[i];
+    CRect label(client.left, top, client.left + kLabelWidth,
+                top + kTrackHeight);
+    std::wstring name(instance.image_name.empty() ?
+        std::wstring(L"?") : base::UTF8ToWide(instance.image_name));
+    std::wstring text(base::StringPrintf(L"%ls (%d)\n%.1f MB",
+        name.c_str(), instance.process_id,
+        instance.peak_working_set / (1024.0 * 1024.0)));
+    label.DeflateRect(4, 2);
+    dc.DrawText(text.c_str(), static_cast<int>(text.length()), &label,
+                DT_LEFT | DT_NOPREFIX | DT_END_ELLIPSIS);
+
+    CRect rect(client.left + kLabelWidth, top, client.right,
+               top + kTrackHeight);
+    DrawTrack(dc.m_hDC, instance, rect);
+
+    top += kTrackHeight;
+    CRect grid(client.left, top, client.right, top + 1);
+    dc.FillSolidRect(&grid, kGridColor);
+    ++top;
+  }
+
+  dc.SelectFont(old_font);
+}
+
+void MemoryChartView::DrawRuler(CDCHandle dc, const CRect& client) {
+  CRect ruler(client.left, client.top, client.right,
+              client.top + kRulerHeight);
+  dc.FillSolidRect(&ruler, kRulerColor);
+
+  // Pick the least tick interval of the 1, 2, 5 series that spaces the
+  // ticks far enough apart to label.
+  int track_width = TrackWidth(client);
+  double min_tick_us = static_cast<double>(view_span_.InMicroseconds()) *
+      kMinTickSpacing / track_width;
+  int64 tick_us = 1;
+  int digits = 6;
+  while (tick_us < min_tick_us) {
+    if (tick_us * 2 >= min_tick_us) {
+      tick_us *= 2;
+    } else if (tick_us * 5 >= min_tick_us) {
+      tick_us *= 5;
+    } else {
+      tick_us *= 10;
+      digits = std::max(0, digits - 1);
+    }
+  }
+
+  // The ticks count from the start of the capture.
+  int64 start_us = (view_start_ - capture_start_).InMicroseconds();
+  int64 tick = start_us / tick_us * tick_us;
+  if (tick < start_us)
+    tick += tick_us;
+  int64 end_us = start_us + view_span_.InMicroseconds();
+  for (; tick <= end_us; tick += tick_us) {
+    int x = kLabelWidth + static_cast<int>(
+        static_cast<double>(tick - start_us) * track_width /
+        view_span_.InMicroseconds());
+    CRect mark(x, ruler.bottom - 4, x + 1, ruler.bottom);
+    dc.FillSolidRect(&mark, kTickColor);
+
+    std::wstring text(base::StringPrintf(L"%.*fs", digits, tick / 1e6));
+    CRect label(x + 2, ruler.top, x + kMinTickSpacing, ruler.bottom);
+    dc.DrawText(text.c_str(), static_cast<int>(text.length()), &label,
+                DT_LEFT | DT_VCENTER | DT_SINGLELINE | DT_NOPREFIX);
+  }
+}
+
+void MemoryChartView::DrawTrack(CDCHandle dc, const Instance& instance,
+                                const CRect& rect) {
+  if (rect.Width() <= 0)
+    return;
+
+  memory_service_->GetSamples(instance.id, view_start_,
+                              view_start_ + view_span_, rect.Width(),
+                              &samples_);
+
+  // The memory scales to the instance's peak, and the fault rate to the
+  // highest rate of the track in view.
+  double scale = static_cast<double>(
+      std::max(instance.peak_working_set, instance.peak_commit));
+  double max_rate = 0;
+  for (size_t i = 0; i < samples_.size(); ++i)
+    max_rate = std::max(max_rate, samples_[i].page_faults_per_second);
+
+  int chart_bottom = rect.bottom - kFaultStripHeight;
+  int chart_height = std::max(1, chart_bottom - rect.top - 1);
+  for (size_t i = 0; i < samples_.size(); ++i) {
+    const Sample& sample = samples_[i];
+    int x = rect.left + static_cast<int>(i);
+    if (scale > 0) {
+      int working_set = static_cast<int>(
+          sample.working_set * chart_height / scale);
+      if (working_set > 0) {
+        CRect area(x, chart_bottom - working_set, x + 1, chart_bottom);
+        dc.FillSolidRect(&area, kWorkingSetColor);
+      }
+      if (sample.commit > 0) {
+        int y = chart_bottom - static_cast<int>(
+            sample.commit * chart_height / scale);
+        CRect line(x, std::max<int>(rect.top, y - 1), x + 1, y + 1);
+        dc.FillSolidRect(&line, kCommitColor);
+      }
+    }
+
+    if (sample.page_faults_per_second > 0) {
+      CRect strip(x, chart_bottom, x + 1, rect.bottom);
+      dc.FillSolidRect(&strip, Blend(kNoFaultColor, kFaultColor,
+          sample.page_faults_per_second / max_rate));
+    }
+  }
+}
+
+BOOL MemoryChartView::OnMouseWheel(UINT flags, short delta, CPoint point) {
+  int notches = delta / WHEEL_DELTA;
+  if (notches == 0)
+    return TRUE;
+
+  if (flags & MK_SHIFT) {
+    // Scroll the tracks.
+    if (notches > 0)
+      first_track_ -= std::min(first_track_, static_cast<size_t>(notches));
+    else
+      first_track_ += -notches;
+    Invalidate();
+    return TRUE;
+  }
+
+  // Zoom about the time under the cursor.
+  ScreenToClient(&point);
+  CRect client;
+  GetClientRect(&client);
+  int track_width = TrackWidth(client);
+  base::Time anchor(TimeAt(std::max<int>(kLabelWidth, point.x),
+                           track_width));
+
+  double old_span = static_cast<double>(view_span_.InMicroseconds());
+  double new_span = old_span * pow(kZoomStep, -notches);
+  new_span = std::max(static_cast<double>(kMinViewSpanUs),
+                      std::min(static_cast<double>(kMaxViewSpanUs),
+                               new_span));
+
+  int64 anchor_offset = (anchor - view_start_).InMicroseconds();
+  view_start_ = anchor - base::TimeDelta::FromMicroseconds(
+      static_cast<int64>(anchor_offset * new_span / old_span));
+  view_span_ = base::TimeDelta::FromMicroseconds(
+      static_cast<int64>(new_span));
+  fit_ = false;
+  Invalidate();
+
+  return TRUE;
+}
+
+void MemoryChartView::OnLButtonDown(UINT flags, CPoint point) {
+  SetFocus();
+  if (point.x < kLabelWidth || time_callback_.is_null())
+    return;
+
+  CRect client;
+  GetClientRect(&client);
+  time_callback_.Run(TimeAt(point.x, TrackWidth(client)));
+}
+
+void MemoryChartView::OnLButtonDblClk(UINT flags, CPoint point) {
+  // Fit the capture back into view, and follow it.
+  fit_ = true;
+  first_track_ = 0;
+  UpdateRange();
+  Invalidate();
+}
@@ -0,0 +1,120 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Memory chart view declaration.
+#ifndef SAWBUCK_VIEWER_MEMORY_CHART_VIEW_H_
+#define SAWBUCK_VIEWER_MEMORY_CHART_VIEW_H_
+
+#include <atlbase.h>
+#include <atlapp.h>
+#include <atlcrack.h>
+#include <atlgdi.h>
+#include <atlmisc.h>
+#include <atlwin.h>
+#include <vector>
+#include "base/callback.h"
+#include "base/time/time.h"
+#include "sawbuck/log_lib/process_memory_service.h"
+
+// The memory chart view draws the working set, commit and page fault rate
+// of each process instance as a track against a time ruler, the instances
+// of the largest peak working set topmost. The working set is drawn as an
+// area, the commit as a line over it, and the page fault rate shades a
+// strip under them. The mouse wheel zooms about the cursor, shift and the
+// wheel scrolls the tracks, a click goes to the log rows of the time under
+// the cursor, and a double click fits the whole capture back into view,
+// which then follows the capture as it grows.
+// Each track draws a column per pixel from the service's samples, so the
+// cost of a paint is bound by the size of the window.
+class MemoryChartView : public CWindowImpl<MemoryChartView> {
+ public:
+  DECLARE_WND_CLASS_EX(L"SawbuckMemoryChartView",
+                       CS_DBLCLKS | CS_HREDRAW | CS_VREDRAW,
+                       COLOR_WINDOW)
+
+  BEGIN_MSG_MAP_EX(MemoryChartView)
+    MSG_WM_CREATE(OnCreate)
+    MSG_WM_DESTROY(OnDestroy)
+    MSG_WM_TIMER(OnTimer)
+    MSG_WM_ERASEBKGND(OnEraseBkgnd)
+    MSG_WM_PAINT(OnPaint)
+    MSG_WM_MOUSEWHEEL(OnMouseWheel)
+    MSG_WM_LBUTTONDOWN(OnLButtonDown)
+    MSG_WM_LBUTTONDBLCLK(OnLButtonDblClk)
+  END_MSG_MAP()
+
+  // Takes the time clicked on.
+  typedef base::Callback<void(const base::Time&)> TimeCallback;
+
+  MemoryChartView();
+
+  // Sets the memory service we draw, which must outlive us.
+  void set_memory_service(IProcessMemoryService* memory_service) {
+    memory_service_ = memory_service;
+  }
+  // Sets the callback to issue with the time clicked on.
+  void set_time_callback(const TimeCallback& time_callback) {
+    time_callback_ = time_callback;
+  }
+
+ private:
+  typedef IProcessMemoryService::Instance Instance;
+  typedef IProcessMemoryService::Sample Sample;
+
+  int OnCreate(LPCREATESTRUCT create_struct);
+  void OnDestroy();
+  void OnTimer(UINT_PTR timer_id);
+  BOOL OnEraseBkgnd(CDCHandle dc);
+  void OnPaint(CDCHandle dc);
+  BOOL OnMouseWheel(UINT flags, short delta, CPoint point);
+  void OnLButtonDown(UINT flags, CPoint point);
+  void OnLButtonDblClk(UINT flags, CPoint point);
+
+  // Reads the time range of the service, and fits it into view if
+  // following the capture.
+  // @returns true iff the range changed since the last call.
+  bool UpdateRange();
+
+  // @returns the width of the track area of @p client.
+  static int TrackWidth(const CRect& client);
+  // @returns the time at @p x of the track area.
+  base::Time TimeAt(int x, int track_width) const;
+
+  void DrawRuler(CDCHandle dc, const CRect& client);
+  void DrawTrack(CDCHandle dc, const Instance& instance, const CRect& rect);
+
+  IProcessMemoryService* memory_service_;
+  TimeCallback time_callback_;
+
+  // The time at the left edge of the tracks, and the time across them.
+  base::Time view_start_;
+  base::TimeDelta view_span_;
+  // True while we fit the capture, until the user zooms.
+  bool fit_;
+  // The first track at the top of the view.
+  size_t first_track_;
+
+  // The time range of the service as of the last UpdateRange. The ruler
+  // counts from the start of the capture.
+  base::Time capture_start_;
+  base::Time capture_end_;
+
+  // Scratch storage for painting.
+  std::vector<Instance> instances_;
+  std::vector<Sample> samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryChartView);
+};
+
+#endif  // SAWBUCK_VIEWER_MEMORY_CHART_VIEW_H_
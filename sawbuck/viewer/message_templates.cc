@@ -0,0 +1,193 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Message template table implementation.
+#include "sawbuck/viewer/message_templates.h"
+
+#include <algorithm>
+#include "sawbuck/common/memory_footprint.h"
+
+namespace {
+
+// Hex words with a digit at least this long are parameters, shorter ones
+// may well be words.
+const size_t kMinHexParameterLength = 4;
+
+bool IsWordChar(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+      (c >= '0' && c <= '9') || c == '_';
+}
+
+bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+bool IsHexDigit(char c) {
+  return IsDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// Returns true iff @p word is a number, or looks like one in hex.
+bool IsParameter(const char* word, size_t length) {
+  DCHECK_LT(0U, length);
+  if (IsDigit(word[0]))
+    return true;
+  if (length < kMinHexParameterLength)
+    return false;
+
+  bool has_digit = false;
+  for (size_t i = 0; i < length; ++i) {
+    if (!IsHexDigit(word[i]))
+      return false;
+    has_digit = has_digit || IsDigit(word[i]);
+  }
+  return has_digit;
+}
+
+}  // namespace
+
+const MessageTemplates::TemplateId MessageTemplates::kNoTemplate;
+const char MessageTemplates::kParameterMarker;
+const size_t MessageTemplates::kMaxParameterLength;
+
+MessageTemplates::MessageTemplates() : live_bytes_(0) {
+}
+
+MessageTemplates::~MessageTemplates() {
+}
+
+bool MessageTemplates::Split(const base::StringPiece& message,
+                             char marker,
+                             std::string* templ,
+                             std::string* parameters) {
+  DCHECK(templ != NULL);
+  templ->clear();
+  if (parameters != NULL)
+    parameters->clear();
+
+  const char* text = message.data();
+  size_t i = 0;
+  while (i < message.size()) {
+    if (!IsWordChar(text[i])) {
+      if (text[i] == marker && parameters != NULL)
+        return false;
+      templ->push_back(text[i++]);
+      continue;
+    }
+
+    size_t begin = i;
+    while (i < message.size() && IsWordChar(text[i]))
+      ++i;
+    size_t length = i - begin;
+    if (!IsParameter(text + begin, length)) {
+      templ->append(text + begin, length);
+      continue;
+    }
+
+    templ->push_back(marker);
+    if (parameters != NULL) {
+      if (length > kMaxParameterLength)
+        return false;
+      parameters->push_back(static_cast<char>(length));
+      parameters->append(text + begin, length);
+    }
+  }
+
+  return true;
+}
+
+MessageTemplates::TemplateId MessageTemplates::Intern(
+    const base::StringPiece& templ) {
+  IdMap::iterator it(ids_.find(templ));
+  if (it != ids_.end()) {
+    ++entries_[it->second].ref_count;
+    return it->second;
+  }
+
+  TemplateId id = 0;
+  if (free_ids_.empty()) {
+    id = entries_.size();
+    entries_.push_back(Entry());
+  } else {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+  }
+
+  Entry& entry = entries_[id];
+  templ.CopyToString(&entry.text);
+  entry.ref_count = 1;
+  entry.num_parameters =
+      std::count(templ.begin(), templ.end(), kParameterMarker);
+  live_bytes_ += entry.text.size();
+  ids_.insert(std::make_pair(base::StringPiece(entry.text), id));
+
+  return id;
+}
+
+void MessageTemplates::Release(TemplateId id) {
+  DCHECK_LT(id, entries_.size());
+  Entry& entry = entries_[id];
+  DCHECK_NE(0U, entry.ref_count);
+  if (--entry.ref_count != 0)
+    return;
+
+  ids_.erase(entry.text);
+  live_bytes_ -= entry.text.size();
+  std::string().swap(entry.text);
+  free_ids_.push_back(id);
+}
+
+base::StringPiece MessageTemplates::Expand(
+    TemplateId id,
+    const base::StringPiece& parameters,
+    std::string* buffer) const {
+  DCHECK(buffer != NULL);
+  const Entry& entry = GetEntry(id);
+  if (entry.num_parameters == 0)
+    return entry.text;
+
+  buffer->clear();
+  buffer->reserve(entry.text.size() + parameters.size());
+  size_t offset = 0;
+  for (size_t i = 0; i < entry.text.size(); ++i) {
+    if (entry.text[i] != kParameterMarker) {
+      buffer->push_back(entry.text[i]);
+      continue;
+    }
+
+    DCHECK_LT(offset, parameters.size());
+    size_t length = static_cast<uint8>(parameters[offset]);
+    DCHECK_LE(offset + 1 + length, parameters.size());
+    buffer->append(parameters.data() + offset + 1, length);
+    offset += 1 + length;
+  }
+  DCHECK_EQ(parameters.size(), offset);
+
+  return *buffer;
+}
+
+void MessageTemplates::Clear() {
+  std::deque<Entry>().swap(entries_);
+  std::vector<TemplateId>().swap(free_ids_);
+  live_bytes_ = 0;
+  ids_.clear();
+}
+
+size_t MessageTemplates::GetMemoryUsage() const {
+  size_t usage = 0;
+  usage += entries_.size() * sizeof(entries_[0]);
+  usage += free_ids_.capacity() * sizeof(free_ids_[0]);
+  usage += live_bytes_;
+  usage += TreeFootprint(ids_);
+  return usage;
+}
@@ -0,0 +1,137 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Message template table declaration.
+#ifndef SAWBUCK_VIEWER_MESSAGE_TEMPLATES_H_
+#define SAWBUCK_VIEWER_MESSAGE_TEMPLATES_H_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/strings/string_piece.h"
+
+// Interns the templates of log messages. Most messages are formatted from
+// a small set of format strings, and differ only in the numbers they carry,
+// so a message splits into its template, with a marker in place of each
+// number, and its parameters, the numbers' text. Rows refer to a shared
+// copy of their template by a 32 bit id, and carry only their parameters.
+// Templates are reference counted, and the ids of released templates are
+// reused.
+// @note a table takes no lock. Its store interns and releases templates
+//     as it adds and evicts rows, and the pool's tasks look templates up
+//     only while the store doesn't change, as lookups don't write.
+class MessageTemplates {
+ public:
+  typedef uint32 TemplateId;
+  // An id that no template has, for messages stored as they are.
+  static const TemplateId kNoTemplate = static_cast<TemplateId>(-1);
+
+  // Stands in for the parameters of a template.
+  static const char kParameterMarker = '\x01';
+  // Parameters longer than this aren't split out of their message.
+  static const size_t kMaxParameterLength = 255;
+
+  MessageTemplates();
+  ~MessageTemplates();
+
+  // Splits @p message into its template, with the parameters replaced by
+  // @p marker, and the parameters, if @p parameters is non-NULL. The
+  // parameters are the words that start with a digit, like "42", "0x1F" or
+  // "10ms", and the hex words of four or more digits with a decimal digit
+  // among them, like pointers and GUID parts. The parameters are packed
+  // back to back, each preceded by its length in a byte.
+  // @returns false if @p parameters is non-NULL and the message can't be
+  //     split losslessly, as it contains @p marker or a very long
+  //     parameter, in which case the outputs are undefined.
+  static bool Split(const base::StringPiece& message,
+                    char marker,
+                    std::string* templ,
+                    std::string* parameters);
+
+  // Adds a reference to @p templ, interning it if it's new.
+  // @returns the id of the template.
+  TemplateId Intern(const base::StringPiece& templ);
+
+  // Releases a reference to template @p id, which goes when it has no more.
+  void Release(TemplateId id);
+
+  // Accessors for template @p id, which must be referred to.
+  // @{
+  // @returns the template, valid while it's referred to.
+  base::StringPiece GetTemplate(TemplateId id) const {
+    return GetEntry(id).text;
+  }
+  size_t GetRefCount(TemplateId id) const {
+    return GetEntry(id).ref_count;
+  }
+  // @returns the bytes the template takes.
+  size_t GetBytes(TemplateId id) const {
+    return GetEntry(id).text.size();
+  }
+  // @}
+
+  // Expands template @p id with the @p parameters split from a message.
+  // @returns the message, which is the template itself if it has no
+  //     parameters, or else is stored in @p buffer.
+  base::StringPiece Expand(TemplateId id,
+                           const base::StringPiece& parameters,
+                           std::string* buffer) const;
+
+  // @returns the number of distinct templates referred to.
+  size_t num_templates() const { return ids_.size(); }
+
+  // @returns the bytes of the templates referred to.
+  size_t live_bytes() const { return live_bytes_; }
+
+  // Releases all templates and their storage.
+  void Clear();
+
+  // @returns an estimate of the heap memory used by the table.
+  size_t GetMemoryUsage() const;
+
+ private:
+  struct Entry {
+    Entry() : ref_count(0), num_parameters(0) {
+    }
+
+    std::string text;
+    uint32 ref_count;
+    uint32 num_parameters;
+  };
+
+  const Entry& GetEntry(TemplateId id) const {
+    DCHECK_LT(id, entries_.size());
+    DCHECK_NE(0U, entries_[id].ref_count);
+    return entries_[id];
+  }
+
+  // The templates by id, the ids of released templates are in free_ids_.
+  // This is a deque so as to keep the templates in place as it grows.
+  std::deque<Entry> entries_;
+  std::vector<TemplateId> free_ids_;
+
+  // The bytes of the templates referred to.
+  size_t live_bytes_;
+
+  // The keys refer to the templates in entries_.
+  typedef std::map<base::StringPiece, TemplateId> IdMap;
+  IdMap ids_;
+
+  DISALLOW_COPY_AND_ASSIGN(MessageTemplates);
+};
+
+#endif  // SAWBUCK_VIEWER_MESSAGE_TEMPLATES_H_
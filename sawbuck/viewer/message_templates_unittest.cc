@@ -0,0 +1,107 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "sawbuck/viewer/message_templates.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Splits @p message the way the store does, or returns "whole".
+std::string SplitTemplate(const char* message, std::string* parameters) {
+  std::string templ;
+  if (!MessageTemplates::Split(message, '#', &templ, parameters))
+    return "whole";
+  return templ;
+}
+
+}  // namespace
+
+TEST(MessageTemplatesTest, Split) {
+  std::string parameters;
+  EXPECT_EQ("", SplitTemplate("", &parameters));
+  EXPECT_EQ("", parameters);
+  EXPECT_EQ("Opening a file", SplitTemplate("Opening a file", &parameters));
+  EXPECT_EQ("", parameters);
+
+  EXPECT_EQ("Read # bytes at #",
+            SplitTemplate("Read 42 bytes at 0x0012FF7C", &parameters));
+  EXPECT_EQ(std::string("\x02" "42" "\x0A" "0x0012FF7C"), parameters);
+
+  EXPECT_EQ("Took #", SplitTemplate("Took 10ms", &parameters));
+  EXPECT_EQ("Handle #, v8 and utf16",
+            SplitTemplate("Handle 0012ff7c, v8 and utf16", &parameters));
+  EXPECT_EQ("{#-#-#-#-#}",
+            SplitTemplate("{7E1AD3F4-66C9-4d4a-B5D6-94A1B2C3D4E5}",
+                          &parameters));
+  EXPECT_EQ("Deadbeef and cafe",
+            SplitTemplate("Deadbeef and cafe", &parameters));
+
+  // Messages that don't split losslessly are kept whole.
+  EXPECT_EQ("whole", SplitTemplate("Issue #42", &parameters));
+  EXPECT_EQ("Issue ##", SplitTemplate("Issue #42", NULL));
+  std::string long_number(MessageTemplates::kMaxParameterLength + 1, '1');
+  EXPECT_EQ("whole", SplitTemplate(long_number.c_str(), &parameters));
+  EXPECT_EQ("#", SplitTemplate(long_number.c_str(), NULL));
+}
+
+TEST(MessageTemplatesTest, InternAndExpand) {
+  MessageTemplates templates;
+  std::string templ;
+  std::string parameters;
+  ASSERT_TRUE(MessageTemplates::Split("Read 42 bytes at 0x10",
+                                      MessageTemplates::kParameterMarker,
+                                      &templ, &parameters));
+
+  MessageTemplates::TemplateId id = templates.Intern(templ);
+  EXPECT_EQ(id, templates.Intern(templ));
+  EXPECT_EQ(2, templates.GetRefCount(id));
+  EXPECT_EQ(1, templates.num_templates());
+  EXPECT_EQ(templ.size(), templates.live_bytes());
+  EXPECT_EQ(templ.size(), templates.GetBytes(id));
+
+  std::string buffer;
+  EXPECT_EQ("Read 42 bytes at 0x10",
+            templates.Expand(id, parameters, &buffer).as_string());
+
+  // Templates without parameters expand to themselves.
+  MessageTemplates::TemplateId plain = templates.Intern("Plain");
+  EXPECT_NE(id, plain);
+  base::StringPiece expanded(templates.Expand(plain, "", &buffer));
+  EXPECT_EQ("Plain", expanded.as_string());
+  EXPECT_EQ(templates.GetTemplate(plain).data(), expanded.data());
+}
+
+TEST(MessageTemplatesTest, Release) {
+  MessageTemplates templates;
+  MessageTemplates::TemplateId first = templates.Intern("first");
+  MessageTemplates::TemplateId second = templates.Intern("second");
+  templates.Intern("first");
+
+  templates.Release(first);
+  EXPECT_EQ(2, templates.num_templates());
+  templates.Release(first);
+  EXPECT_EQ(1, templates.num_templates());
+  EXPECT_EQ(strlen("second"), templates.live_bytes());
+
+  // Released ids are reused.
+  EXPECT_EQ(first, templates.Intern("third"));
+  EXPECT_EQ("third", templates.GetTemplate(first).as_string());
+  EXPECT_EQ(second, templates.Intern("second"));
+  EXPECT_EQ(2, templates.GetRefCount(second));
+
+  templates.Clear();
+  EXPECT_EQ(0, templates.num_templates());
+  EXPECT_EQ(0, templates.live_bytes());
+}
@@ -26,11 +26,13 @@ class MockILogViewEvents: public ILogViewEvents {
  public:
   MOCK_METHOD0(LogViewNewItems, void());
   MOCK_METHOD0(LogViewCleared, void());
+  MOCK_METHOD1(LogViewEvicted, void(int first_row));
 };
 
 class MockILogView: public ILogView {
  public:
   MOCK_METHOD0(GetNumRows, int());
+  MOCK_METHOD0(GetFirstRow, int());
   MOCK_METHOD0(ClearAll, void());
 
   MOCK_METHOD1(GetSeverity, int(int row));
@@ -38,9 +40,12 @@ class MockILogView: public ILogView {
   MOCK_METHOD1(GetThreadId, DWORD(int row));
   MOCK_METHOD1(GetTime, base::Time(int row));
   MOCK_METHOD1(GetFileName, std::string(int row));
+  MOCK_METHOD1(GetFileAtom, StringTable::Atom(int row));
   MOCK_METHOD1(GetLine, int(int row));
   MOCK_METHOD1(GetMessage, std::string(int row));
-  MOCK_METHOD2(GetStackTrace, void(int row, std::vector<void*>* trace));
+  MOCK_METHOD2(GetStackTrace,
+               void(int row, std::vector<sym_util::Address>* trace));
+  MOCK_METHOD0(GetLogStore, const LogStore*());
 
   MOCK_METHOD2(Register, void(ILogViewEvents* event_sink,
                               int* registration_cookie));
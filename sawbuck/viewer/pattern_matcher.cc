@@ -0,0 +1,366 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Pattern matcher implementation.
+#include "sawbuck/viewer/pattern_matcher.h"
+
+#include "base/logging.h"
+#include "pcre.h"  // NOLINT
+
+namespace {
+
+const int kPatternOptions =
+    PCRE_NEWLINE_ANYCRLF | PCRE_DOTALL | PCRE_UTF8 | PCRE_CASELESS;
+
+inline char ToLowerASCII(char c) {
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+inline bool IsAlnumASCII(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+      (c >= '0' && c <= '9');
+}
+
+inline bool IsASCII(char c) {
+  return (c & 0x80) == 0;
+}
+
+// The characters that aren't literal outside a character class.
+inline bool IsMetaChar(char c) {
+  switch (c) {
+    case '\\': case '^': case '$': case '.': case '[': case '|':
+    case '(': case ')': case '?': case '*': case '+': case '{':
+      return true;
+  }
+  return false;
+}
+
+// The escapes that stand for a single, non-literal, character or for an
+// assertion, and don't consume further pattern characters.
+inline bool IsSimpleEscape(char c) {
+  switch (c) {
+    case 'd': case 'D': case 'w': case 'W': case 's': case 'S':
+    case 'h': case 'H': case 'v': case 'V': case 'R': case 'X':
+    case 'b': case 'B': case 'A': case 'z': case 'Z': case 'G':
+      return true;
+  }
+  return false;
+}
+
+// Returns the position just past the character class that starts at
+// |pos|, or std::string::npos if it's unterminated.
+size_t SkipCharacterClass(const std::string& pattern, size_t pos) {
+  DCHECK_EQ('[', pattern[pos]);
+  ++pos;
+  if (pos < pattern.size() && pattern[pos] == '^')
+    ++pos;
+  // A leading ']' is literal.
+  if (pos < pattern.size() && pattern[pos] == ']')
+    ++pos;
+
+  for (; pos < pattern.size(); ++pos) {
+    if (pattern[pos] == '\\')
+      ++pos;
+    else if (pattern[pos] == ']')
+      return pos + 1;
+  }
+
+  return std::string::npos;
+}
+
+}  // namespace
+
+CaselessSearcher::CaselessSearcher(const base::StringPiece& needle) {
+  needle_.reserve(needle.size());
+  for (size_t i = 0; i < needle.size(); ++i)
+    needle_.push_back(ToLowerASCII(needle[i]));
+
+  // The last character of the needle doesn't figure in the skip table,
+  // as we always shift past it.
+  size_t len = needle_.size();
+  for (size_t i = 0; i < arraysize(skip_); ++i)
+    skip_[i] = len;
+  for (size_t i = 0; i + 1 < len; ++i)
+    skip_[static_cast<uint8>(needle_[i])] = len - 1 - i;
+
+  // Make the skip table case insensitive.
+  for (char c = 'A'; c <= 'Z'; ++c)
+    skip_[static_cast<uint8>(c)] = skip_[static_cast<uint8>(ToLowerASCII(c))];
+}
+
+bool CaselessSearcher::Find(const base::StringPiece& haystack) const {
+  size_t len = needle_.size();
+  if (len == 0)
+    return true;
+  if (haystack.size() < len)
+    return false;
+
+  const char* text = haystack.data();
+  const char* needle = needle_.data();
+  size_t last = len - 1;
+  for (size_t pos = 0; pos <= haystack.size() - len; ) {
+    char c = ToLowerASCII(text[pos + last]);
+    if (c == needle[last]) {
+      size_t i = last;
+      while (i > 0 && ToLowerASCII(text[pos + i - 1]) == needle[i - 1])
+        --i;
+      if (i == 0)
+        return true;
+    }
+    pos += skip_[static_cast<uint8>(c)];
+  }
+
+  return false;
+}
+
+bool CaselessSearcher::Equals(const base::StringPiece& text) const {
+  if (text.size() != needle_.size())
+    return false;
+
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (ToLowerASCII(text[i]) != needle_[i])
+      return false;
+  }
+  return true;
+}
+
+PatternMatcher::PatternMatcher(const std::string& pattern, MatchType type)
+    : pattern_(pattern), type_(type), literal_(NULL), re_(NULL),
+      extra_(NULL), required_(NULL) {
+  Compile();
+}
+
+PatternMatcher::PatternMatcher(const PatternMatcher& other)
+    : pattern_(other.pattern_), type_(other.type_), literal_(NULL),
+      re_(NULL), extra_(NULL), required_(NULL) {
+  Compile();
+}
+
+PatternMatcher::~PatternMatcher() {
+  Release();
+}
+
+PatternMatcher& PatternMatcher::operator=(const PatternMatcher& other) {
+  if (this != &other) {
+    Release();
+    pattern_ = other.pattern_;
+    type_ = other.type_;
+    Compile();
+  }
+  return *this;
+}
+
+bool PatternMatcher::Matches(const base::StringPiece& text) const {
+  if (literal_ != NULL) {
+    if (type_ == FULL_MATCH)
+      return literal_->Equals(text);
+    return literal_->Find(text);
+  }
+
+  if (re_ == NULL)
+    return false;
+
+  // Most rows don't contain the required literal, if there is one, and
+  // this is a lot cheaper than the expression.
+  if (required_ != NULL && !required_->Find(text))
+    return false;
+
+  int rc = pcre_exec(re_,
+                     extra_,
+                     text.data() == NULL ? "" : text.data(),
+                     text.size(),
+                     0,
+                     type_ == FULL_MATCH ? PCRE_ANCHORED : 0,
+                     NULL,
+                     0);
+  // Without an output vector pcre_exec returns zero on a match.
+  return rc >= 0;
+}
+
+bool PatternMatcher::ParseLiteral(const std::string& pattern,
+                                  std::string* literal) {
+  DCHECK(literal != NULL);
+
+  std::string result;
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    char c = pattern[i];
+    // We only fold ASCII case, as does PCRE without Unicode properties,
+    // but steer clear of multi byte characters anyway.
+    if (!IsASCII(c))
+      return false;
+
+    if (c == '\\') {
+      // An escaped punctuation character is literal, anything else
+      // is special.
+      if (i + 1 == pattern.size())
+        return false;
+      c = pattern[++i];
+      if (IsAlnumASCII(c) || !IsASCII(c))
+        return false;
+    } else if (IsMetaChar(c)) {
+      return false;
+    }
+
+    result.push_back(c);
+  }
+
+  literal->swap(result);
+  return true;
+}
+
+std::string PatternMatcher::FindRequiredLiteral(const std::string& pattern) {
+  std::string best;
+  std::string run;
+  int depth = 0;
+  // True iff the last atom appended to run is a literal character, which
+  // a following quantifier may make optional.
+  bool last_is_literal = false;
+
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    char c = pattern[i];
+    bool is_literal = false;
+    switch (c) {
+      case '\\':
+        if (i + 1 == pattern.size())
+          return std::string();
+        c = pattern[++i];
+        if (IsAlnumASCII(c)) {
+          // Escapes like \x41 or \p{L} consume further characters, bail
+          // on those rather than parse them.
+          if (!IsSimpleEscape(c))
+            return std::string();
+        } else if (IsASCII(c)) {
+          is_literal = true;
+        }
+        break;
+
+      case '[':
+        i = SkipCharacterClass(pattern, i);
+        if (i == std::string::npos)
+          return std::string();
+        --i;
+        break;
+
+      case '(':
+        // Option settings could turn on extended mode, or change the
+        // meaning of the pattern otherwise.
+        if (i + 1 < pattern.size() && pattern[i + 1] == '?' &&
+            i + 2 < pattern.size() &&
+            (IsAlnumASCII(pattern[i + 2]) || pattern[i + 2] == '-')) {
+          return std::string();
+        }
+        ++depth;
+        break;
+
+      case ')':
+        --depth;
+        break;
+
+      case '|':
+        // With a top level alternative, nothing is required.
+        if (depth == 0)
+          return std::string();
+        break;
+
+      case '?':
+      case '*':
+      case '{':
+        // The previous atom is optional, or may be repeated zero times.
+        if (last_is_literal && depth == 0)
+          run.resize(run.size() - 1);
+        if (c == '{') {
+          size_t end = pattern.find('}', i);
+          if (end != std::string::npos)
+            i = end;
+        }
+        break;
+
+      case '+':
+        // The previous atom is required, but what follows isn't adjacent.
+        break;
+
+      case '^':
+      case '$':
+      case '.':
+        break;
+
+      default:
+        is_literal = IsASCII(c);
+        break;
+    }
+
+    if (depth == 0 && is_literal) {
+      run.push_back(ToLowerASCII(c));
+      last_is_literal = true;
+    } else {
+      if (run.size() > best.size())
+        best = run;
+      run.clear();
+      last_is_literal = false;
+    }
+  }
+
+  if (run.size() > best.size())
+    best = run;
+
+  return best;
+}
+
+void PatternMatcher::Compile() {
+  DCHECK(literal_ == NULL && re_ == NULL);
+
+  std::string literal;
+  if (ParseLiteral(pattern_, &literal)) {
+    literal_ = new CaselessSearcher(literal);
+    return;
+  }
+
+  // Same as pcrecpp, a full match wraps the pattern to anchor both ends.
+  std::string pattern(pattern_);
+  if (type_ == FULL_MATCH)
+    pattern = "(?:" + pattern_ + ")\\z";
+
+  const char* error = NULL;
+  int error_offset = 0;
+  re_ = pcre_compile(pattern.c_str(), kPatternOptions, &error, &error_offset,
+                     NULL);
+  if (re_ == NULL) {
+    LOG(ERROR) << "Invalid pattern \"" << pattern_ << "\": " << error;
+    return;
+  }
+
+  extra_ = pcre_study(re_, 0, &error);
+  if (error != NULL)
+    LOG(ERROR) << "Failed to study \"" << pattern_ << "\": " << error;
+
+  std::string required(FindRequiredLiteral(pattern_));
+  if (!required.empty())
+    required_ = new CaselessSearcher(required);
+}
+
+void PatternMatcher::Release() {
+  delete literal_;
+  literal_ = NULL;
+  delete required_;
+  required_ = NULL;
+
+  if (extra_ != NULL) {
+    pcre_free(extra_);
+    extra_ = NULL;
+  }
+  if (re_ != NULL) {
+    pcre_free(re_);
+    re_ = NULL;
+  }
+}
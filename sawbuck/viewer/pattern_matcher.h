@@ -0,0 +1,114 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Pattern matcher declaration.
+#ifndef SAWBUCK_VIEWER_PATTERN_MATCHER_H_
+#define SAWBUCK_VIEWER_PATTERN_MATCHER_H_
+
+#include <string>
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+
+// Forward decls, from pcre.h.
+struct real_pcre;
+struct pcre_extra;
+
+// Searches for a literal string, ignoring ASCII case, with the
+// Boyer-Moore-Horspool algorithm.
+class CaselessSearcher {
+ public:
+  explicit CaselessSearcher(const base::StringPiece& needle);
+
+  // @returns true iff @p haystack contains our needle.
+  bool Find(const base::StringPiece& haystack) const;
+
+  // @returns true iff @p text equals our needle.
+  bool Equals(const base::StringPiece& text) const;
+
+  // @returns the needle, in lower case.
+  const std::string& needle() const { return needle_; }
+
+ private:
+  // Our needle lower cased.
+  std::string needle_;
+  // The shift on a mismatch, indexed by the lower cased haystack character
+  // under the end of the needle.
+  size_t skip_[256];
+};
+
+// Matches text against a case insensitive, UTF8 regular expression, with
+// the same options as the filter and find expressions always had.
+//
+// Pure literal patterns, which is what most filters are, bypass PCRE. They
+// are matched with a Horspool search, or a plain compare for full matches.
+// Other patterns are compiled and studied, and if they contain a literal
+// that any match must contain, we search for that first, and only run the
+// expression if it's found.
+// @note literal patterns match as bytes, so unlike PCRE they may also
+//     match text that isn't valid UTF8.
+class PatternMatcher {
+ public:
+  enum MatchType {
+    // The pattern must match all of the text.
+    FULL_MATCH,
+    // The pattern must match somewhere in the text.
+    PARTIAL_MATCH,
+  };
+
+  PatternMatcher(const std::string& pattern, MatchType type);
+  PatternMatcher(const PatternMatcher& other);
+  ~PatternMatcher();
+
+  PatternMatcher& operator=(const PatternMatcher& other);
+
+  // @returns true iff @p text matches our pattern.
+  bool Matches(const base::StringPiece& text) const;
+
+  // @returns true if the pattern is matched without invoking PCRE.
+  bool is_literal() const { return literal_ != NULL; }
+
+  const std::string& pattern() const { return pattern_; }
+  MatchType type() const { return type_; }
+
+  // Parses @p pattern for a pure literal.
+  // @param literal on success receives the literal, with escapes removed.
+  // @returns true iff @p pattern only matches @p literal, case aside.
+  static bool ParseLiteral(const std::string& pattern, std::string* literal);
+
+  // Finds the longest literal any match of @p pattern must contain.
+  // @returns the literal, or the empty string if none could be found.
+  static std::string FindRequiredLiteral(const std::string& pattern);
+
+ private:
+  // (Re-)compiles pattern_.
+  void Compile();
+  // Releases our compiled state.
+  void Release();
+
+  std::string pattern_;
+  MatchType type_;
+
+  // Non-NULL iff pattern_ is a literal.
+  CaselessSearcher* literal_;
+
+  // The compiled and studied expression, otherwise. Studying may yield
+  // no extra data, in which case extra_ is NULL.
+  real_pcre* re_;
+  pcre_extra* extra_;
+
+  // A literal any match must contain, if we found one.
+  CaselessSearcher* required_;
+};
+
+#endif  // SAWBUCK_VIEWER_PATTERN_MATCHER_H_
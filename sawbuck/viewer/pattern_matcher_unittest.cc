@@ -0,0 +1,171 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/pattern_matcher.h"
+
+#include "gtest/gtest.h"
+#include "pcrecpp.h"  // NOLINT
+
+namespace {
+
+TEST(CaselessSearcherTest, Find) {
+  CaselessSearcher searcher("Needle");
+  EXPECT_EQ("needle", searcher.needle());
+
+  EXPECT_TRUE(searcher.Find("needle"));
+  EXPECT_TRUE(searcher.Find("a NEEDLE in a haystack"));
+  EXPECT_TRUE(searcher.Find("haystack with a nEeDlE"));
+  EXPECT_TRUE(searcher.Find("neneeneedneedleneedl"));
+  EXPECT_FALSE(searcher.Find(""));
+  EXPECT_FALSE(searcher.Find("needl"));
+  EXPECT_FALSE(searcher.Find("a haystack with a needl"));
+  EXPECT_FALSE(searcher.Find("neede seems needed"));
+
+  CaselessSearcher empty("");
+  EXPECT_TRUE(empty.Find(""));
+  EXPECT_TRUE(empty.Find("anything"));
+}
+
+TEST(CaselessSearcherTest, Equals) {
+  CaselessSearcher searcher("Foo.cc");
+  EXPECT_TRUE(searcher.Equals("foo.cc"));
+  EXPECT_TRUE(searcher.Equals("FOO.CC"));
+  EXPECT_FALSE(searcher.Equals("foo.c"));
+  EXPECT_FALSE(searcher.Equals("foo.cc "));
+  EXPECT_FALSE(searcher.Equals("foo_cc"));
+}
+
+TEST(PatternMatcherTest, ParseLiteral) {
+  std::string literal;
+  EXPECT_TRUE(PatternMatcher::ParseLiteral("", &literal));
+  EXPECT_EQ("", literal);
+  EXPECT_TRUE(PatternMatcher::ParseLiteral("Some text, #1!", &literal));
+  EXPECT_EQ("Some text, #1!", literal);
+  EXPECT_TRUE(PatternMatcher::ParseLiteral("foo\\.cc", &literal));
+  EXPECT_EQ("foo.cc", literal);
+  EXPECT_TRUE(PatternMatcher::ParseLiteral("a\\(b\\)\\\\", &literal));
+  EXPECT_EQ("a(b)\\", literal);
+  EXPECT_TRUE(PatternMatcher::ParseLiteral("}]", &literal));
+  EXPECT_EQ("}]", literal);
+
+  literal = "unchanged";
+  EXPECT_FALSE(PatternMatcher::ParseLiteral("foo.cc", &literal));
+  EXPECT_FALSE(PatternMatcher::ParseLiteral("^foo", &literal));
+  EXPECT_FALSE(PatternMatcher::ParseLiteral("foo$", &literal));
+  EXPECT_FALSE(PatternMatcher::ParseLiteral("a|b", &literal));
+  EXPECT_FALSE(PatternMatcher::ParseLiteral("ab?", &literal));
+  EXPECT_FALSE(PatternMatcher::ParseLiteral("ab*", &literal));
+  EXPECT_FALSE(PatternMatcher::ParseLiteral("ab+", &literal));
+  EXPECT_FALSE(PatternMatcher::ParseLiteral("a{2}", &literal));
+  EXPECT_FALSE(PatternMatcher::ParseLiteral("[ab]", &literal));
+  EXPECT_FALSE(PatternMatcher::ParseLiteral("(ab)", &literal));
+  EXPECT_FALSE(PatternMatcher::ParseLiteral("a\\d", &literal));
+  EXPECT_FALSE(PatternMatcher::ParseLiteral("trailing\\", &literal));
+  EXPECT_FALSE(PatternMatcher::ParseLiteral("caf\xC3\xA9", &literal));
+  EXPECT_EQ("unchanged", literal);
+}
+
+TEST(PatternMatcherTest, FindRequiredLiteral) {
+  EXPECT_EQ("", PatternMatcher::FindRequiredLiteral(""));
+  EXPECT_EQ("foo", PatternMatcher::FindRequiredLiteral("^foo.*"));
+  EXPECT_EQ(" failed", PatternMatcher::FindRequiredLiteral("\\d+ Failed"));
+  EXPECT_EQ("file.cc",
+            PatternMatcher::FindRequiredLiteral("[a-z]+file\\.cc$"));
+  EXPECT_EQ("handl", PatternMatcher::FindRequiredLiteral("handle?"));
+  EXPECT_EQ("abc", PatternMatcher::FindRequiredLiteral("abc(def|ghi)j"));
+  EXPECT_EQ("xyz", PatternMatcher::FindRequiredLiteral("ab*c[]x]xyz"));
+  EXPECT_EQ("ab", PatternMatcher::FindRequiredLiteral("ab+c"));
+  EXPECT_EQ("b", PatternMatcher::FindRequiredLiteral("a{2,3}b"));
+
+  // These give up.
+  EXPECT_EQ("", PatternMatcher::FindRequiredLiteral("foo|bar"));
+  EXPECT_EQ("", PatternMatcher::FindRequiredLiteral("(?x) f o o"));
+  EXPECT_EQ("", PatternMatcher::FindRequiredLiteral("\\x41BCD"));
+  EXPECT_EQ("", PatternMatcher::FindRequiredLiteral("\\Qa.b\\E"));
+  EXPECT_EQ("", PatternMatcher::FindRequiredLiteral("foo[bar"));
+}
+
+TEST(PatternMatcherTest, Literals) {
+  PatternMatcher partial("Opening", PatternMatcher::PARTIAL_MATCH);
+  EXPECT_TRUE(partial.is_literal());
+  EXPECT_TRUE(partial.Matches("opening a file"));
+  EXPECT_TRUE(partial.Matches("Now OPENING"));
+  EXPECT_FALSE(partial.Matches("Closing the file"));
+
+  PatternMatcher full("Opening", PatternMatcher::FULL_MATCH);
+  EXPECT_TRUE(full.is_literal());
+  EXPECT_TRUE(full.Matches("opening"));
+  EXPECT_FALSE(full.Matches("opening a file"));
+
+  PatternMatcher regex("Open.*file", PatternMatcher::PARTIAL_MATCH);
+  EXPECT_FALSE(regex.is_literal());
+  EXPECT_TRUE(regex.Matches("Opening a file"));
+  EXPECT_FALSE(regex.Matches("Opening a door"));
+}
+
+TEST(PatternMatcherTest, InvalidPatternMatchesNothing) {
+  PatternMatcher matcher("foo(", PatternMatcher::PARTIAL_MATCH);
+  EXPECT_FALSE(matcher.is_literal());
+  EXPECT_FALSE(matcher.Matches("foo("));
+  EXPECT_FALSE(matcher.Matches(""));
+}
+
+TEST(PatternMatcherTest, Copy) {
+  PatternMatcher matcher("a+b", PatternMatcher::FULL_MATCH);
+  PatternMatcher copy(matcher);
+  EXPECT_EQ(matcher.pattern(), copy.pattern());
+  EXPECT_EQ(PatternMatcher::FULL_MATCH, copy.type());
+  EXPECT_TRUE(copy.Matches("aaab"));
+  EXPECT_FALSE(copy.Matches("aaabc"));
+
+  copy = PatternMatcher("text", PatternMatcher::PARTIAL_MATCH);
+  EXPECT_TRUE(copy.is_literal());
+  EXPECT_TRUE(copy.Matches("some text"));
+
+  copy = matcher;
+  EXPECT_FALSE(copy.is_literal());
+  EXPECT_TRUE(copy.Matches("ab"));
+  EXPECT_FALSE(copy.Matches("some text"));
+}
+
+// The matcher must agree with what filters used to do with pcrecpp.
+TEST(PatternMatcherTest, AgreesWithPcre) {
+  const char* kPatterns[] = {
+    "", "file", "FILE", "foo\\.cc", "\\.cc$", "^Open", "#1\\d*$",
+    "fail(ed|ing)", "a|b", "open.*file", "x?y", "[fF]ile", "\\bthe\\b",
+    "\\d+", "line\\nbreak", "caf\xC3\xA9", "(?-i)File", "\\Qa.b\\E",
+  };
+  const char* kTexts[] = {
+    "", "file", "File", "Opening a file #12", "Closing the file #1",
+    "foo.cc", "FOO.CC", "dir\\foo.cc", "fooxcc", "Something failed",
+    "y", "b", "line\nbreak", "line\r\nbreak", "caf\xC3\xA9", "CAF\xC3\xA9",
+    "a.b", "axb", "the end",
+  };
+
+  const pcrecpp::RE_Options options(PCRE_NEWLINE_ANYCRLF | PCRE_DOTALL |
+                                    PCRE_UTF8 | PCRE_CASELESS);
+  for (size_t i = 0; i < arraysize(kPatterns); ++i) {
+    pcrecpp::RE re(kPatterns[i], options);
+    PatternMatcher full(kPatterns[i], PatternMatcher::FULL_MATCH);
+    PatternMatcher partial(kPatterns[i], PatternMatcher::PARTIAL_MATCH);
+
+    for (size_t j = 0; j < arraysize(kTexts); ++j) {
+      EXPECT_EQ(re.FullMatch(kTexts[j]), full.Matches(kTexts[j]))
+          << "'" << kPatterns[i] << "' on '" << kTexts[j] << "'";
+      EXPECT_EQ(re.PartialMatch(kTexts[j]), partial.Matches(kTexts[j]))
+          << "'" << kPatterns[i] << "' in '" << kTexts[j] << "'";
+    }
+  }
+}
+
+}  // namespace
@@ -79,6 +79,61 @@ bool Preferences::ReadStringValue(const wchar_t* name,
   return result;
 }
 
+bool Preferences::WriteDWORDValue(const wchar_t* name, DWORD value) {
+  if (!EnsureWritableKey())
+    return false;
+
+  LONG err = key_.SetDWORDValue(name, value);
+  return err == ERROR_SUCCESS;
+}
+
+bool Preferences::ReadDWORDValue(const wchar_t* name,
+                                 DWORD* value,
+                                 DWORD default_value) {
+  DCHECK(value != NULL);
+
+  if (EnsureReadableKey() &&
+      key_.QueryDWORDValue(name, *value) == ERROR_SUCCESS) {
+    return true;
+  }
+
+  *value = default_value;
+  return false;
+}
+
+bool Preferences::WriteBinaryValue(const wchar_t* name,
+                                   const std::string& value) {
+  if (!EnsureWritableKey())
+    return false;
+
+  LONG err = key_.SetBinaryValue(name, value.data(),
+                                 static_cast<ULONG>(value.size()));
+  return err == ERROR_SUCCESS;
+}
+
+bool Preferences::ReadBinaryValue(const wchar_t* name, std::string* value) {
+  DCHECK(value != NULL);
+
+  if (!EnsureReadableKey())
+    return false;
+
+  ULONG len = 0;
+  LONG err = key_.QueryBinaryValue(name, NULL, &len);
+  if (err != ERROR_SUCCESS)
+    return false;
+
+  value->resize(len);
+  if (len == 0)
+    return true;
+
+  err = key_.QueryBinaryValue(name, &(*value)[0], &len);
+  if (err != ERROR_SUCCESS)
+    return false;
+
+  value->resize(len);
+  return true;
+}
+
 bool Preferences::EnsureReadableKey() {
   if (key_)
     return true;
@@ -32,6 +32,15 @@ class Preferences {
   bool ReadStringValue(const wchar_t* name,
                        std::wstring* value,
                        const wchar_t* default_value);
+
+  bool WriteDWORDValue(const wchar_t* name, DWORD value);
+  bool ReadDWORDValue(const wchar_t* name,
+                      DWORD* value,
+                      DWORD default_value);
+
+  bool WriteBinaryValue(const wchar_t* name, const std::string& value);
+  bool ReadBinaryValue(const wchar_t* name, std::string* value);
+
  private:
   bool EnsureReadableKey();
   bool EnsureWritableKey();
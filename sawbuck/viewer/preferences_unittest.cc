@@ -79,4 +79,49 @@ TEST_F(PreferencesTest, WriteStringValue) {
   EXPECT_STREQ(L"bar2", str.c_str());
 }
 
+TEST_F(PreferencesTest, ReadDWORDValue) {
+  Register(kStringPrefences);
+
+  Preferences pref;
+
+  DWORD value = 0;
+  EXPECT_TRUE(pref.ReadDWORDValue(L"number", &value, 42));
+  EXPECT_EQ(12345U, value);
+
+  // The default is returned for missing and mistyped values.
+  EXPECT_FALSE(pref.ReadDWORDValue(L"foo", &value, 42));
+  EXPECT_EQ(42U, value);
+  EXPECT_FALSE(pref.ReadDWORDValue(L"missing", &value, 43));
+  EXPECT_EQ(43U, value);
+}
+
+TEST_F(PreferencesTest, WriteDWORDValue) {
+  Preferences pref;
+
+  EXPECT_TRUE(pref.WriteDWORDValue(L"number", 54321));
+
+  DWORD value = 0;
+  EXPECT_TRUE(pref.ReadDWORDValue(L"number", &value, 0));
+  EXPECT_EQ(54321U, value);
+}
+
+TEST_F(PreferencesTest, BinaryValue) {
+  Register(kStringPrefences);
+
+  Preferences pref;
+
+  std::string value;
+  EXPECT_FALSE(pref.ReadBinaryValue(L"missing", &value));
+  EXPECT_FALSE(pref.ReadBinaryValue(L"foo", &value));
+
+  const std::string blob("\x00\x01" "binary\xff", 9);
+  EXPECT_TRUE(pref.WriteBinaryValue(L"blob", blob));
+  EXPECT_TRUE(pref.ReadBinaryValue(L"blob", &value));
+  EXPECT_EQ(blob, value);
+
+  EXPECT_TRUE(pref.WriteBinaryValue(L"blob", std::string()));
+  EXPECT_TRUE(pref.ReadBinaryValue(L"blob", &value));
+  EXPECT_TRUE(value.empty());
+}
+
 }  // namespace
@@ -0,0 +1,171 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Process instance index implementation.
+#include "sawbuck/viewer/process_instance_index.h"
+
+#include "base/logging.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+#include "sawbuck/log_lib/process_info_service.h"
+#include "sawbuck/viewer/log_list_view.h"
+#include "sawbuck/viewer/log_store.h"
+
+const ProcessInstanceIndex::InstanceId ProcessInstanceIndex::kUnknownInstance;
+
+// static
+std::string ProcessInstanceIndex::GetImageFileName(
+    const std::wstring& command_line) {
+  std::wstring image;
+  if (!command_line.empty() && command_line[0] == L'"') {
+    size_t end = command_line.find(L'"', 1);
+    image = command_line.substr(1, end == std::wstring::npos ?
+        std::wstring::npos : end - 1);
+  } else {
+    image = command_line.substr(0, command_line.find_first_of(L" \t"));
+  }
+
+  size_t separator = image.find_last_of(L"\\/:");
+  if (separator != std::wstring::npos)
+    image = image.substr(separator + 1);
+  return base::WideToUTF8(StringToLowerASCII(image));
+}
+
+// static
+std::string ProcessInstanceIndex::FormatInstanceKey(
+    DWORD process_id, const base::Time& started) {
+  return base::StringPrintf("%u@%lld", process_id,
+                            started.ToInternalValue());
+}
+
+ProcessInstanceIndex::Instance::Instance() : process_id(0) {
+}
+
+ProcessInstanceIndex::ProcessInstanceIndex(
+    IProcessInfoService* process_info_service)
+    : process_info_service_(process_info_service) {
+  DCHECK(process_info_service != NULL);
+  // The unknown instance comes first, as kUnknownInstance.
+  instances_.push_back(Instance());
+}
+
+ProcessInstanceIndex::~ProcessInstanceIndex() {
+}
+
+ProcessInstanceIndex::InstanceId ProcessInstanceIndex::GetInstance(
+    DWORD process_id, const base::Time& time) {
+  base::AutoLock lock(lock_);
+  return LookUp(process_id, time);
+}
+
+void ProcessInstanceIndex::GetInstances(ILogView* view,
+                                        const LogStore* store,
+                                        const int* rows,
+                                        int num_rows,
+                                        InstanceId* instances) {
+  DCHECK(view != NULL);
+  DCHECK(num_rows == 0 || (rows != NULL && instances != NULL));
+
+  const DWORD* process_ids = store != NULL ? store->process_ids() : NULL;
+  const int64* times = store != NULL ? store->times() : NULL;
+  int first_row = store != NULL ? store->first_row() : 0;
+
+  base::AutoLock lock(lock_);
+  // The run of rows of the last instance looked up goes on for as long as
+  // the process id stays the same and the instance is running.
+  bool in_run = false;
+  DWORD run_process_id = 0;
+  InstanceId run_instance = kUnknownInstance;
+  for (int i = 0; i < num_rows; ++i) {
+    int row = rows[i];
+    DWORD process_id = process_ids != NULL ?
+        process_ids[row - first_row] : view->GetProcessId(row);
+    base::Time time = times != NULL ?
+        base::Time::FromInternalValue(times[row - first_row]) :
+        view->GetTime(row);
+
+    if (!in_run || process_id != run_process_id ||
+        (run_instance != kUnknownInstance &&
+         !IsRunning(run_instance, time))) {
+      run_instance = LookUp(process_id, time);
+      run_process_id = process_id;
+      in_run = true;
+    }
+    instances[i] = run_instance;
+  }
+}
+
+std::string ProcessInstanceIndex::GetImageName(InstanceId instance) {
+  base::AutoLock lock(lock_);
+  DCHECK_LT(instance, instances_.size());
+  return instances_[instance].image_name;
+}
+
+std::string ProcessInstanceIndex::GetCommandLine(InstanceId instance) {
+  base::AutoLock lock(lock_);
+  DCHECK_LT(instance, instances_.size());
+  return instances_[instance].command_line;
+}
+
+std::string ProcessInstanceIndex::GetInstanceKey(InstanceId instance) {
+  base::AutoLock lock(lock_);
+  DCHECK_LT(instance, instances_.size());
+  if (instance == kUnknownInstance)
+    return std::string();
+
+  const Instance& entry = instances_[instance];
+  return FormatInstanceKey(entry.process_id, entry.started);
+}
+
+size_t ProcessInstanceIndex::num_instances() {
+  base::AutoLock lock(lock_);
+  return instances_.size();
+}
+
+ProcessInstanceIndex::InstanceId ProcessInstanceIndex::LookUp(
+    DWORD process_id, const base::Time& time) {
+  lock_.AssertAcquired();
+
+  IProcessInfoService::ProcessInfo info;
+  if (!process_info_service_->GetProcessInfo(process_id, time, &info))
+    return kUnknownInstance;
+
+  std::pair<InstanceMap::iterator, bool> inserted(instance_ids_.insert(
+      std::make_pair(std::make_pair(process_id,
+                                    info.started_.ToInternalValue()),
+                     static_cast<InstanceId>(instances_.size()))));
+  if (inserted.second) {
+    Instance instance;
+    instance.process_id = process_id;
+    instance.started = info.started_;
+    instance.image_name = GetImageFileName(info.command_line_);
+    instance.command_line = base::WideToUTF8(info.command_line_);
+    instances_.push_back(instance);
+  }
+
+  // The process may have ended since it was last looked up.
+  instances_[inserted.first->second].ended = info.ended_;
+  return inserted.first->second;
+}
+
+bool ProcessInstanceIndex::IsRunning(InstanceId instance,
+                                     const base::Time& time) const {
+  lock_.AssertAcquired();
+  DCHECK_LT(instance, instances_.size());
+
+  const Instance& entry = instances_[instance];
+  return time >= entry.started &&
+      (entry.ended.is_null() || time < entry.ended);
+}
@@ -0,0 +1,130 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Process instance index declaration.
+#ifndef SAWBUCK_VIEWER_PROCESS_INSTANCE_INDEX_H_
+#define SAWBUCK_VIEWER_PROCESS_INSTANCE_INDEX_H_
+
+#include <windows.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+
+// Forward decls.
+class ILogView;
+class IProcessInfoService;
+class LogStore;
+
+// Tells the process instances of log rows apart, by joining each row's
+// process id and time against the lifetimes of the processes the process
+// info service knows of. Process ids are reused as processes come and go,
+// so over a long capture a process id doesn't tell a process, where an
+// instance does. Each instance is named by the image its command line
+// starts with, and has its command line.
+//
+// Instances are interned, so clients can tell the outcome of a match on an
+// instance by its id, and ids keep their meaning for the lifetime of the
+// index. Rows come in runs of a process, so the join is done a run at a
+// time, and a run of rows only costs a lookup of its first row.
+// @note this class is thread safe, and reads the views and stores it's
+//     handed from the calling thread, which must be allowed to.
+class ProcessInstanceIndex {
+ public:
+  // Identifies a process instance.
+  typedef uint32 InstanceId;
+  // The instance of rows of processes not known to the service.
+  static const InstanceId kUnknownInstance = 0;
+
+  // @param process_info_service the service to look the processes up in,
+  //     which must outlive the index.
+  explicit ProcessInstanceIndex(IProcessInfoService* process_info_service);
+  ~ProcessInstanceIndex();
+
+  // @returns the instance of process @p process_id at @p time.
+  InstanceId GetInstance(DWORD process_id, const base::Time& time);
+
+  // Joins @p num_rows rows of @p view to their instances, to @p instances.
+  // @param store if non-NULL, the store backing @p view row for row, which
+  //     is then read directly.
+  // @param rows the rows to join, in any order, though rows in runs of a
+  //     process join fastest.
+  void GetInstances(ILogView* view,
+                    const LogStore* store,
+                    const int* rows,
+                    int num_rows,
+                    InstanceId* instances);
+
+  // @returns the file name of @p instance's image in lower case, UTF8
+  //     encoded, or an empty string for kUnknownInstance.
+  std::string GetImageName(InstanceId instance);
+  // @returns the command line of @p instance, UTF8 encoded, or an empty
+  //     string for kUnknownInstance.
+  std::string GetCommandLine(InstanceId instance);
+
+  // @returns the key of @p instance, which names it for the process
+  //     instance filters, or an empty string for kUnknownInstance.
+  std::string GetInstanceKey(InstanceId instance);
+
+  // @returns the number of instances seen, including kUnknownInstance.
+  size_t num_instances();
+
+  // @returns the key of the instance of @p process_id started at
+  //     @p started, its process id and the internal value of its start
+  //     time, e.g. "1234@128000000000000000". The processes running as the
+  //     log began have a start time of zero.
+  static std::string FormatInstanceKey(DWORD process_id,
+                                       const base::Time& started);
+
+  // @returns the file name of the image @p command_line starts with, in
+  //     lower case and UTF8 encoded, which is quoted if it has spaces.
+  static std::string GetImageFileName(const std::wstring& command_line);
+
+ private:
+  struct Instance {
+    Instance();
+
+    DWORD process_id;
+    base::Time started;
+    // Null while the process is running, as of the last lookup.
+    base::Time ended;
+    std::string image_name;
+    std::string command_line;
+  };
+
+  // @returns the instance of process @p process_id at @p time.
+  // @note must be called under lock_.
+  InstanceId LookUp(DWORD process_id, const base::Time& time);
+
+  // @returns true iff @p instance was running at @p time, as of its last
+  //     lookup. A process still running then is taken to run on.
+  // @note must be called under lock_.
+  bool IsRunning(InstanceId instance, const base::Time& time) const;
+
+  IProcessInfoService* process_info_service_;
+
+  base::Lock lock_;
+  // The instances seen, by id.
+  std::vector<Instance> instances_;  // Under lock_.
+  // The ids of the instances seen, by process id and start time.
+  typedef std::map<std::pair<DWORD, int64>, InstanceId> InstanceMap;
+  InstanceMap instance_ids_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(ProcessInstanceIndex);
+};
+
+#endif  // SAWBUCK_VIEWER_PROCESS_INSTANCE_INDEX_H_
@@ -0,0 +1,220 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Process instance index unittests.
+#include "sawbuck/viewer/process_instance_index.h"
+
+#include <evntrace.h>
+#include "base/strings/utf_string_conversions.h"
+#include "gtest/gtest.h"
+#include "sawbuck/log_lib/process_info_service.h"
+#include "sawbuck/viewer/filter.h"
+#include "sawbuck/viewer/filter_program.h"
+#include "sawbuck/viewer/log_store.h"
+#include "sawbuck/viewer/store_log_view.h"
+
+namespace {
+
+using testing::StoreLogView;
+
+const DWORD kPid = 42;
+
+base::Time Seconds(int seconds) {
+  return base::Time::FromInternalValue(
+      base::Time::kMicrosecondsPerSecond * (1000 + seconds));
+}
+
+// Knows of the processes added to it, and counts the lookups.
+class FakeProcessInfoService : public IProcessInfoService {
+ public:
+  FakeProcessInfoService() : num_lookups_(0) {
+  }
+
+  // Adds a process with @p command_line, running from @p started on, and
+  // until @p ended if it's non-null.
+  void AddProcess(DWORD process_id,
+                  const wchar_t* command_line,
+                  const base::Time& started,
+                  const base::Time& ended) {
+    ProcessInfo info = {};
+    info.process_id_ = process_id;
+    info.command_line_ = command_line;
+    info.started_ = started;
+    info.ended_ = ended;
+    processes_.push_back(info);
+  }
+
+  virtual bool GetProcessInfo(DWORD process_id, const base::Time& time,
+                              ProcessInfo* info) {
+    ++num_lookups_;
+    for (size_t i = 0; i < processes_.size(); ++i) {
+      const ProcessInfo& process = processes_[i];
+      if (process.process_id_ == process_id && time >= process.started_ &&
+          (process.ended_.is_null() || time < process.ended_)) {
+        *info = process;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  int num_lookups() const { return num_lookups_; }
+
+ private:
+  std::vector<ProcessInfo> processes_;
+  int num_lookups_;
+};
+
+class ProcessInstanceIndexTest : public testing::Test {
+ public:
+  ProcessInstanceIndexTest()
+      : store_(&file_table_), index_(&service_), view_(&store_) {
+    view_.set_process_instance_index(&index_);
+  }
+
+  virtual void SetUp() {
+    // The pid is reused by a second process, with a quoted image path.
+    service_.AddProcess(kPid, L"C:\\Windows\\System32\\Svchost.exe -k net",
+                        Seconds(0), Seconds(100));
+    service_.AddProcess(kPid, L"\"C:\\Program Files\\App\\app.exe\" --type",
+                        Seconds(100), base::Time());
+  }
+
+  // Adds a row of @p process_id at @p seconds.
+  int AddRow(DWORD process_id, int seconds) {
+    return store_.AddRow(TRACE_LEVEL_INFORMATION, process_id, 1,
+                         Seconds(seconds), 0, 0, "", 0, NULL);
+  }
+
+ protected:
+  FakeProcessInfoService service_;
+  StringTable file_table_;
+  LogStore store_;
+  ProcessInstanceIndex index_;
+  StoreLogView view_;
+};
+
+TEST_F(ProcessInstanceIndexTest, GetInstance) {
+  ProcessInstanceIndex::InstanceId svchost = index_.GetInstance(kPid,
+                                                                Seconds(10));
+  ProcessInstanceIndex::InstanceId app = index_.GetInstance(kPid,
+                                                            Seconds(150));
+  EXPECT_NE(ProcessInstanceIndex::kUnknownInstance, svchost);
+  EXPECT_NE(ProcessInstanceIndex::kUnknownInstance, app);
+  EXPECT_NE(svchost, app);
+  EXPECT_EQ(svchost, index_.GetInstance(kPid, Seconds(99)));
+  EXPECT_EQ(ProcessInstanceIndex::kUnknownInstance,
+            index_.GetInstance(kPid + 1, Seconds(10)));
+  EXPECT_EQ(ProcessInstanceIndex::kUnknownInstance,
+            index_.GetInstance(kPid, Seconds(-10)));
+  EXPECT_EQ(3U, index_.num_instances());
+
+  EXPECT_EQ("svchost.exe", index_.GetImageName(svchost));
+  EXPECT_EQ("C:\\Windows\\System32\\Svchost.exe -k net",
+            index_.GetCommandLine(svchost));
+  EXPECT_EQ("app.exe", index_.GetImageName(app));
+  EXPECT_EQ("", index_.GetImageName(ProcessInstanceIndex::kUnknownInstance));
+}
+
+TEST_F(ProcessInstanceIndexTest, GetInstancesByRun) {
+  const int kNumRows = 200;
+  for (int i = 0; i < kNumRows; ++i)
+    AddRow(kPid, i);
+  AddRow(kPid + 1, 1);
+  AddRow(kPid + 1, 2);
+
+  std::vector<int> rows;
+  for (int i = 0; i < store_.num_rows(); ++i)
+    rows.push_back(i);
+  std::vector<ProcessInstanceIndex::InstanceId> instances(rows.size());
+  index_.GetInstances(&view_, &store_, &rows[0], rows.size(),
+                      &instances[0]);
+
+  ProcessInstanceIndex::InstanceId svchost = index_.GetInstance(kPid,
+                                                                Seconds(0));
+  ProcessInstanceIndex::InstanceId app = index_.GetInstance(kPid,
+                                                            Seconds(100));
+  for (int i = 0; i < kNumRows; ++i)
+    EXPECT_EQ(i < 100 ? svchost : app, instances[i]);
+  EXPECT_EQ(ProcessInstanceIndex::kUnknownInstance, instances[kNumRows]);
+  EXPECT_EQ(ProcessInstanceIndex::kUnknownInstance, instances[kNumRows + 1]);
+
+  // A lookup per run of a process, and the two above.
+  EXPECT_EQ(5, service_.num_lookups());
+
+  // Reading through the view joins alike.
+  std::vector<ProcessInstanceIndex::InstanceId> view_instances(rows.size());
+  index_.GetInstances(&view_, NULL, &rows[0], rows.size(),
+                      &view_instances[0]);
+  EXPECT_TRUE(instances == view_instances);
+}
+
+TEST_F(ProcessInstanceIndexTest, Filters) {
+  int svchost = AddRow(kPid, 10);
+  int app = AddRow(kPid, 110);
+  int unknown = AddRow(kPid + 1, 110);
+
+  Filter name(Filter::PROCESS_NAME, Filter::IS, Filter::INCLUDE,
+              L"svchost.exe");
+  EXPECT_TRUE(name.Matches(&view_, svchost));
+  EXPECT_FALSE(name.Matches(&view_, app));
+  EXPECT_FALSE(name.Matches(&view_, unknown));
+
+  Filter command_line(Filter::COMMAND_LINE, Filter::CONTAINS,
+                      Filter::INCLUDE, L"--type");
+  EXPECT_FALSE(command_line.Matches(&view_, svchost));
+  EXPECT_TRUE(command_line.Matches(&view_, app));
+  EXPECT_FALSE(command_line.Matches(&view_, unknown));
+
+  // The instance filters tell the instances of a process id apart.
+  std::wstring key(base::UTF8ToWide(
+      ProcessInstanceIndex::FormatInstanceKey(kPid, Seconds(100))));
+  Filter instance(Filter::PROCESS_INSTANCE, Filter::IS, Filter::INCLUDE,
+                  key.c_str());
+  EXPECT_FALSE(instance.Matches(&view_, svchost));
+  EXPECT_TRUE(instance.Matches(&view_, app));
+  EXPECT_FALSE(instance.Matches(&view_, unknown));
+  EXPECT_EQ("",
+            index_.GetInstanceKey(ProcessInstanceIndex::kUnknownInstance));
+
+  // Views without an index match no process filter.
+  StoreLogView no_index(&store_);
+  EXPECT_FALSE(name.Matches(&no_index, svchost));
+}
+
+TEST_F(ProcessInstanceIndexTest, FilterProgram) {
+  const int kNumRows = 1000;
+  for (int i = 0; i < kNumRows; ++i)
+    AddRow(kPid, i / 5);
+
+  std::vector<Filter> inclusion;
+  inclusion.push_back(
+      Filter(Filter::PROCESS_NAME, Filter::IS, Filter::INCLUDE, L"app.exe"));
+  std::vector<Filter> exclusion;
+  exclusion.push_back(Filter(Filter::COMMAND_LINE, Filter::CONTAINS,
+                             Filter::EXCLUDE, L"svchost"));
+  FilterProgram program(inclusion, exclusion);
+  std::vector<int> rows;
+  program.Run(&view_, &store_, NULL, 0, kNumRows, &rows);
+
+  ASSERT_EQ(kNumRows / 2, rows.size());
+  for (size_t i = 0; i < rows.size(); ++i)
+    EXPECT_EQ(kNumRows / 2 + static_cast<int>(i), rows[i]);
+
+  // Each block joins once for both filters, with a lookup per instance.
+  EXPECT_GE(2 * (kNumRows / FilterProgram::kBlockRows + 1) + 2,
+            service_.num_lookups());
+}
+
+}  // namespace
@@ -0,0 +1,392 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Process tree implementation.
+#include "sawbuck/viewer/process_tree.h"
+
+#include <algorithm>
+#include "base/logging.h"
+#include "sawbuck/viewer/log_diff.h"
+#include "sawbuck/viewer/log_store.h"
+#include "sawbuck/viewer/process_instance_index.h"
+
+namespace {
+
+// @returns true iff @p message is that of a trace event row of type BEGIN.
+bool IsSpanBegin(const base::StringPiece& message) {
+  static const char kBegin[] = "BEGIN(";
+  if (!message.starts_with(base::StringPiece(kBegin, arraysize(kBegin) - 1)))
+    return false;
+
+  base::StringPiece type;
+  base::StringPiece name;
+  void* id = NULL;
+  return LogDiff::ParseTraceMessage(message, &type, &name, &id);
+}
+
+}  // namespace
+
+const ProcessTree::NodeId ProcessTree::kNoNode;
+const size_t ProcessTree::kNumLevels;
+
+ProcessTree::Node::Node()
+    : id(kNoNode), parent(kNoNode), process_id(0), parent_process_id(0),
+      known(false), spans(0), page_faults(0), bytes_logged(0) {
+  for (size_t i = 0; i < kNumLevels; ++i)
+    rows[i] = 0;
+}
+
+ProcessTree::ProcessTree()
+    : process_sink_(NULL), last_tally_node_(kNoNode), nodes_taken_(0),
+      reshaped_(false) {
+}
+
+ProcessTree::~ProcessTree() {
+}
+
+void ProcessTree::AddRow(DWORD process_id,
+                         const base::Time& time,
+                         UCHAR level,
+                         const base::StringPiece& message) {
+  base::AutoLock lock(lock_);
+  TallyRow(GetTallyNode(process_id, time), level, message);
+}
+
+void ProcessTree::AddStoreRows(const LogStore& store, int begin, int end) {
+  DCHECK_LE(store.first_row(), begin);
+  DCHECK_LE(end, store.num_rows());
+
+  const UCHAR* levels = store.levels();
+  const DWORD* process_ids = store.process_ids();
+  const int64* times = store.times();
+  int first_row = store.first_row();
+  std::string buffer;
+
+  base::AutoLock lock(lock_);
+  for (int row = begin; row < end; ++row) {
+    int index = row - first_row;
+    Node* node = GetTallyNode(process_ids[index],
+                              base::Time::FromInternalValue(times[index]));
+    TallyRow(node, levels[index], store.GetMessage(row, &buffer));
+  }
+}
+
+void ProcessTree::ClearTallies() {
+  base::AutoLock lock(lock_);
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    Node& node = nodes_[i];
+    for (size_t j = 0; j < kNumLevels; ++j)
+      node.rows[j] = 0;
+    node.spans = 0;
+    node.page_faults = 0;
+    node.bytes_logged = 0;
+  }
+  // Every node changed, so they're all handed out anyway.
+  reshaped_ = true;
+}
+
+bool ProcessTree::TakeChanges(std::vector<Node>* nodes) {
+  DCHECK(nodes != NULL);
+  nodes->clear();
+
+  base::AutoLock lock(lock_);
+  bool reshaped = reshaped_;
+  if (reshaped) {
+    nodes->assign(nodes_.begin(), nodes_.end());
+  } else {
+    std::sort(changed_.begin(), changed_.end());
+    nodes->reserve(changed_.size());
+    for (size_t i = 0; i < changed_.size(); ++i)
+      nodes->push_back(nodes_[changed_[i]]);
+  }
+
+  for (size_t i = 0; i < changed_.size(); ++i)
+    is_changed_[changed_[i]] = false;
+  changed_.clear();
+  nodes_taken_ = nodes_.size();
+  reshaped_ = false;
+  return reshaped;
+}
+
+size_t ProcessTree::num_nodes() {
+  base::AutoLock lock(lock_);
+  return nodes_.size();
+}
+
+void ProcessTree::OnProcessIsRunning(const base::Time& time,
+                                     const ProcessInfo& process_info) {
+  {
+    base::AutoLock lock(lock_);
+    // Recorded as started at epoch, as the process info service does.
+    AddProcess(base::Time(), process_info);
+  }
+  if (process_sink_ != NULL)
+    process_sink_->OnProcessIsRunning(time, process_info);
+}
+
+void ProcessTree::OnProcessStarted(const base::Time& time,
+                                   const ProcessInfo& process_info) {
+  {
+    base::AutoLock lock(lock_);
+    AddProcess(time, process_info);
+  }
+  if (process_sink_ != NULL)
+    process_sink_->OnProcessStarted(time, process_info);
+}
+
+void ProcessTree::OnProcessEnded(const base::Time& time,
+                                 const ProcessInfo& process_info,
+                                 ULONG exit_status) {
+  {
+    base::AutoLock lock(lock_);
+    // The end may be replayed, and a process we didn't see start was
+    // running as the log began.
+    NodeId id = FindInstance(process_info.process_id, time, true);
+    if (id == kNoNode)
+      id = AddProcess(base::Time(), process_info);
+    if (nodes_[id].ended.is_null()) {
+      nodes_[id].ended = time;
+      MarkChanged(id);
+    }
+  }
+  if (process_sink_ != NULL)
+    process_sink_->OnProcessEnded(time, process_info, exit_status);
+}
+
+void ProcessTree::OnTransitionFault(DWORD process_id,
+                                    DWORD thread_id,
+                                    const base::Time& time,
+                                    sym_util::Address address,
+                                    sym_util::Address program_counter) {
+  AddPageFault(process_id, time);
+}
+
+void ProcessTree::OnDemandZeroFault(DWORD process_id,
+                                    DWORD thread_id,
+                                    const base::Time& time,
+                                    sym_util::Address address,
+                                    sym_util::Address program_counter) {
+  AddPageFault(process_id, time);
+}
+
+void ProcessTree::OnCopyOnWriteFault(DWORD process_id,
+                                     DWORD thread_id,
+                                     const base::Time& time,
+                                     sym_util::Address address,
+                                     sym_util::Address program_counter) {
+  AddPageFault(process_id, time);
+}
+
+void ProcessTree::OnGuardPageFault(DWORD process_id,
+                                   DWORD thread_id,
+                                   const base::Time& time,
+                                   sym_util::Address address,
+                                   sym_util::Address program_counter) {
+  AddPageFault(process_id, time);
+}
+
+void ProcessTree::OnHardFault(DWORD process_id,
+                              DWORD thread_id,
+                              const base::Time& time,
+                              sym_util::Address address,
+                              sym_util::Address program_counter) {
+  AddPageFault(process_id, time);
+}
+
+void ProcessTree::OnAccessViolationFault(DWORD process_id,
+                                         DWORD thread_id,
+                                         const base::Time& time,
+                                         sym_util::Address address,
+                                         sym_util::Address program_counter) {
+  AddPageFault(process_id, time);
+}
+
+void ProcessTree::OnHardPageFault(DWORD thread_id,
+                                  const base::Time& time,
+                                  const base::Time& initial_time,
+                                  sym_util::Offset offset,
+                                  sym_util::Address address,
+                                  sym_util::Address file_object,
+                                  sym_util::ByteCount byte_count) {
+}
+
+ProcessTree::NodeId ProcessTree::AddProcess(const base::Time& time,
+                                            const ProcessInfo& process_info) {
+  lock_.AssertAcquired();
+
+  // The kernel events of a log are replayed for each import of it, so a
+  // process may come round again.
+  InstanceList& instances = instances_[process_info.process_id];
+  for (size_t i = 0; i < instances.size(); ++i) {
+    const Node& node = nodes_[instances[i]];
+    if (node.started == time && node.command_line == process_info.command_line)
+      return node.id;
+  }
+
+  NodeId id = static_cast<NodeId>(nodes_.size());
+  nodes_.push_back(Node());
+  is_changed_.push_back(false);
+  Node& node = nodes_.back();
+  node.id = id;
+  node.process_id = process_info.process_id;
+  node.parent_process_id = process_info.parent_id;
+  node.known = true;
+  node.started = time;
+  node.image_name =
+      ProcessInstanceIndex::GetImageFileName(process_info.command_line);
+  node.command_line = process_info.command_line;
+
+  // The instances stay in start order, though they mostly start in order.
+  InstanceList::iterator it = instances.end();
+  while (it != instances.begin() && nodes_[*(it - 1)].started > time)
+    --it;
+  instances.insert(it, id);
+
+  MarkChanged(id);
+  Attach(id);
+  return id;
+}
+
+void ProcessTree::Attach(NodeId id) {
+  lock_.AssertAcquired();
+
+  Node& node = nodes_[id];
+  NodeId parent = FindInstance(node.parent_process_id, node.started, false);
+  if (parent != kNoNode && !IsAncestor(id, parent)) {
+    node.parent = parent;
+  } else if (node.started.is_null()) {
+    // The processes running as the log began come in any order, so the
+    // parent may yet come.
+    orphans_.insert(std::make_pair(node.parent_process_id, id));
+  }
+
+  // Likewise this may be the parent of processes seen running before it.
+  if (!node.started.is_null())
+    return;
+  std::pair<OrphanMap::iterator, OrphanMap::iterator> range =
+      orphans_.equal_range(node.process_id);
+  OrphanMap::iterator it = range.first;
+  while (it != range.second) {
+    NodeId orphan = it->second;
+    if (IsAncestor(orphan, id)) {
+      ++it;
+      continue;
+    }
+
+    nodes_[orphan].parent = id;
+    MarkChanged(orphan);
+    // The pane has the orphan as a root if it was handed out.
+    if (orphan < nodes_taken_)
+      reshaped_ = true;
+    orphans_.erase(it++);
+  }
+}
+
+bool ProcessTree::IsAncestor(NodeId ancestor, NodeId node) const {
+  lock_.AssertAcquired();
+
+  for (; node != kNoNode; node = nodes_[node].parent) {
+    if (node == ancestor)
+      return true;
+  }
+  return false;
+}
+
+ProcessTree::NodeId ProcessTree::FindInstance(DWORD process_id,
+                                              const base::Time& time,
+                                              bool at_end) const {
+  lock_.AssertAcquired();
+
+  InstanceMap::const_iterator found = instances_.find(process_id);
+  if (found == instances_.end())
+    return kNoNode;
+
+  // Only the last instance to start by the time can be running then.
+  const InstanceList& instances = found->second;
+  for (size_t i = instances.size(); i != 0; --i) {
+    const Node& node = nodes_[instances[i - 1]];
+    if (node.started <= time) {
+      if (node.ended.is_null() || time < node.ended ||
+          (at_end && time == node.ended)) {
+        return node.id;
+      }
+      break;
+    }
+  }
+  return kNoNode;
+}
+
+ProcessTree::Node* ProcessTree::GetTallyNode(DWORD process_id,
+                                             const base::Time& time) {
+  lock_.AssertAcquired();
+
+  if (last_tally_node_ != kNoNode) {
+    const Node& last = nodes_[last_tally_node_];
+    if (last.process_id == process_id &&
+        (!last.known || (last.started <= time &&
+                         (last.ended.is_null() || time < last.ended)))) {
+      // The process may have started since its rows began tallying to
+      // its unknown node.
+      if (last.known || instances_.find(process_id) == instances_.end())
+        return &nodes_[last_tally_node_];
+    }
+  }
+
+  NodeId id = FindInstance(process_id, time, false);
+  if (id == kNoNode) {
+    std::pair<std::map<DWORD, NodeId>::iterator, bool> inserted =
+        unknown_nodes_.insert(
+            std::make_pair(process_id, static_cast<NodeId>(nodes_.size())));
+    id = inserted.first->second;
+    if (inserted.second) {
+      nodes_.push_back(Node());
+      is_changed_.push_back(false);
+      nodes_.back().id = id;
+      nodes_.back().process_id = process_id;
+    }
+  }
+
+  last_tally_node_ = id;
+  return &nodes_[id];
+}
+
+void ProcessTree::TallyRow(Node* node,
+                           UCHAR level,
+                           const base::StringPiece& message) {
+  lock_.AssertAcquired();
+  DCHECK(node != NULL);
+
+  ++node->rows[std::min(static_cast<size_t>(level), kNumLevels - 1)];
+  node->bytes_logged += message.size();
+  if (IsSpanBegin(message))
+    ++node->spans;
+  MarkChanged(node->id);
+}
+
+void ProcessTree::AddPageFault(DWORD process_id, const base::Time& time) {
+  base::AutoLock lock(lock_);
+  Node* node = GetTallyNode(process_id, time);
+  ++node->page_faults;
+  MarkChanged(node->id);
+}
+
+void ProcessTree::MarkChanged(NodeId id) {
+  lock_.AssertAcquired();
+  DCHECK_LT(id, is_changed_.size());
+
+  if (!is_changed_[id]) {
+    is_changed_[id] = true;
+    changed_.push_back(id);
+  }
+}
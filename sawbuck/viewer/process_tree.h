@@ -0,0 +1,234 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Process tree declaration.
+#ifndef SAWBUCK_VIEWER_PROCESS_TREE_H_
+#define SAWBUCK_VIEWER_PROCESS_TREE_H_
+
+#include <windows.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+
+class LogStore;
+
+// Arranges the process instances of the kernel log into a tree by parent
+// process, and tallies the log rows, trace spans, page faults and bytes
+// logged of each instance as they're ingested. Instances are told apart
+// as ProcessInstanceIndex tells them, by process id and start time, and
+// the rows of process ids the kernel log hasn't told of tally to a node
+// per process id.
+//
+// The tallies are kept up as the events come in, so reading them costs
+// nothing of the length of the log. The tree's pane only takes the nodes
+// that changed since it last looked, see TakeChanges, so that with
+// thousands of short lived processes, an update costs the processes that
+// were active in the meantime rather than all of them.
+// The process events are passed on to another sink, so the tree can sit
+// in the chain of sinks of the kernel log.
+// @note this class is thread safe.
+class ProcessTree : public KernelProcessEvents, public KernelPageFaultEvents {
+ public:
+  // Identifies a node, in the order the nodes were added.
+  typedef uint32 NodeId;
+  static const NodeId kNoNode = static_cast<NodeId>(-1);
+
+  // The severities the rows tally by, TRACE_LEVEL_NONE through
+  // TRACE_LEVEL_VERBOSE, with any level past verbose as verbose.
+  static const size_t kNumLevels = 6;
+
+  struct Node {
+    Node();
+
+    NodeId id;
+    // The node of the parent process, or kNoNode for a root.
+    NodeId parent;
+    DWORD process_id;
+    DWORD parent_process_id;
+    // False for the node of a process id the kernel log hasn't told of,
+    // which has no start time or command line.
+    bool known;
+    // Null for processes that were running as the log began.
+    base::Time started;
+    // Null while the process is running.
+    base::Time ended;
+    // The file name of the image in lower case, UTF8 encoded, as
+    // ProcessInstanceIndex names the instances.
+    std::string image_name;
+    std::wstring command_line;
+
+    // The tallies.
+    int64 rows[kNumLevels];
+    int64 spans;
+    int64 page_faults;
+    int64 bytes_logged;
+  };
+
+  ProcessTree();
+  ~ProcessTree();
+
+  // Sets the sink to pass the process events on to, NULL for none.
+  // @pre no events are being issued.
+  void set_process_event_sink(KernelProcessEvents* process_sink) {
+    process_sink_ = process_sink;
+  }
+
+  // Tallies a row of @p process_id at @p time, of @p level and with
+  // @p message. A trace event row of type BEGIN tallies a span too.
+  void AddRow(DWORD process_id,
+              const base::Time& time,
+              UCHAR level,
+              const base::StringPiece& message);
+  // Tallies the rows [@p begin, @p end) of @p store, e.g. those merged in
+  // from an import.
+  void AddStoreRows(const LogStore& store, int begin, int end);
+
+  // Zeroes the tallies, as the log is cleared, and keeps the processes.
+  void ClearTallies();
+
+  // Retrieves the nodes that changed since the last call to @p nodes, in
+  // order of their ids. New nodes may have parents of higher ids, which
+  // are then new too.
+  // @returns true if the tree changed otherwise than by new nodes and new
+  //     tallies since then, e.g. as a node was adopted by a parent found
+  //     later, in which case @p nodes holds all of the nodes.
+  bool TakeChanges(std::vector<Node>* nodes);
+
+  // @returns the number of nodes in the tree.
+  size_t num_nodes();
+
+  // KernelProcessEvents implementation.
+  virtual void OnProcessIsRunning(const base::Time& time,
+                                  const ProcessInfo& process_info);
+  virtual void OnProcessStarted(const base::Time& time,
+                                const ProcessInfo& process_info);
+  virtual void OnProcessEnded(const base::Time& time,
+                              const ProcessInfo& process_info,
+                              ULONG exit_status);
+
+  // KernelPageFaultEvents implementation. The hard page faults tell no
+  // process, and aren't tallied.
+  virtual void OnTransitionFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter);
+  virtual void OnDemandZeroFault(DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 sym_util::Address address,
+                                 sym_util::Address program_counter);
+  virtual void OnCopyOnWriteFault(DWORD process_id,
+                                  DWORD thread_id,
+                                  const base::Time& time,
+                                  sym_util::Address address,
+                                  sym_util::Address program_counter);
+  virtual void OnGuardPageFault(DWORD process_id,
+                                DWORD thread_id,
+                                const base::Time& time,
+                                sym_util::Address address,
+                                sym_util::Address program_counter);
+  virtual void OnHardFault(DWORD process_id,
+                           DWORD thread_id,
+                           const base::Time& time,
+                           sym_util::Address address,
+                           sym_util::Address program_counter);
+  virtual void OnAccessViolationFault(DWORD process_id,
+                                      DWORD thread_id,
+                                      const base::Time& time,
+                                      sym_util::Address address,
+                                      sym_util::Address program_counter);
+  virtual void OnHardPageFault(DWORD thread_id,
+                               const base::Time& time,
+                               const base::Time& initial_time,
+                               sym_util::Offset offset,
+                               sym_util::Address address,
+                               sym_util::Address file_object,
+                               sym_util::ByteCount byte_count);
+
+ private:
+  // The nodes of the instances of a process id, in start order.
+  typedef std::vector<NodeId> InstanceList;
+  typedef std::map<DWORD, InstanceList> InstanceMap;
+  // The roots waiting on their parent, by parent process id.
+  typedef std::multimap<DWORD, NodeId> OrphanMap;
+
+  // Adds the node of the process of @p process_info, started at @p time,
+  // unless it's there already.
+  // @returns the node.
+  // @pre lock_ is held.
+  NodeId AddProcess(const base::Time& time, const ProcessInfo& process_info);
+
+  // Finds the parent of @p node, or else waits on it as an orphan, and
+  // adopts the orphans waiting on @p node.
+  // @pre lock_ is held.
+  void Attach(NodeId node);
+
+  // @returns true iff @p ancestor is @p node or one of its ancestors.
+  // @pre lock_ is held.
+  bool IsAncestor(NodeId ancestor, NodeId node) const;
+
+  // @returns the node of the instance of @p process_id running at @p time,
+  //     or kNoNode. With @p at_end, an instance that ended at @p time is
+  //     found too.
+  // @pre lock_ is held.
+  NodeId FindInstance(DWORD process_id,
+                      const base::Time& time,
+                      bool at_end) const;
+
+  // @returns the node that rows of @p process_id at @p time tally to,
+  //     adding the node of an unknown process id as needed.
+  // @pre lock_ is held.
+  Node* GetTallyNode(DWORD process_id, const base::Time& time);
+
+  // Tallies a row to @p node.
+  // @pre lock_ is held.
+  void TallyRow(Node* node, UCHAR level, const base::StringPiece& message);
+
+  // Tallies a page fault of @p process_id at @p time.
+  void AddPageFault(DWORD process_id, const base::Time& time);
+
+  // Notes that @p node changed, for the next TakeChanges.
+  // @pre lock_ is held.
+  void MarkChanged(NodeId node);
+
+  KernelProcessEvents* process_sink_;
+
+  base::Lock lock_;
+  std::vector<Node> nodes_;  // Under lock_.
+  InstanceMap instances_;  // Under lock_.
+  // The nodes of the process ids the kernel log hasn't told of.
+  std::map<DWORD, NodeId> unknown_nodes_;  // Under lock_.
+  OrphanMap orphans_;  // Under lock_.
+
+  // The node last tallied to, as rows come in runs of a process.
+  NodeId last_tally_node_;  // Under lock_.
+
+  // The nodes changed since the last TakeChanges, and whether each is.
+  std::vector<NodeId> changed_;  // Under lock_.
+  std::vector<bool> is_changed_;  // Under lock_.
+  // The number of nodes handed out by TakeChanges, those of lower ids.
+  size_t nodes_taken_;  // Under lock_.
+  // True once the tree changed shape beyond new nodes.
+  bool reshaped_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(ProcessTree);
+};
+
+#endif  // SAWBUCK_VIEWER_PROCESS_TREE_H_
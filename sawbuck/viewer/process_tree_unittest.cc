@@ -0,0 +1,237 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Process tree unittests.
+#include "sawbuck/viewer/process_tree.h"
+
+#include <evntrace.h>
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/log_store.h"
+
+namespace {
+
+using testing::_;
+
+class MockKernelProcessEvents: public KernelProcessEvents {
+ public:
+  MOCK_METHOD2(OnProcessIsRunning, void (const base::Time& time,
+                                         const ProcessInfo& process_info));
+  MOCK_METHOD2(OnProcessStarted, void (const base::Time& time,
+                                       const ProcessInfo& process_info));
+  MOCK_METHOD3(OnProcessEnded, void (const base::Time& time,
+                                     const ProcessInfo& process_info,
+                                     ULONG exit_status));
+};
+
+base::Time Seconds(int seconds) {
+  return base::Time::FromInternalValue(
+      base::Time::kMicrosecondsPerSecond * (1000 + seconds));
+}
+
+class ProcessTreeTest : public testing::Test {
+ public:
+  // @returns the info of process @p process_id of @p parent_id, with
+  //     @p command_line.
+  static KernelProcessEvents::ProcessInfo MakeProcess(
+      ULONG process_id, ULONG parent_id, const wchar_t* command_line) {
+    KernelProcessEvents::ProcessInfo info;
+    memset(&info.user_sid, 0, sizeof(info.user_sid) + sizeof(info.sub_auths));
+    info.process_id = process_id;
+    info.parent_id = parent_id;
+    info.session_id = 1;
+    info.command_line = command_line;
+    return info;
+  }
+
+ protected:
+  ProcessTree tree_;
+};
+
+}  // namespace
+
+TEST_F(ProcessTreeTest, ArrangesProcessesByParent) {
+  tree_.OnProcessIsRunning(Seconds(0),
+                           MakeProcess(4, 0, L"System"));
+  tree_.OnProcessStarted(Seconds(1),
+                         MakeProcess(10, 4, L"C:\\Windows\\smss.exe"));
+  tree_.OnProcessStarted(Seconds(2),
+                         MakeProcess(20, 10, L"\"C:\\App Dir\\App.exe\" -x"));
+  // A process whose parent is long gone is a root.
+  tree_.OnProcessStarted(Seconds(3), MakeProcess(30, 99, L"orphan.exe"));
+
+  std::vector<ProcessTree::Node> nodes;
+  EXPECT_FALSE(tree_.TakeChanges(&nodes));
+  ASSERT_EQ(4U, nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i)
+    EXPECT_EQ(i, nodes[i].id);
+
+  EXPECT_EQ(4, nodes[0].process_id);
+  EXPECT_EQ(ProcessTree::kNoNode, nodes[0].parent);
+  EXPECT_TRUE(nodes[0].started.is_null());
+  EXPECT_EQ(nodes[0].id, nodes[1].parent);
+  EXPECT_EQ(nodes[1].id, nodes[2].parent);
+  EXPECT_EQ("app.exe", nodes[2].image_name);
+  EXPECT_EQ(Seconds(2), nodes[2].started);
+  EXPECT_EQ(ProcessTree::kNoNode, nodes[3].parent);
+
+  // Nothing changed since.
+  EXPECT_FALSE(tree_.TakeChanges(&nodes));
+  EXPECT_TRUE(nodes.empty());
+}
+
+TEST_F(ProcessTreeTest, TalliesByInstance) {
+  // The process id is reused once the first instance ends.
+  KernelProcessEvents::ProcessInfo first(MakeProcess(10, 4, L"first.exe"));
+  tree_.OnProcessStarted(Seconds(0), first);
+  tree_.OnProcessEnded(Seconds(10), first, 0);
+  tree_.OnProcessStarted(Seconds(20), MakeProcess(10, 4, L"second.exe"));
+
+  tree_.AddRow(10, Seconds(5), TRACE_LEVEL_ERROR, "12345");
+  tree_.AddRow(10, Seconds(6), TRACE_LEVEL_INFORMATION, "123");
+  tree_.AddRow(10, Seconds(21), 0xFF, "1");
+  tree_.AddRow(10, Seconds(22), TRACE_LEVEL_INFORMATION,
+               "BEGIN(Paint, 0x00000001): ");
+  tree_.OnDemandZeroFault(10, 1, Seconds(7), 0x1000, 0x2000);
+  tree_.OnHardFault(10, 1, Seconds(23), 0x1000, 0x2000);
+  tree_.OnHardFault(10, 1, Seconds(24), 0x1000, 0x2000);
+
+  std::vector<ProcessTree::Node> nodes;
+  EXPECT_FALSE(tree_.TakeChanges(&nodes));
+  ASSERT_EQ(2U, nodes.size());
+
+  const ProcessTree::Node& before = nodes[0];
+  EXPECT_EQ(Seconds(10), before.ended);
+  EXPECT_EQ(1, before.rows[TRACE_LEVEL_ERROR]);
+  EXPECT_EQ(1, before.rows[TRACE_LEVEL_INFORMATION]);
+  EXPECT_EQ(8, before.bytes_logged);
+  EXPECT_EQ(0, before.spans);
+  EXPECT_EQ(1, before.page_faults);
+
+  const ProcessTree::Node& after = nodes[1];
+  EXPECT_TRUE(after.ended.is_null());
+  // Levels past verbose count as verbose.
+  EXPECT_EQ(1, after.rows[ProcessTree::kNumLevels - 1]);
+  EXPECT_EQ(1, after.rows[TRACE_LEVEL_INFORMATION]);
+  EXPECT_EQ(1, after.spans);
+  EXPECT_EQ(2, after.page_faults);
+
+  // Only the nodes that changed are taken next.
+  tree_.AddRow(10, Seconds(30), TRACE_LEVEL_WARNING, "");
+  EXPECT_FALSE(tree_.TakeChanges(&nodes));
+  ASSERT_EQ(1U, nodes.size());
+  EXPECT_EQ(after.id, nodes[0].id);
+  EXPECT_EQ(1, nodes[0].rows[TRACE_LEVEL_WARNING]);
+}
+
+TEST_F(ProcessTreeTest, UnknownProcesses) {
+  tree_.AddRow(50, Seconds(1), TRACE_LEVEL_INFORMATION, "a");
+  tree_.AddRow(50, Seconds(2), TRACE_LEVEL_INFORMATION, "b");
+  tree_.AddRow(60, Seconds(2), TRACE_LEVEL_INFORMATION, "c");
+
+  // Rows of the process id go to its instance once it's known.
+  tree_.OnProcessStarted(Seconds(3), MakeProcess(50, 4, L"late.exe"));
+  tree_.AddRow(50, Seconds(4), TRACE_LEVEL_INFORMATION, "d");
+
+  std::vector<ProcessTree::Node> nodes;
+  EXPECT_FALSE(tree_.TakeChanges(&nodes));
+  ASSERT_EQ(3U, nodes.size());
+  EXPECT_FALSE(nodes[0].known);
+  EXPECT_EQ(50, nodes[0].process_id);
+  EXPECT_EQ(2, nodes[0].rows[TRACE_LEVEL_INFORMATION]);
+  EXPECT_FALSE(nodes[1].known);
+  EXPECT_EQ(60, nodes[1].process_id);
+  EXPECT_TRUE(nodes[2].known);
+  EXPECT_EQ(1, nodes[2].rows[TRACE_LEVEL_INFORMATION]);
+}
+
+TEST_F(ProcessTreeTest, AdoptsRunningChildren) {
+  // The processes running as the log began come in any order.
+  tree_.OnProcessIsRunning(Seconds(0), MakeProcess(20, 10, L"child.exe"));
+
+  std::vector<ProcessTree::Node> nodes;
+  EXPECT_FALSE(tree_.TakeChanges(&nodes));
+  ASSERT_EQ(1U, nodes.size());
+  EXPECT_EQ(ProcessTree::kNoNode, nodes[0].parent);
+
+  // The child was handed out as a root, so its adoption reshapes the tree.
+  tree_.OnProcessIsRunning(Seconds(0), MakeProcess(10, 4, L"parent.exe"));
+  EXPECT_TRUE(tree_.TakeChanges(&nodes));
+  ASSERT_EQ(2U, nodes.size());
+  EXPECT_EQ(nodes[1].id, nodes[0].parent);
+
+  // Children adopted before they're handed out are merely new.
+  tree_.OnProcessIsRunning(Seconds(0), MakeProcess(40, 30, L"a.exe"));
+  tree_.OnProcessIsRunning(Seconds(0), MakeProcess(30, 4, L"b.exe"));
+  EXPECT_FALSE(tree_.TakeChanges(&nodes));
+  ASSERT_EQ(2U, nodes.size());
+  EXPECT_EQ(nodes[1].id, nodes[0].parent);
+}
+
+TEST_F(ProcessTreeTest, NoCycles) {
+  // Process ids that name each other as parents don't make a cycle.
+  tree_.OnProcessIsRunning(Seconds(0), MakeProcess(10, 20, L"a.exe"));
+  tree_.OnProcessIsRunning(Seconds(0), MakeProcess(20, 10, L"b.exe"));
+  tree_.OnProcessIsRunning(Seconds(0), MakeProcess(30, 30, L"c.exe"));
+
+  std::vector<ProcessTree::Node> nodes;
+  tree_.TakeChanges(&nodes);
+  ASSERT_EQ(3U, nodes.size());
+  EXPECT_TRUE(nodes[0].parent == ProcessTree::kNoNode ||
+              nodes[1].parent == ProcessTree::kNoNode);
+  EXPECT_EQ(ProcessTree::kNoNode, nodes[2].parent);
+}
+
+TEST_F(ProcessTreeTest, ReplayedEvents) {
+  MockKernelProcessEvents sink;
+  tree_.set_process_event_sink(&sink);
+  EXPECT_CALL(sink, OnProcessIsRunning(_, _)).Times(2);
+  EXPECT_CALL(sink, OnProcessStarted(_, _)).Times(2);
+  EXPECT_CALL(sink, OnProcessEnded(_, _, 1)).Times(2);
+
+  // The events of a log are replayed on each import of it.
+  KernelProcessEvents::ProcessInfo child(MakeProcess(10, 4, L"child.exe"));
+  for (int i = 0; i < 2; ++i) {
+    tree_.OnProcessIsRunning(Seconds(0), MakeProcess(4, 0, L"System"));
+    tree_.OnProcessStarted(Seconds(1), child);
+    tree_.OnProcessEnded(Seconds(2), child, 1);
+  }
+  EXPECT_EQ(2U, tree_.num_nodes());
+}
+
+TEST_F(ProcessTreeTest, StoreRowsAndClearTallies) {
+  tree_.OnProcessStarted(Seconds(0), MakeProcess(10, 4, L"app.exe"));
+
+  StringTable file_table;
+  LogStore store(&file_table);
+  for (int i = 0; i < 10; ++i) {
+    store.AddRow(i < 3 ? TRACE_LEVEL_ERROR : TRACE_LEVEL_VERBOSE, 10, 1,
+                 Seconds(1 + i), StringTable::kEmptyAtom, 0, "row", 0, NULL);
+  }
+  tree_.AddStoreRows(store, 2, store.num_rows());
+
+  std::vector<ProcessTree::Node> nodes;
+  tree_.TakeChanges(&nodes);
+  ASSERT_EQ(1U, nodes.size());
+  EXPECT_EQ(1, nodes[0].rows[TRACE_LEVEL_ERROR]);
+  EXPECT_EQ(7, nodes[0].rows[TRACE_LEVEL_VERBOSE]);
+  EXPECT_EQ(24, nodes[0].bytes_logged);
+
+  // Clearing hands out all the nodes again, with zero tallies.
+  tree_.ClearTallies();
+  EXPECT_TRUE(tree_.TakeChanges(&nodes));
+  ASSERT_EQ(1U, nodes.size());
+  EXPECT_EQ(0, nodes[0].rows[TRACE_LEVEL_VERBOSE]);
+  EXPECT_EQ(0, nodes[0].bytes_logged);
+}
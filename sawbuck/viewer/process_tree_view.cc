@@ -0,0 +1,161 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Process tree view implementation.
+#include "sawbuck/viewer/process_tree_view.h"
+
+#include <evntrace.h>
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+#include "sawbuck/viewer/process_instance_index.h"
+
+namespace {
+
+const UINT_PTR kUpdateTimerId = 1;
+
+}  // namespace
+
+ProcessTreeView::ProcessTreeView() : process_tree_(NULL) {
+}
+
+int ProcessTreeView::OnCreate(LPCREATESTRUCT create_struct) {
+  // Let the default handler create the control.
+  LRESULT ret = DefWindowProc();
+  SetTimer(kUpdateTimerId, kUpdateIntervalMs);
+  Update();
+  return ret;
+}
+
+void ProcessTreeView::OnDestroy() {
+  KillTimer(kUpdateTimerId);
+  SetMsgHandled(FALSE);
+}
+
+void ProcessTreeView::OnTimer(UINT_PTR timer_id) {
+  if (timer_id != kUpdateTimerId) {
+    SetMsgHandled(FALSE);
+    return;
+  }
+
+  Update();
+}
+
+LRESULT ProcessTreeView::OnDblClk(NMHDR* notification) {
+  HTREEITEM item = GetSelectedItem();
+  if (item == NULL || filter_callback_.is_null())
+    return 0;
+
+  size_t id = GetItemData(item);
+  DCHECK_LT(id, nodes_.size());
+  filter_callback_.Run(GetNodeFilter(nodes_[id]));
+  // Rather than expand or collapse the item.
+  return 1;
+}
+
+void ProcessTreeView::Update() {
+  if (process_tree_ == NULL)
+    return;
+
+  bool reshaped = process_tree_->TakeChanges(&changes_);
+  if (!reshaped && changes_.empty())
+    return;
+
+  SetRedraw(FALSE);
+  if (reshaped) {
+    DeleteAllItems();
+    nodes_.clear();
+    items_.clear();
+  }
+
+  // The new nodes may come before their parents, so they all go in before
+  // any is shown.
+  for (size_t i = 0; i < changes_.size(); ++i) {
+    ProcessTree::NodeId id = changes_[i].id;
+    if (id >= nodes_.size()) {
+      nodes_.resize(id + 1);
+      items_.resize(id + 1, NULL);
+    }
+    nodes_[id] = changes_[i];
+  }
+  for (size_t i = 0; i < changes_.size(); ++i) {
+    ProcessTree::NodeId id = changes_[i].id;
+    if (items_[id] != NULL)
+      SetItemText(items_[id], FormatLabel(nodes_[id]).c_str());
+    else
+      EnsureItem(id);
+  }
+
+  SetRedraw(TRUE);
+  Invalidate();
+}
+
+HTREEITEM ProcessTreeView::EnsureItem(ProcessTree::NodeId id) {
+  DCHECK_LT(id, items_.size());
+  if (items_[id] != NULL)
+    return items_[id];
+
+  ProcessTree::NodeId parent = nodes_[id].parent;
+  HTREEITEM parent_item = TVI_ROOT;
+  if (parent != ProcessTree::kNoNode && parent < items_.size())
+    parent_item = EnsureItem(parent);
+
+  items_[id] = InsertItem(TVIF_TEXT | TVIF_PARAM,
+                          FormatLabel(nodes_[id]).c_str(),
+                          0, 0, 0, 0,
+                          id,
+                          parent_item,
+                          TVI_LAST);
+  return items_[id];
+}
+
+// static
+std::wstring ProcessTreeView::FormatLabel(const ProcessTree::Node& node) {
+  std::wstring label;
+  if (node.known) {
+    label = base::StringPrintf(L"%ls (%u)",
+                               base::UTF8ToWide(node.image_name).c_str(),
+                               node.process_id);
+  } else {
+    label = base::StringPrintf(L"Process %u", node.process_id);
+  }
+
+  int64 rows = 0;
+  for (size_t i = 0; i < ProcessTree::kNumLevels; ++i)
+    rows += node.rows[i];
+  int64 errors = node.rows[TRACE_LEVEL_CRITICAL] + node.rows[TRACE_LEVEL_ERROR];
+  base::StringAppendF(&label,
+      L": %lld rows, %lld errors, %lld warnings, %lld spans, %lld faults, "
+          L"%lld KB",
+      rows, errors, node.rows[TRACE_LEVEL_WARNING], node.spans,
+      node.page_faults, node.bytes_logged / 1024);
+  if (!node.ended.is_null())
+    label += L", ended";
+  return label;
+}
+
+// static
+Filter ProcessTreeView::GetNodeFilter(const ProcessTree::Node& node) {
+  if (!node.known) {
+    return Filter(Filter::PROCESS_ID, Filter::IS, Filter::INCLUDE,
+                  base::UintToString16(node.process_id).c_str());
+  }
+
+  std::wstring key(base::UTF8ToWide(
+      ProcessInstanceIndex::FormatInstanceKey(node.process_id,
+                                              node.started)));
+  return Filter(Filter::PROCESS_INSTANCE, Filter::IS, Filter::INCLUDE,
+                key.c_str());
+}
@@ -0,0 +1,103 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Process tree view declaration.
+#ifndef SAWBUCK_VIEWER_PROCESS_TREE_VIEW_H_
+#define SAWBUCK_VIEWER_PROCESS_TREE_VIEW_H_
+
+#include <atlbase.h>
+#include <atlapp.h>
+#include <atlcrack.h>
+#include <atlctrls.h>
+#include <atlmisc.h>
+#include <string>
+#include <vector>
+#include "base/callback.h"
+#include "sawbuck/viewer/filter.h"
+#include "sawbuck/viewer/process_tree.h"
+
+typedef CWinTraits<WS_CHILD | WS_VISIBLE | WS_CLIPSIBLINGS | TVS_HASBUTTONS |
+    TVS_HASLINES | TVS_LINESATROOT | TVS_SHOWSELALWAYS,
+    WS_EX_CLIENTEDGE> ProcessTreeViewTraits;
+
+// Shows the processes of the process tree by parent, each with its
+// tallies, and follows the tree as it grows. The view takes the nodes that
+// changed from the tree on a timer, so an update costs the processes that
+// were active in the meantime. Double clicking a process asks for a filter
+// on its instance, or on its process id for processes the kernel log
+// hasn't told of.
+class ProcessTreeView
+    : public CWindowImpl<ProcessTreeView, CTreeViewCtrl,
+                         ProcessTreeViewTraits> {
+ public:
+  typedef CWindowImpl<ProcessTreeView, CTreeViewCtrl, ProcessTreeViewTraits>
+      WindowBase;
+  DECLARE_WND_SUPERCLASS(NULL, WindowBase::GetWndClassName())
+
+  BEGIN_MSG_MAP_EX(ProcessTreeView)
+    MSG_WM_CREATE(OnCreate)
+    MSG_WM_DESTROY(OnDestroy)
+    MSG_WM_TIMER(OnTimer)
+    REFLECTED_NOTIFY_CODE_HANDLER_EX(NM_DBLCLK, OnDblClk)
+    DEFAULT_REFLECTION_HANDLER()
+  END_MSG_MAP()
+
+  // Issued with the filter on the process double clicked.
+  typedef base::Callback<void(const Filter&)> FilterCallback;
+
+  ProcessTreeView();
+
+  // Sets the tree we show, which must outlive us.
+  void set_process_tree(ProcessTree* process_tree) {
+    process_tree_ = process_tree;
+  }
+  void set_filter_callback(const FilterCallback& filter_callback) {
+    filter_callback_ = filter_callback;
+  }
+
+  // The interval of our updates.
+  static const UINT kUpdateIntervalMs = 500;
+
+ private:
+  int OnCreate(LPCREATESTRUCT create_struct);
+  void OnDestroy();
+  void OnTimer(UINT_PTR timer_id);
+  LRESULT OnDblClk(NMHDR* notification);
+
+  // Takes the changes of the tree, and shows them.
+  void Update();
+  // @returns the item of node @p id, which is inserted under the item of
+  //     its parent if it's not shown yet.
+  HTREEITEM EnsureItem(ProcessTree::NodeId id);
+
+  // @returns the label of @p node, its image and process id and tallies.
+  static std::wstring FormatLabel(const ProcessTree::Node& node);
+  // @returns the filter on the rows of @p node.
+  static Filter GetNodeFilter(const ProcessTree::Node& node);
+
+  ProcessTree* process_tree_;
+  FilterCallback filter_callback_;
+
+  // The nodes as of their last change, and their items, NULL for those
+  // not shown yet, by id.
+  std::vector<ProcessTree::Node> nodes_;
+  std::vector<HTREEITEM> items_;
+
+  // Scratch storage for the changes.
+  std::vector<ProcessTree::Node> changes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProcessTreeView);
+};
+
+#endif  // SAWBUCK_VIEWER_PROCESS_TREE_VIEW_H_
@@ -17,7 +17,62 @@
 
 #include <atlbase.h>
 #include "base/logging.h"
+#include "sawbuck/common/buffer_parser.h"
 #include "sawbuck/viewer/const_config.h"
+#include "sawbuck/viewer/preferences.h"
+
+namespace {
+
+const uint32 kProviderCacheMagic = 0x56505342;  // 'BSPV'.
+const uint32 kProviderCacheVersion = 1;
+
+struct ProviderCacheHeader {
+  uint32 magic;
+  uint32 version;
+  FILETIME last_write_time;
+  uint32 num_providers;
+};
+
+struct ProviderCacheEntry {
+  GUID provider_guid;
+  uint32 log_level;
+  uint32 enable_flags;
+  uint32 num_flag_names;
+};
+
+template <class T>
+void Append(const T& value, std::string* blob) {
+  blob->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Appends @p str with its terminator, padded to keep the blob aligned.
+void AppendString(const std::wstring& str, std::string* blob) {
+  blob->append(reinterpret_cast<const char*>(str.c_str()),
+               (str.size() + 1) * sizeof(wchar_t));
+  blob->resize((blob->size() + sizeof(uint32) - 1) & ~(sizeof(uint32) - 1));
+}
+
+template <class T>
+bool Read(BinaryBufferReader* reader, T* value) {
+  const T* data = NULL;
+  if (!reader->Read(&data))
+    return false;
+
+  *value = *data;
+  return true;
+}
+
+bool ReadString(BinaryBufferReader* reader, std::wstring* str) {
+  const wchar_t* data = NULL;
+  size_t len = 0;
+  if (!reader->ReadString(&data, &len) || !reader->Align(sizeof(uint32)))
+    return false;
+
+  str->assign(data, len);
+  return true;
+}
+
+}  // namespace
 
 ProviderConfiguration::ProviderConfiguration() {
 }
@@ -84,6 +139,7 @@ bool ProviderConfiguration::ReadProviders() {
     settings.provider_name = tmp_string;
     settings.log_level = static_cast<base::win::EtwEventLevel>(default_level);
     settings.enable_flags = default_flags;
+    settings.muted = false;
 
     // Read the flags names and value.
     CRegKey flags;
@@ -118,6 +174,142 @@ bool ProviderConfiguration::ReadProviders() {
   return true;
 }
 
+bool ProviderConfiguration::ReadProvidersCached() {
+  FILETIME last_write_time = {};
+  if (!GetProvidersLastWriteTime(&last_write_time))
+    return ReadProviders();
+
+  std::string blob;
+  {
+    Preferences pref;
+    if (pref.ReadBinaryValue(config::kProviderCacheValue, &blob) &&
+        DeserializeProviders(last_write_time, blob)) {
+      return true;
+    }
+  }
+
+  if (!ReadProviders())
+    return false;
+
+  SerializeProviders(last_write_time, &blob);
+  Preferences pref;
+  if (!pref.WriteBinaryValue(config::kProviderCacheValue, blob))
+    LOG(ERROR) << "Failed to write the provider cache";
+
+  return true;
+}
+
+void ProviderConfiguration::SerializeProviders(
+    const FILETIME& last_write_time, std::string* blob) const {
+  DCHECK(blob != NULL);
+
+  blob->clear();
+  ProviderCacheHeader header = {};
+  header.magic = kProviderCacheMagic;
+  header.version = kProviderCacheVersion;
+  header.last_write_time = last_write_time;
+  header.num_providers = static_cast<uint32>(settings_.size());
+  Append(header, blob);
+
+  for (size_t i = 0; i < settings_.size(); ++i) {
+    const Settings& settings = settings_[i];
+    ProviderCacheEntry entry = {};
+    entry.provider_guid = settings.provider_guid;
+    entry.log_level = settings.log_level;
+    entry.enable_flags = settings.enable_flags;
+    entry.num_flag_names = static_cast<uint32>(settings.flag_names.size());
+    Append(entry, blob);
+    AppendString(settings.provider_name, blob);
+
+    for (size_t j = 0; j < settings.flag_names.size(); ++j) {
+      Append(static_cast<uint32>(settings.flag_names[j].second), blob);
+      AppendString(settings.flag_names[j].first, blob);
+    }
+  }
+}
+
+bool ProviderConfiguration::DeserializeProviders(
+    const FILETIME& last_write_time, const std::string& blob) {
+  BinaryBufferReader reader(blob.data(), blob.size());
+
+  ProviderCacheHeader header = {};
+  if (!Read(&reader, &header) ||
+      header.magic != kProviderCacheMagic ||
+      header.version != kProviderCacheVersion ||
+      ::CompareFileTime(&header.last_write_time, &last_write_time) != 0) {
+    return false;
+  }
+
+  std::vector<Settings> settings_read;
+  for (uint32 i = 0; i < header.num_providers; ++i) {
+    ProviderCacheEntry entry = {};
+    settings_read.push_back(Settings());
+    Settings& settings = settings_read.back();
+    if (!Read(&reader, &entry) ||
+        !ReadString(&reader, &settings.provider_name)) {
+      return false;
+    }
+
+    settings.provider_guid = entry.provider_guid;
+    settings.log_level = static_cast<base::win::EtwEventLevel>(
+        entry.log_level);
+    settings.enable_flags = entry.enable_flags;
+    settings.muted = false;
+
+    for (uint32 j = 0; j < entry.num_flag_names; ++j) {
+      uint32 mask = 0;
+      std::wstring name;
+      if (!Read(&reader, &mask) || !ReadString(&reader, &name))
+        return false;
+
+      settings.flag_names.push_back(std::make_pair(name, mask));
+    }
+  }
+
+  if (reader.RemainingBytes() != 0)
+    return false;
+
+  settings_.swap(settings_read);
+  return true;
+}
+
+bool ProviderConfiguration::GetProvidersLastWriteTime(
+    FILETIME* last_write_time) {
+  DCHECK(last_write_time != NULL);
+
+  CRegKey providers;
+  LONG err = providers.Open(HKEY_LOCAL_MACHINE,
+                            config::kProviderNamesKey,
+                            KEY_READ);
+  if (err != ERROR_SUCCESS)
+    return false;
+
+  FILETIME latest = {};
+  err = ::RegQueryInfoKey(providers, NULL, NULL, NULL, NULL, NULL, NULL,
+                          NULL, NULL, NULL, NULL, &latest);
+  if (err != ERROR_SUCCESS)
+    return false;
+
+  // The provider keys come with their last write times as they're
+  // enumerated, which saves opening them.
+  for (DWORD index = 0; true; ++index) {
+    wchar_t name[256];
+    DWORD name_len = arraysize(name);
+    FILETIME written = {};
+    err = providers.EnumKey(index, name, &name_len, &written);
+    if (err == ERROR_NO_MORE_ITEMS)
+      break;
+    if (err != ERROR_SUCCESS)
+      return false;
+
+    if (::CompareFileTime(&written, &latest) > 0)
+      latest = written;
+  }
+
+  *last_write_time = latest;
+  return true;
+}
+
 bool ProviderConfiguration::ReadSettings() {
   CRegKey levels_key;
   LONG err = levels_key.Create(HKEY_CURRENT_USER,
@@ -162,11 +354,36 @@ bool ProviderConfiguration::ReadSettings() {
                                        enable_flags);
     if (err == ERROR_SUCCESS)
       settings_[i].enable_flags = enable_flags;
+
+    DWORD muted = 0;
+    err = settings_key.QueryDWORDValue(config::kProviderMutedValue, muted);
+    if (err == ERROR_SUCCESS)
+      settings_[i].muted = muted != 0;
   }
 
   return true;
 }
 
+void ProviderConfiguration::GetChangedProviders(
+    const ProviderConfiguration& other,
+    std::vector<size_t>* changed) const {
+  DCHECK(changed != NULL);
+  DCHECK_EQ(settings_.size(), other.settings_.size());
+  changed->clear();
+
+  for (size_t i = 0; i < settings_.size() && i < other.settings_.size();
+       ++i) {
+    const Settings& ours = settings_[i];
+    const Settings& theirs = other.settings_[i];
+    DCHECK(ours.provider_guid == theirs.provider_guid);
+    if (ours.log_level != theirs.log_level ||
+        ours.enable_flags != theirs.enable_flags ||
+        ours.muted != theirs.muted) {
+      changed->push_back(i);
+    }
+  }
+}
+
 bool ProviderConfiguration::WriteSettings() {
   CRegKey levels_key;
   LONG err = levels_key.Create(HKEY_CURRENT_USER,
@@ -196,6 +413,10 @@ bool ProviderConfiguration::WriteSettings() {
       err = settings_key.SetDWORDValue(config::kProviderEnableFlagsValue,
                                        settings_[i].enable_flags);
     }
+    if (err == ERROR_SUCCESS) {
+      err = settings_key.SetDWORDValue(config::kProviderMutedValue,
+                                       settings_[i].muted ? 1 : 0);
+    }
 
     if (err != ERROR_SUCCESS) {
       LOG(ERROR) << "Error writing log level for provider " <<
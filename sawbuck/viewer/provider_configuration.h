@@ -16,6 +16,7 @@
 #ifndef SAWBUCK_VIEWER_PROVIDER_CONFIGURATION_H_
 #define SAWBUCK_VIEWER_PROVIDER_CONFIGURATION_H_
 
+#include <string>
 #include <vector>
 #include "base/win/event_trace_provider.h"
 
@@ -29,10 +30,37 @@ class ProviderConfiguration {
   // Reads the provider information from root_key.
   bool ReadProviders();
 
+  // Reads the provider information as ReadProviders does, from the cache
+  // under HKCU when no provider registration changed since it was written,
+  // which saves walking the registrations. On a miss, this reads the
+  // providers and writes the cache anew.
+  // @note the cache is keyed on the last write times of the provider names
+  //     key and of the provider keys, which installers rewrite as they
+  //     register a provider; edits deeper in the flags go unnoticed.
+  bool ReadProvidersCached();
+
+  // Serializes the providers, with their current settings, to @p blob,
+  // which notes @p last_write_time as the time the providers were last
+  // changed. Muting isn't serialized.
+  void SerializeProviders(const FILETIME& last_write_time,
+                          std::string* blob) const;
+  // Reads the providers back from @p blob, as serialized by
+  // SerializeProviders, if it was serialized at @p last_write_time.
+  // @returns true on success, false if @p blob is malformed or stale.
+  bool DeserializeProviders(const FILETIME& last_write_time,
+                            const std::string& blob);
+
   // Read and write provider settings from/to root_key.
   bool ReadSettings();
   bool WriteSettings();
 
+  // Gets the providers whose settings differ from those in @p other,
+  // which must hold the same providers in the same order, as it does
+  // when it's a copy of this that was edited.
+  // @param changed returns the indices of the changed providers.
+  void GetChangedProviders(const ProviderConfiguration& other,
+                           std::vector<size_t>* changed) const;
+
   typedef std::vector<std::pair<std::wstring, base::win::EtwEventFlags>>
       FlagNameList;
 
@@ -46,6 +74,9 @@ class ProviderConfiguration {
     base::win::EtwEventLevel log_level;
     // The current enable flags.
     base::win::EtwEventFlags enable_flags;
+    // True iff the provider is left disabled in our sessions, which keeps
+    // its level and flags for when it's unmuted.
+    bool muted;
     // A list of (name, mask) pairs, where mask may have
     // one or more bit set, and the associated name.
     FlagNameList flag_names;
@@ -55,6 +86,10 @@ class ProviderConfiguration {
   const std::vector<Settings>& settings() const { return settings_; }
 
  private:
+  // Gets the latest of the last write times of the provider names key and
+  // of its provider keys to @p last_write_time.
+  static bool GetProvidersLastWriteTime(FILETIME* last_write_time);
+
   std::vector<Settings> settings_;
 
   DISALLOW_COPY_AND_ASSIGN(ProviderConfiguration);
@@ -20,6 +20,7 @@
 #include "gtest/gtest.h"
 #include "sawbuck/viewer/registry_test.h"
 #include "sawbuck/viewer/const_config.h"
+#include "sawbuck/viewer/preferences.h"
 
 namespace {
 
@@ -106,6 +107,7 @@ L"          }\r\n"
 L"          '{7FE69228-633E-4f06-80C1-527FEA23E3A7}' {\r\n"
 L"            val enable_flags = d '&H00000001'\r\n"
 L"            val log_level = d '2'\r\n"
+L"            val muted = d '1'\r\n"
 L"          }\r\n"
 L"        }\r\n"
 L"      }\r\n"
@@ -126,10 +128,116 @@ TEST_F(ProviderConfigurationTest, ReadSettings) {
 
   EXPECT_EQ(3, set->log_level);
   EXPECT_EQ(0xcafebabe, set->enable_flags);
+  EXPECT_FALSE(set->muted);
 
   set = &settings.settings()[1];
   EXPECT_EQ(2, set->log_level);
   EXPECT_EQ(0x1, set->enable_flags);
+  EXPECT_TRUE(set->muted);
+}
+
+TEST_F(ProviderConfigurationTest, GetChangedProviders) {
+  ASSERT_TRUE(Register(kProviderRegistrations));
+
+  ProviderConfiguration defaults;
+  ASSERT_TRUE(defaults.ReadProviders());
+
+  // A copy has nothing changed.
+  ProviderConfiguration copy;
+  copy.Copy(defaults);
+  std::vector<size_t> changed;
+  defaults.GetChangedProviders(copy, &changed);
+  EXPECT_TRUE(changed.empty());
+
+  // Both providers have their levels changed by the configuration.
+  ASSERT_TRUE(Register(kProviderConfiguration));
+  ProviderConfiguration settings;
+  ASSERT_TRUE(settings.ReadProviders());
+  ASSERT_TRUE(settings.ReadSettings());
+  defaults.GetChangedProviders(settings, &changed);
+  ASSERT_EQ(2, changed.size());
+  EXPECT_EQ(0, changed[0]);
+  EXPECT_EQ(1, changed[1]);
+}
+
+void ExpectSameProviders(const ProviderConfiguration& expected,
+                         const ProviderConfiguration& actual) {
+  ASSERT_EQ(expected.settings().size(), actual.settings().size());
+  for (size_t i = 0; i < expected.settings().size(); ++i) {
+    const ProviderConfiguration::Settings& ours = expected.settings()[i];
+    const ProviderConfiguration::Settings& theirs = actual.settings()[i];
+    EXPECT_TRUE(ours.provider_guid == theirs.provider_guid);
+    EXPECT_EQ(ours.provider_name, theirs.provider_name);
+    EXPECT_EQ(ours.log_level, theirs.log_level);
+    EXPECT_EQ(ours.enable_flags, theirs.enable_flags);
+    EXPECT_EQ(ours.flag_names, theirs.flag_names);
+  }
+}
+
+TEST_F(ProviderConfigurationTest, SerializeProviders) {
+  ASSERT_TRUE(Register(kProviderRegistrations));
+
+  ProviderConfiguration settings;
+  ASSERT_TRUE(settings.ReadProviders());
+
+  FILETIME written = { 0x1234, 0x5678 };
+  std::string blob;
+  settings.SerializeProviders(written, &blob);
+
+  ProviderConfiguration copy;
+  ASSERT_TRUE(copy.DeserializeProviders(written, blob));
+  ExpectSameProviders(settings, copy);
+
+  // A blob written at another time is stale.
+  FILETIME later = { 0x1235, 0x5678 };
+  EXPECT_FALSE(copy.DeserializeProviders(later, blob));
+
+  // Truncated blobs are rejected, and leave the providers be.
+  EXPECT_FALSE(copy.DeserializeProviders(written,
+                                         blob.substr(0, blob.size() - 4)));
+  EXPECT_FALSE(copy.DeserializeProviders(written, std::string()));
+  ExpectSameProviders(settings, copy);
+}
+
+TEST_F(ProviderConfigurationTest, ReadProvidersCached) {
+  ASSERT_TRUE(Register(kProviderRegistrations));
+
+  ProviderConfiguration settings;
+  ASSERT_TRUE(settings.ReadProviders());
+
+  // The first read misses, and writes the cache.
+  ProviderConfiguration cached;
+  ASSERT_TRUE(cached.ReadProvidersCached());
+  ExpectSameProviders(settings, cached);
+
+  std::string blob;
+  {
+    Preferences pref;
+    ASSERT_TRUE(pref.ReadBinaryValue(config::kProviderCacheValue, &blob));
+  }
+  EXPECT_FALSE(blob.empty());
+
+  // The next read is served from the cache.
+  ProviderConfiguration again;
+  ASSERT_TRUE(again.ReadProvidersCached());
+  ExpectSameProviders(settings, again);
+
+  // A malformed cache is read through, and rewritten.
+  {
+    Preferences pref;
+    ASSERT_TRUE(pref.WriteBinaryValue(config::kProviderCacheValue, "junk"));
+  }
+  ProviderConfiguration reread;
+  ASSERT_TRUE(reread.ReadProvidersCached());
+  ExpectSameProviders(settings, reread);
+
+  std::string rewritten;
+  {
+    Preferences pref;
+    ASSERT_TRUE(pref.ReadBinaryValue(config::kProviderCacheValue,
+                                     &rewritten));
+  }
+  EXPECT_EQ(blob, rewritten);
 }
 
 TEST_F(ProviderConfigurationTest, WriteSettings) {
@@ -165,6 +273,9 @@ TEST_F(ProviderConfigurationTest, WriteSettings) {
 
   ASSERT_EQ(ERROR_SUCCESS, provider.QueryDWORDValue(L"enable_flags", temp));
   EXPECT_EQ(0xFFFFFFFF, temp);
+
+  ASSERT_EQ(ERROR_SUCCESS, provider.QueryDWORDValue(L"muted", temp));
+  EXPECT_EQ(0, temp);
 }
 
 }  // namespace
@@ -63,8 +63,10 @@ BOOL ProviderDialog::OnInitDialog(CWindow focus, LPARAM init_param) {
 
   providers_.Attach(GetDlgItem(IDC_PROVIDERS));
 
+  // A provider's checkbox is cleared while it's muted.
   const DWORD kStyles =
-      LVS_EX_ONECLICKACTIVATE | LVS_EX_DOUBLEBUFFER | LVS_EX_FULLROWSELECT;
+      LVS_EX_ONECLICKACTIVATE | LVS_EX_DOUBLEBUFFER | LVS_EX_FULLROWSELECT |
+      LVS_EX_CHECKBOXES;
   providers_.SetExtendedListViewStyle(kStyles, kStyles);
   providers_.AddColumn(L"Provider", COL_NAME);
   providers_.AddColumn(L"Log Level", COL_LEVEL);
@@ -82,6 +84,7 @@ BOOL ProviderDialog::OnInitDialog(CWindow focus, LPARAM init_param) {
     providers_.SetItemText(i, COL_ENABLE_BITS,
         StringPrintf(L"0x%08X", settings->enable_flags).c_str());
     providers_.SetItemData(i, reinterpret_cast<DWORD_PTR>(settings));
+    providers_.SetCheckState(i, !settings->muted);
   }
 
   providers_.SortItems(SortByFirstColumn,
@@ -94,6 +97,15 @@ LRESULT ProviderDialog::OnOkCancel(WORD code,
                                    WORD id,
                                    HWND window,
                                    BOOL& handled) {
+  if (id == IDOK) {
+    for (int i = 0; i < providers_.GetItemCount(); ++i) {
+      ProviderConfiguration::Settings* settings =
+          reinterpret_cast<ProviderConfiguration::Settings*>(
+              providers_.GetItemData(i));
+      settings->muted = !providers_.GetCheckState(i);
+    }
+  }
+
   ::EndDialog(m_hWnd, id);
   return 0;
 }
@@ -0,0 +1,76 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Query dialog implementation.
+#include "sawbuck/viewer/query_dialog.h"
+
+#include "base/logging.h"
+#include "base/strings/string_util.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/win/scoped_bstr.h"
+#include "sawbuck/viewer/log_query.h"
+
+QueryDialog::QueryDialog(const LogStore* store, const std::string& query)
+    : store_(store), query_(query) {
+  DCHECK(store != NULL);
+}
+
+QueryDialog::~QueryDialog() {
+}
+
+LRESULT QueryDialog::OnInitDialog(CWindow focus_window, LPARAM init_param) {
+  CWindow text_wnd(GetDlgItem(IDC_QUERY_TEXT));
+  text_wnd.SetFocus();
+  if (!query_.empty()) {
+    text_wnd.SetWindowText(base::UTF8ToWide(query_).c_str());
+    text_wnd.SendMessage(EM_SETSEL, 0, -1);
+  }
+  return FALSE;
+}
+
+LRESULT QueryDialog::OnRun(UINT notify_code, int id, CWindow window) {
+  CWindow text_wnd(GetDlgItem(IDC_QUERY_TEXT));
+  base::win::ScopedBstr text;
+  text_wnd.GetWindowText(text.Receive());
+  std::string query_text;
+  if (text.Length())
+    base::WideToUTF8(text, text.Length(), &query_text);
+  base::TrimWhitespaceASCII(query_text, base::TRIM_ALL, &query_text);
+  if (query_text.empty()) {
+    text_wnd.SetFocus();
+    return 0;
+  }
+
+  // The query runs here and now, looking at the rows the store holds.
+  LogQuery query;
+  std::string output;
+  if (query.Parse(query_text, &output)) {
+    query_ = query_text;
+    LogQuery::Result result;
+    query.Run(*store_, &result);
+    output = LogQuery::FormatResult(result);
+  }
+
+  // The edit control wants its lines ended the Windows way.
+  ReplaceSubstringsAfterOffset(&output, 0, "\n", "\r\n");
+  GetDlgItem(IDC_QUERY_RESULTS).SetWindowText(
+      base::UTF8ToWide(output).c_str());
+  text_wnd.SetFocus();
+  return 0;
+}
+
+LRESULT QueryDialog::OnCancel(UINT notify_code, int id, CWindow window) {
+  EndDialog(IDCANCEL);
+  return 0;
+}
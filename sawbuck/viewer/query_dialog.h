@@ -0,0 +1,56 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Query dialog declaration.
+#ifndef SAWBUCK_VIEWER_QUERY_DIALOG_H_
+#define SAWBUCK_VIEWER_QUERY_DIALOG_H_
+
+#include <atlbase.h>
+#include <atlcrack.h>
+#include <atlwin.h>
+#include <string>
+#include "resource.h"
+
+// Forward decl.
+class LogStore;
+
+// Runs queries over a log store and shows their results, until closed.
+class QueryDialog : public CDialogImpl<QueryDialog> {
+ public:
+  enum { IDD = IDD_QUERYDIALOG };
+
+  BEGIN_MSG_MAP(QueryDialog)
+    MSG_WM_INITDIALOG(OnInitDialog)
+    COMMAND_ID_HANDLER_EX(IDOK, OnRun)
+    COMMAND_ID_HANDLER_EX(IDCANCEL, OnCancel)
+  END_MSG_MAP()
+
+  // @param store the store to query, which must outlive the dialog.
+  // @param query the query the dialog starts out with, UTF8 encoded.
+  QueryDialog(const LogStore* store, const std::string& query);
+  ~QueryDialog();
+
+  LRESULT OnInitDialog(CWindow focus_window, LPARAM init_param);
+  LRESULT OnRun(UINT notify_code, int id, CWindow window);
+  LRESULT OnCancel(UINT notify_code, int id, CWindow window);
+
+  // The query last run, UTF8 encoded.
+  const std::string& query() const { return query_; }
+
+ protected:
+  const LogStore* store_;
+  std::string query_;
+};
+
+#endif  // SAWBUCK_VIEWER_QUERY_DIALOG_H_
@@ -0,0 +1,58 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Remote Agent dialog implementation.
+#include "sawbuck/viewer/remote_agent_dialog.h"
+
+#include "base/strings/string_util.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/win/scoped_bstr.h"
+
+RemoteAgentDialog::RemoteAgentDialog(const std::string& address)
+    : address_(address) {
+}
+
+RemoteAgentDialog::~RemoteAgentDialog() {
+}
+
+LRESULT RemoteAgentDialog::OnInitDialog(CWindow focus_window,
+                                        LPARAM init_param) {
+  CWindow text_wnd(GetDlgItem(IDC_REMOTE_AGENT));
+  text_wnd.SetFocus();
+  if (!address_.empty()) {
+    text_wnd.SetWindowText(base::UTF8ToWide(address_).c_str());
+    text_wnd.SendMessage(EM_SETSEL, 0, -1);
+  }
+  return FALSE;
+}
+
+LRESULT RemoteAgentDialog::OnOk(UINT notify_code, int id, CWindow window) {
+  CWindow text_wnd(GetDlgItem(IDC_REMOTE_AGENT));
+  base::win::ScopedBstr text;
+  text_wnd.GetWindowText(text.Receive());
+  if (text.Length()) {
+    base::WideToUTF8(text, text.Length(), &address_);
+    base::TrimWhitespaceASCII(address_, base::TRIM_ALL, &address_);
+    EndDialog(IDOK);
+  } else {
+    text_wnd.SetFocus();
+  }
+  return 0;
+}
+
+LRESULT RemoteAgentDialog::OnCancel(UINT notify_code, int id,
+                                    CWindow window) {
+  EndDialog(IDCANCEL);
+  return 0;
+}
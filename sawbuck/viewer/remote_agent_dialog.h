@@ -0,0 +1,51 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Remote Agent dialog declaration.
+#ifndef SAWBUCK_VIEWER_REMOTE_AGENT_DIALOG_H_
+#define SAWBUCK_VIEWER_REMOTE_AGENT_DIALOG_H_
+
+#include <atlbase.h>
+#include <atlcrack.h>
+#include <atlwin.h>
+#include <string>
+#include "resource.h"
+
+// Asks for the address of a capture agent to capture from, as host[:port].
+class RemoteAgentDialog : public CDialogImpl<RemoteAgentDialog> {
+ public:
+  enum { IDD = IDD_REMOTEAGENTDIALOG };
+
+  BEGIN_MSG_MAP(RemoteAgentDialog)
+    MSG_WM_INITDIALOG(OnInitDialog)
+    COMMAND_ID_HANDLER_EX(IDOK, OnOk)
+    COMMAND_ID_HANDLER_EX(IDCANCEL, OnCancel)
+  END_MSG_MAP()
+
+  // @param address the address the dialog starts out with.
+  explicit RemoteAgentDialog(const std::string& address);
+  ~RemoteAgentDialog();
+
+  LRESULT OnInitDialog(CWindow focus_window, LPARAM init_param);
+  LRESULT OnOk(UINT notify_code, int id, CWindow window);
+  LRESULT OnCancel(UINT notify_code, int id, CWindow window);
+
+  // The address entered.
+  const std::string& address() const { return address_; }
+
+ protected:
+  std::string address_;
+};
+
+#endif  // SAWBUCK_VIEWER_REMOTE_AGENT_DIALOG_H_
@@ -0,0 +1,218 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Remote capture implementation.
+#include "sawbuck/viewer/remote_capture.h"
+
+#include <ws2tcpip.h>
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+
+namespace {
+
+// The most we read off the socket at a time.
+const int kReceiveBufferSize = 64 * 1024;
+
+}  // namespace
+
+const int RemoteCapture::kCheckDoneIntervalMs;
+
+RemoteCapture::RemoteCapture(StringTable* file_table,
+                             LogEvents* event_sink,
+                             TraceEvents* trace_sink,
+                             KernelProcessEvents* process_sink,
+                             KernelModuleEvents* module_sink,
+                             Delegate* delegate)
+    : file_table_(file_table),
+      event_sink_(event_sink),
+      trace_sink_(trace_sink),
+      process_sink_(process_sink),
+      module_sink_(module_sink),
+      delegate_(delegate),
+      origin_loop_(NULL),
+      socket_(INVALID_SOCKET),
+      stopped_(0),
+      done_(0),
+      result_(S_OK),
+      receive_thread_("Remote capture"),
+      check_done_task_(base::Bind(&RemoteCapture::CheckDone,
+                                  base::Unretained(this))) {
+  DCHECK(file_table != NULL);
+  DCHECK(delegate != NULL);
+}
+
+RemoteCapture::~RemoteCapture() {
+  Stop();
+  check_done_task_.Cancel();
+  receive_thread_.Stop();
+}
+
+void RemoteCapture::Start(const std::string& host, int port) {
+  DCHECK(origin_loop_ == NULL);
+  origin_loop_ = base::MessageLoop::current();
+  DCHECK(origin_loop_ != NULL);
+
+  CHECK(receive_thread_.Start());
+  receive_thread_.message_loop()->PostTask(FROM_HERE,
+      base::Bind(&RemoteCapture::Receive, base::Unretained(this), host, port));
+
+  origin_loop_->PostDelayedTask(FROM_HERE,
+      check_done_task_.callback(),
+      base::TimeDelta::FromMilliseconds(kCheckDoneIntervalMs));
+}
+
+void RemoteCapture::Stop() {
+  base::subtle::Release_Store(&stopped_, 1);
+  CloseSocket();
+}
+
+bool RemoteCapture::ParseAddress(const std::string& str,
+                                 std::string* host,
+                                 int* port) {
+  DCHECK(host != NULL);
+  DCHECK(port != NULL);
+
+  size_t colon = str.rfind(':');
+  *host = str.substr(0, colon);
+  *port = kLogStreamDefaultPort;
+  if (colon != std::string::npos &&
+      (!base::StringToInt(str.substr(colon + 1), port) ||
+       *port <= 0 || *port > 0xFFFF)) {
+    return false;
+  }
+
+  return !host->empty();
+}
+
+void RemoteCapture::Receive(const std::string& host, int port) {
+  HRESULT hr = Connect(host, port);
+
+  LogStreamReader reader;
+  reader.set_event_sink(event_sink_);
+  reader.set_trace_sink(trace_sink_);
+  reader.set_process_event_sink(process_sink_);
+  reader.set_module_event_sink(module_sink_);
+  reader.set_string_table(file_table_);
+
+  // The socket is read from outside the lock, as Stop closes it to
+  // unblock us.
+  SOCKET socket = INVALID_SOCKET;
+  {
+    base::AutoLock lock(lock_);
+    socket = socket_;
+  }
+
+  std::vector<char> buffer(kReceiveBufferSize);
+  while (SUCCEEDED(hr) && !base::subtle::Acquire_Load(&stopped_)) {
+    int received = ::recv(socket, &buffer[0], buffer.size(), 0);
+    if (received == 0)
+      break;
+
+    if (received == SOCKET_ERROR) {
+      if (!base::subtle::Acquire_Load(&stopped_))
+        hr = HRESULT_FROM_WIN32(::WSAGetLastError());
+      break;
+    }
+
+    if (!reader.Append(&buffer[0], received))
+      hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  CloseSocket();
+  ::WSACleanup();
+
+  result_ = hr;
+  base::subtle::Release_Store(&done_, 1);
+}
+
+HRESULT RemoteCapture::Connect(const std::string& host, int port) {
+  WSADATA wsa_data = {};
+  int err = ::WSAStartup(MAKEWORD(2, 2), &wsa_data);
+  if (err != 0)
+    return HRESULT_FROM_WIN32(err);
+
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+  addrinfo* addresses = NULL;
+  err = ::getaddrinfo(host.c_str(), base::IntToString(port).c_str(), &hints,
+                      &addresses);
+  if (err != 0) {
+    LOG(ERROR) << "Failed to resolve " << host << ", error " << err;
+    return HRESULT_FROM_WIN32(err);
+  }
+
+  err = WSAECONNREFUSED;
+  for (addrinfo* address = addresses; address != NULL;
+       address = address->ai_next) {
+    SOCKET socket = ::socket(address->ai_family, address->ai_socktype,
+                             address->ai_protocol);
+    if (socket == INVALID_SOCKET) {
+      err = ::WSAGetLastError();
+      continue;
+    }
+
+    // Stop may have come while we resolved the address.
+    {
+      base::AutoLock lock(lock_);
+      if (base::subtle::Acquire_Load(&stopped_)) {
+        ::closesocket(socket);
+        break;
+      }
+      DCHECK_EQ(INVALID_SOCKET, socket_);
+      socket_ = socket;
+    }
+
+    if (::connect(socket, address->ai_addr,
+                  static_cast<int>(address->ai_addrlen)) == 0) {
+      ::freeaddrinfo(addresses);
+      return S_OK;
+    }
+
+    err = ::WSAGetLastError();
+    CloseSocket();
+  }
+  ::freeaddrinfo(addresses);
+
+  if (base::subtle::Acquire_Load(&stopped_))
+    return S_OK;
+
+  LOG(ERROR) << "Failed to connect to " << host << ":" << port
+      << ", error " << err;
+  return HRESULT_FROM_WIN32(err);
+}
+
+void RemoteCapture::CloseSocket() {
+  base::AutoLock lock(lock_);
+  if (socket_ != INVALID_SOCKET) {
+    ::closesocket(socket_);
+    socket_ = INVALID_SOCKET;
+  }
+}
+
+void RemoteCapture::CheckDone() {
+  DCHECK_EQ(origin_loop_, base::MessageLoop::current());
+
+  if (!base::subtle::Acquire_Load(&done_)) {
+    origin_loop_->PostDelayedTask(FROM_HERE,
+        check_done_task_.callback(),
+        base::TimeDelta::FromMilliseconds(kCheckDoneIntervalMs));
+    return;
+  }
+
+  receive_thread_.Stop();
+  delegate_->OnRemoteCaptureDone(result_);
+}
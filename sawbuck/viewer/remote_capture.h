@@ -0,0 +1,119 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Remote capture declaration.
+#ifndef SAWBUCK_VIEWER_REMOTE_CAPTURE_H_
+#define SAWBUCK_VIEWER_REMOTE_CAPTURE_H_
+
+#include <winsock2.h>
+#include <string>
+#include "base/atomicops.h"
+#include "base/cancelable_callback.h"
+#include "base/message_loop/message_loop.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread.h"
+#include "sawbuck/log_lib/log_stream.h"
+
+// Captures from a capture agent on another machine, by reading the log
+// stream it serves. The stream is received and decoded on a thread of its
+// own, which issues the events to the sinks as the local consumers would.
+class RemoteCapture {
+ public:
+  // Implemented by the clients of RemoteCapture, which are called back on
+  // the thread that started the capture.
+  class Delegate {
+   public:
+    // Issued once the stream ends, or the capture was stopped.
+    // @param hr S_OK if the capture was stopped or the agent went away,
+    //     the error that ended it otherwise.
+    virtual void OnRemoteCaptureDone(HRESULT hr) = 0;
+  };
+
+  // @param file_table the table file names are interned to.
+  // @param event_sink receives the log messages.
+  // @param trace_sink receives the trace events.
+  // @param process_sink receives the kernel process events.
+  // @param module_sink receives the kernel module events.
+  // @param delegate receives the completion notification.
+  // @note the sinks are invoked on the receive thread, and all parameters
+  //    must outlive this instance.
+  RemoteCapture(StringTable* file_table,
+                LogEvents* event_sink,
+                TraceEvents* trace_sink,
+                KernelProcessEvents* process_sink,
+                KernelModuleEvents* module_sink,
+                Delegate* delegate);
+
+  // Stops any capture in progress and waits for the thread to wind up.
+  ~RemoteCapture();
+
+  // Connects to the agent at @p host and @p port and starts capturing
+  // in the background. Must be called once, on a thread with a message
+  // loop.
+  void Start(const std::string& host, int port);
+
+  // Stops the capture, the delegate gets its OnRemoteCaptureDone shortly.
+  void Stop();
+
+  // Splits @p str of the form host[:port] into @p host and @p port, which
+  // defaults to kLogStreamDefaultPort.
+  // @returns true iff @p str parses.
+  static bool ParseAddress(const std::string& str,
+                           std::string* host,
+                           int* port);
+
+  // The interval at which the receive thread is checked for completion.
+  static const int kCheckDoneIntervalMs = 200;
+
+ private:
+  // Run on the receive thread.
+  // @{
+  void Receive(const std::string& host, int port);
+  HRESULT Connect(const std::string& host, int port);
+  // @}
+
+  // Closes socket_ if it's open.
+  void CloseSocket();
+
+  // Calls back the delegate once the receive thread is done.
+  void CheckDone();
+
+  StringTable* file_table_;
+  LogEvents* event_sink_;
+  TraceEvents* trace_sink_;
+  KernelProcessEvents* process_sink_;
+  KernelModuleEvents* module_sink_;
+  Delegate* delegate_;
+
+  // The loop we were started on, where the delegate is called back.
+  base::MessageLoop* origin_loop_;
+
+  // Stop closes the socket, which unblocks the receive thread.
+  base::Lock lock_;
+  SOCKET socket_;  // Under lock_.
+
+  // Non-zero once we're stopped, read by the receive thread.
+  base::subtle::Atomic32 stopped_;
+
+  // Non-zero once the receive thread is done, after it stores result_.
+  base::subtle::Atomic32 done_;
+  HRESULT result_;
+
+  base::Thread receive_thread_;
+  base::CancelableClosure check_done_task_;
+
+  DISALLOW_COPY_AND_ASSIGN(RemoteCapture);
+};
+
+#endif  // SAWBUCK_VIEWER_REMOTE_CAPTURE_H_
@@ -0,0 +1,167 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Remote capture unittests.
+#include "sawbuck/viewer/remote_capture.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using testing::_;
+using testing::InvokeWithoutArgs;
+using testing::NiceMock;
+
+class MockLogEvents : public LogEvents {
+ public:
+  MOCK_METHOD1(OnLogMessage, void(const LogMessage& log_message));
+};
+
+class MockDelegate : public RemoteCapture::Delegate {
+ public:
+  MOCK_METHOD1(OnRemoteCaptureDone, void(HRESULT hr));
+};
+
+// Sends the stream to the accepted connection.
+class SocketOutput : public LogStreamWriter::Output {
+ public:
+  explicit SocketOutput(SOCKET socket) : socket_(socket) {
+  }
+
+  virtual bool Write(const char* data, size_t len) {
+    return ::send(socket_, data, static_cast<int>(len), 0) ==
+        static_cast<int>(len);
+  }
+
+ private:
+  SOCKET socket_;
+};
+
+class RemoteCaptureTest : public testing::Test {
+ public:
+  RemoteCaptureTest()
+      : listener_(INVALID_SOCKET),
+        port_(0),
+        capture_(&file_table_, &log_events_, NULL, NULL, NULL, &delegate_) {
+  }
+
+  virtual void SetUp() {
+    WSADATA wsa_data = {};
+    ASSERT_EQ(0, ::WSAStartup(MAKEWORD(2, 2), &wsa_data));
+
+    // Listen on a port of the system's choosing.
+    listener_ = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ASSERT_NE(INVALID_SOCKET, listener_);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, ::bind(listener_, reinterpret_cast<sockaddr*>(&addr),
+                        sizeof(addr)));
+    ASSERT_EQ(0, ::listen(listener_, 1));
+    int len = sizeof(addr);
+    ASSERT_EQ(0, ::getsockname(listener_, reinterpret_cast<sockaddr*>(&addr),
+                               &len));
+    port_ = ::ntohs(addr.sin_port);
+  }
+
+  virtual void TearDown() {
+    if (listener_ != INVALID_SOCKET)
+      ::closesocket(listener_);
+    ::WSACleanup();
+  }
+
+  void QuitMessageLoop() {
+    message_loop_.Quit();
+  }
+
+ protected:
+  base::MessageLoop message_loop_;
+  SOCKET listener_;
+  int port_;
+
+  StringTable file_table_;
+  NiceMock<MockLogEvents> log_events_;
+  NiceMock<MockDelegate> delegate_;
+  RemoteCapture capture_;
+};
+
+}  // namespace
+
+TEST(RemoteCaptureParseTest, ParseAddress) {
+  std::string host;
+  int port = 0;
+  EXPECT_TRUE(RemoteCapture::ParseAddress("capture-box", &host, &port));
+  EXPECT_EQ("capture-box", host);
+  EXPECT_EQ(kLogStreamDefaultPort, port);
+
+  EXPECT_TRUE(RemoteCapture::ParseAddress("10.0.0.1:1234", &host, &port));
+  EXPECT_EQ("10.0.0.1", host);
+  EXPECT_EQ(1234, port);
+
+  EXPECT_FALSE(RemoteCapture::ParseAddress("", &host, &port));
+  EXPECT_FALSE(RemoteCapture::ParseAddress(":1234", &host, &port));
+  EXPECT_FALSE(RemoteCapture::ParseAddress("host:", &host, &port));
+  EXPECT_FALSE(RemoteCapture::ParseAddress("host:port", &host, &port));
+  EXPECT_FALSE(RemoteCapture::ParseAddress("host:65536", &host, &port));
+}
+
+TEST_F(RemoteCaptureTest, ReceivesStream) {
+  capture_.Start("127.0.0.1", port_);
+  SOCKET agent = ::accept(listener_, NULL, NULL);
+  ASSERT_NE(INVALID_SOCKET, agent);
+
+  {
+    SocketOutput output(agent);
+    LogStreamWriter writer(&output);
+    LogEvents::LogMessage log_message;
+    log_message.time = base::Time::Now();
+    log_message.message = "message";
+    log_message.message_len = 7;
+    writer.OnLogMessage(log_message);
+    writer.OnLogMessage(log_message);
+  }
+  ::closesocket(agent);
+
+  // The agent going away ends the capture, and not as a failure.
+  EXPECT_CALL(log_events_, OnLogMessage(_)).Times(2);
+  EXPECT_CALL(delegate_, OnRemoteCaptureDone(S_OK)).WillOnce(
+      InvokeWithoutArgs(this, &RemoteCaptureTest::QuitMessageLoop));
+  message_loop_.Run();
+}
+
+TEST_F(RemoteCaptureTest, FailsOnGarbage) {
+  capture_.Start("127.0.0.1", port_);
+  SOCKET agent = ::accept(listener_, NULL, NULL);
+  ASSERT_NE(INVALID_SOCKET, agent);
+  const char kGarbage[] = "This is no log stream.";
+  ::send(agent, kGarbage, sizeof(kGarbage), 0);
+
+  EXPECT_CALL(delegate_, OnRemoteCaptureDone(testing::Ne(S_OK))).WillOnce(
+      InvokeWithoutArgs(this, &RemoteCaptureTest::QuitMessageLoop));
+  message_loop_.Run();
+  ::closesocket(agent);
+}
+
+TEST_F(RemoteCaptureTest, Stop) {
+  capture_.Start("127.0.0.1", port_);
+  SOCKET agent = ::accept(listener_, NULL, NULL);
+  ASSERT_NE(INVALID_SOCKET, agent);
+
+  EXPECT_CALL(delegate_, OnRemoteCaptureDone(S_OK)).WillOnce(
+      InvokeWithoutArgs(this, &RemoteCaptureTest::QuitMessageLoop));
+  capture_.Stop();
+  message_loop_.Run();
+  ::closesocket(agent);
+}
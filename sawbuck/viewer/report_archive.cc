@@ -0,0 +1,222 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Report archive reader implementation.
+#include "sawbuck/viewer/report_archive.h"
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_util.h"
+#include "base/win/scoped_handle.h"
+#include "third_party/zlib/contrib/minizip/iowin32.h"
+#include "third_party/zlib/contrib/minizip/unzip.h"
+
+namespace {
+
+// The longest entry name we read from the directory.
+const size_t kMaxEntryNameSize = MAX_PATH;
+
+}  // namespace
+
+const size_t ReportArchive::kInflateBufferSize;
+
+ReportArchive::ReportArchive() : archive_(NULL) {
+}
+
+ReportArchive::~ReportArchive() {
+  Close();
+}
+
+bool ReportArchive::Open(const base::FilePath& path) {
+  DCHECK(archive_ == NULL);
+
+  // The wide file functions take the path as it is.
+  zlib_filefunc64_def file_functions = {};
+  fill_win32_filefunc64W(&file_functions);
+  archive_ = unzOpen2_64(path.value().c_str(), &file_functions);
+  if (archive_ == NULL) {
+    LOG(ERROR) << "Failed to open archive \"" << path.value() << "\".";
+    return false;
+  }
+
+  int err = unzGoToFirstFile(archive_);
+  while (err == UNZ_OK) {
+    unz_file_info64 info = {};
+    char name[kMaxEntryNameSize] = {};
+    err = unzGetCurrentFileInfo64(archive_, &info, name, sizeof(name),
+                                  NULL, 0, NULL, 0);
+    if (err != UNZ_OK)
+      break;
+
+    Entry entry;
+    entry.name = name;
+    entry.size = info.uncompressed_size;
+    entry.compressed_size = info.compressed_size;
+    entries_.push_back(entry);
+
+    err = unzGoToNextFile(archive_);
+  }
+
+  if (err != UNZ_END_OF_LIST_OF_FILE) {
+    LOG(ERROR) << "Failed to read the directory of archive \""
+        << path.value() << "\", error " << err;
+    Close();
+    return false;
+  }
+
+  path_ = path;
+  return true;
+}
+
+void ReportArchive::Close() {
+  if (archive_ != NULL) {
+    unzClose(archive_);
+    archive_ = NULL;
+  }
+  path_.clear();
+  entries_.clear();
+}
+
+HRESULT ReportArchive::ExtractEntry(const std::string& name,
+                                    const base::FilePath& dest,
+                                    const base::subtle::Atomic32* cancelled) {
+  DCHECK(archive_ != NULL);
+  if (!OpenEntry(name))
+    return E_FAIL;
+
+  base::win::ScopedHandle file(::CreateFile(dest.value().c_str(),
+                                            GENERIC_WRITE,
+                                            0,
+                                            NULL,
+                                            CREATE_ALWAYS,
+                                            FILE_ATTRIBUTE_TEMPORARY,
+                                            NULL));
+  if (!file.IsValid()) {
+    DWORD err = ::GetLastError();
+    LOG(ERROR) << "Failed to create \"" << dest.value() << "\", error "
+        << err;
+    unzCloseCurrentFile(archive_);
+    return HRESULT_FROM_WIN32(err);
+  }
+
+  HRESULT hr = S_OK;
+  scoped_ptr<char[]> buffer(new char[kInflateBufferSize]);
+  while (true) {
+    if (cancelled != NULL && base::subtle::Acquire_Load(cancelled)) {
+      hr = E_ABORT;
+      break;
+    }
+
+    int read = unzReadCurrentFile(archive_, buffer.get(), kInflateBufferSize);
+    if (read == 0)
+      break;
+    if (read < 0) {
+      LOG(ERROR) << "Failed to inflate \"" << name << "\", error " << read;
+      hr = E_FAIL;
+      break;
+    }
+
+    DWORD written = 0;
+    if (!::WriteFile(file, buffer.get(), read, &written, NULL) ||
+        written != static_cast<DWORD>(read)) {
+      DWORD err = ::GetLastError();
+      LOG(ERROR) << "Failed to write \"" << dest.value() << "\", error "
+          << err;
+      hr = HRESULT_FROM_WIN32(err);
+      break;
+    }
+  }
+
+  // Closing the entry checks its CRC, once it's read through.
+  int err = unzCloseCurrentFile(archive_);
+  if (SUCCEEDED(hr) && err != UNZ_OK) {
+    LOG(ERROR) << "Entry \"" << name << "\" is corrupt, error " << err;
+    hr = E_FAIL;
+  }
+
+  file.Close();
+  if (FAILED(hr))
+    base::DeleteFile(dest, false);
+
+  return hr;
+}
+
+bool ReportArchive::ReadEntry(const std::string& name,
+                              size_t max_size,
+                              std::string* text) {
+  DCHECK(archive_ != NULL);
+  DCHECK(text != NULL);
+  if (!OpenEntry(name))
+    return false;
+
+  // Read one byte past the limit to tell an entry that exceeds it. The
+  // CRC is checked on closing an entry that was read through.
+  text->resize(max_size + 1);
+  int read = unzReadCurrentFile(archive_, &(*text)[0], text->size());
+  int err = unzCloseCurrentFile(archive_);
+  if (read < 0 || static_cast<size_t>(read) > max_size || err != UNZ_OK) {
+    text->clear();
+    return false;
+  }
+
+  text->resize(read);
+  return true;
+}
+
+void ReportArchive::GetLogEntries(std::vector<std::string>* names) const {
+  DCHECK(names != NULL);
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    if (IsLogEntry(entries_[i].name))
+      names->push_back(entries_[i].name);
+  }
+}
+
+void ReportArchive::ReadTextEntries(size_t max_size,
+                                    std::vector<TextEntry>* entries) {
+  DCHECK(entries != NULL);
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    if (!IsTextEntry(entries_[i].name) || entries_[i].size > max_size)
+      continue;
+
+    TextEntry entry;
+    entry.name = entries_[i].name;
+    if (ReadEntry(entry.name, max_size, &entry.text))
+      entries->push_back(entry);
+  }
+}
+
+bool ReportArchive::IsReportArchive(const base::FilePath& path) {
+  return StringToLowerASCII(path.Extension()) == L".zip";
+}
+
+bool ReportArchive::IsLogEntry(const std::string& name) {
+  return EndsWith(name, ".etl", false);
+}
+
+bool ReportArchive::IsTextEntry(const std::string& name) {
+  return EndsWith(name, ".txt", false) || EndsWith(name, ".json", false);
+}
+
+bool ReportArchive::OpenEntry(const std::string& name) {
+  // The names are matched as sawdust writes them, case sensitively.
+  if (unzLocateFile(archive_, name.c_str(), 1) != UNZ_OK ||
+      unzOpenCurrentFile(archive_) != UNZ_OK) {
+    LOG(ERROR) << "Failed to open entry \"" << name << "\" of archive \""
+        << path_.value() << "\".";
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,113 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Report archive reader declaration.
+#ifndef SAWBUCK_VIEWER_REPORT_ARCHIVE_H_
+#define SAWBUCK_VIEWER_REPORT_ARCHIVE_H_
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+
+// Reads the report archives sawdust writes, the zips of the application
+// and kernel logs along with extracts of the registry and of the system
+// information. The log entries are inflated from the archive straight
+// into files of their own, a buffer at a time, so the archive never has
+// to be extracted as a whole, and the text entries are read to memory.
+// @note an instance is not thread safe, but any number of instances may
+//    read the same archive at once.
+class ReportArchive {
+ public:
+  // An entry in the directory of the archive.
+  struct Entry {
+    Entry() : size(0), compressed_size(0) {
+    }
+
+    std::string name;
+    uint64 size;
+    uint64 compressed_size;
+  };
+
+  // A text entry, as read to memory.
+  struct TextEntry {
+    std::string name;
+    std::string text;
+  };
+
+  ReportArchive();
+  ~ReportArchive();
+
+  // Opens the archive at @p path and reads its directory.
+  // @returns true on success, false if the file can't be read or isn't a
+  //     zip archive.
+  bool Open(const base::FilePath& path);
+  void Close();
+
+  // Inflates the entry @p name to a new file at @p dest. The file is
+  // created as a temporary file, which the system keeps in memory as far
+  // as it can afford to, as it's only mapped to be read back.
+  // @param cancelled the extraction stops when this goes non-zero, may be
+  //     NULL.
+  // @returns S_OK on success, E_ABORT if cancelled, an error code
+  //     otherwise. @p dest is deleted unless the extraction succeeds.
+  HRESULT ExtractEntry(const std::string& name,
+                       const base::FilePath& dest,
+                       const base::subtle::Atomic32* cancelled);
+
+  // Reads the entry @p name to @p text.
+  // @returns false if the entry can't be read, or inflates to more than
+  //     @p max_size bytes.
+  bool ReadEntry(const std::string& name, size_t max_size, std::string* text);
+
+  // Retrieves the names of the log entries to @p names, in the order of
+  // the archive.
+  void GetLogEntries(std::vector<std::string>* names) const;
+
+  // Reads the text entries, such as the system information, which inflate
+  // to at most @p max_size bytes each to @p entries, in the order of the
+  // archive.
+  void ReadTextEntries(size_t max_size, std::vector<TextEntry>* entries);
+
+  // Accessors, valid once open.
+  // @{
+  const base::FilePath& path() const { return path_; }
+  const std::vector<Entry>& entries() const { return entries_; }
+  // @}
+
+  // @returns true if @p path names a report archive, by its extension.
+  static bool IsReportArchive(const base::FilePath& path);
+  // @returns true if @p name is that of a log entry, by its extension.
+  static bool IsLogEntry(const std::string& name);
+  // @returns true if @p name is that of a text entry, by its extension.
+  static bool IsTextEntry(const std::string& name);
+
+  // The amount of data inflated at a time.
+  static const size_t kInflateBufferSize = 256 * 1024;
+
+ private:
+  // Positions the archive at the entry @p name and opens it for reading.
+  bool OpenEntry(const std::string& name);
+
+  base::FilePath path_;
+  // The unzFile of the archive, NULL when closed.
+  void* archive_;
+  std::vector<Entry> entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReportArchive);
+};
+
+#endif  // SAWBUCK_VIEWER_REPORT_ARCHIVE_H_
@@ -0,0 +1,148 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Report archive unit tests.
+#include "sawbuck/viewer/report_archive.h"
+
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/path_service.h"
+#include "base/strings/utf_string_conversions.h"
+#include "gtest/gtest.h"
+#include "third_party/zlib/contrib/minizip/zip.h"
+
+namespace {
+
+const char kSystemInfo[] = "Windows 7\nProcessors: 4\n";
+const char kRegistryExtract[] = "HKEY_CURRENT_USER\\Software\\Chromium\n";
+
+class ReportArchiveTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+
+    base::FilePath src_root;
+    ASSERT_TRUE(PathService::Get(base::DIR_SOURCE_ROOT, &src_root));
+    ASSERT_TRUE(base::ReadFileToString(
+        src_root.AppendASCII("sawbuck\\log_lib\\test_data\\"
+                             "image_data_32_v2.etl"),
+        &log_));
+
+    // The archive is laid out as sawdust lays out its reports.
+    archive_path_ = temp_dir_.path().Append(L"report.zip");
+    zipFile zip = zipOpen(base::WideToUTF8(archive_path_.value()).c_str(),
+                          APPEND_STATUS_CREATE);
+    ASSERT_TRUE(zip != NULL);
+    AddEntry(zip, "Kernel.etl", log_);
+    AddEntry(zip, "BasicSystemInformation.txt", kSystemInfo);
+    AddEntry(zip, "RegistryExtract.txt", kRegistryExtract);
+    ASSERT_EQ(ZIP_OK, zipClose(zip, NULL));
+  }
+
+  void AddEntry(zipFile zip, const char* name, const std::string& data) {
+    ASSERT_EQ(ZIP_OK, zipOpenNewFileInZip(zip, name, NULL, NULL, 0, NULL, 0,
+                                          NULL, Z_DEFLATED,
+                                          Z_DEFAULT_COMPRESSION));
+    ASSERT_EQ(ZIP_OK, zipWriteInFileInZip(zip, data.data(), data.size()));
+    ASSERT_EQ(ZIP_OK, zipCloseFileInZip(zip));
+  }
+
+ protected:
+  base::ScopedTempDir temp_dir_;
+  base::FilePath archive_path_;
+  std::string log_;
+  ReportArchive archive_;
+};
+
+}  // namespace
+
+TEST(ReportArchiveNameTest, ClassifiesNames) {
+  EXPECT_TRUE(ReportArchive::IsReportArchive(base::FilePath(L"c:\\a.zip")));
+  EXPECT_TRUE(ReportArchive::IsReportArchive(base::FilePath(L"c:\\a.ZIP")));
+  EXPECT_FALSE(ReportArchive::IsReportArchive(base::FilePath(L"c:\\a.etl")));
+
+  EXPECT_TRUE(ReportArchive::IsLogEntry("Application.etl"));
+  EXPECT_TRUE(ReportArchive::IsLogEntry("Snapshot1.ETL"));
+  EXPECT_FALSE(ReportArchive::IsLogEntry("Application.bin"));
+
+  EXPECT_TRUE(ReportArchive::IsTextEntry("RegistryExtract.txt"));
+  EXPECT_TRUE(ReportArchive::IsTextEntry("Summary.json"));
+  EXPECT_FALSE(ReportArchive::IsTextEntry("Kernel.etl"));
+}
+
+TEST_F(ReportArchiveTest, OpenReadsDirectory) {
+  ASSERT_TRUE(archive_.Open(archive_path_));
+  ASSERT_EQ(3U, archive_.entries().size());
+  EXPECT_EQ("Kernel.etl", archive_.entries()[0].name);
+  EXPECT_EQ(log_.size(), archive_.entries()[0].size);
+  EXPECT_GT(log_.size(), archive_.entries()[0].compressed_size);
+  EXPECT_EQ("BasicSystemInformation.txt", archive_.entries()[1].name);
+  EXPECT_EQ("RegistryExtract.txt", archive_.entries()[2].name);
+
+  std::vector<std::string> logs;
+  archive_.GetLogEntries(&logs);
+  ASSERT_EQ(1U, logs.size());
+  EXPECT_EQ("Kernel.etl", logs[0]);
+}
+
+TEST_F(ReportArchiveTest, OpenFailsOnNonArchive) {
+  base::FilePath path(temp_dir_.path().Append(L"not_an_archive.zip"));
+  ASSERT_EQ(static_cast<int>(log_.size()),
+            base::WriteFile(path, log_.data(), log_.size()));
+  EXPECT_FALSE(archive_.Open(path));
+  EXPECT_FALSE(archive_.Open(temp_dir_.path().Append(L"missing.zip")));
+}
+
+TEST_F(ReportArchiveTest, ExtractEntry) {
+  ASSERT_TRUE(archive_.Open(archive_path_));
+
+  base::FilePath dest(temp_dir_.path().Append(L"Kernel.etl"));
+  ASSERT_EQ(S_OK, archive_.ExtractEntry("Kernel.etl", dest, NULL));
+  std::string extracted;
+  ASSERT_TRUE(base::ReadFileToString(dest, &extracted));
+  EXPECT_TRUE(extracted == log_);
+
+  EXPECT_EQ(E_FAIL, archive_.ExtractEntry("Missing.etl", dest, NULL));
+
+  // A cancelled extraction leaves nothing behind.
+  base::subtle::Atomic32 cancelled = 1;
+  base::FilePath cancelled_dest(temp_dir_.path().Append(L"Cancelled.etl"));
+  EXPECT_EQ(E_ABORT,
+            archive_.ExtractEntry("Kernel.etl", cancelled_dest, &cancelled));
+  EXPECT_FALSE(base::PathExists(cancelled_dest));
+}
+
+TEST_F(ReportArchiveTest, ReadTextEntries) {
+  ASSERT_TRUE(archive_.Open(archive_path_));
+
+  std::string text;
+  EXPECT_TRUE(archive_.ReadEntry("BasicSystemInformation.txt", 1024, &text));
+  EXPECT_EQ(kSystemInfo, text);
+  EXPECT_FALSE(archive_.ReadEntry("BasicSystemInformation.txt", 4, &text));
+  EXPECT_TRUE(text.empty());
+
+  std::vector<ReportArchive::TextEntry> entries;
+  archive_.ReadTextEntries(1024, &entries);
+  ASSERT_EQ(2U, entries.size());
+  EXPECT_EQ("BasicSystemInformation.txt", entries[0].name);
+  EXPECT_EQ(kSystemInfo, entries[0].text);
+  EXPECT_EQ("RegistryExtract.txt", entries[1].name);
+  EXPECT_EQ(kRegistryExtract, entries[1].text);
+
+  // Entries beyond the size are skipped.
+  entries.clear();
+  archive_.ReadTextEntries(sizeof(kSystemInfo) - 1, &entries);
+  ASSERT_EQ(1U, entries.size());
+  EXPECT_EQ("BasicSystemInformation.txt", entries[0].name);
+}
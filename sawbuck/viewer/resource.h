@@ -27,6 +27,11 @@
 #define IDD_SYMBOLPATH                  106
 #define IDD_FINDDIALOG                  107
 #define IDD_FILTERDIALOG2               108
+#define IDD_GOTOTIMEDIALOG              109
+#define IDD_REMOTEAGENTDIALOG           110
+#define IDD_QUERYDIALOG                 111
+#define IDD_IMPORTSCOPEDIALOG           112
+#define IDD_SESSIONSEARCHDIALOG         113
 #define IDC_PROVIDERS                   1002
 #define IDC_EXCLUDE_RE                  1003
 #define IDC_INCLUDE_RE                  1004
@@ -47,6 +52,18 @@
 #define IDC_FILTER_SAVE                 1019
 #define IDC_BUTTON2                     1020
 #define IDC_FILTER_LOAD                 1021
+#define IDC_FIND_ALL                    1022
+#define IDC_GOTO_TIME                   1023
+#define IDC_REMOTE_AGENT                1024
+#define IDC_QUERY_TEXT                  1025
+#define IDC_QUERY_RESULTS               1026
+#define IDC_FILTER_PREVIEW              1027
+#define IDC_FILTER_EXAMPLES             1028
+#define IDC_IMPORT_BEGIN                1029
+#define IDC_IMPORT_DURATION             1030
+#define IDC_IMPORT_PROCESSES            1031
+#define IDC_SESSION_SEARCH_TEXT         1032
+#define IDC_SESSION_SEARCH_RESULTS      1033
 #define ID_FILE_EXIT                    4001
 #define ID_FILE_IMPORT                  4002
 #define ID_LOG_CAPTURE                  4003
@@ -60,14 +77,48 @@
 #define ID_EDIT_AUTOSIZE_COLUMNS        4011
 #define ID_INCLUDE_COLUMN               4012
 #define ID_EXCLUDE_COLUMN               4013
+#define ID_FILE_CANCEL_IMPORT           4014
+#define ID_EDIT_COPY_TO_FILE            4015
+#define ID_DISK_IO_REPORT               4016
+#define ID_LOG_TRACE_DURATIONS          4017
+#define ID_FILE_RELOAD_CAPTURE          4018
+#define ID_HELP_PERF_STATS              4019
+#define ID_LOG_EVENT_RATES              4020
+#define ID_LOG_SUMMARIZE_LOCATION       4021
+#define ID_LOG_SUMMARIZE_PROCESS        4022
+#define ID_LOG_SUMMARIZE_THREAD         4023
+#define ID_LOG_SUMMARIZE_STACK          4024
+#define ID_LOG_SUMMARIZE_MESSAGE        4025
+#define ID_EDIT_GOTO_TIME               4026
+#define ID_LOG_SORT_BY_TIME             4027
+#define ID_FILE_SAVE_SESSION            4028
+#define ID_FILE_OPEN_SESSION            4029
+#define ID_FILE_IMPORT_LAZILY           4030
+#define ID_LOG_CAPTURE_REMOTE           4031
+#define ID_HOT_FUNCTIONS_REPORT         4032
+#define ID_LOG_QUERY                    4033
+#define ID_KERNEL_CONTEXT_REPORT        4034
+#define ID_FILE_EXPORT_TRACE            4035
+#define ID_REGISTRY_COUNT_REPORT        4036
+#define ID_REGISTRY_LATENCY_REPORT      4037
+#define ID_LOG_COMPARE_LOCATION         4038
+#define ID_LOG_COMPARE_STACK            4039
+#define ID_LOG_SPAN_BASELINE            4040
+#define ID_LOG_SPAN_REGRESSIONS         4041
+#define ID_LOG_PAUSE_CAPTURE            4042
+#define ID_FILE_FOLLOW_LOG              4043
+#define ID_LOG_WARNINGS_ONLY            4044
+#define ID_FILE_IMPORT_SCOPED           4045
+#define ID_FILE_ADD_TO_LIBRARY          4046
+#define ID_FILE_SEARCH_LIBRARY          4047
 
 // Next default values for new objects
 //
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
-#define _APS_NEXT_RESOURCE_VALUE        109
-#define _APS_NEXT_COMMAND_VALUE         4013
-#define _APS_NEXT_CONTROL_VALUE         1022
+#define _APS_NEXT_RESOURCE_VALUE        114
+#define _APS_NEXT_COMMAND_VALUE         4048
+#define _APS_NEXT_CONTROL_VALUE         1034
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif
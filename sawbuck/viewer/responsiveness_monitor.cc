@@ -0,0 +1,176 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// UI responsiveness monitor implementation.
+#include "sawbuck/viewer/responsiveness_monitor.h"
+
+#include <algorithm>
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+
+namespace {
+
+bool LongerTotal(const ResponsivenessMonitor::PostingSite& a,
+                 const ResponsivenessMonitor::PostingSite& b) {
+  return a.total > b.total;
+}
+
+void FormatHistogram(const char* title,
+                     const ResponsivenessMonitor::Histogram& histogram,
+                     std::string* text) {
+  typedef ResponsivenessMonitor::Histogram Histogram;
+  base::StringAppendF(text, "%s: %lld, %.1f ms total, %.1f ms max\n",
+                      title, histogram.total_count,
+                      histogram.total.InMillisecondsF(),
+                      histogram.max.InMillisecondsF());
+  for (size_t i = 0; i < Histogram::kNumBuckets; ++i) {
+    if (histogram.counts[i] == 0)
+      continue;
+
+    std::string range;
+    if (i == 0)
+      range = "< 1 ms";
+    else if (i + 1 == Histogram::kNumBuckets)
+      range = base::StringPrintf(">= %d ms", 1 << (i - 1));
+    else
+      range = base::StringPrintf("%d - %d ms", 1 << (i - 1), 1 << i);
+    base::StringAppendF(text, "  %-16s %12lld\n", range.c_str(),
+                        histogram.counts[i]);
+  }
+}
+
+}  // namespace
+
+const int ResponsivenessMonitor::kStallThresholdMs;
+const size_t ResponsivenessMonitor::Histogram::kNumBuckets;
+
+ResponsivenessMonitor::Histogram::Histogram() : total_count(0) {
+  for (size_t i = 0; i < kNumBuckets; ++i)
+    counts[i] = 0;
+}
+
+void ResponsivenessMonitor::Histogram::Add(base::TimeDelta duration) {
+  ++counts[GetBucket(duration)];
+  ++total_count;
+  total += duration;
+  max = std::max(max, duration);
+}
+
+size_t ResponsivenessMonitor::Histogram::GetBucket(
+    base::TimeDelta duration) {
+  int64 ms = duration.InMilliseconds();
+  size_t bucket = 0;
+  while (ms > 0 && bucket + 1 < kNumBuckets) {
+    ms >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+ResponsivenessMonitor::ResponsivenessMonitor() {
+}
+
+ResponsivenessMonitor::~ResponsivenessMonitor() {
+}
+
+void ResponsivenessMonitor::TaskStarted(base::TimeTicks now) {
+  if (!running_tasks_.empty())
+    running_tasks_.back().nested = true;
+
+  RunningTask task = { now, false };
+  running_tasks_.push_back(task);
+}
+
+void ResponsivenessMonitor::TaskFinished(
+    const tracked_objects::Location& posted_from, base::TimeTicks now) {
+  // We may have been installed while a task was running.
+  if (running_tasks_.empty())
+    return;
+
+  RunningTask task = running_tasks_.back();
+  running_tasks_.pop_back();
+  if (task.nested)
+    return;
+
+  base::TimeDelta duration = now - task.start;
+  task_durations_.Add(duration);
+  if (duration.InMilliseconds() <= kStallThresholdMs)
+    return;
+
+  std::pair<std::string, int> key(posted_from.file_name(),
+                                  posted_from.line_number());
+  PostingSite& site = posting_sites_[key];
+  if (site.long_tasks == 0) {
+    site.function = posted_from.function_name();
+    site.file = key.first;
+    site.line = key.second;
+  }
+  ++site.long_tasks;
+  site.total += duration;
+  site.max = std::max(site.max, duration);
+
+  ReportStall(base::StringPrintf(L"UI stalled for %lld ms in a task from %ls"
+                                     L" (%ls:%d)",
+                                 duration.InMilliseconds(),
+                                 base::UTF8ToWide(site.function).c_str(),
+                                 base::UTF8ToWide(site.file).c_str(),
+                                 site.line));
+}
+
+void ResponsivenessMonitor::MessageDispatched(base::TimeDelta wait) {
+  dispatch_waits_.Add(wait);
+  if (wait.InMilliseconds() <= kStallThresholdMs)
+    return;
+
+  ReportStall(base::StringPrintf(L"UI stalled for %lld ms before dispatching"
+                                     L" a message",
+                                 wait.InMilliseconds()));
+}
+
+void ResponsivenessMonitor::GetPostingSites(
+    std::vector<PostingSite>* sites) const {
+  DCHECK(sites != NULL);
+  sites->clear();
+  PostingSiteMap::const_iterator it(posting_sites_.begin());
+  for (; it != posting_sites_.end(); ++it)
+    sites->push_back(it->second);
+  std::stable_sort(sites->begin(), sites->end(), LongerTotal);
+}
+
+std::string ResponsivenessMonitor::Format() const {
+  std::string text;
+  FormatHistogram("UI tasks", task_durations_, &text);
+  FormatHistogram("UI message dispatch waits", dispatch_waits_, &text);
+
+  std::vector<PostingSite> sites;
+  GetPostingSites(&sites);
+  if (!sites.empty())
+    text += "Long UI tasks by posting site:\n";
+  for (size_t i = 0; i < sites.size(); ++i) {
+    const PostingSite& site = sites[i];
+    base::StringAppendF(&text, "  %s (%s:%d): %lld, %.1f ms total,"
+                            " %.1f ms max\n",
+                        site.function.c_str(), site.file.c_str(), site.line,
+                        site.long_tasks, site.total.InMillisecondsF(),
+                        site.max.InMillisecondsF());
+  }
+  return text;
+}
+
+void ResponsivenessMonitor::ReportStall(const std::wstring& description) {
+  LOG(WARNING) << description;
+  if (!stall_callback_.is_null())
+    stall_callback_.Run(description);
+}
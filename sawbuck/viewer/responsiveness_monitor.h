@@ -0,0 +1,127 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// UI responsiveness monitor declaration.
+#ifndef SAWBUCK_VIEWER_RESPONSIVENESS_MONITOR_H_
+#define SAWBUCK_VIEWER_RESPONSIVENESS_MONITOR_H_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/location.h"
+#include "base/time/time.h"
+
+// Keeps tabs on how responsive the UI thread is. It tallies the durations
+// of the tasks the UI loop runs, and the time the window messages wait to
+// be dispatched, which is how long a message handler that blocks holds up
+// the UI. The tasks and waits that stall the UI for longer than
+// kStallThresholdMs are logged, passed to the stall callback, and the long
+// tasks are attributed to the site that posted them.
+// @note this is only to be used on the UI thread.
+class ResponsivenessMonitor {
+ public:
+  // Tasks and waits longer than this stall the UI.
+  static const int kStallThresholdMs = 100;
+
+  // A histogram of durations in power of two millisecond buckets. Bucket
+  // zero holds the durations under a millisecond, bucket i those in
+  // [2^(i-1), 2^i) ms, and the last one all the longer ones.
+  struct Histogram {
+    static const size_t kNumBuckets = 12;
+
+    Histogram();
+
+    void Add(base::TimeDelta duration);
+    // @returns the bucket @p duration goes in.
+    static size_t GetBucket(base::TimeDelta duration);
+
+    int64 counts[kNumBuckets];
+    int64 total_count;
+    base::TimeDelta total;
+    base::TimeDelta max;
+  };
+
+  // The long tasks posted from a site.
+  struct PostingSite {
+    PostingSite() : line(0), long_tasks(0) {
+    }
+
+    std::string function;
+    std::string file;
+    int line;
+    int64 long_tasks;
+    base::TimeDelta total;
+    base::TimeDelta max;
+  };
+
+  // Told what stalled the UI.
+  typedef base::Callback<void(const std::wstring&)> StallCallback;
+
+  ResponsivenessMonitor();
+  ~ResponsivenessMonitor();
+
+  void set_stall_callback(const StallCallback& stall_callback) {
+    stall_callback_ = stall_callback;
+  }
+
+  // A task starts running at @p now.
+  void TaskStarted(base::TimeTicks now);
+  // The last task started, which was posted from @p posted_from, finished
+  // at @p now. Tasks that ran others in a nested loop go unrecorded, as
+  // they spent their time waiting on the nested loop, e.g. a dialog.
+  void TaskFinished(const tracked_objects::Location& posted_from,
+                    base::TimeTicks now);
+
+  // A window message is dispatched after waiting @p wait since it was
+  // queued.
+  void MessageDispatched(base::TimeDelta wait);
+
+  const Histogram& task_durations() const { return task_durations_; }
+  const Histogram& dispatch_waits() const { return dispatch_waits_; }
+
+  // Retrieves the sites that posted long tasks to @p sites, by the
+  // total time their tasks took, longest first.
+  void GetPostingSites(std::vector<PostingSite>* sites) const;
+
+  // @returns a report of the histograms and posting sites.
+  std::string Format() const;
+
+ private:
+  // A task that's running, and whether it ran others.
+  struct RunningTask {
+    base::TimeTicks start;
+    bool nested;
+  };
+
+  // Logs the stall described by @p description and reports it.
+  void ReportStall(const std::wstring& description);
+
+  std::vector<RunningTask> running_tasks_;
+
+  Histogram task_durations_;
+  Histogram dispatch_waits_;
+
+  // The sites that posted long tasks, by file and line.
+  typedef std::map<std::pair<std::string, int>, PostingSite> PostingSiteMap;
+  PostingSiteMap posting_sites_;
+
+  StallCallback stall_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResponsivenessMonitor);
+};
+
+#endif  // SAWBUCK_VIEWER_RESPONSIVENESS_MONITOR_H_
@@ -0,0 +1,132 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// UI responsiveness monitor unittests.
+#include "sawbuck/viewer/responsiveness_monitor.h"
+
+#include "base/bind.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+typedef ResponsivenessMonitor::Histogram Histogram;
+
+class ResponsivenessMonitorTest : public testing::Test {
+ public:
+  ResponsivenessMonitorTest() : start_(base::TimeTicks::Now()) {
+    monitor_.set_stall_callback(
+        base::Bind(&ResponsivenessMonitorTest::OnStall,
+                   base::Unretained(this)));
+  }
+
+  void OnStall(const std::wstring& description) {
+    stalls_.push_back(description);
+  }
+
+  // Runs a task posted from @p posted_from, which takes @p ms.
+  void RunTask(const tracked_objects::Location& posted_from, int ms) {
+    monitor_.TaskStarted(start_);
+    monitor_.TaskFinished(posted_from,
+                          start_ + base::TimeDelta::FromMilliseconds(ms));
+  }
+
+ protected:
+  base::TimeTicks start_;
+  ResponsivenessMonitor monitor_;
+  std::vector<std::wstring> stalls_;
+};
+
+}  // namespace
+
+TEST(ResponsivenessMonitorHistogramTest, GetBucket) {
+  EXPECT_EQ(0U, Histogram::GetBucket(base::TimeDelta()));
+  EXPECT_EQ(0U, Histogram::GetBucket(base::TimeDelta::FromMicroseconds(999)));
+  EXPECT_EQ(1U, Histogram::GetBucket(base::TimeDelta::FromMilliseconds(1)));
+  EXPECT_EQ(2U, Histogram::GetBucket(base::TimeDelta::FromMilliseconds(2)));
+  EXPECT_EQ(2U, Histogram::GetBucket(base::TimeDelta::FromMilliseconds(3)));
+  EXPECT_EQ(8U, Histogram::GetBucket(base::TimeDelta::FromMilliseconds(200)));
+  EXPECT_EQ(Histogram::kNumBuckets - 1,
+            Histogram::GetBucket(base::TimeDelta::FromSeconds(1000)));
+}
+
+TEST_F(ResponsivenessMonitorTest, TalliesTasks) {
+  RunTask(FROM_HERE, 0);
+  RunTask(FROM_HERE, 5);
+  RunTask(FROM_HERE, 5);
+
+  const Histogram& durations = monitor_.task_durations();
+  EXPECT_EQ(3, durations.total_count);
+  EXPECT_EQ(1, durations.counts[0]);
+  EXPECT_EQ(2, durations.counts[3]);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(10), durations.total);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(5), durations.max);
+
+  // None of them stalled.
+  EXPECT_TRUE(stalls_.empty());
+  std::vector<ResponsivenessMonitor::PostingSite> sites;
+  monitor_.GetPostingSites(&sites);
+  EXPECT_TRUE(sites.empty());
+}
+
+TEST_F(ResponsivenessMonitorTest, AttributesLongTasks) {
+  tracked_objects::Location site1(FROM_HERE);
+  tracked_objects::Location site2(FROM_HERE);
+  RunTask(site1, 150);
+  RunTask(site2, 400);
+  RunTask(site1, 200);
+  RunTask(site1, ResponsivenessMonitor::kStallThresholdMs);
+  EXPECT_EQ(3U, stalls_.size());
+
+  std::vector<ResponsivenessMonitor::PostingSite> sites;
+  monitor_.GetPostingSites(&sites);
+  ASSERT_EQ(2U, sites.size());
+  EXPECT_EQ(site2.line_number(), sites[0].line);
+  EXPECT_EQ(1, sites[0].long_tasks);
+  EXPECT_EQ(site1.line_number(), sites[1].line);
+  EXPECT_EQ(site1.file_name(), sites[1].file);
+  EXPECT_EQ(site1.function_name(), sites[1].function);
+  EXPECT_EQ(2, sites[1].long_tasks);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(350), sites[1].total);
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(200), sites[1].max);
+
+  EXPECT_NE(std::string::npos, monitor_.Format().find("Long UI tasks"));
+}
+
+TEST_F(ResponsivenessMonitorTest, SkipsNestingTasks) {
+  // A task that runs a nested loop, e.g. for a dialog, isn't a stall.
+  monitor_.TaskStarted(start_);
+  RunTask(FROM_HERE, 1);
+  monitor_.TaskFinished(FROM_HERE, start_ + base::TimeDelta::FromSeconds(5));
+
+  EXPECT_EQ(1, monitor_.task_durations().total_count);
+  EXPECT_TRUE(stalls_.empty());
+
+  // Nor is a task that was running before we were.
+  monitor_.TaskFinished(FROM_HERE, start_ + base::TimeDelta::FromSeconds(5));
+  EXPECT_EQ(1, monitor_.task_durations().total_count);
+}
+
+TEST_F(ResponsivenessMonitorTest, TalliesDispatchWaits) {
+  monitor_.MessageDispatched(base::TimeDelta::FromMilliseconds(1));
+  EXPECT_TRUE(stalls_.empty());
+  monitor_.MessageDispatched(base::TimeDelta::FromMilliseconds(300));
+  ASSERT_EQ(1U, stalls_.size());
+  EXPECT_NE(std::wstring::npos, stalls_[0].find(L"300 ms"));
+
+  const Histogram& waits = monitor_.dispatch_waits();
+  EXPECT_EQ(2, waits.total_count);
+  EXPECT_EQ(1, waits.counts[1]);
+  EXPECT_EQ(1, waits.counts[9]);
+  EXPECT_EQ(0, monitor_.task_durations().total_count);
+}
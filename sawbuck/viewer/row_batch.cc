@@ -0,0 +1,178 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Row batch implementation.
+#include "sawbuck/viewer/row_batch.h"
+
+#include "base/logging.h"
+#include "sawbuck/viewer/log_list_view.h"
+#include "sawbuck/viewer/log_store.h"
+
+RowBatch::RowBatch() : first_row(0), num_rows(0), columns(0) {
+}
+
+RowBatch::~RowBatch() {
+}
+
+void RowBatch::Reset(int first_row, int num_rows, uint32 columns) {
+  DCHECK_LE(0, num_rows);
+  this->first_row = first_row;
+  this->num_rows = num_rows;
+  this->columns = columns;
+
+  size_t size = static_cast<size_t>(num_rows);
+  severities.resize(columns & SEVERITY ? size : 0);
+  process_ids.resize(columns & PROCESS_ID ? size : 0);
+  thread_ids.resize(columns & THREAD_ID ? size : 0);
+  times.resize(columns & TIME ? size : 0);
+  file_atoms.resize(columns & FILE_ATOM ? size : 0);
+  file_names.resize(columns & FILE_NAME ? size : 0);
+  lines.resize(columns & LINE ? size : 0);
+  messages.resize(columns & MESSAGE ? size : 0);
+  stack_ids.resize(columns & STACK_ID ? size : 0);
+  repeat_counts.resize(columns & REPEATS ? size : 0);
+  last_times.resize(columns & REPEATS ? size : 0);
+  store_rows.clear();
+
+  // The buffers only grow, so that their strings keep their capacity.
+  if (columns & FILE_NAME && file_name_buffers.size() < size)
+    file_name_buffers.resize(size);
+  if (columns & MESSAGE && message_buffers.size() < size)
+    message_buffers.resize(size);
+}
+
+void RowBatch::FillFromStore(const LogStore& store, RowBatch* batch) {
+  DCHECK(batch != NULL);
+  DCHECK_EQ(batch->num_rows, static_cast<int>(batch->store_rows.size()));
+  const std::vector<int>& rows = batch->store_rows;
+  int num_rows = batch->num_rows;
+
+  if (batch->columns & SEVERITY) {
+    for (int i = 0; i < num_rows; ++i)
+      batch->severities[i] = store.GetSeverity(rows[i]);
+  }
+  if (batch->columns & PROCESS_ID) {
+    for (int i = 0; i < num_rows; ++i)
+      batch->process_ids[i] = store.GetProcessId(rows[i]);
+  }
+  if (batch->columns & THREAD_ID) {
+    for (int i = 0; i < num_rows; ++i)
+      batch->thread_ids[i] = store.GetThreadId(rows[i]);
+  }
+  if (batch->columns & TIME) {
+    for (int i = 0; i < num_rows; ++i)
+      batch->times[i] = store.GetTime(rows[i]);
+  }
+  if (batch->columns & FILE_ATOM) {
+    for (int i = 0; i < num_rows; ++i)
+      batch->file_atoms[i] = store.GetFileAtom(rows[i]);
+  }
+  if (batch->columns & FILE_NAME) {
+    // The names are interned, so they stay put.
+    for (int i = 0; i < num_rows; ++i)
+      batch->file_names[i] = store.GetFileName(rows[i]);
+  }
+  if (batch->columns & LINE) {
+    for (int i = 0; i < num_rows; ++i)
+      batch->lines[i] = store.GetLine(rows[i]);
+  }
+  if (batch->columns & MESSAGE) {
+    for (int i = 0; i < num_rows; ++i) {
+      batch->messages[i] =
+          store.GetMessage(rows[i], &batch->message_buffers[i]);
+    }
+  }
+  if (batch->columns & STACK_ID) {
+    for (int i = 0; i < num_rows; ++i)
+      batch->stack_ids[i] = store.GetStackTraceId(rows[i]);
+  }
+  if (batch->columns & REPEATS) {
+    for (int i = 0; i < num_rows; ++i) {
+      batch->repeat_counts[i] = store.GetRepeatCount(rows[i]);
+      batch->last_times[i] = store.GetLastTime(rows[i]);
+    }
+  }
+}
+
+void RowBatch::FillFromView(ILogView* view, RowBatch* batch) {
+  DCHECK(view != NULL);
+  DCHECK(batch != NULL);
+  int first_row = batch->first_row;
+  int num_rows = batch->num_rows;
+
+  if (batch->columns & SEVERITY) {
+    for (int i = 0; i < num_rows; ++i)
+      batch->severities[i] = view->GetSeverity(first_row + i);
+  }
+  if (batch->columns & PROCESS_ID) {
+    for (int i = 0; i < num_rows; ++i)
+      batch->process_ids[i] = view->GetProcessId(first_row + i);
+  }
+  if (batch->columns & THREAD_ID) {
+    for (int i = 0; i < num_rows; ++i)
+      batch->thread_ids[i] = view->GetThreadId(first_row + i);
+  }
+  if (batch->columns & TIME) {
+    for (int i = 0; i < num_rows; ++i)
+      batch->times[i] = view->GetTime(first_row + i);
+  }
+  if (batch->columns & FILE_ATOM) {
+    for (int i = 0; i < num_rows; ++i)
+      batch->file_atoms[i] = view->GetFileAtom(first_row + i);
+  }
+  if (batch->columns & FILE_NAME) {
+    for (int i = 0; i < num_rows; ++i) {
+      batch->file_names[i] = view->GetFileNamePiece(
+          first_row + i, &batch->file_name_buffers[i]);
+    }
+  }
+  if (batch->columns & LINE) {
+    for (int i = 0; i < num_rows; ++i)
+      batch->lines[i] = view->GetLine(first_row + i);
+  }
+  if (batch->columns & MESSAGE) {
+    for (int i = 0; i < num_rows; ++i) {
+      batch->messages[i] = view->GetMessagePiece(
+          first_row + i, &batch->message_buffers[i]);
+    }
+  }
+  if (batch->columns & STACK_ID) {
+    for (int i = 0; i < num_rows; ++i)
+      batch->stack_ids[i] = view->GetStackTraceId(first_row + i);
+  }
+  if (batch->columns & REPEATS) {
+    for (int i = 0; i < num_rows; ++i) {
+      batch->repeat_counts[i] = view->GetRepeatCount(first_row + i);
+      batch->last_times[i] = view->GetLastTime(first_row + i);
+    }
+  }
+}
+
+void ILogView::GetRows(int first_row, int num_rows, uint32 columns,
+                       RowBatch* batch) {
+  DCHECK(batch != NULL);
+  batch->Reset(first_row, num_rows, columns);
+
+  const LogStore* store = GetMappedStore();
+  if (store == NULL) {
+    RowBatch::FillFromView(this, batch);
+    return;
+  }
+
+  // The rows are mapped once, rather than once per column.
+  batch->store_rows.resize(num_rows);
+  for (int i = 0; i < num_rows; ++i)
+    batch->store_rows[i] = GetStoreRow(first_row + i);
+  RowBatch::FillFromStore(*store, batch);
+}
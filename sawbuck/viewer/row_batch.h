@@ -0,0 +1,104 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Row batch declaration.
+#ifndef SAWBUCK_VIEWER_ROW_BATCH_H_
+#define SAWBUCK_VIEWER_ROW_BATCH_H_
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+#include "sawbuck/log_lib/string_table.h"
+#include "sawbuck/viewer/stack_trace_pool.h"
+
+class ILogView;
+class LogStore;
+
+// The columns of a range of rows of a view, an array per column, as
+// ILogView::GetRows fills them in. Consumers that go over many rows read
+// a column at a time rather than a virtual call per cell.
+// Only the columns asked for are filled in, the others are left empty.
+// The file names and messages are pieces of the view's memory where it
+// has any to give, valid for as long as those of ILogView's zero-copy
+// accessors, and of the batch's own buffers otherwise.
+struct RowBatch {
+  // The columns, as bits of a mask.
+  enum Column {
+    SEVERITY = 1 << 0,
+    PROCESS_ID = 1 << 1,
+    THREAD_ID = 1 << 2,
+    TIME = 1 << 3,
+    FILE_ATOM = 1 << 4,
+    FILE_NAME = 1 << 5,
+    LINE = 1 << 6,
+    MESSAGE = 1 << 7,
+    STACK_ID = 1 << 8,
+    // The repeat counts and the times of the last occurrences.
+    REPEATS = 1 << 9,
+
+    // The columns LogViewFormatter shows.
+    FORMATTED_COLUMNS = SEVERITY | PROCESS_ID | THREAD_ID | TIME | FILE_NAME |
+        LINE | MESSAGE | REPEATS,
+    ALL_COLUMNS = (1 << 10) - 1,
+  };
+
+  RowBatch();
+  ~RowBatch();
+
+  // Empties the batch, and sizes the @p columns for @p num_rows rows from
+  // @p first_row on.
+  void Reset(int first_row, int num_rows, uint32 columns);
+
+  // Fill in the columns of @p batch, as reset, from the rows of @p store in
+  // its |store_rows|, or from @p view's accessors, a column at a time.
+  // @{
+  static void FillFromStore(const LogStore& store, RowBatch* batch);
+  static void FillFromView(ILogView* view, RowBatch* batch);
+  // @}
+
+  // @returns true iff the batch holds all of @p columns.
+  bool HasColumns(uint32 columns) const {
+    return (this->columns & columns) == columns;
+  }
+
+  int first_row;
+  int num_rows;
+  uint32 columns;
+
+  // Indexed by row - first_row.
+  std::vector<int> severities;
+  std::vector<DWORD> process_ids;
+  std::vector<DWORD> thread_ids;
+  std::vector<base::Time> times;
+  std::vector<StringTable::Atom> file_atoms;
+  std::vector<base::StringPiece> file_names;
+  std::vector<int> lines;
+  std::vector<base::StringPiece> messages;
+  std::vector<StackTracePool::StackId> stack_ids;
+  std::vector<int> repeat_counts;
+  std::vector<base::Time> last_times;
+
+  // The rows of the view's mapped store the rows are, if it has one.
+  std::vector<int> store_rows;
+
+  // The strings of views that copy theirs, which the pieces above point
+  // into. They keep their capacity from batch to batch.
+  std::vector<std::string> file_name_buffers;
+  std::vector<std::string> message_buffers;
+};
+
+#endif  // SAWBUCK_VIEWER_ROW_BATCH_H_
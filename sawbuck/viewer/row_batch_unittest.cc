@@ -0,0 +1,140 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Row batch unit tests.
+#include "sawbuck/viewer/row_batch.h"
+
+#include "base/strings/stringprintf.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/log_list_view.h"
+#include "sawbuck/viewer/log_store.h"
+#include "sawbuck/viewer/store_log_view.h"
+
+namespace {
+
+using testing::StoreLogView;
+
+// A view on every other row of a view, which maps to the original's store.
+class EvenRowsView : public StoreLogView {
+ public:
+  EvenRowsView(LogStore* store, ILogView* original)
+      : StoreLogView(store), original_(original) {
+    set_hide_store(true);
+  }
+
+  virtual int GetNumRows() { return (original_->GetNumRows() + 1) / 2; }
+  virtual int GetFirstRow() { return 0; }
+  virtual const LogStore* GetMappedStore() {
+    return original_->GetMappedStore();
+  }
+  virtual int GetStoreRow(int row) { return 2 * row; }
+
+ private:
+  ILogView* original_;
+};
+
+class RowBatchTest : public testing::Test {
+ public:
+  RowBatchTest() : store_(&file_table_) {
+  }
+
+  virtual void SetUp() {
+    StringTable::Atom files[] = {
+      file_table_.Intern("foo.cc"),
+      file_table_.Intern("bar.cc"),
+    };
+    for (int i = 0; i < kNumRows; ++i) {
+      store_.AddRow(i % 3 == 0 ? TRACE_LEVEL_ERROR : TRACE_LEVEL_INFORMATION,
+                    10 + i % 2, 100 + i % 5,
+                    base::Time::FromInternalValue(1000 * (i + 1)),
+                    files[i % 2], i, base::StringPrintf("Row %d", i), 0,
+                    NULL);
+    }
+  }
+
+  // Expects the columns of @p batch to be those of the store's rows
+  // [@p first_row, @p first_row + @p num_rows) at @p stride.
+  void ExpectRows(const RowBatch& batch, int first_row, int num_rows,
+                  int stride) {
+    ASSERT_EQ(num_rows, batch.num_rows);
+    std::string buffer;
+    for (int i = 0; i < num_rows; ++i) {
+      int row = (first_row + i) * stride;
+      EXPECT_EQ(store_.GetSeverity(row), batch.severities[i]);
+      EXPECT_EQ(store_.GetProcessId(row), batch.process_ids[i]);
+      EXPECT_EQ(store_.GetThreadId(row), batch.thread_ids[i]);
+      EXPECT_EQ(store_.GetTime(row), batch.times[i]);
+      EXPECT_EQ(store_.GetFileAtom(row), batch.file_atoms[i]);
+      EXPECT_EQ(store_.GetFileName(row), batch.file_names[i].as_string());
+      EXPECT_EQ(store_.GetLine(row), batch.lines[i]);
+      EXPECT_EQ(store_.GetMessage(row, &buffer), batch.messages[i]);
+      EXPECT_EQ(store_.GetStackTraceId(row), batch.stack_ids[i]);
+      EXPECT_EQ(1, batch.repeat_counts[i]);
+      EXPECT_EQ(store_.GetTime(row), batch.last_times[i]);
+    }
+  }
+
+ protected:
+  static const int kNumRows = 100;
+
+  StringTable file_table_;
+  LogStore store_;
+};
+
+}  // namespace
+
+TEST_F(RowBatchTest, FromStore) {
+  StoreLogView view(&store_);
+  RowBatch batch;
+  view.GetRows(10, 20, RowBatch::ALL_COLUMNS, &batch);
+  EXPECT_EQ(10, batch.first_row);
+  EXPECT_EQ(20U, batch.store_rows.size());
+  ExpectRows(batch, 10, 20, 1);
+}
+
+TEST_F(RowBatchTest, FromAccessors) {
+  StoreLogView view(&store_);
+  view.set_hide_store(true);
+  RowBatch batch;
+  view.GetRows(10, 20, RowBatch::ALL_COLUMNS, &batch);
+  EXPECT_TRUE(batch.store_rows.empty());
+  ExpectRows(batch, 10, 20, 1);
+}
+
+TEST_F(RowBatchTest, ThroughMapping) {
+  StoreLogView view(&store_);
+  EvenRowsView even(&store_, &view);
+  RowBatch batch;
+  even.GetRows(5, 10, RowBatch::ALL_COLUMNS, &batch);
+  ExpectRows(batch, 5, 10, 2);
+}
+
+TEST_F(RowBatchTest, OnlyColumnsAsked) {
+  StoreLogView view(&store_);
+  view.set_hide_store(true);
+  RowBatch batch;
+  view.GetRows(0, 50, RowBatch::ALL_COLUMNS, &batch);
+
+  // The batch is reused, and keeps only the columns asked for.
+  view.GetRows(40, 10, RowBatch::SEVERITY | RowBatch::MESSAGE, &batch);
+  EXPECT_TRUE(batch.HasColumns(RowBatch::SEVERITY | RowBatch::MESSAGE));
+  EXPECT_FALSE(batch.HasColumns(RowBatch::FORMATTED_COLUMNS));
+  ASSERT_EQ(10U, batch.severities.size());
+  ASSERT_EQ(10U, batch.messages.size());
+  EXPECT_TRUE(batch.times.empty());
+  EXPECT_TRUE(batch.file_names.empty());
+  EXPECT_EQ("Row 45", batch.messages[5].as_string());
+  EXPECT_EQ(TRACE_LEVEL_ERROR, batch.severities[5]);
+  EXPECT_EQ(TRACE_LEVEL_INFORMATION, batch.severities[6]);
+}
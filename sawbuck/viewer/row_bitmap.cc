@@ -0,0 +1,265 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Row bitmap implementation.
+#include "sawbuck/viewer/row_bitmap.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+const int kBitsPerWordShift = 5;
+const int kBitsPerWord = 1 << kBitsPerWordShift;
+const int kBitMask = kBitsPerWord - 1;
+
+// @returns the index of the lowest set bit of a non-zero @p word.
+int LowestBit(uint32 word) {
+  DCHECK_NE(0U, word);
+  int bit = 0;
+  if ((word & 0xFFFF) == 0) {
+    bit += 16;
+    word >>= 16;
+  }
+  if ((word & 0xFF) == 0) {
+    bit += 8;
+    word >>= 8;
+  }
+  if ((word & 0xF) == 0) {
+    bit += 4;
+    word >>= 4;
+  }
+  if ((word & 0x3) == 0) {
+    bit += 2;
+    word >>= 2;
+  }
+  if ((word & 0x1) == 0)
+    bit += 1;
+  return bit;
+}
+
+// @returns the index of the highest set bit of a non-zero @p word.
+int HighestBit(uint32 word) {
+  DCHECK_NE(0U, word);
+  int bit = 0;
+  if (word >= 1U << 16) {
+    bit += 16;
+    word >>= 16;
+  }
+  if (word >= 1U << 8) {
+    bit += 8;
+    word >>= 8;
+  }
+  if (word >= 1U << 4) {
+    bit += 4;
+    word >>= 4;
+  }
+  if (word >= 1U << 2) {
+    bit += 2;
+    word >>= 2;
+  }
+  if (word >= 1U << 1)
+    bit += 1;
+  return bit;
+}
+
+int PopCount(uint32 word) {
+  word = word - ((word >> 1) & 0x55555555);
+  word = (word & 0x33333333) + ((word >> 2) & 0x33333333);
+  word = (word + (word >> 4)) & 0x0F0F0F0F;
+  return static_cast<int>((word * 0x01010101) >> 24);
+}
+
+// @returns a mask of the bits at or above @p bit.
+inline uint32 MaskFrom(int bit) {
+  return ~0U << bit;
+}
+
+// @returns a mask of the bits at or below @p bit.
+inline uint32 MaskThrough(int bit) {
+  return ~0U >> (kBitMask - bit);
+}
+
+}  // namespace
+
+RowBitmap::RowBitmap() : count_(0) {
+}
+
+RowBitmap::~RowBitmap() {
+}
+
+void RowBitmap::Set(int row) {
+  DCHECK_LE(0, row);
+  Reserve(row + 1);
+
+  size_t index = row;
+  for (size_t level = 0; level < levels_.size(); ++level) {
+    uint32& word = levels_[level][index >> kBitsPerWordShift];
+    uint32 bit = 1U << (index & kBitMask);
+    if ((word & bit) != 0)
+      return;
+
+    if (level == 0)
+      ++count_;
+
+    // If the word had bits already, the levels above know of it.
+    bool was_empty = word == 0;
+    word |= bit;
+    if (!was_empty)
+      return;
+
+    index >>= kBitsPerWordShift;
+  }
+}
+
+void RowBitmap::Clear() {
+  std::vector<Level>().swap(levels_);
+  count_ = 0;
+}
+
+bool RowBitmap::Test(int row) const {
+  if (row < 0 || levels_.empty())
+    return false;
+
+  size_t word = row >> kBitsPerWordShift;
+  if (word >= levels_[0].size())
+    return false;
+
+  return (levels_[0][word] & (1U << (row & kBitMask))) != 0;
+}
+
+int RowBitmap::FindNext(int row) const {
+  if (levels_.empty())
+    return -1;
+
+  // Find the first bit at or after the position on the way up, skipping
+  // past each word that has none.
+  size_t position = std::max(row, 0);
+  size_t level = 0;
+  while (true) {
+    const Level& bits = levels_[level];
+    size_t word = position >> kBitsPerWordShift;
+    if (word >= bits.size())
+      return -1;
+
+    uint32 found = bits[word] & MaskFrom(position & kBitMask);
+    if (found != 0) {
+      position = (word << kBitsPerWordShift) + LowestBit(found);
+      break;
+    }
+
+    if (++level == levels_.size())
+      return -1;
+    position = word + 1;
+  }
+
+  // Then take the lowest bit on the way down.
+  while (level > 0) {
+    --level;
+    uint32 bits = levels_[level][position];
+    position = (position << kBitsPerWordShift) + LowestBit(bits);
+  }
+
+  return static_cast<int>(position);
+}
+
+int RowBitmap::FindPrevious(int row) const {
+  if (row < 0 || levels_.empty())
+    return -1;
+
+  size_t position = std::min(static_cast<size_t>(row),
+                             (levels_[0].size() << kBitsPerWordShift) - 1);
+  size_t level = 0;
+  while (true) {
+    const Level& bits = levels_[level];
+    size_t word = position >> kBitsPerWordShift;
+    uint32 found = bits[word] & MaskThrough(position & kBitMask);
+    if (found != 0) {
+      position = (word << kBitsPerWordShift) + HighestBit(found);
+      break;
+    }
+
+    if (word == 0 || ++level == levels_.size())
+      return -1;
+    position = word - 1;
+  }
+
+  while (level > 0) {
+    --level;
+    uint32 bits = levels_[level][position];
+    position = (position << kBitsPerWordShift) + HighestBit(bits);
+  }
+
+  return static_cast<int>(position);
+}
+
+int RowBitmap::CountRange(int begin, int end) const {
+  if (levels_.empty())
+    return 0;
+
+  const Level& bits = levels_[0];
+  begin = std::max(begin, 0);
+  end = std::min(end, static_cast<int>(bits.size() << kBitsPerWordShift));
+  if (begin >= end)
+    return 0;
+
+  size_t first = begin >> kBitsPerWordShift;
+  size_t last = (end - 1) >> kBitsPerWordShift;
+  uint32 first_mask = MaskFrom(begin & kBitMask);
+  uint32 last_mask = MaskThrough((end - 1) & kBitMask);
+  if (first == last)
+    return PopCount(bits[first] & first_mask & last_mask);
+
+  int count = PopCount(bits[first] & first_mask);
+  for (size_t word = first + 1; word < last; ++word)
+    count += PopCount(bits[word]);
+  return count + PopCount(bits[last] & last_mask);
+}
+
+size_t RowBitmap::GetMemoryUsage() const {
+  size_t usage = levels_.capacity() * sizeof(Level);
+  for (size_t level = 0; level < levels_.size(); ++level)
+    usage += levels_[level].capacity() * sizeof(uint32);
+  return usage;
+}
+
+void RowBitmap::Reserve(int num_bits) {
+  size_t words = (num_bits + kBitsPerWord - 1) >> kBitsPerWordShift;
+  if (!levels_.empty() && levels_[0].size() >= words)
+    return;
+
+  // Grow by doubling, to keep the cost of setting ascending rows linear.
+  if (!levels_.empty())
+    words = std::max(words, levels_[0].size() * 2);
+
+  for (size_t level = 0; ; ++level) {
+    if (level == levels_.size()) {
+      // A new level on top, summarize the level below.
+      levels_.push_back(Level(words));
+      if (level > 0) {
+        const Level& below = levels_[level - 1];
+        for (size_t i = 0; i < below.size(); ++i) {
+          if (below[i] != 0)
+            levels_[level][i >> kBitsPerWordShift] |= 1U << (i & kBitMask);
+        }
+      }
+    } else if (levels_[level].size() < words) {
+      levels_[level].resize(words);
+    }
+
+    if (words == 1)
+      break;
+    words = (words + kBitsPerWord - 1) >> kBitsPerWordShift;
+  }
+}
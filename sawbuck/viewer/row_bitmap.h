@@ -0,0 +1,70 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Row bitmap declaration.
+#ifndef SAWBUCK_VIEWER_ROW_BITMAP_H_
+#define SAWBUCK_VIEWER_ROW_BITMAP_H_
+
+#include <vector>
+#include "base/basictypes.h"
+
+// A set of rows, kept as a bitmap with a bit per row. Above the row bits
+// sit summary levels, each with a bit per non-empty word of the level
+// below, so finding the next or previous row in the set takes a step per
+// level rather than a scan over the words between.
+class RowBitmap {
+ public:
+  RowBitmap();
+  ~RowBitmap();
+
+  // Adds @p row to the set.
+  void Set(int row);
+
+  // Empties the set.
+  void Clear();
+
+  // @returns true iff @p row is in the set.
+  bool Test(int row) const;
+
+  // @returns the first row in the set at or after @p row, or -1.
+  int FindNext(int row) const;
+
+  // @returns the last row in the set at or before @p row, or -1.
+  int FindPrevious(int row) const;
+
+  // @returns the number of rows in the set in [@p begin, @p end).
+  int CountRange(int begin, int end) const;
+
+  // @returns the number of rows in the set.
+  int count() const { return count_; }
+  bool empty() const { return count_ == 0; }
+
+  // @returns the approximate memory used by the set.
+  size_t GetMemoryUsage() const;
+
+ private:
+  typedef std::vector<uint32> Level;
+
+  // Grows the levels to hold at least @p num_bits bits at the bottom.
+  void Reserve(int num_bits);
+
+  // The row bits are levels_[0], and each level above has a bit per word
+  // of the level below it. The top level is a single word.
+  std::vector<Level> levels_;
+  int count_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowBitmap);
+};
+
+#endif  // SAWBUCK_VIEWER_ROW_BITMAP_H_
@@ -0,0 +1,112 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/row_bitmap.h"
+
+#include <set>
+#include "gtest/gtest.h"
+
+namespace {
+
+// Checks @p bitmap against @p rows, everywhere up to @p num_rows.
+void ExpectSameRows(const std::set<int>& rows,
+                    const RowBitmap& bitmap,
+                    int num_rows) {
+  EXPECT_EQ(static_cast<int>(rows.size()), bitmap.count());
+
+  for (int row = -1; row <= num_rows; ++row) {
+    EXPECT_EQ(rows.count(row) != 0, bitmap.Test(row));
+
+    std::set<int>::const_iterator next = rows.lower_bound(row);
+    EXPECT_EQ(next == rows.end() ? -1 : *next, bitmap.FindNext(row));
+
+    std::set<int>::const_iterator prev = rows.upper_bound(row);
+    EXPECT_EQ(prev == rows.begin() ? -1 : *--prev, bitmap.FindPrevious(row))
+        << row;
+  }
+}
+
+TEST(RowBitmapTest, Empty) {
+  RowBitmap bitmap;
+  EXPECT_TRUE(bitmap.empty());
+  EXPECT_EQ(0, bitmap.count());
+  EXPECT_FALSE(bitmap.Test(0));
+  EXPECT_EQ(-1, bitmap.FindNext(0));
+  EXPECT_EQ(-1, bitmap.FindPrevious(100));
+  EXPECT_EQ(0, bitmap.CountRange(0, 100));
+}
+
+TEST(RowBitmapTest, FewRows) {
+  RowBitmap bitmap;
+  std::set<int> rows;
+  const int kRows[] = { 0, 31, 32, 33, 63, 64, 1023, 1024, 1025, 40000 };
+  for (size_t i = 0; i < arraysize(kRows); ++i) {
+    bitmap.Set(kRows[i]);
+    rows.insert(kRows[i]);
+  }
+  // Setting twice changes nothing.
+  bitmap.Set(32);
+
+  EXPECT_FALSE(bitmap.empty());
+  ExpectSameRows(rows, bitmap, 41000);
+}
+
+TEST(RowBitmapTest, ManyRows) {
+  RowBitmap bitmap;
+  std::set<int> rows;
+
+  // Spread the rows out unevenly, and out of order.
+  const int kNumRows = 70000;
+  unsigned int seed = 1;
+  for (int i = 0; i < 2000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    int row = (seed >> 8) % kNumRows;
+    if (i % 2)
+      row /= 17;
+    bitmap.Set(row);
+    rows.insert(row);
+  }
+
+  ExpectSameRows(rows, bitmap, kNumRows);
+
+  const int kRanges[][2] = {
+    { 0, kNumRows }, { 0, 1 }, { 5, 37 }, { 31, 33 }, { 100, 100 },
+    { 1000, 50000 }, { 4095, 4097 }, { -10, 10 }, { 69000, 80000 },
+  };
+  for (size_t i = 0; i < arraysize(kRanges); ++i) {
+    int begin = kRanges[i][0];
+    int end = kRanges[i][1];
+    int expected = std::distance(rows.lower_bound(begin),
+                                 rows.lower_bound(end));
+    EXPECT_EQ(expected, bitmap.CountRange(begin, end))
+        << begin << ", " << end;
+  }
+}
+
+TEST(RowBitmapTest, Clear) {
+  RowBitmap bitmap;
+  for (int row = 0; row < 10000; row += 3)
+    bitmap.Set(row);
+  EXPECT_EQ(3334, bitmap.count());
+  EXPECT_LT(10000U / 8, bitmap.GetMemoryUsage());
+
+  bitmap.Clear();
+  EXPECT_TRUE(bitmap.empty());
+  EXPECT_EQ(-1, bitmap.FindNext(0));
+
+  bitmap.Set(7);
+  EXPECT_EQ(7, bitmap.FindNext(0));
+  EXPECT_EQ(7, bitmap.FindPrevious(9999));
+}
+
+}  // namespace
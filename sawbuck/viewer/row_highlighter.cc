@@ -0,0 +1,343 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Row highlighter implementation.
+#include "sawbuck/viewer/row_highlighter.h"
+
+#include <algorithm>
+#include <iterator>
+#include "base/bind.h"
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop/message_loop.h"
+#include "base/values.h"
+#include "sawbuck/common/perf_counters.h"
+#include "sawbuck/common/task_pool.h"
+#include "sawbuck/viewer/log_list_view.h"
+
+namespace {
+
+PerfCounter highlight_chunk_counter("RowHighlighter.Chunk", 1);
+PerfCounter highlight_range_counter("RowHighlighter.Range", 1);
+
+// No more threads than this evaluate a chunk.
+const size_t kMaxThreads = 8;
+// A chunk holds at most this many rows per thread.
+const int kMaxRowsPerThread = 2000;
+// A row costs a run of every rule's filter program, messages and all,
+// so even a few hundred rows keep a thread busy past the posting cost.
+const int kMinRowsPerThread = 250;
+
+}  // namespace
+
+const COLORREF HighlightRule::kDefaultColor;
+const RowHighlighter::StyleId RowHighlighter::kNoStyle;
+const size_t RowHighlighter::kMaxRules;
+
+HighlightRule::HighlightRule(const Filter& filter,
+                             COLORREF text_color,
+                             COLORREF background_color,
+                             bool bold)
+    : filter(filter), text_color(text_color),
+      background_color(background_color), bold(bold) {
+}
+
+RowHighlighter::RowHighlighter(const RestyledCallback& restyled)
+    : restyled_(restyled), view_(NULL), first_row_(0), refresh_row_(0),
+      refresh_end_(0), refresh_rule_(0),
+      max_threads_(std::min(TaskPool::Get()->num_workers() + 1,
+                            kMaxThreads)) {
+}
+
+RowHighlighter::~RowHighlighter() {
+  // Make sure we're not pinged post-destruction.
+  if (!task_.IsCancelled())
+    task_.Cancel();
+}
+
+void RowHighlighter::SetView(ILogView* view) {
+  view_ = view;
+  // The programs' match state is for the old view's rows.
+  thread_programs_.clear();
+  OnRowsCleared();
+}
+
+void RowHighlighter::SetRules(const std::vector<HighlightRule>& rules) {
+  // The rows styled by the leading rules that stay the same keep their
+  // style, the others are evaluated against the rules past those.
+  size_t kept = 0;
+  while (kept < rules.size() && kept < rules_.size() &&
+         rules[kept].filter == rules_[kept].filter) {
+    ++kept;
+  }
+
+  rules_ = rules;
+  if (rules_.size() > kMaxRules)
+    rules_.erase(rules_.begin() + kMaxRules, rules_.end());
+  kept = std::min(kept, rules_.size());
+  thread_programs_.clear();
+
+  for (size_t i = 0; i < styles_.size(); ++i) {
+    if (styles_[i] > kept)
+      styles_[i] = kNoStyle;
+  }
+
+  // A refresh in progress is for rules from refresh_rule_ on, so it starts
+  // over from the earlier of the two.
+  if (refresh_row_ < refresh_end_)
+    kept = std::min(kept, refresh_rule_);
+  refresh_row_ = first_row_;
+  refresh_end_ = first_row_ + static_cast<int>(styles_.size());
+  refresh_rule_ = kept;
+  if (refresh_rule_ >= rules_.size())
+    refresh_row_ = refresh_end_;
+
+  restyled_.Run(first_row_, refresh_end_);
+  if (refresh_row_ < refresh_end_ ||
+      (view_ != NULL && refresh_end_ < view_->GetNumRows())) {
+    PostEvaluateTask();
+  }
+}
+
+RowHighlighter::StyleId RowHighlighter::GetStyle(int row) const {
+  if (row < first_row_ ||
+      row >= first_row_ + static_cast<int>(styles_.size())) {
+    return kNoStyle;
+  }
+  return styles_[row - first_row_];
+}
+
+const HighlightRule* RowHighlighter::GetRule(StyleId style) const {
+  if (style == kNoStyle || style > rules_.size())
+    return NULL;
+  return &rules_[style - 1];
+}
+
+void RowHighlighter::OnRowsAdded() {
+  PostEvaluateTask();
+}
+
+void RowHighlighter::OnRowsEvicted(int first_row) {
+  while (first_row_ < first_row && !styles_.empty()) {
+    styles_.pop_front();
+    ++first_row_;
+  }
+  first_row_ = std::max(first_row_, first_row);
+  refresh_row_ = std::max(refresh_row_, first_row_);
+  refresh_end_ = std::max(refresh_end_, refresh_row_);
+}
+
+void RowHighlighter::OnRowsCleared() {
+  styles_.clear();
+  first_row_ = view_ != NULL ? view_->GetFirstRow() : 0;
+  refresh_row_ = first_row_;
+  refresh_end_ = first_row_;
+  PostEvaluateTask();
+}
+
+// static
+std::string RowHighlighter::SerializeRules(
+    const std::vector<HighlightRule>& rules) {
+  scoped_ptr<base::ListValue> rule_list(new base::ListValue);
+  for (size_t i = 0; i < rules.size(); ++i) {
+    base::DictionaryValue* rule_dict = rules[i].filter.Serialize();
+    rule_dict->SetInteger("text_color",
+                          static_cast<int>(rules[i].text_color));
+    rule_dict->SetInteger("background_color",
+                          static_cast<int>(rules[i].background_color));
+    rule_dict->SetBoolean("bold", rules[i].bold);
+    rule_list->Append(rule_dict);
+  }
+
+  std::string serialized_string;
+  base::JSONWriter::WriteWithOptions(rule_list.get(),
+                                     base::JSONWriter::OPTIONS_PRETTY_PRINT,
+                                     &serialized_string);
+  return serialized_string;
+}
+
+// static
+std::vector<HighlightRule> RowHighlighter::DeserializeRules(
+    const std::string& stored) {
+  std::vector<HighlightRule> rules;
+  if (stored.empty())
+    return rules;
+
+  scoped_ptr<base::Value> parsed_value(base::JSONReader::Read(stored, true));
+  if (parsed_value.get() == NULL ||
+      !parsed_value->IsType(base::Value::TYPE_LIST)) {
+    LOG(ERROR) << "Failed to parse highlight rule list: " << stored;
+    return rules;
+  }
+
+  const base::ListValue* rule_list =
+      static_cast<base::ListValue*>(parsed_value.get());
+  base::ListValue::const_iterator it(rule_list->begin());
+  for (; it != rule_list->end(); ++it) {
+    if (!(*it)->IsType(base::Value::TYPE_DICTIONARY)) {
+      LOG(ERROR) << "Unexpected highlight rule type, type: "
+                 << (*it)->GetType() << ", string: " << stored;
+      continue;
+    }
+
+    const base::DictionaryValue* rule_dict =
+        static_cast<base::DictionaryValue*>(*it);
+    Filter filter(rule_dict);
+    if (!filter.IsValid())
+      continue;
+
+    // Missing styles leave the look of the rows as it is.
+    int text_color = static_cast<int>(HighlightRule::kDefaultColor);
+    int background_color = static_cast<int>(HighlightRule::kDefaultColor);
+    bool bold = false;
+    rule_dict->GetInteger("text_color", &text_color);
+    rule_dict->GetInteger("background_color", &background_color);
+    rule_dict->GetBoolean("bold", &bold);
+    rules.push_back(HighlightRule(filter,
+                                  static_cast<COLORREF>(text_color),
+                                  static_cast<COLORREF>(background_color),
+                                  bold));
+  }
+
+  return rules;
+}
+
+void RowHighlighter::PreparePrograms(size_t num_threads) {
+  while (thread_programs_.size() < num_threads) {
+    ThreadPrograms* thread = new ThreadPrograms;
+    for (size_t i = 0; i < rules_.size(); ++i) {
+      std::vector<Filter> inclusion;
+      std::vector<Filter> exclusion;
+      if (rules_[i].filter.action() == Filter::EXCLUDE)
+        exclusion.push_back(rules_[i].filter);
+      else
+        inclusion.push_back(rules_[i].filter);
+      thread->programs.push_back(new FilterProgram(inclusion, exclusion));
+    }
+    thread_programs_.push_back(thread);
+  }
+}
+
+void RowHighlighter::PostEvaluateTask() {
+  // Without rules, nothing's styled, and the rows are left to evaluate
+  // against the rules to come.
+  if (view_ == NULL || rules_.empty())
+    return;
+
+  if (task_.IsCancelled()) {
+    task_.Reset(base::Bind(&RowHighlighter::EvaluateChunk,
+                           base::Unretained(this)));
+    base::MessageLoop::current()->PostTask(FROM_HERE, task_.callback());
+  }
+}
+
+void RowHighlighter::EvaluateChunk() {
+  ScopedPerfTimer timer(&highlight_chunk_counter);
+  task_.Cancel();
+  if (view_ == NULL || rules_.empty())
+    return;
+
+  // Rows restyled by a change of rules go before the new rows, as they're
+  // likelier to be on screen.
+  int num_rows = view_->GetNumRows();
+  int end = first_row_ + static_cast<int>(styles_.size());
+  bool refreshing = refresh_row_ < refresh_end_;
+  int start = refreshing ? refresh_row_ : end;
+  int limit = refreshing ? refresh_end_ : num_rows;
+  size_t first_rule = refreshing ? refresh_rule_ : 0;
+  if (start >= limit)
+    return;
+
+  int num_threads = std::max(1, std::min(static_cast<int>(max_threads_),
+                                         (limit - start) / kMinRowsPerThread));
+  int chunk_end = std::min(start + num_threads * kMaxRowsPerThread, limit);
+
+  if (refreshing) {
+    refresh_row_ = chunk_end;
+  } else {
+    // The new rows start out unstyled, and are styled in place.
+    styles_.resize(chunk_end - first_row_, kNoStyle);
+  }
+
+  if (first_rule < rules_.size()) {
+    PreparePrograms(num_threads);
+
+    // Hand the trailing ranges to the task pool, then evaluate the first
+    // range ourselves, and any the pool hasn't got to by then.
+    int range = (chunk_end - start + num_threads - 1) / num_threads;
+    TaskPool::TaskGroup group(TaskPool::Get(), TaskPool::PRIORITY_VISIBLE,
+                              &highlight_range_counter);
+    for (int i = 1; i < num_threads; ++i) {
+      group.Post(base::Bind(&RowHighlighter::EvaluateRangeTask, this, i,
+                            first_rule,
+                            std::min(start + i * range, chunk_end),
+                            std::min(start + (i + 1) * range, chunk_end)));
+    }
+    EvaluateRange(0, first_rule, start, std::min(start + range, chunk_end));
+    group.Wait();
+  }
+
+  restyled_.Run(start, chunk_end);
+
+  // Post again if there's more to do.
+  if (refresh_row_ < refresh_end_ ||
+      first_row_ + static_cast<int>(styles_.size()) < num_rows) {
+    PostEvaluateTask();
+  }
+}
+
+void RowHighlighter::EvaluateRange(size_t thread,
+                                   size_t first_rule,
+                                   int begin,
+                                   int end) {
+  std::vector<int> candidates;
+  for (int row = begin; row < end; ++row) {
+    if (styles_[row - first_row_] == kNoStyle)
+      candidates.push_back(row);
+  }
+
+  // Each rule takes the rows the rules before it left.
+  const LogStore* store = view_->GetLogStore();
+  ScopedVector<FilterProgram>& programs = thread_programs_[thread]->programs;
+  std::vector<int> matches;
+  std::vector<int> rest;
+  for (size_t rule = first_rule;
+       rule < rules_.size() && !candidates.empty(); ++rule) {
+    matches.clear();
+    programs[rule]->Run(view_, store, &candidates[0], 0,
+                        static_cast<int>(candidates.size()), &matches);
+    if (matches.empty())
+      continue;
+
+    for (size_t i = 0; i < matches.size(); ++i)
+      styles_[matches[i] - first_row_] = static_cast<StyleId>(rule + 1);
+
+    rest.clear();
+    std::set_difference(candidates.begin(), candidates.end(),
+                        matches.begin(), matches.end(),
+                        std::back_inserter(rest));
+    candidates.swap(rest);
+  }
+}
+
+// static
+void RowHighlighter::EvaluateRangeTask(RowHighlighter* highlighter,
+                                       size_t thread,
+                                       size_t first_rule,
+                                       int begin,
+                                       int end) {
+  highlighter->EvaluateRange(thread, first_rule, begin, end);
+}
@@ -0,0 +1,161 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Row highlighter declaration.
+#ifndef SAWBUCK_VIEWER_ROW_HIGHLIGHTER_H_
+#define SAWBUCK_VIEWER_ROW_HIGHLIGHTER_H_
+
+#include <windows.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/cancelable_callback.h"
+#include "base/memory/scoped_vector.h"
+#include "sawbuck/viewer/filter.h"
+#include "sawbuck/viewer/filter_program.h"
+
+class ILogView;
+
+// A highlighting rule, which styles the rows its filter passes. A rule
+// with an exclusion filter styles the rows that don't match it.
+struct HighlightRule {
+  // Leaves the look of the rows as it is, for the colors.
+  static const COLORREF kDefaultColor = 0xFF000000;
+
+  HighlightRule(const Filter& filter,
+                COLORREF text_color,
+                COLORREF background_color,
+                bool bold);
+
+  Filter filter;
+  COLORREF text_color;
+  COLORREF background_color;
+  bool bold;
+};
+
+// Sorts the rows of a log view by the highlighting rules they match, into
+// a column of a style per row, which drawing the rows reads rather than
+// evaluate the rules as it goes. A row's style is that of the first rule
+// it matches.
+//
+// The rules are compiled to filter programs, and evaluated in chunks of
+// rows, one chunk per task posted to the current message loop, with each
+// chunk split into row ranges that are evaluated on the shared task pool,
+// as FilterScan does. Only new rows are evaluated as the view grows. When
+// the rules change, the rows matching none of the rules kept as they were
+// are evaluated against the rules past those, so changing the look of a
+// rule, or adding one, costs little.
+// @note the view is read concurrently from the pool's threads, only while
+//    a chunk is evaluated, see FilteredLogView.
+class RowHighlighter {
+ public:
+  // Called with the rows [begin, end) whose styles may have changed.
+  typedef base::Callback<void(int begin, int end)> RestyledCallback;
+
+  // A row's style, which is one past the index of its rule.
+  typedef uint8 StyleId;
+  // The style of rows that match no rule, or aren't evaluated yet.
+  static const StyleId kNoStyle = 0;
+  // The most rules that apply, the rest are ignored.
+  static const size_t kMaxRules = 254;
+
+  // @param restyled is called with the rows restyled.
+  explicit RowHighlighter(const RestyledCallback& restyled);
+  ~RowHighlighter();
+
+  // Sets the view to highlight the rows of, which must outlive us or be
+  // replaced, or NULL for none. Its rows are all evaluated afresh.
+  void SetView(ILogView* view);
+
+  // Sets the rules, and schedules the rows they restyle to be evaluated.
+  void SetRules(const std::vector<HighlightRule>& rules);
+  const std::vector<HighlightRule>& rules() const { return rules_; }
+
+  // @returns the style of @p row.
+  StyleId GetStyle(int row) const;
+  // @returns the rule of @p style, or NULL for kNoStyle.
+  const HighlightRule* GetRule(StyleId style) const;
+
+  // Tell of changes to the view, which the highlighter doesn't listen to
+  // itself, as its client has them first.
+  // @{
+  void OnRowsAdded();
+  void OnRowsEvicted(int first_row);
+  void OnRowsCleared();
+  // @}
+
+  // @returns true iff rows are waiting to be evaluated.
+  bool is_evaluating() const { return !task_.IsCancelled(); }
+
+  // Rules are stored as a list of filters, each with its style alongside.
+  // @{
+  static std::string SerializeRules(const std::vector<HighlightRule>& rules);
+  static std::vector<HighlightRule> DeserializeRules(
+      const std::string& stored);
+  // @}
+
+  // For testing.
+  void set_max_threads(size_t max_threads) { max_threads_ = max_threads; }
+
+ private:
+  // The programs a thread evaluates the rules with, as programs cache
+  // match state.
+  struct ThreadPrograms {
+    ScopedVector<FilterProgram> programs;
+  };
+
+  // Makes sure there are programs for @p num_threads threads.
+  void PreparePrograms(size_t num_threads);
+
+  void PostEvaluateTask();
+  void EvaluateChunk();
+
+  // Evaluates the rules from @p first_rule on against the rows in
+  // [@p begin, @p end) without a style, with the programs of @p thread.
+  void EvaluateRange(size_t thread, size_t first_rule, int begin, int end);
+  // As above, as a task of the pool.
+  static void EvaluateRangeTask(RowHighlighter* highlighter,
+                                size_t thread,
+                                size_t first_rule,
+                                int begin,
+                                int end);
+
+  RestyledCallback restyled_;
+  ILogView* view_;
+  std::vector<HighlightRule> rules_;
+
+  // The programs for each thread, one per rule.
+  ScopedVector<ThreadPrograms> thread_programs_;
+
+  // The style of each row evaluated, from first_row_ on.
+  std::deque<StyleId> styles_;
+  int first_row_;
+
+  // The rows [refresh_row_, refresh_end_) are left to evaluate against the
+  // rules from refresh_rule_ on, after the rules changed.
+  int refresh_row_;
+  int refresh_end_;
+  size_t refresh_rule_;
+
+  // The maximum number of threads evaluating a chunk, including our own.
+  size_t max_threads_;
+
+  base::CancelableClosure task_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowHighlighter);
+};
+
+#endif  // SAWBUCK_VIEWER_ROW_HIGHLIGHTER_H_
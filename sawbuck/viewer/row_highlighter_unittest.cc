@@ -0,0 +1,208 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Row highlighter unittests.
+#include "sawbuck/viewer/row_highlighter.h"
+
+#include "base/bind.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/log_list_view.h"
+#include "sawbuck/viewer/test_log_view.h"
+
+namespace {
+
+using testing::TestLogView;
+
+HighlightRule ProcessRule(const wchar_t* pid, COLORREF color) {
+  return HighlightRule(
+      Filter(Filter::PROCESS_ID, Filter::IS, Filter::INCLUDE, pid),
+      color, HighlightRule::kDefaultColor, false);
+}
+
+HighlightRule ThreadRule(const wchar_t* tid, bool bold) {
+  return HighlightRule(
+      Filter(Filter::THREAD_ID, Filter::IS, Filter::INCLUDE, tid),
+      HighlightRule::kDefaultColor, HighlightRule::kDefaultColor, bold);
+}
+
+class RowHighlighterTest : public testing::Test {
+ public:
+  RowHighlighterTest()
+      : highlighter_(base::Bind(&RowHighlighterTest::OnRestyled,
+                                base::Unretained(this))),
+        restyled_end_(0) {
+  }
+
+  virtual void SetUp() {
+    highlighter_.set_max_threads(4);
+    highlighter_.SetView(&view_);
+  }
+
+  void OnRestyled(int begin, int end) {
+    restyled_end_ = std::max(restyled_end_, end);
+  }
+
+  void RunMessageLoopToIdle() {
+    base::RunLoop run_loop;
+    run_loop.RunUntilIdle();
+    EXPECT_FALSE(highlighter_.is_evaluating());
+  }
+
+  // Expects each row to have the style of the first of the process rule
+  // for pid 1, or the thread rule for tid 2, it matches, in @p order.
+  void ExpectStyles(bool process_first) {
+    for (int row = view_.GetFirstRow(); row < view_.GetNumRows(); ++row) {
+      RowHighlighter::StyleId process_style = process_first ? 1 : 2;
+      RowHighlighter::StyleId thread_style = process_first ? 2 : 1;
+      RowHighlighter::StyleId expected = RowHighlighter::kNoStyle;
+      bool process = row % 3 == 1;
+      bool thread = row % 5 == 2;
+      if (process && (process_first || !thread))
+        expected = process_style;
+      else if (thread)
+        expected = thread_style;
+      ASSERT_EQ(expected, highlighter_.GetStyle(row)) << "row " << row;
+    }
+  }
+
+ protected:
+  base::MessageLoop message_loop_;
+  TestLogView view_;
+  RowHighlighter highlighter_;
+  int restyled_end_;
+};
+
+TEST_F(RowHighlighterTest, StylesRowsByFirstRule) {
+  view_.AddRows(10000);
+  std::vector<HighlightRule> rules;
+  rules.push_back(ProcessRule(L"1", RGB(255, 0, 0)));
+  rules.push_back(ThreadRule(L"2", true));
+  highlighter_.SetRules(rules);
+  EXPECT_TRUE(highlighter_.is_evaluating());
+  RunMessageLoopToIdle();
+
+  ExpectStyles(true);
+  EXPECT_EQ(10000, restyled_end_);
+  EXPECT_EQ(RGB(255, 0, 0), highlighter_.GetRule(1)->text_color);
+  EXPECT_TRUE(highlighter_.GetRule(2)->bold);
+  EXPECT_TRUE(highlighter_.GetRule(RowHighlighter::kNoStyle) == NULL);
+
+  // Only the new rows are evaluated as the view grows.
+  view_.AddRows(5000);
+  highlighter_.OnRowsAdded();
+  RunMessageLoopToIdle();
+  ExpectStyles(true);
+  EXPECT_EQ(15000, restyled_end_);
+}
+
+TEST_F(RowHighlighterTest, ReevaluatesChangedRules) {
+  view_.AddRows(5000);
+  std::vector<HighlightRule> rules;
+  rules.push_back(ProcessRule(L"1", RGB(255, 0, 0)));
+  highlighter_.SetRules(rules);
+  RunMessageLoopToIdle();
+
+  // An added rule styles the rows the first left.
+  rules.push_back(ThreadRule(L"2", true));
+  highlighter_.SetRules(rules);
+  RunMessageLoopToIdle();
+  ExpectStyles(true);
+
+  // A change of look keeps the styles, and changes the rule.
+  rules[0].text_color = RGB(0, 0, 255);
+  highlighter_.SetRules(rules);
+  EXPECT_FALSE(highlighter_.is_evaluating());
+  ExpectStyles(true);
+  EXPECT_EQ(RGB(0, 0, 255), highlighter_.GetRule(1)->text_color);
+
+  // Reordering the rules evaluates the rows anew.
+  std::swap(rules[0], rules[1]);
+  highlighter_.SetRules(rules);
+  RunMessageLoopToIdle();
+  ExpectStyles(false);
+
+  // And without rules nothing's styled.
+  highlighter_.SetRules(std::vector<HighlightRule>());
+  EXPECT_FALSE(highlighter_.is_evaluating());
+  EXPECT_EQ(RowHighlighter::kNoStyle, highlighter_.GetStyle(1));
+}
+
+TEST_F(RowHighlighterTest, ExclusionRules) {
+  view_.AddRows(100);
+  std::vector<HighlightRule> rules;
+  rules.push_back(HighlightRule(
+      Filter(Filter::PROCESS_ID, Filter::IS, Filter::EXCLUDE, L"1"),
+      HighlightRule::kDefaultColor, RGB(0, 255, 0), false));
+  highlighter_.SetRules(rules);
+  RunMessageLoopToIdle();
+
+  for (int row = 0; row < 100; ++row) {
+    EXPECT_EQ(row % 3 == 1 ? RowHighlighter::kNoStyle : 1,
+              highlighter_.GetStyle(row));
+  }
+}
+
+TEST_F(RowHighlighterTest, EvictionAndClearing) {
+  view_.AddRows(1000);
+  std::vector<HighlightRule> rules;
+  rules.push_back(ProcessRule(L"1", RGB(255, 0, 0)));
+  highlighter_.SetRules(rules);
+  RunMessageLoopToIdle();
+
+  view_.set_first_row(600);
+  highlighter_.OnRowsEvicted(600);
+  EXPECT_EQ(RowHighlighter::kNoStyle, highlighter_.GetStyle(1));
+  EXPECT_EQ(1, highlighter_.GetStyle(601));
+  view_.AddRows(1000);
+  highlighter_.OnRowsAdded();
+  RunMessageLoopToIdle();
+  for (int row = 600; row < 2000; ++row) {
+    ASSERT_EQ(row % 3 == 1 ? 1 : RowHighlighter::kNoStyle,
+              highlighter_.GetStyle(row));
+  }
+
+  view_.set_first_row(2000);
+  highlighter_.OnRowsCleared();
+  EXPECT_EQ(RowHighlighter::kNoStyle, highlighter_.GetStyle(1999));
+  view_.AddRows(10);
+  highlighter_.OnRowsAdded();
+  RunMessageLoopToIdle();
+  EXPECT_EQ(1, highlighter_.GetStyle(2002));
+}
+
+TEST_F(RowHighlighterTest, Serialization) {
+  std::vector<HighlightRule> rules;
+  rules.push_back(ProcessRule(L"1", RGB(255, 0, 0)));
+  rules.push_back(HighlightRule(
+      Filter(Filter::MESSAGE, Filter::CONTAINS, Filter::INCLUDE,
+             L"net::ERR"),
+      RGB(255, 0, 0), RGB(255, 255, 0), true));
+
+  std::vector<HighlightRule> deserialized = RowHighlighter::DeserializeRules(
+      RowHighlighter::SerializeRules(rules));
+  ASSERT_EQ(rules.size(), deserialized.size());
+  for (size_t i = 0; i < rules.size(); ++i) {
+    EXPECT_TRUE(rules[i].filter == deserialized[i].filter);
+    EXPECT_EQ(rules[i].text_color, deserialized[i].text_color);
+    EXPECT_EQ(rules[i].background_color, deserialized[i].background_color);
+    EXPECT_EQ(rules[i].bold, deserialized[i].bold);
+  }
+
+  EXPECT_TRUE(RowHighlighter::DeserializeRules("").empty());
+  EXPECT_TRUE(RowHighlighter::DeserializeRules("{").empty());
+}
+
+}  // namespace
@@ -0,0 +1,186 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Keyed row posting index implementation.
+#include "sawbuck/viewer/row_posting_index.h"
+
+#include <algorithm>
+#include "base/logging.h"
+#include "sawbuck/common/memory_footprint.h"
+
+namespace {
+
+// The number of postings between checkpoints.
+const uint32 kCheckpointInterval = 64;
+
+}  // namespace
+
+bool RowPostingIndex::Checkpoint::RowLess(int32 row,
+                                          const Checkpoint& checkpoint) {
+  return row < checkpoint.row;
+}
+
+RowPostingIndex::PostingList::PostingList() : last_row(-1), num_postings(0) {
+}
+
+RowPostingIndex::RowPostingIndex()
+    : last_key_(0), last_list_(NULL), num_rows_(0), first_row_(0) {
+}
+
+RowPostingIndex::~RowPostingIndex() {
+}
+
+void RowPostingIndex::AddRow(uint32 key) {
+  if (last_list_ == NULL || last_key_ != key) {
+    last_key_ = key;
+    last_list_ = &lists_[key];
+  }
+
+  PostingList& list = *last_list_;
+  int32 row = num_rows_++;
+  if (list.num_postings % kCheckpointInterval == 0) {
+    Checkpoint checkpoint = {
+      static_cast<uint32>(list.data.size()), list.last_row
+    };
+    list.checkpoints.push_back(checkpoint);
+  }
+
+  uint32 delta = row - list.last_row;
+  while (delta >= 0x80) {
+    list.data.push_back(static_cast<uint8>(delta | 0x80));
+    delta >>= 7;
+  }
+  list.data.push_back(static_cast<uint8>(delta));
+
+  list.last_row = row;
+  ++list.num_postings;
+}
+
+void RowPostingIndex::Clear() {
+  lists_.clear();
+  last_list_ = NULL;
+  num_rows_ = 0;
+  first_row_ = 0;
+}
+
+void RowPostingIndex::EvictRowsBefore(int row) {
+  if (row <= first_row_)
+    return;
+
+  first_row_ = row;
+  num_rows_ = std::max(num_rows_, row);
+
+  PostingMap::iterator it = lists_.begin();
+  while (it != lists_.end()) {
+    PostingList& list = it->second;
+    if (list.last_row < row) {
+      if (last_list_ == &list)
+        last_list_ = NULL;
+      lists_.erase(it++);
+      continue;
+    }
+
+    // The postings past a checkpoint are all for rows past its row, so
+    // everything before the last checkpoint short of the first row can go.
+    // That checkpoint then stands in as the start of the list.
+    std::vector<Checkpoint>::iterator checkpoint =
+        std::upper_bound(list.checkpoints.begin(), list.checkpoints.end(),
+                         row - 1, Checkpoint::RowLess);
+    DCHECK(checkpoint != list.checkpoints.begin());
+    --checkpoint;
+
+    size_t dropped = checkpoint - list.checkpoints.begin();
+    if (dropped != 0) {
+      uint32 offset = checkpoint->offset;
+      list.data.erase(list.data.begin(), list.data.begin() + offset);
+      list.checkpoints.erase(list.checkpoints.begin(), checkpoint);
+      for (size_t i = 0; i < list.checkpoints.size(); ++i)
+        list.checkpoints[i].offset -= offset;
+      list.num_postings -= dropped * kCheckpointInterval;
+    }
+    ++it;
+  }
+}
+
+void RowPostingIndex::GetKeys(std::vector<uint32>* keys) const {
+  DCHECK(keys != NULL);
+  keys->clear();
+  PostingMap::const_iterator it = lists_.begin();
+  for (; it != lists_.end(); ++it)
+    keys->push_back(it->first);
+}
+
+int RowPostingIndex::GetLastRow(uint32 key) const {
+  PostingMap::const_iterator it = lists_.find(key);
+  if (it == lists_.end())
+    return -1;
+  return it->second.last_row;
+}
+
+void RowPostingIndex::GetRows(uint32 key,
+                              int begin,
+                              int end,
+                              std::vector<int>* rows) const {
+  DCHECK(rows != NULL);
+  begin = std::max(begin, first_row_);
+  end = std::min(end, num_rows_);
+  PostingMap::const_iterator it = lists_.find(key);
+  if (begin >= end || it == lists_.end())
+    return;
+
+  const PostingList& list = it->second;
+  if (list.last_row < begin)
+    return;
+
+  // Start at the last checkpoint before begin.
+  std::vector<Checkpoint>::const_iterator checkpoint =
+      std::upper_bound(list.checkpoints.begin(), list.checkpoints.end(),
+                       begin - 1, Checkpoint::RowLess);
+  if (checkpoint == list.checkpoints.begin())
+    return;
+  --checkpoint;
+
+  const uint8* data = &list.data[0];
+  size_t size = list.data.size();
+  size_t offset = checkpoint->offset;
+  int32 row = checkpoint->row;
+  while (offset < size) {
+    uint32 delta = 0;
+    int shift = 0;
+    uint8 byte = 0;
+    do {
+      DCHECK_LT(offset, size);
+      byte = data[offset++];
+      delta |= static_cast<uint32>(byte & 0x7F) << shift;
+      shift += 7;
+    } while ((byte & 0x80) != 0);
+
+    row += delta;
+    if (row >= end)
+      break;
+    if (row >= begin)
+      rows->push_back(row);
+  }
+}
+
+size_t RowPostingIndex::GetMemoryUsage() const {
+  size_t usage = 0;
+  PostingMap::const_iterator it = lists_.begin();
+  for (; it != lists_.end(); ++it) {
+    usage += TreeNodeFootprint<PostingMap>();
+    usage += it->second.data.capacity();
+    usage += it->second.checkpoints.capacity() * sizeof(Checkpoint);
+  }
+  return usage;
+}
@@ -0,0 +1,105 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Keyed row posting index declaration.
+#ifndef SAWBUCK_VIEWER_ROW_POSTING_INDEX_H_
+#define SAWBUCK_VIEWER_ROW_POSTING_INDEX_H_
+
+#include <map>
+#include <vector>
+#include "base/basictypes.h"
+
+// An incrementally built index from a small integer key of each row, e.g.
+// its severity or process id, to the rows with that key. Filters that only
+// test such keys can then get their rows from the posting lists of the keys
+// that pass, rather than test every row.
+//
+// Unlike TrigramIndex, each posting is an exact row, the rows of a key are
+// delta encoded as varints, with a checkpoint every kCheckpointInterval
+// postings to skip into the list from.
+// @note an index takes no lock. Its store adds and evicts rows on the
+//     store's thread, and the filter programs look rows up on the task
+//     pool only while that thread waits on them, as lookups don't write.
+class RowPostingIndex {
+ public:
+  RowPostingIndex();
+  ~RowPostingIndex();
+
+  // Indexes the next row under @p key.
+  void AddRow(uint32 key);
+
+  // Removes all rows and releases the index storage.
+  void Clear();
+
+  // Drops the rows before @p row, which keep their numbers. Rows are
+  // dropped from a list by whole checkpoints, and keys whose rows are all
+  // dropped go with them. If @p row is past the rows indexed, the rows up
+  // to it are skipped.
+  void EvictRowsBefore(int row);
+
+  // Retrieves the keys of the rows retained to @p keys, in ascending order.
+  void GetKeys(std::vector<uint32>* keys) const;
+
+  // @returns the last row indexed under @p key, or -1 if there's none.
+  //     This is a row retained if any row of @p key is.
+  int GetLastRow(uint32 key) const;
+
+  // Appends the rows of @p key in [@p begin, @p end) to @p rows, in
+  // ascending order.
+  void GetRows(uint32 key, int begin, int end, std::vector<int>* rows) const;
+
+  // @returns the number of rows indexed, including those dropped.
+  int num_rows() const { return num_rows_; }
+
+  // @returns the first row not dropped.
+  int first_row() const { return first_row_; }
+
+  // @returns an estimate of the heap memory used by the index.
+  size_t GetMemoryUsage() const;
+
+ private:
+  // Allows skipping into a posting list. The postings from offset on
+  // are all for rows past row.
+  struct Checkpoint {
+    // Orders checkpoints by row for std::upper_bound.
+    static bool RowLess(int32 row, const Checkpoint& checkpoint);
+
+    uint32 offset;
+    int32 row;
+  };
+
+  struct PostingList {
+    PostingList();
+
+    // The varint encoded deltas between successive rows.
+    std::vector<uint8> data;
+    // A checkpoint for every kCheckpointInterval postings.
+    std::vector<Checkpoint> checkpoints;
+    // The last row added, or -1.
+    int32 last_row;
+    uint32 num_postings;
+  };
+  typedef std::map<uint32, PostingList> PostingMap;
+
+  PostingMap lists_;
+  // The list of the last row's key, as runs of rows commonly share a key.
+  uint32 last_key_;
+  PostingList* last_list_;
+  int num_rows_;
+  int first_row_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowPostingIndex);
+};
+
+#endif  // SAWBUCK_VIEWER_ROW_POSTING_INDEX_H_
@@ -0,0 +1,166 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/row_posting_index.h"
+
+#include <algorithm>
+#include "gtest/gtest.h"
+
+namespace {
+
+const int kNumRows = 5000;
+
+class RowPostingIndexTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    // Rows come in runs of a key, with the occasional rare key, and the
+    // keys far apart are large enough to take several varint bytes.
+    for (int i = 0; i < kNumRows; ++i) {
+      if (i % 1000 == 999)
+        AddRow(0xFFFFFFFF);
+      else if (i % 100 == 7)
+        AddRow(4);
+      else
+        AddRow(i / 10 % 3);
+    }
+  }
+
+  void AddRow(uint32 key) {
+    keys_.push_back(key);
+    index_.AddRow(key);
+  }
+
+  // Checks that the rows of @p key in [@p begin, @p end) are exactly those
+  // we added.
+  void ExpectRows(uint32 key, int begin, int end) {
+    std::vector<int> expected;
+    int first = std::max(begin, index_.first_row());
+    int last = std::min(end, static_cast<int>(keys_.size()));
+    for (int row = first; row < last; ++row) {
+      if (keys_[row] == key)
+        expected.push_back(row);
+    }
+
+    std::vector<int> rows;
+    index_.GetRows(key, begin, end, &rows);
+    EXPECT_EQ(expected, rows) << "key " << key;
+  }
+
+ protected:
+  std::vector<uint32> keys_;
+  RowPostingIndex index_;
+};
+
+TEST_F(RowPostingIndexTest, Empty) {
+  RowPostingIndex index;
+  EXPECT_EQ(0, index.num_rows());
+  EXPECT_EQ(-1, index.GetLastRow(0));
+
+  std::vector<uint32> keys(1, 1);
+  index.GetKeys(&keys);
+  EXPECT_TRUE(keys.empty());
+
+  std::vector<int> rows;
+  index.GetRows(0, 0, 100, &rows);
+  EXPECT_TRUE(rows.empty());
+}
+
+TEST_F(RowPostingIndexTest, GetRows) {
+  EXPECT_EQ(kNumRows, index_.num_rows());
+
+  std::vector<uint32> keys;
+  index_.GetKeys(&keys);
+  ASSERT_EQ(5U, keys.size());
+  EXPECT_EQ(0U, keys[0]);
+  EXPECT_EQ(4U, keys[3]);
+  EXPECT_EQ(0xFFFFFFFF, keys[4]);
+
+  EXPECT_EQ(4999, index_.GetLastRow(0xFFFFFFFF));
+  EXPECT_EQ(4907, index_.GetLastRow(4));
+  EXPECT_EQ(-1, index_.GetLastRow(3));
+
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ExpectRows(keys[i], 0, kNumRows);
+    ExpectRows(keys[i], 1234, 4321);
+    ExpectRows(keys[i], 4990, kNumRows + 10);
+    ExpectRows(keys[i], 100, 100);
+  }
+  ExpectRows(3, 0, kNumRows);
+
+  // The rows are appended.
+  std::vector<int> rows(1, -1);
+  index_.GetRows(4, 0, 200, &rows);
+  ASSERT_EQ(3U, rows.size());
+  EXPECT_EQ(-1, rows[0]);
+  EXPECT_EQ(7, rows[1]);
+  EXPECT_EQ(107, rows[2]);
+}
+
+TEST_F(RowPostingIndexTest, EvictRows) {
+  const int kFirstRow = 3000;
+  index_.EvictRowsBefore(kFirstRow);
+  EXPECT_EQ(kFirstRow, index_.first_row());
+  EXPECT_EQ(kNumRows, index_.num_rows());
+
+  // The evicted rows are out of every list.
+  for (uint32 key = 0; key < 5; ++key) {
+    ExpectRows(key, 0, kNumRows);
+    ExpectRows(key, kFirstRow + 10, kNumRows);
+  }
+  ExpectRows(0xFFFFFFFF, 0, kNumRows);
+
+  // Evicting again, or less, is fine.
+  index_.EvictRowsBefore(kFirstRow - 1000);
+  EXPECT_EQ(kFirstRow, index_.first_row());
+
+  // Keys whose rows are all evicted are gone.
+  index_.EvictRowsBefore(4950);
+  std::vector<uint32> keys;
+  index_.GetKeys(&keys);
+  EXPECT_EQ(4U, keys.size());
+  EXPECT_EQ(-1, index_.GetLastRow(4));
+  ExpectRows(0, 4950, kNumRows);
+
+  // New rows carry on from the last.
+  AddRow(4);
+  ExpectRows(4, 0, index_.num_rows());
+  EXPECT_EQ(kNumRows, index_.GetLastRow(4));
+}
+
+TEST_F(RowPostingIndexTest, EvictPastRows) {
+  RowPostingIndex index;
+  index.EvictRowsBefore(100);
+  EXPECT_EQ(100, index.num_rows());
+
+  index.AddRow(7);
+  std::vector<int> rows;
+  index.GetRows(7, 0, 200, &rows);
+  ASSERT_EQ(1U, rows.size());
+  EXPECT_EQ(100, rows[0]);
+}
+
+TEST_F(RowPostingIndexTest, Clear) {
+  size_t memory = index_.GetMemoryUsage();
+  EXPECT_LT(0U, memory);
+
+  index_.Clear();
+  EXPECT_EQ(0, index_.num_rows());
+  EXPECT_GT(memory, index_.GetMemoryUsage());
+
+  keys_.clear();
+  AddRow(2);
+  AddRow(2);
+  ExpectRows(2, 0, 2);
+}
+
+}  // namespace
@@ -0,0 +1,388 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Compressed row set implementation.
+#include "sawbuck/viewer/row_set.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+const int kChunkShift = 16;
+const int kLowMask = (1 << kChunkShift) - 1;
+
+const int kBitsPerWordShift = 5;
+const int kBitMask = (1 << kBitsPerWordShift) - 1;
+const size_t kWordsPerChunk = RowSet::kRowsPerChunk >> kBitsPerWordShift;
+// The words per block of a bitmap chunk, each of which has its count.
+const size_t kWordsPerBlock = 64;
+const size_t kBlocksPerChunk = kWordsPerChunk / kWordsPerBlock;
+
+// @returns the index of the lowest set bit of a non-zero @p word.
+int LowestBit(uint32 word) {
+  DCHECK_NE(0U, word);
+  int bit = 0;
+  if ((word & 0xFFFF) == 0) {
+    bit += 16;
+    word >>= 16;
+  }
+  if ((word & 0xFF) == 0) {
+    bit += 8;
+    word >>= 8;
+  }
+  if ((word & 0xF) == 0) {
+    bit += 4;
+    word >>= 4;
+  }
+  if ((word & 0x3) == 0) {
+    bit += 2;
+    word >>= 2;
+  }
+  if ((word & 0x1) == 0)
+    bit += 1;
+  return bit;
+}
+
+int PopCount(uint32 word) {
+  word = word - ((word >> 1) & 0x55555555);
+  word = (word & 0x33333333) + ((word >> 2) & 0x33333333);
+  word = (word + (word >> 4)) & 0x0F0F0F0F;
+  return static_cast<int>((word * 0x01010101) >> 24);
+}
+
+}  // namespace
+
+const int RowSet::kRowsPerChunk;
+const size_t RowSet::kMaxArrayRows;
+
+RowSet::Chunk::Chunk(int key) : key(key), count(0) {
+}
+
+void RowSet::Chunk::Append(uint16 low) {
+  ++count;
+  if (is_bitmap()) {
+    size_t word = low >> kBitsPerWordShift;
+    bits[word] |= 1U << (low & kBitMask);
+    ++block_counts[word / kWordsPerBlock];
+    return;
+  }
+
+  DCHECK(array.empty() || array.back() < low);
+  array.push_back(low);
+  if (array.size() > kMaxArrayRows)
+    ConvertToBitmap();
+}
+
+void RowSet::Chunk::ConvertToBitmap() {
+  DCHECK(!is_bitmap());
+  bits.assign(kWordsPerChunk, 0);
+  block_counts.assign(kBlocksPerChunk, 0);
+  for (size_t i = 0; i < array.size(); ++i) {
+    size_t word = array[i] >> kBitsPerWordShift;
+    bits[word] |= 1U << (array[i] & kBitMask);
+    ++block_counts[word / kWordsPerBlock];
+  }
+  std::vector<uint16>().swap(array);
+}
+
+void RowSet::Chunk::SetBits(const std::vector<uint32>& words) {
+  DCHECK_EQ(kWordsPerChunk, words.size());
+  count = 0;
+  for (size_t i = 0; i < words.size(); ++i)
+    count += PopCount(words[i]);
+
+  if (static_cast<size_t>(count) > kMaxArrayRows) {
+    bits = words;
+    block_counts.assign(kBlocksPerChunk, 0);
+    for (size_t i = 0; i < words.size(); ++i)
+      block_counts[i / kWordsPerBlock] += PopCount(words[i]);
+    std::vector<uint16>().swap(array);
+    return;
+  }
+
+  array.clear();
+  for (size_t i = 0; i < words.size(); ++i) {
+    uint32 word = words[i];
+    while (word != 0) {
+      array.push_back(static_cast<uint16>(
+          (i << kBitsPerWordShift) | LowestBit(word)));
+      word &= word - 1;
+    }
+  }
+  std::vector<uint32>().swap(bits);
+  std::vector<uint16>().swap(block_counts);
+}
+
+void RowSet::Chunk::GetBits(std::vector<uint32>* words) const {
+  DCHECK(words != NULL);
+  if (is_bitmap()) {
+    *words = bits;
+    return;
+  }
+
+  words->assign(kWordsPerChunk, 0);
+  for (size_t i = 0; i < array.size(); ++i)
+    (*words)[array[i] >> kBitsPerWordShift] |= 1U << (array[i] & kBitMask);
+}
+
+int RowSet::Chunk::Rank(uint16 low) const {
+  if (!is_bitmap())
+    return std::lower_bound(array.begin(), array.end(), low) - array.begin();
+
+  size_t word = low >> kBitsPerWordShift;
+  size_t block = word / kWordsPerBlock;
+  int rank = 0;
+  for (size_t i = 0; i < block; ++i)
+    rank += block_counts[i];
+  for (size_t i = block * kWordsPerBlock; i < word; ++i)
+    rank += PopCount(bits[i]);
+  return rank + PopCount(bits[word] & ((1U << (low & kBitMask)) - 1));
+}
+
+uint16 RowSet::Chunk::Select(int index) const {
+  DCHECK_LE(0, index);
+  DCHECK_LT(index, count);
+  if (!is_bitmap())
+    return array[index];
+
+  size_t block = 0;
+  while (index >= block_counts[block])
+    index -= block_counts[block++];
+
+  size_t word = block * kWordsPerBlock;
+  while (index >= PopCount(bits[word]))
+    index -= PopCount(bits[word++]);
+
+  uint32 word_bits = bits[word];
+  for (; index > 0; --index)
+    word_bits &= word_bits - 1;
+  return static_cast<uint16>((word << kBitsPerWordShift) |
+                             LowestBit(word_bits));
+}
+
+bool RowSet::Chunk::Contains(uint16 low) const {
+  if (!is_bitmap())
+    return std::binary_search(array.begin(), array.end(), low);
+  return (bits[low >> kBitsPerWordShift] & (1U << (low & kBitMask))) != 0;
+}
+
+RowSet::RowSet() : size_(0) {
+}
+
+RowSet::~RowSet() {
+}
+
+void RowSet::Append(int row) {
+  DCHECK_LE(0, row);
+  int key = row >> kChunkShift;
+  if (chunks_.empty() || chunks_.back().key != key) {
+    DCHECK(chunks_.empty() || chunks_.back().key < key);
+    chunks_.push_back(Chunk(key));
+    chunk_starts_.push_back(size_);
+  }
+  chunks_.back().Append(static_cast<uint16>(row & kLowMask));
+  ++size_;
+}
+
+void RowSet::AppendRows(std::vector<int>::const_iterator begin,
+                        std::vector<int>::const_iterator end) {
+  for (; begin != end; ++begin)
+    Append(*begin);
+}
+
+void RowSet::Clear() {
+  std::deque<Chunk>().swap(chunks_);
+  std::vector<int>().swap(chunk_starts_);
+  size_ = 0;
+}
+
+void RowSet::EraseBefore(int row) {
+  int key = row >> kChunkShift;
+  while (!chunks_.empty() && chunks_.front().key < key)
+    chunks_.pop_front();
+
+  if (!chunks_.empty() && chunks_.front().key == key && row > 0) {
+    Chunk& chunk = chunks_.front();
+    uint16 low = static_cast<uint16>(row & kLowMask);
+    if (chunk.is_bitmap()) {
+      std::vector<uint32> words(chunk.bits);
+      size_t word = low >> kBitsPerWordShift;
+      std::fill(words.begin(), words.begin() + word, 0);
+      words[word] &= ~0U << (low & kBitMask);
+      chunk.SetBits(words);
+    } else {
+      chunk.array.erase(chunk.array.begin(),
+                        std::lower_bound(chunk.array.begin(),
+                                         chunk.array.end(), low));
+      chunk.count = static_cast<int>(chunk.array.size());
+    }
+    if (chunk.count == 0)
+      chunks_.pop_front();
+  }
+
+  UpdateStarts();
+}
+
+bool RowSet::Contains(int row) const {
+  if (row < 0)
+    return false;
+
+  int key = row >> kChunkShift;
+  size_t chunk = FindChunk(key);
+  return chunk < chunks_.size() && chunks_[chunk].key == key &&
+      chunks_[chunk].Contains(static_cast<uint16>(row & kLowMask));
+}
+
+int RowSet::Rank(int row) const {
+  if (row <= 0)
+    return 0;
+
+  int key = row >> kChunkShift;
+  size_t chunk = FindChunk(key);
+  if (chunk == chunks_.size())
+    return size_;
+  if (chunks_[chunk].key != key)
+    return chunk_starts_[chunk];
+  return chunk_starts_[chunk] +
+      chunks_[chunk].Rank(static_cast<uint16>(row & kLowMask));
+}
+
+int RowSet::Select(int index) const {
+  DCHECK_LE(0, index);
+  DCHECK_LT(index, size_);
+  size_t chunk = std::upper_bound(chunk_starts_.begin(), chunk_starts_.end(),
+                                  index) - chunk_starts_.begin() - 1;
+  return (chunks_[chunk].key << kChunkShift) |
+      chunks_[chunk].Select(index - chunk_starts_[chunk]);
+}
+
+void RowSet::GetRows(std::vector<int>* rows) const {
+  DCHECK(rows != NULL);
+  rows->reserve(rows->size() + size_);
+  for (size_t i = 0; i < chunks_.size(); ++i) {
+    const Chunk& chunk = chunks_[i];
+    int base = chunk.key << kChunkShift;
+    if (!chunk.is_bitmap()) {
+      for (size_t j = 0; j < chunk.array.size(); ++j)
+        rows->push_back(base | chunk.array[j]);
+      continue;
+    }
+
+    for (size_t j = 0; j < chunk.bits.size(); ++j) {
+      uint32 word = chunk.bits[j];
+      while (word != 0) {
+        rows->push_back(base | (j << kBitsPerWordShift) | LowestBit(word));
+        word &= word - 1;
+      }
+    }
+  }
+}
+
+void RowSet::IntersectWith(const RowSet& other) {
+  Combine(other, INTERSECT);
+}
+
+void RowSet::UnionWith(const RowSet& other) {
+  Combine(other, UNION);
+}
+
+void RowSet::Subtract(const RowSet& other) {
+  Combine(other, SUBTRACT);
+}
+
+size_t RowSet::GetMemoryUsage() const {
+  size_t usage = chunks_.size() * sizeof(Chunk) +
+      chunk_starts_.capacity() * sizeof(chunk_starts_[0]);
+  for (size_t i = 0; i < chunks_.size(); ++i) {
+    const Chunk& chunk = chunks_[i];
+    usage += chunk.array.capacity() * sizeof(chunk.array[0]);
+    usage += chunk.bits.capacity() * sizeof(chunk.bits[0]);
+    usage += chunk.block_counts.capacity() * sizeof(chunk.block_counts[0]);
+  }
+  return usage;
+}
+
+void RowSet::Combine(const RowSet& other, Operation operation) {
+  // Chunks on one side only are kept or dropped whole, those on both sides
+  // are combined a word at a time.
+  std::deque<Chunk> chunks;
+  std::vector<uint32> words;
+  std::vector<uint32> other_words;
+  size_t i = 0;
+  size_t j = 0;
+  while (i < chunks_.size() || j < other.chunks_.size()) {
+    if (j == other.chunks_.size() ||
+        (i < chunks_.size() && chunks_[i].key < other.chunks_[j].key)) {
+      if (operation != INTERSECT)
+        chunks.push_back(chunks_[i]);
+      ++i;
+      continue;
+    }
+    if (i == chunks_.size() || other.chunks_[j].key < chunks_[i].key) {
+      if (operation == UNION)
+        chunks.push_back(other.chunks_[j]);
+      ++j;
+      continue;
+    }
+
+    chunks_[i].GetBits(&words);
+    other.chunks_[j].GetBits(&other_words);
+    for (size_t k = 0; k < words.size(); ++k) {
+      switch (operation) {
+        case INTERSECT:
+          words[k] &= other_words[k];
+          break;
+        case UNION:
+          words[k] |= other_words[k];
+          break;
+        case SUBTRACT:
+          words[k] &= ~other_words[k];
+          break;
+      }
+    }
+
+    Chunk chunk(chunks_[i].key);
+    chunk.SetBits(words);
+    if (chunk.count != 0)
+      chunks.push_back(chunk);
+    ++i;
+    ++j;
+  }
+
+  chunks_.swap(chunks);
+  UpdateStarts();
+}
+
+void RowSet::UpdateStarts() {
+  chunk_starts_.resize(chunks_.size());
+  size_ = 0;
+  for (size_t i = 0; i < chunks_.size(); ++i) {
+    chunk_starts_[i] = size_;
+    size_ += chunks_[i].count;
+  }
+}
+
+size_t RowSet::FindChunk(int key) const {
+  size_t begin = 0;
+  size_t end = chunks_.size();
+  while (begin < end) {
+    size_t middle = begin + (end - begin) / 2;
+    if (chunks_[middle].key < key)
+      begin = middle + 1;
+    else
+      end = middle;
+  }
+  return begin;
+}
@@ -0,0 +1,149 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Compressed row set declaration.
+#ifndef SAWBUCK_VIEWER_ROW_SET_H_
+#define SAWBUCK_VIEWER_ROW_SET_H_
+
+#include <deque>
+#include <vector>
+#include "base/basictypes.h"
+
+// A compressed set of rows that's built in ascending order, as filtered
+// rows are, with rank and select, so a filtered view can map its rows to
+// the original's and back in O(log n).
+//
+// In the manner of roaring bitmaps, the rows are split into chunks of
+// kRowsPerChunk by their high bits. A chunk holds the low bits of its
+// rows as an array of uint16 while it has at most kMaxArrayRows rows, and
+// as a bitmap once it has more, so a sparse set costs two bytes a row and
+// a dense one an eighth of a byte. Bitmap chunks keep the counts of each
+// block of their words, which bounds a select within the chunk.
+// @note a set takes no lock. Its filtered view appends to it and reads it
+//     on the view's own thread, the filtering tasks hand their rows back
+//     to it rather than append them themselves.
+class RowSet {
+ public:
+  // The rows per chunk, and the most rows an array chunk holds.
+  static const int kRowsPerChunk = 1 << 16;
+  static const size_t kMaxArrayRows = 4096;
+
+  RowSet();
+  ~RowSet();
+
+  // Adds @p row to the set, which must be past all rows in the set.
+  void Append(int row);
+  // Adds the rows in [@p begin, @p end), which must be in ascending order
+  // and past all rows in the set.
+  void AppendRows(std::vector<int>::const_iterator begin,
+                  std::vector<int>::const_iterator end);
+
+  // Empties the set and releases its storage.
+  void Clear();
+
+  // Removes the rows before @p row.
+  void EraseBefore(int row);
+
+  // @returns true iff @p row is in the set.
+  bool Contains(int row) const;
+
+  // @returns the number of rows in the set before @p row, which is the
+  //     index of the first row at or past @p row.
+  int Rank(int row) const;
+
+  // @returns the row at @p index in ascending order, in [0, size()).
+  int Select(int index) const;
+
+  // Appends the rows in the set to @p rows, in ascending order.
+  void GetRows(std::vector<int>* rows) const;
+
+  // Replaces the set by its intersection with, union with, or difference
+  // from @p other, a chunk at a time.
+  // @{
+  void IntersectWith(const RowSet& other);
+  void UnionWith(const RowSet& other);
+  void Subtract(const RowSet& other);
+  // @}
+
+  // @returns the number of rows in the set.
+  int size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // @returns the first and the last row in the set, which mustn't be
+  //     empty.
+  int front() const { return Select(0); }
+  int back() const { return Select(size_ - 1); }
+
+  // @returns an estimate of the heap memory used by the set.
+  size_t GetMemoryUsage() const;
+
+ private:
+  enum Operation {
+    INTERSECT,
+    UNION,
+    SUBTRACT,
+  };
+
+  // The rows sharing their high bits.
+  struct Chunk {
+    explicit Chunk(int key);
+
+    bool is_bitmap() const { return !bits.empty(); }
+
+    // Adds the row with @p low bits, past the chunk's rows.
+    void Append(uint16 low);
+    // Switches from an array to a bitmap.
+    void ConvertToBitmap();
+    // Sets the chunk's rows to the bits of @p words, switching to an array
+    // if they're few enough.
+    void SetBits(const std::vector<uint32>& words);
+    // Retrieves the chunk's rows as the bits of @p words.
+    void GetBits(std::vector<uint32>* words) const;
+
+    // @returns the number of rows in the chunk before @p low.
+    int Rank(uint16 low) const;
+    // @returns the low bits of the row at @p index in the chunk.
+    uint16 Select(int index) const;
+    bool Contains(uint16 low) const;
+
+    // The high bits of the chunk's rows, and their number.
+    int key;
+    int count;
+    // The low bits of the rows in ascending order, for an array chunk.
+    std::vector<uint16> array;
+    // A bit per row, and the count of each block of words, for a bitmap
+    // chunk.
+    std::vector<uint32> bits;
+    std::vector<uint16> block_counts;
+  };
+
+  // Combines the set with @p other by @p operation.
+  void Combine(const RowSet& other, Operation operation);
+
+  // Recomputes chunk_starts_ and size_ from the chunks.
+  void UpdateStarts();
+
+  // @returns the index of the first chunk with a key of @p key or more.
+  size_t FindChunk(int key) const;
+
+  // The chunks in ascending order of key, none empty, and the number of
+  // rows before each.
+  std::deque<Chunk> chunks_;
+  std::vector<int> chunk_starts_;
+  int size_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowSet);
+};
+
+#endif  // SAWBUCK_VIEWER_ROW_SET_H_
@@ -0,0 +1,163 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/row_set.h"
+
+#include <algorithm>
+#include <iterator>
+#include "gtest/gtest.h"
+
+namespace {
+
+// Checks @p set against @p rows, which are in ascending order.
+void ExpectSameRows(const std::vector<int>& rows, const RowSet& set) {
+  ASSERT_EQ(static_cast<int>(rows.size()), set.size());
+  EXPECT_EQ(rows.empty(), set.empty());
+
+  std::vector<int> set_rows;
+  set.GetRows(&set_rows);
+  EXPECT_EQ(rows, set_rows);
+
+  for (size_t i = 0; i < rows.size(); ++i) {
+    ASSERT_EQ(rows[i], set.Select(i));
+    ASSERT_EQ(static_cast<int>(i), set.Rank(rows[i]));
+    ASSERT_TRUE(set.Contains(rows[i]));
+    ASSERT_EQ(static_cast<int>(i) + 1, set.Rank(rows[i] + 1));
+    if (i == 0 || rows[i - 1] != rows[i] - 1)
+      ASSERT_FALSE(set.Contains(rows[i] - 1));
+  }
+}
+
+// @returns every @p step-th row in [@p begin, @p end).
+std::vector<int> GetSteppedRows(int begin, int end, int step) {
+  std::vector<int> rows;
+  for (int row = begin; row < end; row += step)
+    rows.push_back(row);
+  return rows;
+}
+
+void AppendAll(const std::vector<int>& rows, RowSet* set) {
+  set->AppendRows(rows.begin(), rows.end());
+}
+
+TEST(RowSetTest, Empty) {
+  RowSet set;
+  EXPECT_TRUE(set.empty());
+  EXPECT_EQ(0, set.size());
+  EXPECT_FALSE(set.Contains(0));
+  EXPECT_EQ(0, set.Rank(100));
+  EXPECT_EQ(0U, set.GetMemoryUsage());
+}
+
+TEST(RowSetTest, SparseRows) {
+  RowSet set;
+  std::vector<int> rows;
+  const int kRows[] = { 0, 31, 32, 65535, 65536, 65537, 200000, 1 << 24 };
+  for (size_t i = 0; i < arraysize(kRows); ++i) {
+    set.Append(kRows[i]);
+    rows.push_back(kRows[i]);
+  }
+
+  ExpectSameRows(rows, set);
+  EXPECT_EQ(0, set.front());
+  EXPECT_EQ(1 << 24, set.back());
+  EXPECT_EQ(3, set.Rank(1000));
+  EXPECT_EQ(7, set.Rank(300000));
+  EXPECT_EQ(8, set.Rank(1 << 30));
+}
+
+TEST(RowSetTest, DenseRows) {
+  // Most of the rows of a few chunks, which makes for bitmaps, and a
+  // chunk that's sparse.
+  RowSet set;
+  std::vector<int> rows;
+  for (int row = 0; row < 3 * RowSet::kRowsPerChunk; ++row) {
+    if (row % 7 != 3)
+      rows.push_back(row);
+  }
+  std::vector<int> sparse(GetSteppedRows(5 * RowSet::kRowsPerChunk,
+                                         6 * RowSet::kRowsPerChunk, 100));
+  rows.insert(rows.end(), sparse.begin(), sparse.end());
+  AppendAll(rows, &set);
+  ExpectSameRows(rows, set);
+
+  // Far less than a vector of the rows.
+  EXPECT_GT(rows.size() * sizeof(int) / 8, set.GetMemoryUsage());
+}
+
+TEST(RowSetTest, EraseBefore) {
+  std::vector<int> rows(GetSteppedRows(0, 4 * RowSet::kRowsPerChunk, 3));
+  std::vector<int> sparse(GetSteppedRows(4 * RowSet::kRowsPerChunk,
+                                         5 * RowSet::kRowsPerChunk, 1000));
+  rows.insert(rows.end(), sparse.begin(), sparse.end());
+  RowSet set;
+  AppendAll(rows, &set);
+
+  const int kFirstRows[] = {
+    0, 10, RowSet::kRowsPerChunk + 100, 3 * RowSet::kRowsPerChunk - 1,
+    4 * RowSet::kRowsPerChunk + 5000, 6 * RowSet::kRowsPerChunk,
+  };
+  for (size_t i = 0; i < arraysize(kFirstRows); ++i) {
+    set.EraseBefore(kFirstRows[i]);
+    rows.erase(rows.begin(),
+               std::lower_bound(rows.begin(), rows.end(), kFirstRows[i]));
+    ExpectSameRows(rows, set);
+  }
+  EXPECT_TRUE(set.empty());
+
+  // Rows go on being appended.
+  set.Append(7 * RowSet::kRowsPerChunk);
+  EXPECT_EQ(1, set.size());
+  EXPECT_EQ(7 * RowSet::kRowsPerChunk, set.front());
+}
+
+TEST(RowSetTest, SetAlgebra) {
+  std::vector<int> threes(GetSteppedRows(0, 3 * RowSet::kRowsPerChunk, 3));
+  std::vector<int> sevens(GetSteppedRows(RowSet::kRowsPerChunk / 2,
+                                         5 * RowSet::kRowsPerChunk, 7));
+  std::vector<int> expected;
+
+  RowSet set;
+  RowSet other;
+  AppendAll(threes, &set);
+  AppendAll(sevens, &other);
+  set.IntersectWith(other);
+  std::set_intersection(threes.begin(), threes.end(),
+                        sevens.begin(), sevens.end(),
+                        std::back_inserter(expected));
+  ExpectSameRows(expected, set);
+
+  set.Clear();
+  expected.clear();
+  AppendAll(threes, &set);
+  set.UnionWith(other);
+  std::set_union(threes.begin(), threes.end(),
+                 sevens.begin(), sevens.end(),
+                 std::back_inserter(expected));
+  ExpectSameRows(expected, set);
+
+  set.Clear();
+  expected.clear();
+  AppendAll(threes, &set);
+  set.Subtract(other);
+  std::set_difference(threes.begin(), threes.end(),
+                      sevens.begin(), sevens.end(),
+                      std::back_inserter(expected));
+  ExpectSameRows(expected, set);
+
+  // Subtracting a set from itself leaves nothing.
+  set.Subtract(set);
+  EXPECT_TRUE(set.empty());
+}
+
+}  // namespace
@@ -0,0 +1,52 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Session buffer sizer implementation.
+#include "sawbuck/viewer/session_buffer_sizer.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+const uint32 SessionBufferSizer::kGrowthFactor;
+
+SessionBufferSizer::SessionBufferSizer(uint32 max_buffers_ceiling)
+    : max_buffers_ceiling_(max_buffers_ceiling), falling_behind_(false) {
+  DCHECK_LT(0U, max_buffers_ceiling);
+  Stats empty = {};
+  last_stats_ = empty;
+}
+
+bool SessionBufferSizer::OnStats(const Stats& stats,
+                                 uint32* new_maximum_buffers) {
+  DCHECK(new_maximum_buffers != NULL);
+
+  bool lost = stats.events_lost > last_stats_.events_lost ||
+      stats.real_time_buffers_lost > last_stats_.real_time_buffers_lost;
+  bool short_of_buffers = stats.number_of_buffers >= stats.maximum_buffers &&
+      stats.free_buffers * 4 < stats.number_of_buffers;
+  last_stats_ = stats;
+  falling_behind_ = lost || short_of_buffers;
+
+  if (!falling_behind_)
+    return false;
+
+  uint32 grown = std::min(max_buffers_ceiling_,
+                          std::max(stats.maximum_buffers * kGrowthFactor,
+                                   stats.maximum_buffers + 1));
+  if (grown <= stats.maximum_buffers)
+    return false;
+
+  *new_maximum_buffers = grown;
+  return true;
+}
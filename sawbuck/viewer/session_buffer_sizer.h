@@ -0,0 +1,77 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Session buffer sizer declaration.
+#ifndef SAWBUCK_VIEWER_SESSION_BUFFER_SIZER_H_
+#define SAWBUCK_VIEWER_SESSION_BUFFER_SIZER_H_
+
+#include "base/basictypes.h"
+
+// Decides when a trace session's consumer is falling behind from samples
+// of the session's statistics, and how far to grow its buffers to catch
+// up, to no more than a ceiling.
+// The sizer doesn't query the session, the statistics are passed in,
+// which makes it easy to test.
+class SessionBufferSizer {
+ public:
+  // A sample of the statistics of a session, the counts are since it
+  // started.
+  struct Stats {
+    uint32 number_of_buffers;
+    uint32 free_buffers;
+    uint32 maximum_buffers;
+    uint32 events_lost;
+    uint32 real_time_buffers_lost;
+    uint32 buffers_written;
+  };
+
+  // The factor we grow the maximum buffers of a session by.
+  static const uint32 kGrowthFactor = 2;
+
+  // @param max_buffers_ceiling the most buffers to grow a session to.
+  explicit SessionBufferSizer(uint32 max_buffers_ceiling);
+
+  // Takes a sample of the statistics of the session. The session is
+  // falling behind if it lost events or real time buffers since the last
+  // sample, or if it has all the buffers it may and fewer than a quarter
+  // of them are free.
+  // @param new_maximum_buffers on success, returns the maximum buffers to
+  //     update the session to.
+  // @returns true iff the session is falling behind and can grow.
+  bool OnStats(const Stats& stats, uint32* new_maximum_buffers);
+
+  // @returns the last sample, zeros before the first.
+  const Stats& last_stats() const { return last_stats_; }
+
+  // @returns true iff the last sample found the session falling behind,
+  //     whether or not it could grow.
+  bool falling_behind() const { return falling_behind_; }
+  // @returns true iff the session falls behind with all the buffers it
+  //     may grow to, so that only logging less will help it catch up.
+  bool falling_behind_at_ceiling() const {
+    return falling_behind_ &&
+        last_stats_.maximum_buffers >= max_buffers_ceiling_;
+  }
+
+  uint32 max_buffers_ceiling() const { return max_buffers_ceiling_; }
+
+ private:
+  const uint32 max_buffers_ceiling_;
+  Stats last_stats_;
+  bool falling_behind_;
+
+  DISALLOW_COPY_AND_ASSIGN(SessionBufferSizer);
+};
+
+#endif  // SAWBUCK_VIEWER_SESSION_BUFFER_SIZER_H_
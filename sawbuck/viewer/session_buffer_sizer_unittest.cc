@@ -0,0 +1,84 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Session buffer sizer unittests.
+#include "sawbuck/viewer/session_buffer_sizer.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+SessionBufferSizer::Stats MakeStats(uint32 number_of_buffers,
+                                    uint32 free_buffers,
+                                    uint32 maximum_buffers,
+                                    uint32 events_lost,
+                                    uint32 real_time_buffers_lost) {
+  SessionBufferSizer::Stats stats = {};
+  stats.number_of_buffers = number_of_buffers;
+  stats.free_buffers = free_buffers;
+  stats.maximum_buffers = maximum_buffers;
+  stats.events_lost = events_lost;
+  stats.real_time_buffers_lost = real_time_buffers_lost;
+  return stats;
+}
+
+TEST(SessionBufferSizerTest, KeepsUpHealthySession) {
+  SessionBufferSizer sizer(256);
+  uint32 maximum_buffers = 0;
+
+  EXPECT_FALSE(sizer.OnStats(MakeStats(16, 12, 64, 0, 0), &maximum_buffers));
+  // All buffers allocated, but plenty free.
+  EXPECT_FALSE(sizer.OnStats(MakeStats(64, 40, 64, 0, 0), &maximum_buffers));
+  EXPECT_EQ(40U, sizer.last_stats().free_buffers);
+}
+
+TEST(SessionBufferSizerTest, GrowsOnLoss) {
+  SessionBufferSizer sizer(256);
+  uint32 maximum_buffers = 0;
+
+  ASSERT_TRUE(sizer.OnStats(MakeStats(16, 12, 64, 5, 0), &maximum_buffers));
+  EXPECT_EQ(128U, maximum_buffers);
+
+  // The same totals are no new loss.
+  EXPECT_FALSE(sizer.OnStats(MakeStats(16, 12, 128, 5, 0),
+                             &maximum_buffers));
+
+  // Lost real time buffers count too.
+  ASSERT_TRUE(sizer.OnStats(MakeStats(16, 12, 128, 5, 1),
+                            &maximum_buffers));
+  EXPECT_EQ(256U, maximum_buffers);
+
+  // But we stop at the ceiling.
+  EXPECT_FALSE(sizer.OnStats(MakeStats(16, 12, 256, 9, 1),
+                             &maximum_buffers));
+  EXPECT_TRUE(sizer.falling_behind());
+  EXPECT_TRUE(sizer.falling_behind_at_ceiling());
+
+  EXPECT_FALSE(sizer.OnStats(MakeStats(16, 12, 256, 9, 1),
+                             &maximum_buffers));
+  EXPECT_FALSE(sizer.falling_behind());
+  EXPECT_FALSE(sizer.falling_behind_at_ceiling());
+}
+
+TEST(SessionBufferSizerTest, GrowsWhenShortOfBuffers) {
+  SessionBufferSizer sizer(100);
+  uint32 maximum_buffers = 0;
+
+  ASSERT_TRUE(sizer.OnStats(MakeStats(64, 8, 64, 0, 0), &maximum_buffers));
+  EXPECT_EQ(100U, maximum_buffers);
+  EXPECT_TRUE(sizer.falling_behind());
+  EXPECT_FALSE(sizer.falling_behind_at_ceiling());
+}
+
+}  // namespace
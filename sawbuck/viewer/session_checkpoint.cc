@@ -0,0 +1,234 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Session checkpoint implementation.
+#include "sawbuck/viewer/session_checkpoint.h"
+
+#include <share.h>
+#include <algorithm>
+#include <vector>
+#include "base/bind.h"
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/message_loop/message_loop.h"
+#include "sawbuck/viewer/log_index.h"
+#include "sawbuck/viewer/log_store.h"
+
+namespace {
+
+// The checkpoint is copied this much at a time.
+const size_t kCopyBufferSize = 256 * 1024;
+
+}  // namespace
+
+const int SessionCheckpoint::kChunkRows;
+const int64 SessionCheckpoint::kChunkIntervalMs;
+
+SessionCheckpoint::SessionCheckpoint(const LogIndex* index)
+    : index_(index), writer_loop_(NULL), next_row_(0), next_event_(0),
+      file_(NULL), file_bytes_(0) {
+  DCHECK(index != NULL);
+}
+
+SessionCheckpoint::~SessionCheckpoint() {
+  DCHECK(!is_started());
+  if (file_ != NULL)
+    file_util::CloseFile(file_);
+}
+
+void SessionCheckpoint::Start(const base::FilePath& path,
+                              base::MessageLoop* writer_loop) {
+  DCHECK(!is_started());
+  DCHECK(writer_loop != NULL);
+
+  writer_loop_ = writer_loop;
+  path_ = path;
+  next_row_ = 0;
+  next_event_ = 0;
+  last_chunk_ = base::TimeTicks::Now();
+  writer_loop_->PostTask(FROM_HERE,
+      base::Bind(&SessionCheckpoint::OpenFile, base::Unretained(this),
+                 path));
+}
+
+void SessionCheckpoint::Stop() {
+  if (!is_started())
+    return;
+
+  writer_loop_->PostTask(FROM_HERE,
+      base::Bind(&SessionCheckpoint::DiscardFile, base::Unretained(this)));
+  writer_loop_ = NULL;
+  path_.clear();
+}
+
+void SessionCheckpoint::Update(const LogStore& store) {
+  if (!is_started())
+    return;
+
+  int pending_rows = store.num_rows() - std::max(next_row_, store.first_row());
+  if (pending_rows < kChunkRows) {
+    base::TimeTicks now = base::TimeTicks::Now();
+    if (now - last_chunk_ <
+        base::TimeDelta::FromMilliseconds(kChunkIntervalMs)) {
+      return;
+    }
+
+    // Nothing's changed, check again in another interval.
+    if (pending_rows <= 0 && index_->num_kernel_events() == next_event_) {
+      last_chunk_ = now;
+      return;
+    }
+  }
+
+  PostChunk(store, std::string());
+}
+
+void SessionCheckpoint::Save(const LogStore& store,
+                             const std::string& filters,
+                             const base::FilePath& path,
+                             const base::Callback<void(bool)>& callback) {
+  DCHECK(is_started());
+
+  // The filters go in a chunk of their own, which the copy gets and the
+  // checkpoint doesn't, and which takes nothing from the next chunk.
+  PostChunk(store, std::string());
+  std::string* filters_chunk = new std::string;
+  size_t next_event = next_event_;
+  index_->SerializeCheckpointChunk(store, next_row_, filters, &next_event,
+                                   filters_chunk);
+
+  writer_loop_->PostTask(FROM_HERE,
+      base::Bind(&SessionCheckpoint::CopyToFile, base::Unretained(this), path,
+                 base::Owned(filters_chunk), callback));
+}
+
+bool SessionCheckpoint::IsLeftOver(const base::FilePath& path) {
+  if (!base::PathExists(path))
+    return false;
+
+  // The writer denies others write access for as long as it's writing.
+  FILE* file = _wfsopen(path.value().c_str(), L"ab", _SH_DENYNO);
+  if (file == NULL)
+    return false;
+
+  file_util::CloseFile(file);
+  return true;
+}
+
+void SessionCheckpoint::PostChunk(const LogStore& store,
+                                  const std::string& filters) {
+  std::string* chunk = new std::string;
+  index_->SerializeCheckpointChunk(store, next_row_, filters, &next_event_,
+                                   chunk);
+  next_row_ = store.num_rows();
+  last_chunk_ = base::TimeTicks::Now();
+
+  writer_loop_->PostTask(FROM_HERE,
+      base::Bind(&SessionCheckpoint::AppendChunk, base::Unretained(this),
+                 base::Owned(chunk)));
+}
+
+void SessionCheckpoint::OpenFile(const base::FilePath& path) {
+  DCHECK(file_ == NULL);
+
+  file_path_ = path;
+  file_bytes_ = 0;
+  file_ = _wfsopen(path.value().c_str(), L"wb", _SH_DENYWR);
+  if (file_ == NULL) {
+    LOG(ERROR) << "Failed to create the checkpoint \"" << path.value()
+               << "\".";
+    return;
+  }
+
+  std::string header;
+  LogIndex::SerializeCheckpointHeader(&header);
+  WriteToFile(header);
+}
+
+void SessionCheckpoint::AppendChunk(const std::string* chunk) {
+  DCHECK(chunk != NULL);
+  WriteToFile(*chunk);
+}
+
+void SessionCheckpoint::CopyToFile(
+    const base::FilePath& path,
+    const std::string* filters_chunk,
+    const base::Callback<void(bool)>& callback) {
+  DCHECK(filters_chunk != NULL);
+
+  // The whole chunks are flushed, so they read back as written.
+  bool saved = false;
+  if (file_ != NULL) {
+    FILE* source = file_util::OpenFile(file_path_, "rb");
+    FILE* target = file_util::OpenFile(path, "wb");
+    saved = source != NULL && target != NULL;
+
+    std::vector<char> buffer(kCopyBufferSize);
+    int64 remaining = file_bytes_;
+    while (saved && remaining > 0) {
+      size_t size = static_cast<size_t>(
+          std::min(remaining, static_cast<int64>(buffer.size())));
+      saved = fread(&buffer[0], 1, size, source) == size &&
+          fwrite(&buffer[0], 1, size, target) == size;
+      remaining -= size;
+    }
+    if (saved) {
+      saved = fwrite(filters_chunk->data(), 1, filters_chunk->size(),
+                     target) == filters_chunk->size();
+    }
+
+    if (source != NULL)
+      file_util::CloseFile(source);
+    if (target != NULL && !file_util::CloseFile(target))
+      saved = false;
+  }
+
+  if (!saved) {
+    LOG(ERROR) << "Failed to save the checkpoint to \"" << path.value()
+               << "\".";
+    // Don't leave a truncated file around.
+    base::DeleteFile(path, false);
+  }
+  callback.Run(saved);
+}
+
+void SessionCheckpoint::DiscardFile() {
+  if (file_ != NULL) {
+    file_util::CloseFile(file_);
+    file_ = NULL;
+  }
+  if (!file_path_.empty())
+    base::DeleteFile(file_path_, false);
+  file_path_.clear();
+  file_bytes_ = 0;
+}
+
+bool SessionCheckpoint::WriteToFile(const std::string& data) {
+  if (file_ == NULL)
+    return false;
+
+  if (fwrite(data.data(), 1, data.size(), file_) == data.size() &&
+      fflush(file_) == 0) {
+    file_bytes_ += data.size();
+    return true;
+  }
+
+  // The chunks written before stay good, as the file is only loaded up to
+  // its last whole chunk, but those to come can't follow them.
+  LOG(ERROR) << "Failed to write the checkpoint \"" << file_path_.value()
+             << "\".";
+  file_util::CloseFile(file_);
+  file_ = NULL;
+  return false;
+}
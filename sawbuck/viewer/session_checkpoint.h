@@ -0,0 +1,133 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Session checkpoint declaration.
+#ifndef SAWBUCK_VIEWER_SESSION_CHECKPOINT_H_
+#define SAWBUCK_VIEWER_SESSION_CHECKPOINT_H_
+
+#include <stdio.h>
+#include <string>
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/files/file_path.h"
+#include "base/time/time.h"
+
+namespace base {
+class MessageLoop;
+}  // namespace base
+
+class LogIndex;
+class LogStore;
+
+// Checkpoints a live capture to a session file on disk as it runs, so that
+// saving it is a copy, and a crash loses no more than the last few
+// seconds of it. The file is a checkpoint, which is appended to a chunk at
+// a time, @see LogIndex::SerializeCheckpointChunk. Every kChunkRows rows,
+// or every kChunkIntervalMs with fewer, the rows added to the store since
+// the last chunk are serialized to a chunk, along with the file names and
+// stack traces they refer to and the kernel events recorded since, and the
+// chunk is appended to the file and flushed on a writer thread.
+// The chunks are serialized on the store's thread, but each holds no more
+// than a few seconds' rows, so the cost is small and spread over the
+// capture. The message index and posting lists aren't checkpointed, as
+// they're rebuilt as the rows are loaded.
+// @note the file only grows, it keeps the rows the store evicts, which are
+//     skipped as it loads.
+// @note all but the writer tasks run on the thread the store belongs to,
+//     and the writer loop must run the tasks posted to it before this is
+//     destroyed.
+class SessionCheckpoint {
+ public:
+  // @param index records the kernel events of the session, and must
+  //     outlive this checkpoint.
+  explicit SessionCheckpoint(const LogIndex* index);
+  ~SessionCheckpoint();
+
+  // Starts checkpointing to a new file at @p path, written on
+  // @p writer_loop. The first chunk holds the rows the store has already,
+  // and all the kernel events recorded.
+  void Start(const base::FilePath& path, base::MessageLoop* writer_loop);
+
+  // Stops checkpointing, and deletes the file.
+  void Stop();
+
+  bool is_started() const { return writer_loop_ != NULL; }
+  const base::FilePath& path() const { return path_; }
+
+  // Checkpoints the rows added to @p store since the last chunk, if there
+  // are kChunkRows of them, or if the last chunk is kChunkIntervalMs old.
+  void Update(const LogStore& store);
+
+  // Saves a session of @p store and the serialized @p filters to @p path,
+  // by checkpointing the rows added since the last chunk, then copying the
+  // file with a last chunk for the filters. @p callback runs on the writer
+  // loop, with true iff the session was saved.
+  void Save(const LogStore& store,
+            const std::string& filters,
+            const base::FilePath& path,
+            const base::Callback<void(bool)>& callback);
+
+  // @returns the number of the row the next chunk starts at.
+  int next_row() const { return next_row_; }
+
+  // @returns true iff there's a checkpoint at @p path that isn't being
+  //     written, as of a capture that crashed.
+  static bool IsLeftOver(const base::FilePath& path);
+
+  // The rows that make a chunk due, a sealed segment's worth.
+  static const int kChunkRows = 4096;
+  // The interval between chunks of fewer rows.
+  static const int64 kChunkIntervalMs = 5 * 1000;
+
+ private:
+  // Serializes the rows of @p store from next_row_ on to a chunk, with
+  // @p filters, and posts it to the writer loop.
+  void PostChunk(const LogStore& store, const std::string& filters);
+
+  // The writer tasks, which create the file at @p path, append @p chunk to
+  // it, copy it to @p path with @p filters_chunk, and close and delete it.
+  // @{
+  void OpenFile(const base::FilePath& path);
+  void AppendChunk(const std::string* chunk);
+  void CopyToFile(const base::FilePath& path,
+                  const std::string* filters_chunk,
+                  const base::Callback<void(bool)>& callback);
+  void DiscardFile();
+  // @}
+
+  // Writes @p data to file_.
+  // @returns true on success.
+  bool WriteToFile(const std::string& data);
+
+  const LogIndex* index_;
+
+  // NULL until started.
+  base::MessageLoop* writer_loop_;
+  base::FilePath path_;
+  // Where the next chunk starts.
+  int next_row_;
+  size_t next_event_;
+  base::TimeTicks last_chunk_;
+
+  // The checkpoint file, NULL until created, or once it's failed. On the
+  // writer loop.
+  FILE* file_;
+  base::FilePath file_path_;
+  // The bytes of the whole chunks written.
+  int64 file_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(SessionCheckpoint);
+};
+
+#endif  // SAWBUCK_VIEWER_SESSION_CHECKPOINT_H_
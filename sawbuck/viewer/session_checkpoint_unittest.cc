@@ -0,0 +1,164 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Session checkpoint unit tests.
+#include "sawbuck/viewer/session_checkpoint.h"
+
+#include "base/bind.h"
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/message_loop/message_loop.h"
+#include "base/strings/stringprintf.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/log_index.h"
+#include "sawbuck/viewer/log_store.h"
+
+namespace {
+
+void SetSaved(bool* saved_out, bool saved) {
+  *saved_out = saved;
+}
+
+class SessionCheckpointTest : public testing::Test {
+ public:
+  SessionCheckpointTest()
+      : index_(NULL, NULL), checkpoint_(&index_), store_(&file_table_) {
+  }
+
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().Append(L"capture.sbcheckpoint");
+    time_ = base::Time::Now();
+  }
+
+  virtual void TearDown() {
+    checkpoint_.Stop();
+    message_loop_.RunUntilIdle();
+  }
+
+  // Adds @p count rows to store_.
+  void AddRows(int count) {
+    for (int i = 0; i < count; ++i) {
+      int row = store_.num_rows();
+      store_.AddRow(TRACE_LEVEL_INFORMATION, 10, 100,
+                    time_ + base::TimeDelta::FromMicroseconds(row),
+                    file_table_.Intern("foo.cc"), row,
+                    base::StringPrintf("Row %d", row), 0, NULL);
+    }
+  }
+
+  // Loads the session at @p path to @p store.
+  bool Load(const base::FilePath& path, LogStore* store,
+            std::string* filters) {
+    LogIndex loader(NULL, NULL);
+    return loader.LoadSession(path, store, filters);
+  }
+
+ protected:
+  base::MessageLoop message_loop_;
+  base::ScopedTempDir temp_dir_;
+  base::FilePath path_;
+  base::Time time_;
+
+  LogIndex index_;
+  SessionCheckpoint checkpoint_;
+  StringTable file_table_;
+  LogStore store_;
+};
+
+}  // namespace
+
+TEST_F(SessionCheckpointTest, CheckpointsRowsByTheChunk) {
+  AddRows(10);
+  checkpoint_.Start(path_, &message_loop_);
+  EXPECT_TRUE(checkpoint_.is_started());
+  EXPECT_EQ(path_.value(), checkpoint_.path().value());
+
+  // Too few rows for a chunk, too soon.
+  checkpoint_.Update(store_);
+  EXPECT_EQ(0, checkpoint_.next_row());
+
+  AddRows(SessionCheckpoint::kChunkRows);
+  checkpoint_.Update(store_);
+  EXPECT_EQ(store_.num_rows(), checkpoint_.next_row());
+  AddRows(5);
+  checkpoint_.Update(store_);
+  message_loop_.RunUntilIdle();
+
+  // The checkpoint loads as a session of the chunked rows.
+  LogStore loaded(&file_table_);
+  std::string filters;
+  ASSERT_TRUE(Load(path_, &loaded, &filters));
+  ASSERT_EQ(10 + SessionCheckpoint::kChunkRows, loaded.num_rows());
+  std::string buffer;
+  EXPECT_EQ("Row 42", loaded.GetMessage(42, &buffer));
+  EXPECT_TRUE(filters.empty());
+
+  // Stopping deletes it.
+  checkpoint_.Stop();
+  EXPECT_FALSE(checkpoint_.is_started());
+  message_loop_.RunUntilIdle();
+  EXPECT_FALSE(base::PathExists(path_));
+}
+
+TEST_F(SessionCheckpointTest, SaveCopiesTheCheckpoint) {
+  AddRows(SessionCheckpoint::kChunkRows);
+  checkpoint_.Start(path_, &message_loop_);
+  checkpoint_.Update(store_);
+  AddRows(7);
+
+  base::FilePath session_path(temp_dir_.path().Append(L"test.sbsession"));
+  bool saved = false;
+  checkpoint_.Save(store_, "some filters", session_path,
+                   base::Bind(&SetSaved, &saved));
+  message_loop_.RunUntilIdle();
+  ASSERT_TRUE(saved);
+
+  // The copy has all the rows and the filters.
+  LogStore loaded(&file_table_);
+  std::string filters;
+  ASSERT_TRUE(Load(session_path, &loaded, &filters));
+  EXPECT_EQ(store_.num_rows(), loaded.num_rows());
+  EXPECT_EQ("some filters", filters);
+
+  // The checkpoint has the rows, and carries on without the filters.
+  AddRows(3);
+  checkpoint_.Save(store_, "", session_path, base::Bind(&SetSaved, &saved));
+  message_loop_.RunUntilIdle();
+  LogStore checkpointed(&file_table_);
+  ASSERT_TRUE(Load(path_, &checkpointed, &filters));
+  EXPECT_EQ(store_.num_rows(), checkpointed.num_rows());
+  EXPECT_TRUE(filters.empty());
+
+  // The copy fails without a checkpoint file to copy.
+  checkpoint_.Stop();
+  checkpoint_.Start(temp_dir_.path().Append(L"missing").Append(
+                        L"capture.sbcheckpoint"),
+                    &message_loop_);
+  saved = true;
+  checkpoint_.Save(store_, "", session_path, base::Bind(&SetSaved, &saved));
+  message_loop_.RunUntilIdle();
+  EXPECT_FALSE(saved);
+  EXPECT_FALSE(base::PathExists(session_path));
+}
+
+TEST_F(SessionCheckpointTest, IsLeftOver) {
+  EXPECT_FALSE(SessionCheckpoint::IsLeftOver(path_));
+
+  // A crash leaves the file behind.
+  std::string header;
+  LogIndex::SerializeCheckpointHeader(&header);
+  ASSERT_TRUE(LogIndex::WriteFile(path_, header));
+  EXPECT_TRUE(SessionCheckpoint::IsLeftOver(path_));
+}
@@ -0,0 +1,301 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Session library implementation.
+#include "sawbuck/viewer/session_library.h"
+
+#include <algorithm>
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/file_util.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/logging.h"
+#include "base/strings/string_split.h"
+#include "base/strings/utf_string_conversions.h"
+#include "sawbuck/common/perf_counters.h"
+#include "sawbuck/viewer/log_index.h"
+#include "sawbuck/viewer/pattern_matcher.h"
+#include "sawbuck/viewer/trigram_index.h"
+
+namespace {
+
+PerfCounter search_file_counter("SessionLibrary.SearchFile", 1);
+PerfCounter build_index_counter("SessionLibrary.BuildIndex", 1);
+
+const wchar_t kSearchIndexExtension[] = L".sbsearch";
+
+const uint32 kSearchIndexMagic = 0x49534253;  // "SBSI"
+const uint32 kSearchIndexVersion = 1;
+
+// The layout of a search index file. The trigram index image follows the
+// header, which keeps it 8 byte aligned in a mapping of the file.
+struct SearchIndexHeader {
+  uint32 magic;
+  uint32 version;
+
+  // The size and modification time of the indexed file when indexed.
+  int64 file_size;
+  int64 file_last_modified;
+
+  uint32 num_rows;
+  uint32 image_bytes;
+};
+
+// Retrieves the identifying properties of the file at @p path.
+bool GetFileIdentity(const base::FilePath& path,
+                     int64* size,
+                     int64* last_modified) {
+  base::File::Info info;
+  if (!base::GetFileInfo(path, &info))
+    return false;
+
+  *size = info.size;
+  *last_modified = info.last_modified.ToInternalValue();
+  return true;
+}
+
+// Maps the search index of the file at @p path, which holds @p num_rows.
+// @returns true iff the search index is up to date, in which case
+//     @p image holds its trigram index image, within @p mapped.
+bool MapSearchIndex(const base::FilePath& path,
+                    int num_rows,
+                    base::MemoryMappedFile* mapped,
+                    base::StringPiece* image) {
+  int64 size = 0;
+  int64 last_modified = 0;
+  if (!GetFileIdentity(path, &size, &last_modified))
+    return false;
+  if (!mapped->Initialize(SessionLibrary::GetSearchIndexPath(path)))
+    return false;
+  if (mapped->length() < sizeof(SearchIndexHeader))
+    return false;
+
+  const SearchIndexHeader* header =
+      reinterpret_cast<const SearchIndexHeader*>(mapped->data());
+  if (header->magic != kSearchIndexMagic ||
+      header->version != kSearchIndexVersion ||
+      header->file_size != size ||
+      header->file_last_modified != last_modified ||
+      header->num_rows != static_cast<uint32>(num_rows) ||
+      header->image_bytes != mapped->length() - sizeof(*header)) {
+    return false;
+  }
+
+  base::StringPiece found(
+      reinterpret_cast<const char*>(mapped->data() + sizeof(*header)),
+      header->image_bytes);
+  if (!TrigramIndex::IsValidImage(found))
+    return false;
+
+  *image = found;
+  return true;
+}
+
+}  // namespace
+
+SessionLibrary::SessionLibrary()
+    : index_group_(TaskPool::Get(), TaskPool::PRIORITY_BACKGROUND,
+                   &build_index_counter) {
+}
+
+SessionLibrary::~SessionLibrary() {
+}
+
+bool SessionLibrary::Register(const base::FilePath& path) {
+  int num_rows = 0;
+  {
+    LogIndex::MappedFile file;
+    if (!file.Open(path))
+      return false;
+    num_rows = file.num_rows();
+  }
+
+  // The search index is checked and built on the task pool, as building
+  // it reads all the messages of the file.
+  index_group_.Post(base::Bind(&SessionLibrary::UpdateSearchIndex, path,
+                               num_rows));
+
+  if (std::find(paths_.begin(), paths_.end(), path) == paths_.end())
+    paths_.push_back(path);
+  return true;
+}
+
+void SessionLibrary::Unregister(const base::FilePath& path) {
+  std::vector<base::FilePath>::iterator it =
+      std::find(paths_.begin(), paths_.end(), path);
+  if (it == paths_.end())
+    return;
+
+  // A search index being built would outlive its deletion.
+  WaitForSearchIndexes();
+  paths_.erase(it);
+  base::DeleteFile(GetSearchIndexPath(path), false);
+}
+
+void SessionLibrary::SerializePaths(std::string* text) const {
+  DCHECK(text != NULL);
+  text->clear();
+  for (size_t i = 0; i < paths_.size(); ++i) {
+    text->append(base::WideToUTF8(paths_[i].value()));
+    text->push_back('\n');
+  }
+}
+
+void SessionLibrary::DeserializePaths(const std::string& text) {
+  std::vector<std::string> lines;
+  base::SplitString(text, '\n', &lines);
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (lines[i].empty())
+      continue;
+
+    base::FilePath path(base::UTF8ToWide(lines[i]));
+    if (std::find(paths_.begin(), paths_.end(), path) == paths_.end())
+      paths_.push_back(path);
+  }
+}
+
+void SessionLibrary::Search(const base::StringPiece& literal,
+                            size_t max_hits,
+                            std::vector<Hit>* hits) {
+  DCHECK(hits != NULL);
+  hits->clear();
+  if (literal.empty() || max_hits == 0 || paths_.empty())
+    return;
+
+  // The search indexes being built are waited for, rather than scan
+  // their files in full.
+  WaitForSearchIndexes();
+
+  // Search each file as a task of its own, helping out with the files
+  // the pool hasn't got to, then collect the hits in file order.
+  CaselessSearcher searcher(literal);
+  std::vector<std::vector<Hit> > file_hits(paths_.size());
+  {
+    TaskPool::TaskGroup group(TaskPool::Get(), TaskPool::PRIORITY_INTERACTIVE,
+                              &search_file_counter);
+    for (size_t i = 0; i < paths_.size(); ++i) {
+      group.Post(base::Bind(&SessionLibrary::SearchFile, i,
+                            base::ConstRef(paths_[i]),
+                            base::ConstRef(searcher), max_hits,
+                            &file_hits[i]));
+    }
+    group.Wait();
+  }
+
+  for (size_t i = 0; i < file_hits.size() && hits->size() < max_hits; ++i) {
+    size_t count = std::min(file_hits[i].size(), max_hits - hits->size());
+    hits->insert(hits->end(), file_hits[i].begin(),
+                 file_hits[i].begin() + count);
+  }
+}
+
+void SessionLibrary::WaitForSearchIndexes() {
+  index_group_.Wait();
+}
+
+base::FilePath SessionLibrary::GetSearchIndexPath(
+    const base::FilePath& path) {
+  return base::FilePath(path.value() + kSearchIndexExtension);
+}
+
+bool SessionLibrary::BuildSearchIndex(const base::FilePath& path) {
+  int64 size = 0;
+  int64 last_modified = 0;
+  if (!GetFileIdentity(path, &size, &last_modified))
+    return false;
+
+  std::string image;
+  SearchIndexHeader header = {};
+  {
+    LogIndex::MappedFile file;
+    if (!file.Open(path))
+      return false;
+
+    TrigramIndex index;
+    for (int row = 0; row < file.num_rows(); ++row)
+      index.AddRow(file.GetMessage(row));
+    index.Serialize(&image);
+    header.num_rows = file.num_rows();
+  }
+
+  header.magic = kSearchIndexMagic;
+  header.version = kSearchIndexVersion;
+  header.file_size = size;
+  header.file_last_modified = last_modified;
+  header.image_bytes = image.size();
+
+  std::string buffer(reinterpret_cast<const char*>(&header), sizeof(header));
+  buffer.append(image);
+  return LogIndex::WriteFile(GetSearchIndexPath(path), buffer);
+}
+
+void SessionLibrary::UpdateSearchIndex(const base::FilePath& path,
+                                       int num_rows) {
+  bool up_to_date = false;
+  {
+    base::MemoryMappedFile mapped;
+    base::StringPiece image;
+    up_to_date = MapSearchIndex(path, num_rows, &mapped, &image);
+  }
+  // A file searches without its search index, only slower.
+  if (!up_to_date && !BuildSearchIndex(path))
+    LOG(ERROR) << "Failed to write the search index of " << path.value();
+}
+
+void SessionLibrary::SearchFile(size_t file,
+                                const base::FilePath& path,
+                                const CaselessSearcher& searcher,
+                                size_t max_hits,
+                                std::vector<Hit>* hits) {
+  DCHECK(hits != NULL);
+  LogIndex::MappedFile mapped_file;
+  if (!mapped_file.Open(path))
+    return;
+
+  // Narrow the search down by the search index if we can, or else
+  // scan all the rows.
+  const base::StringPiece& literal = searcher.needle();
+  int num_rows = mapped_file.num_rows();
+  std::vector<int> rows;
+  bool narrowed = false;
+  base::MemoryMappedFile mapped_index;
+  base::StringPiece image;
+  if (literal.size() >= TrigramIndex::kMinLiteralLength &&
+      MapSearchIndex(path, num_rows, &mapped_index, &image)) {
+    narrowed = TrigramIndex::GetImageCandidateRows(image, literal, 0,
+                                                   num_rows, &rows);
+  }
+  if (!narrowed) {
+    rows.resize(num_rows);
+    for (int row = 0; row < num_rows; ++row)
+      rows[row] = row;
+  }
+
+  for (size_t i = 0; i < rows.size() && hits->size() < max_hits; ++i) {
+    int row = rows[i];
+    if (row >= num_rows)
+      break;
+
+    base::StringPiece message = mapped_file.GetMessage(row);
+    if (!searcher.Find(message))
+      continue;
+
+    Hit hit;
+    hit.file = file;
+    hit.row = row;
+    hit.time = mapped_file.GetTime(row);
+    message.CopyToString(&hit.message);
+    hits->push_back(hit);
+  }
+}
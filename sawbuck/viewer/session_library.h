@@ -0,0 +1,115 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Session library declaration.
+#ifndef SAWBUCK_VIEWER_SESSION_LIBRARY_H_
+#define SAWBUCK_VIEWER_SESSION_LIBRARY_H_
+
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+#include "sawbuck/common/task_pool.h"
+
+class CaselessSearcher;
+
+// Keeps a library of saved session and index files, and searches the
+// messages of all of them at once, e.g. for the other sessions in which
+// an error was logged.
+//
+// Each file registered gets a search index next to it, which holds the
+// trigram index image of its messages, see TrigramIndex::Serialize. A
+// search maps each file and its search index, looks up the candidate rows
+// in the image in place and verifies them against the mapped messages, so
+// that no file is loaded whole. The search indexes are built, and the
+// files searched, in parallel on the task pool.
+// A file whose search index is missing or out of date, e.g. because the
+// session was saved over, is scanned in full instead, as are all the
+// files for literals too short for the trigram indexes.
+class SessionLibrary {
+ public:
+  // A row containing the literal searched for.
+  struct Hit {
+    Hit() : file(0), row(0) {
+    }
+
+    // The index of the file in paths().
+    size_t file;
+    int row;
+    base::Time time;
+    std::string message;
+  };
+
+  SessionLibrary();
+  ~SessionLibrary();
+
+  // Adds the session or index file at @p path to the library, and starts
+  // bringing its search index up to date in the background.
+  // @returns true iff @p path is a session or index file.
+  bool Register(const base::FilePath& path);
+
+  // Removes @p path from the library, and deletes its search index.
+  void Unregister(const base::FilePath& path);
+
+  // @returns the files in the library, in the order registered.
+  const std::vector<base::FilePath>& paths() const { return paths_; }
+
+  // Serializes the paths of the library, one per line, to @p text.
+  void SerializePaths(std::string* text) const;
+
+  // Restores paths serialized by SerializePaths, without checking the
+  // files or their search indexes, which happens on searching.
+  void DeserializePaths(const std::string& text);
+
+  // Finds the rows of the files containing @p literal, ignoring ASCII
+  // case, at most @p max_hits of them.
+  // @param hits receives the rows, ordered by file and row.
+  void Search(const base::StringPiece& literal,
+              size_t max_hits,
+              std::vector<Hit>* hits);
+
+  // Waits for the search indexes being brought up to date, helping out.
+  void WaitForSearchIndexes();
+
+  // @returns the path of the search index of the file at @p path.
+  static base::FilePath GetSearchIndexPath(const base::FilePath& path);
+
+  // Writes a search index for the file at @p path, whatever its state.
+  // @returns true on success.
+  static bool BuildSearchIndex(const base::FilePath& path);
+
+ private:
+  // Writes a search index for the file at @p path, which holds @p num_rows,
+  // unless it has an up to date one.
+  static void UpdateSearchIndex(const base::FilePath& path, int num_rows);
+
+  // Finds the rows of @p file, at @p path, containing the literal of
+  // @p searcher, as for Search.
+  static void SearchFile(size_t file,
+                         const base::FilePath& path,
+                         const CaselessSearcher& searcher,
+                         size_t max_hits,
+                         std::vector<Hit>* hits);
+
+  std::vector<base::FilePath> paths_;
+
+  // The tasks bringing the search indexes up to date.
+  TaskPool::TaskGroup index_group_;
+
+  DISALLOW_COPY_AND_ASSIGN(SessionLibrary);
+};
+
+#endif  // SAWBUCK_VIEWER_SESSION_LIBRARY_H_
@@ -0,0 +1,160 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Session library unit tests.
+#include "sawbuck/viewer/session_library.h"
+
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/strings/stringprintf.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/log_index.h"
+#include "sawbuck/viewer/log_store.h"
+
+namespace {
+
+class SessionLibraryTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+  // Saves a session of @p num_rows rows to @p name, in which every
+  // @p every rows hold @p message, and the others filler.
+  base::FilePath SaveSession(const wchar_t* name, int num_rows, int every,
+                             const char* message) {
+    StringTable file_table;
+    LogStore store(&file_table);
+    for (int row = 0; row < num_rows; ++row) {
+      std::string text = row % every == 0 ? std::string(message) :
+          base::StringPrintf("Filler row %d", row);
+      store.AddRow(TRACE_LEVEL_INFORMATION, 10, 11,
+                   base::Time::FromInternalValue(1000 + row),
+                   StringTable::kEmptyAtom, 0, text, 0, NULL);
+    }
+
+    LogIndex saver(NULL, NULL);
+    std::string buffer;
+    saver.SerializeSession(store, "", &buffer);
+    base::FilePath path(temp_dir_.path().Append(name));
+    EXPECT_TRUE(LogIndex::WriteFile(path, buffer));
+    return path;
+  }
+
+ protected:
+  base::ScopedTempDir temp_dir_;
+};
+
+}  // namespace
+
+TEST_F(SessionLibraryTest, SearchesAllFiles) {
+  base::FilePath first = SaveSession(L"first.sbsession", 500, 100,
+                                     "Failed to open the file");
+  base::FilePath second = SaveSession(L"second.sbsession", 300, 7,
+                                      "Nothing to see");
+  base::FilePath third = SaveSession(L"third.sbsession", 50, 25,
+                                     "FAILED TO OPEN the pipe");
+
+  SessionLibrary library;
+  ASSERT_TRUE(library.Register(first));
+  ASSERT_TRUE(library.Register(second));
+  ASSERT_TRUE(library.Register(third));
+  library.WaitForSearchIndexes();
+  EXPECT_TRUE(base::PathExists(SessionLibrary::GetSearchIndexPath(first)));
+  ASSERT_EQ(3U, library.paths().size());
+
+  std::vector<SessionLibrary::Hit> hits;
+  library.Search("failed to open", 100, &hits);
+  ASSERT_EQ(7U, hits.size());
+  for (size_t i = 0; i < 5; ++i) {
+    EXPECT_EQ(0U, hits[i].file);
+    EXPECT_EQ(static_cast<int>(i * 100), hits[i].row);
+    EXPECT_EQ("Failed to open the file", hits[i].message);
+  }
+  EXPECT_EQ(2U, hits[5].file);
+  EXPECT_EQ(0, hits[5].row);
+  EXPECT_EQ(2U, hits[6].file);
+  EXPECT_EQ(25, hits[6].row);
+  EXPECT_EQ(base::Time::FromInternalValue(1025), hits[6].time);
+
+  // The hits are capped in file order.
+  library.Search("failed to open", 6, &hits);
+  ASSERT_EQ(6U, hits.size());
+  EXPECT_EQ(2U, hits[5].file);
+
+  // Literals too short for the trigrams are scanned for. All but the
+  // filler rows have an n.
+  library.Search("n", 1000, &hits);
+  EXPECT_EQ(5U + 43U + 2U, hits.size());
+}
+
+TEST_F(SessionLibraryTest, RegisterRejectsOtherFiles) {
+  base::FilePath path(temp_dir_.path().Append(L"not_a_session"));
+  ASSERT_EQ(3, base::WriteFile(path, "foo", 3));
+
+  SessionLibrary library;
+  EXPECT_FALSE(library.Register(path));
+  EXPECT_FALSE(library.Register(temp_dir_.path().Append(L"missing")));
+  EXPECT_TRUE(library.paths().empty());
+}
+
+TEST_F(SessionLibraryTest, StaleSearchIndex) {
+  base::FilePath path = SaveSession(L"test.sbsession", 100, 10, "Found it");
+  SessionLibrary library;
+  ASSERT_TRUE(library.Register(path));
+  library.WaitForSearchIndexes();
+
+  // Saving over the session makes its search index stale, and it's
+  // scanned instead.
+  SaveSession(L"test.sbsession", 200, 50, "Found it again");
+  std::vector<SessionLibrary::Hit> hits;
+  library.Search("found it", 100, &hits);
+  ASSERT_EQ(4U, hits.size());
+  EXPECT_EQ(150, hits[3].row);
+
+  // Registering again brings it up to date.
+  ASSERT_TRUE(library.Register(path));
+  EXPECT_EQ(1U, library.paths().size());
+  library.Search("found it", 100, &hits);
+  EXPECT_EQ(4U, hits.size());
+
+  // A corrupt search index is no better than a stale one.
+  ASSERT_EQ(3, base::WriteFile(SessionLibrary::GetSearchIndexPath(path),
+                               "foo", 3));
+  library.Search("found it", 100, &hits);
+  EXPECT_EQ(4U, hits.size());
+}
+
+TEST_F(SessionLibraryTest, SerializePaths) {
+  base::FilePath first = SaveSession(L"first.sbsession", 10, 1, "One");
+  base::FilePath second = SaveSession(L"second.sbsession", 10, 1, "Two");
+
+  SessionLibrary library;
+  ASSERT_TRUE(library.Register(first));
+  ASSERT_TRUE(library.Register(second));
+  std::string text;
+  library.SerializePaths(&text);
+
+  SessionLibrary restored;
+  restored.DeserializePaths(text);
+  EXPECT_EQ(library.paths(), restored.paths());
+  std::vector<SessionLibrary::Hit> hits;
+  restored.Search("two", 100, &hits);
+  EXPECT_EQ(10U, hits.size());
+
+  restored.Unregister(first);
+  ASSERT_EQ(1U, restored.paths().size());
+  EXPECT_EQ(second, restored.paths()[0]);
+  EXPECT_FALSE(base::PathExists(SessionLibrary::GetSearchIndexPath(first)));
+}
@@ -0,0 +1,102 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Session search dialog implementation.
+#include "sawbuck/viewer/session_search_dialog.h"
+
+#include "base/logging.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/win/scoped_bstr.h"
+
+namespace {
+
+// No more rows than this are listed for a search.
+const size_t kMaxHits = 1000;
+
+}  // namespace
+
+SessionSearchDialog::SessionSearchDialog(SessionLibrary* library,
+                                         const std::string& text)
+    : library_(library), text_(text) {
+  DCHECK(library != NULL);
+}
+
+SessionSearchDialog::~SessionSearchDialog() {
+}
+
+LRESULT SessionSearchDialog::OnInitDialog(CWindow focus_window,
+                                          LPARAM init_param) {
+  CWindow text_wnd(GetDlgItem(IDC_SESSION_SEARCH_TEXT));
+  text_wnd.SetFocus();
+  if (!text_.empty()) {
+    text_wnd.SetWindowText(base::UTF8ToWide(text_).c_str());
+    text_wnd.SendMessage(EM_SETSEL, 0, -1);
+  }
+  return FALSE;
+}
+
+LRESULT SessionSearchDialog::OnSearch(UINT notify_code, int id,
+                                      CWindow window) {
+  CWindow text_wnd(GetDlgItem(IDC_SESSION_SEARCH_TEXT));
+  base::win::ScopedBstr text;
+  text_wnd.GetWindowText(text.Receive());
+  std::string search_text;
+  if (text.Length())
+    base::WideToUTF8(text, text.Length(), &search_text);
+  base::TrimWhitespaceASCII(search_text, base::TRIM_ALL, &search_text);
+  if (search_text.empty()) {
+    text_wnd.SetFocus();
+    return 0;
+  }
+
+  text_ = search_text;
+  library_->Search(text_, kMaxHits, &hits_);
+
+  // Each row lists as the name of its file, its row and its message.
+  CWindow results_wnd(GetDlgItem(IDC_SESSION_SEARCH_RESULTS));
+  results_wnd.SendMessage(LB_RESETCONTENT);
+  for (size_t i = 0; i < hits_.size(); ++i) {
+    const SessionLibrary::Hit& hit = hits_[i];
+    std::wstring line = base::StringPrintf(L"%ls (%d): %ls",
+        library_->paths()[hit.file].BaseName().value().c_str(), hit.row,
+        base::UTF8ToWide(hit.message).c_str());
+    results_wnd.SendMessage(LB_ADDSTRING, 0,
+                            reinterpret_cast<LPARAM>(line.c_str()));
+  }
+  if (hits_.empty()) {
+    results_wnd.SendMessage(LB_ADDSTRING, 0,
+                            reinterpret_cast<LPARAM>(L"No rows found."));
+  }
+  text_wnd.SetFocus();
+  return 0;
+}
+
+LRESULT SessionSearchDialog::OnPickHit(UINT notify_code, int id,
+                                       CWindow window) {
+  LRESULT selected = window.SendMessage(LB_GETCURSEL);
+  if (selected < 0 || static_cast<size_t>(selected) >= hits_.size())
+    return 0;
+
+  hit_ = hits_[selected];
+  EndDialog(IDOK);
+  return 0;
+}
+
+LRESULT SessionSearchDialog::OnCancel(UINT notify_code, int id,
+                                      CWindow window) {
+  EndDialog(IDCANCEL);
+  return 0;
+}
@@ -0,0 +1,63 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Session search dialog declaration.
+#ifndef SAWBUCK_VIEWER_SESSION_SEARCH_DIALOG_H_
+#define SAWBUCK_VIEWER_SESSION_SEARCH_DIALOG_H_
+
+#include <atlbase.h>
+#include <atlcrack.h>
+#include <atlwin.h>
+#include <string>
+#include <vector>
+#include "resource.h"
+#include "sawbuck/viewer/session_library.h"
+
+// Searches the files of a session library and lists the rows found, until
+// closed or a row is picked to open.
+class SessionSearchDialog : public CDialogImpl<SessionSearchDialog> {
+ public:
+  enum { IDD = IDD_SESSIONSEARCHDIALOG };
+
+  BEGIN_MSG_MAP(SessionSearchDialog)
+    MSG_WM_INITDIALOG(OnInitDialog)
+    COMMAND_ID_HANDLER_EX(IDOK, OnSearch)
+    COMMAND_ID_HANDLER_EX(IDCANCEL, OnCancel)
+    COMMAND_HANDLER_EX(IDC_SESSION_SEARCH_RESULTS, LBN_DBLCLK, OnPickHit)
+  END_MSG_MAP()
+
+  // @param library the library to search, which must outlive the dialog.
+  // @param text the text the dialog starts out with, UTF8 encoded.
+  SessionSearchDialog(SessionLibrary* library, const std::string& text);
+  ~SessionSearchDialog();
+
+  LRESULT OnInitDialog(CWindow focus_window, LPARAM init_param);
+  LRESULT OnSearch(UINT notify_code, int id, CWindow window);
+  LRESULT OnPickHit(UINT notify_code, int id, CWindow window);
+  LRESULT OnCancel(UINT notify_code, int id, CWindow window);
+
+  // The text last searched for, UTF8 encoded.
+  const std::string& text() const { return text_; }
+
+  // The row picked, valid once the dialog ends with IDOK.
+  const SessionLibrary::Hit& hit() const { return hit_; }
+
+ protected:
+  SessionLibrary* library_;
+  std::string text_;
+  std::vector<SessionLibrary::Hit> hits_;
+  SessionLibrary::Hit hit_;
+};
+
+#endif  // SAWBUCK_VIEWER_SESSION_SEARCH_DIALOG_H_
@@ -0,0 +1,354 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Time sorted log view implementation.
+#include "sawbuck/viewer/sorted_log_view.h"
+
+#include <algorithm>
+#include <functional>
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/message_loop/message_loop.h"
+#include "sawbuck/common/perf_counters.h"
+
+namespace {
+
+PerfCounter merge_chunk_counter("Sort.MergeChunk", 1);
+
+}  // namespace
+
+const size_t SortedLogView::kMergeChunkRows;
+
+struct SortedLogView::RowLess {
+  explicit RowLess(ILogView* view) : view(view) {
+  }
+
+  bool operator()(int row, int other_row) const {
+    base::Time time(view->GetTime(row));
+    base::Time other_time(view->GetTime(other_row));
+    if (time != other_time)
+      return time < other_time;
+    return row < other_row;
+  }
+
+  ILogView* view;
+};
+
+SortedLogView::SortedLogView(ILogView* original)
+    : first_row_(0), sorted_rows_(0), merge_begin_(0), merge_row_(0),
+      merge_pending_row_(0), original_(original), registration_cookie_(0),
+      next_sink_cookie_(1) {
+  DCHECK(original_ != NULL);
+  original_->Register(this, &registration_cookie_);
+  sorted_rows_ = original_->GetFirstRow();
+  AddNewRows();
+}
+
+SortedLogView::~SortedLogView() {
+  // Make sure we're not pinged post-destruction.
+  if (!task_.IsCancelled())
+    task_.Cancel();
+
+  original_->Unregister(registration_cookie_);
+}
+
+void SortedLogView::LogViewNewItems() {
+  AddNewRows();
+}
+
+void SortedLogView::LogViewCleared() {
+  CancelMerge();
+  rows_.clear();
+  pending_rows_.clear();
+  first_row_ = 0;
+  sorted_rows_ = original_->GetFirstRow();
+  NotifyCleared();
+}
+
+void SortedLogView::LogViewEvicted(int first_row) {
+  // The merge goes by positions in rows_, so it starts over.
+  CancelMerge();
+
+  // Our evicted rows are the leading rows that were evicted, the rest keep
+  // their numbers.
+  size_t num_evicted = 0;
+  while (num_evicted < rows_.size() && rows_[num_evicted] < first_row)
+    ++num_evicted;
+  rows_.erase(rows_.begin(), rows_.begin() + num_evicted);
+  first_row_ += static_cast<int>(num_evicted);
+
+  // Rows evicted from further on leave a gap, so the rows are renumbered.
+  std::vector<int>::iterator kept(
+      std::remove_if(rows_.begin(), rows_.end(),
+                     std::bind2nd(std::less<int>(), first_row)));
+  bool renumber = kept != rows_.end();
+  rows_.erase(kept, rows_.end());
+  pending_rows_.erase(
+      std::remove_if(pending_rows_.begin(), pending_rows_.end(),
+                     std::bind2nd(std::less<int>(), first_row)),
+      pending_rows_.end());
+  sorted_rows_ = std::max(sorted_rows_, first_row);
+
+  if (renumber) {
+    first_row_ = 0;
+    NotifyCleared();
+    NotifyNewItems();
+  } else if (num_evicted != 0) {
+    EventSinkMap::iterator it(event_sinks_.begin());
+    for (; it != event_sinks_.end(); ++it)
+      it->second->LogViewEvicted(first_row_);
+  }
+
+  if (!pending_rows_.empty())
+    StartMerge();
+}
+
+int SortedLogView::GetNumRows() {
+  return first_row_ + static_cast<int>(rows_.size());
+}
+
+int SortedLogView::GetFirstRow() {
+  return first_row_;
+}
+
+void SortedLogView::ClearAll() {
+  original_->ClearAll();
+}
+
+int SortedLogView::GetSeverity(int row) {
+  return original_->GetSeverity(GetOriginalRow(row));
+}
+
+DWORD SortedLogView::GetProcessId(int row) {
+  return original_->GetProcessId(GetOriginalRow(row));
+}
+
+DWORD SortedLogView::GetThreadId(int row) {
+  return original_->GetThreadId(GetOriginalRow(row));
+}
+
+base::Time SortedLogView::GetTime(int row) {
+  return original_->GetTime(GetOriginalRow(row));
+}
+
+std::string SortedLogView::GetFileName(int row) {
+  return original_->GetFileName(GetOriginalRow(row));
+}
+
+StringTable::Atom SortedLogView::GetFileAtom(int row) {
+  return original_->GetFileAtom(GetOriginalRow(row));
+}
+
+int SortedLogView::GetLine(int row) {
+  return original_->GetLine(GetOriginalRow(row));
+}
+
+std::string SortedLogView::GetMessage(int row) {
+  return original_->GetMessage(GetOriginalRow(row));
+}
+
+void SortedLogView::GetStackTrace(int row,
+                                  std::vector<sym_util::Address>* trace) {
+  return original_->GetStackTrace(GetOriginalRow(row), trace);
+}
+
+base::StringPiece SortedLogView::GetFileNamePiece(int row,
+                                                  std::string* buffer) {
+  return original_->GetFileNamePiece(GetOriginalRow(row), buffer);
+}
+
+base::StringPiece SortedLogView::GetMessagePiece(int row,
+                                                 std::string* buffer) {
+  return original_->GetMessagePiece(GetOriginalRow(row), buffer);
+}
+
+size_t SortedLogView::GetStackTracePiece(
+    int row,
+    const sym_util::Address** trace,
+    std::vector<sym_util::Address>* buffer) {
+  return original_->GetStackTracePiece(GetOriginalRow(row), trace, buffer);
+}
+
+StackTracePool::StackId SortedLogView::GetStackTraceId(int row) {
+  return original_->GetStackTraceId(GetOriginalRow(row));
+}
+
+bool SortedLogView::CollapsesRepeats() {
+  return original_->CollapsesRepeats();
+}
+
+int SortedLogView::GetRepeatCount(int row) {
+  return original_->GetRepeatCount(GetOriginalRow(row));
+}
+
+base::Time SortedLogView::GetLastTime(int row) {
+  return original_->GetLastTime(GetOriginalRow(row));
+}
+
+bool SortedLogView::IsLossMarker(int row) {
+  return original_->IsLossMarker(GetOriginalRow(row));
+}
+
+StackModuleIndex* SortedLogView::GetStackModuleIndex() {
+  // Our rows' traces are the original's.
+  return original_->GetStackModuleIndex();
+}
+
+ProcessInstanceIndex* SortedLogView::GetProcessInstanceIndex() {
+  // Our rows' processes are the original's.
+  return original_->GetProcessInstanceIndex();
+}
+
+const LogStore* SortedLogView::GetLogStore() {
+  // Our rows don't map to the original store row for row.
+  return NULL;
+}
+
+const LogStore* SortedLogView::GetMappedStore() {
+  // Our rows are the original's, reordered.
+  return original_->GetMappedStore();
+}
+
+int SortedLogView::GetStoreRow(int row) {
+  // The original is as a rule the store's own view, which maps trivially.
+  return original_->GetStoreRow(GetOriginalRow(row));
+}
+
+void SortedLogView::Register(ILogViewEvents* event_sink,
+                             int* registration_cookie) {
+  int cookie = next_sink_cookie_++;
+  event_sinks_.insert(std::make_pair(cookie, event_sink));
+  *registration_cookie = cookie;
+}
+
+void SortedLogView::Unregister(int registration_cookie) {
+  event_sinks_.erase(registration_cookie);
+}
+
+int SortedLogView::GetOriginalRow(int row) const {
+  DCHECK_LE(first_row_, row);
+  DCHECK_LT(row - first_row_, static_cast<int>(rows_.size()));
+  return rows_[row - first_row_];
+}
+
+void SortedLogView::AddNewRows() {
+  // The rows that come in during a merge are taken in once it's done.
+  if (is_merging())
+    return;
+
+  int num_rows = original_->GetNumRows();
+  int row = std::max(sorted_rows_, original_->GetFirstRow());
+  if (row >= num_rows)
+    return;
+
+  // Rows in order with the last are appended, the rest set aside.
+  size_t starting_rows = rows_.size();
+  RowLess less(original_);
+  for (; row < num_rows; ++row) {
+    if (rows_.empty() || !less(row, rows_.back()))
+      rows_.push_back(row);
+    else
+      pending_rows_.push_back(row);
+  }
+  sorted_rows_ = num_rows;
+
+  if (!pending_rows_.empty())
+    StartMerge();
+
+  if (rows_.size() != starting_rows)
+    NotifyNewItems();
+}
+
+void SortedLogView::StartMerge() {
+  DCHECK(!pending_rows_.empty());
+
+  RowLess less(original_);
+  std::sort(pending_rows_.begin(), pending_rows_.end(), less);
+
+  // The rows before the earliest pending row stay put.
+  merge_begin_ = std::upper_bound(rows_.begin(), rows_.end(),
+                                  pending_rows_.front(), less) -
+      rows_.begin();
+  merge_row_ = merge_begin_;
+  merge_pending_row_ = 0;
+  merged_rows_.clear();
+  merged_rows_.reserve(rows_.size() - merge_begin_ + pending_rows_.size());
+
+  PostMergeTask();
+}
+
+void SortedLogView::PostMergeTask() {
+  if (task_.IsCancelled()) {
+    task_.Reset(base::Bind(&SortedLogView::MergeChunk,
+                           base::Unretained(this)));
+    base::MessageLoop::current()->PostTask(FROM_HERE, task_.callback());
+  }
+}
+
+void SortedLogView::MergeChunk() {
+  ScopedPerfTimer timer(&merge_chunk_counter);
+  task_.Cancel();
+
+  RowLess less(original_);
+  size_t total = rows_.size() - merge_begin_ + pending_rows_.size();
+  size_t end = std::min(merged_rows_.size() + kMergeChunkRows, total);
+  while (merged_rows_.size() < end) {
+    if (merge_pending_row_ == pending_rows_.size() ||
+        (merge_row_ < rows_.size() &&
+         less(rows_[merge_row_], pending_rows_[merge_pending_row_]))) {
+      merged_rows_.push_back(rows_[merge_row_++]);
+    } else {
+      merged_rows_.push_back(pending_rows_[merge_pending_row_++]);
+    }
+  }
+
+  // Post again if we're not done.
+  if (merged_rows_.size() != total) {
+    PostMergeTask();
+    return;
+  }
+
+  // Publish the merge, our rows past |merge_begin_| move if there were any.
+  bool renumber = merge_begin_ != rows_.size();
+  rows_.resize(merge_begin_);
+  rows_.insert(rows_.end(), merged_rows_.begin(), merged_rows_.end());
+  std::vector<int>().swap(merged_rows_);
+  std::vector<int>().swap(pending_rows_);
+
+  if (renumber) {
+    first_row_ = 0;
+    NotifyCleared();
+  }
+  NotifyNewItems();
+
+  // Take in the rows that arrived meanwhile.
+  AddNewRows();
+}
+
+void SortedLogView::CancelMerge() {
+  task_.Cancel();
+  merged_rows_.clear();
+}
+
+void SortedLogView::NotifyNewItems() {
+  EventSinkMap::iterator it(event_sinks_.begin());
+  for (; it != event_sinks_.end(); ++it)
+    it->second->LogViewNewItems();
+}
+
+void SortedLogView::NotifyCleared() {
+  EventSinkMap::iterator it(event_sinks_.begin());
+  for (; it != event_sinks_.end(); ++it)
+    it->second->LogViewCleared();
+}
@@ -0,0 +1,142 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Time sorted log view declaration.
+#ifndef SAWBUCK_VIEWER_SORTED_LOG_VIEW_H_
+#define SAWBUCK_VIEWER_SORTED_LOG_VIEW_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/cancelable_callback.h"
+#include "sawbuck/viewer/log_list_view.h"
+
+// Provides a view on a log with its rows in time order, for logs whose
+// rows interleave sources that arrive out of order with one another, such
+// as several imported files. The view keeps the permutation of the
+// original's rows only, not copies of them.
+//
+// New rows that are in order with the rows seen so far are appended to
+// the view as they arrive, the others are set aside and merged in, in
+// chunks of rows, one chunk per task posted to the current message loop.
+// The outcome is published once the merge completes, and as rows move
+// the view then renumbers its rows, which sinks see as the view being
+// cleared and refilled.
+// @note ties in time go by original row.
+class SortedLogView
+    : public ILogViewEvents,
+      public ILogView {
+ public:
+  explicit SortedLogView(ILogView* original);
+  ~SortedLogView();
+
+  // ILogViewEvents implementation.
+  virtual void LogViewNewItems();
+  virtual void LogViewCleared();
+  virtual void LogViewEvicted(int first_row);
+
+  // ILogView implementation;
+  // @{
+  virtual int GetNumRows();
+  virtual int GetFirstRow();
+  virtual void ClearAll();
+  virtual int GetSeverity(int row);
+  virtual DWORD GetProcessId(int row);
+  virtual DWORD GetThreadId(int row);
+  virtual base::Time GetTime(int row);
+  virtual std::string GetFileName(int row);
+  virtual StringTable::Atom GetFileAtom(int row);
+  virtual int GetLine(int row);
+  virtual std::string GetMessage(int row);
+  virtual void GetStackTrace(int row, std::vector<sym_util::Address>* trace);
+  virtual base::StringPiece GetFileNamePiece(int row, std::string* buffer);
+  virtual base::StringPiece GetMessagePiece(int row, std::string* buffer);
+  virtual size_t GetStackTracePiece(int row,
+                                    const sym_util::Address** trace,
+                                    std::vector<sym_util::Address>* buffer);
+  virtual StackTracePool::StackId GetStackTraceId(int row);
+  virtual bool CollapsesRepeats();
+  virtual int GetRepeatCount(int row);
+  virtual base::Time GetLastTime(int row);
+  virtual bool IsLossMarker(int row);
+  virtual StackModuleIndex* GetStackModuleIndex();
+  virtual ProcessInstanceIndex* GetProcessInstanceIndex();
+  virtual const LogStore* GetLogStore();
+  virtual const LogStore* GetMappedStore();
+  virtual int GetStoreRow(int row);
+  virtual void Register(ILogViewEvents* event_sink,
+                        int* registration_cookie);
+  virtual void Unregister(int registration_cookie);
+  // @}
+
+  // @returns true while out of order rows are being merged in.
+  bool is_merging() const { return !task_.IsCancelled(); }
+
+  // The most rows merged per task.
+  static const size_t kMergeChunkRows = 64 * 1024;
+
+ protected:
+  // Orders original rows by time, then by row.
+  struct RowLess;
+
+  // Returns the row of |original_| our |row| is.
+  int GetOriginalRow(int row) const;
+
+  // Takes in the original's rows since last time, unless merging.
+  void AddNewRows();
+  // Sorts the rows set aside, and starts merging them in.
+  void StartMerge();
+  void PostMergeTask();
+  void MergeChunk();
+  // Drops the merge in progress, keeping the rows set aside.
+  void CancelMerge();
+
+  void NotifyNewItems();
+  void NotifyCleared();
+
+  // The original's rows in time order, our row |first_row_| on. The rows
+  // before are the rows evicted from |original_|, so the rows keep their
+  // numbers until the view is renumbered.
+  std::vector<int> rows_;
+  int first_row_;
+  // The original's rows up to this one have been taken in.
+  int sorted_rows_;
+
+  // The rows that arrived out of order, yet to be merged in.
+  std::vector<int> pending_rows_;
+
+  // The merge of the rows of rows_ from |merge_begin_| on with the
+  // pending rows, and the cursors on both.
+  std::vector<int> merged_rows_;
+  size_t merge_begin_;
+  size_t merge_row_;
+  size_t merge_pending_row_;
+
+  typedef base::CancelableCallback<void()> MergeCallback;
+
+  // Non-cancelled while a merge task is pending.
+  MergeCallback task_;
+
+  ILogView* original_;
+  int registration_cookie_;
+
+  typedef std::map<int, ILogViewEvents*> EventSinkMap;
+  EventSinkMap event_sinks_;
+  int next_sink_cookie_;
+
+  DISALLOW_COPY_AND_ASSIGN(SortedLogView);
+};
+
+#endif  // SAWBUCK_VIEWER_SORTED_LOG_VIEW_H_
@@ -0,0 +1,166 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "sawbuck/viewer/sorted_log_view.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/mock_log_view_interfaces.h"
+#include "sawbuck/viewer/test_log_view.h"
+
+namespace {
+
+using testing::_;
+using testing::InSequence;
+using testing::MockILogViewEvents;
+using testing::StrictMock;
+
+class SortedLogViewTest : public testing::TestLogViewTest {
+};
+
+}  // namespace
+
+TEST_F(SortedLogViewTest, InOrderRows) {
+  original_.AddRow(1);
+  original_.AddRow(2);
+  SortedLogView view(&original_);
+  EXPECT_FALSE(view.is_merging());
+  EXPECT_EQ(2, view.GetNumRows());
+
+  StrictMock<MockILogViewEvents> events;
+  int cookie = 0;
+  view.Register(&events, &cookie);
+
+  // Ties keep their order.
+  original_.AddRow(2);
+  original_.AddRow(3);
+  EXPECT_CALL(events, LogViewNewItems());
+  original_.NotifyNewItems();
+
+  EXPECT_FALSE(view.is_merging());
+  EXPECT_EQ(Rows(0, 1, 2, 3), GetRows(&view));
+  EXPECT_EQ(base::Time::FromDoubleT(3), view.GetTime(3));
+
+  view.Unregister(cookie);
+}
+
+TEST_F(SortedLogViewTest, MergesOutOfOrderRows) {
+  original_.AddRow(10);
+  original_.AddRow(30);
+  SortedLogView view(&original_);
+
+  StrictMock<MockILogViewEvents> events;
+  int cookie = 0;
+  view.Register(&events, &cookie);
+
+  // A second source, partly earlier than the first.
+  original_.AddRow(20);
+  original_.AddRow(5);
+  original_.NotifyNewItems();
+  EXPECT_TRUE(view.is_merging());
+  EXPECT_EQ(2, view.GetNumRows());
+
+  {
+    InSequence sequence;
+    EXPECT_CALL(events, LogViewCleared());
+    EXPECT_CALL(events, LogViewNewItems());
+  }
+  RunMessageLoopToIdle();
+
+  EXPECT_FALSE(view.is_merging());
+  EXPECT_EQ(Rows(3, 0, 2, 1), GetRows(&view));
+  EXPECT_EQ(0, view.FindRowForTime(base::Time::FromDoubleT(1)));
+  EXPECT_EQ(2, view.FindRowForTime(base::Time::FromDoubleT(15)));
+
+  view.Unregister(cookie);
+}
+
+TEST_F(SortedLogViewTest, RowsArrivingWhileMerging) {
+  original_.AddRow(10);
+  original_.AddRow(5);
+  SortedLogView view(&original_);
+  EXPECT_TRUE(view.is_merging());
+
+  // These wait for the merge.
+  original_.AddRow(20);
+  original_.AddRow(15);
+  original_.NotifyNewItems();
+  EXPECT_EQ(1, view.GetNumRows());
+
+  RunMessageLoopToIdle();
+  EXPECT_FALSE(view.is_merging());
+  EXPECT_EQ(Rows(1, 0, 3, 2), GetRows(&view));
+}
+
+TEST_F(SortedLogViewTest, Eviction) {
+  original_.AddRow(10);
+  original_.AddRow(20);
+  original_.AddRow(30);
+  original_.AddRow(40);
+  SortedLogView view(&original_);
+
+  StrictMock<MockILogViewEvents> events;
+  int cookie = 0;
+  view.Register(&events, &cookie);
+
+  // Leading rows keep the numbering.
+  EXPECT_CALL(events, LogViewEvicted(1));
+  original_.Evict(1);
+  EXPECT_EQ(1, view.GetFirstRow());
+  EXPECT_EQ(4, view.GetNumRows());
+  EXPECT_EQ(1, view.GetLine(1));
+
+  // An evicted row mid-view renumbers.
+  original_.AddRow(15);
+  original_.NotifyNewItems();
+  EXPECT_CALL(events, LogViewCleared());
+  EXPECT_CALL(events, LogViewNewItems());
+  RunMessageLoopToIdle();
+  EXPECT_EQ(0, view.GetFirstRow());
+  EXPECT_EQ(Rows(4, 1, 2, 3), GetRows(&view));
+
+  {
+    InSequence sequence;
+    EXPECT_CALL(events, LogViewCleared());
+    EXPECT_CALL(events, LogViewNewItems());
+  }
+  original_.Evict(2);
+  EXPECT_EQ(0, view.GetFirstRow());
+  std::vector<int> expected;
+  expected.push_back(4);
+  expected.push_back(2);
+  expected.push_back(3);
+  EXPECT_EQ(expected, GetRows(&view));
+
+  view.Unregister(cookie);
+}
+
+TEST_F(SortedLogViewTest, EvictionWhileMerging) {
+  original_.AddRow(10);
+  original_.AddRow(20);
+  original_.AddRow(5);
+  original_.AddRow(15);
+  SortedLogView view(&original_);
+  EXPECT_TRUE(view.is_merging());
+
+  // Evicting a pending row restarts the merge without it.
+  original_.Evict(3);
+  EXPECT_TRUE(view.is_merging());
+  RunMessageLoopToIdle();
+
+  EXPECT_FALSE(view.is_merging());
+  EXPECT_EQ(2, view.GetFirstRow());
+  ASSERT_EQ(3, view.GetNumRows());
+  EXPECT_EQ(3, view.GetLine(2));
+}
@@ -0,0 +1,250 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Stack module index implementation.
+#include "sawbuck/viewer/stack_module_index.h"
+
+#include <algorithm>
+#include "base/logging.h"
+#include "base/strings/string_util.h"
+#include "base/strings/utf_string_conversions.h"
+#include "sawbuck/log_lib/symbol_lookup_service.h"
+#include "sawbuck/viewer/log_list_view.h"
+
+namespace {
+
+// @returns the file name of the module at @p path, in lower case.
+std::string GetModuleName(const std::wstring& path) {
+  size_t separator = path.find_last_of(L"\\/:");
+  std::wstring name(separator == std::wstring::npos ?
+      path : path.substr(separator + 1));
+  return base::WideToUTF8(StringToLowerASCII(name));
+}
+
+// Retrieves the frames of @p row's trace in @p view to @p addresses.
+void GetAddresses(ILogView* view,
+                  int row,
+                  std::vector<sym_util::Address>* addresses) {
+  view->GetStackTrace(row, addresses);
+}
+
+}  // namespace
+
+const StackModuleIndex::SetId StackModuleIndex::kEmptySet;
+
+StackModuleIndex::NameSets::NameSets() {
+  // The empty set comes first, as kEmptySet.
+  sets_.push_back(Set());
+  set_ids_.insert(std::make_pair(Set(), kEmptySet));
+}
+
+StackModuleIndex::NameSets::~NameSets() {
+}
+
+StackModuleIndex::SetId StackModuleIndex::NameSets::Intern(
+    const std::vector<std::string>& names) {
+  Set set;
+  set.reserve(names.size());
+  for (size_t i = 0; i < names.size(); ++i) {
+    std::pair<std::map<std::string, NameId>::iterator, bool> inserted(
+        name_ids_.insert(std::make_pair(names[i], names_.size())));
+    if (inserted.second)
+      names_.push_back(names[i]);
+    set.push_back(inserted.first->second);
+  }
+  std::sort(set.begin(), set.end());
+  set.erase(std::unique(set.begin(), set.end()), set.end());
+
+  std::pair<std::map<Set, SetId>::iterator, bool> inserted(
+      set_ids_.insert(std::make_pair(set, sets_.size())));
+  if (inserted.second)
+    sets_.push_back(set);
+  return inserted.first->second;
+}
+
+void StackModuleIndex::NameSets::GetNames(
+    SetId set, std::vector<std::string>* names) const {
+  DCHECK_LT(set, sets_.size());
+  DCHECK(names != NULL);
+
+  const Set& ids = sets_[set];
+  names->resize(ids.size());
+  for (size_t i = 0; i < ids.size(); ++i)
+    (*names)[i] = names_[ids[i]];
+}
+
+StackModuleIndex::Trace::Trace()
+    : serial(0), has_modules(false), modules(kEmptySet),
+      module_generation(-1), has_functions(false), functions(kEmptySet) {
+}
+
+StackModuleIndex::StackModuleIndex(
+    const StackTracePool* pool, ISymbolLookupService* symbol_lookup_service)
+    : pool_(pool), symbol_lookup_service_(symbol_lookup_service) {
+  DCHECK(symbol_lookup_service != NULL);
+}
+
+StackModuleIndex::~StackModuleIndex() {
+}
+
+StackModuleIndex::SetId StackModuleIndex::GetModuleSet(ILogView* view,
+                                                       int row) {
+  DCHECK(view != NULL);
+  StackTracePool::StackId id = view->GetStackTraceId(row);
+  if (id == StackTracePool::kEmptyStack)
+    return kEmptySet;
+
+  uint32 serial = GetSerial(id);
+  if (serial != 0) {
+    base::AutoLock lock(lock_);
+    Trace* trace = GetTrace(id, serial);
+    // Frames outside of the modules may yet fall into modules loaded
+    // since, which the module generation tells of.
+    if (trace->has_modules &&
+        (trace->module_generation == -1 ||
+         trace->module_generation ==
+             symbol_lookup_service_->GetModuleGeneration())) {
+      return trace->modules;
+    }
+  }
+
+  int generation = symbol_lookup_service_->GetModuleGeneration();
+  std::vector<std::string> names;
+  bool complete = LookUpModules(view, row, &names);
+
+  base::AutoLock lock(lock_);
+  SetId set = module_sets_.Intern(names);
+  if (serial != 0) {
+    Trace* trace = GetTrace(id, serial);
+    trace->has_modules = true;
+    trace->modules = set;
+    trace->module_generation = complete ? -1 : generation;
+  }
+  return set;
+}
+
+StackModuleIndex::SetId StackModuleIndex::GetFunctionSet(ILogView* view,
+                                                         int row) {
+  DCHECK(view != NULL);
+  StackTracePool::StackId id = view->GetStackTraceId(row);
+  if (id == StackTracePool::kEmptyStack)
+    return kEmptySet;
+
+  uint32 serial = GetSerial(id);
+  if (serial != 0) {
+    base::AutoLock lock(lock_);
+    Trace* trace = GetTrace(id, serial);
+    if (trace->has_functions)
+      return trace->functions;
+  }
+
+  // The symbols are resolved without holding the lock, as they may take
+  // a while to load. Threads after the same trace resolve it alike.
+  std::vector<std::string> names;
+  ResolveFunctions(view, row, &names);
+
+  base::AutoLock lock(lock_);
+  SetId set = function_sets_.Intern(names);
+  if (serial != 0) {
+    Trace* trace = GetTrace(id, serial);
+    trace->has_functions = true;
+    trace->functions = set;
+  }
+  return set;
+}
+
+void StackModuleIndex::GetModuleNames(SetId set,
+                                      std::vector<std::string>* names) {
+  base::AutoLock lock(lock_);
+  module_sets_.GetNames(set, names);
+}
+
+void StackModuleIndex::GetFunctionNames(SetId set,
+                                        std::vector<std::string>* names) {
+  base::AutoLock lock(lock_);
+  function_sets_.GetNames(set, names);
+}
+
+size_t StackModuleIndex::num_module_sets() {
+  base::AutoLock lock(lock_);
+  return module_sets_.num_sets();
+}
+
+uint32 StackModuleIndex::GetSerial(StackTracePool::StackId id) const {
+  if (pool_ == NULL || id == StackTracePool::kUnknownStack)
+    return 0;
+  return pool_->GetSerial(id);
+}
+
+StackModuleIndex::Trace* StackModuleIndex::GetTrace(
+    StackTracePool::StackId id, uint32 serial) {
+  lock_.AssertAcquired();
+  DCHECK_NE(0U, serial);
+
+  if (id >= traces_.size())
+    traces_.resize(id + 1);
+  Trace* trace = &traces_[id];
+  if (trace->serial != serial) {
+    *trace = Trace();
+    trace->serial = serial;
+  }
+  return trace;
+}
+
+bool StackModuleIndex::LookUpModules(ILogView* view,
+                                     int row,
+                                     std::vector<std::string>* names) {
+  DCHECK(names != NULL);
+
+  std::vector<sym_util::Address> addresses;
+  GetAddresses(view, row, &addresses);
+  if (addresses.empty())
+    return true;
+
+  std::vector<sym_util::ModuleInformation> modules;
+  size_t found = symbol_lookup_service_->GetModulesForAddresses(
+      view->GetProcessId(row), view->GetTime(row), &addresses[0],
+      addresses.size(), &modules);
+  names->clear();
+  for (size_t i = 0; i < modules.size(); ++i) {
+    if (!modules[i].image_file_name.empty())
+      names->push_back(GetModuleName(modules[i].image_file_name));
+  }
+
+  return found == addresses.size();
+}
+
+void StackModuleIndex::ResolveFunctions(ILogView* view,
+                                        int row,
+                                        std::vector<std::string>* names) {
+  DCHECK(names != NULL);
+
+  std::vector<sym_util::Address> addresses;
+  GetAddresses(view, row, &addresses);
+  names->clear();
+  if (addresses.empty())
+    return;
+
+  std::vector<sym_util::ProcessId> process_ids(addresses.size(),
+                                               view->GetProcessId(row));
+  std::vector<base::Time> times(addresses.size(), view->GetTime(row));
+  std::vector<sym_util::SymbolRecord> symbols;
+  symbol_lookup_service_->ResolveAddressesNow(&process_ids[0], &times[0],
+                                              &addresses[0],
+                                              addresses.size(), &symbols);
+  for (size_t i = 0; i < symbols.size(); ++i) {
+    if (!symbols[i].name->empty())
+      names->push_back(base::WideToUTF8(*symbols[i].name));
+  }
+}
@@ -0,0 +1,148 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Stack module index declaration.
+#ifndef SAWBUCK_VIEWER_STACK_MODULE_INDEX_H_
+#define SAWBUCK_VIEWER_STACK_MODULE_INDEX_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/synchronization/lock.h"
+#include "sawbuck/viewer/stack_trace_pool.h"
+
+// Forward decls.
+class ILogView;
+class ISymbolLookupService;
+
+// Sums up the stack traces of a log by the modules and the functions their
+// frames are in, once per distinct trace rather than once per row, so that
+// filters on stacks cost about as much as the distinct traces they see.
+// Each trace maps to an interned set of module names, and on request to an
+// interned set of function names, which needs its symbols resolved. Traces
+// share their sets, so clients can tell the outcome of a match on a set by
+// its id, and set ids keep their meaning for the lifetime of the index.
+//
+// A trace is summed up in the context of the row it's first seen on. Where
+// the same trace turns up in processes that have their modules elsewhere,
+// the other rows are summed up alike.
+// @note this class is thread safe, and reads the views it's handed and the
+//     pool from the calling thread, which must be allowed to.
+class StackModuleIndex {
+ public:
+  // Identifies a set of names, of modules or functions.
+  typedef uint32 SetId;
+  // The empty set, of empty traces, and of traces no module knows.
+  static const SetId kEmptySet = 0;
+
+  // @param pool the pool of the traces the views' stack ids refer to, or
+  //     NULL if there's none, in which case nothing's kept per trace.
+  // @param symbol_lookup_service looks up the modules and symbols of the
+  //     frames.
+  // @note both must outlive the index.
+  StackModuleIndex(const StackTracePool* pool,
+                   ISymbolLookupService* symbol_lookup_service);
+  ~StackModuleIndex();
+
+  // @returns the set of the file names of the modules @p row's trace in
+  //     @p view passes through, in lower case.
+  SetId GetModuleSet(ILogView* view, int row);
+
+  // @returns the set of the names of the functions of @p row's trace in
+  //     @p view. A trace's symbols are resolved the first time this is
+  //     called for it, which may take a while, so this is for when the
+  //     modules leave a match undecided.
+  SetId GetFunctionSet(ILogView* view, int row);
+
+  // Retrieves the names of module set @p set to @p names, UTF8 encoded.
+  void GetModuleNames(SetId set, std::vector<std::string>* names);
+  // Retrieves the names of function set @p set to @p names, UTF8 encoded.
+  void GetFunctionNames(SetId set, std::vector<std::string>* names);
+
+  // @returns the number of distinct module sets, including the empty set.
+  size_t num_module_sets();
+
+ private:
+  // Interns names, and sets of them by the sorted ids of their names.
+  class NameSets {
+   public:
+    NameSets();
+    ~NameSets();
+
+    // @returns the id of the set of @p names, which may have duplicates.
+    SetId Intern(const std::vector<std::string>& names);
+    // Retrieves the names of @p set to @p names.
+    void GetNames(SetId set, std::vector<std::string>* names) const;
+
+    size_t num_sets() const { return sets_.size(); }
+
+   private:
+    typedef uint32 NameId;
+    typedef std::vector<NameId> Set;
+
+    std::map<std::string, NameId> name_ids_;
+    std::vector<std::string> names_;
+    std::map<Set, SetId> set_ids_;
+    std::vector<Set> sets_;
+
+    DISALLOW_COPY_AND_ASSIGN(NameSets);
+  };
+
+  // What we know of a trace of the pool, by its id in the stack pool.
+  struct Trace {
+    Trace();
+
+    // The trace's serial in the pool, zero for none.
+    uint32 serial;
+    bool has_modules;
+    SetId modules;
+    // The module generation of the symbol lookup service the modules were
+    // looked up at, or -1 if all the frames were found in a module.
+    int module_generation;
+    bool has_functions;
+    SetId functions;
+  };
+
+  // @returns the serial of trace @p id in pool_, or zero if the trace
+  //     can't be told apart from others, in which case it's summed up anew
+  //     each time.
+  uint32 GetSerial(StackTracePool::StackId id) const;
+
+  // @returns the entry of trace @p id with @p serial, reset if it was of
+  //     a trace since released.
+  // @note must be called under lock_.
+  Trace* GetTrace(StackTracePool::StackId id, uint32 serial);
+
+  // Looks up the modules of @p row's trace in @p view to @p names.
+  // @returns true iff all the frames are in a module.
+  bool LookUpModules(ILogView* view, int row, std::vector<std::string>* names);
+  // Resolves the functions of @p row's trace in @p view to @p names.
+  void ResolveFunctions(ILogView* view,
+                        int row,
+                        std::vector<std::string>* names);
+
+  const StackTracePool* pool_;
+  ISymbolLookupService* symbol_lookup_service_;
+
+  base::Lock lock_;
+  // The traces of the pool seen so far, by stack id.
+  std::vector<Trace> traces_;  // Under lock_.
+  NameSets module_sets_;  // Under lock_.
+  NameSets function_sets_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(StackModuleIndex);
+};
+
+#endif  // SAWBUCK_VIEWER_STACK_MODULE_INDEX_H_
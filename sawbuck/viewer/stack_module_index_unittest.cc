@@ -0,0 +1,332 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Stack module index unittests.
+#include "sawbuck/viewer/stack_module_index.h"
+
+#include <evntrace.h>
+#include <algorithm>
+#include "gtest/gtest.h"
+#include "sawbuck/log_lib/symbol_lookup_service.h"
+#include "sawbuck/viewer/filter.h"
+#include "sawbuck/viewer/filter_program.h"
+#include "sawbuck/viewer/log_store.h"
+#include "sawbuck/viewer/store_log_view.h"
+
+namespace {
+
+using testing::StoreLogView;
+
+// Knows of two modules, and names each function by its module.
+class FakeSymbolLookupService : public ISymbolLookupService {
+ public:
+  static const sym_util::Address kNetBase = 0x10000;
+  static const sym_util::Address kAppBase = 0x20000;
+  static const sym_util::ModuleSize kModuleSize = 0x1000;
+
+  FakeSymbolLookupService()
+      : app_loaded_(false), module_generation_(0), num_module_lookups_(0),
+        num_symbol_lookups_(0) {
+  }
+
+  // Forgets about the app module, as though it wasn't loaded yet.
+  void set_app_loaded(bool loaded) {
+    app_loaded_ = loaded;
+    ++module_generation_;
+  }
+
+  int num_module_lookups() const { return num_module_lookups_; }
+  int num_symbol_lookups() const { return num_symbol_lookups_; }
+
+  virtual Handle ResolveAddress(sym_util::ProcessId process_id,
+                                const base::Time& time,
+                                sym_util::Address address,
+                                const SymbolResolvedCallback& callback) {
+    ADD_FAILURE() << "Not reached.";
+    return kInvalidHandle;
+  }
+  virtual Handle ResolveAddresses(sym_util::ProcessId process_id,
+                                  const base::Time& time,
+                                  const sym_util::Address* addresses,
+                                  size_t num_addresses,
+                                  sym_util::SymbolLevel level,
+                                  const SymbolsResolvedCallback& callback) {
+    ADD_FAILURE() << "Not reached.";
+    return kInvalidHandle;
+  }
+  virtual Handle ResolveAddressesProgressively(
+      sym_util::ProcessId process_id,
+      const base::Time& time,
+      const sym_util::Address* addresses,
+      size_t num_addresses,
+      sym_util::SymbolLevel level,
+      Priority priority,
+      const base::TimeTicks& deadline,
+      const SymbolsProgressCallback& callback) {
+    ADD_FAILURE() << "Not reached.";
+    return kInvalidHandle;
+  }
+  virtual void PrefetchAddresses(sym_util::ProcessId process_id,
+                                 const base::Time& time,
+                                 const sym_util::Address* addresses,
+                                 size_t num_addresses) {
+  }
+  virtual void ResolveAddressesNow(
+      const sym_util::ProcessId* process_ids,
+      const base::Time* times,
+      const sym_util::Address* addresses,
+      size_t num_addresses,
+      std::vector<sym_util::SymbolRecord>* symbols) {
+    ++num_symbol_lookups_;
+    symbols->assign(num_addresses, sym_util::SymbolRecord());
+    for (size_t i = 0; i < num_addresses; ++i) {
+      if (IsIn(addresses[i], kNetBase))
+        (*symbols)[i].name = strings_.Intern(L"net::Connect");
+      else if (IsIn(addresses[i], kAppBase) && app_loaded_)
+        (*symbols)[i].name = strings_.Intern(L"base::MessageLoop::Run");
+    }
+  }
+  virtual size_t GetModulesForAddresses(
+      sym_util::ProcessId process_id,
+      const base::Time& time,
+      const sym_util::Address* addresses,
+      size_t num_addresses,
+      std::vector<sym_util::ModuleInformation>* modules) {
+    ++num_module_lookups_;
+    size_t found = 0;
+    modules->assign(num_addresses, sym_util::ModuleInformation());
+    for (size_t i = 0; i < num_addresses; ++i) {
+      if (IsIn(addresses[i], kNetBase)) {
+        (*modules)[i].image_file_name = L"C:\\Windows\\System32\\Net.dll";
+        ++found;
+      } else if (IsIn(addresses[i], kAppBase) && app_loaded_) {
+        (*modules)[i].image_file_name = L"C:\\App\\app.exe";
+        ++found;
+      }
+    }
+    return found;
+  }
+  virtual void CancelRequest(Handle request_handle) {
+  }
+  virtual void SetSymbolPath(const wchar_t* symbol_path) {
+  }
+  virtual int GetModuleGeneration() { return module_generation_; }
+
+ private:
+  static bool IsIn(sym_util::Address address, sym_util::Address base) {
+    return address >= base && address < base + kModuleSize;
+  }
+
+  bool app_loaded_;
+  int module_generation_;
+  int num_module_lookups_;
+  int num_symbol_lookups_;
+  sym_util::SymbolStringTable strings_;
+};
+
+sym_util::Address Frame(sym_util::Address base, int offset) {
+  return base + offset;
+}
+
+class StackModuleIndexTest : public testing::Test {
+ public:
+  StackModuleIndexTest()
+      : store_(&file_table_), index_(&store_.stack_pool(), &service_),
+        view_(&store_) {
+    view_.set_stack_module_index(&index_);
+  }
+
+  virtual void SetUp() {
+    service_.set_app_loaded(true);
+  }
+
+  // Adds a row with the trace of @p frames.
+  int AddRow(const sym_util::Address* frames, size_t depth) {
+    return store_.AddRow(TRACE_LEVEL_INFORMATION, 1, 2, base::Time::Now(),
+                         0, 0, "", depth, frames);
+  }
+
+  std::vector<std::string> GetModuleNames(int row) {
+    std::vector<std::string> names;
+    index_.GetModuleNames(index_.GetModuleSet(&view_, row), &names);
+    return names;
+  }
+
+ protected:
+  FakeSymbolLookupService service_;
+  StringTable file_table_;
+  LogStore store_;
+  StackModuleIndex index_;
+  StoreLogView view_;
+};
+
+TEST_F(StackModuleIndexTest, ModuleSets) {
+  const sym_util::Address kNetApp[] = {
+    Frame(FakeSymbolLookupService::kNetBase, 0x10),
+    Frame(FakeSymbolLookupService::kAppBase, 0x20),
+    Frame(FakeSymbolLookupService::kNetBase, 0x30),
+  };
+  const sym_util::Address kAppNet[] = {
+    Frame(FakeSymbolLookupService::kAppBase, 0x40),
+    Frame(FakeSymbolLookupService::kNetBase, 0x50),
+  };
+  int first = AddRow(kNetApp, arraysize(kNetApp));
+  int second = AddRow(kAppNet, arraysize(kAppNet));
+  int third = AddRow(kNetApp, arraysize(kNetApp));
+  int empty = AddRow(NULL, 0);
+
+  // Traces through the same modules share their set, whose names are in
+  // lower case, without directory.
+  StackModuleIndex::SetId set = index_.GetModuleSet(&view_, first);
+  EXPECT_NE(StackModuleIndex::kEmptySet, set);
+  EXPECT_EQ(set, index_.GetModuleSet(&view_, second));
+  EXPECT_EQ(set, index_.GetModuleSet(&view_, third));
+  EXPECT_EQ(StackModuleIndex::kEmptySet, index_.GetModuleSet(&view_, empty));
+  EXPECT_EQ(2U, index_.num_module_sets());
+
+  std::vector<std::string> names(GetModuleNames(first));
+  ASSERT_EQ(2U, names.size());
+  EXPECT_NE(names.end(), std::find(names.begin(), names.end(), "net.dll"));
+  EXPECT_NE(names.end(), std::find(names.begin(), names.end(), "app.exe"));
+
+  // Each distinct trace is looked up once.
+  EXPECT_EQ(2, service_.num_module_lookups());
+  EXPECT_EQ(0, service_.num_symbol_lookups());
+}
+
+TEST_F(StackModuleIndexTest, LooksUpAgainAfterModuleLoads) {
+  const sym_util::Address kTrace[] = {
+    Frame(FakeSymbolLookupService::kNetBase, 0x10),
+    Frame(FakeSymbolLookupService::kAppBase, 0x20),
+  };
+  service_.set_app_loaded(false);
+  int row = AddRow(kTrace, arraysize(kTrace));
+
+  EXPECT_EQ(1U, GetModuleNames(row).size());
+  EXPECT_EQ(1U, GetModuleNames(row).size());
+  EXPECT_EQ(1, service_.num_module_lookups());
+
+  // The frame outside of the modules may be in a module since loaded.
+  service_.set_app_loaded(true);
+  EXPECT_EQ(2U, GetModuleNames(row).size());
+  EXPECT_EQ(2U, GetModuleNames(row).size());
+  EXPECT_EQ(2, service_.num_module_lookups());
+}
+
+TEST_F(StackModuleIndexTest, ReusedStackIds) {
+  const sym_util::Address kNet[] = {
+    Frame(FakeSymbolLookupService::kNetBase, 0x10),
+  };
+  const sym_util::Address kApp[] = {
+    Frame(FakeSymbolLookupService::kAppBase, 0x10),
+  };
+  int row = AddRow(kNet, arraysize(kNet));
+  StackTracePool::StackId id = store_.GetStackTraceId(row);
+  EXPECT_EQ(std::vector<std::string>(1, "net.dll"), GetModuleNames(row));
+
+  // A new trace with the id of one released is looked up anew.
+  store_.Clear();
+  row = AddRow(kApp, arraysize(kApp));
+  ASSERT_EQ(id, store_.GetStackTraceId(row));
+  EXPECT_EQ(std::vector<std::string>(1, "app.exe"), GetModuleNames(row));
+  EXPECT_EQ(2, service_.num_module_lookups());
+}
+
+TEST_F(StackModuleIndexTest, FunctionSets) {
+  const sym_util::Address kTrace[] = {
+    Frame(FakeSymbolLookupService::kNetBase, 0x10),
+    Frame(FakeSymbolLookupService::kAppBase, 0x20),
+    Frame(FakeSymbolLookupService::kNetBase, 0x30),
+  };
+  int first = AddRow(kTrace, arraysize(kTrace));
+  int second = AddRow(kTrace, arraysize(kTrace));
+
+  StackModuleIndex::SetId set = index_.GetFunctionSet(&view_, first);
+  EXPECT_EQ(set, index_.GetFunctionSet(&view_, second));
+  EXPECT_EQ(1, service_.num_symbol_lookups());
+
+  std::vector<std::string> names;
+  index_.GetFunctionNames(set, &names);
+  std::sort(names.begin(), names.end());
+  ASSERT_EQ(2U, names.size());
+  EXPECT_EQ("base::MessageLoop::Run", names[0]);
+  EXPECT_EQ("net::Connect", names[1]);
+}
+
+TEST_F(StackModuleIndexTest, Filters) {
+  const sym_util::Address kNet[] = {
+    Frame(FakeSymbolLookupService::kNetBase, 0x10),
+  };
+  const sym_util::Address kApp[] = {
+    Frame(FakeSymbolLookupService::kAppBase, 0x10),
+  };
+  int net = AddRow(kNet, arraysize(kNet));
+  int app = AddRow(kApp, arraysize(kApp));
+  int empty = AddRow(NULL, 0);
+
+  Filter net_dll(Filter::STACK, Filter::IS, Filter::INCLUDE, L"NET.DLL");
+  EXPECT_TRUE(net_dll.Matches(&view_, net));
+  EXPECT_FALSE(net_dll.Matches(&view_, app));
+  EXPECT_FALSE(net_dll.Matches(&view_, empty));
+  // A value with a dot is only matched against the modules.
+  EXPECT_EQ(0, service_.num_symbol_lookups());
+
+  Filter message_loop(Filter::STACK, Filter::CONTAINS, Filter::EXCLUDE,
+                      L"MessageLoop");
+  EXPECT_FALSE(message_loop.Matches(&view_, net));
+  EXPECT_TRUE(message_loop.Matches(&view_, app));
+  EXPECT_FALSE(message_loop.Matches(&view_, empty));
+  EXPECT_EQ(2, service_.num_symbol_lookups());
+
+  // The modules match without the symbols.
+  Filter app_module(Filter::STACK, Filter::CONTAINS, Filter::INCLUDE,
+                    L"app");
+  EXPECT_TRUE(app_module.Matches(&view_, app));
+  EXPECT_EQ(2, service_.num_symbol_lookups());
+
+  // Views without an index match no stack filter.
+  StoreLogView no_index(&store_);
+  EXPECT_FALSE(net_dll.Matches(&no_index, net));
+}
+
+TEST_F(StackModuleIndexTest, FilterProgram) {
+  const sym_util::Address kNet[] = {
+    Frame(FakeSymbolLookupService::kNetBase, 0x10),
+  };
+  const sym_util::Address kApp[] = {
+    Frame(FakeSymbolLookupService::kAppBase, 0x10),
+  };
+  const int kNumRows = 1000;
+  for (int i = 0; i < kNumRows; ++i) {
+    if (i % 10 < 5)
+      AddRow(kNet, arraysize(kNet));
+    else
+      AddRow(kApp, arraysize(kApp));
+  }
+
+  std::vector<Filter> inclusion;
+  std::vector<Filter> exclusion;
+  exclusion.push_back(
+      Filter(Filter::STACK, Filter::IS, Filter::EXCLUDE, L"net.dll"));
+  FilterProgram program(inclusion, exclusion);
+  std::vector<int> rows;
+  program.Run(&view_, &store_, NULL, 0, kNumRows, &rows);
+
+  ASSERT_EQ(kNumRows / 2, rows.size());
+  for (size_t i = 0; i < rows.size(); ++i)
+    EXPECT_LE(5, rows[i] % 10);
+  EXPECT_EQ(2, service_.num_module_lookups());
+}
+
+}  // namespace
@@ -24,6 +24,15 @@ namespace {
 
 const int kNoItem = -1;
 
+// The shown trace goes ahead of the lookups due within this long.
+const int kResolutionDeadlineMs = 250;
+
+// @returns the file name of @p path, without directory.
+std::wstring GetFileName(const std::wstring& path) {
+  size_t separator = path.find_last_of(L"\\/");
+  return separator == std::wstring::npos ? path : path.substr(separator + 1);
+}
+
 }  // namespace
 
 using base::StringPrintf;
@@ -44,7 +53,10 @@ const wchar_t* StackTraceListView::kColumnWidthValueName =
     config::kStackTraceColumnWidths;
 
 StackTraceListView::StackTraceListView(CUpdateUIBase* update_ui)
-    : update_ui_(update_ui), lookup_service_(NULL), pid_(0) {
+    : update_ui_(update_ui), lookup_service_(NULL), pid_(0),
+      stack_id_(StackTracePool::kUnknownStack),
+      lookup_handle_(ISymbolLookupService::kInvalidHandle),
+      lookup_generation_(0), resolved_(false) {
   COMPILE_ASSERT(arraysize(kColumns) == COL_MAX,
                  wrong_number_of_column_names);
 }
@@ -56,19 +68,18 @@ void StackTraceListView::SetSymbolLookupService(
 
 void StackTraceListView::SetStackTrace(sym_util::ProcessId pid,
                                        const base::Time& time,
+                                       StackTracePool::StackId stack_id,
                                        size_t num_traces,
-                                       void* traces[]) {
+                                       const sym_util::Address traces[]) {
   pid_ = pid;
   time_ = time;
+  stack_id_ = stack_id;
 
-  // Cancel any in-progress symbol resolutions.
-  TraceList::iterator it(trace_.begin());
-  for (; it != trace_.end(); ++it)
-    CancelResolution(&*it);
+  // Cancel any in-progress symbol resolution.
+  CancelResolution();
+  resolved_ = false;
 
-  trace_.clear();
-  for (size_t i = 0; i < num_traces; ++i)
-    trace_.push_back(TraceItem(traces[i]));
+  trace_.assign(traces, traces + num_traces);
 
   DeleteAllItems();
 
@@ -82,6 +93,14 @@ void StackTraceListView::SetStackTrace(sym_util::ProcessId pid,
       SetItem(item, 1, LVIF_TEXT, LPSTR_TEXTCALLBACK, 0, 0, 0, NULL);
     }
   }
+
+  // A trace seen lately needn't go through the lookup service again.
+  const std::vector<sym_util::SymbolRecord>* symbols = FindCachedTrace();
+  if (symbols != NULL) {
+    resolved_ = true;
+    for (size_t row = 0; row < symbols->size(); ++row)
+      SetSymbolText(row, (*symbols)[row]);
+  }
 }
 
 LRESULT StackTraceListView::OnCreate(UINT msg,
@@ -111,12 +130,12 @@ LRESULT StackTraceListView::OnGetDispInfo(NMHDR* pnmh) {
   int col = info->item.iSubItem;
   size_t row = info->item.iItem;
 
-  sym_util::Address address = trace_[row].address_;
+  sym_util::Address address = trace_[row];
 
   if (col == COL_ADDRESS) {
     item_text_ = StringPrintf(L"0x%08llX", address);
   } else {
-    EnsureResolution(&trace_[row]);
+    EnsureResolution();
 
     switch (col) {
       case COL_MODULE:
@@ -148,65 +167,105 @@ LRESULT StackTraceListView::OnItemChanged(NMHDR* pnmh) {
   return 0;
 }
 
-void StackTraceListView::EnsureResolution(TraceItem* item) {
-  DCHECK(item != NULL);
-  if (item->lookup_handle_ != ISymbolLookupService::kInvalidHandle)
+void StackTraceListView::EnsureResolution() {
+  if (resolved_ || lookup_handle_ != ISymbolLookupService::kInvalidHandle)
     return;
 
+  // Resolve the whole trace in one request, as all of it is about to be
+  // shown anyway. We show the files and lines, but no mangled names. The
+  // modules come at once and the functions as soon as their symbols are
+  // loaded, so that slow symbols don't leave the trace blank meanwhile.
   DCHECK(lookup_service_ != NULL);
-  item->lookup_handle_ = lookup_service_->ResolveAddress(
-      pid_, time_, item->address_,
-      base::Bind(&StackTraceListView::SymbolResolved,
+  lookup_generation_ = lookup_service_->GetModuleGeneration();
+  lookup_handle_ = lookup_service_->ResolveAddressesProgressively(
+      pid_, time_, trace_.empty() ? NULL : &trace_[0], trace_.size(),
+      sym_util::SYMBOL_LINE, ISymbolLookupService::PRIORITY_HIGH,
+      base::TimeTicks::Now() +
+          base::TimeDelta::FromMilliseconds(kResolutionDeadlineMs),
+      base::Bind(&StackTraceListView::SymbolsResolved,
                  base::Unretained(this)));
 }
 
-void StackTraceListView::CancelResolution(TraceItem* item) {
-  DCHECK(item != NULL);
-  if (item->lookup_handle_ == ISymbolLookupService::kInvalidHandle)
+void StackTraceListView::CancelResolution() {
+  if (lookup_handle_ == ISymbolLookupService::kInvalidHandle)
     return;
 
   DCHECK(lookup_service_ != NULL);
-  lookup_service_->CancelRequest(item->lookup_handle_);
-  item->lookup_handle_ = ISymbolLookupService::kInvalidHandle;
+  lookup_service_->CancelRequest(lookup_handle_);
+  lookup_handle_ = ISymbolLookupService::kInvalidHandle;
 }
 
-void StackTraceListView::SymbolResolved(sym_util::ProcessId pid,
-    base::Time time, sym_util::Address address,
-    ISymbolLookupService::Handle handle, const sym_util::Symbol& symbol) {
+void StackTraceListView::SymbolsResolved(sym_util::ProcessId pid,
+    base::Time time, ISymbolLookupService::Handle handle,
+    const std::vector<sym_util::Address>& addresses,
+    const std::vector<sym_util::SymbolRecord>& symbols, bool final) {
+  // We should only hear of our current request.
+  DCHECK_EQ(lookup_handle_, handle);
+  DCHECK_EQ(trace_.size(), symbols.size());
+  if (final) {
+    // No longer pending, make sure we don't cancel it later.
+    lookup_handle_ = ISymbolLookupService::kInvalidHandle;
+    resolved_ = true;
+  }
 
-  size_t row = 0;
-  for (; row < trace_.size(); ++row) {
-    if (trace_[row].lookup_handle_ == handle)
-      break;
+  // Keep the symbols for the next time the trace is shown.
+  if (final && stack_id_ != StackTracePool::kUnknownStack &&
+      !trace_.empty()) {
+    cached_traces_.push_front(CachedTrace());
+    CachedTrace& cached = cached_traces_.front();
+    cached.pid = pid_;
+    cached.stack_id = stack_id_;
+    cached.generation = lookup_generation_;
+    cached.trace = trace_;
+    cached.symbols = symbols;
+    if (cached_traces_.size() > kMaxCachedTraces)
+      cached_traces_.pop_back();
   }
 
-  // We should always find our associated handle.
-  DCHECK(trace_[row].lookup_handle_ == handle);
-  // No longer pending, make sure we don't cancel it later.
-  trace_[row].lookup_handle_ = ISymbolLookupService::kInvalidHandle;
+  // Update all the rows, then repaint once.
+  SetRedraw(FALSE);
+  for (size_t row = 0; row < symbols.size(); ++row)
+    SetSymbolText(row, symbols[row]);
+  SetRedraw(TRUE);
+  Invalidate();
+}
 
+void StackTraceListView::SetSymbolText(
+    size_t row, const sym_util::SymbolRecord& symbol) {
   for (int col = COL_MODULE; col < COL_MAX; ++col) {
     std::wstring item_text;
     switch (col) {
       case COL_MODULE:
-        item_text = symbol.module.c_str();
+        item_text = symbol.module->c_str();
         break;
       case COL_FILE:
-        item_text = symbol.file.c_str();
+        if (symbol.level < sym_util::SYMBOL_LINE && !resolved_)
+          item_text = L"...";
+        else
+          item_text = symbol.file->c_str();
         break;
 
       case COL_LINE:
-        if (symbol.line != 0)
+        if (symbol.level < sym_util::SYMBOL_LINE && !resolved_)
+          item_text = L"...";
+        else if (symbol.line != 0)
           item_text = StringPrintf(L"%d", symbol.line);
         break;
 
       case COL_SYMBOL:
-        if (!symbol.name.empty() && symbol.offset != 0) {
+        if (symbol.level < sym_util::SYMBOL_FUNCTION) {
+          // Only the module is known, for now or for good.
+          if (!symbol.module->empty()) {
+            item_text = StringPrintf(L"%ls+0x%X",
+                                     GetFileName(*symbol.module).c_str(),
+                                     symbol.offset);
+          }
+        } else if (!symbol.name->empty() && symbol.offset != 0) {
           item_text = StringPrintf(L"%ls+0x%X",
-                                    symbol.name.c_str(),
+                                    symbol.name->c_str(),
                                     symbol.offset);
         } else {
-          item_text = symbol.name.c_str();
+          item_text = symbol.name->c_str();
         }
         break;
 
@@ -219,6 +278,33 @@ void StackTraceListView::SymbolResolved(sym_util::ProcessId pid,
   }
 }
 
+const std::vector<sym_util::SymbolRecord>*
+    StackTraceListView::FindCachedTrace() {
+  if (stack_id_ == StackTracePool::kUnknownStack || trace_.empty() ||
+      lookup_service_ == NULL) {
+    return NULL;
+  }
+
+  // The symbols are good only while no module has come or gone, as one
+  // may since occupy the trace's addresses.
+  int generation = lookup_service_->GetModuleGeneration();
+  std::list<CachedTrace>::iterator it = cached_traces_.begin();
+  while (it != cached_traces_.end()) {
+    if (it->generation != generation) {
+      it = cached_traces_.erase(it);
+      continue;
+    }
+
+    if (it->pid == pid_ && it->stack_id == stack_id_ && it->trace == trace_) {
+      cached_traces_.splice(cached_traces_.begin(), cached_traces_, it);
+      return &cached_traces_.front().symbols;
+    }
+    ++it;
+  }
+
+  return NULL;
+}
+
 void StackTraceListView::OnCopyCommand(UINT code, int id, CWindow window) {
   std::wstringstream selection;
 
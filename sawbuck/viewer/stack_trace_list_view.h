@@ -21,12 +21,14 @@
 #include <atlcrack.h>
 #include <atlctrls.h>
 #include <atlmisc.h>
+#include <list>
 #include <string>
 #include <vector>
 #include "base/time/time.h"
 #include "sawbuck/log_lib/symbol_lookup_service.h"
 #include "sawbuck/viewer/list_view_base.h"
 #include "sawbuck/viewer/resource.h"
+#include "sawbuck/viewer/stack_trace_pool.h"
 
 // Fwd.
 class ISymbolLookupService;
@@ -61,10 +63,17 @@ class StackTraceListView
   explicit StackTraceListView(CUpdateUIBase* update_ui);
 
   void SetSymbolLookupService(ISymbolLookupService* lookup_service);
+  // Shows the @p num_traces frames at @p traces, observed in @p pid at
+  // @p time. A trace with a @p stack_id other than kUnknownStack is shown
+  // at once if it was resolved lately, and no module has loaded since.
   void SetStackTrace(sym_util::ProcessId pid,
                      const base::Time& time,
+                     StackTracePool::StackId stack_id,
                      size_t num_traces,
-                     void* traces[]);
+                     const sym_util::Address traces[]);
+
+  // The most resolved traces we keep.
+  static const size_t kMaxCachedTraces = 32;
 
   // Our column definitions and config data to satisfy our contract
   // to the ListViewImpl superclass.
@@ -100,26 +109,23 @@ class StackTraceListView
   LRESULT OnGetDispInfo(NMHDR* notification);
   LRESULT OnItemChanged(NMHDR* notification);
 
-  struct TraceItem {
-    explicit TraceItem(void* address)
-        : lookup_handle_(ISymbolLookupService::kInvalidHandle),
-          address_(reinterpret_cast<sym_util::Address>(address)) {
-    }
-
-    // The lookup handle while a lookup is pending for address_.
-    ISymbolLookupService::Handle lookup_handle_;
-    sym_util::Address address_;
-  };
-
-  // Start resolving the address in item, unless it's already being resolved.
-  void EnsureResolution(TraceItem* item);
-  // Cancel any resolution pending for item.
-  void CancelResolution(TraceItem* item);
-
-  // Callback for symbol resolution.
-  void SymbolResolved(sym_util::ProcessId pid, base::Time time,
-      sym_util::Address address, ISymbolLookupService::Handle handle,
-      const sym_util::Symbol& symbol);
+  // Start resolving the addresses of the trace, unless they're already
+  // being resolved.
+  void EnsureResolution();
+  // Cancel any resolution pending for the trace.
+  void CancelResolution();
+
+  // Callback for symbol resolution of the whole trace, at each level it
+  // reaches, @p final at the last.
+  void SymbolsResolved(sym_util::ProcessId pid, base::Time time,
+      ISymbolLookupService::Handle handle,
+      const std::vector<sym_util::Address>& addresses,
+      const std::vector<sym_util::SymbolRecord>& symbols, bool final);
+  // Sets the text of the symbol columns of @p row from @p symbol.
+  void SetSymbolText(size_t row, const sym_util::SymbolRecord& symbol);
+  // Looks for trace_ among the traces resolved lately.
+  // @returns the symbols of trace_, or NULL if they're not cached.
+  const std::vector<sym_util::SymbolRecord>* FindCachedTrace();
 
   CUpdateUIBase* update_ui_;
 
@@ -129,9 +135,29 @@ class StackTraceListView
   // The current stack trace we're displaying.
   sym_util::ProcessId pid_;
   base::Time time_;
-  typedef std::vector<TraceItem> TraceList;
+  StackTracePool::StackId stack_id_;
+  typedef std::vector<sym_util::Address> TraceList;
   TraceList trace_;
 
+  // The lookup handle while a lookup is pending for trace_.
+  ISymbolLookupService::Handle lookup_handle_;
+  // The module generation the pending lookup was issued under.
+  int lookup_generation_;
+  // True once trace_ has been resolved.
+  bool resolved_;
+
+  // A trace resolved lately. Stack ids are reused as traces are evicted
+  // from the log, so the addresses are kept to tell the traces apart.
+  struct CachedTrace {
+    sym_util::ProcessId pid;
+    StackTracePool::StackId stack_id;
+    int generation;
+    TraceList trace;
+    std::vector<sym_util::SymbolRecord> symbols;
+  };
+  // The traces resolved lately, most recently shown first.
+  std::list<CachedTrace> cached_traces_;
+
   // Temporary storage for strings returned from OnGetDispInfo.
   std::wstring item_text_;
 };
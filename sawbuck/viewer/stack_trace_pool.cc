@@ -0,0 +1,215 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Stack trace pool implementation.
+#include "sawbuck/viewer/stack_trace_pool.h"
+
+#include <algorithm>
+#include "sawbuck/common/memory_footprint.h"
+
+const StackTracePool::StackId StackTracePool::kEmptyStack;
+const StackTracePool::StackId StackTracePool::kUnknownStack;
+const size_t StackTracePool::kMinBytesToCompact;
+
+StackTracePool::StackTracePool() : live_bytes_(0), next_serial_(1) {
+  // The empty trace is entry zero, and is never released.
+  entries_.push_back(Entry());
+}
+
+StackTracePool::~StackTracePool() {
+}
+
+void StackTracePool::EncodeFrames(const sym_util::Address* frames,
+                                  size_t depth,
+                                  std::vector<uint8>* bytes) {
+  DCHECK(bytes != NULL);
+  sym_util::Address previous = 0;
+  for (size_t i = 0; i < depth; ++i) {
+    // Zigzag encode the difference, so that small steps down are small.
+    uint64 delta = frames[i] - previous;
+    uint64 value = (delta << 1) ^ (0 - (delta >> 63));
+    previous = frames[i];
+
+    while (value >= 0x80) {
+      bytes->push_back(static_cast<uint8>(value) | 0x80);
+      value >>= 7;
+    }
+    bytes->push_back(static_cast<uint8>(value));
+  }
+}
+
+uint32 StackTracePool::Hash(const uint8* bytes, size_t size) {
+  // FNV-1a over the encoded frames.
+  uint32 hash = 2166136261U;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+StackTracePool::StackId StackTracePool::Lookup(const uint8* bytes,
+                                               size_t size,
+                                               uint32 hash) const {
+  std::pair<IdMap::const_iterator, IdMap::const_iterator> range(
+      ids_.equal_range(hash));
+  for (IdMap::const_iterator it = range.first; it != range.second; ++it) {
+    const Entry& entry = entries_[it->second];
+    // The encoding of each frame ends itself, so equal bytes are equal
+    // frames.
+    if (entry.size == size &&
+        std::equal(bytes, bytes + size, &bytes_[entry.offset])) {
+      return it->second;
+    }
+  }
+  return kUnknownStack;
+}
+
+StackTracePool::StackId StackTracePool::Intern(
+    const sym_util::Address* frames, size_t depth) {
+  DCHECK(frames != NULL || depth == 0);
+  if (depth == 0)
+    return kEmptyStack;
+
+  encoded_.clear();
+  EncodeFrames(frames, depth, &encoded_);
+  uint32 hash = Hash(&encoded_[0], encoded_.size());
+  StackId id = Lookup(&encoded_[0], encoded_.size(), hash);
+  if (id != kUnknownStack) {
+    ++entries_[id].ref_count;
+    return id;
+  }
+
+  if (free_ids_.empty()) {
+    id = entries_.size();
+    entries_.push_back(Entry());
+  } else {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+  }
+
+  Entry& entry = entries_[id];
+  entry.offset = bytes_.size();
+  entry.size = encoded_.size();
+  entry.depth = depth;
+  entry.ref_count = 1;
+  entry.hash = hash;
+  entry.serial = next_serial_++;
+  bytes_.insert(bytes_.end(), encoded_.begin(), encoded_.end());
+  live_bytes_ += entry.size;
+  ids_.insert(std::make_pair(hash, id));
+
+  return id;
+}
+
+StackTracePool::StackId StackTracePool::Find(
+    const sym_util::Address* frames, size_t depth) const {
+  DCHECK(frames != NULL || depth == 0);
+  if (depth == 0)
+    return kEmptyStack;
+
+  std::vector<uint8> encoded;
+  EncodeFrames(frames, depth, &encoded);
+  return Lookup(&encoded[0], encoded.size(),
+                Hash(&encoded[0], encoded.size()));
+}
+
+void StackTracePool::GetFrames(StackId id,
+                               std::vector<sym_util::Address>* frames) const {
+  DCHECK(frames != NULL);
+  const Entry& entry = GetEntry(id);
+  frames->resize(entry.depth);
+
+  const uint8* bytes = entry.size == 0 ? NULL : &bytes_[entry.offset];
+  sym_util::Address previous = 0;
+  for (size_t i = 0; i < entry.depth; ++i) {
+    uint64 value = 0;
+    int shift = 0;
+    uint8 byte = 0;
+    do {
+      byte = *bytes++;
+      value |= static_cast<uint64>(byte & 0x7F) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+
+    previous += (value >> 1) ^ (0 - (value & 1));
+    (*frames)[i] = previous;
+  }
+  DCHECK(entry.depth == 0 || bytes == &bytes_[entry.offset] + entry.size);
+}
+
+void StackTracePool::Release(StackId id) {
+  if (id == kEmptyStack)
+    return;
+
+  DCHECK_LT(id, entries_.size());
+  Entry& entry = entries_[id];
+  DCHECK_NE(0U, entry.ref_count);
+  if (--entry.ref_count != 0)
+    return;
+
+  std::pair<IdMap::iterator, IdMap::iterator> range(
+      ids_.equal_range(entry.hash));
+  IdMap::iterator it = range.first;
+  while (it != range.second && it->second != id)
+    ++it;
+  DCHECK(it != range.second);
+  ids_.erase(it);
+
+  free_ids_.push_back(id);
+  live_bytes_ -= entry.size;
+
+  size_t released_bytes = bytes_.size() - live_bytes_;
+  if (released_bytes >= kMinBytesToCompact &&
+      released_bytes >= live_bytes_) {
+    Compact();
+  }
+}
+
+void StackTracePool::Compact() {
+  std::vector<uint8> bytes;
+  bytes.reserve(live_bytes_);
+  for (size_t id = 1; id < entries_.size(); ++id) {
+    Entry& entry = entries_[id];
+    if (entry.ref_count == 0) {
+      entry.size = 0;
+      entry.depth = 0;
+      continue;
+    }
+
+    const uint8* begin = &bytes_[entry.offset];
+    entry.offset = bytes.size();
+    bytes.insert(bytes.end(), begin, begin + entry.size);
+  }
+  DCHECK_EQ(live_bytes_, bytes.size());
+  bytes_.swap(bytes);
+}
+
+void StackTracePool::Clear() {
+  std::vector<Entry>(1).swap(entries_);
+  std::vector<StackId>().swap(free_ids_);
+  std::vector<uint8>().swap(bytes_);
+  live_bytes_ = 0;
+  ids_.clear();
+}
+
+size_t StackTracePool::GetMemoryUsage() const {
+  size_t usage = 0;
+  usage += entries_.capacity() * sizeof(entries_[0]);
+  usage += free_ids_.capacity() * sizeof(free_ids_[0]);
+  usage += bytes_.capacity();
+  usage += encoded_.capacity();
+  usage += TreeFootprint(ids_);
+  return usage;
+}
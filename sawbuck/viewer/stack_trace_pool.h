@@ -0,0 +1,158 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Stack trace pool declaration.
+#ifndef SAWBUCK_VIEWER_STACK_TRACE_POOL_H_
+#define SAWBUCK_VIEWER_STACK_TRACE_POOL_H_
+
+#include <map>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "sawbuck/sym_util/types.h"
+
+// Interns the stack traces of log rows. Rows logged from the same call site
+// carry the same trace over and over, so rows refer to a shared copy of
+// their trace by a 32 bit id instead, and whatever derives from a trace,
+// like its symbols, can be worked out once per distinct trace. Traces are
+// reference counted, the ids of released traces are reused, and their
+// frames are reclaimed in bulk once they make up half the pool.
+// Frames are 64 bit addresses whatever the viewer's bitness, and are stored
+// as varints of their zigzag encoded difference from the frame before them.
+// The frames of a trace mostly lie in a few modules, so that most take two
+// to four bytes rather than eight.
+// @note a pool takes no lock. Its store interns, releases and compacts
+//     traces on the store's thread. The const members don't write, so the
+//     pool's tasks and the stack module index may read traces from any
+//     thread while the store doesn't change.
+class StackTracePool {
+ public:
+  typedef uint32 StackId;
+  // The id of the empty trace, which is always interned.
+  static const StackId kEmptyStack = 0;
+  // An id that no trace has, for views that don't intern their traces.
+  static const StackId kUnknownStack = static_cast<StackId>(-1);
+
+  StackTracePool();
+  ~StackTracePool();
+
+  // Adds a reference to the trace of the @p depth frames at @p frames,
+  // interning it if it's new.
+  // @returns the id of the trace.
+  StackId Intern(const sym_util::Address* frames, size_t depth);
+
+  // @returns the id of the trace of the @p depth frames at @p frames, or
+  //     kUnknownStack if it isn't interned.
+  StackId Find(const sym_util::Address* frames, size_t depth) const;
+
+  // Releases a reference to trace @p id, which goes when it has no more.
+  void Release(StackId id);
+
+  // Accessors for trace @p id, which must be referred to.
+  // @{
+  size_t GetDepth(StackId id) const {
+    return GetEntry(id).depth;
+  }
+  size_t GetRefCount(StackId id) const {
+    return GetEntry(id).ref_count;
+  }
+  // @returns the serial number of the trace, which no other trace interned
+  //     to the pool has had, for telling the traces of a reused id apart.
+  //     The empty trace's is zero.
+  uint32 GetSerial(StackId id) const {
+    return GetEntry(id).serial;
+  }
+  // @returns the bytes the frames of the trace take.
+  size_t GetBytes(StackId id) const {
+    return GetEntry(id).size;
+  }
+  // @}
+
+  // Retrieves the frames of trace @p id, which must be referred to, to
+  // @p frames.
+  void GetFrames(StackId id, std::vector<sym_util::Address>* frames) const;
+
+  // @returns the number of distinct traces referred to, including the
+  //     empty trace.
+  size_t num_stacks() const { return entries_.size() - free_ids_.size(); }
+
+  // @returns the bytes the frames of the traces referred to take.
+  size_t live_bytes() const { return live_bytes_; }
+
+  // Releases all traces and their storage.
+  void Clear();
+
+  // @returns an estimate of the heap memory used by the pool.
+  size_t GetMemoryUsage() const;
+
+  // Released frames are only reclaimed once they take at least this many
+  // bytes.
+  static const size_t kMinBytesToCompact = 16 * 1024;
+
+ private:
+  struct Entry {
+    Entry() : offset(0), size(0), depth(0), ref_count(0), hash(0),
+        serial(0) {
+    }
+
+    // The frames of the trace are encoded in bytes_[offset] up to
+    // bytes_[offset + size].
+    uint32 offset;
+    uint32 size;
+    uint32 depth;
+    uint32 ref_count;
+    uint32 hash;
+    uint32 serial;
+  };
+
+  const Entry& GetEntry(StackId id) const {
+    DCHECK_LT(id, entries_.size());
+    DCHECK(id == kEmptyStack || entries_[id].ref_count != 0);
+    return entries_[id];
+  }
+
+  // Appends the encoding of the @p depth frames at @p frames to @p bytes.
+  static void EncodeFrames(const sym_util::Address* frames, size_t depth,
+                           std::vector<uint8>* bytes);
+
+  static uint32 Hash(const uint8* bytes, size_t size);
+
+  // @returns the id of the trace of the @p size encoded bytes at @p bytes,
+  //     which hash to @p hash, or kUnknownStack if it isn't interned.
+  StackId Lookup(const uint8* bytes, size_t size, uint32 hash) const;
+
+  // Drops the frames of released traces from bytes_.
+  void Compact();
+
+  // The traces by id, the ids of released traces are in free_ids_.
+  std::vector<Entry> entries_;
+  std::vector<StackId> free_ids_;
+
+  // The encoded frames of all traces, back to back.
+  std::vector<uint8> bytes_;
+  // The number of bytes_ of traces referred to.
+  size_t live_bytes_;
+  // Scratch space for the encoding of the trace being interned.
+  std::vector<uint8> encoded_;
+  // The serial number of the next new trace, which carries on past Clear.
+  uint32 next_serial_;
+
+  // Maps from the hash of each trace referred to to its id.
+  typedef std::multimap<uint32, StackId> IdMap;
+  IdMap ids_;
+
+  DISALLOW_COPY_AND_ASSIGN(StackTracePool);
+};
+
+#endif  // SAWBUCK_VIEWER_STACK_TRACE_POOL_H_
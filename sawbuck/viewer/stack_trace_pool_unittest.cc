@@ -0,0 +1,166 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Stack trace pool unit tests.
+#include "sawbuck/viewer/stack_trace_pool.h"
+
+#include <vector>
+#include "gtest/gtest.h"
+
+namespace {
+
+const sym_util::Address kTrace[] = {
+  0x10001000,
+  0x10002000,
+  0x10003000,
+};
+
+class StackTracePoolTest : public testing::Test {
+ protected:
+  // @returns the frames of trace @p id.
+  std::vector<sym_util::Address> GetTrace(StackTracePool::StackId id) {
+    std::vector<sym_util::Address> frames;
+    pool_.GetFrames(id, &frames);
+    return frames;
+  }
+
+  StackTracePool pool_;
+};
+
+TEST_F(StackTracePoolTest, EmptyTrace) {
+  EXPECT_EQ(StackTracePool::kEmptyStack, pool_.Intern(NULL, 0));
+  EXPECT_EQ(0, pool_.GetDepth(StackTracePool::kEmptyStack));
+  EXPECT_TRUE(GetTrace(StackTracePool::kEmptyStack).empty());
+
+  // Releasing the empty trace does nothing.
+  pool_.Release(StackTracePool::kEmptyStack);
+  EXPECT_EQ(1, pool_.num_stacks());
+  EXPECT_EQ(0, pool_.live_bytes());
+}
+
+TEST_F(StackTracePoolTest, InternsEqualTraces) {
+  StackTracePool::StackId id = pool_.Intern(kTrace, arraysize(kTrace));
+  EXPECT_NE(StackTracePool::kEmptyStack, id);
+  EXPECT_EQ(id, pool_.Intern(kTrace, arraysize(kTrace)));
+  EXPECT_EQ(2, pool_.GetRefCount(id));
+  EXPECT_EQ(std::vector<sym_util::Address>(kTrace,
+                                           kTrace + arraysize(kTrace)),
+            GetTrace(id));
+
+  // A prefix is a different trace.
+  StackTracePool::StackId prefix = pool_.Intern(kTrace, 2);
+  EXPECT_NE(id, prefix);
+  EXPECT_EQ(std::vector<sym_util::Address>(kTrace, kTrace + 2),
+            GetTrace(prefix));
+
+  EXPECT_EQ(3, pool_.num_stacks());
+  EXPECT_EQ(pool_.GetBytes(id) + pool_.GetBytes(prefix), pool_.live_bytes());
+}
+
+TEST_F(StackTracePoolTest, Find) {
+  EXPECT_EQ(StackTracePool::kEmptyStack, pool_.Find(NULL, 0));
+  EXPECT_EQ(StackTracePool::kUnknownStack,
+            pool_.Find(kTrace, arraysize(kTrace)));
+
+  StackTracePool::StackId id = pool_.Intern(kTrace, arraysize(kTrace));
+  EXPECT_EQ(id, pool_.Find(kTrace, arraysize(kTrace)));
+  EXPECT_EQ(StackTracePool::kUnknownStack, pool_.Find(kTrace, 1));
+  // Finding a trace doesn't refer to it.
+  EXPECT_EQ(1, pool_.GetRefCount(id));
+}
+
+TEST_F(StackTracePoolTest, EncodesFramesCompactly) {
+  // Each frame is the difference from the one before it, so near frames
+  // take a few bytes whatever their width.
+  const sym_util::Address kWideTrace[] = {
+    0x00007FF612340000ULL,
+    0x00007FF612341234ULL,
+    0x00007FF612300000ULL,
+    0x00007FF8ABCD0010ULL,
+  };
+  StackTracePool::StackId id = pool_.Intern(kWideTrace,
+                                            arraysize(kWideTrace));
+  EXPECT_EQ(std::vector<sym_util::Address>(kWideTrace,
+                                           kWideTrace + arraysize(kWideTrace)),
+            GetTrace(id));
+  EXPECT_GT(arraysize(kWideTrace) * sizeof(kWideTrace[0]),
+            pool_.GetBytes(id));
+
+  // The difference wraps around for the farthest frames.
+  const sym_util::Address kFarTrace[] = {
+    0xFFFFFFFFFFFFFFF0ULL,
+    0x0000000000000010ULL,
+    0xFFFFFFFFFFFFFFFFULL,
+  };
+  id = pool_.Intern(kFarTrace, arraysize(kFarTrace));
+  EXPECT_EQ(std::vector<sym_util::Address>(kFarTrace,
+                                           kFarTrace + arraysize(kFarTrace)),
+            GetTrace(id));
+}
+
+TEST_F(StackTracePoolTest, ReleaseReusesIds) {
+  StackTracePool::StackId id = pool_.Intern(kTrace, arraysize(kTrace));
+  pool_.Intern(kTrace, arraysize(kTrace));
+  uint32 serial = pool_.GetSerial(id);
+
+  pool_.Release(id);
+  EXPECT_EQ(1, pool_.GetRefCount(id));
+  pool_.Release(id);
+  EXPECT_EQ(1, pool_.num_stacks());
+  EXPECT_EQ(0, pool_.live_bytes());
+
+  // The id goes to the next new trace, which has a serial of its own.
+  EXPECT_EQ(id, pool_.Intern(kTrace, 1));
+  EXPECT_EQ(std::vector<sym_util::Address>(kTrace, kTrace + 1),
+            GetTrace(id));
+  EXPECT_NE(serial, pool_.GetSerial(id));
+  EXPECT_EQ(0U, pool_.GetSerial(StackTracePool::kEmptyStack));
+}
+
+TEST_F(StackTracePoolTest, CompactsReleasedFrames) {
+  // Enough distinct traces to reclaim their frames, keeping every other.
+  const size_t kNumTraces = StackTracePool::kMinBytesToCompact;
+  std::vector<StackTracePool::StackId> ids;
+  std::vector<std::vector<sym_util::Address> > traces;
+  for (size_t i = 0; i < kNumTraces; ++i) {
+    std::vector<sym_util::Address> trace(kTrace, kTrace + arraysize(kTrace));
+    trace.push_back(i);
+    ids.push_back(pool_.Intern(&trace[0], trace.size()));
+    traces.push_back(trace);
+  }
+  size_t usage = pool_.GetMemoryUsage();
+
+  for (size_t i = 0; i < kNumTraces; i += 2)
+    pool_.Release(ids[i]);
+
+  EXPECT_EQ(kNumTraces / 2 + 1, pool_.num_stacks());
+  EXPECT_GT(usage, pool_.GetMemoryUsage());
+  for (size_t i = 1; i < kNumTraces; i += 2)
+    EXPECT_EQ(traces[i], GetTrace(ids[i]));
+
+  // The remaining traces are still found.
+  for (size_t i = 1; i < kNumTraces; i += 2)
+    EXPECT_EQ(ids[i], pool_.Intern(&traces[i][0], traces[i].size()));
+}
+
+TEST_F(StackTracePoolTest, Clear) {
+  pool_.Intern(kTrace, arraysize(kTrace));
+  pool_.Clear();
+
+  EXPECT_EQ(1, pool_.num_stacks());
+  EXPECT_EQ(0, pool_.live_bytes());
+  EXPECT_EQ(StackTracePool::kEmptyStack, pool_.Intern(NULL, 0));
+}
+
+}  // namespace
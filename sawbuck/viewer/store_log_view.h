@@ -0,0 +1,102 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// A log view on a store, for the tests and benchmarks.
+#ifndef SAWBUCK_VIEWER_STORE_LOG_VIEW_H_
+#define SAWBUCK_VIEWER_STORE_LOG_VIEW_H_
+
+#include <string>
+#include <vector>
+
+#include "sawbuck/viewer/log_list_view.h"
+#include "sawbuck/viewer/log_store.h"
+
+namespace testing {
+
+// A view on a log store, row for row. The store is the owner's to fill
+// and clear, the view raises no events.
+class StoreLogView : public ILogView {
+ public:
+  explicit StoreLogView(const LogStore* store)
+      : store_(store), stack_module_index_(NULL),
+        process_instance_index_(NULL), hide_store_(false) {
+  }
+
+  virtual int GetNumRows() { return store_->num_rows(); }
+  virtual int GetFirstRow() { return store_->first_row(); }
+  virtual void ClearAll() {}
+  virtual int GetSeverity(int row) { return store_->GetSeverity(row); }
+  virtual DWORD GetProcessId(int row) { return store_->GetProcessId(row); }
+  virtual DWORD GetThreadId(int row) { return store_->GetThreadId(row); }
+  virtual base::Time GetTime(int row) { return store_->GetTime(row); }
+  virtual std::string GetFileName(int row) {
+    return store_->GetFileName(row);
+  }
+  virtual StringTable::Atom GetFileAtom(int row) {
+    return store_->GetFileAtom(row);
+  }
+  virtual int GetLine(int row) { return store_->GetLine(row); }
+  virtual std::string GetMessage(int row) {
+    std::string buffer;
+    return store_->GetMessage(row, &buffer).as_string();
+  }
+  virtual void GetStackTrace(int row, std::vector<sym_util::Address>* trace) {
+    store_->GetStackTrace(row, trace);
+  }
+  virtual base::StringPiece GetFileNamePiece(int row, std::string* buffer) {
+    return store_->GetFileName(row);
+  }
+  virtual base::StringPiece GetMessagePiece(int row, std::string* buffer) {
+    return store_->GetMessage(row, buffer);
+  }
+  virtual StackTracePool::StackId GetStackTraceId(int row) {
+    return store_->GetStackTraceId(row);
+  }
+  virtual StackModuleIndex* GetStackModuleIndex() {
+    return stack_module_index_;
+  }
+  virtual ProcessInstanceIndex* GetProcessInstanceIndex() {
+    return process_instance_index_;
+  }
+  virtual int GetRepeatCount(int row) { return store_->GetRepeatCount(row); }
+  virtual base::Time GetLastTime(int row) { return store_->GetLastTime(row); }
+  virtual bool IsLossMarker(int row) { return store_->IsLossMarker(row); }
+  virtual const LogStore* GetLogStore() {
+    return hide_store_ ? NULL : store_;
+  }
+  virtual void Register(ILogViewEvents* event_sink,
+                        int* registration_cookie) {}
+  virtual void Unregister(int registration_cookie) {}
+
+  // The indexes the view hands out, NULL by default.
+  void set_stack_module_index(StackModuleIndex* index) {
+    stack_module_index_ = index;
+  }
+  void set_process_instance_index(ProcessInstanceIndex* index) {
+    process_instance_index_ = index;
+  }
+  // Hides the store from GetLogStore, so that the rows are only read
+  // through the accessors.
+  void set_hide_store(bool hide_store) { hide_store_ = hide_store; }
+
+ private:
+  const LogStore* store_;
+  StackModuleIndex* stack_module_index_;
+  ProcessInstanceIndex* process_instance_index_;
+  bool hide_store_;
+};
+
+}  // namespace testing
+
+#endif  // SAWBUCK_VIEWER_STORE_LOG_VIEW_H_
@@ -0,0 +1,145 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// A fake log view and a fixture for the tests of the views stacked on it.
+#ifndef SAWBUCK_VIEWER_TEST_LOG_VIEW_H_
+#define SAWBUCK_VIEWER_TEST_LOG_VIEW_H_
+
+#include <string>
+#include <vector>
+
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "gtest/gtest.h"
+#include "sawbuck/log_lib/string_table.h"
+#include "sawbuck/viewer/log_list_view.h"
+
+namespace testing {
+
+// A log of rows that have a process, a thread, a file and a time, the line
+// of a row is its row. The view tells the last sink registered of its
+// changes as the test asks it to.
+class TestLogView : public ILogView {
+ public:
+  TestLogView() : first_row_(0), event_sink_(NULL) {
+  }
+
+  // Appends a row.
+  void AddRow(DWORD pid, DWORD tid, const char* file, int seconds) {
+    pids_.push_back(pid);
+    tids_.push_back(tid);
+    files_.push_back(file_table_.Intern(file));
+    times_.push_back(base::Time::FromDoubleT(seconds));
+  }
+  // Appends a row at @p seconds, without process, thread or file.
+  void AddRow(int seconds) {
+    AddRow(0, 0, "", seconds);
+  }
+  // Appends @p num_rows rows, the process of row r being r % 3 and its
+  // thread r % 5, without file or time.
+  void AddRows(int num_rows) {
+    for (int i = 0; i < num_rows; ++i) {
+      int row = GetNumRows();
+      AddRow(row % 3, row % 5, "", 0);
+    }
+  }
+
+  // Tells the sink of the rows added.
+  void NotifyNewItems() {
+    ASSERT_TRUE(event_sink_ != NULL);
+    event_sink_->LogViewNewItems();
+  }
+  // Evicts the rows before @p first_row, and tells the sink.
+  void Evict(int first_row) {
+    ASSERT_TRUE(event_sink_ != NULL);
+    first_row_ = first_row;
+    event_sink_->LogViewEvicted(first_row);
+  }
+  // Evicts the rows before @p first_row, quietly.
+  void set_first_row(int first_row) { first_row_ = first_row; }
+
+  virtual int GetNumRows() { return static_cast<int>(times_.size()); }
+  virtual int GetFirstRow() { return first_row_; }
+  virtual void ClearAll() {}
+  virtual int GetSeverity(int row) { return 0; }
+  virtual DWORD GetProcessId(int row) { return pids_[row]; }
+  virtual DWORD GetThreadId(int row) { return tids_[row]; }
+  virtual base::Time GetTime(int row) {
+    EXPECT_LE(first_row_, row);
+    return times_[row];
+  }
+  virtual std::string GetFileName(int row) {
+    return file_table_.GetString(files_[row]);
+  }
+  virtual StringTable::Atom GetFileAtom(int row) { return files_[row]; }
+  virtual int GetLine(int row) {
+    EXPECT_LE(first_row_, row);
+    return row;
+  }
+  virtual std::string GetMessage(int row) { return ""; }
+  virtual void GetStackTrace(int row, std::vector<sym_util::Address>* trace) {}
+  virtual const LogStore* GetLogStore() { return NULL; }
+  virtual void Register(ILogViewEvents* event_sink,
+                        int* registration_cookie) {
+    event_sink_ = event_sink;
+    *registration_cookie = 1;
+  }
+  virtual void Unregister(int registration_cookie) {
+    event_sink_ = NULL;
+  }
+
+ private:
+  StringTable file_table_;
+  std::vector<DWORD> pids_;
+  std::vector<DWORD> tids_;
+  std::vector<StringTable::Atom> files_;
+  std::vector<base::Time> times_;
+  int first_row_;
+  ILogViewEvents* event_sink_;
+};
+
+// A fixture for the tests of a view on a TestLogView.
+class TestLogViewTest : public Test {
+ public:
+  void RunMessageLoopToIdle() {
+    base::RunLoop run_loop;
+    run_loop.RunUntilIdle();
+  }
+
+  // Returns the original rows of @p view, in its order.
+  static std::vector<int> GetRows(ILogView* view) {
+    std::vector<int> rows;
+    for (int row = view->GetFirstRow(); row < view->GetNumRows(); ++row)
+      rows.push_back(view->GetLine(row));
+    return rows;
+  }
+
+  // Returns the rows @p row0 to @p row3, to compare with GetRows.
+  static std::vector<int> Rows(int row0, int row1, int row2, int row3) {
+    std::vector<int> rows;
+    rows.push_back(row0);
+    rows.push_back(row1);
+    rows.push_back(row2);
+    rows.push_back(row3);
+    return rows;
+  }
+
+ protected:
+  base::MessageLoop message_loop_;
+  TestLogView original_;
+};
+
+}  // namespace testing
+
+#endif  // SAWBUCK_VIEWER_TEST_LOG_VIEW_H_
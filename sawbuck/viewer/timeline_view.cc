@@ -0,0 +1,391 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Timeline view implementation.
+#include "sawbuck/viewer/timeline_view.h"
+
+#include <math.h>
+#include <algorithm>
+#include "base/logging.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+
+namespace {
+
+const UINT_PTR kRefreshTimerId = 1;
+const UINT kRefreshMs = 500;
+
+// The layout of the view, in pixels.
+const int kLabelWidth = 96;
+const int kRulerHeight = 18;
+const int kRowHeight = 14;
+// The depths drawn of each track, deeper spans are left out.
+const size_t kDepthRows = 4;
+const int kTrackHeight = kDepthRows * kRowHeight;
+// The least distance between ruler ticks.
+const int kMinTickSpacing = 80;
+// The least width of a span to label.
+const int kMinLabelWidth = 24;
+
+// The zoom per notch of the mouse wheel.
+const double kZoomStep = 1.25;
+const int64 kMinViewSpanUs = 1000;
+const int64 kMaxViewSpanUs = 24LL * 3600 * 1000 * 1000;
+
+const COLORREF kRulerColor = RGB(0xF0, 0xF0, 0xF0);
+const COLORREF kGridColor = RGB(0xD8, 0xD8, 0xD8);
+const COLORREF kIdleColor = RGB(0xDC, 0xE6, 0xF8);
+const COLORREF kBusyColor = RGB(0x20, 0x50, 0xB0);
+const COLORREF kNestedColor = RGB(0x70, 0x98, 0xD8);
+
+// The colors of spans, picked by their names.
+const COLORREF kSpanColors[] = {
+  RGB(0xF4, 0xB4, 0x84), RGB(0xA8, 0xD4, 0x8C), RGB(0x8C, 0xC4, 0xE8),
+  RGB(0xE8, 0xD0, 0x78), RGB(0xC8, 0xA8, 0xE0), RGB(0x90, 0xD8, 0xC8),
+  RGB(0xF0, 0xA0, 0xB8), RGB(0xC0, 0xC0, 0x98),
+};
+
+COLORREF SpanColor(const std::string& name) {
+  size_t hash = 0;
+  for (size_t i = 0; i < name.size(); ++i)
+    hash = hash * 31 + static_cast<unsigned char>(name[i]);
+  return kSpanColors[hash % arraysize(kSpanColors)];
+}
+
+// @returns the color @p fraction of the way from @p from to @p to.
+COLORREF Blend(COLORREF from, COLORREF to, double fraction) {
+  fraction = std::max(0.0, std::min(1.0, fraction));
+  return RGB(
+      GetRValue(from) + (GetRValue(to) - GetRValue(from)) * fraction,
+      GetGValue(from) + (GetGValue(to) - GetGValue(from)) * fraction,
+      GetBValue(from) + (GetBValue(to) - GetBValue(from)) * fraction);
+}
+
+}  // namespace
+
+TimelineView::TimelineView()
+    : span_index_(NULL),
+      view_span_(base::TimeDelta::FromMicroseconds(kMinViewSpanUs)),
+      fit_(true),
+      first_track_(0),
+      dragging_(false),
+      drag_x_(0) {
+}
+
+int TimelineView::OnCreate(LPCREATESTRUCT create_struct) {
+  SetTimer(kRefreshTimerId, kRefreshMs);
+  UpdateRange();
+
+  SetMsgHandled(FALSE);
+  return 1;
+}
+
+void TimelineView::OnDestroy() {
+  KillTimer(kRefreshTimerId);
+  SetMsgHandled(FALSE);
+}
+
+void TimelineView::OnTimer(UINT_PTR timer_id) {
+  if (timer_id != kRefreshTimerId) {
+    SetMsgHandled(FALSE);
+    return;
+  }
+
+  if (UpdateRange())
+    Invalidate();
+}
+
+bool TimelineView::UpdateRange() {
+  base::Time first, last;
+  if (span_index_ == NULL || !span_index_->GetTimeRange(&first, &last))
+    return false;
+
+  bool changed = first != capture_start_ || last != capture_end_;
+  capture_start_ = first;
+  capture_end_ = last;
+
+  if (fit_) {
+    view_start_ = first;
+    view_span_ = std::max(last - first,
+        base::TimeDelta::FromMicroseconds(kMinViewSpanUs));
+  }
+
+  return changed;
+}
+
+int TimelineView::TrackWidth(const CRect& client) {
+  return std::max(1, client.Width() - kLabelWidth);
+}
+
+base::Time TimelineView::TimeAt(int x, int track_width) const {
+  return view_start_ + base::TimeDelta::FromMicroseconds(
+      static_cast<int64>(static_cast<double>(x - kLabelWidth) *
+                         view_span_.InMicroseconds() / track_width));
+}
+
+BOOL TimelineView::OnEraseBkgnd(CDCHandle dc) {
+  // We paint all of our client area.
+  return TRUE;
+}
+
+void TimelineView::OnPaint(CDCHandle unused_dc) {
+  CPaintDC paint_dc(m_hWnd);
+  CMemoryDC dc(paint_dc.m_hDC, paint_dc.m_ps.rcPaint);
+
+  CRect client;
+  GetClientRect(&client);
+  dc.FillSolidRect(&client, ::GetSysColor(COLOR_WINDOW));
+
+  HFONT old_font = dc.SelectFont(AtlGetDefaultGuiFont());
+  dc.SetBkMode(TRANSPARENT);
+  dc.SetTextColor(::GetSysColor(COLOR_WINDOWTEXT));
+
+  tracks_.clear();
+  if (span_index_ != NULL)
+    span_index_->GetTracks(&tracks_);
+
+  if (tracks_.empty()) {
+    dc.DrawText(L"No trace event spans.", -1, &client,
+                DT_CENTER | DT_VCENTER | DT_SINGLELINE | DT_NOPREFIX);
+    dc.SelectFont(old_font);
+    return;
+  }
+
+  DrawRuler(dc.m_hDC, client);
+
+  first_track_ = std::min(first_track_, tracks_.size() - 1);
+  int top = client.top + kRulerHeight;
+  for (size_t i = first_track_; i < tracks_.size() && top < client.bottom;
+       ++i) {
+    const ISpanIndex::Track& track = tracks_[i];
+    CRect label(client.left, top, client.left + kLabelWidth,
+                top + kTrackHeight);
+    std::wstring text(base::StringPrintf(L"%d:%d",
+                                         track.process_id,
+                                         track.thread_id));
+    label.DeflateRect(4, 0);
+    dc.DrawText(text.c_str(), static_cast<int>(text.length()), &label,
+                DT_LEFT | DT_VCENTER | DT_SINGLELINE | DT_NOPREFIX);
+
+    CRect rect(client.left + kLabelWidth, top, client.right,
+               top + kTrackHeight);
+    DrawTrack(dc.m_hDC, track, rect);
+
+    top += kTrackHeight;
+    CRect grid(client.left, top, client.right, top + 1);
+    dc.FillSolidRect(&grid, kGridColor);
+    ++top;
+  }
+
+  dc.SelectFont(old_font);
+}
+
+void TimelineView::DrawRuler(CDCHandle dc, const CRect& client) {
+  CRect ruler(client.left, client.top, client.right,
+              client.top + kRulerHeight);
+  dc.FillSolidRect(&ruler, kRulerColor);
+
+  // Pick the least tick interval of the 1, 2, 5 series that spaces the
+  // ticks far enough apart to label.
+  int track_width = TrackWidth(client);
+  double min_tick_us = static_cast<double>(view_span_.InMicroseconds()) *
+      kMinTickSpacing / track_width;
+  int64 tick_us = 1;
+  int digits = 6;
+  while (tick_us < min_tick_us) {
+    if (tick_us * 2 >= min_tick_us) {
+      tick_us *= 2;
+    } else if (tick_us * 5 >= min_tick_us) {
+      tick_us *= 5;
+    } else {
+      tick_us *= 10;
+      digits = std::max(0, digits - 1);
+    }
+  }
+
+  // The ticks count from the start of the capture.
+  int64 start_us = (view_start_ - capture_start_).InMicroseconds();
+  int64 tick = start_us / tick_us * tick_us;
+  if (tick < start_us)
+    tick += tick_us;
+  int64 end_us = start_us + view_span_.InMicroseconds();
+  for (; tick <= end_us; tick += tick_us) {
+    int x = kLabelWidth + static_cast<int>(
+        static_cast<double>(tick - start_us) * track_width /
+        view_span_.InMicroseconds());
+    CRect mark(x, ruler.bottom - 4, x + 1, ruler.bottom);
+    dc.FillSolidRect(&mark, kBusyColor);
+
+    std::wstring text(base::StringPrintf(L"%.*fs", digits, tick / 1e6));
+    CRect label(x + 2, ruler.top, x + kMinTickSpacing, ruler.bottom);
+    dc.DrawText(text.c_str(), static_cast<int>(text.length()), &label,
+                DT_LEFT | DT_VCENTER | DT_SINGLELINE | DT_NOPREFIX);
+  }
+}
+
+void TimelineView::DrawTrack(CDCHandle dc, const ISpanIndex::Track& track,
+                             const CRect& rect) {
+  if (rect.Width() <= 0)
+    return;
+
+  int64 slice_us = view_span_.InMicroseconds() / rect.Width();
+  if (slice_us < SpanIndex::kFinestBucketUs)
+    DrawSpans(dc, track, rect);
+  else
+    DrawBuckets(dc, track, rect);
+}
+
+void TimelineView::DrawSpans(CDCHandle dc, const ISpanIndex::Track& track,
+                             const CRect& rect) {
+  base::Time view_end(view_start_ + view_span_);
+  span_index_->GetSpans(track, view_start_, view_end, &spans_);
+
+  double pixels_per_us = static_cast<double>(rect.Width()) /
+      view_span_.InMicroseconds();
+  for (size_t i = 0; i < spans_.size(); ++i) {
+    const ISpanIndex::Span& span = spans_[i];
+    if (span.depth >= kDepthRows)
+      continue;
+
+    double begin = (span.begin - view_start_).InMicroseconds() *
+        pixels_per_us;
+    double end = (span.end - view_start_).InMicroseconds() * pixels_per_us;
+    int left = rect.left + static_cast<int>(std::max(0.0, begin));
+    int right = rect.left + static_cast<int>(
+        std::min(static_cast<double>(rect.Width()), end));
+    if (right <= left)
+      right = left + 1;
+
+    int top = rect.top + static_cast<int>(span.depth) * kRowHeight;
+    CRect bar(left, top, right, top + kRowHeight - 1);
+    dc.FillSolidRect(&bar, SpanColor(*span.name));
+
+    if (bar.Width() >= kMinLabelWidth) {
+      std::wstring name(base::UTF8ToWide(*span.name));
+      bar.DeflateRect(2, 0);
+      dc.DrawText(name.c_str(), static_cast<int>(name.length()), &bar,
+                  DT_LEFT | DT_VCENTER | DT_SINGLELINE | DT_NOPREFIX |
+                  DT_END_ELLIPSIS);
+    }
+  }
+}
+
+void TimelineView::DrawBuckets(CDCHandle dc, const ISpanIndex::Track& track,
+                               const CRect& rect) {
+  base::Time view_end(view_start_ + view_span_);
+  span_index_->GetBuckets(track, view_start_, view_end, rect.Width(),
+                          &buckets_);
+
+  double slice_us = static_cast<double>(view_span_.InMicroseconds()) /
+      rect.Width();
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    const ISpanIndex::Bucket& bucket = buckets_[i];
+    if (bucket.span_count == 0)
+      continue;
+
+    // The top row shades how busy the thread was, the rows below show how
+    // deep the spans nested.
+    int x = rect.left + static_cast<int>(i);
+    double busy = bucket.busy.InMicroseconds() / slice_us;
+    CRect top_row(x, rect.top, x + 1, rect.top + kRowHeight - 1);
+    dc.FillSolidRect(&top_row, Blend(kIdleColor, kBusyColor, busy));
+
+    size_t rows = std::min(bucket.max_depth, kDepthRows);
+    if (rows > 1) {
+      CRect nested(x, rect.top + kRowHeight, x + 1,
+                   rect.top + static_cast<int>(rows) * kRowHeight - 1);
+      dc.FillSolidRect(&nested, kNestedColor);
+    }
+  }
+}
+
+BOOL TimelineView::OnMouseWheel(UINT flags, short delta, CPoint point) {
+  int notches = delta / WHEEL_DELTA;
+  if (notches == 0)
+    return TRUE;
+
+  if (flags & MK_SHIFT) {
+    // Scroll the tracks.
+    if (notches > 0)
+      first_track_ -= std::min(first_track_, static_cast<size_t>(notches));
+    else
+      first_track_ += -notches;
+    Invalidate();
+    return TRUE;
+  }
+
+  // Zoom about the time under the cursor.
+  ScreenToClient(&point);
+  CRect client;
+  GetClientRect(&client);
+  int track_width = TrackWidth(client);
+  base::Time anchor(TimeAt(std::max<int>(kLabelWidth, point.x),
+                           track_width));
+
+  double old_span = static_cast<double>(view_span_.InMicroseconds());
+  double new_span = old_span * pow(kZoomStep, -notches);
+  new_span = std::max(static_cast<double>(kMinViewSpanUs),
+                      std::min(static_cast<double>(kMaxViewSpanUs),
+                               new_span));
+
+  int64 anchor_offset = (anchor - view_start_).InMicroseconds();
+  view_start_ = anchor - base::TimeDelta::FromMicroseconds(
+      static_cast<int64>(anchor_offset * new_span / old_span));
+  view_span_ = base::TimeDelta::FromMicroseconds(
+      static_cast<int64>(new_span));
+  fit_ = false;
+  Invalidate();
+
+  return TRUE;
+}
+
+void TimelineView::OnLButtonDown(UINT flags, CPoint point) {
+  SetFocus();
+  SetCapture();
+  dragging_ = true;
+  drag_x_ = point.x;
+  drag_view_start_ = view_start_;
+}
+
+void TimelineView::OnLButtonUp(UINT flags, CPoint point) {
+  if (dragging_)
+    ReleaseCapture();
+}
+
+void TimelineView::OnLButtonDblClk(UINT flags, CPoint point) {
+  // Fit the capture back into view, and follow it.
+  fit_ = true;
+  first_track_ = 0;
+  UpdateRange();
+  Invalidate();
+}
+
+void TimelineView::OnMouseMove(UINT flags, CPoint point) {
+  if (!dragging_)
+    return;
+
+  CRect client;
+  GetClientRect(&client);
+  int64 offset_us = static_cast<int64>(
+      static_cast<double>(point.x - drag_x_) * view_span_.InMicroseconds() /
+      TrackWidth(client));
+  view_start_ = drag_view_start_ -
+      base::TimeDelta::FromMicroseconds(offset_us);
+  fit_ = false;
+  Invalidate();
+}
+
+void TimelineView::OnCaptureChanged(CWindow window) {
+  dragging_ = false;
+}
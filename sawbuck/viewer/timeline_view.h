@@ -0,0 +1,122 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Timeline view declaration.
+#ifndef SAWBUCK_VIEWER_TIMELINE_VIEW_H_
+#define SAWBUCK_VIEWER_TIMELINE_VIEW_H_
+
+#include <atlbase.h>
+#include <atlapp.h>
+#include <atlcrack.h>
+#include <atlgdi.h>
+#include <atlmisc.h>
+#include <atlwin.h>
+#include <vector>
+#include "base/time/time.h"
+#include "sawbuck/log_lib/span_index.h"
+
+// The timeline view draws the trace event spans of each thread as a track
+// of nested bars, a flame chart, against a time ruler. The mouse wheel
+// zooms about the cursor, dragging pans, shift and the wheel scrolls the
+// tracks, and a double click fits the whole capture back into view, which
+// then follows the capture as it grows.
+// Views finer than the finest level of detail of the span index draw and
+// label each span, coarser views draw a column per pixel from the index's
+// buckets, shaded by how busy the thread was, so the cost of a paint is
+// bound by the size of the window rather than by the spans in view.
+class TimelineView : public CWindowImpl<TimelineView> {
+ public:
+  DECLARE_WND_CLASS_EX(L"SawbuckTimelineView",
+                       CS_DBLCLKS | CS_HREDRAW | CS_VREDRAW,
+                       COLOR_WINDOW)
+
+  BEGIN_MSG_MAP_EX(TimelineView)
+    MSG_WM_CREATE(OnCreate)
+    MSG_WM_DESTROY(OnDestroy)
+    MSG_WM_TIMER(OnTimer)
+    MSG_WM_ERASEBKGND(OnEraseBkgnd)
+    MSG_WM_PAINT(OnPaint)
+    MSG_WM_MOUSEWHEEL(OnMouseWheel)
+    MSG_WM_LBUTTONDOWN(OnLButtonDown)
+    MSG_WM_LBUTTONUP(OnLButtonUp)
+    MSG_WM_LBUTTONDBLCLK(OnLButtonDblClk)
+    MSG_WM_MOUSEMOVE(OnMouseMove)
+    MSG_WM_CAPTURECHANGED(OnCaptureChanged)
+  END_MSG_MAP()
+
+  TimelineView();
+
+  // Sets the span index we draw, which must outlive us.
+  void set_span_index(ISpanIndex* span_index) { span_index_ = span_index; }
+
+ private:
+  int OnCreate(LPCREATESTRUCT create_struct);
+  void OnDestroy();
+  void OnTimer(UINT_PTR timer_id);
+  BOOL OnEraseBkgnd(CDCHandle dc);
+  void OnPaint(CDCHandle dc);
+  BOOL OnMouseWheel(UINT flags, short delta, CPoint point);
+  void OnLButtonDown(UINT flags, CPoint point);
+  void OnLButtonUp(UINT flags, CPoint point);
+  void OnLButtonDblClk(UINT flags, CPoint point);
+  void OnMouseMove(UINT flags, CPoint point);
+  void OnCaptureChanged(CWindow window);
+
+  // Reads the time range of the index, and fits it into view if following
+  // the capture.
+  // @returns true iff the range changed since the last call.
+  bool UpdateRange();
+
+  // @returns the width of the track area of @p client.
+  static int TrackWidth(const CRect& client);
+  // @returns the time at @p x of the track area.
+  base::Time TimeAt(int x, int track_width) const;
+
+  void DrawRuler(CDCHandle dc, const CRect& client);
+  void DrawTrack(CDCHandle dc, const ISpanIndex::Track& track,
+                 const CRect& rect);
+  void DrawSpans(CDCHandle dc, const ISpanIndex::Track& track,
+                 const CRect& rect);
+  void DrawBuckets(CDCHandle dc, const ISpanIndex::Track& track,
+                   const CRect& rect);
+
+  ISpanIndex* span_index_;
+
+  // The time at the left edge of the tracks, and the time across them.
+  base::Time view_start_;
+  base::TimeDelta view_span_;
+  // True while we fit the capture, until the user zooms or pans.
+  bool fit_;
+  // The first track at the top of the view.
+  size_t first_track_;
+
+  // Whether dragging, and the x and view start as the drag began.
+  bool dragging_;
+  int drag_x_;
+  base::Time drag_view_start_;
+
+  // The time range of the index as of the last UpdateRange. The ruler
+  // counts from the start of the capture.
+  base::Time capture_start_;
+  base::Time capture_end_;
+
+  // Scratch storage for painting.
+  std::vector<ISpanIndex::Track> tracks_;
+  std::vector<ISpanIndex::Span> spans_;
+  std::vector<ISpanIndex::Bucket> buckets_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimelineView);
+};
+
+#endif  // SAWBUCK_VIEWER_TIMELINE_VIEW_H_
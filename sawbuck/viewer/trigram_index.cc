@@ -0,0 +1,410 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Trigram text index implementation.
+#include "sawbuck/viewer/trigram_index.h"
+
+#include <algorithm>
+#include <iterator>
+#include "base/logging.h"
+
+namespace {
+
+// The number of hash buckets, trigrams that share a bucket share their
+// posting list.
+const int kBucketBits = 16;
+const size_t kNumBuckets = 1 << kBucketBits;
+
+// The number of postings between checkpoints.
+const uint32 kCheckpointInterval = 64;
+
+// "SBTG" in little-endian order.
+const uint32 kImageMagic = 0x47544253;
+
+// An image starts with this header, which is followed by an ImageBucket
+// per bucket, then the checkpoints of all buckets, then their postings.
+// The offsets are from the start of the image.
+struct ImageHeader {
+  uint32 magic;
+  // Zero for an index without buckets, kNumBuckets otherwise.
+  uint32 num_buckets;
+  int32 num_rows;
+  int32 first_row;
+};
+
+struct ImageBucket {
+  uint32 num_postings;
+  uint32 checkpoints_offset;
+  uint32 num_checkpoints;
+  uint32 data_offset;
+  uint32 data_size;
+};
+
+template <class T>
+void AppendPod(const T& value, std::string* buffer) {
+  buffer->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline uint8 ToLowerASCII(char c) {
+  return static_cast<uint8>((c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c);
+}
+
+}  // namespace
+
+const int TrigramIndex::kRowsPerGroup;
+const size_t TrigramIndex::kMinLiteralLength;
+
+bool TrigramIndex::Checkpoint::GroupLess(int32 group,
+                                         const Checkpoint& checkpoint) {
+  return group < checkpoint.group;
+}
+
+TrigramIndex::PostingList::PostingList() : last_group(-1), num_postings(0) {
+}
+
+bool TrigramIndex::ListRef::operator<(const ListRef& other) const {
+  if (num_postings != other.num_postings)
+    return num_postings < other.num_postings;
+  return bucket < other.bucket;
+}
+
+TrigramIndex::TrigramIndex() : num_rows_(0), first_row_(0) {
+}
+
+TrigramIndex::~TrigramIndex() {
+}
+
+void TrigramIndex::AddRow(const base::StringPiece& text) {
+  if (buckets_.empty())
+    buckets_.resize(kNumBuckets);
+
+  int32 group = num_rows_ / kRowsPerGroup;
+  ++num_rows_;
+  if (text.size() < kMinLiteralLength)
+    return;
+
+  for (size_t i = 0; i + kMinLiteralLength <= text.size(); ++i) {
+    PostingList& list = buckets_[GetBucket(text.data() + i)];
+    if (list.last_group == group)
+      continue;
+
+    if (list.num_postings % kCheckpointInterval == 0) {
+      Checkpoint checkpoint = {
+        static_cast<uint32>(list.data.size()), list.last_group
+      };
+      list.checkpoints.push_back(checkpoint);
+    }
+
+    uint32 delta = group - list.last_group;
+    while (delta >= 0x80) {
+      list.data.push_back(static_cast<uint8>(delta | 0x80));
+      delta >>= 7;
+    }
+    list.data.push_back(static_cast<uint8>(delta));
+
+    list.last_group = group;
+    ++list.num_postings;
+  }
+}
+
+void TrigramIndex::Clear() {
+  std::vector<PostingList>().swap(buckets_);
+  num_rows_ = 0;
+  first_row_ = 0;
+}
+
+void TrigramIndex::EvictRowsBefore(int row) {
+  if (row <= first_row_)
+    return;
+
+  first_row_ = row;
+  num_rows_ = std::max(num_rows_, row);
+
+  // The postings past a checkpoint are all for groups past its group, so
+  // everything before the last checkpoint short of the first group can go.
+  // That checkpoint then stands in as the start of the list.
+  int32 first_group = row / kRowsPerGroup;
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    PostingList& list = buckets_[i];
+    std::vector<Checkpoint>::iterator it =
+        std::upper_bound(list.checkpoints.begin(), list.checkpoints.end(),
+                         first_group - 1, Checkpoint::GroupLess);
+    if (it == list.checkpoints.begin())
+      continue;
+    --it;
+
+    size_t dropped = it - list.checkpoints.begin();
+    if (dropped == 0)
+      continue;
+
+    uint32 offset = it->offset;
+    list.data.erase(list.data.begin(), list.data.begin() + offset);
+    list.checkpoints.erase(list.checkpoints.begin(), it);
+    for (size_t j = 0; j < list.checkpoints.size(); ++j)
+      list.checkpoints[j].offset -= offset;
+    list.num_postings -= dropped * kCheckpointInterval;
+  }
+}
+
+bool TrigramIndex::GetCandidateRows(const base::StringPiece& literal,
+                                    int begin,
+                                    int end,
+                                    std::vector<int>* rows) const {
+  DCHECK(rows != NULL);
+  if (literal.size() < kMinLiteralLength)
+    return false;
+
+  // The buckets are allocated with the first row.
+  std::vector<ListRef> lists;
+  for (size_t i = 0;
+       !buckets_.empty() && i + kMinLiteralLength <= literal.size(); ++i) {
+    size_t bucket = GetBucket(literal.data() + i);
+    const PostingList& list = buckets_[bucket];
+    ListRef ref = {
+      list.num_postings, bucket,
+      list.data.empty() ? NULL : &list.data[0], list.data.size(),
+      list.checkpoints.empty() ? NULL : &list.checkpoints[0],
+      list.checkpoints.size()
+    };
+    lists.push_back(ref);
+  }
+
+  return FindCandidateRows(&lists, first_row_, num_rows_, begin, end, rows);
+}
+
+size_t TrigramIndex::GetMemoryUsage() const {
+  size_t usage = buckets_.capacity() * sizeof(buckets_[0]);
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    usage += buckets_[i].data.capacity();
+    usage += buckets_[i].checkpoints.capacity() * sizeof(Checkpoint);
+  }
+  return usage;
+}
+
+void TrigramIndex::Serialize(std::string* buffer) const {
+  DCHECK(buffer != NULL);
+  COMPILE_ASSERT(sizeof(Checkpoint) == 8, checkpoint_is_packed);
+
+  size_t start = buffer->size();
+  ImageHeader header = {
+    kImageMagic, static_cast<uint32>(buckets_.size()), num_rows_, first_row_
+  };
+  AppendPod(header, buffer);
+
+  // The checkpoints come right after the table, and the postings after
+  // them, so the checkpoints are as aligned as the image.
+  uint32 checkpoints_offset = static_cast<uint32>(
+      sizeof(header) + buckets_.size() * sizeof(ImageBucket));
+  uint32 data_offset = checkpoints_offset;
+  for (size_t i = 0; i < buckets_.size(); ++i)
+    data_offset += buckets_[i].checkpoints.size() * sizeof(Checkpoint);
+
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    const PostingList& list = buckets_[i];
+    ImageBucket bucket = {
+      list.num_postings, checkpoints_offset,
+      static_cast<uint32>(list.checkpoints.size()), data_offset,
+      static_cast<uint32>(list.data.size())
+    };
+    AppendPod(bucket, buffer);
+    checkpoints_offset += list.checkpoints.size() * sizeof(Checkpoint);
+    data_offset += list.data.size();
+  }
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    const std::vector<Checkpoint>& checkpoints = buckets_[i].checkpoints;
+    if (!checkpoints.empty()) {
+      buffer->append(reinterpret_cast<const char*>(&checkpoints[0]),
+                     checkpoints.size() * sizeof(Checkpoint));
+    }
+  }
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    const std::vector<uint8>& data = buckets_[i].data;
+    if (!data.empty())
+      buffer->append(reinterpret_cast<const char*>(&data[0]), data.size());
+  }
+  DCHECK_EQ(data_offset, buffer->size() - start);
+}
+
+bool TrigramIndex::IsValidImage(const base::StringPiece& image) {
+  if (image.size() < sizeof(ImageHeader))
+    return false;
+
+  const ImageHeader* header =
+      reinterpret_cast<const ImageHeader*>(image.data());
+  if (header->magic != kImageMagic ||
+      (header->num_buckets != 0 && header->num_buckets != kNumBuckets) ||
+      header->first_row < 0 || header->first_row > header->num_rows ||
+      (header->num_buckets == 0 && header->first_row != header->num_rows)) {
+    return false;
+  }
+
+  uint64 size = image.size();
+  uint64 table_end = sizeof(ImageHeader) +
+      static_cast<uint64>(header->num_buckets) * sizeof(ImageBucket);
+  if (table_end > size)
+    return false;
+
+  const ImageBucket* buckets =
+      reinterpret_cast<const ImageBucket*>(header + 1);
+  for (size_t i = 0; i < header->num_buckets; ++i) {
+    const ImageBucket& bucket = buckets[i];
+    uint64 checkpoints_end = bucket.checkpoints_offset +
+        static_cast<uint64>(bucket.num_checkpoints) * sizeof(Checkpoint);
+    if (bucket.checkpoints_offset % sizeof(uint32) != 0 ||
+        bucket.checkpoints_offset < table_end || checkpoints_end > size ||
+        static_cast<uint64>(bucket.data_offset) + bucket.data_size > size) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool TrigramIndex::GetImageCandidateRows(const base::StringPiece& image,
+                                         const base::StringPiece& literal,
+                                         int begin,
+                                         int end,
+                                         std::vector<int>* rows) {
+  DCHECK(rows != NULL);
+  DCHECK(IsValidImage(image));
+  if (literal.size() < kMinLiteralLength)
+    return false;
+
+  const uint8* data = reinterpret_cast<const uint8*>(image.data());
+  const ImageHeader* header = reinterpret_cast<const ImageHeader*>(data);
+  const ImageBucket* buckets =
+      reinterpret_cast<const ImageBucket*>(header + 1);
+  std::vector<ListRef> lists;
+  for (size_t i = 0;
+       header->num_buckets != 0 && i + kMinLiteralLength <= literal.size();
+       ++i) {
+    size_t index = GetBucket(literal.data() + i);
+    const ImageBucket& bucket = buckets[index];
+    ListRef ref = {
+      bucket.num_postings, index,
+      data + bucket.data_offset, bucket.data_size,
+      reinterpret_cast<const Checkpoint*>(data + bucket.checkpoints_offset),
+      bucket.num_checkpoints
+    };
+    lists.push_back(ref);
+  }
+
+  return FindCandidateRows(&lists, header->first_row, header->num_rows,
+                           begin, end, rows);
+}
+
+bool TrigramIndex::FindCandidateRows(std::vector<ListRef>* lists,
+                                     int first_row,
+                                     int num_rows,
+                                     int begin,
+                                     int end,
+                                     std::vector<int>* rows) {
+  DCHECK(lists != NULL);
+  DCHECK(rows != NULL);
+
+  rows->clear();
+  begin = std::max(begin, first_row);
+  end = std::min(end, num_rows);
+  if (begin >= end)
+    return true;
+  DCHECK(!lists->empty());
+
+  int32 begin_group = begin / kRowsPerGroup;
+  int32 end_group = (end - 1) / kRowsPerGroup + 1;
+
+  // Intersect the posting lists of the literal's trigrams, shortest first.
+  std::sort(lists->begin(), lists->end());
+  size_t num_lists = 1;
+  for (size_t i = 1; i < lists->size(); ++i) {
+    if ((*lists)[i].bucket != (*lists)[num_lists - 1].bucket)
+      (*lists)[num_lists++] = (*lists)[i];
+  }
+  lists->resize(num_lists);
+
+  std::vector<int32> groups;
+  std::vector<int32> list_groups;
+  std::vector<int32> intersection;
+  DecodeGroups((*lists)[0], begin_group, end_group, &groups);
+  for (size_t i = 1; i < lists->size() && !groups.empty(); ++i) {
+    list_groups.clear();
+    DecodeGroups((*lists)[i], groups.front(), groups.back() + 1,
+                 &list_groups);
+
+    intersection.clear();
+    std::set_intersection(groups.begin(), groups.end(),
+                          list_groups.begin(), list_groups.end(),
+                          std::back_inserter(intersection));
+    groups.swap(intersection);
+  }
+
+  // Where most of the rows are candidates, a plain search is as fast.
+  if (groups.size() * 2 > static_cast<size_t>(end_group - begin_group) &&
+      end_group - begin_group > 1) {
+    return false;
+  }
+
+  for (size_t i = 0; i < groups.size(); ++i) {
+    int first = std::max(begin, groups[i] * kRowsPerGroup);
+    int last = std::min(end, (groups[i] + 1) * kRowsPerGroup);
+    for (int row = first; row < last; ++row)
+      rows->push_back(row);
+  }
+
+  return true;
+}
+
+size_t TrigramIndex::GetBucket(const char* text) {
+  uint32 trigram = (ToLowerASCII(text[0]) << 16) |
+      (ToLowerASCII(text[1]) << 8) | ToLowerASCII(text[2]);
+  return (trigram * 2654435761U) >> (32 - kBucketBits);
+}
+
+void TrigramIndex::DecodeGroups(const ListRef& list,
+                                int32 begin_group,
+                                int32 end_group,
+                                std::vector<int32>* groups) {
+  DCHECK(groups != NULL);
+
+  // Start at the last checkpoint before begin_group.
+  const Checkpoint* checkpoints_end =
+      list.checkpoints + list.num_checkpoints;
+  const Checkpoint* it =
+      std::upper_bound(list.checkpoints, checkpoints_end,
+                       begin_group - 1, Checkpoint::GroupLess);
+  if (it == list.checkpoints)
+    return;
+  --it;
+
+  const uint8* data = list.data;
+  size_t size = list.size;
+  size_t offset = it->offset;
+  int32 group = it->group;
+  while (offset < size) {
+    uint32 delta = 0;
+    int shift = 0;
+    uint8 byte = 0;
+    // A list of an image may be cut short, which ends it.
+    do {
+      byte = data[offset++];
+      delta |= static_cast<uint32>(byte & 0x7F) << shift;
+      shift += 7;
+    } while ((byte & 0x80) != 0 && offset < size);
+
+    group += delta;
+    if (group >= end_group)
+      break;
+    if (group >= begin_group)
+      groups->push_back(group);
+  }
+}
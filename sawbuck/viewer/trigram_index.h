@@ -0,0 +1,160 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Trigram text index declaration.
+#ifndef SAWBUCK_VIEWER_TRIGRAM_INDEX_H_
+#define SAWBUCK_VIEWER_TRIGRAM_INDEX_H_
+
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+
+// An incrementally built index from the trigrams of row text to the rows
+// containing them, which narrows a literal search down to the rows that
+// contain all of the literal's trigrams.
+//
+// To keep the index small, rows are indexed in groups of kRowsPerGroup,
+// trigrams are case folded for ASCII and hashed to a fixed number of
+// buckets, and each bucket's posting list holds the delta encoded groups
+// containing any of its trigrams. The candidates for a literal are thus a
+// superset of the rows that contain it, and must be verified.
+//
+// An index serializes to an image that's searched in place, e.g. from a
+// mapped file, without decoding more than the posting lists searched.
+// @note an index takes no lock. Its store adds and evicts rows on the
+//     store's thread, and the pool's filter and query tasks search it only
+//     while that thread waits on them, as searches don't write. The image
+//     functions read nothing but the image, so any number of threads may
+//     search a mapped image at once.
+class TrigramIndex {
+ public:
+  // Rows are indexed, and returned as candidates, in groups of this many.
+  static const int kRowsPerGroup = 32;
+  // The shortest literal the index can narrow a search down for.
+  static const size_t kMinLiteralLength = 3;
+
+  TrigramIndex();
+  ~TrigramIndex();
+
+  // Indexes @p text as the next row.
+  void AddRow(const base::StringPiece& text);
+
+  // Removes all rows and releases the index storage.
+  void Clear();
+
+  // Drops the rows before @p row, which keep their numbers. Rows are
+  // dropped from the index by whole checkpoints, so the candidates for
+  // a search that starts before first_row() may include dropped rows.
+  // If @p row is past the rows indexed, the rows up to it are skipped.
+  void EvictRowsBefore(int row);
+
+  // Finds the rows that may contain @p literal, ignoring ASCII case.
+  // @param begin, end the range of rows to search.
+  // @param rows on success receives the candidate rows in ascending order.
+  // @returns true on success, or false if the index can't usefully narrow
+  //     down the search, because @p literal is too short or too common.
+  bool GetCandidateRows(const base::StringPiece& literal,
+                        int begin,
+                        int end,
+                        std::vector<int>* rows) const;
+
+  // @returns the number of rows indexed, including those dropped.
+  int num_rows() const { return num_rows_; }
+
+  // @returns the first row not dropped.
+  int first_row() const { return first_row_; }
+
+  // @returns an estimate of the heap memory used by the index.
+  size_t GetMemoryUsage() const;
+
+  // Appends the image of the index to @p buffer.
+  void Serialize(std::string* buffer) const;
+
+  // @returns true iff @p image is an index image whose posting lists are
+  //     all within it.
+  static bool IsValidImage(const base::StringPiece& image);
+
+  // As GetCandidateRows, over the index serialized to @p image, which
+  // must be valid and 4 byte aligned.
+  static bool GetImageCandidateRows(const base::StringPiece& image,
+                                    const base::StringPiece& literal,
+                                    int begin,
+                                    int end,
+                                    std::vector<int>* rows);
+
+ private:
+  // Allows skipping into a posting list. The postings from offset on
+  // are all for groups past group.
+  struct Checkpoint {
+    // Orders checkpoints by group for std::upper_bound.
+    static bool GroupLess(int32 group, const Checkpoint& checkpoint);
+
+    uint32 offset;
+    int32 group;
+  };
+
+  struct PostingList {
+    PostingList();
+
+    // The varint encoded deltas between successive groups.
+    std::vector<uint8> data;
+    // A checkpoint for every kCheckpointInterval postings.
+    std::vector<Checkpoint> checkpoints;
+    // The last group added, or -1.
+    int32 last_group;
+    uint32 num_postings;
+  };
+
+  // A posting list, in the index or in an image.
+  struct ListRef {
+    // Orders lists by length, shortest first.
+    bool operator<(const ListRef& other) const;
+
+    uint32 num_postings;
+    size_t bucket;
+    const uint8* data;
+    size_t size;
+    const Checkpoint* checkpoints;
+    size_t num_checkpoints;
+  };
+
+  // @returns the bucket of the trigram starting at @p text.
+  static size_t GetBucket(const char* text);
+
+  // Finds the candidate rows in [@p begin, @p end), of the rows from
+  // @p first_row to @p num_rows, from the posting lists of the trigrams
+  // of a literal in @p lists, @see GetCandidateRows.
+  static bool FindCandidateRows(std::vector<ListRef>* lists,
+                                int first_row,
+                                int num_rows,
+                                int begin,
+                                int end,
+                                std::vector<int>* rows);
+
+  // Decodes the groups in [@p begin_group, @p end_group) of @p list.
+  static void DecodeGroups(const ListRef& list,
+                           int32 begin_group,
+                           int32 end_group,
+                           std::vector<int32>* groups);
+
+  // Allocated on the first row.
+  std::vector<PostingList> buckets_;
+  int num_rows_;
+  int first_row_;
+
+  DISALLOW_COPY_AND_ASSIGN(TrigramIndex);
+};
+
+#endif  // SAWBUCK_VIEWER_TRIGRAM_INDEX_H_
@@ -0,0 +1,226 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/trigram_index.h"
+
+#include <algorithm>
+#include <string>
+#include "base/strings/stringprintf.h"
+#include "gtest/gtest.h"
+#include "sawbuck/viewer/pattern_matcher.h"
+
+namespace {
+
+const int kNumRows = 5000;
+
+class TrigramIndexTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    for (int i = 0; i < kNumRows; ++i) {
+      std::string text;
+      if (i % 100 == 7)
+        text = base::StringPrintf("Rare event number %d", i);
+      else if (i % 3 == 0)
+        text = base::StringPrintf("Opening file %d", i);
+      else
+        text = base::StringPrintf("Closing FILE %d", i);
+      AddRow(text);
+    }
+  }
+
+  void AddRow(const std::string& text) {
+    texts_.push_back(text);
+    index_.AddRow(text);
+  }
+
+  // Checks that the candidates for @p literal in [@p begin, @p end) are
+  // sorted, in range and include every row containing it.
+  void ExpectCandidates(const std::string& literal, int begin, int end) {
+    std::vector<int> rows;
+    ASSERT_TRUE(index_.GetCandidateRows(literal, begin, end, &rows));
+
+    for (size_t i = 0; i < rows.size(); ++i) {
+      EXPECT_LE(begin, rows[i]);
+      EXPECT_GT(end, rows[i]);
+      if (i > 0)
+        EXPECT_LT(rows[i - 1], rows[i]);
+    }
+
+    CaselessSearcher searcher(literal);
+    for (int row = begin; row < end; ++row) {
+      if (searcher.Find(texts_[row])) {
+        EXPECT_TRUE(std::binary_search(rows.begin(), rows.end(), row))
+            << "'" << literal << "' in row " << row;
+      }
+    }
+  }
+
+ protected:
+  std::vector<std::string> texts_;
+  TrigramIndex index_;
+};
+
+TEST_F(TrigramIndexTest, Empty) {
+  TrigramIndex index;
+  EXPECT_EQ(0, index.num_rows());
+
+  std::vector<int> rows(1, 1);
+  EXPECT_TRUE(index.GetCandidateRows("foo", 0, 100, &rows));
+  EXPECT_TRUE(rows.empty());
+}
+
+TEST_F(TrigramIndexTest, ShortLiterals) {
+  std::vector<int> rows;
+  EXPECT_FALSE(index_.GetCandidateRows("", 0, kNumRows, &rows));
+  EXPECT_FALSE(index_.GetCandidateRows("ab", 0, kNumRows, &rows));
+}
+
+TEST_F(TrigramIndexTest, CommonLiterals) {
+  std::vector<int> rows;
+  EXPECT_FALSE(index_.GetCandidateRows("file", 0, kNumRows, &rows));
+
+  // On a single group, there's no telling.
+  ExpectCandidates("file", 10, 20);
+}
+
+TEST_F(TrigramIndexTest, RareLiterals) {
+  EXPECT_EQ(kNumRows, index_.num_rows());
+
+  std::vector<int> rows;
+  ASSERT_TRUE(index_.GetCandidateRows("RARE EVENT", 0, kNumRows, &rows));
+  // Candidates come in groups, one per rare row here.
+  EXPECT_EQ(static_cast<size_t>(kNumRows / 100 * TrigramIndex::kRowsPerGroup),
+            rows.size());
+
+  ExpectCandidates("rare event", 0, kNumRows);
+  ExpectCandidates("number 4207", 0, kNumRows);
+  ExpectCandidates("rare", 1234, 4321);
+  ExpectCandidates("Rare", 4990, kNumRows + 10);
+
+  ASSERT_TRUE(index_.GetCandidateRows("no such text", 0, kNumRows, &rows));
+  EXPECT_TRUE(rows.empty());
+}
+
+TEST_F(TrigramIndexTest, MoreRows) {
+  AddRow("A late addition");
+  AddRow("Short");
+  AddRow("");
+  ExpectCandidates("late addition", 0, index_.num_rows());
+  ExpectCandidates("addition", 4000, index_.num_rows());
+  ExpectCandidates("hor", 4000, index_.num_rows());
+}
+
+TEST_F(TrigramIndexTest, EvictRows) {
+  const int kFirstRow = 3000;
+  index_.EvictRowsBefore(kFirstRow);
+  EXPECT_EQ(kFirstRow, index_.first_row());
+  EXPECT_EQ(kNumRows, index_.num_rows());
+
+  // The evicted rows are out of every search.
+  std::vector<int> rows;
+  ASSERT_TRUE(index_.GetCandidateRows("rare event", 0, kNumRows, &rows));
+  ASSERT_FALSE(rows.empty());
+  EXPECT_LE(kFirstRow, rows.front());
+  ExpectCandidates("rare event", kFirstRow, kNumRows);
+  ExpectCandidates("number 4207", kFirstRow, kNumRows);
+
+  // Evicting again, or less, is fine.
+  index_.EvictRowsBefore(kFirstRow - 1000);
+  EXPECT_EQ(kFirstRow, index_.first_row());
+  index_.EvictRowsBefore(4500);
+  ExpectCandidates("rare", 4500, kNumRows);
+
+  // New rows carry on from the last.
+  AddRow("A late addition");
+  ExpectCandidates("late addition", 4500, index_.num_rows());
+}
+
+TEST_F(TrigramIndexTest, EvictPastRows) {
+  TrigramIndex index;
+  index.EvictRowsBefore(100);
+  EXPECT_EQ(100, index.num_rows());
+
+  index.AddRow("Rare row");
+  std::vector<int> rows;
+  ASSERT_TRUE(index.GetCandidateRows("rare", 0, 200, &rows));
+  ASSERT_FALSE(rows.empty());
+  EXPECT_EQ(100, rows.front());
+  EXPECT_EQ(100, rows.back());
+}
+
+TEST_F(TrigramIndexTest, Clear) {
+  size_t memory = index_.GetMemoryUsage();
+  EXPECT_LT(0U, memory);
+
+  index_.Clear();
+  EXPECT_EQ(0, index_.num_rows());
+  EXPECT_GT(memory, index_.GetMemoryUsage());
+
+  texts_.clear();
+  AddRow("Rare again");
+  ExpectCandidates("rare", 0, 1);
+}
+
+TEST_F(TrigramIndexTest, Image) {
+  index_.EvictRowsBefore(1000);
+  std::string image;
+  index_.Serialize(&image);
+  ASSERT_TRUE(TrigramIndex::IsValidImage(image));
+
+  // The image narrows every search down as the index does.
+  const char* kLiterals[] = { "rare event", "number 4207", "file", "ab",
+                              "no such text" };
+  for (size_t i = 0; i < arraysize(kLiterals); ++i) {
+    std::vector<int> expected;
+    std::vector<int> rows;
+    bool narrowed = index_.GetCandidateRows(kLiterals[i], 0, kNumRows,
+                                            &expected);
+    EXPECT_EQ(narrowed, TrigramIndex::GetImageCandidateRows(
+        image, kLiterals[i], 0, kNumRows, &rows)) << kLiterals[i];
+    if (narrowed)
+      EXPECT_TRUE(expected == rows) << kLiterals[i];
+  }
+
+  std::vector<int> rows;
+  ASSERT_TRUE(TrigramIndex::GetImageCandidateRows(image, "rare", 1234, 4321,
+                                                  &rows));
+  ASSERT_FALSE(rows.empty());
+  EXPECT_LE(1234, rows.front());
+  EXPECT_GT(4321, rows.back());
+}
+
+TEST_F(TrigramIndexTest, EmptyImage) {
+  TrigramIndex index;
+  index.EvictRowsBefore(100);
+  std::string image;
+  index.Serialize(&image);
+  ASSERT_TRUE(TrigramIndex::IsValidImage(image));
+
+  std::vector<int> rows(1, 1);
+  EXPECT_TRUE(TrigramIndex::GetImageCandidateRows(image, "foo", 0, 200,
+                                                  &rows));
+  EXPECT_TRUE(rows.empty());
+}
+
+TEST_F(TrigramIndexTest, InvalidImage) {
+  std::string image;
+  index_.Serialize(&image);
+
+  EXPECT_FALSE(TrigramIndex::IsValidImage(std::string()));
+  EXPECT_FALSE(TrigramIndex::IsValidImage(
+      base::StringPiece(image.data(), image.size() - 1)));
+  image[0] ^= 0xFF;
+  EXPECT_FALSE(TrigramIndex::IsValidImage(image));
+}
+
+}  // namespace
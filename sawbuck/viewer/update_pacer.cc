@@ -0,0 +1,75 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Update pacer implementation.
+#include "sawbuck/viewer/update_pacer.h"
+
+#include "base/logging.h"
+
+const int UpdatePacer::kPeriodMs;
+
+UpdatePacer::UpdatePacer(int max_per_second) : period_updates_(0) {
+  DCHECK_LE(0, max_per_second);
+  if (max_per_second > 0)
+    min_interval_ = base::TimeDelta::FromMicroseconds(
+        base::Time::kMicrosecondsPerSecond / max_per_second);
+}
+
+base::TimeDelta UpdatePacer::GetDelay(base::TimeTicks now) const {
+  if (last_update_.is_null())
+    return base::TimeDelta();
+
+  base::TimeDelta delay = last_update_ + min_interval_ - now;
+  if (delay < base::TimeDelta())
+    return base::TimeDelta();
+
+  return delay;
+}
+
+void UpdatePacer::OnUpdate(base::TimeTicks start, base::TimeTicks end) {
+  DCHECK(start <= end);
+  last_update_ = start;
+
+  if (period_start_.is_null())
+    period_start_ = start;
+  ++period_updates_;
+  period_cost_ += end - start;
+}
+
+bool UpdatePacer::EndPeriod(base::TimeTicks now,
+                            int* num_updates,
+                            base::TimeDelta* cost) {
+  DCHECK(num_updates != NULL);
+  DCHECK(cost != NULL);
+
+  if (period_start_.is_null())
+    return false;
+
+  base::TimeDelta elapsed = now - period_start_;
+  if (elapsed < base::TimeDelta::FromMilliseconds(kPeriodMs))
+    return false;
+
+  // Scale to a second, as the period may have run over.
+  int64 elapsed_us = elapsed.InMicroseconds();
+  *num_updates = static_cast<int>(
+      period_updates_ * base::Time::kMicrosecondsPerSecond / elapsed_us);
+  *cost = base::TimeDelta::FromMicroseconds(
+      period_cost_.InMicroseconds() * base::Time::kMicrosecondsPerSecond /
+      elapsed_us);
+
+  period_start_ = now;
+  period_updates_ = 0;
+  period_cost_ = base::TimeDelta();
+  return true;
+}
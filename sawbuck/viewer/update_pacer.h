@@ -0,0 +1,70 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Update pacer declaration.
+#ifndef SAWBUCK_VIEWER_UPDATE_PACER_H_
+#define SAWBUCK_VIEWER_UPDATE_PACER_H_
+
+#include "base/basictypes.h"
+#include "base/time/time.h"
+
+// Paces updates to at most so many a second, and keeps account of the
+// time they take, a period of a second or more at a time.
+// The pacer doesn't read the clock, the times are passed in, which
+// makes it easy to test.
+class UpdatePacer {
+ public:
+  // @param max_per_second the most updates to allow a second, or zero
+  //     for no limit.
+  explicit UpdatePacer(int max_per_second);
+
+  // @returns how long after @p now the next update is due, zero if it's
+  //     due already.
+  base::TimeDelta GetDelay(base::TimeTicks now) const;
+
+  // Records an update that ran from @p start to @p end.
+  void OnUpdate(base::TimeTicks start, base::TimeTicks end);
+
+  // Ends the accounting period, if it's been a second or more since it
+  // started, and starts another.
+  // @param num_updates on success, returns the number of updates in the
+  //     period, scaled to a second.
+  // @param cost on success, returns the time the updates in the period
+  //     took, scaled to a second.
+  // @returns true iff the period ended.
+  bool EndPeriod(base::TimeTicks now,
+                 int* num_updates,
+                 base::TimeDelta* cost);
+
+  base::TimeDelta min_interval() const { return min_interval_; }
+
+  // The period updates are accounted over.
+  static const int kPeriodMs = 1000;
+
+ private:
+  // The least time from one update to the next.
+  base::TimeDelta min_interval_;
+  // The start of the last update, null until the first.
+  base::TimeTicks last_update_;
+
+  // The start of the accounting period, null until the first update.
+  base::TimeTicks period_start_;
+  // The number of updates and the time they took in the period.
+  int period_updates_;
+  base::TimeDelta period_cost_;
+
+  DISALLOW_COPY_AND_ASSIGN(UpdatePacer);
+};
+
+#endif  // SAWBUCK_VIEWER_UPDATE_PACER_H_
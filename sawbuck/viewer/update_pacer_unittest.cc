@@ -0,0 +1,87 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "sawbuck/viewer/update_pacer.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+using base::TimeDelta;
+using base::TimeTicks;
+
+// An arbitrary, non-null starting time.
+TimeTicks Ms(int64 ms) {
+  return TimeTicks::FromInternalValue(1000000 + ms * 1000);
+}
+
+TEST(UpdatePacerTest, Unlimited) {
+  UpdatePacer pacer(0);
+  EXPECT_EQ(TimeDelta(), pacer.min_interval());
+
+  EXPECT_EQ(TimeDelta(), pacer.GetDelay(Ms(0)));
+  pacer.OnUpdate(Ms(0), Ms(1));
+  EXPECT_EQ(TimeDelta(), pacer.GetDelay(Ms(0)));
+  EXPECT_EQ(TimeDelta(), pacer.GetDelay(Ms(1)));
+}
+
+TEST(UpdatePacerTest, Paces) {
+  UpdatePacer pacer(20);
+  EXPECT_EQ(TimeDelta::FromMilliseconds(50), pacer.min_interval());
+
+  // The first update is due at once.
+  EXPECT_EQ(TimeDelta(), pacer.GetDelay(Ms(0)));
+  pacer.OnUpdate(Ms(0), Ms(5));
+
+  // The next is due an interval after the last one started.
+  EXPECT_EQ(TimeDelta::FromMilliseconds(50), pacer.GetDelay(Ms(0)));
+  EXPECT_EQ(TimeDelta::FromMilliseconds(40), pacer.GetDelay(Ms(10)));
+  EXPECT_EQ(TimeDelta(), pacer.GetDelay(Ms(50)));
+  EXPECT_EQ(TimeDelta(), pacer.GetDelay(Ms(500)));
+
+  pacer.OnUpdate(Ms(500), Ms(501));
+  EXPECT_EQ(TimeDelta::FromMilliseconds(30), pacer.GetDelay(Ms(520)));
+}
+
+TEST(UpdatePacerTest, Accounting) {
+  UpdatePacer pacer(20);
+  int num_updates = 0;
+  TimeDelta cost;
+
+  // Nothing to account for before the first update.
+  EXPECT_FALSE(pacer.EndPeriod(Ms(5000), &num_updates, &cost));
+
+  for (int i = 0; i < 10; ++i)
+    pacer.OnUpdate(Ms(i * 100), Ms(i * 100 + 3));
+
+  // Not yet a second.
+  EXPECT_FALSE(pacer.EndPeriod(Ms(999), &num_updates, &cost));
+
+  EXPECT_TRUE(pacer.EndPeriod(Ms(1000), &num_updates, &cost));
+  EXPECT_EQ(10, num_updates);
+  EXPECT_EQ(TimeDelta::FromMilliseconds(30), cost);
+
+  // The next period starts where that one ended, and scales to a second.
+  pacer.OnUpdate(Ms(1500), Ms(1510));
+  EXPECT_FALSE(pacer.EndPeriod(Ms(1500), &num_updates, &cost));
+  EXPECT_TRUE(pacer.EndPeriod(Ms(3000), &num_updates, &cost));
+  EXPECT_EQ(0, num_updates);
+  EXPECT_EQ(TimeDelta::FromMilliseconds(5), cost);
+
+  // A period with no updates accounts for nothing.
+  EXPECT_TRUE(pacer.EndPeriod(Ms(4000), &num_updates, &cost));
+  EXPECT_EQ(0, num_updates);
+  EXPECT_EQ(TimeDelta(), cost);
+}
+
+}  // namespace
@@ -64,50 +64,173 @@
       'target_name': 'viewer_lib',
       'type': 'static_library',
       'sources': [
+        'aho_corasick.cc',
+        'aho_corasick.h',
+        'back_pressure_controller.cc',
+        'back_pressure_controller.h',
+        'capture_spill.cc',
+        'capture_spill.h',
+        'column_sizer.cc',
+        'column_sizer.h',
+        'column_sorted_log_view.cc',
+        'column_sorted_log_view.h',
         'const_config.h',
+        'display_cache.cc',
+        'display_cache.h',
+        'duplicate_row_filter.cc',
+        'duplicate_row_filter.h',
         'filter.cc',
         'filter.h',
         'filter_dialog.cc',
         'filter_dialog.h',
+        'filter_preview.cc',
+        'filter_preview.h',
+        'filter_program.cc',
+        'filter_program.h',
+        'filter_scan.cc',
+        'filter_scan.h',
         'filtered_log_view.cc',
         'filtered_log_view.h',
         'find_dialog.cc',
         'find_dialog.h',
+        'glyph_run_cache.cc',
+        'glyph_run_cache.h',
+        'go_to_time_dialog.cc',
+        'go_to_time_dialog.h',
+        'import_scope_dialog.cc',
+        'import_scope_dialog.h',
+        'lazy_log.cc',
+        'lazy_log.h',
+        'log_aggregator.cc',
+        'log_aggregator.h',
+        'log_diff.cc',
+        'log_diff.h',
         'log_viewer.h',
         'log_viewer.cc',
         'log_list_view.h',
         'log_list_view.cc',
+        'log_finder.cc',
+        'log_finder.h',
+        'log_follower.cc',
+        'log_follower.h',
+        'log_importer.cc',
+        'log_importer.h',
+        'log_index.cc',
+        'log_index.h',
+        'log_query.cc',
+        'log_query.h',
+        'log_store.cc',
+        'log_store.h',
+        'log_text_writer.cc',
+        'log_text_writer.h',
+        'memory_chart_view.cc',
+        'memory_chart_view.h',
+        'message_templates.cc',
+        'message_templates.h',
+        'pattern_matcher.cc',
+        'pattern_matcher.h',
         'preferences.cc',
         'preferences.h',
+        'process_instance_index.cc',
+        'process_instance_index.h',
+        'process_tree.cc',
+        'process_tree.h',
+        'process_tree_view.cc',
+        'process_tree_view.h',
         'provider_configuration.cc',
         'provider_configuration.h',
         'provider_dialog.cc',
         'provider_dialog.h',
+        'query_dialog.cc',
+        'query_dialog.h',
+        'remote_agent_dialog.cc',
+        'remote_agent_dialog.h',
+        'remote_capture.cc',
+        'remote_capture.h',
+        'report_archive.cc',
+        'report_archive.h',
+        'responsiveness_monitor.cc',
+        'responsiveness_monitor.h',
+        'row_batch.cc',
+        'row_batch.h',
+        'row_bitmap.cc',
+        'row_bitmap.h',
+        'row_highlighter.cc',
+        'row_highlighter.h',
+        'row_posting_index.cc',
+        'row_posting_index.h',
+        'row_set.cc',
+        'row_set.h',
         'sawbuck_guids.h',
+        'session_buffer_sizer.cc',
+        'session_buffer_sizer.h',
+        'session_checkpoint.cc',
+        'session_checkpoint.h',
+        'session_library.cc',
+        'session_library.h',
+        'session_search_dialog.cc',
+        'session_search_dialog.h',
+        'sorted_log_view.cc',
+        'sorted_log_view.h',
+        'stack_module_index.cc',
+        'stack_module_index.h',
         'stack_trace_list_view.h',
         'stack_trace_list_view.cc',
+        'stack_trace_pool.cc',
+        'stack_trace_pool.h',
+        'timeline_view.cc',
+        'timeline_view.h',
+        'trigram_index.cc',
+        'trigram_index.h',
+        'update_pacer.cc',
+        'update_pacer.h',
         'viewer_window.cc',
         'viewer_window.h',
+        'volume_histogram.cc',
+        'volume_histogram.h',
       ],
       'dependencies': [
         '../log_lib/log_lib.gyp:log_lib',
         '<(DEPTH)/base/base.gyp:base',
         '<(DEPTH)/third_party/pcre/pcre.gyp:pcre_lib',
+        '<(DEPTH)/third_party/zlib/zlib.gyp:minizip',
+        '<(DEPTH)/third_party/zlib/zlib.gyp:zlib',
       ],
+      'link_settings': {
+        'libraries': [
+          '-lws2_32.lib',
+        ],
+      },
     },
     {
       # Our tests and sawbuck.exe need the dbghelp and symsrv
       # DLLs in their parent directory, this copies them there.
       'target_name': 'copy_dlls',
       'type': 'none',
-      'copies': [
-        {
-          'destination': '<(PRODUCT_DIR)',
-          'files': [
-            '<(DEPTH)/third_party/debugging_tools/files/dbghelp.dll',
-            '<(DEPTH)/third_party/debugging_tools/files/symsrv.dll',
+      'conditions': [
+        # The DLLs load into our process, so they have to match its
+        # architecture.
+        ['target_arch=="x64"', {
+          'copies': [
+            {
+              'destination': '<(PRODUCT_DIR)',
+              'files': [
+                '<(DEPTH)/third_party/debugging_tools/files/x64/dbghelp.dll',
+                '<(DEPTH)/third_party/debugging_tools/files/x64/symsrv.dll',
+              ],
+            },
           ],
-        },
+        }, {
+          'copies': [
+            {
+              'destination': '<(PRODUCT_DIR)',
+              'files': [
+                '<(DEPTH)/third_party/debugging_tools/files/dbghelp.dll',
+                '<(DEPTH)/third_party/debugging_tools/files/symsrv.dll',
+              ],
+            },
+          ],
+        }],
       ],
     },
     {
@@ -143,20 +266,76 @@
         },
       },
     },
+    {
+      'target_name': 'viewer_benchmarks',
+      'type': 'executable',
+      'sources': [
+        'viewer_benchmarks_main.cc',
+        'viewer.rc',
+      ],
+      'dependencies': [
+        'copy_dlls',
+        'viewer_lib',
+        '<(DEPTH)/base/base.gyp:base',
+        '<(DEPTH)/base/base.gyp:base_i18n',
+      ],
+    },
     {
       'target_name': 'viewer_unittests',
       'type': 'executable',
       'sources': [
+        'aho_corasick_unittest.cc',
+        'back_pressure_controller_unittest.cc',
+        'capture_spill_unittest.cc',
+        'column_sizer_unittest.cc',
+        'column_sorted_log_view_unittest.cc',
+        'display_cache_unittest.cc',
+        'duplicate_row_filter_unittest.cc',
+        'filter_preview_unittest.cc',
+        'filter_program_unittest.cc',
+        'filter_scan_unittest.cc',
         'filter_unittest.cc',
         'filtered_log_view_unittest.cc',
+        'glyph_run_cache_unittest.cc',
+        'lazy_log_unittest.cc',
+        'log_aggregator_unittest.cc',
+        'log_diff_unittest.cc',
+        'log_finder_unittest.cc',
+        'log_follower_unittest.cc',
+        'log_importer_unittest.cc',
+        'log_index_unittest.cc',
+        'log_query_unittest.cc',
+        'log_store_unittest.cc',
+        'log_text_writer_unittest.cc',
+        'message_templates_unittest.cc',
+        'pattern_matcher_unittest.cc',
         'preferences_unittest.cc',
+        'process_instance_index_unittest.cc',
+        'process_tree_unittest.cc',
         'provider_configuration_unittest.cc',
         'registry_test.h',
         'registry_test.cc',
+        'remote_capture_unittest.cc',
+        'report_archive_unittest.cc',
+        'responsiveness_monitor_unittest.cc',
+        'row_batch_unittest.cc',
+        'row_bitmap_unittest.cc',
+        'row_highlighter_unittest.cc',
+        'row_posting_index_unittest.cc',
+        'row_set_unittest.cc',
         'sawbuck_guids.h',
+        'session_buffer_sizer_unittest.cc',
+        'session_checkpoint_unittest.cc',
+        'session_library_unittest.cc',
+        'sorted_log_view_unittest.cc',
+        'stack_module_index_unittest.cc',
+        'stack_trace_pool_unittest.cc',
+        'trigram_index_unittest.cc',
+        'update_pacer_unittest.cc',
         'viewer_unittest_main.cc',
         'viewer_window_unittest.cc',
         'viewer.rc',
+        'volume_histogram_unittest.cc',
       ],
       'dependencies': [
         'copy_dlls',
@@ -0,0 +1,267 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Times the viewer's filtering, find, row formatting and text transcoding
+// on a large synthetic log, and reports the memory the log takes per row. The
+// results are written to stdout as one JSON object per line, of the form
+//   {"benchmark": "filter_contains", "rows": 1000000, "value": 12.5,
+//    "unit": "ms"}
+// so they can be tracked across releases.
+//
+// Usage: viewer_benchmarks [--rows=N] [--index]
+// where --index enables the message index of the log.
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/time/time.h"
+#include "sawbuck/common/utf8_transcoder.h"
+#include "sawbuck/log_lib/string_table.h"
+#include "sawbuck/viewer/filter.h"
+#include "sawbuck/viewer/filtered_log_view.h"
+#include "sawbuck/viewer/log_finder.h"
+#include "sawbuck/viewer/log_list_view.h"
+#include "sawbuck/viewer/log_store.h"
+#include "sawbuck/viewer/store_log_view.h"
+#include "sawbuck/viewer/viewer_module.h"
+
+#include <initguid.h>  // NOLINT
+#include "sawbuck/viewer/sawbuck_guids.h"  // NOLINT
+
+SawbuckAppModule g_sawbuck_app_module;
+
+namespace {
+
+using testing::StoreLogView;
+
+const int kDefaultRows = 1000000;
+// The rows formatted for the formatting benchmark.
+const int kFormatRows = 100000;
+
+const UCHAR kLevels[] = {
+  TRACE_LEVEL_ERROR, TRACE_LEVEL_WARNING, TRACE_LEVEL_INFORMATION,
+  TRACE_LEVEL_INFORMATION, TRACE_LEVEL_VERBOSE,
+};
+const char* kFiles[] = {
+  "c:\\src\\chrome\\browser\\browser_process_impl.cc",
+  "c:\\src\\chrome\\browser\\ui\\browser.cc",
+  "c:\\src\\content\\browser\\renderer_host\\render_widget_host.cc",
+  "c:\\src\\net\\url_request\\url_request_http_job.cc",
+};
+const char* kMessages[] = {
+  "Opening the profile at %d",
+  "Created tab %d for the session",
+  "Request %d completed with status 200",
+  "Something failed with error %d",
+  "Painting %d rects",
+};
+// A message that only the last row has, for the worst case find.
+const char kLastMessage[] = "The needle in the haystack";
+const size_t kStackDepth = 16;
+
+// Records the outcome of a search.
+class FindDelegate : public LogFinder::Delegate {
+ public:
+  FindDelegate() : row_(-1), num_hits_(0) {
+  }
+
+  virtual void OnFindDone(int row) { row_ = row; }
+  virtual void OnFindAllDone(int num_hits) { num_hits_ = num_hits; }
+
+  int row() const { return row_; }
+  int num_hits() const { return num_hits_; }
+
+ private:
+  int row_;
+  int num_hits_;
+};
+
+// Reports a benchmark result.
+void Report(const char* benchmark, int rows, double value, const char* unit) {
+  printf("{\"benchmark\": \"%s\", \"rows\": %d, \"value\": %.3f, "
+         "\"unit\": \"%s\"}\n",
+         benchmark, rows, value, unit);
+}
+
+double ElapsedMs(base::TimeTicks start) {
+  return (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+}
+
+void RunToIdle() {
+  base::RunLoop run_loop;
+  run_loop.RunUntilIdle();
+}
+
+void BuildLog(int num_rows, StringTable* file_table, LogStore* store) {
+  std::vector<StringTable::Atom> files;
+  for (size_t i = 0; i < arraysize(kFiles); ++i)
+    files.push_back(file_table->Intern(kFiles[i]));
+
+  sym_util::Address traces[kStackDepth];
+  for (size_t i = 0; i < kStackDepth; ++i)
+    traces[i] = 0x10000000 + i * 0x1000;
+
+  base::Time time(base::Time::Now());
+  for (int i = 0; i < num_rows; ++i) {
+    std::string message(i == num_rows - 1 ? kLastMessage :
+        base::StringPrintf(kMessages[i % arraysize(kMessages)], i));
+    store->AddRow(kLevels[i % arraysize(kLevels)],
+                  1000 + i % 13,
+                  2000 + i % 101,
+                  time + base::TimeDelta::FromMicroseconds(i * 10),
+                  files[i % files.size()],
+                  100 + i % 1000,
+                  message,
+                  i % 4 == 0 ? kStackDepth : 0,
+                  traces);
+  }
+}
+
+// Times filtering @p view with @p filters to completion.
+void BenchmarkFilter(const char* benchmark,
+                     ILogView* view,
+                     const std::vector<Filter>& filters) {
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  FilteredLogView filtered(view, filters);
+  RunToIdle();
+  Report(benchmark, view->GetNumRows(), ElapsedMs(start), "ms");
+  Report(base::StringPrintf("%s_included", benchmark).c_str(),
+         view->GetNumRows(), filtered.GetNumRows(), "rows");
+}
+
+// Times a search for @p expression down from the first row.
+void BenchmarkFind(const char* benchmark,
+                   ILogView* view,
+                   const std::string& expression) {
+  FindDelegate delegate;
+  LogFinder finder(view, &delegate);
+
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  finder.Find(expression, false, true, view->GetFirstRow());
+  RunToIdle();
+  Report(benchmark, view->GetNumRows(), ElapsedMs(start), "ms");
+  if (delegate.row() == -1)
+    LOG(WARNING) << "No match for \"" << expression << "\".";
+}
+
+// A LogListView to format cells with, it's never shown.
+class FormattingLogListView : public LogListView {
+ public:
+  FormattingLogListView() : LogListView(NULL) {
+  }
+};
+
+// Times the formatting of the cells the list view shows, as done for
+// LVN_GETDISPINFO on rows that aren't in the display cache.
+void BenchmarkFormatting(ILogView* view) {
+  int num_rows = std::min(kFormatRows, view->GetNumRows());
+  FormattingLogListView list_view;
+  list_view.SetLogView(view);
+
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  size_t num_chars = 0;
+  for (int row = 0; row < num_rows; ++row) {
+    for (int col = 0; col < LogViewFormatter::NUM_COLUMNS; ++col)
+      num_chars += list_view.GetCellText(row, col).size();
+  }
+  double elapsed_ms = ElapsedMs(start);
+  CHECK_LT(0U, num_chars);
+
+  Report("format_row", num_rows, elapsed_ms * 1000.0 / num_rows, "us");
+}
+
+// Times converting the messages of @p view to wide characters, with
+// base::UTF8ToWide and with our transcoder, in megabytes a second.
+void BenchmarkTranscoding(ILogView* view) {
+  int num_rows = std::min(kFormatRows, view->GetNumRows());
+  std::vector<std::string> messages(num_rows);
+  size_t num_bytes = 0;
+  for (int row = 0; row < num_rows; ++row) {
+    messages[row] = view->GetMessage(row);
+    num_bytes += messages[row].size();
+  }
+  double megabytes = static_cast<double>(num_bytes) / (1024 * 1024);
+
+  std::wstring wide;
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  for (int row = 0; row < num_rows; ++row)
+    base::UTF8ToWide(messages[row].data(), messages[row].size(), &wide);
+  Report("transcode_base", num_rows, megabytes * 1000.0 / ElapsedMs(start),
+         "MB/s");
+
+  start = base::TimeTicks::HighResNow();
+  for (int row = 0; row < num_rows; ++row)
+    TranscodeUTF8ToWide(messages[row].data(), messages[row].size(), &wide);
+  Report("transcode_sse2", num_rows, megabytes * 1000.0 / ElapsedMs(start),
+         "MB/s");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  CommandLine::Init(argc, argv);
+
+  const CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  int num_rows = kDefaultRows;
+  if (cmd_line->HasSwitch("rows") &&
+      (!base::StringToInt(cmd_line->GetSwitchValueASCII("rows"), &num_rows) ||
+       num_rows <= 0)) {
+    fprintf(stderr, "The number of rows must be a positive number.\n");
+    return 1;
+  }
+
+  base::MessageLoop message_loop;
+  StringTable file_table;
+  LogStore store(&file_table);
+  if (cmd_line->HasSwitch("index"))
+    store.EnableMessageIndex();
+
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  BuildLog(num_rows, &file_table, &store);
+  Report("build_log", num_rows, ElapsedMs(start), "ms");
+  Report("memory_per_row", num_rows,
+         static_cast<double>(store.GetMemoryUsage()) / num_rows, "bytes");
+
+  StoreLogView view(&store);
+
+  std::vector<Filter> filters;
+  filters.push_back(Filter(Filter::MESSAGE, Filter::CONTAINS,
+                           Filter::INCLUDE, L"failed"));
+  BenchmarkFilter("filter_contains", &view, filters);
+
+  filters.clear();
+  filters.push_back(Filter(Filter::PROCESS_ID, Filter::IS,
+                           Filter::INCLUDE, L"1005"));
+  filters.push_back(Filter(Filter::SEVERITY, Filter::IS,
+                           Filter::EXCLUDE, L"VERBOSE"));
+  BenchmarkFilter("filter_columns", &view, filters);
+
+  BenchmarkFind("find_next_near", &view, "Created tab");
+  BenchmarkFind("find_next_last", &view, kLastMessage);
+  BenchmarkFind("find_next_regex", &view, "status [0-9]+$");
+
+  BenchmarkFormatting(&view);
+  BenchmarkTranscoding(&view);
+
+  return 0;
+}
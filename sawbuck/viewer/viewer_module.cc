@@ -23,6 +23,8 @@
 #include "base/message_loop/message_loop.h"
 #include "base/message_loop/message_pump.h"
 #include "base/message_loop/message_pump_win.h"
+#include "sawbuck/log_lib/sawbuck_trace_provider.h"
+#include "sawbuck/viewer/responsiveness_monitor.h"
 #include "sawbuck/viewer/viewer_window.h"
 
 #include <initguid.h>  // NOLINT
@@ -66,20 +68,28 @@ class HybridMessageLoopObserver
   // @}
 
   // @name base::MessageLoop::TaskObserver implementation.
-  // Implemented to keep a task out for WTL idle processing.
+  // Implemented to keep a task out for WTL idle processing, and to time
+  // the tasks.
   // @{
   virtual void WillProcessTask(const base::PendingTask& pending_task) OVERRIDE;
   virtual void DidProcessTask(const base::PendingTask& pending_task) OVERRIDE;
   // @}
 
+  ResponsivenessMonitor* monitor() { return &monitor_; }
+
  private:
   void MaybeScheduleIdleTask();
   void OnIdleTask();
 
   bool idle_scheduled_;
+  ResponsivenessMonitor monitor_;
 };
 
 uint32_t HybridMessageLoopObserver::Dispatch(const base::NativeEvent& event) {
+  // The message's time is the tick count it was queued at.
+  DWORD wait_ms = ::GetTickCount() - event.time;
+  monitor_.MessageDispatched(base::TimeDelta::FromMilliseconds(wait_ms));
+
   // Make sure menus, toolbars and such are updated after event is handled.
   MaybeScheduleIdleTask();
 
@@ -88,6 +98,8 @@ uint32_t HybridMessageLoopObserver::Dispatch(const base::NativeEvent& event) {
 
 void HybridMessageLoopObserver::WillProcessTask(
     const base::PendingTask& pending_task) {
+  monitor_.TaskStarted(base::TimeTicks::Now());
+
   // Make sure we idle to update menus and such after each task or batch of
   // tasks has been handled.
   MaybeScheduleIdleTask();
@@ -95,7 +107,7 @@ void HybridMessageLoopObserver::WillProcessTask(
 
 void HybridMessageLoopObserver::DidProcessTask(
     const base::PendingTask& pending_task) {
-  // Intentionally empty.
+  monitor_.TaskFinished(pending_task.posted_from, base::TimeTicks::Now());
 }
 
 void HybridMessageLoopObserver::MaybeScheduleIdleTask() {
@@ -132,6 +144,8 @@ int APIENTRY wWinMain(HINSTANCE instance,
   settings.logging_dest = logging::LOG_NONE;
   logging::InitLogging(settings);
   logging::LogEventProvider::Initialize(kSawbuckLogProvider);
+  // Our own trace events, for profiling sawbuck.
+  SawbuckTraceProvider::Get()->Register();
 
   ::OleInitialize(NULL);
   ::InitCommonControls();
@@ -147,9 +161,11 @@ int APIENTRY wWinMain(HINSTANCE instance,
   message_loop.AddTaskObserver(&observer);
 
   ViewerWindow window;
+  window.set_responsiveness_monitor(observer.monitor());
   window.CreateEx();
   window.ShowWindow(show);
   window.UpdateWindow();
+  window.OfferLeftOverCheckpoint();
 
   CommandLine* cmd_line = CommandLine::ForCurrentProcess();
   if (cmd_line->HasSwitch("import")) {
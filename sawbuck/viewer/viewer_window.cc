@@ -15,19 +15,36 @@
 // Log viewer window implementation.
 #include "sawbuck/viewer/viewer_window.h"
 
-#include "pcrecpp.h"  // NOLINT
+#include <algorithm>
+#include <sstream>
 #include "base/bind.h"
+#include "base/debug/trace_event_win.h"
 #include "base/environment.h"
 #include "base/file_util.h"
 #include "base/logging.h"
+#include "base/logging_win.h"
 #include "base/path_service.h"
+#include "base/strings/string_split.h"
 #include "base/strings/string_util.h"
 #include "base/strings/stringprintf.h"
 #include "base/strings/utf_string_conversions.h"
 #include "base/win/event_trace_consumer.h"
+#include "build/build_config.h"
+#include "sawbuck/common/memory_budget.h"
+#include "sawbuck/common/perf_counters.h"
+#include "sawbuck/log_lib/kernel_capture_profile.h"
+#include "sawbuck/log_lib/kernel_log_types.h"
+#include "sawbuck/log_lib/sawbuck_trace_provider.h"
+#include "sawbuck/log_lib/trace_json_writer.h"
 #include "sawbuck/viewer/const_config.h"
+#include "sawbuck/viewer/import_scope_dialog.h"
+#include "sawbuck/viewer/log_diff.h"
 #include "sawbuck/viewer/preferences.h"
 #include "sawbuck/viewer/provider_dialog.h"
+#include "sawbuck/viewer/remote_agent_dialog.h"
+#include "sawbuck/viewer/responsiveness_monitor.h"
+#include "sawbuck/viewer/session_checkpoint.h"
+#include "sawbuck/viewer/session_search_dialog.h"
 #include "sawbuck/viewer/viewer_module.h"
 #include <initguid.h>  // NOLINT
 
@@ -37,13 +54,499 @@ const wchar_t* kMicrosoftSymSrv = L"http://msdl.microsoft.com/download/symbols";
 const wchar_t* kChromeSymSrv =
     L"http://chromium-browser-symsrv.commondatastorage.googleapis.com";
 
-// A regular expression that matches "[<stuff>:<file>(<line>)].message"
-// and extracts the file/line/message parts.
-const pcrecpp::RE kFileRe("\\[[^\\]]*\\:([^:]+)\\((\\d+)\\)\\].(.*\\w).*",
-                          PCRE_NEWLINE_ANYCRLF | PCRE_DOTALL | PCRE_UTF8);
-
 const wchar_t kSessionName[] = L"Sawbuck Log Session";
 
+// The number of rows each log consumer thread can queue for the UI
+// thread before spilling to the overflow list, must be a power of two.
+const size_t kLogRingCapacity = 8192;
+
+// The most real time sessions the app providers are split across.
+const DWORD kMaxAppSessions = 8;
+
+// The most times a second we update the views with new log messages,
+// unless the preferences say otherwise. Each update costs the UI thread
+// a repaint, so there's no sense in going much faster than the eye.
+const DWORD kDefaultNewItemsUpdatesPerSecond = 20;
+const DWORD kMaxNewItemsUpdatesPerSecond = 1000;
+
+// How long to hold captured rows for the kernel events before them, unless
+// the preferences say otherwise. The kernel session flushes every second,
+// so this trades the latency of the rows against the odds of their module
+// loads arriving late.
+const DWORD kDefaultReorderLatencyMs = 500;
+const DWORD kMaxReorderLatencyMs = 10 * 1000;
+// The most rows held for reordering, past which the earliest are released
+// regardless.
+const size_t kReorderBufferCapacity = 64 * 1024;
+// How soon to look again at rows held for reordering.
+const int kReorderRecheckMs = 50;
+
+#if defined(ARCH_CPU_64_BITS)
+// A 64-bit viewer has the address space for logs of any size, and for the
+// files of lazy imports to stay mapped.
+const bool kLargeAddressSpace = true;
+const DWORD kDefaultRetainMaxMb = 0;
+#else
+// A 32-bit viewer runs out of address space at a few million rows, so it
+// retains at most this many megabytes of them unless the preferences say
+// otherwise.
+const bool kLargeAddressSpace = false;
+const DWORD kDefaultRetainMaxMb = 1024;
+#endif
+
+// The newest rows whose messages the store keeps in the clear, older
+// messages are compressed, as they're rarely read but in a scroll back.
+const size_t kHotRows = 64 * 1024;
+
+// How much memory loaded symbols may take unless the preferences say
+// otherwise, in megabytes. Chrome's PDBs alone run to hundreds.
+const DWORD kDefaultSymbolCacheBudgetMb = kLargeAddressSpace ? 2048 : 512;
+const DWORD kMinSymbolCacheBudgetMb = 16;
+
+// How much memory our caches may take together unless the preferences say
+// otherwise, in megabytes. This leaves room for the display text beside
+// the default symbol budget.
+const DWORD kDefaultMemoryBudgetMb = kLargeAddressSpace ? 2304 : 768;
+const DWORD kMinMemoryBudgetMb = 32;
+// A 32-bit viewer's caches shed memory once the process commits this
+// much, to leave the rest of the address space to the rows.
+const uint64 kProcessCommitLimit =
+    kLargeAddressSpace ? 0 : MemoryBudget::kDefaultCommitLimit;
+// How often we check the caches against the budget and memory pressure.
+const int kMemoryCheckIntervalMs = 1000;
+
+// The modules we preload the symbols of when preloading is on, unless the
+// preferences say otherwise.
+const wchar_t kDefaultPreloadSymbolsModules[] =
+    L"chrome.dll;chrome_child.dll;chrome.exe";
+
+// The name sawbuck traces its imports under, they span from the start of
+// the import to its end.
+const char kImportTraceName[] = "ViewerWindow::ImportLogFiles";
+
+// The most span names the trace durations summary lists.
+const size_t kMaxTraceDurationNames = 30;
+// The most span names the regressions summary lists.
+const size_t kMaxSpanRegressionNames = 30;
+// The percentage of the baseline a span name regresses past by default.
+const DWORD kDefaultSpanRegressionPercent = 150;
+
+// The intervals of event rate history we keep, and the most sources the
+// event rates summary lists.
+const size_t kEventRateHistoryLength = 30;
+const size_t kMaxEventRateSources = 20;
+
+// The file type the performance statistics are saved as.
+_COMDLG_FILTERSPEC kTextFileSpec[] = { {L"Text File", L"*.txt"} };
+
+// Times from the scheduling of a new items notification to its dispatch,
+// which includes any holding off by the pacer.
+PerfCounter new_items_latency_counter("Notify.NewItemsLatency", 1);
+
+// The status bar pane that shows the cost of the updates, and its width.
+const int kUpdateCostPane = 1;
+const int kUpdateCostPaneWidth = 200;
+// And the pane that shows the statistics of our trace sessions.
+const int kSessionStatsPane = 2;
+const int kSessionStatsPaneWidth = 360;
+
+// The buffers of our trace sessions. The sessions start out with at most
+// kSessionMaximumBuffers, and grow when their consumers fall behind, up
+// to the memory the preferences allow.
+const ULONG kSessionBufferSizeKb = 16;
+const ULONG kSessionMinimumBuffers = 16;
+const ULONG kSessionMaximumBuffers = 64;
+const ULONG kSessionFlushTimerSeconds = 1;
+const DWORD kDefaultSessionBufferCeilingMb = 64;
+// How often we look at the statistics of the sessions.
+const int kSessionStatsIntervalMs = 2000;
+// When the app sessions fall behind with all the buffers they may have, the
+// noisiest providers are lowered a level a sample, down to warnings. They
+// get a level back after so many samples in a row of keeping up.
+const UCHAR kBackPressureFloor = TRACE_LEVEL_WARNING;
+const int kBackPressureCalmSamples = 5;
+
+// When the app sessions' parsing is deferred, their events are copied to
+// slabs the size of the session buffers, which are posted at the end of
+// each buffer. The slabs in use at once start out at so many, and grow when
+// the sessions lose buffers regardless, to no more than so many.
+const size_t kSlabSize = kSessionBufferSizeKb * 1024;
+const size_t kInitialSlabs = 16;
+const size_t kMaxSlabs = 1024;
+
+// How large each capture file may grow unless the preferences say
+// otherwise, in megabytes.
+const DWORD kDefaultCaptureFileMaxMb = 256;
+const DWORD kMinCaptureFileMaxMb = 1;
+
+// Retrieves the path of our persistent symbol cache, in the user's local
+// application data, and makes sure its directory exists.
+bool GetSymbolCachePath(base::FilePath* path) {
+  DCHECK(path != NULL);
+
+  base::FilePath app_data_dir;
+  if (!PathService::Get(base::DIR_LOCAL_APP_DATA, &app_data_dir))
+    return false;
+
+  base::FilePath cache_dir(app_data_dir.Append(L"Google").Append(L"Sawbuck"));
+  if (!base::CreateDirectory(cache_dir))
+    return false;
+
+  *path = cache_dir.Append(L"symbol_cache.dat");
+  return true;
+}
+
+int GetNewItemsUpdatesPerSecond() {
+  Preferences prefs;
+  DWORD value = 0;
+  prefs.ReadDWORDValue(config::kNewItemsUpdatesPerSecondValue, &value,
+                       kDefaultNewItemsUpdatesPerSecond);
+  return static_cast<int>(std::min(value, kMaxNewItemsUpdatesPerSecond));
+}
+
+// @returns the most buffers each of our sessions may grow to.
+uint32 GetSessionMaxBuffersCeiling() {
+  Preferences prefs;
+  DWORD value = 0;
+  prefs.ReadDWORDValue(config::kSessionBufferCeilingMbValue, &value,
+                       kDefaultSessionBufferCeilingMb);
+  return std::max(static_cast<uint32>(kSessionMaximumBuffers),
+                  static_cast<uint32>(value * 1024 / kSessionBufferSizeKb));
+}
+
+// Sets the buffers and flushing of a session's properties @p p.
+void SetSessionBuffers(EVENT_TRACE_PROPERTIES* p) {
+  DCHECK(p != NULL);
+  p->BufferSize = kSessionBufferSizeKb;
+  p->MinimumBuffers = kSessionMinimumBuffers;
+  p->MaximumBuffers = kSessionMaximumBuffers;
+  p->FlushTimer = kSessionFlushTimerSeconds;
+}
+
+// Queries the statistics of the session @p session_name and passes them
+// to @p sizer, growing the session's buffers should it ask to.
+// @returns a summary of the statistics, labeled by @p label.
+std::wstring SampleSession(const wchar_t* session_name,
+                           const wchar_t* label,
+                           SessionBufferSizer* sizer) {
+  DCHECK(sizer != NULL);
+
+  base::win::EtwTraceProperties props;
+  HRESULT hr = base::win::EtwTraceController::Query(session_name, &props);
+  if (FAILED(hr))
+    return base::StringPrintf(L"%ls: no statistics", label);
+
+  EVENT_TRACE_PROPERTIES* p = props.get();
+  SessionBufferSizer::Stats stats = {
+      p->NumberOfBuffers,
+      p->FreeBuffers,
+      p->MaximumBuffers,
+      p->EventsLost,
+      p->RealTimeBuffersLost,
+      p->BuffersWritten,
+    };
+  uint32 maximum_buffers = 0;
+  if (sizer->OnStats(stats, &maximum_buffers)) {
+    p->MaximumBuffers = maximum_buffers;
+    hr = base::win::EtwTraceController::Update(session_name, &props);
+    if (FAILED(hr)) {
+      LOG(WARNING) << "Failed to grow the buffers of session \""
+                   << session_name << "\", error 0x" << std::hex << hr;
+      p->MaximumBuffers = stats.maximum_buffers;
+    }
+  }
+
+  return base::StringPrintf(L"%ls: %lu events and %lu buffers lost, "
+                            L"%lu/%lu buffers",
+                            label,
+                            stats.events_lost,
+                            stats.real_time_buffers_lost,
+                            p->NumberOfBuffers,
+                            p->MaximumBuffers);
+}
+
+// Retrieves the capture file preferences.
+// @returns true iff the capture is to be written to @p path.
+bool GetCaptureFile(base::FilePath* path, bool* circular, ULONG* max_mb) {
+  DCHECK(path != NULL);
+  DCHECK(circular != NULL);
+  DCHECK(max_mb != NULL);
+
+  Preferences prefs;
+  std::wstring file;
+  prefs.ReadStringValue(config::kCaptureFileValue, &file, L"");
+  if (file.empty())
+    return false;
+
+  DWORD value = 0;
+  prefs.ReadDWORDValue(config::kCaptureFileCircularValue, &value, 1);
+  *circular = value != 0;
+  prefs.ReadDWORDValue(config::kCaptureFileMaxMbValue, &value,
+                       kDefaultCaptureFileMaxMb);
+  *max_mb = std::max(value, kMinCaptureFileMaxMb);
+  *path = base::FilePath(file);
+  return true;
+}
+
+// Configures @p sampler from the log sampling preferences.
+void ConfigureLogSampler(LogSampler* sampler) {
+  DCHECK(sampler != NULL);
+
+  Preferences prefs;
+  std::string spec;
+  prefs.ReadStringValue(config::kLogSamplingRulesValue, &spec, "");
+  std::vector<LogSampler::Rule> rules;
+  if (!LogSampler::ParseRules(spec, &rules)) {
+    LOG(ERROR) << "Ignoring malformed log sampling rules: " << spec;
+    rules.clear();
+  }
+  sampler->set_rules(rules);
+
+  DWORD rate_limit = 0;
+  prefs.ReadDWORDValue(config::kLogRateLimitValue, &rate_limit, 0);
+  sampler->set_rate_limit(rate_limit);
+}
+
+// Adds the counts of @p sampler to @p stats, whose rules are the same.
+void AddSamplingStats(const LogSampler& sampler, LogSampler::Stats* stats) {
+  DCHECK(stats != NULL);
+
+  LogSampler::Stats sampler_stats;
+  sampler.GetStats(&sampler_stats);
+  stats->messages += sampler_stats.messages;
+  stats->rate_limited += sampler_stats.rate_limited;
+  if (stats->rules.size() < sampler_stats.rules.size())
+    stats->rules.resize(sampler_stats.rules.size());
+  for (size_t i = 0; i < sampler_stats.rules.size(); ++i) {
+    stats->rules[i].matched += sampler_stats.rules[i].matched;
+    stats->rules[i].dropped += sampler_stats.rules[i].dropped;
+  }
+}
+
+// Has the session of @p props write to the file at @p path, as well as to
+// its real time consumer.
+HRESULT SetSessionLogFile(const base::FilePath& path,
+                          bool circular,
+                          ULONG max_mb,
+                          base::win::EtwTraceProperties* props) {
+  DCHECK(props != NULL);
+  EVENT_TRACE_PROPERTIES* p = props->get();
+  p->LogFileMode = EVENT_TRACE_REAL_TIME_MODE |
+      (circular ? EVENT_TRACE_FILE_MODE_CIRCULAR :
+                  EVENT_TRACE_FILE_MODE_SEQUENTIAL);
+  p->MaximumFileSize = max_mb;
+  return props->SetLoggerFileName(path.value().c_str());
+}
+
+// @returns the rows to retain of the capture.
+LogStore::Retention GetRetention() {
+  Preferences prefs;
+  DWORD max_rows = 0;
+  DWORD max_mb = 0;
+  DWORD max_minutes = 0;
+  prefs.ReadDWORDValue(config::kRetainMaxRowsValue, &max_rows, 0);
+  prefs.ReadDWORDValue(config::kRetainMaxMbValue, &max_mb,
+                       kDefaultRetainMaxMb);
+  prefs.ReadDWORDValue(config::kRetainMaxMinutesValue, &max_minutes, 0);
+
+  LogStore::Retention retention;
+  retention.max_rows = max_rows;
+  retention.max_bytes = static_cast<size_t>(max_mb) * 1024 * 1024;
+  retention.max_age = base::TimeDelta::FromMinutes(max_minutes);
+  return retention;
+}
+
+// @returns true iff repeated rows are to be collapsed.
+bool GetCollapseRepeats() {
+  Preferences prefs;
+  DWORD value = 0;
+  prefs.ReadDWORDValue(config::kCollapseRepeatsValue, &value, 0);
+  return value != 0;
+}
+
+// @returns the number of real time sessions to split the app providers
+// across.
+size_t GetNumAppSessions() {
+  Preferences prefs;
+  DWORD value = 1;
+  prefs.ReadDWORDValue(config::kAppSessionsValue, &value, 1);
+  return std::max(static_cast<DWORD>(1), std::min(value, kMaxAppSessions));
+}
+
+base::TimeDelta GetReorderLatency() {
+  Preferences prefs;
+  DWORD value = 0;
+  prefs.ReadDWORDValue(config::kReorderLatencyMsValue, &value,
+                       kDefaultReorderLatencyMs);
+  return base::TimeDelta::FromMilliseconds(
+      std::min(value, kMaxReorderLatencyMs));
+}
+
+// @returns the most memory loaded symbols may take, in bytes.
+uint64 GetSymbolCacheBudget() {
+  Preferences prefs;
+  DWORD value = 0;
+  prefs.ReadDWORDValue(config::kSymbolCacheBudgetValue, &value,
+                       kDefaultSymbolCacheBudgetMb);
+  return static_cast<uint64>(std::max(value, kMinSymbolCacheBudgetMb)) <<
+      20;
+}
+
+// @returns the most memory our caches may take together, in bytes.
+uint64 GetMemoryBudget() {
+  Preferences prefs;
+  DWORD value = 0;
+  prefs.ReadDWORDValue(config::kMemoryBudgetValue, &value,
+                       kDefaultMemoryBudgetMb);
+  return static_cast<uint64>(std::max(value, kMinMemoryBudgetMb)) << 20;
+}
+
+// Retrieves the modules to preload the symbols of to @p image_names, which
+// is empty unless preloading is on.
+void GetPreloadModules(std::vector<std::wstring>* image_names) {
+  DCHECK(image_names != NULL);
+  image_names->clear();
+
+  Preferences prefs;
+  DWORD preload = 0;
+  prefs.ReadDWORDValue(config::kPreloadSymbolsValue, &preload, 0);
+  if (preload == 0)
+    return;
+
+  std::wstring modules;
+  prefs.ReadStringValue(config::kPreloadSymbolsModulesValue, &modules,
+                        kDefaultPreloadSymbolsModules);
+  base::SplitString(modules, L';', image_names);
+}
+
+bool CaptureContextSwitches() {
+  Preferences prefs;
+  DWORD capture = 0;
+  prefs.ReadDWORDValue(config::kCaptureContextSwitchesValue, &capture, 0);
+  return capture != 0;
+}
+
+bool CaptureDiskIo() {
+  Preferences prefs;
+  DWORD capture = 0;
+  prefs.ReadDWORDValue(config::kCaptureDiskIoValue, &capture, 0);
+  return capture != 0;
+}
+
+bool CapturePageFaults() {
+  Preferences prefs;
+  DWORD capture = 0;
+  prefs.ReadDWORDValue(config::kCapturePageFaultsValue, &capture, 0);
+  return capture != 0;
+}
+
+bool CaptureCpuSamples() {
+  Preferences prefs;
+  DWORD capture = 0;
+  prefs.ReadDWORDValue(config::kCaptureCpuSamplesValue, &capture, 0);
+  return capture != 0;
+}
+
+bool CaptureRegistry() {
+  Preferences prefs;
+  DWORD capture = 0;
+  prefs.ReadDWORDValue(config::kCaptureRegistryValue, &capture, 0);
+  return capture != 0;
+}
+
+// @returns the kernel flags to capture, those of the kernel profile if one
+// is set, to @p profile_name, or those the capture values ask for.
+ULONG GetKernelEnableFlags(std::wstring* profile_name) {
+  DCHECK(profile_name != NULL);
+  Preferences prefs;
+  prefs.ReadStringValue(config::kKernelProfileValue, profile_name, L"");
+
+  // The thread events name the threads of the rows, so they're in either
+  // way, as are the process counters, which come only as processes end
+  // and at the rundowns.
+  ULONG flags = EVENT_TRACE_FLAG_IMAGE_LOAD | EVENT_TRACE_FLAG_PROCESS |
+      EVENT_TRACE_FLAG_THREAD | EVENT_TRACE_FLAG_PROCESS_COUNTERS;
+  kernel_capture_profile::Profile profile;
+  if (kernel_capture_profile::FindProfile(base::WideToUTF8(*profile_name),
+                                          &profile)) {
+    return flags | kernel_capture_profile::GetEnableFlags(profile);
+  }
+
+  profile_name->clear();
+  // The scheduler events are plentiful.
+  if (CaptureContextSwitches())
+    flags |= EVENT_TRACE_FLAG_CSWITCH | EVENT_TRACE_FLAG_DISPATCHER;
+  // The file I/O flag gets us the names of the files read.
+  if (CaptureDiskIo())
+    flags |= EVENT_TRACE_FLAG_DISK_IO | EVENT_TRACE_FLAG_DISK_FILE_IO;
+  if (CapturePageFaults()) {
+    flags |= EVENT_TRACE_FLAG_MEMORY_PAGE_FAULTS |
+        EVENT_TRACE_FLAG_MEMORY_HARD_FAULTS;
+  }
+  // The profile interrupts sample each processor at the default interval of
+  // a millisecond.
+  if (CaptureCpuSamples())
+    flags |= EVENT_TRACE_FLAG_PROFILE;
+  if (CaptureRegistry())
+    flags |= EVENT_TRACE_FLAG_REGISTRY;
+  return flags;
+}
+
+bool UseBackPressure() {
+  Preferences prefs;
+  DWORD back_pressure = 1;
+  prefs.ReadDWORDValue(config::kBackPressureValue, &back_pressure, 1);
+  return back_pressure != 0;
+}
+
+bool DeferParsing() {
+  Preferences prefs;
+  DWORD defer = 1;
+  prefs.ReadDWORDValue(config::kDeferParsingValue, &defer, 1);
+  return defer != 0;
+}
+
+double GetSpanRegressionFactor() {
+  Preferences prefs;
+  DWORD percent = kDefaultSpanRegressionPercent;
+  prefs.ReadDWORDValue(config::kSpanRegressionPercentValue, &percent,
+                       kDefaultSpanRegressionPercent);
+  if (percent <= 100)
+    percent = kDefaultSpanRegressionPercent;
+  return percent / 100.0;
+}
+
+// Asks the kernel logger @p session for the stacks of its profile
+// interrupts. The stack tracing setting is new to Windows 7, so on earlier
+// systems the samples come without stacks, and go unreported.
+// @returns true on success.
+bool EnableProfileStackWalks(TRACEHANDLE session) {
+  HMODULE advapi32 = ::GetModuleHandle(L"advapi32.dll");
+  if (!advapi32)
+    return false;
+
+  typedef ULONG (WINAPI* TraceSetInformationProc)(
+      TRACEHANDLE session, TRACE_INFO_CLASS info_class, void* info,
+      ULONG info_length);
+  TraceSetInformationProc trace_set_information =
+      reinterpret_cast<TraceSetInformationProc>(
+          ::GetProcAddress(advapi32, "TraceSetInformation"));
+  if (trace_set_information == NULL)
+    return false;
+
+  CLASSIC_EVENT_ID event_id = {};
+  event_id.EventGuid = kernel_log_types::kPerfInfoEventClass;
+  event_id.Type = kernel_log_types::kSampledProfileEvent;
+  ULONG error = trace_set_information(session, TraceStackTracingInfo,
+                                      &event_id, sizeof(event_id));
+  if (error != ERROR_SUCCESS) {
+    LOG(ERROR) << "Unable to enable profile stack walks, error " << error;
+    return false;
+  }
+
+  return true;
+}
+
 bool Is64BitSystem() {
   if (sizeof(void*) == 8)  // NOLINT
     return true;
@@ -66,6 +569,73 @@ bool Is64BitSystem() {
   return is_wow_64 != FALSE;
 }
 
+_COMDLG_FILTERSPEC kSessionFileSpec[] = {
+  {L"Sawbuck Session", L"*.sbsession"}
+};
+
+_COMDLG_FILTERSPEC kLibraryFileSpec[] = {
+  {L"Sawbuck Session or Index", L"*.sbsession;*.sbidx"}
+};
+
+_COMDLG_FILTERSPEC kTraceFileSpec[] = {
+  {L"Trace Event JSON", L"*.json"}
+};
+
+// Prompts for the path of a session or trace file with @p dialog.
+// @returns true on success.
+template <class Dialog>
+bool GetSessionPath(Dialog* dialog, base::FilePath* path) {
+  if (dialog->DoModal() != IDOK)
+    return false;
+
+  std::wstring file_path;
+  file_path.resize(MAX_PATH);
+  if (FAILED(dialog->GetFilePath(&file_path[0], MAX_PATH - 1)))
+    return false;
+  file_path.resize(wcslen(file_path.c_str()));
+
+  *path = base::FilePath(file_path);
+  return true;
+}
+
+// Reports to @p status_callback whether the session at @p path was
+// @p saved.
+void ReportSessionSaved(const base::FilePath& path,
+                        const base::Callback<void(const wchar_t*)>&
+                            status_callback,
+                        bool saved) {
+  std::wstring status;
+  if (saved) {
+    status = base::StringPrintf(L"Saved session to %ls\r\n",
+                                path.value().c_str());
+  } else {
+    status = base::StringPrintf(L"Failed to save session to %ls\r\n",
+                                path.value().c_str());
+  }
+  status_callback.Run(status.c_str());
+}
+
+// Writes the serialized session @p buffer to @p path, on the session
+// writer thread, and reports how it went to @p status_callback.
+void WriteSessionFile(const base::FilePath& path,
+                      const std::string* buffer,
+                      const base::Callback<void(const wchar_t*)>&
+                          status_callback) {
+  ReportSessionSaved(path, status_callback, LogIndex::WriteFile(path, *buffer));
+}
+
+// Retrieves the path of the checkpoint of our capture to @p path.
+// @returns true on success.
+bool GetCheckpointPath(base::FilePath* path) {
+  DCHECK(path != NULL);
+  base::FilePath temp_dir;
+  if (!base::GetTempDir(&temp_dir))
+    return false;
+
+  *path = temp_dir.Append(L"Sawbuck capture.sbcheckpoint");
+  return true;
+}
+
 }  // namespace
 
 bool operator < (const GUID& a, const GUID& b) {
@@ -75,135 +645,300 @@ bool operator < (const GUID& a, const GUID& b) {
 void ViewerWindow::CompileAsserts() {
 }
 
+ViewerWindow::PendingRowQueue::PendingRowQueue()
+    : ring(kLogRingCapacity), overflowing(0) {
+}
+
+ViewerWindow::AppSession::AppSession(const std::wstring& name,
+                                     LogEvents* sink)
+    : name(name),
+      rate_stats(kEventRateHistoryLength),
+      sampler(sink),
+      thread(base::WideToUTF8(name)),
+      ingest_thread(base::WideToUTF8(name + L" ingest")) {
+}
+
+ViewerWindow::AppSession::~AppSession() {
+}
+
 ViewerWindow::ViewerWindow()
      : symbol_lookup_worker_("Symbol Lookup Worker"),
+       log_store_(&file_table_),
+       notified_first_row_(0),
+       reorder_buffer_(kReorderBufferCapacity),
+       reorder_latency_(GetReorderLatency()),
+       capture_paused_(false),
        next_sink_cookie_(1),
+       stack_module_index_(&log_store_.stack_pool(), &symbol_lookup_service_),
+       log_sampler_(this),
        log_viewer_(this),
        ui_loop_(NULL),
        notify_log_view_new_items_(
           base::Bind(&ViewerWindow::NotifyLogViewNewItems,
                      base::Unretained(this))),
-       notify_log_view_new_items_pending_(false),
+       notify_log_view_new_items_pending_(0),
+       new_items_pacer_(GetNewItemsUpdatesPerSecond()),
+       new_items_deferred_(false),
        update_status_task_(base::Bind(&ViewerWindow::UpdateStatus,
                                       base::Unretained(this))),
        update_status_task_pending_(false),
-       log_consumer_thread_("Event log consumer"),
-       kernel_consumer_thread_("Kernel log consumer") {
+       responsiveness_monitor_(NULL),
+       process_instance_index_(&process_info_service_),
+       session_events_(&process_info_service_, &symbol_lookup_service_),
+       session_checkpoint_(&session_events_),
+       startup_thread_("Startup settings"),
+       symbol_path_ready_(true, false),
+       settings_ready_(true, false),
+       back_pressure_(kBackPressureFloor, kBackPressureCalmSamples),
+       back_pressure_on_(false),
+       kernel_consumer_thread_("Kernel log consumer"),
+       session_writer_thread_("Session writer") {
   ui_loop_ = base::MessageLoop::current();
   DCHECK(ui_loop_ != NULL);
 
+  // Index the messages, for Find and the message filters.
+  log_store_.EnableMessageIndex();
+  log_store_.set_retention(GetRetention());
+  log_store_.set_collapse_repeats(GetCollapseRepeats());
+  log_store_.set_hot_rows(kHotRows);
+
   symbol_lookup_worker_.Start();
   DCHECK(symbol_lookup_worker_.message_loop() != NULL);
 
   status_callback_ = base::Bind(&ViewerWindow::OnStatusUpdate,
                                 base::Unretained(this));
   symbol_lookup_service_.set_status_callback(status_callback_);
+  session_events_.set_module_process_sink(&process_tree_);
+  process_tree_.set_process_event_sink(&process_memory_service_);
+  process_memory_service_.set_process_event_sink(&symbol_lookup_service_);
+  process_memory_service_.set_page_fault_event_sink(&process_tree_);
+
+  trace_span_matcher_.set_span_sink(&span_index_);
 
   symbol_lookup_service_.set_background_thread(
       symbol_lookup_worker_.message_loop());
 
-  InitSymbolPath();
-  symbol_lookup_service_.SetSymbolPath(symbol_path_.c_str());
-
-  settings_.ReadProviders();
-  settings_.ReadSettings();
+  // The symbol path and the providers come out of the registry, which is
+  // slow enough on some machines to hold up the window. They're read in
+  // the background, until something needs them.
+  CHECK(startup_thread_.Start());
+  startup_thread_.message_loop()->PostTask(FROM_HERE,
+      base::Bind(&ViewerWindow::ReadStartupSettings,
+                 base::Unretained(this)));
+
+  base::FilePath symbol_cache_path;
+  if (GetSymbolCachePath(&symbol_cache_path))
+    symbol_lookup_service_.OpenPersistentCache(symbol_cache_path);
+  symbol_lookup_service_.SetSymbolCacheBudget(GetSymbolCacheBudget());
+
+  MemoryBudget* budget = MemoryBudget::Get();
+  budget->set_limit(GetMemoryBudget());
+  budget->set_commit_limit(kProcessCommitLimit);
+  memory_check_task_.Reset(base::Bind(&ViewerWindow::CheckMemory,
+                                      base::Unretained(this)));
+  ui_loop_->PostDelayedTask(FROM_HERE, memory_check_task_.callback(),
+      base::TimeDelta::FromMilliseconds(kMemoryCheckIntervalMs));
+
+  std::vector<std::wstring> preload_modules;
+  GetPreloadModules(&preload_modules);
+  symbol_lookup_service_.SetPreloadModules(preload_modules);
 }
 
 ViewerWindow::~ViewerWindow() {
+  if (responsiveness_monitor_ != NULL) {
+    responsiveness_monitor_->set_stall_callback(
+        ResponsivenessMonitor::StallCallback());
+  }
+
+  // The startup settings go to our services.
+  startup_thread_.Stop();
+
+  // The importer, the remote capture and the follower refer to our
+  // services, wind them up first.
+  importer_.reset();
+  remote_capture_.reset();
+  log_follower_.reset();
+
   // Last resort..
   StopCapturing();
 
+  // Let any session being written finish, it reports to our status. A
+  // clean exit leaves no checkpoint behind.
+  session_checkpoint_.Stop();
+  session_writer_thread_.Stop();
   symbol_lookup_worker_.Stop();
 
   notify_log_view_new_items_.Cancel();
   update_status_task_.Cancel();
+  session_stats_task_.Cancel();
+  memory_check_task_.Cancel();
 }
 
-namespace {
-
-class ImportLogConsumer
-    : public base::win::EtwTraceConsumerBase<ImportLogConsumer>,
-      public LogParser,
-      public KernelLogParser {
- public:
-  ImportLogConsumer();
-  ~ImportLogConsumer();
-
-  static void ProcessEvent(PEVENT_TRACE event);
-
- private:
-  static ImportLogConsumer* current_;
-};
-
-ImportLogConsumer* ImportLogConsumer::current_ = NULL;
-
-ImportLogConsumer::ImportLogConsumer() {
-  DCHECK(current_ == NULL);
-  current_ = this;
+void ViewerWindow::ImportLogFiles(const std::vector<base::FilePath>& paths) {
+  StartImport(paths, false, LogImporter::Scope());
 }
 
-ImportLogConsumer::~ImportLogConsumer() {
-  DCHECK(current_ == this);
-  current_ = NULL;
+void ViewerWindow::set_responsiveness_monitor(
+    ResponsivenessMonitor* monitor) {
+  DCHECK(monitor != NULL);
+  responsiveness_monitor_ = monitor;
+  responsiveness_monitor_->set_stall_callback(
+      base::Bind(&ViewerWindow::OnUIStall, base::Unretained(this)));
 }
 
-void ImportLogConsumer::ProcessEvent(PEVENT_TRACE event) {
-  DCHECK(current_ != NULL);
-
-  if (!current_->LogParser::ProcessOneEvent(event) &&
-      !current_->KernelLogParser::ProcessOneEvent(event)) {
-    LOG(INFO) << "Unknown event";
+void ViewerWindow::ImportLogFilesLazily(
+    const std::vector<base::FilePath>& paths) {
+  // The files of a lazy import stay mapped, which only fits a large
+  // address space, and the entries of report archives don't outlive the
+  // import.
+  bool has_archive = false;
+  for (size_t i = 0; i < paths.size(); ++i)
+    has_archive = has_archive || ReportArchive::IsReportArchive(paths[i]);
+  if (!kLargeAddressSpace || has_archive) {
+    ImportLogFiles(paths);
+    return;
   }
+
+  // The lazy rows replace what we have.
+  if (importer_.get() == NULL)
+    ClearAll();
+  StartImport(paths, true, LogImporter::Scope());
 }
 
-}  // namespace
+void ViewerWindow::StartImport(const std::vector<base::FilePath>& paths,
+                               bool lazy,
+                               const LogImporter::Scope& scope) {
+  // Only one import at a time, and none while capturing remotely or
+  // following a log.
+  if (importer_.get() != NULL || remote_capture_.get() != NULL ||
+      log_follower_.get() != NULL) {
+    return;
+  }
+
+  // The rows of a lazy import don't mix with others.
+  if (lazy_log_.get() != NULL)
+    ClearAll();
+
+  // The imported modules' symbols are looked up on the symbol path.
+  WaitForSymbolPath();
 
-void ViewerWindow::ImportLogFiles(const std::vector<base::FilePath>& paths) {
   UISetText(0, L"Importing");
   UIUpdateStatusBar();
+  UIEnable(ID_FILE_IMPORT, false);
+  UIEnable(ID_FILE_IMPORT_SCOPED, false);
+  UIEnable(ID_FILE_IMPORT_LAZILY, false);
+  UIEnable(ID_FILE_CANCEL_IMPORT, true);
+  UIEnable(ID_FILE_FOLLOW_LOG, false);
+  UIEnable(ID_FILE_RELOAD_CAPTURE, false);
+  UIEnable(ID_FILE_OPEN_SESSION, false);
+  UIEnable(ID_LOG_CAPTURE, false);
+  UIEnable(ID_LOG_CAPTURE_REMOTE, false);
+
+  importer_.reset(new LogImporter(&file_table_,
+                                  &session_events_,
+                                  &session_events_,
+                                  this));
+  importer_->set_lazy(lazy);
+  importer_->set_scope(scope);
+  SawbuckTraceProvider::Get()->TraceEvent(kImportTraceName,
+                                          importer_.get(),
+                                          base::debug::kTraceEventTypeBegin,
+                                          NULL);
+  importer_->Start(paths);
+}
 
-  ImportLogConsumer import_consumer;
+void ViewerWindow::OnImportProgress(int percent_done) {
+  UISetText(0, base::StringPrintf(L"Importing %d%%", percent_done).c_str());
+  UIUpdateStatusBar();
+}
 
-  // Open all the log files.
-  for (size_t i = 0; i < paths.size(); ++i) {
-    HRESULT hr = import_consumer.OpenFileSession(paths[i].value().c_str());
+void ViewerWindow::OnImportDone(HRESULT hr) {
+  DCHECK(importer_.get() != NULL);
 
-    if (FAILED(hr)) {
-      std::wstring msg =
-          base::StringPrintf(L"Failed to open log file \"%ls\", error 0x%08X",
-                             paths[i].value().c_str(),
-                             hr);
+  // Keep whatever was imported, even on failure or cancellation.
+  FlushPendingRows();
+  if (importer_->lazy()) {
+    // The store was cleared for the lazy rows, which stand in for it.
+    lazy_log_.reset(new LazyLog(&file_table_));
+    importer_->MergeInto(lazy_log_.get());
+    UIEnable(ID_FILE_SAVE_SESSION, false);
+  } else {
+    // The merged rows are tallied by process as a whole, as they bypass
+    // the pending rows. The lazy rows go untallied, as they're decoded as
+    // they're shown.
+    int first_merged = log_store_.num_rows();
+    importer_->MergeInto(&log_store_);
+    process_tree_.AddStoreRows(log_store_,
+                               std::max(first_merged, log_store_.first_row()),
+                               log_store_.num_rows());
+  }
+  ScheduleNewItemsNotification();
 
-      ::MessageBox(m_hWnd, msg.c_str(), L"Error Importing Logs", MB_OK);
-      return;
-    }
+  // A report's system information and registry extract show beside the
+  // process tree.
+  if (!importer_->report_texts().empty())
+    log_viewer_.SetReportTexts(importer_->report_texts());
+
+  LogImporter::LossCounts losses = importer_->GetLossCounts();
+  loss_summary_.clear();
+  if (losses.events_lost != 0 || losses.buffers_lost != 0 ||
+      losses.num_markers != 0) {
+    loss_summary_ = base::StringPrintf(
+        L"Import: %I64u events and %I64u buffers lost, %Iu marked",
+        losses.events_lost, losses.buffers_lost, losses.num_markers);
   }
+  // Rows were in several files if they overlapped, e.g. rotated logs.
+  if (importer_->num_duplicates() != 0) {
+    loss_summary_ += base::StringPrintf(
+        loss_summary_.empty() ? L"Import: %Iu duplicates dropped" :
+                                L", %Iu duplicates dropped",
+        importer_->num_duplicates());
+  }
+  UpdateIdleStats();
+  SawbuckTraceProvider::Get()->TraceEvent(kImportTraceName,
+                                          importer_.get(),
+                                          base::debug::kTraceEventTypeEnd,
+                                          NULL);
 
-  // Attach our event sinks to the consumer.
-  import_consumer.set_event_sink(this);
-  import_consumer.set_trace_sink(this);
-  import_consumer.set_process_event_sink(&process_info_service_);
-  import_consumer.set_module_event_sink(&symbol_lookup_service_);
+  // We're called from the importer, so it has to go away later.
+  ui_loop_->DeleteSoon(FROM_HERE, importer_.release());
 
-  // Consume the files.
-  // TODO(siggi): Report progress here.
-  HRESULT hr = import_consumer.Consume();
-  if (FAILED(hr)) {
+  UISetText(0, L"Ready");
+  UIUpdateStatusBar();
+  UIEnable(ID_FILE_IMPORT, true);
+  UIEnable(ID_FILE_IMPORT_SCOPED, true);
+  UIEnable(ID_FILE_IMPORT_LAZILY, kLargeAddressSpace);
+  UIEnable(ID_FILE_CANCEL_IMPORT, false);
+  UIEnable(ID_FILE_FOLLOW_LOG, true);
+  UIEnable(ID_FILE_RELOAD_CAPTURE, !capture_files_.empty());
+  UIEnable(ID_FILE_OPEN_SESSION, true);
+  UIEnable(ID_LOG_CAPTURE, true);
+  UIEnable(ID_LOG_CAPTURE_REMOTE, true);
+
+  if (FAILED(hr) && hr != E_ABORT) {
     std::wstring msg =
         base::StringPrintf(L"Import failed with error 0x%08X", hr);
     ::MessageBox(m_hWnd, msg.c_str(), L"Error Importing Logs", MB_OK);
   }
-
-  UISetText(0, L"Ready");
-  UIUpdateStatusBar();
 }
 
 const wchar_t kLogFileFilter[] =
     L"Event Trace Files\0*.etl\0"
+    L"Sawdust Reports\0*.zip\0"
     L"All Files\n\0*.*\0";
 
 void ViewerWindow::SetCapture(bool capture) {
-  bool capturing = (log_controller_.session() != NULL);
+  // The local capture doesn't mix with a remote one, nor with a followed
+  // log.
+  if (remote_capture_.get() != NULL || log_follower_.get() != NULL)
+    capture = false;
+
+  // What was spilled while paused goes to the store before the capture
+  // stops.
+  if (!capture)
+    SetCapturePaused(false);
+
+  bool capturing = IsCapturing();
   if (capturing != capture) {
     if (capture) {
       if (!StartCapturing()) {
@@ -217,36 +952,371 @@ void ViewerWindow::SetCapture(bool capture) {
 
   // Only allow import when not capturing.
   UIEnable(ID_FILE_IMPORT, !capture);
+  UIEnable(ID_FILE_IMPORT_SCOPED, !capture);
+  UIEnable(ID_FILE_IMPORT_LAZILY, kLargeAddressSpace && !capture);
+  UIEnable(ID_FILE_FOLLOW_LOG, !capture);
+  UIEnable(ID_FILE_RELOAD_CAPTURE, !capture && !capture_files_.empty());
+  UIEnable(ID_FILE_OPEN_SESSION, !capture);
+  UIEnable(ID_LOG_CAPTURE_REMOTE, !capture);
+  UIEnable(ID_LOG_PAUSE_CAPTURE, capture);
   UISetCheck(ID_LOG_CAPTURE, capture);
 }
 
+void ViewerWindow::SetCapturePaused(bool paused) {
+  DCHECK_EQ(ui_loop_, base::MessageLoop::current());
+  if (paused == capture_paused_)
+    return;
+
+  // The rows due go where they would have before the change.
+  DrainPendingRows();
+  capture_paused_ = paused;
+  UISetCheck(ID_LOG_PAUSE_CAPTURE, paused);
+  if (paused) {
+    UISetText(0, L"Capture paused");
+    return;
+  }
+
+  // The rows spilled are appended straight from their columns, and the
+  // views hear of them in a single notification.
+  int first_new = log_store_.num_rows();
+  if (capture_spill_.AppendTo(&log_store_))
+    UISetText(0, L"Capture resumed");
+  else
+    UISetText(0, L"Capture resumed, some paused rows were lost");
+  process_tree_.AddStoreRows(log_store_,
+                             std::max(first_new, log_store_.first_row()),
+                             log_store_.num_rows());
+  NotifyLogViewEvicted();
+  ScheduleNewItemsNotification();
+}
+
+bool ViewerWindow::PromptForLogFiles(std::vector<base::FilePath>* paths) {
+  DCHECK(paths != NULL);
+  CMultiFileDialog dialog(NULL, NULL, 0, kLogFileFilter, m_hWnd);
+
+  if (dialog.DoModal() != IDOK)
+    return false;
+
+  std::wstring path;
+  int len = dialog.GetFirstPathName(NULL, 0);
+  DCHECK(len != 0);
+  path.resize(len);
+  len = dialog.GetFirstPathName(&path[0], path.size());
+  DCHECK(len != 0);
+
+  do {
+    paths->push_back(base::FilePath(path));
+
+    len = dialog.GetNextPathName(NULL, 0);
+    if (len != 0) {
+      path.resize(len);
+      len = dialog.GetNextPathName(&path[0], path.size());
+    }
+  } while (len != 0);
+
+  return true;
+}
+
 LRESULT ViewerWindow::OnImport(
     WORD code, LPARAM lparam, HWND wnd, BOOL& handled) {
-  CMultiFileDialog dialog(NULL, NULL, 0, kLogFileFilter, m_hWnd);
+  std::vector<base::FilePath> paths;
+  if (PromptForLogFiles(&paths))
+    ImportLogFiles(paths);
+
+  return 0;
+}
+
+LRESULT ViewerWindow::OnImportLazily(
+    WORD code, LPARAM lparam, HWND wnd, BOOL& handled) {
+  std::vector<base::FilePath> paths;
+  if (PromptForLogFiles(&paths))
+    ImportLogFilesLazily(paths);
+
+  return 0;
+}
+
+LRESULT ViewerWindow::OnImportScoped(
+    WORD code, LPARAM lparam, HWND wnd, BOOL& handled) {
+  std::vector<base::FilePath> paths;
+  if (!PromptForLogFiles(&paths))
+    return 0;
+
+  ImportScopeDialog dialog(import_scope_begin_, import_scope_duration_,
+                           import_scope_process_ids_);
+  if (dialog.DoModal(m_hWnd) != IDOK)
+    return 0;
+
+  LogImporter::Scope scope;
+  if (!LogImporter::ParseScope(dialog.begin(), dialog.duration(),
+                               dialog.process_ids(), &scope)) {
+    ::MessageBox(m_hWnd, L"The times should read as seconds, and the "
+                 L"processes as ids separated by commas.",
+                 L"Import Log Range", MB_OK);
+    return 0;
+  }
+  import_scope_begin_ = dialog.begin();
+  import_scope_duration_ = dialog.duration();
+  import_scope_process_ids_ = dialog.process_ids();
+
+  StartImport(paths, false, scope);
+  return 0;
+}
+
+LRESULT ViewerWindow::OnCancelImport(
+    WORD code, LPARAM lparam, HWND wnd, BOOL& handled) {
+  if (importer_.get() != NULL)
+    importer_->Cancel();
+
+  return 0;
+}
+
+LRESULT ViewerWindow::OnReloadCapture(
+    WORD code, LPARAM lparam, HWND wnd, BOOL& handled) {
+  if (IsCapturing() || importer_.get() != NULL ||
+      remote_capture_.get() != NULL || log_follower_.get() != NULL ||
+      capture_files_.empty()) {
+    return 0;
+  }
+
+  // The files hold everything the real time consumers saw, and whatever
+  // they lost, so they replace what we have.
+  std::vector<base::FilePath> paths;
+  for (size_t i = 0; i < capture_files_.size(); ++i) {
+    if (base::PathExists(capture_files_[i]))
+      paths.push_back(capture_files_[i]);
+  }
+  if (paths.empty())
+    return 0;
+
+  ClearAll();
+  ImportLogFiles(paths);
+  return 0;
+}
+
+LRESULT ViewerWindow::OnOpenSession(
+    WORD code, LPARAM lparam, HWND wnd, BOOL& handled) {
+  if (IsCapturing() || importer_.get() != NULL ||
+      remote_capture_.get() != NULL || log_follower_.get() != NULL) {
+    return 0;
+  }
+
+  CShellFileOpenDialog dialog(NULL,
+                              FOS_FORCEFILESYSTEM | FOS_FILEMUSTEXIST,
+                              L"sbsession",
+                              &kSessionFileSpec[0],
+                              arraysize(kSessionFileSpec));
+  base::FilePath path;
+  if (GetSessionPath(&dialog, &path))
+    OpenSession(path);
+
+  return 0;
+}
+
+void ViewerWindow::OfferLeftOverCheckpoint() {
+  base::FilePath path;
+  if (!GetCheckpointPath(&path) || !SessionCheckpoint::IsLeftOver(path))
+    return;
+
+  int answer = MessageBox(L"Sawbuck exited while capturing, and left a "
+                          L"checkpoint of the capture behind. Open it as a "
+                          L"session? Otherwise it's discarded.",
+                          L"Capture Checkpoint",
+                          MB_YESNO | MB_ICONQUESTION);
+  if (answer == IDYES)
+    OpenSession(path);
+
+  // Its rows are in the store, and checkpointed again as we capture.
+  base::DeleteFile(path, false);
+}
+
+void ViewerWindow::StartCheckpoint() {
+  base::FilePath path;
+  if (session_checkpoint_.is_started() || !GetCheckpointPath(&path))
+    return;
+
+  if (!session_writer_thread_.IsRunning())
+    CHECK(session_writer_thread_.Start());
+  session_checkpoint_.Start(path, session_writer_thread_.message_loop());
+}
+
+bool ViewerWindow::OpenSession(const base::FilePath& path) {
+  // The session replaces what we have. Its kernel events go by way of
+  // session_events_, so they're kept for the next save, and their modules
+  // to the symbol lookups.
+  WaitForSymbolPath();
+  ClearAll();
+  LogIndex loader(&session_events_, &session_events_);
+  std::string filters;
+  if (!loader.LoadSession(path, &log_store_, &filters)) {
+    LOG(ERROR) << "Failed to open session: " << path.value();
+    MessageBox(L"Failed to open the session.", L"Error Opening Session",
+               MB_OK | MB_ICONWARNING);
+    return false;
+  }
+  process_tree_.AddStoreRows(log_store_, log_store_.first_row(),
+                             log_store_.num_rows());
+  ScheduleNewItemsNotification();
+
+  log_viewer_.SetFilters(Filter::DeserializeFilters(filters));
+  return true;
+}
+
+LRESULT ViewerWindow::OnAddToLibrary(
+    WORD code, LPARAM lparam, HWND wnd, BOOL& handled) {
+  CShellFileOpenDialog dialog(NULL,
+                              FOS_FORCEFILESYSTEM | FOS_FILEMUSTEXIST,
+                              L"sbsession",
+                              &kLibraryFileSpec[0],
+                              arraysize(kLibraryFileSpec));
+  base::FilePath path;
+  if (!GetSessionPath(&dialog, &path))
+    return 0;
+
+  // Registering indexes the file's messages for searching in the
+  // background, unless its search index is up to date already.
+  if (!session_library_.Register(path)) {
+    MessageBox(L"The file is not a session or an index.",
+               L"Error Adding to Session Library", MB_OK | MB_ICONWARNING);
+    return 0;
+  }
+
+  Preferences prefs;
+  std::string library;
+  session_library_.SerializePaths(&library);
+  prefs.WriteStringValue(config::kSessionLibraryValue, library);
+  return 0;
+}
+
+LRESULT ViewerWindow::OnSearchLibrary(
+    WORD code, LPARAM lparam, HWND wnd, BOOL& handled) {
+  if (session_library_.paths().empty()) {
+    MessageBox(L"Add sessions to the library to search them.",
+               L"Search Session Library", MB_OK);
+    return 0;
+  }
+
+  SessionSearchDialog dialog(&session_library_, session_search_text_);
+  INT_PTR picked = dialog.DoModal(m_hWnd);
+  session_search_text_ = dialog.text();
+  if (picked != IDOK)
+    return 0;
+
+  // The row picked opens in its session, or in its log for an index.
+  if (IsCapturing() || importer_.get() != NULL ||
+      remote_capture_.get() != NULL || log_follower_.get() != NULL) {
+    MessageBox(L"Stop capturing or importing to open the row.",
+               L"Search Session Library", MB_OK);
+    return 0;
+  }
+
+  const SessionLibrary::Hit& hit = dialog.hit();
+  const base::FilePath& path = session_library_.paths()[hit.file];
+  base::FilePath log_path;
+  if (LogIndex::GetLogPath(path, &log_path)) {
+    ClearAll();
+    ImportLogFiles(std::vector<base::FilePath>(1, log_path));
+  } else if (!OpenSession(path)) {
+    return 0;
+  }
+
+  // The rows reach the list along the way, which waits for them.
+  log_viewer_.GoToTime(hit.time);
+  return 0;
+}
+
+LRESULT ViewerWindow::OnSaveSession(
+    WORD code, LPARAM lparam, HWND wnd, BOOL& handled) {
+  CShellFileSaveDialog dialog(L"session",
+                              FOS_FORCEFILESYSTEM | FOS_PATHMUSTEXIST |
+                                  FOS_OVERWRITEPROMPT,
+                              L"sbsession",
+                              &kSessionFileSpec[0],
+                              arraysize(kSessionFileSpec));
+  base::FilePath path;
+  if (!GetSessionPath(&dialog, &path))
+    return 0;
 
-  if (dialog.DoModal() == IDOK) {
-    std::vector<base::FilePath> paths;
+  // The store belongs to the UI thread, so it's serialized here, then
+  // written out in the background. While checkpointing, only the rows
+  // since the last chunk are, and the checkpoint is copied.
+  DrainPendingRows();
+  ScheduleNewItemsNotification();
+  std::string filters(Filter::SerializeFilters(log_viewer_.GetFilters()));
+  if (session_checkpoint_.is_started()) {
+    session_checkpoint_.Save(log_store_, filters, path,
+        base::Bind(&ReportSessionSaved, path, status_callback_));
+  } else {
+    std::string* buffer = new std::string;
+    session_events_.SerializeSession(log_store_, filters, buffer);
+
+    if (!session_writer_thread_.IsRunning())
+      CHECK(session_writer_thread_.Start());
+    session_writer_thread_.message_loop()->PostTask(FROM_HERE,
+        base::Bind(&WriteSessionFile, path, base::Owned(buffer),
+                   status_callback_));
+  }
 
-    std::wstring path;
-    int len = dialog.GetFirstPathName(NULL, 0);
-    DCHECK(len != 0);
-    path.resize(len);
-    len = dialog.GetFirstPathName(&path[0], path.size());
-    DCHECK(len != 0);
+  UISetText(0, L"Saving session");
+  UIUpdateStatusBar();
+  return 0;
+}
 
-    do {
-      paths.push_back(base::FilePath(path));
+LRESULT ViewerWindow::OnExportTrace(
+    WORD code, LPARAM lparam, HWND wnd, BOOL& handled) {
+  CShellFileSaveDialog dialog(L"trace",
+                              FOS_FORCEFILESYSTEM | FOS_PATHMUSTEXIST |
+                                  FOS_OVERWRITEPROMPT,
+                              L"json",
+                              &kTraceFileSpec[0],
+                              arraysize(kTraceFileSpec));
+  base::FilePath path;
+  if (!GetSessionPath(&dialog, &path))
+    return 0;
 
-      len = dialog.GetNextPathName(NULL, 0);
-      if (len != 0) {
-        path.resize(len);
-        len = dialog.GetNextPathName(&path[0], path.size());
+  FILE* file = file_util::OpenFile(path, "wb");
+  bool written = file != NULL;
+  size_t num_spans = 0;
+  if (file != NULL) {
+    LogExportWriter::FileOutput output(file);
+    TraceJsonWriter writer(&output, LogExportWriter::kDefaultBufferSize);
+    writer.set_process_info_service(&process_info_service_);
+
+    // The spans are read out a track at a time, so we hold no more than
+    // a track's worth at once.
+    std::vector<ISpanIndex::Track> tracks;
+    span_index_.GetTracks(&tracks);
+    base::Time first;
+    base::Time last;
+    if (span_index_.GetTimeRange(&first, &last)) {
+      const base::TimeDelta slop(base::TimeDelta::FromMicroseconds(1));
+      std::vector<ISpanIndex::Span> spans;
+      for (size_t i = 0; i < tracks.size(); ++i) {
+        const ISpanIndex::Track& track = tracks[i];
+        span_index_.GetSpans(track, first - slop, last + slop, &spans);
+        for (size_t j = 0; j < spans.size(); ++j) {
+          const ISpanIndex::Span& span = spans[j];
+          writer.WriteSpan(track.process_id, track.thread_id, *span.name,
+                           span.begin, span.end, span.depth);
+        }
       }
-    } while (len != 0);
+    }
 
-    ImportLogFiles(paths);
+    written = writer.Finish();
+    num_spans = writer.num_spans();
+    written = file_util::CloseFile(file) && written;
   }
 
+  std::wstring status;
+  if (written) {
+    status = base::StringPrintf(L"Exported %u spans to %ls",
+                                static_cast<unsigned>(num_spans),
+                                path.value().c_str());
+  } else {
+    status = base::StringPrintf(L"Failed to export spans to %ls",
+                                path.value().c_str());
+  }
+  UISetText(0, status.c_str());
+  UIUpdateStatusBar();
   return 0;
 }
 
@@ -264,13 +1334,23 @@ LRESULT ViewerWindow::OnAbout(
 }
 
 void ViewerWindow::StopCapturing() {
-  log_controller_.Stop(NULL);
+  for (size_t i = 0; i < app_sessions_.size(); ++i)
+    app_sessions_[i]->controller.Stop(NULL);
   kernel_controller_.Stop(NULL);
-  log_consumer_thread_.Stop();
-  log_consumer_.reset();
+  for (size_t i = 0; i < app_sessions_.size(); ++i) {
+    AppSession* session = app_sessions_[i];
+    // The consumer is through with the ingest thread once it stops.
+    session->thread.Stop();
+    session->ingest_thread.Stop();
+    session->consumer.reset();
+    session->buffer_sizer.reset();
+  }
 
   kernel_consumer_thread_.Stop();
   kernel_consumer_.reset();
+
+  session_stats_task_.Cancel();
+  kernel_buffer_sizer_.reset();
 }
 
 static bool TestAndOfferToStopSession(HWND parent,
@@ -313,70 +1393,125 @@ static bool TestAndOfferToStopSession(HWND parent,
 }
 
 bool ViewerWindow::StartCapturing() {
-  DCHECK(NULL == log_controller_.session());
+  DCHECK(!IsCapturing());
   DCHECK(NULL == kernel_controller_.session());
-  DCHECK(NULL == log_consumer_.get());
   DCHECK(NULL == kernel_consumer_.get());
 
+  // The providers to enable, and the symbols of what we capture, have to
+  // be known by now.
+  WaitForProviderSettings();
+
+  // The rows of the last capture go to the store before its sessions go.
+  FlushPendingRows();
+  app_sessions_.clear();
+  size_t num_app_sessions = GetNumAppSessions();
+  for (size_t i = 0; i < num_app_sessions; ++i) {
+    std::wstring name(kSessionName);
+    if (i != 0)
+      name += base::StringPrintf(L" %d", static_cast<int>(i + 1));
+    app_sessions_.push_back(new AppSession(name, this));
+  }
+
   // Preflight the start operation by seeing whether one of the log sessions
   // we're going to establish are already in use, and offer to stop them if so.
-  if (!TestAndOfferToStopSession(m_hWnd, kSessionName) ||
-      !TestAndOfferToStopSession(m_hWnd, KERNEL_LOGGER_NAME)) {
-    // One or both log sessions still in use.
-    return false;
+  for (size_t i = 0; i < app_sessions_.size(); ++i) {
+    if (!TestAndOfferToStopSession(m_hWnd, app_sessions_[i]->name.c_str()))
+      return false;
   }
-
-  // Create a session for our log message capturing.
-  base::win::EtwTraceProperties log_props;
-  EVENT_TRACE_PROPERTIES* p = log_props.get();
-  // Use the QPC timer, see
-  // http://msdn.microsoft.com/en-us/library/aa364160(v=vs.85).aspx.
-  p->Wnode.ClientContext = 1;
-  p->LogFileMode = EVENT_TRACE_REAL_TIME_MODE;
-  p->MaximumFileSize = 100;  // 100 M file size.
-  // Get image load and process events.
-  p->FlushTimer = 1;  // flush every second.
-  p->BufferSize = 16;  // 16 K buffers.
-  HRESULT hr = log_controller_.Start(kSessionName, &log_props);
-  if (FAILED(hr))
+  if (!TestAndOfferToStopSession(m_hWnd, KERNEL_LOGGER_NAME))
     return false;
 
-  // And open a consumer on it.
-  log_consumer_.reset(new LogConsumer());
-  log_consumer_->set_event_sink(this);
-  log_consumer_->set_trace_sink(this);
-  hr = log_consumer_->OpenRealtimeSession(kSessionName);
-  if (FAILED(hr))
-    return false;
-
-  // Consume it in a new thread.
-  CHECK(log_consumer_thread_.Start());
-  log_consumer_thread_.message_loop()->PostTask(FROM_HERE,
-      base::Bind(base::IgnoreResult(&LogConsumer::Consume),
-                 base::Unretained(log_consumer_.get())));
+  // The captured rows don't mix with those of a lazy import.
+  if (lazy_log_.get() != NULL)
+    ClearAll();
+
+  // Create the sessions for our log message capturing, and write them to
+  // files too, if asked. The first session writes to the capture file, the
+  // others beside it.
+  capture_files_.clear();
+  base::FilePath capture_file;
+  bool circular = false;
+  ULONG max_file_mb = 0;
+  bool capture_to_file = GetCaptureFile(&capture_file, &circular,
+                                        &max_file_mb);
+  for (size_t i = 0; i < app_sessions_.size(); ++i) {
+    base::FilePath session_file;
+    if (capture_to_file && i == 0)
+      session_file = capture_file;
+    if (capture_to_file && i != 0) {
+      session_file = capture_file.InsertBeforeExtension(
+          base::StringPrintf(L".%d", static_cast<int>(i + 1)));
+    }
+    if (!StartAppSession(app_sessions_[i], session_file, circular,
+                         max_file_mb)) {
+      return false;
+    }
+  }
 
   // Start the kernel logger session.
   base::win::EtwTraceProperties kernel_props;
-  p = kernel_props.get();
+  EVENT_TRACE_PROPERTIES* p = kernel_props.get();
   p->Wnode.Guid = SystemTraceControlGuid;
   // Use the QPC timer, see
   // http://msdn.microsoft.com/en-us/library/aa364160(v=vs.85).aspx.
   p->Wnode.ClientContext = 1;
   p->LogFileMode = EVENT_TRACE_REAL_TIME_MODE;
   p->MaximumFileSize = 100;  // 100 M file size.
-  // Get image load and process events.
-  p->EnableFlags = EVENT_TRACE_FLAG_IMAGE_LOAD | EVENT_TRACE_FLAG_PROCESS;
-  p->FlushTimer = 1;  // flush every second.
-  p->BufferSize = 16;  // 16 K buffers.
-  hr = kernel_controller_.Start(KERNEL_LOGGER_NAME, &kernel_props);
+  // The kernel events of the profile, or of the capture values. The sinks
+  // the events go to follow the flags.
+  p->EnableFlags = GetKernelEnableFlags(&kernel_profile_);
+  bool capture_context_switches =
+      (p->EnableFlags & EVENT_TRACE_FLAG_CSWITCH) != 0;
+  bool capture_disk_io = (p->EnableFlags & EVENT_TRACE_FLAG_DISK_IO) != 0;
+  bool capture_page_faults =
+      (p->EnableFlags & EVENT_TRACE_FLAG_MEMORY_PAGE_FAULTS) != 0;
+  bool capture_cpu_samples = (p->EnableFlags & EVENT_TRACE_FLAG_PROFILE) != 0;
+  bool capture_registry = (p->EnableFlags & EVENT_TRACE_FLAG_REGISTRY) != 0;
+  SetSessionBuffers(p);
+  base::FilePath kernel_capture_file(
+      capture_file.InsertBeforeExtension(L".kernel"));
+  if (capture_to_file) {
+    hr = SetSessionLogFile(kernel_capture_file, circular, max_file_mb,
+                           &kernel_props);
+    if (FAILED(hr))
+      return false;
+  }
+
+  HRESULT hr = kernel_controller_.Start(KERNEL_LOGGER_NAME, &kernel_props);
   if (FAILED(hr))
     return false;
+  if (capture_to_file)
+    capture_files_.push_back(kernel_capture_file);
+  if (capture_cpu_samples)
+    EnableProfileStackWalks(kernel_controller_.session());
 
   // And open a consumer on it.
   kernel_consumer_.reset(new KernelLogConsumer());
   DCHECK(NULL != kernel_consumer_.get());
-  kernel_consumer_->set_module_event_sink(&symbol_lookup_service_);
-  kernel_consumer_->set_process_event_sink(&process_info_service_);
+  kernel_consumer_->set_module_event_sink(&session_events_);
+  kernel_consumer_->set_process_event_sink(&session_events_);
+  kernel_consumer_->set_thread_event_sink(&thread_info_service_);
+  kernel_consumer_->set_memory_event_sink(&process_memory_service_);
+  // The thread context service indexes the events on their way to the
+  // services that aggregate them.
+  if (capture_context_switches) {
+    thread_context_service_.set_scheduler_event_sink(&cpu_timeline_service_);
+    kernel_consumer_->set_scheduler_event_sink(&thread_context_service_);
+  }
+  if (capture_disk_io) {
+    disk_io_latency_service_.set_thread_info_service(&thread_info_service_);
+    thread_context_service_.set_disk_io_event_sink(&disk_io_latency_service_);
+    kernel_consumer_->set_disk_io_event_sink(&thread_context_service_);
+  }
+  if (capture_page_faults) {
+    thread_context_service_.set_page_fault_event_sink(
+        &process_memory_service_);
+    kernel_consumer_->set_page_fault_event_sink(&thread_context_service_);
+  }
+  if (capture_cpu_samples)
+    kernel_consumer_->set_profile_event_sink(&cpu_profile_service_);
+  if (capture_registry)
+    kernel_consumer_->set_registry_event_sink(&registry_access_service_);
   kernel_consumer_->set_is_64_bit_log(Is64BitSystem());
   hr = kernel_consumer_->OpenRealtimeSession(KERNEL_LOGGER_NAME);
   if (FAILED(hr))
@@ -388,58 +1523,203 @@ bool ViewerWindow::StartCapturing() {
       base::Bind(base::IgnoreResult(&KernelLogConsumer::Consume),
                  base::Unretained(kernel_consumer_.get())));
 
-  if (SUCCEEDED(hr))
+  if (SUCCEEDED(hr)) {
     EnableProviders(settings_);
 
+    back_pressure_on_ = UseBackPressure();
+    std::vector<UCHAR> levels;
+    for (size_t i = 0; i < settings_.settings().size(); ++i) {
+      const ProviderConfiguration::Settings& provider =
+          settings_.settings()[i];
+      levels.push_back(provider.muted ? 0 : provider.log_level);
+    }
+    back_pressure_.Reset(levels);
+
+    uint32 ceiling = GetSessionMaxBuffersCeiling();
+    for (size_t i = 0; i < app_sessions_.size(); ++i)
+      app_sessions_[i]->buffer_sizer.reset(new SessionBufferSizer(ceiling));
+    kernel_buffer_sizer_.reset(new SessionBufferSizer(ceiling));
+    kernel_cost_meter_.Reset();
+    session_stats_task_.Reset(base::Bind(&ViewerWindow::UpdateSessionStats,
+                                         base::Unretained(this)));
+    ui_loop_->PostDelayedTask(FROM_HERE, session_stats_task_.callback(),
+        base::TimeDelta::FromMilliseconds(kSessionStatsIntervalMs));
+
+    StartCheckpoint();
+  }
+
   return SUCCEEDED(hr);
 }
 
+bool ViewerWindow::StartAppSession(AppSession* session,
+                                   const base::FilePath& capture_file,
+                                   bool circular,
+                                   ULONG max_file_mb) {
+  DCHECK(session != NULL);
+
+  base::win::EtwTraceProperties props;
+  EVENT_TRACE_PROPERTIES* p = props.get();
+  // Use the QPC timer, see
+  // http://msdn.microsoft.com/en-us/library/aa364160(v=vs.85).aspx.
+  p->Wnode.ClientContext = 1;
+  p->LogFileMode = EVENT_TRACE_REAL_TIME_MODE;
+  p->MaximumFileSize = 100;  // 100 M file size.
+  SetSessionBuffers(p);
+
+  HRESULT hr = S_OK;
+  if (!capture_file.empty()) {
+    hr = SetSessionLogFile(capture_file, circular, max_file_mb, &props);
+    if (FAILED(hr))
+      return false;
+  }
+
+  hr = session->controller.Start(session->name.c_str(), &props);
+  if (FAILED(hr))
+    return false;
+  if (!capture_file.empty())
+    capture_files_.push_back(capture_file);
+
+  // And open a consumer on it, which tallies the events by source.
+  session->rate_stats.EndInterval(base::TimeTicks::Now());
+  session->consumer.reset(new LogConsumer());
+  session->consumer->set_event_rate_stats(&session->rate_stats);
+  session->decoder.reset(new TdhEventDecoder(NULL));
+  session->consumer->set_generic_decoder(session->decoder.get());
+  // The log messages go through the sampler when it has sampling to do.
+  ConfigureLogSampler(&session->sampler);
+  if (session->sampler.IsSampling())
+    session->consumer->set_event_sink(&session->sampler);
+  else
+    session->consumer->set_event_sink(this);
+  session->consumer->set_trace_sink(this);
+  session->consumer->set_string_table(&file_table_);
+  session->consumer->set_batch_log_messages(true);
+  hr = session->consumer->OpenRealtimeSession(session->name.c_str());
+  if (FAILED(hr))
+    return false;
+
+  // Consume it in a new thread. Unless told otherwise, that thread only
+  // copies the events for another to parse, so the ETW callbacks return
+  // promptly. The thread the rows come from queues them apart from those
+  // of the other sessions. The reorder buffer merges them back in time
+  // order.
+  CHECK(session->thread.Start());
+  base::Thread* producer_thread = &session->thread;
+  if (DeferParsing()) {
+    CHECK(session->ingest_thread.Start());
+    session->consumer->DeferParsing(session->ingest_thread.message_loop(),
+                                    kSlabSize, kInitialSlabs);
+    producer_thread = &session->ingest_thread;
+  }
+  producer_thread->message_loop()->PostTask(FROM_HERE,
+      base::Bind(&ViewerWindow::SetProducerRows, base::Unretained(this),
+                 &session->rows));
+  session->thread.message_loop()->PostTask(FROM_HERE,
+      base::Bind(base::IgnoreResult(&LogConsumer::Consume),
+                 base::Unretained(session->consumer.get())));
+
+  return true;
+}
+
+bool ViewerWindow::IsCapturing() const {
+  return !app_sessions_.empty() &&
+      app_sessions_[0]->controller.session() != NULL;
+}
+
+ViewerWindow::AppSession* ViewerWindow::GetProviderSession(size_t index) {
+  DCHECK(!app_sessions_.empty());
+  // The providers are dealt out to the sessions in turn.
+  return app_sessions_[index % app_sessions_.size()];
+}
+
 void ViewerWindow::EnableProviders(
     const ProviderConfiguration& settings) {
   for (size_t i = 0; i < settings.settings().size(); ++i) {
-    log_controller_.EnableProvider(
+    if (settings.settings()[i].muted)
+      continue;
+
+    GetProviderSession(i)->controller.EnableProvider(
         settings.settings()[i].provider_guid,
         settings.settings()[i].log_level,
         settings.settings()[i].enable_flags);
   }
 }
 
-void ViewerWindow::OnLogMessage(const LogEvents::LogMessage& log_message) {
-  ViewerWindow::LogMessage msg;
-  msg.level = log_message.level;
-  msg.process_id = log_message.process_id;
-  msg.thread_id = log_message.thread_id;
-  msg.time_stamp = log_message.time;
-
-  // Use regular expression matching to extract the
-  // file/line/message from the log string, which is of
-  // format "[<stuff>:<file>(<line>)] <message><ws>".
-  if (!kFileRe.FullMatch(
-      pcrecpp::StringPiece(log_message.message, log_message.message_len),
-                           &msg.file, &msg.line, &msg.message)) {
-    // As fallback, just slurp the entire string.
-    msg.message.assign(log_message.message, log_message.message_len);
+void ViewerWindow::UpdateProvider(const ProviderConfiguration& settings,
+                                  size_t index) {
+  DCHECK(IsCapturing());
+  const ProviderConfiguration::Settings& provider =
+      settings.settings()[index];
+  base::win::EtwTraceController& controller =
+      GetProviderSession(index)->controller;
+
+  // Enabling a provider that's enabled already changes its level and
+  // flags in place, the session keeps running.
+  HRESULT hr = S_OK;
+  if (provider.muted) {
+    hr = controller.DisableProvider(provider.provider_guid);
+  } else {
+    hr = controller.EnableProvider(provider.provider_guid,
+                                   provider.log_level,
+                                   provider.enable_flags);
   }
-
-  // If the message carried file information, use that
-  // in preference to the above.
-  if (log_message.file_len != 0) {
-    msg.file.assign(log_message.file, log_message.file_len);
-    msg.line = log_message.line;
+  if (FAILED(hr)) {
+    LOG(ERROR) << "Failed to update provider " << provider.provider_name
+        << ", error " << hr;
   }
 
-  if (log_message.trace_depth > 0) {
-    msg.trace.insert(msg.trace.begin(),
-                     &log_message.traces[0],
-                     &log_message.traces[log_message.trace_depth - 1]);
+  // The configured level wins over any lowering.
+  if (index < back_pressure_.num_providers()) {
+    back_pressure_.SetConfiguredLevel(index,
+                                      provider.muted ? 0 : provider.log_level);
   }
+}
+
+void ViewerWindow::OnLogMessage(const LogEvents::LogMessage& log_message) {
+  AddLogMessage(log_message);
+  ScheduleNewItemsNotification();
+}
 
-  base::AutoLock lock(list_lock_);
-  log_messages_.push_back(msg);
+void ViewerWindow::OnLogMessages(const LogEvents::LogMessage* log_messages,
+                                 size_t num_messages) {
+  for (size_t i = 0; i < num_messages; ++i)
+    AddLogMessage(log_messages[i]);
+
+  if (num_messages != 0)
+    ScheduleNewItemsNotification();
+}
 
+void ViewerWindow::OnEventLoss(const LogEvents::EventLoss& event_loss) {
+  // The marker takes the path of the rows, so it stays in order with them.
+  AddRow(TRACE_LEVEL_WARNING,
+         0,
+         0,
+         event_loss.time,
+         log_store_.loss_marker_file(),
+         0,
+         FormatEventLoss(event_loss),
+         0,
+         NULL);
   ScheduleNewItemsNotification();
 }
 
+void ViewerWindow::AddLogMessage(const LogEvents::LogMessage& log_message) {
+  StringTable::Atom file_atom = StringTable::kEmptyAtom;
+  int line = 0;
+  base::StringPiece message;
+  ParseLogMessage(log_message, &file_table_, &file_atom, &line, &message);
+
+  AddRow(log_message.level,
+         log_message.process_id,
+         log_message.thread_id,
+         log_message.time,
+         file_atom,
+         line,
+         message,
+         log_message.trace_depth,
+         log_message.traces);
+}
+
 void ViewerWindow::OnStatusUpdate(const wchar_t* status) {
   base::AutoLock lock(status_lock_);
   if (status_.find_first_of(L"\r\n") == std::wstring::npos) {
@@ -479,65 +1759,451 @@ void ViewerWindow::UpdateStatus() {
   UISetText(0, status.c_str());
 }
 
+void ViewerWindow::OnUIStall(const std::wstring& description) {
+  DCHECK_EQ(base::MessageLoop::current(), ui_loop_);
+  UISetText(0, description.c_str());
+}
+
+void ViewerWindow::UpdateSessionStats() {
+  DCHECK_EQ(base::MessageLoop::current(), ui_loop_);
+  if (kernel_buffer_sizer_.get() == NULL)
+    return;
+
+  std::wstring stats;
+  base::TimeTicks now = base::TimeTicks::Now();
+  for (size_t i = 0; i < app_sessions_.size(); ++i) {
+    AppSession* session = app_sessions_[i];
+    std::wstring label(L"App");
+    if (app_sessions_.size() > 1)
+      label += base::StringPrintf(L" %d", static_cast<int>(i + 1));
+    uint32 buffers_lost =
+        session->buffer_sizer->last_stats().real_time_buffers_lost;
+    stats += SampleSession(session->name.c_str(), label.c_str(),
+                           session->buffer_sizer.get());
+    stats += L"; ";
+    session->rate_stats.EndInterval(now);
+
+    // A session that loses buffers while its parsing is deferred may have
+    // waited on the ingest thread, so it gets more slabs to run ahead with.
+    if (session->buffer_sizer->last_stats().real_time_buffers_lost !=
+            buffers_lost &&
+        session->ingest_thread.IsRunning()) {
+      size_t max_slabs = session->consumer->max_slabs();
+      session->consumer->set_max_slabs(std::min(max_slabs * 2, kMaxSlabs));
+    }
+  }
+  stats += SampleSession(KERNEL_LOGGER_NAME, L"Kernel",
+                         kernel_buffer_sizer_.get());
+  stats += L"; ";
+
+  // Logging less only helps the app sessions, the kernel's flags are fixed
+  // for the capture.
+  if (back_pressure_on_) {
+    bool behind = false;
+    for (size_t i = 0; i < app_sessions_.size(); ++i) {
+      if (app_sessions_[i]->buffer_sizer->falling_behind_at_ceiling())
+        behind = true;
+    }
+    ApplyBackPressure(behind);
+    if (back_pressure_.is_lowered())
+      stats += L"Provider levels lowered to keep up; ";
+  }
+
+  // What the kernel profile costs, to weigh its detail against.
+  SessionCostMeter::Totals kernel_totals;
+  kernel_consumer_->GetTotals(&kernel_totals);
+  kernel_cost_meter_.Sample(now, kernel_totals);
+  if (kernel_cost_meter_.has_cost()) {
+    const SessionCostMeter::Cost& cost = kernel_cost_meter_.cost();
+    stats += base::StringPrintf(
+        L"%ls: %.0f events/s, %.1f KB/s, %.1f%% CPU; ",
+        kernel_profile_.empty() ? L"Custom kernel" : kernel_profile_.c_str(),
+        cost.events_per_second, cost.bytes_per_second / 1024,
+        cost.consumer_cpu * 100);
+  }
+
+  // The matcher's histograms are per name, so checking them costs the
+  // same however long the capture's been going.
+  if (span_regressions_.has_baseline()) {
+    std::vector<TraceSpanMatcher::DurationStats> spans;
+    trace_span_matcher_.GetDurationStats(&spans);
+    if (span_regressions_.Check(spans, base::Time::Now()) != 0)
+      UISetText(0, L"Span durations regressed, see Span Regressions");
+    if (span_regressions_.regression_count() != 0) {
+      stats += base::StringPrintf(L"%d span regressions; ",
+          static_cast<int>(span_regressions_.regression_count()));
+    }
+  }
+  if (capture_paused_) {
+    stats += base::StringPrintf(L"%d rows paused; ",
+        static_cast<int>(capture_spill_.num_rows()));
+  }
+  stats += MemoryBudget::Get()->FormatSummary();
+  UISetText(kSessionStatsPane, stats.c_str());
+
+  ui_loop_->PostDelayedTask(FROM_HERE, session_stats_task_.callback(),
+      base::TimeDelta::FromMilliseconds(kSessionStatsIntervalMs));
+}
+
+void ViewerWindow::ApplyBackPressure(bool behind) {
+  DCHECK_EQ(base::MessageLoop::current(), ui_loop_);
+  DCHECK_EQ(settings_.settings().size(), back_pressure_.num_providers());
+
+  std::vector<UCHAR> old_levels;
+  for (size_t i = 0; i < back_pressure_.num_providers(); ++i)
+    old_levels.push_back(back_pressure_.level(i));
+  std::vector<double> rates;
+  GetProviderRates(&rates);
+  std::vector<size_t> changed;
+  back_pressure_.Sample(behind, rates, &changed);
+
+  for (size_t i = 0; i < changed.size(); ++i) {
+    size_t index = changed[i];
+    const ProviderConfiguration::Settings& provider =
+        settings_.settings()[index];
+    UCHAR level = back_pressure_.level(index);
+    HRESULT hr = GetProviderSession(index)->controller.EnableProvider(
+        provider.provider_guid, level, provider.enable_flags);
+    if (FAILED(hr)) {
+      LOG(ERROR) << "Failed to change the level of provider "
+          << provider.provider_name << ", error " << hr;
+    }
+
+    // The marker stands in for the events the lowering drops, so the
+    // filters keep it as they keep the markers of lost events.
+    AddRow(TRACE_LEVEL_WARNING,
+           0,
+           0,
+           base::Time::Now(),
+           log_store_.loss_marker_file(),
+           0,
+           FormatLevelChange(base::WideToUTF8(provider.provider_name),
+                             old_levels[index], level),
+           0,
+           NULL);
+  }
+  if (!changed.empty())
+    ScheduleNewItemsNotification();
+}
+
+void ViewerWindow::GetProviderRates(std::vector<double>* rates) {
+  DCHECK(rates != NULL);
+  const std::vector<ProviderConfiguration::Settings>& providers =
+      settings_.settings();
+  rates->assign(providers.size(), 0);
+
+  for (size_t s = 0; s < app_sessions_.size(); ++s) {
+    std::vector<EventRateStats::Rates> source_rates;
+    app_sessions_[s]->rate_stats.GetRates(&source_rates);
+
+    // The events of the providers decoded by manifest are classed by their
+    // provider. The others share the event classes of Chrome's, so the
+    // rest of the session's events are split evenly among them.
+    double unattributed = 0;
+    for (size_t j = 0; j < source_rates.size(); ++j) {
+      size_t i = s;
+      for (; i < providers.size(); i += app_sessions_.size()) {
+        if (providers[i].provider_guid == source_rates[j].key.event_class)
+          break;
+      }
+      if (i < providers.size())
+        (*rates)[i] += source_rates[j].events_per_second;
+      else
+        unattributed += source_rates[j].events_per_second;
+    }
+
+    std::vector<size_t> sharing;
+    for (size_t i = s; i < providers.size(); i += app_sessions_.size()) {
+      if (!providers[i].muted && (*rates)[i] == 0)
+        sharing.push_back(i);
+    }
+    for (size_t i = 0; i < sharing.size(); ++i)
+      (*rates)[sharing[i]] = unattributed / sharing.size();
+  }
+}
+
+void ViewerWindow::CheckMemory() {
+  DCHECK_EQ(base::MessageLoop::current(), ui_loop_);
+
+  // The caches register and evict on this thread, so the budget is safe
+  // to enforce here.
+  MemoryBudget::Get()->CheckPressure();
+  UpdateIdleStats();
+
+  ui_loop_->PostDelayedTask(FROM_HERE, memory_check_task_.callback(),
+      base::TimeDelta::FromMilliseconds(kMemoryCheckIntervalMs));
+}
+
+void ViewerWindow::UpdateIdleStats() {
+  // While capturing, the budget shares the pane with the sessions.
+  if (kernel_buffer_sizer_.get() != NULL)
+    return;
+
+  std::wstring stats(loss_summary_);
+  if (!stats.empty())
+    stats += L"; ";
+  stats += MemoryBudget::Get()->FormatSummary();
+  UISetText(kSessionStatsPane, stats.c_str());
+}
+
 void ViewerWindow::OnTraceEventBegin(
     const TraceEvents::TraceMessage& trace_message) {
+  trace_span_matcher_.OnTraceEventBegin(trace_message);
+  trace_flow_matcher_.OnTraceEventBegin(trace_message);
   AddTraceEventToLog("BEGIN", trace_message);
 }
 
 void ViewerWindow::OnTraceEventEnd(
     const TraceEvents::TraceMessage& trace_message) {
+  trace_span_matcher_.OnTraceEventEnd(trace_message);
+  trace_flow_matcher_.OnTraceEventEnd(trace_message);
   AddTraceEventToLog("END", trace_message);
 }
 
 void ViewerWindow::OnTraceEventInstant(
     const TraceEvents::TraceMessage& trace_message) {
+  trace_flow_matcher_.OnTraceEventInstant(trace_message);
   AddTraceEventToLog("INSTANT", trace_message);
 }
 
 void ViewerWindow::AddTraceEventToLog(const char* type,
     const TraceEvents::TraceMessage& trace_message) {
-  ViewerWindow::LogMessage msg;
-  msg.level = trace_message.level;
-  msg.process_id = trace_message.process_id;
-  msg.thread_id = trace_message.thread_id;
-  msg.time_stamp = trace_message.time;
-
-  // The message will be of form "{BEGIN|END|INSTANT}(<name>, 0x<id>): <extra>"
-  msg.message = base::StringPrintf("%s(%*s, 0x%08X): %*s",
-                                   type,
-                                   trace_message.name_len,
-                                   trace_message.name,
-                                   trace_message.id,
-                                   trace_message.extra_len,
-                                   trace_message.extra);
-
-  for (size_t i = 0; i < trace_message.trace_depth; ++i)
-    msg.trace.push_back(trace_message.traces[i]);
-
-  base::AutoLock lock(list_lock_);
-  log_messages_.push_back(msg);
-
+  AddRow(trace_message.level,
+         trace_message.process_id,
+         trace_message.thread_id,
+         trace_message.time,
+         StringTable::kEmptyAtom,
+         0,
+         FormatTraceMessage(type, trace_message),
+         trace_message.trace_depth,
+         trace_message.traces);
   ScheduleNewItemsNotification();
 }
 
-void ViewerWindow::ScheduleNewItemsNotification() {
-  // The list lock must be held.
-  list_lock_.AssertAcquired();
+void ViewerWindow::AddRow(UCHAR level,
+                          DWORD process_id,
+                          DWORD thread_id,
+                          const base::Time& time,
+                          StringTable::Atom file,
+                          int line,
+                          const base::StringPiece& message,
+                          size_t trace_depth,
+                          void* const* traces) {
+  if (base::MessageLoop::current() == ui_loop_) {
+    // Imports run on the UI thread, which owns the store. Anything
+    // queued goes first to keep the rows in order.
+    FlushPendingRows();
+    SetPendingRow(level, process_id, thread_id, time, file, line,
+                  message, trace_depth, traces, &import_row_);
+    AddPendingRowToStore(import_row_);
+    return;
+  }
+
+  // Each app session's consumer thread has a queue of its own.
+  PendingRowQueue* rows = producer_rows_.Get();
+  if (rows == NULL)
+    rows = &default_rows_;
+
+  PendingRow* row = NULL;
+  if (!base::subtle::Acquire_Load(&rows->overflowing))
+    row = rows->ring.BeginPush();
+
+  if (row != NULL) {
+    SetPendingRow(level, process_id, thread_id, time, file, line,
+                  message, trace_depth, traces, row);
+    rows->ring.EndPush();
+  } else {
+    base::AutoLock lock(rows->overflow_lock);
+    rows->overflow_rows.push_back(PendingRow());
+    SetPendingRow(level, process_id, thread_id, time, file, line,
+                  message, trace_depth, traces, &rows->overflow_rows.back());
+    base::subtle::Release_Store(&rows->overflowing, 1);
+  }
+}
+
+// static
+void ViewerWindow::SetPendingRow(UCHAR level,
+                                 DWORD process_id,
+                                 DWORD thread_id,
+                                 const base::Time& time,
+                                 StringTable::Atom file,
+                                 int line,
+                                 const base::StringPiece& message,
+                                 size_t trace_depth,
+                                 void* const* traces,
+                                 PendingRow* row) {
+  DCHECK(row != NULL);
+
+  row->level = level;
+  row->process_id = process_id;
+  row->thread_id = thread_id;
+  row->time = time;
+  row->file = file;
+  row->line = line;
+  row->message.assign(message.data(), message.size());
+  // The frames are widened to 64 bits whatever our own bitness.
+  row->trace.resize(trace_depth);
+  for (size_t i = 0; i < trace_depth; ++i)
+    row->trace[i] = reinterpret_cast<uintptr_t>(traces[i]);
+}
+
+void ViewerWindow::DrainPendingRows() {
+  DCHECK_EQ(ui_loop_, base::MessageLoop::current());
+  TakePendingRows();
+
+  // Without a kernel session there's nothing to wait for.
+  if (kernel_consumer_.get() == NULL) {
+    FlushPendingRows();
+    return;
+  }
+
+  base::Time release_before(std::max(base::Time::Now() - reorder_latency_,
+                                     kernel_consumer_->watermark()));
+  PendingRow row;
+  while (reorder_buffer_.PopBefore(release_before, &row))
+    AddPendingRowToStore(row);
+}
+
+void ViewerWindow::FlushPendingRows() {
+  DCHECK_EQ(ui_loop_, base::MessageLoop::current());
+  TakePendingRows();
+
+  PendingRow row;
+  while (reorder_buffer_.PopFront(&row))
+    AddPendingRowToStore(row);
+}
+
+void ViewerWindow::TakePendingRows() {
+  TakeQueuedRows(&default_rows_);
+  for (size_t i = 0; i < app_sessions_.size(); ++i)
+    TakeQueuedRows(&app_sessions_[i]->rows);
+}
 
-  if (!notify_log_view_new_items_pending_) {
-    notify_log_view_new_items_pending_ = true;
+void ViewerWindow::TakeQueuedRows(PendingRowQueue* rows) {
+  DCHECK(rows != NULL);
+  DrainRing(rows);
+  if (!base::subtle::Acquire_Load(&rows->overflowing))
+    return;
+
+  // The producer stays off the ring while overflowing, so whatever
+  // the ring holds now precedes the overflow rows.
+  DrainRing(rows);
+
+  std::vector<PendingRow> overflow_rows;
+  {
+    base::AutoLock lock(rows->overflow_lock);
+    overflow_rows.swap(rows->overflow_rows);
+    base::subtle::Release_Store(&rows->overflowing, 0);
+  }
+
+  for (size_t i = 0; i < overflow_rows.size(); ++i)
+    ReorderRow(&overflow_rows[i]);
+}
+
+void ViewerWindow::DrainRing(PendingRowQueue* rows) {
+  while (PendingRow* row = rows->ring.Front()) {
+    ReorderRow(row);
+    rows->ring.Pop();
+  }
+}
+
+void ViewerWindow::SetProducerRows(PendingRowQueue* rows) {
+  producer_rows_.Set(rows);
+}
+
+void ViewerWindow::ReorderRow(PendingRow* row) {
+  DCHECK(row != NULL);
+  if (reorder_latency_ == base::TimeDelta())
+    AddPendingRowToStore(*row);
+  else
+    reorder_buffer_.Push(row->time, row);
+}
+
+void ViewerWindow::AddPendingRowToStore(const PendingRow& row) {
+  if (capture_paused_) {
+    capture_spill_.AddRow(row.level, row.process_id, row.thread_id, row.time,
+                          row.file, row.line, row.message,
+                          row.trace.size(),
+                          row.trace.empty() ? NULL : &row.trace[0]);
+    return;
+  }
+
+  log_store_.AddRow(row.level, row.process_id, row.thread_id, row.time,
+                    row.file, row.line, row.message,
+                    row.trace.size(),
+                    row.trace.empty() ? NULL : &row.trace[0]);
+  process_tree_.AddRow(row.process_id, row.time, row.level, row.message);
+  NotifyLogViewEvicted();
+}
+
+void ViewerWindow::ScheduleNewItemsNotification() {
+  if (base::subtle::NoBarrier_CompareAndSwap(
+          &notify_log_view_new_items_pending_, 0, 1) == 0) {
+    new_items_scheduled_ = base::TimeTicks::HighResNow();
     ui_loop_->PostTask(FROM_HERE, notify_log_view_new_items_.callback());
   }
 }
 
 void ViewerWindow::NotifyLogViewNewItems() {
   DCHECK_EQ(ui_loop_, base::MessageLoop::current());
-  {
-    base::AutoLock lock(list_lock_);
 
-    // Notification no longer pending.
-    notify_log_view_new_items_pending_ = false;
+  // Hold off until the next update is due. The notification stays pending
+  // in the meantime, so the rows that come in don't schedule more, and
+  // they all go out in one update.
+  base::TimeTicks start = base::TimeTicks::Now();
+  base::TimeDelta delay = new_items_pacer_.GetDelay(start);
+  if (delay > base::TimeDelta()) {
+    ui_loop_->PostDelayedTask(FROM_HERE,
+                              notify_log_view_new_items_.callback(),
+                              delay);
+    return;
+  }
+
+  // Whoever scheduled the notification wrote its time before posting it,
+  // and nobody writes it again until it's no longer pending.
+  new_items_latency_counter.AddTimed(base::TimeTicks::HighResNow() -
+                                         new_items_scheduled_);
+
+  // Notification no longer pending, rows queued after this point
+  // will schedule another.
+  base::subtle::Release_Store(&notify_log_view_new_items_pending_, 0);
+  DrainPendingRows();
+  session_checkpoint_.Update(log_store_);
+
+  // Look again at the rows held for reordering, unless more rows have
+  // scheduled a notification already.
+  if (!reorder_buffer_.empty() &&
+      base::subtle::NoBarrier_CompareAndSwap(
+          &notify_log_view_new_items_pending_, 0, 1) == 0) {
+    new_items_scheduled_ = base::TimeTicks::HighResNow();
+    ui_loop_->PostDelayedTask(FROM_HERE,
+        notify_log_view_new_items_.callback(),
+        base::TimeDelta::FromMilliseconds(kReorderRecheckMs));
+  }
+
+  // There's no one to see the new rows while we're minimized, so the
+  // views hear of them once we're restored.
+  if (IsWindow() && IsIconic())
+    new_items_deferred_ = true;
+  else
+    DispatchLogViewNewItems();
+
+  base::TimeTicks end = base::TimeTicks::Now();
+  new_items_pacer_.OnUpdate(start, end);
+
+  int num_updates = 0;
+  base::TimeDelta cost;
+  if (new_items_pacer_.EndPeriod(end, &num_updates, &cost)) {
+    UISetText(kUpdateCostPane,
+              base::StringPrintf(L"%d updates/s, %.1f ms/s",
+                                 num_updates,
+                                 cost.InMillisecondsF()).c_str());
   }
+}
+
+void ViewerWindow::DispatchLogViewNewItems() {
+  DCHECK_EQ(ui_loop_, base::MessageLoop::current());
+  new_items_deferred_ = false;
 
   EventSinkMap::iterator it(event_sinks_.begin());
   for (; it != event_sinks_.end(); ++it) {
@@ -553,10 +2219,27 @@ void ViewerWindow::NotifyLogViewCleared() {
   }
 }
 
+void ViewerWindow::NotifyLogViewEvicted() {
+  DCHECK_EQ(ui_loop_, base::MessageLoop::current());
+  int first_row = log_store_.first_row();
+  if (first_row == notified_first_row_)
+    return;
+
+  // This goes out as soon as the rows are evicted, ahead of the new rows
+  // that evicted them, as the listeners may access rows in the meantime.
+  notified_first_row_ = first_row;
+  EventSinkMap::iterator it(event_sinks_.begin());
+  for (; it != event_sinks_.end(); ++it) {
+    it->second->LogViewEvicted(first_row);
+  }
+}
+
 LRESULT ViewerWindow::OnConfigureProviders(WORD code,
                                            LPARAM lparam,
                                            HWND wnd,
                                            BOOL& handled) {
+  WaitForProviderSettings();
+
   // Make a copy of our settings.
   ProviderConfiguration settings_copy;
 
@@ -564,8 +2247,15 @@ LRESULT ViewerWindow::OnConfigureProviders(WORD code,
 
   ProviderDialog dialog(&settings_copy);
   if (dialog.DoModal(m_hWnd) == IDOK) {
+    // While capturing, only the providers that changed are touched, the
+    // others go on logging undisturbed.
+    std::vector<size_t> changed;
+    settings_.GetChangedProviders(settings_copy, &changed);
     settings_.Copy(settings_copy);
-    EnableProviders(settings_);
+    if (IsCapturing()) {
+      for (size_t i = 0; i < changed.size(); ++i)
+        UpdateProvider(settings_, changed[i]);
+    }
     settings_.WriteSettings();
   }
 
@@ -576,7 +2266,7 @@ LRESULT ViewerWindow::OnToggleCapture(WORD code,
                                       LPARAM lparam,
                                       HWND wnd,
                                       BOOL& handled) {
-  bool capturing = log_controller_.session() != NULL;
+  bool capturing = IsCapturing();
   DCHECK_EQ(capturing,
             ((UIGetState(ID_LOG_CAPTURE) & UPDUI_CHECKED) == UPDUI_CHECKED));
   SetCapture(!capturing);
@@ -584,6 +2274,186 @@ LRESULT ViewerWindow::OnToggleCapture(WORD code,
   return 0;
 }
 
+LRESULT ViewerWindow::OnTogglePauseCapture(WORD code,
+                                           LPARAM lparam,
+                                           HWND wnd,
+                                           BOOL& handled) {
+  if (IsCapturing())
+    SetCapturePaused(!capture_paused_);
+
+  return 0;
+}
+
+LRESULT ViewerWindow::OnToggleRemoteCapture(WORD code,
+                                            LPARAM lparam,
+                                            HWND wnd,
+                                            BOOL& handled) {
+  // A second go stops the capture, OnRemoteCaptureDone winds it up.
+  if (remote_capture_.get() != NULL) {
+    remote_capture_->Stop();
+    return 0;
+  }
+
+  if (IsCapturing() || importer_.get() != NULL || log_follower_.get() != NULL)
+    return 0;
+
+  RemoteAgentDialog dialog(remote_agent_);
+  if (dialog.DoModal(m_hWnd) != IDOK)
+    return 0;
+
+  std::string host;
+  int port = 0;
+  if (!RemoteCapture::ParseAddress(dialog.address(), &host, &port)) {
+    ::MessageBox(m_hWnd, L"The agent's address should read as host[:port].",
+                 L"Capture From Remote Agent", MB_OK);
+    return 0;
+  }
+  remote_agent_ = dialog.address();
+
+  // The agent's modules are looked up on our symbol path.
+  WaitForSymbolPath();
+
+  // The captured rows don't mix with those of a lazy import.
+  if (lazy_log_.get() != NULL)
+    ClearAll();
+
+  // The log messages go through the sampler when it has sampling to do,
+  // as they do for a local capture.
+  ConfigureLogSampler(&log_sampler_);
+  LogEvents* event_sink = this;
+  if (log_sampler_.IsSampling())
+    event_sink = &log_sampler_;
+  remote_capture_.reset(new RemoteCapture(&file_table_,
+                                          event_sink,
+                                          this,
+                                          &session_events_,
+                                          &session_events_,
+                                          this));
+  remote_capture_->Start(host, port);
+
+  UISetText(0, base::StringPrintf(L"Capturing from %ls",
+      base::UTF8ToWide(remote_agent_).c_str()).c_str());
+  UIUpdateStatusBar();
+  UIEnable(ID_FILE_IMPORT, false);
+  UIEnable(ID_FILE_IMPORT_SCOPED, false);
+  UIEnable(ID_FILE_IMPORT_LAZILY, false);
+  UIEnable(ID_FILE_FOLLOW_LOG, false);
+  UIEnable(ID_FILE_RELOAD_CAPTURE, false);
+  UIEnable(ID_FILE_OPEN_SESSION, false);
+  UIEnable(ID_LOG_CAPTURE, false);
+  UISetCheck(ID_LOG_CAPTURE_REMOTE, true);
+
+  return 0;
+}
+
+void ViewerWindow::OnRemoteCaptureDone(HRESULT hr) {
+  DCHECK(remote_capture_.get() != NULL);
+
+  // We're called from the capture, so it has to go away later.
+  ui_loop_->DeleteSoon(FROM_HERE, remote_capture_.release());
+
+  UISetText(0, L"Ready");
+  UIUpdateStatusBar();
+  UIEnable(ID_FILE_IMPORT, true);
+  UIEnable(ID_FILE_IMPORT_SCOPED, true);
+  UIEnable(ID_FILE_IMPORT_LAZILY, kLargeAddressSpace);
+  UIEnable(ID_FILE_FOLLOW_LOG, true);
+  UIEnable(ID_FILE_RELOAD_CAPTURE, !capture_files_.empty());
+  UIEnable(ID_FILE_OPEN_SESSION, true);
+  UIEnable(ID_LOG_CAPTURE, true);
+  UISetCheck(ID_LOG_CAPTURE_REMOTE, false);
+
+  if (FAILED(hr)) {
+    std::wstring msg = base::StringPrintf(
+        L"Capture from %ls failed with error 0x%08X",
+        base::UTF8ToWide(remote_agent_).c_str(), hr);
+    ::MessageBox(m_hWnd, msg.c_str(), L"Capture From Remote Agent", MB_OK);
+  }
+}
+
+LRESULT ViewerWindow::OnToggleFollowLog(WORD code,
+                                        LPARAM lparam,
+                                        HWND wnd,
+                                        BOOL& handled) {
+  // A second go stops following, OnLogFollowDone winds it up.
+  if (log_follower_.get() != NULL) {
+    log_follower_->Stop();
+    return 0;
+  }
+
+  if (IsCapturing() || importer_.get() != NULL ||
+      remote_capture_.get() != NULL) {
+    return 0;
+  }
+
+  CFileDialog dialog(TRUE, L"etl", NULL,
+                     OFN_FILEMUSTEXIST | OFN_HIDEREADONLY | OFN_PATHMUSTEXIST,
+                     kLogFileFilter, m_hWnd);
+  if (dialog.DoModal() != IDOK)
+    return 0;
+  followed_log_ = base::FilePath(dialog.m_szFileName);
+
+  // The logging processes' modules are looked up on our symbol path.
+  WaitForSymbolPath();
+
+  // The followed rows don't mix with those of a lazy import.
+  if (lazy_log_.get() != NULL)
+    ClearAll();
+
+  // The log messages go through the sampler when it has sampling to do,
+  // as they do for a capture.
+  ConfigureLogSampler(&log_sampler_);
+  LogEvents* event_sink = this;
+  if (log_sampler_.IsSampling())
+    event_sink = &log_sampler_;
+  log_follower_.reset(new LogFollower(&file_table_,
+                                      event_sink,
+                                      this,
+                                      &session_events_,
+                                      &session_events_,
+                                      this));
+  log_follower_->Start(followed_log_);
+
+  UISetText(0, base::StringPrintf(L"Following %ls",
+      followed_log_.BaseName().value().c_str()).c_str());
+  UIUpdateStatusBar();
+  UIEnable(ID_FILE_IMPORT, false);
+  UIEnable(ID_FILE_IMPORT_SCOPED, false);
+  UIEnable(ID_FILE_IMPORT_LAZILY, false);
+  UIEnable(ID_FILE_RELOAD_CAPTURE, false);
+  UIEnable(ID_FILE_OPEN_SESSION, false);
+  UIEnable(ID_LOG_CAPTURE, false);
+  UIEnable(ID_LOG_CAPTURE_REMOTE, false);
+  UISetCheck(ID_FILE_FOLLOW_LOG, true);
+
+  return 0;
+}
+
+void ViewerWindow::OnLogFollowDone(HRESULT hr) {
+  DCHECK(log_follower_.get() != NULL);
+
+  // We're called from the follower, so it has to go away later.
+  ui_loop_->DeleteSoon(FROM_HERE, log_follower_.release());
+
+  UISetText(0, L"Ready");
+  UIUpdateStatusBar();
+  UIEnable(ID_FILE_IMPORT, true);
+  UIEnable(ID_FILE_IMPORT_SCOPED, true);
+  UIEnable(ID_FILE_IMPORT_LAZILY, kLargeAddressSpace);
+  UIEnable(ID_FILE_RELOAD_CAPTURE, !capture_files_.empty());
+  UIEnable(ID_FILE_OPEN_SESSION, true);
+  UIEnable(ID_LOG_CAPTURE, true);
+  UIEnable(ID_LOG_CAPTURE_REMOTE, true);
+  UISetCheck(ID_FILE_FOLLOW_LOG, false);
+
+  if (FAILED(hr)) {
+    std::wstring msg = base::StringPrintf(
+        L"Following %ls failed with error 0x%08X",
+        followed_log_.value().c_str(), hr);
+    ::MessageBox(m_hWnd, msg.c_str(), L"Follow Log File", MB_OK);
+  }
+}
+
 namespace {
 
 class SymbolPathDialog: public CDialogImpl<SymbolPathDialog> {
@@ -631,6 +2501,7 @@ LRESULT ViewerWindow::OnSymbolPath(WORD code,
                                    LPARAM lparam,
                                    HWND wnd,
                                    BOOL& handled) {
+  WaitForSymbolPath();
   SymbolPathDialog dialog(&symbol_path_);
 
   if (IDOK == dialog.DoModal(m_hWnd)) {
@@ -643,6 +2514,248 @@ LRESULT ViewerWindow::OnSymbolPath(WORD code,
   return 0;
 }
 
+LRESULT ViewerWindow::OnTraceDurations(WORD code,
+                                       LPARAM lparam,
+                                       HWND wnd,
+                                       BOOL& handled) {
+  std::vector<TraceSpanMatcher::DurationStats> stats;
+  trace_span_matcher_.GetDurationStats(&stats);
+
+  std::wstringstream text;
+  if (stats.empty())
+    text << L"No trace event spans captured yet." << std::endl;
+  for (size_t i = 0; i < stats.size() && i < kMaxTraceDurationNames; ++i) {
+    const TraceSpanMatcher::DurationStats& name_stats = stats[i];
+    text << base::UTF8ToWide(name_stats.name) << L": "
+        << name_stats.count << L" spans, "
+        << name_stats.total.InMillisecondsF() << L" ms in all, median "
+        << name_stats.p50.InMillisecondsF() << L" ms, 95th "
+        << name_stats.p95.InMillisecondsF() << L" ms, 99th "
+        << name_stats.p99.InMillisecondsF() << L" ms, max "
+        << name_stats.max.InMillisecondsF() << L" ms" << std::endl;
+  }
+  text << std::endl << trace_span_matcher_.open_span_count()
+      << L" spans open, " << trace_span_matcher_.unmatched_end_count()
+      << L" ends unmatched." << std::endl;
+
+  std::vector<TraceFlowMatcher::FlowStats> flows;
+  trace_flow_matcher_.GetFlowStats(&flows);
+  if (!flows.empty())
+    text << std::endl << L"Cross process flows:" << std::endl;
+  for (size_t i = 0; i < flows.size() && i < kMaxTraceDurationNames; ++i) {
+    const TraceFlowMatcher::FlowStats& flow = flows[i];
+    text << base::UTF8ToWide(flow.name) << L": "
+        << flow.end_to_end.count << L" flows, median "
+        << flow.end_to_end.p50.InMillisecondsF() << L" ms, 95th "
+        << flow.end_to_end.p95.InMillisecondsF() << L" ms, max "
+        << flow.end_to_end.max.InMillisecondsF() << L" ms; hop 95ths";
+    for (size_t j = 0; j < flow.hops.size(); ++j)
+      text << L" " << flow.hops[j].p95.InMillisecondsF();
+    text << L" ms" << std::endl;
+  }
+  text << std::endl << trace_flow_matcher_.open_flow_count()
+      << L" flows open, " << trace_flow_matcher_.local_flow_count()
+      << L" local, " << trace_flow_matcher_.expired_flow_count()
+      << L" expired, " << trace_flow_matcher_.unmatched_end_count()
+      << L" ends unmatched, " << trace_flow_matcher_.dropped_begin_count()
+      << L" begins dropped.";
+
+  ::MessageBox(m_hWnd, text.str().c_str(), L"Trace Durations", MB_OK);
+  return 0;
+}
+
+LRESULT ViewerWindow::OnLoadSpanBaseline(WORD code,
+                                         LPARAM lparam,
+                                         HWND wnd,
+                                         BOOL& handled) {
+  CShellFileOpenDialog dialog(NULL,
+                              FOS_FORCEFILESYSTEM | FOS_FILEMUSTEXIST,
+                              L"sbsession",
+                              &kSessionFileSpec[0],
+                              arraysize(kSessionFileSpec));
+  base::FilePath path;
+  if (!GetSessionPath(&dialog, &path))
+    return 0;
+
+  // Only the baseline's span durations are kept, its rows and kernel events
+  // go with the store.
+  StringTable baseline_files;
+  LogStore baseline(&baseline_files);
+  LogIndex loader(NULL, NULL);
+  std::string filters;
+  if (!loader.LoadSession(path, &baseline, &filters)) {
+    LOG(ERROR) << "Failed to open span baseline: " << path.value();
+    MessageBox(L"Failed to open the session.", L"Error Loading Baseline",
+               MB_OK | MB_ICONWARNING);
+    return 0;
+  }
+
+  std::vector<TraceSpanMatcher::DurationStats> spans;
+  LogDiff::GetSpanDurations(baseline, &spans);
+  span_regressions_.set_factor(GetSpanRegressionFactor());
+  span_regressions_.SetBaseline(spans);
+  if (!span_regressions_.has_baseline()) {
+    MessageBox(L"The session has too few trace event spans to compare to.",
+               L"Error Loading Baseline", MB_OK | MB_ICONWARNING);
+    return 0;
+  }
+
+  UISetText(0, base::StringPrintf(L"Loaded the durations of %d span names",
+      static_cast<int>(span_regressions_.baseline_size())).c_str());
+  UIUpdateStatusBar();
+  return 0;
+}
+
+LRESULT ViewerWindow::OnSpanRegressions(WORD code,
+                                        LPARAM lparam,
+                                        HWND wnd,
+                                        BOOL& handled) {
+  std::wstringstream text;
+  if (!span_regressions_.has_baseline()) {
+    text << L"No span baseline loaded, see Load Span Baseline.";
+    ::MessageBox(m_hWnd, text.str().c_str(), L"Span Regressions", MB_OK);
+    return 0;
+  }
+
+  // Check the latest durations, rather than wait on the next sample.
+  std::vector<TraceSpanMatcher::DurationStats> spans;
+  trace_span_matcher_.GetDurationStats(&spans);
+  span_regressions_.Check(spans, base::Time::Now());
+
+  std::vector<SpanRegressionDetector::Regression> regressions;
+  span_regressions_.GetRegressions(&regressions);
+  text.setf(std::ios::fixed, std::ios::floatfield);
+  text.precision(1);
+  if (regressions.empty()) {
+    text << L"No span names of the baseline's "
+        << span_regressions_.baseline_size() << L" regressed past "
+        << span_regressions_.factor() << L"x." << std::endl;
+  }
+  for (size_t i = 0;
+       i < regressions.size() && i < kMaxSpanRegressionNames; ++i) {
+    const SpanRegressionDetector::Regression& regression = regressions[i];
+    base::Time::Exploded flagged;
+    regression.first_flagged.LocalExplode(&flagged);
+    text << base::UTF8ToWide(regression.name) << L": 95th "
+        << regression.p95.InMillisecondsF() << L" ms, baseline "
+        << regression.baseline_p95.InMillisecondsF() << L" ms ("
+        << regression.ratio << L"x) over " << regression.count
+        << L" spans, flagged at "
+        << base::StringPrintf(L"%02d:%02d:%02d", flagged.hour,
+                              flagged.minute, flagged.second)
+        << std::endl;
+  }
+
+  ::MessageBox(m_hWnd, text.str().c_str(), L"Span Regressions", MB_OK);
+  return 0;
+}
+
+LRESULT ViewerWindow::OnEventRates(WORD code,
+                                   LPARAM lparam,
+                                   HWND wnd,
+                                   BOOL& handled) {
+  // The sessions' providers don't overlap, nor do their sources.
+  std::vector<EventRateStats::Rates> rates;
+  for (size_t i = 0; i < app_sessions_.size(); ++i) {
+    std::vector<EventRateStats::Rates> session_rates;
+    app_sessions_[i]->rate_stats.GetRates(&session_rates);
+    rates.insert(rates.end(), session_rates.begin(), session_rates.end());
+  }
+  std::sort(rates.begin(), rates.end(), EventRateStats::BusiestFirst);
+
+  std::wstringstream text;
+  if (rates.empty())
+    text << L"No events captured yet." << std::endl;
+  text.setf(std::ios::fixed, std::ios::floatfield);
+  text.precision(1);
+  for (size_t i = 0; i < rates.size() && i < kMaxEventRateSources; ++i) {
+    const EventRateStats::Rates& rate = rates[i];
+    std::wstring event_class;
+    if (rate.key.event_class == logging::kLogEventId) {
+      event_class = L"Log";
+    } else if (rate.key.event_class == base::debug::kTraceEventClass32 ||
+               rate.key.event_class == base::debug::kTraceEventClass64) {
+      event_class = L"Trace";
+    } else {
+      wchar_t guid[40] = {};
+      CHECK(::StringFromGUID2(rate.key.event_class, guid, arraysize(guid)));
+      event_class = guid;
+    }
+
+    text << L"Process " << rate.key.process_id << L", level "
+        << static_cast<int>(rate.key.level) << L", " << event_class << L": "
+        << rate.events_per_second << L" events/s, "
+        << rate.bytes_per_second / 1024 << L" KB/s, "
+        << rate.events << L" events in all  "
+        << MakeSparkline(rate.history) << std::endl;
+  }
+  if (rates.size() > kMaxEventRateSources) {
+    text << std::endl << (rates.size() - kMaxEventRateSources)
+        << L" quieter sources not shown." << std::endl;
+  }
+
+  // The drops let the rates of what was kept be scaled back up.
+  LogSampler::Stats sampling;
+  log_sampler_.GetStats(&sampling);
+  for (size_t i = 0; i < app_sessions_.size(); ++i)
+    AddSamplingStats(app_sessions_[i]->sampler, &sampling);
+  if (sampling.messages != 0) {
+    text << std::endl << L"Sampling saw " << sampling.messages
+        << L" log messages, the rate limit dropped "
+        << sampling.rate_limited << L"." << std::endl;
+    for (size_t i = 0; i < sampling.rules.size(); ++i) {
+      text << L"Rule " << i + 1 << L": " << sampling.rules[i].matched
+          << L" matched, " << sampling.rules[i].dropped << L" dropped."
+          << std::endl;
+    }
+  }
+
+  ::MessageBox(m_hWnd, text.str().c_str(), L"Event Rates", MB_OK);
+  return 0;
+}
+
+LRESULT ViewerWindow::OnPerfStats(WORD code,
+                                  LPARAM lparam,
+                                  HWND wnd,
+                                  BOOL& handled) {
+  std::vector<PerfCounterValues> values;
+  PerfCounter::GetAllValues(&values);
+  std::string stats = FormatPerfCounterValues(values);
+  if (responsiveness_monitor_ != NULL)
+    stats += "\n" + responsiveness_monitor_->Format();
+  stats += "\n" + base::WideToUTF8(MemoryBudget::Get()->FormatSummary());
+
+  std::wstring text(base::UTF8ToWide(stats));
+  text += L"\nSave the statistics to a file?";
+  if (::MessageBox(m_hWnd, text.c_str(), L"Performance Statistics",
+                   MB_YESNO) != IDYES) {
+    return 0;
+  }
+
+  CShellFileSaveDialog dialog(L"sawbuck_perf",
+                              FOS_FORCEFILESYSTEM | FOS_PATHMUSTEXIST |
+                                  FOS_OVERWRITEPROMPT | FOS_DONTADDTORECENT,
+                              L"txt",
+                              &kTextFileSpec[0],
+                              1);
+  if (dialog.DoModal() != IDOK)
+    return 0;
+
+  std::wstring file_path;
+  file_path.resize(MAX_PATH);
+  if (FAILED(dialog.GetFilePath(&file_path[0], MAX_PATH - 1)))
+    return 0;
+  file_path.resize(wcslen(file_path.c_str()));
+
+  if (base::WriteFile(base::FilePath(file_path), stats.data(),
+                      stats.size()) != static_cast<int>(stats.size())) {
+    LOG(ERROR) << "Failed to save performance statistics to " << file_path;
+    ::MessageBox(m_hWnd, L"Failed to write the file.", L"File save error.",
+                 MB_OK | MB_ICONWARNING);
+  }
+  return 0;
+}
+
 BOOL ViewerWindow::OnIdle() {
   UIUpdateMenuBar();
   UIUpdateStatusBar();
@@ -660,10 +2773,19 @@ int ViewerWindow::OnCreate(LPCREATESTRUCT lpCreateStruct) {
 
   // Import is enabled, except when capturing.
   UIEnable(ID_FILE_IMPORT, true);
+  UIEnable(ID_FILE_IMPORT_SCOPED, true);
+  UIEnable(ID_FILE_IMPORT_LAZILY, kLargeAddressSpace);
+  UIEnable(ID_FILE_CANCEL_IMPORT, false);
+  UIEnable(ID_FILE_FOLLOW_LOG, true);
+  UIEnable(ID_FILE_RELOAD_CAPTURE, false);
+  UIEnable(ID_FILE_OPEN_SESSION, true);
+  UIEnable(ID_FILE_SAVE_SESSION, true);
+  UIEnable(ID_LOG_PAUSE_CAPTURE, false);
 
   // Edit menu is disabled by default.
   UIEnable(ID_EDIT_CUT, false);
   UIEnable(ID_EDIT_COPY, false);
+  UIEnable(ID_EDIT_COPY_TO_FILE, false);
   UIEnable(ID_EDIT_PASTE, false);
   UIEnable(ID_EDIT_CLEAR, false);
   UIEnable(ID_EDIT_CLEAR_ALL, false);
@@ -680,6 +2802,20 @@ int ViewerWindow::OnCreate(LPCREATESTRUCT lpCreateStruct) {
   log_viewer_.SetLogView(this);
   log_viewer_.SetSymbolLookupService(&symbol_lookup_service_);
   log_viewer_.SetProcessInfoService(&process_info_service_);
+  log_viewer_.SetThreadInfoService(&thread_info_service_);
+  log_viewer_.SetCpuTimelineService(&cpu_timeline_service_);
+  log_viewer_.SetDiskIoLatencyService(&disk_io_latency_service_);
+  log_viewer_.SetCpuProfileService(&cpu_profile_service_);
+  log_viewer_.SetRegistryAccessService(&registry_access_service_);
+  log_viewer_.SetThreadContextService(&thread_context_service_);
+  log_viewer_.SetSpanIndex(&span_index_);
+  log_viewer_.SetProcessMemoryService(&process_memory_service_);
+  log_viewer_.SetProcessTree(&process_tree_);
+
+  Preferences prefs;
+  std::string library;
+  prefs.ReadStringValue(config::kSessionLibraryValue, &library, "");
+  session_library_.DeserializePaths(library);
 
   log_viewer_.Create(m_hWnd,
                      NULL,
@@ -737,57 +2873,174 @@ void ViewerWindow::OnDestroy() {
   ::PostQuitMessage(1);
 }
 
+void ViewerWindow::OnSize(UINT type, CSize size) {
+  // Catch the views up on what came in while we were minimized.
+  if (type != SIZE_MINIMIZED && new_items_deferred_)
+    DispatchLogViewNewItems();
+
+  // Keep the update cost and session statistics panes at the right of the
+  // status bar.
+  if (m_hWndStatusBar != NULL) {
+    int right = std::max(0, size.cx - kSessionStatsPaneWidth);
+    int parts[] = { std::max(0, right - kUpdateCostPaneWidth), right, -1 };
+    CStatusBarCtrl(m_hWndStatusBar).SetParts(arraysize(parts), parts);
+  }
+
+  // Let the frame lay itself out.
+  SetMsgHandled(FALSE);
+}
+
 int ViewerWindow::GetNumRows() {
-  base::AutoLock lock(list_lock_);
-  return log_messages_.size();
+  if (lazy_log_.get() != NULL)
+    return lazy_log_->num_rows();
+  return log_store_.num_rows();
+}
+
+int ViewerWindow::GetFirstRow() {
+  if (lazy_log_.get() != NULL)
+    return 0;
+  return log_store_.first_row();
 }
 
 void ViewerWindow::ClearAll() {
-  {
-    base::AutoLock lock(list_lock_);
-    log_messages_.clear();
-  }
+  // Queued rows are part of what's cleared.
+  FlushPendingRows();
+  log_store_.Clear();
+  lazy_log_.reset();
+  process_tree_.ClearTallies();
+  log_viewer_.SetReportTexts(std::vector<ReportArchive::TextEntry>());
+  capture_spill_.Clear();
+  loss_summary_.clear();
+  notified_first_row_ = 0;
+  // The rows are numbered anew, so the checkpoint starts over.
+  session_checkpoint_.Stop();
+  if (IsCapturing())
+    StartCheckpoint();
+  UIEnable(ID_FILE_SAVE_SESSION, true);
   NotifyLogViewCleared();
 }
 
 int ViewerWindow::GetSeverity(int row) {
-  base::AutoLock lock(list_lock_);
-  return log_messages_[row].level;
+  if (lazy_log_.get() != NULL)
+    return lazy_log_->GetSeverity(row);
+  return log_store_.GetSeverity(row);
 }
 
 DWORD ViewerWindow::GetProcessId(int row) {
-  base::AutoLock lock(list_lock_);
-  return log_messages_[row].process_id;
+  if (lazy_log_.get() != NULL)
+    return lazy_log_->GetProcessId(row);
+  return log_store_.GetProcessId(row);
 }
 
 DWORD ViewerWindow::GetThreadId(int row) {
-  base::AutoLock lock(list_lock_);
-  return log_messages_[row].thread_id;
+  if (lazy_log_.get() != NULL)
+    return lazy_log_->GetThreadId(row);
+  return log_store_.GetThreadId(row);
 }
 
 base::Time ViewerWindow::GetTime(int row) {
-  base::AutoLock lock(list_lock_);
-  return log_messages_[row].time_stamp;
+  if (lazy_log_.get() != NULL)
+    return lazy_log_->GetTime(row);
+  return log_store_.GetTime(row);
 }
 
 std::string ViewerWindow::GetFileName(int row) {
-  base::AutoLock lock(list_lock_);
-  return log_messages_[row].file;
+  return GetFileNamePiece(row, NULL).as_string();
+}
+
+StringTable::Atom ViewerWindow::GetFileAtom(int row) {
+  if (lazy_log_.get() != NULL)
+    return lazy_log_->GetFileAtom(row);
+  return log_store_.GetFileAtom(row);
 }
 
 int ViewerWindow::GetLine(int row) {
-  base::AutoLock lock(list_lock_);
-  return log_messages_[row].line;
+  if (lazy_log_.get() != NULL)
+    return lazy_log_->GetLine(row);
+  return log_store_.GetLine(row);
 }
 
 std::string ViewerWindow::GetMessage(int row) {
-  base::AutoLock lock(list_lock_);
-  return log_messages_[row].message;
+  std::string buffer;
+  return GetMessagePiece(row, &buffer).as_string();
+}
+
+void ViewerWindow::GetStackTrace(int row,
+                                 std::vector<sym_util::Address>* trace) {
+  if (lazy_log_.get() != NULL) {
+    lazy_log_->GetStackTrace(row, trace);
+    return;
+  }
+  log_store_.GetStackTrace(row, trace);
+}
+
+base::StringPiece ViewerWindow::GetFileNamePiece(int row,
+                                                 std::string* buffer) {
+  // The file names are interned either way, so they stay put.
+  if (lazy_log_.get() != NULL)
+    return file_table_.GetString(lazy_log_->GetFileAtom(row));
+  return log_store_.GetFileName(row);
+}
+
+base::StringPiece ViewerWindow::GetMessagePiece(int row,
+                                                std::string* buffer) {
+  if (lazy_log_.get() != NULL) {
+    DCHECK(buffer != NULL);
+    lazy_log_->GetMessage(row, buffer);
+    return *buffer;
+  }
+  return log_store_.GetMessage(row, buffer);
+}
+
+StackTracePool::StackId ViewerWindow::GetStackTraceId(int row) {
+  // The lazy rows aren't interned, so their traces go unidentified.
+  if (lazy_log_.get() != NULL)
+    return StackTracePool::kUnknownStack;
+  return log_store_.GetStackTraceId(row);
+}
+
+bool ViewerWindow::CollapsesRepeats() {
+  return lazy_log_.get() == NULL && log_store_.collapse_repeats();
+}
+
+int ViewerWindow::GetRepeatCount(int row) {
+  if (lazy_log_.get() != NULL)
+    return 1;
+  return log_store_.GetRepeatCount(row);
+}
+
+base::Time ViewerWindow::GetLastTime(int row) {
+  if (lazy_log_.get() != NULL)
+    return lazy_log_->GetTime(row);
+  return log_store_.GetLastTime(row);
+}
+
+bool ViewerWindow::IsLossMarker(int row) {
+  // Lazy rows come straight from the file, which has no markers.
+  if (lazy_log_.get() != NULL)
+    return false;
+  return log_store_.IsLossMarker(row);
+}
+
+int ViewerWindow::FindRowForTime(const base::Time& time) {
+  if (lazy_log_.get() != NULL)
+    return lazy_log_->FindRowForTime(time);
+  return log_store_.FindRowForTime(time);
+}
+
+StackModuleIndex* ViewerWindow::GetStackModuleIndex() {
+  return &stack_module_index_;
+}
+
+ProcessInstanceIndex* ViewerWindow::GetProcessInstanceIndex() {
+  return &process_instance_index_;
 }
 
-void ViewerWindow::GetStackTrace(int row, std::vector<void*>* trace) {
-  base::AutoLock lock(list_lock_);
-  *trace = log_messages_[row].trace;
+const LogStore* ViewerWindow::GetLogStore() {
+  // The views read the lazy rows through us, row by row.
+  if (lazy_log_.get() != NULL)
+    return NULL;
+  return &log_store_;
 }
 
 void ViewerWindow::Register(ILogViewEvents* event_sink,
@@ -802,6 +3055,30 @@ void ViewerWindow::Unregister(int registration_cookie) {
   event_sinks_.erase(registration_cookie);
 }
 
+void ViewerWindow::ReadStartupSettings() {
+  DCHECK_EQ(startup_thread_.message_loop(), base::MessageLoop::current());
+
+  InitSymbolPath();
+  // This hands the path to the symbol lookup worker, ahead of the lookups
+  // posted once we signal.
+  symbol_lookup_service_.SetSymbolPath(symbol_path_.c_str());
+  symbol_path_ready_.Signal();
+
+  settings_.ReadProvidersCached();
+  settings_.ReadSettings();
+  settings_ready_.Signal();
+}
+
+void ViewerWindow::WaitForSymbolPath() {
+  DCHECK_EQ(ui_loop_, base::MessageLoop::current());
+  symbol_path_ready_.Wait();
+}
+
+void ViewerWindow::WaitForProviderSettings() {
+  DCHECK_EQ(ui_loop_, base::MessageLoop::current());
+  settings_ready_.Wait();
+}
+
 void ViewerWindow::InitSymbolPath() {
   {
     // Attempt to read our current preference if one exists.
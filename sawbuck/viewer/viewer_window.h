@@ -24,29 +24,70 @@
 #include <atlframe.h>
 #include <atlmisc.h>
 #include <atlres.h>
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
+#include "base/atomicops.h"
 #include "base/cancelable_callback.h"
 #include "base/files/file_path.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
 #include "base/synchronization/lock.h"
+#include "base/synchronization/waitable_event.h"
 #include "base/threading/thread.h"
+#include "base/threading/thread_local.h"
 #include "base/win/event_trace_controller.h"
+#include "sawbuck/common/reorder_buffer.h"
+#include "sawbuck/common/spsc_ring.h"
+#include "sawbuck/log_lib/cpu_profile_service.h"
+#include "sawbuck/log_lib/cpu_timeline_service.h"
+#include "sawbuck/log_lib/disk_io_latency_service.h"
+#include "sawbuck/log_lib/event_rate_stats.h"
 #include "sawbuck/log_lib/kernel_log_consumer.h"
 #include "sawbuck/log_lib/log_consumer.h"
+#include "sawbuck/log_lib/log_sampler.h"
 #include "sawbuck/log_lib/process_info_service.h"
+#include "sawbuck/log_lib/process_memory_service.h"
+#include "sawbuck/log_lib/registry_access_service.h"
+#include "sawbuck/log_lib/session_cost_meter.h"
+#include "sawbuck/log_lib/span_index.h"
+#include "sawbuck/log_lib/span_regression_detector.h"
 #include "sawbuck/log_lib/symbol_lookup_service.h"
+#include "sawbuck/log_lib/tdh_event_decoder.h"
+#include "sawbuck/log_lib/thread_context_service.h"
+#include "sawbuck/log_lib/thread_info_service.h"
+#include "sawbuck/log_lib/trace_flow_matcher.h"
+#include "sawbuck/log_lib/trace_span_matcher.h"
+#include "sawbuck/viewer/back_pressure_controller.h"
+#include "sawbuck/viewer/capture_spill.h"
+#include "sawbuck/viewer/lazy_log.h"
+#include "sawbuck/viewer/log_follower.h"
+#include "sawbuck/viewer/log_importer.h"
+#include "sawbuck/viewer/log_index.h"
+#include "sawbuck/viewer/log_store.h"
 #include "sawbuck/viewer/log_viewer.h"
+#include "sawbuck/viewer/process_instance_index.h"
+#include "sawbuck/viewer/process_tree.h"
 #include "sawbuck/viewer/provider_configuration.h"
+#include "sawbuck/viewer/remote_capture.h"
+#include "sawbuck/viewer/session_buffer_sizer.h"
+#include "sawbuck/viewer/session_checkpoint.h"
+#include "sawbuck/viewer/session_library.h"
 #include "sawbuck/viewer/resource.h"
+#include "sawbuck/viewer/stack_module_index.h"
+#include "sawbuck/viewer/update_pacer.h"
 
+class ResponsivenessMonitor;
 
 class ViewerWindow
     : public CFrameWindowImpl<ViewerWindow>,
       public LogEvents,
       public TraceEvents,
       public ILogView,
+      public LogImporter::Delegate,
+      public RemoteCapture::Delegate,
+      public LogFollower::Delegate,
       public CIdleHandler,
       public CMessageFilter,
       public CUpdateUI<ViewerWindow> {
@@ -57,12 +98,30 @@ class ViewerWindow
   BEGIN_MSG_MAP_EX(ViewerWindow)
     MSG_WM_CREATE(OnCreate)
     MSG_WM_DESTROY(OnDestroy)
+    MSG_WM_SIZE(OnSize)
     COMMAND_ID_HANDLER(ID_FILE_IMPORT, OnImport)
+    COMMAND_ID_HANDLER(ID_FILE_IMPORT_LAZILY, OnImportLazily)
+    COMMAND_ID_HANDLER(ID_FILE_IMPORT_SCOPED, OnImportScoped)
+    COMMAND_ID_HANDLER(ID_FILE_CANCEL_IMPORT, OnCancelImport)
+    COMMAND_ID_HANDLER(ID_FILE_FOLLOW_LOG, OnToggleFollowLog)
+    COMMAND_ID_HANDLER(ID_FILE_RELOAD_CAPTURE, OnReloadCapture)
+    COMMAND_ID_HANDLER(ID_FILE_OPEN_SESSION, OnOpenSession)
+    COMMAND_ID_HANDLER(ID_FILE_SAVE_SESSION, OnSaveSession)
+    COMMAND_ID_HANDLER(ID_FILE_EXPORT_TRACE, OnExportTrace)
+    COMMAND_ID_HANDLER(ID_FILE_ADD_TO_LIBRARY, OnAddToLibrary)
+    COMMAND_ID_HANDLER(ID_FILE_SEARCH_LIBRARY, OnSearchLibrary)
     COMMAND_ID_HANDLER(ID_FILE_EXIT, OnExit)
     COMMAND_ID_HANDLER(ID_APP_ABOUT, OnAbout)
     COMMAND_ID_HANDLER(ID_LOG_CONFIGUREPROVIDERS, OnConfigureProviders)
     COMMAND_ID_HANDLER(ID_LOG_CAPTURE, OnToggleCapture)
+    COMMAND_ID_HANDLER(ID_LOG_CAPTURE_REMOTE, OnToggleRemoteCapture)
+    COMMAND_ID_HANDLER(ID_LOG_PAUSE_CAPTURE, OnTogglePauseCapture)
     COMMAND_ID_HANDLER(ID_LOG_SYMBOLPATH, OnSymbolPath)
+    COMMAND_ID_HANDLER(ID_LOG_TRACE_DURATIONS, OnTraceDurations)
+    COMMAND_ID_HANDLER(ID_LOG_SPAN_BASELINE, OnLoadSpanBaseline)
+    COMMAND_ID_HANDLER(ID_LOG_SPAN_REGRESSIONS, OnSpanRegressions)
+    COMMAND_ID_HANDLER(ID_LOG_EVENT_RATES, OnEventRates)
+    COMMAND_ID_HANDLER(ID_HELP_PERF_STATS, OnPerfStats)
     // Forward other commands to the client window.
     CHAIN_CLIENT_COMMANDS()
     CHAIN_MSG_MAP(CUpdateUI<ViewerWindow>);
@@ -71,18 +130,34 @@ class ViewerWindow
 
   BEGIN_UPDATE_UI_MAP(ViewerWindow)
     UPDATE_ELEMENT(ID_FILE_IMPORT, UPDUI_MENUBAR)
+    UPDATE_ELEMENT(ID_FILE_IMPORT_LAZILY, UPDUI_MENUBAR)
+    UPDATE_ELEMENT(ID_FILE_IMPORT_SCOPED, UPDUI_MENUBAR)
+    UPDATE_ELEMENT(ID_FILE_CANCEL_IMPORT, UPDUI_MENUBAR)
+    UPDATE_ELEMENT(ID_FILE_FOLLOW_LOG, UPDUI_MENUBAR)
+    UPDATE_ELEMENT(ID_FILE_RELOAD_CAPTURE, UPDUI_MENUBAR)
+    UPDATE_ELEMENT(ID_FILE_OPEN_SESSION, UPDUI_MENUBAR)
+    UPDATE_ELEMENT(ID_FILE_SAVE_SESSION, UPDUI_MENUBAR)
     UPDATE_ELEMENT(ID_LOG_CAPTURE, UPDUI_MENUBAR)
+    UPDATE_ELEMENT(ID_LOG_CAPTURE_REMOTE, UPDUI_MENUBAR)
+    UPDATE_ELEMENT(ID_LOG_PAUSE_CAPTURE, UPDUI_MENUBAR)
     UPDATE_ELEMENT(ID_LOG_FILTER, UPDUI_MENUBAR)
+    UPDATE_ELEMENT(ID_LOG_SORT_BY_TIME, UPDUI_MENUBAR)
+    UPDATE_ELEMENT(ID_LOG_WARNINGS_ONLY, UPDUI_MENUBAR)
+    UPDATE_ELEMENT(ID_LOG_QUERY, UPDUI_MENUBAR)
     UPDATE_ELEMENT(ID_EDIT_AUTOSIZE_COLUMNS, UPDUI_MENUBAR)
     UPDATE_ELEMENT(ID_EDIT_CUT, UPDUI_MENUBAR)
     UPDATE_ELEMENT(ID_EDIT_COPY, UPDUI_MENUBAR)
+    UPDATE_ELEMENT(ID_EDIT_COPY_TO_FILE, UPDUI_MENUBAR)
     UPDATE_ELEMENT(ID_EDIT_PASTE, UPDUI_MENUBAR)
     UPDATE_ELEMENT(ID_EDIT_CLEAR, UPDUI_MENUBAR)
     UPDATE_ELEMENT(ID_EDIT_CLEAR_ALL, UPDUI_MENUBAR)
     UPDATE_ELEMENT(ID_EDIT_SELECT_ALL, UPDUI_MENUBAR)
     UPDATE_ELEMENT(ID_EDIT_FIND, UPDUI_MENUBAR)
     UPDATE_ELEMENT(ID_EDIT_FIND_NEXT, UPDUI_MENUBAR)
+    UPDATE_ELEMENT(ID_EDIT_GOTO_TIME, UPDUI_MENUBAR)
     UPDATE_ELEMENT(0, UPDUI_STATUSBAR)
+    UPDATE_ELEMENT(1, UPDUI_STATUSBAR)
+    UPDATE_ELEMENT(2, UPDUI_STATUSBAR)
   END_UPDATE_UI_MAP()
 
   ViewerWindow();
@@ -90,15 +165,29 @@ class ViewerWindow
 
   // ILogView implementation
   virtual int GetNumRows();
+  virtual int GetFirstRow();
   virtual void ClearAll();
   virtual int GetSeverity(int row);
   virtual DWORD GetProcessId(int row);
   virtual DWORD GetThreadId(int row);
   virtual base::Time GetTime(int row);
   virtual std::string GetFileName(int row);
+  virtual StringTable::Atom GetFileAtom(int row);
   virtual int GetLine(int row);
   virtual std::string GetMessage(int row);
-  virtual void GetStackTrace(int row, std::vector<void*>* stack_trace);
+  virtual void GetStackTrace(int row,
+                             std::vector<sym_util::Address>* stack_trace);
+  virtual base::StringPiece GetFileNamePiece(int row, std::string* buffer);
+  virtual base::StringPiece GetMessagePiece(int row, std::string* buffer);
+  virtual StackTracePool::StackId GetStackTraceId(int row);
+  virtual bool CollapsesRepeats();
+  virtual int GetRepeatCount(int row);
+  virtual base::Time GetLastTime(int row);
+  virtual bool IsLossMarker(int row);
+  virtual int FindRowForTime(const base::Time& time);
+  virtual StackModuleIndex* GetStackModuleIndex();
+  virtual ProcessInstanceIndex* GetProcessInstanceIndex();
+  virtual const LogStore* GetLogStore();
 
   virtual void Register(ILogViewEvents* event_sink,
                         int* registration_cookie);
@@ -107,44 +196,160 @@ class ViewerWindow
   // Turn capturing on or off.
   virtual void SetCapture(bool capture);
 
-  // Consumes the logs in paths.
+  // Starts consuming the logs in paths in the background.
   void ImportLogFiles(const std::vector<base::FilePath>& paths);
+  // As ImportLogFiles, but only indexes the logs, whose rows are then
+  // decoded as they're read. The rows replace what we have, @see LazyLog.
+  void ImportLogFilesLazily(const std::vector<base::FilePath>& paths);
+
+  // Offers to open the checkpoint a capture left behind by a crash, if
+  // any, then discards it.
+  void OfferLeftOverCheckpoint();
+
+  // Shows the UI stalls @p monitor sees in our status, and its tallies in
+  // the performance statistics. @p monitor must outlive us.
+  void set_responsiveness_monitor(ResponsivenessMonitor* monitor);
+
+  // LogImporter::Delegate implementation.
+  virtual void OnImportProgress(int percent_done);
+  virtual void OnImportDone(HRESULT hr);
+
+  // RemoteCapture::Delegate implementation.
+  virtual void OnRemoteCaptureDone(HRESULT hr);
+
+  // LogFollower::Delegate implementation.
+  virtual void OnLogFollowDone(HRESULT hr);
 
  private:
   LRESULT OnImport(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
+  LRESULT OnImportLazily(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
+  LRESULT OnImportScoped(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
+  LRESULT OnCancelImport(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
+  LRESULT OnToggleFollowLog(WORD code, LPARAM lparam, HWND wnd,
+                            BOOL& handled);
+  LRESULT OnReloadCapture(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
+  LRESULT OnOpenSession(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
+  LRESULT OnSaveSession(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
+  LRESULT OnExportTrace(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
+  LRESULT OnAddToLibrary(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
+  LRESULT OnSearchLibrary(WORD code, LPARAM lparam, HWND wnd,
+                          BOOL& handled);
   LRESULT OnExit(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
   LRESULT OnAbout(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
   LRESULT OnConfigureProviders(WORD code, LPARAM lparam, HWND wnd,
       BOOL& handled);
   LRESULT OnToggleCapture(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
+  LRESULT OnToggleRemoteCapture(WORD code, LPARAM lparam, HWND wnd,
+                                BOOL& handled);
+  LRESULT OnTogglePauseCapture(WORD code, LPARAM lparam, HWND wnd,
+                               BOOL& handled);
   LRESULT OnSymbolPath(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
+  LRESULT OnTraceDurations(WORD code, LPARAM lparam, HWND wnd,
+                           BOOL& handled);
+  LRESULT OnLoadSpanBaseline(WORD code, LPARAM lparam, HWND wnd,
+                             BOOL& handled);
+  LRESULT OnSpanRegressions(WORD code, LPARAM lparam, HWND wnd,
+                            BOOL& handled);
+  LRESULT OnEventRates(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
+  LRESULT OnPerfStats(WORD code, LPARAM lparam, HWND wnd, BOOL& handled);
 
   virtual BOOL OnIdle();
   virtual BOOL PreTranslateMessage(MSG* pMsg);
   int OnCreate(LPCREATESTRUCT lpCreateStruct);
   void OnDestroy();
+  void OnSize(UINT type, CSize size);
 
   // Host for compile-time asserts on privates.
   static void CompileAsserts();
 
+  struct AppSession;
+  struct PendingRowQueue;
+
   void StopCapturing();
   bool StartCapturing();
+  // Pauses or resumes the capture. A paused capture keeps its sessions
+  // running, but its rows go to capture_spill_ rather than log_store_, and
+  // resuming appends them all in one go.
+  void SetCapturePaused(bool paused);
+  // Starts @p session, and a consumer on it, writing it to @p capture_file
+  // too unless it's empty.
+  // @returns true on success.
+  bool StartAppSession(AppSession* session,
+                       const base::FilePath& capture_file,
+                       bool circular,
+                       ULONG max_file_mb);
+  // @returns true while the sessions of a local capture run.
+  bool IsCapturing() const;
+  // @returns the session the provider at @p index of the settings is
+  //     enabled on while capturing.
+  AppSession* GetProviderSession(size_t index);
+
+  // Prompts for the log files to import into @p paths.
+  // @returns true unless the prompt is dismissed.
+  bool PromptForLogFiles(std::vector<base::FilePath>* paths);
+  // Starts importing @p scope of @p paths, lazily if @p lazy is true.
+  void StartImport(const std::vector<base::FilePath>& paths,
+                   bool lazy,
+                   const LogImporter::Scope& scope);
+  // Opens the session at @p path in place of what we have.
+  // @returns true on success.
+  bool OpenSession(const base::FilePath& path);
+  // Starts checkpointing the store, for as long as we capture to it.
+  void StartCheckpoint();
 
  private:
   // Initializes the symbol path.
   void InitSymbolPath();
 
+  // Runs on startup_thread_ to set up the symbol path and read the
+  // provider settings, which may take seconds, off the UI thread.
+  void ReadStartupSettings();
+  // Block until ReadStartupSettings has set up symbol_path_, and until
+  // it has read settings_, respectively.
+  void WaitForSymbolPath();
+  void WaitForProviderSettings();
+
   // Called on UI thread to dispatch notifications to listeners.
   void NotifyLogViewNewItems();
+  void DispatchLogViewNewItems();
   void NotifyLogViewCleared();
+  // Tells the listeners of any rows the store evicted since last they
+  // heard. They must hear of it before they next access a row.
+  void NotifyLogViewEvicted();
 
   // LogEvents implementation.
   void OnLogMessage(const LogEvents::LogMessage& log_message);
+  void OnLogMessages(const LogEvents::LogMessage* log_messages,
+                     size_t num_messages);
+  void OnEventLoss(const LogEvents::EventLoss& event_loss);
+
+  // Parses log_message and adds it to the log.
+  void AddLogMessage(const LogEvents::LogMessage& log_message);
 
   // Invoked on the background thread by the symbol service.
   void OnStatusUpdate(const wchar_t* status);
   // Invoked on the UI thread to update our status.
   void UpdateStatus();
+  // Invoked on the UI thread by the responsiveness monitor.
+  void OnUIStall(const std::wstring& description);
+
+  // Invoked on the UI thread every so often while capturing, to show the
+  // statistics of our sessions and grow the buffers of those falling
+  // behind.
+  void UpdateSessionStats();
+  // Has back_pressure_ sample the app sessions, falling behind if
+  // @p behind, and applies its changes to the providers, with a marker row
+  // for each.
+  void ApplyBackPressure(bool behind);
+  // Retrieves the events per second of each provider of settings_ over
+  // the last interval of the sessions' rate stats to @p rates.
+  void GetProviderRates(std::vector<double>* rates);
+  // Invoked on the UI thread every so often to have the caches shed
+  // memory when they're over the budget, or memory runs low.
+  void CheckMemory();
+  // Shows the losses of the last import and the memory budget in the
+  // session stats pane, unless capturing.
+  void UpdateIdleStats();
 
   // TraceEvents implementation.
   void OnTraceEventBegin(const TraceEvents::TraceMessage& trace_message);
@@ -155,41 +360,149 @@ class ViewerWindow
   void AddTraceEventToLog(const char* type,
                           const TraceEvents::TraceMessage& trace_message);
 
+  // Adds a row to the log. On the UI thread the row goes straight to
+  // log_store_, otherwise it's queued to the ring of the calling thread's
+  // queue, or to its overflow rows when the ring is full. The caller is
+  // responsible for scheduling the new items notification.
+  void AddRow(UCHAR level,
+              DWORD process_id,
+              DWORD thread_id,
+              const base::Time& time,
+              StringTable::Atom file,
+              int line,
+              const base::StringPiece& message,
+              size_t trace_depth,
+              void* const* traces);
+
+  // Moves the queued rows to the reorder buffer, and from there to
+  // log_store_ those that are due, must be called on the UI thread.
+  void DrainPendingRows();
+  // As DrainPendingRows, but moves all of the reorder buffer to log_store_.
+  void FlushPendingRows();
+  // Moves the queued rows to the reorder buffer.
+  void TakePendingRows();
+  void TakeQueuedRows(PendingRowQueue* rows);
+  void DrainRing(PendingRowQueue* rows);
+  // Has the rows AddRow queues on the calling thread go to @p rows.
+  void SetProducerRows(PendingRowQueue* rows);
+  // Holds @p row in the reorder buffer, taking its contents, or adds it
+  // straight to log_store_ if reordering is off.
+  void ReorderRow(PendingRow* row);
+  void AddPendingRowToStore(const PendingRow& row);
+
   // Schedule a notification of new items on UI thread.
-  // Must be called under list_lock_.
+  // May be called on any thread.
   void ScheduleNewItemsNotification();
 
+  // Enables the unmuted providers of @p settings in the log session.
   void EnableProviders(const ProviderConfiguration& settings);
+  // Applies the settings of the provider at @p index in @p settings to
+  // the running log session, disabling it if it's muted.
+  void UpdateProvider(const ProviderConfiguration& settings, size_t index);
 
   // The currently configured symbol path.
   std::wstring symbol_path_;
 
-  struct LogMessage {
-    LogMessage() : level(0), process_id(0), thread_id(0), line(0) {
-    }
+  // We dedicate a thread to the symbol lookup work, rather than use the
+  // task pool, as dbghelp is single threaded: the lookup service runs its
+  // requests serially on a loop of its own.
+  base::Thread symbol_lookup_worker_;
+
+  // The file names of all log messages, shared with the log parsers.
+  StringTable file_table_;
 
+  // The rows of the log, only accessed on the UI thread.
+  LogStore log_store_;
+  // The rows of the last lazy import, if any, which stand in for
+  // log_store_ until they're cleared.
+  scoped_ptr<LazyLog> lazy_log_;
+  // The first row of log_store_ the listeners know of.
+  int notified_first_row_;
+
+  // A row on its way from the log consumer thread to log_store_.
+  struct PendingRow {
     UCHAR level;
     DWORD process_id;
     DWORD thread_id;
-    base::Time time_stamp;
-    std::string file;
+    base::Time time;
+    StringTable::Atom file;
     int line;
     std::string message;
-    std::vector<void*> trace;
+    std::vector<sym_util::Address> trace;
+
+    // Swaps rows without copying their storage, for the reorder buffer.
+    friend void swap(PendingRow& a, PendingRow& b) {
+      std::swap(a.level, b.level);
+      std::swap(a.process_id, b.process_id);
+      std::swap(a.thread_id, b.thread_id);
+      std::swap(a.time, b.time);
+      std::swap(a.file, b.file);
+      std::swap(a.line, b.line);
+      a.message.swap(b.message);
+      a.trace.swap(b.trace);
+    }
+  };
+  // Fills in @p row, reusing its storage.
+  static void SetPendingRow(UCHAR level,
+                            DWORD process_id,
+                            DWORD thread_id,
+                            const base::Time& time,
+                            StringTable::Atom file,
+                            int line,
+                            const base::StringPiece& message,
+                            size_t trace_depth,
+                            void* const* traces,
+                            PendingRow* row);
+
+  // A log consumer thread publishes rows to the ring of its queue, and the
+  // UI thread moves them to log_store_ before it notifies of new items.
+  // Should the ring fill up, the consumer thread spills to overflow_rows
+  // rather than block on the UI thread. To preserve order, it keeps
+  // spilling until the UI thread has drained the overflow.
+  struct PendingRowQueue {
+    PendingRowQueue();
+
+    SpscRing<PendingRow> ring;
+    base::Lock overflow_lock;
+    std::vector<PendingRow> overflow_rows;  // Under overflow_lock.
+    base::subtle::Atomic32 overflowing;
   };
 
-  // We dedicate a thread to the symbol lookup work.
-  base::Thread symbol_lookup_worker_;
-
-  base::Lock list_lock_;
-  typedef std::vector<LogMessage> LogMessageList;
-  LogMessageList log_messages_;  // Under list_lock_.
+  // The queue of the threads without one of their own, such as that of a
+  // remote capture.
+  PendingRowQueue default_rows_;
+  // The queue of each app session's consumer thread.
+  base::ThreadLocalPointer<PendingRowQueue> producer_rows_;
+
+  // During live capture the kernel events that rows depend on, such as the
+  // loads of the modules of their stack traces, are consumed on another
+  // thread and can arrive after the rows. The UI thread holds the rows it
+  // drains here, and releases them to log_store_ in time order once they
+  // fall behind the kernel log's watermark, or are older than the reorder
+  // latency, whichever comes first. A zero latency turns this off.
+  ReorderBuffer<PendingRow> reorder_buffer_;
+  base::TimeDelta reorder_latency_;
+  // The row an import on the UI thread adds, reused from row to row.
+  PendingRow import_row_;
+  // While the capture is paused, the rows released to log_store_ are
+  // spilled here instead, so the views hear of none of them until it
+  // resumes.
+  bool capture_paused_;
+  CaptureSpill capture_spill_;
 
   typedef base::CancelableCallback<void()> NotifyNewItemsCallback;
 
   // Keeps the task pending to notify event sinks on the UI thread.
   NotifyNewItemsCallback notify_log_view_new_items_;
-  bool notify_log_view_new_items_pending_;  // Under list_lock_.
+  base::subtle::Atomic32 notify_log_view_new_items_pending_;
+  // When the pending notification was scheduled.
+  base::TimeTicks new_items_scheduled_;
+
+  // Paces the new items notifications, and accounts for their cost.
+  UpdatePacer new_items_pacer_;
+  // True iff new items came in while we were minimized, and the event
+  // sinks are yet to hear of them.
+  bool new_items_deferred_;
 
   // The message loop we're instantiated on, used to signal
   // back to the main thread from workers.
@@ -201,6 +514,8 @@ class ViewerWindow
 
   // The symbol lookup service we provide to the log list view.
   SymbolLookupService symbol_lookup_service_;
+  // Sums up the traces of log_store_ for the stack filters.
+  StackModuleIndex stack_module_index_;
   typedef base::Callback<void(const wchar_t*)> StatusCallback;
   StatusCallback status_callback_;
 
@@ -210,26 +525,150 @@ class ViewerWindow
   std::wstring status_;  // Under status_lock_.
   bool update_status_task_pending_;  // Under status_lock_;
 
+  // Watches the UI thread, if set.
+  ResponsivenessMonitor* responsiveness_monitor_;
+
   // Takes care of sinking KernelProcessEvents for us.
   ProcessInfoService process_info_service_;
-
-  // The list view control that displays log_messages_.
+  // Joins the rows of log_store_ to their processes for the process
+  // filters.
+  ProcessInstanceIndex process_instance_index_;
+  // Tallies the rows of log_store_ and the page faults by process, for
+  // the process tree pane. It passes the process events on to the memory
+  // service.
+  ProcessTree process_tree_;
+  // Keeps the memory timelines of the process instances for the memory
+  // chart, from the process counter events. It passes the process events
+  // on to the symbol lookup service, and the page faults on to the process
+  // tree.
+  ProcessMemoryService process_memory_service_;
+  // And KernelThreadEvents.
+  ThreadInfoService thread_info_service_;
+  // And KernelSchedulerEvents, when capturing context switches.
+  CpuTimelineService cpu_timeline_service_;
+  // And KernelDiskIoEvents, when capturing disk I/O.
+  DiskIoLatencyService disk_io_latency_service_;
+  // And KernelProfileEvents, when sampling the CPU.
+  CpuProfileService cpu_profile_service_;
+  // And KernelRegistryEvents, when capturing registry accesses.
+  RegistryAccessService registry_access_service_;
+  // Indexes the page fault, disk I/O and scheduler events by thread, in
+  // front of the services above.
+  ThreadContextService thread_context_service_;
+  // Samples the log messages we capture from a remote agent, on their way
+  // to us. A local capture samples by session.
+  LogSampler log_sampler_;
+  // Pairs up the begin and end trace events we capture.
+  TraceSpanMatcher trace_span_matcher_;
+  // And indexes its spans for the timeline.
+  SpanIndex span_index_;
+  // Checks its durations against those of a baseline session as we
+  // capture, once one is loaded.
+  SpanRegressionDetector span_regressions_;
+  // Follows the trace event flows that cross processes, for their latency.
+  TraceFlowMatcher trace_flow_matcher_;
+  // Records the kernel process and module events on their way to the
+  // services, for the sessions we save.
+  LogIndex session_events_;
+  // Checkpoints the store and the events above to disk as we capture, to
+  // save it in a copy, or open it after a crash.
+  SessionCheckpoint session_checkpoint_;
+
+  // The import in progress, if any.
+  scoped_ptr<LogImporter> importer_;
+  // What the sessions of the last import lost, and the duplicate rows
+  // dropped from its files, shown with the memory budget, or empty if
+  // there were none.
+  std::wstring loss_summary_;
+
+  // The capture from a remote agent in progress, if any, and the address
+  // of the last agent we captured from.
+  scoped_ptr<RemoteCapture> remote_capture_;
+  std::string remote_agent_;
+
+  // The scope of the last scoped import, as entered.
+  std::string import_scope_begin_;
+  std::string import_scope_duration_;
+  std::string import_scope_process_ids_;
+
+  // The saved sessions we search across, kept in the preferences, and the
+  // text last searched for.
+  SessionLibrary session_library_;
+  std::string session_search_text_;
+
+  // The log file being followed, if any, and its path.
+  scoped_ptr<LogFollower> log_follower_;
+  base::FilePath followed_log_;
+
+  // The list view control that displays log_store_.
   LogViewer log_viewer_;
 
-  // Controller for the logging session.
-  base::win::EtwTraceController log_controller_;
-
-  // Log level settings for the providers we know of.
+  // Log level settings for the providers we know of, read on
+  // startup_thread_. Valid on the UI thread once WaitForProviderSettings
+  // returns.
   ProviderConfiguration settings_;
 
+  // Reads our startup settings, signaling symbol_path_ready_ as it set up
+  // symbol_path_, and settings_ready_ as it read settings_.
+  base::Thread startup_thread_;
+  base::WaitableEvent symbol_path_ready_;
+  base::WaitableEvent settings_ready_;
+
   // Controller for the kernel logging session.
   base::win::EtwTraceController kernel_controller_;
 
+  // One of the real time sessions the app providers are split across,
+  // each consumed on a thread of its own with parsing state of its own.
+  struct AppSession {
+    AppSession(const std::wstring& name, LogEvents* sink);
+    ~AppSession();
+
+    std::wstring name;
+    base::win::EtwTraceController controller;
+    // NULL until StartConsuming. Valid until StopConsuming.
+    scoped_ptr<LogConsumer> consumer;
+    // Decodes the events of providers other than Chrome's for consumer,
+    // and outlives it.
+    scoped_ptr<TdhEventDecoder> decoder;
+    // Tallies the events of the session by source.
+    EventRateStats rate_stats;
+    // Samples the log messages of the session, on their way to us.
+    LogSampler sampler;
+    // The rows the consumer thread queues.
+    PendingRowQueue rows;
+    // Grows the buffers of the session while capturing.
+    scoped_ptr<SessionBufferSizer> buffer_sizer;
+    base::Thread thread;
+    // Parses the events copied on thread, when the parsing is deferred.
+    base::Thread ingest_thread;
+  };
+  // The sessions of the last capture, the first of which is kSessionName.
+  // They're kept after it stops for a look at what it captured.
+  ScopedVector<AppSession> app_sessions_;
+
   // NULL until StartConsuming. Valid until StopConsuming.
-  scoped_ptr<LogConsumer> log_consumer_;
   scoped_ptr<KernelLogConsumer> kernel_consumer_;
-  base::Thread log_consumer_thread_;
+  // The files the last capture was written to, if any. Unlike the real
+  // time consumers, the files don't miss the events of buffers lost to a
+  // consumer falling behind.
+  std::vector<base::FilePath> capture_files_;
+
+  // Grows the buffers of the kernel session while capturing.
+  scoped_ptr<SessionBufferSizer> kernel_buffer_sizer_;
+  // Measures what the kernel session costs while capturing, and the name
+  // of the kernel profile it captures, empty if none.
+  SessionCostMeter kernel_cost_meter_;
+  std::wstring kernel_profile_;
+  // Lowers the levels of the providers while the app sessions can't keep
+  // up, if back_pressure_on_, indexed as settings_ while capturing.
+  BackPressureController back_pressure_;
+  bool back_pressure_on_;
+  typedef base::CancelableCallback<void()> SessionStatsCallback;
+  SessionStatsCallback session_stats_task_;
+  SessionStatsCallback memory_check_task_;
   base::Thread kernel_consumer_thread_;
+  // Writes the sessions we save, started on first use.
+  base::Thread session_writer_thread_;
 };
 
 #endif  // SAWBUCK_VIEWER_VIEWER_WINDOW_H_
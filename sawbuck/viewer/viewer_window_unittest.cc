@@ -13,14 +13,30 @@
 // limitations under the License.
 #include "sawbuck/viewer/viewer_window.h"
 
+#include "base/bind.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/threading/thread.h"
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 #include "sawbuck/viewer/mock_log_view_interfaces.h"
 
 namespace {
 
+using testing::AtLeast;
 using testing::StrictMock;
 
+// Issues num_messages log messages to events, numbered from zero.
+void IssueLogMessages(LogEvents* events, int num_messages) {
+  for (int i = 0; i < num_messages; ++i) {
+    std::string text(base::IntToString(i));
+    LogEvents::LogMessage msg;
+    msg.level = TRACE_LEVEL_INFORMATION;
+    msg.message = text.c_str();
+    msg.message_len = text.length();
+    events->OnLogMessage(msg);
+  }
+}
+
 class ViewerWindowTest : public testing::Test {
  protected:
   base::MessageLoop message_loop_;
@@ -52,4 +68,34 @@ TEST_F(ViewerWindowTest, ClearAll) {
   viewer_window.ClearAll();
 }
 
+TEST_F(ViewerWindowTest, RowsFromOtherThread) {
+  ViewerWindow viewer_window;
+
+  int reg_cookie = 0;
+  StrictMock<testing::MockILogViewEvents> mock_event_sink;
+  viewer_window.Register(&mock_event_sink, &reg_cookie);
+
+  // Issue more messages than fit in the ring, to exercise the overflow.
+  const int kNumMessages = 20000;
+  base::Thread producer("Producer");
+  ASSERT_TRUE(producer.Start());
+  producer.message_loop()->PostTask(FROM_HERE,
+      base::Bind(&IssueLogMessages,
+                 static_cast<LogEvents*>(&viewer_window),
+                 kNumMessages));
+  producer.Stop();
+
+  // Rows don't show up until the UI thread gets around to them.
+  EXPECT_EQ(0, viewer_window.GetNumRows());
+
+  EXPECT_CALL(mock_event_sink, LogViewNewItems()).Times(AtLeast(1));
+  message_loop_.RunUntilIdle();
+
+  ASSERT_EQ(kNumMessages, viewer_window.GetNumRows());
+  for (int i = 0; i < kNumMessages; ++i)
+    ASSERT_EQ(base::IntToString(i), viewer_window.GetMessage(i));
+
+  viewer_window.Unregister(reg_cookie);
+}
+
 }  // namespace
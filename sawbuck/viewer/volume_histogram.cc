@@ -0,0 +1,245 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event volume histogram implementation.
+#include "sawbuck/viewer/volume_histogram.h"
+
+#include <evntrace.h>
+#include <algorithm>
+#include "base/logging.h"
+
+namespace {
+
+// @returns @p value / @p divisor rounded towards negative infinity.
+int64 FloorDiv(int64 value, int64 divisor) {
+  DCHECK_LT(0, divisor);
+  int64 quotient = value / divisor;
+  if (value % divisor < 0)
+    --quotient;
+  return quotient;
+}
+
+}  // namespace
+
+VolumeHistogram::Bucket::Bucket() {
+  for (int i = 0; i < NUM_SEVERITIES; ++i)
+    counts[i] = 0;
+}
+
+uint32 VolumeHistogram::Bucket::total() const {
+  uint32 total = 0;
+  for (int i = 0; i < NUM_SEVERITIES; ++i)
+    total += counts[i];
+  return total;
+}
+
+VolumeHistogram::VolumeHistogram() : origin_(0), num_rows_(0) {
+  Clear();
+}
+
+VolumeHistogram::~VolumeHistogram() {
+}
+
+void VolumeHistogram::Add(int64 time, UCHAR level) {
+  // The first row aligns the buckets, to the coarsest of them so that
+  // each bucket lies within one of each coarser level.
+  if (num_rows_ == 0) {
+    int64 width = levels_.back().width;
+    origin_ = FloorDiv(time, width) * width;
+  }
+  ++num_rows_;
+
+  Severity severity = GetSeverity(level);
+  size_t i = 0;
+  while (i < levels_.size()) {
+    Level& current = levels_[i];
+    int64 index = GetIndex(current, time);
+    std::deque<Bucket>& buckets = current.buckets;
+    if (buckets.empty()) {
+      current.first_index = index;
+      buckets.push_back(Bucket());
+    } else {
+      int64 old_last =
+          current.first_index + static_cast<int64>(buckets.size()) - 1;
+      int64 first = std::min(current.first_index, index);
+      int64 last = std::max(old_last, index);
+      // Only the finest level can outgrow its extent, as the coarsest
+      // level's indexes are clamped to it.
+      if (last - first >= static_cast<int64>(kMaxBuckets)) {
+        DCHECK_EQ(0U, i);
+        levels_.pop_front();
+        continue;
+      }
+
+      if (index < current.first_index) {
+        buckets.insert(buckets.begin(),
+                       static_cast<size_t>(current.first_index - index),
+                       Bucket());
+        current.first_index = index;
+      } else if (index > old_last) {
+        buckets.resize(static_cast<size_t>(index - current.first_index + 1));
+      }
+    }
+
+    ++buckets[static_cast<size_t>(index - current.first_index)]
+        .counts[severity];
+    ++i;
+  }
+}
+
+void VolumeHistogram::Remove(int64 time, UCHAR level) {
+  DCHECK_LT(0U, num_rows_);
+  --num_rows_;
+
+  Severity severity = GetSeverity(level);
+  for (size_t i = 0; i < levels_.size(); ++i) {
+    Level& current = levels_[i];
+    int64 offset = GetIndex(current, time) - current.first_index;
+    // A row past the coarsest level's extent may have been counted in
+    // what was its edge bucket then.
+    if (offset >= 0 && offset < static_cast<int64>(current.buckets.size())) {
+      uint32& count =
+          current.buckets[static_cast<size_t>(offset)].counts[severity];
+      if (count > 0)
+        --count;
+    }
+    Trim(&current);
+  }
+}
+
+void VolumeHistogram::Clear() {
+  levels_.clear();
+  int64 width = kFinestWidth;
+  for (size_t i = 0; i < kNumLevels; ++i) {
+    levels_.push_back(Level());
+    levels_.back().width = width;
+    width *= kFanout;
+  }
+  origin_ = 0;
+  num_rows_ = 0;
+}
+
+bool VolumeHistogram::empty() const {
+  return levels_.front().buckets.empty();
+}
+
+int64 VolumeHistogram::start_time() const {
+  const Level& finest = levels_.front();
+  if (finest.buckets.empty())
+    return 0;
+  return GetBucketStart(finest, finest.first_index);
+}
+
+int64 VolumeHistogram::end_time() const {
+  const Level& finest = levels_.front();
+  if (finest.buckets.empty())
+    return 0;
+  return GetBucketStart(finest, finest.first_index + finest.buckets.size());
+}
+
+void VolumeHistogram::GetBuckets(int64 start,
+                                 int64 end,
+                                 size_t num_buckets,
+                                 std::vector<Bucket>* buckets) const {
+  DCHECK(buckets != NULL);
+  buckets->assign(num_buckets, Bucket());
+  if (num_buckets == 0 || end <= start || empty())
+    return;
+
+  double bucket_width = static_cast<double>(end - start) / num_buckets;
+  size_t fit = 0;
+  while (fit + 1 < levels_.size() && levels_[fit + 1].width <= bucket_width)
+    ++fit;
+  const Level& level = levels_[fit];
+  int64 first = level.first_index;
+  int64 last = first + static_cast<int64>(level.buckets.size()) - 1;
+
+  if (level.width > bucket_width) {
+    for (size_t i = 0; i < num_buckets; ++i) {
+      int64 time = start + static_cast<int64>(i * bucket_width);
+      int64 index = FloorDiv(time - origin_, level.width);
+      if (index >= first && index <= last)
+        (*buckets)[i] = level.buckets[static_cast<size_t>(index - first)];
+    }
+    return;
+  }
+
+  // The level's buckets are no wider than ours, so there are at most
+  // kFanout of them to each of ours, but at the coarsest level, which
+  // is bound by kMaxBuckets.
+  int64 begin_index = std::max(first, FloorDiv(start - origin_, level.width));
+  int64 end_index = std::min(last, FloorDiv(end - 1 - origin_, level.width));
+  for (int64 index = begin_index; index <= end_index; ++index) {
+    int64 offset = GetBucketStart(level, index) - start;
+    size_t i = 0;
+    if (offset > 0) {
+      i = std::min(num_buckets - 1,
+                   static_cast<size_t>(offset / bucket_width));
+    }
+
+    const Bucket& bucket = level.buckets[static_cast<size_t>(index - first)];
+    for (int severity = 0; severity < NUM_SEVERITIES; ++severity)
+      (*buckets)[i].counts[severity] += bucket.counts[severity];
+  }
+}
+
+VolumeHistogram::Severity VolumeHistogram::GetSeverity(UCHAR level) {
+  switch (level) {
+    case TRACE_LEVEL_FATAL:
+    case TRACE_LEVEL_ERROR:
+      return SEVERITY_ERROR;
+    case TRACE_LEVEL_WARNING:
+      return SEVERITY_WARNING;
+    case TRACE_LEVEL_NONE:
+    case TRACE_LEVEL_INFORMATION:
+      return SEVERITY_INFO;
+    default:
+      return SEVERITY_VERBOSE;
+  }
+}
+
+size_t VolumeHistogram::GetMemoryUsage() const {
+  size_t usage = 0;
+  for (size_t i = 0; i < levels_.size(); ++i)
+    usage += levels_[i].buckets.size() * sizeof(Bucket);
+  return usage;
+}
+
+int64 VolumeHistogram::GetIndex(const Level& level, int64 time) const {
+  int64 index = FloorDiv(time - origin_, level.width);
+  if (&level != &levels_.back() || level.buckets.empty())
+    return index;
+
+  int64 max_span = static_cast<int64>(kMaxBuckets) - 1;
+  int64 last = level.first_index +
+      static_cast<int64>(level.buckets.size()) - 1;
+  index = std::max(index, last - max_span);
+  return std::min(index, level.first_index + max_span);
+}
+
+int64 VolumeHistogram::GetBucketStart(const Level& level,
+                                      int64 index) const {
+  return origin_ + index * level.width;
+}
+
+void VolumeHistogram::Trim(Level* level) {
+  DCHECK(level != NULL);
+  std::deque<Bucket>& buckets = level->buckets;
+  while (!buckets.empty() && buckets.front().total() == 0) {
+    buckets.pop_front();
+    ++level->first_index;
+  }
+  while (!buckets.empty() && buckets.back().total() == 0)
+    buckets.pop_back();
+}
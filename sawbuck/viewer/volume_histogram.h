@@ -0,0 +1,136 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event volume histogram declaration.
+#ifndef SAWBUCK_VIEWER_VOLUME_HISTOGRAM_H_
+#define SAWBUCK_VIEWER_VOLUME_HISTOGRAM_H_
+
+#include <windows.h>
+#include <deque>
+#include <vector>
+#include "base/basictypes.h"
+
+// Counts rows by time and severity at several resolutions, as a pyramid
+// of levels of time buckets, each level kFanout times coarser than the
+// one below it. Adding or removing a row touches one bucket per level, so
+// it takes constant time, and reading the volume across a time range
+// sums a bounded number of buckets of the level that best fits the range,
+// so it costs no more for an hour of rows than for a second of them.
+//
+// The levels span the rows' times, less the empty buckets at either end.
+// A level that would span more than kMaxBuckets is dropped, leaving the
+// coarser ones, and the coarsest one counts the rows past its extent in
+// the bucket at its edge, so bogus times cost neither memory nor time.
+// @note a histogram takes no lock, its store counts and evicts rows and
+//     the list view reads the volume on the UI thread alike.
+class VolumeHistogram {
+ public:
+  // The severities counted, from the log levels.
+  enum Severity {
+    SEVERITY_ERROR,
+    SEVERITY_WARNING,
+    SEVERITY_INFO,
+    SEVERITY_VERBOSE,
+    NUM_SEVERITIES,
+  };
+
+  // The row counts of a time bucket.
+  struct Bucket {
+    Bucket();
+
+    // @returns the rows of all severities.
+    uint32 total() const;
+
+    uint32 counts[NUM_SEVERITIES];
+  };
+
+  // The width of the finest buckets in internal time units, or 100 ms.
+  static const int64 kFinestWidth = 100 * 1000;
+  // The ratio of the widths of the buckets of successive levels.
+  static const int kFanout = 4;
+  // The number of levels, the coarsest buckets are some 27 minutes wide.
+  static const size_t kNumLevels = 8;
+  // The most buckets a level spans.
+  static const size_t kMaxBuckets = 64 * 1024;
+
+  VolumeHistogram();
+  ~VolumeHistogram();
+
+  // Counts a row of log @p level at @p time, an internal time value.
+  void Add(int64 time, UCHAR level);
+  // Uncounts a row counted by Add.
+  void Remove(int64 time, UCHAR level);
+
+  // Removes all rows and restores all levels.
+  void Clear();
+
+  // @returns true iff no rows are counted.
+  bool empty() const;
+
+  // @returns the start of the first bucket and the end of the last bucket
+  //     counting rows, or zero if empty.
+  // @{
+  int64 start_time() const;
+  int64 end_time() const;
+  // @}
+
+  // Sums the rows from @p start to @p end into @p num_buckets buckets of
+  // equal width, from the coarsest level whose buckets are no wider than
+  // those. Where even the finest level's are wider, each bucket gets the
+  // counts of the finest bucket its start falls in.
+  // @param buckets on return holds @p num_buckets buckets.
+  void GetBuckets(int64 start,
+                  int64 end,
+                  size_t num_buckets,
+                  std::vector<Bucket>* buckets) const;
+
+  // @returns the severity of rows of log @p level.
+  static Severity GetSeverity(UCHAR level);
+
+  // @returns an estimate of the heap memory used by the histogram.
+  size_t GetMemoryUsage() const;
+
+ private:
+  struct Level {
+    Level() : width(0), first_index(0) {
+    }
+
+    // The width of the buckets.
+    int64 width;
+    // The index of the first bucket, bucket i starts at
+    // origin_ + i * width.
+    int64 first_index;
+    std::deque<Bucket> buckets;
+  };
+
+  // @returns the index of the bucket of @p level that @p time falls in,
+  //     clamped to the extent of the coarsest level.
+  int64 GetIndex(const Level& level, int64 time) const;
+
+  // @returns the start time of bucket @p index of @p level.
+  int64 GetBucketStart(const Level& level, int64 index) const;
+
+  // Drops the empty buckets at either end of @p level.
+  static void Trim(Level* level);
+
+  // The levels from the finest retained to the coarsest.
+  std::deque<Level> levels_;
+  // The time all levels' buckets align to, set by the first row.
+  int64 origin_;
+  size_t num_rows_;
+
+  DISALLOW_COPY_AND_ASSIGN(VolumeHistogram);
+};
+
+#endif  // SAWBUCK_VIEWER_VOLUME_HISTOGRAM_H_
@@ -0,0 +1,141 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Event volume histogram unittests.
+#include "sawbuck/viewer/volume_histogram.h"
+
+#include <evntrace.h>
+#include <vector>
+#include "gtest/gtest.h"
+
+namespace {
+
+const int64 kSecond = 1000 * 1000;
+// The width of the coarsest buckets, and a start aligned to them so that
+// the buckets of all levels align to the buckets asked for.
+const int64 kCoarsestWidth = VolumeHistogram::kFinestWidth * 16384;
+const int64 kStart = 1000 * kCoarsestWidth;
+
+typedef std::vector<VolumeHistogram::Bucket> Buckets;
+
+uint32 CountAll(const Buckets& buckets, VolumeHistogram::Severity severity) {
+  uint32 count = 0;
+  for (size_t i = 0; i < buckets.size(); ++i)
+    count += buckets[i].counts[severity];
+  return count;
+}
+
+TEST(VolumeHistogramTest, CountsBySeverity) {
+  VolumeHistogram histogram;
+  EXPECT_TRUE(histogram.empty());
+
+  // A second of rows, every tenth an error.
+  for (int i = 0; i < 1000; ++i) {
+    histogram.Add(kStart + i * 1000,
+                  i % 10 == 0 ? TRACE_LEVEL_ERROR : TRACE_LEVEL_INFORMATION);
+  }
+  ASSERT_FALSE(histogram.empty());
+  EXPECT_LE(histogram.start_time(), kStart);
+  EXPECT_GE(histogram.end_time(), kStart + kSecond);
+
+  Buckets buckets;
+  histogram.GetBuckets(kStart, kStart + kSecond, 10, &buckets);
+  ASSERT_EQ(10U, buckets.size());
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    EXPECT_EQ(100U, buckets[i].total());
+    EXPECT_EQ(10U, buckets[i].counts[VolumeHistogram::SEVERITY_ERROR]);
+  }
+
+  // Coarser buckets sum the finer ones.
+  histogram.GetBuckets(kStart, kStart + kSecond, 1, &buckets);
+  ASSERT_EQ(1U, buckets.size());
+  EXPECT_EQ(1000U, buckets[0].total());
+  EXPECT_EQ(900U, buckets[0].counts[VolumeHistogram::SEVERITY_INFO]);
+}
+
+TEST(VolumeHistogramTest, SumsAcrossLongRanges) {
+  VolumeHistogram histogram;
+
+  // A row a second for an hour, and a warning a minute.
+  const int kSeconds = 3600;
+  for (int i = 0; i < kSeconds; ++i) {
+    histogram.Add(kStart + i * kSecond,
+                  i % 60 == 0 ? TRACE_LEVEL_WARNING : TRACE_LEVEL_VERBOSE);
+  }
+
+  Buckets buckets;
+  histogram.GetBuckets(histogram.start_time(), histogram.end_time(), 600,
+                       &buckets);
+  EXPECT_EQ(60U, CountAll(buckets, VolumeHistogram::SEVERITY_WARNING));
+  EXPECT_EQ(kSeconds - 60U,
+            CountAll(buckets, VolumeHistogram::SEVERITY_VERBOSE));
+}
+
+TEST(VolumeHistogramTest, RemoveTrims) {
+  VolumeHistogram histogram;
+  const int64 kInterval = 400 * 1000;
+  for (int i = 0; i < 128; ++i)
+    histogram.Add(kStart + i * kInterval, TRACE_LEVEL_INFORMATION);
+
+  // Removing the oldest half moves the start up.
+  for (int i = 0; i < 64; ++i)
+    histogram.Remove(kStart + i * kInterval, TRACE_LEVEL_INFORMATION);
+  EXPECT_EQ(kStart + 64 * kInterval, histogram.start_time());
+
+  Buckets buckets;
+  histogram.GetBuckets(kStart, kStart + 128 * kInterval, 4, &buckets);
+  EXPECT_EQ(0U, buckets[0].total());
+  EXPECT_EQ(0U, buckets[1].total());
+  EXPECT_EQ(32U, buckets[2].total());
+  EXPECT_EQ(32U, buckets[3].total());
+
+  for (int i = 64; i < 128; ++i)
+    histogram.Remove(kStart + i * kInterval, TRACE_LEVEL_INFORMATION);
+  EXPECT_TRUE(histogram.empty());
+  EXPECT_EQ(0, histogram.start_time());
+}
+
+TEST(VolumeHistogramTest, OutOfOrderRows) {
+  VolumeHistogram histogram;
+  histogram.Add(kStart + 30 * kSecond, TRACE_LEVEL_ERROR);
+  histogram.Add(kStart, TRACE_LEVEL_WARNING);
+  EXPECT_EQ(kStart, histogram.start_time());
+
+  Buckets buckets;
+  histogram.GetBuckets(kStart, kStart + kCoarsestWidth / 32, 2, &buckets);
+  EXPECT_EQ(1U, buckets[0].counts[VolumeHistogram::SEVERITY_WARNING]);
+  EXPECT_EQ(1U, buckets[1].counts[VolumeHistogram::SEVERITY_ERROR]);
+}
+
+TEST(VolumeHistogramTest, BogusTimesAreBounded) {
+  VolumeHistogram histogram;
+  histogram.Add(kStart, TRACE_LEVEL_INFORMATION);
+  // Rows decades apart drop the finer levels, and the memory stays bound.
+  histogram.Add(kStart + 100LL * 365 * 24 * 3600 * kSecond,
+                TRACE_LEVEL_INFORMATION);
+  histogram.Add(kStart + kSecond, TRACE_LEVEL_INFORMATION);
+  EXPECT_GE(VolumeHistogram::kNumLevels * VolumeHistogram::kMaxBuckets *
+                sizeof(VolumeHistogram::Bucket),
+            histogram.GetMemoryUsage());
+
+  Buckets buckets;
+  histogram.GetBuckets(histogram.start_time(), histogram.end_time(), 100,
+                       &buckets);
+  EXPECT_EQ(3U, CountAll(buckets, VolumeHistogram::SEVERITY_INFO));
+
+  histogram.Clear();
+  EXPECT_TRUE(histogram.empty());
+}
+
+}  // namespace
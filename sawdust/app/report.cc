@@ -17,16 +17,36 @@
 
 #include <istream>  // NOLINT - streams used as abstracts, without formatting.
 #include <fstream>  // NOLINT
+#include <set>
+#include <sstream>  // NOLINT
+#include <vector>
 #include "base/file_path.h"
 #include "base/file_util.h"
 #include "base/logging.h"
 #include "base/scoped_ptr.h"
+#include "base/stringprintf.h"
+#include "sawdust/tracer/com_utils.h"
+#include "sawdust/tracer/log_summarizer.h"
+#include "sawdust/tracer/log_trimmer.h"
+#include "sawdust/tracer/mapped_file_reader.h"
 
 namespace {
 
 const char kChromeUploadTitle[] = "Application.etl";
 const char kKernelUploadTitle[] = "Kernel.etl";
+const char kChromeSegmentTitleFmt[] = "Application%d.etl";
+const char kKernelSegmentTitleFmt[] = "Kernel%d.etl";
+const char kSnapshotUploadTitleFmt[] = "Snapshot%d.etl";
+const char kTrimmedChromeUploadTitle[] = "Application.bin";
+const char kTrimmedSnapshotUploadTitleFmt[] = "Snapshot%d.bin";
+const wchar_t kTrimmedExtension[] = L"bin";
+const wchar_t kRegistryStampFile[] = L"registry_extract.stamp";
+const char kSnapshotIndexTitle[] = "Snapshots.txt";
+const char kSummaryTitle[] = "Summary.json";
 
+// Serves a file in views of a mapping, which go to the compressor without
+// a copy or a read call per buffer. A file that can't be mapped is served
+// through a stream instead.
 class FileEntry : public ReportContent::ReportEntryWithInit {
  public:
   FileEntry(const FilePath& file, const char * title)
@@ -34,6 +54,7 @@ class FileEntry : public ReportContent::ReportEntryWithInit {
   }
 
   ~FileEntry() {
+    reader_.Close();
     if (stream_.is_open())
       stream_.close();
     if (marked_ok_ && file_util::PathExists(file_path_))
@@ -42,25 +63,230 @@ class FileEntry : public ReportContent::ReportEntryWithInit {
 
   // Initialization simply means: open the file.
   HRESULT Initialize() {
-    stream_.open(file_path_.value().c_str(),
-                 std::ios_base::in | std::ios_base::binary);
+    HRESULT hr = reader_.Open(file_path_);
+    if (SUCCEEDED(hr))
+      return S_OK;
+
+    LOG(WARNING) << "Unable to map " << file_path_.value() << ". " <<
+        com::LogHr(hr);
+    OpenStream();
     return stream_.bad() ? E_ACCESSDENIED : S_OK;
   }
 
-  std::istream& Data() { return stream_; }  // Override (IReportContentEntry).
+  // Override (IReportContentEntry).
+  std::istream& Data() {
+    OpenStream();
+    return stream_;
+  }
+
+  HRESULT NextBlock(const char** data, size_t* size) {
+    if (!reader_.is_open())
+      return E_NOTIMPL;
+    return reader_.NextView(data, size);
+  }
+
   const char* Title() const { return public_title_.c_str(); }
 
   void MarkCompleted() {
+    reader_.Close();
     marked_ok_ = true;
   }
 
  private:
+  void OpenStream() {
+    if (!stream_.is_open()) {
+      stream_.open(file_path_.value().c_str(),
+                   std::ios_base::in | std::ios_base::binary);
+    }
+  }
+
+  MappedFileReader reader_;
   std::ifstream stream_;
   FilePath file_path_;
   std::string public_title_;
   bool marked_ok_;
 };
 
+// Serves a log deflated ahead of time, which goes into the archive as it is.
+// The deflated file goes away once the entry is completed.
+class PrecompressedEntry : public ReportContent::ReportEntryWithInit {
+ public:
+  PrecompressedEntry(const PrecompressedSegment& segment, const char* title)
+      : segment_(segment), public_title_(title), marked_ok_(false) {
+  }
+
+  ~PrecompressedEntry() {
+    if (marked_ok_ && file_util::PathExists(segment_.path))
+      file_util::Delete(segment_.path, false);
+  }
+
+  HRESULT Initialize() {
+    return file_util::PathExists(segment_.path) ? S_OK : E_ACCESSDENIED;
+  }
+
+  // The uploader takes the segment rather than the stream, which would be
+  // the deflated data.
+  std::istream& Data() {
+    NOTREACHED() << "A precompressed entry has no stream.";
+    stream_.setstate(std::ios_base::badbit);
+    return stream_;
+  }
+
+  bool GetPrecompressedSegment(PrecompressedSegment* segment) {
+    *segment = segment_;
+    return true;
+  }
+
+  const char* Title() const { return public_title_.c_str(); }
+
+  void MarkCompleted() { marked_ok_ = true; }
+
+ private:
+  PrecompressedSegment segment_;
+  std::string public_title_;
+  std::stringstream stream_;
+  bool marked_ok_;
+};
+
+// Uploads a log trimmed down by |trimmer| in place of the log itself, which
+// still goes as it is if trimming fails. Either way both files go away once
+// the entry is completed.
+class TrimmedFileEntry : public ReportContent::ReportEntryWithInit {
+ public:
+  TrimmedFileEntry(const FilePath& file, const char* title,
+                   const char* trimmed_title, LogTrimmer* trimmer)
+      : file_path_(file), public_title_(title),
+        trimmed_title_(trimmed_title), trimmer_(trimmer), marked_ok_(false) {
+    DCHECK(trimmer != NULL);
+  }
+
+  ~TrimmedFileEntry() {
+    file_entry_.reset();
+    if (marked_ok_ && file_util::PathExists(file_path_))
+      file_util::Delete(file_path_, false);
+  }
+
+  HRESULT Initialize() {
+    FilePath trimmed_path(file_path_.ReplaceExtension(kTrimmedExtension));
+    HRESULT hr = trimmer_->Trim(file_path_, trimmed_path);
+    if (SUCCEEDED(hr)) {
+      VLOG(1) << "Trimmed " << file_path_.value() << " to " <<
+          trimmer_->kept_event_count() << " events, dropped " <<
+          trimmer_->dropped_event_count() << ".";
+      file_entry_.reset(new FileEntry(trimmed_path, trimmed_title_.c_str()));
+    } else {
+      // Better to upload the log as it is than nothing at all.
+      LOG(ERROR) << "Failed to trim " << file_path_.value() << ". " <<
+          com::LogHr(hr);
+      file_entry_.reset(new FileEntry(file_path_, public_title_.c_str()));
+    }
+    return file_entry_->Initialize();
+  }
+
+  std::istream& Data() { return file_entry_->Data(); }
+  HRESULT NextBlock(const char** data, size_t* size) {
+    return file_entry_->NextBlock(data, size);
+  }
+  const char* Title() const { return file_entry_->Title(); }
+
+  void MarkCompleted() {
+    file_entry_->MarkCompleted();
+    marked_ok_ = true;
+  }
+
+ private:
+  FilePath file_path_;
+  std::string public_title_;
+  std::string trimmed_title_;
+  scoped_ptr<LogTrimmer> trimmer_;
+  scoped_ptr<FileEntry> file_entry_;
+  bool marked_ok_;
+};
+
+// Makes a trimmer for |trim|, keeping the events from |from| until |to|.
+LogTrimmer* CreateTrimmer(const TracerConfiguration::TrimSettings& trim,
+                          base::Time from, base::Time to) {
+  LogTrimmer* trimmer = new LogTrimmer();
+  trimmer->set_max_level(trim.level);
+  trimmer->set_process_ids(std::set<DWORD>(trim.process_ids.begin(),
+                                           trim.process_ids.end()));
+  trimmer->set_time_window(from, to);
+  return trimmer;
+}
+
+// Tells what fired each snapshot, and when. The snapshots are named after
+// |title_format|.
+class SnapshotIndexEntry : public ReportContent::ReportEntryWithInit {
+ public:
+  SnapshotIndexEntry(const TracerController::Snapshots& snapshots,
+                     const char* title_format)
+      : snapshots_(snapshots), title_format_(title_format) {
+    DCHECK(!snapshots.empty());
+  }
+
+  HRESULT Initialize() {
+    for (size_t i = 0; i < snapshots_.size(); ++i) {
+      const TracerController::Snapshot& snapshot = snapshots_[i];
+      base::Time::Exploded time;
+      snapshot.time.UTCExplode(&time);
+      stream_ << base::StringPrintf(title_format_.c_str(),
+                                    static_cast<int>(i + 1)) <<
+          base::StringPrintf(": %04d-%02d-%02d %02d:%02d:%02d.%03d UTC, ",
+                             time.year, time.month, time.day_of_month,
+                             time.hour, time.minute, time.second,
+                             time.millisecond) <<
+          "last " << snapshot.window.InSeconds() << " s. " <<
+          snapshot.reason << std::endl;
+    }
+    return S_OK;
+  }
+
+  std::istream& Data() { return stream_; }
+  const char* Title() const { return kSnapshotIndexTitle; }
+
+  void MarkCompleted() {
+  }
+
+ private:
+  TracerController::Snapshots snapshots_;
+  std::string title_format_;
+  std::stringstream stream_;
+};
+
+// Summarizes logs in a pass over each, leaving them be.
+class SummaryEntry : public ReportContent::ReportEntryWithInit {
+ public:
+  explicit SummaryEntry(const std::vector<FilePath>& log_paths)
+      : log_paths_(log_paths) {
+  }
+
+  // A log that can't be read is left out of the summary, which then says
+  // what it can about the others.
+  HRESULT Initialize() {
+    LogSummarizer summarizer;
+    for (size_t i = 0; i < log_paths_.size(); ++i) {
+      HRESULT hr = summarizer.AddLog(log_paths_[i]);
+      LOG_IF(ERROR, FAILED(hr)) << "Failed to summarize " <<
+          log_paths_[i].value() << ". " << com::LogHr(hr);
+    }
+
+    std::string json;
+    summarizer.WriteJson(&json);
+    stream_.str(json);
+    return S_OK;
+  }
+
+  std::istream& Data() { return stream_; }
+  const char* Title() const { return kSummaryTitle; }
+
+  void MarkCompleted() {
+  }
+
+ private:
+  std::vector<FilePath> log_paths_;
+  std::stringstream stream_;
+};
+
 class RegistryEntry : public ReportContent::ReportEntryWithInit {
  public:
   explicit RegistryEntry(const std::vector<std::wstring>& all_entries,
@@ -75,6 +301,9 @@ class RegistryEntry : public ReportContent::ReportEntryWithInit {
   }
 
   std::istream& Data() { return reg_data_proc_->Data(); }
+  HRESULT NextBlock(const char** data, size_t* size) {
+    return reg_data_proc_->NextBlock(data, size);
+  }
   const char* Title() const { return reg_data_proc_->Title(); }
 
   void MarkCompleted() {
@@ -88,14 +317,20 @@ class RegistryEntry : public ReportContent::ReportEntryWithInit {
 
 class BaseSystemInfoEntry : public ReportContent::ReportEntryWithInit {
  public:
-  explicit BaseSystemInfoEntry(const TracerConfiguration& config,
-                               SystemInfoExtractor* extractor_instance)
+  BaseSystemInfoEntry(const TracerConfiguration& config,
+                      SystemInfoExtractor* extractor_instance,
+                      SystemInfoCache* cache)
       : harvest_env_vars_(config.HarvestEnvVariables()),
-        info_extractor_(extractor_instance)  {
+        info_extractor_(extractor_instance),
+        cache_(cache) {
   }
 
   HRESULT Initialize() {
-    info_extractor_->Initialize(harvest_env_vars_);
+    std::string snapshot;
+    if (cache_ != NULL && cache_->GetSnapshot(&snapshot))
+      info_extractor_->InitializeFromSnapshot(snapshot);
+    else
+      info_extractor_->Initialize(harvest_env_vars_);
     return S_OK;
   }
 
@@ -109,6 +344,7 @@ class BaseSystemInfoEntry : public ReportContent::ReportEntryWithInit {
  private:
   scoped_ptr<SystemInfoExtractor> info_extractor_;
   bool harvest_env_vars_;
+  SystemInfoCache* cache_;  // Not owned, may be NULL.
 };
 
 }  // namespace
@@ -120,6 +356,14 @@ ReportContent::~ReportContent() {
   }
 }
 
+void ReportContent::AddPrecompressedLog(const PrecompressedSegment& segment,
+                                        bool kernel) {
+  std::string title = kernel ?
+      base::StringPrintf(kKernelSegmentTitleFmt, ++kernel_segment_count_) :
+      base::StringPrintf(kChromeSegmentTitleFmt, ++chrome_segment_count_);
+  entry_queue_.push_back(new PrecompressedEntry(segment, title.c_str()));
+}
+
 HRESULT ReportContent::Initialize(const TracerController& controller,
                                   const TracerConfiguration& config) {
   FilePath source_file_path;
@@ -128,7 +372,22 @@ HRESULT ReportContent::Initialize(const TracerController& controller,
     LOG(ERROR) << "No data to upload. Weird.";
     return E_FAIL;
   }
-  entry_queue_.push_back(new FileEntry(source_file_path, kChromeUploadTitle));
+  // The kernel log isn't trimmed, as the trimmer only knows the events of
+  // the application log.
+  TracerConfiguration::TrimSettings trim;
+  bool trim_logs = config.GetTrimSettings(&trim);
+  if (trim_logs) {
+    base::Time from;
+    if (trim.window_minutes > 0)
+      from = base::Time::Now() -
+          base::TimeDelta::FromMinutes(trim.window_minutes);
+    entry_queue_.push_back(new TrimmedFileEntry(source_file_path,
+        kChromeUploadTitle, kTrimmedChromeUploadTitle,
+        CreateTrimmer(trim, from, base::Time())));
+  } else {
+    entry_queue_.push_back(new FileEntry(source_file_path,
+                                         kChromeUploadTitle));
+  }
 
   if (config.IsKernelLoggingEnabled()) {
     if (controller.GetCompletedKernelEventLogFileName(&source_file_path)) {
@@ -141,18 +400,70 @@ HRESULT ReportContent::Initialize(const TracerController& controller,
     }
   }
 
+  // The snapshots are numbered in the order they were taken. Trimmed, each
+  // keeps only the window that led up to its trigger.
+  TracerController::Snapshots snapshots;
+  controller.GetSnapshots(&snapshots);
+  for (size_t i = 0; i < snapshots.size(); ++i) {
+    const TracerController::Snapshot& snapshot = snapshots[i];
+    std::string title = base::StringPrintf(kSnapshotUploadTitleFmt,
+                                           static_cast<int>(i + 1));
+    if (trim_logs) {
+      std::string trimmed_title = base::StringPrintf(
+          kTrimmedSnapshotUploadTitleFmt, static_cast<int>(i + 1));
+      entry_queue_.push_back(new TrimmedFileEntry(snapshot.log_path,
+          title.c_str(), trimmed_title.c_str(),
+          CreateTrimmer(trim, snapshot.time - snapshot.window,
+                        snapshot.time)));
+    } else {
+      entry_queue_.push_back(new FileEntry(snapshot.log_path, title.c_str()));
+    }
+  }
+  if (!snapshots.empty()) {
+    entry_queue_.push_back(new SnapshotIndexEntry(snapshots,
+        trim_logs ? kTrimmedSnapshotUploadTitleFmt : kSnapshotUploadTitleFmt));
+  }
+
   std::vector<std::wstring> registry_keys;
   if (config.GetRegistryQuery(&registry_keys) && !registry_keys.empty()) {
-    entry_queue_.push_back(new RegistryEntry(registry_keys,
-                                             CreateRegistryExtractor()));
+    // An incremental extract keeps its stamp next to the logs.
+    RegistryExtractor* extractor = CreateRegistryExtractor();
+    FilePath log_path;
+    if (config.HarvestRegistryIncrementally() &&
+        config.GetLogFileName(&log_path)) {
+      extractor->set_stamp_path(log_path.DirName().Append(kRegistryStampFile));
+    }
+    entry_queue_.push_back(new RegistryEntry(registry_keys, extractor));
   }
 
   entry_queue_.push_back(new BaseSystemInfoEntry(config,
-                                                 CreateInfoExtractor()));
+                                                 CreateInfoExtractor(),
+                                                 system_info_cache_));
 
   return S_OK;
 }
 
+HRESULT ReportContent::InitializeSummary(const TracerController& controller,
+                                         const TracerConfiguration& config) {
+  std::vector<FilePath> log_paths;
+  FilePath log_path;
+  if (!controller.GetCompletedEventLogFileName(&log_path)) {
+    LOG(ERROR) << "No data to summarize.";
+    return E_FAIL;
+  }
+  log_paths.push_back(log_path);
+  if (config.IsKernelLoggingEnabled() &&
+      controller.GetCompletedKernelEventLogFileName(&log_path)) {
+    log_paths.push_back(log_path);
+  }
+
+  entry_queue_.push_back(new SummaryEntry(log_paths));
+  entry_queue_.push_back(new BaseSystemInfoEntry(config,
+                                                 CreateInfoExtractor(),
+                                                 system_info_cache_));
+  return S_OK;
+}
+
 HRESULT ReportContent::GetNextEntry(IReportContentEntry** entry) {
   DCHECK(entry != NULL);
   HRESULT hr = S_OK;
@@ -22,6 +22,7 @@
 
 #include "sawdust/tracer/configuration.h"
 #include "sawdust/tracer/controller.h"
+#include "sawdust/tracer/precompressed_segment.h"
 #include "sawdust/tracer/registry.h"
 #include "sawdust/tracer/system_info.h"
 #include "sawdust/tracer/upload.h"
@@ -31,14 +32,36 @@
 // registry extraction if declared so in configuration.
 class ReportContent : public IReportContent {
  public:
-  ReportContent() {}
+  ReportContent()
+      : system_info_cache_(NULL), chrome_segment_count_(0),
+        kernel_segment_count_(0) {
+  }
   ~ReportContent();
 
+  // System information will come from |cache| when set, instead of being
+  // collected while the report is put together. Call before Initialize.
+  void set_system_info_cache(SystemInfoCache* cache) {
+    system_info_cache_ = cache;
+  }
+
+  // Adds |segment|, a log sealed by a rotation before the last and deflated
+  // since, to go ahead of the logs of the controller as a kernel log if
+  // |kernel|, or an application log. Segments are numbered in the order
+  // they are added, so add the oldest first. The deflated file goes away
+  // once it is uploaded. Call before Initialize.
+  void AddPrecompressedLog(const PrecompressedSegment& segment, bool kernel);
+
   // Creates all required wrappers and extractors, as defined by |config|. Log
   // files will be dug out from |controller|.
   HRESULT Initialize(const TracerController& controller,
                      const TracerConfiguration& config);
 
+  // Creates the entries of a report summarizing the logs of |controller|
+  // instead of carrying them, along with the system information. The logs
+  // stay on the disk, for a full report to take should the server ask.
+  HRESULT InitializeSummary(const TracerController& controller,
+                            const TracerConfiguration& config);
+
   HRESULT GetNextEntry(IReportContentEntry** entry);
 
 
@@ -60,6 +83,9 @@ class ReportContent : public IReportContent {
   typedef std::list<ReportEntryWithInit*> ReportEntryContainer;
   ReportEntryContainer entry_queue_;
   scoped_ptr<ReportEntryWithInit> current_entry_;
+  SystemInfoCache* system_info_cache_;  // Not owned, may be NULL.
+  int chrome_segment_count_;
+  int kernel_segment_count_;
 };
 
 #endif  // SAWDUST_APP_REPORT_H_
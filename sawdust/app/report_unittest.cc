@@ -44,6 +44,7 @@ class MockTracerConfiguration : public TracerConfiguration {
  public:
   MOCK_CONST_METHOD0(IsKernelLoggingEnabled, bool());
   MOCK_CONST_METHOD1(GetRegistryQuery, bool(std::vector<std::wstring>*));
+  MOCK_CONST_METHOD1(GetTrimSettings, bool(TrimSettings*));
 };
 
 
@@ -63,6 +64,7 @@ class MockRegistryExtractor : public RegistryExtractor {
     return input_container.size();
   }
   std::istream& Data() { return mock_data_as_stream_; }
+  HRESULT NextBlock(const char** data, size_t* size) { return E_NOTIMPL; }
   void MarkCompleted() { mock_data_as_stream_.seekg(0); }
 
   const char* Title() const { return "FakeRegistryExtract.txt"; }
@@ -197,4 +199,30 @@ TEST_F(ReportContentTest, PartialReportDump) {
   ASSERT_EQ(entry_counter, 2);
 }
 
+TEST_F(ReportContentTest, UntrimmableLogGoesAsItIs) {
+  MockTracerInfoFunctions mock_controller;
+  MockTracerConfiguration mock_config;
+
+  EXPECT_CALL(mock_controller, GetCompletedEventLogFileName(_)).
+      WillOnce(DoAll(SetArgumentPointee<0>(app_fake_file_), Return(true)));
+  EXPECT_CALL(mock_config, IsKernelLoggingEnabled()).WillOnce(Return(false));
+  EXPECT_CALL(mock_config, GetRegistryQuery(_)).WillOnce(Return(false));
+  EXPECT_CALL(mock_config, GetTrimSettings(_)).WillOnce(Return(true));
+
+  TestingReportContent test_object;
+  ASSERT_HRESULT_SUCCEEDED(test_object.Initialize(mock_controller,
+                                                  mock_config));
+
+  // The fake log is no log at all, so there is nothing to trim it with.
+  IReportContentEntry* entry = NULL;
+  ASSERT_EQ(S_OK, test_object.GetNextEntry(&entry));
+  EXPECT_STREQ("Application.etl", entry->Title());
+  EXPECT_FALSE(file_util::PathExists(app_fake_file_.ReplaceExtension(L"bin")));
+
+  char buffer[15];
+  std::streamsize bytes_read =
+      entry->Data().read(buffer, sizeof(buffer)).gcount();
+  ASSERT_EQ(bytes_read, sizeof(buffer));
+}
+
 }  // namespace
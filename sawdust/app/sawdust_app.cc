@@ -25,7 +25,9 @@
 #include "base/stringprintf.h"
 #include "sawdust/app/sawdust_about.h"
 #include "sawdust/app/report.h"
+#include "sawdust/tracer/background_mode.h"
 #include "sawdust/tracer/com_utils.h"
+#include "third_party/zlib/zlib.h"
 
 #include "sawdust/app/resource.h"
 
@@ -53,12 +55,31 @@ const wchar_t kDefaultBaloonText[] = L"Sawdust has started and is now "
 const wchar_t kActivityLogFmt[] = L"%s\nLogging program activity "
     L"(started %d %s ago).";
 const wchar_t kActivityUploadFmt[] = L"%s\n%s to %s.";
+const wchar_t kActivityProgressFmt[] = L"%s\n%s, %.1f MB sent at %.0f KB/s, "
+    L"to %s.";
 const wchar_t kDoneUploadFmt[] = L"Log data has been %s to %s.%s";
 const wchar_t kUploadFailureFmt[] = L"The program encountered an error while "
     L"trying to %s data to %s.%s";
 const wchar_t kLoggingRestarts[] = L"\nLoging will now restart";
 const wchar_t kUploadRetry[] = L"\nRetrying...";
 const unsigned int kTooltipUpdateElapse = 15000;  // Every 15 seconds.
+// The logs are sealed and deflated ahead of an upload once the user has been
+// away this long.
+const DWORD kIdlePrecompressionMs = 5 * 60 * 1000;
+const wchar_t kDeflatedLogSuffix[] = L".deflate";
+// The server answers a summary with this when it wants the logs as well.
+const wchar_t kLogsWantedResponse[] = L"logs=wanted";
+
+// The deflate level |config| gives ETW logs, as the uploader would.
+int GetLogCompressionLevel(const TracerConfiguration& config) {
+  const TracerConfiguration::MapOfCompressionLevels& levels =
+      config.GetCompressionLevels();
+  TracerConfiguration::MapOfCompressionLevels::const_iterator it =
+      levels.find(".etl");
+  if (it == levels.end())
+    it = levels.find(TracerConfiguration::kDefaultCompressionKey);
+  return it != levels.end() ? it->second : Z_DEFAULT_COMPRESSION;
+}
 
 template<size_t N>
 bool LoadStringSafe(HINSTANCE instance, UINT id, wchar_t (&string)[N]) {
@@ -95,6 +116,27 @@ class SawdustApplication::UploadTask : public Task {
       return E_FAIL;
     }
     uploader_.reset(new ReportUploader(target_uri, !assume_remote));
+    uploader_->set_resumable(
+        the_app_->configuration_object_.IsUploadResumable());
+    uploader_->set_deduplicated(
+        the_app_->configuration_object_.IsUploadDeduplicated());
+    uploader_->set_background(
+        the_app_->configuration_object_.IsUploadInBackground());
+
+    // The throttle also counts what is sent, for the tooltip to show.
+    uint64 kbps = the_app_->configuration_object_.GetUploadBandwidthKbps();
+    the_app_->upload_throttle_.reset(new BandwidthThrottle(kbps * 1024));
+    uploader_->set_throttle(the_app_->upload_throttle_.get());
+
+    const TracerConfiguration::MapOfCompressionLevels& levels =
+        the_app_->configuration_object_.GetCompressionLevels();
+    for (TracerConfiguration::MapOfCompressionLevels::const_iterator it =
+             levels.begin(); it != levels.end(); ++it) {
+      if (it->first == TracerConfiguration::kDefaultCompressionKey)
+        uploader_->set_default_compression_level(it->second);
+      else
+        uploader_->set_compression_level(it->first, it->second);
+    }
     return S_OK;
   }
 
@@ -108,7 +150,27 @@ class SawdustApplication::UploadTask : public Task {
           NewRunnableMethod(the_app_, &OnGuiUpdateRequest,
                             UPDATE_TIP, DONT_SHOW_BALLOON, std::wstring()));
 
+      if (SummarySuffices()) {
+        // The server has what it wants. The deflated segments would only
+        // ride along with a later upload they don't belong to.
+        std::vector<PrecompressedLog>& logs = the_app_->precompressed_logs_;
+        for (size_t i = 0; i < logs.size(); ++i)
+          file_util::Delete(logs[i].segment.path, false);
+        logs.clear();
+        the_app_->main_message_loop_->PostTask(FROM_HERE,
+            NewRunnableMethod(the_app_, &OnGuiUpdateRequest,
+                              UPDATE_TIP, SHOW_BALLOON, std::wstring()));
+        FinishRun();
+        return;
+      }
+
       ReportContent content;
+      content.set_system_info_cache(&the_app_->system_info_cache_);
+      for (size_t i = 0; i < the_app_->precompressed_logs_.size(); ++i) {
+        const PrecompressedLog& log = the_app_->precompressed_logs_[i];
+        content.AddPrecompressedLog(log.segment, log.kernel);
+      }
+      the_app_->precompressed_logs_.clear();
       hr_ = content.Initialize(the_app_->controller_,
                                the_app_->configuration_object_);
       if (SUCCEEDED(hr_)) {
@@ -145,15 +207,7 @@ class SawdustApplication::UploadTask : public Task {
            "Not initialized properly." : "Already pending.");
       hr_ = E_UNEXPECTED;
     }
-
-    the_app_->upload_task_ = NULL;  // We won't need it there anymore.
-    // The above might be a race, but benign. upload_task_ is also used to
-    // enable / disable the menu command launching upload, but in conjunction
-    // controller_.IsProcessing which itself is synchronized.
-
-    if (close_task_ != NULL) {
-      the_app_->main_message_loop_->PostTask(FROM_HERE, close_task_.release());
-    }
+    FinishRun();
   }
 
   void FormErrorString(std::wstring* error_string, bool permit_retry) {
@@ -171,6 +225,49 @@ class SawdustApplication::UploadTask : public Task {
   }
 
  private:
+  // Uploads a summary of the logs ahead of them, when so configured.
+  // Returns true when the server has no use for the logs themselves. A
+  // summary that can't be made or sent is no reason to hold the logs back.
+  bool SummarySuffices() {
+    const TracerConfiguration& config = the_app_->configuration_object_;
+    std::wstring target_uri;
+    bool remote_target = false;
+    if (!config.IsSummaryFirst() ||
+        !config.GetUploadPath(&target_uri, &remote_target) || !remote_target)
+      return false;
+
+    target_uri += target_uri.find(L'?') == std::wstring::npos ?
+        L"?summary=1" : L"&summary=1";
+    ReportUploader summary_uploader(target_uri, false);
+    summary_uploader.set_keep_retry_archive(false);
+    summary_uploader.set_background(config.IsUploadInBackground());
+    summary_uploader.set_throttle(the_app_->upload_throttle_.get());
+
+    ReportContent summary;
+    summary.set_system_info_cache(&the_app_->system_info_cache_);
+    HRESULT hr = summary.InitializeSummary(the_app_->controller_, config);
+    if (SUCCEEDED(hr))
+      hr = summary_uploader.Upload(&summary);
+    if (FAILED(hr)) {
+      LOG(WARNING) << "The summary could not be uploaded, the logs go "
+          "without one. " << com::LogHr(hr);
+      return false;
+    }
+    return summary_uploader.server_response().find(kLogsWantedResponse) ==
+        std::wstring::npos;
+  }
+
+  void FinishRun() {
+    the_app_->upload_task_ = NULL;  // We won't need it there anymore.
+    // The above might be a race, but benign. upload_task_ is also used to
+    // enable / disable the menu command launching upload, but in conjunction
+    // controller_.IsProcessing which itself is synchronized.
+
+    if (close_task_ != NULL) {
+      the_app_->main_message_loop_->PostTask(FROM_HERE, close_task_.release());
+    }
+  }
+
   scoped_ptr<Task> close_task_;
   scoped_ptr<ReportUploader> uploader_;
   SawdustApplication* the_app_;
@@ -178,9 +275,67 @@ class SawdustApplication::UploadTask : public Task {
 };
 
 
+// Deflates the logs a rotation sealed, on the upload thread, in background
+// mode. The segments go to the next upload.
+class SawdustApplication::PrecompressTask : public Task {
+ public:
+  // Either log path may be empty, for none.
+  PrecompressTask(SawdustApplication* parent_object,
+                  const FilePath& chrome_log,
+                  const FilePath& kernel_log,
+                  int level)
+      : the_app_(parent_object), chrome_log_(chrome_log),
+        kernel_log_(kernel_log), level_(level) {
+    DCHECK(the_app_ != NULL);
+  }
+
+  void Run() {
+    ScopedBackgroundMode background_mode(true);
+    Precompress(chrome_log_, false);
+    Precompress(kernel_log_, true);
+    the_app_->main_message_loop_->PostTask(FROM_HERE,
+        NewRunnableMethod(the_app_, &OnPrecompressionDone));
+  }
+
+ private:
+  void Precompress(const FilePath& log_path, bool kernel) {
+    if (log_path.empty())
+      return;
+
+    // The sessions alternate between two files, so the deflated file of the
+    // rotation before last is written over.
+    FilePath deflated_path(log_path.value() + kDeflatedLogSuffix);
+    std::vector<PrecompressedLog>& logs = the_app_->precompressed_logs_;
+    for (size_t i = 0; i < logs.size(); ++i) {
+      if (logs[i].segment.path == deflated_path) {
+        logs.erase(logs.begin() + i);
+        break;
+      }
+    }
+
+    PrecompressedLog log;
+    log.kernel = kernel;
+    HRESULT hr = PrecompressSegment(log_path, deflated_path, level_,
+                                    &the_app_->abort_precompression_,
+                                    &log.segment);
+    if (SUCCEEDED(hr)) {
+      logs.push_back(log);
+      // The deflated file holds all of it now.
+      file_util::Delete(log_path, false);
+    }
+  }
+
+  SawdustApplication* the_app_;
+  FilePath chrome_log_;
+  FilePath kernel_log_;
+  int level_;
+};
+
 SawdustApplication::SawdustApplication(HINSTANCE instance)
   : tray_menu_(NULL), current_instance_(NULL), main_hwnd_(NULL),
-    upload_thread_(kUploadThreadId), exiting_(false), upload_task_(NULL) {
+    upload_thread_(kUploadThreadId), exiting_(false), upload_task_(NULL),
+    precompressing_(false), abort_precompression_(false),
+    logs_precompressed_(false), precompressed_input_time_(0) {
   current_instance_ = instance;
   ::memset(&icon_data_, 0, sizeof(icon_data_));
 }
@@ -257,6 +412,16 @@ LRESULT CALLBACK SawdustApplication::WndProc(HWND hwnd, UINT message,
       if (lparam == NULL && app != NULL &&
           reinterpret_cast<WPARAM>(app) == wparam) {
         app->OnTooltipUpdateRequest();
+        app->OnIdleCheck();
+      }
+      break;
+    }
+    case WM_SETTINGCHANGE: {
+      // Whatever changed (environment included) goes into the next report.
+      SawdustApplication* app = GetWindowData(hwnd);
+      if (app != NULL) {
+        app->system_info_cache_.Refresh(
+            app->configuration_object_.HarvestEnvVariables());
       }
       break;
     }
@@ -395,6 +560,9 @@ HRESULT SawdustApplication::Initialize(int cmd_show) {
   if (FAILED(hr))
     return hr;
 
+  // Get the system information ready before anyone asks for a report.
+  system_info_cache_.Refresh(configuration_object_.HarvestEnvVariables());
+
   main_message_loop_ = MessageLoop::current();
   DCHECK(NULL != main_message_loop_);
   hr = InitializeSysTrayApp(cmd_show);
@@ -442,21 +610,46 @@ void SawdustApplication::OrderlyShutdown(bool suppress_cleanup) {
         file_util::PathExists(file_to_remove)) {
       file_util::Delete(file_to_remove, false);
     }
+
+    TracerController::Snapshots snapshots;
+    controller_.GetSnapshots(&snapshots);
+    for (size_t i = 0; i < snapshots.size(); ++i) {
+      if (file_util::PathExists(snapshots[i].log_path))
+        file_util::Delete(snapshots[i].log_path, false);
+    }
   }
 
   // Upload thread should be empty by now. Stop it.
   DCHECK(upload_task_ == NULL);
+  abort_precompression_ = true;
   if (upload_thread_.IsRunning())
     upload_thread_.Stop();
 
+  // The logs deflated for an upload that never came are left over as well.
+  for (size_t i = 0; i < precompressed_logs_.size(); ++i) {
+    const FilePath& deflated_path = precompressed_logs_[i].segment.path;
+    if (!suppress_cleanup && file_util::PathExists(deflated_path))
+      file_util::Delete(deflated_path, false);
+  }
+  precompressed_logs_.clear();
+
   ::Shell_NotifyIcon(NIM_DELETE, &icon_data_);
   ::DestroyWindow(main_hwnd_);
 }
 
-// Response to the 'upload' menu command. We will stop the current logging
-// process and commence upload. Once the process has been completed, the logging
-// process shall be restarted.
+// Response to the 'upload' menu command. We will rotate the current logs out
+// and upload them while logging carries on in fresh files. Sessions that can't
+// be rotated are stopped instead, and restarted once the upload has been
+// completed. While logs sealed by the last rotation are being deflated, the
+// sessions are stopped too, as the next rotation would write over them.
 void SawdustApplication::OnUploadInvoked() {
+  if (upload_task_ == NULL && !precompressing_ &&
+      !controller_.IsFlightRecorder() && SUCCEEDED(controller_.Rotate())) {
+    // Nothing to restart, the sessions never stopped.
+    PostUploadTask(new UploadTask(NULL, this));
+    return;
+  }
+
   // Instance of upload task with re-start task to boot.
   InvokeUploadTask(new UploadTask(
       NewRunnableMethod(this, &SawdustApplication::StartLogging), this));
@@ -474,22 +667,76 @@ void SawdustApplication::InvokeUploadTask(UploadTask* task) {
       return;
     }
 
-    if (!upload_thread_.IsRunning()) {
-      base::Thread::Options start_options(MessageLoop::TYPE_IO, 0);
-      if (!upload_thread_.StartWithOptions(start_options)) {
-        NOTREACHED() << "Failed to start the upload thread!";
-      }
-    }
+    PostUploadTask(task);
+  }
+}
 
-    if SUCCEEDED(task->Initialize()) {
-      upload_task_ = task;
-      upload_thread_.message_loop()->PostTask(FROM_HERE, upload_task_);
-    } else {
-      NOTREACHED() << "Failed to initialize upload task. Will not start.";
+void SawdustApplication::PostUploadTask(UploadTask* task) {
+  DCHECK(upload_task_ == NULL);
+
+  StartUploadThread();
+  if SUCCEEDED(task->Initialize()) {
+    upload_task_ = task;
+    logs_precompressed_ = false;
+    upload_thread_.message_loop()->PostTask(FROM_HERE, upload_task_);
+  } else {
+    NOTREACHED() << "Failed to initialize upload task. Will not start.";
+  }
+}
+
+void SawdustApplication::StartUploadThread() {
+  if (!upload_thread_.IsRunning()) {
+    base::Thread::Options start_options(MessageLoop::TYPE_IO, 0);
+    if (!upload_thread_.StartWithOptions(start_options)) {
+      NOTREACHED() << "Failed to start the upload thread!";
     }
   }
 }
 
+// Once per spell of the user's absence, seals the logs and deflates them on
+// the upload thread, so that an upload finds most of its data compressed.
+// The application log isn't when it is to be trimmed, as the trimmer reads
+// it as it is.
+void SawdustApplication::OnIdleCheck() {
+  if (exiting_ || upload_task_ != NULL || precompressing_ ||
+      controller_.IsFlightRecorder() || !controller_.IsLogWorthSaving()) {
+    return;
+  }
+
+  LASTINPUTINFO input_info = { sizeof(input_info) };
+  if (!::GetLastInputInfo(&input_info) ||
+      input_info.dwTime == precompressed_input_time_ ||
+      ::GetTickCount() - input_info.dwTime < kIdlePrecompressionMs) {
+    return;
+  }
+
+  HRESULT hr = controller_.Rotate();
+  if (FAILED(hr)) {
+    LOG(WARNING) << "Failed to seal the logs for precompression. " <<
+        com::LogHr(hr);
+    return;
+  }
+  precompressed_input_time_ = input_info.dwTime;
+
+  FilePath chrome_log;
+  FilePath kernel_log;
+  TracerConfiguration::TrimSettings trim;
+  if (!configuration_object_.GetTrimSettings(&trim))
+    controller_.GetCompletedEventLogFileName(&chrome_log);
+  controller_.GetCompletedKernelEventLogFileName(&kernel_log);
+
+  precompressing_ = true;
+  logs_precompressed_ = true;
+  StartUploadThread();
+  upload_thread_.message_loop()->PostTask(FROM_HERE,
+      new PrecompressTask(this, chrome_log, kernel_log,
+                          GetLogCompressionLevel(configuration_object_)));
+}
+
+void SawdustApplication::OnPrecompressionDone() {
+  precompressing_ = false;
+}
+
 // Handle user's application exit request. If the controller is running and
 // has accumulated enough data, we will give the user upload action (question
 // through a message box).
@@ -500,7 +747,7 @@ void SawdustApplication::OnExitInvoked() {
   TracerConfiguration::ExitAction exit_step =
       configuration_object_.ActionOnExit();
 
-  if (controller_.IsLogWorthSaving()) {
+  if (controller_.IsLogWorthSaving() || logs_precompressed_) {
     // The controller appears to be running and there is some worthwhile unsaved
     // data. If the settings say we should try and upload - let's try.
     if (exit_step == TracerConfiguration::REPORT_ASK) {
@@ -569,7 +816,24 @@ void SawdustApplication::OnTooltipUpdateRequest() {
   const size_t wsize = arraysize(icon_data_.szTip);
   bool remote = false;
   std::wstring upload_url;
-  if (controller_.IsRunning()) {
+  if (upload_task_ != NULL &&
+      configuration_object_.GetUploadPath(&upload_url, &remote)) {
+    // Uploading. Logging goes on meanwhile when the logs were rotated, so
+    // this goes first.
+    const wchar_t* activity = remote ? L"Uploading" : L"Compressing";
+    uint64 sent = upload_throttle_ != NULL ?
+        upload_throttle_->GetBytesSent() : 0;
+    if (sent != 0) {
+      _snwprintf_s(icon_data_.szTip, wsize, _TRUNCATE, kActivityProgressFmt,
+                   tooltip_buffer, activity, sent / (1024.0 * 1024.0),
+                   upload_throttle_->GetThroughput() / 1024.0,
+                   upload_url.c_str());
+    } else {
+      _snwprintf_s(icon_data_.szTip, wsize, _TRUNCATE, kActivityUploadFmt,
+                   tooltip_buffer, activity, upload_url.c_str());
+    }
+    constructed = true;
+  } else if (controller_.IsRunning()) {
     // Logging.
     base::TimeDelta logtime = controller_.GetLoggingTimeSpan();
     const wchar_t* unit = L"minutes";
@@ -585,13 +849,6 @@ void SawdustApplication::OnTooltipUpdateRequest() {
                    kActivityLogFmt, tooltip_buffer, value, unit);
       constructed = true;
     }
-  } else if (upload_task_ != NULL &&
-             configuration_object_.GetUploadPath(&upload_url, &remote)) {
-    // Updating.
-    _snwprintf_s(icon_data_.szTip, wsize, _TRUNCATE, kActivityUploadFmt,
-                 tooltip_buffer, remote ? L"Uploading" : L"Compressing",
-                 upload_url.c_str());
-    constructed = true;
   }
 
   // Idle or weird. Or both.
@@ -20,12 +20,16 @@
 #include <ShellAPI.h>
 
 #include <string>
+#include <vector>
 
 #include "base/scoped_ptr.h"
 #include "base/threading/thread.h"
 #include "base/time.h"
+#include "sawdust/tracer/bandwidth_throttle.h"
 #include "sawdust/tracer/configuration.h"
 #include "sawdust/tracer/controller.h"
+#include "sawdust/tracer/precompressed_segment.h"
+#include "sawdust/tracer/system_info.h"
 #include "sawdust/tracer/upload.h"
 
 class Task;
@@ -46,12 +50,21 @@ class SawdustApplication {
   void OnMainMenuDisplayRequest(HWND hwnd, const POINT& click_point);
   void OrderlyShutdown(bool suppress_cleanup);
   void OnTooltipUpdateRequest();
+  void OnIdleCheck();
+  void OnPrecompressionDone();
   void OnNotificationDisplayRequest();
   void OnErrorNotificationRequest(const std::wstring& error_message);
 
  private:
+  class PrecompressTask;
   class UploadTask;
 
+  // A log deflated ahead of an upload.
+  struct PrecompressedLog {
+    PrecompressedSegment segment;
+    bool kernel;  // The kernel log, or else the application log.
+  };
+
   enum UpdateTip {
     UPDATE_TIP = 0,
     SKIP_TIP,
@@ -64,6 +77,8 @@ class SawdustApplication {
 
   static SawdustApplication* GetWindowData(HWND hwnd);
   void InvokeUploadTask(UploadTask* task);
+  void PostUploadTask(UploadTask* task);
+  void StartUploadThread();
   void StartLogging();
   void OnGuiUpdateRequest(UpdateTip update_tip, ShowBalloon show_balloon,
                           std::wstring message);
@@ -80,6 +95,8 @@ class SawdustApplication {
   // Actual data entries.
   TracerConfiguration configuration_object_;
   TracerController controller_;
+  // System information, collected in the background and ready for reports.
+  SystemInfoCache system_info_cache_;
 
   // Threading related. Note that since all operations are scheduled from the
   // same thread (GUI) there is no need for locks guarding upload. Note that
@@ -87,6 +104,20 @@ class SawdustApplication {
   // with that.
   Task* upload_task_;
   base::Thread upload_thread_;
+  // Paces the upload in progress and counts what it sent. Replaced as an
+  // upload task is initialized.
+  scoped_ptr<BandwidthThrottle> upload_throttle_;
+
+  // Logs deflated ahead of the next upload, oldest first. Only the upload
+  // thread gets at them, as the tasks which deflate and upload them run
+  // there in turn.
+  std::vector<PrecompressedLog> precompressed_logs_;
+  bool precompressing_;  // A PrecompressTask is pending.
+  bool abort_precompression_;  // Set as the application shuts down.
+  // Some logs were sealed for precompression since the last upload.
+  bool logs_precompressed_;
+  // The time of the last input before the logs were last sealed.
+  DWORD precompressed_input_time_;
 
   MessageLoop* main_message_loop_;
   DISALLOW_COPY_AND_ASSIGN(SawdustApplication);
@@ -16,21 +16,37 @@ import BaseHTTPServer
 import bisect
 import cgi
 import datetime
+import hashlib
 import optparse
 import os
 import cPickle as pickle
+import re
 import shutil
 import SocketServer
 import stat
 import cStringIO as StringIO
 import sys
 import tempfile
+import threading
+import time
 import urllib
 import urlparse
+import zipfile
+import zlib
 
 PROTOCOL_VERSION = 'HTTP/1.1'
 UPLOAD_PATH = 'cr/report'
 
+# Query parameters of the resumable upload protocol, which are not part of
+# the report's description.
+RESUMABLE_PARAMETERS = ('upload_id', 'offset', 'crc', 'last')
+UPLOAD_ID_PATTERN = re.compile(r'^[A-Za-z0-9-]+$')
+
+# Query parameters of the deduplicated upload protocol, likewise. Chunks are
+# named by their SHA-1, in hex.
+DEDUPLICATED_PARAMETERS = ('chunks', 'chunk', 'manifest')
+CHUNK_HASH_PATTERN = re.compile(r'^[0-9a-f]{40}$')
+
 
 class HTTPServer(SocketServer.ThreadingTCPServer):
   allow_reuse_address = 1  # Seems to make sense in testing environment.
@@ -48,9 +64,54 @@ def GetParser():
   parser.add_option('-p', '--port', dest='port', metavar='ID',
                    type='int', default=8080,
                    help='Port to use.')
+  parser.add_option('-w', '--want_logs', dest='want_logs',
+                   action='store_true', default=False,
+                   help='Ask for the logs after a summary.')
+  parser.add_option('-d', '--discard', dest='discard',
+                   action='store_true', default=False,
+                   help='Take reports in without storing them, as for load '
+                   'tests.')
   return parser
 
 
+class NullFile(object):
+  """A file that forgets what is written to it."""
+  def write(self, data):
+    pass
+
+
+class ServerStats(object):
+  """Counts the POST requests served, and the time spent on them."""
+
+  def __init__(self):
+    self._lock = threading.Lock()
+    self._requests = 0
+    self._bytes = 0
+    self._seconds = 0.0
+    self._max_seconds = 0.0
+
+  def Record(self, length, seconds):
+    self._lock.acquire()
+    try:
+      self._requests += 1
+      self._bytes += length
+      self._seconds += seconds
+      self._max_seconds = max(self._max_seconds, seconds)
+    finally:
+      self._lock.release()
+
+  def Text(self):
+    """Returns the counts as lines of "name=value"."""
+    self._lock.acquire()
+    try:
+      average = self._seconds / self._requests if self._requests else 0.0
+      return ('requests=%d\r\nbytes=%d\r\naverage_ms=%.1f\r\n'
+              'max_ms=%.1f\r\n' % (self._requests, self._bytes,
+                                   average * 1000, self._max_seconds * 1000))
+    finally:
+      self._lock.release()
+
+
 def CautiousCopy(fsrc, fdst, length):
   remaining_length = length
   while remaining_length > 0:
@@ -64,13 +125,18 @@ class LogStorage(object):
   """Manages the directory of uploaded log files."""
   INDEX_FILE_NAME = "index.db"
   DATA_FILE_SUFFIX = "logs.zip"
+  PARTIAL_FILE_SUFFIX = "partial"
+  CHUNK_DIRECTORY_NAME = "chunks"
 
-  def __init__(self, work_directory):
+  def __init__(self, work_directory, discard=False):
     """Initializes content based on the content of work_directory.
 
     If the directory does not exist, we will try to create it.
     If the index file does not exist, again we will try to create it.
+    With discard, reports are read in and dropped rather than stored. The
+    chunks of deduplicated uploads are still stored.
     """
+    self._discard = discard
     if not os.path.exists(work_directory):
       os.makedirs(work_directory)
       self._new_dir = True
@@ -82,6 +148,16 @@ class LogStorage(object):
     self.IndexFile = anydbm.open(os.path.join(self.StorageLocation,
                                               self.INDEX_FILE_NAME), 'c')
     self.Index = self._BuildIndex()
+    # The chunks of deduplicated uploads outlive the server, for the uploads
+    # of returning reporters to find them.
+    self._chunk_directory = os.path.join(self.StorageLocation,
+                                         self.CHUNK_DIRECTORY_NAME)
+    if not os.path.isdir(self._chunk_directory):
+      os.makedirs(self._chunk_directory)
+    # Sizes of the resumable uploads completed since the server started, so
+    # that a client which missed the answer to its last chunk can ask.
+    self._completed_uploads = {}
+    self._uploads_lock = threading.Lock()
 
   def BashAll(self):
     pass
@@ -102,6 +178,10 @@ class LogStorage(object):
     """
     # meta_data will map a string key to a list of entries. Our syntax basically
     # takes string-->string, so we will flatten the dictionary right here.
+    if self._discard:
+      CautiousCopy(data, NullFile(), length)
+      return True, "discarded"
+
     description = dict((str(k), str(v[0])) for (k, v) in meta_data.iteritems())
     description['time'] = datetime.datetime.now()
     file_info = None
@@ -133,6 +213,150 @@ class LogStorage(object):
       if not process_succeeded and file_info is not None:
         os.remove(file_info[1])
 
+  def GetUploadOffset(self, upload_id):
+    """Returns the number of bytes held of a resumable upload, or None."""
+    self._uploads_lock.acquire()
+    try:
+      return self._GetUploadOffset(upload_id)
+    finally:
+      self._uploads_lock.release()
+
+  def AppendToUpload(self, upload_id, offset, crc, data, meta_data, last):
+    """Appends a chunk to a resumable upload, if it fits.
+
+    The chunk is taken if it starts where the upload is at and its CRC-32
+    matches. The last chunk completes the upload, which then enters the index
+    like any other.
+    Args:
+      upload_id: The name of the upload.
+      offset: The offset of the chunk in the upload.
+      crc: The CRC-32 of the chunk, as the client computed it.
+      data: The chunk.
+      meta_data: A dictionary describing the request, for the index.
+      last: True for the last chunk of the upload.
+    Returns:
+      A tuple of whether the chunk was taken and the size of the upload held.
+    """
+    self._uploads_lock.acquire()
+    try:
+      held = self._GetUploadOffset(upload_id) or 0
+      if upload_id in self._completed_uploads:
+        return held == offset + len(data), held
+      if offset != held or zlib.crc32(data) & 0xffffffff != crc:
+        return False, held
+
+      partial_path = self._PartialPath(upload_id)
+      partial_file = open(partial_path, 'ab')
+      try:
+        partial_file.write(data)
+      finally:
+        partial_file.close()
+      held += len(data)
+
+      if last:
+        partial_file = open(partial_path, 'rb')
+        try:
+          status, key = self.AddNew(meta_data, partial_file, held)
+        finally:
+          partial_file.close()
+        if not status:
+          return False, held
+        os.remove(partial_path)
+        self._completed_uploads[upload_id] = held
+      return True, held
+    finally:
+      self._uploads_lock.release()
+
+  def HasChunk(self, chunk_hash):
+    return os.path.exists(self._ChunkPath(chunk_hash))
+
+  def AddChunk(self, chunk_hash, body):
+    """Stores a chunk of a deduplicated upload, if it matches its hash.
+
+    Args:
+      chunk_hash: The SHA-1 of the chunk, as the client computed it.
+      body: The chunk, deflated in zlib format.
+    Returns:
+      Whether the chunk was taken.
+    """
+    try:
+      chunk = zlib.decompress(body)
+    except zlib.error:
+      return False
+    if hashlib.sha1(chunk).hexdigest() != chunk_hash:
+      return False
+
+    # Written aside and renamed, so that a chunk is there whole or not at all.
+    chunk_file_info = tempfile.mkstemp(dir=self._chunk_directory)
+    chunk_file = os.fdopen(chunk_file_info[0], 'wb')
+    try:
+      chunk_file.write(chunk)
+    finally:
+      chunk_file.close()
+    if os.path.exists(self._ChunkPath(chunk_hash)):
+      os.remove(chunk_file_info[1])
+    else:
+      os.rename(chunk_file_info[1], self._ChunkPath(chunk_hash))
+    return True
+
+  def AddFromManifest(self, meta_data, manifest):
+    """Puts the report of a deduplicated upload together and inserts it.
+
+    The manifest lists each file of the report as a line "entry <title>",
+    followed by a line "<hash> <size>" for each of its chunks.
+    Args:
+      meta_data: A dictionary describing the request, for the index.
+      manifest: The text of the manifest.
+    Returns:
+      A tuple of whether the report was inserted and its key, or the reason
+      it wasn't.
+    """
+    entries = []
+    for line in manifest.splitlines():
+      kind, _, value = line.strip().partition(' ')
+      if kind == 'entry':
+        entries.append((value, []))
+      elif kind and entries and CHUNK_HASH_PATTERN.match(kind):
+        entries[-1][2].append(kind)
+      elif kind:
+        return False, 'Bad manifest line: ' + line
+
+    archive_data = StringIO.StringIO()
+    archive = zipfile.ZipFile(archive_data, 'w', zipfile.ZIP_DEFLATED)
+    try:
+      for (title, chunk_hashes) in entries:
+        pieces = []
+        for chunk_hash in chunk_hashes:
+          if not self.HasChunk(chunk_hash):
+            return False, 'Missing chunk ' + chunk_hash
+          chunk_file = open(self._ChunkPath(chunk_hash), 'rb')
+          try:
+            pieces.append(chunk_file.read())
+          finally:
+            chunk_file.close()
+        archive.writestr(title, ''.join(pieces))
+    finally:
+      archive.close()
+
+    archive_size = archive_data.tell()
+    archive_data.seek(0)
+    return self.AddNew(meta_data, archive_data, archive_size)
+
+  def _ChunkPath(self, chunk_hash):
+    return os.path.join(self._chunk_directory, chunk_hash)
+
+  def _GetUploadOffset(self, upload_id):
+    if upload_id in self._completed_uploads:
+      return self._completed_uploads[upload_id]
+    partial_path = self._PartialPath(upload_id)
+    if not os.path.exists(partial_path):
+      return None
+    return os.path.getsize(partial_path)
+
+  def _PartialPath(self, upload_id):
+    return os.path.join(self.StorageLocation,
+                        "%s.%s" % (upload_id, self.PARTIAL_FILE_SUFFIX))
+
   def GetAllEntries(self):
     """Returns an iterator over a collection of (dictionary, reference_key).
 
@@ -177,6 +401,15 @@ class LogStorage(object):
 
 class RequestHandler(BaseHTTPServer.BaseHTTPRequestHandler):
   def do_GET(self):
+    if self.path.strip('/') == 'stats':
+      self.SendText(200, self.server.Stats.Text())
+      return
+
+    resource_query = urlparse.parse_qs(urlparse.urlsplit(self.path).query)
+    if 'upload_id' in resource_query:
+      self.SendUploadOffset(resource_query['upload_id'][0])
+      return
+
     resource_path = urllib.unquote_plus(self.path).lstrip('/\\')
     f = None
     if not resource_path or resource_path in ('index', 'index.html'):
@@ -203,6 +436,12 @@ class RequestHandler(BaseHTTPServer.BaseHTTPRequestHandler):
       self.send_error(404, "File not found")
 
   def do_POST(self):
+    start = time.time()
+    length = self.HandlePost()
+    self.server.Stats.Record(length, time.time() - start)
+
+  def HandlePost(self):
+    """Serves a POST request, and returns the length of its body."""
     resource_id = urllib.unquote_plus(self.path).lstrip('/\\')
     resource_id = urlparse.urlsplit(resource_id)
     resource_query =  urlparse.parse_qs(resource_id.query)
@@ -211,12 +450,26 @@ class RequestHandler(BaseHTTPServer.BaseHTTPRequestHandler):
       # ever run into this exception.
       raise NotImplementedError(self.headers.type + ' not handled.')
 
-    if not 'content-length' in self.headers:
-      return
+    data = self.rfile
+    if self.headers.get('transfer-encoding', '').lower() == 'chunked':
+      data = StringIO.StringIO(self.ReadChunkedBody())
+      data_len = len(data.getvalue())
+    elif 'content-length' in self.headers:
+      data_len = int(self.headers['content-length'])
+    else:
+      return 0
+
+    if 'upload_id' in resource_query:
+      self.HandleResumableChunk(resource_query, data.read(data_len))
+      self.close_connection = 1
+      return data_len
+
+    if [p for p in DEDUPLICATED_PARAMETERS if p in resource_query]:
+      self.HandleDeduplicated(resource_query, data.read(data_len))
+      self.close_connection = 1
+      return data_len
 
-    data_len = int(self.headers['content-length'])
-    status, key = self.server.Storage.AddNew(resource_query, self.rfile,
-                                             data_len)
+    status, key = self.server.Storage.AddNew(resource_query, data, data_len)
     self.send_response(201)
     self.end_headers()
 
@@ -225,12 +478,110 @@ class RequestHandler(BaseHTTPServer.BaseHTTPRequestHandler):
       self.wfile.write('OK. <BR>')
       self.wfile.write(key)
       self.wfile.write('<BR>')
+      if 'summary' in resource_query and self.server.WantLogs:
+        self.wfile.write('logs=wanted<BR>')
     else:
       self.wfile.write('FAILED')
 
     # Read and processed - done (reading from this connection on windows will
     # likely hang the program).
     self.close_connection = 1
+    return data_len
+
+  def ReadChunkedBody(self):
+    """Reads a body in chunked transfer encoding, see RFC 2616 3.6.1."""
+    body = StringIO.StringIO()
+    while True:
+      size_line = self.rfile.readline()
+      chunk_size = int(size_line.split(';')[0].strip(), 16)
+      if not chunk_size:
+        break
+      CautiousCopy(self.rfile, body, chunk_size)
+      self.rfile.readline()  # The CRLF closing the chunk.
+
+    # Skip the trailers, up to the empty line.
+    while self.rfile.readline().strip():
+      pass
+    return body.getvalue()
+
+  def SendUploadOffset(self, upload_id):
+    """Answers a query for the size held of a resumable upload."""
+    if not UPLOAD_ID_PATTERN.match(upload_id):
+      self.send_error(400, "Bad upload id")
+      return
+
+    offset = self.server.Storage.GetUploadOffset(upload_id)
+    if offset is None:
+      self.send_error(404, "Upload not found")
+      return
+    self.SendOffset(200, offset)
+
+  def HandleResumableChunk(self, query, data):
+    """Takes in a chunk of a resumable upload, or refuses it."""
+    try:
+      upload_id = query['upload_id'][0]
+      offset = int(query['offset'][0])
+      crc = int(query['crc'][0], 16)
+    except (KeyError, ValueError):
+      self.send_error(400, "Bad upload chunk parameters")
+      return
+    if not UPLOAD_ID_PATTERN.match(upload_id):
+      self.send_error(400, "Bad upload id")
+      return
+
+    last = query.get('last', ['0'])[0] == '1'
+    meta_data = dict((k, v) for (k, v) in query.iteritems()
+                     if k not in RESUMABLE_PARAMETERS)
+    taken, held = self.server.Storage.AppendToUpload(upload_id, offset, crc,
+                                                     data, meta_data, last)
+    if not taken:
+      # A chunk that doesn't start where the upload is at is a conflict, one
+      # that does was corrupted on the way.
+      self.SendOffset(409 if offset != held else 400, held)
+    else:
+      self.SendOffset(201 if last else 200, held)
+
+  def HandleDeduplicated(self, query, data):
+    """Takes in a request of a deduplicated upload."""
+    storage = self.server.Storage
+    if 'chunks' in query:
+      # The answer lists the chunks the server lacks of those asked about.
+      missing = [h for h in data.split()
+                 if not CHUNK_HASH_PATTERN.match(h) or not storage.HasChunk(h)]
+      self.SendText(200, ''.join(h + '\n' for h in missing))
+    elif 'chunk' in query:
+      chunk_hash = query['chunk'][0]
+      if not CHUNK_HASH_PATTERN.match(chunk_hash):
+        self.send_error(400, "Bad chunk hash")
+      elif not storage.AddChunk(chunk_hash, data):
+        self.send_error(400, "The chunk doesn't match its hash")
+      else:
+        self.SendText(201, 'OK\r\n')
+    else:
+      meta_data = dict((k, v) for (k, v) in query.iteritems()
+                       if k not in DEDUPLICATED_PARAMETERS)
+      status, key = storage.AddFromManifest(meta_data, data)
+      if status:
+        self.SendText(201, '<HTML>POST OK. <BR>%s<BR>' % key)
+      else:
+        self.send_error(409, key)
+
+  def SendText(self, status, body):
+    """Sends a plain text answer."""
+    self.send_response(status)
+    self.send_header('Content-type', 'text/plain')
+    self.send_header('Content-Length', str(len(body)))
+    self.end_headers()
+    self.wfile.write(body)
+
+  def SendOffset(self, status, offset):
+    """Sends the body of resumable upload answers."""
+    body = 'offset=%d\r\n' % offset
+    self.send_response(status)
+    self.send_header('Content-type', 'text/plain')
+    self.send_header('Content-Length', str(len(body)))
+    self.end_headers()
+    self.wfile.write(body)
 
   def SendTocStreamHead(self):
     """Sending the table of content."""
@@ -268,10 +619,12 @@ class RequestHandler(BaseHTTPServer.BaseHTTPRequestHandler):
 
 
 class HttpServerWithContent(HTTPServer):
-  def __init__(self, host_name, port, content_handler):
+  def __init__(self, host_name, port, content_handler, want_logs=False):
     RequestHandler.protocol_version = PROTOCOL_VERSION
     assert content_handler is not None
     self.Storage = content_handler
+    self.WantLogs = want_logs
+    self.Stats = ServerStats()
     HTTPServer.__init__(self, (host_name, port), RequestHandler)
 
 
@@ -280,10 +633,11 @@ def main():
   work_directory = os.curdir if not args else args[0]
 
   # Just start the server.
-  data = LogStorage(work_directory)
+  data = LogStorage(work_directory, command_options.discard)
   try:
     server = HttpServerWithContent(command_options.server,
-                                   command_options.port, data)
+                                   command_options.port, data,
+                                   command_options.want_logs)
     print "Press Ctrl+C to quit..."
     server.serve_forever()
   except KeyboardInterrupt:
@@ -0,0 +1,48 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Background processing mode for the threads that package and upload reports.
+
+#include "sawdust/tracer/background_mode.h"
+
+#include "base/logging.h"
+#include "sawdust/tracer/com_utils.h"
+
+ScopedBackgroundMode::ScopedBackgroundMode(bool enabled)
+    : mode_(NONE), old_priority_(THREAD_PRIORITY_NORMAL) {
+  if (!enabled)
+    return;
+
+  HANDLE thread = ::GetCurrentThread();
+  if (::SetThreadPriority(thread, THREAD_MODE_BACKGROUND_BEGIN)) {
+    mode_ = BACKGROUND_MODE;
+    return;
+  }
+
+  // Before Vista, there's no background mode to lower the I/O priority.
+  old_priority_ = ::GetThreadPriority(thread);
+  if (::SetThreadPriority(thread, THREAD_PRIORITY_LOWEST)) {
+    mode_ = LOWEST_PRIORITY;
+  } else {
+    LOG(WARNING) << "Failed to lower the thread priority. " << com::LogWe();
+  }
+}
+
+ScopedBackgroundMode::~ScopedBackgroundMode() {
+  HANDLE thread = ::GetCurrentThread();
+  if (mode_ == BACKGROUND_MODE)
+    ::SetThreadPriority(thread, THREAD_MODE_BACKGROUND_END);
+  else if (mode_ == LOWEST_PRIORITY)
+    ::SetThreadPriority(thread, old_priority_);
+}
@@ -0,0 +1,47 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Background processing mode for the threads that package and upload reports.
+
+#ifndef SAWDUST_TRACER_BACKGROUND_MODE_H_
+#define SAWDUST_TRACER_BACKGROUND_MODE_H_
+
+#include <windows.h>
+
+#include "base/basictypes.h"
+
+// Puts the calling thread in background processing mode, with low CPU, I/O
+// and memory priority, for the lifetime of the object. Where the mode isn't
+// available, the thread merely runs at the lowest priority. Does nothing if
+// constructed disabled.
+class ScopedBackgroundMode {
+ public:
+  explicit ScopedBackgroundMode(bool enabled);
+  ~ScopedBackgroundMode();
+
+ private:
+  enum Mode {
+    NONE,
+    BACKGROUND_MODE,
+    LOWEST_PRIORITY,
+  };
+
+  Mode mode_;
+  // The priority the thread had before we lowered it.
+  int old_priority_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedBackgroundMode);
+};
+
+#endif  // SAWDUST_TRACER_BACKGROUND_MODE_H_
@@ -0,0 +1,102 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Upload bandwidth throttle.
+
+#include "sawdust/tracer/bandwidth_throttle.h"
+
+#include <math.h>
+#include <windows.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+const int BandwidthThrottle::kMaxSleepMs;
+
+BandwidthThrottle::BandwidthThrottle(uint64 bytes_per_second)
+    : bytes_per_second_(bytes_per_second),
+      allowance_(static_cast<double>(bytes_per_second)),
+      bytes_sent_(0) {
+}
+
+BandwidthThrottle::~BandwidthThrottle() {
+}
+
+bool BandwidthThrottle::Consume(size_t size, const bool* abort_flag) {
+  base::TimeDelta wait;
+  {
+    base::AutoLock lock(lock_);
+    base::TimeTicks now = Now();
+    if (first_send_.is_null()) {
+      first_send_ = now;
+      last_refill_ = now;
+    }
+
+    if (bytes_per_second_ != 0) {
+      // The allowance fills up with the time since the last send, to no more
+      // than a second's worth, which bounds the bursts after a pause.
+      double rate = static_cast<double>(bytes_per_second_);
+      allowance_ = std::min(rate, allowance_ +
+          rate * (now - last_refill_).InMicroseconds() /
+              base::Time::kMicrosecondsPerSecond);
+      last_refill_ = now;
+      allowance_ -= size;
+      if (allowance_ < 0) {
+        wait = base::TimeDelta::FromMicroseconds(static_cast<int64>(ceil(
+            -allowance_ * base::Time::kMicrosecondsPerSecond / rate)));
+      }
+    }
+  }
+
+  const base::TimeDelta max_sleep(
+      base::TimeDelta::FromMilliseconds(kMaxSleepMs));
+  while (wait > base::TimeDelta()) {
+    if (abort_flag != NULL && *abort_flag)
+      return false;
+    base::TimeDelta delay = std::min(wait, max_sleep);
+    Sleep(delay);
+    wait -= delay;
+  }
+
+  base::AutoLock lock(lock_);
+  bytes_sent_ += size;
+  return true;
+}
+
+uint64 BandwidthThrottle::GetBytesSent() const {
+  base::AutoLock lock(lock_);
+  return bytes_sent_;
+}
+
+double BandwidthThrottle::GetThroughput() const {
+  base::AutoLock lock(lock_);
+  if (first_send_.is_null())
+    return 0.0;
+
+  int64 elapsed_us = (Now() - first_send_).InMicroseconds();
+  if (elapsed_us <= 0)
+    return 0.0;
+  return static_cast<double>(bytes_sent_) *
+      base::Time::kMicrosecondsPerSecond / elapsed_us;
+}
+
+base::TimeTicks BandwidthThrottle::Now() const {
+  return base::TimeTicks::Now();
+}
+
+void BandwidthThrottle::Sleep(base::TimeDelta delay) {
+  ::Sleep(static_cast<DWORD>(std::max(delay.InMilliseconds(),
+                                      static_cast<int64>(1))));
+}
@@ -0,0 +1,72 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Limits the rate uploads go out at.
+
+#ifndef SAWDUST_TRACER_BANDWIDTH_THROTTLE_H_
+#define SAWDUST_TRACER_BANDWIDTH_THROTTLE_H_
+
+#include "base/basictypes.h"
+#include "base/synchronization/lock.h"
+#include "base/time.h"
+
+// Limits the rate bytes are sent at with a token bucket: the allowance fills
+// up at the rate limit, up to a second's worth, and each send takes its bytes
+// from it, waiting out what's missing. It also counts the bytes sent, which
+// another thread may read as the progress and throughput of the upload.
+// This class is thread safe.
+class BandwidthThrottle {
+ public:
+  // Waits are cut in slices of this many milliseconds, so that an abort
+  // doesn't wait for long.
+  static const int kMaxSleepMs = 100;
+
+  // |bytes_per_second| of zero puts no limit on the rate, only counts.
+  explicit BandwidthThrottle(uint64 bytes_per_second);
+  virtual ~BandwidthThrottle();
+
+  // Waits until |size| bytes may be sent, and counts them as sent.
+  // |abort_flag| may be NULL, or point to a flag that abandons the wait as it
+  // is set. Returns false if the wait was abandoned.
+  bool Consume(size_t size, const bool* abort_flag);
+
+  uint64 bytes_per_second() const { return bytes_per_second_; }
+
+  // The bytes sent so far.
+  uint64 GetBytesSent() const;
+
+  // The average rate the bytes went at since the first was sent, in bytes per
+  // second, or zero before any time went by.
+  double GetThroughput() const;
+
+ protected:
+  // Test seams.
+  virtual base::TimeTicks Now() const;
+  virtual void Sleep(base::TimeDelta delay);
+
+ private:
+  const uint64 bytes_per_second_;
+
+  mutable base::Lock lock_;
+  // The bytes that may go without waiting, which is negative while sends
+  // wait for what they took beyond it. Under lock_.
+  double allowance_;
+  base::TimeTicks first_send_;  // Under lock_.
+  base::TimeTicks last_refill_;  // Under lock_.
+  uint64 bytes_sent_;  // Under lock_.
+
+  DISALLOW_COPY_AND_ASSIGN(BandwidthThrottle);
+};
+
+#endif  // SAWDUST_TRACER_BANDWIDTH_THROTTLE_H_
@@ -0,0 +1,111 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Upload bandwidth throttle unittests.
+
+#include "sawdust/tracer/bandwidth_throttle.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Runs on a clock that only moves as the throttle sleeps, or as told.
+class TestingBandwidthThrottle : public BandwidthThrottle {
+ public:
+  explicit TestingBandwidthThrottle(uint64 bytes_per_second)
+      : BandwidthThrottle(bytes_per_second),
+        now_(base::TimeTicks::FromInternalValue(1000000)),
+        sleep_count_(0),
+        abort_flag_(NULL) {
+  }
+
+  void Advance(base::TimeDelta delta) { now_ += delta; }
+
+  base::TimeDelta slept() const { return slept_; }
+  int sleep_count() const { return sleep_count_; }
+  // Sets |abort_flag| as the throttle first sleeps.
+  void set_abort_on_sleep(bool* abort_flag) { abort_flag_ = abort_flag; }
+
+ protected:
+  virtual base::TimeTicks Now() const { return now_; }
+
+  virtual void Sleep(base::TimeDelta delay) {
+    EXPECT_GE(BandwidthThrottle::kMaxSleepMs, delay.InMilliseconds());
+    ++sleep_count_;
+    slept_ += delay;
+    now_ += delay;
+    if (abort_flag_ != NULL)
+      *abort_flag_ = true;
+  }
+
+ private:
+  base::TimeTicks now_;
+  base::TimeDelta slept_;
+  int sleep_count_;
+  bool* abort_flag_;
+};
+
+}  // namespace
+
+TEST(BandwidthThrottleTest, Unlimited) {
+  TestingBandwidthThrottle throttle(0);
+  EXPECT_EQ(0.0, throttle.GetThroughput());
+
+  EXPECT_TRUE(throttle.Consume(10 * 1024 * 1024, NULL));
+  EXPECT_TRUE(throttle.Consume(10 * 1024 * 1024, NULL));
+  EXPECT_EQ(0, throttle.sleep_count());
+  EXPECT_EQ(20 * 1024 * 1024, throttle.GetBytesSent());
+}
+
+TEST(BandwidthThrottleTest, LimitsTheRate) {
+  TestingBandwidthThrottle throttle(1000);
+
+  // A second's worth goes right away.
+  EXPECT_TRUE(throttle.Consume(1000, NULL));
+  EXPECT_EQ(0, throttle.sleep_count());
+
+  // What's beyond waits its time.
+  EXPECT_TRUE(throttle.Consume(500, NULL));
+  EXPECT_NEAR(500, throttle.slept().InMilliseconds(), 1);
+  EXPECT_EQ(5, throttle.sleep_count());
+
+  // Long pauses don't build up more than a second's worth.
+  throttle.Advance(base::TimeDelta::FromSeconds(10));
+  EXPECT_TRUE(throttle.Consume(1500, NULL));
+  EXPECT_NEAR(1000, throttle.slept().InMilliseconds(), 1);
+
+  EXPECT_EQ(3000, throttle.GetBytesSent());
+}
+
+TEST(BandwidthThrottleTest, Throughput) {
+  TestingBandwidthThrottle throttle(1000);
+  for (int i = 0; i < 10; ++i)
+    EXPECT_TRUE(throttle.Consume(1000, NULL));
+
+  // The first second's worth went in a burst, the rest at the limit.
+  EXPECT_NEAR(9000, throttle.slept().InMilliseconds(), 1);
+  EXPECT_NEAR(10000 / 9.0, throttle.GetThroughput(), 1.0);
+}
+
+TEST(BandwidthThrottleTest, Abort) {
+  TestingBandwidthThrottle throttle(1000);
+  bool abort = false;
+  throttle.set_abort_on_sleep(&abort);
+
+  // A send that needn't wait goes through regardless.
+  EXPECT_TRUE(throttle.Consume(1000, &abort));
+  EXPECT_FALSE(throttle.Consume(1000, &abort));
+  EXPECT_EQ(1, throttle.sleep_count());
+  EXPECT_EQ(1000, throttle.GetBytesSent());
+}
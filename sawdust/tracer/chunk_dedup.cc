@@ -0,0 +1,317 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Deduplicated uploads implementation.
+
+#include "sawdust/tracer/chunk_dedup.h"
+
+#include "base/logging.h"
+#include "base/sha1.h"
+#include "base/string_number_conversions.h"
+#include "base/string_util.h"
+#include "base/stringprintf.h"
+#include "base/utf_string_conversions.h"
+#include "third_party/zlib/zlib.h"
+
+#include "sawdust/tracer/bandwidth_throttle.h"
+#include "sawdust/tracer/chunked_upload.h"
+
+namespace {
+
+// Chunks come at 64K or so, wide enough apart for the queries and the
+// manifest to stay small, and close enough that a log's appended tail
+// costs little more than itself.
+const size_t kMinChunkSize = 16 * 1024;
+const size_t kAverageChunkSize = 64 * 1024;
+const size_t kMaxChunkSize = 256 * 1024;
+
+// The server is asked about this many chunks at a time, which bounds the
+// data held waiting for its answer.
+const size_t kChunksPerQuery = 32;
+
+// The rolling hash is a function of the last this many bytes.
+const size_t kHashWindow = 32;
+
+// The gear table is seeded the same on every machine, for the same data to
+// be cut the same for everyone. Changing it makes every chunk new.
+const uint32 kGearSeed = 0x9E3779B9;
+
+const wchar_t kHashListContentType[] = L"text/plain";
+const wchar_t kChunkContentType[] = L"application/octet-stream";
+
+bool IsAborted(const bool* abort_flag) {
+  return abort_flag != NULL && *abort_flag;
+}
+
+std::string HashChunk(const std::string& chunk) {
+  std::string digest(base::SHA1HashString(chunk));
+  return StringToLowerASCII(base::HexEncode(digest.data(), digest.size()));
+}
+
+// Deflates |chunk| at |level| into |body|, in zlib format.
+bool DeflateChunk(const std::string& chunk, int level, std::string* body) {
+  uLongf body_size = compressBound(static_cast<uLong>(chunk.size()));
+  body->resize(body_size);
+  int result = compress2(reinterpret_cast<Bytef*>(&(*body)[0]), &body_size,
+                         reinterpret_cast<const Bytef*>(chunk.data()),
+                         static_cast<uLong>(chunk.size()), level);
+  if (result != Z_OK)
+    return false;
+  body->resize(body_size);
+  return true;
+}
+}
+
+ContentDefinedChunker::ContentDefinedChunker(size_t min_size,
+                                             size_t average_size,
+                                             size_t max_size)
+    : min_size_(min_size), max_size_(max_size), shift_(32), hash_(0) {
+  DCHECK_LT(0u, average_size);
+  DCHECK_EQ(0u, average_size & (average_size - 1));
+  DCHECK_LE(min_size, max_size);
+  for (size_t bits = average_size; bits > 1; bits >>= 1)
+    --shift_;
+
+  uint32 state = kGearSeed;
+  for (size_t i = 0; i < arraysize(gear_); ++i) {
+    // Xorshift, which is random enough for a hash and fixed across compilers.
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    gear_[i] = state;
+  }
+}
+
+void ContentDefinedChunker::Write(const char* data,
+                                  size_t size,
+                                  std::vector<std::string>* chunks) {
+  DCHECK(data != NULL || size == 0);
+  DCHECK(chunks != NULL);
+
+  size_t start = 0;
+  for (size_t i = 0; i < size; ++i) {
+    size_t length = chunk_.size() + i - start + 1;
+    // The cut can't come before min_size_, so the hash needn't be rolled
+    // until the window leading up to it.
+    if (length + kHashWindow <= min_size_)
+      continue;
+
+    hash_ = (hash_ << 1) + gear_[static_cast<uint8>(data[i])];
+    if (length < min_size_)
+      continue;
+    if (length < max_size_ && (hash_ >> shift_) != 0)
+      continue;
+
+    chunk_.append(data + start, i - start + 1);
+    chunks->push_back(std::string());
+    chunks->back().swap(chunk_);
+    start = i + 1;
+    hash_ = 0;
+  }
+  chunk_.append(data + start, size - start);
+}
+
+void ContentDefinedChunker::Flush(std::vector<std::string>* chunks) {
+  DCHECK(chunks != NULL);
+  if (!chunk_.empty()) {
+    chunks->push_back(std::string());
+    chunks->back().swap(chunk_);
+  }
+  hash_ = 0;
+}
+
+ChunkDeduplicator::ChunkDeduplicator(IChunkStoreTransport* transport,
+                                     BandwidthThrottle* throttle,
+                                     const bool* abort_flag)
+    : transport_(transport), throttle_(throttle), abort_flag_(abort_flag),
+      chunker_(kMinChunkSize, kAverageChunkSize, kMaxChunkSize),
+      level_(Z_DEFAULT_COMPRESSION), total_bytes_(0), sent_bytes_(0) {
+  DCHECK(transport_ != NULL);
+}
+
+void ChunkDeduplicator::BeginEntry(const char* title, int level) {
+  DCHECK(title != NULL);
+  DCHECK(pending_chunks_.empty());
+  level_ = level;
+  manifest_ += "entry ";
+  manifest_ += title;
+  manifest_ += '\n';
+}
+
+HRESULT ChunkDeduplicator::WriteEntryData(const char* data, size_t size) {
+  total_bytes_ += size;
+  chunker_.Write(data, size, &pending_chunks_);
+  if (pending_chunks_.size() < kChunksPerQuery)
+    return S_OK;
+  return SendPendingChunks();
+}
+
+HRESULT ChunkDeduplicator::EndEntry() {
+  chunker_.Flush(&pending_chunks_);
+  return SendPendingChunks();
+}
+
+HRESULT ChunkDeduplicator::Finish(std::wstring* response) {
+  DCHECK(response != NULL);
+  DCHECK(pending_chunks_.empty());
+  if (IsAborted(abort_flag_))
+    return E_ABORT;
+
+  HRESULT hr = transport_->SendManifest(manifest_, response);
+  LOG_IF(INFO, SUCCEEDED(hr)) << "Sent " << sent_bytes_ << " of " <<
+      total_bytes_ << " bytes, the server held the rest.";
+  return hr;
+}
+
+HRESULT ChunkDeduplicator::SendPendingChunks() {
+  if (pending_chunks_.empty())
+    return S_OK;
+
+  std::vector<std::string> hashes;
+  std::vector<std::string> unknown_hashes;
+  for (size_t i = 0; i < pending_chunks_.size(); ++i) {
+    hashes.push_back(HashChunk(pending_chunks_[i]));
+    base::StringAppendF(&manifest_, "%s %u\n", hashes.back().c_str(),
+                        static_cast<unsigned>(pending_chunks_[i].size()));
+    if (stored_hashes_.find(hashes.back()) == stored_hashes_.end())
+      unknown_hashes.push_back(hashes.back());
+  }
+
+  std::set<std::string> missing;
+  if (!unknown_hashes.empty()) {
+    HRESULT hr = transport_->QueryMissing(unknown_hashes, &missing);
+    if (FAILED(hr))
+      return hr;
+  }
+
+  for (size_t i = 0; i < pending_chunks_.size(); ++i) {
+    // Chunks the server holds, or that went earlier in the batch, stay.
+    if (stored_hashes_.find(hashes[i]) != stored_hashes_.end() ||
+        missing.find(hashes[i]) == missing.end()) {
+      stored_hashes_.insert(hashes[i]);
+      continue;
+    }
+
+    if (IsAborted(abort_flag_))
+      return E_ABORT;
+
+    std::string body;
+    if (!DeflateChunk(pending_chunks_[i], level_, &body)) {
+      LOG(ERROR) << "Failed to deflate chunk " << hashes[i];
+      return E_FAIL;
+    }
+    if (throttle_ != NULL && !throttle_->Consume(body.size(), abort_flag_))
+      return E_ABORT;
+
+    HRESULT hr = transport_->SendChunk(hashes[i], body);
+    if (FAILED(hr))
+      return hr;
+    sent_bytes_ += pending_chunks_[i].size();
+    stored_hashes_.insert(hashes[i]);
+  }
+
+  pending_chunks_.clear();
+  return S_OK;
+}
+
+HttpChunkStoreTransport::HttpChunkStoreTransport(const std::wstring& url)
+    : url_(url) {
+}
+
+HRESULT HttpChunkStoreTransport::QueryMissing(
+    const std::vector<std::string>& hashes,
+    std::set<std::string>* missing) {
+  DCHECK(missing != NULL);
+
+  std::string body;
+  for (size_t i = 0; i < hashes.size(); ++i) {
+    body += hashes[i];
+    body += '\n';
+  }
+
+  std::wstring url(MakeUrl("chunks=query"));
+  DWORD status = 0;
+  std::string response;
+  HRESULT hr = SendHttpRequest(L"POST", url.c_str(), kHashListContentType,
+                               body, &status, &response);
+  if (FAILED(hr))
+    return hr;
+  if (status != 200) {
+    LOG(ERROR) << "The server answered a chunk query with status " << status;
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  ParseHashList(response, missing);
+  return S_OK;
+}
+
+HRESULT HttpChunkStoreTransport::SendChunk(const std::string& hash,
+                                           const std::string& body) {
+  std::wstring url(MakeUrl("chunk=" + hash));
+  DWORD status = 0;
+  std::string response;
+  HRESULT hr = SendHttpRequest(L"POST", url.c_str(), kChunkContentType, body,
+                               &status, &response);
+  if (FAILED(hr))
+    return hr;
+  if (status < 200 || status >= 300) {
+    LOG(ERROR) << "The server answered chunk " << hash << " with status " <<
+        status;
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+  return S_OK;
+}
+
+HRESULT HttpChunkStoreTransport::SendManifest(const std::string& manifest,
+                                              std::wstring* response) {
+  DCHECK(response != NULL);
+
+  std::wstring url(MakeUrl("manifest=1"));
+  DWORD status = 0;
+  std::string answer;
+  HRESULT hr = SendHttpRequest(L"POST", url.c_str(), kHashListContentType,
+                               manifest, &status, &answer);
+  if (FAILED(hr))
+    return hr;
+  if (status < 200 || status >= 300) {
+    LOG(ERROR) << "The server answered the manifest with status " << status;
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+  *response = UTF8ToWide(answer);
+  return S_OK;
+}
+
+std::wstring HttpChunkStoreTransport::MakeUrl(
+    const std::string& parameters) const {
+  std::wstring url(url_);
+  url += url.find(L'?') == std::wstring::npos ? L'?' : L'&';
+  url += ASCIIToWide(parameters);
+  return url;
+}
+
+void ParseHashList(const std::string& text, std::set<std::string>* hashes) {
+  DCHECK(hashes != NULL);
+
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = text.find('\n', start);
+    if (end == std::string::npos)
+      end = text.size();
+    std::string line;
+    TrimWhitespaceASCII(text.substr(start, end - start), TRIM_ALL, &line);
+    if (!line.empty())
+      hashes->insert(line);
+    start = end + 1;
+  }
+}
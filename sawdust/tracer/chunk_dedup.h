@@ -0,0 +1,155 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Deduplicated uploads, which cut the entries of a report into chunks at
+// points chosen by their content and send only the chunks the server lacks.
+
+#ifndef SAWDUST_TRACER_CHUNK_DEDUP_H_
+#define SAWDUST_TRACER_CHUNK_DEDUP_H_
+
+#include <windows.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+
+class BandwidthThrottle;
+
+// Cuts a stream into chunks where a rolling hash of the bytes before each
+// point says so, so that data shifted by an insertion is still cut at the
+// same places, and most chunks of a log that grew are those of its last
+// upload. Past |min_size|, a cut comes every |average_size| bytes or so,
+// which is a power of two, and by |max_size| at the latest.
+class ContentDefinedChunker {
+ public:
+  ContentDefinedChunker(size_t min_size, size_t average_size, size_t max_size);
+
+  // Appends |size| bytes of |data| to the stream, moving the chunks they
+  // complete to the back of |chunks|.
+  void Write(const char* data, size_t size, std::vector<std::string>* chunks);
+
+  // Moves the rest of the stream, if any, to the back of |chunks| as its last
+  // chunk, and starts a new stream.
+  void Flush(std::vector<std::string>* chunks);
+
+ private:
+  size_t min_size_;
+  size_t max_size_;
+  int shift_;  // Cuts are where the hash has no bits set above this.
+  uint32 hash_;
+  uint32 gear_[256];  // The random values the hash is rolled with.
+  std::string chunk_;
+
+  DISALLOW_COPY_AND_ASSIGN(ContentDefinedChunker);
+};
+
+// The server end of a deduplicated upload, which stores chunks by their
+// hash across uploads. The protocol over HTTP is implemented by
+// HttpChunkStoreTransport, and served by test_server/crash_eater.py.
+class IChunkStoreTransport {
+ public:
+  virtual ~IChunkStoreTransport() {}
+
+  // Asks the server which of |hashes| it holds no chunk for, and puts those
+  // into |missing|.
+  virtual HRESULT QueryMissing(const std::vector<std::string>& hashes,
+                               std::set<std::string>* missing) = 0;
+
+  // Sends |body|, the chunk hashed |hash| deflated in zlib format.
+  virtual HRESULT SendChunk(const std::string& hash,
+                            const std::string& body) = 0;
+
+  // Sends the |manifest| of an upload, see ChunkDeduplicator, on which the
+  // server puts the report together. |response| receives its answer.
+  virtual HRESULT SendManifest(const std::string& manifest,
+                               std::wstring* response) = 0;
+};
+
+// Takes the entries of a report in, sending the chunks of their data the
+// server lacks as it goes, and sends the report's manifest last. The
+// manifest lists each entry as a line "entry <title>", followed by a line
+// "<hash> <size>" per chunk. Hashes are the SHA-1 of a chunk, in hex.
+class ChunkDeduplicator {
+ public:
+  // |throttle| and |abort_flag| may be NULL. |abort_flag| abandons the
+  // upload as it is set.
+  ChunkDeduplicator(IChunkStoreTransport* transport,
+                    BandwidthThrottle* throttle,
+                    const bool* abort_flag);
+
+  // Starts an entry titled |title|, whose chunks are deflated at |level| on
+  // the way. The data must be the entry's own, not deflated ahead of time,
+  // for its chunks to match those of other uploads.
+  void BeginEntry(const char* title, int level);
+  HRESULT WriteEntryData(const char* data, size_t size);
+  HRESULT EndEntry();
+
+  // Sends the manifest, with |response| receiving the server's answer.
+  HRESULT Finish(std::wstring* response);
+
+  // The bytes of entry data taken in, and those sent rather than found on
+  // the server.
+  uint64 total_bytes() const { return total_bytes_; }
+  uint64 sent_bytes() const { return sent_bytes_; }
+
+ private:
+  // Adds the pending chunks to the manifest, and sends those the server
+  // lacks.
+  HRESULT SendPendingChunks();
+
+  IChunkStoreTransport* transport_;
+  BandwidthThrottle* throttle_;
+  const bool* abort_flag_;
+  ContentDefinedChunker chunker_;
+  int level_;
+  std::vector<std::string> pending_chunks_;
+  std::set<std::string> stored_hashes_;  // Sent or found on the server.
+  std::string manifest_;
+  uint64 total_bytes_;
+  uint64 sent_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChunkDeduplicator);
+};
+
+// Speaks the deduplicated protocol to the crash server at a URL, with the
+// request in a query parameter added to it: a POST with "chunks=query"
+// sends a list of hashes, one per line, and is answered with those the
+// server lacks, a POST with "chunk=<hash>" sends a chunk, and a POST with
+// "manifest=1" sends the manifest.
+class HttpChunkStoreTransport : public IChunkStoreTransport {
+ public:
+  explicit HttpChunkStoreTransport(const std::wstring& url);
+
+  // IChunkStoreTransport implementation.
+  virtual HRESULT QueryMissing(const std::vector<std::string>& hashes,
+                               std::set<std::string>* missing);
+  virtual HRESULT SendChunk(const std::string& hash, const std::string& body);
+  virtual HRESULT SendManifest(const std::string& manifest,
+                               std::wstring* response);
+
+ private:
+  // Returns the URL with |parameters| added to its query.
+  std::wstring MakeUrl(const std::string& parameters) const;
+
+  std::wstring url_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpChunkStoreTransport);
+};
+
+// Parses a list of hashes, one per line, into |hashes|.
+void ParseHashList(const std::string& text, std::set<std::string>* hashes);
+
+#endif  // SAWDUST_TRACER_CHUNK_DEDUP_H_
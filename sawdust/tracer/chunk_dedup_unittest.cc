@@ -0,0 +1,263 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Deduplicated uploads unittests.
+
+#include "sawdust/tracer/chunk_dedup.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+const size_t kMinSize = 1024;
+const size_t kAverageSize = 4096;
+const size_t kMaxSize = 16384;
+
+// No chunk ChunkDeduplicator sends is larger.
+const size_t kMaxDeduplicatedSize = 256 * 1024;
+
+// Makes |size| bytes that no chunker would find a pattern in.
+std::string MakeData(size_t size, uint32 seed) {
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = static_cast<char>(seed >> 16);
+  }
+  return data;
+}
+
+std::vector<std::string> Chunk(const std::string& data, size_t write_size) {
+  ContentDefinedChunker chunker(kMinSize, kAverageSize, kMaxSize);
+  std::vector<std::string> chunks;
+  for (size_t i = 0; i < data.size(); i += write_size) {
+    size_t size = std::min(write_size, data.size() - i);
+    chunker.Write(data.data() + i, size, &chunks);
+  }
+  chunker.Flush(&chunks);
+  return chunks;
+}
+
+// A server which holds the chunks in a map.
+class FakeStore : public IChunkStoreTransport {
+ public:
+  FakeStore() : query_count_(0), manifest_count_(0) {
+  }
+
+  virtual HRESULT QueryMissing(const std::vector<std::string>& hashes,
+                               std::set<std::string>* missing) {
+    ++query_count_;
+    for (size_t i = 0; i < hashes.size(); ++i) {
+      if (chunks_.find(hashes[i]) == chunks_.end())
+        missing->insert(hashes[i]);
+    }
+    return S_OK;
+  }
+
+  virtual HRESULT SendChunk(const std::string& hash,
+                            const std::string& body) {
+    std::string chunk(kMaxDeduplicatedSize, '\0');
+    uLongf chunk_size = static_cast<uLongf>(chunk.size());
+    EXPECT_EQ(Z_OK, uncompress(reinterpret_cast<Bytef*>(&chunk[0]),
+                               &chunk_size,
+                               reinterpret_cast<const Bytef*>(body.data()),
+                               static_cast<uLong>(body.size())));
+    chunk.resize(chunk_size);
+    EXPECT_TRUE(chunks_.find(hash) == chunks_.end());
+    chunks_[hash] = chunk;
+    sent_hashes_.push_back(hash);
+    return S_OK;
+  }
+
+  virtual HRESULT SendManifest(const std::string& manifest,
+                               std::wstring* response) {
+    ++manifest_count_;
+    manifest_ = manifest;
+    *response = L"OK";
+    return S_OK;
+  }
+
+  // Puts the entry titled |title| together from the manifest.
+  bool Assemble(const std::string& title, std::string* data) const {
+    std::string header("entry " + title + "\n");
+    size_t pos = manifest_.find(header);
+    if (pos == std::string::npos)
+      return false;
+
+    data->clear();
+    pos += header.size();
+    while (pos < manifest_.size() &&
+           manifest_.compare(pos, 6, "entry ") != 0) {
+      size_t end = manifest_.find('\n', pos);
+      std::string line(manifest_.substr(pos, end - pos));
+      std::map<std::string, std::string>::const_iterator it =
+          chunks_.find(line.substr(0, line.find(' ')));
+      if (it == chunks_.end())
+        return false;
+      data->append(it->second);
+      pos = end + 1;
+    }
+    return true;
+  }
+
+  const std::string& manifest() const { return manifest_; }
+  const std::vector<std::string>& sent_hashes() const { return sent_hashes_; }
+  int query_count() const { return query_count_; }
+  int manifest_count() const { return manifest_count_; }
+  void clear_sent_hashes() { sent_hashes_.clear(); }
+
+ private:
+  std::map<std::string, std::string> chunks_;
+  std::vector<std::string> sent_hashes_;
+  std::string manifest_;
+  int query_count_;
+  int manifest_count_;
+};
+
+HRESULT UploadEntries(FakeStore* store,
+                      const char* const* titles,
+                      const std::string* entries,
+                      size_t entry_count,
+                      uint64* sent_bytes) {
+  ChunkDeduplicator deduplicator(store, NULL, NULL);
+  for (size_t i = 0; i < entry_count; ++i) {
+    deduplicator.BeginEntry(titles[i], Z_DEFAULT_COMPRESSION);
+    HRESULT hr = deduplicator.WriteEntryData(entries[i].data(),
+                                             entries[i].size());
+    if (SUCCEEDED(hr))
+      hr = deduplicator.EndEntry();
+    if (FAILED(hr))
+      return hr;
+  }
+  std::wstring response;
+  *sent_bytes = deduplicator.sent_bytes();
+  return deduplicator.Finish(&response);
+}
+
+}  // namespace
+
+TEST(ContentDefinedChunkerTest, CutsWithinBounds) {
+  std::string data(MakeData(200000, 1));
+  std::vector<std::string> chunks(Chunk(data, data.size()));
+
+  ASSERT_LT(1u, chunks.size());
+  std::string joined;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    if (i + 1 < chunks.size())
+      EXPECT_LE(kMinSize, chunks[i].size());
+    EXPECT_GE(kMaxSize, chunks[i].size());
+    joined += chunks[i];
+  }
+  EXPECT_EQ(data, joined);
+}
+
+TEST(ContentDefinedChunkerTest, CutsRegardlessOfWrites) {
+  std::string data(MakeData(100000, 2));
+  EXPECT_EQ(Chunk(data, data.size()), Chunk(data, 1));
+  EXPECT_EQ(Chunk(data, data.size()), Chunk(data, 777));
+}
+
+TEST(ContentDefinedChunkerTest, CutsLongRunsAtTheMaximum) {
+  std::string data(3 * kMaxSize, 'x');
+  std::vector<std::string> chunks(Chunk(data, data.size()));
+  ASSERT_EQ(3u, chunks.size());
+  EXPECT_EQ(kMaxSize, chunks[0].size());
+}
+
+TEST(ContentDefinedChunkerTest, InsertionMovesFewCuts) {
+  std::string data(MakeData(200000, 3));
+  std::vector<std::string> chunks(Chunk(data, data.size()));
+  std::vector<std::string> shifted_chunks(
+      Chunk("some inserted bytes" + data, data.size()));
+
+  std::set<std::string> original(chunks.begin(), chunks.end());
+  size_t shared = 0;
+  for (size_t i = 0; i < shifted_chunks.size(); ++i)
+    shared += original.count(shifted_chunks[i]);
+  EXPECT_LE(chunks.size() - 2, shared);
+}
+
+TEST(ChunkDeduplicatorTest, SendsEachChunkOnce) {
+  FakeStore store;
+  const char* titles[] = { "First.etl", "Second.etl" };
+  std::string entries[] = { MakeData(300000, 4), std::string() };
+  entries[1] = entries[0];
+  uint64 sent_bytes = 0;
+
+  ASSERT_HRESULT_SUCCEEDED(UploadEntries(&store, titles, entries, 2,
+                                         &sent_bytes));
+  EXPECT_EQ(entries[0].size(), sent_bytes);
+  EXPECT_EQ(1, store.manifest_count());
+
+  std::string assembled;
+  ASSERT_TRUE(store.Assemble(titles[0], &assembled));
+  EXPECT_EQ(entries[0], assembled);
+  ASSERT_TRUE(store.Assemble(titles[1], &assembled));
+  EXPECT_EQ(entries[1], assembled);
+}
+
+TEST(ChunkDeduplicatorTest, SendsOnlyWhatTheServerLacks) {
+  FakeStore store;
+  const char* titles[] = { "Kernel.etl" };
+  std::string log(MakeData(500000, 5));
+  uint64 sent_bytes = 0;
+  ASSERT_HRESULT_SUCCEEDED(UploadEntries(&store, titles, &log, 1,
+                                         &sent_bytes));
+  EXPECT_EQ(log.size(), sent_bytes);
+
+  // The same log, grown, goes as little more than its tail.
+  std::string tail(MakeData(50000, 6));
+  std::string grown_log(log + tail);
+  store.clear_sent_hashes();
+  ASSERT_HRESULT_SUCCEEDED(UploadEntries(&store, titles, &grown_log, 1,
+                                         &sent_bytes));
+  EXPECT_GE(tail.size() + kMaxDeduplicatedSize, sent_bytes);
+  EXPECT_LT(0u, sent_bytes);
+
+  std::string assembled;
+  ASSERT_TRUE(store.Assemble(titles[0], &assembled));
+  EXPECT_EQ(grown_log, assembled);
+
+  // Nothing new goes at all.
+  store.clear_sent_hashes();
+  ASSERT_HRESULT_SUCCEEDED(UploadEntries(&store, titles, &grown_log, 1,
+                                         &sent_bytes));
+  EXPECT_EQ(0u, sent_bytes);
+  EXPECT_TRUE(store.sent_hashes().empty());
+}
+
+TEST(ChunkDeduplicatorTest, Aborts) {
+  FakeStore store;
+  bool abort = true;
+  ChunkDeduplicator deduplicator(&store, NULL, &abort);
+  deduplicator.BeginEntry("Some.txt", Z_DEFAULT_COMPRESSION);
+  ASSERT_HRESULT_SUCCEEDED(deduplicator.WriteEntryData("abc", 3));
+  EXPECT_EQ(E_ABORT, deduplicator.EndEntry());
+  EXPECT_TRUE(store.sent_hashes().empty());
+}
+
+TEST(ChunkDedupTest, ParseHashList) {
+  std::set<std::string> hashes;
+  ParseHashList("ab12\r\n\ncd34\nef56", &hashes);
+  ASSERT_EQ(3u, hashes.size());
+  EXPECT_EQ(1u, hashes.count("ab12"));
+  EXPECT_EQ(1u, hashes.count("cd34"));
+  EXPECT_EQ(1u, hashes.count("ef56"));
+}
@@ -0,0 +1,290 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// HTTP uploads, over WinHTTP.
+
+#include "sawdust/tracer/chunked_upload.h"
+
+#include <winhttp.h>
+
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "base/utf_string_conversions.h"
+
+#include "sawdust/tracer/bandwidth_throttle.h"
+#include "sawdust/tracer/com_utils.h"
+#include "sawdust/tracer/upload_chunk_queue.h"
+
+namespace {
+
+const wchar_t kUserAgent[] = L"Sawdust";
+
+// Closes a WinHTTP handle when going out of scope.
+class ScopedInternetHandle {
+ public:
+  explicit ScopedInternetHandle(HINTERNET handle = NULL) : handle_(handle) {
+  }
+
+  ~ScopedInternetHandle() {
+    if (handle_ != NULL)
+      ::WinHttpCloseHandle(handle_);
+  }
+
+  void reset(HINTERNET handle) {
+    if (handle_ != NULL)
+      ::WinHttpCloseHandle(handle_);
+    handle_ = handle;
+  }
+
+  HINTERNET get() const { return handle_; }
+
+ private:
+  HINTERNET handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedInternetHandle);
+};
+
+// Writes all |size| bytes of |data| to the body of |request|.
+bool WriteAll(HINTERNET request, const char* data, size_t size) {
+  while (size > 0) {
+    DWORD written = 0;
+    if (!::WinHttpWriteData(request, data, static_cast<DWORD>(size),
+                            &written)) {
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+// Writes |data| as a chunk of the body of |request|, WinHTTP leaves the
+// chunk framing to us. An empty chunk ends the body.
+bool WriteChunk(HINTERNET request, const std::string& data) {
+  std::string size_line(base::StringPrintf("%X\r\n", data.size()));
+  return WriteAll(request, size_line.data(), size_line.size()) &&
+      WriteAll(request, data.data(), data.size()) &&
+      WriteAll(request, "\r\n", 2);
+}
+
+// Reads the body of the response to |request| into |response|.
+bool ReadResponse(HINTERNET request, std::string* response) {
+  DWORD available = 0;
+  do {
+    if (!::WinHttpQueryDataAvailable(request, &available))
+      return false;
+
+    size_t offset = response->size();
+    response->resize(offset + available);
+    DWORD read = 0;
+    if (available != 0 &&
+        !::WinHttpReadData(request, &(*response)[offset], available, &read)) {
+      return false;
+    }
+    response->resize(offset + read);
+  } while (available != 0);
+
+  return true;
+}
+
+// The handles of a WinHTTP request, which close in reverse order.
+class HttpRequest {
+ public:
+  HttpRequest() {
+  }
+
+  // Opens a |verb| request on |url|.
+  HRESULT Open(const wchar_t* verb, const wchar_t* url) {
+    wchar_t host[256] = {};
+    wchar_t path[2048] = {};
+    wchar_t extra[2048] = {};
+    URL_COMPONENTS components = { sizeof(components) };
+    components.lpszHostName = host;
+    components.dwHostNameLength = arraysize(host);
+    components.lpszUrlPath = path;
+    components.dwUrlPathLength = arraysize(path);
+    components.lpszExtraInfo = extra;
+    components.dwExtraInfoLength = arraysize(extra);
+    if (!::WinHttpCrackUrl(url, 0, 0, &components)) {
+      LOG(ERROR) << "Malformed upload URL " << url;
+      return com::AlwaysErrorFromLastError();
+    }
+
+    session_.reset(::WinHttpOpen(kUserAgent,
+                                 WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+                                 WINHTTP_NO_PROXY_NAME,
+                                 WINHTTP_NO_PROXY_BYPASS,
+                                 0));
+    if (session_.get() == NULL)
+      return com::AlwaysErrorFromLastError();
+
+    connection_.reset(::WinHttpConnect(session_.get(), host,
+                                       components.nPort, 0));
+    if (connection_.get() == NULL)
+      return com::AlwaysErrorFromLastError();
+
+    std::wstring object(path);
+    object += extra;
+    DWORD flags =
+        components.nScheme == INTERNET_SCHEME_HTTPS ? WINHTTP_FLAG_SECURE : 0;
+    request_.reset(
+        ::WinHttpOpenRequest(connection_.get(), verb, object.c_str(), NULL,
+                             WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
+                             flags));
+    if (request_.get() == NULL)
+      return com::AlwaysErrorFromLastError();
+
+    return S_OK;
+  }
+
+  // Waits for the response, and reads its |status| and body.
+  HRESULT Receive(DWORD* status, std::string* response) {
+    if (!::WinHttpReceiveResponse(request_.get(), NULL))
+      return com::AlwaysErrorFromLastError();
+
+    DWORD status_size = sizeof(*status);
+    if (!::WinHttpQueryHeaders(request_.get(),
+                               WINHTTP_QUERY_STATUS_CODE |
+                                   WINHTTP_QUERY_FLAG_NUMBER,
+                               WINHTTP_HEADER_NAME_BY_INDEX,
+                               status,
+                               &status_size,
+                               WINHTTP_NO_HEADER_INDEX)) {
+      return com::AlwaysErrorFromLastError();
+    }
+
+    response->clear();
+    if (!ReadResponse(request_.get(), response))
+      return com::AlwaysErrorFromLastError();
+
+    return S_OK;
+  }
+
+  HINTERNET get() const { return request_.get(); }
+
+ private:
+  ScopedInternetHandle session_;
+  ScopedInternetHandle connection_;
+  ScopedInternetHandle request_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpRequest);
+};
+
+HRESULT PostChunks(const wchar_t* url,
+                   const wchar_t* content_type,
+                   UploadChunkQueue* queue,
+                   BandwidthThrottle* throttle,
+                   std::wstring* response) {
+  HttpRequest request;
+  HRESULT hr = request.Open(L"POST", url);
+  if (FAILED(hr))
+    return hr;
+
+  std::wstring headers(base::StringPrintf(
+      L"Content-Type: %ls\r\nTransfer-Encoding: chunked\r\n", content_type));
+  if (!::WinHttpSendRequest(request.get(),
+                            headers.c_str(),
+                            static_cast<DWORD>(headers.size()),
+                            WINHTTP_NO_REQUEST_DATA,
+                            0,
+                            WINHTTP_IGNORE_REQUEST_TOTAL_LENGTH,
+                            0)) {
+    return com::AlwaysErrorFromLastError();
+  }
+
+  std::string chunk;
+  while (queue->Pop(&chunk)) {
+    if (chunk.empty())
+      continue;
+    if (throttle != NULL && !throttle->Consume(chunk.size(), NULL))
+      return E_ABORT;
+    if (!WriteChunk(request.get(), chunk))
+      return com::AlwaysErrorFromLastError();
+  }
+
+  // A cancelled archive mustn't be terminated, lest the server take it.
+  if (queue->cancelled())
+    return E_ABORT;
+
+  chunk.clear();
+  if (!WriteChunk(request.get(), chunk))
+    return com::AlwaysErrorFromLastError();
+
+  DWORD status = 0;
+  std::string body;
+  hr = request.Receive(&status, &body);
+  if (FAILED(hr))
+    return hr;
+  if (status < 200 || status >= 300) {
+    LOG(ERROR) << "The server answered the upload with status " << status;
+    return HRESULT_FROM_WIN32(ERROR_WINHTTP_INVALID_SERVER_RESPONSE);
+  }
+
+  *response = UTF8ToWide(body);
+  return S_OK;
+}
+
+}  // namespace
+
+HRESULT PostChunkedUpload(const wchar_t* url,
+                          const wchar_t* content_type,
+                          UploadChunkQueue* queue,
+                          BandwidthThrottle* throttle,
+                          std::wstring* response) {
+  DCHECK(url != NULL);
+  DCHECK(content_type != NULL);
+  DCHECK(queue != NULL);
+  DCHECK(response != NULL);
+
+  HRESULT hr = PostChunks(url, content_type, queue, throttle, response);
+  if (FAILED(hr))
+    queue->Cancel();
+
+  return hr;
+}
+
+HRESULT SendHttpRequest(const wchar_t* verb,
+                        const wchar_t* url,
+                        const wchar_t* content_type,
+                        const std::string& body,
+                        DWORD* status,
+                        std::string* response) {
+  DCHECK(verb != NULL);
+  DCHECK(url != NULL);
+  DCHECK(status != NULL);
+  DCHECK(response != NULL);
+
+  HttpRequest request;
+  HRESULT hr = request.Open(verb, url);
+  if (FAILED(hr))
+    return hr;
+
+  std::wstring headers;
+  if (content_type != NULL)
+    headers = base::StringPrintf(L"Content-Type: %ls\r\n", content_type);
+  DWORD size = static_cast<DWORD>(body.size());
+  if (!::WinHttpSendRequest(request.get(),
+                            headers.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS :
+                                              headers.c_str(),
+                            static_cast<DWORD>(headers.size()),
+                            size == 0 ? WINHTTP_NO_REQUEST_DATA :
+                                        const_cast<char*>(body.data()),
+                            size,
+                            size,
+                            0)) {
+    return com::AlwaysErrorFromLastError();
+  }
+
+  return request.Receive(status, response);
+}
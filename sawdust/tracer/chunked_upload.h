@@ -0,0 +1,49 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Uploads to an HTTP server, streamed in chunked transfer encoding or not.
+
+#ifndef SAWDUST_TRACER_CHUNKED_UPLOAD_H_
+#define SAWDUST_TRACER_CHUNKED_UPLOAD_H_
+
+#include <windows.h>
+
+#include <string>
+
+class BandwidthThrottle;
+class UploadChunkQueue;
+
+// POSTs the chunks of |queue| to |url| as they come, with |content_type|,
+// in chunked transfer encoding, so the size of the body needn't be known up
+// front. The chunks go through |throttle|, unless that's NULL. On success,
+// |response| receives the text the server answered with. Returns E_ABORT if
+// |queue| is cancelled, and cancels |queue| on any other failure so its
+// producer stops.
+HRESULT PostChunkedUpload(const wchar_t* url,
+                          const wchar_t* content_type,
+                          UploadChunkQueue* queue,
+                          BandwidthThrottle* throttle,
+                          std::wstring* response);
+
+// Sends a |verb| request to |url| with |body|, of |content_type| unless
+// that's NULL. On success, |status| and |response| receive the status code
+// and the body the server answered with, whatever the status.
+HRESULT SendHttpRequest(const wchar_t* verb,
+                        const wchar_t* url,
+                        const wchar_t* content_type,
+                        const std::string& body,
+                        DWORD* status,
+                        std::string* response);
+
+#endif  // SAWDUST_TRACER_CHUNKED_UPLOAD_H_
@@ -34,6 +34,7 @@ const char kProvidersKey[] = "providers";
 const char kUploadKey[] = "report";
 const char kRegistryEntriesKey[] = "registry-harvest";
 const char kSettingsKey[] = "other";
+const char kTriggersKey[] = "triggers";
 
 const char kGuidKey[] = "guid";
 const char kNameKey[] = "name";
@@ -44,11 +45,29 @@ const char kKernelOn[] = "kernel_trace";
 const char kKernelFile[] = "kernel_event_file";
 const char kChromeFile[] = "chrome_event_file";
 const char kKernelFileSize[] = "kernel_file_size";
+const char kKernelProfile[] = "kernel_profile";
 const char kChromeFileSize[] = "chrome_file_size";
 const char kHarvestEnvVars[] = "get_environment_strings";
+const char kIncrementalRegistry[] = "incremental_registry";
+const char kFlightRecorderOn[] = "flight_recorder";
 
 const char kTargetKey[] = "target";
 const char kOnExitKey[] = "exit_handler";
+const char kResumableKey[] = "resumable";
+const char kBandwidthKey[] = "bandwidth_kbps";
+const char kBackgroundKey[] = "background";
+const char kSummaryFirstKey[] = "summary_first";
+const char kDeduplicateKey[] = "deduplicate";
+const char kCompressionKey[] = "compression";
+const char kTrimKey[] = "trim";
+const char kTrimWindowKey[] = "window_minutes";
+const char kTrimProcessesKey[] = "pids";
+
+const char kTriggerMessageKey[] = "message";
+const char kTriggerSpanKey[] = "span_ms";
+const char kSnapshotSecondsKey[] = "snapshot_seconds";
+const char kSnapshotIntervalKey[] = "interval_seconds";
+const char kMaxSnapshotsKey[] = "max_snapshots";
 
 const char kOtherParametersKey[] = "parameters";
 const wchar_t kDefaultAppName[] = L"Chrome";
@@ -70,23 +89,50 @@ const unsigned kDefaultFileSize = 15;
 const unsigned kMaxFileSize = 250;
 const bool kDefaultKernelTraceOn = true;
 const bool kDefaultEnvHarvesting = true;
+const int kDefaultSnapshotSeconds = 120;
+const int kDefaultSnapshotInterval = 300;
+const int kDefaultMaxSnapshots = 3;
 }  // namespace
 
 
 TracerConfiguration::MapOfLevelNames TracerConfiguration::named_levels_;
 TracerConfiguration::MapOfActionNames TracerConfiguration::named_actions_;
+TracerConfiguration::MapOfCompressionNames
+    TracerConfiguration::named_compressions_;
 
 const char TracerConfiguration::kAppKey[] = "prod";
 const char TracerConfiguration::kModuleKey[] = "module";
 const char TracerConfiguration::kVersionKey[] = "version";
 const char TracerConfiguration::kVersionKeyKey[] = "version_regkey";
+const char TracerConfiguration::kDefaultCompressionKey[] = "default";
+
+TracerConfiguration::TrimSettings::TrimSettings()
+    : window_minutes(0), level(TRACE_LEVEL_VERBOSE) {
+}
+
+TracerConfiguration::SnapshotTriggers::SnapshotTriggers()
+    : level(TRACE_LEVEL_NONE),
+      span_ms(0),
+      snapshot_seconds(kDefaultSnapshotSeconds),
+      min_interval_seconds(kDefaultSnapshotInterval),
+      max_snapshots(kDefaultMaxSnapshots) {
+}
 
 TracerConfiguration::TracerConfiguration()
     : trace_kernel_on_(kDefaultKernelTraceOn),
+      kernel_profile_(kernel_capture_profile::MINIMAL),
+      flight_recorder_on_(false),
       max_kernel_file_size_(kDefaultFileSize),
       max_chrome_file_size_(kDefaultFileSize),
       exit_action_(REPORT_ASK),
-      harvest_env_variables_(kDefaultEnvHarvesting) {
+      resumable_upload_(false),
+      upload_bandwidth_kbps_(0),
+      upload_in_background_(true),
+      summary_first_(false),
+      upload_deduplicated_(false),
+      trim_logs_(false),
+      harvest_env_variables_(kDefaultEnvHarvesting),
+      harvest_registry_incrementally_(false) {
   if (named_levels_.empty()) {
     named_levels_["verbose"] = TRACE_LEVEL_VERBOSE;
     named_levels_["information"] = TRACE_LEVEL_INFORMATION;
@@ -102,6 +148,14 @@ TracerConfiguration::TracerConfiguration()
     named_actions_["clear"] = REPORT_CLEAR;
     named_actions_["auto"] = REPORT_AUTO;
   }
+
+  // Deflate levels, as zlib has them.
+  if (named_compressions_.empty()) {
+    named_compressions_["store"] = 0;
+    named_compressions_["fast"] = 1;
+    named_compressions_["default"] = 6;
+    named_compressions_["best"] = 9;
+  }
 }
 
 // Initializes the object from a given JSON formatted string, returns false on
@@ -168,6 +222,14 @@ bool TracerConfiguration::Initialize(const std::string& json,
                                                  &child_node)) &&
                   (child_node == NULL ||
                    ExtractLogSettings(child_node, error_message_out));
+  return_status = return_status &&
+                  SUCCEEDED(ExtractOptionalValue(config_dictionary,
+                                                 kTriggersKey,
+                                                 Value::TYPE_DICTIONARY,
+                                                 error_message_out,
+                                                 &child_node)) &&
+                  (child_node == NULL ||
+                   ExtractSnapshotTriggers(child_node, error_message_out));
 
   root_in_fs_ = target_directory;
   return return_status;
@@ -268,6 +330,13 @@ bool TracerConfiguration::ExtractUploadInstructions(Value* upload_node,
 
   target_url_.clear();
   exit_action_ = REPORT_ASK;
+  resumable_upload_ = false;
+  upload_bandwidth_kbps_ = 0;
+  upload_in_background_ = true;
+  summary_first_ = false;
+  upload_deduplicated_ = false;
+  compression_levels_.clear();
+  trim_logs_ = false;
 
   Value* param_value = NULL;
   if (SUCCEEDED(ExtractOptionalValue(upload_dict, kTargetKey,
@@ -291,6 +360,95 @@ bool TracerConfiguration::ExtractUploadInstructions(Value* upload_node,
     exit_action_ = found_it->second;
   }
 
+  param_value = NULL;
+  if (SUCCEEDED(ExtractOptionalValue(upload_dict, kResumableKey,
+                                     Value::TYPE_BOOLEAN, NULL,
+                                     &param_value)) &&
+      param_value != NULL) {
+    param_value->GetAsBoolean(&resumable_upload_);
+  }
+
+  // Zero or less leaves the upload unthrottled.
+  param_value = NULL;
+  if (SUCCEEDED(ExtractOptionalValue(upload_dict, kBandwidthKey,
+                                     Value::TYPE_INTEGER, NULL,
+                                     &param_value)) &&
+      param_value != NULL) {
+    int raw_value = 0;
+    param_value->GetAsInteger(&raw_value);
+    if (raw_value > 0)
+      upload_bandwidth_kbps_ = raw_value;
+  }
+
+  param_value = NULL;
+  if (SUCCEEDED(ExtractOptionalValue(upload_dict, kBackgroundKey,
+                                     Value::TYPE_BOOLEAN, NULL,
+                                     &param_value)) &&
+      param_value != NULL) {
+    param_value->GetAsBoolean(&upload_in_background_);
+  }
+
+  param_value = NULL;
+  if (SUCCEEDED(ExtractOptionalValue(upload_dict, kSummaryFirstKey,
+                                     Value::TYPE_BOOLEAN, NULL,
+                                     &param_value)) &&
+      param_value != NULL) {
+    param_value->GetAsBoolean(&summary_first_);
+  }
+
+  param_value = NULL;
+  if (SUCCEEDED(ExtractOptionalValue(upload_dict, kDeduplicateKey,
+                                     Value::TYPE_BOOLEAN, NULL,
+                                     &param_value)) &&
+      param_value != NULL) {
+    param_value->GetAsBoolean(&upload_deduplicated_);
+  }
+
+  // Compression levels go by entry name extension, say ".etl": "fast".
+  param_value = NULL;
+  if (SUCCEEDED(ExtractOptionalValue(upload_dict, kCompressionKey,
+                                     Value::TYPE_DICTIONARY, NULL,
+                                     &param_value)) &&
+      param_value != NULL) {
+    DictionaryValue* compression_dict =
+        static_cast<DictionaryValue*>(param_value);
+    for (DictionaryValue::key_iterator kit = compression_dict->begin_keys();
+         kit != compression_dict->end_keys(); ++kit) {
+      std::string name;
+      MapOfCompressionNames::const_iterator found_it =
+          named_compressions_.end();
+      if (compression_dict->GetStringWithoutPathExpansion(*kit, &name))
+        found_it = named_compressions_.find(name);
+      if (found_it == named_compressions_.end()) {
+        if (error_string_out != NULL) {
+          base::SStringPrintf(error_string_out, kErrorWordNotInDictionaryFmt,
+                              name.c_str());
+        }
+        return false;
+      }
+      if (*kit != kDefaultCompressionKey &&
+          (kit->empty() || (*kit)[0] != '.')) {
+        if (error_string_out != NULL) {
+          base::SStringPrintf(error_string_out, kErrorWordNotInDictionaryFmt,
+                              kit->c_str());
+        }
+        return false;
+      }
+      compression_levels_[StringToLowerASCII(*kit)] = found_it->second;
+    }
+  }
+
+  param_value = NULL;
+  if (FAILED(ExtractOptionalValue(upload_dict, kTrimKey,
+                                  Value::TYPE_DICTIONARY, error_string_out,
+                                  &param_value))) {
+    return false;
+  } else if (param_value != NULL &&
+             !ExtractTrimSettings(static_cast<DictionaryValue*>(param_value),
+                                  error_string_out)) {
+    return false;
+  }
+
   param_value = NULL;
   upload_params_.reset();
   if (SUCCEEDED(ExtractOptionalValue(upload_dict, kOtherParametersKey,
@@ -336,9 +494,12 @@ bool TracerConfiguration::ExtractLogSettings(Value* log_node,
   chrome_file_pat_.clear();
   kernel_file_pat_.clear();
   trace_kernel_on_ = kDefaultKernelTraceOn;
+  kernel_profile_ = kernel_capture_profile::MINIMAL;
+  flight_recorder_on_ = false;
   max_kernel_file_size_ = kDefaultFileSize;
   max_chrome_file_size_ = kDefaultFileSize;
   harvest_env_variables_ = kDefaultEnvHarvesting;
+  harvest_registry_incrementally_ = false;
   std::string error_string;
   Value* param_value = NULL;
   if (SUCCEEDED(ExtractOptionalValue(options_dict, kChromeFile,
@@ -361,6 +522,27 @@ bool TracerConfiguration::ExtractLogSettings(Value* log_node,
     param_value->GetAsBoolean(&trace_kernel_on_);
   }
 
+  param_value = NULL;
+  if (SUCCEEDED(ExtractOptionalValue(options_dict, kKernelProfile,
+                                     Value::TYPE_STRING, error_string_out,
+                                     &param_value)) && param_value != NULL) {
+    std::string profile_name;
+    param_value->GetAsString(&profile_name);
+    if (!kernel_capture_profile::FindProfile(profile_name,
+                                             &kernel_profile_)) {
+      base::SStringPrintf(error_string_out, kErrorWordNotInDictionaryFmt,
+                          profile_name.c_str());
+      return false;
+    }
+  }
+
+  param_value = NULL;
+  if (SUCCEEDED(ExtractOptionalValue(options_dict, kFlightRecorderOn,
+                                     Value::TYPE_BOOLEAN, error_string_out,
+                                     &param_value)) && param_value != NULL) {
+    param_value->GetAsBoolean(&flight_recorder_on_);
+  }
+
   param_value = NULL;
   if (SUCCEEDED(ExtractOptionalValue(options_dict, kKernelFileSize,
                                      Value::TYPE_INTEGER, error_string_out,
@@ -388,9 +570,154 @@ bool TracerConfiguration::ExtractLogSettings(Value* log_node,
       param_value->GetAsBoolean(&harvest_env_variables_);
   }
 
+  param_value = NULL;
+  if (SUCCEEDED(ExtractOptionalValue(options_dict, kIncrementalRegistry,
+                                     Value::TYPE_BOOLEAN, error_string_out,
+                                     &param_value)) && param_value != NULL) {
+    param_value->GetAsBoolean(&harvest_registry_incrementally_);
+  }
+
   return true;
 }
 
+bool TracerConfiguration::ExtractTrimSettings(DictionaryValue* trim_dict,
+    std::string* error_string_out) {
+  DCHECK(trim_dict != NULL);
+  trim_settings_ = TrimSettings();
+
+  Value* param_value = NULL;
+  if (FAILED(ExtractOptionalValue(trim_dict, kTrimWindowKey,
+                                  Value::TYPE_INTEGER, error_string_out,
+                                  &param_value))) {
+    return false;
+  } else if (param_value != NULL) {
+    int raw_value = 0;
+    param_value->GetAsInteger(&raw_value);
+    if (raw_value > 0)
+      trim_settings_.window_minutes = raw_value;
+  }
+
+  param_value = NULL;
+  if (FAILED(ExtractOptionalValue(trim_dict, kLevelKey, Value::TYPE_STRING,
+                                  error_string_out, &param_value))) {
+    return false;
+  } else if (param_value != NULL) {
+    std::string level_name;
+    param_value->GetAsString(&level_name);
+    MapOfLevelNames::const_iterator found_it = named_levels_.find(level_name);
+    if (found_it == named_levels_.end()) {
+      if (error_string_out != NULL) {
+        base::SStringPrintf(error_string_out, kErrorWordNotInDictionaryFmt,
+                            level_name.c_str());
+      }
+      return false;
+    }
+    trim_settings_.level = found_it->second;
+  }
+
+  param_value = NULL;
+  if (FAILED(ExtractOptionalValue(trim_dict, kTrimProcessesKey,
+                                  Value::TYPE_LIST, error_string_out,
+                                  &param_value))) {
+    return false;
+  } else if (param_value != NULL) {
+    ListValue* pid_list = static_cast<ListValue*>(param_value);
+    for (ListValue::const_iterator vit = pid_list->begin();
+         vit != pid_list->end(); ++vit) {
+      int pid = 0;
+      if (*vit == NULL || !(*vit)->GetAsInteger(&pid) || pid <= 0) {
+        if (error_string_out != NULL) {
+          base::SStringPrintf(error_string_out,
+              kErrorElementTypeFmt, kTrimProcessesKey);
+        }
+        return false;
+      }
+      trim_settings_.process_ids.push_back(static_cast<DWORD>(pid));
+    }
+  }
+
+  trim_logs_ = true;
+  return true;
+}
+
+bool TracerConfiguration::GetTrimSettings(TrimSettings* trim) const {
+  DCHECK(trim != NULL);
+  *trim = trim_settings_;
+  return trim_logs_;
+}
+
+bool TracerConfiguration::ExtractSnapshotTriggers(
+    Value* triggers_node, std::string* error_string_out) {
+  DCHECK(triggers_node != NULL &&
+         triggers_node->IsType(Value::TYPE_DICTIONARY));
+  DictionaryValue* triggers_dict = static_cast<DictionaryValue*>(triggers_node);
+  snapshot_triggers_ = SnapshotTriggers();
+
+  Value* param_value = NULL;
+  if (FAILED(ExtractOptionalValue(triggers_dict, kLevelKey, Value::TYPE_STRING,
+                                  error_string_out, &param_value))) {
+    return false;
+  } else if (param_value != NULL) {
+    std::string level_name;
+    param_value->GetAsString(&level_name);
+    MapOfLevelNames::const_iterator found_it = named_levels_.find(level_name);
+    if (found_it == named_levels_.end()) {
+      std::string error_string;
+      base::SStringPrintf(&error_string,
+                          kErrorWordNotInDictionaryFmt, level_name.c_str());
+      LOG(WARNING) << error_string;
+      if (error_string_out != NULL)
+        *error_string_out = error_string;
+      return false;
+    }
+    snapshot_triggers_.level = found_it->second;
+  }
+
+  param_value = NULL;
+  if (FAILED(ExtractOptionalValue(triggers_dict, kTriggerMessageKey,
+                                  Value::TYPE_STRING, error_string_out,
+                                  &param_value))) {
+    return false;
+  } else if (param_value != NULL) {
+    param_value->GetAsString(&snapshot_triggers_.message_pattern);
+  }
+
+  // The numbers are all optional, and only taken if positive.
+  struct {
+    const char* key;
+    int* value;
+  } numbers[] = {
+    { kTriggerSpanKey, &snapshot_triggers_.span_ms },
+    { kSnapshotSecondsKey, &snapshot_triggers_.snapshot_seconds },
+    { kSnapshotIntervalKey, &snapshot_triggers_.min_interval_seconds },
+    { kMaxSnapshotsKey, &snapshot_triggers_.max_snapshots },
+  };
+  for (size_t i = 0; i < arraysize(numbers); ++i) {
+    param_value = NULL;
+    if (FAILED(ExtractOptionalValue(triggers_dict, numbers[i].key,
+                                    Value::TYPE_INTEGER, error_string_out,
+                                    &param_value))) {
+      return false;
+    } else if (param_value != NULL) {
+      int raw_value = 0;
+      param_value->GetAsInteger(&raw_value);
+      if (raw_value > 0)
+        *numbers[i].value = raw_value;
+    }
+  }
+
+  return true;
+}
+
+bool TracerConfiguration::GetSnapshotTriggers(
+    SnapshotTriggers* triggers) const {
+  DCHECK(triggers != NULL);
+  *triggers = snapshot_triggers_;
+  return snapshot_triggers_.level != TRACE_LEVEL_NONE ||
+         !snapshot_triggers_.message_pattern.empty() ||
+         snapshot_triggers_.span_ms > 0;
+}
+
 bool TracerConfiguration::GetLogFileName(FilePath* return_path) const {
   return GetTargetFilePath(root_in_fs_, chrome_file_pat_,  return_path);
 }
@@ -495,13 +822,25 @@ void TracerConfiguration::Clear() {
   chrome_file_pat_.clear();
   kernel_file_pat_.clear();
   trace_kernel_on_ = false;
+  kernel_profile_ = kernel_capture_profile::MINIMAL;
+  flight_recorder_on_ = false;
   max_kernel_file_size_ = 0;
   max_chrome_file_size_ = 0;
 
   target_url_.clear();
   exit_action_ = REPORT_ASK;
+  resumable_upload_ = false;
+  upload_bandwidth_kbps_ = 0;
+  upload_in_background_ = false;
+  summary_first_ = false;
+  upload_deduplicated_ = false;
+  compression_levels_.clear();
+  trim_logs_ = false;
+  trim_settings_ = TrimSettings();
   upload_params_.reset();
   harvest_env_variables_ = false;
+  harvest_registry_incrementally_ = false;
+  snapshot_triggers_ = SnapshotTriggers();
 }
 
 bool TracerConfiguration::GetTracedApplication(std::wstring* app_name) const {
@@ -27,6 +27,7 @@
 #include "base/values.h"
 #include "base/version.h"
 #include "base/win/event_trace_provider.h"
+#include "sawbuck/log_lib/kernel_capture_profile.h"
 
 // Reads complete configuration data (for the entire mechanism, including
 // tracing, config data harvesting and upload) from a json file. Verifies data
@@ -47,6 +48,41 @@ class TracerConfiguration {
 
   typedef std::list<ProviderSettings> ProviderDefinitions;
 
+  // Deflate levels, from 0 (store) to 9, keyed by the extension of report
+  // entry names (".etl"), or by kDefaultCompressionKey for other entries.
+  typedef std::map<std::string, int> MapOfCompressionLevels;
+
+  // When to snapshot the application log as it is being written, see
+  // LogWatcher. A trigger left zero or empty is off.
+  struct SnapshotTriggers {
+    SnapshotTriggers();
+
+    // Log messages at this level or more severe.
+    base::win::EtwEventLevel level;
+    // Log messages matching this regular expression.
+    std::string message_pattern;
+    // Trace event spans that last longer than this, in milliseconds.
+    int span_ms;
+    // The length of log leading up to a trigger a snapshot is to hold, and
+    // the least time between two snapshots, in seconds.
+    int snapshot_seconds;
+    int min_interval_seconds;
+    // The most snapshots a logging session takes.
+    int max_snapshots;
+  };
+
+  // How to trim the application logs down before they are reported.
+  struct TrimSettings {
+    TrimSettings();
+
+    // Keep the events logged this long before the report, unless zero.
+    int window_minutes;
+    // Keep the events at this level or more severe.
+    base::win::EtwEventLevel level;
+    // Keep the events of these processes, unless empty.
+    std::vector<DWORD> process_ids;
+  };
+
   enum ExitAction {
     REPORT_ASK = 0,  // Ask user if the default action should be taken.
     REPORT_NONE,  // Do nothing, just stop logging and quit.
@@ -59,6 +95,7 @@ class TracerConfiguration {
   static const char kModuleKey[];
   static const char kVersionKey[];
   static const char kVersionKeyKey[];
+  static const char kDefaultCompressionKey[];
 
   TracerConfiguration();
   virtual ~TracerConfiguration() {}
@@ -77,6 +114,22 @@ class TracerConfiguration {
     return trace_kernel_on_;
   }
 
+  // The kernel capture profile, which names the kernel events logged.
+  virtual kernel_capture_profile::Profile GetKernelProfile() const {
+    return kernel_profile_;
+  }
+
+  // The kernel enable flags of the kernel capture profile.
+  ULONG GetKernelEnableFlags() const {
+    return kernel_capture_profile::GetEnableFlags(kernel_profile_);
+  }
+
+  // Should the sessions be held in memory, and only written out to the log
+  // files as they stop. The file size caps then size the memory buffers.
+  virtual bool IsFlightRecorderEnabled() const {
+    return flight_recorder_on_;
+  }
+
   unsigned GetLogFileSizeCapMb() const {
     return max_chrome_file_size_;
   }
@@ -110,11 +163,51 @@ class TracerConfiguration {
 
   ExitAction ActionOnExit() const;
 
+  // Should remote uploads go in resumable chunks, see ReportUploader.
+  virtual bool IsUploadResumable() const { return resumable_upload_; }
+
+  // The rate remote uploads are held to, in kilobytes a second, as given
+  // under report\bandwidth_kbps. 0 means no limit.
+  virtual unsigned GetUploadBandwidthKbps() const {
+    return upload_bandwidth_kbps_;
+  }
+
+  // Should reports be compressed and uploaded in background mode, at low
+  // CPU and I/O priority. Defaults to true.
+  virtual bool IsUploadInBackground() const { return upload_in_background_; }
+
+  // Should remote uploads send a summary of the logs first, and the logs
+  // themselves only if the server asks for them, see LogSummarizer.
+  virtual bool IsSummaryFirst() const { return summary_first_; }
+
+  // Should remote uploads send only the chunks of the report the server
+  // doesn't hold from earlier uploads, see ChunkDeduplicator.
+  virtual bool IsUploadDeduplicated() const { return upload_deduplicated_; }
+
+  // The compression levels of report entries, as given under
+  // report\compression. Entries not covered are left to the uploader.
+  virtual const MapOfCompressionLevels& GetCompressionLevels() const {
+    return compression_levels_;
+  }
+
+  // The trimming given under report\trim. Returns false if the logs go as
+  // they are.
+  virtual bool GetTrimSettings(TrimSettings* trim) const;
+
+  // The triggers given under triggers. Returns false if none is on.
+  virtual bool GetSnapshotTriggers(SnapshotTriggers* triggers) const;
+
   // Get all requested registry subtrees we should harvest.
   virtual bool GetRegistryQuery(std::vector<std::wstring>* query_keys) const;
 
   virtual bool HarvestEnvVariables() const { return harvest_env_variables_; }
 
+  // Whether the registry extract leaves out the values of the keys not
+  // written since the last report.
+  virtual bool HarvestRegistryIncrementally() const {
+    return harvest_registry_incrementally_;
+  }
+
  protected:
   // Part of initialization. Populates provider_defs_ with values extracted from
   // |providers_node|.
@@ -131,6 +224,12 @@ class TracerConfiguration {
   // ETW log files.
   bool ExtractLogSettings(Value* log_node,
                           std::string* error_string_out);
+  // Part of initialization. Sets trim_settings_ from |trim_dict|.
+  bool ExtractTrimSettings(DictionaryValue* trim_dict,
+                           std::string* error_string_out);
+  // Part of initialization. Sets snapshot_triggers_ from |triggers_node|.
+  bool ExtractSnapshotTriggers(Value* triggers_node,
+                               std::string* error_string_out);
 
   // Utility function for processing pattern used to describe upload target.
   static bool ExpandBracketPattern(const std::wstring& pattern,
@@ -154,6 +253,7 @@ class TracerConfiguration {
  private:
   typedef std::map<std::string, base::win::EtwEventLevel> MapOfLevelNames;
   typedef std::map<std::string, ExitAction> MapOfActionNames;
+  typedef std::map<std::string, int> MapOfCompressionNames;
 
   void Clear();
 
@@ -176,18 +276,31 @@ class TracerConfiguration {
   std::wstring chrome_file_pat_;
   std::wstring kernel_file_pat_;
   bool trace_kernel_on_;
+  kernel_capture_profile::Profile kernel_profile_;
+  bool flight_recorder_on_;
   unsigned max_kernel_file_size_;
   unsigned max_chrome_file_size_;
 
   bool harvest_env_variables_;
+  bool harvest_registry_incrementally_;
+  SnapshotTriggers snapshot_triggers_;
 
   std::wstring target_url_;
   ExitAction exit_action_;
+  bool resumable_upload_;
+  unsigned upload_bandwidth_kbps_;
+  bool upload_in_background_;
+  bool summary_first_;
+  bool upload_deduplicated_;
+  MapOfCompressionLevels compression_levels_;
+  bool trim_logs_;
+  TrimSettings trim_settings_;
   scoped_ptr<DictionaryValue> upload_params_;
   scoped_ptr<ListValue> registry_query_;
 
   static MapOfLevelNames named_levels_;
   static MapOfActionNames named_actions_;
+  static MapOfCompressionNames named_compressions_;
 
   DISALLOW_COPY_AND_ASSIGN(TracerConfiguration);
 };
@@ -85,6 +85,8 @@ class TracerConfigurationTest : public testing::Test {
 
     tested_object_.reset(new TestingTracerConfiguration(&known_existing_dirs_));
     ADD_TO_MAP(verification_map_, IsKernelLoggingEnabled);
+    ADD_TO_MAP(verification_map_, GetKernelProfile);
+    ADD_TO_MAP(verification_map_, IsFlightRecorderEnabled);
     ADD_TO_MAP(verification_map_, GetLogFileSizeCapMb);
     ADD_TO_MAP(verification_map_, GetKernelLogFileSizeCapMb);
     ADD_TO_MAP(verification_map_, GetLogFileName);
@@ -95,6 +97,15 @@ class TracerConfigurationTest : public testing::Test {
     ADD_TO_MAP(verification_map_, GetParameterWord);
     ADD_TO_MAP(verification_map_, GetUploadPath);
     ADD_TO_MAP(verification_map_, HarvestEnvVariables);
+    ADD_TO_MAP(verification_map_, HarvestRegistryIncrementally);
+    ADD_TO_MAP(verification_map_, IsUploadResumable);
+    ADD_TO_MAP(verification_map_, GetUploadBandwidthKbps);
+    ADD_TO_MAP(verification_map_, IsUploadInBackground);
+    ADD_TO_MAP(verification_map_, IsSummaryFirst);
+    ADD_TO_MAP(verification_map_, IsUploadDeduplicated);
+    ADD_TO_MAP(verification_map_, GetCompressionLevels);
+    ADD_TO_MAP(verification_map_, GetTrimSettings);
+    ADD_TO_MAP(verification_map_, GetSnapshotTriggers);
 #undef ADD_TO_MAP
   }
 
@@ -259,6 +270,18 @@ class TracerConfigurationTest : public testing::Test {
         &TracerConfiguration::IsKernelLoggingEnabled, test_value));
   }
 
+  void VerifyGetKernelProfile(const Value& test_value) const {
+    std::string test_name;
+    ASSERT_TRUE(test_value.GetAsString(&test_name));
+    ASSERT_EQ(test_name, kernel_capture_profile::GetName(
+        tested_object_->GetKernelProfile()));
+  }
+
+  void VerifyIsFlightRecorderEnabled(const Value& test_value) const {
+    ASSERT_TRUE(CheckResultEqualDirect(tested_object_.get(),
+        &TracerConfiguration::IsFlightRecorderEnabled, test_value));
+  }
+
   void VerifyGetLogFileSizeCapMb(const Value& test_value) const {
     ASSERT_TRUE(CheckResultEqualDirect(tested_object_.get(),
         &TracerConfiguration::GetLogFileSizeCapMb, test_value));
@@ -348,6 +371,110 @@ class TracerConfigurationTest : public testing::Test {
         &TracerConfiguration::HarvestEnvVariables, test_value));
   }
 
+  void VerifyHarvestRegistryIncrementally(const Value& test_value) const {
+    ASSERT_TRUE(CheckResultEqualDirect(tested_object_.get(),
+        &TracerConfiguration::HarvestRegistryIncrementally, test_value));
+  }
+
+  void VerifyIsUploadResumable(const Value& test_value) const {
+    ASSERT_TRUE(CheckResultEqualDirect(tested_object_.get(),
+        &TracerConfiguration::IsUploadResumable, test_value));
+  }
+
+  void VerifyGetUploadBandwidthKbps(const Value& test_value) const {
+    ASSERT_TRUE(CheckResultEqualDirect(tested_object_.get(),
+        &TracerConfiguration::GetUploadBandwidthKbps, test_value));
+  }
+
+  void VerifyIsUploadInBackground(const Value& test_value) const {
+    ASSERT_TRUE(CheckResultEqualDirect(tested_object_.get(),
+        &TracerConfiguration::IsUploadInBackground, test_value));
+  }
+
+  void VerifyIsSummaryFirst(const Value& test_value) const {
+    ASSERT_TRUE(CheckResultEqualDirect(tested_object_.get(),
+        &TracerConfiguration::IsSummaryFirst, test_value));
+  }
+
+  void VerifyIsUploadDeduplicated(const Value& test_value) const {
+    ASSERT_TRUE(CheckResultEqualDirect(tested_object_.get(),
+        &TracerConfiguration::IsUploadDeduplicated, test_value));
+  }
+
+  void VerifyGetCompressionLevels(const Value& test_value) const {
+    ASSERT_TRUE(test_value.IsType(Value::TYPE_DICTIONARY));
+    const DictionaryValue& level_dictionary =
+        static_cast<const DictionaryValue&>(test_value);
+    const TracerConfiguration::MapOfCompressionLevels& levels =
+        tested_object_->GetCompressionLevels();
+    ASSERT_EQ(level_dictionary.size(), levels.size());
+
+    // The keys are extensions, which must not be taken for paths.
+    for (DictionaryValue::key_iterator kit = level_dictionary.begin_keys();
+         kit != level_dictionary.end_keys(); ++kit) {
+      int test_level = 0;
+      ASSERT_TRUE(level_dictionary.GetIntegerWithoutPathExpansion(
+          *kit, &test_level));
+      TracerConfiguration::MapOfCompressionLevels::const_iterator found_it =
+          levels.find(*kit);
+      ASSERT_TRUE(found_it != levels.end());
+      ASSERT_EQ(test_level, found_it->second);
+    }
+  }
+
+  void VerifyGetTrimSettings(const Value& test_value) const {
+    ASSERT_TRUE(test_value.IsType(Value::TYPE_DICTIONARY));
+    const DictionaryValue& trim_dictionary =
+        static_cast<const DictionaryValue&>(test_value);
+    TracerConfiguration::TrimSettings trim;
+    bool test_on = false;
+    int test_window = 0, test_level = 0;
+    ListValue* test_pids = NULL;
+    ASSERT_TRUE(trim_dictionary.GetBoolean("on", &test_on));
+    ASSERT_TRUE(trim_dictionary.GetInteger("window_minutes", &test_window));
+    ASSERT_TRUE(trim_dictionary.GetInteger("level", &test_level));
+    ASSERT_TRUE(trim_dictionary.GetList("pids", &test_pids));
+
+    ASSERT_EQ(test_on, tested_object_->GetTrimSettings(&trim));
+    ASSERT_EQ(test_window, trim.window_minutes);
+    ASSERT_EQ(test_level, trim.level);
+    ASSERT_EQ(test_pids->GetSize(), trim.process_ids.size());
+    for (size_t i = 0; i < trim.process_ids.size(); ++i) {
+      int test_pid = 0;
+      ASSERT_TRUE(test_pids->GetInteger(i, &test_pid));
+      ASSERT_EQ(test_pid, trim.process_ids[i]);
+    }
+  }
+
+  void VerifyGetSnapshotTriggers(const Value& test_value) const {
+    ASSERT_TRUE(test_value.IsType(Value::TYPE_DICTIONARY));
+    const DictionaryValue& trigger_dictionary =
+        static_cast<const DictionaryValue&>(test_value);
+    TracerConfiguration::SnapshotTriggers triggers;
+    bool test_on = false;
+    int test_level = 0, test_span_ms = 0, test_seconds = 0;
+    int test_interval = 0, test_max_snapshots = 0;
+    std::string test_message;
+    ASSERT_TRUE(trigger_dictionary.GetBoolean("on", &test_on));
+    ASSERT_TRUE(trigger_dictionary.GetInteger("level", &test_level));
+    ASSERT_TRUE(trigger_dictionary.GetString("message", &test_message));
+    ASSERT_TRUE(trigger_dictionary.GetInteger("span_ms", &test_span_ms));
+    ASSERT_TRUE(trigger_dictionary.GetInteger("snapshot_seconds",
+                                              &test_seconds));
+    ASSERT_TRUE(trigger_dictionary.GetInteger("interval_seconds",
+                                              &test_interval));
+    ASSERT_TRUE(trigger_dictionary.GetInteger("max_snapshots",
+                                              &test_max_snapshots));
+
+    ASSERT_EQ(test_on, tested_object_->GetSnapshotTriggers(&triggers));
+    ASSERT_EQ(test_level, triggers.level);
+    ASSERT_EQ(test_message, triggers.message_pattern);
+    ASSERT_EQ(test_span_ms, triggers.span_ms);
+    ASSERT_EQ(test_seconds, triggers.snapshot_seconds);
+    ASSERT_EQ(test_interval, triggers.min_interval_seconds);
+    ASSERT_EQ(test_max_snapshots, triggers.max_snapshots);
+  }
+
   typedef void (TracerConfigurationTest::*VerificationMethod)
       (const Value&) const;
   typedef std::map<std::string, VerificationMethod> VerificationMapType;
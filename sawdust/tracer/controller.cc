@@ -15,11 +15,16 @@
 // Controller for ETW events (a wrapper around base implementation).
 #include "sawdust/tracer/controller.h"
 
+#include <algorithm>
+
+#include "base/file_util.h"
 #include "base/logging.h"
+#include "base/stringprintf.h"
 #include "sawdust/tracer/com_utils.h"
 
 const wchar_t TracerController::kSawdustTraceSessionName[] =
     L"Sawdust logging session";
+const wchar_t TracerController::kRotatedLogSuffix[] = L"_rotated";
 
 HRESULT TracerController::Start(const TracerConfiguration& config) {
   base::AutoLock lock(start_stop_lock_);
@@ -30,6 +35,14 @@ HRESULT TracerController::Start(const TracerConfiguration& config) {
   mru_start_point_ = base::Time();  // Set to null.
   acquired_kernel_log_.clear();  // Indicate there is no 'completed' log.
   acquired_chrome_log_.clear();
+  flight_recorder_ = false;
+  flight_recorder_kernel_log_.clear();
+  flight_recorder_chrome_log_.clear();
+  configured_kernel_log_.clear();
+  configured_chrome_log_.clear();
+  active_kernel_log_.clear();
+  active_chrome_log_.clear();
+  rotation_count_ = 0;
 
   if (!VerifyAndStopIfRunning(KERNEL_LOGGER_NAME) ||
       !VerifyAndStopIfRunning(kSawdustTraceSessionName)) {
@@ -45,19 +58,34 @@ HRESULT TracerController::Start(const TracerConfiguration& config) {
     return E_FAIL;
   }
 
+  bool flight_recorder = config.IsFlightRecorderEnabled();
+  TracerConfiguration::SnapshotTriggers triggers;
+  bool watch_log = config.GetSnapshotTriggers(&triggers);
+  if (watch_log && flight_recorder) {
+    // A buffering session can't be consumed in real time.
+    LOG(WARNING) << "Snapshot triggers are ignored by a flight recorder.";
+    watch_log = false;
+  }
+
   HRESULT hr = S_OK;
   {
     base::win::EtwTraceProperties trace_definition;
-    trace_definition.SetLoggerFileName(log_path.value().c_str());
     EVENT_TRACE_PROPERTIES* p = trace_definition.get();
     p->Wnode.ClientContext = 1;  // QPC timer accuracy.
 
-    // Circular log, and get the entire space right away to avoid any trouble.
-    p->LogFileMode = EVENT_TRACE_FILE_MODE_CIRCULAR |
-                    EVENT_TRACE_FILE_MODE_PREALLOCATE;
-
-    p->MaximumFileSize = config.GetLogFileSizeCapMb();
-    p->FlushTimer = 30;  // 30 seconds flush lag.
+    if (flight_recorder) {
+      SetUpFlightRecorder(config.GetLogFileSizeCapMb(), p);
+    } else {
+      trace_definition.SetLoggerFileName(log_path.value().c_str());
+      // Circular log, and get the entire space right away to avoid any
+      // trouble.
+      p->LogFileMode = EVENT_TRACE_FILE_MODE_CIRCULAR |
+                      EVENT_TRACE_FILE_MODE_PREALLOCATE;
+      p->MaximumFileSize = config.GetLogFileSizeCapMb();
+      p->FlushTimer = 30;  // 30 seconds flush lag.
+    }
+    if (watch_log)
+      p->LogFileMode |= EVENT_TRACE_REAL_TIME_MODE;
     hr = StartLogging(&log_controller_, &trace_definition,
                       kSawdustTraceSessionName);
   }
@@ -70,16 +98,21 @@ HRESULT TracerController::Start(const TracerConfiguration& config) {
 
   if (config.IsKernelLoggingEnabled()) {
     base::win::EtwTraceProperties trace_definition;
-    trace_definition.SetLoggerFileName(kernel_path.value().c_str());
     EVENT_TRACE_PROPERTIES* p = trace_definition.get();
     p->Wnode.Guid = SystemTraceControlGuid;
-    p->LogFileMode = EVENT_TRACE_FILE_MODE_CIRCULAR |
-                     EVENT_TRACE_FILE_MODE_PREALLOCATE;
-    p->MaximumFileSize = config.GetKernelLogFileSizeCapMb();
-    // Get image load and process events.
-    p->EnableFlags = EVENT_TRACE_FLAG_IMAGE_LOAD | EVENT_TRACE_FLAG_PROCESS;
-    p->FlushTimer = 1;  // flush every second.
-    p->BufferSize = 16;  // 16 K buffers.
+    if (flight_recorder) {
+      SetUpFlightRecorder(config.GetKernelLogFileSizeCapMb(), p);
+    } else {
+      trace_definition.SetLoggerFileName(kernel_path.value().c_str());
+      p->LogFileMode = EVENT_TRACE_FILE_MODE_CIRCULAR |
+                       EVENT_TRACE_FILE_MODE_PREALLOCATE;
+      p->MaximumFileSize = config.GetKernelLogFileSizeCapMb();
+      p->FlushTimer = 1;  // flush every second.
+      p->BufferSize = 16;  // 16 K buffers.
+    }
+    // Get the events of the kernel profile, image load and process events
+    // at the least.
+    p->EnableFlags = config.GetKernelEnableFlags();
     hr = StartLogging(&kernel_controller_, &trace_definition,
                       KERNEL_LOGGER_NAME);
 
@@ -90,19 +123,70 @@ HRESULT TracerController::Start(const TracerConfiguration& config) {
     }
   }
 
+  if (flight_recorder) {
+    flight_recorder_ = true;
+    flight_recorder_chrome_log_ = log_path;
+    if (config.IsKernelLoggingEnabled())
+      flight_recorder_kernel_log_ = kernel_path;
+  } else {
+    configured_chrome_log_ = log_path;
+    active_chrome_log_ = log_path;
+    if (config.IsKernelLoggingEnabled()) {
+      configured_kernel_log_ = kernel_path;
+      active_kernel_log_ = kernel_path;
+    }
+  }
+
   initialized_providers_.clear();
   EnableProviders(config.settings(), &initialized_providers_);
   mru_start_point_ = base::Time::Now();  // Keep the start point around.
 
+  {
+    base::AutoLock snapshot_lock(snapshot_lock_);
+    snapshots_.clear();
+    snapshot_source_ = log_path;
+    snapshot_window_ = base::TimeDelta::FromSeconds(triggers.snapshot_seconds);
+  }
+  if (watch_log) {
+    // Logging goes on without the snapshots.
+    HRESULT hr_watch = StartWatching(triggers);
+    LOG_IF(ERROR, FAILED(hr_watch)) << "Failed to watch the log. " <<
+        com::LogHr(hr_watch);
+  }
+
   return initialized_providers_.empty() ? S_FALSE : hr;
 }
 
 HRESULT TracerController::Stop() {
   base::AutoLock lock(start_stop_lock_);
 
+  if (watcher_ != NULL) {
+    watcher_->StopWatching();
+    watcher_.reset();
+  }
+
+  if (flight_recorder_) {
+    // A session that fails to dump stops all the same, its log is lost.
+    if (!flight_recorder_kernel_log_.empty()) {
+      HRESULT hr_dump = DumpToFile(&kernel_controller_, KERNEL_LOGGER_NAME,
+                                   flight_recorder_kernel_log_);
+      LOG_IF(ERROR, FAILED(hr_dump)) << "Failed to dump the kernel log. "
+          << com::LogHr(hr_dump);
+    }
+    if (!flight_recorder_chrome_log_.empty()) {
+      HRESULT hr_dump = DumpToFile(&log_controller_, kSawdustTraceSessionName,
+                                   flight_recorder_chrome_log_);
+      LOG_IF(ERROR, FAILED(hr_dump)) << "Failed to dump the log. "
+          << com::LogHr(hr_dump);
+    }
+    flight_recorder_ = false;
+  }
+
   StopKernelLogging(&acquired_kernel_log_);
 
   HRESULT hr = StopLogging(&initialized_providers_, &acquired_chrome_log_);
+  active_kernel_log_.clear();
+  active_chrome_log_.clear();
 
   if (FAILED(hr))
     return hr;
@@ -110,6 +194,52 @@ HRESULT TracerController::Stop() {
   return initialized_providers_.empty() ? S_OK : E_FAIL;
 }
 
+HRESULT TracerController::Rotate() {
+  base::AutoLock lock(start_stop_lock_);
+  if (flight_recorder_ || active_chrome_log_.empty()) {
+    LOG(ERROR) << "There is no session logging to a file to rotate.";
+    return E_UNEXPECTED;
+  }
+
+  FilePath chrome_log_path(
+      GetRotatedLogPath(configured_chrome_log_, rotation_count_ + 1));
+  HRESULT hr = SwitchLogFile(&log_controller_, kSawdustTraceSessionName,
+                             chrome_log_path);
+  if (FAILED(hr)) {
+    LOG(ERROR) << "Failed to rotate the log. " << com::LogHr(hr);
+    return hr;
+  }
+  ++rotation_count_;
+  acquired_chrome_log_ = active_chrome_log_;
+  active_chrome_log_ = chrome_log_path;
+
+  // A kernel log that fails to switch goes on in the same file, and is left
+  // out of the report.
+  acquired_kernel_log_.clear();
+  if (!active_kernel_log_.empty()) {
+    FilePath kernel_log_path(
+        GetRotatedLogPath(configured_kernel_log_, rotation_count_));
+    HRESULT hr_kernel = SwitchLogFile(&kernel_controller_, KERNEL_LOGGER_NAME,
+                                      kernel_log_path);
+    if (SUCCEEDED(hr_kernel)) {
+      acquired_kernel_log_ = active_kernel_log_;
+      active_kernel_log_ = kernel_log_path;
+    } else {
+      LOG(ERROR) << "Failed to rotate the kernel log. " <<
+          com::LogHr(hr_kernel);
+    }
+  }
+
+  mru_start_point_ = base::Time::Now();
+
+  {
+    base::AutoLock snapshot_lock(snapshot_lock_);
+    snapshot_source_ = chrome_log_path;
+  }
+
+  return S_OK;
+}
+
 bool TracerController::IsRunning() const {
   base::AutoLock lock(start_stop_lock_);
 
@@ -118,6 +248,35 @@ bool TracerController::IsRunning() const {
          (kernel_controller_.session() != NULL);
 }
 
+void TracerController::GetSnapshots(Snapshots* snapshots) const {
+  DCHECK(snapshots != NULL);
+  base::AutoLock lock(snapshot_lock_);
+  *snapshots = snapshots_;
+}
+
+void TracerController::OnSnapshotTrigger(const std::string& reason,
+                                         base::Time time) {
+  base::AutoLock lock(snapshot_lock_);
+  Snapshot snapshot;
+  snapshot.log_path = snapshot_source_.InsertBeforeExtension(
+      base::StringPrintf(L"_snapshot%d", snapshots_.size() + 1));
+  HRESULT hr = CopyLog(snapshot_source_, snapshot.log_path);
+  if (FAILED(hr)) {
+    LOG(ERROR) << "Failed to take a snapshot of the log. " << com::LogHr(hr);
+    return;
+  }
+
+  snapshot.reason = reason;
+  snapshot.time = time;
+  snapshot.window = snapshot_window_;
+  snapshots_.push_back(snapshot);
+}
+
+bool TracerController::IsFlightRecorder() const {
+  base::AutoLock lock(start_stop_lock_);
+  return flight_recorder_;
+}
+
 bool TracerController::GetCompletedEventLogFileName(FilePath* event_log) const {
   DCHECK(event_log != NULL);
   base::AutoLock lock(start_stop_lock_);
@@ -198,6 +357,83 @@ void TracerController::EnableProviders(
   }
 }
 
+HRESULT TracerController::DumpToFile(
+    base::win::EtwTraceController* controller,
+    const wchar_t* session_name,
+    const FilePath& log_path) {
+  DCHECK(controller != NULL);
+  base::win::EtwTraceProperties properties;
+  HRESULT hr = base::win::EtwTraceController::Query(session_name, &properties);
+  if (FAILED(hr))
+    return hr;
+
+  // Giving the buffering session a file to write to makes it one, and it
+  // flushes what it has in memory there. It is stopped right after.
+  hr = properties.SetLoggerFileName(log_path.value().c_str());
+  if (FAILED(hr))
+    return hr;
+  properties.get()->LogFileMode = EVENT_TRACE_FILE_MODE_SEQUENTIAL;
+  return base::win::EtwTraceController::Update(session_name, &properties);
+}
+
+HRESULT TracerController::SwitchLogFile(
+    base::win::EtwTraceController* controller,
+    const wchar_t* session_name,
+    const FilePath& log_path) {
+  DCHECK(controller != NULL);
+  base::win::EtwTraceProperties properties;
+  HRESULT hr = base::win::EtwTraceController::Query(session_name, &properties);
+  if (FAILED(hr))
+    return hr;
+
+  // The session closes the file it has been writing to, and carries on in
+  // the new one with the same mode and size.
+  hr = properties.SetLoggerFileName(log_path.value().c_str());
+  if (FAILED(hr))
+    return hr;
+  return base::win::EtwTraceController::Update(session_name, &properties);
+}
+
+HRESULT TracerController::StartWatching(
+    const TracerConfiguration::SnapshotTriggers& triggers) {
+  DCHECK(watcher_ == NULL);
+  watcher_.reset(new LogWatcher(triggers, this));
+  HRESULT hr = watcher_->StartWatching(kSawdustTraceSessionName);
+  if (FAILED(hr))
+    watcher_.reset();
+  return hr;
+}
+
+HRESULT TracerController::CopyLog(const FilePath& log_path,
+                                  const FilePath& snapshot_path) {
+  // The log is only complete up to the last time the buffers went out.
+  base::win::EtwTraceProperties properties;
+  HRESULT hr = base::win::EtwTraceController::Flush(kSawdustTraceSessionName,
+                                                    &properties);
+  if (FAILED(hr))
+    return hr;
+
+  return file_util::CopyFile(log_path, snapshot_path) ? S_OK : E_FAIL;
+}
+
+FilePath TracerController::GetRotatedLogPath(const FilePath& configured_path,
+                                             int rotation) {
+  if (rotation % 2 == 0)
+    return configured_path;
+  return configured_path.InsertBeforeExtension(kRotatedLogSuffix);
+}
+
+void TracerController::SetUpFlightRecorder(
+    unsigned size_mb, EVENT_TRACE_PROPERTIES* properties) {
+  DCHECK(properties != NULL);
+  // The buffers are all allocated up front, and reused round and round.
+  ULONG buffer_count = size_mb * 1024 / kFlightRecorderBufferKb;
+  properties->LogFileMode = EVENT_TRACE_BUFFERING_MODE;
+  properties->BufferSize = kFlightRecorderBufferKb;
+  properties->MinimumBuffers = std::max(buffer_count, 2UL);
+  properties->MaximumBuffers = properties->MinimumBuffers;
+}
+
 bool TracerController::VerifyAndStopIfRunning(
     const wchar_t* session_name) const {
   // Try and query the session properties.
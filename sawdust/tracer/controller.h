@@ -17,36 +17,76 @@
 #define SAWDUST_TRACER_CONTROLLER_H_
 
 #include <windows.h>
+#include <string>
 #include <vector>
 
 #include "base/file_path.h"
+#include "base/scoped_ptr.h"
 #include "base/synchronization/lock.h"
 #include "base/time.h"
 #include "base/win/event_trace_controller.h"
 
 #include "sawdust/tracer/configuration.h"
+#include "sawdust/tracer/log_watcher.h"
 
 // The controller (you really want one at a time) starts and stops logging
 // sessions as defined by the configuration object passed to the Start method.
+// When the configuration has snapshot triggers, the application session is
+// also watched as it is being logged, and a copy of its log is taken each
+// time a trigger fires.
 // This class is thread safe.
-class TracerController {
+class TracerController : public LogWatcher::Delegate {
  public:
+  // A copy of the application log, taken as a trigger fired.
+  struct Snapshot {
+    FilePath log_path;
+    // What fired, and the time of the event it fired on.
+    std::string reason;
+    base::Time time;
+    // The length of log leading up to |time| the snapshot is about.
+    base::TimeDelta window;
+  };
+  typedef std::vector<Snapshot> Snapshots;
+
   static const wchar_t kSawdustTraceSessionName[];
   static const int kMinimalLogAgeInSeconds = 180;
 
-  TracerController() { }
+  // The size of the memory buffers of flight recorder sessions, in KB.
+  static const unsigned kFlightRecorderBufferKb = 64;
+
+  // The suffix of the file the sessions alternate to on every other
+  // rotation.
+  static const wchar_t kRotatedLogSuffix[];
+
+  TracerController() : flight_recorder_(false), rotation_count_(0) { }
   virtual ~TracerController() { }
 
   // Commences logging as defined in settings. It is a breach of contract to
   // call start while a session is ongoing. Successful call to Start will
-  // create disk files as defined in config.
+  // create disk files as defined in config, unless the config asks for a
+  // flight recorder. The sessions are then held in circular memory buffers,
+  // sized as the files would be, and nothing is written to disk until Stop.
   HRESULT Start(const TracerConfiguration& config);
 
   // Stops the current logging session. If successful, paths of acquired logs
   // can be retrieved usign GetComplete* functions. These files are left on the
-  // disk (the controller doesn't own them).
+  // disk (the controller doesn't own them). A flight recorder's buffers are
+  // dumped to the files first.
   HRESULT Stop();
 
+  // Switches the current sessions over to fresh log files without stopping
+  // them, so that no events are lost while the logs so far are reported. If
+  // successful, the logs written up to now are complete, and their paths can
+  // be retrieved using the GetCompleted* functions, while logging carries on.
+  // The sessions alternate between the files of the configuration and files
+  // of kRotatedLogSuffix next to them, so a completed log is written over
+  // by the rotation after next. Flight recorders, whose logs only reach the
+  // disk as they stop, can't be rotated.
+  HRESULT Rotate();
+
+  // Whether the current sessions are held in memory.
+  bool IsFlightRecorder() const;
+
   virtual bool IsRunning() const;
   bool IsLogWorthSaving() const;
   base::TimeDelta GetLoggingTimeSpan() const;
@@ -57,10 +97,17 @@ class TracerController {
   virtual bool GetCurrentKernelEventLogFileName(FilePath* event_log) const;
 
   // Query functions for retrieving completed log file names. Valid only once
-  // logging session has been closed (by calling 'stop').
+  // logging session has been closed (by calling 'stop'), or rotated.
   virtual bool GetCompletedEventLogFileName(FilePath* event_log) const;
   virtual bool GetCompletedKernelEventLogFileName(FilePath* event_log) const;
 
+  // Retrieves the snapshots the current or last session took. Like the logs,
+  // their files are left on the disk once logging stopped.
+  void GetSnapshots(Snapshots* snapshots) const;
+
+  // LogWatcher::Delegate implementation, takes a snapshot.
+  virtual void OnSnapshotTrigger(const std::string& reason, base::Time time);
+
  private:
   // A call to the Start method of the controller. Intended as a test seam only.
   virtual HRESULT StartLogging(base::win::EtwTraceController* controller,
@@ -74,6 +121,39 @@ class TracerController {
       const TracerConfiguration::ProviderDefinitions& requested,
       TracerConfiguration::ProviderDefinitions* enabled);
 
+  // Switches the in-memory session |session_name| run by |controller| to
+  // write to |log_path|, which flushes its buffers there. Made virtual to
+  // serve as a test seam.
+  virtual HRESULT DumpToFile(base::win::EtwTraceController* controller,
+                             const wchar_t* session_name,
+                             const FilePath& log_path);
+
+  // Switches the session |session_name| run by |controller| over to writing
+  // to |log_path|, in the mode it logs in, which completes the file it wrote
+  // to until now. Made virtual to serve as a test seam.
+  virtual HRESULT SwitchLogFile(base::win::EtwTraceController* controller,
+                                const wchar_t* session_name,
+                                const FilePath& log_path);
+
+  // Starts watching the application session for |triggers|. Made virtual to
+  // serve as a test seam.
+  virtual HRESULT StartWatching(
+      const TracerConfiguration::SnapshotTriggers& triggers);
+
+  // Flushes the application session, and copies its log from |log_path| to
+  // |snapshot_path|. Made virtual to serve as a test seam.
+  virtual HRESULT CopyLog(const FilePath& log_path,
+                          const FilePath& snapshot_path);
+
+  // Returns the file the session configured to log to |configured_path|
+  // writes to after |rotation| rotations.
+  static FilePath GetRotatedLogPath(const FilePath& configured_path,
+                                    int rotation);
+
+  // Sets |properties| up for an in-memory circular session of |size_mb|.
+  static void SetUpFlightRecorder(unsigned size_mb,
+                                  EVENT_TRACE_PROPERTIES* properties);
+
   // If a session identified by |session_name| is running, stop it. Returns
   // false if a session was running, but couldn't be stopped, true otherwise.
   // Made virtual to serve as a test seam.
@@ -112,9 +192,36 @@ class TracerController {
   FilePath acquired_kernel_log_;
   FilePath acquired_chrome_log_;
 
+  // The files of the configuration, the files the sessions write to now,
+  // empty for a flight recorder or a session that isn't running, and the
+  // number of rotations since the sessions started.
+  FilePath configured_kernel_log_;
+  FilePath configured_chrome_log_;
+  FilePath active_kernel_log_;
+  FilePath active_chrome_log_;
+  int rotation_count_;
+
+  // Whether the sessions are held in memory, and the files they are dumped
+  // to when they stop.
+  bool flight_recorder_;
+  FilePath flight_recorder_kernel_log_;
+  FilePath flight_recorder_chrome_log_;
+
   base::Time mru_start_point_;
   mutable base::Lock start_stop_lock_;
 
+  // Watches the application session, when there are snapshot triggers. It
+  // is only started and stopped along with the sessions.
+  scoped_ptr<LogWatcher> watcher_;
+
+  // The log snapshots are taken of and their window, as well as the
+  // snapshots taken. Taken on the watcher's thread, they have their own lock
+  // so that Stop can hold start_stop_lock_ while the watcher winds down.
+  FilePath snapshot_source_;
+  base::TimeDelta snapshot_window_;
+  Snapshots snapshots_;
+  mutable base::Lock snapshot_lock_;
+
   DISALLOW_COPY_AND_ASSIGN(TracerController);
 };
 
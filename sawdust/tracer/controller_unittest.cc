@@ -46,11 +46,21 @@ class MockTracerController : public TracerController {
   MOCK_METHOD1(StopKernelLogging, bool(FilePath*));
   MOCK_METHOD2(StopLogging, HRESULT(TracerConfiguration::ProviderDefinitions*,
                                     FilePath*));
+  MOCK_METHOD3(DumpToFile, HRESULT(base::win::EtwTraceController*,
+                                   const wchar_t*,
+                                   const FilePath&));
+  MOCK_METHOD3(SwitchLogFile, HRESULT(base::win::EtwTraceController*,
+                                      const wchar_t*,
+                                      const FilePath&));
+  MOCK_METHOD1(StartWatching,
+               HRESULT(const TracerConfiguration::SnapshotTriggers&));
+  MOCK_METHOD2(CopyLog, HRESULT(const FilePath&, const FilePath&));
 };
 
 class TracerControllerTest : public testing::Test {
  public:
   typedef std::map<std::wstring, std::wstring> PathMapType;
+  typedef std::map<std::wstring, ULONG> LogModeMapType;
   static const wchar_t kFakeWorkingDir[];
 
   void SetUp() {
@@ -85,6 +95,8 @@ class TracerControllerTest : public testing::Test {
                                 const wchar_t* logger) {
     intercepted_logger_paths_.insert(
         PathMapType::value_type(logger, properties->GetLoggerFileName()));
+    intercepted_log_modes_.insert(
+        LogModeMapType::value_type(logger, properties->get()->LogFileMode));
     return S_OK;
   }
 
@@ -98,6 +110,7 @@ class TracerControllerTest : public testing::Test {
   scoped_ptr<Value> configurations_;
   ScopedTempDir temp_dir_;
   PathMapType intercepted_logger_paths_;
+  LogModeMapType intercepted_log_modes_;
   TracerConfiguration::ProviderDefinitions intercepted_providers_;
 };
 
@@ -232,4 +245,194 @@ TEST_F(TracerControllerTest, TestWithKernelAndPaths) {
   ASSERT_EQ(intercepted_providers_.size(), 1);
 }
 
+TEST_F(TracerControllerTest, TestFlightRecorder) {
+  TracerConfiguration config;
+  ASSERT_NO_FATAL_FAILURE(RetrieveConfiguration("flight-recorder", &config));
+
+  FilePath app_file, kernel_file;
+  ASSERT_TRUE(config.GetLogFileName(&app_file));
+  ASSERT_TRUE(config.GetKernelLogFileName(&kernel_file));
+
+  // Expectations: both sessions are held in memory, with no file until they
+  // are dumped to the ones in settings on Stop.
+  MockTracerController controller;
+  EXPECT_CALL(controller, VerifyAndStopIfRunning(_)).
+      WillRepeatedly(Return(true));
+  EXPECT_CALL(controller, StartLogging(_, _, StrEq(KERNEL_LOGGER_NAME))).
+      WillOnce(Invoke(this, &TracerControllerTest::InterceptStartLogging));
+  EXPECT_CALL(controller, StartLogging(_, _,
+      StrEq(TracerController::kSawdustTraceSessionName))).
+          WillOnce(Invoke(this, &TracerControllerTest::InterceptStartLogging));
+  EXPECT_CALL(controller, EnableProviders(_, _)).Times(1);
+
+  ASSERT_HRESULT_SUCCEEDED(controller.Start(config));
+  ASSERT_TRUE(controller.IsFlightRecorder());
+
+  ASSERT_EQ(2, intercepted_logger_paths_.size());
+  EXPECT_TRUE(intercepted_logger_paths_[KERNEL_LOGGER_NAME].empty());
+  EXPECT_TRUE(intercepted_logger_paths_[
+      TracerController::kSawdustTraceSessionName].empty());
+  EXPECT_EQ(EVENT_TRACE_BUFFERING_MODE,
+            intercepted_log_modes_[KERNEL_LOGGER_NAME]);
+  EXPECT_EQ(EVENT_TRACE_BUFFERING_MODE,
+            intercepted_log_modes_[TracerController::kSawdustTraceSessionName]);
+
+  // There's no file to rotate out until the buffers are dumped.
+  EXPECT_CALL(controller, SwitchLogFile(_, _, _)).Times(0);
+  EXPECT_HRESULT_FAILED(controller.Rotate());
+
+  EXPECT_CALL(controller, DumpToFile(_, StrEq(KERNEL_LOGGER_NAME),
+                                     kernel_file)).WillOnce(Return(S_OK));
+  EXPECT_CALL(controller, DumpToFile(_,
+      StrEq(TracerController::kSawdustTraceSessionName), app_file)).
+          WillOnce(Return(S_OK));
+  EXPECT_CALL(controller, StopKernelLogging(_)).WillOnce(DoAll(
+      SetArgumentPointee<0>(kernel_file), Return(true)));
+  EXPECT_CALL(controller, StopLogging(_, _)).WillOnce(DoAll(
+      SetArgumentPointee<0>(TracerConfiguration::ProviderDefinitions()),
+      SetArgumentPointee<1>(app_file),
+      Return(true)));
+  ASSERT_HRESULT_SUCCEEDED(controller.Stop());
+  ASSERT_FALSE(controller.IsFlightRecorder());
+
+  FilePath ret_app_path, ret_kernel_path;
+  ASSERT_TRUE(controller.GetCompletedEventLogFileName(&ret_app_path));
+  ASSERT_EQ(app_file, ret_app_path);
+  ASSERT_TRUE(controller.GetCompletedKernelEventLogFileName(&ret_kernel_path));
+  ASSERT_EQ(kernel_file, ret_kernel_path);
+}
+
+TEST_F(TracerControllerTest, TestRotate) {
+  TracerConfiguration config;
+  ASSERT_NO_FATAL_FAILURE(
+      RetrieveConfiguration("complete-definition", &config));
+
+  FilePath app_file, kernel_file;
+  ASSERT_TRUE(config.GetLogFileName(&app_file));
+  ASSERT_TRUE(config.GetKernelLogFileName(&kernel_file));
+  FilePath rotated_app_file(
+      app_file.InsertBeforeExtension(TracerController::kRotatedLogSuffix));
+  FilePath rotated_kernel_file(
+      kernel_file.InsertBeforeExtension(TracerController::kRotatedLogSuffix));
+
+  MockTracerController controller;
+  EXPECT_CALL(controller, VerifyAndStopIfRunning(_)).
+      WillRepeatedly(Return(true));
+  EXPECT_CALL(controller, StartLogging(_, _, _)).
+      WillRepeatedly(Return(S_OK));
+  EXPECT_CALL(controller, EnableProviders(_, _)).
+      WillOnce(Invoke(this, &TracerControllerTest::InterceptEnableProviders));
+
+  // Rotating before a session started fails.
+  EXPECT_CALL(controller, SwitchLogFile(_, _, _)).Times(0);
+  EXPECT_HRESULT_FAILED(controller.Rotate());
+
+  ASSERT_HRESULT_SUCCEEDED(controller.Start(config));
+  FilePath ret_app_path, ret_kernel_path;
+  EXPECT_FALSE(controller.GetCompletedEventLogFileName(&ret_app_path));
+
+  // The first rotation switches both sessions to the rotated files, and
+  // completes the files of the configuration.
+  EXPECT_CALL(controller, SwitchLogFile(_,
+      StrEq(TracerController::kSawdustTraceSessionName), rotated_app_file)).
+          WillOnce(Return(S_OK));
+  EXPECT_CALL(controller, SwitchLogFile(_, StrEq(KERNEL_LOGGER_NAME),
+                                        rotated_kernel_file)).
+      WillOnce(Return(S_OK));
+  ASSERT_HRESULT_SUCCEEDED(controller.Rotate());
+  ASSERT_TRUE(controller.GetCompletedEventLogFileName(&ret_app_path));
+  EXPECT_EQ(app_file, ret_app_path);
+  ASSERT_TRUE(controller.GetCompletedKernelEventLogFileName(&ret_kernel_path));
+  EXPECT_EQ(kernel_file, ret_kernel_path);
+
+  // The next switches back. A kernel session that fails to switch leaves
+  // no completed kernel log.
+  EXPECT_CALL(controller, SwitchLogFile(_,
+      StrEq(TracerController::kSawdustTraceSessionName), app_file)).
+          WillOnce(Return(S_OK));
+  EXPECT_CALL(controller, SwitchLogFile(_, StrEq(KERNEL_LOGGER_NAME),
+                                        kernel_file)).
+      WillOnce(Return(E_FAIL));
+  ASSERT_HRESULT_SUCCEEDED(controller.Rotate());
+  ASSERT_TRUE(controller.GetCompletedEventLogFileName(&ret_app_path));
+  EXPECT_EQ(rotated_app_file, ret_app_path);
+  EXPECT_FALSE(controller.GetCompletedKernelEventLogFileName(&ret_kernel_path));
+
+  // A log session that fails to switch fails the rotation, and leaves the
+  // completed logs as they were.
+  EXPECT_CALL(controller, SwitchLogFile(_,
+      StrEq(TracerController::kSawdustTraceSessionName), rotated_app_file)).
+          WillOnce(Return(E_FAIL));
+  EXPECT_HRESULT_FAILED(controller.Rotate());
+  ASSERT_TRUE(controller.GetCompletedEventLogFileName(&ret_app_path));
+  EXPECT_EQ(rotated_app_file, ret_app_path);
+
+  EXPECT_CALL(controller, StopKernelLogging(_)).WillOnce(DoAll(
+      SetArgumentPointee<0>(rotated_kernel_file), Return(true)));
+  EXPECT_CALL(controller, StopLogging(_, _)).WillOnce(DoAll(
+      SetArgumentPointee<0>(TracerConfiguration::ProviderDefinitions()),
+      SetArgumentPointee<1>(app_file),
+      Return(true)));
+  ASSERT_HRESULT_SUCCEEDED(controller.Stop());
+
+  // Once stopped, there's nothing to rotate.
+  EXPECT_HRESULT_FAILED(controller.Rotate());
+}
+
+TEST_F(TracerControllerTest, TestSnapshotTriggers) {
+  TracerConfiguration config;
+  ASSERT_NO_FATAL_FAILURE(RetrieveConfiguration("snapshot-triggers", &config));
+
+  FilePath app_file;
+  ASSERT_TRUE(config.GetLogFileName(&app_file));
+
+  // Expectations: the application session is also logged in real time, and
+  // watched.
+  MockTracerController controller;
+  EXPECT_CALL(controller, VerifyAndStopIfRunning(_)).
+      WillRepeatedly(Return(true));
+  EXPECT_CALL(controller, StartLogging(_, _,
+      StrEq(TracerController::kSawdustTraceSessionName))).
+          WillOnce(Invoke(this, &TracerControllerTest::InterceptStartLogging));
+  EXPECT_CALL(controller, EnableProviders(_, _)).Times(1);
+  EXPECT_CALL(controller, StartWatching(_)).WillOnce(Return(S_OK));
+
+  ASSERT_HRESULT_SUCCEEDED(controller.Start(config));
+  EXPECT_EQ(app_file.value(),
+            intercepted_logger_paths_[
+                TracerController::kSawdustTraceSessionName]);
+  EXPECT_NE(0U, intercepted_log_modes_[
+      TracerController::kSawdustTraceSessionName] &
+          EVENT_TRACE_REAL_TIME_MODE);
+
+  // A trigger copies the log, and a copy that fails takes no snapshot.
+  base::Time trigger_time = base::Time::Now();
+  EXPECT_CALL(controller, CopyLog(app_file, _)).
+      WillOnce(Return(S_OK)).
+      WillOnce(Return(E_FAIL));
+  controller.OnSnapshotTrigger("Log message at level 2: Oops", trigger_time);
+  controller.OnSnapshotTrigger("Log message at level 2: Oops", trigger_time);
+
+  TracerController::Snapshots snapshots;
+  controller.GetSnapshots(&snapshots);
+  ASSERT_EQ(1U, snapshots.size());
+  EXPECT_NE(app_file, snapshots[0].log_path);
+  EXPECT_TRUE(app_file.DirName() == snapshots[0].log_path.DirName());
+  EXPECT_EQ("Log message at level 2: Oops", snapshots[0].reason);
+  EXPECT_EQ(trigger_time, snapshots[0].time);
+  EXPECT_EQ(30, snapshots[0].window.InSeconds());
+
+  EXPECT_CALL(controller, StopKernelLogging(_)).WillOnce(Return(false));
+  EXPECT_CALL(controller, StopLogging(_, _)).WillOnce(DoAll(
+      SetArgumentPointee<0>(TracerConfiguration::ProviderDefinitions()),
+      SetArgumentPointee<1>(app_file),
+      Return(true)));
+  ASSERT_HRESULT_SUCCEEDED(controller.Stop());
+
+  // The snapshots outlive the session.
+  snapshots.clear();
+  controller.GetSnapshots(&snapshots);
+  EXPECT_EQ(1U, snapshots.size());
+}
+
 }  // namespace
@@ -0,0 +1,237 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log summarizer implementation.
+#include "sawdust/tracer/log_summarizer.h"
+
+#include <algorithm>
+
+#include "base/json/json_writer.h"
+#include "base/logging.h"
+#include "base/scoped_ptr.h"
+#include "base/values.h"
+
+namespace {
+
+const char* const kLevelNames[] = {
+  "none", "critical", "error", "warning", "information", "verbose",
+};
+
+// Orders the sites by count, most first, then by file and line.
+bool SiteGoesFirst(const LogSummarizer::Site& a, const LogSummarizer::Site& b) {
+  if (a.count != b.count)
+    return a.count > b.count;
+  if (a.file != b.file)
+    return a.file < b.file;
+  return a.line < b.line;
+}
+
+// Counts that overflow a JSON integer go as doubles.
+Value* CreateCountValue(uint64 count) {
+  if (count <= static_cast<uint64>(kint32max))
+    return Value::CreateIntegerValue(static_cast<int>(count));
+  return Value::CreateDoubleValue(static_cast<double>(count));
+}
+
+double ToMilliseconds(base::TimeDelta delta) {
+  return delta.InMicroseconds() / 1000.0;
+}
+
+}  // namespace
+
+LogSummarizer::LogSummarizer()
+    : max_sites_(kDefaultMaxSites), total_message_count_(0),
+      lost_event_count_(0), lost_buffer_count_(0) {
+  COMPILE_ASSERT(arraysize(kLevelNames) == TRACE_LEVEL_VERBOSE + 1,
+                 level_names_cover_the_levels);
+  std::fill(level_counts_, level_counts_ + arraysize(level_counts_), 0);
+
+  // The messages go without their text, which the summary has no use for.
+  parser_.set_event_sink(this);
+  parser_.set_trace_sink(&span_matcher_);
+  parser_.set_string_table(&string_table_);
+  parser_.set_log_fields(LogEvents::FIELD_FILE_LINE);
+  // The parser's own filter is relative to the first event, which would
+  // drop the events a log holds out of order, so we open it all the way.
+  LogParser::EventFilter filter;
+  filter.from = base::TimeDelta::FromMicroseconds(kint64min);
+  parser_.set_event_filter(filter);
+
+  kernel_parser_.set_process_event_sink(this);
+}
+
+LogSummarizer::~LogSummarizer() {
+}
+
+HRESULT LogSummarizer::AddLog(const FilePath& log_path) {
+  EtlFileReader reader;
+  HRESULT hr = reader.Open(log_path);
+  if (FAILED(hr))
+    return hr;
+
+  return reader.Consume(this);
+}
+
+uint64 LogSummarizer::message_count(UCHAR level) const {
+  return level < arraysize(level_counts_) ? level_counts_[level] : 0;
+}
+
+void LogSummarizer::GetTopSites(std::vector<Site>* sites) const {
+  DCHECK(sites != NULL);
+  sites->clear();
+  for (SiteCounts::const_iterator it = site_counts_.begin();
+       it != site_counts_.end(); ++it) {
+    Site site = { string_table_.GetString(it->first.first), it->first.second,
+                  it->second };
+    sites->push_back(site);
+  }
+
+  size_t kept = std::min(max_sites_, sites->size());
+  std::partial_sort(sites->begin(), sites->begin() + kept, sites->end(),
+                    SiteGoesFirst);
+  sites->resize(kept);
+}
+
+void LogSummarizer::WriteJson(std::string* json) {
+  DCHECK(json != NULL);
+  DictionaryValue summary;
+
+  DictionaryValue* messages = new DictionaryValue();
+  messages->Set("total", CreateCountValue(total_message_count_));
+  for (size_t level = TRACE_LEVEL_CRITICAL; level < arraysize(level_counts_);
+       ++level) {
+    messages->Set(kLevelNames[level], CreateCountValue(level_counts_[level]));
+  }
+  summary.Set("messages", messages);
+  summary.Set("lost_events", CreateCountValue(lost_event_count_));
+  summary.Set("lost_buffers", CreateCountValue(lost_buffer_count_));
+
+  std::vector<Site> top_sites;
+  GetTopSites(&top_sites);
+  ListValue* sites = new ListValue();
+  for (size_t i = 0; i < top_sites.size(); ++i) {
+    DictionaryValue* site = new DictionaryValue();
+    site->SetString("file", top_sites[i].file);
+    site->SetInteger("line", top_sites[i].line);
+    site->Set("count", CreateCountValue(top_sites[i].count));
+    sites->Append(site);
+  }
+  summary.Set("top_sites", sites);
+
+  // The times go in seconds since the Unix epoch.
+  ListValue* processes = new ListValue();
+  for (size_t i = 0; i < processes_.size(); ++i) {
+    const Process& process = processes_[i];
+    DictionaryValue* entry = new DictionaryValue();
+    entry->SetInteger("pid", static_cast<int>(process.process_id));
+    entry->SetString("image", process.image_name);
+    if (!process.start.is_null())
+      entry->SetDouble("start", process.start.ToDoubleT());
+    if (!process.end.is_null()) {
+      entry->SetDouble("end", process.end.ToDoubleT());
+      entry->SetInteger("exit_status", static_cast<int>(process.exit_status));
+    }
+    processes->Append(entry);
+  }
+  summary.Set("processes", processes);
+
+  std::vector<TraceSpanMatcher::DurationStats> stats;
+  span_matcher_.GetDurationStats(&stats);
+  ListValue* spans = new ListValue();
+  for (size_t i = 0; i < stats.size(); ++i) {
+    DictionaryValue* span = new DictionaryValue();
+    span->SetString("name", stats[i].name);
+    span->Set("count", CreateCountValue(stats[i].count));
+    span->SetDouble("total_ms", ToMilliseconds(stats[i].total));
+    span->SetDouble("p50_ms", ToMilliseconds(stats[i].p50));
+    span->SetDouble("p95_ms", ToMilliseconds(stats[i].p95));
+    span->SetDouble("p99_ms", ToMilliseconds(stats[i].p99));
+    span->SetDouble("max_ms", ToMilliseconds(stats[i].max));
+    spans->Append(span);
+  }
+  summary.Set("spans", spans);
+  summary.Set("unmatched_span_ends",
+              CreateCountValue(span_matcher_.unmatched_end_count()));
+
+  base::JSONWriter::Write(&summary, true, json);
+}
+
+void LogSummarizer::OnEvent(EVENT_TRACE* event) {
+  DCHECK(event != NULL);
+  if (!parser_.ProcessOneEvent(event))
+    kernel_parser_.ProcessOneEvent(event);
+}
+
+void LogSummarizer::OnBuffersLost(int64 time_stamp, size_t num_buffers) {
+  lost_buffer_count_ += num_buffers;
+}
+
+void LogSummarizer::OnLogMessage(const LogMessage& log_message) {
+  ++total_message_count_;
+  if (log_message.level < arraysize(level_counts_))
+    ++level_counts_[log_message.level];
+  // Messages issued by another parser than ours bring no atom of our table.
+  StringTable::Atom file_atom = log_message.file_atom;
+  if (file_atom == StringTable::kEmptyAtom && log_message.file_len != 0) {
+    file_atom = string_table_.Intern(
+        base::StringPiece(log_message.file, log_message.file_len));
+  }
+  if (file_atom != StringTable::kEmptyAtom)
+    ++site_counts_[std::make_pair(file_atom, log_message.line)];
+}
+
+void LogSummarizer::OnEventLoss(const EventLoss& event_loss) {
+  if (event_loss.type == EventLoss::BUFFERS_LOST)
+    lost_buffer_count_ += event_loss.count;
+  else
+    lost_event_count_ += event_loss.count;
+}
+
+void LogSummarizer::OnProcessIsRunning(const base::Time& time,
+                                       const ProcessInfo& process_info) {
+  FindOrAddProcess(process_info.process_id, process_info.image_name);
+}
+
+void LogSummarizer::OnProcessStarted(const base::Time& time,
+                                     const ProcessInfo& process_info) {
+  // A process id may be reused, once the process that had it ended.
+  running_processes_.erase(process_info.process_id);
+  Process* process = FindOrAddProcess(process_info.process_id,
+                                      process_info.image_name);
+  process->start = time;
+}
+
+void LogSummarizer::OnProcessEnded(const base::Time& time,
+                                   const ProcessInfo& process_info,
+                                   ULONG exit_status) {
+  Process* process = FindOrAddProcess(process_info.process_id,
+                                      process_info.image_name);
+  process->end = time;
+  process->exit_status = exit_status;
+  running_processes_.erase(process_info.process_id);
+}
+
+LogSummarizer::Process* LogSummarizer::FindOrAddProcess(
+    DWORD process_id, const std::string& image_name) {
+  std::map<DWORD, size_t>::iterator it = running_processes_.find(process_id);
+  if (it != running_processes_.end())
+    return &processes_[it->second];
+
+  Process process;
+  process.process_id = process_id;
+  process.image_name = image_name;
+  running_processes_[process_id] = processes_.size();
+  processes_.push_back(process);
+  return &processes_.back();
+}
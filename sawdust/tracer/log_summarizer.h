@@ -0,0 +1,141 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Summarizes logs on the device, ahead of uploading them.
+
+#ifndef SAWDUST_TRACER_LOG_SUMMARIZER_H_
+#define SAWDUST_TRACER_LOG_SUMMARIZER_H_
+
+#include <windows.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/file_path.h"
+#include "base/time.h"
+#include "sawbuck/log_lib/etl_file_reader.h"
+#include "sawbuck/log_lib/kernel_log_consumer.h"
+#include "sawbuck/log_lib/log_consumer.h"
+#include "sawbuck/log_lib/string_table.h"
+#include "sawbuck/log_lib/trace_span_matcher.h"
+
+// Boils application and kernel logs down to a few kilobytes of figures,
+// which a report can carry ahead of the logs themselves: the log messages
+// by level, the file:line sites that log the most, the lifetimes of the
+// processes the kernel log saw, and the percentiles of the durations of the
+// trace event spans. A single pass over each log does it, holding nothing
+// of the events but counts.
+class LogSummarizer : public EtlEventSink,
+                      public LogEvents,
+                      public KernelProcessEvents {
+ public:
+  // The default number of sites summarized.
+  static const size_t kDefaultMaxSites = 10;
+
+  // The messages logged from a line of a file.
+  struct Site {
+    std::string file;
+    int line;
+    uint64 count;
+  };
+
+  // A process of the kernel log. The times are null where the log doesn't
+  // tell them, for processes that were running as it began, or which
+  // outlived it.
+  struct Process {
+    Process() : process_id(0), exit_status(0) {}
+
+    DWORD process_id;
+    std::string image_name;
+    base::Time start;
+    base::Time end;
+    ULONG exit_status;  // Valid once the process ended.
+  };
+
+  LogSummarizer();
+  ~LogSummarizer();
+
+  // Sets the number of sites summarized, |kDefaultMaxSites| by default.
+  void set_max_sites(size_t max_sites) { max_sites_ = max_sites; }
+
+  // Reads the events of the log at |log_path|, application or kernel, into
+  // the summary.
+  HRESULT AddLog(const FilePath& log_path);
+
+  // Writes the summary as a JSON object to |json|.
+  void WriteJson(std::string* json);
+
+  // The messages logged at |level|, a TRACE_LEVEL_* value.
+  uint64 message_count(UCHAR level) const;
+  uint64 total_message_count() const { return total_message_count_; }
+  // The events and buffers the logs lost.
+  uint64 lost_event_count() const { return lost_event_count_; }
+  uint64 lost_buffer_count() const { return lost_buffer_count_; }
+
+  // Retrieves the sites logging the most to |sites|, most first.
+  void GetTopSites(std::vector<Site>* sites) const;
+
+  // The processes of the kernel logs, in the order they were first seen.
+  const std::vector<Process>& processes() const { return processes_; }
+
+  // Matches the trace events into spans, and times them.
+  TraceSpanMatcher* span_matcher() { return &span_matcher_; }
+
+  // EtlEventSink implementation.
+  virtual void OnEvent(EVENT_TRACE* event);
+  virtual void OnBuffersLost(int64 time_stamp, size_t num_buffers);
+
+  // LogEvents implementation.
+  virtual void OnLogMessage(const LogMessage& log_message);
+  virtual void OnEventLoss(const EventLoss& event_loss);
+
+  // KernelProcessEvents implementation.
+  virtual void OnProcessIsRunning(const base::Time& time,
+                                  const ProcessInfo& process_info);
+  virtual void OnProcessStarted(const base::Time& time,
+                                const ProcessInfo& process_info);
+  virtual void OnProcessEnded(const base::Time& time,
+                              const ProcessInfo& process_info,
+                              ULONG exit_status);
+
+ private:
+  // Finds the process |process_id| running at the moment, or adds it.
+  Process* FindOrAddProcess(DWORD process_id, const std::string& image_name);
+
+  LogParser parser_;
+  KernelLogParser kernel_parser_;
+  TraceSpanMatcher span_matcher_;
+  StringTable string_table_;  // The file names of the sites.
+
+  size_t max_sites_;
+  uint64 level_counts_[TRACE_LEVEL_VERBOSE + 1];
+  uint64 total_message_count_;
+  uint64 lost_event_count_;
+  uint64 lost_buffer_count_;
+
+  // The message counts by file atom and line.
+  typedef std::map<std::pair<StringTable::Atom, int>, uint64> SiteCounts;
+  SiteCounts site_counts_;
+
+  std::vector<Process> processes_;
+  // The index in processes_ of the running process of each id.
+  std::map<DWORD, size_t> running_processes_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogSummarizer);
+};
+
+#endif  // SAWDUST_TRACER_LOG_SUMMARIZER_H_
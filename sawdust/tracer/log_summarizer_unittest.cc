@@ -0,0 +1,182 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log summarizer unittests.
+#include "sawdust/tracer/log_summarizer.h"
+
+#include <string.h>
+
+#include "base/json/json_reader.h"
+#include "base/scoped_ptr.h"
+#include "base/values.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+const DWORD kPid = 1234;
+const DWORD kTid = 4321;
+
+class LogSummarizerTest : public testing::Test {
+ public:
+  LogSummarizerTest() : kT0(base::Time::Now()) {
+  }
+
+  // Issues a message logged at |level| from |file|:|line|.
+  void Log(UCHAR level, const char* file, int line) {
+    LogEvents::LogMessage message;
+    message.time = kT0;
+    message.level = level;
+    message.process_id = kPid;
+    message.thread_id = kTid;
+    message.file = file;
+    message.file_len = strlen(file);
+    message.line = line;
+    summarizer_.OnLogMessage(message);
+  }
+
+  KernelProcessEvents::ProcessInfo MakeProcess(DWORD pid, const char* image) {
+    KernelProcessEvents::ProcessInfo info = {};
+    info.process_id = pid;
+    info.image_name = image;
+    return info;
+  }
+
+ protected:
+  const base::Time kT0;
+  LogSummarizer summarizer_;
+};
+
+}  // namespace
+
+TEST_F(LogSummarizerTest, CountsMessagesByLevel) {
+  Log(TRACE_LEVEL_ERROR, "a.cc", 1);
+  Log(TRACE_LEVEL_ERROR, "a.cc", 2);
+  Log(TRACE_LEVEL_WARNING, "b.cc", 1);
+  Log(TRACE_LEVEL_VERBOSE, "b.cc", 1);
+
+  EXPECT_EQ(4u, summarizer_.total_message_count());
+  EXPECT_EQ(2u, summarizer_.message_count(TRACE_LEVEL_ERROR));
+  EXPECT_EQ(1u, summarizer_.message_count(TRACE_LEVEL_WARNING));
+  EXPECT_EQ(0u, summarizer_.message_count(TRACE_LEVEL_INFORMATION));
+  EXPECT_EQ(1u, summarizer_.message_count(TRACE_LEVEL_VERBOSE));
+  EXPECT_EQ(0u, summarizer_.message_count(200));
+}
+
+TEST_F(LogSummarizerTest, RanksTheSites) {
+  for (int i = 0; i < 5; ++i)
+    Log(TRACE_LEVEL_INFORMATION, "spam.cc", 10);
+  for (int i = 0; i < 3; ++i)
+    Log(TRACE_LEVEL_INFORMATION, "spam.cc", 20);
+  Log(TRACE_LEVEL_ERROR, "rare.cc", 5);
+  Log(TRACE_LEVEL_ERROR, "other.cc", 5);
+
+  summarizer_.set_max_sites(3);
+  std::vector<LogSummarizer::Site> sites;
+  summarizer_.GetTopSites(&sites);
+  ASSERT_EQ(3u, sites.size());
+  EXPECT_EQ("spam.cc", sites[0].file);
+  EXPECT_EQ(10, sites[0].line);
+  EXPECT_EQ(5u, sites[0].count);
+  EXPECT_EQ("spam.cc", sites[1].file);
+  EXPECT_EQ(20, sites[1].line);
+  EXPECT_EQ(3u, sites[1].count);
+  // Ties go by file name.
+  EXPECT_EQ("other.cc", sites[2].file);
+  EXPECT_EQ(1u, sites[2].count);
+}
+
+TEST_F(LogSummarizerTest, TracksProcessLifetimes) {
+  base::Time t1 = kT0 + base::TimeDelta::FromSeconds(1);
+  base::Time t2 = kT0 + base::TimeDelta::FromSeconds(2);
+  base::Time t3 = kT0 + base::TimeDelta::FromSeconds(3);
+  summarizer_.OnProcessIsRunning(kT0, MakeProcess(10, "explorer.exe"));
+  summarizer_.OnProcessStarted(t1, MakeProcess(20, "chrome.exe"));
+  summarizer_.OnProcessEnded(t2, MakeProcess(20, "chrome.exe"), 3);
+  // The id is reused by another process.
+  summarizer_.OnProcessStarted(t3, MakeProcess(20, "notepad.exe"));
+
+  const std::vector<LogSummarizer::Process>& processes =
+      summarizer_.processes();
+  ASSERT_EQ(3u, processes.size());
+  EXPECT_EQ("explorer.exe", processes[0].image_name);
+  EXPECT_TRUE(processes[0].start.is_null());
+  EXPECT_TRUE(processes[0].end.is_null());
+  EXPECT_EQ("chrome.exe", processes[1].image_name);
+  EXPECT_TRUE(processes[1].start == t1);
+  EXPECT_TRUE(processes[1].end == t2);
+  EXPECT_EQ(3u, processes[1].exit_status);
+  EXPECT_EQ("notepad.exe", processes[2].image_name);
+  EXPECT_TRUE(processes[2].start == t3);
+  EXPECT_TRUE(processes[2].end.is_null());
+}
+
+TEST_F(LogSummarizerTest, CountsLosses) {
+  LogEvents::EventLoss loss;
+  loss.count = 7;
+  summarizer_.OnEventLoss(loss);
+  loss.type = LogEvents::EventLoss::BUFFERS_LOST;
+  loss.count = 2;
+  summarizer_.OnEventLoss(loss);
+  summarizer_.OnBuffersLost(0, 3);
+
+  EXPECT_EQ(7u, summarizer_.lost_event_count());
+  EXPECT_EQ(5u, summarizer_.lost_buffer_count());
+}
+
+TEST_F(LogSummarizerTest, WritesJson) {
+  Log(TRACE_LEVEL_ERROR, "a.cc", 12);
+  summarizer_.OnProcessStarted(kT0, MakeProcess(20, "chrome.exe"));
+
+  std::string json;
+  summarizer_.WriteJson(&json);
+  scoped_ptr<Value> value(base::JSONReader::Read(json, false));
+  ASSERT_TRUE(value != NULL);
+  ASSERT_TRUE(value->IsType(Value::TYPE_DICTIONARY));
+  DictionaryValue* summary = static_cast<DictionaryValue*>(value.get());
+
+  int count = 0;
+  EXPECT_TRUE(summary->GetInteger("messages.total", &count));
+  EXPECT_EQ(1, count);
+  EXPECT_TRUE(summary->GetInteger("messages.error", &count));
+  EXPECT_EQ(1, count);
+
+  ListValue* sites = NULL;
+  ASSERT_TRUE(summary->GetList("top_sites", &sites));
+  ASSERT_EQ(1u, sites->GetSize());
+  DictionaryValue* site = NULL;
+  ASSERT_TRUE(sites->GetDictionary(0, &site));
+  std::string file;
+  EXPECT_TRUE(site->GetString("file", &file));
+  EXPECT_EQ("a.cc", file);
+  int line = 0;
+  EXPECT_TRUE(site->GetInteger("line", &line));
+  EXPECT_EQ(12, line);
+
+  ListValue* processes = NULL;
+  ASSERT_TRUE(summary->GetList("processes", &processes));
+  ASSERT_EQ(1u, processes->GetSize());
+  DictionaryValue* process = NULL;
+  ASSERT_TRUE(processes->GetDictionary(0, &process));
+  std::string image;
+  EXPECT_TRUE(process->GetString("image", &image));
+  EXPECT_EQ("chrome.exe", image);
+  double start = 0;
+  EXPECT_TRUE(process->GetDouble("start", &start));
+  EXPECT_DOUBLE_EQ(kT0.ToDoubleT(), start);
+  EXPECT_FALSE(process->HasKey("end"));
+
+  ListValue* spans = NULL;
+  ASSERT_TRUE(summary->GetList("spans", &spans));
+  EXPECT_EQ(0u, spans->GetSize());
+}
@@ -0,0 +1,81 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log trimmer implementation.
+#include "sawdust/tracer/log_trimmer.h"
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "sawbuck/log_lib/log_export_writer.h"
+
+LogTrimmer::LogTrimmer()
+    : max_level_(TRACE_LEVEL_VERBOSE), dropped_event_count_(0),
+      kept_event_count_(0) {
+  // The parser's own filter is relative to the first event, which would
+  // drop the events a log holds out of order, so we open it all the way
+  // and filter here instead.
+  LogParser::EventFilter filter;
+  filter.from = base::TimeDelta::FromMicroseconds(kint64min);
+  parser_.set_event_filter(filter);
+}
+
+HRESULT LogTrimmer::Trim(const FilePath& log_path,
+                         const FilePath& trimmed_path) {
+  EtlFileReader reader;
+  HRESULT hr = reader.Open(log_path);
+  if (FAILED(hr))
+    return hr;
+
+  FILE* trimmed_file = file_util::OpenFile(trimmed_path, "wb");
+  if (trimmed_file == NULL)
+    return E_ACCESSDENIED;
+
+  bool written = false;
+  {
+    LogExportWriter::FileOutput output(trimmed_file);
+    LogExportWriter writer(LogExportWriter::BINARY, &output,
+                           LogExportWriter::kDefaultBufferSize);
+    parser_.set_event_sink(&writer);
+    parser_.set_trace_sink(&writer);
+    hr = reader.Consume(this);
+    written = writer.Flush();
+    parser_.set_event_sink(NULL);
+    parser_.set_trace_sink(NULL);
+  }
+  file_util::CloseFile(trimmed_file);
+
+  if (SUCCEEDED(hr) && !written)
+    hr = E_FAIL;
+  if (FAILED(hr))
+    file_util::Delete(trimmed_path, false);
+  return hr;
+}
+
+void LogTrimmer::OnEvent(EVENT_TRACE* event) {
+  DCHECK(event != NULL);
+  base::Time time = base::Time::FromFileTime(
+      reinterpret_cast<FILETIME&>(event->Header.TimeStamp));
+  bool passes = event->Header.Class.Level <= max_level_ &&
+      (process_ids_.empty() ||
+       process_ids_.find(event->Header.ProcessId) != process_ids_.end()) &&
+      (from_.is_null() || time >= from_) &&
+      (to_.is_null() || time <= to_);
+
+  // Only the log messages and trace events are of interest, the parser
+  // leaves the rest.
+  if (passes && parser_.ProcessOneEvent(event))
+    ++kept_event_count_;
+  else
+    ++dropped_event_count_;
+}
@@ -0,0 +1,83 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Trims application logs down before they are reported.
+
+#ifndef SAWDUST_TRACER_LOG_TRIMMER_H_
+#define SAWDUST_TRACER_LOG_TRIMMER_H_
+
+#include <windows.h>
+
+#include <set>
+
+#include "base/basictypes.h"
+#include "base/file_path.h"
+#include "base/time.h"
+#include "sawbuck/log_lib/etl_file_reader.h"
+#include "sawbuck/log_lib/log_consumer.h"
+
+// Re-encodes an application log file, keeping only the events logged in a
+// time window, at a level or more severe, and by some processes. The log
+// messages and trace events kept are written in the binary columns of
+// LogExportWriter, which is a lot more compact than the ETW buffers they
+// came from. Events that don't pass are dropped on their header, before
+// their payload is decoded.
+class LogTrimmer : public EtlEventSink {
+ public:
+  // Keeps all the events, until narrowed by the setters.
+  LogTrimmer();
+
+  // Keeps the events at |level| or more severe.
+  void set_max_level(UCHAR max_level) { max_level_ = max_level; }
+
+  // Keeps the events of the processes in |process_ids|, unless it's empty.
+  void set_process_ids(const std::set<DWORD>& process_ids) {
+    process_ids_ = process_ids;
+  }
+
+  // Keeps the events logged from |from| and until |to|, either of which may
+  // be null to leave that end open.
+  void set_time_window(base::Time from, base::Time to) {
+    from_ = from;
+    to_ = to;
+  }
+
+  // Trims the log at |log_path| into |trimmed_path|.
+  HRESULT Trim(const FilePath& log_path, const FilePath& trimmed_path);
+
+  // The events dropped and kept so far.
+  size_t dropped_event_count() const { return dropped_event_count_; }
+  size_t kept_event_count() const { return kept_event_count_; }
+
+  // The parser the events that pass go to. Exposed for testing.
+  LogParser* parser() { return &parser_; }
+
+  // EtlEventSink implementation.
+  virtual void OnEvent(EVENT_TRACE* event);
+
+ private:
+  LogParser parser_;
+
+  UCHAR max_level_;
+  std::set<DWORD> process_ids_;
+  base::Time from_;
+  base::Time to_;
+
+  size_t dropped_event_count_;
+  size_t kept_event_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogTrimmer);
+};
+
+#endif  // SAWDUST_TRACER_LOG_TRIMMER_H_
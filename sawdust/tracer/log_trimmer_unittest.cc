@@ -0,0 +1,146 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log trimmer unittests.
+#include "sawdust/tracer/log_trimmer.h"
+
+#include <cguid.h>
+
+#include "base/file_util.h"
+#include "base/logging_win.h"
+#include "base/scoped_temp_dir.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using testing::_;
+using testing::Field;
+using testing::StrictMock;
+
+const DWORD kPid = 1234;
+const DWORD kTid = 4321;
+
+char kMessageText[] = "Nothing to see here, please move on";
+
+class MockLogEvents : public LogEvents {
+ public:
+  MOCK_METHOD1(OnLogMessage, void(const LogEvents::LogMessage& message));
+};
+
+class LogTrimmerTest : public testing::Test {
+ public:
+  LogTrimmerTest() : kT0(base::Time::Now()) {
+  }
+
+  virtual void SetUp() {
+    trimmer_.parser()->set_event_sink(&events_);
+  }
+
+  // Feeds a log message of |pid| at |level|, |seconds| past kT0.
+  void Log(DWORD pid, UCHAR level, int seconds) {
+    Log(logging::kLogEventId, pid, level, seconds);
+  }
+
+  void Log(const GUID& event_class, DWORD pid, UCHAR level, int seconds) {
+    EVENT_TRACE event = {};
+    event.Header.Size = sizeof(event);
+    event.Header.Class.Type = logging::LOG_MESSAGE;
+    event.Header.Class.Level = level;
+    event.Header.ProcessId = pid;
+    event.Header.ThreadId = kTid;
+    reinterpret_cast<FILETIME&>(event.Header.TimeStamp) =
+        (kT0 + base::TimeDelta::FromSeconds(seconds)).ToFileTime();
+    event.Header.Guid = event_class;
+    event.MofData = kMessageText;
+    event.MofLength = sizeof(kMessageText);
+    trimmer_.OnEvent(&event);
+  }
+
+ protected:
+  LogTrimmer trimmer_;
+  StrictMock<MockLogEvents> events_;
+  const base::Time kT0;
+};
+
+}  // namespace
+
+TEST_F(LogTrimmerTest, KeepsAllByDefault) {
+  EXPECT_CALL(events_, OnLogMessage(_)).Times(3);
+  Log(kPid, TRACE_LEVEL_VERBOSE, 0);
+  Log(kPid + 1, TRACE_LEVEL_ERROR, 10);
+  Log(kPid, TRACE_LEVEL_INFORMATION, -10);
+
+  // Other events aren't ours to keep.
+  Log(GUID_NULL, kPid, TRACE_LEVEL_ERROR, 0);
+  EXPECT_EQ(3U, trimmer_.kept_event_count());
+  EXPECT_EQ(1U, trimmer_.dropped_event_count());
+}
+
+TEST_F(LogTrimmerTest, KeepsProcesses) {
+  std::set<DWORD> process_ids;
+  process_ids.insert(kPid);
+  process_ids.insert(kPid + 2);
+  trimmer_.set_process_ids(process_ids);
+
+  EXPECT_CALL(events_, OnLogMessage(Field(&LogEvents::LogMessage::process_id,
+                                          kPid)));
+  EXPECT_CALL(events_, OnLogMessage(Field(&LogEvents::LogMessage::process_id,
+                                          kPid + 2)));
+  Log(kPid, TRACE_LEVEL_INFORMATION, 0);
+  Log(kPid + 1, TRACE_LEVEL_INFORMATION, 0);
+  Log(kPid + 2, TRACE_LEVEL_INFORMATION, 0);
+  EXPECT_EQ(2U, trimmer_.kept_event_count());
+  EXPECT_EQ(1U, trimmer_.dropped_event_count());
+}
+
+TEST_F(LogTrimmerTest, KeepsTimeWindow) {
+  trimmer_.set_time_window(kT0, kT0 + base::TimeDelta::FromSeconds(10));
+
+  EXPECT_CALL(events_, OnLogMessage(_)).Times(2);
+  Log(kPid, TRACE_LEVEL_INFORMATION, -1);
+  Log(kPid, TRACE_LEVEL_INFORMATION, 0);
+  Log(kPid, TRACE_LEVEL_INFORMATION, 10);
+  Log(kPid, TRACE_LEVEL_INFORMATION, 11);
+  EXPECT_EQ(2U, trimmer_.kept_event_count());
+
+  // An open end.
+  trimmer_.set_time_window(kT0, base::Time());
+  EXPECT_CALL(events_, OnLogMessage(_)).Times(1);
+  Log(kPid, TRACE_LEVEL_INFORMATION, 1000);
+}
+
+TEST_F(LogTrimmerTest, KeepsLevel) {
+  trimmer_.set_max_level(TRACE_LEVEL_WARNING);
+
+  EXPECT_CALL(events_, OnLogMessage(Field(&LogEvents::LogMessage::level,
+                                          TRACE_LEVEL_WARNING)));
+  EXPECT_CALL(events_, OnLogMessage(Field(&LogEvents::LogMessage::level,
+                                          TRACE_LEVEL_ERROR)));
+  Log(kPid, TRACE_LEVEL_INFORMATION, 0);
+  Log(kPid, TRACE_LEVEL_WARNING, 0);
+  Log(kPid, TRACE_LEVEL_ERROR, 0);
+  EXPECT_EQ(2U, trimmer_.kept_event_count());
+  EXPECT_EQ(1U, trimmer_.dropped_event_count());
+}
+
+TEST_F(LogTrimmerTest, FailsOnMissingLog) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath trimmed_path(temp_dir.path().Append(L"trimmed.bin"));
+
+  EXPECT_HRESULT_FAILED(trimmer_.Trim(temp_dir.path().Append(L"none.etl"),
+                                      trimmed_path));
+  EXPECT_FALSE(file_util::PathExists(trimmed_path));
+}
@@ -0,0 +1,189 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log watcher implementation.
+#include "sawdust/tracer/log_watcher.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "pcre.h"  // NOLINT
+#include "sawdust/tracer/com_utils.h"
+
+namespace {
+
+// The same options as Sawbuck's filters.
+const int kPatternOptions =
+    PCRE_NEWLINE_ANYCRLF | PCRE_DOTALL | PCRE_UTF8 | PCRE_CASELESS;
+
+// The most characters of a message a trigger reason quotes.
+const size_t kMaxQuotedLength = 120;
+
+std::string QuoteMessage(const LogEvents::LogMessage& log_message) {
+  size_t length = std::min(log_message.message_len, kMaxQuotedLength);
+  std::string quote(log_message.message, length);
+  if (length < log_message.message_len)
+    quote.append("...");
+  return quote;
+}
+
+}  // namespace
+
+LogWatcher::LogWatcher(const TracerConfiguration::SnapshotTriggers& triggers,
+                       Delegate* delegate)
+    : triggers_(triggers), delegate_(delegate), re_(NULL), extra_(NULL),
+      fired_count_(0) {
+  DCHECK(delegate != NULL);
+
+  if (!triggers_.message_pattern.empty()) {
+    const char* error = NULL;
+    int error_offset = 0;
+    re_ = pcre_compile(triggers_.message_pattern.c_str(), kPatternOptions,
+                       &error, &error_offset, NULL);
+    if (re_ == NULL) {
+      // The other triggers still stand.
+      LOG(ERROR) << "Invalid trigger pattern \"" <<
+          triggers_.message_pattern << "\": " << error;
+    } else {
+      extra_ = pcre_study(re_, 0, &error);
+      LOG_IF(ERROR, error != NULL) << "Failed to study \"" <<
+          triggers_.message_pattern << "\": " << error;
+    }
+  }
+
+  if (triggers_.span_ms > 0) {
+    span_matcher_.reset(new TraceSpanMatcher());
+    span_matcher_->set_span_sink(this);
+  }
+}
+
+LogWatcher::~LogWatcher() {
+  StopWatching();
+
+  if (extra_ != NULL)
+    pcre_free(extra_);
+  if (re_ != NULL)
+    pcre_free(re_);
+}
+
+HRESULT LogWatcher::StartWatching(const wchar_t* session_name) {
+  DCHECK(session_name != NULL);
+  DCHECK(consumer_ == NULL);
+
+  consumer_.reset(new LogConsumer());
+  AttachTo(consumer_.get());
+  HRESULT hr = consumer_->OpenRealtimeSession(session_name);
+  if (FAILED(hr)) {
+    LOG(ERROR) << "Failed to open the session to watch. " << com::LogHr(hr);
+    consumer_.reset();
+    return hr;
+  }
+
+  thread_.reset(new base::DelegateSimpleThread(this, "LogWatcher"));
+  thread_->Start();
+  return S_OK;
+}
+
+void LogWatcher::StopWatching() {
+  if (consumer_ == NULL)
+    return;
+
+  // Closing the session ends the consumption on our thread.
+  consumer_->Close();
+  if (thread_ != NULL) {
+    thread_->Join();
+    thread_.reset();
+  }
+  consumer_.reset();
+}
+
+void LogWatcher::AttachTo(LogParser* parser) {
+  DCHECK(parser != NULL);
+
+  bool watch_messages = triggers_.level != TRACE_LEVEL_NONE || re_ != NULL;
+  parser->set_event_sink(watch_messages ? this : NULL);
+  // Without a sink the trace events are dropped before they are decoded.
+  parser->set_trace_sink(span_matcher_.get());
+
+  // Only the message pattern and the spans need the less severe events.
+  LogParser::EventFilter filter;
+  if (re_ == NULL && span_matcher_ == NULL)
+    filter.max_level = triggers_.level;
+  parser->set_event_filter(filter);
+}
+
+void LogWatcher::OnLogMessage(const LogMessage& log_message) {
+  if (IsThrottled(log_message.time))
+    return;
+
+  if (triggers_.level != TRACE_LEVEL_NONE &&
+      log_message.level <= triggers_.level) {
+    Fire(base::StringPrintf("Log message at level %d: ", log_message.level) +
+             QuoteMessage(log_message),
+         log_message.time);
+    return;
+  }
+
+  if (re_ != NULL) {
+    int rc = pcre_exec(re_,
+                       extra_,
+                       log_message.message == NULL ? "" : log_message.message,
+                       log_message.message_len,
+                       0,
+                       0,
+                       NULL,
+                       0);
+    // Without an output vector pcre_exec returns zero on a match.
+    if (rc >= 0) {
+      Fire("Log message matching \"" + triggers_.message_pattern + "\": " +
+               QuoteMessage(log_message),
+           log_message.time);
+    }
+  }
+}
+
+void LogWatcher::OnTraceSpan(const TraceSpan& span) {
+  int64 duration_ms = (span.end - span.begin).InMilliseconds();
+  if (duration_ms <= triggers_.span_ms || IsThrottled(span.end))
+    return;
+
+  Fire(base::StringPrintf("Trace span %s lasted %d ms", span.name->c_str(),
+                          static_cast<int>(duration_ms)),
+       span.end);
+}
+
+void LogWatcher::Run() {
+  DCHECK(consumer_ != NULL);
+  HRESULT hr = consumer_->Consume();
+  // Closing the session cancels the consumption.
+  LOG_IF(ERROR, FAILED(hr) && hr != HRESULT_FROM_WIN32(ERROR_CANCELLED)) <<
+      "Watching the session failed. " << com::LogHr(hr);
+}
+
+bool LogWatcher::IsThrottled(base::Time time) const {
+  if (fired_count_ >= triggers_.max_snapshots)
+    return true;
+
+  return !last_fired_.is_null() &&
+      time - last_fired_ <
+          base::TimeDelta::FromSeconds(triggers_.min_interval_seconds);
+}
+
+void LogWatcher::Fire(const std::string& reason, base::Time time) {
+  last_fired_ = time;
+  ++fired_count_;
+  LOG(INFO) << "Snapshot trigger: " << reason;
+  delegate_->OnSnapshotTrigger(reason, time);
+}
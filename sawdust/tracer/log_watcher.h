@@ -0,0 +1,122 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Watches the live application log for the triggers of a snapshot.
+
+#ifndef SAWDUST_TRACER_LOG_WATCHER_H_
+#define SAWDUST_TRACER_LOG_WATCHER_H_
+
+#include <windows.h>
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/scoped_ptr.h"
+#include "base/threading/simple_thread.h"
+#include "base/time.h"
+#include "sawbuck/log_lib/log_consumer.h"
+#include "sawbuck/log_lib/trace_span_matcher.h"
+#include "sawdust/tracer/configuration.h"
+
+// Forward decls, from pcre.h.
+struct real_pcre;
+struct pcre_extra;
+
+// Consumes a real-time ETW session, the application's, and fires as one of
+// the configured triggers matches: a log message at the trigger level or
+// more severe, a log message matching the trigger expression, or a trace
+// event span lasting longer than the trigger duration. As what is kept of
+// the log will wrap around long before anyone gets to report it, the
+// delegate takes a snapshot of it there and then.
+//
+// The watcher is meant to stay cheap while the application logs away. The
+// events the triggers can't match are dropped on their header by the log
+// parser, and once a trigger has fired the others are not looked at until
+// the least interval between snapshots has passed, nor at all once a
+// session has taken its most snapshots.
+class LogWatcher
+    : public LogEvents,
+      public TraceSpanEvents,
+      public base::DelegateSimpleThread::Delegate {
+ public:
+  class Delegate {
+   public:
+    virtual ~Delegate() {}
+
+    // Issued on the watching thread as a trigger fires on an event logged at
+    // |time|. |reason| tells what fired, for the report to say.
+    virtual void OnSnapshotTrigger(const std::string& reason,
+                                   base::Time time) = 0;
+  };
+
+  // |delegate| must outlive the watcher.
+  LogWatcher(const TracerConfiguration::SnapshotTriggers& triggers,
+             Delegate* delegate);
+  // Stops watching, if need be.
+  ~LogWatcher();
+
+  // Opens the real-time session |session_name|, which must be logging in
+  // real-time mode, and consumes it on a thread of our own.
+  HRESULT StartWatching(const wchar_t* session_name);
+
+  // Closes the session, and waits for the thread to be done with it.
+  void StopWatching();
+
+  // Sets |parser| to sink into us, narrowed to the events the triggers can
+  // match. Exposed for testing.
+  void AttachTo(LogParser* parser);
+
+  // The number of times a trigger fired.
+  int fired_count() const { return fired_count_; }
+
+  // LogEvents implementation.
+  virtual void OnLogMessage(const LogMessage& log_message);
+
+  // TraceSpanEvents implementation.
+  virtual void OnTraceSpan(const TraceSpan& span);
+
+  // DelegateSimpleThread::Delegate implementation.
+  virtual void Run();
+
+ private:
+  // True if no trigger is to be looked at for an event logged at |time|.
+  bool IsThrottled(base::Time time) const;
+
+  // Has the delegate take a snapshot for |reason|.
+  void Fire(const std::string& reason, base::Time time);
+
+  TracerConfiguration::SnapshotTriggers triggers_;
+  Delegate* delegate_;
+
+  // The compiled and studied message pattern, NULL if there is none.
+  // Studying may yield no extra data, in which case extra_ is NULL too.
+  real_pcre* re_;
+  pcre_extra* extra_;
+
+  // Pairs the trace events into spans, when there is a span trigger.
+  scoped_ptr<TraceSpanMatcher> span_matcher_;
+
+  // The time of the event the last trigger fired on and the number of
+  // times a trigger fired. Only touched on the watching thread.
+  base::Time last_fired_;
+  int fired_count_;
+
+  // The consumer of the session and its thread, while watching.
+  scoped_ptr<LogConsumer> consumer_;
+  scoped_ptr<base::DelegateSimpleThread> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogWatcher);
+};
+
+#endif  // SAWDUST_TRACER_LOG_WATCHER_H_
@@ -0,0 +1,132 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Log watcher unittests.
+#include "sawdust/tracer/log_watcher.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using testing::_;
+using testing::HasSubstr;
+using testing::StrictMock;
+
+class MockDelegate : public LogWatcher::Delegate {
+ public:
+  MOCK_METHOD2(OnSnapshotTrigger, void(const std::string&, base::Time));
+};
+
+class LogWatcherTest : public testing::Test {
+ public:
+  LogWatcherTest() : kT0(base::Time::Now()) {
+    triggers_.min_interval_seconds = 10;
+    triggers_.max_snapshots = 2;
+  }
+
+  // Logs |text| at |level|, |seconds| past kT0.
+  void Log(LogWatcher* watcher, UCHAR level, const char* text, int seconds) {
+    LogEvents::LogMessage message;
+    message.time = kT0 + base::TimeDelta::FromSeconds(seconds);
+    message.level = level;
+    message.message = text;
+    message.message_len = strlen(text);
+    watcher->OnLogMessage(message);
+  }
+
+  // Ends a span named |name| of |duration_ms|, |seconds| past kT0.
+  void Span(LogWatcher* watcher, const char* name, int duration_ms,
+            int seconds) {
+    std::string span_name(name);
+    TraceSpanEvents::TraceSpan span = {};
+    span.name = &span_name;
+    span.end = kT0 + base::TimeDelta::FromSeconds(seconds);
+    span.begin = span.end - base::TimeDelta::FromMilliseconds(duration_ms);
+    watcher->OnTraceSpan(span);
+  }
+
+ protected:
+  TracerConfiguration::SnapshotTriggers triggers_;
+  StrictMock<MockDelegate> delegate_;
+  const base::Time kT0;
+};
+
+}  // namespace
+
+TEST_F(LogWatcherTest, LevelTrigger) {
+  triggers_.level = TRACE_LEVEL_ERROR;
+  LogWatcher watcher(triggers_, &delegate_);
+
+  // Less severe messages don't fire.
+  Log(&watcher, TRACE_LEVEL_WARNING, "Careful", 0);
+
+  EXPECT_CALL(delegate_, OnSnapshotTrigger(HasSubstr("Broken"), kT0));
+  Log(&watcher, TRACE_LEVEL_ERROR, "Broken", 0);
+
+  // Not again within the interval.
+  Log(&watcher, TRACE_LEVEL_CRITICAL, "Still broken", 5);
+
+  base::Time t10 = kT0 + base::TimeDelta::FromSeconds(10);
+  EXPECT_CALL(delegate_, OnSnapshotTrigger(HasSubstr("Fatal"), t10));
+  Log(&watcher, TRACE_LEVEL_CRITICAL, "Fatal", 10);
+
+  // Nor once the session took its most snapshots.
+  Log(&watcher, TRACE_LEVEL_ERROR, "Broken", 100);
+  EXPECT_EQ(2, watcher.fired_count());
+}
+
+TEST_F(LogWatcherTest, MessageTrigger) {
+  triggers_.message_pattern = "renderer [0-9]+ hung";
+  LogWatcher watcher(triggers_, &delegate_);
+
+  Log(&watcher, TRACE_LEVEL_INFORMATION, "Renderer busy", 0);
+  EXPECT_CALL(delegate_, OnSnapshotTrigger(HasSubstr("Renderer 12 hung"), _));
+  Log(&watcher, TRACE_LEVEL_INFORMATION, "Renderer 12 hung", 1);
+  EXPECT_EQ(1, watcher.fired_count());
+}
+
+TEST_F(LogWatcherTest, LongMessagesAreQuotedInPart) {
+  triggers_.level = TRACE_LEVEL_ERROR;
+  LogWatcher watcher(triggers_, &delegate_);
+
+  std::string text(1000, 'x');
+  std::string reason;
+  EXPECT_CALL(delegate_, OnSnapshotTrigger(_, _)).
+      WillOnce(testing::SaveArg<0>(&reason));
+  Log(&watcher, TRACE_LEVEL_ERROR, text.c_str(), 0);
+  EXPECT_GT(text.size(), reason.size());
+  EXPECT_THAT(reason, HasSubstr("xxx..."));
+}
+
+TEST_F(LogWatcherTest, InvalidPatternIsIgnored) {
+  triggers_.level = TRACE_LEVEL_ERROR;
+  triggers_.message_pattern = "(unbalanced";
+  LogWatcher watcher(triggers_, &delegate_);
+
+  Log(&watcher, TRACE_LEVEL_INFORMATION, "(unbalanced", 0);
+  EXPECT_CALL(delegate_, OnSnapshotTrigger(_, _));
+  Log(&watcher, TRACE_LEVEL_ERROR, "Broken", 1);
+}
+
+TEST_F(LogWatcherTest, SpanTrigger) {
+  triggers_.span_ms = 500;
+  LogWatcher watcher(triggers_, &delegate_);
+
+  Span(&watcher, "Paint", 500, 0);
+  EXPECT_CALL(delegate_,
+              OnSnapshotTrigger(HasSubstr("Paint lasted 501 ms"), _));
+  Span(&watcher, "Paint", 501, 1);
+  EXPECT_EQ(1, watcher.fired_count());
+}
@@ -0,0 +1,119 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Mapped file reader implementation.
+#include "sawdust/tracer/mapped_file_reader.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace {
+
+size_t RoundUpToGranularity(size_t size) {
+  SYSTEM_INFO system_info = {};
+  ::GetSystemInfo(&system_info);
+  size_t granularity = system_info.dwAllocationGranularity;
+  DCHECK(granularity != 0);
+  size = std::max(size, granularity);
+  return (size + granularity - 1) / granularity * granularity;
+}
+
+}  // namespace
+
+MappedFileReader::MappedFileReader()
+    : view_(NULL), view_size_(RoundUpToGranularity(kDefaultViewSize)),
+      file_size_(0), offset_(0) {
+}
+
+MappedFileReader::MappedFileReader(size_t view_size)
+    : view_(NULL), view_size_(RoundUpToGranularity(view_size)),
+      file_size_(0), offset_(0) {
+}
+
+MappedFileReader::~MappedFileReader() {
+  Close();
+}
+
+HRESULT MappedFileReader::Open(const FilePath& path) {
+  Close();
+
+  // Sequential scan lets the cache manager read well ahead of the views.
+  file_.Set(::CreateFile(path.value().c_str(), GENERIC_READ,
+                         FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                         OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL));
+  if (!file_.IsValid())
+    return HRESULT_FROM_WIN32(::GetLastError());
+
+  LARGE_INTEGER size = {};
+  if (!::GetFileSizeEx(file_.Get(), &size)) {
+    HRESULT hr = HRESULT_FROM_WIN32(::GetLastError());
+    file_.Close();
+    return hr;
+  }
+  file_size_ = size.QuadPart;
+
+  if (file_size_ != 0) {
+    mapping_.Set(::CreateFileMapping(file_.Get(), NULL, PAGE_READONLY, 0, 0,
+                                     NULL));
+    if (!mapping_.IsValid()) {
+      HRESULT hr = HRESULT_FROM_WIN32(::GetLastError());
+      LOG(ERROR) << "Unable to map " << path.value() << ", error " <<
+          ::GetLastError();
+      file_.Close();
+      return hr;
+    }
+  }
+
+  return S_OK;
+}
+
+HRESULT MappedFileReader::NextView(const char** data, size_t* size) {
+  DCHECK(data != NULL && size != NULL);
+  DCHECK(is_open());
+  Unmap();
+  if (!is_open())
+    return E_UNEXPECTED;
+  if (offset_ >= file_size_)
+    return S_FALSE;
+
+  size_t mapped = static_cast<size_t>(
+      std::min(static_cast<int64>(view_size_), file_size_ - offset_));
+  ULARGE_INTEGER offset = {};
+  offset.QuadPart = offset_;
+  view_ = ::MapViewOfFile(mapping_.Get(), FILE_MAP_READ, offset.HighPart,
+                          offset.LowPart, mapped);
+  if (view_ == NULL)
+    return HRESULT_FROM_WIN32(::GetLastError());
+
+  offset_ += mapped;
+  *data = reinterpret_cast<const char*>(view_);
+  *size = mapped;
+  return S_OK;
+}
+
+void MappedFileReader::Close() {
+  Unmap();
+  mapping_.Close();
+  file_.Close();
+  file_size_ = 0;
+  offset_ = 0;
+}
+
+void MappedFileReader::Unmap() {
+  if (view_ != NULL) {
+    ::UnmapViewOfFile(view_);
+    view_ = NULL;
+  }
+}
@@ -0,0 +1,68 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Reads files through views of a file mapping.
+
+#ifndef SAWDUST_TRACER_MAPPED_FILE_READER_H_
+#define SAWDUST_TRACER_MAPPED_FILE_READER_H_
+
+#include <windows.h>
+
+#include "base/basictypes.h"
+#include "base/file_path.h"
+#include "base/win/scoped_handle.h"
+
+// Reads a file front to back one mapped view at a time, so that the data is
+// handed out straight from the system cache, without copies or a read call
+// per buffer. Only one view is mapped at a time, which keeps the address
+// space used bounded however large the file.
+class MappedFileReader {
+ public:
+  // The size of the views of a reader made with the default constructor.
+  static const size_t kDefaultViewSize = 4 * 1024 * 1024;
+
+  MappedFileReader();
+  // Maps views of |view_size|, rounded up to the allocation granularity.
+  explicit MappedFileReader(size_t view_size);
+  ~MappedFileReader();
+
+  // Opens the file at |path| for reading.
+  HRESULT Open(const FilePath& path);
+
+  // Maps the next view of the file, setting |data| and |size| to it, and
+  // returns S_OK, or S_FALSE past the end of the file. The view stays valid
+  // until the next call or Close.
+  HRESULT NextView(const char** data, size_t* size);
+
+  // Unmaps the view and closes the file. The destructor also does it.
+  void Close();
+
+  bool is_open() const { return file_.IsValid(); }
+  int64 file_size() const { return file_size_; }
+
+ private:
+  void Unmap();
+
+  base::win::ScopedHandle file_;
+  // Only held while the file isn't empty, as an empty file can't be mapped.
+  base::win::ScopedHandle mapping_;
+  void* view_;
+  size_t view_size_;
+  int64 file_size_;
+  int64 offset_;  // Where the next view starts.
+
+  DISALLOW_COPY_AND_ASSIGN(MappedFileReader);
+};
+
+#endif  // SAWDUST_TRACER_MAPPED_FILE_READER_H_
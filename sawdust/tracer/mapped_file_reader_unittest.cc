@@ -0,0 +1,141 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Mapped file reader unittests.
+#include "sawdust/tracer/mapped_file_reader.h"
+
+#include <string>
+
+#include "base/file_util.h"
+#include "base/scoped_temp_dir.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// The smallest view there is, as views are rounded up to the granularity.
+const size_t kSmallViewSize = 1;
+
+class MappedFileReaderTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    SYSTEM_INFO system_info = {};
+    ::GetSystemInfo(&system_info);
+    granularity_ = system_info.dwAllocationGranularity;
+  }
+
+ protected:
+  // Writes |size| bytes of a pattern to a file named |name|.
+  FilePath CreateTestFile(const wchar_t* name, size_t size,
+                          std::string* content) {
+    content->clear();
+    for (size_t i = 0; i < size; ++i)
+      content->push_back(static_cast<char>(i * 7 + i / 251));
+    FilePath path(temp_dir_.path().Append(name));
+    EXPECT_EQ(static_cast<int>(size),
+              file_util::WriteFile(path, content->data(), size));
+    return path;
+  }
+
+  // Reads all of |reader|'s views into |content|, counting them in |views|.
+  HRESULT ReadAll(MappedFileReader* reader, std::string* content,
+                  int* views) {
+    content->clear();
+    *views = 0;
+    const char* data = NULL;
+    size_t size = 0;
+    HRESULT hr = S_OK;
+    while ((hr = reader->NextView(&data, &size)) == S_OK) {
+      content->append(data, size);
+      ++*views;
+    }
+    return hr;
+  }
+
+  ScopedTempDir temp_dir_;
+  size_t granularity_;
+};
+
+}  // namespace
+
+TEST_F(MappedFileReaderTest, ReadsInViews) {
+  std::string expected;
+  FilePath path(CreateTestFile(L"log.etl", granularity_ * 3 + 100,
+                               &expected));
+
+  MappedFileReader reader(kSmallViewSize);
+  ASSERT_HRESULT_SUCCEEDED(reader.Open(path));
+  EXPECT_EQ(static_cast<int64>(expected.size()), reader.file_size());
+
+  std::string content;
+  int views = 0;
+  EXPECT_EQ(S_FALSE, ReadAll(&reader, &content, &views));
+  EXPECT_EQ(4, views);
+  EXPECT_TRUE(content == expected);
+}
+
+TEST_F(MappedFileReaderTest, ReadsInOneView) {
+  std::string expected;
+  FilePath path(CreateTestFile(L"log.etl", granularity_ + 1, &expected));
+
+  MappedFileReader reader;
+  ASSERT_HRESULT_SUCCEEDED(reader.Open(path));
+
+  std::string content;
+  int views = 0;
+  EXPECT_EQ(S_FALSE, ReadAll(&reader, &content, &views));
+  EXPECT_EQ(1, views);
+  EXPECT_TRUE(content == expected);
+}
+
+TEST_F(MappedFileReaderTest, ReadsEmptyFile) {
+  std::string expected;
+  FilePath path(CreateTestFile(L"empty.etl", 0, &expected));
+
+  MappedFileReader reader;
+  ASSERT_HRESULT_SUCCEEDED(reader.Open(path));
+
+  std::string content;
+  int views = 0;
+  EXPECT_EQ(S_FALSE, ReadAll(&reader, &content, &views));
+  EXPECT_EQ(0, views);
+}
+
+TEST_F(MappedFileReaderTest, FailsOnMissingFile) {
+  MappedFileReader reader;
+  EXPECT_HRESULT_FAILED(reader.Open(temp_dir_.path().Append(L"none.etl")));
+  EXPECT_FALSE(reader.is_open());
+}
+
+TEST_F(MappedFileReaderTest, Reopens) {
+  std::string expected;
+  FilePath path(CreateTestFile(L"log.etl", granularity_ * 2, &expected));
+
+  MappedFileReader reader(kSmallViewSize);
+  ASSERT_HRESULT_SUCCEEDED(reader.Open(path));
+  const char* data = NULL;
+  size_t size = 0;
+  ASSERT_EQ(S_OK, reader.NextView(&data, &size));
+
+  // Opening again starts over.
+  ASSERT_HRESULT_SUCCEEDED(reader.Open(path));
+  std::string content;
+  int views = 0;
+  EXPECT_EQ(S_FALSE, ReadAll(&reader, &content, &views));
+  EXPECT_EQ(2, views);
+  EXPECT_TRUE(content == expected);
+
+  reader.Close();
+  EXPECT_FALSE(reader.is_open());
+}
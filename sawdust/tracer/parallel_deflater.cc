@@ -0,0 +1,310 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Parallel zip entry compression.
+
+#include "sawdust/tracer/parallel_deflater.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/scoped_ptr.h"
+#include "base/synchronization/waitable_event.h"
+#include "third_party/zlib/zlib.h"
+
+#include "sawdust/tracer/background_mode.h"
+#include "sawdust/tracer/zip_stream_writer.h"
+
+namespace {
+
+// Deflate looks back this far, so that is all of the last block that helps.
+const size_t kDictionarySize = 32 * 1024;
+
+const size_t kOutputBufferSize = 16384;
+
+}  // namespace
+
+// A block of an entry, compressed on a pool thread.
+class ParallelDeflater::Block : public base::DelegateSimpleThread::Delegate {
+ public:
+  // Takes the contents of |input|. |first| and |last| place the block in its
+  // entry |name|, deflated at |level|. |dictionary| is the tail of the block
+  // before. |background| compresses it in background mode.
+  Block(const std::string& name,
+        int level,
+        bool first,
+        bool last,
+        std::string* input,
+        const std::string& dictionary,
+        bool background)
+      : name_(name), level_(level), first_(first), last_(last),
+        dictionary_(dictionary), background_(background), crc_(0),
+        succeeded_(false), done_(true, false) {
+    input_.swap(*input);
+  }
+
+  void Run() {
+    ScopedBackgroundMode background_mode(background_);
+    crc_ = crc32(0L, Z_NULL, 0);
+    crc_ = crc32(crc_, reinterpret_cast<const Bytef*>(input_.data()),
+                 static_cast<uInt>(input_.size()));
+    succeeded_ = Deflate();
+    done_.Signal();
+  }
+
+  // Waits for the block to be compressed.
+  void Wait() { done_.Wait(); }
+
+  const std::string& name() const { return name_; }
+  bool first() const { return first_; }
+  bool last() const { return last_; }
+  bool succeeded() const { return succeeded_; }
+  const std::string& output() const { return output_; }
+  uint32 crc() const { return crc_; }
+  uint32 size() const { return static_cast<uint32>(input_.size()); }
+
+ private:
+  bool Deflate() {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level_, Z_DEFLATED, -MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      return false;
+    }
+
+    bool success = dictionary_.empty() ||
+        deflateSetDictionary(&stream,
+                             reinterpret_cast<const Bytef*>(dictionary_.data()),
+                             static_cast<uInt>(dictionary_.size())) == Z_OK;
+
+    // The sync flush ends the block on a byte boundary without ending the
+    // stream, for the next block to carry on.
+    int flush = last_ ? Z_FINISH : Z_SYNC_FLUSH;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(
+        input_.data()));
+    stream.avail_in = static_cast<uInt>(input_.size());
+    char buffer[kOutputBufferSize];
+    int result = Z_OK;
+    while (success) {
+      stream.next_out = reinterpret_cast<Bytef*>(buffer);
+      stream.avail_out = sizeof(buffer);
+      result = deflate(&stream, flush);
+      if (result == Z_STREAM_ERROR) {
+        success = false;
+        break;
+      }
+
+      output_.append(buffer, sizeof(buffer) - stream.avail_out);
+      if (stream.avail_out != 0 && (!last_ || result == Z_STREAM_END))
+        break;
+    }
+
+    deflateEnd(&stream);
+    return success;
+  }
+
+  const std::string name_;
+  const int level_;
+  const bool first_;
+  const bool last_;
+  std::string input_;
+  const std::string dictionary_;
+  const bool background_;
+  std::string output_;
+  uint32 crc_;
+  bool succeeded_;
+  base::WaitableEvent done_;
+
+  DISALLOW_COPY_AND_ASSIGN(Block);
+};
+
+ParallelDeflater::ParallelDeflater(ZipStreamWriter* writer,
+                                   int thread_count,
+                                   size_t block_size,
+                                   size_t max_pending_blocks)
+    : writer_(writer),
+      pool_("ReportCompression", thread_count),
+      pool_running_(true),
+      block_size_(block_size),
+      max_pending_blocks_(max_pending_blocks),
+      in_entry_(false),
+      deflated_entry_(false),
+      first_block_(false),
+      level_(Z_DEFAULT_COMPRESSION),
+      failed_(false),
+      background_(false) {
+  DCHECK(writer_ != NULL);
+  DCHECK_LT(0, thread_count);
+  DCHECK_LT(0u, block_size_);
+  DCHECK_LT(0u, max_pending_blocks_);
+  pool_.Start();
+}
+
+ParallelDeflater::~ParallelDeflater() {
+  StopPool();
+  for (size_t i = 0; i < pending_.size(); ++i)
+    delete pending_[i];
+}
+
+bool ParallelDeflater::BeginEntry(const char* name, int level) {
+  DCHECK(name != NULL);
+  DCHECK(level == Z_DEFAULT_COMPRESSION ||
+         (level >= Z_NO_COMPRESSION && level <= Z_BEST_COMPRESSION));
+  if (in_entry_ && !EndEntry())
+    return false;
+  if (failed_)
+    return false;
+
+  in_entry_ = true;
+  first_block_ = true;
+  level_ = level;
+  entry_name_ = name;
+  input_.clear();
+  dictionary_.clear();
+  return true;
+}
+
+bool ParallelDeflater::WriteEntryData(const char* data, size_t size) {
+  DCHECK(in_entry_ && !deflated_entry_);
+  if (failed_ || !in_entry_ || deflated_entry_)
+    return false;
+
+  while (size != 0) {
+    size_t taken = std::min(size, block_size_ - input_.size());
+    input_.append(data, taken);
+    data += taken;
+    size -= taken;
+    if (input_.size() == block_size_ && !QueueBlock(false))
+      return false;
+  }
+  return true;
+}
+
+bool ParallelDeflater::BeginDeflatedEntry(const char* name) {
+  DCHECK(name != NULL);
+  if (in_entry_ && !EndEntry())
+    return false;
+  while (!failed_ && !pending_.empty()) {
+    if (!WriteOutBlock())
+      return false;
+  }
+  if (failed_)
+    return false;
+
+  if (!writer_->BeginDeflatedEntry(name)) {
+    failed_ = true;
+    return false;
+  }
+  in_entry_ = true;
+  deflated_entry_ = true;
+  return true;
+}
+
+bool ParallelDeflater::WriteDeflatedData(const char* deflated,
+                                         size_t deflated_size,
+                                         uint32 crc,
+                                         uint32 size) {
+  DCHECK(in_entry_ && deflated_entry_);
+  if (failed_ || !in_entry_ || !deflated_entry_)
+    return false;
+
+  if (!writer_->WriteDeflatedData(deflated, deflated_size, crc, size)) {
+    failed_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool ParallelDeflater::EndEntry() {
+  if (!in_entry_)
+    return !failed_;
+
+  in_entry_ = false;
+  if (deflated_entry_) {
+    deflated_entry_ = false;
+    if (failed_ || !writer_->EndEntry()) {
+      failed_ = true;
+      return false;
+    }
+    return true;
+  }
+  return QueueBlock(true);
+}
+
+bool ParallelDeflater::Finish() {
+  bool success = EndEntry();
+  while (success && !pending_.empty())
+    success = WriteOutBlock();
+  StopPool();
+  return success;
+}
+
+bool ParallelDeflater::QueueBlock(bool last) {
+  if (failed_)
+    return false;
+
+  while (pending_.size() >= max_pending_blocks_) {
+    if (!WriteOutBlock())
+      return false;
+  }
+
+  std::string next_dictionary;
+  if (!last) {
+    size_t tail = std::min(input_.size(), kDictionarySize);
+    next_dictionary.assign(input_, input_.size() - tail, tail);
+  }
+
+  Block* block = new Block(entry_name_, level_, first_block_, last, &input_,
+                           dictionary_, background_);
+  pending_.push_back(block);
+  pool_.AddWork(block);
+
+  input_.clear();
+  input_.reserve(block_size_);
+  dictionary_.swap(next_dictionary);
+  first_block_ = false;
+  return true;
+}
+
+bool ParallelDeflater::WriteOutBlock() {
+  DCHECK(!pending_.empty());
+  scoped_ptr<Block> block(pending_.front());
+  pending_.pop_front();
+  block->Wait();
+
+  if (!block->succeeded()) {
+    LOG(ERROR) << "Compression of " << block->name() << " failed.";
+    failed_ = true;
+    return false;
+  }
+
+  if ((block->first() &&
+       !writer_->BeginDeflatedEntry(block->name().c_str())) ||
+      !writer_->WriteDeflatedData(block->output(), block->crc(),
+                                  block->size()) ||
+      (block->last() && !writer_->EndEntry())) {
+    failed_ = true;
+    return false;
+  }
+  return true;
+}
+
+void ParallelDeflater::StopPool() {
+  if (pool_running_) {
+    pool_.JoinAll();
+    pool_running_ = false;
+  }
+}
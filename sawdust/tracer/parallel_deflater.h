@@ -0,0 +1,109 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Compresses zip entries on a pool of threads.
+
+#ifndef SAWDUST_TRACER_PARALLEL_DEFLATER_H_
+#define SAWDUST_TRACER_PARALLEL_DEFLATER_H_
+
+#include <deque>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/threading/simple_thread.h"
+
+class ZipStreamWriter;
+
+// Puts entries into a zip archive, compressing them on a pool of threads.
+// The data of each entry is cut in blocks which are deflated independently,
+// pigz style: every block but an entry's last ends on a sync flush, so the
+// deflated blocks concatenate into the entry's deflate stream, and each is
+// primed with the tail of the block before it so as to lose little of the
+// compression ratio. Blocks of consecutive entries are compressed at the
+// same time, and handed to the writer in order as they are done.
+class ParallelDeflater {
+ public:
+  // |writer| must outlive the deflater. |thread_count| threads compress
+  // blocks of |block_size| bytes, of which at most |max_pending_blocks| are
+  // held in memory at a time.
+  ParallelDeflater(ZipStreamWriter* writer,
+                   int thread_count,
+                   size_t block_size,
+                   size_t max_pending_blocks);
+  // Abandons the blocks not written out yet, after they are compressed.
+  ~ParallelDeflater();
+
+  // Starts an entry named |name|, deflated at |level| (0 to 9, or
+  // Z_DEFAULT_COMPRESSION), ending any entry in progress.
+  bool BeginEntry(const char* name, int level);
+
+  // Adds |size| bytes of |data| to the current entry.
+  bool WriteEntryData(const char* data, size_t size);
+
+  // Starts an entry named |name| whose data comes deflated already, through
+  // WriteDeflatedData, ending any entry in progress. The blocks pending are
+  // written out first, so that the entry keeps its place in the archive.
+  bool BeginDeflatedEntry(const char* name);
+
+  // Writes |deflated_size| bytes at |deflated|, the next piece of the raw
+  // deflate stream of the current entry, which inflates to |size| bytes with
+  // a CRC-32 of |crc|. See ZipStreamWriter::WriteDeflatedData.
+  bool WriteDeflatedData(const char* deflated, size_t deflated_size,
+                         uint32 crc, uint32 size);
+
+  // Ends the current entry.
+  bool EndEntry();
+
+  // Ends any entry in progress and waits for all blocks to be written out.
+  // The archive's directory is then left for the writer to finish.
+  bool Finish();
+
+  // Compresses the blocks queued from now on in background mode, so as not
+  // to compete with the foreground for the CPU and the disk.
+  void set_background(bool background) { background_ = background; }
+
+ private:
+  class Block;
+
+  // Queues the buffered input as the next block of the current entry.
+  bool QueueBlock(bool last);
+
+  // Waits for the oldest pending block to be compressed and writes it out.
+  bool WriteOutBlock();
+
+  // Lets the pool threads finish their work and exit.
+  void StopPool();
+
+  ZipStreamWriter* writer_;
+  base::DelegateSimpleThreadPool pool_;
+  bool pool_running_;
+  size_t block_size_;
+  size_t max_pending_blocks_;
+  // Blocks being compressed or waiting to be written out, oldest first.
+  std::deque<Block*> pending_;
+
+  bool in_entry_;
+  bool deflated_entry_;  // The current entry comes deflated already.
+  bool first_block_;  // No block of the current entry is queued yet.
+  int level_;  // The deflate level of the current entry.
+  bool failed_;
+  bool background_;
+  std::string entry_name_;  // The current entry.
+  std::string input_;  // The input of the next block.
+  std::string dictionary_;  // The tail of the input of the last block.
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelDeflater);
+};
+
+#endif  // SAWDUST_TRACER_PARALLEL_DEFLATER_H_
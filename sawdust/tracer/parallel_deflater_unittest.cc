@@ -0,0 +1,232 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Parallel zip entry compression unittests.
+
+#include "sawdust/tracer/parallel_deflater.h"
+
+#include <algorithm>
+#include <string>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/scoped_temp_dir.h"
+#include "base/utf_string_conversions.h"
+#include "gtest/gtest.h"
+#include "third_party/zlib/zlib.h"
+#include "third_party/zlib/contrib/minizip/unzip.h"
+
+#include "sawdust/tracer/zip_stream_writer.h"
+
+namespace {
+
+const int kThreadCount = 3;
+const size_t kBlockSize = 1000;
+const size_t kMaxPendingBlocks = 5;
+
+// Collects the archive in a string.
+class StringSink : public IArchiveSink {
+ public:
+  StringSink() : fail_after_(std::string::npos) {
+  }
+
+  bool Write(const char* data, size_t size) {
+    if (archive_.size() + size > fail_after_)
+      return false;
+    archive_.append(data, size);
+    return true;
+  }
+
+  void set_fail_after(size_t fail_after) { fail_after_ = fail_after; }
+  const std::string& archive() const { return archive_; }
+
+ private:
+  std::string archive_;
+  size_t fail_after_;
+};
+
+class ParallelDeflaterTest : public testing::Test {
+ public:
+  void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+  // Writes |archive| to a file and opens it for unzipping.
+  unzFile OpenArchive(const std::string& archive) {
+    FilePath path = temp_dir_.path().AppendASCII("archive.zip");
+    if (file_util::WriteFile(path, archive.data(), archive.size()) !=
+        static_cast<int>(archive.size())) {
+      return NULL;
+    }
+    return unzOpen(WideToUTF8(path.value()).c_str());
+  }
+
+  // Reads the entry |name| of |file| into |content|.
+  bool ReadEntry(unzFile file, const char* name, std::string* content) {
+    if (unzLocateFile(file, name, 0) != UNZ_OK ||
+        unzOpenCurrentFile(file) != UNZ_OK) {
+      return false;
+    }
+
+    content->clear();
+    char buffer[1024];
+    int read = 0;
+    while ((read = unzReadCurrentFile(file, buffer, sizeof(buffer))) > 0)
+      content->append(buffer, read);
+
+    // Closing checks the CRC.
+    return unzCloseCurrentFile(file) == UNZ_OK && read == 0;
+  }
+
+ protected:
+  ScopedTempDir temp_dir_;
+};
+
+}  // namespace
+
+TEST_F(ParallelDeflaterTest, WritesReadableArchive) {
+  // Repeats that span blocks exercise the dictionaries.
+  std::string text;
+  for (int i = 0; i < 500; ++i)
+    text.append(i % 7 == 0 ? "A line of text that repeats.\n" : "Another.\n");
+  std::string big;
+  for (int i = 0; i < 100000; ++i)
+    big.push_back(static_cast<char>(i * 7919 % 251));
+  // Exactly two blocks.
+  std::string even(2 * kBlockSize, 'e');
+
+  StringSink sink;
+  ZipStreamWriter writer(&sink);
+  ParallelDeflater deflater(&writer, kThreadCount, kBlockSize,
+                            kMaxPendingBlocks);
+  ASSERT_TRUE(deflater.BeginEntry("text.txt", Z_BEST_COMPRESSION));
+  ASSERT_TRUE(deflater.WriteEntryData(text.data(), text.size()));
+  // Beginning an entry ends the last one.
+  ASSERT_TRUE(deflater.BeginEntry("empty.txt", Z_DEFAULT_COMPRESSION));
+  ASSERT_TRUE(deflater.BeginEntry("big.dat", Z_BEST_SPEED));
+  for (size_t i = 0; i < big.size(); i += 700)
+    ASSERT_TRUE(deflater.WriteEntryData(big.data() + i,
+                                        std::min<size_t>(700, big.size() - i)));
+  ASSERT_TRUE(deflater.BeginEntry("even.txt", Z_NO_COMPRESSION));
+  ASSERT_TRUE(deflater.WriteEntryData(even.data(), even.size()));
+  ASSERT_TRUE(deflater.Finish());
+  ASSERT_TRUE(writer.Finish());
+  EXPECT_EQ(sink.archive().size(), writer.bytes_written());
+
+  unzFile file = OpenArchive(sink.archive());
+  ASSERT_TRUE(file != NULL);
+  std::string content;
+  EXPECT_TRUE(ReadEntry(file, "text.txt", &content));
+  EXPECT_TRUE(text == content);
+  EXPECT_TRUE(ReadEntry(file, "empty.txt", &content));
+  EXPECT_EQ("", content);
+  EXPECT_TRUE(ReadEntry(file, "big.dat", &content));
+  EXPECT_TRUE(big == content);
+  EXPECT_TRUE(ReadEntry(file, "even.txt", &content));
+  EXPECT_TRUE(even == content);
+  // The stored entry didn't shrink.
+  unz_file_info info = {};
+  ASSERT_EQ(UNZ_OK, unzGetCurrentFileInfo(file, &info, NULL, 0, NULL, 0,
+                                          NULL, 0));
+  EXPECT_LT(even.size(), info.compressed_size);
+  EXPECT_EQ(UNZ_OK, unzClose(file));
+}
+
+TEST_F(ParallelDeflaterTest, DeflatedEntryKeepsItsPlace) {
+  std::string before(5 * kBlockSize, 'b');
+  std::string data;
+  for (int i = 0; i < 3000; ++i)
+    data.push_back(static_cast<char>('a' + i % 26));
+
+  // A raw deflate stream, as the precompressor makes them.
+  z_stream stream = {};
+  ASSERT_EQ(Z_OK, deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS,
+                               8, Z_DEFAULT_STRATEGY));
+  std::string deflated(deflateBound(&stream, data.size()), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&deflated[0]);
+  stream.avail_out = static_cast<uInt>(deflated.size());
+  ASSERT_EQ(Z_STREAM_END, deflate(&stream, Z_FINISH));
+  deflated.resize(stream.total_out);
+  deflateEnd(&stream);
+  uint32 crc = crc32(0, reinterpret_cast<const Bytef*>(data.data()),
+                     static_cast<uInt>(data.size()));
+
+  StringSink sink;
+  ZipStreamWriter writer(&sink);
+  ParallelDeflater deflater(&writer, kThreadCount, kBlockSize,
+                            kMaxPendingBlocks);
+  ASSERT_TRUE(deflater.BeginEntry("before.txt", Z_DEFAULT_COMPRESSION));
+  ASSERT_TRUE(deflater.WriteEntryData(before.data(), before.size()));
+  // The deflated data may come in pieces, the CRC and size with any.
+  ASSERT_TRUE(deflater.BeginDeflatedEntry("deflated.txt"));
+  size_t half = deflated.size() / 2;
+  ASSERT_TRUE(deflater.WriteDeflatedData(deflated.data(), half, crc,
+                                         static_cast<uint32>(data.size())));
+  ASSERT_TRUE(deflater.WriteDeflatedData(deflated.data() + half,
+                                         deflated.size() - half, 0, 0));
+  // Beginning an entry ends the deflated one.
+  ASSERT_TRUE(deflater.BeginEntry("after.txt", Z_DEFAULT_COMPRESSION));
+  ASSERT_TRUE(deflater.WriteEntryData(data.data(), data.size()));
+  ASSERT_TRUE(deflater.Finish());
+  ASSERT_TRUE(writer.Finish());
+
+  unzFile file = OpenArchive(sink.archive());
+  ASSERT_TRUE(file != NULL);
+  std::string content;
+  EXPECT_TRUE(ReadEntry(file, "before.txt", &content));
+  EXPECT_TRUE(before == content);
+  EXPECT_TRUE(ReadEntry(file, "deflated.txt", &content));
+  EXPECT_TRUE(data == content);
+  EXPECT_TRUE(ReadEntry(file, "after.txt", &content));
+  EXPECT_TRUE(data == content);
+  EXPECT_EQ(UNZ_OK, unzClose(file));
+}
+
+TEST_F(ParallelDeflaterTest, SinkFailureFailsDeflater) {
+  StringSink sink;
+  sink.set_fail_after(100);
+  ZipStreamWriter writer(&sink);
+  ParallelDeflater deflater(&writer, kThreadCount, kBlockSize,
+                            kMaxPendingBlocks);
+  ASSERT_TRUE(deflater.BeginEntry("data.txt", Z_DEFAULT_COMPRESSION));
+
+  std::string data(10000, 'x');
+  bool success = true;
+  for (int i = 0; i < 100 && success; ++i) {
+    data[i] = static_cast<char>(i);
+    success = deflater.WriteEntryData(data.data(), data.size());
+  }
+  success = success && deflater.Finish();
+  EXPECT_FALSE(success);
+
+  // The deflater stays failed.
+  EXPECT_FALSE(deflater.BeginEntry("more.txt", Z_DEFAULT_COMPRESSION));
+  EXPECT_FALSE(deflater.Finish());
+}
+
+TEST_F(ParallelDeflaterTest, AbandonsPendingBlocks) {
+  StringSink sink;
+  ZipStreamWriter writer(&sink);
+  {
+    ParallelDeflater deflater(&writer, kThreadCount, kBlockSize,
+                              kMaxPendingBlocks);
+    ASSERT_TRUE(deflater.BeginEntry("data.txt", Z_DEFAULT_COMPRESSION));
+    std::string data(3 * kBlockSize, 'x');
+    ASSERT_TRUE(deflater.WriteEntryData(data.data(), data.size()));
+  }
+  // Nothing of the entry made it to the archive.
+  EXPECT_EQ(0u, writer.bytes_written());
+}
@@ -0,0 +1,129 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Deflation of sealed logs ahead of their upload.
+
+#include "sawdust/tracer/precompressed_segment.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "third_party/zlib/zlib.h"
+
+#include "sawdust/tracer/mapped_file_reader.h"
+
+namespace {
+
+const size_t kOutputBufferSize = 64 * 1024;
+
+// Runs |stream| over its input with |flush|, writing all output to |file|.
+bool DeflateInto(z_stream* stream, int flush, FILE* file) {
+  char buffer[kOutputBufferSize];
+  do {
+    stream->next_out = reinterpret_cast<Bytef*>(buffer);
+    stream->avail_out = sizeof(buffer);
+    int result = deflate(stream, flush);
+    if (result == Z_STREAM_ERROR)
+      return false;
+
+    size_t produced = sizeof(buffer) - stream->avail_out;
+    if (produced != 0 && fwrite(buffer, 1, produced, file) != produced)
+      return false;
+  } while (stream->avail_out == 0);
+  return true;
+}
+
+HRESULT DeflateFile(MappedFileReader* reader,
+                    int level,
+                    const bool* abort_flag,
+                    FILE* file,
+                    uint32* crc) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return E_FAIL;
+  }
+
+  *crc = crc32(0L, Z_NULL, 0);
+  HRESULT hr = S_OK;
+  const char* view = NULL;
+  size_t view_size = 0;
+  while (SUCCEEDED(hr) && (hr = reader->NextView(&view, &view_size)) == S_OK) {
+    if (abort_flag != NULL && *abort_flag) {
+      hr = E_ABORT;
+      break;
+    }
+
+    *crc = crc32(*crc, reinterpret_cast<const Bytef*>(view),
+                 static_cast<uInt>(view_size));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(view));
+    stream.avail_in = static_cast<uInt>(view_size);
+    if (!DeflateInto(&stream, Z_NO_FLUSH, file))
+      hr = E_FAIL;
+  }
+
+  if (hr == S_FALSE) {
+    stream.avail_in = 0;
+    hr = DeflateInto(&stream, Z_FINISH, file) ? S_OK : E_FAIL;
+  }
+  deflateEnd(&stream);
+  return hr;
+}
+
+}  // namespace
+
+HRESULT PrecompressSegment(const FilePath& source,
+                           const FilePath& destination,
+                           int level,
+                           const bool* abort_flag,
+                           PrecompressedSegment* segment) {
+  DCHECK(segment != NULL);
+
+  MappedFileReader reader;
+  HRESULT hr = reader.Open(source);
+  if (FAILED(hr)) {
+    LOG(ERROR) << "Unable to map " << source.value() << ".";
+    return hr;
+  }
+  if (reader.file_size() > static_cast<int64>(kuint32max)) {
+    LOG(ERROR) << source.value() << " is too large to precompress.";
+    return E_INVALIDARG;
+  }
+
+  FILE* file = file_util::OpenFile(destination, "wb");
+  if (file == NULL) {
+    LOG(ERROR) << "Unable to create " << destination.value() << ".";
+    return E_ACCESSDENIED;
+  }
+
+  uint32 crc = 0;
+  hr = DeflateFile(&reader, level, abort_flag, file, &crc);
+  if (!file_util::CloseFile(file) && SUCCEEDED(hr))
+    hr = E_FAIL;
+
+  if (FAILED(hr)) {
+    LOG_IF(ERROR, hr != E_ABORT) << "Failed to precompress " <<
+        source.value() << ".";
+    file_util::Delete(destination, false);
+    return hr;
+  }
+
+  segment->path = destination;
+  segment->crc = crc;
+  segment->size = static_cast<uint32>(reader.file_size());
+  return S_OK;
+}
@@ -0,0 +1,45 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Deflation of sealed logs ahead of their upload.
+
+#ifndef SAWDUST_TRACER_PRECOMPRESSED_SEGMENT_H_
+#define SAWDUST_TRACER_PRECOMPRESSED_SEGMENT_H_
+
+#include <windows.h>
+
+#include "base/basictypes.h"
+#include "base/file_path.h"
+
+// A sealed log deflated ahead of its upload, into a raw deflate stream that
+// goes into a zip entry as it is, see ZipStreamWriter::BeginDeflatedEntry.
+struct PrecompressedSegment {
+  PrecompressedSegment() : crc(0), size(0) {}
+
+  FilePath path;  // The deflated data.
+  uint32 crc;  // The CRC-32 of the data before deflation.
+  uint32 size;  // The size of the data before deflation.
+};
+
+// Deflates the file at |source| at |level| (0 to 9, or Z_DEFAULT_COMPRESSION)
+// into |destination|, filling in |segment| with it. Gives up with E_ABORT as
+// |abort_flag| is set, unless that's NULL. On failure |destination| is
+// deleted. Files of 4 GB or more, which don't fit a zip entry, are refused.
+HRESULT PrecompressSegment(const FilePath& source,
+                           const FilePath& destination,
+                           int level,
+                           const bool* abort_flag,
+                           PrecompressedSegment* segment);
+
+#endif  // SAWDUST_TRACER_PRECOMPRESSED_SEGMENT_H_
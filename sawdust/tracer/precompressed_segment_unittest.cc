@@ -0,0 +1,129 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Precompressed segment unittests.
+
+#include "sawdust/tracer/precompressed_segment.h"
+
+#include <string>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/scoped_temp_dir.h"
+#include "gtest/gtest.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+class PrecompressedSegmentTest : public testing::Test {
+ public:
+  void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    source_ = temp_dir_.path().AppendASCII("kernel.etl");
+    destination_ = temp_dir_.path().AppendASCII("kernel.etl.deflate");
+  }
+
+  void WriteSource(const std::string& content) {
+    ASSERT_EQ(static_cast<int>(content.size()),
+              file_util::WriteFile(source_, content.data(), content.size()));
+  }
+
+  // Inflates the raw deflate stream of |deflated| into |content|.
+  static bool Inflate(const std::string& deflated, std::string* content) {
+    z_stream stream = {};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+      return false;
+
+    content->clear();
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(
+        deflated.data()));
+    stream.avail_in = static_cast<uInt>(deflated.size());
+    int result = Z_OK;
+    while (result == Z_OK) {
+      char buffer[1024];
+      stream.next_out = reinterpret_cast<Bytef*>(buffer);
+      stream.avail_out = sizeof(buffer);
+      result = inflate(&stream, Z_NO_FLUSH);
+      content->append(buffer, sizeof(buffer) - stream.avail_out);
+    }
+    inflateEnd(&stream);
+    return result == Z_STREAM_END && stream.avail_in == 0;
+  }
+
+ protected:
+  ScopedTempDir temp_dir_;
+  FilePath source_;
+  FilePath destination_;
+};
+
+}  // namespace
+
+TEST_F(PrecompressedSegmentTest, DeflatesTheFile) {
+  std::string content;
+  for (int i = 0; i < 200000; ++i)
+    content.push_back(static_cast<char>(i % 13 == 0 ? i * 7 : 0));
+  WriteSource(content);
+
+  PrecompressedSegment segment;
+  ASSERT_EQ(S_OK, PrecompressSegment(source_, destination_, Z_BEST_SPEED,
+                                     NULL, &segment));
+  EXPECT_TRUE(segment.path == destination_);
+  EXPECT_EQ(content.size(), segment.size);
+  EXPECT_EQ(crc32(0, reinterpret_cast<const Bytef*>(content.data()),
+                  static_cast<uInt>(content.size())),
+            segment.crc);
+
+  std::string deflated;
+  ASSERT_TRUE(file_util::ReadFileToString(destination_, &deflated));
+  EXPECT_GT(content.size(), deflated.size());
+  std::string inflated;
+  ASSERT_TRUE(Inflate(deflated, &inflated));
+  EXPECT_TRUE(content == inflated);
+}
+
+TEST_F(PrecompressedSegmentTest, DeflatesAnEmptyFile) {
+  WriteSource("");
+
+  PrecompressedSegment segment;
+  ASSERT_EQ(S_OK, PrecompressSegment(source_, destination_,
+                                     Z_DEFAULT_COMPRESSION, NULL, &segment));
+  EXPECT_EQ(0u, segment.size);
+  EXPECT_EQ(crc32(0L, Z_NULL, 0), segment.crc);
+
+  std::string deflated;
+  ASSERT_TRUE(file_util::ReadFileToString(destination_, &deflated));
+  std::string inflated;
+  ASSERT_TRUE(Inflate(deflated, &inflated));
+  EXPECT_EQ("", inflated);
+}
+
+TEST_F(PrecompressedSegmentTest, AbortDeletesTheDestination) {
+  WriteSource(std::string(1000, 'x'));
+
+  bool abort = true;
+  PrecompressedSegment segment;
+  EXPECT_EQ(E_ABORT, PrecompressSegment(source_, destination_,
+                                        Z_DEFAULT_COMPRESSION, &abort,
+                                        &segment));
+  EXPECT_FALSE(file_util::PathExists(destination_));
+  EXPECT_TRUE(segment.path.empty());
+}
+
+TEST_F(PrecompressedSegmentTest, MissingSourceFails) {
+  PrecompressedSegment segment;
+  EXPECT_TRUE(FAILED(PrecompressSegment(source_, destination_,
+                                        Z_DEFAULT_COMPRESSION, NULL,
+                                        &segment)));
+  EXPECT_FALSE(file_util::PathExists(destination_));
+}
@@ -19,28 +19,32 @@
 #include <algorithm>
 #include <strstream>  // NOLINT - streams used as abstracts, without formatting.
 
+#include "base/file_util.h"
 #include "base/logging.h"
 #include "base/scoped_ptr.h"
+#include "base/string_number_conversions.h"
 #include "base/string_util.h"
 #include "base/stringprintf.h"
+#include "base/threading/simple_thread.h"
 #include "base/utf_string_conversions.h"
 
 namespace {
 
+// Root entries are extracted on up to kMaxExtractionThreads threads.
+const int kMaxExtractionThreads = 4;
+
 bool CompareNoCase(const std::wstring& lhv, const std::wstring& rhv) {
   return ::_wcsicmp(lhv.c_str(), rhv.c_str()) <= 0;
 }
 };
 
-// Implementation of a text stream which feeds itself directly on the system
-// registry, yielding its content as defined in the query.
-// Essentially, this is where most of the real work is done.
+// Implementation of a text stream serving the extract, one root entry's
+// buffer after another, straight from the buffers.
 class RegistryExtractor::RegistryStreamBuff : public std::streambuf {
  public:
-  explicit RegistryStreamBuff(const EntriesCollection& pass_entries,
-                              const std::vector<std::wstring>& missing_data)
-      : source_queue_(pass_entries), current_op_buffer_index_(0),
-        formal_buffer_tail_(formal_buffer_), missing_(missing_data) {
+  explicit RegistryStreamBuff(std::vector<std::string>* extract)
+      : extract_(extract), next_block_(0) {
+    DCHECK(extract != NULL);
   }
 
  protected:
@@ -49,206 +53,260 @@ class RegistryExtractor::RegistryStreamBuff : public std::streambuf {
   }
 
   std::streambuf::int_type underflow() {
-    if (gptr() == NULL || gptr() >= egptr()) {
-      if (LoadFormalBuffer()) {
-        setg(formal_buffer_, formal_buffer_, formal_buffer_tail_);
-        return traits_type::to_int_type(*formal_buffer_);
-      } else {
-        return traits_type::eof();
-      }
-    } else {
-      DCHECK(gptr() >= formal_buffer_ && gptr() < formal_buffer_ + kBufferSize);
+    if (gptr() != NULL && gptr() < egptr())
       return traits_type::to_int_type(*gptr());
-    }
-  }
 
-  // Load data into the formal buffer from operation_buffer_. If operation
-  // buffer is used up, need to produce some more data.
-  bool LoadFormalBuffer() {
-    if (operation_buffer_.empty() ||
-        current_op_buffer_index_ >= operation_buffer_.size()) {
-      GetMoreData();
+    while (next_block_ < extract_->size() &&
+           (*extract_)[next_block_].empty()) {
+      ++next_block_;
     }
+    if (next_block_ == extract_->size())
+      return traits_type::eof();
 
-    if (operation_buffer_.empty())
-      return false;  // No data produced, we are done.
-
-    DCHECK(current_op_buffer_index_ >= 0 &&
-           current_op_buffer_index_ < operation_buffer_.size());
+    std::string& block = (*extract_)[next_block_++];
+    setg(&block[0], &block[0], &block[0] + block.size());
+    return traits_type::to_int_type(*gptr());
+  }
 
-    std::string::iterator src_iterator = operation_buffer_.begin() +
-                                         current_op_buffer_index_;
-    std::string::iterator end_iterator;
+ private:
+  std::vector<std::string>* extract_;
+  size_t next_block_;
+};
 
-    if (operation_buffer_.end() - src_iterator < kBufferSize)
-      end_iterator = operation_buffer_.end();
-    else
-      end_iterator = src_iterator + kBufferSize;
+// Extracts a root entry on a pool thread.
+class RegistryExtractor::EntryExtraction
+    : public base::DelegateSimpleThread::Delegate {
+ public:
+  EntryExtraction(const ScanEntryDef& entry, base::Time unchanged_since,
+                  std::string* output)
+      : entry_(entry), unchanged_since_(unchanged_since), output_(output) {
+  }
 
-    formal_buffer_tail_ = std::copy(src_iterator, end_iterator, formal_buffer_);
-    current_op_buffer_index_ = static_cast<std::string::size_type>(
-        end_iterator - operation_buffer_.begin());
-    return true;
+  virtual void Run() {
+    ExtractEntry(entry_, unchanged_since_, output_);
   }
 
-  // Advance the processing by munching the item on the stack.
-  void GetMoreData() {
-    operation_buffer_.clear();
-    current_op_buffer_index_ = 0;
+ private:
+  ScanEntryDef entry_;
+  base::Time unchanged_since_;
+  std::string* output_;
+
+  DISALLOW_COPY_AND_ASSIGN(EntryExtraction);
+};
 
-    if (current_stack_.empty()) {
-      if (!source_queue_.empty()) {
-        current_stack_.push_back(source_queue_.front());
-        source_queue_.pop_front();
+RegistryExtractor::RegistryExtractor()
+    : extracted_(false), next_block_(0), own_data_stream_(NULL) {
+}
+
+void RegistryExtractor::ExtractEntry(const ScanEntryDef& entry,
+                                     base::Time unchanged_since,
+                                     std::string* output) {
+  DCHECK(output != NULL);
+  if (!entry.value_name_.empty()) {
+    // An easy one. Just output the key data. Since value entries other than
+    // these find in the input list are never put on stack, we don't need to
+    // worry here about indentation.
+    DCHECK_EQ(entry.indent_, unsigned(0));
+    std::string formatted_value;
+    base::win::RegKey parent_key(entry.root_, entry.path_.c_str(), KEY_READ);
+    if (parent_key.Valid() &&
+        parent_key.ValueExists(entry.value_name_.c_str())) {
+      if (!CreateFormattedRegValue(&parent_key, entry.value_name_.c_str(), 0,
+                                   &formatted_value)) {
+        formatted_value = "ERROR: could not retrieve the value!";
       }
+    } else {
+      formatted_value = "ERROR: the value is GONE!";
     }
 
-    if (current_stack_.empty())
-      return;  // Nothing to do.
-
-    EntriesCollection stack_tack;
-
-    // The 'stack' concept here is a bit abused. Since I want to take advantage
-    // of RegKey iteration, I will list each element's sub-keys right away and
-    // tuck them to the stack-o-list (in reverse order). This will give me a
-    // depth-first behavior without the need to remember the iterator state.
-    const ScanEntryDef& this_entry = current_stack_.back();
-
-    if (!this_entry.value_name_.empty()) {
-      // An easy one. Just output the key data. Since value entries other than
-      // these find in the input list are never put on stack, we don't need to
-      // worry here about indentation.
-      DCHECK_EQ(this_entry.indent_, unsigned(0));
-      std::string formatted_value;
-      base::win::RegKey parent_key(this_entry.root_, this_entry.path_.c_str(),
-                                   KEY_READ);
-      if (parent_key.Valid() &&
-          parent_key.ValueExists(this_entry.value_name_.c_str())) {
-        if (!CreateFormattedRegValue(&parent_key,
-                                     this_entry.value_name_.c_str(), 0,
-                                     &formatted_value)) {
-          formatted_value = "ERROR: could not retrieve the value!";
-        }
-      } else {
-        formatted_value = "ERROR: the value is GONE!";
-      }
+    base::StringAppendF(output, "%s\\%s\\%s\t(%s)\n",
+                        entry.root_name_.c_str(),
+                        WideToUTF8(entry.path_).c_str(),
+                        WideToUTF8(entry.value_name_).c_str(),
+                        formatted_value.c_str());
+    return;
+  }
 
-      operation_buffer_.reserve(formatted_value.size() + 64 +
-                                2 * (this_entry.path_.size() +
-                                     this_entry.value_name_.size()));
-      base::SStringPrintf(&operation_buffer_, "%s\\%s\\%s\t(%s)\n",
-                          this_entry.root_name_.c_str(),
-                          WideToUTF8(this_entry.path_).c_str(),
-                          WideToUTF8(this_entry.value_name_).c_str(),
-                          formatted_value.c_str());
-    } else {
-      // Here, we need to employ iterators walking over values and keys.
-      base::win::RegKey values_key(this_entry.root_,
-                                   this_entry.path_.c_str(), KEY_READ);
-      int value_count = values_key.ValueCount();
-
-      // First size guesstimate.
-      operation_buffer_.reserve(256 + 128 * value_count);
-
-      if (this_entry.indent_ > 0) {
-        std::wstring::const_reverse_iterator last_segment_it =
-            std::find(this_entry.path_.rbegin(),
-                      this_entry.path_.rend(), L'\\');
-
-        std::wstring last_segment(last_segment_it.base(),
-                                  this_entry.path_.end());
-        operation_buffer_.append(this_entry.indent_, '\t');
-        operation_buffer_.append(WideToUTF8(last_segment));
-        operation_buffer_.append(1, '\n');
-      } else {
-        base::SStringPrintf(&operation_buffer_, "%s\\%s\n",
-                            this_entry.root_name_.c_str(),
-                            WideToUTF8(this_entry.path_).c_str());
-      }
+  // The 'stack' concept here is a bit abused. Since I want to take advantage
+  // of key enumeration, I will list each element's sub-keys right away and
+  // tuck them to the stack-o-list (in reverse order). This will give me a
+  // depth-first behavior without the need to remember the iterator state.
+  EntriesCollection stack;
+  stack.push_back(entry);
+  while (!stack.empty()) {
+    ScanEntryDef this_entry = stack.back();
+    stack.pop_back();
+    ExtractKey(this_entry, unchanged_since, &stack, output);
+  }
+}
 
-      std::wstring value_name;
-      std::string formatted_value;
-      for (int i = 0;
-           i < value_count &&
-           ERROR_SUCCESS == values_key.ReadName(i, &value_name); ++i) {
-        operation_buffer_.append(this_entry.indent_ + 1, '\t');
-        std::string formatted_val;
-        if (CreateFormattedRegValue(&values_key, value_name.c_str(),
-                                    this_entry.indent_ + 2, &formatted_val)) {
-          base::StringAppendF(&operation_buffer_, "%s\t(%s)\n",
-                              WideToUTF8(value_name).c_str(),
-                              formatted_val.c_str());
-        } else {
-          operation_buffer_.append(WideToUTF8(value_name));
-          operation_buffer_.append("\t(Failed to extract the value)\n");
-        }
+void RegistryExtractor::ExtractKey(const ScanEntryDef& entry,
+                                   base::Time unchanged_since,
+                                   EntriesCollection* stack,
+                                   std::string* output) {
+  if (entry.indent_ > 0) {
+    std::wstring::const_reverse_iterator last_segment_it =
+        std::find(entry.path_.rbegin(), entry.path_.rend(), L'\\');
+
+    std::wstring last_segment(last_segment_it.base(), entry.path_.end());
+    output->append(entry.indent_, '\t');
+    output->append(WideToUTF8(last_segment));
+    output->append(1, '\n');
+  } else {
+    base::StringAppendF(output, "%s\\%s\n", entry.root_name_.c_str(),
+                        WideToUTF8(entry.path_).c_str());
+  }
+
+  base::win::RegKey key(entry.root_, entry.path_.c_str(), KEY_READ);
+  DWORD subkey_count = 0;
+  DWORD max_subkey_length = 0;
+  DWORD value_count = 0;
+  DWORD max_value_name_length = 0;
+  DWORD max_value_size = 0;
+  FILETIME last_write = {};
+  if (!key.Valid() ||
+      ::RegQueryInfoKey(key.Handle(), NULL, NULL, NULL, &subkey_count,
+                        &max_subkey_length, NULL, &value_count,
+                        &max_value_name_length, &max_value_size, NULL,
+                        &last_write) != ERROR_SUCCESS) {
+    output->append(entry.indent_ + 1, '\t');
+    output->append("(Failed to open the key)\n");
+    return;
+  }
+
+  if (!unchanged_since.is_null() &&
+      base::Time::FromFileTime(last_write) < unchanged_since) {
+    output->append(entry.indent_ + 1, '\t');
+    output->append("(Values unchanged since the last report)\n");
+  } else if (value_count > 0) {
+    // Make room for all values up front, guessing the formatted data takes
+    // about twice the raw.
+    output->reserve(output->size() + value_count *
+        (entry.indent_ + 8 + max_value_name_length + 2 * max_value_size));
+
+    // Each value comes with its data in one call.
+    scoped_array<wchar_t> name(new wchar_t[max_value_name_length + 1]);
+    size_t data_length = max_value_size / sizeof(wchar_t) + 2;
+    scoped_array<wchar_t> data(new wchar_t[data_length]);
+    for (DWORD i = 0; i < value_count; ++i) {
+      DWORD name_length = max_value_name_length + 1;
+      DWORD type = REG_NONE;
+      DWORD size = static_cast<DWORD>(data_length * sizeof(wchar_t));
+      LONG result = ::RegEnumValue(key.Handle(), i, name.get(), &name_length,
+                                   NULL, &type,
+                                   reinterpret_cast<BYTE*>(data.get()),
+                                   &size);
+      if (result == ERROR_NO_MORE_ITEMS)
+        break;
+
+      std::string value_name;
+      std::string formatted_val;
+      bool formatted = false;
+      if (result == ERROR_SUCCESS) {
+        value_name = WideToUTF8(std::wstring(name.get(), name_length));
+        formatted = FormatRegValue(type, data.get(), size, entry.indent_ + 2,
+                                   &formatted_val);
+      } else if (result == ERROR_MORE_DATA) {
+        // The value grew since the key was queried, read it on its own.
+        value_name = WideToUTF8(std::wstring(name.get(), name_length));
+        formatted = CreateFormattedRegValue(&key, name.get(),
+                                            entry.indent_ + 2, &formatted_val);
+      } else {
+        continue;
       }
 
-      // Having written out all values, we now list all child entries.
-      base::win::RegistryKeyIterator keys(this_entry.root_,
-                                          this_entry.path_.c_str());
-      while (keys.Valid()) {
-        stack_tack.push_back(ScanEntryDef());
-        ScanEntryDef& new_entry = stack_tack.back();
-        new_entry.indent_ = this_entry.indent_ + 1;
-        new_entry.root_ = this_entry.root_;
-        new_entry.path_ = this_entry.path_;
-        new_entry.path_ += L'\\';
-        new_entry.path_ += keys.Name();
-
-        ++keys;
+      output->append(entry.indent_ + 1, '\t');
+      if (formatted) {
+        base::StringAppendF(output, "%s\t(%s)\n", value_name.c_str(),
+                            formatted_val.c_str());
+      } else {
+        output->append(value_name);
+        output->append("\t(Failed to extract the value)\n");
       }
     }
-
-    current_stack_.pop_back();
-    // Normally we would insert in opposite order. However, RegistryKeyIterator
-    // walks in the reverse order (comparing to what we would normally see in
-    // regedit). Thus, it is enough to just tuck the list to the end.
-    current_stack_.insert(current_stack_.end(),
-                          stack_tack.begin(), stack_tack.end());
-
-    if (current_stack_.empty() && source_queue_.empty())
-      AppendErrorList();
   }
 
-  void AppendErrorList() {
-    if (missing_.empty())
-      return;
-    operation_buffer_.reserve(operation_buffer_.size() +
-                              missing_.size() * 256 + 64);
+  // Having written out all values, we now list all child entries. They are
+  // enumerated from the last, so that the first ends on top of the stack and
+  // comes out first.
+  scoped_array<wchar_t> subkey_name(new wchar_t[max_subkey_length + 1]);
+  EntriesCollection subkeys;
+  for (DWORD i = subkey_count; i > 0; --i) {
+    DWORD name_length = max_subkey_length + 1;
+    if (::RegEnumKeyEx(key.Handle(), i - 1, subkey_name.get(), &name_length,
+                       NULL, NULL, NULL, NULL) != ERROR_SUCCESS) {
+      continue;
+    }
+    subkeys.push_back(ScanEntryDef());
+    ScanEntryDef& new_entry = subkeys.back();
+    new_entry.indent_ = entry.indent_ + 1;
+    new_entry.root_ = entry.root_;
+    new_entry.path_ = entry.path_;
+    new_entry.path_ += L'\\';
+    new_entry.path_.append(subkey_name.get(), name_length);
+  }
+  stack->insert(stack->end(), subkeys.begin(), subkeys.end());
+}
 
-    base::StringAppendF(&operation_buffer_,
-                        "\n%s\n", "Keys / values not found:");
+void RegistryExtractor::Extract() {
+  if (extracted_)
+    return;
+  extracted_ = true;
+  extract_time_ = base::Time::Now();
+
+  base::Time unchanged_since;
+  std::string stamp;
+  int64 stamp_value = 0;
+  if (!stamp_path_.empty() &&
+      file_util::ReadFileToString(stamp_path_, &stamp) &&
+      base::StringToInt64(stamp, &stamp_value)) {
+    unchanged_since = base::Time::FromInternalValue(stamp_value);
+  }
 
-    for (std::vector<std::wstring>::const_iterator it = missing_.begin();
-         it != missing_.end(); ++it) {
-      operation_buffer_.append(1, '\t');
-      operation_buffer_.append(WideToUTF8(*it));
-      operation_buffer_.append(1, '\n');
+  extract_.clear();
+  extract_.resize(validated_root_entries_.size() + 1);
+  int thread_count = std::min(static_cast<int>(validated_root_entries_.size()),
+                              kMaxExtractionThreads);
+  if (thread_count > 1) {
+    // The extractions must outlive the pool's work on them.
+    std::vector<EntryExtraction*> extractions;
+    base::DelegateSimpleThreadPool pool("RegistryExtraction", thread_count);
+    pool.Start();
+    size_t i = 0;
+    for (EntriesCollection::const_iterator it =
+             validated_root_entries_.begin();
+         it != validated_root_entries_.end(); ++it, ++i) {
+      extractions.push_back(new EntryExtraction(*it, unchanged_since,
+                                                &extract_[i]));
+      pool.AddWork(extractions.back());
     }
+    pool.JoinAll();
+    for (size_t j = 0; j < extractions.size(); ++j)
+      delete extractions[j];
+  } else if (thread_count == 1) {
+    ExtractEntry(validated_root_entries_.front(), unchanged_since,
+                 &extract_[0]);
   }
 
- private:
-  static const int kBufferSize = 4096;
-  char formal_buffer_[kBufferSize];
-  char* formal_buffer_tail_;  // Points behind the actual data in the buffer.
-
-  // Inflatable buffer into which text will be first put.
-  std::string operation_buffer_;
-  // Points behind data loaded into formal.
-  std::string::size_type current_op_buffer_index_;
-
-  EntriesCollection source_queue_;
-  EntriesCollection current_stack_;
-  std::vector<std::wstring> missing_;
-};
+  std::string& missing = extract_.back();
+  if (!missing_entries_.empty()) {
+    base::StringAppendF(&missing, "\n%s\n", "Keys / values not found:");
 
-RegistryExtractor::RegistryExtractor() : own_data_stream_(NULL) {
+    for (std::vector<std::wstring>::const_iterator it =
+             missing_entries_.begin();
+         it != missing_entries_.end(); ++it) {
+      missing.append(1, '\t');
+      missing.append(WideToUTF8(*it));
+      missing.append(1, '\n');
+    }
+  }
 }
 
 void RegistryExtractor::Reset() {
   validated_root_entries_.clear();
   missing_entries_.clear();
+  extract_.clear();
+  extracted_ = false;
 }
 
 // The routine tries to break the string first as a key path and then as a value
@@ -354,24 +412,48 @@ int RegistryExtractor::Initialize(
     ++pass_counter;
   }
 
-  current_streambuff_.reset(new RegistryStreamBuff(validated_root_entries_,
-                                                   missing_entries_));
+  extracted_ = false;
+  next_block_ = 0;
+  current_streambuff_.reset(new RegistryStreamBuff(&extract_));
   own_data_stream_.rdbuf(current_streambuff_.get());
   return pass_counter;
 }
 
 std::istream& RegistryExtractor::Data() {
   DCHECK(own_data_stream_.rdbuf() == current_streambuff_.get());
+  Extract();
   return own_data_stream_;
 }
 
+HRESULT RegistryExtractor::NextBlock(const char** data, size_t* size) {
+  DCHECK(data != NULL && size != NULL);
+  Extract();
+  while (next_block_ < extract_.size() && extract_[next_block_].empty())
+    ++next_block_;
+  if (next_block_ == extract_.size())
+    return S_FALSE;
+
+  const std::string& block = extract_[next_block_++];
+  *data = block.data();
+  *size = block.size();
+  return S_OK;
+}
+
 void RegistryExtractor::MarkCompleted() {
   DCHECK(own_data_stream_.rdbuf() == current_streambuff_.get());
-  current_streambuff_.reset(new RegistryStreamBuff(validated_root_entries_,
-                                                   missing_entries_));
+  if (extracted_ && !stamp_path_.empty()) {
+    std::string stamp(base::Int64ToString(extract_time_.ToInternalValue()));
+    if (file_util::WriteFile(stamp_path_, stamp.data(), stamp.size()) !=
+        static_cast<int>(stamp.size())) {
+      LOG(WARNING) << "Unable to write " << stamp_path_.value();
+    }
+  }
+
+  // Rewinds, serving the same extract again.
+  next_block_ = 0;
+  current_streambuff_.reset(new RegistryStreamBuff(&extract_));
   own_data_stream_.rdbuf(current_streambuff_.get());
 }
-
 bool RegistryExtractor::FormatBinaryValue(const char* buffer,
                                           size_t buffer_size,
                                           std::string* formatted_output) {
@@ -451,14 +533,22 @@ bool RegistryExtractor::CreateFormattedRegValue(base::win::RegKey* key,
                                &size, &type) == ERROR_SUCCESS;
   }
 
-  if (succeeded)
-    formatted_utf8->clear();
+  return succeeded && FormatRegValue(type, utility_buffer, size,
+                                     multiline_indent, formatted_utf8);
+}
+
+bool RegistryExtractor::FormatRegValue(DWORD type, const wchar_t* data,
+                                       DWORD size, int multiline_indent,
+                                       std::string* formatted_utf8) {
+  DCHECK(formatted_utf8 != NULL);
+  bool succeeded = true;
+  formatted_utf8->clear();
 
-  if (succeeded && size > 0) {
+  if (size > 0) {
     switch (type) {
       case REG_DWORD: {
         DCHECK_EQ(size, size_t(4));  // REG_DWORD is 32-bit, by doc.
-        uint32* cast_buff = reinterpret_cast<uint32*>(utility_buffer);
+        const uint32* cast_buff = reinterpret_cast<const uint32*>(data);
         // No need to worry about endian-ness. It is windows and little-endian
         // has a separate type.
         base::SStringPrintf(formatted_utf8, "0x%0*X", 8, *cast_buff);
@@ -466,25 +556,23 @@ bool RegistryExtractor::CreateFormattedRegValue(base::win::RegKey* key,
       }
       case REG_QWORD: {
         DCHECK_EQ(size, size_t(8));  // REG_QWORD is 64-bit, by doc.
-        uint64* cast_buff = reinterpret_cast<uint64*>(utility_buffer);
+        const uint64* cast_buff = reinterpret_cast<const uint64*>(data);
         base::SStringPrintf(formatted_utf8, "0x%0*I64X", 16, *cast_buff);
         break;
       }
       case REG_SZ: {
         DCHECK_EQ(size % 2, size_t(0));
         // Give length without the trailing zero.
-        succeeded = WideToUTF8(utility_buffer, size / 2 - 1, formatted_utf8);
+        succeeded = WideToUTF8(data, size / 2 - 1, formatted_utf8);
         break;
       }
       case REG_EXPAND_SZ: {
-        size_t required_length = ExpandEnvironmentStrings(utility_buffer,
-                                                          NULL, 0);
+        size_t required_length = ExpandEnvironmentStrings(data, NULL, 0);
         if (required_length > 0) {
           required_length += 2;
           wchar_t* expand_buffer = reinterpret_cast<wchar_t*>(
               malloc(required_length * sizeof(wchar_t)));
-          size_t copy_length = ExpandEnvironmentStrings(utility_buffer,
-                                                        expand_buffer,
+          size_t copy_length = ExpandEnvironmentStrings(data, expand_buffer,
                                                         required_length);
           // Success: returns the number of wchar_t's copied
           // Fail: buffer too small, returns the size required
@@ -501,14 +589,13 @@ bool RegistryExtractor::CreateFormattedRegValue(base::win::RegKey* key,
       }
       case REG_MULTI_SZ: {
         DCHECK_EQ(size % sizeof(wchar_t), size_t(0));
-        succeeded = FormatMultiStringValue(utility_buffer,
-                                           size / sizeof(wchar_t),
+        succeeded = FormatMultiStringValue(data, size / sizeof(wchar_t),
                                            multiline_indent, formatted_utf8);
         break;
       }
       case REG_BINARY: {
-        succeeded = FormatBinaryValue(reinterpret_cast<char*>(utility_buffer),
-                                      size, formatted_utf8);
+        succeeded = FormatBinaryValue(reinterpret_cast<const char*>(data), size,
+                                      formatted_utf8);
         break;
       }
       default:
@@ -21,6 +21,8 @@
 #include <string>
 #include <vector>
 
+#include "base/file_path.h"
+#include "base/time.h"
 #include "base/win/registry.h"
 
 #include "sawdust/tracer/configuration.h"
@@ -46,6 +48,10 @@
 // as defined in registry (valued first). Indentation is marked by \t symbol,
 // which also separates value names from data stored there. Integral values are
 // shown as hex, binary data as byte-wide hex.
+// The entries are extracted on a few threads at the first read, each into a
+// buffer sized up front, and the buffers are then served in order as they
+// are. An incremental extract lists the keys not written since the last
+// report without their values, see set_stamp_path.
 class RegistryExtractor : public IReportContentEntry {
  public:
   RegistryExtractor();
@@ -59,7 +65,16 @@ class RegistryExtractor : public IReportContentEntry {
   // (which will be recursed) or a value.
   virtual int Initialize(const std::vector<std::wstring>& input_container);
 
+  // Makes the extract incremental. The time of the last extract to go into
+  // a report is kept in the file at |stamp_path|, which MarkCompleted
+  // updates. A key not written since then is listed with a note in place of
+  // its values. Its subkeys are still walked, as writing to a subkey leaves
+  // the key's own write time alone.
+  void set_stamp_path(const FilePath& stamp_path) { stamp_path_ = stamp_path; }
+
   std::istream& Data();
+  // Hands out the extract of each entry as it is, without a copy.
+  HRESULT NextBlock(const char** data, size_t* size);
   void MarkCompleted();
 
   const char* Title() const { return "RegistryExtract.txt"; }
@@ -82,6 +97,11 @@ class RegistryExtractor : public IReportContentEntry {
                                       const wchar_t* value_name,
                                       int multiline_indent,
                                       std::string* formatted_utf8);
+  // Formats |size| bytes of |data|, a value of registry |type| as read, the
+  // way CreateFormattedRegValue does.
+  static bool FormatRegValue(DWORD type, const wchar_t* data, DWORD size,
+                             int multiline_indent,
+                             std::string* formatted_utf8);
  protected:
   // A structure holding information about a registry key or value.
   // It is a value if |value_name_| is not empty.
@@ -107,12 +127,36 @@ class RegistryExtractor : public IReportContentEntry {
   static bool VerifiedEntryFromString(const std::wstring& full_path,
                                       ScanEntryDef* entry);
 
+  // Appends the extract of |entry|, a value or a whole key, to |output|.
+  // Keys not written since |unchanged_since| are listed without values,
+  // unless it's null.
+  static void ExtractEntry(const ScanEntryDef& entry,
+                           base::Time unchanged_since,
+                           std::string* output);
+  // Appends the extract of |entry|'s key, without its subkeys, to |output|
+  // and pushes the subkeys on |stack|.
+  static void ExtractKey(const ScanEntryDef& entry,
+                         base::Time unchanged_since,
+                         EntriesCollection* stack,
+                         std::string* output);
+
  private:
   class RegistryStreamBuff;
+  class EntryExtraction;
+
+  // Extracts all entries into extract_, unless done already.
+  void Extract();
 
   EntriesCollection validated_root_entries_;
   std::vector<std::wstring> missing_entries_;
 
+  // The extract of each root entry, in order, then the list of missing ones.
+  std::vector<std::string> extract_;
+  bool extracted_;
+  base::Time extract_time_;
+  size_t next_block_;  // The extract_ NextBlock hands out next.
+  FilePath stamp_path_;
+
   std::istream own_data_stream_;
 
   scoped_ptr<std::streambuf> current_streambuff_;
@@ -20,8 +20,10 @@
 #include <string>
 #include <vector>
 
+#include "base/file_util.h"
 #include "base/logging.h"
 #include "base/scoped_ptr.h"
+#include "base/scoped_temp_dir.h"
 #include "base/string_split.h"
 #include "base/stringprintf.h"
 #include "base/utf_string_conversions.h"
@@ -576,4 +578,82 @@ TEST_F(RegistryExtractorTest, RecursiveDescent) {
   }
 }
 
+TEST_F(RegistryExtractorTest, BlocksMatchData) {
+  base::win::RegKey reg_folder(HKEY_CURRENT_USER, kTreeExerciseKey,
+                               KEY_ALL_ACCESS);
+  reg_folder.WriteValue(L"Value_Str1", L"A text value");
+  reg_folder.CreateKey(L"Branch_A", KEY_ALL_ACCESS);
+  reg_folder.WriteValue(L"Value_DW1", 42);
+
+  std::vector<std::wstring> init_box;
+  init_box.push_back(std::wstring(L"HKEY_CURRENT_USER\") + kTreeExerciseKey);
+  init_box.push_back(std::wstring(L"HKEY_CURRENT_USER\") + kListExerciseKey);
+
+  RegistryExtractor harvester;
+  ASSERT_EQ(1, harvester.Initialize(init_box));
+  std::string all_content(std::istreambuf_iterator<char>(harvester.Data()),
+                          std::istreambuf_iterator<char>());
+  EXPECT_NE(std::string::npos, all_content.find("Keys / values not found:"));
+
+  std::string all_blocks;
+  const char* data = NULL;
+  size_t size = 0;
+  HRESULT hr = S_OK;
+  while ((hr = harvester.NextBlock(&data, &size)) == S_OK)
+    all_blocks.append(data, size);
+  EXPECT_EQ(S_FALSE, hr);
+  EXPECT_EQ(all_content, all_blocks);
+
+  // Completing rewinds to the same extract.
+  harvester.MarkCompleted();
+  ASSERT_EQ(S_OK, harvester.NextBlock(&data, &size));
+  EXPECT_EQ(0, all_content.compare(0, size, data, size));
+}
+
+TEST_F(RegistryExtractorTest, IncrementalExtract) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath stamp_path(temp_dir.path().Append(L"registry.stamp"));
+
+  base::win::RegKey reg_folder(HKEY_CURRENT_USER, kTreeExerciseKey,
+                               KEY_ALL_ACCESS);
+  reg_folder.WriteValue(L"Value_Str1", L"A text value");
+  base::win::RegKey branch(HKEY_CURRENT_USER, kTreeExerciseKey,
+                           KEY_ALL_ACCESS);
+  branch.CreateKey(L"Branch_A", KEY_ALL_ACCESS);
+  branch.WriteValue(L"Value_DW1", 42);
+
+  std::vector<std::wstring> init_box;
+  init_box.push_back(std::wstring(L"HKEY_CURRENT_USER\") + kTreeExerciseKey);
+  const char kUnchanged[] = "(Values unchanged since the last report)";
+
+  // With no stamp yet, all goes.
+  {
+    RegistryExtractor harvester;
+    harvester.set_stamp_path(stamp_path);
+    ASSERT_EQ(1, harvester.Initialize(init_box));
+    std::string all_content(std::istreambuf_iterator<char>(harvester.Data()),
+                            std::istreambuf_iterator<char>());
+    EXPECT_NE(std::string::npos, all_content.find("Value_Str1"));
+    EXPECT_NE(std::string::npos, all_content.find("Value_DW1"));
+    EXPECT_EQ(std::string::npos, all_content.find(kUnchanged));
+    harvester.MarkCompleted();
+  }
+  ASSERT_TRUE(file_util::PathExists(stamp_path));
+
+  // Now only the key written since goes with its values.
+  reg_folder.WriteValue(L"Value_Str2", L"Another text");
+  {
+    RegistryExtractor harvester;
+    harvester.set_stamp_path(stamp_path);
+    ASSERT_EQ(1, harvester.Initialize(init_box));
+    std::string all_content(std::istreambuf_iterator<char>(harvester.Data()),
+                            std::istreambuf_iterator<char>());
+    EXPECT_NE(std::string::npos, all_content.find("Value_Str2"));
+    EXPECT_NE(std::string::npos, all_content.find("Branch_A"));
+    EXPECT_EQ(std::string::npos, all_content.find("Value_DW1"));
+    EXPECT_NE(std::string::npos, all_content.find(kUnchanged));
+  }
+}
+
 }  // namespace
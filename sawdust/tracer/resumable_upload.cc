@@ -0,0 +1,229 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Resumable uploads implementation.
+
+#include "sawdust/tracer/resumable_upload.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/string_number_conversions.h"
+#include "base/string_util.h"
+#include "base/stringprintf.h"
+#include "base/utf_string_conversions.h"
+#include "third_party/zlib/zlib.h"
+
+#include "sawdust/tracer/chunked_upload.h"
+#include "sawdust/tracer/com_utils.h"
+
+namespace {
+
+const char kOffsetPrefix[] = "offset=";
+const wchar_t kChunkContentType[] = L"application/octet-stream";
+
+// Reads up to |size| bytes of |file| at |offset| into |chunk|.
+bool ReadChunk(FILE* file, uint64 offset, size_t size, std::string* chunk) {
+  if (_fseeki64(file, static_cast<int64>(offset), SEEK_SET) != 0)
+    return false;
+
+  chunk->resize(size);
+  size_t read = size == 0 ? 0 : fread(&(*chunk)[0], 1, size, file);
+  chunk->resize(read);
+  return read == size || !ferror(file);
+}
+}
+
+HRESULT UploadResumably(const FilePath& path,
+                        const std::string& upload_id,
+                        size_t chunk_size,
+                        IResumableUploadTransport* transport,
+                        const bool* abort_flag) {
+  DCHECK(!upload_id.empty());
+  DCHECK_LT(0u, chunk_size);
+  DCHECK(transport != NULL);
+
+  int64 file_size = 0;
+  if (!file_util::GetFileSize(path, &file_size)) {
+    LOG(ERROR) << "Cannot read the size of " << path.value();
+    return E_ACCESSDENIED;
+  }
+  uint64 size = static_cast<uint64>(file_size);
+
+  uint64 offset = 0;
+  HRESULT hr = transport->QueryOffset(upload_id, &offset);
+  if (FAILED(hr))
+    return hr;
+  if (offset > size) {
+    LOG(ERROR) << "The server holds more of upload " << upload_id
+        << " than there is.";
+    return E_UNEXPECTED;
+  }
+  LOG_IF(INFO, offset != 0) << "Resuming upload " << upload_id << " at "
+      << offset << " of " << size << " bytes.";
+
+  FILE* file = file_util::OpenFile(path, "rb");
+  if (file == NULL)
+    return E_ACCESSDENIED;
+
+  // The last chunk goes out even if the server holds all the bytes, as it
+  // completes the upload.
+  std::string chunk;
+  int attempts = 0;
+  bool done = false;
+  while (SUCCEEDED(hr) && !done) {
+    if (abort_flag != NULL && *abort_flag) {
+      hr = E_ABORT;
+      break;
+    }
+
+    size_t length = static_cast<size_t>(
+        std::min(static_cast<uint64>(chunk_size), size - offset));
+    if (!ReadChunk(file, offset, length, &chunk)) {
+      LOG(ERROR) << "Failed to read " << path.value();
+      hr = E_FAIL;
+      break;
+    }
+
+    bool last = offset + length == size;
+    uint32 crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(chunk.data()),
+                static_cast<uInt>(chunk.size()));
+
+    uint64 acknowledged = offset;
+    hr = transport->SendChunk(upload_id, offset, chunk, crc, last,
+                              &acknowledged);
+    if (FAILED(hr)) {
+      // The chunk may or may not have made it, ask the server.
+      LOG(WARNING) << "Sending a chunk of upload " << upload_id
+          << " failed. " << com::LogHr(hr);
+      hr = transport->QueryOffset(upload_id, &acknowledged);
+      if (FAILED(hr))
+        break;
+    }
+
+    if (acknowledged == offset + length) {
+      offset = acknowledged;
+      attempts = 0;
+      done = last;
+    } else if (acknowledged > size) {
+      LOG(ERROR) << "The server holds more of upload " << upload_id
+          << " than there is.";
+      hr = E_UNEXPECTED;
+    } else {
+      // The chunk didn't take, go on from where the server is at.
+      LOG(WARNING) << "The server holds " << acknowledged << " bytes of "
+          << upload_id << " rather than " << offset + length << ".";
+      offset = acknowledged;
+      if (++attempts >= kMaxResumableAttempts)
+        hr = HRESULT_FROM_WIN32(ERROR_RETRY);
+    }
+  }
+
+  file_util::CloseFile(file);
+  return hr;
+}
+
+HttpResumableUploadTransport::HttpResumableUploadTransport(
+    const std::wstring& url) : url_(url) {
+}
+
+HRESULT HttpResumableUploadTransport::QueryOffset(const std::string& upload_id,
+                                                  uint64* offset) {
+  DCHECK(offset != NULL);
+
+  std::wstring url(MakeUrl("upload_id=" + upload_id));
+  DWORD status = 0;
+  std::string response;
+  HRESULT hr = SendHttpRequest(L"GET", url.c_str(), NULL, std::string(),
+                               &status, &response);
+  if (FAILED(hr))
+    return hr;
+
+  // An upload the server doesn't know starts from scratch.
+  if (status == 404) {
+    *offset = 0;
+    return S_OK;
+  }
+
+  if (status != 200 || !ParseResumableOffset(response, offset)) {
+    LOG(ERROR) << "Bad answer to an upload offset query, status " << status;
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  return S_OK;
+}
+
+HRESULT HttpResumableUploadTransport::SendChunk(const std::string& upload_id,
+                                                uint64 offset,
+                                                const std::string& chunk,
+                                                uint32 crc,
+                                                bool last,
+                                                uint64* acknowledged) {
+  DCHECK(acknowledged != NULL);
+
+  std::wstring url(MakeUrl(base::StringPrintf(
+      "upload_id=%s&offset=%I64u&crc=%08x%s", upload_id.c_str(), offset, crc,
+      last ? "&last=1" : "")));
+  DWORD status = 0;
+  std::string response;
+  HRESULT hr = SendHttpRequest(L"POST", url.c_str(), kChunkContentType,
+                               chunk, &status, &response);
+  if (FAILED(hr))
+    return hr;
+
+  // A refused chunk is answered with the offset the server is at.
+  if ((status < 200 || status >= 300) && status != 400 && status != 409) {
+    LOG(ERROR) << "The server answered an upload chunk with status "
+        << status;
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  if (!ParseResumableOffset(response, acknowledged)) {
+    LOG(ERROR) << "Bad answer to an upload chunk: " << response;
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  return S_OK;
+}
+
+std::wstring HttpResumableUploadTransport::MakeUrl(
+    const std::string& parameters) const {
+  std::wstring url(url_);
+  url += url.find(L'?') == std::wstring::npos ? L'?' : L'&';
+  url += ASCIIToWide(parameters);
+  return url;
+}
+
+bool ParseResumableOffset(const std::string& response, uint64* offset) {
+  DCHECK(offset != NULL);
+
+  // The offset is on the first line, anything after is for humans.
+  std::string line(response.substr(0, response.find('\n')));
+  TrimWhitespaceASCII(line, TRIM_ALL, &line);
+  if (line.compare(0, arraysize(kOffsetPrefix) - 1, kOffsetPrefix) != 0)
+    return false;
+
+  int64 value = 0;
+  if (!base::StringToInt64(line.substr(arraysize(kOffsetPrefix) - 1),
+                           &value) || value < 0) {
+    return false;
+  }
+
+  *offset = static_cast<uint64>(value);
+  return true;
+}
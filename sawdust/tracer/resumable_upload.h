@@ -0,0 +1,99 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Resumable uploads, which send an archive in checksummed chunks and pick
+// up from the last chunk the server acknowledged.
+
+#ifndef SAWDUST_TRACER_RESUMABLE_UPLOAD_H_
+#define SAWDUST_TRACER_RESUMABLE_UPLOAD_H_
+
+#include <windows.h>
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/file_path.h"
+
+// The server end of a resumable upload. The server keeps the bytes of each
+// upload it acknowledged, keyed by the upload's id. The protocol over HTTP
+// is implemented by HttpResumableUploadTransport, and served by
+// test_server/crash_eater.py.
+class IResumableUploadTransport {
+ public:
+  virtual ~IResumableUploadTransport() {}
+
+  // Asks the server for the number of bytes it holds of |upload_id|, which is
+  // zero for an upload it doesn't know.
+  virtual HRESULT QueryOffset(const std::string& upload_id,
+                              uint64* offset) = 0;
+
+  // Sends |chunk|, the bytes of |upload_id| at |offset|, along with their
+  // CRC-32 |crc|. |last| marks the end of the upload, on which the server
+  // takes it in. On success, |acknowledged| is the number of bytes the server
+  // now holds, which falls short of the end of |chunk| if the server refused
+  // it, say for a bad checksum or an offset it doesn't hold.
+  virtual HRESULT SendChunk(const std::string& upload_id,
+                            uint64 offset,
+                            const std::string& chunk,
+                            uint32 crc,
+                            bool last,
+                            uint64* acknowledged) = 0;
+};
+
+// The number of chunks in a row that may fail before an upload gives up.
+const int kMaxResumableAttempts = 3;
+
+// Sends the file at |path| as upload |upload_id| over |transport|, in chunks
+// of |chunk_size|, starting from wherever the server is at. Should a chunk
+// fail, the upload goes on from wherever the server is then at, until it
+// gives up. A later call then resumes where this one left off.
+// |abort_flag| may be NULL, or point to a flag that abandons the upload as
+// it is set.
+HRESULT UploadResumably(const FilePath& path,
+                        const std::string& upload_id,
+                        size_t chunk_size,
+                        IResumableUploadTransport* transport,
+                        const bool* abort_flag);
+
+// Speaks the resumable protocol to the crash server at a URL. The upload id
+// and offset go in query parameters added to the URL: a GET with
+// "upload_id" queries the offset, a POST with "upload_id", "offset", "crc"
+// and, for the last chunk, "last=1" sends a chunk as its body. Either is
+// answered with a body of "offset=<bytes held>".
+class HttpResumableUploadTransport : public IResumableUploadTransport {
+ public:
+  explicit HttpResumableUploadTransport(const std::wstring& url);
+
+  // IResumableUploadTransport implementation.
+  virtual HRESULT QueryOffset(const std::string& upload_id, uint64* offset);
+  virtual HRESULT SendChunk(const std::string& upload_id,
+                            uint64 offset,
+                            const std::string& chunk,
+                            uint32 crc,
+                            bool last,
+                            uint64* acknowledged);
+
+ private:
+  // Returns the URL with |parameters| added to its query.
+  std::wstring MakeUrl(const std::string& parameters) const;
+
+  std::wstring url_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpResumableUploadTransport);
+};
+
+// Parses the server's answer to a resumable upload request into |offset|.
+bool ParseResumableOffset(const std::string& response, uint64* offset);
+
+#endif  // SAWDUST_TRACER_RESUMABLE_UPLOAD_H_
@@ -0,0 +1,190 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Resumable uploads unittests.
+
+#include "sawdust/tracer/resumable_upload.h"
+
+#include <string>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/scoped_temp_dir.h"
+#include "gtest/gtest.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+const char kUploadId[] = "some-upload";
+const size_t kChunkSize = 1000;
+
+// A server which holds the upload in a string, and can be made to refuse
+// or drop chunks.
+class FakeTransport : public IResumableUploadTransport {
+ public:
+  FakeTransport()
+      : chunk_count_(0), fail_chunk_(-1), corrupt_chunk_(-1),
+        keep_failed_chunk_(false), completed_(false) {
+  }
+
+  virtual HRESULT QueryOffset(const std::string& upload_id, uint64* offset) {
+    EXPECT_EQ(kUploadId, upload_id);
+    *offset = held_.size();
+    return S_OK;
+  }
+
+  virtual HRESULT SendChunk(const std::string& upload_id,
+                            uint64 offset,
+                            const std::string& chunk,
+                            uint32 crc,
+                            bool last,
+                            uint64* acknowledged) {
+    EXPECT_EQ(kUploadId, upload_id);
+    int chunk_number = chunk_count_++;
+
+    uint32 expected_crc = crc32(0L, Z_NULL, 0);
+    expected_crc = crc32(expected_crc,
+                         reinterpret_cast<const Bytef*>(chunk.data()),
+                         static_cast<uInt>(chunk.size()));
+    if (chunk_number == corrupt_chunk_)
+      ++expected_crc;
+
+    bool take = offset == held_.size() && crc == expected_crc;
+    if (chunk_number == fail_chunk_) {
+      // The connection dropped, after the server got the chunk or not.
+      if (take && keep_failed_chunk_)
+        held_.append(chunk);
+      return E_FAIL;
+    }
+
+    if (take) {
+      held_.append(chunk);
+      completed_ = last;
+    }
+    *acknowledged = held_.size();
+    return S_OK;
+  }
+
+  const std::string& held() const { return held_; }
+  bool completed() const { return completed_; }
+  int chunk_count() const { return chunk_count_; }
+
+  void set_held(const std::string& held) { held_ = held; }
+  void set_fail_chunk(int chunk, bool keep) {
+    fail_chunk_ = chunk;
+    keep_failed_chunk_ = keep;
+  }
+  void set_corrupt_chunk(int chunk) { corrupt_chunk_ = chunk; }
+
+ private:
+  std::string held_;
+  int chunk_count_;
+  int fail_chunk_;
+  int corrupt_chunk_;
+  bool keep_failed_chunk_;
+  bool completed_;
+};
+
+class ResumableUploadTest : public testing::Test {
+ public:
+  void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("archive.zip");
+    for (int i = 0; i < 3500; ++i)
+      content_.push_back(static_cast<char>(i * 7919 % 251));
+    ASSERT_EQ(static_cast<int>(content_.size()),
+              file_util::WriteFile(path_, content_.data(), content_.size()));
+  }
+
+ protected:
+  ScopedTempDir temp_dir_;
+  FilePath path_;
+  std::string content_;
+  FakeTransport transport_;
+};
+
+}  // namespace
+
+TEST_F(ResumableUploadTest, UploadsInChunks) {
+  ASSERT_HRESULT_SUCCEEDED(
+      UploadResumably(path_, kUploadId, kChunkSize, &transport_, NULL));
+  EXPECT_EQ(content_, transport_.held());
+  EXPECT_TRUE(transport_.completed());
+  EXPECT_EQ(4, transport_.chunk_count());
+}
+
+TEST_F(ResumableUploadTest, ResumesWhereTheServerIsAt) {
+  transport_.set_held(content_.substr(0, 2000));
+  ASSERT_HRESULT_SUCCEEDED(
+      UploadResumably(path_, kUploadId, kChunkSize, &transport_, NULL));
+  EXPECT_EQ(content_, transport_.held());
+  EXPECT_TRUE(transport_.completed());
+  EXPECT_EQ(2, transport_.chunk_count());
+}
+
+TEST_F(ResumableUploadTest, CompletesAFullyHeldUpload) {
+  transport_.set_held(content_);
+  ASSERT_HRESULT_SUCCEEDED(
+      UploadResumably(path_, kUploadId, kChunkSize, &transport_, NULL));
+  EXPECT_EQ(content_, transport_.held());
+  EXPECT_TRUE(transport_.completed());
+  EXPECT_EQ(1, transport_.chunk_count());
+}
+
+TEST_F(ResumableUploadTest, ResendsRefusedChunks) {
+  transport_.set_corrupt_chunk(1);
+  ASSERT_HRESULT_SUCCEEDED(
+      UploadResumably(path_, kUploadId, kChunkSize, &transport_, NULL));
+  EXPECT_EQ(content_, transport_.held());
+  EXPECT_EQ(5, transport_.chunk_count());
+}
+
+TEST_F(ResumableUploadTest, RecoversFromDroppedChunks) {
+  // The server got the chunk, but its answer was lost.
+  transport_.set_fail_chunk(1, true);
+  ASSERT_HRESULT_SUCCEEDED(
+      UploadResumably(path_, kUploadId, kChunkSize, &transport_, NULL));
+  EXPECT_EQ(content_, transport_.held());
+  EXPECT_EQ(4, transport_.chunk_count());
+}
+
+TEST_F(ResumableUploadTest, RecoversFromLostChunks) {
+  // The chunk never made it to the server.
+  transport_.set_fail_chunk(2, false);
+  ASSERT_HRESULT_SUCCEEDED(
+      UploadResumably(path_, kUploadId, kChunkSize, &transport_, NULL));
+  EXPECT_EQ(content_, transport_.held());
+  EXPECT_EQ(5, transport_.chunk_count());
+}
+
+TEST_F(ResumableUploadTest, Aborts) {
+  bool abort = true;
+  EXPECT_EQ(E_ABORT,
+            UploadResumably(path_, kUploadId, kChunkSize, &transport_,
+                            &abort));
+  EXPECT_EQ(0, transport_.chunk_count());
+}
+
+TEST(ParseResumableOffsetTest, Parses) {
+  uint64 offset = 0;
+  EXPECT_TRUE(ParseResumableOffset("offset=1234", &offset));
+  EXPECT_EQ(1234u, offset);
+  EXPECT_TRUE(ParseResumableOffset(" offset=0 \r\nChunk refused.", &offset));
+  EXPECT_EQ(0u, offset);
+
+  EXPECT_FALSE(ParseResumableOffset("", &offset));
+  EXPECT_FALSE(ParseResumableOffset("offset=", &offset));
+  EXPECT_FALSE(ParseResumableOffset("offset=-1", &offset));
+  EXPECT_FALSE(ParseResumableOffset("size=12", &offset));
+}
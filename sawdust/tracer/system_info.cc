@@ -16,12 +16,19 @@
 #include "sawdust/tracer/system_info.h"
 
 #include <string>
+#include <vector>
 #include "base/logging.h"
+#include "base/message_loop.h"
+#include "base/scoped_ptr.h"
 #include "base/string_util.h"
 #include "base/stringprintf.h"
 #include "base/sys_info.h"
+#include "base/task.h"
 #include "base/utf_string_conversions.h"
 
+// The cache outlives its own thread, which is stopped in the destructor.
+DISABLE_RUNNABLE_METHOD_REFCOUNT(SystemInfoCache);
+
 const char SystemInfoExtractor::kHeaderMem[] = "Physical memory";
 const char SystemInfoExtractor::kHeaderSysName[] = "Operating system";
 const char SystemInfoExtractor::kHeaderSysInfo[] = "Native system info";
@@ -30,6 +37,15 @@ const char SystemInfoExtractor::kHeaderPageSize[] = "Page size";
 const char SystemInfoExtractor::kHeaderProcs[] = "Number of processors";
 const char SystemInfoExtractor::kHeaderProcRev[] = "Processor revision";
 const char SystemInfoExtractor::kHeaderProcMask[] = "Active processor mask";
+const char SystemInfoExtractor::kHeaderMemAvail[] = "Available physical memory";
+const char SystemInfoExtractor::kHeaderMemLoad[] = "Memory load";
+const char SystemInfoExtractor::kHeaderCommit[] = "Commit limit";
+const char SystemInfoExtractor::kHeaderCommitAvail[] = "Available commit";
+const char SystemInfoExtractor::kHeaderTopology[] = "Processor topology";
+const char SystemInfoExtractor::kHeaderPackages[] = "Processor packages";
+const char SystemInfoExtractor::kHeaderCores[] = "Processor cores";
+const char SystemInfoExtractor::kHeaderLogical[] = "Logical processors";
+const char SystemInfoExtractor::kHeaderNumaNodes[] = "NUMA nodes";
 
 // Formats data into a string and stuff it into the out string. All done on
 // char-specialized data.
@@ -37,28 +53,130 @@ void SystemInfoExtractor::Initialize(bool include_env_variables) {
   std::string out_data_string;
   out_data_string.reserve(2048);
 
-  base::StringAppendF(&out_data_string, "%s:\t%I64u\n", kHeaderMem,
-                      base::SysInfo::AmountOfPhysicalMemory());
+  AppendMemoryStatus(&out_data_string);
+  CollectSnapshot(include_env_variables, &out_data_string);
+
+  data_as_stream_.str(out_data_string);
+}
+
+void SystemInfoExtractor::InitializeFromSnapshot(const std::string& snapshot) {
+  std::string out_data_string;
+  out_data_string.reserve(snapshot.size() + 256);
+
+  AppendMemoryStatus(&out_data_string);
+  out_data_string.append(snapshot);
+
+  data_as_stream_.str(out_data_string);
+}
 
-  base::StringAppendF(&out_data_string, "%s:\t%s version %s\n", kHeaderSysName,
+void SystemInfoExtractor::CollectSnapshot(bool include_env_variables,
+                                          std::string* out_string) {
+  DCHECK(out_string != NULL);
+  base::StringAppendF(out_string, "%s:\t%s version %s\n", kHeaderSysName,
                       base::SysInfo::OperatingSystemName().c_str(),
                       base::SysInfo::OperatingSystemVersion().c_str());
 
-  base::StringAppendF(&out_data_string, "\n\n%s:\n", kHeaderSysInfo);
+  base::StringAppendF(out_string, "\n\n%s:\n", kHeaderSysInfo);
   SYSTEM_INFO sys_info;
   ::GetNativeSystemInfo(&sys_info);
-  FromSystemInfo(sys_info, &out_data_string);
+  FromSystemInfo(sys_info, out_string);
 
-  base::StringAppendF(&out_data_string, "\n\n%s:\n", kHeaderSysInfo2);
+  base::StringAppendF(out_string, "\n\n%s:\n", kHeaderSysInfo2);
   ::GetSystemInfo(&sys_info);
-  FromSystemInfo(sys_info, &out_data_string);
+  FromSystemInfo(sys_info, out_string);
+
+  base::StringAppendF(out_string, "\n\n%s:\n", kHeaderTopology);
+  AppendProcessorTopology(out_string);
 
   if (include_env_variables) {
-    out_data_string.append(2, '\n');
-    AppendEnvironmentStrings(&out_data_string);
+    out_string->append(2, '\n');
+    AppendEnvironmentStrings(out_string);
   }
+}
 
-  data_as_stream_.str(out_data_string);
+void SystemInfoExtractor::AppendMemoryStatus(std::string* out_string) {
+  base::StringAppendF(out_string, "%s:\t%I64u\n", kHeaderMem,
+                      base::SysInfo::AmountOfPhysicalMemory());
+
+  MEMORYSTATUSEX memory_status = {};
+  memory_status.dwLength = sizeof(memory_status);
+  if (!::GlobalMemoryStatusEx(&memory_status)) {
+    LOG(WARNING) << "GlobalMemoryStatusEx failed. Error " << ::GetLastError();
+    return;
+  }
+
+  base::StringAppendF(out_string, "%s:\t%I64u\n", kHeaderMemAvail,
+                      memory_status.ullAvailPhys);
+  base::StringAppendF(out_string, "%s:\t%u%%\n", kHeaderMemLoad,
+                      memory_status.dwMemoryLoad);
+  base::StringAppendF(out_string, "%s:\t%I64u\n", kHeaderCommit,
+                      memory_status.ullTotalPageFile);
+  base::StringAppendF(out_string, "%s:\t%I64u\n", kHeaderCommitAvail,
+                      memory_status.ullAvailPageFile);
+}
+
+void SystemInfoExtractor::AppendProcessorTopology(std::string* out_string) {
+  DWORD buffer_size = 0;
+  if (::GetLogicalProcessorInformation(NULL, &buffer_size) ||
+      ::GetLastError() != ERROR_INSUFFICIENT_BUFFER || buffer_size == 0) {
+    out_string->append("Not available\n");
+    return;
+  }
+
+  size_t entry_count =
+      buffer_size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
+  scoped_array<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> entries(
+      new SYSTEM_LOGICAL_PROCESSOR_INFORMATION[entry_count]);
+  if (!::GetLogicalProcessorInformation(entries.get(), &buffer_size)) {
+    LOG(WARNING) << "GetLogicalProcessorInformation failed. Error " <<
+        ::GetLastError();
+    out_string->append("Not available\n");
+    return;
+  }
+  entry_count = buffer_size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
+
+  int packages = 0;
+  int cores = 0;
+  int logical_processors = 0;
+  int numa_nodes = 0;
+  // Cache size per level (1 to 3), summed over all caches of the level.
+  const int kMaxCacheLevel = 3;
+  std::vector<DWORD> cache_sizes(kMaxCacheLevel + 1, 0);
+  for (size_t i = 0; i < entry_count; ++i) {
+    const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& entry = entries[i];
+    switch (entry.Relationship) {
+      case RelationProcessorPackage:
+        ++packages;
+        break;
+      case RelationProcessorCore:
+        ++cores;
+        // Each set bit of the mask is a logical processor on this core.
+        for (ULONG_PTR mask = entry.ProcessorMask; mask != 0; mask >>= 1)
+          logical_processors += static_cast<int>(mask & 1);
+        break;
+      case RelationNumaNode:
+        ++numa_nodes;
+        break;
+      case RelationCache:
+        if (entry.Cache.Level >= 1 && entry.Cache.Level <= kMaxCacheLevel)
+          cache_sizes[entry.Cache.Level] += entry.Cache.Size;
+        break;
+      default:
+        break;
+    }
+  }
+
+  base::StringAppendF(out_string, "%s:\t%d\n", kHeaderPackages, packages);
+  base::StringAppendF(out_string, "%s:\t%d\n", kHeaderCores, cores);
+  base::StringAppendF(out_string, "%s:\t%d\n", kHeaderLogical,
+                      logical_processors);
+  base::StringAppendF(out_string, "%s:\t%d\n", kHeaderNumaNodes, numa_nodes);
+  for (int level = 1; level <= kMaxCacheLevel; ++level) {
+    if (cache_sizes[level] != 0) {
+      base::StringAppendF(out_string, "L%d cache:\t%u\n", level,
+                          cache_sizes[level]);
+    }
+  }
 }
 
 void SystemInfoExtractor::FromSystemInfo(const SYSTEM_INFO& data,
@@ -117,3 +235,48 @@ void SystemInfoExtractor::AppendEnvironmentStrings(std::string* out_string) {
     ::FreeEnvironmentStrings(env_strings);
   }
 }
+
+SystemInfoCache::SystemInfoCache()
+    : thread_("SystemInfoCache"), collected_(true, false) {
+}
+
+SystemInfoCache::~SystemInfoCache() {
+  thread_.Stop();
+}
+
+void SystemInfoCache::Refresh(bool include_env_variables) {
+  if (!thread_.IsRunning() && !thread_.Start()) {
+    NOTREACHED() << "Failed to start the system info thread.";
+    return;
+  }
+
+  thread_.message_loop()->PostTask(FROM_HERE,
+      NewRunnableMethod(this, &SystemInfoCache::Collect,
+                        include_env_variables));
+}
+
+bool SystemInfoCache::GetSnapshot(std::string* snapshot) {
+  DCHECK(snapshot != NULL);
+  if (!thread_.IsRunning())
+    return false;
+
+  collected_.Wait();
+  base::AutoLock lock(lock_);
+  *snapshot = snapshot_;
+  return true;
+}
+
+// Runs on thread_. Collection happens outside of the lock, so readers only
+// ever wait for the swap.
+void SystemInfoCache::Collect(bool include_env_variables) {
+  std::string snapshot;
+  snapshot.reserve(4096);
+  SystemInfoExtractor extractor;
+  extractor.CollectSnapshot(include_env_variables, &snapshot);
+
+  {
+    base::AutoLock lock(lock_);
+    snapshot_.swap(snapshot);
+  }
+  collected_.Signal();
+}
@@ -19,11 +19,15 @@
 #include <sstream>
 #include <string>
 
+#include "base/synchronization/lock.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
 #include "sawdust/tracer/upload.h"
 
 // Extracts some basic information on the current system: operating system name
 // and version, processor type (and other things provided by GetSystemInfo),
-// list of environment variables. All that packaged as a stream.
+// processor topology, memory status, list of environment variables. All that
+// packaged as a stream.
 class SystemInfoExtractor : public IReportContentEntry {
  public:
   SystemInfoExtractor() { }
@@ -33,6 +37,14 @@ class SystemInfoExtractor : public IReportContentEntry {
   // Appending env-vars is optional (|include_env_variables|).
   virtual void Initialize(bool include_env_variables);
 
+  // Initializes the object from |snapshot|, as made by CollectSnapshot. Only
+  // the memory status, which changes all the time, is taken anew.
+  void InitializeFromSnapshot(const std::string& snapshot);
+
+  // Appends to |out_string| all the information that stays put while the
+  // system runs, that is all but the memory status.
+  void CollectSnapshot(bool include_env_variables, std::string* out_string);
+
   std::istream& Data() { return data_as_stream_; }
   void MarkCompleted() { data_as_stream_.seekg(0); }
 
@@ -42,10 +54,8 @@ class SystemInfoExtractor : public IReportContentEntry {
   // formats this nicely into a \n separated list of values in |out_string|.
   static void ListEnvironmentStrings(const wchar_t* string_table,
                                      std::string* out_string);
- protected:
-  // Real datatype under data(). Added as a test seam.
-  typedef std::istringstream StreamType;
 
+  // Headers of the report lines.
   static const char kHeaderMem[];
   static const char kHeaderSysName[];
   static const char kHeaderSysInfo[];
@@ -54,10 +64,30 @@ class SystemInfoExtractor : public IReportContentEntry {
   static const char kHeaderProcs[];
   static const char kHeaderProcRev[];
   static const char kHeaderProcMask[];
+  static const char kHeaderMemAvail[];
+  static const char kHeaderMemLoad[];
+  static const char kHeaderCommit[];
+  static const char kHeaderCommitAvail[];
+  static const char kHeaderTopology[];
+  static const char kHeaderPackages[];
+  static const char kHeaderCores[];
+  static const char kHeaderLogical[];
+  static const char kHeaderNumaNodes[];
+
+ protected:
+  // Real datatype under data(). Added as a test seam.
+  typedef std::istringstream StreamType;
 
   // Format nicely the content of |data|.
   static void FromSystemInfo(const SYSTEM_INFO& data, std::string* out_string);
 
+  // Append the current memory status to |out_string|.
+  static void AppendMemoryStatus(std::string* out_string);
+
+  // Append the packages, cores, logical processors, NUMA nodes and caches
+  // to |out_string|.
+  static void AppendProcessorTopology(std::string* out_string);
+
  private:
   // Exposed to create a test seam.
   virtual void AppendEnvironmentStrings(std::string* out_string);
@@ -66,4 +96,33 @@ class SystemInfoExtractor : public IReportContentEntry {
   DISALLOW_COPY_AND_ASSIGN(SystemInfoExtractor);
 };
 
+// Keeps a snapshot of the system information ready for reports, so that
+// they don't wait on collecting it. The snapshot is collected on a thread
+// of its own, first at startup and then again when the system tells of a
+// change in its settings.
+class SystemInfoCache {
+ public:
+  SystemInfoCache();
+  ~SystemInfoCache();
+
+  // Collects the snapshot anew, with the environment if
+  // |include_env_variables|, in the background.
+  void Refresh(bool include_env_variables);
+
+  // Copies the latest snapshot into |snapshot|, waiting for the first one
+  // to be collected. Returns false if none is on the way.
+  bool GetSnapshot(std::string* snapshot);
+
+ private:
+  void Collect(bool include_env_variables);
+
+  base::Thread thread_;
+  // Signalled once the first snapshot is in.
+  base::WaitableEvent collected_;
+  base::Lock lock_;  // Guards snapshot_.
+  std::string snapshot_;
+
+  DISALLOW_COPY_AND_ASSIGN(SystemInfoCache);
+};
+
 #endif  // SAWDUST_TRACER_SYSTEM_INFO_H_
@@ -62,6 +62,9 @@ class TestingSystemInfoExtractor : public SystemInfoExtractor {
       headers_.push_back(kHeaderProcs);
       headers_.push_back(kHeaderProcRev);
       headers_.push_back(kHeaderProcMask);
+      headers_.push_back(kHeaderMemLoad);
+      headers_.push_back(kHeaderTopology);
+      headers_.push_back(kHeaderCores);
     }
     return headers_;
   }
@@ -148,4 +151,46 @@ TEST(SystemInfoExtractorTest, FullInitializationTest) {
   }
 }
 
+// The snapshot leaves the memory status out; initializing from it puts the
+// memory status back in.
+TEST(SystemInfoExtractorTest, InitializeFromSnapshot) {
+  TestingSystemInfoExtractor test_instance;
+  std::string snapshot;
+  test_instance.CollectSnapshot(true, &snapshot);
+  ASSERT_EQ(std::string::npos,
+            snapshot.find(SystemInfoExtractor::kHeaderMemLoad));
+  ASSERT_NE(std::string::npos, snapshot.find(kTestDataForEnvVars));
+
+  test_instance.InitializeFromSnapshot(snapshot);
+  std::string formatted_data;
+  test_instance.GetData(&formatted_data);
+  const std::list<std::string>& headers = test_instance.ListHeaders();
+  for (std::list<std::string>::const_iterator word_it = headers.begin();
+       word_it != headers.end(); ++word_it) {
+    ASSERT_NE(std::string::npos, formatted_data.find(*word_it));
+  }
+  ASSERT_NE(std::string::npos, formatted_data.find(snapshot));
+}
+
+TEST(SystemInfoCacheTest, SnapshotAfterRefresh) {
+  SystemInfoCache cache;
+  std::string snapshot;
+  ASSERT_FALSE(cache.GetSnapshot(&snapshot));
+
+  cache.Refresh(false);
+  ASSERT_TRUE(cache.GetSnapshot(&snapshot));
+  ASSERT_NE(std::string::npos,
+            snapshot.find(SystemInfoExtractor::kHeaderSysName));
+  ASSERT_NE(std::string::npos,
+            snapshot.find(SystemInfoExtractor::kHeaderTopology));
+  ASSERT_EQ(std::string::npos,
+            snapshot.find(SystemInfoExtractor::kHeaderMemLoad));
+
+  // A second refresh serves the old snapshot until the new one is in.
+  cache.Refresh(false);
+  std::string next_snapshot;
+  ASSERT_TRUE(cache.GetSnapshot(&next_snapshot));
+  ASSERT_FALSE(next_snapshot.empty());
+}
+
 }  // namespace
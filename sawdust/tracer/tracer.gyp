@@ -27,36 +27,81 @@
       'target_name': 'tracer_lib',
       'type': 'static_library',
       'sources': [
+        'background_mode.h',
+        'background_mode.cc',
+        'bandwidth_throttle.h',
+        'bandwidth_throttle.cc',
+        'chunk_dedup.h',
+        'chunk_dedup.cc',
+        'chunked_upload.h',
+        'chunked_upload.cc',
         'com_utils.h',
         'com_utils.cc',
         'configuration.h',
         'configuration.cc',
         'controller.h',
         'controller.cc',
+        'log_summarizer.h',
+        'log_summarizer.cc',
+        'log_trimmer.h',
+        'log_trimmer.cc',
+        'log_watcher.h',
+        'log_watcher.cc',
+        'mapped_file_reader.h',
+        'mapped_file_reader.cc',
+        'parallel_deflater.h',
+        'parallel_deflater.cc',
+        'precompressed_segment.h',
+        'precompressed_segment.cc',
         'registry.h',
         'registry.cc',
+        'resumable_upload.h',
+        'resumable_upload.cc',
         'sawdust_guids.h',
         'system_info.h',
         'system_info.cc',
         'upload.h',
         'upload.cc',
+        'upload_chunk_queue.h',
+        'upload_chunk_queue.cc',
+        'zip_stream_writer.h',
+        'zip_stream_writer.cc',
       ],
       'dependencies': [
         '<(DEPTH)/base/base.gyp:base',
+        '<(DEPTH)/sawbuck/log_lib/log_lib.gyp:log_lib',
+        '<(DEPTH)/third_party/pcre/pcre.gyp:pcre_lib',
+        '<(DEPTH)/third_party/zlib/zlib.gyp:zlib',
       ],
+      'link_settings': {
+        'libraries': [
+          '-lwinhttp.lib',
+        ],
+      },
     },
     {
       'target_name': 'tracer_lib_unittests',
       'type': 'executable',
       'sources': [
+        'bandwidth_throttle_unittest.cc',
+        'chunk_dedup_unittest.cc',
         'configuration_unittest.cc',
         'controller_unittest.cc',
+        'log_summarizer_unittest.cc',
+        'log_trimmer_unittest.cc',
+        'log_watcher_unittest.cc',
+        'mapped_file_reader_unittest.cc',
+        'parallel_deflater_unittest.cc',
+        'precompressed_segment_unittest.cc',
         'registry_unittest.cc',
+        'resumable_upload_unittest.cc',
         'system_info_unittest.cc',
         'tracer_unittest_main.cc',
         'tracer_unittest_util.h',
         'tracer_unittest_util.cc',
+        'upload_chunk_queue_unittest.cc',
         'upload_unittest.cc',
+        'zip_stream_writer_unittest.cc',
         'test_data/configuration_unittest_data.json',
         'test_data/configuration_unittest_expressions.json',
         'test_data/controller_unittest_configs.json',
@@ -69,6 +114,23 @@
         '<(DEPTH)/third_party/zlib/zlib.gyp:*',
         '<(DEPTH)/build/temp_gyp/googleurl.gyp:googleurl',
       ]
-    }
+    },
+    {
+      'target_name': 'upload_benchmark',
+      'type': 'executable',
+      'sources': [
+        'upload_benchmark_main.cc',
+      ],
+      'dependencies': [
+        'tracer_lib',
+        '<(DEPTH)/base/base.gyp:base',
+        '<(DEPTH)/third_party/zlib/zlib.gyp:zlib',
+      ],
+      'link_settings': {
+        'libraries': [
+          '-lpsapi.lib',
+        ],
+      },
+    },
   ]
 }
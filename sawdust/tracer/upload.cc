@@ -20,85 +20,477 @@
 #include <msxml.h>
 #include <wininet.h>  // For win32 http error code.
 
+#include <algorithm>
+
 #include "base/file_util.h"
 #include "base/logging.h"
 #include "base/string_number_conversions.h"
-#include "third_party/zlib/contrib/minizip/zip.h"
-#include "third_party/zlib/contrib/minizip/iowin32.h"
-
+#include "base/string_util.h"
+#include "base/sys_info.h"
+#include "base/threading/simple_thread.h"
+#include "base/utf_string_conversions.h"
+#include "third_party/zlib/zlib.h"
+
+#include "sawdust/tracer/background_mode.h"
+#include "sawdust/tracer/bandwidth_throttle.h"
+#include "sawdust/tracer/chunk_dedup.h"
+#include "sawdust/tracer/chunked_upload.h"
 #include "sawdust/tracer/com_utils.h"
+#include "sawdust/tracer/mapped_file_reader.h"
+#include "sawdust/tracer/parallel_deflater.h"
+#include "sawdust/tracer/precompressed_segment.h"
+#include "sawdust/tracer/resumable_upload.h"
+#include "sawdust/tracer/upload_chunk_queue.h"
+#include "sawdust/tracer/zip_stream_writer.h"
 
 namespace {
-// This function is derived from third_party/minizip/iowin32.c.
-// Its only difference is that it treats the char* as UTF8 and
-// uses the Unicode version of CreateFile.
-// This version has been copied from chrome/common/zip.cc
-typedef struct {
-  HANDLE hf;
-  int error;
-} WIN32FILE_IOWIN;
-
 const unsigned kZipBufferSize = 8192;
 
-// A custom zip file-open function (see zipOpen2 in minizip/zip.h). Note that
-// the allocated structure is owned by the caller (minizip library, that is).
-// This a bit opaque, but: the return value is always treated as a stream handle
-// (see struct layout), but released by free in win32_close_file_func.
-void* ZipOpenFunc(void* opaque, const char* filename, int mode) {
-  HANDLE file = 0;
-  void* ret = NULL;
-  const ReportUploader* invocation_origin =
-      reinterpret_cast<const ReportUploader*>(opaque);
-  FilePath path_obj;
-  if (invocation_origin == NULL ||
-      !invocation_origin->GetArchivePath(&path_obj)) {
-    NOTREACHED() << "Failed to retrieve target file name.";
-    return NULL;
-  }
-
-  DWORD desired_access = 0;
-  DWORD creation_disposition = GENERIC_READ;
-  DWORD share_mode = 0;
-  DWORD flags_and_attributes = 0;
-
-  if ((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER) == ZLIB_FILEFUNC_MODE_READ) {
-    desired_access = GENERIC_READ;
-    creation_disposition = OPEN_EXISTING;
-    share_mode = FILE_SHARE_READ;
-  } else if (mode & ZLIB_FILEFUNC_MODE_EXISTING) {
-    desired_access = GENERIC_WRITE | GENERIC_READ;
-    creation_disposition = OPEN_EXISTING;
-  } else if (mode & ZLIB_FILEFUNC_MODE_CREATE) {
-    desired_access = GENERIC_WRITE | GENERIC_READ;
-    creation_disposition = CREATE_ALWAYS;
-  }
-
-  if ((!path_obj.empty()) && (desired_access != 0)) {
-    file = CreateFile(path_obj.value().c_str(), desired_access, share_mode,
-                      NULL, creation_disposition, flags_and_attributes, NULL);
-  }
-
-  if (file == INVALID_HANDLE_VALUE)
-    file = NULL;
-
-  if (file != NULL) {
-    WIN32FILE_IOWIN file_ret;
-    file_ret.hf = file;
-    file_ret.error = 0;
-    ret = malloc(sizeof(WIN32FILE_IOWIN));
-    if (ret == NULL)
-      CloseHandle(file);
-    else
-      *(static_cast<WIN32FILE_IOWIN*>(ret)) = file_ret;
+// Entries are compressed on up to kMaxCompressionThreads threads, in blocks
+// of kCompressionBlockSize, with kPendingBlocksPerThread blocks per thread
+// held at a time.
+const int kMaxCompressionThreads = 4;
+const size_t kCompressionBlockSize = 128 * 1024;
+const size_t kPendingBlocksPerThread = 4;
+
+// The archive goes to the server in chunks of this size, with at most
+// kMaxQueuedChunks of them waiting to be sent.
+const size_t kUploadChunkSize = 64 * 1024;
+const size_t kMaxQueuedChunks = 16;
+
+// Resumable uploads go in chunks of this size, each acknowledged by the
+// server, so it is what a failure loses at most.
+const size_t kResumableChunkSize = 1024 * 1024;
+
+const wchar_t kArchiveContentType[] = L"application/zip";
+
+// Writes the archive to a file.
+class FileSink : public IArchiveSink {
+ public:
+  FileSink() : file_(NULL) {
+  }
+
+  ~FileSink() {
+    Close();
+  }
+
+  bool Open(const FilePath& path) {
+    DCHECK(file_ == NULL);
+    file_ = file_util::OpenFile(path, "wb");
+    return file_ != NULL;
+  }
+
+  // Returns false if the file could not be written to the end.
+  bool Close() {
+    if (file_ == NULL)
+      return false;
+    bool success = file_util::CloseFile(file_);
+    file_ = NULL;
+    return success;
+  }
+
+  bool is_open() const { return file_ != NULL; }
+
+  bool Write(const char* data, size_t size) {
+    DCHECK(file_ != NULL);
+    return fwrite(data, 1, size, file_) == size;
+  }
+
+ private:
+  FILE* file_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileSink);
+};
+
+// Cuts the archive into chunks for the upload queue, teeing it into an
+// optional retry copy.
+class ChunkingSink : public IArchiveSink {
+ public:
+  // |retry_copy| may be NULL for none.
+  ChunkingSink(UploadChunkQueue* queue, FileSink* retry_copy)
+      : queue_(queue), retry_copy_(retry_copy), retry_copy_failed_(false) {
+    DCHECK(queue_ != NULL);
+    chunk_.reserve(kUploadChunkSize);
+  }
+
+  bool Write(const char* data, size_t size) {
+    // The copy is a convenience, the upload goes on without it.
+    if (retry_copy_ != NULL && !retry_copy_failed_ &&
+        !retry_copy_->Write(data, size)) {
+      LOG(WARNING) << "Failed to write the retry copy of the archive.";
+      retry_copy_failed_ = true;
+    }
+
+    chunk_.append(data, size);
+    if (chunk_.size() < kUploadChunkSize)
+      return true;
+
+    return PushChunk();
+  }
+
+  // Pushes the last partial chunk.
+  bool Flush() {
+    return chunk_.empty() || PushChunk();
+  }
+
+  bool retry_copy_failed() const { return retry_copy_failed_; }
+
+ private:
+  bool PushChunk() {
+    if (!queue_->Push(&chunk_))
+      return false;
+    chunk_.clear();
+    chunk_.reserve(kUploadChunkSize);
+    return true;
+  }
+
+  UploadChunkQueue* queue_;
+  FileSink* retry_copy_;
+  bool retry_copy_failed_;
+  std::string chunk_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChunkingSink);
+};
+
+// Throttles the chunks of a resumable upload as they go.
+class ThrottledTransport : public IResumableUploadTransport {
+ public:
+  // |throttle| may be NULL for none. |abort_flag| abandons a send waiting
+  // for the throttle as it is set.
+  ThrottledTransport(IResumableUploadTransport* transport,
+                     BandwidthThrottle* throttle,
+                     const bool* abort_flag)
+      : transport_(transport), throttle_(throttle), abort_flag_(abort_flag) {
+    DCHECK(transport_ != NULL);
+  }
+
+  virtual HRESULT QueryOffset(const std::string& upload_id, uint64* offset) {
+    return transport_->QueryOffset(upload_id, offset);
+  }
+
+  virtual HRESULT SendChunk(const std::string& upload_id,
+                            uint64 offset,
+                            const std::string& chunk,
+                            uint32 crc,
+                            bool last,
+                            uint64* acknowledged) {
+    if (throttle_ != NULL && !throttle_->Consume(chunk.size(), abort_flag_))
+      return E_ABORT;
+    return transport_->SendChunk(upload_id, offset, chunk, crc, last,
+                                 acknowledged);
   }
-  return ret;
+
+ private:
+  IResumableUploadTransport* transport_;
+  BandwidthThrottle* throttle_;
+  const bool* abort_flag_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThrottledTransport);
+};
+
+// Makes an id for a resumable upload that no other upload will have.
+bool MakeUploadId(std::string* upload_id) {
+  GUID guid = {};
+  if (FAILED(::CoCreateGuid(&guid)))
+    return false;
+
+  wchar_t guid_string[40] = {};
+  if (::StringFromGUID2(guid, guid_string, arraysize(guid_string)) == 0)
+    return false;
+
+  // Strip the braces, the server only takes alphanumerics and dashes.
+  std::wstring id(guid_string);
+  *upload_id = WideToASCII(id.substr(1, id.size() - 2));
+  return true;
 }
+
+// Takes the data of an entry as ReadEntryData or ReadSegmentData reads it.
+class IEntryDataVisitor {
+ public:
+  virtual ~IEntryDataVisitor() {}
+
+  // Takes the next |size| bytes of |data|. A failure stops the read.
+  virtual HRESULT Visit(const char* data, size_t size) = 0;
+};
+
+// Reads the data of |entry| into |visitor|, block by block, or through its
+// stream for entries not served in blocks. Gives up with E_ABORT as
+// |abort_flag| is set.
+HRESULT ReadEntryData(IReportContentEntry* entry,
+                      const bool* abort_flag,
+                      IEntryDataVisitor* visitor) {
+  const char* block = NULL;
+  size_t block_size = 0;
+  HRESULT hr = S_OK;
+  while ((hr = entry->NextBlock(&block, &block_size)) == S_OK) {
+    if (*abort_flag)
+      return E_ABORT;
+    hr = visitor->Visit(block, block_size);
+    if (FAILED(hr))
+      return hr;
+  }
+
+  if (hr == S_FALSE)
+    return S_OK;
+  if (hr != E_NOTIMPL) {
+    LOG(ERROR) << "Reading from source " << entry->Title() << " failed. " <<
+        com::LogHr(hr);
+    return hr;
+  }
+
+  std::istream& data = entry->Data();
+  char buffer[kZipBufferSize];
+  do {
+    std::streamsize bytes_read = data.read(buffer, sizeof(buffer)).gcount();
+    if (data.bad()) {
+      LOG(ERROR) << "Reading from source stream " << entry->Title()
+          << " failed.";
+      return E_FAIL;
+    }
+    if (*abort_flag)
+      return E_ABORT;
+    hr = visitor->Visit(buffer, static_cast<size_t>(bytes_read));
+    if (FAILED(hr))
+      return hr;
+  } while (!data.eof());
+
+  return S_OK;
 }
 
+// Reads the deflated data of |segment| into |visitor|, one mapped view at a
+// time. Gives up with E_ABORT as |abort_flag| is set.
+HRESULT ReadSegmentData(const PrecompressedSegment& segment,
+                        const bool* abort_flag,
+                        IEntryDataVisitor* visitor) {
+  MappedFileReader reader;
+  HRESULT hr = reader.Open(segment.path);
+  if (FAILED(hr)) {
+    LOG(ERROR) << "Unable to map " << segment.path.value() << ". " <<
+        com::LogHr(hr);
+    return hr;
+  }
+
+  const char* view = NULL;
+  size_t view_size = 0;
+  while ((hr = reader.NextView(&view, &view_size)) == S_OK) {
+    if (*abort_flag)
+      return E_ABORT;
+    hr = visitor->Visit(view, view_size);
+    if (FAILED(hr))
+      return hr;
+  }
+
+  if (FAILED(hr)) {
+    LOG(ERROR) << "Reading from " << segment.path.value() << " failed. " <<
+        com::LogHr(hr);
+    return hr;
+  }
+  return S_OK;
+}
+
+// Compresses the data of an entry into the archive.
+class DeflatingVisitor : public IEntryDataVisitor {
+ public:
+  DeflatingVisitor(ParallelDeflater* deflater, const char* title)
+      : deflater_(deflater), title_(title) {
+    DCHECK(deflater_ != NULL);
+  }
+
+  virtual HRESULT Visit(const char* data, size_t size) {
+    if (!deflater_->WriteEntryData(data, size)) {
+      LOG(ERROR) << "Could not write data to zip for path " << title_;
+      return E_FAIL;
+    }
+    return S_OK;
+  }
+
+ private:
+  ParallelDeflater* deflater_;
+  const char* title_;
+
+  DISALLOW_COPY_AND_ASSIGN(DeflatingVisitor);
+};
+
+// Copies the data of a precompressed entry into the archive as it is. The
+// CRC and size of the whole entry go with its first piece.
+class DeflatedDataVisitor : public IEntryDataVisitor {
+ public:
+  DeflatedDataVisitor(ParallelDeflater* deflater,
+                      const char* title,
+                      const PrecompressedSegment& segment)
+      : deflater_(deflater), title_(title), crc_(segment.crc),
+        size_(segment.size) {
+    DCHECK(deflater_ != NULL);
+  }
+
+  virtual HRESULT Visit(const char* data, size_t size) {
+    if (!deflater_->WriteDeflatedData(data, size, crc_, size_)) {
+      LOG(ERROR) << "Could not write data to zip for path " << title_;
+      return E_FAIL;
+    }
+    crc_ = 0;
+    size_ = 0;
+    return S_OK;
+  }
+
+ private:
+  ParallelDeflater* deflater_;
+  const char* title_;
+  uint32 crc_;
+  uint32 size_;
+
+  DISALLOW_COPY_AND_ASSIGN(DeflatedDataVisitor);
+};
+
+// Feeds the data of an entry to a deduplicator.
+class DeduplicatingVisitor : public IEntryDataVisitor {
+ public:
+  explicit DeduplicatingVisitor(ChunkDeduplicator* deduplicator)
+      : deduplicator_(deduplicator) {
+    DCHECK(deduplicator_ != NULL);
+  }
+
+  virtual HRESULT Visit(const char* data, size_t size) {
+    return deduplicator_->WriteEntryData(data, size);
+  }
+
+ private:
+  ChunkDeduplicator* deduplicator_;
+
+  DISALLOW_COPY_AND_ASSIGN(DeduplicatingVisitor);
+};
+
+// Inflates the data of a precompressed entry into another visitor, and
+// checks it against the CRC and size of its segment.
+class InflatingVisitor : public IEntryDataVisitor {
+ public:
+  InflatingVisitor(IEntryDataVisitor* output,
+                   const PrecompressedSegment& segment)
+      : output_(output), expected_crc_(segment.crc),
+        expected_size_(segment.size), crc_(crc32(0, Z_NULL, 0)), size_(0),
+        finished_(false) {
+    DCHECK(output_ != NULL);
+    ::memset(&stream_, 0, sizeof(stream_));
+    initialized_ = inflateInit2(&stream_, -MAX_WBITS) == Z_OK;
+  }
+
+  ~InflatingVisitor() {
+    if (initialized_)
+      inflateEnd(&stream_);
+  }
+
+  virtual HRESULT Visit(const char* data, size_t size) {
+    if (!initialized_)
+      return E_FAIL;
+
+    stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream_.avail_in = static_cast<uInt>(size);
+    // The inflated data may not fit one buffer, so go on while it fills up.
+    while (!finished_ && (stream_.avail_in != 0 || stream_.avail_out == 0)) {
+      stream_.next_out = reinterpret_cast<Bytef*>(buffer_);
+      stream_.avail_out = sizeof(buffer_);
+      int result = inflate(&stream_, Z_NO_FLUSH);
+      if (result == Z_BUF_ERROR)
+        break;  // Wants more input.
+      if (result != Z_OK && result != Z_STREAM_END) {
+        LOG(ERROR) << "Failed to inflate precompressed data, " << result;
+        return E_FAIL;
+      }
+      finished_ = result == Z_STREAM_END;
+
+      size_t inflated = sizeof(buffer_) - stream_.avail_out;
+      crc_ = crc32(crc_, reinterpret_cast<Bytef*>(buffer_),
+                   static_cast<uInt>(inflated));
+      size_ += static_cast<uint32>(inflated);
+      HRESULT hr = output_->Visit(buffer_, inflated);
+      if (FAILED(hr))
+        return hr;
+    }
+    return S_OK;
+  }
+
+  // Returns S_OK if the data came to its end, and matches its segment.
+  HRESULT Finish() const {
+    if (!finished_ || crc_ != expected_crc_ || size_ != expected_size_) {
+      LOG(ERROR) << "Precompressed data doesn't match its segment.";
+      return E_FAIL;
+    }
+    return S_OK;
+  }
+
+ private:
+  IEntryDataVisitor* output_;
+  uint32 expected_crc_;
+  uint32 expected_size_;
+  uint32 crc_;
+  uint32 size_;
+  z_stream stream_;
+  bool initialized_;
+  bool finished_;
+  char buffer_[kZipBufferSize];
+
+  DISALLOW_COPY_AND_ASSIGN(InflatingVisitor);
+};
+}
+
+// Compresses the report content into the upload queue, on its own thread.
+class ReportUploader::CompressionWorker
+    : public base::DelegateSimpleThread::Delegate {
+ public:
+  // |retry_path| is where to copy the archive to, or empty for nowhere.
+  CompressionWorker(ReportUploader* uploader,
+                    IReportContent* content,
+                    UploadChunkQueue* queue,
+                    const FilePath& retry_path)
+      : uploader_(uploader), content_(content), queue_(queue),
+        retry_path_(retry_path), hr_(E_PENDING), retry_copy_complete_(false) {
+  }
+
+  void Run() {
+    FileSink retry_copy;
+    if (!retry_path_.empty() && !retry_copy.Open(retry_path_))
+      LOG(WARNING) << "Cannot create file " << retry_path_.value();
+
+    ChunkingSink sink(queue_, retry_copy.is_open() ? &retry_copy : NULL);
+    hr_ = uploader_->WriteArchive(content_, &sink);
+    if (SUCCEEDED(hr_) && !sink.Flush())
+      hr_ = E_ABORT;
+
+    retry_copy_complete_ = retry_copy.is_open() && retry_copy.Close() &&
+        !sink.retry_copy_failed();
+
+    // Only a complete archive may be terminated, the sender abandons others.
+    if (SUCCEEDED(hr_))
+      queue_->Close();
+    else
+      queue_->Cancel();
+  }
+
+  // Valid once the thread has been joined.
+  HRESULT hr() const { return hr_; }
+  bool retry_copy_complete() const { return retry_copy_complete_; }
+
+ private:
+  ReportUploader* uploader_;
+  IReportContent* content_;
+  UploadChunkQueue* queue_;
+  FilePath retry_path_;
+  HRESULT hr_;
+  bool retry_copy_complete_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompressionWorker);
+};
+
 ReportUploader::ReportUploader(const std::wstring& target, bool local)
     : uri_target_(target),
       remote_upload_(!local),
-      abort_(false) {
+      abort_(false),
+      keep_retry_archive_(true),
+      resumable_(false),
+      deduplicated_(false),
+      background_(false),
+      throttle_(NULL),
+      default_compression_level_(Z_DEFAULT_COMPRESSION) {
 }
 
 // The destructor will remove the temporary archive.
@@ -108,6 +500,14 @@ ReportUploader::~ReportUploader() {
 
 HRESULT ReportUploader::Upload(IReportContent* content) {
   DCHECK(content != NULL);
+  if (remote_upload_ && deduplicated_)
+    return UploadDeduplicated(content);
+
+  // A resumable upload may have to send any part of the archive again, so it
+  // can't be streamed while it's compressed.
+  if (remote_upload_ && !resumable_)
+    return StreamContent(content);
+
   if (!MakeTemporaryPath(&temp_archive_path_))
     return E_ACCESSDENIED;
 
@@ -121,6 +521,13 @@ HRESULT ReportUploader::Upload(IReportContent* content) {
     return hr;
   }
 
+  if (remote_upload_ && !MakeUploadId(&upload_id_)) {
+    LOG(ERROR) << "Failed to make an id for the upload.";
+    ClearTemporaryData();
+    temp_archive_path_.clear();
+    return E_UNEXPECTED;
+  }
+
   hr = UploadArchive();
 
   if (SUCCEEDED(hr))  // If upload failed data is retained to allow a retry.
@@ -129,21 +536,59 @@ HRESULT ReportUploader::Upload(IReportContent* content) {
   return hr;
 }
 
-HRESULT ReportUploader::ZipContent(IReportContent* content) {
-  // Create the zip file. Note we use custom file open operation.
-  zlib_filefunc_def zip_funcs;
-  fill_win32_filefunc(&zip_funcs);
-  zip_funcs.zopen_file = ZipOpenFunc;
-  zip_funcs.opaque = reinterpret_cast<void*>(this);
-
+HRESULT ReportUploader::StreamContent(IReportContent* content) {
   abort_ = false;
-  zipFile archive_handle = zipOpen2("fake name", APPEND_STATUS_CREATE,
-                                    NULL, &zip_funcs);
-  if (archive_handle == NULL) {
-    LOG(ERROR) << "couldn't create file " << temp_archive_path_.value();
-    return false;
+  server_response_.clear();
+  temp_archive_path_.clear();
+  if (keep_retry_archive_ && !MakeTemporaryPath(&temp_archive_path_)) {
+    LOG(WARNING) << "Uploading without keeping a copy for retries.";
+    temp_archive_path_.clear();
+  }
+
+  UploadChunkQueue queue(kMaxQueuedChunks);
+  CompressionWorker worker(this, content, &queue, temp_archive_path_);
+  base::DelegateSimpleThread compression_thread(&worker, "ReportCompression");
+  compression_thread.Start();
+
+  std::wstring response;
+  HRESULT hr = PostChunkedUpload(uri_target_.c_str(), kArchiveContentType,
+                                 &queue, throttle_, &response);
+  compression_thread.Join();
+  LOG_IF(INFO, !response.empty()) << "Server response: " << response;
+  server_response_.swap(response);
+
+  // A copy that isn't complete is of no use for a retry.
+  if (FAILED(worker.hr()) || !worker.retry_copy_complete()) {
+    ClearTemporaryData();
+    temp_archive_path_.clear();
   }
 
+  if (FAILED(worker.hr())) {
+    LOG(ERROR) << "Failed to create the archive. " << com::LogHr(worker.hr());
+    // The compression stops as the upload fails, report the cause.
+    if (FAILED(hr) && hr != E_ABORT && !abort_)
+      return hr;
+    return worker.hr();
+  }
+
+  if (FAILED(hr)) {
+    LOG(ERROR) << "Upload failed. " << com::LogHr(hr);
+    return hr;  // The retry copy, if any, remains for UploadArchive.
+  }
+
+  ClearTemporaryData();
+  return hr;
+}
+
+HRESULT ReportUploader::UploadDeduplicated(IReportContent* content) {
+  abort_ = false;
+  server_response_.clear();
+  temp_archive_path_.clear();
+
+  // The entries are read, and their new chunks deflated, on this thread.
+  ScopedBackgroundMode background_mode(background_);
+  HttpChunkStoreTransport transport(uri_target_);
+  ChunkDeduplicator deduplicator(&transport, throttle_, &abort_);
   IReportContentEntry* entry = NULL;
   HRESULT hr = content->GetNextEntry(&entry);
 
@@ -151,7 +596,7 @@ HRESULT ReportUploader::ZipContent(IReportContent* content) {
     if (abort_)
       hr = E_ABORT;
     else
-      hr = WriteEntryIntoZip(archive_handle, entry);
+      hr = DeduplicateEntry(&deduplicator, entry);
 
     if (SUCCEEDED(hr)) {
       entry->MarkCompleted();
@@ -159,11 +604,32 @@ HRESULT ReportUploader::ZipContent(IReportContent* content) {
     }
   }
 
+  std::wstring response;
+  if (SUCCEEDED(hr))
+    hr = deduplicator.Finish(&response);
+  if (FAILED(hr)) {
+    LOG(ERROR) << "Upload failed. " << com::LogHr(hr);
+    return hr;
+  }
+
+  LOG_IF(INFO, !response.empty()) << "Server response: " << response;
+  server_response_.swap(response);
+  return S_OK;
+}
+
+HRESULT ReportUploader::ZipContent(IReportContent* content) {
+  abort_ = false;
+  FileSink archive;
+  if (!archive.Open(temp_archive_path_)) {
+    LOG(ERROR) << "couldn't create file " << temp_archive_path_.value();
+    return E_ACCESSDENIED;
+  }
+
+  HRESULT hr = WriteArchive(content, &archive);
+
   // Regardless the result, close the archive.
-  int close_file_code = zipClose(archive_handle, NULL);
-  if (close_file_code != ZIP_OK) {
-    LOG(ERROR) << "Failed to properly close the zip archive. Code=" <<
-        close_file_code;
+  if (!archive.Close()) {
+    LOG(ERROR) << "Failed to properly close the zip archive.";
 
     if (SUCCEEDED(hr))
       hr = E_UNEXPECTED;
@@ -171,13 +637,57 @@ HRESULT ReportUploader::ZipContent(IReportContent* content) {
   return hr;
 }
 
+HRESULT ReportUploader::WriteArchive(IReportContent* content,
+                                     IArchiveSink* sink) {
+  DCHECK(content != NULL);
+  DCHECK(sink != NULL);
+
+  // The entries are read in on this thread, and compressed on the deflater's.
+  ScopedBackgroundMode background_mode(background_);
+  ZipStreamWriter writer(sink);
+  int thread_count = std::max(1, std::min(base::SysInfo::NumberOfProcessors(),
+                                          kMaxCompressionThreads));
+  ParallelDeflater deflater(&writer, thread_count, kCompressionBlockSize,
+                            thread_count * kPendingBlocksPerThread);
+  deflater.set_background(background_);
+  IReportContentEntry* entry = NULL;
+  HRESULT hr = content->GetNextEntry(&entry);
+
+  while (SUCCEEDED(hr) && entry) {
+    if (abort_)
+      hr = E_ABORT;
+    else
+      hr = WriteEntryIntoZip(&deflater, entry);
+
+    if (SUCCEEDED(hr)) {
+      entry->MarkCompleted();
+      hr = content->GetNextEntry(&entry);
+    }
+  }
+
+  if (SUCCEEDED(hr) && (!deflater.Finish() || !writer.Finish())) {
+    LOG(ERROR) << "Failed to finish the zip archive.";
+    hr = E_FAIL;
+  }
+  return hr;
+}
+
 HRESULT ReportUploader::UploadArchive() {
-  if (remote_upload_) {
+  if (remote_upload_ && resumable_) {
+    DCHECK(!upload_id_.empty());
+    HttpResumableUploadTransport http_transport(uri_target_);
+    ThrottledTransport transport(&http_transport, throttle_, &abort_);
+    HRESULT hr = UploadResumably(temp_archive_path_, upload_id_,
+                                 kResumableChunkSize, &transport, &abort_);
+    LOG_IF(ERROR, FAILED(hr)) << "Upload failed. " << com::LogHr(hr);
+    return hr;
+  } else if (remote_upload_) {
     std::wstring reponse;
     HRESULT hr = UploadToCrashServer(temp_archive_path_.value().c_str(),
                                      uri_target_.c_str(), &reponse);
     LOG_IF(ERROR, FAILED(hr)) << "Upload failed. " << com::LogHr(hr);
     LOG_IF(INFO, !reponse.empty()) << "Server response: " << reponse;
+    server_response_.swap(reponse);
     return hr;
   } else {
     // A simple file move will do.
@@ -190,6 +700,30 @@ HRESULT ReportUploader::UploadArchive() {
   }
 }
 
+void ReportUploader::set_compression_level(const std::string& extension,
+                                           int level) {
+  DCHECK(!extension.empty() && extension[0] == '.');
+  DCHECK(level >= Z_NO_COMPRESSION && level <= Z_BEST_COMPRESSION);
+  compression_levels_[StringToLowerASCII(extension)] = level;
+}
+
+void ReportUploader::set_default_compression_level(int level) {
+  DCHECK(level >= Z_NO_COMPRESSION && level <= Z_BEST_COMPRESSION);
+  default_compression_level_ = level;
+}
+
+int ReportUploader::GetCompressionLevel(const char* title) const {
+  std::string name(title);
+  size_t dot = name.rfind('.');
+  if (dot != std::string::npos) {
+    std::map<std::string, int>::const_iterator found_it =
+        compression_levels_.find(StringToLowerASCII(name.substr(dot)));
+    if (found_it != compression_levels_.end())
+      return found_it->second;
+  }
+  return default_compression_level_;
+}
+
 bool ReportUploader::GetArchivePath(FilePath* archive_path) const {
   if (!temp_archive_path_.empty() && archive_path != NULL)
     *archive_path = temp_archive_path_;
@@ -197,60 +731,73 @@ bool ReportUploader::GetArchivePath(FilePath* archive_path) const {
 }
 
 
-HRESULT ReportUploader::WriteEntryIntoZip(void* zip_vhandle,
+HRESULT ReportUploader::WriteEntryIntoZip(ParallelDeflater* deflater,
                                           IReportContentEntry* entry) {
-  // The purpose of shenanigans with the parameter type here is to avoid
-  // including a third_party header into upload.h.
-  zipFile zip_file = zip_vhandle;
-  if (ZIP_OK != zipOpenNewFileInZip(zip_file,
-                                    entry->Title(),
-                                    NULL,  // No file info.
-                                    NULL,  // No extrafield_local.
-                                    0u,    // Size of extrafield_local (none).
-                                    NULL,  // No extrafield_global.
-                                    0u,    // Size of extrafield_global (none).
-                                    NULL,  // No comment.
-                                    Z_DEFLATED,  // Compression method.
-                                    Z_DEFAULT_COMPRESSION)) {  // Level.
+  PrecompressedSegment segment;
+  if (entry->GetPrecompressedSegment(&segment))
+    return WritePrecompressedEntry(deflater, entry, segment);
+
+  if (!deflater->BeginEntry(entry->Title(),
+                           GetCompressionLevel(entry->Title()))) {
     LOG(ERROR) << "Could not open zip file entry " << entry->Title();
-    return E_FAIL;
+    return abort_ ? E_ABORT : E_FAIL;
   }
 
-  HRESULT hr = S_OK;
-  // Write the content using provided stream.
-  std::istream& data = entry->Data();
+  DeflatingVisitor visitor(deflater, entry->Title());
+  HRESULT hr = ReadEntryData(entry, &abort_, &visitor);
 
-  char buffer[kZipBufferSize];
+  if (SUCCEEDED(hr) && !deflater->EndEntry()) {
+    LOG(ERROR) << "Could not close zip file entry " << entry->Title();
+    return E_FAIL;
+  }
 
-  bool keep_zipping = true;
-  do {
-    std::streamsize bytes_read = data.read(buffer, sizeof(buffer)).gcount();
+  return hr;
+}
 
-    if (data.bad()) {
-      LOG(ERROR) << "Reading from source stream " << entry->Title()
-          << " failed.";
-      hr = E_FAIL;
-      keep_zipping = false;
-    } else if (abort_) {
-      keep_zipping = false;
-      hr = E_ABORT;
-    } else {
-      if (ZIP_OK != zipWriteInFileInZip(zip_file, buffer, bytes_read)) {
-        LOG(ERROR) << "Could not write data to zip for path " << entry->Title();
-        hr = E_FAIL;
-        keep_zipping = false;
-      } else {
-        keep_zipping = !data.eof();
-      }
-    }
-  } while (keep_zipping);
+HRESULT ReportUploader::WritePrecompressedEntry(
+    ParallelDeflater* deflater,
+    IReportContentEntry* entry,
+    const PrecompressedSegment& segment) {
+  if (!deflater->BeginDeflatedEntry(entry->Title())) {
+    LOG(ERROR) << "Could not open zip file entry " << entry->Title();
+    return abort_ ? E_ABORT : E_FAIL;
+  }
 
-  if (ZIP_OK != zipCloseFileInZip(zip_file)) {
+  DeflatedDataVisitor visitor(deflater, entry->Title(), segment);
+  HRESULT hr = ReadSegmentData(segment, &abort_, &visitor);
+  if (FAILED(hr))
+    return hr;
+
+  if (!deflater->EndEntry()) {
     LOG(ERROR) << "Could not close zip file entry " << entry->Title();
     return E_FAIL;
   }
+  return S_OK;
+}
 
-  return hr;
+HRESULT ReportUploader::DeduplicateEntry(ChunkDeduplicator* deduplicator,
+                                         IReportContentEntry* entry) {
+  // Data deflated ahead of time is inflated back on the way, as a change
+  // anywhere shifts all of the deflated bytes after it, which would leave
+  // no chunk of a log matching those of its last upload.
+  deduplicator->BeginEntry(entry->Title(),
+                           GetCompressionLevel(entry->Title()));
+
+  DeduplicatingVisitor visitor(deduplicator);
+  PrecompressedSegment segment;
+  HRESULT hr = S_OK;
+  if (entry->GetPrecompressedSegment(&segment)) {
+    InflatingVisitor inflater(&visitor, segment);
+    hr = ReadSegmentData(segment, &abort_, &inflater);
+    if (SUCCEEDED(hr))
+      hr = inflater.Finish();
+  } else {
+    hr = ReadEntryData(entry, &abort_, &visitor);
+  }
+
+  if (FAILED(hr))
+    return hr;
+  return deduplicator->EndEntry();
 }
 
 // The function executes POST to the specified crash server.
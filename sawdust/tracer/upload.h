@@ -19,9 +19,17 @@
 
 #include <windows.h>
 #include <iostream>  // NOLINT - streams used as abstracts, without formatting.
+#include <map>
+#include <string>
 
 #include "base/file_path.h"
 
+class BandwidthThrottle;
+class ChunkDeduplicator;
+class IArchiveSink;
+class ParallelDeflater;
+struct PrecompressedSegment;
+
 // A single entry corresponding to a file in the target archive. The purpose of
 // istream masquerade is to have consistent interface to binary files (logs) and
 // whatever other content we might want to write. These streams are never used
@@ -34,6 +42,22 @@ class IReportContentEntry {
   // done and then call 'MarkCompleted'.
   virtual std::istream& Data() = 0;
 
+  // Entries that hold their data in memory, such as a mapped file, may hand
+  // it out in large blocks instead, saving the copies through Data(). Sets
+  // |data| and |size| to the next block, which stays valid until the next
+  // call or MarkCompleted, and returns S_OK, or S_FALSE past the end. The
+  // client reads Data() instead if this returns E_NOTIMPL, as by default.
+  virtual HRESULT NextBlock(const char** data, size_t* size) {
+    return E_NOTIMPL;
+  }
+
+  // Entries whose data was deflated ahead of time, see PrecompressSegment,
+  // go into the archive as they are rather than being compressed again.
+  // Sets |segment| and returns true if so. By default entries aren't.
+  virtual bool GetPrecompressedSegment(PrecompressedSegment* segment) {
+    return false;
+  }
+
   // The file name that should be associated with the stream when it is sent to
   // its destination.
   virtual const char * Title() const = 0;
@@ -62,7 +86,10 @@ class ReportUploader {
   ReportUploader(const std::wstring& target, bool local);
   virtual ~ReportUploader();
 
-  // This should take a list of streams (or 'stream factories' to archive)
+  // This should take a list of streams (or 'stream factories' to archive).
+  // Remote uploads compress on a worker thread into a bounded queue, which
+  // the calling thread streams to the server meanwhile, so compression and
+  // network overlap and the archive is never read back from disk.
   HRESULT Upload(IReportContent* content);
 
   // UploadArchive is invoked by Upload, but it is left public to permit GUI-
@@ -75,10 +102,64 @@ class ReportUploader {
   // Sets the 'abort' flag and returns immediately.
   void SignalAbort();
 
+  // Sets whether remote uploads also write the archive to a temporary file,
+  // which a failed upload retains for UploadArchive to retry from. On by
+  // default.
+  void set_keep_retry_archive(bool keep) { keep_retry_archive_ = keep; }
+
+  // Sets whether remote uploads go in checksummed chunks which the server
+  // acknowledges, so that UploadArchive resumes a failed upload from the
+  // last chunk the server holds rather than from scratch. The archive is
+  // then compressed in full to a temporary file before it goes out. Off by
+  // default.
+  void set_resumable(bool resumable) { resumable_ = resumable; }
+
+  // Sets whether remote uploads send the entries in chunks cut by their
+  // content, skipping those the server holds from earlier uploads, and then
+  // a manifest the server puts the report together from. This beats the
+  // resumable and streamed uploads, and leaves no archive to retry from.
+  // Off by default.
+  void set_deduplicated(bool deduplicated) { deduplicated_ = deduplicated; }
+
+  // Sets the deflate level, from 0 (store) to 9, of the entries whose titles
+  // end in |extension|, say ".etl". Level 1 gets through the long runs of
+  // padding in ETW logs much faster than the default, at little cost in size.
+  void set_compression_level(const std::string& extension, int level);
+
+  // Sets the deflate level of the entries no extension has a level for.
+  void set_default_compression_level(int level);
+
+  // Sets whether the archive is read and compressed in background processing
+  // mode, with low CPU and I/O priority, so that packaging a report doesn't
+  // slow the machine down. Off by default.
+  void set_background(bool background) { background_ = background; }
+
+  // Sets the throttle remote uploads are sent through, which limits their
+  // rate and counts their progress, or NULL, the default, for none. It must
+  // outlive the upload. The retry of a streamed upload, which posts the
+  // whole archive at once, goes unthrottled.
+  void set_throttle(BandwidthThrottle* throttle) { throttle_ = throttle; }
+
+  // The text the server answered the last streamed or deduplicated upload,
+  // or its retry, with. Empty for resumable uploads and local targets.
+  const std::wstring& server_response() const { return server_response_; }
+
  protected:
   // Write the entire |content| into zip file at temp_archive_path_.
   HRESULT ZipContent(IReportContent* content);
 
+  // Write the entire |content| as a zip archive into |sink|, compressing the
+  // entries on a few threads.
+  HRESULT WriteArchive(IReportContent* content, IArchiveSink* sink);
+
+  // Compress |content| on a worker thread while streaming the archive to the
+  // crash server, keeping a copy at temp_archive_path_ if so configured.
+  HRESULT StreamContent(IReportContent* content);
+
+  // Send the entries of |content| to the chunk store at the crash server,
+  // see ChunkDeduplicator.
+  HRESULT UploadDeduplicated(IReportContent* content);
+
   // Remove the temporary archive from the local drive.
   void ClearTemporaryData();
 
@@ -91,12 +172,35 @@ class ReportUploader {
   virtual bool MakeTemporaryPath(FilePath* tmp_file_path) const;
 
  private:
-  HRESULT WriteEntryIntoZip(void* zip_handle, IReportContentEntry* entry);
+  class CompressionWorker;
+
+  HRESULT WriteEntryIntoZip(ParallelDeflater* deflater,
+                            IReportContentEntry* entry);
+  // Copies the deflated data of a precompressed |entry| into the archive.
+  HRESULT WritePrecompressedEntry(ParallelDeflater* deflater,
+                                  IReportContentEntry* entry,
+                                  const PrecompressedSegment& segment);
+  // Feeds the data of |entry| to |deduplicator|, inflating it back if it
+  // was deflated ahead of time.
+  HRESULT DeduplicateEntry(ChunkDeduplicator* deduplicator,
+                           IReportContentEntry* entry);
+
+  // The deflate level for the entry titled |title|.
+  int GetCompressionLevel(const char* title) const;
 
   std::wstring uri_target_;  // Upload target path.
   bool remote_upload_;  // Is uri_target_ a HTTP location or a local path.
   FilePath temp_archive_path_;  // Points at the zip archive while created.
   bool abort_;  // Signals that compression and upload is to be abandoned.
+  bool keep_retry_archive_;  // Remote uploads keep temp_archive_path_.
+  bool resumable_;  // Remote uploads go in resumable chunks.
+  bool deduplicated_;  // Remote uploads send only the chunks not held.
+  bool background_;  // The archive is compressed in background mode.
+  BandwidthThrottle* throttle_;  // Throttles remote uploads, may be NULL.
+  std::wstring server_response_;  // The answer to the last upload.
+  std::string upload_id_;  // Names the resumable upload to the server.
+  std::map<std::string, int> compression_levels_;  // By title extension.
+  int default_compression_level_;
 
   DISALLOW_COPY_AND_ASSIGN(ReportUploader);
 };
@@ -0,0 +1,456 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Measures the upload pipeline on synthetic reports: how fast a report is
+// packaged at each compression level, how fast reports go to a crash server
+// in each upload mode, several at a time, and the peak memory each takes.
+// Point it at test_server/crash_eater.py, run with --discard so that the
+// load doesn't fill the disk.
+//
+// Usage: upload_benchmark [--size_mb=N] [--entries=N] [--concurrency=N]
+//            [--url=<report URL>] [--stats_url=<server>/stats]
+
+#include <windows.h>
+#include <psapi.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <sstream>  // NOLINT - streams used as abstracts, without formatting.
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/scoped_ptr.h"
+#include "base/scoped_temp_dir.h"
+#include "base/string_number_conversions.h"
+#include "base/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/simple_thread.h"
+#include "base/time.h"
+#include "third_party/zlib/zlib.h"
+
+#include "sawdust/tracer/bandwidth_throttle.h"
+#include "sawdust/tracer/chunked_upload.h"
+#include "sawdust/tracer/upload.h"
+
+#include <InitGuid.h>  // NOLINT - both required to link.
+#include "sawdust/tracer/sawdust_guids.h"  // NOLINT
+
+namespace {
+
+const int kDefaultSizeMb = 64;
+const int kDefaultEntryCount = 4;
+const int kDefaultConcurrency = 4;
+
+// Entries are served in blocks the size of an ETW buffer, the start of
+// which holds events and the rest padding, as in the logs.
+const size_t kBlockSize = 64 * 1024;
+const size_t kEventBytesPerBlock = 24 * 1024;
+const size_t kMaxEventSize = 256;
+
+// The committed memory is sampled this often for its peak.
+const int kMemorySampleMs = 5;
+
+const double kMegabyte = 1024.0 * 1024.0;
+
+const char kHexDigits[] = "0123456789abcdef";
+
+// The words of the events, for the data to deflate about as logs do.
+const char* const kWords[] = {
+  "browser", "render", "process", "thread", "message", "loop", "task",
+  "posted", "started", "finished", "failed", "cache", "entry", "url",
+  "request", "response", "bytes", "read", "write", "timeout", "0x0000",
+  "handle", "window", "paint", "layout", "script", "plugin", "gpu",
+};
+
+enum UploadMode {
+  STREAMED_UPLOAD,
+  RESUMABLE_UPLOAD,
+  DEDUPLICATED_UPLOAD,
+};
+
+// Serves |size| bytes of log-like data in blocks, made up from |seed|, so
+// that entries made alike are alike.
+class SyntheticEntry : public IReportContentEntry {
+ public:
+  SyntheticEntry(const std::string& title, uint64 size, uint32 seed)
+      : title_(title), size_(size), served_(0), state_(seed),
+        block_(kBlockSize) {
+  }
+
+  // The data only goes in blocks.
+  virtual std::istream& Data() { return empty_stream_; }
+
+  virtual HRESULT NextBlock(const char** data, size_t* size) {
+    if (served_ >= size_)
+      return S_FALSE;
+
+    FillBlock();
+    *data = &block_[0];
+    *size = static_cast<size_t>(std::min<uint64>(kBlockSize,
+                                                 size_ - served_));
+    served_ += *size;
+    return S_OK;
+  }
+
+  virtual const char* Title() const { return title_.c_str(); }
+
+  virtual void MarkCompleted() {
+  }
+
+ private:
+  uint32 NextRandom() {
+    state_ = state_ * 1103515245 + 12345;
+    return state_ >> 8;
+  }
+
+  // Events are lines of a changing hex stamp and a few words.
+  void FillBlock() {
+    size_t pos = 0;
+    while (pos + kMaxEventSize <= kEventBytesPerBlock) {
+      uint32 stamp = NextRandom();
+      for (int shift = 20; shift >= 0; shift -= 4)
+        block_[pos++] = kHexDigits[(stamp >> shift) & 0xF];
+
+      int word_count = 3 + NextRandom() % 8;
+      for (int i = 0; i < word_count; ++i) {
+        const char* word = kWords[NextRandom() % arraysize(kWords)];
+        size_t length = strlen(word);
+        block_[pos++] = ' ';
+        memcpy(&block_[pos], word, length);
+        pos += length;
+      }
+      block_[pos++] = '\n';
+    }
+    memset(&block_[pos], 0, kBlockSize - pos);
+  }
+
+  std::string title_;
+  uint64 size_;
+  uint64 served_;
+  uint32 state_;
+  std::vector<char> block_;
+  std::istringstream empty_stream_;
+
+  DISALLOW_COPY_AND_ASSIGN(SyntheticEntry);
+};
+
+// A report of |entry_count| entries of |entry_size| bytes each.
+class SyntheticContent : public IReportContent {
+ public:
+  SyntheticContent(int entry_count, uint64 entry_size, uint32 seed)
+      : entry_count_(entry_count), entry_size_(entry_size), seed_(seed),
+        next_entry_(0) {
+  }
+
+  virtual HRESULT GetNextEntry(IReportContentEntry** entry) {
+    if (next_entry_ >= entry_count_) {
+      *entry = NULL;
+      return S_FALSE;
+    }
+
+    current_entry_.reset(new SyntheticEntry(
+        base::StringPrintf("Synthetic%d.etl", next_entry_), entry_size_,
+        seed_ + next_entry_));
+    ++next_entry_;
+    *entry = current_entry_.get();
+    return S_OK;
+  }
+
+  uint64 total_size() const { return entry_count_ * entry_size_; }
+
+ private:
+  int entry_count_;
+  uint64 entry_size_;
+  uint32 seed_;
+  int next_entry_;
+  scoped_ptr<SyntheticEntry> current_entry_;
+
+  DISALLOW_COPY_AND_ASSIGN(SyntheticContent);
+};
+
+// Samples the memory committed by the process on a thread of its own, from
+// construction to Stop, for the peak.
+class PeakMemorySampler : public base::DelegateSimpleThread::Delegate {
+ public:
+  PeakMemorySampler()
+      : stop_event_(false, false), baseline_(GetCommittedMemory()),
+        peak_(baseline_), thread_(this, "PeakMemorySampler"),
+        stopped_(false) {
+    thread_.Start();
+  }
+
+  ~PeakMemorySampler() {
+    Stop();
+  }
+
+  void Run() {
+    do {
+      peak_ = std::max(peak_, GetCommittedMemory());
+    } while (!stop_event_.TimedWait(
+        base::TimeDelta::FromMilliseconds(kMemorySampleMs)));
+  }
+
+  // Returns the peak above what was committed at construction.
+  size_t Stop() {
+    if (!stopped_) {
+      stop_event_.Signal();
+      thread_.Join();
+      stopped_ = true;
+    }
+    return peak_ - baseline_;
+  }
+
+ private:
+  static size_t GetCommittedMemory() {
+    PROCESS_MEMORY_COUNTERS counters = { sizeof(counters) };
+    if (!::GetProcessMemoryInfo(::GetCurrentProcess(), &counters,
+                                sizeof(counters))) {
+      return 0;
+    }
+    return counters.PagefileUsage;
+  }
+
+  base::WaitableEvent stop_event_;
+  size_t baseline_;
+  size_t peak_;
+  base::DelegateSimpleThread thread_;
+  bool stopped_;
+
+  DISALLOW_COPY_AND_ASSIGN(PeakMemorySampler);
+};
+
+// Uploads a synthetic report on a thread of its own.
+class UploadWorker : public base::DelegateSimpleThread::Delegate {
+ public:
+  // |counter| counts the bytes sent, for all workers.
+  UploadWorker(const std::wstring& url,
+               UploadMode mode,
+               int entry_count,
+               uint64 entry_size,
+               uint32 seed,
+               BandwidthThrottle* counter)
+      : url_(url), mode_(mode), entry_count_(entry_count),
+        entry_size_(entry_size), seed_(seed), counter_(counter),
+        hr_(E_PENDING) {
+  }
+
+  void Run() {
+    SyntheticContent content(entry_count_, entry_size_, seed_);
+    ReportUploader uploader(url_, false);
+    uploader.set_resumable(mode_ == RESUMABLE_UPLOAD);
+    uploader.set_deduplicated(mode_ == DEDUPLICATED_UPLOAD);
+    uploader.set_keep_retry_archive(false);
+    uploader.set_throttle(counter_);
+    hr_ = uploader.Upload(&content);
+  }
+
+  // Valid once the thread has been joined.
+  HRESULT hr() const { return hr_; }
+
+ private:
+  std::wstring url_;
+  UploadMode mode_;
+  int entry_count_;
+  uint64 entry_size_;
+  uint32 seed_;
+  BandwidthThrottle* counter_;
+  HRESULT hr_;
+
+  DISALLOW_COPY_AND_ASSIGN(UploadWorker);
+};
+
+// Prints a benchmark's results: the rate the report data went at, the
+// bytes that came out of the pipeline, and the peak memory it took.
+void Report(const char* name,
+            uint64 report_bytes,
+            uint64 output_bytes,
+            size_t peak_memory,
+            int failures,
+            base::TimeDelta elapsed) {
+  double seconds = std::max(elapsed.InSecondsF(), 1e-9);
+  printf("%-32s %10.1f %10.1f %10.1f %8d\n", name,
+         report_bytes / kMegabyte / seconds, output_bytes / kMegabyte,
+         peak_memory / kMegabyte, failures);
+}
+
+// Reads a report through, to tell the cost of making up the data from that
+// of the pipeline.
+void BenchmarkGeneration(int entry_count, uint64 entry_size) {
+  SyntheticContent content(entry_count, entry_size, 1);
+  PeakMemorySampler sampler;
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  IReportContentEntry* entry = NULL;
+  while (content.GetNextEntry(&entry) == S_OK) {
+    const char* data = NULL;
+    size_t size = 0;
+    while (entry->NextBlock(&data, &size) == S_OK) {
+    }
+  }
+  base::TimeDelta elapsed = base::TimeTicks::HighResNow() - start;
+  Report("Generation", content.total_size(), 0, sampler.Stop(), 0, elapsed);
+}
+
+// Packages a report into a local archive at deflate |level|.
+void BenchmarkArchive(const char* name,
+                      int level,
+                      int entry_count,
+                      uint64 entry_size,
+                      const FilePath& directory) {
+  FilePath archive_path(directory.AppendASCII("benchmark.zip"));
+  SyntheticContent content(entry_count, entry_size, 1);
+  ReportUploader uploader(archive_path.value(), true);
+  uploader.set_default_compression_level(level);
+
+  PeakMemorySampler sampler;
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  HRESULT hr = uploader.Upload(&content);
+  base::TimeDelta elapsed = base::TimeTicks::HighResNow() - start;
+  size_t peak_memory = sampler.Stop();
+
+  int64 archive_size = 0;
+  file_util::GetFileSize(archive_path, &archive_size);
+  file_util::Delete(archive_path, false);
+  Report(name, content.total_size(), archive_size, peak_memory,
+         FAILED(hr) ? 1 : 0, elapsed);
+}
+
+// Uploads |concurrency| reports to |url| at once, each made up from a seed
+// of its own from |seed| on.
+void BenchmarkUpload(const char* name,
+                     UploadMode mode,
+                     const std::wstring& url,
+                     int concurrency,
+                     int entry_count,
+                     uint64 entry_size,
+                     uint32 seed) {
+  BandwidthThrottle counter(0);
+  std::vector<UploadWorker*> workers;
+  std::vector<base::DelegateSimpleThread*> threads;
+  for (int i = 0; i < concurrency; ++i) {
+    workers.push_back(new UploadWorker(url, mode, entry_count, entry_size,
+                                       seed + i * entry_count, &counter));
+    threads.push_back(new base::DelegateSimpleThread(workers.back(),
+                                                     "UploadWorker"));
+  }
+
+  PeakMemorySampler sampler;
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  for (int i = 0; i < concurrency; ++i)
+    threads[i]->Start();
+  for (int i = 0; i < concurrency; ++i)
+    threads[i]->Join();
+  base::TimeDelta elapsed = base::TimeTicks::HighResNow() - start;
+  size_t peak_memory = sampler.Stop();
+
+  int failures = 0;
+  for (int i = 0; i < concurrency; ++i) {
+    if (FAILED(workers[i]->hr()))
+      ++failures;
+    delete threads[i];
+    delete workers[i];
+  }
+  Report(name, concurrency * entry_count * entry_size,
+         counter.GetBytesSent(), peak_memory, failures, elapsed);
+}
+
+// Reads a positive number from switch |name|, if given, into |value|.
+bool GetPositiveSwitch(const CommandLine* cmd_line,
+                       const char* name,
+                       int* value) {
+  if (!cmd_line->HasSwitch(name))
+    return true;
+  return base::StringToInt(cmd_line->GetSwitchValueASCII(name), value) &&
+      *value > 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  CommandLine::Init(argc, argv);
+  const CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+
+  int size_mb = kDefaultSizeMb;
+  int entry_count = kDefaultEntryCount;
+  int concurrency = kDefaultConcurrency;
+  if (!GetPositiveSwitch(cmd_line, "size_mb", &size_mb) ||
+      !GetPositiveSwitch(cmd_line, "entries", &entry_count) ||
+      !GetPositiveSwitch(cmd_line, "concurrency", &concurrency)) {
+    printf("--size_mb, --entries and --concurrency take positive numbers.\n");
+    return 1;
+  }
+  uint64 entry_size = static_cast<uint64>(size_mb) * 1024 * 1024 /
+      entry_count;
+
+  ScopedTempDir temp_dir;
+  if (!temp_dir.CreateUniqueTempDir()) {
+    printf("Failed to create a temporary directory.\n");
+    return 1;
+  }
+
+  printf("%-32s %10s %10s %10s %8s\n",
+         "Benchmark", "MB/s", "Out MB", "Peak MB", "Failed");
+  BenchmarkGeneration(entry_count, entry_size);
+  BenchmarkArchive("Archive, store", Z_NO_COMPRESSION, entry_count,
+                   entry_size, temp_dir.path());
+  BenchmarkArchive("Archive, fast", Z_BEST_SPEED, entry_count, entry_size,
+                   temp_dir.path());
+  BenchmarkArchive("Archive, default", Z_DEFAULT_COMPRESSION, entry_count,
+                   entry_size, temp_dir.path());
+  BenchmarkArchive("Archive, best", Z_BEST_COMPRESSION, entry_count,
+                   entry_size, temp_dir.path());
+
+  std::wstring url(cmd_line->GetSwitchValueNative("url"));
+  if (url.empty())
+    return 0;
+
+  // The server keeps the chunks of deduplicated uploads, so each run starts
+  // from seeds of its own for the first of them to find none.
+  uint32 seed = ::GetTickCount();
+  std::string title;
+  base::SStringPrintf(&title, "Upload x%d, streamed", concurrency);
+  BenchmarkUpload(title.c_str(), STREAMED_UPLOAD, url, concurrency,
+                  entry_count, entry_size, seed);
+  base::SStringPrintf(&title, "Upload x%d, resumable", concurrency);
+  BenchmarkUpload(title.c_str(), RESUMABLE_UPLOAD, url, concurrency,
+                  entry_count, entry_size, seed);
+  base::SStringPrintf(&title, "Upload x%d, deduplicated", concurrency);
+  BenchmarkUpload(title.c_str(), DEDUPLICATED_UPLOAD, url, concurrency,
+                  entry_count, entry_size, seed);
+  base::SStringPrintf(&title, "Upload x%d, deduplicated again",
+                      concurrency);
+  BenchmarkUpload(title.c_str(), DEDUPLICATED_UPLOAD, url, concurrency,
+                  entry_count, entry_size, seed);
+
+  std::wstring stats_url(cmd_line->GetSwitchValueNative("stats_url"));
+  if (!stats_url.empty()) {
+    DWORD status = 0;
+    std::string stats;
+    HRESULT hr = SendHttpRequest(L"GET", stats_url.c_str(), NULL,
+                                 std::string(), &status, &stats);
+    if (SUCCEEDED(hr) && status == 200)
+      printf("\nServer:\n%s", stats.c_str());
+    else
+      printf("\nFailed to get the server's stats, error 0x%08X status %u.\n",
+             hr, status);
+  }
+
+  return 0;
+}
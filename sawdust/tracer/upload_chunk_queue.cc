@@ -0,0 +1,77 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Bounded archive chunk queue.
+
+#include "sawdust/tracer/upload_chunk_queue.h"
+
+#include "base/logging.h"
+
+UploadChunkQueue::UploadChunkQueue(size_t max_chunks)
+    : changed_(&lock_), max_chunks_(max_chunks), closed_(false),
+      cancelled_(false) {
+  DCHECK_LT(0u, max_chunks);
+}
+
+UploadChunkQueue::~UploadChunkQueue() {
+}
+
+bool UploadChunkQueue::Push(std::string* chunk) {
+  DCHECK(chunk != NULL);
+
+  base::AutoLock lock(lock_);
+  DCHECK(!closed_);
+  while (!cancelled_ && chunks_.size() >= max_chunks_)
+    changed_.Wait();
+  if (cancelled_)
+    return false;
+
+  chunks_.push_back(std::string());
+  chunks_.back().swap(*chunk);
+  changed_.Broadcast();
+  return true;
+}
+
+bool UploadChunkQueue::Pop(std::string* chunk) {
+  DCHECK(chunk != NULL);
+
+  base::AutoLock lock(lock_);
+  while (!cancelled_ && !closed_ && chunks_.empty())
+    changed_.Wait();
+  if (cancelled_ || chunks_.empty())
+    return false;
+
+  chunk->swap(chunks_.front());
+  chunks_.pop_front();
+  changed_.Broadcast();
+  return true;
+}
+
+void UploadChunkQueue::Close() {
+  base::AutoLock lock(lock_);
+  closed_ = true;
+  changed_.Broadcast();
+}
+
+void UploadChunkQueue::Cancel() {
+  base::AutoLock lock(lock_);
+  cancelled_ = true;
+  chunks_.clear();
+  changed_.Broadcast();
+}
+
+bool UploadChunkQueue::cancelled() const {
+  base::AutoLock lock(lock_);
+  return cancelled_;
+}
@@ -0,0 +1,64 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// A bounded queue of archive chunks, from the compressor to the uploader.
+
+#ifndef SAWDUST_TRACER_UPLOAD_CHUNK_QUEUE_H_
+#define SAWDUST_TRACER_UPLOAD_CHUNK_QUEUE_H_
+
+#include <deque>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+
+// Hands chunks of an archive from the thread compressing it to the thread
+// sending it. The producer blocks while the queue is full, so the memory in
+// flight stays bounded whichever end is faster.
+class UploadChunkQueue {
+ public:
+  explicit UploadChunkQueue(size_t max_chunks);
+  ~UploadChunkQueue();
+
+  // Queues |chunk|, whose content is swapped out, blocking while the queue is
+  // full. Returns false if the queue was cancelled.
+  bool Push(std::string* chunk);
+
+  // Takes the next chunk into |chunk|, blocking while the queue is empty and
+  // open. Returns false once the queue is closed and drained, or cancelled.
+  bool Pop(std::string* chunk);
+
+  // Signals that no more chunks will be pushed.
+  void Close();
+
+  // Discards the queued chunks and fails both ends from now on. Either end
+  // cancels to abandon the transfer.
+  void Cancel();
+
+  bool cancelled() const;
+
+ private:
+  mutable base::Lock lock_;
+  // Signalled as chunks are pushed or popped, and as the queue closes.
+  base::ConditionVariable changed_;
+  std::deque<std::string> chunks_;
+  size_t max_chunks_;
+  bool closed_;
+  bool cancelled_;
+
+  DISALLOW_COPY_AND_ASSIGN(UploadChunkQueue);
+};
+
+#endif  // SAWDUST_TRACER_UPLOAD_CHUNK_QUEUE_H_
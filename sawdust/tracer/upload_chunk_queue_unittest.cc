@@ -0,0 +1,111 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Bounded archive chunk queue unittests.
+
+#include "sawdust/tracer/upload_chunk_queue.h"
+
+#include <string>
+
+#include "base/stringprintf.h"
+#include "base/threading/simple_thread.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+const int kChunkCount = 100;
+
+// Pushes numbered chunks until done or the queue is cancelled.
+class Producer : public base::DelegateSimpleThread::Delegate {
+ public:
+  explicit Producer(UploadChunkQueue* queue)
+      : queue_(queue), pushed_(0), close_(true) {
+  }
+
+  void Run() {
+    for (int i = 0; i < kChunkCount; ++i) {
+      std::string chunk(base::StringPrintf("chunk %d", i));
+      if (!queue_->Push(&chunk))
+        return;
+      EXPECT_TRUE(chunk.empty());
+      ++pushed_;
+    }
+    if (close_)
+      queue_->Close();
+  }
+
+  int pushed() const { return pushed_; }
+  void set_close(bool close) { close_ = close; }
+
+ private:
+  UploadChunkQueue* queue_;
+  int pushed_;
+  bool close_;
+};
+
+TEST(UploadChunkQueueTest, HandsChunksOverInOrder) {
+  UploadChunkQueue queue(2);
+  Producer producer(&queue);
+  base::DelegateSimpleThread thread(&producer, "Producer");
+  thread.Start();
+
+  std::string chunk;
+  int popped = 0;
+  while (queue.Pop(&chunk)) {
+    EXPECT_EQ(base::StringPrintf("chunk %d", popped), chunk);
+    ++popped;
+  }
+  thread.Join();
+
+  EXPECT_EQ(kChunkCount, popped);
+  EXPECT_EQ(kChunkCount, producer.pushed());
+  EXPECT_FALSE(queue.cancelled());
+}
+
+TEST(UploadChunkQueueTest, CancelUnblocksProducer) {
+  UploadChunkQueue queue(2);
+  Producer producer(&queue);
+  producer.set_close(false);
+  base::DelegateSimpleThread thread(&producer, "Producer");
+  thread.Start();
+
+  std::string chunk;
+  ASSERT_TRUE(queue.Pop(&chunk));
+  EXPECT_EQ("chunk 0", chunk);
+
+  // The producer fills the queue and blocks, until the cancel fails it.
+  queue.Cancel();
+  thread.Join();
+  EXPECT_GT(kChunkCount, producer.pushed());
+  EXPECT_TRUE(queue.cancelled());
+  EXPECT_FALSE(queue.Pop(&chunk));
+}
+
+TEST(UploadChunkQueueTest, CloseDrainsQueue) {
+  UploadChunkQueue queue(4);
+  std::string chunk("one");
+  ASSERT_TRUE(queue.Push(&chunk));
+  chunk = "two";
+  ASSERT_TRUE(queue.Push(&chunk));
+  queue.Close();
+
+  ASSERT_TRUE(queue.Pop(&chunk));
+  EXPECT_EQ("one", chunk);
+  ASSERT_TRUE(queue.Pop(&chunk));
+  EXPECT_EQ("two", chunk);
+  EXPECT_FALSE(queue.Pop(&chunk));
+  EXPECT_FALSE(queue.cancelled());
+}
+
+}  // namespace
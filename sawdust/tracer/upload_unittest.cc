@@ -17,6 +17,7 @@
 #include <stdlib.h>
 #include <time.h>
 
+#include <algorithm>
 #include <sstream>
 #include <string>
 
@@ -24,6 +25,7 @@
 #include "base/file_util.h"
 #include "base/logging.h"
 #include "base/scoped_temp_dir.h"
+#include "base/stringprintf.h"
 #include "base/utf_string_conversions.h"
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
@@ -63,6 +65,28 @@ class ScopedZipWrap {
       return UNZ_OK == unzLocateFile(file_, path, 0);
     return false;
   }
+
+  bool GetCompressedSize(const char* path, uLong* size) {
+    unz_file_info info = {};
+    if (!CheckFileExists(path) ||
+        unzGetCurrentFileInfo(file_, &info, NULL, 0, NULL, 0, NULL, 0) !=
+            UNZ_OK) {
+      return false;
+    }
+    *size = info.compressed_size;
+    return true;
+  }
+
+  bool ReadFile(const char* path, std::string* content) {
+    if (!CheckFileExists(path) || unzOpenCurrentFile(file_) != UNZ_OK)
+      return false;
+    content->clear();
+    char buffer[4096];
+    int read = 0;
+    while ((read = unzReadCurrentFile(file_, buffer, sizeof(buffer))) > 0)
+      content->append(buffer, read);
+    return unzCloseCurrentFile(file_) == UNZ_OK && read == 0;
+  }
  private:
   unzFile file_;
 };
@@ -86,6 +110,32 @@ class ContentFromText : public IReportContentEntry {
   std::istringstream content_;
 };
 
+// Serves given text in blocks of |block_size|, with no stream to read.
+class ContentFromBlocks : public ContentFromText {
+ public:
+  ContentFromBlocks(const std::string& title, const std::string& data,
+                    size_t block_size)
+      : ContentFromText(title, ""), data_(data), block_size_(block_size),
+        offset_(0) {
+  }
+
+  HRESULT NextBlock(const char** data, size_t* size) {
+    if (offset_ == data_.size())
+      return S_FALSE;
+    *data = data_.data() + offset_;
+    *size = std::min(block_size_, data_.size() - offset_);
+    offset_ += *size;
+    return S_OK;
+  }
+
+  void MarkCompleted() { offset_ = 0; }
+
+ private:
+  std::string data_;
+  size_t block_size_;
+  size_t offset_;
+};
+
 // A prop to tests the abort action. Call uploader's abort when it tries to
 // dismiss it
 class ContentWithAbortCall : public ContentFromText {
@@ -290,6 +340,61 @@ TEST_F(ReportUploadTest, CompressionToLocal) {
   ASSERT_TRUE(verified_zip.Close());
 }
 
+TEST_F(ReportUploadTest, CompressionFromBlocks) {
+  FilePath file_path = temp_dir_.path().AppendASCII("CompressionBlocks.zip");
+
+  TestingReportUploader uploader(file_path.value(), true);
+
+  std::string text;
+  for (int i = 0; i < 20000; ++i)
+    text.append(base::StringPrintf("Log line %d.\n", i));
+  TestContentContainer data_feed;
+  data_feed.Add(new ContentFromBlocks("blocks.etl", text, 100000));
+  data_feed.Add(new ContentFromText("stream.txt", text));
+  data_feed.Add(new ContentFromBlocks("empty.etl", "", 100000));
+
+  ASSERT_HRESULT_SUCCEEDED(uploader.Upload(&data_feed));
+
+  ScopedZipWrap verified_zip;
+  ASSERT_TRUE(verified_zip.Open(file_path));
+  std::string content;
+  ASSERT_TRUE(verified_zip.ReadFile("blocks.etl", &content));
+  EXPECT_TRUE(content == text);
+  ASSERT_TRUE(verified_zip.ReadFile("stream.txt", &content));
+  EXPECT_TRUE(content == text);
+  ASSERT_TRUE(verified_zip.ReadFile("empty.etl", &content));
+  EXPECT_TRUE(content.empty());
+  ASSERT_TRUE(verified_zip.Close());
+}
+
+TEST_F(ReportUploadTest, CompressionLevels) {
+  FilePath file_path = temp_dir_.path().AppendASCII("CompressionLevels.zip");
+
+  TestingReportUploader uploader(file_path.value(), true);
+  uploader.set_compression_level(".ETL", 0);
+  uploader.set_default_compression_level(9);
+
+  std::string text;
+  for (int i = 0; i < 1000; ++i)
+    text.append("Log line, much like the one before.\n");
+  TestContentContainer data_feed;
+  data_feed.Add(new ContentFromText("stored.etl", text));
+  data_feed.Add(new ContentFromText("deflated.txt", text));
+
+  ASSERT_HRESULT_SUCCEEDED(uploader.Upload(&data_feed));
+
+  ScopedZipWrap verified_zip;
+  ASSERT_TRUE(verified_zip.Open(file_path));
+  uLong stored_size = 0;
+  uLong deflated_size = 0;
+  ASSERT_TRUE(verified_zip.GetCompressedSize("stored.etl", &stored_size));
+  ASSERT_TRUE(verified_zip.GetCompressedSize("deflated.txt",
+                                             &deflated_size));
+  EXPECT_LE(text.size(), stored_size);
+  EXPECT_GT(text.size() / 10, deflated_size);
+  ASSERT_TRUE(verified_zip.Close());
+}
+
 TEST_F(ReportUploadTest, FailureRecovery) {
   FilePath temp_store = temp_dir_.path().AppendASCII("FailureRecovery.temp");
   FilePath target_file = temp_dir_.path().AppendASCII("FailureRecovery.zip");
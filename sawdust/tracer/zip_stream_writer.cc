@@ -0,0 +1,285 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Streaming zip archive writer.
+
+#include "sawdust/tracer/zip_stream_writer.h"
+
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace {
+
+const uint32 kLocalHeaderSignature = 0x04034b50;
+const uint32 kDataDescriptorSignature = 0x08074b50;
+const uint32 kCentralHeaderSignature = 0x02014b50;
+const uint32 kEndOfCentralDirSignature = 0x06054b50;
+
+// Version 2.0 of the format is needed for deflate and data descriptors.
+const uint16 kVersionNeeded = 20;
+// Bit 3: the CRC and sizes are in the trailing data descriptor.
+const uint16 kDataDescriptorFlag = 0x0008;
+const uint16 kDeflateMethod = 8;
+
+// The zip format stores everything little-endian.
+void Append16(uint16 value, std::string* out) {
+  out->push_back(static_cast<char>(value & 0xFF));
+  out->push_back(static_cast<char>(value >> 8));
+}
+
+void Append32(uint32 value, std::string* out) {
+  Append16(static_cast<uint16>(value & 0xFFFF), out);
+  Append16(static_cast<uint16>(value >> 16), out);
+}
+
+// Converts the local time |now| to MS-DOS time and date.
+void ToDosTime(time_t now, uint16* dos_time, uint16* dos_date) {
+  struct tm local = {};
+  localtime_s(&local, &now);
+  *dos_time = static_cast<uint16>((local.tm_hour << 11) |
+                                  (local.tm_min << 5) | (local.tm_sec / 2));
+  // DOS dates start in 1980.
+  int year = std::max(local.tm_year - 80, 0);
+  *dos_date = static_cast<uint16>((year << 9) | ((local.tm_mon + 1) << 5) |
+                                  local.tm_mday);
+}
+
+}  // namespace
+
+ZipStreamWriter::ZipStreamWriter(IArchiveSink* sink)
+    : sink_(sink), in_entry_(false), compressing_(false), failed_(false),
+      offset_(0), dos_time_(0), dos_date_(0) {
+  DCHECK(sink_ != NULL);
+  memset(&stream_, 0, sizeof(stream_));
+  ToDosTime(time(NULL), &dos_time_, &dos_date_);
+}
+
+ZipStreamWriter::~ZipStreamWriter() {
+  if (compressing_)
+    deflateEnd(&stream_);
+}
+
+bool ZipStreamWriter::BeginEntry(const char* name) {
+  return BeginEntryImpl(name, true);
+}
+
+bool ZipStreamWriter::BeginDeflatedEntry(const char* name) {
+  return BeginEntryImpl(name, false);
+}
+
+bool ZipStreamWriter::BeginEntryImpl(const char* name, bool compress) {
+  DCHECK(name != NULL);
+  if (in_entry_ && !EndEntry())
+    return false;
+  if (failed_ || entries_.size() >= 0xFFFF)
+    return false;
+
+  // A raw deflate stream, as the zip headers stand in for zlib's.
+  memset(&stream_, 0, sizeof(stream_));
+  if (compress &&
+      deflateInit2(&stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS,
+                   8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    LOG(ERROR) << "Failed to initialize the compressor.";
+    failed_ = true;
+    return false;
+  }
+  in_entry_ = true;
+  compressing_ = compress;
+
+  current_.name = name;
+  current_.crc = crc32(0L, Z_NULL, 0);
+  current_.compressed_size = 0;
+  current_.size = 0;
+  current_.header_offset = offset_;
+
+  // The CRC and sizes are left zero here, they trail the data.
+  std::string header;
+  Append32(kLocalHeaderSignature, &header);
+  Append16(kVersionNeeded, &header);
+  Append16(kDataDescriptorFlag, &header);
+  Append16(kDeflateMethod, &header);
+  Append16(dos_time_, &header);
+  Append16(dos_date_, &header);
+  Append32(0, &header);  // CRC.
+  Append32(0, &header);  // Compressed size.
+  Append32(0, &header);  // Uncompressed size.
+  Append16(static_cast<uint16>(current_.name.size()), &header);
+  Append16(0, &header);  // Extra field length.
+  header.append(current_.name);
+
+  return Emit(header.data(), header.size());
+}
+
+bool ZipStreamWriter::WriteEntryData(const char* data, size_t size) {
+  DCHECK(in_entry_ && compressing_);
+  if (failed_ || !in_entry_ || !compressing_)
+    return false;
+  if (size == 0)
+    return true;
+
+  if (size > kuint32max - current_.size) {
+    LOG(ERROR) << "Entry " << current_.name << " is too large to zip.";
+    failed_ = true;
+    return false;
+  }
+
+  current_.crc = crc32(current_.crc, reinterpret_cast<const Bytef*>(data),
+                       static_cast<uInt>(size));
+  current_.size += static_cast<uint32>(size);
+
+  stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream_.avail_in = static_cast<uInt>(size);
+  return Deflate(Z_NO_FLUSH);
+}
+
+bool ZipStreamWriter::WriteDeflatedData(const std::string& deflated,
+                                        uint32 crc,
+                                        uint32 size) {
+  return WriteDeflatedData(deflated.data(), deflated.size(), crc, size);
+}
+
+bool ZipStreamWriter::WriteDeflatedData(const char* deflated,
+                                        size_t deflated_size,
+                                        uint32 crc,
+                                        uint32 size) {
+  DCHECK(in_entry_ && !compressing_);
+  if (failed_ || !in_entry_ || compressing_)
+    return false;
+
+  if (size > kuint32max - current_.size ||
+      deflated_size > kuint32max - current_.compressed_size) {
+    LOG(ERROR) << "Entry " << current_.name << " is too large to zip.";
+    failed_ = true;
+    return false;
+  }
+
+  current_.crc = crc32_combine(current_.crc, crc, size);
+  current_.size += size;
+  current_.compressed_size += static_cast<uint32>(deflated_size);
+  return deflated_size == 0 || Emit(deflated, deflated_size);
+}
+
+bool ZipStreamWriter::EndEntry() {
+  if (!in_entry_)
+    return !failed_;
+
+  bool success = !failed_;
+  if (compressing_) {
+    success = success && Deflate(Z_FINISH);
+    deflateEnd(&stream_);
+    compressing_ = false;
+  }
+  in_entry_ = false;
+  if (!success)
+    return false;
+
+  std::string descriptor;
+  Append32(kDataDescriptorSignature, &descriptor);
+  Append32(current_.crc, &descriptor);
+  Append32(current_.compressed_size, &descriptor);
+  Append32(current_.size, &descriptor);
+  entries_.push_back(current_);
+
+  return Emit(descriptor.data(), descriptor.size());
+}
+
+bool ZipStreamWriter::Finish() {
+  if (!EndEntry())
+    return false;
+
+  uint32 directory_offset = offset_;
+  std::string directory;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    const EntryRecord& entry = entries_[i];
+    Append32(kCentralHeaderSignature, &directory);
+    Append16(kVersionNeeded, &directory);  // Version made by.
+    Append16(kVersionNeeded, &directory);
+    Append16(kDataDescriptorFlag, &directory);
+    Append16(kDeflateMethod, &directory);
+    Append16(dos_time_, &directory);
+    Append16(dos_date_, &directory);
+    Append32(entry.crc, &directory);
+    Append32(entry.compressed_size, &directory);
+    Append32(entry.size, &directory);
+    Append16(static_cast<uint16>(entry.name.size()), &directory);
+    Append16(0, &directory);  // Extra field length.
+    Append16(0, &directory);  // Comment length.
+    Append16(0, &directory);  // Disk number.
+    Append16(0, &directory);  // Internal attributes.
+    Append32(0, &directory);  // External attributes.
+    Append32(entry.header_offset, &directory);
+    directory.append(entry.name);
+  }
+
+  uint32 directory_size = static_cast<uint32>(directory.size());
+  Append32(kEndOfCentralDirSignature, &directory);
+  Append16(0, &directory);  // This disk.
+  Append16(0, &directory);  // The disk the directory starts on.
+  Append16(static_cast<uint16>(entries_.size()), &directory);
+  Append16(static_cast<uint16>(entries_.size()), &directory);
+  Append32(directory_size, &directory);
+  Append32(directory_offset, &directory);
+  Append16(0, &directory);  // Comment length.
+
+  bool success = Emit(directory.data(), directory.size());
+  failed_ = true;  // No more writing.
+  return success;
+}
+
+bool ZipStreamWriter::Emit(const void* data, size_t size) {
+  if (failed_)
+    return false;
+
+  if (size > kuint32max - offset_) {
+    LOG(ERROR) << "The archive is too large to zip.";
+    failed_ = true;
+    return false;
+  }
+
+  if (!sink_->Write(static_cast<const char*>(data), size)) {
+    failed_ = true;
+    return false;
+  }
+
+  offset_ += static_cast<uint32>(size);
+  return true;
+}
+
+bool ZipStreamWriter::Deflate(int flush) {
+  int result = Z_OK;
+  do {
+    stream_.next_out = reinterpret_cast<Bytef*>(output_);
+    stream_.avail_out = sizeof(output_);
+    result = deflate(&stream_, flush);
+    if (result == Z_STREAM_ERROR) {
+      LOG(ERROR) << "Compression of " << current_.name << " failed.";
+      failed_ = true;
+      return false;
+    }
+
+    size_t produced = sizeof(output_) - stream_.avail_out;
+    current_.compressed_size += static_cast<uint32>(produced);
+    if (produced != 0 && !Emit(output_, produced))
+      return false;
+    // Without more input, deflate is done once it leaves output space.
+  } while (stream_.avail_out == 0 || (flush == Z_FINISH &&
+                                      result != Z_STREAM_END));
+
+  DCHECK_EQ(0u, stream_.avail_in);
+  return true;
+}
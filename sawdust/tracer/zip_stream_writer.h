@@ -0,0 +1,112 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// A zip archive writer that streams the archive out as it's written.
+
+#ifndef SAWDUST_TRACER_ZIP_STREAM_WRITER_H_
+#define SAWDUST_TRACER_ZIP_STREAM_WRITER_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "third_party/zlib/zlib.h"
+
+// Receives the bytes of an archive in order, as they are produced.
+class IArchiveSink {
+ public:
+  virtual ~IArchiveSink() {}
+
+  // Takes the next |size| bytes of the archive. Returns false to fail the
+  // archive.
+  virtual bool Write(const char* data, size_t size) = 0;
+};
+
+// Writes a zip archive front to back, never seeking, so the archive can go
+// out over a network connection while it is being compressed. Each entry
+// carries its CRC and sizes in a data descriptor that trails its data, as
+// these aren't known up front. The archive is limited to 4 GB and to 64K
+// entries (no zip64 extensions).
+class ZipStreamWriter {
+ public:
+  // |sink| must outlive the writer.
+  explicit ZipStreamWriter(IArchiveSink* sink);
+  ~ZipStreamWriter();
+
+  // Starts a deflated entry named |name|, ending any entry in progress.
+  bool BeginEntry(const char* name);
+
+  // Compresses |size| bytes of |data| into the current entry.
+  bool WriteEntryData(const char* data, size_t size);
+
+  // Starts an entry named |name| whose data comes deflated already, through
+  // WriteDeflatedData, ending any entry in progress.
+  bool BeginDeflatedEntry(const char* name);
+
+  // Writes |deflated|, the next piece of the raw deflate stream of the
+  // current entry, which inflates to |size| bytes with a CRC-32 of |crc|.
+  // The pieces must make up one stream, the last ending it.
+  bool WriteDeflatedData(const std::string& deflated, uint32 crc,
+                         uint32 size);
+  // The same for the |deflated_size| bytes at |deflated|.
+  bool WriteDeflatedData(const char* deflated, size_t deflated_size,
+                         uint32 crc, uint32 size);
+
+  // Ends the current entry, writing out its data descriptor.
+  bool EndEntry();
+
+  // Ends any entry in progress and writes the central directory. The writer
+  // can't be used after this.
+  bool Finish();
+
+  // The number of archive bytes handed to the sink so far.
+  uint32 bytes_written() const { return offset_; }
+
+ private:
+  struct EntryRecord {
+    std::string name;
+    uint32 crc;
+    uint32 compressed_size;
+    uint32 size;
+    uint32 header_offset;
+  };
+
+  // Starts the entry |name|, with a compressor of its own if |compress|.
+  bool BeginEntryImpl(const char* name, bool compress);
+
+  // Hands |size| bytes of |data| to the sink, accounting for the offset.
+  bool Emit(const void* data, size_t size);
+
+  // Runs the compressor over the pending input with |flush|, emitting all
+  // output it produces.
+  bool Deflate(int flush);
+
+  IArchiveSink* sink_;
+  z_stream stream_;
+  bool in_entry_;
+  bool compressing_;  // stream_ compresses the current entry.
+  bool failed_;
+  uint32 offset_;
+  uint16 dos_time_;
+  uint16 dos_date_;
+  EntryRecord current_;
+  std::vector<EntryRecord> entries_;
+
+  static const size_t kOutputBufferSize = 16384;
+  char output_[kOutputBufferSize];
+
+  DISALLOW_COPY_AND_ASSIGN(ZipStreamWriter);
+};
+
+#endif  // SAWDUST_TRACER_ZIP_STREAM_WRITER_H_
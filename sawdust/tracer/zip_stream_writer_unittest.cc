@@ -0,0 +1,138 @@
+// Copyright 2012 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Streaming zip archive writer unittests.
+
+#include "sawdust/tracer/zip_stream_writer.h"
+
+#include <string>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/scoped_temp_dir.h"
+#include "base/utf_string_conversions.h"
+#include "gtest/gtest.h"
+#include "third_party/zlib/contrib/minizip/unzip.h"
+
+namespace {
+
+// Collects the archive in a string.
+class StringSink : public IArchiveSink {
+ public:
+  StringSink() : fail_after_(std::string::npos) {
+  }
+
+  bool Write(const char* data, size_t size) {
+    if (archive_.size() + size > fail_after_)
+      return false;
+    archive_.append(data, size);
+    return true;
+  }
+
+  void set_fail_after(size_t fail_after) { fail_after_ = fail_after; }
+  const std::string& archive() const { return archive_; }
+
+ private:
+  std::string archive_;
+  size_t fail_after_;
+};
+
+class ZipStreamWriterTest : public testing::Test {
+ public:
+  void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+  // Writes |archive| to a file and opens it for unzipping.
+  unzFile OpenArchive(const std::string& archive) {
+    FilePath path = temp_dir_.path().AppendASCII("archive.zip");
+    if (file_util::WriteFile(path, archive.data(), archive.size()) !=
+        static_cast<int>(archive.size())) {
+      return NULL;
+    }
+    return unzOpen(WideToUTF8(path.value()).c_str());
+  }
+
+  // Reads the entry |name| of |file| into |content|.
+  bool ReadEntry(unzFile file, const char* name, std::string* content) {
+    if (unzLocateFile(file, name, 0) != UNZ_OK ||
+        unzOpenCurrentFile(file) != UNZ_OK) {
+      return false;
+    }
+
+    content->clear();
+    char buffer[1024];
+    int read = 0;
+    while ((read = unzReadCurrentFile(file, buffer, sizeof(buffer))) > 0)
+      content->append(buffer, read);
+
+    // Closing checks the CRC.
+    return unzCloseCurrentFile(file) == UNZ_OK && read == 0;
+  }
+
+ protected:
+  ScopedTempDir temp_dir_;
+};
+
+}  // namespace
+
+TEST_F(ZipStreamWriterTest, WritesReadableArchive) {
+  std::string text("Some text that compresses, compresses, compresses.");
+  std::string big;
+  for (int i = 0; i < 100000; ++i)
+    big.push_back(static_cast<char>(i * 7919 % 251));
+
+  StringSink sink;
+  ZipStreamWriter writer(&sink);
+  ASSERT_TRUE(writer.BeginEntry("text.txt"));
+  ASSERT_TRUE(writer.WriteEntryData(text.data(), text.size()));
+  // Beginning an entry ends the last one.
+  ASSERT_TRUE(writer.BeginEntry("empty.txt"));
+  ASSERT_TRUE(writer.BeginEntry("big.dat"));
+  for (size_t i = 0; i < big.size(); i += 1000)
+    ASSERT_TRUE(writer.WriteEntryData(big.data() + i, 1000));
+  ASSERT_TRUE(writer.Finish());
+  EXPECT_EQ(sink.archive().size(), writer.bytes_written());
+
+  unzFile file = OpenArchive(sink.archive());
+  ASSERT_TRUE(file != NULL);
+  std::string content;
+  EXPECT_TRUE(ReadEntry(file, "text.txt", &content));
+  EXPECT_EQ(text, content);
+  EXPECT_TRUE(ReadEntry(file, "empty.txt", &content));
+  EXPECT_EQ("", content);
+  EXPECT_TRUE(ReadEntry(file, "big.dat", &content));
+  EXPECT_TRUE(big == content);
+  EXPECT_EQ(UNZ_OK, unzClose(file));
+}
+
+TEST_F(ZipStreamWriterTest, SinkFailureFailsWriter) {
+  StringSink sink;
+  sink.set_fail_after(100);
+  ZipStreamWriter writer(&sink);
+  ASSERT_TRUE(writer.BeginEntry("data.txt"));
+
+  std::string data(10000, 'x');
+  bool success = true;
+  for (int i = 0; i < 100 && success; ++i) {
+    data[i] = static_cast<char>(i);
+    success = writer.WriteEntryData(data.data(), data.size());
+  }
+  success = success && writer.Finish();
+  EXPECT_FALSE(success);
+
+  // The writer stays failed.
+  EXPECT_FALSE(writer.BeginEntry("more.txt"));
+  EXPECT_FALSE(writer.Finish());
+}